@@ -3,7 +3,7 @@
  *
  * Yori shell display and manipulate file attributes
  *
- * Copyright (c) 2021 Malcolm J. Smith
+ * Copyright (c) 2021-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -157,10 +157,17 @@ typedef struct _ATTRIB_CONTEXT {
 
     /**
      A string to record the unescaped path to display for files.  This is
-     kept here so the allocation can be reused for later files.
+     kept here so the allocation can be reused for later files.  This is
+     only used from the thread enumerating files.
      */
     YORI_STRING UnescapedPath;
 
+    /**
+     The engine used to apply attribute changes in parallel.  This is NULL
+     if attributes are being displayed.
+     */
+    PYORI_LIB_FILE_UPDATE_ENGINE Engine;
+
     /**
      Records the total number of files processed within a single command line
      argument.
@@ -174,13 +181,106 @@ typedef struct _ATTRIB_CONTEXT {
 
 } ATTRIB_CONTEXT, *PATTRIB_CONTEXT;
 
+/**
+ The step of an attribute update that failed.
+ */
+typedef enum _ATTRIB_UPDATE_STEP {
+    AttribUpdateStepQuery = 0,
+    AttribUpdateStepModify = 1
+} ATTRIB_UPDATE_STEP;
+
+/**
+ Apply an attribute change to a file.  This is invoked on a worker thread.
+ The existing attributes are taken from enumeration where available, so
+ each file only needs a single path based call to update it.
+
+ @param Update Pointer to the update describing the file.  On completion,
+        this is updated with the result.
+
+ @param Context Pointer to the attrib context.
+ */
+VOID
+AttribApplyFile(
+    __in PYORI_LIB_FILE_UPDATE Update,
+    __in PVOID Context
+    )
+{
+    PATTRIB_CONTEXT AttribContext = (PATTRIB_CONTEXT)Context;
+    DWORD ExistingAttributes;
+    DWORD NewAttributes;
+
+    if (Update->FileInfo != NULL) {
+        ExistingAttributes = Update->FileInfo->dwFileAttributes;
+    } else {
+        ExistingAttributes = GetFileAttributes(Update->FilePath.StartOfString);
+        if (ExistingAttributes == (DWORD)-1) {
+            Update->Error = GetLastError();
+            Update->FailedStep = AttribUpdateStepQuery;
+            return;
+        }
+    }
+
+    NewAttributes = ExistingAttributes & ~(AttribContext->AttributesToClear);
+    NewAttributes = NewAttributes | AttribContext->AttributesToSet;
+
+    if (NewAttributes != ExistingAttributes) {
+        if (!SetFileAttributes(Update->FilePath.StartOfString, NewAttributes)) {
+            Update->Error = GetLastError();
+            Update->FailedStep = AttribUpdateStepModify;
+            return;
+        }
+        Update->Modified = TRUE;
+    }
+}
+
+/**
+ Report the result of an attribute change to a file.  This is invoked for
+ one file at a time, in the order that files were found.
+
+ @param Update Pointer to the update describing the file and its result.
+
+ @param Context Pointer to the attrib context.
+ */
+VOID
+AttribReportFile(
+    __in PYORI_LIB_FILE_UPDATE Update,
+    __in PVOID Context
+    )
+{
+    PATTRIB_CONTEXT AttribContext = (PATTRIB_CONTEXT)Context;
+    YORI_STRING UnescapedPath;
+    LPTSTR ErrText;
+
+    if (Update->Error != ERROR_SUCCESS) {
+        ErrText = YoriLibGetWinErrorText(Update->Error);
+        if (Update->FailedStep == AttribUpdateStepQuery) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("attrib: query of attributes failed: %y %s"), &Update->FilePath, ErrText);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("attrib: modification of attributes failed: %y %s"), &Update->FilePath, ErrText);
+        }
+        YoriLibFreeWinErrorText(ErrText);
+        return;
+    }
+
+    if (Update->Modified && AttribContext->Verbose) {
+        YoriLibInitEmptyString(&UnescapedPath);
+        if (!YoriLibUnescapePath(&Update->FilePath, &UnescapedPath)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Updating %y\n"), &Update->FilePath);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Updating %y\n"), &UnescapedPath);
+        }
+        YoriLibFreeStringContents(&UnescapedPath);
+    }
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
 
  @param FilePath Pointer to the file path that was found.
 
- @param FileInfo Information about the file.
+ @param FileInfo Information about the file.  This can be NULL if the file
+        was not found by enumeration.
 
  @param Depth Specifies recursion depth.  Ignored in this application.
 
@@ -201,15 +301,30 @@ AttribFileFoundCallback(
     DWORD LastError;
     LPTSTR ErrText;
     DWORD ExistingAttributes;
-    DWORD NewAttributes;
+    TCHAR StrAtts[sizeof(AttribFileAttrPairs)/sizeof(AttribFileAttrPairs[0]) + 1];
+    DWORD Index;
 
     UNREFERENCED_PARAMETER(Depth);
-    UNREFERENCED_PARAMETER(FileInfo);
 
     ASSERT(YoriLibIsStringNullTerminated(FilePath));
 
     AttribContext->FilesFoundThisArg++;
 
+    //
+    //  When changing attributes, the change is applied and reported
+    //  asynchronously.  Errors are reported when the result is known, but
+    //  the file was still found.
+    //
+
+    if (AttribContext->Engine != NULL) {
+        AttribContext->SavedErrorThisArg = ERROR_SUCCESS;
+        AttribContext->FilesFound++;
+        if (!YoriLibQueueFileUpdate(AttribContext->Engine, FilePath, FileInfo)) {
+            return FALSE;
+        }
+        return TRUE;
+    }
+
     ExistingAttributes = GetFileAttributes(FilePath->StartOfString);
     if (ExistingAttributes == (DWORD)-1) {
         LastError = GetLastError();
@@ -219,47 +334,20 @@ AttribFileFoundCallback(
         return TRUE;
     }
 
-    if (AttribContext->AttributesToSet == 0 &&
-        AttribContext->AttributesToClear == 0) {
-
-        TCHAR StrAtts[sizeof(AttribFileAttrPairs)/sizeof(AttribFileAttrPairs[0]) + 1];
-        DWORD Index;
-
-        for (Index = 0; Index < sizeof(AttribFileAttrPairs)/sizeof(AttribFileAttrPairs[0]); Index++) {
-            if (ExistingAttributes & AttribFileAttrPairs[Index].Flag) {
-                StrAtts[Index] = AttribFileAttrPairs[Index].DisplayLetter;
-            } else {
-                StrAtts[Index] = ' ';
-            }
+    for (Index = 0; Index < sizeof(AttribFileAttrPairs)/sizeof(AttribFileAttrPairs[0]); Index++) {
+        if (ExistingAttributes & AttribFileAttrPairs[Index].Flag) {
+            StrAtts[Index] = AttribFileAttrPairs[Index].DisplayLetter;
+        } else {
+            StrAtts[Index] = ' ';
         }
+    }
 
-        StrAtts[Index] = '\0';
+    StrAtts[Index] = '\0';
 
-        if (!YoriLibUnescapePath(FilePath, &AttribContext->UnescapedPath)) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%s %y\n"), StrAtts, FilePath);
-        } else {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%s %y\n"), StrAtts, &AttribContext->UnescapedPath);
-        }
+    if (!YoriLibUnescapePath(FilePath, &AttribContext->UnescapedPath)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%s %y\n"), StrAtts, FilePath);
     } else {
-
-        NewAttributes = ExistingAttributes & ~(AttribContext->AttributesToClear);
-        NewAttributes = NewAttributes | AttribContext->AttributesToSet;
-
-        if (NewAttributes != ExistingAttributes) {
-            if (!SetFileAttributes(FilePath->StartOfString, NewAttributes)) {
-                LastError = GetLastError();
-                ErrText = YoriLibGetWinErrorText(LastError);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("attrib: modification of attributes failed: %y %s"), FilePath, ErrText);
-                YoriLibFreeWinErrorText(ErrText);
-                return TRUE;
-            } else if (AttribContext->Verbose) {
-                if (!YoriLibUnescapePath(FilePath, &AttribContext->UnescapedPath)) {
-                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Updating %y\n"), FilePath);
-                } else {
-                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Updating %y\n"), &AttribContext->UnescapedPath);
-                }
-            }
-        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%s %y\n"), StrAtts, &AttribContext->UnescapedPath);
     }
 
     AttribContext->SavedErrorThisArg = ERROR_SUCCESS;
@@ -439,7 +527,7 @@ ENTRYPOINT(
                 AttribHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2017-2021"));
+                YoriLibDisplayMitLicense(_T("2017-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
@@ -510,10 +598,28 @@ ENTRYPOINT(
         MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
     }
 
+    //
+    //  Changes are applied in parallel, with results reported in the order
+    //  that files are found.  Displaying attributes only needs information
+    //  from enumeration, so it is performed as files are found.
+    //
+
+    if (AttribContext.AttributesToSet != 0 ||
+        AttribContext.AttributesToClear != 0) {
+
+        if (!YoriLibCreateFileUpdateEngine(AttribApplyFile, AttribReportFile, &AttribContext, 0, &AttribContext.Engine)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("attrib: out of memory\n"));
+            return EXIT_FAILURE;
+        }
+    }
+
     if (MatchAllFiles) {
         YoriLibConstantString(&Arg, _T("*"));
 
         if (!YoriLibUserStringToSingleFilePath(&Arg, TRUE, &FullPath)) {
+            if (AttribContext.Engine != NULL) {
+                YoriLibDestroyFileUpdateEngine(AttribContext.Engine);
+            }
             return EXIT_FAILURE;
         }
 
@@ -560,6 +666,10 @@ ENTRYPOINT(
         }
     }
 
+    if (AttribContext.Engine != NULL) {
+        YoriLibDestroyFileUpdateEngine(AttribContext.Engine);
+    }
+
     YoriLibFreeStringContents(&AttribContext.UnescapedPath);
 
     if (AttribContext.FilesFound == 0) {
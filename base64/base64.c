@@ -3,7 +3,7 @@
  *
  * Yori shell base64 encode or decode
  *
- * Copyright (c) 2023 Malcolm J. Smith
+ * Copyright (c) 2023-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -54,318 +54,251 @@ Base64Help(VOID)
 }
 
 /**
- A buffer for a single data stream.
+ The number of bytes encoded on each line of output.  This generates lines of
+ 64 characters, which is the format used by CryptBinaryToString.
  */
-typedef struct _BASE64_BUFFER {
+#define BASE64_BYTES_PER_LINE (48)
+
+/**
+ The number of lines of output to generate from each block of input.
+ */
+#define BASE64_LINES_PER_BLOCK (1024)
+
+/**
+ The number of bytes of input to encode at a time.
+ */
+#define BASE64_ENCODE_BLOCK_SIZE (BASE64_BYTES_PER_LINE * BASE64_LINES_PER_BLOCK)
+
+/**
+ The number of characters of output generated from each block of input,
+ including a carriage return and line feed after each line.
+ */
+#define BASE64_ENCODE_OUTPUT_SIZE (BASE64_LINES_PER_BLOCK * (YORI_LIB_BASE64_ENCODED_LENGTH(BASE64_BYTES_PER_LINE) + 2))
+
+/**
+ The number of characters of input to decode at a time.
+ */
+#define BASE64_DECODE_BLOCK_SIZE (64 * 1024)
+
+/**
+ The number of bytes of output generated from each block of input.
+ */
+#define BASE64_DECODE_OUTPUT_SIZE (YORI_LIB_BASE64_DECODED_LENGTH(BASE64_DECODE_BLOCK_SIZE))
+
+/**
+ Context describing an encode or decode operation.
+ */
+typedef struct _BASE64_CONTEXT {
 
     /**
-     A handle to a pipe which is the source of data for this buffer.
+     A handle to a file or pipe which is the source of data.
      */
     HANDLE hSource;
 
     /**
-     The data buffer.
+     A handle to the device to write results to.
      */
-    YORI_LIB_BYTE_BUFFER ByteBuffer;
+    HANDLE hTarget;
 
-} BASE64_BUFFER, *PBASE64_BUFFER;
+    /**
+     A buffer to hold each block of input.
+     */
+    PUCHAR InputBuffer;
+
+    /**
+     A buffer to hold the result of processing each block of input.
+     */
+    PUCHAR OutputBuffer;
+
+} BASE64_CONTEXT, *PBASE64_CONTEXT;
 
 /**
- Populate data from stdin into an in memory buffer.
+ Read a block of data from the source.  Reads from pipes can complete with
+ less data than requested, so this continues reading until the block is
+ full or the end of the data is reached.
 
- @param ThisBuffer A pointer to the process buffer set.
+ @param Base64Context Pointer to the context describing the operation.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @param Length The number of bytes to read.
+
+ @return The number of bytes read, which is less than Length only if the
+         end of the data has been reached.
  */
-BOOL
-Base64BufferPump(
-    __in PBASE64_BUFFER ThisBuffer
+DWORD
+Base64ReadBlock(
+    __in PBASE64_CONTEXT Base64Context,
+    __in DWORD Length
     )
 {
     DWORD BytesRead;
-    BOOL Result = FALSE;
-    PUCHAR WriteBuffer;
-    YORI_ALLOC_SIZE_T BytesAvailable;
-
-    while (TRUE) {
+    DWORD TotalRead;
+
+    TotalRead = 0;
+    while (TotalRead < Length) {
+        if (!ReadFile(Base64Context->hSource,
+                      YoriLibAddToPointer(Base64Context->InputBuffer, TotalRead),
+                      Length - TotalRead,
+                      &BytesRead,
+                      NULL)) {
 
-        WriteBuffer = YoriLibByteBufferGetPointerToEnd(&ThisBuffer->ByteBuffer, 16384, &BytesAvailable);
-        if (WriteBuffer == NULL) {
             break;
         }
 
-        if (ReadFile(ThisBuffer->hSource,
-                     WriteBuffer,
-                     BytesAvailable,
-                     &BytesRead,
-                     NULL)) {
-
-            if (BytesRead == 0) {
-                Result = TRUE;
-                break;
-            }
-
-            YoriLibByteBufferAddToPopulatedLength(&ThisBuffer->ByteBuffer, BytesRead);
-
-        } else {
-            Result = TRUE;
+        if (BytesRead == 0) {
             break;
         }
+
+        TotalRead = TotalRead + BytesRead;
     }
 
-    return Result;
+    return TotalRead;
 }
 
 /**
- Allocate and initialize a buffer for an input stream.
+ Write a block of results to the target.
+
+ @param Base64Context Pointer to the context describing the operation.
 
- @param Buffer Pointer to the buffer to allocate structures for.
+ @param Length The number of bytes in the output buffer to write.
 
- @return TRUE if the buffer is successfully initialized, FALSE if it is not.
+ @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-Base64AllocateBuffer(
-    __out PBASE64_BUFFER Buffer
+Base64WriteBlock(
+    __in PBASE64_CONTEXT Base64Context,
+    __in DWORD Length
     )
 {
-    return YoriLibByteBufferInitialize(&Buffer->ByteBuffer, 1024);
-}
+    DWORD BytesSent;
+    DWORD BytesWritten;
+    DWORD Err;
+    LPTSTR ErrText;
 
-/**
- Free structures associated with a single input stream.
+    BytesSent = 0;
+    while (BytesSent < Length) {
+        if (!WriteFile(Base64Context->hTarget,
+                       YoriLibAddToPointer(Base64Context->OutputBuffer, BytesSent),
+                       Length - BytesSent,
+                       &BytesWritten,
+                       NULL)) {
 
- @param ThisBuffer Pointer to the single stream's buffers to deallocate.
- */
-VOID
-Base64FreeBuffer(
-    __in PBASE64_BUFFER ThisBuffer
-    )
-{
-    YoriLibByteBufferCleanup(&ThisBuffer->ByteBuffer);
+            Err = GetLastError();
+            ErrText = YoriLibGetWinErrorText(Err);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to write to output: %s"), ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            return FALSE;
+        }
+
+        BytesSent = BytesSent + BytesWritten;
+    }
+
+    return TRUE;
 }
 
 /**
- Perform base64 encode and output to the requested device.
+ Perform base64 encode and output to the requested device.  The source is
+ processed one block at a time, so memory usage does not depend on the size
+ of the source.
 
- @param ThisBuffer Pointer to the buffer to output.
+ @param Base64Context Pointer to the context describing the operation.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 Base64Encode(
-    __inout PBASE64_BUFFER ThisBuffer
+    __in PBASE64_CONTEXT Base64Context
     )
 {
-    DWORD CharsRequired;
-    YORI_STRING Buffer;
-    DWORD Err;
-    LPTSTR ErrText;
-    PUCHAR SourceBuffer;
-    YORI_ALLOC_SIZE_T BytesPopulated;
-
-    //
-    //  Calculate the buffer size needed
-    //
+    DWORD BytesRead;
+    DWORD BytesEncoded;
+    DWORD LineLength;
+    DWORD OutputLength;
 
-    SourceBuffer = YoriLibByteBufferGetPointerToValidData(&ThisBuffer->ByteBuffer, 0, &BytesPopulated);
-    if (!DllCrypt32.pCryptBinaryToStringW(SourceBuffer, BytesPopulated, CRYPT_STRING_BASE64, NULL, &CharsRequired)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to calculate buffer length in CryptBinaryToString: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        return FALSE;
-    }
+    while (TRUE) {
 
-    //
-    //  Check if the buffer size would overflow, and fail if so
-    //
+        BytesRead = Base64ReadBlock(Base64Context, BASE64_ENCODE_BLOCK_SIZE);
+        if (BytesRead == 0) {
+            break;
+        }
 
-    if (!YoriLibIsSizeAllocatable(CharsRequired)) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: supplied data too large\n"));
-        return FALSE;
-    }
+        OutputLength = 0;
+        for (BytesEncoded = 0; BytesEncoded < BytesRead; BytesEncoded = BytesEncoded + LineLength) {
+            LineLength = BASE64_BYTES_PER_LINE;
+            if (BytesEncoded + LineLength > BytesRead) {
+                LineLength = BytesRead - BytesEncoded;
+            }
 
-    //
-    //  Allocate buffer
-    //
+            OutputLength = OutputLength + YoriLibBase64Encode(&Base64Context->InputBuffer[BytesEncoded], (YORI_ALLOC_SIZE_T)LineLength, &Base64Context->OutputBuffer[OutputLength]);
+            Base64Context->OutputBuffer[OutputLength] = '\r';
+            Base64Context->OutputBuffer[OutputLength + 1] = '\n';
+            OutputLength = OutputLength + 2;
+        }
 
-    if (!YoriLibAllocateString(&Buffer, (YORI_ALLOC_SIZE_T)CharsRequired)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocation failure: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        return FALSE;
-    }
+        ASSERT(OutputLength <= BASE64_ENCODE_OUTPUT_SIZE);
 
-    //
-    //  Perform the encode
-    //
+        if (!Base64WriteBlock(Base64Context, OutputLength)) {
+            return FALSE;
+        }
 
-    if (!DllCrypt32.pCryptBinaryToStringW(SourceBuffer, BytesPopulated, CRYPT_STRING_BASE64, Buffer.StartOfString, &CharsRequired)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to encode in CryptBinaryToString: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&Buffer);
-        return FALSE;
+        if (BytesRead < BASE64_ENCODE_BLOCK_SIZE || YoriLibIsOperationCancelled()) {
+            break;
+        }
     }
 
-    Buffer.LengthInChars = (YORI_ALLOC_SIZE_T)CharsRequired;
-
-    //
-    //  Free the source buffer.  We're done with it by this point, and
-    //  output may need to double buffer for encoding.
-    //
-
-    Base64FreeBuffer(ThisBuffer);
-
-    //
-    //  Output the encoded form.
-    //
-
-    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &Buffer);
-    YoriLibFreeStringContents(&Buffer);
-
     return TRUE;
 }
 
 /**
- Perform base64 decode and output to the requested device.
+ Perform base64 decode and output to the requested device.  The source is
+ processed one block at a time, so memory usage does not depend on the size
+ of the source.
 
- @param ThisBuffer Pointer to the buffer to output.
+ @param Base64Context Pointer to the context describing the operation.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 Base64Decode(
-    __inout PBASE64_BUFFER ThisBuffer
+    __in PBASE64_CONTEXT Base64Context
     )
 {
-    YORI_ALLOC_SIZE_T CharsRequired;
-    DWORD BytesRequired;
-    YORI_STRING Buffer;
-    PUCHAR BinaryBuffer;
-    DWORD Skip;
-    DWORD Flags;
-    DWORD BytesSent;
-    BOOL Result;
-    HANDLE hTarget;
-    DWORD Err;
-    LPTSTR ErrText;
-    PUCHAR SourceBuffer;
-    YORI_ALLOC_SIZE_T BytesPopulated;
+    YORI_LIB_BASE64_DECODE_STATE DecodeState;
+    YORI_ALLOC_SIZE_T BytesDecoded;
+    DWORD BytesRead;
 
-    //
-    //  Convert the input buffer into a UTF16 string.
-    //
+    YoriLibBase64DecodeInitialize(&DecodeState);
 
-    SourceBuffer = YoriLibByteBufferGetPointerToValidData(&ThisBuffer->ByteBuffer, 0, &BytesPopulated);
-    if (SourceBuffer == NULL) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocation failure\n"));
-        return FALSE;
-    }
-    CharsRequired = YoriLibGetMultibyteInputSizeNeeded(SourceBuffer, BytesPopulated);
-    if (!YoriLibAllocateString(&Buffer, CharsRequired + 1)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocation failure: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        return FALSE;
-    }
-
-    YoriLibMultibyteInput(SourceBuffer, BytesPopulated, Buffer.StartOfString, CharsRequired);
-    Buffer.LengthInChars = CharsRequired;
-    Buffer.StartOfString[CharsRequired] = '\0';
+    while (TRUE) {
 
-    //
-    //  Free the source buffer.  We're done with it by this point, and
-    //  output may need to double buffer for encoding.
-    //
+        BytesRead = Base64ReadBlock(Base64Context, BASE64_DECODE_BLOCK_SIZE);
+        if (BytesRead == 0) {
+            break;
+        }
 
-    Base64FreeBuffer(ThisBuffer);
+        if (!YoriLibBase64Decode(&DecodeState, Base64Context->InputBuffer, (YORI_ALLOC_SIZE_T)BytesRead, Base64Context->OutputBuffer, &BytesDecoded)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: input is not valid base64\n"));
+            return FALSE;
+        }
 
-    //
-    //  Calculate the buffer size needed
-    //
+        if (!Base64WriteBlock(Base64Context, BytesDecoded)) {
+            return FALSE;
+        }
 
-    if (!DllCrypt32.pCryptStringToBinaryW(Buffer.StartOfString, Buffer.LengthInChars, CRYPT_STRING_BASE64, NULL, &BytesRequired, NULL, NULL)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to calculate buffer length in CryptStringToBinary: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&Buffer);
-        return FALSE;
+        if (BytesRead < BASE64_DECODE_BLOCK_SIZE || YoriLibIsOperationCancelled()) {
+            break;
+        }
     }
 
-    //
-    //  Allocate binary buffer
-    //
-
-    BinaryBuffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesRequired);
-    if (BinaryBuffer == NULL) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocation failure: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&Buffer);
+    if (!YoriLibBase64DecodeFinalize(&DecodeState, Base64Context->OutputBuffer, &BytesDecoded)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: input is truncated\n"));
         return FALSE;
     }
 
-    //
-    //  Perform the decode
-    //
-
-    if (!DllCrypt32.pCryptStringToBinaryW(Buffer.StartOfString, Buffer.LengthInChars, CRYPT_STRING_BASE64, BinaryBuffer, &BytesRequired, &Skip, &Flags)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to encode in CryptBinaryToString: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&Buffer);
-        YoriLibFree(BinaryBuffer);
+    if (BytesDecoded > 0 && !Base64WriteBlock(Base64Context, BytesDecoded)) {
         return FALSE;
     }
 
-    //
-    //  We're done with the string form of the source, deallocate it.
-    //
-
-    YoriLibFreeStringContents(&Buffer);
-
-    //
-    //  Output the decoded form.
-    //
-    BytesSent = 0;
-    Result = TRUE;
-    hTarget = GetStdHandle(STD_OUTPUT_HANDLE);
-
-    while (BytesSent < BytesRequired) {
-        DWORD BytesToWrite;
-        DWORD BytesWritten;
-        BytesToWrite = 4096;
-        if (BytesSent + BytesToWrite > BytesRequired) {
-            BytesToWrite = BytesRequired - BytesSent;
-        }
-
-        if (WriteFile(hTarget,
-                      YoriLibAddToPointer(BinaryBuffer, BytesSent),
-                      BytesToWrite,
-                      &BytesWritten,
-                      NULL)) {
-
-            BytesSent += BytesWritten;
-        } else {
-            Err = GetLastError();
-            ErrText = YoriLibGetWinErrorText(Err);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to write to output: %s"), ErrText);
-            YoriLibFreeWinErrorText(ErrText);
-            Result = FALSE;
-        }
-
-        ASSERT(BytesSent <= BytesRequired);
-    }
-    YoriLibFree(BinaryBuffer);
-
-    return Result;
+    return TRUE;
 }
 
 #ifdef YORI_BUILTIN
@@ -401,12 +334,13 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T StartArg = 0;
     YORI_STRING Arg;
     BOOLEAN Decode = FALSE;
-    BASE64_BUFFER Base64Buffer;
+    BASE64_CONTEXT Base64Context;
     YORI_STRING FullFilePath;
+    BOOL Result;
     DWORD Err;
     LPTSTR ErrText;
 
-    ZeroMemory(&Base64Buffer, sizeof(Base64Buffer));
+    ZeroMemory(&Base64Context, sizeof(Base64Context));
     YoriLibInitEmptyString(&FullFilePath);
 
     for (i = 1; i < ArgC; i++) {
@@ -420,7 +354,7 @@ ENTRYPOINT(
                 Base64Help();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2023"));
+                YoriLibDisplayMitLicense(_T("2023-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("d")) == 0) {
                 Decode = TRUE;
@@ -441,14 +375,6 @@ ENTRYPOINT(
         }
     }
 
-    YoriLibLoadCrypt32Functions();
-    if (DllCrypt32.pCryptBinaryToStringW == NULL ||
-        DllCrypt32.pCryptStringToBinaryW == NULL) {
-
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: operating system support not present\n"));
-        return EXIT_FAILURE;
-    }
-
 #if YORI_BUILTIN
     YoriLibCancelEnable(FALSE);
 #endif
@@ -459,7 +385,7 @@ ENTRYPOINT(
     //
 
     YoriLibInitEmptyString(&FullFilePath);
-    Base64Buffer.hSource = GetStdHandle(STD_INPUT_HANDLE);
+    Base64Context.hSource = GetStdHandle(STD_INPUT_HANDLE);
     if (StartArg == 0 || StartArg == ArgC) {
         if (YoriLibIsStdInConsole()) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: no file or pipe for input\n"));
@@ -474,8 +400,8 @@ ENTRYPOINT(
             return EXIT_FAILURE;
         }
 
-        Base64Buffer.hSource = CreateFile(FullFilePath.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-        if (Base64Buffer.hSource == INVALID_HANDLE_VALUE) {
+        Base64Context.hSource = CreateFile(FullFilePath.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (Base64Context.hSource == INVALID_HANDLE_VALUE) {
             Err = GetLastError();
             ErrText = YoriLibGetWinErrorText(Err);
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: opening file failed: %s"), ErrText);
@@ -485,52 +411,38 @@ ENTRYPOINT(
         }
     }
 
-    if (!Base64AllocateBuffer(&Base64Buffer)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocating buffer failed: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        if (FullFilePath.LengthInChars > 0) {
-            CloseHandle(Base64Buffer.hSource);
-        }
-        YoriLibFreeStringContents(&FullFilePath);
-        return EXIT_FAILURE;
-    }
+    //
+    //  Allocate a single buffer large enough for either operation's input
+    //  and output.
+    //
 
-    if (!Base64BufferPump(&Base64Buffer)) {
+    Base64Context.InputBuffer = YoriLibMalloc(BASE64_DECODE_BLOCK_SIZE + BASE64_DECODE_OUTPUT_SIZE + BASE64_ENCODE_OUTPUT_SIZE);
+    if (Base64Context.InputBuffer == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocation failure\n"));
         if (FullFilePath.LengthInChars > 0) {
-            CloseHandle(Base64Buffer.hSource);
+            CloseHandle(Base64Context.hSource);
         }
         YoriLibFreeStringContents(&FullFilePath);
-        Base64FreeBuffer(&Base64Buffer);
         return EXIT_FAILURE;
     }
+    Base64Context.OutputBuffer = Base64Context.InputBuffer + BASE64_DECODE_BLOCK_SIZE;
+    Base64Context.hTarget = GetStdHandle(STD_OUTPUT_HANDLE);
 
-    if (!Decode) {
-        if (!Base64Encode(&Base64Buffer)) {
-            if (FullFilePath.LengthInChars > 0) {
-                CloseHandle(Base64Buffer.hSource);
-            }
-            YoriLibFreeStringContents(&FullFilePath);
-            Base64FreeBuffer(&Base64Buffer);
-            return EXIT_FAILURE;
-        }
+    if (Decode) {
+        Result = Base64Decode(&Base64Context);
     } else {
-        if (!Base64Decode(&Base64Buffer)) {
-            if (FullFilePath.LengthInChars > 0) {
-                CloseHandle(Base64Buffer.hSource);
-            }
-            YoriLibFreeStringContents(&FullFilePath);
-            Base64FreeBuffer(&Base64Buffer);
-            return EXIT_FAILURE;
-        }
+        Result = Base64Encode(&Base64Context);
     }
 
     if (FullFilePath.LengthInChars > 0) {
-        CloseHandle(Base64Buffer.hSource);
+        CloseHandle(Base64Context.hSource);
     }
     YoriLibFreeStringContents(&FullFilePath);
-    Base64FreeBuffer(&Base64Buffer);
+    YoriLibFree(Base64Context.InputBuffer);
+
+    if (!Result) {
+        return EXIT_FAILURE;
+    }
 
     return EXIT_SUCCESS;
 }
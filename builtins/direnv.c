@@ -3,7 +3,7 @@
  *
  * Yori execute scripts based on current directory to update environment
  *
- * Copyright (c) 2019 Malcolm J. Smith
+ * Copyright (c) 2019-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -95,6 +95,22 @@ YORI_STRING DirenvPreviousExecutedScript;
  */
 YORI_STRING DirenvPreviousCurrentDirectory;
 
+/**
+ The script found when probing from the previous current directory, or an
+ empty string if no script was found.  This may differ from
+ DirenvPreviousExecutedScript if the script was not allowed to execute.
+ When the current directory moves to a child of the previous current
+ directory, only the new components need to be probed, and if none contain
+ a script, this is the result.
+ */
+YORI_STRING DirenvPreviousFoundScript;
+
+/**
+ Set to TRUE once DirenvPreviousFoundScript describes the result of probing
+ from DirenvPreviousCurrentDirectory.
+ */
+BOOLEAN DirenvPreviousFoundScriptValid;
+
 /**
  Set to TRUE to indicate that direnv has been linked into the shell, thereby
  exposing the DIRENVAPPLY command.
@@ -117,6 +133,8 @@ DirenvNotifyUnload(VOID)
 {
     YoriLibFreeStringContents(&DirenvPreviousExecutedScript);
     YoriLibFreeStringContents(&DirenvPreviousCurrentDirectory);
+    YoriLibFreeStringContents(&DirenvPreviousFoundScript);
+    DirenvPreviousFoundScriptValid = FALSE;
 }
 
 /**
@@ -422,6 +440,8 @@ DirenvApplyInternal(VOID)
     YORI_STRING NewScript;
     YORI_STRING CurrentDirectorySubset;
     YORI_STRING EnvName;
+    YORI_ALLOC_SIZE_T ProbeStopLength;
+    BOOLEAN ScriptFound;
 
     //
     //  In the vast majority of cases, this module is already installed.
@@ -470,33 +490,92 @@ DirenvApplyInternal(VOID)
     }
 
     //
-    //  Keep moving up directories from the current directory.  Once a
-    //  envrc.ys1 file is found, execute it.
+    //  If the new directory is a child of the previous directory, the
+    //  previous directory and its parents have already been probed, so
+    //  only probe the components that have been added.  This keeps
+    //  descending through a deep tree, particularly on a network drive,
+    //  from probing every parent on every change.
+    //
+
+    ProbeStopLength = 0;
+    if (DirenvPreviousFoundScriptValid &&
+        DirenvPreviousCurrentDirectory.LengthInChars > 0 &&
+        CurrentDirectory.LengthInChars > DirenvPreviousCurrentDirectory.LengthInChars &&
+        YoriLibIsSep(CurrentDirectory.StartOfString[DirenvPreviousCurrentDirectory.LengthInChars]) &&
+        !YoriLibIsSep(DirenvPreviousCurrentDirectory.StartOfString[DirenvPreviousCurrentDirectory.LengthInChars - 1]) &&
+        YoriLibCompareStringInsCnt(&CurrentDirectory, &DirenvPreviousCurrentDirectory, DirenvPreviousCurrentDirectory.LengthInChars) == 0) {
+
+        ProbeStopLength = DirenvPreviousCurrentDirectory.LengthInChars;
+    }
+
+    //
+    //  Keep moving up directories from the current directory until an
+    //  envrc.ys1 file is found.
     //
 
     YoriLibInitEmptyString(&CurrentDirectorySubset);
     CurrentDirectorySubset.StartOfString = CurrentDirectory.StartOfString;
     CurrentDirectorySubset.LengthInChars = CurrentDirectory.LengthInChars;
+    ScriptFound = FALSE;
 
     while (TRUE) {
+        if (ProbeStopLength > 0 && CurrentDirectorySubset.LengthInChars == ProbeStopLength) {
+            if (DirenvPreviousFoundScript.LengthInChars > 0) {
+                memcpy(NewScript.StartOfString, DirenvPreviousFoundScript.StartOfString, DirenvPreviousFoundScript.LengthInChars * sizeof(TCHAR));
+                NewScript.LengthInChars = DirenvPreviousFoundScript.LengthInChars;
+                NewScript.StartOfString[NewScript.LengthInChars] = '\0';
+                CurrentDirectorySubset.LengthInChars = NewScript.LengthInChars - (sizeof("\\envrc.ys1") - 1);
+                ScriptFound = TRUE;
+            }
+            break;
+        }
+
         NewScript.LengthInChars = YoriLibSPrintf(NewScript.StartOfString, _T("%y\\envrc.ys1"), &CurrentDirectorySubset);
 
         if (GetFileAttributes(NewScript.StartOfString) != (DWORD)-1) {
+            ScriptFound = TRUE;
+            break;
+        }
 
-            //
-            //  If the script we found is the same one that's active, do
-            //  nothing.
-            //
-
-            if (YoriLibCompareStringIns(&NewScript, &DirenvPreviousExecutedScript) == 0) {
-                YoriLibFreeStringContents(&NewScript);
+        while (CurrentDirectorySubset.LengthInChars > 0) {
+            CurrentDirectorySubset.LengthInChars--;
+            if (YoriLibIsSep(CurrentDirectorySubset.StartOfString[CurrentDirectorySubset.LengthInChars])) {
                 break;
             }
+        }
 
-            if (!DirenvScriptAllowedInDirectory(&CurrentDirectorySubset)) {
-                YoriLibFreeStringContents(&NewScript);
-                break;
-            }
+        if (CurrentDirectorySubset.LengthInChars == 0) {
+            break;
+        }
+    }
+
+    //
+    //  Remember the result so that a subsequent move into a child can
+    //  reuse it.  If this cannot be recorded, the next change will probe
+    //  every parent.
+    //
+
+    YoriLibFreeStringContents(&DirenvPreviousFoundScript);
+    DirenvPreviousFoundScriptValid = TRUE;
+    if (ScriptFound) {
+        if (!YoriLibCopyString(&DirenvPreviousFoundScript, &NewScript)) {
+            DirenvPreviousFoundScriptValid = FALSE;
+        }
+    }
+
+    if (ScriptFound) {
+
+        //
+        //  If the script we found is the same one that's active, or the
+        //  script is not allowed to run, do nothing.  Otherwise undo the
+        //  previous script and execute the new one.
+        //
+
+        if (YoriLibCompareStringIns(&NewScript, &DirenvPreviousExecutedScript) == 0 ||
+            !DirenvScriptAllowedInDirectory(&CurrentDirectorySubset)) {
+
+            YoriLibFreeStringContents(&NewScript);
+        } else {
 
             if (DirenvPreviousExecutedScript.LengthInChars > 0) {
                 DirenvUndoPreviousScript();
@@ -517,28 +596,18 @@ DirenvApplyInternal(VOID)
             DirenvApplyInvoked = TRUE;
             YoriCallExecuteExpression(&DirenvPreviousExecutedScript);
             DirenvApplyInvoked = FALSE;
-            break;
-        }
-
-        while (CurrentDirectorySubset.LengthInChars > 0) {
-            CurrentDirectorySubset.LengthInChars--;
-            if (YoriLibIsSep(CurrentDirectorySubset.StartOfString[CurrentDirectorySubset.LengthInChars])) {
-                break;
-            }
         }
+    } else {
 
         //
         //  No active script is found.  See if we need to undo the effects of
         //  a previous script.
         //
 
-        if (CurrentDirectorySubset.LengthInChars == 0) {
-            if (DirenvPreviousExecutedScript.LengthInChars > 0) {
-                DirenvUndoPreviousScript();
-            }
-            YoriLibFreeStringContents(&NewScript);
-            break;
+        if (DirenvPreviousExecutedScript.LengthInChars > 0) {
+            DirenvUndoPreviousScript();
         }
+        YoriLibFreeStringContents(&NewScript);
     }
 
     YoriLibFreeStringContents(&DirenvPreviousCurrentDirectory);
@@ -578,7 +647,7 @@ YoriCmd_DIRENVAPPLY(
                 DirenvApplyHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2019"));
+                YoriLibDisplayMitLicense(_T("2019-2026"));
                 return EXIT_SUCCESS;
             }
         }
@@ -648,7 +717,7 @@ YoriCmd_DIRENV(
                 DirenvHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2019"));
+                YoriLibDisplayMitLicense(_T("2019-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("a")) == 0) {
                 ArgumentUnderstood = TRUE;
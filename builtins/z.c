@@ -3,7 +3,7 @@
  *
  * Yori shell change directory based on a heuristic match
  *
- * Copyright (c) 2017-2018 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -36,7 +36,13 @@ CHAR strZHelpText[] =
         "\n"
         "Changes the current directory based on a heuristic match.\n"
         "\n"
-        "Z [-license] <directory>\n";
+        "Z [-license] [-l] [-u] <directory>\n"
+        "\n"
+        "   -l             List the recent directories and their hit counts\n"
+        "   -u             Unload the recent directory list from memory\n"
+        "\n"
+        "If YORIZFILE is set, recent directories are saved to that file and are\n"
+        "shared by every shell using it.\n";
 
 /**
  Display usage text to the user.
@@ -101,6 +107,13 @@ typedef struct _Z_RECENT_DIRECTORIES {
      */
     DWORD MonotonicAddAttempt;
 
+    /**
+     The last write time of the file specified by YORIZFILE when its
+     contents were last loaded into or saved from the list.  This allows
+     the file to be reloaded only when another shell has updated it.
+     */
+    FILETIME StoreWriteTime;
+
 } Z_RECENT_DIRECTORIES, *PZ_RECENT_DIRECTORIES;
 
 /**
@@ -156,6 +169,80 @@ ZListStack(VOID)
     return TRUE;
 }
 
+/**
+ Allocate a new entry for a recent directory and insert it into the list.
+ The caller is responsible for ensuring the list has space for the entry.
+
+ @param DirectoryName Pointer to the fully qualified directory name to add.
+
+ @param HitCount The number of times the directory has been encountered.
+
+ @param InsertAtTail If TRUE, the entry is inserted as the least recently
+        used entry.  If FALSE, it is inserted as the most recently used entry.
+
+ @return TRUE if the entry was successfully added, FALSE if it was not.
+ */
+BOOL
+ZInsertRecentDirectory(
+    __in PYORI_STRING DirectoryName,
+    __in DWORD HitCount,
+    __in BOOLEAN InsertAtTail
+    )
+{
+    PZ_RECENT_DIRECTORY NewRecentDir;
+
+    NewRecentDir = YoriLibReferencedMalloc(sizeof(Z_RECENT_DIRECTORY) + (DirectoryName->LengthInChars + 1) * sizeof(TCHAR));
+    if (NewRecentDir == NULL) {
+        return FALSE;
+    }
+
+    YoriLibReference(NewRecentDir);
+    NewRecentDir->DirectoryName.MemoryToFree = NewRecentDir;
+    NewRecentDir->DirectoryName.StartOfString = (LPWSTR)(NewRecentDir + 1);
+    NewRecentDir->DirectoryName.LengthAllocated = DirectoryName->LengthInChars + 1;
+    NewRecentDir->DirectoryName.LengthInChars = DirectoryName->LengthInChars;
+
+    memcpy(NewRecentDir->DirectoryName.StartOfString, DirectoryName->StartOfString, DirectoryName->LengthInChars * sizeof(TCHAR));
+    NewRecentDir->DirectoryName.StartOfString[DirectoryName->LengthInChars] = '\0';
+
+    NewRecentDir->HitCount = HitCount;
+
+    if (InsertAtTail) {
+        YoriLibAppendList(&ZRecentDirectories.RecentDirList, &NewRecentDir->ListEntry);
+    } else {
+        YoriLibInsertList(&ZRecentDirectories.RecentDirList, &NewRecentDir->ListEntry);
+    }
+    ZRecentDirectories.RecentDirCount++;
+
+    ASSERT(ZRecentDirectories.RecentDirCount <= Z_MAX_RECENT_DIRS);
+
+    return TRUE;
+}
+
+/**
+ Free all entries in the list of recent directories.
+ */
+VOID
+ZFreeRecentDirectories(VOID)
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PZ_RECENT_DIRECTORY FoundRecentDir;
+
+    if (ZRecentDirectories.RecentDirList.Next == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
+    while (ListEntry != NULL) {
+        FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
+        YoriLibRemoveListItem(&FoundRecentDir->ListEntry);
+        YoriLibFreeStringContents(&FoundRecentDir->DirectoryName);
+        YoriLibDereference(FoundRecentDir);
+    }
+    ZRecentDirectories.RecentDirCount = 0;
+}
+
 /**
  Check the recent directories for a match to DirectoryName.  If a match is
  found, promote it to be the most recent entry and update its HitCount.
@@ -233,47 +320,238 @@ ZAddDirectoryToRecent(
     //  Attempt to insert a new entry corresponding to this directory.
     //
 
-    FoundRecentDir = YoriLibReferencedMalloc(sizeof(Z_RECENT_DIRECTORY) + (DirectoryName->LengthInChars + 1) * sizeof(TCHAR));
-    if (FoundRecentDir == NULL) {
+    return ZInsertRecentDirectory(DirectoryName, 1, FALSE);
+}
+
+/**
+ Return the fully qualified path to the file used to share recent
+ directories between shells, as specified by the YORIZFILE environment
+ variable.
+
+ @param FilePath On successful completion, populated with a newly allocated
+        string containing the path to the file.
+
+ @return TRUE if a file has been specified, FALSE if it has not or it could
+         not be resolved.
+ */
+__success(return)
+BOOL
+ZGetStoreFileName(
+    __out PYORI_STRING FilePath
+    )
+{
+    YORI_STRING EnvVar;
+
+    YoriLibInitEmptyString(&EnvVar);
+    if (!YoriLibAllocateAndGetEnvVar(_T("YORIZFILE"), &EnvVar)) {
         return FALSE;
     }
 
-    YoriLibReference(FoundRecentDir);
-    FoundRecentDir->DirectoryName.MemoryToFree = FoundRecentDir;
-    FoundRecentDir->DirectoryName.StartOfString = (LPWSTR)(FoundRecentDir + 1);
-    FoundRecentDir->DirectoryName.LengthAllocated = DirectoryName->LengthInChars + 1;
-    FoundRecentDir->DirectoryName.LengthInChars = DirectoryName->LengthInChars;
+    if (EnvVar.LengthInChars == 0) {
+        YoriLibFreeStringContents(&EnvVar);
+        return FALSE;
+    }
 
-    memcpy(FoundRecentDir->DirectoryName.StartOfString, DirectoryName->StartOfString, (DirectoryName->LengthInChars + 1) * sizeof(TCHAR));
+    YoriLibInitEmptyString(FilePath);
+    if (!YoriLibUserStringToSingleFilePath(&EnvVar, TRUE, FilePath)) {
+        YoriLibFreeStringContents(&EnvVar);
+        return FALSE;
+    }
 
-    FoundRecentDir->HitCount = 1;
+    YoriLibFreeStringContents(&EnvVar);
+    return TRUE;
+}
 
-    YoriLibInsertList(&ZRecentDirectories.RecentDirList, &FoundRecentDir->ListEntry);
-    ZRecentDirectories.RecentDirCount++;
+/**
+ Query the last write time of the file used to share recent directories
+ and remember it, so that the file is only reloaded if it is subsequently
+ updated by another shell.
 
-    ASSERT(ZRecentDirectories.RecentDirCount <= Z_MAX_RECENT_DIRS);
+ @param FilePath Pointer to the path to the file.
+ */
+VOID
+ZRecordStoreWriteTime(
+    __in PYORI_STRING FilePath
+    )
+{
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    HANDLE FileHandle;
+
+    FileHandle = CreateFile(FilePath->StartOfString,
+                            FILE_READ_ATTRIBUTES,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return;
+    }
 
-    return TRUE;
+    if (GetFileInformationByHandle(FileHandle, &FileInfo)) {
+        ZRecentDirectories.StoreWriteTime = FileInfo.ftLastWriteTime;
+    }
+
+    CloseHandle(FileHandle);
 }
 
 /**
- Called when the module is unloaded to clean up state.
+ If a file has been specified to share recent directories, and it has been
+ modified since this shell last loaded or saved it, replace the in memory
+ list with the contents of the file.  Each line in the file consists of a
+ hit count, a tab, and a fully qualified directory name, in order of most
+ recently used to least recently used.  If the file cannot be loaded, the
+ in memory list is retained.
  */
 VOID
-YORI_BUILTIN_FN
-ZNotifyUnload(VOID)
+ZLoadRecentDirectories(VOID)
+{
+    YORI_STRING FilePath;
+    YORI_STRING LineString;
+    YORI_STRING DirectoryName;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    PVOID LineContext;
+    HANDLE FileHandle;
+    YORI_MAX_SIGNED_T HitCount;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+
+    if (!ZGetStoreFileName(&FilePath)) {
+        return;
+    }
+
+    FileHandle = CreateFile(FilePath.StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                            NULL);
+
+    YoriLibFreeStringContents(&FilePath);
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    if (!GetFileInformationByHandle(FileHandle, &FileInfo) ||
+        (FileInfo.ftLastWriteTime.dwHighDateTime == ZRecentDirectories.StoreWriteTime.dwHighDateTime &&
+         FileInfo.ftLastWriteTime.dwLowDateTime == ZRecentDirectories.StoreWriteTime.dwLowDateTime)) {
+
+        CloseHandle(FileHandle);
+        return;
+    }
+
+    ZFreeRecentDirectories();
+    if (ZRecentDirectories.RecentDirList.Next == NULL) {
+        YoriLibInitializeListHead(&ZRecentDirectories.RecentDirList);
+    }
+
+    LineContext = NULL;
+    YoriLibInitEmptyString(&LineString);
+    while (ZRecentDirectories.RecentDirCount < Z_MAX_RECENT_DIRS) {
+
+        if (!YoriLibReadLineToString(&LineString, &LineContext, FileHandle)) {
+            break;
+        }
+
+        if (!YoriLibStringToNumber(&LineString, FALSE, &HitCount, &CharsConsumed) ||
+            CharsConsumed + 1 >= LineString.LengthInChars ||
+            LineString.StartOfString[CharsConsumed] != '\t') {
+
+            continue;
+        }
+
+        if (HitCount <= 0) {
+            HitCount = 1;
+        }
+
+        YoriLibInitEmptyString(&DirectoryName);
+        DirectoryName.StartOfString = &LineString.StartOfString[CharsConsumed + 1];
+        DirectoryName.LengthInChars = LineString.LengthInChars - CharsConsumed - 1;
+
+        if (!ZInsertRecentDirectory(&DirectoryName, (DWORD)HitCount, TRUE)) {
+            break;
+        }
+    }
+
+    ZRecentDirectories.StoreWriteTime = FileInfo.ftLastWriteTime;
+
+    YoriLibLineReadCloseOrCache(LineContext);
+    YoriLibFreeStringContents(&LineString);
+    CloseHandle(FileHandle);
+}
+
+/**
+ If a file has been specified to share recent directories, write the in
+ memory list to it.  The list is written to a temporary file which then
+ replaces the existing file, so another shell never observes a partially
+ written list.
+ */
+VOID
+ZSaveRecentDirectories(VOID)
 {
+    YORI_STRING FilePath;
+    YORI_STRING TempPath;
     PYORI_LIST_ENTRY ListEntry;
     PZ_RECENT_DIRECTORY FoundRecentDir;
+    HANDLE FileHandle;
+
+    if (ZRecentDirectories.RecentDirList.Next == NULL) {
+        return;
+    }
+
+    if (!ZGetStoreFileName(&FilePath)) {
+        return;
+    }
+
+    if (!YoriLibAllocateString(&TempPath, FilePath.LengthInChars + 32)) {
+        YoriLibFreeStringContents(&FilePath);
+        return;
+    }
+
+    TempPath.LengthInChars = YoriLibSPrintf(TempPath.StartOfString, _T("%y.%x.tmp"), &FilePath, GetCurrentProcessId());
+
+    FileHandle = CreateFile(TempPath.StartOfString,
+                            GENERIC_WRITE,
+                            0,
+                            NULL,
+                            CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        YoriLibFreeStringContents(&TempPath);
+        YoriLibFreeStringContents(&FilePath);
+        return;
+    }
 
     ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
     while (ListEntry != NULL) {
         FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
         ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
-        YoriLibRemoveListItem(&FoundRecentDir->ListEntry);
-        YoriLibFreeStringContents(&FoundRecentDir->DirectoryName);
-        YoriLibDereference(FoundRecentDir);
+        YoriLibOutputToDevice(FileHandle, 0, _T("%i\t%y\n"), FoundRecentDir->HitCount, &FoundRecentDir->DirectoryName);
     }
+
+    CloseHandle(FileHandle);
+
+    if (MoveFileEx(TempPath.StartOfString, FilePath.StartOfString, MOVEFILE_REPLACE_EXISTING)) {
+        ZRecordStoreWriteTime(&FilePath);
+    } else {
+        DeleteFile(TempPath.StartOfString);
+    }
+
+    YoriLibFreeStringContents(&TempPath);
+    YoriLibFreeStringContents(&FilePath);
+}
+
+/**
+ Called when the module is unloaded to clean up state.
+ */
+VOID
+YORI_BUILTIN_FN
+ZNotifyUnload(VOID)
+{
+    ZFreeRecentDirectories();
 }
 
 /**
@@ -638,7 +916,7 @@ YoriCmd_Z(
                 ZHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2017-2018"));
+                YoriLibDisplayMitLicense(_T("2017-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
                 ListStack = TRUE;
@@ -658,6 +936,8 @@ YoriCmd_Z(
         }
     }
 
+    ZLoadRecentDirectories();
+
     if (ListStack) {
         ZListStack();
         return EXIT_SUCCESS;
@@ -718,6 +998,7 @@ YoriCmd_Z(
 
     ZAddDirectoryToRecent(&OldCurrentDirectory);
     ZAddDirectoryToRecent(&BestMatch);
+    ZSaveRecentDirectories();
 
     Result = YoriCallSetCurrentDirectory(&BestMatch);
     if (!Result) {
@@ -3,7 +3,7 @@
  *
  * Yori shell compress and uncompress archives
  *
- * Copyright (c) 2018-2019 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -75,6 +75,11 @@ typedef struct _CAB_MATCH_ITEM {
      wildcards.
      */
     YORI_STRING MatchCriteria;
+
+    /**
+     The match criteria, compiled for matching against each file.
+     */
+    YORI_LIB_FILE_MATCH_EXPRESSION CompiledCriteria;
 } CAB_MATCH_ITEM, *PCAB_MATCH_ITEM;
 
 /**
@@ -152,6 +157,7 @@ CabCreateAddMatch(
     MatchItem->MatchCriteria.LengthAllocated = NewCriteria->LengthInChars + 1;
     memcpy(MatchItem->MatchCriteria.StartOfString, NewCriteria->StartOfString, MatchItem->MatchCriteria.LengthInChars * sizeof(TCHAR));
     MatchItem->MatchCriteria.StartOfString[MatchItem->MatchCriteria.LengthInChars] = '\0';
+    YoriLibCompileFileMatchExpression(&MatchItem->MatchCriteria, &MatchItem->CompiledCriteria);
     YoriLibAppendList(List, &MatchItem->MatchList);
     return TRUE;
 }
@@ -211,12 +217,12 @@ CabCreateShouldExclude(
     ListEntry = YoriLibGetNextListEntry(&CreateContext->ExcludeList, NULL);
     while (ListEntry != NULL) {
         MatchItem = CONTAINING_RECORD(ListEntry, CAB_MATCH_ITEM, MatchList);
-        if (YoriLibDoesFileMatchExpression(RelativePath, &MatchItem->MatchCriteria)) {
+        if (YoriLibDoesFileMatchCompiledExpression(RelativePath, &MatchItem->CompiledCriteria)) {
 
             ListEntry = YoriLibGetNextListEntry(&CreateContext->IncludeList, NULL);
             while (ListEntry != NULL) {
                 MatchItem = CONTAINING_RECORD(ListEntry, CAB_MATCH_ITEM, MatchList);
-                if (YoriLibDoesFileMatchExpression(RelativePath, &MatchItem->MatchCriteria)) {
+                if (YoriLibDoesFileMatchCompiledExpression(RelativePath, &MatchItem->CompiledCriteria)) {
                     return FALSE;
                 }
                 ListEntry = YoriLibGetNextListEntry(&CreateContext->IncludeList, ListEntry);
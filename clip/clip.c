@@ -104,10 +104,11 @@ const CHAR ClipDummyFragEnd[] =
 #define HTMLCLIP_FRAGEND_SIZE (sizeof(ClipDummyFragEnd)-1)
 
 /**
- The maximum amount of data to buffer from a pipe before acting upon it.  The
- clipboard requires a full buffer of data to oeprate with.
+ The initial size of the buffer used to read from a pipe, whose length is not
+ known in advance.  The buffer doubles each time it fills, so this only
+ determines the number of reallocations needed for large input.
  */
-#define MAX_PIPE_SIZE (4*1024*1024)
+#define CLIP_PIPE_INITIAL_SIZE (1024*1024)
 
 //
 //  Older versions of the analysis engine don't understand that a buffer
@@ -124,149 +125,187 @@ const CHAR ClipDummyFragEnd[] =
 #endif
 
 /**
- Copy the contents of a file or pipe to the clipboard in HTML format.
+ Read the entire contents of a file or pipe into a global memory allocation
+ that can be handed directly to the clipboard.  Data is read into the
+ allocation in place, leaving space before it for a header and after it for
+ a trailer, so the caller does not need to copy it again.  A file is read
+ up to its known length.  Input from a pipe is read into an allocation that
+ is grown as needed, so there is no fixed limit on the amount of data from a
+ pipe.  Any failure is displayed to the user before returning.
 
  @param hFile Handle to the file or pipe.
 
  @param FileSize The length of the file, in bytes.  For a pipe, this value is
-        not known beforehand, and is specified as MAX_PIPE_SIZE.
+        not known beforehand, and is specified as zero.
+
+ @param HeaderSize The number of bytes to reserve before the data.
+
+ @param TrailerSize The number of bytes to reserve after the data.
+
+ @param HandleForClipboard On successful completion, updated to contain the
+        global memory allocation.  This allocation is unlocked.
+
+ @param DataLength On successful completion, updated to contain the number of
+        bytes read from the file or pipe.
 
  @return TRUE to indicate success or FALSE to indicate failure.
  */
+__success(return)
 BOOL
-ClipCopyAsHtml(
+ClipReadToGlobal(
     __in HANDLE hFile,
-    __in DWORD FileSize
+    __in DWORD FileSize,
+    __in YORI_ALLOC_SIZE_T HeaderSize,
+    __in YORI_ALLOC_SIZE_T TrailerSize,
+    __out PHANDLE HandleForClipboard,
+    __out PYORI_ALLOC_SIZE_T DataLength
     )
 {
-    YORI_ALLOC_SIZE_T AllocSize;
-    DWORD  DesiredSize;
+    YORI_MAX_UNSIGNED_T DesiredSize;
+    YORI_ALLOC_SIZE_T Capacity;
+    YORI_ALLOC_SIZE_T CurrentOffset;
+    DWORD  BytesTransferred;
     HANDLE hMem;
+    HANDLE hNewMem;
     PUCHAR pMem;
-    DWORD  BytesTransferred;
-    YORI_ALLOC_SIZE_T CurrentOffset;
-    UINT   ClipFmt;
-    DWORD  Err;
-    LPTSTR ErrText;
+    BOOLEAN SizeKnown;
 
-    //
-    //  Allocate space to copy the file or pipe contents.
-    //
+    SizeKnown = TRUE;
+    if (FileSize == 0) {
+        FileSize = CLIP_PIPE_INITIAL_SIZE;
+        SizeKnown = FALSE;
+    }
 
-    DesiredSize = FileSize + HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE + HTMLCLIP_FRAGEND_SIZE + 2;
+    DesiredSize = (YORI_MAX_UNSIGNED_T)FileSize + HeaderSize + TrailerSize;
     if (!YoriLibIsSizeAllocatable(DesiredSize)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: input too large for buffer\n"));
         return FALSE;
     }
-    AllocSize = (YORI_ALLOC_SIZE_T)DesiredSize;
-    hMem = GlobalAlloc(GMEM_MOVEABLE|GMEM_DDESHARE, AllocSize);
+    Capacity = (YORI_ALLOC_SIZE_T)FileSize;
+
+    hMem = GlobalAlloc(GMEM_MOVEABLE|GMEM_DDESHARE, (YORI_ALLOC_SIZE_T)DesiredSize);
     if (hMem == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: could not allocate memory for input\n"));
         return FALSE;
     }
 
     pMem = DllKernel32.pGlobalLock(hMem);
     if (pMem == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: could not lock memory for input\n"));
         GlobalFree(hMem);
         return FALSE;
     }
 
-    //
-    //  Note this is not Unicode.
-    //
-    //  First, prepare the header.  Leave a magic space at the end of the
-    //  header.
-    //
-
-    YoriLibSPrintfSA((PCHAR)pMem,
-                     AllocSize,
-                     "Version:0.9\n"
-                     "StartHTML:%08i\n"
-                     "EndHTML:%08i\n"
-                     "StartFragment:%08i\n"
-                     "EndFragment:%08i\n"
-                     "<!--StartFragment-->"
-                     " ",
-                     (int)HTMLCLIP_HDR_SIZE,
-                     (int)(HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE + HTMLCLIP_FRAGEND_SIZE + 1 + FileSize),
-                     (int)(HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE),
-                     (int)(HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE + 1 + FileSize));
-
     CurrentOffset = 0;
+    while (TRUE) {
 
-    //
-    //  Read text immediately following the header that we just prepared.
-    //
+        //
+        //  If the buffer is full and the input is a file, all of it has
+        //  been read.  Growing it here would temporarily need twice the
+        //  memory just to observe the end of the file.
+        //
 
-    while (ReadFile(hFile, pMem + HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE + 1 + CurrentOffset, FileSize - CurrentOffset, &BytesTransferred, NULL)) {
-        CurrentOffset = CurrentOffset + (YORI_ALLOC_SIZE_T)BytesTransferred;
+        if (CurrentOffset == Capacity && SizeKnown) {
+            break;
+        }
 
         //
-        //  If we're reading from the pipe and have exceeded our storage,
-        //  fail.
+        //  If the buffer is full, double it.  The memory must be unlocked
+        //  to allow it to move.
         //
 
-        if (CurrentOffset == FileSize &&
-            FileSize == MAX_PIPE_SIZE &&
-            hFile == GetStdHandle(STD_INPUT_HANDLE)) {
+        if (CurrentOffset == Capacity) {
+            DesiredSize = (YORI_MAX_UNSIGNED_T)Capacity * 2 + HeaderSize + TrailerSize;
+            if (!YoriLibIsSizeAllocatable(DesiredSize)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: input too large for buffer\n"));
+                DllKernel32.pGlobalUnlock(hMem);
+                GlobalFree(hMem);
+                return FALSE;
+            }
 
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Pipe data too large for buffer.  Limit is %i bytes\n"), MAX_PIPE_SIZE);
-            return FALSE;
+            DllKernel32.pGlobalUnlock(hMem);
+            hNewMem = GlobalReAlloc(hMem, (YORI_ALLOC_SIZE_T)DesiredSize, GMEM_MOVEABLE);
+            if (hNewMem == NULL) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: could not allocate memory for input\n"));
+                GlobalFree(hMem);
+                return FALSE;
+            }
+            hMem = hNewMem;
+            Capacity = Capacity * 2;
+
+            pMem = DllKernel32.pGlobalLock(hMem);
+            if (pMem == NULL) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: could not lock memory for input\n"));
+                GlobalFree(hMem);
+                return FALSE;
+            }
+        }
+
+        if (!ReadFile(hFile, pMem + HeaderSize + CurrentOffset, Capacity - CurrentOffset, &BytesTransferred, NULL)) {
+            break;
         }
 
         if (BytesTransferred == 0) {
             break;
         }
+
+        CurrentOffset = CurrentOffset + (YORI_ALLOC_SIZE_T)BytesTransferred;
     }
 
+    DllKernel32.pGlobalUnlock(hMem);
+
+    //
+    //  If there was no input, the user probably isn't sure how to use this
+    //  program, so help them along.
+    //
+
     if (CurrentOffset == 0) {
+        GlobalFree(hMem);
         ClipHelp();
         return FALSE;
     }
 
     //
-    //  If we don't have as much text as we expected, the header is wrong
-    //  and needs to be rewritten with correct values.
+    //  If the input was smaller than expected, give back the excess.  This
+    //  is only an optimization, so failure is not fatal.
     //
 
-    if (CurrentOffset < FileSize) {
-        FileSize = CurrentOffset;
-        YoriLibSPrintfA((PCHAR)pMem,
-                        "Version:0.9\n"
-                        "StartHTML:%08i\n"
-                        "EndHTML:%08i\n"
-                        "StartFragment:%08i\n"
-                        "EndFragment:%08i\n"
-                        "<!--StartFragment-->",
-                        (int)HTMLCLIP_HDR_SIZE,
-                        (int)(HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE + HTMLCLIP_FRAGEND_SIZE + 1 + FileSize),
-                        (int)(HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE),
-                        (int)(HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE + 1 + FileSize));
-
-        //
-        //  That magic space from above has now been set to NULL by printf.
-        //  Put the magic space back.
-        //
-
-        pMem[HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE] = ' ';
+    if (CurrentOffset < Capacity) {
+        hNewMem = GlobalReAlloc(hMem, HeaderSize + CurrentOffset + TrailerSize, GMEM_MOVEABLE);
+        if (hNewMem != NULL) {
+            hMem = hNewMem;
+        }
     }
 
-    //
-    //  Fill in the footer of the protocol.
-    //
+    *HandleForClipboard = hMem;
+    *DataLength = CurrentOffset;
+    return TRUE;
+}
 
-    YoriLibSPrintfA((PCHAR)(pMem + FileSize + HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE + 1),
-                    "%s",
-                    ClipDummyFragEnd);
+/**
+ Empty the clipboard and place a single format on it.  On success, the
+ clipboard owns the memory.  On failure, the memory is freed.
 
-    DllKernel32.pGlobalUnlock(hMem);
+ @param ClipFmt The clipboard format to set.
 
-    //
-    //  Send the buffer to the clipboard.
-    //
+ @param hMem The global memory allocation containing the data.
+
+ @return TRUE to indicate success or FALSE to indicate failure.
+ */
+BOOL
+ClipSetSingleFormat(
+    __in UINT ClipFmt,
+    __in HANDLE hMem
+    )
+{
+    DWORD  Err;
+    LPTSTR ErrText;
 
     if (!YoriLibOpenClipboard()) {
         Err = GetLastError();
         ErrText = YoriLibGetWinErrorText(Err);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: could not open clipboard: %s\n"), ErrText);
+        GlobalFree(hMem);
         return FALSE;
     }
 
@@ -275,15 +314,7 @@ ClipCopyAsHtml(
         ErrText = YoriLibGetWinErrorText(Err);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: could not empty clipboard: %s\n"), ErrText);
         DllUser32.pCloseClipboard();
-        return FALSE;
-    }
-
-    ClipFmt = DllUser32.pRegisterClipboardFormatW(_T("HTML Format"));
-    if (ClipFmt == 0) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: could not register clipboard format: %s\n"), ErrText);
-        DllUser32.pCloseClipboard();
+        GlobalFree(hMem);
         return FALSE;
     }
 
@@ -292,165 +323,182 @@ ClipCopyAsHtml(
         ErrText = YoriLibGetWinErrorText(Err);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: could not set clipboard data: %s\n"), ErrText);
         DllUser32.pCloseClipboard();
+        GlobalFree(hMem);
         return FALSE;
     }
+
     DllUser32.pCloseClipboard();
-    GlobalFree(hMem);
     return TRUE;
 }
 
 /**
- Copy the contents of a file or pipe to the clipboard in RTF format.
+ Register a named clipboard format, displaying an error on failure.
+
+ @param FormatName The name of the format.
+
+ @return The format number, or zero on failure.
+ */
+UINT
+ClipRegisterFormat(
+    __in LPCTSTR FormatName
+    )
+{
+    UINT   ClipFmt;
+    DWORD  Err;
+    LPTSTR ErrText;
+
+    ClipFmt = DllUser32.pRegisterClipboardFormatW(FormatName);
+    if (ClipFmt == 0) {
+        Err = GetLastError();
+        ErrText = YoriLibGetWinErrorText(Err);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: could not register clipboard format: %s\n"), ErrText);
+    }
+    return ClipFmt;
+}
+
+/**
+ Copy the contents of a file or pipe to the clipboard in HTML format.
 
  @param hFile Handle to the file or pipe.
 
  @param FileSize The length of the file, in bytes.  For a pipe, this value is
-        not known beforehand, and is specified as MAX_PIPE_SIZE.
+        not known beforehand, and is specified as zero.
 
  @return TRUE to indicate success or FALSE to indicate failure.
  */
 BOOL
-ClipCopyAsRtf(
+ClipCopyAsHtml(
     __in HANDLE hFile,
     __in DWORD FileSize
     )
 {
-    LPSTR  AnsiBuffer;
-    YORI_ALLOC_SIZE_T AllocSize;
     HANDLE hMem;
-    PCHAR  pMem;
-    DWORD  BytesTransferred;
-    YORI_ALLOC_SIZE_T CurrentOffset;
-    DWORD  Err;
-    LPTSTR ErrText;
+    PUCHAR pMem;
+    YORI_ALLOC_SIZE_T DataLength;
     UINT   ClipFmt;
 
+    ClipFmt = ClipRegisterFormat(_T("HTML Format"));
+    if (ClipFmt == 0) {
+        return FALSE;
+    }
+
     //
-    //  Allocate space to copy the file or pipe contents.
+    //  Read text immediately following space for the header, leaving a
+    //  magic space between the header and the text.
     //
 
-    if (!YoriLibIsSizeAllocatable(FileSize + 1)) {
+    if (!ClipReadToGlobal(hFile,
+                          FileSize,
+                          HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE + 1,
+                          HTMLCLIP_FRAGEND_SIZE + 1,
+                          &hMem,
+                          &DataLength)) {
         return FALSE;
     }
-    AllocSize = (YORI_ALLOC_SIZE_T)(FileSize + 1);
-    AnsiBuffer = YoriLibMalloc(AllocSize);
-    if (AnsiBuffer == NULL) {
+
+    pMem = DllKernel32.pGlobalLock(hMem);
+    if (pMem == NULL) {
+        GlobalFree(hMem);
         return FALSE;
     }
 
     //
     //  Note this is not Unicode.
     //
+    //  Now that the length is known, prepare the header.  Printf will
+    //  terminate it, so the magic space is written afterwards.
+    //
 
-    CurrentOffset = 0;
+    YoriLibSPrintfSA((PCHAR)pMem,
+                     HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE + 1,
+                     "Version:0.9\n"
+                     "StartHTML:%08i\n"
+                     "EndHTML:%08i\n"
+                     "StartFragment:%08i\n"
+                     "EndFragment:%08i\n"
+                     "<!--StartFragment-->",
+                     (int)HTMLCLIP_HDR_SIZE,
+                     (int)(HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE + HTMLCLIP_FRAGEND_SIZE + 1 + DataLength),
+                     (int)(HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE),
+                     (int)(HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE + 1 + DataLength));
+
+    pMem[HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE] = ' ';
 
     //
-    //  Read text.
+    //  Fill in the footer of the protocol.
     //
 
-    while (ReadFile(hFile, AnsiBuffer + CurrentOffset, FileSize - CurrentOffset, &BytesTransferred, NULL)) {
-        CurrentOffset = CurrentOffset + (YORI_ALLOC_SIZE_T)BytesTransferred;
+    YoriLibSPrintfA((PCHAR)(pMem + DataLength + HTMLCLIP_HDR_SIZE + HTMLCLIP_FRAGSTART_SIZE + 1),
+                    "%s",
+                    ClipDummyFragEnd);
 
-        //
-        //  If we're reading from the pipe and have exceeded our storage,
-        //  fail.
-        //
+    DllKernel32.pGlobalUnlock(hMem);
 
-        if (CurrentOffset == FileSize &&
-            FileSize == MAX_PIPE_SIZE &&
-            hFile == GetStdHandle(STD_INPUT_HANDLE)) {
+    //
+    //  Send the buffer to the clipboard.
+    //
 
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Pipe data too large for buffer.  Limit is %i bytes\n"), MAX_PIPE_SIZE);
-            return FALSE;
-        }
+    return ClipSetSingleFormat(ClipFmt, hMem);
+}
 
-        if (BytesTransferred == 0) {
-            break;
-        }
-    }
+/**
+ Copy the contents of a file or pipe to the clipboard in RTF format.
 
-    if (CurrentOffset == 0) {
-        YoriLibFree(AnsiBuffer);
-        ClipHelp();
+ @param hFile Handle to the file or pipe.
+
+ @param FileSize The length of the file, in bytes.  For a pipe, this value is
+        not known beforehand, and is specified as zero.
+
+ @return TRUE to indicate success or FALSE to indicate failure.
+ */
+BOOL
+ClipCopyAsRtf(
+    __in HANDLE hFile,
+    __in DWORD FileSize
+    )
+{
+    HANDLE hMem;
+    PCHAR  pMem;
+    YORI_ALLOC_SIZE_T DataLength;
+    YORI_ALLOC_SIZE_T Index;
+    UINT   ClipFmt;
+
+    ClipFmt = ClipRegisterFormat(_T("Rich Text Format"));
+    if (ClipFmt == 0) {
         return FALSE;
     }
 
+    //
+    //  Read text, leaving space for a NULL terminator.
+    //
 
-    AllocSize = CurrentOffset;
-    hMem = GlobalAlloc(GMEM_MOVEABLE|GMEM_DDESHARE, (AllocSize + 1) * sizeof(TCHAR));
-    if (hMem == NULL) {
-        YoriLibFree(AnsiBuffer);
+    if (!ClipReadToGlobal(hFile, FileSize, 0, 1, &hMem, &DataLength)) {
         return FALSE;
     }
 
     pMem = DllKernel32.pGlobalLock(hMem);
     if (pMem == NULL) {
         GlobalFree(hMem);
-        YoriLibFree(AnsiBuffer);
         return FALSE;
     }
 
-    for (CurrentOffset = 0; CurrentOffset < AllocSize; CurrentOffset++) {
+    //
+    //  Note this is not Unicode.  RTF is 7 bit, so strip the high bit in
+    //  place.
+    //
 
-        //
-        //  Analyze gets really confused here and thinks AnsiBuffer is
-        //  of size BytesTransferred (ie., it doesn't understand that
-        //  the read started partway through the buffer.)  At this point,
-        //  it is of size CurrentOffset.
-        //
-#if defined(_MSC_VER) && (_MSC_VER >= 1700)
-#pragma warning(suppress: 6385)
-#endif
-        pMem[CurrentOffset] = (CHAR)(AnsiBuffer[CurrentOffset] & 0x7f);
+    for (Index = 0; Index < DataLength; Index++) {
+        pMem[Index] = (CHAR)(pMem[Index] & 0x7f);
     }
 
-    pMem[AllocSize] = '\0';
+    pMem[DataLength] = '\0';
     DllKernel32.pGlobalUnlock(hMem);
 
-    YoriLibFree(AnsiBuffer);
-
     //
     //  Send the buffer to the clipboard.
     //
 
-    if (!YoriLibOpenClipboard()) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: could not open clipboard: %s\n"), ErrText);
-        GlobalFree(hMem);
-        return FALSE;
-    }
-
-    if (!DllUser32.pEmptyClipboard()) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: could not empty clipboard: %s\n"), ErrText);
-        DllUser32.pCloseClipboard();
-        GlobalFree(hMem);
-        return FALSE;
-    }
-
-    ClipFmt = DllUser32.pRegisterClipboardFormatW(_T("Rich Text Format"));
-    if (ClipFmt == 0) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: could not register clipboard format: %s\n"), ErrText);
-        DllUser32.pCloseClipboard();
-        return FALSE;
-    }
-
-    if (DllUser32.pSetClipboardData(ClipFmt, hMem) == NULL) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: could not set clipboard data: %s\n"), ErrText);
-        DllUser32.pCloseClipboard();
-        GlobalFree(hMem);
-        return FALSE;
-    }
-
-    DllUser32.pCloseClipboard();
-    GlobalFree(hMem);
-    return TRUE;
+    return ClipSetSingleFormat(ClipFmt, hMem);
 }
 
 #if defined(_MSC_VER) && (_MSC_VER >= 1500) && (_MSC_VER <= 1600)
@@ -463,7 +511,7 @@ ClipCopyAsRtf(
  @param hFile Handle to the file or pipe.
 
  @param FileSize The length of the file, in bytes.  For a pipe, this value is
-        not known beforehand, and is specified as MAX_PIPE_SIZE.
+        not known beforehand, and is specified as zero.
 
  @return TRUE to indicate success or FALSE to indicate failure.
  */
@@ -473,129 +521,64 @@ ClipCopyAsText(
     __in DWORD FileSize
     )
 {
+    HANDLE hRaw;
     LPSTR  AnsiBuffer;
-    YORI_ALLOC_SIZE_T AllocSize;
+    YORI_ALLOC_SIZE_T DataLength;
+    YORI_ALLOC_SIZE_T CharsNeeded;
     HANDLE hMem;
     PTCHAR pMem;
-    DWORD  BytesTransferred;
-    YORI_ALLOC_SIZE_T CurrentOffset;
-    DWORD  Err;
-    LPTSTR ErrText;
 
     //
-    //  Allocate space to copy the file or pipe contents.
+    //  Read the input in its original encoding.  Unlike the other formats,
+    //  this needs to be converted, and the conversion cannot occur in
+    //  place.
     //
 
-    if (!YoriLibIsSizeAllocatable(FileSize + 1)) {
+    if (!ClipReadToGlobal(hFile, FileSize, 0, 0, &hRaw, &DataLength)) {
         return FALSE;
     }
-    AllocSize = (YORI_ALLOC_SIZE_T)(FileSize + 1);
-    AnsiBuffer = YoriLibMalloc(AllocSize);
+
+    AnsiBuffer = DllKernel32.pGlobalLock(hRaw);
     if (AnsiBuffer == NULL) {
+        GlobalFree(hRaw);
         return FALSE;
     }
 
-    //
-    //  Note this is not Unicode.
-    //
-
-    CurrentOffset = 0;
-
-    //
-    //  Read text.
-    //
-
-    while (ReadFile(hFile, AnsiBuffer + CurrentOffset, FileSize - CurrentOffset, &BytesTransferred, NULL)) {
-        CurrentOffset = CurrentOffset + (YORI_ALLOC_SIZE_T)BytesTransferred;
-
-        //
-        //  If we're reading from the pipe and have exceeded our storage,
-        //  fail.
-        //
-
-        if (CurrentOffset == FileSize &&
-            FileSize == MAX_PIPE_SIZE &&
-            hFile == GetStdHandle(STD_INPUT_HANDLE)) {
-
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Pipe data too large for buffer.  Limit is %i bytes\n"), MAX_PIPE_SIZE);
-            return FALSE;
-        }
-
-        if (BytesTransferred == 0) {
-            break;
-        }
-    }
-
-    if (CurrentOffset == 0) {
-        YoriLibFree(AnsiBuffer);
-        ClipHelp();
+    CharsNeeded = YoriLibGetMultibyteInputSizeNeeded(AnsiBuffer, DataLength);
+    if (!YoriLibIsSizeAllocatable(((YORI_MAX_UNSIGNED_T)CharsNeeded + 1) * sizeof(TCHAR))) {
+        DllKernel32.pGlobalUnlock(hRaw);
+        GlobalFree(hRaw);
         return FALSE;
     }
 
-
-    AllocSize = YoriLibGetMultibyteInputSizeNeeded(AnsiBuffer, CurrentOffset);
-    hMem = GlobalAlloc(GMEM_MOVEABLE|GMEM_DDESHARE, (AllocSize + 1) * sizeof(TCHAR));
+    hMem = GlobalAlloc(GMEM_MOVEABLE|GMEM_DDESHARE, (CharsNeeded + 1) * sizeof(TCHAR));
     if (hMem == NULL) {
-        YoriLibFree(AnsiBuffer);
+        DllKernel32.pGlobalUnlock(hRaw);
+        GlobalFree(hRaw);
         return FALSE;
     }
 
     pMem = DllKernel32.pGlobalLock(hMem);
     if (pMem == NULL) {
         GlobalFree(hMem);
-        YoriLibFree(AnsiBuffer);
+        DllKernel32.pGlobalUnlock(hRaw);
+        GlobalFree(hRaw);
         return FALSE;
     }
 
-    //
-    //  Analyze gets really confused here and thinks AnsiBuffer is
-    //  of size BytesTransferred (ie., it doesn't understand that
-    //  the read started partway through the buffer.)  At this point,
-    //  it is of size CurrentOffset.
-    //
-#if defined(_MSC_VER) && (_MSC_VER >= 1700)
-#pragma warning(suppress: 6385)
-#endif
-    YoriLibMultibyteInput(AnsiBuffer, CurrentOffset, pMem, AllocSize);
+    YoriLibMultibyteInput(AnsiBuffer, DataLength, pMem, CharsNeeded);
 
-    pMem[AllocSize] = '\0';
+    pMem[CharsNeeded] = '\0';
     DllKernel32.pGlobalUnlock(hMem);
 
-    YoriLibFree(AnsiBuffer);
+    DllKernel32.pGlobalUnlock(hRaw);
+    GlobalFree(hRaw);
 
     //
     //  Send the buffer to the clipboard.
     //
 
-    if (!YoriLibOpenClipboard()) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: could not open clipboard: %s\n"), ErrText);
-        GlobalFree(hMem);
-        return FALSE;
-    }
-
-    if (!DllUser32.pEmptyClipboard()) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: could not empty clipboard: %s\n"), ErrText);
-        DllUser32.pCloseClipboard();
-        GlobalFree(hMem);
-        return FALSE;
-    }
-
-    if (DllUser32.pSetClipboardData(CF_UNICODETEXT, hMem) == NULL) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("clip: could not set clipboard data: %s\n"), ErrText);
-        DllUser32.pCloseClipboard();
-        GlobalFree(hMem);
-        return FALSE;
-    }
-
-    DllUser32.pCloseClipboard();
-    GlobalFree(hMem);
-    return TRUE;
+    return ClipSetSingleFormat(CF_UNICODETEXT, hMem);
 }
 
 /**
@@ -1182,7 +1165,7 @@ ENTRYPOINT(
             hFile = GetStdHandle(STD_OUTPUT_HANDLE);
         } else {
 
-            FileSize = MAX_PIPE_SIZE;
+            FileSize = 0;
             hFile = GetStdHandle(STD_INPUT_HANDLE);
 
             //
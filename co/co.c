@@ -3,7 +3,7 @@
  *
  * Yori shell mini file manager
  *
- * Copyright (c) 2019-2023 Malcolm J. Smith
+ * Copyright (c) 2019-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -67,13 +67,39 @@ CoHelp(VOID)
     return TRUE;
 }
 
+/**
+ The interval in milliseconds between checks for files found by the
+ background thread or changes reported within the directory.
+ */
+#define CO_POPULATE_INTERVAL (100)
+
+/**
+ The time in milliseconds to wait for an enumeration to complete before
+ displaying partial results.  Most directories are small, and waiting
+ briefly for them avoids displaying an empty list followed by its contents.
+ */
+#define CO_POPULATE_SYNCHRONOUS_WAIT (50)
+
+/**
+ The number of files the background thread collects before making them
+ available to the display.
+ */
+#define CO_POPULATE_BATCH_SIZE (256)
+
+/**
+ The size of the buffer used to receive directory change notifications, in
+ bytes.
+ */
+#define CO_CHANGE_BUFFER_SIZE (64 * 1024)
+
 /**
  Information about a single found file.
  */
 typedef struct _CO_FOUND_FILE {
 
     /**
-     The found file link within the list of found files.
+     The found file link within the list of files found by the background
+     thread that have not yet been displayed.
      */
     YORI_LIST_ENTRY ListEntry;
 
@@ -104,6 +130,11 @@ typedef struct _CO_FOUND_FILE {
      */
     BOOLEAN IsDirectory;
 
+    /**
+     TRUE if the user has selected this file in the list.
+     */
+    BOOLEAN Selected;
+
 } CO_FOUND_FILE, *PCO_FOUND_FILE;
 
 /**
@@ -123,15 +154,21 @@ typedef enum _CO_SORT_TYPE {
 typedef struct _CO_CONTEXT {
 
     /**
-     A linked list of the files that have been found.
+     A linked list of the files that have been found by the background
+     thread and have not yet been displayed.  This is protected by Mutex.
      */
-    YORI_LIST_ENTRY FilesFound;
+    YORI_LIST_ENTRY PendingFiles;
 
     /**
-     The number of files that have been found.
+     The number of files being displayed.
      */
     YORI_ALLOC_SIZE_T FilesFoundCount;
 
+    /**
+     The number of elements allocated in FileArray.
+     */
+    YORI_ALLOC_SIZE_T FileArrayAllocated;
+
     /**
      The sort order currently being applied.  Note this is not reset in
      CoFreeContext, because it needs to be preserved across repopulation.
@@ -144,8 +181,9 @@ typedef struct _CO_CONTEXT {
     PYORI_WIN_CTRL_HANDLE List;
 
     /**
-     The same list as above, arranged into a flat array form to match the
-     addressing of the list control.
+     The files being displayed, in sorted order, arranged into a flat array
+     form to match the addressing of the list control.  This is only
+     accessed by the UI thread.
      */
     PCO_FOUND_FILE* FileArray;
 
@@ -158,247 +196,1267 @@ typedef struct _CO_CONTEXT {
      The current directory for the application.
      */
     YORI_STRING CurrentDirectory;
+
+    /**
+     The wildcard specification being enumerated by the background thread.
+     */
+    YORI_STRING PopulateSpec;
+
+    /**
+     Handle to the background thread.  NULL if enumeration is occurring
+     synchronously or the thread has been waited for.
+     */
+    HANDLE Thread;
+
+    /**
+     A mutex protecting the pending list and the error, cancel and complete
+     fields.
+     */
+    HANDLE Mutex;
+
+    /**
+     A handle to the current directory, used to receive notifications when
+     its contents change.  NULL if changes are not being monitored.
+     */
+    HANDLE ChangeHandle;
+
+    /**
+     The overlapped structure for the outstanding change notification
+     request.  Its event is signalled when changes are available.
+     */
+    OVERLAPPED ChangeOverlapped;
+
+    /**
+     A buffer to receive change notifications.
+     */
+    PVOID ChangeBuffer;
+
+    /**
+     The first error encountered by the background thread, or
+     ERROR_SUCCESS.
+     */
+    DWORD Error;
+
+    /**
+     Set to TRUE to request the background thread to stop.
+     */
+    BOOLEAN Cancel;
+
+    /**
+     Set to TRUE by the background thread once it has found all files.
+     */
+    BOOLEAN Complete;
+
+    /**
+     Set to TRUE by the UI thread once all files have been displayed.  This
+     is only accessed by the UI thread.
+     */
+    BOOLEAN Finished;
+
+    /**
+     Set to TRUE while a file operation is iterating over the displayed
+     files, so a timer callback from a nested dialog does not change them.
+     */
+    BOOLEAN UpdatesSuspended;
 } CO_CONTEXT, *PCO_CONTEXT;
 
+/**
+ A batch of files found by the background thread which have not yet been
+ made available to the display.
+ */
+typedef struct _CO_POPULATE_BATCH {
+
+    /**
+     Pointer to the co context.
+     */
+    PCO_CONTEXT CoContext;
+
+    /**
+     A linked list of files found in this batch.
+     */
+    YORI_LIST_ENTRY Files;
+
+    /**
+     The number of files in this batch.
+     */
+    DWORD Count;
+
+    /**
+     The first error encountered while enumerating, or ERROR_SUCCESS.
+     */
+    DWORD Error;
+} CO_POPULATE_BATCH, *PCO_POPULATE_BATCH;
+
+/**
+ Free a single found file.
+
+ @param FoundFile Pointer to the found file to free.
+ */
+VOID
+CoFreeFoundFile(
+    __in PCO_FOUND_FILE FoundFile
+    )
+{
+    YoriLibFreeStringContents(&FoundFile->DisplayName);
+    YoriLibFreeStringContents(&FoundFile->FullFilePath);
+    YoriLibDereference(FoundFile);
+}
+
+/**
+ Free all found files on a linked list.
+
+ @param ListHead Pointer to the list of found files to free.
+ */
+VOID
+CoFreeFoundFileList(
+    __in PYORI_LIST_ENTRY ListHead
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PCO_FOUND_FILE FoundFile;
+
+    ListEntry = YoriLibGetNextListEntry(ListHead, NULL);
+    while (ListEntry != NULL) {
+        FoundFile = CONTAINING_RECORD(ListEntry, CO_FOUND_FILE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(ListHead, ListEntry);
+
+        YoriLibRemoveListItem(&FoundFile->ListEntry);
+        CoFreeFoundFile(FoundFile);
+    }
+}
+
+/**
+ Free all found files, including those being displayed and those found but
+ not yet displayed.  The caller must ensure the background thread is not
+ running.
+
+ @param CoContext Pointer to the context of found files to free.
+ */
+VOID
+CoFreeFileList(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    CoFreeFoundFileList(&CoContext->PendingFiles);
+
+    for (Index = 0; Index < CoContext->FilesFoundCount; Index++) {
+        CoFreeFoundFile(CoContext->FileArray[Index]);
+    }
+
+    if (CoContext->FileArray != NULL) {
+        YoriLibFree(CoContext->FileArray);
+        CoContext->FileArray = NULL;
+    }
+
+    CoContext->FilesFoundCount = 0;
+    CoContext->FileArrayAllocated = 0;
+}
+
+/**
+ Allocate a found file structure describing a file.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @param FileInfo Information about the file.
+
+ @return Pointer to the found file, or NULL on allocation failure.
+ */
+PCO_FOUND_FILE
+CoAllocateFoundFile(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo
+    )
+{
+    PCO_FOUND_FILE FoundFile;
+    YORI_ALLOC_SIZE_T DisplayNameLength;
+
+    DisplayNameLength = (YORI_ALLOC_SIZE_T)_tcslen(FileInfo->cFileName);
+    FoundFile = YoriLibReferencedMalloc(sizeof(CO_FOUND_FILE) + (DisplayNameLength + 1 + FilePath->LengthInChars + 1) * sizeof(TCHAR));
+    if (FoundFile == NULL) {
+        return NULL;
+    }
+
+    YoriLibInitEmptyString(&FoundFile->DisplayName);
+    YoriLibInitEmptyString(&FoundFile->FullFilePath);
+
+    YoriLibReference(FoundFile);
+    FoundFile->DisplayName.MemoryToFree = FoundFile;
+    FoundFile->DisplayName.StartOfString = (LPTSTR)(FoundFile + 1);
+    FoundFile->DisplayName.LengthInChars = DisplayNameLength;
+    FoundFile->DisplayName.LengthAllocated = DisplayNameLength + 1;
+
+    memcpy(FoundFile->DisplayName.StartOfString, FileInfo->cFileName, DisplayNameLength * sizeof(TCHAR));
+    FoundFile->DisplayName.StartOfString[FoundFile->DisplayName.LengthInChars] = '\0';
+
+    YoriLibReference(FoundFile);
+    FoundFile->FullFilePath.MemoryToFree = FoundFile;
+    FoundFile->FullFilePath.StartOfString = FoundFile->DisplayName.StartOfString + FoundFile->DisplayName.LengthAllocated;
+    FoundFile->FullFilePath.LengthInChars = FilePath->LengthInChars;
+    FoundFile->FullFilePath.LengthAllocated = FilePath->LengthInChars + 1;
+
+    memcpy(FoundFile->FullFilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    FoundFile->FullFilePath.StartOfString[FoundFile->FullFilePath.LengthInChars] = '\0';
+
+    FoundFile->FileSize.HighPart = FileInfo->nFileSizeHigh;
+    FoundFile->FileSize.LowPart = FileInfo->nFileSizeLow;
+    FoundFile->WriteTime.HighPart = FileInfo->ftLastWriteTime.dwHighDateTime;
+    FoundFile->WriteTime.LowPart = FileInfo->ftLastWriteTime.dwLowDateTime;
+
+    if (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        FoundFile->IsDirectory = TRUE;
+    } else {
+        FoundFile->IsDirectory = FALSE;
+    }
+
+    FoundFile->Selected = FALSE;
+    return FoundFile;
+}
+
+/**
+ Make a batch of files found by the background thread available to the
+ display.
+
+ @param Batch Pointer to the files found by the background thread.  On
+        completion, this batch is empty.
+ */
+VOID
+CoPublishBatch(
+    __inout PCO_POPULATE_BATCH Batch
+    )
+{
+    PCO_CONTEXT CoContext = Batch->CoContext;
+    PYORI_LIST_ENTRY ListEntry;
+
+    WaitForSingleObject(CoContext->Mutex, INFINITE);
+    ListEntry = YoriLibGetNextListEntry(&Batch->Files, NULL);
+    while (ListEntry != NULL) {
+        YoriLibRemoveListItem(ListEntry);
+        YoriLibAppendList(&CoContext->PendingFiles, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Batch->Files, NULL);
+    }
+    ReleaseMutex(CoContext->Mutex);
+    Batch->Count = 0;
+}
+
+/**
+ A callback that is invoked when a file is found that should be added to the
+ list.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.
+
+ @param Depth Specifies the recursion depth.  Ignored in this application.
+
+ @param Context Pointer to the batch of found files to add this file to.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+CoFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PCO_POPULATE_BATCH Batch = (PCO_POPULATE_BATCH)Context;
+    PCO_FOUND_FILE FoundFile;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    if (Batch->CoContext->Cancel) {
+        return FALSE;
+    }
+
+    FoundFile = CoAllocateFoundFile(FilePath, FileInfo);
+    if (FoundFile == NULL) {
+        Batch->Error = ERROR_NOT_ENOUGH_MEMORY;
+        return FALSE;
+    }
+
+    YoriLibAppendList(&Batch->Files, &FoundFile->ListEntry);
+    Batch->Count++;
+
+    if (Batch->Count >= CO_POPULATE_BATCH_SIZE) {
+        CoPublishBatch(Batch);
+    }
+    return TRUE;
+}
+
+/**
+ Enumerate the files within the current directory.  This is normally
+ executed on a background thread, and makes files available to the display
+ in batches.
+
+ @param CoContext Pointer to the co context.
+ */
+VOID
+CoPopulateWorker(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    CO_POPULATE_BATCH Batch;
+
+    Batch.CoContext = CoContext;
+    YoriLibInitializeListHead(&Batch.Files);
+    Batch.Count = 0;
+    Batch.Error = ERROR_SUCCESS;
+
+    YoriLibForEachFile(&CoContext->PopulateSpec,
+                       YORILIB_FILEENUM_BASIC_EXPANSION | YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES | YORILIB_FILEENUM_INCLUDE_DOTFILES,
+                       0,
+                       CoFileFoundCallback,
+                       NULL,
+                       &Batch);
+
+    CoPublishBatch(&Batch);
+
+    WaitForSingleObject(CoContext->Mutex, INFINITE);
+    if (!CoContext->Cancel) {
+        CoContext->Error = Batch.Error;
+    }
+    CoContext->Complete = TRUE;
+    ReleaseMutex(CoContext->Mutex);
+}
+
+/**
+ The entrypoint for the background thread which enumerates a directory.
+
+ @param Context Pointer to the co context.
+
+ @return Zero.
+ */
+DWORD WINAPI
+CoPopulateThread(
+    __in PVOID Context
+    )
+{
+    CoPopulateWorker((PCO_CONTEXT)Context);
+    return 0;
+}
+
+/**
+ Compare two found files according to the sort order currently being
+ applied.  Files which compare equal by size or date are ordered by name.
+
+ @param CoContext Pointer to the co context specifying the sort order.
+
+ @param Left Pointer to the first file to compare.
+
+ @param Right Pointer to the second file to compare.
+
+ @return Negative if Left should be displayed before Right, zero if they
+         are equal, and positive if Left should be displayed after Right.
+ */
+int
+CoCompareFiles(
+    __in PCO_CONTEXT CoContext,
+    __in PCO_FOUND_FILE Left,
+    __in PCO_FOUND_FILE Right
+    )
+{
+    if (CoContext->SortType == CoSortBySize) {
+        if (Left->FileSize.QuadPart < Right->FileSize.QuadPart) {
+            return -1;
+        } else if (Left->FileSize.QuadPart > Right->FileSize.QuadPart) {
+            return 1;
+        }
+    } else if (CoContext->SortType == CoSortByDate) {
+        if (Left->WriteTime.QuadPart < Right->WriteTime.QuadPart) {
+            return -1;
+        } else if (Left->WriteTime.QuadPart > Right->WriteTime.QuadPart) {
+            return 1;
+        }
+    }
+
+    return YoriLibCompareStringIns(&Left->DisplayName, &Right->DisplayName);
+}
+
+/**
+ Merge two adjacent sorted ranges of an array of found files into a single
+ sorted range.
 
+ @param CoContext Pointer to the co context specifying the sort order.
+
+ @param Array Pointer to the array of found files.
+
+ @param Start The index of the first element of the first range.
+
+ @param Middle The index of the first element of the second range.
+
+ @param End The index beyond the final element of the second range.
+
+ @param Temp Pointer to a scratch array at least End elements long.
+ */
+VOID
+CoMergeFileRanges(
+    __in PCO_CONTEXT CoContext,
+    __inout PCO_FOUND_FILE* Array,
+    __in YORI_ALLOC_SIZE_T Start,
+    __in YORI_ALLOC_SIZE_T Middle,
+    __in YORI_ALLOC_SIZE_T End,
+    __inout PCO_FOUND_FILE* Temp
+    )
+{
+    YORI_ALLOC_SIZE_T LeftIndex;
+    YORI_ALLOC_SIZE_T RightIndex;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (Start == Middle || Middle == End ||
+        CoCompareFiles(CoContext, Array[Middle - 1], Array[Middle]) <= 0) {
+
+        return;
+    }
+
+    LeftIndex = Start;
+    RightIndex = Middle;
+    for (Index = Start; Index < End; Index++) {
+        if (RightIndex >= End ||
+            (LeftIndex < Middle &&
+             CoCompareFiles(CoContext, Array[LeftIndex], Array[RightIndex]) <= 0)) {
+
+            Temp[Index] = Array[LeftIndex];
+            LeftIndex++;
+        } else {
+            Temp[Index] = Array[RightIndex];
+            RightIndex++;
+        }
+    }
+
+    memcpy(&Array[Start], &Temp[Start], (End - Start) * sizeof(PCO_FOUND_FILE));
+}
+
+/**
+ Sort a range of an array of found files.
+
+ @param CoContext Pointer to the co context specifying the sort order.
+
+ @param Array Pointer to the array of found files.
+
+ @param Start The index of the first element to sort.
+
+ @param End The index beyond the final element to sort.
+
+ @param Temp Pointer to a scratch array at least End elements long.
+ */
+VOID
+CoSortFileRange(
+    __in PCO_CONTEXT CoContext,
+    __inout PCO_FOUND_FILE* Array,
+    __in YORI_ALLOC_SIZE_T Start,
+    __in YORI_ALLOC_SIZE_T End,
+    __inout PCO_FOUND_FILE* Temp
+    )
+{
+    YORI_ALLOC_SIZE_T Width;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Middle;
+    YORI_ALLOC_SIZE_T RangeEnd;
+
+    for (Width = 1; Width < End - Start; Width = Width * 2) {
+        for (Index = Start; End - Index > Width; Index = RangeEnd) {
+            Middle = Index + Width;
+            RangeEnd = End;
+            if (End - Middle > Width) {
+                RangeEnd = Middle + Width;
+            }
+            CoMergeFileRanges(CoContext, Array, Index, Middle, RangeEnd, Temp);
+        }
+    }
+}
+
+/**
+ Return the text of an item in the list.
+
+ @param Ctrl Pointer to the list control.
+
+ @param Index The index of the item to return.
+
+ @param String On successful completion, updated to point to the text of
+        the item.  This refers to memory owned by the found file.
+
+ @return TRUE to indicate the string was populated, FALSE if it was not.
+ */
+BOOLEAN
+CoGetFileText(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl,
+    __in YORI_ALLOC_SIZE_T Index,
+    __inout PYORI_STRING String
+    )
+{
+    PCO_CONTEXT CoContext;
+
+    CoContext = YoriWinGetControlContext(YoriWinGetControlParent(Ctrl));
+    if (Index >= CoContext->FilesFoundCount) {
+        return FALSE;
+    }
+
+    String->StartOfString = CoContext->FileArray[Index]->DisplayName.StartOfString;
+    String->LengthInChars = CoContext->FileArray[Index]->DisplayName.LengthInChars;
+    return TRUE;
+}
+
+/**
+ Query or toggle whether an item in the list is selected.  The selection is
+ recorded in the found file so that it follows the file as the list is
+ populated and sorted.
+
+ @param Ctrl Pointer to the list control.
+
+ @param Index The index of the item.
+
+ @param Toggle TRUE if the selection state of the item should be changed.
+
+ @return TRUE if the item is selected after any change.
+ */
+BOOLEAN
+CoFileSelected(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl,
+    __in YORI_ALLOC_SIZE_T Index,
+    __in BOOLEAN Toggle
+    )
+{
+    PCO_CONTEXT CoContext;
+    PCO_FOUND_FILE FoundFile;
+
+    CoContext = YoriWinGetControlContext(YoriWinGetControlParent(Ctrl));
+    if (Index >= CoContext->FilesFoundCount) {
+        return FALSE;
+    }
+
+    FoundFile = CoContext->FileArray[Index];
+    if (Toggle) {
+        FoundFile->Selected = (BOOLEAN)!FoundFile->Selected;
+    }
+    return FoundFile->Selected;
+}
+
+/**
+ Return the found file that is currently active in the list control.
+
+ @param CoContext Pointer to the co context.
+
+ @param ActiveIndex On completion, updated to contain the index of the
+        active file.  This is zero if no file is active.
+
+ @return Pointer to the active file, or NULL if no file is active.
+ */
+PCO_FOUND_FILE
+CoGetActiveFile(
+    __in PCO_CONTEXT CoContext,
+    __out PYORI_ALLOC_SIZE_T ActiveIndex
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    *ActiveIndex = 0;
+    if (!YoriWinListGetActiveOption(CoContext->List, &Index) ||
+        Index >= CoContext->FilesFoundCount) {
+
+        return NULL;
+    }
+
+    *ActiveIndex = Index;
+    return CoContext->FileArray[Index];
+}
+
+/**
+ Update the list control after the displayed files have changed, keeping
+ the previously active file active.  If the previously active file is no
+ longer displayed, the file at the same position becomes active.
+
+ @param CoContext Pointer to the co context.
+
+ @param ActiveFile Pointer to the file which was active before the change,
+        or NULL if that file is no longer displayed.
+
+ @param ActiveIndex The index of the file which was active before the
+        change.
+ */
+VOID
+CoRefreshList(
+    __in PCO_CONTEXT CoContext,
+    __in_opt PCO_FOUND_FILE ActiveFile,
+    __in YORI_ALLOC_SIZE_T ActiveIndex
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T CurrentIndex;
+
+    YoriWinListSetVirtualItems(CoContext->List, CoContext->FilesFoundCount, CoGetFileText);
+
+    if (CoContext->FilesFoundCount == 0 ||
+        !YoriWinListGetActiveOption(CoContext->List, &CurrentIndex)) {
+
+        return;
+    }
+
+    Index = CoContext->FilesFoundCount;
+    if (ActiveFile != NULL) {
+        for (Index = 0; Index < CoContext->FilesFoundCount; Index++) {
+            if (CoContext->FileArray[Index] == ActiveFile) {
+                break;
+            }
+        }
+    }
+
+    if (Index == CoContext->FilesFoundCount) {
+        Index = ActiveIndex;
+        if (Index >= CoContext->FilesFoundCount) {
+            Index = CoContext->FilesFoundCount - 1;
+        }
+    }
+
+    if (Index != CurrentIndex) {
+        YoriWinListSetActiveOption(CoContext->List, Index);
+    }
+}
+
+/**
+ Add a list of found files to the displayed files, preserving the sort
+ order.  The new files are sorted among themselves and then merged with
+ the files already displayed, so adding a batch does not require the
+ existing files to be sorted again.
+
+ @param CoContext Pointer to the co context.
+
+ @param Files Pointer to a list of found files to add.  On completion, the
+        list is empty, and any files that could not be added have been freed.
+
+ @return TRUE to indicate the files were added, FALSE on allocation failure.
+ */
+__success(return)
+BOOLEAN
+CoAddFiles(
+    __in PCO_CONTEXT CoContext,
+    __inout PYORI_LIST_ENTRY Files
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PCO_FOUND_FILE FoundFile;
+    PCO_FOUND_FILE ActiveFile;
+    PCO_FOUND_FILE* NewArray;
+    PCO_FOUND_FILE* Temp;
+    YORI_ALLOC_SIZE_T ActiveIndex;
+    YORI_ALLOC_SIZE_T OldCount;
+    DWORD NewCount;
+    DWORD NewAllocated;
+
+    NewCount = CoContext->FilesFoundCount;
+    ListEntry = YoriLibGetNextListEntry(Files, NULL);
+    while (ListEntry != NULL) {
+        NewCount++;
+        ListEntry = YoriLibGetNextListEntry(Files, ListEntry);
+    }
+
+    if (NewCount == CoContext->FilesFoundCount) {
+        return TRUE;
+    }
+
+    if (NewCount > CoContext->FileArrayAllocated) {
+        NewAllocated = CoContext->FileArrayAllocated * 2;
+        if (NewAllocated < NewCount) {
+            NewAllocated = NewCount;
+        }
+        if (!YoriLibIsSizeAllocatable(NewAllocated * sizeof(PCO_FOUND_FILE))) {
+            NewAllocated = NewCount;
+        }
+        if (!YoriLibIsSizeAllocatable(NewAllocated * sizeof(PCO_FOUND_FILE))) {
+            CoFreeFoundFileList(Files);
+            return FALSE;
+        }
+
+        NewArray = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(PCO_FOUND_FILE)));
+        if (NewArray == NULL) {
+            CoFreeFoundFileList(Files);
+            return FALSE;
+        }
+
+        if (CoContext->FileArray != NULL) {
+            memcpy(NewArray, CoContext->FileArray, CoContext->FilesFoundCount * sizeof(PCO_FOUND_FILE));
+            YoriLibFree(CoContext->FileArray);
+        }
+        CoContext->FileArray = NewArray;
+        CoContext->FileArrayAllocated = (YORI_ALLOC_SIZE_T)NewAllocated;
+    }
+
+    Temp = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewCount * sizeof(PCO_FOUND_FILE)));
+    if (Temp == NULL) {
+        CoFreeFoundFileList(Files);
+        return FALSE;
+    }
+
+    ActiveFile = CoGetActiveFile(CoContext, &ActiveIndex);
+
+    OldCount = CoContext->FilesFoundCount;
+    ListEntry = YoriLibGetNextListEntry(Files, NULL);
+    while (ListEntry != NULL) {
+        FoundFile = CONTAINING_RECORD(ListEntry, CO_FOUND_FILE, ListEntry);
+        YoriLibRemoveListItem(ListEntry);
+        CoContext->FileArray[CoContext->FilesFoundCount] = FoundFile;
+        CoContext->FilesFoundCount++;
+        ListEntry = YoriLibGetNextListEntry(Files, NULL);
+    }
+
+    CoSortFileRange(CoContext, CoContext->FileArray, OldCount, CoContext->FilesFoundCount, Temp);
+    CoMergeFileRanges(CoContext, CoContext->FileArray, 0, OldCount, CoContext->FilesFoundCount, Temp);
+    YoriLibFree(Temp);
+
+    CoRefreshList(CoContext, ActiveFile, ActiveIndex);
+    return TRUE;
+}
+
+/**
+ Sort the displayed files according to the sort order currently being
+ applied, keeping the active file active.
+
+ @param CoContext Pointer to the co context.
+
+ @return TRUE to indicate the files were sorted, FALSE on allocation
+         failure.
+ */
+__success(return)
+BOOLEAN
+CoSortFiles(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    PCO_FOUND_FILE ActiveFile;
+    PCO_FOUND_FILE* Temp;
+    YORI_ALLOC_SIZE_T ActiveIndex;
+
+    if (CoContext->FilesFoundCount == 0) {
+        return TRUE;
+    }
+
+    Temp = YoriLibMalloc((YORI_ALLOC_SIZE_T)(CoContext->FilesFoundCount * sizeof(PCO_FOUND_FILE)));
+    if (Temp == NULL) {
+        return FALSE;
+    }
+
+    ActiveFile = CoGetActiveFile(CoContext, &ActiveIndex);
+    CoSortFileRange(CoContext, CoContext->FileArray, 0, CoContext->FilesFoundCount, Temp);
+    YoriLibFree(Temp);
+
+    CoRefreshList(CoContext, ActiveFile, ActiveIndex);
+    return TRUE;
+}
+
+/**
+ Remove a file from the displayed files and free it.  The caller is
+ expected to update the list control once all changes are made.
+
+ @param CoContext Pointer to the co context.
+
+ @param Index The index of the file to remove.
+ */
+VOID
+CoRemoveFile(
+    __in PCO_CONTEXT CoContext,
+    __in YORI_ALLOC_SIZE_T Index
+    )
+{
+    ASSERT(Index < CoContext->FilesFoundCount);
+    CoFreeFoundFile(CoContext->FileArray[Index]);
+    memmove(&CoContext->FileArray[Index],
+            &CoContext->FileArray[Index + 1],
+            (CoContext->FilesFoundCount - Index - 1) * sizeof(PCO_FOUND_FILE));
+    CoContext->FilesFoundCount--;
+}
+
+/**
+ Find a displayed file by name.
+
+ @param CoContext Pointer to the co context.
+
+ @param FileName Pointer to the name of the file to find.
+
+ @return The index of the file, or the number of displayed files if no
+         file has the specified name.
+ */
+YORI_ALLOC_SIZE_T
+CoFindFileByName(
+    __in PCO_CONTEXT CoContext,
+    __in PYORI_STRING FileName
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    for (Index = 0; Index < CoContext->FilesFoundCount; Index++) {
+        if (YoriLibCompareStringIns(&CoContext->FileArray[Index]->DisplayName, FileName) == 0) {
+            break;
+        }
+    }
+
+    return Index;
+}
+
+/**
+ Remove any trailing newline characters from a string.
+
+ @param String Pointer to the string to truncate.
+ */
+VOID
+CoTrimTrailingNewlines(
+    __inout PYORI_STRING String
+    )
+{
+    DWORD Index;
+    for (Index = String->LengthInChars; Index > 0; Index--) {
+        if (String->StartOfString[Index - 1] != '\r' &&
+            String->StartOfString[Index - 1] != '\n') {
+
+            break;
+        }
+        String->LengthInChars--;
+    }
+}
+
+/**
+ Display an error to the user.
+
+ @param CoContext Pointer to the co context.
+
+ @param Prefix Pointer to a NULL terminated string describing the operation
+        that failed.
+
+ @param LastError The Win32 error code describing the failure.
+ */
+VOID
+CoDisplayError(
+    __in PCO_CONTEXT CoContext,
+    __in LPCTSTR Prefix,
+    __in DWORD LastError
+    )
+{
+    YORI_STRING Buttons[1];
+    YORI_STRING Title;
+    YORI_STRING Label;
+    LPTSTR ErrText;
+
+    ErrText = YoriLibGetWinErrorText(LastError);
+    if (ErrText == NULL) {
+        return;
+    }
+
+    YoriLibConstantString(&Buttons[0], _T("&Ok"));
+    YoriLibConstantString(&Title, _T("Error"));
+    YoriLibInitEmptyString(&Label);
+    YoriLibYPrintf(&Label, _T("%s: %s"), Prefix, ErrText);
+    YoriLibFreeWinErrorText(ErrText);
+    if (Label.LengthInChars > 0) {
+        CoTrimTrailingNewlines(&Label);
+        YoriDlgMessageBox(CoContext->WinMgr, &Title, &Label, 1, Buttons, 0, 0);
+        YoriLibFreeStringContents(&Label);
+    }
+}
+
+/**
+ Request notification of the next set of changes within the current
+ directory.
+
+ @param CoContext Pointer to the co context.
+
+ @return TRUE to indicate a request is outstanding, FALSE if changes are
+         not being monitored.
+ */
+BOOLEAN
+CoWatchIssue(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    ResetEvent(CoContext->ChangeOverlapped.hEvent);
+    if (!DllKernel32.pReadDirectoryChangesW(CoContext->ChangeHandle,
+                                            CoContext->ChangeBuffer,
+                                            CO_CHANGE_BUFFER_SIZE,
+                                            FALSE,
+                                            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE,
+                                            NULL,
+                                            &CoContext->ChangeOverlapped,
+                                            NULL)) {
+
+        CloseHandle(CoContext->ChangeHandle);
+        CoContext->ChangeHandle = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Stop monitoring the current directory for changes.
+
+ @param CoContext Pointer to the co context.
+ */
+VOID
+CoWatchStop(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    DWORD BytesTransferred;
+
+    if (CoContext->ChangeHandle != NULL) {
+        CancelIo(CoContext->ChangeHandle);
+        GetOverlappedResult(CoContext->ChangeHandle, &CoContext->ChangeOverlapped, &BytesTransferred, TRUE);
+        CloseHandle(CoContext->ChangeHandle);
+        CoContext->ChangeHandle = NULL;
+    }
+}
 
 /**
- Free all found files in the list.
+ Begin monitoring the current directory for changes.  This is performed
+ before enumerating the directory so that changes which occur during
+ enumeration are not lost.  If the system cannot report changes, the list
+ is only updated by operations performed within this program.
 
- @param CoContext Pointer to the context of found files to free.
+ @param CoContext Pointer to the co context.
  */
 VOID
-CoFreeFileList(
+CoWatchStart(
     __in PCO_CONTEXT CoContext
     )
 {
-    PYORI_LIST_ENTRY ListEntry;
-    PCO_FOUND_FILE FoundFile;
+    HANDLE ChangeHandle;
 
-    ListEntry = NULL;
-    ListEntry = YoriLibGetNextListEntry(&CoContext->FilesFound, ListEntry);
-    while (ListEntry != NULL) {
-        FoundFile = CONTAINING_RECORD(ListEntry, CO_FOUND_FILE, ListEntry);
-        ListEntry = YoriLibGetNextListEntry(&CoContext->FilesFound, ListEntry);
+    if (DllKernel32.pReadDirectoryChangesW == NULL ||
+        CoContext->ChangeBuffer == NULL ||
+        CoContext->ChangeOverlapped.hEvent == NULL) {
 
-        YoriLibRemoveListItem(&FoundFile->ListEntry);
-        YoriLibFreeStringContents(&FoundFile->DisplayName);
-        YoriLibFreeStringContents(&FoundFile->FullFilePath);
-        YoriLibDereference(FoundFile);
+        return;
     }
 
-    if (CoContext->FileArray != NULL) {
-        YoriLibFree(CoContext->FileArray);
-        CoContext->FileArray = NULL;
+    ChangeHandle = CreateFile(CoContext->CurrentDirectory.StartOfString,
+                              FILE_LIST_DIRECTORY,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL,
+                              OPEN_EXISTING,
+                              FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+                              NULL);
+
+    if (ChangeHandle == INVALID_HANDLE_VALUE) {
+        return;
     }
 
-    CoContext->FilesFoundCount = 0;
+    CoContext->ChangeHandle = ChangeHandle;
+    CoWatchIssue(CoContext);
 }
 
 /**
- Free all allocations in the context.
+ Update a single file in the displayed files following a change reported
+ within the directory.  If the file exists, any previous entry for it is
+ replaced, and if it does not exist, any previous entry is removed.
 
- @param CoContext Pointer to the context of found files to free.
+ @param CoContext Pointer to the co context.
+
+ @param FileName Pointer to the name of the file that changed.
  */
 VOID
-CoFreeContext(
-    __in PCO_CONTEXT CoContext
+CoWatchUpdateFile(
+    __in PCO_CONTEXT CoContext,
+    __in PYORI_STRING FileName
     )
 {
-    CoFreeFileList(CoContext);
-    YoriLibFreeStringContents(&CoContext->CurrentDirectory);
-}
+    YORI_STRING FullPath;
+    YORI_LIST_ENTRY NewFiles;
+    YORI_ALLOC_SIZE_T Index;
+    WIN32_FIND_DATA FindData;
+    PCO_FOUND_FILE FoundFile;
+    HANDLE FindHandle;
+    BOOLEAN Selected;
+
+    Selected = FALSE;
+    Index = CoFindFileByName(CoContext, FileName);
+    if (Index < CoContext->FilesFoundCount) {
+        Selected = CoContext->FileArray[Index]->Selected;
+        CoRemoveFile(CoContext, Index);
+    }
 
-/**
- A callback that is invoked when a file is found that should be added to the
- list.
+    YoriLibInitEmptyString(&FullPath);
+    YoriLibYPrintf(&FullPath, _T("%y\\%y"), &CoContext->CurrentDirectory, FileName);
+    if (FullPath.StartOfString == NULL) {
+        return;
+    }
 
- @param FilePath Pointer to the file path that was found.
+    FindHandle = FindFirstFile(FullPath.StartOfString, &FindData);
+    if (FindHandle == INVALID_HANDLE_VALUE) {
+        YoriLibFreeStringContents(&FullPath);
+        return;
+    }
+    FindClose(FindHandle);
 
- @param FileInfo Information about the file.
+    FoundFile = CoAllocateFoundFile(&FullPath, &FindData);
+    YoriLibFreeStringContents(&FullPath);
+    if (FoundFile == NULL) {
+        return;
+    }
 
- @param Depth Specifies the recursion depth.  Ignored in this application.
+    FoundFile->Selected = Selected;
+    YoriLibInitializeListHead(&NewFiles);
+    YoriLibAppendList(&NewFiles, &FoundFile->ListEntry);
+    CoAddFiles(CoContext, &NewFiles);
+}
+
+/**
+ Apply any changes reported within the current directory to the displayed
+ files.  Changes are only applied once the initial enumeration has been
+ displayed, so that files are not found twice.
 
- @param Context Pointer to the co context specifying the list to populate
-        with found files.
+ @param CoContext Pointer to the co context.
 
- @return TRUE to continute enumerating, FALSE to abort.
+ @return TRUE if the displayed files reflect all reported changes, FALSE if
+         more changes occurred than could be reported and the list should be
+         populated again.
  */
-BOOL
-CoFileFoundCallback(
-    __in PYORI_STRING FilePath,
-    __in PWIN32_FIND_DATA FileInfo,
-    __in DWORD Depth,
-    __in PVOID Context
+BOOLEAN
+CoWatchProcess(
+    __in PCO_CONTEXT CoContext
     )
 {
-    PCO_CONTEXT CoContext = (PCO_CONTEXT)Context;
-    PCO_FOUND_FILE FoundFile;
-    YORI_ALLOC_SIZE_T DisplayNameLength;
+    PFILE_NOTIFY_INFORMATION Notify;
+    PCO_FOUND_FILE ActiveFile;
+    YORI_ALLOC_SIZE_T ActiveIndex;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_STRING FileName;
+    DWORD BytesTransferred;
+    DWORD Offset;
 
-    UNREFERENCED_PARAMETER(Depth);
+    if (CoContext->ChangeHandle == NULL ||
+        !CoContext->Finished ||
+        WaitForSingleObject(CoContext->ChangeOverlapped.hEvent, 0) != WAIT_OBJECT_0) {
 
-    DisplayNameLength = (YORI_ALLOC_SIZE_T)_tcslen(FileInfo->cFileName);
-    FoundFile = YoriLibReferencedMalloc(sizeof(CO_FOUND_FILE) + (DisplayNameLength + 1 + FilePath->LengthInChars + 1) * sizeof(TCHAR));
-    if (FoundFile == NULL) {
-        return FALSE;
+        return TRUE;
     }
 
-    YoriLibInitEmptyString(&FoundFile->DisplayName);
-    YoriLibInitEmptyString(&FoundFile->FullFilePath);
+    if (!GetOverlappedResult(CoContext->ChangeHandle, &CoContext->ChangeOverlapped, &BytesTransferred, FALSE)) {
+        CloseHandle(CoContext->ChangeHandle);
+        CoContext->ChangeHandle = NULL;
+        return TRUE;
+    }
 
-    YoriLibReference(FoundFile);
-    FoundFile->DisplayName.MemoryToFree = FoundFile;
-    FoundFile->DisplayName.StartOfString = (LPTSTR)(FoundFile + 1);
-    FoundFile->DisplayName.LengthInChars = DisplayNameLength;
-    FoundFile->DisplayName.LengthAllocated = DisplayNameLength + 1;
+    //
+    //  If the buffer overflowed, the changes are unknown, so start over.
+    //
 
-    memcpy(FoundFile->DisplayName.StartOfString, FileInfo->cFileName, DisplayNameLength * sizeof(TCHAR));
-    FoundFile->DisplayName.StartOfString[FoundFile->DisplayName.LengthInChars] = '\0';
+    if (BytesTransferred == 0) {
+        return FALSE;
+    }
 
-    YoriLibReference(FoundFile);
-    FoundFile->FullFilePath.MemoryToFree = FoundFile;
-    FoundFile->FullFilePath.StartOfString = FoundFile->DisplayName.StartOfString + FoundFile->DisplayName.LengthAllocated;
-    FoundFile->FullFilePath.LengthInChars = FilePath->LengthInChars;
-    FoundFile->FullFilePath.LengthAllocated = FilePath->LengthInChars + 1;
+    ActiveFile = CoGetActiveFile(CoContext, &ActiveIndex);
 
-    memcpy(FoundFile->FullFilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
-    FoundFile->FullFilePath.StartOfString[FoundFile->FullFilePath.LengthInChars] = '\0';
+    Offset = 0;
+    do {
+        Notify = (PFILE_NOTIFY_INFORMATION)YoriLibAddToPointer(CoContext->ChangeBuffer, Offset);
+        YoriLibInitEmptyString(&FileName);
+        FileName.StartOfString = Notify->FileName;
+        FileName.LengthInChars = (YORI_ALLOC_SIZE_T)(Notify->FileNameLength / sizeof(WCHAR));
 
-    FoundFile->FileSize.HighPart = FileInfo->nFileSizeHigh;
-    FoundFile->FileSize.LowPart = FileInfo->nFileSizeLow;
-    FoundFile->WriteTime.HighPart = FileInfo->ftLastWriteTime.dwHighDateTime;
-    FoundFile->WriteTime.LowPart = FileInfo->ftLastWriteTime.dwLowDateTime;
+        if (Notify->Action == FILE_ACTION_REMOVED ||
+            Notify->Action == FILE_ACTION_RENAMED_OLD_NAME) {
 
-    if (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-        FoundFile->IsDirectory = TRUE;
-    } else {
-        FoundFile->IsDirectory = FALSE;
-    }
+            Index = CoFindFileByName(CoContext, &FileName);
+            if (Index < CoContext->FilesFoundCount) {
+                if (CoContext->FileArray[Index] == ActiveFile) {
+                    ActiveFile = NULL;
+                }
+                CoRemoveFile(CoContext, Index);
+            }
+        } else {
+            if (ActiveFile != NULL &&
+                YoriLibCompareStringIns(&ActiveFile->DisplayName, &FileName) == 0) {
 
-    YoriLibAppendList(&CoContext->FilesFound, &FoundFile->ListEntry);
-    CoContext->FilesFoundCount++;
+                ActiveFile = NULL;
+            }
+            CoWatchUpdateFile(CoContext, &FileName);
+        }
+
+        Offset = Offset + Notify->NextEntryOffset;
+    } while (Notify->NextEntryOffset != 0 && Offset < BytesTransferred);
+
+    CoRefreshList(CoContext, ActiveFile, ActiveIndex);
+    CoWatchIssue(CoContext);
     return TRUE;
 }
 
 /**
- Populate in memory structures and the UI list with found files.
+ Display any files found by the background thread since the previous call.
+ Once enumeration has completed, the thread is waited for and any error is
+ reported.
 
- @param CoContext Pointer to the context to populate with found files.
-
- @return TRUE to indicate success, FALSE to indicate failure.
+ @param CoContext Pointer to the co context.
  */
-__success(return)
-BOOL
-CoPopulateList(
+VOID
+CoPopulateUpdate(
     __in PCO_CONTEXT CoContext
     )
 {
-    YORI_STRING FileSpec;
-    PYORI_STRING DisplayArray;
-    DWORD Index;
-    DWORD SubIndex;
-    DWORD BestIndex;
+    YORI_LIST_ENTRY NewFiles;
     PYORI_LIST_ENTRY ListEntry;
-    PCO_FOUND_FILE FoundFile;
-    PCO_FOUND_FILE CompareFile;
-    PCO_FOUND_FILE BestFile;
-
-    YoriLibInitEmptyString(&FileSpec);
-    YoriLibYPrintf(&FileSpec, _T("%y\\*"), &CoContext->CurrentDirectory);
-    YoriLibForEachFile(&FileSpec,
-                       YORILIB_FILEENUM_BASIC_EXPANSION | YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES | YORILIB_FILEENUM_INCLUDE_DOTFILES,
-                       0,
-                       CoFileFoundCallback,
-                       NULL,
-                       CoContext);
-    YoriLibFreeStringContents(&FileSpec);
+    BOOLEAN Complete;
+    DWORD Err;
 
-    if (CoContext->FilesFoundCount == 0) {
-        return TRUE;
+    if (CoContext->Finished) {
+        return;
     }
 
-    DisplayArray = YoriLibMalloc(sizeof(YORI_STRING) * CoContext->FilesFoundCount);
-    if (DisplayArray == NULL) {
-        return FALSE;
+    YoriLibInitializeListHead(&NewFiles);
+    WaitForSingleObject(CoContext->Mutex, INFINITE);
+    ListEntry = YoriLibGetNextListEntry(&CoContext->PendingFiles, NULL);
+    while (ListEntry != NULL) {
+        YoriLibRemoveListItem(ListEntry);
+        YoriLibAppendList(&NewFiles, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&CoContext->PendingFiles, NULL);
+    }
+    Complete = CoContext->Complete;
+    Err = CoContext->Error;
+    ReleaseMutex(CoContext->Mutex);
+
+    if (!CoAddFiles(CoContext, &NewFiles)) {
+        WaitForSingleObject(CoContext->Mutex, INFINITE);
+        if (CoContext->Error == ERROR_SUCCESS) {
+            CoContext->Error = ERROR_NOT_ENOUGH_MEMORY;
+        }
+        CoContext->Cancel = TRUE;
+        ReleaseMutex(CoContext->Mutex);
     }
 
-    CoContext->FileArray = YoriLibMalloc(sizeof(PCO_FOUND_FILE) * CoContext->FilesFoundCount);
-    if (CoContext->FileArray == NULL) {
-        YoriLibDereference(DisplayArray);
-        return FALSE;
+    if (!Complete) {
+        return;
     }
 
     //
-    //  Arrange the files into a flat array
+    //  Mark the enumeration finished before anything that could process
+    //  input, so a nested timer callback finds nothing to do.
     //
 
-    ListEntry = NULL;
-    for (Index = 0; Index < CoContext->FilesFoundCount; Index++) {
-        ListEntry = YoriLibGetNextListEntry(&CoContext->FilesFound, ListEntry);
-        FoundFile = CONTAINING_RECORD(ListEntry, CO_FOUND_FILE, ListEntry);
-        CoContext->FileArray[Index] = FoundFile;
+    CoContext->Finished = TRUE;
+
+    if (CoContext->Thread != NULL) {
+        WaitForSingleObject(CoContext->Thread, INFINITE);
+        CloseHandle(CoContext->Thread);
+        CoContext->Thread = NULL;
     }
 
-    //
-    //  Sort the array based on the selected sort criteria
-    //
+    YoriWinListSetVirtualItems(CoContext->List, CoContext->FilesFoundCount, CoGetFileText);
 
-    for (Index = 0; Index < CoContext->FilesFoundCount; Index++) {
-        FoundFile = CoContext->FileArray[Index];
-        BestFile = FoundFile;
-        BestIndex = Index;
-        for (SubIndex = Index + 1; SubIndex < CoContext->FilesFoundCount; SubIndex++) {
-            CompareFile = CoContext->FileArray[SubIndex];
-            if (CoContext->SortType == CoSortByName) {
-                if (YoriLibCompareStringIns(&CompareFile->DisplayName, &BestFile->DisplayName) < 0) {
-                    BestFile = CompareFile;
-                    BestIndex = SubIndex;
-                }
-            } else if (CoContext->SortType == CoSortBySize) {
-                if (CompareFile->FileSize.QuadPart < BestFile->FileSize.QuadPart) {
-                    BestFile = CompareFile;
-                    BestIndex = SubIndex;
-                }
-            } else if (CoContext->SortType == CoSortByDate) {
-                if (CompareFile->WriteTime.QuadPart < BestFile->WriteTime.QuadPart) {
-                    BestFile = CompareFile;
-                    BestIndex = SubIndex;
-                }
-            }
-        }
+    if (Err != ERROR_SUCCESS) {
+        CoDisplayError(CoContext, _T("Could not enumerate directory"), Err);
+    }
+}
 
-        if (BestIndex != Index) {
-            CoContext->FileArray[BestIndex] = CoContext->FileArray[Index];
-            CoContext->FileArray[Index] = BestFile;
-        }
+/**
+ Stop any enumeration in progress, stop monitoring the directory for
+ changes, and free all found files.  The list is emptied, since it displays
+ names owned by the found files.
+
+ @param CoContext Pointer to the co context.
+ */
+VOID
+CoPopulateCancel(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    if (CoContext->Thread != NULL) {
+        WaitForSingleObject(CoContext->Mutex, INFINITE);
+        CoContext->Cancel = TRUE;
+        ReleaseMutex(CoContext->Mutex);
+
+        WaitForSingleObject(CoContext->Thread, INFINITE);
+        CloseHandle(CoContext->Thread);
+        CoContext->Thread = NULL;
     }
 
-    //
-    //  Generate the display array string based on the result of the sort
-    //
+    CoWatchStop(CoContext);
+    YoriWinListClearAllItems(CoContext->List);
+    CoFreeFileList(CoContext);
+    YoriLibFreeStringContents(&CoContext->PopulateSpec);
+    CoContext->Finished = TRUE;
+}
 
-    for (Index = 0; Index < CoContext->FilesFoundCount; Index++) {
-        memcpy(&DisplayArray[Index], &CoContext->FileArray[Index]->DisplayName, sizeof(YORI_STRING));
+/**
+ Free all allocations in the context.
+
+ @param CoContext Pointer to the context of found files to free.
+ */
+VOID
+CoFreeContext(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    if (CoContext->Mutex != NULL) {
+        YoriWinSetPeriodicNotifyCallback(YoriWinGetControlParent(CoContext->List), 0, NULL);
+        CoPopulateCancel(CoContext);
+        CloseHandle(CoContext->Mutex);
+        CoContext->Mutex = NULL;
     }
 
-    //
-    //  Populate the list with the result
-    //
+    if (CoContext->ChangeOverlapped.hEvent != NULL) {
+        CloseHandle(CoContext->ChangeOverlapped.hEvent);
+        CoContext->ChangeOverlapped.hEvent = NULL;
+    }
+
+    if (CoContext->ChangeBuffer != NULL) {
+        YoriLibFree(CoContext->ChangeBuffer);
+        CoContext->ChangeBuffer = NULL;
+    }
+
+    YoriLibFreeStringContents(&CoContext->CurrentDirectory);
+}
+
+/**
+ Begin populating the list with files in the current directory.  Files are
+ displayed as they are found and inserted in sorted order.  Enumeration
+ occurs on a background thread so that large directories or network shares
+ do not prevent the user from interacting with the display.
+
+ @param CoContext Pointer to the context to populate with found files.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+CoPopulateList(
+    __in PCO_CONTEXT CoContext
+    )
+{
+    DWORD ThreadId;
 
-    if (!YoriWinListAddItems(CoContext->List, DisplayArray, CoContext->FilesFoundCount)) {
-        YoriLibDereference(DisplayArray);
+    YoriLibInitEmptyString(&CoContext->PopulateSpec);
+    YoriLibYPrintf(&CoContext->PopulateSpec, _T("%y\\*"), &CoContext->CurrentDirectory);
+    if (CoContext->PopulateSpec.StartOfString == NULL) {
         return FALSE;
     }
 
-    YoriLibFree(DisplayArray);
+    CoContext->Error = ERROR_SUCCESS;
+    CoContext->Cancel = FALSE;
+    CoContext->Complete = FALSE;
+    CoContext->Finished = FALSE;
+
+    CoWatchStart(CoContext);
+    YoriWinListSetVirtualItems(CoContext->List, 0, CoGetFileText);
+
+    CoContext->Thread = CreateThread(NULL, 0, CoPopulateThread, CoContext, 0, &ThreadId);
+    if (CoContext->Thread != NULL) {
+        WaitForSingleObject(CoContext->Thread, CO_POPULATE_SYNCHRONOUS_WAIT);
+        CoPopulateUpdate(CoContext);
+        return TRUE;
+    }
+
+    //
+    //  If a thread cannot be created, enumerate the directory now.
+    //
+
+    CoPopulateWorker(CoContext);
+    CoPopulateUpdate(CoContext);
     return TRUE;
 }
 
 /**
- Clear the contents of the list and start over.  This isn't a great user
- experience because of how it affects the view region.  We'll want something
- better.
+ Clear the contents of the list and start over.  This is used when the
+ current directory changes, or when changes within the directory could not
+ be tracked.
 
  @param CoContext Pointer to context about files to display and the list to
         display them in.
@@ -411,11 +1469,34 @@ CoRepopulateList(
     __in PCO_CONTEXT CoContext
     )
 {
-    CoFreeFileList(CoContext);
-    YoriWinListClearAllItems(CoContext->List);
+    CoPopulateCancel(CoContext);
     return CoPopulateList(CoContext);
 }
 
+/**
+ A callback invoked periodically to display files found by the background
+ thread and changes reported within the directory.
+
+ @param Ctrl Pointer to the main window.
+ */
+VOID
+CoPeriodicCallback(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PCO_CONTEXT CoContext;
+
+    CoContext = YoriWinGetControlContext(Ctrl);
+    if (CoContext->UpdatesSuspended) {
+        return;
+    }
+
+    CoPopulateUpdate(CoContext);
+    if (!CoWatchProcess(CoContext)) {
+        CoRepopulateList(CoContext);
+    }
+}
+
 /**
  Verify that a file is selected.  If no file is selected, display a dialog
  letting the user know.
@@ -450,27 +1531,6 @@ CoIsFileSelected(
     return FALSE;
 }
 
-/**
- Remove any trailing newline characters from a string.
-
- @param String Pointer to the string to truncate.
- */
-VOID
-CoTrimTrailingNewlines(
-    __inout PYORI_STRING String
-    )
-{
-    DWORD Index;
-    for (Index = String->LengthInChars; Index > 0; Index--) {
-        if (String->StartOfString[Index - 1] != '\r' &&
-            String->StartOfString[Index - 1] != '\n') {
-
-            break;
-        }
-        String->LengthInChars--;
-    }
-}
-
 /**
  Display a dialog to prompt the user for a directory to use as the target of
  a copy or move operation.
@@ -694,6 +1754,8 @@ CoDeleteButtonClicked(
     )
 {
     YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T ActiveIndex;
+    PCO_FOUND_FILE ActiveFile;
     BOOLEAN ListChanged = FALSE;
     YORI_STRING Buttons[1];
     YORI_STRING Title;
@@ -705,7 +1767,11 @@ CoDeleteButtonClicked(
         return;
     }
 
-    for (Index = 0; Index < CoContext.FilesFoundCount; Index++) {
+    CoContext.UpdatesSuspended = TRUE;
+    ActiveFile = CoGetActiveFile(&CoContext, &ActiveIndex);
+
+    Index = 0;
+    while (Index < CoContext.FilesFoundCount) {
         if (YoriWinListIsOptionSelected(CoContext.List, Index)) {
             if (!DeleteFile(CoContext.FileArray[Index]->FullFilePath.StartOfString)) {
                 DWORD LastError;
@@ -722,12 +1788,19 @@ CoDeleteButtonClicked(
                 YoriLibFreeStringContents(&Label);
                 break;
             }
+            if (CoContext.FileArray[Index] == ActiveFile) {
+                ActiveFile = NULL;
+            }
+            CoRemoveFile(&CoContext, Index);
             ListChanged = TRUE;
+            continue;
         }
+        Index++;
     }
     if (ListChanged) {
-        CoRepopulateList(&CoContext);
+        CoRefreshList(&CoContext, ActiveFile, ActiveIndex);
     }
+    CoContext.UpdatesSuspended = FALSE;
 }
 
 /**
@@ -748,6 +1821,8 @@ CoMoveButtonClicked(
     YORI_STRING FullDir;
     YORI_STRING FullDest;
     YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T ActiveIndex;
+    PCO_FOUND_FILE ActiveFile;
     DWORD LastError;
     BOOLEAN ListChanged = FALSE;
     YORI_STRING Buttons[1];
@@ -769,8 +1844,12 @@ CoMoveButtonClicked(
         return;
     }
 
+    CoContext.UpdatesSuspended = TRUE;
+    ActiveFile = CoGetActiveFile(&CoContext, &ActiveIndex);
+
     ListChanged = FALSE;
-    for (Index = 0; Index < CoContext.FilesFoundCount; Index++) {
+    Index = 0;
+    while (Index < CoContext.FilesFoundCount) {
         if (YoriWinListIsOptionSelected(CoContext.List, Index)) {
 
             FullDest.LengthInChars =
@@ -803,16 +1882,23 @@ CoMoveButtonClicked(
                 }
                 break;
             }
+            if (CoContext.FileArray[Index] == ActiveFile) {
+                ActiveFile = NULL;
+            }
+            CoRemoveFile(&CoContext, Index);
             ListChanged = TRUE;
+            continue;
         }
+        Index++;
     }
 
     YoriLibFreeStringContents(&FullDest);
     YoriLibFreeStringContents(&FullDir);
 
     if (ListChanged) {
-        CoRepopulateList(&CoContext);
+        CoRefreshList(&CoContext, ActiveFile, ActiveIndex);
     }
+    CoContext.UpdatesSuspended = FALSE;
 }
 
 /**
@@ -829,7 +1915,6 @@ CoCopyButtonClicked(
     YORI_STRING FullDest;
     YORI_ALLOC_SIZE_T Index;
     DWORD LastError;
-    BOOLEAN ListChanged = FALSE;
     YORI_STRING Buttons[1];
     YORI_STRING Title;
     YORI_STRING Label;
@@ -849,7 +1934,12 @@ CoCopyButtonClicked(
         return;
     }
 
-    ListChanged = FALSE;
+    //
+    //  Files are copied to a different directory, so the displayed files do
+    //  not change, but any change is reported through the directory watch.
+    //
+
+    CoContext.UpdatesSuspended = TRUE;
     for (Index = 0; Index < CoContext.FilesFoundCount; Index++) {
         if (YoriWinListIsOptionSelected(CoContext.List, Index)) {
             FullDest.LengthInChars =
@@ -884,13 +1974,10 @@ CoCopyButtonClicked(
             }
         }
     }
+    CoContext.UpdatesSuspended = FALSE;
 
     YoriLibFreeStringContents(&FullDest);
     YoriLibFreeStringContents(&FullDir);
-
-    if (ListChanged) {
-        CoRepopulateList(&CoContext);
-    }
 }
 
 /**
@@ -909,7 +1996,9 @@ CoSortSelected(
     if (YoriWinComboGetActiveOption(ClickedCtrl, &ActiveIndex)) {
         if (ActiveIndex < CoSortBeyondMaximum && ActiveIndex != (YORI_ALLOC_SIZE_T)CoContext.SortType) {
             CoContext.SortType = ActiveIndex;
-            CoRepopulateList(&CoContext);
+            if (!CoSortFiles(&CoContext)) {
+                CoRepopulateList(&CoContext);
+            }
         }
     }
 }
@@ -1314,11 +2403,34 @@ CoCreateSynchronousMenu(VOID)
     YoriWinComboAddItems(Ctrl, SortStrings, CoSortBeyondMaximum);
     YoriWinComboSetActiveOption(Ctrl, CoContext.SortType);
 
-    YoriLibInitializeListHead(&CoContext.FilesFound);
+    YoriLibInitializeListHead(&CoContext.PendingFiles);
     CoContext.FilesFoundCount = 0;
+    CoContext.FileArrayAllocated = 0;
     CoContext.FileArray = NULL;
     CoContext.List = List;
     CoContext.WinMgr = WinMgr;
+    CoContext.Thread = NULL;
+    CoContext.ChangeHandle = NULL;
+    CoContext.UpdatesSuspended = FALSE;
+    YoriLibInitEmptyString(&CoContext.PopulateSpec);
+    ZeroMemory(&CoContext.ChangeOverlapped, sizeof(CoContext.ChangeOverlapped));
+    CoContext.ChangeOverlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    CoContext.ChangeBuffer = YoriLibMalloc(CO_CHANGE_BUFFER_SIZE);
+    CoContext.Mutex = CreateMutex(NULL, FALSE, NULL);
+
+    YoriWinSetControlContext(Parent, &CoContext);
+    YoriWinListSetVirtualSelection(List, CoFileSelected);
+
+    if (CoContext.Mutex == NULL ||
+        !YoriWinSetPeriodicNotifyCallback(Parent, CO_POPULATE_INTERVAL, CoPeriodicCallback)) {
+
+        CoFreeContext(&CoContext);
+        YoriWinDestroyWindow(Parent);
+        YoriWinCloseWindowManager(WinMgr);
+        CoContext.WinMgr = NULL;
+        return FALSE;
+    }
+
     if (!YoriLibGetCurrentDirectory(&CoContext.CurrentDirectory)) {
         CoFreeContext(&CoContext);
         YoriWinDestroyWindow(Parent);
@@ -1409,6 +2521,7 @@ ENTRYPOINT(
     }
 
     YoriLibLoadAdvApi32Functions();
+    YoriLibLoadKernel32Functions();
 
     if (!CoCreateSynchronousMenu()) {
         return EXIT_FAILURE;
@@ -35,11 +35,12 @@ CHAR strCompactHelpText[] =
         "\n"
         "Compress or decompress one or more files.\n"
         "\n"
-        "COMPACT [-license] [-b] [-c:algorithm | -u] [-s] [<file>...]\n"
+        "COMPACT [-license] [-b] [-c:algorithm [-f] | -u] [-s] [<file>...]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -c             Compress files with the specified algorithm.  Options are:\n"
         "                    lzx, ntfs, xp4k, xp8k, xp16k\n"
+        "   -f             Compress files even if they appear to be incompressible\n"
         "   -s             Process files from all subdirectories\n"
         "   -u             Decompress files\n"
         "   -v             Verbose output\n";
@@ -243,6 +244,7 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T StartArg = 0;
     WORD MatchFlags;
     BOOLEAN BasicEnumeration = FALSE;
+    BOOLEAN CompressIncompressible = FALSE;
     COMPACT_CONTEXT CompactContext;
     YORILIB_COMPRESS_ALGORITHM CompressionAlgorithm;
     YORI_STRING Arg;
@@ -294,6 +296,9 @@ ENTRYPOINT(
                 CompactContext.Compress = TRUE;
                 ArgumentUnderstood = TRUE;
 
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("f")) == 0) {
+                CompressIncompressible = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 CompactContext.Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -337,6 +342,7 @@ ENTRYPOINT(
     if (CompactContext.Verbose) {
         CompactContext.CompressContext.Verbose = TRUE;
     }
+    CompactContext.CompressContext.CompressIncompressible = CompressIncompressible;
 
     //
     //  NTFS compression operates on directories and therefore this program
@@ -370,6 +376,13 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
+    if (CompactContext.CompressContext.FilesSkippedIncompressible > 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                      _T("%i of %lli files were not compressed because they appear to be incompressible\n"),
+                      CompactContext.CompressContext.FilesSkippedIncompressible,
+                      CompactContext.FilesFound);
+    }
+
     return EXIT_SUCCESS;
 }
 
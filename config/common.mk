@@ -17,6 +17,14 @@ KERNELBASE=0
 FDI=0
 !ENDIF
 
+!IFNDEF HEAPPROFILE
+HEAPPROFILE=0
+!ENDIF
+
+!IFNDEF DLLPROFILE
+DLLPROFILE=0
+!ENDIF
+
 !IFNDEF BINDIR
 BINDIR=
 !ENDIF
@@ -78,6 +86,14 @@ CFLAGS_NOUNICODE=$(CFLAGS_NOUNICODE) -Gy -O1sb1
 
 !ENDIF # DEBUG
 
+!IF $(HEAPPROFILE)==1
+CFLAGS_NOUNICODE=$(CFLAGS_NOUNICODE) -DYORI_HEAP_PROFILE=1
+!ENDIF
+
+!IF $(DLLPROFILE)==1
+CFLAGS_NOUNICODE=$(CFLAGS_NOUNICODE) -DYORI_DLL_PROFILE=1
+!ENDIF
+
 #
 # Include and link to the desired CRT.
 #
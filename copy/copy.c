@@ -3,7 +3,7 @@
  *
  * Yori shell copy files
  *
- * Copyright (c) 2017-2022 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -35,22 +35,31 @@ CHAR strCopyHelpText[] =
         "\n"
         "Copies one or more files.\n"
         "\n"
-        "COPY [-license] [-b] [-c:algorithm] [-ds size] [-l] [-n|-nt|-p] [-s] [-t] [-v]\n"
-        "      [-x exclude] <src>\n"
-        "COPY [-license] [-b] [-c:algorithm] [-ds size] [-l] [-n|-nt|-p] [-s] [-t] [-v]\n"
-        "      [-x exclude] <src> [<src> ...] <dest>\n"
+        "COPY [-license] [-b] [-c:algorithm] [-ds size] [-j n] [-l] [-n|-nt|-p] [-s] [-t]\n"
+        "      [-u] [-uc count] [-us size] [-v] [-verify] [-x exclude] <src>\n"
+        "COPY [-license] [-b] [-c:algorithm] [-ds size] [-j n] [-l] [-n|-nt|-p] [-s] [-t]\n"
+        "      [-u] [-uc count] [-us size] [-v] [-verify] [-x exclude] <src> [<src> ...] <dest>\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -c             Compress targets with specified algorithm.  Options are:\n"
         "                    lzx, ntfs, xp4k, xp8k, xp16k\n"
         "   -ds            The size of the device, ignored for files\n"
+        "   -j             Copy up to n files concurrently\n"
         "   -l             Copy links as links rather than contents\n"
         "   -n             Copy new or files whose size have changed only\n"
         "   -nt            Copy new or files whose size or timestamps have changed only\n"
         "   -p             Preserve existing files, no overwriting\n"
         "   -s             Copy subdirectories as well as files\n"
         "   -t             Copy timestamps only, no data\n"
+        "   -u             Copy file data only with unbuffered IO, for large files.\n"
+        "                    Blocks are cloned if the volume supports it, and\n"
+        "                    sparse files remain sparse\n"
+        "   -uc            The number of buffers to use for unbuffered IO\n"
+        "   -us            The size of each buffer to use for unbuffered IO\n"
         "   -v             Verbose output\n"
+        "   -verify        Copy with unbuffered IO and verify the data written by\n"
+        "                    reading it back and comparing against a hash\n"
+        "                    calculated while copying\n"
         "   -x             Exclude files matching specified pattern\n";
 
 /**
@@ -82,8 +91,52 @@ typedef struct _COPY_EXCLUDE_ITEM {
      wildcards.
      */
     YORI_STRING ExcludeCriteria;
+
+    /**
+     The exclude criteria, compiled for matching against each file.
+     */
+    YORI_LIB_FILE_MATCH_EXPRESSION CompiledCriteria;
 } COPY_EXCLUDE_ITEM, *PCOPY_EXCLUDE_ITEM;
 
+/**
+ The maximum number of worker threads that can copy files concurrently.
+ */
+#define COPY_MAX_WORKERS (64)
+
+/**
+ The number of files that can be queued for each worker thread before
+ enumeration waits for workers to catch up.
+ */
+#define COPY_JOBS_PER_WORKER (16)
+
+/**
+ A single file queued for copying by a worker thread.
+ */
+typedef struct _COPY_JOB {
+
+    /**
+     The entry for this job within the list of queued jobs.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The full path to the source file.  This points into the same allocation
+     as the job.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     The offset in characters within FilePath of the path relative to the
+     root of the source.
+     */
+    YORI_ALLOC_SIZE_T RelativePathOffset;
+
+    /**
+     Information about the source file from enumeration.
+     */
+    WIN32_FIND_DATA FileInfo;
+} COPY_JOB, *PCOPY_JOB;
+
 /**
  A context passed between each source file match when copying multiple
  files.
@@ -99,6 +152,11 @@ typedef struct _COPY_CONTEXT {
      */
     YORI_LIST_ENTRY ExcludeList;
 
+    /**
+     A list of files waiting to be copied by worker threads.
+     */
+    YORI_LIST_ENTRY JobList;
+
     /**
      State related to background compression of files after copy.
      */
@@ -130,6 +188,63 @@ typedef struct _COPY_CONTEXT {
      */
     DWORD FilesFoundThisArg;
 
+    /**
+     The number of buffers to use when copying data with unbuffered IO, or
+     zero to use the default.
+     */
+    DWORD UnbufferedBufferCount;
+
+    /**
+     The size of each buffer to use when copying data with unbuffered IO,
+     or zero to use the default.
+     */
+    DWORD UnbufferedBufferSize;
+
+    /**
+     The number of worker threads in the Workers array.  If zero, files are
+     copied by the main thread as they are found.
+     */
+    DWORD WorkerCount;
+
+    /**
+     An array of handles to worker threads.
+     */
+    PHANDLE Workers;
+
+    /**
+     The number of jobs in JobList.
+     */
+    DWORD JobsQueued;
+
+    /**
+     The number of jobs that can be in JobList before enumeration waits for
+     workers to complete some of them.
+     */
+    DWORD MaximumJobsQueued;
+
+    /**
+     A mutex synchronizing JobList between the main thread and worker
+     threads.
+     */
+    HANDLE Mutex;
+
+    /**
+     A manual reset event which is signalled when jobs are available for
+     worker threads or worker threads should exit.
+     */
+    HANDLE WorkAvailableEvent;
+
+    /**
+     An auto reset event which is signalled when a worker thread completes
+     a job.
+     */
+    HANDLE JobCompleteEvent;
+
+    /**
+     TRUE if worker threads should exit once the queue is empty.
+     */
+    BOOLEAN Shutdown;
+
     /**
      If TRUE, targets should be compressed.
      */
@@ -182,10 +297,30 @@ typedef struct _COPY_CONTEXT {
      */
     BOOLEAN DestinationIsDevice;
 
+    /**
+     If TRUE, file data is copied with unbuffered IO rather than CopyFile.
+     This does not copy file metadata, but avoids filling the cache when
+     copying large files.
+     */
+    BOOLEAN Unbuffered;
+
     /**
      If TRUE, output is generated for each object copied.
      */
     BOOLEAN Verbose;
+
+    /**
+     If TRUE, data copied with unbuffered IO is read back from the
+     destination and compared against a digest calculated during the copy.
+     */
+    BOOLEAN Verify;
+
+    /**
+     The number of files which could not be verified, or did not match.
+     This is updated from worker threads, so it is updated with interlocked
+     operations.
+     */
+    DWORD VerifyFailures;
 } COPY_CONTEXT, *PCOPY_CONTEXT;
 
 /**
@@ -218,6 +353,7 @@ CopyAddExclude(
     ExcludeItem->ExcludeCriteria.LengthAllocated = NewCriteria->LengthInChars + 1;
     memcpy(ExcludeItem->ExcludeCriteria.StartOfString, NewCriteria->StartOfString, ExcludeItem->ExcludeCriteria.LengthInChars * sizeof(TCHAR));
     ExcludeItem->ExcludeCriteria.StartOfString[ExcludeItem->ExcludeCriteria.LengthInChars] = '\0';
+    YoriLibCompileFileMatchExpression(&ExcludeItem->ExcludeCriteria, &ExcludeItem->CompiledCriteria);
     YoriLibAppendList(&CopyContext->ExcludeList, &ExcludeItem->ExcludeList);
     return TRUE;
 }
@@ -325,7 +461,7 @@ CopyShouldExclude(
     ListEntry = YoriLibGetNextListEntry(&CopyContext->ExcludeList, NULL);
     while (ListEntry != NULL) {
         ExcludeItem = CONTAINING_RECORD(ListEntry, COPY_EXCLUDE_ITEM, ExcludeList);
-        if (YoriLibDoesFileMatchExpression(RelativeSourcePath, &ExcludeItem->ExcludeCriteria)) {
+        if (YoriLibDoesFileMatchCompiledExpression(RelativeSourcePath, &ExcludeItem->CompiledCriteria)) {
             return TRUE;
         }
         ListEntry = YoriLibGetNextListEntry(&CopyContext->ExcludeList, ListEntry);
@@ -553,6 +689,342 @@ CopyAsLink(
     return TRUE;
 }
 
+/**
+ Copy data by opening the source and destination for unbuffered overlapped
+ IO, keeping several reads and writes in flight.  This only applies to
+ objects on disk, so other objects such as the console are not handled
+ here.
+
+ @param CopyContext Pointer to the copy context, specifying device size and
+        buffers to use.
+
+ @param SourceFile Pointer to the source file/device name.
+
+ @param DestFile Pointer to the destination file/device name.
+
+ @param CopySucceeded On successful completion, set to TRUE if the data was
+        copied, or FALSE if the copy failed.  Failures are displayed by this
+        function.
+
+ @return TRUE to indicate the copy was attempted, or FALSE if the objects
+         could not be opened for unbuffered IO and another method should be
+         used.
+ */
+__success(return)
+BOOL
+CopyAsUnbufferedDataMove(
+    __in PCOPY_CONTEXT CopyContext,
+    __in PYORI_STRING SourceFile,
+    __in PYORI_STRING DestFile,
+    __out PBOOL CopySucceeded
+    )
+{
+    YORI_LIB_COPY_DATA_PARAMS Params;
+    HANDLE SourceHandle;
+    HANDLE DestHandle;
+    DWORD LastError;
+    LPTSTR ErrText;
+
+    SourceHandle = CreateFile(SourceFile->StartOfString,
+                              GENERIC_READ,
+                              FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                              NULL,
+                              OPEN_EXISTING,
+                              FILE_FLAG_OPEN_NO_RECALL|FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_NO_BUFFERING|FILE_FLAG_OVERLAPPED,
+                              NULL);
+
+    if (SourceHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    if (GetFileType(SourceHandle) != FILE_TYPE_DISK) {
+        CloseHandle(SourceHandle);
+        return FALSE;
+    }
+
+    DestHandle = CreateFile(DestFile->StartOfString,
+                            GENERIC_WRITE,
+                            FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                            NULL,
+                            CREATE_ALWAYS,
+                            FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_NO_BUFFERING|FILE_FLAG_OVERLAPPED,
+                            NULL);
+
+    if (DestHandle == INVALID_HANDLE_VALUE && GetLastError() == ERROR_INVALID_PARAMETER) {
+        DestHandle = CreateFile(DestFile->StartOfString,
+                                GENERIC_WRITE,
+                                FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                                NULL,
+                                OPEN_EXISTING,
+                                FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_NO_BUFFERING|FILE_FLAG_OVERLAPPED,
+                                NULL);
+    }
+
+    if (DestHandle == INVALID_HANDLE_VALUE) {
+        CloseHandle(SourceHandle);
+        return FALSE;
+    }
+
+    if (GetFileType(DestHandle) != FILE_TYPE_DISK) {
+        CloseHandle(SourceHandle);
+        CloseHandle(DestHandle);
+        return FALSE;
+    }
+
+    ZeroMemory(&Params, sizeof(Params));
+    Params.BufferCount = CopyContext->UnbufferedBufferCount;
+    Params.BufferSize = CopyContext->UnbufferedBufferSize;
+    Params.MaximumLength.QuadPart = CopyContext->DeviceSize.QuadPart;
+    Params.ComputeDigest = CopyContext->Verify;
+
+    LastError = YoriLibCopyFileData(SourceHandle, DestHandle, &Params);
+    CloseHandle(SourceHandle);
+    CloseHandle(DestHandle);
+
+    if (LastError != ERROR_SUCCESS) {
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Copy of data failed: %y to %y: %s"), SourceFile, DestFile, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        *CopySucceeded = FALSE;
+        return TRUE;
+    }
+
+    if (CopyContext->Verbose) {
+        YORI_STRING SizeString;
+        YORI_STRING RateString;
+        TCHAR SizeStringBuffer[6];
+        TCHAR RateStringBuffer[6];
+        LARGE_INTEGER Rate;
+        LONGLONG Milliseconds;
+
+        YoriLibInitEmptyString(&SizeString);
+        SizeString.StartOfString = SizeStringBuffer;
+        SizeString.LengthAllocated = sizeof(SizeStringBuffer)/sizeof(SizeStringBuffer[0]);
+
+        YoriLibInitEmptyString(&RateString);
+        RateString.StartOfString = RateStringBuffer;
+        RateString.LengthAllocated = sizeof(RateStringBuffer)/sizeof(RateStringBuffer[0]);
+
+        Milliseconds = Params.ElapsedTime.QuadPart / (10 * 1000);
+        if (Milliseconds == 0) {
+            Milliseconds = 1;
+        }
+        Rate.QuadPart = Params.BytesCopied.QuadPart * 1000 / Milliseconds;
+
+        YoriLibFileSizeToString(&SizeString, &Params.BytesCopied);
+        YoriLibFileSizeToString(&RateString, &Rate);
+        if (Params.Cloned) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Cloned %y in %lli ms\n"), &SizeString, Milliseconds);
+        } else if (Params.Sparse) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Copied %y of allocated ranges in %lli ms, %y/s\n"), &SizeString, Milliseconds, &RateString);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Copied %y in %lli ms, %y/s\n"), &SizeString, Milliseconds, &RateString);
+        }
+    }
+
+    if (CopyContext->Verify &&
+        !CopyVerifyUnbufferedDataMove(CopyContext, SourceFile, DestFile, &Params)) {
+
+        InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&CopyContext->VerifyFailures);
+        *CopySucceeded = FALSE;
+        return TRUE;
+    }
+
+    *CopySucceeded = TRUE;
+    return TRUE;
+}
+
+/**
+ Verify data copied by YoriLibCopyFileData by reading the destination and
+ comparing its digest against the digest calculated while the data was
+ copied.  If the data was cloned, no digest was calculated, so the source is
+ read as well.  The destination is read with unbuffered IO, so the data
+ compared is the data on the storage rather than in the cache.
+
+ @param CopyContext Pointer to the copy context, specifying the buffer size.
+
+ @param SourceFile Pointer to the source file/device name.
+
+ @param DestFile Pointer to the destination file/device name.
+
+ @param Params Pointer to the parameters of the completed copy.
+
+ @return TRUE if the destination matches, FALSE if it does not or could not
+         be read.  Failures are displayed by this function.
+ */
+BOOL
+CopyVerifyUnbufferedDataMove(
+    __in PCOPY_CONTEXT CopyContext,
+    __in PYORI_STRING SourceFile,
+    __in PYORI_STRING DestFile,
+    __in PYORI_LIB_COPY_DATA_PARAMS Params
+    )
+{
+    HANDLE FileHandle;
+    DWORDLONG ExpectedDigest;
+    DWORDLONG ActualDigest;
+    LARGE_INTEGER Length;
+    DWORD LastError;
+    LPTSTR ErrText;
+
+    ActualDigest = 0;
+    ExpectedDigest = Params->Digest;
+    Length.QuadPart = Params->DigestLength.QuadPart;
+
+    if (!Params->DigestComputed) {
+        FileHandle = CreateFile(SourceFile->StartOfString,
+                                GENERIC_READ,
+                                FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                                NULL,
+                                OPEN_EXISTING,
+                                FILE_FLAG_OPEN_NO_RECALL|FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_NO_BUFFERING,
+                                NULL);
+
+        if (FileHandle == INVALID_HANDLE_VALUE) {
+            LastError = GetLastError();
+        } else {
+            Length.QuadPart = Params->BytesCopied.QuadPart;
+            LastError = YoriLibCopyDataComputeDigest(FileHandle, &Params->SourceOffset, &Length, CopyContext->UnbufferedBufferSize, &ExpectedDigest);
+            CloseHandle(FileHandle);
+        }
+
+        if (LastError != ERROR_SUCCESS) {
+            ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Verify failed reading source: %y: %s"), SourceFile, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            return FALSE;
+        }
+    }
+
+    FileHandle = CreateFile(DestFile->StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_NO_BUFFERING,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        LastError = GetLastError();
+    } else {
+        LastError = YoriLibCopyDataComputeDigest(FileHandle, &Params->DestOffset, &Length, CopyContext->UnbufferedBufferSize, &ActualDigest);
+        CloseHandle(FileHandle);
+    }
+
+    if (LastError != ERROR_SUCCESS) {
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Verify failed reading destination: %y: %s"), DestFile, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    if (ActualDigest != ExpectedDigest) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Verify failed: %y does not match %y\n"), DestFile, SourceFile);
+        return FALSE;
+    }
+
+    if (CopyContext->Verbose) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Verified %y, digest %016llx\n"), DestFile, ActualDigest);
+    }
+
+    return TRUE;
+}
+
+/**
+ Verify data copied by the single buffer fallback in CopyAsDumbDataMove by
+ reading the source and destination again with buffered IO and comparing
+ their digests.
+
+ @param SourceFile Pointer to the source file/device name.
+
+ @param DestFile Pointer to the destination file/device name.
+
+ @param Length The number of bytes copied from the source.
+
+ @return TRUE if the destination matches, FALSE if it does not or could not
+         be read.  Failures are displayed by this function.
+ */
+BOOL
+CopyVerifyDumbDataMove(
+    __in PYORI_STRING SourceFile,
+    __in PYORI_STRING DestFile,
+    __in LONGLONG Length
+    )
+{
+    HANDLE FileHandle;
+    DWORDLONG ExpectedDigest;
+    DWORDLONG ActualDigest;
+    LARGE_INTEGER Offset;
+    LARGE_INTEGER RangeLength;
+    DWORD LastError;
+    LPTSTR ErrText;
+
+    //
+    //  A length of zero means read to the end of the file, so an empty copy
+    //  is checked here.
+    //
+
+    if (Length == 0) {
+        return TRUE;
+    }
+
+    Offset.QuadPart = 0;
+    RangeLength.QuadPart = Length;
+    ExpectedDigest = 0;
+    ActualDigest = 0;
+
+    FileHandle = CreateFile(SourceFile->StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_FLAG_OPEN_NO_RECALL|FILE_FLAG_BACKUP_SEMANTICS,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        LastError = GetLastError();
+    } else {
+        LastError = YoriLibCopyDataComputeDigest(FileHandle, &Offset, &RangeLength, 0, &ExpectedDigest);
+        CloseHandle(FileHandle);
+    }
+
+    if (LastError != ERROR_SUCCESS) {
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Verify failed reading source: %y: %s"), SourceFile, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    FileHandle = CreateFile(DestFile->StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_FLAG_BACKUP_SEMANTICS,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        LastError = GetLastError();
+    } else {
+        LastError = YoriLibCopyDataComputeDigest(FileHandle, &Offset, &RangeLength, 0, &ActualDigest);
+        CloseHandle(FileHandle);
+    }
+
+    if (LastError != ERROR_SUCCESS) {
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Verify failed reading destination: %y: %s"), DestFile, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    if (ActualDigest != ExpectedDigest) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Verify failed: %y does not match %y\n"), DestFile, SourceFile);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  For objects that are not really files, copy can't use CopyFile, and instead
  falls back to this stupid thing of reading and writing.  Note this path
@@ -583,6 +1055,19 @@ CopyAsDumbDataMove(
     DWORD LastError;
     LPTSTR ErrText;
     LONGLONG TotalBytesCopied;
+    LONGLONG DataBytesCopied;
+    BOOL CopySucceeded;
+    DWORD SourceFileType;
+
+    //
+    //  Objects on disk can be copied with several reads and writes in
+    //  flight, which is much faster for large files and devices.  Other
+    //  objects use a single buffer.
+    //
+
+    if (CopyAsUnbufferedDataMove(CopyContext, SourceFile, DestFile, &CopySucceeded)) {
+        return CopySucceeded;
+    }
 
     SourceHandle = CreateFile(SourceFile->StartOfString,
                               GENERIC_READ,
@@ -600,6 +1085,8 @@ CopyAsDumbDataMove(
         return FALSE;
     }
 
+    SourceFileType = GetFileType(SourceHandle) & ~(FILE_TYPE_REMOTE);
+
     DestHandle = CreateFile(DestFile->StartOfString,
                             GENERIC_WRITE,
                             FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
@@ -646,6 +1133,7 @@ CopyAsDumbDataMove(
     }
 
     TotalBytesCopied = 0;
+    DataBytesCopied = 0;
 
     while (ReadFile(SourceHandle, Buffer, BufferSize, &BytesCopied, NULL)) {
         if (BytesCopied == 0) {
@@ -658,6 +1146,7 @@ CopyAsDumbDataMove(
             BytesCopied = (DWORD)(CopyContext->DeviceSize.QuadPart - TotalBytesCopied);
 
         }
+        DataBytesCopied = DataBytesCopied + BytesCopied;
 
         //
         //  If the destination has a sector size requirement, round up to the
@@ -702,6 +1191,31 @@ CopyAsDumbDataMove(
     YoriLibFree(Buffer);
     CloseHandle(SourceHandle);
     CloseHandle(DestHandle);
+
+    //
+    //  If verification was requested, check the data here too.  A source
+    //  that is not on disk can't be read again, so the copy can't be
+    //  verified, and this is reported as a failure rather than silently
+    //  succeeding.
+    //
+
+    if (CopyContext->Verify) {
+        if (SourceFileType != FILE_TYPE_DISK) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Verify not possible: %y cannot be read again, %y was not verified\n"), SourceFile, DestFile);
+            InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&CopyContext->VerifyFailures);
+            return FALSE;
+        }
+
+        if (!CopyVerifyDumbDataMove(SourceFile, DestFile, DataBytesCopied)) {
+            InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&CopyContext->VerifyFailures);
+            return FALSE;
+        }
+
+        if (CopyContext->Verbose) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Verified %y\n"), DestFile);
+        }
+    }
+
     return TRUE;
 }
 
@@ -749,68 +1263,50 @@ CopyTimestamps(
 }
 
 /**
- A callback that is invoked when a file is found that matches a search criteria
- specified in the set of strings to enumerate.
+ Copy a single object to the destination, unless it is excluded.  This is
+ called on the main thread, or on a worker thread when copying files in
+ parallel.
 
- @param FilePath Pointer to the file path that was found.
+ @param CopyContext Pointer to a context block specifying the destination of
+        the copy, indicating parameters to the copy operation, and tracking
+        how many objects have been copied.
+
+ @param FilePath Pointer to the source path, which must be NULL terminated.
+
+ @param RelativePathOffset The offset in characters within FilePath of the
+        path relative to the root of the source.
 
  @param FileInfo Information about the file.  This can be NULL if the file was
         not found from enumeration, since the file may not be a file system
         object (ie., it may be a device.)
 
- @param Depth Indicates the recursion depth.  Used by copy to check if it
-        needs to create new directories in the destination path.
-
- @param Context Pointer to a context block specifying the destination of the
-        copy, indicating parameters to the copy operation, and tracking how
-        many objects have been copied.
-
- @return TRUE to continute enumerating, FALSE to abort.
+ @return TRUE to indicate the object was processed, FALSE to indicate a
+         failure that should abort enumeration.
  */
 BOOL
-CopyFileFoundCallback(
+CopyProcessObject(
+    __in PCOPY_CONTEXT CopyContext,
     __in PYORI_STRING FilePath,
-    __in_opt PWIN32_FIND_DATA FileInfo,
-    __in DWORD Depth,
-    __in PVOID Context
+    __in YORI_ALLOC_SIZE_T RelativePathOffset,
+    __in_opt PWIN32_FIND_DATA FileInfo
     )
 {
-    PCOPY_CONTEXT CopyContext = (PCOPY_CONTEXT)Context;
     YORI_STRING RelativePathFromSource;
     YORI_STRING FullDest;
     YORI_STRING HumanSourcePath;
     YORI_STRING HumanDestPath;
     PYORI_STRING SourceNameToDisplay;
     PYORI_STRING DestNameToDisplay;
-    YORI_ALLOC_SIZE_T SlashesFound;
-    YORI_ALLOC_SIZE_T Index;
     DWORD LastError;
 
-    CopyContext->FilesFoundThisArg++;
-
-    ASSERT(YoriLibIsStringNullTerminated(FilePath));
-
     YoriLibInitEmptyString(&FullDest);
     YoriLibInitEmptyString(&RelativePathFromSource);
     YoriLibInitEmptyString(&HumanSourcePath);
     YoriLibInitEmptyString(&HumanDestPath);
     SourceNameToDisplay = FilePath;
 
-    SlashesFound = 0;
-    for (Index = FilePath->LengthInChars; Index > 0; Index--) {
-        if (FilePath->StartOfString[Index - 1] == '\\') {
-            SlashesFound++;
-            if (SlashesFound == Depth + 1) {
-                break;
-            }
-        }
-    }
-
-    ASSERT(Index > 0);
-    ASSERT(SlashesFound == Depth + 1);
-
-    RelativePathFromSource.StartOfString = &FilePath->StartOfString[Index];
-    RelativePathFromSource.LengthInChars = FilePath->LengthInChars - Index;
+    RelativePathFromSource.StartOfString = &FilePath->StartOfString[RelativePathOffset];
+    RelativePathFromSource.LengthInChars = FilePath->LengthInChars - RelativePathOffset;
 
     //
     //  Check if the user wanted to exclude this file
@@ -881,6 +1377,12 @@ CopyFileFoundCallback(
             }
         } else if (CopyContext->DestinationIsDevice || YoriLibIsFileNameDeviceName(FilePath)) {
             CopyAsDumbDataMove(CopyContext, FilePath, &FullDest);
+        } else if (CopyContext->Unbuffered) {
+            if (CopyAsDumbDataMove(CopyContext, FilePath, &FullDest) &&
+                CopyContext->CompressDest) {
+
+                YoriLibCompressFileInBackground(&CopyContext->CompressContext, &FullDest);
+            }
         } else {
             LastError = YoriLibCopyFile(FilePath, &FullDest);
             if (LastError != ERROR_SUCCESS) {
@@ -922,13 +1424,282 @@ CopyFileFoundCallback(
         CopyTimestamps(FileInfo, &FullDest);
     }
 
-    CopyContext->FilesCopied++;
+    InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&CopyContext->FilesCopied);
     YoriLibFreeStringContents(&FullDest);
     YoriLibFreeStringContents(&HumanSourcePath);
     YoriLibFreeStringContents(&HumanDestPath);
     return TRUE;
 }
 
+/**
+ A worker thread that copies queued files until told to exit.
+
+ @param Context Pointer to the copy context.
+
+ @return Thread exit code, which is always zero.
+ */
+DWORD WINAPI
+CopyWorkerThread(
+    __in LPVOID Context
+    )
+{
+    PCOPY_CONTEXT CopyContext;
+    PYORI_LIST_ENTRY ListEntry;
+    PCOPY_JOB Job;
+
+    CopyContext = (PCOPY_CONTEXT)Context;
+
+    while (TRUE) {
+        WaitForSingleObject(CopyContext->Mutex, INFINITE);
+        ListEntry = YoriLibGetNextListEntry(&CopyContext->JobList, NULL);
+        if (ListEntry != NULL) {
+            YoriLibRemoveListItem(ListEntry);
+            ReleaseMutex(CopyContext->Mutex);
+
+            Job = CONTAINING_RECORD(ListEntry, COPY_JOB, ListEntry);
+            CopyProcessObject(CopyContext, &Job->FilePath, Job->RelativePathOffset, &Job->FileInfo);
+            YoriLibFree(Job);
+
+            WaitForSingleObject(CopyContext->Mutex, INFINITE);
+            CopyContext->JobsQueued--;
+            ReleaseMutex(CopyContext->Mutex);
+            SetEvent(CopyContext->JobCompleteEvent);
+            continue;
+        }
+
+        if (CopyContext->Shutdown) {
+            ReleaseMutex(CopyContext->Mutex);
+            break;
+        }
+
+        ResetEvent(CopyContext->WorkAvailableEvent);
+        ReleaseMutex(CopyContext->Mutex);
+        WaitForSingleObject(CopyContext->WorkAvailableEvent, INFINITE);
+    }
+
+    return 0;
+}
+
+/**
+ Queue a file to be copied by a worker thread.  If too many files are
+ already queued, this waits for workers to complete some of them.
+
+ @param CopyContext Pointer to the copy context.
+
+ @param FilePath Pointer to the full path to the source file.
+
+ @param RelativePathOffset The offset in characters within FilePath of the
+        path relative to the root of the source.
+
+ @param FileInfo Information about the file from enumeration.
+
+ @return TRUE to indicate the file was queued, FALSE to indicate failure.
+ */
+BOOL
+CopyQueueFile(
+    __in PCOPY_CONTEXT CopyContext,
+    __in PYORI_STRING FilePath,
+    __in YORI_ALLOC_SIZE_T RelativePathOffset,
+    __in PWIN32_FIND_DATA FileInfo
+    )
+{
+    PCOPY_JOB Job;
+
+    Job = YoriLibMalloc(sizeof(COPY_JOB) + (FilePath->LengthInChars + 1) * sizeof(TCHAR));
+    if (Job == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Job->FilePath);
+    Job->FilePath.StartOfString = (LPTSTR)(Job + 1);
+    Job->FilePath.LengthInChars = FilePath->LengthInChars;
+    Job->FilePath.LengthAllocated = FilePath->LengthInChars + 1;
+    memcpy(Job->FilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    Job->FilePath.StartOfString[FilePath->LengthInChars] = '\0';
+    Job->RelativePathOffset = RelativePathOffset;
+    memcpy(&Job->FileInfo, FileInfo, sizeof(WIN32_FIND_DATA));
+
+    while (TRUE) {
+        WaitForSingleObject(CopyContext->Mutex, INFINITE);
+        if (CopyContext->JobsQueued < CopyContext->MaximumJobsQueued) {
+            break;
+        }
+        ReleaseMutex(CopyContext->Mutex);
+        WaitForSingleObject(CopyContext->JobCompleteEvent, INFINITE);
+    }
+
+    YoriLibAppendList(&CopyContext->JobList, &Job->ListEntry);
+    CopyContext->JobsQueued++;
+    ReleaseMutex(CopyContext->Mutex);
+    SetEvent(CopyContext->WorkAvailableEvent);
+    return TRUE;
+}
+
+/**
+ Wait for all queued files to be copied and terminate worker threads.
+
+ @param CopyContext Pointer to the copy context.
+ */
+VOID
+CopyStopWorkers(
+    __in PCOPY_CONTEXT CopyContext
+    )
+{
+    DWORD Index;
+
+    if (CopyContext->Workers != NULL) {
+        WaitForSingleObject(CopyContext->Mutex, INFINITE);
+        CopyContext->Shutdown = TRUE;
+        ReleaseMutex(CopyContext->Mutex);
+        SetEvent(CopyContext->WorkAvailableEvent);
+
+        for (Index = 0; Index < CopyContext->WorkerCount; Index++) {
+            WaitForSingleObject(CopyContext->Workers[Index], INFINITE);
+            CloseHandle(CopyContext->Workers[Index]);
+        }
+        YoriLibFree(CopyContext->Workers);
+        CopyContext->Workers = NULL;
+    }
+    CopyContext->WorkerCount = 0;
+
+    if (CopyContext->Mutex != NULL) {
+        CloseHandle(CopyContext->Mutex);
+        CopyContext->Mutex = NULL;
+    }
+
+    if (CopyContext->WorkAvailableEvent != NULL) {
+        CloseHandle(CopyContext->WorkAvailableEvent);
+        CopyContext->WorkAvailableEvent = NULL;
+    }
+
+    if (CopyContext->JobCompleteEvent != NULL) {
+        CloseHandle(CopyContext->JobCompleteEvent);
+        CopyContext->JobCompleteEvent = NULL;
+    }
+}
+
+/**
+ Start worker threads to copy files in parallel.  If the threads cannot be
+ started, files are copied by the main thread.
+
+ @param CopyContext Pointer to the copy context.
+
+ @param WorkerCount The number of worker threads to start.
+ */
+VOID
+CopyStartWorkers(
+    __in PCOPY_CONTEXT CopyContext,
+    __in DWORD WorkerCount
+    )
+{
+    DWORD Index;
+    DWORD ThreadId;
+
+    YoriLibInitializeListHead(&CopyContext->JobList);
+    CopyContext->JobsQueued = 0;
+    CopyContext->MaximumJobsQueued = WorkerCount * COPY_JOBS_PER_WORKER;
+    CopyContext->Shutdown = FALSE;
+
+    CopyContext->Mutex = CreateMutex(NULL, FALSE, NULL);
+    CopyContext->WorkAvailableEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    CopyContext->JobCompleteEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    CopyContext->Workers = YoriLibMalloc(WorkerCount * sizeof(HANDLE));
+
+    if (CopyContext->Mutex == NULL ||
+        CopyContext->WorkAvailableEvent == NULL ||
+        CopyContext->JobCompleteEvent == NULL ||
+        CopyContext->Workers == NULL) {
+
+        if (CopyContext->Workers != NULL) {
+            YoriLibFree(CopyContext->Workers);
+            CopyContext->Workers = NULL;
+        }
+        CopyStopWorkers(CopyContext);
+        return;
+    }
+
+    for (Index = 0; Index < WorkerCount; Index++) {
+        CopyContext->Workers[Index] = CreateThread(NULL, 0, CopyWorkerThread, CopyContext, 0, &ThreadId);
+        if (CopyContext->Workers[Index] == NULL) {
+            break;
+        }
+        CopyContext->WorkerCount++;
+    }
+
+    if (CopyContext->WorkerCount == 0) {
+        YoriLibFree(CopyContext->Workers);
+        CopyContext->Workers = NULL;
+        CopyStopWorkers(CopyContext);
+    }
+}
+
+/**
+ A callback that is invoked when a file is found that matches a search criteria
+ specified in the set of strings to enumerate.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.  This can be NULL if the file was
+        not found from enumeration, since the file may not be a file system
+        object (ie., it may be a device.)
+
+ @param Depth Indicates the recursion depth.  Used by copy to check if it
+        needs to create new directories in the destination path.
+
+ @param Context Pointer to a context block specifying the destination of the
+        copy, indicating parameters to the copy operation, and tracking how
+        many objects have been copied.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+CopyFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in_opt PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PCOPY_CONTEXT CopyContext = (PCOPY_CONTEXT)Context;
+    YORI_ALLOC_SIZE_T SlashesFound;
+    YORI_ALLOC_SIZE_T Index;
+
+    CopyContext->FilesFoundThisArg++;
+
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+
+    SlashesFound = 0;
+    for (Index = FilePath->LengthInChars; Index > 0; Index--) {
+        if (FilePath->StartOfString[Index - 1] == '\\') {
+            SlashesFound++;
+            if (SlashesFound == Depth + 1) {
+                break;
+            }
+        }
+    }
+
+    ASSERT(Index > 0);
+    ASSERT(SlashesFound == Depth + 1);
+
+    //
+    //  Directories are returned before their contents, and are created
+    //  here so that the destination tree exists before any file within it
+    //  is queued.  Links being copied as links and devices are also handled
+    //  here, leaving workers to copy regular files.
+    //
+
+    if (CopyContext->WorkerCount > 0 &&
+        FileInfo != NULL &&
+        (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 &&
+        ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0 || !CopyContext->CopyAsLinks) &&
+        !CopyContext->DestinationIsDevice) {
+
+        return CopyQueueFile(CopyContext, FilePath, Index, FileInfo);
+    }
+
+    return CopyProcessObject(CopyContext, FilePath, Index, FileInfo);
+}
+
 /**
  Free the structures allocated within a copy context.  The structure itself
  is on the stack and is not freed.  This will wait for any outstanding
@@ -941,6 +1712,7 @@ CopyFreeCopyContext(
     __in PCOPY_CONTEXT CopyContext
     )
 {
+    CopyStopWorkers(CopyContext);
     YoriLibFreeCompressContext(&CopyContext->CompressContext);
     YoriLibFreeStringContents(&CopyContext->Dest);
     CopyFreeExcludes(CopyContext);
@@ -987,8 +1759,12 @@ ENTRYPOINT(
     COPY_CONTEXT CopyContext;
     YORILIB_COMPRESS_ALGORITHM CompressionAlgorithm;
     YORI_STRING Arg;
+    DWORD WorkerCount;
+    YORI_MAX_SIGNED_T llTemp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
 
     FileCount = 0;
+    WorkerCount = 0;
     Recursive = FALSE;
     BasicEnumeration = FALSE;
     ZeroMemory(&CopyContext, sizeof(CopyContext));
@@ -1050,6 +1826,20 @@ ENTRYPOINT(
                 CompressionAlgorithm.WofAlgorithm = FILE_PROVIDER_COMPRESSION_XPRESS16K;
                 CopyContext.CompressDest = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (i + 1 < ArgC) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], FALSE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        llTemp > 0) {
+
+                        WorkerCount = COPY_MAX_WORKERS;
+                        if (llTemp < COPY_MAX_WORKERS) {
+                            WorkerCount = (DWORD)llTemp;
+                        }
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
                 CopyContext.CopyAsLinks = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -1079,9 +1869,41 @@ ENTRYPOINT(
                 CopyContext.CopyTimestamps = TRUE;
                 CopyContext.SkipDataCopy = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("u")) == 0) {
+                CopyContext.Unbuffered = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("uc")) == 0) {
+                if (i + 1 < ArgC) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], FALSE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        llTemp > 0) {
+
+                        CopyContext.UnbufferedBufferCount = (DWORD)llTemp;
+                        if (llTemp > MAXIMUM_WAIT_OBJECTS) {
+                            CopyContext.UnbufferedBufferCount = MAXIMUM_WAIT_OBJECTS;
+                        }
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("us")) == 0) {
+                if (i + 1 < ArgC) {
+                    LARGE_INTEGER BufferSize;
+                    YoriLibStringToFileSize(&ArgV[i + 1], &BufferSize);
+                    CopyContext.UnbufferedBufferSize = YORI_LIB_COPY_DATA_MAXIMUM_BUFFER_SIZE;
+                    if (BufferSize.QuadPart < YORI_LIB_COPY_DATA_MAXIMUM_BUFFER_SIZE) {
+                        CopyContext.UnbufferedBufferSize = BufferSize.LowPart;
+                    }
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("v")) == 0) {
                 CopyContext.Verbose = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("verify")) == 0) {
+                CopyContext.Unbuffered = TRUE;
+                CopyContext.Verify = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("x")) == 0) {
                 if (i + 1 < ArgC) {
                     CopyAddExclude(&CopyContext, &ArgV[i + 1]);
@@ -1171,6 +1993,17 @@ ENTRYPOINT(
     CopyContext.FilesCopied = 0;
     FilesProcessed = 0;
 
+    //
+    //  Copying small files is dominated by per file latency, so when
+    //  requested, copy several at once.  This only makes sense when the
+    //  destination is a directory, since copying multiple files to a
+    //  single file is an error.
+    //
+
+    if (WorkerCount > 1 && (CopyContext.DestAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        CopyStartWorkers(&CopyContext, WorkerCount);
+    }
+
     for (i = FirstFileArg; i <= LastFileArg; i++) {
         if (!YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
 
@@ -1222,6 +2055,8 @@ ENTRYPOINT(
         }
     }
 
+    CopyStopWorkers(&CopyContext);
+
     Result = EXIT_SUCCESS;
 
     if (CopyContext.FilesCopied == 0) {
@@ -1229,6 +2064,11 @@ ENTRYPOINT(
         Result = EXIT_FAILURE;
     }
 
+    if (CopyContext.VerifyFailures != 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("copy: %i files were not verified\n"), CopyContext.VerifyFailures);
+        Result = EXIT_FAILURE;
+    }
+
     CopyFreeCopyContext(&CopyContext);
 
     return Result;
@@ -36,8 +36,10 @@ CHAR strCshotHelpText[] =
         "Captures previous output on the console and outputs to standard output.\n"
         "\n"
         "CSHOT [-license] [-s num] [-c num]\n"
+        "CSHOT [-license] -p ms\n"
         "\n"
         "   -c             The number of lines to capture\n"
+        "   -p             Capture the window periodically, outputting only changes\n"
         "   -s             The number of lines to skip\n";
 
 /**
@@ -54,6 +56,66 @@ CshotHelp(VOID)
     return TRUE;
 }
 
+/**
+ Capture the visible console window periodically and output the changes
+ since the previous capture as VT sequences, until cancelled.
+
+ @param Interval Specifies the number of milliseconds between captures.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+CshotCapturePeriodically(
+    __in DWORD Interval
+    )
+{
+    YORILIB_CONSOLE_SNAPSHOT Snapshot;
+    HANDLE hConsole;
+    HANDLE hTarget;
+    HANDLE CancelHandle;
+    DWORD CurrentMode;
+    BOOL Result;
+
+    //
+    //  Writing changes to the console being captured would change it, so
+    //  output must be going somewhere else.
+    //
+
+    hTarget = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (GetConsoleMode(hTarget, &CurrentMode)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("cshot: periodic capture requires output to be redirected\n"));
+        return FALSE;
+    }
+
+    hConsole = CreateFile(_T("CONOUT$"), GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+    if (hConsole == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    YoriLibInitializeConsoleSnapshot(&Snapshot);
+    CancelHandle = YoriLibCancelGetEvent();
+    Result = TRUE;
+
+    while (TRUE) {
+        if (!YoriLibRewriteConsoleChanges(hConsole, hTarget, &Snapshot)) {
+            Result = FALSE;
+            break;
+        }
+
+        if (CancelHandle != NULL) {
+            if (WaitForSingleObject(CancelHandle, Interval) == WAIT_OBJECT_0) {
+                break;
+            }
+        } else {
+            Sleep(Interval);
+        }
+    }
+
+    YoriLibCleanupConsoleSnapshot(&Snapshot);
+    CloseHandle(hConsole);
+    return Result;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the cshot builtin command.
@@ -85,6 +147,7 @@ ENTRYPOINT(
     BOOLEAN ArgumentUnderstood;
     YORI_ALLOC_SIZE_T SkipCount = 0;
     YORI_ALLOC_SIZE_T LineCount = 0;
+    DWORD Interval = 0;
     YORI_ALLOC_SIZE_T i;
     YORI_STRING Arg;
     YORI_MAX_SIGNED_T Temp;
@@ -112,6 +175,14 @@ ENTRYPOINT(
                         i++;
                     }
                 }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("p")) == 0) {
+                if (ArgC > i + 1) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &Temp, &CharsConsumed) && Temp > 0) {
+                        Interval = (DWORD)Temp;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 if (ArgC > i + 1) {
                     if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &Temp, &CharsConsumed)) {
@@ -128,6 +199,16 @@ ENTRYPOINT(
         }
     }
 
+    if (Interval != 0) {
+#if YORI_BUILTIN
+        YoriLibCancelEnable(FALSE);
+#endif
+        if (!CshotCapturePeriodically(Interval)) {
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
     if (!YoriLibRewriteConsoleContents(GetStdHandle(STD_OUTPUT_HANDLE), LineCount, SkipCount)) {
         return EXIT_FAILURE;
     }
@@ -26,7 +26,6 @@
 
 #include <yoripch.h>
 #include <yorilib.h>
-#include <remimu.hxx>
 
 /**
  Help text to display to the user.
@@ -111,6 +110,18 @@ typedef struct _CUT_CONTEXT {
      */
     LPTSTR FieldSeperator;
 
+    /**
+     A bitmap of characters below 0x100 which are in FieldSeperator, so each
+     character in a line can be checked without searching the string.
+     */
+    DWORD SeperatorMap[0x100 / 32];
+
+    /**
+     TRUE if FieldSeperator contains any character which is not described
+     by SeperatorMap.
+     */
+    BOOLEAN WideSeperators;
+
     /**
      The first error encountered when enumerating objects from a single arg.
      This is used to preserve file not found/path not found errors so that
@@ -152,13 +163,86 @@ typedef struct _CUT_CONTEXT {
     DWORD EncodingToUse;
 
     /**
-     Regex tokens.
+     The compiled regular expression.
      */
-    RegexToken tokens[1024];
-    int16_t token_count;
+    YORI_LIB_REGEX Regex;
 
 } CUT_CONTEXT, *PCUT_CONTEXT;
 
+/**
+ The number of characters to buffer before writing output, when writing the
+ results from a file.
+ */
+#define CUT_OUTPUT_BUFFER_SIZE (64 * 1024)
+
+/**
+ Record the set of field delimiting characters in a bitmap, so each
+ character in a line can be checked against the set in constant time.
+
+ @param CutContext The context that describes the actions to perform.
+ */
+VOID
+CutBuildSeperatorMap(
+    __inout PCUT_CONTEXT CutContext
+    )
+{
+    LPTSTR Seperator;
+    TCHAR Char;
+
+    ZeroMemory(CutContext->SeperatorMap, sizeof(CutContext->SeperatorMap));
+    CutContext->WideSeperators = FALSE;
+    for (Seperator = CutContext->FieldSeperator; *Seperator != '\0'; Seperator++) {
+        Char = *Seperator;
+        if (Char < 0x100) {
+            CutContext->SeperatorMap[Char / 32] |= ((DWORD)1 << (Char % 32));
+        } else {
+            CutContext->WideSeperators = TRUE;
+        }
+    }
+}
+
+/**
+ Count the number of characters in a string before the first field
+ delimiting character.
+
+ @param CutContext The context that describes the actions to perform.
+
+ @param String The string to search.
+
+ @return The number of characters before the first delimiter, or the length
+         of the string if it contains no delimiter.
+ */
+YORI_ALLOC_SIZE_T
+CutCountCharsBeforeSeperator(
+    __in PCUT_CONTEXT CutContext,
+    __in PYORI_STRING String
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    LPTSTR Seperator;
+    TCHAR Char;
+
+    for (Index = 0; Index < String->LengthInChars; Index++) {
+        Char = String->StartOfString[Index];
+        if (Char < 0x100) {
+            if (CutContext->SeperatorMap[Char / 32] & ((DWORD)1 << (Char % 32))) {
+                break;
+            }
+        } else if (CutContext->WideSeperators) {
+            for (Seperator = CutContext->FieldSeperator; *Seperator != '\0'; Seperator++) {
+                if (*Seperator == Char) {
+                    break;
+                }
+            }
+            if (*Seperator != '\0') {
+                break;
+            }
+        }
+    }
+
+    return Index;
+}
+
 /**
  Process an incoming stream from a single handle in line mode, applying the
  user requested actions.
@@ -178,9 +262,14 @@ CutProcessHandleLines(
     YORI_STRING MatchingSubset;
     PVOID LineContext = NULL;
     YORI_STRING LineString;
+    YORI_STRING LowerString;
+    YORI_STRING OutputBuffer;
     YORI_ALLOC_SIZE_T DesiredOffset;
     YORI_ALLOC_SIZE_T ReverseOffset;
     YORI_ALLOC_SIZE_T DesiredLength;
+    HANDLE hOut;
+    char *text;
+    int cbtextallocated;
 
     //
     //  Truncate the desired offset and length to 32 bits.  The line
@@ -193,6 +282,21 @@ CutProcessHandleLines(
     DesiredLength = (YORI_ALLOC_SIZE_T)CutContext->DesiredLength;
 
     YoriLibInitEmptyString(&LineString);
+    YoriLibInitEmptyString(&LowerString);
+    YoriLibInitEmptyString(&OutputBuffer);
+    text = NULL;
+    cbtextallocated = 0;
+
+    //
+    //  When the input is a file, it's not expected to arrive incrementally,
+    //  so output can be buffered and written in large blocks.  This fails
+    //  gracefully by writing each line as it is found.
+    //
+
+    hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (GetFileType(hSource) == FILE_TYPE_DISK) {
+        YoriLibAllocateString(&OutputBuffer, CUT_OUTPUT_BUFFER_SIZE);
+    }
 
     while (TRUE) {
         if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
@@ -208,44 +312,56 @@ CutProcessHandleLines(
             YORI_ALLOC_SIZE_T OffsetOfMatch;
             BOOLEAN MatchFound = FALSE;
             if (CutContext->RegexMatch) {
-                int offset = 0;
-                const int cbtext = WideCharToMultiByte(CutContext->EncodingToUse, 0, LineString.StartOfString, LineString.LengthInChars, NULL, 0, NULL, NULL);
-                char *text;
+                YORI_ALLOC_SIZE_T ByteOffsetOfMatch;
+                YORI_ALLOC_SIZE_T Index;
+                int cbtext;
+
+                //
+                //  The lower case copy and the multibyte form of the line
+                //  are held in buffers which are reused for each line and
+                //  only reallocated when a longer line is found.  Any
+                //  character converts to at most four bytes.
+                //
 
                 if (CutContext->CaseInsensitive && DllUser32.pCharLowerBuffW) {
-                    if (!YoriLibCopyString(&MatchingSubset, &LineString)) {
-                        break;
+                    if (LowerString.LengthAllocated < LineString.LengthInChars) {
+                        YoriLibFreeStringContents(&LowerString);
+                        if (!YoriLibAllocateString(&LowerString, LineString.LengthAllocated)) {
+                            break;
+                        }
                     }
-                    DllUser32.pCharLowerBuffW(MatchingSubset.StartOfString, MatchingSubset.LengthInChars);
+                    memcpy(LowerString.StartOfString, LineString.StartOfString, LineString.LengthInChars * sizeof(TCHAR));
+                    LowerString.LengthInChars = LineString.LengthInChars;
+                    DllUser32.pCharLowerBuffW(LowerString.StartOfString, LowerString.LengthInChars);
+                    MatchingSubset.StartOfString = LowerString.StartOfString;
                 }
 
-                text = YoriLibMalloc(cbtext + 1);
-                if (text == NULL) {
-                    break;
+                if (cbtextallocated < (int)MatchingSubset.LengthInChars * 4 + 1) {
+                    if (text != NULL) {
+                        YoriLibFree(text);
+                    }
+                    cbtextallocated = (int)LineString.LengthAllocated * 4 + 1;
+                    text = YoriLibMalloc(cbtextallocated);
+                    if (text == NULL) {
+                        cbtextallocated = 0;
+                        break;
+                    }
                 }
-                WideCharToMultiByte(CutContext->EncodingToUse, 0, MatchingSubset.StartOfString, MatchingSubset.LengthInChars, text, cbtext, NULL, NULL);
+                cbtext = WideCharToMultiByte(CutContext->EncodingToUse, 0, MatchingSubset.StartOfString, MatchingSubset.LengthInChars, text, cbtextallocated - 1, NULL, NULL);
                 text[cbtext] = '\0';
                 OffsetOfMatch = 0;
-                while (offset < cbtext) {
-                    int length;
+                if (YoriLibRegexSearch(&CutContext->Regex, text, cbtext, 0, 0, NULL, NULL, &ByteOffsetOfMatch) >= 0 &&
+                    ByteOffsetOfMatch < (YORI_ALLOC_SIZE_T)cbtext) {
 
-                    if ((text[offset] & '\xC0') == '\x80') {
-                        ++offset;
-                        continue;
-                    }
-
-                    length = (int)regex_match(CutContext->tokens, text, offset, 0, NULL, NULL);
-                    if (length >= 0) {
-                        MatchFound = TRUE;
-                        break;
+                    MatchFound = TRUE;
+                    for (Index = 0; Index < ByteOffsetOfMatch; Index++) {
+                        if ((text[Index] & '\xC0') != '\x80') {
+                            OffsetOfMatch++;
+                        }
                     }
-                    ++offset;
-                    ++OffsetOfMatch;
                 }
-                YoriLibFreeStringContents(&MatchingSubset);
                 MatchingSubset.StartOfString = LineString.StartOfString;
                 MatchingSubset.LengthInChars = LineString.LengthInChars;
-                YoriLibFree(text);
             } else if (CutContext->CaseInsensitive) {
                 if (YoriLibFindFirstMatchSubstrIns(&MatchingSubset, 1, &CutContext->MatchText, &OffsetOfMatch)) {
                     MatchFound = TRUE;
@@ -277,7 +393,7 @@ CutProcessHandleLines(
             for (CurrentField = 0; CurrentField <= CutContext->FieldOfInterest; CurrentField++) {
                 YORI_ALLOC_SIZE_T CharsBeforeSeperator;
 
-                CharsBeforeSeperator = YoriLibCntStringNotWithChars(&MatchingSubset, CutContext->FieldSeperator);
+                CharsBeforeSeperator = CutCountCharsBeforeSeperator(CutContext, &MatchingSubset);
                 if (CurrentField == CutContext->FieldOfInterest) {
                     MatchingSubset.LengthInChars = CharsBeforeSeperator;
                 } else {
@@ -304,13 +420,36 @@ CutProcessHandleLines(
         }
 
         if (MatchingSubset.LengthInChars > 0) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &MatchingSubset);
+            if (OutputBuffer.LengthAllocated - OutputBuffer.LengthInChars <= MatchingSubset.LengthInChars) {
+                if (OutputBuffer.LengthInChars > 0) {
+                    YoriLibOutputString(hOut, 0, &OutputBuffer);
+                    OutputBuffer.LengthInChars = 0;
+                }
+            }
+
+            if (OutputBuffer.LengthAllocated - OutputBuffer.LengthInChars > MatchingSubset.LengthInChars) {
+                memcpy(&OutputBuffer.StartOfString[OutputBuffer.LengthInChars], MatchingSubset.StartOfString, MatchingSubset.LengthInChars * sizeof(TCHAR));
+                OutputBuffer.LengthInChars = OutputBuffer.LengthInChars + MatchingSubset.LengthInChars;
+                OutputBuffer.StartOfString[OutputBuffer.LengthInChars] = '\n';
+                OutputBuffer.LengthInChars++;
+            } else {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &MatchingSubset);
+            }
         }
     }
 
+    if (OutputBuffer.LengthInChars > 0) {
+        YoriLibOutputString(hOut, 0, &OutputBuffer);
+    }
+
+    if (text != NULL) {
+        YoriLibFree(text);
+    }
+
     YoriLibLineReadCloseOrCache(LineContext);
     YoriLibFreeStringContents(&LineString);
-    YoriLibFreeStringContents(&MatchingSubset);
+    YoriLibFreeStringContents(&LowerString);
+    YoriLibFreeStringContents(&OutputBuffer);
 
     return TRUE;
 }
@@ -735,6 +874,8 @@ ENTRYPOINT(
         CutContext.FieldSeperator = _T(",");
     }
 
+    CutBuildSeperatorMap(&CutContext);
+
 #if YORI_BUILTIN
     YoriLibCancelEnable(FALSE);
 #endif
@@ -772,8 +913,7 @@ ENTRYPOINT(
 
         WideCharToMultiByte(CutContext.EncodingToUse, 0, CutContext.MatchText.StartOfString, CutContext.MatchText.LengthInChars, pattern, cbpattern, NULL, NULL);
         pattern[cbpattern] = '\0';
-        CutContext.token_count = 1024;
-        if (regex_parse(pattern, CutContext.tokens, &CutContext.token_count, 0) != 0) {
+        if (YoriLibRegexCompile(pattern, &CutContext.Regex) != 0) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("cut: invalid regex\n"));
             return EXIT_FAILURE;
         }
@@ -792,6 +932,7 @@ ENTRYPOINT(
         if (YoriLibIsStdInConsole()) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("cut: No file or pipe for input\n"));
             YoriLibFreeStringContents(&CutContext.MatchText);
+            YoriLibRegexFree(&CutContext.Regex);
             return EXIT_FAILURE;
         }
         hSource = GetStdHandle(STD_INPUT_HANDLE);
@@ -840,6 +981,7 @@ ENTRYPOINT(
     YoriLibLineReadCleanupCache();
 #endif
     YoriLibFreeStringContents(&CutContext.MatchText);
+    YoriLibRegexFree(&CutContext.Regex);
 
     return Result;
 }
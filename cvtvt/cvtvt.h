@@ -39,5 +39,6 @@
 BOOL CvtvtHtml4SetFunctions(__out PYORI_LIB_VT_CALLBACK_FUNCTIONS CallbackFunctions);
 BOOL CvtvtHtml5SetFunctions(__out PYORI_LIB_VT_CALLBACK_FUNCTIONS CallbackFunctions);
 BOOL CvtvtRtfSetFunctions(__out PYORI_LIB_VT_CALLBACK_FUNCTIONS CallbackFunctions);
+BOOL CvtvtHtmlFlush(__in HANDLE hOutput);
 
 // vim:sw=4:ts=4:et:
@@ -3,7 +3,7 @@
  *
  * Convert VT100/ANSI escape sequences into HTML.
  *
- * Copyright (c) 2015-2018 Malcolm J. Smith
+ * Copyright (c) 2015-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -32,6 +32,58 @@
  */
 YORILIB_HTML_GENERATE_CONTEXT CvtvtHtmlGenerateContext;
 
+/**
+ The number of characters of generated HTML to buffer before writing to the
+ output stream.
+ */
+#define CVTVT_HTML_BUFFER_SIZE (64 * 1024)
+
+/**
+ Generated HTML which has not yet been written to the output stream.  Text
+ and escapes are typically small, so generating each directly into this
+ buffer avoids an allocation and a write for each of them.
+ */
+YORI_STRING CvtvtHtmlOutputBuffer;
+
+/**
+ Write any buffered HTML to the output stream.
+
+ @param hOutput The stream to output buffered HTML to.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+CvtvtHtmlFlush(
+    __in HANDLE hOutput
+    )
+{
+    BOOL Result;
+
+    if (CvtvtHtmlOutputBuffer.LengthInChars == 0) {
+        return TRUE;
+    }
+
+    Result = YoriLibOutputTextToMbyteDev(hOutput, &CvtvtHtmlOutputBuffer);
+    CvtvtHtmlOutputBuffer.LengthInChars = 0;
+    return Result;
+}
+
+/**
+ Prepare a string describing the unused space at the end of the output
+ buffer, so that generated HTML can be written there directly.
+
+ @param Tail On completion, updated to refer to the unused space.
+ */
+VOID
+CvtvtHtmlGetBufferTail(
+    __out PYORI_STRING Tail
+    )
+{
+    YoriLibInitEmptyString(Tail);
+    Tail->StartOfString = CvtvtHtmlOutputBuffer.StartOfString + CvtvtHtmlOutputBuffer.LengthInChars;
+    Tail->LengthAllocated = CvtvtHtmlOutputBuffer.LengthAllocated - CvtvtHtmlOutputBuffer.LengthInChars;
+}
+
 /**
  Indicate the beginning of a stream and perform any initial output.
 
@@ -51,6 +103,10 @@ CvtvtHtmlInitializeStream(
 
     UNREFERENCED_PARAMETER(Context);
 
+    if (!YoriLibAllocateString(&CvtvtHtmlOutputBuffer, CVTVT_HTML_BUFFER_SIZE)) {
+        return FALSE;
+    }
+
     YoriLibInitEmptyString(&OutputString);
     if (!YoriLibHtmlGenerateInitialString(&OutputString, &CvtvtHtmlGenerateContext)) {
         return FALSE;
@@ -80,6 +136,9 @@ CvtvtHtmlEndStream(
     YORI_STRING OutputString;
     UNREFERENCED_PARAMETER(Context);
 
+    CvtvtHtmlFlush(hOutput);
+    YoriLibFreeStringContents(&CvtvtHtmlOutputBuffer);
+
     YoriLibInitEmptyString(&OutputString);
 
     if (!YoriLibHtmlGenerateEndString(&OutputString, &CvtvtHtmlGenerateContext)) {
@@ -118,12 +177,42 @@ CvtvtHtmlProcessAndOutputText(
 
     UNREFERENCED_PARAMETER(Context);
 
-    YoriLibInitEmptyString(&TextString);
+    //
+    //  Try to generate into the output buffer.  If it doesn't fit, flush
+    //  the buffer and try again.
+    //
+
+    CvtvtHtmlGetBufferTail(&TextString);
     BufferSizeNeeded = 0;
     if (!YoriLibHtmlGenerateTextString(&TextString, &BufferSizeNeeded, String)) {
         return FALSE;
     }
 
+    if (BufferSizeNeeded > TextString.LengthAllocated &&
+        CvtvtHtmlOutputBuffer.LengthInChars > 0 &&
+        BufferSizeNeeded <= CvtvtHtmlOutputBuffer.LengthAllocated) {
+
+        CvtvtHtmlFlush(hOutput);
+        CvtvtHtmlGetBufferTail(&TextString);
+        BufferSizeNeeded = 0;
+        if (!YoriLibHtmlGenerateTextString(&TextString, &BufferSizeNeeded, String)) {
+            return FALSE;
+        }
+    }
+
+    if (BufferSizeNeeded <= TextString.LengthAllocated) {
+        CvtvtHtmlOutputBuffer.LengthInChars = CvtvtHtmlOutputBuffer.LengthInChars + TextString.LengthInChars;
+        return TRUE;
+    }
+
+    //
+    //  The text is larger than the buffer, so allocate space for it and
+    //  write it directly.
+    //
+
+    CvtvtHtmlFlush(hOutput);
+
+    YoriLibInitEmptyString(&TextString);
     if (!YoriLibAllocateString(&TextString, BufferSizeNeeded)) {
         return FALSE;
     }
@@ -167,26 +256,38 @@ CvtvtHtmlProcessAndOutputEscape(
 
     UNREFERENCED_PARAMETER(Context);
 
-    YoriLibInitEmptyString(&TextString);
+    //
+    //  Generation updates the context, so generate against a copy and
+    //  only keep the result if the output fit.  Escapes are small, so
+    //  after a flush they always fit.
+    //
+
+    CvtvtHtmlGetBufferTail(&TextString);
     BufferSizeNeeded = 0;
     memcpy(&DummyGenerateContext, &CvtvtHtmlGenerateContext, sizeof(YORILIB_HTML_GENERATE_CONTEXT));
     if (!YoriLibHtmlGenerateEscapeString(&TextString, &BufferSizeNeeded, String, &DummyGenerateContext)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&TextString, BufferSizeNeeded)) {
-        return FALSE;
+    if (BufferSizeNeeded > TextString.LengthAllocated) {
+        if (!CvtvtHtmlFlush(hOutput)) {
+            return FALSE;
+        }
+
+        CvtvtHtmlGetBufferTail(&TextString);
+        BufferSizeNeeded = 0;
+        memcpy(&DummyGenerateContext, &CvtvtHtmlGenerateContext, sizeof(YORILIB_HTML_GENERATE_CONTEXT));
+        if (!YoriLibHtmlGenerateEscapeString(&TextString, &BufferSizeNeeded, String, &DummyGenerateContext)) {
+            return FALSE;
+        }
+
+        if (BufferSizeNeeded > TextString.LengthAllocated) {
+            return FALSE;
+        }
     }
 
-    BufferSizeNeeded = 0;
-    if (!YoriLibHtmlGenerateEscapeString(&TextString, &BufferSizeNeeded, String, &CvtvtHtmlGenerateContext)) {
-        YoriLibFreeStringContents(&TextString);
-        return FALSE;
-    }
-
-    YoriLibOutputTextToMbyteDev(hOutput, &TextString);
-
-    YoriLibFreeStringContents(&TextString);
+    memcpy(&CvtvtHtmlGenerateContext, &DummyGenerateContext, sizeof(YORILIB_HTML_GENERATE_CONTEXT));
+    CvtvtHtmlOutputBuffer.LengthInChars = CvtvtHtmlOutputBuffer.LengthInChars + TextString.LengthInChars;
     return TRUE;
 }
 
@@ -61,6 +61,14 @@ CvtvtUsage(VOID)
     return TRUE;
 }
 
+/**
+ The size of the buffer for each pipe used to communicate with a child
+ process.  A small buffer forces a fast producing child to wait for each
+ small chunk to be converted, so this is large enough to allow output to be
+ consumed in large reads.
+ */
+#define CVTVT_PIPE_BUFFER_SIZE (64 * 1024)
+
 /**
  Pump any incoming data from standard input to a specified pipe which will
  be used as the input for a child process.
@@ -77,7 +85,7 @@ CvtvtInputPumpThread(
 {
     HANDLE hOutput = (HANDLE)Context;
     HANDLE hInput;
-    UCHAR StupidBuffer[256];
+    UCHAR StupidBuffer[4096];
     DWORD BytesRead;
     DWORD BytesWritten;
 
@@ -154,13 +162,13 @@ CvtvtLaunchChildProcess(
     ZeroMemory(&StartupInfo, sizeof(StartupInfo));
     ZeroMemory(&ProcessInfo, sizeof(ProcessInfo));
 
-    if (!CreatePipe(&hProcessInput, &hParentOutput, NULL, 2048)) {
+    if (!CreatePipe(&hProcessInput, &hParentOutput, NULL, CVTVT_PIPE_BUFFER_SIZE)) {
         Err = GetLastError();
         YoriLibFreeStringContents(&FoundExecutable);
         return Err;
     }
 
-    if (!CreatePipe(&hParentInput, &hProcessOutput, NULL, 2048)) {
+    if (!CreatePipe(&hParentInput, &hProcessOutput, NULL, CVTVT_PIPE_BUFFER_SIZE)) {
         Err = GetLastError();
         CloseHandle(hProcessInput);
         CloseHandle(hParentOutput);
@@ -465,6 +473,15 @@ ENTRYPOINT(
                 break;
             }
         }
+
+        //
+        //  If the source has gone quiet, write out anything that has been
+        //  buffered so it's visible while waiting for more.
+        //
+
+        if (TimeoutReached) {
+            CvtvtHtmlFlush(hOutput);
+        }
     }
 
     if (StreamStarted) {
@@ -3,7 +3,7 @@
  *
  * Yori shell display disk free on volumes
  *
- * Copyright (c) 2017-2023 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -35,9 +35,10 @@ CHAR strDfHelpText[] =
         "\n"
         "Display disk free space.\n"
         "\n"
-        "DF [-license] [-m] [<drive>]\n"
+        "DF [-license] [-m] [-t <seconds>] [<drive>]\n"
         "\n"
-        "   -m             Minimal display, raw data only\n";
+        "   -m             Minimal display, raw data only\n"
+        "   -t             Seconds to wait for volumes to respond, 0 to wait forever\n";
 
 /**
  Display usage text to the user.
@@ -98,12 +99,148 @@ typedef struct _DF_CONTEXT {
 } DF_CONTEXT, *PDF_CONTEXT;
 
 /**
- Report the space usage on a single volume.
+ The default number of seconds to wait for volumes to respond.
+ */
+#define DF_DEFAULT_TIMEOUT (10)
+
+/**
+ Information about a single volume, populated by a worker thread.  This is
+ reference counted so that a worker which does not complete in time can
+ continue to use it after the command has finished reporting.
+ */
+typedef struct _DF_VOLUME {
+
+    /**
+     The volume name.  This can either be a volume GUID path returned from
+     volume enumeration, or a user specified path to anything.
+     */
+    TCHAR VolName[512];
+
+    /**
+     The mount point of the volume, if it could be found.
+     */
+    TCHAR MountPointName[MAX_PATH];
+
+    /**
+     Handle to the worker thread querying the volume, or NULL if the volume
+     was queried synchronously.
+     */
+    HANDLE hThread;
+
+    /**
+     The size of the volume, in bytes.
+     */
+    LARGE_INTEGER TotalBytes;
+
+    /**
+     Free space on the volume, in bytes.
+     */
+    LARGE_INTEGER FreeBytes;
+
+    /**
+     TRUE if MountPointName has been populated.
+     */
+    BOOLEAN HaveMountPoint;
+
+    /**
+     TRUE if TotalBytes and FreeBytes have been populated.
+     */
+    BOOLEAN HaveFreeSpace;
+
+} DF_VOLUME, *PDF_VOLUME;
+
+/**
+ Query the mount point and space usage of a single volume.
+
+ @param Volume Pointer to the volume to query.
+ */
+VOID
+DfQueryVolume(
+    __inout PDF_VOLUME Volume
+    )
+{
+    DWORD CharsReturned;
+
+    //
+    //  If the OS supports it, try to translate the GUID volume names back
+    //  into drive letters.
+    //
+
+    if (DllKernel32.pGetVolumePathNamesForVolumeNameW) {
+        if (DllKernel32.pGetVolumePathNamesForVolumeNameW(Volume->VolName, Volume->MountPointName, sizeof(Volume->MountPointName)/sizeof(Volume->MountPointName[0]), &CharsReturned)) {
+            Volume->HaveMountPoint = TRUE;
+        }
+    }
+
+    if (YoriLibGetDiskFreeSpace(Volume->VolName, &Volume->FreeBytes, &Volume->TotalBytes, NULL)) {
+        Volume->HaveFreeSpace = TRUE;
+    }
+}
+
+/**
+ A worker thread which queries a single volume.  Each volume is queried on
+ its own thread so that an unresponsive volume does not delay the others.
+
+ @param Context Pointer to the volume to query.  The worker holds a
+        reference on this which it releases on completion.
+
+ @return Zero.
+ */
+DWORD WINAPI
+DfQueryVolumeThread(
+    __in LPVOID Context
+    )
+{
+    PDF_VOLUME Volume;
+
+    Volume = (PDF_VOLUME)Context;
+    DfQueryVolume(Volume);
+    YoriLibDereference(Volume);
+    return 0;
+}
+
+/**
+ Allocate a volume and start a worker thread to query it.  If a thread
+ cannot be created, the volume is queried synchronously.
 
  @param VolName The volume name.  This can either be a volume GUID path
         returned from volume enumeration, or a user specified path to
         anything.
 
+ @return Pointer to the volume, or NULL on allocation failure.  The caller
+         should release this with YoriLibDereference.
+ */
+PDF_VOLUME
+DfStartVolumeQuery(
+    __in PYORI_STRING VolName
+    )
+{
+    PDF_VOLUME Volume;
+    DWORD ThreadId;
+
+    Volume = YoriLibReferencedMalloc(sizeof(DF_VOLUME));
+    if (Volume == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Volume, sizeof(DF_VOLUME));
+    YoriLibSPrintfS(Volume->VolName, sizeof(Volume->VolName)/sizeof(Volume->VolName[0]), _T("%y"), VolName);
+
+    YoriLibReference(Volume);
+    Volume->hThread = CreateThread(NULL, 0, DfQueryVolumeThread, Volume, 0, &ThreadId);
+    if (Volume->hThread == NULL) {
+        YoriLibDereference(Volume);
+        DfQueryVolume(Volume);
+    }
+
+    return Volume;
+}
+
+/**
+ Report the space usage on a single volume.
+
+ @param Volume Pointer to the volume which has been queried.
+
  @param DfContext Pointer to the context used to indicate options for each
         drive whose free space is being reported.
 
@@ -111,7 +248,7 @@ typedef struct _DF_CONTEXT {
  */
 BOOL
 DfReportSingleVolume(
-    __in LPTSTR VolName,
+    __in PDF_VOLUME Volume,
     __in PDF_CONTEXT DfContext
     )
 {
@@ -126,8 +263,7 @@ DfReportSingleVolume(
     WIN32_FIND_DATA FindData;
     YORI_STRING VtAttribute;
     TCHAR VtAttributeBuffer[YORI_MAX_VT_ESCAPE_CHARS];
-
-    TCHAR MountPointName[MAX_PATH];
+    LPTSTR VolName;
     LPTSTR NameToReport;
 
     //
@@ -144,23 +280,20 @@ DfReportSingleVolume(
     VtAttribute.StartOfString = VtAttributeBuffer;
     VtAttribute.LengthAllocated = sizeof(VtAttributeBuffer)/sizeof(VtAttributeBuffer[0]);
 
-    //
-    //  If the OS supports it, try to translate the GUID volume names back
-    //  into drive letters.
-    //
-
+    VolName = Volume->VolName;
     NameToReport = VolName;
-    if (DllKernel32.pGetVolumePathNamesForVolumeNameW) {
-        if (DllKernel32.pGetVolumePathNamesForVolumeNameW(VolName, MountPointName, sizeof(MountPointName)/sizeof(MountPointName[0]), &PercentageUsed)) {
-            NameToReport = MountPointName;
-        }
+    if (Volume->HaveMountPoint) {
+        NameToReport = Volume->MountPointName;
     }
 
     //
-    //  Query free space and display the result.
+    //  Display the result of the query.
     //
 
-    if (YoriLibGetDiskFreeSpace(VolName, &FreeBytes, &TotalBytes, NULL)) {
+    if (Volume->HaveFreeSpace) {
+
+        TotalBytes.QuadPart = Volume->TotalBytes.QuadPart;
+        FreeBytes.QuadPart = Volume->FreeBytes.QuadPart;
 
         YoriLibFileSizeToString(&StrTotalSize, &TotalBytes);
         YoriLibFileSizeToString(&StrFreeSize, &FreeBytes);
@@ -221,6 +354,58 @@ DfReportSingleVolume(
     return Result;
 }
 
+/**
+ Add a volume to the set being queried, reallocating the set if needed.
+
+ @param Volumes Pointer to the array of volumes being queried.  This may be
+        reallocated.
+
+ @param VolumeCount Pointer to the number of volumes in the array.  On
+        success this is incremented.
+
+ @param VolumesAllocated Pointer to the number of elements allocated in the
+        array.  This may be updated if the array is reallocated.
+
+ @param VolName The volume name.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+DfAddVolume(
+    __inout PDF_VOLUME **Volumes,
+    __inout PDWORD VolumeCount,
+    __inout PDWORD VolumesAllocated,
+    __in PYORI_STRING VolName
+    )
+{
+    PDF_VOLUME *NewVolumes;
+    DWORD NewAllocated;
+
+    if (*VolumeCount == *VolumesAllocated) {
+        NewAllocated = *VolumesAllocated * 2;
+        if (NewAllocated == 0) {
+            NewAllocated = 32;
+        }
+        NewVolumes = YoriLibMalloc(NewAllocated * sizeof(PDF_VOLUME));
+        if (NewVolumes == NULL) {
+            return FALSE;
+        }
+        if (*Volumes != NULL) {
+            memcpy(NewVolumes, *Volumes, *VolumeCount * sizeof(PDF_VOLUME));
+            YoriLibFree(*Volumes);
+        }
+        *Volumes = NewVolumes;
+        *VolumesAllocated = NewAllocated;
+    }
+
+    (*Volumes)[*VolumeCount] = DfStartVolumeQuery(VolName);
+    if ((*Volumes)[*VolumeCount] == NULL) {
+        return FALSE;
+    }
+    (*VolumeCount)++;
+    return TRUE;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the df builtin command.
@@ -252,14 +437,26 @@ ENTRYPOINT(
     BOOL ArgumentUnderstood;
     YORI_ALLOC_SIZE_T i;
     YORI_ALLOC_SIZE_T StartArg = 0;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    YORI_MAX_SIGNED_T llTemp;
     YORI_STRING Arg;
     HANDLE FindHandle;
     TCHAR VolName[512];
     DF_CONTEXT DfContext;
     YORI_STRING Combined;
+    YORI_STRING YsVolName;
+    PDF_VOLUME *Volumes;
+    DWORD VolumeCount;
+    DWORD VolumesAllocated;
+    DWORD Index;
+    DWORD Timeout;
+    DWORD StartTime;
+    DWORD Elapsed;
+    DWORD WaitResult;
 
     ZeroMemory(&DfContext, sizeof(DfContext));
     DfContext.DisplayGraph = TRUE;
+    Timeout = DF_DEFAULT_TIMEOUT * 1000;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -272,12 +469,26 @@ ENTRYPOINT(
                 DfHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2017-2023"));
+                YoriLibDisplayMitLicense(_T("2017-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("m")) == 0) {
                 DfContext.MinimalDisplay = TRUE;
                 DfContext.DisplayGraph = FALSE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("t")) == 0) {
+                if (ArgC > i + 1 &&
+                    YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                    CharsConsumed > 0 &&
+                    llTemp >= 0 &&
+                    llTemp < 0x100000) {
+
+                    Timeout = (DWORD)llTemp * 1000;
+                    if (Timeout == 0) {
+                        Timeout = INFINITE;
+                    }
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 StartArg = i;
                 ArgumentUnderstood = TRUE;
@@ -322,22 +533,71 @@ ENTRYPOINT(
 
     SetErrorMode(SEM_FAILCRITICALERRORS | SEM_NOOPENFILEERRORBOX);
 
+    //
+    //  Start querying every volume at once, so the time taken is bounded
+    //  by the slowest volume rather than the sum of all of them.
+    //
+
+    Volumes = NULL;
+    VolumeCount = 0;
+    VolumesAllocated = 0;
+    StartTime = GetTickCount();
+
     if (StartArg != 0) {
         for (i = StartArg; i < ArgC; i++) {
-            if (!DfReportSingleVolume(ArgV[i].StartOfString, &DfContext)) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("df: Could not query %y\n"), &ArgV[i]);
+            if (!DfAddVolume(&Volumes, &VolumeCount, &VolumesAllocated, &ArgV[i])) {
+                break;
             }
         }
     } else {
         FindHandle = YoriLibFindFirstVolume(VolName, sizeof(VolName)/sizeof(VolName[0]));
         if (FindHandle != INVALID_HANDLE_VALUE) {
             do {
-                DfReportSingleVolume(VolName, &DfContext);
+                YoriLibConstantString(&YsVolName, VolName);
+                if (!DfAddVolume(&Volumes, &VolumeCount, &VolumesAllocated, &YsVolName)) {
+                    break;
+                }
             } while(YoriLibFindNextVolume(FindHandle, VolName, sizeof(VolName)/sizeof(VolName[0])));
             YoriLibFindVolumeClose(FindHandle);
         }
     }
 
+    //
+    //  Report volumes in order, waiting until the timeout for each.  A
+    //  volume which has not responded by then is reported as unavailable
+    //  and its worker is left to finish and release it.
+    //
+
+    for (Index = 0; Index < VolumeCount; Index++) {
+        WaitResult = WAIT_OBJECT_0;
+        if (Volumes[Index]->hThread != NULL) {
+            if (Timeout == INFINITE) {
+                WaitResult = WaitForSingleObject(Volumes[Index]->hThread, INFINITE);
+            } else {
+                Elapsed = GetTickCount() - StartTime;
+                if (Elapsed > Timeout) {
+                    Elapsed = Timeout;
+                }
+                WaitResult = WaitForSingleObject(Volumes[Index]->hThread, Timeout - Elapsed);
+            }
+            CloseHandle(Volumes[Index]->hThread);
+        }
+
+        if (WaitResult != WAIT_OBJECT_0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("unavailable %s\n"), Volumes[Index]->VolName);
+            DfContext.VolumesDisplayed++;
+        } else if (!DfReportSingleVolume(Volumes[Index], &DfContext)) {
+            if (StartArg != 0) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("df: Could not query %s\n"), Volumes[Index]->VolName);
+            }
+        }
+        YoriLibDereference(Volumes[Index]);
+    }
+
+    if (Volumes != NULL) {
+        YoriLibFree(Volumes);
+    }
+
     YoriLibFileFiltFreeFilter(&DfContext.ColorRules);
 
     return EXIT_SUCCESS;
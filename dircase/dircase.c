@@ -3,7 +3,7 @@
  *
  * Yori shell mark directories for case sensitive or insensitive semantics
  *
- * Copyright (c) 2021 Malcolm J. Smith
+ * Copyright (c) 2021-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -86,32 +86,40 @@ typedef struct _DIRCASE_CONTEXT {
     LONGLONG DirsFound;
 
     /**
-     Records the total number of directories processed.
+     Records the total number of directories processed.  This is updated
+     as results are reported, which happens on one thread at a time.
      */
     LONGLONG DirsModified;
 
+    /**
+     The engine used to apply changes to directories in parallel.
+     */
+    PYORI_LIB_FILE_UPDATE_ENGINE Engine;
+
 } DIRCASE_CONTEXT, *PDIRCASE_CONTEXT;
 
 /**
- A callback that is invoked when a directory is found that matches a search
- criteria specified in the set of strings to enumerate.
-
- @param FilePath Pointer to the file path that was found.
-
- @param FileInfo Information about the directory.
+ The step of a case sensitivity update that failed.
+ */
+typedef enum _DIRCASE_UPDATE_STEP {
+    DirCaseUpdateStepOpen = 0,
+    DirCaseUpdateStepModify = 1
+} DIRCASE_UPDATE_STEP;
 
- @param Depth Specifies recursion depth.  Ignored in this application.
+/**
+ Apply a case sensitivity change to a directory.  This is invoked on a
+ worker thread.
 
- @param Context Pointer to the dircase context structure indicating the action
-        to perform and populated with the directory found.
+ @param Update Pointer to the update describing the directory.  On
+        completion, this is updated with the result.  If the change could
+        not be applied, the error is a Win32 error if the directory could
+        not be opened, or an NTSTATUS code if the change was rejected.
 
- @return TRUE to continute enumerating, FALSE to abort.
+ @param Context Pointer to the dircase context.
  */
-BOOL
-DirCaseFileFoundCallback(
-    __in PYORI_STRING FilePath,
-    __in PWIN32_FIND_DATA FileInfo,
-    __in DWORD Depth,
+VOID
+DirCaseApplyDirectory(
+    __in PYORI_LIB_FILE_UPDATE Update,
     __in PVOID Context
     )
 {
@@ -122,21 +130,9 @@ DirCaseFileFoundCallback(
     DWORD AccessRequired;
     DWORD Status;
 
-    UNREFERENCED_PARAMETER(FileInfo);
-    UNREFERENCED_PARAMETER(Depth);
-
-    ASSERT(YoriLibIsStringNullTerminated(FilePath));
-    ASSERT((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
-
-    DirCaseContext->DirsFound++;
-
-    if (DirCaseContext->Verbose) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Updating %y...\n"), FilePath);
-    }
-
     AccessRequired = FILE_WRITE_ATTRIBUTES | SYNCHRONIZE;
 
-    hDir = CreateFile(FilePath->StartOfString,
+    hDir = CreateFile(Update->FilePath.StartOfString,
                       AccessRequired,
                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
                       NULL,
@@ -145,7 +141,9 @@ DirCaseFileFoundCallback(
                       NULL);
 
     if (hDir == INVALID_HANDLE_VALUE) {
-        return FALSE;
+        Update->Error = GetLastError();
+        Update->FailedStep = DirCaseUpdateStepOpen;
+        return;
     }
 
     CaseSensitiveInfo.Flags = 0;
@@ -153,16 +151,89 @@ DirCaseFileFoundCallback(
         CaseSensitiveInfo.Flags = 1;
     }
 
-
     Status = DllNtDll.pNtSetInformationFile(hDir, &IoStatusBlock, &CaseSensitiveInfo, sizeof(CaseSensitiveInfo), FileCaseSensitiveInformation);
     CloseHandle(hDir);
 
     if (Status != 0) {
-        LPTSTR ErrText = YoriLibGetNtErrorText(Status);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Update of %y failed: %s"), FilePath, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-    } else {
+        Update->Error = Status;
+        Update->FailedStep = DirCaseUpdateStepModify;
+        return;
+    }
+
+    Update->Modified = TRUE;
+}
+
+/**
+ Report the result of a case sensitivity change to a directory.  This is
+ invoked for one directory at a time, in the order that directories were
+ found.
+
+ @param Update Pointer to the update describing the directory and its
+        result.
+
+ @param Context Pointer to the dircase context.
+ */
+VOID
+DirCaseReportDirectory(
+    __in PYORI_LIB_FILE_UPDATE Update,
+    __in PVOID Context
+    )
+{
+    PDIRCASE_CONTEXT DirCaseContext = (PDIRCASE_CONTEXT)Context;
+    LPTSTR ErrText;
+
+    if (DirCaseContext->Verbose) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Updating %y...\n"), &Update->FilePath);
+    }
+
+    if (Update->Error == ERROR_SUCCESS) {
         DirCaseContext->DirsModified++;
+        return;
+    }
+
+    if (Update->FailedStep == DirCaseUpdateStepOpen) {
+        ErrText = YoriLibGetWinErrorText(Update->Error);
+    } else {
+        ErrText = YoriLibGetNtErrorText(Update->Error);
+    }
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Update of %y failed: %s"), &Update->FilePath, ErrText);
+    YoriLibFreeWinErrorText(ErrText);
+}
+
+/**
+ A callback that is invoked when a directory is found that matches a search
+ criteria specified in the set of strings to enumerate.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the directory.
+
+ @param Depth Specifies recursion depth.  Ignored in this application.
+
+ @param Context Pointer to the dircase context structure indicating the action
+        to perform and populated with the directory found.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+DirCaseFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PDIRCASE_CONTEXT DirCaseContext = (PDIRCASE_CONTEXT)Context;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+    ASSERT((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+
+    DirCaseContext->DirsFound++;
+
+    if (!YoriLibQueueFileUpdate(DirCaseContext->Engine, FilePath, FileInfo)) {
+        return FALSE;
     }
 
     return TRUE;
@@ -281,7 +352,7 @@ ENTRYPOINT(
                 DirCaseHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2021"));
+                YoriLibDisplayMitLicense(_T("2021-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
@@ -336,6 +407,11 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
+    if (!YoriLibCreateFileUpdateEngine(DirCaseApplyDirectory, DirCaseReportDirectory, &DirCaseContext, 0, &DirCaseContext.Engine)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("dircase: out of memory\n"));
+        return EXIT_FAILURE;
+    }
+
 #if YORI_BUILTIN
     YoriLibCancelEnable(FALSE);
 #endif
@@ -358,6 +434,8 @@ ENTRYPOINT(
                            &DirCaseContext);
     }
 
+    YoriLibDestroyFileUpdateEngine(DirCaseContext.Engine);
+
     if (DirCaseContext.DirsFound == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("dircase: no matching files found\n"));
     }
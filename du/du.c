@@ -35,8 +35,8 @@ CHAR strDuHelpText[] =
         "\n"
         "Display disk space used within directories.\n"
         "\n"
-        "DU [-license] [-a] [-b] [-c] [-color] [-d] [-h] [-r <num>] [-s <size>]\n"
-        "   [-w] [<spec>...]\n"
+        "DU [-license] [-a] [-b] [-c] [-color] [-d] [-h|-hx] [-j <n>] [-mft] [-r <num>]\n"
+        "   [-s <size>] [-top <n>] [-w] [<spec>...]\n"
         "\n"
         "   -a             Enable all features for maximum accuracy\n"
         "   -b             Use basic search criteria for files only\n"
@@ -44,8 +44,12 @@ CHAR strDuHelpText[] =
         "   -color         Use file color highlighting\n"
         "   -d             Include space used by alternate data streams\n"
         "   -h             Average space used across multiple hard links\n"
+        "   -hx            Count space used by hard linked files once, where first found\n"
+        "   -j <n>         Calculate space used by up to n subdirectories concurrently\n"
+        "   -mft           Read the NTFS master file table directly if possible\n"
         "   -r <num>       The maximum recursion depth to display\n"
         "   -s <size>      Only display directories containing at least size bytes\n"
+        "   -top <n>       Only display the n largest directories and n largest files\n"
         "   -u             Round space up to file allocation unit or cluster size\n"
         "   -w             Count files backed by a WIM archive as zero size\n";
 
@@ -85,6 +89,130 @@ typedef struct _DU_WIN32_FIND_STREAM_DATA {
     WCHAR cStreamName[DU_MAX_STREAM_NAME];
 } DU_WIN32_FIND_STREAM_DATA, *PDU_WIN32_FIND_STREAM_DATA;
 
+/**
+ The size of the buffer used to read file IDs from a directory.
+ */
+#define DU_FILE_ID_BUFFER_SIZE (64 * 1024)
+
+/**
+ The number of entries to allocate in a file ID set when the first file is
+ added.  This must be a power of two.
+ */
+#define DU_FILE_ID_SET_INITIAL_CAPACITY (4096)
+
+/**
+ A 128 bit identifier for a file, consisting of its file ID and the serial
+ number of the volume containing it.
+ */
+typedef struct _DU_FILE_ID {
+
+    /**
+     The file ID within the volume.
+     */
+    DWORDLONG FileId;
+
+    /**
+     The serial number of the volume.
+     */
+    DWORDLONG VolumeSerialNumber;
+} DU_FILE_ID, *PDU_FILE_ID;
+
+/**
+ The set of files which have been counted, used to count each hard linked
+ file once.  This is an open addressed hash table of file IDs, where an
+ entry of zero is unused.  It is shared between worker threads.
+ */
+typedef struct _DU_FILE_ID_SET {
+
+    /**
+     An array of Capacity entries.
+     */
+    PDU_FILE_ID Entries;
+
+    /**
+     The number of entries in the array.  This is a power of two.
+     */
+    DWORD Capacity;
+
+    /**
+     The number of entries in use.
+     */
+    DWORD Count;
+
+    /**
+     A mutex synchronizing the set between worker threads, or NULL if the
+     set is only used by one thread.
+     */
+    HANDLE Mutex;
+} DU_FILE_ID_SET, *PDU_FILE_ID_SET;
+
+/**
+ The file ID of a single file within a directory.
+ */
+typedef struct _DU_DIRECTORY_FILE_ID {
+
+    /**
+     The file ID of the file.
+     */
+    DWORDLONG FileId;
+
+    /**
+     The offset of the name of the file within the names buffer, in
+     characters.
+     */
+    DWORD NameOffset;
+
+    /**
+     The length of the name of the file, in characters.
+     */
+    DWORD NameLength;
+} DU_DIRECTORY_FILE_ID, *PDU_DIRECTORY_FILE_ID;
+
+/**
+ The file IDs of the files within a directory.  These are read in one pass
+ over the directory rather than by opening each file, and are in the order
+ the file system returns them, which is normally the order that files are
+ found by enumeration.
+ */
+typedef struct _DU_DIRECTORY_FILE_IDS {
+
+    /**
+     An array of Allocated entries, of which the first Count are in use.
+     */
+    PDU_DIRECTORY_FILE_ID Entries;
+
+    /**
+     The names of the files, referred to by each entry.
+     */
+    YORI_STRING Names;
+
+    /**
+     The number of entries in use.
+     */
+    DWORD Count;
+
+    /**
+     The number of entries allocated.
+     */
+    DWORD Allocated;
+
+    /**
+     The index of the entry after the most recently found entry, where the
+     next search starts.
+     */
+    DWORD Cursor;
+
+    /**
+     The serial number of the volume containing the directory.
+     */
+    DWORD VolumeSerialNumber;
+
+    /**
+     TRUE if the file IDs have been read for the current directory.
+     */
+    BOOLEAN Loaded;
+} DU_DIRECTORY_FILE_IDS, *PDU_DIRECTORY_FILE_IDS;
+
 /**
  A structure describing a particular directory.  When traversing through
  files to calculate space, there will be one of these structures for each
@@ -120,8 +248,332 @@ typedef struct _DU_DIRECTORY_STACK {
      enabled.
      */
     LONGLONG AllocationSize;
+
+    /**
+     When reading the MFT, the segment number of the next subdirectory
+     within this directory to process, or zero if all subdirectories have
+     been processed.
+     */
+    DWORD MftNextChild;
+
+    /**
+     When counting hard linked files once, the file IDs of the files in
+     this directory, which are read when the first file is found.
+     */
+    DU_DIRECTORY_FILE_IDS FileIds;
 } DU_DIRECTORY_STACK, *PDU_DIRECTORY_STACK;
 
+/**
+ The segment number of the root directory of an NTFS volume.
+ */
+#define DU_MFT_ROOT_SEGMENT (5)
+
+/**
+ Segment numbers below this value are reserved for NTFS metadata files,
+ which are not visible when enumerating directories.
+ */
+#define DU_MFT_FIRST_USER_SEGMENT (16)
+
+/**
+ Set on an MFT entry if a base file record has been found for it.
+ */
+#define DU_MFT_ENTRY_IN_USE          (0x01)
+
+/**
+ Set on an MFT entry if it describes a directory.
+ */
+#define DU_MFT_ENTRY_DIRECTORY       (0x02)
+
+/**
+ Set on an MFT entry if a name has been recorded for it.
+ */
+#define DU_MFT_ENTRY_HAS_NAME        (0x04)
+
+/**
+ Set on an MFT entry if its default stream is backed by a WIM archive.
+ */
+#define DU_MFT_ENTRY_WIM_BACKED      (0x08)
+
+/**
+ Set on an MFT entry for a directory once its subdirectories have been
+ sorted into enumeration order.
+ */
+#define DU_MFT_ENTRY_CHILDREN_SORTED (0x10)
+
+/**
+ Information collected about a single file or directory while reading the
+ MFT.  One of these exists for every file record on the volume, indexed by
+ segment number.
+ */
+typedef struct _DU_MFT_ENTRY {
+
+    /**
+     Information which depends on whether the entry is a file or directory.
+     */
+    union {
+
+        /**
+         Information about a file.
+         */
+        struct {
+
+            /**
+             The space attributed to the default stream of the file.
+             */
+            LONGLONG DefaultStreamSpace;
+
+            /**
+             The space attributed to named streams of the file.
+             */
+            LONGLONG NamedStreamSpace;
+        } File;
+
+        /**
+         Information about a directory, populated once all file records
+         have been read.
+         */
+        struct {
+
+            /**
+             The space consumed by files within this directory.
+             */
+            LONGLONG SpaceConsumed;
+
+            /**
+             The segment number of the first subdirectory, or zero if there
+             are no subdirectories.
+             */
+            DWORD FirstChild;
+
+            /**
+             The number of files or directories within this directory.
+             */
+            DWORD ObjectsFound;
+        } Directory;
+    } u;
+
+    /**
+     The segment number of the directory containing the first name of this
+     file.
+     */
+    DWORD ParentSegment;
+
+    /**
+     For a directory, the segment number of the next subdirectory within
+     the same parent, or zero if this is the last subdirectory.
+     */
+    DWORD NextSibling;
+
+    /**
+     The offset within the MFT's name buffer of the name of this entry, in
+     characters.
+     */
+    DWORD NameOffset;
+
+    /**
+     The sequence number of the directory containing the first name of this
+     file.
+     */
+    WORD ParentSequence;
+
+    /**
+     The sequence number of the file record.
+     */
+    WORD Sequence;
+
+    /**
+     The number of names referring to this file, excluding short names.
+     */
+    WORD LinkCount;
+
+    /**
+     The length of the name of this entry, in characters.
+     */
+    UCHAR NameLength;
+
+    /**
+     Flags for this entry, including DU_MFT_ENTRY_IN_USE.
+     */
+    UCHAR Flags;
+} DU_MFT_ENTRY, *PDU_MFT_ENTRY;
+
+/**
+ An additional name for a file which has more than one hard link.
+ */
+typedef struct _DU_MFT_LINK {
+
+    /**
+     The segment number of the file.
+     */
+    DWORD FileSegment;
+
+    /**
+     The segment number of the directory containing this name.
+     */
+    DWORD ParentSegment;
+
+    /**
+     The sequence number of the directory containing this name.
+     */
+    WORD ParentSequence;
+} DU_MFT_LINK, *PDU_MFT_LINK;
+
+/**
+ Information collected from reading the MFT of a single volume.
+ */
+typedef struct _DU_MFT {
+
+    /**
+     The serial number of the volume.
+     */
+    DWORD VolumeSerialNumber;
+
+    /**
+     The number of bytes per cluster on the volume.
+     */
+    DWORD BytesPerCluster;
+
+    /**
+     The number of elements in the Entries array.
+     */
+    DWORD EntryCount;
+
+    /**
+     An array of entries, one per file record, indexed by segment number.
+     */
+    PDU_MFT_ENTRY Entries;
+
+    /**
+     The number of elements in use in the Links array.
+     */
+    DWORD LinkCount;
+
+    /**
+     The number of elements allocated in the Links array.
+     */
+    DWORD LinksAllocated;
+
+    /**
+     An array of additional names for files with more than one hard link.
+     */
+    PDU_MFT_LINK Links;
+
+    /**
+     The number of characters in use in the Names buffer.
+     */
+    DWORD NameCharsUsed;
+
+    /**
+     The number of characters allocated in the Names buffer.
+     */
+    DWORD NameCharsAllocated;
+
+    /**
+     A buffer containing the names of directories.  These are not NULL
+     terminated.
+     */
+    LPTSTR Names;
+} DU_MFT, *PDU_MFT;
+
+/**
+ The maximum number of worker threads that can calculate space in
+ subdirectories concurrently.
+ */
+#define DU_MAX_WORKERS (64)
+
+/**
+ The number of subdirectories that can be queued for each worker thread
+ before enumeration waits for results to be displayed.
+ */
+#define DU_JOBS_PER_WORKER (16)
+
+/**
+ A single top level subdirectory whose space is calculated by a worker
+ thread.
+ */
+typedef struct _DU_JOB {
+
+    /**
+     The entry for this job within the list of jobs in the order they were
+     found.  Results are displayed in this order.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The entry for this job within the list of jobs that have not yet been
+     picked up by a worker thread.
+     */
+    YORI_LIST_ENTRY PendingListEntry;
+
+    /**
+     The search criteria describing the contents of the subdirectory.  This
+     points into the same allocation as the job.
+     */
+    YORI_STRING FileSpec;
+
+    /**
+     Output generated by the worker for this subdirectory, which is
+     displayed once all earlier jobs have been displayed.
+     */
+    YORI_STRING Output;
+
+    /**
+     The total amount of space consumed within the subdirectory.
+     */
+    LONGLONG SpaceConsumed;
+
+    /**
+     Set to TRUE once the worker has finished with the subdirectory.
+     */
+    BOOLEAN Complete;
+} DU_JOB, *PDU_JOB;
+
+/**
+ The largest number of directories or files that can be displayed with
+ -top.
+ */
+#define DU_MAX_TOP_COUNT (0x10000)
+
+/**
+ A single directory or file retained because it is among the largest found.
+ */
+typedef struct _DU_TOP_ENTRY {
+
+    /**
+     The space consumed by the object.
+     */
+    LONGLONG SpaceConsumed;
+
+    /**
+     The full path to the object, in escaped form.
+     */
+    YORI_STRING Name;
+} DU_TOP_ENTRY, *PDU_TOP_ENTRY;
+
+/**
+ A bounded set of the largest objects found so far.  This is maintained as
+ a min-heap so the smallest retained object can be replaced in logarithmic
+ time, and memory does not grow with the number of objects found.
+ */
+typedef struct _DU_TOP {
+
+    /**
+     The maximum number of objects to retain.  Zero if the largest objects
+     are not being tracked.
+     */
+    DWORD Capacity;
+
+    /**
+     The number of objects currently retained.
+     */
+    DWORD Count;
+
+    /**
+     An array of Capacity elements, of which the first Count are in use.
+     */
+    PDU_TOP_ENTRY Entries;
+} DU_TOP, *PDU_TOP;
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
@@ -170,6 +622,12 @@ typedef struct _DU_CONTEXT {
      */
     BOOLEAN AverageHardLinkSize;
 
+    /**
+     Count the size of a file with multiple hard links once, at the first
+     link found.
+     */
+    BOOLEAN CountHardLinksOnce;
+
     /**
      Count space used by alternate data streams on the file.
      */
@@ -181,6 +639,24 @@ typedef struct _DU_CONTEXT {
      */
     BOOLEAN WimBackedFilesAsZero;
 
+    /**
+     Set to TRUE if ColorRules are owned by another context and should not
+     be freed when this context is cleaned up.
+     */
+    BOOLEAN SharedColorRules;
+
+    /**
+     Set to TRUE to indicate worker threads should exit once no more jobs
+     are pending.
+     */
+    BOOLEAN Shutdown;
+
+    /**
+     Set to TRUE to attempt to calculate space by reading the NTFS MFT
+     rather than enumerating directories.
+     */
+    BOOLEAN UseMft;
+
     /**
      The color to display file sizes in.
      */
@@ -206,23 +682,325 @@ typedef struct _DU_CONTEXT {
      */
     YORI_LIB_FILE_FILTER ColorRules;
 
-} DU_CONTEXT, *PDU_CONTEXT;
+    /**
+     A buffer used to format a single line of output.
+     */
+    YORI_STRING OutputLine;
 
-/**
- Deallocate all child allocations within a DU_CONTEXT structure.  The
- structure itself is typically stack allocated and will not be freed.
+    /**
+     Information collected from reading the MFT of the most recently used
+     volume, or NULL if the MFT has not been read.
+     */
+    PDU_MFT Mft;
 
- @param DuContext Pointer to the DuContext to clean up.
- */
-VOID
-DuCleanupContext(
-    __in PDU_CONTEXT DuContext
-    )
-{
-    YORI_ALLOC_SIZE_T Index;
+    /**
+     If CountHardLinksOnce is TRUE, the set of files counted so far.  This
+     is shared between the main context and worker contexts.
+     */
+    PDU_FILE_ID_SET FileIdSet;
+
+    /**
+     If the user requested only the largest objects be displayed, the
+     largest directories found so far.
+     */
+    DU_TOP TopDirectories;
+
+    /**
+     If the user requested only the largest objects be displayed, the
+     largest files found so far.
+     */
+    DU_TOP TopFiles;
+
+    /**
+     If not NULL, output is appended to this string rather than written to
+     standard output.  This is used by worker threads so results can be
+     displayed in the order subdirectories were found.
+     */
+    PYORI_STRING OutputBuffer;
+
+    /**
+     The flags to use when enumerating.
+     */
+    WORD MatchFlags;
+
+    /**
+     The function to invoke when a directory cannot be enumerated, used by
+     worker threads enumerating subdirectories.
+     */
+    PYORILIB_FILE_ENUM_ERROR_FN ErrorCallback;
+
+    /**
+     The list of jobs that have been queued and whose results have not been
+     displayed, in the order they were found.
+     */
+    YORI_LIST_ENTRY JobList;
+
+    /**
+     The list of jobs which have not yet been picked up by a worker thread.
+     */
+    YORI_LIST_ENTRY PendingJobList;
+
+    /**
+     The number of jobs in JobList.
+     */
+    DWORD JobsQueued;
+
+    /**
+     The maximum number of jobs that can be queued before enumeration waits
+     for results to be displayed.
+     */
+    DWORD MaximumJobsQueued;
+
+    /**
+     The number of worker threads.  Zero if space is calculated on the
+     calling thread.
+     */
+    DWORD WorkerCount;
+
+    /**
+     An array of handles to worker threads.
+     */
+    PHANDLE Workers;
+
+    /**
+     A mutex protecting the job lists and the state of each job.
+     */
+    HANDLE Mutex;
+
+    /**
+     A manual reset event signalled when jobs are pending or worker threads
+     should exit.
+     */
+    HANDLE WorkAvailableEvent;
+
+    /**
+     An auto reset event signalled whenever a worker completes a job.
+     */
+    HANDLE JobCompleteEvent;
+
+} DU_CONTEXT, *PDU_CONTEXT;
+
+/**
+ Free information collected from reading the MFT.
+
+ @param Mft Pointer to the information to free.
+ */
+VOID
+DuMftFree(
+    __in PDU_MFT Mft
+    )
+{
+    if (Mft->Entries != NULL) {
+        YoriLibFree(Mft->Entries);
+    }
+    if (Mft->Links != NULL) {
+        YoriLibFree(Mft->Links);
+    }
+    if (Mft->Names != NULL) {
+        YoriLibFree(Mft->Names);
+    }
+    YoriLibFree(Mft);
+}
+
+/**
+ Prepare a set of the largest objects.
+
+ @param Top Pointer to the set to initialize.
+
+ @param Capacity The number of objects to retain.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+DuTopInitialize(
+    __out PDU_TOP Top,
+    __in DWORD Capacity
+    )
+{
+    DWORD Index;
+
+    Top->Count = 0;
+    Top->Capacity = 0;
+    Top->Entries = YoriLibMalloc(Capacity * sizeof(DU_TOP_ENTRY));
+    if (Top->Entries == NULL) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < Capacity; Index++) {
+        Top->Entries[Index].SpaceConsumed = 0;
+        YoriLibInitEmptyString(&Top->Entries[Index].Name);
+    }
+    Top->Capacity = Capacity;
+    return TRUE;
+}
+
+/**
+ Free a set of the largest objects.
+
+ @param Top Pointer to the set to free.
+ */
+VOID
+DuTopCleanup(
+    __in PDU_TOP Top
+    )
+{
+    DWORD Index;
+
+    if (Top->Entries != NULL) {
+        for (Index = 0; Index < Top->Capacity; Index++) {
+            YoriLibFreeStringContents(&Top->Entries[Index].Name);
+        }
+        YoriLibFree(Top->Entries);
+        Top->Entries = NULL;
+    }
+    Top->Capacity = 0;
+    Top->Count = 0;
+}
+
+/**
+ Move an element down a min-heap until neither of its children are smaller
+ than it.
+
+ @param Entries Pointer to the array of heap elements.
+
+ @param Index The index of the element to move.
+
+ @param Count The number of elements within the heap.
+ */
+VOID
+DuTopSiftDown(
+    __in PDU_TOP_ENTRY Entries,
+    __in DWORD Index,
+    __in DWORD Count
+    )
+{
+    DWORD Child;
+    DU_TOP_ENTRY Swap;
+
+    while (TRUE) {
+        Child = Index * 2 + 1;
+        if (Child >= Count) {
+            break;
+        }
+        if (Child + 1 < Count &&
+            Entries[Child + 1].SpaceConsumed < Entries[Child].SpaceConsumed) {
+            Child++;
+        }
+        if (Entries[Index].SpaceConsumed <= Entries[Child].SpaceConsumed) {
+            break;
+        }
+        memcpy(&Swap, &Entries[Index], sizeof(DU_TOP_ENTRY));
+        memcpy(&Entries[Index], &Entries[Child], sizeof(DU_TOP_ENTRY));
+        memcpy(&Entries[Child], &Swap, sizeof(DU_TOP_ENTRY));
+        Index = Child;
+    }
+}
+
+/**
+ Offer an object to a set of the largest objects.  If the set is full and
+ the object is larger than the smallest retained object, the smallest is
+ discarded.
+
+ @param Top Pointer to the set of largest objects.
+
+ @param SpaceConsumed The space consumed by the object.
+
+ @param Name Pointer to the full path to the object.
+ */
+VOID
+DuTopAdd(
+    __in PDU_TOP Top,
+    __in LONGLONG SpaceConsumed,
+    __in PYORI_STRING Name
+    )
+{
+    DWORD Index;
+    DWORD Parent;
+    DU_TOP_ENTRY Swap;
+
+    if (Top->Count < Top->Capacity) {
+
+        //
+        //  There is space for the object, so add it as a leaf and move it
+        //  up until its parent is no larger than it.
+        //
+
+        Index = Top->Count;
+        if (YoriLibYPrintf(&Top->Entries[Index].Name, _T("%y"), Name) < 0) {
+            return;
+        }
+        Top->Entries[Index].SpaceConsumed = SpaceConsumed;
+        Top->Count++;
+
+        while (Index > 0) {
+            Parent = (Index - 1) / 2;
+            if (Top->Entries[Parent].SpaceConsumed <= Top->Entries[Index].SpaceConsumed) {
+                break;
+            }
+            memcpy(&Swap, &Top->Entries[Index], sizeof(DU_TOP_ENTRY));
+            memcpy(&Top->Entries[Index], &Top->Entries[Parent], sizeof(DU_TOP_ENTRY));
+            memcpy(&Top->Entries[Parent], &Swap, sizeof(DU_TOP_ENTRY));
+            Index = Parent;
+        }
+        return;
+    }
+
+    if (Top->Count == 0 || SpaceConsumed <= Top->Entries[0].SpaceConsumed) {
+        return;
+    }
+
+    //
+    //  Replace the smallest object, reusing its name allocation where
+    //  possible, and restore the heap.
+    //
+
+    if (YoriLibYPrintf(&Top->Entries[0].Name, _T("%y"), Name) < 0) {
+        return;
+    }
+    Top->Entries[0].SpaceConsumed = SpaceConsumed;
+    DuTopSiftDown(Top->Entries, 0, Top->Count);
+}
+
+/**
+ Offer every object in one set of largest objects to another.  This is used
+ to combine the results from worker threads.
+
+ @param Dest Pointer to the set of largest objects to update.
+
+ @param Source Pointer to the set of largest objects to add to Dest.
+ */
+VOID
+DuTopMerge(
+    __in PDU_TOP Dest,
+    __in PDU_TOP Source
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < Source->Count; Index++) {
+        DuTopAdd(Dest, Source->Entries[Index].SpaceConsumed, &Source->Entries[Index].Name);
+    }
+}
+
+/**
+ Deallocate all child allocations within a DU_CONTEXT structure.  The
+ structure itself is typically stack allocated and will not be freed.
+
+ @param DuContext Pointer to the DuContext to clean up.
+ */
+VOID
+DuCleanupContext(
+    __in PDU_CONTEXT DuContext
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
 
     for (Index = 0; Index < DuContext->StackAllocated; Index++) {
         YoriLibFreeStringContents(&DuContext->DirStack[Index].DirectoryName);
+        YoriLibFreeStringContents(&DuContext->DirStack[Index].FileIds.Names);
+        if (DuContext->DirStack[Index].FileIds.Entries != NULL) {
+            YoriLibFree(DuContext->DirStack[Index].FileIds.Entries);
+        }
     }
 
     if (DuContext->DirStack != NULL) {
@@ -232,7 +1010,57 @@ DuCleanupContext(
 
     DuContext->StackAllocated = 0;
     DuContext->StackIndex = 0;
-    YoriLibFileFiltFreeFilter(&DuContext->ColorRules);
+    YoriLibFreeStringContents(&DuContext->OutputLine);
+    if (DuContext->Mft != NULL) {
+        DuMftFree(DuContext->Mft);
+        DuContext->Mft = NULL;
+    }
+    DuTopCleanup(&DuContext->TopDirectories);
+    DuTopCleanup(&DuContext->TopFiles);
+    if (!DuContext->SharedColorRules) {
+        YoriLibFileFiltFreeFilter(&DuContext->ColorRules);
+    }
+}
+
+/**
+ Append a string to a buffer of output, growing the buffer as needed.
+
+ @param Buffer Pointer to the buffer of output to append to.
+
+ @param String Pointer to the string to append.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+DuAppendOutput(
+    __inout PYORI_STRING Buffer,
+    __in PYORI_STRING String
+    )
+{
+    DWORD LengthRequired;
+    DWORD LengthToAllocate;
+
+    LengthRequired = Buffer->LengthInChars + String->LengthInChars + 1;
+    if (LengthRequired > Buffer->LengthAllocated) {
+        LengthToAllocate = Buffer->LengthAllocated * 2;
+        if (LengthToAllocate < LengthRequired + 0x400) {
+            LengthToAllocate = LengthRequired + 0x400;
+        }
+        if (!YoriLibIsSizeAllocatable(LengthToAllocate)) {
+            LengthToAllocate = LengthRequired;
+            if (!YoriLibIsSizeAllocatable(LengthToAllocate)) {
+                return FALSE;
+            }
+        }
+        if (!YoriLibReallocString(Buffer, (YORI_ALLOC_SIZE_T)LengthToAllocate)) {
+            return FALSE;
+        }
+    }
+
+    memcpy(&Buffer->StartOfString[Buffer->LengthInChars], String->StartOfString, String->LengthInChars * sizeof(TCHAR));
+    Buffer->LengthInChars = Buffer->LengthInChars + String->LengthInChars;
+    Buffer->StartOfString[Buffer->LengthInChars] = '\0';
+    return TRUE;
 }
 
 /**
@@ -254,11 +1082,149 @@ DuCloseStack(
     DirStack->ObjectsFoundThisDirectory = 0;
     DirStack->SpaceConsumedThisDirectory = 0;
     DirStack->SpaceConsumedInChildren = 0;
+    DirStack->FileIds.Loaded = FALSE;
+}
+
+/**
+ Display the space consumed by a directory or file.
+
+ @param DuContext Pointer to the DuContext specifying how to display the
+        object and where to send output.
+
+ @param ObjectName Pointer to the full path to the object, in escaped form.
+
+ @param SizeToDisplay The space consumed by the object.
+ */
+VOID
+DuDisplaySpace(
+    __in PDU_CONTEXT DuContext,
+    __in PYORI_STRING ObjectName,
+    __in LARGE_INTEGER SizeToDisplay
+    )
+{
+    YORI_STRING UnescapedPath;
+    PYORI_STRING StringToDisplay;
+    YORI_STRING FileSizeString;
+    TCHAR FileSizeStringBuffer[8];
+    YORI_STRING VtAttribute;
+    TCHAR VtAttributeBuffer[YORI_MAX_VT_ESCAPE_CHARS];
+    YORILIB_COLOR_ATTRIBUTES Attribute;
+    YORI_SIGNED_ALLOC_SIZE_T LineLength;
+
+    //
+    //  Convert the escaped path into a path for humans.
+    //
+
+    YoriLibInitEmptyString(&UnescapedPath);
+    if (YoriLibUnescapePath(ObjectName, &UnescapedPath)) {
+        StringToDisplay = &UnescapedPath;
+    } else {
+        StringToDisplay = ObjectName;
+    }
+
+    //
+    //  Convert the file size from a number of bytes to a short string
+    //  with a suffix
+    //
+
+    YoriLibInitEmptyString(&FileSizeString);
+    FileSizeString.StartOfString = FileSizeStringBuffer;
+    FileSizeString.LengthAllocated = sizeof(FileSizeStringBuffer)/sizeof(FileSizeStringBuffer[0]);
+    YoriLibFileSizeToString(&FileSizeString, &SizeToDisplay);
+
+    //
+    //  If the user requested it, determine the color to display with
+    //
+
+    YoriLibInitEmptyString(&VtAttribute);
+    if (DuContext->ColorRules.NumberCriteria) {
+        WIN32_FIND_DATA FileInfo;
+
+        VtAttribute.StartOfString = VtAttributeBuffer;
+        VtAttribute.LengthAllocated = sizeof(VtAttributeBuffer)/sizeof(VtAttributeBuffer[0]);
+
+        if (!YoriLibUpdateFindDataFromFileInformation(&FileInfo, ObjectName->StartOfString, TRUE) || 
+            !YoriLibFileFiltCheckColorMatch(&DuContext->ColorRules, ObjectName, &FileInfo, &Attribute)) {
+            Attribute.Ctrl = YORILIB_ATTRCTRL_WINDOW_BG | YORILIB_ATTRCTRL_WINDOW_FG;
+            Attribute.Win32Attr = (UCHAR)YoriLibVtGetDefaultColor();
+        }
+
+        YoriLibVtStringForTextAttribute(&VtAttribute, Attribute.Ctrl, Attribute.Win32Attr);
+    }
+
+    if (VtAttribute.LengthInChars > 0) {
+        LineLength = YoriLibYPrintf(&DuContext->OutputLine,
+                                    _T("%y%y%c[0m %y%y%c[0m\n"),
+                                    &DuContext->FileSizeColorString,
+                                    &FileSizeString,
+                                    27,
+                                    &VtAttribute,
+                                    StringToDisplay,
+                                    27);
+    } else {
+        LineLength = YoriLibYPrintf(&DuContext->OutputLine, _T("%y %y\n"), &FileSizeString, StringToDisplay);
+    }
+
+    //
+    //  Worker threads buffer output so it can be displayed in
+    //  order once earlier subdirectories have been displayed.
+    //
+
+    if (LineLength > 0) {
+        if (DuContext->OutputBuffer != NULL) {
+            DuAppendOutput(DuContext->OutputBuffer, &DuContext->OutputLine);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DuContext->OutputLine);
+        }
+    }
+
+    YoriLibFreeStringContents(&UnescapedPath);
+}
+
+/**
+ Display the objects within a set of the largest objects, largest first.
+ This reorders the set, so no objects can be added after it is displayed.
+
+ @param DuContext Pointer to the DuContext specifying how to display each
+        object.
+
+ @param Top Pointer to the set of largest objects.
+ */
+VOID
+DuTopDisplay(
+    __in PDU_CONTEXT DuContext,
+    __in PDU_TOP Top
+    )
+{
+    DWORD Index;
+    DWORD Count;
+    DU_TOP_ENTRY Swap;
+    LARGE_INTEGER SizeToDisplay;
+
+    //
+    //  Repeatedly move the smallest remaining object to the end of the
+    //  heap, leaving the array sorted from largest to smallest.
+    //
+
+    for (Count = Top->Count; Count > 1; Count--) {
+        memcpy(&Swap, &Top->Entries[0], sizeof(DU_TOP_ENTRY));
+        memcpy(&Top->Entries[0], &Top->Entries[Count - 1], sizeof(DU_TOP_ENTRY));
+        memcpy(&Top->Entries[Count - 1], &Swap, sizeof(DU_TOP_ENTRY));
+        DuTopSiftDown(Top->Entries, 0, Count - 1);
+    }
+
+    for (Index = 0; Index < Top->Count; Index++) {
+        SizeToDisplay.QuadPart = Top->Entries[Index].SpaceConsumed;
+        DuDisplaySpace(DuContext, &Top->Entries[Index].Name, SizeToDisplay);
+    }
+    Top->Count = 0;
 }
 
 /**
  Print the space consumed by a particular directory, and close out the
- directory's stack frame so it can be reused by the next directory.
+ directory's stack frame so it can be reused by the next directory.  If the
+ user requested only the largest directories be displayed, the directory is
+ retained for display later rather than displayed.
 
  @param DuContext Pointer to the DuContext which contains the directory to
         display and close.
@@ -273,544 +1239,2182 @@ DuReportAndCloseStack(
     __in DWORD Depth
     )
 {
-    YORI_STRING UnescapedPath;
-    PYORI_STRING StringToDisplay;
-    YORI_STRING FileSizeString;
-    TCHAR FileSizeStringBuffer[8];
     LARGE_INTEGER SizeToDisplay;
-    YORI_STRING VtAttribute;
-    TCHAR VtAttributeBuffer[YORI_MAX_VT_ESCAPE_CHARS];
-    YORILIB_COLOR_ATTRIBUTES Attribute;
+    PDU_DIRECTORY_STACK DirStack;
+
+    DirStack = &DuContext->DirStack[Depth];
+
+    if (DuContext->MaximumDepthToDisplay == 0 ||
+        Depth <= DuContext->MaximumDepthToDisplay) {
+
+        SizeToDisplay.QuadPart = DirStack->SpaceConsumedInChildren + DirStack->SpaceConsumedThisDirectory;
+
+        if (DuContext->MinimumDirectorySizeToDisplay.QuadPart == 0 ||
+            SizeToDisplay.QuadPart >= DuContext->MinimumDirectorySizeToDisplay.QuadPart) {
+
+            if (DuContext->TopDirectories.Capacity > 0) {
+                DuTopAdd(&DuContext->TopDirectories, SizeToDisplay.QuadPart, &DirStack->DirectoryName);
+            } else {
+                DuDisplaySpace(DuContext, &DirStack->DirectoryName, SizeToDisplay);
+            }
+        }
+    }
+
+    DuCloseStack(DirStack);
+    return TRUE;
+}
+
+/**
+ Display all directory frames which have not been otherwise displayed because
+ no object has been found in a subsequent directory.
+
+ @param DuContext Pointer to the DuContext which may contain active directory
+        frames.
+
+ @param MinDepthToDisplay Indicates the minimum depth number that should be
+        displayed to the user.  Frames below this are cleared for reuse but
+        not displayed.
+
+ @param SpaceConsumed Optionally points to a location to receive the total
+        space consumed within the outermost directory frame.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+DuReportAndCloseAllActiveStacks(
+    __in PDU_CONTEXT DuContext,
+    __in DWORD MinDepthToDisplay,
+    __out_opt PLONGLONG SpaceConsumed
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    if (SpaceConsumed != NULL) {
+        *SpaceConsumed = 0;
+    }
+
+    Index = DuContext->StackIndex;
+    if (Index >= DuContext->StackAllocated) {
+        ASSERT(Index == 0);
+        ASSERT(DuContext->DirStack == NULL);
+        return TRUE;
+    }
+    while (TRUE) {
+        if (Index > 0) {
+            DuContext->DirStack[Index - 1].SpaceConsumedInChildren +=
+                DuContext->DirStack[Index].SpaceConsumedInChildren +
+                DuContext->DirStack[Index].SpaceConsumedThisDirectory;
+        } else if (SpaceConsumed != NULL) {
+            *SpaceConsumed = DuContext->DirStack[Index].SpaceConsumedInChildren +
+                             DuContext->DirStack[Index].SpaceConsumedThisDirectory;
+        }
+        if (Index >= MinDepthToDisplay) {
+            DuReportAndCloseStack(DuContext, Index);
+        } else {
+            DuCloseStack(&DuContext->DirStack[Index]);
+        }
+        if (Index == 0) {
+            break;
+        }
+        Index--;
+        DuContext->StackIndex--;
+    }
+    return TRUE;
+}
+
+/**
+ Initialize a single directory stack location.
+
+ @param DuContext Pointer to the DU context specifying the options to apply.
+
+ @param DirStack Pointer to the directory stack location to initialize.
+
+ @param DirName Pointer to the directory name to initialize in the stack.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+DuInitializeDirectoryStack(
+    __in PDU_CONTEXT DuContext,
+    __in PDU_DIRECTORY_STACK DirStack,
+    __in PYORI_STRING DirName
+    )
+{
+    DWORD SectorsPerCluster;
+    DWORD BytesPerSector;
+    DWORD NumberOfFreeClusters;
+    DWORD TotalNumberOfClusters;
+
+    if (DirStack->DirectoryName.LengthAllocated <= DirName->LengthInChars) {
+        YoriLibFreeStringContents(&DirStack->DirectoryName);
+        if (!YoriLibAllocateString(&DirStack->DirectoryName, DirName->LengthInChars + 80)) {
+            return FALSE;
+        }
+    }
+
+    memcpy(DirStack->DirectoryName.StartOfString, DirName->StartOfString, DirName->LengthInChars * sizeof(TCHAR));
+    DirStack->DirectoryName.StartOfString[DirName->LengthInChars] = '\0';
+    DirStack->DirectoryName.LengthInChars = DirName->LengthInChars;
+    DirStack->FileIds.Loaded = FALSE;
+
+    //
+    //  If GetDiskFreeSpace fails, see if it works on the effective root.
+    //  This is to support systems without mount points where this call can
+    //  fail when called on a directory.
+    //
+
+    if (DuContext->AllocationSize) {
+        if (!GetDiskFreeSpace(DirStack->DirectoryName.StartOfString, &SectorsPerCluster, &BytesPerSector, &NumberOfFreeClusters, &TotalNumberOfClusters)) {
+            YORI_STRING EffectiveRoot;
+
+            DirStack->AllocationSize = 4096;
+
+            if (YoriLibFindEffRoot(&DirStack->DirectoryName, &EffectiveRoot) &&
+                EffectiveRoot.LengthInChars < DirStack->DirectoryName.LengthInChars) {
+
+                TCHAR SavedChar;
+                SavedChar = EffectiveRoot.StartOfString[EffectiveRoot.LengthInChars];
+                EffectiveRoot.StartOfString[EffectiveRoot.LengthInChars] = '\0';
+
+                if (GetDiskFreeSpace(EffectiveRoot.StartOfString, &SectorsPerCluster, &BytesPerSector, &NumberOfFreeClusters, &TotalNumberOfClusters)) {
+                    DirStack->AllocationSize = SectorsPerCluster * BytesPerSector;
+                }
+
+                EffectiveRoot.StartOfString[EffectiveRoot.LengthInChars] = SavedChar;
+            }
+
+        } else {
+            DirStack->AllocationSize = SectorsPerCluster * BytesPerSector;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Add a file to the set of files which have been counted.
+
+ @param Set Pointer to the set.
+
+ @param Key Pointer to the identifier of the file.
+
+ @return TRUE if the file was not previously in the set, so should be
+         counted, or FALSE if it has already been counted.
+ */
+BOOLEAN
+DuFileIdSetInsert(
+    __in PDU_FILE_ID_SET Set,
+    __in PDU_FILE_ID Key
+    )
+{
+    PDU_FILE_ID NewEntries;
+    PDU_FILE_ID Entry;
+    DWORD NewCapacity;
+    DWORD Index;
+    DWORD Mask;
+    DWORD Hash;
+    BOOLEAN Inserted;
+
+    //
+    //  An ID of zero is used to indicate an unused entry.  File systems
+    //  which report this ID don't support hard links, so the file is always
+    //  counted.
+    //
+
+    if (Key->FileId == 0) {
+        return TRUE;
+    }
+
+    if (Set->Mutex != NULL) {
+        WaitForSingleObject(Set->Mutex, INFINITE);
+    }
+
+    //
+    //  Keep the table at most half full, so searches end quickly.  If it
+    //  can't grow, continue with the existing table until it's full, and
+    //  then count every file.
+    //
+
+    if ((Set->Count + 1) * 2 > Set->Capacity) {
+        NewCapacity = Set->Capacity * 2;
+        if (NewCapacity == 0) {
+            NewCapacity = DU_FILE_ID_SET_INITIAL_CAPACITY;
+        }
+
+        NewEntries = NULL;
+        if (YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)NewCapacity * sizeof(DU_FILE_ID))) {
+            NewEntries = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewCapacity * sizeof(DU_FILE_ID)));
+        }
+
+        if (NewEntries != NULL) {
+            ZeroMemory(NewEntries, NewCapacity * sizeof(DU_FILE_ID));
+            Mask = NewCapacity - 1;
+            for (Index = 0; Index < Set->Capacity; Index++) {
+                Entry = &Set->Entries[Index];
+                if (Entry->FileId != 0) {
+                    Hash = (DWORD)(((Entry->FileId ^ (Entry->VolumeSerialNumber << 32)) * 0x9E3779B97F4A7C15ULL) >> 32);
+                    while (NewEntries[Hash & Mask].FileId != 0) {
+                        Hash++;
+                    }
+                    NewEntries[Hash & Mask] = *Entry;
+                }
+            }
+
+            if (Set->Entries != NULL) {
+                YoriLibFree(Set->Entries);
+            }
+            Set->Entries = NewEntries;
+            Set->Capacity = NewCapacity;
+        } else if (Set->Count + 1 >= Set->Capacity) {
+            if (Set->Mutex != NULL) {
+                ReleaseMutex(Set->Mutex);
+            }
+            return TRUE;
+        }
+    }
+
+    Mask = Set->Capacity - 1;
+    Hash = (DWORD)(((Key->FileId ^ (Key->VolumeSerialNumber << 32)) * 0x9E3779B97F4A7C15ULL) >> 32);
+    Inserted = TRUE;
+    while (TRUE) {
+        Entry = &Set->Entries[Hash & Mask];
+        if (Entry->FileId == 0) {
+            *Entry = *Key;
+            Set->Count++;
+            break;
+        }
+        if (Entry->FileId == Key->FileId &&
+            Entry->VolumeSerialNumber == Key->VolumeSerialNumber) {
+
+            Inserted = FALSE;
+            break;
+        }
+        Hash++;
+    }
+
+    if (Set->Mutex != NULL) {
+        ReleaseMutex(Set->Mutex);
+    }
+
+    return Inserted;
+}
+
+/**
+ Free the contents of a file ID set.
+
+ @param Set Pointer to the set.
+ */
+VOID
+DuFileIdSetCleanup(
+    __in PDU_FILE_ID_SET Set
+    )
+{
+    if (Set->Entries != NULL) {
+        YoriLibFree(Set->Entries);
+        Set->Entries = NULL;
+    }
+    Set->Capacity = 0;
+    Set->Count = 0;
+
+    if (Set->Mutex != NULL) {
+        CloseHandle(Set->Mutex);
+        Set->Mutex = NULL;
+    }
+}
+
+/**
+ Add an entry returned from reading a directory to the file IDs for the
+ directory.
+
+ @param FileIds Pointer to the file IDs for the directory.
+
+ @param DirInfo Pointer to the entry returned from reading the directory.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+DuAddDirectoryFileId(
+    __in PDU_DIRECTORY_FILE_IDS FileIds,
+    __in PYORI_FILE_ID_BOTH_DIR_INFO DirInfo
+    )
+{
+    PDU_DIRECTORY_FILE_ID NewEntries;
+    PDU_DIRECTORY_FILE_ID Entry;
+    DWORD NameLength;
+    DWORD NewAllocated;
+    DWORD LengthRequired;
+
+    if (FileIds->Count >= FileIds->Allocated) {
+        NewAllocated = FileIds->Allocated * 2;
+        if (NewAllocated < 256) {
+            NewAllocated = 256;
+        }
+        if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)NewAllocated * sizeof(DU_DIRECTORY_FILE_ID))) {
+            return FALSE;
+        }
+        NewEntries = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(DU_DIRECTORY_FILE_ID)));
+        if (NewEntries == NULL) {
+            return FALSE;
+        }
+        if (FileIds->Entries != NULL) {
+            memcpy(NewEntries, FileIds->Entries, FileIds->Count * sizeof(DU_DIRECTORY_FILE_ID));
+            YoriLibFree(FileIds->Entries);
+        }
+        FileIds->Entries = NewEntries;
+        FileIds->Allocated = NewAllocated;
+    }
+
+    NameLength = DirInfo->FileNameLength / sizeof(WCHAR);
+    LengthRequired = FileIds->Names.LengthInChars + NameLength;
+    if (LengthRequired > FileIds->Names.LengthAllocated) {
+        NewAllocated = FileIds->Names.LengthAllocated * 2;
+        if (NewAllocated < LengthRequired + 0x1000) {
+            NewAllocated = LengthRequired + 0x1000;
+        }
+        if (!YoriLibIsSizeAllocatable(NewAllocated * sizeof(TCHAR))) {
+            return FALSE;
+        }
+        if (!YoriLibReallocString(&FileIds->Names, (YORI_ALLOC_SIZE_T)NewAllocated)) {
+            return FALSE;
+        }
+    }
+
+    Entry = &FileIds->Entries[FileIds->Count];
+    Entry->FileId = (DWORDLONG)DirInfo->FileId.QuadPart;
+    Entry->NameOffset = FileIds->Names.LengthInChars;
+    Entry->NameLength = NameLength;
+    memcpy(&FileIds->Names.StartOfString[FileIds->Names.LengthInChars], DirInfo->FileName, NameLength * sizeof(WCHAR));
+    FileIds->Names.LengthInChars = FileIds->Names.LengthInChars + (YORI_ALLOC_SIZE_T)NameLength;
+    FileIds->Count++;
+
+    return TRUE;
+}
+
+/**
+ Read the file IDs of every file in a directory.  This is done with large
+ requests against the directory, so the file ID of each file is known
+ without opening it.
+
+ @param DirStack Pointer to the directory frame to read file IDs for.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+DuLoadDirectoryFileIds(
+    __in PDU_DIRECTORY_STACK DirStack
+    )
+{
+    PDU_DIRECTORY_FILE_IDS FileIds;
+    PYORI_FILE_ID_BOTH_DIR_INFO DirInfo;
+    BY_HANDLE_FILE_INFORMATION DirHandleInfo;
+    HANDLE DirHandle;
+    PUCHAR Buffer;
+    DWORD InfoClass;
+    DWORD Offset;
+    DWORD Err;
+
+    FileIds = &DirStack->FileIds;
+    FileIds->Loaded = TRUE;
+    FileIds->Count = 0;
+    FileIds->Cursor = 0;
+    FileIds->Names.LengthInChars = 0;
+
+    if (DllKernel32.pGetFileInformationByHandleEx == NULL) {
+        return FALSE;
+    }
+
+    DirHandle = CreateFile(DirStack->DirectoryName.StartOfString,
+                           FILE_LIST_DIRECTORY|SYNCHRONIZE,
+                           FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                           NULL,
+                           OPEN_EXISTING,
+                           FILE_FLAG_BACKUP_SEMANTICS,
+                           NULL);
+
+    if (DirHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    if (!GetFileInformationByHandle(DirHandle, &DirHandleInfo)) {
+        CloseHandle(DirHandle);
+        return FALSE;
+    }
+    FileIds->VolumeSerialNumber = DirHandleInfo.dwVolumeSerialNumber;
+
+    Buffer = YoriLibMalloc(DU_FILE_ID_BUFFER_SIZE);
+    if (Buffer == NULL) {
+        CloseHandle(DirHandle);
+        return FALSE;
+    }
+
+    Err = ERROR_SUCCESS;
+    InfoClass = YoriFileIdBothDirectoryRestartInfo;
+    while (DllKernel32.pGetFileInformationByHandleEx(DirHandle, InfoClass, Buffer, DU_FILE_ID_BUFFER_SIZE)) {
+        InfoClass = YoriFileIdBothDirectoryInfo;
+        Offset = 0;
+        while (TRUE) {
+            DirInfo = (PYORI_FILE_ID_BOTH_DIR_INFO)(Buffer + Offset);
+            if ((DirInfo->FileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 &&
+                !DuAddDirectoryFileId(FileIds, DirInfo)) {
+
+                Err = ERROR_NOT_ENOUGH_MEMORY;
+                break;
+            }
+
+            if (DirInfo->NextEntryOffset == 0) {
+                break;
+            }
+            Offset = Offset + DirInfo->NextEntryOffset;
+        }
+
+        if (Err != ERROR_SUCCESS) {
+            break;
+        }
+    }
+
+    if (Err == ERROR_SUCCESS) {
+        Err = GetLastError();
+        if (Err == ERROR_NO_MORE_FILES) {
+            Err = ERROR_SUCCESS;
+        }
+    }
+
+    YoriLibFree(Buffer);
+    CloseHandle(DirHandle);
+
+    if (Err != ERROR_SUCCESS) {
+        FileIds->Count = 0;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Determine whether a file should be counted when counting hard linked files
+ once.  The file ID is found from the file IDs read from its directory, and
+ the file is counted if that ID has not been counted before.  If the file ID
+ cannot be determined, the file is counted.
+
+ @param DuContext Pointer to the du context, containing the set of files
+        counted so far.
+
+ @param DirStack Pointer to the frame for the directory containing the file.
+
+ @param FileInfo Pointer to information about the file from enumeration.
+
+ @return TRUE if the file should be counted, FALSE if it has already been
+         counted under another name.
+ */
+BOOLEAN
+DuIsFirstLinkToFile(
+    __in PDU_CONTEXT DuContext,
+    __in PDU_DIRECTORY_STACK DirStack,
+    __in PWIN32_FIND_DATA FileInfo
+    )
+{
+    PDU_DIRECTORY_FILE_IDS FileIds;
+    PDU_DIRECTORY_FILE_ID Entry;
+    DU_FILE_ID Key;
+    DWORD NameLength;
+    DWORD Index;
+    DWORD Searched;
+
+    FileIds = &DirStack->FileIds;
+    if (!FileIds->Loaded) {
+        DuLoadDirectoryFileIds(DirStack);
+    }
+
+    if (FileIds->Count == 0) {
+        return TRUE;
+    }
+
+    //
+    //  Files are normally found in the same order as the IDs were read, so
+    //  the search starts after the previous file found and usually ends
+    //  on the first comparison.
+    //
+
+    NameLength = (DWORD)_tcslen(FileInfo->cFileName);
+    Index = FileIds->Cursor;
+    for (Searched = 0; Searched < FileIds->Count; Searched++) {
+        if (Index >= FileIds->Count) {
+            Index = 0;
+        }
+        Entry = &FileIds->Entries[Index];
+        Index++;
+        if (Entry->NameLength == NameLength &&
+            memcmp(&FileIds->Names.StartOfString[Entry->NameOffset], FileInfo->cFileName, NameLength * sizeof(TCHAR)) == 0) {
+
+            FileIds->Cursor = Index;
+            Key.FileId = Entry->FileId;
+            Key.VolumeSerialNumber = FileIds->VolumeSerialNumber;
+            return DuFileIdSetInsert(DuContext->FileIdSet, &Key);
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Count the amount of disk space to attribute to a file given the user selected
+ options.
+
+ @param DuContext Context specifying the accounting options to apply.
+
+ @param DirStack Pointer to the directory stack indicating the allocation size
+        used for the directory.
+
+ @param FilePath Pointer to a fully specified path to the file.
+
+ @param FileInfo Pointer to the block of data returned from directory
+        enumerate.
+
+ @return The number of bytes attributable to the file.
+ */
+LARGE_INTEGER
+DuCalculateSpaceUsedByFile(
+    __in PDU_CONTEXT DuContext,
+    __in PDU_DIRECTORY_STACK DirStack,
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo
+    )
+{
+    LARGE_INTEGER FileSize;
+    HANDLE FileHandle = INVALID_HANDLE_VALUE;
+    BOOL ForceSizeZero = FALSE;
+    BOOL ReportedOpenError = FALSE;
+
+    FileSize.QuadPart = 0;
+
+    if (DuContext->AverageHardLinkSize || DuContext->WimBackedFilesAsZero) {
+
+        FileHandle = CreateFile(FilePath->StartOfString,
+                                FILE_READ_ATTRIBUTES|SYNCHRONIZE,
+                                FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                                NULL,
+                                OPEN_EXISTING,
+                                FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_OPEN_NO_RECALL | FILE_FLAG_BACKUP_SEMANTICS,
+                                NULL);
+        if (FileHandle == INVALID_HANDLE_VALUE) {
+            DWORD ErrorCode = GetLastError();
+            LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of %y failed, results inaccurate: %s"), FilePath, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            ReportedOpenError = TRUE;
+        }
+    }
+
+    //
+    //  If the file is WIM backed and the user requested it, count the default
+    //  stream size as zero.
+    //
+
+    if (DuContext->WimBackedFilesAsZero) {
+        struct {
+            WOF_EXTERNAL_INFO WofHeader;
+            union {
+                WIM_PROVIDER_EXTERNAL_INFO WimInfo;
+                FILE_PROVIDER_EXTERNAL_INFO FileInfo;
+            } u;
+        } WofInfo;
+        DWORD BytesReturned;
+
+        if (DeviceIoControl(FileHandle, FSCTL_GET_EXTERNAL_BACKING, NULL, 0, &WofInfo, sizeof(WofInfo), &BytesReturned, NULL)) {
+            if (WofInfo.WofHeader.Provider == WOF_PROVIDER_WIM) {
+                FileSize.QuadPart = 0;
+                ForceSizeZero = TRUE;
+            }
+        }
+    }
+
+    //
+    //  If the default stream size wasn't forced to zero above, calculate it
+    //  now as either the compressed or uncompressed file size.
+    //
+
+    if (!ForceSizeZero) {
+        if (DuContext->CompressedFileSize &&
+            DllKernel32.pGetCompressedFileSizeW) {
+
+            FileSize.LowPart = DllKernel32.pGetCompressedFileSizeW(FilePath->StartOfString, (PDWORD)&FileSize.HighPart);
+
+            if (FileSize.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+                FileSize.LowPart = FileInfo->nFileSizeLow;
+                FileSize.HighPart = FileInfo->nFileSizeHigh;
+            }
+        } else {
+            FileSize.LowPart = FileInfo->nFileSizeLow;
+            FileSize.HighPart = FileInfo->nFileSizeHigh;
+        }
+    }
+
+    //
+    //  Round up to allocation size if requested.
+    //
+
+    if (DuContext->AllocationSize) {
+        FileSize.QuadPart = (FileSize.QuadPart + DirStack->AllocationSize - 1) & (~(DirStack->AllocationSize - 1));
+    }
+
+    //
+    //  Add in any space used by alternate streams.  Note in particular that
+    //  WIM backed files will only have their default stream WIM backed, so
+    //  these are added in even in the ForceSizeZero case.
+    //
+
+    if (DuContext->IncludeNamedStreams &&
+        DllKernel32.pFindFirstStreamW &&
+        DllKernel32.pFindNextStreamW) {
+
+        HANDLE hFind;
+        WIN32_FIND_STREAM_DATA FindStreamData;
+
+        hFind = DllKernel32.pFindFirstStreamW(FilePath->StartOfString, 0, &FindStreamData, 0);
+        if (hFind == INVALID_HANDLE_VALUE) {
+            if (!ReportedOpenError) {
+                DWORD ErrorCode = GetLastError();
+                LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of %y failed, results inaccurate: %s"), FilePath, ErrText);
+                YoriLibFreeWinErrorText(ErrText);
+            }
+        } else {
+            do {
+                if (_tcscmp(FindStreamData.cStreamName, L"::$DATA") != 0) {
+                    FileSize.QuadPart += FindStreamData.StreamSize.QuadPart;
+                    if (DuContext->AllocationSize) {
+                        FileSize.QuadPart = (FileSize.QuadPart + DirStack->AllocationSize - 1) & (~(DirStack->AllocationSize - 1));
+                    }
+                }
+            } while (DllKernel32.pFindNextStreamW(hFind, &FindStreamData));
+            FindClose(hFind);
+        }
+    }
+
+    //
+    //  If the file has a size and hardlink averaging is reuqested, divide the
+    //  size found by the number of hard links.
+    //
+
+    if (DuContext->AverageHardLinkSize && FileHandle != INVALID_HANDLE_VALUE && FileSize.QuadPart != 0) {
+        BY_HANDLE_FILE_INFORMATION HandleFileInfo;
+
+        if (GetFileInformationByHandle(FileHandle, &HandleFileInfo)) {
+            if (HandleFileInfo.nNumberOfLinks > 1) {
+                FileSize.QuadPart = FileSize.QuadPart / HandleFileInfo.nNumberOfLinks;
+            }
+        }
+    }
+
+    if (FileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(FileHandle);
+    }
+
+    //
+    //  If each hard linked file should be counted once, count nothing for
+    //  any link after the first one found.
+    //
+
+    if (DuContext->CountHardLinksOnce && FileSize.QuadPart != 0) {
+        if (!DuIsFirstLinkToFile(DuContext, DirStack, FileInfo)) {
+            FileSize.QuadPart = 0;
+        }
+    }
+
+    return FileSize;
+}
+
+
+
+/**
+ Ensure the directory stack has a frame allocated for a specified depth.
+
+ @param DuContext Pointer to the du context.
+
+ @param Depth The depth which must have an allocated frame.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+DuEnsureStackDepth(
+    __in PDU_CONTEXT DuContext,
+    __in DWORD Depth
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    if (Depth >= DuContext->StackAllocated) {
+        PDU_DIRECTORY_STACK NewStack;
+        DWORD BytesRequested;
+        YORI_ALLOC_SIZE_T BytesToAllocate;
+        BytesRequested = (Depth + 8) * sizeof(DU_DIRECTORY_STACK);
+        BytesToAllocate = YoriLibMaximumAllocationInRange(BytesRequested, BytesRequested);
+        if (BytesToAllocate == 0) {
+            return FALSE;
+        }
+        NewStack = YoriLibMalloc(BytesToAllocate);
+        if (NewStack == NULL) {
+            return FALSE;
+        }
+
+        if (DuContext->StackAllocated > 0) {
+            memcpy(NewStack, DuContext->DirStack, DuContext->StackAllocated * sizeof(DU_DIRECTORY_STACK));
+            YoriLibFree(DuContext->DirStack);
+        }
+
+        for (Index = DuContext->StackAllocated; Index < Depth + 8; Index++) {
+            YoriLibInitEmptyString(&NewStack[Index].DirectoryName);
+            NewStack[Index].ObjectsFoundThisDirectory = 0;
+            NewStack[Index].SpaceConsumedThisDirectory = 0;
+            NewStack[Index].SpaceConsumedInChildren = 0;
+            NewStack[Index].MftNextChild = 0;
+            ZeroMemory(&NewStack[Index].FileIds, sizeof(NewStack[Index].FileIds));
+            YoriLibInitEmptyString(&NewStack[Index].FileIds.Names);
+        }
+
+        DuContext->DirStack = NewStack;
+        DuContext->StackAllocated = (YORI_ALLOC_SIZE_T)Depth + 8;
+    }
+
+    return TRUE;
+}
+
+/**
+ A callback that is invoked when a file is found that matches a search criteria
+ specified in the set of strings to enumerate.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.
+
+ @param Depth Recursion depth, ignored in this application.
+
+ @param Context Pointer to the du context structure indicating the
+        action to perform and populated with the number of objects found.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+DuFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PDU_CONTEXT DuContext = (PDU_CONTEXT)Context;
+    LPTSTR FilePart;
+    YORI_ALLOC_SIZE_T Index;
+
+    //
+    //  Depth can only describe the number of path seperators in a single
+    //  string, so cannot exceed the allocation granularity of the system
+    //
+
+    ASSERT(Depth < YORI_MAX_ALLOC_SIZE);
+
+    if (!DuEnsureStackDepth(DuContext, Depth)) {
+        return FALSE;
+    }
+
+    //
+    //  StackIndex would normally be populated except for the first item at
+    //  Depth == 0
+    //
+
+    if (DuContext->StackIndex > 0 || DuContext->DirStack[0].DirectoryName.LengthInChars > 0) {
+        Index = DuContext->StackIndex;
+        while (TRUE) {
+            YORI_ALLOC_SIZE_T StackDirLength;
+            StackDirLength = DuContext->DirStack[Index].DirectoryName.LengthInChars;
+            if (Depth >= Index &&
+                YoriLibCompareStringCnt(FilePath, &DuContext->DirStack[Index].DirectoryName, StackDirLength) == 0 &&
+                (FilePath->LengthInChars == StackDirLength ||
+                 YoriLibIsSep(FilePath->StartOfString[StackDirLength]) ||
+                 YoriLibIsSep(DuContext->DirStack[Index].DirectoryName.StartOfString[StackDirLength - 1]))) {
+
+                break;
+            }
+
+            if (Index > 0) {
+                DuContext->DirStack[Index - 1].SpaceConsumedInChildren +=
+                    DuContext->DirStack[Index].SpaceConsumedInChildren +
+                    DuContext->DirStack[Index].SpaceConsumedThisDirectory;
+            }
+            DuReportAndCloseStack(DuContext, Index);
+            if (Index == 0) {
+                break;
+            }
+            Index--;
+            DuContext->StackIndex--;
+        }
+    }
+
+    FilePart = YoriLibFindRightMostCharacter(FilePath, '\\');
+    ASSERT(FilePart != NULL);
+    if (FilePart != NULL) {
+        YORI_STRING ThisDirName;
+        YoriLibInitEmptyString(&ThisDirName);
+        ThisDirName.StartOfString = FilePath->StartOfString;
+        ThisDirName.LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - FilePath->StartOfString);
+        if (ThisDirName.LengthInChars == 6) {
+            ThisDirName.LengthInChars++;
+            if (!YoriLibIsPfxDrvLetterColonSlash(&ThisDirName)) {
+                ThisDirName.LengthInChars--;
+            }
+        }
+
+        Index = (YORI_ALLOC_SIZE_T)Depth;
+        while (TRUE) {
+            if (DuContext->DirStack[Index].DirectoryName.LengthInChars > 0) {
+
+                ASSERT(Index == DuContext->StackIndex);
+                ASSERT(YoriLibCompareString(&DuContext->DirStack[Index].DirectoryName, &ThisDirName) == 0);
+                break;
+            }
+            if (!DuInitializeDirectoryStack(DuContext, &DuContext->DirStack[Index], &ThisDirName)) {
+                return FALSE;
+            }
+            ASSERT(DuContext->DirStack[Index].ObjectsFoundThisDirectory == 0);
+            ASSERT(DuContext->DirStack[Index].SpaceConsumedThisDirectory == 0);
+            ASSERT(DuContext->DirStack[Index].SpaceConsumedInChildren == 0);
+            if (Index == 0) {
+                break;
+            }
+            Index--;
+            FilePart = YoriLibFindRightMostCharacter(&ThisDirName, '\\');
+            ASSERT(FilePart != NULL);
+            ThisDirName.LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - ThisDirName.StartOfString);
+            if (ThisDirName.LengthInChars == 6) {
+                ThisDirName.LengthInChars++;
+                if (!YoriLibIsPfxDrvLetterColonSlash(&ThisDirName)) {
+                    ThisDirName.LengthInChars--;
+                }
+            }
+        }
+    }
+
+    DuContext->StackIndex = (YORI_ALLOC_SIZE_T)Depth;
+    DuContext->DirStack[Depth].ObjectsFoundThisDirectory++;
+
+    if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+        LARGE_INTEGER FileSize;
+        FileSize = DuCalculateSpaceUsedByFile(DuContext, &DuContext->DirStack[Depth], FilePath, FileInfo);
+        DuContext->DirStack[Depth].SpaceConsumedThisDirectory += FileSize.QuadPart;
+        if (DuContext->TopFiles.Capacity > 0) {
+            DuTopAdd(&DuContext->TopFiles, FileSize.QuadPart, FilePath);
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ A callback that is invoked when a directory cannot be successfully enumerated.
+
+ @param FilePath Pointer to the file path that could not be enumerated.
+
+ @param ErrorCode The Win32 error code describing the failure.
+
+ @param Depth Recursion depth, ignored in this application.
+
+ @param Context Pointer to the du context structure indicating the
+        action to perform and populated with the number of objects found.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+DuFileEnumerateErrorCallback(
+    __in PYORI_STRING FilePath,
+    __in DWORD ErrorCode,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
+    UNREFERENCED_PARAMETER(Depth);
+    UNREFERENCED_PARAMETER(Context);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Enumerate of %y failed, results incomplete: %s"), FilePath, ErrText);
+    YoriLibFreeWinErrorText(ErrText);
+    return TRUE;
+}
+
+/**
+ Prepare a context for use by a worker thread.  The worker context uses the
+ same options as the main context but has its own directory stack.
+
+ @param WorkerContext Pointer to the context to initialize.
+
+ @param DuContext Pointer to the main context specifying the options to
+        apply.
+ */
+VOID
+DuInitializeWorkerContext(
+    __out PDU_CONTEXT WorkerContext,
+    __in PDU_CONTEXT DuContext
+    )
+{
+    ZeroMemory(WorkerContext, sizeof(DU_CONTEXT));
+
+    WorkerContext->MaximumDepthToDisplay = DuContext->MaximumDepthToDisplay;
+    WorkerContext->AllocationSize = DuContext->AllocationSize;
+    WorkerContext->CompressedFileSize = DuContext->CompressedFileSize;
+    WorkerContext->AverageHardLinkSize = DuContext->AverageHardLinkSize;
+    WorkerContext->CountHardLinksOnce = DuContext->CountHardLinksOnce;
+    WorkerContext->FileIdSet = DuContext->FileIdSet;
+    WorkerContext->IncludeNamedStreams = DuContext->IncludeNamedStreams;
+    WorkerContext->WimBackedFilesAsZero = DuContext->WimBackedFilesAsZero;
+    WorkerContext->FileSizeColor = DuContext->FileSizeColor;
+    WorkerContext->MinimumDirectorySizeToDisplay.QuadPart = DuContext->MinimumDirectorySizeToDisplay.QuadPart;
+    WorkerContext->MatchFlags = DuContext->MatchFlags;
+
+    //
+    //  Each worker tracks its own largest objects, which are merged into
+    //  the main context when the worker exits.
+    //
+
+    if (DuContext->TopDirectories.Capacity > 0) {
+        DuTopInitialize(&WorkerContext->TopDirectories, DuContext->TopDirectories.Capacity);
+        DuTopInitialize(&WorkerContext->TopFiles, DuContext->TopFiles.Capacity);
+    }
+
+    memcpy(WorkerContext->FileSizeColorStringBuffer, DuContext->FileSizeColorStringBuffer, sizeof(WorkerContext->FileSizeColorStringBuffer));
+    WorkerContext->FileSizeColorString.StartOfString = WorkerContext->FileSizeColorStringBuffer;
+    WorkerContext->FileSizeColorString.LengthInChars = DuContext->FileSizeColorString.LengthInChars;
+    WorkerContext->FileSizeColorString.LengthAllocated = DuContext->FileSizeColorString.LengthAllocated;
+
+    //
+    //  Color rules are only read once parsed, so the worker can use the
+    //  main context's rules without copying them.
+    //
+
+    memcpy(&WorkerContext->ColorRules, &DuContext->ColorRules, sizeof(YORI_LIB_FILE_FILTER));
+    WorkerContext->SharedColorRules = TRUE;
+}
+
+/**
+ A worker thread that calculates space used within queued subdirectories
+ until told to exit.  Each worker has its own directory stack, so each
+ subdirectory is processed exactly as it would be on a single thread, with
+ output buffered in the job.
+
+ @param Context Pointer to the du context.
+
+ @return Thread exit code, which is always zero.
+ */
+DWORD WINAPI
+DuWorkerThread(
+    __in LPVOID Context
+    )
+{
+    PDU_CONTEXT DuContext;
+    DU_CONTEXT WorkerContext;
+    PYORI_LIST_ENTRY ListEntry;
+    PDU_JOB Job;
+
+    DuContext = (PDU_CONTEXT)Context;
+    DuInitializeWorkerContext(&WorkerContext, DuContext);
+
+    while (TRUE) {
+        WaitForSingleObject(DuContext->Mutex, INFINITE);
+        ListEntry = YoriLibGetNextListEntry(&DuContext->PendingJobList, NULL);
+        if (ListEntry != NULL) {
+            YoriLibRemoveListItem(ListEntry);
+            ReleaseMutex(DuContext->Mutex);
+
+            //
+            //  The subdirectory was found at depth zero, so its contents
+            //  are at depth one.  Enumerating from there leaves the parent
+            //  in the outermost frame, which is not displayed, exactly as
+            //  when the whole tree is enumerated on one thread.  The path
+            //  has already been expanded so should not be expanded again.
+            //
+
+            Job = CONTAINING_RECORD(ListEntry, DU_JOB, PendingListEntry);
+            WorkerContext.OutputBuffer = &Job->Output;
+            YoriLibForEachFile(&Job->FileSpec,
+                               (WORD)(WorkerContext.MatchFlags | YORILIB_FILEENUM_BASIC_EXPANSION),
+                               1,
+                               DuFileFoundCallback,
+                               DuContext->ErrorCallback,
+                               &WorkerContext);
+            DuReportAndCloseAllActiveStacks(&WorkerContext, 1, &Job->SpaceConsumed);
+            WorkerContext.OutputBuffer = NULL;
+
+            WaitForSingleObject(DuContext->Mutex, INFINITE);
+            Job->Complete = TRUE;
+            ReleaseMutex(DuContext->Mutex);
+            SetEvent(DuContext->JobCompleteEvent);
+            continue;
+        }
+
+        if (DuContext->Shutdown) {
+            ReleaseMutex(DuContext->Mutex);
+            break;
+        }
+
+        ResetEvent(DuContext->WorkAvailableEvent);
+        ReleaseMutex(DuContext->Mutex);
+        WaitForSingleObject(DuContext->WorkAvailableEvent, INFINITE);
+    }
+
+    if (WorkerContext.TopDirectories.Capacity > 0 || WorkerContext.TopFiles.Capacity > 0) {
+        WaitForSingleObject(DuContext->Mutex, INFINITE);
+        DuTopMerge(&DuContext->TopDirectories, &WorkerContext.TopDirectories);
+        DuTopMerge(&DuContext->TopFiles, &WorkerContext.TopFiles);
+        ReleaseMutex(DuContext->Mutex);
+    }
+
+    DuCleanupContext(&WorkerContext);
+    return 0;
+}
+
+/**
+ Display the results of completed jobs in the order they were queued, and
+ merge the space they consumed into the parent directory frame.
+
+ @param DuContext Pointer to the du context.
+
+ @param WaitForAll If TRUE, wait for all queued jobs to complete.  If FALSE,
+        return as soon as the oldest job has not yet completed.
+ */
+VOID
+DuRetireJobs(
+    __in PDU_CONTEXT DuContext,
+    __in BOOLEAN WaitForAll
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PDU_JOB Job;
+
+    while (TRUE) {
+        WaitForSingleObject(DuContext->Mutex, INFINITE);
+        ListEntry = YoriLibGetNextListEntry(&DuContext->JobList, NULL);
+        if (ListEntry == NULL) {
+            ReleaseMutex(DuContext->Mutex);
+            break;
+        }
+
+        Job = CONTAINING_RECORD(ListEntry, DU_JOB, ListEntry);
+        if (!Job->Complete) {
+            ReleaseMutex(DuContext->Mutex);
+            if (!WaitForAll) {
+                break;
+            }
+            WaitForSingleObject(DuContext->JobCompleteEvent, INFINITE);
+            continue;
+        }
+
+        YoriLibRemoveListItem(ListEntry);
+        DuContext->JobsQueued--;
+        ReleaseMutex(DuContext->Mutex);
+
+        if (Job->Output.LengthInChars > 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &Job->Output);
+        }
+
+        if (DuContext->StackAllocated > 0) {
+            DuContext->DirStack[0].SpaceConsumedInChildren += Job->SpaceConsumed;
+        }
+
+        YoriLibFreeStringContents(&Job->Output);
+        YoriLibFree(Job);
+    }
+}
+
+/**
+ Queue a subdirectory to have its space calculated by a worker thread.  If
+ too many jobs are outstanding, this displays completed results and waits
+ for workers to catch up.
+
+ @param DuContext Pointer to the du context.
+
+ @param DirPath Pointer to the full path to the subdirectory.
+
+ @return TRUE to indicate the subdirectory was queued, FALSE to indicate
+         failure.
+ */
+BOOL
+DuQueueJob(
+    __in PDU_CONTEXT DuContext,
+    __in PYORI_STRING DirPath
+    )
+{
+    PDU_JOB Job;
+    YORI_ALLOC_SIZE_T Length;
+
+    Job = YoriLibMalloc(sizeof(DU_JOB) + (DirPath->LengthInChars + 3) * sizeof(TCHAR));
+    if (Job == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Job->FileSpec);
+    Job->FileSpec.StartOfString = (LPTSTR)(Job + 1);
+    Job->FileSpec.LengthAllocated = DirPath->LengthInChars + 3;
+    Length = DirPath->LengthInChars;
+    memcpy(Job->FileSpec.StartOfString, DirPath->StartOfString, Length * sizeof(TCHAR));
+    if (Length == 0 || !YoriLibIsSep(Job->FileSpec.StartOfString[Length - 1])) {
+        Job->FileSpec.StartOfString[Length] = '\\';
+        Length++;
+    }
+    Job->FileSpec.StartOfString[Length] = '*';
+    Length++;
+    Job->FileSpec.StartOfString[Length] = '\0';
+    Job->FileSpec.LengthInChars = Length;
+
+    YoriLibInitEmptyString(&Job->Output);
+    Job->SpaceConsumed = 0;
+    Job->Complete = FALSE;
+
+    while (TRUE) {
+        DuRetireJobs(DuContext, FALSE);
+        WaitForSingleObject(DuContext->Mutex, INFINITE);
+        if (DuContext->JobsQueued < DuContext->MaximumJobsQueued) {
+            break;
+        }
+        ReleaseMutex(DuContext->Mutex);
+        WaitForSingleObject(DuContext->JobCompleteEvent, INFINITE);
+    }
+
+    YoriLibAppendList(&DuContext->JobList, &Job->ListEntry);
+    YoriLibAppendList(&DuContext->PendingJobList, &Job->PendingListEntry);
+    DuContext->JobsQueued++;
+    ReleaseMutex(DuContext->Mutex);
+    SetEvent(DuContext->WorkAvailableEvent);
+    return TRUE;
+}
+
+/**
+ A callback that is invoked for each top level object when worker threads
+ are in use.  The object is accounted for in the parent as usual, and each
+ subdirectory that would be recursed into is queued to a worker.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.
+
+ @param Depth Recursion depth, which is always zero.
+
+ @param Context Pointer to the du context structure.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+DuTopLevelFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PDU_CONTEXT DuContext = (PDU_CONTEXT)Context;
+
+    ASSERT(Depth == 0);
+
+    if (!DuFileFoundCallback(FilePath, FileInfo, Depth, Context)) {
+        return FALSE;
+    }
+
+    if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+        return TRUE;
+    }
+
+    //
+    //  Links are not traversed when the tree is enumerated on one thread,
+    //  so don't queue them here either.
+    //
+
+    if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0 &&
+        (FileInfo->dwReserved0 == IO_REPARSE_TAG_MOUNT_POINT ||
+         FileInfo->dwReserved0 == IO_REPARSE_TAG_SYMLINK)) {
+
+        return TRUE;
+    }
+
+    return DuQueueJob(DuContext, FilePath);
+}
+
+/**
+ Wait for all worker threads to exit.  Any jobs must have been retired
+ before calling this function.
+
+ @param DuContext Pointer to the du context.
+ */
+VOID
+DuStopWorkers(
+    __in PDU_CONTEXT DuContext
+    )
+{
+    DWORD Index;
+
+    if (DuContext->Workers != NULL) {
+        WaitForSingleObject(DuContext->Mutex, INFINITE);
+        DuContext->Shutdown = TRUE;
+        ReleaseMutex(DuContext->Mutex);
+        SetEvent(DuContext->WorkAvailableEvent);
+
+        for (Index = 0; Index < DuContext->WorkerCount; Index++) {
+            WaitForSingleObject(DuContext->Workers[Index], INFINITE);
+            CloseHandle(DuContext->Workers[Index]);
+        }
+        YoriLibFree(DuContext->Workers);
+        DuContext->Workers = NULL;
+    }
+    DuContext->WorkerCount = 0;
+
+    if (DuContext->Mutex != NULL) {
+        CloseHandle(DuContext->Mutex);
+        DuContext->Mutex = NULL;
+    }
+
+    if (DuContext->WorkAvailableEvent != NULL) {
+        CloseHandle(DuContext->WorkAvailableEvent);
+        DuContext->WorkAvailableEvent = NULL;
+    }
+
+    if (DuContext->JobCompleteEvent != NULL) {
+        CloseHandle(DuContext->JobCompleteEvent);
+        DuContext->JobCompleteEvent = NULL;
+    }
+}
+
+/**
+ Start worker threads to calculate space used by subdirectories in
+ parallel.  If the threads cannot be started, space is calculated on the
+ calling thread.  This must be called after all options in the context
+ have been initialized, since workers copy them.
+
+ @param DuContext Pointer to the du context.
+
+ @param WorkerCount The number of worker threads to start.
+ */
+VOID
+DuStartWorkers(
+    __in PDU_CONTEXT DuContext,
+    __in DWORD WorkerCount
+    )
+{
+    DWORD Index;
+    DWORD ThreadId;
+
+    YoriLibInitializeListHead(&DuContext->JobList);
+    YoriLibInitializeListHead(&DuContext->PendingJobList);
+    DuContext->JobsQueued = 0;
+    DuContext->MaximumJobsQueued = WorkerCount * DU_JOBS_PER_WORKER;
+    DuContext->Shutdown = FALSE;
+
+    DuContext->Mutex = CreateMutex(NULL, FALSE, NULL);
+    DuContext->WorkAvailableEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    DuContext->JobCompleteEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    DuContext->Workers = YoriLibMalloc(WorkerCount * sizeof(HANDLE));
+
+    if (DuContext->Mutex == NULL ||
+        DuContext->WorkAvailableEvent == NULL ||
+        DuContext->JobCompleteEvent == NULL ||
+        DuContext->Workers == NULL) {
+
+        if (DuContext->Workers != NULL) {
+            YoriLibFree(DuContext->Workers);
+            DuContext->Workers = NULL;
+        }
+        DuStopWorkers(DuContext);
+        return;
+    }
+
+    for (Index = 0; Index < WorkerCount; Index++) {
+        DuContext->Workers[Index] = CreateThread(NULL, 0, DuWorkerThread, DuContext, 0, &ThreadId);
+        if (DuContext->Workers[Index] == NULL) {
+            break;
+        }
+        DuContext->WorkerCount++;
+    }
+
+    if (DuContext->WorkerCount == 0) {
+        YoriLibFree(DuContext->Workers);
+        DuContext->Workers = NULL;
+        DuStopWorkers(DuContext);
+    }
+}
+
+/**
+ Add a name found in the MFT to the entry describing a file.  The first name
+ is recorded in the entry itself and any further hard links are recorded
+ in a separate array.
+
+ @param Mft Pointer to the information collected from the MFT.
+
+ @param Entry Pointer to the entry describing the file.
+
+ @param FileName Pointer to the name, which has been validated to contain
+        the characters it describes.
+
+ @param StoreName If TRUE, the characters of the name should be retained so
+        that the object can be displayed later.  This is used for
+        directories.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+DuMftAddName(
+    __in PDU_MFT Mft,
+    __in PDU_MFT_ENTRY Entry,
+    __in PYORI_LIB_NTFS_FILE_NAME FileName,
+    __in BOOLEAN StoreName
+    )
+{
+    DWORDLONG ParentSegment;
+    DWORD ParentIndex;
+    DWORDLONG NewAllocated;
+
+    ParentSegment = YORI_LIB_NTFS_SEGMENT_NUMBER(FileName->ParentDirectory);
+    ParentIndex = (DWORD)-1;
+    if (ParentSegment < Mft->EntryCount) {
+        ParentIndex = (DWORD)ParentSegment;
+    }
+
+    if (Entry->LinkCount == 0) {
+        Entry->ParentSegment = ParentIndex;
+        Entry->ParentSequence = YORI_LIB_NTFS_SEQUENCE_NUMBER(FileName->ParentDirectory);
+
+        if (StoreName && (Entry->Flags & DU_MFT_ENTRY_HAS_NAME) == 0) {
+            if (Mft->NameCharsUsed + FileName->FileNameLength > Mft->NameCharsAllocated) {
+                LPTSTR NewNames;
+                NewAllocated = ((DWORDLONG)Mft->NameCharsAllocated + FileName->FileNameLength) * 2;
+                if (NewAllocated < 0x10000) {
+                    NewAllocated = 0x10000;
+                }
+                if (NewAllocated * sizeof(TCHAR) > YORI_MAX_ALLOC_SIZE) {
+                    return FALSE;
+                }
+                NewNames = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(TCHAR)));
+                if (NewNames == NULL) {
+                    return FALSE;
+                }
+                if (Mft->Names != NULL) {
+                    memcpy(NewNames, Mft->Names, Mft->NameCharsUsed * sizeof(TCHAR));
+                    YoriLibFree(Mft->Names);
+                }
+                Mft->Names = NewNames;
+                Mft->NameCharsAllocated = (DWORD)NewAllocated;
+            }
+
+            memcpy(&Mft->Names[Mft->NameCharsUsed], FileName->FileName, FileName->FileNameLength * sizeof(TCHAR));
+            Entry->NameOffset = Mft->NameCharsUsed;
+            Entry->NameLength = FileName->FileNameLength;
+            Entry->Flags = (UCHAR)(Entry->Flags | DU_MFT_ENTRY_HAS_NAME);
+            Mft->NameCharsUsed = Mft->NameCharsUsed + FileName->FileNameLength;
+        }
+    } else {
+        if (Mft->LinkCount >= Mft->LinksAllocated) {
+            PDU_MFT_LINK NewLinks;
+            NewAllocated = ((DWORDLONG)Mft->LinksAllocated + 1) * 2;
+            if (NewAllocated < 0x1000) {
+                NewAllocated = 0x1000;
+            }
+            if (NewAllocated * sizeof(DU_MFT_LINK) > YORI_MAX_ALLOC_SIZE) {
+                return FALSE;
+            }
+            NewLinks = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(DU_MFT_LINK)));
+            if (NewLinks == NULL) {
+                return FALSE;
+            }
+            if (Mft->Links != NULL) {
+                memcpy(NewLinks, Mft->Links, Mft->LinkCount * sizeof(DU_MFT_LINK));
+                YoriLibFree(Mft->Links);
+            }
+            Mft->Links = NewLinks;
+            Mft->LinksAllocated = (DWORD)NewAllocated;
+        }
+
+        Mft->Links[Mft->LinkCount].FileSegment = (DWORD)(Entry - Mft->Entries);
+        Mft->Links[Mft->LinkCount].ParentSegment = ParentIndex;
+        Mft->Links[Mft->LinkCount].ParentSequence = YORI_LIB_NTFS_SEQUENCE_NUMBER(FileName->ParentDirectory);
+        Mft->LinkCount++;
+    }
+
+    if (Entry->LinkCount < 0xFFFF) {
+        Entry->LinkCount++;
+    }
+
+    return TRUE;
+}
+
+/**
+ A callback invoked for each file record read from the MFT.  This collects
+ the names, sizes and flags needed to calculate space for each directory.
+
+ @param SegmentNumber The segment number of the file record.
+
+ @param FileRecord Pointer to the file record.
+
+ @param RecordLength The length of the file record, in bytes.
+
+ @param Context Pointer to the du context, whose Mft member is being
+        populated.
+
+ @return TRUE to continue enumerating, FALSE to abort.
+ */
+BOOL
+DuMftRecordCallback(
+    __in DWORDLONG SegmentNumber,
+    __in PYORI_LIB_NTFS_FILE_RECORD FileRecord,
+    __in DWORD RecordLength,
+    __in PVOID Context
+    )
+{
+    PDU_CONTEXT DuContext = (PDU_CONTEXT)Context;
+    PDU_MFT Mft = DuContext->Mft;
+    PDU_MFT_ENTRY Entry;
+    PYORI_LIB_NTFS_ATTRIBUTE Attribute;
+    PYORI_LIB_NTFS_FILE_NAME FileName;
+    PDWORD ReparseTag;
+    PWOF_EXTERNAL_INFO WofInfo;
+    DWORDLONG BaseSegment;
+    BOOLEAN ExtensionRecord;
+    LONGLONG StreamSpace;
+
+    //
+    //  Attributes in extension records are accounted to the base record
+    //  of the file.
+    //
 
-    PDU_DIRECTORY_STACK DirStack;
+    BaseSegment = SegmentNumber;
+    ExtensionRecord = FALSE;
+    if (FileRecord->BaseFileRecord != 0) {
+        BaseSegment = YORI_LIB_NTFS_SEGMENT_NUMBER(FileRecord->BaseFileRecord);
+        ExtensionRecord = TRUE;
+    }
 
-    DirStack = &DuContext->DirStack[Depth];
+    if (BaseSegment >= Mft->EntryCount) {
+        return TRUE;
+    }
 
-    if (DuContext->MaximumDepthToDisplay == 0 ||
-        Depth <= DuContext->MaximumDepthToDisplay) {
+    Entry = &Mft->Entries[(DWORD)BaseSegment];
+    if (!ExtensionRecord) {
+        Entry->Flags = (UCHAR)(Entry->Flags | DU_MFT_ENTRY_IN_USE);
+        Entry->Sequence = FileRecord->SequenceNumber;
+        if (FileRecord->Flags & YORI_LIB_NTFS_FILE_RECORD_DIRECTORY) {
+            Entry->Flags = (UCHAR)(Entry->Flags | DU_MFT_ENTRY_DIRECTORY);
+        }
+    }
 
-        SizeToDisplay.QuadPart = DirStack->SpaceConsumedInChildren + DirStack->SpaceConsumedThisDirectory;
+    Attribute = NULL;
+    while (TRUE) {
+        Attribute = YoriLibMftGetNextAttribute(FileRecord, RecordLength, Attribute);
+        if (Attribute == NULL) {
+            break;
+        }
 
-        if (DuContext->MinimumDirectorySizeToDisplay.QuadPart == 0 ||
-            SizeToDisplay.QuadPart >= DuContext->MinimumDirectorySizeToDisplay.QuadPart) {
+        if (Attribute->TypeCode == YORI_LIB_NTFS_ATTRIBUTE_FILE_NAME) {
 
             //
-            //  Convert the escaped path into a path for humans.
+            //  Short names duplicate a long name, so they are not another
+            //  link to the file.
             //
 
-            YoriLibInitEmptyString(&UnescapedPath);
-            if (YoriLibUnescapePath(&DirStack->DirectoryName, &UnescapedPath)) {
-                StringToDisplay = &UnescapedPath;
-            } else {
-                StringToDisplay = &DirStack->DirectoryName;
+            FileName = YoriLibMftGetResidentValue(Attribute, FIELD_OFFSET(YORI_LIB_NTFS_FILE_NAME, FileName));
+            if (FileName == NULL ||
+                FileName->Flags == YORI_LIB_NTFS_FILE_NAME_DOS ||
+                YoriLibMftGetResidentValue(Attribute, FIELD_OFFSET(YORI_LIB_NTFS_FILE_NAME, FileName) + FileName->FileNameLength * sizeof(WCHAR)) == NULL) {
+
+                continue;
             }
 
             //
-            //  Convert the file size from a number of bytes to a short string
-            //  with a suffix
+            //  The directory flag is only present on the base record, so
+            //  names in extension records are retained in case they
+            //  describe a directory.
             //
 
-            YoriLibInitEmptyString(&FileSizeString);
-            FileSizeString.StartOfString = FileSizeStringBuffer;
-            FileSizeString.LengthAllocated = sizeof(FileSizeStringBuffer)/sizeof(FileSizeStringBuffer[0]);
-            YoriLibFileSizeToString(&FileSizeString, &SizeToDisplay);
+            if (!DuMftAddName(Mft,
+                              Entry,
+                              FileName,
+                              (BOOLEAN)(ExtensionRecord || (FileRecord->Flags & YORI_LIB_NTFS_FILE_RECORD_DIRECTORY)))) {
+                return FALSE;
+            }
+
+        } else if (Attribute->TypeCode == YORI_LIB_NTFS_ATTRIBUTE_DATA) {
 
-            //
-            //  If the user requested it, determine the color to display with
-            //
+            if (Attribute->FormCode == YORI_LIB_NTFS_ATTRIBUTE_RESIDENT) {
+                if (YoriLibMftGetResidentValue(Attribute, 0) == NULL) {
+                    continue;
+                }
+                StreamSpace = Attribute->Form.Resident.ValueLength;
+            } else {
 
-            YoriLibInitEmptyString(&VtAttribute);
-            if (DuContext->ColorRules.NumberCriteria) {
-                WIN32_FIND_DATA FileInfo;
+                //
+                //  Sizes are only recorded in the first extent of a
+                //  nonresident attribute.
+                //
 
-                VtAttribute.StartOfString = VtAttributeBuffer;
-                VtAttribute.LengthAllocated = sizeof(VtAttributeBuffer)/sizeof(VtAttributeBuffer[0]);
+                if (Attribute->Form.Nonresident.LowestVcn != 0) {
+                    continue;
+                }
+                StreamSpace = Attribute->Form.Nonresident.FileSize;
+                if (DuContext->CompressedFileSize &&
+                    (Attribute->Flags & (YORI_LIB_NTFS_ATTRIBUTE_COMPRESSED_MASK | YORI_LIB_NTFS_ATTRIBUTE_SPARSE)) != 0 &&
+                    Attribute->RecordLength >= FIELD_OFFSET(YORI_LIB_NTFS_ATTRIBUTE, Form.Nonresident.TotalAllocated) + sizeof(LONGLONG)) {
 
-                if (!YoriLibUpdateFindDataFromFileInformation(&FileInfo, DirStack->DirectoryName.StartOfString, TRUE) || 
-                    !YoriLibFileFiltCheckColorMatch(&DuContext->ColorRules, &DirStack->DirectoryName, &FileInfo, &Attribute)) {
-                    Attribute.Ctrl = YORILIB_ATTRCTRL_WINDOW_BG | YORILIB_ATTRCTRL_WINDOW_FG;
-                    Attribute.Win32Attr = (UCHAR)YoriLibVtGetDefaultColor();
+                    StreamSpace = Attribute->Form.Nonresident.TotalAllocated;
                 }
+            }
 
-                YoriLibVtStringForTextAttribute(&VtAttribute, Attribute.Ctrl, Attribute.Win32Attr);
+            if (DuContext->AllocationSize) {
+                StreamSpace = (StreamSpace + Mft->BytesPerCluster - 1) & (~((LONGLONG)Mft->BytesPerCluster - 1));
             }
 
-            if (VtAttribute.LengthInChars > 0) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
-                              _T("%y%y%c[0m %y%y%c[0m\n"),
-                              &DuContext->FileSizeColorString,
-                              &FileSizeString,
-                              27,
-                              &VtAttribute,
-                              StringToDisplay,
-                              27);
-            } else {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y\n"), &FileSizeString, StringToDisplay);
+            if (Attribute->NameLength == 0) {
+                Entry->u.File.DefaultStreamSpace = StreamSpace;
+            } else if (DuContext->IncludeNamedStreams) {
+                Entry->u.File.NamedStreamSpace += StreamSpace;
             }
 
-            YoriLibFreeStringContents(&UnescapedPath);
+        } else if (Attribute->TypeCode == YORI_LIB_NTFS_ATTRIBUTE_REPARSE_POINT &&
+                   DuContext->WimBackedFilesAsZero) {
+
+            //
+            //  The reparse buffer consists of a tag, a length, a reserved
+            //  field, and for WOF, a header indicating the provider.
+            //
+
+            ReparseTag = YoriLibMftGetResidentValue(Attribute, 2 * sizeof(DWORD) + sizeof(WOF_EXTERNAL_INFO));
+            if (ReparseTag != NULL && *ReparseTag == IO_REPARSE_TAG_WOF) {
+                WofInfo = YoriLibAddToPointer(ReparseTag, 2 * sizeof(DWORD));
+                if (WofInfo->Provider == WOF_PROVIDER_WIM) {
+                    Entry->Flags = (UCHAR)(Entry->Flags | DU_MFT_ENTRY_WIM_BACKED);
+                }
+            }
         }
     }
 
-    DuCloseStack(DirStack);
     return TRUE;
 }
 
 /**
- Display all directory frames which have not been otherwise displayed because
- no object has been found in a subsequent directory.
+ Return the entry for a parent directory if it refers to a directory that
+ is still in use.
 
- @param DuContext Pointer to the DuContext which may contain active directory
-        frames.
+ @param Mft Pointer to the information collected from the MFT.
 
- @param MinDepthToDisplay Indicates the minimum depth number that should be
-        displayed to the user.  Frames below this are cleared for reuse but
-        not displayed.
+ @param ParentSegment The segment number of the parent directory.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @param ParentSequence The sequence number of the parent directory.
+
+ @return Pointer to the entry for the parent directory, or NULL if the
+         parent is not a valid directory.
  */
-BOOL
-DuReportAndCloseAllActiveStacks(
-    __in PDU_CONTEXT DuContext,
-    __in DWORD MinDepthToDisplay
+PDU_MFT_ENTRY
+DuMftGetParent(
+    __in PDU_MFT Mft,
+    __in DWORD ParentSegment,
+    __in WORD ParentSequence
     )
 {
-    YORI_ALLOC_SIZE_T Index;
-    Index = DuContext->StackIndex;
-    if (Index >= DuContext->StackAllocated) {
-        ASSERT(Index == 0);
-        ASSERT(DuContext->DirStack == NULL);
-        return TRUE;
+    PDU_MFT_ENTRY Parent;
+
+    if (ParentSegment >= Mft->EntryCount) {
+        return NULL;
     }
-    while (TRUE) {
-        if (Index > 0) {
-            DuContext->DirStack[Index - 1].SpaceConsumedInChildren +=
-                DuContext->DirStack[Index].SpaceConsumedInChildren +
-                DuContext->DirStack[Index].SpaceConsumedThisDirectory;
-        }
-        if (Index >= MinDepthToDisplay) {
-            DuReportAndCloseStack(DuContext, Index);
-        } else {
-            DuCloseStack(&DuContext->DirStack[Index]);
-        }
-        if (Index == 0) {
-            break;
-        }
-        Index--;
-        DuContext->StackIndex--;
+
+    Parent = &Mft->Entries[ParentSegment];
+    if ((Parent->Flags & (DU_MFT_ENTRY_IN_USE | DU_MFT_ENTRY_DIRECTORY)) != (DU_MFT_ENTRY_IN_USE | DU_MFT_ENTRY_DIRECTORY) ||
+        Parent->Sequence != ParentSequence) {
+
+        return NULL;
     }
-    return TRUE;
+
+    return Parent;
 }
 
 /**
- Initialize a single directory stack location.
+ Return the space to attribute to each name of a file given the user
+ selected options.
 
- @param DuContext Pointer to the DU context specifying the options to apply.
-
- @param DirStack Pointer to the directory stack location to initialize.
+ @param DuContext Pointer to the du context specifying the options.
 
- @param DirName Pointer to the directory name to initialize in the stack.
+ @param Entry Pointer to the entry describing the file.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @return The number of bytes attributable to each name of the file.
  */
-BOOL
-DuInitializeDirectoryStack(
+LONGLONG
+DuMftSpaceUsedByFile(
     __in PDU_CONTEXT DuContext,
-    __in PDU_DIRECTORY_STACK DirStack,
-    __in PYORI_STRING DirName
+    __in PDU_MFT_ENTRY Entry
     )
 {
-    DWORD SectorsPerCluster;
-    DWORD BytesPerSector;
-    DWORD NumberOfFreeClusters;
-    DWORD TotalNumberOfClusters;
+    LONGLONG Space;
 
-    if (DirStack->DirectoryName.LengthAllocated <= DirName->LengthInChars) {
-        YoriLibFreeStringContents(&DirStack->DirectoryName);
-        if (!YoriLibAllocateString(&DirStack->DirectoryName, DirName->LengthInChars + 80)) {
-            return FALSE;
-        }
+    Space = 0;
+    if ((Entry->Flags & DU_MFT_ENTRY_WIM_BACKED) == 0) {
+        Space = Entry->u.File.DefaultStreamSpace;
     }
+    Space = Space + Entry->u.File.NamedStreamSpace;
 
-    memcpy(DirStack->DirectoryName.StartOfString, DirName->StartOfString, DirName->LengthInChars * sizeof(TCHAR));
-    DirStack->DirectoryName.StartOfString[DirName->LengthInChars] = '\0';
-    DirStack->DirectoryName.LengthInChars = DirName->LengthInChars;
-
-    //
-    //  If GetDiskFreeSpace fails, see if it works on the effective root.
-    //  This is to support systems without mount points where this call can
-    //  fail when called on a directory.
-    //
-
-    if (DuContext->AllocationSize) {
-        if (!GetDiskFreeSpace(DirStack->DirectoryName.StartOfString, &SectorsPerCluster, &BytesPerSector, &NumberOfFreeClusters, &TotalNumberOfClusters)) {
-            YORI_STRING EffectiveRoot;
-
-            DirStack->AllocationSize = 4096;
-
-            if (YoriLibFindEffRoot(&DirStack->DirectoryName, &EffectiveRoot) &&
-                EffectiveRoot.LengthInChars < DirStack->DirectoryName.LengthInChars) {
-
-                TCHAR SavedChar;
-                SavedChar = EffectiveRoot.StartOfString[EffectiveRoot.LengthInChars];
-                EffectiveRoot.StartOfString[EffectiveRoot.LengthInChars] = '\0';
-
-                if (GetDiskFreeSpace(EffectiveRoot.StartOfString, &SectorsPerCluster, &BytesPerSector, &NumberOfFreeClusters, &TotalNumberOfClusters)) {
-                    DirStack->AllocationSize = SectorsPerCluster * BytesPerSector;
-                }
-
-                EffectiveRoot.StartOfString[EffectiveRoot.LengthInChars] = SavedChar;
-            }
-
-        } else {
-            DirStack->AllocationSize = SectorsPerCluster * BytesPerSector;
-        }
+    if (DuContext->AverageHardLinkSize && Entry->LinkCount > 1) {
+        Space = Space / Entry->LinkCount;
     }
 
-    return TRUE;
+    return Space;
 }
 
 /**
- Count the amount of disk space to attribute to a file given the user selected
- options.
-
- @param DuContext Context specifying the accounting options to apply.
-
- @param DirStack Pointer to the directory stack indicating the allocation size
-        used for the directory.
-
- @param FilePath Pointer to a fully specified path to the file.
-
- @param FileInfo Pointer to the block of data returned from directory
-        enumerate.
+ Once every file record has been read, calculate the space consumed by
+ files in each directory and build a list of subdirectories for each
+ directory.
 
- @return The number of bytes attributable to the file.
+ @param DuContext Pointer to the du context containing the information
+        collected from the MFT.
  */
-LARGE_INTEGER
-DuCalculateSpaceUsedByFile(
-    __in PDU_CONTEXT DuContext,
-    __in PDU_DIRECTORY_STACK DirStack,
-    __in PYORI_STRING FilePath,
-    __in PWIN32_FIND_DATA FileInfo
+VOID
+DuMftCalculateTotals(
+    __in PDU_CONTEXT DuContext
     )
 {
-    LARGE_INTEGER FileSize;
-    HANDLE FileHandle = INVALID_HANDLE_VALUE;
-    BOOL ForceSizeZero = FALSE;
-    BOOL ReportedOpenError = FALSE;
-
-    FileSize.QuadPart = 0;
+    PDU_MFT Mft = DuContext->Mft;
+    PDU_MFT_ENTRY Entry;
+    PDU_MFT_ENTRY Parent;
+    PDU_MFT_LINK Link;
+    LONGLONG Space;
+    DWORD Segment;
+    DWORD Index;
 
-    if (DuContext->AverageHardLinkSize || DuContext->WimBackedFilesAsZero) {
+    //
+    //  Any stream sizes recorded for directories are not counted, and the
+    //  same storage is used for the directory totals.
+    //
 
-        FileHandle = CreateFile(FilePath->StartOfString,
-                                FILE_READ_ATTRIBUTES|SYNCHRONIZE,
-                                FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                                NULL,
-                                OPEN_EXISTING,
-                                FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_OPEN_NO_RECALL | FILE_FLAG_BACKUP_SEMANTICS,
-                                NULL);
-        if (FileHandle == INVALID_HANDLE_VALUE) {
-            DWORD ErrorCode = GetLastError();
-            LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of %y failed, results inaccurate: %s"), FilePath, ErrText);
-            YoriLibFreeWinErrorText(ErrText);
-            ReportedOpenError = TRUE;
+    for (Segment = 0; Segment < Mft->EntryCount; Segment++) {
+        Entry = &Mft->Entries[Segment];
+        if (Entry->Flags & DU_MFT_ENTRY_DIRECTORY) {
+            Entry->u.Directory.SpaceConsumed = 0;
+            Entry->u.Directory.FirstChild = 0;
+            Entry->u.Directory.ObjectsFound = 0;
         }
     }
 
     //
-    //  If the file is WIM backed and the user requested it, count the default
-    //  stream size as zero.
+    //  Metadata files other than the root directory are not visible in
+    //  any directory.
     //
 
-    if (DuContext->WimBackedFilesAsZero) {
-        struct {
-            WOF_EXTERNAL_INFO WofHeader;
-            union {
-                WIM_PROVIDER_EXTERNAL_INFO WimInfo;
-                FILE_PROVIDER_EXTERNAL_INFO FileInfo;
-            } u;
-        } WofInfo;
-        DWORD BytesReturned;
+    for (Segment = 0; Segment < Mft->EntryCount; Segment++) {
+        Entry = &Mft->Entries[Segment];
+        if ((Entry->Flags & DU_MFT_ENTRY_IN_USE) == 0 ||
+            Entry->LinkCount == 0 ||
+            Segment == DU_MFT_ROOT_SEGMENT ||
+            Segment < DU_MFT_FIRST_USER_SEGMENT) {
 
-        if (DeviceIoControl(FileHandle, FSCTL_GET_EXTERNAL_BACKING, NULL, 0, &WofInfo, sizeof(WofInfo), &BytesReturned, NULL)) {
-            if (WofInfo.WofHeader.Provider == WOF_PROVIDER_WIM) {
-                FileSize.QuadPart = 0;
-                ForceSizeZero = TRUE;
-            }
+            continue;
+        }
+
+        Parent = DuMftGetParent(Mft, Entry->ParentSegment, Entry->ParentSequence);
+        if (Parent == NULL || Parent == Entry) {
+            continue;
+        }
+
+        Parent->u.Directory.ObjectsFound++;
+        if (Entry->Flags & DU_MFT_ENTRY_DIRECTORY) {
+            Entry->NextSibling = Parent->u.Directory.FirstChild;
+            Parent->u.Directory.FirstChild = Segment;
+        } else {
+            Parent->u.Directory.SpaceConsumed += DuMftSpaceUsedByFile(DuContext, Entry);
         }
     }
 
-    //
-    //  If the default stream size wasn't forced to zero above, calculate it
-    //  now as either the compressed or uncompressed file size.
-    //
+    for (Index = 0; Index < Mft->LinkCount; Index++) {
+        Link = &Mft->Links[Index];
+        Entry = &Mft->Entries[Link->FileSegment];
+        if ((Entry->Flags & (DU_MFT_ENTRY_IN_USE | DU_MFT_ENTRY_DIRECTORY)) != DU_MFT_ENTRY_IN_USE ||
+            Link->FileSegment < DU_MFT_FIRST_USER_SEGMENT) {
 
-    if (!ForceSizeZero) {
-        if (DuContext->CompressedFileSize &&
-            DllKernel32.pGetCompressedFileSizeW) {
+            continue;
+        }
 
-            FileSize.LowPart = DllKernel32.pGetCompressedFileSizeW(FilePath->StartOfString, (PDWORD)&FileSize.HighPart);
+        Parent = DuMftGetParent(Mft, Link->ParentSegment, Link->ParentSequence);
+        if (Parent == NULL) {
+            continue;
+        }
 
-            if (FileSize.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
-                FileSize.LowPart = FileInfo->nFileSizeLow;
-                FileSize.HighPart = FileInfo->nFileSizeHigh;
-            }
-        } else {
-            FileSize.LowPart = FileInfo->nFileSizeLow;
-            FileSize.HighPart = FileInfo->nFileSizeHigh;
+        //
+        //  When counting hard linked files once, the space was attributed
+        //  to the first name above.
+        //
+
+        Space = 0;
+        if (!DuContext->CountHardLinksOnce) {
+            Space = DuMftSpaceUsedByFile(DuContext, Entry);
         }
+        Parent->u.Directory.ObjectsFound++;
+        Parent->u.Directory.SpaceConsumed += Space;
     }
+}
 
-    //
-    //  Round up to allocation size if requested.
-    //
+/**
+ Sort a list of subdirectories by name, so they are displayed in the same
+ order as they would be found by enumerating the parent directory.
 
-    if (DuContext->AllocationSize) {
-        FileSize.QuadPart = (FileSize.QuadPart + DirStack->AllocationSize - 1) & (~(DirStack->AllocationSize - 1));
+ @param Mft Pointer to the information collected from the MFT.
+
+ @param FirstChild The segment number of the first subdirectory in the
+        list.
+
+ @return The segment number of the first subdirectory in the sorted list.
+ */
+DWORD
+DuMftSortChildren(
+    __in PDU_MFT Mft,
+    __in DWORD FirstChild
+    )
+{
+    DWORD Middle;
+    DWORD End;
+    DWORD Second;
+    DWORD Head;
+    DWORD Tail;
+    DWORD Next;
+    YORI_STRING FirstName;
+    YORI_STRING SecondName;
+
+    if (FirstChild == 0 || Mft->Entries[FirstChild].NextSibling == 0) {
+        return FirstChild;
     }
 
     //
-    //  Add in any space used by alternate streams.  Note in particular that
-    //  WIM backed files will only have their default stream WIM backed, so
-    //  these are added in even in the ForceSizeZero case.
+    //  Split the list in half, sort each half, then merge them.
     //
 
-    if (DuContext->IncludeNamedStreams &&
-        DllKernel32.pFindFirstStreamW &&
-        DllKernel32.pFindNextStreamW) {
+    Middle = FirstChild;
+    End = Mft->Entries[FirstChild].NextSibling;
+    while (End != 0) {
+        End = Mft->Entries[End].NextSibling;
+        if (End != 0) {
+            Middle = Mft->Entries[Middle].NextSibling;
+            End = Mft->Entries[End].NextSibling;
+        }
+    }
 
-        HANDLE hFind;
-        WIN32_FIND_STREAM_DATA FindStreamData;
+    Second = Mft->Entries[Middle].NextSibling;
+    Mft->Entries[Middle].NextSibling = 0;
+
+    FirstChild = DuMftSortChildren(Mft, FirstChild);
+    Second = DuMftSortChildren(Mft, Second);
+
+    YoriLibInitEmptyString(&FirstName);
+    YoriLibInitEmptyString(&SecondName);
+    Head = 0;
+    Tail = 0;
+    while (FirstChild != 0 || Second != 0) {
+        if (FirstChild != 0 && Second != 0) {
+            FirstName.StartOfString = &Mft->Names[Mft->Entries[FirstChild].NameOffset];
+            FirstName.LengthInChars = Mft->Entries[FirstChild].NameLength;
+            SecondName.StartOfString = &Mft->Names[Mft->Entries[Second].NameOffset];
+            SecondName.LengthInChars = Mft->Entries[Second].NameLength;
+        }
 
-        hFind = DllKernel32.pFindFirstStreamW(FilePath->StartOfString, 0, &FindStreamData, 0);
-        if (hFind == INVALID_HANDLE_VALUE) {
-            if (!ReportedOpenError) {
-                DWORD ErrorCode = GetLastError();
-                LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of %y failed, results inaccurate: %s"), FilePath, ErrText);
-                YoriLibFreeWinErrorText(ErrText);
-            }
+        if (Second == 0 ||
+            (FirstChild != 0 && YoriLibCompareStringIns(&FirstName, &SecondName) <= 0)) {
+            Next = FirstChild;
+            FirstChild = Mft->Entries[FirstChild].NextSibling;
         } else {
-            do {
-                if (_tcscmp(FindStreamData.cStreamName, L"::$DATA") != 0) {
-                    FileSize.QuadPart += FindStreamData.StreamSize.QuadPart;
-                    if (DuContext->AllocationSize) {
-                        FileSize.QuadPart = (FileSize.QuadPart + DirStack->AllocationSize - 1) & (~(DirStack->AllocationSize - 1));
-                    }
-                }
-            } while (DllKernel32.pFindNextStreamW(hFind, &FindStreamData));
-            FindClose(hFind);
+            Next = Second;
+            Second = Mft->Entries[Second].NextSibling;
+        }
+
+        if (Tail == 0) {
+            Head = Next;
+        } else {
+            Mft->Entries[Tail].NextSibling = Next;
         }
+        Tail = Next;
     }
 
-    //
-    //  If the file has a size and hardlink averaging is reuqested, divide the
-    //  size found by the number of hard links.
-    //
+    return Head;
+}
+
+/**
+ Populate a directory frame from the totals calculated for a directory in
+ the MFT.
 
-    if (DuContext->AverageHardLinkSize && FileHandle != INVALID_HANDLE_VALUE && FileSize.QuadPart != 0) {
-        BY_HANDLE_FILE_INFORMATION HandleFileInfo;
+ @param Mft Pointer to the information collected from the MFT.
 
-        if (GetFileInformationByHandle(FileHandle, &HandleFileInfo)) {
-            if (HandleFileInfo.nNumberOfLinks > 1) {
-                FileSize.QuadPart = FileSize.QuadPart / HandleFileInfo.nNumberOfLinks;
-            }
-        }
+ @param DirStack Pointer to the directory frame to populate.  The caller is
+        expected to have populated the directory name.
+
+ @param Segment The segment number of the directory.
+ */
+VOID
+DuMftPrepareStack(
+    __in PDU_MFT Mft,
+    __in PDU_DIRECTORY_STACK DirStack,
+    __in DWORD Segment
+    )
+{
+    PDU_MFT_ENTRY Entry;
+
+    Entry = &Mft->Entries[Segment];
+    if ((Entry->Flags & DU_MFT_ENTRY_CHILDREN_SORTED) == 0) {
+        Entry->u.Directory.FirstChild = DuMftSortChildren(Mft, Entry->u.Directory.FirstChild);
+        Entry->Flags = (UCHAR)(Entry->Flags | DU_MFT_ENTRY_CHILDREN_SORTED);
     }
 
-    if (FileHandle != INVALID_HANDLE_VALUE) {
-        CloseHandle(FileHandle);
+    DirStack->ObjectsFoundThisDirectory = Entry->u.Directory.ObjectsFound;
+    DirStack->SpaceConsumedThisDirectory = Entry->u.Directory.SpaceConsumed;
+    DirStack->SpaceConsumedInChildren = 0;
+    DirStack->MftNextChild = Entry->u.Directory.FirstChild;
+}
+
+/**
+ Read the MFT of the volume containing a directory and calculate the space
+ consumed by every directory on the volume.  On success the results are
+ retained in the du context so other directories on the same volume can be
+ displayed without reading the MFT again.
+
+ @param DuContext Pointer to the du context.
+
+ @param FullPath Pointer to a fully specified path to a directory on the
+        volume.
+
+ @param VolumeSerialNumber The serial number of the volume, used to check
+        that the volume being read contains the directory.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+DuMftLoad(
+    __in PDU_CONTEXT DuContext,
+    __in PYORI_STRING FullPath,
+    __in DWORD VolumeSerialNumber
+    )
+{
+    NTFS_VOLUME_DATA_BUFFER VolumeData;
+    HANDLE VolumeHandle;
+    PDU_MFT Mft;
+    DWORDLONG EntryCount;
+    DWORD Err;
+
+    if (DuContext->Mft != NULL) {
+        DuMftFree(DuContext->Mft);
+        DuContext->Mft = NULL;
     }
 
+    VolumeHandle = YoriLibMftOpenVolume(FullPath, &VolumeData);
+    if (VolumeHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
 
-    return FileSize;
-}
+    if (VolumeData.VolumeSerialNumber.LowPart != VolumeSerialNumber) {
+        CloseHandle(VolumeHandle);
+        SetLastError(ERROR_NOT_SAME_DEVICE);
+        return FALSE;
+    }
 
+    EntryCount = VolumeData.MftValidDataLength.QuadPart / VolumeData.BytesPerFileRecordSegment;
+    if (EntryCount * sizeof(DU_MFT_ENTRY) > YORI_MAX_ALLOC_SIZE) {
+        CloseHandle(VolumeHandle);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
 
+    Mft = YoriLibMalloc(sizeof(DU_MFT));
+    if (Mft == NULL) {
+        CloseHandle(VolumeHandle);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
 
-/**
- A callback that is invoked when a file is found that matches a search criteria
- specified in the set of strings to enumerate.
+    ZeroMemory(Mft, sizeof(DU_MFT));
+    Mft->VolumeSerialNumber = VolumeSerialNumber;
+    Mft->BytesPerCluster = VolumeData.BytesPerCluster;
+    Mft->EntryCount = (DWORD)EntryCount;
+    Mft->Entries = YoriLibMalloc((YORI_ALLOC_SIZE_T)(EntryCount * sizeof(DU_MFT_ENTRY)));
+    if (Mft->Entries == NULL) {
+        CloseHandle(VolumeHandle);
+        DuMftFree(Mft);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+    ZeroMemory(Mft->Entries, (YORI_ALLOC_SIZE_T)(EntryCount * sizeof(DU_MFT_ENTRY)));
+
+    DuContext->Mft = Mft;
+    if (!YoriLibMftEnumerateRecords(VolumeHandle, &VolumeData, DuMftRecordCallback, DuContext)) {
+        Err = GetLastError();
+        CloseHandle(VolumeHandle);
+        DuMftFree(Mft);
+        DuContext->Mft = NULL;
+        SetLastError(Err);
+        return FALSE;
+    }
 
- @param FilePath Pointer to the file path that was found.
+    CloseHandle(VolumeHandle);
+    DuMftCalculateTotals(DuContext);
+    return TRUE;
+}
 
- @param FileInfo Information about the file.
+/**
+ Attempt to calculate and display the space used within a single directory
+ by reading the MFT of its volume.  This fails without displaying anything
+ if the search criteria is not a single directory, or if the MFT cannot be
+ read, so the caller can enumerate the directory instead.
 
- @param Depth Recursion depth, ignored in this application.
+ @param DuContext Pointer to the du context.
 
- @param Context Pointer to the du context structure indicating the
-        action to perform and populated with the number of objects found.
+ @param FileSpec Pointer to the search criteria.
 
- @return TRUE to continute enumerating, FALSE to abort.
+ @return TRUE if the space has been displayed, FALSE if the caller should
+         enumerate the directory.
  */
+__success(return)
 BOOL
-DuFileFoundCallback(
-    __in PYORI_STRING FilePath,
-    __in PWIN32_FIND_DATA FileInfo,
-    __in DWORD Depth,
-    __in PVOID Context
+DuMftEnumerateSpec(
+    __in PDU_CONTEXT DuContext,
+    __in PYORI_STRING FileSpec
     )
 {
-    PDU_CONTEXT DuContext = (PDU_CONTEXT)Context;
+    YORI_STRING FullPath;
+    YORI_STRING ChildName;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    HANDLE FileHandle;
+    PDU_MFT Mft;
+    PDU_MFT_ENTRY Entry;
+    PDU_DIRECTORY_STACK DirStack;
+    PDU_DIRECTORY_STACK ChildStack;
     LPTSTR FilePart;
+    DWORD TargetSegment;
+    DWORD Child;
+    DWORD Depth;
+    DWORD Err;
+    BOOLEAN Abort;
     YORI_ALLOC_SIZE_T Index;
+    YORI_SIGNED_ALLOC_SIZE_T NameLength;
 
     //
-    //  Depth can only describe the number of path seperators in a single
-    //  string, so cannot exceed the allocation granularity of the system
+    //  Wildcards and braces are resolved by enumerating.
     //
 
-    ASSERT(Depth < YORI_MAX_ALLOC_SIZE);
+    for (Index = 0; Index < FileSpec->LengthInChars; Index++) {
+        if (FileSpec->StartOfString[Index] == '*' ||
+            FileSpec->StartOfString[Index] == '?' ||
+            FileSpec->StartOfString[Index] == '{' ||
+            FileSpec->StartOfString[Index] == '[') {
 
-    if (Depth >= DuContext->StackAllocated) {
-        PDU_DIRECTORY_STACK NewStack;
-        DWORD BytesRequested;
-        YORI_ALLOC_SIZE_T BytesToAllocate;
-        BytesRequested = (Depth + 8) * sizeof(DU_DIRECTORY_STACK);
-        BytesToAllocate = YoriLibMaximumAllocationInRange(BytesRequested, BytesRequested);
-        if (BytesToAllocate == 0) {
             return FALSE;
         }
-        NewStack = YoriLibMalloc(BytesToAllocate);
-        if (NewStack == NULL) {
+    }
+
+    YoriLibInitEmptyString(&FullPath);
+    if (!YoriLibUserStringToSingleFilePath(FileSpec, TRUE, &FullPath)) {
+        return FALSE;
+    }
+
+    FileHandle = CreateFile(FullPath.StartOfString,
+                            FILE_READ_ATTRIBUTES|SYNCHRONIZE,
+                            FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_BACKUP_SEMANTICS,
+                            NULL);
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        YoriLibFreeStringContents(&FullPath);
+        return FALSE;
+    }
+
+    if (!GetFileInformationByHandle(FileHandle, &FileInfo)) {
+        CloseHandle(FileHandle);
+        YoriLibFreeStringContents(&FullPath);
+        return FALSE;
+    }
+    CloseHandle(FileHandle);
+
+    if ((FileInfo.dwFileAttributes & (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_REPARSE_POINT)) != FILE_ATTRIBUTE_DIRECTORY ||
+        (FileInfo.nFileIndexHigh & 0xFFFF) != 0) {
+
+        YoriLibFreeStringContents(&FullPath);
+        return FALSE;
+    }
+    TargetSegment = FileInfo.nFileIndexLow;
+
+    if (DuContext->Mft == NULL ||
+        DuContext->Mft->VolumeSerialNumber != FileInfo.dwVolumeSerialNumber) {
+
+        if (!DuMftLoad(DuContext, &FullPath, FileInfo.dwVolumeSerialNumber)) {
+            LPTSTR ErrText;
+            Err = GetLastError();
+            ErrText = YoriLibGetWinErrorText(Err);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("du: MFT of %y could not be read, enumerating directories: %s"), FileSpec, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            YoriLibFreeStringContents(&FullPath);
             return FALSE;
         }
+    }
 
-        if (DuContext->StackAllocated > 0) {
-            memcpy(NewStack, DuContext->DirStack, DuContext->StackAllocated * sizeof(DU_DIRECTORY_STACK));
-            YoriLibFree(DuContext->DirStack);
-        }
+    Mft = DuContext->Mft;
+    if (TargetSegment >= Mft->EntryCount) {
+        YoriLibFreeStringContents(&FullPath);
+        return FALSE;
+    }
 
-        for (Index = DuContext->StackAllocated; Index < Depth + 8; Index++) {
-            YoriLibInitEmptyString(&NewStack[Index].DirectoryName);
-            NewStack[Index].ObjectsFoundThisDirectory = 0;
-            NewStack[Index].SpaceConsumedThisDirectory = 0;
-            NewStack[Index].SpaceConsumedInChildren = 0;
-        }
+    Entry = &Mft->Entries[TargetSegment];
+    if ((Entry->Flags & (DU_MFT_ENTRY_IN_USE | DU_MFT_ENTRY_DIRECTORY)) != (DU_MFT_ENTRY_IN_USE | DU_MFT_ENTRY_DIRECTORY)) {
+        YoriLibFreeStringContents(&FullPath);
+        return FALSE;
+    }
 
-        DuContext->DirStack = NewStack;
-        DuContext->StackAllocated = (YORI_ALLOC_SIZE_T)Depth + 8;
+    Depth = 1;
+    if (!DuEnsureStackDepth(DuContext, Depth)) {
+        YoriLibFreeStringContents(&FullPath);
+        return FALSE;
     }
 
     //
-    //  StackIndex would normally be populated except for the first item at
-    //  Depth == 0
+    //  Display the target with the case recorded in its parent directory,
+    //  as enumerating would.
     //
 
-    if (DuContext->StackIndex > 0 || DuContext->DirStack[0].DirectoryName.LengthInChars > 0) {
-        Index = DuContext->StackIndex;
-        while (TRUE) {
-            YORI_ALLOC_SIZE_T StackDirLength;
-            StackDirLength = DuContext->DirStack[Index].DirectoryName.LengthInChars;
-            if (Depth >= Index &&
-                YoriLibCompareStringCnt(FilePath, &DuContext->DirStack[Index].DirectoryName, StackDirLength) == 0 &&
-                (FilePath->LengthInChars == StackDirLength ||
-                 YoriLibIsSep(FilePath->StartOfString[StackDirLength]) ||
-                 YoriLibIsSep(DuContext->DirStack[Index].DirectoryName.StartOfString[StackDirLength - 1]))) {
+    DirStack = &DuContext->DirStack[Depth];
+    while (FullPath.LengthInChars > 0 &&
+           YoriLibIsSep(FullPath.StartOfString[FullPath.LengthInChars - 1]) &&
+           TargetSegment != DU_MFT_ROOT_SEGMENT) {
 
-                break;
-            }
+        FullPath.LengthInChars--;
+    }
 
-            if (Index > 0) {
-                DuContext->DirStack[Index - 1].SpaceConsumedInChildren +=
-                    DuContext->DirStack[Index].SpaceConsumedInChildren +
-                    DuContext->DirStack[Index].SpaceConsumedThisDirectory;
-            }
-            DuReportAndCloseStack(DuContext, Index);
-            if (Index == 0) {
-                break;
-            }
-            Index--;
-            DuContext->StackIndex--;
-        }
+    FilePart = NULL;
+    if (TargetSegment != DU_MFT_ROOT_SEGMENT && (Entry->Flags & DU_MFT_ENTRY_HAS_NAME) != 0) {
+        FilePart = YoriLibFindRightMostCharacter(&FullPath, '\\');
     }
 
-    FilePart = YoriLibFindRightMostCharacter(FilePath, '\\');
-    ASSERT(FilePart != NULL);
     if (FilePart != NULL) {
-        YORI_STRING ThisDirName;
-        YoriLibInitEmptyString(&ThisDirName);
-        ThisDirName.StartOfString = FilePath->StartOfString;
-        ThisDirName.LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - FilePath->StartOfString);
-        if (ThisDirName.LengthInChars == 6) {
-            ThisDirName.LengthInChars++;
-            if (!YoriLibIsPfxDrvLetterColonSlash(&ThisDirName)) {
-                ThisDirName.LengthInChars--;
-            }
+        YoriLibInitEmptyString(&ChildName);
+        ChildName.StartOfString = &Mft->Names[Entry->NameOffset];
+        ChildName.LengthInChars = Entry->NameLength;
+        FullPath.LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - FullPath.StartOfString + 1);
+        if (YoriLibYPrintf(&DirStack->DirectoryName, _T("%y%y"), &FullPath, &ChildName) < 0) {
+            YoriLibFreeStringContents(&FullPath);
+            return FALSE;
         }
+    } else {
+        if (YoriLibYPrintf(&DirStack->DirectoryName, _T("%y"), &FullPath) < 0) {
+            YoriLibFreeStringContents(&FullPath);
+            return FALSE;
+        }
+    }
+    YoriLibFreeStringContents(&FullPath);
 
-        Index = (YORI_ALLOC_SIZE_T)Depth;
-        while (TRUE) {
-            if (DuContext->DirStack[Index].DirectoryName.LengthInChars > 0) {
+    //
+    //  Walk the tree of directories, displaying each after its
+    //  subdirectories, which is the order enumerating would display them.
+    //
 
-                ASSERT(Index == DuContext->StackIndex);
-                ASSERT(YoriLibCompareString(&DuContext->DirStack[Index].DirectoryName, &ThisDirName) == 0);
-                break;
+    DuMftPrepareStack(Mft, DirStack, TargetSegment);
+    Abort = FALSE;
+    while (TRUE) {
+        DirStack = &DuContext->DirStack[Depth];
+        if (!Abort && DirStack->MftNextChild != 0) {
+            if (YoriLibIsOperationCancelled()) {
+                Abort = TRUE;
+                continue;
             }
-            if (!DuInitializeDirectoryStack(DuContext, &DuContext->DirStack[Index], &ThisDirName)) {
-                return FALSE;
+
+            Child = DirStack->MftNextChild;
+            Entry = &Mft->Entries[Child];
+            DirStack->MftNextChild = Entry->NextSibling;
+            if ((Entry->Flags & DU_MFT_ENTRY_HAS_NAME) == 0) {
+                continue;
             }
-            ASSERT(DuContext->DirStack[Index].ObjectsFoundThisDirectory == 0);
-            ASSERT(DuContext->DirStack[Index].SpaceConsumedThisDirectory == 0);
-            ASSERT(DuContext->DirStack[Index].SpaceConsumedInChildren == 0);
-            if (Index == 0) {
-                break;
+
+            if (!DuEnsureStackDepth(DuContext, Depth + 1)) {
+                Abort = TRUE;
+                continue;
             }
-            Index--;
-            FilePart = YoriLibFindRightMostCharacter(&ThisDirName, '\\');
-            ASSERT(FilePart != NULL);
-            ThisDirName.LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - ThisDirName.StartOfString);
-            if (ThisDirName.LengthInChars == 6) {
-                ThisDirName.LengthInChars++;
-                if (!YoriLibIsPfxDrvLetterColonSlash(&ThisDirName)) {
-                    ThisDirName.LengthInChars--;
-                }
+
+            DirStack = &DuContext->DirStack[Depth];
+            ChildStack = &DuContext->DirStack[Depth + 1];
+            YoriLibInitEmptyString(&ChildName);
+            ChildName.StartOfString = &Mft->Names[Entry->NameOffset];
+            ChildName.LengthInChars = Entry->NameLength;
+            if (YoriLibIsSep(DirStack->DirectoryName.StartOfString[DirStack->DirectoryName.LengthInChars - 1])) {
+                NameLength = YoriLibYPrintf(&ChildStack->DirectoryName, _T("%y%y"), &DirStack->DirectoryName, &ChildName);
+            } else {
+                NameLength = YoriLibYPrintf(&ChildStack->DirectoryName, _T("%y\\%y"), &DirStack->DirectoryName, &ChildName);
+            }
+
+            if (NameLength < 0) {
+                Abort = TRUE;
+                continue;
             }
+
+            DuMftPrepareStack(Mft, ChildStack, Child);
+            Depth++;
+            continue;
         }
-    }
 
-    DuContext->StackIndex = (YORI_ALLOC_SIZE_T)Depth;
-    DuContext->DirStack[Depth].ObjectsFoundThisDirectory++;
+        if (Depth > 1) {
+            DuContext->DirStack[Depth - 1].SpaceConsumedInChildren +=
+                DirStack->SpaceConsumedInChildren +
+                DirStack->SpaceConsumedThisDirectory;
+        }
 
-    if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
-        LARGE_INTEGER FileSize;
-        FileSize = DuCalculateSpaceUsedByFile(DuContext, &DuContext->DirStack[Depth], FilePath, FileInfo);
-        DuContext->DirStack[Depth].SpaceConsumedThisDirectory += FileSize.QuadPart;
+        DirStack->MftNextChild = 0;
+        if (DirStack->ObjectsFoundThisDirectory > 0) {
+            DuReportAndCloseStack(DuContext, Depth);
+        } else {
+            DuCloseStack(DirStack);
+        }
+
+        if (Depth == 1) {
+            break;
+        }
+        Depth--;
     }
 
     return TRUE;
 }
 
 /**
- A callback that is invoked when a directory cannot be successfully enumerated.
-
- @param FilePath Pointer to the file path that could not be enumerated.
+ Calculate and display the space used within directories matching a
+ single user specified search criteria.
 
- @param ErrorCode The Win32 error code describing the failure.
-
- @param Depth Recursion depth, ignored in this application.
+ @param DuContext Pointer to the du context.
 
- @param Context Pointer to the du context structure indicating the
-        action to perform and populated with the number of objects found.
+ @param FileSpec Pointer to the search criteria.
 
- @return TRUE to continute enumerating, FALSE to abort.
+ @param ErrorCallback Optionally points to a function to invoke if a
+        directory cannot be enumerated.
  */
-BOOL
-DuFileEnumerateErrorCallback(
-    __in PYORI_STRING FilePath,
-    __in DWORD ErrorCode,
-    __in DWORD Depth,
-    __in PVOID Context
+VOID
+DuEnumerateSpec(
+    __in PDU_CONTEXT DuContext,
+    __in PYORI_STRING FileSpec,
+    __in_opt PYORILIB_FILE_ENUM_ERROR_FN ErrorCallback
     )
 {
-    LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
-    UNREFERENCED_PARAMETER(Depth);
-    UNREFERENCED_PARAMETER(Context);
-    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Enumerate of %y failed, results incomplete: %s"), FilePath, ErrText);
-    YoriLibFreeWinErrorText(ErrText);
-    return TRUE;
+    WORD TopLevelFlags;
+
+    if (DuContext->UseMft && DuMftEnumerateSpec(DuContext, FileSpec)) {
+        DuReportAndCloseAllActiveStacks(DuContext, 1, NULL);
+        return;
+    }
+
+    if (DuContext->WorkerCount > 0) {
+
+        //
+        //  Only directories at the top level need to be found here, since
+        //  files at the top level are accounted for in a frame which is
+        //  never displayed.  Workers recurse into each directory.
+        //
+
+        TopLevelFlags = (WORD)(DuContext->MatchFlags & ~(YORILIB_FILEENUM_RETURN_FILES |
+                                                        YORILIB_FILEENUM_RECURSE_AFTER_RETURN |
+                                                        YORILIB_FILEENUM_RECURSE_BEFORE_RETURN));
+
+        DuContext->ErrorCallback = ErrorCallback;
+        YoriLibForEachFile(FileSpec, TopLevelFlags, 0, DuTopLevelFileFoundCallback, ErrorCallback, DuContext);
+        DuRetireJobs(DuContext, TRUE);
+    } else {
+        YoriLibForEachFile(FileSpec, DuContext->MatchFlags, 0, DuFileFoundCallback, ErrorCallback, DuContext);
+    }
+    DuReportAndCloseAllActiveStacks(DuContext, 1, NULL);
 }
 
 #ifdef YORI_BUILTIN
@@ -846,11 +3450,16 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T StartArg = 0;
     WORD MatchFlags;
     BOOLEAN BasicEnumeration = FALSE;
+    DWORD WorkerCount = 0;
+    DWORD TopCount = 0;
     DU_CONTEXT DuContext;
+    DU_FILE_ID_SET FileIdSet;
     YORI_STRING Combined;
     YORI_STRING Arg;
 
     ZeroMemory(&DuContext, sizeof(DuContext));
+    ZeroMemory(&FileIdSet, sizeof(FileIdSet));
+    DuContext.FileIdSet = &FileIdSet;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -883,6 +3492,30 @@ ENTRYPOINT(
                 ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("h")) == 0) {
                 DuContext.AverageHardLinkSize = TRUE;
+                DuContext.CountHardLinksOnce = FALSE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("hx")) == 0) {
+                DuContext.CountHardLinksOnce = TRUE;
+                DuContext.AverageHardLinkSize = FALSE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (i + 1 < ArgC) {
+                    YORI_MAX_SIGNED_T Count;
+                    YORI_ALLOC_SIZE_T CharsConsumed;
+                    if (YoriLibStringToNumber(&ArgV[i + 1], FALSE, &Count, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        Count > 0) {
+
+                        WorkerCount = DU_MAX_WORKERS;
+                        if (Count < DU_MAX_WORKERS) {
+                            WorkerCount = (DWORD)Count;
+                        }
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("mft")) == 0) {
+                DuContext.UseMft = TRUE;
                 ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("r")) == 0) {
                 if (i + 1 < ArgC) {
@@ -901,6 +3534,22 @@ ENTRYPOINT(
                     ArgumentUnderstood = TRUE;
                     i++;
                 }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("top")) == 0) {
+                if (i + 1 < ArgC) {
+                    YORI_MAX_SIGNED_T Count;
+                    YORI_ALLOC_SIZE_T CharsConsumed;
+                    if (YoriLibStringToNumber(&ArgV[i + 1], FALSE, &Count, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        Count > 0) {
+
+                        TopCount = DU_MAX_TOP_COUNT;
+                        if (Count < DU_MAX_TOP_COUNT) {
+                            TopCount = (DWORD)Count;
+                        }
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("u")) == 0) {
                 DuContext.AllocationSize = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -951,11 +3600,44 @@ ENTRYPOINT(
     MatchFlags = YORILIB_FILEENUM_RETURN_FILES |
                  YORILIB_FILEENUM_RETURN_DIRECTORIES |
                  YORILIB_FILEENUM_RECURSE_BEFORE_RETURN |
-                 YORILIB_FILEENUM_NO_LINK_TRAVERSE;
+                 YORILIB_FILEENUM_NO_LINK_TRAVERSE |
+                 YORILIB_FILEENUM_BASIC_INFO;
     if (BasicEnumeration) {
         MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
     }
 
+    DuContext.MatchFlags = MatchFlags;
+
+    if (TopCount > 0) {
+        if (!DuTopInitialize(&DuContext.TopDirectories, TopCount) ||
+            !DuTopInitialize(&DuContext.TopFiles, TopCount)) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("du: out of memory\n"));
+            DuCleanupContext(&DuContext);
+            return EXIT_FAILURE;
+        }
+    }
+
+    //
+    //  All output is written from this thread; worker threads buffer their
+    //  results for this thread to display.
+    //
+
+    YoriLibEnableOutputBuffering();
+
+    if (WorkerCount > 1) {
+        if (DuContext.CountHardLinksOnce) {
+            FileIdSet.Mutex = CreateMutex(NULL, FALSE, NULL);
+            if (FileIdSet.Mutex == NULL) {
+                WorkerCount = 1;
+            }
+        }
+    }
+
+    if (WorkerCount > 1) {
+        DuStartWorkers(&DuContext, WorkerCount);
+    }
+
     //
     //  If no file name is specified, use .
     //
@@ -963,15 +3645,32 @@ ENTRYPOINT(
     if (StartArg == 0 || StartArg == ArgC) {
         YORI_STRING FilesInDirectorySpec;
         YoriLibConstantString(&FilesInDirectorySpec, _T("."));
-        YoriLibForEachFile(&FilesInDirectorySpec, MatchFlags, 0, DuFileFoundCallback, NULL, &DuContext);
-        DuReportAndCloseAllActiveStacks(&DuContext, 1);
+        DuEnumerateSpec(&DuContext, &FilesInDirectorySpec, NULL);
     } else {
         for (i = StartArg; i < ArgC; i++) {
-            YoriLibForEachFile(&ArgV[i], MatchFlags, 0, DuFileFoundCallback, DuFileEnumerateErrorCallback, &DuContext);
-            DuReportAndCloseAllActiveStacks(&DuContext, 1);
+            DuEnumerateSpec(&DuContext, &ArgV[i], DuFileEnumerateErrorCallback);
+        }
+    }
+
+    DuStopWorkers(&DuContext);
+    DuFileIdSetCleanup(&FileIdSet);
+
+    //
+    //  Display the largest directories, then the largest files, separated
+    //  by a blank line.
+    //
+
+    if (DuContext.TopDirectories.Capacity > 0) {
+        DWORD DirectoryCount;
+        DirectoryCount = DuContext.TopDirectories.Count;
+        DuTopDisplay(&DuContext, &DuContext.TopDirectories);
+        if (DirectoryCount > 0 && DuContext.TopFiles.Count > 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
         }
+        DuTopDisplay(&DuContext, &DuContext.TopFiles);
     }
 
+    YoriLibDisableOutputBuffering();
     DuCleanupContext(&DuContext);
 
     return EXIT_SUCCESS;
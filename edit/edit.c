@@ -65,6 +65,232 @@ EditHelp(VOID)
     return TRUE;
 }
 
+/**
+ The number of lines to load before a file is displayed.  Any remaining
+ lines are loaded by a background thread.
+ */
+#define EDIT_INITIAL_LOAD_LINES (1000)
+
+/**
+ The number of lines the background thread loads before making them
+ available to the edit control.
+ */
+#define EDIT_BACKGROUND_LOAD_LINES (0x4000)
+
+/**
+ The interval in milliseconds between checks for lines loaded by the
+ background thread.
+ */
+#define EDIT_BACKGROUND_LOAD_INTERVAL (200)
+
+/**
+ A buffer containing the text of multiple lines.  This allows lines to be
+ copied without an allocation for each line.
+ */
+typedef struct _EDIT_LINE_BUFFER {
+
+    /**
+     A referenced buffer containing the text of multiple lines.  Each line
+     holds a reference to the buffer.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The offset within Buffer to place the next line.
+     */
+    YORI_ALLOC_SIZE_T BufferOffset;
+
+    /**
+     The number of bytes remaining in Buffer.
+     */
+    YORI_ALLOC_SIZE_T BytesRemainingInBuffer;
+
+} EDIT_LINE_BUFFER, *PEDIT_LINE_BUFFER;
+
+/**
+ State describing a file being loaded into the edit control.  The first lines
+ of the file are loaded before the file is displayed, and the remainder are
+ loaded by a background thread and appended to the edit control
+ periodically.
+ */
+typedef struct _EDIT_LOADER {
+
+    /**
+     Handle to the file being loaded.
+     */
+    HANDLE hFile;
+
+    /**
+     Handle to the background thread loading the file.  NULL if the file is
+     being loaded synchronously.
+     */
+    HANDLE Thread;
+
+    /**
+     A mutex synchronizing the pending lines, progress and completion state
+     between the background thread and the user interface.
+     */
+    HANDLE Mutex;
+
+    /**
+     An auto reset event which is signalled whenever the background thread
+     adds pending lines or finishes.
+     */
+    HANDLE LinesAvailableEvent;
+
+    /**
+     The line reading context for the file.
+     */
+    PVOID LineContext;
+
+    /**
+     A buffer to read each line into before copying it into a line buffer.
+     */
+    YORI_STRING LineString;
+
+    /**
+     The buffer to place the text of lines which are read into.
+     */
+    EDIT_LINE_BUFFER LineBuffer;
+
+    /**
+     An array of lines loaded by the background thread which have not yet
+     been added to the edit control.
+     */
+    PYORI_STRING PendingLines;
+
+    /**
+     The number of elements allocated in the PendingLines array.
+     */
+    YORI_ALLOC_SIZE_T PendingLinesAllocated;
+
+    /**
+     The number of elements populated in the PendingLines array.
+     */
+    YORI_ALLOC_SIZE_T PendingLineCount;
+
+    /**
+     The size of the file in bytes.
+     */
+    LONGLONG FileSize;
+
+    /**
+     The number of bytes of the file which have been read.
+     */
+    LONGLONG BytesLoaded;
+
+    /**
+     The multibyte input encoding to restore once the load has finished.
+     */
+    DWORD SavedEncoding;
+
+    /**
+     The line ending of the first line which had one.
+     */
+    YORI_LIB_LINE_ENDING FirstLineEnding;
+
+    /**
+     Set to TRUE once the end of the file has been reached.
+     */
+    BOOLEAN EndOfFile;
+
+    /**
+     Set to TRUE if the file could not be loaded in its entirety.
+     */
+    BOOLEAN Failed;
+
+    /**
+     Set to TRUE by the background thread when it will not add any further
+     pending lines.
+     */
+    BOOLEAN Complete;
+
+    /**
+     Set to TRUE by the user interface to request the background thread
+     stop loading.
+     */
+    BOOLEAN Cancel;
+
+} EDIT_LOADER, *PEDIT_LOADER;
+
+/**
+ The size of the buffer used to encode text before writing it to a file
+ being saved.
+ */
+#define EDIT_SAVE_BUFFER_SIZE (1024 * 1024)
+
+/**
+ The interval in milliseconds between checks for whether a background save
+ has completed.
+ */
+#define EDIT_BACKGROUND_SAVE_INTERVAL (200)
+
+/**
+ State describing a file being saved.  The contents of the edit control are
+ copied when the save starts, and a background thread writes the copy to a
+ temporary file which is then renamed over the target.
+ */
+typedef struct _EDIT_SAVER {
+
+    /**
+     Handle to the background thread saving the file.  NULL if the file is
+     being saved synchronously.
+     */
+    HANDLE Thread;
+
+    /**
+     Handle to the temporary file being written.
+     */
+    HANDLE TempHandle;
+
+    /**
+     The name of the temporary file being written.
+     */
+    YORI_STRING TempFileName;
+
+    /**
+     The name of the file to replace once the temporary file is complete.
+     */
+    YORI_STRING FileName;
+
+    /**
+     A copy of the lines in the edit control when the save started.
+     */
+    PYORI_STRING Lines;
+
+    /**
+     The number of elements in the Lines array.
+     */
+    YORI_ALLOC_SIZE_T LineCount;
+
+    /**
+     The number of lines which have been written.  This is updated by the
+     background thread and used to display progress.
+     */
+    YORI_ALLOC_SIZE_T LinesWritten;
+
+    /**
+     The line ending to write after each line.
+     */
+    YORI_STRING Newline;
+
+    /**
+     The encoding to write the file in.
+     */
+    DWORD Encoding;
+
+    /**
+     TRUE if a byte order mark should be written at the start of the file.
+     */
+    BOOLEAN WriteBom;
+
+    /**
+     Set to TRUE once the file has been written and renamed into place.
+     */
+    BOOLEAN Result;
+
+} EDIT_SAVER, *PEDIT_SAVER;
+
 /**
  A context that records files found and being operated on in the current
  window.
@@ -223,6 +449,29 @@ typedef struct _EDIT_CONTEXT {
      */
     BOOLEAN ReadOnly;
 
+    /**
+     TRUE if the most recently opened file could not be loaded in its
+     entirety.
+     */
+    BOOLEAN LoadIncomplete;
+
+    /**
+     Pointer to the state of the file being loaded.  NULL if no file is
+     currently being loaded.
+     */
+    PEDIT_LOADER Loader;
+
+    /**
+     TRUE if the most recent background save failed.
+     */
+    BOOLEAN SaveFailed;
+
+    /**
+     Pointer to the state of the file being saved.  NULL if no file is
+     currently being saved.
+     */
+    PEDIT_SAVER Saver;
+
 } EDIT_CONTEXT, *PEDIT_CONTEXT;
 
 /**
@@ -349,108 +598,205 @@ EditUpdateOpenedFileCaption(
 }
 
 /**
- Process a single opened stream, enumerating through all lines and populating
- the multiline edit control with the contents.
+ Copy a line into a buffer shared with other lines, allocating a new buffer
+ if the current one does not have space for it.
 
- @param EditContext Pointer to the edit context.
+ @param LineBuffer Pointer to the shared buffer state.
+
+ @param Source Pointer to the line to copy.
 
- @param hSource The opened source stream.
+ @param Dest On successful completion, updated to refer to the copy of the
+        line.  The copy holds a reference on the shared buffer and is NULL
+        terminated.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
+__success(return)
 BOOLEAN
-EditPopulateFromStream(
-    __in PEDIT_CONTEXT EditContext,
-    __in HANDLE hSource
+EditLineBufferCopyLine(
+    __inout PEDIT_LINE_BUFFER LineBuffer,
+    __in PCYORI_STRING Source,
+    __out PYORI_STRING Dest
     )
 {
-    PVOID LineContext = NULL;
-    YORI_STRING LineString;
     PTCHAR NewLine;
     YORI_ALLOC_SIZE_T BytesRequired;
     YORI_ALLOC_SIZE_T BytesAfterAlignment;
-    PUCHAR Buffer = NULL;
-    YORI_ALLOC_SIZE_T BytesRemainingInBuffer = 0;
-    YORI_ALLOC_SIZE_T BufferOffset = 0;
     YORI_ALLOC_SIZE_T Alignment;
-    BOOLEAN Result;
-    YORI_ALLOC_SIZE_T LinesAllocated;
-    YORI_ALLOC_SIZE_T LinesPopulated;
     DWORD BytesDesired;
-    PYORI_STRING LineArray;
-    YORI_LIB_LINE_ENDING FirstLineEnding;
-    YORI_LIB_LINE_ENDING LineEnding;
-    BOOL TimeoutReached;
 
-    LineArray = NULL;
-    LinesAllocated = 0;
-    LinesPopulated = 0;
+    BytesRequired = (Source->LengthInChars + 1) * sizeof(TCHAR);
 
-    FirstLineEnding = YoriLibLineEndingNone;
+    //
+    //  Align to 8 bytes for the next line.
+    //
 
-    YoriLibInitEmptyString(&LineString);
-    Result = TRUE;
+    Alignment = (LineBuffer->BufferOffset + BytesRequired) % 8;
+    if (Alignment > 0) {
+        Alignment = 8 - Alignment;
+    }
+    BytesAfterAlignment = BytesRequired + Alignment;
 
-    while (TRUE) {
+    //
+    //  If we need a buffer, allocate a buffer that typically has space for
+    //  multiple lines
+    //
 
-        if (!YoriLibReadLineToStringEx(&LineString, &LineContext, TRUE, INFINITE, hSource, &LineEnding, &TimeoutReached)) {
-            break;
+    if (LineBuffer->Buffer == NULL || BytesAfterAlignment > LineBuffer->BytesRemainingInBuffer) {
+        if (LineBuffer->Buffer != NULL) {
+            YoriLibDereference(LineBuffer->Buffer);
+        }
+        BytesDesired = 64 * 1024;
+        if (BytesAfterAlignment > BytesDesired) {
+            BytesDesired = BytesAfterAlignment;
         }
+        LineBuffer->BytesRemainingInBuffer = YoriLibMaximumAllocationInRange(BytesAfterAlignment, BytesDesired);
+        LineBuffer->BufferOffset = 0;
 
-        if (FirstLineEnding == YoriLibLineEndingNone && LineEnding != YoriLibLineEndingNone) {
-            FirstLineEnding = LineEnding;
+        LineBuffer->Buffer = YoriLibReferencedMalloc(LineBuffer->BytesRemainingInBuffer);
+        if (LineBuffer->Buffer == NULL) {
+            LineBuffer->BytesRemainingInBuffer = 0;
+            return FALSE;
         }
+    }
 
-        BytesRequired = (LineString.LengthInChars + 1) * sizeof(TCHAR);
+    NewLine = (PTCHAR)YoriLibAddToPointer(LineBuffer->Buffer, LineBuffer->BufferOffset);
+    YoriLibReference(LineBuffer->Buffer);
 
-        //
-        //  Align to 8 bytes for the next line.
-        //
+    Dest->MemoryToFree = LineBuffer->Buffer;
+    Dest->StartOfString = NewLine;
+    Dest->LengthAllocated = BytesRequired / sizeof(TCHAR);
+    Dest->LengthInChars = Dest->LengthAllocated - 1;
 
-        Alignment = (BufferOffset + BytesRequired) % 8;
-        if (Alignment > 0) {
-            Alignment = 8 - Alignment;
-        }
-        BytesAfterAlignment = BytesRequired + Alignment;
+    memcpy(NewLine, Source->StartOfString, Source->LengthInChars * sizeof(TCHAR));
+    NewLine[Source->LengthInChars] = '\0';
 
-        //
-        //  If we need a buffer, allocate a buffer that typically has space for
-        //  multiple lines
-        //
+    //
+    //  Align to 8 bytes for the next line.
+    //
 
-        if (Buffer == NULL || BytesAfterAlignment > BytesRemainingInBuffer) {
-            if (Buffer != NULL) {
-                YoriLibDereference(Buffer);
-            }
-            BytesDesired = 64 * 1024;
-            if (BytesAfterAlignment > BytesDesired) {
-                BytesDesired = BytesAfterAlignment;
-            }
-            BytesRemainingInBuffer = YoriLibMaximumAllocationInRange(BytesAfterAlignment, BytesDesired);
-            BufferOffset = 0;
+    LineBuffer->BufferOffset = LineBuffer->BufferOffset + BytesAfterAlignment;
+    LineBuffer->BytesRemainingInBuffer = LineBuffer->BytesRemainingInBuffer - BytesAfterAlignment;
 
-            Buffer = YoriLibReferencedMalloc(BytesRemainingInBuffer);
-            if (Buffer == NULL) {
-                Result = FALSE;
-                break;
-            }
+    return TRUE;
+}
+
+/**
+ Release the reference held on a shared line buffer.  Lines which were
+ copied into the buffer retain their own references.
+
+ @param LineBuffer Pointer to the shared buffer state.
+ */
+VOID
+EditLineBufferCleanup(
+    __inout PEDIT_LINE_BUFFER LineBuffer
+    )
+{
+    if (LineBuffer->Buffer != NULL) {
+        YoriLibDereference(LineBuffer->Buffer);
+        LineBuffer->Buffer = NULL;
+    }
+    LineBuffer->BufferOffset = 0;
+    LineBuffer->BytesRemainingInBuffer = 0;
+}
+
+/**
+ Free an array of lines that were loaded from a file but have not been
+ added to the edit control.
+
+ @param LineArray Pointer to the array of lines.  This can be NULL if no
+        array has been allocated.
+
+ @param LineCount The number of lines populated in the array.
+ */
+VOID
+EditLoaderFreeLines(
+    __in_opt PYORI_STRING LineArray,
+    __in YORI_ALLOC_SIZE_T LineCount
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    for (Index = 0; Index < LineCount; Index++) {
+        YoriLibFreeStringContents(&LineArray[Index]);
+    }
+
+    if (LineArray != NULL) {
+        YoriLibDereference(LineArray);
+    }
+}
+
+/**
+ Read lines from a file being loaded into an array of lines.
+
+ @param Loader Pointer to the loader state.
+
+ @param MaxLines The maximum number of lines to read.  Fewer lines are read
+        if the end of the file is reached.
+
+ @param LineArray On input, points to an array of lines, which may be NULL.
+        On completion, updated to point to an array containing any
+        lines read.  This array may be reallocated by this function.
+
+ @param LinesAllocated On input, the number of elements allocated in
+        LineArray.  Updated if it is reallocated.
+
+ @param LinesPopulated On input, the number of elements populated in
+        LineArray.  Updated to include any lines read.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  Any lines
+         read before a failure are returned in LineArray.
+ */
+__success(return)
+BOOLEAN
+EditLoaderReadLines(
+    __inout PEDIT_LOADER Loader,
+    __in YORI_ALLOC_SIZE_T MaxLines,
+    __inout PYORI_STRING *LineArray,
+    __inout PYORI_ALLOC_SIZE_T LinesAllocated,
+    __inout PYORI_ALLOC_SIZE_T LinesPopulated
+    )
+{
+    YORI_ALLOC_SIZE_T LinesRead;
+    YORI_ALLOC_SIZE_T LocalLinesAllocated;
+    YORI_ALLOC_SIZE_T LocalLinesPopulated;
+    PYORI_STRING LocalLineArray;
+    BOOLEAN Result;
+    YORI_LIB_LINE_ENDING LineEnding;
+    BOOL TimeoutReached;
+
+    LocalLineArray = *LineArray;
+    LocalLinesAllocated = *LinesAllocated;
+    LocalLinesPopulated = *LinesPopulated;
+    LinesRead = 0;
+    Result = TRUE;
+
+    while (LinesRead < MaxLines) {
+
+        if (!YoriLibReadLineToStringEx(&Loader->LineString, &Loader->LineContext, TRUE, INFINITE, Loader->hFile, &LineEnding, &TimeoutReached)) {
+            Loader->EndOfFile = TRUE;
+            break;
+        }
+
+        if (Loader->FirstLineEnding == YoriLibLineEndingNone && LineEnding != YoriLibLineEndingNone) {
+            Loader->FirstLineEnding = LineEnding;
         }
 
         //
         //  See if more lines in the line array need to be allocated
         //
 
-        if (LinesPopulated == LinesAllocated) {
+        if (LocalLinesPopulated == LocalLinesAllocated) {
             PYORI_STRING NewLineArray;
             YORI_ALLOC_SIZE_T BytesToAllocate;
             DWORD RequiredBytes;
             DWORD DesiredBytes;
 
-            RequiredBytes = LinesAllocated;
+            RequiredBytes = LocalLinesAllocated;
             RequiredBytes = RequiredBytes + 1;
             RequiredBytes = RequiredBytes * sizeof(YORI_STRING);
 
-            DesiredBytes = LinesAllocated;
+            DesiredBytes = LocalLinesAllocated;
             DesiredBytes = DesiredBytes * 2;
             if (DesiredBytes < 0x1000) {
                 DesiredBytes = 0x1000;
@@ -469,162 +815,965 @@ EditPopulateFromStream(
                 break;
             }
 
-            if (LinesPopulated > 0) {
-                memcpy(NewLineArray, LineArray, LinesPopulated * sizeof(YORI_STRING));
+            if (LocalLinesPopulated > 0) {
+                memcpy(NewLineArray, LocalLineArray, LocalLinesPopulated * sizeof(YORI_STRING));
             }
 
-            if (LineArray != NULL) {
-                YoriLibDereference(LineArray);
+            if (LocalLineArray != NULL) {
+                YoriLibDereference(LocalLineArray);
             }
-            LineArray = NewLineArray;
-            LinesAllocated = BytesToAllocate / sizeof(YORI_STRING);
+            LocalLineArray = NewLineArray;
+            LocalLinesAllocated = BytesToAllocate / sizeof(YORI_STRING);
         }
 
         //
         //  Write this line into the current buffer
         //
 
-        NewLine = (PTCHAR)YoriLibAddToPointer(Buffer, BufferOffset);
-        YoriLibReference(Buffer);
+        if (!EditLineBufferCopyLine(&Loader->LineBuffer, &Loader->LineString, &LocalLineArray[LocalLinesPopulated])) {
+            Result = FALSE;
+            break;
+        }
 
-        LineArray[LinesPopulated].MemoryToFree = Buffer;
-        LineArray[LinesPopulated].StartOfString = NewLine;
-        LineArray[LinesPopulated].LengthAllocated = BytesRequired / sizeof(TCHAR);
-        LineArray[LinesPopulated].LengthInChars = LineArray[LinesPopulated].LengthAllocated - 1;
+        LocalLinesPopulated++;
+        LinesRead++;
+    }
 
-        memcpy(NewLine, LineString.StartOfString, LineString.LengthInChars * sizeof(TCHAR));
-        NewLine[LineString.LengthInChars] = '\0';
+    *LineArray = LocalLineArray;
+    *LinesAllocated = LocalLinesAllocated;
+    *LinesPopulated = LocalLinesPopulated;
 
-        LinesPopulated++;
+    return Result;
+}
 
-        //
-        //  Align to 8 bytes for the next line.
-        //
+/**
+ Read lines from a file being loaded and append them to the edit control
+ on the calling thread.
 
-        BufferOffset = BufferOffset + BytesAfterAlignment;
-        BytesRemainingInBuffer = BytesRemainingInBuffer - BytesAfterAlignment;
-    }
+ @param EditContext Pointer to the edit context.
 
-    if (Buffer != NULL) {
-        YoriLibDereference(Buffer);
-    }
+ @param MaxLines The maximum number of lines to load.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+EditLoaderLoadLines(
+    __in PEDIT_CONTEXT EditContext,
+    __in YORI_ALLOC_SIZE_T MaxLines
+    )
+{
+    PEDIT_LOADER Loader;
+    PYORI_STRING LineArray;
+    YORI_ALLOC_SIZE_T LinesAllocated;
+    YORI_ALLOC_SIZE_T LinesPopulated;
+    BOOLEAN Result;
+
+    Loader = EditContext->Loader;
+    LineArray = NULL;
+    LinesAllocated = 0;
+    LinesPopulated = 0;
+
+    Result = EditLoaderReadLines(Loader, MaxLines, &LineArray, &LinesAllocated, &LinesPopulated);
+    if (Result && LinesPopulated > 0) {
+        if (YoriWinMultilineEditAppendLinesNoDataCopy(EditContext->MultilineEdit, LineArray, LinesPopulated)) {
+            LinesPopulated = 0;
+        } else {
+            Result = FALSE;
+        }
+    }
+
+    EditLoaderFreeLines(LineArray, LinesPopulated);
+    return Result;
+}
+
+/**
+ A background thread which loads the remainder of a file.  Lines are made
+ available to the user interface in batches via the pending line array.
+
+ @param Context Pointer to the loader state.
+
+ @return Thread exit code, which is ignored.
+ */
+DWORD WINAPI
+EditLoaderThread(
+    __in LPVOID Context
+    )
+{
+    PEDIT_LOADER Loader;
+    PYORI_STRING LineArray;
+    PYORI_STRING NewLineArray;
+    YORI_ALLOC_SIZE_T LinesAllocated;
+    YORI_ALLOC_SIZE_T LinesPopulated;
+    YORI_MAX_UNSIGNED_T LinesDesired;
+    LARGE_INTEGER FilePosition;
+    BOOLEAN Result;
+    BOOLEAN Finished;
+
+    Loader = (PEDIT_LOADER)Context;
+    Finished = FALSE;
+
+    while (!Finished) {
+        LineArray = NULL;
+        LinesAllocated = 0;
+        LinesPopulated = 0;
+
+        Result = EditLoaderReadLines(Loader, EDIT_BACKGROUND_LOAD_LINES, &LineArray, &LinesAllocated, &LinesPopulated);
+
+        FilePosition.HighPart = 0;
+        FilePosition.LowPart = SetFilePointer(Loader->hFile, 0, &FilePosition.HighPart, FILE_CURRENT);
+
+        WaitForSingleObject(Loader->Mutex, INFINITE);
+
+        if (!Loader->Cancel && LinesPopulated > 0) {
+
+            //
+            //  If the user interface has consumed all previous lines, hand
+            //  over this array.  Otherwise, append to the existing pending
+            //  lines.
+            //
+
+            if (Loader->PendingLineCount == 0) {
+                ASSERT(Loader->PendingLines == NULL);
+                Loader->PendingLines = LineArray;
+                Loader->PendingLinesAllocated = LinesAllocated;
+                Loader->PendingLineCount = LinesPopulated;
+                LineArray = NULL;
+                LinesPopulated = 0;
+            } else {
+                if (Loader->PendingLineCount + LinesPopulated > Loader->PendingLinesAllocated) {
+                    LinesDesired = Loader->PendingLineCount + LinesPopulated;
+                    LinesDesired = LinesDesired * 2;
+                    NewLineArray = NULL;
+                    if (YoriLibIsSizeAllocatable(LinesDesired * sizeof(YORI_STRING))) {
+                        NewLineArray = YoriLibReferencedMalloc((YORI_ALLOC_SIZE_T)LinesDesired * sizeof(YORI_STRING));
+                    }
+                    if (NewLineArray == NULL) {
+                        Result = FALSE;
+                    } else {
+                        memcpy(NewLineArray, Loader->PendingLines, Loader->PendingLineCount * sizeof(YORI_STRING));
+                        YoriLibDereference(Loader->PendingLines);
+                        Loader->PendingLines = NewLineArray;
+                        Loader->PendingLinesAllocated = (YORI_ALLOC_SIZE_T)LinesDesired;
+                    }
+                }
+
+                if (Result) {
+                    memcpy(&Loader->PendingLines[Loader->PendingLineCount], LineArray, LinesPopulated * sizeof(YORI_STRING));
+                    Loader->PendingLineCount = Loader->PendingLineCount + LinesPopulated;
+                    LinesPopulated = 0;
+                }
+            }
+        }
+
+        Loader->BytesLoaded = FilePosition.QuadPart;
+        if (!Result && !Loader->Cancel) {
+            Loader->Failed = TRUE;
+        }
+
+        if (!Result || Loader->EndOfFile || Loader->Cancel) {
+            Loader->Complete = TRUE;
+            Finished = TRUE;
+        }
+
+        ReleaseMutex(Loader->Mutex);
+        SetEvent(Loader->LinesAvailableEvent);
+
+        EditLoaderFreeLines(LineArray, LinesPopulated);
+    }
+
+    return 0;
+}
+
+/**
+ Move any lines loaded by the background thread into the edit control.
+
+ @param EditContext Pointer to the edit context.
+
+ @return TRUE to indicate the background thread has finished and no further
+         lines will be loaded, FALSE if it is still loading.
+ */
+BOOLEAN
+EditLoaderAppendPendingLines(
+    __in PEDIT_CONTEXT EditContext
+    )
+{
+    PEDIT_LOADER Loader;
+    PYORI_STRING LineArray;
+    YORI_ALLOC_SIZE_T LineCount;
+    BOOLEAN Complete;
+
+    Loader = EditContext->Loader;
+
+    WaitForSingleObject(Loader->Mutex, INFINITE);
+    LineArray = Loader->PendingLines;
+    LineCount = Loader->PendingLineCount;
+    Loader->PendingLines = NULL;
+    Loader->PendingLinesAllocated = 0;
+    Loader->PendingLineCount = 0;
+    Complete = Loader->Complete;
+    ReleaseMutex(Loader->Mutex);
+
+    if (LineCount > 0) {
+        if (YoriWinMultilineEditAppendLinesNoDataCopy(EditContext->MultilineEdit, LineArray, LineCount)) {
+            LineCount = 0;
+        } else {
+
+            //
+            //  If the lines cannot be added, stop loading since any later
+            //  lines would be in the wrong place.
+            //
+
+            WaitForSingleObject(Loader->Mutex, INFINITE);
+            Loader->Cancel = TRUE;
+            Loader->Failed = TRUE;
+            ReleaseMutex(Loader->Mutex);
+            Complete = TRUE;
+        }
+    }
+
+    EditLoaderFreeLines(LineArray, LineCount);
+    return Complete;
+}
+
+/**
+ Tear down the state for loading a file.  If a background thread is loading
+ the file, this waits for it to exit, so the caller should first indicate
+ that it should stop or ensure it has finished.
+
+ @param EditContext Pointer to the edit context.
+ */
+VOID
+EditLoaderClose(
+    __in PEDIT_CONTEXT EditContext
+    )
+{
+    PEDIT_LOADER Loader;
+
+    Loader = EditContext->Loader;
+    if (Loader == NULL) {
+        return;
+    }
+
+    if (Loader->Thread != NULL) {
+        WaitForSingleObject(Loader->Thread, INFINITE);
+        CloseHandle(Loader->Thread);
+        YoriWinSetPeriodicNotifyCallback(YoriWinGetControlParent(EditContext->MultilineEdit), 0, NULL);
+    }
+
+    if (Loader->Failed) {
+        EditContext->LoadIncomplete = TRUE;
+    }
+
+    EditLoaderFreeLines(Loader->PendingLines, Loader->PendingLineCount);
+
+    EditLineBufferCleanup(&Loader->LineBuffer);
+
+    if (Loader->LineContext != NULL) {
+        YoriLibLineReadCloseOrCache(Loader->LineContext);
+    }
+
+    YoriLibFreeStringContents(&Loader->LineString);
+    YoriLibSetMultibyteInputEncoding(Loader->SavedEncoding);
+
+    if (Loader->LinesAvailableEvent != NULL) {
+        CloseHandle(Loader->LinesAvailableEvent);
+    }
+
+    if (Loader->Mutex != NULL) {
+        CloseHandle(Loader->Mutex);
+    }
+
+    CloseHandle(Loader->hFile);
+    YoriLibFree(Loader);
+    EditContext->Loader = NULL;
+
+    YoriWinMultilineEditSetReadOnly(EditContext->MultilineEdit, EditContext->ReadOnly);
+}
+
+/**
+ Stop loading the current file, if a load is in progress.  Any lines which
+ have already been loaded remain in the edit control.
+
+ @param EditContext Pointer to the edit context.
+ */
+VOID
+EditCancelLoad(
+    __in PEDIT_CONTEXT EditContext
+    )
+{
+    PEDIT_LOADER Loader;
+
+    Loader = EditContext->Loader;
+    if (Loader == NULL) {
+        return;
+    }
+
+    if (Loader->Mutex != NULL) {
+        WaitForSingleObject(Loader->Mutex, INFINITE);
+        Loader->Cancel = TRUE;
+        ReleaseMutex(Loader->Mutex);
+    }
+
+    EditLoaderClose(EditContext);
+}
+
+/**
+ Update the status bar to display the cursor location, and the progress of
+ loading the file if it is still being loaded.
+
+ @param EditContext Pointer to the edit context.
+
+ @param CursorOffset The horizontal offset of the cursor in buffer
+        coordinates.
+
+ @param CursorLine The vertical offset of the cursor in buffer coordinates.
+ */
+VOID
+EditUpdateStatusBar(
+    __in PEDIT_CONTEXT EditContext,
+    __in DWORD CursorOffset,
+    __in DWORD CursorLine
+    )
+{
+    PEDIT_LOADER Loader;
+    PEDIT_SAVER Saver;
+    YORI_STRING NewStatus;
+    LONGLONG BytesLoaded;
+    DWORD Percent;
+
+    YoriLibInitEmptyString(&NewStatus);
+
+    Loader = EditContext->Loader;
+    if (Loader != NULL && Loader->Mutex != NULL) {
+        WaitForSingleObject(Loader->Mutex, INFINITE);
+        BytesLoaded = Loader->BytesLoaded;
+        ReleaseMutex(Loader->Mutex);
+
+        Percent = 0;
+        if (Loader->FileSize > 0) {
+            Percent = (DWORD)(BytesLoaded * 100 / Loader->FileSize);
+            if (Percent > 99) {
+                Percent = 99;
+            }
+        }
+
+        YoriLibYPrintf(&NewStatus, _T("Loading %i%%  %06i:%04i "), Percent, CursorLine + 1, CursorOffset + 1);
+    } else if (EditContext->Saver != NULL) {
+        Saver = EditContext->Saver;
+        Percent = 0;
+        if (Saver->LineCount > 0) {
+            Percent = (DWORD)((YORI_MAX_UNSIGNED_T)Saver->LinesWritten * 100 / Saver->LineCount);
+            if (Percent > 99) {
+                Percent = 99;
+            }
+        }
+
+        YoriLibYPrintf(&NewStatus, _T("Saving %i%%  %06i:%04i "), Percent, CursorLine + 1, CursorOffset + 1);
+    } else if (EditContext->SaveFailed) {
+        YoriLibYPrintf(&NewStatus, _T("Save failed  %06i:%04i "), CursorLine + 1, CursorOffset + 1);
+    } else if (EditContext->LoadIncomplete) {
+        YoriLibYPrintf(&NewStatus, _T("Incomplete  %06i:%04i "), CursorLine + 1, CursorOffset + 1);
+    } else {
+        YoriLibYPrintf(&NewStatus, _T("%06i:%04i "), CursorLine + 1, CursorOffset + 1);
+    }
+
+    YoriWinLabelSetCaption(EditContext->StatusBar, &NewStatus);
+    YoriLibFreeStringContents(&NewStatus);
+}
+
+/**
+ Update the status bar for the current cursor location and redisplay the
+ window.  This is used when the status changes without the cursor moving.
+
+ @param EditContext Pointer to the edit context.
+ */
+VOID
+EditRefreshStatusBar(
+    __in PEDIT_CONTEXT EditContext
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    YORI_ALLOC_SIZE_T CursorOffset;
+    YORI_ALLOC_SIZE_T CursorLine;
+
+    Parent = YoriWinGetControlParent(EditContext->MultilineEdit);
+    YoriWinMultilineEditGetCursorLocation(EditContext->MultilineEdit, &CursorOffset, &CursorLine);
+    EditUpdateStatusBar(EditContext, CursorOffset, CursorLine);
+    YoriWinDisplayWindowContents(Parent);
+}
+
+/**
+ Add any lines loaded by the background thread to the edit control and
+ update the display to indicate progress.
+
+ @param EditContext Pointer to the edit context.
+ */
+VOID
+EditLoaderUpdateDisplay(
+    __in PEDIT_CONTEXT EditContext
+    )
+{
+    if (EditContext->Loader != NULL &&
+        EditLoaderAppendPendingLines(EditContext)) {
+
+        EditLoaderClose(EditContext);
+    }
+
+    EditRefreshStatusBar(EditContext);
+}
+
+/**
+ A callback invoked periodically while a background thread is loading a
+ file.
+
+ @param Ctrl Pointer to the main window.
+ */
+VOID
+EditLoaderPeriodicCallback(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PEDIT_CONTEXT EditContext;
+
+    EditContext = YoriWinGetControlContext(Ctrl);
+    EditLoaderUpdateDisplay(EditContext);
+}
+
+/**
+ Wait for a file being loaded in the background to contain a specified
+ number of lines.  This is used before operations that need to see the
+ contents of the file beyond what has been loaded so far.
+
+ @param EditContext Pointer to the edit context.
+
+ @param LinesNeeded The number of lines required by the caller.  This
+        function returns once the edit control contains this many lines or
+        the load has finished.  Specify (YORI_ALLOC_SIZE_T)-1 to wait for
+        the entire file.
+ */
+VOID
+EditWaitForLoad(
+    __in PEDIT_CONTEXT EditContext,
+    __in YORI_ALLOC_SIZE_T LinesNeeded
+    )
+{
+    while (EditContext->Loader != NULL) {
+        EditLoaderUpdateDisplay(EditContext);
+        if (EditContext->Loader == NULL ||
+            YoriWinMultilineEditGetLineCount(EditContext->MultilineEdit) >= LinesNeeded) {
+
+            break;
+        }
+
+        WaitForSingleObject(EditContext->Loader->LinesAvailableEvent, INFINITE);
+    }
+}
+
+/**
+ Check if a file has the read only bit set.  If it does, we won't be able to
+ overwrite it.  Prompt the user to remove the read only bit, and if it can
+ be removed successfully, allow the save to continue.
+
+ @param Parent Pointer to the control describing the main window.
+
+ @param FileName The file that may be overwritten.
+
+ @return TRUE to indicate that the file is still write protected and cannot
+         be overwritten.  FALSE to indicate that the file doesn't exist or
+         is not write protected, so save can continue.
+ */
+BOOLEAN
+EditIsFileWriteProtected(
+    __in PYORI_WIN_CTRL_HANDLE Parent,
+    __in PYORI_STRING FileName
+    )
+{
+    DWORD Attributes;
+    DWORD ButtonPressed;
+    YORI_STRING UnescapedPath;
+    YORI_STRING Text;
+    YORI_STRING Title;
+    YORI_STRING ButtonText[2];
+    BOOLEAN WriteProtected;
+
+    WriteProtected = FALSE;
+    ASSERT(YoriLibIsStringNullTerminated(FileName));
+    Attributes = GetFileAttributes(FileName->StartOfString);
+    if (Attributes != (DWORD)-1 &&
+        (Attributes & FILE_ATTRIBUTE_READONLY) != 0) {
+
+        WriteProtected = TRUE;
+        YoriLibConstantString(&Title, _T("Overwrite read only file"));
+
+        YoriLibInitEmptyString(&UnescapedPath);
+        if (!YoriLibUnescapePath(FileName, &UnescapedPath)) {
+            UnescapedPath.StartOfString = FileName->StartOfString;
+            UnescapedPath.LengthInChars = FileName->LengthInChars;
+        }
+
+        YoriLibInitEmptyString(&Text);
+        YoriLibYPrintf(&Text,
+                       _T("%y is read only.  Overwrite?"),
+                       &UnescapedPath);
+
+        YoriLibFreeStringContents(&UnescapedPath);
+        YoriLibConstantString(&ButtonText[0], _T("&Overwrite"));
+        YoriLibConstantString(&ButtonText[1], _T("Do&n't save"));
+        ButtonPressed = YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
+                                          &Title,
+                                          &Text,
+                                          2,
+                                          ButtonText,
+                                          0,
+                                          0);
+        YoriLibFreeStringContents(&Text);
+
+        if (ButtonPressed == 1) {
+            Attributes = Attributes & ~(FILE_ATTRIBUTE_READONLY);
+            if (SetFileAttributes(FileName->StartOfString, Attributes)) {
+                WriteProtected = FALSE;
+            } else {
+                YoriLibConstantString(&Text, _T("Could not remove read only attribute."));
+                YoriLibConstantString(&ButtonText[0], _T("&Ok"));
+                YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
+                                  &Title,
+                                  &Text,
+                                  1,
+                                  ButtonText,
+                                  0,
+                                  0);
+            }
+        }
+    }
+
+    return WriteProtected;
+}
+
+/**
+ Free the state describing a file being saved.  The temporary file must
+ have been closed before calling this function.
+
+ @param Saver Pointer to the save state.
+ */
+VOID
+EditSaverFree(
+    __in PEDIT_SAVER Saver
+    )
+{
+    ASSERT(Saver->TempHandle == NULL);
+    EditLoaderFreeLines(Saver->Lines, Saver->LineCount);
+    YoriLibFreeStringContents(&Saver->TempFileName);
+    YoriLibFreeStringContents(&Saver->FileName);
+    YoriLibFree(Saver);
+}
+
+/**
+ Write the contents of the save buffer to the temporary file.
+
+ @param Saver Pointer to the save state.
+
+ @param Buffer Pointer to the encoded data to write.
+
+ @param BufferUsed On input, the number of bytes in Buffer to write.  On
+        successful completion, set to zero.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+EditSaverFlushBuffer(
+    __in PEDIT_SAVER Saver,
+    __in PUCHAR Buffer,
+    __inout PYORI_ALLOC_SIZE_T BufferUsed
+    )
+{
+    DWORD BytesWritten;
+
+    if (*BufferUsed == 0) {
+        return TRUE;
+    }
+
+    if (!WriteFile(Saver->TempHandle, Buffer, *BufferUsed, &BytesWritten, NULL) ||
+        BytesWritten != *BufferUsed) {
+
+        return FALSE;
+    }
+
+    *BufferUsed = 0;
+    return TRUE;
+}
+
+/**
+ Write the copy of the edit control contents into the temporary file,
+ and rename it over the target file.  Text is encoded into a large buffer
+ which is written as a unit, so the file is written in a small number of
+ large operations rather than one per line.
+
+ @param Saver Pointer to the save state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+EditSaverWriteFile(
+    __inout PEDIT_SAVER Saver
+    )
+{
+    PUCHAR Buffer;
+    PYORI_STRING Line;
+    YORI_ALLOC_SIZE_T LineIndex;
+    YORI_ALLOC_SIZE_T BufferUsed;
+    YORI_ALLOC_SIZE_T BytesNeeded;
+    YORI_ALLOC_SIZE_T NewlineLength;
+    UCHAR NewlineBuffer[8];
+    DWORD SavedEncoding;
+    DWORD Attributes;
+    BOOLEAN ReplaceSucceeded;
+    BOOLEAN Result;
+
+    Buffer = YoriLibMalloc(EDIT_SAVE_BUFFER_SIZE);
+    if (Buffer == NULL) {
+        CloseHandle(Saver->TempHandle);
+        Saver->TempHandle = NULL;
+        DeleteFile(Saver->TempFileName.StartOfString);
+        return FALSE;
+    }
+
+    BufferUsed = 0;
+    if (Saver->WriteBom) {
+        if (Saver->Encoding == CP_UTF8) {
+            Buffer[0] = 0xEF;
+            Buffer[1] = 0xBB;
+            Buffer[2] = 0xBF;
+            BufferUsed = 3;
+        } else if (Saver->Encoding == CP_UTF16) {
+            Buffer[0] = 0xFF;
+            Buffer[1] = 0xFE;
+            BufferUsed = 2;
+        }
+    }
+
+    SavedEncoding = YoriLibGetMultibyteOutputEncoding();
+    YoriLibSetMultibyteOutputEncoding(Saver->Encoding);
+
+    NewlineLength = YoriLibGetMbyteOutputSizeNeeded(Saver->Newline.StartOfString, Saver->Newline.LengthInChars);
+    ASSERT(NewlineLength <= sizeof(NewlineBuffer));
+    if (NewlineLength > sizeof(NewlineBuffer)) {
+        NewlineLength = 0;
+    }
+    YoriLibMultibyteOutput(Saver->Newline.StartOfString, Saver->Newline.LengthInChars, (LPSTR)NewlineBuffer, NewlineLength);
+
+    Result = TRUE;
+    for (LineIndex = 0; LineIndex < Saver->LineCount; LineIndex++) {
+        Line = &Saver->Lines[LineIndex];
+        if (Line->LengthInChars > 0) {
+            BytesNeeded = YoriLibGetMbyteOutputSizeNeeded(Line->StartOfString, Line->LengthInChars);
+            if (BytesNeeded > EDIT_SAVE_BUFFER_SIZE - BufferUsed) {
+                if (!EditSaverFlushBuffer(Saver, Buffer, &BufferUsed)) {
+                    Result = FALSE;
+                    break;
+                }
+            }
+
+            //
+            //  A line too large for the buffer is encoded and written by
+            //  itself.
+            //
+
+            if (BytesNeeded > EDIT_SAVE_BUFFER_SIZE) {
+                if (!YoriLibOutputTextToMbyteDev(Saver->TempHandle, Line)) {
+                    Result = FALSE;
+                    break;
+                }
+            } else {
+                YoriLibMultibyteOutput(Line->StartOfString, Line->LengthInChars, (LPSTR)YoriLibAddToPointer(Buffer, BufferUsed), BytesNeeded);
+                BufferUsed = BufferUsed + BytesNeeded;
+            }
+        }
+
+        if (NewlineLength > EDIT_SAVE_BUFFER_SIZE - BufferUsed) {
+            if (!EditSaverFlushBuffer(Saver, Buffer, &BufferUsed)) {
+                Result = FALSE;
+                break;
+            }
+        }
+
+        memcpy(YoriLibAddToPointer(Buffer, BufferUsed), NewlineBuffer, NewlineLength);
+        BufferUsed = BufferUsed + NewlineLength;
+        Saver->LinesWritten = LineIndex + 1;
+    }
+
+    YoriLibSetMultibyteOutputEncoding(SavedEncoding);
+
+    if (Result && !EditSaverFlushBuffer(Saver, Buffer, &BufferUsed)) {
+        Result = FALSE;
+    }
+
+    YoriLibFree(Buffer);
+
+    //
+    //  Flush the temporary file to ensure it's durable, and rename it over
+    //  the top of the chosen file, replacing if necessary.  This ensures
+    //  that the old contents are not deleted until the new contents are
+    //  successfully written.
+    //
+
+    if (Result && !FlushFileBuffers(Saver->TempHandle)) {
+        Result = FALSE;
+    }
+
+    CloseHandle(Saver->TempHandle);
+    Saver->TempHandle = NULL;
+
+    if (!Result) {
+        DeleteFile(Saver->TempFileName.StartOfString);
+        return FALSE;
+    }
+
+    //
+    //  If the file exists and ReplaceFile is present, replace it. Without
+    //  ReplaceFile or if the file doesn't exist, rename the temporary file
+    //  into place.  If ReplaceFile fails for whatever reason, fall back to
+    //  rename, which implicitly prioritizes succeeding the save to preserving
+    //  whatever file metadata ReplaceFile is aiming to retain.
+    //
+
+    ReplaceSucceeded = FALSE;
+    Attributes = GetFileAttributes(Saver->FileName.StartOfString);
+    if (Attributes != (DWORD)-1 &&
+        DllKernel32.pReplaceFileW != NULL) {
+
+        if (DllKernel32.pReplaceFileW(Saver->FileName.StartOfString, Saver->TempFileName.StartOfString, NULL, 0, NULL, NULL)) {
+            ReplaceSucceeded = TRUE;
+        }
+    }
+
+    if (!ReplaceSucceeded) {
+        if (!MoveFileEx(Saver->TempFileName.StartOfString, Saver->FileName.StartOfString, MOVEFILE_REPLACE_EXISTING)) {
+            DeleteFile(Saver->TempFileName.StartOfString);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ A background thread which writes a file being saved.
+
+ @param Context Pointer to the save state.
+
+ @return Thread exit code, which is ignored.
+ */
+DWORD WINAPI
+EditSaverThread(
+    __in LPVOID Context
+    )
+{
+    PEDIT_SAVER Saver;
+
+    Saver = (PEDIT_SAVER)Context;
+    Saver->Result = EditSaverWriteFile(Saver);
+    return 0;
+}
+
+/**
+ Wait for a background save to finish and tear down its state.  This does
+ not report failure to the user.
+
+ @param EditContext Pointer to the edit context.
+
+ @return TRUE to indicate the save succeeded or no save was in progress,
+         FALSE to indicate the save failed.
+ */
+BOOLEAN
+EditSaverComplete(
+    __in PEDIT_CONTEXT EditContext
+    )
+{
+    PEDIT_SAVER Saver;
+    BOOLEAN Result;
+
+    Saver = EditContext->Saver;
+    if (Saver == NULL) {
+        return TRUE;
+    }
+
+    if (Saver->Thread != NULL) {
+        WaitForSingleObject(Saver->Thread, INFINITE);
+        CloseHandle(Saver->Thread);
+        YoriWinSetPeriodicNotifyCallback(YoriWinGetControlParent(EditContext->MultilineEdit), 0, NULL);
+    }
+
+    Result = Saver->Result;
+    EditSaverFree(Saver);
+    EditContext->Saver = NULL;
+
+    //
+    //  The buffer was marked as unmodified when the save started.  If it
+    //  failed, the contents have not been saved.
+    //
+
+    if (!Result) {
+        EditContext->SaveFailed = TRUE;
+        YoriWinMultilineEditSetModifyState(EditContext->MultilineEdit, TRUE);
+    }
+
+    return Result;
+}
+
+/**
+ Wait for any background save to finish.  If it failed, tell the user.
+
+ @param EditContext Pointer to the edit context.
+
+ @return TRUE to indicate the save succeeded or no save was in progress,
+         FALSE to indicate the save failed.
+ */
+BOOLEAN
+EditWaitForSave(
+    __in PEDIT_CONTEXT EditContext
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    YORI_STRING Title;
+    YORI_STRING Text;
+    YORI_STRING ButtonText;
+
+    if (EditContext->Saver == NULL) {
+        return TRUE;
+    }
+
+    if (EditSaverComplete(EditContext)) {
+        EditRefreshStatusBar(EditContext);
+        return TRUE;
+    }
+
+    EditRefreshStatusBar(EditContext);
+
+    Parent = YoriWinGetControlParent(EditContext->MultilineEdit);
+    YoriLibConstantString(&Title, _T("Save"));
+    YoriLibConstantString(&Text, _T("Could not save file"));
+    YoriLibConstantString(&ButtonText, _T("Ok"));
 
-    YoriLibLineReadCloseOrCache(LineContext);
-    YoriLibFreeStringContents(&LineString);
+    YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
+                      &Title,
+                      &Text,
+                      1,
+                      &ButtonText,
+                      0,
+                      0);
 
-    if (Result == FALSE) {
-        while (LinesPopulated > 0) {
-            YoriLibFreeStringContents(&LineArray[LinesPopulated - 1]);
-            LinesPopulated--;
-        }
+    return FALSE;
+}
 
-        if (LineArray != NULL) {
-            YoriLibDereference(LineArray);
-        }
+/**
+ A callback invoked periodically while a background thread is saving a
+ file.
 
-        return FALSE;
-    }
+ @param Ctrl Pointer to the main window.
+ */
+VOID
+EditSaverPeriodicCallback(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PEDIT_CONTEXT EditContext;
 
-    if (LinesPopulated > 0) {
-        YoriWinMultilineEditAppendLinesNoDataCopy(EditContext->MultilineEdit, LineArray, LinesPopulated);
+    EditContext = YoriWinGetControlContext(Ctrl);
+    if (EditContext->Saver != NULL &&
+        WaitForSingleObject(EditContext->Saver->Thread, 0) == WAIT_OBJECT_0) {
 
-        YoriLibConstantString(&EditContext->Newline, _T("\r\n"));
-        if (FirstLineEnding == YoriLibLineEndingLF) {
-            YoriLibConstantString(&EditContext->Newline, _T("\n"));
-        } else if (FirstLineEnding == YoriLibLineEndingCR) {
-            YoriLibConstantString(&EditContext->Newline, _T("\r"));
-        }
-    }
+        //
+        //  A failure is indicated in the status bar rather than with a
+        //  dialog, since this is invoked from a timer.
+        //
 
-    if (LineArray != NULL) {
-        YoriLibDereference(LineArray);
+        EditSaverComplete(EditContext);
     }
 
-    return Result;
+    EditRefreshStatusBar(EditContext);
 }
 
 /**
- Check if a file has the read only bit set.  If it does, we won't be able to
- overwrite it.  Prompt the user to remove the read only bit, and if it can
- be removed successfully, allow the save to continue.
+ Copy the lines in the edit control so they can be saved while the user
+ continues editing.
 
- @param Parent Pointer to the control describing the main window.
+ @param EditContext Pointer to the edit context.
 
- @param FileName The file that may be overwritten.
+ @param Saver Pointer to the save state, which is updated with the copy of
+        the lines.
 
- @return TRUE to indicate that the file is still write protected and cannot
-         be overwritten.  FALSE to indicate that the file doesn't exist or
-         is not write protected, so save can continue.
+ @return TRUE to indicate success, FALSE to indicate failure.
  */
+__success(return)
 BOOLEAN
-EditIsFileWriteProtected(
-    __in PYORI_WIN_CTRL_HANDLE Parent,
-    __in PYORI_STRING FileName
+EditSaverCopyLines(
+    __in PEDIT_CONTEXT EditContext,
+    __inout PEDIT_SAVER Saver
     )
 {
-    DWORD Attributes;
-    DWORD ButtonPressed;
-    YORI_STRING UnescapedPath;
-    YORI_STRING Text;
-    YORI_STRING Title;
-    YORI_STRING ButtonText[2];
-    BOOLEAN WriteProtected;
+    EDIT_LINE_BUFFER LineBuffer;
+    YORI_STRING EmptyLine;
+    PYORI_STRING Line;
+    YORI_ALLOC_SIZE_T LineIndex;
+    YORI_ALLOC_SIZE_T LineCount;
+    YORI_ALLOC_SIZE_T AutoIndentLine;
+    BOOLEAN AutoIndentActive;
+    BOOLEAN Result;
 
-    WriteProtected = FALSE;
-    ASSERT(YoriLibIsStringNullTerminated(FileName));
-    Attributes = GetFileAttributes(FileName->StartOfString);
-    if (Attributes != (DWORD)-1 &&
-        (Attributes & FILE_ATTRIBUTE_READONLY) != 0) {
+    YoriWinMultilineEditGetAutoIndent(EditContext->MultilineEdit, NULL, &AutoIndentActive, &AutoIndentLine, NULL);
 
-        WriteProtected = TRUE;
-        YoriLibConstantString(&Title, _T("Overwrite read only file"));
+    LineCount = YoriWinMultilineEditGetLineCount(EditContext->MultilineEdit);
+    Saver->LineCount = 0;
+    Saver->Lines = NULL;
+    if (LineCount == 0) {
+        return TRUE;
+    }
 
-        YoriLibInitEmptyString(&UnescapedPath);
-        if (!YoriLibUnescapePath(FileName, &UnescapedPath)) {
-            UnescapedPath.StartOfString = FileName->StartOfString;
-            UnescapedPath.LengthInChars = FileName->LengthInChars;
-        }
+    if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)LineCount * sizeof(YORI_STRING))) {
+        return FALSE;
+    }
 
-        YoriLibInitEmptyString(&Text);
-        YoriLibYPrintf(&Text,
-                       _T("%y is read only.  Overwrite?"),
-                       &UnescapedPath);
+    Saver->Lines = YoriLibReferencedMalloc(LineCount * sizeof(YORI_STRING));
+    if (Saver->Lines == NULL) {
+        return FALSE;
+    }
 
-        YoriLibFreeStringContents(&UnescapedPath);
-        YoriLibConstantString(&ButtonText[0], _T("&Overwrite"));
-        YoriLibConstantString(&ButtonText[1], _T("Do&n't save"));
-        ButtonPressed = YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
-                                          &Title,
-                                          &Text,
-                                          2,
-                                          ButtonText,
-                                          0,
-                                          0);
-        YoriLibFreeStringContents(&Text);
+    ZeroMemory(&LineBuffer, sizeof(LineBuffer));
+    YoriLibInitEmptyString(&EmptyLine);
+    Result = TRUE;
 
-        if (ButtonPressed == 1) {
-            Attributes = Attributes & ~(FILE_ATTRIBUTE_READONLY);
-            if (SetFileAttributes(FileName->StartOfString, Attributes)) {
-                WriteProtected = FALSE;
-            } else {
-                YoriLibConstantString(&Text, _T("Could not remove read only attribute."));
-                YoriLibConstantString(&ButtonText[0], _T("&Ok"));
-                YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
-                                  &Title,
-                                  &Text,
-                                  1,
-                                  ButtonText,
-                                  0,
-                                  0);
-            }
+    for (LineIndex = 0; LineIndex < LineCount; LineIndex++) {
+        Line = YoriWinMultilineEditGetLineByIndex(EditContext->MultilineEdit, LineIndex);
+
+        //
+        //  If the line is only auto indent, then pretend it's empty since
+        //  the user hasn't written anything there.
+        //
+
+        if (AutoIndentActive && LineIndex == AutoIndentLine) {
+            Line = &EmptyLine;
+        }
+
+        if (!EditLineBufferCopyLine(&LineBuffer, Line, &Saver->Lines[LineIndex])) {
+            Result = FALSE;
+            break;
         }
+        Saver->LineCount++;
     }
 
-    return WriteProtected;
+    EditLineBufferCleanup(&LineBuffer);
+    return Result;
 }
 
 /**
- Load the contents of the specified file into the edit window.
+ Load the contents of the specified file into the edit window.  The first
+ lines of the file are loaded before this function returns.  If the file is
+ larger than this, the remainder is loaded by a background thread and
+ appended to the edit control periodically.  The edit control is read only
+ until the load completes.
 
  @param EditContext Pointer to the edit context.
 
@@ -639,7 +1788,10 @@ EditLoadFile(
     )
 {
     HANDLE hFile;
-    DWORD SavedEncoding;
+    PEDIT_LOADER Loader;
+    LARGE_INTEGER FileSize;
+    DWORD ThreadId;
+    BOOLEAN Result;
 
     if (FileName->StartOfString == NULL) {
         return FALSE;
@@ -652,6 +1804,11 @@ EditLoadFile(
         return FALSE;
     }
 
+    EditCancelLoad(EditContext);
+    EditWaitForSave(EditContext);
+    EditContext->LoadIncomplete = FALSE;
+    EditContext->SaveFailed = FALSE;
+
     if (EditContext->Encoding == CP_UTF8_OR_16) {
         DWORD NewEncoding;
         DWORD BytesRead;
@@ -682,23 +1839,91 @@ EditLoadFile(
         EditContext->Encoding = NewEncoding;
     }
 
+    Loader = YoriLibMalloc(sizeof(EDIT_LOADER));
+    if (Loader == NULL) {
+        CloseHandle(hFile);
+        return FALSE;
+    }
+
+    ZeroMemory(Loader, sizeof(EDIT_LOADER));
+    Loader->hFile = hFile;
+    Loader->FirstLineEnding = YoriLibLineEndingNone;
+    YoriLibInitEmptyString(&Loader->LineString);
+
+    FileSize.HighPart = 0;
+    FileSize.LowPart = GetFileSize(hFile, (LPDWORD)&FileSize.HighPart);
+    if (FileSize.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+        FileSize.QuadPart = 0;
+    }
+    Loader->FileSize = FileSize.QuadPart;
+
+    EditContext->Loader = Loader;
+
     YoriWinMultilineEditClear(EditContext->MultilineEdit);
-    SavedEncoding = YoriLibGetMultibyteInputEncoding();
+    Loader->SavedEncoding = YoriLibGetMultibyteInputEncoding();
     YoriLibSetMultibyteInputEncoding(EditContext->Encoding);
-    EditPopulateFromStream(EditContext, hFile);
-    YoriLibSetMultibyteInputEncoding(SavedEncoding);
-    CloseHandle(hFile);
+
+    //
+    //  Load enough of the file to display it immediately.
+    //
+
+    Result = EditLoaderLoadLines(EditContext, EDIT_INITIAL_LOAD_LINES);
+
+    if (YoriWinMultilineEditGetLineCount(EditContext->MultilineEdit) > 0) {
+        YoriLibConstantString(&EditContext->Newline, _T("\r\n"));
+        if (Loader->FirstLineEnding == YoriLibLineEndingLF) {
+            YoriLibConstantString(&EditContext->Newline, _T("\n"));
+        } else if (Loader->FirstLineEnding == YoriLibLineEndingCR) {
+            YoriLibConstantString(&EditContext->Newline, _T("\r"));
+        }
+    }
+
+    if (!Result || Loader->EndOfFile) {
+        Loader->Failed = (BOOLEAN)!Result;
+        EditLoaderClose(EditContext);
+        return TRUE;
+    }
+
+    //
+    //  Load the remainder of the file on a background thread.  If that
+    //  cannot be started, load it now.
+    //
+
+    Loader->Mutex = CreateMutex(NULL, FALSE, NULL);
+    Loader->LinesAvailableEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (Loader->Mutex != NULL &&
+        Loader->LinesAvailableEvent != NULL &&
+        YoriWinSetPeriodicNotifyCallback(YoriWinGetControlParent(EditContext->MultilineEdit), EDIT_BACKGROUND_LOAD_INTERVAL, EditLoaderPeriodicCallback)) {
+
+        Loader->Thread = CreateThread(NULL, 0, EditLoaderThread, Loader, 0, &ThreadId);
+        if (Loader->Thread != NULL) {
+            YoriWinMultilineEditSetReadOnly(EditContext->MultilineEdit, TRUE);
+            return TRUE;
+        }
+
+        YoriWinSetPeriodicNotifyCallback(YoriWinGetControlParent(EditContext->MultilineEdit), 0, NULL);
+    }
+
+    Result = EditLoaderLoadLines(EditContext, (YORI_ALLOC_SIZE_T)-1);
+    Loader->Failed = (BOOLEAN)!Result;
+    EditLoaderClose(EditContext);
     return TRUE;
 }
 
 /**
- Save the contents of the opened window into a file.
+ Save the contents of the opened window into a file.  The temporary file is
+ created before this function returns, and the contents of the window are
+ copied, but the file is written by a background thread so the user can
+ continue working.  The buffer should be marked as unmodified when this
+ function succeeds; if the background save later fails, it is marked as
+ modified again.
 
  @param EditContext Pointer to the edit context.
 
  @param FileName Pointer to the name of the file to save.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @return TRUE to indicate the save has started or succeeded, FALSE to
+         indicate failure.
  */
 BOOLEAN
 EditSaveFile(
@@ -706,24 +1931,21 @@ EditSaveFile(
     __in PYORI_STRING FileName
     )
 {
-    BOOLEAN AutoIndentActive;
-    YORI_ALLOC_SIZE_T AutoIndentLine;
-    YORI_ALLOC_SIZE_T LineIndex;
-    YORI_ALLOC_SIZE_T LineCount;
-    DWORD SavedEncoding;
+    PEDIT_SAVER Saver;
     YORI_ALLOC_SIZE_T Index;
-    DWORD Attributes;
-    PYORI_STRING Line;
     YORI_STRING ParentDirectory;
     YORI_STRING Prefix;
-    YORI_STRING TempFileName;
-    HANDLE TempHandle;
-    BOOLEAN ReplaceSucceeded;
+    DWORD ThreadId;
+    BOOLEAN Result;
 
     if (FileName->StartOfString == NULL) {
         return FALSE;
     }
 
+    EditWaitForLoad(EditContext, (YORI_ALLOC_SIZE_T)-1);
+    EditWaitForSave(EditContext);
+    EditContext->SaveFailed = FALSE;
+
     if (EditContext->Newline.StartOfString == NULL) {
         YoriLibConstantString(&EditContext->Newline, _T("\r\n"));
         __analysis_assume(EditContext->Newline.StartOfString != NULL);
@@ -731,6 +1953,23 @@ EditSaveFile(
 
     ASSERT(YoriLibIsStringNullTerminated(FileName));
 
+    Saver = YoriLibMalloc(sizeof(EDIT_SAVER));
+    if (Saver == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(Saver, sizeof(EDIT_SAVER));
+    YoriLibInitEmptyString(&Saver->TempFileName);
+
+    if (!YoriLibAllocateString(&Saver->FileName, FileName->LengthInChars + 1)) {
+        EditSaverFree(Saver);
+        return FALSE;
+    }
+
+    memcpy(Saver->FileName.StartOfString, FileName->StartOfString, FileName->LengthInChars * sizeof(TCHAR));
+    Saver->FileName.StartOfString[FileName->LengthInChars] = '\0';
+    Saver->FileName.LengthInChars = FileName->LengthInChars;
+
     //
     //  Find the parent directory of the user specified file so a temporary
     //  file can be created in the same directory.  This is done to increase
@@ -753,123 +1992,44 @@ EditSaveFile(
 
     YoriLibConstantString(&Prefix, _T("YEDT"));
 
-    if (!YoriLibGetTempFileName(&ParentDirectory, &Prefix, &TempHandle, &TempFileName)) {
+    if (!YoriLibGetTempFileName(&ParentDirectory, &Prefix, &Saver->TempHandle, &Saver->TempFileName)) {
+        Saver->TempHandle = NULL;
+        EditSaverFree(Saver);
         return FALSE;
     }
 
-    YoriWinMultilineEditGetAutoIndent(EditContext->MultilineEdit, NULL, &AutoIndentActive, &AutoIndentLine, NULL);
-
-    //
-    //  Write all of the lines to the temporary file and abort on failure.
-    //
-
-    LineCount = YoriWinMultilineEditGetLineCount(EditContext->MultilineEdit);
+    if (!EditSaverCopyLines(EditContext, Saver)) {
+        CloseHandle(Saver->TempHandle);
+        Saver->TempHandle = NULL;
+        DeleteFile(Saver->TempFileName.StartOfString);
+        EditSaverFree(Saver);
+        return FALSE;
+    }
 
     if (EditContext->Encoding == CP_UTF8_OR_16) {
         EditContext->Encoding = CP_UTF8;
     }
 
-    if (EditContext->WriteBom) {
-        UCHAR BomBuffer[3];
-        DWORD BomLength;
-        DWORD BytesWritten;
-
-        BomLength = 0;
-
-        if (EditContext->Encoding == CP_UTF8) {
-            BomBuffer[0] = 0xEF;
-            BomBuffer[1] = 0xBB;
-            BomBuffer[2] = 0xBF;
-            BomLength = 3;
-        } else if (EditContext->Encoding == CP_UTF16) {
-            BomBuffer[0] = 0xFF;
-            BomBuffer[1] = 0xFE;
-            BomLength = 2;
-        }
-
-        if (BomLength > 0) {
-            if (!WriteFile(TempHandle, BomBuffer, BomLength, &BytesWritten, NULL)) {
-                CloseHandle(TempHandle);
-                DeleteFile(TempFileName.StartOfString);
-                YoriLibFreeStringContents(&TempFileName);
-                return FALSE;
-            }
-        }
-    }
-
-    SavedEncoding = YoriLibGetMultibyteOutputEncoding();
-    YoriLibSetMultibyteOutputEncoding(EditContext->Encoding);
-    for (LineIndex = 0; LineIndex < LineCount; LineIndex++) {
-        Line = YoriWinMultilineEditGetLineByIndex(EditContext->MultilineEdit, LineIndex);
-        //
-        //  We only need to write lines with contents.  If the line is only
-        //  auto indent, then pretend it's empty since the user hasn't
-        //  written anything there.
-        //
-
-        if (Line->LengthInChars > 0 && (!AutoIndentActive || LineIndex != AutoIndentLine)) {
-            if (!YoriLibOutputTextToMbyteDev(TempHandle, Line)) {
-                CloseHandle(TempHandle);
-                DeleteFile(TempFileName.StartOfString);
-                YoriLibFreeStringContents(&TempFileName);
-                YoriLibSetMultibyteOutputEncoding(SavedEncoding);
-                return FALSE;
-            }
-        }
-        if (!YoriLibOutputTextToMbyteDev(TempHandle, &EditContext->Newline)) {
-            CloseHandle(TempHandle);
-            DeleteFile(TempFileName.StartOfString);
-            YoriLibFreeStringContents(&TempFileName);
-            YoriLibSetMultibyteOutputEncoding(SavedEncoding);
-            return FALSE;
-        }
-    }
-    YoriLibSetMultibyteOutputEncoding(SavedEncoding);
-
-    //
-    //  Flush the temporary file to ensure it's durable, and rename it over
-    //  the top of the chosen file, replacing if necessary.  This ensures
-    //  that the old contents are not deleted until the new contents are
-    //  successfully written.
-    //
-
-    if (!FlushFileBuffers(TempHandle)) {
-        CloseHandle(TempHandle);
-        DeleteFile(TempFileName.StartOfString);
-        YoriLibFreeStringContents(&TempFileName);
-        return FALSE;
-    }
-
-    CloseHandle(TempHandle);
+    Saver->Encoding = EditContext->Encoding;
+    Saver->WriteBom = EditContext->WriteBom;
+    YoriLibConstantString(&Saver->Newline, EditContext->Newline.StartOfString);
 
     //
-    //  If the file exists and ReplaceFile is present, replace it. Without
-    //  ReplaceFile or if the file doesn't exist, rename the temporary file
-    //  into place.  If ReplaceFile fails for whatever reason, fall back to
-    //  rename, which implicitly prioritizes succeeding the save to preserving
-    //  whatever file metadata ReplaceFile is aiming to retain.
+    //  Write the file on a background thread.  If that cannot be started,
+    //  write it now.
     //
 
-    ReplaceSucceeded = FALSE;
-    Attributes = GetFileAttributes(FileName->StartOfString);
-    if (Attributes != (DWORD)-1 &&
-        DllKernel32.pReplaceFileW != NULL) {
-
-        if (DllKernel32.pReplaceFileW(FileName->StartOfString, TempFileName.StartOfString, NULL, 0, NULL, NULL)) {
-            ReplaceSucceeded = TRUE;
-        }
-    }
-
-    if (!ReplaceSucceeded) {
-        if (!MoveFileEx(TempFileName.StartOfString, FileName->StartOfString, MOVEFILE_REPLACE_EXISTING)) {
-            DeleteFile(TempFileName.StartOfString);
-            YoriLibFreeStringContents(&TempFileName);
-            return FALSE;
-        }
+    Saver->Thread = CreateThread(NULL, 0, EditSaverThread, Saver, 0, &ThreadId);
+    if (Saver->Thread != NULL) {
+        EditContext->Saver = Saver;
+        YoriWinSetPeriodicNotifyCallback(YoriWinGetControlParent(EditContext->MultilineEdit), EDIT_BACKGROUND_SAVE_INTERVAL, EditSaverPeriodicCallback);
+        EditRefreshStatusBar(EditContext);
+        return TRUE;
     }
 
-    YoriLibFreeStringContents(&TempFileName);
-    return TRUE;
+    Result = EditSaverWriteFile(Saver);
+    EditSaverFree(Saver);
+    return Result;
 }
 
 VOID
@@ -900,6 +2060,13 @@ EditPromptForSaveIfModified(
     __in PEDIT_CONTEXT EditContext
     )
 {
+    //
+    //  If a save is in progress, wait for it, since if it fails the user
+    //  needs to be prompted.
+    //
+
+    EditWaitForSave(EditContext);
+
     if (YoriWinMultilineEditGetModifyState(EditContext->MultilineEdit)) {
         PYORI_WIN_CTRL_HANDLE Parent;
         YORI_STRING Title;
@@ -944,6 +2111,8 @@ EditPromptForSaveIfModified(
                 EditSaveAsButtonClicked(Ctrl);
             }
 
+            EditWaitForSave(EditContext);
+
             //
             //  If the buffer is still modified, that implies the save didn't
             //  happen, so cancel.
@@ -978,6 +2147,9 @@ EditNewButtonClicked(
         return;
     }
 
+    EditCancelLoad(EditContext);
+    EditContext->LoadIncomplete = FALSE;
+    EditContext->SaveFailed = FALSE;
     EditContext->WriteBom = FALSE;
     YoriWinMultilineEditClear(EditContext->MultilineEdit);
     YoriLibFreeStringContents(&EditContext->OpenFileName);
@@ -1285,7 +2457,7 @@ EditOpenButtonClicked(
         EditContext->ReadOnly = FALSE;
     }
 
-    YoriWinMultilineEditSetReadOnly(EditContext->MultilineEdit, EditContext->ReadOnly);
+    YoriWinMultilineEditSetReadOnly(EditContext->MultilineEdit, EditContext->ReadOnly || EditContext->Loader != NULL);
 }
 
 VOID
@@ -1737,21 +2909,32 @@ EditFindNextMatchingString(
     }
 
     //
-    //  Do the rest of the lines the easy way
+    //  Do the rest of the lines the easy way.  If the file is still being
+    //  loaded, wait for more lines and search those too.
     //
 
-    for (LineIndex = StartLine + 1; LineIndex < LineCount; LineIndex++) {
-        Line = YoriWinMultilineEditGetLineByIndex(EditContext->MultilineEdit, LineIndex);
-        if (EditContext->SearchMatchCase) {
-            Match = YoriLibFindFirstMatchSubstr(Line, 1, &EditContext->SearchString, &Offset);
-        } else {
-            Match = YoriLibFindFirstMatchSubstrIns(Line, 1, &EditContext->SearchString, &Offset);
+    LineIndex = StartLine + 1;
+    while (TRUE) {
+        for (; LineIndex < LineCount; LineIndex++) {
+            Line = YoriWinMultilineEditGetLineByIndex(EditContext->MultilineEdit, LineIndex);
+            if (EditContext->SearchMatchCase) {
+                Match = YoriLibFindFirstMatchSubstr(Line, 1, &EditContext->SearchString, &Offset);
+            } else {
+                Match = YoriLibFindFirstMatchSubstrIns(Line, 1, &EditContext->SearchString, &Offset);
+            }
+            if (Match != NULL) {
+                *NextMatchLine = LineIndex;
+                *NextMatchOffset = Offset;
+                return TRUE;
+            }
         }
-        if (Match != NULL) {
-            *NextMatchLine = LineIndex;
-            *NextMatchOffset = Offset;
-            return TRUE;
+
+        if (EditContext->Loader == NULL) {
+            break;
         }
+
+        EditWaitForLoad(EditContext, LineCount + 1);
+        LineCount = YoriWinMultilineEditGetLineCount(EditContext->MultilineEdit);
     }
 
     return FALSE;
@@ -2304,6 +3487,7 @@ EditGoToLineButtonClicked(
             NewLine--;
         }
 
+        EditWaitForLoad(EditContext, NewLine + 1);
         YoriWinMultilineEditSetCursorLocation(EditContext->MultilineEdit, 0, NewLine);
     }
 
@@ -2696,16 +3880,11 @@ EditNotifyCursorMove(
 {
     PYORI_WIN_CTRL_HANDLE Parent;
     PEDIT_CONTEXT EditContext;
-    YORI_STRING NewStatus;
 
     Parent = YoriWinGetControlParent(Ctrl);
     EditContext = YoriWinGetControlContext(Parent);
 
-    YoriLibInitEmptyString(&NewStatus);
-    YoriLibYPrintf(&NewStatus, _T("%06i:%04i "), CursorLine + 1, CursorOffset + 1);
-
-    YoriWinLabelSetCaption(EditContext->StatusBar, &NewStatus);
-    YoriLibFreeStringContents(&NewStatus);
+    EditUpdateStatusBar(EditContext, CursorOffset, CursorLine);
 
     //
     //  In a strange optimization reversal, force a repaint after this update
@@ -3132,7 +4311,7 @@ EditCreateMainWindow(
     if (EditContext->OpenFileName.StartOfString != NULL) {
         EditLoadFile(EditContext, &EditContext->OpenFileName);
         EditUpdateOpenedFileCaption(EditContext);
-        YoriWinMultilineEditSetReadOnly(EditContext->MultilineEdit, EditContext->ReadOnly);
+        YoriWinMultilineEditSetReadOnly(EditContext->MultilineEdit, EditContext->ReadOnly || EditContext->Loader != NULL);
     }
 
     YoriWinSetControlContext(Parent, EditContext);
@@ -3143,6 +4322,8 @@ EditCreateMainWindow(
         Result = FALSE;
     }
 
+    EditCancelLoad(EditContext);
+    EditWaitForSave(EditContext);
     YoriWinDestroyWindow(Parent);
     YoriWinCloseWindowManager(WinMgr);
     return (BOOL)Result;
@@ -3,7 +3,7 @@
  *
  * Yori shell display differences between two environments
  *
- * Copyright (c) 2021 Malcolm J. Smith
+ * Copyright (c) 2021-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -35,9 +35,13 @@ CHAR strEnvDiffHelpText[] =
         "\n"
         "Compares the difference between the current environment and one in a file.\n"
         "\n"
-        "ENVDIFF [-license] [-r] [<file>]\n"
+        "ENVDIFF [-license] [-c] [-r] [<file>]\n"
         "\n"
-        "   -r             Reverse to apply changes to source to current environment\n";
+        "   -c             Report changes, including each component of lists such as PATH\n"
+        "   -r             Reverse to apply changes to source to current environment\n"
+        "\n"
+        "With -c, added variables are shown as +, removed as -, and modified as ~.\n"
+        "Within semicolon delimited lists, each added or removed component is shown.\n";
 
 /**
  Display usage text to the user.
@@ -198,9 +202,165 @@ typedef enum _ENVDIFF_CHANGE_TYPE {
  Specifies the format to output environment changes in.
  */
 typedef enum _ENVDIFF_OUTPUT_FORMAT {
-    EnvDiffOutputCmdBatch = 0
+    EnvDiffOutputCmdBatch = 0,
+    EnvDiffOutputComponents = 1
 } ENVDIFF_OUTPUT_FORMAT;
 
+/**
+ Find the next component within a semicolon delimited list.
+
+ @param Value Pointer to the entire list.
+
+ @param Offset Specifies the offset within the list to search from.  On
+        completion, updated to the offset following the component that was
+        found.
+
+ @param Component On successful completion, updated to point to the
+        component within the list.
+
+ @return TRUE if a component was found, FALSE if the end of the list was
+         reached.
+ */
+__success(return)
+BOOLEAN
+EnvDiffGetNextComponent(
+    __in PYORI_STRING Value,
+    __inout PYORI_ALLOC_SIZE_T Offset,
+    __out PYORI_STRING Component
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    YoriLibInitEmptyString(Component);
+    Index = *Offset;
+
+    //
+    //  Empty components have no effect on a search path, so skip them.
+    //
+
+    while (Index < Value->LengthInChars && Value->StartOfString[Index] == ';') {
+        Index++;
+    }
+
+    if (Index >= Value->LengthInChars) {
+        *Offset = Index;
+        return FALSE;
+    }
+
+    Component->StartOfString = &Value->StartOfString[Index];
+    while (Index < Value->LengthInChars && Value->StartOfString[Index] != ';') {
+        Index++;
+    }
+    Component->LengthInChars = (YORI_ALLOC_SIZE_T)(&Value->StartOfString[Index] - Component->StartOfString);
+    *Offset = Index;
+    return TRUE;
+}
+
+/**
+ Output the components that were added to or removed from a semicolon
+ delimited list.  The components of the original list are placed in a hash
+ table, so that each component of the new list can be found in constant
+ time, which keeps long search paths from requiring a quadratic comparison.
+
+ @param Key The name of the environment variable.
+
+ @param BaseValue The old value of the variable.
+
+ @param NewValue The new value of the variable.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+EnvDiffOutputComponentDifference(
+    __in PYORI_STRING Key,
+    __in PYORI_STRING BaseValue,
+    __in PYORI_STRING NewValue
+    )
+{
+    PYORI_OPEN_HASH_TABLE Components;
+    PYORI_OPEN_HASH_ENTRY Entries;
+    PYORI_OPEN_HASH_ENTRY Entry;
+    YORI_STRING Component;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T EntryCount;
+    YORI_ALLOC_SIZE_T Index;
+    BOOLEAN ChangeFound;
+
+    EntryCount = 0;
+    Offset = 0;
+    while (EnvDiffGetNextComponent(BaseValue, &Offset, &Component)) {
+        EntryCount++;
+    }
+
+    Entries = NULL;
+    if (EntryCount > 0) {
+        Entries = YoriLibMalloc((YORI_ALLOC_SIZE_T)(EntryCount * sizeof(YORI_OPEN_HASH_ENTRY)));
+        if (Entries == NULL) {
+            return FALSE;
+        }
+    }
+
+    Components = YoriLibAllocateOpenHashTable(EntryCount);
+    if (Components == NULL) {
+        if (Entries != NULL) {
+            YoriLibFree(Entries);
+        }
+        return FALSE;
+    }
+
+    //
+    //  Insert each distinct component of the original list.  The context
+    //  of each entry records whether the new list also contains it.
+    //
+
+    EntryCount = 0;
+    Offset = 0;
+    while (EnvDiffGetNextComponent(BaseValue, &Offset, &Component)) {
+        if (YoriLibOpenHashLookupByKey(Components, &Component) == NULL &&
+            YoriLibOpenHashInsertByKey(Components, &Component, NULL, &Entries[EntryCount])) {
+
+            EntryCount++;
+        }
+    }
+
+    ChangeFound = FALSE;
+    Offset = 0;
+    while (EnvDiffGetNextComponent(NewValue, &Offset, &Component)) {
+        Entry = YoriLibOpenHashLookupByKey(Components, &Component);
+        if (Entry == NULL) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("~%y +%y\n"), Key, &Component);
+            ChangeFound = TRUE;
+        } else {
+            Entry->Context = Entry;
+        }
+    }
+
+    for (Index = 0; Index < EntryCount; Index++) {
+        if (Entries[Index].Context == NULL) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("~%y -%y\n"), Key, &Entries[Index].Key);
+            ChangeFound = TRUE;
+        }
+        YoriLibOpenHashRemoveByEntry(&Entries[Index]);
+    }
+
+    //
+    //  If the lists contain the same components but are not identical,
+    //  the components have been reordered or duplicated, so show the new
+    //  value.
+    //
+
+    if (!ChangeFound) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("~%y=%y\n"), Key, NewValue);
+    }
+
+    YoriLibFreeEmptyOpenHashTable(Components);
+    if (Entries != NULL) {
+        YoriLibFree(Entries);
+    }
+
+    return TRUE;
+}
+
 /**
  Output a change to the environment in the specified format.
 
@@ -227,8 +387,25 @@ EnvDiffOutputDifference(
     __in ENVDIFF_CHANGE_TYPE ChangeType
     )
 {
-    UNREFERENCED_PARAMETER(BaseValue);
-    UNREFERENCED_PARAMETER(Format);
+    if (Format == EnvDiffOutputComponents) {
+        if (ChangeType == EnvDiffChangeAdd) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("+%y=%y\n"), Key, NewValue);
+        } else if (ChangeType == EnvDiffChangeRemove) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("-%y=%y\n"), Key, BaseValue);
+        } else if (ChangeType == EnvDiffChangeModify) {
+            __analysis_assume(NewValue != NULL);
+            __analysis_assume(BaseValue != NULL);
+
+            if (YoriLibFindLeftMostCharacter(BaseValue, ';') != NULL ||
+                YoriLibFindLeftMostCharacter(NewValue, ';') != NULL) {
+
+                return EnvDiffOutputComponentDifference(Key, BaseValue, NewValue);
+            }
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("~%y=%y\n"), Key, NewValue);
+        }
+
+        return TRUE;
+    }
 
     if (ChangeType == EnvDiffChangeAdd) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("set %y=%y\n"), Key, NewValue);
@@ -263,6 +440,107 @@ EnvDiffOutputDifference(
     return TRUE;
 }
 
+/**
+ Build a sorted array of the variable names within an environment block.
+ Blocks loaded from a file are not necessarily sorted, and even the process
+ environment orders names differently to a case insensitive comparison when
+ one name is a prefix of another, so sorting the names allows the blocks
+ to be compared in a single pass.  Each name refers to the environment
+ block, and is directly followed by an equals sign and its value.
+
+ @param EnvironmentBlock Pointer to the environment block.
+
+ @param Keys On successful completion, updated to point to an array of
+        names.  The caller should free this with @ref YoriLibFree .
+
+ @param KeyCount On successful completion, updated to contain the number of
+        names in the array.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+EnvDiffBuildSortedKeys(
+    __in PYORI_STRING EnvironmentBlock,
+    __out PYORI_STRING *Keys,
+    __out PYORI_ALLOC_SIZE_T KeyCount
+    )
+{
+    YORI_STRING KeyValue;
+    YORI_STRING Key;
+    PYORI_STRING LocalKeys;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_ALLOC_SIZE_T Offset;
+
+    Count = 0;
+    Offset = 0;
+    while (TRUE) {
+        EnvDiffKeyValueAtOffset(EnvironmentBlock, Offset, &KeyValue);
+        if (KeyValue.LengthInChars == 0) {
+            break;
+        }
+        Count++;
+        Offset = EnvDiffGetNextKeyValueOffset(EnvironmentBlock, &KeyValue, Offset);
+    }
+
+    LocalKeys = YoriLibMalloc((YORI_ALLOC_SIZE_T)((Count + 1) * sizeof(YORI_STRING)));
+    if (LocalKeys == NULL) {
+        return FALSE;
+    }
+
+    Count = 0;
+    Offset = 0;
+    while (TRUE) {
+        EnvDiffKeyValueAtOffset(EnvironmentBlock, Offset, &KeyValue);
+        if (KeyValue.LengthInChars == 0) {
+            break;
+        }
+
+        //
+        //  Skip any variables whose name starts with "=".  These are used for
+        //  per drive current directories and exit code, and are not
+        //  really user state.
+        //
+
+        EnvDiffGetKeyFromKeyValue(&KeyValue, &Key);
+        if (Key.LengthInChars > 0 && Key.StartOfString[0] != '=') {
+            LocalKeys[Count] = Key;
+            Count++;
+        }
+        Offset = EnvDiffGetNextKeyValueOffset(EnvironmentBlock, &KeyValue, Offset);
+    }
+
+    YoriLibSortStringArray(LocalKeys, Count);
+
+    *Keys = LocalKeys;
+    *KeyCount = Count;
+    return TRUE;
+}
+
+/**
+ Find the value of a variable given its name returned from
+ @ref EnvDiffBuildSortedKeys .
+
+ @param EnvironmentBlock Pointer to the environment block.
+
+ @param Key Pointer to the name, which refers to the environment block.
+
+ @param Value On completion, updated to point to the value string within the
+        environment block.
+ */
+VOID
+EnvDiffGetValueFromKey(
+    __in PYORI_STRING EnvironmentBlock,
+    __in PYORI_STRING Key,
+    __out PYORI_STRING Value
+    )
+{
+    YORI_STRING KeyValue;
+
+    EnvDiffKeyValueAtOffset(EnvironmentBlock, (YORI_ALLOC_SIZE_T)(Key->StartOfString - EnvironmentBlock->StartOfString), &KeyValue);
+    EnvDiffGetValueFromKeyValue(&KeyValue, Key, Value);
+}
+
 /**
  Compare two environment blocks, and output the differences in the specified
  format.
@@ -282,103 +560,75 @@ EnvDiffCompareEnvironments(
     __in ENVDIFF_OUTPUT_FORMAT OutputFormat
     )
 {
-    YORI_STRING BaseKeyValue;
-    YORI_STRING NewKeyValue;
-    YORI_STRING BaseKey;
-    YORI_STRING NewKey;
+    PYORI_STRING BaseKeys;
+    PYORI_STRING NewKeys;
+    YORI_ALLOC_SIZE_T BaseCount;
+    YORI_ALLOC_SIZE_T NewCount;
+    YORI_ALLOC_SIZE_T BaseIndex;
+    YORI_ALLOC_SIZE_T NewIndex;
     YORI_STRING BaseValue;
     YORI_STRING NewValue;
-    YORI_ALLOC_SIZE_T BaseStart;
-    YORI_ALLOC_SIZE_T NewStart;
     int Compare;
 
-    YoriLibInitEmptyString(&BaseKeyValue);
-    YoriLibInitEmptyString(&NewKeyValue);
-
-    BaseStart = 0;
-    NewStart = 0;
-
-    while (TRUE) {
-
-        EnvDiffKeyValueAtOffset(BaseEnvironment, BaseStart, &BaseKeyValue);
-        EnvDiffKeyValueAtOffset(NewEnvironment, NewStart, &NewKeyValue);
-
-        if (BaseKeyValue.LengthInChars == 0 &&
-            NewKeyValue.LengthInChars == 0) {
-
-            break;
-        }
-
-        EnvDiffGetKeyFromKeyValue(&BaseKeyValue, &BaseKey);
-        EnvDiffGetKeyFromKeyValue(&NewKeyValue, &NewKey);
-        EnvDiffGetValueFromKeyValue(&BaseKeyValue, &BaseKey, &BaseValue);
-        EnvDiffGetValueFromKeyValue(&NewKeyValue, &NewKey, &NewValue);
-
-        //
-        //  Skip any variables whose name starts with "=".  These are used for
-        //  per drive current directories and exit code, and are not 
-        //  really user state.
-        //
-
-        if (BaseKey.LengthInChars > 0 &&
-            BaseKey.StartOfString[0] == '=') {
+    if (!EnvDiffBuildSortedKeys(BaseEnvironment, &BaseKeys, &BaseCount)) {
+        return FALSE;
+    }
 
-            BaseStart = EnvDiffGetNextKeyValueOffset(BaseEnvironment, &BaseKeyValue, BaseStart);
-            continue;
-        }
+    if (!EnvDiffBuildSortedKeys(NewEnvironment, &NewKeys, &NewCount)) {
+        YoriLibFree(BaseKeys);
+        return FALSE;
+    }
 
-        if (NewKey.LengthInChars > 0 &&
-            NewKey.StartOfString[0] == '=') {
+    BaseIndex = 0;
+    NewIndex = 0;
 
-            NewStart = EnvDiffGetNextKeyValueOffset(NewEnvironment, &NewKeyValue, NewStart);
-            continue;
-        }
+    while (BaseIndex < BaseCount || NewIndex < NewCount) {
 
         //
         //  If there is no base value, there is a new variable added that is
         //  not in base.  If there is no new value, there is a value in base
-        //  that has been removed.
+        //  that has been removed.  If both have variables, because both are
+        //  sorted, if there's a difference we know which one has a variable
+        //  that the other does not by lexicographic order.
         //
 
-        if (BaseKeyValue.LengthInChars == 0) {
-            EnvDiffOutputDifference(&NewKey, NULL, &NewValue, OutputFormat, EnvDiffChangeAdd);
-            NewStart = EnvDiffGetNextKeyValueOffset(NewEnvironment, &NewKeyValue, NewStart);
-        } else if (NewKeyValue.LengthInChars == 0) {
-            EnvDiffOutputDifference(&BaseKey, &BaseValue, NULL, OutputFormat, EnvDiffChangeRemove);
-            BaseStart = EnvDiffGetNextKeyValueOffset(BaseEnvironment, &BaseKeyValue, BaseStart);
+        if (BaseIndex >= BaseCount) {
+            Compare = 1;
+        } else if (NewIndex >= NewCount) {
+            Compare = -1;
+        } else {
+            Compare = YoriLibCompareStringIns(&BaseKeys[BaseIndex], &NewKeys[NewIndex]);
+        }
+
+        if (Compare < 0) {
+            EnvDiffGetValueFromKey(BaseEnvironment, &BaseKeys[BaseIndex], &BaseValue);
+            EnvDiffOutputDifference(&BaseKeys[BaseIndex], &BaseValue, NULL, OutputFormat, EnvDiffChangeRemove);
+            BaseIndex++;
+        } else if (Compare > 0) {
+            EnvDiffGetValueFromKey(NewEnvironment, &NewKeys[NewIndex], &NewValue);
+            EnvDiffOutputDifference(&NewKeys[NewIndex], NULL, &NewValue, OutputFormat, EnvDiffChangeAdd);
+            NewIndex++;
         } else {
 
             //
-            //  If both have variables, check to see if one is ahead of the
-            //  other.  Because environment blocks are sorted, if there's
-            //  a difference we know which one has a variable that the other
-            //  does not by lexicographic order.
+            //  If the value is the same, nothing has happened.
+            //  Otherwise, indicate the modification.
             //
 
-            Compare = YoriLibCompareStringIns(&BaseKey, &NewKey);
-            if (Compare < 0) {
-                EnvDiffOutputDifference(&BaseKey, &BaseValue, NULL, OutputFormat, EnvDiffChangeRemove);
-                BaseStart = EnvDiffGetNextKeyValueOffset(BaseEnvironment, &BaseKeyValue, BaseStart);
-            } else if (Compare > 0) {
-                EnvDiffOutputDifference(&NewKey, NULL, &NewValue, OutputFormat, EnvDiffChangeAdd);
-                NewStart = EnvDiffGetNextKeyValueOffset(NewEnvironment, &NewKeyValue, NewStart);
-            } else {
-
-                //
-                //  If the value is the same, nothing has happened.
-                //  Otherwise, indicate the modification.
-                //
-
-                if (YoriLibCompareString(&BaseValue, &NewValue) != 0) {
-                    EnvDiffOutputDifference(&NewKey, &BaseValue, &NewValue, OutputFormat, EnvDiffChangeModify);
-                }
-                BaseStart = EnvDiffGetNextKeyValueOffset(BaseEnvironment, &BaseKeyValue, BaseStart);
-                NewStart = EnvDiffGetNextKeyValueOffset(NewEnvironment, &NewKeyValue, NewStart);
+            EnvDiffGetValueFromKey(BaseEnvironment, &BaseKeys[BaseIndex], &BaseValue);
+            EnvDiffGetValueFromKey(NewEnvironment, &NewKeys[NewIndex], &NewValue);
+            if (YoriLibCompareString(&BaseValue, &NewValue) != 0) {
+                EnvDiffOutputDifference(&NewKeys[NewIndex], &BaseValue, &NewValue, OutputFormat, EnvDiffChangeModify);
             }
+            BaseIndex++;
+            NewIndex++;
         }
     }
 
-    return FALSE;
+    YoriLibFree(BaseKeys);
+    YoriLibFree(NewKeys);
+
+    return TRUE;
 }
 
 /**
@@ -550,8 +800,10 @@ ENTRYPOINT(
     YORI_STRING CurrentEnvironment;
     YORI_STRING BaseEnvironment;
     BOOLEAN Reverse;
+    ENVDIFF_OUTPUT_FORMAT OutputFormat;
 
     Reverse = FALSE;
+    OutputFormat = EnvDiffOutputCmdBatch;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -564,8 +816,11 @@ ENTRYPOINT(
                 EnvDiffHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2021"));
+                YoriLibDisplayMitLicense(_T("2021-2026"));
                 return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("c")) == 0) {
+                OutputFormat = EnvDiffOutputComponents;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("r")) == 0) {
                 Reverse = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -610,9 +865,9 @@ ENTRYPOINT(
 
     if (Result == EXIT_SUCCESS) {
         if (Reverse) {
-            EnvDiffCompareEnvironments(&CurrentEnvironment, &BaseEnvironment, EnvDiffOutputCmdBatch);
+            EnvDiffCompareEnvironments(&CurrentEnvironment, &BaseEnvironment, OutputFormat);
         } else {
-            EnvDiffCompareEnvironments(&BaseEnvironment, &CurrentEnvironment, EnvDiffOutputCmdBatch);
+            EnvDiffCompareEnvironments(&BaseEnvironment, &CurrentEnvironment, OutputFormat);
         }
     }
 
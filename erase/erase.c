@@ -35,10 +35,11 @@ CHAR strEraseHelpText[] =
         "\n"
         "Delete one or more files.\n"
         "\n"
-        "ERASE [-license] [-b] [-p | -r] [-s] <file> [<file>...]\n"
+        "ERASE [-license] [-b] [-j] [-p | -r] [-s] <file> [<file>...]\n"
         "\n"
         "   --             Treat all further arguments as files to delete\n"
         "   -b             Use basic search criteria for files only\n"
+        "   -j             Delete subdirectories concurrently on multiple threads\n"
         "   -p             Delete files with POSIX semantics\n"
         "   -r             Send files to the recycle bin\n"
         "   -s             Erase all files matching the pattern in all subdirectories\n";
@@ -73,14 +74,22 @@ typedef struct _ERASE_CONTEXT {
     BOOLEAN RecycleBin;
 
     /**
-     The number of files found.
+     The number of files found.  This is updated with interlocked
+     operations since files may be found on multiple threads.
      */
-    DWORDLONG FilesFound;
+    DWORD FilesFound;
 
     /**
-     The number of files successfully marked for delete.
+     The number of files successfully marked for delete.  This is updated
+     with interlocked operations since files may be deleted on multiple
+     threads.
      */
-    DWORDLONG FilesMarkedForDelete;
+    DWORD FilesMarkedForDelete;
+
+    /**
+     Files waiting to be sent to the recycle bin.
+     */
+    YORI_LIB_RECYCLE_BATCH RecycleBatch;
 
 } ERASE_CONTEXT, *PERASE_CONTEXT;
 
@@ -109,6 +118,87 @@ EraseDeleteFile(
     return YoriLibPosixDeleteFile(FileName);
 }
 
+/**
+ Delete a file directly, removing any attributes that prevent deletion if
+ necessary, and display any error encountered.
+
+ @param EraseContext Pointer to the context indicating which delete mode to
+        use.
+
+ @param FilePath Pointer to the file name to delete.
+
+ @return TRUE to indicate the file was marked for delete successfully, or
+         FALSE to indicate failure.
+ */
+BOOL
+EraseDeleteFileWithRetry(
+    __in PERASE_CONTEXT EraseContext,
+    __in PYORI_STRING FilePath
+    )
+{
+    DWORD Err;
+    LPTSTR ErrText;
+
+    if (EraseDeleteFile(EraseContext, FilePath)) {
+        return TRUE;
+    }
+
+    Err = GetLastError();
+    if (Err == ERROR_ACCESS_DENIED) {
+        DWORD OldAttributes = GetFileAttributes(FilePath->StartOfString);
+        DWORD NewAttributes = OldAttributes & ~(FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM);
+
+        if (OldAttributes != NewAttributes) {
+            SetFileAttributes(FilePath->StartOfString, NewAttributes);
+
+            Err = NO_ERROR;
+
+            if (!EraseDeleteFile(EraseContext, FilePath)) {
+                Err = GetLastError();
+            }
+
+            if (Err != NO_ERROR) {
+                SetFileAttributes(FilePath->StartOfString, OldAttributes);
+            }
+        }
+    }
+
+    if (Err != NO_ERROR) {
+        ErrText = YoriLibGetWinErrorText(Err);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("erase: delete of %y failed: %s"), FilePath, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ A callback invoked for a file that was queued to be sent to the recycle
+ bin but could not be.  The file is deleted directly instead.
+
+ @param FilePath Pointer to the file that could not be recycled.
+
+ @param Context Pointer to the erase context.
+ */
+VOID
+EraseRecycleFailedCallback(
+    __in PYORI_STRING FilePath,
+    __in PVOID Context
+    )
+{
+    PERASE_CONTEXT EraseContext = (PERASE_CONTEXT)Context;
+
+    //
+    //  The file was counted as deleted when it was queued, so only update
+    //  the count if it can't be deleted.
+    //
+
+    if (!EraseDeleteFileWithRetry(EraseContext, FilePath)) {
+        InterlockedDecrement((INTERLOCKED_VOLATILE LONG *)&EraseContext->FilesMarkedForDelete);
+    }
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
@@ -132,8 +222,6 @@ EraseFileFoundCallback(
     __in PVOID Context
     )
 {
-    DWORD Err;
-    LPTSTR ErrText;
     BOOLEAN FileDeleted;
     PERASE_CONTEXT EraseContext = (PERASE_CONTEXT)Context;
 
@@ -144,14 +232,16 @@ EraseFileFoundCallback(
     FileDeleted = FALSE;
     if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
 
-        EraseContext->FilesFound++;
+        InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&EraseContext->FilesFound);
 
         //
-        //  If the user wanted it deleted via the recycle bin, try that.
+        //  If the user wanted it deleted via the recycle bin, queue it.
+        //  Files are sent in batches since each shell operation is
+        //  expensive.
         //
 
         if (EraseContext->RecycleBin) {
-            if (YoriLibRecycleBinFile(FilePath)) {
+            if (YoriLibRecycleBinBatchAdd(&EraseContext->RecycleBatch, FilePath)) {
                 FileDeleted = TRUE;
             }
         }
@@ -161,40 +251,12 @@ EraseFileFoundCallback(
         //  directly.
         //
 
-        if (!FileDeleted && !EraseDeleteFile(EraseContext, FilePath)) {
-            Err = GetLastError();
-            if (Err == ERROR_ACCESS_DENIED) {
-                DWORD OldAttributes = GetFileAttributes(FilePath->StartOfString);
-                DWORD NewAttributes = OldAttributes & ~(FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM);
-
-                if (OldAttributes != NewAttributes) {
-                    SetFileAttributes(FilePath->StartOfString, NewAttributes);
-
-                    Err = NO_ERROR;
-
-                    if (!EraseDeleteFile(EraseContext, FilePath)) {
-                        Err = GetLastError();
-                    } else {
-                        FileDeleted = TRUE;
-                    }
-
-                    if (Err != NO_ERROR) {
-                        SetFileAttributes(FilePath->StartOfString, OldAttributes);
-                    }
-                }
-            }
-
-            if (Err != NO_ERROR) {
-                ErrText = YoriLibGetWinErrorText(Err);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("erase: delete of %y failed: %s"), FilePath, ErrText);
-                YoriLibFreeWinErrorText(ErrText);
-            }
-        } else {
+        if (!FileDeleted && EraseDeleteFileWithRetry(EraseContext, FilePath)) {
             FileDeleted = TRUE;
         }
 
         if (FileDeleted) {
-            EraseContext->FilesMarkedForDelete++;
+            InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&EraseContext->FilesMarkedForDelete);
         }
     }
     return TRUE;
@@ -287,6 +349,7 @@ ENTRYPOINT(
     WORD MatchFlags;
     BOOLEAN Recursive;
     BOOLEAN BasicEnumeration;
+    BOOLEAN Parallel;
     YORI_ALLOC_SIZE_T StartArg = 0;
     YORI_ALLOC_SIZE_T i;
     ERASE_CONTEXT Context;
@@ -295,6 +358,7 @@ ENTRYPOINT(
     ZeroMemory(&Context, sizeof(Context));
     Recursive = FALSE;
     BasicEnumeration = FALSE;
+    Parallel = FALSE;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -312,6 +376,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                Parallel = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("p")) == 0) {
                 Context.PosixSemantics = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -343,6 +410,21 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
+    //
+    //  When deleting concurrently, POSIX semantics are used where the OS
+    //  supports them, so each name is gone as soon as it is deleted rather
+    //  than lingering until every handle to it is closed.  Sending files
+    //  to the recycle bin is not done concurrently.
+    //
+
+    if (Parallel) {
+        if (Context.RecycleBin) {
+            Parallel = FALSE;
+        } else if (DllKernel32.pSetFileInformationByHandle != NULL) {
+            Context.PosixSemantics = TRUE;
+        }
+    }
+
     if (Context.PosixSemantics &&
         DllKernel32.pSetFileInformationByHandle == NULL) {
 
@@ -361,13 +443,18 @@ ENTRYPOINT(
 
     YoriLibEnableBackupPrivilege();
 
-    MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
+    MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS | YORILIB_FILEENUM_BASIC_INFO;
     if (Recursive) {
         MatchFlags |= YORILIB_FILEENUM_RECURSE_BEFORE_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
     }
     if (BasicEnumeration) {
         MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
     }
+    if (Parallel) {
+        MatchFlags |= YORILIB_FILEENUM_PARALLEL | YORILIB_FILEENUM_CONCURRENT_CALLBACKS;
+    }
+
+    YoriLibRecycleBinBatchInitialize(&Context.RecycleBatch, EraseRecycleFailedCallback, &Context);
 
     for (i = StartArg; i < ArgC; i++) {
 
@@ -379,6 +466,9 @@ ENTRYPOINT(
                              &Context);
     }
 
+    YoriLibRecycleBinBatchFlush(&Context.RecycleBatch);
+    YoriLibRecycleBinBatchCleanup(&Context.RecycleBatch);
+
     if (Context.FilesFound == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("erase: no matching files found\n"));
         ASSERT(Context.FilesMarkedForDelete == 0);
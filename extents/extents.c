@@ -3,7 +3,7 @@
  *
  * Yori shell display and manipulate file extents
  *
- * Copyright (c) 2018-2025 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -36,6 +36,7 @@ CHAR strExtentsHelpText[] =
         "Output location of files within a volume or disk and relocate files.\n"
         "\n"
         "EXTENTS [-license] [-b] [-d] [-h] [-m vcn lcn cnt] [-s] <file>...\n"
+        "EXTENTS [-license] -v|-vm <path>...\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -d             Return directories rather than directory contents\n"
@@ -44,7 +45,130 @@ CHAR strExtentsHelpText[] =
         "   -dv            Display contents of the file from the volume\n"
         "   -h             Display output in hexadecimal\n"
         "   -m vcn lcn cnt Move a range of a file to a new position\n"
-        "   -s             Process files from all subdirectories\n";
+        "   -s             Process files from all subdirectories\n"
+        "   -v             Report fragmentation of the volume containing each path\n"
+        "   -vm            Report fragmentation and move the most fragmented files\n";
+
+/**
+ The number of most fragmented files to retain when reporting on a volume.
+ */
+#define EXTENTS_REPORT_FILE_COUNT (20)
+
+/**
+ The number of largest free space regions to retain when reporting on a
+ volume.  These are the candidate targets when planning file moves.
+ */
+#define EXTENTS_REPORT_FREE_RUN_COUNT (64)
+
+/**
+ The number of bytes of volume bitmap to request in each call.  Each byte
+ describes eight clusters.
+ */
+#define EXTENTS_BITMAP_BUFFER_SIZE (64 * 1024)
+
+/**
+ Information about a file found when reporting on a volume.
+ */
+typedef struct _EXTENTS_FRAGMENTED_FILE {
+
+    /**
+     The full path to the file.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     The number of discontiguous ranges of clusters used by the file.
+     */
+    DWORDLONG FragmentCount;
+
+    /**
+     The number of clusters allocated to the file.
+     */
+    DWORDLONG ClusterCount;
+
+    /**
+     TRUE if the file contains ranges that are not allocated, such as a
+     sparse or compressed file.  These cannot be moved in a single request.
+     */
+    BOOLEAN HasUnallocatedRanges;
+
+} EXTENTS_FRAGMENTED_FILE, *PEXTENTS_FRAGMENTED_FILE;
+
+/**
+ A range of free clusters found when reporting on a volume.
+ */
+typedef struct _EXTENTS_FREE_RUN {
+
+    /**
+     The first free cluster in the range.
+     */
+    DWORDLONG StartingLcn;
+
+    /**
+     The number of free clusters in the range.
+     */
+    DWORDLONG ClusterCount;
+
+} EXTENTS_FREE_RUN, *PEXTENTS_FREE_RUN;
+
+/**
+ Information collected when reporting on the fragmentation of a volume.
+ */
+typedef struct _EXTENTS_VOLUME_REPORT {
+
+    /**
+     The number of clusters on the volume.
+     */
+    DWORDLONG TotalClusters;
+
+    /**
+     The number of free clusters on the volume.
+     */
+    DWORDLONG FreeClusters;
+
+    /**
+     The number of discontiguous ranges of free clusters on the volume.
+     */
+    DWORDLONG FreeRunCount;
+
+    /**
+     The number of files whose extents were queried.
+     */
+    DWORDLONG FilesScanned;
+
+    /**
+     The number of files with more than one fragment.
+     */
+    DWORDLONG FragmentedFiles;
+
+    /**
+     The total number of fragments across all files whose extents were
+     queried.
+     */
+    DWORDLONG TotalFragments;
+
+    /**
+     The number of entries populated in the FreeRuns array.
+     */
+    DWORD FreeRunsRetained;
+
+    /**
+     The number of entries populated in the Files array.
+     */
+    DWORD FilesRetained;
+
+    /**
+     The largest free ranges on the volume, sorted by descending size.
+     */
+    EXTENTS_FREE_RUN FreeRuns[EXTENTS_REPORT_FREE_RUN_COUNT];
+
+    /**
+     The most fragmented files on the volume, sorted by descending fragment
+     count.
+     */
+    EXTENTS_FRAGMENTED_FILE Files[EXTENTS_REPORT_FILE_COUNT];
+
+} EXTENTS_VOLUME_REPORT, *PEXTENTS_VOLUME_REPORT;
 
 /**
  Context passed to the callback which is invoked for each file found.
@@ -104,6 +228,24 @@ typedef struct _EXTENTS_CONTEXT {
      */
     BOOLEAN DisplayVolumeContents;
 
+    /**
+     If TRUE, report on the fragmentation of the volume containing each
+     argument rather than displaying the extents of each file.
+     */
+    BOOLEAN ReportVolume;
+
+    /**
+     If TRUE, after reporting on the fragmentation of a volume, move the
+     most fragmented files into free space.
+     */
+    BOOLEAN DefragmentVolume;
+
+    /**
+     When reporting on a volume, points to the information collected about
+     the volume.
+     */
+    PEXTENTS_VOLUME_REPORT VolumeReport;
+
 } EXTENTS_CONTEXT, *PEXTENTS_CONTEXT;
 
 /**
@@ -659,6 +801,7 @@ ExtentsMoveFile(
         ErrText = YoriLibGetWinErrorText(Error);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: move extent 0x%llx of %y to 0x%llx failed: %s"), ExtentsContext->StartingVcn, FilePath, ExtentsContext->StartingLcn, ErrText);
         YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
     }
 
     return TRUE;
@@ -906,6 +1049,684 @@ End:
     return TRUE;
 }
 
+/**
+ Record a range of free clusters found on the volume.  The largest ranges
+ are retained as candidate targets for moving files.
+
+ @param Report Pointer to the volume report to update.
+
+ @param StartingLcn The first free cluster in the range.
+
+ @param ClusterCount The number of free clusters in the range.
+ */
+VOID
+ExtentsRecordFreeRun(
+    __inout PEXTENTS_VOLUME_REPORT Report,
+    __in DWORDLONG StartingLcn,
+    __in DWORDLONG ClusterCount
+    )
+{
+    DWORD Index;
+
+    Report->FreeClusters = Report->FreeClusters + ClusterCount;
+    Report->FreeRunCount++;
+
+    if (Report->FreeRunsRetained == EXTENTS_REPORT_FREE_RUN_COUNT) {
+        if (Report->FreeRuns[EXTENTS_REPORT_FREE_RUN_COUNT - 1].ClusterCount >= ClusterCount) {
+            return;
+        }
+        Index = EXTENTS_REPORT_FREE_RUN_COUNT - 1;
+    } else {
+        Index = Report->FreeRunsRetained;
+        Report->FreeRunsRetained++;
+    }
+
+    while (Index > 0 && Report->FreeRuns[Index - 1].ClusterCount < ClusterCount) {
+        Report->FreeRuns[Index] = Report->FreeRuns[Index - 1];
+        Index--;
+    }
+
+    Report->FreeRuns[Index].StartingLcn = StartingLcn;
+    Report->FreeRuns[Index].ClusterCount = ClusterCount;
+}
+
+/**
+ Read the allocation bitmap of a volume and record the free space found.
+
+ @param Report Pointer to the volume report to update.
+
+ @param VolumePath Specifies the path to the volume, used for display.
+
+ @param VolumeHandle Specifies a handle to the volume.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+ExtentsScanVolumeBitmap(
+    __inout PEXTENTS_VOLUME_REPORT Report,
+    __in PYORI_STRING VolumePath,
+    __in HANDLE VolumeHandle
+    )
+{
+    STARTING_LCN_INPUT_BUFFER StartingLcn;
+    PVOLUME_BITMAP_BUFFER Bitmap;
+    DWORD BitmapBufferSize;
+    DWORD BytesReturned;
+    DWORDLONG ClustersInBuffer;
+    DWORDLONG Index;
+    DWORDLONG Lcn;
+    DWORDLONG RunStart;
+    DWORDLONG RunLength;
+    BOOLEAN MoreToGo;
+    UCHAR Byte;
+    SYSERR Error;
+    LPTSTR ErrText;
+
+    BitmapBufferSize = FIELD_OFFSET(VOLUME_BITMAP_BUFFER, Buffer) + EXTENTS_BITMAP_BUFFER_SIZE;
+    Bitmap = YoriLibMalloc(BitmapBufferSize);
+    if (Bitmap == NULL) {
+        return FALSE;
+    }
+
+    StartingLcn.StartingLcn.QuadPart = 0;
+    RunStart = 0;
+    RunLength = 0;
+
+    MoreToGo = TRUE;
+    while (MoreToGo) {
+        MoreToGo = FALSE;
+        if (!DeviceIoControl(VolumeHandle,
+                             FSCTL_GET_VOLUME_BITMAP,
+                             &StartingLcn,
+                             sizeof(StartingLcn),
+                             Bitmap,
+                             BitmapBufferSize,
+                             &BytesReturned,
+                             NULL)) {
+
+            Error = GetLastError();
+            if (Error != ERROR_MORE_DATA) {
+                ErrText = YoriLibGetWinErrorText(Error);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: get volume bitmap of %y failed: %s"), VolumePath, ErrText);
+                YoriLibFreeWinErrorText(ErrText);
+                YoriLibFree(Bitmap);
+                return FALSE;
+            }
+            MoreToGo = TRUE;
+        }
+
+        if (BytesReturned < FIELD_OFFSET(VOLUME_BITMAP_BUFFER, Buffer)) {
+            break;
+        }
+
+        Lcn = Bitmap->StartingLcn.QuadPart;
+        if (Report->TotalClusters == 0) {
+            Report->TotalClusters = Lcn + Bitmap->BitmapSize.QuadPart;
+        }
+
+        ClustersInBuffer = (BytesReturned - FIELD_OFFSET(VOLUME_BITMAP_BUFFER, Buffer)) * 8;
+        if (ClustersInBuffer > (DWORDLONG)Bitmap->BitmapSize.QuadPart) {
+            ClustersInBuffer = Bitmap->BitmapSize.QuadPart;
+        }
+
+        //
+        //  Most bytes describe eight clusters which are all in use or all
+        //  free, so handle those without looking at each bit.
+        //
+
+        Index = 0;
+        while (Index < ClustersInBuffer) {
+            Byte = Bitmap->Buffer[Index / 8];
+            if ((Index % 8) == 0 &&
+                Index + 8 <= ClustersInBuffer &&
+                (Byte == 0 || Byte == 0xFF)) {
+
+                if (Byte == 0) {
+                    if (RunLength == 0) {
+                        RunStart = Lcn + Index;
+                    }
+                    RunLength = RunLength + 8;
+                } else if (RunLength > 0) {
+                    ExtentsRecordFreeRun(Report, RunStart, RunLength);
+                    RunLength = 0;
+                }
+                Index = Index + 8;
+            } else {
+                if (Byte & (1 << (Index % 8))) {
+                    if (RunLength > 0) {
+                        ExtentsRecordFreeRun(Report, RunStart, RunLength);
+                        RunLength = 0;
+                    }
+                } else {
+                    if (RunLength == 0) {
+                        RunStart = Lcn + Index;
+                    }
+                    RunLength++;
+                }
+                Index++;
+            }
+        }
+
+        if (ClustersInBuffer == 0 || YoriLibIsOperationCancelled()) {
+            break;
+        }
+
+        StartingLcn.StartingLcn.QuadPart = Lcn + ClustersInBuffer;
+    }
+
+    if (RunLength > 0) {
+        ExtentsRecordFreeRun(Report, RunStart, RunLength);
+    }
+
+    YoriLibFree(Bitmap);
+    return TRUE;
+}
+
+/**
+ Count the number of discontiguous ranges of clusters used by a file.
+
+ @param FileHandle Specifies a handle to the file.
+
+ @param FragmentFile On successful completion, updated to contain the number
+        of fragments and clusters used by the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+ExtentsCountFragments(
+    __in HANDLE FileHandle,
+    __out PEXTENTS_FRAGMENTED_FILE FragmentFile
+    )
+{
+    STARTING_VCN_INPUT_BUFFER StartingVcn;
+    PRETRIEVAL_POINTERS_BUFFER RetrievalPointers;
+    YORI_ALLOC_SIZE_T RetrievalPointerSize;
+    LONGLONG CurrentVcn;
+    LONGLONG NextVcn;
+    LONGLONG Lcn;
+    LONGLONG NextExpectedLcn;
+    BOOLEAN MoreToGo;
+    DWORD Index;
+    DWORD BytesReturned;
+    SYSERR Error;
+
+    FragmentFile->FragmentCount = 0;
+    FragmentFile->ClusterCount = 0;
+    FragmentFile->HasUnallocatedRanges = FALSE;
+
+    RetrievalPointerSize = 4096;
+    RetrievalPointers = YoriLibMalloc(RetrievalPointerSize);
+    if (RetrievalPointers == NULL) {
+        return FALSE;
+    }
+
+    YoriLibLiAssignUnsigned(&StartingVcn.StartingVcn, 0);
+    NextExpectedLcn = -1;
+
+    MoreToGo = TRUE;
+    while (MoreToGo) {
+        MoreToGo = FALSE;
+        if (!DeviceIoControl(FileHandle,
+                             FSCTL_GET_RETRIEVAL_POINTERS,
+                             &StartingVcn,
+                             sizeof(StartingVcn),
+                             RetrievalPointers,
+                             RetrievalPointerSize,
+                             &BytesReturned,
+                             NULL)) {
+
+            Error = GetLastError();
+            if (Error == ERROR_HANDLE_EOF) {
+                break;
+            } else if (Error != ERROR_MORE_DATA) {
+                YoriLibFree(RetrievalPointers);
+                return FALSE;
+            }
+            MoreToGo = TRUE;
+        }
+
+        CurrentVcn = RetrievalPointers->StartingVcn.QuadPart;
+        for (Index = 0; Index < RetrievalPointers->ExtentCount; Index++) {
+            NextVcn = RetrievalPointers->Extents[Index].NextVcn.QuadPart;
+            Lcn = RetrievalPointers->Extents[Index].Lcn.QuadPart;
+            if (Lcn == INVALID_LCN) {
+                FragmentFile->HasUnallocatedRanges = TRUE;
+            } else {
+                if (Lcn != NextExpectedLcn) {
+                    FragmentFile->FragmentCount++;
+                }
+                FragmentFile->ClusterCount = FragmentFile->ClusterCount + (NextVcn - CurrentVcn);
+                NextExpectedLcn = Lcn + (NextVcn - CurrentVcn);
+            }
+            CurrentVcn = NextVcn;
+        }
+
+        if (MoreToGo) {
+            if (CurrentVcn > StartingVcn.StartingVcn.QuadPart) {
+                StartingVcn.StartingVcn.QuadPart = CurrentVcn;
+            } else {
+                MoreToGo = FALSE;
+            }
+        }
+    }
+
+    YoriLibFree(RetrievalPointers);
+    return TRUE;
+}
+
+/**
+ A callback that is invoked for each file on a volume when reporting on the
+ fragmentation of the volume.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.  Ignored in this function.
+
+ @param Depth Specifies recursion depth.  Ignored in this function.
+
+ @param Context Pointer to the extents context structure containing the
+        volume report to update.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+ExtentsReportFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in_opt PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PEXTENTS_CONTEXT ExtentsContext;
+    PEXTENTS_VOLUME_REPORT Report;
+    EXTENTS_FRAGMENTED_FILE FragmentFile;
+    HANDLE FileHandle;
+    DWORD Index;
+    BOOLEAN Result;
+
+    UNREFERENCED_PARAMETER(FileInfo);
+    UNREFERENCED_PARAMETER(Depth);
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+
+    ExtentsContext = (PEXTENTS_CONTEXT)Context;
+    Report = ExtentsContext->VolumeReport;
+
+    if (YoriLibIsOperationCancelled()) {
+        return FALSE;
+    }
+
+    FileHandle = CreateFile(FilePath->StartOfString,
+                            FILE_READ_ATTRIBUTES,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return TRUE;
+    }
+
+    Result = ExtentsCountFragments(FileHandle, &FragmentFile);
+    CloseHandle(FileHandle);
+    if (!Result) {
+        return TRUE;
+    }
+
+    Report->FilesScanned++;
+    Report->TotalFragments = Report->TotalFragments + FragmentFile.FragmentCount;
+    if (FragmentFile.FragmentCount <= 1) {
+        return TRUE;
+    }
+    Report->FragmentedFiles++;
+
+    //
+    //  Retain the file if it is among the most fragmented found so far.
+    //
+
+    if (Report->FilesRetained == EXTENTS_REPORT_FILE_COUNT) {
+        if (Report->Files[EXTENTS_REPORT_FILE_COUNT - 1].FragmentCount >= FragmentFile.FragmentCount) {
+            return TRUE;
+        }
+        Index = EXTENTS_REPORT_FILE_COUNT - 1;
+        YoriLibFreeStringContents(&Report->Files[Index].FilePath);
+    } else {
+        Index = Report->FilesRetained;
+        Report->FilesRetained++;
+    }
+
+    while (Index > 0 && Report->Files[Index - 1].FragmentCount < FragmentFile.FragmentCount) {
+        Report->Files[Index] = Report->Files[Index - 1];
+        Index--;
+    }
+
+    if (!YoriLibCopyString(&FragmentFile.FilePath, FilePath)) {
+        YoriLibInitEmptyString(&FragmentFile.FilePath);
+    }
+    Report->Files[Index] = FragmentFile;
+
+    return TRUE;
+}
+
+/**
+ A callback that is invoked when a directory cannot be successfully
+ enumerated when reporting on the fragmentation of a volume.
+
+ @param FilePath Pointer to the file path that could not be enumerated.
+
+ @param ErrorCode The Win32 error code describing the failure.
+
+ @param Depth Recursion depth, ignored in this application.
+
+ @param Context Pointer to the extents context structure.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+ExtentsReportErrorCallback(
+    __in PYORI_STRING FilePath,
+    __in DWORD ErrorCode,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    UNREFERENCED_PARAMETER(FilePath);
+    UNREFERENCED_PARAMETER(ErrorCode);
+    UNREFERENCED_PARAMETER(Depth);
+    UNREFERENCED_PARAMETER(Context);
+
+    //
+    //  Directories which the user cannot access are expected when walking
+    //  a whole volume.  Skip them; the report counts the files scanned.
+    //
+
+    return TRUE;
+}
+
+/**
+ Plan where to move each of the most fragmented files on a volume so that
+ each becomes contiguous, and optionally perform the moves.  Each file is
+ placed in the smallest retained free range that can hold it, and that
+ range is then reduced so later files are not planned into the same space.
+
+ @param ExtentsContext Pointer to the application context.
+
+ @param Report Pointer to the volume report describing the files and free
+        space.
+
+ @param VolumeHandle Specifies a handle to the volume.  This must have write
+        access if files are being moved.
+ */
+VOID
+ExtentsPlanDefragment(
+    __in PEXTENTS_CONTEXT ExtentsContext,
+    __inout PEXTENTS_VOLUME_REPORT Report,
+    __in HANDLE VolumeHandle
+    )
+{
+    PEXTENTS_FRAGMENTED_FILE FragmentFile;
+    PEXTENTS_FREE_RUN FreeRun;
+    HANDLE FileHandle;
+    DWORD FileIndex;
+    DWORD RunIndex;
+    DWORD FilesMoved;
+
+    if (Report->FilesRetained == 0) {
+        return;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\nDefragment plan:\n"));
+
+    FilesMoved = 0;
+    for (FileIndex = 0; FileIndex < Report->FilesRetained; FileIndex++) {
+        FragmentFile = &Report->Files[FileIndex];
+        if (FragmentFile->FilePath.StartOfString == NULL) {
+            continue;
+        }
+
+        if (FragmentFile->HasUnallocatedRanges) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  %y: skipped, file has unallocated ranges\n"), &FragmentFile->FilePath);
+            continue;
+        }
+
+        FreeRun = NULL;
+        for (RunIndex = 0; RunIndex < Report->FreeRunsRetained; RunIndex++) {
+            if (Report->FreeRuns[RunIndex].ClusterCount >= FragmentFile->ClusterCount &&
+                (FreeRun == NULL || Report->FreeRuns[RunIndex].ClusterCount < FreeRun->ClusterCount)) {
+
+                FreeRun = &Report->FreeRuns[RunIndex];
+            }
+        }
+
+        if (FreeRun == NULL || FragmentFile->ClusterCount > (DWORD)-1) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  %y: skipped, no free range of %lli clusters\n"), &FragmentFile->FilePath, FragmentFile->ClusterCount);
+            continue;
+        }
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  extents -m 0 %lli %lli %y\n"), FreeRun->StartingLcn, FragmentFile->ClusterCount, &FragmentFile->FilePath);
+
+        if (ExtentsContext->DefragmentVolume) {
+            FileHandle = CreateFile(FragmentFile->FilePath.StartOfString,
+                                    FILE_READ_ATTRIBUTES,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    NULL,
+                                    OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT,
+                                    NULL);
+
+            if (FileHandle != INVALID_HANDLE_VALUE) {
+                ExtentsContext->StartingVcn = 0;
+                ExtentsContext->StartingLcn = FreeRun->StartingLcn;
+                ExtentsContext->ClusterCount = (DWORD)FragmentFile->ClusterCount;
+                if (ExtentsMoveFile(ExtentsContext, &FragmentFile->FilePath, VolumeHandle, FileHandle)) {
+                    FilesMoved++;
+                }
+                CloseHandle(FileHandle);
+            }
+        }
+
+        FreeRun->StartingLcn = FreeRun->StartingLcn + FragmentFile->ClusterCount;
+        FreeRun->ClusterCount = FreeRun->ClusterCount - FragmentFile->ClusterCount;
+
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+    }
+
+    if (ExtentsContext->DefragmentVolume) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n%i of %i files moved\n"), FilesMoved, Report->FilesRetained);
+    }
+}
+
+/**
+ Report on the fragmentation of free space and files on the volume
+ containing a specified path.
+
+ @param ExtentsContext Pointer to the application context.
+
+ @param UserPath Specifies a path on the volume, as entered by the user.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+ExtentsReportVolume(
+    __in PEXTENTS_CONTEXT ExtentsContext,
+    __in PYORI_STRING UserPath
+    )
+{
+    YORI_STRING FullPath;
+    YORI_STRING VolRootName;
+    YORI_STRING FileSpec;
+    PEXTENTS_VOLUME_REPORT Report;
+    PEXTENTS_FRAGMENTED_FILE FragmentFile;
+    HANDLE VolumeHandle;
+    DWORD SectorsPerCluster;
+    DWORD SectorSize;
+    DWORD FreeClusters;
+    DWORD TotalClusters;
+    DWORD DesiredAccess;
+    DWORD Index;
+    DWORDLONG Average;
+    SYSERR Error;
+    LPTSTR ErrText;
+    BOOLEAN Result;
+
+    Result = FALSE;
+    YoriLibInitEmptyString(&FullPath);
+    YoriLibInitEmptyString(&VolRootName);
+    YoriLibInitEmptyString(&FileSpec);
+    VolumeHandle = INVALID_HANDLE_VALUE;
+
+    Report = YoriLibMalloc(sizeof(EXTENTS_VOLUME_REPORT));
+    if (Report == NULL) {
+        return FALSE;
+    }
+    ZeroMemory(Report, sizeof(EXTENTS_VOLUME_REPORT));
+
+    if (!YoriLibUserStringToSingleFilePath(UserPath, TRUE, &FullPath) ||
+        !YoriLibGetVolumePathName(&FullPath, &VolRootName)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: failed to find volume for %y\n"), UserPath);
+        goto Cleanup;
+    }
+
+    //
+    //  GetDiskFreeSpace wants a name with a trailing backslash.  Add one
+    //  if needed.
+    //
+
+    if (VolRootName.LengthInChars > 0 &&
+        VolRootName.LengthInChars + 1 < VolRootName.LengthAllocated &&
+        VolRootName.StartOfString[VolRootName.LengthInChars - 1] != '\\') {
+
+        VolRootName.StartOfString[VolRootName.LengthInChars] = '\\';
+        VolRootName.StartOfString[VolRootName.LengthInChars + 1] = '\0';
+        VolRootName.LengthInChars++;
+    }
+
+    if (!GetDiskFreeSpace(VolRootName.StartOfString,
+                          &SectorsPerCluster,
+                          &SectorSize,
+                          &FreeClusters,
+                          &TotalClusters)) {
+        Error = GetLastError();
+        ErrText = YoriLibGetWinErrorText(Error);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: GetDiskFreeSpace of %y failed: %s\n"), &VolRootName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        goto Cleanup;
+    }
+
+    //
+    //  Enumerate every file below the root of the volume.
+    //
+
+    if (!YoriLibAllocateString(&FileSpec, VolRootName.LengthInChars + 2)) {
+        goto Cleanup;
+    }
+    FileSpec.LengthInChars = YoriLibSPrintf(FileSpec.StartOfString, _T("%y*"), &VolRootName);
+
+    //
+    //  Truncate the trailing backslash so as to open the volume instead of
+    //  root directory
+    //
+
+    VolRootName.LengthInChars--;
+    VolRootName.StartOfString[VolRootName.LengthInChars] = '\0';
+
+    DesiredAccess = FILE_READ_ATTRIBUTES | FILE_TRAVERSE;
+    if (ExtentsContext->DefragmentVolume) {
+        DesiredAccess = FILE_READ_ATTRIBUTES | FILE_READ_DATA | FILE_WRITE_DATA;
+    }
+
+    VolumeHandle = CreateFile(VolRootName.StartOfString,
+                              DesiredAccess,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL,
+                              OPEN_EXISTING,
+                              FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_OPEN_NO_RECALL,
+                              NULL);
+    if (VolumeHandle == INVALID_HANDLE_VALUE) {
+        Error = GetLastError();
+        ErrText = YoriLibGetWinErrorText(Error);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: open of %y failed: %s\n"), &VolRootName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        goto Cleanup;
+    }
+
+    if (!ExtentsScanVolumeBitmap(Report, &VolRootName, VolumeHandle)) {
+        goto Cleanup;
+    }
+
+    ExtentsContext->VolumeReport = Report;
+    YoriLibForEachFile(&FileSpec,
+                       YORILIB_FILEENUM_RETURN_FILES |
+                       YORILIB_FILEENUM_RETURN_DIRECTORIES |
+                       YORILIB_FILEENUM_DIRECTORY_CONTENTS |
+                       YORILIB_FILEENUM_RECURSE_BEFORE_RETURN |
+                       YORILIB_FILEENUM_RECURSE_PRESERVE_WILD |
+                       YORILIB_FILEENUM_NO_LINK_TRAVERSE |
+                       YORILIB_FILEENUM_INCLUDE_DOTFILES |
+                       YORILIB_FILEENUM_BASIC_EXPANSION,
+                       0,
+                       ExtentsReportFileFoundCallback,
+                       ExtentsReportErrorCallback,
+                       ExtentsContext);
+    ExtentsContext->VolumeReport = NULL;
+
+    if (ExtentsContext->FilesFound > 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Volume %y\n"), &VolRootName);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Cluster size:          %i\n"), SectorsPerCluster * SectorSize);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Total clusters:        %lli\n"), Report->TotalClusters);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Free clusters:         %lli"), Report->FreeClusters);
+    if (Report->TotalClusters > 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(" (%lli%%)"), Report->FreeClusters * 100 / Report->TotalClusters);
+    }
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Free space fragments:  %lli\n"), Report->FreeRunCount);
+    if (Report->FreeRunsRetained > 0) {
+        Average = Report->FreeClusters / Report->FreeRunCount;
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Largest free fragment: %lli clusters\n"), Report->FreeRuns[0].ClusterCount);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Average free fragment: %lli clusters\n"), Average);
+    }
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Files scanned:         %lli\n"), Report->FilesScanned);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Fragmented files:      %lli\n"), Report->FragmentedFiles);
+    if (Report->FilesScanned > 0) {
+        Average = Report->TotalFragments * 100 / Report->FilesScanned;
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Fragments per file:    %lli.%02i\n"), Average / 100, (DWORD)(Average % 100));
+    }
+
+    if (Report->FilesRetained > 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\nMost fragmented files:\n"));
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Fragments    |  Clusters     | File\n"));
+        for (Index = 0; Index < Report->FilesRetained; Index++) {
+            FragmentFile = &Report->Files[Index];
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  %-12lli | %-13lli | %y\n"), FragmentFile->FragmentCount, FragmentFile->ClusterCount, &FragmentFile->FilePath);
+        }
+    }
+
+    ExtentsPlanDefragment(ExtentsContext, Report, VolumeHandle);
+
+    ExtentsContext->FilesFound++;
+    Result = TRUE;
+
+Cleanup:
+
+    for (Index = 0; Index < Report->FilesRetained; Index++) {
+        YoriLibFreeStringContents(&Report->Files[Index].FilePath);
+    }
+    if (VolumeHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(VolumeHandle);
+    }
+    YoriLibFreeStringContents(&FileSpec);
+    YoriLibFreeStringContents(&VolRootName);
+    YoriLibFreeStringContents(&FullPath);
+    YoriLibFree(Report);
+    return Result;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the extents builtin command.
@@ -955,7 +1776,7 @@ ENTRYPOINT(
                 ExtentsHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2018-2025"));
+                YoriLibDisplayMitLicense(_T("2018-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
@@ -1012,6 +1833,13 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("v")) == 0) {
+                ExtentsContext.ReportVolume = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("vm")) == 0) {
+                ExtentsContext.ReportVolume = TRUE;
+                ExtentsContext.DefragmentVolume = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 ArgumentUnderstood = TRUE;
                 StartArg = i + 1;
@@ -1040,6 +1868,10 @@ ENTRYPOINT(
     if (StartArg == 0 || StartArg == ArgC) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: missing argument\n"));
         return EXIT_FAILURE;
+    } else if (ExtentsContext.ReportVolume) {
+        for (i = StartArg; i < ArgC; i++) {
+            ExtentsReportVolume(&ExtentsContext, &ArgV[i]);
+        }
     } else {
         MatchFlags = YORILIB_FILEENUM_RETURN_FILES;
 
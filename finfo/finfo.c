@@ -35,13 +35,67 @@ CHAR strFInfoHelpText[] =
         "\n"
         "Output information about file metadata.\n"
         "\n"
-        "FINFO [-license] [-b] [-d] [-f fmt] [-s] <file>...\n"
+        "FINFO [-license] [-b] [-d] [-f fmt] [-j <n>] [-s] <file>...\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -d             Return directories rather than directory contents\n"
         "   -f             Specify a custom format string\n"
+        "   -j <n>         Collect information for up to n files concurrently\n"
         "   -s             Process files from all subdirectories\n";
 
+/**
+ The maximum number of worker threads that can collect information about
+ files concurrently.
+ */
+#define FINFO_MAX_WORKERS (64)
+
+/**
+ The number of files that can be queued for each worker thread.  Files are
+ output in the order they were queued, so this bounds how far ahead of the
+ output the workers can get.
+ */
+#define FINFO_JOBS_PER_WORKER (8)
+
+/**
+ The maximum number of distinct collection functions that a format string
+ can refer to.  This is larger than the number of distinct collection
+ functions used by known variables.
+ */
+#define FINFO_MAX_COLLECT_FNS (48)
+
+/**
+ Specifies a pointer to a function which can collect file information from
+ the disk or file system for some particular piece of data.
+ */
+typedef BOOL (* PFINFO_COLLECT_FN)(PYORI_FILE_INFO, PWIN32_FIND_DATA, PYORI_STRING);
+
+/**
+ A single file whose information is collected by a worker thread.
+ */
+typedef struct _FINFO_JOB {
+
+    /**
+     The full path to the file.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     The directory information for the file.
+     */
+    WIN32_FIND_DATA FileInfo;
+
+    /**
+     Information collected about the file by a worker thread.
+     */
+    YORI_FILE_INFO Entry;
+
+    /**
+     TRUE once a worker thread has collected information about the file.
+     */
+    BOOLEAN Complete;
+
+} FINFO_JOB, *PFINFO_JOB;
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
@@ -68,6 +122,92 @@ typedef struct _FINFO_CONTEXT {
      */
     YORI_FILE_INFO Entry;
 
+    /**
+     TRUE if Entry has already been populated by a worker thread with every
+     collection function in CollectFns, so variables can be output without
+     collecting them again.
+     */
+    BOOLEAN Precollected;
+
+    /**
+     Set to TRUE to indicate that worker threads should exit once no jobs
+     remain.
+     */
+    BOOLEAN Shutdown;
+
+    /**
+     The number of elements in the CollectFns array.
+     */
+    DWORD CollectFnCount;
+
+    /**
+     The distinct collection functions referred to by the format string.
+     Worker threads apply each of these to each file.
+     */
+    PFINFO_COLLECT_FN CollectFns[FINFO_MAX_COLLECT_FNS];
+
+    /**
+     The combined access required to the file by the collection functions in
+     CollectFns, allowing a worker to open each file once.
+     */
+    DWORD DesiredAccess;
+
+    /**
+     The number of worker threads in the Workers array.  If zero, files are
+     processed by the main thread as they are found.
+     */
+    DWORD WorkerCount;
+
+    /**
+     An array of handles to worker threads.
+     */
+    PHANDLE Workers;
+
+    /**
+     A circular array of jobs, in the order that files were found.
+     */
+    PFINFO_JOB Jobs;
+
+    /**
+     The number of elements in the Jobs array.
+     */
+    DWORD JobsAllocated;
+
+    /**
+     The index of the oldest job in the Jobs array, which is the next job to
+     output.
+     */
+    DWORD JobHead;
+
+    /**
+     The number of jobs in the Jobs array, starting from JobHead.
+     */
+    DWORD JobCount;
+
+    /**
+     The number of jobs, starting from JobHead, that have been taken by a
+     worker thread.
+     */
+    DWORD JobsDispatched;
+
+    /**
+     A mutex synchronizing the Jobs array between the main thread and
+     worker threads.
+     */
+    HANDLE Mutex;
+
+    /**
+     A manual reset event which is signalled when jobs are available for
+     worker threads or worker threads should exit.
+     */
+    HANDLE WorkAvailableEvent;
+
+    /**
+     An auto reset event which is signalled when a worker thread completes
+     a job.
+     */
+    HANDLE JobCompleteEvent;
+
     /**
      Records the total number of files processed.
      */
@@ -80,12 +220,6 @@ typedef struct _FINFO_CONTEXT {
 
 } FINFO_CONTEXT, *PFINFO_CONTEXT;
 
-/**
- Specifies a pointer to a function which can collect file information from
- the disk or file system for some particular piece of data.
- */
-typedef BOOL (* PFINFO_COLLECT_FN)(PYORI_FILE_INFO, PWIN32_FIND_DATA, PYORI_STRING);
-
 /**
  Specifies a pointer to a function which can output a particular piece of file
  information.
@@ -1400,7 +1534,9 @@ FInfoExpandVariables(
 
     for (Index = 0; Index < sizeof(FInfoKnownVariables)/sizeof(FInfoKnownVariables[0]); Index++) {
         if (YoriLibCompareStringLit(VariableName, FInfoKnownVariables[Index].VariableName) == 0) {
-            FInfoKnownVariables[Index].CollectFn(&FInfoContext->Entry, FInfoContext->FileInfo, FInfoContext->FilePath);
+            if (!FInfoContext->Precollected) {
+                FInfoKnownVariables[Index].CollectFn(&FInfoContext->Entry, FInfoContext->FileInfo, FInfoContext->FilePath);
+            }
             CharsNeeded = FInfoKnownVariables[Index].OutputFn(FInfoContext, OutputString);
             break;
         }
@@ -1409,6 +1545,292 @@ FInfoExpandVariables(
     return CharsNeeded;
 }
 
+/**
+ Record the collection function needed to expand a variable in the format
+ string, so that worker threads can collect it in advance.
+
+ @param OutputString The buffer to populate with the result of variable
+        expansion.  This is not populated.
+
+ @param VariableName The name of the variable.
+
+ @param Context Pointer to a FINFO_CONTEXT structure to record the collection
+        function in.
+
+ @return The number of characters populated, which is always zero.
+ */
+YORI_ALLOC_SIZE_T
+FInfoRecordCollectFn(
+    __inout PYORI_STRING OutputString,
+    __in PYORI_STRING VariableName,
+    __in PVOID Context
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    DWORD FnIndex;
+    PFINFO_COLLECT_FN CollectFn;
+    PFINFO_CONTEXT FInfoContext = (PFINFO_CONTEXT)Context;
+
+    UNREFERENCED_PARAMETER(OutputString);
+
+    for (Index = 0; Index < sizeof(FInfoKnownVariables)/sizeof(FInfoKnownVariables[0]); Index++) {
+        if (YoriLibCompareStringLit(VariableName, FInfoKnownVariables[Index].VariableName) == 0) {
+            CollectFn = FInfoKnownVariables[Index].CollectFn;
+            for (FnIndex = 0; FnIndex < FInfoContext->CollectFnCount; FnIndex++) {
+                if (FInfoContext->CollectFns[FnIndex] == CollectFn) {
+                    break;
+                }
+            }
+
+            if (FnIndex == FInfoContext->CollectFnCount &&
+                FnIndex < FINFO_MAX_COLLECT_FNS) {
+
+                FInfoContext->CollectFns[FnIndex] = CollectFn;
+                FInfoContext->CollectFnCount++;
+                FInfoContext->DesiredAccess |= YoriLibCollectGetRequiredAccess(CollectFn);
+            }
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ Expand the format string for a file and output the result.
+
+ @param FInfoContext Pointer to the finfo context.  If Precollected is TRUE,
+        Entry already contains the information about the file.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @param FileInfo Pointer to the directory information for the file.
+ */
+VOID
+FInfoOutputFile(
+    __in PFINFO_CONTEXT FInfoContext,
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo
+    )
+{
+    YORI_STRING DisplayString;
+
+    FInfoContext->FilePath = FilePath;
+    FInfoContext->FileInfo = FileInfo;
+    FInfoContext->FilesFound++;
+
+    YoriLibInitEmptyString(&DisplayString);
+    YoriLibExpandCommandVariables(&FInfoContext->FormatString, '$', FInfoExpandVariables, FInfoContext, &DisplayString);
+    if (DisplayString.StartOfString != NULL) {
+        if (FInfoContext->FilesFound > 1) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n%y"), &DisplayString);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+        }
+        YoriLibFreeStringContents(&DisplayString);
+    }
+}
+
+/**
+ Output the results of completed jobs in the order they were queued, until
+ no more than a specified number of jobs remain queued.
+
+ @param FInfoContext Pointer to the finfo context.
+
+ @param MaximumOutstanding The number of jobs that can remain queued when this
+        function returns.  If more than this number of jobs are queued, this
+        function waits for workers to complete them.
+ */
+VOID
+FInfoRetireJobs(
+    __in PFINFO_CONTEXT FInfoContext,
+    __in DWORD MaximumOutstanding
+    )
+{
+    PFINFO_JOB Job;
+    BOOLEAN Done;
+
+    while (TRUE) {
+        WaitForSingleObject(FInfoContext->Mutex, INFINITE);
+        Job = NULL;
+        Done = FALSE;
+        if (FInfoContext->JobCount > 0 && FInfoContext->Jobs[FInfoContext->JobHead].Complete) {
+            Job = &FInfoContext->Jobs[FInfoContext->JobHead];
+        } else if (FInfoContext->JobCount <= MaximumOutstanding) {
+            Done = TRUE;
+        }
+        ReleaseMutex(FInfoContext->Mutex);
+
+        if (Done) {
+            break;
+        }
+
+        if (Job == NULL) {
+            WaitForSingleObject(FInfoContext->JobCompleteEvent, INFINITE);
+            continue;
+        }
+
+        //
+        //  Workers do not touch completed jobs, so the job can be output
+        //  without holding the mutex.  The extension refers to the file
+        //  name within the entry, so it needs to refer to the copy.
+        //
+
+        memcpy(&FInfoContext->Entry, &Job->Entry, sizeof(YORI_FILE_INFO));
+        if (Job->Entry.Extension != NULL) {
+            FInfoContext->Entry.Extension = &FInfoContext->Entry.FileName[Job->Entry.Extension - Job->Entry.FileName];
+        }
+
+        FInfoContext->Precollected = TRUE;
+        FInfoOutputFile(FInfoContext, &Job->FilePath, &Job->FileInfo);
+        FInfoContext->Precollected = FALSE;
+
+        WaitForSingleObject(FInfoContext->Mutex, INFINITE);
+        Job->Complete = FALSE;
+        FInfoContext->JobHead = (FInfoContext->JobHead + 1) % FInfoContext->JobsAllocated;
+        FInfoContext->JobCount--;
+        FInfoContext->JobsDispatched--;
+        ReleaseMutex(FInfoContext->Mutex);
+    }
+}
+
+/**
+ Queue a file to have its information collected by a worker thread.  If the
+ queue is full, this waits for the oldest queued file to be output.
+
+ @param FInfoContext Pointer to the finfo context.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @param FileInfo Pointer to the directory information for the file.
+
+ @return TRUE to indicate the file was queued, FALSE to indicate failure.
+ */
+BOOL
+FInfoQueueFile(
+    __in PFINFO_CONTEXT FInfoContext,
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo
+    )
+{
+    PFINFO_JOB Job;
+    YORI_ALLOC_SIZE_T LengthNeeded;
+
+    FInfoRetireJobs(FInfoContext, FInfoContext->JobsAllocated - 1);
+
+    //
+    //  Only this thread adds jobs, and workers only look at jobs within
+    //  JobCount, so the free slot can be filled without the mutex.
+    //
+
+    Job = &FInfoContext->Jobs[(FInfoContext->JobHead + FInfoContext->JobCount) % FInfoContext->JobsAllocated];
+
+    LengthNeeded = FilePath->LengthInChars + 1;
+    if (Job->FilePath.LengthAllocated < LengthNeeded) {
+        if (LengthNeeded < MAX_PATH) {
+            LengthNeeded = MAX_PATH;
+        }
+        YoriLibFreeStringContents(&Job->FilePath);
+        if (!YoriLibAllocateString(&Job->FilePath, LengthNeeded)) {
+            return FALSE;
+        }
+    }
+
+    memcpy(Job->FilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    Job->FilePath.StartOfString[FilePath->LengthInChars] = '\0';
+    Job->FilePath.LengthInChars = FilePath->LengthInChars;
+    memcpy(&Job->FileInfo, FileInfo, sizeof(WIN32_FIND_DATA));
+
+    WaitForSingleObject(FInfoContext->Mutex, INFINITE);
+    FInfoContext->JobCount++;
+    ReleaseMutex(FInfoContext->Mutex);
+    SetEvent(FInfoContext->WorkAvailableEvent);
+
+    //
+    //  Output any results that are ready so output keeps pace with
+    //  enumeration.
+    //
+
+    FInfoRetireJobs(FInfoContext, FInfoContext->JobsAllocated);
+    return TRUE;
+}
+
+/**
+ Collect all information referred to by the format string for a queued file.
+ The file is opened once with the access needed by all collection functions,
+ so executable headers and version resources are read through one handle.
+
+ @param FInfoContext Pointer to the finfo context.
+
+ @param Job Pointer to the job describing the file.
+ */
+VOID
+FInfoCollectJob(
+    __in PFINFO_CONTEXT FInfoContext,
+    __inout PFINFO_JOB Job
+    )
+{
+    DWORD Index;
+
+    ZeroMemory(&Job->Entry, sizeof(YORI_FILE_INFO));
+    if (FInfoContext->DesiredAccess != 0) {
+        YoriLibCollectOpenSharedHandle(&Job->Entry, &Job->FileInfo, &Job->FilePath, FInfoContext->DesiredAccess);
+    }
+
+    for (Index = 0; Index < FInfoContext->CollectFnCount; Index++) {
+        FInfoContext->CollectFns[Index](&Job->Entry, &Job->FileInfo, &Job->FilePath);
+    }
+
+    YoriLibCollectCloseSharedHandle(&Job->Entry);
+}
+
+/**
+ A worker thread that collects information about queued files until told to
+ exit.
+
+ @param Context Pointer to the finfo context.
+
+ @return Thread exit code, which is always zero.
+ */
+DWORD WINAPI
+FInfoWorkerThread(
+    __in LPVOID Context
+    )
+{
+    PFINFO_CONTEXT FInfoContext;
+    PFINFO_JOB Job;
+
+    FInfoContext = (PFINFO_CONTEXT)Context;
+
+    while (TRUE) {
+        WaitForSingleObject(FInfoContext->Mutex, INFINITE);
+        if (FInfoContext->JobsDispatched < FInfoContext->JobCount) {
+            Job = &FInfoContext->Jobs[(FInfoContext->JobHead + FInfoContext->JobsDispatched) % FInfoContext->JobsAllocated];
+            FInfoContext->JobsDispatched++;
+            ReleaseMutex(FInfoContext->Mutex);
+
+            FInfoCollectJob(FInfoContext, Job);
+
+            WaitForSingleObject(FInfoContext->Mutex, INFINITE);
+            Job->Complete = TRUE;
+            ReleaseMutex(FInfoContext->Mutex);
+            SetEvent(FInfoContext->JobCompleteEvent);
+            continue;
+        }
+
+        if (FInfoContext->Shutdown) {
+            ReleaseMutex(FInfoContext->Mutex);
+            break;
+        }
+
+        ResetEvent(FInfoContext->WorkAvailableEvent);
+        ReleaseMutex(FInfoContext->Mutex);
+        WaitForSingleObject(FInfoContext->WorkAvailableEvent, INFINITE);
+    }
+
+    return 0;
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
@@ -1432,7 +1854,6 @@ FInfoFileFoundCallback(
     __in PVOID Context
     )
 {
-    YORI_STRING DisplayString;
     WIN32_FIND_DATA LocalFileInfo;
     PWIN32_FIND_DATA FileInfoToUse;
     PFINFO_CONTEXT FInfoContext;
@@ -1452,20 +1873,150 @@ FInfoFileFoundCallback(
         FileInfoToUse = &LocalFileInfo;
     }
 
-    FInfoContext->FilePath = FilePath;
-    FInfoContext->FileInfo = FileInfoToUse;
-    FInfoContext->FilesFound++;
     FInfoContext->FilesFoundThisArg++;
 
-    YoriLibInitEmptyString(&DisplayString);
-    YoriLibExpandCommandVariables(&FInfoContext->FormatString, '$', FInfoExpandVariables, FInfoContext, &DisplayString);
-    if (DisplayString.StartOfString != NULL) {
-        if (FInfoContext->FilesFound > 1) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n%y"), &DisplayString);
-        } else {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+    if (FInfoContext->WorkerCount > 0) {
+        return FInfoQueueFile(FInfoContext, FilePath, FileInfoToUse);
+    }
+
+    FInfoOutputFile(FInfoContext, FilePath, FileInfoToUse);
+    return TRUE;
+}
+
+/**
+ Wait for all queued files to be output, stop all worker threads, and free
+ the state used to collect information in parallel.
+
+ @param FInfoContext Pointer to the finfo context.
+ */
+VOID
+FInfoStopWorkers(
+    __in PFINFO_CONTEXT FInfoContext
+    )
+{
+    DWORD Index;
+
+    if (FInfoContext->Jobs != NULL && FInfoContext->WorkerCount > 0) {
+        FInfoRetireJobs(FInfoContext, 0);
+        WaitForSingleObject(FInfoContext->Mutex, INFINITE);
+        FInfoContext->Shutdown = TRUE;
+        ReleaseMutex(FInfoContext->Mutex);
+        SetEvent(FInfoContext->WorkAvailableEvent);
+    }
+
+    if (FInfoContext->Workers != NULL) {
+        for (Index = 0; Index < FInfoContext->WorkerCount; Index++) {
+            WaitForSingleObject(FInfoContext->Workers[Index], INFINITE);
+            CloseHandle(FInfoContext->Workers[Index]);
         }
-        YoriLibFreeStringContents(&DisplayString);
+        YoriLibFree(FInfoContext->Workers);
+        FInfoContext->Workers = NULL;
+    }
+    FInfoContext->WorkerCount = 0;
+
+    if (FInfoContext->Jobs != NULL) {
+        for (Index = 0; Index < FInfoContext->JobsAllocated; Index++) {
+            YoriLibFreeStringContents(&FInfoContext->Jobs[Index].FilePath);
+        }
+        YoriLibFree(FInfoContext->Jobs);
+        FInfoContext->Jobs = NULL;
+    }
+    FInfoContext->JobsAllocated = 0;
+
+    if (FInfoContext->Mutex != NULL) {
+        CloseHandle(FInfoContext->Mutex);
+        FInfoContext->Mutex = NULL;
+    }
+
+    if (FInfoContext->WorkAvailableEvent != NULL) {
+        CloseHandle(FInfoContext->WorkAvailableEvent);
+        FInfoContext->WorkAvailableEvent = NULL;
+    }
+
+    if (FInfoContext->JobCompleteEvent != NULL) {
+        CloseHandle(FInfoContext->JobCompleteEvent);
+        FInfoContext->JobCompleteEvent = NULL;
+    }
+}
+
+/**
+ Start worker threads to collect information about files in parallel.  If
+ this fails, files are processed by the main thread.
+
+ @param FInfoContext Pointer to the finfo context, whose format string has
+        already been specified.
+
+ @param WorkerCount The number of worker threads to start.
+
+ @return TRUE to indicate at least one worker thread was started, FALSE if
+         none were.
+ */
+BOOL
+FInfoStartWorkers(
+    __in PFINFO_CONTEXT FInfoContext,
+    __in DWORD WorkerCount
+    )
+{
+    DWORD Index;
+    DWORD ThreadId;
+    DWORD JobsAllocated;
+    YORI_STRING Unused;
+
+    ASSERT(WorkerCount <= FINFO_MAX_WORKERS);
+
+    //
+    //  Determine which collection functions the format string needs, so
+    //  workers can apply them before the format string is expanded.
+    //
+
+    FInfoContext->CollectFnCount = 0;
+    FInfoContext->DesiredAccess = 0;
+    YoriLibInitEmptyString(&Unused);
+    YoriLibExpandCommandVariables(&FInfoContext->FormatString, '$', FInfoRecordCollectFn, FInfoContext, &Unused);
+    YoriLibFreeStringContents(&Unused);
+
+    FInfoContext->Mutex = CreateMutex(NULL, FALSE, NULL);
+    FInfoContext->WorkAvailableEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    FInfoContext->JobCompleteEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (FInfoContext->Mutex == NULL ||
+        FInfoContext->WorkAvailableEvent == NULL ||
+        FInfoContext->JobCompleteEvent == NULL) {
+
+        FInfoStopWorkers(FInfoContext);
+        return FALSE;
+    }
+
+    JobsAllocated = WorkerCount * FINFO_JOBS_PER_WORKER;
+    FInfoContext->Jobs = YoriLibMalloc(JobsAllocated * sizeof(FINFO_JOB));
+    if (FInfoContext->Jobs == NULL) {
+        FInfoStopWorkers(FInfoContext);
+        return FALSE;
+    }
+    ZeroMemory(FInfoContext->Jobs, JobsAllocated * sizeof(FINFO_JOB));
+    FInfoContext->JobsAllocated = JobsAllocated;
+
+    FInfoContext->Workers = YoriLibMalloc(WorkerCount * sizeof(HANDLE));
+    if (FInfoContext->Workers == NULL) {
+        FInfoStopWorkers(FInfoContext);
+        return FALSE;
+    }
+
+    FInfoContext->JobHead = 0;
+    FInfoContext->JobCount = 0;
+    FInfoContext->JobsDispatched = 0;
+    FInfoContext->Shutdown = FALSE;
+
+    for (Index = 0; Index < WorkerCount; Index++) {
+        FInfoContext->Workers[Index] = CreateThread(NULL, 0, FInfoWorkerThread, FInfoContext, 0, &ThreadId);
+        if (FInfoContext->Workers[Index] == NULL) {
+            break;
+        }
+        FInfoContext->WorkerCount++;
+    }
+
+    if (FInfoContext->WorkerCount == 0) {
+        FInfoStopWorkers(FInfoContext);
+        return FALSE;
     }
 
     return TRUE;
@@ -1534,6 +2085,9 @@ ENTRYPOINT(
     BOOLEAN ReturnDirectories = FALSE;
     FINFO_CONTEXT FInfoContext;
     YORI_STRING Arg;
+    DWORD WorkerCount = 0;
+    YORI_MAX_SIGNED_T llTemp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
 
     ZeroMemory(&FInfoContext, sizeof(FInfoContext));
     YoriLibConstantString(&FInfoContext.FormatString, FInfoDefaultFormatString);
@@ -1562,6 +2116,20 @@ ENTRYPOINT(
                     i++;
                     memcpy(&FInfoContext.FormatString, &ArgV[i], sizeof(YORI_STRING));
                 }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (i + 1 < ArgC) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], FALSE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        llTemp > 0) {
+
+                        WorkerCount = FINFO_MAX_WORKERS;
+                        if (llTemp < FINFO_MAX_WORKERS) {
+                            WorkerCount = (DWORD)llTemp;
+                        }
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -1610,6 +2178,18 @@ ENTRYPOINT(
             MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
         }
 
+        //
+        //  Collecting information about executables reads their headers and
+        //  version resources, which leaves the disk mostly idle when done
+        //  one file at a time.  When requested, queue files to worker
+        //  threads.  Results are still displayed in the order files were
+        //  found.
+        //
+
+        if (WorkerCount > 1) {
+            FInfoStartWorkers(&FInfoContext, WorkerCount);
+        }
+
         for (i = StartArg; i < ArgC; i++) {
 
             FInfoContext.FilesFoundThisArg = 0;
@@ -1623,6 +2203,8 @@ ENTRYPOINT(
                 }
             }
         }
+
+        FInfoStopWorkers(&FInfoContext);
     }
 
     if (FInfoContext.FilesFound == 0) {
@@ -3,7 +3,7 @@
  *
  * Yori shell enumerate and operate on strings or files
  *
- * Copyright (c) 2017-2019 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -38,7 +38,7 @@ const
 CHAR strForHelpText[] =
         "Enumerates through a list of strings or files.\n"
         "\n"
-        "FOR [-license] [-b] [-c] [-d] [-i <criteria>] [-l] [-p n] [-r]\n"
+        "FOR [-license] [-b] [-c] [-d] [-i <criteria>] [-l] [-o|-oi] [-p n] [-r]\n"
         "    <var> in (<list>) do <cmd>\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
@@ -46,6 +46,8 @@ CHAR strForHelpText[] =
         "   -d             Match directories rather than files\n"
         "   -i <criteria>  Only treat match files if they meet criteria, see below\n"
         "   -l             Use (start,step,end) notation for the list\n"
+        "   -o             Display the output of each command when it completes\n"
+        "   -oi            Display the output of each command in the order of the list\n"
         "   -p <n>         Execute with <n> concurrent processes\n"
         "   -r             Look for matches in subdirectories under the current directory\n"
         "\n"
@@ -75,6 +77,191 @@ ForHelp(VOID)
     return TRUE;
 }
 
+/**
+ The number of child processes that a single wait thread can wait for.  One
+ wait object is reserved for the event used to tell the thread that the set
+ of processes to wait for has changed.
+ */
+#define FOR_PROCESSES_PER_WAIT_THREAD (MAXIMUM_WAIT_OBJECTS - 1)
+
+/**
+ Specifies how the output of child processes is displayed.
+ */
+typedef enum _FOR_OUTPUT_MODE {
+    ForOutputDirect = 0,
+    ForOutputCompletionOrder = 1,
+    ForOutputInputOrder = 2
+} FOR_OUTPUT_MODE;
+
+/**
+ The output of a single child process, captured so that it can be displayed
+ in its entirety once the process completes.
+ */
+typedef struct _FOR_CAPTURED_OUTPUT {
+
+    /**
+     The list of captured output waiting for earlier commands to complete
+     before it can be displayed.  This is only used when output is displayed
+     in input order.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The order in which the command was launched.
+     */
+    DWORDLONG Sequence;
+
+    /**
+     The number of bytes allocated in Buffer.
+     */
+    YORI_ALLOC_SIZE_T BytesAllocated;
+
+    /**
+     The number of bytes of output populated in Buffer.
+     */
+    YORI_ALLOC_SIZE_T BytesPopulated;
+
+    /**
+     The output from the child process.
+     */
+    PUCHAR Buffer;
+} FOR_CAPTURED_OUTPUT, *PFOR_CAPTURED_OUTPUT;
+
+/**
+ Information about a single child process which is currently running.
+ */
+typedef struct _FOR_SLOT {
+
+    /**
+     A handle to the child process.
+     */
+    HANDLE ProcessHandle;
+
+    /**
+     Nonzero if a wait thread should wait for ProcessHandle to complete.
+     This is set by the main thread once a process has been launched and
+     cleared by the wait thread when the process completes.
+     */
+    LONG volatile WaitArmed;
+
+    /**
+     If output is being captured, the pipe that the child process writes
+     its output to.
+     */
+    HANDLE PipeFromProcess;
+
+    /**
+     If output is being captured, a thread which reads from PipeFromProcess
+     into Output.
+     */
+    HANDLE PumpThread;
+
+    /**
+     If output is being captured, the output from the child process.
+     */
+    PFOR_CAPTURED_OUTPUT Output;
+} FOR_SLOT, *PFOR_SLOT;
+
+/**
+ Forward declaration of the set of wait threads.
+ */
+typedef struct _FOR_WAIT_POOL *PFOR_WAIT_POOL;
+
+/**
+ A thread which waits for a range of slots to complete.
+ */
+typedef struct _FOR_WAIT_THREAD {
+
+    /**
+     Pointer to the set of wait threads this thread belongs to.
+     */
+    PFOR_WAIT_POOL Pool;
+
+    /**
+     A handle to the thread.
+     */
+    HANDLE Thread;
+
+    /**
+     An auto reset event signalled when a slot owned by this thread has a
+     new process to wait for, or the thread should exit.
+     */
+    HANDLE WakeEvent;
+
+    /**
+     The first slot owned by this thread.
+     */
+    DWORD FirstSlot;
+
+    /**
+     The number of slots owned by this thread.
+     */
+    DWORD SlotCount;
+} FOR_WAIT_THREAD, *PFOR_WAIT_THREAD;
+
+/**
+ A set of threads which wait for child processes and report their
+ completion to the main thread.  Each thread waits for up to
+ FOR_PROCESSES_PER_WAIT_THREAD processes, so the number of concurrent
+ child processes is not limited by WaitForMultipleObjects, and the main
+ thread finds each completed slot in constant time.
+ */
+typedef struct _FOR_WAIT_POOL {
+
+    /**
+     The array of slots being waited for.
+     */
+    PFOR_SLOT Slots;
+
+    /**
+     The number of elements in Slots.
+     */
+    DWORD SlotCount;
+
+    /**
+     The number of wait threads.
+     */
+    DWORD ThreadCount;
+
+    /**
+     An array of wait threads.
+     */
+    PFOR_WAIT_THREAD Threads;
+
+    /**
+     A mutex protecting the queue of completed slots.
+     */
+    HANDLE Mutex;
+
+    /**
+     A semaphore whose count is the number of completed slots in the
+     queue.
+     */
+    HANDLE CompletionSemaphore;
+
+    /**
+     A circular queue of slots which have completed and have not yet been
+     processed by the main thread.  Each slot can only be in the queue once,
+     so this has SlotCount elements.
+     */
+    PDWORD CompletedSlots;
+
+    /**
+     The index within CompletedSlots of the oldest completed slot.
+     */
+    DWORD CompletedHead;
+
+    /**
+     The number of slots in CompletedSlots.
+     */
+    DWORD CompletedCount;
+
+    /**
+     Set to TRUE to indicate that wait threads should exit.
+     */
+    BOOLEAN volatile Shutdown;
+} FOR_WAIT_POOL;
+
 /**
  State about the currently running processes as well as information required
  to launch any new processes from this program.
@@ -86,6 +273,12 @@ typedef struct _FOR_EXEC_CONTEXT {
      */
     BOOLEAN InvokeCmd;
 
+    /**
+     Specifies whether the output of child processes is captured, and if so,
+     the order in which it is displayed.
+     */
+    FOR_OUTPUT_MODE OutputMode;
+
     /**
      The string that might be found in ArgV which should be changed to contain
      the value of any match.
@@ -116,10 +309,45 @@ typedef struct _FOR_EXEC_CONTEXT {
     YORI_ALLOC_SIZE_T CurrentConcurrentCount;
 
     /**
-     An array of handles with CurrentConcurrentCount number of valid
-     elements.  These correspond to processes that are currently running.
+     An array of TargetConcurrentCount slots, CurrentConcurrentCount of which
+     correspond to processes that are currently running.
      */
-    PHANDLE HandleArray;
+    PFOR_SLOT Slots;
+
+    /**
+     A stack of indexes into Slots which are not currently running a
+     process.
+     */
+    PDWORD FreeSlots;
+
+    /**
+     The number of elements in FreeSlots.
+     */
+    DWORD FreeSlotCount;
+
+    /**
+     The set of threads waiting for processes in Slots to complete.
+     */
+    FOR_WAIT_POOL WaitPool;
+
+    /**
+     The sequence number to assign to the next command whose output is
+     captured.
+     */
+    DWORDLONG NextSequence;
+
+    /**
+     When displaying output in input order, the sequence number of the next
+     command whose output should be displayed.
+     */
+    DWORDLONG NextSequenceToDisplay;
+
+    /**
+     When displaying output in input order, a list of captured output
+     sorted by sequence number, which is waiting for output from earlier
+     commands.
+     */
+    YORI_LIST_ENTRY PendingOutput;
 
     /**
      A list of criteria to filter matches against.
@@ -128,6 +356,566 @@ typedef struct _FOR_EXEC_CONTEXT {
 
 } FOR_EXEC_CONTEXT, *PFOR_EXEC_CONTEXT;
 
+/**
+ Add a slot to the queue of completed slots and wake the main thread.
+
+ @param Pool Pointer to the set of wait threads.
+
+ @param Slot The index of the slot that has completed.
+ */
+VOID
+ForWaitPoolComplete(
+    __in PFOR_WAIT_POOL Pool,
+    __in DWORD Slot
+    )
+{
+    WaitForSingleObject(Pool->Mutex, INFINITE);
+    ASSERT(Pool->CompletedCount < Pool->SlotCount);
+    Pool->CompletedSlots[(Pool->CompletedHead + Pool->CompletedCount) % Pool->SlotCount] = Slot;
+    Pool->CompletedCount++;
+    ReleaseMutex(Pool->Mutex);
+    ReleaseSemaphore(Pool->CompletionSemaphore, 1, NULL);
+}
+
+/**
+ A thread which waits for child processes within a range of slots to
+ complete, and reports each completion to the main thread.
+
+ @param Context Pointer to the wait thread structure.
+
+ @return Thread exit code, which is always zero.
+ */
+DWORD WINAPI
+ForWaitThread(
+    __in LPVOID Context
+    )
+{
+    PFOR_WAIT_THREAD WaitThread;
+    PFOR_WAIT_POOL Pool;
+    HANDLE Handles[MAXIMUM_WAIT_OBJECTS];
+    DWORD Slots[MAXIMUM_WAIT_OBJECTS];
+    DWORD Count;
+    DWORD Slot;
+    DWORD Index;
+
+    WaitThread = (PFOR_WAIT_THREAD)Context;
+    Pool = WaitThread->Pool;
+
+    while (!Pool->Shutdown) {
+
+        //
+        //  Rebuild the set of processes to wait for each time, since the
+        //  main thread arms slots as it launches processes.
+        //
+
+        Handles[0] = WaitThread->WakeEvent;
+        Count = 1;
+        for (Slot = WaitThread->FirstSlot; Slot < WaitThread->FirstSlot + WaitThread->SlotCount; Slot++) {
+            if (InterlockedCompareExchange(&Pool->Slots[Slot].WaitArmed, TRUE, TRUE)) {
+                Handles[Count] = Pool->Slots[Slot].ProcessHandle;
+                Slots[Count] = Slot;
+                Count++;
+            }
+        }
+
+        Index = WaitForMultipleObjectsEx(Count, Handles, FALSE, INFINITE, FALSE);
+        if (Index == WAIT_FAILED) {
+
+            //
+            //  Rather than leave the main thread waiting forever, report
+            //  every process as complete.
+            //
+
+            for (Index = 1; Index < Count; Index++) {
+                InterlockedExchange(&Pool->Slots[Slots[Index]].WaitArmed, FALSE);
+                ForWaitPoolComplete(Pool, Slots[Index]);
+            }
+            WaitForSingleObject(WaitThread->WakeEvent, INFINITE);
+            continue;
+        }
+
+        Index = Index - WAIT_OBJECT_0;
+        if (Index > 0 && Index < Count) {
+            InterlockedExchange(&Pool->Slots[Slots[Index]].WaitArmed, FALSE);
+            ForWaitPoolComplete(Pool, Slots[Index]);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ Stop all wait threads and free the set of wait threads.  No slots should
+ be armed when this is called.
+
+ @param Pool Pointer to the set of wait threads.
+ */
+VOID
+ForWaitPoolCleanup(
+    __in PFOR_WAIT_POOL Pool
+    )
+{
+    DWORD Index;
+
+    Pool->Shutdown = TRUE;
+    if (Pool->Threads != NULL) {
+        for (Index = 0; Index < Pool->ThreadCount; Index++) {
+            if (Pool->Threads[Index].Thread != NULL) {
+                SetEvent(Pool->Threads[Index].WakeEvent);
+                WaitForSingleObject(Pool->Threads[Index].Thread, INFINITE);
+                CloseHandle(Pool->Threads[Index].Thread);
+            }
+            if (Pool->Threads[Index].WakeEvent != NULL) {
+                CloseHandle(Pool->Threads[Index].WakeEvent);
+            }
+        }
+        YoriLibFree(Pool->Threads);
+        Pool->Threads = NULL;
+    }
+
+    if (Pool->CompletedSlots != NULL) {
+        YoriLibFree(Pool->CompletedSlots);
+        Pool->CompletedSlots = NULL;
+    }
+
+    if (Pool->Mutex != NULL) {
+        CloseHandle(Pool->Mutex);
+        Pool->Mutex = NULL;
+    }
+
+    if (Pool->CompletionSemaphore != NULL) {
+        CloseHandle(Pool->CompletionSemaphore);
+        Pool->CompletionSemaphore = NULL;
+    }
+}
+
+/**
+ Start the threads which wait for child processes to complete.
+
+ @param Pool Pointer to the set of wait threads to initialize.
+
+ @param Slots Pointer to the array of slots to wait for.
+
+ @param SlotCount The number of elements in Slots.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+ForWaitPoolInitialize(
+    __out PFOR_WAIT_POOL Pool,
+    __in PFOR_SLOT Slots,
+    __in DWORD SlotCount
+    )
+{
+    DWORD Index;
+    DWORD ThreadId;
+    PFOR_WAIT_THREAD WaitThread;
+
+    ZeroMemory(Pool, sizeof(FOR_WAIT_POOL));
+    Pool->Slots = Slots;
+    Pool->SlotCount = SlotCount;
+    Pool->ThreadCount = (SlotCount + FOR_PROCESSES_PER_WAIT_THREAD - 1) / FOR_PROCESSES_PER_WAIT_THREAD;
+
+    Pool->Mutex = CreateMutex(NULL, FALSE, NULL);
+    Pool->CompletionSemaphore = CreateSemaphore(NULL, 0, SlotCount, NULL);
+    Pool->CompletedSlots = YoriLibMalloc(SlotCount * sizeof(DWORD));
+    Pool->Threads = YoriLibMalloc(Pool->ThreadCount * sizeof(FOR_WAIT_THREAD));
+    if (Pool->Mutex == NULL ||
+        Pool->CompletionSemaphore == NULL ||
+        Pool->CompletedSlots == NULL ||
+        Pool->Threads == NULL) {
+
+        ForWaitPoolCleanup(Pool);
+        return FALSE;
+    }
+
+    ZeroMemory(Pool->Threads, Pool->ThreadCount * sizeof(FOR_WAIT_THREAD));
+    for (Index = 0; Index < Pool->ThreadCount; Index++) {
+        WaitThread = &Pool->Threads[Index];
+        WaitThread->Pool = Pool;
+        WaitThread->FirstSlot = Index * FOR_PROCESSES_PER_WAIT_THREAD;
+        WaitThread->SlotCount = FOR_PROCESSES_PER_WAIT_THREAD;
+        if (WaitThread->FirstSlot + WaitThread->SlotCount > SlotCount) {
+            WaitThread->SlotCount = SlotCount - WaitThread->FirstSlot;
+        }
+
+        WaitThread->WakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (WaitThread->WakeEvent == NULL) {
+            ForWaitPoolCleanup(Pool);
+            return FALSE;
+        }
+
+        WaitThread->Thread = CreateThread(NULL, 0, ForWaitThread, WaitThread, 0, &ThreadId);
+        if (WaitThread->Thread == NULL) {
+            ForWaitPoolCleanup(Pool);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Indicate that a slot has launched a process which should be waited for.
+
+ @param Pool Pointer to the set of wait threads.
+
+ @param Slot The index of the slot.
+ */
+VOID
+ForWaitPoolArm(
+    __in PFOR_WAIT_POOL Pool,
+    __in DWORD Slot
+    )
+{
+    InterlockedExchange(&Pool->Slots[Slot].WaitArmed, TRUE);
+    SetEvent(Pool->Threads[Slot / FOR_PROCESSES_PER_WAIT_THREAD].WakeEvent);
+}
+
+/**
+ Wait for any armed slot to complete.
+
+ @param Pool Pointer to the set of wait threads.
+
+ @return The index of the slot that completed.
+ */
+DWORD
+ForWaitPoolWait(
+    __in PFOR_WAIT_POOL Pool
+    )
+{
+    DWORD Slot;
+
+    WaitForSingleObject(Pool->CompletionSemaphore, INFINITE);
+    WaitForSingleObject(Pool->Mutex, INFINITE);
+    ASSERT(Pool->CompletedCount > 0);
+    Slot = Pool->CompletedSlots[Pool->CompletedHead];
+    Pool->CompletedHead = (Pool->CompletedHead + 1) % Pool->SlotCount;
+    Pool->CompletedCount--;
+    ReleaseMutex(Pool->Mutex);
+
+    return Slot;
+}
+
+/**
+ Write captured output to standard output.
+
+ @param Output Pointer to the captured output.
+ */
+VOID
+ForDisplayCapturedOutput(
+    __in PFOR_CAPTURED_OUTPUT Output
+    )
+{
+    HANDLE hOut;
+    DWORD BytesWritten;
+    YORI_ALLOC_SIZE_T BytesRemaining;
+    PUCHAR WritePoint;
+
+    hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    WritePoint = Output->Buffer;
+    BytesRemaining = Output->BytesPopulated;
+    while (BytesRemaining > 0) {
+        if (!WriteFile(hOut, WritePoint, BytesRemaining, &BytesWritten, NULL) ||
+            BytesWritten == 0) {
+
+            break;
+        }
+        WritePoint = WritePoint + BytesWritten;
+        BytesRemaining = BytesRemaining - (YORI_ALLOC_SIZE_T)BytesWritten;
+    }
+}
+
+/**
+ Free captured output.
+
+ @param Output Pointer to the captured output.
+ */
+VOID
+ForFreeCapturedOutput(
+    __in PFOR_CAPTURED_OUTPUT Output
+    )
+{
+    if (Output->Buffer != NULL) {
+        YoriLibFree(Output->Buffer);
+    }
+    YoriLibFree(Output);
+}
+
+/**
+ A thread which reads the output of a child process into a buffer until
+ the child closes its end of the pipe.
+
+ @param Context Pointer to the slot whose output should be captured.
+
+ @return Thread exit code, which is always zero.
+ */
+DWORD WINAPI
+ForOutputPumpThread(
+    __in LPVOID Context
+    )
+{
+    PFOR_SLOT Slot;
+    PFOR_CAPTURED_OUTPUT Output;
+    YORI_ALLOC_SIZE_T NewBytesAllocated;
+    PUCHAR NewBuffer;
+    DWORD BytesRead;
+
+    Slot = (PFOR_SLOT)Context;
+    Output = Slot->Output;
+
+    while (TRUE) {
+
+        //
+        //  If the buffer is full, grow it.  If that is not possible, write
+        //  the output now rather than lose it.
+        //
+
+        if (Output->BytesPopulated == Output->BytesAllocated) {
+            NewBuffer = NULL;
+            if (Output->BytesAllocated <= YORI_MAX_ALLOC_SIZE / 4) {
+                NewBytesAllocated = Output->BytesAllocated * 4;
+                NewBuffer = YoriLibMalloc(NewBytesAllocated);
+            }
+
+            if (NewBuffer == NULL) {
+                ForDisplayCapturedOutput(Output);
+                Output->BytesPopulated = 0;
+            } else {
+                memcpy(NewBuffer, Output->Buffer, Output->BytesPopulated);
+                YoriLibFree(Output->Buffer);
+                Output->Buffer = NewBuffer;
+                Output->BytesAllocated = NewBytesAllocated;
+            }
+        }
+
+        if (!ReadFile(Slot->PipeFromProcess,
+                      Output->Buffer + Output->BytesPopulated,
+                      Output->BytesAllocated - Output->BytesPopulated,
+                      &BytesRead,
+                      NULL) ||
+            BytesRead == 0) {
+
+            break;
+        }
+
+        Output->BytesPopulated = Output->BytesPopulated + (YORI_ALLOC_SIZE_T)BytesRead;
+    }
+
+    return 0;
+}
+
+/**
+ Prepare a slot to capture the output of a child process.  This creates a
+ pipe and a thread to read from it.
+
+ @param Slot Pointer to the slot which will launch the child process.
+
+ @param WritePipe On successful completion, populated with an inheritable
+        handle which the child process should use as its standard output.
+        The caller should close this once the child process has been
+        launched.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+ForPrepareCapturedOutput(
+    __in PFOR_SLOT Slot,
+    __out PHANDLE WritePipe
+    )
+{
+    PFOR_CAPTURED_OUTPUT Output;
+    HANDLE ReadHandle;
+    HANDLE WriteHandle;
+    HANDLE InheritableHandle;
+    DWORD ThreadId;
+
+    Output = YoriLibMalloc(sizeof(FOR_CAPTURED_OUTPUT));
+    if (Output == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(Output, sizeof(FOR_CAPTURED_OUTPUT));
+    Output->BytesAllocated = 1024;
+    Output->Buffer = YoriLibMalloc(Output->BytesAllocated);
+    if (Output->Buffer == NULL) {
+        ForFreeCapturedOutput(Output);
+        return FALSE;
+    }
+
+    if (!CreatePipe(&ReadHandle, &WriteHandle, NULL, 0)) {
+        ForFreeCapturedOutput(Output);
+        return FALSE;
+    }
+
+    if (!YoriLibMakeInheritableHandle(WriteHandle, &InheritableHandle)) {
+        CloseHandle(ReadHandle);
+        CloseHandle(WriteHandle);
+        ForFreeCapturedOutput(Output);
+        return FALSE;
+    }
+
+    Slot->Output = Output;
+    Slot->PipeFromProcess = ReadHandle;
+    Slot->PumpThread = CreateThread(NULL, 0, ForOutputPumpThread, Slot, 0, &ThreadId);
+    if (Slot->PumpThread == NULL) {
+        CloseHandle(ReadHandle);
+        CloseHandle(InheritableHandle);
+        ForFreeCapturedOutput(Output);
+        Slot->Output = NULL;
+        Slot->PipeFromProcess = NULL;
+        return FALSE;
+    }
+
+    *WritePipe = InheritableHandle;
+    return TRUE;
+}
+
+/**
+ Wait for a slot to finish capturing output and close the pipe it was
+ reading from.  The pump thread finishes once every process with a handle
+ to the pipe has closed it, which is normally when the child process exits.
+ The captured output remains attached to the slot.
+
+ @param Slot Pointer to the slot.
+ */
+VOID
+ForFinishCapturedOutput(
+    __in PFOR_SLOT Slot
+    )
+{
+    if (Slot->PumpThread != NULL) {
+        WaitForSingleObject(Slot->PumpThread, INFINITE);
+        CloseHandle(Slot->PumpThread);
+        Slot->PumpThread = NULL;
+    }
+
+    if (Slot->PipeFromProcess != NULL) {
+        CloseHandle(Slot->PipeFromProcess);
+        Slot->PipeFromProcess = NULL;
+    }
+}
+
+/**
+ Display the captured output from a command which has completed.  If output
+ is displayed in input order, this may be deferred until earlier commands
+ have completed, and may display output from later commands which were
+ waiting for this one.
+
+ @param ExecContext Pointer to the for exec context.
+
+ @param Output Pointer to the captured output.  This is freed or queued by
+        this routine.
+ */
+VOID
+ForCompleteCapturedOutput(
+    __in PFOR_EXEC_CONTEXT ExecContext,
+    __in PFOR_CAPTURED_OUTPUT Output
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PFOR_CAPTURED_OUTPUT Pending;
+
+    if (ExecContext->OutputMode != ForOutputInputOrder) {
+        ForDisplayCapturedOutput(Output);
+        ForFreeCapturedOutput(Output);
+        return;
+    }
+
+    //
+    //  Insert into the pending list in sequence order.  Commands tend to
+    //  complete in roughly the order they were launched, so search from
+    //  the end.
+    //
+
+    ListEntry = YoriLibGetPreviousListEntry(&ExecContext->PendingOutput, NULL);
+    while (ListEntry != NULL) {
+        Pending = CONTAINING_RECORD(ListEntry, FOR_CAPTURED_OUTPUT, ListEntry);
+        if (Pending->Sequence < Output->Sequence) {
+            break;
+        }
+        ListEntry = YoriLibGetPreviousListEntry(&ExecContext->PendingOutput, ListEntry);
+    }
+
+    if (ListEntry == NULL) {
+        YoriLibInsertList(&ExecContext->PendingOutput, &Output->ListEntry);
+    } else {
+        YoriLibInsertList(ListEntry, &Output->ListEntry);
+    }
+
+    //
+    //  Display everything which is no longer waiting for an earlier
+    //  command.
+    //
+
+    ListEntry = YoriLibGetNextListEntry(&ExecContext->PendingOutput, NULL);
+    while (ListEntry != NULL) {
+        Pending = CONTAINING_RECORD(ListEntry, FOR_CAPTURED_OUTPUT, ListEntry);
+        if (Pending->Sequence != ExecContext->NextSequenceToDisplay) {
+            break;
+        }
+
+        YoriLibRemoveListItem(ListEntry);
+        ForDisplayCapturedOutput(Pending);
+        ForFreeCapturedOutput(Pending);
+        ExecContext->NextSequenceToDisplay++;
+        ListEntry = YoriLibGetNextListEntry(&ExecContext->PendingOutput, NULL);
+    }
+}
+
+/**
+ Allocate the slots for child processes and start the threads which wait
+ for them.
+
+ @param ExecContext Pointer to the for exec context, where
+        TargetConcurrentCount has been populated.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+ForInitializeSlots(
+    __inout PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    DWORD Index;
+
+    YoriLibInitializeListHead(&ExecContext->PendingOutput);
+
+    if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)ExecContext->TargetConcurrentCount * sizeof(FOR_SLOT))) {
+        return FALSE;
+    }
+
+    ExecContext->Slots = YoriLibMalloc(ExecContext->TargetConcurrentCount * sizeof(FOR_SLOT));
+    ExecContext->FreeSlots = YoriLibMalloc(ExecContext->TargetConcurrentCount * sizeof(DWORD));
+    if (ExecContext->Slots == NULL ||
+        ExecContext->FreeSlots == NULL) {
+
+        return FALSE;
+    }
+
+    ZeroMemory(ExecContext->Slots, ExecContext->TargetConcurrentCount * sizeof(FOR_SLOT));
+
+    //
+    //  Push the slots in reverse so the lowest numbered slots are used
+    //  first, which keeps the processes within as few wait threads as
+    //  possible.
+    //
+
+    for (Index = 0; Index < ExecContext->TargetConcurrentCount; Index++) {
+        ExecContext->FreeSlots[Index] = ExecContext->TargetConcurrentCount - Index - 1;
+    }
+    ExecContext->FreeSlotCount = ExecContext->TargetConcurrentCount;
+
+    if (!ForWaitPoolInitialize(&ExecContext->WaitPool, ExecContext->Slots, ExecContext->TargetConcurrentCount)) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  Wait for any single process to complete.
 
@@ -139,36 +927,73 @@ ForWaitForProcessToComplete(
     __in PFOR_EXEC_CONTEXT ExecContext
     )
 {
-    DWORD Result;
-    YORI_ALLOC_SIZE_T Index;
-    YORI_ALLOC_SIZE_T Count;
+    DWORD SlotIndex;
+    PFOR_SLOT Slot;
+
+    ASSERT(ExecContext->CurrentConcurrentCount > 0);
 
-    Result = WaitForMultipleObjectsEx(ExecContext->CurrentConcurrentCount, ExecContext->HandleArray, FALSE, INFINITE, FALSE);
+    SlotIndex = ForWaitPoolWait(&ExecContext->WaitPool);
+    Slot = &ExecContext->Slots[SlotIndex];
 
-    ASSERT(Result < (WAIT_OBJECT_0 + ExecContext->CurrentConcurrentCount));
+    CloseHandle(Slot->ProcessHandle);
+    Slot->ProcessHandle = NULL;
 
-    Index = (YORI_ALLOC_SIZE_T)(Result - WAIT_OBJECT_0);
+    ForFinishCapturedOutput(Slot);
+    if (Slot->Output != NULL) {
+        ForCompleteCapturedOutput(ExecContext, Slot->Output);
+        Slot->Output = NULL;
+    }
 
-    ASSERT(Index < ExecContext->CurrentConcurrentCount);
+    ExecContext->FreeSlots[ExecContext->FreeSlotCount] = SlotIndex;
+    ExecContext->FreeSlotCount++;
+    ExecContext->CurrentConcurrentCount--;
+}
 
-    CloseHandle(ExecContext->HandleArray[Index]);
+/**
+ Wait for all running processes to complete, display any output which is
+ still pending, and free the slots for child processes.
 
-    for (Count = Index; Count < ExecContext->CurrentConcurrentCount - 1; Count++) {
+ @param ExecContext Pointer to the for exec context.
+ */
+VOID
+ForCleanupSlots(
+    __inout PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PFOR_CAPTURED_OUTPUT Pending;
 
-#if defined(_MSC_VER) && (_MSC_VER >= 1700)
-        //
-        //  The "correct" annotation here would describe that HandleArray is
-        //  of TargetConcurrentCount elements, CurrentConcurrentCount of which
-        //  are readable, and CurrentConcurrentCount needs to be less than or
-        //  equal to TargetConcurrentCount.  This is something that I don't
-        //  see a way to express as of this writing.
-        //
-#pragma warning(suppress: 6001)
-#endif
-        ExecContext->HandleArray[Count] = ExecContext->HandleArray[Count + 1];
+    while (ExecContext->CurrentConcurrentCount > 0) {
+        ForWaitForProcessToComplete(ExecContext);
     }
 
-    ExecContext->CurrentConcurrentCount--;
+    //
+    //  Every command has completed, so nothing should be waiting, but
+    //  display anything left rather than lose it.
+    //
+
+    if (ExecContext->PendingOutput.Next != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&ExecContext->PendingOutput, NULL);
+        while (ListEntry != NULL) {
+            Pending = CONTAINING_RECORD(ListEntry, FOR_CAPTURED_OUTPUT, ListEntry);
+            YoriLibRemoveListItem(ListEntry);
+            ForDisplayCapturedOutput(Pending);
+            ForFreeCapturedOutput(Pending);
+            ListEntry = YoriLibGetNextListEntry(&ExecContext->PendingOutput, NULL);
+        }
+    }
+
+    ForWaitPoolCleanup(&ExecContext->WaitPool);
+
+    if (ExecContext->Slots != NULL) {
+        YoriLibFree(ExecContext->Slots);
+        ExecContext->Slots = NULL;
+    }
+
+    if (ExecContext->FreeSlots != NULL) {
+        YoriLibFree(ExecContext->FreeSlots);
+        ExecContext->FreeSlots = NULL;
+    }
 }
 
 /**
@@ -602,6 +1427,9 @@ ForExecuteCommand(
     PROCESS_INFORMATION ProcessInfo;
     STARTUPINFO StartupInfo;
     YORI_LIBSH_CMD_CONTEXT NewCmd;
+    DWORD SlotIndex;
+    PFOR_SLOT Slot;
+    HANDLE WritePipe;
 
     YoriLibInitEmptyString(&CmdLine);
 
@@ -764,18 +1592,51 @@ ForExecuteCommand(
     memset(&StartupInfo, 0, sizeof(StartupInfo));
     StartupInfo.cb = sizeof(StartupInfo);
 
+    ASSERT(ExecContext->FreeSlotCount > 0);
+    SlotIndex = ExecContext->FreeSlots[ExecContext->FreeSlotCount - 1];
+    Slot = &ExecContext->Slots[SlotIndex];
+
+    //
+    //  If output is being captured, give the child a pipe as its standard
+    //  output.  If that can't be set up, let the child write to standard
+    //  output directly rather than fail.
+    //
+
+    WritePipe = NULL;
+    if (ExecContext->OutputMode != ForOutputDirect &&
+        ForPrepareCapturedOutput(Slot, &WritePipe)) {
+
+        StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+        StartupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+        StartupInfo.hStdOutput = WritePipe;
+        StartupInfo.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    }
+
     if (!CreateProcess(NULL, CmdLine.StartOfString, NULL, NULL, TRUE, CREATE_DEFAULT_ERROR_MODE, NULL, NULL, &StartupInfo, &ProcessInfo)) {
         DWORD LastError = GetLastError();
         LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("for: execution failed: %s"), ErrText);
         YoriLibFreeWinErrorText(ErrText);
+        if (WritePipe != NULL) {
+            CloseHandle(WritePipe);
+            ForFinishCapturedOutput(Slot);
+            ForFreeCapturedOutput(Slot->Output);
+            Slot->Output = NULL;
+        }
         goto Cleanup;
     }
 
     CloseHandle(ProcessInfo.hThread);
+    if (WritePipe != NULL) {
+        CloseHandle(WritePipe);
+        Slot->Output->Sequence = ExecContext->NextSequence;
+        ExecContext->NextSequence++;
+    }
 
-    ExecContext->HandleArray[ExecContext->CurrentConcurrentCount] = ProcessInfo.hProcess;
+    Slot->ProcessHandle = ProcessInfo.hProcess;
+    ExecContext->FreeSlotCount--;
     ExecContext->CurrentConcurrentCount++;
+    ForWaitPoolArm(&ExecContext->WaitPool, SlotIndex);
 
     if (ExecContext->CurrentConcurrentCount == ExecContext->TargetConcurrentCount) {
         ForWaitForProcessToComplete(ExecContext);
@@ -892,7 +1753,7 @@ ENTRYPOINT(
                 ForHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2017-2019"));
+                YoriLibDisplayMitLicense(_T("2017-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
@@ -924,6 +1785,12 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
                 StepMode = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("o")) == 0) {
+                ExecContext.OutputMode = ForOutputCompletionOrder;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("oi")) == 0) {
+                ExecContext.OutputMode = ForOutputInputOrder;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("p")) == 0) {
                 if (i + 1 < ArgC) {
                     YORI_MAX_SIGNED_T LlNumberProcesses = 0;
@@ -1023,8 +1890,7 @@ ENTRYPOINT(
 
     ExecContext.ArgC = ArgC - CmdArg;
     ExecContext.ArgV = &ArgV[CmdArg];
-    ExecContext.HandleArray = YoriLibMalloc(ExecContext.TargetConcurrentCount * sizeof(HANDLE));
-    if (ExecContext.HandleArray == NULL) {
+    if (!ForInitializeSlots(&ExecContext)) {
         goto cleanup_and_exit;
     }
 
@@ -1219,17 +2085,14 @@ ENTRYPOINT(
         }
     }
 
-    while (ExecContext.CurrentConcurrentCount > 0) {
-        ForWaitForProcessToComplete(&ExecContext);
-    }
-
+    ForCleanupSlots(&ExecContext);
     YoriLibFileFiltFreeFilter(&ExecContext.Filter);
-    YoriLibFree(ExecContext.HandleArray);
 
     return EXIT_SUCCESS;
 
 cleanup_and_exit:
 
+    ForCleanupSlots(&ExecContext);
     YoriLibFileFiltFreeFilter(&ExecContext.Filter);
 
     return EXIT_FAILURE;
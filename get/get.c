@@ -3,7 +3,7 @@
  *
  * Yori shell fetch objects from HTTP
  *
- * Copyright (c) 2017-2019 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -34,9 +34,13 @@ const
 CHAR strGetHelpText[] =
         "Fetches objects from HTTP and stores them in local files.\n"
         "\n"
-        "GET [-license] [-n] <url> <file>\n"
+        "GET [-license] [-n] [-p] [-s <count>] <url> [<file>]\n"
         "\n"
-        "   -n             Only download URL if newer than file\n";
+        "   -n             Only download URL if newer than file\n"
+        "   -p             Display progress, throughput and time remaining\n"
+        "   -s <count>     Download large objects as up to <count> concurrent ranges\n"
+        "\n"
+        "If no file is specified, the object is written to standard output.\n";
 
 /**
  Display usage text to the user.
@@ -52,6 +56,100 @@ GetHelp(VOID)
     return TRUE;
 }
 
+/**
+ State used to display the progress of a download.
+ */
+typedef struct _GET_PROGRESS_CONTEXT {
+
+    /**
+     The tick count when the download started.
+     */
+    DWORD StartTick;
+
+    /**
+     TRUE once progress has been displayed, so the line can be terminated
+     when the download finishes.
+     */
+    BOOLEAN Displayed;
+} GET_PROGRESS_CONTEXT, *PGET_PROGRESS_CONTEXT;
+
+/**
+ Display the progress of a download, including the throughput so far and,
+ if the length of the object is known, the estimated time remaining.
+
+ @param BytesReceived The number of bytes received so far.
+
+ @param TotalBytes The length of the object, or zero if not known.
+
+ @param Context Pointer to the progress context.
+ */
+VOID
+GetDisplayProgress(
+    __in DWORDLONG BytesReceived,
+    __in DWORDLONG TotalBytes,
+    __in PVOID Context
+    )
+{
+    PGET_PROGRESS_CONTEXT ProgressContext;
+    TCHAR ReceivedStringBuffer[sizeof("12.3k")];
+    TCHAR TotalStringBuffer[sizeof("12.3k")];
+    TCHAR RateStringBuffer[sizeof("12.3k")];
+    YORI_STRING ReceivedString;
+    YORI_STRING TotalString;
+    YORI_STRING RateString;
+    LARGE_INTEGER Value;
+    DWORDLONG BytesPerSecond;
+    DWORDLONG SecondsRemaining;
+    DWORD Elapsed;
+
+    ProgressContext = (PGET_PROGRESS_CONTEXT)Context;
+    Elapsed = GetTickCount() - ProgressContext->StartTick;
+    BytesPerSecond = 0;
+    if (Elapsed > 0) {
+        BytesPerSecond = BytesReceived * 1000 / Elapsed;
+    }
+
+    YoriLibInitEmptyString(&ReceivedString);
+    ReceivedString.StartOfString = ReceivedStringBuffer;
+    ReceivedString.LengthAllocated = sizeof(ReceivedStringBuffer)/sizeof(ReceivedStringBuffer[0]);
+    Value.QuadPart = BytesReceived;
+    YoriLibFileSizeToString(&ReceivedString, &Value);
+
+    YoriLibInitEmptyString(&RateString);
+    RateString.StartOfString = RateStringBuffer;
+    RateString.LengthAllocated = sizeof(RateStringBuffer)/sizeof(RateStringBuffer[0]);
+    Value.QuadPart = BytesPerSecond;
+    YoriLibFileSizeToString(&RateString, &Value);
+
+    if (TotalBytes == 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("\r%y, %y/s  "), &ReceivedString, &RateString);
+    } else {
+        YoriLibInitEmptyString(&TotalString);
+        TotalString.StartOfString = TotalStringBuffer;
+        TotalString.LengthAllocated = sizeof(TotalStringBuffer)/sizeof(TotalStringBuffer[0]);
+        Value.QuadPart = TotalBytes;
+        YoriLibFileSizeToString(&TotalString, &Value);
+
+        if (BytesPerSecond == 0 || BytesReceived >= TotalBytes) {
+            SecondsRemaining = 0;
+        } else {
+            SecondsRemaining = (TotalBytes - BytesReceived + BytesPerSecond - 1) / BytesPerSecond;
+        }
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                      _T("\r%y of %y (%i%%), %y/s, %i:%02i:%02i remaining  "),
+                      &ReceivedString,
+                      &TotalString,
+                      (DWORD)(BytesReceived * 100 / TotalBytes),
+                      &RateString,
+                      (DWORD)(SecondsRemaining / 3600),
+                      (DWORD)((SecondsRemaining / 60) % 60),
+                      (DWORD)(SecondsRemaining % 60));
+    }
+
+    ProgressContext->Displayed = TRUE;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the get builtin command.
@@ -86,10 +184,18 @@ ENTRYPOINT(
     YORI_STRING NewFileName;
     PYORI_STRING ExistingUrlName;
     YORI_LIB_UPDATE_ERROR Error;
+    YORI_LIB_UPDATE_OPTIONS Options;
+    GET_PROGRESS_CONTEXT ProgressContext;
     YORI_STRING Agent;
     YORI_STRING Arg;
+    YORI_MAX_SIGNED_T llTemp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
     BOOLEAN NewerOnly = FALSE;
+    BOOLEAN DisplayProgress = FALSE;
     SYSTEMTIME ExistingFileTime;
+    DWORD ConsoleMode;
+
+    ZeroMemory(&Options, sizeof(Options));
 
     for (i = 1; i < ArgC; i++) {
 
@@ -103,8 +209,22 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("n")) == 0) {
                 NewerOnly = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("p")) == 0) {
+                DisplayProgress = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
+                if (ArgC > i + 1) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        llTemp > 0) {
+
+                        Options.SegmentCount = (DWORD)llTemp;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2017-2019"));
+                YoriLibDisplayMitLicense(_T("2017-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 ArgumentUnderstood = TRUE;
@@ -122,12 +242,26 @@ ENTRYPOINT(
         }
     }
 
-    if (ArgC - StartArg < 2) {
+    if (StartArg >= ArgC) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("get: missing argument\n"));
         return EXIT_FAILURE;
     }
 
-    if (!YoriLibUserStringToSingleFilePath(&ArgV[StartArg + 1], TRUE, &NewFileName)) {
+    //
+    //  Without a file name the object is streamed to standard output,
+    //  which is only useful if it has been redirected.
+    //
+
+    YoriLibInitEmptyString(&NewFileName);
+    if (ArgC - StartArg < 2) {
+        if (NewerOnly ||
+            GetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE), &ConsoleMode)) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("get: missing argument\n"));
+            return EXIT_FAILURE;
+        }
+        Options.OutputHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+    } else if (!YoriLibUserStringToSingleFilePath(&ArgV[StartArg + 1], TRUE, &NewFileName)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("get: failed to resolve %y\n"), &ArgV[StartArg + 1]);
         return EXIT_FAILURE;
     }
@@ -169,12 +303,24 @@ ENTRYPOINT(
         YoriLibFreeStringContents(&NewFileName);
         return EXIT_FAILURE;
     }
-    Error = YoriLibUpdateBinaryFromUrl(ExistingUrlName,
-                                       &NewFileName,
-                                       &Agent,
-                                       NewerOnly?&ExistingFileTime:NULL);
+
+    ProgressContext.StartTick = GetTickCount();
+    ProgressContext.Displayed = FALSE;
+    if (DisplayProgress) {
+        Options.ProgressCallback = GetDisplayProgress;
+        Options.ProgressContext = &ProgressContext;
+    }
+
+    Error = YoriLibUpdateBinaryFromUrlEx(ExistingUrlName,
+                                         (Options.OutputHandle != NULL)?NULL:&NewFileName,
+                                         &Agent,
+                                         NewerOnly?&ExistingFileTime:NULL,
+                                         &Options);
     YoriLibFreeStringContents(&NewFileName);
     YoriLibFreeStringContents(&Agent);
+    if (ProgressContext.Displayed) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("\n"));
+    }
     if (Error != YoriLibUpdErrorSuccess) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("get: failed to download: %s\n"), YoriLibUpdateErrorString(Error));
         return EXIT_FAILURE;
@@ -3,7 +3,7 @@
  *
  * Yori shell query group membership
  *
- * Copyright (c) 2018-2020 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -36,8 +36,10 @@ CHAR strGrpcmpHelpText[] =
         "Returns true if the user is a member of the specified group."
         "\n"
         "GRPCMP [-license] [-b] <group>\n"
+        "GRPCMP [-license] -s\n"
         "\n"
-        "   -b             Treat the group as a well known builtin\n";
+        "   -b             Treat the group as a well known builtin\n"
+        "   -s             Check each group named on standard input and report membership\n";
 
 /**
  Display usage text to the user.
@@ -53,6 +55,363 @@ GrpcmpHelp(VOID)
     return TRUE;
 }
 
+/**
+ The result of checking membership of a single group.
+ */
+typedef enum _GRPCMP_RESULT {
+    GrpcmpResultMember = 0,
+    GrpcmpResultNotMember = 1,
+    GrpcmpResultNotFound = 2,
+    GrpcmpResultNotGroup = 3
+} GRPCMP_RESULT;
+
+/**
+ A group name that has previously been checked.  Scripts often check the
+ same group repeatedly, and each name lookup can require a round trip to a
+ domain controller, so each distinct name is only resolved once.
+ */
+typedef struct _GRPCMP_CACHED_NAME {
+
+    /**
+     The link of this name within the list of all cached names.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The entry of this name within the hash table of names.
+     */
+    YORI_OPEN_HASH_ENTRY HashEntry;
+
+    /**
+     The result of checking membership of the group.
+     */
+    GRPCMP_RESULT Result;
+} GRPCMP_CACHED_NAME, *PGRPCMP_CACHED_NAME;
+
+/**
+ The set of enabled group SIDs in the current token.
+ */
+typedef struct _GRPCMP_SID_SET {
+
+    /**
+     A hash table of SIDs, keyed by the hex encoding of each SID.
+     */
+    PYORI_OPEN_HASH_TABLE Table;
+
+    /**
+     An array of hash entries, one per SID in the table.
+     */
+    PYORI_OPEN_HASH_ENTRY Entries;
+
+    /**
+     The number of entries in the Entries array which are in the table.
+     */
+    YORI_ALLOC_SIZE_T EntryCount;
+} GRPCMP_SID_SET, *PGRPCMP_SID_SET;
+
+/**
+ Generate a string form of a SID which can be used as a hash table key.
+
+ @param Sid Pointer to the SID.
+
+ @param Key On successful completion, populated with a newly allocated
+        string containing the SID encoded as hex.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+GrpcmpSidToKey(
+    __in PSID Sid,
+    __out PYORI_STRING Key
+    )
+{
+    YORI_ALLOC_SIZE_T SidLength;
+
+    SidLength = (YORI_ALLOC_SIZE_T)DllAdvApi32.pGetLengthSid(Sid);
+    if (!YoriLibAllocateString(Key, SidLength * 2 + 1)) {
+        return FALSE;
+    }
+
+    if (!YoriLibHexBufferToString(Sid, SidLength, Key)) {
+        YoriLibFreeStringContents(Key);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Free a set of SIDs populated by @ref GrpcmpBuildTokenSidSet .
+
+ @param SidSet Pointer to the set to free.
+ */
+VOID
+GrpcmpFreeSidSet(
+    __in PGRPCMP_SID_SET SidSet
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    for (Index = 0; Index < SidSet->EntryCount; Index++) {
+        YoriLibOpenHashRemoveByEntry(&SidSet->Entries[Index]);
+    }
+
+    if (SidSet->Table != NULL) {
+        YoriLibFreeEmptyOpenHashTable(SidSet->Table);
+    }
+
+    if (SidSet->Entries != NULL) {
+        YoriLibFree(SidSet->Entries);
+    }
+
+    ZeroMemory(SidSet, sizeof(GRPCMP_SID_SET));
+}
+
+/**
+ Populate a hash table with the enabled group SIDs in the current token, so
+ that membership of any number of groups can be checked without scanning the
+ token for each one.
+
+ @param SidSet On successful completion, populated with the set of SIDs.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+GrpcmpBuildTokenSidSet(
+    __out PGRPCMP_SID_SET SidSet
+    )
+{
+    PTOKEN_GROUPS Groups;
+    YORI_STRING Key;
+    YORI_ALLOC_SIZE_T Index;
+
+    ZeroMemory(SidSet, sizeof(GRPCMP_SID_SET));
+
+    if (!YoriLibQueryTokenGroups(NULL, &Groups)) {
+        return FALSE;
+    }
+
+    SidSet->Table = YoriLibAllocateOpenHashTable((YORI_ALLOC_SIZE_T)Groups->GroupCount);
+    if (Groups->GroupCount > 0) {
+        SidSet->Entries = YoriLibMalloc((YORI_ALLOC_SIZE_T)(Groups->GroupCount * sizeof(YORI_OPEN_HASH_ENTRY)));
+    }
+
+    if (SidSet->Table == NULL ||
+        (Groups->GroupCount > 0 && SidSet->Entries == NULL)) {
+
+        GrpcmpFreeSidSet(SidSet);
+        YoriLibFree(Groups);
+        return FALSE;
+    }
+
+    for (Index = 0; Index < Groups->GroupCount; Index++) {
+        if ((Groups->Groups[Index].Attributes & SE_GROUP_ENABLED) == 0) {
+            continue;
+        }
+
+        if (!GrpcmpSidToKey(Groups->Groups[Index].Sid, &Key)) {
+            GrpcmpFreeSidSet(SidSet);
+            YoriLibFree(Groups);
+            return FALSE;
+        }
+
+        if (YoriLibOpenHashLookupByKey(SidSet->Table, &Key) == NULL) {
+            if (!YoriLibOpenHashInsertByKey(SidSet->Table, &Key, NULL, &SidSet->Entries[SidSet->EntryCount])) {
+                YoriLibFreeStringContents(&Key);
+                GrpcmpFreeSidSet(SidSet);
+                YoriLibFree(Groups);
+                return FALSE;
+            }
+            SidSet->EntryCount++;
+        }
+        YoriLibFreeStringContents(&Key);
+    }
+
+    YoriLibFree(Groups);
+    return TRUE;
+}
+
+/**
+ Resolve a group name and check whether its SID is in the current token.
+
+ @param SidSet Pointer to the set of SIDs in the current token.
+
+ @param GroupName Pointer to the NULL terminated name of the group.
+
+ @return The result of the check.
+ */
+GRPCMP_RESULT
+GrpcmpCheckGroupName(
+    __in PGRPCMP_SID_SET SidSet,
+    __in PYORI_STRING GroupName
+    )
+{
+    union {
+        SID Sid;
+        UCHAR Storage[512];
+    } Sid;
+    TCHAR Domain[256];
+    DWORD SidSize;
+    DWORD DomainNameSize;
+    SID_NAME_USE Use;
+    YORI_STRING Key;
+    GRPCMP_RESULT Result;
+
+    SidSize = sizeof(Sid);
+    DomainNameSize = sizeof(Domain)/sizeof(Domain[0]);
+
+    if (!DllAdvApi32.pLookupAccountNameW(NULL, GroupName->StartOfString, &Sid, &SidSize, Domain, &DomainNameSize, &Use)) {
+        return GrpcmpResultNotFound;
+    }
+
+    if (Use != SidTypeGroup && Use != SidTypeWellKnownGroup && Use != SidTypeAlias) {
+        return GrpcmpResultNotGroup;
+    }
+
+    if (!GrpcmpSidToKey(&Sid.Sid, &Key)) {
+        return GrpcmpResultNotFound;
+    }
+
+    Result = GrpcmpResultNotMember;
+    if (YoriLibOpenHashLookupByKey(SidSet->Table, &Key) != NULL) {
+        Result = GrpcmpResultMember;
+    }
+    YoriLibFreeStringContents(&Key);
+    return Result;
+}
+
+/**
+ Read group names from standard input, one per line, and report whether the
+ current user is a member of each.  The token is queried once, and each
+ distinct name is resolved once, so large lists can be checked quickly.
+
+ @return EXIT_SUCCESS if the user is a member of every group, EXIT_FAILURE
+         if not or if the groups could not be checked.
+ */
+DWORD
+GrpcmpBatch(VOID)
+{
+    GRPCMP_SID_SET SidSet;
+    PYORI_OPEN_HASH_TABLE NameCache;
+    YORI_LIST_ENTRY CachedNames;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+    PGRPCMP_CACHED_NAME CachedName;
+    YORI_STRING LineString;
+    YORI_STRING GroupName;
+    YORI_STRING NameCopy;
+    PVOID LineContext;
+    DWORD ExitCode;
+    LPCTSTR ResultText;
+
+    if (YoriLibIsStdInConsole()) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("grpcmp: no file or pipe for input\n"));
+        return EXIT_FAILURE;
+    }
+
+    if (DllAdvApi32.pGetLengthSid == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("grpcmp: OS functionality not available\n"));
+        return EXIT_FAILURE;
+    }
+
+    if (!GrpcmpBuildTokenSidSet(&SidSet)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("grpcmp: could not query token groups\n"));
+        return EXIT_FAILURE;
+    }
+
+    NameCache = YoriLibAllocateOpenHashTable(256);
+    if (NameCache == NULL) {
+        GrpcmpFreeSidSet(&SidSet);
+        return EXIT_FAILURE;
+    }
+
+    YoriLibInitializeListHead(&CachedNames);
+    YoriLibInitEmptyString(&LineString);
+    LineContext = NULL;
+    ExitCode = EXIT_SUCCESS;
+
+    while (YoriLibReadLineToString(&LineString, &LineContext, GetStdHandle(STD_INPUT_HANDLE))) {
+
+        YoriLibInitEmptyString(&GroupName);
+        GroupName.StartOfString = LineString.StartOfString;
+        GroupName.LengthInChars = LineString.LengthInChars;
+        YoriLibTrimSpaces(&GroupName);
+        if (GroupName.LengthInChars == 0) {
+            continue;
+        }
+
+        HashEntry = YoriLibOpenHashLookupByKey(NameCache, &GroupName);
+        if (HashEntry != NULL) {
+            CachedName = HashEntry->Context;
+        } else {
+            CachedName = YoriLibMalloc(sizeof(GRPCMP_CACHED_NAME));
+            if (CachedName == NULL) {
+                ExitCode = EXIT_FAILURE;
+                break;
+            }
+
+            //
+            //  The line buffer is reused for the next line, so the hash
+            //  entry needs its own copy of the name.
+            //
+
+            if (!YoriLibCopyString(&NameCopy, &GroupName)) {
+                YoriLibFree(CachedName);
+                ExitCode = EXIT_FAILURE;
+                break;
+            }
+
+            CachedName->Result = GrpcmpCheckGroupName(&SidSet, &NameCopy);
+            if (!YoriLibOpenHashInsertByKey(NameCache, &NameCopy, CachedName, &CachedName->HashEntry)) {
+                YoriLibFreeStringContents(&NameCopy);
+                YoriLibFree(CachedName);
+                ExitCode = EXIT_FAILURE;
+                break;
+            }
+            YoriLibFreeStringContents(&NameCopy);
+            YoriLibAppendList(&CachedNames, &CachedName->ListEntry);
+        }
+
+        switch (CachedName->Result) {
+            case GrpcmpResultMember:
+                ResultText = _T("member");
+                break;
+            case GrpcmpResultNotMember:
+                ResultText = _T("not member");
+                break;
+            case GrpcmpResultNotGroup:
+                ResultText = _T("not a group");
+                break;
+            default:
+                ResultText = _T("not found");
+                break;
+        }
+
+        if (CachedName->Result != GrpcmpResultMember) {
+            ExitCode = EXIT_FAILURE;
+        }
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y: %s\n"), &GroupName, ResultText);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&CachedNames, NULL);
+    while (ListEntry != NULL) {
+        CachedName = CONTAINING_RECORD(ListEntry, GRPCMP_CACHED_NAME, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&CachedNames, ListEntry);
+        YoriLibOpenHashRemoveByEntry(&CachedName->HashEntry);
+        YoriLibFree(CachedName);
+    }
+
+    YoriLibFreeEmptyOpenHashTable(NameCache);
+    YoriLibLineReadCloseOrCache(LineContext);
+    YoriLibFreeStringContents(&LineString);
+    GrpcmpFreeSidSet(&SidSet);
+
+    return ExitCode;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the grpcmp builtin command.
@@ -85,11 +444,14 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T StartArg;
     YORI_ALLOC_SIZE_T i;
     BOOL IsMember = FALSE;
+    DWORD ExitCode;
     BOOL BuiltinMode;
+    BOOLEAN BatchMode;
     YORI_STRING Arg;
 
     StartArg = 0;
     BuiltinMode = FALSE;
+    BatchMode = FALSE;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -102,11 +464,14 @@ ENTRYPOINT(
                 GrpcmpHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2018-2020"));
+                YoriLibDisplayMitLicense(_T("2018-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BuiltinMode = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
+                BatchMode = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 StartArg = i + 1;
                 ArgumentUnderstood = TRUE;
@@ -123,7 +488,7 @@ ENTRYPOINT(
         }
     }
 
-    if (StartArg == 0 || StartArg == ArgC) {
+    if (!BatchMode && (StartArg == 0 || StartArg == ArgC)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("grpcmp: missing argument\n"));
         return EXIT_FAILURE;
     }
@@ -142,6 +507,14 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
+    if (BatchMode) {
+        ExitCode = GrpcmpBatch();
+#if !YORI_BUILTIN
+        YoriLibLineReadCleanupCache();
+#endif
+        return ExitCode;
+    }
+
     if (BuiltinMode) {
         PSID pSid;
         DWORD WellKnownId;
@@ -3,7 +3,7 @@
  *
  * Yori shell hash a file
  *
- * Copyright (c) 2019-2021 Malcolm J. Smith
+ * Copyright (c) 2019-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -40,11 +40,14 @@ CHAR strHashHelpText[] =
         "\n"
         "Hash a file.\n"
         "\n"
-        "HASH [-license] [-a <algorithm>] [-b] [-s] [<file>]\n"
+        "HASH [-license] [-a <algorithm>] [-b] [-cache <file>] [-j <n>] [-s] [<file>]\n"
         "\n"
         "   -a <algorithm> Specify the hash algorithm. Supported algorithms:\n"
-        "                    MD4, MD5, SHA1, SHA256, SHA384, or SHA512\n"
+        "                    CRC32C, MD4, MD5, SHA1, SHA256, SHA384, SHA512, or\n"
+        "                    XXH64\n"
         "   -b             Use basic search criteria for files only\n"
+        "   -cache <file>  Reuse hashes recorded in file for unchanged files\n"
+        "   -j <n>         Hash up to n files concurrently\n"
         "   -s             Hash files in subdirectories\n";
 
 /**
@@ -61,6 +64,266 @@ HashHelp(VOID)
     return TRUE;
 }
 
+/**
+ The method used to calculate a hash.
+ */
+typedef enum _HASH_BACKEND {
+    HashBackendCryptoApi = 0,
+    HashBackendBCrypt = 1,
+    HashBackendCrc32c = 2,
+    HashBackendXxHash64 = 3
+} HASH_BACKEND;
+
+/**
+ A hash algorithm that can be specified on the command line.
+ */
+typedef struct _HASH_ALGORITHM {
+
+    /**
+     The name of the algorithm.
+     */
+    LPCTSTR Name;
+
+    /**
+     The algorithm in CALG_* format, or zero if it is implemented in this
+     program.
+     */
+    DWORD CryptAlgorithm;
+
+    /**
+     The BCrypt algorithm identifier, or NULL if it is implemented in this
+     program.
+     */
+    LPCWSTR BCryptAlgorithm;
+
+    /**
+     The method to calculate the hash.  For operating system algorithms this
+     is HashBackendCryptoApi, and BCrypt is used instead when it is
+     available.
+     */
+    HASH_BACKEND Backend;
+
+} HASH_ALGORITHM, *PHASH_ALGORITHM;
+
+/**
+ A pointer to a hash algorithm that cannot be modified.
+ */
+typedef HASH_ALGORITHM CONST *PCHASH_ALGORITHM;
+
+/**
+ The supported hash algorithms.  CRC32C and XXH64 are not cryptographic, but
+ are much faster, and are suitable for detecting changes.
+ */
+CONST HASH_ALGORITHM HashAlgorithms[] = {
+    {_T("CRC32C"), 0,            NULL,      HashBackendCrc32c},
+    {_T("MD4"),    CALG_MD4,     L"MD4",    HashBackendCryptoApi},
+    {_T("MD5"),    CALG_MD5,     L"MD5",    HashBackendCryptoApi},
+    {_T("SHA1"),   CALG_SHA1,    L"SHA1",   HashBackendCryptoApi},
+    {_T("SHA256"), CALG_SHA_256, L"SHA256", HashBackendCryptoApi},
+    {_T("SHA384"), CALG_SHA_384, L"SHA384", HashBackendCryptoApi},
+    {_T("SHA512"), CALG_SHA_512, L"SHA512", HashBackendCryptoApi},
+    {_T("XXH64"),  0,            NULL,      HashBackendXxHash64},
+};
+
+/**
+ The maximum number of worker threads that can hash files concurrently.
+ */
+#define HASH_MAX_WORKERS (64)
+
+/**
+ The number of files that can be queued for each worker thread.  Files are
+ output in the order they were queued, so this bounds how far ahead of the
+ output the workers can get.
+ */
+#define HASH_JOBS_PER_WORKER (4)
+
+/**
+ Forward declaration of the context passed to each file found.
+ */
+typedef struct _HASH_CONTEXT *PHASH_CONTEXT;
+
+/**
+ State for a single thread that hashes files.  The main thread has one of
+ these which it uses when files are not hashed in parallel.
+ */
+typedef struct _HASH_WORKER {
+
+    /**
+     Pointer to the context for the hash operation.
+     */
+    PHASH_CONTEXT HashContext;
+
+    /**
+     A handle to the thread.  This is NULL for the main thread's worker.
+     */
+    HANDLE Thread;
+
+    /**
+     Pointer to a blob of memory containing the result of the hash calculation
+     for each file.  This is HashLength bytes in size.
+     */
+    PUCHAR HashBuffer;
+
+    /**
+     Pointer to a buffer to read data from a stream into.  This is
+     ReadBufferLength bytes in size.
+     */
+    PVOID ReadBuffer;
+
+    /**
+     Buffers and events to read files opened for overlapped IO.  Several
+     reads are kept in flight while data from an earlier read is hashed.
+     */
+    YORI_LIB_ASYNC_IO AsyncIo;
+
+    /**
+     The CryptoAPI hash object for the file currently being hashed.
+     */
+    DWORD_PTR CryptHash;
+
+    /**
+     The BCrypt hash object.  If the BCrypt provider supports reusable hash
+     objects, this is created once and used for every file.  Otherwise it is
+     created for each file.
+     */
+    PVOID BCryptHash;
+
+    /**
+     Memory for BCrypt to store the state of the hash object.
+     */
+    PUCHAR BCryptHashObject;
+
+    /**
+     The CRC32C of the data hashed so far.
+     */
+    DWORD Crc32c;
+
+    /**
+     The XXH64 state of the data hashed so far.
+     */
+    YORI_LIB_XXHASH64_STATE XxHash64;
+
+} HASH_WORKER, *PHASH_WORKER;
+
+/**
+ A single file queued for hashing by a worker thread.
+ */
+typedef struct _HASH_JOB {
+
+    /**
+     The full path to the file.  The buffer is retained and reused for later
+     files that use the same job slot.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     The offset in characters within FilePath of the path to display.
+     */
+    YORI_ALLOC_SIZE_T RelativePathOffset;
+
+    /**
+     The hex representation of the hash of the file.
+     */
+    YORI_STRING HashString;
+
+    /**
+     If the file could not be opened, the Win32 error code from the open.
+     ERROR_SUCCESS if the file was opened.
+     */
+    DWORD OpenError;
+
+    /**
+     TRUE if a failure to open the file should be displayed.
+     */
+    BOOLEAN ReportOpenError;
+
+    /**
+     TRUE if the file was hashed successfully and HashString is valid.
+     */
+    BOOLEAN Succeeded;
+
+    /**
+     TRUE once a worker has finished processing the job.
+     */
+    BOOLEAN Complete;
+
+} HASH_JOB, *PHASH_JOB;
+
+/**
+ The information that is compared to determine whether a file has changed
+ since it was last hashed.
+ */
+typedef struct _HASH_FILE_STAMP {
+
+    /**
+     The serial number of the volume containing the file.
+     */
+    DWORD VolumeSerialNumber;
+
+    /**
+     The file ID, unique within the volume.
+     */
+    LARGE_INTEGER FileId;
+
+    /**
+     The size of the file in bytes.
+     */
+    LARGE_INTEGER FileSize;
+
+    /**
+     The last write time of the file.
+     */
+    LARGE_INTEGER LastWriteTime;
+
+    /**
+     The most recent USN of the file, or zero if the volume does not have a
+     change journal.
+     */
+    LARGE_INTEGER Usn;
+
+} HASH_FILE_STAMP, *PHASH_FILE_STAMP;
+
+/**
+ The number of characters in a hash cache key, being the volume serial
+ number and file ID in hex.
+ */
+#define HASH_CACHE_KEY_LENGTH (sizeof(DWORD) * 2 + sizeof(LARGE_INTEGER) * 2)
+
+/**
+ A previously calculated hash of a file.
+ */
+typedef struct _HASH_CACHE_ENTRY {
+
+    /**
+     The entry within the hash table of cached hashes, keyed by volume serial
+     number and file ID.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The entry within the list of cached hashes, used to write them back to
+     the cache file in a stable order.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The state of the file when it was hashed.
+     */
+    HASH_FILE_STAMP Stamp;
+
+    /**
+     The hex representation of the hash of the file.  This points into the
+     same allocation as the entry.
+     */
+    YORI_STRING HashString;
+
+    /**
+     Storage for the key of the entry.
+     */
+    TCHAR KeyBuffer[HASH_CACHE_KEY_LENGTH + 1];
+
+} HASH_CACHE_ENTRY, *PHASH_CACHE_ENTRY;
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
@@ -72,6 +335,11 @@ typedef struct _HASH_CONTEXT {
      */
     BOOLEAN Recursive;
 
+    /**
+     TRUE if worker threads should exit once the queue is empty.
+     */
+    BOOLEAN Shutdown;
+
     /**
      WinCrypt handle to the algorithm provider.  If 0, the algorithm provider
      has not been initialized.
@@ -87,197 +355,1463 @@ typedef struct _HASH_CONTEXT {
     DWORD SavedErrorThisArg;
 
     /**
-     The algorithm to use in CALG_* format.
+     The algorithm to use.
      */
-    DWORD Algorithm;
+    PCHASH_ALGORITHM Algorithm;
 
     /**
-     Pointer to a blob of memory containing the result of the hash calculation
-     for each file.
+     The method used to calculate the hash.
      */
-    PUCHAR HashBuffer;
+    HASH_BACKEND Backend;
 
     /**
-     Specifies the number of bytes in HashBuffer.
+     BCrypt handle to the algorithm provider.  If NULL, the BCrypt provider
+     has not been initialized.
      */
-    YORI_ALLOC_SIZE_T HashLength;
+    PVOID BCryptProvider;
 
     /**
-     Pointer to a buffer to read data from the file into.
+     The number of bytes needed by each BCrypt hash object.
      */
-    PVOID ReadBuffer;
+    DWORD BCryptObjectLength;
+
+    /**
+     TRUE if the BCrypt provider supports hash objects that can be reused
+     after the hash is finished.
+     */
+    BOOLEAN BCryptReusable;
+
+    /**
+     Specifies the number of bytes in the result of the hash calculation.
+     */
+    YORI_ALLOC_SIZE_T HashLength;
 
     /**
-     Specifies the number of bytes in ReadBuffer.
+     Specifies the number of bytes in each read buffer.
      */
     YORI_ALLOC_SIZE_T ReadBufferLength;
 
     /**
      A string which contains enough characters to contain the hex
-     representation of HashBuffer plus a NULL terminator.
+     representation of the hash plus a NULL terminator.  This is used by
+     the main thread.
      */
     YORI_STRING HashString;
 
-    /**
-     Records the total number of files processed.
-     */
-    LONGLONG FilesFound;
+    /**
+     Buffers used by the main thread to hash files.
+     */
+    HASH_WORKER MainWorker;
+
+    /**
+     The number of worker threads in the Workers array.  If zero, files are
+     hashed by the main thread as they are found.
+     */
+    DWORD WorkerCount;
+
+    /**
+     An array of worker threads.
+     */
+    PHASH_WORKER Workers;
+
+    /**
+     A circular array of jobs, in the order that files were found.
+     */
+    PHASH_JOB Jobs;
+
+    /**
+     The number of elements in the Jobs array.
+     */
+    DWORD JobsAllocated;
+
+    /**
+     The index of the oldest job in the Jobs array, which is the next job to
+     output.
+     */
+    DWORD JobHead;
+
+    /**
+     The number of jobs in the Jobs array, starting from JobHead.
+     */
+    DWORD JobCount;
+
+    /**
+     The number of jobs, starting from JobHead, that have been taken by a
+     worker thread.
+     */
+    DWORD JobsDispatched;
+
+    /**
+     A mutex synchronizing the Jobs array between the main thread and
+     worker threads.
+     */
+    HANDLE Mutex;
+
+    /**
+     A manual reset event which is signalled when jobs are available for
+     worker threads or worker threads should exit.
+     */
+    HANDLE WorkAvailableEvent;
+
+    /**
+     An auto reset event which is signalled when a worker thread completes
+     a job.
+     */
+    HANDLE JobCompleteEvent;
+
+    /**
+     The full path to a file containing hashes from previous runs.  If empty,
+     hashes are not cached.
+     */
+    YORI_STRING CacheFileName;
+
+    /**
+     A hash table of cached hashes, or NULL if hashes are not cached.
+     */
+    PYORI_HASH_TABLE Cache;
+
+    /**
+     A list of cached hashes.
+     */
+    YORI_LIST_ENTRY CacheList;
+
+    /**
+     A mutex synchronizing the cache between worker threads.
+     */
+    HANDLE CacheMutex;
+
+    /**
+     TRUE if any cache entry has been added or updated, so the cache file
+     needs to be rewritten.
+     */
+    BOOLEAN CacheChanged;
+
+    /**
+     Records the total number of files processed.
+     */
+    LONGLONG FilesFound;
+
+    /**
+     Records the total number of files processed within a single command line
+     argument.
+     */
+    LONGLONG FilesFoundThisArg;
+
+} HASH_CONTEXT;
+
+/**
+ Prepare to hash a new file.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param Worker Pointer to the worker state of the calling thread.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+HashBegin(
+    __in PHASH_CONTEXT HashContext,
+    __in PHASH_WORKER Worker
+    )
+{
+    switch(HashContext->Backend) {
+        case HashBackendCryptoApi:
+            if (!DllAdvApi32.pCryptCreateHash(HashContext->Provider, HashContext->Algorithm->CryptAlgorithm, 0, 0, &Worker->CryptHash)) {
+                return FALSE;
+            }
+            break;
+        case HashBackendBCrypt:
+            if (!HashContext->BCryptReusable) {
+                if (DllBCrypt.pBCryptCreateHash(HashContext->BCryptProvider, &Worker->BCryptHash, Worker->BCryptHashObject, HashContext->BCryptObjectLength, NULL, 0, 0) < 0) {
+                    Worker->BCryptHash = NULL;
+                    return FALSE;
+                }
+            }
+            break;
+        case HashBackendCrc32c:
+            Worker->Crc32c = 0;
+            break;
+        case HashBackendXxHash64:
+            YoriLibXxHash64Initialize(&Worker->XxHash64, 0);
+            break;
+    }
+
+    return TRUE;
+}
+
+/**
+ Add data to the hash of the current file.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param Worker Pointer to the worker state of the calling thread.
+
+ @param Buffer Pointer to the data to hash.
+
+ @param Length The number of bytes in Buffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+HashUpdate(
+    __in PHASH_CONTEXT HashContext,
+    __in PHASH_WORKER Worker,
+    __in PVOID Buffer,
+    __in DWORD Length
+    )
+{
+    switch(HashContext->Backend) {
+        case HashBackendCryptoApi:
+            if (!DllAdvApi32.pCryptHashData(Worker->CryptHash, Buffer, Length, 0)) {
+                return FALSE;
+            }
+            break;
+        case HashBackendBCrypt:
+            if (DllBCrypt.pBCryptHashData(Worker->BCryptHash, Buffer, Length, 0) < 0) {
+                return FALSE;
+            }
+            break;
+        case HashBackendCrc32c:
+            Worker->Crc32c = YoriLibCrc32c(Worker->Crc32c, Buffer, Length);
+            break;
+        case HashBackendXxHash64:
+            YoriLibXxHash64Update(&Worker->XxHash64, Buffer, Length);
+            break;
+    }
+
+    return TRUE;
+}
+
+/**
+ Complete the hash of the current file, and optionally convert the result to
+ a string.  This must be called after each successful call to HashBegin,
+ including when an error prevents the hash from being used.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param Worker Pointer to the worker state of the calling thread.
+
+ @param HashString Optionally points to a string to update with the hex
+        representation of the hash.  This must be large enough to contain
+        the hash.  If NULL, the hash is discarded.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+HashEnd(
+    __in PHASH_CONTEXT HashContext,
+    __in PHASH_WORKER Worker,
+    __inout_opt PYORI_STRING HashString
+    )
+{
+    DWORD HashLength;
+    DWORDLONG XxHash;
+    DWORD Index;
+    BOOL Result;
+
+    Result = TRUE;
+    switch(HashContext->Backend) {
+        case HashBackendCryptoApi:
+            if (HashString != NULL) {
+                HashLength = HashContext->HashLength;
+                if (!DllAdvApi32.pCryptGetHashParam(Worker->CryptHash, HP_HASHVAL, Worker->HashBuffer, &HashLength, 0)) {
+                    Result = FALSE;
+                }
+            }
+            DllAdvApi32.pCryptDestroyHash(Worker->CryptHash);
+            Worker->CryptHash = 0;
+            break;
+        case HashBackendBCrypt:
+
+            //
+            //  Finishing a reusable hash resets it for the next file, so
+            //  this is needed even if the result is discarded.
+            //
+
+            if (DllBCrypt.pBCryptFinishHash(Worker->BCryptHash, Worker->HashBuffer, HashContext->HashLength, 0) < 0) {
+                Result = FALSE;
+            }
+            if (!HashContext->BCryptReusable) {
+                DllBCrypt.pBCryptDestroyHash(Worker->BCryptHash);
+                Worker->BCryptHash = NULL;
+            }
+            break;
+        case HashBackendCrc32c:
+            for (Index = 0; Index < sizeof(DWORD); Index++) {
+                Worker->HashBuffer[Index] = (UCHAR)(Worker->Crc32c >> ((sizeof(DWORD) - Index - 1) * 8));
+            }
+            break;
+        case HashBackendXxHash64:
+            XxHash = YoriLibXxHash64Finalize(&Worker->XxHash64);
+            for (Index = 0; Index < sizeof(DWORDLONG); Index++) {
+                Worker->HashBuffer[Index] = (UCHAR)(XxHash >> ((sizeof(DWORDLONG) - Index - 1) * 8));
+            }
+            break;
+    }
+
+    if (Result && HashString != NULL) {
+        if (!YoriLibHexBufferToString(Worker->HashBuffer, HashContext->HashLength, HashString)) {
+            Result = FALSE;
+        }
+    }
+
+    return Result;
+}
+
+/**
+ Take a single incoming stream and hash its contents.
+
+ @param hSource A handle to the incoming stream, which may be a file or a
+        pipe.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param Worker Pointer to the worker state of the calling thread.
+
+ @param HashString On successful completion, updated to contain the hex
+        representation of the hash.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+HashProcessStream(
+    __in HANDLE hSource,
+    __in PHASH_CONTEXT HashContext,
+    __in PHASH_WORKER Worker,
+    __inout PYORI_STRING HashString
+    )
+{
+    DWORD Err;
+    DWORD BytesRead;
+
+    if (!HashBegin(HashContext, Worker)) {
+        return FALSE;
+    }
+
+    Err = ERROR_SUCCESS;
+    while (TRUE) {
+        if (!ReadFile(hSource, Worker->ReadBuffer, HashContext->ReadBufferLength, &BytesRead, NULL)) {
+            // MSFIX: Distinguish errors here better? EOF means success,
+            // read error means hash is wrong.  Could be reading from a pipe
+            // etc though
+            break;
+        }
+
+        if (BytesRead == 0) {
+            break;
+        }
+
+        if (!HashUpdate(HashContext, Worker, Worker->ReadBuffer, BytesRead)) {
+            Err = GetLastError();
+            break;
+        }
+
+    }
+
+    if (Err == ERROR_SUCCESS) {
+        if (!HashEnd(HashContext, Worker, HashString)) {
+            Err = !(ERROR_SUCCESS);
+        }
+    } else {
+        HashEnd(HashContext, Worker, NULL);
+    }
+
+    if (Err != STATUS_SUCCESS) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Hash the contents of a file, keeping reads outstanding into several buffers
+ while the contents of another buffer are being hashed.
+
+ @param hSource A handle to the file, opened for overlapped IO.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param Worker Pointer to the worker state of the calling thread.
+
+ @param HashString On successful completion, updated to contain the hex
+        representation of the hash.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+HashProcessOverlappedFile(
+    __in HANDLE hSource,
+    __in PHASH_CONTEXT HashContext,
+    __in PHASH_WORKER Worker,
+    __inout PYORI_STRING HashString
+    )
+{
+    PUCHAR Data;
+    DWORD BytesRead;
+    BOOL Result;
+
+    if (!HashBegin(HashContext, Worker)) {
+        return FALSE;
+    }
+
+    Result = YoriLibAsyncReadBegin(&Worker->AsyncIo, hSource, NULL);
+    while (Result) {
+        Result = YoriLibAsyncRead(&Worker->AsyncIo, &Data, &BytesRead);
+        if (!Result || BytesRead == 0) {
+            break;
+        }
+
+        if (!HashUpdate(HashContext, Worker, Data, BytesRead)) {
+            Result = FALSE;
+        }
+    }
+
+    if (!YoriLibAsyncIoComplete(&Worker->AsyncIo)) {
+        Result = FALSE;
+    }
+
+    if (Result) {
+        if (!HashEnd(HashContext, Worker, HashString)) {
+            Result = FALSE;
+        }
+    } else {
+        HashEnd(HashContext, Worker, NULL);
+    }
+
+    return Result;
+}
+
+/**
+ Query the information used to determine whether a file has changed since it
+ was last hashed.
+
+ @param FileHandle Handle to the file.
+
+ @param Stamp On successful completion, populated with the state of the
+        file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+HashGetFileStamp(
+    __in HANDLE FileHandle,
+    __out PHASH_FILE_STAMP Stamp
+    )
+{
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    struct {
+        USN_RECORD UsnRecord;
+        WCHAR FileName[YORI_LIB_MAX_FILE_NAME];
+    } s1;
+    DWORD BytesReturned;
+
+    if (!GetFileInformationByHandle(FileHandle, &FileInfo)) {
+        return FALSE;
+    }
+
+    Stamp->VolumeSerialNumber = FileInfo.dwVolumeSerialNumber;
+    Stamp->FileId.LowPart = FileInfo.nFileIndexLow;
+    Stamp->FileId.HighPart = FileInfo.nFileIndexHigh;
+    Stamp->FileSize.LowPart = FileInfo.nFileSizeLow;
+    Stamp->FileSize.HighPart = FileInfo.nFileSizeHigh;
+    Stamp->LastWriteTime.LowPart = FileInfo.ftLastWriteTime.dwLowDateTime;
+    Stamp->LastWriteTime.HighPart = FileInfo.ftLastWriteTime.dwHighDateTime;
+
+    //
+    //  Volumes without a change journal fail this, and the remaining fields
+    //  are used to detect changes.
+    //
+
+    Stamp->Usn.QuadPart = 0;
+    if (DeviceIoControl(FileHandle, FSCTL_READ_FILE_USN_DATA, NULL, 0, &s1, sizeof(s1), &BytesReturned, NULL)) {
+        Stamp->Usn.QuadPart = s1.UsnRecord.Usn;
+    }
+
+    return TRUE;
+}
+
+/**
+ Generate the key used to find a file in the hash cache.
+
+ @param Stamp Pointer to the state of the file.
+
+ @param KeyBuffer Pointer to a buffer of HASH_CACHE_KEY_LENGTH + 1
+        characters to store the key.
+
+ @param Key On completion, updated to refer to the key in KeyBuffer.
+ */
+VOID
+HashBuildCacheKey(
+    __in PHASH_FILE_STAMP Stamp,
+    __out_ecount(HASH_CACHE_KEY_LENGTH + 1) LPTSTR KeyBuffer,
+    __out PYORI_STRING Key
+    )
+{
+    YoriLibInitEmptyString(Key);
+    Key->StartOfString = KeyBuffer;
+    Key->LengthInChars = YoriLibSPrintfS(KeyBuffer, HASH_CACHE_KEY_LENGTH + 1, _T("%08x%016llx"), Stamp->VolumeSerialNumber, Stamp->FileId.QuadPart);
+    Key->LengthAllocated = HASH_CACHE_KEY_LENGTH + 1;
+}
+
+/**
+ Look for a file in the hash cache.  If the file has not changed since the
+ cached hash was calculated, return the cached hash.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param Stamp Pointer to the state of the file.
+
+ @param HashString On successful completion, updated to contain the hex
+        representation of the cached hash.
+
+ @return TRUE to indicate the cached hash was returned, FALSE if the file is
+         not in the cache or has changed.
+ */
+__success(return)
+BOOL
+HashLookupCache(
+    __in PHASH_CONTEXT HashContext,
+    __in PHASH_FILE_STAMP Stamp,
+    __inout PYORI_STRING HashString
+    )
+{
+    TCHAR KeyBuffer[HASH_CACHE_KEY_LENGTH + 1];
+    YORI_STRING Key;
+    PYORI_HASH_ENTRY HashEntry;
+    PHASH_CACHE_ENTRY Entry;
+    BOOL Found;
+
+    HashBuildCacheKey(Stamp, KeyBuffer, &Key);
+    Found = FALSE;
+
+    WaitForSingleObject(HashContext->CacheMutex, INFINITE);
+    HashEntry = YoriLibHashLookupByKey(HashContext->Cache, &Key);
+    if (HashEntry != NULL) {
+        Entry = (PHASH_CACHE_ENTRY)HashEntry->Context;
+        if (Entry->Stamp.FileSize.QuadPart == Stamp->FileSize.QuadPart &&
+            Entry->Stamp.LastWriteTime.QuadPart == Stamp->LastWriteTime.QuadPart &&
+            Entry->Stamp.Usn.QuadPart == Stamp->Usn.QuadPart &&
+            Entry->HashString.LengthInChars < HashString->LengthAllocated) {
+
+            memcpy(HashString->StartOfString, Entry->HashString.StartOfString, Entry->HashString.LengthInChars * sizeof(TCHAR));
+            HashString->StartOfString[Entry->HashString.LengthInChars] = '\0';
+            HashString->LengthInChars = Entry->HashString.LengthInChars;
+            Found = TRUE;
+        }
+    }
+    ReleaseMutex(HashContext->CacheMutex);
+
+    return Found;
+}
+
+/**
+ Record the hash of a file in the hash cache, replacing any previous hash
+ for the same file.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param Stamp Pointer to the state of the file when it was hashed.
+
+ @param HashString Pointer to the hex representation of the hash.
+
+ @param Changed TRUE if the cache file should be rewritten to include this
+        entry.  This is FALSE when loading entries from the cache file.
+
+ @return TRUE to indicate the hash was recorded, FALSE to indicate failure.
+ */
+BOOL
+HashUpdateCache(
+    __in PHASH_CONTEXT HashContext,
+    __in PHASH_FILE_STAMP Stamp,
+    __in PCYORI_STRING HashString,
+    __in BOOLEAN Changed
+    )
+{
+    TCHAR KeyBuffer[HASH_CACHE_KEY_LENGTH + 1];
+    YORI_STRING Key;
+    PYORI_HASH_ENTRY HashEntry;
+    PHASH_CACHE_ENTRY Entry;
+
+    if (HashString->LengthInChars != HashContext->HashLength * 2) {
+        return FALSE;
+    }
+
+    HashBuildCacheKey(Stamp, KeyBuffer, &Key);
+
+    WaitForSingleObject(HashContext->CacheMutex, INFINITE);
+    HashEntry = YoriLibHashLookupByKey(HashContext->Cache, &Key);
+    if (HashEntry != NULL) {
+        Entry = (PHASH_CACHE_ENTRY)HashEntry->Context;
+    } else {
+        Entry = YoriLibMalloc(sizeof(HASH_CACHE_ENTRY) + (HashString->LengthInChars + 1) * sizeof(TCHAR));
+        if (Entry == NULL) {
+            ReleaseMutex(HashContext->CacheMutex);
+            return FALSE;
+        }
+
+        ZeroMemory(Entry, sizeof(HASH_CACHE_ENTRY));
+        YoriLibInitEmptyString(&Entry->HashString);
+        Entry->HashString.StartOfString = (LPTSTR)(Entry + 1);
+        Entry->HashString.LengthAllocated = HashString->LengthInChars + 1;
+        memcpy(Entry->KeyBuffer, KeyBuffer, sizeof(KeyBuffer));
+        Key.StartOfString = Entry->KeyBuffer;
+
+        YoriLibHashInsertByKey(HashContext->Cache, &Key, Entry, &Entry->HashEntry);
+        YoriLibAppendList(&HashContext->CacheList, &Entry->ListEntry);
+    }
+
+    memcpy(&Entry->Stamp, Stamp, sizeof(HASH_FILE_STAMP));
+    memcpy(Entry->HashString.StartOfString, HashString->StartOfString, HashString->LengthInChars * sizeof(TCHAR));
+    Entry->HashString.StartOfString[HashString->LengthInChars] = '\0';
+    Entry->HashString.LengthInChars = HashString->LengthInChars;
+    if (Changed) {
+        HashContext->CacheChanged = TRUE;
+    }
+    ReleaseMutex(HashContext->CacheMutex);
+
+    return TRUE;
+}
+
+/**
+ Prepare the hash cache and load any entries from the cache file.  The first
+ line of the cache file names the hash algorithm, and entries are only
+ loaded if it matches the algorithm in use.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @return TRUE to indicate the cache was initialized, FALSE to indicate
+         failure.  A missing or unreadable cache file is not a failure.
+ */
+BOOL
+HashLoadCache(
+    __in PHASH_CONTEXT HashContext
+    )
+{
+    HASH_FILE_STAMP Stamp;
+    PLARGE_INTEGER Fields[4];
+    YORI_STRING LineString;
+    YORI_STRING Remaining;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    YORI_MAX_SIGNED_T llTemp;
+    DWORD Index;
+    HANDLE hCache;
+    PVOID LineContext = NULL;
+
+    YoriLibInitializeListHead(&HashContext->CacheList);
+
+    HashContext->CacheMutex = CreateMutex(NULL, FALSE, NULL);
+    if (HashContext->CacheMutex == NULL) {
+        return FALSE;
+    }
+
+    HashContext->Cache = YoriLibAllocateHashTable(1000);
+    if (HashContext->Cache == NULL) {
+        return FALSE;
+    }
+
+    hCache = CreateFile(HashContext->CacheFileName.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hCache == INVALID_HANDLE_VALUE) {
+        return TRUE;
+    }
+
+    YoriLibInitEmptyString(&LineString);
+
+    if (!YoriLibReadLineToString(&LineString, &LineContext, hCache) ||
+        YoriLibCompareStringLitIns(&LineString, HashContext->Algorithm->Name) != 0) {
+
+        HashContext->CacheChanged = TRUE;
+        YoriLibLineReadCloseOrCache(LineContext);
+        YoriLibFreeStringContents(&LineString);
+        CloseHandle(hCache);
+        return TRUE;
+    }
+
+    Fields[0] = &Stamp.FileId;
+    Fields[1] = &Stamp.FileSize;
+    Fields[2] = &Stamp.LastWriteTime;
+    Fields[3] = &Stamp.Usn;
+
+    while (TRUE) {
+        if (!YoriLibReadLineToString(&LineString, &LineContext, hCache)) {
+            break;
+        }
+
+        //
+        //  The format of each line is expected to be:
+        //  VolumeSerial FileId FileSize LastWriteTime Usn Hash
+        //
+
+        YoriLibInitEmptyString(&Remaining);
+        Remaining.StartOfString = LineString.StartOfString;
+        Remaining.LengthInChars = LineString.LengthInChars;
+
+        if (!YoriLibStringToNumberBase(&Remaining, 16, FALSE, &llTemp, &CharsConsumed) ||
+            CharsConsumed == 0 ||
+            CharsConsumed >= Remaining.LengthInChars ||
+            Remaining.StartOfString[CharsConsumed] != ' ') {
+
+            continue;
+        }
+        Stamp.VolumeSerialNumber = (DWORD)llTemp;
+        Remaining.StartOfString = Remaining.StartOfString + CharsConsumed + 1;
+        Remaining.LengthInChars = Remaining.LengthInChars - CharsConsumed - 1;
+
+        for (Index = 0; Index < sizeof(Fields)/sizeof(Fields[0]); Index++) {
+            if (!YoriLibStringToNumberBase(&Remaining, 16, FALSE, &llTemp, &CharsConsumed) ||
+                CharsConsumed == 0 ||
+                CharsConsumed >= Remaining.LengthInChars ||
+                Remaining.StartOfString[CharsConsumed] != ' ') {
+
+                break;
+            }
+            Fields[Index]->QuadPart = llTemp;
+            Remaining.StartOfString = Remaining.StartOfString + CharsConsumed + 1;
+            Remaining.LengthInChars = Remaining.LengthInChars - CharsConsumed - 1;
+        }
+
+        if (Index < sizeof(Fields)/sizeof(Fields[0])) {
+            continue;
+        }
+
+        HashUpdateCache(HashContext, &Stamp, &Remaining, FALSE);
+    }
+
+    YoriLibLineReadCloseOrCache(LineContext);
+    YoriLibFreeStringContents(&LineString);
+    CloseHandle(hCache);
+    return TRUE;
+}
+
+/**
+ Write the hash cache to the cache file if it has changed, and free all
+ cache entries.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+ */
+VOID
+HashSaveAndDeleteCache(
+    __in PHASH_CONTEXT HashContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PHASH_CACHE_ENTRY Entry;
+    HANDLE hCache;
+
+    if (HashContext->Cache == NULL) {
+        return;
+    }
+
+    hCache = NULL;
+    if (HashContext->CacheChanged) {
+        hCache = CreateFile(HashContext->CacheFileName.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hCache == INVALID_HANDLE_VALUE) {
+            LPTSTR ErrText = YoriLibGetWinErrorText(GetLastError());
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: open of %y failed: %s"), &HashContext->CacheFileName, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            hCache = NULL;
+        } else {
+            YoriLibOutputToDevice(hCache, 0, _T("%s\n"), HashContext->Algorithm->Name);
+        }
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&HashContext->CacheList, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, HASH_CACHE_ENTRY, ListEntry);
+
+        if (hCache != NULL) {
+            YoriLibOutputToDevice(hCache,
+                                  0,
+                                  _T("%08x %016llx %016llx %016llx %016llx %y\n"),
+                                  Entry->Stamp.VolumeSerialNumber,
+                                  Entry->Stamp.FileId.QuadPart,
+                                  Entry->Stamp.FileSize.QuadPart,
+                                  Entry->Stamp.LastWriteTime.QuadPart,
+                                  Entry->Stamp.Usn.QuadPart,
+                                  &Entry->HashString);
+        }
+        YoriLibRemoveListItem(&Entry->ListEntry);
+        YoriLibHashRemoveByEntry(&Entry->HashEntry);
+        YoriLibFree(Entry);
+        ListEntry = YoriLibGetNextListEntry(&HashContext->CacheList, NULL);
+    }
+    YoriLibFreeEmptyHashTable(HashContext->Cache);
+    HashContext->Cache = NULL;
+
+    if (hCache != NULL) {
+        CloseHandle(hCache);
+    }
+}
+
+/**
+ Open a file and hash its contents.  Files large enough to require several
+ reads are reopened for overlapped IO so that reading and hashing can
+ overlap.
+
+ @param FilePath Pointer to the full path to the file, which must be NULL
+        terminated.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param Worker Pointer to the worker state of the calling thread.
+
+ @param HashString On successful completion, updated to contain the hex
+        representation of the hash.
+
+ @param OpenError On completion, set to the Win32 error from opening the
+        file, or ERROR_SUCCESS if the file was opened.
+
+ @return TRUE to indicate the file was hashed, FALSE to indicate failure.
+ */
+BOOL
+HashProcessFile(
+    __in PYORI_STRING FilePath,
+    __in PHASH_CONTEXT HashContext,
+    __in PHASH_WORKER Worker,
+    __inout PYORI_STRING HashString,
+    __out PDWORD OpenError
+    )
+{
+    HANDLE FileHandle;
+    HANDLE OverlappedHandle;
+    DWORD FileSizeLow;
+    DWORD FileSizeHigh;
+    HASH_FILE_STAMP Stamp;
+    BOOL StampValid;
+    BOOL Result;
+
+    *OpenError = ERROR_SUCCESS;
+
+    FileHandle = CreateFile(FilePath->StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
+                            NULL);
+
+    if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
+        *OpenError = GetLastError();
+        return FALSE;
+    }
+
+    //
+    //  If a cached hash exists and the file has not changed since it was
+    //  calculated, use it.  The state is captured before reading so that
+    //  a change during hashing is detected next time.
+    //
+
+    StampValid = FALSE;
+    if (HashContext->Cache != NULL && GetFileType(FileHandle) == FILE_TYPE_DISK) {
+        StampValid = HashGetFileStamp(FileHandle, &Stamp);
+        if (StampValid && HashLookupCache(HashContext, &Stamp, HashString)) {
+            CloseHandle(FileHandle);
+            return TRUE;
+        }
+    }
+
+    //
+    //  If the file is on disk and will take more than two reads, try to
+    //  open it again for overlapped IO.  If that fails for any reason, the
+    //  original handle is still usable for synchronous reads.
+    //
+
+    OverlappedHandle = NULL;
+    if (GetFileType(FileHandle) == FILE_TYPE_DISK) {
+        FileSizeHigh = 0;
+        FileSizeLow = GetFileSize(FileHandle, &FileSizeHigh);
+        if (FileSizeHigh > 0 || FileSizeLow > HashContext->ReadBufferLength * 2) {
+            OverlappedHandle = CreateFile(FilePath->StartOfString,
+                                          GENERIC_READ,
+                                          FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                          NULL,
+                                          OPEN_EXISTING,
+                                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+                                          NULL);
+            if (OverlappedHandle == INVALID_HANDLE_VALUE) {
+                OverlappedHandle = NULL;
+            }
+        }
+    }
+
+    if (OverlappedHandle != NULL) {
+        CloseHandle(FileHandle);
+        Result = HashProcessOverlappedFile(OverlappedHandle, HashContext, Worker, HashString);
+        CloseHandle(OverlappedHandle);
+    } else {
+        Result = HashProcessStream(FileHandle, HashContext, Worker, HashString);
+        CloseHandle(FileHandle);
+    }
+
+    if (Result && StampValid) {
+        HashUpdateCache(HashContext, &Stamp, HashString, TRUE);
+    }
+
+    return Result;
+}
+
+/**
+ Display the result of hashing a file, or the error from opening it.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @param RelativePath Pointer to the path of the file to display.
+
+ @param HashString Pointer to the hex representation of the hash.  This is
+        only meaningful if Succeeded is TRUE.
+
+ @param OpenError The Win32 error from opening the file, or ERROR_SUCCESS if
+        the file was opened.
+
+ @param ReportOpenError TRUE if a failure to open the file should be
+        displayed.
+
+ @param Succeeded TRUE if the file was hashed successfully.
+ */
+VOID
+HashOutputResult(
+    __in PHASH_CONTEXT HashContext,
+    __in PYORI_STRING FilePath,
+    __in PYORI_STRING RelativePath,
+    __in PYORI_STRING HashString,
+    __in DWORD OpenError,
+    __in BOOLEAN ReportOpenError,
+    __in BOOLEAN Succeeded
+    )
+{
+    if (OpenError != ERROR_SUCCESS) {
+        if (ReportOpenError) {
+            LPTSTR ErrText = YoriLibGetWinErrorText(OpenError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: open of %y failed: %s"), FilePath, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+        }
+        return;
+    }
+
+    HashContext->FilesFound++;
+
+    if (Succeeded) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y\n"), HashString, RelativePath);
+    }
+}
+
+/**
+ Output the results of completed jobs in the order they were queued, until
+ no more than a specified number of jobs remain queued.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param MaximumOutstanding The number of jobs that can remain queued when this
+        function returns.  If more than this number of jobs are queued, this
+        function waits for workers to complete them.
+ */
+VOID
+HashRetireJobs(
+    __in PHASH_CONTEXT HashContext,
+    __in DWORD MaximumOutstanding
+    )
+{
+    PHASH_JOB Job;
+    YORI_STRING RelativePath;
+    BOOLEAN Done;
+
+    while (TRUE) {
+        WaitForSingleObject(HashContext->Mutex, INFINITE);
+        Job = NULL;
+        Done = FALSE;
+        if (HashContext->JobCount > 0 && HashContext->Jobs[HashContext->JobHead].Complete) {
+            Job = &HashContext->Jobs[HashContext->JobHead];
+        } else if (HashContext->JobCount <= MaximumOutstanding) {
+            Done = TRUE;
+        }
+        ReleaseMutex(HashContext->Mutex);
+
+        if (Done) {
+            break;
+        }
+
+        if (Job == NULL) {
+            WaitForSingleObject(HashContext->JobCompleteEvent, INFINITE);
+            continue;
+        }
+
+        //
+        //  Workers do not touch completed jobs, so the job can be output
+        //  without holding the mutex.
+        //
+
+        YoriLibInitEmptyString(&RelativePath);
+        RelativePath.StartOfString = &Job->FilePath.StartOfString[Job->RelativePathOffset];
+        RelativePath.LengthInChars = Job->FilePath.LengthInChars - Job->RelativePathOffset;
+
+        HashOutputResult(HashContext,
+                         &Job->FilePath,
+                         &RelativePath,
+                         &Job->HashString,
+                         Job->OpenError,
+                         Job->ReportOpenError,
+                         Job->Succeeded);
+
+        WaitForSingleObject(HashContext->Mutex, INFINITE);
+        Job->Complete = FALSE;
+        HashContext->JobHead = (HashContext->JobHead + 1) % HashContext->JobsAllocated;
+        HashContext->JobCount--;
+        HashContext->JobsDispatched--;
+        ReleaseMutex(HashContext->Mutex);
+    }
+}
+
+/**
+ Queue a file to be hashed by a worker thread.  If the queue is full, this
+ waits for the oldest queued file to be hashed and output.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @param RelativePathOffset The offset in characters within FilePath of the
+        path to display.
+
+ @return TRUE to indicate the file was queued, FALSE to indicate failure.
+ */
+BOOL
+HashQueueFile(
+    __in PHASH_CONTEXT HashContext,
+    __in PYORI_STRING FilePath,
+    __in YORI_ALLOC_SIZE_T RelativePathOffset
+    )
+{
+    PHASH_JOB Job;
+    YORI_ALLOC_SIZE_T LengthNeeded;
+
+    HashRetireJobs(HashContext, HashContext->JobsAllocated - 1);
+
+    //
+    //  Only this thread adds jobs, and workers only look at jobs within
+    //  JobCount, so the free slot can be filled without the mutex.
+    //
+
+    Job = &HashContext->Jobs[(HashContext->JobHead + HashContext->JobCount) % HashContext->JobsAllocated];
+
+    LengthNeeded = FilePath->LengthInChars + 1;
+    if (Job->FilePath.LengthAllocated < LengthNeeded) {
+        if (LengthNeeded < MAX_PATH) {
+            LengthNeeded = MAX_PATH;
+        }
+        YoriLibFreeStringContents(&Job->FilePath);
+        if (!YoriLibAllocateString(&Job->FilePath, LengthNeeded)) {
+            return FALSE;
+        }
+    }
+
+    memcpy(Job->FilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    Job->FilePath.StartOfString[FilePath->LengthInChars] = '\0';
+    Job->FilePath.LengthInChars = FilePath->LengthInChars;
+    Job->RelativePathOffset = RelativePathOffset;
+    Job->OpenError = ERROR_SUCCESS;
+    Job->Succeeded = FALSE;
+    Job->ReportOpenError = FALSE;
+    if (HashContext->SavedErrorThisArg == ERROR_SUCCESS) {
+        Job->ReportOpenError = TRUE;
+    }
+
+    WaitForSingleObject(HashContext->Mutex, INFINITE);
+    HashContext->JobCount++;
+    ReleaseMutex(HashContext->Mutex);
+    SetEvent(HashContext->WorkAvailableEvent);
+
+    //
+    //  Output any results that are ready so output keeps pace with
+    //  enumeration.
+    //
+
+    HashRetireJobs(HashContext, HashContext->JobsAllocated);
+    return TRUE;
+}
+
+/**
+ A worker thread that hashes queued files until told to exit.
+
+ @param Context Pointer to the worker state for this thread.
+
+ @return Thread exit code, which is always zero.
+ */
+DWORD WINAPI
+HashWorkerThread(
+    __in LPVOID Context
+    )
+{
+    PHASH_WORKER Worker;
+    PHASH_CONTEXT HashContext;
+    PHASH_JOB Job;
+
+    Worker = (PHASH_WORKER)Context;
+    HashContext = Worker->HashContext;
+
+    while (TRUE) {
+        WaitForSingleObject(HashContext->Mutex, INFINITE);
+        if (HashContext->JobsDispatched < HashContext->JobCount) {
+            Job = &HashContext->Jobs[(HashContext->JobHead + HashContext->JobsDispatched) % HashContext->JobsAllocated];
+            HashContext->JobsDispatched++;
+            ReleaseMutex(HashContext->Mutex);
+
+            Job->Succeeded = (BOOLEAN)HashProcessFile(&Job->FilePath, HashContext, Worker, &Job->HashString, &Job->OpenError);
+
+            WaitForSingleObject(HashContext->Mutex, INFINITE);
+            Job->Complete = TRUE;
+            ReleaseMutex(HashContext->Mutex);
+            SetEvent(HashContext->JobCompleteEvent);
+            continue;
+        }
+
+        if (HashContext->Shutdown) {
+            ReleaseMutex(HashContext->Mutex);
+            break;
+        }
+
+        ResetEvent(HashContext->WorkAvailableEvent);
+        ReleaseMutex(HashContext->Mutex);
+        WaitForSingleObject(HashContext->WorkAvailableEvent, INFINITE);
+    }
+
+    return 0;
+}
+
+/**
+ A callback that is invoked when a file is found within the tree root whose
+ hash is requested.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.  This can be NULL if the file
+        was not found by enumeration.
+
+ @param Depth Indicates the recursion depth.
+
+ @param Context Pointer to a context block specifying the hash to generate.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+HashFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in_opt PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PHASH_CONTEXT HashContext = (PHASH_CONTEXT)Context;
+    YORI_STRING RelativePathFrom;
+    YORI_ALLOC_SIZE_T SlashesFound;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD OpenError;
+    BOOL Succeeded;
+    BOOLEAN ReportOpenError;
+
+    UNREFERENCED_PARAMETER(FileInfo);
+
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+
+    YoriLibInitEmptyString(&RelativePathFrom);
+
+    SlashesFound = 0;
+    for (Index = FilePath->LengthInChars; Index > 0; Index--) {
+        if (FilePath->StartOfString[Index - 1] == '\\') {
+            SlashesFound++;
+            if (SlashesFound == Depth + 1) {
+                break;
+            }
+        }
+    }
+
+    ASSERT(Index > 0);
+    ASSERT(SlashesFound == Depth + 1);
+
+    //
+    //  When hashing in parallel, the file is assumed to be openable so
+    //  that the literal fallback is not attempted, and any error is
+    //  reported when the job is output.
+    //
+
+    if (HashContext->WorkerCount > 0) {
+        HashContext->FilesFoundThisArg++;
+        if (!HashQueueFile(HashContext, FilePath, Index)) {
+            return FALSE;
+        }
+        HashContext->SavedErrorThisArg = ERROR_SUCCESS;
+        return TRUE;
+    }
+
+    RelativePathFrom.StartOfString = &FilePath->StartOfString[Index];
+    RelativePathFrom.LengthInChars = FilePath->LengthInChars - Index;
+
+    ReportOpenError = FALSE;
+    if (HashContext->SavedErrorThisArg == ERROR_SUCCESS) {
+        ReportOpenError = TRUE;
+    }
+
+    Succeeded = HashProcessFile(FilePath, HashContext, &HashContext->MainWorker, &HashContext->HashString, &OpenError);
+    if (OpenError == ERROR_SUCCESS) {
+        HashContext->FilesFoundThisArg++;
+        HashContext->SavedErrorThisArg = ERROR_SUCCESS;
+    }
+
+    HashOutputResult(HashContext,
+                     FilePath,
+                     &RelativePathFrom,
+                     &HashContext->HashString,
+                     OpenError,
+                     ReportOpenError,
+                     (BOOLEAN)Succeeded);
+
+    return TRUE;
+}
+
+/**
+ Free the buffers and events used by a worker.  The worker itself is not
+ freed.
+
+ @param Worker Pointer to the worker to clean up.
+ */
+VOID
+HashCleanupWorker(
+    __in PHASH_WORKER Worker
+    )
+{
+    if (Worker->BCryptHash != NULL) {
+        DllBCrypt.pBCryptDestroyHash(Worker->BCryptHash);
+        Worker->BCryptHash = NULL;
+    }
+
+    if (Worker->BCryptHashObject != NULL) {
+        YoriLibFree(Worker->BCryptHashObject);
+        Worker->BCryptHashObject = NULL;
+    }
 
-    /**
-     Records the total number of files processed within a single command line
-     argument.
-     */
-    LONGLONG FilesFoundThisArg;
+    if (Worker->HashBuffer != NULL) {
+        YoriLibFree(Worker->HashBuffer);
+        Worker->HashBuffer = NULL;
+    }
 
-} HASH_CONTEXT, *PHASH_CONTEXT;
+    if (Worker->ReadBuffer != NULL) {
+        YoriLibFree(Worker->ReadBuffer);
+        Worker->ReadBuffer = NULL;
+    }
+
+    YoriLibAsyncIoCleanup(&Worker->AsyncIo);
+}
 
 /**
- Take a single incoming stream and break it into pieces.
+ Allocate the buffers and events used by a worker.
 
- @param hSource A handle to the incoming stream, which may be a file or a
-        pipe.
- 
- @param HashContext Pointer to a context describing the actions to perform.
+ @param HashContext Pointer to the hash context, which specifies the size of
+        the buffers to allocate.
+
+ @param Worker Pointer to the worker to initialize.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-HashProcessStream(
-    __in HANDLE hSource,
-    __in PHASH_CONTEXT HashContext
+HashInitializeWorker(
+    __in PHASH_CONTEXT HashContext,
+    __out PHASH_WORKER Worker
     )
 {
-    DWORD Err;
-    DWORD_PTR hHash;
-    DWORD BytesRead;
+    ZeroMemory(Worker, sizeof(HASH_WORKER));
+    Worker->HashContext = HashContext;
 
-    HashContext->FilesFound++;
-    HashContext->FilesFoundThisArg++;
+    Worker->HashBuffer = YoriLibMalloc(HashContext->HashLength);
+    if (Worker->HashBuffer == NULL) {
+        HashCleanupWorker(Worker);
+        return FALSE;
+    }
 
-    if (!DllAdvApi32.pCryptCreateHash(HashContext->Provider, HashContext->Algorithm, 0, 0, &hHash)) {
+    Worker->ReadBuffer = YoriLibMalloc(HashContext->ReadBufferLength);
+    if (Worker->ReadBuffer == NULL) {
+        HashCleanupWorker(Worker);
         return FALSE;
     }
 
+    if (!YoriLibAsyncIoInitialize(&Worker->AsyncIo, 0, HashContext->ReadBufferLength)) {
+        HashCleanupWorker(Worker);
+        return FALSE;
+    }
 
-    Err = ERROR_SUCCESS;
-    while (TRUE) {
-        if (!ReadFile(hSource, HashContext->ReadBuffer, HashContext->ReadBufferLength, &BytesRead, NULL)) {
-            // MSFIX: Distinguish errors here better? EOF means success,
-            // read error means hash is wrong.  Could be reading from a pipe
-            // etc though
-            break;
-        }
+    //
+    //  BCrypt requires the caller to provide memory for hash objects.  If
+    //  hash objects are reusable, create one now to use for every file.
+    //
 
-        if (BytesRead == 0) {
-            break;
+    if (HashContext->Backend == HashBackendBCrypt) {
+        Worker->BCryptHashObject = YoriLibMalloc(HashContext->BCryptObjectLength);
+        if (Worker->BCryptHashObject == NULL) {
+            HashCleanupWorker(Worker);
+            return FALSE;
         }
 
-        if (!DllAdvApi32.pCryptHashData(hHash, HashContext->ReadBuffer, BytesRead, 0)) {
-            Err = GetLastError();
-            break;
+        if (HashContext->BCryptReusable) {
+            if (DllBCrypt.pBCryptCreateHash(HashContext->BCryptProvider,
+                                            &Worker->BCryptHash,
+                                            Worker->BCryptHashObject,
+                                            HashContext->BCryptObjectLength,
+                                            NULL,
+                                            0,
+                                            BCRYPT_HASH_REUSABLE_FLAG) < 0) {
+
+                Worker->BCryptHash = NULL;
+                HashCleanupWorker(Worker);
+                return FALSE;
+            }
         }
+    }
+
+    return TRUE;
+}
+
+/**
+ Wait for all queued files to be output, stop all worker threads, and free
+ the state used to hash in parallel.
+
+ @param HashContext Pointer to the hash context.
+ */
+VOID
+HashStopWorkers(
+    __in PHASH_CONTEXT HashContext
+    )
+{
+    DWORD Index;
 
+    if (HashContext->Jobs != NULL && HashContext->WorkerCount > 0) {
+        HashRetireJobs(HashContext, 0);
+        WaitForSingleObject(HashContext->Mutex, INFINITE);
+        HashContext->Shutdown = TRUE;
+        ReleaseMutex(HashContext->Mutex);
+        SetEvent(HashContext->WorkAvailableEvent);
     }
 
-    if (Err == ERROR_SUCCESS) {
-        DWORD HashLength;
-        HashLength = HashContext->HashLength;
-        if (DllAdvApi32.pCryptGetHashParam(hHash, HP_HASHVAL, HashContext->HashBuffer, &HashLength, 0)) {
-            if (!YoriLibHexBufferToString(HashContext->HashBuffer, HashContext->HashLength, &HashContext->HashString)) {
-                Err = !(ERROR_SUCCESS);
+    if (HashContext->Workers != NULL) {
+        for (Index = 0; Index < HashContext->WorkerCount; Index++) {
+            if (HashContext->Workers[Index].Thread != NULL) {
+                WaitForSingleObject(HashContext->Workers[Index].Thread, INFINITE);
+                CloseHandle(HashContext->Workers[Index].Thread);
             }
+            HashCleanupWorker(&HashContext->Workers[Index]);
         }
+        YoriLibFree(HashContext->Workers);
+        HashContext->Workers = NULL;
     }
+    HashContext->WorkerCount = 0;
 
-    DllAdvApi32.pCryptDestroyHash(hHash);
+    if (HashContext->Jobs != NULL) {
+        for (Index = 0; Index < HashContext->JobsAllocated; Index++) {
+            YoriLibFreeStringContents(&HashContext->Jobs[Index].FilePath);
+            YoriLibFreeStringContents(&HashContext->Jobs[Index].HashString);
+        }
+        YoriLibFree(HashContext->Jobs);
+        HashContext->Jobs = NULL;
+    }
+    HashContext->JobsAllocated = 0;
 
-    if (Err != STATUS_SUCCESS) {
-        return FALSE;
+    if (HashContext->Mutex != NULL) {
+        CloseHandle(HashContext->Mutex);
+        HashContext->Mutex = NULL;
     }
 
-    return TRUE;
+    if (HashContext->WorkAvailableEvent != NULL) {
+        CloseHandle(HashContext->WorkAvailableEvent);
+        HashContext->WorkAvailableEvent = NULL;
+    }
+
+    if (HashContext->JobCompleteEvent != NULL) {
+        CloseHandle(HashContext->JobCompleteEvent);
+        HashContext->JobCompleteEvent = NULL;
+    }
 }
 
 /**
- A callback that is invoked when a file is found within the tree root whose
- hash is requested.
-
- @param FilePath Pointer to the file path that was found.
-
- @param FileInfo Information about the file.  This can be NULL if the file
-        was not found by enumeration.
+ Start worker threads to hash files in parallel.  If this fails, files
+ are hashed by the main thread.
 
- @param Depth Indicates the recursion depth.
+ @param HashContext Pointer to the hash context, which has already been
+        initialized with HashInitializeContext.
 
- @param Context Pointer to a context block specifying the hash to generate.
+ @param WorkerCount The number of worker threads to start.
 
- @return TRUE to continute enumerating, FALSE to abort.
+ @return TRUE to indicate at least one worker thread was started, FALSE if
+         none were.
  */
 BOOL
-HashFileFoundCallback(
-    __in PYORI_STRING FilePath,
-    __in_opt PWIN32_FIND_DATA FileInfo,
-    __in DWORD Depth,
-    __in PVOID Context
+HashStartWorkers(
+    __in PHASH_CONTEXT HashContext,
+    __in DWORD WorkerCount
     )
 {
-    PHASH_CONTEXT HashContext = (PHASH_CONTEXT)Context;
-    YORI_STRING RelativePathFrom;
-    HANDLE FileHandle;
-    YORI_ALLOC_SIZE_T SlashesFound;
-    YORI_ALLOC_SIZE_T Index;
+    DWORD Index;
+    DWORD ThreadId;
+    DWORD JobsAllocated;
 
-    UNREFERENCED_PARAMETER(FileInfo);
+    ASSERT(WorkerCount <= HASH_MAX_WORKERS);
 
-    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+    HashContext->Mutex = CreateMutex(NULL, FALSE, NULL);
+    HashContext->WorkAvailableEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    HashContext->JobCompleteEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (HashContext->Mutex == NULL ||
+        HashContext->WorkAvailableEvent == NULL ||
+        HashContext->JobCompleteEvent == NULL) {
 
-    YoriLibInitEmptyString(&RelativePathFrom);
+        HashStopWorkers(HashContext);
+        return FALSE;
+    }
 
-    SlashesFound = 0;
-    for (Index = FilePath->LengthInChars; Index > 0; Index--) {
-        if (FilePath->StartOfString[Index - 1] == '\\') {
-            SlashesFound++;
-            if (SlashesFound == Depth + 1) {
-                break;
-            }
-        }
+    JobsAllocated = WorkerCount * HASH_JOBS_PER_WORKER;
+    HashContext->Jobs = YoriLibMalloc(JobsAllocated * sizeof(HASH_JOB));
+    if (HashContext->Jobs == NULL) {
+        HashStopWorkers(HashContext);
+        return FALSE;
     }
+    ZeroMemory(HashContext->Jobs, JobsAllocated * sizeof(HASH_JOB));
+    HashContext->JobsAllocated = JobsAllocated;
 
-    ASSERT(Index > 0);
-    ASSERT(SlashesFound == Depth + 1);
+    for (Index = 0; Index < JobsAllocated; Index++) {
+        if (!YoriLibAllocateString(&HashContext->Jobs[Index].HashString, HashContext->HashLength * 2 + 1)) {
+            HashStopWorkers(HashContext);
+            return FALSE;
+        }
+    }
 
-    RelativePathFrom.StartOfString = &FilePath->StartOfString[Index];
-    RelativePathFrom.LengthInChars = FilePath->LengthInChars - Index;
+    HashContext->Workers = YoriLibMalloc(WorkerCount * sizeof(HASH_WORKER));
+    if (HashContext->Workers == NULL) {
+        HashStopWorkers(HashContext);
+        return FALSE;
+    }
 
-    FileHandle = CreateFile(FilePath->StartOfString,
-                            GENERIC_READ,
-                            FILE_SHARE_READ | FILE_SHARE_DELETE,
-                            NULL,
-                            OPEN_EXISTING,
-                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
-                            NULL);
+    HashContext->JobHead = 0;
+    HashContext->JobCount = 0;
+    HashContext->JobsDispatched = 0;
+    HashContext->Shutdown = FALSE;
 
-    if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
-        if (HashContext->SavedErrorThisArg == ERROR_SUCCESS) {
-            DWORD LastError = GetLastError();
-            LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: open of %y failed: %s"), FilePath, ErrText);
-            YoriLibFreeWinErrorText(ErrText);
+    for (Index = 0; Index < WorkerCount; Index++) {
+        if (!HashInitializeWorker(HashContext, &HashContext->Workers[Index])) {
+            break;
         }
-        return TRUE;
+        HashContext->Workers[Index].Thread = CreateThread(NULL, 0, HashWorkerThread, &HashContext->Workers[Index], 0, &ThreadId);
+        if (HashContext->Workers[Index].Thread == NULL) {
+            HashCleanupWorker(&HashContext->Workers[Index]);
+            break;
+        }
+        HashContext->WorkerCount++;
     }
 
-    HashContext->SavedErrorThisArg = ERROR_SUCCESS;
-
-    if (HashProcessStream(FileHandle, HashContext)) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y\n"), &HashContext->HashString, &RelativePathFrom);
+    if (HashContext->WorkerCount == 0) {
+        HashStopWorkers(HashContext);
+        return FALSE;
     }
 
-    CloseHandle(FileHandle);
     return TRUE;
 }
 
-
 /**
  Cleanup any internal allocations within the hash context.  The context
  itself is a stack allocation and is not freed.
@@ -291,15 +1825,15 @@ HashCleanupContext(
 {
     BOOL Result;
 
-    if (HashContext->HashBuffer != NULL) {
-        YoriLibFree(HashContext->HashBuffer);
-        HashContext->HashBuffer = NULL;
-    }
+    HashStopWorkers(HashContext);
+    HashCleanupWorker(&HashContext->MainWorker);
+    HashSaveAndDeleteCache(HashContext);
 
-    if (HashContext->ReadBuffer != NULL) {
-        YoriLibFree(HashContext->ReadBuffer);
-        HashContext->ReadBuffer = NULL;
+    if (HashContext->CacheMutex != NULL) {
+        CloseHandle(HashContext->CacheMutex);
+        HashContext->CacheMutex = NULL;
     }
+    YoriLibFreeStringContents(&HashContext->CacheFileName);
 
     YoriLibFreeStringContents(&HashContext->HashString);
 
@@ -308,6 +1842,11 @@ HashCleanupContext(
         ASSERT(Result);
         HashContext->Provider = 0;
     }
+
+    if (HashContext->BCryptProvider != NULL) {
+        DllBCrypt.pBCryptCloseAlgorithmProvider(HashContext->BCryptProvider, 0);
+        HashContext->BCryptProvider = NULL;
+    }
 }
 
 /**
@@ -345,20 +1884,90 @@ CONST HASH_ACQUIRE_CONFIG HashAcquireConfigOptions[] = {
 };
 
 /**
- Allocate any internal allocations within the hash context needed for the
- specified hash algorithm.
+ Attempt to use BCrypt to calculate the hash.  BCrypt is available on Vista
+ and later.  Where it supports reusable hash objects, which is Windows 8 and
+ later, a hash object is created once per thread rather than once per file.
 
- @param HashContext Pointer to the hash context to initialize.
+ @param HashContext Pointer to the hash context to initialize.  The algorithm
+        has already been specified.
+
+ @return TRUE to indicate BCrypt will be used, FALSE if it is not available.
+ */
+BOOL
+HashInitializeBCrypt(
+    __in PHASH_CONTEXT HashContext
+    )
+{
+    DWORD Length;
+    DWORD BytesReturned;
+
+    if (HashContext->Algorithm->BCryptAlgorithm == NULL) {
+        return FALSE;
+    }
+
+    YoriLibLoadBCryptFunctions();
+    if (DllBCrypt.pBCryptCloseAlgorithmProvider == NULL ||
+        DllBCrypt.pBCryptCreateHash == NULL ||
+        DllBCrypt.pBCryptDestroyHash == NULL ||
+        DllBCrypt.pBCryptFinishHash == NULL ||
+        DllBCrypt.pBCryptGetProperty == NULL ||
+        DllBCrypt.pBCryptHashData == NULL ||
+        DllBCrypt.pBCryptOpenAlgorithmProvider == NULL) {
+
+        return FALSE;
+    }
+
+    HashContext->BCryptReusable = TRUE;
+    if (DllBCrypt.pBCryptOpenAlgorithmProvider(&HashContext->BCryptProvider,
+                                               HashContext->Algorithm->BCryptAlgorithm,
+                                               MS_PRIMITIVE_PROVIDER,
+                                               BCRYPT_HASH_REUSABLE_FLAG) < 0) {
+
+        HashContext->BCryptReusable = FALSE;
+        if (DllBCrypt.pBCryptOpenAlgorithmProvider(&HashContext->BCryptProvider,
+                                                   HashContext->Algorithm->BCryptAlgorithm,
+                                                   MS_PRIMITIVE_PROVIDER,
+                                                   0) < 0) {
+
+            HashContext->BCryptProvider = NULL;
+            return FALSE;
+        }
+    }
+
+    if (DllBCrypt.pBCryptGetProperty(HashContext->BCryptProvider, BCRYPT_OBJECT_LENGTH, (PUCHAR)&Length, sizeof(Length), &BytesReturned, 0) < 0 ||
+        !YoriLibIsSizeAllocatable(Length)) {
+
+        DllBCrypt.pBCryptCloseAlgorithmProvider(HashContext->BCryptProvider, 0);
+        HashContext->BCryptProvider = NULL;
+        return FALSE;
+    }
+    HashContext->BCryptObjectLength = Length;
 
- @param Algorithm Specifies a CALG_* algorithm indicating the algorithm to
-        initialize.
+    if (DllBCrypt.pBCryptGetProperty(HashContext->BCryptProvider, BCRYPT_HASH_LENGTH, (PUCHAR)&Length, sizeof(Length), &BytesReturned, 0) < 0 ||
+        !YoriLibIsSizeAllocatable(Length)) {
+
+        DllBCrypt.pBCryptCloseAlgorithmProvider(HashContext->BCryptProvider, 0);
+        HashContext->BCryptProvider = NULL;
+        return FALSE;
+    }
+    HashContext->HashLength = (YORI_ALLOC_SIZE_T)Length;
+    HashContext->Backend = HashBackendBCrypt;
+
+    return TRUE;
+}
+
+/**
+ Use the CryptoAPI to calculate the hash.  This is available on NT 4 and
+ later.
+
+ @param HashContext Pointer to the hash context to initialize.  The algorithm
+        has already been specified.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-HashInitializeContext(
-    __in PHASH_CONTEXT HashContext,
-    __in DWORD Algorithm
+HashInitializeCryptoApi(
+    __in PHASH_CONTEXT HashContext
     )
 {
     DWORD_PTR hHash;
@@ -367,6 +1976,18 @@ HashInitializeContext(
     DWORD Index;
     DWORD HashLength;
 
+    YoriLibLoadAdvApi32Functions();
+    if (DllAdvApi32.pCryptAcquireContextW == NULL ||
+        DllAdvApi32.pCryptCreateHash == NULL ||
+        DllAdvApi32.pCryptDestroyHash == NULL ||
+        DllAdvApi32.pCryptGetHashParam == NULL ||
+        DllAdvApi32.pCryptHashData == NULL ||
+        DllAdvApi32.pCryptReleaseContext == NULL) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: operating system support not present\n"));
+        return FALSE;
+    }
+
     LastError = ERROR_SUCCESS;
 
     //
@@ -409,13 +2030,11 @@ HashInitializeContext(
         ErrText = YoriLibGetWinErrorText(LastError);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: algorithm provider not functional: %s\n"), ErrText);
         YoriLibFreeWinErrorText(ErrText);
-        HashCleanupContext(HashContext);
         return FALSE;
     }
 
-    if (!DllAdvApi32.pCryptCreateHash(HashContext->Provider, Algorithm, 0, 0, &hHash)) {
+    if (!DllAdvApi32.pCryptCreateHash(HashContext->Provider, HashContext->Algorithm->CryptAlgorithm, 0, 0, &hHash)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: operating system support not present\n"));
-        HashCleanupContext(HashContext);
         return FALSE;
     }
 
@@ -426,7 +2045,6 @@ HashInitializeContext(
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: could not determine hash length: %s\n"), ErrText);
             YoriLibFreeWinErrorText(ErrText);
             DllAdvApi32.pCryptDestroyHash(hHash);
-            HashCleanupContext(HashContext);
             return FALSE;
         }
     }
@@ -434,19 +2052,44 @@ HashInitializeContext(
     if (!YoriLibIsSizeAllocatable(HashLength)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: hash length %i too large\n"), HashLength);
         DllAdvApi32.pCryptDestroyHash(hHash);
-        HashCleanupContext(HashContext);
         return FALSE;
     }
     HashContext->HashLength = (YORI_ALLOC_SIZE_T)HashLength;
 
     DllAdvApi32.pCryptDestroyHash(hHash);
 
-    HashContext->Algorithm = Algorithm;
+    HashContext->Backend = HashBackendCryptoApi;
+    return TRUE;
+}
 
-    HashContext->HashBuffer = YoriLibMalloc(HashContext->HashLength);
-    if (HashContext->HashBuffer == NULL) {
-        HashCleanupContext(HashContext);
-        return FALSE;
+/**
+ Allocate any internal allocations within the hash context needed for the
+ specified hash algorithm.
+
+ @param HashContext Pointer to the hash context to initialize.
+
+ @param Algorithm Pointer to the algorithm to initialize.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+HashInitializeContext(
+    __in PHASH_CONTEXT HashContext,
+    __in PCHASH_ALGORITHM Algorithm
+    )
+{
+    HashContext->Algorithm = Algorithm;
+    HashContext->Backend = Algorithm->Backend;
+
+    if (HashContext->Backend == HashBackendCrc32c) {
+        HashContext->HashLength = sizeof(DWORD);
+    } else if (HashContext->Backend == HashBackendXxHash64) {
+        HashContext->HashLength = sizeof(DWORDLONG);
+    } else if (!HashInitializeBCrypt(HashContext)) {
+        if (!HashInitializeCryptoApi(HashContext)) {
+            HashCleanupContext(HashContext);
+            return FALSE;
+        }
     }
 
     if (!YoriLibAllocateString(&HashContext->HashString, HashContext->HashLength * 2 + 1)) {
@@ -456,8 +2099,7 @@ HashInitializeContext(
 
     HashContext->ReadBufferLength = YoriLibMaximumAllocationInRange(60 * 1024, 1024 * 1024);
 
-    HashContext->ReadBuffer = YoriLibMalloc(HashContext->ReadBufferLength);
-    if (HashContext->ReadBuffer == NULL) {
+    if (!HashInitializeWorker(HashContext, &HashContext->MainWorker)) {
         HashCleanupContext(HashContext);
         return FALSE;
     }
@@ -561,9 +2203,21 @@ ENTRYPOINT(
     BOOLEAN BasicEnumeration = FALSE;
     HASH_CONTEXT HashContext;
     YORI_STRING Arg;
-    DWORD Algorithm = CALG_SHA1;
+    PCHASH_ALGORITHM Algorithm;
+    DWORD Index;
+    DWORD WorkerCount = 0;
+    YORI_MAX_SIGNED_T llTemp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
 
     ZeroMemory(&HashContext, sizeof(HashContext));
+    Algorithm = NULL;
+    for (Index = 0; Index < sizeof(HashAlgorithms)/sizeof(HashAlgorithms[0]); Index++) {
+        if (HashAlgorithms[Index].CryptAlgorithm == CALG_SHA1) {
+            Algorithm = &HashAlgorithms[Index];
+            break;
+        }
+    }
+    ASSERT(Algorithm != NULL);
 
     for (i = 1; i < ArgC; i++) {
 
@@ -580,38 +2234,44 @@ ENTRYPOINT(
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("a")) == 0) {
                 if (i + 1 < ArgC) {
-                    if (YoriLibCompareStringLitIns(&ArgV[i + 1], _T("MD4")) == 0) {
-                        ArgumentUnderstood = TRUE;
-                        i++;
-                        Algorithm = CALG_MD4;
-                    } else if (YoriLibCompareStringLitIns(&ArgV[i + 1], _T("MD5")) == 0) {
-                        ArgumentUnderstood = TRUE;
-                        i++;
-                        Algorithm = CALG_MD5;
-                    } else if (YoriLibCompareStringLitIns(&ArgV[i + 1], _T("SHA1")) == 0) {
-                        ArgumentUnderstood = TRUE;
-                        i++;
-                        Algorithm = CALG_SHA1;
-                    } else if (YoriLibCompareStringLitIns(&ArgV[i + 1], _T("SHA256")) == 0) {
-                        ArgumentUnderstood = TRUE;
-                        i++;
-                        Algorithm = CALG_SHA_256;
-                    } else if (YoriLibCompareStringLitIns(&ArgV[i + 1], _T("SHA384")) == 0) {
-                        ArgumentUnderstood = TRUE;
-                        i++;
-                        Algorithm = CALG_SHA_384;
-                    } else if (YoriLibCompareStringLitIns(&ArgV[i + 1], _T("SHA512")) == 0) {
-                        ArgumentUnderstood = TRUE;
-                        i++;
-                        Algorithm = CALG_SHA_512;
-                    } else {
-                        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: algorithm not recognized.  Supported algorithms are MD4, MD5, SHA1, SHA256, SHA384, and SHA512\n"));
+                    for (Index = 0; Index < sizeof(HashAlgorithms)/sizeof(HashAlgorithms[0]); Index++) {
+                        if (YoriLibCompareStringLitIns(&ArgV[i + 1], HashAlgorithms[Index].Name) == 0) {
+                            Algorithm = &HashAlgorithms[Index];
+                            break;
+                        }
+                    }
+                    if (Index == sizeof(HashAlgorithms)/sizeof(HashAlgorithms[0])) {
+                        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: algorithm not recognized.  Supported algorithms are CRC32C, MD4, MD5, SHA1, SHA256, SHA384, SHA512, and XXH64\n"));
                         return EXIT_FAILURE;
                     }
+                    ArgumentUnderstood = TRUE;
+                    i++;
                 }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("cache")) == 0) {
+                if (i + 1 < ArgC) {
+                    YoriLibFreeStringContents(&HashContext.CacheFileName);
+                    if (YoriLibUserStringToSingleFilePath(&ArgV[i + 1], TRUE, &HashContext.CacheFileName)) {
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (i + 1 < ArgC) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], FALSE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        llTemp > 0) {
+
+                        WorkerCount = HASH_MAX_WORKERS;
+                        if (llTemp < HASH_MAX_WORKERS) {
+                            WorkerCount = (DWORD)llTemp;
+                        }
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 HashContext.Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -631,20 +2291,15 @@ ENTRYPOINT(
         }
     }
 
-    YoriLibLoadAdvApi32Functions();
-    if (DllAdvApi32.pCryptAcquireContextW == NULL ||
-        DllAdvApi32.pCryptCreateHash == NULL ||
-        DllAdvApi32.pCryptDestroyHash == NULL ||
-        DllAdvApi32.pCryptGetHashParam == NULL ||
-        DllAdvApi32.pCryptHashData == NULL ||
-        DllAdvApi32.pCryptReleaseContext == NULL) {
-
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: operating system support not present\n"));
+    if (!HashInitializeContext(&HashContext, Algorithm)) {
         return EXIT_FAILURE;
     }
 
-    if (!HashInitializeContext(&HashContext, Algorithm)) {
-        return EXIT_FAILURE;
+    if (HashContext.CacheFileName.LengthInChars > 0) {
+        if (!HashLoadCache(&HashContext)) {
+            HashCleanupContext(&HashContext);
+            return EXIT_FAILURE;
+        }
     }
 
 #if YORI_BUILTIN
@@ -670,13 +2325,14 @@ ENTRYPOINT(
             return EXIT_FAILURE;
         }
 
-        if (!HashProcessStream(GetStdHandle(STD_INPUT_HANDLE), &HashContext)) {
+        HashContext.FilesFound++;
+        if (!HashProcessStream(GetStdHandle(STD_INPUT_HANDLE), &HashContext, &HashContext.MainWorker, &HashContext.HashString)) {
             HashCleanupContext(&HashContext);
             return EXIT_FAILURE;
         }
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &HashContext.HashString);
     } else {
-        MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
+        MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS | YORILIB_FILEENUM_BASIC_INFO;
         if (BasicEnumeration) {
             MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
         }
@@ -684,6 +2340,16 @@ ENTRYPOINT(
             MatchFlags |= YORILIB_FILEENUM_RECURSE_AFTER_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
         }
 
+        //
+        //  Hashing one file at a time leaves the disk mostly idle, so when
+        //  requested, queue files to worker threads.  Results are still
+        //  displayed in the order files were found.
+        //
+
+        if (WorkerCount > 1) {
+            HashStartWorkers(&HashContext, WorkerCount);
+        }
+
         for (i = StartArg; i < ArgC; i++) {
 
             HashContext.FilesFoundThisArg = 0;
@@ -1474,9 +1474,9 @@ typedef struct _HEXDUMP_ONE_OBJECT {
     BOOL ReadFailed;
 
     /**
-     The number of bytes to display for a given line from this
-     buffer.  This is recalculated for each line based on the source's
-     buffer length.
+     The number of bytes to display from this buffer.  This is recalculated
+     for each read based on the number of bytes read and the range the user
+     requested.
      */
     YORI_ALLOC_SIZE_T DisplayLength;
 } HEXDUMP_ONE_OBJECT, *PHEXDUMP_ONE_OBJECT;
@@ -1501,16 +1501,13 @@ HexDumpDisplayDiff(
 {
     HEXDUMP_ONE_OBJECT Objects[2];
     YORI_ALLOC_SIZE_T BufferSize;
-    YORI_ALLOC_SIZE_T BufferOffset;
     YORI_ALLOC_SIZE_T LengthToDisplay;
-    YORI_ALLOC_SIZE_T LengthThisLine;
     DWORD DisplayFlags;
     LARGE_INTEGER StreamOffset;
     DWORD Count;
     BOOL Result = FALSE;
-    BOOL LineDifference;
 
-    BufferSize = YoriLibMaximumAllocationInRange(16 * 1024, 64 * 1024);
+    BufferSize = YoriLibMaximumAllocationInRange(16 * 1024, 1024 * 1024);
     DisplayFlags = 0;
     if (!HexDumpContext->HideOffset) {
         DisplayFlags |= YORI_LIB_HEX_FLAG_DISPLAY_LARGE_OFFSET;
@@ -1637,57 +1634,26 @@ HexDumpDisplayDiff(
             }
         }
 
-        BufferOffset = 0;
-
-        while(BufferOffset < LengthToDisplay) {
-
-            //
-            //  Check each line to see if it's different
-            //
-
-            LineDifference = FALSE;
-            if (LengthToDisplay - BufferOffset >= 16) {
-                LengthThisLine = 16;
-            } else {
-                LengthThisLine = LengthToDisplay - BufferOffset;
-            }
-            for (Count = 0; Count < sizeof(Objects)/sizeof(Objects[0]); Count++) {
-                Objects[Count].DisplayLength = LengthThisLine;
-                if (BufferOffset + LengthThisLine > (YORI_ALLOC_SIZE_T)Objects[Count].BytesReturned) {
-                    LineDifference = TRUE;
-                    Objects[Count].DisplayLength = 0;
-                    if (Objects[Count].BytesReturned > BufferOffset) {
-                        Objects[Count].DisplayLength = (YORI_ALLOC_SIZE_T)Objects[0].BytesReturned - BufferOffset;
-                    }
-                }
-            }
-
-            if (!LineDifference &&
-                memcmp(&Objects[0].Buffer[BufferOffset], &Objects[1].Buffer[BufferOffset], LengthThisLine) != 0) {
-                LineDifference = TRUE;
-            }
+        //
+        //  Display the lines that differ.  Identical regions are skipped
+        //  by comparing large blocks at a time.
+        //
 
-            //
-            //  If it's different, display it
-            //
-
-            if (LineDifference) {
-                if (!YoriLibHexDiff(StreamOffset.QuadPart + BufferOffset,
-                                    (LPCSTR)&Objects[0].Buffer[BufferOffset],
-                                    Objects[0].DisplayLength,
-                                    (LPCSTR)&Objects[1].Buffer[BufferOffset],
-                                    Objects[1].DisplayLength,
-                                    HexDumpContext->BytesPerGroup,
-                                    DisplayFlags)) {
-                    break;
-                }
+        for (Count = 0; Count < sizeof(Objects)/sizeof(Objects[0]); Count++) {
+            Objects[Count].DisplayLength = (YORI_ALLOC_SIZE_T)Objects[Count].BytesReturned;
+            if (Objects[Count].DisplayLength > LengthToDisplay) {
+                Objects[Count].DisplayLength = LengthToDisplay;
             }
+        }
 
-            //
-            //  Move to the next line
-            //
-
-            BufferOffset = BufferOffset + LengthThisLine;
+        if (!YoriLibHexDiff(StreamOffset.QuadPart,
+                            (LPCSTR)Objects[0].Buffer,
+                            Objects[0].DisplayLength,
+                            (LPCSTR)Objects[1].Buffer,
+                            Objects[1].DisplayLength,
+                            HexDumpContext->BytesPerGroup,
+                            DisplayFlags | YORI_LIB_HEX_FLAG_SKIP_IDENTICAL)) {
+            break;
         }
 
         StreamOffset.QuadPart += LengthToDisplay;
@@ -1862,6 +1828,18 @@ ENTRYPOINT(
 
     YoriLibEnableBackupPrivilege();
 
+    //
+    //  Buffer output in the standalone program, where it is flushed on
+    //  exit.  Reverse mode writes binary data to the output handle
+    //  directly, so it cannot be combined with buffered text.
+    //
+
+#if !YORI_BUILTIN
+    if (!Reverse) {
+        YoriLibEnableOutputBuffering();
+    }
+#endif
+
     if (DiffMode) {
         if (StartArg == 0 || StartArg + 2 > ArgC) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hexdump: insufficient arguments\n"));
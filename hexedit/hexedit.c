@@ -69,6 +69,148 @@ HexEditHelp(VOID)
     return TRUE;
 }
 
+/**
+ The number of bytes to load at a time from a file or device that is too
+ large to load in its entirety.
+ */
+#define HEXEDIT_WINDOW_SIZE (16 * 1024 * 1024)
+
+/**
+ The alignment of the start of each window within a large file or device.
+ This is a multiple of any sector size, so windows on devices can be
+ written without buffering.
+ */
+#define HEXEDIT_WINDOW_ALIGNMENT (64 * 1024)
+
+/**
+ The alignment of writes to a device.  This is a multiple of any sector
+ size, so any range of a device can be written without buffering.
+ */
+#define HEXEDIT_SECTOR_ALIGNMENT (4096)
+
+/**
+ The largest file that is loaded in its entirety.  Devices larger than a
+ single window are always loaded a window at a time, since their length
+ cannot change.
+ */
+#define HEXEDIT_MAXIMUM_FULL_LOAD (256 * 1024 * 1024)
+
+/**
+ The number of bytes searched at a time by a background search.  Reads from
+ a file or device end on a multiple of this value, which is a multiple of any
+ sector size.  This must be a power of two.
+ */
+#define HEXEDIT_SEARCH_CHUNK_SIZE (1024 * 1024)
+
+/**
+ The interval in milliseconds between checks for the progress of a
+ background search.
+ */
+#define HEXEDIT_SEARCH_INTERVAL (200)
+
+/**
+ State describing a search for a pattern which is performed on a background
+ thread.  The search can cover a file or device which is too large to load,
+ so data beyond the loaded window is read from the file.
+ */
+typedef struct _HEXEDIT_SEARCH {
+
+    /**
+     Handle to the background thread performing the search.
+     */
+    HANDLE Thread;
+
+    /**
+     A mutex synchronizing the fields below which are updated by the
+     background thread.
+     */
+    HANDLE Mutex;
+
+    /**
+     Handle to the file or device to read data beyond the loaded window
+     from, or NULL if all of the data to search is loaded.
+     */
+    HANDLE hFile;
+
+    /**
+     A referenced pointer to the data loaded into the hexedit control.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The offset within the file of the first byte in Buffer.
+     */
+    DWORDLONG BufferOffset;
+
+    /**
+     The number of bytes in Buffer.
+     */
+    YORI_ALLOC_SIZE_T BufferLength;
+
+    /**
+     A referenced pointer to the bytes to search for.  Each byte has the
+     corresponding Mask byte applied.
+     */
+    PUCHAR Pattern;
+
+    /**
+     Pointer to the mask of bits within each byte which must match.  This is
+     part of the Pattern allocation.
+     */
+    PUCHAR Mask;
+
+    /**
+     The number of bytes in the pattern.
+     */
+    YORI_ALLOC_SIZE_T PatternLength;
+
+    /**
+     The index of the first byte in the pattern which has no wildcard bits,
+     or PatternLength if every byte contains wildcard bits.
+     */
+    YORI_ALLOC_SIZE_T AnchorIndex;
+
+    /**
+     The offset within the file to start searching from.
+     */
+    DWORDLONG StartOffset;
+
+    /**
+     The offset within the file to stop searching at.
+     */
+    DWORDLONG EndOffset;
+
+    /**
+     The offset within the file that has been searched so far.
+     */
+    DWORDLONG CurrentOffset;
+
+    /**
+     If Found is TRUE, the offset within the file of the match.
+     */
+    DWORDLONG MatchOffset;
+
+    /**
+     A Win32 error code indicating why the search failed, or ERROR_SUCCESS.
+     */
+    DWORD Error;
+
+    /**
+     Set to TRUE to request the background thread stop searching.
+     */
+    BOOLEAN Cancel;
+
+    /**
+     Set to TRUE by the background thread when it has finished.
+     */
+    BOOLEAN Complete;
+
+    /**
+     Set to TRUE by the background thread if a match was found.
+     */
+    BOOLEAN Found;
+} HEXEDIT_SEARCH, *PHEXEDIT_SEARCH;
+
 /**
  A context that records files found and being operated on in the current
  window.
@@ -110,6 +252,18 @@ typedef struct _HEXEDIT_CONTEXT {
      */
     YORI_ALLOC_SIZE_T DataLength;
 
+    /**
+     The offset within the file of the range that was opened for editing.
+     When the range is too large to load, DataOffset and DataLength describe
+     the window within this range that is currently loaded.
+     */
+    DWORDLONG RangeOffset;
+
+    /**
+     The length of the range that was opened for editing.
+     */
+    DWORDLONG RangeLength;
+
     /**
      The data that was most recently searched for.
      */
@@ -120,6 +274,20 @@ typedef struct _HEXEDIT_CONTEXT {
      */
     YORI_ALLOC_SIZE_T SearchBufferLength;
 
+    /**
+     If the most recent search was for a pattern, points to the mask of
+     bits within each byte of SearchBuffer which must match.  This is part
+     of the SearchBuffer allocation.  NULL if the most recent search was for
+     exact data.
+     */
+    PUCHAR SearchMask;
+
+    /**
+     Pointer to the state of a background search.  NULL if no search is in
+     progress.
+     */
+    PHEXEDIT_SEARCH Search;
+
     /**
      The index of the edit menu.  This is used to check and uncheck menu
      items based on the state of the control.
@@ -210,6 +378,13 @@ typedef struct _HEXEDIT_CONTEXT {
      */
     BOOLEAN ReadOnly;
 
+    /**
+     TRUE if the range opened for editing is too large to load, so only a
+     window within it is loaded at any time.  While this is set, saves
+     write the window back in place and cannot change its length.
+     */
+    BOOLEAN Windowed;
+
 } HEXEDIT_CONTEXT, *PHEXEDIT_CONTEXT;
 
 /**
@@ -259,799 +434,1053 @@ HexEditFreeDataBuffer(
 }
 
 /**
- Set the caption on the hexedit control to match the file name component of the
- currently opened file.
+ The value of a machine word with the low bit of each byte set.
  */
-VOID
-HexEditUpdateOpenedFileCaption(
-    __in PHEXEDIT_CONTEXT HexEditContext
+#define HEXEDIT_SEARCH_LOW_BITS ((DWORD_PTR)-1 / 0xFF)
+
+/**
+ The value of a machine word with the high bit of each byte set.
+ */
+#define HEXEDIT_SEARCH_HIGH_BITS (HEXEDIT_SEARCH_LOW_BITS * 0x80)
+
+/**
+ Search a chunk of data for a pattern.  The search looks for one byte of the
+ pattern which has no wildcard bits, and compares a machine word at a time
+ against that byte, so the full pattern is only compared at offsets where
+ that byte is present.
+
+ @param Search Pointer to the search state, containing the pattern.
+
+ @param Chunk Pointer to the data to search.
+
+ @param ChunkLength The number of bytes in Chunk.
+
+ @param MatchIndex On successful completion, updated to contain the offset
+        within Chunk of the first match.
+
+ @return TRUE to indicate a match was found, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+HexEditSearchFindInChunk(
+    __in PHEXEDIT_SEARCH Search,
+    __in PUCHAR Chunk,
+    __in YORI_ALLOC_SIZE_T ChunkLength,
+    __out PYORI_ALLOC_SIZE_T MatchIndex
     )
 {
-    YORI_STRING NewCaption;
-    LPTSTR FinalSlash;
+    PUCHAR Pattern;
+    PUCHAR Mask;
+    YORI_ALLOC_SIZE_T PatternLength;
+    YORI_ALLOC_SIZE_T AnchorIndex;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T EndIndex;
+    YORI_ALLOC_SIZE_T StartIndex;
+    YORI_ALLOC_SIZE_T PatternIndex;
+    DWORD_PTR Broadcast;
+    DWORD_PTR Word;
+    UCHAR Anchor;
 
-    YoriLibInitEmptyString(&NewCaption);
+    Pattern = Search->Pattern;
+    Mask = Search->Mask;
+    PatternLength = Search->PatternLength;
 
-    FinalSlash = YoriLibFindRightMostCharacter(&HexEditContext->OpenFileName, '\\');
-    if (FinalSlash != NULL) {
-        NewCaption.StartOfString = FinalSlash + 1;
-        NewCaption.LengthInChars = (YORI_ALLOC_SIZE_T)(HexEditContext->OpenFileName.LengthInChars - (FinalSlash - HexEditContext->OpenFileName.StartOfString + 1));
-    } else {
-        NewCaption.StartOfString = HexEditContext->OpenFileName.StartOfString;
-        NewCaption.LengthInChars = HexEditContext->OpenFileName.LengthInChars;
+    if (ChunkLength < PatternLength) {
+        return FALSE;
     }
 
-    YoriWinHexEditSetCaption(HexEditContext->HexEdit, &NewCaption);
+    //
+    //  If every byte in the pattern is a wildcard, it matches anywhere.
+    //
+
+    AnchorIndex = Search->AnchorIndex;
+    if (AnchorIndex >= PatternLength) {
+        *MatchIndex = 0;
+        return TRUE;
+    }
+
+    Anchor = Pattern[AnchorIndex];
+    Broadcast = HEXEDIT_SEARCH_LOW_BITS * Anchor;
+    Index = AnchorIndex;
+    EndIndex = ChunkLength - PatternLength + AnchorIndex + 1;
+
+    while (Index < EndIndex) {
+
+        //
+        //  When aligned, skip a word at a time while no byte in the word
+        //  equals the anchor byte.  XOR makes matching bytes zero, and a
+        //  word contains a zero byte if subtracting one from each byte
+        //  borrows into a high bit that was clear.
+        //
+
+        if ((((DWORD_PTR)&Chunk[Index]) & (sizeof(DWORD_PTR) - 1)) == 0) {
+            while (Index + sizeof(DWORD_PTR) <= EndIndex) {
+                Word = *(PDWORD_PTR)&Chunk[Index] ^ Broadcast;
+                if (((Word - HEXEDIT_SEARCH_LOW_BITS) & ~Word & HEXEDIT_SEARCH_HIGH_BITS) != 0) {
+                    break;
+                }
+                Index = Index + sizeof(DWORD_PTR);
+            }
+
+            if (Index >= EndIndex) {
+                break;
+            }
+        }
+
+        if (Chunk[Index] == Anchor) {
+            StartIndex = Index - AnchorIndex;
+            for (PatternIndex = 0; PatternIndex < PatternLength; PatternIndex++) {
+                if ((Chunk[StartIndex + PatternIndex] & Mask[PatternIndex]) != Pattern[PatternIndex]) {
+                    break;
+                }
+            }
+
+            if (PatternIndex == PatternLength) {
+                *MatchIndex = StartIndex;
+                return TRUE;
+            }
+        }
+
+        Index++;
+    }
+
+    return FALSE;
 }
 
 /**
- Load the contents of the specified file into the hexedit window.
+ Read data for a background search.  Data within the range loaded into the
+ hexedit control is copied from it, so unsaved changes are searched, and any
+ data beyond it is read from the file or device.
 
- @param HexEditContext Pointer to the hexedit context.
+ @param Search Pointer to the search state.
 
- @param FileName Pointer to the name of the file to open.
+ @param Offset The offset within the file of the data to read.
 
- @param DataOffset Specifies the offset within the file to load the data.
+ @param Buffer Pointer to a buffer to populate with data.
 
- @param DataLength Specifies the number of bytes of data to load.  If zero,
-        the entire file or device contents are loaded.
+ @param Length The number of bytes to read.
 
  @return Win32 error code, including ERROR_SUCCESS to indicate success.
  */
 DWORD
-HexEditLoadFile(
-    __in PHEXEDIT_CONTEXT HexEditContext,
-    __in PYORI_STRING FileName,
-    __in DWORDLONG DataOffset,
-    __in DWORDLONG DataLength
+HexEditSearchRead(
+    __in PHEXEDIT_SEARCH Search,
+    __in DWORDLONG Offset,
+    __out_bcount(Length) PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T Length
     )
 {
-    HANDLE hFile;
-    LARGE_INTEGER FileSize;
     LARGE_INTEGER FileOffset;
-    YORI_MAX_SIGNED_T nFileSize;
-    YORI_ALLOC_SIZE_T ReadLength;
-    PUCHAR Buffer;
+    YORI_ALLOC_SIZE_T BytesToCopy;
     DWORD BytesRead;
     DWORD Err;
 
-    if (FileName->StartOfString == NULL) {
-        return ERROR_INVALID_NAME;
-    }
+    if (Offset >= Search->BufferOffset &&
+        Offset < Search->BufferOffset + Search->BufferLength) {
 
-    ASSERT(YoriLibIsStringNullTerminated(FileName));
+        BytesToCopy = Length;
+        if (Search->BufferOffset + Search->BufferLength - Offset < BytesToCopy) {
+            BytesToCopy = (YORI_ALLOC_SIZE_T)(Search->BufferOffset + Search->BufferLength - Offset);
+        }
 
-    hFile = CreateFile(FileName->StartOfString, FILE_READ_DATA | FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (hFile == INVALID_HANDLE_VALUE) {
-        return GetLastError();
+        memcpy(Buffer, &Search->Buffer[Offset - Search->BufferOffset], BytesToCopy);
+        Offset = Offset + BytesToCopy;
+        Buffer = Buffer + BytesToCopy;
+        Length = Length - BytesToCopy;
     }
 
-    // 
-    //  MSFIX This doesn't make any sense for a device.  We could detect the
-    //  error and try IOCTL_DISK_GET_LENGTH_INFO, although for a device we
-    //  probably should receive the size to access.
-    //
-
-    if (DataLength == 0) {
-        Err = YoriLibGetFileOrDeviceSize(hFile, &FileSize.QuadPart);
-        if (Err != ERROR_SUCCESS) {
-            CloseHandle(hFile);
-            return Err;
-        }
-    } else {
-        FileSize.QuadPart = DataLength;
+    if (Length == 0) {
+        return ERROR_SUCCESS;
     }
 
-    nFileSize = (YORI_MAX_SIGNED_T)FileSize.QuadPart;
-    if (!YoriLibIsSizeAllocatable(nFileSize)) {
-        CloseHandle(hFile);
-        return ERROR_READ_FAULT;
+    if (Search->hFile == NULL) {
+        return ERROR_HANDLE_EOF;
     }
 
-    ReadLength = (YORI_ALLOC_SIZE_T)FileSize.QuadPart;
-
-    FileOffset.QuadPart = DataOffset;
-    if (FileOffset.QuadPart != 0) {
-        if (!SetFilePointer(hFile, FileOffset.LowPart, &FileOffset.HighPart, FILE_BEGIN)) {
-            Err = GetLastError();
-            CloseHandle(hFile);
+    FileOffset.QuadPart = Offset;
+    FileOffset.LowPart = SetFilePointer(Search->hFile, FileOffset.LowPart, &FileOffset.HighPart, FILE_BEGIN);
+    if (FileOffset.LowPart == (DWORD)-1) {
+        Err = GetLastError();
+        if (Err != NO_ERROR) {
             return Err;
         }
     }
 
-    Buffer = YoriLibReferencedMalloc(ReadLength);
-    if (Buffer == NULL) {
-        CloseHandle(hFile);
-        return ERROR_NOT_ENOUGH_MEMORY;
+    if (!ReadFile(Search->hFile, Buffer, Length, &BytesRead, NULL)) {
+        return GetLastError();
     }
 
-    if (!ReadFile(hFile, Buffer, ReadLength, &BytesRead, NULL)) {
-        Err = GetLastError();
-        YoriLibDereference(Buffer);
-        CloseHandle(hFile);
-        return Err;
+    if (BytesRead != Length) {
+        return ERROR_HANDLE_EOF;
     }
 
-    //
-    //  If the call requested us to automatically detect the length, tolerate
-    //  it being a little smaller than we expect.  This happens when the
-    //  partition layer passes IOCTLs to the disk, sigh.
-    //
+    return ERROR_SUCCESS;
+}
 
-    if (BytesRead > ReadLength ||
-        (DataLength != 0 && BytesRead != ReadLength)) {
+/**
+ A background thread which searches for a pattern.
 
-        YoriLibDereference(Buffer);
-        CloseHandle(hFile);
-        return ERROR_INVALID_DATA;
-    }
+ @param Context Pointer to the search state.
 
-    CloseHandle(hFile);
+ @return Thread exit code, which is ignored.
+ */
+DWORD WINAPI
+HexEditSearchThread(
+    __in LPVOID Context
+    )
+{
+    PHEXEDIT_SEARCH Search;
+    PUCHAR Chunk;
+    DWORDLONG Offset;
+    DWORDLONG MatchOffset;
+    YORI_ALLOC_SIZE_T ReadLength;
+    YORI_ALLOC_SIZE_T ChunkLength;
+    YORI_ALLOC_SIZE_T Carry;
+    YORI_ALLOC_SIZE_T MatchIndex;
+    BOOLEAN Found;
+    BOOLEAN Cancel;
+    DWORD Err;
 
-    YoriWinHexEditClear(HexEditContext->HexEdit);
+    Search = (PHEXEDIT_SEARCH)Context;
+    Found = FALSE;
+    MatchOffset = 0;
+    Err = ERROR_SUCCESS;
 
-    if (!YoriWinHexEditSetDataNoCopy(HexEditContext->HexEdit, Buffer, ReadLength, (YORI_ALLOC_SIZE_T)BytesRead)) {
-        YoriLibDereference(Buffer);
-        return ERROR_NOT_ENOUGH_MEMORY;
-    }
-    YoriLibDereference(Buffer);
+    Chunk = YoriLibMalloc(HEXEDIT_SEARCH_CHUNK_SIZE + Search->PatternLength);
+    if (Chunk == NULL) {
+        Err = ERROR_NOT_ENOUGH_MEMORY;
+    } else {
 
-    HexEditContext->DataOffset = DataOffset;
-    HexEditContext->DataLength = ReadLength;
+        //
+        //  Each chunk starts with the final bytes of the previous chunk,
+        //  so matches which span chunks are found.  Reads end on a chunk
+        //  aligned offset, so reads from devices remain sector aligned.
+        //
 
-    return ERROR_SUCCESS;
-}
+        Carry = 0;
+        Offset = Search->StartOffset;
+        while (Offset < Search->EndOffset) {
+            ReadLength = (YORI_ALLOC_SIZE_T)(HEXEDIT_SEARCH_CHUNK_SIZE - (Offset & (HEXEDIT_SEARCH_CHUNK_SIZE - 1)));
+            if (Search->EndOffset - Offset < ReadLength) {
+                ReadLength = (YORI_ALLOC_SIZE_T)(Search->EndOffset - Offset);
+            }
 
-/**
- Save the contents of the opened window into a file.
+            Err = HexEditSearchRead(Search, Offset, &Chunk[Carry], ReadLength);
+            if (Err != ERROR_SUCCESS) {
+                break;
+            }
 
- @param HexEditContext Pointer to the hexedit context.
+            ChunkLength = Carry + ReadLength;
+            if (HexEditSearchFindInChunk(Search, Chunk, ChunkLength, &MatchIndex)) {
+                MatchOffset = Offset - Carry + MatchIndex;
+                Found = TRUE;
+                break;
+            }
 
- @param WinMgrHandle Handle to the window manager to use when displaying
-        errors.
+            Offset = Offset + ReadLength;
+            Carry = Search->PatternLength - 1;
+            if (Carry > ChunkLength) {
+                Carry = ChunkLength;
+            }
+            memmove(Chunk, &Chunk[ChunkLength - Carry], Carry);
 
- @param FileName Pointer to the name of the file to save.
+            WaitForSingleObject(Search->Mutex, INFINITE);
+            Search->CurrentOffset = Offset;
+            Cancel = Search->Cancel;
+            ReleaseMutex(Search->Mutex);
 
- @param DataOffset Specifies the offset within the file to store the data.
+            if (Cancel) {
+                break;
+            }
+        }
 
- @param DataLength Specifies the number of bytes of data to store.  If this
-        differs from the current buffer, the save operation is failed.  If
-        this is zero, the number of bytes is undefined, and any value in the
-        hex edit control buffer can be used.
+        YoriLibFree(Chunk);
+    }
 
- @return TRUE to indicate success, FALSE to indicate failure.
- */
-BOOLEAN
-HexEditSaveFile(
-    __in PHEXEDIT_CONTEXT HexEditContext,
-    __in PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgrHandle,
-    __in PYORI_STRING FileName,
-    __in DWORDLONG DataOffset,
-    __in DWORDLONG DataLength
+    WaitForSingleObject(Search->Mutex, INFINITE);
+    Search->Found = Found;
+    Search->MatchOffset = MatchOffset;
+    Search->Error = Err;
+    Search->Complete = TRUE;
+    ReleaseMutex(Search->Mutex);
+
+    return 0;
+}
+
+/**
+ Return the percentage of the data that a background search has searched.
+
+ @param Search Pointer to the search state.
+
+ @return The percentage of data searched.
+ */
+DWORD
+HexEditSearchPercentComplete(
+    __in PHEXEDIT_SEARCH Search
     )
 {
-    YORI_ALLOC_SIZE_T Index;
-    DWORD Attributes;
-    DWORD Err;
-    LPTSTR ErrText;
-    YORI_STRING ParentDirectory;
-    YORI_STRING Prefix;
-    YORI_STRING TempFileName;
-    HANDLE WriteHandle;
-    BOOLEAN ReplaceSucceeded;
-    PUCHAR Buffer;
-    YORI_ALLOC_SIZE_T BufferLength;
-    YORI_ALLOC_SIZE_T EffectiveDataLength;
-    DWORD BufferWritten;
-    YORI_STRING Text;
-    YORI_STRING Title;
-    YORI_STRING ButtonText;
+    DWORDLONG CurrentOffset;
+    DWORD Percent;
+
+    WaitForSingleObject(Search->Mutex, INFINITE);
+    CurrentOffset = Search->CurrentOffset;
+    ReleaseMutex(Search->Mutex);
+
+    Percent = 0;
+    if (Search->EndOffset > Search->StartOffset) {
+        Percent = (DWORD)((CurrentOffset - Search->StartOffset) * 100 / (Search->EndOffset - Search->StartOffset));
+        if (Percent > 99) {
+            Percent = 99;
+        }
+    }
 
-    YoriLibInitEmptyString(&TempFileName);
-    YoriLibInitEmptyString(&Text);
-    YoriLibConstantString(&Title, _T("Save"));
-    YoriLibConstantString(&ButtonText, _T("Ok"));
+    return Percent;
+}
 
-    if (FileName->StartOfString == NULL) {
-        YoriLibConstantString(&Text, _T("Cannot save: file name not specified"));
-        goto DisplayErrorAndFail;
-    }
+/**
+ Tear down the state for a background search.  If a background thread is
+ searching, this waits for it to exit, so the caller should first indicate
+ that it should stop or ensure it has finished.
 
-    if (!YoriLibIsSizeAllocatable(DataLength)) {
-        YoriLibConstantString(&Text, _T("Cannot save: device size too large"));
-        goto DisplayErrorAndFail;
-    }
+ @param HexEditContext Pointer to the hexedit context.
+ */
+VOID
+HexEditSearchClose(
+    __in PHEXEDIT_CONTEXT HexEditContext
+    )
+{
+    PHEXEDIT_SEARCH Search;
 
-    EffectiveDataLength = (YORI_ALLOC_SIZE_T)DataLength;
+    Search = HexEditContext->Search;
+    if (Search == NULL) {
+        return;
+    }
 
-    ASSERT(YoriLibIsStringNullTerminated(FileName));
+    if (Search->Thread != NULL) {
+        WaitForSingleObject(Search->Thread, INFINITE);
+        CloseHandle(Search->Thread);
+        YoriWinSetPeriodicNotifyCallback(YoriWinGetControlParent(HexEditContext->HexEdit), 0, NULL);
+    }
 
-    if (!YoriLibIsFileNameDeviceName(FileName)) {
+    if (Search->Mutex != NULL) {
+        CloseHandle(Search->Mutex);
+    }
 
-        //
-        //  Find the parent directory of the user specified file so a temporary
-        //  file can be created in the same directory.  This is done to increase
-        //  the chance that the file is written to the same device as the final
-        //  location and to test that the user can write to the location.
-        //
+    if (Search->hFile != NULL) {
+        CloseHandle(Search->hFile);
+    }
 
-        YoriLibInitEmptyString(&ParentDirectory);
-        for (Index = FileName->LengthInChars; Index > 0; Index--) {
-            if (YoriLibIsSep(FileName->StartOfString[Index - 1])) {
-                ParentDirectory.StartOfString = FileName->StartOfString;
-                ParentDirectory.LengthInChars = Index - 1;
-                break;
-            }
-        }
+    if (Search->Buffer != NULL) {
+        YoriLibDereference(Search->Buffer);
+    }
 
-        if (Index == 0) {
-            YoriLibConstantString(&ParentDirectory, _T("."));
-        }
+    if (Search->Pattern != NULL) {
+        YoriLibDereference(Search->Pattern);
+    }
 
-        YoriLibConstantString(&Prefix, _T("YEDT"));
+    YoriLibFree(Search);
+    HexEditContext->Search = NULL;
 
-        if (!YoriLibGetTempFileName(&ParentDirectory, &Prefix, &WriteHandle, &TempFileName)) {
+    YoriWinHexEditSetReadOnly(HexEditContext->HexEdit, HexEditContext->ReadOnly);
+}
 
-            YoriLibYPrintf(&Text, _T("Could not open temporary file in %y"), &ParentDirectory);
-            goto DisplayErrorAndFail;
-        }
+/**
+ Stop a background search, if one is in progress.
 
-    } else {
+ @param HexEditContext Pointer to the hexedit context.
+ */
+VOID
+HexEditSearchCancel(
+    __in PHEXEDIT_CONTEXT HexEditContext
+    )
+{
+    PHEXEDIT_SEARCH Search;
 
-        WriteHandle = CreateFile(FileName->StartOfString,
-                                 FILE_WRITE_DATA | FILE_WRITE_ATTRIBUTES | FILE_READ_ATTRIBUTES | SYNCHRONIZE,
-                                 FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
-                                 NULL,
-                                 OPEN_EXISTING,
-                                 FILE_FLAG_NO_BUFFERING,
-                                 NULL);
+    Search = HexEditContext->Search;
+    if (Search == NULL) {
+        return;
+    }
 
-        if (WriteHandle == INVALID_HANDLE_VALUE) {
-            Err = GetLastError();
-            ErrText = YoriLibGetWinErrorText(Err);
-            YoriLibYPrintf(&Text, _T("Could not open device %s: %s"), FileName->StartOfString, ErrText);
-            YoriLibFreeWinErrorText(ErrText);
-            goto DisplayErrorAndFail;
-        }
+    if (Search->Mutex != NULL) {
+        WaitForSingleObject(Search->Mutex, INFINITE);
+        Search->Cancel = TRUE;
+        ReleaseMutex(Search->Mutex);
     }
 
-    YoriWinHexEditGetDataNoCopy(HexEditContext->HexEdit, &Buffer, &BufferLength);
+    HexEditSearchClose(HexEditContext);
+}
 
-    if (EffectiveDataLength != 0 &&
-        EffectiveDataLength != BufferLength) {
+/**
+ Set the caption on the hexedit control to match the file name component of the
+ currently opened file.
+ */
+VOID
+HexEditUpdateOpenedFileCaption(
+    __in PHEXEDIT_CONTEXT HexEditContext
+    )
+{
+    YORI_STRING NewCaption;
+    LPTSTR FinalSlash;
 
-        YoriLibYPrintf(&Text, _T("Device length %i bytes does not match buffer length %i bytes"), EffectiveDataLength, BufferLength);
-        goto DisplayErrorAndFail;
-    }
+    YoriLibInitEmptyString(&NewCaption);
 
-    if (DataOffset != 0) {
-        LARGE_INTEGER FileOffset;
-        FileOffset.QuadPart = DataOffset;
-        if (!SetFilePointer(WriteHandle, FileOffset.LowPart, &FileOffset.HighPart, FILE_BEGIN)) {
-            CloseHandle(WriteHandle);
-            if (TempFileName.LengthInChars > 0) {
-                DeleteFile(TempFileName.StartOfString);
-            }
-            YoriLibFreeStringContents(&TempFileName);
-            YoriLibYPrintf(&Text, _T("Could not seek to offset 0x%llx"), FileOffset.QuadPart);
-            goto DisplayErrorAndFail;
-        }
+    FinalSlash = YoriLibFindRightMostCharacter(&HexEditContext->OpenFileName, '\\');
+    if (FinalSlash != NULL) {
+        NewCaption.StartOfString = FinalSlash + 1;
+        NewCaption.LengthInChars = (YORI_ALLOC_SIZE_T)(HexEditContext->OpenFileName.LengthInChars - (FinalSlash - HexEditContext->OpenFileName.StartOfString + 1));
+    } else {
+        NewCaption.StartOfString = HexEditContext->OpenFileName.StartOfString;
+        NewCaption.LengthInChars = HexEditContext->OpenFileName.LengthInChars;
     }
 
-    if (Buffer != NULL) {
+    YoriWinHexEditSetCaption(HexEditContext->HexEdit, &NewCaption);
+}
 
-        //
-        //  MSFIX This is truncating to 4Gb but is probably limited much lower
-        //
+/**
+ Read a range of a file or device into the hexedit window, replacing any
+ data currently there.
 
-        if (!WriteFile(WriteHandle, Buffer, (DWORD)BufferLength, &BufferWritten, NULL)) {
-            Err = GetLastError();
-            ErrText = YoriLibGetWinErrorText(Err);
-            CloseHandle(WriteHandle);
-            if (TempFileName.LengthInChars > 0) {
-                DeleteFile(TempFileName.StartOfString);
-            }
-            YoriLibFreeStringContents(&TempFileName);
-            YoriLibDereference(Buffer);
-            YoriLibYPrintf(&Text, _T("Could not write to device: %s"), ErrText);
-            YoriLibFreeWinErrorText(ErrText);
-            goto DisplayErrorAndFail;
-        }
+ @param HexEditContext Pointer to the hexedit context.
 
-        YoriLibDereference(Buffer);
-    }
+ @param hFile Handle to the file or device.
 
-    if (TempFileName.LengthInChars > 0) {
+ @param WindowOffset Specifies the offset within the file to load the data.
 
-        //
-        //  Flush the temporary file to ensure it's durable, and rename it over
-        //  the top of the chosen file, replacing if necessary.  This ensures
-        //  that the old contents are not deleted until the new contents are
-        //  successfully written.
-        //
+ @param WindowLength Specifies the number of bytes of data to load.
 
-        if (!FlushFileBuffers(WriteHandle)) {
-            CloseHandle(WriteHandle);
-            DeleteFile(TempFileName.StartOfString);
-            YoriLibFreeStringContents(&TempFileName);
-            YoriLibConstantString(&Text, _T("Could not flush temporary file"));
-            goto DisplayErrorAndFail;
-        }
+ @param AllowShortRead If TRUE, the file may contain less data than
+        requested, and whatever is present is loaded.  If FALSE, the load
+        fails unless all of the requested data is present.
 
-        CloseHandle(WriteHandle);
+ @return Win32 error code, including ERROR_SUCCESS to indicate success.
+ */
+DWORD
+HexEditReadWindow(
+    __in PHEXEDIT_CONTEXT HexEditContext,
+    __in HANDLE hFile,
+    __in DWORDLONG WindowOffset,
+    __in YORI_ALLOC_SIZE_T WindowLength,
+    __in BOOLEAN AllowShortRead
+    )
+{
+    LARGE_INTEGER FileOffset;
+    PUCHAR Buffer;
+    DWORD BytesRead;
+    DWORD Err;
 
-        //
-        //  If the file exists and ReplaceFile is present, replace it. Without
-        //  ReplaceFile or if the file doesn't exist, rename the temporary file
-        //  into place.  If ReplaceFile fails for whatever reason, fall back to
-        //  rename, which implicitly prioritizes succeeding the save to preserving
-        //  whatever file metadata ReplaceFile is aiming to retain.
-        //
+    //
+    //  Any background search refers to the data being replaced.
+    //
 
-        ReplaceSucceeded = FALSE;
-        Attributes = GetFileAttributes(FileName->StartOfString);
-        if (Attributes != (DWORD)-1 &&
-            DllKernel32.pReplaceFileW != NULL) {
+    HexEditSearchCancel(HexEditContext);
 
-            if (DllKernel32.pReplaceFileW(FileName->StartOfString, TempFileName.StartOfString, NULL, 0, NULL, NULL)) {
-                ReplaceSucceeded = TRUE;
+    FileOffset.QuadPart = WindowOffset;
+    if (FileOffset.QuadPart != 0) {
+        FileOffset.LowPart = SetFilePointer(hFile, FileOffset.LowPart, &FileOffset.HighPart, FILE_BEGIN);
+        if (FileOffset.LowPart == (DWORD)-1) {
+            Err = GetLastError();
+            if (Err != NO_ERROR) {
+                return Err;
             }
         }
+    }
 
-        if (!ReplaceSucceeded) {
-            if (!MoveFileEx(TempFileName.StartOfString, FileName->StartOfString, MOVEFILE_REPLACE_EXISTING)) {
-                DeleteFile(TempFileName.StartOfString);
-                YoriLibFreeStringContents(&TempFileName);
-                YoriLibConstantString(&Text, _T("Could not replace file with temporary file"));
-                goto DisplayErrorAndFail;
-            }
-        }
-    } else {
-        CloseHandle(WriteHandle);
+    Buffer = YoriLibReferencedMalloc(WindowLength);
+    if (Buffer == NULL) {
+        return ERROR_NOT_ENOUGH_MEMORY;
     }
 
-    HexEditContext->DataOffset = DataOffset;
-    HexEditContext->DataLength = EffectiveDataLength;
+    if (!ReadFile(hFile, Buffer, WindowLength, &BytesRead, NULL)) {
+        Err = GetLastError();
+        YoriLibDereference(Buffer);
+        return Err;
+    }
 
-    YoriLibFreeStringContents(&TempFileName);
-    return TRUE;
+    if (BytesRead > WindowLength ||
+        (!AllowShortRead && BytesRead != WindowLength)) {
 
-DisplayErrorAndFail:
+        YoriLibDereference(Buffer);
+        return ERROR_INVALID_DATA;
+    }
 
-    YoriDlgMessageBox(WinMgrHandle,
-                      &Title,
-                      &Text,
-                      1,
-                      &ButtonText,
-                      0,
-                      0);
+    YoriWinHexEditClear(HexEditContext->HexEdit);
 
-    YoriLibFreeStringContents(&Text);
+    if (!YoriWinHexEditSetDataNoCopy(HexEditContext->HexEdit, Buffer, WindowLength, (YORI_ALLOC_SIZE_T)BytesRead)) {
+        YoriLibDereference(Buffer);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    YoriLibDereference(Buffer);
 
-    return FALSE;
+    HexEditContext->DataOffset = WindowOffset;
+    HexEditContext->DataLength = (YORI_ALLOC_SIZE_T)BytesRead;
+    YoriWinHexEditSetDisplayOffset(HexEditContext->HexEdit, WindowOffset);
+
+    return ERROR_SUCCESS;
 }
 
-VOID
-HexEditSaveButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
-    );
+/**
+ Load the contents of the specified file into the hexedit window.  If the
+ range to load is too large, only the first window of it is loaded, and
+ other windows are loaded as the user navigates to them.
 
-VOID
-HexEditSaveAsButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
-    );
+ @param HexEditContext Pointer to the hexedit context.
 
-/**
- If the file has been modified, prompt the user to save it, and save it if
- requested.
+ @param FileName Pointer to the name of the file to open.
 
- @param Ctrl Pointer to the menu control indicating the action that triggered
-        this prompt.
+ @param DataOffset Specifies the offset within the file to load the data.
 
- @param HexEditContext Pointer to the hexedit context.
+ @param DataLength Specifies the number of bytes of data to load.  If zero,
+        the entire file or device contents are loaded.
 
- @return TRUE to indicate that the requested action should proceed, FALSE to
-         indicate the user has cancelled the request.
+ @return Win32 error code, including ERROR_SUCCESS to indicate success.
  */
-BOOLEAN
-HexEditPromptForSaveIfModified(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl,
-    __in PHEXEDIT_CONTEXT HexEditContext
+DWORD
+HexEditLoadFile(
+    __in PHEXEDIT_CONTEXT HexEditContext,
+    __in PYORI_STRING FileName,
+    __in DWORDLONG DataOffset,
+    __in DWORDLONG DataLength
     )
 {
-    if (YoriWinHexEditGetModifyState(HexEditContext->HexEdit)) {
-        PYORI_WIN_CTRL_HANDLE Parent;
-        YORI_STRING Title;
-        YORI_STRING Text;
-        YORI_STRING ButtonText[3];
-        DWORD ButtonId;
+    HANDLE hFile;
+    LARGE_INTEGER FileSize;
+    DWORDLONG RangeLength;
+    YORI_ALLOC_SIZE_T ReadLength;
+    BOOLEAN Windowed;
+    DWORD Err;
 
-        Parent = YoriWinGetControlParent(HexEditContext->HexEdit);
+    if (FileName->StartOfString == NULL) {
+        return ERROR_INVALID_NAME;
+    }
 
-        YoriLibConstantString(&Title, _T("Save changes"));
-        YoriLibConstantString(&Text, _T("The file has been modified.  Save changes?"));
-        YoriLibConstantString(&ButtonText[0], _T("&Yes"));
-        YoriLibConstantString(&ButtonText[1], _T("&No"));
-        YoriLibConstantString(&ButtonText[2], _T("&Cancel"));
+    ASSERT(YoriLibIsStringNullTerminated(FileName));
 
-        ButtonId = YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
-                                     &Title,
-                                     &Text,
-                                     3,
-                                     ButtonText,
-                                     0,
-                                     2);
+    hFile = CreateFile(FileName->StartOfString, FILE_READ_DATA | FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return GetLastError();
+    }
 
-        //
-        //  If the dialog failed or the cancel button was pressed, don't
-        //  exit.
-        //
+    // 
+    //  MSFIX This doesn't make any sense for a device.  We could detect the
+    //  error and try IOCTL_DISK_GET_LENGTH_INFO, although for a device we
+    //  probably should receive the size to access.
+    //
 
-        if (ButtonId == 0 || ButtonId == 3) {
-            return FALSE;
+    if (DataLength == 0) {
+        Err = YoriLibGetFileOrDeviceSize(hFile, &FileSize.QuadPart);
+        if (Err != ERROR_SUCCESS) {
+            CloseHandle(hFile);
+            return Err;
         }
 
-        //
-        //  If the save button was clicked, invoke save or save as depending
-        //  on whether a file name is present.
-        //
+        RangeLength = 0;
+        if ((DWORDLONG)FileSize.QuadPart > DataOffset) {
+            RangeLength = (DWORDLONG)FileSize.QuadPart - DataOffset;
+        }
+    } else {
+        RangeLength = DataLength;
+    }
 
-        if (ButtonId == 1) {
-            if (HexEditContext->OpenFileName.LengthInChars > 0) {
-                HexEditSaveButtonClicked(Ctrl);
-            } else {
-                HexEditSaveAsButtonClicked(Ctrl);
-            }
+    //
+    //  Load large devices, or any file that is too large to hold in memory,
+    //  one window at a time.
+    //
 
-            //
-            //  If the buffer is still modified, that implies the save didn't
-            //  happen, so cancel.
-            //
+    Windowed = FALSE;
+    if (RangeLength > HEXEDIT_WINDOW_SIZE &&
+        (RangeLength > HEXEDIT_MAXIMUM_FULL_LOAD ||
+         YoriLibIsFileNameDeviceName(FileName) ||
+         !YoriLibIsSizeAllocatable(RangeLength))) {
 
-            if (YoriWinHexEditGetModifyState(HexEditContext->HexEdit)) {
-                return FALSE;
-            }
-        }
+        Windowed = TRUE;
+        ReadLength = HEXEDIT_WINDOW_SIZE;
+    } else if (!YoriLibIsSizeAllocatable(RangeLength)) {
+        CloseHandle(hFile);
+        return ERROR_READ_FAULT;
+    } else {
+        ReadLength = (YORI_ALLOC_SIZE_T)RangeLength;
     }
 
-    return TRUE;
+    //
+    //  If the call requested us to automatically detect the length, tolerate
+    //  it being a little smaller than we expect.  This happens when the
+    //  partition layer passes IOCTLs to the disk, sigh.
+    //
+
+    Err = HexEditReadWindow(HexEditContext, hFile, DataOffset, ReadLength, (BOOLEAN)(DataLength == 0 || Windowed));
+    CloseHandle(hFile);
+    if (Err != ERROR_SUCCESS) {
+        return Err;
+    }
+
+    HexEditContext->RangeOffset = DataOffset;
+    HexEditContext->RangeLength = RangeLength;
+    HexEditContext->Windowed = Windowed;
+
+    return ERROR_SUCCESS;
 }
 
 /**
- A callback invoked when the new menu item is invoked.
+ Write the ranges of the hexedit window that have been modified back to the
+ file or device they were loaded from, leaving the remainder of the file
+ untouched.
 
- @param Ctrl Pointer to the menu bar control.
+ @param HexEditContext Pointer to the hexedit context.
+
+ @param WriteHandle Handle to the file or device, opened for write.
+
+ @param Buffer Pointer to the data in the hexedit window.
+
+ @param BufferLength Specifies the number of bytes in Buffer.
+
+ @param DataOffset Specifies the offset within the file of the first byte
+        in Buffer.
+
+ @param Alignment Specifies the alignment required for each write, in bytes.
+        Each range is expanded to this alignment.  This must be a power of
+        two, and can be one if no alignment is required.
+
+ @return Win32 error code, including ERROR_SUCCESS to indicate success.
  */
-VOID
-HexEditNewButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
+DWORD
+HexEditWriteModifiedRanges(
+    __in PHEXEDIT_CONTEXT HexEditContext,
+    __in HANDLE WriteHandle,
+    __in PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T BufferLength,
+    __in DWORDLONG DataOffset,
+    __in YORI_ALLOC_SIZE_T Alignment
     )
 {
-    PHEXEDIT_CONTEXT HexEditContext;
-    PYORI_WIN_CTRL_HANDLE Parent;
+    DWORD Index;
+    DWORD Err;
+    DWORD BytesWritten;
+    YORI_ALLOC_SIZE_T RangeStart;
+    YORI_ALLOC_SIZE_T RangeLength;
+    YORI_ALLOC_SIZE_T RangeEnd;
+    LARGE_INTEGER FileOffset;
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
+    for (Index = 0; YoriWinHexEditGetModifiedRange(HexEditContext->HexEdit, Index, &RangeStart, &RangeLength); Index++) {
+        RangeEnd = RangeStart + RangeLength;
+        RangeStart = RangeStart & ~(Alignment - 1);
+        RangeEnd = (RangeEnd + Alignment - 1) & ~(Alignment - 1);
+        if (RangeEnd > BufferLength) {
+            RangeEnd = BufferLength;
+        }
 
-    if (!HexEditPromptForSaveIfModified(Ctrl, HexEditContext)) {
-        return;
+        FileOffset.QuadPart = DataOffset + RangeStart;
+        if (SetFilePointer(WriteHandle, FileOffset.LowPart, &FileOffset.HighPart, FILE_BEGIN) == (DWORD)-1) {
+            Err = GetLastError();
+            if (Err != NO_ERROR) {
+                return Err;
+            }
+        }
+
+        if (!WriteFile(WriteHandle, &Buffer[RangeStart], (DWORD)(RangeEnd - RangeStart), &BytesWritten, NULL)) {
+            return GetLastError();
+        }
     }
 
-    YoriWinHexEditClear(HexEditContext->HexEdit);
-    YoriLibFreeStringContents(&HexEditContext->OpenFileName);
-    HexEditUpdateOpenedFileCaption(HexEditContext);
-    YoriWinHexEditSetModifyState(HexEditContext->HexEdit, FALSE);
+    if (!FlushFileBuffers(WriteHandle)) {
+        return GetLastError();
+    }
+
+    return ERROR_SUCCESS;
 }
 
 /**
- Display an open dialog.  The open may be for files or devices.
-
- @param Parent Handle to the main window.
+ Save the contents of the opened window into a file.
 
  @param HexEditContext Pointer to the hexedit context.
 
- @param OpenDevice If TRUE, the open device dialog should be displayed.
-        If FALSE, the open file dialog should be displayed.
+ @param WinMgrHandle Handle to the window manager to use when displaying
+        errors.
+
+ @param FileName Pointer to the name of the file to save.
+
+ @param DataOffset Specifies the offset within the file to store the data.
+
+ @param DataLength Specifies the number of bytes of data to store.  If this
+        differs from the current buffer, the save operation is failed.  If
+        this is zero, the number of bytes is undefined, and any value in the
+        hex edit control buffer can be used.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
  */
-VOID
-HexEditOpenDialog(
-    __in PYORI_WIN_CTRL_HANDLE Parent,
+BOOLEAN
+HexEditSaveFile(
     __in PHEXEDIT_CONTEXT HexEditContext,
-    __in BOOLEAN OpenDevice
+    __in PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgrHandle,
+    __in PYORI_STRING FileName,
+    __in DWORDLONG DataOffset,
+    __in DWORDLONG DataLength
     )
 {
-    YORI_STRING Title;
-    YORI_STRING Text;
-    YORI_STRING FullName;
-    YORI_DLG_FILE_CUSTOM_VALUE ReadOnlyValues[2];
-    YORI_DLG_FILE_CUSTOM_OPTION CustomOptionArray[1];
+    YORI_ALLOC_SIZE_T Index;
+    DWORD Attributes;
     DWORD Err;
-    DWORDLONG DeviceOffset;
-    DWORDLONG DeviceLength;
+    LPTSTR ErrText;
+    YORI_STRING ParentDirectory;
+    YORI_STRING Prefix;
+    YORI_STRING TempFileName;
+    HANDLE WriteHandle;
+    BOOLEAN ReplaceSucceeded;
+    PUCHAR Buffer;
+    YORI_ALLOC_SIZE_T BufferLength;
+    YORI_ALLOC_SIZE_T EffectiveDataLength;
+    DWORD BufferWritten;
+    BOOLEAN InPlace;
+    YORI_STRING Text;
+    YORI_STRING Title;
+    YORI_STRING ButtonText;
 
-    YoriLibConstantString(&ReadOnlyValues[0].ValueText, _T("Open for editing"));
-    YoriLibConstantString(&ReadOnlyValues[1].ValueText, _T("Open read only"));
+    YoriLibInitEmptyString(&TempFileName);
+    YoriLibInitEmptyString(&Text);
+    YoriLibConstantString(&Title, _T("Save"));
+    YoriLibConstantString(&ButtonText, _T("Ok"));
 
-    YoriLibConstantString(&CustomOptionArray[0].Description, _T("&Read Only:"));
-    CustomOptionArray[0].ValueCount = 2;
-    CustomOptionArray[0].Values = ReadOnlyValues;
-    if (HexEditContext->ReadOnly) {
-        CustomOptionArray[0].SelectedValue = 1;
-    } else {
-        CustomOptionArray[0].SelectedValue = 0;
+    if (FileName->StartOfString == NULL) {
+        YoriLibConstantString(&Text, _T("Cannot save: file name not specified"));
+        goto DisplayErrorAndFail;
     }
 
-    YoriLibConstantString(&Title, _T("Open"));
-    YoriLibInitEmptyString(&Text);
+    if (!YoriLibIsSizeAllocatable(DataLength)) {
+        YoriLibConstantString(&Text, _T("Cannot save: device size too large"));
+        goto DisplayErrorAndFail;
+    }
 
-    DeviceOffset = 0;
-    DeviceLength = 0;
+    EffectiveDataLength = (YORI_ALLOC_SIZE_T)DataLength;
 
-    if (OpenDevice) {
-        YoriDlgDevice(YoriWinGetWindowManagerHandle(Parent),
-                      &Title,
-                      sizeof(CustomOptionArray)/sizeof(CustomOptionArray[0]),
-                      CustomOptionArray,
-                      &Text,
-                      &DeviceOffset,
-                      &DeviceLength);
+    ASSERT(YoriLibIsStringNullTerminated(FileName));
 
-    } else {
-        YoriDlgFile(YoriWinGetWindowManagerHandle(Parent),
-                    &Title,
-                    sizeof(CustomOptionArray)/sizeof(CustomOptionArray[0]),
-                    CustomOptionArray,
-                    &Text);
-    }
+    //
+    //  If only a window of the file is loaded, the rest of the file only
+    //  exists on disk, so the window can only be written back to where it
+    //  came from.
+    //
 
-    if (Text.LengthInChars == 0) {
-        YoriLibFreeStringContents(&Text);
-        return;
-    }
-    YoriLibInitEmptyString(&FullName);
+    InPlace = FALSE;
+    if (HexEditContext->Windowed) {
+        if (YoriLibCompareStringIns(FileName, &HexEditContext->OpenFileName) != 0 ||
+            DataOffset != HexEditContext->DataOffset) {
 
-    if (!YoriLibUserStringToSingleFilePath(&Text, TRUE, &FullName)) {
-        YoriLibFreeStringContents(&Text);
-        return;
-    }
-
-    YoriLibFreeStringContents(&Text);
-    Err = HexEditLoadFile(HexEditContext, &FullName, DeviceOffset, DeviceLength);
-    if (Err != ERROR_SUCCESS) {
-        YORI_STRING DialogText;
-        YORI_STRING ButtonText;
-        LPTSTR ErrText;
+            YoriLibConstantString(&Text, _T("Cannot save: only part of the file is loaded"));
+            goto DisplayErrorAndFail;
+        }
+        InPlace = TRUE;
+    } else if (YoriLibIsFileNameDeviceName(FileName) &&
+               YoriLibCompareStringIns(FileName, &HexEditContext->OpenFileName) == 0 &&
+               DataOffset == HexEditContext->DataOffset) {
 
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibInitEmptyString(&DialogText);
-        YoriLibYPrintf(&DialogText, _T("Could not open file: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
+        InPlace = TRUE;
+    }
 
-        YoriLibConstantString(&ButtonText, _T("Ok"));
+    if (!InPlace && !YoriLibIsFileNameDeviceName(FileName)) {
 
-        YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
-                          &Title,
-                          &DialogText,
-                          1,
-                          &ButtonText,
-                          0,
-                          0);
+        //
+        //  Find the parent directory of the user specified file so a temporary
+        //  file can be created in the same directory.  This is done to increase
+        //  the chance that the file is written to the same device as the final
+        //  location and to test that the user can write to the location.
+        //
 
-        YoriLibFreeStringContents(&DialogText);
-        YoriLibFreeStringContents(&FullName);
-        return;
-    }
+        YoriLibInitEmptyString(&ParentDirectory);
+        for (Index = FileName->LengthInChars; Index > 0; Index--) {
+            if (YoriLibIsSep(FileName->StartOfString[Index - 1])) {
+                ParentDirectory.StartOfString = FileName->StartOfString;
+                ParentDirectory.LengthInChars = Index - 1;
+                break;
+            }
+        }
 
-    YoriLibFreeStringContents(&HexEditContext->OpenFileName);
-    memcpy(&HexEditContext->OpenFileName, &FullName, sizeof(YORI_STRING));
-    HexEditUpdateOpenedFileCaption(HexEditContext);
-    YoriWinHexEditSetModifyState(HexEditContext->HexEdit, FALSE);
+        if (Index == 0) {
+            YoriLibConstantString(&ParentDirectory, _T("."));
+        }
 
-    if (CustomOptionArray[0].SelectedValue != 0) {
-        HexEditContext->ReadOnly = TRUE;
-    } else {
-        HexEditContext->ReadOnly = FALSE;
-    }
+        YoriLibConstantString(&Prefix, _T("YEDT"));
 
-    YoriWinHexEditSetReadOnly(HexEditContext->HexEdit, HexEditContext->ReadOnly);
-}
+        if (!YoriLibGetTempFileName(&ParentDirectory, &Prefix, &WriteHandle, &TempFileName)) {
 
-/**
- Display a save as dialog.  The save may be for files or devices.
+            YoriLibYPrintf(&Text, _T("Could not open temporary file in %y"), &ParentDirectory);
+            goto DisplayErrorAndFail;
+        }
 
- @param Parent Handle to the main window.
+    } else {
 
- @param HexEditContext Pointer to the hexedit context.
+        WriteHandle = CreateFile(FileName->StartOfString,
+                                 FILE_WRITE_DATA | FILE_WRITE_ATTRIBUTES | FILE_READ_ATTRIBUTES | SYNCHRONIZE,
+                                 FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                 NULL,
+                                 OPEN_EXISTING,
+                                 YoriLibIsFileNameDeviceName(FileName) ? FILE_FLAG_NO_BUFFERING : 0,
+                                 NULL);
 
- @param SaveDevice If TRUE, the save device dialog should be displayed.
-        If FALSE, the save file dialog should be displayed.
- */
-VOID
-HexEditSaveAsDialog(
-    __in PYORI_WIN_CTRL_HANDLE Parent,
-    __in PHEXEDIT_CONTEXT HexEditContext,
-    __in BOOLEAN SaveDevice
-    )
-{
-    YORI_STRING Title;
-    YORI_STRING Text;
-    YORI_STRING FullName;
-    DWORDLONG DeviceOffset;
-    DWORDLONG DeviceLength;
-    PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgrHandle;
+        if (WriteHandle == INVALID_HANDLE_VALUE) {
+            Err = GetLastError();
+            ErrText = YoriLibGetWinErrorText(Err);
+            YoriLibYPrintf(&Text, _T("Could not open device %s: %s"), FileName->StartOfString, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            goto DisplayErrorAndFail;
+        }
+    }
 
-    WinMgrHandle = YoriWinGetWindowManagerHandle(Parent);
+    YoriWinHexEditGetDataNoCopy(HexEditContext->HexEdit, &Buffer, &BufferLength);
 
-    YoriLibConstantString(&Title, _T("Save As"));
-    YoriLibInitEmptyString(&Text);
+    if (EffectiveDataLength != 0 &&
+        EffectiveDataLength != BufferLength) {
 
-    DeviceOffset = 0;
-    DeviceLength = 0;
+        CloseHandle(WriteHandle);
+        if (TempFileName.LengthInChars > 0) {
+            DeleteFile(TempFileName.StartOfString);
+        }
+        YoriLibFreeStringContents(&TempFileName);
+        if (Buffer != NULL) {
+            YoriLibDereference(Buffer);
+        }
+        YoriLibYPrintf(&Text, _T("Device length %i bytes does not match buffer length %i bytes"), EffectiveDataLength, BufferLength);
+        goto DisplayErrorAndFail;
+    }
 
-    if (SaveDevice) {
-        YoriDlgDevice(WinMgrHandle,
-                      &Title,
-                      0,
-                      NULL,
-                      &Text,
-                      &DeviceOffset,
-                      &DeviceLength);
+    //
+    //  When writing back to the same location, only write the parts that
+    //  changed.  Devices are opened without buffering, so writes need to
+    //  be in whole sectors.
+    //
 
-    } else {
-        YoriDlgFile(WinMgrHandle,
-                    &Title,
-                    0,
-                    NULL,
-                    &Text);
-    }
+    if (InPlace) {
+        Err = ERROR_SUCCESS;
+        if (Buffer != NULL) {
+            Err = HexEditWriteModifiedRanges(HexEditContext,
+                                             WriteHandle,
+                                             Buffer,
+                                             BufferLength,
+                                             DataOffset,
+                                             YoriLibIsFileNameDeviceName(FileName) ? HEXEDIT_SECTOR_ALIGNMENT : 1);
+            YoriLibDereference(Buffer);
+        }
+        CloseHandle(WriteHandle);
 
-    if (Text.LengthInChars == 0) {
-        YoriLibFreeStringContents(&Text);
-        return;
-    }
-    YoriLibInitEmptyString(&FullName);
+        if (Err != ERROR_SUCCESS) {
+            ErrText = YoriLibGetWinErrorText(Err);
+            YoriLibYPrintf(&Text, _T("Could not write to device: %s"), ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            goto DisplayErrorAndFail;
+        }
 
-    if (!YoriLibUserStringToSingleFilePath(&Text, TRUE, &FullName)) {
-        YoriLibFreeStringContents(&Text);
-        return;
+        HexEditContext->DataLength = BufferLength;
+        return TRUE;
     }
 
-    YoriLibFreeStringContents(&Text);
+    if (DataOffset != 0) {
+        LARGE_INTEGER FileOffset;
+        FileOffset.QuadPart = DataOffset;
+        if (SetFilePointer(WriteHandle, FileOffset.LowPart, &FileOffset.HighPart, FILE_BEGIN) == (DWORD)-1 &&
+            GetLastError() != NO_ERROR) {
 
-    if (!HexEditSaveFile(HexEditContext, WinMgrHandle, &FullName, DeviceOffset, DeviceLength)) {
-        YoriLibFreeStringContents(&FullName);
-        return;
+            CloseHandle(WriteHandle);
+            if (Buffer != NULL) {
+                YoriLibDereference(Buffer);
+            }
+            if (TempFileName.LengthInChars > 0) {
+                DeleteFile(TempFileName.StartOfString);
+            }
+            YoriLibFreeStringContents(&TempFileName);
+            YoriLibYPrintf(&Text, _T("Could not seek to offset 0x%llx"), FileOffset.QuadPart);
+            goto DisplayErrorAndFail;
+        }
     }
 
-    YoriLibFreeStringContents(&HexEditContext->OpenFileName);
-    memcpy(&HexEditContext->OpenFileName, &FullName, sizeof(YORI_STRING));
-    HexEditUpdateOpenedFileCaption(HexEditContext);
-    YoriWinHexEditSetModifyState(HexEditContext->HexEdit, FALSE);
-}
+    if (Buffer != NULL) {
 
-/**
- A callback invoked when the open menu item is invoked.
+        //
+        //  MSFIX This is truncating to 4Gb but is probably limited much lower
+        //
 
- @param Ctrl Pointer to the menu bar control.
- */
-VOID
-HexEditOpenButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
-    )
-{
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PHEXEDIT_CONTEXT HexEditContext;
+        if (!WriteFile(WriteHandle, Buffer, (DWORD)BufferLength, &BufferWritten, NULL)) {
+            Err = GetLastError();
+            ErrText = YoriLibGetWinErrorText(Err);
+            CloseHandle(WriteHandle);
+            if (TempFileName.LengthInChars > 0) {
+                DeleteFile(TempFileName.StartOfString);
+            }
+            YoriLibFreeStringContents(&TempFileName);
+            YoriLibDereference(Buffer);
+            YoriLibYPrintf(&Text, _T("Could not write to device: %s"), ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            goto DisplayErrorAndFail;
+        }
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
+        YoriLibDereference(Buffer);
+    }
 
-    HexEditOpenDialog(Parent, HexEditContext, FALSE);
-}
+    if (TempFileName.LengthInChars > 0) {
 
-/**
- A callback invoked when the open menu item is invoked.
+        //
+        //  Flush the temporary file to ensure it's durable, and rename it over
+        //  the top of the chosen file, replacing if necessary.  This ensures
+        //  that the old contents are not deleted until the new contents are
+        //  successfully written.
+        //
 
- @param Ctrl Pointer to the menu bar control.
- */
-VOID
-HexEditOpenDeviceButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
-    )
-{
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PHEXEDIT_CONTEXT HexEditContext;
+        if (!FlushFileBuffers(WriteHandle)) {
+            CloseHandle(WriteHandle);
+            DeleteFile(TempFileName.StartOfString);
+            YoriLibFreeStringContents(&TempFileName);
+            YoriLibConstantString(&Text, _T("Could not flush temporary file"));
+            goto DisplayErrorAndFail;
+        }
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
+        CloseHandle(WriteHandle);
 
-    HexEditOpenDialog(Parent, HexEditContext, TRUE);
-}
+        //
+        //  If the file exists and ReplaceFile is present, replace it. Without
+        //  ReplaceFile or if the file doesn't exist, rename the temporary file
+        //  into place.  If ReplaceFile fails for whatever reason, fall back to
+        //  rename, which implicitly prioritizes succeeding the save to preserving
+        //  whatever file metadata ReplaceFile is aiming to retain.
+        //
 
-VOID
-HexEditSaveAsButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
-    );
+        ReplaceSucceeded = FALSE;
+        Attributes = GetFileAttributes(FileName->StartOfString);
+        if (Attributes != (DWORD)-1 &&
+            DllKernel32.pReplaceFileW != NULL) {
 
-/**
- A callback invoked when the save menu item is invoked.
+            if (DllKernel32.pReplaceFileW(FileName->StartOfString, TempFileName.StartOfString, NULL, 0, NULL, NULL)) {
+                ReplaceSucceeded = TRUE;
+            }
+        }
 
- @param Ctrl Pointer to the menu bar control.
- */
-VOID
-HexEditSaveButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
-    )
-{
-    PHEXEDIT_CONTEXT HexEditContext;
+        if (!ReplaceSucceeded) {
+            if (!MoveFileEx(TempFileName.StartOfString, FileName->StartOfString, MOVEFILE_REPLACE_EXISTING)) {
+                DeleteFile(TempFileName.StartOfString);
+                YoriLibFreeStringContents(&TempFileName);
+                YoriLibConstantString(&Text, _T("Could not replace file with temporary file"));
+                goto DisplayErrorAndFail;
+            }
+        }
+    } else {
+        CloseHandle(WriteHandle);
+    }
 
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgrHandle;
+    HexEditContext->DataOffset = DataOffset;
+    HexEditContext->DataLength = EffectiveDataLength;
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
-    WinMgrHandle = YoriWinGetWindowManagerHandle(Parent);
+    YoriLibFreeStringContents(&TempFileName);
+    return TRUE;
 
-    if (HexEditContext->OpenFileName.StartOfString == NULL) {
-        HexEditSaveAsButtonClicked(Ctrl);
-        return;
-    }
+DisplayErrorAndFail:
 
-    if (!HexEditSaveFile(HexEditContext, WinMgrHandle, &HexEditContext->OpenFileName, HexEditContext->DataOffset, HexEditContext->DataLength)) {
-        return;
-    }
-    YoriWinHexEditSetModifyState(HexEditContext->HexEdit, FALSE);
+    YoriDlgMessageBox(WinMgrHandle,
+                      &Title,
+                      &Text,
+                      1,
+                      &ButtonText,
+                      0,
+                      0);
+
+    YoriLibFreeStringContents(&Text);
+
+    return FALSE;
 }
 
-/**
- A callback invoked when the save as menu item is invoked.
+VOID
+HexEditSaveButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    );
 
- @param Ctrl Pointer to the menu bar control.
- */
 VOID
 HexEditSaveAsButtonClicked(
     __in PYORI_WIN_CTRL_HANDLE Ctrl
-    )
-{
-    PHEXEDIT_CONTEXT HexEditContext;
-    PYORI_WIN_CTRL_HANDLE Parent;
+    );
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
+/**
+ If the file has been modified, prompt the user to save it, and save it if
+ requested.
 
-    HexEditSaveAsDialog(Parent, HexEditContext, FALSE);
-}
+ @param Ctrl Pointer to the menu control indicating the action that triggered
+        this prompt.
 
-/**
- A callback invoked when the save as device menu item is invoked.
+ @param HexEditContext Pointer to the hexedit context.
 
- @param Ctrl Pointer to the menu bar control.
+ @return TRUE to indicate that the requested action should proceed, FALSE to
+         indicate the user has cancelled the request.
  */
-VOID
-HexEditSaveAsDeviceButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
+BOOLEAN
+HexEditPromptForSaveIfModified(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl,
+    __in PHEXEDIT_CONTEXT HexEditContext
     )
 {
-    PHEXEDIT_CONTEXT HexEditContext;
-    PYORI_WIN_CTRL_HANDLE Parent;
+    if (YoriWinHexEditGetModifyState(HexEditContext->HexEdit)) {
+        PYORI_WIN_CTRL_HANDLE Parent;
+        YORI_STRING Title;
+        YORI_STRING Text;
+        YORI_STRING ButtonText[3];
+        DWORD ButtonId;
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
+        Parent = YoriWinGetControlParent(HexEditContext->HexEdit);
 
-    HexEditSaveAsDialog(Parent, HexEditContext, TRUE);
+        YoriLibConstantString(&Title, _T("Save changes"));
+        YoriLibConstantString(&Text, _T("The file has been modified.  Save changes?"));
+        YoriLibConstantString(&ButtonText[0], _T("&Yes"));
+        YoriLibConstantString(&ButtonText[1], _T("&No"));
+        YoriLibConstantString(&ButtonText[2], _T("&Cancel"));
+
+        ButtonId = YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
+                                     &Title,
+                                     &Text,
+                                     3,
+                                     ButtonText,
+                                     0,
+                                     2);
+
+        //
+        //  If the dialog failed or the cancel button was pressed, don't
+        //  exit.
+        //
+
+        if (ButtonId == 0 || ButtonId == 3) {
+            return FALSE;
+        }
+
+        //
+        //  If the save button was clicked, invoke save or save as depending
+        //  on whether a file name is present.
+        //
+
+        if (ButtonId == 1) {
+            if (HexEditContext->OpenFileName.LengthInChars > 0) {
+                HexEditSaveButtonClicked(Ctrl);
+            } else {
+                HexEditSaveAsButtonClicked(Ctrl);
+            }
+
+            //
+            //  If the buffer is still modified, that implies the save didn't
+            //  happen, so cancel.
+            //
+
+            if (YoriWinHexEditGetModifyState(HexEditContext->HexEdit)) {
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
 }
 
 /**
- A callback invoked when the exit button is clicked.
+ A callback invoked when the new menu item is invoked.
 
- @param Ctrl Pointer to the button that was clicked.
+ @param Ctrl Pointer to the menu bar control.
  */
 VOID
-HexEditExitButtonClicked(
+HexEditNewButtonClicked(
     __in PYORI_WIN_CTRL_HANDLE Ctrl
     )
 {
-    PYORI_WIN_CTRL_HANDLE Parent;
     PHEXEDIT_CONTEXT HexEditContext;
+    PYORI_WIN_CTRL_HANDLE Parent;
 
     Parent = YoriWinGetControlParent(Ctrl);
     HexEditContext = YoriWinGetControlContext(Parent);
@@ -1060,72 +1489,212 @@ HexEditExitButtonClicked(
         return;
     }
 
-    YoriWinCloseWindow(Parent, TRUE);
+    HexEditSearchCancel(HexEditContext);
+    YoriWinHexEditClear(HexEditContext->HexEdit);
+    YoriWinHexEditSetDisplayOffset(HexEditContext->HexEdit, 0);
+    HexEditContext->DataOffset = 0;
+    HexEditContext->DataLength = 0;
+    HexEditContext->RangeOffset = 0;
+    HexEditContext->RangeLength = 0;
+    HexEditContext->Windowed = FALSE;
+    YoriLibFreeStringContents(&HexEditContext->OpenFileName);
+    HexEditUpdateOpenedFileCaption(HexEditContext);
+    YoriWinHexEditSetModifyState(HexEditContext->HexEdit, FALSE);
 }
 
 /**
- A callback invoked when the edit menu is opened.
+ Display an open dialog.  The open may be for files or devices.
 
- @param Ctrl Pointer to the menubar control.
+ @param Parent Handle to the main window.
+
+ @param HexEditContext Pointer to the hexedit context.
+
+ @param OpenDevice If TRUE, the open device dialog should be displayed.
+        If FALSE, the open file dialog should be displayed.
  */
 VOID
-HexEditEditButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
+HexEditOpenDialog(
+    __in PYORI_WIN_CTRL_HANDLE Parent,
+    __in PHEXEDIT_CONTEXT HexEditContext,
+    __in BOOLEAN OpenDevice
     )
 {
-    PYORI_WIN_CTRL_HANDLE EditMenu;
-    PYORI_WIN_CTRL_HANDLE CutItem;
-    PYORI_WIN_CTRL_HANDLE CopyItem;
-    PYORI_WIN_CTRL_HANDLE PasteItem;
-    PYORI_WIN_CTRL_HANDLE ClearItem;
-    BOOLEAN DataSelected;
-    PUCHAR ClipboardBuffer;
-    YORI_ALLOC_SIZE_T ClipboardBufferLength;
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PHEXEDIT_CONTEXT HexEditContext;
+    YORI_STRING Title;
+    YORI_STRING Text;
+    YORI_STRING FullName;
+    YORI_DLG_FILE_CUSTOM_VALUE ReadOnlyValues[2];
+    YORI_DLG_FILE_CUSTOM_OPTION CustomOptionArray[1];
+    DWORD Err;
+    DWORDLONG DeviceOffset;
+    DWORDLONG DeviceLength;
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
+    YoriLibConstantString(&ReadOnlyValues[0].ValueText, _T("Open for editing"));
+    YoriLibConstantString(&ReadOnlyValues[1].ValueText, _T("Open read only"));
 
-    ClipboardBuffer = NULL;
-    ClipboardBufferLength = 0;
-    YoriLibPasteBinaryData(&ClipboardBuffer, &ClipboardBufferLength);
+    YoriLibConstantString(&CustomOptionArray[0].Description, _T("&Read Only:"));
+    CustomOptionArray[0].ValueCount = 2;
+    CustomOptionArray[0].Values = ReadOnlyValues;
+    if (HexEditContext->ReadOnly) {
+        CustomOptionArray[0].SelectedValue = 1;
+    } else {
+        CustomOptionArray[0].SelectedValue = 0;
+    }
 
-    DataSelected = YoriWinHexEditSelectionActive(HexEditContext->HexEdit);
-    EditMenu = YoriWinMenuBarGetSubmenuHandle(Ctrl, NULL, HexEditContext->EditMenuIndex);
-    CutItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, HexEditContext->EditCutMenuIndex);
-    CopyItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, HexEditContext->EditCopyMenuIndex);
-    PasteItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, HexEditContext->EditPasteMenuIndex);
-    ClearItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, HexEditContext->EditClearMenuIndex);
+    YoriLibConstantString(&Title, _T("Open"));
+    YoriLibInitEmptyString(&Text);
+
+    DeviceOffset = 0;
+    DeviceLength = 0;
+
+    if (OpenDevice) {
+        YoriDlgDevice(YoriWinGetWindowManagerHandle(Parent),
+                      &Title,
+                      sizeof(CustomOptionArray)/sizeof(CustomOptionArray[0]),
+                      CustomOptionArray,
+                      &Text,
+                      &DeviceOffset,
+                      &DeviceLength);
 
-    if (DataSelected) {
-        YoriWinMenuBarEnableMenuItem(CutItem);
-        YoriWinMenuBarEnableMenuItem(CopyItem);
-        YoriWinMenuBarEnableMenuItem(ClearItem);
     } else {
-        YoriWinMenuBarDisableMenuItem(CutItem);
-        YoriWinMenuBarDisableMenuItem(CopyItem);
-        YoriWinMenuBarDisableMenuItem(ClearItem);
+        YoriDlgFile(YoriWinGetWindowManagerHandle(Parent),
+                    &Title,
+                    sizeof(CustomOptionArray)/sizeof(CustomOptionArray[0]),
+                    CustomOptionArray,
+                    &Text);
     }
 
-    if (ClipboardBuffer != NULL) {
-        YoriWinMenuBarEnableMenuItem(PasteItem);
-    } else {
-        YoriWinMenuBarDisableMenuItem(PasteItem);
+    if (Text.LengthInChars == 0) {
+        YoriLibFreeStringContents(&Text);
+        return;
     }
+    YoriLibInitEmptyString(&FullName);
 
-    if (ClipboardBuffer != NULL) {
-        YoriLibDereference(ClipboardBuffer);
+    if (!YoriLibUserStringToSingleFilePath(&Text, TRUE, &FullName)) {
+        YoriLibFreeStringContents(&Text);
+        return;
     }
-}
 
-/**
- A callback invoked when the cut button is clicked.
+    YoriLibFreeStringContents(&Text);
+    Err = HexEditLoadFile(HexEditContext, &FullName, DeviceOffset, DeviceLength);
+    if (Err != ERROR_SUCCESS) {
+        YORI_STRING DialogText;
+        YORI_STRING ButtonText;
+        LPTSTR ErrText;
 
- @param Ctrl Pointer to the button that was clicked.
+        ErrText = YoriLibGetWinErrorText(Err);
+        YoriLibInitEmptyString(&DialogText);
+        YoriLibYPrintf(&DialogText, _T("Could not open file: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+
+        YoriLibConstantString(&ButtonText, _T("Ok"));
+
+        YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
+                          &Title,
+                          &DialogText,
+                          1,
+                          &ButtonText,
+                          0,
+                          0);
+
+        YoriLibFreeStringContents(&DialogText);
+        YoriLibFreeStringContents(&FullName);
+        return;
+    }
+
+    YoriLibFreeStringContents(&HexEditContext->OpenFileName);
+    memcpy(&HexEditContext->OpenFileName, &FullName, sizeof(YORI_STRING));
+    HexEditUpdateOpenedFileCaption(HexEditContext);
+    YoriWinHexEditSetModifyState(HexEditContext->HexEdit, FALSE);
+
+    if (CustomOptionArray[0].SelectedValue != 0) {
+        HexEditContext->ReadOnly = TRUE;
+    } else {
+        HexEditContext->ReadOnly = FALSE;
+    }
+
+    YoriWinHexEditSetReadOnly(HexEditContext->HexEdit, HexEditContext->ReadOnly);
+}
+
+/**
+ Display a save as dialog.  The save may be for files or devices.
+
+ @param Parent Handle to the main window.
+
+ @param HexEditContext Pointer to the hexedit context.
+
+ @param SaveDevice If TRUE, the save device dialog should be displayed.
+        If FALSE, the save file dialog should be displayed.
  */
 VOID
-HexEditCutButtonClicked(
+HexEditSaveAsDialog(
+    __in PYORI_WIN_CTRL_HANDLE Parent,
+    __in PHEXEDIT_CONTEXT HexEditContext,
+    __in BOOLEAN SaveDevice
+    )
+{
+    YORI_STRING Title;
+    YORI_STRING Text;
+    YORI_STRING FullName;
+    DWORDLONG DeviceOffset;
+    DWORDLONG DeviceLength;
+    PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgrHandle;
+
+    WinMgrHandle = YoriWinGetWindowManagerHandle(Parent);
+
+    YoriLibConstantString(&Title, _T("Save As"));
+    YoriLibInitEmptyString(&Text);
+
+    DeviceOffset = 0;
+    DeviceLength = 0;
+
+    if (SaveDevice) {
+        YoriDlgDevice(WinMgrHandle,
+                      &Title,
+                      0,
+                      NULL,
+                      &Text,
+                      &DeviceOffset,
+                      &DeviceLength);
+
+    } else {
+        YoriDlgFile(WinMgrHandle,
+                    &Title,
+                    0,
+                    NULL,
+                    &Text);
+    }
+
+    if (Text.LengthInChars == 0) {
+        YoriLibFreeStringContents(&Text);
+        return;
+    }
+    YoriLibInitEmptyString(&FullName);
+
+    if (!YoriLibUserStringToSingleFilePath(&Text, TRUE, &FullName)) {
+        YoriLibFreeStringContents(&Text);
+        return;
+    }
+
+    YoriLibFreeStringContents(&Text);
+
+    if (!HexEditSaveFile(HexEditContext, WinMgrHandle, &FullName, DeviceOffset, DeviceLength)) {
+        YoriLibFreeStringContents(&FullName);
+        return;
+    }
+
+    YoriLibFreeStringContents(&HexEditContext->OpenFileName);
+    memcpy(&HexEditContext->OpenFileName, &FullName, sizeof(YORI_STRING));
+    HexEditUpdateOpenedFileCaption(HexEditContext);
+    YoriWinHexEditSetModifyState(HexEditContext->HexEdit, FALSE);
+}
+
+/**
+ A callback invoked when the open menu item is invoked.
+
+ @param Ctrl Pointer to the menu bar control.
+ */
+VOID
+HexEditOpenButtonClicked(
     __in PYORI_WIN_CTRL_HANDLE Ctrl
     )
 {
@@ -1135,16 +1704,16 @@ HexEditCutButtonClicked(
     Parent = YoriWinGetControlParent(Ctrl);
     HexEditContext = YoriWinGetControlContext(Parent);
 
-    YoriWinHexEditCutSelectedData(HexEditContext->HexEdit);
+    HexEditOpenDialog(Parent, HexEditContext, FALSE);
 }
 
 /**
- A callback invoked when the copy button is clicked.
+ A callback invoked when the open menu item is invoked.
 
- @param Ctrl Pointer to the button that was clicked.
+ @param Ctrl Pointer to the menu bar control.
  */
 VOID
-HexEditCopyButtonClicked(
+HexEditOpenDeviceButtonClicked(
     __in PYORI_WIN_CTRL_HANDLE Ctrl
     )
 {
@@ -1154,131 +1723,321 @@ HexEditCopyButtonClicked(
     Parent = YoriWinGetControlParent(Ctrl);
     HexEditContext = YoriWinGetControlContext(Parent);
 
-    YoriWinHexEditCopySelectedData(HexEditContext->HexEdit);
+    HexEditOpenDialog(Parent, HexEditContext, TRUE);
 }
 
+VOID
+HexEditSaveAsButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    );
+
 /**
- A callback invoked when the paste button is clicked.
+ A callback invoked when the save menu item is invoked.
 
- @param Ctrl Pointer to the button that was clicked.
+ @param Ctrl Pointer to the menu bar control.
  */
 VOID
-HexEditPasteButtonClicked(
+HexEditSaveButtonClicked(
     __in PYORI_WIN_CTRL_HANDLE Ctrl
     )
 {
-    PYORI_WIN_CTRL_HANDLE Parent;
     PHEXEDIT_CONTEXT HexEditContext;
 
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgrHandle;
+
     Parent = YoriWinGetControlParent(Ctrl);
     HexEditContext = YoriWinGetControlContext(Parent);
+    WinMgrHandle = YoriWinGetWindowManagerHandle(Parent);
 
-    YoriWinHexEditPasteData(HexEditContext->HexEdit);
+    if (HexEditContext->OpenFileName.StartOfString == NULL) {
+        HexEditSaveAsButtonClicked(Ctrl);
+        return;
+    }
+
+    if (!HexEditSaveFile(HexEditContext, WinMgrHandle, &HexEditContext->OpenFileName, HexEditContext->DataOffset, HexEditContext->DataLength)) {
+        return;
+    }
+    YoriWinHexEditSetModifyState(HexEditContext->HexEdit, FALSE);
 }
 
 /**
- A callback invoked when the clear button is clicked.
+ A callback invoked when the save as menu item is invoked.
 
- @param Ctrl Pointer to the button that was clicked.
+ @param Ctrl Pointer to the menu bar control.
  */
 VOID
-HexEditClearButtonClicked(
+HexEditSaveAsButtonClicked(
     __in PYORI_WIN_CTRL_HANDLE Ctrl
     )
 {
-    PYORI_WIN_CTRL_HANDLE Parent;
     PHEXEDIT_CONTEXT HexEditContext;
+    PYORI_WIN_CTRL_HANDLE Parent;
 
     Parent = YoriWinGetControlParent(Ctrl);
     HexEditContext = YoriWinGetControlContext(Parent);
-    YoriWinHexEditDeleteSelection(HexEditContext->HexEdit);
-    YoriWinHexEditSetModifyState(HexEditContext->HexEdit, TRUE);
-}
 
+    HexEditSaveAsDialog(Parent, HexEditContext, FALSE);
+}
 
 /**
- Search forward through a memory buffer looking for a matching sub-buffer.
- Both are treated as opaque binary buffers.
-
- @param Buffer Pointer to the master buffer that may contain a match.
-
- @param BufferLength The length of the master buffer, in bytes.
+ A callback invoked when the save as device menu item is invoked.
 
- @param BufferOffset The initial offset to search within the master buffer,
-        in bytes.
+ @param Ctrl Pointer to the menu bar control.
+ */
+VOID
+HexEditSaveAsDeviceButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PHEXEDIT_CONTEXT HexEditContext;
+    PYORI_WIN_CTRL_HANDLE Parent;
 
- @param SearchBuffer Pointer to the buffer to search for.
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
 
- @param SearchBufferLength The length of the search buffer, in bytes.
+    HexEditSaveAsDialog(Parent, HexEditContext, TRUE);
+}
 
- @param FoundOffset On successful completion (ie., a match is found), updated
-        to point to the offset within the master buffer of the match.
+/**
+ A callback invoked when the exit button is clicked.
 
- @return TRUE to indicate a match was found, FALSE if no match was found.
+ @param Ctrl Pointer to the button that was clicked.
  */
-__success(return)
-BOOLEAN
-HexEditFindNextMemorySubset(
-    __in PUCHAR Buffer,
-    __in YORI_ALLOC_SIZE_T BufferLength,
-    __in YORI_ALLOC_SIZE_T BufferOffset,
-    __in PUCHAR SearchBuffer,
-    __in YORI_ALLOC_SIZE_T SearchBufferLength,
-    __out PYORI_ALLOC_SIZE_T FoundOffset
+VOID
+HexEditExitButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
     )
 {
-    YORI_ALLOC_SIZE_T BufferIndex;
-    YORI_ALLOC_SIZE_T SearchBufferIndex;
-    YORI_ALLOC_SIZE_T EndIndex;
-
-    if (BufferOffset > BufferLength ||
-        BufferLength - BufferOffset < SearchBufferLength) {
-
-        return FALSE;
-    }
-
-    EndIndex = BufferLength - SearchBufferLength + 1;
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
 
-    for (BufferIndex = BufferOffset; BufferIndex < EndIndex; BufferIndex++) {
-        for (SearchBufferIndex = 0; SearchBufferIndex < SearchBufferLength; SearchBufferIndex++) {
-            if (Buffer[BufferIndex + SearchBufferIndex] != SearchBuffer[SearchBufferIndex]) {
-                break;
-            }
-        }
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
 
-        if (SearchBufferIndex == SearchBufferLength) {
-            *FoundOffset = BufferIndex;
-            return TRUE;
-        }
+    if (!HexEditPromptForSaveIfModified(Ctrl, HexEditContext)) {
+        return;
     }
 
-    return FALSE;
+    YoriWinCloseWindow(Parent, TRUE);
 }
 
 /**
- Search backward through a memory buffer looking for a matching sub-buffer.
- Both are treated as opaque binary buffers.
-
- @param Buffer Pointer to the master buffer that may contain a match.
-
- @param BufferLength The length of the master buffer, in bytes.
-
- @param BufferOffset The initial offset to search within the master buffer,
-        in bytes.
-
- @param SearchBuffer Pointer to the buffer to search for.
-
- @param SearchBufferLength The length of the search buffer, in bytes.
-
- @param FoundOffset On successful completion (ie., a match is found), updated
-        to point to the offset within the master buffer of the match.
+ A callback invoked when the edit menu is opened.
 
- @return TRUE to indicate a match was found, FALSE if no match was found.
+ @param Ctrl Pointer to the menubar control.
  */
-__success(return)
-BOOLEAN
-HexEditFindPreviousMemorySubset(
-    __in PUCHAR Buffer,
+VOID
+HexEditEditButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE EditMenu;
+    PYORI_WIN_CTRL_HANDLE CutItem;
+    PYORI_WIN_CTRL_HANDLE CopyItem;
+    PYORI_WIN_CTRL_HANDLE PasteItem;
+    PYORI_WIN_CTRL_HANDLE ClearItem;
+    BOOLEAN DataSelected;
+    PUCHAR ClipboardBuffer;
+    YORI_ALLOC_SIZE_T ClipboardBufferLength;
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    ClipboardBuffer = NULL;
+    ClipboardBufferLength = 0;
+    YoriLibPasteBinaryData(&ClipboardBuffer, &ClipboardBufferLength);
+
+    DataSelected = YoriWinHexEditSelectionActive(HexEditContext->HexEdit);
+    EditMenu = YoriWinMenuBarGetSubmenuHandle(Ctrl, NULL, HexEditContext->EditMenuIndex);
+    CutItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, HexEditContext->EditCutMenuIndex);
+    CopyItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, HexEditContext->EditCopyMenuIndex);
+    PasteItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, HexEditContext->EditPasteMenuIndex);
+    ClearItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, HexEditContext->EditClearMenuIndex);
+
+    if (DataSelected) {
+        YoriWinMenuBarEnableMenuItem(CutItem);
+        YoriWinMenuBarEnableMenuItem(CopyItem);
+        YoriWinMenuBarEnableMenuItem(ClearItem);
+    } else {
+        YoriWinMenuBarDisableMenuItem(CutItem);
+        YoriWinMenuBarDisableMenuItem(CopyItem);
+        YoriWinMenuBarDisableMenuItem(ClearItem);
+    }
+
+    if (ClipboardBuffer != NULL) {
+        YoriWinMenuBarEnableMenuItem(PasteItem);
+    } else {
+        YoriWinMenuBarDisableMenuItem(PasteItem);
+    }
+
+    if (ClipboardBuffer != NULL) {
+        YoriLibDereference(ClipboardBuffer);
+    }
+}
+
+/**
+ A callback invoked when the cut button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+HexEditCutButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    YoriWinHexEditCutSelectedData(HexEditContext->HexEdit);
+}
+
+/**
+ A callback invoked when the copy button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+HexEditCopyButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    YoriWinHexEditCopySelectedData(HexEditContext->HexEdit);
+}
+
+/**
+ A callback invoked when the paste button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+HexEditPasteButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    YoriWinHexEditPasteData(HexEditContext->HexEdit);
+}
+
+/**
+ A callback invoked when the clear button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+HexEditClearButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+    YoriWinHexEditDeleteSelection(HexEditContext->HexEdit);
+    YoriWinHexEditSetModifyState(HexEditContext->HexEdit, TRUE);
+}
+
+
+/**
+ Search forward through a memory buffer looking for a matching sub-buffer.
+ Both are treated as opaque binary buffers.
+
+ @param Buffer Pointer to the master buffer that may contain a match.
+
+ @param BufferLength The length of the master buffer, in bytes.
+
+ @param BufferOffset The initial offset to search within the master buffer,
+        in bytes.
+
+ @param SearchBuffer Pointer to the buffer to search for.
+
+ @param SearchBufferLength The length of the search buffer, in bytes.
+
+ @param FoundOffset On successful completion (ie., a match is found), updated
+        to point to the offset within the master buffer of the match.
+
+ @return TRUE to indicate a match was found, FALSE if no match was found.
+ */
+__success(return)
+BOOLEAN
+HexEditFindNextMemorySubset(
+    __in PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T BufferLength,
+    __in YORI_ALLOC_SIZE_T BufferOffset,
+    __in PUCHAR SearchBuffer,
+    __in YORI_ALLOC_SIZE_T SearchBufferLength,
+    __out PYORI_ALLOC_SIZE_T FoundOffset
+    )
+{
+    YORI_ALLOC_SIZE_T BufferIndex;
+    YORI_ALLOC_SIZE_T SearchBufferIndex;
+    YORI_ALLOC_SIZE_T EndIndex;
+
+    if (BufferOffset > BufferLength ||
+        BufferLength - BufferOffset < SearchBufferLength) {
+
+        return FALSE;
+    }
+
+    EndIndex = BufferLength - SearchBufferLength + 1;
+
+    for (BufferIndex = BufferOffset; BufferIndex < EndIndex; BufferIndex++) {
+        for (SearchBufferIndex = 0; SearchBufferIndex < SearchBufferLength; SearchBufferIndex++) {
+            if (Buffer[BufferIndex + SearchBufferIndex] != SearchBuffer[SearchBufferIndex]) {
+                break;
+            }
+        }
+
+        if (SearchBufferIndex == SearchBufferLength) {
+            *FoundOffset = BufferIndex;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Search backward through a memory buffer looking for a matching sub-buffer.
+ Both are treated as opaque binary buffers.
+
+ @param Buffer Pointer to the master buffer that may contain a match.
+
+ @param BufferLength The length of the master buffer, in bytes.
+
+ @param BufferOffset The initial offset to search within the master buffer,
+        in bytes.
+
+ @param SearchBuffer Pointer to the buffer to search for.
+
+ @param SearchBufferLength The length of the search buffer, in bytes.
+
+ @param FoundOffset On successful completion (ie., a match is found), updated
+        to point to the offset within the master buffer of the match.
+
+ @return TRUE to indicate a match was found, FALSE if no match was found.
+ */
+__success(return)
+BOOLEAN
+HexEditFindPreviousMemorySubset(
+    __in PUCHAR Buffer,
     __in YORI_ALLOC_SIZE_T BufferLength,
     __in YORI_ALLOC_SIZE_T BufferOffset,
     __in PUCHAR SearchBuffer,
@@ -1543,6 +2302,7 @@ HexEditFindButtonClicked(
 
     HexEditContext->SearchBuffer = FindData;
     HexEditContext->SearchBufferLength = FindDataLength;
+    HexEditContext->SearchMask = NULL;
     if (!HexEditFindNextFromCurrentPosition(HexEditContext, FALSE)) {
         YORI_STRING ButtonText[1];
         YORI_STRING Text;
@@ -1561,6 +2321,12 @@ HexEditFindButtonClicked(
     }
 }
 
+BOOLEAN
+HexEditStartPatternSearch(
+    __in PHEXEDIT_CONTEXT HexEditContext,
+    __in BOOLEAN StartAtNextByte
+    );
+
 /**
  A callback invoked when the repeat last find menu item is invoked.
 
@@ -1583,6 +2349,16 @@ HexEditFindNextButtonClicked(
         return;
     }
 
+    //
+    //  If the last find was for a pattern, search for the next match in
+    //  the background.
+    //
+
+    if (HexEditContext->SearchMask != NULL) {
+        HexEditStartPatternSearch(HexEditContext, TRUE);
+        return;
+    }
+
     if (!HexEditFindNextFromCurrentPosition(HexEditContext, TRUE)) {
         YORI_STRING Title;
         YORI_STRING Text;
@@ -1618,8 +2394,13 @@ HexEditFindPreviousButtonClicked(
     Parent = YoriWinGetControlParent(Ctrl);
     HexEditContext = YoriWinGetControlContext(Parent);
 
+    //
+    //  Patterns are only searched for forward.
+    //
+
     if (HexEditContext->SearchBuffer == NULL ||
-        HexEditContext->SearchBufferLength == 0) {
+        HexEditContext->SearchBufferLength == 0 ||
+        HexEditContext->SearchMask != NULL) {
 
         return;
     }
@@ -1688,6 +2469,8 @@ HexEditChangeButtonClicked(
     ReplaceAll = FALSE;
     MatchFound = FALSE;
 
+    HexEditSearchCancel(HexEditContext);
+
     YoriWinHexEditGetCursorLocation(HexEditContext->HexEdit, &AsChar, &StartOffset, &BitShift);
 
     while(TRUE) {
@@ -1807,6 +2590,7 @@ HexEditChangeButtonClicked(
             YoriLibReference(OldData);
             HexEditContext->SearchBuffer = OldData;
             HexEditContext->SearchBufferLength = OldDataLength;
+            HexEditContext->SearchMask = NULL;
         }
 
         if (MatchFound) {
@@ -1834,509 +2618,1280 @@ HexEditChangeButtonClicked(
         StartOffset = NextMatchOffset;
     }
 
-    HexEditFreeDataBuffer(&OldData, &OldDataLength);
-    HexEditFreeDataBuffer(&NewData, &NewDataLength);
+    HexEditFreeDataBuffer(&OldData, &OldDataLength);
+    HexEditFreeDataBuffer(&NewData, &NewDataLength);
+}
+
+
+/**
+ Load a different window of a file or device that is too large to load in
+ its entirety, and move the cursor to a specified offset.  If the currently
+ loaded window has been modified, the user is prompted to save it first.
+
+ @param Ctrl Pointer to a control within the main window.
+
+ @param HexEditContext Pointer to the hexedit context.
+
+ @param WindowOffset Specifies the requested start of the window, as an
+        offset within the file.  This is aligned down and constrained to
+        the range opened for editing.
+
+ @param CursorOffset Specifies the offset within the file to move the
+        cursor to once the window is loaded.
+
+ @return TRUE to indicate the window was loaded, FALSE if it was not.
+ */
+BOOLEAN
+HexEditMoveWindow(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl,
+    __in PHEXEDIT_CONTEXT HexEditContext,
+    __in DWORDLONG WindowOffset,
+    __in DWORDLONG CursorOffset
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    DWORDLONG RangeEnd;
+    DWORDLONG WindowLength;
+    HANDLE hFile;
+    DWORD Err;
+
+    ASSERT(HexEditContext->Windowed);
+    ASSERT(HexEditContext->RangeLength > 0);
+
+    if (!HexEditPromptForSaveIfModified(Ctrl, HexEditContext)) {
+        return FALSE;
+    }
+
+    RangeEnd = HexEditContext->RangeOffset + HexEditContext->RangeLength;
+    if (WindowOffset >= RangeEnd) {
+        WindowOffset = RangeEnd - 1;
+    }
+
+    WindowOffset = WindowOffset & ~((DWORDLONG)HEXEDIT_WINDOW_ALIGNMENT - 1);
+    if (WindowOffset < HexEditContext->RangeOffset) {
+        WindowOffset = HexEditContext->RangeOffset;
+    }
+
+    WindowLength = RangeEnd - WindowOffset;
+    if (WindowLength > HEXEDIT_WINDOW_SIZE) {
+        WindowLength = HEXEDIT_WINDOW_SIZE;
+    }
+
+    hFile = CreateFile(HexEditContext->OpenFileName.StartOfString, FILE_READ_DATA | FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        Err = GetLastError();
+    } else {
+        Err = HexEditReadWindow(HexEditContext, hFile, WindowOffset, (YORI_ALLOC_SIZE_T)WindowLength, TRUE);
+        CloseHandle(hFile);
+    }
+
+    Parent = YoriWinGetControlParent(Ctrl);
+
+    if (Err != ERROR_SUCCESS) {
+        YORI_STRING Title;
+        YORI_STRING DialogText;
+        YORI_STRING ButtonText;
+        LPTSTR ErrText;
+
+        ErrText = YoriLibGetWinErrorText(Err);
+        YoriLibInitEmptyString(&DialogText);
+        YoriLibYPrintf(&DialogText, _T("Could not read file: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+
+        YoriLibConstantString(&Title, _T("Error"));
+        YoriLibConstantString(&ButtonText, _T("Ok"));
+
+        YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
+                          &Title,
+                          &DialogText,
+                          1,
+                          &ButtonText,
+                          0,
+                          0);
+
+        YoriLibFreeStringContents(&DialogText);
+        return FALSE;
+    }
+
+    YoriWinHexEditSetModifyState(HexEditContext->HexEdit, FALSE);
+    YoriWinHexEditSetReadOnly(HexEditContext->HexEdit, HexEditContext->ReadOnly);
+
+    if (CursorOffset < HexEditContext->DataOffset) {
+        CursorOffset = HexEditContext->DataOffset;
+    } else if (HexEditContext->DataLength > 0 &&
+               CursorOffset >= HexEditContext->DataOffset + HexEditContext->DataLength) {
+        CursorOffset = HexEditContext->DataOffset + HexEditContext->DataLength - 1;
+    }
+
+    YoriWinHexEditSetCursorLocation(HexEditContext->HexEdit, FALSE, (YORI_ALLOC_SIZE_T)(CursorOffset - HexEditContext->DataOffset), 0);
+    return TRUE;
+}
+
+/**
+ A callback invoked when the go to menu item is invoked.
+
+ @param Ctrl Pointer to the menu bar control.
+ */
+VOID
+HexEditGoToButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    YORI_STRING Title;
+    YORI_STRING Text;
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+    YORI_MAX_SIGNED_T SignedNewOffset;
+    YORI_MAX_UNSIGNED_T NewOffset;
+    DWORDLONG WindowOffset;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    YoriLibConstantString(&Title, _T("Go to"));
+    YoriLibInitEmptyString(&Text);
+
+    YoriDlgInput(YoriWinGetWindowManagerHandle(Parent),
+                 &Title,
+                 TRUE,
+                 &Text);
+
+    if (Text.LengthInChars == 0) {
+        YoriLibFreeStringContents(&Text);
+        return;
+    }
+
+    if (YoriLibStringToNumber(&Text, FALSE, &SignedNewOffset, &CharsConsumed) &&
+        CharsConsumed > 0) {
+
+        if (SignedNewOffset < 0) {
+            NewOffset = 0;
+        } else {
+            NewOffset = (YORI_MAX_UNSIGNED_T)SignedNewOffset;
+        }
+
+        if (HexEditContext->Windowed &&
+            (NewOffset < HexEditContext->DataOffset ||
+             NewOffset >= HexEditContext->DataOffset + HexEditContext->DataLength)) {
+
+            //
+            //  Load a window with the requested offset in the middle so the
+            //  user can move in either direction.
+            //
+
+            WindowOffset = HexEditContext->RangeOffset;
+            if (NewOffset > WindowOffset + HEXEDIT_WINDOW_SIZE / 2) {
+                WindowOffset = NewOffset - HEXEDIT_WINDOW_SIZE / 2;
+            }
+
+            HexEditMoveWindow(Ctrl, HexEditContext, WindowOffset, NewOffset);
+        } else {
+            if (NewOffset < HexEditContext->DataOffset) {
+                NewOffset = HexEditContext->DataOffset;
+            }
+
+            YoriWinHexEditSetCursorLocation(HexEditContext->HexEdit, FALSE, (YORI_ALLOC_SIZE_T)(NewOffset - HexEditContext->DataOffset), 0);
+        }
+    }
+
+    YoriLibFreeStringContents(&Text);
+}
+
+/**
+ A callback invoked when the next window menu item is invoked.
+
+ @param Ctrl Pointer to the menu bar control.
+ */
+VOID
+HexEditNextWindowButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+    DWORDLONG NewOffset;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    if (!HexEditContext->Windowed) {
+        return;
+    }
+
+    NewOffset = HexEditContext->DataOffset + HexEditContext->DataLength;
+    if (NewOffset >= HexEditContext->RangeOffset + HexEditContext->RangeLength) {
+        return;
+    }
+
+    HexEditMoveWindow(Ctrl, HexEditContext, NewOffset, NewOffset);
+}
+
+/**
+ A callback invoked when the previous window menu item is invoked.
+
+ @param Ctrl Pointer to the menu bar control.
+ */
+VOID
+HexEditPreviousWindowButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+    DWORDLONG WindowOffset;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    if (!HexEditContext->Windowed ||
+        HexEditContext->DataOffset <= HexEditContext->RangeOffset) {
+
+        return;
+    }
+
+    WindowOffset = HexEditContext->RangeOffset;
+    if (HexEditContext->DataOffset > WindowOffset + HEXEDIT_WINDOW_SIZE) {
+        WindowOffset = HexEditContext->DataOffset - HEXEDIT_WINDOW_SIZE;
+    }
+
+    HexEditMoveWindow(Ctrl, HexEditContext, WindowOffset, HexEditContext->DataOffset - 1);
+}
+
+/**
+ A callback invoked when the view button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+HexEditViewButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+    PYORI_WIN_CTRL_HANDLE ViewMenu;
+    PYORI_WIN_CTRL_HANDLE ViewBytesItem;
+    PYORI_WIN_CTRL_HANDLE ViewWordsItem;
+    PYORI_WIN_CTRL_HANDLE ViewDwordsItem;
+    PYORI_WIN_CTRL_HANDLE ViewQwordsItem;
+    PYORI_WIN_CTRL_HANDLE ViewNoOffsetItem;
+    PYORI_WIN_CTRL_HANDLE ViewShortOffsetItem;
+    PYORI_WIN_CTRL_HANDLE ViewLongOffsetItem;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    ViewMenu = YoriWinMenuBarGetSubmenuHandle(Ctrl, NULL, HexEditContext->ViewMenuIndex);
+    ViewBytesItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, ViewMenu, HexEditContext->ViewBytesMenuIndex);
+    ViewWordsItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, ViewMenu, HexEditContext->ViewWordsMenuIndex);
+    ViewDwordsItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, ViewMenu, HexEditContext->ViewDwordsMenuIndex);
+    ViewQwordsItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, ViewMenu, HexEditContext->ViewQwordsMenuIndex);
+    ViewNoOffsetItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, ViewMenu, HexEditContext->ViewNoOffsetMenuIndex);
+    ViewShortOffsetItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, ViewMenu, HexEditContext->ViewShortOffsetMenuIndex);
+    ViewLongOffsetItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, ViewMenu, HexEditContext->ViewLongOffsetMenuIndex);
+
+    YoriWinMenuBarUncheckMenuItem(ViewBytesItem);
+    YoriWinMenuBarUncheckMenuItem(ViewWordsItem);
+    YoriWinMenuBarUncheckMenuItem(ViewDwordsItem);
+    YoriWinMenuBarUncheckMenuItem(ViewQwordsItem);
+
+    YoriWinMenuBarUncheckMenuItem(ViewNoOffsetItem);
+    YoriWinMenuBarUncheckMenuItem(ViewShortOffsetItem);
+    YoriWinMenuBarUncheckMenuItem(ViewLongOffsetItem);
+
+    switch(HexEditContext->BytesPerWord) {
+        case 1:
+            YoriWinMenuBarCheckMenuItem(ViewBytesItem);
+            break;
+        case 2:
+            YoriWinMenuBarCheckMenuItem(ViewWordsItem);
+            break;
+        case 4:
+            YoriWinMenuBarCheckMenuItem(ViewDwordsItem);
+            break;
+        case 8:
+            YoriWinMenuBarCheckMenuItem(ViewQwordsItem);
+            break;
+    }
+
+    switch(HexEditContext->OffsetWidth) {
+        case 0:
+            YoriWinMenuBarCheckMenuItem(ViewNoOffsetItem);
+            break;
+        case 32:
+            YoriWinMenuBarCheckMenuItem(ViewShortOffsetItem);
+            break;
+        case 64:
+            YoriWinMenuBarCheckMenuItem(ViewLongOffsetItem);
+            break;
+    }
+}
+
+/**
+ A callback invoked when the view bytes button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+HexEditViewBytesButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    HexEditContext->BytesPerWord = 1;
+    YoriWinHexEditSetBytesPerWord(HexEditContext->HexEdit, HexEditContext->BytesPerWord);
+}
+
+/**
+ A callback invoked when the view words button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+HexEditViewWordsButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    HexEditContext->BytesPerWord = 2;
+    YoriWinHexEditSetBytesPerWord(HexEditContext->HexEdit, HexEditContext->BytesPerWord);
+}
+
+/**
+ A callback invoked when the view dwords button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+HexEditViewDwordsButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    HexEditContext->BytesPerWord = 4;
+    YoriWinHexEditSetBytesPerWord(HexEditContext->HexEdit, HexEditContext->BytesPerWord);
+}
+
+/**
+ A callback invoked when the view qwords button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+HexEditViewQwordsButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    HexEditContext->BytesPerWord = 8;
+    YoriWinHexEditSetBytesPerWord(HexEditContext->HexEdit, HexEditContext->BytesPerWord);
+}
+
+/**
+ A callback invoked when the no offset button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+HexEditViewNoOffsetButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    if (YoriWinHexEditSetStyle(HexEditContext->HexEdit, 0)) {
+        HexEditContext->OffsetWidth = 0;
+    }
+}
+
+/**
+ A callback invoked when the short offset button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+HexEditViewShortOffsetButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    if (YoriWinHexEditSetStyle(HexEditContext->HexEdit, YORI_WIN_HEX_EDIT_STYLE_OFFSET)) {
+        HexEditContext->OffsetWidth = 32;
+    }
+}
+
+/**
+ A callback invoked when the long offset button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+HexEditViewLongOffsetButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    if (YoriWinHexEditSetStyle(HexEditContext->HexEdit, YORI_WIN_HEX_EDIT_STYLE_LARGE_OFFSET)) {
+        HexEditContext->OffsetWidth = 64;
+    }
+}
+
+/**
+ A callback invoked when the calculate PE checksum menu item is invoked.
+
+ @param Ctrl Pointer to the menu bar control.
+ */
+VOID
+HexEditCalculatePEChecksumButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+    YORI_STRING Title;
+    YORI_STRING Text;
+    YORI_STRING ButtonText[1];
+    PYORILIB_PE_HEADERS PeHeaders;
+    PUCHAR Buffer;
+    YORI_ALLOC_SIZE_T BufferLength;
+    DWORD CurrentChecksum;
+    DWORD NewChecksum;
+    YORI_ALLOC_SIZE_T DataOffset;
+
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    YoriLibLoadImageHlpFunctions();
+
+    if (DllImageHlp.pCheckSumMappedFile == NULL) {
+        YoriLibConstantString(&Title, _T("Error"));
+        YoriLibConstantString(&Text, _T("OS support not present"));
+        YoriLibConstantString(&ButtonText[0], _T("&Ok"));
+
+        YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
+                          &Title,
+                          &Text,
+                          1,
+                          ButtonText,
+                          0,
+                          0);
+
+        return;
+    }
+
+    if (!YoriWinHexEditGetDataNoCopy(HexEditContext->HexEdit, &Buffer, &BufferLength)) {
+        return;
+    }
+
+    PeHeaders = DllImageHlp.pCheckSumMappedFile(Buffer, BufferLength, &CurrentChecksum, &NewChecksum);
+    if (PeHeaders == NULL) {
+        YoriLibDereference(Buffer);
+        YoriLibConstantString(&Title, _T("Error"));
+        YoriLibConstantString(&Text, _T("Could not calculate checksum.  Possibly not PE file?"));
+        YoriLibConstantString(&ButtonText[0], _T("&Ok"));
+
+        YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
+                          &Title,
+                          &Text,
+                          1,
+                          ButtonText,
+                          0,
+                          0);
+        return;
+    }
+
+
+    DataOffset = (YORI_ALLOC_SIZE_T)((PUCHAR)PeHeaders - Buffer);
+    DataOffset = DataOffset + FIELD_OFFSET(YORILIB_PE_HEADERS, OptionalHeader.CheckSum);
+    YoriLibDereference(Buffer);
+    YoriWinHexEditReplaceData(HexEditContext->HexEdit, DataOffset, &NewChecksum, sizeof(NewChecksum));
+}
+
+/**
+ A callback invoked when the about menu item is invoked.
+
+ @param Ctrl Pointer to the menu bar control.
+ */
+VOID
+HexEditAboutButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    YORI_STRING Title;
+    YORI_STRING Text;
+    YORI_STRING LeftText;
+    YORI_STRING CenteredText;
+    YORI_STRING ButtonTexts[2];
+    YORI_ALLOC_SIZE_T Index;
+    DWORD ButtonClicked;
+
+    PYORI_WIN_CTRL_HANDLE Parent;
+    Parent = YoriWinGetControlParent(Ctrl);
+
+    YoriLibConstantString(&Title, _T("About"));
+    YoriLibInitEmptyString(&Text);
+    YoriLibYPrintf(&Text,
+                   _T("HexEdit %i.%02i\n")
+#if YORI_BUILD_ID
+                   _T("Build %i\n")
+#endif
+                   _T("%hs"),
+
+                   YORI_VER_MAJOR,
+                   YORI_VER_MINOR,
+#if YORI_BUILD_ID
+                   YORI_BUILD_ID,
+#endif
+                   strHexEditHelpText);
+
+    if (Text.StartOfString == NULL) {
+        return;
+    }
+
+    //
+    //  Search through the combined string to find the split point where
+    //  earlier text should be centered and later text should be left
+    //  aligned.  This is done to allow documentation for switches to be
+    //  legible.  The split point is therefore defined as the first place
+    //  a newline is followed by a space, indicating documentation for a
+    //  switch.
+    //
+    //  Note the label control will swallow all leading spaces in a line.
+    //
+
+    YoriLibInitEmptyString(&CenteredText);
+    YoriLibInitEmptyString(&LeftText);
+
+    for (Index = 0; Index < Text.LengthInChars; Index++) {
+        if (Text.StartOfString[Index] == '\n' &&
+            Index + 1 < Text.LengthInChars &&
+            Text.StartOfString[Index + 1] == ' ') {
+
+            CenteredText.StartOfString = Text.StartOfString;
+            CenteredText.LengthInChars = Index;
+
+            LeftText.StartOfString = &Text.StartOfString[Index + 1];
+            LeftText.LengthInChars = Text.LengthInChars - Index - 1;
+
+            break;
+        }
+    }
+
+    YoriLibConstantString(&ButtonTexts[0], _T("&Ok"));
+    YoriLibConstantString(&ButtonTexts[1], _T("&View License..."));
+
+    ButtonClicked = YoriDlgAbout(YoriWinGetWindowManagerHandle(Parent),
+                                 &Title,
+                                 &CenteredText,
+                                 &LeftText,
+                                 2,
+                                 ButtonTexts,
+                                 0,
+                                 0);
+
+    YoriLibFreeStringContents(&Text);
+
+    if (ButtonClicked == 2) {
+        if (YoriLibMitLicenseText(strHexEditCopyrightYear, &Text)) {
+
+            YoriLibInitEmptyString(&CenteredText);
+            YoriLibConstantString(&Title, _T("License"));
+
+            //
+            //  Replace all single line breaks with spaces but leave one line
+            //  break in the case of double line (paragraph) breaks.  The
+            //  label control can decide how to format lines.
+            //
+
+            for (Index = 0; Index < Text.LengthInChars; Index++) {
+                if (Text.StartOfString[Index] == '\n' &&
+                    Index + 1 < Text.LengthInChars &&
+                    Text.StartOfString[Index + 1] != '\n') {
+
+                    Text.StartOfString[Index] = ' ';
+                }
+            }
+
+            YoriDlgAbout(YoriWinGetWindowManagerHandle(Parent),
+                         &Title,
+                         &CenteredText,
+                         &Text,
+                         1,
+                         ButtonTexts,
+                         0,
+                         0);
+            YoriLibFreeStringContents(&Text);
+        }
+    }
+}
+
+/**
+ A callback from the multiline hexedit control to indicate the cursor has moved
+ and the status bar should be updated.
+
+ @param Ctrl Pointer to the multiline hexedit control.
+
+ @param BufferOffset The offset within the buffer being edited.
+
+ @param BitShift The number of bits shifted from the lowest order bit, used
+        because when editing hex digits there are multiple display cells per
+        byte.
+ */
+VOID
+HexEditNotifyCursorMove(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl,
+    __in DWORDLONG BufferOffset,
+    __in DWORD BitShift
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+    YORI_STRING NewStatus;
+    YORI_STRING SearchStatus;
+    LARGE_INTEGER liBufferOffset;
+
+    UNREFERENCED_PARAMETER(BitShift);
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    YoriLibInitEmptyString(&SearchStatus);
+    if (HexEditContext->Search != NULL) {
+        YoriLibYPrintf(&SearchStatus, _T("Searching %i%%  "), HexEditSearchPercentComplete(HexEditContext->Search));
+    }
+
+    liBufferOffset.QuadPart = HexEditContext->DataOffset + BufferOffset;
+    YoriLibInitEmptyString(&NewStatus);
+    if (HexEditContext->Windowed) {
+        LARGE_INTEGER liRangeEnd;
+        liRangeEnd.QuadPart = HexEditContext->RangeOffset + HexEditContext->RangeLength;
+        YoriLibYPrintf(&NewStatus, _T("%y0x%08x`%08x of 0x%08x`%08x "), &SearchStatus, liBufferOffset.HighPart, liBufferOffset.LowPart, liRangeEnd.HighPart, liRangeEnd.LowPart);
+    } else {
+        YoriLibYPrintf(&NewStatus, _T("%y0x%08x`%08x "), &SearchStatus, liBufferOffset.HighPart, liBufferOffset.LowPart);
+    }
+
+    YoriWinLabelSetCaption(HexEditContext->StatusBar, &NewStatus);
+    YoriLibFreeStringContents(&NewStatus);
+    YoriLibFreeStringContents(&SearchStatus);
+
+    //
+    //  In a strange optimization reversal, force a repaint after this update
+    //  in the hope that this console update is isolated to this without
+    //  needing to update piles of user text at the same time
+    //
+
+    YoriWinDisplayWindowContents(Parent);
 }
 
 
 /**
- A callback invoked when the go to menu item is invoked.
+ Update the status bar for the current cursor location and redisplay the
+ window.  This is used when the status changes without the cursor moving.
 
- @param Ctrl Pointer to the menu bar control.
+ @param HexEditContext Pointer to the hexedit context.
  */
 VOID
-HexEditGoToButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
+HexEditRefreshStatusBar(
+    __in PHEXEDIT_CONTEXT HexEditContext
     )
 {
-    YORI_STRING Title;
-    YORI_STRING Text;
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PHEXEDIT_CONTEXT HexEditContext;
-    YORI_MAX_SIGNED_T SignedNewOffset;
-    YORI_MAX_UNSIGNED_T NewOffset;
-    YORI_ALLOC_SIZE_T CharsConsumed;
-
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
+    YORI_ALLOC_SIZE_T BufferOffset;
+    UCHAR BitShift;
+    BOOLEAN AsChar;
 
-    YoriLibConstantString(&Title, _T("Go to"));
-    YoriLibInitEmptyString(&Text);
+    if (!YoriWinHexEditGetCursorLocation(HexEditContext->HexEdit, &AsChar, &BufferOffset, &BitShift)) {
+        BufferOffset = 0;
+        BitShift = 0;
+    }
 
-    YoriDlgInput(YoriWinGetWindowManagerHandle(Parent),
-                 &Title,
-                 TRUE,
-                 &Text);
+    HexEditNotifyCursorMove(HexEditContext->HexEdit, BufferOffset, BitShift);
+}
 
-    if (Text.LengthInChars == 0) {
-        YoriLibFreeStringContents(&Text);
-        return;
-    }
+/**
+ Return the value of a hex digit.
 
-    if (YoriLibStringToNumber(&Text, FALSE, &SignedNewOffset, &CharsConsumed) &&
-        CharsConsumed > 0) {
+ @param Char The character to convert.
 
-        if (SignedNewOffset < 0) {
-            NewOffset = 0;
-        } else {
-            NewOffset = (YORI_MAX_UNSIGNED_T)SignedNewOffset;
-        }
+ @param Value On successful completion, updated to contain the value of the
+        digit.
 
-        YoriWinHexEditSetCursorLocation(HexEditContext->HexEdit, FALSE, (YORI_ALLOC_SIZE_T)NewOffset, 0);
+ @return TRUE to indicate the character is a hex digit, FALSE if it is not.
+ */
+__success(return)
+BOOLEAN
+HexEditHexDigitValue(
+    __in TCHAR Char,
+    __out PUCHAR Value
+    )
+{
+    if (Char >= '0' && Char <= '9') {
+        *Value = (UCHAR)(Char - '0');
+    } else if (Char >= 'a' && Char <= 'f') {
+        *Value = (UCHAR)(Char - 'a' + 10);
+    } else if (Char >= 'A' && Char <= 'F') {
+        *Value = (UCHAR)(Char - 'A' + 10);
+    } else {
+        return FALSE;
     }
 
-    YoriLibFreeStringContents(&Text);
+    return TRUE;
 }
 
 /**
- A callback invoked when the view button is clicked.
+ Parse a search pattern entered by the user into the bytes to search for and
+ a mask of the bits within each byte which must match.  The pattern can
+ contain:
 
- @param Ctrl Pointer to the button that was clicked.
+  - Hex digits, where each pair of digits describes a byte.  A ? in place of
+    a digit matches any value for that digit.
+  - Text in quotes, which is converted using the current multibyte encoding.
+  - Text in quotes following a u, which is converted to UTF-16.
+
+ Spaces between elements are ignored, so 4D 5A ?? ?? "This" u"PE" is a
+ valid pattern.
+
+ @param Text Pointer to the pattern entered by the user.
+
+ @param Pattern On successful completion, updated to point to a referenced
+        allocation containing the bytes to search for, followed by the mask
+        for each byte.  The bytes have the mask applied.
+
+ @param PatternLength On successful completion, updated to contain the number
+        of bytes in the pattern.
+
+ @return TRUE to indicate success, FALSE to indicate the pattern is invalid.
  */
-VOID
-HexEditViewButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
+__success(return)
+BOOLEAN
+HexEditParseSearchPattern(
+    __in PYORI_STRING Text,
+    __out PUCHAR *Pattern,
+    __out PYORI_ALLOC_SIZE_T PatternLength
     )
 {
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PHEXEDIT_CONTEXT HexEditContext;
-    PYORI_WIN_CTRL_HANDLE ViewMenu;
-    PYORI_WIN_CTRL_HANDLE ViewBytesItem;
-    PYORI_WIN_CTRL_HANDLE ViewWordsItem;
-    PYORI_WIN_CTRL_HANDLE ViewDwordsItem;
-    PYORI_WIN_CTRL_HANDLE ViewQwordsItem;
-    PYORI_WIN_CTRL_HANDLE ViewNoOffsetItem;
-    PYORI_WIN_CTRL_HANDLE ViewShortOffsetItem;
-    PYORI_WIN_CTRL_HANDLE ViewLongOffsetItem;
-
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
+    PUCHAR Bytes;
+    PUCHAR Mask;
+    YORI_ALLOC_SIZE_T MaximumLength;
+    YORI_ALLOC_SIZE_T Length;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T TextStart;
+    YORI_ALLOC_SIZE_T TextLength;
+    YORI_ALLOC_SIZE_T BytesNeeded;
+    YORI_ALLOC_SIZE_T CharIndex;
+    TCHAR Char;
+    UCHAR Digit;
+    UCHAR DigitMask;
+    UCHAR HighDigit;
+    UCHAR HighDigitMask;
+    BOOLEAN HaveHighDigit;
+    BOOLEAN Unicode;
 
-    ViewMenu = YoriWinMenuBarGetSubmenuHandle(Ctrl, NULL, HexEditContext->ViewMenuIndex);
-    ViewBytesItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, ViewMenu, HexEditContext->ViewBytesMenuIndex);
-    ViewWordsItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, ViewMenu, HexEditContext->ViewWordsMenuIndex);
-    ViewDwordsItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, ViewMenu, HexEditContext->ViewDwordsMenuIndex);
-    ViewQwordsItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, ViewMenu, HexEditContext->ViewQwordsMenuIndex);
-    ViewNoOffsetItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, ViewMenu, HexEditContext->ViewNoOffsetMenuIndex);
-    ViewShortOffsetItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, ViewMenu, HexEditContext->ViewShortOffsetMenuIndex);
-    ViewLongOffsetItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, ViewMenu, HexEditContext->ViewLongOffsetMenuIndex);
+    //
+    //  No character in the pattern can generate more than three bytes.
+    //
 
-    YoriWinMenuBarUncheckMenuItem(ViewBytesItem);
-    YoriWinMenuBarUncheckMenuItem(ViewWordsItem);
-    YoriWinMenuBarUncheckMenuItem(ViewDwordsItem);
-    YoriWinMenuBarUncheckMenuItem(ViewQwordsItem);
+    if (Text->LengthInChars == 0 ||
+        !YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)Text->LengthInChars * 6)) {
 
-    YoriWinMenuBarUncheckMenuItem(ViewNoOffsetItem);
-    YoriWinMenuBarUncheckMenuItem(ViewShortOffsetItem);
-    YoriWinMenuBarUncheckMenuItem(ViewLongOffsetItem);
+        return FALSE;
+    }
 
-    switch(HexEditContext->BytesPerWord) {
-        case 1:
-            YoriWinMenuBarCheckMenuItem(ViewBytesItem);
-            break;
-        case 2:
-            YoriWinMenuBarCheckMenuItem(ViewWordsItem);
-            break;
-        case 4:
-            YoriWinMenuBarCheckMenuItem(ViewDwordsItem);
-            break;
-        case 8:
-            YoriWinMenuBarCheckMenuItem(ViewQwordsItem);
-            break;
+    MaximumLength = Text->LengthInChars * 3;
+    Bytes = YoriLibReferencedMalloc(MaximumLength * 2);
+    if (Bytes == NULL) {
+        return FALSE;
     }
+    Mask = Bytes + MaximumLength;
 
-    switch(HexEditContext->OffsetWidth) {
-        case 0:
-            YoriWinMenuBarCheckMenuItem(ViewNoOffsetItem);
-            break;
-        case 32:
-            YoriWinMenuBarCheckMenuItem(ViewShortOffsetItem);
-            break;
-        case 64:
-            YoriWinMenuBarCheckMenuItem(ViewLongOffsetItem);
+    Length = 0;
+    HighDigit = 0;
+    HighDigitMask = 0;
+    HaveHighDigit = FALSE;
+    Index = 0;
+
+    while (Index < Text->LengthInChars) {
+        Char = Text->StartOfString[Index];
+
+        if (Char == ' ' || Char == '\t') {
+            Index++;
+            continue;
+        }
+
+        if (Char == '"' ||
+            ((Char == 'u' || Char == 'U') &&
+             Index + 1 < Text->LengthInChars &&
+             Text->StartOfString[Index + 1] == '"')) {
+
+            if (HaveHighDigit) {
+                break;
+            }
+
+            Unicode = FALSE;
+            if (Char != '"') {
+                Unicode = TRUE;
+                Index++;
+            }
+            Index++;
+
+            TextStart = Index;
+            while (Index < Text->LengthInChars && Text->StartOfString[Index] != '"') {
+                Index++;
+            }
+
+            if (Index == Text->LengthInChars) {
+                break;
+            }
+
+            TextLength = Index - TextStart;
+            Index++;
+
+            if (TextLength == 0) {
+                continue;
+            }
+
+            if (Unicode) {
+                for (CharIndex = 0; CharIndex < TextLength; CharIndex++) {
+                    Char = Text->StartOfString[TextStart + CharIndex];
+                    Bytes[Length] = (UCHAR)(Char & 0xFF);
+                    Mask[Length] = 0xFF;
+                    Bytes[Length + 1] = (UCHAR)((Char >> 8) & 0xFF);
+                    Mask[Length + 1] = 0xFF;
+                    Length = Length + 2;
+                }
+            } else {
+                BytesNeeded = YoriLibGetMbyteOutputSizeNeeded(&Text->StartOfString[TextStart], TextLength);
+                if (BytesNeeded > MaximumLength - Length) {
+                    break;
+                }
+                YoriLibMultibyteOutput(&Text->StartOfString[TextStart], TextLength, (LPSTR)&Bytes[Length], BytesNeeded);
+                memset(&Mask[Length], 0xFF, BytesNeeded);
+                Length = Length + BytesNeeded;
+            }
+            continue;
+        }
+
+        if (Char == '?') {
+            Digit = 0;
+            DigitMask = 0;
+        } else if (HexEditHexDigitValue(Char, &Digit)) {
+            DigitMask = 0xF;
+        } else {
             break;
+        }
+
+        Index++;
+
+        if (!HaveHighDigit) {
+            HighDigit = Digit;
+            HighDigitMask = DigitMask;
+            HaveHighDigit = TRUE;
+        } else {
+            Mask[Length] = (UCHAR)((HighDigitMask << 4) | DigitMask);
+            Bytes[Length] = (UCHAR)(((HighDigit << 4) | Digit) & Mask[Length]);
+            Length++;
+            HaveHighDigit = FALSE;
+        }
     }
-}
 
-/**
- A callback invoked when the view bytes button is clicked.
+    if (Index < Text->LengthInChars || HaveHighDigit || Length == 0) {
+        YoriLibDereference(Bytes);
+        return FALSE;
+    }
 
- @param Ctrl Pointer to the button that was clicked.
- */
-VOID
-HexEditViewBytesButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
-    )
-{
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PHEXEDIT_CONTEXT HexEditContext;
+    //
+    //  Move the mask to immediately follow the bytes.
+    //
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
+    memmove(&Bytes[Length], Mask, Length);
 
-    HexEditContext->BytesPerWord = 1;
-    YoriWinHexEditSetBytesPerWord(HexEditContext->HexEdit, HexEditContext->BytesPerWord);
+    *Pattern = Bytes;
+    *PatternLength = Length;
+    return TRUE;
 }
 
 /**
- A callback invoked when the view words button is clicked.
+ Display a message box for the find pattern feature.
 
- @param Ctrl Pointer to the button that was clicked.
+ @param HexEditContext Pointer to the hexedit context.
+
+ @param Text Pointer to the text to display.
  */
 VOID
-HexEditViewWordsButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
+HexEditSearchMessage(
+    __in PHEXEDIT_CONTEXT HexEditContext,
+    __in PYORI_STRING Text
     )
 {
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PHEXEDIT_CONTEXT HexEditContext;
+    YORI_STRING Title;
+    YORI_STRING ButtonText[1];
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
+    YoriLibConstantString(&Title, _T("Find Pattern"));
+    YoriLibConstantString(&ButtonText[0], _T("&Ok"));
 
-    HexEditContext->BytesPerWord = 2;
-    YoriWinHexEditSetBytesPerWord(HexEditContext->HexEdit, HexEditContext->BytesPerWord);
+    YoriDlgMessageBox(HexEditContext->WinMgr,
+                      &Title,
+                      Text,
+                      1,
+                      ButtonText,
+                      0,
+                      0);
 }
 
 /**
- A callback invoked when the view dwords button is clicked.
+ Move the cursor to a match found by a background search and select it.  If
+ the match is outside the currently loaded window, the window containing it
+ is loaded.
 
- @param Ctrl Pointer to the button that was clicked.
+ @param HexEditContext Pointer to the hexedit context.
+
+ @param MatchOffset The offset within the file of the match.
+
+ @param MatchLength The length of the match, in bytes.
  */
 VOID
-HexEditViewDwordsButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
+HexEditSearchShowMatch(
+    __in PHEXEDIT_CONTEXT HexEditContext,
+    __in DWORDLONG MatchOffset,
+    __in YORI_ALLOC_SIZE_T MatchLength
     )
 {
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PHEXEDIT_CONTEXT HexEditContext;
+    DWORDLONG WindowOffset;
+    YORI_ALLOC_SIZE_T ByteOffset;
+    YORI_ALLOC_SIZE_T BufferOffset;
+    UCHAR BitShift;
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
+    if (MatchOffset < HexEditContext->DataOffset ||
+        MatchOffset + MatchLength > HexEditContext->DataOffset + HexEditContext->DataLength) {
 
-    HexEditContext->BytesPerWord = 4;
-    YoriWinHexEditSetBytesPerWord(HexEditContext->HexEdit, HexEditContext->BytesPerWord);
-}
+        if (!HexEditContext->Windowed) {
+            return;
+        }
 
-/**
- A callback invoked when the view qwords button is clicked.
+        //
+        //  Load a window with the match in the middle so the user can see
+        //  the data around it.
+        //
 
- @param Ctrl Pointer to the button that was clicked.
- */
-VOID
-HexEditViewQwordsButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
-    )
-{
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PHEXEDIT_CONTEXT HexEditContext;
+        WindowOffset = HexEditContext->RangeOffset;
+        if (MatchOffset > WindowOffset + HEXEDIT_WINDOW_SIZE / 2) {
+            WindowOffset = MatchOffset - HEXEDIT_WINDOW_SIZE / 2;
+        }
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
+        if (!HexEditMoveWindow(HexEditContext->HexEdit, HexEditContext, WindowOffset, MatchOffset)) {
+            return;
+        }
 
-    HexEditContext->BytesPerWord = 8;
-    YoriWinHexEditSetBytesPerWord(HexEditContext->HexEdit, HexEditContext->BytesPerWord);
+        if (MatchOffset < HexEditContext->DataOffset) {
+            return;
+        }
+    }
+
+    ByteOffset = (YORI_ALLOC_SIZE_T)(MatchOffset - HexEditContext->DataOffset);
+    HexEditByteOffsetToBufferOffsetAndShift(HexEditContext, ByteOffset, &BufferOffset, &BitShift);
+    YoriWinHexEditSetCursorLocation(HexEditContext->HexEdit, FALSE, BufferOffset, BitShift);
+    YoriWinHexEditSetSelectionRange(HexEditContext->HexEdit, ByteOffset, ByteOffset + MatchLength - 1);
 }
 
 /**
- A callback invoked when the no offset button is clicked.
+ Check whether a background search has finished.  If it has, move to the
+ match or tell the user that no match was found.  If it has not, update the
+ status bar to indicate progress.
 
- @param Ctrl Pointer to the button that was clicked.
+ @param HexEditContext Pointer to the hexedit context.
  */
 VOID
-HexEditViewNoOffsetButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
+HexEditSearchUpdateDisplay(
+    __in PHEXEDIT_CONTEXT HexEditContext
     )
 {
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PHEXEDIT_CONTEXT HexEditContext;
+    PHEXEDIT_SEARCH Search;
+    DWORDLONG MatchOffset;
+    YORI_ALLOC_SIZE_T MatchLength;
+    YORI_STRING Text;
+    LPTSTR ErrText;
+    BOOLEAN Complete;
+    BOOLEAN Found;
+    BOOLEAN Cancel;
+    DWORD Err;
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
+    Search = HexEditContext->Search;
+    if (Search == NULL) {
+        return;
+    }
 
-    if (YoriWinHexEditSetStyle(HexEditContext->HexEdit, 0)) {
-        HexEditContext->OffsetWidth = 0;
+    WaitForSingleObject(Search->Mutex, INFINITE);
+    Complete = Search->Complete;
+    Found = Search->Found;
+    Cancel = Search->Cancel;
+    MatchOffset = Search->MatchOffset;
+    Err = Search->Error;
+    ReleaseMutex(Search->Mutex);
+
+    if (!Complete) {
+        HexEditRefreshStatusBar(HexEditContext);
+        return;
+    }
+
+    MatchLength = Search->PatternLength;
+    HexEditSearchClose(HexEditContext);
+
+    if (Found) {
+        HexEditSearchShowMatch(HexEditContext, MatchOffset, MatchLength);
+    } else if (Err != ERROR_SUCCESS) {
+        ErrText = YoriLibGetWinErrorText(Err);
+        YoriLibInitEmptyString(&Text);
+        YoriLibYPrintf(&Text, _T("Could not read file: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        HexEditSearchMessage(HexEditContext, &Text);
+        YoriLibFreeStringContents(&Text);
+    } else if (!Cancel) {
+        YoriLibConstantString(&Text, _T("Data not found."));
+        HexEditSearchMessage(HexEditContext, &Text);
     }
+
+    HexEditRefreshStatusBar(HexEditContext);
 }
 
 /**
- A callback invoked when the short offset button is clicked.
+ A callback invoked periodically while a background thread is searching.
 
- @param Ctrl Pointer to the button that was clicked.
+ @param Ctrl Pointer to the main window.
  */
 VOID
-HexEditViewShortOffsetButtonClicked(
+HexEditSearchPeriodicCallback(
     __in PYORI_WIN_CTRL_HANDLE Ctrl
     )
 {
-    PYORI_WIN_CTRL_HANDLE Parent;
     PHEXEDIT_CONTEXT HexEditContext;
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
-
-    if (YoriWinHexEditSetStyle(HexEditContext->HexEdit, YORI_WIN_HEX_EDIT_STYLE_OFFSET)) {
-        HexEditContext->OffsetWidth = 32;
-    }
+    HexEditContext = YoriWinGetControlContext(Ctrl);
+    HexEditSearchUpdateDisplay(HexEditContext);
 }
 
 /**
- A callback invoked when the long offset button is clicked.
+ Start searching for the current search pattern on a background thread.  The
+ search starts from the cursor and continues to the end of the range opened
+ for editing, including data beyond the currently loaded window.  While the
+ search is in progress the hexedit control is read only.
 
- @param Ctrl Pointer to the button that was clicked.
+ @param HexEditContext Pointer to the hexedit context, containing the search
+        pattern.
+
+ @param StartAtNextByte TRUE to indicate searching should start from the byte
+        after the cursor, FALSE if it should start at the cursor.
+
+ @return TRUE to indicate the search was started, FALSE if it was not.
  */
-VOID
-HexEditViewLongOffsetButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
+BOOLEAN
+HexEditStartPatternSearch(
+    __in PHEXEDIT_CONTEXT HexEditContext,
+    __in BOOLEAN StartAtNextByte
     )
 {
+    PHEXEDIT_SEARCH Search;
     PYORI_WIN_CTRL_HANDLE Parent;
-    PHEXEDIT_CONTEXT HexEditContext;
-
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
+    YORI_ALLOC_SIZE_T BufferOffset;
+    DWORDLONG RangeEnd;
+    DWORD ThreadId;
+    UCHAR BitShift;
+    BOOLEAN AsChar;
 
-    if (YoriWinHexEditSetStyle(HexEditContext->HexEdit, YORI_WIN_HEX_EDIT_STYLE_LARGE_OFFSET)) {
-        HexEditContext->OffsetWidth = 64;
-    }
-}
+    HexEditSearchCancel(HexEditContext);
 
-/**
- A callback invoked when the calculate PE checksum menu item is invoked.
+    if (HexEditContext->SearchBuffer == NULL ||
+        HexEditContext->SearchMask == NULL) {
 
- @param Ctrl Pointer to the menu bar control.
- */
-VOID
-HexEditCalculatePEChecksumButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
-    )
-{
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PHEXEDIT_CONTEXT HexEditContext;
-    YORI_STRING Title;
-    YORI_STRING Text;
-    YORI_STRING ButtonText[1];
-    PYORILIB_PE_HEADERS PeHeaders;
-    PUCHAR Buffer;
-    YORI_ALLOC_SIZE_T BufferLength;
-    DWORD CurrentChecksum;
-    DWORD NewChecksum;
-    YORI_ALLOC_SIZE_T DataOffset;
+        return FALSE;
+    }
 
+    if (!YoriWinHexEditGetCursorLocation(HexEditContext->HexEdit, &AsChar, &BufferOffset, &BitShift)) {
+        return FALSE;
+    }
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
+    Search = YoriLibMalloc(sizeof(HEXEDIT_SEARCH));
+    if (Search == NULL) {
+        return FALSE;
+    }
 
-    YoriLibLoadImageHlpFunctions();
+    ZeroMemory(Search, sizeof(HEXEDIT_SEARCH));
+    HexEditContext->Search = Search;
 
-    if (DllImageHlp.pCheckSumMappedFile == NULL) {
-        YoriLibConstantString(&Title, _T("Error"));
-        YoriLibConstantString(&Text, _T("OS support not present"));
-        YoriLibConstantString(&ButtonText[0], _T("&Ok"));
+    YoriLibReference(HexEditContext->SearchBuffer);
+    Search->Pattern = HexEditContext->SearchBuffer;
+    Search->Mask = HexEditContext->SearchMask;
+    Search->PatternLength = HexEditContext->SearchBufferLength;
+    for (Search->AnchorIndex = 0; Search->AnchorIndex < Search->PatternLength; Search->AnchorIndex++) {
+        if (Search->Mask[Search->AnchorIndex] == 0xFF) {
+            break;
+        }
+    }
 
-        YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
-                          &Title,
-                          &Text,
-                          1,
-                          ButtonText,
-                          0,
-                          0);
+    YoriWinHexEditGetDataNoCopy(HexEditContext->HexEdit, &Search->Buffer, &Search->BufferLength);
+    Search->BufferOffset = HexEditContext->DataOffset;
 
-        return;
+    Search->StartOffset = HexEditContext->DataOffset + BufferOffset + (BitShift / 8);
+    if (StartAtNextByte) {
+        Search->StartOffset = Search->StartOffset + 1;
     }
+    Search->EndOffset = Search->BufferOffset + Search->BufferLength;
+    Search->CurrentOffset = Search->StartOffset;
 
-    if (!YoriWinHexEditGetDataNoCopy(HexEditContext->HexEdit, &Buffer, &BufferLength)) {
-        return;
+    //
+    //  If only part of the range is loaded, search the rest of it from the
+    //  file or device.
+    //
+
+    if (HexEditContext->Windowed) {
+        RangeEnd = HexEditContext->RangeOffset + HexEditContext->RangeLength;
+        if (RangeEnd > Search->EndOffset) {
+            Search->hFile = CreateFile(HexEditContext->OpenFileName.StartOfString, FILE_READ_DATA | FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (Search->hFile == INVALID_HANDLE_VALUE) {
+                Search->hFile = NULL;
+                HexEditSearchClose(HexEditContext);
+                return FALSE;
+            }
+            Search->EndOffset = RangeEnd;
+        }
     }
 
-    PeHeaders = DllImageHlp.pCheckSumMappedFile(Buffer, BufferLength, &CurrentChecksum, &NewChecksum);
-    if (PeHeaders == NULL) {
-        YoriLibDereference(Buffer);
-        YoriLibConstantString(&Title, _T("Error"));
-        YoriLibConstantString(&Text, _T("Could not calculate checksum.  Possibly not PE file?"));
-        YoriLibConstantString(&ButtonText[0], _T("&Ok"));
+    Parent = YoriWinGetControlParent(HexEditContext->HexEdit);
+    Search->Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (Search->Mutex == NULL ||
+        !YoriWinSetPeriodicNotifyCallback(Parent, HEXEDIT_SEARCH_INTERVAL, HexEditSearchPeriodicCallback)) {
 
-        YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
-                          &Title,
-                          &Text,
-                          1,
-                          ButtonText,
-                          0,
-                          0);
-        return;
+        HexEditSearchClose(HexEditContext);
+        return FALSE;
     }
 
+    Search->Thread = CreateThread(NULL, 0, HexEditSearchThread, Search, 0, &ThreadId);
+    if (Search->Thread == NULL) {
+        YoriWinSetPeriodicNotifyCallback(Parent, 0, NULL);
+        HexEditSearchClose(HexEditContext);
+        return FALSE;
+    }
 
-    DataOffset = (YORI_ALLOC_SIZE_T)((PUCHAR)PeHeaders - Buffer);
-    DataOffset = DataOffset + FIELD_OFFSET(YORILIB_PE_HEADERS, OptionalHeader.CheckSum);
-    YoriLibDereference(Buffer);
-    YoriWinHexEditReplaceData(HexEditContext->HexEdit, DataOffset, &NewChecksum, sizeof(NewChecksum));
+    YoriWinHexEditSetReadOnly(HexEditContext->HexEdit, TRUE);
+    HexEditRefreshStatusBar(HexEditContext);
+    return TRUE;
 }
 
 /**
- A callback invoked when the about menu item is invoked.
+ A callback invoked when the find pattern menu item is invoked.
 
  @param Ctrl Pointer to the menu bar control.
  */
 VOID
-HexEditAboutButtonClicked(
+HexEditFindPatternButtonClicked(
     __in PYORI_WIN_CTRL_HANDLE Ctrl
     )
 {
     YORI_STRING Title;
     YORI_STRING Text;
-    YORI_STRING LeftText;
-    YORI_STRING CenteredText;
-    YORI_STRING ButtonTexts[2];
-    YORI_ALLOC_SIZE_T Index;
-    DWORD ButtonClicked;
-
     PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+    PUCHAR Pattern;
+    YORI_ALLOC_SIZE_T PatternLength;
+
     Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
 
-    YoriLibConstantString(&Title, _T("About"));
+    YoriLibConstantString(&Title, _T("Find Pattern"));
     YoriLibInitEmptyString(&Text);
-    YoriLibYPrintf(&Text,
-                   _T("HexEdit %i.%02i\n")
-#if YORI_BUILD_ID
-                   _T("Build %i\n")
-#endif
-                   _T("%hs"),
 
-                   YORI_VER_MAJOR,
-                   YORI_VER_MINOR,
-#if YORI_BUILD_ID
-                   YORI_BUILD_ID,
-#endif
-                   strHexEditHelpText);
+    YoriDlgInput(YoriWinGetWindowManagerHandle(Parent),
+                 &Title,
+                 FALSE,
+                 &Text);
 
-    if (Text.StartOfString == NULL) {
+    if (Text.LengthInChars == 0) {
+        YoriLibFreeStringContents(&Text);
         return;
     }
 
-    //
-    //  Search through the combined string to find the split point where
-    //  earlier text should be centered and later text should be left
-    //  aligned.  This is done to allow documentation for switches to be
-    //  legible.  The split point is therefore defined as the first place
-    //  a newline is followed by a space, indicating documentation for a
-    //  switch.
-    //
-    //  Note the label control will swallow all leading spaces in a line.
-    //
-
-    YoriLibInitEmptyString(&CenteredText);
-    YoriLibInitEmptyString(&LeftText);
-
-    for (Index = 0; Index < Text.LengthInChars; Index++) {
-        if (Text.StartOfString[Index] == '\n' &&
-            Index + 1 < Text.LengthInChars &&
-            Text.StartOfString[Index + 1] == ' ') {
-
-            CenteredText.StartOfString = Text.StartOfString;
-            CenteredText.LengthInChars = Index;
-
-            LeftText.StartOfString = &Text.StartOfString[Index + 1];
-            LeftText.LengthInChars = Text.LengthInChars - Index - 1;
-
-            break;
-        }
+    if (!HexEditParseSearchPattern(&Text, &Pattern, &PatternLength)) {
+        YoriLibFreeStringContents(&Text);
+        YoriLibConstantString(&Text, _T("The pattern should contain hex digits, ? wildcards, \"text\" or u\"text\"."));
+        HexEditSearchMessage(HexEditContext, &Text);
+        return;
     }
 
-    YoriLibConstantString(&ButtonTexts[0], _T("&Ok"));
-    YoriLibConstantString(&ButtonTexts[1], _T("&View License..."));
-
-    ButtonClicked = YoriDlgAbout(YoriWinGetWindowManagerHandle(Parent),
-                                 &Title,
-                                 &CenteredText,
-                                 &LeftText,
-                                 2,
-                                 ButtonTexts,
-                                 0,
-                                 0);
-
     YoriLibFreeStringContents(&Text);
 
-    if (ButtonClicked == 2) {
-        if (YoriLibMitLicenseText(strHexEditCopyrightYear, &Text)) {
-
-            YoriLibInitEmptyString(&CenteredText);
-            YoriLibConstantString(&Title, _T("License"));
-
-            //
-            //  Replace all single line breaks with spaces but leave one line
-            //  break in the case of double line (paragraph) breaks.  The
-            //  label control can decide how to format lines.
-            //
-
-            for (Index = 0; Index < Text.LengthInChars; Index++) {
-                if (Text.StartOfString[Index] == '\n' &&
-                    Index + 1 < Text.LengthInChars &&
-                    Text.StartOfString[Index + 1] != '\n') {
+    HexEditSearchCancel(HexEditContext);
+    if (HexEditContext->SearchBuffer != NULL) {
+        YoriLibDereference(HexEditContext->SearchBuffer);
+    }
 
-                    Text.StartOfString[Index] = ' ';
-                }
-            }
+    HexEditContext->SearchBuffer = Pattern;
+    HexEditContext->SearchBufferLength = PatternLength;
+    HexEditContext->SearchMask = Pattern + PatternLength;
 
-            YoriDlgAbout(YoriWinGetWindowManagerHandle(Parent),
-                         &Title,
-                         &CenteredText,
-                         &Text,
-                         1,
-                         ButtonTexts,
-                         0,
-                         0);
-            YoriLibFreeStringContents(&Text);
-        }
+    if (!HexEditStartPatternSearch(HexEditContext, FALSE)) {
+        YoriLibConstantString(&Text, _T("Could not start search."));
+        HexEditSearchMessage(HexEditContext, &Text);
     }
 }
 
 /**
- A callback from the multiline hexedit control to indicate the cursor has moved
- and the status bar should be updated.
-
- @param Ctrl Pointer to the multiline hexedit control.
-
- @param BufferOffset The offset within the buffer being edited.
+ A callback invoked when the stop find menu item is invoked.
 
- @param BitShift The number of bits shifted from the lowest order bit, used
-        because when editing hex digits there are multiple display cells per
-        byte.
+ @param Ctrl Pointer to the menu bar control.
  */
 VOID
-HexEditNotifyCursorMove(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl,
-    __in DWORDLONG BufferOffset,
-    __in DWORD BitShift
+HexEditStopFindButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
     )
 {
     PYORI_WIN_CTRL_HANDLE Parent;
     PHEXEDIT_CONTEXT HexEditContext;
-    YORI_STRING NewStatus;
-    LARGE_INTEGER liBufferOffset;
-
-    UNREFERENCED_PARAMETER(BitShift);
 
     Parent = YoriWinGetControlParent(Ctrl);
     HexEditContext = YoriWinGetControlContext(Parent);
 
-    liBufferOffset.QuadPart = BufferOffset;
-    YoriLibInitEmptyString(&NewStatus);
-    YoriLibYPrintf(&NewStatus, _T("0x%08x`%08x "), liBufferOffset.HighPart, liBufferOffset.LowPart);
-
-    YoriWinLabelSetCaption(HexEditContext->StatusBar, &NewStatus);
-    YoriLibFreeStringContents(&NewStatus);
-
-    //
-    //  In a strange optimization reversal, force a repaint after this update
-    //  in the hope that this console update is isolated to this without
-    //  needing to update piles of user text at the same time
-    //
+    if (HexEditContext->Search == NULL) {
+        return;
+    }
 
-    YoriWinDisplayWindowContents(Parent);
+    HexEditSearchCancel(HexEditContext);
+    HexEditRefreshStatusBar(HexEditContext);
 }
 
-
 /**
  Create the menu bar and add initial items to it.
 
@@ -2355,7 +3910,7 @@ HexEditPopulateMenuBar(
 {
     YORI_WIN_MENU_ENTRY FileMenuEntries[8];
     YORI_WIN_MENU_ENTRY EditMenuEntries[4];
-    YORI_WIN_MENU_ENTRY SearchMenuEntries[6];
+    YORI_WIN_MENU_ENTRY SearchMenuEntries[10];
     YORI_WIN_MENU_ENTRY ViewMenuEntries[8];
     YORI_WIN_MENU_ENTRY ToolsMenuEntries[1];
     YORI_WIN_MENU_ENTRY HelpMenuEntries[1];
@@ -2447,6 +4002,16 @@ HexEditPopulateMenuBar(
     SearchMenuEntries[MenuIndex].NotifyCallback = HexEditFindPreviousButtonClicked;
     MenuIndex++;
 
+    YoriLibConstantString(&SearchMenuEntries[MenuIndex].Caption, _T("Find P&attern..."));
+    YoriLibConstantString(&SearchMenuEntries[MenuIndex].Hotkey, _T("Ctrl+P"));
+    SearchMenuEntries[MenuIndex].NotifyCallback = HexEditFindPatternButtonClicked;
+    MenuIndex++;
+
+    YoriLibConstantString(&SearchMenuEntries[MenuIndex].Caption, _T("&Stop Find"));
+    YoriLibConstantString(&SearchMenuEntries[MenuIndex].Hotkey, _T("Ctrl+T"));
+    SearchMenuEntries[MenuIndex].NotifyCallback = HexEditStopFindButtonClicked;
+    MenuIndex++;
+
     YoriLibConstantString(&SearchMenuEntries[MenuIndex].Caption, _T("&Change..."));
     YoriLibConstantString(&SearchMenuEntries[MenuIndex].Hotkey, _T("Ctrl+R"));
     SearchMenuEntries[MenuIndex].NotifyCallback = HexEditChangeButtonClicked;
@@ -2460,6 +4025,14 @@ HexEditPopulateMenuBar(
     SearchMenuEntries[MenuIndex].NotifyCallback = HexEditGoToButtonClicked;
     MenuIndex++;
 
+    YoriLibConstantString(&SearchMenuEntries[MenuIndex].Caption, _T("&Next Window"));
+    SearchMenuEntries[MenuIndex].NotifyCallback = HexEditNextWindowButtonClicked;
+    MenuIndex++;
+
+    YoriLibConstantString(&SearchMenuEntries[MenuIndex].Caption, _T("Pre&vious Window"));
+    SearchMenuEntries[MenuIndex].NotifyCallback = HexEditPreviousWindowButtonClicked;
+    MenuIndex++;
+
     ZeroMemory(&ViewMenuEntries, sizeof(ViewMenuEntries));
     MenuIndex = 0;
     HexEditContext->ViewBytesMenuIndex = MenuIndex;
@@ -2774,6 +4347,7 @@ HexEditCreateMainWindow(
         Result = FALSE;
     }
 
+    HexEditSearchCancel(HexEditContext);
     YoriWinDestroyWindow(Parent);
     YoriWinCloseWindowManager(WinMgr);
     return (BOOL)Result;
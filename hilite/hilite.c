@@ -91,6 +91,11 @@ typedef struct _HILITE_MATCH_CRITERIA {
      */
     YORI_STRING MatchString;
 
+    /**
+     The preprocessed form of MatchString, used for substring matches.
+     */
+    YORI_LIB_SUBSTRING_SEARCH Search;
+
     /**
      The color to apply to the line, in event of a match.
      */
@@ -145,8 +150,36 @@ typedef struct _HILITE_CONTEXT {
      */
     YORI_LIST_ENTRY EndMatches;
 
+    /**
+     TRUE if ContainsSearch has been prepared, so the first match of any
+     nonempty substring in MiddleMatches can be found in a single pass.
+     */
+    BOOLEAN ContainsSearchPrepared;
+
+    /**
+     An array of the nonempty substrings in MiddleMatches, in list order.
+     */
+    PYORI_STRING ContainsStrings;
+
+    /**
+     An array of the criteria corresponding to each entry in
+     ContainsStrings.
+     */
+    PHILITE_MATCH_CRITERIA *ContainsCriteria;
+
+    /**
+     The preprocessed form of ContainsStrings.
+     */
+    YORI_LIB_MULTI_SUBSTRING_SEARCH ContainsSearch;
+
 } HILITE_CONTEXT, *PHILITE_CONTEXT;
 
+/**
+ The minimum number of substrings which can be in the middle of lines before
+ they are searched for together rather than individually.
+ */
+#define HILITE_MULTI_SEARCH_THRESHOLD 2
+
 /**
  Return the next match, in order.  All matches that must be at the start
  of the line are returned first, then all matches in the middle of the line,
@@ -244,6 +277,9 @@ HiliteProcessStream(
     BOOLEAN MatchFound;
     BOOLEAN AnyMatchFound;
     YORI_ALLOC_SIZE_T MatchOffset;
+    PHILITE_MATCH_CRITERIA ContainsMatch;
+    YORI_ALLOC_SIZE_T ContainsMatchOffset;
+    PYORI_STRING FoundString;
 
     YoriLibInitEmptyString(&LineString);
     YoriLibInitEmptyString(&Substring);
@@ -280,6 +316,21 @@ HiliteProcessStream(
             } else {
                 ListHead = &HiliteContext->MiddleMatches;
             }
+
+            //
+            //  Find the first match of any substring which can be in the
+            //  middle of the line.
+            //
+
+            ContainsMatch = NULL;
+            ContainsMatchOffset = 0;
+            if (HiliteContext->ContainsSearchPrepared) {
+                FoundString = YoriLibMultiSubstringSearch(&HiliteContext->ContainsSearch, &Substring, &ContainsMatchOffset);
+                if (FoundString != NULL) {
+                    ContainsMatch = HiliteContext->ContainsCriteria[FoundString - HiliteContext->ContainsStrings];
+                }
+            }
+
             MatchCriteria = NULL;
             MatchCriteria = HiliteGetNextMatch(HiliteContext, &ListHead, MatchCriteria);
             while (MatchCriteria != NULL) {
@@ -321,14 +372,28 @@ HiliteProcessStream(
                         }
                     }
                 } else if (MatchCriteria->MatchType == HiliteMatchTypeContains) {
-                    if (HiliteContext->Insensitive) {
-                        if (YoriLibFindFirstMatchSubstrIns(&Substring, 1, &MatchCriteria->MatchString, &MatchOffset)) {
+
+                    //
+                    //  When highlighting text, only the first match of any
+                    //  substring can be closest to the start of the line.
+                    //  When highlighting lines, an earlier criteria may
+                    //  match later in the line, but if nothing matched,
+                    //  no criteria can match.
+                    //
+
+                    if (HiliteContext->ContainsSearchPrepared &&
+                        MatchCriteria->MatchString.LengthInChars > 0) {
+
+                        if (MatchCriteria == ContainsMatch) {
                             MatchFound = TRUE;
-                        }
-                    } else {
-                        if (YoriLibFindFirstMatchSubstr(&Substring, 1, &MatchCriteria->MatchString, &MatchOffset)) {
+                            MatchOffset = ContainsMatchOffset;
+                        } else if (!HiliteContext->HighlightMatchText &&
+                                   ContainsMatch != NULL &&
+                                   YoriLibSubstringSearch(&MatchCriteria->Search, &Substring, &MatchOffset)) {
                             MatchFound = TRUE;
                         }
+                    } else if (YoriLibSubstringSearch(&MatchCriteria->Search, &Substring, &MatchOffset)) {
+                        MatchFound = TRUE;
                     }
                 }
 
@@ -567,6 +632,17 @@ HiliteCleanupContext(
     PHILITE_MATCH_CRITERIA NextMatchCriteria;
     PYORI_LIST_ENTRY ListHead;
 
+    if (HiliteContext->ContainsSearchPrepared) {
+        YoriLibFreeMultiSubstringSearch(&HiliteContext->ContainsSearch);
+        HiliteContext->ContainsSearchPrepared = FALSE;
+    }
+
+    if (HiliteContext->ContainsStrings != NULL) {
+        YoriLibFree(HiliteContext->ContainsStrings);
+        HiliteContext->ContainsStrings = NULL;
+        HiliteContext->ContainsCriteria = NULL;
+    }
+
     ListHead = &HiliteContext->StartMatches;
 
     MatchCriteria = HiliteGetNextMatch(HiliteContext, &ListHead, NULL);
@@ -578,6 +654,63 @@ HiliteCleanupContext(
     }
 }
 
+/**
+ Preprocess all of the nonempty substrings which can be found in the middle
+ of lines together, so the first match of any of them can be found in a
+ single pass over each line.  If there are too few substrings for this to
+ be worthwhile, or on allocation failure, each substring is searched for
+ individually.
+
+ @param HiliteContext The context containing user specified criteria.
+ */
+VOID
+HilitePrepareContainsSearch(
+    __inout PHILITE_CONTEXT HiliteContext
+    )
+{
+    PHILITE_MATCH_CRITERIA MatchCriteria;
+    PYORI_LIST_ENTRY ListEntry;
+    YORI_ALLOC_SIZE_T Count;
+
+    Count = 0;
+    ListEntry = YoriLibGetNextListEntry(&HiliteContext->MiddleMatches, NULL);
+    while (ListEntry != NULL) {
+        MatchCriteria = CONTAINING_RECORD(ListEntry, HILITE_MATCH_CRITERIA, ListEntry);
+        if (MatchCriteria->MatchString.LengthInChars > 0) {
+            Count++;
+        }
+        ListEntry = YoriLibGetNextListEntry(&HiliteContext->MiddleMatches, ListEntry);
+    }
+
+    if (Count < HILITE_MULTI_SEARCH_THRESHOLD) {
+        return;
+    }
+
+    HiliteContext->ContainsStrings = YoriLibMalloc(Count * (sizeof(YORI_STRING) + sizeof(PHILITE_MATCH_CRITERIA)));
+    if (HiliteContext->ContainsStrings == NULL) {
+        return;
+    }
+    HiliteContext->ContainsCriteria = (PHILITE_MATCH_CRITERIA *)&HiliteContext->ContainsStrings[Count];
+
+    Count = 0;
+    ListEntry = YoriLibGetNextListEntry(&HiliteContext->MiddleMatches, NULL);
+    while (ListEntry != NULL) {
+        MatchCriteria = CONTAINING_RECORD(ListEntry, HILITE_MATCH_CRITERIA, ListEntry);
+        if (MatchCriteria->MatchString.LengthInChars > 0) {
+            YoriLibInitEmptyString(&HiliteContext->ContainsStrings[Count]);
+            HiliteContext->ContainsStrings[Count].StartOfString = MatchCriteria->MatchString.StartOfString;
+            HiliteContext->ContainsStrings[Count].LengthInChars = MatchCriteria->MatchString.LengthInChars;
+            HiliteContext->ContainsCriteria[Count] = MatchCriteria;
+            Count++;
+        }
+        ListEntry = YoriLibGetNextListEntry(&HiliteContext->MiddleMatches, ListEntry);
+    }
+
+    if (YoriLibPrepareMultiSubstringSearch(&HiliteContext->ContainsSearch, Count, HiliteContext->ContainsStrings, HiliteContext->Insensitive)) {
+        HiliteContext->ContainsSearchPrepared = TRUE;
+    }
+}
+
 
 #ifdef YORI_BUILTIN
 /**
@@ -615,6 +748,7 @@ ENTRYPOINT(
     HILITE_CONTEXT HiliteContext;
     CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
     PHILITE_MATCH_CRITERIA NewCriteria;
+    PYORI_LIST_ENTRY ListEntry;
     YORI_STRING Arg;
 
     ZeroMemory(&HiliteContext, sizeof(HiliteContext));
@@ -725,6 +859,20 @@ ENTRYPOINT(
         }
     }
 
+    //
+    //  Now that it's known whether matches are case insensitive, preprocess
+    //  each substring so it can be located quickly in every line.
+    //
+
+    ListEntry = YoriLibGetNextListEntry(&HiliteContext.MiddleMatches, NULL);
+    while (ListEntry != NULL) {
+        NewCriteria = CONTAINING_RECORD(ListEntry, HILITE_MATCH_CRITERIA, ListEntry);
+        YoriLibPrepareSubstringSearch(&NewCriteria->Search, &NewCriteria->MatchString, HiliteContext.Insensitive);
+        ListEntry = YoriLibGetNextListEntry(&HiliteContext.MiddleMatches, ListEntry);
+    }
+
+    HilitePrepareContainsSearch(&HiliteContext);
+
     //
     //  Attempt to enable backup privilege so an administrator can access more
     //  objects successfully.
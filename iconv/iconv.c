@@ -3,7 +3,7 @@
  *
  * Yori character encoding conversions
  *
- * Copyright (c) 2017-2020 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -35,12 +35,13 @@ CHAR strIconvHelpText[] =
         "\n"
         "Convert the character encoding of one or more files.\n"
         "\n"
-        "ICONV [-license] [-b] [-s] [-e <encoding>] [-i <encoding>] [<file>...]\n"
+        "ICONV [-license] [-b] [-r] [-s] [-e <encoding>] [-i <encoding>] [<file>...]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -e <encoding>  Specifies the new encoding to use\n"
         "   -i <encoding>  Specifies the input (current) encoding\n"
         "   -m             Use traditional Mac line endings (CR)\n"
+        "   -r             Convert in large blocks, preserving line endings\n"
         "   -s             Process files from all subdirectories\n"
         "   -u             Use Unix line endings (LF)\n"
         "   -w             Use Windows line endings (CRLF)\n";
@@ -90,6 +91,17 @@ typedef struct _ICONV_CONTEXT {
      */
     LONGLONG FilesFound;
 
+    /**
+     TRUE if data should be converted in large blocks without interpreting
+     lines.  Line endings in the source are preserved.
+     */
+    BOOLEAN Raw;
+
+    /**
+     Set to TRUE if writing converted data in raw mode has failed.
+     */
+    BOOLEAN WriteFailed;
+
 } ICONV_CONTEXT, *PICONV_CONTEXT;
 
 /**
@@ -156,6 +168,486 @@ IconvProcessStream(
     return TRUE;
 }
 
+/**
+ The number of bytes read from the source for each block in raw mode.
+ */
+#define ICONV_BLOCK_SIZE (1024 * 1024)
+
+/**
+ The largest number of bytes that can form an incomplete character at the
+ end of a block, which are carried into the following block.
+ */
+#define ICONV_MAX_CARRY (4)
+
+/**
+ A block of data being converted in raw mode.
+ */
+typedef struct _ICONV_BLOCK {
+
+    /**
+     The thread pool item header.
+     */
+    YORI_LIB_WORK_ITEM WorkItem;
+
+    /**
+     Pointer to the context describing the conversion.
+     */
+    PICONV_CONTEXT IconvContext;
+
+    /**
+     Handle to write the converted data to.
+     */
+    HANDLE hTarget;
+
+    /**
+     Optionally points to a semaphore to release once the block has been
+     written, limiting the number of blocks in memory.
+     */
+    HANDLE Semaphore;
+
+    /**
+     Pointer to the data in the source encoding.  This buffer is allocated
+     along with this structure.
+     */
+    PUCHAR Input;
+
+    /**
+     The number of bytes of complete characters in Input.
+     */
+    DWORD InputLength;
+
+    /**
+     Pointer to a buffer to hold the data in UTF16, if the conversion
+     requires it.  This buffer is allocated along with this structure.
+     */
+    LPTSTR Wide;
+
+    /**
+     Pointer to a buffer to hold the data in the target encoding.  This
+     buffer is allocated along with this structure.
+     */
+    PUCHAR Output;
+
+    /**
+     The number of bytes of data in Output.
+     */
+    DWORD OutputLength;
+
+    /**
+     TRUE if this is the first block of the stream.  A byte order mark is
+     removed from the first block if the target encoding is not Unicode.
+     */
+    BOOLEAN First;
+
+} ICONV_BLOCK, *PICONV_BLOCK;
+
+/**
+ Determine how many bytes at the start of a block form complete characters
+ in the source encoding.  Any remaining bytes are the beginning of a
+ character which continues in the next block.
+
+ @param Encoding The source encoding.
+
+ @param Buffer Pointer to the block.
+
+ @param Length The number of bytes in the block.
+
+ @return The number of bytes forming complete characters.
+ */
+DWORD
+IconvCompleteCharsLength(
+    __in DWORD Encoding,
+    __in PUCHAR Buffer,
+    __in DWORD Length
+    )
+{
+    DWORD Index;
+    DWORD SequenceLength;
+    WORD Char;
+    CPINFO CpInfo;
+
+    if (Encoding == CP_UTF16) {
+
+        //
+        //  Keep an odd byte, or a high surrogate whose low surrogate is in
+        //  the next block.
+        //
+
+        Length = Length & ~(1);
+        if (Length >= sizeof(WCHAR)) {
+            Char = (WORD)(Buffer[Length - 2] | (Buffer[Length - 1] << 8));
+            if (Char >= 0xD800 && Char <= 0xDBFF) {
+                Length = Length - sizeof(WCHAR);
+            }
+        }
+        return Length;
+    }
+
+    if (Encoding == CP_UTF8) {
+
+        //
+        //  Find the lead byte of the final character, and check if all of
+        //  its continuation bytes are present.
+        //
+
+        for (Index = 1; Index < ICONV_MAX_CARRY && Index <= Length; Index++) {
+            if ((Buffer[Length - Index] & 0xC0) == 0x80) {
+                continue;
+            }
+            if (Buffer[Length - Index] >= 0xC0) {
+                SequenceLength = 2;
+                if (Buffer[Length - Index] >= 0xF0) {
+                    SequenceLength = 4;
+                } else if (Buffer[Length - Index] >= 0xE0) {
+                    SequenceLength = 3;
+                }
+                if (SequenceLength > Index) {
+                    return Length - Index;
+                }
+            }
+            break;
+        }
+        return Length;
+    }
+
+    //
+    //  For double byte code pages, a lead byte can only be identified by
+    //  scanning from a known character boundary.
+    //
+
+    if (!GetCPInfo(Encoding, &CpInfo) || CpInfo.MaxCharSize <= 1) {
+        return Length;
+    }
+
+    Index = 0;
+    while (Index < Length) {
+        if (IsDBCSLeadByteEx(Encoding, Buffer[Index])) {
+            if (Index + 1 >= Length) {
+                return Index;
+            }
+            Index = Index + 2;
+        } else {
+            Index++;
+        }
+    }
+
+    return Length;
+}
+
+/**
+ Allocate a block for raw conversion, including buffers to hold the data in
+ each encoding.
+
+ @param IconvContext Pointer to the context describing the conversion.
+
+ @param hTarget Handle to write the converted data to.
+
+ @return Pointer to the block, or NULL on allocation failure.
+ */
+PICONV_BLOCK
+IconvAllocateBlock(
+    __in PICONV_CONTEXT IconvContext,
+    __in HANDLE hTarget
+    )
+{
+    PICONV_BLOCK Block;
+    DWORD InputSize;
+    DWORD WideSize;
+    DWORD OutputSize;
+
+    //
+    //  Every source encoding generates at most one UTF16 code unit per
+    //  byte, and every target encoding needs at most four bytes per UTF16
+    //  code unit.
+    //
+
+    InputSize = ICONV_BLOCK_SIZE + ICONV_MAX_CARRY;
+    WideSize = 0;
+    OutputSize = 0;
+    if (IconvContext->SourceEncoding != IconvContext->TargetEncoding) {
+        if (IconvContext->SourceEncoding != CP_UTF16) {
+            WideSize = InputSize * sizeof(TCHAR);
+        }
+        if (IconvContext->TargetEncoding != CP_UTF16) {
+            OutputSize = InputSize * 4;
+        }
+    }
+
+    Block = YoriLibMalloc(sizeof(ICONV_BLOCK) + InputSize + WideSize + OutputSize);
+    if (Block == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Block, sizeof(ICONV_BLOCK));
+    Block->IconvContext = IconvContext;
+    Block->hTarget = hTarget;
+    Block->Wide = (LPTSTR)(Block + 1);
+    Block->Input = (PUCHAR)Block->Wide + WideSize;
+    Block->Output = Block->Input + InputSize;
+    return Block;
+}
+
+/**
+ Convert a block of data from the source encoding to the target encoding.
+ This may be invoked on a worker thread, so it uses the encodings in the
+ context rather than the process wide encodings.  UTF8 and UTF16 are
+ converted directly, and other encodings are converted through UTF16.
+
+ @param Pool Pointer to the thread pool, or NULL if the block is being
+        converted on the thread reading data.
+
+ @param WorkItem Pointer to the work item within the block.
+ */
+VOID
+IconvConvertBlock(
+    __in_opt PYORI_LIB_THREAD_POOL Pool,
+    __in PYORI_LIB_WORK_ITEM WorkItem
+    )
+{
+    PICONV_BLOCK Block;
+    PICONV_CONTEXT IconvContext;
+    LPTSTR Wide;
+    DWORD WideLength;
+
+    UNREFERENCED_PARAMETER(Pool);
+
+    Block = CONTAINING_RECORD(WorkItem, ICONV_BLOCK, WorkItem);
+    IconvContext = Block->IconvContext;
+
+    if (IconvContext->SourceEncoding == IconvContext->TargetEncoding) {
+        Block->Output = Block->Input;
+        Block->OutputLength = Block->InputLength;
+        return;
+    }
+
+    if (IconvContext->SourceEncoding == CP_UTF16) {
+        Wide = (LPTSTR)Block->Input;
+        WideLength = Block->InputLength / sizeof(TCHAR);
+    } else if (IconvContext->SourceEncoding == CP_UTF8) {
+        Wide = Block->Wide;
+        WideLength = YoriLibUtf16FromUtf8((LPCSTR)Block->Input, Block->InputLength, Wide, Block->InputLength);
+    } else {
+        Wide = Block->Wide;
+        WideLength = MultiByteToWideChar(IconvContext->SourceEncoding, 0, (LPCSTR)Block->Input, Block->InputLength, Wide, Block->InputLength);
+    }
+
+    if (Block->First && WideLength > 0 && Wide[0] == 0xFEFF &&
+        IconvContext->TargetEncoding != CP_UTF16 &&
+        IconvContext->TargetEncoding != CP_UTF8) {
+
+        Wide++;
+        WideLength--;
+    }
+
+    if (IconvContext->TargetEncoding == CP_UTF16) {
+        Block->Output = (PUCHAR)Wide;
+        Block->OutputLength = WideLength * sizeof(TCHAR);
+    } else if (IconvContext->TargetEncoding == CP_UTF8) {
+        Block->OutputLength = YoriLibUtf8FromUtf16(Wide, WideLength, (LPSTR)Block->Output, Block->InputLength * 4);
+    } else if (WideLength > 0) {
+        Block->OutputLength = WideCharToMultiByte(IconvContext->TargetEncoding, 0, Wide, WideLength, (LPSTR)Block->Output, Block->InputLength * 4, NULL, NULL);
+    }
+}
+
+/**
+ Write a converted block to the target and free it.  When converting on a
+ thread pool, this is invoked for one block at a time, in the order that
+ blocks were read.
+
+ @param Pool Pointer to the thread pool, or NULL if the block is being
+        converted on the thread reading data.
+
+ @param WorkItem Pointer to the work item within the block.
+ */
+VOID
+IconvWriteBlock(
+    __in_opt PYORI_LIB_THREAD_POOL Pool,
+    __in PYORI_LIB_WORK_ITEM WorkItem
+    )
+{
+    PICONV_BLOCK Block;
+    HANDLE Semaphore;
+    DWORD BytesWritten;
+
+    UNREFERENCED_PARAMETER(Pool);
+
+    Block = CONTAINING_RECORD(WorkItem, ICONV_BLOCK, WorkItem);
+    Semaphore = Block->Semaphore;
+
+    if (Block->OutputLength > 0 && !Block->IconvContext->WriteFailed) {
+        if (!WriteFile(Block->hTarget, Block->Output, Block->OutputLength, &BytesWritten, NULL) ||
+            BytesWritten != Block->OutputLength) {
+
+            Block->IconvContext->WriteFailed = TRUE;
+        }
+    }
+
+    YoriLibFree(Block);
+
+    if (Semaphore != NULL) {
+        ReleaseSemaphore(Semaphore, 1, NULL);
+    }
+}
+
+/**
+ Convert the encoding of an opened stream in large blocks, without
+ interpreting lines.  Line endings are preserved as they are in the source.
+ Characters which are split across blocks are carried into the following
+ block.  If the source is a file on disk and larger than one block, blocks
+ are converted concurrently on a thread pool and written in order.
+
+ @param hSource Handle to the source.
+
+ @param hTarget Handle to the target.
+
+ @param IconvContext Specifies the encodings to apply.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+IconvProcessStreamRaw(
+    __in HANDLE hSource,
+    __in HANDLE hTarget,
+    __in PICONV_CONTEXT IconvContext
+    )
+{
+    PYORI_LIB_THREAD_POOL Pool;
+    PICONV_BLOCK Block;
+    HANDLE Semaphore;
+    HANDLE WaitHandles[2];
+    DWORD HandleCount;
+    DWORD MaxOutstanding;
+    DWORD BytesRead;
+    DWORD TotalLength;
+    DWORD CompleteLength;
+    DWORD CarryLength;
+    UCHAR Carry[ICONV_MAX_CARRY];
+    LARGE_INTEGER FileSize;
+    BOOLEAN First;
+    BOOLEAN EndOfStream;
+    BOOL Result;
+
+    IconvContext->FilesFound++;
+
+    //
+    //  Only use a thread pool when there is enough data to benefit.  The
+    //  number of blocks in memory is limited to a small multiple of the
+    //  number of threads.
+    //
+
+    Pool = NULL;
+    Semaphore = NULL;
+    FileSize.QuadPart = 0;
+    if (GetFileType(hSource) == FILE_TYPE_DISK) {
+        FileSize.LowPart = GetFileSize(hSource, (LPDWORD)&FileSize.HighPart);
+        if (FileSize.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+            FileSize.QuadPart = 0;
+        }
+    }
+
+    if (FileSize.QuadPart > ICONV_BLOCK_SIZE) {
+
+        if (YoriLibCreateThreadPool(0, YoriLibCpuClassAny, &Pool)) {
+            MaxOutstanding = YoriLibGetThreadPoolThreadCount(Pool) * 2;
+            Semaphore = CreateSemaphore(NULL, MaxOutstanding, MaxOutstanding, NULL);
+            if (Semaphore == NULL) {
+                YoriLibDestroyThreadPool(Pool);
+                Pool = NULL;
+            }
+        }
+    }
+
+    Result = TRUE;
+    CarryLength = 0;
+    First = TRUE;
+    EndOfStream = FALSE;
+
+    while (!EndOfStream && !IconvContext->WriteFailed) {
+
+        if (Semaphore != NULL) {
+            HandleCount = 0;
+            WaitHandles[HandleCount++] = Semaphore;
+            if (YoriLibCancelGetEvent() != NULL) {
+                WaitHandles[HandleCount++] = YoriLibCancelGetEvent();
+            }
+            if (WaitForMultipleObjects(HandleCount, WaitHandles, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                Result = FALSE;
+                break;
+            }
+        } else if (YoriLibIsOperationCancelled()) {
+            Result = FALSE;
+            break;
+        }
+
+        Block = IconvAllocateBlock(IconvContext, hTarget);
+        if (Block == NULL) {
+            if (Semaphore != NULL) {
+                ReleaseSemaphore(Semaphore, 1, NULL);
+            }
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("iconv: out of memory\n"));
+            Result = FALSE;
+            break;
+        }
+
+        if (CarryLength > 0) {
+            memcpy(Block->Input, Carry, CarryLength);
+        }
+
+        //
+        //  A pipe whose writer has closed reports an error rather than a
+        //  zero length read, so any failure is treated as the end.  Once
+        //  the end is reached, any carried bytes are converted as they are.
+        //
+
+        if (!ReadFile(hSource, Block->Input + CarryLength, ICONV_BLOCK_SIZE, &BytesRead, NULL)) {
+            BytesRead = 0;
+        }
+
+        TotalLength = CarryLength + BytesRead;
+        if (BytesRead == 0) {
+            EndOfStream = TRUE;
+            CompleteLength = TotalLength;
+        } else {
+            CompleteLength = IconvCompleteCharsLength(IconvContext->SourceEncoding, Block->Input, TotalLength);
+        }
+
+        CarryLength = TotalLength - CompleteLength;
+        if (CarryLength > 0) {
+            memcpy(Carry, Block->Input + CompleteLength, CarryLength);
+        }
+
+        Block->InputLength = CompleteLength;
+        Block->First = First;
+        Block->Semaphore = Semaphore;
+        First = FALSE;
+
+        if (Pool != NULL) {
+            Block->WorkItem.ExecuteFn = IconvConvertBlock;
+            Block->WorkItem.CompleteFn = IconvWriteBlock;
+            YoriLibSubmitWorkItem(Pool, &Block->WorkItem);
+        } else {
+            IconvConvertBlock(NULL, &Block->WorkItem);
+            IconvWriteBlock(NULL, &Block->WorkItem);
+        }
+    }
+
+    if (Pool != NULL) {
+        YoriLibWaitForThreadPool(Pool);
+        YoriLibDestroyThreadPool(Pool);
+    }
+
+    if (Semaphore != NULL) {
+        CloseHandle(Semaphore);
+    }
+
+    if (IconvContext->WriteFailed) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("iconv: write failed\n"));
+        Result = FALSE;
+    }
+
+    return Result;
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
@@ -203,7 +695,11 @@ IconvFileFoundCallback(
             return TRUE;
         }
 
-        IconvProcessStream(FileHandle, IconvContext);
+        if (IconvContext->Raw) {
+            IconvProcessStreamRaw(FileHandle, GetStdHandle(STD_OUTPUT_HANDLE), IconvContext);
+        } else {
+            IconvProcessStream(FileHandle, IconvContext);
+        }
 
         CloseHandle(FileHandle);
     }
@@ -331,6 +827,7 @@ ENTRYPOINT(
     BOOLEAN BasicEnumeration = FALSE;
     ICONV_CONTEXT IconvContext;
     YORI_STRING Arg;
+    DWORD ConsoleMode;
 
     ZeroMemory(&IconvContext, sizeof(IconvContext));
     IconvContext.SourceEncoding = CP_UTF8;
@@ -348,7 +845,7 @@ ENTRYPOINT(
                 IconvHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2017-2020"));
+                YoriLibDisplayMitLicense(_T("2017-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
@@ -379,6 +876,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("u")) == 0) {
                 IconvContext.LineEnding = _T("\n");
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("r")) == 0) {
+                IconvContext.Raw = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 IconvContext.Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -412,6 +912,17 @@ ENTRYPOINT(
 
     YoriLibEnableBackupPrivilege();
 
+    //
+    //  Raw mode writes bytes in the target encoding directly.  A console
+    //  displays characters rather than bytes, so use line mode for it.
+    //
+
+    if (IconvContext.Raw &&
+        GetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE), &ConsoleMode)) {
+
+        IconvContext.Raw = FALSE;
+    }
+
     //
     //  If no file name is specified, use stdin; otherwise open
     //  the file and use that
@@ -423,7 +934,11 @@ ENTRYPOINT(
             return EXIT_FAILURE;
         }
 
-        IconvProcessStream(GetStdHandle(STD_INPUT_HANDLE), &IconvContext);
+        if (IconvContext.Raw) {
+            IconvProcessStreamRaw(GetStdHandle(STD_INPUT_HANDLE), GetStdHandle(STD_OUTPUT_HANDLE), &IconvContext);
+        } else {
+            IconvProcessStream(GetStdHandle(STD_INPUT_HANDLE), &IconvContext);
+        }
     } else {
         MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
         if (IconvContext.Recursive) {
@@ -36,17 +36,24 @@ CHAR strIniToolHelpText[] =
         "Query or set values in INI files.\n"
         "\n"
         "INITOOL [-license]\n"
+        "INITOOL -b <file>\n"
         "INITOOL -d <file> <section> [<key>]\n"
         "INITOOL -l <file> <section>\n"
         "INITOOL -r <file> <section> <key>\n"
         "INITOOL -s <file>\n"
         "INITOOL -w <file> <section> <key> <value>\n"
         "\n"
+        "   -b             Perform operations read from standard input, one per line\n"
         "   -d             Delete a specified key from an INI file\n"
         "   -l             List key/value pairs in a specified section from an INI file\n"
         "   -r             Read a specified key from an INI file\n"
         "   -s             List sections in an INI file\n"
-        "   -w             Write a specified value to an INI file\n";
+        "   -w             Write a specified value to an INI file\n"
+        "\n"
+        "Batch operations are specified as the operation letter followed by its\n"
+        "arguments, such as \"r <section> <key>\".  The file is loaded once and any\n"
+        "changes are written once after all operations succeed.  Each value read is\n"
+        "followed by a newline.\n";
 
 /**
  Display usage text to the user.
@@ -63,46 +70,53 @@ IniToolHelp(VOID)
 }
 
 /**
- Delete a value from an INI file.
+ Delete a value from a loaded INI file.
 
- @param UserFileName Pointer to the file name of the INI file.
+ @param IniFile Pointer to the loaded INI file.
 
  @param Section Pointer to the section within the INI file to update.
 
- @param Key Pointer to the key part of the key value pair.
+ @param Key Pointer to the key part of the key value pair.  If NULL, the
+        entire section is deleted.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 IniToolDeleteFromIniFile(
-    __in PYORI_STRING UserFileName,
+    __in PYORI_LIB_INI_FILE IniFile,
     __in PYORI_STRING Section,
     __in_opt PYORI_STRING Key
     )
 {
-    YORI_STRING RealFileName;
+    return YoriLibIniWriteString(IniFile, Section->StartOfString, (Key != NULL)?Key->StartOfString:NULL, NULL);
+}
 
-    if (DllKernel32.pWritePrivateProfileStringW == NULL) {
-        return FALSE;
-    }
+/**
+ Output a list of NULL terminated strings, terminated by an additional
+ NULL, one string per line.
 
-    if (!YoriLibUserStringToSingleFilePath(UserFileName, FALSE, &RealFileName)) {
-        return FALSE;
-    }
+ @param Buffer Pointer to the first string in the list.
+ */
+VOID
+IniToolOutputMultiString(
+    __in LPTSTR Buffer
+    )
+{
+    LPTSTR ThisVar;
 
-    if (!DllKernel32.pWritePrivateProfileStringW(Section->StartOfString, (Key != NULL)?Key->StartOfString:NULL, NULL, RealFileName.StartOfString)) {
-        YoriLibFreeStringContents(&RealFileName);
-        return FALSE;
-    }
+    ThisVar = Buffer;
+    while (*ThisVar != '\0') {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%s\n"), ThisVar);
 
-    YoriLibFreeStringContents(&RealFileName);
-    return TRUE;
+        ThisVar += _tcslen(ThisVar);
+        ThisVar++;
+    }
 }
 
 /**
- List a section from an INI file and write it to standard output.
+ List a section from a loaded INI file and write it to standard output.
 
- @param UserFileName Pointer to the file name of the INI file.
+ @param IniFile Pointer to the loaded INI file.
 
  @param Section Pointer to the section within the INI file to read.
 
@@ -110,143 +124,107 @@ IniToolDeleteFromIniFile(
  */
 BOOL
 IniToolListSectionFromIniFile(
-    __in PYORI_STRING UserFileName,
+    __in PYORI_LIB_INI_FILE IniFile,
     __in PYORI_STRING Section
     )
 {
-    YORI_STRING RealFileName;
     YORI_STRING Value;
-    LPTSTR ThisVar;
-
-    if (DllKernel32.pGetPrivateProfileSectionW == NULL) {
-        return FALSE;
-    }
-
-    if (!YoriLibUserStringToSingleFilePath(UserFileName, FALSE, &RealFileName)) {
-        return FALSE;
-    }
 
     if (!YoriLibAllocateString(&Value, 32 * 1024)) {
-        YoriLibFreeStringContents(&RealFileName);
         return FALSE;
     }
 
     Value.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(Section->StartOfString,
-                                               Value.StartOfString,
-                                               Value.LengthAllocated,
-                                               RealFileName.StartOfString);
-    ThisVar = Value.StartOfString;
-    while (*ThisVar != '\0') {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%s\n"), ThisVar);
+        YoriLibIniGetSection(IniFile,
+                             Section->StartOfString,
+                             Value.StartOfString,
+                             Value.LengthAllocated);
 
-        ThisVar += _tcslen(ThisVar);
-        ThisVar++;
-    }
+    IniToolOutputMultiString(Value.StartOfString);
 
-    YoriLibFreeStringContents(&RealFileName);
     YoriLibFreeStringContents(&Value);
     return TRUE;
 }
 
 /**
- List sections from an INI file and write them to standard output.
+ List sections from a loaded INI file and write them to standard output.
 
- @param UserFileName Pointer to the file name of the INI file.
+ @param IniFile Pointer to the loaded INI file.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 IniToolListSectionsFromIniFile(
-    __in PYORI_STRING UserFileName
+    __in PYORI_LIB_INI_FILE IniFile
     )
 {
-    YORI_STRING RealFileName;
     YORI_STRING Value;
-    LPTSTR ThisVar;
-
-    if (DllKernel32.pGetPrivateProfileSectionNamesW == NULL) {
-        return FALSE;
-    }
-
-    if (!YoriLibUserStringToSingleFilePath(UserFileName, FALSE, &RealFileName)) {
-        return FALSE;
-    }
 
     if (!YoriLibAllocateString(&Value, 32 * 1024)) {
-        YoriLibFreeStringContents(&RealFileName);
         return FALSE;
     }
 
     Value.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionNamesW(Value.StartOfString,
-                                                    Value.LengthAllocated,
-                                                    RealFileName.StartOfString);
-    ThisVar = Value.StartOfString;
-    while (*ThisVar != '\0') {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%s\n"), ThisVar);
+        YoriLibIniGetSectionNames(IniFile,
+                                  Value.StartOfString,
+                                  Value.LengthAllocated);
 
-        ThisVar += _tcslen(ThisVar);
-        ThisVar++;
-    }
+    IniToolOutputMultiString(Value.StartOfString);
 
-    YoriLibFreeStringContents(&RealFileName);
     YoriLibFreeStringContents(&Value);
     return TRUE;
 }
 
 /**
- Read a value from an INI file and write it to standard output.
+ Read a value from a loaded INI file and write it to standard output.
 
- @param UserFileName Pointer to the file name of the INI file.
+ @param IniFile Pointer to the loaded INI file.
 
  @param Section Pointer to the section within the INI file to read.
 
  @param Key Pointer to the key part of the key value pair.
 
+ @param Newline If TRUE, a newline is written after the value.  This is used
+        when multiple values are written so each can be distinguished.
+
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 IniToolReadFromIniFile(
-    __in PYORI_STRING UserFileName,
+    __in PYORI_LIB_INI_FILE IniFile,
     __in PYORI_STRING Section,
-    __in PYORI_STRING Key
+    __in PYORI_STRING Key,
+    __in BOOLEAN Newline
     )
 {
-    YORI_STRING RealFileName;
     YORI_STRING Value;
 
-    if (DllKernel32.pGetPrivateProfileStringW == NULL) {
-        return FALSE;
-    }
-
-    if (!YoriLibUserStringToSingleFilePath(UserFileName, FALSE, &RealFileName)) {
-        return FALSE;
-    }
-
     if (!YoriLibAllocateString(&Value, 32 * 1024)) {
-        YoriLibFreeStringContents(&RealFileName);
         return FALSE;
     }
 
     Value.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(Section->StartOfString,
-                                              Key->StartOfString,
-                                              _T(""),
-                                              Value.StartOfString,
-                                              Value.LengthAllocated,
-                                              RealFileName.StartOfString);
-    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &Value);
+        YoriLibIniGetString(IniFile,
+                            Section->StartOfString,
+                            Key->StartOfString,
+                            _T(""),
+                            Value.StartOfString,
+                            Value.LengthAllocated);
+
+    if (Newline) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &Value);
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &Value);
+    }
 
-    YoriLibFreeStringContents(&RealFileName);
     YoriLibFreeStringContents(&Value);
     return TRUE;
 }
 
 /**
- Write a value to an INI file.
+ Write a value to a loaded INI file.
 
- @param UserFileName Pointer to the file name of the INI file.
+ @param IniFile Pointer to the loaded INI file.
 
  @param Section Pointer to the section within the INI file to update.
 
@@ -258,29 +236,38 @@ IniToolReadFromIniFile(
  */
 BOOL
 IniToolWriteToIniFile(
-    __in PYORI_STRING UserFileName,
+    __in PYORI_LIB_INI_FILE IniFile,
     __in PYORI_STRING Section,
     __in PYORI_STRING Key,
     __in PYORI_STRING Value
     )
 {
-    YORI_STRING RealFileName;
+    return YoriLibIniWriteString(IniFile, Section->StartOfString, Key->StartOfString, Value->StartOfString);
+}
 
-    if (DllKernel32.pWritePrivateProfileStringW == NULL) {
-        return FALSE;
-    }
+/**
+ Resolve a user specified file name and load the INI file it refers to.
 
-    if (!YoriLibUserStringToSingleFilePath(UserFileName, FALSE, &RealFileName)) {
-        return FALSE;
-    }
+ @param UserFileName Pointer to the file name of the INI file.
 
-    if (!DllKernel32.pWritePrivateProfileStringW(Section->StartOfString, Key->StartOfString, Value->StartOfString, RealFileName.StartOfString)) {
-        YoriLibFreeStringContents(&RealFileName);
-        return FALSE;
+ @return Pointer to the loaded INI file, or NULL on failure.
+ */
+__success(return != NULL)
+PYORI_LIB_INI_FILE
+IniToolLoad(
+    __in PYORI_STRING UserFileName
+    )
+{
+    YORI_STRING RealFileName;
+    PYORI_LIB_INI_FILE IniFile;
+
+    if (!YoriLibUserStringToSingleFilePath(UserFileName, FALSE, &RealFileName)) {
+        return NULL;
     }
 
+    IniFile = YoriLibIniLoad(&RealFileName);
     YoriLibFreeStringContents(&RealFileName);
-    return TRUE;
+    return IniFile;
 }
 
 /**
@@ -292,9 +279,184 @@ typedef enum _INITOOL_OPERATION {
     IniToolOpReadValue = 2,
     IniToolOpDeleteValue = 3,
     IniToolOpListSection = 4,
-    IniToolOpListSections = 5
+    IniToolOpListSections = 5,
+    IniToolOpBatch = 6
 } INITOOL_OPERATION;
 
+/**
+ Perform a single operation against a loaded INI file.
+
+ @param IniFile Pointer to the loaded INI file.
+
+ @param Op The operation to perform.
+
+ @param ArgC The number of arguments to the operation, excluding the file
+        name.
+
+ @param ArgV An array of arguments to the operation, excluding the file
+        name.
+
+ @param Batch TRUE if the operation is one of many being performed, in which
+        case each value read is followed by a newline.
+
+ @param Modified Set to TRUE if the operation changed the INI file.
+        Unmodified otherwise.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+IniToolExecute(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __in INITOOL_OPERATION Op,
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[],
+    __in BOOLEAN Batch,
+    __inout PBOOLEAN Modified
+    )
+{
+    YORI_ALLOC_SIZE_T ArgsNeeded;
+
+    switch(Op) {
+        case IniToolOpWriteValue:
+            ArgsNeeded = 3;
+            break;
+        case IniToolOpReadValue:
+            ArgsNeeded = 2;
+            break;
+        case IniToolOpDeleteValue:
+        case IniToolOpListSection:
+            ArgsNeeded = 1;
+            break;
+        case IniToolOpListSections:
+            ArgsNeeded = 0;
+            break;
+        default:
+            return FALSE;
+    }
+
+    if (ArgC < ArgsNeeded) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("initool: missing argument\n"));
+        return FALSE;
+    }
+
+    if (Op == IniToolOpWriteValue) {
+        if (!IniToolWriteToIniFile(IniFile, &ArgV[0], &ArgV[1], &ArgV[2])) {
+            return FALSE;
+        }
+        *Modified = TRUE;
+    } else if (Op == IniToolOpReadValue) {
+        return IniToolReadFromIniFile(IniFile, &ArgV[0], &ArgV[1], Batch);
+    } else if (Op == IniToolOpDeleteValue) {
+        if (!IniToolDeleteFromIniFile(IniFile, &ArgV[0], (ArgC > 1)?&ArgV[1]:NULL)) {
+            return FALSE;
+        }
+        *Modified = TRUE;
+    } else if (Op == IniToolOpListSection) {
+        return IniToolListSectionFromIniFile(IniFile, &ArgV[0]);
+    } else if (Op == IniToolOpListSections) {
+        return IniToolListSectionsFromIniFile(IniFile);
+    }
+
+    return TRUE;
+}
+
+/**
+ Read operations from standard input, one per line, and perform each
+ against a single loaded copy of an INI file.  Each line consists of an
+ operation letter as used on the command line followed by its arguments,
+ for example "r section key".  Processing stops at the first operation that
+ fails.
+
+ @param IniFile Pointer to the loaded INI file.
+
+ @param Modified Set to TRUE if any operation changed the INI file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+IniToolExecuteBatch(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __inout PBOOLEAN Modified
+    )
+{
+    PVOID LineContext = NULL;
+    YORI_STRING LineString;
+    PYORI_STRING ArgV;
+    YORI_ALLOC_SIZE_T ArgC;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD LineNumber;
+    INITOOL_OPERATION Op;
+    BOOL Result;
+
+    YoriLibInitEmptyString(&LineString);
+    LineNumber = 0;
+    Result = TRUE;
+
+    while (TRUE) {
+
+        if (!YoriLibReadLineToString(&LineString, &LineContext, GetStdHandle(STD_INPUT_HANDLE))) {
+            break;
+        }
+
+        LineNumber++;
+        YoriLibTrimSpaces(&LineString);
+        if (LineString.LengthInChars == 0) {
+            continue;
+        }
+
+        if (!YoriLibIsStringNullTerminated(&LineString)) {
+            if (!YoriLibReallocString(&LineString, LineString.LengthInChars + 1)) {
+                Result = FALSE;
+                break;
+            }
+            LineString.StartOfString[LineString.LengthInChars] = '\0';
+        }
+
+        ArgV = YoriLibCmdlineToArgcArgv(LineString.StartOfString, (YORI_ALLOC_SIZE_T)-1, FALSE, &ArgC, NULL);
+        if (ArgV == NULL) {
+            Result = FALSE;
+            break;
+        }
+
+        Op = IniToolOpNone;
+        if (ArgC > 0) {
+            if (YoriLibCompareStringLitIns(&ArgV[0], _T("d")) == 0) {
+                Op = IniToolOpDeleteValue;
+            } else if (YoriLibCompareStringLitIns(&ArgV[0], _T("l")) == 0) {
+                Op = IniToolOpListSection;
+            } else if (YoriLibCompareStringLitIns(&ArgV[0], _T("r")) == 0) {
+                Op = IniToolOpReadValue;
+            } else if (YoriLibCompareStringLitIns(&ArgV[0], _T("s")) == 0) {
+                Op = IniToolOpListSections;
+            } else if (YoriLibCompareStringLitIns(&ArgV[0], _T("w")) == 0) {
+                Op = IniToolOpWriteValue;
+            }
+        }
+
+        if (Op == IniToolOpNone) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("initool: line %i: operation not understood: %y\n"), LineNumber, &LineString);
+            Result = FALSE;
+        } else if (!IniToolExecute(IniFile, Op, ArgC - 1, &ArgV[1], TRUE, Modified)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("initool: line %i: operation failed: %y\n"), LineNumber, &LineString);
+            Result = FALSE;
+        }
+
+        for (Index = 0; Index < ArgC; Index++) {
+            YoriLibFreeStringContents(&ArgV[Index]);
+        }
+        YoriLibDereference(ArgV);
+
+        if (!Result) {
+            break;
+        }
+    }
+
+    YoriLibLineReadCloseOrCache(LineContext);
+    YoriLibFreeStringContents(&LineString);
+
+    return Result;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the initool builtin command.
@@ -328,6 +490,9 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T StartArg = 0;
     YORI_STRING Arg;
     INITOOL_OPERATION Op;
+    PYORI_LIB_INI_FILE IniFile;
+    BOOLEAN Modified;
+    BOOL Result;
 
     Op = IniToolOpNone;
 
@@ -344,6 +509,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
                 YoriLibDisplayMitLicense(_T("2018"));
                 return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
+                Op = IniToolOpBatch;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("d")) == 0) {
                 Op = IniToolOpDeleteValue;
                 ArgumentUnderstood = TRUE;
@@ -380,58 +548,36 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
-    if (Op == IniToolOpWriteValue) {
-        if (StartArg == 0 || StartArg + 4 > ArgC) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("initool: missing argument\n"));
-            return EXIT_FAILURE;
-        }
+    if (StartArg == 0 || StartArg + 1 > ArgC) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("initool: missing argument\n"));
+        return EXIT_FAILURE;
+    }
 
-        if (!IniToolWriteToIniFile(&ArgV[StartArg], &ArgV[StartArg + 1], &ArgV[StartArg + 2], &ArgV[StartArg + 3])) {
-            return EXIT_FAILURE;
-        }
-    } else if (Op == IniToolOpReadValue) {
-        if (StartArg == 0 || StartArg + 3 > ArgC) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("initool: missing argument\n"));
-            return EXIT_FAILURE;
-        }
+    IniFile = IniToolLoad(&ArgV[StartArg]);
+    if (IniFile == NULL) {
+        return EXIT_FAILURE;
+    }
 
-        if (!IniToolReadFromIniFile(&ArgV[StartArg], &ArgV[StartArg + 1], &ArgV[StartArg + 2])) {
-            return EXIT_FAILURE;
-        }
-    } else if (Op == IniToolOpDeleteValue) {
-        if (StartArg == 0 || StartArg + 2 > ArgC) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("initool: missing argument\n"));
-            return EXIT_FAILURE;
-        }
+    Modified = FALSE;
+    if (Op == IniToolOpBatch) {
+        Result = IniToolExecuteBatch(IniFile, &Modified);
+    } else {
+        Result = IniToolExecute(IniFile, Op, ArgC - StartArg - 1, &ArgV[StartArg + 1], FALSE, &Modified);
+    }
 
-        if (StartArg + 2 < ArgC) {
+    //
+    //  Changes are only written if every operation succeeded, so a failed
+    //  batch leaves the file untouched.
+    //
 
-            if (!IniToolDeleteFromIniFile(&ArgV[StartArg], &ArgV[StartArg + 1], &ArgV[StartArg + 2])) {
-                return EXIT_FAILURE;
-            }
-        } else {
-            if (!IniToolDeleteFromIniFile(&ArgV[StartArg], &ArgV[StartArg + 1], NULL)) {
-                return EXIT_FAILURE;
-            }
-        }
-    } else if (Op == IniToolOpListSection) {
-        if (StartArg == 0 || StartArg + 2 > ArgC) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("initool: missing argument\n"));
-            return EXIT_FAILURE;
-        }
+    if (Result && Modified) {
+        Result = YoriLibIniFlush(IniFile);
+    }
 
-        if (!IniToolListSectionFromIniFile(&ArgV[StartArg], &ArgV[StartArg + 1])) {
-            return EXIT_FAILURE;
-        }
-    } else if (Op == IniToolOpListSections) {
-        if (StartArg == 0 || StartArg + 1 > ArgC) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("initool: missing argument\n"));
-            return EXIT_FAILURE;
-        }
+    YoriLibIniFree(IniFile);
 
-        if (!IniToolListSectionsFromIniFile(&ArgV[StartArg])) {
-            return EXIT_FAILURE;
-        }
+    if (!Result) {
+        return EXIT_FAILURE;
     }
 
     return EXIT_SUCCESS;
@@ -0,0 +1,297 @@
+/**
+ * @file lib/arena.c
+ *
+ * Yori arena allocation routines for short lived objects
+ *
+ * Copyright (c) 2024 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The default usable size of each chunk, in bytes.
+ */
+#define YORI_LIB_ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+
+/**
+ The alignment of every allocation returned from an arena.
+ */
+#define YORI_LIB_ARENA_ALIGNMENT (sizeof(YORI_MAX_UNSIGNED_T))
+
+/**
+ A single block of memory owned by an arena.  The memory handed out to
+ callers immediately follows this header.
+ */
+typedef struct _YORI_LIB_ARENA_CHUNK {
+
+    /**
+     The next chunk in whichever list this chunk is on.
+     */
+    PYORI_LIB_ARENA_CHUNK Next;
+
+    /**
+     The number of usable bytes following this header.
+     */
+    YORI_ALLOC_SIZE_T BytesAllocated;
+
+    /**
+     The number of usable bytes which have been handed out to callers.
+     */
+    YORI_ALLOC_SIZE_T BytesUsed;
+
+    /**
+     Padding so the data following the header is aligned.
+     */
+    YORI_MAX_UNSIGNED_T AlignmentPadding;
+
+} YORI_LIB_ARENA_CHUNK;
+
+/**
+ Initialize an arena.  No memory is allocated until the first allocation is
+ requested.  Allocations from an arena are not synchronized, so each arena
+ should be used by one thread at a time.
+
+ @param Arena Pointer to the arena to initialize.
+
+ @param ChunkSize The number of bytes to allocate from the heap at a time.
+        If zero, a default size is used.
+ */
+VOID
+YoriLibArenaCreate(
+    __out PYORI_LIB_ARENA Arena,
+    __in YORI_ALLOC_SIZE_T ChunkSize
+    )
+{
+    if (ChunkSize == 0) {
+        ChunkSize = YORI_LIB_ARENA_DEFAULT_CHUNK_SIZE;
+    }
+
+    Arena->Chunks = NULL;
+    Arena->FreeChunks = NULL;
+    Arena->ChunkSize = ChunkSize;
+}
+
+/**
+ Allocate a new chunk from the heap.
+
+ @param BytesRequired The number of usable bytes in the chunk.
+
+ @return Pointer to the chunk, or NULL on allocation failure.
+ */
+PYORI_LIB_ARENA_CHUNK
+YoriLibArenaAllocateChunk(
+    __in YORI_ALLOC_SIZE_T BytesRequired
+    )
+{
+    PYORI_LIB_ARENA_CHUNK Chunk;
+
+    if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)BytesRequired + sizeof(YORI_LIB_ARENA_CHUNK))) {
+        return NULL;
+    }
+
+    Chunk = YoriLibMalloc(BytesRequired + sizeof(YORI_LIB_ARENA_CHUNK));
+    if (Chunk == NULL) {
+        return NULL;
+    }
+
+    Chunk->Next = NULL;
+    Chunk->BytesAllocated = BytesRequired;
+    Chunk->BytesUsed = 0;
+    return Chunk;
+}
+
+/**
+ Allocate memory from an arena.  The memory remains valid until the arena
+ is reset or destroyed, and cannot be freed individually.
+
+ @param Arena Pointer to the arena.
+
+ @param SizeInBytes The number of bytes to allocate.
+
+ @return Pointer to the allocated memory, or NULL on allocation failure.
+ */
+__success(return != NULL)
+PVOID
+YoriLibArenaAlloc(
+    __inout PYORI_LIB_ARENA Arena,
+    __in YORI_ALLOC_SIZE_T SizeInBytes
+    )
+{
+    PYORI_LIB_ARENA_CHUNK Chunk;
+    PVOID Result;
+    YORI_ALLOC_SIZE_T AlignedSize;
+
+    if (SizeInBytes > YORI_MAX_ALLOC_SIZE - YORI_LIB_ARENA_ALIGNMENT) {
+        return NULL;
+    }
+
+    AlignedSize = (SizeInBytes + YORI_LIB_ARENA_ALIGNMENT - 1) & ~(YORI_LIB_ARENA_ALIGNMENT - 1);
+
+    //
+    //  If the current chunk has space, carve from it.
+    //
+
+    Chunk = Arena->Chunks;
+    if (Chunk != NULL &&
+        Chunk->BytesAllocated - Chunk->BytesUsed >= AlignedSize) {
+
+        Result = YoriLibAddToPointer(Chunk + 1, Chunk->BytesUsed);
+        Chunk->BytesUsed = Chunk->BytesUsed + AlignedSize;
+        return Result;
+    }
+
+    //
+    //  Large allocations get a chunk of their own.  This is inserted behind
+    //  the current chunk so the space remaining there can still be used.
+    //
+
+    if (AlignedSize > Arena->ChunkSize / 4) {
+        Chunk = YoriLibArenaAllocateChunk(AlignedSize);
+        if (Chunk == NULL) {
+            return NULL;
+        }
+
+        Chunk->BytesUsed = AlignedSize;
+        if (Arena->Chunks != NULL) {
+            Chunk->Next = Arena->Chunks->Next;
+            Arena->Chunks->Next = Chunk;
+        } else {
+            Arena->Chunks = Chunk;
+        }
+        return (Chunk + 1);
+    }
+
+    //
+    //  Otherwise start a new chunk, reusing one retained from a previous
+    //  reset if possible.
+    //
+
+    Chunk = Arena->FreeChunks;
+    if (Chunk != NULL) {
+        Arena->FreeChunks = Chunk->Next;
+        Chunk->BytesUsed = 0;
+    } else {
+        Chunk = YoriLibArenaAllocateChunk(Arena->ChunkSize);
+        if (Chunk == NULL) {
+            return NULL;
+        }
+    }
+
+    Chunk->Next = Arena->Chunks;
+    Arena->Chunks = Chunk;
+    Chunk->BytesUsed = AlignedSize;
+    return (Chunk + 1);
+}
+
+/**
+ Allocate a Yori string whose contents are taken from an arena.  The string
+ does not hold a reference, so freeing it has no effect, and its contents
+ remain valid until the arena is reset or destroyed.
+
+ @param Arena Pointer to the arena.
+
+ @param String On successful completion, populated to describe the newly
+        allocated buffer.
+
+ @param CharsToAllocate The number of characters to allocate in the string.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibArenaAllocateString(
+    __inout PYORI_LIB_ARENA Arena,
+    __out PYORI_STRING String,
+    __in YORI_ALLOC_SIZE_T CharsToAllocate
+    )
+{
+    YoriLibInitEmptyString(String);
+    if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)CharsToAllocate * sizeof(TCHAR))) {
+        return FALSE;
+    }
+
+    String->StartOfString = YoriLibArenaAlloc(Arena, CharsToAllocate * sizeof(TCHAR));
+    if (String->StartOfString == NULL) {
+        return FALSE;
+    }
+
+    String->LengthAllocated = CharsToAllocate;
+    return TRUE;
+}
+
+/**
+ Release every allocation made from an arena.  Regular sized chunks are
+ retained for reuse by later allocations, so an arena that is reset after
+ each phase of work stops calling the heap once it reaches its working set.
+
+ @param Arena Pointer to the arena.
+ */
+VOID
+YoriLibArenaReset(
+    __inout PYORI_LIB_ARENA Arena
+    )
+{
+    PYORI_LIB_ARENA_CHUNK Chunk;
+    PYORI_LIB_ARENA_CHUNK Next;
+
+    Chunk = Arena->Chunks;
+    while (Chunk != NULL) {
+        Next = Chunk->Next;
+        if (Chunk->BytesAllocated == Arena->ChunkSize) {
+            Chunk->Next = Arena->FreeChunks;
+            Arena->FreeChunks = Chunk;
+        } else {
+            YoriLibFree(Chunk);
+        }
+        Chunk = Next;
+    }
+
+    Arena->Chunks = NULL;
+}
+
+/**
+ Release every allocation made from an arena and return all of its memory
+ to the heap.  The arena can be used again after this call.
+
+ @param Arena Pointer to the arena.
+ */
+VOID
+YoriLibArenaDestroy(
+    __inout PYORI_LIB_ARENA Arena
+    )
+{
+    PYORI_LIB_ARENA_CHUNK Chunk;
+    PYORI_LIB_ARENA_CHUNK Next;
+
+    YoriLibArenaReset(Arena);
+
+    Chunk = Arena->FreeChunks;
+    while (Chunk != NULL) {
+        Next = Chunk->Next;
+        YoriLibFree(Chunk);
+        Chunk = Next;
+    }
+
+    Arena->FreeChunks = NULL;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,632 @@
+/**
+ * @file lib/asyncio.c
+ *
+ * Yori lib overlapped sequential IO with cancellation
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The number of buffers to use if the caller does not specify one.
+ */
+#define YORI_LIB_ASYNC_IO_DEFAULT_BUFFER_COUNT (4)
+
+/**
+ The size of each buffer to use if the caller does not specify one.
+ */
+#define YORI_LIB_ASYNC_IO_DEFAULT_BUFFER_SIZE (1024 * 1024)
+
+/**
+ The alignment of each buffer and of the buffer size.  This is a multiple of
+ any common sector size so that buffers can be used for unbuffered IO.
+ */
+#define YORI_LIB_ASYNC_IO_ALIGNMENT (4096)
+
+/**
+ Allocate the buffers and events used to perform overlapped IO.  The same
+ context can be used for any number of files, one at a time.
+
+ @param AsyncIo Pointer to the context to initialize.
+
+ @param BufferCount The number of buffers, which is the maximum number of IOs
+        that can be in flight at once.  If zero, a default is used.
+
+ @param BufferSize The size of each buffer in bytes.  If zero, a default is
+        used.  This is rounded up to a multiple of the sector size, and
+        buffers are page aligned, so they can be used for unbuffered IO.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibAsyncIoInitialize(
+    __out PYORI_LIB_ASYNC_IO AsyncIo,
+    __in DWORD BufferCount,
+    __in DWORD BufferSize
+    )
+{
+    DWORD Index;
+
+    ZeroMemory(AsyncIo, sizeof(YORI_LIB_ASYNC_IO));
+
+    if (BufferCount == 0) {
+        BufferCount = YORI_LIB_ASYNC_IO_DEFAULT_BUFFER_COUNT;
+    }
+
+    if (BufferSize == 0) {
+        BufferSize = YORI_LIB_ASYNC_IO_DEFAULT_BUFFER_SIZE;
+    }
+
+    BufferSize = (BufferSize + YORI_LIB_ASYNC_IO_ALIGNMENT - 1) & ~(YORI_LIB_ASYNC_IO_ALIGNMENT - 1);
+    if (BufferSize == 0 ||
+        !YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)BufferCount * BufferSize) ||
+        !YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)BufferCount * sizeof(YORI_LIB_ASYNC_IO_BUFFER))) {
+
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+
+    AsyncIo->Buffers = YoriLibMalloc(BufferCount * sizeof(YORI_LIB_ASYNC_IO_BUFFER));
+    if (AsyncIo->Buffers == NULL) {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+    ZeroMemory(AsyncIo->Buffers, BufferCount * sizeof(YORI_LIB_ASYNC_IO_BUFFER));
+    AsyncIo->BufferCount = BufferCount;
+    AsyncIo->BufferSize = BufferSize;
+
+    //
+    //  VirtualAlloc returns page aligned memory, which satisfies the buffer
+    //  alignment requirements of unbuffered IO.
+    //
+
+    AsyncIo->BufferMemory = VirtualAlloc(NULL, (SIZE_T)BufferCount * BufferSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (AsyncIo->BufferMemory == NULL) {
+        YoriLibAsyncIoCleanup(AsyncIo);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+
+    for (Index = 0; Index < BufferCount; Index++) {
+        AsyncIo->Buffers[Index].Buffer = AsyncIo->BufferMemory + (SIZE_T)Index * BufferSize;
+        AsyncIo->Buffers[Index].Overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if (AsyncIo->Buffers[Index].Overlapped.hEvent == NULL) {
+            YoriLibAsyncIoCleanup(AsyncIo);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Free the buffers and events used to perform overlapped IO.  Any IO must
+ have been completed with @ref YoriLibAsyncIoComplete .
+
+ @param AsyncIo Pointer to the context to clean up.
+ */
+VOID
+YoriLibAsyncIoCleanup(
+    __in PYORI_LIB_ASYNC_IO AsyncIo
+    )
+{
+    DWORD Index;
+
+    ASSERT(AsyncIo->ActiveCount == 0);
+
+    if (AsyncIo->Buffers != NULL) {
+        for (Index = 0; Index < AsyncIo->BufferCount; Index++) {
+            if (AsyncIo->Buffers[Index].Overlapped.hEvent != NULL) {
+                CloseHandle(AsyncIo->Buffers[Index].Overlapped.hEvent);
+            }
+        }
+        YoriLibFree(AsyncIo->Buffers);
+        AsyncIo->Buffers = NULL;
+    }
+
+    if (AsyncIo->BufferMemory != NULL) {
+        VirtualFree(AsyncIo->BufferMemory, 0, MEM_RELEASE);
+        AsyncIo->BufferMemory = NULL;
+    }
+}
+
+/**
+ Issue a read or write into a buffer at the next offset in the file.
+
+ @param AsyncIo Pointer to the context.
+
+ @param Buffer Pointer to the buffer to perform IO on.
+
+ @param Length The number of bytes to read or write.
+
+ @return ERROR_SUCCESS to indicate the IO was issued, ERROR_HANDLE_EOF if a
+         read is at or beyond the end of the file, or a Win32 error code on
+         failure.
+ */
+DWORD
+YoriLibAsyncIoStart(
+    __in PYORI_LIB_ASYNC_IO AsyncIo,
+    __in PYORI_LIB_ASYNC_IO_BUFFER Buffer,
+    __in DWORD Length
+    )
+{
+    DWORD BytesTransferred;
+    DWORD Err;
+    BOOL Result;
+
+    ASSERT(!Buffer->Active);
+
+    Buffer->Overlapped.Internal = 0;
+    Buffer->Overlapped.InternalHigh = 0;
+    Buffer->Overlapped.Offset = AsyncIo->NextOffset.LowPart;
+    Buffer->Overlapped.OffsetHigh = AsyncIo->NextOffset.HighPart;
+
+    if (AsyncIo->Writing) {
+        Result = WriteFile(AsyncIo->FileHandle, Buffer->Buffer, Length, &BytesTransferred, &Buffer->Overlapped);
+    } else {
+        Result = ReadFile(AsyncIo->FileHandle, Buffer->Buffer, Length, &BytesTransferred, &Buffer->Overlapped);
+    }
+
+    if (!Result) {
+        Err = GetLastError();
+        if (Err != ERROR_IO_PENDING) {
+            if (!AsyncIo->Writing && Err == ERROR_BROKEN_PIPE) {
+                Err = ERROR_HANDLE_EOF;
+            }
+            return Err;
+        }
+    }
+
+    Buffer->Active = TRUE;
+    AsyncIo->ActiveCount++;
+    AsyncIo->NextOffset.QuadPart = AsyncIo->NextOffset.QuadPart + Length;
+    return ERROR_SUCCESS;
+}
+
+/**
+ Wait for all IO in progress to finish and mark every buffer idle.  If the
+ operation is being abandoned, outstanding IO is cancelled first.  The IO
+ must finish before its buffer and event can be reused.
+
+ @param AsyncIo Pointer to the context.
+
+ @param Cancel TRUE to cancel outstanding IO, FALSE to let it finish.
+
+ @return ERROR_SUCCESS if all IO completed successfully, or the Win32 error
+         from the first IO that failed.
+ */
+DWORD
+YoriLibAsyncIoDrain(
+    __in PYORI_LIB_ASYNC_IO AsyncIo,
+    __in BOOLEAN Cancel
+    )
+{
+    PYORI_LIB_ASYNC_IO_BUFFER Buffer;
+    DWORD BytesTransferred;
+    DWORD Index;
+    DWORD Err;
+
+    Err = ERROR_SUCCESS;
+    if (AsyncIo->ActiveCount == 0) {
+        return Err;
+    }
+
+    if (Cancel) {
+        CancelIo(AsyncIo->FileHandle);
+    }
+
+    for (Index = 0; Index < AsyncIo->BufferCount; Index++) {
+        Buffer = &AsyncIo->Buffers[(AsyncIo->Oldest + Index) % AsyncIo->BufferCount];
+        if (Buffer->Active) {
+            if (!GetOverlappedResult(AsyncIo->FileHandle, &Buffer->Overlapped, &BytesTransferred, TRUE) &&
+                Err == ERROR_SUCCESS) {
+
+                Err = GetLastError();
+            }
+            Buffer->Active = FALSE;
+            AsyncIo->ActiveCount--;
+        }
+    }
+
+    ASSERT(AsyncIo->ActiveCount == 0);
+    return Err;
+}
+
+/**
+ Wait for the IO on a buffer to finish, or for the user to cancel the
+ operation.
+
+ @param AsyncIo Pointer to the context.
+
+ @param Buffer Pointer to the buffer to wait for.
+
+ @param BytesTransferred On successful completion, updated to contain the
+        number of bytes transferred by the IO.
+
+ @return ERROR_SUCCESS to indicate the IO completed, ERROR_OPERATION_ABORTED if the
+         operation was cancelled, or the Win32 error from the IO.  If an
+         error is returned, all IO has been stopped.
+ */
+DWORD
+YoriLibAsyncIoWait(
+    __in PYORI_LIB_ASYNC_IO AsyncIo,
+    __in PYORI_LIB_ASYNC_IO_BUFFER Buffer,
+    __out PDWORD BytesTransferred
+    )
+{
+    HANDLE Handles[2];
+    DWORD HandleCount;
+    DWORD WaitResult;
+    DWORD Err;
+
+    ASSERT(Buffer->Active);
+
+    //
+    //  If the IO and the cancel event are both signalled, the wait favours
+    //  the IO, so data that has already arrived is not discarded.
+    //
+
+    Handles[0] = Buffer->Overlapped.hEvent;
+    HandleCount = 1;
+    Handles[1] = YoriLibCancelGetEvent();
+    if (Handles[1] != NULL) {
+        HandleCount = 2;
+    }
+
+    WaitResult = WaitForMultipleObjects(HandleCount, Handles, FALSE, INFINITE);
+    if (WaitResult != WAIT_OBJECT_0) {
+        if (WaitResult == WAIT_OBJECT_0 + 1) {
+            Err = ERROR_OPERATION_ABORTED;
+        } else {
+            Err = GetLastError();
+        }
+        YoriLibAsyncIoDrain(AsyncIo, TRUE);
+        return Err;
+    }
+
+    Buffer->Active = FALSE;
+    AsyncIo->ActiveCount--;
+
+    if (!GetOverlappedResult(AsyncIo->FileHandle, &Buffer->Overlapped, BytesTransferred, FALSE)) {
+        Err = GetLastError();
+        if (!AsyncIo->Writing &&
+            (Err == ERROR_HANDLE_EOF || Err == ERROR_BROKEN_PIPE)) {
+
+            *BytesTransferred = 0;
+            return ERROR_SUCCESS;
+        }
+        YoriLibAsyncIoDrain(AsyncIo, TRUE);
+        return Err;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/**
+ Prepare the context to perform IO on a file.
+
+ @param AsyncIo Pointer to the context.
+
+ @param FileHandle The file to perform IO on.
+
+ @param Offset Optionally points to the offset within the file to start IO
+        at.  If not specified, IO starts at the beginning of the file.
+
+ @param Writing TRUE if the file is being written, FALSE if it is being read.
+ */
+VOID
+YoriLibAsyncIoBegin(
+    __in PYORI_LIB_ASYNC_IO AsyncIo,
+    __in HANDLE FileHandle,
+    __in_opt PLARGE_INTEGER Offset,
+    __in BOOLEAN Writing
+    )
+{
+    ASSERT(AsyncIo->ActiveCount == 0);
+
+    AsyncIo->FileHandle = FileHandle;
+    AsyncIo->NextOffset.QuadPart = 0;
+    if (Offset != NULL) {
+        AsyncIo->NextOffset.QuadPart = Offset->QuadPart;
+    }
+    AsyncIo->Oldest = 0;
+    AsyncIo->Error = ERROR_SUCCESS;
+    AsyncIo->Writing = Writing;
+    AsyncIo->EndOfFile = FALSE;
+    AsyncIo->CallerOwnsBuffer = FALSE;
+}
+
+/**
+ Start reading a file sequentially, keeping a read outstanding into every
+ buffer.  Data is returned in file order by @ref YoriLibAsyncRead .  IO only
+ overlaps if the handle was opened with FILE_FLAG_OVERLAPPED; other handles,
+ including pipes, still work but each read completes before it is issued.
+
+ @param AsyncIo Pointer to the context.
+
+ @param FileHandle The file to read.
+
+ @param Offset Optionally points to the offset within the file to start
+        reading from.  If not specified, reading starts at the beginning of
+        the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  On failure
+         no IO is in progress.
+ */
+__success(return)
+BOOL
+YoriLibAsyncReadBegin(
+    __in PYORI_LIB_ASYNC_IO AsyncIo,
+    __in HANDLE FileHandle,
+    __in_opt PLARGE_INTEGER Offset
+    )
+{
+    DWORD Index;
+    DWORD Err;
+
+    YoriLibAsyncIoBegin(AsyncIo, FileHandle, Offset, FALSE);
+
+    for (Index = 0; Index < AsyncIo->BufferCount; Index++) {
+        Err = YoriLibAsyncIoStart(AsyncIo, &AsyncIo->Buffers[Index], AsyncIo->BufferSize);
+        if (Err == ERROR_HANDLE_EOF) {
+            AsyncIo->EndOfFile = TRUE;
+            break;
+        } else if (Err != ERROR_SUCCESS) {
+            YoriLibAsyncIoDrain(AsyncIo, TRUE);
+            AsyncIo->Error = Err;
+            SetLastError(Err);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Return the next block of a file being read with
+ @ref YoriLibAsyncReadBegin .  The buffer returned remains valid until the
+ next call to this function or @ref YoriLibAsyncIoComplete , at which point
+ it is used for another read.  If the user cancels the operation, this
+ returns promptly and fails with ERROR_OPERATION_ABORTED.
+
+ @param AsyncIo Pointer to the context.
+
+ @param Data On successful completion, updated to point to the data that was
+        read.
+
+ @param BytesRead On successful completion, updated to contain the number of
+        bytes read.  Zero indicates the end of the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  On failure
+         no IO is in progress.
+ */
+__success(return)
+BOOL
+YoriLibAsyncRead(
+    __in PYORI_LIB_ASYNC_IO AsyncIo,
+    __out PUCHAR * Data,
+    __out PDWORD BytesRead
+    )
+{
+    PYORI_LIB_ASYNC_IO_BUFFER Buffer;
+    DWORD Err;
+
+    *Data = NULL;
+    *BytesRead = 0;
+
+    //
+    //  Reuse the buffer returned previously for a read beyond all of the
+    //  reads in progress.
+    //
+
+    if (AsyncIo->CallerOwnsBuffer) {
+        AsyncIo->CallerOwnsBuffer = FALSE;
+        Buffer = &AsyncIo->Buffers[AsyncIo->Oldest];
+        AsyncIo->Oldest = (AsyncIo->Oldest + 1) % AsyncIo->BufferCount;
+        if (!AsyncIo->EndOfFile) {
+            Err = YoriLibAsyncIoStart(AsyncIo, Buffer, AsyncIo->BufferSize);
+            if (Err == ERROR_HANDLE_EOF) {
+                AsyncIo->EndOfFile = TRUE;
+            } else if (Err != ERROR_SUCCESS) {
+                YoriLibAsyncIoDrain(AsyncIo, TRUE);
+                AsyncIo->Error = Err;
+            }
+        }
+    }
+
+    if (AsyncIo->Error != ERROR_SUCCESS) {
+        SetLastError(AsyncIo->Error);
+        return FALSE;
+    }
+
+    Buffer = &AsyncIo->Buffers[AsyncIo->Oldest];
+    if (!Buffer->Active) {
+        return TRUE;
+    }
+
+    Err = YoriLibAsyncIoWait(AsyncIo, Buffer, BytesRead);
+    if (Err != ERROR_SUCCESS) {
+        AsyncIo->Error = Err;
+        SetLastError(Err);
+        return FALSE;
+    }
+
+    //
+    //  Any reads beyond the end of the file have nothing to return.
+    //
+
+    if (*BytesRead == 0) {
+        AsyncIo->EndOfFile = TRUE;
+        YoriLibAsyncIoDrain(AsyncIo, TRUE);
+        return TRUE;
+    }
+
+    *Data = Buffer->Buffer;
+    AsyncIo->CallerOwnsBuffer = TRUE;
+    return TRUE;
+}
+
+/**
+ Start writing a file sequentially.  Data is supplied by filling a buffer
+ from @ref YoriLibAsyncWriteGetBuffer and issuing it with
+ @ref YoriLibAsyncWrite .  IO only overlaps if the handle was opened with
+ FILE_FLAG_OVERLAPPED.
+
+ @param AsyncIo Pointer to the context.
+
+ @param FileHandle The file to write.
+
+ @param Offset Optionally points to the offset within the file to start
+        writing to.  If not specified, writing starts at the beginning of the
+        file.
+ */
+VOID
+YoriLibAsyncWriteBegin(
+    __in PYORI_LIB_ASYNC_IO AsyncIo,
+    __in HANDLE FileHandle,
+    __in_opt PLARGE_INTEGER Offset
+    )
+{
+    YoriLibAsyncIoBegin(AsyncIo, FileHandle, Offset, TRUE);
+}
+
+/**
+ Return a buffer to fill with data to write.  If every buffer has a write in
+ progress, this waits for the oldest one to finish.  If the user cancels the
+ operation, this returns promptly and fails with ERROR_OPERATION_ABORTED.
+
+ @param AsyncIo Pointer to the context.
+
+ @return Pointer to a buffer of BufferSize bytes, or NULL on failure.  On
+         failure no IO is in progress.
+ */
+__success(return != NULL)
+PUCHAR
+YoriLibAsyncWriteGetBuffer(
+    __in PYORI_LIB_ASYNC_IO AsyncIo
+    )
+{
+    PYORI_LIB_ASYNC_IO_BUFFER Buffer;
+    DWORD BytesWritten;
+    DWORD Err;
+
+    if (AsyncIo->Error != ERROR_SUCCESS) {
+        SetLastError(AsyncIo->Error);
+        return NULL;
+    }
+
+    Buffer = &AsyncIo->Buffers[AsyncIo->Oldest];
+    if (Buffer->Active) {
+        Err = YoriLibAsyncIoWait(AsyncIo, Buffer, &BytesWritten);
+        if (Err == ERROR_SUCCESS && BytesWritten != Buffer->Length) {
+            YoriLibAsyncIoDrain(AsyncIo, TRUE);
+            Err = ERROR_WRITE_FAULT;
+        }
+        if (Err != ERROR_SUCCESS) {
+            AsyncIo->Error = Err;
+            SetLastError(Err);
+            return NULL;
+        }
+    }
+
+    return Buffer->Buffer;
+}
+
+/**
+ Write the buffer most recently returned from
+ @ref YoriLibAsyncWriteGetBuffer to the next offset in the file.
+
+ @param AsyncIo Pointer to the context.
+
+ @param Length The number of bytes in the buffer to write.
+
+ @return TRUE to indicate the write was issued, FALSE to indicate failure.
+         On failure no IO is in progress.
+ */
+__success(return)
+BOOL
+YoriLibAsyncWrite(
+    __in PYORI_LIB_ASYNC_IO AsyncIo,
+    __in DWORD Length
+    )
+{
+    PYORI_LIB_ASYNC_IO_BUFFER Buffer;
+    DWORD Err;
+
+    ASSERT(Length <= AsyncIo->BufferSize);
+
+    if (AsyncIo->Error != ERROR_SUCCESS) {
+        SetLastError(AsyncIo->Error);
+        return FALSE;
+    }
+
+    Buffer = &AsyncIo->Buffers[AsyncIo->Oldest];
+    Buffer->Length = Length;
+    Err = YoriLibAsyncIoStart(AsyncIo, Buffer, Length);
+    if (Err != ERROR_SUCCESS) {
+        YoriLibAsyncIoDrain(AsyncIo, TRUE);
+        AsyncIo->Error = Err;
+        SetLastError(Err);
+        return FALSE;
+    }
+
+    AsyncIo->Oldest = (AsyncIo->Oldest + 1) % AsyncIo->BufferCount;
+    return TRUE;
+}
+
+/**
+ Finish performing IO on a file.  Writes in progress are waited for, and
+ reads in progress are cancelled since their data is no longer needed.
+ Once this returns, the context can be used for another file.
+
+ @param AsyncIo Pointer to the context.
+
+ @return TRUE if every IO succeeded, FALSE if any failed or the operation was
+         cancelled.  On failure, the error is available from GetLastError.
+ */
+__success(return)
+BOOL
+YoriLibAsyncIoComplete(
+    __in PYORI_LIB_ASYNC_IO AsyncIo
+    )
+{
+    DWORD Err;
+
+    Err = YoriLibAsyncIoDrain(AsyncIo, (BOOLEAN)!AsyncIo->Writing);
+    if (AsyncIo->Writing && AsyncIo->Error == ERROR_SUCCESS) {
+        AsyncIo->Error = Err;
+    }
+
+    AsyncIo->CallerOwnsBuffer = FALSE;
+    AsyncIo->FileHandle = NULL;
+
+    if (AsyncIo->Error != ERROR_SUCCESS) {
+        SetLastError(AsyncIo->Error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
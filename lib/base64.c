@@ -0,0 +1,431 @@
+/**
+ * @file lib/base64.c
+ *
+ * Yori base64 encode and decode in fixed size blocks
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The characters used to encode each six bit value.
+ */
+CONST CHAR YoriLibBase64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/**
+ A value in YoriLibBase64DecodeTable indicating a whitespace character which
+ is ignored when decoding.
+ */
+#define YORI_LIB_BASE64_DECODE_WHITESPACE (0x40)
+
+/**
+ A value in YoriLibBase64DecodeTable indicating a padding character.
+ */
+#define YORI_LIB_BASE64_DECODE_PAD        (0x41)
+
+/**
+ A value in YoriLibBase64DecodeTable indicating a character which is not
+ valid in base64 encoded data.
+ */
+#define YORI_LIB_BASE64_DECODE_INVALID    (0xFF)
+
+/**
+ A table of the two characters to emit for each twelve bit value, so that
+ each three bytes of input is encoded with two lookups.
+ */
+CHAR YoriLibBase64EncodeTable[4096][2];
+
+/**
+ A table of the six bit value for each input character, or one of the
+ YORI_LIB_BASE64_DECODE_ values above.  Every value that is not a six bit
+ value has a bit above the low six set, so four characters can be checked
+ for validity by combining them.
+ */
+UCHAR YoriLibBase64DecodeTable[256];
+
+/**
+ TRUE once YoriLibBase64EncodeTable and YoriLibBase64DecodeTable have been
+ populated.
+ */
+BOOLEAN YoriLibBase64TablesInitialized;
+
+/**
+ Populate the base64 tables.  If two threads race to do this, both write
+ identical values, so no synchronization is needed.
+ */
+VOID
+YoriLibBase64InitializeTables(VOID)
+{
+    DWORD Index;
+
+    for (Index = 0; Index < 4096; Index++) {
+        YoriLibBase64EncodeTable[Index][0] = YoriLibBase64Alphabet[Index >> 6];
+        YoriLibBase64EncodeTable[Index][1] = YoriLibBase64Alphabet[Index & 0x3F];
+    }
+
+    for (Index = 0; Index < 256; Index++) {
+        YoriLibBase64DecodeTable[Index] = YORI_LIB_BASE64_DECODE_INVALID;
+    }
+
+    for (Index = 0; Index < 64; Index++) {
+        YoriLibBase64DecodeTable[(UCHAR)YoriLibBase64Alphabet[Index]] = (UCHAR)Index;
+    }
+
+    YoriLibBase64DecodeTable[' '] = YORI_LIB_BASE64_DECODE_WHITESPACE;
+    YoriLibBase64DecodeTable['\t'] = YORI_LIB_BASE64_DECODE_WHITESPACE;
+    YoriLibBase64DecodeTable['\r'] = YORI_LIB_BASE64_DECODE_WHITESPACE;
+    YoriLibBase64DecodeTable['\n'] = YORI_LIB_BASE64_DECODE_WHITESPACE;
+    YoriLibBase64DecodeTable['='] = YORI_LIB_BASE64_DECODE_PAD;
+
+    YoriLibBase64TablesInitialized = TRUE;
+}
+
+/**
+ Encode a buffer as base64.  Data can be encoded in pieces by calling this
+ repeatedly, provided that every piece other than the last is a multiple of
+ three bytes.  The final piece is padded as needed.  No line breaks are
+ inserted.
+
+ @param Input Pointer to the data to encode.
+
+ @param InputLength The number of bytes in Input.
+
+ @param Output Pointer to a buffer to receive the encoded characters.  This
+        must be at least YORI_LIB_BASE64_ENCODED_LENGTH(InputLength) bytes.
+
+ @return The number of characters written to Output.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibBase64Encode(
+    __in CONST UCHAR * Input,
+    __in YORI_ALLOC_SIZE_T InputLength,
+    __out_ecount(YORI_LIB_BASE64_ENCODED_LENGTH(InputLength)) PUCHAR Output
+    )
+{
+    CONST UCHAR * Src;
+    PUCHAR Dest;
+    YORI_ALLOC_SIZE_T Remaining;
+    DWORD Group;
+    CHAR CONST * Pair;
+
+    if (!YoriLibBase64TablesInitialized) {
+        YoriLibBase64InitializeTables();
+    }
+
+    Src = Input;
+    Dest = Output;
+    Remaining = InputLength;
+
+    //
+    //  Process twelve bytes per step, which generates sixteen characters
+    //  from eight lookups.
+    //
+
+    while (Remaining >= 12) {
+        Group = ((DWORD)Src[0] << 16) | ((DWORD)Src[1] << 8) | Src[2];
+        Pair = YoriLibBase64EncodeTable[Group >> 12];
+        Dest[0] = Pair[0];
+        Dest[1] = Pair[1];
+        Pair = YoriLibBase64EncodeTable[Group & 0xFFF];
+        Dest[2] = Pair[0];
+        Dest[3] = Pair[1];
+
+        Group = ((DWORD)Src[3] << 16) | ((DWORD)Src[4] << 8) | Src[5];
+        Pair = YoriLibBase64EncodeTable[Group >> 12];
+        Dest[4] = Pair[0];
+        Dest[5] = Pair[1];
+        Pair = YoriLibBase64EncodeTable[Group & 0xFFF];
+        Dest[6] = Pair[0];
+        Dest[7] = Pair[1];
+
+        Group = ((DWORD)Src[6] << 16) | ((DWORD)Src[7] << 8) | Src[8];
+        Pair = YoriLibBase64EncodeTable[Group >> 12];
+        Dest[8] = Pair[0];
+        Dest[9] = Pair[1];
+        Pair = YoriLibBase64EncodeTable[Group & 0xFFF];
+        Dest[10] = Pair[0];
+        Dest[11] = Pair[1];
+
+        Group = ((DWORD)Src[9] << 16) | ((DWORD)Src[10] << 8) | Src[11];
+        Pair = YoriLibBase64EncodeTable[Group >> 12];
+        Dest[12] = Pair[0];
+        Dest[13] = Pair[1];
+        Pair = YoriLibBase64EncodeTable[Group & 0xFFF];
+        Dest[14] = Pair[0];
+        Dest[15] = Pair[1];
+
+        Src = Src + 12;
+        Dest = Dest + 16;
+        Remaining = Remaining - 12;
+    }
+
+    while (Remaining >= 3) {
+        Group = ((DWORD)Src[0] << 16) | ((DWORD)Src[1] << 8) | Src[2];
+        Pair = YoriLibBase64EncodeTable[Group >> 12];
+        Dest[0] = Pair[0];
+        Dest[1] = Pair[1];
+        Pair = YoriLibBase64EncodeTable[Group & 0xFFF];
+        Dest[2] = Pair[0];
+        Dest[3] = Pair[1];
+
+        Src = Src + 3;
+        Dest = Dest + 4;
+        Remaining = Remaining - 3;
+    }
+
+    if (Remaining > 0) {
+        Group = (DWORD)Src[0] << 16;
+        if (Remaining > 1) {
+            Group = Group | ((DWORD)Src[1] << 8);
+        }
+        Dest[0] = YoriLibBase64Alphabet[Group >> 18];
+        Dest[1] = YoriLibBase64Alphabet[(Group >> 12) & 0x3F];
+        if (Remaining > 1) {
+            Dest[2] = YoriLibBase64Alphabet[(Group >> 6) & 0x3F];
+        } else {
+            Dest[2] = '=';
+        }
+        Dest[3] = '=';
+        Dest = Dest + 4;
+    }
+
+    return (YORI_ALLOC_SIZE_T)(Dest - Output);
+}
+
+/**
+ Prepare to decode a new base64 stream.
+
+ @param State Pointer to the decode state to initialize.
+ */
+VOID
+YoriLibBase64DecodeInitialize(
+    __out PYORI_LIB_BASE64_DECODE_STATE State
+    )
+{
+    State->Accumulator = 0;
+    State->CharCount = 0;
+    State->PadCount = 0;
+    State->Complete = FALSE;
+}
+
+/**
+ Emit the bytes described by a complete or final quantum of characters
+ and reset the quantum.
+
+ @param State Pointer to the decode state.
+
+ @param Output Pointer to the location to write the decoded bytes.
+
+ @return The number of bytes written to Output.
+ */
+DWORD
+YoriLibBase64DecodeFlushQuantum(
+    __inout PYORI_LIB_BASE64_DECODE_STATE State,
+    __out_ecount(3) PUCHAR Output
+    )
+{
+    DWORD Accumulator;
+    DWORD BytesToWrite;
+    DWORD CharCount;
+
+    //
+    //  Align the accumulator as though four characters had been provided,
+    //  then emit one byte fewer than the number of characters with data.
+    //
+
+    Accumulator = State->Accumulator;
+    for (CharCount = State->CharCount; CharCount < 4; CharCount++) {
+        Accumulator = Accumulator << 6;
+    }
+
+    BytesToWrite = State->CharCount - State->PadCount - 1;
+    Output[0] = (UCHAR)(Accumulator >> 16);
+    if (BytesToWrite > 1) {
+        Output[1] = (UCHAR)(Accumulator >> 8);
+    }
+    if (BytesToWrite > 2) {
+        Output[2] = (UCHAR)Accumulator;
+    }
+
+    State->Accumulator = 0;
+    State->CharCount = 0;
+    return BytesToWrite;
+}
+
+/**
+ Decode a buffer of base64 characters.  A stream can be decoded in pieces of
+ any size by calling this repeatedly with the same state, and calling
+ YoriLibBase64DecodeFinalize after the final piece.  Whitespace is ignored.
+
+ @param State Pointer to the decode state, which carries any partial group
+        of characters between calls.
+
+ @param Input Pointer to the characters to decode.
+
+ @param InputLength The number of characters in Input.
+
+ @param Output Pointer to a buffer to receive decoded data.  This must be at
+        least YORI_LIB_BASE64_DECODED_LENGTH(InputLength) bytes.
+
+ @param BytesWritten On successful completion, updated to contain the number
+        of bytes written to Output.
+
+ @return TRUE to indicate success, FALSE if the input is not valid base64.
+ */
+__success(return)
+BOOLEAN
+YoriLibBase64Decode(
+    __inout PYORI_LIB_BASE64_DECODE_STATE State,
+    __in CONST UCHAR * Input,
+    __in YORI_ALLOC_SIZE_T InputLength,
+    __out_ecount(YORI_LIB_BASE64_DECODED_LENGTH(InputLength)) PUCHAR Output,
+    __out PYORI_ALLOC_SIZE_T BytesWritten
+    )
+{
+    CONST UCHAR * Src;
+    CONST UCHAR * End;
+    PUCHAR Dest;
+    UCHAR Value0;
+    UCHAR Value1;
+    UCHAR Value2;
+    UCHAR Value3;
+    DWORD Group;
+
+    if (!YoriLibBase64TablesInitialized) {
+        YoriLibBase64InitializeTables();
+    }
+
+    Src = Input;
+    End = Input + InputLength;
+    Dest = Output;
+
+    while (Src < End) {
+
+        //
+        //  When aligned to the start of a group, decode four characters at
+        //  a time for as long as they are all data characters.  Anything
+        //  else falls through to be handled one character at a time.
+        //
+
+        if (State->CharCount == 0 && !State->Complete) {
+            while (End - Src >= 4) {
+                Value0 = YoriLibBase64DecodeTable[Src[0]];
+                Value1 = YoriLibBase64DecodeTable[Src[1]];
+                Value2 = YoriLibBase64DecodeTable[Src[2]];
+                Value3 = YoriLibBase64DecodeTable[Src[3]];
+                if ((Value0 | Value1 | Value2 | Value3) & 0xC0) {
+                    break;
+                }
+
+                Group = ((DWORD)Value0 << 18) | ((DWORD)Value1 << 12) | ((DWORD)Value2 << 6) | Value3;
+                Dest[0] = (UCHAR)(Group >> 16);
+                Dest[1] = (UCHAR)(Group >> 8);
+                Dest[2] = (UCHAR)Group;
+                Dest = Dest + 3;
+                Src = Src + 4;
+            }
+
+            if (Src >= End) {
+                break;
+            }
+        }
+
+        Value0 = YoriLibBase64DecodeTable[*Src];
+        Src++;
+
+        if (Value0 == YORI_LIB_BASE64_DECODE_WHITESPACE) {
+            continue;
+        }
+
+        if (Value0 == YORI_LIB_BASE64_DECODE_INVALID || State->Complete) {
+            return FALSE;
+        }
+
+        //
+        //  Padding can only occur in the final two positions of a group,
+        //  and once started, only more padding can complete the group.
+        //
+
+        if (Value0 == YORI_LIB_BASE64_DECODE_PAD) {
+            if (State->CharCount < 2) {
+                return FALSE;
+            }
+            State->PadCount++;
+            Value0 = 0;
+        } else if (State->PadCount > 0) {
+            return FALSE;
+        }
+
+        State->Accumulator = (State->Accumulator << 6) | Value0;
+        State->CharCount++;
+
+        if (State->CharCount == 4) {
+            if (State->PadCount > 0) {
+                State->Complete = TRUE;
+            }
+            Dest = Dest + YoriLibBase64DecodeFlushQuantum(State, Dest);
+        }
+    }
+
+    *BytesWritten = (YORI_ALLOC_SIZE_T)(Dest - Output);
+    return TRUE;
+}
+
+/**
+ Complete decoding a base64 stream.  A final group that is missing its
+ padding is accepted.
+
+ @param State Pointer to the decode state.
+
+ @param Output Pointer to a buffer to receive any remaining decoded data.
+        This must be at least three bytes.
+
+ @param BytesWritten On successful completion, updated to contain the number
+        of bytes written to Output.
+
+ @return TRUE to indicate success, FALSE if the stream ended partway through
+         a byte.
+ */
+__success(return)
+BOOLEAN
+YoriLibBase64DecodeFinalize(
+    __inout PYORI_LIB_BASE64_DECODE_STATE State,
+    __out_ecount(3) PUCHAR Output,
+    __out PYORI_ALLOC_SIZE_T BytesWritten
+    )
+{
+    *BytesWritten = 0;
+    if (State->CharCount == 0) {
+        return TRUE;
+    }
+
+    if (State->CharCount - State->PadCount < 2) {
+        return FALSE;
+    }
+
+    *BytesWritten = (YORI_ALLOC_SIZE_T)YoriLibBase64DecodeFlushQuantum(State, Output);
+    State->Complete = TRUE;
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
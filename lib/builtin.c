@@ -28,6 +28,30 @@
 #include "yorilib.h"
 #include "yoricall.h"
 
+/**
+ A variable in the current environment, recorded while a new set of
+ environment strings is applied so that variables which are unchanged can
+ be left alone.
+ */
+typedef struct _YORI_LIB_BUILTIN_ENV_VAR {
+
+    /**
+     The entry within the hash table, whose key is the variable name.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The value of the variable in the current environment.
+     */
+    YORI_STRING Value;
+
+    /**
+     Set to TRUE if the variable is present in the new environment, so it
+     should not be deleted.
+     */
+    BOOLEAN Retained;
+} YORI_LIB_BUILTIN_ENV_VAR, *PYORI_LIB_BUILTIN_ENV_VAR;
+
 /**
  Retore a set of environment strings into the current environment.  This
  implies removing all currently defined variables and replacing them with
@@ -36,6 +60,13 @@
  interface.  Note that the input buffer is modified temporarily (ie.,
  it is not immutable.)
 
+ Typically the new environment differs from the current one by a handful
+ of variables, such as when endlocal restores the environment saved by
+ setlocal.  Only variables whose value is changing are set, and only
+ variables that are not in the new environment are deleted, so the cost
+ is proportional to the number of changes rather than the size of the
+ environment.
+
  @param NewEnvironment Pointer to the new environment strings to apply.
 
  @return TRUE to indicate success, FALSE to indicate failure.
@@ -48,9 +79,15 @@ YoriLibBuiltinSetEnvironmentStrings(
     YORI_STRING CurrentEnvironment;
     YORI_STRING VariableName;
     YORI_STRING ValueName;
+    PYORI_HASH_TABLE CurrentVars;
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_LIB_BUILTIN_ENV_VAR Vars;
+    PYORI_LIB_BUILTIN_ENV_VAR Var;
     LPTSTR ThisVar;
     LPTSTR ThisValue;
     YORI_ALLOC_SIZE_T VarLen;
+    YORI_ALLOC_SIZE_T VarCount;
+    YORI_ALLOC_SIZE_T Index;
 
     if (!YoriLibGetEnvironmentStrings(&CurrentEnvironment)) {
         return FALSE;
@@ -59,42 +96,79 @@ YoriLibBuiltinSetEnvironmentStrings(
     YoriLibInitEmptyString(&VariableName);
     YoriLibInitEmptyString(&ValueName);
 
+    //
+    //  Count the variables in the current environment.  We know there's at
+    //  least one char in each.  Skip it if it's equals since that's how
+    //  drive current directories are recorded.
+    //
+
+    VarCount = 0;
     ThisVar = CurrentEnvironment.StartOfString;
     while (*ThisVar != '\0') {
         VarLen = (YORI_ALLOC_SIZE_T)_tcslen(ThisVar);
+        if (_tcschr(&ThisVar[1], '=') != NULL) {
+            VarCount++;
+        }
+        ThisVar += VarLen;
+        ThisVar++;
+    }
+
+    CurrentVars = YoriLibAllocateHashTable(VarCount + 1);
+    if (CurrentVars == NULL) {
+        YoriLibFreeStringContents(&CurrentEnvironment);
+        return FALSE;
+    }
 
-        //
-        //  We know there's at least one char.  Skip it if it's equals since
-        //  that's how drive current directories are recorded.
-        //
+    Vars = NULL;
+    if (VarCount > 0) {
+        Vars = YoriLibMalloc(VarCount * sizeof(YORI_LIB_BUILTIN_ENV_VAR));
+        if (Vars == NULL) {
+            YoriLibFreeEmptyHashTable(CurrentVars);
+            YoriLibFreeStringContents(&CurrentEnvironment);
+            return FALSE;
+        }
+    }
+
+    //
+    //  Record each current variable.  The names are terminated within the
+    //  buffer so they can be deleted later.
+    //
+
+    Index = 0;
+    ThisVar = CurrentEnvironment.StartOfString;
+    while (*ThisVar != '\0' && Index < VarCount) {
+        VarLen = (YORI_ALLOC_SIZE_T)_tcslen(ThisVar);
 
         ThisValue = _tcschr(&ThisVar[1], '=');
         if (ThisValue != NULL) {
             ThisValue[0] = '\0';
+            Var = &Vars[Index];
             VariableName.StartOfString = ThisVar;
             VariableName.LengthInChars = (YORI_ALLOC_SIZE_T)(ThisValue - ThisVar);
             VariableName.LengthAllocated = (YORI_ALLOC_SIZE_T)(VariableName.LengthInChars + 1);
-            YoriCallSetEnvironmentVariable(&VariableName, NULL);
+            YoriLibInitEmptyString(&Var->Value);
+            Var->Value.StartOfString = &ThisValue[1];
+            Var->Value.LengthInChars = (YORI_ALLOC_SIZE_T)(VarLen - VariableName.LengthInChars - 1);
+            Var->Value.LengthAllocated = (YORI_ALLOC_SIZE_T)(Var->Value.LengthInChars + 1);
+            Var->Retained = FALSE;
+            YoriLibHashInsertByKey(CurrentVars, &VariableName, Var, &Var->HashEntry);
+            Index++;
         }
 
         ThisVar += VarLen;
         ThisVar++;
     }
-    YoriLibFreeStringContents(&CurrentEnvironment);
+    VarCount = Index;
 
     //
-    //  Now restore the saved environment.
+    //  Now apply the saved environment, setting any variable whose value
+    //  is different to its current value.
     //
 
     ThisVar = NewEnvironment->StartOfString;
     while (*ThisVar != '\0') {
         VarLen = (YORI_ALLOC_SIZE_T)_tcslen(ThisVar);
 
-        //
-        //  We know there's at least one char.  Skip it if it's equals since
-        //  that's how drive current directories are recorded.
-        //
-
         ThisValue = _tcschr(&ThisVar[1], '=');
         if (ThisValue != NULL) {
             ThisValue[0] = '\0';
@@ -105,7 +179,28 @@ YoriLibBuiltinSetEnvironmentStrings(
             ValueName.StartOfString = ThisValue;
             ValueName.LengthInChars = (YORI_ALLOC_SIZE_T)(VarLen - VariableName.LengthInChars - 1);
             ValueName.LengthAllocated = (YORI_ALLOC_SIZE_T)(ValueName.LengthInChars + 1);
-            YoriCallSetEnvironmentVariable(&VariableName, &ValueName);
+
+            HashEntry = YoriLibHashLookupByKey(CurrentVars, &VariableName);
+            if (HashEntry == NULL) {
+                YoriCallSetEnvironmentVariable(&VariableName, &ValueName);
+            } else {
+                Var = HashEntry->Context;
+                Var->Retained = TRUE;
+
+                //
+                //  Setting a variable retains the case of an existing name,
+                //  so if only the case of the name differs, delete the
+                //  existing variable first.
+                //
+
+                if (YoriLibCompareString(&HashEntry->Key, &VariableName) != 0) {
+                    YoriCallSetEnvironmentVariable(&HashEntry->Key, NULL);
+                    YoriCallSetEnvironmentVariable(&VariableName, &ValueName);
+                } else if (YoriLibCompareString(&Var->Value, &ValueName) != 0) {
+                    YoriCallSetEnvironmentVariable(&VariableName, &ValueName);
+                }
+            }
+
             ThisValue--;
             ThisValue[0] = '=';
         }
@@ -114,6 +209,24 @@ YoriLibBuiltinSetEnvironmentStrings(
         ThisVar++;
     }
 
+    //
+    //  Delete anything that is not in the saved environment.
+    //
+
+    for (Index = 0; Index < VarCount; Index++) {
+        Var = &Vars[Index];
+        if (!Var->Retained) {
+            YoriCallSetEnvironmentVariable(&Var->HashEntry.Key, NULL);
+        }
+        YoriLibHashRemoveByEntry(&Var->HashEntry);
+    }
+
+    if (Vars != NULL) {
+        YoriLibFree(Vars);
+    }
+    YoriLibFreeEmptyHashTable(CurrentVars);
+    YoriLibFreeStringContents(&CurrentEnvironment);
+
     return TRUE;
 }
 
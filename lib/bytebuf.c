@@ -3,7 +3,7 @@
  *
  * Yori expandable memory buffer
  *
- * Copyright (c) 2017-2023 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -27,6 +27,22 @@
 #include "yoripch.h"
 #include "yorilib.h"
 
+/**
+ The granularity used when reserving and committing memory for a reserved
+ byte buffer.  This matches the allocation granularity of VirtualAlloc.
+ */
+#define YORI_LIB_BYTE_BUFFER_RESERVE_GRANULARITY (64 * 1024)
+
+/**
+ Round a size up to the granularity used for reserved byte buffers.
+
+ @param Size The size to round.
+
+ @return The rounded size.
+ */
+#define YoriLibByteBufferRoundToGranularity(Size) \
+    (((Size) + YORI_LIB_BYTE_BUFFER_RESERVE_GRANULARITY - 1) & ~((YORI_MAX_UNSIGNED_T)YORI_LIB_BYTE_BUFFER_RESERVE_GRANULARITY - 1))
+
 /**
  Initialize a byte buffer.  The structure itself is owned by the caller.
 
@@ -46,6 +62,7 @@ YoriLibByteBufferInitialize(
     Buffer->Buffer = NULL;
     Buffer->BytesAllocated = InitialSize;
     Buffer->BytesPopulated = 0;
+    Buffer->BytesReserved = 0;
 
     if (InitialSize > 0) {
         if (!YoriLibIsSizeAllocatable(InitialSize)) {
@@ -61,6 +78,47 @@ YoriLibByteBufferInitialize(
     return TRUE;
 }
 
+/**
+ Initialize a byte buffer which reserves address space for its maximum
+ expected size and commits memory as it grows.  Unlike a buffer from
+ @ref YoriLibByteBufferInitialize , growing does not copy existing data,
+ which matters for buffers that grow to a very large size.  Memory is only
+ committed as it is needed, so reserving a large range is inexpensive.  If
+ the buffer grows beyond the reserved size it can still be extended, but
+ doing so requires a copy.
+
+ @param Buffer Pointer to the buffer to initialize.
+
+ @param MaximumSize The number of bytes of address space to reserve.
+
+ @return TRUE if the buffer is successfully initialized, FALSE if it is not.
+ */
+BOOL
+YoriLibByteBufferInitializeReserved(
+    __out PYORI_LIB_BYTE_BUFFER Buffer,
+    __in YORI_MAX_UNSIGNED_T MaximumSize
+    )
+{
+    YORI_MAX_UNSIGNED_T BytesToReserve;
+
+    YoriLibByteBufferInitialize(Buffer, 0);
+
+    BytesToReserve = YoriLibByteBufferRoundToGranularity(MaximumSize);
+    if (BytesToReserve == 0 ||
+        !YoriLibIsSizeAllocatable(BytesToReserve)) {
+
+        return FALSE;
+    }
+
+    Buffer->Buffer = VirtualAlloc(NULL, (SIZE_T)BytesToReserve, MEM_RESERVE, PAGE_READWRITE);
+    if (Buffer->Buffer == NULL) {
+        return FALSE;
+    }
+
+    Buffer->BytesReserved = BytesToReserve;
+    return TRUE;
+}
+
 /**
  Free structures associated with a single input stream.
 
@@ -71,7 +129,9 @@ YoriLibByteBufferCleanup(
     __in PYORI_LIB_BYTE_BUFFER Buffer
     )
 {
-    if (Buffer->Buffer != NULL) {
+    if (Buffer->BytesReserved != 0) {
+        VirtualFree(Buffer->Buffer, 0, MEM_RELEASE);
+    } else if (Buffer->Buffer != NULL) {
         YoriLibFree(Buffer->Buffer);
     }
 
@@ -92,6 +152,82 @@ YoriLibByteBufferReset(
     Buffer->BytesPopulated = 0;
 }
 
+/**
+ Extend a reserved byte buffer to a specified number of bytes.  If the
+ reserved range is large enough, this commits more of it.  If not, a larger
+ range is reserved and existing data is moved into it.
+
+ @param Buffer Pointer to the byte buffer structure.
+
+ @param NewTotalLength The new total length to commit in the byte buffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+YoriLibByteBufferExtendReserved(
+    __in PYORI_LIB_BYTE_BUFFER Buffer,
+    __in YORI_ALLOC_SIZE_T NewTotalLength
+    )
+{
+    YORI_MAX_UNSIGNED_T BytesToCommit;
+    YORI_MAX_UNSIGNED_T BytesToReserve;
+    PUCHAR NewBuffer;
+
+    BytesToCommit = YoriLibByteBufferRoundToGranularity(NewTotalLength);
+
+    if (BytesToCommit <= Buffer->BytesReserved) {
+        if (VirtualAlloc(YoriLibAddToPointer(Buffer->Buffer, Buffer->BytesAllocated),
+                         (SIZE_T)(BytesToCommit - Buffer->BytesAllocated),
+                         MEM_COMMIT,
+                         PAGE_READWRITE) == NULL) {
+
+            return FALSE;
+        }
+
+        Buffer->BytesAllocated = BytesToCommit;
+        return TRUE;
+    }
+
+    //
+    //  The caller underestimated the size needed.  Reserve twice as much
+    //  so that copying remains infrequent.
+    //
+
+    BytesToReserve = Buffer->BytesReserved * 2;
+    if (BytesToReserve < BytesToCommit) {
+        BytesToReserve = BytesToCommit;
+    }
+
+    if (!YoriLibIsSizeAllocatable(BytesToReserve)) {
+        BytesToReserve = BytesToCommit;
+        if (!YoriLibIsSizeAllocatable(BytesToReserve)) {
+            return FALSE;
+        }
+    }
+
+    NewBuffer = VirtualAlloc(NULL, (SIZE_T)BytesToReserve, MEM_RESERVE, PAGE_READWRITE);
+    if (NewBuffer == NULL) {
+        return FALSE;
+    }
+
+    if (VirtualAlloc(NewBuffer, (SIZE_T)BytesToCommit, MEM_COMMIT, PAGE_READWRITE) == NULL) {
+        VirtualFree(NewBuffer, 0, MEM_RELEASE);
+        return FALSE;
+    }
+
+    if (Buffer->BytesPopulated > 0) {
+        memcpy(NewBuffer, Buffer->Buffer, (SIZE_T)Buffer->BytesPopulated);
+    }
+
+    VirtualFree(Buffer->Buffer, 0, MEM_RELEASE);
+
+    Buffer->Buffer = NewBuffer;
+    Buffer->BytesAllocated = BytesToCommit;
+    Buffer->BytesReserved = BytesToReserve;
+
+    return TRUE;
+}
+
 /**
  Extend the byte buffer to a specified number of bytes.  This extends the
  allocation only without populating any contents.
@@ -114,6 +250,10 @@ YoriLibByteBufferExtend(
         return FALSE;
     }
 
+    if (Buffer->BytesReserved != 0) {
+        return YoriLibByteBufferExtendReserved(Buffer, NewTotalLength);
+    }
+
     if (!YoriLibIsSizeAllocatable(NewTotalLength)) {
         return FALSE;
     }
@@ -179,6 +319,19 @@ YoriLibByteBufferGetPointerToEnd(
             DesiredLength = RequiredLength;
         }
 
+        //
+        //  A reserved buffer doesn't need to grow geometrically to avoid
+        //  copies, but committing in large steps avoids a system call for
+        //  each small extension.  Don't let that exceed the reservation.
+        //
+
+        if (Buffer->BytesReserved != 0 &&
+            RequiredLength <= Buffer->BytesReserved &&
+            DesiredLength > Buffer->BytesReserved) {
+
+            DesiredLength = Buffer->BytesReserved;
+        }
+
         NewLength = YoriLibMaximumAllocationInRange(RequiredLength, DesiredLength);
         if (NewLength == 0) {
             return NULL;
@@ -3,7 +3,7 @@
  *
  * Yori shell extract .cab files
  *
- * Copyright (c) 2018-2022 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -27,6 +27,25 @@
 #include <yoripch.h>
 #include <yorilib.h>
 
+/**
+ The number of bytes to accumulate before writing to a file being extracted.
+ FDI writes each decompressed block individually, which is typically 32Kb.
+ */
+#define YORI_LIB_CAB_WRITE_BUFFER_SIZE (256 * 1024)
+
+/**
+ The maximum number of threads to use when extracting a CAB.  Each thread
+ extracts a distinct set of folders.
+ */
+#define YORI_LIB_CAB_MAX_EXTRACT_THREADS (8)
+
+/**
+ The compressed size of a folder at which a new folder is started when
+ creating a CAB.  Each folder is a separate compression stream, so a CAB
+ with several folders can be extracted by several threads.
+ */
+#define YORI_LIB_CAB_FOLDER_THRESHOLD (1024 * 1024)
+
 /**
  Context information to pass around as files are being expanded.
  */
@@ -89,8 +108,53 @@ typedef struct _YORI_LIB_CAB_EXPAND_CONTEXT {
      */
     PYORI_STRING ErrorString;
 
+    /**
+     If the CAB is being extracted by multiple threads, a mutex to
+     serialize calls to the user specified callbacks.  NULL if the CAB is
+     being extracted by a single thread.
+     */
+    HANDLE CallbackMutex;
+
+    /**
+     The number of threads extracting the CAB.  Folders are assigned to
+     threads by dividing the folder index by this value.
+     */
+    DWORD FolderStride;
+
+    /**
+     The remainder of the folder index divided by FolderStride that this
+     context is responsible for extracting.
+     */
+    DWORD FolderIndex;
+
 } YORI_LIB_CAB_EXPAND_CONTEXT, *PYORI_LIB_CAB_EXPAND_CONTEXT;
 
+/**
+ A file opened by FDI.  FDI writes to extracted files in small chunks, so
+ these are accumulated in a buffer and written in larger requests.  The
+ CAB file itself is opened without a buffer.
+ */
+typedef struct _YORI_LIB_CAB_FDI_FILE {
+
+    /**
+     The handle to the file.
+     */
+    HANDLE hFile;
+
+    /**
+     Points to a buffer of YORI_LIB_CAB_WRITE_BUFFER_SIZE bytes containing
+     data that has not yet been written to the file.  NULL if writes to
+     this file are not buffered.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The number of bytes in Buffer that have not yet been written.
+     */
+    DWORD BytesBuffered;
+
+} YORI_LIB_CAB_FDI_FILE, *PYORI_LIB_CAB_FDI_FILE;
+
 /**
  Context passed when adding files during compression operations.  Used here
  to indicate which encoding to use to interpret file names.
@@ -465,6 +529,79 @@ YoriLibCabFciFileOpen(
     return YoriLibCabFileOpen(FileName, Encoding, OFlag, PMode);
 }
 
+/**
+ Allocate a structure to describe a file opened on behalf of FDI.
+
+ @param hFile The handle to the file.  On failure, this handle is closed.
+
+ @param Buffered If TRUE, writes to the file are accumulated in a buffer.
+        If FALSE, the file is accessed directly.
+
+ @return A pointer to the allocated structure, cast to a DWORD_PTR in the
+         form FDI expects, or -1 on failure.
+ */
+DWORD_PTR
+YoriLibCabFdiAllocateFile(
+    __in HANDLE hFile,
+    __in BOOLEAN Buffered
+    )
+{
+    PYORI_LIB_CAB_FDI_FILE File;
+    DWORD BytesToAllocate;
+
+    BytesToAllocate = sizeof(YORI_LIB_CAB_FDI_FILE);
+    if (Buffered) {
+        BytesToAllocate = BytesToAllocate + YORI_LIB_CAB_WRITE_BUFFER_SIZE;
+    }
+
+    File = YoriLibMalloc(BytesToAllocate);
+    if (File == NULL) {
+        CloseHandle(hFile);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return (DWORD_PTR)-1;
+    }
+
+    File->hFile = hFile;
+    File->Buffer = NULL;
+    File->BytesBuffered = 0;
+    if (Buffered) {
+        File->Buffer = (PUCHAR)(File + 1);
+    }
+
+    return (DWORD_PTR)File;
+}
+
+/**
+ Write any data that has been accumulated in the buffer for a file opened
+ on behalf of FDI.
+
+ @param File Pointer to the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCabFdiFlushFile(
+    __in PYORI_LIB_CAB_FDI_FILE File
+    )
+{
+    DWORD BytesWritten;
+    DWORD BytesToWrite;
+
+    BytesToWrite = File->BytesBuffered;
+    File->BytesBuffered = 0;
+    if (BytesToWrite == 0) {
+        return TRUE;
+    }
+
+    if (!WriteFile(File->hFile, File->Buffer, BytesToWrite, &BytesWritten, NULL) ||
+        BytesWritten != BytesToWrite) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  A callback invoked during FDICopy to open a file.  Note that this is used
  on the same file multiple times and thus requires sharing with previous
@@ -487,6 +624,7 @@ YoriLibCabFdiFileOpen(
     )
 {
     DWORD Encoding;
+    HANDLE hFile;
 
     //
     //  From observation, this callback is only invoked to open the cab
@@ -499,9 +637,13 @@ YoriLibCabFdiFileOpen(
         Encoding = CP_UTF8;
     }
 
-    return YoriLibCabFileOpen(FileName, Encoding, OFlag, PMode);
-}
+    hFile = (HANDLE)YoriLibCabFileOpen(FileName, Encoding, OFlag, PMode);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return (DWORD_PTR)-1;
+    }
 
+    return YoriLibCabFdiAllocateFile(hFile, FALSE);
+}
 
 /**
  Combine a parent directory with the CAB's relative file name and output the
@@ -815,7 +957,13 @@ YoriLibCabFdiFileRead(
     __in DWORD ByteCount
     )
 {
-    return YoriLibCabFciFileRead(FileHandle, Buffer, ByteCount, NULL, NULL);
+    PYORI_LIB_CAB_FDI_FILE File = (PYORI_LIB_CAB_FDI_FILE)FileHandle;
+
+    if (!YoriLibCabFdiFlushFile(File)) {
+        return (DWORD)-1;
+    }
+
+    return YoriLibCabFciFileRead((DWORD_PTR)File->hFile, Buffer, ByteCount, NULL, NULL);
 }
 
 /**
@@ -877,7 +1025,25 @@ YoriLibCabFdiFileWrite(
     __in DWORD ByteCount
     )
 {
-    return YoriLibCabFciFileWrite(FileHandle, Buffer, ByteCount, NULL, NULL);
+    PYORI_LIB_CAB_FDI_FILE File = (PYORI_LIB_CAB_FDI_FILE)FileHandle;
+
+    if (File->Buffer == NULL) {
+        return YoriLibCabFciFileWrite((DWORD_PTR)File->hFile, Buffer, ByteCount, NULL, NULL);
+    }
+
+    if (ByteCount > YORI_LIB_CAB_WRITE_BUFFER_SIZE - File->BytesBuffered) {
+        if (!YoriLibCabFdiFlushFile(File)) {
+            return (DWORD)-1;
+        }
+    }
+
+    if (ByteCount >= YORI_LIB_CAB_WRITE_BUFFER_SIZE) {
+        return YoriLibCabFciFileWrite((DWORD_PTR)File->hFile, Buffer, ByteCount, NULL, NULL);
+    }
+
+    memcpy(&File->Buffer[File->BytesBuffered], Buffer, ByteCount);
+    File->BytesBuffered = File->BytesBuffered + ByteCount;
+    return ByteCount;
 }
 
 /**
@@ -918,7 +1084,17 @@ YoriLibCabFdiFileClose(
     __in DWORD_PTR FileHandle
     )
 {
-    return YoriLibCabFciFileClose(FileHandle, NULL, NULL);
+    PYORI_LIB_CAB_FDI_FILE File = (PYORI_LIB_CAB_FDI_FILE)FileHandle;
+    INT Result;
+
+    Result = 0;
+    if (!YoriLibCabFdiFlushFile(File)) {
+        Result = -1;
+    }
+
+    YoriLibCabFciFileClose((DWORD_PTR)File->hFile, NULL, NULL);
+    YoriLibFree(File);
+    return Result;
 }
 
 /**
@@ -977,7 +1153,13 @@ YoriLibCabFdiFileSeek(
     __in INT SeekType
     )
 {
-    return YoriLibCabFciFileSeek(FileHandle, DistanceToMove, SeekType, NULL, NULL);
+    PYORI_LIB_CAB_FDI_FILE File = (PYORI_LIB_CAB_FDI_FILE)FileHandle;
+
+    if (!YoriLibCabFdiFlushFile(File)) {
+        return (DWORD)-1;
+    }
+
+    return YoriLibCabFciFileSeek((DWORD_PTR)File->hFile, DistanceToMove, SeekType, NULL, NULL);
 }
 
 /**
@@ -1214,6 +1396,44 @@ YoriLibCabFciGetOpenInfo(
     return Handle;
 }
 
+/**
+ Invoke a user specified callback for a file being extracted.  If the CAB
+ is being extracted by multiple threads, callbacks are serialized so the
+ user context does not need to be synchronized.
+
+ @param ExpandContext Pointer to the context describing the extract
+        operation.
+
+ @param Callback Pointer to the callback to invoke.
+
+ @param FullPath Pointer to the full path to the file on disk.
+
+ @param FileName Pointer to the name of the file within the CAB.
+
+ @return The result of the callback.
+ */
+BOOL
+YoriLibCabInvokeExpandCallback(
+    __in PYORI_LIB_CAB_EXPAND_CONTEXT ExpandContext,
+    __in PYORI_LIB_CAB_EXPAND_FILE_CALLBACK Callback,
+    __in PYORI_STRING FullPath,
+    __in PYORI_STRING FileName
+    )
+{
+    BOOL Result;
+
+    if (ExpandContext->CallbackMutex != NULL) {
+        WaitForSingleObject(ExpandContext->CallbackMutex, INFINITE);
+    }
+
+    Result = Callback(FullPath, FileName, ExpandContext->UserContext);
+
+    if (ExpandContext->CallbackMutex != NULL) {
+        ReleaseMutex(ExpandContext->CallbackMutex);
+    }
+
+    return Result;
+}
 
 /**
  A callback invoked during FDICopy to indicate events and state encountered
@@ -1241,15 +1461,28 @@ YoriLibCabNotify(
     LARGE_INTEGER liTemp;
     TIME_ZONE_INFORMATION Tzi;
     PYORI_LIB_CAB_EXPAND_CONTEXT ExpandContext;
+    PYORI_LIB_CAB_FDI_FILE File;
     YORI_STRING FullPath;
     YORI_STRING FileName;
     DWORD_PTR Handle;
     DWORD Encoding;
+    BOOL FlushSucceeded;
 
     switch(NotifyType) {
         case YoriLibCabNotifyCopyFile:
             ExpandContext = (PYORI_LIB_CAB_EXPAND_CONTEXT)Notification->Context;
 
+            //
+            //  If multiple threads are extracting the CAB, skip files in
+            //  folders that belong to a different thread.
+            //
+
+            if (ExpandContext->FolderStride > 1 &&
+                (DWORD)(Notification->CabinetFolderCount % ExpandContext->FolderStride) != ExpandContext->FolderIndex) {
+
+                return 0;
+            }
+
             Encoding = CP_ACP;
             if (Notification->HalfAttributes & YORI_CAB_NAME_IS_UTF) {
                 Encoding = CP_UTF8;
@@ -1264,9 +1497,17 @@ YoriLibCabNotify(
             }
             if (YoriLibCabShouldIncludeFile(&FileName, ExpandContext)) {
                 if (ExpandContext->CommenceExtractCallback == NULL ||
-                    ExpandContext->CommenceExtractCallback(&FullPath, &FileName, ExpandContext->UserContext)) {
+                    YoriLibCabInvokeExpandCallback(ExpandContext, ExpandContext->CommenceExtractCallback, &FullPath, &FileName)) {
 
                     Handle = YoriLibCabFileOpenForExtract(&FullPath, &ExpandContext->ErrorCode, ExpandContext->ErrorString);
+                    if (Handle != (DWORD_PTR)INVALID_HANDLE_VALUE) {
+                        Handle = YoriLibCabFdiAllocateFile((HANDLE)Handle, TRUE);
+                        if (Handle == (DWORD_PTR)-1 &&
+                            ExpandContext->ErrorCode == ERROR_SUCCESS) {
+
+                            ExpandContext->ErrorCode = ERROR_NOT_ENOUGH_MEMORY;
+                        }
+                    }
                 } else {
                     Handle = 0;
                 }
@@ -1277,6 +1518,19 @@ YoriLibCabNotify(
             YoriLibFreeStringContents(&FileName);
             return Handle;
         case YoriLibCabNotifyCloseFile:
+
+            //
+            //  Write any buffered data before setting the timestamp, so the
+            //  write doesn't update it.
+            //
+
+            ExpandContext = (PYORI_LIB_CAB_EXPAND_CONTEXT)Notification->Context;
+            File = (PYORI_LIB_CAB_FDI_FILE)Notification->FileHandle;
+            FlushSucceeded = YoriLibCabFdiFlushFile(File);
+            if (!FlushSucceeded && ExpandContext->ErrorCode == ERROR_SUCCESS) {
+                ExpandContext->ErrorCode = GetLastError();
+            }
+
             if (GetTimeZoneInformation(&Tzi) == TIME_ZONE_ID_INVALID) {
                 Tzi.Bias = 0;
             }
@@ -1301,20 +1555,22 @@ YoriLibCabNotify(
             //  Set the time on the file
             //
 
-            SetFileTime((HANDLE)Notification->FileHandle, &TimeToSet, &TimeToSet, &TimeToSet);
+            SetFileTime(File->hFile, &TimeToSet, &TimeToSet, &TimeToSet);
             YoriLibCabFdiFileClose(Notification->FileHandle);
+            if (!FlushSucceeded) {
+                return 0;
+            }
 
             Encoding = CP_ACP;
             if (Notification->HalfAttributes & YORI_CAB_NAME_IS_UTF) {
                 Encoding = CP_UTF8;
             }
 
-            ExpandContext = (PYORI_LIB_CAB_EXPAND_CONTEXT)Notification->Context;
             if (YoriLibCabBuildFileNames(ExpandContext->TargetDirectory, Notification->String1, Encoding, &FullPath, &FileName)) {
                 SetFileAttributes(FullPath.StartOfString, Notification->HalfAttributes);
 
                 if (ExpandContext->CompleteExtractCallback != NULL) {
-                    ExpandContext->CompleteExtractCallback(&FullPath, &FileName, ExpandContext->UserContext);
+                    YoriLibCabInvokeExpandCallback(ExpandContext, ExpandContext->CompleteExtractCallback, &FullPath, &FileName);
                 }
                 YoriLibFreeStringContents(&FullPath);
                 YoriLibFreeStringContents(&FileName);
@@ -1328,6 +1584,166 @@ YoriLibCabNotify(
     return 0;
 }
 
+/**
+ Return the number of folders in a CAB file.  Each folder is a separate
+ compression stream that can be extracted independently of the others.
+
+ @param CabFileName Pointer to the full path to the CAB file.
+
+ @return The number of folders in the CAB, or zero if it could not be
+         determined.
+ */
+DWORD
+YoriLibCabGetFolderCount(
+    __in PYORI_STRING CabFileName
+    )
+{
+    HANDLE hFile;
+    UCHAR Header[28];
+    DWORD BytesRead;
+    DWORD FolderCount;
+
+    hFile = CreateFile(CabFileName->StartOfString,
+                       GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL,
+                       NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    FolderCount = 0;
+    if (ReadFile(hFile, Header, sizeof(Header), &BytesRead, NULL) &&
+        BytesRead == sizeof(Header) &&
+        memcmp(Header, "MSCF", 4) == 0) {
+
+        FolderCount = Header[26] | (Header[27] << 8);
+    }
+
+    CloseHandle(hFile);
+    return FolderCount;
+}
+
+/**
+ State for a thread extracting a set of folders from a CAB file.
+ */
+typedef struct _YORI_LIB_CAB_EXTRACT_WORKER {
+
+    /**
+     Context describing the files to extract and where to extract them.
+     */
+    YORI_LIB_CAB_EXPAND_CONTEXT ExpandContext;
+
+    /**
+     The file name of the CAB, without its parent directory, in the encoding
+     used by FDI.
+     */
+    LPSTR AnsiCabFileName;
+
+    /**
+     The parent directory of the CAB, including a trailing separator, in
+     the encoding used by FDI.
+     */
+    LPSTR AnsiCabParentDirectory;
+
+    /**
+     A string to populate with error information if the caller's string is
+     in use by a different worker.
+     */
+    YORI_STRING ErrorString;
+
+    /**
+     Set to TRUE if the folders were extracted successfully.
+     */
+    BOOL Result;
+
+} YORI_LIB_CAB_EXTRACT_WORKER, *PYORI_LIB_CAB_EXTRACT_WORKER;
+
+/**
+ Extract the folders from a CAB file that are assigned to a worker.
+
+ @param Worker Pointer to the worker describing the folders to extract.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCabExtractFolders(
+    __in PYORI_LIB_CAB_EXTRACT_WORKER Worker
+    )
+{
+    PYORI_LIB_CAB_EXPAND_CONTEXT ExpandContext;
+    CAB_CB_ERROR CabErrors;
+    LPVOID hFdi;
+    BOOL Result;
+
+    ExpandContext = &Worker->ExpandContext;
+
+    hFdi = DllCabinet.pFdiCreate(YoriLibCabAlloc,
+                                 YoriLibCabFree,
+                                 YoriLibCabFdiFileOpen,
+                                 YoriLibCabFdiFileRead,
+                                 YoriLibCabFdiFileWrite,
+                                 YoriLibCabFdiFileClose,
+                                 YoriLibCabFdiFileSeek,
+                                 -1,
+                                 &CabErrors);
+
+    if (hFdi == NULL) {
+        if (ExpandContext->ErrorCode == ERROR_SUCCESS) {
+            ExpandContext->ErrorCode = GetLastError();
+        }
+        if (ExpandContext->ErrorString != NULL && ExpandContext->ErrorString->LengthInChars == 0) {
+            YoriLibYPrintf(ExpandContext->ErrorString, _T("Error %i in pFdiCreate"), GetLastError());
+        }
+        return FALSE;
+    }
+
+    Result = TRUE;
+    if (!DllCabinet.pFdiCopy(hFdi,
+                             Worker->AnsiCabFileName,
+                             Worker->AnsiCabParentDirectory,
+                             0,
+                             YoriLibCabNotify,
+                             NULL,
+                             ExpandContext)) {
+        if (ExpandContext->ErrorCode == ERROR_SUCCESS) {
+            ExpandContext->ErrorCode = GetLastError();
+        }
+        if (ExpandContext->ErrorString != NULL && ExpandContext->ErrorString->LengthInChars == 0) {
+            YoriLibYPrintf(ExpandContext->ErrorString, _T("Error %i in pFdiCopy"), GetLastError());
+        }
+        Result = FALSE;
+    }
+
+    if (DllCabinet.pFdiDestroy != NULL) {
+        DllCabinet.pFdiDestroy(hFdi);
+    }
+
+    return Result;
+}
+
+/**
+ A thread entrypoint to extract the folders from a CAB file that are
+ assigned to a worker.
+
+ @param Context Pointer to the worker.
+
+ @return Zero.  The result is recorded in the worker.
+ */
+DWORD WINAPI
+YoriLibCabExtractWorkerThread(
+    __in LPVOID Context
+    )
+{
+    PYORI_LIB_CAB_EXTRACT_WORKER Worker = (PYORI_LIB_CAB_EXTRACT_WORKER)Context;
+
+    Worker->Result = YoriLibCabExtractFolders(Worker);
+    return 0;
+}
+
 /**
  Extract a cabinet file into a specified directory.
 
@@ -1392,12 +1808,16 @@ YoriLibExtractCab(
     YORI_STRING CabFileNameOnly;
     YORI_STRING FullTargetDirectory;
     LPTSTR FinalBackslash;
-    LPVOID hFdi;
-    CAB_CB_ERROR CabErrors;
     LPSTR AnsiCabFileName;
     LPSTR AnsiCabParentDirectory;
     BOOL Result = FALSE;
     YORI_LIB_CAB_EXPAND_CONTEXT ExpandContext;
+    YORI_LIB_CAB_EXTRACT_WORKER Workers[YORI_LIB_CAB_MAX_EXTRACT_THREADS];
+    HANDLE Threads[YORI_LIB_CAB_MAX_EXTRACT_THREADS];
+    SYSTEM_INFO SysInfo;
+    DWORD ThreadCount;
+    DWORD ThreadId;
+    DWORD Index;
     DWORD Encoding;
     DWORD Error;
 
@@ -1418,7 +1838,6 @@ YoriLibExtractCab(
     YoriLibInitEmptyString(&FullTargetDirectory);
     AnsiCabParentDirectory = NULL;
     AnsiCabFileName = NULL;
-    hFdi = NULL;
     ZeroMemory(&ExpandContext, sizeof(ExpandContext));
     ExpandContext.DefaultInclude = IncludeAllByDefault;
     ExpandContext.NumberFilesToInclude = NumberFilesToInclude;
@@ -1430,6 +1849,9 @@ YoriLibExtractCab(
     ExpandContext.UserContext = UserContext;
     ExpandContext.ErrorCode = ERROR_SUCCESS;
     ExpandContext.ErrorString = ErrorString;
+    ExpandContext.CallbackMutex = NULL;
+    ExpandContext.FolderStride = 1;
+    ExpandContext.FolderIndex = 0;
 
     if (!YoriLibUserStringToSingleFilePath(CabFileName, FALSE, &FullCabFileName)) {
         if (ErrorCode != NULL) {
@@ -1499,51 +1921,94 @@ YoriLibExtractCab(
         goto Exit;
     }
 
-    hFdi = DllCabinet.pFdiCreate(YoriLibCabAlloc,
-                                 YoriLibCabFree,
-                                 YoriLibCabFdiFileOpen,
-                                 YoriLibCabFdiFileRead,
-                                 YoriLibCabFdiFileWrite,
-                                 YoriLibCabFdiFileClose,
-                                 YoriLibCabFdiFileSeek,
-                                 -1,
-                                 &CabErrors);
+    ExpandContext.TargetDirectory = &FullTargetDirectory;
 
-    if (hFdi == NULL) {
-        if (ErrorCode != NULL && *ErrorCode == ERROR_SUCCESS) {
-            *ErrorCode = GetLastError();
+    //
+    //  Each folder in a CAB is compressed independently, so if the CAB has
+    //  more than one, assign folders to threads and have each thread run
+    //  its own FDI instance over the CAB, skipping files in folders that
+    //  belong to other threads.
+    //
+
+    GetSystemInfo(&SysInfo);
+    ThreadCount = YoriLibCabGetFolderCount(&FullCabFileName);
+    if (ThreadCount > SysInfo.dwNumberOfProcessors) {
+        ThreadCount = SysInfo.dwNumberOfProcessors;
+    }
+    if (ThreadCount > YORI_LIB_CAB_MAX_EXTRACT_THREADS) {
+        ThreadCount = YORI_LIB_CAB_MAX_EXTRACT_THREADS;
+    }
+    if (ThreadCount < 1) {
+        ThreadCount = 1;
+    }
+
+    if (ThreadCount > 1) {
+        ExpandContext.CallbackMutex = CreateMutex(NULL, FALSE, NULL);
+        if (ExpandContext.CallbackMutex == NULL) {
+            ThreadCount = 1;
         }
-        if (ErrorString != NULL && ErrorString->LengthInChars == 0) {
-            YoriLibYPrintf(ErrorString, _T("Error %i in pFdiCreate"), GetLastError());
+    }
+
+    for (Index = 0; Index < ThreadCount; Index++) {
+        memcpy(&Workers[Index].ExpandContext, &ExpandContext, sizeof(ExpandContext));
+        Workers[Index].ExpandContext.FolderStride = ThreadCount;
+        Workers[Index].ExpandContext.FolderIndex = Index;
+        Workers[Index].AnsiCabFileName = AnsiCabFileName;
+        Workers[Index].AnsiCabParentDirectory = AnsiCabParentDirectory;
+        Workers[Index].Result = FALSE;
+        YoriLibInitEmptyString(&Workers[Index].ErrorString);
+        if (Index > 0 && ErrorString != NULL) {
+            Workers[Index].ExpandContext.ErrorString = &Workers[Index].ErrorString;
         }
-        goto Exit;
+        Threads[Index] = NULL;
     }
 
-    ExpandContext.TargetDirectory = &FullTargetDirectory;
+    YoriLibTraceBegin(YORI_LIB_TRACE_CABINET, _T("ExtractCab"), &FullCabFileName, 0);
 
-    if (!DllCabinet.pFdiCopy(hFdi,
-                             AnsiCabFileName,
-                             AnsiCabParentDirectory,
-                             0,
-                             YoriLibCabNotify,
-                             NULL,
-                             &ExpandContext)) {
-        if (ErrorCode != NULL && *ErrorCode == ERROR_SUCCESS) {
-            *ErrorCode = GetLastError();
-        }
-        if (ErrorString != NULL && ErrorString->LengthInChars == 0) {
-            YoriLibYPrintf(ErrorString, _T("Error %i in pFdiCopy"), GetLastError());
+    for (Index = 1; Index < ThreadCount; Index++) {
+        Threads[Index] = CreateThread(NULL, 0, YoriLibCabExtractWorkerThread, &Workers[Index], 0, &ThreadId);
+    }
+
+    Workers[0].Result = YoriLibCabExtractFolders(&Workers[0]);
+
+    //
+    //  Wait for the other workers.  If a thread couldn't be created, its
+    //  folders are extracted here.
+    //
+
+    for (Index = 1; Index < ThreadCount; Index++) {
+        if (Threads[Index] != NULL) {
+            WaitForSingleObject(Threads[Index], INFINITE);
+            CloseHandle(Threads[Index]);
+        } else {
+            Workers[Index].Result = YoriLibCabExtractFolders(&Workers[Index]);
         }
-        goto Exit;
     }
 
+    YoriLibTraceEnd(YORI_LIB_TRACE_CABINET, _T("ExtractCab"), &FullCabFileName, 0);
+
     Result = TRUE;
-Exit:
+    for (Index = 0; Index < ThreadCount; Index++) {
+        if (!Workers[Index].Result) {
+            if (Result) {
+                if (ErrorCode != NULL && *ErrorCode == ERROR_SUCCESS) {
+                    *ErrorCode = Workers[Index].ExpandContext.ErrorCode;
+                }
+                if (ErrorString != NULL && ErrorString->LengthInChars == 0) {
+                    YoriLibYPrintf(ErrorString, _T("%y"), &Workers[Index].ErrorString);
+                }
+            }
+            Result = FALSE;
+        }
+        YoriLibFreeStringContents(&Workers[Index].ErrorString);
+    }
 
-    if (DllCabinet.pFdiDestroy != NULL && hFdi != NULL) {
-        DllCabinet.pFdiDestroy(hFdi);
+    if (ExpandContext.CallbackMutex != NULL) {
+        CloseHandle(ExpandContext.CallbackMutex);
     }
 
+Exit:
+
     YoriLibFreeStringContents(&FullCabFileName);
     YoriLibFreeStringContents(&FullTargetDirectory);
     if (AnsiCabParentDirectory != NULL) {
@@ -1630,11 +2095,12 @@ YoriLibCreateCab(
     //
     //  We don't want to split data across multiple CABs.  This feature
     //  was for floppy disks.  Today, set the maximum size to as large
-    //  as is possible.
+    //  as is possible.  Data is split across multiple folders within the
+    //  CAB so that larger CABs can be extracted by multiple threads.
     //
 
     CabHandle->CompressContext.SizeAvailable = 0x7FFFF000;
-    CabHandle->CompressContext.ThresholdForNextFolder = 0x7FFFF000;
+    CabHandle->CompressContext.ThresholdForNextFolder = YORI_LIB_CAB_FOLDER_THRESHOLD;
 
     CabHandle->AddContext.OnDiskNameIsUtf = FALSE;
     Encoding = CP_ACP;
@@ -1756,6 +2222,7 @@ YoriLibAddFileToCab(
         return FALSE;
     }
 
+    YoriLibTraceBegin(YORI_LIB_TRACE_CABINET, _T("AddFileToCab"), FileNameOnDisk, 0);
     Result = DllCabinet.pFciAddFile(CabHandle->FciHandle,
                                     FileNameOnDiskAnsi,
                                     FileNameInCabAnsi,
@@ -1764,6 +2231,7 @@ YoriLibAddFileToCab(
                                     YoriLibCabFciStatus,
                                     YoriLibCabFciGetOpenInfo,
                                     CAB_FCI_ALGORITHM_MSZIP);
+    YoriLibTraceEnd(YORI_LIB_TRACE_CABINET, _T("AddFileToCab"), FileNameOnDisk, 0);
 
     YoriLibFree(FileNameOnDiskAnsi);
     YoriLibFree(FileNameInCabAnsi);
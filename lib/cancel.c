@@ -282,6 +282,12 @@ YoriLibCtrlCHandler(
         return FALSE;
     }
 
+#if YORI_HEAP_PROFILE
+    if (CtrlType == CTRL_BREAK_EVENT) {
+        YoriLibDisplayHeapProfile();
+    }
+#endif
+
     if (CtrlType == CTRL_C_EVENT ||
         CtrlType == CTRL_BREAK_EVENT) {
 
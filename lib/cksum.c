@@ -0,0 +1,492 @@
+/**
+ * @file lib/cksum.c
+ *
+ * Yori non-cryptographic checksums for change detection
+ *
+ * Copyright (c) 2024-2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The reflected CRC32C (Castagnoli) polynomial.
+ */
+#define YORI_LIB_CRC32C_POLYNOMIAL (0x82F63B78)
+
+/**
+ Tables used to update a CRC32C eight bytes at a time.  Table zero is the
+ conventional byte at a time table; table N is the contribution of a byte
+ that is followed by N further bytes.
+ */
+DWORD YoriLibCrc32cTable[8][256];
+
+/**
+ TRUE once YoriLibCrc32cTable has been populated.
+ */
+BOOLEAN YoriLibCrc32cTableInitialized;
+
+/**
+ Populate the CRC32C tables.  If two threads race to do this, both write
+ identical values, so no synchronization is needed.
+ */
+VOID
+YoriLibCrc32cInitializeTable(VOID)
+{
+    DWORD Index;
+    DWORD Bit;
+    DWORD Slice;
+    DWORD Crc;
+
+    for (Index = 0; Index < 256; Index++) {
+        Crc = Index;
+        for (Bit = 0; Bit < 8; Bit++) {
+            if (Crc & 1) {
+                Crc = (Crc >> 1) ^ YORI_LIB_CRC32C_POLYNOMIAL;
+            } else {
+                Crc = Crc >> 1;
+            }
+        }
+        YoriLibCrc32cTable[0][Index] = Crc;
+    }
+
+    for (Index = 0; Index < 256; Index++) {
+        Crc = YoriLibCrc32cTable[0][Index];
+        for (Slice = 1; Slice < 8; Slice++) {
+            Crc = (Crc >> 8) ^ YoriLibCrc32cTable[0][Crc & 0xFF];
+            YoriLibCrc32cTable[Slice][Index] = Crc;
+        }
+    }
+
+    YoriLibCrc32cTableInitialized = TRUE;
+}
+
+/**
+ Update a CRC32C with more data.  The CRC of a buffer can be calculated in
+ pieces by passing the result of each call to the next.
+
+ @param Crc The CRC of all previous data, or zero to start a new CRC.
+
+ @param Buffer Pointer to the data to add to the CRC.
+
+ @param Length The number of bytes in Buffer.
+
+ @return The CRC of all previous data followed by Buffer.
+ */
+DWORD
+YoriLibCrc32c(
+    __in DWORD Crc,
+    __in PVOID Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    PUCHAR Ptr;
+    YORI_ALLOC_SIZE_T Remaining;
+    DWORD Low;
+    DWORD High;
+
+    if (!YoriLibCrc32cTableInitialized) {
+        YoriLibCrc32cInitializeTable();
+    }
+
+    Ptr = Buffer;
+    Remaining = Length;
+    Crc = ~Crc;
+
+    //
+    //  Process eight bytes per step.  The bytes are assembled explicitly
+    //  so this works on any alignment and byte order.
+    //
+
+    while (Remaining >= 8) {
+        Low = Crc ^ (Ptr[0] | (Ptr[1] << 8) | (Ptr[2] << 16) | ((DWORD)Ptr[3] << 24));
+        High = Ptr[4] | (Ptr[5] << 8) | (Ptr[6] << 16) | ((DWORD)Ptr[7] << 24);
+        Crc = YoriLibCrc32cTable[7][Low & 0xFF] ^
+              YoriLibCrc32cTable[6][(Low >> 8) & 0xFF] ^
+              YoriLibCrc32cTable[5][(Low >> 16) & 0xFF] ^
+              YoriLibCrc32cTable[4][Low >> 24] ^
+              YoriLibCrc32cTable[3][High & 0xFF] ^
+              YoriLibCrc32cTable[2][(High >> 8) & 0xFF] ^
+              YoriLibCrc32cTable[1][(High >> 16) & 0xFF] ^
+              YoriLibCrc32cTable[0][High >> 24];
+        Ptr += 8;
+        Remaining -= 8;
+    }
+
+    while (Remaining > 0) {
+        Crc = (Crc >> 8) ^ YoriLibCrc32cTable[0][(Crc ^ *Ptr) & 0xFF];
+        Ptr++;
+        Remaining--;
+    }
+
+    return ~Crc;
+}
+
+/**
+ The first XXH64 prime.
+ */
+#define YORI_LIB_XXH64_PRIME1 ((((DWORDLONG)0x9E3779B1) << 32) | 0x85EBCA87)
+
+/**
+ The second XXH64 prime.
+ */
+#define YORI_LIB_XXH64_PRIME2 ((((DWORDLONG)0xC2B2AE3D) << 32) | 0x27D4EB4F)
+
+/**
+ The third XXH64 prime.
+ */
+#define YORI_LIB_XXH64_PRIME3 ((((DWORDLONG)0x165667B1) << 32) | 0x9E3779F9)
+
+/**
+ The fourth XXH64 prime.
+ */
+#define YORI_LIB_XXH64_PRIME4 ((((DWORDLONG)0x85EBCA77) << 32) | 0xC2B2AE63)
+
+/**
+ The fifth XXH64 prime.
+ */
+#define YORI_LIB_XXH64_PRIME5 ((((DWORDLONG)0x27D4EB2F) << 32) | 0x165667C5)
+
+/**
+ The number of bytes processed by each step of XXH64.
+ */
+#define YORI_LIB_XXH64_STRIPE_LENGTH (32)
+
+/**
+ Rotate a 64 bit value left.
+ */
+#define YORI_LIB_XXH64_ROTL(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+/**
+ Read a little endian 64 bit value from a possibly unaligned buffer.
+
+ @param Ptr Pointer to the bytes to read.
+
+ @return The value.
+ */
+DWORDLONG
+YoriLibXxHash64Read64(
+    __in PUCHAR Ptr
+    )
+{
+    DWORD Low;
+    DWORD High;
+
+    Low = Ptr[0] | (Ptr[1] << 8) | (Ptr[2] << 16) | ((DWORD)Ptr[3] << 24);
+    High = Ptr[4] | (Ptr[5] << 8) | (Ptr[6] << 16) | ((DWORD)Ptr[7] << 24);
+    return (((DWORDLONG)High) << 32) | Low;
+}
+
+/**
+ Mix eight bytes of input into one XXH64 accumulator.
+
+ @param Accumulator The current accumulator value.
+
+ @param Input The input to mix.
+
+ @return The new accumulator value.
+ */
+DWORDLONG
+YoriLibXxHash64Round(
+    __in DWORDLONG Accumulator,
+    __in DWORDLONG Input
+    )
+{
+    Accumulator = Accumulator + Input * YORI_LIB_XXH64_PRIME2;
+    Accumulator = YORI_LIB_XXH64_ROTL(Accumulator, 31);
+    return Accumulator * YORI_LIB_XXH64_PRIME1;
+}
+
+/**
+ Merge an accumulator into the final XXH64 hash.
+
+ @param Hash The hash so far.
+
+ @param Accumulator The accumulator to merge.
+
+ @return The new hash value.
+ */
+DWORDLONG
+YoriLibXxHash64MergeRound(
+    __in DWORDLONG Hash,
+    __in DWORDLONG Accumulator
+    )
+{
+    Hash = Hash ^ YoriLibXxHash64Round(0, Accumulator);
+    return Hash * YORI_LIB_XXH64_PRIME1 + YORI_LIB_XXH64_PRIME4;
+}
+
+/**
+ Prepare to calculate an XXH64 hash.
+
+ @param State Pointer to the state to initialize.
+
+ @param Seed The seed for the hash.  Use zero for the standard XXH64 result.
+ */
+VOID
+YoriLibXxHash64Initialize(
+    __out PYORI_LIB_XXHASH64_STATE State,
+    __in DWORDLONG Seed
+    )
+{
+    State->Accumulator[0] = Seed + YORI_LIB_XXH64_PRIME1 + YORI_LIB_XXH64_PRIME2;
+    State->Accumulator[1] = Seed + YORI_LIB_XXH64_PRIME2;
+    State->Accumulator[2] = Seed;
+    State->Accumulator[3] = Seed - YORI_LIB_XXH64_PRIME1;
+    State->Seed = Seed;
+    State->TotalLength = 0;
+    State->BytesBuffered = 0;
+}
+
+/**
+ Add data to an XXH64 hash.
+
+ @param State Pointer to the hash state.
+
+ @param Buffer Pointer to the data to add.
+
+ @param Length The number of bytes in Buffer.
+ */
+VOID
+YoriLibXxHash64Update(
+    __inout PYORI_LIB_XXHASH64_STATE State,
+    __in PVOID Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    PUCHAR Ptr;
+    YORI_ALLOC_SIZE_T Remaining;
+    YORI_ALLOC_SIZE_T Copy;
+    DWORD Index;
+
+    Ptr = Buffer;
+    Remaining = Length;
+    State->TotalLength = State->TotalLength + Length;
+
+    //
+    //  If a partial stripe was left over from earlier calls, complete it
+    //  first.
+    //
+
+    if (State->BytesBuffered > 0) {
+        Copy = YORI_LIB_XXH64_STRIPE_LENGTH - State->BytesBuffered;
+        if (Copy > Remaining) {
+            Copy = Remaining;
+        }
+        memcpy(&State->Buffer[State->BytesBuffered], Ptr, Copy);
+        State->BytesBuffered = State->BytesBuffered + Copy;
+        Ptr += Copy;
+        Remaining -= Copy;
+
+        if (State->BytesBuffered < YORI_LIB_XXH64_STRIPE_LENGTH) {
+            return;
+        }
+
+        for (Index = 0; Index < 4; Index++) {
+            State->Accumulator[Index] = YoriLibXxHash64Round(State->Accumulator[Index], YoriLibXxHash64Read64(&State->Buffer[Index * 8]));
+        }
+        State->BytesBuffered = 0;
+    }
+
+    while (Remaining >= YORI_LIB_XXH64_STRIPE_LENGTH) {
+        State->Accumulator[0] = YoriLibXxHash64Round(State->Accumulator[0], YoriLibXxHash64Read64(Ptr));
+        State->Accumulator[1] = YoriLibXxHash64Round(State->Accumulator[1], YoriLibXxHash64Read64(Ptr + 8));
+        State->Accumulator[2] = YoriLibXxHash64Round(State->Accumulator[2], YoriLibXxHash64Read64(Ptr + 16));
+        State->Accumulator[3] = YoriLibXxHash64Round(State->Accumulator[3], YoriLibXxHash64Read64(Ptr + 24));
+        Ptr += YORI_LIB_XXH64_STRIPE_LENGTH;
+        Remaining -= YORI_LIB_XXH64_STRIPE_LENGTH;
+    }
+
+    if (Remaining > 0) {
+        memcpy(State->Buffer, Ptr, Remaining);
+        State->BytesBuffered = Remaining;
+    }
+}
+
+/**
+ Return the XXH64 hash of all data added to the state.  The state is not
+ modified, so more data can be added afterwards.
+
+ @param State Pointer to the hash state.
+
+ @return The hash.
+ */
+DWORDLONG
+YoriLibXxHash64Finalize(
+    __in PYORI_LIB_XXHASH64_STATE State
+    )
+{
+    DWORDLONG Hash;
+    PUCHAR Ptr;
+    YORI_ALLOC_SIZE_T Remaining;
+    DWORD Value;
+
+    if (State->TotalLength >= YORI_LIB_XXH64_STRIPE_LENGTH) {
+        Hash = YORI_LIB_XXH64_ROTL(State->Accumulator[0], 1) +
+               YORI_LIB_XXH64_ROTL(State->Accumulator[1], 7) +
+               YORI_LIB_XXH64_ROTL(State->Accumulator[2], 12) +
+               YORI_LIB_XXH64_ROTL(State->Accumulator[3], 18);
+        Hash = YoriLibXxHash64MergeRound(Hash, State->Accumulator[0]);
+        Hash = YoriLibXxHash64MergeRound(Hash, State->Accumulator[1]);
+        Hash = YoriLibXxHash64MergeRound(Hash, State->Accumulator[2]);
+        Hash = YoriLibXxHash64MergeRound(Hash, State->Accumulator[3]);
+    } else {
+        Hash = State->Seed + YORI_LIB_XXH64_PRIME5;
+    }
+
+    Hash = Hash + State->TotalLength;
+
+    Ptr = State->Buffer;
+    Remaining = State->BytesBuffered;
+    while (Remaining >= 8) {
+        Hash = Hash ^ YoriLibXxHash64Round(0, YoriLibXxHash64Read64(Ptr));
+        Hash = YORI_LIB_XXH64_ROTL(Hash, 27) * YORI_LIB_XXH64_PRIME1 + YORI_LIB_XXH64_PRIME4;
+        Ptr += 8;
+        Remaining -= 8;
+    }
+
+    if (Remaining >= 4) {
+        Value = Ptr[0] | (Ptr[1] << 8) | (Ptr[2] << 16) | ((DWORD)Ptr[3] << 24);
+        Hash = Hash ^ (Value * YORI_LIB_XXH64_PRIME1);
+        Hash = YORI_LIB_XXH64_ROTL(Hash, 23) * YORI_LIB_XXH64_PRIME2 + YORI_LIB_XXH64_PRIME3;
+        Ptr += 4;
+        Remaining -= 4;
+    }
+
+    while (Remaining > 0) {
+        Hash = Hash ^ (*Ptr * YORI_LIB_XXH64_PRIME5);
+        Hash = YORI_LIB_XXH64_ROTL(Hash, 11) * YORI_LIB_XXH64_PRIME1;
+        Ptr++;
+        Remaining--;
+    }
+
+    Hash = Hash ^ (Hash >> 33);
+    Hash = Hash * YORI_LIB_XXH64_PRIME2;
+    Hash = Hash ^ (Hash >> 29);
+    Hash = Hash * YORI_LIB_XXH64_PRIME3;
+    Hash = Hash ^ (Hash >> 32);
+
+    return Hash;
+}
+
+/**
+ Add data to a PE image checksum.  The PE checksum is the 16 bit one's
+ complement sum of every little endian word in the file, followed by adding
+ the length of the file.  The caller is responsible for adding the length,
+ and for removing the contribution of the checksum field in the header.
+
+ Data can be supplied in pieces, but every piece other than the last must
+ contain an even number of bytes so that no word is split across calls.
+ If the final piece has an odd length, the last byte is treated as a word
+ whose high byte is zero.
+
+ @param Sum The value returned from a previous call, or zero to begin a new
+        checksum.
+
+ @param Buffer Pointer to the data to add to the checksum.
+
+ @param Length The number of bytes in Buffer.
+
+ @return The 16 bit sum of the previous data followed by Buffer.
+ */
+DWORD
+YoriLibPeChecksumUpdate(
+    __in DWORD Sum,
+    __in PVOID Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    PUCHAR Ptr;
+    PDWORD Dwords;
+    YORI_ALLOC_SIZE_T Remaining;
+    DWORDLONG Accumulator0;
+    DWORDLONG Accumulator1;
+    DWORDLONG Accumulator2;
+    DWORDLONG Accumulator3;
+
+    Ptr = Buffer;
+    Remaining = Length;
+    Accumulator0 = Sum;
+    Accumulator1 = 0;
+    Accumulator2 = 0;
+    Accumulator3 = 0;
+
+    //
+    //  If the buffer is at an even address, consume a word if needed to
+    //  reach a DWORD boundary, then read the bulk of the data as DWORDs.
+    //  Since 0x10000 is one more than 0xFFFF, the high word of each DWORD
+    //  contributes the same value to a one's complement sum whether it is
+    //  shifted down or not, so whole DWORDs can be added into 64 bit
+    //  accumulators and folded at the end.  Four accumulators keep the
+    //  additions independent so they can execute in parallel.  This relies
+    //  on the processor being little endian, which Windows always is.
+    //
+
+    if (((DWORD_PTR)Ptr & 1) == 0) {
+        if (((DWORD_PTR)Ptr & 2) != 0 && Remaining >= 2) {
+            Accumulator0 += *(PWORD)Ptr;
+            Ptr += 2;
+            Remaining -= 2;
+        }
+
+        Dwords = (PDWORD)Ptr;
+        while (Remaining >= 16) {
+            Accumulator0 += Dwords[0];
+            Accumulator1 += Dwords[1];
+            Accumulator2 += Dwords[2];
+            Accumulator3 += Dwords[3];
+            Dwords += 4;
+            Remaining -= 16;
+        }
+
+        while (Remaining >= 4) {
+            Accumulator0 += *Dwords;
+            Dwords++;
+            Remaining -= 4;
+        }
+
+        Ptr = (PUCHAR)Dwords;
+    }
+
+    //
+    //  Assemble any remaining data, or all of it if the buffer is at an odd
+    //  address, from bytes.
+    //
+
+    while (Remaining >= 2) {
+        Accumulator0 += Ptr[0] | (Ptr[1] << 8);
+        Ptr += 2;
+        Remaining -= 2;
+    }
+
+    if (Remaining > 0) {
+        Accumulator0 += Ptr[0];
+    }
+
+    Accumulator0 = Accumulator0 + Accumulator1 + Accumulator2 + Accumulator3;
+    while ((Accumulator0 >> 16) != 0) {
+        Accumulator0 = (Accumulator0 & 0xFFFF) + (Accumulator0 >> 16);
+    }
+
+    return (DWORD)Accumulator0;
+}
+
+// vim:sw=4:ts=4:et:
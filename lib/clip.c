@@ -4,7 +4,7 @@
  * Convert a Yori string containing HTML into a Utf-8 formatted text stream for
  * use in the clipboard.
  *
- * Copyright (c) 2015-2021 Malcolm J. Smith
+ * Copyright (c) 2015-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -96,19 +96,24 @@ YoriLibGetUsableEncoding(VOID)
 }
 
 /**
- Attempt to open the clipboard with some retries in case it is currently in
- use.
+ Attempt to open the clipboard on behalf of a window with some retries in
+ case it is currently in use.
 
  @note https://stackoverflow.com/questions/66475791 suggests docs are wrong.
 
+ @param Window The window to associate with the open clipboard.  If the
+        clipboard is emptied, this window becomes the clipboard owner.
+
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOLEAN
-YoriLibOpenClipboard(VOID)
+YoriLibOpenClipboardForWindow(
+    __in HWND Window
+    )
 {
     DWORD Attempt;
 
-    if (DllUser32.pOpenClipboard == NULL || DllUser32.pGetDesktopWindow == NULL) {
+    if (DllUser32.pOpenClipboard == NULL) {
         return FALSE;
     }
 
@@ -117,7 +122,7 @@ YoriLibOpenClipboard(VOID)
             Sleep(1<<Attempt);
         }
 
-        if (DllUser32.pOpenClipboard(DllUser32.pGetDesktopWindow())) {
+        if (DllUser32.pOpenClipboard(Window)) {
             return TRUE;
         }
     }
@@ -125,6 +130,22 @@ YoriLibOpenClipboard(VOID)
     return FALSE;
 }
 
+/**
+ Attempt to open the clipboard with some retries in case it is currently in
+ use.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+YoriLibOpenClipboard(VOID)
+{
+    if (DllUser32.pGetDesktopWindow == NULL) {
+        return FALSE;
+    }
+
+    return YoriLibOpenClipboardForWindow(DllUser32.pGetDesktopWindow());
+}
+
 //
 //  Older versions of the analysis engine don't understand that a buffer
 //  allocated with GlobalAlloc and subsequently locked with GlobalLock has
@@ -389,9 +410,387 @@ YoriLibCopyText(
     return TRUE;
 }
 
+/**
+ Copy a Yori string into a global memory allocation in text format.
+
+ @param TextToCopy Pointer to the string to copy.
+
+ @param HandleForClipboard On successful completion, points to a handle
+        suitable for sending to the clipboard.
+
+ @return TRUE to indicate success or FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibBuildTextClipboardBuffer(
+    __in PYORI_STRING TextToCopy,
+    __out PHANDLE HandleForClipboard
+    )
+{
+    HANDLE hMem;
+    LPWSTR pMem;
+
+    hMem = GlobalAlloc(GMEM_MOVEABLE, (TextToCopy->LengthInChars + 1) * sizeof(TCHAR));
+    if (hMem == NULL) {
+        return FALSE;
+    }
+
+    pMem = DllKernel32.pGlobalLock(hMem);
+    if (pMem == NULL) {
+        GlobalFree(hMem);
+        return FALSE;
+    }
+
+    memcpy(pMem, TextToCopy->StartOfString, TextToCopy->LengthInChars * sizeof(TCHAR));
+    pMem[TextToCopy->LengthInChars] = '\0';
+    DllKernel32.pGlobalUnlock(hMem);
+
+    *HandleForClipboard = hMem;
+    return TRUE;
+}
+
+/**
+ Copy a Yori string containing RTF into a global memory allocation.  Because
+ RTF predates Unicode, any extended characters must have already been
+ encoded when generating RTF, so the high 8 bits per char are discarded here.
+
+ @param TextToCopy Pointer to the string to copy.
+
+ @param HandleForClipboard On successful completion, points to a handle
+        suitable for sending to the clipboard.
+
+ @return TRUE to indicate success or FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibBuildRtfClipboardBuffer(
+    __in PYORI_STRING TextToCopy,
+    __out PHANDLE HandleForClipboard
+    )
+{
+    HANDLE hMem;
+    LPSTR pMem;
+    YORI_ALLOC_SIZE_T Index;
+
+    hMem = GlobalAlloc(GMEM_MOVEABLE, TextToCopy->LengthInChars + 1);
+    if (hMem == NULL) {
+        return FALSE;
+    }
+
+    pMem = DllKernel32.pGlobalLock(hMem);
+    if (pMem == NULL) {
+        GlobalFree(hMem);
+        return FALSE;
+    }
+
+    for (Index = 0; Index < TextToCopy->LengthInChars; Index++) {
+        pMem[Index] = (UCHAR)(TextToCopy->StartOfString[Index] & 0x7f);
+    }
+    pMem[TextToCopy->LengthInChars] = '\0';
+    DllKernel32.pGlobalUnlock(hMem);
+
+    *HandleForClipboard = hMem;
+    return TRUE;
+}
+
+/**
+ State describing RTF and HTML formats which have been placed on the
+ clipboard but not yet rendered.  A hidden window owns the clipboard and is
+ serviced by a background thread, which renders a format when another
+ application requests it.  Most applications only request one of these
+ formats, and many request none, so rendering them on demand avoids
+ generating large buffers that are never used.
+ */
+typedef struct _YORI_LIB_CLIP_DELAYED_RENDER {
+
+    /**
+     Handle to the thread servicing the clipboard owner window.
+     */
+    HANDLE Thread;
+
+    /**
+     The clipboard owner window.  This is NULL if the window could not be
+     created or has been destroyed.
+     */
+    HWND Window;
+
+    /**
+     A mutex protecting the strings below, which are modified by the thread
+     copying to the clipboard and read by the thread rendering formats.
+     */
+    HANDLE Mutex;
+
+    /**
+     The string to render in RTF format.
+     */
+    YORI_STRING RtfVersion;
+
+    /**
+     The string to render in HTML format.
+     */
+    YORI_STRING HtmlVersion;
+
+    /**
+     The registered clipboard format for RTF.
+     */
+    UINT RtfFmt;
+
+    /**
+     The registered clipboard format for HTML.
+     */
+    UINT HtmlFmt;
+
+    /**
+     Set to TRUE if the background thread has been started, even if it
+     failed to create a window.
+     */
+    BOOLEAN Started;
+} YORI_LIB_CLIP_DELAYED_RENDER, *PYORI_LIB_CLIP_DELAYED_RENDER;
+
+/**
+ Process wide state for formats whose rendering has been delayed.
+ */
+YORI_LIB_CLIP_DELAYED_RENDER YoriLibClipDelayedRender;
+
+/**
+ The window class name of the clipboard owner window.
+ */
+#define YORI_LIB_CLIP_OWNER_CLASS _T("YoriClipboardOwner")
+
+/**
+ Render a delayed format and place it on the clipboard.  The clipboard is
+ expected to be open.
+
+ @param Format The clipboard format to render.
+ */
+VOID
+YoriLibClipRenderFormat(
+    __in UINT Format
+    )
+{
+    PYORI_LIB_CLIP_DELAYED_RENDER Delayed = &YoriLibClipDelayedRender;
+    HANDLE hMem;
+    BOOL Result;
+
+    Result = FALSE;
+    WaitForSingleObject(Delayed->Mutex, INFINITE);
+    if (Format == Delayed->RtfFmt && Delayed->RtfVersion.StartOfString != NULL) {
+        Result = YoriLibBuildRtfClipboardBuffer(&Delayed->RtfVersion, &hMem);
+    } else if (Format == Delayed->HtmlFmt && Delayed->HtmlVersion.StartOfString != NULL) {
+        Result = YoriLibBuildHtmlClipboardBuffer(&Delayed->HtmlVersion, &hMem);
+    }
+    ReleaseMutex(Delayed->Mutex);
+
+    if (Result) {
+        if (DllUser32.pSetClipboardData(Format, hMem) == NULL) {
+            GlobalFree(hMem);
+        }
+    }
+}
+
+/**
+ The window procedure for the clipboard owner window.
+
+ @param hWnd Handle to the clipboard owner window.
+
+ @param uMsg The message being delivered.
+
+ @param wParam The first message parameter.  For WM_RENDERFORMAT, this is
+        the format to render.
+
+ @param lParam The second message parameter.
+
+ @return The result of processing the message.
+ */
+LRESULT CALLBACK
+YoriLibClipOwnerWndProc(
+    __in HWND hWnd,
+    __in UINT uMsg,
+    __in WPARAM wParam,
+    __in LPARAM lParam
+    )
+{
+    PYORI_LIB_CLIP_DELAYED_RENDER Delayed = &YoriLibClipDelayedRender;
+
+    switch(uMsg) {
+        case WM_RENDERFORMAT:
+            YoriLibClipRenderFormat((UINT)wParam);
+            return 0;
+
+        case WM_RENDERALLFORMATS:
+
+            //
+            //  The window is being destroyed, so render everything that
+            //  is still outstanding, provided this window still owns the
+            //  clipboard.
+            //
+
+            if (YoriLibOpenClipboardForWindow(hWnd)) {
+                if (DllUser32.pGetClipboardOwner() == hWnd) {
+                    YoriLibClipRenderFormat(Delayed->RtfFmt);
+                    YoriLibClipRenderFormat(Delayed->HtmlFmt);
+                }
+                DllUser32.pCloseClipboard();
+            }
+            return 0;
+
+        case WM_DESTROYCLIPBOARD:
+            WaitForSingleObject(Delayed->Mutex, INFINITE);
+            YoriLibFreeStringContents(&Delayed->RtfVersion);
+            YoriLibFreeStringContents(&Delayed->HtmlVersion);
+            ReleaseMutex(Delayed->Mutex);
+            return 0;
+
+        case WM_DESTROY:
+            Delayed->Window = NULL;
+            return 0;
+    }
+
+    return DllUser32.pDefWindowProcW(hWnd, uMsg, wParam, lParam);
+}
+
+/**
+ The entrypoint for the thread which creates and services the clipboard
+ owner window.
+
+ @param Context Pointer to an event to signal once the window has been
+        created or could not be created.
+
+ @return Zero.
+ */
+DWORD WINAPI
+YoriLibClipOwnerThread(
+    __in PVOID Context
+    )
+{
+    PYORI_LIB_CLIP_DELAYED_RENDER Delayed = &YoriLibClipDelayedRender;
+    HANDLE ReadyEvent = (HANDLE)Context;
+    WNDCLASSW WndClass;
+    MSG Msg;
+
+    ZeroMemory(&WndClass, sizeof(WndClass));
+    WndClass.lpfnWndProc = YoriLibClipOwnerWndProc;
+    WndClass.hInstance = GetModuleHandle(NULL);
+    WndClass.lpszClassName = YORI_LIB_CLIP_OWNER_CLASS;
+
+    if (DllUser32.pRegisterClassW(&WndClass) == 0 &&
+        GetLastError() != ERROR_CLASS_ALREADY_EXISTS) {
+
+        SetEvent(ReadyEvent);
+        return 0;
+    }
+
+    //
+    //  The window is never shown.  It exists only to own the clipboard.
+    //
+
+    Delayed->Window = DllUser32.pCreateWindowExW(0, YORI_LIB_CLIP_OWNER_CLASS, NULL, 0, 0, 0, 0, 0, NULL, NULL, WndClass.hInstance, NULL);
+    SetEvent(ReadyEvent);
+
+    if (Delayed->Window == NULL) {
+        return 0;
+    }
+
+    while (Delayed->Window != NULL && DllUser32.pGetMessageW(&Msg, NULL, 0, 0) > 0) {
+        DllUser32.pDispatchMessageW(&Msg);
+    }
+
+    return 0;
+}
+
+/**
+ Start the thread which owns the clipboard when rendering is delayed, if it
+ has not already been started.
+
+ @return TRUE if a clipboard owner window is available, FALSE if formats
+         must be rendered immediately.
+ */
+BOOLEAN
+YoriLibClipStartDelayedRender(VOID)
+{
+    PYORI_LIB_CLIP_DELAYED_RENDER Delayed = &YoriLibClipDelayedRender;
+    HANDLE ReadyEvent;
+    DWORD ThreadId;
+
+    if (Delayed->Started) {
+        return (BOOLEAN)(Delayed->Window != NULL);
+    }
+
+    if (DllUser32.pCreateWindowExW == NULL ||
+        DllUser32.pDefWindowProcW == NULL ||
+        DllUser32.pDispatchMessageW == NULL ||
+        DllUser32.pGetClipboardOwner == NULL ||
+        DllUser32.pGetMessageW == NULL ||
+        DllUser32.pPostMessageW == NULL ||
+        DllUser32.pRegisterClassW == NULL) {
+
+        return FALSE;
+    }
+
+    Delayed->Started = TRUE;
+
+    Delayed->Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (Delayed->Mutex == NULL) {
+        return FALSE;
+    }
+
+    ReadyEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (ReadyEvent == NULL) {
+        return FALSE;
+    }
+
+    Delayed->Thread = CreateThread(NULL, 0, YoriLibClipOwnerThread, ReadyEvent, 0, &ThreadId);
+    if (Delayed->Thread == NULL) {
+        CloseHandle(ReadyEvent);
+        return FALSE;
+    }
+
+    WaitForSingleObject(ReadyEvent, INFINITE);
+    CloseHandle(ReadyEvent);
+
+    if (Delayed->Window == NULL) {
+        WaitForSingleObject(Delayed->Thread, INFINITE);
+        CloseHandle(Delayed->Thread);
+        Delayed->Thread = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Destroy the clipboard owner window, rendering any formats that have not
+ yet been requested, and wait for its thread to terminate.
+ */
+VOID
+YoriLibClipStopDelayedRender(VOID)
+{
+    PYORI_LIB_CLIP_DELAYED_RENDER Delayed = &YoriLibClipDelayedRender;
+
+    if (Delayed->Thread != NULL) {
+        if (Delayed->Window != NULL) {
+            DllUser32.pPostMessageW(Delayed->Window, WM_CLOSE, 0, 0);
+        }
+        WaitForSingleObject(Delayed->Thread, INFINITE);
+        CloseHandle(Delayed->Thread);
+        Delayed->Thread = NULL;
+    }
+
+    if (Delayed->Mutex != NULL) {
+        CloseHandle(Delayed->Mutex);
+        Delayed->Mutex = NULL;
+    }
+
+    YoriLibFreeStringContents(&Delayed->RtfVersion);
+    YoriLibFreeStringContents(&Delayed->HtmlVersion);
+    Delayed->Started = FALSE;
+}
+
 /**
  Copy a Yori text string into the clipboard along with an HTML and RTF
- representation of the same string.
+ representation of the same string.  The text form is copied immediately.
+ Where possible, the RTF and HTML forms are only generated when another
+ application requests them.
 
  @param TextVersion The string to populate into the clipboard in text format.
 
@@ -409,15 +808,14 @@ YoriLibCopyTextRtfAndHtml(
     __in PYORI_STRING HtmlVersion
     )
 {
+    PYORI_LIB_CLIP_DELAYED_RENDER Delayed = &YoriLibClipDelayedRender;
     HANDLE hText;
     HANDLE hHtml;
     HANDLE hRtf;
-    HANDLE hClip;
-    LPWSTR pWideMem;
-    LPSTR  pNarrowMem;
-    DWORD Index;
     UINT HtmlFmt;
     UINT RtfFmt;
+    BOOLEAN DelayRender;
+    BOOLEAN Opened;
 
     YoriLibLoadUser32Functions();
 
@@ -431,11 +829,13 @@ YoriLibCopyTextRtfAndHtml(
         return FALSE;
     }
 
-    //
-    //  Open the clipboard and empty its contents.
-    //
+    HtmlFmt = DllUser32.pRegisterClipboardFormatW(_T("HTML Format"));
+    if (HtmlFmt == 0) {
+        return FALSE;
+    }
 
-    if (!YoriLibOpenClipboard()) {
+    RtfFmt = DllUser32.pRegisterClipboardFormatW(_T("Rich Text Format"));
+    if (RtfFmt == 0) {
         return FALSE;
     }
 
@@ -444,117 +844,102 @@ YoriLibCopyTextRtfAndHtml(
     //  a global memory allocation.
     //
 
-    hText = GlobalAlloc(GMEM_MOVEABLE, (TextVersion->LengthInChars + 1) * sizeof(TCHAR));
-    if (hText == NULL) {
-        DllUser32.pCloseClipboard();
-        return FALSE;
-    }
-
-    pWideMem = DllKernel32.pGlobalLock(hText);
-    if (pWideMem == NULL) {
-        GlobalFree(hText);
-        DllUser32.pCloseClipboard();
+    if (!YoriLibBuildTextClipboardBuffer(TextVersion, &hText)) {
         return FALSE;
     }
 
-    memcpy(pWideMem, TextVersion->StartOfString, TextVersion->LengthInChars * sizeof(TCHAR));
-    pWideMem[TextVersion->LengthInChars] = '\0';
-    DllKernel32.pGlobalUnlock(hText);
-    pWideMem = NULL;
-
     //
-    //  The clipboard uses global memory handles.  Copy the RTF form into
-    //  a global memory allocation.  Because RTF predates Unicode, any
-    //  extended characters must have already been encoded when generating
-    //  RTF, so the high 8 bits per char are discarded here.
+    //  If a clipboard owner window is available, the RTF and HTML forms are
+    //  rendered on request.  Otherwise, construct them now.
     //
 
-    hRtf = GlobalAlloc(GMEM_MOVEABLE, RtfVersion->LengthInChars + 1);
-    if (hRtf == NULL) {
-        GlobalFree(hText);
-        DllUser32.pCloseClipboard();
-        return FALSE;
-    }
-
-    pNarrowMem = DllKernel32.pGlobalLock(hRtf);
-    if (pNarrowMem == NULL) {
-        GlobalFree(hText);
-        GlobalFree(hRtf);
-        DllUser32.pCloseClipboard();
-        return FALSE;
-    }
+    hRtf = NULL;
+    hHtml = NULL;
+    DelayRender = YoriLibClipStartDelayedRender();
+    if (!DelayRender) {
+        if (!YoriLibBuildRtfClipboardBuffer(RtfVersion, &hRtf)) {
+            GlobalFree(hText);
+            return FALSE;
+        }
 
-    for (Index = 0; Index < RtfVersion->LengthInChars; Index++) {
-        pNarrowMem[Index] = (UCHAR)(RtfVersion->StartOfString[Index] & 0x7f);
+        if (!YoriLibBuildHtmlClipboardBuffer(HtmlVersion, &hHtml)) {
+            GlobalFree(hText);
+            GlobalFree(hRtf);
+            return FALSE;
+        }
     }
-    pNarrowMem[RtfVersion->LengthInChars] = '\0';
-
-    DllKernel32.pGlobalUnlock(hRtf);
-    pNarrowMem = NULL;
 
     //
-    //  Construct a global memory region for HTML.  This is more involved
-    //  because unlike the others it has a header.
+    //  Open the clipboard and empty its contents.  When rendering is
+    //  delayed, the clipboard is opened on behalf of the owner window so
+    //  that emptying it makes that window the owner.  Emptying the
+    //  clipboard frees any strings retained from a previous copy.
     //
 
-    if (!YoriLibBuildHtmlClipboardBuffer(HtmlVersion, &hHtml)) {
-        GlobalFree(hText);
-        GlobalFree(hRtf);
-        DllUser32.pCloseClipboard();
-        return FALSE;
+    if (DelayRender) {
+        Opened = YoriLibOpenClipboardForWindow(Delayed->Window);
+    } else {
+        Opened = YoriLibOpenClipboard();
     }
 
-    DllUser32.pEmptyClipboard();
-
-    HtmlFmt = DllUser32.pRegisterClipboardFormatW(_T("HTML Format"));
-    if (HtmlFmt == 0) {
+    if (!Opened) {
         GlobalFree(hText);
-        GlobalFree(hRtf);
-        GlobalFree(hHtml);
-        DllUser32.pCloseClipboard();
+        if (hRtf != NULL) {
+            GlobalFree(hRtf);
+        }
+        if (hHtml != NULL) {
+            GlobalFree(hHtml);
+        }
         return FALSE;
     }
 
-    RtfFmt = DllUser32.pRegisterClipboardFormatW(_T("Rich Text Format"));
-    if (RtfFmt == 0) {
-        GlobalFree(hText);
-        GlobalFree(hRtf);
-        GlobalFree(hHtml);
-        DllUser32.pCloseClipboard();
-        return FALSE;
-    }
+    DllUser32.pEmptyClipboard();
 
-    hClip = DllUser32.pSetClipboardData(CF_UNICODETEXT, hText);
-    if (hClip == NULL) {
-        DllUser32.pCloseClipboard();
-        GlobalFree(hHtml);
-        GlobalFree(hRtf);
-        GlobalFree(hText);
-        return FALSE;
+    if (DelayRender) {
+        WaitForSingleObject(Delayed->Mutex, INFINITE);
+        Delayed->RtfFmt = RtfFmt;
+        Delayed->HtmlFmt = HtmlFmt;
+        YoriLibFreeStringContents(&Delayed->RtfVersion);
+        YoriLibFreeStringContents(&Delayed->HtmlVersion);
+        if (!YoriLibCopyString(&Delayed->RtfVersion, RtfVersion) ||
+            !YoriLibCopyString(&Delayed->HtmlVersion, HtmlVersion)) {
+
+            YoriLibFreeStringContents(&Delayed->RtfVersion);
+            YoriLibFreeStringContents(&Delayed->HtmlVersion);
+            DelayRender = FALSE;
+        }
+        ReleaseMutex(Delayed->Mutex);
     }
 
-    hClip = DllUser32.pSetClipboardData(RtfFmt, hRtf);
-    if (hClip == NULL) {
+    //
+    //  Once the clipboard accepts a handle, it owns the allocation.
+    //
+
+    if (DllUser32.pSetClipboardData(CF_UNICODETEXT, hText) == NULL) {
         DllUser32.pCloseClipboard();
-        GlobalFree(hHtml);
-        GlobalFree(hRtf);
         GlobalFree(hText);
+        if (hRtf != NULL) {
+            GlobalFree(hRtf);
+        }
+        if (hHtml != NULL) {
+            GlobalFree(hHtml);
+        }
         return FALSE;
     }
 
-    hClip = DllUser32.pSetClipboardData(HtmlFmt, hHtml);
-    if (hClip == NULL) {
-        DllUser32.pCloseClipboard();
-        GlobalFree(hHtml);
-        GlobalFree(hRtf);
-        GlobalFree(hText);
-        return FALSE;
+    if (DelayRender) {
+        DllUser32.pSetClipboardData(RtfFmt, NULL);
+        DllUser32.pSetClipboardData(HtmlFmt, NULL);
+    } else if (hRtf != NULL) {
+        if (DllUser32.pSetClipboardData(RtfFmt, hRtf) == NULL) {
+            GlobalFree(hRtf);
+        }
+        if (DllUser32.pSetClipboardData(HtmlFmt, hHtml) == NULL) {
+            GlobalFree(hHtml);
+        }
     }
 
     DllUser32.pCloseClipboard();
-    GlobalFree(hText);
-    GlobalFree(hRtf);
-    GlobalFree(hHtml);
     return TRUE;
 }
 
@@ -784,11 +1169,14 @@ YORI_STRING YoriLibProcessClipboard;
 /**
  Empty the process clipboard.  This is used on process termination to free
  memory since the process clipboard is inaccessible after process termination
- anyway.
+ anyway.  Any formats on the system clipboard whose rendering was delayed
+ are rendered now, since this process will not be present to render them
+ later.
  */
 VOID
 YoriLibEmptyProcessClipboard(VOID)
 {
+    YoriLibClipStopDelayedRender();
     YoriLibFreeStringContents(&YoriLibProcessClipboard);
 }
 
@@ -3,7 +3,7 @@
  *
  * Converts between strings and argc/argv arrays
  *
- * Copyright (c) 2017-2021 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -511,6 +511,12 @@ YoriLibArgArrayToVariableValue(
  Parses a NULL terminated command line string into an argument count and array
  of YORI_STRINGs corresponding to arguments.
 
+ The command line is parsed in a single pass.  Before parsing, a quick scan
+ determines the length of the string and the number of runs of spaces
+ within it, which bound the number of arguments and characters that parsing
+ can generate.  All arguments are then written into one allocation as they
+ are found, so no quote or escape processing is performed more than once.
+
  @param CmdLine The NULL terminated command line.
 
  @param MaxArgs The maximum number of arguments to return.  All trailing
@@ -542,16 +548,24 @@ YoriLibCmdlineToArgcArgv(
     __out_opt PBOOLEAN * ArgQuotesPresent
     )
 {
-    YORI_ALLOC_SIZE_T ArgCount = 0;
-    YORI_ALLOC_SIZE_T CharCount = 0;
+    YORI_ALLOC_SIZE_T ArgCount;
+    YORI_ALLOC_SIZE_T MaxArgCount;
+    YORI_ALLOC_SIZE_T CharCount;
     YORI_ALLOC_SIZE_T SlashCount;
+    YORI_ALLOC_SIZE_T Index;
     TCHAR CONST * c;
     PYORI_STRING ArgvArray;
+    PYORI_STRING Arg;
     PBOOLEAN ArgQuotes;
     LPTSTR ReturnStrings;
     BOOLEAN EndArg;
     BOOLEAN QuoteOpen;
 
+    *ArgC = 0;
+    if (ArgQuotesPresent) {
+        *ArgQuotesPresent = NULL;
+    }
+
     //
     //  Consume all spaces.  After this, we're either at
     //  the end of string, or we have an arg, and it
@@ -561,107 +575,42 @@ YoriLibCmdlineToArgcArgv(
     c = CmdLine;
     while (*c == ' ') c++;
 
-    QuoteOpen = FALSE;
-
-
-    while (*c != '\0') {
-        EndArg = FALSE;
-
-        if (*c == '^' && c[1] != '\0' && ApplyCaretAsEscape) {
-            c++;
-            CharCount++;
-        } else if (*c == '\\') {
-            for (SlashCount = 1; c[SlashCount] == '\\'; SlashCount++);
-            if (c[SlashCount] == '"') {
-
-                //
-                //  Because one char is left for regular processing, only
-                //  adjust for one less pair.  Three slashes means consume
-                //  two chars, output one; four means consume three, output
-                //  one, etc.
-                //
-
-                if ((SlashCount % 2) == 0) {
-                    SlashCount--;
-                }
-                CharCount += SlashCount / 2;
-                c += SlashCount;
-            }
-        } else if (*c == '"') {
-            QuoteOpen = (BOOLEAN)(!QuoteOpen);
-            c++;
-            if (ArgCount < MaxArgs && *c == '\0') {
-                ArgCount++;
-            }
-            continue;
-        } else if (!QuoteOpen && *c == ' ') {
-            EndArg = TRUE;
-        }
-
-        if (ArgCount + 1 < MaxArgs && EndArg) {
-            c++;
-            while (*c == ' ') c++;
-            ArgCount++;
-        } else {
-            CharCount++;
-
-            //
-            //  If we hit a break char, we count the argument then.
-            //  If we hit end of string, count it here; note we're
-            //  only counting it if we counted a character before it
-            //  (ie., trailing whitespace is not an arg.)
-            //
+    if (*c == '\0' || MaxArgs == 0) {
+        return NULL;
+    }
 
-            c++;
+    //
+    //  A new argument can only begin after a run of spaces, so the number
+    //  of runs bounds the number of arguments.  Each argument can't be
+    //  longer than the input, and a NULL is added to each.
+    //
 
-            if (ArgCount < MaxArgs && *c == '\0') {
-                ArgCount++;
-            }
+    MaxArgCount = 1;
+    for (CharCount = 0; c[CharCount] != '\0'; CharCount++) {
+        if (c[CharCount] == ' ' && c[CharCount + 1] != ' ') {
+            MaxArgCount++;
         }
     }
 
-    *ArgC = ArgCount;
-    if (ArgCount == 0) {
-        if (ArgQuotesPresent) {
-            *ArgQuotesPresent = NULL;
-        }
-        return NULL;
+    if (MaxArgCount > MaxArgs) {
+        MaxArgCount = MaxArgs;
     }
 
-    ArgvArray = YoriLibReferencedMalloc( (ArgCount * sizeof(YORI_STRING)) +
-                                         (ArgCount * sizeof(BOOLEAN)) +
-                                         (CharCount + ArgCount) * sizeof(TCHAR));
+    ArgvArray = YoriLibReferencedMalloc( (MaxArgCount * sizeof(YORI_STRING)) +
+                                         (MaxArgCount * sizeof(BOOLEAN)) +
+                                         (CharCount + MaxArgCount) * sizeof(TCHAR));
     if (ArgvArray == NULL) {
-        *ArgC = 0;
-        if (ArgQuotesPresent) {
-            *ArgQuotesPresent = NULL;
-        }
         return NULL;
     }
 
-
-    ArgQuotes = (PBOOLEAN)(ArgvArray + ArgCount);
-    ReturnStrings = (LPTSTR)(ArgQuotes + ArgCount);
-
-    if (ArgQuotesPresent != NULL) {
-        *ArgQuotesPresent = ArgQuotes;
-    }
+    ArgQuotes = (PBOOLEAN)(ArgvArray + MaxArgCount);
+    ReturnStrings = (LPTSTR)(ArgQuotes + MaxArgCount);
 
     ArgCount = 0;
-    YoriLibInitEmptyString(&ArgvArray[ArgCount]);
-    ArgvArray[ArgCount].StartOfString = ReturnStrings;
-    ArgvArray[ArgCount].MemoryToFree = ArgvArray;
-    YoriLibReference(ArgvArray);
+    Arg = &ArgvArray[ArgCount];
+    YoriLibInitEmptyString(Arg);
+    Arg->StartOfString = ReturnStrings;
     ArgQuotes[ArgCount] = FALSE;
-
-    //
-    //  Consume all spaces.  After this, we're either at
-    //  the end of string, or we have an arg, and it
-    //  might start with a quote
-    //
-
-    c = CmdLine;
-    while (*c == ' ') c++;
     QuoteOpen = FALSE;
 
     while (*c != '\0') {
@@ -670,7 +619,6 @@ YoriLibCmdlineToArgcArgv(
         if (*c == '^' && c[1] != '\0' && ApplyCaretAsEscape) {
             *ReturnStrings = *c;
             ReturnStrings++;
-            ArgvArray[ArgCount].LengthInChars++;
             c++;
         } else if (*c == '\\') {
             for (SlashCount = 1; c[SlashCount] == '\\'; SlashCount++);
@@ -685,10 +633,9 @@ YoriLibCmdlineToArgcArgv(
                 //  character below.
                 //
 
-                for (CharCount = 2; CharCount < SlashCount; CharCount += 2) {
+                for (Index = 2; Index < SlashCount; Index += 2) {
                     *ReturnStrings = '\\';
                     ReturnStrings++;
-                    ArgvArray[ArgCount].LengthInChars++;
                     c += 2;
                 }
                 c++;
@@ -699,53 +646,63 @@ YoriLibCmdlineToArgcArgv(
                 ArgQuotes[ArgCount] = TRUE;
             }
             c++;
-            if (*c == '\0') {
-                *ReturnStrings = '\0';
-                ArgvArray[ArgCount].LengthAllocated = (YORI_ALLOC_SIZE_T)(ArgvArray[ArgCount].LengthInChars + 1);
-            }
             continue;
         } else if (!QuoteOpen && *c == ' ') {
             EndArg = TRUE;
         }
 
-        if (ArgCount + 1 < MaxArgs && EndArg) {
+        if (ArgCount + 1 < MaxArgCount && EndArg) {
             *ReturnStrings = '\0';
+            Arg->LengthInChars = (YORI_ALLOC_SIZE_T)(ReturnStrings - Arg->StartOfString);
+            Arg->LengthAllocated = (YORI_ALLOC_SIZE_T)(Arg->LengthInChars + 1);
             ReturnStrings++;
-            ArgvArray[ArgCount].LengthAllocated = (YORI_ALLOC_SIZE_T)(ArgvArray[ArgCount].LengthInChars + 1);
 
             c++;
             while (*c == ' ') c++;
             if (*c != '\0') {
                 ArgCount++;
-                YoriLibInitEmptyString(&ArgvArray[ArgCount]);
-                ArgvArray[ArgCount].StartOfString = ReturnStrings;
-                YoriLibReference(ArgvArray);
-                ArgvArray[ArgCount].MemoryToFree = ArgvArray;
+                Arg = &ArgvArray[ArgCount];
+                YoriLibInitEmptyString(Arg);
+                Arg->StartOfString = ReturnStrings;
                 ArgQuotes[ArgCount] = FALSE;
             }
         } else {
             *ReturnStrings = *c;
             ReturnStrings++;
-            ArgvArray[ArgCount].LengthInChars++;
+            c++;
+        }
+    }
 
-            //
-            //  If we hit a break char, we count the argument then.
-            //  If we hit end of string, count it here; note we're
-            //  only counting it if we counted a character before it
-            //  (ie., trailing whitespace is not an arg.)
-            //
+    //
+    //  If the string ended within an argument, terminate it here.  Note
+    //  trailing whitespace has already terminated the final argument and
+    //  does not start another one.
+    //
 
-            c++;
+    if (Arg->LengthAllocated == 0) {
+        *ReturnStrings = '\0';
+        Arg->LengthInChars = (YORI_ALLOC_SIZE_T)(ReturnStrings - Arg->StartOfString);
+        Arg->LengthAllocated = (YORI_ALLOC_SIZE_T)(Arg->LengthInChars + 1);
+    }
 
-            if (*c == '\0') {
-                *ReturnStrings = '\0';
-                ArgvArray[ArgCount].LengthAllocated = (YORI_ALLOC_SIZE_T)(ArgvArray[ArgCount].LengthInChars + 1);
-            }
-        }
+    ArgCount++;
+
+    //
+    //  Each argument holds a reference to the allocation, in addition to
+    //  the reference held by the array itself.
+    //
+
+    for (Index = 0; Index < ArgCount; Index++) {
+        ArgvArray[Index].MemoryToFree = ArgvArray;
+        YoriLibReference(ArgvArray);
+    }
+
+    *ArgC = ArgCount;
+    if (ArgQuotesPresent != NULL) {
+        *ArgQuotesPresent = ArgQuotes;
     }
 
     return ArgvArray;
 }
 
-
 // vim:sw=4:ts=4:et:
@@ -3,7 +3,7 @@
  *
  * Yori CPU query routines
  *
- * Copyright (c) 2019-2022 Malcolm J. Smith
+ * Copyright (c) 2019-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -27,6 +27,118 @@
 #include "yoripch.h"
 #include "yorilib.h"
 
+/**
+ Query processor relationship information from the system, allocating a
+ buffer of the required size.
+
+ @param Relationship The type of relationship to query.
+
+ @param ProcInfo On successful completion, updated to point to an allocated
+        buffer containing the information.  The caller should free this
+        with YoriLibFree.
+
+ @param BytesInBuffer On successful completion, updated to contain the
+        number of bytes of information in the buffer.
+
+ @return Win32 error code, ERROR_SUCCESS to indicate success.
+ */
+DWORD
+YoriLibQueryLogicalProcessorInformation(
+    __in YORI_LOGICAL_PROCESSOR_RELATIONSHIP Relationship,
+    __out PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *ProcInfo,
+    __out PDWORD BytesInBuffer
+    )
+{
+    DWORD Err;
+    DWORD BytesNeeded;
+    PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX Buffer;
+
+    *ProcInfo = NULL;
+    *BytesInBuffer = 0;
+
+    if (DllKernel32.pGetLogicalProcessorInformationEx == NULL) {
+        return ERROR_PROC_NOT_FOUND;
+    }
+
+    //
+    //  Query processor information from the system.  This needs to allocate
+    //  memory as needed to populate, so loop while the buffer is too small
+    //  in order to allocate the correct amount.
+    //
+
+    Buffer = NULL;
+    BytesNeeded = 0;
+    while(TRUE) {
+        if (DllKernel32.pGetLogicalProcessorInformationEx(Relationship, Buffer, &BytesNeeded)) {
+            Err = ERROR_SUCCESS;
+            break;
+        }
+
+        Err = GetLastError();
+        if (Err != ERROR_INSUFFICIENT_BUFFER) {
+            break;
+        }
+
+        if (Buffer != NULL) {
+            YoriLibFree(Buffer);
+            Buffer = NULL;
+        }
+
+        if (!YoriLibIsSizeAllocatable(BytesNeeded)) {
+            Err = ERROR_NOT_ENOUGH_MEMORY;
+            break;
+        }
+
+        Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+        if (Buffer == NULL) {
+            Err = ERROR_NOT_ENOUGH_MEMORY;
+            break;
+        }
+    }
+
+    if (Err != ERROR_SUCCESS) {
+        if (Buffer != NULL) {
+            YoriLibFree(Buffer);
+        }
+        return Err;
+    }
+
+    *ProcInfo = Buffer;
+    *BytesInBuffer = BytesNeeded;
+    return ERROR_SUCCESS;
+}
+
+/**
+ Count the number of logical processors described by a processor core
+ relationship.
+
+ @param Core Pointer to the processor core relationship.
+
+ @return The number of logical processors in the core.
+ */
+DWORD
+YoriLibCountCoreLogicalProcessors(
+    __in PYORI_PROCESSOR_RELATIONSHIP Core
+    )
+{
+    DWORD GroupIndex;
+    DWORD LogicalProcessorIndex;
+    DWORD LogicalProcessorCount;
+    DWORD_PTR LogicalProcessorMask;
+
+    LogicalProcessorCount = 0;
+    for (GroupIndex = 0; GroupIndex < Core->GroupCount; GroupIndex++) {
+        for (LogicalProcessorIndex = 0; LogicalProcessorIndex < 8 * sizeof(DWORD_PTR); LogicalProcessorIndex++) {
+            LogicalProcessorMask = 1;
+            LogicalProcessorMask = LogicalProcessorMask<<LogicalProcessorIndex;
+            if (Core->GroupMask[GroupIndex].Mask & LogicalProcessorMask) {
+                LogicalProcessorCount++;
+            }
+        }
+    }
+
+    return LogicalProcessorCount;
+}
 
 /**
  Query the system to find the number of high performance and high efficiency
@@ -56,53 +168,15 @@ YoriLibQueryCpuCount(
 
     if (DllKernel32.pGetLogicalProcessorInformationEx != NULL) {
         DWORD Err;
-        DWORD BytesInBuffer = 0;
+        DWORD BytesInBuffer;
         DWORD CurrentOffset = 0;
-        DWORD GroupIndex;
         WORD LocalEfficiencyProcessorCount;
         WORD LocalPerformanceProcessorCount;
         WORD LogicalProcessorCount;
-        WORD LogicalProcessorIndex;
-        DWORD_PTR LogicalProcessorMask;
-        PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX ProcInfo = NULL;
+        PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX ProcInfo;
         PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX Entry;
-        PYORI_PROCESSOR_GROUP_AFFINITY Group;
-    
-        //
-        //  Query processor information from the system.  This needs to allocate
-        //  memory as needed to populate, so loop while the buffer is too small
-        //  in order to allocate the correct amount.
-        //
-    
-        Err = ERROR_SUCCESS;
-        while(TRUE) {
-            if (DllKernel32.pGetLogicalProcessorInformationEx(YoriProcessorRelationAll, ProcInfo, &BytesInBuffer)) {
-                Err = ERROR_SUCCESS;
-                break;
-            }
-    
-            Err = GetLastError();
-            if (Err == ERROR_INSUFFICIENT_BUFFER) {
-                if (ProcInfo != NULL) {
-                    YoriLibFree(ProcInfo);
-                    ProcInfo = NULL;
-                }
 
-                if (!YoriLibIsSizeAllocatable(BytesInBuffer)) {
-                    Err = ERROR_NOT_ENOUGH_MEMORY;
-                    break;
-                }
-    
-                ProcInfo = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesInBuffer);
-                if (ProcInfo == NULL) {
-                    Err = ERROR_NOT_ENOUGH_MEMORY;
-                    break;
-                }
-            } else {
-                break;
-            }
-        }
-    
+        Err = YoriLibQueryLogicalProcessorInformation(YoriProcessorRelationAll, &ProcInfo, &BytesInBuffer);
         if (Err == ERROR_SUCCESS) {
             LocalEfficiencyProcessorCount = 0;
             LocalPerformanceProcessorCount = 0;
@@ -115,17 +189,7 @@ YoriLibQueryCpuCount(
                     //  this core.
                     //
 
-                    LogicalProcessorCount = 0;
-                    for (GroupIndex = 0; GroupIndex < Entry->u.Processor.GroupCount; GroupIndex++) {
-                        Group = &Entry->u.Processor.GroupMask[GroupIndex];
-                        for (LogicalProcessorIndex = 0; LogicalProcessorIndex < 8 * sizeof(DWORD_PTR); LogicalProcessorIndex++) {
-                            LogicalProcessorMask = 1;
-                            LogicalProcessorMask = LogicalProcessorMask<<LogicalProcessorIndex;
-                            if (Group->Mask & LogicalProcessorMask) {
-                                LogicalProcessorCount++;
-                            }
-                        }
-                    }
+                    LogicalProcessorCount = (WORD)YoriLibCountCoreLogicalProcessors(&Entry->u.Processor);
                     if (Entry->u.Processor.EfficiencyClass == 0) {
                         LocalEfficiencyProcessorCount = (WORD)(LocalEfficiencyProcessorCount + LogicalProcessorCount);
                     } else {
@@ -178,4 +242,496 @@ YoriLibQueryCpuCount(
     *EfficiencyLogicalProcessors = 0;
 }
 
+/**
+ Find a logical processor within a topology.
+
+ @param Topology Pointer to the topology to search.
+
+ @param Group The processor group of the logical processor.
+
+ @param Number The index of the logical processor within its group.
+
+ @return Pointer to the logical processor, or NULL if it is not found.
+ */
+PYORI_LIB_CPU_PROCESSOR
+YoriLibFindCpuInTopology(
+    __in PYORI_LIB_CPU_TOPOLOGY Topology,
+    __in WORD Group,
+    __in UCHAR Number
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < Topology->ProcessorCount; Index++) {
+        if (Topology->Processors[Index].Group == Group &&
+            Topology->Processors[Index].Number == Number) {
+
+            return &Topology->Processors[Index];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ Populate the CPU set identifiers of each logical processor within a
+ topology.  CPU sets are available on Windows 10 and above.
+
+ @param Topology Pointer to the topology to update.
+ */
+VOID
+YoriLibQueryCpuSets(
+    __inout PYORI_LIB_CPU_TOPOLOGY Topology
+    )
+{
+    PYORI_SYSTEM_CPU_SET_INFORMATION CpuSets;
+    PYORI_SYSTEM_CPU_SET_INFORMATION Entry;
+    PYORI_LIB_CPU_PROCESSOR Processor;
+    DWORD BytesInBuffer;
+    DWORD CurrentOffset;
+    DWORD Found;
+
+    if (DllKernel32.pGetSystemCpuSetInformation == NULL) {
+        return;
+    }
+
+    BytesInBuffer = 0;
+    DllKernel32.pGetSystemCpuSetInformation(NULL, 0, &BytesInBuffer, GetCurrentProcess(), 0);
+    if (BytesInBuffer == 0 || !YoriLibIsSizeAllocatable(BytesInBuffer)) {
+        return;
+    }
+
+    CpuSets = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesInBuffer);
+    if (CpuSets == NULL) {
+        return;
+    }
+
+    if (!DllKernel32.pGetSystemCpuSetInformation(CpuSets, BytesInBuffer, &BytesInBuffer, GetCurrentProcess(), 0)) {
+        YoriLibFree(CpuSets);
+        return;
+    }
+
+    Found = 0;
+    CurrentOffset = 0;
+    while (CurrentOffset + sizeof(YORI_SYSTEM_CPU_SET_INFORMATION) <= BytesInBuffer) {
+        Entry = YoriLibAddToPointer(CpuSets, CurrentOffset);
+        if (Entry->Size == 0) {
+            break;
+        }
+        if (Entry->Type == YoriCpuSetInformation) {
+            Processor = YoriLibFindCpuInTopology(Topology, Entry->Group, Entry->LogicalProcessorIndex);
+            if (Processor != NULL) {
+                Processor->CpuSetId = Entry->Id;
+                Found++;
+            }
+        }
+        CurrentOffset += Entry->Size;
+    }
+
+    //
+    //  Only use CPU sets if every logical processor has one, so that any
+    //  selection made from the topology can be expressed.
+    //
+
+    if (Found == Topology->ProcessorCount) {
+        Topology->HaveCpuSets = TRUE;
+    }
+
+    YoriLibFree(CpuSets);
+}
+
+/**
+ Query the processor topology of the system, describing each logical
+ processor along with its processor group, NUMA node, core, efficiency
+ class and CPU set.  On older systems this describes the processors in
+ the current processor group as a single homogenous set.
+
+ @param Topology On successful completion, updated to point to an allocated
+        topology.  The caller should free this with YoriLibFree.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibQueryCpuTopology(
+    __out PYORI_LIB_CPU_TOPOLOGY *Topology
+    )
+{
+    PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX ProcInfo;
+    PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX Entry;
+    PYORI_PROCESSOR_GROUP_AFFINITY Group;
+    PYORI_LIB_CPU_PROCESSOR Processor;
+    PYORI_LIB_CPU_TOPOLOGY NewTopology;
+    YORI_SYSTEM_INFO SysInfo;
+    DWORD BytesInBuffer;
+    DWORD CurrentOffset;
+    DWORD ProcessorCount;
+    DWORD CoreCount;
+    DWORD GroupIndex;
+    DWORD Index;
+    UCHAR LogicalProcessorIndex;
+    DWORD_PTR LogicalProcessorMask;
+
+    ProcessorCount = 0;
+    if (YoriLibQueryLogicalProcessorInformation(YoriProcessorRelationAll, &ProcInfo, &BytesInBuffer) == ERROR_SUCCESS) {
+        CurrentOffset = 0;
+        while (CurrentOffset < BytesInBuffer) {
+            Entry = YoriLibAddToPointer(ProcInfo, CurrentOffset);
+            if (Entry->Relationship == YoriProcessorRelationProcessorCore) {
+                ProcessorCount += YoriLibCountCoreLogicalProcessors(&Entry->u.Processor);
+            }
+            CurrentOffset += Entry->SizeInBytes;
+        }
+
+        if (ProcessorCount == 0) {
+            YoriLibFree(ProcInfo);
+            ProcInfo = NULL;
+        }
+    }
+
+    //
+    //  If the system cannot describe its processors, describe the ones
+    //  in the current processor group.  Note GetSystemInfo cannot fail.
+    //
+
+    if (ProcessorCount == 0) {
+        GetSystemInfo((LPSYSTEM_INFO)&SysInfo);
+        ProcessorCount = SysInfo.dwNumberOfProcessors;
+        if (ProcessorCount == 0) {
+            ProcessorCount = 1;
+        }
+    }
+
+    NewTopology = YoriLibMalloc((YORI_ALLOC_SIZE_T)(sizeof(YORI_LIB_CPU_TOPOLOGY) + (ProcessorCount - 1) * sizeof(YORI_LIB_CPU_PROCESSOR)));
+    if (NewTopology == NULL) {
+        if (ProcInfo != NULL) {
+            YoriLibFree(ProcInfo);
+        }
+        return FALSE;
+    }
+
+    ZeroMemory(NewTopology, sizeof(YORI_LIB_CPU_TOPOLOGY) + (ProcessorCount - 1) * sizeof(YORI_LIB_CPU_PROCESSOR));
+
+    if (ProcInfo == NULL) {
+        NewTopology->ProcessorCount = ProcessorCount;
+        NewTopology->CoreCount = ProcessorCount;
+        NewTopology->GroupCount = 1;
+        NewTopology->NumaNodeCount = 1;
+        for (Index = 0; Index < ProcessorCount; Index++) {
+            NewTopology->Processors[Index].Number = (UCHAR)Index;
+            NewTopology->Processors[Index].Core = Index;
+        }
+        *Topology = NewTopology;
+        return TRUE;
+    }
+
+    //
+    //  Describe each logical processor within each core.
+    //
+
+    CoreCount = 0;
+    NewTopology->GroupCount = 1;
+    CurrentOffset = 0;
+    while (CurrentOffset < BytesInBuffer) {
+        Entry = YoriLibAddToPointer(ProcInfo, CurrentOffset);
+        if (Entry->Relationship == YoriProcessorRelationProcessorCore) {
+            for (GroupIndex = 0; GroupIndex < Entry->u.Processor.GroupCount; GroupIndex++) {
+                Group = &Entry->u.Processor.GroupMask[GroupIndex];
+                if (Group->Group >= NewTopology->GroupCount) {
+                    NewTopology->GroupCount = (WORD)(Group->Group + 1);
+                }
+                for (LogicalProcessorIndex = 0; LogicalProcessorIndex < 8 * sizeof(DWORD_PTR); LogicalProcessorIndex++) {
+                    LogicalProcessorMask = 1;
+                    LogicalProcessorMask = LogicalProcessorMask<<LogicalProcessorIndex;
+                    if ((Group->Mask & LogicalProcessorMask) &&
+                        NewTopology->ProcessorCount < ProcessorCount) {
+
+                        Processor = &NewTopology->Processors[NewTopology->ProcessorCount];
+                        Processor->Group = Group->Group;
+                        Processor->Number = LogicalProcessorIndex;
+                        Processor->EfficiencyClass = Entry->u.Processor.EfficiencyClass;
+                        Processor->Core = CoreCount;
+                        NewTopology->ProcessorCount++;
+                    }
+                }
+            }
+            if (Entry->u.Processor.EfficiencyClass > NewTopology->HighestEfficiencyClass) {
+                NewTopology->HighestEfficiencyClass = Entry->u.Processor.EfficiencyClass;
+            }
+            CoreCount++;
+        }
+        CurrentOffset += Entry->SizeInBytes;
+    }
+    NewTopology->CoreCount = CoreCount;
+
+    //
+    //  Assign each logical processor to its NUMA node.
+    //
+
+    CurrentOffset = 0;
+    while (CurrentOffset < BytesInBuffer) {
+        Entry = YoriLibAddToPointer(ProcInfo, CurrentOffset);
+        if (Entry->Relationship == YoriProcessorRelationNumaNode) {
+            Group = &Entry->u.NumaNode.GroupMask;
+            for (Index = 0; Index < NewTopology->ProcessorCount; Index++) {
+                Processor = &NewTopology->Processors[Index];
+                LogicalProcessorMask = 1;
+                LogicalProcessorMask = LogicalProcessorMask<<Processor->Number;
+                if (Processor->Group == Group->Group &&
+                    (Group->Mask & LogicalProcessorMask) != 0) {
+
+                    Processor->NumaNode = Entry->u.NumaNode.NodeNumber;
+                }
+            }
+            NewTopology->NumaNodeCount++;
+        }
+        CurrentOffset += Entry->SizeInBytes;
+    }
+
+    if (NewTopology->NumaNodeCount == 0) {
+        NewTopology->NumaNodeCount = 1;
+    }
+
+    YoriLibFree(ProcInfo);
+
+    YoriLibQueryCpuSets(NewTopology);
+
+    *Topology = NewTopology;
+    return TRUE;
+}
+
+/**
+ Check whether a logical processor is suitable for a class of work.
+
+ @param Topology Pointer to the system topology.
+
+ @param Processor Pointer to the logical processor to check.
+
+ @param CpuClass The class of work.
+
+ @return TRUE if the processor is suitable for the work, FALSE if not.
+ */
+BOOLEAN
+YoriLibIsCpuInClass(
+    __in PYORI_LIB_CPU_TOPOLOGY Topology,
+    __in PYORI_LIB_CPU_PROCESSOR Processor,
+    __in YORI_LIB_CPU_CLASS CpuClass
+    )
+{
+    //
+    //  On homogenous systems, all cores report efficiency class zero, and
+    //  are suitable for any work.  Otherwise, efficiency class zero is the
+    //  most efficient class, consistent with YoriLibQueryCpuCount.
+    //
+
+    if (CpuClass == YoriLibCpuClassAny || Topology->HighestEfficiencyClass == 0) {
+        return TRUE;
+    }
+
+    if (CpuClass == YoriLibCpuClassEfficiency) {
+        return (BOOLEAN)(Processor->EfficiencyClass == 0);
+    }
+
+    return (BOOLEAN)(Processor->EfficiencyClass != 0);
+}
+
+/**
+ Restrict a thread to logical processors suited to a class of work.  Each
+ worker in a pool should be given a distinct index, which is used to
+ distribute workers across processor groups so that a pool can use more
+ than 64 logical processors.  Each thread is restricted to the suitable
+ processors within a single group rather than one processor, so the
+ scheduler can still balance work within the group.
+
+ @param hThread Handle to the thread to place.
+
+ @param Topology Pointer to the system topology, returned from
+        YoriLibQueryCpuTopology.
+
+ @param CpuClass The class of work that the thread performs.
+
+ @param WorkerIndex The index of this worker within its pool.
+
+ @return TRUE if the thread was placed or did not need to be, FALSE if the
+         system could not place it.
+ */
+BOOLEAN
+YoriLibPlaceThread(
+    __in HANDLE hThread,
+    __in PYORI_LIB_CPU_TOPOLOGY Topology,
+    __in YORI_LIB_CPU_CLASS CpuClass,
+    __in DWORD WorkerIndex
+    )
+{
+    YORI_PROCESSOR_GROUP_AFFINITY Affinity;
+    PYORI_LIB_CPU_PROCESSOR Processor;
+    PDWORD CpuSetIds;
+    DWORD MatchCount;
+    DWORD TargetIndex;
+    DWORD GroupMatchCount;
+    DWORD Index;
+    WORD TargetGroup;
+    DWORD_PTR LogicalProcessorMask;
+    BOOL Result;
+
+    MatchCount = 0;
+    for (Index = 0; Index < Topology->ProcessorCount; Index++) {
+        if (YoriLibIsCpuInClass(Topology, &Topology->Processors[Index], CpuClass)) {
+            MatchCount++;
+        }
+    }
+
+    if (MatchCount == 0) {
+        CpuClass = YoriLibCpuClassAny;
+        MatchCount = Topology->ProcessorCount;
+    }
+
+    //
+    //  If every processor is suitable and there is only one group, the
+    //  scheduler can already use all of them.
+    //
+
+    if (MatchCount == Topology->ProcessorCount && Topology->GroupCount <= 1) {
+        return TRUE;
+    }
+
+    //
+    //  Find the group of the processor corresponding to this worker.
+    //  Processors are described in group order, so consecutive workers
+    //  fill each group before moving to the next.
+    //
+
+    TargetIndex = WorkerIndex % MatchCount;
+    TargetGroup = 0;
+    for (Index = 0; Index < Topology->ProcessorCount; Index++) {
+        Processor = &Topology->Processors[Index];
+        if (YoriLibIsCpuInClass(Topology, Processor, CpuClass)) {
+            if (TargetIndex == 0) {
+                TargetGroup = Processor->Group;
+                break;
+            }
+            TargetIndex--;
+        }
+    }
+
+    ZeroMemory(&Affinity, sizeof(Affinity));
+    Affinity.Group = TargetGroup;
+    GroupMatchCount = 0;
+    for (Index = 0; Index < Topology->ProcessorCount; Index++) {
+        Processor = &Topology->Processors[Index];
+        if (Processor->Group == TargetGroup &&
+            YoriLibIsCpuInClass(Topology, Processor, CpuClass)) {
+
+            LogicalProcessorMask = 1;
+            LogicalProcessorMask = LogicalProcessorMask<<Processor->Number;
+            Affinity.Mask = Affinity.Mask | LogicalProcessorMask;
+            GroupMatchCount++;
+        }
+    }
+
+    //
+    //  CPU sets are preferred since they allow the system to override the
+    //  selection if processors are reserved, whereas affinity is a hard
+    //  restriction.
+    //
+
+    if (Topology->HaveCpuSets && DllKernel32.pSetThreadSelectedCpuSets != NULL) {
+        CpuSetIds = YoriLibMalloc((YORI_ALLOC_SIZE_T)(GroupMatchCount * sizeof(DWORD)));
+        if (CpuSetIds != NULL) {
+            GroupMatchCount = 0;
+            for (Index = 0; Index < Topology->ProcessorCount; Index++) {
+                Processor = &Topology->Processors[Index];
+                if (Processor->Group == TargetGroup &&
+                    YoriLibIsCpuInClass(Topology, Processor, CpuClass)) {
+
+                    CpuSetIds[GroupMatchCount] = Processor->CpuSetId;
+                    GroupMatchCount++;
+                }
+            }
+
+            Result = DllKernel32.pSetThreadSelectedCpuSets(hThread, CpuSetIds, GroupMatchCount);
+            YoriLibFree(CpuSetIds);
+            if (Result) {
+                return TRUE;
+            }
+        }
+    }
+
+    if (DllKernel32.pSetThreadGroupAffinity != NULL) {
+        if (DllKernel32.pSetThreadGroupAffinity(hThread, &Affinity, NULL)) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Determine the processor affinity that confines work to logical processors
+ suited to a class of work.  Affinity applies within a single processor
+ group, so if suitable processors span several groups, the group with the
+ most suitable processors is chosen.
+
+ @param Topology Pointer to the system topology, returned from
+        YoriLibQueryCpuTopology.
+
+ @param CpuClass The class of work.
+
+ @param Affinity On successful completion, populated with the processor
+        group and the suitable processors within it.
+
+ @return TRUE if any processor is suitable, FALSE if none are.
+ */
+__success(return)
+BOOLEAN
+YoriLibGetCpuClassAffinity(
+    __in PYORI_LIB_CPU_TOPOLOGY Topology,
+    __in YORI_LIB_CPU_CLASS CpuClass,
+    __out PYORI_PROCESSOR_GROUP_AFFINITY Affinity
+    )
+{
+    PYORI_LIB_CPU_PROCESSOR Processor;
+    DWORD Index;
+    DWORD GroupMatchCount;
+    DWORD BestMatchCount;
+    WORD Group;
+    DWORD_PTR LogicalProcessorMask;
+
+    ZeroMemory(Affinity, sizeof(YORI_PROCESSOR_GROUP_AFFINITY));
+    BestMatchCount = 0;
+    for (Group = 0; Group < Topology->GroupCount; Group++) {
+        GroupMatchCount = 0;
+        for (Index = 0; Index < Topology->ProcessorCount; Index++) {
+            Processor = &Topology->Processors[Index];
+            if (Processor->Group == Group &&
+                YoriLibIsCpuInClass(Topology, Processor, CpuClass)) {
+
+                GroupMatchCount++;
+            }
+        }
+
+        if (GroupMatchCount > BestMatchCount) {
+            BestMatchCount = GroupMatchCount;
+            Affinity->Group = Group;
+        }
+    }
+
+    if (BestMatchCount == 0) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < Topology->ProcessorCount; Index++) {
+        Processor = &Topology->Processors[Index];
+        if (Processor->Group == Affinity->Group &&
+            YoriLibIsCpuInClass(Topology, Processor, CpuClass)) {
+
+            LogicalProcessorMask = 1;
+            LogicalProcessorMask = LogicalProcessorMask<<Processor->Number;
+            Affinity->Mask = Affinity->Mask | LogicalProcessorMask;
+        }
+    }
+
+    return TRUE;
+}
+
 // vim:sw=4:ts=4:et:
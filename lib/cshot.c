@@ -28,6 +28,158 @@
 #include <yorilib.h>
 
 
+/**
+ The maximum number of cells to request from the console in a single call.
+ ReadConsoleOutput fails if it's given a large request, so requests are
+ split into blocks of whole lines no larger than this.
+ */
+#define YORI_LIB_CSHOT_READ_CELLS (0x2000)
+
+/**
+ Read a region of the console into a buffer, using as few calls as the
+ console permits.
+
+ @param hConsole Handle to the console to read from.
+
+ @param Region The region of the console buffer to read.
+
+ @param Buffer Pointer to a buffer to populate.  This must contain enough
+        cells to describe the entire region.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibReadConsoleRegion(
+    __in HANDLE hConsole,
+    __in PSMALL_RECT Region,
+    __out PCHAR_INFO Buffer
+    )
+{
+    SMALL_RECT BlockReadWindow;
+    COORD BlockBufferSize;
+    COORD BlockBufferOffset;
+    SHORT Width;
+    SHORT LinesPerBlock;
+    SHORT LineIndex;
+
+    Width = (SHORT)(Region->Right - Region->Left + 1);
+    LinesPerBlock = (SHORT)(YORI_LIB_CSHOT_READ_CELLS / Width);
+    if (LinesPerBlock == 0) {
+        LinesPerBlock = 1;
+    }
+
+    BlockBufferOffset.X = 0;
+    BlockBufferOffset.Y = 0;
+
+    for (LineIndex = Region->Top; LineIndex <= Region->Bottom; LineIndex = (SHORT)(LineIndex + LinesPerBlock)) {
+
+        BlockReadWindow.Left = Region->Left;
+        BlockReadWindow.Right = Region->Right;
+        BlockReadWindow.Top = LineIndex;
+        BlockReadWindow.Bottom = (SHORT)(LineIndex + LinesPerBlock - 1);
+        if (BlockReadWindow.Bottom > Region->Bottom) {
+            BlockReadWindow.Bottom = Region->Bottom;
+        }
+
+        BlockBufferSize.X = Width;
+        BlockBufferSize.Y = (SHORT)(BlockReadWindow.Bottom - BlockReadWindow.Top + 1);
+
+        if (!ReadConsoleOutput(hConsole, &Buffer[(LineIndex - Region->Top) * Width], BlockBufferSize, BlockBufferOffset, &BlockReadWindow)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Ensure a string has space for a number of additional characters beyond its
+ current length.
+
+ @param String The string to check.  This string may be reallocated within
+        this routine.
+
+ @param ExtraChars Specifies the number of characters that the caller intends
+        to append to the string.
+
+ @return TRUE to indicate the space is available, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCshotEnsureSpace(
+    __inout PYORI_STRING String,
+    __in DWORD ExtraChars
+    )
+{
+    DWORD BufferSizeNeeded;
+
+    BufferSizeNeeded = String->LengthInChars + ExtraChars + 1;
+    if (!YoriLibIsSizeAllocatable(BufferSizeNeeded)) {
+        return FALSE;
+    }
+
+    if (String->LengthAllocated < (YORI_ALLOC_SIZE_T)BufferSizeNeeded) {
+        if (!YoriLibReallocString(String, (YORI_ALLOC_SIZE_T)BufferSizeNeeded)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Append the text and VT escapes describing a series of console cells to a
+ string.  Escapes are only generated where the attribute changes.
+
+ @param String The string to append to.  This string may be reallocated
+        within this routine.
+
+ @param Cells Pointer to the cells to describe.
+
+ @param Count The number of cells to describe.
+
+ @param LastAttribute On input, points to the attribute currently in effect
+        on the target.  On output, updated to the attribute in effect after
+        the appended text.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibAppendVtStringForCells(
+    __inout PYORI_STRING String,
+    __in PCHAR_INFO Cells,
+    __in DWORD Count,
+    __inout PWORD LastAttribute
+    )
+{
+    DWORD CellIndex;
+    YORI_STRING EscapeString;
+
+    //
+    //  Allocate for the worst case, being an escape for every cell, so the
+    //  cells only need to be walked once
+    //
+
+    if (!YoriLibCshotEnsureSpace(String, Count * (YORI_MAX_VT_ESCAPE_CHARS + 1))) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&EscapeString);
+
+    for (CellIndex = 0; CellIndex < Count; CellIndex++) {
+        if (Cells[CellIndex].Attributes != *LastAttribute) {
+            *LastAttribute = Cells[CellIndex].Attributes;
+            EscapeString.StartOfString = &String->StartOfString[String->LengthInChars];
+            EscapeString.LengthAllocated = YORI_MAX_VT_ESCAPE_CHARS;
+            YoriLibVtStringForTextAttribute(&EscapeString, 0, *LastAttribute);
+            String->LengthInChars = String->LengthInChars + EscapeString.LengthInChars;
+        }
+        String->StartOfString[String->LengthInChars] = Cells[CellIndex].Char.UnicodeChar;
+        String->LengthInChars++;
+    }
+
+    return TRUE;
+}
+
 /**
  Read contents from the console window and send the contents to a device.
 
@@ -52,9 +204,11 @@ YoriLibRewriteConsoleContents(
     SMALL_RECT ReadWindow;
     PCHAR_INFO ReadBuffer;
     COORD ReadBufferSize;
-    COORD ReadBufferOffset;
-    DWORD LastAttribute;
+    WORD LastAttribute;
     WORD LineIndex;
+    DWORD CurrentMode;
+    BOOLEAN TargetIsConsole;
+    YORI_STRING Line;
 
     hConsole = CreateFile(_T("CONOUT$"), GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
     if (hConsole == INVALID_HANDLE_VALUE) {
@@ -98,56 +252,245 @@ YoriLibRewriteConsoleContents(
         return FALSE;
     }
 
-    ReadBufferOffset.X = 0;
-    ReadBufferOffset.Y = 0;
+    if (!YoriLibReadConsoleRegion(hConsole, &ReadWindow, ReadBuffer)) {
+        CloseHandle(hConsole);
+        YoriLibFree(ReadBuffer);
+        return FALSE;
+    }
+
+    CloseHandle(hConsole);
 
     //
-    //  ReadConsoleOutput fails if it's given a large request, so give it
-    //  a pile of small (one line) requests.
+    //  If the target is a console, it will wrap at the end of each line,
+    //  so only files need explicit line breaks.  This can't change while
+    //  generating output, so check once.
     //
 
-    for (LineIndex = 0; LineIndex < (WORD)ReadBufferSize.Y; LineIndex++) {
-        SMALL_RECT LineReadWindow;
-        COORD LineReadBufferSize;
+    TargetIsConsole = FALSE;
+    if (GetConsoleMode(hTarget, &CurrentMode)) {
+        TargetIsConsole = TRUE;
+    }
+
+    YoriLibInitEmptyString(&Line);
 
-        LineReadWindow.Left = ReadWindow.Left;
-        LineReadWindow.Right = ReadWindow.Right;
-        LineReadWindow.Top = (WORD)(ReadWindow.Top + LineIndex);
-        LineReadWindow.Bottom = LineReadWindow.Top;
+    //
+    //  Start with an attribute that differs from the first cell so the
+    //  first line begins by setting it.  Each line is generated into a
+    //  single string and written in one operation rather than one
+    //  operation per cell.
+    //
+
+    LastAttribute = (WORD)~ReadBuffer[0].Attributes;
 
-        LineReadBufferSize.X = ReadBufferSize.X;
-        LineReadBufferSize.Y = 1;
+    for (LineIndex = 0; LineIndex < (WORD)ReadBufferSize.Y; LineIndex++) {
+        Line.LengthInChars = 0;
+        if (!YoriLibAppendVtStringForCells(&Line, &ReadBuffer[LineIndex * ReadBufferSize.X], ReadBufferSize.X, &LastAttribute) ||
+            !YoriLibCshotEnsureSpace(&Line, 1)) {
 
-        if (!ReadConsoleOutput(hConsole, &ReadBuffer[LineIndex * ReadBufferSize.X], LineReadBufferSize, ReadBufferOffset, &LineReadWindow)) {
-            CloseHandle(hConsole);
+            YoriLibFreeStringContents(&Line);
             YoriLibFree(ReadBuffer);
             return FALSE;
         }
+        if (!TargetIsConsole) {
+            Line.StartOfString[Line.LengthInChars] = '\n';
+            Line.LengthInChars++;
+        }
+        YoriLibOutputString(hTarget, 0, &Line);
     }
 
-    YoriLibVtSetConsoleTextAttrDev(hTarget, 0, 0, ReadBuffer[0].Attributes);
-    LastAttribute = ReadBuffer[0].Attributes;
+    YoriLibFreeStringContents(&Line);
+    YoriLibFree(ReadBuffer);
+    return TRUE;
+}
 
-    for (ReadBufferOffset.Y = 0; ReadBufferOffset.Y < ReadBufferSize.Y; ReadBufferOffset.Y++) {
-        DWORD CurrentMode;
+/**
+ Prepare a snapshot for use with @ref YoriLibRewriteConsoleChanges .
+
+ @param Snapshot Pointer to the snapshot to initialize.
+ */
+VOID
+YoriLibInitializeConsoleSnapshot(
+    __out PYORILIB_CONSOLE_SNAPSHOT Snapshot
+    )
+{
+    ZeroMemory(Snapshot, sizeof(YORILIB_CONSOLE_SNAPSHOT));
+    YoriLibInitEmptyString(&Snapshot->Output);
+}
 
-        for (ReadBufferOffset.X = 0; ReadBufferOffset.X < ReadBufferSize.X; ReadBufferOffset.X++) {
-            DWORD CellIndex;
+/**
+ Free any allocations associated with a console snapshot.
 
-            CellIndex = ReadBufferOffset.Y * ReadBufferSize.X + ReadBufferOffset.X;
+ @param Snapshot Pointer to the snapshot to clean up.
+ */
+VOID
+YoriLibCleanupConsoleSnapshot(
+    __inout PYORILIB_CONSOLE_SNAPSHOT Snapshot
+    )
+{
+    if (Snapshot->Cells != NULL) {
+        YoriLibFree(Snapshot->Cells);
+    }
+    if (Snapshot->NewCells != NULL) {
+        YoriLibFree(Snapshot->NewCells);
+    }
+    YoriLibFreeStringContents(&Snapshot->Output);
+    YoriLibInitializeConsoleSnapshot(Snapshot);
+}
 
-            if (ReadBuffer[CellIndex].Attributes != LastAttribute) {
-                YoriLibVtSetConsoleTextAttrDev(hTarget, 0, 0, ReadBuffer[CellIndex].Attributes);
-                LastAttribute = ReadBuffer[CellIndex].Attributes;
-            }
-            YoriLibOutputToDevice(hTarget, 0, _T("%c"), ReadBuffer[CellIndex].Char.UnicodeChar);
+/**
+ Read the visible console window and send a VT stream to a device that
+ updates the device from the previous capture to the current one.  The
+ first capture, or any capture after the window changes size, repaints the
+ whole window; subsequent captures only emit rows that have changed, so
+ periodic captures of a mostly idle console generate little output.
+
+ The console provides no indication of which regions have changed, so the
+ window is still read in full each time, but reading is comparatively cheap
+ and it's the generation and writing of VT that is avoided.
+
+ @param hConsole Handle to the console to read from.
+
+ @param hTarget Handle to the target device.
+
+ @param Snapshot Pointer to the state from the previous capture.  This should
+        have been initialized with @ref YoriLibInitializeConsoleSnapshot and
+        is updated to describe this capture on success.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibRewriteConsoleChanges(
+    __in HANDLE hConsole,
+    __in HANDLE hTarget,
+    __inout PYORILIB_CONSOLE_SNAPSHOT Snapshot
+    )
+{
+    CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
+    COORD WindowSize;
+    COORD CursorPosition;
+    DWORD CellsNeeded;
+    BOOLEAN Repaint;
+    PCHAR_INFO Swap;
+    SHORT LineIndex;
+    DWORD RowOffset;
+    YORI_ALLOC_SIZE_T CharsWritten;
+
+    if (!GetConsoleScreenBufferInfo(hConsole, &ScreenInfo)) {
+        return FALSE;
+    }
+
+    WindowSize.X = (SHORT)(ScreenInfo.srWindow.Right - ScreenInfo.srWindow.Left + 1);
+    WindowSize.Y = (SHORT)(ScreenInfo.srWindow.Bottom - ScreenInfo.srWindow.Top + 1);
+    CellsNeeded = WindowSize.X * WindowSize.Y;
+
+    Repaint = FALSE;
+    if (Snapshot->Cells == NULL ||
+        WindowSize.X != Snapshot->Size.X ||
+        WindowSize.Y != Snapshot->Size.Y) {
+
+        Repaint = TRUE;
+    }
+
+    if (CellsNeeded > Snapshot->CellsAllocated) {
+        PCHAR_INFO NewCells;
+        PCHAR_INFO Cells;
+
+        Cells = YoriLibMalloc(CellsNeeded * sizeof(CHAR_INFO));
+        if (Cells == NULL) {
+            return FALSE;
         }
-        if (!GetConsoleMode(hTarget, &CurrentMode)) {
-            YoriLibOutputToDevice(hTarget, 0, _T("\n"));
+        NewCells = YoriLibMalloc(CellsNeeded * sizeof(CHAR_INFO));
+        if (NewCells == NULL) {
+            YoriLibFree(Cells);
+            return FALSE;
+        }
+
+        if (Snapshot->Cells != NULL) {
+            YoriLibFree(Snapshot->Cells);
         }
+        if (Snapshot->NewCells != NULL) {
+            YoriLibFree(Snapshot->NewCells);
+        }
+        Snapshot->Cells = Cells;
+        Snapshot->NewCells = NewCells;
+        Snapshot->CellsAllocated = CellsNeeded;
+        Repaint = TRUE;
     }
 
-    YoriLibFree(ReadBuffer);
+    if (!YoriLibReadConsoleRegion(hConsole, &ScreenInfo.srWindow, Snapshot->NewCells)) {
+        return FALSE;
+    }
+
+    Snapshot->Output.LengthInChars = 0;
+
+    //
+    //  When repainting, clear the target and start with an attribute that
+    //  differs from the first cell so it is set explicitly, since nothing
+    //  is known about the target's state.
+    //
+
+    if (Repaint) {
+        if (!YoriLibCshotEnsureSpace(&Snapshot->Output, sizeof("E[2J"))) {
+            return FALSE;
+        }
+        Snapshot->Output.LengthInChars = YoriLibSPrintf(Snapshot->Output.StartOfString, _T("%c[2J"), 27);
+        Snapshot->LastAttribute = (WORD)~Snapshot->NewCells[0].Attributes;
+    }
+
+    for (LineIndex = 0; LineIndex < WindowSize.Y; LineIndex++) {
+        RowOffset = LineIndex * WindowSize.X;
+        if (!Repaint &&
+            memcmp(&Snapshot->NewCells[RowOffset], &Snapshot->Cells[RowOffset], WindowSize.X * sizeof(CHAR_INFO)) == 0) {
+
+            continue;
+        }
+
+        if (!YoriLibCshotEnsureSpace(&Snapshot->Output, sizeof("E[99999;1H"))) {
+            return FALSE;
+        }
+        CharsWritten = YoriLibSPrintf(&Snapshot->Output.StartOfString[Snapshot->Output.LengthInChars], _T("%c[%i;1H"), 27, LineIndex + 1);
+        Snapshot->Output.LengthInChars = Snapshot->Output.LengthInChars + CharsWritten;
+
+        if (!YoriLibAppendVtStringForCells(&Snapshot->Output, &Snapshot->NewCells[RowOffset], WindowSize.X, &Snapshot->LastAttribute)) {
+            return FALSE;
+        }
+    }
+
+    //
+    //  Move the cursor if anything was drawn, since drawing moves it, or if
+    //  the console cursor has moved.
+    //
+
+    CursorPosition.X = (SHORT)(ScreenInfo.dwCursorPosition.X - ScreenInfo.srWindow.Left);
+    CursorPosition.Y = (SHORT)(ScreenInfo.dwCursorPosition.Y - ScreenInfo.srWindow.Top);
+
+    if (Snapshot->Output.LengthInChars > 0 ||
+        CursorPosition.X != Snapshot->CursorPosition.X ||
+        CursorPosition.Y != Snapshot->CursorPosition.Y) {
+
+        if (!YoriLibCshotEnsureSpace(&Snapshot->Output, sizeof("E[99999;99999H"))) {
+            return FALSE;
+        }
+        CharsWritten = YoriLibSPrintf(&Snapshot->Output.StartOfString[Snapshot->Output.LengthInChars], _T("%c[%i;%iH"), 27, CursorPosition.Y + 1, CursorPosition.X + 1);
+        Snapshot->Output.LengthInChars = Snapshot->Output.LengthInChars + CharsWritten;
+        Snapshot->CursorPosition.X = CursorPosition.X;
+        Snapshot->CursorPosition.Y = CursorPosition.Y;
+    }
+
+    if (Snapshot->Output.LengthInChars > 0) {
+        YoriLibOutputString(hTarget, 0, &Snapshot->Output);
+    }
+
+    //
+    //  The cells just read become the baseline for the next capture.
+    //
+
+    Swap = Snapshot->Cells;
+    Snapshot->Cells = Snapshot->NewCells;
+    Snapshot->NewCells = Swap;
+    Snapshot->Size.X = WindowSize.X;
+    Snapshot->Size.Y = WindowSize.Y;
+
     return TRUE;
 }
 
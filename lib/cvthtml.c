@@ -697,6 +697,25 @@ typedef struct _YORI_LIB_HTML_CONVERT_CONTEXT {
      */
     YORILIB_HTML_GENERATE_CONTEXT GenerateContext;
 
+    /**
+     If TRUE, output is not generated.  Instead, LengthNeeded is updated to
+     contain the number of characters that would be generated.
+     */
+    BOOLEAN MeasureOnly;
+
+    /**
+     When MeasureOnly is TRUE, the number of characters that would have been
+     generated so far.
+     */
+    YORI_ALLOC_SIZE_T LengthNeeded;
+
+    /**
+     When MeasureOnly is TRUE, a buffer to generate each fragment of output
+     into in order to determine its length.  This is reused for each
+     fragment.
+     */
+    YORI_STRING Scratch;
+
 } YORI_LIB_HTML_CONVERT_CONTEXT, *PYORI_LIB_HTML_CONVERT_CONTEXT;
 
 /**
@@ -737,6 +756,122 @@ YoriLibHtmlCvtAppendWithReallocate(
     return TRUE;
 }
 
+/**
+ Return a string describing the space that the next fragment of output
+ should be generated into.  When generating output, this is the unused
+ space at the end of the HTML buffer, so fragments are generated in place.
+ When measuring, this is the scratch buffer.
+
+ @param HtmlContext Pointer to the conversion context.
+
+ @param Tail On completion, updated to describe the space to generate the
+        next fragment into.  This string does not own its allocation.
+ */
+VOID
+YoriLibHtmlCvtGetTail(
+    __in PYORI_LIB_HTML_CONVERT_CONTEXT HtmlContext,
+    __out PYORI_STRING Tail
+    )
+{
+    PYORI_STRING HtmlText;
+
+    YoriLibInitEmptyString(Tail);
+    if (HtmlContext->MeasureOnly) {
+        Tail->StartOfString = HtmlContext->Scratch.StartOfString;
+        Tail->LengthAllocated = HtmlContext->Scratch.LengthAllocated;
+    } else if (HtmlContext->HtmlText->StartOfString != NULL) {
+        HtmlText = HtmlContext->HtmlText;
+        Tail->StartOfString = &HtmlText->StartOfString[HtmlText->LengthInChars];
+        Tail->LengthAllocated = HtmlText->LengthAllocated - HtmlText->LengthInChars;
+    }
+}
+
+/**
+ Ensure the space that the next fragment of output is generated into can
+ contain a specified number of characters.  This is only needed if the
+ output has not been measured in advance.
+
+ @param HtmlContext Pointer to the conversion context.
+
+ @param LengthNeeded The number of characters needed, including space for
+        a NULL terminator.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibHtmlCvtExtendTail(
+    __in PYORI_LIB_HTML_CONVERT_CONTEXT HtmlContext,
+    __in YORI_ALLOC_SIZE_T LengthNeeded
+    )
+{
+    DWORD LengthRequired;
+    YORI_ALLOC_SIZE_T AllocSize;
+
+    if (HtmlContext->MeasureOnly) {
+        YoriLibFreeStringContents(&HtmlContext->Scratch);
+        return YoriLibAllocateString(&HtmlContext->Scratch, LengthNeeded);
+    }
+
+    LengthRequired = HtmlContext->HtmlText->LengthInChars + LengthNeeded;
+    if (!YoriLibIsSizeAllocatable(LengthRequired)) {
+        return FALSE;
+    }
+    AllocSize = YoriLibMaximumAllocationInRange(LengthRequired, LengthRequired * 4);
+    return YoriLibReallocString(HtmlContext->HtmlText, AllocSize);
+}
+
+/**
+ Record a fragment of output which has been generated into the space
+ returned from YoriLibHtmlCvtGetTail.
+
+ @param HtmlContext Pointer to the conversion context.
+
+ @param Tail Pointer to the string describing the generated fragment.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibHtmlCvtCommitTail(
+    __in PYORI_LIB_HTML_CONVERT_CONTEXT HtmlContext,
+    __in PCYORI_STRING Tail
+    )
+{
+    if (HtmlContext->MeasureOnly) {
+        if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)HtmlContext->LengthNeeded + Tail->LengthInChars + 1)) {
+            return FALSE;
+        }
+        HtmlContext->LengthNeeded = HtmlContext->LengthNeeded + Tail->LengthInChars;
+    } else {
+        HtmlContext->HtmlText->LengthInChars = HtmlContext->HtmlText->LengthInChars + Tail->LengthInChars;
+    }
+    return TRUE;
+}
+
+/**
+ Append a fully formed string to the output, or account for its length if
+ the output is being measured.
+
+ @param HtmlContext Pointer to the conversion context.
+
+ @param String The string to append.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibHtmlCvtAppend(
+    __in PYORI_LIB_HTML_CONVERT_CONTEXT HtmlContext,
+    __in PYORI_STRING String
+    )
+{
+    if (HtmlContext->MeasureOnly) {
+        return YoriLibHtmlCvtCommitTail(HtmlContext, String);
+    }
+    return YoriLibHtmlCvtAppendWithReallocate(HtmlContext->HtmlText, String);
+}
+
 /**
  Indicate the beginning of a stream and perform any initial output.
 
@@ -763,7 +898,7 @@ YoriLibHtmlCnvInitializeStream(
         return FALSE;
     }
 
-    if (!YoriLibHtmlCvtAppendWithReallocate(HtmlContext->HtmlText, &OutputString)) {
+    if (!YoriLibHtmlCvtAppend(HtmlContext, &OutputString)) {
         YoriLibFreeStringContents(&OutputString);
         return FALSE;
     }
@@ -800,7 +935,7 @@ YoriLibHtmlCnvEndStream(
         return FALSE;
     }
 
-    if (!YoriLibHtmlCvtAppendWithReallocate(HtmlContext->HtmlText, &OutputString)) {
+    if (!YoriLibHtmlCvtAppend(HtmlContext, &OutputString)) {
         YoriLibFreeStringContents(&OutputString);
         return FALSE;
     }
@@ -830,36 +965,36 @@ YoriLibHtmlCnvProcessAndOutputText(
     __inout PYORI_MAX_UNSIGNED_T Context
     )
 {
-
     YORI_STRING TextString;
     YORI_ALLOC_SIZE_T BufferSizeNeeded;
     PYORI_LIB_HTML_CONVERT_CONTEXT HtmlContext = (PYORI_LIB_HTML_CONVERT_CONTEXT)hOutput;
 
     UNREFERENCED_PARAMETER(Context);
 
-    YoriLibInitEmptyString(&TextString);
-    BufferSizeNeeded = 0;
-    if (!YoriLibHtmlGenerateTextString(&TextString, &BufferSizeNeeded, String)) {
-        return FALSE;
-    }
-
-    if (!YoriLibAllocateString(&TextString, BufferSizeNeeded)) {
-        return FALSE;
-    }
+    //
+    //  Generate directly into the output buffer.  If it is too small,
+    //  extend it and generate again.
+    //
 
+    YoriLibHtmlCvtGetTail(HtmlContext, &TextString);
     BufferSizeNeeded = 0;
     if (!YoriLibHtmlGenerateTextString(&TextString, &BufferSizeNeeded, String)) {
-        YoriLibFreeStringContents(&TextString);
         return FALSE;
     }
 
-    if (!YoriLibHtmlCvtAppendWithReallocate(HtmlContext->HtmlText, &TextString)) {
-        YoriLibFreeStringContents(&TextString);
-        return FALSE;
+    if (BufferSizeNeeded > TextString.LengthAllocated) {
+        if (!YoriLibHtmlCvtExtendTail(HtmlContext, BufferSizeNeeded)) {
+            return FALSE;
+        }
+
+        YoriLibHtmlCvtGetTail(HtmlContext, &TextString);
+        BufferSizeNeeded = 0;
+        if (!YoriLibHtmlGenerateTextString(&TextString, &BufferSizeNeeded, String)) {
+            return FALSE;
+        }
     }
 
-    YoriLibFreeStringContents(&TextString);
-    return TRUE;
+    return YoriLibHtmlCvtCommitTail(HtmlContext, &TextString);
 }
 
 
@@ -887,34 +1022,41 @@ YoriLibHtmlCnvProcessAndOutputEscape(
     YORI_STRING TextString;
     YORI_ALLOC_SIZE_T BufferSizeNeeded;
     PYORI_LIB_HTML_CONVERT_CONTEXT HtmlContext = (PYORI_LIB_HTML_CONVERT_CONTEXT)hOutput;
-    YORILIB_HTML_GENERATE_CONTEXT DummyGenerateContext;
+    YORILIB_HTML_GENERATE_CONTEXT NewGenerateContext;
 
     UNREFERENCED_PARAMETER(Context);
 
-    memcpy(&DummyGenerateContext, &HtmlContext->GenerateContext, sizeof(YORILIB_HTML_GENERATE_CONTEXT));
+    //
+    //  Generate directly into the output buffer.  If it is too small,
+    //  extend it and generate again.  Generation updates state, so it is
+    //  performed on a copy which is only retained once output succeeds.
+    //
 
-    YoriLibInitEmptyString(&TextString);
+    memcpy(&NewGenerateContext, &HtmlContext->GenerateContext, sizeof(YORILIB_HTML_GENERATE_CONTEXT));
+    YoriLibHtmlCvtGetTail(HtmlContext, &TextString);
     BufferSizeNeeded = 0;
-    if (!YoriLibHtmlGenerateEscapeStringInternal(&TextString, &BufferSizeNeeded, HtmlContext->ColorTable, String, &DummyGenerateContext)) {
+    if (!YoriLibHtmlGenerateEscapeStringInternal(&TextString, &BufferSizeNeeded, HtmlContext->ColorTable, String, &NewGenerateContext)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&TextString, BufferSizeNeeded)) {
-        return FALSE;
-    }
+    if (BufferSizeNeeded > TextString.LengthAllocated) {
+        if (!YoriLibHtmlCvtExtendTail(HtmlContext, BufferSizeNeeded)) {
+            return FALSE;
+        }
 
-    BufferSizeNeeded = 0;
-    if (!YoriLibHtmlGenerateEscapeStringInternal(&TextString, &BufferSizeNeeded, HtmlContext->ColorTable, String, &HtmlContext->GenerateContext)) {
-        YoriLibFreeStringContents(&TextString);
-        return FALSE;
+        memcpy(&NewGenerateContext, &HtmlContext->GenerateContext, sizeof(YORILIB_HTML_GENERATE_CONTEXT));
+        YoriLibHtmlCvtGetTail(HtmlContext, &TextString);
+        BufferSizeNeeded = 0;
+        if (!YoriLibHtmlGenerateEscapeStringInternal(&TextString, &BufferSizeNeeded, HtmlContext->ColorTable, String, &NewGenerateContext)) {
+            return FALSE;
+        }
     }
 
-    if (!YoriLibHtmlCvtAppendWithReallocate(HtmlContext->HtmlText, &TextString)) {
-        YoriLibFreeStringContents(&TextString);
+    if (!YoriLibHtmlCvtCommitTail(HtmlContext, &TextString)) {
         return FALSE;
     }
 
-    YoriLibFreeStringContents(&TextString);
+    memcpy(&HtmlContext->GenerateContext, &NewGenerateContext, sizeof(YORILIB_HTML_GENERATE_CONTEXT));
     return TRUE;
 }
 
@@ -947,6 +1089,9 @@ YoriLibHtmlConvertToHtmlFromVt(
 {
     YORI_LIB_VT_CALLBACK_FUNCTIONS CallbackFunctions;
     YORI_LIB_HTML_CONVERT_CONTEXT HtmlContext;
+    YORI_MAX_UNSIGNED_T LengthRequired;
+    DWORD Pass;
+    BOOL Result;
     BOOL FreeColorTable = FALSE;
 
     HtmlContext.HtmlText = HtmlText;
@@ -958,44 +1103,65 @@ YoriLibHtmlConvertToHtmlFromVt(
             HtmlContext.ColorTable = YoriLibDefaultColorTable;
         }
     }
-    HtmlContext.GenerateContext.HtmlVersion = HtmlVersion;
 
     CallbackFunctions.InitializeStream = YoriLibHtmlCnvInitializeStream;
     CallbackFunctions.EndStream = YoriLibHtmlCnvEndStream;
     CallbackFunctions.ProcessAndOutputText = YoriLibHtmlCnvProcessAndOutputText;
     CallbackFunctions.ProcessAndOutputEscape = YoriLibHtmlCnvProcessAndOutputEscape;
     CallbackFunctions.Context = 0;
+    Result = TRUE;
 
-    if (!YoriLibHtmlCnvInitializeStream((HANDLE)&HtmlContext, &CallbackFunctions.Context)) {
-        if (FreeColorTable) {
-            YoriLibDereference(HtmlContext.ColorTable);
+    //
+    //  Measure the output, allocate it once, then generate it.
+    //
+
+    HtmlContext.MeasureOnly = TRUE;
+    HtmlContext.LengthNeeded = 0;
+    YoriLibInitEmptyString(&HtmlContext.Scratch);
+
+    for (Pass = 0; Pass < 2; Pass++) {
+        HtmlContext.GenerateContext.HtmlVersion = HtmlVersion;
+        if (!YoriLibHtmlCnvInitializeStream((HANDLE)&HtmlContext, &CallbackFunctions.Context) ||
+            !YoriLibProcVtEscOnOpenStream(VtText->StartOfString,
+                                          VtText->LengthInChars,
+                                          (HANDLE)&HtmlContext,
+                                          &CallbackFunctions) ||
+            !YoriLibHtmlCnvEndStream((HANDLE)&HtmlContext, &CallbackFunctions.Context)) {
+
+            Result = FALSE;
+            break;
         }
-        return FALSE;
-    }
 
-    if (!YoriLibProcVtEscOnOpenStream(VtText->StartOfString,
-                                      VtText->LengthInChars,
-                                      (HANDLE)&HtmlContext,
-                                      &CallbackFunctions)) {
+        if (HtmlContext.MeasureOnly) {
+            YoriLibFreeStringContents(&HtmlContext.Scratch);
+            HtmlContext.MeasureOnly = FALSE;
 
-        if (FreeColorTable) {
-            YoriLibDereference(HtmlContext.ColorTable);
-        }
+            //
+            //  Generating a fragment requires space for a NULL terminator
+            //  after it, and escapes request one more character than
+            //  that, so allow for this following the final fragment.
+            //
 
-        return FALSE;
-    }
+            LengthRequired = HtmlText->LengthInChars + HtmlContext.LengthNeeded + 2;
+            if (!YoriLibIsSizeAllocatable(LengthRequired)) {
+                Result = FALSE;
+                break;
+            }
+            if (HtmlText->LengthAllocated < LengthRequired &&
+                !YoriLibReallocString(HtmlText, (YORI_ALLOC_SIZE_T)LengthRequired)) {
 
-    if (!YoriLibHtmlCnvEndStream((HANDLE)&HtmlContext, &CallbackFunctions.Context)) {
-        if (FreeColorTable) {
-            YoriLibDereference(HtmlContext.ColorTable);
+                Result = FALSE;
+                break;
+            }
         }
-        return FALSE;
     }
+
+    YoriLibFreeStringContents(&HtmlContext.Scratch);
     if (FreeColorTable) {
         YoriLibDereference(HtmlContext.ColorTable);
     }
 
-    return TRUE;
+    return Result;
 }
 
 // vim:sw=4:ts=4:et:
@@ -549,6 +549,25 @@ typedef struct _YORI_LIB_RTF_CONVERT_CONTEXT {
      */
     BOOLEAN UnderlineState;
 
+    /**
+     If TRUE, output is not generated.  Instead, LengthNeeded is updated to
+     contain the number of characters that would be generated.
+     */
+    BOOLEAN MeasureOnly;
+
+    /**
+     When MeasureOnly is TRUE, the number of characters that would have been
+     generated so far.
+     */
+    YORI_ALLOC_SIZE_T LengthNeeded;
+
+    /**
+     When MeasureOnly is TRUE, a buffer to generate each fragment of output
+     into in order to determine its length.  This is reused for each
+     fragment.
+     */
+    YORI_STRING Scratch;
+
 } YORI_LIB_RTF_CONVERT_CONTEXT, *PYORI_LIB_RTF_CONVERT_CONTEXT;
 
 /**
@@ -588,6 +607,122 @@ YoriLibRtfCvtAppendWithReallocate(
     return TRUE;
 }
 
+/**
+ Return a string describing the space that the next fragment of output
+ should be generated into.  When generating output, this is the unused
+ space at the end of the RTF buffer, so fragments are generated in place.
+ When measuring, this is the scratch buffer.
+
+ @param RtfContext Pointer to the conversion context.
+
+ @param Tail On completion, updated to describe the space to generate the
+        next fragment into.  This string does not own its allocation.
+ */
+VOID
+YoriLibRtfCvtGetTail(
+    __in PYORI_LIB_RTF_CONVERT_CONTEXT RtfContext,
+    __out PYORI_STRING Tail
+    )
+{
+    PYORI_STRING RtfText;
+
+    YoriLibInitEmptyString(Tail);
+    if (RtfContext->MeasureOnly) {
+        Tail->StartOfString = RtfContext->Scratch.StartOfString;
+        Tail->LengthAllocated = RtfContext->Scratch.LengthAllocated;
+    } else if (RtfContext->RtfText->StartOfString != NULL) {
+        RtfText = RtfContext->RtfText;
+        Tail->StartOfString = &RtfText->StartOfString[RtfText->LengthInChars];
+        Tail->LengthAllocated = RtfText->LengthAllocated - RtfText->LengthInChars;
+    }
+}
+
+/**
+ Ensure the space that the next fragment of output is generated into can
+ contain a specified number of characters.  This is only needed if the
+ output has not been measured in advance.
+
+ @param RtfContext Pointer to the conversion context.
+
+ @param LengthNeeded The number of characters needed, including space for
+        a NULL terminator.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRtfCvtExtendTail(
+    __in PYORI_LIB_RTF_CONVERT_CONTEXT RtfContext,
+    __in YORI_ALLOC_SIZE_T LengthNeeded
+    )
+{
+    DWORD LengthRequired;
+    YORI_ALLOC_SIZE_T AllocSize;
+
+    if (RtfContext->MeasureOnly) {
+        YoriLibFreeStringContents(&RtfContext->Scratch);
+        return YoriLibAllocateString(&RtfContext->Scratch, LengthNeeded);
+    }
+
+    LengthRequired = RtfContext->RtfText->LengthInChars + LengthNeeded;
+    if (!YoriLibIsSizeAllocatable(LengthRequired)) {
+        return FALSE;
+    }
+    AllocSize = YoriLibMaximumAllocationInRange(LengthRequired, LengthRequired * 4);
+    return YoriLibReallocString(RtfContext->RtfText, AllocSize);
+}
+
+/**
+ Record a fragment of output which has been generated into the space
+ returned from YoriLibRtfCvtGetTail.
+
+ @param RtfContext Pointer to the conversion context.
+
+ @param Tail Pointer to the string describing the generated fragment.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRtfCvtCommitTail(
+    __in PYORI_LIB_RTF_CONVERT_CONTEXT RtfContext,
+    __in PCYORI_STRING Tail
+    )
+{
+    if (RtfContext->MeasureOnly) {
+        if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)RtfContext->LengthNeeded + Tail->LengthInChars + 1)) {
+            return FALSE;
+        }
+        RtfContext->LengthNeeded = RtfContext->LengthNeeded + Tail->LengthInChars;
+    } else {
+        RtfContext->RtfText->LengthInChars = RtfContext->RtfText->LengthInChars + Tail->LengthInChars;
+    }
+    return TRUE;
+}
+
+/**
+ Append a fully formed string to the output, or account for its length if
+ the output is being measured.
+
+ @param RtfContext Pointer to the conversion context.
+
+ @param String The string to append.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRtfCvtAppend(
+    __in PYORI_LIB_RTF_CONVERT_CONTEXT RtfContext,
+    __in PYORI_STRING String
+    )
+{
+    if (RtfContext->MeasureOnly) {
+        return YoriLibRtfCvtCommitTail(RtfContext, String);
+    }
+    return YoriLibRtfCvtAppendWithReallocate(RtfContext->RtfText, String);
+}
+
 /**
  Indicate the beginning of a stream and perform any initial output.
 
@@ -614,7 +749,7 @@ YoriLibRtfCnvInitializeStream(
         return FALSE;
     }
 
-    if (!YoriLibRtfCvtAppendWithReallocate(RtfContext->RtfText, &OutputString)) {
+    if (!YoriLibRtfCvtAppend(RtfContext, &OutputString)) {
         YoriLibFreeStringContents(&OutputString);
         return FALSE;
     }
@@ -650,7 +785,7 @@ YoriLibRtfCnvEndStream(
         return FALSE;
     }
 
-    if (!YoriLibRtfCvtAppendWithReallocate(RtfContext->RtfText, &OutputString)) {
+    if (!YoriLibRtfCvtAppend(RtfContext, &OutputString)) {
         YoriLibFreeStringContents(&OutputString);
         return FALSE;
     }
@@ -680,36 +815,36 @@ YoriLibRtfCnvProcessAndOutputText(
     __inout PYORI_MAX_UNSIGNED_T Context
     )
 {
-
     YORI_STRING TextString;
     YORI_ALLOC_SIZE_T BufferSizeNeeded;
     PYORI_LIB_RTF_CONVERT_CONTEXT RtfContext = (PYORI_LIB_RTF_CONVERT_CONTEXT)hOutput;
 
     UNREFERENCED_PARAMETER(Context);
 
-    YoriLibInitEmptyString(&TextString);
-    BufferSizeNeeded = 0;
-    if (!YoriLibRtfGenerateTextString(&TextString, &BufferSizeNeeded, String)) {
-        return FALSE;
-    }
-
-    if (!YoriLibAllocateString(&TextString, BufferSizeNeeded)) {
-        return FALSE;
-    }
+    //
+    //  Generate directly into the output buffer.  If it is too small,
+    //  extend it and generate again.
+    //
 
+    YoriLibRtfCvtGetTail(RtfContext, &TextString);
     BufferSizeNeeded = 0;
     if (!YoriLibRtfGenerateTextString(&TextString, &BufferSizeNeeded, String)) {
-        YoriLibFreeStringContents(&TextString);
         return FALSE;
     }
 
-    if (!YoriLibRtfCvtAppendWithReallocate(RtfContext->RtfText, &TextString)) {
-        YoriLibFreeStringContents(&TextString);
-        return FALSE;
+    if (BufferSizeNeeded > TextString.LengthAllocated) {
+        if (!YoriLibRtfCvtExtendTail(RtfContext, BufferSizeNeeded)) {
+            return FALSE;
+        }
+
+        YoriLibRtfCvtGetTail(RtfContext, &TextString);
+        BufferSizeNeeded = 0;
+        if (!YoriLibRtfGenerateTextString(&TextString, &BufferSizeNeeded, String)) {
+            return FALSE;
+        }
     }
 
-    YoriLibFreeStringContents(&TextString);
-    return TRUE;
+    return YoriLibRtfCvtCommitTail(RtfContext, &TextString);
 }
 
 
@@ -736,33 +871,41 @@ YoriLibRtfCnvProcessAndOutputEscape(
     YORI_STRING TextString;
     YORI_ALLOC_SIZE_T BufferSizeNeeded;
     PYORI_LIB_RTF_CONVERT_CONTEXT RtfContext = (PYORI_LIB_RTF_CONVERT_CONTEXT)hOutput;
-    BOOLEAN DummyUnderlineState;
+    BOOLEAN NewUnderlineState;
 
     UNREFERENCED_PARAMETER(Context);
 
-    YoriLibInitEmptyString(&TextString);
+    //
+    //  Generate directly into the output buffer.  If it is too small,
+    //  extend it and generate again.  Generation updates state, so it is
+    //  performed on a copy which is only retained once output succeeds.
+    //
+
+    NewUnderlineState = RtfContext->UnderlineState;
+    YoriLibRtfCvtGetTail(RtfContext, &TextString);
     BufferSizeNeeded = 0;
-    DummyUnderlineState = RtfContext->UnderlineState;
-    if (!YoriLibRtfGenerateEscapeString(&TextString, &BufferSizeNeeded, String, &DummyUnderlineState)) {
+    if (!YoriLibRtfGenerateEscapeString(&TextString, &BufferSizeNeeded, String, &NewUnderlineState)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&TextString, BufferSizeNeeded)) {
-        return FALSE;
-    }
+    if (BufferSizeNeeded > TextString.LengthAllocated) {
+        if (!YoriLibRtfCvtExtendTail(RtfContext, BufferSizeNeeded)) {
+            return FALSE;
+        }
 
-    BufferSizeNeeded = 0;
-    if (!YoriLibRtfGenerateEscapeString(&TextString, &BufferSizeNeeded, String, &RtfContext->UnderlineState)) {
-        YoriLibFreeStringContents(&TextString);
-        return FALSE;
+        NewUnderlineState = RtfContext->UnderlineState;
+        YoriLibRtfCvtGetTail(RtfContext, &TextString);
+        BufferSizeNeeded = 0;
+        if (!YoriLibRtfGenerateEscapeString(&TextString, &BufferSizeNeeded, String, &NewUnderlineState)) {
+            return FALSE;
+        }
     }
 
-    if (!YoriLibRtfCvtAppendWithReallocate(RtfContext->RtfText, &TextString)) {
-        YoriLibFreeStringContents(&TextString);
+    if (!YoriLibRtfCvtCommitTail(RtfContext, &TextString)) {
         return FALSE;
     }
 
-    YoriLibFreeStringContents(&TextString);
+    RtfContext->UnderlineState = NewUnderlineState;
     return TRUE;
 }
 
@@ -791,6 +934,9 @@ YoriLibRtfConvertToRtfFromVt(
 {
     YORI_LIB_VT_CALLBACK_FUNCTIONS CallbackFunctions;
     YORI_LIB_RTF_CONVERT_CONTEXT RtfContext;
+    YORI_MAX_UNSIGNED_T LengthRequired;
+    DWORD Pass;
+    BOOL Result;
     BOOL FreeColorTable = FALSE;
 
     RtfContext.RtfText = RtfText;
@@ -802,43 +948,65 @@ YoriLibRtfConvertToRtfFromVt(
             RtfContext.ColorTable = YoriLibDefaultColorTable;
         }
     }
-    RtfContext.UnderlineState = FALSE;
 
     CallbackFunctions.InitializeStream = YoriLibRtfCnvInitializeStream;
     CallbackFunctions.EndStream = YoriLibRtfCnvEndStream;
     CallbackFunctions.ProcessAndOutputText = YoriLibRtfCnvProcessAndOutputText;
     CallbackFunctions.ProcessAndOutputEscape = YoriLibRtfCnvProcessAndOutputEscape;
     CallbackFunctions.Context = 0;
+    Result = TRUE;
 
-    if (!YoriLibRtfCnvInitializeStream((HANDLE)&RtfContext, &CallbackFunctions.Context)) {
-        if (FreeColorTable) {
-            YoriLibDereference(RtfContext.ColorTable);
+    //
+    //  Measure the output, allocate it once, then generate it.
+    //
+
+    RtfContext.MeasureOnly = TRUE;
+    RtfContext.LengthNeeded = 0;
+    YoriLibInitEmptyString(&RtfContext.Scratch);
+
+    for (Pass = 0; Pass < 2; Pass++) {
+        RtfContext.UnderlineState = FALSE;
+        if (!YoriLibRtfCnvInitializeStream((HANDLE)&RtfContext, &CallbackFunctions.Context) ||
+            !YoriLibProcVtEscOnOpenStream(VtText->StartOfString,
+                                          VtText->LengthInChars,
+                                          (HANDLE)&RtfContext,
+                                          &CallbackFunctions) ||
+            !YoriLibRtfCnvEndStream((HANDLE)&RtfContext, &CallbackFunctions.Context)) {
+
+            Result = FALSE;
+            break;
         }
-        return FALSE;
-    }
 
-    if (!YoriLibProcVtEscOnOpenStream(VtText->StartOfString,
-                                      VtText->LengthInChars,
-                                      (HANDLE)&RtfContext,
-                                      &CallbackFunctions)) {
+        if (RtfContext.MeasureOnly) {
+            YoriLibFreeStringContents(&RtfContext.Scratch);
+            RtfContext.MeasureOnly = FALSE;
 
-        if (FreeColorTable) {
-            YoriLibDereference(RtfContext.ColorTable);
-        }
-        return FALSE;
-    }
+            //
+            //  Generating a fragment requires space for a NULL terminator
+            //  after it, and escapes request one more character than
+            //  that, so allow for this following the final fragment.
+            //
 
-    if (!YoriLibRtfCnvEndStream((HANDLE)&RtfContext, &CallbackFunctions.Context)) {
-        if (FreeColorTable) {
-            YoriLibDereference(RtfContext.ColorTable);
+            LengthRequired = RtfText->LengthInChars + RtfContext.LengthNeeded + 2;
+            if (!YoriLibIsSizeAllocatable(LengthRequired)) {
+                Result = FALSE;
+                break;
+            }
+            if (RtfText->LengthAllocated < LengthRequired &&
+                !YoriLibReallocString(RtfText, (YORI_ALLOC_SIZE_T)LengthRequired)) {
+
+                Result = FALSE;
+                break;
+            }
         }
-        return FALSE;
     }
 
+    YoriLibFreeStringContents(&RtfContext.Scratch);
     if (FreeColorTable) {
         YoriLibDereference(RtfContext.ColorTable);
     }
-    return TRUE;
+
+    return Result;
 }
 
 // vim:sw=4:ts=4:et:
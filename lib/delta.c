@@ -0,0 +1,898 @@
+/**
+ * @file lib/delta.c
+ *
+ * Yori binary delta creation and application
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The signature at the start of every delta file, 'YDLT'.
+ */
+#define YORI_LIB_DELTA_SIGNATURE (0x544C4459)
+
+/**
+ The version of the delta format generated and understood by this code.
+ */
+#define YORI_LIB_DELTA_VERSION (1)
+
+/**
+ The size of a block of the source file that is indexed when creating a
+ delta.  Matches shorter than this are not found.
+ */
+#define YORI_LIB_DELTA_BLOCK_SIZE (32)
+
+/**
+ The multiplier used by the rolling hash over a block.
+ */
+#define YORI_LIB_DELTA_HASH_MULTIPLIER (0x01000193)
+
+/**
+ The maximum number of slots to examine in the block index when inserting
+ or looking up a hash.
+ */
+#define YORI_LIB_DELTA_MAX_PROBES (8)
+
+/**
+ The size of buffers used when reading and writing files.
+ */
+#define YORI_LIB_DELTA_BUFFER_SIZE (64 * 1024)
+
+/**
+ An operation indicating the end of the delta.
+ */
+#define YORI_LIB_DELTA_OP_END    (0)
+
+/**
+ An operation indicating a range of the source file should be copied to the
+ target file.
+ */
+#define YORI_LIB_DELTA_OP_COPY   (1)
+
+/**
+ An operation indicating the bytes that follow in the delta should be
+ written to the target file.
+ */
+#define YORI_LIB_DELTA_OP_INSERT (2)
+
+/**
+ The header at the start of a delta file.  This describes the file the delta
+ applies to and the file that results from applying it, so each can be
+ verified.
+ */
+typedef struct _YORI_LIB_DELTA_HEADER {
+
+    /**
+     Set to YORI_LIB_DELTA_SIGNATURE.
+     */
+    DWORD Signature;
+
+    /**
+     Set to YORI_LIB_DELTA_VERSION.
+     */
+    DWORD Version;
+
+    /**
+     The size of the file the delta applies to, in bytes.
+     */
+    DWORDLONG SourceSize;
+
+    /**
+     The XXH64 hash of the file the delta applies to.
+     */
+    DWORDLONG SourceHash;
+
+    /**
+     The size of the file generated by applying the delta, in bytes.
+     */
+    DWORDLONG TargetSize;
+
+    /**
+     The XXH64 hash of the file generated by applying the delta.
+     */
+    DWORDLONG TargetHash;
+} YORI_LIB_DELTA_HEADER, *PYORI_LIB_DELTA_HEADER;
+
+/**
+ A single operation in a delta file.  These follow the header until an
+ operation of YORI_LIB_DELTA_OP_END is found.
+ */
+typedef struct _YORI_LIB_DELTA_OP {
+
+    /**
+     The type of the operation, one of the YORI_LIB_DELTA_OP values.
+     */
+    DWORD Op;
+
+    /**
+     The number of bytes to write to the target file.  For an insert
+     operation, this many bytes follow the operation in the delta file.
+     */
+    DWORD Length;
+
+    /**
+     For a copy operation, the offset in the source file to copy from.
+     */
+    DWORDLONG SourceOffset;
+} YORI_LIB_DELTA_OP, *PYORI_LIB_DELTA_OP;
+
+/**
+ A buffered writer used to generate a delta file.
+ */
+typedef struct _YORI_LIB_DELTA_WRITER {
+
+    /**
+     Handle to the file being written.
+     */
+    HANDLE hFile;
+
+    /**
+     Buffer of data not yet written to the file.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The number of bytes in Buffer.
+     */
+    DWORD BytesBuffered;
+
+    /**
+     Set to FALSE if any write has failed.
+     */
+    BOOL Success;
+} YORI_LIB_DELTA_WRITER, *PYORI_LIB_DELTA_WRITER;
+
+/**
+ Write any buffered data to the delta file.
+
+ @param Writer Pointer to the writer.
+ */
+VOID
+YoriLibDeltaFlush(
+    __inout PYORI_LIB_DELTA_WRITER Writer
+    )
+{
+    DWORD BytesWritten;
+
+    if (Writer->BytesBuffered > 0) {
+        if (!WriteFile(Writer->hFile, Writer->Buffer, Writer->BytesBuffered, &BytesWritten, NULL) ||
+            BytesWritten != Writer->BytesBuffered) {
+
+            Writer->Success = FALSE;
+        }
+        Writer->BytesBuffered = 0;
+    }
+}
+
+/**
+ Append data to the delta file.
+
+ @param Writer Pointer to the writer.
+
+ @param Data Pointer to the data to write.
+
+ @param Length The number of bytes to write.
+ */
+VOID
+YoriLibDeltaWrite(
+    __inout PYORI_LIB_DELTA_WRITER Writer,
+    __in_ecount(Length) CONST UCHAR * Data,
+    __in DWORD Length
+    )
+{
+    DWORD BytesThisPass;
+
+    while (Length > 0) {
+        if (Writer->BytesBuffered == YORI_LIB_DELTA_BUFFER_SIZE) {
+            YoriLibDeltaFlush(Writer);
+        }
+
+        BytesThisPass = YORI_LIB_DELTA_BUFFER_SIZE - Writer->BytesBuffered;
+        if (BytesThisPass > Length) {
+            BytesThisPass = Length;
+        }
+
+        memcpy(&Writer->Buffer[Writer->BytesBuffered], Data, BytesThisPass);
+        Writer->BytesBuffered = Writer->BytesBuffered + BytesThisPass;
+        Data = Data + BytesThisPass;
+        Length = Length - BytesThisPass;
+    }
+}
+
+/**
+ Append an operation to the delta file.
+
+ @param Writer Pointer to the writer.
+
+ @param Op The type of the operation.
+
+ @param Length The number of bytes the operation writes to the target.
+
+ @param SourceOffset For a copy, the offset in the source to copy from.
+
+ @param Data For an insert, pointer to the bytes to insert.
+ */
+VOID
+YoriLibDeltaWriteOp(
+    __inout PYORI_LIB_DELTA_WRITER Writer,
+    __in DWORD Op,
+    __in DWORD Length,
+    __in DWORDLONG SourceOffset,
+    __in_opt CONST UCHAR * Data
+    )
+{
+    YORI_LIB_DELTA_OP DeltaOp;
+
+    DeltaOp.Op = Op;
+    DeltaOp.Length = Length;
+    DeltaOp.SourceOffset = SourceOffset;
+    YoriLibDeltaWrite(Writer, (CONST UCHAR *)&DeltaOp, sizeof(DeltaOp));
+    if (Op == YORI_LIB_DELTA_OP_INSERT && Data != NULL) {
+        YoriLibDeltaWrite(Writer, Data, Length);
+    }
+}
+
+/**
+ Load the entire contents of a file into memory.
+
+ @param FileName Pointer to the name of the file to load.  This must be NULL
+        terminated.
+
+ @param Buffer On successful completion, updated to point to a newly
+        allocated buffer containing the file contents.  The caller should
+        free this with @ref YoriLibFree .
+
+ @param Length On successful completion, updated to contain the number of
+        bytes in the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibDeltaLoadFile(
+    __in PCYORI_STRING FileName,
+    __out PUCHAR * Buffer,
+    __out PDWORD Length
+    )
+{
+    HANDLE hFile;
+    DWORD FileSizeHigh;
+    DWORD FileSize;
+    DWORD BytesRead;
+    DWORD Offset;
+    PUCHAR Data;
+
+    hFile = CreateFile(FileName->StartOfString,
+                       GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_FLAG_SEQUENTIAL_SCAN,
+                       NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    FileSize = GetFileSize(hFile, &FileSizeHigh);
+    if ((FileSize == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) ||
+        FileSizeHigh != 0 ||
+        !YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)FileSize + 1)) {
+
+        CloseHandle(hFile);
+        return FALSE;
+    }
+
+    Data = YoriLibMalloc((YORI_ALLOC_SIZE_T)(FileSize + 1));
+    if (Data == NULL) {
+        CloseHandle(hFile);
+        return FALSE;
+    }
+
+    Offset = 0;
+    while (Offset < FileSize) {
+        if (!ReadFile(hFile, &Data[Offset], FileSize - Offset, &BytesRead, NULL) ||
+            BytesRead == 0) {
+
+            YoriLibFree(Data);
+            CloseHandle(hFile);
+            return FALSE;
+        }
+        Offset = Offset + BytesRead;
+    }
+
+    CloseHandle(hFile);
+    *Buffer = Data;
+    *Length = FileSize;
+    return TRUE;
+}
+
+/**
+ Calculate the rolling hash of a block of data.
+
+ @param Data Pointer to YORI_LIB_DELTA_BLOCK_SIZE bytes of data.
+
+ @return The hash of the block.
+ */
+DWORD
+YoriLibDeltaHashBlock(
+    __in CONST UCHAR * Data
+    )
+{
+    DWORD Hash;
+    DWORD Index;
+
+    Hash = 0;
+    for (Index = 0; Index < YORI_LIB_DELTA_BLOCK_SIZE; Index++) {
+        Hash = Hash * YORI_LIB_DELTA_HASH_MULTIPLIER + Data[Index];
+    }
+    return Hash;
+}
+
+/**
+ Convert a rolling hash into a slot in the block index.
+
+ @param Hash The rolling hash of a block.
+
+ @param SlotMask One less than the number of slots in the index, which is a
+        power of two.
+
+ @return The first slot to examine for the hash.
+ */
+DWORD
+YoriLibDeltaHashToSlot(
+    __in DWORD Hash,
+    __in DWORD SlotMask
+    )
+{
+    Hash = Hash ^ (Hash >> 15);
+    Hash = Hash * 0x2C1B3C6D;
+    Hash = Hash ^ (Hash >> 12);
+    return Hash & SlotMask;
+}
+
+/**
+ Calculate the size and hash of a file, which are used to identify the file
+ that a delta applies to.
+
+ @param FileName Pointer to the name of the file.  This must be NULL
+        terminated.
+
+ @param FileSize On successful completion, updated to contain the size of
+        the file in bytes.
+
+ @param Hash On successful completion, updated to contain the XXH64 hash of
+        the file contents.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibDeltaHashFile(
+    __in PCYORI_STRING FileName,
+    __out PDWORDLONG FileSize,
+    __out PDWORDLONG Hash
+    )
+{
+    HANDLE hFile;
+    PUCHAR Buffer;
+    DWORD BytesRead;
+    DWORDLONG TotalBytes;
+    YORI_LIB_XXHASH64_STATE State;
+    BOOL Result;
+
+    ASSERT(YoriLibIsStringNullTerminated(FileName));
+
+    hFile = CreateFile(FileName->StartOfString,
+                       GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_FLAG_SEQUENTIAL_SCAN,
+                       NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc(YORI_LIB_DELTA_BUFFER_SIZE);
+    if (Buffer == NULL) {
+        CloseHandle(hFile);
+        return FALSE;
+    }
+
+    YoriLibXxHash64Initialize(&State, 0);
+    TotalBytes = 0;
+    Result = FALSE;
+
+    while (TRUE) {
+        if (!ReadFile(hFile, Buffer, YORI_LIB_DELTA_BUFFER_SIZE, &BytesRead, NULL)) {
+            break;
+        }
+
+        if (BytesRead == 0) {
+            Result = TRUE;
+            break;
+        }
+
+        YoriLibXxHash64Update(&State, Buffer, (YORI_ALLOC_SIZE_T)BytesRead);
+        TotalBytes = TotalBytes + BytesRead;
+    }
+
+    YoriLibFree(Buffer);
+    CloseHandle(hFile);
+
+    if (Result) {
+        *FileSize = TotalBytes;
+        *Hash = YoriLibXxHash64Finalize(&State);
+    }
+
+    return Result;
+}
+
+/**
+ Create a delta which can be applied to one file to generate another.  The
+ source file is indexed in fixed size blocks, then the target is scanned
+ with a rolling hash to find regions that can be copied from the source.
+ Anything else is stored in the delta verbatim.
+
+ @param SourceFile Pointer to the name of the older file that the delta will
+        be applied to.  This must be NULL terminated.
+
+ @param TargetFile Pointer to the name of the newer file that applying the
+        delta should generate.  This must be NULL terminated.
+
+ @param DeltaFile Pointer to the name of the delta file to create.  This
+        must be NULL terminated.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibCreateDelta(
+    __in PCYORI_STRING SourceFile,
+    __in PCYORI_STRING TargetFile,
+    __in PCYORI_STRING DeltaFile
+    )
+{
+    PUCHAR Source;
+    PUCHAR Target;
+    DWORD SourceLength;
+    DWORD TargetLength;
+    PDWORD Slots;
+    DWORD SlotCount;
+    DWORD SlotMask;
+    DWORD Slot;
+    DWORD Probe;
+    DWORD BlockCount;
+    DWORD Block;
+    DWORD Hash;
+    DWORD HighPower;
+    DWORD Index;
+    DWORD LiteralStart;
+    DWORD MatchSource;
+    DWORD MatchTarget;
+    DWORD MatchLength;
+    DWORD Candidate;
+    YORI_LIB_DELTA_HEADER Header;
+    YORI_LIB_DELTA_WRITER Writer;
+    YORI_LIB_XXHASH64_STATE State;
+    BOOL Result;
+
+    ASSERT(YoriLibIsStringNullTerminated(SourceFile));
+    ASSERT(YoriLibIsStringNullTerminated(TargetFile));
+    ASSERT(YoriLibIsStringNullTerminated(DeltaFile));
+
+    Source = NULL;
+    Target = NULL;
+    Slots = NULL;
+    Result = FALSE;
+    ZeroMemory(&Writer, sizeof(Writer));
+    Writer.hFile = INVALID_HANDLE_VALUE;
+
+    if (!YoriLibDeltaLoadFile(SourceFile, &Source, &SourceLength)) {
+        goto Exit;
+    }
+
+    if (!YoriLibDeltaLoadFile(TargetFile, &Target, &TargetLength)) {
+        goto Exit;
+    }
+
+    //
+    //  Index every whole block in the source.  The index is open addressed
+    //  with at least twice as many slots as blocks, and each slot holds a
+    //  block number plus one so that zero indicates an empty slot.  If a
+    //  hash is very common, later blocks with it are simply not indexed.
+    //
+
+    BlockCount = SourceLength / YORI_LIB_DELTA_BLOCK_SIZE;
+    SlotCount = 16;
+    while (SlotCount < BlockCount * 2) {
+        SlotCount = SlotCount * 2;
+        if (SlotCount == 0 || !YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)SlotCount * sizeof(DWORD))) {
+            goto Exit;
+        }
+    }
+    SlotMask = SlotCount - 1;
+
+    Slots = YoriLibMalloc((YORI_ALLOC_SIZE_T)(SlotCount * sizeof(DWORD)));
+    if (Slots == NULL) {
+        goto Exit;
+    }
+    ZeroMemory(Slots, SlotCount * sizeof(DWORD));
+
+    for (Block = 0; Block < BlockCount; Block++) {
+        Hash = YoriLibDeltaHashBlock(&Source[Block * YORI_LIB_DELTA_BLOCK_SIZE]);
+        Slot = YoriLibDeltaHashToSlot(Hash, SlotMask);
+        for (Probe = 0; Probe < YORI_LIB_DELTA_MAX_PROBES; Probe++) {
+            if (Slots[Slot] == 0) {
+                Slots[Slot] = Block + 1;
+                break;
+            }
+            Slot = (Slot + 1) & SlotMask;
+        }
+    }
+
+    Writer.Buffer = YoriLibMalloc(YORI_LIB_DELTA_BUFFER_SIZE);
+    if (Writer.Buffer == NULL) {
+        goto Exit;
+    }
+
+    Writer.hFile = CreateFile(DeltaFile->StartOfString,
+                              GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_DELETE,
+                              NULL,
+                              CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL,
+                              NULL);
+
+    if (Writer.hFile == INVALID_HANDLE_VALUE) {
+        goto Exit;
+    }
+    Writer.Success = TRUE;
+
+    ZeroMemory(&Header, sizeof(Header));
+    Header.Signature = YORI_LIB_DELTA_SIGNATURE;
+    Header.Version = YORI_LIB_DELTA_VERSION;
+    Header.SourceSize = SourceLength;
+    Header.TargetSize = TargetLength;
+    YoriLibXxHash64Initialize(&State, 0);
+    YoriLibXxHash64Update(&State, Source, (YORI_ALLOC_SIZE_T)SourceLength);
+    Header.SourceHash = YoriLibXxHash64Finalize(&State);
+    YoriLibXxHash64Initialize(&State, 0);
+    YoriLibXxHash64Update(&State, Target, (YORI_ALLOC_SIZE_T)TargetLength);
+    Header.TargetHash = YoriLibXxHash64Finalize(&State);
+    YoriLibDeltaWrite(&Writer, (CONST UCHAR *)&Header, sizeof(Header));
+
+    //
+    //  HighPower is the contribution of the byte leaving the window, used
+    //  to roll the hash forward one byte at a time.
+    //
+
+    HighPower = 1;
+    for (Index = 1; Index < YORI_LIB_DELTA_BLOCK_SIZE; Index++) {
+        HighPower = HighPower * YORI_LIB_DELTA_HASH_MULTIPLIER;
+    }
+
+    LiteralStart = 0;
+    Index = 0;
+    Hash = 0;
+    if (BlockCount > 0 && TargetLength >= YORI_LIB_DELTA_BLOCK_SIZE) {
+        Hash = YoriLibDeltaHashBlock(Target);
+    }
+
+    while (BlockCount > 0 && Index + YORI_LIB_DELTA_BLOCK_SIZE <= TargetLength) {
+
+        Candidate = 0;
+        Slot = YoriLibDeltaHashToSlot(Hash, SlotMask);
+        for (Probe = 0; Probe < YORI_LIB_DELTA_MAX_PROBES && Slots[Slot] != 0; Probe++) {
+            Block = Slots[Slot] - 1;
+            if (memcmp(&Source[Block * YORI_LIB_DELTA_BLOCK_SIZE], &Target[Index], YORI_LIB_DELTA_BLOCK_SIZE) == 0) {
+                Candidate = Slots[Slot];
+                break;
+            }
+            Slot = (Slot + 1) & SlotMask;
+        }
+
+        if (Candidate == 0) {
+            if (Index + YORI_LIB_DELTA_BLOCK_SIZE < TargetLength) {
+                Hash = (Hash - Target[Index] * HighPower) * YORI_LIB_DELTA_HASH_MULTIPLIER + Target[Index + YORI_LIB_DELTA_BLOCK_SIZE];
+            }
+            Index++;
+            continue;
+        }
+
+        //
+        //  Extend the match backwards into any pending literal data and
+        //  forwards as far as the two files agree.
+        //
+
+        MatchSource = (Candidate - 1) * YORI_LIB_DELTA_BLOCK_SIZE;
+        MatchTarget = Index;
+        while (MatchTarget > LiteralStart &&
+               MatchSource > 0 &&
+               Target[MatchTarget - 1] == Source[MatchSource - 1]) {
+
+            MatchTarget--;
+            MatchSource--;
+        }
+
+        MatchLength = Index - MatchTarget + YORI_LIB_DELTA_BLOCK_SIZE;
+        while (MatchTarget + MatchLength < TargetLength &&
+               MatchSource + MatchLength < SourceLength &&
+               Target[MatchTarget + MatchLength] == Source[MatchSource + MatchLength]) {
+
+            MatchLength++;
+        }
+
+        if (MatchTarget > LiteralStart) {
+            YoriLibDeltaWriteOp(&Writer, YORI_LIB_DELTA_OP_INSERT, MatchTarget - LiteralStart, 0, &Target[LiteralStart]);
+        }
+        YoriLibDeltaWriteOp(&Writer, YORI_LIB_DELTA_OP_COPY, MatchLength, MatchSource, NULL);
+
+        Index = MatchTarget + MatchLength;
+        LiteralStart = Index;
+        if (Index + YORI_LIB_DELTA_BLOCK_SIZE <= TargetLength) {
+            Hash = YoriLibDeltaHashBlock(&Target[Index]);
+        }
+    }
+
+    if (TargetLength > LiteralStart) {
+        YoriLibDeltaWriteOp(&Writer, YORI_LIB_DELTA_OP_INSERT, TargetLength - LiteralStart, 0, &Target[LiteralStart]);
+    }
+    YoriLibDeltaWriteOp(&Writer, YORI_LIB_DELTA_OP_END, 0, 0, NULL);
+    YoriLibDeltaFlush(&Writer);
+
+    Result = Writer.Success;
+
+Exit:
+
+    if (Writer.hFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(Writer.hFile);
+        if (!Result) {
+            DeleteFile(DeltaFile->StartOfString);
+        }
+    }
+
+    if (Writer.Buffer != NULL) {
+        YoriLibFree(Writer.Buffer);
+    }
+
+    if (Slots != NULL) {
+        YoriLibFree(Slots);
+    }
+
+    if (Target != NULL) {
+        YoriLibFree(Target);
+    }
+
+    if (Source != NULL) {
+        YoriLibFree(Source);
+    }
+
+    return Result;
+}
+
+/**
+ Apply a delta to a file to generate a new file.  The source file is checked
+ against the size and hash recorded in the delta before anything is written,
+ and the generated file is checked against the expected size and hash.
+
+ @param SourceFile Pointer to the name of the file to apply the delta to.
+        This must be NULL terminated.
+
+ @param DeltaFile Pointer to the name of the delta file.  This must be NULL
+        terminated.
+
+ @param TargetFile Pointer to the name of the file to generate.  This must
+        be NULL terminated.  If the delta cannot be applied, this file is
+        deleted.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibApplyDelta(
+    __in PCYORI_STRING SourceFile,
+    __in PCYORI_STRING DeltaFile,
+    __in PCYORI_STRING TargetFile
+    )
+{
+    HANDLE hSource;
+    HANDLE hDelta;
+    HANDLE hTarget;
+    PUCHAR Buffer;
+    YORI_LIB_DELTA_HEADER Header;
+    YORI_LIB_DELTA_OP DeltaOp;
+    YORI_LIB_XXHASH64_STATE State;
+    DWORDLONG SourceSize;
+    DWORDLONG SourceHash;
+    DWORDLONG BytesGenerated;
+    DWORD BytesThisPass;
+    DWORD BytesRead;
+    DWORD BytesWritten;
+    LONG OffsetHigh;
+    BOOL Result;
+
+    ASSERT(YoriLibIsStringNullTerminated(SourceFile));
+    ASSERT(YoriLibIsStringNullTerminated(DeltaFile));
+    ASSERT(YoriLibIsStringNullTerminated(TargetFile));
+
+    hSource = INVALID_HANDLE_VALUE;
+    hTarget = INVALID_HANDLE_VALUE;
+    Buffer = NULL;
+    Result = FALSE;
+
+    hDelta = CreateFile(DeltaFile->StartOfString,
+                        GENERIC_READ,
+                        FILE_SHARE_READ | FILE_SHARE_DELETE,
+                        NULL,
+                        OPEN_EXISTING,
+                        FILE_FLAG_SEQUENTIAL_SCAN,
+                        NULL);
+
+    if (hDelta == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    if (!ReadFile(hDelta, &Header, sizeof(Header), &BytesRead, NULL) ||
+        BytesRead != sizeof(Header) ||
+        Header.Signature != YORI_LIB_DELTA_SIGNATURE ||
+        Header.Version != YORI_LIB_DELTA_VERSION) {
+
+        goto Exit;
+    }
+
+    if (!YoriLibDeltaHashFile(SourceFile, &SourceSize, &SourceHash) ||
+        SourceSize != Header.SourceSize ||
+        SourceHash != Header.SourceHash) {
+
+        goto Exit;
+    }
+
+    hSource = CreateFile(SourceFile->StartOfString,
+                         GENERIC_READ,
+                         FILE_SHARE_READ | FILE_SHARE_DELETE,
+                         NULL,
+                         OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL,
+                         NULL);
+
+    if (hSource == INVALID_HANDLE_VALUE) {
+        goto Exit;
+    }
+
+    Buffer = YoriLibMalloc(YORI_LIB_DELTA_BUFFER_SIZE);
+    if (Buffer == NULL) {
+        goto Exit;
+    }
+
+    hTarget = CreateFile(TargetFile->StartOfString,
+                         GENERIC_WRITE,
+                         FILE_SHARE_READ | FILE_SHARE_DELETE,
+                         NULL,
+                         CREATE_ALWAYS,
+                         FILE_ATTRIBUTE_NORMAL,
+                         NULL);
+
+    if (hTarget == INVALID_HANDLE_VALUE) {
+        goto Exit;
+    }
+
+    YoriLibXxHash64Initialize(&State, 0);
+    BytesGenerated = 0;
+
+    while (TRUE) {
+        if (!ReadFile(hDelta, &DeltaOp, sizeof(DeltaOp), &BytesRead, NULL) ||
+            BytesRead != sizeof(DeltaOp)) {
+
+            goto Exit;
+        }
+
+        if (DeltaOp.Op == YORI_LIB_DELTA_OP_END) {
+            break;
+        }
+
+        if (DeltaOp.Op == YORI_LIB_DELTA_OP_COPY) {
+            if (DeltaOp.SourceOffset > Header.SourceSize ||
+                DeltaOp.Length > Header.SourceSize - DeltaOp.SourceOffset) {
+
+                goto Exit;
+            }
+
+            OffsetHigh = (LONG)(DeltaOp.SourceOffset >> 32);
+            if (SetFilePointer(hSource, (LONG)(DeltaOp.SourceOffset & 0xFFFFFFFF), &OffsetHigh, FILE_BEGIN) == (DWORD)-1 &&
+                GetLastError() != NO_ERROR) {
+
+                goto Exit;
+            }
+        } else if (DeltaOp.Op != YORI_LIB_DELTA_OP_INSERT) {
+            goto Exit;
+        }
+
+        if (DeltaOp.Length > Header.TargetSize - BytesGenerated) {
+            goto Exit;
+        }
+
+        while (DeltaOp.Length > 0) {
+            BytesThisPass = YORI_LIB_DELTA_BUFFER_SIZE;
+            if (BytesThisPass > DeltaOp.Length) {
+                BytesThisPass = DeltaOp.Length;
+            }
+
+            if (DeltaOp.Op == YORI_LIB_DELTA_OP_COPY) {
+                if (!ReadFile(hSource, Buffer, BytesThisPass, &BytesRead, NULL)) {
+                    goto Exit;
+                }
+            } else {
+                if (!ReadFile(hDelta, Buffer, BytesThisPass, &BytesRead, NULL)) {
+                    goto Exit;
+                }
+            }
+
+            if (BytesRead != BytesThisPass) {
+                goto Exit;
+            }
+
+            if (!WriteFile(hTarget, Buffer, BytesThisPass, &BytesWritten, NULL) ||
+                BytesWritten != BytesThisPass) {
+
+                goto Exit;
+            }
+
+            YoriLibXxHash64Update(&State, Buffer, (YORI_ALLOC_SIZE_T)BytesThisPass);
+            BytesGenerated = BytesGenerated + BytesThisPass;
+            DeltaOp.Length = DeltaOp.Length - BytesThisPass;
+        }
+    }
+
+    if (BytesGenerated == Header.TargetSize &&
+        YoriLibXxHash64Finalize(&State) == Header.TargetHash) {
+
+        Result = TRUE;
+    }
+
+Exit:
+
+    if (hTarget != INVALID_HANDLE_VALUE) {
+        CloseHandle(hTarget);
+        if (!Result) {
+            DeleteFile(TargetFile->StartOfString);
+        }
+    }
+
+    if (Buffer != NULL) {
+        YoriLibFree(Buffer);
+    }
+
+    if (hSource != INVALID_HANDLE_VALUE) {
+        CloseHandle(hSource);
+    }
+
+    CloseHandle(hDelta);
+
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
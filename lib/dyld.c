@@ -3,7 +3,7 @@
  *
  * Yori dynamically loaded OS function support
  *
- * Copyright (c) 2018-2021 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -44,6 +44,110 @@ typedef struct _YORI_DLL_NAME_MAP {
     LPCSTR FnName;
 } YORI_DLL_NAME_MAP, *PYORI_DLL_NAME_MAP;
 
+#if YORI_DLL_PROFILE
+
+/**
+ The maximum number of modules whose load cost can be recorded.  Modules
+ beyond this are not reported.
+ */
+#define YORI_DLL_PROFILE_MODULES (32)
+
+/**
+ Information recorded about the cost of loading a single module and resolving
+ functions from it.
+ */
+typedef struct _YORI_DLL_PROFILE_MODULE {
+
+    /**
+     The module that functions are being resolved from.
+     */
+    HMODULE hDll;
+
+    /**
+     The number of performance counter ticks spent loading the module.  This
+     is zero for modules that were already loaded into the process.
+     */
+    DWORDLONG LoadTicks;
+
+    /**
+     The number of performance counter ticks spent resolving functions from
+     the module.
+     */
+    DWORDLONG LookupTicks;
+
+    /**
+     The number of functions that were looked up in the module.
+     */
+    DWORD Lookups;
+
+    /**
+     The number of functions that were found in the module.
+     */
+    DWORD Resolved;
+} YORI_DLL_PROFILE_MODULE, *PYORI_DLL_PROFILE_MODULE;
+
+/**
+ Global state for DLL load profiling.  Loaders are normally invoked from a
+ single thread during process initialization, so this is not synchronized;
+ concurrent loads on other threads may be counted imprecisely.
+ */
+struct {
+
+    /**
+     The frequency of the performance counter, or zero if it has not been
+     queried yet.
+     */
+    LARGE_INTEGER Frequency;
+
+    /**
+     The number of entries in Modules that are in use.
+     */
+    DWORD ModuleCount;
+
+    /**
+     Information about each module that has been loaded or resolved from.
+     */
+    YORI_DLL_PROFILE_MODULE Modules[YORI_DLL_PROFILE_MODULES];
+} YoriLibDllProfile;
+
+/**
+ Find the profile record for a module, allocating a new one if this module has
+ not been seen before.
+
+ @param hDll The module to find a record for.
+
+ @return Pointer to the profile record, or NULL if the table is full.
+ */
+PYORI_DLL_PROFILE_MODULE
+YoriLibDllProfileFindModule(
+    __in HMODULE hDll
+    )
+{
+    DWORD Index;
+    PYORI_DLL_PROFILE_MODULE Module;
+
+    for (Index = 0; Index < YoriLibDllProfile.ModuleCount; Index++) {
+        if (YoriLibDllProfile.Modules[Index].hDll == hDll) {
+            return &YoriLibDllProfile.Modules[Index];
+        }
+    }
+
+    if (YoriLibDllProfile.ModuleCount >= YORI_DLL_PROFILE_MODULES) {
+        return NULL;
+    }
+
+    if (YoriLibDllProfile.Frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&YoriLibDllProfile.Frequency);
+    }
+
+    Module = &YoriLibDllProfile.Modules[YoriLibDllProfile.ModuleCount];
+    ZeroMemory(Module, sizeof(YORI_DLL_PROFILE_MODULE));
+    Module->hDll = hDll;
+    YoriLibDllProfile.ModuleCount++;
+    return Module;
+}
+#endif
+
 /**
  Convert a file name into a fully specified path to the System32 directory.
 
@@ -95,12 +199,21 @@ YoriLibLoadLibraryFromSystemDirectory(
     YORI_STRING YsDllName;
     YORI_STRING FullPath;
     HMODULE DllModule;
+#if YORI_DLL_PROFILE
+    LARGE_INTEGER StartTime;
+    LARGE_INTEGER EndTime;
+    PYORI_DLL_PROFILE_MODULE Module;
+#endif
 
     YoriLibConstantString(&YsDllName, DllName);
     if (!YoriLibFullPathToSystemDirectory(&YsDllName, &FullPath)) {
         return NULL;
     }
 
+#if YORI_DLL_PROFILE
+    QueryPerformanceCounter(&StartTime);
+#endif
+
     DllModule = NULL;
     if (DllKernel32.pLoadLibraryW != NULL) {
         DllModule = DllKernel32.pLoadLibraryW(FullPath.StartOfString);
@@ -108,6 +221,16 @@ YoriLibLoadLibraryFromSystemDirectory(
         DllModule = DllKernel32.pLoadLibraryExW(FullPath.StartOfString, NULL, 0);
     }
 
+#if YORI_DLL_PROFILE
+    QueryPerformanceCounter(&EndTime);
+    if (DllModule != NULL) {
+        Module = YoriLibDllProfileFindModule(DllModule);
+        if (Module != NULL) {
+            Module->LoadTicks = Module->LoadTicks + (EndTime.QuadPart - StartTime.QuadPart);
+        }
+    }
+#endif
+
     YoriLibFreeStringContents(&FullPath);
     return DllModule;
 }
@@ -146,7 +269,10 @@ YoriLibLoadNtDllFunctions(VOID)
     DllNtDll.pNtQuerySymbolicLinkObject = (PNT_QUERY_SYMBOLIC_LINK_OBJECT)GetProcAddress(DllNtDll.hDll, "NtQuerySymbolicLinkObject");
     DllNtDll.pNtQuerySystemInformation = (PNT_QUERY_SYSTEM_INFORMATION)GetProcAddress(DllNtDll.hDll, "NtQuerySystemInformation");
     DllNtDll.pNtSetInformationFile = (PNT_SET_INFORMATION_FILE)GetProcAddress(DllNtDll.hDll, "NtSetInformationFile");
+    DllNtDll.pNtSetInformationProcess = (PNT_SET_INFORMATION_PROCESS)GetProcAddress(DllNtDll.hDll, "NtSetInformationProcess");
     DllNtDll.pNtSystemDebugControl = (PNT_SYSTEM_DEBUG_CONTROL)GetProcAddress(DllNtDll.hDll, "NtSystemDebugControl");
+    DllNtDll.pRtlCompressBuffer = (PRTL_COMPRESS_BUFFER)GetProcAddress(DllNtDll.hDll, "RtlCompressBuffer");
+    DllNtDll.pRtlGetCompressionWorkSpaceSize = (PRTL_GET_COMPRESSION_WORK_SPACE_SIZE)GetProcAddress(DllNtDll.hDll, "RtlGetCompressionWorkSpaceSize");
     DllNtDll.pRtlGetLastNtStatus = (PRTL_GET_LAST_NT_STATUS)GetProcAddress(DllNtDll.hDll, "RtlGetLastNtStatus");
     return TRUE;
 }
@@ -166,8 +292,10 @@ CONST YORI_DLL_NAME_MAP DllKernel32Symbols[] = {
     {(FARPROC *)&DllKernel32.pCopyFileW, "CopyFileW"},
     {(FARPROC *)&DllKernel32.pCopyFileExW, "CopyFileExW"},
     {(FARPROC *)&DllKernel32.pCreateHardLinkW, "CreateHardLinkW"},
+    {(FARPROC *)&DllKernel32.pCreateIoCompletionPort, "CreateIoCompletionPort"},
     {(FARPROC *)&DllKernel32.pCreateJobObjectW, "CreateJobObjectW"},
     {(FARPROC *)&DllKernel32.pCreateSymbolicLinkW, "CreateSymbolicLinkW"},
+    {(FARPROC *)&DllKernel32.pFindFirstFileExW, "FindFirstFileExW"},
     {(FARPROC *)&DllKernel32.pFindFirstStreamW, "FindFirstStreamW"},
     {(FARPROC *)&DllKernel32.pFindFirstVolumeW, "FindFirstVolumeW"},
     {(FARPROC *)&DllKernel32.pFindNextStreamW, "FindNextStreamW"},
@@ -197,6 +325,8 @@ CONST YORI_DLL_NAME_MAP DllKernel32Symbols[] = {
     {(FARPROC *)&DllKernel32.pGetPrivateProfileStringW, "GetPrivateProfileStringW"},
     {(FARPROC *)&DllKernel32.pGetProcessIoCounters, "GetProcessIoCounters"},
     {(FARPROC *)&DllKernel32.pGetProductInfo, "GetProductInfo"},
+    {(FARPROC *)&DllKernel32.pGetQueuedCompletionStatus, "GetQueuedCompletionStatus"},
+    {(FARPROC *)&DllKernel32.pGetSystemCpuSetInformation, "GetSystemCpuSetInformation"},
     {(FARPROC *)&DllKernel32.pGetSystemPowerStatus, "GetSystemPowerStatus"},
     {(FARPROC *)&DllKernel32.pGetTickCount64, "GetTickCount64"},
     {(FARPROC *)&DllKernel32.pGetVersionExW, "GetVersionExW"},
@@ -212,9 +342,13 @@ CONST YORI_DLL_NAME_MAP DllKernel32Symbols[] = {
     {(FARPROC *)&DllKernel32.pIsWow64Process2, "IsWow64Process2"},
     {(FARPROC *)&DllKernel32.pLoadLibraryW, "LoadLibraryW"},
     {(FARPROC *)&DllKernel32.pLoadLibraryExW, "LoadLibraryExW"},
+    {(FARPROC *)&DllKernel32.pOpenFileById, "OpenFileById"},
     {(FARPROC *)&DllKernel32.pOpenThread, "OpenThread"},
+    {(FARPROC *)&DllKernel32.pPostQueuedCompletionStatus, "PostQueuedCompletionStatus"},
     {(FARPROC *)&DllKernel32.pQueryFullProcessImageNameW, "QueryFullProcessImageNameW"},
     {(FARPROC *)&DllKernel32.pQueryInformationJobObject, "QueryInformationJobObject"},
+    {(FARPROC *)&DllKernel32.pQueryProcessCycleTime, "QueryProcessCycleTime"},
+    {(FARPROC *)&DllKernel32.pReadDirectoryChangesW, "ReadDirectoryChangesW"},
     {(FARPROC *)&DllKernel32.pRegisterApplicationRestart, "RegisterApplicationRestart"},
     {(FARPROC *)&DllKernel32.pReplaceFileW, "ReplaceFileW"},
     {(FARPROC *)&DllKernel32.pRtlCaptureStackBackTrace, "RtlCaptureStackBackTrace"},
@@ -224,7 +358,10 @@ CONST YORI_DLL_NAME_MAP DllKernel32Symbols[] = {
     {(FARPROC *)&DllKernel32.pSetCurrentConsoleFontEx, "SetCurrentConsoleFontEx"},
     {(FARPROC *)&DllKernel32.pSetFileInformationByHandle, "SetFileInformationByHandle"},
     {(FARPROC *)&DllKernel32.pSetInformationJobObject, "SetInformationJobObject"},
+    {(FARPROC *)&DllKernel32.pSetProcessInformation, "SetProcessInformation"},
     {(FARPROC *)&DllKernel32.pSetSystemPowerState, "SetSystemPowerState"},
+    {(FARPROC *)&DllKernel32.pSetThreadGroupAffinity, "SetThreadGroupAffinity"},
+    {(FARPROC *)&DllKernel32.pSetThreadSelectedCpuSets, "SetThreadSelectedCpuSets"},
     {(FARPROC *)&DllKernel32.pWritePrivateProfileStringW, "WritePrivateProfileStringW"},
     {(FARPROC *)&DllKernel32.pWow64DisableWow64FsRedirection, "Wow64DisableWow64FsRedirection"},
     {(FARPROC *)&DllKernel32.pWow64GetThreadContext, "Wow64GetThreadContext"},
@@ -300,6 +437,40 @@ YoriLibLoadKernel32Functions(VOID)
     return TRUE;
 }
 
+/**
+ A structure containing pointers to bcrypt.dll functions that can be used if
+ they are found but programs do not have a hard dependency on.
+ */
+YORI_BCRYPT_FUNCTIONS DllBCrypt;
+
+/**
+ Load pointers to all optional bcrypt.dll functions.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibLoadBCryptFunctions(VOID)
+{
+    if (DllBCrypt.hDll != NULL) {
+        return TRUE;
+    }
+
+    DllBCrypt.hDll = YoriLibLoadLibraryFromSystemDirectory(_T("BCRYPT.DLL"));
+    if (DllBCrypt.hDll == NULL) {
+        return FALSE;
+    }
+
+    DllBCrypt.pBCryptCloseAlgorithmProvider = (PBCRYPT_CLOSE_ALGORITHM_PROVIDER)GetProcAddress(DllBCrypt.hDll, "BCryptCloseAlgorithmProvider");
+    DllBCrypt.pBCryptCreateHash = (PBCRYPT_CREATE_HASH)GetProcAddress(DllBCrypt.hDll, "BCryptCreateHash");
+    DllBCrypt.pBCryptDestroyHash = (PBCRYPT_DESTROY_HASH)GetProcAddress(DllBCrypt.hDll, "BCryptDestroyHash");
+    DllBCrypt.pBCryptFinishHash = (PBCRYPT_FINISH_HASH)GetProcAddress(DllBCrypt.hDll, "BCryptFinishHash");
+    DllBCrypt.pBCryptGetProperty = (PBCRYPT_GET_PROPERTY)GetProcAddress(DllBCrypt.hDll, "BCryptGetProperty");
+    DllBCrypt.pBCryptHashData = (PBCRYPT_HASH_DATA)GetProcAddress(DllBCrypt.hDll, "BCryptHashData");
+    DllBCrypt.pBCryptOpenAlgorithmProvider = (PBCRYPT_OPEN_ALGORITHM_PROVIDER)GetProcAddress(DllBCrypt.hDll, "BCryptOpenAlgorithmProvider");
+
+    return TRUE;
+}
+
 /**
  A structure containing pointers to crypt32.dll functions that can be used if
  they are found but programs do not have a hard dependency on.
@@ -384,6 +555,13 @@ YoriLibLoadDbgHelpFunctions(VOID)
     }
 
     DllDbgHelp.pMiniDumpWriteDump = (PMINI_DUMP_WRITE_DUMP)GetProcAddress(DllDbgHelp.hDll, "MiniDumpWriteDump");
+    DllDbgHelp.pStackWalk64 = (PSTACK_WALK64)GetProcAddress(DllDbgHelp.hDll, "StackWalk64");
+    DllDbgHelp.pSymCleanup = (PSYM_CLEANUP)GetProcAddress(DllDbgHelp.hDll, "SymCleanup");
+    DllDbgHelp.pSymFromAddr = (PSYM_FROM_ADDR)GetProcAddress(DllDbgHelp.hDll, "SymFromAddr");
+    DllDbgHelp.pSymFunctionTableAccess64 = (PSYM_FUNCTION_TABLE_ACCESS64)GetProcAddress(DllDbgHelp.hDll, "SymFunctionTableAccess64");
+    DllDbgHelp.pSymGetModuleBase64 = (PSYM_GET_MODULE_BASE64)GetProcAddress(DllDbgHelp.hDll, "SymGetModuleBase64");
+    DllDbgHelp.pSymInitialize = (PSYM_INITIALIZE)GetProcAddress(DllDbgHelp.hDll, "SymInitialize");
+    DllDbgHelp.pSymSetOptions = (PSYM_SET_OPTIONS)GetProcAddress(DllDbgHelp.hDll, "SymSetOptions");
 
     return TRUE;
 }
@@ -680,6 +858,7 @@ YoriLibLoadVirtDiskFunctions(VOID)
     DllVirtDisk.pCreateVirtualDisk = (PCREATE_VIRTUAL_DISK)GetProcAddress(DllVirtDisk.hDll, "CreateVirtualDisk");
     DllVirtDisk.pDetachVirtualDisk = (PDETACH_VIRTUAL_DISK)GetProcAddress(DllVirtDisk.hDll, "DetachVirtualDisk");
     DllVirtDisk.pExpandVirtualDisk = (PEXPAND_VIRTUAL_DISK)GetProcAddress(DllVirtDisk.hDll, "ExpandVirtualDisk");
+    DllVirtDisk.pGetVirtualDiskOperationProgress = (PGET_VIRTUAL_DISK_OPERATION_PROGRESS)GetProcAddress(DllVirtDisk.hDll, "GetVirtualDiskOperationProgress");
     DllVirtDisk.pGetVirtualDiskPhysicalPath = (PGET_VIRTUAL_DISK_PHYSICAL_PATH)GetProcAddress(DllVirtDisk.hDll, "GetVirtualDiskPhysicalPath");
     DllVirtDisk.pOpenVirtualDisk = (POPEN_VIRTUAL_DISK)GetProcAddress(DllVirtDisk.hDll, "OpenVirtualDisk");
     DllVirtDisk.pMergeVirtualDisk = (PMERGE_VIRTUAL_DISK)GetProcAddress(DllVirtDisk.hDll, "MergeVirtualDisk");
@@ -820,5 +999,111 @@ YoriLibLoadWtsApi32Functions(VOID)
     return TRUE;
 }
 
+#if YORI_DLL_PROFILE
+
+//
+//  The remainder of this file needs to call the real GetProcAddress.
+//
+
+#undef GetProcAddress
+
+/**
+ Resolve a function from a module, recording the time spent and whether the
+ function was found.  In profiling builds, all calls to GetProcAddress are
+ redirected here.
+
+ @param hDll The module to resolve the function from.
+
+ @param FnName The name of the function to resolve.
+
+ @return Pointer to the function, or NULL if it was not found.
+ */
+FARPROC
+YoriLibDllProfileGetProcAddress(
+    __in HMODULE hDll,
+    __in LPCSTR FnName
+    )
+{
+    LARGE_INTEGER StartTime;
+    LARGE_INTEGER EndTime;
+    PYORI_DLL_PROFILE_MODULE Module;
+    FARPROC Function;
+
+    QueryPerformanceCounter(&StartTime);
+    Function = GetProcAddress(hDll, FnName);
+    QueryPerformanceCounter(&EndTime);
+
+    Module = YoriLibDllProfileFindModule(hDll);
+    if (Module != NULL) {
+        Module->LookupTicks = Module->LookupTicks + (EndTime.QuadPart - StartTime.QuadPart);
+        Module->Lookups++;
+        if (Function != NULL) {
+            Module->Resolved++;
+        }
+    }
+
+    return Function;
+}
+#endif
+
+/**
+ When using DLL profiling, display the time spent loading each module and
+ resolving functions from it, along with how many of the requested functions
+ were found.  When DLL profiling is not present, does nothing.
+ */
+VOID
+YoriLibDisplayDllProfile(VOID)
+{
+#if YORI_DLL_PROFILE
+    PYORI_DLL_PROFILE_MODULE Module;
+    TCHAR ModuleName[MAX_PATH];
+    YORI_STRING YsModuleName;
+    LPTSTR BaseName;
+    DWORD Length;
+    DWORD Index;
+    DWORDLONG LoadTime;
+    DWORDLONG LookupTime;
+
+    if (YoriLibDllProfile.ModuleCount == 0 ||
+        YoriLibDllProfile.Frequency.QuadPart == 0) {
+
+        return;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("DLL profile: %i modules\n"), YoriLibDllProfile.ModuleCount);
+
+    for (Index = 0; Index < YoriLibDllProfile.ModuleCount; Index++) {
+        Module = &YoriLibDllProfile.Modules[Index];
+
+        Length = GetModuleFileName(Module->hDll, ModuleName, sizeof(ModuleName)/sizeof(ModuleName[0]));
+        if (Length >= sizeof(ModuleName)/sizeof(ModuleName[0])) {
+            Length = 0;
+        }
+        ModuleName[Length] = '\0';
+
+        YoriLibInitEmptyString(&YsModuleName);
+        YsModuleName.StartOfString = ModuleName;
+        YsModuleName.LengthInChars = (YORI_ALLOC_SIZE_T)Length;
+        BaseName = YoriLibFindRightMostCharacter(&YsModuleName, '\\');
+        if (BaseName != NULL) {
+            BaseName++;
+        } else {
+            BaseName = ModuleName;
+        }
+
+        LoadTime = Module->LoadTicks * 1000000 / YoriLibDllProfile.Frequency.QuadPart;
+        LookupTime = Module->LookupTicks * 1000000 / YoriLibDllProfile.Frequency.QuadPart;
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                      _T("%s: loaded in %llius, %i of %i functions resolved in %llius\n"),
+                      BaseName,
+                      LoadTime,
+                      Module->Resolved,
+                      Module->Lookups,
+                      LookupTime);
+    }
+#endif
+}
+
 
 // vim:sw=4:ts=4:et:
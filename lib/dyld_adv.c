@@ -3,7 +3,7 @@
  *
  * Yori dynamically loaded OS function support
  *
- * Copyright (c) 2018-2021 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -66,9 +66,13 @@ CONST YORI_DLL_NAME_MAP DllAdvApi32Symbols[] = {
     {(FARPROC *)&DllAdvApi32.pCryptHashData, "CryptHashData"},
     {(FARPROC *)&DllAdvApi32.pCryptReleaseContext, "CryptReleaseContext"},
     {(FARPROC *)&DllAdvApi32.pEqualSid, "EqualSid"},
+    {(FARPROC *)&DllAdvApi32.pEventRegister, "EventRegister"},
+    {(FARPROC *)&DllAdvApi32.pEventWriteString, "EventWriteString"},
     {(FARPROC *)&DllAdvApi32.pFreeSid, "FreeSid"},
     {(FARPROC *)&DllAdvApi32.pGetFileSecurityW, "GetFileSecurityW"},
     {(FARPROC *)&DllAdvApi32.pGetLengthSid, "GetLengthSid"},
+    {(FARPROC *)&DllAdvApi32.pGetSecurityDescriptorControl, "GetSecurityDescriptorControl"},
+    {(FARPROC *)&DllAdvApi32.pGetSecurityDescriptorDacl, "GetSecurityDescriptorDacl"},
     {(FARPROC *)&DllAdvApi32.pGetSecurityDescriptorOwner, "GetSecurityDescriptorOwner"},
     {(FARPROC *)&DllAdvApi32.pGetTokenInformation, "GetTokenInformation"},
     {(FARPROC *)&DllAdvApi32.pImpersonateSelf, "ImpersonateSelf"},
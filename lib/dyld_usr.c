@@ -56,6 +56,7 @@ YORI_USER32_FUNCTIONS DllUser32;
 CONST YORI_DLL_NAME_MAP DllUser32Symbols[] = {
     {(FARPROC *)&DllUser32.pCascadeWindows, "CascadeWindows"},
     {(FARPROC *)&DllUser32.pCloseClipboard, "CloseClipboard"},
+    {(FARPROC *)&DllUser32.pCreateWindowExW, "CreateWindowExW"},
     {(FARPROC *)&DllUser32.pDdeClientTransaction, "DdeClientTransaction"},
     {(FARPROC *)&DllUser32.pDdeConnect, "DdeConnect"},
     {(FARPROC *)&DllUser32.pDdeCreateDataHandle, "DdeCreateDataHandle"},
@@ -64,6 +65,8 @@ CONST YORI_DLL_NAME_MAP DllUser32Symbols[] = {
     {(FARPROC *)&DllUser32.pDdeFreeStringHandle, "DdeFreeStringHandle"},
     {(FARPROC *)&DllUser32.pDdeInitializeW, "DdeInitializeW"},
     {(FARPROC *)&DllUser32.pDdeUninitialize, "DdeUninitialize"},
+    {(FARPROC *)&DllUser32.pDefWindowProcW, "DefWindowProcW"},
+    {(FARPROC *)&DllUser32.pDispatchMessageW, "DispatchMessageW"},
     {(FARPROC *)&DllUser32.pDrawIconEx, "DrawIconEx"},
     {(FARPROC *)&DllUser32.pEmptyClipboard, "EmptyClipboard"},
     {(FARPROC *)&DllUser32.pEnumClipboardFormats, "EnumClipboardFormats"},
@@ -75,9 +78,11 @@ CONST YORI_DLL_NAME_MAP DllUser32Symbols[] = {
     {(FARPROC *)&DllUser32.pGetClassNameW, "GetClassNameW"},
     {(FARPROC *)&DllUser32.pGetClipboardData, "GetClipboardData"},
     {(FARPROC *)&DllUser32.pGetClipboardFormatNameW, "GetClipboardFormatNameW"},
+    {(FARPROC *)&DllUser32.pGetClipboardOwner, "GetClipboardOwner"},
     {(FARPROC *)&DllUser32.pGetClientRect, "GetClientRect"},
     {(FARPROC *)&DllUser32.pGetDesktopWindow, "GetDesktopWindow"},
     {(FARPROC *)&DllUser32.pGetKeyboardLayout, "GetKeyboardLayout"},
+    {(FARPROC *)&DllUser32.pGetMessageW, "GetMessageW"},
     {(FARPROC *)&DllUser32.pGetMonitorInfoW, "GetMonitorInfoW"},
     {(FARPROC *)&DllUser32.pGetShellWindow, "GetShellWindow"},
     {(FARPROC *)&DllUser32.pGetSystemMetrics, "GetSystemMetrics"},
@@ -90,6 +95,8 @@ CONST YORI_DLL_NAME_MAP DllUser32Symbols[] = {
     {(FARPROC *)&DllUser32.pMonitorFromWindow, "MonitorFromWindow"},
     {(FARPROC *)&DllUser32.pMoveWindow, "MoveWindow"},
     {(FARPROC *)&DllUser32.pOpenClipboard, "OpenClipboard"},
+    {(FARPROC *)&DllUser32.pPostMessageW, "PostMessageW"},
+    {(FARPROC *)&DllUser32.pRegisterClassW, "RegisterClassW"},
     {(FARPROC *)&DllUser32.pRegisterClipboardFormatW, "RegisterClipboardFormatW"},
     {(FARPROC *)&DllUser32.pRegisterShellHookWindow, "RegisterShellHookWindow"},
     {(FARPROC *)&DllUser32.pSendMessageW, "SendMessageW"},
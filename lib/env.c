@@ -664,4 +664,409 @@ YoriLibRemoveEnvComponent(
 }
 
 
+/**
+ Initialize a parsed list of components from a semicolon delimited
+ environment variable.  The list is initially empty.  A caller making a
+ series of changes to a variable can load it with
+ @ref YoriLibEnvCompLoadVariable , make each change, and update the
+ variable once with @ref YoriLibEnvCompApplyToVariable .
+
+ @param List Pointer to the list to initialize.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibEnvCompInitialize(
+    __out PYORI_ENV_COMPONENT_LIST List
+    )
+{
+    YoriLibInitializeListHead(&List->ComponentList);
+    List->ComponentCount = 0;
+    List->TotalChars = 0;
+    List->HashTable = YoriLibAllocateOpenHashTable(0);
+    if (List->HashTable == NULL) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Remove a component from a list of components and free it.
+
+ @param List Pointer to the list containing the component.
+
+ @param Component Pointer to the component to remove.
+ */
+VOID
+YoriLibEnvCompFreeComponent(
+    __in PYORI_ENV_COMPONENT_LIST List,
+    __in PYORI_ENV_COMPONENT Component
+    )
+{
+    YoriLibOpenHashRemoveByEntry(&Component->HashEntry);
+    YoriLibRemoveListItem(&Component->ListEntry);
+    List->ComponentCount--;
+    List->TotalChars = List->TotalChars - Component->Value.LengthInChars;
+    YoriLibDereference(Component);
+}
+
+/**
+ Free all components within a list of components along with the list's
+ hash table.
+
+ @param List Pointer to the list to clean up.
+ */
+VOID
+YoriLibEnvCompCleanup(
+    __in PYORI_ENV_COMPONENT_LIST List
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_ENV_COMPONENT Component;
+
+    ListEntry = YoriLibGetNextListEntry(&List->ComponentList, NULL);
+    while (ListEntry != NULL) {
+        Component = CONTAINING_RECORD(ListEntry, YORI_ENV_COMPONENT, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&List->ComponentList, ListEntry);
+        YoriLibEnvCompFreeComponent(List, Component);
+    }
+
+    if (List->HashTable != NULL) {
+        YoriLibFreeEmptyOpenHashTable(List->HashTable);
+        List->HashTable = NULL;
+    }
+}
+
+/**
+ Find a component within a list of components, ignoring case.
+
+ @param List Pointer to the list to search.
+
+ @param Component Pointer to the text of the component to find.
+
+ @return Pointer to the component, or NULL if it is not in the list.
+ */
+PYORI_ENV_COMPONENT
+YoriLibEnvCompFind(
+    __in PYORI_ENV_COMPONENT_LIST List,
+    __in PCYORI_STRING Component
+    )
+{
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+
+    HashEntry = YoriLibOpenHashLookupByKey(List->HashTable, Component);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+
+    return HashEntry->Context;
+}
+
+/**
+ Add a component to a list of components if it's not already there.  Empty
+ components are ignored.
+
+ @param List Pointer to the list to add the component to.
+
+ @param NewComponent The component to add.  This string is copied, so it can
+        be in a buffer that will be reused.
+
+ @param InsertAtFront If TRUE, insert the new component at the front of the
+        list.  If FALSE, add the component to the end of the list.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibEnvCompAdd(
+    __in PYORI_ENV_COMPONENT_LIST List,
+    __in PCYORI_STRING NewComponent,
+    __in BOOL InsertAtFront
+    )
+{
+    PYORI_ENV_COMPONENT Component;
+    YORI_MAX_UNSIGNED_T SizeNeeded;
+
+    if (NewComponent->LengthInChars == 0) {
+        return TRUE;
+    }
+
+    if (YoriLibEnvCompFind(List, NewComponent) != NULL) {
+        return TRUE;
+    }
+
+    //
+    //  The characters follow the component in the same allocation, and the
+    //  string refers to that allocation so that the hash entry can
+    //  reference it.
+    //
+
+    SizeNeeded = sizeof(YORI_ENV_COMPONENT) + ((YORI_MAX_UNSIGNED_T)NewComponent->LengthInChars + 1) * sizeof(TCHAR);
+    if (!YoriLibIsSizeAllocatable(SizeNeeded)) {
+        return FALSE;
+    }
+
+    Component = YoriLibReferencedMalloc((YORI_ALLOC_SIZE_T)SizeNeeded);
+    if (Component == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Component->Value);
+    Component->Value.MemoryToFree = Component;
+    Component->Value.StartOfString = (LPTSTR)(Component + 1);
+    memcpy(Component->Value.StartOfString, NewComponent->StartOfString, NewComponent->LengthInChars * sizeof(TCHAR));
+    Component->Value.StartOfString[NewComponent->LengthInChars] = '\0';
+    Component->Value.LengthInChars = NewComponent->LengthInChars;
+    Component->Value.LengthAllocated = NewComponent->LengthInChars + 1;
+
+    if (!YoriLibOpenHashInsertByKey(List->HashTable, &Component->Value, Component, &Component->HashEntry)) {
+        YoriLibDereference(Component);
+        return FALSE;
+    }
+
+    if (InsertAtFront) {
+        YoriLibInsertList(&List->ComponentList, &Component->ListEntry);
+    } else {
+        YoriLibAppendList(&List->ComponentList, &Component->ListEntry);
+    }
+
+    List->ComponentCount++;
+    List->TotalChars = List->TotalChars + Component->Value.LengthInChars;
+    return TRUE;
+}
+
+/**
+ Move a component to the front or end of a list of components.  If the
+ component is not already in the list, it is added.
+
+ @param List Pointer to the list containing the component.
+
+ @param Component The component to move.
+
+ @param MoveToFront If TRUE, the component is moved to the front of the
+        list.  If FALSE, it is moved to the end of the list.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibEnvCompMove(
+    __in PYORI_ENV_COMPONENT_LIST List,
+    __in PCYORI_STRING Component,
+    __in BOOL MoveToFront
+    )
+{
+    PYORI_ENV_COMPONENT Existing;
+
+    Existing = YoriLibEnvCompFind(List, Component);
+    if (Existing == NULL) {
+        return YoriLibEnvCompAdd(List, Component, MoveToFront);
+    }
+
+    YoriLibRemoveListItem(&Existing->ListEntry);
+    if (MoveToFront) {
+        YoriLibInsertList(&List->ComponentList, &Existing->ListEntry);
+    } else {
+        YoriLibAppendList(&List->ComponentList, &Existing->ListEntry);
+    }
+
+    return TRUE;
+}
+
+/**
+ Remove a component from a list of components if it's there.
+
+ @param List Pointer to the list to remove the component from.
+
+ @param ComponentToRemove The component to remove.
+
+ @return TRUE if the component was found and removed, FALSE if it was not
+         in the list.
+ */
+BOOL
+YoriLibEnvCompRemove(
+    __in PYORI_ENV_COMPONENT_LIST List,
+    __in PCYORI_STRING ComponentToRemove
+    )
+{
+    PYORI_ENV_COMPONENT Existing;
+
+    Existing = YoriLibEnvCompFind(List, ComponentToRemove);
+    if (Existing == NULL) {
+        return FALSE;
+    }
+
+    YoriLibEnvCompFreeComponent(List, Existing);
+    return TRUE;
+}
+
+/**
+ Parse a semicolon delimited string and add each of its components to the
+ end of a list of components.  Empty components are skipped, and since the
+ first instance of a component is the one that takes effect when searching,
+ any later duplicates are discarded.
+
+ @param List Pointer to the list to add components to.
+
+ @param String The semicolon delimited string.  This string is not modified
+        and is not referenced after this call returns.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibEnvCompLoadString(
+    __in PYORI_ENV_COMPONENT_LIST List,
+    __in PCYORI_STRING String
+    )
+{
+    YORI_STRING Component;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Start;
+
+    YoriLibInitEmptyString(&Component);
+    Start = 0;
+    for (Index = 0; Index < String->LengthInChars; Index++) {
+        if (String->StartOfString[Index] == ';') {
+            Component.StartOfString = &String->StartOfString[Start];
+            Component.LengthInChars = Index - Start;
+            if (!YoriLibEnvCompAdd(List, &Component, FALSE)) {
+                return FALSE;
+            }
+            Start = Index + 1;
+        }
+    }
+
+    Component.StartOfString = &String->StartOfString[Start];
+    Component.LengthInChars = String->LengthInChars - Start;
+    return YoriLibEnvCompAdd(List, &Component, FALSE);
+}
+
+/**
+ Load the contents of a semicolon delimited environment variable into a list
+ of components.  If the variable is not defined, no components are added.
+
+ @param List Pointer to the list to add components to.
+
+ @param EnvironmentVariable The name of the environment variable to load.
+
+ @return TRUE to indicate success, FALSE on failure.
+ */
+__success(return)
+BOOL
+YoriLibEnvCompLoadVariable(
+    __in PYORI_ENV_COMPONENT_LIST List,
+    __in LPCTSTR EnvironmentVariable
+    )
+{
+    YORI_STRING Value;
+    BOOL Success;
+
+    YoriLibInitEmptyString(&Value);
+    if (!YoriLibAllocateAndGetEnvVar(EnvironmentVariable, &Value)) {
+        return FALSE;
+    }
+
+    Success = YoriLibEnvCompLoadString(List, &Value);
+    YoriLibFreeStringContents(&Value);
+    return Success;
+}
+
+/**
+ Generate a semicolon delimited string from a list of components.  The
+ string is allocated once at its final size.
+
+ @param List Pointer to the list of components.
+
+ @param Result On successful completion, updated to contain a newly
+        allocated, NULL terminated string.  If the list is empty, this
+        string has no characters.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibEnvCompBuildString(
+    __in PYORI_ENV_COMPONENT_LIST List,
+    __out PYORI_STRING Result
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_ENV_COMPONENT Component;
+    YORI_MAX_UNSIGNED_T SizeNeeded;
+    YORI_ALLOC_SIZE_T Offset;
+
+    //
+    //  Each component needs either a seperator after it or, for the final
+    //  component, a NULL terminator.
+    //
+
+    SizeNeeded = List->TotalChars + List->ComponentCount + 1;
+    if (!YoriLibIsSizeAllocatable(SizeNeeded)) {
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(Result, (YORI_ALLOC_SIZE_T)SizeNeeded)) {
+        return FALSE;
+    }
+
+    Offset = 0;
+    ListEntry = YoriLibGetNextListEntry(&List->ComponentList, NULL);
+    while (ListEntry != NULL) {
+        Component = CONTAINING_RECORD(ListEntry, YORI_ENV_COMPONENT, ListEntry);
+        if (Offset > 0) {
+            Result->StartOfString[Offset] = ';';
+            Offset++;
+        }
+        memcpy(&Result->StartOfString[Offset], Component->Value.StartOfString, Component->Value.LengthInChars * sizeof(TCHAR));
+        Offset = Offset + Component->Value.LengthInChars;
+        ListEntry = YoriLibGetNextListEntry(&List->ComponentList, ListEntry);
+    }
+
+    Result->StartOfString[Offset] = '\0';
+    Result->LengthInChars = Offset;
+    return TRUE;
+}
+
+/**
+ Update an environment variable to contain the components in a list of
+ components.  If the list is empty, the variable is deleted.
+
+ @param List Pointer to the list of components.
+
+ @param EnvironmentVariable The name of the environment variable to update.
+
+ @return TRUE to indicate success, FALSE on failure.
+ */
+__success(return)
+BOOL
+YoriLibEnvCompApplyToVariable(
+    __in PYORI_ENV_COMPONENT_LIST List,
+    __in LPCTSTR EnvironmentVariable
+    )
+{
+    YORI_STRING CombinedString;
+
+    if (List->ComponentCount == 0) {
+        if (!SetEnvironmentVariable(EnvironmentVariable, NULL)) {
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    if (!YoriLibEnvCompBuildString(List, &CombinedString)) {
+        return FALSE;
+    }
+
+    if (!SetEnvironmentVariable(EnvironmentVariable, CombinedString.StartOfString)) {
+        YoriLibFreeStringContents(&CombinedString);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&CombinedString);
+    return TRUE;
+}
+
 // vim:sw=4:ts=4:et:
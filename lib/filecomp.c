@@ -4,7 +4,7 @@
  * Yori lib perform transparent individual file compression on background
  * threads
  *
- * Copyright (c) 2018 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -28,6 +28,105 @@
 #include <yoripch.h>
 #include <yorilib.h>
 
+/**
+ The number of files on a volume that can be processed concurrently before
+ any throughput has been measured.
+ */
+#define YORILIB_COMPRESS_INITIAL_CONCURRENCY (2)
+
+/**
+ The interval, in milliseconds, over which throughput on a volume is
+ measured before its concurrency limit is reconsidered.
+ */
+#define YORILIB_COMPRESS_SAMPLE_INTERVAL (1000)
+
+/**
+ The average time, in milliseconds, that files must wait in a volume's
+ queue before additional concurrency is attempted.  If files are being
+ processed as soon as they are queued, more threads cannot help.
+ */
+#define YORILIB_COMPRESS_QUEUE_LATENCY_THRESHOLD (10)
+
+/**
+ A volume containing files to compress or decompress.  Files on different
+ volumes are queued separately so that each device can have a concurrency
+ limit suited to it.  A rotational disk slows down as more files are
+ processed at once, whereas a solid state device can keep many threads
+ busy.
+ */
+typedef struct _YORILIB_COMPRESS_VOLUME {
+
+    /**
+     The entry for this volume on the compress context's list of volumes.
+     */
+    YORI_LIST_ENTRY VolumeList;
+
+    /**
+     The name of the volume.  This is empty for files whose volume could
+     not be determined.
+     */
+    YORI_STRING VolumeName;
+
+    /**
+     The list of files on this volume requiring compression.
+     */
+    YORI_LIST_ENTRY PendingList;
+
+    /**
+     The number of items currently queued on this volume.
+     */
+    YORI_ALLOC_SIZE_T ItemsQueued;
+
+    /**
+     The number of items on this volume currently being processed by
+     worker threads.
+     */
+    YORI_ALLOC_SIZE_T ActiveItems;
+
+    /**
+     The maximum number of items on this volume that worker threads can
+     process concurrently.
+     */
+    YORI_ALLOC_SIZE_T ConcurrencyLimit;
+
+    /**
+     The direction that ConcurrencyLimit was last changed in, either 1 or
+     -1.  If throughput improved, the limit continues to move in the same
+     direction.  If it degraded, the direction is reversed.
+     */
+    INT Direction;
+
+    /**
+     The tick count at the start of the current measurement interval.
+     */
+    DWORD IntervalStart;
+
+    /**
+     The number of bytes processed on this volume in the current
+     measurement interval.
+     */
+    DWORDLONG IntervalBytes;
+
+    /**
+     The number of items taken from the queue in the current measurement
+     interval.
+     */
+    DWORD IntervalItemsStarted;
+
+    /**
+     The total number of milliseconds that items taken from the queue in
+     the current measurement interval spent waiting in the queue.
+     */
+    DWORD IntervalQueueTime;
+
+    /**
+     The throughput, in bytes per second, measured in the previous
+     interval.
+     */
+    DWORDLONG LastThroughput;
+
+} YORILIB_COMPRESS_VOLUME, *PYORILIB_COMPRESS_VOLUME;
+
 /**
  A single item to compress or decompress.
  */
@@ -38,6 +137,16 @@ typedef struct _YORILIB_PENDING_ACTION {
      */
     YORI_LIST_ENTRY CompressList;
 
+    /**
+     The volume containing the file.
+     */
+    PYORILIB_COMPRESS_VOLUME Volume;
+
+    /**
+     The tick count when the item was queued.
+     */
+    DWORD QueuedTime;
+
     /**
      The file name to compress.
      */
@@ -68,28 +177,33 @@ YoriLibInitializeCompressContext(
     __in YORILIB_COMPRESS_ALGORITHM CompressionAlgorithm
     )
 {
-    SYSTEM_INFO SystemInfo;
-    GetSystemInfo(&SystemInfo);
+    WORD PerformanceProcessors;
+    WORD EfficiencyProcessors;
+
+    YoriLibInitializeListHead(&CompressContext->VolumeList);
+    YoriLibInitEmptyString(&CompressContext->LastParentDirectory);
+    CompressContext->LastVolume = NULL;
 
     CompressContext->CompressionAlgorithm.EntireAlgorithm = CompressionAlgorithm.EntireAlgorithm;
+    CompressContext->FilesSkippedIncompressible = 0;
+    CompressContext->CompressIncompressible = FALSE;
 
     //
-    //  Create threads equal to the number of CPUs.  The system can compress
-    //  chunks of data on background threads, so this is just the number of
-    //  threads initiating work.  Unfortunately, the call to CreateFile
-    //  after copy has a tendency to block, so we need this to be part of
-    //  the threadpool to prevent bottlenecking the copy.
+    //  Allow up to one thread per CPU.  The system can compress chunks of
+    //  data on background threads, so this is just the number of threads
+    //  initiating work.  Unfortunately, the call to CreateFile after copy
+    //  has a tendency to block, so we need this to be part of the
+    //  threadpool to prevent bottlenecking the copy.  The number of threads
+    //  used on each volume is limited separately based on the throughput
+    //  the volume achieves.
     //
 
-    CompressContext->MaxThreads = (YORI_ALLOC_SIZE_T)SystemInfo.dwNumberOfProcessors;
+    YoriLibQueryCpuCount(&PerformanceProcessors, &EfficiencyProcessors);
+    CompressContext->MaxThreads = (YORI_ALLOC_SIZE_T)(PerformanceProcessors + EfficiencyProcessors);
     if (CompressContext->MaxThreads < 1) {
         CompressContext->MaxThreads = 1;
     }
-    if (CompressContext->MaxThreads > 32) {
-        CompressContext->MaxThreads = 32;
-    }
 
-    YoriLibInitializeListHead(&CompressContext->PendingList);
     CompressContext->WorkerWaitEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
     if (CompressContext->WorkerWaitEvent == NULL) {
         return FALSE;
@@ -126,16 +240,37 @@ YoriLibFreeCompressContext(
     __in PYORILIB_COMPRESS_CONTEXT CompressContext
     )
 {
+    PYORI_LIST_ENTRY ListEntry;
+    PYORILIB_COMPRESS_VOLUME Volume;
+
+    //
+    //  There can be more threads than WaitForMultipleObjects can wait on,
+    //  so wait for each in turn.
+    //
+
     if (CompressContext->ThreadsAllocated > 0) {
         DWORD Index;
         SetEvent(CompressContext->WorkerShutdownEvent);
-        WaitForMultipleObjectsEx(CompressContext->ThreadsAllocated, CompressContext->Threads, TRUE, INFINITE, FALSE);
         for (Index = 0; Index < CompressContext->ThreadsAllocated; Index++) {
+            WaitForSingleObject(CompressContext->Threads[Index], INFINITE);
             CloseHandle(CompressContext->Threads[Index]);
             CompressContext->Threads[Index] = NULL;
         }
-        ASSERT(YoriLibIsListEmpty(&CompressContext->PendingList));
+        CompressContext->ThreadsAllocated = 0;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&CompressContext->VolumeList, NULL);
+    while (ListEntry != NULL) {
+        Volume = CONTAINING_RECORD(ListEntry, YORILIB_COMPRESS_VOLUME, VolumeList);
+        ListEntry = YoriLibGetNextListEntry(&CompressContext->VolumeList, ListEntry);
+        ASSERT(YoriLibIsListEmpty(&Volume->PendingList));
+        YoriLibRemoveListItem(&Volume->VolumeList);
+        YoriLibFreeStringContents(&Volume->VolumeName);
+        YoriLibFree(Volume);
     }
+    CompressContext->LastVolume = NULL;
+    YoriLibFreeStringContents(&CompressContext->LastParentDirectory);
+
     if (CompressContext->WorkerWaitEvent != NULL) {
         CloseHandle(CompressContext->WorkerWaitEvent);
         CompressContext->WorkerWaitEvent = NULL;
@@ -154,6 +289,322 @@ YoriLibFreeCompressContext(
     }
 }
 
+/**
+ File extensions of formats which are already compressed, so compressing
+ them again would consume time without saving space.
+ */
+CONST LPCTSTR YoriLibIncompressibleExtensions[] = {
+    _T("7z"),
+    _T("aac"),
+    _T("avi"),
+    _T("bz2"),
+    _T("cab"),
+    _T("docx"),
+    _T("flac"),
+    _T("gif"),
+    _T("gz"),
+    _T("heic"),
+    _T("jpeg"),
+    _T("jpg"),
+    _T("m4a"),
+    _T("mkv"),
+    _T("mov"),
+    _T("mp3"),
+    _T("mp4"),
+    _T("ogg"),
+    _T("png"),
+    _T("pptx"),
+    _T("rar"),
+    _T("webm"),
+    _T("webp"),
+    _T("wim"),
+    _T("xlsx"),
+    _T("xz"),
+    _T("zip"),
+    _T("zst"),
+};
+
+/**
+ A signature found at the beginning of files whose format is already
+ compressed.
+ */
+typedef struct _YORILIB_INCOMPRESSIBLE_SIGNATURE {
+
+    /**
+     The offset within the file of the signature.
+     */
+    DWORD Offset;
+
+    /**
+     The number of bytes in the signature.
+     */
+    DWORD Length;
+
+    /**
+     The bytes of the signature.
+     */
+    CONST CHAR * Signature;
+
+} YORILIB_INCOMPRESSIBLE_SIGNATURE;
+
+/**
+ Signatures of formats which are already compressed.
+ */
+CONST YORILIB_INCOMPRESSIBLE_SIGNATURE YoriLibIncompressibleSignatures[] = {
+    {0, 4, "PK\x03\x04"},
+    {0, 2, "\x1F\x8B"},
+    {0, 6, "7z\xBC\xAF\x27\x1C"},
+    {0, 4, "Rar!"},
+    {0, 3, "BZh"},
+    {0, 6, "\xFD" "7zXZ\x00"},
+    {0, 4, "\x28\xB5\x2F\xFD"},
+    {0, 4, "MSCF"},
+    {0, 3, "\xFF\xD8\xFF"},
+    {0, 4, "\x89PNG"},
+    {0, 4, "GIF8"},
+    {0, 4, "\x1A\x45\xDF\xA3"},
+    {0, 4, "OggS"},
+    {0, 4, "fLaC"},
+    {0, 3, "ID3"},
+    {4, 4, "ftyp"},
+};
+
+/**
+ The number of bytes in each region of a file that is compressed to estimate
+ how well the file will compress.
+ */
+#define YORILIB_COMPRESS_SAMPLE_SIZE (64 * 1024)
+
+/**
+ The number of regions of a file that are compressed to estimate how well
+ the file will compress.  The regions are spread evenly through the file.
+ */
+#define YORILIB_COMPRESS_SAMPLE_COUNT (4)
+
+/**
+ If the sampled regions of a file compress to more than this percentage of
+ their original size, the file is not compressed.
+ */
+#define YORILIB_COMPRESS_SAMPLE_THRESHOLD (90)
+
+/**
+ Check whether a file's extension indicates that it is in a format which is
+ already compressed.
+
+ @param FileName Pointer to the file name.
+
+ @return TRUE if the file is known to be compressed already, FALSE if it is
+         not.
+ */
+BOOL
+YoriLibIsExtensionIncompressible(
+    __in PYORI_STRING FileName
+    )
+{
+    YORI_STRING Extension;
+    LPTSTR FinalDot;
+    LPTSTR FinalSeperator;
+    DWORD Index;
+
+    FinalDot = YoriLibFindRightMostCharacter(FileName, '.');
+    if (FinalDot == NULL) {
+        return FALSE;
+    }
+
+    FinalSeperator = YoriLibFindRightMostCharacter(FileName, '\\');
+    if (FinalSeperator != NULL && FinalSeperator > FinalDot) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Extension);
+    Extension.StartOfString = FinalDot + 1;
+    Extension.LengthInChars = (YORI_ALLOC_SIZE_T)(FileName->LengthInChars - (FinalDot - FileName->StartOfString) - 1);
+
+    for (Index = 0; Index < sizeof(YoriLibIncompressibleExtensions)/sizeof(YoriLibIncompressibleExtensions[0]); Index++) {
+        if (YoriLibCompareStringLitIns(&Extension, YoriLibIncompressibleExtensions[Index]) == 0) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Check whether the beginning of a file contains the signature of a format
+ which is already compressed.
+
+ @param Buffer Pointer to the data at the beginning of the file.
+
+ @param BufferLength The number of bytes in Buffer.
+
+ @return TRUE if the file is known to be compressed already, FALSE if it is
+         not.
+ */
+BOOL
+YoriLibIsSignatureIncompressible(
+    __in_ecount(BufferLength) PUCHAR Buffer,
+    __in DWORD BufferLength
+    )
+{
+    CONST YORILIB_INCOMPRESSIBLE_SIGNATURE * Signature;
+    DWORD Index;
+
+    for (Index = 0; Index < sizeof(YoriLibIncompressibleSignatures)/sizeof(YoriLibIncompressibleSignatures[0]); Index++) {
+        Signature = &YoriLibIncompressibleSignatures[Index];
+        if (Signature->Offset + Signature->Length <= BufferLength &&
+            memcmp(&Buffer[Signature->Offset], Signature->Signature, Signature->Length) == 0) {
+
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Estimate whether a file will benefit from compression.  Files whose name
+ or signature indicate a format that is already compressed are rejected
+ without further work.  Otherwise, several regions spread through the file
+ are compressed in memory, and the file is rejected if they do not compress
+ well.
+
+ @param FileName Pointer to the name of the file.
+
+ @param FileHandle Handle to the file, opened for read.
+
+ @param FileSize The size of the file, in bytes.
+
+ @param KnownFormat On completion, set to TRUE if the file was rejected
+        because of its name or signature, or FALSE if it was sampled.
+
+ @param Percentage On completion, updated to contain the size of the
+        compressed samples as a percentage of their original size.
+
+ @return TRUE if the file should be compressed, FALSE if it should not.
+ */
+BOOL
+YoriLibIsFileCompressible(
+    __in PYORI_STRING FileName,
+    __in HANDLE FileHandle,
+    __in DWORDLONG FileSize,
+    __out PBOOL KnownFormat,
+    __out PDWORD Percentage
+    )
+{
+    PUCHAR Sample;
+    PUCHAR Compressed;
+    PVOID WorkSpace;
+    ULONG WorkSpaceSize;
+    ULONG FragmentWorkSpaceSize;
+    ULONG CompressedSize;
+    DWORD BytesRead;
+    DWORD Index;
+    DWORDLONG Offset;
+    DWORDLONG TotalSampled;
+    DWORDLONG TotalCompressed;
+    LONG OffsetHigh;
+    LONG Status;
+    BOOL Result;
+
+    *KnownFormat = TRUE;
+    *Percentage = 100;
+    if (YoriLibIsExtensionIncompressible(FileName)) {
+        return FALSE;
+    }
+
+    WorkSpaceSize = 0;
+    if (DllNtDll.pRtlCompressBuffer == NULL ||
+        DllNtDll.pRtlGetCompressionWorkSpaceSize == NULL ||
+        DllNtDll.pRtlGetCompressionWorkSpaceSize(COMPRESSION_FORMAT_LZNT1 | COMPRESSION_ENGINE_STANDARD, &WorkSpaceSize, &FragmentWorkSpaceSize) < 0) {
+
+        WorkSpaceSize = 0;
+    }
+
+    Sample = YoriLibMalloc(YORILIB_COMPRESS_SAMPLE_SIZE * 2 + WorkSpaceSize);
+    if (Sample == NULL) {
+        *KnownFormat = FALSE;
+        *Percentage = 0;
+        return TRUE;
+    }
+    Compressed = Sample + YORILIB_COMPRESS_SAMPLE_SIZE;
+    WorkSpace = Compressed + YORILIB_COMPRESS_SAMPLE_SIZE;
+
+    TotalSampled = 0;
+    TotalCompressed = 0;
+    Result = TRUE;
+
+    for (Index = 0; Index < YORILIB_COMPRESS_SAMPLE_COUNT; Index++) {
+
+        //
+        //  Small files are sampled from the start with regions next to
+        //  each other.  Larger files have their regions spread out so the
+        //  first and last regions are at the start and end of the file.
+        //
+
+        if (FileSize <= YORILIB_COMPRESS_SAMPLE_SIZE * YORILIB_COMPRESS_SAMPLE_COUNT) {
+            Offset = (DWORDLONG)Index * YORILIB_COMPRESS_SAMPLE_SIZE;
+            if (Offset >= FileSize) {
+                break;
+            }
+        } else {
+            Offset = (FileSize - YORILIB_COMPRESS_SAMPLE_SIZE) * Index / (YORILIB_COMPRESS_SAMPLE_COUNT - 1);
+        }
+
+        OffsetHigh = (LONG)(Offset >> 32);
+        SetFilePointer(FileHandle, (LONG)(Offset & 0xFFFFFFFF), &OffsetHigh, FILE_BEGIN);
+        if (!ReadFile(FileHandle, Sample, YORILIB_COMPRESS_SAMPLE_SIZE, &BytesRead, NULL) ||
+            BytesRead == 0) {
+
+            break;
+        }
+
+        if (Index == 0 &&
+            YoriLibIsSignatureIncompressible(Sample, BytesRead)) {
+
+            Result = FALSE;
+            break;
+        }
+
+        *KnownFormat = FALSE;
+        if (WorkSpaceSize == 0) {
+            break;
+        }
+
+        //
+        //  If the compressed form doesn't fit in a buffer the size of the
+        //  input, the data is incompressible.
+        //
+
+        Status = DllNtDll.pRtlCompressBuffer(COMPRESSION_FORMAT_LZNT1 | COMPRESSION_ENGINE_STANDARD,
+                                             Sample,
+                                             BytesRead,
+                                             Compressed,
+                                             YORILIB_COMPRESS_SAMPLE_SIZE,
+                                             4096,
+                                             &CompressedSize,
+                                             WorkSpace);
+        if (Status < 0 || CompressedSize > BytesRead) {
+            CompressedSize = BytesRead;
+        }
+
+        TotalSampled = TotalSampled + BytesRead;
+        TotalCompressed = TotalCompressed + CompressedSize;
+    }
+
+    if (Result) {
+        *Percentage = 0;
+        if (TotalSampled > 0) {
+            *Percentage = (DWORD)(TotalCompressed * 100 / TotalSampled);
+            if (*Percentage > YORILIB_COMPRESS_SAMPLE_THRESHOLD) {
+                Result = FALSE;
+            }
+        }
+    }
+
+    YoriLibFree(Sample);
+    return Result;
+}
+
 /**
  Compress a single file.  This can be called on worker threads, or occasionally
  on the main thread if the worker threads are backlogged.
@@ -161,23 +612,37 @@ YoriLibFreeCompressContext(
  @param PendingAction Pointer to the object that needs to be compressed.
         This structure is deallocated within this function.
 
- @param CompressionAlgorithm Specifies the compression algorithm to compress
-        the file with.
+ @param CompressContext Pointer to the compress context, which specifies the
+        compression algorithm to compress the file with.
+
+ @param BytesProcessed Optionally points to a value to receive the size of
+        the file.  This is used to measure throughput.
  
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 YoriLibCompressSingleFile(
     __in PYORILIB_PENDING_ACTION PendingAction,
-    __in YORILIB_COMPRESS_ALGORITHM CompressionAlgorithm
+    __in PYORILIB_COMPRESS_CONTEXT CompressContext,
+    __out_opt PDWORDLONG BytesProcessed
     )
 {
     HANDLE DestFileHandle;
     DWORD AccessRequired;
     BY_HANDLE_FILE_INFORMATION FileInfo;
     DWORD BytesReturned;
+    DWORD Percentage;
+    BOOL KnownFormat;
     BOOL Result = FALSE;
     BOOL CompressFile = TRUE;
+    DWORDLONG FileSize;
+    YORILIB_COMPRESS_ALGORITHM CompressionAlgorithm;
+
+    CompressionAlgorithm.EntireAlgorithm = CompressContext->CompressionAlgorithm.EntireAlgorithm;
+
+    if (BytesProcessed != NULL) {
+        *BytesProcessed = 0;
+    }
 
     //
     //  In order to compress system files, we can't open for write access.
@@ -214,13 +679,43 @@ YoriLibCompressSingleFile(
         goto Exit;
     }
 
+    FileSize = ((DWORDLONG)FileInfo.nFileSizeHigh << 32) | FileInfo.nFileSizeLow;
+    if (BytesProcessed != NULL) {
+        *BytesProcessed = FileSize;
+    }
+
     if (FileInfo.nFileSizeHigh == 0 &&
         FileInfo.nFileSizeLow < 10 * 1024) {
 
         goto Exit;
     }
 
+    //
+    //  Skip files that are already in a compressed format.  For these,
+    //  compression would take time without saving space.
+    //
+
+    if (!CompressContext->CompressIncompressible &&
+        (FileInfo.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 &&
+        !YoriLibIsFileCompressible(&PendingAction->FileName,
+                                   DestFileHandle,
+                                   FileSize,
+                                   &KnownFormat,
+                                   &Percentage)) {
+
+        InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&CompressContext->FilesSkippedIncompressible);
+        if (CompressContext->Verbose) {
+            if (KnownFormat) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Skipping %y: format is already compressed\n"), &PendingAction->FileName);
+            } else {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Skipping %y: sample compressed to %i%%\n"), &PendingAction->FileName, Percentage);
+            }
+        }
+        Result = TRUE;
+        goto Exit;
+    }
 
+    YoriLibTraceBegin(YORI_LIB_TRACE_COMPRESS, _T("CompressFile"), &PendingAction->FileName, FileSize);
     if (CompressionAlgorithm.NtfsAlgorithm != 0) {
         USHORT Algorithm = (USHORT)CompressionAlgorithm.NtfsAlgorithm;
 
@@ -277,6 +772,7 @@ YoriLibCompressSingleFile(
                                      NULL);
         }
     }
+    YoriLibTraceEnd(YORI_LIB_TRACE_COMPRESS, _T("CompressFile"), &PendingAction->FileName, FileSize);
 
 Exit:
     if (DestFileHandle != NULL) {
@@ -293,13 +789,18 @@ Exit:
  @param PendingAction Pointer to the object that needs to be decompressed.
         This structure is deallocated within this function.
 
+ @param BytesProcessed Optionally points to a value to receive the size of
+        the file.  This is used to measure throughput.
+
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 YoriLibDecompressSingleFile(
-    __in PYORILIB_PENDING_ACTION PendingAction
+    __in PYORILIB_PENDING_ACTION PendingAction,
+    __out_opt PDWORDLONG BytesProcessed
     )
 {
+    BY_HANDLE_FILE_INFORMATION FileInfo;
     BOOL GlobalResult = TRUE;
     DWORD BytesReturned;
     DWORD AccessRequired;
@@ -348,11 +849,21 @@ YoriLibDecompressSingleFile(
         }
     }
 
+    if (BytesProcessed != NULL) {
+        *BytesProcessed = 0;
+    }
+
     if (DestFileHandle == INVALID_HANDLE_VALUE) {
         YoriLibFree(PendingAction);
         return FALSE;
     }
 
+    if (BytesProcessed != NULL &&
+        GetFileInformationByHandle(DestFileHandle, &FileInfo)) {
+
+        *BytesProcessed = ((DWORDLONG)FileInfo.nFileSizeHigh << 32) | FileInfo.nFileSizeLow;
+    }
+
     if ((AccessRequired & FILE_WRITE_DATA) != 0) {
         LocalResult = DeviceIoControl(DestFileHandle,
                                       FSCTL_SET_COMPRESSION,
@@ -409,6 +920,130 @@ YoriLibDecompressSingleFile(
 }
 
 
+/**
+ Find the next item that a worker thread should process.  This is the first
+ queued item on a volume that has not reached its concurrency limit.  The
+ volume is moved to the end of the list so that volumes are serviced in
+ turn.  This function assumes the caller holds the compress context mutex.
+
+ @param CompressContext Pointer to the compress context.
+
+ @return Pointer to the item to process, or NULL if no item can be
+         processed now.
+ */
+PYORILIB_PENDING_ACTION
+YoriLibGetNextCompressAction(
+    __in PYORILIB_COMPRESS_CONTEXT CompressContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORILIB_COMPRESS_VOLUME Volume;
+    PYORILIB_PENDING_ACTION PendingAction;
+
+    ListEntry = YoriLibGetNextListEntry(&CompressContext->VolumeList, NULL);
+    while (ListEntry != NULL) {
+        Volume = CONTAINING_RECORD(ListEntry, YORILIB_COMPRESS_VOLUME, VolumeList);
+        if (Volume->ItemsQueued > 0 &&
+            Volume->ActiveItems < Volume->ConcurrencyLimit) {
+
+            PendingAction = CONTAINING_RECORD(Volume->PendingList.Next, YORILIB_PENDING_ACTION, CompressList);
+            YoriLibRemoveListItem(&PendingAction->CompressList);
+            Volume->ItemsQueued--;
+            Volume->ActiveItems++;
+            ASSERT(CompressContext->ItemsQueued > 0);
+            CompressContext->ItemsQueued--;
+
+            Volume->IntervalItemsStarted++;
+            Volume->IntervalQueueTime = Volume->IntervalQueueTime + (GetTickCount() - PendingAction->QueuedTime);
+
+            YoriLibRemoveListItem(&Volume->VolumeList);
+            YoriLibAppendList(&CompressContext->VolumeList, &Volume->VolumeList);
+            return PendingAction;
+        }
+        ListEntry = YoriLibGetNextListEntry(&CompressContext->VolumeList, ListEntry);
+    }
+
+    return NULL;
+}
+
+/**
+ Record the completion of an item on a volume, and if enough time has
+ elapsed, adjust the number of items the volume can process concurrently.
+ The limit is moved one step at a time.  If throughput improved after the
+ previous step, the next step is in the same direction; if it degraded,
+ the direction is reversed.  The limit is not raised unless items are
+ waiting in the queue, since more threads can't help a volume that is
+ keeping up.  This function assumes the caller holds the compress context
+ mutex.
+
+ @param CompressContext Pointer to the compress context.
+
+ @param Volume Pointer to the volume containing the item.
+
+ @param BytesProcessed The size of the item that was processed.
+ */
+VOID
+YoriLibCompleteCompressAction(
+    __in PYORILIB_COMPRESS_CONTEXT CompressContext,
+    __in PYORILIB_COMPRESS_VOLUME Volume,
+    __in DWORDLONG BytesProcessed
+    )
+{
+    DWORD Elapsed;
+    DWORD AverageQueueTime;
+    DWORDLONG Throughput;
+    DWORDLONG Tolerance;
+
+    ASSERT(Volume->ActiveItems > 0);
+    Volume->ActiveItems--;
+    Volume->IntervalBytes = Volume->IntervalBytes + BytesProcessed;
+
+    Elapsed = GetTickCount() - Volume->IntervalStart;
+    if (Elapsed < YORILIB_COMPRESS_SAMPLE_INTERVAL) {
+        return;
+    }
+
+    Throughput = Volume->IntervalBytes * 1000 / Elapsed;
+    AverageQueueTime = 0;
+    if (Volume->IntervalItemsStarted > 0) {
+        AverageQueueTime = Volume->IntervalQueueTime / Volume->IntervalItemsStarted;
+    }
+
+    Tolerance = Volume->LastThroughput / 10;
+    if (Throughput + Tolerance < Volume->LastThroughput) {
+        Volume->Direction = -Volume->Direction;
+    }
+
+    if (Volume->Direction > 0) {
+        if (AverageQueueTime >= YORILIB_COMPRESS_QUEUE_LATENCY_THRESHOLD &&
+            Volume->ConcurrencyLimit < CompressContext->MaxThreads) {
+
+            Volume->ConcurrencyLimit++;
+        }
+    } else {
+        if (Volume->ConcurrencyLimit > 1) {
+            Volume->ConcurrencyLimit--;
+        } else {
+            Volume->Direction = 1;
+        }
+    }
+
+    if (CompressContext->Verbose) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                      _T("Volume %y: %lli bytes/sec, %i ms queue latency, concurrency %i\n"),
+                      &Volume->VolumeName,
+                      Throughput,
+                      AverageQueueTime,
+                      Volume->ConcurrencyLimit);
+    }
+
+    Volume->LastThroughput = Throughput;
+    Volume->IntervalStart = GetTickCount();
+    Volume->IntervalBytes = 0;
+    Volume->IntervalItemsStarted = 0;
+    Volume->IntervalQueueTime = 0;
+}
+
 /**
  A background thread which will attempt to compress any items that it finds on
  a list of files requiring compression.
@@ -426,7 +1061,10 @@ YoriLibCompressWorker(
     PYORILIB_COMPRESS_CONTEXT CompressContext = (PYORILIB_COMPRESS_CONTEXT)Context;
     DWORD FoundEvent;
     PYORILIB_PENDING_ACTION PendingAction;
+    PYORILIB_COMPRESS_VOLUME Volume;
+    DWORDLONG BytesProcessed;
     BOOL Result = TRUE;
+    BOOL MoreQueued;
 
     while (TRUE) {
 
@@ -437,32 +1075,40 @@ YoriLibCompressWorker(
         FoundEvent = WaitForMultipleObjectsEx(2, &CompressContext->WorkerWaitEvent, FALSE, INFINITE, FALSE);
 
         //
-        //  Process any queued work.
+        //  Process any queued work that volume limits allow.
         //
 
         while (TRUE) {
             WaitForSingleObject(CompressContext->Mutex, INFINITE);
-            if (!YoriLibIsListEmpty(&CompressContext->PendingList)) {
-                PendingAction = CONTAINING_RECORD(CompressContext->PendingList.Next, YORILIB_PENDING_ACTION, CompressList);
-                ASSERT(CompressContext->ItemsQueued > 0);
-                CompressContext->ItemsQueued--;
-                YoriLibRemoveListItem(&PendingAction->CompressList);
-                ReleaseMutex(CompressContext->Mutex);
-
-                if (PendingAction->Compress) {
-                    if (!YoriLibCompressSingleFile(PendingAction, CompressContext->CompressionAlgorithm)) {
-                        Result = FALSE;
-                    }
-                } else {
-                    if (!YoriLibDecompressSingleFile(PendingAction)) {
-                        Result = FALSE;
-                    }
-                }
+            PendingAction = YoriLibGetNextCompressAction(CompressContext);
+            ReleaseMutex(CompressContext->Mutex);
+            if (PendingAction == NULL) {
+                break;
+            }
 
+            Volume = PendingAction->Volume;
+            if (PendingAction->Compress) {
+                if (!YoriLibCompressSingleFile(PendingAction, CompressContext, &BytesProcessed)) {
+                    Result = FALSE;
+                }
             } else {
-                ASSERT(CompressContext->ItemsQueued == 0);
-                ReleaseMutex(CompressContext->Mutex);
-                break;
+                if (!YoriLibDecompressSingleFile(PendingAction, &BytesProcessed)) {
+                    Result = FALSE;
+                }
+            }
+
+            WaitForSingleObject(CompressContext->Mutex, INFINITE);
+            YoriLibCompleteCompressAction(CompressContext, Volume, BytesProcessed);
+            MoreQueued = (CompressContext->ItemsQueued > 0);
+            ReleaseMutex(CompressContext->Mutex);
+
+            //
+            //  If the volume's limit was raised, another thread may be able
+            //  to start processing an item that was previously blocked.
+            //
+
+            if (MoreQueued) {
+                SetEvent(CompressContext->WorkerWaitEvent);
             }
         }
 
@@ -478,11 +1124,115 @@ YoriLibCompressWorker(
     return Result;
 }
 
+/**
+ Find the volume containing a file, and allocate a structure to describe
+ it if no file on that volume has been queued previously.  Since files are
+ usually queued a directory at a time, the volume of the previous file is
+ used if the file is in the same directory.  Files can be queued from
+ multiple threads, so the previous directory is only accessed with the
+ mutex held.
+
+ @param CompressContext Pointer to the compress context.
+
+ @param FileName Pointer to the full path to the file.
+
+ @return Pointer to the volume, or NULL on allocation failure.
+ */
+PYORILIB_COMPRESS_VOLUME
+YoriLibGetCompressVolume(
+    __in PYORILIB_COMPRESS_CONTEXT CompressContext,
+    __in PYORI_STRING FileName
+    )
+{
+    YORI_STRING ParentDirectory;
+    YORI_STRING VolumeName;
+    LPTSTR FinalSeperator;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORILIB_COMPRESS_VOLUME Volume;
+
+    YoriLibInitEmptyString(&ParentDirectory);
+    FinalSeperator = YoriLibFindRightMostCharacter(FileName, '\\');
+    if (FinalSeperator != NULL) {
+        ParentDirectory.StartOfString = FileName->StartOfString;
+        ParentDirectory.LengthInChars = (YORI_ALLOC_SIZE_T)(FinalSeperator - FileName->StartOfString);
+    }
+
+    WaitForSingleObject(CompressContext->Mutex, INFINITE);
+    if (CompressContext->LastVolume != NULL &&
+        YoriLibCompareStringIns(&ParentDirectory, &CompressContext->LastParentDirectory) == 0) {
+
+        Volume = CompressContext->LastVolume;
+        ReleaseMutex(CompressContext->Mutex);
+        return Volume;
+    }
+    ReleaseMutex(CompressContext->Mutex);
+
+    YoriLibInitEmptyString(&VolumeName);
+    if (!YoriLibGetVolumePathName(FileName, &VolumeName)) {
+        YoriLibFreeStringContents(&VolumeName);
+    }
+
+    //
+    //  Workers move volumes within the list, so the list can only be
+    //  searched with the mutex held.
+    //
+
+    WaitForSingleObject(CompressContext->Mutex, INFINITE);
+    Volume = NULL;
+    ListEntry = YoriLibGetNextListEntry(&CompressContext->VolumeList, NULL);
+    while (ListEntry != NULL) {
+        Volume = CONTAINING_RECORD(ListEntry, YORILIB_COMPRESS_VOLUME, VolumeList);
+        if (YoriLibCompareStringIns(&Volume->VolumeName, &VolumeName) == 0) {
+            break;
+        }
+        Volume = NULL;
+        ListEntry = YoriLibGetNextListEntry(&CompressContext->VolumeList, ListEntry);
+    }
+
+    if (Volume == NULL) {
+        Volume = YoriLibMalloc(sizeof(YORILIB_COMPRESS_VOLUME));
+        if (Volume == NULL) {
+            ReleaseMutex(CompressContext->Mutex);
+            YoriLibFreeStringContents(&VolumeName);
+            return NULL;
+        }
+
+        ZeroMemory(Volume, sizeof(YORILIB_COMPRESS_VOLUME));
+        YoriLibCloneString(&Volume->VolumeName, &VolumeName);
+        YoriLibInitializeListHead(&Volume->PendingList);
+        Volume->ConcurrencyLimit = YORILIB_COMPRESS_INITIAL_CONCURRENCY;
+        if (Volume->ConcurrencyLimit > CompressContext->MaxThreads) {
+            Volume->ConcurrencyLimit = CompressContext->MaxThreads;
+        }
+        Volume->Direction = 1;
+        Volume->IntervalStart = GetTickCount();
+        YoriLibAppendList(&CompressContext->VolumeList, &Volume->VolumeList);
+    }
+
+    //
+    //  Remember the directory so the next file in it doesn't need to
+    //  resolve its volume again.
+    //
+
+    YoriLibFreeStringContents(&CompressContext->LastParentDirectory);
+    CompressContext->LastVolume = NULL;
+    if (YoriLibAllocateString(&CompressContext->LastParentDirectory, ParentDirectory.LengthInChars + 1)) {
+        memcpy(CompressContext->LastParentDirectory.StartOfString, ParentDirectory.StartOfString, ParentDirectory.LengthInChars * sizeof(TCHAR));
+        CompressContext->LastParentDirectory.LengthInChars = ParentDirectory.LengthInChars;
+        CompressContext->LastParentDirectory.StartOfString[ParentDirectory.LengthInChars] = '\0';
+        CompressContext->LastVolume = Volume;
+    }
+    ReleaseMutex(CompressContext->Mutex);
+    YoriLibFreeStringContents(&VolumeName);
+
+    return Volume;
+}
+
 /**
  Add a pending action to the queue of items to be performed by background
  threads.  If the background threads already have an excessively large
- queue of work, this function returns FALSE to indicate it should be
- completed by the foreground thread.
+ queue of work for the file's volume, this function returns FALSE to
+ indicate it should be completed by the foreground thread.
 
  @param CompressContext Pointer to the compress context describing the state
         of background threads.
@@ -500,10 +1250,34 @@ YoriLibAddToBackgroundCompressQueue(
 {
     BOOL Result = FALSE;
     DWORD ThreadId;
+    PYORILIB_COMPRESS_VOLUME Volume;
+    PYORI_LIST_ENTRY ListEntry;
+    YORI_ALLOC_SIZE_T TotalConcurrency;
+
+    Volume = YoriLibGetCompressVolume(CompressContext, &PendingAction->FileName);
+    if (Volume == NULL) {
+        return FALSE;
+    }
+
+    PendingAction->Volume = Volume;
 
     WaitForSingleObject(CompressContext->Mutex, INFINITE);
+
+    //
+    //  Create a new thread if the combined limits of all volumes allow more
+    //  items to be processed than there are threads, and work is waiting.
+    //
+
+    TotalConcurrency = 0;
+    ListEntry = YoriLibGetNextListEntry(&CompressContext->VolumeList, NULL);
+    while (ListEntry != NULL) {
+        TotalConcurrency = TotalConcurrency + CONTAINING_RECORD(ListEntry, YORILIB_COMPRESS_VOLUME, VolumeList)->ConcurrencyLimit;
+        ListEntry = YoriLibGetNextListEntry(&CompressContext->VolumeList, ListEntry);
+    }
+
     if (CompressContext->ThreadsAllocated == 0 ||
-        (CompressContext->ItemsQueued > CompressContext->ThreadsAllocated * 2 &&
+        (CompressContext->ItemsQueued > 0 &&
+         CompressContext->ThreadsAllocated < TotalConcurrency &&
          CompressContext->ThreadsAllocated < CompressContext->MaxThreads)) {
 
         CompressContext->Threads[CompressContext->ThreadsAllocated] = CreateThread(NULL, 0, YoriLibCompressWorker, CompressContext, 0, &ThreadId);
@@ -516,9 +1290,11 @@ YoriLibAddToBackgroundCompressQueue(
     }
 
     if (CompressContext->ThreadsAllocated > 0 &&
-        CompressContext->ItemsQueued < CompressContext->MaxThreads * 2) {
+        Volume->ItemsQueued < Volume->ConcurrencyLimit * 2) {
 
-        YoriLibAppendList(&CompressContext->PendingList, &PendingAction->CompressList);
+        PendingAction->QueuedTime = GetTickCount();
+        YoriLibAppendList(&Volume->PendingList, &PendingAction->CompressList);
+        Volume->ItemsQueued++;
         CompressContext->ItemsQueued++;
         Result = TRUE;
     }
@@ -580,7 +1356,7 @@ YoriLibCompressFileInBackground(
         if (CompressContext->Verbose) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Compressing %y on main thread for back pressure\n"), FileName);
         }
-        if (!YoriLibCompressSingleFile(PendingAction, CompressContext->CompressionAlgorithm)) {
+        if (!YoriLibCompressSingleFile(PendingAction, CompressContext, NULL)) {
             Result = FALSE;
         }
     }
@@ -639,7 +1415,7 @@ YoriLibDecompressFileInBackground(
         if (CompressContext->Verbose) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Decompressing %y on main thread for back pressure\n"), FileName);
         }
-        if (!YoriLibDecompressSingleFile(PendingAction)) {
+        if (!YoriLibDecompressSingleFile(PendingAction, NULL)) {
             Result = FALSE;
         }
     }
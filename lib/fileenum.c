@@ -3,7 +3,7 @@
  *
  * Yori file enumeration routines
  *
- * Copyright (c) 2017-2018 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -91,6 +91,199 @@ typedef struct _YORILIB_FOREACHFILE_CONTEXT {
 
 } YORILIB_FOREACHFILE_CONTEXT, *PYORILIB_FOREACHFILE_CONTEXT;
 
+/**
+ Indicates that an internal enumerate should execute the phase which
+ recurses into child directories.
+ */
+#define YORILIB_FOREACHFILE_PHASE_RECURSE        0x0001
+
+/**
+ Indicates that an internal enumerate should execute the phase which reports
+ matching objects to the caller.
+ */
+#define YORILIB_FOREACHFILE_PHASE_REPORT         0x0002
+
+/**
+ Indicates that an internal enumerate should execute all phases.
+ */
+#define YORILIB_FOREACHFILE_PHASE_ALL            (YORILIB_FOREACHFILE_PHASE_RECURSE | YORILIB_FOREACHFILE_PHASE_REPORT)
+
+/**
+ The maximum number of threads to use for a parallel enumerate.
+ */
+#define YORILIB_FILEENUM_MAX_PARALLEL_THREADS    32
+
+/**
+ The number of items to allocate in a worker's deque initially.  This is
+ grown as needed.
+ */
+#define YORILIB_FILEENUM_INITIAL_DEQUE_SIZE      64
+
+/**
+ A single directory to enumerate as part of a parallel enumerate.
+ */
+typedef struct _YORILIB_FILEENUM_PARALLEL_ITEM {
+
+    /**
+     Pointer to the item that describes the parent directory.  This is NULL
+     for the top level item supplied by the caller.
+     */
+    struct _YORILIB_FILEENUM_PARALLEL_ITEM *Parent;
+
+    /**
+     The number of operations that must complete before this item is
+     complete.  This includes one reference for enumerating the directory
+     itself, plus one reference for each child directory that has been
+     queued.
+     */
+    LONG PendingCount;
+
+    /**
+     The recursion depth of this item.
+     */
+    DWORD Depth;
+
+    /**
+     If TRUE, objects in this directory should be reported after all child
+     directories have been completely processed.  If FALSE, objects are
+     reported while the directory is initially enumerated.
+     */
+    BOOLEAN DeferReport;
+
+    /**
+     The search criteria to enumerate.  This string is allocated as part of
+     this structure.
+     */
+    YORI_STRING FileSpec;
+
+} YORILIB_FILEENUM_PARALLEL_ITEM, *PYORILIB_FILEENUM_PARALLEL_ITEM;
+
+/**
+ Forward declaration of the context describing a parallel enumerate.
+ */
+typedef struct _YORILIB_FILEENUM_PARALLEL_CONTEXT *PYORILIB_FILEENUM_PARALLEL_CONTEXT;
+
+/**
+ State for a single thread participating in a parallel enumerate.  Each
+ worker has a deque of items.  The worker pushes and pops items from the
+ bottom of its own deque, which keeps the enumerate approximately depth
+ first and bounds memory usage, while idle workers steal items from the
+ top of other workers' deques, which tend to be the largest subtrees.
+ */
+typedef struct _YORILIB_FILEENUM_WORKER {
+
+    /**
+     Pointer to the parallel enumerate that this worker is part of.
+     */
+    PYORILIB_FILEENUM_PARALLEL_CONTEXT Parallel;
+
+    /**
+     A mutex protecting the deque of items for this worker.
+     */
+    HANDLE Mutex;
+
+    /**
+     Handle to the thread executing this worker.  This is NULL for the
+     thread that initiated the enumerate.
+     */
+    HANDLE Thread;
+
+    /**
+     The item currently being processed by this worker.  Any child
+     directories found are queued as children of this item.
+     */
+    PYORILIB_FILEENUM_PARALLEL_ITEM CurrentItem;
+
+    /**
+     An array of pointers to items queued to this worker.
+     */
+    PYORILIB_FILEENUM_PARALLEL_ITEM *Items;
+
+    /**
+     The index of the oldest item in the deque.  Other workers steal from
+     this end.
+     */
+    DWORD Top;
+
+    /**
+     The index one beyond the most recently queued item in the deque.  This
+     worker pushes and pops from this end.
+     */
+    DWORD Bottom;
+
+    /**
+     The number of elements allocated in the Items array.
+     */
+    DWORD ItemsAllocated;
+
+} YORILIB_FILEENUM_WORKER, *PYORILIB_FILEENUM_WORKER;
+
+/**
+ State describing a parallel enumerate.
+ */
+typedef struct _YORILIB_FILEENUM_PARALLEL_CONTEXT {
+
+    /**
+     The flags describing the enumerate.
+     */
+    WORD MatchFlags;
+
+    /**
+     Set to TRUE if any operation has failed and the enumerate should be
+     abandoned.
+     */
+    BOOLEAN Abort;
+
+    /**
+     The number of workers in the Workers array.  The first entry refers to
+     the thread that initiated the enumerate.
+     */
+    DWORD WorkerCount;
+
+    /**
+     The number of items which have been queued but not yet completed.  When
+     this reaches zero, the enumerate is complete.
+     */
+    LONG OutstandingItems;
+
+    /**
+     The callback to invoke on each match.
+     */
+    PYORILIB_FILE_ENUM_FN Callback;
+
+    /**
+     Optionally points to the callback to invoke on each error.
+     */
+    PYORILIB_FILE_ENUM_ERROR_FN ErrorCallback;
+
+    /**
+     Caller provided context to pass to callbacks.
+     */
+    PVOID Context;
+
+    /**
+     A mutex used to serialize callbacks, unless the caller has indicated
+     that callbacks can be invoked concurrently.
+     */
+    HANDLE CallbackMutex;
+
+    /**
+     An auto reset event signalled when work has been queued.
+     */
+    HANDLE WorkAvailableEvent;
+
+    /**
+     A manual reset event signalled when all work has completed.
+     */
+    HANDLE CompleteEvent;
+
+    /**
+     An array of workers.
+     */
+    PYORILIB_FILEENUM_WORKER Workers;
+
+} YORILIB_FILEENUM_PARALLEL_CONTEXT;
+
 /**
  If a string contains a directory that ends with a seperator, and it's not
  referring to a drive root, remove the seperator.
@@ -134,6 +327,376 @@ YoriLibTruncateTrailingSeperatorIfBenign(
     }
 }
 
+/**
+ Set to TRUE if the system has been found to not support basic information
+ or large fetch enumeration, so subsequent enumerates should not attempt it.
+ */
+BOOLEAN YoriLibFileEnumBasicInfoUnsupported;
+
+/**
+ Start a directory enumerate.  If the caller does not need short file names,
+ this requests basic information with a large fetch buffer where the system
+ supports it, and otherwise falls back to a regular FindFirstFile.
+
+ @param FileSpec Pointer to a NULL terminated search criteria.
+
+ @param MatchFlags Specifies the behavior of the enumerate.  This routine
+        checks for YORILIB_FILEENUM_BASIC_INFO.
+
+ @param FindData On successful completion, populated with information about
+        the first object found.
+
+ @return A handle to the find operation, or INVALID_HANDLE_VALUE on failure.
+ */
+HANDLE
+YoriLibFileEnumFindFirstFile(
+    __in LPCTSTR FileSpec,
+    __in WORD MatchFlags,
+    __out PWIN32_FIND_DATA FindData
+    )
+{
+    HANDLE hFind;
+
+    if ((MatchFlags & YORILIB_FILEENUM_BASIC_INFO) != 0 &&
+        DllKernel32.pFindFirstFileExW != NULL &&
+        !YoriLibFileEnumBasicInfoUnsupported) {
+
+        hFind = DllKernel32.pFindFirstFileExW(FileSpec,
+                                              YoriFindExInfoBasic,
+                                              FindData,
+                                              YoriFindExSearchNameMatch,
+                                              NULL,
+                                              FIND_FIRST_EX_LARGE_FETCH);
+
+        if (hFind != INVALID_HANDLE_VALUE) {
+            return hFind;
+        }
+
+        //
+        //  Systems prior to Windows 7 support FindFirstFileEx but not basic
+        //  information or large fetch, and fail with invalid parameter.
+        //  Any other error is a real error, and retrying would yield the
+        //  same result.
+        //
+
+        if (GetLastError() != ERROR_INVALID_PARAMETER) {
+            return hFind;
+        }
+
+        YoriLibFileEnumBasicInfoUnsupported = TRUE;
+    }
+
+    return FindFirstFile(FileSpec, FindData);
+}
+
+/**
+ Invoke the caller's callback for an object found during enumerate.  If the
+ enumerate is parallel, and the caller has not indicated that callbacks can
+ execute concurrently, this serializes the callback with respect to other
+ workers.
+
+ @param Worker Optionally points to the worker performing a parallel
+        enumerate.  If NULL, the enumerate is executing on a single thread.
+
+ @param Callback The callback to invoke.
+
+ @param FilePath Pointer to the full path of the object found.
+
+ @param FileInfo Pointer to information about the object found.
+
+ @param Depth The recursion depth of the object.
+
+ @param Context Caller provided context to pass to the callback.
+
+ @return The result of the callback.  TRUE to continue enumerating, FALSE to
+         abort.
+ */
+BOOL
+YoriLibFileEnumInvokeCallback(
+    __in_opt PYORILIB_FILEENUM_WORKER Worker,
+    __in PYORILIB_FILE_ENUM_FN Callback,
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in_opt PVOID Context
+    )
+{
+    BOOL Result;
+    PYORILIB_FILEENUM_PARALLEL_CONTEXT Parallel;
+
+    if (Worker == NULL) {
+        return Callback(FilePath, FileInfo, Depth, Context);
+    }
+
+    Parallel = Worker->Parallel;
+    if (Parallel->CallbackMutex == NULL) {
+        return Callback(FilePath, FileInfo, Depth, Context);
+    }
+
+    WaitForSingleObject(Parallel->CallbackMutex, INFINITE);
+    Result = Callback(FilePath, FileInfo, Depth, Context);
+    ReleaseMutex(Parallel->CallbackMutex);
+    return Result;
+}
+
+/**
+ Invoke the caller's error callback for a directory that could not be
+ enumerated.  If the enumerate is parallel, and the caller has not indicated
+ that callbacks can execute concurrently, this serializes the callback with
+ respect to other workers.
+
+ @param Worker Optionally points to the worker performing a parallel
+        enumerate.  If NULL, the enumerate is executing on a single thread.
+
+ @param ErrorCallback The callback to invoke.
+
+ @param FilePath Pointer to the path that could not be enumerated.
+
+ @param ErrorCode The Win32 error code describing the failure.
+
+ @param Depth The recursion depth of the object.
+
+ @param Context Caller provided context to pass to the callback.
+
+ @return The result of the callback.  TRUE to continue enumerating, FALSE to
+         abort.
+ */
+BOOL
+YoriLibFileEnumInvokeErrorCallback(
+    __in_opt PYORILIB_FILEENUM_WORKER Worker,
+    __in PYORILIB_FILE_ENUM_ERROR_FN ErrorCallback,
+    __in PYORI_STRING FilePath,
+    __in DWORD ErrorCode,
+    __in DWORD Depth,
+    __in_opt PVOID Context
+    )
+{
+    BOOL Result;
+    PYORILIB_FILEENUM_PARALLEL_CONTEXT Parallel;
+
+    if (Worker == NULL) {
+        return ErrorCallback(FilePath, ErrorCode, Depth, Context);
+    }
+
+    Parallel = Worker->Parallel;
+    if (Parallel->CallbackMutex == NULL) {
+        return ErrorCallback(FilePath, ErrorCode, Depth, Context);
+    }
+
+    WaitForSingleObject(Parallel->CallbackMutex, INFINITE);
+    Result = ErrorCallback(FilePath, ErrorCode, Depth, Context);
+    ReleaseMutex(Parallel->CallbackMutex);
+    return Result;
+}
+
+/**
+ Allocate a parallel item describing a directory to enumerate.
+
+ @param Parent Optionally points to the item describing the parent
+        directory.
+
+ @param FileSpec The search criteria to enumerate.  This is copied into the
+        new item.
+
+ @param Depth The recursion depth of the new item.
+
+ @param DeferReport TRUE if objects should be reported after all children
+        have been processed, FALSE if they should be reported during the
+        initial enumerate.
+
+ @return Pointer to the newly allocated item, or NULL on allocation failure.
+ */
+PYORILIB_FILEENUM_PARALLEL_ITEM
+YoriLibFileEnumAllocateParallelItem(
+    __in_opt PYORILIB_FILEENUM_PARALLEL_ITEM Parent,
+    __in PYORI_STRING FileSpec,
+    __in DWORD Depth,
+    __in BOOLEAN DeferReport
+    )
+{
+    PYORILIB_FILEENUM_PARALLEL_ITEM Item;
+
+    if (!YoriLibIsSizeAllocatable(sizeof(YORILIB_FILEENUM_PARALLEL_ITEM) + ((YORI_MAX_UNSIGNED_T)FileSpec->LengthInChars + 1) * sizeof(TCHAR))) {
+        return NULL;
+    }
+
+    Item = YoriLibMalloc(sizeof(YORILIB_FILEENUM_PARALLEL_ITEM) + (FileSpec->LengthInChars + 1) * sizeof(TCHAR));
+    if (Item == NULL) {
+        return NULL;
+    }
+
+    Item->Parent = Parent;
+    Item->PendingCount = 1;
+    Item->Depth = Depth;
+    Item->DeferReport = DeferReport;
+    YoriLibInitEmptyString(&Item->FileSpec);
+    Item->FileSpec.StartOfString = (LPTSTR)(Item + 1);
+    Item->FileSpec.LengthInChars = FileSpec->LengthInChars;
+    Item->FileSpec.LengthAllocated = FileSpec->LengthInChars + 1;
+    memcpy(Item->FileSpec.StartOfString, FileSpec->StartOfString, FileSpec->LengthInChars * sizeof(TCHAR));
+    Item->FileSpec.StartOfString[FileSpec->LengthInChars] = '\0';
+
+    return Item;
+}
+
+/**
+ Push an item onto the bottom of a worker's deque.
+
+ @param Worker Pointer to the worker whose deque should be updated.
+
+ @param Item Pointer to the item to push.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibFileEnumPushParallelItem(
+    __in PYORILIB_FILEENUM_WORKER Worker,
+    __in PYORILIB_FILEENUM_PARALLEL_ITEM Item
+    )
+{
+    PYORILIB_FILEENUM_PARALLEL_ITEM *NewItems;
+    DWORD NewAllocated;
+    DWORD Count;
+
+    WaitForSingleObject(Worker->Mutex, INFINITE);
+
+    //
+    //  If the end of the array has been reached, either move the live
+    //  items to the start of the array, or if the array is mostly in use,
+    //  reallocate it.
+    //
+
+    if (Worker->Bottom == Worker->ItemsAllocated) {
+        Count = Worker->Bottom - Worker->Top;
+        if (Worker->Top >= Worker->ItemsAllocated / 2) {
+            memmove(Worker->Items, &Worker->Items[Worker->Top], Count * sizeof(PYORILIB_FILEENUM_PARALLEL_ITEM));
+        } else {
+            NewAllocated = Worker->ItemsAllocated * 2;
+            if (NewAllocated < YORILIB_FILEENUM_INITIAL_DEQUE_SIZE) {
+                NewAllocated = YORILIB_FILEENUM_INITIAL_DEQUE_SIZE;
+            }
+            if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)NewAllocated * sizeof(PYORILIB_FILEENUM_PARALLEL_ITEM))) {
+                ReleaseMutex(Worker->Mutex);
+                return FALSE;
+            }
+            NewItems = YoriLibMalloc(NewAllocated * sizeof(PYORILIB_FILEENUM_PARALLEL_ITEM));
+            if (NewItems == NULL) {
+                ReleaseMutex(Worker->Mutex);
+                return FALSE;
+            }
+            if (Count > 0) {
+                memcpy(NewItems, &Worker->Items[Worker->Top], Count * sizeof(PYORILIB_FILEENUM_PARALLEL_ITEM));
+            }
+            if (Worker->Items != NULL) {
+                YoriLibFree(Worker->Items);
+            }
+            Worker->Items = NewItems;
+            Worker->ItemsAllocated = NewAllocated;
+        }
+        Worker->Top = 0;
+        Worker->Bottom = Count;
+    }
+
+    Worker->Items[Worker->Bottom] = Item;
+    Worker->Bottom++;
+    ReleaseMutex(Worker->Mutex);
+
+    SetEvent(Worker->Parallel->WorkAvailableEvent);
+    return TRUE;
+}
+
+/**
+ Take an item from a worker's deque.  The worker which owns the deque takes
+ its most recently pushed item, while other workers steal the oldest item.
+
+ @param Worker Pointer to the worker whose deque should be examined.
+
+ @param Steal TRUE if the caller is not the owner of the deque and should
+        take the oldest item, FALSE if the caller owns the deque and should
+        take the most recent item.
+
+ @param MoreAvailable On successful completion, set to TRUE if the deque
+        still contains items after this item was removed.
+
+ @return Pointer to the item, or NULL if the deque is empty.
+ */
+PYORILIB_FILEENUM_PARALLEL_ITEM
+YoriLibFileEnumTakeParallelItem(
+    __in PYORILIB_FILEENUM_WORKER Worker,
+    __in BOOLEAN Steal,
+    __out PBOOLEAN MoreAvailable
+    )
+{
+    PYORILIB_FILEENUM_PARALLEL_ITEM Item;
+
+    Item = NULL;
+    *MoreAvailable = FALSE;
+    WaitForSingleObject(Worker->Mutex, INFINITE);
+    if (Worker->Bottom > Worker->Top) {
+        if (Steal) {
+            Item = Worker->Items[Worker->Top];
+            Worker->Top++;
+        } else {
+            Worker->Bottom--;
+            Item = Worker->Items[Worker->Bottom];
+        }
+        if (Worker->Bottom == Worker->Top) {
+            Worker->Top = 0;
+            Worker->Bottom = 0;
+        } else {
+            *MoreAvailable = TRUE;
+        }
+    }
+    ReleaseMutex(Worker->Mutex);
+    return Item;
+}
+
+/**
+ Queue a child directory for enumeration as part of a parallel enumerate.
+
+ @param Worker Pointer to the worker that found the child directory.  The
+        child is recorded as a child of this worker's current item.
+
+ @param FileSpec The search criteria to enumerate within the child.
+
+ @param Depth The recursion depth of the child.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibFileEnumQueueParallelChild(
+    __in PYORILIB_FILEENUM_WORKER Worker,
+    __in PYORI_STRING FileSpec,
+    __in DWORD Depth
+    )
+{
+    PYORILIB_FILEENUM_PARALLEL_CONTEXT Parallel;
+    PYORILIB_FILEENUM_PARALLEL_ITEM Parent;
+    PYORILIB_FILEENUM_PARALLEL_ITEM Item;
+
+    Parallel = Worker->Parallel;
+    Parent = Worker->CurrentItem;
+
+    Item = YoriLibFileEnumAllocateParallelItem(Parent, FileSpec, Depth, Parent->DeferReport);
+    if (Item == NULL) {
+        return FALSE;
+    }
+
+    InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&Parent->PendingCount);
+    InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&Parallel->OutstandingItems);
+
+    if (!YoriLibFileEnumPushParallelItem(Worker, Item)) {
+        InterlockedDecrement((INTERLOCKED_VOLATILE LONG *)&Parent->PendingCount);
+        InterlockedDecrement((INTERLOCKED_VOLATILE LONG *)&Parallel->OutstandingItems);
+        YoriLibFree(Item);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  Call a callback for every file matching a specified file pattern.
 
@@ -152,16 +715,28 @@ YoriLibTruncateTrailingSeperatorIfBenign(
         about failures and wants to silently continue.
 
  @param Context Caller provided context to pass to the callback.
+
+ @param Worker Optionally points to the worker performing a parallel
+        enumerate.  If specified, child directories are queued to the
+        worker rather than being enumerated recursively.
+
+ @param PhasesToRun Specifies which phases of the enumerate to perform.  A
+        parallel enumerate which reports objects after their children
+        performs the recursion phase and the report phase separately.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
  */
 __success(return)
 BOOL
-YoriLibForEachFileEnum(
+YoriLibForEachFileEnumInternal(
     __in PYORI_STRING FileSpec,
     __in WORD MatchFlags,
     __in DWORD Depth,
     __in PYORILIB_FILE_ENUM_FN Callback,
     __in_opt PYORILIB_FILE_ENUM_ERROR_FN ErrorCallback,
-    __in_opt PVOID Context
+    __in_opt PVOID Context,
+    __in_opt PYORILIB_FILEENUM_WORKER Worker,
+    __in WORD PhasesToRun
     )
 {
     HANDLE hFind;
@@ -172,6 +747,7 @@ YoriLibForEachFileEnum(
     BOOLEAN RecursePhase;
     BOOLEAN IsLink;
     BOOLEAN TrailingSlashInParentComponent;
+    DWORD EntriesFound;
     PYORILIB_FOREACHFILE_CONTEXT ForEachContext = NULL;
 
     Result = TRUE;
@@ -374,6 +950,24 @@ YoriLibForEachFileEnum(
             }
         }
 
+        //
+        //  If the caller only wants a subset of phases, skip any that are
+        //  not requested.
+        //
+
+        if (RecursePhase) {
+            if ((PhasesToRun & YORILIB_FOREACHFILE_PHASE_RECURSE) == 0) {
+                continue;
+            }
+        } else {
+            if ((PhasesToRun & YORILIB_FOREACHFILE_PHASE_REPORT) == 0) {
+                continue;
+            }
+        }
+
+        YoriLibTraceBegin(YORI_LIB_TRACE_FILEENUM, _T("FileEnum"), &ForEachContext->ParentFullPath, 0);
+        EntriesFound = 0;
+
         //
         //  If we're recursing but should apply the file match pattern on
         //  every subdirectory, brew up a new search criteria now for "*"
@@ -388,7 +982,7 @@ YoriLibForEachFileEnum(
                                 ForEachContext->FullPath.LengthAllocated,
                                 _T("%y\\*"),
                                 &ForEachContext->ParentFullPath);
-            hFind = FindFirstFile(ForEachContext->FullPath.StartOfString, &ForEachContext->FileInfo);
+            hFind = YoriLibFileEnumFindFirstFile(ForEachContext->FullPath.StartOfString, MatchFlags, &ForEachContext->FileInfo);
         } else {
             if (FinalSlashFound) {
 
@@ -439,7 +1033,7 @@ YoriLibForEachFileEnum(
                                         &ForEachContext->EffectiveFileSpec);
                 }
             }
-            hFind = FindFirstFile(ForEachContext->FullPath.StartOfString, &ForEachContext->FileInfo);
+            hFind = YoriLibFileEnumFindFirstFile(ForEachContext->FullPath.StartOfString, MatchFlags, &ForEachContext->FileInfo);
 
             //
             //  If we can't enumerate it because it's a volume root, cook up
@@ -461,8 +1055,9 @@ YoriLibForEachFileEnum(
         }
 
         if (hFind == INVALID_HANDLE_VALUE) {
+            YoriLibTraceEnd(YORI_LIB_TRACE_FILEENUM, _T("FileEnum"), &ForEachContext->ParentFullPath, 0);
             if (ErrorCallback != NULL) {
-                if (!ErrorCallback(&ForEachContext->FullPath, GetLastError(), Depth, Context)) {
+                if (!YoriLibFileEnumInvokeErrorCallback(Worker, ErrorCallback, &ForEachContext->FullPath, GetLastError(), Depth, Context)) {
                     Result = FALSE;
                 }
                 break;
@@ -472,6 +1067,7 @@ YoriLibForEachFileEnum(
 
                 ReportObject = TRUE;
                 DotFile = FALSE;
+                EntriesFound++;
 
                 //
                 //  If the result is . or .., it's never interesting.  The caller
@@ -574,7 +1170,12 @@ YoriLibForEachFileEnum(
                         ForEachContext->RecurseCriteria.StartOfString[ForEachContext->RecurseCriteria.LengthInChars] = '\0';
                     }
 
-                    if (!YoriLibForEachFileEnum(&ForEachContext->RecurseCriteria, MatchFlags, Depth + 1, Callback, ErrorCallback, Context)) {
+                    if (Worker != NULL) {
+                        if (!YoriLibFileEnumQueueParallelChild(Worker, &ForEachContext->RecurseCriteria, Depth + 1)) {
+                            Result = FALSE;
+                            break;
+                        }
+                    } else if (!YoriLibForEachFileEnumInternal(&ForEachContext->RecurseCriteria, MatchFlags, Depth + 1, Callback, ErrorCallback, Context, NULL, YORILIB_FOREACHFILE_PHASE_ALL)) {
                         Result = FALSE;
                         break;
                     }
@@ -582,75 +1183,478 @@ YoriLibForEachFileEnum(
                     YoriLibFreeStringContents(&ForEachContext->RecurseCriteria);
                 }
 
-                //
-                //  Report the object to the caller if we've determined that
-                //  it should be reported.
-                //
+                //
+                //  Report the object to the caller if we've determined that
+                //  it should be reported.
+                //
+
+                if (ReportObject && !RecursePhase) {
+
+                    //
+                    //  Convert the found path into a fully qualified path
+                    //  before reporting it.  If the path ends in a trailing
+                    //  slash, then the directory component is the full path,
+                    //  so adding back cFileName would be bogus.  In this
+                    //  case, there cannot be a wild specification, so only
+                    //  one or zero objects can ever match.
+                    //
+
+                    if (!FinalSlashFound ||
+                        ForEachContext->CharsToFinalSlash != ForEachContext->EffectiveFileSpec.LengthInChars) {
+
+                        if (TrailingSlashInParentComponent) {
+                            ForEachContext->FullPath.LengthInChars =
+                                YoriLibSPrintfS(ForEachContext->FullPath.StartOfString,
+                                                ForEachContext->FullPath.LengthAllocated,
+                                                _T("%y%s"),
+                                                &ForEachContext->ParentFullPath,
+                                                ForEachContext->FileInfo.cFileName);
+                        } else {
+                            ForEachContext->FullPath.LengthInChars =
+                                YoriLibSPrintfS(ForEachContext->FullPath.StartOfString,
+                                                ForEachContext->FullPath.LengthAllocated,
+                                                _T("%y\\%s"),
+                                                &ForEachContext->ParentFullPath,
+                                                ForEachContext->FileInfo.cFileName);
+                        }
+                    }
+
+                    if (!YoriLibFileEnumInvokeCallback(Worker, Callback, &ForEachContext->FullPath, &ForEachContext->FileInfo, Depth, Context)) {
+                        Result = FALSE;
+                        break;
+                    }
+
+                    if (YoriLibIsOperationCancelled()) {
+                        Result = FALSE;
+                        break;
+                    }
+                }
+
+            } while (hFind != INVALID_HANDLE_VALUE && hFind != NULL && FindNextFile(hFind, &ForEachContext->FileInfo));
+
+            YoriLibFreeStringContents(&ForEachContext->RecurseCriteria);
+
+            if (hFind != NULL && hFind != INVALID_HANDLE_VALUE) {
+                FindClose(hFind);
+            }
+
+            YoriLibTraceEnd(YORI_LIB_TRACE_FILEENUM, _T("FileEnum"), &ForEachContext->ParentFullPath, EntriesFound);
+
+            if (Result == FALSE) {
+                break;
+            }
+        }
+    }
+
+    YoriLibFreeStringContents(&ForEachContext->EffectiveFileSpec);
+    YoriLibFreeStringContents(&ForEachContext->ParentFullPath);
+    YoriLibFreeStringContents(&ForEachContext->FullPath);
+    YoriLibFree(ForEachContext);
+
+    return Result;
+}
+
+/**
+ Indicate that an operation on a parallel item has completed.  When all
+ operations on the item are complete, including all of its children, any
+ deferred report phase is performed, the item is deallocated, and its parent
+ is notified.  This may cascade through multiple parents.
+
+ @param Worker Pointer to the worker which completed the operation.
+
+ @param Item Pointer to the item whose operation completed.
+ */
+VOID
+YoriLibFileEnumCompleteParallelItem(
+    __in PYORILIB_FILEENUM_WORKER Worker,
+    __in PYORILIB_FILEENUM_PARALLEL_ITEM Item
+    )
+{
+    PYORILIB_FILEENUM_PARALLEL_CONTEXT Parallel;
+    PYORILIB_FILEENUM_PARALLEL_ITEM Parent;
+
+    Parallel = Worker->Parallel;
+
+    while (Item != NULL) {
+        if (InterlockedDecrement((INTERLOCKED_VOLATILE LONG *)&Item->PendingCount) != 0) {
+            break;
+        }
+
+        //
+        //  Every child of this directory has been processed, so if the
+        //  caller wanted objects reported after their children, report them
+        //  now.
+        //
+
+        if (Item->DeferReport && !Parallel->Abort) {
+            Worker->CurrentItem = Item;
+            if (!YoriLibForEachFileEnumInternal(&Item->FileSpec,
+                                                Parallel->MatchFlags,
+                                                Item->Depth,
+                                                Parallel->Callback,
+                                                Parallel->ErrorCallback,
+                                                Parallel->Context,
+                                                Worker,
+                                                YORILIB_FOREACHFILE_PHASE_REPORT)) {
+                Parallel->Abort = TRUE;
+            }
+            Worker->CurrentItem = NULL;
+        }
+
+        Parent = Item->Parent;
+        YoriLibFree(Item);
+
+        if (InterlockedDecrement((INTERLOCKED_VOLATILE LONG *)&Parallel->OutstandingItems) == 0) {
+            SetEvent(Parallel->CompleteEvent);
+        }
+
+        Item = Parent;
+    }
+}
+
+/**
+ Process items as part of a parallel enumerate until all items have been
+ completed.  Items are taken from the worker's own deque first, and if that
+ is empty, stolen from other workers.  This is executed by each worker
+ thread as well as the thread that initiated the enumerate.
+
+ @param Worker Pointer to the worker processing items.
+ */
+VOID
+YoriLibFileEnumProcessParallelItems(
+    __in PYORILIB_FILEENUM_WORKER Worker
+    )
+{
+    PYORILIB_FILEENUM_PARALLEL_CONTEXT Parallel;
+    PYORILIB_FILEENUM_PARALLEL_ITEM Item;
+    HANDLE WaitHandles[2];
+    BOOLEAN MoreAvailable;
+    DWORD Index;
+    DWORD VictimIndex;
+    WORD PhasesToRun;
+
+    Parallel = Worker->Parallel;
+    WaitHandles[0] = Parallel->CompleteEvent;
+    WaitHandles[1] = Parallel->WorkAvailableEvent;
+    VictimIndex = (DWORD)(Worker - Parallel->Workers);
+
+    while (TRUE) {
+
+        Item = YoriLibFileEnumTakeParallelItem(Worker, FALSE, &MoreAvailable);
+        if (Item == NULL) {
+            for (Index = 1; Index < Parallel->WorkerCount; Index++) {
+                VictimIndex = (VictimIndex + 1) % Parallel->WorkerCount;
+                if (&Parallel->Workers[VictimIndex] == Worker) {
+                    continue;
+                }
+                Item = YoriLibFileEnumTakeParallelItem(&Parallel->Workers[VictimIndex], TRUE, &MoreAvailable);
+                if (Item != NULL) {
+                    break;
+                }
+            }
+        }
+
+        if (Item == NULL) {
+            if (WaitForMultipleObjects(2, WaitHandles, FALSE, INFINITE) == WAIT_OBJECT_0) {
+                break;
+            }
+            continue;
+        }
+
+        //
+        //  The work available event only wakes one waiter.  If more work is
+        //  available, wake another worker to look for it.
+        //
+
+        if (MoreAvailable) {
+            SetEvent(Parallel->WorkAvailableEvent);
+        }
+
+        if (!Parallel->Abort && YoriLibIsOperationCancelled()) {
+            Parallel->Abort = TRUE;
+        }
+
+        if (!Parallel->Abort) {
+            PhasesToRun = YORILIB_FOREACHFILE_PHASE_ALL;
+            if (Item->DeferReport) {
+                PhasesToRun = YORILIB_FOREACHFILE_PHASE_RECURSE;
+            }
+            Worker->CurrentItem = Item;
+            if (!YoriLibForEachFileEnumInternal(&Item->FileSpec,
+                                                Parallel->MatchFlags,
+                                                Item->Depth,
+                                                Parallel->Callback,
+                                                Parallel->ErrorCallback,
+                                                Parallel->Context,
+                                                Worker,
+                                                PhasesToRun)) {
+                Parallel->Abort = TRUE;
+            }
+            Worker->CurrentItem = NULL;
+        }
+
+        YoriLibFileEnumCompleteParallelItem(Worker, Item);
+    }
+}
+
+/**
+ The entrypoint for a worker thread in a parallel enumerate.
+
+ @param Context Pointer to the worker.
+
+ @return Exit code for the thread, currently always zero.
+ */
+DWORD WINAPI
+YoriLibFileEnumParallelWorker(
+    __in LPVOID Context
+    )
+{
+    PYORILIB_FILEENUM_WORKER Worker = (PYORILIB_FILEENUM_WORKER)Context;
+    YoriLibFileEnumProcessParallelItems(Worker);
+    return 0;
+}
+
+/**
+ Call a callback for every file matching a specified file pattern, using
+ multiple threads to enumerate child directories concurrently.  Each
+ directory is enumerated by a single thread, so objects within a directory
+ are reported in order, but objects from different directories can be
+ interleaved.  If the caller requested objects to be reported after their
+ children, this is still honored for each directory.
+
+ @param FileSpec The pattern to match against.
+
+ @param MatchFlags Specifies the behavior of the match, including whether
+        it should be applied recursively and the recursing behavior.
+
+ @param Depth Indicates the current recursion depth.
+
+ @param Callback The callback to invoke on each match.
+
+ @param ErrorCallback Optionally points to a function to invoke if a
+        directory cannot be enumerated.  If NULL, the caller does not care
+        about failures and wants to silently continue.
+
+ @param Context Caller provided context to pass to the callback.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibForEachFileEnumParallel(
+    __in PYORI_STRING FileSpec,
+    __in WORD MatchFlags,
+    __in DWORD Depth,
+    __in PYORILIB_FILE_ENUM_FN Callback,
+    __in_opt PYORILIB_FILE_ENUM_ERROR_FN ErrorCallback,
+    __in_opt PVOID Context
+    )
+{
+    YORILIB_FILEENUM_PARALLEL_CONTEXT Parallel;
+    PYORILIB_FILEENUM_PARALLEL_ITEM Item;
+    PYORILIB_FILEENUM_WORKER Worker;
+    PYORI_LIB_CPU_TOPOLOGY Topology;
+    BOOLEAN DeferReport;
+    BOOL Result;
+    WORD PerformanceProcessors;
+    WORD EfficiencyProcessors;
+    DWORD ThreadCount;
+    DWORD ThreadId;
+    DWORD Index;
+
+    //
+    //  Directory enumeration spends most of its time waiting for the file
+    //  system, particularly on network volumes, so use more threads than
+    //  processors.
+    //
+
+    YoriLibQueryCpuCount(&PerformanceProcessors, &EfficiencyProcessors);
+    ThreadCount = ((DWORD)PerformanceProcessors + EfficiencyProcessors) * 2;
+    if (ThreadCount < 2) {
+        ThreadCount = 2;
+    }
+    if (ThreadCount > YORILIB_FILEENUM_MAX_PARALLEL_THREADS) {
+        ThreadCount = YORILIB_FILEENUM_MAX_PARALLEL_THREADS;
+    }
+
+    ZeroMemory(&Parallel, sizeof(Parallel));
+    Parallel.MatchFlags = MatchFlags;
+    Parallel.Callback = Callback;
+    Parallel.ErrorCallback = ErrorCallback;
+    Parallel.Context = Context;
+    Result = FALSE;
+
+    if ((MatchFlags & YORILIB_FILEENUM_CONCURRENT_CALLBACKS) == 0) {
+        Parallel.CallbackMutex = CreateMutex(NULL, FALSE, NULL);
+        if (Parallel.CallbackMutex == NULL) {
+            goto Exit;
+        }
+    }
+
+    Parallel.WorkAvailableEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (Parallel.WorkAvailableEvent == NULL) {
+        goto Exit;
+    }
+
+    Parallel.CompleteEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Parallel.CompleteEvent == NULL) {
+        goto Exit;
+    }
+
+    Parallel.Workers = YoriLibMalloc(ThreadCount * sizeof(YORILIB_FILEENUM_WORKER));
+    if (Parallel.Workers == NULL) {
+        goto Exit;
+    }
+    ZeroMemory(Parallel.Workers, ThreadCount * sizeof(YORILIB_FILEENUM_WORKER));
+
+    for (Index = 0; Index < ThreadCount; Index++) {
+        Worker = &Parallel.Workers[Index];
+        Worker->Parallel = &Parallel;
+        Worker->Mutex = CreateMutex(NULL, FALSE, NULL);
+        if (Worker->Mutex == NULL) {
+            break;
+        }
+        Parallel.WorkerCount++;
+    }
+
+    if (Parallel.WorkerCount == 0) {
+        goto Exit;
+    }
+
+    //
+    //  If both recursion flags are specified, children are enumerated
+    //  before objects in the directory, so this case is the same as
+    //  recursing before return.
+    //
+
+    DeferReport = FALSE;
+    if ((MatchFlags & YORILIB_FILEENUM_RECURSE_BEFORE_RETURN) != 0) {
+        DeferReport = TRUE;
+    }
+
+    Item = YoriLibFileEnumAllocateParallelItem(NULL, FileSpec, Depth, DeferReport);
+    if (Item == NULL) {
+        goto Exit;
+    }
 
-                if (ReportObject && !RecursePhase) {
+    Parallel.OutstandingItems = 1;
+    if (!YoriLibFileEnumPushParallelItem(&Parallel.Workers[0], Item)) {
+        YoriLibFree(Item);
+        goto Exit;
+    }
 
-                    //
-                    //  Convert the found path into a fully qualified path
-                    //  before reporting it.  If the path ends in a trailing
-                    //  slash, then the directory component is the full path,
-                    //  so adding back cFileName would be bogus.  In this
-                    //  case, there cannot be a wild specification, so only
-                    //  one or zero objects can ever match.
-                    //
+    //
+    //  Start the worker threads.  If any fail to start, the enumerate can
+    //  continue with fewer threads.  The first worker is this thread.
+    //  Threads are distributed across processor groups so that systems
+    //  with more than 64 logical processors can use all of them.
+    //
 
-                    if (!FinalSlashFound ||
-                        ForEachContext->CharsToFinalSlash != ForEachContext->EffectiveFileSpec.LengthInChars) {
+    Topology = NULL;
+    YoriLibQueryCpuTopology(&Topology);
 
-                        if (TrailingSlashInParentComponent) {
-                            ForEachContext->FullPath.LengthInChars =
-                                YoriLibSPrintfS(ForEachContext->FullPath.StartOfString,
-                                                ForEachContext->FullPath.LengthAllocated,
-                                                _T("%y%s"),
-                                                &ForEachContext->ParentFullPath,
-                                                ForEachContext->FileInfo.cFileName);
-                        } else {
-                            ForEachContext->FullPath.LengthInChars =
-                                YoriLibSPrintfS(ForEachContext->FullPath.StartOfString,
-                                                ForEachContext->FullPath.LengthAllocated,
-                                                _T("%y\\%s"),
-                                                &ForEachContext->ParentFullPath,
-                                                ForEachContext->FileInfo.cFileName);
-                        }
-                    }
+    for (Index = 1; Index < Parallel.WorkerCount; Index++) {
+        Worker = &Parallel.Workers[Index];
+        Worker->Thread = CreateThread(NULL, 0, YoriLibFileEnumParallelWorker, Worker, CREATE_SUSPENDED, &ThreadId);
+        if (Worker->Thread != NULL) {
+            if (Topology != NULL) {
+                YoriLibPlaceThread(Worker->Thread, Topology, YoriLibCpuClassAny, Index);
+            }
+            ResumeThread(Worker->Thread);
+        }
+    }
 
-                    if (!Callback(&ForEachContext->FullPath, &ForEachContext->FileInfo, Depth, Context)) {
-                        Result = FALSE;
-                        break;
-                    }
+    if (Topology != NULL) {
+        YoriLibFree(Topology);
+    }
 
-                    if (YoriLibIsOperationCancelled()) {
-                        Result = FALSE;
-                        break;
-                    }
-                }
+    YoriLibFileEnumProcessParallelItems(&Parallel.Workers[0]);
 
-            } while (hFind != INVALID_HANDLE_VALUE && hFind != NULL && FindNextFile(hFind, &ForEachContext->FileInfo));
+    for (Index = 1; Index < Parallel.WorkerCount; Index++) {
+        Worker = &Parallel.Workers[Index];
+        if (Worker->Thread != NULL) {
+            WaitForSingleObject(Worker->Thread, INFINITE);
+            CloseHandle(Worker->Thread);
+            Worker->Thread = NULL;
+        }
+    }
 
-            YoriLibFreeStringContents(&ForEachContext->RecurseCriteria);
+    ASSERT(Parallel.OutstandingItems == 0);
 
-            if (hFind != NULL && hFind != INVALID_HANDLE_VALUE) {
-                FindClose(hFind);
-            }
+    if (!Parallel.Abort) {
+        Result = TRUE;
+    }
 
-            if (Result == FALSE) {
-                break;
+Exit:
+
+    if (Parallel.Workers != NULL) {
+        for (Index = 0; Index < Parallel.WorkerCount; Index++) {
+            Worker = &Parallel.Workers[Index];
+            ASSERT(Worker->Bottom == Worker->Top);
+            if (Worker->Items != NULL) {
+                YoriLibFree(Worker->Items);
             }
+            CloseHandle(Worker->Mutex);
         }
+        YoriLibFree(Parallel.Workers);
     }
 
-    YoriLibFreeStringContents(&ForEachContext->EffectiveFileSpec);
-    YoriLibFreeStringContents(&ForEachContext->ParentFullPath);
-    YoriLibFreeStringContents(&ForEachContext->FullPath);
-    YoriLibFree(ForEachContext);
+    if (Parallel.CompleteEvent != NULL) {
+        CloseHandle(Parallel.CompleteEvent);
+    }
+
+    if (Parallel.WorkAvailableEvent != NULL) {
+        CloseHandle(Parallel.WorkAvailableEvent);
+    }
+
+    if (Parallel.CallbackMutex != NULL) {
+        CloseHandle(Parallel.CallbackMutex);
+    }
 
     return Result;
 }
 
+/**
+ Call a callback for every file matching a specified file pattern.
+
+ @param FileSpec The pattern to match against.
+
+ @param MatchFlags Specifies the behavior of the match, including whether
+        it should be applied recursively and the recursing behavior.
+
+ @param Depth Indicates the current recursion depth.  If this function is
+        reentered, this value is incremented.
+
+ @param Callback The callback to invoke on each match.
+
+ @param ErrorCallback Optionally points to a function to invoke if a
+        directory cannot be enumerated.  If NULL, the caller does not care
+        about failures and wants to silently continue.
+
+ @param Context Caller provided context to pass to the callback.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibForEachFileEnum(
+    __in PYORI_STRING FileSpec,
+    __in WORD MatchFlags,
+    __in DWORD Depth,
+    __in PYORILIB_FILE_ENUM_FN Callback,
+    __in_opt PYORILIB_FILE_ENUM_ERROR_FN ErrorCallback,
+    __in_opt PVOID Context
+    )
+{
+    if ((MatchFlags & YORILIB_FILEENUM_PARALLEL) != 0 &&
+        (MatchFlags & (YORILIB_FILEENUM_RECURSE_AFTER_RETURN | YORILIB_FILEENUM_RECURSE_BEFORE_RETURN)) != 0) {
+
+        return YoriLibForEachFileEnumParallel(FileSpec, MatchFlags, Depth, Callback, ErrorCallback, Context);
+    }
+
+    return YoriLibForEachFileEnumInternal(FileSpec, MatchFlags, Depth, Callback, ErrorCallback, Context, NULL, YORILIB_FOREACHFILE_PHASE_ALL);
+}
+
 /**
  Enumerate the set of possible files matching a user specified pattern.
  This function is responsible for expanding Yori defined sequences, including
@@ -801,116 +1805,323 @@ YoriLibForEachFile(
 }
 
 /**
- Compare a file name against a wildcard criteria to see if it matches.
+ Process a wildcard expression so that it can be compared against file names
+ without reparsing it.  This does not allocate memory; the compiled
+ expression refers to the wildcard string, which must remain valid while the
+ compiled expression is in use.
 
- @param FileName The file name to compare.
- 
- @param Wildcard The string that may contain wildcards to compare against.
+ A '*' matches any number of characters and a '?' matches a single
+ character.  A '?' that follows a '*' is subsumed by it, and '?' characters
+ at the end of the expression may also match the end of the file name.
 
- @return TRUE to indicate a match, FALSE to indicate no match.
+ @param Wildcard The string that may contain wildcards.
+
+ @param Expression On completion, populated with the compiled form of the
+        expression.
  */
-__success(return)
-BOOL
-YoriLibDoesFileMatchExpression (
-    __in PYORI_STRING FileName,
-    __in PYORI_STRING Wildcard
+VOID
+YoriLibCompileFileMatchExpression(
+    __in PCYORI_STRING Wildcard,
+    __out PYORI_LIB_FILE_MATCH_EXPRESSION Expression
     )
 {
-    DWORD FileIndex, WildIndex;
+    LPTSTR Wild;
+    YORI_ALLOC_SIZE_T EffectiveLength;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T SegmentStart;
+    BOOLEAN TrailingStar;
+
+    ZeroMemory(Expression, sizeof(YORI_LIB_FILE_MATCH_EXPRESSION));
+    YoriLibInitEmptyString(&Expression->Wildcard);
+    Expression->Wildcard.StartOfString = Wildcard->StartOfString;
+    Expression->Wildcard.LengthInChars = Wildcard->LengthInChars;
+    Wild = Wildcard->StartOfString;
 
-    TCHAR CompareFile;
-    TCHAR CompareWild;
+    //
+    //  Find the run of wildcard characters at the end of the expression.
+    //  If it contains a '*', the whole run is equivalent to a single '*'.
+    //  If not, it consists of '?' characters which can match the end of the
+    //  file name.
+    //
 
-    FileIndex = 0;
-    WildIndex = 0;
+    EffectiveLength = Wildcard->LengthInChars;
+    while (EffectiveLength > 0 &&
+           (Wild[EffectiveLength - 1] == '*' || Wild[EffectiveLength - 1] == '?')) {
 
-    while (FileIndex < FileName->LengthInChars && WildIndex < Wildcard->LengthInChars) {
+        EffectiveLength--;
+    }
 
-        CompareFile = YoriLibUpcaseChar(FileName->StartOfString[FileIndex]);
-        CompareWild = YoriLibUpcaseChar(Wildcard->StartOfString[WildIndex]);
+    TrailingStar = FALSE;
+    for (Index = EffectiveLength; Index < Wildcard->LengthInChars; Index++) {
+        if (Wild[Index] == '*') {
+            TrailingStar = TRUE;
+            break;
+        }
+    }
 
-        FileIndex++;
-        WildIndex++;
+    if (!TrailingStar) {
+        Expression->OptionalChars = Wildcard->LengthInChars - EffectiveLength;
+    }
 
-        if (CompareWild == '?') {
+    //
+    //  The prefix is everything before the first '*'.
+    //
 
-            //
-            //  '?' matches with everything.  We've already advanced to the next
-            //  char, so continue.
-            //
+    for (Index = 0; Index < EffectiveLength; Index++) {
+        if (Wild[Index] == '*') {
+            break;
+        }
+    }
 
-        } else if (CompareWild == '*') {
+    Expression->PrefixLength = Index;
+    Expression->MinimumLength = Index;
+    if (Index == EffectiveLength && !TrailingStar) {
+        return;
+    }
 
-            //
-            //  Skip over repeated wildcards.
-            //
+    Expression->ContainsStar = TRUE;
 
-            while (WildIndex < Wildcard->LengthInChars) {
-                CompareWild = YoriLibUpcaseChar(Wildcard->StartOfString[WildIndex]);
-                if (CompareWild != '*' && CompareWild != '?') {
-                    break;
-                }
-                WildIndex++;
+    //
+    //  If the expression ends in a '*', the suffix is empty.  Otherwise it
+    //  follows the final '*' and any '?' characters that it subsumes.
+    //
+
+    if (TrailingStar) {
+        Expression->SuffixOffset = EffectiveLength;
+    } else {
+        for (Index = EffectiveLength; Index > 0; Index--) {
+            if (Wild[Index - 1] == '*') {
+                break;
             }
+        }
+        while (Index < EffectiveLength && Wild[Index] == '?') {
+            Index++;
+        }
+        Expression->SuffixOffset = Index;
+        Expression->SuffixLength = EffectiveLength - Index;
+        Expression->MinimumLength = Expression->MinimumLength + Expression->SuffixLength;
+    }
 
-            //
-            //  If we're at the end of the string, consisting entirely of
-            //  wildcards, then any file name ending would match.
-            //
+    //
+    //  Count the characters in any segments between the prefix and the
+    //  suffix, since these must all be present in a matching file name.
+    //
 
-            if (WildIndex == Wildcard->LengthInChars) {
-                return TRUE;
-            }
+    Index = Expression->PrefixLength;
+    while (TRUE) {
+        while (Index < Expression->SuffixOffset &&
+               (Wild[Index] == '*' || Wild[Index] == '?')) {
 
-            //
-            //  If there's a literal after the wildcard, look forward in the
-            //  file name to see if it's there.
-            //
+            Index++;
+        }
 
-            while (FileIndex < FileName->LengthInChars) {
-                CompareFile = YoriLibUpcaseChar(FileName->StartOfString[FileIndex]);
-                if (CompareFile == CompareWild) {
-                    break;
-                }
-                FileIndex++;
-            }
+        if (Index >= Expression->SuffixOffset) {
+            break;
+        }
 
-            //
-            //  There is a literal after the wild but it wasn't found in the
-            //  file name.  This is not a match.
-            //
+        Expression->ContainsMiddle = TRUE;
+        SegmentStart = Index;
+        while (Index < Expression->SuffixOffset && Wild[Index] != '*') {
+            Index++;
+        }
+        Expression->MinimumLength = Expression->MinimumLength + (Index - SegmentStart);
+    }
+}
 
-            if (FileIndex == FileName->LengthInChars) {
-                return FALSE;
-            }
+/**
+ Compare a range of a file name against a segment of a wildcard expression
+ that does not contain any '*' characters.
 
-        } else {
-            if (CompareFile != CompareWild) {
+ @param FileName Pointer to the characters in the file name to compare.
+
+ @param Segment Pointer to the characters in the expression to compare.
+
+ @param Length The number of characters to compare.
+
+ @return TRUE if the characters match, FALSE if they do not.
+ */
+BOOLEAN
+YoriLibDoesFileMatchExpressionSegment(
+    __in LPCTSTR FileName,
+    __in LPCTSTR Segment,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    TCHAR CompareFile;
+    TCHAR CompareWild;
+
+    for (Index = 0; Index < Length; Index++) {
+        CompareWild = Segment[Index];
+        CompareFile = FileName[Index];
+        if (CompareWild != CompareFile && CompareWild != '?') {
+            if (YoriLibUpcaseCharInline(CompareWild) != YoriLibUpcaseCharInline(CompareFile)) {
                 return FALSE;
             }
         }
     }
 
+    return TRUE;
+}
+
+/**
+ Compare the leading characters of a file name against a compiled wildcard
+ expression, ignoring any optional trailing '?' characters.
+
+ @param FileName The file name to compare.
+
+ @param FileLength The number of characters in the file name to compare.
+
+ @param Expression The compiled wildcard expression.
+
+ @return TRUE to indicate a match, FALSE to indicate no match.
+ */
+BOOLEAN
+YoriLibDoesFileMatchCompiledExpressionLength(
+    __in PCYORI_STRING FileName,
+    __in YORI_ALLOC_SIZE_T FileLength,
+    __in PCYORI_LIB_FILE_MATCH_EXPRESSION Expression
+    )
+{
+    LPTSTR Wild;
+    LPTSTR File;
+    YORI_ALLOC_SIZE_T FileIndex;
+    YORI_ALLOC_SIZE_T FileEnd;
+    YORI_ALLOC_SIZE_T WildIndex;
+    YORI_ALLOC_SIZE_T SegmentStart;
+    YORI_ALLOC_SIZE_T SegmentLength;
+
+    if (FileLength < Expression->MinimumLength) {
+        return FALSE;
+    }
+
+    Wild = Expression->Wildcard.StartOfString;
+    File = FileName->StartOfString;
+
+    if (!Expression->ContainsStar) {
+        if (FileLength != Expression->PrefixLength) {
+            return FALSE;
+        }
+        return YoriLibDoesFileMatchExpressionSegment(File, Wild, FileLength);
+    }
+
+    //
+    //  Check the fixed position prefix and suffix first, since these are
+    //  the cheapest to reject.  The minimum length check above ensures
+    //  these do not overlap.
+    //
+
+    FileEnd = FileLength - Expression->SuffixLength;
+    if (!YoriLibDoesFileMatchExpressionSegment(File, Wild, Expression->PrefixLength) ||
+        !YoriLibDoesFileMatchExpressionSegment(&File[FileEnd], &Wild[Expression->SuffixOffset], Expression->SuffixLength)) {
+
+        return FALSE;
+    }
+
+    if (!Expression->ContainsMiddle) {
+        return TRUE;
+    }
+
     //
-    //  Skip over repeated wildcards.
+    //  Find each segment between the prefix and suffix at the earliest
+    //  point it occurs.  Because each '*' can absorb any characters, the
+    //  earliest match for a segment never prevents later segments from
+    //  being found, so no backtracking is needed.
     //
 
-    while (WildIndex < Wildcard->LengthInChars) {
-        ASSERT(FileIndex == FileName->LengthInChars);
-        CompareWild = YoriLibUpcaseChar(Wildcard->StartOfString[WildIndex]);
-        if (CompareWild != '*' && CompareWild != '?') {
+    FileIndex = Expression->PrefixLength;
+    WildIndex = Expression->PrefixLength;
+    while (TRUE) {
+        while (WildIndex < Expression->SuffixOffset &&
+               (Wild[WildIndex] == '*' || Wild[WildIndex] == '?')) {
+
+            WildIndex++;
+        }
+
+        if (WildIndex >= Expression->SuffixOffset) {
             break;
         }
-        WildIndex++;
+
+        SegmentStart = WildIndex;
+        while (WildIndex < Expression->SuffixOffset && Wild[WildIndex] != '*') {
+            WildIndex++;
+        }
+        SegmentLength = WildIndex - SegmentStart;
+
+        while (TRUE) {
+            if (FileEnd - FileIndex < SegmentLength) {
+                return FALSE;
+            }
+            if (YoriLibDoesFileMatchExpressionSegment(&File[FileIndex], &Wild[SegmentStart], SegmentLength)) {
+                break;
+            }
+            FileIndex++;
+        }
+
+        FileIndex = FileIndex + SegmentLength;
     }
 
-    if (FileIndex == FileName->LengthInChars && WildIndex == Wildcard->LengthInChars) {
-        return TRUE;
+    return TRUE;
+}
+
+/**
+ Compare a file name against a compiled wildcard expression to see if it
+ matches.
+
+ @param FileName The file name to compare.
+
+ @param Expression The compiled wildcard expression, from
+        @ref YoriLibCompileFileMatchExpression .
+
+ @return TRUE to indicate a match, FALSE to indicate no match.
+ */
+BOOLEAN
+YoriLibDoesFileMatchCompiledExpression(
+    __in PCYORI_STRING FileName,
+    __in PCYORI_LIB_FILE_MATCH_EXPRESSION Expression
+    )
+{
+    YORI_ALLOC_SIZE_T Extra;
+
+    //
+    //  Trailing '?' characters can match any character or the end of the
+    //  file name, so try each number of characters that they could match.
+    //
+
+    for (Extra = 0; Extra <= Expression->OptionalChars && Extra <= FileName->LengthInChars; Extra++) {
+        if (YoriLibDoesFileMatchCompiledExpressionLength(FileName, FileName->LengthInChars - Extra, Expression)) {
+            return TRUE;
+        }
     }
 
     return FALSE;
 }
 
+/**
+ Compare a file name against a wildcard criteria to see if it matches.
+ Callers comparing many file names against the same criteria should use
+ @ref YoriLibCompileFileMatchExpression and
+ @ref YoriLibDoesFileMatchCompiledExpression instead.
+
+ @param FileName The file name to compare.
+ 
+ @param Wildcard The string that may contain wildcards to compare against.
+
+ @return TRUE to indicate a match, FALSE to indicate no match.
+ */
+__success(return)
+BOOL
+YoriLibDoesFileMatchExpression (
+    __in PYORI_STRING FileName,
+    __in PYORI_STRING Wildcard
+    )
+{
+    YORI_LIB_FILE_MATCH_EXPRESSION Expression;
+
+    YoriLibCompileFileMatchExpression(Wildcard, &Expression);
+    return YoriLibDoesFileMatchCompiledExpression(FileName, &Expression);
+}
+
 /**
  Generate information typically returned from a directory enumeration by
  opening the file and querying information from it.  This is used for named
@@ -229,6 +229,124 @@ YoriLibFileFiltFilterOptions[] = {
      YoriLibGenerateWriteTime,               "write time"},
 };
 
+/**
+ Collection functions which only use information returned from a directory
+ enumerate.  These are inexpensive and fully populate the information they
+ collect, so they can operate on an entry that has not been initialized.
+ */
+CONST YORI_LIB_FILE_FILT_COLLECT_FN
+YoriLibFileFiltFindDataCollectFns[] = {
+    YoriLibCollectAccessTime,
+    YoriLibCollectCreateTime,
+    YoriLibCollectFileAttributes,
+    YoriLibCollectFileExtension,
+    YoriLibCollectFileName,
+    YoriLibCollectFileSize,
+    YoriLibCollectReparseTag,
+    YoriLibCollectShortName,
+    YoriLibCollectWriteTime,
+};
+
+/**
+ The criteria within a color filter which compare against one particular
+ file extension.
+ */
+typedef struct _YORI_LIB_FILE_FILT_EXT_RULES {
+
+    /**
+     The entry for this extension within the index's hash table.  The key
+     of this entry refers to the extension within the first criteria.
+     */
+    YORI_OPEN_HASH_ENTRY HashEntry;
+
+    /**
+     The number of criteria which compare against this extension.
+     */
+    DWORD NumberRules;
+
+    /**
+     An array of indexes of criteria, in the order they occur in the filter.
+     */
+    PDWORD Rules;
+
+} YORI_LIB_FILE_FILT_EXT_RULES, *PYORI_LIB_FILE_FILT_EXT_RULES;
+
+/**
+ Information describing how to collect the data needed by a single criteria.
+ When parsing, a collection function is removed from any criteria whose data
+ was collected by an earlier criteria, which is not valid when only a subset
+ of the criteria are evaluated, so the index retains the original.
+ */
+typedef struct _YORI_LIB_FILE_FILT_RULE_COLLECT {
+
+    /**
+     The function to collect data needed by the criteria.
+     */
+    YORI_LIB_FILE_FILT_COLLECT_FN CollectFn;
+
+    /**
+     A single bit which is unique to CollectFn within this filter, used to
+     record which collection functions have been invoked for a file.
+     */
+    DWORD CollectMask;
+
+    /**
+     TRUE if CollectFn only uses information returned from a directory
+     enumerate.
+     */
+    BOOLEAN FromFindData;
+
+} YORI_LIB_FILE_FILT_RULE_COLLECT, *PYORI_LIB_FILE_FILT_RULE_COLLECT;
+
+/**
+ An index of the criteria within a color filter.  Criteria which check for a
+ file extension being equal to a value are found by hashing a file's
+ extension, and all other criteria are kept in a separate ordered list, so a
+ file is only compared against criteria which could match it.
+ */
+typedef struct _YORI_LIB_FILE_FILT_EXT_INDEX {
+
+    /**
+     A hash table of extensions, where each entry refers to a
+     YORI_LIB_FILE_FILT_EXT_RULES structure.
+     */
+    PYORI_OPEN_HASH_TABLE HashTable;
+
+    /**
+     The number of distinct extensions in the Extensions array.
+     */
+    DWORD NumberExtensions;
+
+    /**
+     An array of the criteria for each distinct extension.
+     */
+    PYORI_LIB_FILE_FILT_EXT_RULES Extensions;
+
+    /**
+     The number of criteria which do not compare against an extension.
+     */
+    DWORD NumberGeneralRules;
+
+    /**
+     An array of indexes of criteria which do not compare against an
+     extension, in the order they occur in the filter.
+     */
+    PDWORD GeneralRules;
+
+    /**
+     The bit within CollectMask which corresponds to collecting the file
+     name, which is needed to find the file's extension.
+     */
+    DWORD FileNameCollectMask;
+
+    /**
+     An array, with one element per criteria, describing how to collect the
+     data needed by each criteria.
+     */
+    PYORI_LIB_FILE_FILT_RULE_COLLECT Collect;
+
+} YORI_LIB_FILE_FILT_EXT_INDEX, *PYORI_LIB_FILE_FILT_EXT_INDEX;
+
 /**
  Display usage text to the user.
  */
@@ -553,6 +671,308 @@ YoriLibFileFiltParseColorElement(
 }
 
 
+/**
+ Check whether a collection function only uses information returned from a
+ directory enumerate.
+
+ @param CollectFn Pointer to the collection function.
+
+ @return TRUE if the function only uses information from the directory
+         enumerate, FALSE if it may query the file.
+ */
+BOOLEAN
+YoriLibFileFiltIsCollectFromFindData(
+    __in YORI_LIB_FILE_FILT_COLLECT_FN CollectFn
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < sizeof(YoriLibFileFiltFindDataCollectFns)/sizeof(YoriLibFileFiltFindDataCollectFns[0]); Index++) {
+        if (CollectFn == YoriLibFileFiltFindDataCollectFns[Index]) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Reorder the criteria in a filter so that criteria which only use
+ information returned from a directory enumerate are evaluated first.  A
+ file that fails one of these is rejected without querying the file for
+ any other criteria.  The relative order of criteria is otherwise retained.
+ If memory cannot be allocated, the order is left unchanged.
+
+ @param Filter Pointer to the filter to reorder.
+ */
+VOID
+YoriLibFileFiltReorderCriteria(
+    __inout PYORI_LIB_FILE_FILTER Filter
+    )
+{
+    PYORI_LIB_FILE_FILT_MATCH_CRITERIA ThisElement;
+    PVOID NewCriteria;
+    DWORD Index;
+    DWORD Pass;
+    DWORD NewCount;
+    BOOLEAN FromFindData;
+
+    if (Filter->NumberCriteria < 2) {
+        return;
+    }
+
+    NewCriteria = YoriLibMalloc(Filter->NumberCriteria * Filter->ElementSize);
+    if (NewCriteria == NULL) {
+        return;
+    }
+
+    NewCount = 0;
+    for (Pass = 0; Pass < 2; Pass++) {
+        for (Index = 0; Index < Filter->NumberCriteria; Index++) {
+            ThisElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Filter->Criteria, Index * Filter->ElementSize);
+            FromFindData = YoriLibFileFiltIsCollectFromFindData(ThisElement->CollectFn);
+            if ((Pass == 0 && FromFindData) ||
+                (Pass == 1 && !FromFindData)) {
+
+                memcpy(YoriLibAddToPointer(NewCriteria, NewCount * Filter->ElementSize), ThisElement, Filter->ElementSize);
+                NewCount++;
+            }
+        }
+    }
+
+    ASSERT(NewCount == Filter->NumberCriteria);
+    YoriLibFree(Filter->Criteria);
+    Filter->Criteria = NewCriteria;
+}
+
+/**
+ Check whether a criteria matches files whose extension is equal to a
+ value, so that it can be found by hashing a file's extension.
+
+ @param Criteria Pointer to the criteria.
+
+ @return TRUE if the criteria can be found via the file's extension, FALSE
+         if it needs to be evaluated for every file.
+ */
+BOOLEAN
+YoriLibFileFiltIsExtensionCriteria(
+    __in PYORI_LIB_FILE_FILT_MATCH_CRITERIA Criteria
+    )
+{
+    LPTSTR Ext;
+
+    if (Criteria->CompareFn != YoriLibCompareFileExtension ||
+        Criteria->TruthStates[YORI_LIB_LESS_THAN] ||
+        !Criteria->TruthStates[YORI_LIB_EQUAL] ||
+        Criteria->TruthStates[YORI_LIB_GREATER_THAN]) {
+
+        return FALSE;
+    }
+
+    //
+    //  The comparison uses the CRT's case insensitivity, which is only
+    //  certain to agree with the hash for ASCII.  Unprintable characters
+    //  are converted to '?' when the file name is collected, so neither
+    //  can be found by hashing the name as it is on disk.
+    //
+
+    for (Ext = Criteria->CompareEntry.Extension; *Ext != '\0'; Ext++) {
+        if (*Ext < 32 || *Ext >= 127 || *Ext == '?') {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Free an index of criteria by file extension.
+
+ @param ExtIndex Pointer to the index to free.
+ */
+VOID
+YoriLibFileFiltFreeExtensionIndex(
+    __in PYORI_LIB_FILE_FILT_EXT_INDEX ExtIndex
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < ExtIndex->NumberExtensions; Index++) {
+        YoriLibOpenHashRemoveByEntry(&ExtIndex->Extensions[Index].HashEntry);
+    }
+
+    if (ExtIndex->HashTable != NULL) {
+        YoriLibFreeEmptyOpenHashTable(ExtIndex->HashTable);
+    }
+
+    YoriLibFree(ExtIndex);
+}
+
+/**
+ Build an index of the criteria in a color filter by the file extension
+ they compare against.  This needs to be called before collection functions
+ are removed from criteria whose data was collected by an earlier criteria.
+ If the filter has no criteria that compare against an extension, or memory
+ cannot be allocated, no index is built and every criteria is evaluated in
+ order.
+
+ @param Filter Pointer to the filter to build an index for.
+ */
+VOID
+YoriLibFileFiltBuildExtensionIndex(
+    __inout PYORI_LIB_FILE_FILTER Filter
+    )
+{
+    PYORI_LIB_FILE_FILT_EXT_INDEX ExtIndex;
+    PYORI_LIB_FILE_FILT_MATCH_CRITERIA ThisElement;
+    PYORI_LIB_FILE_FILT_EXT_RULES ExtRules;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+    YORI_LIB_FILE_FILT_COLLECT_FN CollectFns[32];
+    YORI_STRING Extension;
+    YORI_MAX_UNSIGNED_T SizeNeeded;
+    PDWORD RuleStorage;
+    DWORD NumberExtensionRules;
+    DWORD NumberCollectFns;
+    DWORD FnIndex;
+    DWORD Index;
+    DWORD Offset;
+    DWORD Pass;
+
+    Filter->ExtensionIndex = NULL;
+
+    NumberExtensionRules = 0;
+    for (Index = 0; Index < Filter->NumberCriteria; Index++) {
+        ThisElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Filter->Criteria, Index * Filter->ElementSize);
+        if (YoriLibFileFiltIsExtensionCriteria(ThisElement)) {
+            NumberExtensionRules++;
+        }
+    }
+
+    if (NumberExtensionRules == 0) {
+        return;
+    }
+
+    //
+    //  The index is followed by the collection information for each
+    //  criteria, the structure for each extension, and the indexes of
+    //  each criteria.  There can be no more distinct extensions than
+    //  criteria that compare against an extension.
+    //
+
+    SizeNeeded = sizeof(YORI_LIB_FILE_FILT_EXT_INDEX) +
+                 (YORI_MAX_UNSIGNED_T)Filter->NumberCriteria * (sizeof(YORI_LIB_FILE_FILT_RULE_COLLECT) + sizeof(DWORD)) +
+                 (YORI_MAX_UNSIGNED_T)NumberExtensionRules * sizeof(YORI_LIB_FILE_FILT_EXT_RULES);
+
+    if (!YoriLibIsSizeAllocatable(SizeNeeded)) {
+        return;
+    }
+
+    ExtIndex = YoriLibMalloc((YORI_ALLOC_SIZE_T)SizeNeeded);
+    if (ExtIndex == NULL) {
+        return;
+    }
+
+    ExtIndex->HashTable = NULL;
+    ExtIndex->NumberExtensions = 0;
+    ExtIndex->NumberGeneralRules = 0;
+    ExtIndex->FileNameCollectMask = 0;
+    ExtIndex->Collect = (PYORI_LIB_FILE_FILT_RULE_COLLECT)(ExtIndex + 1);
+    ExtIndex->Extensions = (PYORI_LIB_FILE_FILT_EXT_RULES)(ExtIndex->Collect + Filter->NumberCriteria);
+    RuleStorage = (PDWORD)(ExtIndex->Extensions + NumberExtensionRules);
+    ExtIndex->GeneralRules = RuleStorage + NumberExtensionRules;
+
+    //
+    //  Assign a bit to each distinct collection function so that the
+    //  functions invoked for a file can be tracked cheaply.
+    //
+
+    NumberCollectFns = 0;
+    for (Index = 0; Index < Filter->NumberCriteria; Index++) {
+        ThisElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Filter->Criteria, Index * Filter->ElementSize);
+        for (FnIndex = 0; FnIndex < NumberCollectFns; FnIndex++) {
+            if (CollectFns[FnIndex] == ThisElement->CollectFn) {
+                break;
+            }
+        }
+
+        if (FnIndex == NumberCollectFns) {
+            if (NumberCollectFns == sizeof(CollectFns)/sizeof(CollectFns[0])) {
+                YoriLibFileFiltFreeExtensionIndex(ExtIndex);
+                return;
+            }
+            CollectFns[NumberCollectFns] = ThisElement->CollectFn;
+            NumberCollectFns++;
+        }
+
+        ExtIndex->Collect[Index].CollectFn = ThisElement->CollectFn;
+        ExtIndex->Collect[Index].CollectMask = ((DWORD)1 << FnIndex);
+        ExtIndex->Collect[Index].FromFindData = YoriLibFileFiltIsCollectFromFindData(ThisElement->CollectFn);
+        if (ThisElement->CollectFn == YoriLibCollectFileName) {
+            ExtIndex->FileNameCollectMask = ExtIndex->Collect[Index].CollectMask;
+        }
+    }
+
+    ExtIndex->HashTable = YoriLibAllocateOpenHashTable(NumberExtensionRules);
+    if (ExtIndex->HashTable == NULL) {
+        YoriLibFileFiltFreeExtensionIndex(ExtIndex);
+        return;
+    }
+
+    //
+    //  On the first pass, find each distinct extension and count the
+    //  criteria for it.  On the second pass, fill in the indexes of the
+    //  criteria for each extension, and of the criteria which need to be
+    //  evaluated for every file.
+    //
+
+    for (Pass = 0; Pass < 2; Pass++) {
+        for (Index = 0; Index < Filter->NumberCriteria; Index++) {
+            ThisElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Filter->Criteria, Index * Filter->ElementSize);
+            if (!YoriLibFileFiltIsExtensionCriteria(ThisElement)) {
+                if (Pass == 1) {
+                    ExtIndex->GeneralRules[ExtIndex->NumberGeneralRules] = Index;
+                    ExtIndex->NumberGeneralRules++;
+                }
+                continue;
+            }
+
+            YoriLibConstantString(&Extension, ThisElement->CompareEntry.Extension);
+            HashEntry = YoriLibOpenHashLookupByKey(ExtIndex->HashTable, &Extension);
+            if (HashEntry != NULL) {
+                ExtRules = HashEntry->Context;
+            } else {
+                ASSERT(Pass == 0);
+                ExtRules = &ExtIndex->Extensions[ExtIndex->NumberExtensions];
+                ExtRules->NumberRules = 0;
+                ExtRules->Rules = NULL;
+                if (!YoriLibOpenHashInsertByKey(ExtIndex->HashTable, &Extension, ExtRules, &ExtRules->HashEntry)) {
+                    YoriLibFileFiltFreeExtensionIndex(ExtIndex);
+                    return;
+                }
+                ExtIndex->NumberExtensions++;
+            }
+
+            if (Pass == 1) {
+                ExtRules->Rules[ExtRules->NumberRules] = Index;
+            }
+            ExtRules->NumberRules++;
+        }
+
+        if (Pass == 0) {
+            Offset = 0;
+            for (Index = 0; Index < ExtIndex->NumberExtensions; Index++) {
+                ExtRules = &ExtIndex->Extensions[Index];
+                ExtRules->Rules = &RuleStorage[Offset];
+                Offset = Offset + ExtRules->NumberRules;
+                ExtRules->NumberRules = 0;
+            }
+            ASSERT(Offset == NumberExtensionRules);
+        }
+    }
+
+    Filter->ExtensionIndex = ExtIndex;
+}
+
 /**
  A callback function which can be invoked to parse each element in a
  semicolon delimited list of filter rules to apply.
@@ -582,6 +1002,13 @@ typedef YORI_LIB_FILE_FILT_PARSE_FN *PYORI_LIB_FILE_FILT_PARSE_FN;
  @param AllocationSize Specifies the size, in bytes, needed for each element
         generated.
 
+ @param Reorder If TRUE, the result of evaluating the criteria does not
+        depend on their order, so criteria are reordered to evaluate
+        inexpensive criteria first.
+
+ @param BuildExtensionIndex If TRUE, the criteria are color criteria and an
+        index is built to find criteria by file extension.
+
  @param ErrorSubstring On failure, updated to point to the part of the user's
         expression that caused the failure.
 
@@ -594,6 +1021,8 @@ YoriLibFileFiltParseFilterStringInternal(
     __in PYORI_STRING FilterString,
     __in PYORI_LIB_FILE_FILT_PARSE_FN Fn,
     __in YORI_ALLOC_SIZE_T AllocationSize,
+    __in BOOLEAN Reorder,
+    __in BOOLEAN BuildExtensionIndex,
     __out _On_failure_(_Post_valid_) PYORI_STRING ErrorSubstring
     )
 {
@@ -635,26 +1064,6 @@ YoriLibFileFiltParseFilterStringInternal(
                         YoriLibFree(Criteria);
                         return FALSE;
                     }
-
-                    //
-                    //  At the expense of being N^2, check if a previous
-                    //  item is already collecting the same data.  If it
-                    //  is, don't collect anything by this item.  The
-                    //  hope is this filter chain is executed across
-                    //  multiple files so the cost of this check will be
-                    //  outweighed by the operations it eliminates.
-                    //
-
-                    if (ThisElement->CollectFn != NULL) {
-                        PYORI_LIB_FILE_FILT_MATCH_CRITERIA PreviousElement;
-                        for (Index = 0; Index < ElementCount; Index++) {
-                            PreviousElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Criteria, Index * AllocationSize);
-                            if (ThisElement->CollectFn == PreviousElement->CollectFn) {
-                                ThisElement->CollectFn = NULL;
-                                break;
-                            }
-                        }
-                    }
                 }
                 ElementCount++;
             }
@@ -690,6 +1099,58 @@ YoriLibFileFiltParseFilterStringInternal(
     Filter->Criteria = Criteria;
     Filter->ElementSize = AllocationSize;
     Filter->NumberCriteria = ElementCount;
+    Filter->ExtensionIndex = NULL;
+
+    if (Reorder) {
+        YoriLibFileFiltReorderCriteria(Filter);
+    }
+
+    if (BuildExtensionIndex) {
+        YoriLibFileFiltBuildExtensionIndex(Filter);
+    }
+
+    //
+    //  Count the criteria that can be evaluated before the entry used to
+    //  collect information is initialized.
+    //
+
+    for (Index = 0; Index < ElementCount; Index++) {
+        ThisElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Filter->Criteria, Index * AllocationSize);
+        if (!YoriLibFileFiltIsCollectFromFindData(ThisElement->CollectFn)) {
+            break;
+        }
+    }
+    Filter->CriteriaFromFindData = Index;
+
+    //
+    //  At the expense of being N^2, check if a previous item is already
+    //  collecting the same data.  If it is, don't collect anything by this
+    //  item.  The hope is this filter chain is executed across multiple
+    //  files so the cost of this check will be outweighed by the
+    //  operations it eliminates.  Since the entry is initialized after
+    //  the criteria that use the directory enumerate, items after that
+    //  point cannot rely on data collected before it.
+    //
+
+    for (Index = 1; Index < ElementCount; Index++) {
+        PYORI_LIB_FILE_FILT_MATCH_CRITERIA PreviousElement;
+        DWORD PreviousIndex;
+
+        ThisElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Filter->Criteria, Index * AllocationSize);
+        PreviousIndex = 0;
+        if (Index >= Filter->CriteriaFromFindData) {
+            PreviousIndex = Filter->CriteriaFromFindData;
+        }
+
+        for (; PreviousIndex < Index; PreviousIndex++) {
+            PreviousElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Filter->Criteria, PreviousIndex * AllocationSize);
+            if (ThisElement->CollectFn == PreviousElement->CollectFn) {
+                ThisElement->CollectFn = NULL;
+                break;
+            }
+        }
+    }
+
     return TRUE;
 }
 
@@ -716,7 +1177,7 @@ YoriLibFileFiltParseFilterString(
     __out _On_failure_(_Post_valid_) PYORI_STRING ErrorSubstring
     )
 {
-    return YoriLibFileFiltParseFilterStringInternal(Filter, FilterString, YoriLibFileFiltParseFilterElement, sizeof(YORI_LIB_FILE_FILT_MATCH_CRITERIA), ErrorSubstring);
+    return YoriLibFileFiltParseFilterStringInternal(Filter, FilterString, YoriLibFileFiltParseFilterElement, sizeof(YORI_LIB_FILE_FILT_MATCH_CRITERIA), TRUE, FALSE, ErrorSubstring);
 }
 
 /**
@@ -743,7 +1204,7 @@ YoriLibFileFiltParseColorString(
     __out _On_failure_(_Post_valid_) PYORI_STRING ErrorSubstring
     )
 {
-    return YoriLibFileFiltParseFilterStringInternal(Filter, ColorString, YoriLibFileFiltParseColorElement, sizeof(YORI_LIB_FILE_FILT_COLOR_CRITERIA), ErrorSubstring);
+    return YoriLibFileFiltParseFilterStringInternal(Filter, ColorString, YoriLibFileFiltParseColorElement, sizeof(YORI_LIB_FILE_FILT_COLOR_CRITERIA), FALSE, TRUE, ErrorSubstring);
 }
 
 /**
@@ -779,11 +1240,19 @@ YoriLibFileFiltCheckFilterMatch(
         return TRUE;
     }
 
-    ZeroMemory(&CompareEntry, sizeof(CompareEntry));
+    //
+    //  Criteria that only use the directory enumerate are first, and
+    //  populate everything they compare, so the entry is only initialized
+    //  if a file passes all of them and needs to be queried further.
+    //
 
     CriteriaArray = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)Filter->Criteria;
     for (Count = 0; Count < Filter->NumberCriteria; Count++) {
         Criteria = &CriteriaArray[Count];
+        if (Count == Filter->CriteriaFromFindData) {
+            ZeroMemory(&CompareEntry, sizeof(CompareEntry));
+        }
+
         if (Criteria->CollectFn != NULL &&
             !Criteria->CollectFn(&CompareEntry, FileInfo, FilePath)) {
 
@@ -798,6 +1267,110 @@ YoriLibFileFiltCheckFilterMatch(
     return TRUE;
 }
 
+/**
+ Begin enumerating the criteria within a color filter which could match a
+ file with a specified extension.  Criteria are returned in the order they
+ occur in the filter, so the first criteria which matches is the same as if
+ every criteria were evaluated.
+
+ @param Filter Pointer to the color filter.
+
+ @param Extension Optionally points to the file's extension, not including
+        the period.  If not specified, every criteria is returned.
+
+ @param Enum On completion, populated with the state needed to enumerate
+        criteria with @ref YoriLibFileFiltGetNextColorCriteria .
+ */
+VOID
+YoriLibFileFiltStartColorEnum(
+    __in PYORI_LIB_FILE_FILTER Filter,
+    __in_opt PCYORI_STRING Extension,
+    __out PYORI_LIB_FILE_FILT_COLOR_ENUM Enum
+    )
+{
+    PYORI_LIB_FILE_FILT_EXT_INDEX ExtIndex;
+    PYORI_LIB_FILE_FILT_EXT_RULES ExtRules;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+
+    Enum->ExtensionRules = NULL;
+    Enum->NumberExtensionRules = 0;
+    Enum->ExtensionRuleIndex = 0;
+    Enum->GeneralRuleIndex = 0;
+
+    ExtIndex = (PYORI_LIB_FILE_FILT_EXT_INDEX)Filter->ExtensionIndex;
+    if (ExtIndex == NULL || Extension == NULL) {
+        Enum->GeneralRules = NULL;
+        Enum->NumberGeneralRules = Filter->NumberCriteria;
+        return;
+    }
+
+    Enum->GeneralRules = ExtIndex->GeneralRules;
+    Enum->NumberGeneralRules = ExtIndex->NumberGeneralRules;
+
+    HashEntry = YoriLibOpenHashLookupByKey(ExtIndex->HashTable, Extension);
+    if (HashEntry != NULL) {
+        ExtRules = HashEntry->Context;
+        Enum->ExtensionRules = ExtRules->Rules;
+        Enum->NumberExtensionRules = ExtRules->NumberRules;
+    }
+}
+
+/**
+ Return the next criteria within a color filter which could match a file.
+
+ @param Enum Pointer to the enumeration state, initialized with
+        @ref YoriLibFileFiltStartColorEnum .
+
+ @param CriteriaIndex On successful completion, updated to contain the index
+        of the next criteria to evaluate.
+
+ @return TRUE if a criteria was returned, FALSE if there are no more
+         criteria to evaluate.
+ */
+__success(return)
+BOOL
+YoriLibFileFiltGetNextColorCriteria(
+    __inout PYORI_LIB_FILE_FILT_COLOR_ENUM Enum,
+    __out PDWORD CriteriaIndex
+    )
+{
+    DWORD GeneralRule;
+    DWORD ExtensionRule;
+
+    //
+    //  Both arrays are in filter order, so merge them by returning
+    //  whichever has the lower index.
+    //
+
+    GeneralRule = (DWORD)-1;
+    if (Enum->GeneralRuleIndex < Enum->NumberGeneralRules) {
+        if (Enum->GeneralRules == NULL) {
+            GeneralRule = Enum->GeneralRuleIndex;
+        } else {
+            GeneralRule = Enum->GeneralRules[Enum->GeneralRuleIndex];
+        }
+    }
+
+    ExtensionRule = (DWORD)-1;
+    if (Enum->ExtensionRuleIndex < Enum->NumberExtensionRules) {
+        ExtensionRule = Enum->ExtensionRules[Enum->ExtensionRuleIndex];
+    }
+
+    if (GeneralRule == (DWORD)-1 && ExtensionRule == (DWORD)-1) {
+        return FALSE;
+    }
+
+    if (GeneralRule < ExtensionRule) {
+        *CriteriaIndex = GeneralRule;
+        Enum->GeneralRuleIndex++;
+    } else {
+        *CriteriaIndex = ExtensionRule;
+        Enum->ExtensionRuleIndex++;
+    }
+
+    return TRUE;
+}
+
 /**
  Evaluate which color a file should be displayed as based on the user
  supplied filter string.
@@ -826,14 +1399,18 @@ YoriLibFileFiltCheckColorMatch(
     )
 {
     DWORD Index;
+    DWORD Collected;
+    BOOLEAN EntryInitialized;
     YORILIB_COLOR_ATTRIBUTES ThisAttribute;
     YORILIB_COLOR_ATTRIBUTES PreviousAttributes;
     PYORI_LIB_FILE_FILT_COLOR_CRITERIA ThisApply;
     PYORI_LIB_FILE_FILT_COLOR_CRITERIA ColorsToApply;
+    PYORI_LIB_FILE_FILT_EXT_INDEX ExtIndex;
+    PYORI_LIB_FILE_FILT_RULE_COLLECT Collect;
+    YORI_LIB_FILE_FILT_COLOR_ENUM Enum;
+    YORI_STRING Extension;
     YORI_FILE_INFO CompareEntry;
 
-    ZeroMemory(&CompareEntry, sizeof(CompareEntry));
-
     ThisAttribute.Ctrl = YORILIB_ATTRCTRL_WINDOW_BG | YORILIB_ATTRCTRL_WINDOW_FG;
     ThisAttribute.Win32Attr = 0;
 
@@ -849,14 +1426,59 @@ YoriLibFileFiltCheckColorMatch(
             Filter->NumberCriteria == 0) ||
            Filter->ElementSize == sizeof(YORI_LIB_FILE_FILT_COLOR_CRITERIA));
 
+    //
+    //  If the criteria are indexed by extension, collect the file name to
+    //  find the extension, and only evaluate the criteria for that
+    //  extension along with criteria that apply to all files.
+    //
+
+    Collected = 0;
+    EntryInitialized = FALSE;
+    ExtIndex = (PYORI_LIB_FILE_FILT_EXT_INDEX)Filter->ExtensionIndex;
+    if (ExtIndex != NULL) {
+        YoriLibCollectFileName(&CompareEntry, FileInfo, FilePath);
+        Collected = ExtIndex->FileNameCollectMask;
+        YoriLibConstantString(&Extension, CompareEntry.Extension);
+        YoriLibFileFiltStartColorEnum(Filter, &Extension, &Enum);
+    } else {
+        YoriLibFileFiltStartColorEnum(Filter, NULL, &Enum);
+    }
+
     ColorsToApply = (PYORI_LIB_FILE_FILT_COLOR_CRITERIA)Filter->Criteria;
-    for (Index = 0; Index < Filter->NumberCriteria; Index++) {
+    while (YoriLibFileFiltGetNextColorCriteria(&Enum, &Index)) {
         ThisApply = &ColorsToApply[Index];
+        if (ExtIndex == NULL) {
+            if (Index == Filter->CriteriaFromFindData) {
+                ZeroMemory(&CompareEntry, sizeof(CompareEntry));
+            }
 
-        if (ThisApply->Match.CollectFn != NULL &&
-            !ThisApply->Match.CollectFn(&CompareEntry, FileInfo, FilePath)) {
+            if (ThisApply->Match.CollectFn != NULL &&
+                !ThisApply->Match.CollectFn(&CompareEntry, FileInfo, FilePath)) {
 
-            return FALSE;
+                return FALSE;
+            }
+        } else {
+
+            //
+            //  Since criteria are skipped, an earlier criteria may not
+            //  have collected the data, so track the functions invoked
+            //  for this file.  Initializing the entry discards anything
+            //  collected before it.
+            //
+
+            Collect = &ExtIndex->Collect[Index];
+            if ((Collected & Collect->CollectMask) == 0) {
+                if (!Collect->FromFindData && !EntryInitialized) {
+                    ZeroMemory(&CompareEntry, sizeof(CompareEntry));
+                    EntryInitialized = TRUE;
+                    Collected = 0;
+                }
+
+                if (!Collect->CollectFn(&CompareEntry, FileInfo, FilePath)) {
+                    return FALSE;
+                }
+                Collected = Collected | Collect->CollectMask;
+            }
         }
 
         if (ThisApply->Match.TruthStates[ThisApply->Match.CompareFn(&CompareEntry, &ThisApply->Match.CompareEntry)]) {
@@ -909,11 +1531,16 @@ YoriLibFileFiltFreeFilter(
     __in PYORI_LIB_FILE_FILTER Filter
     )
 {
+    if (Filter->ExtensionIndex != NULL) {
+        YoriLibFileFiltFreeExtensionIndex(Filter->ExtensionIndex);
+    }
     if (Filter->Criteria != NULL) {
         YoriLibFree(Filter->Criteria);
     }
+    Filter->ExtensionIndex = NULL;
     Filter->Criteria = NULL;
     Filter->NumberCriteria = 0;
+    Filter->CriteriaFromFindData = 0;
 }
 
 // vim:sw=4:ts=4:et:
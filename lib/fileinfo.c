@@ -191,6 +191,63 @@ YoriLibCopyFileName(
     return TRUE;
 }
 
+/**
+ Open a file to query information from it.  If the entry has a shared handle
+ with the requested access, that handle is returned rather than opening the
+ file again.
+
+ @param Entry The directory entry being populated.
+
+ @param FullPath Pointer to a string to the full file name.
+
+ @param DesiredAccess The access required to the file.
+
+ @return A handle to the file, or INVALID_HANDLE_VALUE on failure.  The
+         handle should be closed with @ref YoriLibCollectCloseFile .
+ */
+HANDLE
+YoriLibCollectOpenFile(
+    __in PYORI_FILE_INFO Entry,
+    __in PYORI_STRING FullPath,
+    __in DWORD DesiredAccess
+    )
+{
+    ASSERT(YoriLibIsStringNullTerminated(FullPath));
+
+    if (Entry->SharedHandle != NULL &&
+        (Entry->SharedHandleAccess & DesiredAccess) == DesiredAccess) {
+
+        return Entry->SharedHandle;
+    }
+
+    return CreateFile(FullPath->StartOfString,
+                      DesiredAccess,
+                      FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                      NULL,
+                      OPEN_EXISTING,
+                      FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
+                      NULL);
+}
+
+/**
+ Close a handle returned from @ref YoriLibCollectOpenFile .  If the handle is
+ the entry's shared handle, it remains open.
+
+ @param Entry The directory entry being populated.
+
+ @param hFile The handle to close.
+ */
+VOID
+YoriLibCollectCloseFile(
+    __in PYORI_FILE_INFO Entry,
+    __in HANDLE hFile
+    )
+{
+    if (hFile != Entry->SharedHandle) {
+        CloseHandle(hFile);
+    }
+}
+
 
 /**
  Collect information from a directory enumerate and full file name relating
@@ -246,13 +303,7 @@ YoriLibCollectAllocatedRangeCount (
     Entry->AllocatedRangeCount.HighPart = 0;
     Entry->AllocatedRangeCount.LowPart = 0;
 
-    hFile = CreateFile(FullPath->StartOfString,
-                       FILE_READ_ATTRIBUTES|FILE_READ_DATA,
-                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                       NULL,
-                       OPEN_EXISTING,
-                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                       NULL);
+    hFile = YoriLibCollectOpenFile(Entry, FullPath, FILE_READ_ATTRIBUTES|FILE_READ_DATA);
 
     if (hFile != INVALID_HANDLE_VALUE) {
 
@@ -310,7 +361,7 @@ YoriLibCollectAllocatedRangeCount (
             }
         }
 
-        CloseHandle(hFile);
+        YoriLibCollectCloseFile(Entry, hFile);
     }
     return TRUE;
 }
@@ -342,13 +393,7 @@ YoriLibCollectAllocationSize (
 
         HANDLE hFile;
 
-        hFile = CreateFile(FullPath->StartOfString,
-                           FILE_READ_ATTRIBUTES,
-                           FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                           NULL,
-                           OPEN_EXISTING,
-                           FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                           NULL);
+        hFile = YoriLibCollectOpenFile(Entry, FullPath, FILE_READ_ATTRIBUTES);
 
         if (hFile != INVALID_HANDLE_VALUE) {
             FILE_STANDARD_INFO StandardInfo;
@@ -359,7 +404,7 @@ YoriLibCollectAllocationSize (
                 RealAllocSize = TRUE;
             }
 
-            CloseHandle(hFile);
+            YoriLibCollectCloseFile(Entry, hFile);
         }
     }
 
@@ -417,6 +462,46 @@ YoriLibCollectAllocationSize (
     return TRUE;
 }
 
+/**
+ Read an executable's PE header from an opened file.
+
+ @param hFileRead A handle to the file opened for read data access.
+
+ @param PeHeaders On successful completion, updated to point to the contents
+        of the executable's PE headers.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibReadPeHeaders (
+    __in HANDLE hFileRead,
+    __out PYORILIB_PE_HEADERS PeHeaders
+    )
+{
+    IMAGE_DOS_HEADER DosHeader;
+    DWORD BytesReturned;
+
+    SetFilePointer(hFileRead, 0, NULL, FILE_BEGIN);
+
+    if (ReadFile(hFileRead, &DosHeader, sizeof(DosHeader), &BytesReturned, NULL) &&
+        BytesReturned == sizeof(DosHeader) &&
+        DosHeader.e_magic == IMAGE_DOS_SIGNATURE &&
+        DosHeader.e_lfanew != 0) {
+
+        SetFilePointer(hFileRead, DosHeader.e_lfanew, NULL, FILE_BEGIN);
+
+        if (ReadFile(hFileRead, PeHeaders, sizeof(YORILIB_PE_HEADERS), &BytesReturned, NULL) &&
+            BytesReturned == sizeof(YORILIB_PE_HEADERS) &&
+            PeHeaders->Signature == IMAGE_NT_SIGNATURE &&
+            PeHeaders->ImageHeader.SizeOfOptionalHeader >= FIELD_OFFSET(IMAGE_OPTIONAL_HEADER, Subsystem) + sizeof(WORD)) {
+
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
 /**
  Helper function to load an executable's PE header for parsing.  This is used
  by multiple collection functions whose data comes from a PE header.
@@ -436,8 +521,7 @@ YoriLibCapturePeHeaders (
     )
 {
     HANDLE hFileRead;
-    IMAGE_DOS_HEADER DosHeader;
-    DWORD BytesReturned;
+    BOOL Result;
 
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
@@ -456,27 +540,356 @@ YoriLibCapturePeHeaders (
                            NULL);
 
     if (hFileRead != INVALID_HANDLE_VALUE) {
+        Result = YoriLibReadPeHeaders(hFileRead, PeHeaders);
+        CloseHandle(hFileRead);
+        return Result;
+    }
+    return FALSE;
+}
+
+/**
+ The number of images whose information is retained in the image cache.
+ */
+#define YORI_LIB_IMAGE_CACHE_SIZE 16
+
+/**
+ Indicates that an image cache entry has attempted to capture PE headers.
+ */
+#define YORI_LIB_IMAGE_CACHE_PE_HEADERS    0x0001
+
+/**
+ Indicates that an image cache entry contains valid PE headers.
+ */
+#define YORI_LIB_IMAGE_CACHE_PE_VALID      0x0002
+
+/**
+ Indicates that an image cache entry contains version information.
+ */
+#define YORI_LIB_IMAGE_CACHE_VERSION       0x0004
+
+/**
+ Information retained about an image so that querying several attributes
+ of the same image, or the same image repeatedly, only reads it once.
+ */
+typedef struct _YORI_LIB_IMAGE_CACHE_ENTRY {
+
+    /**
+     The full path to the image.  An empty string indicates the entry is
+     not in use.
+     */
+    TCHAR FullPath[MAX_PATH];
+
+    /**
+     The last write time of the image when the information was captured.
+     */
+    FILETIME LastWriteTime;
+
+    /**
+     The size of the image when the information was captured.
+     */
+    DWORD FileSizeLow;
+
+    /**
+     The size of the image when the information was captured.
+     */
+    DWORD FileSizeHigh;
+
+    /**
+     A combination of YORI_LIB_IMAGE_CACHE_* flags indicating which
+     information has been captured.
+     */
+    DWORD Flags;
+
+    /**
+     The image's PE headers, if Flags contains
+     YORI_LIB_IMAGE_CACHE_PE_VALID.
+     */
+    YORILIB_PE_HEADERS PeHeaders;
+
+    /**
+     The image's file version, if Flags contains
+     YORI_LIB_IMAGE_CACHE_VERSION.
+     */
+    LARGE_INTEGER FileVersion;
+
+    /**
+     The image's file version flags, if Flags contains
+     YORI_LIB_IMAGE_CACHE_VERSION.
+     */
+    DWORD FileVersionFlags;
+
+    /**
+     The image's file version string, if Flags contains
+     YORI_LIB_IMAGE_CACHE_VERSION.
+     */
+    TCHAR FileVersionString[33];
+} YORI_LIB_IMAGE_CACHE_ENTRY, *PYORI_LIB_IMAGE_CACHE_ENTRY;
+
+/**
+ A cache of information about recently queried images.
+ */
+YORI_LIB_IMAGE_CACHE_ENTRY YoriLibImageCache[YORI_LIB_IMAGE_CACHE_SIZE];
+
+/**
+ A count of threads accessing the image cache.  A thread can only access the
+ cache if it increments this value from zero; if the cache is busy, threads
+ operate without it rather than waiting.
+ */
+LONG YoriLibImageCacheLock;
+
+/**
+ Attempt to obtain exclusive access to the image cache.
+
+ @return TRUE if the cache can be accessed, in which case the caller must
+         call @ref YoriLibImageCacheRelease ; FALSE if the cache is in use.
+ */
+__success(return)
+BOOLEAN
+YoriLibImageCacheTryAcquire(VOID)
+{
+    if (InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&YoriLibImageCacheLock) == 1) {
+        return TRUE;
+    }
+    InterlockedDecrement((INTERLOCKED_VOLATILE LONG *)&YoriLibImageCacheLock);
+    return FALSE;
+}
+
+/**
+ Release exclusive access to the image cache.
+ */
+VOID
+YoriLibImageCacheRelease(VOID)
+{
+    InterlockedDecrement((INTERLOCKED_VOLATILE LONG *)&YoriLibImageCacheLock);
+}
+
+/**
+ Find the slot in the image cache for an image.  The cache must be acquired
+ by the caller.
+
+ @param FullPath Pointer to the full path to the image.
+
+ @param FindData Pointer to information returned from enumerating the image,
+        used to determine if the cached information is current.
+
+ @param Create If TRUE, and the image is not in the cache, its slot is
+        reinitialized to describe the image.  If FALSE, NULL is returned if
+        the image is not in the cache.
+
+ @return Pointer to the cache entry, or NULL if the image is not in the cache
+         and Create is FALSE, or if the image cannot be cached.
+ */
+PYORI_LIB_IMAGE_CACHE_ENTRY
+YoriLibImageCacheFindEntry(
+    __in PYORI_STRING FullPath,
+    __in PWIN32_FIND_DATA FindData,
+    __in BOOLEAN Create
+    )
+{
+    PYORI_LIB_IMAGE_CACHE_ENTRY CacheEntry;
+    DWORD Hash;
 
-        if (ReadFile(hFileRead, &DosHeader, sizeof(DosHeader), &BytesReturned, NULL) &&
-            BytesReturned == sizeof(DosHeader) &&
-            DosHeader.e_magic == IMAGE_DOS_SIGNATURE &&
-            DosHeader.e_lfanew != 0) {
+    if (FullPath->LengthInChars == 0 ||
+        FullPath->LengthInChars >= MAX_PATH) {
 
-            SetFilePointer(hFileRead, DosHeader.e_lfanew, NULL, FILE_BEGIN);
+        return NULL;
+    }
 
-            if (ReadFile(hFileRead, PeHeaders, sizeof(YORILIB_PE_HEADERS), &BytesReturned, NULL) &&
-                BytesReturned == sizeof(YORILIB_PE_HEADERS) &&
-                PeHeaders->Signature == IMAGE_NT_SIGNATURE &&
-                PeHeaders->ImageHeader.SizeOfOptionalHeader >= FIELD_OFFSET(IMAGE_OPTIONAL_HEADER, Subsystem) + sizeof(WORD)) {
+    Hash = YoriLibHashStringFnv32(0, FullPath);
+    CacheEntry = &YoriLibImageCache[Hash % YORI_LIB_IMAGE_CACHE_SIZE];
+
+    if (CacheEntry->FileSizeLow == FindData->nFileSizeLow &&
+        CacheEntry->FileSizeHigh == FindData->nFileSizeHigh &&
+        CacheEntry->LastWriteTime.dwLowDateTime == FindData->ftLastWriteTime.dwLowDateTime &&
+        CacheEntry->LastWriteTime.dwHighDateTime == FindData->ftLastWriteTime.dwHighDateTime &&
+        YoriLibCompareStringLit(FullPath, CacheEntry->FullPath) == 0) {
+
+        return CacheEntry;
+    }
+
+    if (!Create) {
+        return NULL;
+    }
+
+    memcpy(CacheEntry->FullPath, FullPath->StartOfString, FullPath->LengthInChars * sizeof(TCHAR));
+    CacheEntry->FullPath[FullPath->LengthInChars] = '\0';
+    CacheEntry->LastWriteTime.dwLowDateTime = FindData->ftLastWriteTime.dwLowDateTime;
+    CacheEntry->LastWriteTime.dwHighDateTime = FindData->ftLastWriteTime.dwHighDateTime;
+    CacheEntry->FileSizeLow = FindData->nFileSizeLow;
+    CacheEntry->FileSizeHigh = FindData->nFileSizeHigh;
+    CacheEntry->Flags = 0;
+    return CacheEntry;
+}
+
+/**
+ Load an executable's PE header for a directory entry being populated.  If
+ the image is in the image cache, the header is returned from the cache.  If
+ the entry has a shared handle with data access, the header is read from it,
+ otherwise the file is opened.
 
-                CloseHandle(hFileRead);
-                return TRUE;
+ @param Entry The directory entry being populated.
 
+ @param FindData The directory enumeration information.
+
+ @param FullPath Pointer to a string to the full file name.
+
+ @param PeHeaders On successful completion, updated to point to the contents
+        of the executable's PE headers.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibCaptureEntryPeHeaders (
+    __in PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath,
+    __out PYORILIB_PE_HEADERS PeHeaders
+    )
+{
+    PYORI_LIB_IMAGE_CACHE_ENTRY CacheEntry;
+    BOOL Result;
+
+    if (YoriLibImageCacheTryAcquire()) {
+        CacheEntry = YoriLibImageCacheFindEntry(FullPath, FindData, FALSE);
+        if (CacheEntry != NULL && (CacheEntry->Flags & YORI_LIB_IMAGE_CACHE_PE_HEADERS) != 0) {
+            Result = FALSE;
+            if (CacheEntry->Flags & YORI_LIB_IMAGE_CACHE_PE_VALID) {
+                memcpy(PeHeaders, &CacheEntry->PeHeaders, sizeof(YORILIB_PE_HEADERS));
+                Result = TRUE;
             }
+            YoriLibImageCacheRelease();
+            return Result;
         }
-        CloseHandle(hFileRead);
+        YoriLibImageCacheRelease();
+    }
+
+    if (Entry->SharedHandle != NULL &&
+        (Entry->SharedHandleAccess & FILE_READ_DATA) != 0) {
+
+        Result = YoriLibReadPeHeaders(Entry->SharedHandle, PeHeaders);
+    } else {
+        Result = YoriLibCapturePeHeaders(FullPath, PeHeaders);
+    }
+
+    if (YoriLibImageCacheTryAcquire()) {
+        CacheEntry = YoriLibImageCacheFindEntry(FullPath, FindData, TRUE);
+        if (CacheEntry != NULL) {
+            CacheEntry->Flags |= YORI_LIB_IMAGE_CACHE_PE_HEADERS;
+            if (Result) {
+                memcpy(&CacheEntry->PeHeaders, PeHeaders, sizeof(YORILIB_PE_HEADERS));
+                CacheEntry->Flags |= YORI_LIB_IMAGE_CACHE_PE_VALID;
+            }
+        }
+        YoriLibImageCacheRelease();
+    }
+
+    return Result;
+}
+
+/**
+ Populate the version information for a directory entry, consisting of the
+ file version, file version flags, and file version string.  These all come
+ from the same version resource, so they are captured together and retained
+ in the image cache.
+
+ @param Entry The directory entry to populate.
+
+ @param FindData The directory enumeration information.
+
+ @param FullPath Pointer to a string to the full file name.
+ */
+VOID
+YoriLibCaptureEntryVersion(
+    __inout PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath
+    )
+{
+    PYORI_LIB_IMAGE_CACHE_ENTRY CacheEntry;
+    DWORD Junk;
+    PVOID Buffer;
+    YORI_ALLOC_SIZE_T VerSize;
+    VS_FIXEDFILEINFO * RootBlock;
+    PWORD TranslationBlock;
+
+    ASSERT(YoriLibIsStringNullTerminated(FullPath));
+
+    Entry->FileVersion.QuadPart = 0;
+    Entry->FileVersionFlags = 0;
+    Entry->FileVersionString[0] = '\0';
+
+    if (YoriLibImageCacheTryAcquire()) {
+        CacheEntry = YoriLibImageCacheFindEntry(FullPath, FindData, FALSE);
+        if (CacheEntry != NULL && (CacheEntry->Flags & YORI_LIB_IMAGE_CACHE_VERSION) != 0) {
+            Entry->FileVersion.QuadPart = CacheEntry->FileVersion.QuadPart;
+            Entry->FileVersionFlags = CacheEntry->FileVersionFlags;
+            memcpy(Entry->FileVersionString, CacheEntry->FileVersionString, sizeof(Entry->FileVersionString));
+            YoriLibImageCacheRelease();
+            return;
+        }
+        YoriLibImageCacheRelease();
+    }
+
+    YoriLibLoadVersionFunctions();
+
+    if (DllVersion.pGetFileVersionInfoSizeW == NULL ||
+        DllVersion.pGetFileVersionInfoW == NULL ||
+        DllVersion.pVerQueryValueW == NULL) {
+
+        return;
+    }
+
+    VerSize = (YORI_ALLOC_SIZE_T)DllVersion.pGetFileVersionInfoSizeW(FullPath->StartOfString, &Junk);
+
+    Buffer = YoriLibMalloc(VerSize);
+    if (Buffer != NULL) {
+        if (DllVersion.pGetFileVersionInfoW(FullPath->StartOfString, 0, VerSize, Buffer)) {
+            TCHAR BlockString[sizeof("\\")];
+            TCHAR TranslationBlockString[sizeof("\\VarFileInfo\\Translation")];
+
+            //
+            //  Old versions of version.dll modify this buffer while parsing
+            //  it, so we need to give them a writable stack based copy
+            //
+
+            YoriLibSPrintf(BlockString, _T("\\"));
+            if (DllVersion.pVerQueryValueW(Buffer, BlockString, (PVOID*)&RootBlock, (PUINT)&Junk)) {
+                Entry->FileVersion.HighPart = RootBlock->dwFileVersionMS;
+                Entry->FileVersion.LowPart = RootBlock->dwFileVersionLS;
+                Entry->FileVersionFlags = RootBlock->dwFileFlags & RootBlock->dwFileFlagsMask;
+            }
+
+            YoriLibSPrintf(TranslationBlockString, _T("\\VarFileInfo\\Translation"));
+            if (DllVersion.pVerQueryValueW(Buffer, TranslationBlockString, (PVOID*)&TranslationBlock, (PUINT)&Junk) && Junk >= 2 * sizeof(WORD)) {
+
+                TCHAR LanguageBlockToFind[sizeof("\\StringFileInfo\\01234567\\FileVersion")];
+                LPTSTR FileVersionString;
+
+                YoriLibSPrintf(LanguageBlockToFind, _T("\\StringFileInfo\\%04x%04x\\FileVersion"), TranslationBlock[0], TranslationBlock[1]);
+                if (DllVersion.pVerQueryValueW(Buffer, LanguageBlockToFind, (PVOID*)&FileVersionString, (PUINT)&Junk)) {
+                    DWORD BytesToCopy = Junk * sizeof(TCHAR);
+                    if (BytesToCopy > sizeof(Entry->FileVersionString) - sizeof(TCHAR)) {
+                        BytesToCopy = sizeof(Entry->FileVersionString) - sizeof(TCHAR);
+                    }
+                    memcpy(Entry->FileVersionString, FileVersionString, BytesToCopy);
+                    Entry->FileVersionString[BytesToCopy / sizeof(TCHAR)] = '\0';
+                }
+            }
+        }
+        YoriLibFree(Buffer);
+    }
+
+    if (YoriLibImageCacheTryAcquire()) {
+        CacheEntry = YoriLibImageCacheFindEntry(FullPath, FindData, TRUE);
+        if (CacheEntry != NULL) {
+            CacheEntry->FileVersion.QuadPart = Entry->FileVersion.QuadPart;
+            CacheEntry->FileVersionFlags = Entry->FileVersionFlags;
+            memcpy(CacheEntry->FileVersionString, Entry->FileVersionString, sizeof(CacheEntry->FileVersionString));
+            CacheEntry->Flags |= YORI_LIB_IMAGE_CACHE_VERSION;
+        }
+        YoriLibImageCacheRelease();
     }
-    return FALSE;
 }
 
 /**
@@ -529,12 +942,10 @@ YoriLibCollectArch (
 
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
-    UNREFERENCED_PARAMETER(FindData);
-
     Entry->OsVersionHigh = 0;
     Entry->OsVersionLow = 0;
 
-    if (YoriLibCapturePeHeaders(FullPath, &PeHeaders)) {
+    if (YoriLibCaptureEntryPeHeaders(Entry, FindData, FullPath, &PeHeaders)) {
 
         Entry->Architecture = PeHeaders.ImageHeader.Machine;
     }
@@ -571,13 +982,7 @@ YoriLibCollectCaseSensitivity (
         return TRUE;
     }
 
-    hFile = CreateFile(FullPath->StartOfString,
-                       FILE_READ_ATTRIBUTES,
-                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                       NULL,
-                       OPEN_EXISTING,
-                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                       NULL);
+    hFile = YoriLibCollectOpenFile(Entry, FullPath, FILE_READ_ATTRIBUTES);
 
     if (hFile != INVALID_HANDLE_VALUE) {
 
@@ -590,7 +995,7 @@ YoriLibCollectCaseSensitivity (
             }
         }
 
-        CloseHandle(hFile);
+        YoriLibCollectCloseFile(Entry, hFile);
     }
     return TRUE;
 }
@@ -623,13 +1028,7 @@ YoriLibCollectCompressionAlgorithm (
 
     Entry->CompressionAlgorithm = YoriLibCompressionNone;
 
-    hFile = CreateFile(FullPath->StartOfString,
-                       FILE_READ_ATTRIBUTES,
-                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                       NULL,
-                       OPEN_EXISTING,
-                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                       NULL);
+    hFile = YoriLibCollectOpenFile(Entry, FullPath, FILE_READ_ATTRIBUTES);
 
     if (hFile != INVALID_HANDLE_VALUE) {
 
@@ -675,7 +1074,7 @@ YoriLibCollectCompressionAlgorithm (
             }
         }
 
-        CloseHandle(hFile);
+        YoriLibCollectCloseFile(Entry, hFile);
     }
     return TRUE;
 }
@@ -1035,13 +1434,7 @@ YoriLibCollectFileId (
 
     Entry->FileId.QuadPart = 0;
 
-    hFile = CreateFile(FullPath->StartOfString,
-                       FILE_READ_ATTRIBUTES,
-                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                       NULL,
-                       OPEN_EXISTING,
-                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                       NULL);
+    hFile = YoriLibCollectOpenFile(Entry, FullPath, FILE_READ_ATTRIBUTES);
 
     if (hFile != INVALID_HANDLE_VALUE) {
         BY_HANDLE_FILE_INFORMATION FileInfo;
@@ -1051,7 +1444,7 @@ YoriLibCollectFileId (
             Entry->FileId.HighPart = FileInfo.nFileIndexHigh;
         }
 
-        CloseHandle(hFile);
+        YoriLibCollectCloseFile(Entry, hFile);
     }
     return TRUE;
 }
@@ -1140,56 +1533,7 @@ YoriLibCollectFileVersionString (
     __in PYORI_STRING FullPath
     )
 {
-    DWORD Junk;
-    PVOID Buffer;
-    YORI_ALLOC_SIZE_T VerSize;
-    PWORD TranslationBlock;
-
-    UNREFERENCED_PARAMETER(FindData);
-    ASSERT(YoriLibIsStringNullTerminated(FullPath));
-
-    Entry->FileVersionString[0] = '\0';
-
-    YoriLibLoadVersionFunctions();
-
-    if (DllVersion.pGetFileVersionInfoSizeW == NULL ||
-        DllVersion.pGetFileVersionInfoW == NULL ||
-        DllVersion.pVerQueryValueW == NULL) {
-
-        return TRUE;
-    }
-
-    VerSize = (YORI_ALLOC_SIZE_T)DllVersion.pGetFileVersionInfoSizeW(FullPath->StartOfString, &Junk);
-
-    Buffer = YoriLibMalloc(VerSize);
-    if (Buffer != NULL) {
-        if (DllVersion.pGetFileVersionInfoW(FullPath->StartOfString, 0, VerSize, Buffer)) {
-            TCHAR TranslationBlockString[sizeof("\\VarFileInfo\\Translation")];
-
-            //
-            //  Old versions of version.dll modify this buffer while parsing
-            //  it, so we need to give them a writable stack based copy
-            //
-
-            YoriLibSPrintf(TranslationBlockString, _T("\\VarFileInfo\\Translation"));
-            if (DllVersion.pVerQueryValueW(Buffer, TranslationBlockString, (PVOID*)&TranslationBlock, (PUINT)&Junk) && Junk >= 2 * sizeof(WORD)) {
-
-                TCHAR LanguageBlockToFind[sizeof("\\StringFileInfo\\01234567\\FileVersion")];
-                LPTSTR FileVersionString;
-
-                YoriLibSPrintf(LanguageBlockToFind, _T("\\StringFileInfo\\%04x%04x\\FileVersion"), TranslationBlock[0], TranslationBlock[1]);
-                if (DllVersion.pVerQueryValueW(Buffer, LanguageBlockToFind, (PVOID*)&FileVersionString, (PUINT)&Junk)) {
-                    DWORD BytesToCopy = Junk * sizeof(TCHAR);
-                    if (BytesToCopy > sizeof(Entry->FileVersionString) - sizeof(TCHAR)) {
-                        BytesToCopy = sizeof(Entry->FileVersionString) - sizeof(TCHAR);
-                    }
-                    memcpy(Entry->FileVersionString, FileVersionString, BytesToCopy);
-                    Entry->FileVersionString[BytesToCopy / sizeof(TCHAR)] = '\0';
-                }
-            }
-        }
-        YoriLibFree(Buffer);
-    }
+    YoriLibCaptureEntryVersion(Entry, FindData, FullPath);
     return TRUE;
 }
 
@@ -1221,13 +1565,7 @@ YoriLibCollectFragmentCount (
     Entry->FragmentCount.HighPart = 0;
     Entry->FragmentCount.LowPart = 0;
 
-    hFile = CreateFile(FullPath->StartOfString,
-                       FILE_READ_ATTRIBUTES,
-                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                       NULL,
-                       OPEN_EXISTING,
-                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                       NULL);
+    hFile = YoriLibCollectOpenFile(Entry, FullPath, FILE_READ_ATTRIBUTES);
 
     if (hFile != INVALID_HANDLE_VALUE) {
 
@@ -1285,7 +1623,7 @@ YoriLibCollectFragmentCount (
             StartBuffer.StartingVcn.QuadPart = u.Extents.Extents[u.Extents.ExtentCount - 1].NextVcn.QuadPart;
         }
 
-        CloseHandle(hFile);
+        YoriLibCollectCloseFile(Entry, hFile);
     }
     return TRUE;
 }
@@ -1316,13 +1654,7 @@ YoriLibCollectLinkCount (
 
     Entry->LinkCount = 0;
 
-    hFile = CreateFile(FullPath->StartOfString,
-                       FILE_READ_ATTRIBUTES,
-                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                       NULL,
-                       OPEN_EXISTING,
-                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                       NULL);
+    hFile = YoriLibCollectOpenFile(Entry, FullPath, FILE_READ_ATTRIBUTES);
 
     if (hFile != INVALID_HANDLE_VALUE) {
         BY_HANDLE_FILE_INFORMATION FileInfo;
@@ -1331,7 +1663,7 @@ YoriLibCollectLinkCount (
             Entry->LinkCount = FileInfo.nNumberOfLinks;
         }
 
-        CloseHandle(hFile);
+        YoriLibCollectCloseFile(Entry, hFile);
     }
     return TRUE;
 }
@@ -1364,19 +1696,13 @@ YoriLibCollectObjectId (
 
     ZeroMemory(&Entry->ObjectId, sizeof(Entry->ObjectId));
 
-    hFile = CreateFile(FullPath->StartOfString,
-                       FILE_READ_ATTRIBUTES,
-                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                       NULL,
-                       OPEN_EXISTING,
-                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                       NULL);
+    hFile = YoriLibCollectOpenFile(Entry, FullPath, FILE_READ_ATTRIBUTES);
 
     if (hFile != INVALID_HANDLE_VALUE) {
         if (DeviceIoControl(hFile, FSCTL_GET_OBJECT_ID, NULL, 0, &Buffer, sizeof(Buffer), &BytesReturned, NULL)) {
             memcpy(&Entry->ObjectId, &Buffer.ObjectId, sizeof(Buffer.ObjectId));
         }
-        CloseHandle(hFile);
+        YoriLibCollectCloseFile(Entry, hFile);
     }
     return TRUE;
 }
@@ -1402,13 +1728,12 @@ YoriLibCollectOsVersion (
 {
     YORILIB_PE_HEADERS PeHeaders;
 
-    UNREFERENCED_PARAMETER(FindData);
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
     Entry->OsVersionHigh = 0;
     Entry->OsVersionLow = 0;
 
-    if (YoriLibCapturePeHeaders(FullPath, &PeHeaders)) {
+    if (YoriLibCaptureEntryPeHeaders(Entry, FindData, FullPath, &PeHeaders)) {
 
         Entry->OsVersionHigh = PeHeaders.OptionalHeader.MajorSubsystemVersion;
         Entry->OsVersionLow = PeHeaders.OptionalHeader.MinorSubsystemVersion;
@@ -1568,12 +1893,11 @@ YoriLibCollectSubsystem (
 {
     YORILIB_PE_HEADERS PeHeaders;
 
-    UNREFERENCED_PARAMETER(FindData);
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
     Entry->Subsystem = 0;
 
-    if (YoriLibCapturePeHeaders(FullPath, &PeHeaders)) {
+    if (YoriLibCaptureEntryPeHeaders(Entry, FindData, FullPath, &PeHeaders)) {
 
         Entry->Subsystem = PeHeaders.OptionalHeader.Subsystem;
     }
@@ -1652,13 +1976,7 @@ YoriLibCollectUsn (
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
     Entry->Usn.QuadPart = 0;
-    hFile = CreateFile(FullPath->StartOfString,
-                       FILE_READ_ATTRIBUTES,
-                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                       NULL,
-                       OPEN_EXISTING,
-                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                       NULL);
+    hFile = YoriLibCollectOpenFile(Entry, FullPath, FILE_READ_ATTRIBUTES);
 
     if (hFile != INVALID_HANDLE_VALUE) {
 
@@ -1672,7 +1990,7 @@ YoriLibCollectUsn (
             Entry->Usn.QuadPart = s1.UsnRecord.Usn;
         }
 
-        CloseHandle(hFile);
+        YoriLibCollectCloseFile(Entry, hFile);
     }
     return TRUE;
 }
@@ -1696,53 +2014,108 @@ YoriLibCollectVersion (
     __in PYORI_STRING FullPath
     )
 {
-    DWORD Junk;
-    PVOID Buffer;
-    YORI_ALLOC_SIZE_T VerSize;
-    VS_FIXEDFILEINFO * RootBlock;
+    YoriLibCaptureEntryVersion(Entry, FindData, FullPath);
+    return TRUE;
+}
 
-    UNREFERENCED_PARAMETER(FindData);
-    ASSERT(YoriLibIsStringNullTerminated(FullPath));
+/**
+ Collect information from a directory enumerate and full file name relating
+ to the file's write time.
 
-    Entry->FileVersion.QuadPart = 0;
-    Entry->FileVersionFlags = 0;
+ @param Entry The directory entry to populate.
 
-    YoriLibLoadVersionFunctions();
+ @param FindData The directory enumeration information.
 
-    if (DllVersion.pGetFileVersionInfoSizeW == NULL ||
-        DllVersion.pGetFileVersionInfoW == NULL ||
-        DllVersion.pVerQueryValueW == NULL) {
+ @param FullPath Pointer to a string to the full file name.
 
-        return TRUE;
-    }
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCollectWriteTime(
+    __inout PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath
+    )
+{
+    FILETIME tmp;
 
-    VerSize = (YORI_ALLOC_SIZE_T)DllVersion.pGetFileVersionInfoSizeW(FullPath->StartOfString, &Junk);
+    UNREFERENCED_PARAMETER(FullPath);
 
-    Buffer = YoriLibMalloc(VerSize);
-    if (Buffer != NULL) {
-        if (DllVersion.pGetFileVersionInfoW(FullPath->StartOfString, 0, VerSize, Buffer)) {
-            TCHAR BlockString[sizeof("\\")];
+    FileTimeToLocalFileTime(&FindData->ftLastWriteTime, &tmp);
+    FileTimeToSystemTime(&tmp, &Entry->WriteTime);
+    return TRUE;
+}
 
-            //
-            //  Old versions of version.dll modify this buffer while parsing
-            //  it, so we need to give them a writable stack based copy
-            //
+/**
+ A mapping between a collection function and the access it requires to a
+ handle to the file.
+ */
+typedef struct _YORI_LIB_COLLECT_ACCESS {
 
-            YoriLibSPrintf(BlockString, _T("\\"));
-            if (DllVersion.pVerQueryValueW(Buffer, BlockString, (PVOID*)&RootBlock, (PUINT)&Junk)) {
-                Entry->FileVersion.HighPart = RootBlock->dwFileVersionMS;
-                Entry->FileVersion.LowPart = RootBlock->dwFileVersionLS;
-                Entry->FileVersionFlags = RootBlock->dwFileFlags & RootBlock->dwFileFlagsMask;
-            }
+    /**
+     The collection function.
+     */
+    YORI_LIB_FILE_FILT_COLLECT_FN CollectFn;
+
+    /**
+     The access the collection function requires.
+     */
+    DWORD DesiredAccess;
+} YORI_LIB_COLLECT_ACCESS;
+
+/**
+ The collection functions which query a handle to the file, and the access
+ each requires.  Functions not listed here use the directory enumeration
+ information or query by path.
+ */
+const YORI_LIB_COLLECT_ACCESS
+YoriLibCollectAccess[] = {
+    {YoriLibCollectAllocatedRangeCount,  FILE_READ_ATTRIBUTES|FILE_READ_DATA},
+    {YoriLibCollectAllocationSize,       FILE_READ_ATTRIBUTES},
+    {YoriLibCollectArch,                 FILE_READ_ATTRIBUTES|FILE_READ_DATA},
+    {YoriLibCollectCaseSensitivity,      FILE_READ_ATTRIBUTES},
+    {YoriLibCollectCompressionAlgorithm, FILE_READ_ATTRIBUTES},
+    {YoriLibCollectFileId,               FILE_READ_ATTRIBUTES},
+    {YoriLibCollectFragmentCount,        FILE_READ_ATTRIBUTES},
+    {YoriLibCollectLinkCount,            FILE_READ_ATTRIBUTES},
+    {YoriLibCollectObjectId,             FILE_READ_ATTRIBUTES},
+    {YoriLibCollectOsVersion,            FILE_READ_ATTRIBUTES|FILE_READ_DATA},
+    {YoriLibCollectSubsystem,            FILE_READ_ATTRIBUTES|FILE_READ_DATA},
+    {YoriLibCollectUsn,                  FILE_READ_ATTRIBUTES},
+    };
+
+/**
+ Return the access a collection function requires to a handle to the file.
+ A caller applying several collection functions to the same file can
+ combine these and open the file once with
+ @ref YoriLibCollectOpenSharedHandle .
+
+ @param CollectFn The collection function.
+
+ @return The access required, or zero if the collection function does not
+         open the file.
+ */
+DWORD
+YoriLibCollectGetRequiredAccess(
+    __in YORI_LIB_FILE_FILT_COLLECT_FN CollectFn
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < sizeof(YoriLibCollectAccess)/sizeof(YoriLibCollectAccess[0]); Index++) {
+        if (YoriLibCollectAccess[Index].CollectFn == CollectFn) {
+            return YoriLibCollectAccess[Index].DesiredAccess;
         }
-        YoriLibFree(Buffer);
     }
-    return TRUE;
+
+    return 0;
 }
 
 /**
- Collect information from a directory enumerate and full file name relating
- to the file's write time.
+ Open a handle to a file which is used by all collection functions applied
+ to an entry until @ref YoriLibCollectCloseSharedHandle is called.  This
+ avoids opening the file once per collection function, which is expensive
+ on remote file systems.
 
  @param Entry The directory entry to populate.
 
@@ -1750,24 +2123,76 @@ YoriLibCollectVersion (
 
  @param FullPath Pointer to a string to the full file name.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @param DesiredAccess The combined access required by the collection
+        functions that will be applied, as returned from
+        @ref YoriLibCollectGetRequiredAccess .
+
+ @return TRUE to indicate a shared handle was opened, FALSE if not.  If no
+         shared handle is opened, collection functions open the file
+         themselves.
  */
 BOOL
-YoriLibCollectWriteTime(
+YoriLibCollectOpenSharedHandle(
     __inout PYORI_FILE_INFO Entry,
     __in PWIN32_FIND_DATA FindData,
-    __in PYORI_STRING FullPath
+    __in PYORI_STRING FullPath,
+    __in DWORD DesiredAccess
     )
 {
-    FILETIME tmp;
+    HANDLE hFile;
 
-    UNREFERENCED_PARAMETER(FullPath);
+    ASSERT(YoriLibIsStringNullTerminated(FullPath));
+    ASSERT(Entry->SharedHandle == NULL);
 
-    FileTimeToLocalFileTime(&FindData->ftLastWriteTime, &tmp);
-    FileTimeToSystemTime(&tmp, &Entry->WriteTime);
+    //
+    //  The shared handle refers to a link rather than its target, and
+    //  reading data without recall fails on offline files.  Collection
+    //  functions that read data from these open the file themselves.
+    //
+
+    if (FindData->dwFileAttributes & (FILE_ATTRIBUTE_REPARSE_POINT | FILE_ATTRIBUTE_OFFLINE)) {
+        DesiredAccess = DesiredAccess & ~(FILE_READ_DATA);
+    }
+
+    if (DesiredAccess == 0) {
+        return FALSE;
+    }
+
+    hFile = YoriLibCollectOpenFile(Entry, FullPath, DesiredAccess);
+    if (hFile == INVALID_HANDLE_VALUE &&
+        DesiredAccess != FILE_READ_ATTRIBUTES) {
+
+        DesiredAccess = FILE_READ_ATTRIBUTES;
+        hFile = YoriLibCollectOpenFile(Entry, FullPath, DesiredAccess);
+    }
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    Entry->SharedHandle = hFile;
+    Entry->SharedHandleAccess = DesiredAccess;
     return TRUE;
 }
 
+/**
+ Close a handle opened with @ref YoriLibCollectOpenSharedHandle .  This can
+ be called whether or not a shared handle was opened.
+
+ @param Entry The directory entry whose shared handle should be closed.
+ */
+VOID
+YoriLibCollectCloseSharedHandle(
+    __inout PYORI_FILE_INFO Entry
+    )
+{
+    if (Entry->SharedHandle != NULL) {
+        CloseHandle(Entry->SharedHandle);
+        Entry->SharedHandle = NULL;
+        Entry->SharedHandleAccess = 0;
+    }
+}
+
 //
 //  Sorting support
 //
@@ -0,0 +1,448 @@
+/**
+ * @file lib/fileupd.c
+ *
+ * Yori engine to apply metadata changes to many files in parallel
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The number of updates that can be outstanding against a single volume if
+ the caller does not specify a limit.  Metadata updates are dominated by
+ latency, particularly over SMB, so this is larger than the number of
+ processors on most systems.
+ */
+#define YORI_LIB_FILE_UPDATE_DEFAULT_PER_VOLUME (16)
+
+/**
+ A volume that updates have been queued against.  Each volume limits the
+ number of updates that are in progress against it at any time.
+ */
+typedef struct _YORI_LIB_FILE_UPDATE_VOLUME {
+
+    /**
+     The list of volumes known to the engine.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The root of the volume, being a drive letter or UNC share.  This is
+     allocated at the end of this structure.
+     */
+    YORI_STRING Root;
+
+    /**
+     A semaphore whose count is the number of additional updates that can
+     start against this volume.
+     */
+    HANDLE Semaphore;
+
+} YORI_LIB_FILE_UPDATE_VOLUME, *PYORI_LIB_FILE_UPDATE_VOLUME;
+
+/**
+ An engine to apply updates to files in parallel.
+ */
+typedef struct _YORI_LIB_FILE_UPDATE_ENGINE {
+
+    /**
+     The thread pool used to apply updates.  If a pool could not be
+     created, this is NULL and updates are applied as they are queued.
+     */
+    PYORI_LIB_THREAD_POOL Pool;
+
+    /**
+     The function to apply an update to a file.
+     */
+    PYORI_LIB_FILE_UPDATE_FN UpdateFn;
+
+    /**
+     Optionally points to a function to report the result of an update.
+     */
+    PYORI_LIB_FILE_UPDATE_FN ReportFn;
+
+    /**
+     Caller defined context passed to each function.
+     */
+    PVOID Context;
+
+    /**
+     The number of updates that can be in progress against a single volume.
+     */
+    DWORD MaxPerVolume;
+
+    /**
+     The list of volumes updates have been queued against.  This is only
+     accessed by the thread queueing updates.
+     */
+    YORI_LIST_ENTRY VolumeList;
+
+    /**
+     The volume that the previous update was queued against.  Enumerates
+     typically return many files from the same volume, so this avoids
+     searching the list.
+     */
+    PYORI_LIB_FILE_UPDATE_VOLUME LastVolume;
+
+} YORI_LIB_FILE_UPDATE_ENGINE;
+
+/**
+ A single update to a file.
+ */
+typedef struct _YORI_LIB_FILE_UPDATE_ITEM {
+
+    /**
+     The thread pool item header.
+     */
+    YORI_LIB_WORK_ITEM WorkItem;
+
+    /**
+     The description of the update which is passed to the caller's
+     functions.
+     */
+    YORI_LIB_FILE_UPDATE Update;
+
+    /**
+     Pointer to the engine that this update was queued to.
+     */
+    PYORI_LIB_FILE_UPDATE_ENGINE Engine;
+
+    /**
+     Pointer to the volume containing the file.
+     */
+    PYORI_LIB_FILE_UPDATE_VOLUME Volume;
+
+    /**
+     A copy of information about the file from enumeration.  This is only
+     meaningful if Update.FileInfo is not NULL.
+     */
+    WIN32_FIND_DATA FileInfo;
+
+} YORI_LIB_FILE_UPDATE_ITEM, *PYORI_LIB_FILE_UPDATE_ITEM;
+
+/**
+ Create an engine to apply updates to files in parallel.
+
+ @param UpdateFn Pointer to a function to apply an update to a file.  This
+        is invoked on worker threads, concurrently with other updates.
+
+ @param ReportFn Optionally points to a function to report the result of an
+        update.  This is invoked for one update at a time, in the order that
+        updates were queued.
+
+ @param Context Caller defined context passed to each function.
+
+ @param MaxPerVolume The maximum number of updates that can be in progress
+        against a single volume.  If zero, a default is used.  This is also
+        the number of threads used to apply updates.
+
+ @param Engine On successful completion, updated to point to the engine.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibCreateFileUpdateEngine(
+    __in PYORI_LIB_FILE_UPDATE_FN UpdateFn,
+    __in_opt PYORI_LIB_FILE_UPDATE_FN ReportFn,
+    __in_opt PVOID Context,
+    __in DWORD MaxPerVolume,
+    __out PYORI_LIB_FILE_UPDATE_ENGINE *Engine
+    )
+{
+    PYORI_LIB_FILE_UPDATE_ENGINE NewEngine;
+
+    NewEngine = YoriLibMalloc(sizeof(YORI_LIB_FILE_UPDATE_ENGINE));
+    if (NewEngine == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(NewEngine, sizeof(YORI_LIB_FILE_UPDATE_ENGINE));
+    YoriLibInitializeListHead(&NewEngine->VolumeList);
+    NewEngine->UpdateFn = UpdateFn;
+    NewEngine->ReportFn = ReportFn;
+    NewEngine->Context = Context;
+
+    if (MaxPerVolume == 0) {
+        MaxPerVolume = YORI_LIB_FILE_UPDATE_DEFAULT_PER_VOLUME;
+    }
+    NewEngine->MaxPerVolume = MaxPerVolume;
+
+    if (!YoriLibCreateThreadPool(MaxPerVolume, YoriLibCpuClassAny, &NewEngine->Pool)) {
+        NewEngine->Pool = NULL;
+    }
+
+    *Engine = NewEngine;
+    return TRUE;
+}
+
+/**
+ Find the volume containing a file, or allocate a new volume if no update
+ has been queued against the volume previously.
+
+ @param Engine Pointer to the engine.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @return Pointer to the volume, or NULL on allocation failure.
+ */
+PYORI_LIB_FILE_UPDATE_VOLUME
+YoriLibFileUpdateFindVolume(
+    __in PYORI_LIB_FILE_UPDATE_ENGINE Engine,
+    __in PYORI_STRING FilePath
+    )
+{
+    PYORI_LIB_FILE_UPDATE_VOLUME Volume;
+    PYORI_LIST_ENTRY ListEntry;
+    YORI_STRING Root;
+    LONG MaxPerVolume;
+
+    //
+    //  If the path has no recognizable root, all such paths share a single
+    //  volume with an empty root.
+    //
+
+    if (!YoriLibFindEffRoot(FilePath, &Root)) {
+        YoriLibInitEmptyString(&Root);
+    }
+
+    Volume = Engine->LastVolume;
+    if (Volume != NULL && YoriLibCompareStringIns(&Volume->Root, &Root) == 0) {
+        return Volume;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&Engine->VolumeList, NULL);
+    while (ListEntry != NULL) {
+        Volume = CONTAINING_RECORD(ListEntry, YORI_LIB_FILE_UPDATE_VOLUME, ListEntry);
+        if (YoriLibCompareStringIns(&Volume->Root, &Root) == 0) {
+            Engine->LastVolume = Volume;
+            return Volume;
+        }
+        ListEntry = YoriLibGetNextListEntry(&Engine->VolumeList, ListEntry);
+    }
+
+    Volume = YoriLibMalloc((YORI_ALLOC_SIZE_T)(sizeof(YORI_LIB_FILE_UPDATE_VOLUME) + (Root.LengthInChars + 1) * sizeof(TCHAR)));
+    if (Volume == NULL) {
+        return NULL;
+    }
+
+    MaxPerVolume = (LONG)Engine->MaxPerVolume;
+    Volume->Semaphore = CreateSemaphore(NULL, MaxPerVolume, MaxPerVolume, NULL);
+    if (Volume->Semaphore == NULL) {
+        YoriLibFree(Volume);
+        return NULL;
+    }
+
+    YoriLibInitEmptyString(&Volume->Root);
+    Volume->Root.StartOfString = (LPTSTR)(Volume + 1);
+    Volume->Root.LengthInChars = Root.LengthInChars;
+    Volume->Root.LengthAllocated = Root.LengthInChars + 1;
+    if (Root.LengthInChars > 0) {
+        memcpy(Volume->Root.StartOfString, Root.StartOfString, Root.LengthInChars * sizeof(TCHAR));
+    }
+    Volume->Root.StartOfString[Root.LengthInChars] = '\0';
+
+    YoriLibAppendList(&Engine->VolumeList, &Volume->ListEntry);
+    Engine->LastVolume = Volume;
+    return Volume;
+}
+
+/**
+ Apply an update to a file on a worker thread.
+
+ @param Pool Pointer to the thread pool.
+
+ @param WorkItem Pointer to the work item within the update.
+ */
+VOID
+YoriLibFileUpdateExecute(
+    __in_opt PYORI_LIB_THREAD_POOL Pool,
+    __in PYORI_LIB_WORK_ITEM WorkItem
+    )
+{
+    PYORI_LIB_FILE_UPDATE_ITEM Item;
+    PYORI_LIB_FILE_UPDATE_ENGINE Engine;
+
+    UNREFERENCED_PARAMETER(Pool);
+
+    Item = CONTAINING_RECORD(WorkItem, YORI_LIB_FILE_UPDATE_ITEM, WorkItem);
+    Engine = Item->Engine;
+
+    Engine->UpdateFn(&Item->Update, Engine->Context);
+
+    //
+    //  The volume can accept another update as soon as this one has been
+    //  applied, without waiting for earlier updates to be reported.
+    //
+
+    if (Engine->Pool != NULL) {
+        ReleaseSemaphore(Item->Volume->Semaphore, 1, NULL);
+    }
+}
+
+/**
+ Report the result of an update and free it.  This is called for one update
+ at a time in the order that updates were queued.
+
+ @param Pool Pointer to the thread pool.
+
+ @param WorkItem Pointer to the work item within the update.
+ */
+VOID
+YoriLibFileUpdateComplete(
+    __in_opt PYORI_LIB_THREAD_POOL Pool,
+    __in PYORI_LIB_WORK_ITEM WorkItem
+    )
+{
+    PYORI_LIB_FILE_UPDATE_ITEM Item;
+    PYORI_LIB_FILE_UPDATE_ENGINE Engine;
+
+    UNREFERENCED_PARAMETER(Pool);
+
+    Item = CONTAINING_RECORD(WorkItem, YORI_LIB_FILE_UPDATE_ITEM, WorkItem);
+    Engine = Item->Engine;
+
+    if (Engine->ReportFn != NULL) {
+        Engine->ReportFn(&Item->Update, Engine->Context);
+    }
+
+    YoriLibFree(Item);
+}
+
+/**
+ Queue an update to a file.  If the volume containing the file already has
+ the maximum number of updates in progress, this waits for one of them to
+ finish, so the caller's enumeration proceeds no faster than updates can be
+ applied.
+
+ @param Engine Pointer to the engine.
+
+ @param FilePath Pointer to the full path to the file.  This is copied so
+        the caller can reuse it once this function returns.
+
+ @param FileInfo Optionally points to information about the file from
+        enumeration.  This is copied and provided to the update function so
+        that it can avoid querying information that enumeration already
+        returned.  If NULL, the update function is told that no information
+        is available, which may indicate the file does not exist.
+
+ @return TRUE if the update was queued, FALSE if memory could not be
+         allocated or the user cancelled the operation.  The caller is
+         expected to stop queueing updates if this returns FALSE.
+ */
+__success(return)
+BOOLEAN
+YoriLibQueueFileUpdate(
+    __in PYORI_LIB_FILE_UPDATE_ENGINE Engine,
+    __in PYORI_STRING FilePath,
+    __in_opt PWIN32_FIND_DATA FileInfo
+    )
+{
+    PYORI_LIB_FILE_UPDATE_ITEM Item;
+    PYORI_LIB_FILE_UPDATE_VOLUME Volume;
+    HANDLE WaitHandles[2];
+    DWORD HandleCount;
+    DWORD WaitResult;
+
+    Volume = YoriLibFileUpdateFindVolume(Engine, FilePath);
+    if (Volume == NULL) {
+        return FALSE;
+    }
+
+    Item = YoriLibMalloc((YORI_ALLOC_SIZE_T)(sizeof(YORI_LIB_FILE_UPDATE_ITEM) + (FilePath->LengthInChars + 1) * sizeof(TCHAR)));
+    if (Item == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(Item, sizeof(YORI_LIB_FILE_UPDATE_ITEM));
+    Item->Engine = Engine;
+    Item->Volume = Volume;
+    Item->WorkItem.ExecuteFn = YoriLibFileUpdateExecute;
+    Item->WorkItem.CompleteFn = YoriLibFileUpdateComplete;
+
+    YoriLibInitEmptyString(&Item->Update.FilePath);
+    Item->Update.FilePath.StartOfString = (LPTSTR)(Item + 1);
+    Item->Update.FilePath.LengthInChars = FilePath->LengthInChars;
+    Item->Update.FilePath.LengthAllocated = FilePath->LengthInChars + 1;
+    memcpy(Item->Update.FilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    Item->Update.FilePath.StartOfString[FilePath->LengthInChars] = '\0';
+
+    if (FileInfo != NULL) {
+        memcpy(&Item->FileInfo, FileInfo, sizeof(WIN32_FIND_DATA));
+        Item->Update.FileInfo = &Item->FileInfo;
+    }
+
+    if (Engine->Pool == NULL) {
+        YoriLibFileUpdateExecute(NULL, &Item->WorkItem);
+        YoriLibFileUpdateComplete(NULL, &Item->WorkItem);
+        return TRUE;
+    }
+
+    HandleCount = 0;
+    WaitHandles[HandleCount++] = Volume->Semaphore;
+    if (YoriLibCancelGetEvent() != NULL) {
+        WaitHandles[HandleCount++] = YoriLibCancelGetEvent();
+    }
+
+    WaitResult = WaitForMultipleObjects(HandleCount, WaitHandles, FALSE, INFINITE);
+    if (WaitResult != WAIT_OBJECT_0) {
+        YoriLibFree(Item);
+        return FALSE;
+    }
+
+    YoriLibSubmitWorkItem(Engine->Pool, &Item->WorkItem);
+    return TRUE;
+}
+
+/**
+ Wait for all queued updates to be applied and reported, and free the
+ engine.
+
+ @param Engine Pointer to the engine.
+ */
+VOID
+YoriLibDestroyFileUpdateEngine(
+    __in PYORI_LIB_FILE_UPDATE_ENGINE Engine
+    )
+{
+    PYORI_LIB_FILE_UPDATE_VOLUME Volume;
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (Engine->Pool != NULL) {
+        YoriLibWaitForThreadPool(Engine->Pool);
+        YoriLibDestroyThreadPool(Engine->Pool);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&Engine->VolumeList, NULL);
+    while (ListEntry != NULL) {
+        Volume = CONTAINING_RECORD(ListEntry, YORI_LIB_FILE_UPDATE_VOLUME, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Engine->VolumeList, ListEntry);
+        YoriLibRemoveListItem(&Volume->ListEntry);
+        CloseHandle(Volume->Semaphore);
+        YoriLibFree(Volume);
+    }
+
+    YoriLibFree(Engine);
+}
+
+// vim:sw=4:ts=4:et:
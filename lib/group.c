@@ -3,7 +3,7 @@
  *
  * Yori group membership routines
  *
- * Copyright (c) 2017-2018 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -29,38 +29,32 @@
 
 
 /**
- Query whether the specified group SID is present and enabled in the specified
- access token.
+ Query the groups contained in the specified access token.
 
  @param TokenHandle A handle to an access token. If NULL, the current thread's
         token is used if available, otherwise the current process's token.
 
- @param SidToCheck The group SID to check for.
-
- @param IsMember On successful completion, set to TRUE to indicate the SID is
-        present and enabled in the access token, FALSE if not.
+ @param Groups On successful completion, updated to point to the groups in
+        the token.  The caller should free this with @ref YoriLibFree .
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 __success(return)
 BOOL
-YoriLibCheckTokenMembership(
+YoriLibQueryTokenGroups(
     __in_opt HANDLE TokenHandle,
-    __in PSID SidToCheck,
-    __out PBOOL IsMember
+    __out PTOKEN_GROUPS *Groups
     )
 {
     BOOL TokenOpened = FALSE;
-    PTOKEN_GROUPS Groups;
+    PTOKEN_GROUPS LocalGroups;
     DWORD GroupsSize;
-    YORI_ALLOC_SIZE_T Count;
 
     YoriLibLoadAdvApi32Functions();
 
     if (DllAdvApi32.pOpenThreadToken == NULL ||
         DllAdvApi32.pOpenProcessToken == NULL ||
-        DllAdvApi32.pGetTokenInformation == NULL ||
-        DllAdvApi32.pEqualSid == NULL) {
+        DllAdvApi32.pGetTokenInformation == NULL) {
 
         return FALSE;
     }
@@ -85,19 +79,62 @@ YoriLibCheckTokenMembership(
         return FALSE;
     }
 
-    Groups = YoriLibMalloc(GroupsSize);
-    if (Groups == NULL) {
+    LocalGroups = YoriLibMalloc(GroupsSize);
+    if (LocalGroups == NULL) {
         if (TokenOpened) {
             CloseHandle(TokenHandle);
         }
         return FALSE;
     }
 
-    if (!DllAdvApi32.pGetTokenInformation(TokenHandle, TokenGroups, Groups, GroupsSize, &GroupsSize)) {
+    if (!DllAdvApi32.pGetTokenInformation(TokenHandle, TokenGroups, LocalGroups, GroupsSize, &GroupsSize)) {
         if (TokenOpened) {
             CloseHandle(TokenHandle);
         }
-        YoriLibFree(Groups);
+        YoriLibFree(LocalGroups);
+        return FALSE;
+    }
+
+    if (TokenOpened) {
+        CloseHandle(TokenHandle);
+    }
+
+    *Groups = LocalGroups;
+    return TRUE;
+}
+
+/**
+ Query whether the specified group SID is present and enabled in the specified
+ access token.
+
+ @param TokenHandle A handle to an access token. If NULL, the current thread's
+        token is used if available, otherwise the current process's token.
+
+ @param SidToCheck The group SID to check for.
+
+ @param IsMember On successful completion, set to TRUE to indicate the SID is
+        present and enabled in the access token, FALSE if not.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibCheckTokenMembership(
+    __in_opt HANDLE TokenHandle,
+    __in PSID SidToCheck,
+    __out PBOOL IsMember
+    )
+{
+    PTOKEN_GROUPS Groups;
+    YORI_ALLOC_SIZE_T Count;
+
+    YoriLibLoadAdvApi32Functions();
+
+    if (DllAdvApi32.pEqualSid == NULL) {
+        return FALSE;
+    }
+
+    if (!YoriLibQueryTokenGroups(TokenHandle, &Groups)) {
         return FALSE;
     }
 
@@ -112,9 +149,6 @@ YoriLibCheckTokenMembership(
         }
     }
 
-    if (TokenOpened) {
-        CloseHandle(TokenHandle);
-    }
     YoriLibFree(Groups);
     return TRUE;
 }
@@ -3,7 +3,7 @@
  *
  * Yori hash table manipulation routines
  *
- * Copyright (c) 2018 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -29,16 +29,20 @@
 
 
 /**
- Allocate an empty hash table.
+ Allocate an empty hash table with a specified hash function.
 
  @param NumberBuckets The number of buckets to allocate into the hash table.
 
+ @param HashFunction Optionally points to the function to use to hash keys.
+        If not specified, @ref YoriLibHashString32 is used.
+
  @return On successful completion, points to the resulting hash table.
          On allocation failure, returns NULL.
  */
 PYORI_HASH_TABLE
-YoriLibAllocateHashTable(
-    __in YORI_ALLOC_SIZE_T NumberBuckets
+YoriLibAllocateHashTableEx(
+    __in YORI_ALLOC_SIZE_T NumberBuckets,
+    __in_opt PYORI_HASH_STRING_FN HashFunction
     )
 {
     DWORD SizeNeeded = sizeof(YORI_HASH_TABLE) + NumberBuckets * sizeof(YORI_HASH_BUCKET);
@@ -54,7 +58,12 @@ YoriLibAllocateHashTable(
         return NULL;
     }
 
+    if (HashFunction == NULL) {
+        HashFunction = YoriLibHashString32;
+    }
+
     HashTable->NumberBuckets = NumberBuckets;
+    HashTable->HashFunction = HashFunction;
     HashTable->Buckets = (PYORI_HASH_BUCKET)(HashTable + 1);
 
     for (BucketIndex = 0; BucketIndex < NumberBuckets; BucketIndex++) {
@@ -64,6 +73,22 @@ YoriLibAllocateHashTable(
     return HashTable;
 }
 
+/**
+ Allocate an empty hash table using the default hash function.
+
+ @param NumberBuckets The number of buckets to allocate into the hash table.
+
+ @return On successful completion, points to the resulting hash table.
+         On allocation failure, returns NULL.
+ */
+PYORI_HASH_TABLE
+YoriLibAllocateHashTable(
+    __in YORI_ALLOC_SIZE_T NumberBuckets
+    )
+{
+    return YoriLibAllocateHashTableEx(NumberBuckets, NULL);
+}
+
 /**
  Free a hash table.  This assumes the caller has already removed and
  performed all necessary cleanup for any objects within it.
@@ -110,7 +135,7 @@ YoriLibHashString32(
 
     Hash = InitialHash;
     for (Index = 0; Index < String->LengthInChars; Index++) {
-        Hash = (Hash << 3) ^ YoriLibUpcaseChar(String->StartOfString[Index]) ^ (Hash >> 29);
+        Hash = (Hash << 3) ^ YoriLibUpcaseCharInline(String->StartOfString[Index]) ^ (Hash >> 29);
     }
 
     //
@@ -149,6 +174,161 @@ YoriLibHashString(
     return (WORD)Hash;
 }
 
+/**
+ The FNV-1a prime used to combine each pair of characters into the hash.
+ */
+#define YORI_HASH_FNV_PRIME (0x01000193)
+
+/**
+ The FNV-1a offset basis, used to seed the hash.
+ */
+#define YORI_HASH_FNV_OFFSET (0x811c9dc5)
+
+/**
+ Hash a yori string into a 32 bit hash value without regard to case.  This
+ is an FNV-1a style hash which consumes two characters per step and applies
+ a final avalanche, so every bit of the result, including the low bits used
+ to select a bucket, depends on every character of the string.  It produces
+ different values to @ref YoriLibHashString32 and should be used where the
+ hash is not persisted.
+
+ @param InitialHash The starting value to use for the hash.
+
+ @param String The string to generate a hash for.
+
+ @return A 32 bit hash value for the string.
+ */
+DWORD
+YoriLibHashStringFnv32(
+    __in DWORD InitialHash,
+    __in PCYORI_STRING String
+    )
+{
+    DWORD Hash;
+    DWORD Index;
+    DWORD Pair;
+    DWORD LowerMask;
+    LPCTSTR Chars;
+
+    Hash = InitialHash ^ YORI_HASH_FNV_OFFSET;
+    Chars = String->StartOfString;
+
+    for (Index = 0; Index < String->LengthInChars; Index += 2) {
+        if (Index + 1 < String->LengthInChars) {
+            Pair = (DWORD)(WORD)Chars[Index] | ((DWORD)(WORD)Chars[Index + 1] << 16);
+        } else {
+            Pair = (DWORD)(WORD)Chars[Index];
+        }
+
+        //
+        //  If both characters are ASCII, upcase both at once.  Adding 0x1F
+        //  sets bit 7 of a character that is at least 'a', and adding 0x05
+        //  sets bit 7 of a character that is above 'z'.  Neither can carry
+        //  into the neighbouring character.  Where exactly one is set the
+        //  character is lowercase, so clear its 0x20 bit.  Otherwise fold
+        //  each character individually.
+        //
+
+        if ((Pair & 0xFF80FF80) == 0) {
+            LowerMask = ((Pair + 0x001F001F) ^ (Pair + 0x00050005)) & 0x00800080;
+            Pair = Pair ^ (LowerMask >> 2);
+        } else {
+            Pair = (DWORD)(WORD)YoriLibUpcaseChar((TCHAR)(Pair & 0xFFFF)) |
+                   ((DWORD)(WORD)YoriLibUpcaseChar((TCHAR)(Pair >> 16)) << 16);
+        }
+
+        //
+        //  Multiplication only moves bits upward, so fold the high bits back
+        //  down after each step so that the upper character of each pair
+        //  influences subsequent steps.
+        //
+
+        Hash = (Hash ^ Pair) * YORI_HASH_FNV_PRIME;
+        Hash = Hash ^ (Hash >> 15);
+    }
+
+    Hash = Hash ^ (Hash >> 16);
+    Hash = Hash * 0x7feb352d;
+    Hash = Hash ^ (Hash >> 15);
+    Hash = Hash * 0x846ca68b;
+    Hash = Hash ^ (Hash >> 16);
+
+    return Hash;
+}
+
+/**
+ Hash a yori string into a 32 bit hash value, where strings which differ
+ only in case produce different values.  This is the same as
+ @ref YoriLibHashStringFnv32 without upcasing each character.
+
+ @param InitialHash The starting value to use for the hash.
+
+ @param String The string to generate a hash for.
+
+ @return A 32 bit hash value for the string.
+ */
+DWORD
+YoriLibHashStringCaseSensitiveFnv32(
+    __in DWORD InitialHash,
+    __in PCYORI_STRING String
+    )
+{
+    DWORD Hash;
+    DWORD Index;
+    DWORD Pair;
+    LPCTSTR Chars;
+
+    Hash = InitialHash ^ YORI_HASH_FNV_OFFSET;
+    Chars = String->StartOfString;
+
+    for (Index = 0; Index < String->LengthInChars; Index += 2) {
+        if (Index + 1 < String->LengthInChars) {
+            Pair = (DWORD)(WORD)Chars[Index] | ((DWORD)(WORD)Chars[Index + 1] << 16);
+        } else {
+            Pair = (DWORD)(WORD)Chars[Index];
+        }
+
+        Hash = (Hash ^ Pair) * YORI_HASH_FNV_PRIME;
+        Hash = Hash ^ (Hash >> 15);
+    }
+
+    Hash = Hash ^ (Hash >> 16);
+    Hash = Hash * 0x7feb352d;
+    Hash = Hash ^ (Hash >> 15);
+    Hash = Hash * 0x846ca68b;
+    Hash = Hash ^ (Hash >> 16);
+
+    return Hash;
+}
+
+/**
+ Determine the bucket index for a key within a chained hash table.
+
+ @param HashTable Pointer to the hash table.
+
+ @param KeyString Pointer to the key.
+
+ @return The index of the bucket which would contain the key.
+ */
+DWORD
+YoriLibHashBucketForKey(
+    __in PYORI_HASH_TABLE HashTable,
+    __in PCYORI_STRING KeyString
+    )
+{
+    DWORD Hash;
+
+    //
+    //  Move some high bits into the low bits since the low bits
+    //  will likely be used as a bucket index.  This is the same
+    //  folding performed by YoriLibHashString.
+    //
+
+    Hash = HashTable->HashFunction(0, KeyString);
+    Hash = (WORD)(Hash ^ (Hash >> 16));
+    return Hash % HashTable->NumberBuckets;
+}
+
 /**
  Insert an object with a string based key into the hash table.
 
@@ -170,7 +350,7 @@ YoriLibHashInsertByKey(
     __out PYORI_HASH_ENTRY HashEntry
     )
 {
-    DWORD BucketIndex = YoriLibHashString(KeyString) % HashTable->NumberBuckets;
+    DWORD BucketIndex = YoriLibHashBucketForKey(HashTable, KeyString);
 
     YoriLibCloneString(&HashEntry->Key, KeyString);
     HashEntry->Context = Context;
@@ -193,7 +373,7 @@ YoriLibHashLookupByKey(
     __in PCYORI_STRING KeyString
     )
 {
-    DWORD BucketIndex = YoriLibHashString(KeyString) % HashTable->NumberBuckets;
+    DWORD BucketIndex = YoriLibHashBucketForKey(HashTable, KeyString);
     PYORI_LIST_ENTRY ListEntry;
     PYORI_HASH_ENTRY HashEntry;
 
@@ -251,4 +431,562 @@ YoriLibHashRemoveByKey(
     return Entry;
 }
 
+/**
+ The minimum number of slots in an open addressing hash table.  This must be
+ a power of two.
+ */
+#define YORI_OPEN_HASH_MIN_SLOTS (16)
+
+/**
+ Allocate and initialize the slot array for an open addressing hash table,
+ moving any existing entries into the new array.
+
+ @param HashTable Pointer to the hash table.
+
+ @param NumberSlots The number of slots to allocate.  This must be a power of
+        two and must be greater than the number of entries in the table.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibOpenHashResize(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in YORI_ALLOC_SIZE_T NumberSlots
+    )
+{
+    PYORI_OPEN_HASH_SLOT NewSlots;
+    PYORI_OPEN_HASH_ENTRY Entry;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T SlotIndex;
+    YORI_ALLOC_SIZE_T Mask;
+
+    ASSERT(NumberSlots > HashTable->NumberEntries);
+    ASSERT((NumberSlots & (NumberSlots - 1)) == 0);
+
+    if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)NumberSlots * sizeof(YORI_OPEN_HASH_SLOT))) {
+        return FALSE;
+    }
+
+    NewSlots = YoriLibMalloc(NumberSlots * sizeof(YORI_OPEN_HASH_SLOT));
+    if (NewSlots == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(NewSlots, NumberSlots * sizeof(YORI_OPEN_HASH_SLOT));
+    Mask = NumberSlots - 1;
+
+    for (Index = 0; Index < HashTable->NumberSlots; Index++) {
+        Entry = HashTable->Slots[Index].Entry;
+        if (Entry == NULL) {
+            continue;
+        }
+
+        SlotIndex = HashTable->Slots[Index].Hash & Mask;
+        while (NewSlots[SlotIndex].Entry != NULL) {
+            SlotIndex = (SlotIndex + 1) & Mask;
+        }
+
+        NewSlots[SlotIndex].Hash = HashTable->Slots[Index].Hash;
+        NewSlots[SlotIndex].Entry = Entry;
+        Entry->SlotIndex = SlotIndex;
+    }
+
+    if (HashTable->Slots != NULL) {
+        YoriLibFree(HashTable->Slots);
+    }
+
+    HashTable->Slots = NewSlots;
+    HashTable->NumberSlots = NumberSlots;
+    return TRUE;
+}
+
+/**
+ Allocate an empty open addressing hash table with a specified hash
+ function.  Unlike @ref YoriLibAllocateHashTable , this table grows as
+ entries are inserted, so the number of entries specified here is only used
+ to avoid resizing while the table is being populated.
+
+ @param ExpectedEntries The number of entries the caller expects to insert.
+        This can be zero.
+
+ @param HashFunction Optionally points to the function to use to hash keys.
+        If not specified, @ref YoriLibHashStringFnv32 is used.
+
+ @return On successful completion, points to the resulting hash table.
+         On allocation failure, returns NULL.
+ */
+PYORI_OPEN_HASH_TABLE
+YoriLibAllocateOpenHashTableEx(
+    __in YORI_ALLOC_SIZE_T ExpectedEntries,
+    __in_opt PYORI_HASH_STRING_FN HashFunction
+    )
+{
+    PYORI_OPEN_HASH_TABLE HashTable;
+    YORI_ALLOC_SIZE_T NumberSlots;
+
+    //
+    //  Keep the table no more than three quarters full.
+    //
+
+    NumberSlots = YORI_OPEN_HASH_MIN_SLOTS;
+    while (NumberSlots / 4 * 3 < ExpectedEntries) {
+        if (NumberSlots >= YORI_MAX_ALLOC_SIZE / 2) {
+            return NULL;
+        }
+        NumberSlots = NumberSlots * 2;
+    }
+
+    HashTable = YoriLibReferencedMalloc(sizeof(YORI_OPEN_HASH_TABLE));
+    if (HashTable == NULL) {
+        return NULL;
+    }
+
+    if (HashFunction == NULL) {
+        HashFunction = YoriLibHashStringFnv32;
+    }
+
+    HashTable->NumberSlots = 0;
+    HashTable->NumberEntries = 0;
+    HashTable->HashFunction = HashFunction;
+    HashTable->Slots = NULL;
+
+    if (!YoriLibOpenHashResize(HashTable, NumberSlots)) {
+        YoriLibDereference(HashTable);
+        return NULL;
+    }
+
+    return HashTable;
+}
+
+/**
+ Allocate an empty open addressing hash table using the default hash
+ function.
+
+ @param ExpectedEntries The number of entries the caller expects to insert.
+        This can be zero.
+
+ @return On successful completion, points to the resulting hash table.
+         On allocation failure, returns NULL.
+ */
+PYORI_OPEN_HASH_TABLE
+YoriLibAllocateOpenHashTable(
+    __in YORI_ALLOC_SIZE_T ExpectedEntries
+    )
+{
+    return YoriLibAllocateOpenHashTableEx(ExpectedEntries, NULL);
+}
+
+/**
+ Free an open addressing hash table.  This assumes the caller has already
+ removed and performed all necessary cleanup for any objects within it.
+
+ @param HashTable Pointer to the hash table to deallocate.
+ */
+VOID
+YoriLibFreeEmptyOpenHashTable(
+    __in PYORI_OPEN_HASH_TABLE HashTable
+    )
+{
+    ASSERT(HashTable->NumberEntries == 0);
+
+    if (HashTable->Slots != NULL) {
+        YoriLibFree(HashTable->Slots);
+    }
+
+    YoriLibDereference(HashTable);
+}
+
+/**
+ Insert an object with a string based key into an open addressing hash
+ table.  If the table is becoming full, it is grown.
+
+ @param HashTable The hash table to insert the object into.
+
+ @param KeyString Pointer to a Yori string describing the key for the
+        entry.
+
+ @param Context Pointer to a blob of data which is meaningful to the caller.
+
+ @param HashEntry On successful completion, populated with structures
+        describing the entry within the hash table.
+
+ @return TRUE to indicate the entry was inserted, FALSE to indicate it could
+         not be inserted due to allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibOpenHashInsertByKey(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in PYORI_STRING KeyString,
+    __in PVOID Context,
+    __out PYORI_OPEN_HASH_ENTRY HashEntry
+    )
+{
+    DWORD Hash;
+    YORI_ALLOC_SIZE_T SlotIndex;
+    YORI_ALLOC_SIZE_T Mask;
+
+    //
+    //  Grow the table if it would become more than three quarters full.
+    //  If this fails, the insert can still proceed as long as one slot
+    //  remains empty, which is needed for lookups to terminate.
+    //
+
+    if (HashTable->NumberEntries + 1 > HashTable->NumberSlots / 4 * 3) {
+        if (HashTable->NumberSlots >= YORI_MAX_ALLOC_SIZE / 2 ||
+            !YoriLibOpenHashResize(HashTable, HashTable->NumberSlots * 2)) {
+
+            if (HashTable->NumberEntries + 1 >= HashTable->NumberSlots) {
+                return FALSE;
+            }
+        }
+    }
+
+    Hash = HashTable->HashFunction(0, KeyString);
+    Mask = HashTable->NumberSlots - 1;
+    SlotIndex = Hash & Mask;
+    while (HashTable->Slots[SlotIndex].Entry != NULL) {
+        SlotIndex = (SlotIndex + 1) & Mask;
+    }
+
+    YoriLibCloneString(&HashEntry->Key, KeyString);
+    HashEntry->Context = Context;
+    HashEntry->HashTable = HashTable;
+    HashEntry->SlotIndex = SlotIndex;
+    HashTable->Slots[SlotIndex].Hash = Hash;
+    HashTable->Slots[SlotIndex].Entry = HashEntry;
+    HashTable->NumberEntries++;
+
+    return TRUE;
+}
+
+/**
+ Locate an object within an open addressing hash table by a specified key.
+
+ @param HashTable Pointer to the hash table to search for the object.
+
+ @param KeyString Pointer to the key to identify the object.
+
+ @return Pointer to the entry within the hash table if a match is found.
+         If no match is found, returns NULL.
+ */
+PYORI_OPEN_HASH_ENTRY
+YoriLibOpenHashLookupByKey(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in PCYORI_STRING KeyString
+    )
+{
+    DWORD Hash;
+    YORI_ALLOC_SIZE_T SlotIndex;
+    YORI_ALLOC_SIZE_T Mask;
+    PYORI_OPEN_HASH_SLOT Slot;
+
+    Hash = HashTable->HashFunction(0, KeyString);
+    Mask = HashTable->NumberSlots - 1;
+    SlotIndex = Hash & Mask;
+
+    while (TRUE) {
+        Slot = &HashTable->Slots[SlotIndex];
+        if (Slot->Entry == NULL) {
+            break;
+        }
+
+        if (Slot->Hash == Hash &&
+            YoriLibCompareStringIns(KeyString, &Slot->Entry->Key) == 0) {
+
+            return Slot->Entry;
+        }
+        SlotIndex = (SlotIndex + 1) & Mask;
+    }
+
+    return NULL;
+}
+
+/**
+ Remove an entry from an open addressing hash table.  This routine assumes
+ the entry must already be inserted into a hash table.
+
+ @param HashEntry The entry to remove.
+ */
+VOID
+YoriLibOpenHashRemoveByEntry(
+    __in PYORI_OPEN_HASH_ENTRY HashEntry
+    )
+{
+    PYORI_OPEN_HASH_TABLE HashTable;
+    YORI_ALLOC_SIZE_T EmptyIndex;
+    YORI_ALLOC_SIZE_T SlotIndex;
+    YORI_ALLOC_SIZE_T HomeIndex;
+    YORI_ALLOC_SIZE_T Mask;
+    BOOLEAN CanMove;
+
+    HashTable = HashEntry->HashTable;
+    Mask = HashTable->NumberSlots - 1;
+    EmptyIndex = HashEntry->SlotIndex;
+    ASSERT(HashTable->Slots[EmptyIndex].Entry == HashEntry);
+
+    HashTable->Slots[EmptyIndex].Entry = NULL;
+    HashTable->NumberEntries--;
+
+    //
+    //  Rather than leaving a tombstone, move any following entries whose
+    //  probe sequence passes through the now empty slot back into it, so
+    //  that lookups can continue to terminate at the first empty slot.
+    //
+
+    SlotIndex = EmptyIndex;
+    while (TRUE) {
+        SlotIndex = (SlotIndex + 1) & Mask;
+        if (HashTable->Slots[SlotIndex].Entry == NULL) {
+            break;
+        }
+
+        //
+        //  The entry can only be moved if its natural slot is not
+        //  cyclically between the empty slot and its current slot.
+        //
+
+        HomeIndex = HashTable->Slots[SlotIndex].Hash & Mask;
+        if (EmptyIndex <= SlotIndex) {
+            CanMove = (BOOLEAN)(HomeIndex <= EmptyIndex || HomeIndex > SlotIndex);
+        } else {
+            CanMove = (BOOLEAN)(HomeIndex <= EmptyIndex && HomeIndex > SlotIndex);
+        }
+
+        if (CanMove) {
+            HashTable->Slots[EmptyIndex].Hash = HashTable->Slots[SlotIndex].Hash;
+            HashTable->Slots[EmptyIndex].Entry = HashTable->Slots[SlotIndex].Entry;
+            HashTable->Slots[EmptyIndex].Entry->SlotIndex = EmptyIndex;
+            HashTable->Slots[SlotIndex].Entry = NULL;
+            EmptyIndex = SlotIndex;
+        }
+    }
+
+    HashEntry->HashTable = NULL;
+    YoriLibFreeStringContents(&HashEntry->Key);
+}
+
+/**
+ Remove a hash entry from an open addressing hash table by performing a
+ lookup by key.
+
+ @param HashTable The hash table to remove the entry from.
+
+ @param KeyString The key matching the object to remove.
+
+ @return Pointer to the entry if one was removed, or NULL if no match was
+         found.
+ */
+PYORI_OPEN_HASH_ENTRY
+YoriLibOpenHashRemoveByKey(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in PYORI_STRING KeyString
+    )
+{
+    PYORI_OPEN_HASH_ENTRY Entry;
+    Entry = YoriLibOpenHashLookupByKey(HashTable, KeyString);
+    if (Entry != NULL) {
+        YoriLibOpenHashRemoveByEntry(Entry);
+    }
+
+    return Entry;
+}
+
+/**
+ Allocate an empty atom table.  Strings interned into the table share a
+ single allocation, so programs which refer to the same name from many
+ structures only hold one copy of it.
+
+ @param ExpectedEntries The number of strings the caller expects to intern.
+        This can be zero.
+
+ @return On successful completion, points to the resulting atom table.
+         On allocation failure, returns NULL.
+ */
+PYORI_LIB_ATOM_TABLE
+YoriLibAllocateAtomTable(
+    __in YORI_ALLOC_SIZE_T ExpectedEntries
+    )
+{
+    PYORI_LIB_ATOM_TABLE AtomTable;
+
+    AtomTable = YoriLibMalloc(sizeof(YORI_LIB_ATOM_TABLE));
+    if (AtomTable == NULL) {
+        return NULL;
+    }
+
+    AtomTable->HashTable = YoriLibAllocateOpenHashTable(ExpectedEntries);
+    if (AtomTable->HashTable == NULL) {
+        YoriLibFree(AtomTable);
+        return NULL;
+    }
+
+    YoriLibInitializeListHead(&AtomTable->AtomList);
+    return AtomTable;
+}
+
+/**
+ Remove an atom from its table and release the table's reference on its
+ memory.
+
+ @param Atom Pointer to the atom to remove.
+ */
+VOID
+YoriLibRemoveAtom(
+    __in PYORI_LIB_ATOM Atom
+    )
+{
+    YoriLibOpenHashRemoveByEntry(&Atom->HashEntry);
+    YoriLibRemoveListItem(&Atom->ListEntry);
+    YoriLibDereference(Atom);
+}
+
+/**
+ Free an atom table along with any atoms that are still within it.  Atoms
+ from the table cannot be used after this point, although any strings
+ cloned from them remain valid.
+
+ @param AtomTable Pointer to the atom table to deallocate.
+ */
+VOID
+YoriLibFreeAtomTable(
+    __in PYORI_LIB_ATOM_TABLE AtomTable
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIB_ATOM Atom;
+
+    ListEntry = YoriLibGetNextListEntry(&AtomTable->AtomList, NULL);
+    while (ListEntry != NULL) {
+        Atom = CONTAINING_RECORD(ListEntry, YORI_LIB_ATOM, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&AtomTable->AtomList, ListEntry);
+        YoriLibRemoveAtom(Atom);
+    }
+
+    YoriLibFreeEmptyOpenHashTable(AtomTable->HashTable);
+    YoriLibFree(AtomTable);
+}
+
+/**
+ Find an existing atom matching a string, ignoring case.  This does not
+ create an atom or take a reference on it.
+
+ @param AtomTable Pointer to the atom table.
+
+ @param String Pointer to the string to find.
+
+ @return Pointer to the atom, or NULL if the string has not been interned.
+ */
+PYORI_LIB_ATOM
+YoriLibLookupAtom(
+    __in PYORI_LIB_ATOM_TABLE AtomTable,
+    __in PCYORI_STRING String
+    )
+{
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+
+    HashEntry = YoriLibOpenHashLookupByKey(AtomTable->HashTable, String);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+
+    return HashEntry->Context;
+}
+
+/**
+ Intern a string, returning the existing atom if one matches the string
+ ignoring case, or creating a new atom if not.  The caller owns a reference
+ on the returned atom and should release it with @ref YoriLibReleaseAtom ,
+ or leave it to be released by @ref YoriLibFreeAtomTable .
+
+ @param AtomTable Pointer to the atom table.
+
+ @param String Pointer to the string to intern.  This string is copied if a
+        new atom is created, so it can be in a buffer that will be reused.
+
+ @return Pointer to the atom, or NULL on allocation failure.
+ */
+PYORI_LIB_ATOM
+YoriLibInternString(
+    __in PYORI_LIB_ATOM_TABLE AtomTable,
+    __in PCYORI_STRING String
+    )
+{
+    PYORI_LIB_ATOM Atom;
+    YORI_MAX_UNSIGNED_T SizeNeeded;
+
+    Atom = YoriLibLookupAtom(AtomTable, String);
+    if (Atom != NULL) {
+        Atom->ReferenceCount++;
+        return Atom;
+    }
+
+    //
+    //  The characters follow the atom in the same allocation, and the
+    //  string refers to that allocation so that it can be cloned.
+    //
+
+    SizeNeeded = sizeof(YORI_LIB_ATOM) + ((YORI_MAX_UNSIGNED_T)String->LengthInChars + 1) * sizeof(TCHAR);
+    if (!YoriLibIsSizeAllocatable(SizeNeeded)) {
+        return NULL;
+    }
+
+    Atom = YoriLibReferencedMalloc((YORI_ALLOC_SIZE_T)SizeNeeded);
+    if (Atom == NULL) {
+        return NULL;
+    }
+
+    YoriLibInitEmptyString(&Atom->String);
+    Atom->String.MemoryToFree = Atom;
+    Atom->String.StartOfString = (LPTSTR)(Atom + 1);
+    memcpy(Atom->String.StartOfString, String->StartOfString, String->LengthInChars * sizeof(TCHAR));
+    Atom->String.StartOfString[String->LengthInChars] = '\0';
+    Atom->String.LengthInChars = String->LengthInChars;
+    Atom->String.LengthAllocated = String->LengthInChars + 1;
+    Atom->Hash = YoriLibHashStringCaseSensitiveFnv32(0, &Atom->String);
+    Atom->FoldedHash = YoriLibHashStringFnv32(0, &Atom->String);
+    Atom->ReferenceCount = 1;
+
+    if (!YoriLibOpenHashInsertByKey(AtomTable->HashTable, &Atom->String, Atom, &Atom->HashEntry)) {
+        YoriLibDereference(Atom);
+        return NULL;
+    }
+
+    YoriLibAppendList(&AtomTable->AtomList, &Atom->ListEntry);
+    return Atom;
+}
+
+/**
+ Take an additional reference on an atom.
+
+ @param Atom Pointer to the atom.
+ */
+VOID
+YoriLibReferenceAtom(
+    __in PYORI_LIB_ATOM Atom
+    )
+{
+    ASSERT(Atom->ReferenceCount > 0);
+    Atom->ReferenceCount++;
+}
+
+/**
+ Release a reference on an atom.  When the final reference is released the
+ atom is removed from its table.
+
+ @param Atom Pointer to the atom.
+ */
+VOID
+YoriLibReleaseAtom(
+    __in PYORI_LIB_ATOM Atom
+    )
+{
+    ASSERT(Atom->ReferenceCount > 0);
+    Atom->ReferenceCount--;
+    if (Atom->ReferenceCount == 0) {
+        YoriLibRemoveAtom(Atom);
+    }
+}
+
 // vim:sw=4:ts=4:et:
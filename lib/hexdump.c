@@ -623,6 +623,156 @@ YoriLibHexDumpWriteOffset(
 
 }
 
+/**
+ The number of bytes compared at a time when YoriLibHexDiff is looking for
+ the next line that differs.  This must be a multiple of
+ YORI_LIB_HEXDUMP_BYTES_PER_LINE.
+ */
+#define YORI_LIB_HEX_DIFF_COMPARE_BLOCK (4096)
+
+/**
+ The largest number of characters that YoriLibHexFullLineToBuffer can
+ generate.  This is the C style prefix, six characters per byte, and a
+ separator followed by a character per byte.
+ */
+#define YORI_LIB_HEX_FULL_LINE_MAX_CHARS (8 + 6 * YORI_LIB_HEXDUMP_BYTES_PER_LINE + 1 + YORI_LIB_HEXDUMP_BYTES_PER_LINE)
+
+/**
+ A table of the two hex digits to display for each byte value.
+ */
+TCHAR YoriLibHexPairTable[256][2];
+
+/**
+ A table of the character to display for each byte value, which is the
+ byte itself if it is printable or a period if it is not.
+ */
+TCHAR YoriLibHexCharTable[256];
+
+/**
+ TRUE once YoriLibHexPairTable and YoriLibHexCharTable have been populated.
+ */
+BOOLEAN YoriLibHexTablesInitialized;
+
+/**
+ Populate the tables used to format full lines.  If two threads race to do
+ this, both write identical values, so no synchronization is needed.
+ */
+VOID
+YoriLibHexInitializeTables(VOID)
+{
+    DWORD Index;
+
+    for (Index = 0; Index < 256; Index++) {
+        YoriLibHexPairTable[Index][0] = HEX_DIGIT_FROM_VALUE(Index >> 4);
+        YoriLibHexPairTable[Index][1] = HEX_DIGIT_FROM_VALUE(Index);
+        if (YoriLibIsCharPrintable((WCHAR)Index)) {
+            YoriLibHexCharTable[Index] = (TCHAR)Index;
+        } else {
+            YoriLibHexCharTable[Index] = '.';
+        }
+    }
+
+    YoriLibHexTablesInitialized = TRUE;
+}
+
+/**
+ Generate the hex and character portion of a line that contains a full
+ YORI_LIB_HEXDUMP_BYTES_PER_LINE bytes with no highlighting.  This produces
+ the same output as the per word routines above, but formats each byte with
+ a table lookup rather than assembling and shifting each word.
+
+ @param Output Pointer to a buffer to populate with the result.  This must
+        be able to hold YORI_LIB_HEX_FULL_LINE_MAX_CHARS characters.
+
+ @param Buffer Pointer to YORI_LIB_HEXDUMP_BYTES_PER_LINE bytes to display.
+
+ @param BytesPerWord The number of bytes to display at a time.
+
+ @param DumpFlags Flags for the operation.  If YORI_LIB_HEX_FLAG_C_STYLE is
+        specified, every byte is followed by a comma, so this should not be
+        used for the final line.
+
+ @return The number of characters written to Output.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibHexFullLineToBuffer(
+    __out_ecount(YORI_LIB_HEX_FULL_LINE_MAX_CHARS) LPTSTR Output,
+    __in CONST UCHAR * Buffer,
+    __in DWORD BytesPerWord,
+    __in DWORD DumpFlags
+    )
+{
+    LPTSTR Ptr;
+    DWORD WordIndex;
+    DWORD ByteIndex;
+    TCHAR CONST * Pair;
+    UCHAR Low;
+    UCHAR High;
+    TCHAR TCharToDisplay;
+
+    if (!YoriLibHexTablesInitialized) {
+        YoriLibHexInitializeTables();
+    }
+
+    Ptr = Output;
+
+    if (DumpFlags & YORI_LIB_HEX_FLAG_C_STYLE) {
+        for (ByteIndex = 0; ByteIndex < 8; ByteIndex++) {
+            *(Ptr++) = ' ';
+        }
+        for (ByteIndex = 0; ByteIndex < YORI_LIB_HEXDUMP_BYTES_PER_LINE; ByteIndex++) {
+            Pair = YoriLibHexPairTable[Buffer[ByteIndex]];
+            Ptr[0] = '0';
+            Ptr[1] = 'x';
+            Ptr[2] = Pair[0];
+            Ptr[3] = Pair[1];
+            Ptr[4] = ',';
+            Ptr[5] = ' ';
+            Ptr = Ptr + 6;
+        }
+    } else {
+
+        //
+        //  Words are little endian, so display the bytes within each word
+        //  from last to first.  Eight byte words separate their high and
+        //  low halves with a backtick.
+        //
+
+        for (WordIndex = 0; WordIndex < YORI_LIB_HEXDUMP_BYTES_PER_LINE; WordIndex = WordIndex + BytesPerWord) {
+            for (ByteIndex = BytesPerWord; ByteIndex > 0; ByteIndex--) {
+                Pair = YoriLibHexPairTable[Buffer[WordIndex + ByteIndex - 1]];
+                Ptr[0] = Pair[0];
+                Ptr[1] = Pair[1];
+                Ptr = Ptr + 2;
+                if (ByteIndex == sizeof(DWORD) + 1 && BytesPerWord == sizeof(DWORDLONG)) {
+                    *(Ptr++) = '`';
+                }
+            }
+            *(Ptr++) = ' ';
+        }
+    }
+
+    if (DumpFlags & YORI_LIB_HEX_FLAG_DISPLAY_CHARS) {
+        *(Ptr++) = ' ';
+        for (ByteIndex = 0; ByteIndex < YORI_LIB_HEXDUMP_BYTES_PER_LINE; ByteIndex++) {
+            *(Ptr++) = YoriLibHexCharTable[Buffer[ByteIndex]];
+        }
+    } else if (DumpFlags & YORI_LIB_HEX_FLAG_DISPLAY_WCHARS) {
+        *(Ptr++) = ' ';
+        for (WordIndex = 0; WordIndex < YORI_LIB_HEXDUMP_BYTES_PER_LINE / sizeof(TCHAR); WordIndex++) {
+            Low = Buffer[WordIndex * sizeof(TCHAR)];
+            High = Buffer[WordIndex * sizeof(TCHAR) + 1];
+            TCharToDisplay = (TCHAR)((High << 8) + Low);
+            if (!YoriLibIsCharPrintable(TCharToDisplay)) {
+                TCharToDisplay = '.';
+            }
+            *(Ptr++) = TCharToDisplay;
+        }
+    }
+
+    return (YORI_ALLOC_SIZE_T)(Ptr - Output);
+}
+
 /**
  Generate a line of hex string into a caller supplied buffer.
 
@@ -687,6 +837,20 @@ YoriLibHexLineToString(
     Subset.LengthAllocated = Subset.LengthAllocated - Subset.LengthInChars;
     Subset.LengthInChars = 0;
 
+    //
+    //  Most lines are full and are not the final C style line, which can
+    //  be generated without checking each byte against the length.
+    //
+
+    if (BufferLength >= YORI_LIB_HEXDUMP_BYTES_PER_LINE &&
+        ((DumpFlags & YORI_LIB_HEX_FLAG_C_STYLE) == 0 || MoreFollowing) &&
+        (BytesPerWord == 1 || BytesPerWord == 2 || BytesPerWord == 4 || BytesPerWord == 8) &&
+        Subset.LengthAllocated >= YORI_LIB_HEX_FULL_LINE_MAX_CHARS) {
+
+        LineBuffer->LengthInChars = LineBuffer->LengthInChars + YoriLibHexFullLineToBuffer(Subset.StartOfString, Buffer, BytesPerWord, DumpFlags);
+        return;
+    }
+
     //
     //  Figure out how many hex bytes can be displayed on this line
     //
@@ -891,6 +1055,73 @@ YoriLibHexDump(
     return TRUE;
 }
 
+/**
+ Find the next line that differs between two buffers.  Large blocks are
+ compared first so identical regions are skipped quickly, then lines within
+ the first block that differs.
+
+ @param Buffer1 Pointer to the first buffer.
+
+ @param Buffer1Length The length of the first buffer, in bytes.
+
+ @param Buffer2 Pointer to the second buffer.
+
+ @param Buffer2Length The length of the second buffer, in bytes.
+
+ @param LineIndex The first line to check.
+
+ @return The index of the first line at or after LineIndex that differs.
+         Lines beyond the end of either buffer are considered different.
+         If the buffers are the same length and identical from LineIndex,
+         the number of lines in the buffers is returned.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibHexDiffFindDifferentLine(
+    __in LPCSTR Buffer1,
+    __in YORI_ALLOC_SIZE_T Buffer1Length,
+    __in LPCSTR Buffer2,
+    __in YORI_ALLOC_SIZE_T Buffer2Length,
+    __in YORI_ALLOC_SIZE_T LineIndex
+    )
+{
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T CommonLength;
+
+    CommonLength = Buffer1Length;
+    if (Buffer2Length < CommonLength) {
+        CommonLength = Buffer2Length;
+    }
+
+    Offset = LineIndex * YORI_LIB_HEXDUMP_BYTES_PER_LINE;
+
+    while (Offset + YORI_LIB_HEX_DIFF_COMPARE_BLOCK <= CommonLength &&
+           memcmp(&Buffer1[Offset], &Buffer2[Offset], YORI_LIB_HEX_DIFF_COMPARE_BLOCK) == 0) {
+
+        Offset = Offset + YORI_LIB_HEX_DIFF_COMPARE_BLOCK;
+    }
+
+    while (Offset + YORI_LIB_HEXDUMP_BYTES_PER_LINE <= CommonLength &&
+           memcmp(&Buffer1[Offset], &Buffer2[Offset], YORI_LIB_HEXDUMP_BYTES_PER_LINE) == 0) {
+
+        Offset = Offset + YORI_LIB_HEXDUMP_BYTES_PER_LINE;
+    }
+
+    //
+    //  A partial final line is only the same if both buffers end at the
+    //  same point.
+    //
+
+    if (Offset < CommonLength &&
+        Offset + YORI_LIB_HEXDUMP_BYTES_PER_LINE > CommonLength &&
+        Buffer1Length == Buffer2Length &&
+        memcmp(&Buffer1[Offset], &Buffer2[Offset], CommonLength - Offset) == 0) {
+
+        Offset = Offset + YORI_LIB_HEXDUMP_BYTES_PER_LINE;
+    }
+
+    return Offset / YORI_LIB_HEXDUMP_BYTES_PER_LINE;
+}
+
 /**
  Display two buffers side by side in hex format.
 
@@ -939,14 +1170,25 @@ YoriLibHexDiff(
     YORI_ALLOC_SIZE_T BufferLengths[2];
     YORI_STRING LineBuffer;
     YORI_STRING Subset;
+    YORI_ALLOC_SIZE_T CharsPerLine;
+    YORI_ALLOC_SIZE_T AllocSize;
+    HANDLE hOut;
 
     if (BytesPerWord != 1 && BytesPerWord != 2 && BytesPerWord != 4 && BytesPerWord != 8) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&LineBuffer, 32 * YORI_LIB_HEXDUMP_BYTES_PER_LINE + 64)) {
+    //
+    //  Lines are generated into a buffer that holds many of them, which is
+    //  written once it can't hold another.
+    //
+
+    CharsPerLine = 32 * YORI_LIB_HEXDUMP_BYTES_PER_LINE + 64;
+    AllocSize = YoriLibMaximumAllocationInRange(60 * 1024, 1024 * 1024);
+    if (!YoriLibAllocateString(&LineBuffer, AllocSize)) {
         return FALSE;
     }
+    hOut = GetStdHandle(STD_OUTPUT_HANDLE);
 
     Subset.StartOfString = LineBuffer.StartOfString;
     Subset.LengthInChars = 0;
@@ -967,6 +1209,14 @@ YoriLibHexDiff(
 
     for (LineIndex = 0; LineIndex < LineCount; LineIndex++) {
 
+        if (DumpFlags & YORI_LIB_HEX_FLAG_SKIP_IDENTICAL) {
+            LineIndex = YoriLibHexDiffFindDifferentLine(Buffer1, Buffer1Length, Buffer2, Buffer2Length, LineIndex);
+            if (LineIndex >= LineCount) {
+                break;
+            }
+            DisplayBufferOffset.QuadPart = StartOfBufferOffset + (LONGLONG)LineIndex * YORI_LIB_HEXDUMP_BYTES_PER_LINE;
+        }
+
         //
         //  If the caller requested to display the buffer offset for each
         //  line, display it
@@ -1137,11 +1387,18 @@ YoriLibHexDiff(
             Subset.StartOfString++;
             LineBuffer.LengthInChars++;
         }
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &LineBuffer);
-        LineBuffer.LengthInChars = 0;
-        Subset.StartOfString = LineBuffer.StartOfString;
-        Subset.LengthInChars = LineBuffer.LengthInChars;
-        Subset.LengthAllocated = LineBuffer.LengthAllocated;
+
+        if (LineBuffer.LengthAllocated - LineBuffer.LengthInChars <= CharsPerLine) {
+            YoriLibOutputString(hOut, 0, &LineBuffer);
+            LineBuffer.LengthInChars = 0;
+        }
+        Subset.StartOfString = &LineBuffer.StartOfString[LineBuffer.LengthInChars];
+        Subset.LengthInChars = 0;
+        Subset.LengthAllocated = LineBuffer.LengthAllocated - LineBuffer.LengthInChars;
+    }
+
+    if (LineBuffer.LengthInChars > 0) {
+        YoriLibOutputString(hOut, 0, &LineBuffer);
     }
 
     YoriLibFreeStringContents(&LineBuffer);
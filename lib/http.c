@@ -3,7 +3,7 @@
  *
  * Yori fallback HTTP support
  *
- * Copyright (c) 2023 Malcolm J. Smith
+ * Copyright (c) 2023-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -64,6 +64,37 @@ typedef struct _YORI_LIB_HTTP_HEADER_LINE {
 
 } YORI_LIB_HTTP_HEADER_LINE, *PYORI_LIB_HTTP_HEADER_LINE;
 
+/**
+ The maximum number of idle connections that each internet handle retains
+ for use by later requests.
+ */
+#define YORI_LIB_HTTP_MAX_IDLE_CONNECTIONS (4)
+
+/**
+ The maximum size of the headers in an HTTP response, in bytes.  This exists
+ to fail cleanly on malformed responses rather than buffering indefinitely.
+ */
+#define YORI_LIB_HTTP_MAX_HEADER_SIZE (64 * 1024)
+
+/**
+ A connection to a server which has completed a request and can be used for
+ a later request to the same server.
+ */
+typedef struct _YORI_LIB_HTTP_IDLE_CONNECTION {
+
+    /**
+     The host name that the connection refers to.  If this string has no
+     allocation, this entry is not in use.
+     */
+    YORI_STRING Host;
+
+    /**
+     The connected socket.
+     */
+    SOCKET Socket;
+
+} YORI_LIB_HTTP_IDLE_CONNECTION, *PYORI_LIB_HTTP_IDLE_CONNECTION;
+
 /**
  A nonopaque representation of an HINTERNET handle.
  */
@@ -84,6 +115,12 @@ typedef struct _YORI_LIB_INTERNET_HANDLE {
              agent, being the only value supported with YoriLibInternetOpen.
              */
             YORI_STRING UserAgent;
+
+            /**
+             Connections to servers which can be reused for subsequent
+             requests to the same server.
+             */
+            YORI_LIB_HTTP_IDLE_CONNECTION IdleConnections[YORI_LIB_HTTP_MAX_IDLE_CONNECTIONS];
         } Internet;
         struct {
 
@@ -280,6 +317,7 @@ YoriLibInternetCloseHandle(
     )
 {
     PYORI_LIB_INTERNET_HANDLE Handle;
+    DWORD Index;
 
     if (hInternet == NULL) {
         return FALSE;
@@ -296,6 +334,12 @@ YoriLibInternetCloseHandle(
     }
 
     if (Handle->HandleType == YoriLibInternetHandle) {
+        for (Index = 0; Index < YORI_LIB_HTTP_MAX_IDLE_CONNECTIONS; Index++) {
+            if (Handle->u.Internet.IdleConnections[Index].Host.StartOfString != NULL) {
+                DllWsock32.pclosesocket(Handle->u.Internet.IdleConnections[Index].Socket);
+                YoriLibFreeStringContents(&Handle->u.Internet.IdleConnections[Index].Host);
+            }
+        }
         YoriLibFreeStringContents(&Handle->u.Internet.UserAgent);
         DllWsock32.pWSACleanup();
     } else if (Handle->HandleType == YoriLibUrlHandle) {
@@ -547,9 +591,514 @@ YoriLibHttpProcessResponseHeaders(
     return TRUE;
 }
 
+/**
+ Connect a new socket to the specified host on the HTTP port.
+
+ @param Host The host name to connect to.
+
+ @return The connected socket, or INVALID_SOCKET on failure.
+ */
+SOCKET
+YoriLibHttpConnect(
+    __in PCYORI_STRING Host
+    )
+{
+    struct hostent * addr;
+    struct sockaddr_in sin;
+    UCHAR * AnsiBuffer;
+    SOCKET s;
+
+    AnsiBuffer = YoriLibMalloc(Host->LengthInChars + 1);
+    if (AnsiBuffer == NULL) {
+        return INVALID_SOCKET;
+    }
+
+    YoriLibSPrintfA(AnsiBuffer, "%y", Host);
+    addr = DllWsock32.pgethostbyname(AnsiBuffer);
+    if (addr == NULL || addr->h_addrtype != AF_INET || addr->h_length != sizeof(DWORD)) {
+        YoriLibFree(AnsiBuffer);
+        return INVALID_SOCKET;
+    }
+
+    YoriLibFree(AnsiBuffer);
+
+    s = DllWsock32.psocket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+
+    ZeroMemory(&sin, sizeof(sin));
+
+    // MSFIX Probably should parse the port from the host name
+    sin.sin_family = AF_INET;
+    sin.sin_port = 0x5000; // 80, in hex, in big endian
+    memcpy(&sin.sin_addr.s_addr, addr->h_addr, addr->h_length);
+
+    if (DllWsock32.pconnect(s, &sin, sizeof(sin)) != 0) {
+        DllWsock32.pclosesocket(s);
+        return INVALID_SOCKET;
+    }
+
+    return s;
+}
+
+/**
+ Find an idle connection to a host which can be used for a new request, and
+ remove it from the set of idle connections.
+
+ @param InternetHandle Pointer to the internet handle owning idle connections.
+
+ @param Host The host name to find a connection for.
+
+ @return A connected socket, or INVALID_SOCKET if no idle connection to the
+         host exists.  Note the server may have closed the connection since
+         it was last used.
+ */
+SOCKET
+YoriLibHttpTakeIdleConnection(
+    __in PYORI_LIB_INTERNET_HANDLE InternetHandle,
+    __in PCYORI_STRING Host
+    )
+{
+    PYORI_LIB_HTTP_IDLE_CONNECTION Connection;
+    DWORD Index;
+    SOCKET s;
+
+    for (Index = 0; Index < YORI_LIB_HTTP_MAX_IDLE_CONNECTIONS; Index++) {
+        Connection = &InternetHandle->u.Internet.IdleConnections[Index];
+        if (Connection->Host.StartOfString != NULL &&
+            YoriLibCompareStringIns(&Connection->Host, Host) == 0) {
+
+            s = Connection->Socket;
+            YoriLibFreeStringContents(&Connection->Host);
+            return s;
+        }
+    }
+
+    return INVALID_SOCKET;
+}
+
+/**
+ Retain a connection which has completed a request so it can be used for a
+ later request to the same host.  If no space is available to retain it,
+ the connection is closed.
+
+ @param InternetHandle Pointer to the internet handle owning idle connections.
+
+ @param Host The host name that the connection refers to.
+
+ @param s The connected socket.  The caller should not use this socket after
+        this call.
+ */
+VOID
+YoriLibHttpReturnIdleConnection(
+    __in PYORI_LIB_INTERNET_HANDLE InternetHandle,
+    __in PCYORI_STRING Host,
+    __in SOCKET s
+    )
+{
+    PYORI_LIB_HTTP_IDLE_CONNECTION Connection;
+    DWORD Index;
+
+    for (Index = 0; Index < YORI_LIB_HTTP_MAX_IDLE_CONNECTIONS; Index++) {
+        Connection = &InternetHandle->u.Internet.IdleConnections[Index];
+        if (Connection->Host.StartOfString == NULL) {
+            if (!YoriLibAllocateString(&Connection->Host, Host->LengthInChars + 1)) {
+                break;
+            }
+            memcpy(Connection->Host.StartOfString, Host->StartOfString, Host->LengthInChars * sizeof(TCHAR));
+            Connection->Host.LengthInChars = Host->LengthInChars;
+            Connection->Host.StartOfString[Host->LengthInChars] = '\0';
+            Connection->Socket = s;
+            return;
+        }
+    }
+
+    DllWsock32.pclosesocket(s);
+}
+
+/**
+ Receive more data from a connection, appending it to the response buffer.
+
+ @param UrlRequest Pointer to the request whose buffer should be extended.
+
+ @param s The connected socket.
+
+ @return TRUE to indicate more data was received, FALSE if the connection was
+         closed or failed.
+ */
+BOOLEAN
+YoriLibHttpReceive(
+    __in PYORI_LIB_INTERNET_HANDLE UrlRequest,
+    __in SOCKET s
+    )
+{
+    UCHAR * AnsiBuffer;
+    YORI_ALLOC_SIZE_T BytesRemaining;
+    INT Length;
+
+    AnsiBuffer = YoriLibByteBufferGetPointerToEnd(&UrlRequest->u.Url.ByteBuffer, 256 * 1024, &BytesRemaining);
+    if (AnsiBuffer == NULL) {
+        return FALSE;
+    }
+
+    Length = DllWsock32.precv(s, AnsiBuffer, (INT)BytesRemaining, 0);
+    if (Length <= 0) {
+        return FALSE;
+    }
+
+    YoriLibByteBufferAddToPopulatedLength(&UrlRequest->u.Url.ByteBuffer, Length);
+    return TRUE;
+}
+
+/**
+ Find the end of a line in the response buffer, receiving more data until
+ the line is complete.
+
+ @param UrlRequest Pointer to the request containing the response.
+
+ @param s The connected socket.
+
+ @param Offset The offset within the response buffer of the start of the
+        line.
+
+ @param LineEnd On successful completion, updated to the offset of the
+        newline character terminating the line.
+
+ @return TRUE to indicate a complete line was found, FALSE if the connection
+         was closed or failed first.
+ */
+__success(return)
+BOOLEAN
+YoriLibHttpReceiveLine(
+    __in PYORI_LIB_INTERNET_HANDLE UrlRequest,
+    __in SOCKET s,
+    __in YORI_MAX_UNSIGNED_T Offset,
+    __out PYORI_MAX_UNSIGNED_T LineEnd
+    )
+{
+    YORI_MAX_UNSIGNED_T Index;
+
+    Index = Offset;
+    while (TRUE) {
+        for (; Index < UrlRequest->u.Url.ByteBuffer.BytesPopulated; Index++) {
+            if (UrlRequest->u.Url.ByteBuffer.Buffer[Index] == '\n') {
+                *LineEnd = Index;
+                return TRUE;
+            }
+        }
+
+        if (!YoriLibHttpReceive(UrlRequest, s)) {
+            return FALSE;
+        }
+    }
+}
+
+/**
+ Receive a body using chunked transfer encoding, and remove the chunk framing
+ so the body is contiguous from the start of the payload.
+
+ @param UrlRequest Pointer to the request whose headers have been processed.
+
+ @param s The connected socket.
+
+ @param ExtraData On successful completion, set to TRUE if data was received
+        beyond the end of the body.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibHttpReceiveChunkedBody(
+    __in PYORI_LIB_INTERNET_HANDLE UrlRequest,
+    __in SOCKET s,
+    __out PBOOLEAN ExtraData
+    )
+{
+    YORI_MAX_UNSIGNED_T ReadOffset;
+    YORI_MAX_UNSIGNED_T WriteOffset;
+    YORI_MAX_UNSIGNED_T LineEnd;
+    YORI_MAX_UNSIGNED_T ChunkSize;
+    YORI_MAX_UNSIGNED_T Index;
+    UCHAR Char;
+    DWORD Digits;
+
+    ReadOffset = UrlRequest->u.Url.HttpBodyOffset;
+    WriteOffset = ReadOffset;
+
+    while (TRUE) {
+
+        //
+        //  Each chunk starts with a line containing its size in hex,
+        //  optionally followed by extensions which are ignored.
+        //
+
+        if (!YoriLibHttpReceiveLine(UrlRequest, s, ReadOffset, &LineEnd)) {
+            return FALSE;
+        }
+
+        ChunkSize = 0;
+        Digits = 0;
+        for (Index = ReadOffset; Index < LineEnd; Index++) {
+            Char = UrlRequest->u.Url.ByteBuffer.Buffer[Index];
+            if (Char >= '0' && Char <= '9') {
+                ChunkSize = ChunkSize * 16 + Char - '0';
+            } else if (Char >= 'a' && Char <= 'f') {
+                ChunkSize = ChunkSize * 16 + Char - 'a' + 10;
+            } else if (Char >= 'A' && Char <= 'F') {
+                ChunkSize = ChunkSize * 16 + Char - 'A' + 10;
+            } else {
+                break;
+            }
+            Digits++;
+            if (ChunkSize > YORI_MAX_ALLOC_SIZE) {
+                return FALSE;
+            }
+        }
+
+        if (Digits == 0) {
+            return FALSE;
+        }
+
+        ReadOffset = LineEnd + 1;
+
+        //
+        //  A zero length chunk ends the body.  It can be followed by trailer
+        //  headers, which are discarded, and ends with an empty line.
+        //
+
+        if (ChunkSize == 0) {
+            while (TRUE) {
+                if (!YoriLibHttpReceiveLine(UrlRequest, s, ReadOffset, &LineEnd)) {
+                    return FALSE;
+                }
+                Index = ReadOffset;
+                ReadOffset = LineEnd + 1;
+                if (LineEnd == Index ||
+                    (LineEnd == Index + 1 && UrlRequest->u.Url.ByteBuffer.Buffer[Index] == '\r')) {
+                    break;
+                }
+            }
+            break;
+        }
+
+        while (UrlRequest->u.Url.ByteBuffer.BytesPopulated < ReadOffset + ChunkSize) {
+            if (!YoriLibHttpReceive(UrlRequest, s)) {
+                return FALSE;
+            }
+        }
+
+        //
+        //  Move the chunk data over the framing of this and any previous
+        //  chunk.  The write offset never exceeds the read offset.
+        //
+
+        memmove(&UrlRequest->u.Url.ByteBuffer.Buffer[WriteOffset],
+                &UrlRequest->u.Url.ByteBuffer.Buffer[ReadOffset],
+                (YORI_ALLOC_SIZE_T)ChunkSize);
+
+        WriteOffset = WriteOffset + ChunkSize;
+        ReadOffset = ReadOffset + ChunkSize;
+
+        //
+        //  Swallow the line break that follows the chunk data.
+        //
+
+        if (!YoriLibHttpReceiveLine(UrlRequest, s, ReadOffset, &LineEnd)) {
+            return FALSE;
+        }
+        ReadOffset = LineEnd + 1;
+    }
+
+    *ExtraData = FALSE;
+    if (UrlRequest->u.Url.ByteBuffer.BytesPopulated > ReadOffset) {
+        *ExtraData = TRUE;
+    }
+
+    UrlRequest->u.Url.ByteBuffer.BytesPopulated = WriteOffset;
+    return TRUE;
+}
+
+/**
+ Receive an HTTP response from a connection, parse its headers, and receive
+ the body according to the framing the server indicated.
+
+ @param UrlRequest Pointer to the request that was sent.
+
+ @param s The connected socket.
+
+ @param RedirectUrl On successful completion, updated to contain a new URL if
+        the request should be redirected.
+
+ @param KeepAlive On successful completion, set to TRUE if the connection can
+        be used for a subsequent request.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibHttpReceiveResponse(
+    __in PYORI_LIB_INTERNET_HANDLE UrlRequest,
+    __in SOCKET s,
+    __inout PYORI_STRING RedirectUrl,
+    __out PBOOLEAN KeepAlive
+    )
+{
+    PYORI_LIB_HTTP_HEADER_LINE ResponseLine;
+    YORI_MAX_UNSIGNED_T SearchOffset;
+    YORI_MAX_UNSIGNED_T BodyEnd;
+    YORI_MAX_SIGNED_T llTemp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    PUCHAR Buffer;
+    BOOLEAN HeadersComplete;
+    BOOLEAN ExtraData;
+    BOOLEAN CanReuse;
+    DWORD StatusCode;
+
+    //
+    //  Receive until the empty line that ends the headers.  Only rescan the
+    //  tail that couldn't be resolved on the previous pass.
+    //
+
+    SearchOffset = 0;
+    HeadersComplete = FALSE;
+    while (!HeadersComplete) {
+        if (!YoriLibHttpReceive(UrlRequest, s)) {
+            return FALSE;
+        }
+
+        Buffer = UrlRequest->u.Url.ByteBuffer.Buffer;
+        for (; SearchOffset < UrlRequest->u.Url.ByteBuffer.BytesPopulated; SearchOffset++) {
+            if (Buffer[SearchOffset] != '\n') {
+                continue;
+            }
+            if (SearchOffset + 1 >= UrlRequest->u.Url.ByteBuffer.BytesPopulated) {
+                break;
+            }
+            if (Buffer[SearchOffset + 1] == '\n') {
+                HeadersComplete = TRUE;
+                break;
+            }
+            if (Buffer[SearchOffset + 1] == '\r') {
+                if (SearchOffset + 2 >= UrlRequest->u.Url.ByteBuffer.BytesPopulated) {
+                    break;
+                }
+                if (Buffer[SearchOffset + 2] == '\n') {
+                    HeadersComplete = TRUE;
+                    break;
+                }
+            }
+        }
+
+        if (!HeadersComplete && SearchOffset > YORI_LIB_HTTP_MAX_HEADER_SIZE) {
+            return FALSE;
+        }
+    }
+
+    if (!YoriLibHttpProcessResponseHeaders(UrlRequest, RedirectUrl)) {
+        return FALSE;
+    }
+
+    //
+    //  HTTP/1.1 connections persist unless the server says otherwise;
+    //  HTTP/1.0 connections only persist if the server says so.
+    //
+
+    CanReuse = FALSE;
+    if (UrlRequest->u.Url.HttpMinorVersion >= 1) {
+        CanReuse = TRUE;
+    }
+
+    ResponseLine = YoriLibHttpFindResponseHeader(UrlRequest, _T("Connection"));
+    if (ResponseLine != NULL) {
+        if (YoriLibCompareStringLitIns(&ResponseLine->Value, _T("close")) == 0) {
+            CanReuse = FALSE;
+        } else if (YoriLibCompareStringLitIns(&ResponseLine->Value, _T("keep-alive")) == 0) {
+            CanReuse = TRUE;
+        }
+    }
+
+    ExtraData = FALSE;
+    StatusCode = UrlRequest->u.Url.HttpStatusCode;
+
+    if ((StatusCode >= 100 && StatusCode < 200) || StatusCode == 204 || StatusCode == 304) {
+
+        //
+        //  These responses never have a body.
+        //
+
+        BodyEnd = UrlRequest->u.Url.HttpBodyOffset;
+        if (UrlRequest->u.Url.ByteBuffer.BytesPopulated > BodyEnd) {
+            ExtraData = TRUE;
+            UrlRequest->u.Url.ByteBuffer.BytesPopulated = BodyEnd;
+        }
+    } else {
+        ResponseLine = YoriLibHttpFindResponseHeader(UrlRequest, _T("Transfer-Encoding"));
+        if (ResponseLine != NULL &&
+            ResponseLine->Value.LengthInChars >= sizeof("chunked") - 1) {
+
+            YORI_STRING Encoding;
+            YoriLibInitEmptyString(&Encoding);
+            Encoding.StartOfString = &ResponseLine->Value.StartOfString[ResponseLine->Value.LengthInChars - sizeof("chunked") + 1];
+            Encoding.LengthInChars = sizeof("chunked") - 1;
+            if (YoriLibCompareStringLitIns(&Encoding, _T("chunked")) != 0) {
+                ResponseLine = NULL;
+            }
+        } else {
+            ResponseLine = NULL;
+        }
+
+        if (ResponseLine != NULL) {
+            if (!YoriLibHttpReceiveChunkedBody(UrlRequest, s, &ExtraData)) {
+                return FALSE;
+            }
+        } else {
+            ResponseLine = YoriLibHttpFindResponseHeader(UrlRequest, _T("Content-Length"));
+            if (ResponseLine != NULL &&
+                YoriLibStringToNumber(&ResponseLine->Value, FALSE, &llTemp, &CharsConsumed) &&
+                CharsConsumed > 0 &&
+                llTemp >= 0) {
+
+                BodyEnd = UrlRequest->u.Url.HttpBodyOffset + (YORI_MAX_UNSIGNED_T)llTemp;
+                while (UrlRequest->u.Url.ByteBuffer.BytesPopulated < BodyEnd) {
+                    if (!YoriLibHttpReceive(UrlRequest, s)) {
+                        return FALSE;
+                    }
+                }
+                if (UrlRequest->u.Url.ByteBuffer.BytesPopulated > BodyEnd) {
+                    ExtraData = TRUE;
+                    UrlRequest->u.Url.ByteBuffer.BytesPopulated = BodyEnd;
+                }
+            } else {
+
+                //
+                //  With no framing, the body continues until the server
+                //  closes the connection, so it can't be reused.
+                //
+
+                while (YoriLibHttpReceive(UrlRequest, s));
+                CanReuse = FALSE;
+            }
+        }
+    }
+
+    //
+    //  Only one request is issued at a time, so data beyond the response
+    //  means the connection is not in a known state.
+    //
+
+    if (ExtraData) {
+        CanReuse = FALSE;
+    }
+
+    *KeepAlive = CanReuse;
+    return TRUE;
+}
+
 /**
  Connect to a specified URL, download contents, parse headers, and redirect as
- necessary.
+ necessary.  Connections are reused across requests to the same host where
+ the server allows it.
 
  @param UrlRequest Pointer to a URL handle containing a URL to connect to.
 
@@ -565,22 +1114,22 @@ YoriLibHttpProcessUrlRequest(
     __inout PYORI_STRING RedirectUrl
     )
 {
+    PYORI_LIB_INTERNET_HANDLE InternetHandle;
     YORI_STRING HostSubset;
     YORI_STRING Request;
+    YORI_STRING HostHeader;
+    YORI_STRING HostLiteral;
+    YORI_ALLOC_SIZE_T HostOffset;
     LPCTSTR EndOfHost;
-    struct hostent * addr;
-    struct sockaddr_in sin;
+    LPCTSTR UserHeaderSeperator;
     UCHAR * AnsiBuffer;
     SOCKET s;
-    DWORD Length;
-    DWORD TotalLength;
-    YORI_ALLOC_SIZE_T BytesRemaining;
-
-    //
-    //  MSFIX Implement this
-    //
+    BOOLEAN Reused;
+    BOOLEAN KeepAlive;
+    DWORD Attempt;
 
     YoriLibInitEmptyString(RedirectUrl);
+    InternetHandle = UrlRequest->u.Url.InternetHandle;
 
     //
     //  Currently this code only speaks http.  Note there is no TLS support
@@ -601,91 +1150,109 @@ YoriLibHttpProcessUrlRequest(
         return FALSE;
     }
 
-    YoriLibInitEmptyString(&Request);
-    YoriLibYPrintf(&Request,
-                   _T("GET %s HTTP/1.0\r\n%y\r\nUser-Agent: %y(YoriWinInet %i.%02i)\r\n\r\n"),
-                   EndOfHost,
-                   &UrlRequest->u.Url.UserRequestHeaders,
-                   &UrlRequest->u.Url.InternetHandle->u.Internet.UserAgent,
-                   YORI_VER_MAJOR, YORI_VER_MINOR);
-
-    if (Request.StartOfString == NULL) {
-        return FALSE;
-    }
+    //
+    //  HTTP/1.1 requires a Host header.  Callers may have supplied one
+    //  already, in which case don't send a second.
+    //
 
-    AnsiBuffer = YoriLibMalloc(HostSubset.LengthInChars + 1);
-    if (AnsiBuffer == NULL) {
-        YoriLibFreeStringContents(&Request);
-        return FALSE;
-    }
+    YoriLibInitEmptyString(&HostHeader);
+    YoriLibConstantString(&HostLiteral, _T("Host:"));
+    if (YoriLibFindFirstMatchSubstrIns(&UrlRequest->u.Url.UserRequestHeaders, 1, &HostLiteral, &HostOffset) == NULL ||
+        (HostOffset > 0 && UrlRequest->u.Url.UserRequestHeaders.StartOfString[HostOffset - 1] != '\n')) {
 
-    YoriLibSPrintfA(AnsiBuffer, "%y", &HostSubset);
-    addr = DllWsock32.pgethostbyname(AnsiBuffer);
-    if (addr == NULL || addr->h_addrtype != AF_INET || addr->h_length != sizeof(DWORD)) {
-        YoriLibFree(AnsiBuffer);
-        YoriLibFreeStringContents(&Request);
-        return FALSE;
+        YoriLibYPrintf(&HostHeader, _T("Host: %y\r\n"), &HostSubset);
+        if (HostHeader.StartOfString == NULL) {
+            return FALSE;
+        }
     }
 
-    YoriLibFree(AnsiBuffer);
-
-    s = DllWsock32.psocket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (s == INVALID_SOCKET) {
-        YoriLibFreeStringContents(&Request);
-        return FALSE;
+    UserHeaderSeperator = _T("");
+    if (UrlRequest->u.Url.UserRequestHeaders.LengthInChars > 0) {
+        UserHeaderSeperator = _T("\r\n");
     }
 
-    ZeroMemory(&sin, sizeof(sin));
+    YoriLibInitEmptyString(&Request);
+    YoriLibYPrintf(&Request,
+                   _T("GET %s HTTP/1.1\r\n%yConnection: keep-alive\r\nUser-Agent: %y(YoriWinInet %i.%02i)\r\n%y%s\r\n"),
+                   EndOfHost,
+                   &HostHeader,
+                   &InternetHandle->u.Internet.UserAgent,
+                   YORI_VER_MAJOR, YORI_VER_MINOR,
+                   &UrlRequest->u.Url.UserRequestHeaders,
+                   UserHeaderSeperator);
 
-    // MSFIX Probably should parse the port from the host name
-    sin.sin_family = AF_INET;
-    sin.sin_port = 0x5000; // 80, in hex, in big endian
-    memcpy(&sin.sin_addr.s_addr, addr->h_addr, addr->h_length);
+    YoriLibFreeStringContents(&HostHeader);
 
-    if (DllWsock32.pconnect(s, &sin, sizeof(sin)) != 0) {
-        YoriLibFreeStringContents(&Request);
-        DllWsock32.pclosesocket(s);
+    if (Request.StartOfString == NULL) {
         return FALSE;
     }
 
     AnsiBuffer = YoriLibMalloc(Request.LengthInChars + 1);
     if (AnsiBuffer == NULL) {
         YoriLibFreeStringContents(&Request);
-        DllWsock32.pclosesocket(s);
         return FALSE;
     }
 
     YoriLibSPrintfA(AnsiBuffer, "%y", &Request);
-    if (DllWsock32.psend(s, AnsiBuffer, Request.LengthInChars, 0) != (int)Request.LengthInChars) {
-        YoriLibFree(AnsiBuffer);
-        YoriLibFreeStringContents(&Request);
-        DllWsock32.pclosesocket(s);
-        return FALSE;
-    }
 
-    YoriLibFreeStringContents(&Request);
-    YoriLibFree(AnsiBuffer);
+    //
+    //  Prefer an idle connection to the same host.  The server may have
+    //  closed it while it was idle, which is only discovered by using it,
+    //  so if a reused connection fails before returning anything, retry
+    //  once on a new connection.
+    //
 
-    YoriLibByteBufferReset(&UrlRequest->u.Url.ByteBuffer);
-    TotalLength = 0;
-    while(TRUE) {
-        AnsiBuffer = YoriLibByteBufferGetPointerToEnd(&UrlRequest->u.Url.ByteBuffer, 256 * 1024, &BytesRemaining);
-        Length = DllWsock32.precv(s, AnsiBuffer, (DWORD)BytesRemaining, 0);
-        if (Length == 0) {
+    for (Attempt = 0; Attempt < 2; Attempt++) {
+
+        Reused = FALSE;
+        s = INVALID_SOCKET;
+        if (Attempt == 0) {
+            s = YoriLibHttpTakeIdleConnection(InternetHandle, &HostSubset);
+        }
+        if (s != INVALID_SOCKET) {
+            Reused = TRUE;
+        } else {
+            s = YoriLibHttpConnect(&HostSubset);
+            if (s == INVALID_SOCKET) {
+                break;
+            }
+        }
+
+        YoriLibHttpResetUrlRequest(UrlRequest);
+
+        if (DllWsock32.psend(s, AnsiBuffer, Request.LengthInChars, 0) != (int)Request.LengthInChars) {
+            DllWsock32.pclosesocket(s);
+            if (Reused) {
+                continue;
+            }
             break;
         }
-        YoriLibByteBufferAddToPopulatedLength(&UrlRequest->u.Url.ByteBuffer, Length);
-    }
 
-    DllWsock32.pclosesocket(s);
+        if (!YoriLibHttpReceiveResponse(UrlRequest, s, RedirectUrl, &KeepAlive)) {
+            DllWsock32.pclosesocket(s);
+            if (Reused && UrlRequest->u.Url.ByteBuffer.BytesPopulated == 0) {
+                continue;
+            }
+            break;
+        }
 
-    if (!YoriLibHttpProcessResponseHeaders(UrlRequest, RedirectUrl)) {
-        return FALSE;
-    }
+        if (KeepAlive) {
+            YoriLibHttpReturnIdleConnection(InternetHandle, &HostSubset, s);
+        } else {
+            DllWsock32.pclosesocket(s);
+        }
+
+        YoriLibFreeStringContents(&Request);
+        YoriLibFree(AnsiBuffer);
 
-    // YoriLibHttpOutputUrlResponse(UrlRequest);
+        // YoriLibHttpOutputUrlResponse(UrlRequest);
 
-    return TRUE;
+        return TRUE;
+    }
+
+    YoriLibFreeStringContents(&Request);
+    YoriLibFree(AnsiBuffer);
+    return FALSE;
 }
 
 /**
@@ -936,10 +1503,13 @@ YoriLibInternetOpenUrl(
     while (TRUE) {
         YoriLibHttpResetUrlRequest(UrlHandle);
         YoriLibInitEmptyString(&LocationHeader);
+        YoriLibTraceBegin(YORI_LIB_TRACE_HTTP, _T("Http"), &UrlHandle->u.Url.Url, 0);
         if (!YoriLibHttpProcessUrlRequest(UrlHandle, &LocationHeader)) {
+            YoriLibTraceEnd(YORI_LIB_TRACE_HTTP, _T("Http"), &UrlHandle->u.Url.Url, 0);
             YoriLibInternetCloseHandle(UrlHandle);
             return NULL;
         }
+        YoriLibTraceEnd(YORI_LIB_TRACE_HTTP, _T("Http"), &UrlHandle->u.Url.Url, UrlHandle->u.Url.ByteBuffer.BytesPopulated);
 
         if (LocationHeader.StartOfString == NULL) {
             break;
@@ -3,7 +3,7 @@
  *
  * Yori text encoding routines
  *
- * Copyright (c) 2017 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -135,6 +135,334 @@ YoriLibSetMultibyteInputEncoding(
     YoriLibActiveInputEncodingInitialized = TRUE;
 }
 
+/**
+ The number of code units that are checked together when converting runs
+ of ASCII text.
+ */
+#define YORI_LIB_ICONV_ASCII_BLOCK (8)
+
+/**
+ Returns nonzero if a block of code units are all ASCII.  The units are
+ combined before a single comparison, which avoids a branch per unit and
+ allows the compiler to use wide registers, without requiring the buffer
+ to be aligned.  Mask specifies the bits that must be clear in an ASCII
+ code unit.
+ */
+#define YORI_LIB_ICONV_IS_ASCII_BLOCK(Src, Mask) \
+    ((((Src)[0] | (Src)[1] | (Src)[2] | (Src)[3] | \
+       (Src)[4] | (Src)[5] | (Src)[6] | (Src)[7]) & (Mask)) == 0)
+
+/**
+ Copy a block of ASCII code units, changing their width to the specified
+ type.
+ */
+#define YORI_LIB_ICONV_COPY_BLOCK(Dest, Src, Type) \
+    (Dest)[0] = (Type)(Src)[0]; \
+    (Dest)[1] = (Type)(Src)[1]; \
+    (Dest)[2] = (Type)(Src)[2]; \
+    (Dest)[3] = (Type)(Src)[3]; \
+    (Dest)[4] = (Type)(Src)[4]; \
+    (Dest)[5] = (Type)(Src)[5]; \
+    (Dest)[6] = (Type)(Src)[6]; \
+    (Dest)[7] = (Type)(Src)[7];
+
+/**
+ Convert a UTF16 string into UTF8, or count the number of bytes needed to
+ do so.  This is used in preference to WideCharToMultiByte since most text
+ is ASCII and can be converted without a call into the system.  Unpaired
+ surrogates are converted into the replacement character, consistent with
+ current versions of Windows.
+
+ @param InputStringBuffer Pointer to a UTF16 string.
+
+ @param InputBufferLength The size of InputStringBuffer, in characters.
+
+ @param OutputStringBuffer Optionally points to a buffer to be populated
+        with the UTF8 form.  If NULL, the number of bytes needed is
+        returned without generating output.
+
+ @param OutputBufferLength The length of the output buffer, in bytes.
+
+ @return The number of bytes generated, or which would be generated if
+         OutputStringBuffer is NULL.  If the output buffer is too small,
+         output stops at the last complete character which fits.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibUtf8FromUtf16(
+    __in_ecount(InputBufferLength) LPCTSTR InputStringBuffer,
+    __in YORI_ALLOC_SIZE_T InputBufferLength,
+    __out_ecount_opt(OutputBufferLength) LPSTR OutputStringBuffer,
+    __in YORI_ALLOC_SIZE_T OutputBufferLength
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T OutIndex;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    YORI_ALLOC_SIZE_T BytesNeeded;
+    DWORD Char;
+
+    Index = 0;
+    OutIndex = 0;
+
+    while (Index < InputBufferLength) {
+
+        //
+        //  Process any run of ASCII characters, which are the same in both
+        //  encodings.
+        //
+
+        if (OutputStringBuffer == NULL) {
+            while (Index + YORI_LIB_ICONV_ASCII_BLOCK <= InputBufferLength &&
+                   YORI_LIB_ICONV_IS_ASCII_BLOCK(&InputStringBuffer[Index], 0xFF80)) {
+
+                Index += YORI_LIB_ICONV_ASCII_BLOCK;
+                OutIndex += YORI_LIB_ICONV_ASCII_BLOCK;
+            }
+            while (Index < InputBufferLength && InputStringBuffer[Index] < 0x80) {
+                Index++;
+                OutIndex++;
+            }
+        } else {
+            while (Index + YORI_LIB_ICONV_ASCII_BLOCK <= InputBufferLength &&
+                   OutIndex + YORI_LIB_ICONV_ASCII_BLOCK <= OutputBufferLength &&
+                   YORI_LIB_ICONV_IS_ASCII_BLOCK(&InputStringBuffer[Index], 0xFF80)) {
+
+                YORI_LIB_ICONV_COPY_BLOCK(&OutputStringBuffer[OutIndex], &InputStringBuffer[Index], CHAR);
+                Index += YORI_LIB_ICONV_ASCII_BLOCK;
+                OutIndex += YORI_LIB_ICONV_ASCII_BLOCK;
+            }
+            while (Index < InputBufferLength &&
+                   OutIndex < OutputBufferLength &&
+                   InputStringBuffer[Index] < 0x80) {
+
+                OutputStringBuffer[OutIndex] = (CHAR)InputStringBuffer[Index];
+                Index++;
+                OutIndex++;
+            }
+        }
+
+        if (Index >= InputBufferLength) {
+            break;
+        }
+
+        Char = InputStringBuffer[Index];
+        if (Char < 0x80) {
+            break;
+        }
+
+        CharsConsumed = 1;
+        if (Char < 0x800) {
+            BytesNeeded = 2;
+        } else if (Char >= 0xD800 && Char <= 0xDFFF) {
+            if (Char <= 0xDBFF &&
+                Index + 1 < InputBufferLength &&
+                InputStringBuffer[Index + 1] >= 0xDC00 &&
+                InputStringBuffer[Index + 1] <= 0xDFFF) {
+
+                Char = 0x10000 + ((Char - 0xD800) << 10) + (InputStringBuffer[Index + 1] - 0xDC00);
+                CharsConsumed = 2;
+                BytesNeeded = 4;
+            } else {
+                Char = 0xFFFD;
+                BytesNeeded = 3;
+            }
+        } else {
+            BytesNeeded = 3;
+        }
+
+        if (OutputStringBuffer != NULL) {
+            if (OutIndex + BytesNeeded > OutputBufferLength) {
+                break;
+            }
+
+            if (BytesNeeded == 2) {
+                OutputStringBuffer[OutIndex] = (CHAR)(0xC0 | (Char >> 6));
+                OutputStringBuffer[OutIndex + 1] = (CHAR)(0x80 | (Char & 0x3F));
+            } else if (BytesNeeded == 3) {
+                OutputStringBuffer[OutIndex] = (CHAR)(0xE0 | (Char >> 12));
+                OutputStringBuffer[OutIndex + 1] = (CHAR)(0x80 | ((Char >> 6) & 0x3F));
+                OutputStringBuffer[OutIndex + 2] = (CHAR)(0x80 | (Char & 0x3F));
+            } else {
+                OutputStringBuffer[OutIndex] = (CHAR)(0xF0 | (Char >> 18));
+                OutputStringBuffer[OutIndex + 1] = (CHAR)(0x80 | ((Char >> 12) & 0x3F));
+                OutputStringBuffer[OutIndex + 2] = (CHAR)(0x80 | ((Char >> 6) & 0x3F));
+                OutputStringBuffer[OutIndex + 3] = (CHAR)(0x80 | (Char & 0x3F));
+            }
+        }
+
+        Index = Index + CharsConsumed;
+        OutIndex = OutIndex + BytesNeeded;
+    }
+
+    return OutIndex;
+}
+
+/**
+ Convert a UTF8 string into UTF16, or count the number of characters needed
+ to do so.  This is used in preference to MultiByteToWideChar since most
+ text is ASCII and can be converted without a call into the system.  Each
+ invalid or truncated sequence is converted into a single replacement
+ character, consistent with current versions of Windows.
+
+ @param InputStringBuffer Pointer to a UTF8 string.
+
+ @param InputBufferLength The size of InputStringBuffer, in bytes.
+
+ @param OutputStringBuffer Optionally points to a buffer to be populated
+        with the UTF16 form.  If NULL, the number of characters needed is
+        returned without generating output.
+
+ @param OutputBufferLength The length of the output buffer, in characters.
+
+ @return The number of characters generated, or which would be generated if
+         OutputStringBuffer is NULL.  If the output buffer is too small,
+         output stops at the last complete character which fits.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibUtf16FromUtf8(
+    __in_ecount(InputBufferLength) LPCSTR InputStringBuffer,
+    __in YORI_ALLOC_SIZE_T InputBufferLength,
+    __out_ecount_opt(OutputBufferLength) LPTSTR OutputStringBuffer,
+    __in YORI_ALLOC_SIZE_T OutputBufferLength
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T OutIndex;
+    YORI_ALLOC_SIZE_T BytesConsumed;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+    DWORD BytesRemaining;
+    DWORD Char;
+    UCHAR Byte;
+    UCHAR LowestNext;
+    UCHAR HighestNext;
+
+    Index = 0;
+    OutIndex = 0;
+
+    while (Index < InputBufferLength) {
+
+        //
+        //  Process any run of ASCII characters, which are the same in both
+        //  encodings.
+        //
+
+        if (OutputStringBuffer == NULL) {
+            while (Index + YORI_LIB_ICONV_ASCII_BLOCK <= InputBufferLength &&
+                   YORI_LIB_ICONV_IS_ASCII_BLOCK((PUCHAR)&InputStringBuffer[Index], 0x80)) {
+
+                Index += YORI_LIB_ICONV_ASCII_BLOCK;
+                OutIndex += YORI_LIB_ICONV_ASCII_BLOCK;
+            }
+            while (Index < InputBufferLength && (UCHAR)InputStringBuffer[Index] < 0x80) {
+                Index++;
+                OutIndex++;
+            }
+        } else {
+            while (Index + YORI_LIB_ICONV_ASCII_BLOCK <= InputBufferLength &&
+                   OutIndex + YORI_LIB_ICONV_ASCII_BLOCK <= OutputBufferLength &&
+                   YORI_LIB_ICONV_IS_ASCII_BLOCK((PUCHAR)&InputStringBuffer[Index], 0x80)) {
+
+                YORI_LIB_ICONV_COPY_BLOCK(&OutputStringBuffer[OutIndex], (PUCHAR)&InputStringBuffer[Index], TCHAR);
+                Index += YORI_LIB_ICONV_ASCII_BLOCK;
+                OutIndex += YORI_LIB_ICONV_ASCII_BLOCK;
+            }
+            while (Index < InputBufferLength &&
+                   OutIndex < OutputBufferLength &&
+                   (UCHAR)InputStringBuffer[Index] < 0x80) {
+
+                OutputStringBuffer[OutIndex] = InputStringBuffer[Index];
+                Index++;
+                OutIndex++;
+            }
+        }
+
+        if (Index >= InputBufferLength) {
+            break;
+        }
+
+        Byte = (UCHAR)InputStringBuffer[Index];
+        if (Byte < 0x80) {
+            break;
+        }
+
+        //
+        //  Determine the length of the sequence from the lead byte, and the
+        //  valid range of the following byte.  Restricting the second byte
+        //  excludes overlong forms, surrogates and values above 0x10FFFF.
+        //
+
+        LowestNext = 0x80;
+        HighestNext = 0xBF;
+        if (Byte >= 0xC2 && Byte <= 0xDF) {
+            BytesRemaining = 1;
+            Char = Byte & 0x1F;
+        } else if (Byte >= 0xE0 && Byte <= 0xEF) {
+            BytesRemaining = 2;
+            Char = Byte & 0x0F;
+            if (Byte == 0xE0) {
+                LowestNext = 0xA0;
+            } else if (Byte == 0xED) {
+                HighestNext = 0x9F;
+            }
+        } else if (Byte >= 0xF0 && Byte <= 0xF4) {
+            BytesRemaining = 3;
+            Char = Byte & 0x07;
+            if (Byte == 0xF0) {
+                LowestNext = 0x90;
+            } else if (Byte == 0xF4) {
+                HighestNext = 0x8F;
+            }
+        } else {
+            BytesRemaining = 0;
+            Char = 0xFFFD;
+        }
+
+        BytesConsumed = 1;
+        while (BytesRemaining > 0) {
+            if (Index + BytesConsumed >= InputBufferLength) {
+                break;
+            }
+            Byte = (UCHAR)InputStringBuffer[Index + BytesConsumed];
+            if (Byte < LowestNext || Byte > HighestNext) {
+                break;
+            }
+            Char = (Char << 6) | (Byte & 0x3F);
+            BytesConsumed++;
+            BytesRemaining--;
+            LowestNext = 0x80;
+            HighestNext = 0xBF;
+        }
+
+        if (BytesRemaining > 0) {
+            Char = 0xFFFD;
+        }
+
+        CharsNeeded = 1;
+        if (Char >= 0x10000) {
+            CharsNeeded = 2;
+        }
+
+        if (OutputStringBuffer != NULL) {
+            if (OutIndex + CharsNeeded > OutputBufferLength) {
+                break;
+            }
+
+            if (CharsNeeded == 2) {
+                Char = Char - 0x10000;
+                OutputStringBuffer[OutIndex] = (TCHAR)(0xD800 + (Char >> 10));
+                OutputStringBuffer[OutIndex + 1] = (TCHAR)(0xDC00 + (Char & 0x3FF));
+            } else {
+                OutputStringBuffer[OutIndex] = (TCHAR)Char;
+            }
+        }
+
+        Index = Index + BytesConsumed;
+        OutIndex = OutIndex + CharsNeeded;
+    }
+
+    return OutIndex;
+}
+
 /**
  Returns the number of bytes needed to store a specified UTF16 string in
  the current output encoding.
@@ -156,6 +484,9 @@ YoriLibGetMbyteOutputSizeNeeded(
     if (Encoding == CP_UTF16) {
         return BufferLength * sizeof(WCHAR);
     }
+    if (Encoding == CP_UTF8) {
+        return YoriLibUtf8FromUtf16(StringBuffer, BufferLength, NULL, 0);
+    }
     Return = WideCharToMultiByte(Encoding, 0, StringBuffer, BufferLength, NULL, 0, NULL, NULL);
     ASSERT(Return > 0 || BufferLength == 0);
     ASSERT(YoriLibIsSizeAllocatable(Return));
@@ -198,6 +529,11 @@ YoriLibMultibyteOutput(
         }
         return;
     }
+    if (Encoding == CP_UTF8) {
+        Return = YoriLibUtf8FromUtf16(InputStringBuffer, InputBufferLength, OutputStringBuffer, OutputBufferLength);
+        ASSERT(Return == YoriLibUtf8FromUtf16(InputStringBuffer, InputBufferLength, NULL, 0));
+        return;
+    }
     Return = WideCharToMultiByte(Encoding,
                                  0,
                                  InputStringBuffer,
@@ -234,6 +570,9 @@ YoriLibGetMultibyteInputSizeNeeded(
     if (Encoding == CP_UTF16) {
         return BufferLength;
     }
+    if (Encoding == CP_UTF8) {
+        return YoriLibUtf16FromUtf8(StringBuffer, BufferLength, NULL, 0);
+    }
     Return = MultiByteToWideChar(Encoding, 0, StringBuffer, BufferLength, NULL, 0);
     ASSERT(YoriLibIsSizeAllocatable(Return));
     return (YORI_ALLOC_SIZE_T)Return;
@@ -268,6 +607,11 @@ YoriLibMultibyteInput(
         }
         return;
     }
+    if (Encoding == CP_UTF8) {
+        Return = YoriLibUtf16FromUtf8(InputStringBuffer, InputBufferLength, OutputStringBuffer, OutputBufferLength);
+        ASSERT(Return == YoriLibUtf16FromUtf8(InputStringBuffer, InputBufferLength, NULL, 0));
+        return;
+    }
     Return = MultiByteToWideChar(Encoding,
                                  0,
                                  InputStringBuffer,
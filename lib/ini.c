@@ -0,0 +1,1513 @@
+/**
+ * @file lib/ini.c
+ *
+ * Yori in memory INI file support
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ A single line within an INI file.  Lines which assign a value to a key are
+ also found through the hash table of their section.  Other lines, such as
+ comments and blank lines, are retained so they can be written back.
+ */
+typedef struct _YORI_LIB_INI_LINE {
+
+    /**
+     The link of this line within the lines of its section.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The entry for this line within the key table of its section.  Only
+     used if IsKey is TRUE and this is the first line for the key.
+     */
+    YORI_OPEN_HASH_ENTRY HashEntry;
+
+    /**
+     The text of the line, excluding any line ending.
+     */
+    YORI_STRING Line;
+
+    /**
+     The name of the key, referring to memory within Line.
+     */
+    YORI_STRING Key;
+
+    /**
+     The value of the key, referring to memory within Line.
+     */
+    YORI_STRING Value;
+
+    /**
+     TRUE if this line assigns a value to a key.
+     */
+    BOOLEAN IsKey;
+
+    /**
+     TRUE if this line is currently in the key table of its section.
+     */
+    BOOLEAN InTable;
+
+} YORI_LIB_INI_LINE, *PYORI_LIB_INI_LINE;
+
+/**
+ A section within an INI file.
+ */
+typedef struct _YORI_LIB_INI_SECTION {
+
+    /**
+     The link of this section within the sections of the file.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The entry for this section within the section table of the file.
+     */
+    YORI_OPEN_HASH_ENTRY HashEntry;
+
+    /**
+     The text of the line introducing the section.  Empty for the lines
+     preceding the first section.
+     */
+    YORI_STRING Line;
+
+    /**
+     The name of the section, referring to memory within Line.
+     */
+    YORI_STRING Name;
+
+    /**
+     The list of lines within the section.
+     */
+    YORI_LIST_ENTRY Lines;
+
+    /**
+     A table of the keys within the section.
+     */
+    PYORI_OPEN_HASH_TABLE Keys;
+
+    /**
+     TRUE if this section is currently in the section table of the file.
+     */
+    BOOLEAN InTable;
+
+} YORI_LIB_INI_SECTION, *PYORI_LIB_INI_SECTION;
+
+/**
+ An INI file which has been loaded into memory.
+ */
+typedef struct _YORI_LIB_INI_FILE {
+
+    /**
+     The path to the file.
+     */
+    YORI_STRING FileName;
+
+    /**
+     The lines preceding the first section.
+     */
+    YORI_LIB_INI_SECTION Preamble;
+
+    /**
+     The list of sections in the file, in the order they are written.
+     */
+    YORI_LIST_ENTRY Sections;
+
+    /**
+     A table of the sections in the file.
+     */
+    PYORI_OPEN_HASH_TABLE SectionTable;
+
+    /**
+     The encoding of the file, which is either CP_ACP, CP_UTF8 or CP_UTF16.
+     */
+    DWORD Encoding;
+
+    /**
+     TRUE if the file has changed since it was loaded or last flushed.
+     */
+    BOOLEAN Modified;
+
+} YORI_LIB_INI_FILE;
+
+/**
+ Remove spaces and tabs from the beginning and end of a string.
+
+ @param String Pointer to the string to trim.
+ */
+VOID
+YoriLibIniTrim(
+    __inout PYORI_STRING String
+    )
+{
+    while (String->LengthInChars > 0 &&
+           (String->StartOfString[0] == ' ' || String->StartOfString[0] == '\t')) {
+
+        String->StartOfString++;
+        String->LengthInChars--;
+    }
+
+    while (String->LengthInChars > 0 &&
+           (String->StartOfString[String->LengthInChars - 1] == ' ' ||
+            String->StartOfString[String->LengthInChars - 1] == '\t')) {
+
+        String->LengthInChars--;
+    }
+}
+
+/**
+ Allocate a line structure describing a line of text.  If the line assigns
+ a value to a key, the key and value are located.
+
+ @param Text Pointer to the text of the line.  The line takes a reference on
+        this text.
+
+ @return Pointer to the line, or NULL on allocation failure.
+ */
+PYORI_LIB_INI_LINE
+YoriLibIniAllocateLine(
+    __in PYORI_STRING Text
+    )
+{
+    PYORI_LIB_INI_LINE Line;
+    YORI_ALLOC_SIZE_T Index;
+
+    Line = YoriLibMalloc(sizeof(YORI_LIB_INI_LINE));
+    if (Line == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Line, sizeof(YORI_LIB_INI_LINE));
+    YoriLibCloneString(&Line->Line, Text);
+
+    YoriLibInitEmptyString(&Line->Key);
+    Line->Key.StartOfString = Text->StartOfString;
+    Line->Key.LengthInChars = Text->LengthInChars;
+    YoriLibIniTrim(&Line->Key);
+
+    if (Line->Key.LengthInChars == 0 || Line->Key.StartOfString[0] == ';') {
+        return Line;
+    }
+
+    for (Index = 0; Index < Line->Key.LengthInChars; Index++) {
+        if (Line->Key.StartOfString[Index] == '=') {
+            break;
+        }
+    }
+
+    if (Index == Line->Key.LengthInChars) {
+        return Line;
+    }
+
+    YoriLibInitEmptyString(&Line->Value);
+    Line->Value.StartOfString = &Line->Key.StartOfString[Index + 1];
+    Line->Value.LengthInChars = (YORI_ALLOC_SIZE_T)(Line->Key.LengthInChars - Index - 1);
+    Line->Key.LengthInChars = Index;
+    YoriLibIniTrim(&Line->Key);
+    YoriLibIniTrim(&Line->Value);
+
+    if (Line->Key.LengthInChars > 0) {
+        Line->IsKey = TRUE;
+    }
+
+    return Line;
+}
+
+/**
+ Free a line structure.  The line must not be in a key table.
+
+ @param Line Pointer to the line to free.
+ */
+VOID
+YoriLibIniFreeLine(
+    __in PYORI_LIB_INI_LINE Line
+    )
+{
+    ASSERT(!Line->InTable);
+    YoriLibFreeStringContents(&Line->Line);
+    YoriLibFree(Line);
+}
+
+/**
+ Add a line to the key table of a section if it assigns a value to a key
+ that is not already in the table.  As with the system's INI support, the
+ first assignment to a key within a section is the one which is used.
+
+ @param Section Pointer to the section.
+
+ @param Line Pointer to the line.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibIniAddLineToTable(
+    __in PYORI_LIB_INI_SECTION Section,
+    __in PYORI_LIB_INI_LINE Line
+    )
+{
+    if (!Line->IsKey ||
+        YoriLibOpenHashLookupByKey(Section->Keys, &Line->Key) != NULL) {
+
+        return TRUE;
+    }
+
+    if (!YoriLibOpenHashInsertByKey(Section->Keys, &Line->Key, Line, &Line->HashEntry)) {
+        return FALSE;
+    }
+
+    Line->InTable = TRUE;
+    return TRUE;
+}
+
+/**
+ Initialize a section structure.
+
+ @param Section Pointer to the section to initialize.
+
+ @param Text Pointer to the text of the line introducing the section, or NULL
+        for the lines preceding the first section.  The section takes a
+        reference on this text.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibIniInitializeSection(
+    __out PYORI_LIB_INI_SECTION Section,
+    __in_opt PYORI_STRING Text
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    ZeroMemory(Section, sizeof(YORI_LIB_INI_SECTION));
+    YoriLibInitializeListHead(&Section->Lines);
+    YoriLibInitEmptyString(&Section->Line);
+    YoriLibInitEmptyString(&Section->Name);
+
+    Section->Keys = YoriLibAllocateOpenHashTable(0);
+    if (Section->Keys == NULL) {
+        return FALSE;
+    }
+
+    if (Text != NULL) {
+        YoriLibCloneString(&Section->Line, Text);
+        Section->Name.StartOfString = Text->StartOfString;
+        Section->Name.LengthInChars = Text->LengthInChars;
+        YoriLibIniTrim(&Section->Name);
+
+        ASSERT(Section->Name.LengthInChars > 0 && Section->Name.StartOfString[0] == '[');
+        Section->Name.StartOfString++;
+        Section->Name.LengthInChars--;
+
+        for (Index = 0; Index < Section->Name.LengthInChars; Index++) {
+            if (Section->Name.StartOfString[Index] == ']') {
+                break;
+            }
+        }
+        Section->Name.LengthInChars = Index;
+        YoriLibIniTrim(&Section->Name);
+    }
+
+    return TRUE;
+}
+
+/**
+ Free the lines within a section and the section's resources.  The section
+ structure itself is not freed.
+
+ @param Section Pointer to the section to clean up.
+ */
+VOID
+YoriLibIniCleanupSection(
+    __in PYORI_LIB_INI_SECTION Section
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIB_INI_LINE Line;
+
+    ListEntry = YoriLibGetNextListEntry(&Section->Lines, NULL);
+    while (ListEntry != NULL) {
+        Line = CONTAINING_RECORD(ListEntry, YORI_LIB_INI_LINE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Section->Lines, ListEntry);
+        YoriLibRemoveListItem(&Line->ListEntry);
+        if (Line->InTable) {
+            YoriLibOpenHashRemoveByEntry(&Line->HashEntry);
+            Line->InTable = FALSE;
+        }
+        YoriLibIniFreeLine(Line);
+    }
+
+    if (Section->Keys != NULL) {
+        YoriLibFreeEmptyOpenHashTable(Section->Keys);
+        Section->Keys = NULL;
+    }
+
+    YoriLibFreeStringContents(&Section->Line);
+}
+
+/**
+ Allocate a new section, add it to the end of the file, and add it to the
+ section table if no section with the same name exists.
+
+ @param IniFile Pointer to the INI file.
+
+ @param Text Pointer to the text of the line introducing the section.  The
+        section takes a reference on this text.
+
+ @return Pointer to the section, or NULL on allocation failure.
+ */
+PYORI_LIB_INI_SECTION
+YoriLibIniAppendSection(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __in PYORI_STRING Text
+    )
+{
+    PYORI_LIB_INI_SECTION Section;
+
+    Section = YoriLibMalloc(sizeof(YORI_LIB_INI_SECTION));
+    if (Section == NULL) {
+        return NULL;
+    }
+
+    if (!YoriLibIniInitializeSection(Section, Text)) {
+        YoriLibIniCleanupSection(Section);
+        YoriLibFree(Section);
+        return NULL;
+    }
+
+    if (YoriLibOpenHashLookupByKey(IniFile->SectionTable, &Section->Name) == NULL) {
+        if (!YoriLibOpenHashInsertByKey(IniFile->SectionTable, &Section->Name, Section, &Section->HashEntry)) {
+            YoriLibIniCleanupSection(Section);
+            YoriLibFree(Section);
+            return NULL;
+        }
+        Section->InTable = TRUE;
+    }
+
+    YoriLibAppendList(&IniFile->Sections, &Section->ListEntry);
+    return Section;
+}
+
+/**
+ Decode the contents of an INI file into a string.  Files are UTF16 if they
+ start with a UTF16 BOM, UTF8 if they start with a UTF8 BOM, and in the
+ active code page otherwise, matching the system's INI support.
+
+ @param IniFile Pointer to the INI file, whose encoding is updated.
+
+ @param Buffer Pointer to the file contents.
+
+ @param BufferLength The length of the file contents, in bytes.
+
+ @param Text On successful completion, populated with the decoded text.
+
+ @return TRUE to indicate success, FALSE on failure.
+ */
+__success(return)
+BOOL
+YoriLibIniDecode(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __in PUCHAR Buffer,
+    __in DWORD BufferLength,
+    __out PYORI_STRING Text
+    )
+{
+    DWORD CharsNeeded;
+    DWORD SkipBytes;
+
+    SkipBytes = 0;
+    IniFile->Encoding = CP_ACP;
+    if (BufferLength >= 2 && Buffer[0] == 0xFF && Buffer[1] == 0xFE) {
+        IniFile->Encoding = CP_UTF16;
+        SkipBytes = 2;
+    } else if (BufferLength >= 3 && Buffer[0] == 0xEF && Buffer[1] == 0xBB && Buffer[2] == 0xBF) {
+        IniFile->Encoding = CP_UTF8;
+        SkipBytes = 3;
+    }
+
+    Buffer = Buffer + SkipBytes;
+    BufferLength = BufferLength - SkipBytes;
+
+    if (IniFile->Encoding == CP_UTF16) {
+        CharsNeeded = BufferLength / sizeof(TCHAR);
+    } else if (BufferLength == 0) {
+        CharsNeeded = 0;
+    } else {
+        CharsNeeded = MultiByteToWideChar(IniFile->Encoding, 0, (LPCSTR)Buffer, BufferLength, NULL, 0);
+        if (CharsNeeded == 0) {
+            return FALSE;
+        }
+    }
+
+    if (!YoriLibIsSizeAllocatable(CharsNeeded + 1) ||
+        !YoriLibAllocateString(Text, (YORI_ALLOC_SIZE_T)(CharsNeeded + 1))) {
+
+        return FALSE;
+    }
+
+    if (IniFile->Encoding == CP_UTF16) {
+        memcpy(Text->StartOfString, Buffer, CharsNeeded * sizeof(TCHAR));
+    } else if (CharsNeeded > 0) {
+        MultiByteToWideChar(IniFile->Encoding, 0, (LPCSTR)Buffer, BufferLength, Text->StartOfString, CharsNeeded);
+    }
+
+    Text->LengthInChars = (YORI_ALLOC_SIZE_T)CharsNeeded;
+    Text->StartOfString[CharsNeeded] = '\0';
+    return TRUE;
+}
+
+/**
+ Parse the text of an INI file into sections and lines.
+
+ @param IniFile Pointer to the INI file to populate.
+
+ @param Text Pointer to the text of the file.  Lines take references on this
+        text.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibIniParse(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __in PYORI_STRING Text
+    )
+{
+    PYORI_LIB_INI_SECTION Section;
+    PYORI_LIB_INI_LINE Line;
+    YORI_STRING LineText;
+    YORI_STRING Trimmed;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T LineStart;
+
+    Section = &IniFile->Preamble;
+    LineStart = 0;
+
+    while (LineStart < Text->LengthInChars) {
+        for (Index = LineStart; Index < Text->LengthInChars; Index++) {
+            if (Text->StartOfString[Index] == '\r' || Text->StartOfString[Index] == '\n') {
+                break;
+            }
+        }
+
+        YoriLibInitEmptyString(&LineText);
+        LineText.MemoryToFree = Text->MemoryToFree;
+        LineText.StartOfString = &Text->StartOfString[LineStart];
+        LineText.LengthInChars = (YORI_ALLOC_SIZE_T)(Index - LineStart);
+
+        if (Index < Text->LengthInChars && Text->StartOfString[Index] == '\r') {
+            Index++;
+        }
+        if (Index < Text->LengthInChars && Text->StartOfString[Index] == '\n') {
+            Index++;
+        }
+        LineStart = Index;
+
+        YoriLibInitEmptyString(&Trimmed);
+        Trimmed.StartOfString = LineText.StartOfString;
+        Trimmed.LengthInChars = LineText.LengthInChars;
+        YoriLibIniTrim(&Trimmed);
+
+        if (Trimmed.LengthInChars > 0 && Trimmed.StartOfString[0] == '[') {
+            Section = YoriLibIniAppendSection(IniFile, &LineText);
+            if (Section == NULL) {
+                return FALSE;
+            }
+            continue;
+        }
+
+        Line = YoriLibIniAllocateLine(&LineText);
+        if (Line == NULL) {
+            return FALSE;
+        }
+
+        YoriLibAppendList(&Section->Lines, &Line->ListEntry);
+        if (!YoriLibIniAddLineToTable(Section, Line)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Free an INI file which was loaded into memory.  Any changes which have not
+ been written with @ref YoriLibIniFlush are discarded.
+
+ @param IniFile Pointer to the INI file to free.
+ */
+VOID
+YoriLibIniFree(
+    __in PYORI_LIB_INI_FILE IniFile
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIB_INI_SECTION Section;
+
+    ListEntry = YoriLibGetNextListEntry(&IniFile->Sections, NULL);
+    while (ListEntry != NULL) {
+        Section = CONTAINING_RECORD(ListEntry, YORI_LIB_INI_SECTION, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&IniFile->Sections, ListEntry);
+        YoriLibRemoveListItem(&Section->ListEntry);
+        if (Section->InTable) {
+            YoriLibOpenHashRemoveByEntry(&Section->HashEntry);
+        }
+        YoriLibIniCleanupSection(Section);
+        YoriLibFree(Section);
+    }
+
+    YoriLibIniCleanupSection(&IniFile->Preamble);
+
+    if (IniFile->SectionTable != NULL) {
+        YoriLibFreeEmptyOpenHashTable(IniFile->SectionTable);
+    }
+
+    YoriLibFreeStringContents(&IniFile->FileName);
+    YoriLibFree(IniFile);
+}
+
+/**
+ Load an INI file into memory so that values can be queried and updated
+ without parsing the file for each operation.  A file which does not exist
+ is treated as empty, and is created if values are written to it.
+
+ @param FileName Pointer to a fully qualified path to the INI file.
+
+ @return Pointer to the loaded INI file, which should be freed with
+         @ref YoriLibIniFree , or NULL on failure.
+ */
+__success(return != NULL)
+PYORI_LIB_INI_FILE
+YoriLibIniLoad(
+    __in PCYORI_STRING FileName
+    )
+{
+    PYORI_LIB_INI_FILE IniFile;
+    HANDLE hFile;
+    DWORD FileSizeHigh;
+    DWORD FileSize;
+    DWORD BytesRead;
+    PUCHAR Buffer;
+    YORI_STRING Text;
+    BOOL Result;
+
+    ASSERT(YoriLibIsStringNullTerminated(FileName));
+
+    IniFile = YoriLibMalloc(sizeof(YORI_LIB_INI_FILE));
+    if (IniFile == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(IniFile, sizeof(YORI_LIB_INI_FILE));
+    YoriLibInitializeListHead(&IniFile->Sections);
+    IniFile->Encoding = CP_ACP;
+
+    if (!YoriLibIniInitializeSection(&IniFile->Preamble, NULL)) {
+        YoriLibIniFree(IniFile);
+        return NULL;
+    }
+
+    IniFile->SectionTable = YoriLibAllocateOpenHashTable(0);
+    if (IniFile->SectionTable == NULL) {
+        YoriLibIniFree(IniFile);
+        return NULL;
+    }
+
+    if (!YoriLibAllocateString(&IniFile->FileName, FileName->LengthInChars + 1)) {
+        YoriLibIniFree(IniFile);
+        return NULL;
+    }
+    memcpy(IniFile->FileName.StartOfString, FileName->StartOfString, FileName->LengthInChars * sizeof(TCHAR));
+    IniFile->FileName.StartOfString[FileName->LengthInChars] = '\0';
+    IniFile->FileName.LengthInChars = FileName->LengthInChars;
+
+    hFile = CreateFile(FileName->StartOfString,
+                       GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_FLAG_SEQUENTIAL_SCAN,
+                       NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        if (GetLastError() == ERROR_FILE_NOT_FOUND ||
+            GetLastError() == ERROR_PATH_NOT_FOUND) {
+
+            return IniFile;
+        }
+        YoriLibIniFree(IniFile);
+        return NULL;
+    }
+
+    FileSize = GetFileSize(hFile, &FileSizeHigh);
+    if (FileSizeHigh != 0 ||
+        FileSize == (DWORD)-1 ||
+        !YoriLibIsSizeAllocatable(FileSize + 1)) {
+
+        CloseHandle(hFile);
+        YoriLibIniFree(IniFile);
+        return NULL;
+    }
+
+    Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)(FileSize + 1));
+    if (Buffer == NULL) {
+        CloseHandle(hFile);
+        YoriLibIniFree(IniFile);
+        return NULL;
+    }
+
+    Result = ReadFile(hFile, Buffer, FileSize, &BytesRead, NULL);
+    CloseHandle(hFile);
+
+    if (!Result || BytesRead != FileSize) {
+        YoriLibFree(Buffer);
+        YoriLibIniFree(IniFile);
+        return NULL;
+    }
+
+    Result = YoriLibIniDecode(IniFile, Buffer, FileSize, &Text);
+    YoriLibFree(Buffer);
+    if (!Result) {
+        YoriLibIniFree(IniFile);
+        return NULL;
+    }
+
+    Result = YoriLibIniParse(IniFile, &Text);
+    YoriLibFreeStringContents(&Text);
+    if (!Result) {
+        YoriLibIniFree(IniFile);
+        return NULL;
+    }
+
+    return IniFile;
+}
+
+/**
+ Find a section within an INI file.
+
+ @param IniFile Pointer to the INI file.
+
+ @param SectionName Pointer to the name of the section.
+
+ @return Pointer to the section, or NULL if it is not found.
+ */
+PYORI_LIB_INI_SECTION
+YoriLibIniFindSection(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __in LPCTSTR SectionName
+    )
+{
+    YORI_STRING Name;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+
+    YoriLibConstantString(&Name, SectionName);
+    HashEntry = YoriLibOpenHashLookupByKey(IniFile->SectionTable, &Name);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+
+    return HashEntry->Context;
+}
+
+/**
+ Find the line assigning a value to a key within a section.
+
+ @param Section Pointer to the section.
+
+ @param KeyName Pointer to the name of the key.
+
+ @return Pointer to the line, or NULL if it is not found.
+ */
+PYORI_LIB_INI_LINE
+YoriLibIniFindKey(
+    __in PYORI_LIB_INI_SECTION Section,
+    __in LPCTSTR KeyName
+    )
+{
+    YORI_STRING Name;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+
+    YoriLibConstantString(&Name, KeyName);
+    HashEntry = YoriLibOpenHashLookupByKey(Section->Keys, &Name);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+
+    return HashEntry->Context;
+}
+
+/**
+ Copy a string into a caller's buffer, truncating if necessary, and
+ returning the number of characters copied in the same way as
+ GetPrivateProfileString.
+
+ @param Source Pointer to the string to copy.
+
+ @param Buffer Pointer to the buffer to copy into.
+
+ @param BufferLength The length of Buffer, in characters.
+
+ @return The number of characters copied, not including the NULL terminator.
+ */
+DWORD
+YoriLibIniCopyToBuffer(
+    __in PCYORI_STRING Source,
+    __out_ecount(BufferLength) LPTSTR Buffer,
+    __in DWORD BufferLength
+    )
+{
+    DWORD Length;
+
+    if (BufferLength == 0) {
+        return 0;
+    }
+
+    Length = Source->LengthInChars;
+    if (Length >= BufferLength) {
+        Length = BufferLength - 1;
+    }
+
+    memcpy(Buffer, Source->StartOfString, Length * sizeof(TCHAR));
+    Buffer[Length] = '\0';
+    return Length;
+}
+
+/**
+ Query a string value from an INI file.  This behaves like
+ GetPrivateProfileString: surrounding quotes are removed from the value,
+ and if the value does not fit, it is truncated.
+
+ @param IniFile Pointer to the INI file.
+
+ @param SectionName Pointer to the name of the section.
+
+ @param KeyName Pointer to the name of the key.
+
+ @param DefaultValue Pointer to the value to return if the key is not found.
+
+ @param Buffer Pointer to a buffer to receive the value.
+
+ @param BufferLength The length of Buffer, in characters.
+
+ @return The number of characters copied into Buffer, not including the NULL
+         terminator.
+ */
+DWORD
+YoriLibIniGetString(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName,
+    __in_opt LPCTSTR DefaultValue,
+    __out_ecount(BufferLength) LPTSTR Buffer,
+    __in DWORD BufferLength
+    )
+{
+    PYORI_LIB_INI_SECTION Section;
+    PYORI_LIB_INI_LINE Line;
+    YORI_STRING Value;
+
+    Line = NULL;
+    Section = YoriLibIniFindSection(IniFile, SectionName);
+    if (Section != NULL) {
+        Line = YoriLibIniFindKey(Section, KeyName);
+    }
+
+    if (Line == NULL) {
+        if (DefaultValue == NULL) {
+            DefaultValue = _T("");
+        }
+        YoriLibConstantString(&Value, DefaultValue);
+        return YoriLibIniCopyToBuffer(&Value, Buffer, BufferLength);
+    }
+
+    YoriLibInitEmptyString(&Value);
+    Value.StartOfString = Line->Value.StartOfString;
+    Value.LengthInChars = Line->Value.LengthInChars;
+    if (Value.LengthInChars >= 2 &&
+        (Value.StartOfString[0] == '"' || Value.StartOfString[0] == '\'') &&
+        Value.StartOfString[Value.LengthInChars - 1] == Value.StartOfString[0]) {
+
+        Value.StartOfString++;
+        Value.LengthInChars = Value.LengthInChars - 2;
+    }
+
+    return YoriLibIniCopyToBuffer(&Value, Buffer, BufferLength);
+}
+
+/**
+ Query a numeric value from an INI file.  This behaves like
+ GetPrivateProfileInt.
+
+ @param IniFile Pointer to the INI file.
+
+ @param SectionName Pointer to the name of the section.
+
+ @param KeyName Pointer to the name of the key.
+
+ @param DefaultValue The value to return if the key is not found or is not
+        numeric.
+
+ @return The value of the key.
+ */
+UINT
+YoriLibIniGetInt(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName,
+    __in INT DefaultValue
+    )
+{
+    TCHAR Buffer[32];
+    YORI_STRING Value;
+    YORI_MAX_SIGNED_T Number;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+
+    YoriLibInitEmptyString(&Value);
+    Value.StartOfString = Buffer;
+    Value.LengthInChars = (YORI_ALLOC_SIZE_T)YoriLibIniGetString(IniFile, SectionName, KeyName, NULL, Buffer, sizeof(Buffer)/sizeof(Buffer[0]));
+
+    if (!YoriLibStringToNumber(&Value, FALSE, &Number, &CharsConsumed) ||
+        CharsConsumed == 0) {
+
+        return (UINT)DefaultValue;
+    }
+
+    return (UINT)Number;
+}
+
+/**
+ Append a NULL terminated string to a buffer containing a list of NULL
+ terminated strings, as used by GetPrivateProfileSection.
+
+ @param Source Pointer to the string to append.
+
+ @param Buffer Pointer to the buffer.
+
+ @param BufferLength The length of Buffer, in characters.
+
+ @param Offset Pointer to the offset within Buffer to write to.  On
+        successful completion, updated to the offset following the NULL
+        terminator.
+
+ @return TRUE if the string and its terminator fit, leaving room for the
+         final terminator.  FALSE if the buffer is full.
+ */
+__success(return)
+BOOL
+YoriLibIniAppendToList(
+    __in PCYORI_STRING Source,
+    __out_ecount(BufferLength) LPTSTR Buffer,
+    __in DWORD BufferLength,
+    __inout PDWORD Offset
+    )
+{
+    if (*Offset + Source->LengthInChars + 2 > BufferLength) {
+        return FALSE;
+    }
+
+    memcpy(&Buffer[*Offset], Source->StartOfString, Source->LengthInChars * sizeof(TCHAR));
+    *Offset = *Offset + Source->LengthInChars;
+    Buffer[*Offset] = '\0';
+    *Offset = *Offset + 1;
+    return TRUE;
+}
+
+/**
+ Terminate a list of NULL terminated strings.
+
+ @param Buffer Pointer to the buffer.
+
+ @param BufferLength The length of Buffer, in characters.
+
+ @param Offset The offset following the final string in the list.
+
+ @return The number of characters in the list, not including the final NULL
+         terminator.
+ */
+DWORD
+YoriLibIniTerminateList(
+    __out_ecount(BufferLength) LPTSTR Buffer,
+    __in DWORD BufferLength,
+    __in DWORD Offset
+    )
+{
+    if (BufferLength == 0) {
+        return 0;
+    }
+
+    if (BufferLength == 1) {
+        Buffer[0] = '\0';
+        return 0;
+    }
+
+    if (Offset == 0) {
+        Buffer[0] = '\0';
+        Buffer[1] = '\0';
+        return 0;
+    }
+
+    Buffer[Offset] = '\0';
+    return Offset;
+}
+
+/**
+ Query all of the keys and values in a section of an INI file.  This
+ behaves like GetPrivateProfileSection, returning a list of NULL terminated
+ key=value strings followed by an additional NULL terminator.  Unlike the
+ system function, entries which do not fit in the buffer are omitted rather
+ than truncated.
+
+ @param IniFile Pointer to the INI file.
+
+ @param SectionName Pointer to the name of the section.
+
+ @param Buffer Pointer to a buffer to receive the list.
+
+ @param BufferLength The length of Buffer, in characters.
+
+ @return The number of characters copied into Buffer, not including the final
+         NULL terminator.
+ */
+DWORD
+YoriLibIniGetSection(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __in LPCTSTR SectionName,
+    __out_ecount(BufferLength) LPTSTR Buffer,
+    __in DWORD BufferLength
+    )
+{
+    PYORI_LIB_INI_SECTION Section;
+    PYORI_LIB_INI_LINE Line;
+    PYORI_LIST_ENTRY ListEntry;
+    YORI_STRING Text;
+    DWORD Offset;
+
+    Offset = 0;
+
+    Section = YoriLibIniFindSection(IniFile, SectionName);
+    if (Section != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&Section->Lines, NULL);
+        while (ListEntry != NULL) {
+            Line = CONTAINING_RECORD(ListEntry, YORI_LIB_INI_LINE, ListEntry);
+            ListEntry = YoriLibGetNextListEntry(&Section->Lines, ListEntry);
+
+            if (!Line->IsKey) {
+                continue;
+            }
+
+            //
+            //  Return each assignment as key=value without any whitespace
+            //  around the equals sign, so callers can split on it.
+            //
+
+            if (Offset + Line->Key.LengthInChars + 1 + Line->Value.LengthInChars + 2 > BufferLength) {
+                break;
+            }
+
+            memcpy(&Buffer[Offset], Line->Key.StartOfString, Line->Key.LengthInChars * sizeof(TCHAR));
+            Offset = Offset + Line->Key.LengthInChars;
+            Buffer[Offset] = '=';
+            Offset++;
+            YoriLibInitEmptyString(&Text);
+            Text.StartOfString = Line->Value.StartOfString;
+            Text.LengthInChars = Line->Value.LengthInChars;
+            YoriLibIniAppendToList(&Text, Buffer, BufferLength, &Offset);
+        }
+    }
+
+    return YoriLibIniTerminateList(Buffer, BufferLength, Offset);
+}
+
+/**
+ Query the names of all sections in an INI file.  This behaves like
+ GetPrivateProfileSectionNames, returning a list of NULL terminated names
+ followed by an additional NULL terminator.  Names which do not fit in the
+ buffer are omitted.
+
+ @param IniFile Pointer to the INI file.
+
+ @param Buffer Pointer to a buffer to receive the list.
+
+ @param BufferLength The length of Buffer, in characters.
+
+ @return The number of characters copied into Buffer, not including the final
+         NULL terminator.
+ */
+DWORD
+YoriLibIniGetSectionNames(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __out_ecount(BufferLength) LPTSTR Buffer,
+    __in DWORD BufferLength
+    )
+{
+    PYORI_LIB_INI_SECTION Section;
+    PYORI_LIST_ENTRY ListEntry;
+    DWORD Offset;
+
+    Offset = 0;
+
+    ListEntry = YoriLibGetNextListEntry(&IniFile->Sections, NULL);
+    while (ListEntry != NULL) {
+        Section = CONTAINING_RECORD(ListEntry, YORI_LIB_INI_SECTION, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&IniFile->Sections, ListEntry);
+
+        if (!Section->InTable) {
+            continue;
+        }
+
+        if (!YoriLibIniAppendToList(&Section->Name, Buffer, BufferLength, &Offset)) {
+            break;
+        }
+    }
+
+    return YoriLibIniTerminateList(Buffer, BufferLength, Offset);
+}
+
+/**
+ Remove a line from a section and free it.  If the line was the one found
+ for its key and a later line assigns the same key, the later line becomes
+ the one found for the key.
+
+ @param Section Pointer to the section containing the line.
+
+ @param Line Pointer to the line to remove.
+ */
+VOID
+YoriLibIniRemoveLine(
+    __in PYORI_LIB_INI_SECTION Section,
+    __in PYORI_LIB_INI_LINE Line
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIB_INI_LINE Later;
+    BOOLEAN WasInTable;
+
+    WasInTable = Line->InTable;
+    if (Line->InTable) {
+        YoriLibOpenHashRemoveByEntry(&Line->HashEntry);
+        Line->InTable = FALSE;
+    }
+
+    ListEntry = &Line->ListEntry;
+    if (WasInTable) {
+        while (TRUE) {
+            ListEntry = YoriLibGetNextListEntry(&Section->Lines, ListEntry);
+            if (ListEntry == NULL) {
+                break;
+            }
+            Later = CONTAINING_RECORD(ListEntry, YORI_LIB_INI_LINE, ListEntry);
+            if (Later->IsKey && YoriLibCompareStringIns(&Later->Key, &Line->Key) == 0) {
+                YoriLibIniAddLineToTable(Section, Later);
+                break;
+            }
+        }
+    }
+
+    YoriLibRemoveListItem(&Line->ListEntry);
+    YoriLibIniFreeLine(Line);
+}
+
+/**
+ Update a value in an INI file, or remove a key or section.  This behaves
+ like WritePrivateProfileString, except the change is only made in memory
+ until @ref YoriLibIniFlush is called.
+
+ @param IniFile Pointer to the INI file.
+
+ @param SectionName Pointer to the name of the section.
+
+ @param KeyName Pointer to the name of the key.  If NULL, the entire section
+        is removed.
+
+ @param Value Pointer to the value to assign to the key.  If NULL, the key
+        is removed.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibIniWriteString(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __in LPCTSTR SectionName,
+    __in_opt LPCTSTR KeyName,
+    __in_opt LPCTSTR Value
+    )
+{
+    PYORI_LIB_INI_SECTION Section;
+    PYORI_LIB_INI_SECTION Later;
+    PYORI_LIB_INI_LINE Line;
+    PYORI_LIB_INI_LINE NewLine;
+    PYORI_LIST_ENTRY ListEntry;
+    YORI_STRING Text;
+
+    Section = YoriLibIniFindSection(IniFile, SectionName);
+
+    //
+    //  Removing something that doesn't exist succeeds without changing the
+    //  file.
+    //
+
+    if (KeyName == NULL) {
+        if (Section != NULL) {
+            YoriLibOpenHashRemoveByEntry(&Section->HashEntry);
+            Section->InTable = FALSE;
+
+            //
+            //  If the name appears again later in the file, that section
+            //  now becomes the one that is found.
+            //
+
+            ListEntry = &Section->ListEntry;
+            while (TRUE) {
+                ListEntry = YoriLibGetNextListEntry(&IniFile->Sections, ListEntry);
+                if (ListEntry == NULL) {
+                    break;
+                }
+                Later = CONTAINING_RECORD(ListEntry, YORI_LIB_INI_SECTION, ListEntry);
+                if (YoriLibCompareStringIns(&Later->Name, &Section->Name) == 0) {
+                    if (YoriLibOpenHashInsertByKey(IniFile->SectionTable, &Later->Name, Later, &Later->HashEntry)) {
+                        Later->InTable = TRUE;
+                    }
+                    break;
+                }
+            }
+
+            YoriLibRemoveListItem(&Section->ListEntry);
+            YoriLibIniCleanupSection(Section);
+            YoriLibFree(Section);
+            IniFile->Modified = TRUE;
+        }
+        return TRUE;
+    }
+
+    Line = NULL;
+    if (Section != NULL) {
+        Line = YoriLibIniFindKey(Section, KeyName);
+    }
+
+    if (Value == NULL) {
+        if (Line != NULL) {
+            YoriLibIniRemoveLine(Section, Line);
+            IniFile->Modified = TRUE;
+        }
+        return TRUE;
+    }
+
+    if (Section == NULL) {
+        YoriLibInitEmptyString(&Text);
+        YoriLibYPrintf(&Text, _T("[%s]"), SectionName);
+        if (Text.StartOfString == NULL) {
+            return FALSE;
+        }
+        Section = YoriLibIniAppendSection(IniFile, &Text);
+        YoriLibFreeStringContents(&Text);
+        if (Section == NULL) {
+            return FALSE;
+        }
+        IniFile->Modified = TRUE;
+    }
+
+    YoriLibInitEmptyString(&Text);
+    YoriLibYPrintf(&Text, _T("%s=%s"), KeyName, Value);
+    if (Text.StartOfString == NULL) {
+        return FALSE;
+    }
+
+    NewLine = YoriLibIniAllocateLine(&Text);
+    YoriLibFreeStringContents(&Text);
+    if (NewLine == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  If the key already exists, replace its line in place.  Otherwise
+    //  add it after the last key in the section, so any blank lines or
+    //  comments preceding the next section stay where they are.
+    //
+
+    if (Line != NULL) {
+        YoriLibInsertList(&Line->ListEntry, &NewLine->ListEntry);
+        YoriLibOpenHashRemoveByEntry(&Line->HashEntry);
+        Line->InTable = FALSE;
+        YoriLibRemoveListItem(&Line->ListEntry);
+        YoriLibIniFreeLine(Line);
+    } else {
+        ListEntry = NULL;
+        while (TRUE) {
+            ListEntry = YoriLibGetPreviousListEntry(&Section->Lines, ListEntry);
+            if (ListEntry == NULL) {
+                break;
+            }
+            Line = CONTAINING_RECORD(ListEntry, YORI_LIB_INI_LINE, ListEntry);
+            if (Line->IsKey) {
+                break;
+            }
+        }
+
+        if (ListEntry == NULL) {
+            YoriLibInsertList(&Section->Lines, &NewLine->ListEntry);
+        } else {
+            YoriLibInsertList(ListEntry, &NewLine->ListEntry);
+        }
+    }
+
+    if (!YoriLibIniAddLineToTable(Section, NewLine)) {
+        YoriLibRemoveListItem(&NewLine->ListEntry);
+        YoriLibIniFreeLine(NewLine);
+        IniFile->Modified = TRUE;
+        return FALSE;
+    }
+
+    IniFile->Modified = TRUE;
+    return TRUE;
+}
+
+/**
+ Append a line of text and a line ending to a string being constructed to
+ write back to an INI file.
+
+ @param Output Pointer to the string being constructed.
+
+ @param Text Pointer to the line of text.
+ */
+VOID
+YoriLibIniAppendOutputLine(
+    __inout PYORI_STRING Output,
+    __in PCYORI_STRING Text
+    )
+{
+    memcpy(&Output->StartOfString[Output->LengthInChars], Text->StartOfString, Text->LengthInChars * sizeof(TCHAR));
+    Output->LengthInChars = Output->LengthInChars + Text->LengthInChars;
+    Output->StartOfString[Output->LengthInChars++] = '\r';
+    Output->StartOfString[Output->LengthInChars++] = '\n';
+}
+
+/**
+ Write the text of an INI file to a handle in the file's encoding.
+
+ @param IniFile Pointer to the INI file.
+
+ @param hFile Handle to the file to write to.
+
+ @param Text Pointer to the text to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibIniWriteEncoded(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __in HANDLE hFile,
+    __in PCYORI_STRING Text
+    )
+{
+    UCHAR Bom[3];
+    DWORD BomLength;
+    DWORD BytesNeeded;
+    DWORD BytesWritten;
+    LPSTR Encoded;
+    BOOL Result;
+
+    BomLength = 0;
+    if (IniFile->Encoding == CP_UTF16) {
+        Bom[0] = 0xFF;
+        Bom[1] = 0xFE;
+        BomLength = 2;
+    } else if (IniFile->Encoding == CP_UTF8) {
+        Bom[0] = 0xEF;
+        Bom[1] = 0xBB;
+        Bom[2] = 0xBF;
+        BomLength = 3;
+    }
+
+    if (BomLength > 0) {
+        if (!WriteFile(hFile, Bom, BomLength, &BytesWritten, NULL) ||
+            BytesWritten != BomLength) {
+
+            return FALSE;
+        }
+    }
+
+    if (Text->LengthInChars == 0) {
+        return TRUE;
+    }
+
+    if (IniFile->Encoding == CP_UTF16) {
+        BytesNeeded = Text->LengthInChars * sizeof(TCHAR);
+        if (!WriteFile(hFile, Text->StartOfString, BytesNeeded, &BytesWritten, NULL) ||
+            BytesWritten != BytesNeeded) {
+
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    BytesNeeded = WideCharToMultiByte(IniFile->Encoding, 0, Text->StartOfString, Text->LengthInChars, NULL, 0, NULL, NULL);
+    if (BytesNeeded == 0 || !YoriLibIsSizeAllocatable(BytesNeeded)) {
+        return FALSE;
+    }
+
+    Encoded = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+    if (Encoded == NULL) {
+        return FALSE;
+    }
+
+    WideCharToMultiByte(IniFile->Encoding, 0, Text->StartOfString, Text->LengthInChars, Encoded, BytesNeeded, NULL, NULL);
+    Result = WriteFile(hFile, Encoded, BytesNeeded, &BytesWritten, NULL);
+    YoriLibFree(Encoded);
+
+    if (!Result || BytesWritten != BytesNeeded) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Write any changes made to an INI file back to disk.  The new contents are
+ written to a temporary file in the same directory which then replaces the
+ original, so the file is never observed partially written.
+
+ @param IniFile Pointer to the INI file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibIniFlush(
+    __in PYORI_LIB_INI_FILE IniFile
+    )
+{
+    PYORI_LIST_ENTRY SectionEntry;
+    PYORI_LIST_ENTRY LineEntry;
+    PYORI_LIB_INI_SECTION Section;
+    PYORI_LIB_INI_LINE Line;
+    YORI_STRING Output;
+    YORI_STRING Directory;
+    YORI_STRING Prefix;
+    YORI_STRING TempName;
+    LPTSTR FinalBackslash;
+    HANDLE hTempFile;
+    DWORD CharsNeeded;
+    BOOL Result;
+
+    if (!IniFile->Modified) {
+        return TRUE;
+    }
+
+    //
+    //  Count the characters needed, including two for each line ending.
+    //
+
+    CharsNeeded = 0;
+    Section = &IniFile->Preamble;
+    SectionEntry = NULL;
+    while (TRUE) {
+        if (SectionEntry != NULL) {
+            CharsNeeded = CharsNeeded + Section->Line.LengthInChars + 2;
+        }
+        LineEntry = YoriLibGetNextListEntry(&Section->Lines, NULL);
+        while (LineEntry != NULL) {
+            Line = CONTAINING_RECORD(LineEntry, YORI_LIB_INI_LINE, ListEntry);
+            CharsNeeded = CharsNeeded + Line->Line.LengthInChars + 2;
+            LineEntry = YoriLibGetNextListEntry(&Section->Lines, LineEntry);
+        }
+        SectionEntry = YoriLibGetNextListEntry(&IniFile->Sections, SectionEntry);
+        if (SectionEntry == NULL) {
+            break;
+        }
+        Section = CONTAINING_RECORD(SectionEntry, YORI_LIB_INI_SECTION, ListEntry);
+    }
+
+    if (!YoriLibIsSizeAllocatable(CharsNeeded + 1) ||
+        !YoriLibAllocateString(&Output, (YORI_ALLOC_SIZE_T)(CharsNeeded + 1))) {
+
+        return FALSE;
+    }
+
+    Section = &IniFile->Preamble;
+    SectionEntry = NULL;
+    while (TRUE) {
+        if (SectionEntry != NULL) {
+            YoriLibIniAppendOutputLine(&Output, &Section->Line);
+        }
+        LineEntry = YoriLibGetNextListEntry(&Section->Lines, NULL);
+        while (LineEntry != NULL) {
+            Line = CONTAINING_RECORD(LineEntry, YORI_LIB_INI_LINE, ListEntry);
+            YoriLibIniAppendOutputLine(&Output, &Line->Line);
+            LineEntry = YoriLibGetNextListEntry(&Section->Lines, LineEntry);
+        }
+        SectionEntry = YoriLibGetNextListEntry(&IniFile->Sections, SectionEntry);
+        if (SectionEntry == NULL) {
+            break;
+        }
+        Section = CONTAINING_RECORD(SectionEntry, YORI_LIB_INI_SECTION, ListEntry);
+    }
+
+    //
+    //  Create the temporary file next to the INI file so it can be renamed
+    //  over the original.
+    //
+
+    YoriLibInitEmptyString(&Directory);
+    FinalBackslash = YoriLibFindRightMostCharacter(&IniFile->FileName, '\\');
+    if (FinalBackslash == NULL) {
+        YoriLibConstantString(&Directory, _T("."));
+    } else {
+        Directory.StartOfString = IniFile->FileName.StartOfString;
+        Directory.LengthInChars = (YORI_ALLOC_SIZE_T)(FinalBackslash - IniFile->FileName.StartOfString);
+    }
+
+    YoriLibConstantString(&Prefix, _T("INI"));
+    if (!YoriLibGetTempFileName(&Directory, &Prefix, &hTempFile, &TempName)) {
+        YoriLibFreeStringContents(&Output);
+        return FALSE;
+    }
+
+    Result = YoriLibIniWriteEncoded(IniFile, hTempFile, &Output);
+    YoriLibFreeStringContents(&Output);
+
+    if (Result) {
+        Result = FlushFileBuffers(hTempFile);
+    }
+    CloseHandle(hTempFile);
+
+    if (Result) {
+        Result = MoveFileEx(TempName.StartOfString, IniFile->FileName.StartOfString, MOVEFILE_REPLACE_EXISTING);
+    }
+
+    if (!Result) {
+        DeleteFile(TempName.StartOfString);
+        YoriLibFreeStringContents(&TempName);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&TempName);
+    IniFile->Modified = FALSE;
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -4,7 +4,7 @@
  * Yori wrappers around Windows Job Object functionality.  Loads dynamically
  * to allow for fallback if the host OS doesn't support it.
  *
- * Copyright (c) 2017 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -61,6 +61,31 @@ YoriLibAssignProcessToJobObject(
     return DllKernel32.pAssignProcessToJobObject(hJob, hProcess);
 }
 
+/**
+ Load the basic limits currently applied to a job object, so that a new
+ limit can be added without discarding limits set previously.  If the limits
+ cannot be queried, the structure is initialized to specify no limits.
+
+ @param hJob Handle to the job object.
+
+ @param LimitInfo On completion, populated with the current limits.
+ */
+VOID
+YoriLibQueryJobObjectBasicLimits(
+    __in HANDLE hJob,
+    __out PYORI_JOB_BASIC_LIMIT_INFORMATION LimitInfo
+    )
+{
+    DWORD BytesReturned;
+
+    ZeroMemory(LimitInfo, sizeof(YORI_JOB_BASIC_LIMIT_INFORMATION));
+    if (DllKernel32.pQueryInformationJobObject != NULL) {
+        if (!DllKernel32.pQueryInformationJobObject(hJob, 2, LimitInfo, sizeof(YORI_JOB_BASIC_LIMIT_INFORMATION), &BytesReturned)) {
+            ZeroMemory(LimitInfo, sizeof(YORI_JOB_BASIC_LIMIT_INFORMATION));
+        }
+    }
+}
+
 /**
  Set the process priority to be used by a job object.  If this functionality
  is not supported by the host OS, returns FALSE.
@@ -77,10 +102,89 @@ YoriLibLimitJobObjectPriority(
     if (DllKernel32.pSetInformationJobObject == NULL) {
         return FALSE;
     }
-    ZeroMemory(&LimitInfo, sizeof(LimitInfo));
-    LimitInfo.Flags = 0x20;
+    YoriLibQueryJobObjectBasicLimits(hJob, &LimitInfo);
+    LimitInfo.Flags = LimitInfo.Flags | YORI_JOB_LIMIT_PRIORITY_CLASS;
     LimitInfo.Priority = Priority;
     return DllKernel32.pSetInformationJobObject(hJob, 2, &LimitInfo, sizeof(LimitInfo));
 }
 
+/**
+ Restrict the processors that processes within a job object can execute on.
+ Unlike thread or process affinity, this applies to every process that is
+ later launched within the job, so it can confine an entire process tree.
+ If this functionality is not supported by the host OS, returns FALSE.
+
+ @param hJob Handle to the job object.
+
+ @param Affinity Specifies the processor group and the set of processors
+        within that group.  If the group is nonzero, the job is assigned to
+        that group, which requires a system with processor group support.
+
+ @return TRUE on success, FALSE on failure.
+ */
+BOOL
+YoriLibLimitJobObjectAffinity(
+    __in HANDLE hJob,
+    __in PYORI_PROCESSOR_GROUP_AFFINITY Affinity
+    )
+{
+    YORI_JOB_BASIC_LIMIT_INFORMATION LimitInfo;
+    WORD Group;
+
+    if (DllKernel32.pSetInformationJobObject == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  Processes within a job can only be placed in a group other than the
+    //  default one if the job is assigned to it first.  Older systems don't
+    //  have groups, so only fail if a group was explicitly requested.
+    //
+
+    Group = Affinity->Group;
+    if (!DllKernel32.pSetInformationJobObject(hJob, YORI_JOB_GROUP_INFORMATION, &Group, sizeof(Group))) {
+        if (Affinity->Group != 0) {
+            return FALSE;
+        }
+    }
+
+    if (Affinity->Mask == 0) {
+        return TRUE;
+    }
+
+    YoriLibQueryJobObjectBasicLimits(hJob, &LimitInfo);
+    LimitInfo.Flags = LimitInfo.Flags | YORI_JOB_LIMIT_AFFINITY;
+    LimitInfo.Affinity = Affinity->Mask;
+    return DllKernel32.pSetInformationJobObject(hJob, 2, &LimitInfo, sizeof(LimitInfo));
+}
+
+/**
+ Associate a job object with a completion port, so that notifications about
+ processes within the job are queued to the port.  If this functionality is
+ not supported by the host OS, returns FALSE.
+
+ @param hJob Handle to the job object.
+
+ @param hPort Handle to the completion port.
+
+ @param Key The completion key to report with each notification.
+
+ @return TRUE on success, FALSE on failure.
+ */
+BOOL
+YoriLibAssociateJobObjectWithCompletionPort(
+    __in HANDLE hJob,
+    __in HANDLE hPort,
+    __in_opt PVOID Key
+    )
+{
+    YORI_JOB_ASSOCIATE_COMPLETION_PORT Port;
+    if (DllKernel32.pSetInformationJobObject == NULL) {
+        return FALSE;
+    }
+    Port.Key = Key;
+    Port.Port = hPort;
+    return DllKernel32.pSetInformationJobObject(hJob, JobObjectAssociateCompletionPortInformation, &Port, sizeof(Port));
+}
+
 // vim:sw=4:ts=4:et:
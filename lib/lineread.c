@@ -3,7 +3,7 @@
  *
  * Implementations for reading lines from files.
  *
- * Copyright (c) 2014-2020 Malcolm J. Smith
+ * Copyright (c) 2014-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -83,6 +83,73 @@ typedef struct _YORI_LIB_LINE_READ_CONTEXT {
      */
     BOOLEAN Terminated;
 
+    /**
+     If TRUE, a read has been issued to the read ahead thread and has not
+     yet been collected.
+     */
+    BOOLEAN ReadAheadPending;
+
+    /**
+     If TRUE, the read ahead thread should terminate when it is next
+     signalled.
+     */
+    BOOLEAN ReadAheadShutdown;
+
+    /**
+     If TRUE, the caller has requested that this context not use a read
+     ahead thread, so disk files are read synchronously.
+     */
+    BOOLEAN ReadAheadDisabled;
+
+    /**
+     A thread which reads the next chunk of a disk file while lines are
+     being returned from the current one.  This is NULL if read ahead is
+     not in use, and is retained along with its buffer if the context is
+     cached.
+     */
+    HANDLE ReadAheadThread;
+
+    /**
+     An event signalled to instruct the read ahead thread to perform a read.
+     */
+    HANDLE ReadAheadRequestEvent;
+
+    /**
+     An event signalled by the read ahead thread when a read has completed.
+     */
+    HANDLE ReadAheadCompleteEvent;
+
+    /**
+     The handle that the read ahead thread should read from.
+     */
+    HANDLE ReadAheadFileHandle;
+
+    /**
+     A buffer which the read ahead thread reads into.
+     */
+    PUCHAR ReadAheadBuffer;
+
+    /**
+     The size of ReadAheadBuffer, in bytes.
+     */
+    DWORD ReadAheadBufferLength;
+
+    /**
+     The number of bytes of valid data in ReadAheadBuffer.
+     */
+    DWORD ReadAheadBytesValid;
+
+    /**
+     The number of bytes in ReadAheadBuffer that have been moved into
+     PreviousBuffer.
+     */
+    DWORD ReadAheadBytesConsumed;
+
+    /**
+     The error returned from the most recent read ahead, or ERROR_SUCCESS.
+     */
+    DWORD ReadAheadError;
+
 } YORI_LIB_LINE_READ_CONTEXT, *PYORI_LIB_LINE_READ_CONTEXT;
 
 /**
@@ -181,6 +248,110 @@ YoriLibBytesInBom(
     return 0;
 }
 
+/**
+ A pointer sized value with the value one in every byte.
+ */
+#define YORI_LIB_LINE_READ_ONES_8 ((~(DWORD_PTR)0) / 0xFF)
+
+/**
+ A pointer sized value with the value one in every 16 bit word.
+ */
+#define YORI_LIB_LINE_READ_ONES_16 ((~(DWORD_PTR)0) / 0xFFFF)
+
+/**
+ Find the first carriage return or line feed in a buffer of 8 bit
+ characters.  Aligned pointer sized words are examined at a time, and only
+ words which contain a character below 0xE are examined character by
+ character.
+
+ @param Buffer Pointer to the buffer to search.
+
+ @param Length The number of characters in the buffer.
+
+ @return The offset of the first line break character, or Length if the
+         buffer does not contain one.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibLineReadFindBreakA(
+    __in PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T End;
+    DWORD_PTR Word;
+
+    Index = 0;
+    while (Index < Length) {
+        End = Index + 1;
+        if ((((DWORD_PTR)&Buffer[Index]) & (sizeof(DWORD_PTR) - 1)) == 0 &&
+            Length - Index >= sizeof(DWORD_PTR)) {
+
+            Word = *(DWORD_PTR *)&Buffer[Index];
+            if (((Word - YORI_LIB_LINE_READ_ONES_8 * 0xE) & ~Word & (YORI_LIB_LINE_READ_ONES_8 * 0x80)) == 0) {
+                Index = Index + sizeof(DWORD_PTR);
+                continue;
+            }
+            End = Index + sizeof(DWORD_PTR);
+        }
+
+        for (; Index < End; Index++) {
+            if (Buffer[Index] == 0xD || Buffer[Index] == 0xA) {
+                return Index;
+            }
+        }
+    }
+
+    return Length;
+}
+
+/**
+ Find the first carriage return or line feed in a buffer of 16 bit
+ characters.  Aligned pointer sized words are examined at a time, and only
+ words which contain a character below 0xE are examined character by
+ character.
+
+ @param Buffer Pointer to the buffer to search.
+
+ @param Length The number of characters in the buffer.
+
+ @return The offset of the first line break character, or Length if the
+         buffer does not contain one.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibLineReadFindBreakW(
+    __in PWCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T End;
+    DWORD_PTR Word;
+
+    Index = 0;
+    while (Index < Length) {
+        End = Index + 1;
+        if ((((DWORD_PTR)&Buffer[Index]) & (sizeof(DWORD_PTR) - 1)) == 0 &&
+            Length - Index >= sizeof(DWORD_PTR) / sizeof(WCHAR)) {
+
+            Word = *(DWORD_PTR *)&Buffer[Index];
+            if (((Word - YORI_LIB_LINE_READ_ONES_16 * 0xE) & ~Word & (YORI_LIB_LINE_READ_ONES_16 * 0x8000)) == 0) {
+                Index = Index + sizeof(DWORD_PTR) / sizeof(WCHAR);
+                continue;
+            }
+            End = Index + sizeof(DWORD_PTR) / sizeof(WCHAR);
+        }
+
+        for (; Index < End; Index++) {
+            if (Buffer[Index] == 0xD || Buffer[Index] == 0xA) {
+                return Index;
+            }
+        }
+    }
+
+    return Length;
+}
+
 /**
  The number of cached read line contexts to keep.
  */
@@ -314,9 +485,297 @@ YoriLibReadLineAllocateContext(VOID)
     }
     ReadContext->PreviousBuffer = NULL;
     ReadContext->LengthOfBuffer = 0;
+    ReadContext->ReadAheadPending = FALSE;
+    ReadContext->ReadAheadShutdown = FALSE;
+    ReadContext->ReadAheadThread = NULL;
+    ReadContext->ReadAheadRequestEvent = NULL;
+    ReadContext->ReadAheadCompleteEvent = NULL;
+    ReadContext->ReadAheadFileHandle = NULL;
+    ReadContext->ReadAheadBuffer = NULL;
+    ReadContext->ReadAheadBufferLength = 0;
     return ReadContext;
 }
 
+/**
+ A thread which performs reads on behalf of a line read context, so that the
+ next chunk of a file is being read while lines are returned from the
+ previous one.
+
+ @param Context Pointer to the line read context.
+
+ @return Exit code for the thread, currently always zero.
+ */
+DWORD WINAPI
+YoriLibLineReadAheadWorker(
+    __in LPVOID Context
+    )
+{
+    PYORI_LIB_LINE_READ_CONTEXT ReadContext;
+    DWORD BytesToRead;
+    DWORD BytesRead;
+
+    ReadContext = (PYORI_LIB_LINE_READ_CONTEXT)Context;
+
+    while (TRUE) {
+        WaitForSingleObject(ReadContext->ReadAheadRequestEvent, INFINITE);
+        if (ReadContext->ReadAheadShutdown) {
+            break;
+        }
+
+        BytesToRead = ReadContext->ReadAheadBufferLength;
+        while (TRUE) {
+            BytesRead = 0;
+            if (ReadFile(ReadContext->ReadAheadFileHandle, ReadContext->ReadAheadBuffer, BytesToRead, &BytesRead, NULL)) {
+                ReadContext->ReadAheadError = ERROR_SUCCESS;
+                break;
+            }
+
+            //
+            //  NT 3.1 can fail reads with NOT_ENOUGH_MEMORY if the buffer
+            //  is too large.  Work around this by shrinking the requested
+            //  number of bytes to read.
+            //
+
+            ReadContext->ReadAheadError = GetLastError();
+            if (ReadContext->ReadAheadError == ERROR_NOT_ENOUGH_MEMORY && BytesToRead > 16384) {
+                BytesToRead = 16384;
+                continue;
+            }
+
+            BytesRead = 0;
+            break;
+        }
+
+        ReadContext->ReadAheadBytesValid = BytesRead;
+        ReadContext->ReadAheadBytesConsumed = 0;
+        SetEvent(ReadContext->ReadAheadCompleteEvent);
+    }
+
+    return 0;
+}
+
+/**
+ Start the read ahead thread for a line read context, if it is not already
+ running, and allocate its buffer.  The buffer is sized to match the line
+ buffer when first allocated, and is retained if the context is cached.  If
+ this fails, the context continues to use synchronous reads.
+
+ @param ReadContext Pointer to the line read context.
+
+ @return TRUE if read ahead is available, FALSE if it is not.
+ */
+BOOLEAN
+YoriLibLineReadAheadStart(
+    __inout PYORI_LIB_LINE_READ_CONTEXT ReadContext
+    )
+{
+    DWORD ThreadId;
+
+    if (ReadContext->ReadAheadThread != NULL) {
+        return TRUE;
+    }
+
+    if (ReadContext->ReadAheadBuffer == NULL) {
+        ReadContext->ReadAheadBuffer = YoriLibMalloc(ReadContext->LengthOfBuffer);
+        if (ReadContext->ReadAheadBuffer == NULL) {
+            return FALSE;
+        }
+        ReadContext->ReadAheadBufferLength = ReadContext->LengthOfBuffer;
+    }
+
+    ReadContext->ReadAheadRequestEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (ReadContext->ReadAheadRequestEvent == NULL) {
+        return FALSE;
+    }
+
+    ReadContext->ReadAheadCompleteEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (ReadContext->ReadAheadCompleteEvent == NULL) {
+        CloseHandle(ReadContext->ReadAheadRequestEvent);
+        ReadContext->ReadAheadRequestEvent = NULL;
+        return FALSE;
+    }
+
+    ReadContext->ReadAheadShutdown = FALSE;
+    ReadContext->ReadAheadThread = CreateThread(NULL, 0, YoriLibLineReadAheadWorker, ReadContext, 0, &ThreadId);
+    if (ReadContext->ReadAheadThread == NULL) {
+        CloseHandle(ReadContext->ReadAheadRequestEvent);
+        CloseHandle(ReadContext->ReadAheadCompleteEvent);
+        ReadContext->ReadAheadRequestEvent = NULL;
+        ReadContext->ReadAheadCompleteEvent = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Wait for any read that has been issued to the read ahead thread to
+ complete, and discard its data.  This is used when the context is closed
+ or cached, because the caller is free to close the file handle afterwards.
+
+ @param ReadContext Pointer to the line read context.
+ */
+VOID
+YoriLibLineReadAheadQuiesce(
+    __inout PYORI_LIB_LINE_READ_CONTEXT ReadContext
+    )
+{
+    if (ReadContext->ReadAheadPending) {
+        WaitForSingleObject(ReadContext->ReadAheadCompleteEvent, INFINITE);
+        ReadContext->ReadAheadPending = FALSE;
+    }
+
+    ReadContext->ReadAheadBytesValid = 0;
+    ReadContext->ReadAheadBytesConsumed = 0;
+    ReadContext->ReadAheadError = ERROR_SUCCESS;
+    ReadContext->ReadAheadFileHandle = NULL;
+}
+
+/**
+ Fill a buffer with the next data from a file using the read ahead thread.
+ Data from a completed read ahead is copied into the caller's buffer, and
+ once it has all been consumed the next read is issued, so that it
+ proceeds while the caller parses the data it has been given.
+
+ @param ReadContext Pointer to the line read context.
+
+ @param FileHandle The handle to read from.
+
+ @param Buffer Pointer to the buffer to populate.
+
+ @param BytesToRead The size of Buffer, in bytes.
+
+ @param BytesRead On completion, set to the number of bytes placed in Buffer.
+        Zero indicates the end of the file.
+
+ @return ERROR_SUCCESS to indicate success, or the error from the read.
+ */
+DWORD
+YoriLibLineReadAheadFill(
+    __inout PYORI_LIB_LINE_READ_CONTEXT ReadContext,
+    __in HANDLE FileHandle,
+    __out_bcount(BytesToRead) PUCHAR Buffer,
+    __in DWORD BytesToRead,
+    __out PDWORD BytesRead
+    )
+{
+    DWORD BytesToCopy;
+
+    *BytesRead = 0;
+
+    //
+    //  If nothing is in flight and nothing is left over, this is the first
+    //  read of the file, so issue it now.
+    //
+
+    if (!ReadContext->ReadAheadPending &&
+        ReadContext->ReadAheadBytesConsumed == ReadContext->ReadAheadBytesValid) {
+
+        if (ReadContext->ReadAheadError != ERROR_SUCCESS) {
+            return ReadContext->ReadAheadError;
+        }
+
+        ReadContext->ReadAheadFileHandle = FileHandle;
+        ReadContext->ReadAheadPending = TRUE;
+        SetEvent(ReadContext->ReadAheadRequestEvent);
+    }
+
+    if (ReadContext->ReadAheadPending) {
+        WaitForSingleObject(ReadContext->ReadAheadCompleteEvent, INFINITE);
+        ReadContext->ReadAheadPending = FALSE;
+    }
+
+    BytesToCopy = ReadContext->ReadAheadBytesValid - ReadContext->ReadAheadBytesConsumed;
+    if (BytesToCopy == 0) {
+        return ReadContext->ReadAheadError;
+    }
+
+    if (BytesToCopy > BytesToRead) {
+        BytesToCopy = BytesToRead;
+    }
+
+    memcpy(Buffer, &ReadContext->ReadAheadBuffer[ReadContext->ReadAheadBytesConsumed], BytesToCopy);
+    ReadContext->ReadAheadBytesConsumed = ReadContext->ReadAheadBytesConsumed + BytesToCopy;
+    *BytesRead = BytesToCopy;
+
+    if (ReadContext->ReadAheadBytesConsumed == ReadContext->ReadAheadBytesValid &&
+        ReadContext->ReadAheadError == ERROR_SUCCESS) {
+
+        ReadContext->ReadAheadPending = TRUE;
+        SetEvent(ReadContext->ReadAheadRequestEvent);
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/**
+ Terminate the read ahead thread for a line read context and free its
+ resources.
+
+ @param ReadContext Pointer to the line read context.
+ */
+VOID
+YoriLibLineReadAheadStop(
+    __inout PYORI_LIB_LINE_READ_CONTEXT ReadContext
+    )
+{
+    if (ReadContext->ReadAheadThread != NULL) {
+        YoriLibLineReadAheadQuiesce(ReadContext);
+        ReadContext->ReadAheadShutdown = TRUE;
+        SetEvent(ReadContext->ReadAheadRequestEvent);
+        WaitForSingleObject(ReadContext->ReadAheadThread, INFINITE);
+        CloseHandle(ReadContext->ReadAheadThread);
+        CloseHandle(ReadContext->ReadAheadRequestEvent);
+        CloseHandle(ReadContext->ReadAheadCompleteEvent);
+        ReadContext->ReadAheadThread = NULL;
+        ReadContext->ReadAheadRequestEvent = NULL;
+        ReadContext->ReadAheadCompleteEvent = NULL;
+    }
+
+    if (ReadContext->ReadAheadBuffer != NULL) {
+        YoriLibFree(ReadContext->ReadAheadBuffer);
+        ReadContext->ReadAheadBuffer = NULL;
+        ReadContext->ReadAheadBufferLength = 0;
+    }
+}
+
+/**
+ Stop using a read ahead thread for a line read context, so that any further
+ reads from a disk file are performed synchronously.  This is useful for a
+ caller which keeps many contexts open to wait for small amounts of data to
+ be appended to files, where a thread per context is costly and reading
+ ahead has no benefit.  Any data which has been read ahead but not yet
+ consumed is returned to the file by moving the file pointer back.
+
+ @param Context Pointer to the line read context.  This can be NULL if no
+        line has been read yet.
+ */
+VOID
+YoriLibLineReadDisableReadAhead(
+    __in_opt PVOID Context
+    )
+{
+    PYORI_LIB_LINE_READ_CONTEXT ReadContext = (PYORI_LIB_LINE_READ_CONTEXT)Context;
+    LONG BytesUnconsumed;
+
+    if (ReadContext == NULL) {
+        return;
+    }
+
+    ReadContext->ReadAheadDisabled = TRUE;
+    if (ReadContext->ReadAheadPending) {
+        WaitForSingleObject(ReadContext->ReadAheadCompleteEvent, INFINITE);
+        ReadContext->ReadAheadPending = FALSE;
+    }
+
+    BytesUnconsumed = (LONG)(ReadContext->ReadAheadBytesValid - ReadContext->ReadAheadBytesConsumed);
+    if (BytesUnconsumed > 0 && ReadContext->ReadAheadFileHandle != NULL) {
+        SetFilePointer(ReadContext->ReadAheadFileHandle, -1 * BytesUnconsumed, NULL, FILE_CURRENT);
+    }
+
+    YoriLibLineReadAheadStop(ReadContext);
+}
+
 /**
  Close a line read context, and store it in the cache if there is an
  available slot for it.  After using this routine, a caller is expected to
@@ -329,6 +788,10 @@ YoriLibLineReadCloseOrCache(
     __in_opt PVOID Context
     )
 {
+    if (Context != NULL) {
+        YoriLibLineReadAheadQuiesce((PYORI_LIB_LINE_READ_CONTEXT)Context);
+    }
+
     if (YoriLibIsInterlockedCompareExchangePointerAvailable()) {
         PYORI_LIB_LINE_READ_CONTEXT ReadContext = (PYORI_LIB_LINE_READ_CONTEXT)Context;
         PYORI_LIB_LINE_READ_CONTEXT OldContext;
@@ -467,6 +930,11 @@ YoriLibReadLineToStringEx(
             ReadContext->ReadWChars = FALSE;
         }
         ReadContext->Terminated = FALSE;
+        ReadContext->ReadAheadBytesValid = 0;
+        ReadContext->ReadAheadBytesConsumed = 0;
+        ReadContext->ReadAheadError = ERROR_SUCCESS;
+        ReadContext->ReadAheadDisabled = FALSE;
+        ASSERT(!ReadContext->ReadAheadPending);
     } else {
         ReadContext = *Context;
         if (ReadContext->Terminated) {
@@ -518,6 +986,11 @@ YoriLibReadLineToStringEx(
             PWCHAR WideBuffer = (PWCHAR)YoriLibAddToPointer(ReadContext->PreviousBuffer, ReadContext->CurrentBufferOffset);
             CharsRemaining = (ReadContext->BytesInBuffer - ReadContext->CurrentBufferOffset) / sizeof(WCHAR);
             for (Count = 0; Count < CharsRemaining; Count++) {
+                Count = Count + YoriLibLineReadFindBreakW(&WideBuffer[Count], CharsRemaining - Count);
+                if (Count == CharsRemaining) {
+                    break;
+                }
+
                 if (WideBuffer[Count] == 0xD ||
                     WideBuffer[Count] == 0xA) {
 
@@ -569,6 +1042,10 @@ YoriLibReadLineToStringEx(
             PUCHAR Buffer = YoriLibAddToPointer(ReadContext->PreviousBuffer, ReadContext->CurrentBufferOffset);
             CharsRemaining = ReadContext->BytesInBuffer - ReadContext->CurrentBufferOffset;
             for (Count = 0; Count < CharsRemaining; Count++) {
+                Count = Count + YoriLibLineReadFindBreakA(&Buffer[Count], CharsRemaining - Count);
+                if (Count == CharsRemaining) {
+                    break;
+                }
 
                 if (Buffer[Count] == 0xD ||
                     Buffer[Count] == 0xA) {
@@ -739,27 +1216,56 @@ YoriLibReadLineToStringEx(
             BytesToRead = ReadContext->LengthOfBuffer - ReadContext->BytesInBuffer;
             LastError = ERROR_SUCCESS;
 
-            while(TRUE) {
-                if (ReadFile(FileHandle, YoriLibAddToPointer(ReadContext->PreviousBuffer, ReadContext->BytesInBuffer), BytesToRead, &BytesRead, NULL)) {
-                    LastError = ERROR_SUCCESS;
-                    break;
-                }
+            YoriLibTraceBegin(YORI_LIB_TRACE_LINEREAD, _T("LineRead"), NULL, BytesToRead);
+
+            //
+            //  For disk files, let a second thread read the next chunk while
+            //  this one is parsing lines.  If that can't be set up, fall
+            //  back to reading synchronously.
+            //
+
+            if (ReadContext->FileType == FILE_TYPE_DISK &&
+                !ReadContext->ReadAheadDisabled &&
+                YoriLibLineReadAheadStart(ReadContext)) {
+
+                LastError = YoriLibLineReadAheadFill(ReadContext,
+                                                     FileHandle,
+                                                     YoriLibAddToPointer(ReadContext->PreviousBuffer, ReadContext->BytesInBuffer),
+                                                     BytesToRead,
+                                                     &BytesRead);
+            } else {
 
                 //
-                //  NT 3.1 can fail reads with NOT_ENOUGH_MEMORY if the buffer
-                //  is too large.  Work around this by shrinking the requested
-                //  number of bytes to read.
+                //  Input may depend on output that has been generated, so
+                //  make sure it has been written before waiting.
                 //
 
-                LastError = GetLastError();
-                if (LastError == ERROR_NOT_ENOUGH_MEMORY && BytesToRead > 16384) {
-                    BytesToRead = 16384;
-                    continue;
-                }
+                YoriLibFlushOutput();
 
-                break;
+                while(TRUE) {
+                    if (ReadFile(FileHandle, YoriLibAddToPointer(ReadContext->PreviousBuffer, ReadContext->BytesInBuffer), BytesToRead, &BytesRead, NULL)) {
+                        LastError = ERROR_SUCCESS;
+                        break;
+                    }
+
+                    //
+                    //  NT 3.1 can fail reads with NOT_ENOUGH_MEMORY if the
+                    //  buffer is too large.  Work around this by shrinking
+                    //  the requested number of bytes to read.
+                    //
+
+                    LastError = GetLastError();
+                    if (LastError == ERROR_NOT_ENOUGH_MEMORY && BytesToRead > 16384) {
+                        BytesToRead = 16384;
+                        continue;
+                    }
+
+                    break;
+                }
             }
 
+            YoriLibTraceEnd(YORI_LIB_TRACE_LINEREAD, _T("LineRead"), NULL, BytesRead);
+
             if (LastError != ERROR_SUCCESS) {
 #if DBG
                 //
@@ -865,6 +1371,124 @@ YoriLibReadLineToString(
     return YoriLibReadLineToStringEx(UserString, Context, TRUE, INFINITE, FileHandle, &LineEnding, &TimeoutReached);
 }
 
+/**
+ Return lines which are already in the line reader's buffer as spans within
+ that buffer, without copying or converting them.  This allows callers
+ processing large volumes of text to consume many lines per call.  If no
+ complete lines are buffered, this returns zero, and the caller should call
+ @ref YoriLibReadLineToStringEx to read the next line, which will also
+ refill the buffer.  Lines are never returned from here until the first
+ line has been read via @ref YoriLibReadLineToStringEx , so that it can
+ remove any byte order mark.
+
+ @param Context Pointer to the line read context, which may be NULL if no
+        lines have been read yet.
+
+ @param Spans On successful completion, populated with a description of each
+        line found.  These point into the line reader's buffer and are only
+        valid until the next call to read from this context.
+
+ @param MaximumSpans The number of elements in the Spans array.
+
+ @param WideChars On successful completion, set to TRUE to indicate the
+        spans contain 16 bit characters, or FALSE to indicate they contain
+        8 bit characters in the input encoding.
+
+ @return The number of spans populated.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibReadLineGetBufferedSpans(
+    __in_opt PVOID Context,
+    __out_ecount(MaximumSpans) PYORI_LIB_LINE_SPAN Spans,
+    __in YORI_ALLOC_SIZE_T MaximumSpans,
+    __out PBOOLEAN WideChars
+    )
+{
+    PYORI_LIB_LINE_READ_CONTEXT ReadContext;
+    YORI_ALLOC_SIZE_T SpanCount;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T CharSize;
+    YORI_ALLOC_SIZE_T CharsRemaining;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    WCHAR BreakChar;
+    WCHAR NextChar;
+    PVOID StartOfLine;
+
+    ReadContext = (PYORI_LIB_LINE_READ_CONTEXT)Context;
+    *WideChars = FALSE;
+    if (ReadContext == NULL ||
+        ReadContext->Terminated ||
+        ReadContext->LinesRead == 0) {
+
+        return 0;
+    }
+
+    *WideChars = ReadContext->ReadWChars;
+    CharSize = 1;
+    if (ReadContext->ReadWChars) {
+        CharSize = sizeof(WCHAR);
+    }
+
+    SpanCount = 0;
+    Offset = ReadContext->CurrentBufferOffset;
+    while (SpanCount < MaximumSpans) {
+        StartOfLine = YoriLibAddToPointer(ReadContext->PreviousBuffer, Offset);
+        CharsRemaining = (ReadContext->BytesInBuffer - Offset) / CharSize;
+        NextChar = 0;
+        if (ReadContext->ReadWChars) {
+            Count = YoriLibLineReadFindBreakW(StartOfLine, CharsRemaining);
+            if (Count == CharsRemaining) {
+                break;
+            }
+            BreakChar = ((PWCHAR)StartOfLine)[Count];
+            if (Count + 1 < CharsRemaining) {
+                NextChar = ((PWCHAR)StartOfLine)[Count + 1];
+            }
+        } else {
+            Count = YoriLibLineReadFindBreakA(StartOfLine, CharsRemaining);
+            if (Count == CharsRemaining) {
+                break;
+            }
+            BreakChar = ((PUCHAR)StartOfLine)[Count];
+            if (Count + 1 < CharsRemaining) {
+                NextChar = ((PUCHAR)StartOfLine)[Count + 1];
+            }
+        }
+
+        //
+        //  A carriage return at the end of the buffer may be followed by a
+        //  line feed that hasn't been read yet, so leave it for the regular
+        //  line reader.
+        //
+
+        Spans[SpanCount].StartOfLine = StartOfLine;
+        Spans[SpanCount].LengthInChars = Count;
+        if (BreakChar == 0xD) {
+            if (Count + 1 == CharsRemaining) {
+                break;
+            }
+            if (NextChar == 0xA) {
+                Spans[SpanCount].LineEnding = YoriLibLineEndingCRLF;
+                CharsConsumed = Count + 2;
+            } else {
+                Spans[SpanCount].LineEnding = YoriLibLineEndingCR;
+                CharsConsumed = Count + 1;
+            }
+        } else {
+            Spans[SpanCount].LineEnding = YoriLibLineEndingLF;
+            CharsConsumed = Count + 1;
+        }
+
+        Offset = Offset + CharsConsumed * CharSize;
+        SpanCount++;
+    }
+
+    ReadContext->CurrentBufferOffset = Offset;
+    ReadContext->LinesRead = ReadContext->LinesRead + SpanCount;
+    return SpanCount;
+}
+
 /**
  Free any context allocated by YoriLibReadLineFromFile .
 
@@ -877,6 +1501,7 @@ YoriLibLineReadClose(
 {
     PYORI_LIB_LINE_READ_CONTEXT ReadContext = (PYORI_LIB_LINE_READ_CONTEXT)Context;
     if (ReadContext != NULL) {
+        YoriLibLineReadAheadStop(ReadContext);
         if (ReadContext->PreviousBuffer != NULL) {
             YoriLibFree(ReadContext->PreviousBuffer);
         }
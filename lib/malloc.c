@@ -88,6 +88,21 @@ typedef struct _YORI_SPECIAL_HEAP_HEADER {
      */
     DWORD ReservedForAlignment;
 
+#if YORI_HEAP_PROFILE
+    /**
+     The index of the call site within the profile table that made this
+     allocation.
+     */
+    DWORD ProfileSite;
+
+    /**
+     The number of allocations made in the process when this allocation was
+     made.  This allows the lifetime of the allocation to be measured in
+     allocations when it is freed.
+     */
+    DWORD ProfileAllocationNumber;
+#endif
+
     /**
      This structure may be followed by the stack that allocated this
      allocation.
@@ -95,6 +110,86 @@ typedef struct _YORI_SPECIAL_HEAP_HEADER {
 
 } YORI_SPECIAL_HEAP_HEADER, *PYORI_SPECIAL_HEAP_HEADER;
 
+#if YORI_HEAP_PROFILE
+
+/**
+ The number of distinct call sites that can be profiled.  This must be a
+ power of two.  Once the table is three quarters full, further call sites are
+ accumulated into a single overflow entry.
+ */
+#define YORI_HEAP_PROFILE_SITES (2048)
+
+/**
+ The number of buckets in the lifetime histogram.  Each bucket covers sixteen
+ times the range of the previous bucket, so eight buckets cover any 32 bit
+ lifetime.
+ */
+#define YORI_HEAP_PROFILE_LIFETIME_BUCKETS (8)
+
+/**
+ Allocation statistics for a single call site.
+ */
+typedef struct _YORI_HEAP_PROFILE_SITE {
+
+    /**
+     The function that allocated the memory.  NULL if this entry is not in
+     use.
+     */
+    LPCSTR Function;
+
+    /**
+     The source file that allocated the memory.
+     */
+    LPCSTR File;
+
+    /**
+     The line number that allocated the memory.
+     */
+    DWORD Line;
+
+    /**
+     The number of allocations made by this call site.
+     */
+    DWORD Allocations;
+
+    /**
+     The number of allocations made by this call site that have been freed.
+     */
+    DWORD Frees;
+
+    /**
+     The number of bytes allocated by this call site that are currently
+     allocated.
+     */
+    DWORD BytesLive;
+
+    /**
+     The largest value that BytesLive has reached.
+     */
+    DWORD PeakBytesLive;
+
+    /**
+     An extra 32 bits to keep BytesAllocated 64 bit aligned.
+     */
+    DWORD ReservedForAlignment;
+
+    /**
+     The total number of bytes ever allocated by this call site.
+     */
+    DWORDLONG BytesAllocated;
+
+    /**
+     A histogram of allocation lifetimes, measured in the number of other
+     allocations made while each allocation was live.  Bucket zero counts
+     allocations freed before sixteen other allocations were made, bucket
+     one before 256, and so on.
+     */
+    DWORD Lifetime[YORI_HEAP_PROFILE_LIFETIME_BUCKETS];
+
+} YORI_HEAP_PROFILE_SITE, *PYORI_HEAP_PROFILE_SITE;
+
+#endif
+
 /**
  A structure containing process global state for the special heap allocator.
  */
@@ -133,6 +228,33 @@ typedef struct _YORI_SPECIAL_HEAP_GLOBAL {
      */
     HANDLE Mutex;
 
+#if YORI_HEAP_PROFILE
+    /**
+     The number of entries in ProfileSites that are in use, excluding the
+     overflow entry.
+     */
+    DWORD ProfileSitesInUse;
+
+    /**
+     The largest value that BytesCurrentlyAllocated has reached.
+     */
+    DWORD PeakBytesAllocated;
+
+    /**
+     Statistics for each call site, indexed by a hash of the call site.  The
+     final entry is used for call sites that could not be inserted into the
+     table.
+     */
+    YORI_HEAP_PROFILE_SITE ProfileSites[YORI_HEAP_PROFILE_SITES + 1];
+
+    /**
+     Scratch space used to sort call sites when generating a report.  This
+     is kept here so that reporting does not need to allocate memory from
+     the heap that it is reporting on.
+     */
+    DWORD ProfileSortedSites[YORI_HEAP_PROFILE_SITES + 1];
+#endif
+
 } YORI_SPECIAL_HEAP_GLOBAL, PYORI_SPECIAL_HEAP_GLOBAL;
 
 /**
@@ -140,6 +262,129 @@ typedef struct _YORI_SPECIAL_HEAP_GLOBAL {
  */
 YORI_SPECIAL_HEAP_GLOBAL YoriLibSpecialHeap;
 
+#if YORI_HEAP_PROFILE
+
+/**
+ Find the profile entry for a call site, inserting it if it has not been
+ seen before.  This is called with the special heap mutex held.
+
+ @param Function Pointer to a constant string indicating the function that is
+        allocating the memory.
+
+ @param File Pointer to a constant string indicating the source file that is
+        allocating the memory.
+
+ @param Line Specifies the line number within the source file that is
+        allocating the memory.
+
+ @return The index of the call site within the profile table.
+ */
+DWORD
+YoriLibHeapProfileFindSite(
+    __in LPCSTR Function,
+    __in LPCSTR File,
+    __in DWORD Line
+    )
+{
+    PYORI_HEAP_PROFILE_SITE Site;
+    DWORD Index;
+
+    //
+    //  The file name is a string literal, so its address is as good a key
+    //  as its contents.  Low bits are discarded since they are often zero
+    //  due to alignment.
+    //
+
+    Index = (DWORD)(((DWORD_PTR)File >> 3) * 0x9E3779B1) ^ (Line * 0x85EBCA6B);
+    Index = Index ^ (Index >> 16);
+    Index = Index & (YORI_HEAP_PROFILE_SITES - 1);
+
+    while (TRUE) {
+        Site = &YoriLibSpecialHeap.ProfileSites[Index];
+        if (Site->Function == NULL) {
+            if (YoriLibSpecialHeap.ProfileSitesInUse >= YORI_HEAP_PROFILE_SITES / 4 * 3) {
+                return YORI_HEAP_PROFILE_SITES;
+            }
+            Site->Function = Function;
+            Site->File = File;
+            Site->Line = Line;
+            YoriLibSpecialHeap.ProfileSitesInUse++;
+            return Index;
+        }
+
+        if (Site->File == File && Site->Line == Line) {
+            return Index;
+        }
+
+        Index = (Index + 1) & (YORI_HEAP_PROFILE_SITES - 1);
+    }
+}
+
+/**
+ Record an allocation against its call site.  This is called with the
+ special heap mutex held.
+
+ @param Header Pointer to the header of the new allocation.
+
+ @param Bytes The number of bytes allocated, from the user's perspective.
+ */
+VOID
+YoriLibHeapProfileRecordAlloc(
+    __in PYORI_SPECIAL_HEAP_HEADER Header,
+    __in DWORD Bytes
+    )
+{
+    PYORI_HEAP_PROFILE_SITE Site;
+
+    Header->ProfileSite = YoriLibHeapProfileFindSite(Header->Function, Header->File, Header->Line);
+    Header->ProfileAllocationNumber = YoriLibSpecialHeap.NumberAllocated;
+
+    Site = &YoriLibSpecialHeap.ProfileSites[Header->ProfileSite];
+    Site->Allocations++;
+    Site->BytesAllocated += Bytes;
+    Site->BytesLive += Bytes;
+    if (Site->BytesLive > Site->PeakBytesLive) {
+        Site->PeakBytesLive = Site->BytesLive;
+    }
+
+    if (YoriLibSpecialHeap.BytesCurrentlyAllocated > YoriLibSpecialHeap.PeakBytesAllocated) {
+        YoriLibSpecialHeap.PeakBytesAllocated = YoriLibSpecialHeap.BytesCurrentlyAllocated;
+    }
+}
+
+/**
+ Record the free of an allocation against the call site that allocated it.
+ This is called with the special heap mutex held.
+
+ @param Header Pointer to the header of the allocation being freed.
+
+ @param Bytes The number of bytes being freed, from the user's perspective.
+ */
+VOID
+YoriLibHeapProfileRecordFree(
+    __in PYORI_SPECIAL_HEAP_HEADER Header,
+    __in DWORD Bytes
+    )
+{
+    PYORI_HEAP_PROFILE_SITE Site;
+    DWORD Lifetime;
+    DWORD Bucket;
+
+    Site = &YoriLibSpecialHeap.ProfileSites[Header->ProfileSite];
+    Site->Frees++;
+    Site->BytesLive -= Bytes;
+
+    Lifetime = YoriLibSpecialHeap.NumberAllocated - Header->ProfileAllocationNumber;
+    Bucket = 0;
+    while (Lifetime >= 16 && Bucket < YORI_HEAP_PROFILE_LIFETIME_BUCKETS - 1) {
+        Lifetime = Lifetime >> 4;
+        Bucket++;
+    }
+    Site->Lifetime[Bucket]++;
+}
+
+#endif
+
 #endif
 
 #if !YORI_SPECIAL_HEAP
@@ -261,6 +506,9 @@ YoriLibMallocSpecialHeap(
     YoriLibSpecialHeap.NumberAllocated++;
     YoriLibSpecialHeap.BytesCurrentlyAllocated += (Bytes + Alignment - 1) & ~(Alignment - 1);
     YoriLibAppendList(&YoriLibSpecialHeap.ActiveAllocationsList, &Header->ListEntry);
+#if YORI_HEAP_PROFILE
+    YoriLibHeapProfileRecordAlloc(Header, (Bytes + Alignment - 1) & ~(Alignment - 1));
+#endif
     ReleaseMutex(YoriLibSpecialHeap.Mutex);
 
     return (PUCHAR)Header + Header->OffsetToData;
@@ -315,6 +563,9 @@ YoriLibFree(
     YoriLibSpecialHeap.NumberFreed++;
     YoriLibSpecialHeap.BytesCurrentlyAllocated -= BytesToFree;
     YoriLibRemoveListItem(&Header->ListEntry);
+#if YORI_HEAP_PROFILE
+    YoriLibHeapProfileRecordFree(Header, BytesToFree);
+#endif
 
     if (YoriLibSpecialHeap.RecentlyFreed[MyEntry] != NULL) {
 
@@ -344,6 +595,96 @@ YoriLibFree(
 #endif
 }
 
+/**
+ When using heap profiling, display allocation statistics for each call site,
+ sorted by the total number of bytes allocated.  When heap profiling is not
+ present, does nothing.  This can be called at any time, including from a
+ Ctrl+Break handler.
+ */
+VOID
+YoriLibDisplayHeapProfile(VOID)
+{
+#if YORI_HEAP_PROFILE
+    PYORI_HEAP_PROFILE_SITE Site;
+    PYORI_HEAP_PROFILE_SITE CompareSite;
+    DWORD SiteCount;
+    DWORD Index;
+    DWORD InsertIndex;
+    DWORD SiteIndex;
+
+    if (YoriLibSpecialHeap.Mutex == NULL) {
+        return;
+    }
+
+    WaitForSingleObject(YoriLibSpecialHeap.Mutex, INFINITE);
+
+    //
+    //  Insertion sort the sites in use by bytes allocated, largest first.
+    //  This is called rarely and the table is small, and sorting in place
+    //  avoids allocating from the heap being reported on.
+    //
+
+    SiteCount = 0;
+    for (SiteIndex = 0; SiteIndex <= YORI_HEAP_PROFILE_SITES; SiteIndex++) {
+        Site = &YoriLibSpecialHeap.ProfileSites[SiteIndex];
+        if (Site->Allocations == 0) {
+            continue;
+        }
+
+        InsertIndex = SiteCount;
+        while (InsertIndex > 0) {
+            CompareSite = &YoriLibSpecialHeap.ProfileSites[YoriLibSpecialHeap.ProfileSortedSites[InsertIndex - 1]];
+            if (CompareSite->BytesAllocated >= Site->BytesAllocated) {
+                break;
+            }
+            YoriLibSpecialHeap.ProfileSortedSites[InsertIndex] = YoriLibSpecialHeap.ProfileSortedSites[InsertIndex - 1];
+            InsertIndex--;
+        }
+        YoriLibSpecialHeap.ProfileSortedSites[InsertIndex] = SiteIndex;
+        SiteCount++;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                  _T("Heap profile: %i allocations from %i call sites, peak %i bytes allocated\n"),
+                  YoriLibSpecialHeap.NumberAllocated,
+                  SiteCount,
+                  YoriLibSpecialHeap.PeakBytesAllocated);
+
+    for (Index = 0; Index < SiteCount; Index++) {
+        SiteIndex = YoriLibSpecialHeap.ProfileSortedSites[Index];
+        Site = &YoriLibSpecialHeap.ProfileSites[SiteIndex];
+        if (SiteIndex == YORI_HEAP_PROFILE_SITES) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("(other call sites)\n"));
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                          _T("%hs (%hs:%i)\n"),
+                          Site->Function,
+                          Site->File,
+                          Site->Line);
+        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                      _T("    %lli bytes in %i allocations, %i freed, %i bytes live, %i bytes peak\n"),
+                      Site->BytesAllocated,
+                      Site->Allocations,
+                      Site->Frees,
+                      Site->BytesLive,
+                      Site->PeakBytesLive);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                      _T("    lifetime <16:%i <256:%i <4K:%i <64K:%i <1M:%i <16M:%i <256M:%i more:%i\n"),
+                      Site->Lifetime[0],
+                      Site->Lifetime[1],
+                      Site->Lifetime[2],
+                      Site->Lifetime[3],
+                      Site->Lifetime[4],
+                      Site->Lifetime[5],
+                      Site->Lifetime[6],
+                      Site->Lifetime[7]);
+    }
+
+    ReleaseMutex(YoriLibSpecialHeap.Mutex);
+#endif
+}
+
 /**
  When using memory debugging, display the number of bytes of allocation and
  number of allocations currently in use.  When memory debugging is not present,
@@ -354,6 +695,11 @@ YoriLibDisplayMemoryUsage(VOID)
 {
 #if YORI_SPECIAL_HEAP
     YORI_ALLOC_SIZE_T PageSize;
+
+#if YORI_HEAP_PROFILE
+    YoriLibDisplayHeapProfile();
+#endif
+
     PageSize = YoriLibGetPageSize();
     if (YoriLibSpecialHeap.BytesCurrentlyAllocated > 0 ||
         (YoriLibSpecialHeap.NumberAllocated - YoriLibSpecialHeap.NumberFreed > 0)) {
@@ -0,0 +1,688 @@
+/**
+ * @file lib/mftenum.c
+ *
+ * Yori enumerate file records from an NTFS master file table
+ *
+ * Copyright (c) 2024 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+
+/**
+ The number of bytes protected by each entry in a file record's update
+ sequence array.  This is fixed by the on disk format regardless of the
+ sector size of the device.
+ */
+#define YORI_LIB_MFT_FIXUP_STRIDE (512)
+
+/**
+ The number of bytes to read from the MFT in each request.
+ */
+#define YORI_LIB_MFT_READ_SIZE (1024 * 1024)
+
+/**
+ A single contiguous range of clusters containing part of the MFT.
+ */
+typedef struct _YORI_LIB_MFT_EXTENT {
+
+    /**
+     The first cluster on the volume containing this part of the MFT.
+     */
+    LONGLONG Lcn;
+
+    /**
+     The number of clusters in this part of the MFT.
+     */
+    LONGLONG ClusterCount;
+} YORI_LIB_MFT_EXTENT, *PYORI_LIB_MFT_EXTENT;
+
+/**
+ Open the volume hosting a file for the purpose of reading its MFT, and
+ query the NTFS parameters of the volume.  This requires the caller to be
+ able to read the volume directly, which normally requires an elevated
+ caller.
+
+ @param FilePath Pointer to a fully specified, escaped path to a file on the
+        volume.
+
+ @param VolumeData On successful completion, populated with information
+        about the NTFS volume.
+
+ @return A handle to the volume, or INVALID_HANDLE_VALUE on failure, with
+         last error set to indicate the reason.
+ */
+HANDLE
+YoriLibMftOpenVolume(
+    __in PYORI_STRING FilePath,
+    __out PNTFS_VOLUME_DATA_BUFFER VolumeData
+    )
+{
+    YORI_STRING VolumeName;
+    HANDLE VolumeHandle;
+    DWORD BytesReturned;
+    DWORD Err;
+
+    YoriLibInitEmptyString(&VolumeName);
+    if (!YoriLibGetVolumePathName(FilePath, &VolumeName)) {
+        if (GetLastError() == ERROR_SUCCESS) {
+            SetLastError(ERROR_INVALID_NAME);
+        }
+        return INVALID_HANDLE_VALUE;
+    }
+
+    VolumeHandle = CreateFile(VolumeName.StartOfString,
+                              FILE_READ_DATA | FILE_READ_ATTRIBUTES | SYNCHRONIZE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL,
+                              OPEN_EXISTING,
+                              FILE_FLAG_BACKUP_SEMANTICS,
+                              NULL);
+
+    Err = GetLastError();
+    YoriLibFreeStringContents(&VolumeName);
+
+    if (VolumeHandle == INVALID_HANDLE_VALUE) {
+        SetLastError(Err);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    if (!DeviceIoControl(VolumeHandle,
+                         FSCTL_GET_NTFS_VOLUME_DATA,
+                         NULL,
+                         0,
+                         VolumeData,
+                         sizeof(NTFS_VOLUME_DATA_BUFFER),
+                         &BytesReturned,
+                         NULL)) {
+
+        Err = GetLastError();
+        CloseHandle(VolumeHandle);
+        SetLastError(Err);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    //
+    //  Check the parameters are ones this code knows how to handle.  File
+    //  records must be a whole number of fixup blocks and sectors, and
+    //  clusters must be a whole number of sectors.
+    //
+
+    if (VolumeData->BytesPerFileRecordSegment < sizeof(YORI_LIB_NTFS_FILE_RECORD) ||
+        VolumeData->BytesPerFileRecordSegment > YORI_LIB_MFT_READ_SIZE / 2 ||
+        (VolumeData->BytesPerFileRecordSegment % YORI_LIB_MFT_FIXUP_STRIDE) != 0 ||
+        VolumeData->BytesPerSector == 0 ||
+        (VolumeData->BytesPerFileRecordSegment % VolumeData->BytesPerSector) != 0 ||
+        VolumeData->BytesPerCluster == 0 ||
+        (VolumeData->BytesPerCluster % VolumeData->BytesPerSector) != 0 ||
+        (YORI_LIB_MFT_READ_SIZE % VolumeData->BytesPerSector) != 0) {
+
+        CloseHandle(VolumeHandle);
+        SetLastError(ERROR_NOT_SUPPORTED);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    return VolumeHandle;
+}
+
+/**
+ Apply the update sequence array to a file record read from disk, which
+ restores the final two bytes of each block and verifies that the record
+ was written completely.
+
+ @param FileRecord Pointer to the file record.
+
+ @param RecordLength The length of the file record, in bytes.
+
+ @return TRUE if the record is valid and has been updated, FALSE if the
+         record is not valid.
+ */
+BOOLEAN
+YoriLibMftApplyFixups(
+    __inout PYORI_LIB_NTFS_FILE_RECORD FileRecord,
+    __in DWORD RecordLength
+    )
+{
+    PWORD UpdateSequenceArray;
+    PWORD BlockEnd;
+    DWORD Index;
+    DWORD Count;
+
+    Count = FileRecord->UpdateSequenceArraySize;
+    if (Count == 0 ||
+        Count - 1 != RecordLength / YORI_LIB_MFT_FIXUP_STRIDE ||
+        (FileRecord->UpdateSequenceArrayOffset & 1) != 0 ||
+        FileRecord->UpdateSequenceArrayOffset + Count * sizeof(WORD) > RecordLength) {
+
+        return FALSE;
+    }
+
+    UpdateSequenceArray = (PWORD)YoriLibAddToPointer(FileRecord, FileRecord->UpdateSequenceArrayOffset);
+    for (Index = 1; Index < Count; Index++) {
+        BlockEnd = (PWORD)YoriLibAddToPointer(FileRecord, Index * YORI_LIB_MFT_FIXUP_STRIDE - sizeof(WORD));
+        if (*BlockEnd != UpdateSequenceArray[0]) {
+            return FALSE;
+        }
+        *BlockEnd = UpdateSequenceArray[Index];
+    }
+
+    return TRUE;
+}
+
+/**
+ Return the next attribute within a file record.
+
+ @param FileRecord Pointer to the file record.  Fixups must already have
+        been applied.
+
+ @param RecordLength The length of the file record, in bytes.
+
+ @param PreviousAttribute Pointer to the previously returned attribute, or
+        NULL to return the first attribute in the record.
+
+ @return Pointer to the next attribute, or NULL if there are no more
+         attributes or the record is not well formed.
+ */
+PYORI_LIB_NTFS_ATTRIBUTE
+YoriLibMftGetNextAttribute(
+    __in PYORI_LIB_NTFS_FILE_RECORD FileRecord,
+    __in DWORD RecordLength,
+    __in_opt PYORI_LIB_NTFS_ATTRIBUTE PreviousAttribute
+    )
+{
+    PYORI_LIB_NTFS_ATTRIBUTE Attribute;
+    DWORD Offset;
+    DWORD Limit;
+
+    Limit = RecordLength;
+    if (FileRecord->BytesInUse < Limit) {
+        Limit = FileRecord->BytesInUse;
+    }
+
+    if (PreviousAttribute == NULL) {
+        Offset = FileRecord->FirstAttributeOffset;
+    } else {
+        Offset = (DWORD)((PUCHAR)PreviousAttribute - (PUCHAR)FileRecord) + PreviousAttribute->RecordLength;
+    }
+
+    if (Offset + sizeof(DWORD) > Limit || (Offset & 7) != 0) {
+        return NULL;
+    }
+
+    Attribute = (PYORI_LIB_NTFS_ATTRIBUTE)YoriLibAddToPointer(FileRecord, Offset);
+    if (Attribute->TypeCode == YORI_LIB_NTFS_ATTRIBUTE_END) {
+        return NULL;
+    }
+
+    //
+    //  Every attribute must at least contain a resident header and fit
+    //  within the record, or the record is not well formed.
+    //
+
+    if (Offset + FIELD_OFFSET(YORI_LIB_NTFS_ATTRIBUTE, Form.Resident.ResidentFlags) > Limit ||
+        Attribute->RecordLength < FIELD_OFFSET(YORI_LIB_NTFS_ATTRIBUTE, Form.Resident.ResidentFlags) ||
+        Attribute->RecordLength > Limit - Offset) {
+
+        return NULL;
+    }
+
+    if (Attribute->FormCode != YORI_LIB_NTFS_ATTRIBUTE_RESIDENT &&
+        Attribute->RecordLength < FIELD_OFFSET(YORI_LIB_NTFS_ATTRIBUTE, Form.Nonresident.TotalAllocated)) {
+
+        return NULL;
+    }
+
+    if (Attribute->NameLength > 0 &&
+        Attribute->NameOffset + Attribute->NameLength * sizeof(WCHAR) > Attribute->RecordLength) {
+
+        return NULL;
+    }
+
+    return Attribute;
+}
+
+/**
+ Return the value of a resident attribute.
+
+ @param Attribute Pointer to the attribute, which has been returned from
+        @ref YoriLibMftGetNextAttribute .
+
+ @param MinimumLength The minimum number of bytes the caller requires
+        within the value.
+
+ @return Pointer to the value, or NULL if the attribute is not resident or
+         the value is not large enough.
+ */
+PVOID
+YoriLibMftGetResidentValue(
+    __in PYORI_LIB_NTFS_ATTRIBUTE Attribute,
+    __in DWORD MinimumLength
+    )
+{
+    if (Attribute->FormCode != YORI_LIB_NTFS_ATTRIBUTE_RESIDENT ||
+        Attribute->Form.Resident.ValueLength < MinimumLength ||
+        Attribute->Form.Resident.ValueOffset > Attribute->RecordLength ||
+        Attribute->Form.Resident.ValueLength > Attribute->RecordLength - Attribute->Form.Resident.ValueOffset) {
+
+        return NULL;
+    }
+
+    return YoriLibAddToPointer(Attribute, Attribute->Form.Resident.ValueOffset);
+}
+
+/**
+ Read a range of bytes from a volume.
+
+ @param VolumeHandle Handle to the volume.
+
+ @param Offset The offset within the volume to read from, in bytes.
+
+ @param Buffer Pointer to a buffer to receive the data.
+
+ @param Length The number of bytes to read.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibMftReadVolume(
+    __in HANDLE VolumeHandle,
+    __in LONGLONG Offset,
+    __out PVOID Buffer,
+    __in DWORD Length
+    )
+{
+    OVERLAPPED Overlapped;
+    LARGE_INTEGER ReadOffset;
+    DWORD BytesRead;
+
+    ZeroMemory(&Overlapped, sizeof(Overlapped));
+    ReadOffset.QuadPart = Offset;
+    Overlapped.Offset = ReadOffset.LowPart;
+    Overlapped.OffsetHigh = ReadOffset.HighPart;
+
+    if (!ReadFile(VolumeHandle, Buffer, Length, &BytesRead, &Overlapped)) {
+        return FALSE;
+    }
+
+    if (BytesRead != Length) {
+        SetLastError(ERROR_HANDLE_EOF);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Decode the mapping pairs of a nonresident attribute into an array of
+ extents.
+
+ @param Attribute Pointer to the nonresident attribute.
+
+ @param Extents Pointer to an array of extents to populate.
+
+ @param MaximumExtents The number of elements in the Extents array.
+
+ @param ExtentCount On successful completion, updated to contain the number
+        of extents populated.
+
+ @return TRUE to indicate success, FALSE if the mapping pairs are not well
+         formed or describe unallocated ranges.
+ */
+BOOLEAN
+YoriLibMftDecodeMappingPairs(
+    __in PYORI_LIB_NTFS_ATTRIBUTE Attribute,
+    __out_ecount(MaximumExtents) PYORI_LIB_MFT_EXTENT Extents,
+    __in DWORD MaximumExtents,
+    __out PDWORD ExtentCount
+    )
+{
+    PUCHAR Pairs;
+    PUCHAR End;
+    DWORD LengthBytes;
+    DWORD OffsetBytes;
+    DWORD Index;
+    DWORD Count;
+    DWORDLONG Length;
+    DWORDLONG Delta;
+    LONGLONG Lcn;
+
+    if (Attribute->Form.Nonresident.MappingPairsOffset >= Attribute->RecordLength) {
+        return FALSE;
+    }
+
+    Pairs = YoriLibAddToPointer(Attribute, Attribute->Form.Nonresident.MappingPairsOffset);
+    End = YoriLibAddToPointer(Attribute, Attribute->RecordLength);
+    Lcn = 0;
+    Count = 0;
+
+    while (Pairs < End && *Pairs != 0) {
+        LengthBytes = *Pairs & 0xF;
+        OffsetBytes = *Pairs >> 4;
+        Pairs++;
+
+        //
+        //  A zero offset size describes a sparse range, which should never
+        //  exist within the MFT.
+        //
+
+        if (LengthBytes == 0 || LengthBytes > 8 ||
+            OffsetBytes == 0 || OffsetBytes > 8 ||
+            (DWORD)(End - Pairs) < LengthBytes + OffsetBytes ||
+            Count >= MaximumExtents) {
+
+            return FALSE;
+        }
+
+        Length = 0;
+        for (Index = 0; Index < LengthBytes; Index++) {
+            Length = Length | ((DWORDLONG)Pairs[Index] << (Index * 8));
+        }
+        Pairs = Pairs + LengthBytes;
+
+        Delta = 0;
+        for (Index = 0; Index < OffsetBytes; Index++) {
+            Delta = Delta | ((DWORDLONG)Pairs[Index] << (Index * 8));
+        }
+        if (OffsetBytes < 8 && (Pairs[OffsetBytes - 1] & 0x80) != 0) {
+            Delta = Delta | ~(((DWORDLONG)1 << (OffsetBytes * 8)) - 1);
+        }
+        Pairs = Pairs + OffsetBytes;
+
+        Lcn = Lcn + (LONGLONG)Delta;
+        if (Lcn < 0 || (LONGLONG)Length <= 0) {
+            return FALSE;
+        }
+
+        Extents[Count].Lcn = Lcn;
+        Extents[Count].ClusterCount = (LONGLONG)Length;
+        Count++;
+    }
+
+    *ExtentCount = Count;
+    return TRUE;
+}
+
+/**
+ Find the extents containing the MFT by reading the first file record,
+ which describes the MFT itself.
+
+ @param VolumeHandle Handle to the volume.
+
+ @param VolumeData Pointer to information about the NTFS volume.
+
+ @param Buffer Pointer to a buffer to use to read the first record.  This
+        must be at least one file record and one sector in size.
+
+ @param Extents On successful completion, updated to point to an array of
+        extents allocated within this routine.  The caller should free this
+        with @ref YoriLibFree .
+
+ @param ExtentCount On successful completion, updated to contain the number
+        of extents in the array.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibMftGetExtents(
+    __in HANDLE VolumeHandle,
+    __in PNTFS_VOLUME_DATA_BUFFER VolumeData,
+    __in PVOID Buffer,
+    __out PYORI_LIB_MFT_EXTENT *Extents,
+    __out PDWORD ExtentCount
+    )
+{
+    PYORI_LIB_NTFS_FILE_RECORD FileRecord;
+    PYORI_LIB_NTFS_ATTRIBUTE Attribute;
+    PYORI_LIB_MFT_EXTENT LocalExtents;
+    DWORD MaximumExtents;
+    DWORD RecordLength;
+    DWORD ReadLength;
+    DWORD Index;
+    LONGLONG ClustersFound;
+
+    RecordLength = VolumeData->BytesPerFileRecordSegment;
+    ReadLength = RecordLength;
+    if (ReadLength < VolumeData->BytesPerSector) {
+        ReadLength = VolumeData->BytesPerSector;
+    }
+
+    if (!YoriLibMftReadVolume(VolumeHandle,
+                              VolumeData->MftStartLcn.QuadPart * VolumeData->BytesPerCluster,
+                              Buffer,
+                              ReadLength)) {
+        return FALSE;
+    }
+
+    FileRecord = (PYORI_LIB_NTFS_FILE_RECORD)Buffer;
+    if (FileRecord->Signature != YORI_LIB_NTFS_FILE_RECORD_SIGNATURE ||
+        !YoriLibMftApplyFixups(FileRecord, RecordLength)) {
+
+        SetLastError(ERROR_INVALID_DATA);
+        return FALSE;
+    }
+
+    Attribute = NULL;
+    while (TRUE) {
+        Attribute = YoriLibMftGetNextAttribute(FileRecord, RecordLength, Attribute);
+        if (Attribute == NULL) {
+            break;
+        }
+        if (Attribute->TypeCode == YORI_LIB_NTFS_ATTRIBUTE_DATA &&
+            Attribute->NameLength == 0 &&
+            Attribute->FormCode != YORI_LIB_NTFS_ATTRIBUTE_RESIDENT &&
+            Attribute->Form.Nonresident.LowestVcn == 0) {
+
+            break;
+        }
+    }
+
+    if (Attribute == NULL) {
+        SetLastError(ERROR_INVALID_DATA);
+        return FALSE;
+    }
+
+    //
+    //  Each mapping pair requires at least three bytes, so this is an upper
+    //  bound on the number of extents.
+    //
+
+    MaximumExtents = Attribute->RecordLength / 3 + 1;
+    LocalExtents = YoriLibMalloc(MaximumExtents * sizeof(YORI_LIB_MFT_EXTENT));
+    if (LocalExtents == NULL) {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+
+    if (!YoriLibMftDecodeMappingPairs(Attribute, LocalExtents, MaximumExtents, ExtentCount)) {
+        YoriLibFree(LocalExtents);
+        SetLastError(ERROR_INVALID_DATA);
+        return FALSE;
+    }
+
+    //
+    //  If the MFT is so fragmented that its mapping continues in another
+    //  file record, the remaining extents would need to be found via the
+    //  attribute list.  This isn't supported here; callers are expected
+    //  to fall back to enumerating directories.
+    //
+
+    ClustersFound = 0;
+    for (Index = 0; Index < *ExtentCount; Index++) {
+        ClustersFound = ClustersFound + LocalExtents[Index].ClusterCount;
+    }
+
+    if (ClustersFound != Attribute->Form.Nonresident.HighestVcn + 1 ||
+        ClustersFound * VolumeData->BytesPerCluster < VolumeData->MftValidDataLength.QuadPart) {
+
+        YoriLibFree(LocalExtents);
+        SetLastError(ERROR_NOT_SUPPORTED);
+        return FALSE;
+    }
+
+    *Extents = LocalExtents;
+    return TRUE;
+}
+
+/**
+ Call a callback for every in use file record in the MFT of an NTFS volume.
+ The MFT is read directly from the volume in large sequential reads, which
+ is far faster than enumerating directories, but requires the caller to be
+ able to read the volume.  Records are supplied in segment number order,
+ with fixups applied.  Note that a single file may be described by a base
+ record and any number of extension records.
+
+ @param VolumeHandle Handle to the volume, from @ref YoriLibMftOpenVolume .
+
+ @param VolumeData Pointer to information about the NTFS volume.
+
+ @param Callback The callback to invoke for each in use file record.
+
+ @param Context Caller provided context to pass to the callback.
+
+ @return TRUE to indicate success, FALSE to indicate failure or that the
+         callback requested enumeration to stop.
+ */
+__success(return)
+BOOL
+YoriLibMftEnumerateRecords(
+    __in HANDLE VolumeHandle,
+    __in PNTFS_VOLUME_DATA_BUFFER VolumeData,
+    __in PYORI_LIB_MFT_RECORD_FN Callback,
+    __in_opt PVOID Context
+    )
+{
+    PYORI_LIB_MFT_EXTENT Extents;
+    PYORI_LIB_NTFS_FILE_RECORD FileRecord;
+    PUCHAR Buffer;
+    DWORD ExtentCount;
+    DWORD ExtentIndex;
+    DWORD RecordLength;
+    DWORD ReadLength;
+    DWORD Carry;
+    DWORD Available;
+    DWORD Offset;
+    DWORDLONG SegmentNumber;
+    DWORDLONG SegmentCount;
+    LONGLONG ExtentOffset;
+    LONGLONG ExtentLength;
+    BOOL Result;
+
+    RecordLength = VolumeData->BytesPerFileRecordSegment;
+    SegmentCount = VolumeData->MftValidDataLength.QuadPart / RecordLength;
+
+    //
+    //  VirtualAlloc returns page aligned memory, which satisfies the
+    //  alignment requirements of reading directly from a volume.
+    //
+
+    Buffer = VirtualAlloc(NULL, YORI_LIB_MFT_READ_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    if (!YoriLibMftGetExtents(VolumeHandle, VolumeData, Buffer, &Extents, &ExtentCount)) {
+        DWORD Err;
+        Err = GetLastError();
+        VirtualFree(Buffer, 0, MEM_RELEASE);
+        SetLastError(Err);
+        return FALSE;
+    }
+
+    Result = TRUE;
+    SegmentNumber = 0;
+    Carry = 0;
+
+    for (ExtentIndex = 0; Result && ExtentIndex < ExtentCount && SegmentNumber < SegmentCount; ExtentIndex++) {
+
+        ExtentOffset = 0;
+        ExtentLength = Extents[ExtentIndex].ClusterCount * VolumeData->BytesPerCluster;
+
+        while (ExtentOffset < ExtentLength && SegmentNumber < SegmentCount) {
+
+            ReadLength = YORI_LIB_MFT_READ_SIZE - Carry;
+            if ((LONGLONG)ReadLength > ExtentLength - ExtentOffset) {
+                ReadLength = (DWORD)(ExtentLength - ExtentOffset);
+            }
+
+            if (!YoriLibMftReadVolume(VolumeHandle,
+                                      Extents[ExtentIndex].Lcn * VolumeData->BytesPerCluster + ExtentOffset,
+                                      Buffer + Carry,
+                                      ReadLength)) {
+                Result = FALSE;
+                break;
+            }
+
+            ExtentOffset = ExtentOffset + ReadLength;
+            Available = Carry + ReadLength;
+
+            for (Offset = 0;
+                 Offset + RecordLength <= Available && SegmentNumber < SegmentCount;
+                 Offset = Offset + RecordLength, SegmentNumber++) {
+
+                FileRecord = (PYORI_LIB_NTFS_FILE_RECORD)(Buffer + Offset);
+                if (FileRecord->Signature != YORI_LIB_NTFS_FILE_RECORD_SIGNATURE ||
+                    !YoriLibMftApplyFixups(FileRecord, RecordLength) ||
+                    (FileRecord->Flags & YORI_LIB_NTFS_FILE_RECORD_IN_USE) == 0) {
+
+                    continue;
+                }
+
+                if (!Callback(SegmentNumber, FileRecord, RecordLength, Context)) {
+                    SetLastError(ERROR_OPERATION_ABORTED);
+                    Result = FALSE;
+                    break;
+                }
+            }
+
+            if (!Result) {
+                break;
+            }
+
+            //
+            //  If a file record spans two extents, keep the part that has
+            //  been read so the remainder can be read after it.
+            //
+
+            Carry = Available - Offset;
+            if (Carry > 0) {
+                memmove(Buffer, Buffer + Offset, Carry);
+            }
+
+            if (YoriLibIsOperationCancelled()) {
+                SetLastError(ERROR_OPERATION_ABORTED);
+                Result = FALSE;
+                break;
+            }
+        }
+    }
+
+    if (Result && SegmentNumber < SegmentCount) {
+        SetLastError(ERROR_INVALID_DATA);
+        Result = FALSE;
+    }
+
+    YoriLibFree(Extents);
+    VirtualFree(Buffer, 0, MEM_RELEASE);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
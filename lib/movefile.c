@@ -3,7 +3,7 @@
  *
  * Yori shell move or rename a file
  *
- * Copyright (c) 2017-2020 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -271,5 +271,1208 @@ YoriLibCopyFile(
     return Error;
 }
 
+/**
+ The state of a single buffer used by YoriLibCopyFileData.
+ */
+typedef struct _YORI_LIB_COPY_DATA_BUFFER {
+
+    /**
+     The overlapped structure for the read or write in progress.
+     */
+    OVERLAPPED Overlapped;
+
+    /**
+     Pointer to the buffer.  This is aligned to a page boundary.
+     */
+    PVOID Buffer;
+
+    /**
+     The offset in the source and destination of the data in the buffer.
+     */
+    LARGE_INTEGER Offset;
+
+    /**
+     The number of bytes requested by the most recent read.  A read that
+     returns less than this has reached the end of the source.
+     */
+    DWORD RequestLength;
+
+    /**
+     The number of bytes of source data in the buffer.  Writes may be
+     larger than this if the data is padded to a sector boundary.
+     */
+    DWORD DataLength;
+
+    /**
+     TRUE if a read or write is in progress into this buffer.
+     */
+    BOOLEAN Active;
+
+    /**
+     TRUE if the operation in progress is a write.  FALSE if it is a read.
+     */
+    BOOLEAN Writing;
+
+} YORI_LIB_COPY_DATA_BUFFER, *PYORI_LIB_COPY_DATA_BUFFER;
+
+/**
+ The number of bytes to clone in a single request when block cloning.
+ */
+#define YORI_LIB_COPY_DATA_CLONE_CHUNK_SIZE (1024 * 1024 * 1024)
+
+/**
+ The number of allocated ranges to query from a sparse file at a time.
+ */
+#define YORI_LIB_COPY_DATA_RANGES_PER_QUERY (32)
+
+/**
+ Tracks the next region of the source to read for YoriLibCopyFileData.  For
+ most sources this advances through the source one buffer at a time.  For
+ sparse files, it advances through the allocated ranges of the file so that
+ holes are not read or written.
+ */
+typedef struct _YORI_LIB_COPY_DATA_CURSOR {
+
+    /**
+     Handle to the source.
+     */
+    HANDLE SourceHandle;
+
+    /**
+     The offset of the next read.
+     */
+    LARGE_INTEGER NextOffset;
+
+    /**
+     The number of bytes to copy, or zero to copy until the end of the
+     source.  For sparse files, this is the file size.
+     */
+    LARGE_INTEGER MaximumLength;
+
+    /**
+     For sparse files, the end of the allocated range being read, rounded up
+     to Alignment.
+     */
+    LARGE_INTEGER RangeEnd;
+
+    /**
+     For sparse files, the offset to query allocated ranges from when the
+     ranges in Ranges have been read.
+     */
+    LARGE_INTEGER QueryOffset;
+
+    /**
+     The size of each read.
+     */
+    DWORD BufferSize;
+
+    /**
+     The alignment of each read.
+     */
+    DWORD Alignment;
+
+    /**
+     If the source is a device, its sector size, otherwise zero.  Devices
+     fail reads that extend beyond their end, so the final read of a device
+     is limited to the sectors that remain.
+     */
+    DWORD SourceSectorSize;
+
+    /**
+     For sparse files, the number of valid entries in Ranges.
+     */
+    DWORD RangeCount;
+
+    /**
+     For sparse files, the index of the next entry in Ranges to read.
+     */
+    DWORD RangeIndex;
+
+    /**
+     If the allocated ranges of a sparse file could not be queried, the Win32
+     error.  Otherwise ERROR_SUCCESS.
+     */
+    DWORD Error;
+
+    /**
+     TRUE if only allocated ranges should be read.
+     */
+    BOOLEAN Sparse;
+
+    /**
+     TRUE if there is nothing more to read.
+     */
+    BOOLEAN Complete;
+
+    /**
+     For sparse files, a set of allocated ranges to read.
+     */
+    FILE_ALLOCATED_RANGE_BUFFER Ranges[YORI_LIB_COPY_DATA_RANGES_PER_QUERY];
+
+} YORI_LIB_COPY_DATA_CURSOR, *PYORI_LIB_COPY_DATA_CURSOR;
+
+/**
+ Issue a device IO control to a handle opened for overlapped IO and wait for
+ it to complete.
+
+ @param FileHandle Handle to the file or device.
+
+ @param IoControlCode The IO control to issue.
+
+ @param InBuffer Pointer to the input buffer.
+
+ @param InBufferSize The size of the input buffer, in bytes.
+
+ @param OutBuffer Pointer to the output buffer.
+
+ @param OutBufferSize The size of the output buffer, in bytes.
+
+ @param BytesReturned On completion, updated to contain the number of bytes
+        returned in OutBuffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  On failure,
+         the last error is set.
+ */
+__success(return)
+BOOL
+YoriLibCopyDataDeviceIoControl(
+    __in HANDLE FileHandle,
+    __in DWORD IoControlCode,
+    __in_opt PVOID InBuffer,
+    __in DWORD InBufferSize,
+    __out_opt PVOID OutBuffer,
+    __in DWORD OutBufferSize,
+    __out PDWORD BytesReturned
+    )
+{
+    OVERLAPPED Overlapped;
+    BOOL Result;
+    DWORD Err;
+
+    *BytesReturned = 0;
+    ZeroMemory(&Overlapped, sizeof(Overlapped));
+    Overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Overlapped.hEvent == NULL) {
+        return FALSE;
+    }
+
+    Result = DeviceIoControl(FileHandle, IoControlCode, InBuffer, InBufferSize, OutBuffer, OutBufferSize, BytesReturned, &Overlapped);
+    if (!Result && GetLastError() == ERROR_IO_PENDING) {
+        Result = GetOverlappedResult(FileHandle, &Overlapped, BytesReturned, TRUE);
+    }
+
+    Err = GetLastError();
+    CloseHandle(Overlapped.hEvent);
+    SetLastError(Err);
+    return Result;
+}
+
+/**
+ Set the end of file of a file opened for overlapped IO.
+
+ @param FileHandle Handle to the file.
+
+ @param EndOfFile The new file size, in bytes.
+
+ @return ERROR_SUCCESS to indicate success, or a Win32 error code.
+ */
+DWORD
+YoriLibCopyDataSetEndOfFile(
+    __in HANDLE FileHandle,
+    __in LONGLONG EndOfFile
+    )
+{
+    LARGE_INTEGER NewEndOfFile;
+
+    NewEndOfFile.QuadPart = EndOfFile;
+    SetFilePointer(FileHandle, NewEndOfFile.LowPart, &NewEndOfFile.HighPart, FILE_BEGIN);
+    if (!SetEndOfFile(FileHandle)) {
+        return GetLastError();
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/**
+ Attempt to copy a file by cloning its blocks, so that the destination
+ shares storage with the source until either is modified.  This requires
+ both files to be on the same volume, and a file system that supports
+ block cloning, such as ReFS.
+
+ @param SourceHandle Handle to the source file.
+
+ @param DestHandle Handle to the destination file, which is expected to be
+        empty.
+
+ @param SourceInfo Pointer to information about the source file.
+
+ @param DestInfo Pointer to information about the destination file.
+
+ @return ERROR_SUCCESS to indicate the file was cloned, or a Win32 error
+         code.  On failure, the destination is returned to being empty.
+ */
+DWORD
+YoriLibCopyDataClone(
+    __in HANDLE SourceHandle,
+    __in HANDLE DestHandle,
+    __in LPBY_HANDLE_FILE_INFORMATION SourceInfo,
+    __in LPBY_HANDLE_FILE_INFORMATION DestInfo
+    )
+{
+    FSCTL_GET_INTEGRITY_INFORMATION_BUFFER GetIntegrity;
+    FSCTL_SET_INTEGRITY_INFORMATION_BUFFER SetIntegrity;
+    DUPLICATE_EXTENTS_DATA Duplicate;
+    LARGE_INTEGER FileSize;
+    LARGE_INTEGER CloneLength;
+    LONGLONG ChunkSize;
+    DWORD BytesReturned;
+    DWORD Err;
+
+    if (SourceInfo->dwVolumeSerialNumber != DestInfo->dwVolumeSerialNumber) {
+        return ERROR_NOT_SAME_DEVICE;
+    }
+
+    //
+    //  File systems that support block cloning report the cluster size
+    //  with integrity information, and clone ranges must be cluster
+    //  aligned.
+    //
+
+    if (!YoriLibCopyDataDeviceIoControl(SourceHandle, FSCTL_GET_INTEGRITY_INFORMATION, NULL, 0, &GetIntegrity, sizeof(GetIntegrity), &BytesReturned)) {
+        return GetLastError();
+    }
+
+    if (GetIntegrity.ClusterSizeInBytes == 0) {
+        return ERROR_NOT_SUPPORTED;
+    }
+
+    //
+    //  The destination must match the source's sparseness and integrity
+    //  settings before blocks can be shared.
+    //
+
+    if (SourceInfo->dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) {
+        if (!YoriLibCopyDataDeviceIoControl(DestHandle, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &BytesReturned)) {
+            return GetLastError();
+        }
+    }
+
+    SetIntegrity.ChecksumAlgorithm = GetIntegrity.ChecksumAlgorithm;
+    SetIntegrity.Reserved = 0;
+    SetIntegrity.Flags = GetIntegrity.Flags;
+    YoriLibCopyDataDeviceIoControl(DestHandle, FSCTL_SET_INTEGRITY_INFORMATION, &SetIntegrity, sizeof(SetIntegrity), NULL, 0, &BytesReturned);
+
+    FileSize.LowPart = SourceInfo->nFileSizeLow;
+    FileSize.HighPart = SourceInfo->nFileSizeHigh;
+
+    Err = YoriLibCopyDataSetEndOfFile(DestHandle, FileSize.QuadPart);
+    if (Err != ERROR_SUCCESS) {
+        return Err;
+    }
+
+    //
+    //  The final cluster can be cloned in full even though the file ends
+    //  within it.  Clone in chunks to bound the time of each request.
+    //
+
+    CloneLength.QuadPart = (FileSize.QuadPart + GetIntegrity.ClusterSizeInBytes - 1) / GetIntegrity.ClusterSizeInBytes * GetIntegrity.ClusterSizeInBytes;
+    ChunkSize = YORI_LIB_COPY_DATA_CLONE_CHUNK_SIZE / GetIntegrity.ClusterSizeInBytes * GetIntegrity.ClusterSizeInBytes;
+    if (ChunkSize == 0) {
+        ChunkSize = GetIntegrity.ClusterSizeInBytes;
+    }
+
+    Duplicate.FileHandle = SourceHandle;
+    Duplicate.SourceFileOffset.QuadPart = 0;
+    while (Duplicate.SourceFileOffset.QuadPart < CloneLength.QuadPart) {
+        Duplicate.TargetFileOffset.QuadPart = Duplicate.SourceFileOffset.QuadPart;
+        Duplicate.ByteCount.QuadPart = CloneLength.QuadPart - Duplicate.SourceFileOffset.QuadPart;
+        if (Duplicate.ByteCount.QuadPart > ChunkSize) {
+            Duplicate.ByteCount.QuadPart = ChunkSize;
+        }
+
+        if (!YoriLibCopyDataDeviceIoControl(DestHandle, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &Duplicate, sizeof(Duplicate), NULL, 0, &BytesReturned)) {
+            Err = GetLastError();
+            YoriLibCopyDataSetEndOfFile(DestHandle, 0);
+            return Err;
+        }
+
+        Duplicate.SourceFileOffset.QuadPart = Duplicate.SourceFileOffset.QuadPart + Duplicate.ByteCount.QuadPart;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/**
+ Find the next region of the source to read.
+
+ @param Cursor Pointer to the cursor describing the regions of the source
+        that have been read.
+
+ @param Offset On successful completion, updated to contain the offset of
+        the read.
+
+ @param Length On successful completion, updated to contain the number of
+        bytes to read.
+
+ @return TRUE to indicate a region to read was found, FALSE if there is
+         nothing more to read.  If FALSE is returned because allocated
+         ranges could not be queried, Cursor->Error is set.
+ */
+__success(return)
+BOOL
+YoriLibCopyDataNextRead(
+    __inout PYORI_LIB_COPY_DATA_CURSOR Cursor,
+    __out PLARGE_INTEGER Offset,
+    __out PDWORD Length
+    )
+{
+    FILE_ALLOCATED_RANGE_BUFFER StartBuffer;
+    PFILE_ALLOCATED_RANGE_BUFFER Range;
+    LARGE_INTEGER RangeStart;
+    DWORD BytesReturned;
+
+    if (Cursor->Complete) {
+        return FALSE;
+    }
+
+    if (Cursor->MaximumLength.QuadPart != 0 &&
+        Cursor->NextOffset.QuadPart >= Cursor->MaximumLength.QuadPart) {
+
+        Cursor->Complete = TRUE;
+        return FALSE;
+    }
+
+    if (!Cursor->Sparse) {
+        Offset->QuadPart = Cursor->NextOffset.QuadPart;
+        *Length = Cursor->BufferSize;
+        if (Cursor->SourceSectorSize != 0 &&
+            Cursor->MaximumLength.QuadPart != 0 &&
+            Cursor->MaximumLength.QuadPart - Cursor->NextOffset.QuadPart < Cursor->BufferSize) {
+
+            *Length = (DWORD)(Cursor->MaximumLength.QuadPart - Cursor->NextOffset.QuadPart);
+            *Length = (*Length + Cursor->SourceSectorSize - 1) / Cursor->SourceSectorSize * Cursor->SourceSectorSize;
+        }
+        Cursor->NextOffset.QuadPart = Cursor->NextOffset.QuadPart + *Length;
+        return TRUE;
+    }
+
+    //
+    //  Move to the next allocated range once the current one has been read,
+    //  querying more ranges when needed.  Ranges are widened to the
+    //  alignment of the IO, so may overlap the range before.
+    //
+
+    while (Cursor->NextOffset.QuadPart >= Cursor->RangeEnd.QuadPart) {
+        if (Cursor->RangeIndex >= Cursor->RangeCount) {
+            if (Cursor->QueryOffset.QuadPart >= Cursor->MaximumLength.QuadPart) {
+                Cursor->Complete = TRUE;
+                return FALSE;
+            }
+
+            StartBuffer.FileOffset.QuadPart = Cursor->QueryOffset.QuadPart;
+            StartBuffer.Length.QuadPart = Cursor->MaximumLength.QuadPart - Cursor->QueryOffset.QuadPart;
+            if (!YoriLibCopyDataDeviceIoControl(Cursor->SourceHandle, FSCTL_QUERY_ALLOCATED_RANGES, &StartBuffer, sizeof(StartBuffer), Cursor->Ranges, sizeof(Cursor->Ranges), &BytesReturned) &&
+                GetLastError() != ERROR_MORE_DATA) {
+
+                Cursor->Error = GetLastError();
+                Cursor->Complete = TRUE;
+                return FALSE;
+            }
+
+            Cursor->RangeCount = BytesReturned / sizeof(FILE_ALLOCATED_RANGE_BUFFER);
+            Cursor->RangeIndex = 0;
+            if (Cursor->RangeCount == 0) {
+                Cursor->Complete = TRUE;
+                return FALSE;
+            }
+
+            Range = &Cursor->Ranges[Cursor->RangeCount - 1];
+            Cursor->QueryOffset.QuadPart = Range->FileOffset.QuadPart + Range->Length.QuadPart;
+        }
+
+        Range = &Cursor->Ranges[Cursor->RangeIndex];
+        Cursor->RangeIndex++;
+
+        RangeStart.QuadPart = Range->FileOffset.QuadPart / Cursor->Alignment * Cursor->Alignment;
+        Cursor->RangeEnd.QuadPart = (Range->FileOffset.QuadPart + Range->Length.QuadPart + Cursor->Alignment - 1) / Cursor->Alignment * Cursor->Alignment;
+        if (RangeStart.QuadPart > Cursor->NextOffset.QuadPart) {
+            Cursor->NextOffset.QuadPart = RangeStart.QuadPart;
+        }
+    }
+
+    Offset->QuadPart = Cursor->NextOffset.QuadPart;
+    *Length = Cursor->BufferSize;
+    if (Cursor->RangeEnd.QuadPart - Cursor->NextOffset.QuadPart < Cursor->BufferSize) {
+        *Length = (DWORD)(Cursor->RangeEnd.QuadPart - Cursor->NextOffset.QuadPart);
+    }
+    Cursor->NextOffset.QuadPart = Cursor->NextOffset.QuadPart + *Length;
+    return TRUE;
+}
+
+/**
+ Start an overlapped read or write into a buffer used by
+ YoriLibCopyFileData.
+
+ @param FileHandle Handle to the file or device to read from or write to.
+
+ @param Buffer Pointer to the buffer.  The offset of the IO is specified in
+        the buffer.
+
+ @param Length The number of bytes to read or write.
+
+ @param Write TRUE to write, FALSE to read.
+
+ @return ERROR_SUCCESS to indicate the IO was started, or a Win32 error code.
+         If the IO was started, Buffer->Overlapped.hEvent will be signalled
+         when it completes.
+ */
+DWORD
+YoriLibCopyDataStartIo(
+    __in HANDLE FileHandle,
+    __inout PYORI_LIB_COPY_DATA_BUFFER Buffer,
+    __in DWORD Length,
+    __in BOOLEAN Write
+    )
+{
+    BOOL Result;
+    DWORD Err;
+
+    Buffer->Overlapped.Offset = Buffer->Offset.LowPart;
+    Buffer->Overlapped.OffsetHigh = Buffer->Offset.HighPart;
+    Buffer->Writing = Write;
+
+    if (Write) {
+        Result = WriteFile(FileHandle, Buffer->Buffer, Length, NULL, &Buffer->Overlapped);
+    } else {
+        Buffer->RequestLength = Length;
+        Result = ReadFile(FileHandle, Buffer->Buffer, Length, NULL, &Buffer->Overlapped);
+    }
+
+    if (!Result) {
+        Err = GetLastError();
+        if (Err != ERROR_IO_PENDING) {
+            return Err;
+        }
+    }
+
+    Buffer->Active = TRUE;
+    return ERROR_SUCCESS;
+}
+
+/**
+ Start a read of the next region of the source into a buffer used by
+ YoriLibCopyFileData.
+
+ @param SourceHandle Handle to the source.
+
+ @param Buffer Pointer to the buffer.
+
+ @param Cursor Pointer to the cursor describing the next region to read.
+
+ @param EndOfSource On completion, set to TRUE if there is nothing more to
+        read.
+
+ @return ERROR_SUCCESS to indicate a read was started or there is nothing
+         more to read, or a Win32 error code.
+ */
+DWORD
+YoriLibCopyDataStartRead(
+    __in HANDLE SourceHandle,
+    __inout PYORI_LIB_COPY_DATA_BUFFER Buffer,
+    __inout PYORI_LIB_COPY_DATA_CURSOR Cursor,
+    __out PBOOLEAN EndOfSource
+    )
+{
+    DWORD Length;
+    DWORD Err;
+
+    *EndOfSource = FALSE;
+    if (!YoriLibCopyDataNextRead(Cursor, &Buffer->Offset, &Length)) {
+        *EndOfSource = TRUE;
+        return Cursor->Error;
+    }
+
+    Err = YoriLibCopyDataStartIo(SourceHandle, Buffer, Length, FALSE);
+    if (Err == ERROR_HANDLE_EOF) {
+        *EndOfSource = TRUE;
+        Err = ERROR_SUCCESS;
+    }
+
+    return Err;
+}
+
+/**
+ Check whether a buffer used by YoriLibCopyFileData contains only zeroes.
+ Buffers are page aligned and lengths are a multiple of the IO alignment, so
+ the buffer can be compared a machine word at a time.
+
+ @param Buffer Pointer to the buffer.
+
+ @param Length The number of bytes to check.  This must be a multiple of the
+        size of a machine word.
+
+ @return TRUE if every byte is zero, FALSE if any byte is not.
+ */
+BOOLEAN
+YoriLibCopyDataIsZero(
+    __in PVOID Buffer,
+    __in DWORD Length
+    )
+{
+    DWORD_PTR * Words;
+    DWORD Count;
+    DWORD Index;
+
+    Words = (DWORD_PTR *)Buffer;
+    Count = Length / sizeof(DWORD_PTR);
+
+    //
+    //  Combining several words before testing lets the loop test one
+    //  branch per group, and the first block of a nonzero buffer usually
+    //  ends the check immediately.
+    //
+
+    for (Index = 0; Index + 4 <= Count; Index += 4) {
+        if ((Words[Index] | Words[Index + 1] | Words[Index + 2] | Words[Index + 3]) != 0) {
+            return FALSE;
+        }
+    }
+
+    for (; Index < Count; Index++) {
+        if (Words[Index] != 0) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Calculate the digest of data in a buffer used by YoriLibCopyFileData or
+ YoriLibCopyDataComputeDigest.  The digest of a range is the sum of the XXH64
+ hash of each chunk which contains any nonzero data, seeded with the offset
+ of the chunk.  Because it's a sum, buffers can be added in any order, which
+ allows reads that complete out of order to be added as they complete, and
+ because chunks of zeroes are omitted, ranges left unwritten in a sparse
+ destination have the same digest as the zeroes that were read from the
+ source.
+
+ @param Buffer Pointer to the buffer.  This must be padded with zeroes to a
+        multiple of YORI_LIB_COPY_DATA_DIGEST_CHUNK.
+
+ @param Length The number of bytes of data in the buffer.
+
+ @param Offset The offset of the data relative to the start of the range
+        being digested.  This must be a multiple of
+        YORI_LIB_COPY_DATA_DIGEST_CHUNK.
+
+ @return The digest of the data in the buffer, to be added to the digest of
+         the range.
+ */
+DWORDLONG
+YoriLibCopyDataDigestBuffer(
+    __in PUCHAR Buffer,
+    __in DWORD Length,
+    __in DWORDLONG Offset
+    )
+{
+    YORI_LIB_XXHASH64_STATE HashState;
+    DWORDLONG Digest;
+    DWORD ChunkOffset;
+    DWORD ChunkLength;
+
+    Digest = 0;
+    for (ChunkOffset = 0; ChunkOffset < Length; ChunkOffset += YORI_LIB_COPY_DATA_DIGEST_CHUNK) {
+        ChunkLength = Length - ChunkOffset;
+        if (ChunkLength > YORI_LIB_COPY_DATA_DIGEST_CHUNK) {
+            ChunkLength = YORI_LIB_COPY_DATA_DIGEST_CHUNK;
+        }
+
+        if (YoriLibCopyDataIsZero(Buffer + ChunkOffset, YORI_LIB_COPY_DATA_DIGEST_CHUNK)) {
+            continue;
+        }
+
+        YoriLibXxHash64Initialize(&HashState, Offset + ChunkOffset);
+        YoriLibXxHash64Update(&HashState, Buffer + ChunkOffset, (YORI_ALLOC_SIZE_T)ChunkLength);
+        Digest = Digest + YoriLibXxHash64Finalize(&HashState);
+    }
+
+    return Digest;
+}
+
+/**
+ Read a range of a file or device and calculate the same digest that
+ YoriLibCopyFileData calculates for the data it copies.  This is used to
+ verify a copy by reading the destination once and comparing the result
+ against the digest calculated while copying, rather than reading both the
+ source and destination again.
+
+ @param FileHandle Handle to the file or device to read.  This may be opened
+        with FILE_FLAG_NO_BUFFERING and FILE_FLAG_OVERLAPPED.
+
+ @param Offset The offset to start reading from.  If the handle is opened
+        with FILE_FLAG_NO_BUFFERING, this must be sector aligned.
+
+ @param Length The number of bytes to read, or zero to read until the end of
+        the file.
+
+ @param BufferSize The size of the buffer to read with, or zero to use a
+        default.
+
+ @param Digest On successful completion, updated to contain the digest of
+        the range.
+
+ @return ERROR_SUCCESS to indicate success, or a Win32 error code.
+ */
+DWORD
+YoriLibCopyDataComputeDigest(
+    __in HANDLE FileHandle,
+    __in PLARGE_INTEGER Offset,
+    __in PLARGE_INTEGER Length,
+    __in DWORD BufferSize,
+    __out PDWORDLONG Digest
+    )
+{
+    OVERLAPPED Overlapped;
+    PUCHAR Buffer;
+    LARGE_INTEGER ReadOffset;
+    LARGE_INTEGER Remaining;
+    DWORDLONG RangeDigest;
+    DWORD ReadLength;
+    DWORD BytesTransferred;
+    DWORD PaddedLength;
+    DWORD Err;
+
+    if (BufferSize == 0) {
+        BufferSize = YORI_LIB_COPY_DATA_DEFAULT_BUFFER_SIZE;
+    } else if (BufferSize > YORI_LIB_COPY_DATA_MAXIMUM_BUFFER_SIZE) {
+        BufferSize = YORI_LIB_COPY_DATA_MAXIMUM_BUFFER_SIZE;
+    }
+    BufferSize = (BufferSize + YORI_LIB_COPY_DATA_DIGEST_CHUNK - 1) / YORI_LIB_COPY_DATA_DIGEST_CHUNK * YORI_LIB_COPY_DATA_DIGEST_CHUNK;
+
+    Buffer = VirtualAlloc(NULL, BufferSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (Buffer == NULL) {
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    ZeroMemory(&Overlapped, sizeof(Overlapped));
+    Overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Overlapped.hEvent == NULL) {
+        Err = GetLastError();
+        VirtualFree(Buffer, 0, MEM_RELEASE);
+        return Err;
+    }
+
+    Err = ERROR_SUCCESS;
+    RangeDigest = 0;
+    ReadOffset.QuadPart = 0;
+    Remaining.QuadPart = Length->QuadPart;
+
+    while (Length->QuadPart == 0 || Remaining.QuadPart > 0) {
+
+        //
+        //  The final read of a range is rounded up to a whole chunk, which
+        //  keeps it aligned for unbuffered IO, and any data beyond the
+        //  range is ignored.
+        //
+
+        ReadLength = BufferSize;
+        if (Length->QuadPart != 0 && Remaining.QuadPart < ReadLength) {
+            ReadLength = (DWORD)(Remaining.QuadPart + YORI_LIB_COPY_DATA_DIGEST_CHUNK - 1) / YORI_LIB_COPY_DATA_DIGEST_CHUNK * YORI_LIB_COPY_DATA_DIGEST_CHUNK;
+        }
+
+        Overlapped.Offset = (DWORD)(Offset->QuadPart + ReadOffset.QuadPart);
+        Overlapped.OffsetHigh = (DWORD)((Offset->QuadPart + ReadOffset.QuadPart) >> 32);
+        ResetEvent(Overlapped.hEvent);
+
+        BytesTransferred = 0;
+        if (!ReadFile(FileHandle, Buffer, ReadLength, &BytesTransferred, &Overlapped)) {
+            Err = GetLastError();
+            if (Err == ERROR_IO_PENDING) {
+                Err = ERROR_SUCCESS;
+                if (!GetOverlappedResult(FileHandle, &Overlapped, &BytesTransferred, TRUE)) {
+                    Err = GetLastError();
+                }
+            }
+            if (Err == ERROR_HANDLE_EOF) {
+                Err = ERROR_SUCCESS;
+                BytesTransferred = 0;
+            }
+            if (Err != ERROR_SUCCESS) {
+                break;
+            }
+        }
+
+        if (Length->QuadPart != 0 && BytesTransferred > Remaining.QuadPart) {
+            BytesTransferred = (DWORD)Remaining.QuadPart;
+        }
+
+        if (BytesTransferred == 0) {
+            break;
+        }
+
+        PaddedLength = (BytesTransferred + YORI_LIB_COPY_DATA_DIGEST_CHUNK - 1) / YORI_LIB_COPY_DATA_DIGEST_CHUNK * YORI_LIB_COPY_DATA_DIGEST_CHUNK;
+        if (PaddedLength > BytesTransferred) {
+            ZeroMemory(Buffer + BytesTransferred, PaddedLength - BytesTransferred);
+        }
+
+        RangeDigest = RangeDigest + YoriLibCopyDataDigestBuffer(Buffer, BytesTransferred, ReadOffset.QuadPart);
+        ReadOffset.QuadPart = ReadOffset.QuadPart + BytesTransferred;
+        Remaining.QuadPart = Remaining.QuadPart - BytesTransferred;
+
+        if (BytesTransferred < ReadLength) {
+            break;
+        }
+    }
+
+    CloseHandle(Overlapped.hEvent);
+    VirtualFree(Buffer, 0, MEM_RELEASE);
+
+    if (Err == ERROR_SUCCESS) {
+        *Digest = RangeDigest;
+    }
+    return Err;
+}
+
+/**
+ Copy data from one file or device to another, keeping several reads and
+ writes in flight at once.  This is intended for large files and devices
+ where a single synchronous read and write leaves the storage idle.  Both
+ handles must be opened for overlapped IO, and may be opened with
+ FILE_FLAG_NO_BUFFERING.  Data read from SourceOffset onwards is written from
+ DestOffset onwards, which allows a range of a file to be copied to another
+ position.  If the destination is a file, it is truncated at the end of the
+ data copied; if it is a device, the final write is padded with zeroes to
+ a sector boundary.
+
+ When copying a whole file to the start of a file, the destination is
+ expected to be empty.  If both are on a volume that supports block cloning,
+ the blocks are cloned rather than copied.  Otherwise, if the source is
+ sparse, the destination is made sparse and only allocated ranges are
+ copied.
+
+ @param SourceHandle Handle to the source, opened for overlapped IO.
+
+ @param DestHandle Handle to the destination, opened for overlapped IO.
+
+ @param Params Pointer to parameters for the copy.  On input, this can
+        specify the number and size of buffers to use and the number of
+        bytes to copy.  On output, this indicates the number of bytes that
+        were copied, the time taken, and how the data was copied.
+
+ @return ERROR_SUCCESS to indicate success, or a Win32 error code.
+ */
+DWORD
+YoriLibCopyFileData(
+    __in HANDLE SourceHandle,
+    __in HANDLE DestHandle,
+    __inout PYORI_LIB_COPY_DATA_PARAMS Params
+    )
+{
+    PYORI_LIB_COPY_DATA_BUFFER Buffers;
+    PYORI_LIB_COPY_DATA_BUFFER Buffer;
+    YORI_LIB_COPY_DATA_CURSOR Cursor;
+    BY_HANDLE_FILE_INFORMATION SourceInfo;
+    BY_HANDLE_FILE_INFORMATION DestInfo;
+    DISK_GEOMETRY DiskGeometry;
+    HANDLE Events[MAXIMUM_WAIT_OBJECTS];
+    DWORD EventBuffer[MAXIMUM_WAIT_OBJECTS];
+    PUCHAR BufferMemory;
+    DWORD BufferCount;
+    DWORD BufferSize;
+    DWORD Alignment;
+    DWORD DestSectorSize;
+    DWORD SourceSectorSize;
+    DWORD ActiveCount;
+    DWORD EventCount;
+    DWORD BufferEventCount;
+    DWORD Index;
+    DWORD WaitResult;
+    DWORD BytesTransferred;
+    DWORD WriteLength;
+    DWORD Err;
+    DWORD IoErr;
+    LARGE_INTEGER FileSize;
+    LARGE_INTEGER EndOfData;
+    LONGLONG StartTime;
+    BOOLEAN EndOfSource;
+    BOOLEAN Stop;
+    BOOLEAN SkipZeroBlocks;
+    HANDLE CancelEvent;
+
+    StartTime = YoriLibGetSystemTimeAsInteger();
+    Params->BytesCopied.QuadPart = 0;
+    Params->ZeroBytesSkipped.QuadPart = 0;
+    Params->ElapsedTime.QuadPart = 0;
+    Params->Cloned = FALSE;
+    Params->Sparse = FALSE;
+    Params->DigestComputed = FALSE;
+    Params->Digest = 0;
+    Params->DigestLength.QuadPart = 0;
+
+    //
+    //  If the process is handling Ctrl+C, wait for it alongside the IO so
+    //  that a large copy can be stopped promptly.  This consumes one wait
+    //  slot, so the number of buffers is one fewer than the wait limit.
+    //
+
+    CancelEvent = YoriLibCancelGetEvent();
+
+    //
+    //  Unbuffered IO requires offsets and lengths to be a multiple of the
+    //  sector size.  Files don't report a sector size, so use a value that
+    //  is a multiple of any common sector size.
+    //
+
+    DestSectorSize = 0;
+    if (YoriLibCopyDataDeviceIoControl(DestHandle, IOCTL_DISK_GET_DRIVE_GEOMETRY, NULL, 0, &DiskGeometry, sizeof(DiskGeometry), &BytesTransferred)) {
+        DestSectorSize = DiskGeometry.BytesPerSector;
+    }
+
+    SourceSectorSize = 0;
+    if (YoriLibCopyDataDeviceIoControl(SourceHandle, IOCTL_DISK_GET_DRIVE_GEOMETRY, NULL, 0, &DiskGeometry, sizeof(DiskGeometry), &BytesTransferred)) {
+        SourceSectorSize = DiskGeometry.BytesPerSector;
+    }
+    Alignment = DestSectorSize;
+    if (Alignment < 4096) {
+        Alignment = 4096;
+    }
+
+    BufferCount = Params->BufferCount;
+    if (BufferCount == 0) {
+        BufferCount = YORI_LIB_COPY_DATA_DEFAULT_BUFFER_COUNT;
+    } else if (BufferCount > MAXIMUM_WAIT_OBJECTS - 1) {
+        BufferCount = MAXIMUM_WAIT_OBJECTS - 1;
+    }
+
+    BufferSize = Params->BufferSize;
+    if (BufferSize == 0) {
+        BufferSize = YORI_LIB_COPY_DATA_DEFAULT_BUFFER_SIZE;
+    } else if (BufferSize > YORI_LIB_COPY_DATA_MAXIMUM_BUFFER_SIZE) {
+        BufferSize = YORI_LIB_COPY_DATA_MAXIMUM_BUFFER_SIZE;
+    }
+    BufferSize = (BufferSize + Alignment - 1) / Alignment * Alignment;
+
+    //
+    //  The cursor works in source offsets, so the maximum length becomes
+    //  the offset to stop reading at.
+    //
+
+    ZeroMemory(&Cursor, sizeof(Cursor));
+    Cursor.SourceHandle = SourceHandle;
+    Cursor.NextOffset.QuadPart = Params->SourceOffset.QuadPart;
+    if (Params->MaximumLength.QuadPart != 0) {
+        Cursor.MaximumLength.QuadPart = Params->SourceOffset.QuadPart + Params->MaximumLength.QuadPart;
+    }
+    Cursor.BufferSize = BufferSize;
+    Cursor.Alignment = Alignment;
+
+    //
+    //  If the source is a device and no length was specified, read to the
+    //  end of the device, so the final read doesn't extend beyond it.
+    //
+
+    if (SourceSectorSize != 0) {
+        Cursor.SourceSectorSize = SourceSectorSize;
+        if (Cursor.MaximumLength.QuadPart == 0 &&
+            YoriLibCopyDataDeviceIoControl(SourceHandle, IOCTL_DISK_GET_LENGTH_INFO, NULL, 0, &FileSize, sizeof(FileSize), &BytesTransferred)) {
+
+            Cursor.MaximumLength.QuadPart = FileSize.QuadPart;
+        }
+    }
+
+    //
+    //  Blocks of zeroes are only skipped when writing to a file which is
+    //  assumed to be empty.  Making it sparse means the skipped ranges
+    //  occupy no space, but if that isn't possible the file system fills
+    //  them with zeroes, so the result is still correct.
+    //
+
+    SkipZeroBlocks = FALSE;
+    if (Params->SkipZeroBlocks && DestSectorSize == 0) {
+        SkipZeroBlocks = TRUE;
+        YoriLibCopyDataDeviceIoControl(DestHandle, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &BytesTransferred);
+    }
+
+    //
+    //  When copying a whole file to a file, try to clone it, and if that's
+    //  not possible, preserve any sparseness.
+    //
+
+    FileSize.QuadPart = 0;
+    if (DestSectorSize == 0 &&
+        Params->MaximumLength.QuadPart == 0 &&
+        Params->SourceOffset.QuadPart == 0 &&
+        Params->DestOffset.QuadPart == 0 &&
+        GetFileInformationByHandle(SourceHandle, &SourceInfo) &&
+        GetFileInformationByHandle(DestHandle, &DestInfo)) {
+
+        FileSize.LowPart = SourceInfo.nFileSizeLow;
+        FileSize.HighPart = SourceInfo.nFileSizeHigh;
+
+        if (FileSize.QuadPart > 0 &&
+            YoriLibCopyDataClone(SourceHandle, DestHandle, &SourceInfo, &DestInfo) == ERROR_SUCCESS) {
+
+            Params->Cloned = TRUE;
+            Params->BytesCopied.QuadPart = FileSize.QuadPart;
+            Params->ElapsedTime.QuadPart = YoriLibGetSystemTimeAsInteger() - StartTime;
+            return ERROR_SUCCESS;
+        }
+
+        if ((SourceInfo.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) &&
+            YoriLibCopyDataDeviceIoControl(DestHandle, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &BytesTransferred)) {
+
+            Cursor.Sparse = TRUE;
+            Cursor.MaximumLength.QuadPart = FileSize.QuadPart;
+            Params->Sparse = TRUE;
+        }
+    }
+
+    Buffers = YoriLibMalloc(BufferCount * sizeof(YORI_LIB_COPY_DATA_BUFFER));
+    if (Buffers == NULL) {
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    ZeroMemory(Buffers, BufferCount * sizeof(YORI_LIB_COPY_DATA_BUFFER));
+
+    //
+    //  VirtualAlloc returns page aligned memory, which satisfies the buffer
+    //  alignment requirements of unbuffered IO.
+    //
+
+    BufferMemory = VirtualAlloc(NULL, (SIZE_T)BufferCount * BufferSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (BufferMemory == NULL) {
+        YoriLibFree(Buffers);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    Err = ERROR_SUCCESS;
+    for (Index = 0; Index < BufferCount; Index++) {
+        Buffers[Index].Buffer = BufferMemory + (SIZE_T)Index * BufferSize;
+        Buffers[Index].Overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if (Buffers[Index].Overlapped.hEvent == NULL) {
+            Err = GetLastError();
+            break;
+        }
+    }
+
+    //
+    //  Reads start at the source offset and advance by whole buffers, or
+    //  for sparse files, at allocated ranges rounded to the alignment, so
+    //  every read begins on a chunk boundary relative to the start of the
+    //  copy.
+    //
+
+    if (Params->ComputeDigest) {
+        Params->DigestComputed = TRUE;
+    }
+
+    EndOfData.QuadPart = Params->DestOffset.QuadPart;
+    EndOfSource = FALSE;
+    Stop = FALSE;
+    ActiveCount = 0;
+
+    if (Err != ERROR_SUCCESS) {
+        Stop = TRUE;
+    }
+
+    //
+    //  Start a read into every buffer.
+    //
+
+    for (Index = 0; Index < BufferCount && !Stop && !EndOfSource; Index++) {
+        IoErr = YoriLibCopyDataStartRead(SourceHandle, &Buffers[Index], &Cursor, &EndOfSource);
+        if (IoErr != ERROR_SUCCESS) {
+            Err = IoErr;
+            Stop = TRUE;
+        } else if (Buffers[Index].Active) {
+            ActiveCount++;
+        }
+    }
+
+    //
+    //  As each read completes, write its data to the same offset in the
+    //  destination.  As each write completes, reuse the buffer for the next
+    //  read.  Once the end of the source is reached or an error occurs, no
+    //  new IO is started, but IO in progress must complete before the
+    //  buffers can be freed.
+    //
+
+    while (ActiveCount > 0) {
+        EventCount = 0;
+        for (Index = 0; Index < BufferCount; Index++) {
+            if (Buffers[Index].Active) {
+                Events[EventCount] = Buffers[Index].Overlapped.hEvent;
+                EventBuffer[EventCount] = Index;
+                EventCount++;
+            }
+        }
+
+        BufferEventCount = EventCount;
+        if (CancelEvent != NULL) {
+            Events[EventCount] = CancelEvent;
+            EventCount++;
+        }
+
+        WaitResult = WaitForMultipleObjects(EventCount, Events, FALSE, INFINITE);
+        if (WaitResult < WAIT_OBJECT_0 || WaitResult >= WAIT_OBJECT_0 + BufferEventCount) {
+            if (Err == ERROR_SUCCESS) {
+                if (WaitResult == WAIT_OBJECT_0 + BufferEventCount) {
+                    Err = ERROR_OPERATION_ABORTED;
+                } else {
+                    Err = GetLastError();
+                }
+            }
+            CancelIo(SourceHandle);
+            CancelIo(DestHandle);
+            for (Index = 0; Index < BufferCount; Index++) {
+                Buffer = &Buffers[Index];
+                if (Buffer->Active) {
+                    GetOverlappedResult(Buffer->Writing ? DestHandle : SourceHandle, &Buffer->Overlapped, &BytesTransferred, TRUE);
+                    Buffer->Active = FALSE;
+                }
+            }
+            ActiveCount = 0;
+            break;
+        }
+
+        Buffer = &Buffers[EventBuffer[WaitResult - WAIT_OBJECT_0]];
+        Buffer->Active = FALSE;
+        ActiveCount--;
+
+        if (!GetOverlappedResult(Buffer->Writing ? DestHandle : SourceHandle, &Buffer->Overlapped, &BytesTransferred, FALSE)) {
+            IoErr = GetLastError();
+            if (!Buffer->Writing && IoErr == ERROR_HANDLE_EOF) {
+                BytesTransferred = 0;
+            } else {
+                if (Err == ERROR_SUCCESS) {
+                    Err = IoErr;
+                }
+                Stop = TRUE;
+                continue;
+            }
+        }
+
+        if (Stop) {
+            continue;
+        }
+
+        if (!Buffer->Writing) {
+
+            //
+            //  A short read indicates the end of the source.  Reads
+            //  already issued beyond it will return no data.
+            //
+
+            if (BytesTransferred < Buffer->RequestLength) {
+                EndOfSource = TRUE;
+            }
+
+            if (Cursor.MaximumLength.QuadPart != 0 &&
+                Buffer->Offset.QuadPart + BytesTransferred > Cursor.MaximumLength.QuadPart) {
+
+                BytesTransferred = (DWORD)(Cursor.MaximumLength.QuadPart - Buffer->Offset.QuadPart);
+            }
+
+            if (BytesTransferred == 0) {
+                continue;
+            }
+
+            Buffer->DataLength = BytesTransferred;
+            Buffer->Offset.QuadPart = Buffer->Offset.QuadPart - Params->SourceOffset.QuadPart + Params->DestOffset.QuadPart;
+            if (Buffer->Offset.QuadPart + BytesTransferred > EndOfData.QuadPart) {
+                EndOfData.QuadPart = Buffer->Offset.QuadPart + BytesTransferred;
+            }
+
+            WriteLength = (BytesTransferred + Alignment - 1) / Alignment * Alignment;
+            if (WriteLength > BytesTransferred) {
+                ZeroMemory((PUCHAR)Buffer->Buffer + BytesTransferred, WriteLength - BytesTransferred);
+            }
+
+            if (Params->DigestComputed) {
+                Params->Digest = Params->Digest +
+                    YoriLibCopyDataDigestBuffer(Buffer->Buffer,
+                                                BytesTransferred,
+                                                Buffer->Offset.QuadPart - Params->DestOffset.QuadPart);
+            }
+
+            //
+            //  If the block is entirely zero, leave the destination range
+            //  unwritten, and reuse the buffer for the next read as if the
+            //  write had completed.
+            //
+
+            if (SkipZeroBlocks && YoriLibCopyDataIsZero(Buffer->Buffer, WriteLength)) {
+                Params->BytesCopied.QuadPart = Params->BytesCopied.QuadPart + BytesTransferred;
+                Params->ZeroBytesSkipped.QuadPart = Params->ZeroBytesSkipped.QuadPart + BytesTransferred;
+
+                if (EndOfSource) {
+                    continue;
+                }
+
+                IoErr = YoriLibCopyDataStartRead(SourceHandle, Buffer, &Cursor, &EndOfSource);
+                if (IoErr != ERROR_SUCCESS) {
+                    Err = IoErr;
+                    Stop = TRUE;
+                } else if (Buffer->Active) {
+                    ActiveCount++;
+                }
+                continue;
+            }
+
+            IoErr = YoriLibCopyDataStartIo(DestHandle, Buffer, WriteLength, TRUE);
+            if (IoErr != ERROR_SUCCESS) {
+                Err = IoErr;
+                Stop = TRUE;
+                continue;
+            }
+            ActiveCount++;
+
+        } else {
+
+            Params->BytesCopied.QuadPart = Params->BytesCopied.QuadPart + Buffer->DataLength;
+
+            if (EndOfSource) {
+                continue;
+            }
+
+            IoErr = YoriLibCopyDataStartRead(SourceHandle, Buffer, &Cursor, &EndOfSource);
+            if (IoErr != ERROR_SUCCESS) {
+                Err = IoErr;
+                Stop = TRUE;
+            } else if (Buffer->Active) {
+                ActiveCount++;
+            }
+        }
+    }
+
+    //
+    //  If the destination is a file, remove any padding written after the
+    //  end of the data.  Sparse files may end in a hole, so are set to the
+    //  size of the source.
+    //
+
+    if (Err == ERROR_SUCCESS && DestSectorSize == 0) {
+        if (Cursor.Sparse) {
+            EndOfData.QuadPart = FileSize.QuadPart;
+        }
+        Err = YoriLibCopyDataSetEndOfFile(DestHandle, EndOfData.QuadPart);
+    }
+
+    if (Params->DigestComputed) {
+        Params->DigestLength.QuadPart = EndOfData.QuadPart - Params->DestOffset.QuadPart;
+    }
+
+    for (Index = 0; Index < BufferCount; Index++) {
+        if (Buffers[Index].Overlapped.hEvent != NULL) {
+            CloseHandle(Buffers[Index].Overlapped.hEvent);
+        }
+    }
+
+    VirtualFree(BufferMemory, 0, MEM_RELEASE);
+    YoriLibFree(Buffers);
+
+    Params->ElapsedTime.QuadPart = YoriLibGetSystemTimeAsInteger() - StartTime;
+    return Err;
+}
 
 // vim:sw=4:ts=4:et:
@@ -1020,6 +1020,1192 @@ YoriLibPathLocateKnownExtensionUnknownLocation(
 }
 
 
+/**
+ Information about a single directory within the path.
+ */
+typedef struct _YORI_LIB_PATH_INDEX_DIR {
+
+    /**
+     The entry for this directory within the list of directories, in the
+     order they occur in the path.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The list of files found in this directory.
+     */
+    YORI_LIST_ENTRY FileList;
+
+    /**
+     The name of the directory, as specified in the path.
+     */
+    YORI_STRING DirName;
+
+    /**
+     A change notification handle which is signalled when a file is added,
+     removed or renamed within the directory.  This is NULL if no
+     notification could be registered.
+     */
+    HANDLE ChangeHandle;
+
+    /**
+     The position of this directory within the path.
+     */
+    DWORD Order;
+
+    /**
+     TRUE if FileList describes the contents of the directory.  If FALSE,
+     the directory needs to be searched each time it is used.
+     */
+    BOOLEAN Indexed;
+} YORI_LIB_PATH_INDEX_DIR, *PYORI_LIB_PATH_INDEX_DIR;
+
+/**
+ Information about a single file within a directory in the path.
+ */
+typedef struct _YORI_LIB_PATH_INDEX_FILE {
+
+    /**
+     The entry for this file within the hash table of all files.  This is
+     only inserted for the first directory in the path containing a file
+     with this name, since that is the one a search would find.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The entry for this file within the directory's list of files.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     Pointer to the directory containing the file.
+     */
+    PYORI_LIB_PATH_INDEX_DIR Dir;
+
+    /**
+     The name of the file, as returned by enumerating the directory.  The
+     characters follow this structure.
+     */
+    YORI_STRING FileName;
+
+    /**
+     Pointer to the next file with the same name in a later directory in
+     the path.  Files with the same name are chained, in path order, from
+     the file that is inserted into the hash table, so a search for all
+     matches does not need to enumerate directories.
+     */
+    struct _YORI_LIB_PATH_INDEX_FILE *NextWithSameName;
+
+    /**
+     TRUE if HashEntry is inserted into the hash table.
+     */
+    BOOLEAN Inserted;
+} YORI_LIB_PATH_INDEX_FILE, *PYORI_LIB_PATH_INDEX_FILE;
+
+/**
+ The state of the path index for the process.
+ */
+typedef struct _YORI_LIB_PATH_INDEX {
+
+    /**
+     A mutex synchronizing access to the index.  This is NULL if the index
+     has not been enabled.
+     */
+    HANDLE Mutex;
+
+    /**
+     The value of the PATH environment variable when the index was built.
+     */
+    YORI_STRING PathValue;
+
+    /**
+     The list of directories in the path.
+     */
+    YORI_LIST_ENTRY DirList;
+
+    /**
+     A hash table of file names, finding the first file in path order with
+     each name.
+     */
+    PYORI_HASH_TABLE Files;
+
+    /**
+     The number of directories within DirList.
+     */
+    DWORD DirCount;
+
+    /**
+     The number of callers that have enabled the index.  The index is freed
+     when the last of these calls @ref YoriLibPathIndexCleanup .
+     */
+    DWORD EnableCount;
+} YORI_LIB_PATH_INDEX;
+
+/**
+ The path index for the process.
+ */
+YORI_LIB_PATH_INDEX YoriLibPathIndex;
+
+/**
+ Remove every file from the hash table of files, leaving each file in its
+ directory's list and not chained to any other file.
+ */
+VOID
+YoriLibPathIndexRemoveAllFromHash(VOID)
+{
+    PYORI_LIST_ENTRY DirEntry;
+    PYORI_LIST_ENTRY FileEntry;
+    PYORI_LIB_PATH_INDEX_DIR Dir;
+    PYORI_LIB_PATH_INDEX_FILE File;
+
+    DirEntry = YoriLibGetNextListEntry(&YoriLibPathIndex.DirList, NULL);
+    while (DirEntry != NULL) {
+        Dir = CONTAINING_RECORD(DirEntry, YORI_LIB_PATH_INDEX_DIR, ListEntry);
+        FileEntry = YoriLibGetNextListEntry(&Dir->FileList, NULL);
+        while (FileEntry != NULL) {
+            File = CONTAINING_RECORD(FileEntry, YORI_LIB_PATH_INDEX_FILE, ListEntry);
+            if (File->Inserted) {
+                YoriLibHashRemoveByEntry(&File->HashEntry);
+                File->Inserted = FALSE;
+            }
+            File->NextWithSameName = NULL;
+            FileEntry = YoriLibGetNextListEntry(&Dir->FileList, FileEntry);
+        }
+        DirEntry = YoriLibGetNextListEntry(&YoriLibPathIndex.DirList, DirEntry);
+    }
+}
+
+/**
+ Insert the first file with each name, in path order, into the hash table
+ of files, and chain later files with the same name to it.
+ */
+VOID
+YoriLibPathIndexInsertAllIntoHash(VOID)
+{
+    PYORI_LIST_ENTRY DirEntry;
+    PYORI_LIST_ENTRY FileEntry;
+    PYORI_LIB_PATH_INDEX_DIR Dir;
+    PYORI_LIB_PATH_INDEX_FILE File;
+    PYORI_LIB_PATH_INDEX_FILE PriorFile;
+    PYORI_HASH_ENTRY HashEntry;
+
+    DirEntry = YoriLibGetNextListEntry(&YoriLibPathIndex.DirList, NULL);
+    while (DirEntry != NULL) {
+        Dir = CONTAINING_RECORD(DirEntry, YORI_LIB_PATH_INDEX_DIR, ListEntry);
+        FileEntry = YoriLibGetNextListEntry(&Dir->FileList, NULL);
+        while (FileEntry != NULL) {
+            File = CONTAINING_RECORD(FileEntry, YORI_LIB_PATH_INDEX_FILE, ListEntry);
+            ASSERT(!File->Inserted);
+            ASSERT(File->NextWithSameName == NULL);
+            HashEntry = YoriLibHashLookupByKey(YoriLibPathIndex.Files, &File->FileName);
+            if (HashEntry == NULL) {
+                YoriLibHashInsertByKey(YoriLibPathIndex.Files, &File->FileName, File, &File->HashEntry);
+                File->Inserted = TRUE;
+            } else {
+                PriorFile = HashEntry->Context;
+                while (PriorFile->NextWithSameName != NULL) {
+                    PriorFile = PriorFile->NextWithSameName;
+                }
+                PriorFile->NextWithSameName = File;
+            }
+            FileEntry = YoriLibGetNextListEntry(&Dir->FileList, FileEntry);
+        }
+        DirEntry = YoriLibGetNextListEntry(&YoriLibPathIndex.DirList, DirEntry);
+    }
+}
+
+/**
+ Free the list of files found in a directory.  The files must have been
+ removed from the hash table.
+
+ @param Dir Pointer to the directory.
+ */
+VOID
+YoriLibPathIndexFreeDirFiles(
+    __inout PYORI_LIB_PATH_INDEX_DIR Dir
+    )
+{
+    PYORI_LIST_ENTRY FileEntry;
+    PYORI_LIB_PATH_INDEX_FILE File;
+
+    FileEntry = YoriLibGetNextListEntry(&Dir->FileList, NULL);
+    while (FileEntry != NULL) {
+        File = CONTAINING_RECORD(FileEntry, YORI_LIB_PATH_INDEX_FILE, ListEntry);
+        FileEntry = YoriLibGetNextListEntry(&Dir->FileList, FileEntry);
+        ASSERT(!File->Inserted);
+        YoriLibRemoveListItem(&File->ListEntry);
+        YoriLibFree(File);
+    }
+    Dir->Indexed = FALSE;
+}
+
+/**
+ Enumerate the contents of a directory in the path.  If this fails, the
+ directory is marked as not indexed, and it will be searched directly.
+
+ @param Dir Pointer to the directory.
+ */
+VOID
+YoriLibPathIndexEnumerateDir(
+    __inout PYORI_LIB_PATH_INDEX_DIR Dir
+    )
+{
+    YORI_STRING SearchName;
+    PYORI_LIB_PATH_INDEX_FILE File;
+    WIN32_FIND_DATA FindData;
+    YORI_ALLOC_SIZE_T FileNameLength;
+    HANDLE hFind;
+
+    ASSERT(YoriLibIsListEmpty(&Dir->FileList));
+    Dir->Indexed = FALSE;
+
+    //
+    //  Only directories with a change notification can be indexed, since
+    //  without one there is no way to know the index is current.
+    //
+
+    if (Dir->ChangeHandle == NULL) {
+        return;
+    }
+
+    if (!YoriLibAllocateString(&SearchName, Dir->DirName.LengthInChars + sizeof("\\*"))) {
+        return;
+    }
+
+    if (Dir->DirName.LengthInChars > 0 &&
+        YoriLibIsSep(Dir->DirName.StartOfString[Dir->DirName.LengthInChars - 1])) {
+
+        SearchName.LengthInChars = YoriLibSPrintf(SearchName.StartOfString, _T("%y*"), &Dir->DirName);
+    } else {
+        SearchName.LengthInChars = YoriLibSPrintf(SearchName.StartOfString, _T("%y\\*"), &Dir->DirName);
+    }
+
+    hFind = FindFirstNonDirectoryFile(SearchName.StartOfString, &FindData);
+    YoriLibFreeStringContents(&SearchName);
+    if (hFind == INVALID_HANDLE_VALUE) {
+        if (GetLastError() == ERROR_FILE_NOT_FOUND) {
+            Dir->Indexed = TRUE;
+        }
+        return;
+    }
+
+    do {
+        FileNameLength = (YORI_ALLOC_SIZE_T)_tcslen(FindData.cFileName);
+        File = YoriLibMalloc(sizeof(YORI_LIB_PATH_INDEX_FILE) + (FileNameLength + 1) * sizeof(TCHAR));
+        if (File == NULL) {
+            FindClose(hFind);
+            YoriLibPathIndexFreeDirFiles(Dir);
+            return;
+        }
+
+        ZeroMemory(File, sizeof(YORI_LIB_PATH_INDEX_FILE));
+        File->Dir = Dir;
+        YoriLibInitEmptyString(&File->FileName);
+        File->FileName.StartOfString = (LPTSTR)(File + 1);
+        File->FileName.LengthInChars = FileNameLength;
+        File->FileName.LengthAllocated = FileNameLength + 1;
+        memcpy(File->FileName.StartOfString, FindData.cFileName, (FileNameLength + 1) * sizeof(TCHAR));
+        YoriLibAppendList(&Dir->FileList, &File->ListEntry);
+
+    } while (FindNextNonDirectoryFile(hFind, &FindData));
+
+    FindClose(hFind);
+    Dir->Indexed = TRUE;
+}
+
+/**
+ Free all directories and files within the index, leaving it enabled but
+ empty.
+ */
+VOID
+YoriLibPathIndexFreeAll(VOID)
+{
+    PYORI_LIST_ENTRY DirEntry;
+    PYORI_LIB_PATH_INDEX_DIR Dir;
+
+    YoriLibPathIndexRemoveAllFromHash();
+
+    DirEntry = YoriLibGetNextListEntry(&YoriLibPathIndex.DirList, NULL);
+    while (DirEntry != NULL) {
+        Dir = CONTAINING_RECORD(DirEntry, YORI_LIB_PATH_INDEX_DIR, ListEntry);
+        DirEntry = YoriLibGetNextListEntry(&YoriLibPathIndex.DirList, DirEntry);
+        YoriLibPathIndexFreeDirFiles(Dir);
+        if (Dir->ChangeHandle != NULL) {
+            FindCloseChangeNotification(Dir->ChangeHandle);
+        }
+        YoriLibRemoveListItem(&Dir->ListEntry);
+        YoriLibFree(Dir);
+    }
+
+    YoriLibPathIndex.DirCount = 0;
+    YoriLibFreeStringContents(&YoriLibPathIndex.PathValue);
+}
+
+/**
+ Construct the list of directories from a value of the PATH environment
+ variable and enumerate each of them.
+
+ @param PathValue Pointer to the value of the PATH environment variable.
+        This string is retained by the index.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibPathIndexBuild(
+    __in PYORI_STRING PathValue
+    )
+{
+    PYORI_LIB_PATH_INDEX_DIR Dir;
+    YORI_STRING Remaining;
+    YORI_STRING Component;
+    YORI_ALLOC_SIZE_T Index;
+
+    ASSERT(YoriLibIsListEmpty(&YoriLibPathIndex.DirList));
+    YoriLibCloneString(&YoriLibPathIndex.PathValue, PathValue);
+
+    YoriLibInitEmptyString(&Remaining);
+    Remaining.StartOfString = PathValue->StartOfString;
+    Remaining.LengthInChars = PathValue->LengthInChars;
+
+    while (Remaining.LengthInChars > 0) {
+        YoriLibInitEmptyString(&Component);
+        Component.StartOfString = Remaining.StartOfString;
+        for (Index = 0; Index < Remaining.LengthInChars; Index++) {
+            if (Remaining.StartOfString[Index] == ';') {
+                break;
+            }
+        }
+        Component.LengthInChars = Index;
+
+        if (Index < Remaining.LengthInChars) {
+            Index++;
+        }
+        Remaining.StartOfString = Remaining.StartOfString + Index;
+        Remaining.LengthInChars = Remaining.LengthInChars - Index;
+
+        if (Component.LengthInChars == 0) {
+            continue;
+        }
+
+        Dir = YoriLibMalloc(sizeof(YORI_LIB_PATH_INDEX_DIR) + (Component.LengthInChars + 1) * sizeof(TCHAR));
+        if (Dir == NULL) {
+            YoriLibPathIndexFreeAll();
+            return FALSE;
+        }
+
+        ZeroMemory(Dir, sizeof(YORI_LIB_PATH_INDEX_DIR));
+        YoriLibInitializeListHead(&Dir->FileList);
+        YoriLibInitEmptyString(&Dir->DirName);
+        Dir->DirName.StartOfString = (LPTSTR)(Dir + 1);
+        Dir->DirName.LengthInChars = Component.LengthInChars;
+        Dir->DirName.LengthAllocated = Component.LengthInChars + 1;
+        memcpy(Dir->DirName.StartOfString, Component.StartOfString, Component.LengthInChars * sizeof(TCHAR));
+        Dir->DirName.StartOfString[Component.LengthInChars] = '\0';
+        Dir->Order = YoriLibPathIndex.DirCount;
+        YoriLibPathIndex.DirCount++;
+        YoriLibAppendList(&YoriLibPathIndex.DirList, &Dir->ListEntry);
+
+        //
+        //  A relative path refers to a different location as the current
+        //  directory changes, so it is always searched directly.  The
+        //  notification is registered before enumerating so that changes
+        //  made during the enumerate are detected.
+        //
+
+        if (YoriLibIsDrvLetterColonSlash(&Dir->DirName) ||
+            (Dir->DirName.LengthInChars > 2 &&
+             YoriLibIsSep(Dir->DirName.StartOfString[0]) &&
+             YoriLibIsSep(Dir->DirName.StartOfString[1]))) {
+
+            Dir->ChangeHandle = FindFirstChangeNotification(Dir->DirName.StartOfString, FALSE, FILE_NOTIFY_CHANGE_FILE_NAME);
+            if (Dir->ChangeHandle == INVALID_HANDLE_VALUE) {
+                Dir->ChangeHandle = NULL;
+            }
+        }
+
+        YoriLibPathIndexEnumerateDir(Dir);
+    }
+
+    YoriLibPathIndexInsertAllIntoHash();
+    return TRUE;
+}
+
+/**
+ Ensure the index reflects the current PATH environment variable and the
+ current contents of each directory.  Directories whose change notification
+ has been signalled are enumerated again.
+
+ @return TRUE to indicate the index is current, FALSE if it could not be
+         constructed.
+ */
+__success(return)
+BOOLEAN
+YoriLibPathIndexRefresh(VOID)
+{
+    PYORI_LIST_ENTRY DirEntry;
+    PYORI_LIB_PATH_INDEX_DIR Dir;
+    YORI_STRING PathValue;
+    BOOLEAN Changed;
+
+    YoriLibInitEmptyString(&PathValue);
+    if (!YoriLibAllocateAndGetEnvVar(_T("PATH"), &PathValue)) {
+        YoriLibPathIndexFreeAll();
+        return FALSE;
+    }
+
+    if (YoriLibCompareString(&PathValue, &YoriLibPathIndex.PathValue) != 0) {
+
+        YoriLibPathIndexFreeAll();
+        if (!YoriLibPathIndexBuild(&PathValue)) {
+            YoriLibFreeStringContents(&PathValue);
+            return FALSE;
+        }
+        YoriLibFreeStringContents(&PathValue);
+        return TRUE;
+    }
+
+    YoriLibFreeStringContents(&PathValue);
+
+    Changed = FALSE;
+    DirEntry = YoriLibGetNextListEntry(&YoriLibPathIndex.DirList, NULL);
+    while (DirEntry != NULL) {
+        Dir = CONTAINING_RECORD(DirEntry, YORI_LIB_PATH_INDEX_DIR, ListEntry);
+        if (Dir->ChangeHandle != NULL &&
+            WaitForSingleObject(Dir->ChangeHandle, 0) == WAIT_OBJECT_0) {
+
+            if (!Changed) {
+                YoriLibPathIndexRemoveAllFromHash();
+                Changed = TRUE;
+            }
+
+            YoriLibPathIndexFreeDirFiles(Dir);
+            if (!FindNextChangeNotification(Dir->ChangeHandle)) {
+                FindCloseChangeNotification(Dir->ChangeHandle);
+                Dir->ChangeHandle = NULL;
+            }
+            YoriLibPathIndexEnumerateDir(Dir);
+        }
+        DirEntry = YoriLibGetNextListEntry(&YoriLibPathIndex.DirList, DirEntry);
+    }
+
+    if (Changed) {
+        YoriLibPathIndexInsertAllIntoHash();
+    }
+
+    return TRUE;
+}
+
+/**
+ Search directories in the path which are not indexed for a file, stopping
+ at a specified directory.  This is used to ensure that a match found in the
+ index is not preceded by a match in a directory that cannot be indexed.
+
+ @param SearchFor The file name to search for.
+
+ @param ExactName If TRUE, SearchFor contains an extension and only a file
+        with exactly that name is searched for.  If FALSE, each extension in
+        PathExtComponents is appended.
+
+ @param StopOrder The order of the first directory which should not be
+        searched.
+
+ @param PathExtComponents The array of extensions to search for.
+
+ @param PathExtCount The number of elements in PathExtComponents.
+
+ @param FoundPath On successful completion, updated to contain the full path
+        to any match.  If no match is found, this contains an empty string.
+
+ @return TRUE to indicate the search was successful, FALSE to indicate
+         failure.  Success does not imply a match was found.
+ */
+__success(return)
+BOOLEAN
+YoriLibPathIndexSearchUnindexed(
+    __in PYORI_STRING SearchFor,
+    __in BOOLEAN ExactName,
+    __in DWORD StopOrder,
+    __inout PYORI_PATHEXT_COMPONENT PathExtComponents,
+    __in YORI_ALLOC_SIZE_T PathExtCount,
+    __inout PYORI_STRING FoundPath
+    )
+{
+    PYORI_LIST_ENTRY DirEntry;
+    PYORI_LIB_PATH_INDEX_DIR Dir;
+    YORI_STRING ScratchArea;
+    YORI_STRING SearchName;
+    WIN32_FIND_DATA FindData;
+    HANDLE hFind;
+
+    YoriLibInitEmptyString(&ScratchArea);
+    DirEntry = YoriLibGetNextListEntry(&YoriLibPathIndex.DirList, NULL);
+    while (DirEntry != NULL) {
+        Dir = CONTAINING_RECORD(DirEntry, YORI_LIB_PATH_INDEX_DIR, ListEntry);
+        if (Dir->Order >= StopOrder) {
+            break;
+        }
+
+        if (!Dir->Indexed) {
+            if (ExactName) {
+                if (!YoriLibAllocateString(&SearchName, Dir->DirName.LengthInChars + 1 + SearchFor->LengthInChars + 1)) {
+                    YoriLibFreeStringContents(&ScratchArea);
+                    return FALSE;
+                }
+                SearchName.LengthInChars = YoriLibSPrintf(SearchName.StartOfString, _T("%y\\%y"), &Dir->DirName, SearchFor);
+                hFind = FindFirstNonDirectoryFile(SearchName.StartOfString, &FindData);
+                YoriLibFreeStringContents(&SearchName);
+                if (hFind != INVALID_HANDLE_VALUE) {
+                    FindClose(hFind);
+                    if (!YoriLibLocateBuildFullName(&Dir->DirName, &FindData, FoundPath, FALSE)) {
+                        YoriLibFreeStringContents(&ScratchArea);
+                        return FALSE;
+                    }
+                }
+            } else {
+                if (!YoriLibLocateFileExtensionsInOnePath(SearchFor,
+                                                          &Dir->DirName,
+                                                          &ScratchArea,
+                                                          PathExtComponents,
+                                                          PathExtCount,
+                                                          NULL,
+                                                          NULL,
+                                                          FoundPath,
+                                                          FALSE)) {
+                    YoriLibFreeStringContents(&ScratchArea);
+                    return FALSE;
+                }
+            }
+
+            if (FoundPath->StartOfString[0] != '\0') {
+                break;
+            }
+        }
+
+        DirEntry = YoriLibGetNextListEntry(&YoriLibPathIndex.DirList, DirEntry);
+    }
+
+    YoriLibFreeStringContents(&ScratchArea);
+    return TRUE;
+}
+
+/**
+ Construct the full path to a file found in the index.
+
+ @param File Pointer to the file.
+
+ @param FoundPath On successful completion, updated to contain the full path
+        to the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibPathIndexBuildFullName(
+    __in PYORI_LIB_PATH_INDEX_FILE File,
+    __inout PYORI_STRING FoundPath
+    )
+{
+    WIN32_FIND_DATA FindData;
+
+    if (File->FileName.LengthInChars >= sizeof(FindData.cFileName)/sizeof(FindData.cFileName[0])) {
+        return FALSE;
+    }
+
+    ZeroMemory(&FindData, sizeof(FindData));
+    memcpy(FindData.cFileName, File->FileName.StartOfString, (File->FileName.LengthInChars + 1) * sizeof(TCHAR));
+    if (!YoriLibLocateBuildFullName(&File->Dir->DirName, &FindData, FoundPath, FALSE)) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Find a file with a specified name within a single indexed directory.
+
+ @param Dir Pointer to the directory, which must be indexed.
+
+ @param FileName The name of the file to find.
+
+ @return Pointer to the file, or NULL if the directory does not contain a
+         file with this name.
+ */
+PYORI_LIB_PATH_INDEX_FILE
+YoriLibPathIndexFindInDir(
+    __in PYORI_LIB_PATH_INDEX_DIR Dir,
+    __in PYORI_STRING FileName
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_LIB_PATH_INDEX_FILE File;
+
+    ASSERT(Dir->Indexed);
+
+    HashEntry = YoriLibHashLookupByKey(YoriLibPathIndex.Files, FileName);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+
+    //
+    //  The chain is in path order, so stop once it passes this directory.
+    //
+
+    File = HashEntry->Context;
+    while (File != NULL && File->Dir->Order <= Dir->Order) {
+        if (File->Dir == Dir) {
+            return File;
+        }
+        File = File->NextWithSameName;
+    }
+
+    return NULL;
+}
+
+/**
+ Search the path for a file, using the index where possible.
+
+ @param SearchFor The file name to search for.
+
+ @param ExactName If TRUE, SearchFor contains an extension and only a file
+        with exactly that name is searched for.  If FALSE, each extension in
+        PathExtComponents is appended.
+
+ @param PathExtComponents The array of extensions to search for.
+
+ @param PathExtCount The number of elements in PathExtComponents.
+
+ @param FoundPath On successful completion, updated to contain the full path
+        to any match.  If no match is found, this contains an empty string.
+
+ @return TRUE to indicate the search was successful, FALSE to indicate
+         failure.  Success does not imply a match was found.
+ */
+__success(return)
+BOOLEAN
+YoriLibPathIndexSearchPath(
+    __in PYORI_STRING SearchFor,
+    __in BOOLEAN ExactName,
+    __inout PYORI_PATHEXT_COMPONENT PathExtComponents,
+    __in YORI_ALLOC_SIZE_T PathExtCount,
+    __inout PYORI_STRING FoundPath
+    )
+{
+    PYORI_LIB_PATH_INDEX_FILE Best;
+    PYORI_LIB_PATH_INDEX_FILE File;
+    PYORI_HASH_ENTRY HashEntry;
+    YORI_STRING Candidate;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_ALLOC_SIZE_T LongestExtension;
+    DWORD StopOrder;
+
+    Best = NULL;
+    if (ExactName) {
+        HashEntry = YoriLibHashLookupByKey(YoriLibPathIndex.Files, SearchFor);
+        if (HashEntry != NULL) {
+            Best = HashEntry->Context;
+        }
+    } else {
+
+        LongestExtension = 0;
+        for (Count = 0; Count < PathExtCount; Count++) {
+            if (PathExtComponents[Count].Extension.LengthInChars > LongestExtension) {
+                LongestExtension = PathExtComponents[Count].Extension.LengthInChars;
+            }
+        }
+
+        if (!YoriLibAllocateString(&Candidate, SearchFor->LengthInChars + LongestExtension + 1)) {
+            return FALSE;
+        }
+
+        //
+        //  A search finds the first directory containing a match for any
+        //  extension, and within that directory, the first extension.
+        //
+
+        for (Count = 0; Count < PathExtCount; Count++) {
+            Candidate.LengthInChars = YoriLibSPrintf(Candidate.StartOfString, _T("%y%y"), SearchFor, &PathExtComponents[Count].Extension);
+            HashEntry = YoriLibHashLookupByKey(YoriLibPathIndex.Files, &Candidate);
+            if (HashEntry != NULL) {
+                File = HashEntry->Context;
+                if (Best == NULL || File->Dir->Order < Best->Dir->Order) {
+                    Best = File;
+                }
+            }
+        }
+
+        YoriLibFreeStringContents(&Candidate);
+    }
+
+    StopOrder = YoriLibPathIndex.DirCount;
+    if (Best != NULL) {
+        StopOrder = Best->Dir->Order;
+    }
+
+    if (!YoriLibPathIndexSearchUnindexed(SearchFor, ExactName, StopOrder, PathExtComponents, PathExtCount, FoundPath)) {
+        return FALSE;
+    }
+
+    if (FoundPath->StartOfString[0] != '\0' || Best == NULL) {
+        return TRUE;
+    }
+
+    return YoriLibPathIndexBuildFullName(Best, FoundPath);
+}
+
+/**
+ Search the current directory and then the path for a file, using the index
+ for directories in the path.  This follows the same order as
+ @ref YoriLibLocateExecutableInPath .
+
+ @param SearchFor The file name to search for.  This should not contain a
+        path component.
+
+ @param HasExtension TRUE if SearchFor contains an extension, in which case
+        files with exactly that name are searched for before PATHEXT is
+        applied.
+
+ @param FoundPath On successful completion, updated to contain the full path
+        to any match.  If no match is found, this contains an empty string.
+
+ @return TRUE to indicate the search was successful, FALSE to indicate
+         failure.  Success does not imply a match was found.
+ */
+__success(return)
+BOOLEAN
+YoriLibPathIndexSearch(
+    __in PYORI_STRING SearchFor,
+    __in BOOLEAN HasExtension,
+    __inout PYORI_STRING FoundPath
+    )
+{
+    PYORI_PATHEXT_COMPONENT PathExtComponents;
+    YORI_ALLOC_SIZE_T PathExtCount;
+    YORI_STRING CurrentDirectory;
+    YORI_STRING ScratchArea;
+    WIN32_FIND_DATA FindData;
+    HANDLE hFind;
+
+    PathExtComponents = YoriLibPathBuildPathExtComponentList(&PathExtCount);
+    if (PathExtComponents == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  The current directory changes too frequently to index, so it is
+    //  always searched directly.
+    //
+
+    YoriLibConstantString(&CurrentDirectory, _T("."));
+    FoundPath->StartOfString[0] = '\0';
+    FoundPath->LengthInChars = 0;
+
+    if (HasExtension) {
+        hFind = FindFirstNonDirectoryFile(SearchFor->StartOfString, &FindData);
+        if (hFind != INVALID_HANDLE_VALUE) {
+            FindClose(hFind);
+            if (!YoriLibLocateBuildFullName(&CurrentDirectory, &FindData, FoundPath, FALSE)) {
+                YoriLibPathFreePathExtComponents(PathExtComponents, PathExtCount);
+                return FALSE;
+            }
+        }
+
+        if (FoundPath->StartOfString[0] == '\0' &&
+            !YoriLibPathIndexSearchPath(SearchFor, TRUE, PathExtComponents, PathExtCount, FoundPath)) {
+
+            YoriLibPathFreePathExtComponents(PathExtComponents, PathExtCount);
+            return FALSE;
+        }
+    }
+
+    if (FoundPath->StartOfString[0] == '\0') {
+        YoriLibInitEmptyString(&ScratchArea);
+        if (!YoriLibLocateFileExtensionsInOnePath(SearchFor,
+                                                  &CurrentDirectory,
+                                                  &ScratchArea,
+                                                  PathExtComponents,
+                                                  PathExtCount,
+                                                  NULL,
+                                                  NULL,
+                                                  FoundPath,
+                                                  FALSE)) {
+            YoriLibFreeStringContents(&ScratchArea);
+            YoriLibPathFreePathExtComponents(PathExtComponents, PathExtCount);
+            return FALSE;
+        }
+        YoriLibFreeStringContents(&ScratchArea);
+    }
+
+    if (FoundPath->StartOfString[0] == '\0' &&
+        !YoriLibPathIndexSearchPath(SearchFor, FALSE, PathExtComponents, PathExtCount, FoundPath)) {
+
+        YoriLibPathFreePathExtComponents(PathExtComponents, PathExtCount);
+        return FALSE;
+    }
+
+    YoriLibPathFreePathExtComponents(PathExtComponents, PathExtCount);
+    return TRUE;
+}
+
+/**
+ Search the current directory and then the path for every match of a file,
+ using the index for directories in the path.  This reports matches in the
+ same order as @ref YoriLibLocateExecutableInPath would when searching the
+ path directly.
+
+ @param SearchFor The file name to search for.  This should not contain a
+        path component.
+
+ @param HasExtension TRUE if SearchFor contains an extension, in which case
+        files with exactly that name are reported before PATHEXT is
+        applied.
+
+ @param MatchAllCallback The callback to invoke for each match.  If this
+        returns FALSE, the search ends.
+
+ @param MatchAllContext Context information to supply to MatchAllCallback.
+
+ @param FoundPath A buffer used to construct the full path to each match.
+
+ @return TRUE to indicate the search completed, FALSE to indicate it ended
+         because of a failure or because MatchAllCallback requested it.
+ */
+__success(return)
+BOOLEAN
+YoriLibPathIndexSearchAll(
+    __in PYORI_STRING SearchFor,
+    __in BOOLEAN HasExtension,
+    __in PYORI_LIB_PATH_MATCH_FN MatchAllCallback,
+    __in_opt PVOID MatchAllContext,
+    __inout PYORI_STRING FoundPath
+    )
+{
+    PYORI_PATHEXT_COMPONENT PathExtComponents;
+    YORI_ALLOC_SIZE_T PathExtCount;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_ALLOC_SIZE_T LongestExtension;
+    PYORI_LIST_ENTRY DirEntry;
+    PYORI_LIB_PATH_INDEX_DIR Dir;
+    PYORI_LIB_PATH_INDEX_FILE File;
+    YORI_STRING CurrentDirectory;
+    YORI_STRING ScratchArea;
+    YORI_STRING SearchName;
+    YORI_STRING Candidate;
+    WIN32_FIND_DATA FindData;
+    HANDLE hFind;
+    BOOLEAN Result;
+
+    PathExtComponents = YoriLibPathBuildPathExtComponentList(&PathExtCount);
+    if (PathExtComponents == NULL) {
+        return FALSE;
+    }
+
+    LongestExtension = 0;
+    for (Count = 0; Count < PathExtCount; Count++) {
+        if (PathExtComponents[Count].Extension.LengthInChars > LongestExtension) {
+            LongestExtension = PathExtComponents[Count].Extension.LengthInChars;
+        }
+    }
+
+    if (!YoriLibAllocateString(&Candidate, SearchFor->LengthInChars + LongestExtension + 1)) {
+        YoriLibPathFreePathExtComponents(PathExtComponents, PathExtCount);
+        return FALSE;
+    }
+
+    YoriLibConstantString(&CurrentDirectory, _T("."));
+    YoriLibInitEmptyString(&ScratchArea);
+    YoriLibInitEmptyString(&SearchName);
+    Result = FALSE;
+
+    //
+    //  If the name has an extension, report each file with exactly that
+    //  name, starting with the current directory.
+    //
+
+    if (HasExtension) {
+        hFind = FindFirstNonDirectoryFile(SearchFor->StartOfString, &FindData);
+        if (hFind != INVALID_HANDLE_VALUE) {
+            FindClose(hFind);
+            if (!YoriLibLocateBuildFullName(&CurrentDirectory, &FindData, FoundPath, FALSE) ||
+                !MatchAllCallback(FoundPath, MatchAllContext)) {
+
+                goto Exit;
+            }
+        }
+
+        DirEntry = YoriLibGetNextListEntry(&YoriLibPathIndex.DirList, NULL);
+        while (DirEntry != NULL) {
+            Dir = CONTAINING_RECORD(DirEntry, YORI_LIB_PATH_INDEX_DIR, ListEntry);
+            if (Dir->Indexed) {
+                File = YoriLibPathIndexFindInDir(Dir, SearchFor);
+                if (File != NULL) {
+                    if (!YoriLibPathIndexBuildFullName(File, FoundPath) ||
+                        !MatchAllCallback(FoundPath, MatchAllContext)) {
+
+                        goto Exit;
+                    }
+                }
+            } else {
+                if (!YoriLibAllocateString(&SearchName, Dir->DirName.LengthInChars + 1 + SearchFor->LengthInChars + 1)) {
+                    goto Exit;
+                }
+                SearchName.LengthInChars = YoriLibSPrintf(SearchName.StartOfString, _T("%y\\%y"), &Dir->DirName, SearchFor);
+                hFind = FindFirstNonDirectoryFile(SearchName.StartOfString, &FindData);
+                YoriLibFreeStringContents(&SearchName);
+                if (hFind != INVALID_HANDLE_VALUE) {
+                    FindClose(hFind);
+                    if (!YoriLibLocateBuildFullName(&Dir->DirName, &FindData, FoundPath, FALSE) ||
+                        !MatchAllCallback(FoundPath, MatchAllContext)) {
+
+                        goto Exit;
+                    }
+                }
+            }
+            DirEntry = YoriLibGetNextListEntry(&YoriLibPathIndex.DirList, DirEntry);
+        }
+    }
+
+    //
+    //  Report each file with an extension from PATHEXT, starting with the
+    //  current directory.  Within each directory, matches are reported in
+    //  PATHEXT order.
+    //
+
+    if (!YoriLibLocateFileExtensionsInOnePath(SearchFor,
+                                              &CurrentDirectory,
+                                              &ScratchArea,
+                                              PathExtComponents,
+                                              PathExtCount,
+                                              MatchAllCallback,
+                                              MatchAllContext,
+                                              FoundPath,
+                                              FALSE)) {
+        goto Exit;
+    }
+
+    DirEntry = YoriLibGetNextListEntry(&YoriLibPathIndex.DirList, NULL);
+    while (DirEntry != NULL) {
+        Dir = CONTAINING_RECORD(DirEntry, YORI_LIB_PATH_INDEX_DIR, ListEntry);
+        if (Dir->Indexed) {
+            for (Count = 0; Count < PathExtCount; Count++) {
+                Candidate.LengthInChars = YoriLibSPrintf(Candidate.StartOfString, _T("%y%y"), SearchFor, &PathExtComponents[Count].Extension);
+                File = YoriLibPathIndexFindInDir(Dir, &Candidate);
+                if (File != NULL) {
+                    if (!YoriLibPathIndexBuildFullName(File, FoundPath) ||
+                        !MatchAllCallback(FoundPath, MatchAllContext)) {
+
+                        goto Exit;
+                    }
+                }
+            }
+        } else {
+            if (!YoriLibLocateFileExtensionsInOnePath(SearchFor,
+                                                      &Dir->DirName,
+                                                      &ScratchArea,
+                                                      PathExtComponents,
+                                                      PathExtCount,
+                                                      MatchAllCallback,
+                                                      MatchAllContext,
+                                                      FoundPath,
+                                                      FALSE)) {
+                goto Exit;
+            }
+        }
+        DirEntry = YoriLibGetNextListEntry(&YoriLibPathIndex.DirList, DirEntry);
+    }
+
+    Result = TRUE;
+
+Exit:
+    YoriLibFreeStringContents(&Candidate);
+    YoriLibFreeStringContents(&ScratchArea);
+    YoriLibPathFreePathExtComponents(PathExtComponents, PathExtCount);
+    return Result;
+}
+
+/**
+ Attempt to resolve a file in the path using the index.  This is called
+ from @ref YoriLibLocateExecutableInPath for searches that are not qualified
+ with a path and are looking for a single result.
+
+ @param SearchFor The file name to search for.
+
+ @param HasExtension TRUE if SearchFor contains an extension.
+
+ @param PathName On successful completion, updated to contain a newly
+        allocated string containing the full path to any match.  If no match
+        is found, this contains an empty string.
+
+ @return TRUE to indicate the index answered the query, FALSE to indicate
+         that the caller should search the path directly.
+ */
+__success(return)
+BOOLEAN
+YoriLibPathIndexLocate(
+    __in PYORI_STRING SearchFor,
+    __in BOOLEAN HasExtension,
+    __out PYORI_STRING PathName
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    BOOLEAN Result;
+
+    if (YoriLibPathIndex.Mutex == NULL) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < SearchFor->LengthInChars; Index++) {
+        if (SearchFor->StartOfString[Index] == '*' ||
+            SearchFor->StartOfString[Index] == '?') {
+
+            return FALSE;
+        }
+    }
+
+    if (!YoriLibAllocateString(PathName, MAX_PATH)) {
+        return FALSE;
+    }
+
+    WaitForSingleObject(YoriLibPathIndex.Mutex, INFINITE);
+    Result = FALSE;
+    if (YoriLibPathIndexRefresh()) {
+        Result = YoriLibPathIndexSearch(SearchFor, HasExtension, PathName);
+    }
+    ReleaseMutex(YoriLibPathIndex.Mutex);
+
+    if (!Result) {
+        YoriLibFreeStringContents(PathName);
+    }
+
+    return Result;
+}
+
+/**
+ Attempt to report every match for a file in the path using the index.
+ This is called from @ref YoriLibLocateExecutableInPath for searches that
+ are not qualified with a path and are looking for all results.  The index
+ is locked while MatchAllCallback is invoked, so the callback must not
+ search the path itself.
+
+ @param SearchFor The file name to search for.
+
+ @param HasExtension TRUE if SearchFor contains an extension.
+
+ @param MatchAllCallback The callback to invoke for each match.
+
+ @param MatchAllContext Context information to supply to MatchAllCallback.
+
+ @return TRUE to indicate the index answered the query, FALSE to indicate
+         that the caller should search the path directly.  Once any match
+         has been reported the index is considered to have answered the
+         query, even if the search could not complete, so that matches are
+         not reported twice.
+ */
+__success(return)
+BOOLEAN
+YoriLibPathIndexLocateAll(
+    __in PYORI_STRING SearchFor,
+    __in BOOLEAN HasExtension,
+    __in PYORI_LIB_PATH_MATCH_FN MatchAllCallback,
+    __in_opt PVOID MatchAllContext
+    )
+{
+    YORI_STRING FoundPath;
+    YORI_ALLOC_SIZE_T Index;
+    BOOLEAN Result;
+
+    if (YoriLibPathIndex.Mutex == NULL) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < SearchFor->LengthInChars; Index++) {
+        if (SearchFor->StartOfString[Index] == '*' ||
+            SearchFor->StartOfString[Index] == '?') {
+
+            return FALSE;
+        }
+    }
+
+    if (!YoriLibAllocateString(&FoundPath, MAX_PATH)) {
+        return FALSE;
+    }
+
+    WaitForSingleObject(YoriLibPathIndex.Mutex, INFINITE);
+    Result = FALSE;
+    if (YoriLibPathIndexRefresh()) {
+        YoriLibPathIndexSearchAll(SearchFor, HasExtension, MatchAllCallback, MatchAllContext, &FoundPath);
+        Result = TRUE;
+    }
+    ReleaseMutex(YoriLibPathIndex.Mutex);
+
+    YoriLibFreeStringContents(&FoundPath);
+    return Result;
+}
+
+/**
+ Enable the index of directories in the path for this process.  Once
+ enabled, @ref YoriLibLocateExecutableInPath answers searches from the index
+ and only searches directories again when they change.  This is intended
+ for long running processes such as the shell, and the caller is expected to
+ call @ref YoriLibPathIndexCleanup before exiting.  Calls may be nested, so
+ a builtin command can enable the index while running within a shell that
+ has already enabled it.
+
+ @return TRUE to indicate the index was enabled, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibPathIndexEnable(VOID)
+{
+    if (YoriLibPathIndex.Mutex != NULL) {
+        YoriLibPathIndex.EnableCount++;
+        return TRUE;
+    }
+
+    YoriLibPathIndex.Files = YoriLibAllocateHashTable(1000);
+    if (YoriLibPathIndex.Files == NULL) {
+        return FALSE;
+    }
+
+    YoriLibPathIndex.Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (YoriLibPathIndex.Mutex == NULL) {
+        YoriLibFreeEmptyHashTable(YoriLibPathIndex.Files);
+        YoriLibPathIndex.Files = NULL;
+        return FALSE;
+    }
+
+    YoriLibInitializeListHead(&YoriLibPathIndex.DirList);
+    YoriLibInitEmptyString(&YoriLibPathIndex.PathValue);
+    YoriLibPathIndex.DirCount = 0;
+    YoriLibPathIndex.EnableCount = 1;
+    return TRUE;
+}
+
+/**
+ Release a caller's use of the index of directories in the path.  When the
+ last caller that enabled the index calls this, the index is freed and
+ searches return to searching the path directly.
+ */
+VOID
+YoriLibPathIndexCleanup(VOID)
+{
+    if (YoriLibPathIndex.Mutex == NULL) {
+        return;
+    }
+
+    ASSERT(YoriLibPathIndex.EnableCount > 0);
+    YoriLibPathIndex.EnableCount--;
+    if (YoriLibPathIndex.EnableCount > 0) {
+        return;
+    }
+
+    YoriLibPathIndexFreeAll();
+    YoriLibFreeEmptyHashTable(YoriLibPathIndex.Files);
+    YoriLibPathIndex.Files = NULL;
+    CloseHandle(YoriLibPathIndex.Mutex);
+    YoriLibPathIndex.Mutex = NULL;
+}
+
 /**
  Search for a file name within the path.  If it's found, output the string
  matching.  The caller is expected to free this string with
@@ -1149,6 +2335,25 @@ YoriLibLocateExecutableInPath(
         SearchPathExt = TRUE;
     }
 
+    //
+    //  If the path index is enabled, it can answer searches when there is
+    //  no path component.
+    //
+
+    if (SearchPath &&
+        MatchAllCallback == NULL &&
+        YoriLibPathIndexLocate(SearchFor, (BOOLEAN)!SearchPathExt, PathName)) {
+
+        return TRUE;
+    }
+
+    if (SearchPath &&
+        MatchAllCallback != NULL &&
+        YoriLibPathIndexLocateAll(SearchFor, (BOOLEAN)!SearchPathExt, MatchAllCallback, MatchAllContext)) {
+
+        return TRUE;
+    }
+
     YoriLibInitEmptyString(PathName);
 
     //
@@ -3,7 +3,7 @@
  *
  * Unicode versions of printf functions.
  *
- * Copyright (c) 2014 Malcolm J. Smith
+ * Copyright (c) 2014-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -127,7 +127,9 @@ YoriLibSPrintf(
 /**
  Process a printf format string and output the result into a Yori string.
  If the string is not large enough to contain the result, it is reallocated
- internally.
+ internally.  If the string already has an allocation, the result is
+ formatted directly into it, so callers that reuse a string across calls
+ only process the format string once.
 
  @param Dest The string to populate with the result.
 
@@ -149,6 +151,20 @@ YoriLibYPrintfInternal(
     YORI_SIGNED_ALLOC_SIZE_T required_len;
     YORI_SIGNED_ALLOC_SIZE_T out_len;
 
+    //
+    //  A result that fills the buffer may have been truncated in its final
+    //  specifier, which is not reported as a failure, so only use a result
+    //  that leaves space to spare.
+    //
+
+    if (Dest->LengthAllocated > 1) {
+        out_len = YoriLibVSPrintf(Dest->StartOfString, Dest->LengthAllocated, szFmt, marker);
+        if (out_len >= 0 && (YORI_ALLOC_SIZE_T)out_len < Dest->LengthAllocated - 1) {
+            Dest->LengthInChars = out_len;
+            return out_len;
+        }
+    }
+
     required_len = YoriLibVSPrintfSize(szFmt, marker);
     if (required_len < 0) {
         return required_len;
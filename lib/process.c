@@ -3,7 +3,7 @@
  *
  * Yori process enumeration support routines
  *
- * Copyright (c) 2018-2020 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -28,61 +28,108 @@
 #include "yorilib.h"
 
 /**
- Load information about all processes currently executing in the system.
+ Load information about all processes currently executing in the system,
+ reusing a buffer from a previous call if it is large enough.  This allows
+ a caller that samples the process list repeatedly to avoid reallocating
+ the buffer each time.
 
- @param ProcessInfo On successful completion, updated to point to a list of
-        processes executing within the system.  The caller is expected to
-        free this with YoriLibFree.
+ @param ProcessInfo On input, points to a buffer returned from a previous
+        call to this function, or NULL.  On output, updated to point to the
+        buffer, which may have been reallocated.  This is updated even on
+        failure, and the caller is expected to free it with YoriLibFree if
+        it is not NULL.
+
+ @param BytesAllocated On input, specifies the size of the buffer in
+        ProcessInfo.  On output, updated to contain the size of the buffer.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 __success(return)
 BOOL
-YoriLibGetSystemProcessList(
-    __out PYORI_SYSTEM_PROCESS_INFORMATION *ProcessInfo
+YoriLibUpdateSystemProcessList(
+    __inout PYORI_SYSTEM_PROCESS_INFORMATION *ProcessInfo,
+    __inout PYORI_ALLOC_SIZE_T BytesAllocated
     )
 {
-    PYORI_SYSTEM_PROCESS_INFORMATION LocalProcessInfo = NULL;
+    PYORI_SYSTEM_PROCESS_INFORMATION LocalProcessInfo;
     DWORD BytesReturned;
-    YORI_ALLOC_SIZE_T BytesAllocated;
+    YORI_ALLOC_SIZE_T LocalBytesAllocated;
     LONG Status;
 
     if (DllNtDll.pNtQuerySystemInformation == NULL) {
         return FALSE;
     }
 
-    BytesAllocated = 0;
+    LocalProcessInfo = *ProcessInfo;
+    LocalBytesAllocated = *BytesAllocated;
+    if (LocalProcessInfo == NULL) {
+        LocalBytesAllocated = 0;
+    }
 
     do {
 
-        if (LocalProcessInfo != NULL) {
-            YoriLibFree(LocalProcessInfo);
-        }
+        if (LocalProcessInfo == NULL) {
+            if (LocalBytesAllocated == 0) {
+                LocalBytesAllocated = 60 * 1024;
+            } else if (LocalBytesAllocated <= 15 * 1024 * 1024 && YoriLibIsSizeAllocatable(LocalBytesAllocated * 4)) {
+                LocalBytesAllocated = LocalBytesAllocated * 4;
+            } else {
+                *BytesAllocated = 0;
+                return FALSE;
+            }
 
-        if (BytesAllocated == 0) {
-            BytesAllocated = 60 * 1024;
-        } else if (BytesAllocated <= 15 * 1024 * 1024 && YoriLibIsSizeAllocatable(BytesAllocated * 4)) {
-            BytesAllocated = BytesAllocated * 4;
-        } else {
-            return FALSE;
-        }
+            LocalProcessInfo = YoriLibMalloc(LocalBytesAllocated);
+            if (LocalProcessInfo == NULL) {
+                *BytesAllocated = 0;
+                return FALSE;
+            }
 
-        LocalProcessInfo = YoriLibMalloc(BytesAllocated);
-        if (LocalProcessInfo == NULL) {
-            return FALSE;
+            *ProcessInfo = LocalProcessInfo;
+            *BytesAllocated = LocalBytesAllocated;
         }
 
-        Status = DllNtDll.pNtQuerySystemInformation(SystemProcessInformation, LocalProcessInfo, BytesAllocated, &BytesReturned);
+        Status = DllNtDll.pNtQuerySystemInformation(SystemProcessInformation, LocalProcessInfo, LocalBytesAllocated, &BytesReturned);
+        if (Status == STATUS_INFO_LENGTH_MISMATCH) {
+            YoriLibFree(LocalProcessInfo);
+            LocalProcessInfo = NULL;
+            *ProcessInfo = NULL;
+        }
     } while (Status == STATUS_INFO_LENGTH_MISMATCH);
 
-
     if (Status != 0) {
-        YoriLibFree(LocalProcessInfo);
         return FALSE;
     }
 
     if (BytesReturned == 0) {
-        YoriLibFree(LocalProcessInfo);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Load information about all processes currently executing in the system.
+
+ @param ProcessInfo On successful completion, updated to point to a list of
+        processes executing within the system.  The caller is expected to
+        free this with YoriLibFree.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibGetSystemProcessList(
+    __out PYORI_SYSTEM_PROCESS_INFORMATION *ProcessInfo
+    )
+{
+    PYORI_SYSTEM_PROCESS_INFORMATION LocalProcessInfo = NULL;
+    YORI_ALLOC_SIZE_T BytesAllocated;
+
+    BytesAllocated = 0;
+    if (!YoriLibUpdateSystemProcessList(&LocalProcessInfo, &BytesAllocated)) {
+        if (LocalProcessInfo != NULL) {
+            YoriLibFree(LocalProcessInfo);
+        }
         return FALSE;
     }
 
@@ -153,4 +200,69 @@ YoriLibGetSystemHandlesList(
     return TRUE;
 }
 
+/**
+ Lower the I/O and memory priority of a process so that it interferes less
+ with foreground work.  Processes launched by this process inherit both
+ priorities.  Each priority is applied if the host OS supports it.
+
+ @param hProcess Handle to the process, which requires
+        PROCESS_SET_INFORMATION access.
+
+ @return TRUE if either priority was applied, FALSE if neither could be.
+ */
+BOOL
+YoriLibSetProcessBackgroundPriority(
+    __in HANDLE hProcess
+    )
+{
+    DWORD IoPriority;
+    DWORD MemoryPriority;
+    BOOL Result;
+
+    Result = FALSE;
+    if (DllNtDll.pNtSetInformationProcess != NULL) {
+        IoPriority = YORI_IO_PRIORITY_VERY_LOW;
+        if (DllNtDll.pNtSetInformationProcess(hProcess, YORI_PROCESS_IO_PRIORITY, &IoPriority, sizeof(IoPriority)) == 0) {
+            Result = TRUE;
+        }
+    }
+
+    if (DllKernel32.pSetProcessInformation != NULL) {
+        MemoryPriority = YORI_MEMORY_PRIORITY_VERY_LOW;
+        if (DllKernel32.pSetProcessInformation(hProcess, YORI_PROCESS_MEMORY_PRIORITY, &MemoryPriority, sizeof(MemoryPriority))) {
+            Result = TRUE;
+        }
+    }
+
+    return Result;
+}
+
+/**
+ Indicate that a process can execute at reduced speed to improve energy
+ efficiency, also known as EcoQoS.  On hybrid systems this also makes the
+ scheduler prefer efficiency cores.  If this functionality is not supported
+ by the host OS, returns FALSE.
+
+ @param hProcess Handle to the process, which requires
+        PROCESS_SET_INFORMATION access.
+
+ @return TRUE on success, FALSE on failure.
+ */
+BOOL
+YoriLibSetProcessPowerThrottling(
+    __in HANDLE hProcess
+    )
+{
+    YORI_PROCESS_POWER_THROTTLING_STATE State;
+
+    if (DllKernel32.pSetProcessInformation == NULL) {
+        return FALSE;
+    }
+
+    State.Version = YORI_PROCESS_POWER_THROTTLING_CURRENT_VERSION;
+    State.ControlMask = YORI_PROCESS_POWER_THROTTLING_EXECUTION_SPEED;
+    State.StateMask = YORI_PROCESS_POWER_THROTTLING_EXECUTION_SPEED;
+    return DllKernel32.pSetProcessInformation(hProcess, YORI_PROCESS_POWER_THROTTLING, &State, sizeof(State));
+}
+
 // vim:sw=4:ts=4:et:
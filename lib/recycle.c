@@ -3,7 +3,7 @@
  *
  * Yori shell send files to the recycle bin.
  *
- * Copyright (c) 2018 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -93,4 +93,204 @@ YoriLibRecycleBinFile(
     return FALSE;
 }
 
+/**
+ The number of objects to queue before sending them to the recycle bin.
+ Each shell operation has a large fixed cost, so this should be large, but
+ bounded so that progress is made while enumerating large trees.
+ */
+#define YORI_LIB_RECYCLE_BATCH_MAX_COUNT (1000)
+
+/**
+ The number of characters to allocate for paths queued to the recycle bin.
+ */
+#define YORI_LIB_RECYCLE_BATCH_BUFFER_SIZE (128 * 1024)
+
+/**
+ Prepare a batch of objects to send to the recycle bin.
+
+ @param Batch Pointer to the batch to initialize.
+
+ @param FailedCallback Pointer to a function to invoke for each object that
+        was queued but could not be sent to the recycle bin.  The caller
+        would typically delete these directly.
+
+ @param Context Context to pass to FailedCallback.
+ */
+VOID
+YoriLibRecycleBinBatchInitialize(
+    __out PYORI_LIB_RECYCLE_BATCH Batch,
+    __in PYORI_LIB_RECYCLE_FAILED_FN FailedCallback,
+    __in_opt PVOID Context
+    )
+{
+    YoriLibInitEmptyString(&Batch->Paths);
+    Batch->Count = 0;
+    Batch->FailedCallback = FailedCallback;
+    Batch->Context = Context;
+}
+
+/**
+ Send all queued objects to the recycle bin in a single shell operation.
+ If the operation fails, any objects which still exist are retried one at a
+ time, and any object which still cannot be sent to the recycle bin is
+ passed to the batch's failure callback.
+
+ @param Batch Pointer to the batch to flush.
+
+ @return TRUE if all queued objects were sent to the recycle bin, FALSE if
+         any were passed to the failure callback.
+ */
+BOOL
+YoriLibRecycleBinBatchFlush(
+    __inout PYORI_LIB_RECYCLE_BATCH Batch
+    )
+{
+    YORI_SHFILEOP FileOp;
+    YORI_STRING FilePath;
+    YORI_ALLOC_SIZE_T Offset;
+    INT Result;
+    BOOL AllRecycled;
+
+    if (Batch->Count == 0) {
+        return TRUE;
+    }
+
+    ZeroMemory(&FileOp, sizeof(FileOp));
+    FileOp.Function = YORI_SHFILEOP_DELETE;
+    FileOp.Source = Batch->Paths.StartOfString;
+    FileOp.Flags = YORI_SHFILEOP_FLAG_SILENT|YORI_SHFILEOP_FLAG_NOCONFIRMATION|YORI_SHFILEOP_FLAG_ALLOWUNDO|YORI_SHFILEOP_FLAG_NOERRORUI;
+
+    Result = DllShell32.pSHFileOperationW(&FileOp);
+
+    AllRecycled = TRUE;
+    if (Result != 0 || FileOp.Aborted) {
+
+        //
+        //  The shell stops at the first failure, so some objects may have
+        //  been recycled and some may not.  Anything that's gone has been
+        //  handled; anything that remains is retried individually so that
+        //  one failure doesn't cause everything after it to be deleted
+        //  permanently.
+        //
+
+        Offset = 0;
+        while (Offset < Batch->Paths.LengthInChars) {
+            YoriLibInitEmptyString(&FilePath);
+            FilePath.StartOfString = &Batch->Paths.StartOfString[Offset];
+            FilePath.LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(FilePath.StartOfString);
+            FilePath.LengthAllocated = FilePath.LengthInChars + 1;
+
+            if (GetFileAttributes(FilePath.StartOfString) != (DWORD)-1 &&
+                !YoriLibRecycleBinFile(&FilePath)) {
+
+                AllRecycled = FALSE;
+                Batch->FailedCallback(&FilePath, Batch->Context);
+            }
+
+            Offset = Offset + FilePath.LengthInChars + 1;
+        }
+    }
+
+    Batch->Count = 0;
+    Batch->Paths.LengthInChars = 0;
+    return AllRecycled;
+}
+
+/**
+ Queue an object to be sent to the recycle bin.  Objects are sent when
+ enough have been queued or when the batch is flushed.  Objects which are
+ queued may be passed to the failure callback when the batch is flushed.
+
+ @param Batch Pointer to the batch.
+
+ @param FilePath Pointer to the path of the object to recycle.
+
+ @return TRUE if the object was queued, FALSE if it was not and the caller
+         should handle it directly.
+ */
+BOOL
+YoriLibRecycleBinBatchAdd(
+    __inout PYORI_LIB_RECYCLE_BATCH Batch,
+    __in PYORI_STRING FilePath
+    )
+{
+    YORI_STRING Tail;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+    YORI_ALLOC_SIZE_T AllocSize;
+
+    YoriLibLoadShell32Functions();
+    if (DllShell32.pSHFileOperationW == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  Space is needed for the path, its NULL, and the extra NULL that
+    //  terminates the list.  Unescaping a path never makes it longer.
+    //
+
+    if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)FilePath->LengthInChars + 2)) {
+        return FALSE;
+    }
+    CharsNeeded = FilePath->LengthInChars + 2;
+
+    if (Batch->Paths.LengthAllocated - Batch->Paths.LengthInChars < CharsNeeded) {
+        YoriLibRecycleBinBatchFlush(Batch);
+        if (Batch->Paths.LengthAllocated < CharsNeeded) {
+            AllocSize = YORI_LIB_RECYCLE_BATCH_BUFFER_SIZE;
+            if (AllocSize < CharsNeeded) {
+                AllocSize = CharsNeeded;
+            }
+            YoriLibFreeStringContents(&Batch->Paths);
+            if (!YoriLibAllocateString(&Batch->Paths, AllocSize)) {
+                return FALSE;
+            }
+        }
+    }
+
+    //
+    //  Shell will explode if it sees \\?\, so convert back to a Win32
+    //  path directly into the buffer.  If the result is too long for
+    //  shell to handle, let the caller deal with it.
+    //
+
+    YoriLibInitEmptyString(&Tail);
+    Tail.StartOfString = &Batch->Paths.StartOfString[Batch->Paths.LengthInChars];
+    Tail.LengthAllocated = Batch->Paths.LengthAllocated - Batch->Paths.LengthInChars;
+    if (!YoriLibUnescapePath(FilePath, &Tail)) {
+        return FALSE;
+    }
+    ASSERT(Tail.StartOfString == &Batch->Paths.StartOfString[Batch->Paths.LengthInChars]);
+
+    if (Tail.LengthInChars >= MAX_PATH) {
+        return FALSE;
+    }
+
+    Batch->Paths.StartOfString[Batch->Paths.LengthInChars + Tail.LengthInChars] = '\0';
+    Batch->Paths.LengthInChars = Batch->Paths.LengthInChars + Tail.LengthInChars + 1;
+    Batch->Paths.StartOfString[Batch->Paths.LengthInChars] = '\0';
+    Batch->Count++;
+
+    if (Batch->Count >= YORI_LIB_RECYCLE_BATCH_MAX_COUNT) {
+        YoriLibRecycleBinBatchFlush(Batch);
+    }
+
+    return TRUE;
+}
+
+/**
+ Free resources associated with a batch of objects to send to the recycle
+ bin.  Any objects which have been queued and not flushed are discarded, so
+ callers would normally flush the batch first.
+
+ @param Batch Pointer to the batch.
+ */
+VOID
+YoriLibRecycleBinBatchCleanup(
+    __inout PYORI_LIB_RECYCLE_BATCH Batch
+    )
+{
+    YoriLibFreeStringContents(&Batch->Paths);
+    Batch->Count = 0;
+}
+
 // vim:sw=4:ts=4:et:
@@ -0,0 +1,1099 @@
+/**
+ * @file lib/regexvm.c
+ *
+ * Yori regular expression matching without backtracking
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+#include "remimu.hxx"
+
+//
+//  Regular expressions are parsed by remimu, which produces an array of
+//  tokens.  Those tokens are compiled here into a program for a virtual
+//  machine which advances every possible match concurrently, one character
+//  at a time, so the time to search a string is proportional to the length
+//  of the string multiplied by the size of the program, regardless of the
+//  pattern.  Threads are kept in priority order, so the match found is the
+//  same one a backtracking matcher would find, except that a repeated group
+//  which matches an empty string is not considered as a separate iteration.
+//  Possessive quantifiers and atomic groups depend on backtracking, so
+//  expressions using those are matched by remimu instead.
+//
+
+/**
+ The maximum number of tokens that a regular expression can be parsed into.
+ */
+#define YORI_LIB_REGEX_MAX_TOKENS (1024)
+
+/**
+ The maximum number of instructions in a compiled program.  Expressions
+ requiring more than this, typically due to large repeat counts, are matched
+ by remimu instead.
+ */
+#define YORI_LIB_REGEX_MAX_INSTRUCTIONS (8192)
+
+/**
+ The maximum number of capture groups, including the entire match, whose
+ location is recorded by the program.
+ */
+#define YORI_LIB_REGEX_MAX_CAPTURES (10)
+
+/**
+ A value indicating that the target of a jump has not been determined yet.
+ */
+#define YORI_LIB_REGEX_PENDING ((DWORD)-1)
+
+/**
+ Token kinds generated by remimu.  These values are defined by remimu.h,
+ which is not included by C code.
+ */
+#define YORI_LIB_REGEX_KIND_NORMAL 0
+
+/**
+ A token opening a capturing group.
+ */
+#define YORI_LIB_REGEX_KIND_OPEN   1
+
+/**
+ A token opening a non-capturing group.
+ */
+#define YORI_LIB_REGEX_KIND_NCOPEN 2
+
+/**
+ A token closing a group.
+ */
+#define YORI_LIB_REGEX_KIND_CLOSE  3
+
+/**
+ A token separating alternatives within a group.
+ */
+#define YORI_LIB_REGEX_KIND_OR     4
+
+/**
+ A token matching the start of the text.
+ */
+#define YORI_LIB_REGEX_KIND_CARET  5
+
+/**
+ A token matching the end of the text.
+ */
+#define YORI_LIB_REGEX_KIND_DOLLAR 6
+
+/**
+ A token matching a word boundary.
+ */
+#define YORI_LIB_REGEX_KIND_BOUND  7
+
+/**
+ A token matching anything other than a word boundary.
+ */
+#define YORI_LIB_REGEX_KIND_NBOUND 8
+
+/**
+ The token terminating the array.
+ */
+#define YORI_LIB_REGEX_KIND_END    9
+
+/**
+ A token mode indicating a possessive quantifier or atomic group.
+ */
+#define YORI_LIB_REGEX_MODE_POSSESSIVE 1
+
+/**
+ A token mode indicating a lazy quantifier.
+ */
+#define YORI_LIB_REGEX_MODE_LAZY       2
+
+/**
+ The operations that a program instruction can perform.
+ */
+typedef enum _YORI_LIB_REGEX_OP {
+
+    /**
+     Consume one character if it is in the set described by a token,
+     otherwise terminate the thread.
+     */
+    YoriLibRegexOpChar = 1,
+
+    /**
+     The thread has found a match.
+     */
+    YoriLibRegexOpMatch = 2,
+
+    /**
+     Continue at instruction X.
+     */
+    YoriLibRegexOpJmp = 3,
+
+    /**
+     Continue at instruction X, and at lower priority, at instruction Y.
+     */
+    YoriLibRegexOpSplit = 4,
+
+    /**
+     Record the current position in a capture slot.
+     */
+    YoriLibRegexOpSave = 5,
+
+    /**
+     Terminate the thread unless the current position satisfies an anchor.
+     */
+    YoriLibRegexOpAssert = 6
+} YORI_LIB_REGEX_OP;
+
+/**
+ A single instruction within a compiled program.
+ */
+typedef struct _YORI_LIB_REGEX_INSTRUCTION {
+
+    /**
+     The operation to perform, from YORI_LIB_REGEX_OP.
+     */
+    UCHAR Op;
+
+    /**
+     For assertions, the remimu token kind describing the anchor.
+     */
+    UCHAR Kind;
+
+    /**
+     For save instructions, the capture slot to record into.  Even slots
+     record the start of a group and odd slots the end.
+     */
+    WORD Slot;
+
+    /**
+     For character instructions, the index of the token describing the set
+     of characters to match.
+     */
+    DWORD Token;
+
+    /**
+     The instruction to continue at for jumps and splits.
+     */
+    DWORD X;
+
+    /**
+     The lower priority instruction to continue at for splits.
+     */
+    DWORD Y;
+} YORI_LIB_REGEX_INSTRUCTION, *PYORI_LIB_REGEX_INSTRUCTION;
+
+/**
+ An entry on the stack used to follow instructions which don't consume a
+ character.
+ */
+typedef struct _YORI_LIB_REGEX_STACK_ENTRY {
+
+    /**
+     The instruction to follow, or YORI_LIB_REGEX_PENDING to indicate this
+     entry restores a capture slot.
+     */
+    DWORD Pc;
+
+    /**
+     For entries restoring a capture slot, the slot to restore.
+     */
+    DWORD Slot;
+
+    /**
+     For entries restoring a capture slot, the value to restore.
+     */
+    LONG_PTR Value;
+} YORI_LIB_REGEX_STACK_ENTRY, *PYORI_LIB_REGEX_STACK_ENTRY;
+
+/**
+ State used while compiling tokens into a program.
+ */
+typedef struct _YORI_LIB_REGEX_COMPILER {
+
+    /**
+     The tokens to compile.
+     */
+    RegexToken *Tokens;
+
+    /**
+     The program being generated.  This has one more element than the
+     maximum number of instructions, which is written to once the program
+     has become too large.
+     */
+    PYORI_LIB_REGEX_INSTRUCTION Program;
+
+    /**
+     The number of instructions generated.
+     */
+    DWORD Count;
+
+    /**
+     Set to TRUE if the tokens cannot be compiled, and matching should be
+     performed by remimu.
+     */
+    BOOLEAN Unsupported;
+
+    /**
+     For each token opening a capturing group, the capture index of the
+     group, or 0xFFFF if the group is not recorded.
+     */
+    WORD CaptureIndex[YORI_LIB_REGEX_MAX_TOKENS];
+} YORI_LIB_REGEX_COMPILER, *PYORI_LIB_REGEX_COMPILER;
+
+/**
+ Add an instruction to the program being compiled.
+
+ @param Compiler Pointer to the compiler state.
+
+ @param Op The operation of the instruction.
+
+ @return The index of the instruction.  If the program has become too large,
+         this refers to a scratch element which can be written to but is
+         not part of the program.
+ */
+DWORD
+YoriLibRegexEmit(
+    __inout PYORI_LIB_REGEX_COMPILER Compiler,
+    __in YORI_LIB_REGEX_OP Op
+    )
+{
+    PYORI_LIB_REGEX_INSTRUCTION Instruction;
+    DWORD Index;
+
+    if (Compiler->Count >= YORI_LIB_REGEX_MAX_INSTRUCTIONS) {
+        Compiler->Unsupported = TRUE;
+        Index = YORI_LIB_REGEX_MAX_INSTRUCTIONS;
+    } else {
+        Index = Compiler->Count;
+        Compiler->Count++;
+    }
+
+    Instruction = &Compiler->Program[Index];
+    ZeroMemory(Instruction, sizeof(YORI_LIB_REGEX_INSTRUCTION));
+    Instruction->Op = (UCHAR)Op;
+    return Index;
+}
+
+/**
+ Update any jump targets which have not been determined, from a specified
+ instruction to the end of the program, to refer to the next instruction to
+ be generated.  Constructs nested within the range have already resolved
+ their own targets, so anything remaining belongs to the caller.
+
+ @param Compiler Pointer to the compiler state.
+
+ @param Start The first instruction to update.
+ */
+VOID
+YoriLibRegexPatchPending(
+    __inout PYORI_LIB_REGEX_COMPILER Compiler,
+    __in DWORD Start
+    )
+{
+    DWORD Index;
+
+    for (Index = Start; Index < Compiler->Count; Index++) {
+        if (Compiler->Program[Index].X == YORI_LIB_REGEX_PENDING) {
+            Compiler->Program[Index].X = Compiler->Count;
+        }
+        if (Compiler->Program[Index].Y == YORI_LIB_REGEX_PENDING) {
+            Compiler->Program[Index].Y = Compiler->Count;
+        }
+    }
+}
+
+VOID
+YoriLibRegexCompileRepeat(
+    __inout PYORI_LIB_REGEX_COMPILER Compiler,
+    __in DWORD TokenIndex
+    );
+
+/**
+ Compile a sequence of tokens, which may contain groups but does not contain
+ alternatives at this level.
+
+ @param Compiler Pointer to the compiler state.
+
+ @param First The index of the first token.
+
+ @param Last The index of the token following the sequence.
+ */
+VOID
+YoriLibRegexCompileSequence(
+    __inout PYORI_LIB_REGEX_COMPILER Compiler,
+    __in DWORD First,
+    __in DWORD Last
+    )
+{
+    RegexToken *Token;
+    DWORD Index;
+    DWORD Instruction;
+
+    Index = First;
+    while (Index < Last && !Compiler->Unsupported) {
+        Token = &Compiler->Tokens[Index];
+        if (Token->mode & YORI_LIB_REGEX_MODE_POSSESSIVE) {
+            Compiler->Unsupported = TRUE;
+            return;
+        }
+
+        switch(Token->kind) {
+            case YORI_LIB_REGEX_KIND_NORMAL:
+                YoriLibRegexCompileRepeat(Compiler, Index);
+                Index++;
+                break;
+            case YORI_LIB_REGEX_KIND_OPEN:
+            case YORI_LIB_REGEX_KIND_NCOPEN:
+                YoriLibRegexCompileRepeat(Compiler, Index);
+                Index = Index + Token->pair_offset + 1;
+                break;
+            case YORI_LIB_REGEX_KIND_CARET:
+            case YORI_LIB_REGEX_KIND_DOLLAR:
+            case YORI_LIB_REGEX_KIND_BOUND:
+            case YORI_LIB_REGEX_KIND_NBOUND:
+                Instruction = YoriLibRegexEmit(Compiler, YoriLibRegexOpAssert);
+                Compiler->Program[Instruction].Kind = Token->kind;
+                Index++;
+                break;
+            default:
+                Compiler->Unsupported = TRUE;
+                return;
+        }
+    }
+}
+
+/**
+ Compile the alternatives within a group.  Each alternative is tried in
+ order of priority.
+
+ @param Compiler Pointer to the compiler state.
+
+ @param Open The index of the token opening the group.
+ */
+VOID
+YoriLibRegexCompileAlternatives(
+    __inout PYORI_LIB_REGEX_COMPILER Compiler,
+    __in DWORD Open
+    )
+{
+    RegexToken *Tokens;
+    DWORD Start;
+    DWORD First;
+    DWORD Next;
+    DWORD Split;
+    DWORD Jmp;
+
+    Tokens = Compiler->Tokens;
+    Start = Compiler->Count;
+    First = Open + 1;
+    Next = Open + Tokens[Open].mask[15];
+
+    while (Tokens[Next].kind == YORI_LIB_REGEX_KIND_OR && !Compiler->Unsupported) {
+        Split = YoriLibRegexEmit(Compiler, YoriLibRegexOpSplit);
+        Compiler->Program[Split].X = Split + 1;
+        YoriLibRegexCompileSequence(Compiler, First, Next);
+        Jmp = YoriLibRegexEmit(Compiler, YoriLibRegexOpJmp);
+        Compiler->Program[Jmp].X = YORI_LIB_REGEX_PENDING;
+        Compiler->Program[Split].Y = Compiler->Count;
+
+        First = Next + 1;
+        Next = Next + Tokens[Next].pair_offset;
+    }
+
+    YoriLibRegexCompileSequence(Compiler, First, Next);
+    YoriLibRegexPatchPending(Compiler, Start);
+}
+
+/**
+ Compile a single instance of a character set or group, without regard to
+ its quantifier.
+
+ @param Compiler Pointer to the compiler state.
+
+ @param TokenIndex The index of the token describing the character set, or
+        opening the group.
+ */
+VOID
+YoriLibRegexCompileAtom(
+    __inout PYORI_LIB_REGEX_COMPILER Compiler,
+    __in DWORD TokenIndex
+    )
+{
+    RegexToken *Token;
+    DWORD Instruction;
+    WORD Capture;
+
+    Token = &Compiler->Tokens[TokenIndex];
+    if (Token->kind == YORI_LIB_REGEX_KIND_NORMAL) {
+        Instruction = YoriLibRegexEmit(Compiler, YoriLibRegexOpChar);
+        Compiler->Program[Instruction].Token = TokenIndex;
+        return;
+    }
+
+    Capture = 0xFFFF;
+    if (Token->kind == YORI_LIB_REGEX_KIND_OPEN) {
+        Capture = Compiler->CaptureIndex[TokenIndex];
+    }
+
+    if (Capture != 0xFFFF) {
+        Instruction = YoriLibRegexEmit(Compiler, YoriLibRegexOpSave);
+        Compiler->Program[Instruction].Slot = (WORD)(Capture * 2);
+    }
+
+    YoriLibRegexCompileAlternatives(Compiler, TokenIndex);
+
+    if (Capture != 0xFFFF) {
+        Instruction = YoriLibRegexEmit(Compiler, YoriLibRegexOpSave);
+        Compiler->Program[Instruction].Slot = (WORD)(Capture * 2 + 1);
+    }
+}
+
+/**
+ Compile a character set or group along with its quantifier.  Repeat counts
+ are expanded into copies of the character set or group, so large counts
+ can make the program too large to compile.
+
+ @param Compiler Pointer to the compiler state.
+
+ @param TokenIndex The index of the token describing the character set, or
+        opening the group.
+ */
+VOID
+YoriLibRegexCompileRepeat(
+    __inout PYORI_LIB_REGEX_COMPILER Compiler,
+    __in DWORD TokenIndex
+    )
+{
+    RegexToken *Token;
+    DWORD Start;
+    DWORD Index;
+    DWORD Split;
+    DWORD Jmp;
+    BOOLEAN Lazy;
+
+    Token = &Compiler->Tokens[TokenIndex];
+
+    //
+    //  The upper bound is one more than the maximum count, or zero if
+    //  unlimited.  An upper bound of one means the token can only occur
+    //  zero times, so it matches nothing.
+    //
+
+    if (Token->count_hi == 1) {
+        return;
+    }
+
+    Lazy = FALSE;
+    if (Token->mode & YORI_LIB_REGEX_MODE_LAZY) {
+        Lazy = TRUE;
+    }
+
+    Start = Compiler->Count;
+    for (Index = 0; Index < Token->count_lo && !Compiler->Unsupported; Index++) {
+        YoriLibRegexCompileAtom(Compiler, TokenIndex);
+    }
+
+    if (Token->count_hi == 0) {
+        Split = YoriLibRegexEmit(Compiler, YoriLibRegexOpSplit);
+        YoriLibRegexCompileAtom(Compiler, TokenIndex);
+        Jmp = YoriLibRegexEmit(Compiler, YoriLibRegexOpJmp);
+        Compiler->Program[Jmp].X = Split;
+        if (Lazy) {
+            Compiler->Program[Split].X = Compiler->Count;
+            Compiler->Program[Split].Y = Split + 1;
+        } else {
+            Compiler->Program[Split].X = Split + 1;
+            Compiler->Program[Split].Y = Compiler->Count;
+        }
+        return;
+    }
+
+    for (Index = Token->count_lo; Index + 1 < Token->count_hi && !Compiler->Unsupported; Index++) {
+        Split = YoriLibRegexEmit(Compiler, YoriLibRegexOpSplit);
+        if (Lazy) {
+            Compiler->Program[Split].X = YORI_LIB_REGEX_PENDING;
+            Compiler->Program[Split].Y = Split + 1;
+        } else {
+            Compiler->Program[Split].X = Split + 1;
+            Compiler->Program[Split].Y = YORI_LIB_REGEX_PENDING;
+        }
+        YoriLibRegexCompileAtom(Compiler, TokenIndex);
+    }
+
+    YoriLibRegexPatchPending(Compiler, Start);
+}
+
+/**
+ Compile parsed tokens into a program and allocate the memory needed to
+ execute it.
+
+ @param Regex Pointer to the regular expression, whose Tokens are populated.
+        On successful completion, the program is populated.
+
+ @param TokenCount The number of tokens.
+
+ @return TRUE to indicate the program was compiled, FALSE if the expression
+         should be matched by remimu.
+ */
+BOOLEAN
+YoriLibRegexCompileProgram(
+    __inout PYORI_LIB_REGEX Regex,
+    __in DWORD TokenCount
+    )
+{
+    PYORI_LIB_REGEX_COMPILER Compiler;
+    PYORI_LIB_REGEX_INSTRUCTION Program;
+    RegexToken *Tokens;
+    DWORD Index;
+    DWORD Instruction;
+    DWORD Stride;
+    DWORD ScratchSize;
+    WORD CaptureCount;
+
+    Compiler = YoriLibMalloc(sizeof(YORI_LIB_REGEX_COMPILER));
+    if (Compiler == NULL) {
+        return FALSE;
+    }
+
+    Compiler->Program = YoriLibMalloc((YORI_LIB_REGEX_MAX_INSTRUCTIONS + 1) * sizeof(YORI_LIB_REGEX_INSTRUCTION));
+    if (Compiler->Program == NULL) {
+        YoriLibFree(Compiler);
+        return FALSE;
+    }
+
+    Tokens = Regex->Tokens;
+    Compiler->Tokens = Tokens;
+    Compiler->Count = 0;
+    Compiler->Unsupported = FALSE;
+
+    //
+    //  Capturing groups are numbered in the order they are opened, which
+    //  includes the implicit group surrounding the whole expression, so the
+    //  first capture is the entire match.
+    //
+
+    CaptureCount = 0;
+    for (Index = 0; Index < TokenCount; Index++) {
+        Compiler->CaptureIndex[Index] = 0xFFFF;
+        if (Tokens[Index].kind == YORI_LIB_REGEX_KIND_OPEN &&
+            CaptureCount < YORI_LIB_REGEX_MAX_CAPTURES) {
+
+            Compiler->CaptureIndex[Index] = CaptureCount;
+            CaptureCount++;
+        }
+    }
+
+    if (TokenCount == 0) {
+        Instruction = YoriLibRegexEmit(Compiler, YoriLibRegexOpSave);
+        Compiler->Program[Instruction].Slot = 0;
+        Instruction = YoriLibRegexEmit(Compiler, YoriLibRegexOpSave);
+        Compiler->Program[Instruction].Slot = 1;
+        CaptureCount = 1;
+    } else {
+        YoriLibRegexCompileRepeat(Compiler, 0);
+    }
+    YoriLibRegexEmit(Compiler, YoriLibRegexOpMatch);
+
+    if (Compiler->Unsupported || CaptureCount == 0) {
+        YoriLibFree(Compiler->Program);
+        YoriLibFree(Compiler);
+        return FALSE;
+    }
+
+    //
+    //  Allocate the program along with the memory needed to execute it,
+    //  being two lists of threads, each containing at most one thread per
+    //  instruction, capture slots for the thread being followed and the
+    //  match found, a stack, and a generation number per instruction.
+    //
+
+    Stride = 1 + 2 * CaptureCount;
+    ScratchSize = Compiler->Count * sizeof(YORI_LIB_REGEX_INSTRUCTION) +
+                  2 * Compiler->Count * Stride * sizeof(LONG_PTR) +
+                  2 * 2 * CaptureCount * sizeof(LONG_PTR) +
+                  (2 * Compiler->Count + 2) * sizeof(YORI_LIB_REGEX_STACK_ENTRY) +
+                  Compiler->Count * sizeof(DWORD);
+
+    Program = YoriLibMalloc(ScratchSize);
+    if (Program == NULL) {
+        YoriLibFree(Compiler->Program);
+        YoriLibFree(Compiler);
+        return FALSE;
+    }
+
+    memcpy(Program, Compiler->Program, Compiler->Count * sizeof(YORI_LIB_REGEX_INSTRUCTION));
+    Regex->Program = Program;
+    Regex->InstructionCount = Compiler->Count;
+    Regex->CaptureCount = CaptureCount;
+    Regex->ThreadLists = (PLONG_PTR)&Program[Compiler->Count];
+    Regex->Captures = &Regex->ThreadLists[2 * Compiler->Count * Stride];
+    Regex->Stack = (PVOID)&Regex->Captures[2 * 2 * CaptureCount];
+    Regex->Generations = (PDWORD)&((PYORI_LIB_REGEX_STACK_ENTRY)Regex->Stack)[2 * Compiler->Count + 2];
+    ZeroMemory(Regex->Generations, Compiler->Count * sizeof(DWORD));
+    Regex->Generation = 0;
+
+    YoriLibFree(Compiler->Program);
+    YoriLibFree(Compiler);
+    return TRUE;
+}
+
+/**
+ Parse a regular expression and compile it so that it can be searched for
+ in many strings.
+
+ @param Pattern The NULL terminated regular expression, in the multibyte
+        encoding of text that it will be searched for in.
+
+ @param Regex On successful completion, populated with the compiled regular
+        expression.  This should be freed with @ref YoriLibRegexFree .
+
+ @return Zero to indicate success, -1 if the expression is invalid or uses
+         unsupported features, or -2 if the expression is too complex or on
+         allocation failure.
+ */
+int
+YoriLibRegexCompile(
+    __in LPCSTR Pattern,
+    __out PYORI_LIB_REGEX Regex
+    )
+{
+    int16_t TokenCount;
+    int Error;
+
+    ZeroMemory(Regex, sizeof(YORI_LIB_REGEX));
+
+    Regex->Tokens = YoriLibMalloc(YORI_LIB_REGEX_MAX_TOKENS * sizeof(RegexToken));
+    if (Regex->Tokens == NULL) {
+        return -2;
+    }
+
+    TokenCount = YORI_LIB_REGEX_MAX_TOKENS;
+    Error = regex_parse(Pattern, Regex->Tokens, &TokenCount, 0);
+    if (Error != 0) {
+        YoriLibFree(Regex->Tokens);
+        Regex->Tokens = NULL;
+        return Error;
+    }
+
+    //
+    //  If the expression can't be compiled, it is still valid, and remimu
+    //  will be used to match it.
+    //
+
+    YoriLibRegexCompileProgram(Regex, TokenCount);
+    return 0;
+}
+
+/**
+ Free a regular expression compiled with @ref YoriLibRegexCompile .
+
+ @param Regex Pointer to the regular expression.
+ */
+VOID
+YoriLibRegexFree(
+    __inout PYORI_LIB_REGEX Regex
+    )
+{
+    if (Regex->Program != NULL) {
+        YoriLibFree(Regex->Program);
+        Regex->Program = NULL;
+    }
+
+    if (Regex->Tokens != NULL) {
+        YoriLibFree(Regex->Tokens);
+        Regex->Tokens = NULL;
+    }
+}
+
+/**
+ Return TRUE if a character is considered part of a word for the purpose of
+ word boundary anchors.  This is consistent with remimu.
+
+ @param Char The character to check.
+
+ @return TRUE if the character is part of a word, FALSE if it is not.
+ */
+BOOLEAN
+YoriLibRegexIsWordChar(
+    __in UCHAR Char
+    )
+{
+    if ((Char >= '0' && Char <= '9') ||
+        (Char >= 'A' && Char <= 'Z') ||
+        (Char >= 'a' && Char <= 'z') ||
+        Char == '_') {
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Check whether an anchor is satisfied at a position within the text.
+
+ @param Kind The remimu token kind describing the anchor.
+
+ @param Text Pointer to the text.
+
+ @param TextLength The number of characters in the text.
+
+ @param Position The position within the text.
+
+ @return TRUE if the anchor is satisfied, FALSE if it is not.
+ */
+BOOLEAN
+YoriLibRegexCheckAssert(
+    __in UCHAR Kind,
+    __in LPCSTR Text,
+    __in YORI_ALLOC_SIZE_T TextLength,
+    __in YORI_ALLOC_SIZE_T Position
+    )
+{
+    BOOLEAN PreviousIsWord;
+    BOOLEAN NextIsWord;
+
+    if (Kind == YORI_LIB_REGEX_KIND_CARET) {
+        return (BOOLEAN)(Position == 0);
+    } else if (Kind == YORI_LIB_REGEX_KIND_DOLLAR) {
+        return (BOOLEAN)(Position == TextLength);
+    }
+
+    PreviousIsWord = FALSE;
+    if (Position > 0) {
+        PreviousIsWord = YoriLibRegexIsWordChar((UCHAR)Text[Position - 1]);
+    }
+
+    NextIsWord = FALSE;
+    if (Position < TextLength) {
+        NextIsWord = YoriLibRegexIsWordChar((UCHAR)Text[Position]);
+    }
+
+    if (Kind == YORI_LIB_REGEX_KIND_BOUND) {
+        return (BOOLEAN)(PreviousIsWord != NextIsWord);
+    }
+
+    return (BOOLEAN)(PreviousIsWord == NextIsWord);
+}
+
+/**
+ Add a thread to a list of threads, following any instructions which do not
+ consume a character.  Threads are added in priority order, and an
+ instruction which has been reached at this position already is not added
+ again, since the earlier thread reaching it has higher priority.
+
+ @param Regex Pointer to the regular expression.
+
+ @param List Pointer to the list of threads to add to.
+
+ @param ListCount Pointer to the number of threads in the list.  This is
+        updated to include any threads added.
+
+ @param Pc The instruction the new thread starts at.
+
+ @param Captures The capture slots of the new thread.  These are modified
+        while instructions are followed, and restored before returning.
+
+ @param Text Pointer to the text.
+
+ @param TextLength The number of characters in the text.
+
+ @param Position The position within the text of the new thread.
+ */
+VOID
+YoriLibRegexAddThread(
+    __in PYORI_LIB_REGEX Regex,
+    __inout PLONG_PTR List,
+    __inout PDWORD ListCount,
+    __in DWORD Pc,
+    __inout PLONG_PTR Captures,
+    __in LPCSTR Text,
+    __in YORI_ALLOC_SIZE_T TextLength,
+    __in YORI_ALLOC_SIZE_T Position
+    )
+{
+    PYORI_LIB_REGEX_INSTRUCTION Program;
+    PYORI_LIB_REGEX_INSTRUCTION Instruction;
+    PYORI_LIB_REGEX_STACK_ENTRY Stack;
+    PLONG_PTR Entry;
+    DWORD StackCount;
+    DWORD SlotCount;
+    DWORD Stride;
+
+    Program = Regex->Program;
+    Stack = Regex->Stack;
+    SlotCount = 2 * Regex->CaptureCount;
+    Stride = 1 + SlotCount;
+
+    StackCount = 1;
+    Stack[0].Pc = Pc;
+
+    while (StackCount > 0) {
+        StackCount--;
+        if (Stack[StackCount].Pc == YORI_LIB_REGEX_PENDING) {
+            Captures[Stack[StackCount].Slot] = Stack[StackCount].Value;
+            continue;
+        }
+
+        Pc = Stack[StackCount].Pc;
+        while (Regex->Generations[Pc] != Regex->Generation) {
+            Regex->Generations[Pc] = Regex->Generation;
+            Instruction = &Program[Pc];
+
+            if (Instruction->Op == YoriLibRegexOpJmp) {
+                Pc = Instruction->X;
+            } else if (Instruction->Op == YoriLibRegexOpSplit) {
+                Stack[StackCount].Pc = Instruction->Y;
+                StackCount++;
+                Pc = Instruction->X;
+            } else if (Instruction->Op == YoriLibRegexOpSave) {
+                Stack[StackCount].Pc = YORI_LIB_REGEX_PENDING;
+                Stack[StackCount].Slot = Instruction->Slot;
+                Stack[StackCount].Value = Captures[Instruction->Slot];
+                StackCount++;
+                Captures[Instruction->Slot] = Position;
+                Pc++;
+            } else if (Instruction->Op == YoriLibRegexOpAssert) {
+                if (!YoriLibRegexCheckAssert(Instruction->Kind, Text, TextLength, Position)) {
+                    break;
+                }
+                Pc++;
+            } else {
+                Entry = &List[(*ListCount) * Stride];
+                Entry[0] = Pc;
+                memcpy(&Entry[1], Captures, SlotCount * sizeof(LONG_PTR));
+                (*ListCount)++;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ Advance the generation number used to determine whether an instruction has
+ been reached at the current position already.
+
+ @param Regex Pointer to the regular expression.
+ */
+VOID
+YoriLibRegexNextGeneration(
+    __inout PYORI_LIB_REGEX Regex
+    )
+{
+    Regex->Generation++;
+    if (Regex->Generation == 0) {
+        ZeroMemory(Regex->Generations, Regex->InstructionCount * sizeof(DWORD));
+        Regex->Generation = 1;
+    }
+}
+
+/**
+ Search for a regular expression within text.  Matches are only found when
+ starting from the first byte of a multibyte character.  The match found is
+ the one starting closest to the beginning of the text, and if several
+ matches start there, the one a backtracking matcher would find first.
+
+ This function uses memory within the compiled expression, so a compiled
+ expression cannot be searched for by multiple threads at the same time.
+
+ @param Regex Pointer to the compiled regular expression.
+
+ @param Text Pointer to the text to search.  This must be NULL terminated.
+
+ @param TextLength The number of bytes in the text, excluding the NULL.
+
+ @param StartOffset The offset within the text to start searching from.
+
+ @param CaptureSlots The number of elements in CapturePos and CaptureSpan.
+
+ @param CapturePos Optionally points to an array which on a successful
+        match is updated with the offset of each capture group within the
+        text, or -1 if the group did not participate in the match.  The
+        first group is the entire match.
+
+ @param CaptureSpan Optionally points to an array which on a successful
+        match is updated with the length of each capture group, or -1 if
+        the group did not participate in the match.
+
+ @param MatchOffset On successful completion, updated with the offset of the
+        match within the text.
+
+ @return The length of the match in bytes, -1 if no match was found, or -2
+         if the expression was too complex to evaluate.
+ */
+LONG_PTR
+YoriLibRegexSearch(
+    __in PYORI_LIB_REGEX Regex,
+    __in LPCSTR Text,
+    __in YORI_ALLOC_SIZE_T TextLength,
+    __in YORI_ALLOC_SIZE_T StartOffset,
+    __in WORD CaptureSlots,
+    __out_ecount_opt(CaptureSlots) PLONG_PTR CapturePos,
+    __out_ecount_opt(CaptureSlots) PLONG_PTR CaptureSpan,
+    __out PYORI_ALLOC_SIZE_T MatchOffset
+    )
+{
+    PYORI_LIB_REGEX_INSTRUCTION Program;
+    PYORI_LIB_REGEX_INSTRUCTION Instruction;
+    PLONG_PTR CurrentList;
+    PLONG_PTR NextList;
+    PLONG_PTR SwapList;
+    PLONG_PTR Entry;
+    PLONG_PTR Captures;
+    PLONG_PTR MatchCaptures;
+    RegexToken *Tokens;
+    DWORD CurrentCount;
+    DWORD NextCount;
+    DWORD Index;
+    DWORD SlotCount;
+    DWORD Stride;
+    YORI_ALLOC_SIZE_T Position;
+    ptrdiff_t Length;
+    UCHAR Char;
+    BOOLEAN Matched;
+
+    *MatchOffset = 0;
+
+    //
+    //  If the expression couldn't be compiled, try each starting offset
+    //  with remimu.
+    //
+
+    if (Regex->Program == NULL) {
+        for (Position = StartOffset; Position <= TextLength; Position++) {
+            if (Position < TextLength && (Text[Position] & 0xC0) == 0x80) {
+                continue;
+            }
+
+            Length = regex_match(Regex->Tokens, Text, Position, CaptureSlots, (ptrdiff_t *)CapturePos, (ptrdiff_t *)CaptureSpan);
+            //
+            //  remimu returns the offset of the end of the match.
+            //
+
+            if (Length >= 0) {
+                *MatchOffset = Position;
+                return Length - Position;
+            }
+
+            if (Length < -1) {
+                return -2;
+            }
+        }
+
+        return -1;
+    }
+
+    Program = Regex->Program;
+    Tokens = Regex->Tokens;
+    SlotCount = 2 * Regex->CaptureCount;
+    Stride = 1 + SlotCount;
+    CurrentList = Regex->ThreadLists;
+    NextList = &Regex->ThreadLists[Regex->InstructionCount * Stride];
+    Captures = Regex->Captures;
+    MatchCaptures = &Regex->Captures[SlotCount];
+
+    CurrentCount = 0;
+    Matched = FALSE;
+    YoriLibRegexNextGeneration(Regex);
+
+    for (Position = StartOffset; Position <= TextLength; Position++) {
+
+        //
+        //  Until a match is found, start a new thread at each character, at
+        //  lower priority than threads which started earlier.
+        //
+
+        if (!Matched &&
+            (Position == TextLength || (Text[Position] & 0xC0) != 0x80)) {
+
+            for (Index = 0; Index < SlotCount; Index++) {
+                Captures[Index] = -1;
+            }
+            YoriLibRegexAddThread(Regex, CurrentList, &CurrentCount, 0, Captures, Text, TextLength, Position);
+        }
+
+        if (CurrentCount == 0 && Matched) {
+            break;
+        }
+
+        YoriLibRegexNextGeneration(Regex);
+        NextCount = 0;
+        Char = 0;
+        if (Position < TextLength) {
+            Char = (UCHAR)Text[Position];
+        }
+
+        for (Index = 0; Index < CurrentCount; Index++) {
+            Entry = &CurrentList[Index * Stride];
+            Instruction = &Program[Entry[0]];
+
+            //
+            //  A thread which finds a match supersedes all lower priority
+            //  threads, but higher priority threads may still find a
+            //  different match.
+            //
+
+            if (Instruction->Op == YoriLibRegexOpMatch) {
+                memcpy(MatchCaptures, &Entry[1], SlotCount * sizeof(LONG_PTR));
+                Matched = TRUE;
+                break;
+            }
+
+            if (Position < TextLength &&
+                (Tokens[Instruction->Token].mask[Char >> 4] & (1 << (Char & 0xF))) != 0) {
+
+                memcpy(Captures, &Entry[1], SlotCount * sizeof(LONG_PTR));
+                YoriLibRegexAddThread(Regex, NextList, &NextCount, (DWORD)Entry[0] + 1, Captures, Text, TextLength, Position + 1);
+            }
+        }
+
+        SwapList = CurrentList;
+        CurrentList = NextList;
+        NextList = SwapList;
+        CurrentCount = NextCount;
+    }
+
+    if (!Matched) {
+        return -1;
+    }
+
+    for (Index = 0; Index < CaptureSlots && Index < Regex->CaptureCount; Index++) {
+        if (CapturePos != NULL) {
+            CapturePos[Index] = -1;
+        }
+        if (CaptureSpan != NULL) {
+            CaptureSpan[Index] = -1;
+        }
+        if (MatchCaptures[Index * 2] >= 0 && MatchCaptures[Index * 2 + 1] >= MatchCaptures[Index * 2]) {
+            if (CapturePos != NULL) {
+                CapturePos[Index] = MatchCaptures[Index * 2];
+            }
+            if (CaptureSpan != NULL) {
+                CaptureSpan[Index] = MatchCaptures[Index * 2 + 1] - MatchCaptures[Index * 2];
+            }
+        }
+    }
+
+    *MatchOffset = (YORI_ALLOC_SIZE_T)MatchCaptures[0];
+    return MatchCaptures[1] - MatchCaptures[0];
+}
+
+// vim:sw=4:ts=4:et:
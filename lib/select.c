@@ -220,6 +220,63 @@ YoriLibClearPreviousSelectionDisplay(
     Selection->SelectionPreviouslyActive = FALSE;
 }
 
+/**
+ The maximum number of cells to read from the console in a single call when
+ reading a selected region.  Older consoles fail requests whose buffer
+ exceeds 64Kb, so this is kept comfortably below that.
+ */
+#define YORILIB_SELECTION_READ_CELLS (0x2000)
+
+/**
+ Ensure the temporary buffer used to read from the console can hold a
+ specified number of cells.  This buffer only grows, so repeated reads of
+ similar sizes do not reallocate.
+
+ @param Selection Pointer to the selection which may contain a previous
+        allocation for this routine to use, and may be populated with a new
+        allocation.
+
+ @param nLength The number of cells required.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibSelectionEnsureCharInfoBuffer(
+    __in PYORILIB_SELECTION Selection,
+    __in DWORD nLength
+    )
+{
+    PCHAR_INFO CharInfo;
+    DWORD dwAllocSize;
+
+    if (nLength <= Selection->TempCharInfoBufferSize) {
+        return TRUE;
+    }
+
+    dwAllocSize = nLength * 2;
+    if (dwAllocSize < 0x100) {
+        dwAllocSize = 0x100;
+    }
+
+    if (!YoriLibIsSizeAllocatable(dwAllocSize * sizeof(CHAR_INFO))) {
+        return FALSE;
+    }
+
+    CharInfo = YoriLibMalloc((YORI_ALLOC_SIZE_T)(dwAllocSize * sizeof(CHAR_INFO)));
+    if (CharInfo == NULL) {
+        return FALSE;
+    }
+
+    if (Selection->TempCharInfoBuffer != NULL) {
+        YoriLibFree(Selection->TempCharInfoBuffer);
+    }
+
+    Selection->TempCharInfoBuffer = CharInfo;
+    Selection->TempCharInfoBufferSize = dwAllocSize;
+    return TRUE;
+}
+
 /**
  Windows 10 consoles have a nasty bug where ReadConsoleOutputAttribute
  doesn't return correct colors when the console has previously displayed
@@ -266,29 +323,9 @@ YoriLibReadConsoleOutputAttributeForSelection(
     COORD dwBufferSize;
     COORD dwBufferCoord;
     DWORD dwIndex;
-    DWORD dwAllocSize;
-
-    if (nLength > Selection->TempCharInfoBufferSize) {
-        dwAllocSize = nLength * 2;
-        if (dwAllocSize < 0x100) {
-            dwAllocSize = 0x100;
-        }
-
-        if (!YoriLibIsSizeAllocatable(dwAllocSize * sizeof(CHAR_INFO))) {
-            return FALSE;
-        }
-
-        CharInfo = YoriLibMalloc((YORI_ALLOC_SIZE_T)(dwAllocSize * sizeof(CHAR_INFO)));
-        if (CharInfo == NULL) {
-            return FALSE;
-        }
-
-        if (Selection->TempCharInfoBuffer != NULL) {
-            YoriLibFree(Selection->TempCharInfoBuffer);
-        }
 
-        Selection->TempCharInfoBuffer = CharInfo;
-        Selection->TempCharInfoBufferSize = dwAllocSize;
+    if (!YoriLibSelectionEnsureCharInfoBuffer(Selection, nLength)) {
+        return FALSE;
     }
 
     CharInfo = Selection->TempCharInfoBuffer;
@@ -318,7 +355,10 @@ YoriLibReadConsoleOutputAttributeForSelection(
 }
 
 /**
- Nano doesn't implement ReadConsoleOutputCharacter, so fall back to
+ Read the characters within a rectangular region of the console.  Rather
+ than reading each line separately, this reads as many lines as fit within
+ a single bounded request, so large selections require few calls.  Since
+ Nano doesn't implement ReadConsoleOutputCharacter, this uses
  ReadConsoleOutput.
 
  @param Selection Pointer to the selection which may contain a previous
@@ -328,27 +368,22 @@ YoriLibReadConsoleOutputAttributeForSelection(
  @param hConsole Handle to the console output.
 
  @param lpCharacter Pointer to an array of TCHARs that is populated with
-        characters inside this routine.
-
- @param nLength The number of console cells and characters to populate.
+        the characters in the region, one line after another with no
+        separators.  This must be large enough to hold every cell in the
+        region.
 
- @param dwReadCoord The console buffer coordinates to start reading
-        characters from.
-
- @param lpNumberOfCharsRead On successful completion, updated to contain the
-        number of characters successfully read.
+ @param Region Pointer to the region to read.  Any line that cannot be read
+        is populated with spaces.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 __success(return)
 BOOL
-YoriLibReadConsoleOutputCharacterForSelection(
+YoriLibReadConsoleOutputCharacterRegionForSelection(
     __in PYORILIB_SELECTION Selection,
     __in HANDLE hConsole,
-    __out_ecount(nLength) LPTSTR lpCharacter,
-    __in DWORD nLength,
-    __in PCOORD dwReadCoord,
-    __out LPDWORD lpNumberOfCharsRead
+    __out LPTSTR lpCharacter,
+    __in PSMALL_RECT Region
     )
 {
     PCHAR_INFO CharInfo;
@@ -356,59 +391,57 @@ YoriLibReadConsoleOutputCharacterForSelection(
     COORD dwBufferSize;
     COORD dwBufferCoord;
     DWORD dwIndex;
-    DWORD dwAllocSize;
-
-    if (nLength > Selection->TempCharInfoBufferSize) {
-        dwAllocSize = nLength * 2;
-        if (dwAllocSize < 0x100) {
-            dwAllocSize = 0x100;
-        }
-
-        if (!YoriLibIsSizeAllocatable(dwAllocSize * sizeof(CHAR_INFO))) {
-            return FALSE;
-        }
-
-        CharInfo = YoriLibMalloc((YORI_ALLOC_SIZE_T)(dwAllocSize * sizeof(CHAR_INFO)));
-        if (CharInfo == NULL) {
-            return FALSE;
-        }
-
-        if (Selection->TempCharInfoBuffer != NULL) {
-            YoriLibFree(Selection->TempCharInfoBuffer);
-        }
+    DWORD LineLength;
+    DWORD LinesPerRead;
+    DWORD LinesThisRead;
+    DWORD CellsThisRead;
+    SHORT LineIndex;
 
-        Selection->TempCharInfoBuffer = CharInfo;
-        Selection->TempCharInfoBufferSize = dwAllocSize;
+    LineLength = Region->Right - Region->Left + 1;
+    LinesPerRead = YORILIB_SELECTION_READ_CELLS / LineLength;
+    if (LinesPerRead == 0) {
+        LinesPerRead = 1;
     }
 
-    CharInfo = Selection->TempCharInfoBuffer;
-
-    dwBufferSize.X = (SHORT)nLength;
-    dwBufferSize.Y = 1;
-    dwBufferCoord.X = 0;
-    dwBufferCoord.Y = 0;
-    ReadRegion.Left = dwReadCoord->X;
-    ReadRegion.Top = dwReadCoord->Y;
-    ReadRegion.Right = (SHORT)(dwReadCoord->X + nLength - 1);
-    ReadRegion.Bottom = dwReadCoord->Y;
-
-    if (!ReadConsoleOutput(hConsole, CharInfo, dwBufferSize, dwBufferCoord, &ReadRegion)) {
+    if (!YoriLibSelectionEnsureCharInfoBuffer(Selection, LinesPerRead * LineLength)) {
         return FALSE;
     }
 
-    for (dwIndex = 0; dwIndex < nLength; dwIndex++) {
-        lpCharacter[dwIndex] = CharInfo[dwIndex].Char.UnicodeChar;
-    }
+    CharInfo = Selection->TempCharInfoBuffer;
 
-    if (lpNumberOfCharsRead != NULL) {
-        *lpNumberOfCharsRead = ReadRegion.Right - ReadRegion.Left + 1;
+    for (LineIndex = Region->Top; LineIndex <= Region->Bottom; LineIndex = (SHORT)(LineIndex + LinesThisRead)) {
+        LinesThisRead = Region->Bottom - LineIndex + 1;
+        if (LinesThisRead > LinesPerRead) {
+            LinesThisRead = LinesPerRead;
+        }
+        CellsThisRead = LinesThisRead * LineLength;
+
+        dwBufferSize.X = (SHORT)LineLength;
+        dwBufferSize.Y = (SHORT)LinesThisRead;
+        dwBufferCoord.X = 0;
+        dwBufferCoord.Y = 0;
+        ReadRegion.Left = Region->Left;
+        ReadRegion.Top = LineIndex;
+        ReadRegion.Right = Region->Right;
+        ReadRegion.Bottom = (SHORT)(LineIndex + LinesThisRead - 1);
+
+        if (ReadConsoleOutput(hConsole, CharInfo, dwBufferSize, dwBufferCoord, &ReadRegion)) {
+            for (dwIndex = 0; dwIndex < CellsThisRead; dwIndex++) {
+                lpCharacter[dwIndex] = CharInfo[dwIndex].Char.UnicodeChar;
+            }
+        } else {
+            for (dwIndex = 0; dwIndex < CellsThisRead; dwIndex++) {
+                lpCharacter[dwIndex] = ' ';
+            }
+        }
+
+        lpCharacter += CellsThisRead;
     }
 
     return TRUE;
 }
 
 
-
 /**
  Return the selection color to use.  On Vista and newer systems this is the
  console popup color, which is what quickedit would do.  On Nano server,
@@ -1390,6 +1423,7 @@ YoriLibCopySelectionIfPresent(
     )
 {
     YORI_STRING TextToCopy;
+    YORI_STRING RawText;
     YORI_STRING VtText;
     YORI_STRING HtmlText;
     YORI_STRING RtfText;
@@ -1397,6 +1431,7 @@ YoriLibCopySelectionIfPresent(
     SHORT LineCount;
     SHORT LineIndex;
     LPTSTR TextWritePoint;
+    LPTSTR TextReadPoint;
     COORD StartPoint;
     DWORD CharsWritten;
     HANDLE ConsoleHandle;
@@ -1449,22 +1484,24 @@ YoriLibCopySelectionIfPresent(
     }
 
     //
-    //  In the first pass, copy all of the text, including trailing spaces.
-    //  This version will be used to construct the rich text form.
+    //  Read all of the text, including trailing spaces, into the end of the
+    //  buffer.  This version will be used to construct the rich text form.
+    //  The plain text form is later generated into the start of the same
+    //  buffer by removing trailing spaces and adding line breaks.  Since the
+    //  raw text is offset by the space needed for every line break, the
+    //  plain text for each line never overwrites raw text that has not been
+    //  consumed yet.
     //
 
-    TextWritePoint = TextToCopy.StartOfString;
-    for (LineIndex = Selection->CurrentlySelected.Top; LineIndex <= Selection->CurrentlySelected.Bottom; LineIndex++) {
-        StartPoint.X = Selection->CurrentlySelected.Left;
-        StartPoint.Y = LineIndex;
+    YoriLibInitEmptyString(&RawText);
+    RawText.StartOfString = TextToCopy.StartOfString + 2 * LineCount;
+    RawText.LengthInChars = (YORI_ALLOC_SIZE_T)(LineLength * LineCount);
 
-        YoriLibReadConsoleOutputCharacterForSelection(Selection, ConsoleHandle, TextWritePoint, LineLength, &StartPoint, &CharsWritten);
-
-        TextWritePoint += LineLength;
+    if (!YoriLibReadConsoleOutputCharacterRegionForSelection(Selection, ConsoleHandle, RawText.StartOfString, &Selection->CurrentlySelected)) {
+        YoriLibFreeStringContents(&TextToCopy);
+        return FALSE;
     }
 
-    TextToCopy.LengthInChars = (YORI_ALLOC_SIZE_T)(TextWritePoint - TextToCopy.StartOfString);
-
     StartPoint.X = (SHORT)(Selection->CurrentlySelected.Right - Selection->CurrentlySelected.Left + 1);
     StartPoint.Y = (SHORT)(Selection->CurrentlySelected.Bottom - Selection->CurrentlySelected.Top + 1);
 
@@ -1475,7 +1512,7 @@ YoriLibCopySelectionIfPresent(
     //
 
     if (!YoriLibIsSystemClipboardAvailable()) {
-        if (YoriLibCopyTextWithProcessFallback(&TextToCopy)) {
+        if (YoriLibCopyTextWithProcessFallback(&RawText)) {
             YoriLibFreeStringContents(&TextToCopy);
             return TRUE;
         }
@@ -1502,7 +1539,7 @@ YoriLibCopySelectionIfPresent(
             return FALSE;
         }
 
-        if (!YoriLibGenerateVtStringFromConsoleBuffers(&VtText, StartPoint, TextToCopy.StartOfString, Attributes.AttributeArray)) {
+        if (!YoriLibGenerateVtStringFromConsoleBuffers(&VtText, StartPoint, RawText.StartOfString, Attributes.AttributeArray)) {
             YoriLibFree(Attributes.AttributeArray);
             YoriLibFreeStringContents(&TextToCopy);
             return FALSE;
@@ -1511,23 +1548,23 @@ YoriLibCopySelectionIfPresent(
         YoriLibFree(Attributes.AttributeArray);
 
         //
-        //  In the second pass, copy all of the text, truncating trailing spaces.
-        //  This version will be used to construct the plain text form.
+        //  Generate the plain text form from the raw text, truncating
+        //  trailing spaces and separating lines with line breaks.
         //
 
         TextWritePoint = TextToCopy.StartOfString;
-        for (LineIndex = Selection->CurrentlySelected.Top; LineIndex <= Selection->CurrentlySelected.Bottom; LineIndex++) {
-            StartPoint.X = Selection->CurrentlySelected.Left;
-            StartPoint.Y = LineIndex;
-
-            YoriLibReadConsoleOutputCharacterForSelection(Selection, ConsoleHandle, TextWritePoint, LineLength, &StartPoint, &CharsWritten);
+        TextReadPoint = RawText.StartOfString;
+        for (LineIndex = 0; LineIndex < LineCount; LineIndex++) {
+            CharsWritten = LineLength;
             while (CharsWritten > 0) {
-                if (TextWritePoint[CharsWritten - 1] != ' ') {
+                if (TextReadPoint[CharsWritten - 1] != ' ') {
                     break;
                 }
                 CharsWritten--;
             }
+            memmove(TextWritePoint, TextReadPoint, CharsWritten * sizeof(TCHAR));
             TextWritePoint += CharsWritten;
+            TextReadPoint += LineLength;
 
             TextWritePoint[0] = '\r';
             TextWritePoint++;
@@ -429,8 +429,13 @@ YoriLibForEachStream(
         StreamContext.StreamNameHasWild = FALSE;
     }
 
+    //
+    //  The stream callback builds each path in a single buffer within the
+    //  stream context, so it cannot be invoked concurrently.
+    //
+
     Result = YoriLibForEachFile(&FileSpecNoStream,
-                                MatchFlags,
+                                (WORD)(MatchFlags & ~(YORILIB_FILEENUM_CONCURRENT_CALLBACKS)),
                                 Depth,
                                 YoriLibStreamEnumFileFoundCallback,
                                 YoriLibStreamEnumErrorCallback,
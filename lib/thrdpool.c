@@ -0,0 +1,744 @@
+/**
+ * @file lib/thrdpool.c
+ *
+ * Yori pool of worker threads with work stealing queues
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The number of items to allocate in each worker's deque when it is first
+ used.
+ */
+#define YORI_LIB_THREAD_POOL_INITIAL_DEQUE_SIZE (64)
+
+/**
+ The maximum number of threads in a pool.  This bounds the cost of idle
+ workers searching for work to steal.
+ */
+#define YORI_LIB_THREAD_POOL_MAX_THREADS (256)
+
+/**
+ A single worker thread within a pool.  Each worker has a deque of items.
+ Items submitted from a worker are pushed to its own deque and the worker
+ takes its most recently queued item first, which tends to keep related
+ data in cache, while idle workers steal the oldest item from other
+ workers' deques.
+ */
+typedef struct _YORI_LIB_THREAD_POOL_WORKER {
+
+    /**
+     Pointer to the pool that this worker is part of.
+     */
+    PYORI_LIB_THREAD_POOL Pool;
+
+    /**
+     A mutex protecting the deque of items for this worker.
+     */
+    HANDLE Mutex;
+
+    /**
+     Handle to the thread executing this worker.
+     */
+    HANDLE Thread;
+
+    /**
+     The identifier of the thread executing this worker, used to find the
+     worker when items are submitted from within the pool.
+     */
+    DWORD ThreadId;
+
+    /**
+     An array of pointers to items queued to this worker.
+     */
+    PYORI_LIB_WORK_ITEM *Items;
+
+    /**
+     The index of the oldest item in the deque.  Other workers steal from
+     this end.
+     */
+    DWORD Top;
+
+    /**
+     The index one beyond the most recently queued item in the deque.  This
+     worker pushes and pops from this end.
+     */
+    DWORD Bottom;
+
+    /**
+     The number of elements allocated in the Items array.
+     */
+    DWORD ItemsAllocated;
+
+} YORI_LIB_THREAD_POOL_WORKER, *PYORI_LIB_THREAD_POOL_WORKER;
+
+/**
+ A pool of worker threads.
+ */
+typedef struct _YORI_LIB_THREAD_POOL {
+
+    /**
+     A mutex protecting the count of outstanding items and the list of
+     items awaiting completion.
+     */
+    HANDLE Mutex;
+
+    /**
+     An auto reset event signalled when work has been queued.
+     */
+    HANDLE WorkAvailableEvent;
+
+    /**
+     A manual reset event signalled when the pool is being destroyed.
+     */
+    HANDLE ShutdownEvent;
+
+    /**
+     A manual reset event signalled when no items are outstanding.
+     */
+    HANDLE IdleEvent;
+
+    /**
+     Items with a completion function which have been submitted but not yet
+     completed, in the order that they were submitted.
+     */
+    YORI_LIST_ENTRY CompletionList;
+
+    /**
+     The number of items which have been submitted but not yet completed.
+     */
+    DWORD OutstandingItems;
+
+    /**
+     The number of workers in the Workers array.
+     */
+    DWORD WorkerCount;
+
+    /**
+     The worker that the next item submitted from outside the pool should
+     be queued to.
+     */
+    DWORD NextWorker;
+
+    /**
+     Set to TRUE if the pool has been cancelled, either explicitly or
+     because the user requested cancellation.
+     */
+    BOOLEAN Cancelled;
+
+    /**
+     Set to TRUE while a thread is calling completion functions.  This
+     ensures completion functions are called one at a time and in order.
+     */
+    BOOLEAN CompletionInProgress;
+
+    /**
+     An array of workers.
+     */
+    PYORI_LIB_THREAD_POOL_WORKER Workers;
+
+} YORI_LIB_THREAD_POOL;
+
+/**
+ Push an item onto the bottom of a worker's deque.
+
+ @param Worker Pointer to the worker whose deque should be updated.
+
+ @param Item Pointer to the item to push.
+
+ @return TRUE to indicate the item was queued, FALSE to indicate it could
+         not be queued.
+ */
+__success(return)
+BOOLEAN
+YoriLibThreadPoolPushItem(
+    __in PYORI_LIB_THREAD_POOL_WORKER Worker,
+    __in PYORI_LIB_WORK_ITEM Item
+    )
+{
+    PYORI_LIB_WORK_ITEM *NewItems;
+    DWORD NewAllocated;
+    DWORD Count;
+
+    WaitForSingleObject(Worker->Mutex, INFINITE);
+
+    //
+    //  If the end of the array has been reached, either move the live
+    //  items to the start of the array, or if the array is mostly in use,
+    //  reallocate it.
+    //
+
+    if (Worker->Bottom == Worker->ItemsAllocated) {
+        Count = Worker->Bottom - Worker->Top;
+        if (Worker->Top >= Worker->ItemsAllocated / 2 && Worker->Top > 0) {
+            memmove(Worker->Items, &Worker->Items[Worker->Top], Count * sizeof(PYORI_LIB_WORK_ITEM));
+        } else {
+            NewAllocated = Worker->ItemsAllocated * 2;
+            if (NewAllocated < YORI_LIB_THREAD_POOL_INITIAL_DEQUE_SIZE) {
+                NewAllocated = YORI_LIB_THREAD_POOL_INITIAL_DEQUE_SIZE;
+            }
+            if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)NewAllocated * sizeof(PYORI_LIB_WORK_ITEM))) {
+                ReleaseMutex(Worker->Mutex);
+                return FALSE;
+            }
+            NewItems = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(PYORI_LIB_WORK_ITEM)));
+            if (NewItems == NULL) {
+                ReleaseMutex(Worker->Mutex);
+                return FALSE;
+            }
+            if (Count > 0) {
+                memcpy(NewItems, &Worker->Items[Worker->Top], Count * sizeof(PYORI_LIB_WORK_ITEM));
+            }
+            if (Worker->Items != NULL) {
+                YoriLibFree(Worker->Items);
+            }
+            Worker->Items = NewItems;
+            Worker->ItemsAllocated = NewAllocated;
+        }
+        Worker->Top = 0;
+        Worker->Bottom = Count;
+    }
+
+    Worker->Items[Worker->Bottom] = Item;
+    Worker->Bottom++;
+    ReleaseMutex(Worker->Mutex);
+
+    SetEvent(Worker->Pool->WorkAvailableEvent);
+    return TRUE;
+}
+
+/**
+ Take an item from a worker's deque.  The worker which owns the deque takes
+ its most recently pushed item, while other workers steal the oldest item.
+
+ @param Worker Pointer to the worker whose deque should be examined.
+
+ @param Steal TRUE if the caller is not the owner of the deque and should
+        take the oldest item, FALSE if the caller owns the deque and should
+        take the most recent item.
+
+ @param MoreAvailable On successful completion, set to TRUE if the deque
+        still contains items after this item was removed.
+
+ @return Pointer to the item, or NULL if the deque is empty.
+ */
+PYORI_LIB_WORK_ITEM
+YoriLibThreadPoolTakeItem(
+    __in PYORI_LIB_THREAD_POOL_WORKER Worker,
+    __in BOOLEAN Steal,
+    __out PBOOLEAN MoreAvailable
+    )
+{
+    PYORI_LIB_WORK_ITEM Item;
+
+    Item = NULL;
+    *MoreAvailable = FALSE;
+    WaitForSingleObject(Worker->Mutex, INFINITE);
+    if (Worker->Bottom > Worker->Top) {
+        if (Steal) {
+            Item = Worker->Items[Worker->Top];
+            Worker->Top++;
+        } else {
+            Worker->Bottom--;
+            Item = Worker->Items[Worker->Bottom];
+        }
+        if (Worker->Bottom == Worker->Top) {
+            Worker->Top = 0;
+            Worker->Bottom = 0;
+        } else {
+            *MoreAvailable = TRUE;
+        }
+    }
+    ReleaseMutex(Worker->Mutex);
+    return Item;
+}
+
+/**
+ Indicate that an item is no longer outstanding.  The pool mutex must be
+ held by the caller.
+
+ @param Pool Pointer to the pool.
+ */
+VOID
+YoriLibThreadPoolRetireItem(
+    __in PYORI_LIB_THREAD_POOL Pool
+    )
+{
+    ASSERT(Pool->OutstandingItems > 0);
+    Pool->OutstandingItems--;
+    if (Pool->OutstandingItems == 0) {
+        SetEvent(Pool->IdleEvent);
+    }
+}
+
+/**
+ Execute a single item and, if it is the oldest item awaiting completion,
+ call completion functions for it and any subsequent items that have
+ already executed.
+
+ @param Pool Pointer to the pool.
+
+ @param Item Pointer to the item to execute.
+ */
+VOID
+YoriLibThreadPoolExecuteItem(
+    __in PYORI_LIB_THREAD_POOL Pool,
+    __in PYORI_LIB_WORK_ITEM Item
+    )
+{
+    PYORI_LIB_WORK_ITEM_FN CompleteFn;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIB_WORK_ITEM CompleteItem;
+
+    if (!Pool->Cancelled && YoriLibIsOperationCancelled()) {
+        Pool->Cancelled = TRUE;
+    }
+
+    //
+    //  If there is no completion function, the execute function owns the
+    //  item and it cannot be referenced after it returns.
+    //
+
+    CompleteFn = Item->CompleteFn;
+    Item->ExecuteFn(Pool, Item);
+
+    WaitForSingleObject(Pool->Mutex, INFINITE);
+    if (CompleteFn == NULL) {
+        YoriLibThreadPoolRetireItem(Pool);
+        ReleaseMutex(Pool->Mutex);
+        return;
+    }
+
+    Item->Executed = TRUE;
+    if (Pool->CompletionInProgress) {
+        ReleaseMutex(Pool->Mutex);
+        return;
+    }
+
+    //
+    //  Complete items in submission order while the oldest item has
+    //  executed.  The mutex is released while calling each completion
+    //  function, so other threads can mark items as executed, and those
+    //  are found when the list is examined again.
+    //
+
+    Pool->CompletionInProgress = TRUE;
+    while (TRUE) {
+        ListEntry = YoriLibGetNextListEntry(&Pool->CompletionList, NULL);
+        if (ListEntry == NULL) {
+            break;
+        }
+        CompleteItem = CONTAINING_RECORD(ListEntry, YORI_LIB_WORK_ITEM, CompletionList);
+        if (!CompleteItem->Executed) {
+            break;
+        }
+        YoriLibRemoveListItem(&CompleteItem->CompletionList);
+        ReleaseMutex(Pool->Mutex);
+
+        CompleteItem->CompleteFn(Pool, CompleteItem);
+
+        WaitForSingleObject(Pool->Mutex, INFINITE);
+        YoriLibThreadPoolRetireItem(Pool);
+    }
+    Pool->CompletionInProgress = FALSE;
+    ReleaseMutex(Pool->Mutex);
+}
+
+/**
+ The entrypoint for a worker thread in a pool.  Items are taken from the
+ worker's own deque first, and if that is empty, stolen from other workers.
+
+ @param Context Pointer to the worker.
+
+ @return Exit code for the thread, currently always zero.
+ */
+DWORD WINAPI
+YoriLibThreadPoolWorker(
+    __in LPVOID Context
+    )
+{
+    PYORI_LIB_THREAD_POOL_WORKER Worker;
+    PYORI_LIB_THREAD_POOL Pool;
+    PYORI_LIB_WORK_ITEM Item;
+    HANDLE WaitHandles[2];
+    BOOLEAN MoreAvailable;
+    DWORD Index;
+    DWORD VictimIndex;
+
+    Worker = (PYORI_LIB_THREAD_POOL_WORKER)Context;
+    Pool = Worker->Pool;
+    WaitHandles[0] = Pool->ShutdownEvent;
+    WaitHandles[1] = Pool->WorkAvailableEvent;
+    VictimIndex = (DWORD)(Worker - Pool->Workers);
+
+    while (TRUE) {
+
+        Item = YoriLibThreadPoolTakeItem(Worker, FALSE, &MoreAvailable);
+        if (Item == NULL) {
+            for (Index = 1; Index < Pool->WorkerCount; Index++) {
+                VictimIndex = (VictimIndex + 1) % Pool->WorkerCount;
+                if (&Pool->Workers[VictimIndex] == Worker) {
+                    continue;
+                }
+                Item = YoriLibThreadPoolTakeItem(&Pool->Workers[VictimIndex], TRUE, &MoreAvailable);
+                if (Item != NULL) {
+                    break;
+                }
+            }
+        }
+
+        if (Item == NULL) {
+            if (WaitForMultipleObjects(2, WaitHandles, FALSE, INFINITE) == WAIT_OBJECT_0) {
+                break;
+            }
+            continue;
+        }
+
+        //
+        //  The work available event only wakes one waiter.  If more work is
+        //  available, wake another worker to look for it.
+        //
+
+        if (MoreAvailable) {
+            SetEvent(Pool->WorkAvailableEvent);
+        }
+
+        YoriLibThreadPoolExecuteItem(Pool, Item);
+    }
+
+    return 0;
+}
+
+/**
+ Stop all worker threads in a pool and free its resources.  This assumes
+ no items are outstanding.
+
+ @param Pool Pointer to the pool to free.
+ */
+VOID
+YoriLibThreadPoolCleanup(
+    __in PYORI_LIB_THREAD_POOL Pool
+    )
+{
+    PYORI_LIB_THREAD_POOL_WORKER Worker;
+    DWORD Index;
+
+    if (Pool->Workers != NULL) {
+        if (Pool->ShutdownEvent != NULL) {
+            SetEvent(Pool->ShutdownEvent);
+        }
+        for (Index = 0; Index < Pool->WorkerCount; Index++) {
+            Worker = &Pool->Workers[Index];
+            if (Worker->Thread != NULL) {
+                WaitForSingleObject(Worker->Thread, INFINITE);
+                CloseHandle(Worker->Thread);
+            }
+            ASSERT(Worker->Bottom == Worker->Top);
+            if (Worker->Items != NULL) {
+                YoriLibFree(Worker->Items);
+            }
+            if (Worker->Mutex != NULL) {
+                CloseHandle(Worker->Mutex);
+            }
+        }
+        YoriLibFree(Pool->Workers);
+    }
+
+    if (Pool->Mutex != NULL) {
+        CloseHandle(Pool->Mutex);
+    }
+    if (Pool->WorkAvailableEvent != NULL) {
+        CloseHandle(Pool->WorkAvailableEvent);
+    }
+    if (Pool->ShutdownEvent != NULL) {
+        CloseHandle(Pool->ShutdownEvent);
+    }
+    if (Pool->IdleEvent != NULL) {
+        CloseHandle(Pool->IdleEvent);
+    }
+
+    YoriLibFree(Pool);
+}
+
+/**
+ Create a pool of worker threads.  Worker threads are distributed across
+ processor groups, so a pool can use more than 64 logical processors.
+
+ @param ThreadCount The number of worker threads to create.  If zero, one
+        thread is created for each logical processor.
+
+ @param CpuClass The class of work that the pool performs, used to select
+        which logical processors the threads should execute on.
+
+ @param Pool On successful completion, updated to point to the pool.  The
+        caller should free this with @ref YoriLibDestroyThreadPool .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibCreateThreadPool(
+    __in DWORD ThreadCount,
+    __in YORI_LIB_CPU_CLASS CpuClass,
+    __out PYORI_LIB_THREAD_POOL *Pool
+    )
+{
+    PYORI_LIB_THREAD_POOL NewPool;
+    PYORI_LIB_THREAD_POOL_WORKER Worker;
+    PYORI_LIB_CPU_TOPOLOGY Topology;
+    WORD PerformanceProcessors;
+    WORD EfficiencyProcessors;
+    DWORD Index;
+
+    if (ThreadCount == 0) {
+        YoriLibQueryCpuCount(&PerformanceProcessors, &EfficiencyProcessors);
+        ThreadCount = (DWORD)PerformanceProcessors + EfficiencyProcessors;
+        if (ThreadCount == 0) {
+            ThreadCount = 1;
+        }
+    }
+
+    if (ThreadCount > YORI_LIB_THREAD_POOL_MAX_THREADS) {
+        ThreadCount = YORI_LIB_THREAD_POOL_MAX_THREADS;
+    }
+
+    NewPool = YoriLibMalloc(sizeof(YORI_LIB_THREAD_POOL));
+    if (NewPool == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(NewPool, sizeof(YORI_LIB_THREAD_POOL));
+    YoriLibInitializeListHead(&NewPool->CompletionList);
+
+    NewPool->Mutex = CreateMutex(NULL, FALSE, NULL);
+    NewPool->WorkAvailableEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    NewPool->ShutdownEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    NewPool->IdleEvent = CreateEvent(NULL, TRUE, TRUE, NULL);
+    if (NewPool->Mutex == NULL ||
+        NewPool->WorkAvailableEvent == NULL ||
+        NewPool->ShutdownEvent == NULL ||
+        NewPool->IdleEvent == NULL) {
+
+        YoriLibThreadPoolCleanup(NewPool);
+        return FALSE;
+    }
+
+    NewPool->Workers = YoriLibMalloc((YORI_ALLOC_SIZE_T)(ThreadCount * sizeof(YORI_LIB_THREAD_POOL_WORKER)));
+    if (NewPool->Workers == NULL) {
+        YoriLibThreadPoolCleanup(NewPool);
+        return FALSE;
+    }
+    ZeroMemory(NewPool->Workers, ThreadCount * sizeof(YORI_LIB_THREAD_POOL_WORKER));
+
+    //
+    //  Threads are created suspended so that they only execute on their
+    //  selected processors.  The pool can continue with fewer threads if
+    //  any fail to start.
+    //
+
+    Topology = NULL;
+    YoriLibQueryCpuTopology(&Topology);
+
+    for (Index = 0; Index < ThreadCount; Index++) {
+        Worker = &NewPool->Workers[NewPool->WorkerCount];
+        Worker->Pool = NewPool;
+        Worker->Mutex = CreateMutex(NULL, FALSE, NULL);
+        if (Worker->Mutex == NULL) {
+            break;
+        }
+        Worker->Thread = CreateThread(NULL, 0, YoriLibThreadPoolWorker, Worker, CREATE_SUSPENDED, &Worker->ThreadId);
+        if (Worker->Thread == NULL) {
+            CloseHandle(Worker->Mutex);
+            Worker->Mutex = NULL;
+            break;
+        }
+        NewPool->WorkerCount++;
+    }
+
+    for (Index = 0; Index < NewPool->WorkerCount; Index++) {
+        Worker = &NewPool->Workers[Index];
+        if (Topology != NULL) {
+            YoriLibPlaceThread(Worker->Thread, Topology, CpuClass, Index);
+        }
+        ResumeThread(Worker->Thread);
+    }
+
+    if (Topology != NULL) {
+        YoriLibFree(Topology);
+    }
+
+    if (NewPool->WorkerCount == 0) {
+        YoriLibThreadPoolCleanup(NewPool);
+        return FALSE;
+    }
+
+    *Pool = NewPool;
+    return TRUE;
+}
+
+/**
+ Submit an item of work to a pool.  If this is called from a worker thread
+ in the pool, the item is queued to that worker, and is likely to execute
+ next on the same thread unless another worker is idle.  Otherwise, items
+ are distributed across workers.
+
+ @param Pool Pointer to the pool.
+
+ @param Item Pointer to the item to execute.  The caller is expected to
+        have initialized ExecuteFn and CompleteFn.  The item must remain
+        valid until its final callback has been invoked.
+ */
+VOID
+YoriLibSubmitWorkItem(
+    __in PYORI_LIB_THREAD_POOL Pool,
+    __in PYORI_LIB_WORK_ITEM Item
+    )
+{
+    PYORI_LIB_THREAD_POOL_WORKER Worker;
+    DWORD ThreadId;
+    DWORD Index;
+
+    Item->Executed = FALSE;
+
+    WaitForSingleObject(Pool->Mutex, INFINITE);
+    if (Pool->OutstandingItems == 0) {
+        ResetEvent(Pool->IdleEvent);
+    }
+    Pool->OutstandingItems++;
+    if (Item->CompleteFn != NULL) {
+        YoriLibAppendList(&Pool->CompletionList, &Item->CompletionList);
+    }
+
+    Worker = NULL;
+    ThreadId = GetCurrentThreadId();
+    for (Index = 0; Index < Pool->WorkerCount; Index++) {
+        if (Pool->Workers[Index].ThreadId == ThreadId) {
+            Worker = &Pool->Workers[Index];
+            break;
+        }
+    }
+
+    if (Worker == NULL) {
+        Worker = &Pool->Workers[Pool->NextWorker];
+        Pool->NextWorker = (Pool->NextWorker + 1) % Pool->WorkerCount;
+    }
+    ReleaseMutex(Pool->Mutex);
+
+    //
+    //  If the item cannot be queued due to allocation failure, execute it
+    //  synchronously.  This is slower but preserves the semantics of every
+    //  submitted item executing and completing.
+    //
+
+    if (!YoriLibThreadPoolPushItem(Worker, Item)) {
+        YoriLibThreadPoolExecuteItem(Pool, Item);
+    }
+}
+
+/**
+ Returns TRUE if the work in a pool has been cancelled, either explicitly
+ via @ref YoriLibCancelThreadPool or because the user requested
+ cancellation.  Items continue to be executed and completed after
+ cancellation so their resources can be released, but long running items
+ should check this periodically and return early.
+
+ @param Pool Pointer to the pool.
+
+ @return TRUE if the work has been cancelled, FALSE if it should continue.
+ */
+BOOLEAN
+YoriLibIsThreadPoolCancelled(
+    __in PYORI_LIB_THREAD_POOL Pool
+    )
+{
+    if (!Pool->Cancelled && YoriLibIsOperationCancelled()) {
+        Pool->Cancelled = TRUE;
+    }
+    return Pool->Cancelled;
+}
+
+/**
+ Cancel work in a pool.  This is typically called by an item which has
+ encountered a failure that means other items do not need to be processed.
+
+ @param Pool Pointer to the pool.
+ */
+VOID
+YoriLibCancelThreadPool(
+    __in PYORI_LIB_THREAD_POOL Pool
+    )
+{
+    Pool->Cancelled = TRUE;
+}
+
+/**
+ Return the number of worker threads in a pool.  Callers may use this to
+ determine how finely to divide work.
+
+ @param Pool Pointer to the pool.
+
+ @return The number of worker threads.
+ */
+DWORD
+YoriLibGetThreadPoolThreadCount(
+    __in PYORI_LIB_THREAD_POOL Pool
+    )
+{
+    return Pool->WorkerCount;
+}
+
+/**
+ Wait for all items submitted to a pool to execute and complete.  This must
+ not be called from a worker thread within the pool.
+
+ @param Pool Pointer to the pool.
+
+ @return TRUE if all items completed without the pool being cancelled,
+         FALSE if the pool was cancelled.
+ */
+BOOLEAN
+YoriLibWaitForThreadPool(
+    __in PYORI_LIB_THREAD_POOL Pool
+    )
+{
+    WaitForSingleObject(Pool->IdleEvent, INFINITE);
+    return (BOOLEAN)!YoriLibIsThreadPoolCancelled(Pool);
+}
+
+/**
+ Wait for all items submitted to a pool to complete, stop its worker
+ threads and free it.
+
+ @param Pool Pointer to the pool.
+ */
+VOID
+YoriLibDestroyThreadPool(
+    __in PYORI_LIB_THREAD_POOL Pool
+    )
+{
+    WaitForSingleObject(Pool->IdleEvent, INFINITE);
+    YoriLibThreadPoolCleanup(Pool);
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,200 @@
+/**
+ * @file lib/trace.c
+ *
+ * Yori event tracing provider
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The identifier of the Yori event tracing provider,
+ {c5aa229d-e451-4f34-80d1-d6708a50a8a9}.  A trace can be captured with a
+ command such as "xperf -start yori -on c5aa229d-e451-4f34-80d1-d6708a50a8a9"
+ alongside a kernel trace.  Events are strings, so they do not need a
+ manifest to be displayed.
+ */
+CONST GUID YoriLibTraceProviderGuid = {0xc5aa229d, 0xe451, 0x4f34, {0x80, 0xd1, 0xd6, 0x70, 0x8a, 0x50, 0xa8, 0xa9}};
+
+/**
+ The level of events written by the provider.  This corresponds to
+ TRACE_LEVEL_INFORMATION.
+ */
+#define YORI_LIB_TRACE_LEVEL (4)
+
+/**
+ The keywords that a trace session has enabled.  This is zero if no session
+ is collecting events from this process, which allows callers to check it
+ before doing any work to describe an event.
+ */
+ULONGLONG YoriLibTraceEnabledKeywords;
+
+/**
+ Nonzero once a thread has attempted to register the provider.
+ */
+LONG YoriLibTraceRegistrationAttempted;
+
+/**
+ The handle to the provider, if it has been registered.
+ */
+YORI_REGHANDLE YoriLibTraceProviderHandle;
+
+/**
+ A callback invoked by the system when a trace session enables or disables
+ the provider.
+
+ @param SourceId The identifier of the session.
+
+ @param IsEnabled The control code indicating the change.
+
+ @param Level The maximum level of events the session is collecting.
+
+ @param MatchAnyKeyword The keywords that the session is collecting.  If
+        zero, the session is collecting all events.
+
+ @param MatchAllKeyword Keywords that must all be present for the session to
+        collect an event.  This is not used by this provider.
+
+ @param FilterData Filtering information, not used by this provider.
+
+ @param CallbackContext Context specified when registering, not used by
+        this provider.
+ */
+VOID WINAPI
+YoriLibTraceEnableCallback(
+    __in CONST GUID * SourceId,
+    __in ULONG IsEnabled,
+    __in UCHAR Level,
+    __in ULONGLONG MatchAnyKeyword,
+    __in ULONGLONG MatchAllKeyword,
+    __in_opt PVOID FilterData,
+    __in_opt PVOID CallbackContext
+    )
+{
+    UNREFERENCED_PARAMETER(SourceId);
+    UNREFERENCED_PARAMETER(MatchAllKeyword);
+    UNREFERENCED_PARAMETER(FilterData);
+    UNREFERENCED_PARAMETER(CallbackContext);
+
+    if (IsEnabled == YORI_EVENT_CONTROL_CODE_ENABLE_PROVIDER &&
+        (Level == 0 || Level >= YORI_LIB_TRACE_LEVEL)) {
+
+        if (MatchAnyKeyword == 0) {
+            MatchAnyKeyword = (ULONGLONG)-1;
+        }
+        YoriLibTraceEnabledKeywords = MatchAnyKeyword;
+    } else if (IsEnabled == YORI_EVENT_CONTROL_CODE_DISABLE_PROVIDER) {
+        YoriLibTraceEnabledKeywords = 0;
+    }
+}
+
+/**
+ Register the event tracing provider.  This is performed once per process
+ from @ref YoriLibTraceIsEnabled , so processes which never reach a trace
+ point do not load anything.  If a session is already collecting events,
+ the system enables the provider before registration returns.
+
+ @return TRUE if the provider was registered by this call, FALSE if it
+         could not be registered or was previously registered.
+ */
+BOOLEAN
+YoriLibTraceRegister(VOID)
+{
+    if (InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&YoriLibTraceRegistrationAttempted) != 1) {
+        return FALSE;
+    }
+
+    YoriLibLoadAdvApi32Functions();
+    if (DllAdvApi32.pEventRegister == NULL ||
+        DllAdvApi32.pEventWriteString == NULL) {
+
+        return FALSE;
+    }
+
+    if (DllAdvApi32.pEventRegister(&YoriLibTraceProviderGuid, YoriLibTraceEnableCallback, NULL, &YoriLibTraceProviderHandle) != ERROR_SUCCESS) {
+        YoriLibTraceProviderHandle = 0;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Write an event marking the beginning or end of an operation.  Callers are
+ expected to check @ref YoriLibTraceIsEnabled first so that no work is done
+ when tracing is not active.
+
+ @param Keyword The category of the event, one of the YORI_LIB_TRACE_
+        values.
+
+ @param Operation A short name for the operation.
+
+ @param Begin TRUE if the operation is starting, FALSE if it has finished.
+
+ @param Object Optionally points to the name of the object being operated
+        on, such as a file, directory or URL.
+
+ @param Size A size associated with the operation, such as the number of
+        bytes or items processed.  This is typically zero when beginning an
+        operation whose size is not yet known.
+ */
+VOID
+YoriLibTraceWrite(
+    __in ULONGLONG Keyword,
+    __in LPCTSTR Operation,
+    __in BOOLEAN Begin,
+    __in_opt PCYORI_STRING Object,
+    __in DWORDLONG Size
+    )
+{
+    YORI_STRING Message;
+    YORI_STRING EmptyString;
+    LPCTSTR Phase;
+
+    if (YoriLibTraceProviderHandle == 0 ||
+        (YoriLibTraceEnabledKeywords & Keyword) == 0) {
+
+        return;
+    }
+
+    if (Object == NULL) {
+        YoriLibInitEmptyString(&EmptyString);
+        Object = &EmptyString;
+    }
+
+    Phase = _T("end");
+    if (Begin) {
+        Phase = _T("begin");
+    }
+
+    YoriLibInitEmptyString(&Message);
+    YoriLibYPrintf(&Message, _T("%s %s %y size=%lli"), Operation, Phase, Object, Size);
+    if (Message.StartOfString == NULL) {
+        return;
+    }
+
+    DllAdvApi32.pEventWriteString(YoriLibTraceProviderHandle, YORI_LIB_TRACE_LEVEL, Keyword, Message.StartOfString);
+    YoriLibFreeStringContents(&Message);
+}
+
+// vim:sw=4:ts=4:et:
@@ -4,7 +4,7 @@
  * Code to update a file from the internet including the running
  * executable.
  *
- * Copyright (c) 2016-2023 Malcolm J. Smith
+ * Copyright (c) 2016-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -337,6 +337,794 @@ YoriLibUpdateBuildHttpHeaders(
     return TRUE;
 }
 
+/**
+ The number of times a download is resumed after the connection fails before
+ giving up.
+ */
+#define YORI_LIB_UPDATE_MAX_RESUME_ATTEMPTS (3)
+
+/**
+ The minimum size of an object, in bytes, before it is downloaded as several
+ concurrent byte ranges.  Below this the extra requests cost more than they
+ save.
+ */
+#define YORI_LIB_UPDATE_SEGMENT_THRESHOLD (16 * 1024 * 1024)
+
+/**
+ The number of concurrent byte ranges used to download a large object if the
+ caller does not specify a number.
+ */
+#define YORI_LIB_UPDATE_SEGMENT_COUNT (4)
+
+/**
+ The maximum number of concurrent byte ranges used to download a large
+ object.
+ */
+#define YORI_LIB_UPDATE_MAX_SEGMENTS (16)
+
+/**
+ The minimum interval in milliseconds between calls to a progress callback.
+ */
+#define YORI_LIB_UPDATE_PROGRESS_INTERVAL (250)
+
+/**
+ A value for the end offset of a segment indicating the length of the object
+ is not known, so the segment continues until the server indicates the end.
+ */
+#define YORI_LIB_UPDATE_UNKNOWN_LENGTH ((DWORDLONG)-1)
+
+/**
+ State shared by every request issued for a single download.
+ */
+typedef struct _YORI_LIB_UPDATE_DOWNLOAD {
+
+    /**
+     Pointer to the Dll function table to use.
+     */
+    PYORI_WININET_FUNCTIONS Dll;
+
+    /**
+     The internet handle used for all requests.
+     */
+    PVOID hInternet;
+
+    /**
+     The Url being downloaded.
+     */
+    PCYORI_STRING Url;
+
+    /**
+     Handle to the local file being written.
+     */
+    HANDLE hTempFile;
+
+    /**
+     If the download is split into concurrent segments and hTempFile does
+     not support overlapped writes, a mutex serializing positioning and
+     writing to hTempFile.  NULL if there is only one segment or writes are
+     overlapped.
+     */
+    HANDLE FileMutex;
+
+    /**
+     The array of segments in the download, used to calculate progress.
+     */
+    struct _YORI_LIB_UPDATE_SEGMENT *Segments;
+
+    /**
+     The number of elements in the Segments array.
+     */
+    DWORD SegmentCount;
+
+    /**
+     The length of the object, or zero if not known.
+     */
+    DWORDLONG TotalLength;
+
+    /**
+     Optionally points to a function to call to indicate progress.
+     */
+    PYORI_LIB_UPDATE_PROGRESS_FN ProgressCallback;
+
+    /**
+     Context to pass to ProgressCallback.
+     */
+    PVOID ProgressContext;
+
+    /**
+     The tick count when ProgressCallback was last called.
+     */
+    DWORD LastProgressTick;
+
+    /**
+     TRUE if the WinInet implementation only supports ANSI strings.
+     */
+    BOOL WinInetOnlySupportsAnsi;
+
+    /**
+     TRUE if hTempFile was opened for overlapped IO, so each segment can
+     write at its own offset while it receives more data.
+     */
+    BOOLEAN OverlappedWrites;
+
+    /**
+     TRUE if hTempFile is a stream supplied by the caller, such as a pipe.
+     Data is written in order without positioning, and cannot be rewritten
+     if the server restarts the object.
+     */
+    BOOLEAN Sequential;
+
+} YORI_LIB_UPDATE_DOWNLOAD, *PYORI_LIB_UPDATE_DOWNLOAD;
+
+/**
+ A contiguous range of a download which is received over one request at a
+ time, resuming with a new request if one fails.
+ */
+typedef struct _YORI_LIB_UPDATE_SEGMENT {
+
+    /**
+     Pointer to the download this segment is part of.
+     */
+    PYORI_LIB_UPDATE_DOWNLOAD Download;
+
+    /**
+     The request currently returning data for this segment, or NULL if a
+     request needs to be issued.
+     */
+    PVOID hRequest;
+
+    /**
+     The offset within the object of the first byte of this segment.
+     */
+    DWORDLONG StartOffset;
+
+    /**
+     The offset within the object of the next byte to receive.
+     */
+    DWORDLONG Offset;
+
+    /**
+     The offset within the object immediately after the final byte of this
+     segment, or YORI_LIB_UPDATE_UNKNOWN_LENGTH.
+     */
+    DWORDLONG EndOffset;
+
+    /**
+     The result of receiving this segment.
+     */
+    YORI_LIB_UPDATE_ERROR Result;
+
+    /**
+     If writes are overlapped, the structure describing the write issued
+     for this segment.
+     */
+    OVERLAPPED Overlapped;
+
+    /**
+     The number of bytes in the outstanding write, if WritePending is TRUE.
+     */
+    DWORD PendingLength;
+
+    /**
+     TRUE if this segment covers the whole object, so a server which ignores
+     a range request can be handled by starting again from the beginning.
+     */
+    BOOLEAN CanRestart;
+
+    /**
+     TRUE if an overlapped write has been issued for this segment and has
+     not yet been waited for.
+     */
+    BOOLEAN WritePending;
+
+    /**
+     TRUE if the thread receiving this segment should call the progress
+     callback.  Only one segment does this, so the callback is always
+     invoked from the same thread.
+     */
+    BOOLEAN ReportProgress;
+
+} YORI_LIB_UPDATE_SEGMENT, *PYORI_LIB_UPDATE_SEGMENT;
+
+/**
+ Open a Url with the specified headers, using whichever character set the
+ WinInet implementation supports.
+
+ @param Download Pointer to the download state.
+
+ @param Headers Pointer to the HTTP headers to supply.
+
+ @return A request handle, or NULL on failure.
+ */
+PVOID
+YoriLibUpdateOpenUrlWinInet(
+    __in PYORI_LIB_UPDATE_DOWNLOAD Download,
+    __in PCYORI_STRING Headers
+    )
+{
+    PYORI_WININET_FUNCTIONS Dll;
+    PCYORI_STRING Url;
+    PVOID hRequest;
+
+    Dll = Download->Dll;
+    Url = Download->Url;
+
+    if (Download->WinInetOnlySupportsAnsi) {
+        YORI_ALLOC_SIZE_T AnsiCombinedHeaderLength;
+        LPSTR AnsiCombinedHeader;
+        YORI_ALLOC_SIZE_T AnsiUrlLength;
+        LPSTR AnsiUrl;
+
+        AnsiCombinedHeaderLength = (YORI_ALLOC_SIZE_T)WideCharToMultiByte(CP_ACP,
+               0,
+               Headers->StartOfString,
+               Headers->LengthInChars,
+               NULL,
+               0,
+               NULL,
+               NULL);
+        AnsiUrlLength = (YORI_ALLOC_SIZE_T)WideCharToMultiByte(CP_ACP,
+                0,
+                Url->StartOfString,
+                Url->LengthInChars,
+                NULL,
+                0,
+                NULL,
+                NULL);
+
+        AnsiCombinedHeader = YoriLibMalloc(AnsiCombinedHeaderLength + 1);
+        if (AnsiCombinedHeader == NULL) {
+            return NULL;
+        }
+
+        AnsiUrl = YoriLibMalloc(AnsiUrlLength + 1);
+        if (AnsiUrl == NULL) {
+            YoriLibFree(AnsiCombinedHeader);
+            return NULL;
+        }
+
+        WideCharToMultiByte(CP_ACP,
+                            0,
+                            Headers->StartOfString,
+                            Headers->LengthInChars,
+                            AnsiCombinedHeader,
+                            AnsiCombinedHeaderLength,
+                            NULL,
+                            NULL);
+        AnsiCombinedHeader[AnsiCombinedHeaderLength] = '\0';
+
+        WideCharToMultiByte(CP_ACP,
+                            0,
+                            Url->StartOfString,
+                            Url->LengthInChars,
+                            AnsiUrl,
+                            AnsiUrlLength,
+                            NULL,
+                            NULL);
+        AnsiUrl[AnsiUrlLength] = '\0';
+
+        hRequest = Dll->pInternetOpenUrlA(Download->hInternet,
+                                          AnsiUrl,
+                                          AnsiCombinedHeader,
+                                          AnsiCombinedHeaderLength,
+                                          0,
+                                          0);
+        YoriLibFree(AnsiUrl);
+        YoriLibFree(AnsiCombinedHeader);
+
+    } else {
+
+        hRequest = Dll->pInternetOpenUrlW(Download->hInternet,
+                                          Url->StartOfString,
+                                          Headers->StartOfString,
+                                          Headers->LengthInChars,
+                                          0,
+                                          0);
+    }
+
+    return hRequest;
+}
+
+/**
+ Query a numeric value describing the response to a request.
+
+ @param Download Pointer to the download state.
+
+ @param hRequest The request to query.
+
+ @param InfoLevel The information to query, including HTTP_QUERY_FLAG_NUMBER.
+
+ @param Value On successful completion, updated to contain the value.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibUpdateQueryNumberWinInet(
+    __in PYORI_LIB_UPDATE_DOWNLOAD Download,
+    __in PVOID hRequest,
+    __in DWORD InfoLevel,
+    __out PDWORD Value
+    )
+{
+    DWORD BufferSize;
+    DWORD Index;
+
+    BufferSize = sizeof(DWORD);
+    Index = 0;
+    *Value = 0;
+
+    if (Download->WinInetOnlySupportsAnsi) {
+        return Download->Dll->pHttpQueryInfoA(hRequest, InfoLevel, Value, &BufferSize, &Index);
+    }
+    return Download->Dll->pHttpQueryInfoW(hRequest, InfoLevel, Value, &BufferSize, &Index);
+}
+
+/**
+ Check whether the server indicated that it accepts byte range requests for
+ the object.
+
+ @param Download Pointer to the download state.
+
+ @param hRequest The request to query.
+
+ @return TRUE if the server accepts byte ranges, FALSE if it does not or
+         did not say.
+ */
+BOOL
+YoriLibUpdateAcceptsRangesWinInet(
+    __in PYORI_LIB_UPDATE_DOWNLOAD Download,
+    __in PVOID hRequest
+    )
+{
+    TCHAR Value[16];
+    CHAR AnsiValue[16];
+    DWORD BufferSize;
+    DWORD Index;
+    YORI_STRING ValueString;
+
+    Index = 0;
+    if (Download->WinInetOnlySupportsAnsi) {
+        BufferSize = sizeof(AnsiValue) - 1;
+        if (!Download->Dll->pHttpQueryInfoA(hRequest, HTTP_QUERY_ACCEPT_RANGES, AnsiValue, &BufferSize, &Index)) {
+            return FALSE;
+        }
+        for (Index = 0; Index < BufferSize && Index < sizeof(AnsiValue) - 1; Index++) {
+            Value[Index] = AnsiValue[Index];
+        }
+        Value[Index] = '\0';
+    } else {
+        BufferSize = sizeof(Value) - sizeof(TCHAR);
+        if (!Download->Dll->pHttpQueryInfoW(hRequest, HTTP_QUERY_ACCEPT_RANGES, Value, &BufferSize, &Index)) {
+            return FALSE;
+        }
+        Value[BufferSize / sizeof(TCHAR)] = '\0';
+    }
+
+    YoriLibConstantString(&ValueString, Value);
+    if (YoriLibCompareStringLitIns(&ValueString, _T("bytes")) == 0) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Issue a request for the remaining part of a segment using an HTTP Range
+ header.
+
+ @param Segment Pointer to the segment.  On success, its request handle is
+        populated.
+
+ @return An update error code indicating success or appropriate error.
+ */
+YORI_LIB_UPDATE_ERROR
+YoriLibUpdateOpenRangeWinInet(
+    __inout PYORI_LIB_UPDATE_SEGMENT Segment
+    )
+{
+    PYORI_LIB_UPDATE_DOWNLOAD Download;
+    YORI_STRING BaseHeader;
+    YORI_STRING CombinedHeader;
+    YORI_STRING HostSubset;
+    LPTSTR ObjectName;
+    PVOID hRequest;
+    DWORD StatusCode;
+
+    Download = Segment->Download;
+
+    //
+    //  Don't send If-Modified-Since here.  The object was already found to
+    //  be newer, and a server would answer a conditional range request for
+    //  an unchanged object with no data at all.
+    //
+
+    if (!YoriLibUpdateBuildHttpHeaders(Download->Url, NULL, &BaseHeader, &HostSubset, &ObjectName)) {
+        return YoriLibUpdErrorInetInit;
+    }
+
+    YoriLibInitEmptyString(&CombinedHeader);
+    if (Segment->EndOffset == YORI_LIB_UPDATE_UNKNOWN_LENGTH) {
+        YoriLibYPrintf(&CombinedHeader, _T("%yRange: bytes=%lli-\r\n"), &BaseHeader, Segment->Offset);
+    } else {
+        YoriLibYPrintf(&CombinedHeader, _T("%yRange: bytes=%lli-%lli\r\n"), &BaseHeader, Segment->Offset, Segment->EndOffset - 1);
+    }
+    YoriLibFreeStringContents(&BaseHeader);
+
+    if (CombinedHeader.StartOfString == NULL) {
+        return YoriLibUpdErrorInetInit;
+    }
+
+    hRequest = YoriLibUpdateOpenUrlWinInet(Download, &CombinedHeader);
+    YoriLibFreeStringContents(&CombinedHeader);
+
+    if (hRequest == NULL) {
+        return YoriLibUpdErrorInetConnect;
+    }
+
+    if (!YoriLibUpdateQueryNumberWinInet(Download, hRequest, HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_STATUS_CODE, &StatusCode)) {
+        Download->Dll->pInternetCloseHandle(hRequest);
+        return YoriLibUpdErrorInetConnect;
+    }
+
+    //
+    //  A server that ignores the range returns the entire object.  That's
+    //  only usable if this segment is the entire object, in which case the
+    //  segment starts again from the beginning.
+    //
+
+    if (StatusCode == 200 && Segment->CanRestart) {
+        Segment->StartOffset = 0;
+        Segment->Offset = 0;
+    } else if (StatusCode != 206) {
+        Download->Dll->pInternetCloseHandle(hRequest);
+        return YoriLibUpdErrorInetConnect;
+    }
+
+    Segment->hRequest = hRequest;
+    return YoriLibUpdErrorSuccess;
+}
+
+/**
+ Write data received for a download at a specified offset in the local file.
+
+ @param Download Pointer to the download state.
+
+ @param Offset The offset within the file to write to.  This is ignored if
+        the download is written to a sequential stream.
+
+ @param Buffer Pointer to the data to write.
+
+ @param Length The number of bytes to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibUpdateWriteAt(
+    __in PYORI_LIB_UPDATE_DOWNLOAD Download,
+    __in DWORDLONG Offset,
+    __in PVOID Buffer,
+    __in DWORD Length
+    )
+{
+    LONG OffsetHigh;
+    DWORD BytesWritten;
+    BOOL Result;
+
+    Result = FALSE;
+    if (Download->Sequential) {
+        if (WriteFile(Download->hTempFile, Buffer, Length, &BytesWritten, NULL) &&
+            BytesWritten == Length) {
+
+            Result = TRUE;
+        }
+        return Result;
+    }
+
+    if (Download->FileMutex != NULL) {
+        WaitForSingleObject(Download->FileMutex, INFINITE);
+    }
+
+    OffsetHigh = (LONG)(Offset >> 32);
+    if (SetFilePointer(Download->hTempFile, (LONG)(Offset & 0xFFFFFFFF), &OffsetHigh, FILE_BEGIN) != (DWORD)-1 ||
+        GetLastError() == NO_ERROR) {
+
+        if (WriteFile(Download->hTempFile, Buffer, Length, &BytesWritten, NULL) &&
+            BytesWritten == Length) {
+
+            Result = TRUE;
+        }
+    }
+
+    if (Download->FileMutex != NULL) {
+        ReleaseMutex(Download->FileMutex);
+    }
+
+    return Result;
+}
+
+/**
+ Wait for any overlapped write issued for a segment to complete.
+
+ @param Segment Pointer to the segment.
+
+ @return TRUE if there was no write outstanding or it completed
+         successfully, FALSE if it failed.
+ */
+BOOL
+YoriLibUpdateWaitForSegmentWrite(
+    __inout PYORI_LIB_UPDATE_SEGMENT Segment
+    )
+{
+    DWORD BytesWritten;
+
+    if (!Segment->WritePending) {
+        return TRUE;
+    }
+
+    Segment->WritePending = FALSE;
+    if (!GetOverlappedResult(Segment->Download->hTempFile, &Segment->Overlapped, &BytesWritten, TRUE) ||
+        BytesWritten != Segment->PendingLength) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Write data received for a segment at the segment's current offset.  If the
+ local file supports overlapped IO, the write is issued and this function
+ returns once the previous write for the segment has completed, so the
+ caller can receive more data into a different buffer while this one is
+ written.
+
+ @param Segment Pointer to the segment.
+
+ @param Buffer Pointer to the data to write.  If the write is overlapped,
+        this buffer must not be modified until
+        @ref YoriLibUpdateWaitForSegmentWrite has been called.
+
+ @param Length The number of bytes to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibUpdateWriteSegment(
+    __inout PYORI_LIB_UPDATE_SEGMENT Segment,
+    __in PVOID Buffer,
+    __in DWORD Length
+    )
+{
+    PYORI_LIB_UPDATE_DOWNLOAD Download;
+
+    Download = Segment->Download;
+    if (!Download->OverlappedWrites) {
+        return YoriLibUpdateWriteAt(Download, Segment->Offset, Buffer, Length);
+    }
+
+    if (!YoriLibUpdateWaitForSegmentWrite(Segment)) {
+        return FALSE;
+    }
+
+    Segment->Overlapped.Offset = (DWORD)(Segment->Offset & 0xFFFFFFFF);
+    Segment->Overlapped.OffsetHigh = (DWORD)(Segment->Offset >> 32);
+    if (!WriteFile(Download->hTempFile, Buffer, Length, NULL, &Segment->Overlapped) &&
+        GetLastError() != ERROR_IO_PENDING) {
+
+        return FALSE;
+    }
+
+    Segment->PendingLength = Length;
+    Segment->WritePending = TRUE;
+    return TRUE;
+}
+
+/**
+ Indicate the progress of a download to the caller's progress callback, if
+ one was supplied.  Calls are limited to one per
+ YORI_LIB_UPDATE_PROGRESS_INTERVAL unless Force is specified.
+
+ @param Download Pointer to the download state.
+
+ @param Force TRUE to call the callback regardless of when it was last
+        called.
+ */
+VOID
+YoriLibUpdateReportProgress(
+    __inout PYORI_LIB_UPDATE_DOWNLOAD Download,
+    __in BOOLEAN Force
+    )
+{
+    DWORDLONG BytesReceived;
+    DWORD Now;
+    DWORD Index;
+
+    if (Download->ProgressCallback == NULL) {
+        return;
+    }
+
+    Now = GetTickCount();
+    if (!Force && Now - Download->LastProgressTick < YORI_LIB_UPDATE_PROGRESS_INTERVAL) {
+        return;
+    }
+    Download->LastProgressTick = Now;
+
+    //
+    //  Other segments are updating their offsets concurrently.  This value
+    //  is only used for display, so an approximate sum is sufficient.
+    //
+
+    BytesReceived = 0;
+    for (Index = 0; Index < Download->SegmentCount; Index++) {
+        BytesReceived = BytesReceived + Download->Segments[Index].Offset - Download->Segments[Index].StartOffset;
+    }
+
+    Download->ProgressCallback(BytesReceived, Download->TotalLength, Download->ProgressContext);
+}
+
+/**
+ Receive a segment of a download and write it to the local file.  If the
+ request fails before the segment is complete, a new request is issued for
+ the remainder of the segment.  If the local file supports overlapped IO,
+ two buffers are used so that one can be written while the other receives
+ data.
+
+ @param Segment Pointer to the segment to receive.  If this has no request
+        handle, a request is issued.  On completion the request handle is
+        closed.
+
+ @return An update error code indicating success or appropriate error.
+ */
+YORI_LIB_UPDATE_ERROR
+YoriLibUpdateReadSegmentWinInet(
+    __inout PYORI_LIB_UPDATE_SEGMENT Segment
+    )
+{
+    PYORI_LIB_UPDATE_DOWNLOAD Download;
+    PUCHAR Buffers[2];
+    PUCHAR Buffer;
+    DWORD BufferIndex;
+    DWORD BytesToRead;
+    DWORD BytesRead;
+    DWORD Attempts;
+    BOOLEAN Complete;
+    YORI_LIB_UPDATE_ERROR Result;
+
+    Download = Segment->Download;
+
+    Buffers[0] = YoriLibMalloc(UPDATE_READ_SIZE);
+    Buffers[1] = Buffers[0];
+    if (Buffers[0] != NULL && Download->OverlappedWrites) {
+        Buffers[1] = YoriLibMalloc(UPDATE_READ_SIZE);
+        if (Buffers[1] == NULL) {
+            YoriLibFree(Buffers[0]);
+            Buffers[0] = NULL;
+        }
+    }
+
+    if (Buffers[0] == NULL) {
+        if (Segment->hRequest != NULL) {
+            Download->Dll->pInternetCloseHandle(Segment->hRequest);
+            Segment->hRequest = NULL;
+        }
+        return YoriLibUpdErrorFileWrite;
+    }
+
+    BufferIndex = 0;
+
+    Attempts = 0;
+    Result = YoriLibUpdErrorSuccess;
+
+    while (TRUE) {
+        if (Segment->hRequest == NULL) {
+            Result = YoriLibUpdateOpenRangeWinInet(Segment);
+            if (Result != YoriLibUpdErrorSuccess) {
+                Attempts++;
+                if (Attempts > YORI_LIB_UPDATE_MAX_RESUME_ATTEMPTS) {
+                    break;
+                }
+                continue;
+            }
+        }
+
+        Complete = FALSE;
+        Result = YoriLibUpdErrorInetRead;
+        while (TRUE) {
+            BytesToRead = UPDATE_READ_SIZE;
+            if (Segment->EndOffset != YORI_LIB_UPDATE_UNKNOWN_LENGTH) {
+                if (Segment->Offset >= Segment->EndOffset) {
+                    Complete = TRUE;
+                    break;
+                }
+                if (Segment->EndOffset - Segment->Offset < BytesToRead) {
+                    BytesToRead = (DWORD)(Segment->EndOffset - Segment->Offset);
+                }
+            }
+
+            Buffer = Buffers[BufferIndex];
+            if (!Download->Dll->pInternetReadFile(Segment->hRequest, Buffer, BytesToRead, &BytesRead)) {
+                break;
+            }
+
+            //
+            //  The end of the data is only the end of the segment if the
+            //  length wasn't known.  Otherwise the connection ended early.
+            //
+
+            if (BytesRead == 0) {
+                if (Segment->EndOffset == YORI_LIB_UPDATE_UNKNOWN_LENGTH) {
+                    Complete = TRUE;
+                }
+                break;
+            }
+
+            if (!YoriLibUpdateWriteSegment(Segment, Buffer, BytesRead)) {
+                Result = YoriLibUpdErrorFileWrite;
+                break;
+            }
+
+            BufferIndex = 1 - BufferIndex;
+            Segment->Offset = Segment->Offset + BytesRead;
+            if (Segment->ReportProgress) {
+                YoriLibUpdateReportProgress(Download, FALSE);
+            }
+        }
+
+        Download->Dll->pInternetCloseHandle(Segment->hRequest);
+        Segment->hRequest = NULL;
+
+        //
+        //  Data is only known to be in the file once the last write has
+        //  completed, and the buffers can't be reused or freed before then.
+        //
+
+        if (!YoriLibUpdateWaitForSegmentWrite(Segment)) {
+            Complete = FALSE;
+            Result = YoriLibUpdErrorFileWrite;
+        }
+
+        if (Complete) {
+            Result = YoriLibUpdErrorSuccess;
+            break;
+        }
+
+        if (Result == YoriLibUpdErrorFileWrite) {
+            break;
+        }
+
+        Attempts++;
+        if (Attempts > YORI_LIB_UPDATE_MAX_RESUME_ATTEMPTS) {
+            break;
+        }
+    }
+
+    if (Buffers[1] != Buffers[0]) {
+        YoriLibFree(Buffers[1]);
+    }
+    YoriLibFree(Buffers[0]);
+    return Result;
+}
+
+/**
+ A worker thread which receives one segment of a download.
+
+ @param Context Pointer to the segment to receive.
+
+ @return Zero.
+ */
+DWORD WINAPI
+YoriLibUpdateSegmentWorker(
+    __in LPVOID Context
+    )
+{
+    PYORI_LIB_UPDATE_SEGMENT Segment;
+
+    Segment = (PYORI_LIB_UPDATE_SEGMENT)Context;
+    Segment->Result = YoriLibUpdateReadSegmentWinInet(Segment);
+    return 0;
+}
+
 /**
  Download a file from the internet and store it in a local location using
  WinInet.dll.  This function is only used once WinInet is loaded.
@@ -356,6 +1144,8 @@ YoriLibUpdateBuildHttpHeaders(
  @param IfModifiedSince If specified, indicates a timestamp where a new
         object should only be downloaded if it is newer.
 
+ @param Options Optionally points to options controlling the download.
+
  @return An update error code indicating success or appropriate error.
  */
 YORI_LIB_UPDATE_ERROR
@@ -364,25 +1154,40 @@ YoriLibUpdateBinaryFromUrlWinInet(
     __in PCYORI_STRING Url,
     __in_opt PCYORI_STRING TargetName,
     __in PCYORI_STRING Agent,
-    __in_opt PSYSTEMTIME IfModifiedSince
+    __in_opt PSYSTEMTIME IfModifiedSince,
+    __in_opt PYORI_LIB_UPDATE_OPTIONS Options
     )
 {
     PVOID hInternet = NULL;
     PVOID NewBinary = NULL;
-    PUCHAR NewBinaryData = NULL;
-    DWORD ErrorBufferSize = 0;
+    UCHAR Signature[2];
     DWORD ActualBinarySize;
     YORI_STRING TempName;
     YORI_STRING TempPath;
     YORI_STRING PrefixString;
     HANDLE hTempFile = INVALID_HANDLE_VALUE;
-    BOOL SuccessfullyComplete = FALSE;
     BOOL WinInetOnlySupportsAnsi = FALSE;
     DWORD dwError;
     YORI_LIB_UPDATE_ERROR Return = YoriLibUpdErrorSuccess;
     YORI_STRING CombinedHeader;
     YORI_STRING HostSubset;
     LPTSTR ObjectName;
+    YORI_LIB_UPDATE_DOWNLOAD Download;
+    YORI_LIB_UPDATE_SEGMENT Segments[YORI_LIB_UPDATE_MAX_SEGMENTS];
+    HANDLE Threads[YORI_LIB_UPDATE_MAX_SEGMENTS];
+    OVERLAPPED ReadOverlapped;
+    DWORD MaxSegments;
+    DWORD SegmentCount = 0;
+    DWORD SegmentLength;
+    DWORD ContentLength;
+    BOOL ContentLengthKnown;
+    DWORD Index;
+    DWORD ThreadId;
+    LONG OffsetHigh;
+    SYSTEMTIME LastModified;
+    FILETIME LastModifiedFileTime;
+    BOOL LastModifiedKnown;
+    DWORD BufferSize;
 
     ASSERT(YoriLibIsStringNullTerminated(Url));
     ASSERT(YoriLibIsStringNullTerminated(Agent));
@@ -390,6 +1195,7 @@ YoriLibUpdateBinaryFromUrlWinInet(
 
     YoriLibInitEmptyString(&TempName);
     YoriLibInitEmptyString(&TempPath);
+    ZeroMemory(&Download, sizeof(Download));
 
     //
     //  Open an internet connection with default proxy settings.
@@ -475,172 +1281,254 @@ YoriLibUpdateBinaryFromUrlWinInet(
     //  Request the desired URL and check the status is HTTP success.
     //
 
-    if (WinInetOnlySupportsAnsi) {
-        YORI_ALLOC_SIZE_T AnsiCombinedHeaderLength;
-        LPSTR AnsiCombinedHeader;
-        YORI_ALLOC_SIZE_T AnsiUrlLength;
-        LPSTR AnsiUrl;
+    Download.Dll = Dll;
+    Download.hInternet = hInternet;
+    Download.Url = Url;
+    Download.hTempFile = INVALID_HANDLE_VALUE;
+    Download.WinInetOnlySupportsAnsi = WinInetOnlySupportsAnsi;
 
-        AnsiCombinedHeaderLength = (YORI_ALLOC_SIZE_T)WideCharToMultiByte(CP_ACP,
-               0,
-               CombinedHeader.StartOfString,
-               CombinedHeader.LengthInChars,
-               NULL,
-               0,
-               NULL,
-               NULL);
-        AnsiUrlLength = (YORI_ALLOC_SIZE_T)WideCharToMultiByte(CP_ACP,
-                0,
-                Url->StartOfString,
-                Url->LengthInChars,
-                NULL,
-                0,
-                NULL,
-                NULL);
+    NewBinary = YoriLibUpdateOpenUrlWinInet(&Download, &CombinedHeader);
+    YoriLibFreeStringContents(&CombinedHeader);
 
-        AnsiCombinedHeader = YoriLibMalloc(AnsiCombinedHeaderLength + 1);
-        if (AnsiCombinedHeader == NULL) {
-            YoriLibFreeStringContents(&CombinedHeader);
-            Return = YoriLibUpdErrorInetInit;
+    if (NewBinary == NULL) {
+        Return = YoriLibUpdErrorInetConnect;
+        goto Exit;
+    }
+
+    if (!YoriLibUpdateQueryNumberWinInet(&Download, NewBinary, HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_STATUS_CODE, &dwError)) {
+        Return = YoriLibUpdErrorInetConnect;
+        goto Exit;
+    }
+
+    if (dwError != 200) {
+        if (dwError != 304 || IfModifiedSince == NULL) {
+            Return = YoriLibUpdErrorInetConnect;
+        }
+        goto Exit;
+    }
+
+    MaxSegments = YORI_LIB_UPDATE_SEGMENT_COUNT;
+    if (Options != NULL) {
+        Download.ProgressCallback = Options->ProgressCallback;
+        Download.ProgressContext = Options->ProgressContext;
+        if (Options->SegmentCount != 0) {
+            MaxSegments = Options->SegmentCount;
+            if (MaxSegments > YORI_LIB_UPDATE_MAX_SEGMENTS) {
+                MaxSegments = YORI_LIB_UPDATE_MAX_SEGMENTS;
+            }
+        }
+    }
+
+    if (Options != NULL && Options->OutputHandle != NULL) {
+
+        //
+        //  A caller supplied stream is written in order, so it can only be
+        //  populated from a single segment.
+        //
+
+        Download.hTempFile = Options->OutputHandle;
+        Download.Sequential = TRUE;
+        MaxSegments = 1;
+    } else {
+
+        //
+        //  Create a temporary file to hold the contents.
+        //
+
+        if (!YoriLibGetTempPath(&TempPath, 0)) {
+            Return = YoriLibUpdErrorFileWrite;
             goto Exit;
         }
 
-        AnsiUrl = YoriLibMalloc(AnsiUrlLength + 1);
-        if (AnsiUrl == NULL) {
-            YoriLibFree(AnsiCombinedHeader);
-            YoriLibFreeStringContents(&CombinedHeader);
-            Return = YoriLibUpdErrorInetInit;
+        YoriLibConstantString(&PrefixString, _T("UPD"));
+        if (!YoriLibGetTempFileName(&TempPath, &PrefixString, &hTempFile, &TempName)) {
+            Return = YoriLibUpdErrorFileWrite;
             goto Exit;
         }
 
-        WideCharToMultiByte(CP_ACP,
-                            0,
-                            CombinedHeader.StartOfString,
-                            CombinedHeader.LengthInChars,
-                            AnsiCombinedHeader,
-                            AnsiCombinedHeaderLength,
-                            NULL,
-                            NULL);
-        AnsiCombinedHeader[AnsiCombinedHeaderLength] = '\0';
+        //
+        //  Reopen the file for overlapped IO, so each segment can write
+        //  one buffer while receiving the next.  The original handle
+        //  doesn't share write access, so it needs to be closed first.  If
+        //  the file can't be opened this way, use synchronous writes.
+        //
 
-        WideCharToMultiByte(CP_ACP,
-                            0,
-                            Url->StartOfString,
-                            Url->LengthInChars,
-                            AnsiUrl,
-                            AnsiUrlLength,
-                            NULL,
-                            NULL);
-        AnsiUrl[AnsiUrlLength] = '\0';
+        CloseHandle(hTempFile);
+        hTempFile = CreateFile(TempName.StartOfString,
+                               GENERIC_READ | GENERIC_WRITE,
+                               FILE_SHARE_READ | FILE_SHARE_DELETE,
+                               NULL,
+                               OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
+                               NULL);
 
-        NewBinary = Dll->pInternetOpenUrlA(hInternet,
-                                           AnsiUrl,
-                                           AnsiCombinedHeader,
-                                           AnsiCombinedHeaderLength,
-                                           0,
-                                           0);
-        YoriLibFree(AnsiUrl);
-        YoriLibFree(AnsiCombinedHeader);
+        if (hTempFile != INVALID_HANDLE_VALUE) {
+            Download.OverlappedWrites = TRUE;
+        } else {
+            hTempFile = CreateFile(TempName.StartOfString,
+                                   GENERIC_READ | GENERIC_WRITE,
+                                   FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                   NULL,
+                                   OPEN_EXISTING,
+                                   FILE_ATTRIBUTE_NORMAL,
+                                   NULL);
+
+            if (hTempFile == INVALID_HANDLE_VALUE) {
+                DeleteFile(TempName.StartOfString);
+                Return = YoriLibUpdErrorFileWrite;
+                goto Exit;
+            }
+        }
 
-    } else {
+        Download.hTempFile = hTempFile;
+    }
 
-        NewBinary = Dll->pInternetOpenUrlW(hInternet,
-                                           Url->StartOfString,
-                                           CombinedHeader.StartOfString,
-                                           CombinedHeader.LengthInChars,
-                                           0,
-                                           0);
+    //
+    //  Remember when the server says the object was modified, so the local
+    //  file can carry that time.  A later request made with the file's time
+    //  as If-Modified-Since then compares against the server's own clock.
+    //
+
+    BufferSize = sizeof(LastModified);
+    Index = 0;
+    if (WinInetOnlySupportsAnsi) {
+        LastModifiedKnown = Dll->pHttpQueryInfoA(NewBinary, HTTP_QUERY_FLAG_SYSTEMTIME | HTTP_QUERY_LAST_MODIFIED, &LastModified, &BufferSize, &Index);
+    } else {
+        LastModifiedKnown = Dll->pHttpQueryInfoW(NewBinary, HTTP_QUERY_FLAG_SYSTEMTIME | HTTP_QUERY_LAST_MODIFIED, &LastModified, &BufferSize, &Index);
     }
 
-    if (NewBinary == NULL) {
-        YoriLibFreeStringContents(&CombinedHeader);
-        Return = YoriLibUpdErrorInetConnect;
-        goto Exit;
+    //
+    //  Large objects from servers that accept byte ranges are fetched as
+    //  several concurrent ranges, which helps on high latency links.  The
+    //  file is extended to its final size up front so each range can be
+    //  written in place; marking it sparse first avoids zero filling the
+    //  regions that haven't arrived yet.
+    //
+
+    ContentLength = 0;
+    ContentLengthKnown = YoriLibUpdateQueryNumberWinInet(&Download, NewBinary, HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_CONTENT_LENGTH, &ContentLength);
+
+    if (ContentLengthKnown) {
+        Download.TotalLength = ContentLength;
     }
 
-    YoriLibFreeStringContents(&CombinedHeader);
+    SegmentCount = 1;
+    if (MaxSegments > 1 &&
+        ContentLengthKnown &&
+        ContentLength >= YORI_LIB_UPDATE_SEGMENT_THRESHOLD &&
+        YoriLibUpdateAcceptsRangesWinInet(&Download, NewBinary)) {
 
-    ErrorBufferSize = sizeof(dwError);
-    ActualBinarySize = 0;
-    dwError = 0;
+        if (Download.OverlappedWrites) {
+            SegmentCount = MaxSegments;
+        } else {
+            Download.FileMutex = CreateMutex(NULL, FALSE, NULL);
+            if (Download.FileMutex != NULL) {
+                SegmentCount = MaxSegments;
+            }
+        }
 
-    if (WinInetOnlySupportsAnsi) {
-        if (!Dll->pHttpQueryInfoA(NewBinary,
-                                  HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_STATUS_CODE,
-                                  &dwError,
-                                  &ErrorBufferSize,
-                                  &ActualBinarySize)) {
-            Return = YoriLibUpdErrorInetConnect;
-            goto Exit;
+        if (SegmentCount > 1) {
+            DeviceIoControl(hTempFile, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &ActualBinarySize, NULL);
+            SetFilePointer(hTempFile, ContentLength, NULL, FILE_BEGIN);
+            SetEndOfFile(hTempFile);
         }
-    } else {
-        if (!Dll->pHttpQueryInfoW(NewBinary,
-                                  HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_STATUS_CODE,
-                                  &dwError,
-                                  &ErrorBufferSize,
-                                  &ActualBinarySize)) {
-            Return = YoriLibUpdErrorInetConnect;
-            goto Exit;
+    }
+
+    ZeroMemory(Segments, SegmentCount * sizeof(YORI_LIB_UPDATE_SEGMENT));
+    SegmentLength = ContentLength / SegmentCount;
+    for (Index = 0; Index < SegmentCount; Index++) {
+        Segments[Index].Download = &Download;
+        Segments[Index].hRequest = NULL;
+        Segments[Index].Offset = (DWORDLONG)Index * SegmentLength;
+        Segments[Index].StartOffset = Segments[Index].Offset;
+        Segments[Index].EndOffset = (DWORDLONG)(Index + 1) * SegmentLength;
+        Segments[Index].Result = YoriLibUpdErrorSuccess;
+        Segments[Index].CanRestart = (BOOLEAN)(SegmentCount == 1 && !Download.Sequential);
+        Segments[Index].ReportProgress = (BOOLEAN)(Index == 0);
+        Threads[Index] = NULL;
+        if (Download.OverlappedWrites) {
+            Segments[Index].Overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+            if (Segments[Index].Overlapped.hEvent == NULL) {
+                SegmentCount = Index + 1;
+                Return = YoriLibUpdErrorFileWrite;
+                goto Exit;
+            }
         }
     }
-
-    if (dwError != 200) {
-        if (dwError != 304 || IfModifiedSince == NULL) {
-            Return = YoriLibUpdErrorInetConnect;
-        }
-        goto Exit;
+    Segments[SegmentCount - 1].EndOffset = ContentLength;
+    if (!ContentLengthKnown) {
+        Segments[0].EndOffset = YORI_LIB_UPDATE_UNKNOWN_LENGTH;
     }
 
+    Download.Segments = Segments;
+    Download.SegmentCount = SegmentCount;
+
     //
-    //  Create a temporary file to hold the contents.
+    //  The first segment continues on the request that's already open.
+    //  Any segment whose thread can't be created is received here after
+    //  the first.
     //
 
-    if (!YoriLibGetTempPath(&TempPath, 0)) {
-        Return = YoriLibUpdErrorFileWrite;
-        goto Exit;
+    Segments[0].hRequest = NewBinary;
+    NewBinary = NULL;
+
+    for (Index = 1; Index < SegmentCount; Index++) {
+        Threads[Index] = CreateThread(NULL, 0, YoriLibUpdateSegmentWorker, &Segments[Index], 0, &ThreadId);
     }
 
-    YoriLibConstantString(&PrefixString, _T("UPD"));
-    if (!YoriLibGetTempFileName(&TempPath, &PrefixString, &hTempFile, &TempName)) {
-        Return = YoriLibUpdErrorFileWrite;
-        goto Exit;
+    Return = YoriLibUpdateReadSegmentWinInet(&Segments[0]);
+
+    for (Index = 1; Index < SegmentCount; Index++) {
+        if (Threads[Index] != NULL) {
+            while (WaitForSingleObject(Threads[Index], YORI_LIB_UPDATE_PROGRESS_INTERVAL) == WAIT_TIMEOUT) {
+                YoriLibUpdateReportProgress(&Download, FALSE);
+            }
+            CloseHandle(Threads[Index]);
+        } else if (Return == YoriLibUpdErrorSuccess) {
+            Segments[Index].Result = YoriLibUpdateReadSegmentWinInet(&Segments[Index]);
+        } else {
+            Segments[Index].Result = Return;
+        }
+
+        if (Return == YoriLibUpdErrorSuccess) {
+            Return = Segments[Index].Result;
+        }
     }
 
-    NewBinaryData = YoriLibMalloc(UPDATE_READ_SIZE);
-    if (NewBinaryData == NULL) {
-        Return = YoriLibUpdErrorFileWrite;
+    if (Download.FileMutex != NULL) {
+        CloseHandle(Download.FileMutex);
+        Download.FileMutex = NULL;
+    }
+
+    if (Return != YoriLibUpdErrorSuccess) {
         goto Exit;
     }
 
+    YoriLibUpdateReportProgress(&Download, TRUE);
+
     //
-    //  Read from the internet location and save to the temporary file.
+    //  A caller supplied stream has nothing further to update.
     //
 
-    while (Dll->pInternetReadFile(NewBinary, NewBinaryData, UPDATE_READ_SIZE, &ActualBinarySize)) {
-
-        DWORD DataWritten;
-
-        if (ActualBinarySize == 0) {
-            SuccessfullyComplete = TRUE;
-            break;
-        }
-
-        if (!WriteFile(hTempFile, NewBinaryData, ActualBinarySize, &DataWritten, NULL) ||
-            DataWritten != ActualBinarySize) {
-
-            Return = YoriLibUpdErrorFileWrite;
-            goto Exit;
-        }
+    if (Download.Sequential) {
+        goto Exit;
     }
 
     //
-    //  The only acceptable reason to fail is all the data has been
-    //  received.
+    //  If a single stream was restarted, the object may be shorter than
+    //  the data written previously, so end the file where the data ended.
     //
 
-    if (!SuccessfullyComplete) {
-        Return = YoriLibUpdErrorInetRead;
-        goto Exit;
+    if (SegmentCount == 1) {
+        OffsetHigh = (LONG)(Segments[0].Offset >> 32);
+        SetFilePointer(hTempFile, (LONG)(Segments[0].Offset & 0xFFFFFFFF), &OffsetHigh, FILE_BEGIN);
+        SetEndOfFile(hTempFile);
+    }
+
+    if (LastModifiedKnown &&
+        SystemTimeToFileTime(&LastModified, &LastModifiedFileTime)) {
+
+        SetFileTime(hTempFile, NULL, NULL, &LastModifiedFileTime);
     }
 
     //
@@ -649,11 +1537,25 @@ YoriLibUpdateBinaryFromUrlWinInet(
     //
 
     if (TargetName == NULL) {
-        SetFilePointer(hTempFile, 0, NULL, FILE_BEGIN);
-        if (!ReadFile(hTempFile, NewBinaryData, 2, &ActualBinarySize, NULL) ||
-            ActualBinarySize != 2 ||
-            NewBinaryData[0] != 'M' ||
-            NewBinaryData[1] != 'Z' ) {
+        ActualBinarySize = 0;
+        if (Download.OverlappedWrites) {
+            ZeroMemory(&ReadOverlapped, sizeof(ReadOverlapped));
+            ReadOverlapped.hEvent = Segments[0].Overlapped.hEvent;
+            if (ReadFile(hTempFile, Signature, 2, NULL, &ReadOverlapped) ||
+                GetLastError() == ERROR_IO_PENDING) {
+
+                GetOverlappedResult(hTempFile, &ReadOverlapped, &ActualBinarySize, TRUE);
+            }
+        } else {
+            SetFilePointer(hTempFile, 0, NULL, FILE_BEGIN);
+            if (!ReadFile(hTempFile, Signature, 2, &ActualBinarySize, NULL)) {
+                ActualBinarySize = 0;
+            }
+        }
+
+        if (ActualBinarySize != 2 ||
+            Signature[0] != 'M' ||
+            Signature[1] != 'Z' ) {
 
             Return = YoriLibUpdErrorInetContents;
             goto Exit;
@@ -665,8 +1567,6 @@ YoriLibUpdateBinaryFromUrlWinInet(
     //
 
     CloseHandle(hTempFile);
-    YoriLibFree(NewBinaryData);
-    NewBinaryData = NULL;
     hTempFile = INVALID_HANDLE_VALUE;
 
     if (YoriLibUpdateBinaryFromFile(TargetName, &TempName)) {
@@ -677,8 +1577,14 @@ YoriLibUpdateBinaryFromUrlWinInet(
 
 Exit:
 
-    if (NewBinaryData != NULL) {
-        YoriLibFree(NewBinaryData);
+    for (Index = 0; Index < SegmentCount; Index++) {
+        if (Segments[Index].Overlapped.hEvent != NULL) {
+            CloseHandle(Segments[Index].Overlapped.hEvent);
+        }
+    }
+
+    if (Download.FileMutex != NULL) {
+        CloseHandle(Download.FileMutex);
     }
 
     if (hTempFile != INVALID_HANDLE_VALUE) {
@@ -700,6 +1606,375 @@ Exit:
     return Return;
 }
 
+/**
+ The maximum number of deltas that will be applied in sequence to bring a
+ file up to date.
+ */
+#define YORI_LIB_UPDATE_MAX_DELTAS (16)
+
+/**
+ Generate the name of a new temporary file.  The file is created by this
+ function and should be deleted by the caller.
+
+ @param TempName On successful completion, populated with the name of the
+        temporary file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibUpdateCreateTempFile(
+    __out PYORI_STRING TempName
+    )
+{
+    YORI_STRING TempPath;
+    YORI_STRING PrefixString;
+    HANDLE hTempFile;
+
+    if (!YoriLibGetTempPath(&TempPath, 0)) {
+        return FALSE;
+    }
+
+    YoriLibConstantString(&PrefixString, _T("UPD"));
+    if (!YoriLibGetTempFileName(&TempPath, &PrefixString, &hTempFile, TempName)) {
+        YoriLibFreeStringContents(&TempPath);
+        return FALSE;
+    }
+
+    CloseHandle(hTempFile);
+    YoriLibFreeStringContents(&TempPath);
+    return TRUE;
+}
+
+/**
+ Download the hash of the complete object, which is published next to the
+ object with a name of "<Url>.xxh64" and contains sixteen hex digits of the
+ XXH64 hash of the object.
+
+ @param Dll Pointer to a block of function pointers to call.
+
+ @param Url The Url of the complete object.
+
+ @param Agent The user agent to report to the remote web server.
+
+ @param Hash On successful completion, updated to contain the hash of the
+        complete object.
+
+ @return TRUE to indicate the hash was found, FALSE if it was not.
+ */
+__success(return)
+BOOL
+YoriLibUpdateDownloadPublishedHash(
+    __in PYORI_WININET_FUNCTIONS Dll,
+    __in PCYORI_STRING Url,
+    __in PCYORI_STRING Agent,
+    __out PDWORDLONG Hash
+    )
+{
+    YORI_STRING HashUrl;
+    YORI_STRING HashName;
+    YORI_STRING HashString;
+    TCHAR HashChars[16];
+    CHAR Buffer[16];
+    YORI_MAX_SIGNED_T Number;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    YORI_ALLOC_SIZE_T Index;
+    HANDLE hFile;
+    DWORD BytesRead;
+    BOOL Result;
+
+    YoriLibInitEmptyString(&HashUrl);
+    if (YoriLibYPrintf(&HashUrl, _T("%y.xxh64"), Url) < 0 ||
+        HashUrl.StartOfString == NULL) {
+
+        YoriLibFreeStringContents(&HashUrl);
+        return FALSE;
+    }
+
+    if (!YoriLibUpdateCreateTempFile(&HashName)) {
+        YoriLibFreeStringContents(&HashUrl);
+        return FALSE;
+    }
+    DeleteFile(HashName.StartOfString);
+
+    if (YoriLibUpdateBinaryFromUrlWinInet(Dll, &HashUrl, &HashName, Agent, NULL, NULL) != YoriLibUpdErrorSuccess) {
+        DeleteFile(HashName.StartOfString);
+        YoriLibFreeStringContents(&HashName);
+        YoriLibFreeStringContents(&HashUrl);
+        return FALSE;
+    }
+    YoriLibFreeStringContents(&HashUrl);
+
+    Result = FALSE;
+    hFile = CreateFile(HashName.StartOfString,
+                       GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL,
+                       NULL);
+
+    if (hFile != INVALID_HANDLE_VALUE) {
+        if (ReadFile(hFile, Buffer, sizeof(Buffer), &BytesRead, NULL) &&
+            BytesRead == sizeof(Buffer)) {
+
+            for (Index = 0; Index < sizeof(Buffer); Index++) {
+                HashChars[Index] = (TCHAR)(UCHAR)Buffer[Index];
+            }
+
+            YoriLibInitEmptyString(&HashString);
+            HashString.StartOfString = HashChars;
+            HashString.LengthInChars = sizeof(Buffer);
+
+            if (YoriLibStringToNumberBase(&HashString, 16, FALSE, &Number, &CharsConsumed) &&
+                CharsConsumed == HashString.LengthInChars) {
+
+                *Hash = (DWORDLONG)Number;
+                Result = TRUE;
+            }
+        }
+        CloseHandle(hFile);
+    }
+
+    DeleteFile(HashName.StartOfString);
+    YoriLibFreeStringContents(&HashName);
+    return Result;
+}
+
+/**
+ Attempt to update a local file by applying binary deltas rather than
+ downloading the complete object.  A delta that converts one version of the
+ object into the next is published next to the object with a name of
+ "<Url>.<hash>.ydlt", where hash is sixteen hex digits of the XXH64 hash of
+ the older file.  Deltas are downloaded and applied for as long as one exists
+ for the current contents, so a publisher only needs to provide a delta from
+ each version to its successor.  Each delta verifies the file it applies to
+ and the file that it generates.  The result is only used if it matches the
+ published hash of the complete object, so a chain of deltas that stops at
+ an intermediate version falls back to downloading the complete object.
+
+ @param Dll Pointer to a block of function pointers to call.
+
+ @param Url The Url of the complete object.
+
+ @param TargetName If specified, the local file to update.  If not
+        specified, the current executable is updated.
+
+ @param Agent The user agent to report to the remote web server.
+
+ @return YoriLibUpdErrorSuccess if deltas brought the local file up to
+         date with the complete object and the local file was replaced.  Any
+         other value indicates the caller should download the complete
+         object.
+ */
+YORI_LIB_UPDATE_ERROR
+YoriLibUpdateBinaryFromDeltasWinInet(
+    __in PYORI_WININET_FUNCTIONS Dll,
+    __in PCYORI_STRING Url,
+    __in_opt PCYORI_STRING TargetName,
+    __in PCYORI_STRING Agent
+    )
+{
+    YORI_STRING ExistingPath;
+    YORI_STRING CurrentPath;
+    YORI_STRING DeltaUrl;
+    YORI_STRING DeltaName;
+    YORI_STRING NewName;
+    DWORDLONG FileSize;
+    DWORDLONG Hash;
+    DWORDLONG PublishedHash;
+    DWORD DeltasApplied;
+    BOOLEAN UpToDate;
+    HANDLE hFile;
+    UCHAR Signature[2];
+    DWORD BytesRead;
+    YORI_LIB_UPDATE_ERROR Return;
+
+    YoriLibInitEmptyString(&ExistingPath);
+
+    //
+    //  Only full paths and the running executable are considered.  A file
+    //  name without a path is resolved by YoriLibUpdateBinaryFromFile and
+    //  will be downloaded whole.
+    //
+
+    if (TargetName == NULL) {
+        if (!YoriLibAllocateString(&ExistingPath, 32768)) {
+            return YoriLibUpdErrorFileWrite;
+        }
+
+        ExistingPath.LengthInChars = (YORI_ALLOC_SIZE_T)GetModuleFileName(NULL, ExistingPath.StartOfString, ExistingPath.LengthAllocated);
+        if (ExistingPath.LengthInChars == 0 ||
+            ExistingPath.LengthInChars >= ExistingPath.LengthAllocated) {
+
+            YoriLibFreeStringContents(&ExistingPath);
+            return YoriLibUpdErrorFileWrite;
+        }
+    } else if (YoriLibFindRightMostCharacter(TargetName, '\\') != NULL) {
+        YoriLibCloneString(&ExistingPath, (PYORI_STRING)TargetName);
+    } else {
+        return YoriLibUpdErrorFileWrite;
+    }
+
+    //
+    //  An empty or missing file has nothing to apply a delta to, so don't
+    //  ask for the published hash.
+    //
+
+    if (!YoriLibDeltaHashFile(&ExistingPath, &FileSize, &Hash) ||
+        FileSize == 0) {
+
+        YoriLibFreeStringContents(&ExistingPath);
+        return YoriLibUpdErrorInetContents;
+    }
+
+    //
+    //  Without the hash of the complete object there's no way to tell
+    //  whether deltas bring the file fully up to date.
+    //
+
+    if (!YoriLibUpdateDownloadPublishedHash(Dll, Url, Agent, &PublishedHash)) {
+        YoriLibFreeStringContents(&ExistingPath);
+        return YoriLibUpdErrorInetContents;
+    }
+
+    YoriLibInitEmptyString(&CurrentPath);
+    YoriLibCloneString(&CurrentPath, &ExistingPath);
+    YoriLibInitEmptyString(&DeltaUrl);
+    DeltasApplied = 0;
+    UpToDate = FALSE;
+
+    for (; DeltasApplied <= YORI_LIB_UPDATE_MAX_DELTAS; DeltasApplied++) {
+
+        if (!YoriLibDeltaHashFile(&CurrentPath, &FileSize, &Hash) ||
+            FileSize == 0) {
+
+            break;
+        }
+
+        if (Hash == PublishedHash) {
+            UpToDate = TRUE;
+            break;
+        }
+
+        if (DeltasApplied == YORI_LIB_UPDATE_MAX_DELTAS) {
+            break;
+        }
+
+        YoriLibFreeStringContents(&DeltaUrl);
+        if (YoriLibYPrintf(&DeltaUrl, _T("%y.%016llx.ydlt"), Url, Hash) < 0 ||
+            DeltaUrl.StartOfString == NULL) {
+
+            break;
+        }
+
+        //
+        //  The download moves the object over the target name, so remove
+        //  the placeholder to avoid it being treated as an older version.
+        //
+
+        if (!YoriLibUpdateCreateTempFile(&DeltaName)) {
+            break;
+        }
+        DeleteFile(DeltaName.StartOfString);
+
+        if (YoriLibUpdateBinaryFromUrlWinInet(Dll, &DeltaUrl, &DeltaName, Agent, NULL, NULL) != YoriLibUpdErrorSuccess) {
+            DeleteFile(DeltaName.StartOfString);
+            YoriLibFreeStringContents(&DeltaName);
+            break;
+        }
+
+        if (!YoriLibUpdateCreateTempFile(&NewName)) {
+            DeleteFile(DeltaName.StartOfString);
+            YoriLibFreeStringContents(&DeltaName);
+            break;
+        }
+
+        if (!YoriLibApplyDelta(&CurrentPath, &DeltaName, &NewName)) {
+            DeleteFile(DeltaName.StartOfString);
+            YoriLibFreeStringContents(&DeltaName);
+            DeleteFile(NewName.StartOfString);
+            YoriLibFreeStringContents(&NewName);
+            break;
+        }
+
+        DeleteFile(DeltaName.StartOfString);
+        YoriLibFreeStringContents(&DeltaName);
+
+        //
+        //  Intermediate versions are temporary files and are discarded once
+        //  the next version has been generated from them.
+        //
+
+        if (DeltasApplied > 0) {
+            DeleteFile(CurrentPath.StartOfString);
+        }
+        YoriLibFreeStringContents(&CurrentPath);
+        memcpy(&CurrentPath, &NewName, sizeof(YORI_STRING));
+    }
+
+    YoriLibFreeStringContents(&DeltaUrl);
+    YoriLibFreeStringContents(&ExistingPath);
+
+    //
+    //  If nothing was applied there's nothing to install.  If the chain
+    //  stopped before reaching the complete object, discard the
+    //  intermediate version so the caller downloads the complete object.
+    //
+
+    if (DeltasApplied == 0) {
+        YoriLibFreeStringContents(&CurrentPath);
+        return YoriLibUpdErrorInetContents;
+    }
+
+    if (!UpToDate) {
+        DeleteFile(CurrentPath.StartOfString);
+        YoriLibFreeStringContents(&CurrentPath);
+        return YoriLibUpdErrorInetContents;
+    }
+
+    //
+    //  For validation, if the request is to modify the current executable
+    //  check that the result is an executable.
+    //
+
+    Return = YoriLibUpdErrorSuccess;
+    if (TargetName == NULL) {
+        Return = YoriLibUpdErrorInetContents;
+        hFile = CreateFile(CurrentPath.StartOfString,
+                           GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_DELETE,
+                           NULL,
+                           OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL,
+                           NULL);
+
+        if (hFile != INVALID_HANDLE_VALUE) {
+            if (ReadFile(hFile, Signature, 2, &BytesRead, NULL) &&
+                BytesRead == 2 &&
+                Signature[0] == 'M' &&
+                Signature[1] == 'Z') {
+
+                Return = YoriLibUpdErrorSuccess;
+            }
+            CloseHandle(hFile);
+        }
+    }
+
+    if (Return == YoriLibUpdErrorSuccess &&
+        !YoriLibUpdateBinaryFromFile(TargetName, &CurrentPath)) {
+
+        Return = YoriLibUpdErrorFileReplace;
+    }
+
+    if (Return != YoriLibUpdErrorSuccess) {
+        DeleteFile(CurrentPath.StartOfString);
+    }
+
+    YoriLibFreeStringContents(&CurrentPath);
+    return Return;
+}
+
 /**
  Dump an RCDATA resource identified through an Url to a local file.
  This function is only used when pkglist.ini is embedded as RCDATA.
@@ -803,34 +2078,47 @@ Exit:
 }
 
 /**
- Download a file from the internet and store it in a local location.
+ Download a file from the internet and store it in a local location, or
+ write it to a caller supplied handle.
 
  @param Url The Url to download the file from.
 
  @param TargetName If specified, the local location to store the file.
-        If not specified, the current executable name is used.
+        If not specified, the current executable name is used.  This is
+        ignored if Options specifies an output handle.
 
  @param Agent The user agent to report to the remote web server.
 
  @param IfModifiedSince If specified, indicates a timestamp where a new
         object should only be downloaded if it is newer.
 
+ @param Options Optionally points to options controlling the download.
+
  @return An update error code indicating success or appropriate error.
  */
 YORI_LIB_UPDATE_ERROR
-YoriLibUpdateBinaryFromUrl(
+YoriLibUpdateBinaryFromUrlEx(
     __in PCYORI_STRING Url,
     __in_opt PCYORI_STRING TargetName,
     __in PCYORI_STRING Agent,
-    __in_opt PSYSTEMTIME IfModifiedSince
+    __in_opt PSYSTEMTIME IfModifiedSince,
+    __in_opt PYORI_LIB_UPDATE_OPTIONS Options
     )
 {
+    BOOLEAN ToFile;
+
     static const TCHAR DownloadPage[] = _T("https://github.com/datadiode/yori/releases/latest/download/");
 
     ASSERT(YoriLibIsStringNullTerminated(Url));
     ASSERT(YoriLibIsStringNullTerminated(Agent));
 
-    if (FindResource(NULL, _T("pkglist.ini"), RT_RCDATA) != NULL &&
+    ToFile = TRUE;
+    if (Options != NULL && Options->OutputHandle != NULL) {
+        ToFile = FALSE;
+    }
+
+    if (ToFile &&
+        FindResource(NULL, _T("pkglist.ini"), RT_RCDATA) != NULL &&
         _tcsnicmp(Url->StartOfString, DownloadPage, sizeof DownloadPage/sizeof DownloadPage[0] - 1) == 0) {
 
         return YoriLibUpdateBinaryFromRCData(Url, TargetName);
@@ -850,12 +2138,49 @@ YoriLibUpdateBinaryFromUrl(
         DllWinInet.pInternetReadFile != NULL &&
         DllWinInet.pInternetCloseHandle != NULL) {
 
-        return YoriLibUpdateBinaryFromUrlWinInet(&DllWinInet, Url, TargetName, Agent, IfModifiedSince);
+        //
+        //  If the local file can be brought up to date with deltas, there's
+        //  no need to transfer the whole object.
+        //
+
+        if (ToFile &&
+            YoriLibUpdateBinaryFromDeltasWinInet(&DllWinInet, Url, TargetName, Agent) == YoriLibUpdErrorSuccess) {
+
+            return YoriLibUpdErrorSuccess;
+        }
+
+        return YoriLibUpdateBinaryFromUrlWinInet(&DllWinInet, Url, TargetName, Agent, IfModifiedSince, Options);
     }
 
     return YoriLibUpdErrorInetInit;
 }
 
+/**
+ Download a file from the internet and store it in a local location.
+
+ @param Url The Url to download the file from.
+
+ @param TargetName If specified, the local location to store the file.
+        If not specified, the current executable name is used.
+
+ @param Agent The user agent to report to the remote web server.
+
+ @param IfModifiedSince If specified, indicates a timestamp where a new
+        object should only be downloaded if it is newer.
+
+ @return An update error code indicating success or appropriate error.
+ */
+YORI_LIB_UPDATE_ERROR
+YoriLibUpdateBinaryFromUrl(
+    __in PCYORI_STRING Url,
+    __in_opt PCYORI_STRING TargetName,
+    __in PCYORI_STRING Agent,
+    __in_opt PSYSTEMTIME IfModifiedSince
+    )
+{
+    return YoriLibUpdateBinaryFromUrlEx(Url, TargetName, Agent, IfModifiedSince, NULL);
+}
+
 /**
  Returns a constant (not allocated) string corresponding to the specified
  update error code.
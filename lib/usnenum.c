@@ -0,0 +1,960 @@
+/**
+ * @file lib/usnenum.c
+ *
+ * Yori enumerate files changed since a point in an NTFS change journal
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+
+/**
+ The number of bytes to read from the change journal in each request.
+ */
+#define YORI_LIB_USN_READ_SIZE (64 * 1024)
+
+/**
+ The number of characters needed to describe a file reference number as a
+ hash key, including a suffix character and NULL terminator.
+ */
+#define YORI_LIB_USN_KEY_LENGTH (sizeof("0123456789abcdef-"))
+
+/**
+ A file that has changed since the checkpoint.  A file can be described by
+ many journal records, which are combined into one of these so that each
+ file is reported once.
+ */
+typedef struct _YORI_LIB_USN_CHANGE {
+
+    /**
+     The entry within the hash table of changes, keyed by file reference
+     number.  Previous names of renamed files are recorded as separate
+     entries with a suffix on the key.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The entry within the list of changes, so they can be reported in the
+     order they were first observed.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The file reference number of the directory containing the file.
+     */
+    DWORDLONG ParentFileReferenceNumber;
+
+    /**
+     The combination of reasons from all records describing this file.
+     */
+    DWORD Reason;
+
+    /**
+     The attributes of the file from the most recent record.
+     */
+    DWORD FileAttributes;
+
+    /**
+     The name of the file within its parent directory.
+     */
+    YORI_STRING FileName;
+} YORI_LIB_USN_CHANGE, *PYORI_LIB_USN_CHANGE;
+
+/**
+ A directory whose full path has been resolved from its file reference
+ number.
+ */
+typedef struct _YORI_LIB_USN_PARENT {
+
+    /**
+     The entry within the hash table of directories, keyed by file reference
+     number.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The entry within the list of directories, for teardown.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The full path to the directory.  This is empty if the directory no
+     longer exists.
+     */
+    YORI_STRING Path;
+} YORI_LIB_USN_PARENT, *PYORI_LIB_USN_PARENT;
+
+/**
+ State used while processing the change journal of a volume.
+ */
+typedef struct _YORI_LIB_USN_CONTEXT {
+
+    /**
+     Handle to the volume.
+     */
+    HANDLE VolumeHandle;
+
+    /**
+     Changes keyed by file reference number.
+     */
+    PYORI_HASH_TABLE Changes;
+
+    /**
+     A list of changes in the order they were observed.
+     */
+    YORI_LIST_ENTRY ChangeList;
+
+    /**
+     Resolved directories keyed by file reference number.
+     */
+    PYORI_HASH_TABLE Parents;
+
+    /**
+     A list of resolved directories.
+     */
+    YORI_LIST_ENTRY ParentList;
+} YORI_LIB_USN_CONTEXT, *PYORI_LIB_USN_CONTEXT;
+
+/**
+ Context passed through a full enumeration when changes cannot be obtained
+ from the change journal.
+ */
+typedef struct _YORI_LIB_USN_FULL_ENUM_CONTEXT {
+
+    /**
+     The caller's callback.
+     */
+    PYORI_LIB_USN_CHANGE_FN Callback;
+
+    /**
+     The caller's context.
+     */
+    PVOID Context;
+} YORI_LIB_USN_FULL_ENUM_CONTEXT, *PYORI_LIB_USN_FULL_ENUM_CONTEXT;
+
+/**
+ Open the volume hosting a file and query the state of its change journal.
+ This requires the caller to be able to open the volume, which normally
+ requires an elevated caller.
+
+ @param FilePath Pointer to a fully specified, escaped path to a file on the
+        volume.
+
+ @param JournalData On successful completion, populated with information
+        about the change journal.
+
+ @return A handle to the volume, or INVALID_HANDLE_VALUE on failure, with
+         last error set to indicate the reason.
+ */
+HANDLE
+YoriLibUsnOpenVolume(
+    __in PYORI_STRING FilePath,
+    __out PUSN_JOURNAL_DATA JournalData
+    )
+{
+    YORI_STRING VolumeName;
+    HANDLE VolumeHandle;
+    DWORD BytesReturned;
+    DWORD Err;
+
+    YoriLibInitEmptyString(&VolumeName);
+    if (!YoriLibGetVolumePathName(FilePath, &VolumeName)) {
+        if (GetLastError() == ERROR_SUCCESS) {
+            SetLastError(ERROR_INVALID_NAME);
+        }
+        return INVALID_HANDLE_VALUE;
+    }
+
+    VolumeHandle = CreateFile(VolumeName.StartOfString,
+                              FILE_READ_DATA | FILE_READ_ATTRIBUTES | SYNCHRONIZE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL,
+                              OPEN_EXISTING,
+                              FILE_FLAG_BACKUP_SEMANTICS,
+                              NULL);
+
+    Err = GetLastError();
+    YoriLibFreeStringContents(&VolumeName);
+
+    if (VolumeHandle == INVALID_HANDLE_VALUE) {
+        SetLastError(Err);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    if (!DeviceIoControl(VolumeHandle,
+                         FSCTL_QUERY_USN_JOURNAL,
+                         NULL,
+                         0,
+                         JournalData,
+                         sizeof(USN_JOURNAL_DATA),
+                         &BytesReturned,
+                         NULL)) {
+
+        Err = GetLastError();
+        CloseHandle(VolumeHandle);
+        SetLastError(Err);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    return VolumeHandle;
+}
+
+/**
+ Record the current position of the change journal of the volume hosting a
+ directory, so that changes after this point can later be enumerated with
+ @ref YoriLibUsnEnumerateChanges .
+
+ @param Root Pointer to a fully specified, escaped path to a directory.
+
+ @param Checkpoint On successful completion, populated with the current
+        position of the change journal.
+
+ @return TRUE to indicate success, FALSE to indicate failure, including if
+         the volume has no change journal.
+ */
+__success(return)
+BOOL
+YoriLibUsnQueryCheckpoint(
+    __in PYORI_STRING Root,
+    __out PYORI_LIB_USN_CHECKPOINT Checkpoint
+    )
+{
+    USN_JOURNAL_DATA JournalData;
+    HANDLE VolumeHandle;
+
+    VolumeHandle = YoriLibUsnOpenVolume(Root, &JournalData);
+    if (VolumeHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    CloseHandle(VolumeHandle);
+    Checkpoint->JournalId = JournalData.UsnJournalID;
+    Checkpoint->NextUsn = (LONGLONG)JournalData.NextUsn;
+    return TRUE;
+}
+
+/**
+ Generate a hash key for a file reference number.
+
+ @param FileReferenceNumber The file reference number.
+
+ @param Suffix Optionally, a character to append to the key, allowing more
+        than one entry for the same file.
+
+ @param Key On successful completion, populated with a newly allocated key.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibUsnBuildKey(
+    __in DWORDLONG FileReferenceNumber,
+    __in TCHAR Suffix,
+    __out PYORI_STRING Key
+    )
+{
+    if (!YoriLibAllocateString(Key, YORI_LIB_USN_KEY_LENGTH)) {
+        return FALSE;
+    }
+
+    Key->LengthInChars = YoriLibSPrintf(Key->StartOfString, _T("%016llx"), FileReferenceNumber);
+    if (Suffix != '\0') {
+        Key->StartOfString[Key->LengthInChars] = Suffix;
+        Key->LengthInChars++;
+        Key->StartOfString[Key->LengthInChars] = '\0';
+    }
+    return TRUE;
+}
+
+/**
+ Combine a change journal record into the set of changes.  Records for the
+ same file are merged, except that the first name a renamed file had is
+ kept as a separate entry so its removal from that location can be reported.
+
+ @param UsnContext Pointer to the change journal context.
+
+ @param Record Pointer to the change journal record.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibUsnAddRecord(
+    __in PYORI_LIB_USN_CONTEXT UsnContext,
+    __in PUSN_RECORD Record
+    )
+{
+    PYORI_LIB_USN_CHANGE Change;
+    PYORI_HASH_ENTRY HashEntry;
+    YORI_STRING Key;
+    TCHAR Suffix;
+    BOOLEAN OldName;
+
+    OldName = FALSE;
+    Suffix = '\0';
+    if (Record->Reason & USN_REASON_RENAME_OLD_NAME) {
+        OldName = TRUE;
+        Suffix = '-';
+    }
+
+    if (!YoriLibUsnBuildKey(Record->FileReferenceNumber, Suffix, &Key)) {
+        return FALSE;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(UsnContext->Changes, &Key);
+    if (HashEntry != NULL) {
+        YoriLibFreeStringContents(&Key);
+
+        //
+        //  Only the original location of a renamed file is of interest, so
+        //  later renames from intermediate names are ignored.
+        //
+
+        if (OldName) {
+            return TRUE;
+        }
+
+        Change = HashEntry->Context;
+    } else {
+        Change = YoriLibMalloc(sizeof(YORI_LIB_USN_CHANGE));
+        if (Change == NULL) {
+            YoriLibFreeStringContents(&Key);
+            return FALSE;
+        }
+
+        ZeroMemory(Change, sizeof(YORI_LIB_USN_CHANGE));
+        YoriLibHashInsertByKey(UsnContext->Changes, &Key, Change, &Change->HashEntry);
+        YoriLibFreeStringContents(&Key);
+        YoriLibAppendList(&UsnContext->ChangeList, &Change->ListEntry);
+    }
+
+    //
+    //  The most recent record describes where the file is now.
+    //
+
+    YoriLibFreeStringContents(&Change->FileName);
+    if (!YoriLibAllocateString(&Change->FileName, (YORI_ALLOC_SIZE_T)(Record->FileNameLength / sizeof(TCHAR) + 1))) {
+        return FALSE;
+    }
+
+    memcpy(Change->FileName.StartOfString, (PUCHAR)Record + Record->FileNameOffset, Record->FileNameLength);
+    Change->FileName.LengthInChars = (YORI_ALLOC_SIZE_T)(Record->FileNameLength / sizeof(TCHAR));
+    Change->FileName.StartOfString[Change->FileName.LengthInChars] = '\0';
+
+    Change->ParentFileReferenceNumber = Record->ParentFileReferenceNumber;
+    Change->FileAttributes = Record->FileAttributes;
+    Change->Reason = Change->Reason | Record->Reason;
+
+    return TRUE;
+}
+
+/**
+ Find the full path to a directory from its file reference number.  Results
+ are cached since many changed files are typically in the same directory.
+
+ @param UsnContext Pointer to the change journal context.
+
+ @param FileReferenceNumber The file reference number of the directory.
+
+ @return Pointer to the path of the directory, which is empty if the
+         directory no longer exists, or NULL on allocation failure.
+ */
+PYORI_STRING
+YoriLibUsnResolveParent(
+    __in PYORI_LIB_USN_CONTEXT UsnContext,
+    __in DWORDLONG FileReferenceNumber
+    )
+{
+    PYORI_LIB_USN_PARENT Parent;
+    PYORI_HASH_ENTRY HashEntry;
+    YORI_FILE_ID_DESCRIPTOR FileId;
+    YORI_STRING Key;
+    HANDLE DirHandle;
+    DWORD LengthNeeded;
+
+    if (!YoriLibUsnBuildKey(FileReferenceNumber, '\0', &Key)) {
+        return NULL;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(UsnContext->Parents, &Key);
+    if (HashEntry != NULL) {
+        YoriLibFreeStringContents(&Key);
+        Parent = HashEntry->Context;
+        return &Parent->Path;
+    }
+
+    Parent = YoriLibMalloc(sizeof(YORI_LIB_USN_PARENT));
+    if (Parent == NULL) {
+        YoriLibFreeStringContents(&Key);
+        return NULL;
+    }
+
+    ZeroMemory(Parent, sizeof(YORI_LIB_USN_PARENT));
+    YoriLibHashInsertByKey(UsnContext->Parents, &Key, Parent, &Parent->HashEntry);
+    YoriLibFreeStringContents(&Key);
+    YoriLibAppendList(&UsnContext->ParentList, &Parent->ListEntry);
+
+    ZeroMemory(&FileId, sizeof(FileId));
+    FileId.dwSize = sizeof(FileId);
+    FileId.Type = 0;
+    FileId.FileId.QuadPart = (LONGLONG)FileReferenceNumber;
+
+    DirHandle = DllKernel32.pOpenFileById(UsnContext->VolumeHandle,
+                                          &FileId,
+                                          FILE_READ_ATTRIBUTES | SYNCHRONIZE,
+                                          FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                          NULL,
+                                          FILE_FLAG_BACKUP_SEMANTICS);
+
+    if (DirHandle == INVALID_HANDLE_VALUE) {
+        return &Parent->Path;
+    }
+
+    LengthNeeded = DllKernel32.pGetFinalPathNameByHandleW(DirHandle, NULL, 0, 0);
+    if (LengthNeeded > 0 &&
+        YoriLibIsSizeAllocatable(LengthNeeded) &&
+        YoriLibAllocateString(&Parent->Path, (YORI_ALLOC_SIZE_T)LengthNeeded)) {
+
+        LengthNeeded = DllKernel32.pGetFinalPathNameByHandleW(DirHandle, Parent->Path.StartOfString, Parent->Path.LengthAllocated, 0);
+        if (LengthNeeded == 0 || LengthNeeded >= Parent->Path.LengthAllocated) {
+            YoriLibFreeStringContents(&Parent->Path);
+        } else {
+            Parent->Path.LengthInChars = (YORI_ALLOC_SIZE_T)LengthNeeded;
+        }
+    }
+
+    CloseHandle(DirHandle);
+    return &Parent->Path;
+}
+
+/**
+ Return TRUE if a path is the root directory or an object within it.
+
+ @param Root Pointer to the root directory.
+
+ @param Path Pointer to the path to check.
+
+ @return TRUE if the path is within the root, FALSE if it is not.
+ */
+BOOLEAN
+YoriLibUsnIsPathWithinRoot(
+    __in PYORI_STRING Root,
+    __in PYORI_STRING Path
+    )
+{
+    YORI_ALLOC_SIZE_T RootLength;
+
+    RootLength = Root->LengthInChars;
+    while (RootLength > 0 && YoriLibIsSep(Root->StartOfString[RootLength - 1])) {
+        RootLength--;
+    }
+
+    if (Path->LengthInChars < RootLength ||
+        YoriLibCompareStringInsCnt(Root, Path, RootLength) != 0) {
+
+        return FALSE;
+    }
+
+    if (Path->LengthInChars == RootLength ||
+        YoriLibIsSep(Path->StartOfString[RootLength])) {
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Report each combined change within the root directory to the caller.
+
+ @param UsnContext Pointer to the change journal context.
+
+ @param Root Pointer to the root directory.
+
+ @param Callback The callback to invoke for each change.
+
+ @param Context Caller provided context to pass to the callback.
+
+ @return TRUE to indicate success, FALSE to indicate failure or that the
+         callback requested enumeration to stop.
+ */
+__success(return)
+BOOL
+YoriLibUsnReportChanges(
+    __in PYORI_LIB_USN_CONTEXT UsnContext,
+    __in PYORI_STRING Root,
+    __in PYORI_LIB_USN_CHANGE_FN Callback,
+    __in_opt PVOID Context
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIB_USN_CHANGE Change;
+    PYORI_STRING ParentPath;
+    YORI_STRING FullPath;
+    DWORD Flags;
+    BOOL Result;
+
+    YoriLibInitEmptyString(&FullPath);
+    Result = TRUE;
+
+    ListEntry = YoriLibGetNextListEntry(&UsnContext->ChangeList, NULL);
+    while (ListEntry != NULL) {
+        Change = CONTAINING_RECORD(ListEntry, YORI_LIB_USN_CHANGE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&UsnContext->ChangeList, ListEntry);
+
+        //
+        //  A file that was created and deleted since the checkpoint never
+        //  existed as far as the caller is concerned.
+        //
+
+        if ((Change->Reason & USN_REASON_FILE_CREATE) &&
+            (Change->Reason & USN_REASON_FILE_DELETE)) {
+
+            continue;
+        }
+
+        ParentPath = YoriLibUsnResolveParent(UsnContext, Change->ParentFileReferenceNumber);
+        if (ParentPath == NULL) {
+            Result = FALSE;
+            break;
+        }
+
+        //
+        //  If the parent no longer exists, its deletion is reported, which
+        //  implies its contents are gone too.
+        //
+
+        if (ParentPath->LengthInChars == 0) {
+            continue;
+        }
+
+        if (!YoriLibUsnIsPathWithinRoot(Root, ParentPath)) {
+            continue;
+        }
+
+        FullPath.LengthInChars = 0;
+        if (YoriLibYPrintf(&FullPath, _T("%y\\%y"), ParentPath, &Change->FileName) < 0) {
+            Result = FALSE;
+            break;
+        }
+
+        Flags = 0;
+        if (Change->FileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            Flags = Flags | YORI_LIB_USN_CHANGE_DIRECTORY;
+        }
+        if (Change->Reason & (USN_REASON_FILE_DELETE | USN_REASON_RENAME_OLD_NAME)) {
+            Flags = Flags | YORI_LIB_USN_CHANGE_DELETED;
+        } else if (Change->Reason & USN_REASON_RENAME_NEW_NAME) {
+            Flags = Flags | YORI_LIB_USN_CHANGE_RENAMED;
+        }
+
+        if (!Callback(&FullPath, Flags, Context)) {
+            SetLastError(ERROR_OPERATION_ABORTED);
+            Result = FALSE;
+            break;
+        }
+    }
+
+    YoriLibFreeStringContents(&FullPath);
+    return Result;
+}
+
+/**
+ Free all state collected while processing the change journal.
+
+ @param UsnContext Pointer to the change journal context.
+ */
+VOID
+YoriLibUsnCleanupContext(
+    __in PYORI_LIB_USN_CONTEXT UsnContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIB_USN_CHANGE Change;
+    PYORI_LIB_USN_PARENT Parent;
+
+    ListEntry = YoriLibGetNextListEntry(&UsnContext->ChangeList, NULL);
+    while (ListEntry != NULL) {
+        Change = CONTAINING_RECORD(ListEntry, YORI_LIB_USN_CHANGE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&UsnContext->ChangeList, ListEntry);
+        YoriLibRemoveListItem(&Change->ListEntry);
+        YoriLibHashRemoveByEntry(&Change->HashEntry);
+        YoriLibFreeStringContents(&Change->FileName);
+        YoriLibFree(Change);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&UsnContext->ParentList, NULL);
+    while (ListEntry != NULL) {
+        Parent = CONTAINING_RECORD(ListEntry, YORI_LIB_USN_PARENT, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&UsnContext->ParentList, ListEntry);
+        YoriLibRemoveListItem(&Parent->ListEntry);
+        YoriLibHashRemoveByEntry(&Parent->HashEntry);
+        YoriLibFreeStringContents(&Parent->Path);
+        YoriLibFree(Parent);
+    }
+
+    if (UsnContext->Changes != NULL) {
+        YoriLibFreeEmptyHashTable(UsnContext->Changes);
+        UsnContext->Changes = NULL;
+    }
+
+    if (UsnContext->Parents != NULL) {
+        YoriLibFreeEmptyHashTable(UsnContext->Parents);
+        UsnContext->Parents = NULL;
+    }
+}
+
+/**
+ Read all records from the change journal between the checkpoint and the
+ current end of the journal, combining them into a set of changes.
+
+ @param UsnContext Pointer to the change journal context.
+
+ @param JournalData Pointer to the current state of the change journal.
+
+ @param StartUsn The first record to read.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  If records
+         after the checkpoint have been discarded from the journal, last
+         error is set to ERROR_JOURNAL_ENTRY_DELETED.
+ */
+__success(return)
+BOOL
+YoriLibUsnReadJournal(
+    __in PYORI_LIB_USN_CONTEXT UsnContext,
+    __in PUSN_JOURNAL_DATA JournalData,
+    __in LONGLONG StartUsn
+    )
+{
+    YORI_READ_USN_JOURNAL_DATA ReadData;
+    PUSN_RECORD Record;
+    PUCHAR Buffer;
+    DWORD BytesReturned;
+    DWORD Offset;
+    LONGLONG NextUsn;
+    BOOL Result;
+
+    Buffer = YoriLibMalloc(YORI_LIB_USN_READ_SIZE);
+    if (Buffer == NULL) {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+
+    ZeroMemory(&ReadData, sizeof(ReadData));
+    ReadData.StartUsn = StartUsn;
+    ReadData.ReasonMask = 0xFFFFFFFF;
+    ReadData.UsnJournalID = JournalData->UsnJournalID;
+
+    Result = TRUE;
+    while (ReadData.StartUsn < (LONGLONG)JournalData->NextUsn) {
+        if (!DeviceIoControl(UsnContext->VolumeHandle,
+                             FSCTL_READ_USN_JOURNAL,
+                             &ReadData,
+                             sizeof(ReadData),
+                             Buffer,
+                             YORI_LIB_USN_READ_SIZE,
+                             &BytesReturned,
+                             NULL)) {
+
+            Result = FALSE;
+            break;
+        }
+
+        if (BytesReturned < sizeof(LONGLONG)) {
+            break;
+        }
+
+        //
+        //  The buffer starts with the USN to read from next, followed by
+        //  a series of records.  Only version 2 records are understood,
+        //  which is what the volume returns for this version of the read
+        //  request.
+        //
+
+        NextUsn = *(PLONGLONG)Buffer;
+        Offset = sizeof(LONGLONG);
+
+        while (Offset + FIELD_OFFSET(USN_RECORD, FileName) <= BytesReturned) {
+            Record = (PUSN_RECORD)(Buffer + Offset);
+            if (Record->RecordLength == 0 ||
+                Offset + Record->RecordLength > BytesReturned) {
+
+                break;
+            }
+
+            if (Record->MajorVersion == 2 &&
+                Record->Usn < (LONGLONG)JournalData->NextUsn &&
+                (DWORD)Record->FileNameOffset + Record->FileNameLength <= Record->RecordLength) {
+
+                if (!YoriLibUsnAddRecord(UsnContext, Record)) {
+                    SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+                    Result = FALSE;
+                    break;
+                }
+            }
+
+            Offset = Offset + Record->RecordLength;
+        }
+
+        if (!Result) {
+            break;
+        }
+
+        if (NextUsn <= ReadData.StartUsn) {
+            break;
+        }
+
+        ReadData.StartUsn = NextUsn;
+
+        if (YoriLibIsOperationCancelled()) {
+            SetLastError(ERROR_OPERATION_ABORTED);
+            Result = FALSE;
+            break;
+        }
+    }
+
+    YoriLibFree(Buffer);
+    return Result;
+}
+
+/**
+ A callback invoked for each object found during a full enumeration, which
+ reports the object to the caller as changed.
+
+ @param FilePath Pointer to the full path of the object.
+
+ @param FileInfo Pointer to information about the object.
+
+ @param Depth Recursion depth, ignored in this function.
+
+ @param Context Pointer to the full enumeration context.
+
+ @return TRUE to continue enumerating, FALSE to stop.
+ */
+BOOL
+YoriLibUsnFullEnumCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PYORI_LIB_USN_FULL_ENUM_CONTEXT FullEnumContext;
+    DWORD Flags;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    FullEnumContext = (PYORI_LIB_USN_FULL_ENUM_CONTEXT)Context;
+
+    Flags = 0;
+    if (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        Flags = YORI_LIB_USN_CHANGE_DIRECTORY;
+    }
+
+    return FullEnumContext->Callback(FilePath, Flags, FullEnumContext->Context);
+}
+
+/**
+ Report every object within a directory as changed, by enumerating the
+ directory tree.
+
+ @param Root Pointer to the root directory.
+
+ @param Callback The callback to invoke for each object.
+
+ @param Context Caller provided context to pass to the callback.
+
+ @return TRUE to indicate success, FALSE to indicate failure or that the
+         callback requested enumeration to stop.
+ */
+__success(return)
+BOOL
+YoriLibUsnFullEnumerate(
+    __in PYORI_STRING Root,
+    __in PYORI_LIB_USN_CHANGE_FN Callback,
+    __in_opt PVOID Context
+    )
+{
+    YORI_LIB_USN_FULL_ENUM_CONTEXT FullEnumContext;
+    YORI_STRING FileSpec;
+    BOOL Result;
+
+    YoriLibInitEmptyString(&FileSpec);
+    if (YoriLibYPrintf(&FileSpec, _T("%y\\*"), Root) < 0) {
+        return FALSE;
+    }
+
+    FullEnumContext.Callback = Callback;
+    FullEnumContext.Context = Context;
+
+    Result = YoriLibForEachFile(&FileSpec,
+                                YORILIB_FILEENUM_RETURN_FILES |
+                                  YORILIB_FILEENUM_RETURN_DIRECTORIES |
+                                  YORILIB_FILEENUM_RECURSE_AFTER_RETURN |
+                                  YORILIB_FILEENUM_NO_LINK_TRAVERSE,
+                                0,
+                                YoriLibUsnFullEnumCallback,
+                                NULL,
+                                &FullEnumContext);
+
+    YoriLibFreeStringContents(&FileSpec);
+    return Result;
+}
+
+/**
+ Call a callback for every file and directory within a directory tree that
+ has changed since a checkpoint.  Changes are obtained from the change
+ journal of the volume, so the time taken is proportional to the number of
+ changes on the volume rather than the number of files in the tree.  Each
+ changed object is reported once, however many times it changed.
+
+ If changes cannot be obtained from the journal, because the checkpoint is
+ empty, the journal has been recreated, records after the checkpoint have
+ been discarded, or the volume cannot be opened, every object in the tree is
+ reported instead.  In this case objects that were deleted are not
+ reported, so callers that track deletions need to treat anything not
+ reported as deleted.
+
+ Renaming or moving a directory changes the path of everything within it
+ without any record of those objects, so callers that need those paths need
+ to enumerate the contents of directories reported as renamed.
+
+ @param Root Pointer to a fully specified, escaped path to a directory.
+
+ @param Checkpoint On input, the point in the journal to report changes
+        from.  This may be zero filled to request a full enumeration.  On
+        successful completion, updated to the point in the journal to
+        supply next time, which may be zero filled if the volume has no
+        change journal.
+
+ @param Callback The callback to invoke for each changed object.
+
+ @param Context Caller provided context to pass to the callback.
+
+ @param FullEnumeration Optionally points to a boolean updated to TRUE if
+        every object was reported because changes could not be obtained
+        from the journal.
+
+ @return TRUE to indicate success, FALSE to indicate failure or that the
+         callback requested enumeration to stop.
+ */
+__success(return)
+BOOL
+YoriLibUsnEnumerateChanges(
+    __in PYORI_STRING Root,
+    __inout PYORI_LIB_USN_CHECKPOINT Checkpoint,
+    __in PYORI_LIB_USN_CHANGE_FN Callback,
+    __in_opt PVOID Context,
+    __out_opt PBOOLEAN FullEnumeration
+    )
+{
+    YORI_LIB_USN_CONTEXT UsnContext;
+    USN_JOURNAL_DATA JournalData;
+    BOOLEAN JournalUsable;
+    BOOL Result;
+    DWORD Err;
+
+    if (FullEnumeration != NULL) {
+        *FullEnumeration = FALSE;
+    }
+
+    YoriLibLoadKernel32Functions();
+
+    ZeroMemory(&UsnContext, sizeof(UsnContext));
+    YoriLibInitializeListHead(&UsnContext.ChangeList);
+    YoriLibInitializeListHead(&UsnContext.ParentList);
+
+    UsnContext.VolumeHandle = YoriLibUsnOpenVolume(Root, &JournalData);
+    JournalUsable = FALSE;
+    if (UsnContext.VolumeHandle != INVALID_HANDLE_VALUE &&
+        DllKernel32.pOpenFileById != NULL &&
+        DllKernel32.pGetFinalPathNameByHandleW != NULL &&
+        Checkpoint->JournalId != 0 &&
+        Checkpoint->JournalId == JournalData.UsnJournalID &&
+        Checkpoint->NextUsn >= (LONGLONG)JournalData.FirstUsn &&
+        Checkpoint->NextUsn <= (LONGLONG)JournalData.NextUsn) {
+
+        JournalUsable = TRUE;
+    }
+
+    if (JournalUsable) {
+        UsnContext.Changes = YoriLibAllocateHashTable(1000);
+        UsnContext.Parents = YoriLibAllocateHashTable(250);
+        if (UsnContext.Changes == NULL || UsnContext.Parents == NULL) {
+            YoriLibUsnCleanupContext(&UsnContext);
+            CloseHandle(UsnContext.VolumeHandle);
+            SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+            return FALSE;
+        }
+
+        if (!YoriLibUsnReadJournal(&UsnContext, &JournalData, Checkpoint->NextUsn)) {
+            Err = GetLastError();
+            if (Err != ERROR_JOURNAL_ENTRY_DELETED &&
+                Err != ERROR_JOURNAL_DELETE_IN_PROGRESS &&
+                Err != ERROR_JOURNAL_NOT_ACTIVE) {
+
+                YoriLibUsnCleanupContext(&UsnContext);
+                CloseHandle(UsnContext.VolumeHandle);
+                SetLastError(Err);
+                return FALSE;
+            }
+            JournalUsable = FALSE;
+        }
+    }
+
+    if (JournalUsable) {
+        Result = YoriLibUsnReportChanges(&UsnContext, Root, Callback, Context);
+    } else {
+        if (FullEnumeration != NULL) {
+            *FullEnumeration = TRUE;
+        }
+        Result = YoriLibUsnFullEnumerate(Root, Callback, Context);
+    }
+
+    Err = GetLastError();
+    YoriLibUsnCleanupContext(&UsnContext);
+
+    //
+    //  The new checkpoint is the end of the journal as it was before any
+    //  records were read or any enumeration performed, so anything that
+    //  changes while this is happening is reported next time.
+    //
+
+    if (Result) {
+        if (UsnContext.VolumeHandle != INVALID_HANDLE_VALUE) {
+            Checkpoint->JournalId = JournalData.UsnJournalID;
+            Checkpoint->NextUsn = (LONGLONG)JournalData.NextUsn;
+        } else {
+            Checkpoint->JournalId = 0;
+            Checkpoint->NextUsn = 0;
+        }
+    }
+
+    if (UsnContext.VolumeHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(UsnContext.VolumeHandle);
+    }
+
+    SetLastError(Err);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
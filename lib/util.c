@@ -519,7 +519,11 @@ YoriLibGetSystemTimeAsInteger(VOID)
 }
 
 /**
- Attempt to delete a file using POSIX semantics.
+ Attempt to delete a file using POSIX semantics.  The name is removed from
+ the namespace as soon as this call returns, even if other handles to the
+ file remain open, so a parent directory can be removed immediately after
+ its children.  Where the OS supports it, read only files are deleted
+ without needing to change their attributes first.
 
  @param FileName Pointer to the file name to delete.
 
@@ -552,10 +556,24 @@ YoriLibPosixDeleteFile(
         return FALSE;
     }
 
-    DispositionInfo.Flags = FILE_DISPOSITION_FLAG_DELETE | FILE_DISPOSITION_FLAG_POSIX_SEMANTICS;
+    //
+    //  Versions of Windows that support POSIX semantics but predate the
+    //  ignore read only flag fail the request as invalid, so try again
+    //  without it.
+    //
+
+    DispositionInfo.Flags = FILE_DISPOSITION_FLAG_DELETE | FILE_DISPOSITION_FLAG_POSIX_SEMANTICS | FILE_DISPOSITION_FLAG_IGNORE_READONLY_ATTRIBUTE;
     if (!DllKernel32.pSetFileInformationByHandle(hFile, FileDispositionInfoEx, &DispositionInfo, sizeof(DispositionInfo))) {
         DWORD Err;
         Err = GetLastError();
+        if (Err == ERROR_INVALID_PARAMETER) {
+            DispositionInfo.Flags = FILE_DISPOSITION_FLAG_DELETE | FILE_DISPOSITION_FLAG_POSIX_SEMANTICS;
+            if (DllKernel32.pSetFileInformationByHandle(hFile, FileDispositionInfoEx, &DispositionInfo, sizeof(DispositionInfo))) {
+                CloseHandle(hFile);
+                return TRUE;
+            }
+            Err = GetLastError();
+        }
         CloseHandle(hFile);
         SetLastError(Err);
         return FALSE;
@@ -4,7 +4,7 @@
  * Convert VT100/ANSI escape sequences into other formats, including the 
  * console.
  *
- * Copyright (c) 2015-2021 Malcolm J. Smith
+ * Copyright (c) 2015-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -62,6 +62,318 @@ BOOLEAN YoriLibVtResetColorSet = FALSE;
  */
 LPTSTR YoriLibVtLineEnding = _T("\r\n");
 
+/**
+ The number of bytes of output to accumulate before writing them to the
+ device when output buffering is enabled.
+ */
+#define YORI_LIB_OUTPUT_BUFFER_SIZE (64 * 1024)
+
+/**
+ The number of bytes initially allocated to hold output when output is
+ being captured.  The buffer grows as needed.
+ */
+#define YORI_LIB_OUTPUT_CAPTURE_INITIAL_SIZE (4 * 1024)
+
+/**
+ State describing an output stream whose contents are accumulated in memory
+ and written to the device in large blocks rather than as each string is
+ generated.
+ */
+typedef struct _YORI_LIB_OUTPUT_BUFFER {
+
+    /**
+     The handle to the device being buffered.
+     */
+    HANDLE Handle;
+
+    /**
+     The thread which enabled buffering.  The buffer is not synchronized, so
+     output from any other thread is written to the device directly.
+     */
+    DWORD ThreadId;
+
+    /**
+     The number of bytes currently in the buffer.
+     */
+    DWORD BytesInBuffer;
+
+    /**
+     The number of bytes allocated to the buffer.
+     */
+    DWORD BytesAllocated;
+
+    /**
+     TRUE if buffering is enabled.
+     */
+    BOOLEAN Active;
+
+    /**
+     TRUE if output is being captured.  In this case the buffer grows to
+     hold all output and is never written to the device.
+     */
+    BOOLEAN Capture;
+
+    /**
+     TRUE if the device is a console.  In this case the buffer contains
+     TCHARs to be written with WriteConsole.  If FALSE, the buffer contains
+     bytes in the output encoding to be written with WriteFile.
+     */
+    BOOLEAN IsConsole;
+
+    /**
+     Pointer to the buffer.
+     */
+    PUCHAR Buffer;
+
+} YORI_LIB_OUTPUT_BUFFER, *PYORI_LIB_OUTPUT_BUFFER;
+
+/**
+ The output buffer for standard output, if buffering has been enabled.
+ */
+YORI_LIB_OUTPUT_BUFFER YoriLibOutputBuffer;
+
+/**
+ Indicate whether output to a device from the current thread should be
+ accumulated in the output buffer.
+
+ @param hOutput Handle to the device to receive output.
+
+ @return TRUE if the output should be buffered, FALSE if it should be
+         written to the device.
+ */
+BOOLEAN
+YoriLibIsOutputBuffered(
+    __in HANDLE hOutput
+    )
+{
+    if (YoriLibOutputBuffer.Active &&
+        YoriLibOutputBuffer.Handle == hOutput &&
+        YoriLibOutputBuffer.ThreadId == GetCurrentThreadId()) {
+
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ Write any output accumulated in the output buffer to its device.  This is
+ called implicitly when the buffer fills, before console attributes are
+ changed, and before writing to a different device.  Applications should
+ call it explicitly before waiting for user input.  If called from a thread
+ other than the one that enabled buffering, this function does nothing.
+ */
+VOID
+YoriLibFlushOutput(VOID)
+{
+    DWORD BytesTransferred;
+
+    if (!YoriLibOutputBuffer.Active ||
+        YoriLibOutputBuffer.Capture ||
+        YoriLibOutputBuffer.BytesInBuffer == 0 ||
+        YoriLibOutputBuffer.ThreadId != GetCurrentThreadId()) {
+
+        return;
+    }
+
+    if (YoriLibOutputBuffer.IsConsole) {
+        WriteConsole(YoriLibOutputBuffer.Handle,
+                     YoriLibOutputBuffer.Buffer,
+                     YoriLibOutputBuffer.BytesInBuffer / sizeof(TCHAR),
+                     &BytesTransferred,
+                     NULL);
+    } else {
+        WriteFile(YoriLibOutputBuffer.Handle,
+                  YoriLibOutputBuffer.Buffer,
+                  YoriLibOutputBuffer.BytesInBuffer,
+                  &BytesTransferred,
+                  NULL);
+    }
+
+    YoriLibOutputBuffer.BytesInBuffer = 0;
+}
+
+/**
+ Reserve space in the output buffer for data about to be generated, writing
+ any existing buffer contents to the device if there is insufficient space.
+
+ @param Length The number of bytes to reserve.
+
+ @return Pointer to the location in the buffer to populate, or NULL if the
+         data is larger than the buffer and should be written to the device
+         directly.  On success the caller is expected to populate all of the
+         requested bytes.
+ */
+PVOID
+YoriLibOutputBufferReserve(
+    __in DWORD Length
+    )
+{
+    PVOID Result;
+    PUCHAR NewBuffer;
+    DWORD NewSize;
+
+    if (YoriLibOutputBuffer.BytesInBuffer + Length > YoriLibOutputBuffer.BytesAllocated) {
+
+        //
+        //  Captured output has nowhere to go, so grow the buffer.
+        //
+
+        if (YoriLibOutputBuffer.Capture) {
+            NewSize = YoriLibOutputBuffer.BytesAllocated * 2;
+            if (NewSize < YoriLibOutputBuffer.BytesInBuffer + Length) {
+                NewSize = YoriLibOutputBuffer.BytesInBuffer + Length;
+            }
+            NewBuffer = YoriLibMalloc(NewSize);
+            if (NewBuffer == NULL) {
+                return NULL;
+            }
+            memcpy(NewBuffer, YoriLibOutputBuffer.Buffer, YoriLibOutputBuffer.BytesInBuffer);
+            YoriLibFree(YoriLibOutputBuffer.Buffer);
+            YoriLibOutputBuffer.Buffer = NewBuffer;
+            YoriLibOutputBuffer.BytesAllocated = NewSize;
+        } else {
+            YoriLibFlushOutput();
+        }
+    }
+
+    if (Length > YoriLibOutputBuffer.BytesAllocated) {
+        return NULL;
+    }
+
+    Result = YoriLibAddToPointer(YoriLibOutputBuffer.Buffer, YoriLibOutputBuffer.BytesInBuffer);
+    YoriLibOutputBuffer.BytesInBuffer += Length;
+    return Result;
+}
+
+/**
+ Enable buffering of standard output.  Once enabled, text written by the
+ current thread is accumulated in memory and written to the device when the
+ buffer fills, when it is explicitly flushed, or when buffering is disabled.
+ This is intended for applications that generate large volumes of output,
+ where issuing a system call for each string is expensive.  The type of the
+ device is determined once here rather than on each call.
+
+ @return TRUE to indicate buffering is enabled, FALSE if it could not be
+         enabled, in which case output is written to the device directly.
+ */
+BOOLEAN
+YoriLibEnableOutputBuffering(VOID)
+{
+    DWORD CurrentMode;
+
+    if (YoriLibOutputBuffer.Active) {
+        return TRUE;
+    }
+
+    YoriLibOutputBuffer.Buffer = YoriLibMalloc(YORI_LIB_OUTPUT_BUFFER_SIZE);
+    if (YoriLibOutputBuffer.Buffer == NULL) {
+        return FALSE;
+    }
+
+    YoriLibOutputBuffer.Handle = GetStdHandle(STD_OUTPUT_HANDLE);
+    YoriLibOutputBuffer.ThreadId = GetCurrentThreadId();
+    YoriLibOutputBuffer.BytesInBuffer = 0;
+    YoriLibOutputBuffer.BytesAllocated = YORI_LIB_OUTPUT_BUFFER_SIZE;
+    YoriLibOutputBuffer.IsConsole = FALSE;
+    if (GetConsoleMode(YoriLibOutputBuffer.Handle, &CurrentMode)) {
+        YoriLibOutputBuffer.IsConsole = TRUE;
+    }
+    YoriLibOutputBuffer.Active = TRUE;
+    return TRUE;
+}
+
+/**
+ Write any buffered output to its device and disable output buffering.  This
+ should be called from the thread that enabled buffering.
+ */
+VOID
+YoriLibDisableOutputBuffering(VOID)
+{
+    if (!YoriLibOutputBuffer.Active ||
+        YoriLibOutputBuffer.Capture) {
+
+        return;
+    }
+
+    YoriLibFlushOutput();
+    YoriLibOutputBuffer.Active = FALSE;
+    YoriLibFree(YoriLibOutputBuffer.Buffer);
+    YoriLibOutputBuffer.Buffer = NULL;
+}
+
+/**
+ Begin capturing standard output.  Once enabled, text written by the current
+ thread to standard output is accumulated in memory in the same form that
+ would have been written to the device, and is never written to the device.
+ This allows a caller executing code in process to obtain its output without
+ a pipe and a thread to drain it.  Enabling or disabling output buffering
+ has no effect while output is being captured.
+
+ @return TRUE to indicate capture has begun, FALSE if output is already being
+         buffered or memory could not be allocated.
+ */
+__success(return)
+BOOLEAN
+YoriLibBeginOutputCapture(VOID)
+{
+    if (YoriLibOutputBuffer.Active) {
+        return FALSE;
+    }
+
+    YoriLibOutputBuffer.Buffer = YoriLibMalloc(YORI_LIB_OUTPUT_CAPTURE_INITIAL_SIZE);
+    if (YoriLibOutputBuffer.Buffer == NULL) {
+        return FALSE;
+    }
+
+    YoriLibOutputBuffer.Handle = GetStdHandle(STD_OUTPUT_HANDLE);
+    YoriLibOutputBuffer.ThreadId = GetCurrentThreadId();
+    YoriLibOutputBuffer.BytesInBuffer = 0;
+    YoriLibOutputBuffer.BytesAllocated = YORI_LIB_OUTPUT_CAPTURE_INITIAL_SIZE;
+    YoriLibOutputBuffer.IsConsole = FALSE;
+    YoriLibOutputBuffer.Capture = TRUE;
+    YoriLibOutputBuffer.Active = TRUE;
+    return TRUE;
+}
+
+/**
+ Stop capturing standard output and return the text that was captured.  This
+ should be called from the thread that began capturing.
+
+ @param Output On successful completion, populated with a newly allocated
+        string containing the captured text.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  Capture has
+         ended in either case.
+ */
+__success(return)
+BOOLEAN
+YoriLibEndOutputCapture(
+    __out PYORI_STRING Output
+    )
+{
+    YORI_ALLOC_SIZE_T LengthNeeded;
+    BOOLEAN Result;
+
+    ASSERT(YoriLibOutputBuffer.Active && YoriLibOutputBuffer.Capture);
+
+    Result = FALSE;
+    YoriLibInitEmptyString(Output);
+
+    LengthNeeded = YoriLibGetMultibyteInputSizeNeeded((LPCSTR)YoriLibOutputBuffer.Buffer, (YORI_ALLOC_SIZE_T)YoriLibOutputBuffer.BytesInBuffer);
+    if (YoriLibAllocateString(Output, LengthNeeded + 1)) {
+        YoriLibMultibyteInput((LPCSTR)YoriLibOutputBuffer.Buffer, (YORI_ALLOC_SIZE_T)YoriLibOutputBuffer.BytesInBuffer, Output->StartOfString, LengthNeeded);
+        Output->LengthInChars = LengthNeeded;
+        Output->StartOfString[LengthNeeded] = '\0';
+        Result = TRUE;
+    }
+
+    YoriLibOutputBuffer.Active = FALSE;
+    YoriLibOutputBuffer.Capture = FALSE;
+    YoriLibFree(YoriLibOutputBuffer.Buffer);
+    YoriLibOutputBuffer.Buffer = NULL;
+    return Result;
+}
+
 /**
  Set the default color for the process.  The default color is the one that
  will be used when a reset command is issued to the terminal.  For most
@@ -158,6 +470,22 @@ YoriLibOutputTextToMbyteDev(
 
         AnsiBytesNeeded = (YORI_ALLOC_SIZE_T)YoriLibGetMbyteOutputSizeNeeded(String->StartOfString, String->LengthInChars);
 
+        //
+        //  If the output is being buffered, encode directly into the
+        //  buffer.
+        //
+
+        if (YoriLibIsOutputBuffered(hOutput)) {
+            AnsiBuf = YoriLibOutputBufferReserve(AnsiBytesNeeded);
+            if (AnsiBuf != NULL) {
+                YoriLibMultibyteOutput(String->StartOfString,
+                                       String->LengthInChars,
+                                       AnsiBuf,
+                                       AnsiBytesNeeded);
+                return TRUE;
+            }
+        }
+
         if (AnsiBytesNeeded > (int)sizeof(AnsiStackBuf)) {
             AnsiBuf = YoriLibMalloc(AnsiBytesNeeded);
         } else {
@@ -180,6 +508,15 @@ YoriLibOutputTextToMbyteDev(
         }
     }
 #else
+    if (YoriLibIsOutputBuffered(hOutput)) {
+        PVOID Buffer;
+        Buffer = YoriLibOutputBufferReserve(String->LengthInChars * sizeof(TCHAR));
+        if (Buffer != NULL) {
+            memcpy(Buffer, String->StartOfString, String->LengthInChars * sizeof(TCHAR));
+            return TRUE;
+        }
+    }
+
     Result = WriteFile(hOutput,
                        String->StartOfString,
                        String->LengthInChars*sizeof(TCHAR),
@@ -333,8 +670,17 @@ YoriLibConsoleProcOutputText(
     )
 {
     DWORD BytesTransferred;
+    PVOID Buffer;
     UNREFERENCED_PARAMETER(Context);
 
+    if (YoriLibIsOutputBuffered(hOutput)) {
+        Buffer = YoriLibOutputBufferReserve(String->LengthInChars * sizeof(TCHAR));
+        if (Buffer != NULL) {
+            memcpy(Buffer, String->StartOfString, String->LengthInChars * sizeof(TCHAR));
+            return TRUE;
+        }
+    }
+
     WriteConsole(hOutput,
                  String->StartOfString,
                  String->LengthInChars,
@@ -383,6 +729,108 @@ YoriLibColorTable[] = {0,
                        FOREGROUND_BLUE|FOREGROUND_GREEN|FOREGROUND_RED};
 
 
+/**
+ A character that is not part of a VT sequence.
+ */
+#define YORI_LIB_VT_CLASS_TEXT      0
+
+/**
+ The escape character which introduces a VT sequence.
+ */
+#define YORI_LIB_VT_CLASS_ESCAPE    1
+
+/**
+ A decimal digit within the parameters of a VT sequence.
+ */
+#define YORI_LIB_VT_CLASS_DIGIT     2
+
+/**
+ The delimiter between parameters of a VT sequence.
+ */
+#define YORI_LIB_VT_CLASS_SEPARATOR 3
+
+/**
+ The class of each 7 bit character when parsing VT sequences.  Characters
+ above this range are always text.
+ */
+CONST UCHAR
+YoriLibVtCharClass[128] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 3, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+/**
+ Return the parsing class of a character.
+ */
+#define YoriLibVtClassOfChar(CH) \
+    (((CH) < 128)?YoriLibVtCharClass[(CH)]:YORI_LIB_VT_CLASS_TEXT)
+
+/**
+ The number of escape to color translations to remember.
+ */
+#define YORI_LIB_VT_COLOR_CACHE_ENTRIES 16
+
+/**
+ A previously calculated translation of an escape sequence into a color.
+ */
+typedef struct _YORI_LIB_VT_COLOR_CACHE_ENTRY {
+
+    /**
+     The color the escape was applied to.
+     */
+    WORD InitialColor;
+
+    /**
+     The color that was used for a reset when the translation was performed.
+     */
+    WORD ResetColor;
+
+    /**
+     The resulting color.
+     */
+    WORD FinalColor;
+
+    /**
+     The components of the initial color that were propagated into the
+     resulting color.
+     */
+    WORD InitialComponentsUsed;
+
+    /**
+     The number of characters in the escape sequence.  Zero indicates the
+     entry is not in use.
+     */
+    YORI_ALLOC_SIZE_T LengthInChars;
+
+    /**
+     The escape sequence.
+     */
+    TCHAR Escape[YORI_MAX_VT_ESCAPE_CHARS];
+
+} YORI_LIB_VT_COLOR_CACHE_ENTRY, *PYORI_LIB_VT_COLOR_CACHE_ENTRY;
+
+/**
+ Recently calculated translations of escape sequences into colors.  Output
+ tends to use a small number of distinct escapes repeatedly.
+ */
+YORI_LIB_VT_COLOR_CACHE_ENTRY YoriLibVtColorCache[YORI_LIB_VT_COLOR_CACHE_ENTRIES];
+
+/**
+ The index of the next entry in the color cache to replace.
+ */
+DWORD YoriLibVtColorCacheNext;
+
+/**
+ Nonzero if a thread is currently accessing the color cache.  A thread which
+ finds the cache in use calculates the color without it rather than waiting.
+ */
+LONG YoriLibVtColorCacheInUse;
+
 /**
  Specifies the value to indicate a new color derives its foreground from the
  existing color.
@@ -403,7 +851,8 @@ YoriLibColorTable[] = {0,
 
 /**
  Given a starting color and a VT sequence which may change it, generate the
- final color.  Both colors are in Win32 attribute form.
+ final color by parsing the sequence.  Both colors are in Win32 attribute
+ form.
 
  @param InitialColor The starting color, in Win32 form.
 
@@ -415,11 +864,9 @@ YoriLibColorTable[] = {0,
  @param InitialComponentsUsed On successful completion, updated to indicate
         which components of the initial color are propagated into the new
         color.
-
- @return TRUE to indicate successful completion, FALSE to indicate failure.
  */
-BOOL
-YoriLibVtFinalColorFromEscEx(
+VOID
+YoriLibVtParseFinalColorFromEsc(
     __in WORD InitialColor,
     __in PCYORI_STRING EscapeSequence,
     __out PWORD FinalColor,
@@ -427,11 +874,9 @@ YoriLibVtFinalColorFromEscEx(
     )
 {
     LPTSTR CurrentPoint = EscapeSequence->StartOfString;
-    YORI_ALLOC_SIZE_T CurrentOffset = 0;
     YORI_ALLOC_SIZE_T RemainingLength;
     WORD  ComponentsUsed = INITIAL_COMPONENT_FOREGROUND | INITIAL_COMPONENT_BACKGROUND | INITIAL_COMPONENT_UNDERLINE;
     WORD  NewColor;
-    YORI_STRING SearchString;
 
     RemainingLength = EscapeSequence->LengthInChars;
     NewColor = InitialColor;
@@ -465,9 +910,20 @@ YoriLibVtFinalColorFromEscEx(
             CurrentPoint++;
             RemainingLength--;
 
-            SearchString.StartOfString = CurrentPoint;
-            SearchString.LengthInChars = RemainingLength;
-            Code = YoriLibDecimalStringToInt(&SearchString);
+            //
+            //  Accumulate the decimal parameter.  An empty parameter is
+            //  zero.
+            //
+
+            Code = 0;
+            while (RemainingLength > 0 &&
+                   YoriLibVtClassOfChar(*CurrentPoint) == YORI_LIB_VT_CLASS_DIGIT) {
+
+                Code = Code * 10 + (*CurrentPoint - '0');
+                CurrentPoint++;
+                RemainingLength--;
+            }
+
             if (Code == 0) {
                 ComponentsUsed = 0;
                 NewColor = YoriLibVtResetColor;
@@ -505,15 +961,8 @@ YoriLibVtFinalColorFromEscEx(
             //  length checking.
             //
 
-            YoriLibInitEmptyString(&SearchString);
-            SearchString.StartOfString = CurrentPoint;
-            SearchString.LengthInChars = RemainingLength;
-            CurrentOffset = YoriLibCntStringWithChars(&SearchString, _T("0123456789"));
-            CurrentPoint += CurrentOffset;
-            RemainingLength = RemainingLength - CurrentOffset;
-
             if (RemainingLength == 0 ||
-                *CurrentPoint != ';') {
+                YoriLibVtClassOfChar(*CurrentPoint) != YORI_LIB_VT_CLASS_SEPARATOR) {
 
                 break;
             }
@@ -526,7 +975,72 @@ YoriLibVtFinalColorFromEscEx(
 
     *FinalColor = NewColor;
     *InitialComponentsUsed = ComponentsUsed;
+}
+
+/**
+ Given a starting color and a VT sequence which may change it, generate the
+ final color.  Both colors are in Win32 attribute form.  Recent results are
+ remembered so that repeated escapes do not need to be parsed again.
+
+ @param InitialColor The starting color, in Win32 form.
+
+ @param EscapeSequence The VT100 sequence to apply to the starting color.
+
+ @param FinalColor On successful completion, updated to contain the final
+        color.
+
+ @param InitialComponentsUsed On successful completion, updated to indicate
+        which components of the initial color are propagated into the new
+        color.
 
+ @return TRUE to indicate successful completion, FALSE to indicate failure.
+ */
+BOOL
+YoriLibVtFinalColorFromEscEx(
+    __in WORD InitialColor,
+    __in PCYORI_STRING EscapeSequence,
+    __out PWORD FinalColor,
+    __out PWORD InitialComponentsUsed
+    )
+{
+    PYORI_LIB_VT_COLOR_CACHE_ENTRY Entry;
+    DWORD Index;
+    WORD ResetColor;
+
+    if (EscapeSequence->LengthInChars > YORI_MAX_VT_ESCAPE_CHARS ||
+        InterlockedExchange(&YoriLibVtColorCacheInUse, 1) != 0) {
+
+        YoriLibVtParseFinalColorFromEsc(InitialColor, EscapeSequence, FinalColor, InitialComponentsUsed);
+        return TRUE;
+    }
+
+    ResetColor = YoriLibVtResetColor;
+    for (Index = 0; Index < YORI_LIB_VT_COLOR_CACHE_ENTRIES; Index++) {
+        Entry = &YoriLibVtColorCache[Index];
+        if (Entry->LengthInChars == EscapeSequence->LengthInChars &&
+            Entry->InitialColor == InitialColor &&
+            Entry->ResetColor == ResetColor &&
+            memcmp(Entry->Escape, EscapeSequence->StartOfString, EscapeSequence->LengthInChars * sizeof(TCHAR)) == 0) {
+
+            *FinalColor = Entry->FinalColor;
+            *InitialComponentsUsed = Entry->InitialComponentsUsed;
+            InterlockedExchange(&YoriLibVtColorCacheInUse, 0);
+            return TRUE;
+        }
+    }
+
+    YoriLibVtParseFinalColorFromEsc(InitialColor, EscapeSequence, FinalColor, InitialComponentsUsed);
+
+    Entry = &YoriLibVtColorCache[YoriLibVtColorCacheNext];
+    YoriLibVtColorCacheNext = (YoriLibVtColorCacheNext + 1) % YORI_LIB_VT_COLOR_CACHE_ENTRIES;
+    Entry->InitialColor = InitialColor;
+    Entry->ResetColor = ResetColor;
+    Entry->FinalColor = *FinalColor;
+    Entry->InitialComponentsUsed = *InitialComponentsUsed;
+    Entry->LengthInChars = EscapeSequence->LengthInChars;
+    memcpy(Entry->Escape, EscapeSequence->StartOfString, EscapeSequence->LengthInChars * sizeof(TCHAR));
+
+    InterlockedExchange(&YoriLibVtColorCacheInUse, 0);
     return TRUE;
 }
 
@@ -576,11 +1090,21 @@ YoriLibConsoleProcOutputEsc(
 {
     CONSOLE_SCREEN_BUFFER_INFO ConsoleInfo;
     WORD NewColor;
+    WORD ExistingColor;
     DWORD PreviousAttributes;
     BOOLEAN NeedExistingColor;
 
     PreviousAttributes = (DWORD)*Context;
 
+    //
+    //  Any buffered text needs to be written before the console attribute
+    //  changes so it is displayed in the color it was generated with.
+    //
+
+    if (YoriLibIsOutputBuffered(hOutput)) {
+        YoriLibFlushOutput();
+    }
+
     //
     //  Save the current color in the low 16 bits.  If a bit is set above
     //  the 16 bits, it indicates those bits are meaningful.  If not,
@@ -621,8 +1145,16 @@ YoriLibConsoleProcOutputEsc(
 
     }
 
-    if (YoriLibVtFinalColorFromEsc(NewColor, String, &NewColor)) {
-        SetConsoleTextAttribute(hOutput, NewColor);
+    //
+    //  The existing color is known at this point, so only update the
+    //  console if the escape changes it.
+    //
+
+    ExistingColor = NewColor;
+    if (YoriLibVtFinalColorFromEsc(ExistingColor, String, &NewColor)) {
+        if (NewColor != ExistingColor) {
+            SetConsoleTextAttribute(hOutput, NewColor);
+        }
         *Context = ((1 << 16) | NewColor);
     }
     return TRUE;
@@ -828,16 +1360,61 @@ YoriLibUtf8TextWithEscSetFn(
     return TRUE;
 }
 
+
 /**
- A list of break characters that indicate a range of text up to this char
- should be processed as text.
+ Return the number of characters at the start of a string which are not
+ the escape character.
+
+ @param String Pointer to the string to search.
+
+ @param StringLength The length of the string, in characters.
+
+ @return The offset of the first escape character, or StringLength if the
+         string contains no escape characters.
  */
-CONST TCHAR YoriLibVtEscape[] = {27, '\0'};
+YORI_ALLOC_SIZE_T
+YoriLibVtCountTextChars(
+    __in LPCTSTR String,
+    __in YORI_ALLOC_SIZE_T StringLength
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    //
+    //  Check four characters per iteration.  The escape character is rare,
+    //  so most iterations consist of four compares and one branch.
+    //
+
+    Index = 0;
+    while (Index + 4 <= StringLength) {
+        if ((String[Index] == 27) |
+            (String[Index + 1] == 27) |
+            (String[Index + 2] == 27) |
+            (String[Index + 3] == 27)) {
+
+            break;
+        }
+        Index = Index + 4;
+    }
+
+    while (Index < StringLength) {
+        if (String[Index] == 27) {
+            break;
+        }
+        Index++;
+    }
+
+    return Index;
+}
 
 /**
  Walk through an input string and process any VT100/ANSI escapes by invoking
  a device specific callback function to perform the requested action.
 
+ Text is accumulated into runs that extend until the next complete escape
+ sequence, so an escape character that does not introduce a sequence is
+ included in the surrounding text rather than being output separately.
+
  @param String Pointer to the string to process.
 
  @param StringLength The length of the string, in characters.
@@ -857,106 +1434,94 @@ YoriLibProcVtEscOnOpenStream(
     __in PYORI_LIB_VT_CALLBACK_FUNCTIONS Callbacks
     )
 {
-    LPTSTR CurrentPoint;
-    YORI_ALLOC_SIZE_T CurrentOffset;
-    YORI_ALLOC_SIZE_T PreviouslyConsumed;
-    YORI_STRING SearchString;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T RunStart;
+    YORI_ALLOC_SIZE_T EndOfEscape;
     YORI_STRING DisplayString;
 
-    CurrentPoint = String;
-    YoriLibInitEmptyString(&SearchString);
     YoriLibInitEmptyString(&DisplayString);
-    SearchString.StartOfString = CurrentPoint;
-    SearchString.LengthInChars = StringLength;
-    CurrentOffset = YoriLibCntStringNotWithChars(&SearchString, YoriLibVtEscape);
-    PreviouslyConsumed = 0;
+    RunStart = 0;
+    Index = 0;
 
     while (TRUE) {
 
-        //
-        //  If we have any text, perform required processing and output the text
-        //
-
-        if (CurrentOffset > 0) {
-            DisplayString.StartOfString = CurrentPoint;
-            DisplayString.LengthInChars = CurrentOffset;
-            if (!Callbacks->ProcessAndOutputText(hOutput, &DisplayString, &Callbacks->Context)) {
-                return FALSE;
-            }
-
-            CurrentPoint = CurrentPoint + CurrentOffset;
-            PreviouslyConsumed = PreviouslyConsumed + CurrentOffset;
-        }
-
-        if (PreviouslyConsumed >= StringLength) {
+        Index = Index + YoriLibVtCountTextChars(&String[Index], StringLength - Index);
+        if (Index >= StringLength) {
             break;
         }
 
         //
-        //  Locate VT100 escapes and process those
+        //  An escape which is not followed by '[' and at least one more
+        //  character is not a sequence, so it is part of the text run.
         //
 
-        if (*CurrentPoint == 27) {
+        if (Index + 2 >= StringLength ||
+            String[Index + 1] != '[') {
 
-            if (PreviouslyConsumed + 2 < StringLength &&
-                CurrentPoint[1] == '[') {
+            Index++;
+            continue;
+        }
 
-                YORI_ALLOC_SIZE_T EndOfEscape;
-                SearchString.StartOfString = &CurrentPoint[2];
-                SearchString.LengthInChars = StringLength - PreviouslyConsumed - 2;
-                EndOfEscape = YoriLibCntStringWithChars(&SearchString, _T("0123456789;"));
+        //
+        //  Skip over the parameters to find the character that terminates
+        //  the sequence.
+        //
 
-                //
-                //  If our buffer is full and we still have an incomplete escape,
-                //  there's no more processing we can perform.  This input is
-                //  bogus.
-                //
+        EndOfEscape = Index + 2;
+        while (EndOfEscape < StringLength) {
+            UCHAR Class;
+            Class = YoriLibVtClassOfChar(String[EndOfEscape]);
+            if (Class != YORI_LIB_VT_CLASS_DIGIT &&
+                Class != YORI_LIB_VT_CLASS_SEPARATOR) {
 
-                if (PreviouslyConsumed == 0 && EndOfEscape == StringLength - 2) {
-                    return FALSE;
-                }
+                break;
+            }
+            EndOfEscape++;
+        }
 
-                //
-                //  If we have an incomplete escape for this chunk, stop
-                //  processing here, loop back and read more data.
-                //
+        if (EndOfEscape >= StringLength) {
 
-                if (EndOfEscape == StringLength - PreviouslyConsumed - 2) {
-                    break;
-                }
+            //
+            //  If the entire buffer is an incomplete escape, there's no
+            //  more processing we can perform.  This input is bogus.
+            //
 
-                DisplayString.StartOfString = CurrentPoint;
-                DisplayString.LengthInChars = EndOfEscape + 3;
+            if (Index == 0) {
+                return FALSE;
+            }
 
-                if (!Callbacks->ProcessAndOutputEscape(hOutput, &DisplayString, &Callbacks->Context)) {
-                    return FALSE;
-                }
-                CurrentPoint = CurrentPoint + EndOfEscape + 3;
-                PreviouslyConsumed = PreviouslyConsumed + EndOfEscape + 3;
-            } else {
+            //
+            //  Otherwise the incomplete escape ends this chunk.  Output
+            //  the text preceding it and stop.
+            //
 
-                //
-                //  Output just the escape character and move to the next
-                //  match
-                //
+            break;
+        }
 
-                DisplayString.StartOfString = CurrentPoint;
-                DisplayString.LengthInChars = 1;
-                if (!Callbacks->ProcessAndOutputText(hOutput, &DisplayString, &Callbacks->Context)) {
-                    return FALSE;
-                }
-                CurrentPoint++;
-                PreviouslyConsumed++;
+        if (Index > RunStart) {
+            DisplayString.StartOfString = &String[RunStart];
+            DisplayString.LengthInChars = Index - RunStart;
+            if (!Callbacks->ProcessAndOutputText(hOutput, &DisplayString, &Callbacks->Context)) {
+                return FALSE;
             }
         }
 
-        if (PreviouslyConsumed >= StringLength) {
-            break;
+        DisplayString.StartOfString = &String[Index];
+        DisplayString.LengthInChars = EndOfEscape - Index + 1;
+        if (!Callbacks->ProcessAndOutputEscape(hOutput, &DisplayString, &Callbacks->Context)) {
+            return FALSE;
         }
 
-        SearchString.StartOfString = CurrentPoint;
-        SearchString.LengthInChars = StringLength - PreviouslyConsumed;
-        CurrentOffset = YoriLibCntStringNotWithChars(&SearchString, YoriLibVtEscape);
+        Index = EndOfEscape + 1;
+        RunStart = Index;
+    }
+
+    if (Index > RunStart) {
+        DisplayString.StartOfString = &String[RunStart];
+        DisplayString.LengthInChars = Index - RunStart;
+        if (!Callbacks->ProcessAndOutputText(hOutput, &DisplayString, &Callbacks->Context)) {
+            return FALSE;
+        }
     }
 
     return TRUE;
@@ -997,6 +1562,60 @@ YoriLibProcVtEscOnNewStream(
     return Result;
 }
 
+/**
+ Select the set of callback functions to use when writing to a device,
+ depending on whether the device is a console supporting color or a file
+ that doesn't.  If output to a different device is being buffered, the
+ buffer is written first so that output to the two devices is not
+ reordered.
+
+ @param hOut The device to write output to.
+
+ @param Flags Flags, indicating behavior.
+
+ @param Callbacks On completion, populated with the callback functions to
+        use for the device.
+ */
+VOID
+YoriLibOutputSelectFn(
+    __in HANDLE hOut,
+    __in WORD Flags,
+    __out PYORI_LIB_VT_CALLBACK_FUNCTIONS Callbacks
+    )
+{
+    DWORD CurrentMode;
+    BOOLEAN IsConsole;
+
+    if (hOut == YORI_LIB_DEBUGGER_HANDLE) {
+        YoriLibDbgSetFn(Callbacks);
+        return;
+    }
+
+    if (YoriLibIsOutputBuffered(hOut)) {
+        IsConsole = YoriLibOutputBuffer.IsConsole;
+    } else {
+        YoriLibFlushOutput();
+        IsConsole = FALSE;
+        if (GetConsoleMode(hOut, &CurrentMode)) {
+            IsConsole = TRUE;
+        }
+    }
+
+    if (IsConsole) {
+        if ((Flags & YORI_LIB_OUTPUT_STRIP_VT) != 0) {
+            YoriLibConsoleNoEscSetFn(Callbacks);
+        } else if ((Flags & YORI_LIB_OUTPUT_PASSTHROUGH_VT) != 0) {
+            YoriLibConsoleIncludeEscSetFn(Callbacks);
+        } else {
+            YoriLibConsoleSetFn(Callbacks);
+        }
+    } else if ((Flags & YORI_LIB_OUTPUT_STRIP_VT) != 0) {
+        YoriLibUtf8TextNoEscSetFn(Callbacks);
+    } else {
+        YoriLibUtf8TextWithEscSetFn(Callbacks);
+    }
+}
+
 /**
  Output a printf-style formatted string to the specified output stream.
 
@@ -1027,33 +1646,13 @@ YoriLibOutputInternal(
     TCHAR stack_buf[64];
     TCHAR * buf;
     YORI_LIB_VT_CALLBACK_FUNCTIONS Callbacks;
-    DWORD CurrentMode;
     BOOL Result;
 
 #ifdef __WATCOMC__
     savedmarker[0] = marker[0];
 #endif
 
-    //
-    //  Check if we're writing to a console supporting color or a file
-    //  that doesn't
-    //
-
-    if (hOut == YORI_LIB_DEBUGGER_HANDLE) {
-        YoriLibDbgSetFn(&Callbacks);
-    } else if (GetConsoleMode(hOut, &CurrentMode)) {
-        if ((Flags & YORI_LIB_OUTPUT_STRIP_VT) != 0) {
-            YoriLibConsoleNoEscSetFn(&Callbacks);
-        } else if ((Flags & YORI_LIB_OUTPUT_PASSTHROUGH_VT) != 0) {
-            YoriLibConsoleIncludeEscSetFn(&Callbacks);
-        } else {
-            YoriLibConsoleSetFn(&Callbacks);
-        }
-    } else if ((Flags & YORI_LIB_OUTPUT_STRIP_VT) != 0) {
-        YoriLibUtf8TextNoEscSetFn(&Callbacks);
-    } else {
-        YoriLibUtf8TextWithEscSetFn(&Callbacks);
-    }
+    YoriLibOutputSelectFn(hOut, Flags, &Callbacks);
 
     len = YoriLibVSPrintfSize(szFmt, marker);
 
@@ -1136,27 +1735,9 @@ YoriLibOutputString(
     )
 {
     YORI_LIB_VT_CALLBACK_FUNCTIONS Callbacks;
-    DWORD CurrentMode;
     BOOL Result;
 
-    //
-    //  Check if we're writing to a console supporting color or a file
-    //  that doesn't
-    //
-
-    if (GetConsoleMode(hOut, &CurrentMode)) {
-        if ((Flags & YORI_LIB_OUTPUT_STRIP_VT) != 0) {
-            YoriLibConsoleNoEscSetFn(&Callbacks);
-        } else if ((Flags & YORI_LIB_OUTPUT_PASSTHROUGH_VT) != 0) {
-            YoriLibConsoleIncludeEscSetFn(&Callbacks);
-        } else {
-            YoriLibConsoleSetFn(&Callbacks);
-        }
-    } else if ((Flags & YORI_LIB_OUTPUT_STRIP_VT) != 0) {
-        YoriLibUtf8TextNoEscSetFn(&Callbacks);
-    } else {
-        YoriLibUtf8TextWithEscSetFn(&Callbacks);
-    }
+    YoriLibOutputSelectFn(hOut, Flags, &Callbacks);
 
     Result = YoriLibProcVtEscOnNewStream(String->StartOfString, String->LengthInChars, hOut, &Callbacks);
 
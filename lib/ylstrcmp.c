@@ -3,7 +3,7 @@
  *
  * Yori string comparison routines
  *
- * Copyright (c) 2017-2018 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -26,7 +26,6 @@
 
 #include "yoripch.h"
 #include "yorilib.h"
-#include "remimu.hxx"
 
 /**
  Compare a Yori string against a NULL terminated string up to a specified
@@ -118,10 +117,7 @@ YoriLibUpcaseChar(
     __in TCHAR c
     )
 {
-    if (c >= 'a' && c <= 'z') {
-        return (TCHAR)(c - 'a' + 'A');
-    }
-    return c;
+    return YoriLibUpcaseCharInline(c);
 }
 
 /**
@@ -147,34 +143,37 @@ YoriLibCompareStringLitInsCnt(
     __in YORI_ALLOC_SIZE_T count
     )
 {
-    YORI_ALLOC_SIZE_T Index = 0;
+    YORI_ALLOC_SIZE_T Index;
+    TCHAR Char1;
+    TCHAR Char2;
 
-    if (count == 0) {
-        return 0;
-    }
-
-    while(TRUE) {
+    for (Index = 0; Index < count; Index++) {
 
+        Char2 = str2[Index];
         if (Index == Str1->LengthInChars) {
-            if (str2[Index] == '\0') {
+            if (Char2 == '\0') {
                 return 0;
             } else {
                 return -1;
             }
-        } else if (str2[Index] == '\0') {
+        } else if (Char2 == '\0') {
             return 1;
         }
 
-        if (YoriLibUpcaseChar(Str1->StartOfString[Index]) < YoriLibUpcaseChar(str2[Index])) {
-            return -1;
-        } else if (YoriLibUpcaseChar(Str1->StartOfString[Index]) > YoriLibUpcaseChar(str2[Index])) {
-            return 1;
-        }
-
-        Index++;
+        //
+        //  Most characters are identical without folding, so only fold
+        //  characters that differ.
+        //
 
-        if (Index == count) {
-            return 0;
+        Char1 = Str1->StartOfString[Index];
+        if (Char1 != Char2) {
+            Char1 = YoriLibUpcaseCharInline(Char1);
+            Char2 = YoriLibUpcaseCharInline(Char2);
+            if (Char1 < Char2) {
+                return -1;
+            } else if (Char1 > Char2) {
+                return 1;
+            }
         }
     }
     return 0;
@@ -302,37 +301,55 @@ YoriLibCompareStringInsCnt(
     __in YORI_ALLOC_SIZE_T count
     )
 {
-    YORI_ALLOC_SIZE_T Index = 0;
-
-    if (count == 0) {
-        return 0;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Length;
+    LPTSTR String1;
+    LPTSTR String2;
+    TCHAR Char1;
+    TCHAR Char2;
+
+    //
+    //  Compare up to the shorter of the two strings or the count, then
+    //  check lengths.  Most characters are identical without folding, so
+    //  only fold characters that differ.
+    //
+
+    Length = Str1->LengthInChars;
+    if (Str2->LengthInChars < Length) {
+        Length = Str2->LengthInChars;
+    }
+    if (count < Length) {
+        Length = count;
     }
 
-    while(TRUE) {
+    String1 = Str1->StartOfString;
+    String2 = Str2->StartOfString;
 
-        if (Index == Str1->LengthInChars) {
-            if (Index == Str2->LengthInChars) {
-                return 0;
-            } else {
+    for (Index = 0; Index < Length; Index++) {
+        Char1 = String1[Index];
+        Char2 = String2[Index];
+        if (Char1 != Char2) {
+            Char1 = YoriLibUpcaseCharInline(Char1);
+            Char2 = YoriLibUpcaseCharInline(Char2);
+            if (Char1 < Char2) {
                 return -1;
+            } else if (Char1 > Char2) {
+                return 1;
             }
-        } else if (Index == Str2->LengthInChars) {
-            return 1;
         }
+    }
 
-        if (YoriLibUpcaseChar(Str1->StartOfString[Index]) < YoriLibUpcaseChar(Str2->StartOfString[Index])) {
-            return -1;
-        } else if (YoriLibUpcaseChar(Str1->StartOfString[Index]) > YoriLibUpcaseChar(Str2->StartOfString[Index])) {
-            return 1;
-        }
+    if (Index == count ||
+        Str1->LengthInChars == Str2->LengthInChars) {
 
-        Index++;
+        return 0;
+    }
 
-        if (Index == count) {
-            return 0;
-        }
+    if (Index == Str1->LengthInChars) {
+        return -1;
     }
-    return 0;
+
+    return 1;
 }
 
 /**
@@ -357,6 +374,88 @@ YoriLibCompareStringIns(
     return YoriLibCompareStringInsCnt(Str1, Str2, (YORI_ALLOC_SIZE_T)-1);
 }
 
+/**
+ The number of compiled regular expressions to retain between calls to
+ YoriLibRegexMatch.
+ */
+#define YORI_LIB_REGEX_MATCH_CACHE_ENTRIES (4)
+
+/**
+ A regular expression compiled by YoriLibRegexMatch along with the text it
+ was compiled from.
+ */
+typedef struct _YORI_LIB_REGEX_MATCH_CACHE_ENTRY {
+
+    /**
+     The compiled expression.
+     */
+    YORI_LIB_REGEX Regex;
+
+    /**
+     The encoding that the expression was converted into before it was
+     compiled.
+     */
+    DWORD Encoding;
+
+    /**
+     The number of bytes in Pattern, not including the NULL terminator.
+     */
+    DWORD PatternLength;
+
+    /**
+     The text of the expression in Encoding.  NULL indicates the entry is not
+     in use.
+     */
+    LPSTR Pattern;
+
+} YORI_LIB_REGEX_MATCH_CACHE_ENTRY, *PYORI_LIB_REGEX_MATCH_CACHE_ENTRY;
+
+/**
+ Recently compiled regular expressions.  Scripts tend to match many strings
+ against the same expression, typically within a loop.
+ */
+YORI_LIB_REGEX_MATCH_CACHE_ENTRY YoriLibRegexMatchCache[YORI_LIB_REGEX_MATCH_CACHE_ENTRIES];
+
+/**
+ The index of the next entry in the regular expression cache to replace.
+ */
+DWORD YoriLibRegexMatchCacheNext;
+
+/**
+ Nonzero if a thread is currently accessing the regular expression cache.
+ Since a compiled expression can only be searched by one thread at a time,
+ this remains set while the search is performed.  A thread which finds the
+ cache in use compiles the expression without it rather than waiting.
+ */
+LONG YoriLibRegexMatchCacheInUse;
+
+/**
+ Free any regular expressions retained by YoriLibRegexMatch.
+ */
+VOID
+YoriLibRegexMatchCleanupCache(VOID)
+{
+    PYORI_LIB_REGEX_MATCH_CACHE_ENTRY Entry;
+    DWORD Index;
+
+    if (InterlockedExchange(&YoriLibRegexMatchCacheInUse, 1) != 0) {
+        return;
+    }
+
+    for (Index = 0; Index < YORI_LIB_REGEX_MATCH_CACHE_ENTRIES; Index++) {
+        Entry = &YoriLibRegexMatchCache[Index];
+        if (Entry->Pattern != NULL) {
+            YoriLibRegexFree(&Entry->Regex);
+            YoriLibFree(Entry->Pattern);
+            Entry->Pattern = NULL;
+            Entry->PatternLength = 0;
+        }
+    }
+
+    YoriLibRegexMatchCacheNext = 0;
+    InterlockedExchange(&YoriLibRegexMatchCacheInUse, 0);
+}
+
 /**
  Match a Yori string against a regular expression.
 
@@ -374,11 +473,14 @@ YoriLibRegexMatch(
 {
     const DWORD EncodingToUse = YoriLibGetUsableEncoding();
 
-    RegexToken tokens[1024];
-    int16_t token_count = 1024;
-    ptrdiff_t ec;
+    PYORI_LIB_REGEX_MATCH_CACHE_ENTRY Entry;
+    YORI_LIB_REGEX Regex;
+    PYORI_LIB_REGEX SearchRegex;
+    YORI_ALLOC_SIZE_T MatchOffset;
+    DWORD Index;
+    BOOLEAN CacheHeld;
+    LONG_PTR ec;
 
-    int offset = 0;
     int cbtext = WideCharToMultiByte(EncodingToUse, 0, Text->StartOfString, Text->LengthInChars, NULL, 0, NULL, NULL);
     char *text = _alloca(cbtext + 1);
     int cbpattern = WideCharToMultiByte(EncodingToUse, 0, Pattern->StartOfString, Pattern->LengthInChars, NULL, 0, NULL, NULL);
@@ -388,21 +490,76 @@ YoriLibRegexMatch(
     WideCharToMultiByte(EncodingToUse, 0, Pattern->StartOfString, Pattern->LengthInChars, pattern, cbpattern, NULL, NULL);
     pattern[cbpattern] = '\0';
 
-    ec = regex_parse(pattern, tokens, &token_count, 0);
-    if (ec < 0) {
-        return (int)ec - 'p';
+    //
+    //  Look for a previously compiled copy of the expression.  If another
+    //  thread is using the cache, compile a private copy instead.
+    //
+
+    SearchRegex = NULL;
+    CacheHeld = FALSE;
+    if (InterlockedExchange(&YoriLibRegexMatchCacheInUse, 1) == 0) {
+        CacheHeld = TRUE;
+        for (Index = 0; Index < YORI_LIB_REGEX_MATCH_CACHE_ENTRIES; Index++) {
+            Entry = &YoriLibRegexMatchCache[Index];
+            if (Entry->Pattern != NULL &&
+                Entry->Encoding == EncodingToUse &&
+                Entry->PatternLength == (DWORD)cbpattern &&
+                memcmp(Entry->Pattern, pattern, (DWORD)cbpattern) == 0) {
+
+                SearchRegex = &Entry->Regex;
+                break;
+            }
+        }
     }
 
-    for (ec = -1; ec < 0 && offset <= cbtext; ++offset) {
-        if ((text[offset] & '\xC0') == '\x80') {
-            continue;
+    if (SearchRegex == NULL) {
+        ec = YoriLibRegexCompile(pattern, &Regex);
+        if (ec < 0) {
+            if (CacheHeld) {
+                InterlockedExchange(&YoriLibRegexMatchCacheInUse, 0);
+            }
+            return (int)ec - 'p';
         }
-        ec = regex_match(tokens, text, offset, 0, 0, 0);
-        if (ec < -1) { // -1 means no match which is not an error
-            return (int)ec - 'm';
+        SearchRegex = &Regex;
+
+        //
+        //  If the cache is held, replace its oldest entry with the newly
+        //  compiled expression.  If the pattern cannot be saved, the
+        //  expression is used once and freed as if the cache were busy.
+        //
+
+        if (CacheHeld) {
+            Entry = &YoriLibRegexMatchCache[YoriLibRegexMatchCacheNext];
+            if (Entry->Pattern != NULL) {
+                YoriLibRegexFree(&Entry->Regex);
+                YoriLibFree(Entry->Pattern);
+                Entry->Pattern = NULL;
+                Entry->PatternLength = 0;
+            }
+
+            Entry->Pattern = YoriLibMalloc((YORI_ALLOC_SIZE_T)cbpattern + 1);
+            if (Entry->Pattern != NULL) {
+                memcpy(Entry->Pattern, pattern, (DWORD)cbpattern + 1);
+                Entry->PatternLength = (DWORD)cbpattern;
+                Entry->Encoding = EncodingToUse;
+                memcpy(&Entry->Regex, &Regex, sizeof(YORI_LIB_REGEX));
+                YoriLibRegexMatchCacheNext = (YoriLibRegexMatchCacheNext + 1) % YORI_LIB_REGEX_MATCH_CACHE_ENTRIES;
+                SearchRegex = &Entry->Regex;
+            }
         }
     }
 
+    ec = YoriLibRegexSearch(SearchRegex, text, cbtext, 0, 0, NULL, NULL, &MatchOffset);
+    if (SearchRegex == &Regex) {
+        YoriLibRegexFree(&Regex);
+    }
+    if (CacheHeld) {
+        InterlockedExchange(&YoriLibRegexMatchCacheInUse, 0);
+    }
+    if (ec < -1) { // -1 means no match which is not an error
+        return (int)ec - 'm';
+    }
+
     return ec >= 0;
 }
 
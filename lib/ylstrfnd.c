@@ -27,6 +27,503 @@
 #include "yoripch.h"
 #include "yorilib.h"
 
+/**
+ The minimum length of a string to search for a single substring before it
+ is worthwhile to preprocess the substring.
+ */
+#define YORI_LIB_SUBSTRING_SEARCH_THRESHOLD (128)
+
+/**
+ Preprocess a substring so that it can be efficiently located in one or more
+ strings.  This builds a table describing how far a search can advance
+ based on the character found at the end of a candidate match, so most
+ characters in the string being searched are never examined.
+
+ @param Search On completion, populated with the preprocessed substring.
+
+ @param Needle The substring to search for.  The search refers to this
+        buffer rather than copying it, so it must remain valid while the
+        search is in use.
+
+ @param Insensitive If TRUE, the search is performed without regard to case.
+ */
+VOID
+YoriLibPrepareSubstringSearch(
+    __out PYORI_LIB_SUBSTRING_SEARCH Search,
+    __in PCYORI_STRING Needle,
+    __in BOOLEAN Insensitive
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    TCHAR Char;
+
+    YoriLibInitEmptyString(&Search->Needle);
+    Search->Needle.StartOfString = Needle->StartOfString;
+    Search->Needle.LengthInChars = Needle->LengthInChars;
+    Search->Insensitive = Insensitive;
+    Search->LastChar = 0;
+
+    for (Index = 0; Index < sizeof(Search->Shift)/sizeof(Search->Shift[0]); Index++) {
+        Search->Shift[Index] = Needle->LengthInChars;
+    }
+
+    if (Needle->LengthInChars == 0) {
+        return;
+    }
+
+    //
+    //  Characters which share the same low 8 bits share an entry, and the
+    //  entry describes the rightmost of them, which is always a safe
+    //  distance to advance.
+    //
+
+    for (Index = 0; Index < Needle->LengthInChars - 1; Index++) {
+        Char = Needle->StartOfString[Index];
+        if (Insensitive) {
+            Char = YoriLibUpcaseChar(Char);
+        }
+        Search->Shift[Char & 0xFF] = Needle->LengthInChars - 1 - Index;
+    }
+
+    Char = Needle->StartOfString[Needle->LengthInChars - 1];
+    if (Insensitive) {
+        Char = YoriLibUpcaseChar(Char);
+    }
+    Search->LastChar = Char;
+}
+
+/**
+ Search through a string for a substring which has been preprocessed with
+ @ref YoriLibPrepareSubstringSearch .  This returns the same result as
+ @ref YoriLibFindFirstMatchSubstr or @ref YoriLibFindFirstMatchSubstrIns
+ with a single substring.
+
+ @param Search Pointer to the preprocessed substring.
+
+ @param String The string to search through.
+
+ @param StringOffsetOfMatch On successful completion, returns the offset
+        within the string of the match.
+
+ @return TRUE if a match was found, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+YoriLibSubstringSearch(
+    __in PYORI_LIB_SUBSTRING_SEARCH Search,
+    __in PCYORI_STRING String,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    )
+{
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T LastOffset;
+    YORI_ALLOC_SIZE_T LastIndex;
+    YORI_ALLOC_SIZE_T Index;
+    LPTSTR Needle;
+    LPTSTR Candidate;
+    TCHAR Char;
+
+    if (StringOffsetOfMatch != NULL) {
+        *StringOffsetOfMatch = 0;
+    }
+
+    //
+    //  An empty substring matches the start of any nonempty string, which
+    //  is consistent with YoriLibFindFirstMatchSubstr.
+    //
+
+    if (Search->Needle.LengthInChars == 0) {
+        if (String->LengthInChars > 0) {
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    if (String->LengthInChars < Search->Needle.LengthInChars) {
+        return FALSE;
+    }
+
+    Needle = Search->Needle.StartOfString;
+    LastIndex = Search->Needle.LengthInChars - 1;
+    LastOffset = String->LengthInChars - Search->Needle.LengthInChars;
+    Offset = 0;
+
+    while (Offset <= LastOffset) {
+        Candidate = &String->StartOfString[Offset];
+        Char = Candidate[LastIndex];
+        if (Search->Insensitive) {
+            Char = YoriLibUpcaseChar(Char);
+        }
+
+        if (Char == Search->LastChar) {
+            if (Search->Insensitive) {
+                for (Index = 0; Index < LastIndex; Index++) {
+                    if (YoriLibUpcaseChar(Candidate[Index]) != YoriLibUpcaseChar(Needle[Index])) {
+                        break;
+                    }
+                }
+            } else {
+                for (Index = 0; Index < LastIndex; Index++) {
+                    if (Candidate[Index] != Needle[Index]) {
+                        break;
+                    }
+                }
+            }
+
+            if (Index == LastIndex) {
+                if (StringOffsetOfMatch != NULL) {
+                    *StringOffsetOfMatch = Offset;
+                }
+                return TRUE;
+            }
+        }
+
+        Offset = Offset + Search->Shift[Char & 0xFF];
+    }
+
+    return FALSE;
+}
+
+/**
+ Find the state which follows a specified state when a character is found.
+
+ @param Search Pointer to the preprocessed set of substrings.
+
+ @param State The index of the current state.
+
+ @param Char The character found, upcased if the search is case
+        insensitive.
+
+ @return The index of the following state, or zero if no state follows the
+         current state for this character.
+ */
+DWORD
+YoriLibMultiSubstringFindChild(
+    __in PYORI_LIB_MULTI_SUBSTRING_SEARCH Search,
+    __in DWORD State,
+    __in TCHAR Char
+    )
+{
+    DWORD Child;
+
+    if (State == 0 && Char < 0x100) {
+        return Search->RootChild[Char];
+    }
+
+    for (Child = Search->Nodes[State].FirstChild; Child != 0; Child = Search->Nodes[Child].NextSibling) {
+        if (Search->Nodes[Child].Char == Char) {
+            return Child;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ Find the state to move to from a specified state when a character is found,
+ following failure links until a state is found which the character
+ follows, or the initial state is reached.
+
+ @param Search Pointer to the preprocessed set of substrings.
+
+ @param State The index of the current state.
+
+ @param Char The character found, upcased if the search is case
+        insensitive.
+
+ @return The index of the next state.
+ */
+DWORD
+YoriLibMultiSubstringNextState(
+    __in PYORI_LIB_MULTI_SUBSTRING_SEARCH Search,
+    __in DWORD State,
+    __in TCHAR Char
+    )
+{
+    DWORD Child;
+
+    while (TRUE) {
+        Child = YoriLibMultiSubstringFindChild(Search, State, Char);
+        if (Child != 0) {
+            return Child;
+        }
+        if (State == 0) {
+            return 0;
+        }
+        State = Search->Nodes[State].Failure;
+    }
+}
+
+/**
+ Preprocess a set of substrings so that the first match of any of them can
+ be located in a string by examining each character of the string once,
+ regardless of the number of substrings.  This is worthwhile when searching
+ for several substrings in many strings.
+
+ @param Search On successful completion, populated with the preprocessed
+        substrings.  This should be freed with
+        @ref YoriLibFreeMultiSubstringSearch .
+
+ @param NumberMatches The number of substrings to look for.
+
+ @param MatchArray An array of strings corresponding to the matches to
+        look for.  The search refers to this array rather than copying it,
+        so it must remain valid while the search is in use.
+
+ @param Insensitive If TRUE, the search is performed without regard to case.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibPrepareMultiSubstringSearch(
+    __out PYORI_LIB_MULTI_SUBSTRING_SEARCH Search,
+    __in YORI_ALLOC_SIZE_T NumberMatches,
+    __in PYORI_STRING MatchArray,
+    __in BOOLEAN Insensitive
+    )
+{
+    PYORI_LIB_MULTI_SUBSTRING_NODE Nodes;
+    PDWORD Queue;
+    DWORD QueueStart;
+    DWORD QueueEnd;
+    DWORD MaxNodes;
+    DWORD State;
+    DWORD Child;
+    DWORD Failure;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T CharIndex;
+    TCHAR Char;
+
+    ZeroMemory(Search, sizeof(YORI_LIB_MULTI_SUBSTRING_SEARCH));
+    Search->MatchArray = MatchArray;
+    Search->NumberMatches = NumberMatches;
+    Search->Insensitive = Insensitive;
+
+    MaxNodes = 1;
+    for (Index = 0; Index < NumberMatches; Index++) {
+        MaxNodes = MaxNodes + MatchArray[Index].LengthInChars;
+    }
+
+    Nodes = YoriLibMalloc(MaxNodes * sizeof(YORI_LIB_MULTI_SUBSTRING_NODE));
+    if (Nodes == NULL) {
+        return FALSE;
+    }
+
+    Queue = YoriLibMalloc(MaxNodes * sizeof(DWORD));
+    if (Queue == NULL) {
+        YoriLibFree(Nodes);
+        return FALSE;
+    }
+
+    ZeroMemory(Nodes, MaxNodes * sizeof(YORI_LIB_MULTI_SUBSTRING_NODE));
+    Search->Nodes = Nodes;
+    Search->NodeCount = 1;
+
+    //
+    //  Build a tree of the substrings, where each state describes a prefix
+    //  of one or more substrings.
+    //
+
+    for (Index = 0; Index < NumberMatches; Index++) {
+        if (MatchArray[Index].LengthInChars == 0) {
+            if (Search->EmptyMatch == 0) {
+                Search->EmptyMatch = Index + 1;
+            }
+            continue;
+        }
+
+        State = 0;
+        for (CharIndex = 0; CharIndex < MatchArray[Index].LengthInChars; CharIndex++) {
+            Char = MatchArray[Index].StartOfString[CharIndex];
+            if (Insensitive) {
+                Char = YoriLibUpcaseChar(Char);
+            }
+            Child = YoriLibMultiSubstringFindChild(Search, State, Char);
+            if (Child == 0) {
+                Child = Search->NodeCount;
+                Search->NodeCount++;
+                Nodes[Child].Char = Char;
+                Nodes[Child].NextSibling = Nodes[State].FirstChild;
+                Nodes[State].FirstChild = Child;
+                if (State == 0 && Char < 0x100) {
+                    Search->RootChild[Char] = Child;
+                }
+            }
+            State = Child;
+        }
+
+        if (Nodes[State].MatchIndex == 0) {
+            Nodes[State].MatchIndex = Index + 1;
+        }
+
+        if (MatchArray[Index].LengthInChars > Search->LongestMatch) {
+            Search->LongestMatch = MatchArray[Index].LengthInChars;
+        }
+    }
+
+    //
+    //  Calculate failure links in order of depth, so the failure link of a
+    //  parent is always known before its children are processed.  States
+    //  following the initial state fail back to the initial state.
+    //
+
+    QueueStart = 0;
+    QueueEnd = 0;
+    for (Child = Nodes[0].FirstChild; Child != 0; Child = Nodes[Child].NextSibling) {
+        Queue[QueueEnd] = Child;
+        QueueEnd++;
+    }
+
+    while (QueueStart < QueueEnd) {
+        State = Queue[QueueStart];
+        QueueStart++;
+
+        for (Child = Nodes[State].FirstChild; Child != 0; Child = Nodes[Child].NextSibling) {
+            Failure = YoriLibMultiSubstringNextState(Search, Nodes[State].Failure, Nodes[Child].Char);
+            Nodes[Child].Failure = Failure;
+            if (Nodes[Failure].MatchIndex != 0) {
+                Nodes[Child].NextMatch = Failure;
+            } else {
+                Nodes[Child].NextMatch = Nodes[Failure].NextMatch;
+            }
+            Queue[QueueEnd] = Child;
+            QueueEnd++;
+        }
+    }
+
+    YoriLibFree(Queue);
+    return TRUE;
+}
+
+/**
+ Free a set of substrings preprocessed with
+ @ref YoriLibPrepareMultiSubstringSearch .
+
+ @param Search Pointer to the preprocessed substrings.
+ */
+VOID
+YoriLibFreeMultiSubstringSearch(
+    __inout PYORI_LIB_MULTI_SUBSTRING_SEARCH Search
+    )
+{
+    if (Search->Nodes != NULL) {
+        YoriLibFree(Search->Nodes);
+        Search->Nodes = NULL;
+    }
+    Search->NodeCount = 0;
+}
+
+/**
+ Search through a string for a set of substrings which have been
+ preprocessed with @ref YoriLibPrepareMultiSubstringSearch .  This returns
+ the same result as @ref YoriLibFindFirstMatchSubstr or
+ @ref YoriLibFindFirstMatchSubstrIns : the match closest to the start of the
+ string, and if several substrings match at that offset, the first of them
+ in the array.
+
+ @param Search Pointer to the preprocessed substrings.
+
+ @param String The string to search through.
+
+ @param StringOffsetOfMatch On successful completion, returns the offset
+        within the string of the match.
+
+ @return If a match is found, returns a pointer to the entry in MatchArray
+         corresponding to the substring that was matched.  If no match is
+         found, returns NULL.
+ */
+PYORI_STRING
+YoriLibMultiSubstringSearch(
+    __in PYORI_LIB_MULTI_SUBSTRING_SEARCH Search,
+    __in PCYORI_STRING String,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    )
+{
+    PYORI_LIB_MULTI_SUBSTRING_NODE Nodes;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T MatchIndex;
+    YORI_ALLOC_SIZE_T MatchStart;
+    YORI_ALLOC_SIZE_T BestIndex;
+    YORI_ALLOC_SIZE_T BestStart;
+    BOOLEAN Found;
+    DWORD State;
+    DWORD Candidate;
+    TCHAR Char;
+
+    if (StringOffsetOfMatch != NULL) {
+        *StringOffsetOfMatch = 0;
+    }
+
+    if (String->LengthInChars == 0) {
+        return NULL;
+    }
+
+    //
+    //  An empty substring matches the start of any nonempty string, which
+    //  is consistent with YoriLibFindFirstMatchSubstr.  Another substring
+    //  earlier in the array can still match at the same offset.
+    //
+
+    Found = FALSE;
+    BestIndex = 0;
+    BestStart = 0;
+    if (Search->EmptyMatch != 0) {
+        Found = TRUE;
+        BestIndex = Search->EmptyMatch - 1;
+    }
+
+    Nodes = Search->Nodes;
+    State = 0;
+    for (Index = 0; Index < String->LengthInChars; Index++) {
+
+        //
+        //  Once a match has been found, a match ending beyond this point
+        //  would have to start after it.
+        //
+
+        if (Found && Index >= BestStart + Search->LongestMatch) {
+            break;
+        }
+
+        Char = String->StartOfString[Index];
+        if (Search->Insensitive) {
+            Char = YoriLibUpcaseChar(Char);
+        }
+
+        State = YoriLibMultiSubstringNextState(Search, State, Char);
+
+        if (Nodes[State].MatchIndex != 0) {
+            Candidate = State;
+        } else {
+            Candidate = Nodes[State].NextMatch;
+        }
+
+        while (Candidate != 0) {
+            MatchIndex = Nodes[Candidate].MatchIndex - 1;
+            MatchStart = Index + 1 - Search->MatchArray[MatchIndex].LengthInChars;
+            if (!Found ||
+                MatchStart < BestStart ||
+                (MatchStart == BestStart && MatchIndex < BestIndex)) {
+
+                Found = TRUE;
+                BestStart = MatchStart;
+                BestIndex = MatchIndex;
+            }
+            Candidate = Nodes[Candidate].NextMatch;
+        }
+    }
+
+    if (!Found) {
+        return NULL;
+    }
+
+    if (StringOffsetOfMatch != NULL) {
+        *StringOffsetOfMatch = BestStart;
+    }
+    return &Search->MatchArray[BestIndex];
+}
+
 /**
  Search through a string looking to see if any substrings can be located.
  Returns the first match in offet from the beginning of the string order.
@@ -57,12 +554,29 @@ YoriLibFindFirstMatchSubstr(
     YORI_STRING RemainingString;
     YORI_ALLOC_SIZE_T CheckCount;
 
+    if (NumberMatches == 1 &&
+        String->LengthInChars >= YORI_LIB_SUBSTRING_SEARCH_THRESHOLD) {
+
+        YORI_LIB_SUBSTRING_SEARCH Search;
+
+        YoriLibPrepareSubstringSearch(&Search, &MatchArray[0], FALSE);
+        if (YoriLibSubstringSearch(&Search, String, StringOffsetOfMatch)) {
+            return &MatchArray[0];
+        }
+        return NULL;
+    }
+
     YoriLibInitEmptyString(&RemainingString);
     RemainingString.StartOfString = String->StartOfString;
     RemainingString.LengthInChars = String->LengthInChars;
 
     while (RemainingString.LengthInChars > 0) {
         for (CheckCount = 0; CheckCount < NumberMatches; CheckCount++) {
+            if (MatchArray[CheckCount].LengthInChars > 0 &&
+                MatchArray[CheckCount].StartOfString[0] != RemainingString.StartOfString[0]) {
+
+                continue;
+            }
             if (YoriLibCompareStringCnt(&RemainingString, &MatchArray[CheckCount], MatchArray[CheckCount].LengthInChars) == 0) {
                 if (StringOffsetOfMatch != NULL) {
                     *StringOffsetOfMatch = String->LengthInChars - RemainingString.LengthInChars;
@@ -110,13 +624,32 @@ YoriLibFindFirstMatchSubstrIns(
 {
     YORI_STRING RemainingString;
     YORI_ALLOC_SIZE_T CheckCount;
+    TCHAR FirstChar;
+
+    if (NumberMatches == 1 &&
+        String->LengthInChars >= YORI_LIB_SUBSTRING_SEARCH_THRESHOLD) {
+
+        YORI_LIB_SUBSTRING_SEARCH Search;
+
+        YoriLibPrepareSubstringSearch(&Search, &MatchArray[0], TRUE);
+        if (YoriLibSubstringSearch(&Search, String, StringOffsetOfMatch)) {
+            return &MatchArray[0];
+        }
+        return NULL;
+    }
 
     YoriLibInitEmptyString(&RemainingString);
     RemainingString.StartOfString = String->StartOfString;
     RemainingString.LengthInChars = String->LengthInChars;
 
     while (RemainingString.LengthInChars > 0) {
+        FirstChar = YoriLibUpcaseChar(RemainingString.StartOfString[0]);
         for (CheckCount = 0; CheckCount < NumberMatches; CheckCount++) {
+            if (MatchArray[CheckCount].LengthInChars > 0 &&
+                YoriLibUpcaseChar(MatchArray[CheckCount].StartOfString[0]) != FirstChar) {
+
+                continue;
+            }
             if (YoriLibCompareStringInsCnt(&RemainingString, &MatchArray[CheckCount], MatchArray[CheckCount].LengthInChars) == 0) {
                 if (StringOffsetOfMatch != NULL) {
                     *StringOffsetOfMatch = String->LengthInChars - RemainingString.LengthInChars;
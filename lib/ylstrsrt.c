@@ -3,7 +3,7 @@
  *
  * Yori string sorting routines
  *
- * Copyright (c) 2017-2018 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -50,129 +50,532 @@ YoriLibSwapStrings(
 }
 
 /**
- Sort an array of strings.  This is currently implemented using a handrolled
- quicksort.
+ The number of characters from the start of each string which are folded
+ into the sort key.
+ */
+#define YORI_LIB_SORT_KEY_CHARS (4)
 
- @param StringArray Pointer to an array of strings.
+/**
+ The number of elements below which insertion sort is used in preference to
+ partitioning or merging.
+ */
+#define YORI_LIB_SORT_INSERTION_THRESHOLD (16)
+
+/**
+ An element being sorted.  Each string is paired with a key which contains
+ its first characters upcased, so that most comparisons can be resolved
+ without examining the string.
+ */
+typedef struct _YORI_LIB_SORT_ITEM {
+
+    /**
+     The upcased leading characters of the string, with the first character
+     in the most significant bits.
+     */
+    YORI_MAX_UNSIGNED_T Key;
+
+    /**
+     The string being sorted.
+     */
+    YORI_STRING String;
+} YORI_LIB_SORT_ITEM, *PYORI_LIB_SORT_ITEM;
+
+/**
+ Generate the sort key for a string.  Strings shorter than the key are
+ padded with zero, so that a string sorts before any longer string that it
+ is a prefix of.
+
+ @param String Pointer to the string.
+
+ @return The sort key.
+ */
+YORI_MAX_UNSIGNED_T
+YoriLibSortBuildKey(
+    __in PCYORI_STRING String
+    )
+{
+    YORI_MAX_UNSIGNED_T Key;
+    YORI_ALLOC_SIZE_T Index;
+
+    Key = 0;
+    for (Index = 0; Index < YORI_LIB_SORT_KEY_CHARS; Index++) {
+        Key = Key << 16;
+        if (Index < String->LengthInChars) {
+            Key = Key | (WORD)YoriLibUpcaseCharInline(String->StartOfString[Index]);
+        }
+    }
+
+    return Key;
+}
+
+/**
+ Compare two sort items.  This returns the same result as
+ YoriLibCompareStringIns on the strings, but only examines the strings if
+ their keys are identical.
+
+ @param Item1 Pointer to the first item.
+
+ @param Item2 Pointer to the second item.
+
+ @return Negative if the first item sorts earlier, positive if the second
+         sorts earlier, or zero if they are equal.
+ */
+int
+YoriLibSortCompareItems(
+    __in PYORI_LIB_SORT_ITEM Item1,
+    __in PYORI_LIB_SORT_ITEM Item2
+    )
+{
+    if (Item1->Key < Item2->Key) {
+        return -1;
+    } else if (Item1->Key > Item2->Key) {
+        return 1;
+    }
+
+    return YoriLibCompareStringIns(&Item1->String, &Item2->String);
+}
+
+/**
+ Swap two sort items.
+
+ @param Item1 Pointer to the first item.
+
+ @param Item2 Pointer to the second item.
+ */
+VOID
+YoriLibSortSwapItems(
+    __inout PYORI_LIB_SORT_ITEM Item1,
+    __inout PYORI_LIB_SORT_ITEM Item2
+    )
+{
+    YORI_LIB_SORT_ITEM SwapItem;
+
+    memcpy(&SwapItem, Item2, sizeof(YORI_LIB_SORT_ITEM));
+    memcpy(Item2, Item1, sizeof(YORI_LIB_SORT_ITEM));
+    memcpy(Item1, &SwapItem, sizeof(YORI_LIB_SORT_ITEM));
+}
+
+/**
+ Sort a small array of items with an insertion sort.  This is stable.
+
+ @param Items Pointer to an array of items.
 
  @param Count The number of elements in the array.
  */
 VOID
-YoriLibSortStringArray(
-    __in_ecount(Count) PYORI_STRING StringArray,
+YoriLibSortInsertionItems(
+    __inout_ecount(Count) PYORI_LIB_SORT_ITEM Items,
     __in YORI_ALLOC_SIZE_T Count
     )
 {
-    YORI_ALLOC_SIZE_T FirstOffset;
+    YORI_LIB_SORT_ITEM Current;
     YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Insert;
+
+    for (Index = 1; Index < Count; Index++) {
+        if (YoriLibSortCompareItems(&Items[Index - 1], &Items[Index]) <= 0) {
+            continue;
+        }
+
+        memcpy(&Current, &Items[Index], sizeof(YORI_LIB_SORT_ITEM));
+        Insert = Index;
+        do {
+            memcpy(&Items[Insert], &Items[Insert - 1], sizeof(YORI_LIB_SORT_ITEM));
+            Insert--;
+        } while (Insert > 0 && YoriLibSortCompareItems(&Items[Insert - 1], &Current) > 0);
+        memcpy(&Items[Insert], &Current, sizeof(YORI_LIB_SORT_ITEM));
+    }
+}
+
+/**
+ Sort an array of items with a heap sort.  This is used when partitioning
+ is not making progress, so that the sort cannot become quadratic.
+
+ @param Items Pointer to an array of items.
+
+ @param Count The number of elements in the array.
+ */
+VOID
+YoriLibSortHeapItems(
+    __inout_ecount(Count) PYORI_LIB_SORT_ITEM Items,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    YORI_ALLOC_SIZE_T Start;
+    YORI_ALLOC_SIZE_T End;
+    YORI_ALLOC_SIZE_T Parent;
+    YORI_ALLOC_SIZE_T Child;
 
     if (Count <= 1) {
         return;
     }
 
-    FirstOffset = 0;
+    //
+    //  Build a max heap, then repeatedly move the largest element to the
+    //  end and restore the heap over the remaining elements.
+    //
 
-    while (TRUE) {
-        YORI_ALLOC_SIZE_T BreakPoint;
-        YORI_ALLOC_SIZE_T LastOffset;
-        YORI_STRING MidPoint;
-        volatile DWORD LastSwapFirst;
-        volatile DWORD LastSwapLast;
+    Start = Count / 2;
+    End = Count;
+    while (End > 1) {
+        if (Start > 0) {
+            Start--;
+            Parent = Start;
+        } else {
+            End--;
+            YoriLibSortSwapItems(&Items[0], &Items[End]);
+            Parent = 0;
+        }
+
+        while (TRUE) {
+            Child = Parent * 2 + 1;
+            if (Child >= End) {
+                break;
+            }
+            if (Child + 1 < End &&
+                YoriLibSortCompareItems(&Items[Child], &Items[Child + 1]) < 0) {
+                Child++;
+            }
+            if (YoriLibSortCompareItems(&Items[Parent], &Items[Child]) >= 0) {
+                break;
+            }
+            YoriLibSortSwapItems(&Items[Parent], &Items[Child]);
+            Parent = Child;
+        }
+    }
+}
+
+/**
+ Sort an array of items with an introsort: a quicksort using a median of
+ three pivot, which switches to heap sort if partitioning goes too deep and
+ to insertion sort for small ranges.
+
+ @param Items Pointer to an array of items.
+
+ @param Count The number of elements in the array.
+
+ @param DepthRemaining The number of partitioning passes which can be
+        performed before switching to heap sort.
+ */
+VOID
+YoriLibSortIntroItems(
+    __inout_ecount(Count) PYORI_LIB_SORT_ITEM Items,
+    __in YORI_ALLOC_SIZE_T Count,
+    __in DWORD DepthRemaining
+    )
+{
+    YORI_LIB_SORT_ITEM Pivot;
+    YORI_ALLOC_SIZE_T Mid;
+    YORI_ALLOC_SIZE_T Last;
+    YORI_ALLOC_SIZE_T FirstOffset;
+    YORI_ALLOC_SIZE_T LastOffset;
+
+    while (Count > YORI_LIB_SORT_INSERTION_THRESHOLD) {
+
+        if (DepthRemaining == 0) {
+            YoriLibSortHeapItems(Items, Count);
+            return;
+        }
+        DepthRemaining--;
 
-        BreakPoint = Count / 2;
-        memcpy(&MidPoint, &StringArray[BreakPoint], sizeof(YORI_STRING));
-    
-        FirstOffset = 0;
-        LastOffset = Count - 1;
-    
         //
-        //  Scan from the beginning looking for an item that should be sorted
-        //  after the midpoint.
+        //  Order the first, middle and last elements.  The middle becomes
+        //  the pivot, and the first and last act as sentinels so the scans
+        //  below cannot run off either end.
         //
-    
-        for (FirstOffset = 0; FirstOffset < LastOffset; FirstOffset++) {
-            if (YoriLibCompareStringIns(&StringArray[FirstOffset],&MidPoint) >= 0) {
-                for (; LastOffset > FirstOffset; LastOffset--) {
-                    if (YoriLibCompareStringIns(&StringArray[LastOffset],&MidPoint) < 0) {
-                        LastSwapFirst = FirstOffset;
-                        LastSwapLast = LastOffset;
-                        YoriLibSwapStrings(&StringArray[FirstOffset], &StringArray[LastOffset]);
-                        LastOffset--;
-                        break;
-                    }
-                }
-                if (LastOffset <= FirstOffset) {
-                    break;
-                }
+
+        Mid = Count / 2;
+        Last = Count - 1;
+        if (YoriLibSortCompareItems(&Items[Mid], &Items[0]) < 0) {
+            YoriLibSortSwapItems(&Items[Mid], &Items[0]);
+        }
+        if (YoriLibSortCompareItems(&Items[Last], &Items[Mid]) < 0) {
+            YoriLibSortSwapItems(&Items[Last], &Items[Mid]);
+            if (YoriLibSortCompareItems(&Items[Mid], &Items[0]) < 0) {
+                YoriLibSortSwapItems(&Items[Mid], &Items[0]);
             }
         }
+        memcpy(&Pivot, &Items[Mid], sizeof(YORI_LIB_SORT_ITEM));
+
+        FirstOffset = 0;
+        LastOffset = Last;
+        while (TRUE) {
+            do {
+                FirstOffset++;
+            } while (YoriLibSortCompareItems(&Items[FirstOffset], &Pivot) < 0);
+
+            do {
+                LastOffset--;
+            } while (YoriLibSortCompareItems(&Items[LastOffset], &Pivot) > 0);
 
-        ASSERT(FirstOffset == LastOffset);
-        FirstOffset = LastOffset;
-        if (YoriLibCompareStringIns(&StringArray[FirstOffset], &MidPoint) < 0) {
-            FirstOffset++;
+            if (FirstOffset >= LastOffset) {
+                break;
+            }
+
+            YoriLibSortSwapItems(&Items[FirstOffset], &Items[LastOffset]);
         }
 
         //
-        //  If no copies occurred, check if everything in the list is
-        //  sorted.
+        //  Everything before FirstOffset sorts no later than the pivot, and
+        //  everything from FirstOffset onwards sorts no earlier.  Recurse
+        //  into the smaller side and loop on the larger one to bound the
+        //  stack depth.
         //
 
-        if (FirstOffset == 0 || FirstOffset == Count) {
-            for (Index = 0; Index < Count - 1; Index++) {
-                if (YoriLibCompareStringIns(&StringArray[Index], &StringArray[Index + 1]) > 0) {
-                    break;
-                }
+        if (FirstOffset < Count - FirstOffset) {
+            YoriLibSortIntroItems(Items, FirstOffset, DepthRemaining);
+            Items = &Items[FirstOffset];
+            Count = Count - FirstOffset;
+        } else {
+            YoriLibSortIntroItems(&Items[FirstOffset], Count - FirstOffset, DepthRemaining);
+            Count = FirstOffset;
+        }
+    }
+
+    YoriLibSortInsertionItems(Items, Count);
+}
+
+/**
+ Sort an array of items with a merge sort.  This is stable, so items which
+ compare equal remain in their original order.
+
+ @param Items Pointer to an array of items.
+
+ @param Temp Pointer to a scratch array with space for Count items.
+
+ @param Count The number of elements in the array.
+ */
+VOID
+YoriLibSortMergeItems(
+    __inout_ecount(Count) PYORI_LIB_SORT_ITEM Items,
+    __out_ecount(Count) PYORI_LIB_SORT_ITEM Temp,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    PYORI_LIB_SORT_ITEM Source;
+    PYORI_LIB_SORT_ITEM Dest;
+    PYORI_LIB_SORT_ITEM Swap;
+    YORI_ALLOC_SIZE_T RunLength;
+    YORI_ALLOC_SIZE_T Start;
+    YORI_ALLOC_SIZE_T Middle;
+    YORI_ALLOC_SIZE_T End;
+    YORI_ALLOC_SIZE_T Left;
+    YORI_ALLOC_SIZE_T Right;
+    YORI_ALLOC_SIZE_T Index;
+
+    //
+    //  Sort small runs in place, then merge pairs of runs back and forth
+    //  between the two arrays, doubling the run length each pass.
+    //
+
+    for (Start = 0; Start < Count; Start += YORI_LIB_SORT_INSERTION_THRESHOLD) {
+        End = Start + YORI_LIB_SORT_INSERTION_THRESHOLD;
+        if (End > Count) {
+            End = Count;
+        }
+        YoriLibSortInsertionItems(&Items[Start], End - Start);
+    }
+
+    Source = Items;
+    Dest = Temp;
+
+    for (RunLength = YORI_LIB_SORT_INSERTION_THRESHOLD; RunLength < Count; RunLength = RunLength * 2) {
+        for (Start = 0; Start < Count; Start = End) {
+            Middle = Start + RunLength;
+            if (Middle > Count) {
+                Middle = Count;
             }
-            if (Index == Count - 1) {
-                return;
+            End = Middle + RunLength;
+            if (End > Count || End < Middle) {
+                End = Count;
             }
 
-            //
-            //  Nothing was copied and it's not because it's identical.  This
-            //  implies a very bad choice of midpoint that belongs either at
-            //  the beginning or the end (so nothing could move past it.)
-            //  Move it around and repeat the process (which will get a new
-            //  midpoint.)
-            //
-    
-            if (FirstOffset == 0) {
-                ASSERT(YoriLibCompareStringIns(&StringArray[0], &MidPoint) > 0);
-
-                if (YoriLibCompareStringIns(&StringArray[0], &MidPoint) > 0) {
-                    YoriLibSwapStrings(&StringArray[0], &StringArray[BreakPoint]);
+            Left = Start;
+            Right = Middle;
+            for (Index = Start; Index < End; Index++) {
+                if (Left < Middle &&
+                    (Right >= End || YoriLibSortCompareItems(&Source[Left], &Source[Right]) <= 0)) {
+
+                    memcpy(&Dest[Index], &Source[Left], sizeof(YORI_LIB_SORT_ITEM));
+                    Left++;
+                } else {
+                    memcpy(&Dest[Index], &Source[Right], sizeof(YORI_LIB_SORT_ITEM));
+                    Right++;
                 }
-            } else {
-                ASSERT(YoriLibCompareStringIns(&MidPoint, &StringArray[Count - 1]) > 0);
-                YoriLibSwapStrings(&StringArray[Count - 1], &StringArray[BreakPoint]);
             }
-        } else {
+        }
+
+        Swap = Source;
+        Source = Dest;
+        Dest = Swap;
+
+        if (RunLength > Count / 2) {
             break;
         }
     }
 
-    //
-    //  If there are two sets (FirstOffset is not at either end), recurse.
-    //
+    if (Source != Items) {
+        memcpy(Items, Source, Count * sizeof(YORI_LIB_SORT_ITEM));
+    }
+}
 
-    if (FirstOffset && (Count - FirstOffset)) {
-        if (FirstOffset > 0) {
-            YoriLibSortStringArray(StringArray, FirstOffset);
-        }
-        if ((Count - FirstOffset) > 0) {
-            YoriLibSortStringArray(&StringArray[FirstOffset], Count - FirstOffset);
+/**
+ Sort an array of strings in place with a stable insertion sort, without
+ requiring any memory allocation.  This is only used if memory for the
+ sort keys cannot be allocated.
+
+ @param StringArray Pointer to an array of strings.
+
+ @param Count The number of elements in the array.
+ */
+VOID
+YoriLibSortStringArrayNoAlloc(
+    __inout_ecount(Count) PYORI_STRING StringArray,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Insert;
+
+    for (Index = 1; Index < Count; Index++) {
+        for (Insert = Index; Insert > 0; Insert--) {
+            if (YoriLibCompareStringIns(&StringArray[Insert - 1], &StringArray[Insert]) <= 0) {
+                break;
+            }
+            YoriLibSwapStrings(&StringArray[Insert - 1], &StringArray[Insert]);
         }
     }
+}
 
-    //
-    //  Check that it's now sorted
-    //
+/**
+ Allocate an array of sort items describing an array of strings, with
+ optional scratch space for a merge sort.
+
+ @param StringArray Pointer to an array of strings.
+
+ @param Count The number of elements in the array.
+
+ @param ItemsToAllocate The number of items to allocate, which must be at
+        least Count.
+
+ @return Pointer to the array of items, or NULL on allocation failure.
+ */
+PYORI_LIB_SORT_ITEM
+YoriLibSortAllocateItems(
+    __in_ecount(Count) PYORI_STRING StringArray,
+    __in YORI_ALLOC_SIZE_T Count,
+    __in YORI_ALLOC_SIZE_T ItemsToAllocate
+    )
+{
+    PYORI_LIB_SORT_ITEM Items;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)ItemsToAllocate * sizeof(YORI_LIB_SORT_ITEM))) {
+        return NULL;
+    }
+
+    Items = YoriLibMalloc(ItemsToAllocate * sizeof(YORI_LIB_SORT_ITEM));
+    if (Items == NULL) {
+        return NULL;
+    }
+
+    for (Index = 0; Index < Count; Index++) {
+        Items[Index].Key = YoriLibSortBuildKey(&StringArray[Index]);
+        memcpy(&Items[Index].String, &StringArray[Index], sizeof(YORI_STRING));
+    }
+
+    return Items;
+}
+
+/**
+ Sort an array of strings without regard to case.  This is implemented as
+ an introsort over a copy of the array which carries the upcased leading
+ characters of each string, so most comparisons are resolved without
+ examining the strings.  The order of strings which compare equal is not
+ defined; use @ref YoriLibStableSortStringArray if that matters.
+
+ @param StringArray Pointer to an array of strings.
+
+ @param Count The number of elements in the array.
+ */
+VOID
+YoriLibSortStringArray(
+    __in_ecount(Count) PYORI_STRING StringArray,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    PYORI_LIB_SORT_ITEM Items;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD DepthLimit;
+
+    if (Count <= 1) {
+        return;
+    }
+
+    Items = YoriLibSortAllocateItems(StringArray, Count, Count);
+    if (Items == NULL) {
+        YoriLibSortStringArrayNoAlloc(StringArray, Count);
+        return;
+    }
+
+    DepthLimit = 0;
+    for (Index = Count; Index > 1; Index = Index / 2) {
+        DepthLimit += 2;
+    }
+
+    YoriLibSortIntroItems(Items, Count, DepthLimit);
+
+    for (Index = 0; Index < Count; Index++) {
+        memcpy(&StringArray[Index], &Items[Index].String, sizeof(YORI_STRING));
+    }
+
+    YoriLibFree(Items);
+
+#if DBG
     for (Index = 0; Index < Count - 1; Index++) {
-        if (YoriLibCompareStringIns(&StringArray[Index], &StringArray[Index + 1]) > 0) {
-            break;
-        }
+        ASSERT(YoriLibCompareStringIns(&StringArray[Index], &StringArray[Index + 1]) <= 0);
+    }
+#endif
+}
+
+/**
+ Sort an array of strings without regard to case, preserving the order of
+ strings which compare equal.  This is implemented as a merge sort.
+
+ @param StringArray Pointer to an array of strings.
+
+ @param Count The number of elements in the array.
+ */
+VOID
+YoriLibStableSortStringArray(
+    __in_ecount(Count) PYORI_STRING StringArray,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    PYORI_LIB_SORT_ITEM Items;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (Count <= 1) {
+        return;
+    }
+
+    Items = NULL;
+    if (Count <= YORI_MAX_ALLOC_SIZE / 2) {
+        Items = YoriLibSortAllocateItems(StringArray, Count, Count * 2);
     }
-    ASSERT (Index == Count - 1);
+
+    if (Items == NULL) {
+        YoriLibSortStringArrayNoAlloc(StringArray, Count);
+        return;
+    }
+
+    YoriLibSortMergeItems(Items, &Items[Count], Count);
+
+    for (Index = 0; Index < Count; Index++) {
+        memcpy(&StringArray[Index], &Items[Index].String, sizeof(YORI_STRING));
+    }
+
+    YoriLibFree(Items);
 }
 
 // vim:sw=4:ts=4:et:
@@ -61,6 +61,14 @@ typedef DWORD SYSERR;
 #define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
 #endif
 
+#ifndef CREATE_NO_WINDOW
+/**
+ Launch a console process with a console that has no window, rather than
+ sharing the console of the parent.
+ */
+#define CREATE_NO_WINDOW 0x08000000
+#endif
+
 #ifndef ENABLE_QUICK_EDIT_MODE
 /**
  Mouse selection capability owned by the console.
@@ -196,6 +204,14 @@ typedef _Return_type_success_(return >= 0) long HRESULT;
 #define ERROR_OLD_WIN_VERSION 1150
 #endif
 
+#ifndef ERROR_TOO_MANY_LINKS
+/**
+ Define for the error indicating that a file cannot have any more hard
+ links.
+ */
+#define ERROR_TOO_MANY_LINKS 1142
+#endif
+
 #ifndef PROCESS_QUERY_LIMITED_INFORMATION
 /**
  Definition for opening processes with very limited access for compilation
@@ -220,6 +236,32 @@ typedef _Return_type_success_(return >= 0) long HRESULT;
 #define SE_CREATE_SYMBOLIC_LINK_NAME      _T("SeCreateSymbolicLinkPrivilege")
 #endif
 
+#ifndef COPY_FILE_COPY_SYMLINK
+/**
+ If the compilation environment hasn't defined it, define the flag to
+ CopyFileEx indicating that a symbolic link should be copied as a link
+ rather than copying its target.
+ */
+#define COPY_FILE_COPY_SYMLINK            (0x00000800)
+#endif
+
+#ifndef SE_DACL_PROTECTED
+/**
+ If the compilation environment hasn't defined it, define the security
+ descriptor control flag indicating that the DACL does not inherit entries
+ from its parent.
+ */
+#define SE_DACL_PROTECTED                 (0x1000)
+#endif
+
+#ifndef INHERITED_ACE
+/**
+ If the compilation environment hasn't defined it, define the ACE flag
+ indicating that the entry was inherited from a parent object.
+ */
+#define INHERITED_ACE                     (0x10)
+#endif
+
 #ifndef DIRECTORY_QUERY
 /**
  The security flag indicating a request to open an object manager directory
@@ -444,6 +486,25 @@ typedef struct _YORI_FILE_CASE_SENSITIVE_INFORMATION {
 
 } YORI_FILE_CASE_SENSITIVE_INFORMATION, *PYORI_FILE_CASE_SENSITIVE_INFORMATION;
 
+/**
+ Definition of the information class to obtain the size of extended
+ attributes on a file for compilation environments that don't define it.
+ */
+#define FileEaInformation (7)
+
+/**
+ Information about the extended attributes on a file.
+ */
+typedef struct _YORI_FILE_EA_INFORMATION {
+
+    /**
+     The size of the extended attributes on the file, in bytes.  Zero if
+     the file has no extended attributes.
+     */
+    DWORD EaSize;
+
+} YORI_FILE_EA_INFORMATION, *PYORI_FILE_EA_INFORMATION;
+
 /**
  Definition of the information class to query memory usage of a process for
  compilation environments that don't define it.
@@ -1155,9 +1216,34 @@ typedef struct _YORI_SYSTEM_PROCESS_INFORMATION {
     PVOID Reserved6[2];
 
     /**
-     Ignored in this application.
+     The number of read operations performed by the process.
+     */
+    LARGE_INTEGER ReadOperationCount;
+
+    /**
+     The number of write operations performed by the process.
+     */
+    LARGE_INTEGER WriteOperationCount;
+
+    /**
+     The number of other I/O operations performed by the process.
+     */
+    LARGE_INTEGER OtherOperationCount;
+
+    /**
+     The number of bytes read by the process.
+     */
+    LARGE_INTEGER ReadTransferCount;
+
+    /**
+     The number of bytes written by the process.
+     */
+    LARGE_INTEGER WriteTransferCount;
+
+    /**
+     The number of bytes transferred by other I/O operations.
      */
-    LARGE_INTEGER Reserved7[6];
+    LARGE_INTEGER OtherTransferCount;
 
 } YORI_SYSTEM_PROCESS_INFORMATION, *PYORI_SYSTEM_PROCESS_INFORMATION;
 
@@ -1917,6 +2003,22 @@ typedef struct _YORI_IO_COUNTERS {
 
 } YORI_IO_COUNTERS, *PYORI_IO_COUNTERS;
 
+/**
+ The set of information levels that can be returned from FindFirstFileEx.
+ */
+typedef enum _YORI_FINDEX_INFO_LEVELS {
+    YoriFindExInfoStandard = 0,
+    YoriFindExInfoBasic = 1
+} YORI_FINDEX_INFO_LEVELS;
+
+/**
+ The set of search operations that can be performed by FindFirstFileEx.
+ */
+typedef enum _YORI_FINDEX_SEARCH_OPS {
+    YoriFindExSearchNameMatch = 0,
+    YoriFindExSearchLimitToDirectories = 1
+} YORI_FINDEX_SEARCH_OPS;
+
 /**
  A set of processor property relationships that are known to
  GetLogicalProcessorInformationEx.
@@ -2224,6 +2326,85 @@ typedef struct _YORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX {
     } u;
 } YORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX, *PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX;
 
+/**
+ The type of information returned from GetSystemCpuSetInformation for a
+ CPU set.
+ */
+#define YoriCpuSetInformation (0)
+
+/**
+ Information returned from GetSystemCpuSetInformation describing a CPU set,
+ which corresponds to a single logical processor.  This information is
+ available on Windows 10+.
+ */
+typedef struct _YORI_SYSTEM_CPU_SET_INFORMATION {
+
+    /**
+     The size of this element in bytes.  This allows the structure to be
+     extended in future.
+     */
+    DWORD Size;
+
+    /**
+     The type of information in this element.  Only YoriCpuSetInformation
+     is currently defined.
+     */
+    DWORD Type;
+
+    /**
+     The identifier of the CPU set, which is used when assigning threads to
+     CPU sets.
+     */
+    DWORD Id;
+
+    /**
+     The processor group of the logical processor.
+     */
+    WORD Group;
+
+    /**
+     The index of the logical processor within its processor group.
+     */
+    UCHAR LogicalProcessorIndex;
+
+    /**
+     An index of the processor core containing the logical processor.
+     */
+    UCHAR CoreIndex;
+
+    /**
+     An index of the last level cache used by the logical processor.
+     */
+    UCHAR LastLevelCacheIndex;
+
+    /**
+     An index of the NUMA node containing the logical processor.
+     */
+    UCHAR NumaNodeIndex;
+
+    /**
+     Indicates the performance and power draw of the logical processor.  The
+     higher the value, the higher performance and power consumption.
+     */
+    UCHAR EfficiencyClass;
+
+    /**
+     Flags describing the state of the CPU set.
+     */
+    UCHAR AllFlags;
+
+    /**
+     Reserved space for future use.
+     */
+    DWORD Reserved;
+
+    /**
+     A tag assigned to the CPU set by the system.
+     */
+    DWORDLONG AllocationTag;
+
+} YORI_SYSTEM_CPU_SET_INFORMATION, *PYORI_SYSTEM_CPU_SET_INFORMATION;
+
 #ifndef REG_QWORD
 /**
  A define for REG_QWORD, if not provided by the compilation environment.
@@ -2371,6 +2552,14 @@ typedef struct _YORI_VOLUME_DISK_EXTENTS {
 #define IO_REPARSE_TAG_SYMLINK     (0xA000000C)
 #endif
 
+#ifndef IO_REPARSE_TAG_WOF
+/**
+ The reparse tag indicating a file whose contents are provided by the
+ Windows Overlay Filter.
+ */
+#define IO_REPARSE_TAG_WOF         (0x80000017)
+#endif
+
 #ifndef IO_REPARSE_TAG_APPEXECLINK
 /**
  The reparse tag indicating a modern app link.
@@ -2586,6 +2775,14 @@ typedef struct _YORI_REPARSE_DATA_BUFFER {
 #define FILE_ATTRIBUTE_STRICTLY_SEQUENTIAL   (0x20000000)
 #endif
 
+#ifndef FIND_FIRST_EX_LARGE_FETCH
+/**
+ Specifies that FindFirstFileEx should use a larger buffer for directory
+ queries if the compilation environment doesn't provide it.
+ */
+#define FIND_FIRST_EX_LARGE_FETCH        (0x00000002)
+#endif
+
 #ifndef FILE_FLAG_OPEN_NO_RECALL
 /**
  Specifies the value for opening a file without recalling from slow storage
@@ -2612,6 +2809,13 @@ typedef struct _YORI_REPARSE_DATA_BUFFER {
 #define COMPRESSION_FORMAT_LZNT1        (0x0002)
 #endif
 
+#ifndef COMPRESSION_ENGINE_STANDARD
+/**
+ Specifies the standard compression engine to RtlCompressBuffer.
+ */
+#define COMPRESSION_ENGINE_STANDARD     (0x0000)
+#endif
+
 #ifndef FSCTL_GET_NTFS_VOLUME_DATA
 /**
  Specifies the FSCTL_GET_NTFS_VOLUME_DATA numerical representation if the
@@ -2853,6 +3057,57 @@ typedef struct RETRIEVAL_POINTERS_BUFFER {
 } RETRIEVAL_POINTERS_BUFFER, *PRETRIEVAL_POINTERS_BUFFER;
 #endif
 
+#ifndef FSCTL_GET_VOLUME_BITMAP
+/**
+ Specifies the FSCTL_GET_VOLUME_BITMAP numerical representation if the
+ compilation environment doesn't provide it.
+ */
+#define FSCTL_GET_VOLUME_BITMAP          CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 27,  METHOD_NEITHER, FILE_ANY_ACCESS)
+
+/**
+ Specifies information required to request volume allocation information.
+ */
+typedef struct {
+
+    /**
+     Specifies the first cluster on the volume where allocation information
+     is requested.
+     */
+    LARGE_INTEGER StartingLcn;
+
+} STARTING_LCN_INPUT_BUFFER;
+
+/**
+ Pointer to information required to request volume allocation information.
+ */
+typedef STARTING_LCN_INPUT_BUFFER *PSTARTING_LCN_INPUT_BUFFER;
+
+/**
+ A buffer returned when enumerating volume allocation information.  Defined
+ here for when the compilation environment doesn't define it.
+ */
+typedef struct _VOLUME_BITMAP_BUFFER {
+
+    /**
+     The cluster described by the first bit in Buffer.  This can be less
+     than the requested cluster since it is rounded down to a byte.
+     */
+    LARGE_INTEGER StartingLcn;
+
+    /**
+     The number of clusters from StartingLcn to the end of the volume.
+     */
+    LARGE_INTEGER BitmapSize;
+
+    /**
+     One bit per cluster, set if the cluster is in use.  The IOCTL result
+     indicates how many bytes are present.
+     */
+    BYTE Buffer[1];
+
+} VOLUME_BITMAP_BUFFER, *PVOLUME_BITMAP_BUFFER;
+#endif
+
 #ifndef FSCTL_MOVE_FILE
 /**
  Specifies the FSCTL_MOVE_FILE numerical representation if the compilation
@@ -2914,6 +3169,118 @@ typedef struct _FILE_ALLOCATED_RANGE_BUFFER {
 
 #endif
 
+#ifndef FSCTL_SET_SPARSE
+/**
+ Specifies the FSCTL_SET_SPARSE numerical representation if the compilation
+ environment doesn't provide it.
+ */
+#define FSCTL_SET_SPARSE                CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 49,  METHOD_BUFFERED, FILE_ANY_ACCESS)
+#endif
+
+#ifndef FSCTL_GET_INTEGRITY_INFORMATION
+/**
+ Specifies the FSCTL_GET_INTEGRITY_INFORMATION numerical representation if
+ the compilation environment doesn't provide it.
+ */
+#define FSCTL_GET_INTEGRITY_INFORMATION CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 159, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+/**
+ Specifies the FSCTL_SET_INTEGRITY_INFORMATION numerical representation if
+ the compilation environment doesn't provide it.
+ */
+#define FSCTL_SET_INTEGRITY_INFORMATION CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 160, METHOD_BUFFERED, FILE_READ_DATA | FILE_WRITE_DATA)
+
+/**
+ Information about the integrity settings of a file, returned from
+ FSCTL_GET_INTEGRITY_INFORMATION.
+ */
+typedef struct _FSCTL_GET_INTEGRITY_INFORMATION_BUFFER {
+
+    /**
+     The checksum algorithm used by the file.
+     */
+    WORD ChecksumAlgorithm;
+
+    /**
+     Reserved.
+     */
+    WORD Reserved;
+
+    /**
+     Flags describing integrity enforcement.
+     */
+    DWORD Flags;
+
+    /**
+     The size of each checksummed chunk, in bytes.
+     */
+    DWORD ChecksumChunkSizeInBytes;
+
+    /**
+     The cluster size of the volume, in bytes.
+     */
+    DWORD ClusterSizeInBytes;
+
+} FSCTL_GET_INTEGRITY_INFORMATION_BUFFER, *PFSCTL_GET_INTEGRITY_INFORMATION_BUFFER;
+
+/**
+ Integrity settings to apply to a file with FSCTL_SET_INTEGRITY_INFORMATION.
+ */
+typedef struct _FSCTL_SET_INTEGRITY_INFORMATION_BUFFER {
+
+    /**
+     The checksum algorithm to use.
+     */
+    WORD ChecksumAlgorithm;
+
+    /**
+     Reserved.
+     */
+    WORD Reserved;
+
+    /**
+     Flags describing integrity enforcement.
+     */
+    DWORD Flags;
+
+} FSCTL_SET_INTEGRITY_INFORMATION_BUFFER, *PFSCTL_SET_INTEGRITY_INFORMATION_BUFFER;
+#endif
+
+#ifndef FSCTL_DUPLICATE_EXTENTS_TO_FILE
+/**
+ Specifies the FSCTL_DUPLICATE_EXTENTS_TO_FILE numerical representation if
+ the compilation environment doesn't provide it.
+ */
+#define FSCTL_DUPLICATE_EXTENTS_TO_FILE CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 209, METHOD_BUFFERED, FILE_WRITE_DATA)
+
+/**
+ A range of a source file to clone into the file the request is sent to.
+ */
+typedef struct _DUPLICATE_EXTENTS_DATA {
+
+    /**
+     Handle to the source file.
+     */
+    HANDLE FileHandle;
+
+    /**
+     The offset in the source file to clone from.
+     */
+    LARGE_INTEGER SourceFileOffset;
+
+    /**
+     The offset in the target file to clone to.
+     */
+    LARGE_INTEGER TargetFileOffset;
+
+    /**
+     The number of bytes to clone.
+     */
+    LARGE_INTEGER ByteCount;
+
+} DUPLICATE_EXTENTS_DATA, *PDUPLICATE_EXTENTS_DATA;
+#endif
+
 #ifndef FSCTL_GET_OBJECT_ID
 /**
  Specifies the FSCTL_GET_OBJECT_ID numerical representation if the
@@ -3101,48 +3468,272 @@ typedef USN_JOURNAL_DATA *PUSN_JOURNAL_DATA;
 
 #endif
 
-
-#ifndef FSCTL_GET_EXTERNAL_BACKING
+#ifndef FSCTL_READ_USN_JOURNAL
 
 /**
- Specifies the FSCTL_GET_EXTERNAL_BACKING numerical representation if the
+ Specifies the FSCTL_READ_USN_JOURNAL numerical representation if the
  compilation environment doesn't provide it.
  */
-#define FSCTL_GET_EXTERNAL_BACKING       CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 196, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define FSCTL_READ_USN_JOURNAL          CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 46,  METHOD_NEITHER, FILE_ANY_ACCESS)
 #endif
 
-#ifndef FSCTL_SET_EXTERNAL_BACKING
-
 /**
- Specifies the FSCTL_SET_EXTERNAL_BACKING numerical representation if the
- compilation environment doesn't provide it.
+ Parameters to FSCTL_READ_USN_JOURNAL.  This is the original version of the
+ structure, which newer compilation environments define with a different
+ name, and which results in version 2 USN records being returned.
  */
-#define FSCTL_SET_EXTERNAL_BACKING       CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 195, METHOD_BUFFERED, FILE_ANY_ACCESS)
-#endif
+typedef struct _YORI_READ_USN_JOURNAL_DATA {
 
-#ifndef FSCTL_DELETE_EXTERNAL_BACKING
+    /**
+     The first USN to return.
+     */
+    LONGLONG StartUsn;
+
+    /**
+     A mask of reasons to return records for.
+     */
+    DWORD ReasonMask;
+
+    /**
+     If nonzero, only return records generated when a handle is closed.
+     */
+    DWORD ReturnOnlyOnClose;
+
+    /**
+     The time to wait for records if none are available.
+     */
+    DWORDLONG Timeout;
+
+    /**
+     The number of bytes of records to wait for if none are available, or
+     zero to return immediately.
+     */
+    DWORDLONG BytesToWaitFor;
 
+    /**
+     The identifier of the journal to read from.
+     */
+    DWORDLONG UsnJournalID;
+} YORI_READ_USN_JOURNAL_DATA, *PYORI_READ_USN_JOURNAL_DATA;
+
+#ifndef USN_REASON_FILE_CREATE
 /**
- Specifies the FSCTL_DELETE_EXTERNAL_BACKING numerical representation if the
- compilation environment doesn't provide it.
+ A USN record reason indicating the file was created.
  */
-#define FSCTL_DELETE_EXTERNAL_BACKING    CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 197, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define USN_REASON_FILE_CREATE          (0x00000100)
 #endif
 
-#ifndef FSCTL_GET_WOF_VERSION
+#ifndef USN_REASON_FILE_DELETE
 /**
- Specifies the FSCTL_GET_WOF_VERSION numerical representation if the
- compilation environment doesn't provide it.
+ A USN record reason indicating the file was deleted.
  */
-#define FSCTL_GET_WOF_VERSION            CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 218, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define USN_REASON_FILE_DELETE          (0x00000200)
 #endif
 
-#ifndef WOF_PROVIDER_WIM
-
+#ifndef USN_REASON_RENAME_OLD_NAME
 /**
- Identifies the WIM provider within WOF.
+ A USN record reason indicating the record describes the name of a file
+ before it was renamed.
  */
-#define WOF_PROVIDER_WIM                 (0x0001)
+#define USN_REASON_RENAME_OLD_NAME      (0x00001000)
+#endif
+
+#ifndef USN_REASON_RENAME_NEW_NAME
+/**
+ A USN record reason indicating the record describes the name of a file
+ after it was renamed.
+ */
+#define USN_REASON_RENAME_NEW_NAME      (0x00002000)
+#endif
+
+#ifndef ERROR_JOURNAL_DELETE_IN_PROGRESS
+/**
+ The error code indicating a change journal is being deleted.
+ */
+#define ERROR_JOURNAL_DELETE_IN_PROGRESS 1178
+#endif
+
+#ifndef ERROR_JOURNAL_NOT_ACTIVE
+/**
+ The error code indicating a change journal is not active.
+ */
+#define ERROR_JOURNAL_NOT_ACTIVE        1179
+#endif
+
+#ifndef ERROR_JOURNAL_ENTRY_DELETED
+/**
+ The error code indicating that requested change journal records have been
+ discarded.
+ */
+#define ERROR_JOURNAL_ENTRY_DELETED     1181
+#endif
+
+/**
+ Identifies a file to open by its file ID.  This is defined here since older
+ compilation environments don't provide it.
+ */
+typedef struct _YORI_FILE_ID_DESCRIPTOR {
+
+    /**
+     The size of this structure in bytes.
+     */
+    DWORD dwSize;
+
+    /**
+     The type of identifier.  Zero indicates a 64 bit file ID.
+     */
+    DWORD Type;
+
+    /**
+     The 64 bit file ID.
+     */
+    LARGE_INTEGER FileId;
+
+    /**
+     Space for larger identifier types, which are not used here.
+     */
+    DWORDLONG Reserved;
+} YORI_FILE_ID_DESCRIPTOR, *PYORI_FILE_ID_DESCRIPTOR;
+
+/**
+ Information about an object in a directory including its file ID, as
+ returned from GetFileInformationByHandleEx.  This is defined here since
+ older compilation environments don't provide it.
+ */
+typedef struct _YORI_FILE_ID_BOTH_DIR_INFO {
+
+    /**
+     The offset in bytes from this entry to the next entry, or zero if this
+     is the last entry in the buffer.
+     */
+    DWORD NextEntryOffset;
+
+    /**
+     The byte offset of the entry within the directory.  This is only
+     meaningful on some file systems.
+     */
+    DWORD FileIndex;
+
+    /**
+     The time the object was created.
+     */
+    LARGE_INTEGER CreationTime;
+
+    /**
+     The time the object was last accessed.
+     */
+    LARGE_INTEGER LastAccessTime;
+
+    /**
+     The time the object was last written to.
+     */
+    LARGE_INTEGER LastWriteTime;
+
+    /**
+     The time the object's metadata was last changed.
+     */
+    LARGE_INTEGER ChangeTime;
+
+    /**
+     The size of the default stream in bytes.
+     */
+    LARGE_INTEGER EndOfFile;
+
+    /**
+     The space allocated to the default stream in bytes.
+     */
+    LARGE_INTEGER AllocationSize;
+
+    /**
+     The attributes of the object.
+     */
+    DWORD FileAttributes;
+
+    /**
+     The length of FileName in bytes.
+     */
+    DWORD FileNameLength;
+
+    /**
+     The size of the extended attributes of the object.
+     */
+    DWORD EaSize;
+
+    /**
+     The length of ShortName in bytes.
+     */
+    CCHAR ShortNameLength;
+
+    /**
+     The short name of the object, if it has one.
+     */
+    WCHAR ShortName[12];
+
+    /**
+     The 64 bit file ID of the object.
+     */
+    LARGE_INTEGER FileId;
+
+    /**
+     The name of the object.  This is not NULL terminated.
+     */
+    WCHAR FileName[1];
+} YORI_FILE_ID_BOTH_DIR_INFO, *PYORI_FILE_ID_BOTH_DIR_INFO;
+
+/**
+ The identifier of the request type that returns the above structure for
+ the next objects in a directory.
+ */
+#define YoriFileIdBothDirectoryInfo         (0x00000000A)
+
+/**
+ The identifier of the request type that returns the above structure for
+ the first objects in a directory.
+ */
+#define YoriFileIdBothDirectoryRestartInfo  (0x00000000B)
+
+
+#ifndef FSCTL_GET_EXTERNAL_BACKING
+
+/**
+ Specifies the FSCTL_GET_EXTERNAL_BACKING numerical representation if the
+ compilation environment doesn't provide it.
+ */
+#define FSCTL_GET_EXTERNAL_BACKING       CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 196, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#endif
+
+#ifndef FSCTL_SET_EXTERNAL_BACKING
+
+/**
+ Specifies the FSCTL_SET_EXTERNAL_BACKING numerical representation if the
+ compilation environment doesn't provide it.
+ */
+#define FSCTL_SET_EXTERNAL_BACKING       CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 195, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#endif
+
+#ifndef FSCTL_DELETE_EXTERNAL_BACKING
+
+/**
+ Specifies the FSCTL_DELETE_EXTERNAL_BACKING numerical representation if the
+ compilation environment doesn't provide it.
+ */
+#define FSCTL_DELETE_EXTERNAL_BACKING    CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 197, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#endif
+
+#ifndef FSCTL_GET_WOF_VERSION
+/**
+ Specifies the FSCTL_GET_WOF_VERSION numerical representation if the
+ compilation environment doesn't provide it.
+ */
+#define FSCTL_GET_WOF_VERSION            CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 218, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#endif
+
+#ifndef WOF_PROVIDER_WIM
+
+/**
+ Identifies the WIM provider within WOF.
+ */
+#define WOF_PROVIDER_WIM                 (0x0001)
 
 /**
  Information about a file whose contents are provided via WOF.
@@ -3357,6 +3948,14 @@ typedef struct _FILE_DISPOSITION_INFO_EX {
 
 #endif
 
+#ifndef FILE_DISPOSITION_FLAG_IGNORE_READONLY_ATTRIBUTE
+/**
+ Indicates that the file should be deleted even if it is marked read only,
+ if the current compilation environment doesn't define it.
+ */
+#define FILE_DISPOSITION_FLAG_IGNORE_READONLY_ATTRIBUTE 0x0010
+#endif
+
 #ifndef FILE_RENAME_FLAG_REPLACE_IF_EXISTS
 /**
  A flag to replace an already existing file on superseding rename if the
@@ -3967,9 +4566,9 @@ typedef struct _YORI_JOB_BASIC_ACCOUNTING_INFORMATION {
     LARGE_INTEGER Unused2;
 
     /**
-     Field not needed/supported by YoriLib.
+     The total number of page faults incurred by processes in the job.
      */
-    DWORD Unused3;
+    DWORD TotalPageFaultCount;
 
     /**
      The total number of processes that have been initiated.
@@ -3988,6 +4587,23 @@ typedef struct _YORI_JOB_BASIC_ACCOUNTING_INFORMATION {
 
 } YORI_JOB_BASIC_ACCOUNTING_INFORMATION, *PYORI_JOB_BASIC_ACCOUNTING_INFORMATION;
 
+/**
+ Structure to query basic and IO accounting information about a job.
+ */
+typedef struct _YORI_JOB_BASIC_AND_IO_ACCOUNTING_INFORMATION {
+
+    /**
+     Basic accounting information about the job.
+     */
+    YORI_JOB_BASIC_ACCOUNTING_INFORMATION BasicInfo;
+
+    /**
+     The IO requests generated by processes in the job.
+     */
+    YORI_IO_COUNTERS IoInfo;
+
+} YORI_JOB_BASIC_AND_IO_ACCOUNTING_INFORMATION, *PYORI_JOB_BASIC_AND_IO_ACCOUNTING_INFORMATION;
+
 /**
  Structure to change basic information about a job.
  */
@@ -4025,9 +4641,10 @@ typedef struct _YORI_JOB_BASIC_LIMIT_INFORMATION {
     DWORD Unused5;
 
     /**
-     Field not needed/supported by YoriLib.
+     The set of processors that processes in the job can execute on, within
+     the job's processor group.
      */
-    SIZE_T Unused6;
+    SIZE_T Affinity;
 
     /**
      The base process priority to assign to the job.
@@ -4040,6 +4657,46 @@ typedef struct _YORI_JOB_BASIC_LIMIT_INFORMATION {
     DWORD Unused7;
 } YORI_JOB_BASIC_LIMIT_INFORMATION, *PYORI_JOB_BASIC_LIMIT_INFORMATION;
 
+/**
+ Structure to query extended limit information about a job, which includes
+ the peak memory used by the job.
+ */
+typedef struct _YORI_JOB_EXTENDED_LIMIT_INFORMATION {
+
+    /**
+     Basic limit information about the job.
+     */
+    YORI_JOB_BASIC_LIMIT_INFORMATION BasicLimitInformation;
+
+    /**
+     Field not needed/supported by YoriLib.
+     */
+    YORI_IO_COUNTERS Unused1;
+
+    /**
+     Field not needed/supported by YoriLib.
+     */
+    SIZE_T Unused2;
+
+    /**
+     Field not needed/supported by YoriLib.
+     */
+    SIZE_T Unused3;
+
+    /**
+     The largest amount of memory committed by any single process in the
+     job.
+     */
+    SIZE_T PeakProcessMemoryUsed;
+
+    /**
+     The largest amount of memory committed by all processes in the job at
+     any one time.
+     */
+    SIZE_T PeakJobMemoryUsed;
+
+} YORI_JOB_EXTENDED_LIMIT_INFORMATION, *PYORI_JOB_EXTENDED_LIMIT_INFORMATION;
+
 /**
  Information specifying how to associate a job object handle with a completion
  port.
@@ -4058,6 +4715,102 @@ typedef struct _YORI_JOB_ASSOCIATE_COMPLETION_PORT {
     HANDLE Port;
 } YORI_JOB_ASSOCIATE_COMPLETION_PORT, *PYORI_JOB_ASSOCIATE_COMPLETION_PORT;
 
+/**
+ A flag in YORI_JOB_BASIC_LIMIT_INFORMATION indicating that the Affinity
+ field should be applied to the job.
+ */
+#define YORI_JOB_LIMIT_AFFINITY (0x10)
+
+/**
+ A flag in YORI_JOB_BASIC_LIMIT_INFORMATION indicating that the Priority
+ field should be applied to the job.
+ */
+#define YORI_JOB_LIMIT_PRIORITY_CLASS (0x20)
+
+/**
+ Definition of the job information class to query or set the processor
+ groups that a job is assigned to.
+ */
+#define YORI_JOB_GROUP_INFORMATION (11)
+
+/**
+ Definition of the information class to set the I/O priority of a process
+ via NtSetInformationProcess.
+ */
+#define YORI_PROCESS_IO_PRIORITY (33)
+
+/**
+ The lowest I/O priority, used for background work.
+ */
+#define YORI_IO_PRIORITY_VERY_LOW (0)
+
+/**
+ Definition of the information class to set the memory priority of a process
+ via SetProcessInformation.
+ */
+#define YORI_PROCESS_MEMORY_PRIORITY (0)
+
+/**
+ The lowest memory priority, used for background work.
+ */
+#define YORI_MEMORY_PRIORITY_VERY_LOW (1)
+
+/**
+ Definition of the information class to set the power throttling state of a
+ process via SetProcessInformation.
+ */
+#define YORI_PROCESS_POWER_THROTTLING (4)
+
+/**
+ The only defined version of YORI_PROCESS_POWER_THROTTLING_STATE.
+ */
+#define YORI_PROCESS_POWER_THROTTLING_CURRENT_VERSION (1)
+
+/**
+ A power throttling flag indicating that the process can execute at reduced
+ speed to improve energy efficiency, also known as EcoQoS.
+ */
+#define YORI_PROCESS_POWER_THROTTLING_EXECUTION_SPEED (0x1)
+
+/**
+ Information describing whether power throttling applies to a process.
+ */
+typedef struct _YORI_PROCESS_POWER_THROTTLING_STATE {
+
+    /**
+     The version of this structure, which should be
+     YORI_PROCESS_POWER_THROTTLING_CURRENT_VERSION.
+     */
+    DWORD Version;
+
+    /**
+     The set of throttling policies that this request is controlling.
+     Policies not specified here are left to the system.
+     */
+    DWORD ControlMask;
+
+    /**
+     For each policy in ControlMask, whether throttling should be enabled.
+     */
+    DWORD StateMask;
+} YORI_PROCESS_POWER_THROTTLING_STATE, *PYORI_PROCESS_POWER_THROTTLING_STATE;
+
+#ifndef JOB_OBJECT_MSG_EXIT_PROCESS
+/**
+ A definition for JOB_OBJECT_MSG_EXIT_PROCESS if it is not defined by the
+ current compilation environment.
+ */
+#define JOB_OBJECT_MSG_EXIT_PROCESS 7
+#endif
+
+#ifndef JOB_OBJECT_MSG_ABNORMAL_EXIT_PROCESS
+/**
+ A definition for JOB_OBJECT_MSG_ABNORMAL_EXIT_PROCESS if it is not defined
+ by the current compilation environment.
+ */
+#define JOB_OBJECT_MSG_ABNORMAL_EXIT_PROCESS 8
+#endif
+
 
 #ifndef SYMBOLIC_LINK_FLAG_DIRECTORY
 /**
@@ -4932,6 +5685,31 @@ typedef struct _YORI_MONITORINFO {
 #define HP_HASHSIZE 4
 #endif
 
+#ifndef BCRYPT_HASH_REUSABLE_FLAG
+/**
+ A definition for the flag to create a hash object that can be reused after
+ the hash is finished if it is not defined by the current compilation
+ environment.
+ */
+#define BCRYPT_HASH_REUSABLE_FLAG 0x00000020
+#endif
+
+#ifndef BCRYPT_OBJECT_LENGTH
+/**
+ A definition for the property containing the size of a BCrypt object if it
+ is not defined by the current compilation environment.
+ */
+#define BCRYPT_OBJECT_LENGTH L"ObjectLength"
+#endif
+
+#ifndef BCRYPT_HASH_LENGTH
+/**
+ A definition for the property containing the size of a hash result if it is
+ not defined by the current compilation environment.
+ */
+#define BCRYPT_HASH_LENGTH L"HashDigestLength"
+#endif
+
 #ifndef SHUTDOWN_FORCE_OTHERS
 /**
  A definition for the value to force shutdown if it is not defined by the
@@ -6972,6 +7750,30 @@ typedef struct _RESIZE_VIRTUAL_DISK_PARAMETERS {
     };
 } RESIZE_VIRTUAL_DISK_PARAMETERS, *PRESIZE_VIRTUAL_DISK_PARAMETERS;
 
+/**
+ The progress of an asynchronous virtual disk operation.
+ */
+typedef struct _VIRTUAL_DISK_PROGRESS {
+
+    /**
+     ERROR_IO_PENDING if the operation is still in progress, otherwise the
+     final status of the operation.
+     */
+    DWORD OperationStatus;
+
+    /**
+     The amount of work that has been completed, in units of
+     CompletionValue.
+     */
+    ULONGLONG CurrentValue;
+
+    /**
+     The amount of work in the operation.  This may be zero if the amount
+     of work is not known.
+     */
+    ULONGLONG CompletionValue;
+} VIRTUAL_DISK_PROGRESS, *PVIRTUAL_DISK_PROGRESS;
+
 #ifndef HTTP_QUERY_FLAG_NUMBER
 /**
  The flag indicating an HTTP status query wants a numeric return value, if not
@@ -6988,10 +7790,42 @@ typedef struct _RESIZE_VIRTUAL_DISK_PARAMETERS {
 #define HTTP_QUERY_STATUS_CODE (0x13)
 #endif
 
+#ifndef HTTP_QUERY_CONTENT_LENGTH
 /**
- The maximum number of PHY types that can be returned for a single network.
+ The flag indicating an HTTP status query wants the length of the response
+ body, if not defined by the current compilation environment.
  */
-#define YORI_WLAN_MAX_PHY_TYPE_NUMBER 8
+#define HTTP_QUERY_CONTENT_LENGTH (0x05)
+#endif
+
+#ifndef HTTP_QUERY_ACCEPT_RANGES
+/**
+ The flag indicating an HTTP status query wants the byte range units the
+ server accepts, if not defined by the current compilation environment.
+ */
+#define HTTP_QUERY_ACCEPT_RANGES (0x2A)
+#endif
+
+#ifndef HTTP_QUERY_LAST_MODIFIED
+/**
+ The flag indicating an HTTP status query wants the time the object was last
+ modified, if not defined by the current compilation environment.
+ */
+#define HTTP_QUERY_LAST_MODIFIED (0x0B)
+#endif
+
+#ifndef HTTP_QUERY_FLAG_SYSTEMTIME
+/**
+ The flag indicating an HTTP status query wants a SYSTEMTIME return value, if
+ not defined by the current compilation environment.
+ */
+#define HTTP_QUERY_FLAG_SYSTEMTIME 0x40000000
+#endif
+
+/**
+ The maximum number of PHY types that can be returned for a single network.
+ */
+#define YORI_WLAN_MAX_PHY_TYPE_NUMBER 8
 
 /**
  The maximum length of an SSID (wireless network) name.
@@ -7446,6 +8280,18 @@ NT_SET_INFORMATION_FILE(HANDLE, PIO_STATUS_BLOCK, PVOID, DWORD, DWORD);
  */
 typedef NT_SET_INFORMATION_FILE *PNT_SET_INFORMATION_FILE;
 
+/**
+ A prototype for the NtSetInformationProcess function.
+ */
+typedef
+LONG WINAPI
+NT_SET_INFORMATION_PROCESS(HANDLE, DWORD, PVOID, DWORD);
+
+/**
+ A prototype for a pointer to the NtSetInformationProcess function.
+ */
+typedef NT_SET_INFORMATION_PROCESS *PNT_SET_INFORMATION_PROCESS;
+
 /**
  A prototype for the NtSystemDebugControl function.
  */
@@ -7470,6 +8316,30 @@ RTL_GET_LAST_NT_STATUS(VOID);
  */
 typedef RTL_GET_LAST_NT_STATUS *PRTL_GET_LAST_NT_STATUS;
 
+/**
+ A prototype for the RtlCompressBuffer function.
+ */
+typedef
+LONG WINAPI
+RTL_COMPRESS_BUFFER(USHORT, PUCHAR, ULONG, PUCHAR, ULONG, ULONG, PULONG, PVOID);
+
+/**
+ A prototype for a pointer to the RtlCompressBuffer function.
+ */
+typedef RTL_COMPRESS_BUFFER *PRTL_COMPRESS_BUFFER;
+
+/**
+ A prototype for the RtlGetCompressionWorkSpaceSize function.
+ */
+typedef
+LONG WINAPI
+RTL_GET_COMPRESSION_WORK_SPACE_SIZE(USHORT, PULONG, PULONG);
+
+/**
+ A prototype for a pointer to the RtlGetCompressionWorkSpaceSize function.
+ */
+typedef RTL_GET_COMPRESSION_WORK_SPACE_SIZE *PRTL_GET_COMPRESSION_WORK_SPACE_SIZE;
+
 /**
  A structure containing optional function pointers to ntdll.dll exported
  functions which programs can operate without having hard dependencies on.
@@ -7541,12 +8411,30 @@ typedef struct _YORI_NTDLL_FUNCTIONS {
      */
     PNT_SET_INFORMATION_FILE pNtSetInformationFile;
 
+    /**
+     If it's available on the current system, a pointer to
+     NtSetInformationProcess.
+     */
+    PNT_SET_INFORMATION_PROCESS pNtSetInformationProcess;
+
     /**
      If it's available on the current system, a pointer to
      NtSystemDebugControl.
      */
     PNT_SYSTEM_DEBUG_CONTROL pNtSystemDebugControl;
 
+    /**
+     If it's available on the current system, a pointer to
+     RtlCompressBuffer.
+     */
+    PRTL_COMPRESS_BUFFER pRtlCompressBuffer;
+
+    /**
+     If it's available on the current system, a pointer to
+     RtlGetCompressionWorkSpaceSize.
+     */
+    PRTL_GET_COMPRESSION_WORK_SPACE_SIZE pRtlGetCompressionWorkSpaceSize;
+
     /**
      If it's available on the current system, a pointer to
      RtlGetLastNtStatus.
@@ -7620,6 +8508,18 @@ CREATE_HARD_LINKW(LPWSTR, LPWSTR, PVOID);
  */
 typedef CREATE_HARD_LINKW *PCREATE_HARD_LINKW;
 
+/**
+ A prototype for the CreateIoCompletionPort function.
+ */
+typedef
+HANDLE WINAPI
+CREATE_IO_COMPLETION_PORT(HANDLE, HANDLE, ULONG_PTR, DWORD);
+
+/**
+ A prototype for a pointer to the CreateIoCompletionPort function.
+ */
+typedef CREATE_IO_COMPLETION_PORT *PCREATE_IO_COMPLETION_PORT;
+
 /**
  A prototype for the CreateJobObjectW function.
  */
@@ -7644,6 +8544,18 @@ CREATE_SYMBOLIC_LINKW(LPTSTR, LPTSTR, DWORD);
  */
 typedef CREATE_SYMBOLIC_LINKW *PCREATE_SYMBOLIC_LINKW;
 
+/**
+ A prototype for the FindFirstFileExW function.
+ */
+typedef
+HANDLE WINAPI
+FIND_FIRST_FILE_EXW(LPCWSTR, YORI_FINDEX_INFO_LEVELS, LPVOID, YORI_FINDEX_SEARCH_OPS, LPVOID, DWORD);
+
+/**
+ A prototype for a pointer to the FindFirstFileExW function.
+ */
+typedef FIND_FIRST_FILE_EXW *PFIND_FIRST_FILE_EXW;
+
 /**
  A prototype for the FindFirstStreamW function.
  */
@@ -7992,6 +8904,30 @@ GET_PRODUCT_INFO(DWORD, DWORD, DWORD, DWORD, PDWORD);
  */
 typedef GET_PRODUCT_INFO *PGET_PRODUCT_INFO;
 
+/**
+ A prototype for the GetQueuedCompletionStatus function.
+ */
+typedef
+BOOL WINAPI
+GET_QUEUED_COMPLETION_STATUS(HANDLE, LPDWORD, PULONG_PTR, LPOVERLAPPED *, DWORD);
+
+/**
+ A prototype for a pointer to the GetQueuedCompletionStatus function.
+ */
+typedef GET_QUEUED_COMPLETION_STATUS *PGET_QUEUED_COMPLETION_STATUS;
+
+/**
+ A prototype for the GetSystemCpuSetInformation function.
+ */
+typedef
+BOOL WINAPI
+GET_SYSTEM_CPU_SET_INFORMATION(PYORI_SYSTEM_CPU_SET_INFORMATION, DWORD, PDWORD, HANDLE, DWORD);
+
+/**
+ A prototype for a pointer to the GetSystemCpuSetInformation function.
+ */
+typedef GET_SYSTEM_CPU_SET_INFORMATION *PGET_SYSTEM_CPU_SET_INFORMATION;
+
 /**
  A prototype for the GetSystemPowerStatus function.
  */
@@ -8172,6 +9108,18 @@ LOAD_LIBRARY_EXW(LPCWSTR, HANDLE, DWORD);
  */
 typedef LOAD_LIBRARY_EXW *PLOAD_LIBRARY_EXW;
 
+/**
+ A prototype for the OpenFileById function.
+ */
+typedef
+HANDLE WINAPI
+OPEN_FILE_BY_ID(HANDLE, PYORI_FILE_ID_DESCRIPTOR, DWORD, DWORD, LPSECURITY_ATTRIBUTES, DWORD);
+
+/**
+ A prototype for a pointer to the OpenFileById function.
+ */
+typedef OPEN_FILE_BY_ID *POPEN_FILE_BY_ID;
+
 /**
  A prototype for the OpenThread function.
  */
@@ -8184,6 +9132,18 @@ OPEN_THREAD(DWORD, BOOL, DWORD);
  */
 typedef OPEN_THREAD *POPEN_THREAD;
 
+/**
+ A prototype for the PostQueuedCompletionStatus function.
+ */
+typedef
+BOOL WINAPI
+POST_QUEUED_COMPLETION_STATUS(HANDLE, DWORD, ULONG_PTR, LPOVERLAPPED);
+
+/**
+ A prototype for a pointer to the PostQueuedCompletionStatus function.
+ */
+typedef POST_QUEUED_COMPLETION_STATUS *PPOST_QUEUED_COMPLETION_STATUS;
+
 /**
  A prototype for the QueryFullProcessImageNameW function.
  */
@@ -8196,6 +9156,18 @@ QUERY_FULL_PROCESS_IMAGE_NAMEW(HANDLE, DWORD, LPTSTR, PDWORD);
  */
 typedef QUERY_FULL_PROCESS_IMAGE_NAMEW *PQUERY_FULL_PROCESS_IMAGE_NAMEW;
 
+/**
+ A prototype for the QueryProcessCycleTime function.
+ */
+typedef
+BOOL WINAPI
+QUERY_PROCESS_CYCLE_TIME(HANDLE, PDWORDLONG);
+
+/**
+ A prototype for a pointer to the QueryProcessCycleTime function.
+ */
+typedef QUERY_PROCESS_CYCLE_TIME *PQUERY_PROCESS_CYCLE_TIME;
+
 /**
  A prototype for the QueryInformationJobObject function.
  */
@@ -8208,6 +9180,18 @@ QUERY_INFORMATION_JOB_OBJECT(HANDLE, DWORD, PVOID, DWORD, LPDWORD);
  */
 typedef QUERY_INFORMATION_JOB_OBJECT *PQUERY_INFORMATION_JOB_OBJECT;
 
+/**
+ A prototype for the ReadDirectoryChangesW function.
+ */
+typedef
+BOOL WINAPI
+READ_DIRECTORY_CHANGESW(HANDLE, LPVOID, DWORD, BOOL, DWORD, LPDWORD, LPOVERLAPPED, LPOVERLAPPED_COMPLETION_ROUTINE);
+
+/**
+ A prototype for a pointer to the ReadDirectoryChangesW function.
+ */
+typedef READ_DIRECTORY_CHANGESW *PREAD_DIRECTORY_CHANGESW;
+
 /**
  A prototype for the RegisterApplicationRestart function.
  */
@@ -8316,6 +9300,18 @@ SET_INFORMATION_JOB_OBJECT(HANDLE, DWORD, PVOID, DWORD);
  */
 typedef SET_INFORMATION_JOB_OBJECT *PSET_INFORMATION_JOB_OBJECT;
 
+/**
+ A prototype for the SetProcessInformation function.
+ */
+typedef
+BOOL WINAPI
+SET_PROCESS_INFORMATION(HANDLE, DWORD, PVOID, DWORD);
+
+/**
+ A prototype for a pointer to the SetProcessInformation function.
+ */
+typedef SET_PROCESS_INFORMATION *PSET_PROCESS_INFORMATION;
+
 /**
  A prototype for the SetSystemPowerState function.
  */
@@ -8328,6 +9324,30 @@ SET_SYSTEM_POWER_STATE(BOOL, BOOL);
  */
 typedef SET_SYSTEM_POWER_STATE *PSET_SYSTEM_POWER_STATE;
 
+/**
+ A prototype for the SetThreadGroupAffinity function.
+ */
+typedef
+BOOL WINAPI
+SET_THREAD_GROUP_AFFINITY(HANDLE, CONST YORI_PROCESSOR_GROUP_AFFINITY *, PYORI_PROCESSOR_GROUP_AFFINITY);
+
+/**
+ A prototype for a pointer to the SetThreadGroupAffinity function.
+ */
+typedef SET_THREAD_GROUP_AFFINITY *PSET_THREAD_GROUP_AFFINITY;
+
+/**
+ A prototype for the SetThreadSelectedCpuSets function.
+ */
+typedef
+BOOL WINAPI
+SET_THREAD_SELECTED_CPU_SETS(HANDLE, CONST DWORD *, DWORD);
+
+/**
+ A prototype for a pointer to the SetThreadSelectedCpuSets function.
+ */
+typedef SET_THREAD_SELECTED_CPU_SETS *PSET_THREAD_SELECTED_CPU_SETS;
+
 /**
  A prototype for the WritePrivateProfileStringW function.
  */
@@ -8422,6 +9442,11 @@ typedef struct _YORI_KERNEL32_FUNCTIONS {
      */
     PCREATE_HARD_LINKW pCreateHardLinkW;
 
+    /**
+     If it's available on the current system, a pointer to CreateIoCompletionPort.
+     */
+    PCREATE_IO_COMPLETION_PORT pCreateIoCompletionPort;
+
     /**
      If it's available on the current system, a pointer to CreateJobObjectW.
      */
@@ -8432,6 +9457,11 @@ typedef struct _YORI_KERNEL32_FUNCTIONS {
      */
     PCREATE_SYMBOLIC_LINKW pCreateSymbolicLinkW;
 
+    /**
+     If it's available on the current system, a pointer to FindFirstFileExW.
+     */
+    PFIND_FIRST_FILE_EXW pFindFirstFileExW;
+
     /**
      If it's available on the current system, a pointer to FindFirstStreamW.
      */
@@ -8577,6 +9607,16 @@ typedef struct _YORI_KERNEL32_FUNCTIONS {
      */
     PGET_PRODUCT_INFO pGetProductInfo;
 
+    /**
+     If it's available on the current system, a pointer to GetQueuedCompletionStatus.
+     */
+    PGET_QUEUED_COMPLETION_STATUS pGetQueuedCompletionStatus;
+
+    /**
+     If it's available on the current system, a pointer to GetSystemCpuSetInformation.
+     */
+    PGET_SYSTEM_CPU_SET_INFORMATION pGetSystemCpuSetInformation;
+
     /**
      If it's available on the current system, a pointer to GetSystemPowerStatus.
      */
@@ -8652,11 +9692,21 @@ typedef struct _YORI_KERNEL32_FUNCTIONS {
      */
     PLOAD_LIBRARY_EXW pLoadLibraryExW;
 
+    /**
+     If it's available on the current system, a pointer to OpenFileById.
+     */
+    POPEN_FILE_BY_ID pOpenFileById;
+
     /**
      If it's available on the current system, a pointer to OpenThread.
      */
     POPEN_THREAD pOpenThread;
 
+    /**
+     If it's available on the current system, a pointer to PostQueuedCompletionStatus.
+     */
+    PPOST_QUEUED_COMPLETION_STATUS pPostQueuedCompletionStatus;
+
     /**
      If it's available on the current system, a pointer to QueryFullProcessImageNameW.
      */
@@ -8667,6 +9717,16 @@ typedef struct _YORI_KERNEL32_FUNCTIONS {
      */
     PQUERY_INFORMATION_JOB_OBJECT pQueryInformationJobObject;
 
+    /**
+     If it's available on the current system, a pointer to QueryProcessCycleTime.
+     */
+    PQUERY_PROCESS_CYCLE_TIME pQueryProcessCycleTime;
+
+    /**
+     If it's available on the current system, a pointer to ReadDirectoryChangesW.
+     */
+    PREAD_DIRECTORY_CHANGESW pReadDirectoryChangesW;
+
     /**
      If it's available on the current system, a pointer to RegisterApplicationRestart.
      */
@@ -8712,11 +9772,26 @@ typedef struct _YORI_KERNEL32_FUNCTIONS {
      */
     PSET_INFORMATION_JOB_OBJECT pSetInformationJobObject;
 
+    /**
+     If it's available on the current system, a pointer to SetProcessInformation.
+     */
+    PSET_PROCESS_INFORMATION pSetProcessInformation;
+
     /**
      If it's available on the current system, a pointer to GetSystemPowerState.
      */
     PSET_SYSTEM_POWER_STATE pSetSystemPowerState;
 
+    /**
+     If it's available on the current system, a pointer to SetThreadGroupAffinity.
+     */
+    PSET_THREAD_GROUP_AFFINITY pSetThreadGroupAffinity;
+
+    /**
+     If it's available on the current system, a pointer to SetThreadSelectedCpuSets.
+     */
+    PSET_THREAD_SELECTED_CPU_SETS pSetThreadSelectedCpuSets;
+
     /**
      If it's available on the current system, a pointer to WritePrivateProfileStringW.
      */
@@ -8884,6 +9959,66 @@ EQUAL_SID(PSID, PSID);
  */
 typedef EQUAL_SID *PEQUAL_SID;
 
+/**
+ A handle to a registered event tracing provider.
+ */
+typedef ULONGLONG YORI_REGHANDLE;
+
+/**
+ A pointer to a handle to a registered event tracing provider.
+ */
+typedef YORI_REGHANDLE *PYORI_REGHANDLE;
+
+/**
+ The control code passed to an event tracing enable callback when a session
+ stops collecting events from the provider.
+ */
+#define YORI_EVENT_CONTROL_CODE_DISABLE_PROVIDER (0)
+
+/**
+ The control code passed to an event tracing enable callback when a session
+ starts collecting events from the provider.
+ */
+#define YORI_EVENT_CONTROL_CODE_ENABLE_PROVIDER  (1)
+
+/**
+ Prototype for a callback invoked when an event tracing session enables or
+ disables a provider.
+ */
+typedef
+VOID WINAPI
+YORI_ETW_ENABLE_CALLBACK(CONST GUID *, ULONG, UCHAR, ULONGLONG, ULONGLONG, PVOID, PVOID);
+
+/**
+ Prototype for a pointer to a callback invoked when an event tracing
+ session enables or disables a provider.
+ */
+typedef YORI_ETW_ENABLE_CALLBACK *PYORI_ETW_ENABLE_CALLBACK;
+
+/**
+ Prototype for the EventRegister function.
+ */
+typedef
+ULONG WINAPI
+EVENT_REGISTER(CONST GUID *, PYORI_ETW_ENABLE_CALLBACK, PVOID, PYORI_REGHANDLE);
+
+/**
+ Prototype for a pointer to the EventRegister function.
+ */
+typedef EVENT_REGISTER *PEVENT_REGISTER;
+
+/**
+ Prototype for the EventWriteString function.
+ */
+typedef
+ULONG WINAPI
+EVENT_WRITE_STRING(YORI_REGHANDLE, UCHAR, ULONGLONG, LPCWSTR);
+
+/**
+ Prototype for a pointer to the EventWriteString function.
+ */
+typedef EVENT_WRITE_STRING *PEVENT_WRITE_STRING;
+
 /**
  Prototype for the FreeSid function.
  */
@@ -8920,6 +10055,30 @@ GET_LENGTH_SID(PSID);
  */
 typedef GET_LENGTH_SID *PGET_LENGTH_SID;
 
+/**
+ A prototype for the GetSecurityDescriptorControl function.
+ */
+typedef
+BOOL WINAPI
+GET_SECURITY_DESCRIPTOR_CONTROL(PSECURITY_DESCRIPTOR, PSECURITY_DESCRIPTOR_CONTROL, LPDWORD);
+
+/**
+ Prototype for a pointer to the GetSecurityDescriptorControl function.
+ */
+typedef GET_SECURITY_DESCRIPTOR_CONTROL *PGET_SECURITY_DESCRIPTOR_CONTROL;
+
+/**
+ A prototype for the GetSecurityDescriptorDacl function.
+ */
+typedef
+BOOL WINAPI
+GET_SECURITY_DESCRIPTOR_DACL(PSECURITY_DESCRIPTOR, LPBOOL, PACL *, LPBOOL);
+
+/**
+ Prototype for a pointer to the GetSecurityDescriptorDacl function.
+ */
+typedef GET_SECURITY_DESCRIPTOR_DACL *PGET_SECURITY_DESCRIPTOR_DACL;
+
 /**
  A prototype for the GetSecurityDescriptorOwner function.
  */
@@ -9326,6 +10485,16 @@ typedef struct _YORI_ADVAPI32_FUNCTIONS {
      */
     PEQUAL_SID pEqualSid;
 
+    /**
+     If it's available on the current system, a pointer to EventRegister.
+     */
+    PEVENT_REGISTER pEventRegister;
+
+    /**
+     If it's available on the current system, a pointer to EventWriteString.
+     */
+    PEVENT_WRITE_STRING pEventWriteString;
+
     /**
      If it's available on the current system, a pointer to FreeSid.
      */
@@ -9341,6 +10510,16 @@ typedef struct _YORI_ADVAPI32_FUNCTIONS {
      */
     PGET_LENGTH_SID pGetLengthSid;
 
+    /**
+     If it's available on the current system, a pointer to GetSecurityDescriptorControl.
+     */
+    PGET_SECURITY_DESCRIPTOR_CONTROL pGetSecurityDescriptorControl;
+
+    /**
+     If it's available on the current system, a pointer to GetSecurityDescriptorDacl.
+     */
+    PGET_SECURITY_DESCRIPTOR_DACL pGetSecurityDescriptorDacl;
+
     /**
      If it's available on the current system, a pointer to GetSecurityDescriptorOwner.
      */
@@ -9652,38 +10831,171 @@ typedef struct _YORI_CABINET_FUNCTIONS {
 extern YORI_CABINET_FUNCTIONS DllCabinet;
 
 /**
- Prototype for the CryptBinaryToStringW function.
+ A prototype for the BCryptOpenAlgorithmProvider function.
  */
 typedef
-BOOL WINAPI
-CRYPT_BINARY_TO_STRINGW(LPBYTE, DWORD, DWORD, LPWSTR, PDWORD);
+LONG WINAPI
+BCRYPT_OPEN_ALGORITHM_PROVIDER(PVOID *, LPCWSTR, LPCWSTR, DWORD);
 
 /**
- Prototype for a pointer to the CryptBinaryToStringW function.
+ A prototype for a pointer to the BCryptOpenAlgorithmProvider function.
  */
-typedef CRYPT_BINARY_TO_STRINGW *PCRYPT_BINARY_TO_STRINGW;
+typedef BCRYPT_OPEN_ALGORITHM_PROVIDER *PBCRYPT_OPEN_ALGORITHM_PROVIDER;
 
 /**
- Prototype for the CryptStringToBinaryW function.
+ A prototype for the BCryptCloseAlgorithmProvider function.
  */
 typedef
-BOOL WINAPI
-CRYPT_STRING_TO_BINARYW(LPCWSTR, DWORD, DWORD, LPBYTE, PDWORD, PDWORD, PDWORD);
+LONG WINAPI
+BCRYPT_CLOSE_ALGORITHM_PROVIDER(PVOID, DWORD);
 
 /**
- Prototype for a pointer to the CryptStringToBinaryW function.
+ A prototype for a pointer to the BCryptCloseAlgorithmProvider function.
  */
-typedef CRYPT_STRING_TO_BINARYW *PCRYPT_STRING_TO_BINARYW;
+typedef BCRYPT_CLOSE_ALGORITHM_PROVIDER *PBCRYPT_CLOSE_ALGORITHM_PROVIDER;
 
 /**
- A structure containing optional function pointers to crypt32.dll exported
- functions which programs can operate without having hard dependencies on.
+ A prototype for the BCryptGetProperty function.
  */
-typedef struct _YORI_CRYPT32_FUNCTIONS {
-    /**
-     A handle to the Dll module.
-     */
-    HINSTANCE hDll;
+typedef
+LONG WINAPI
+BCRYPT_GET_PROPERTY(PVOID, LPCWSTR, PUCHAR, DWORD, PDWORD, DWORD);
+
+/**
+ A prototype for a pointer to the BCryptGetProperty function.
+ */
+typedef BCRYPT_GET_PROPERTY *PBCRYPT_GET_PROPERTY;
+
+/**
+ A prototype for the BCryptCreateHash function.
+ */
+typedef
+LONG WINAPI
+BCRYPT_CREATE_HASH(PVOID, PVOID *, PUCHAR, DWORD, PUCHAR, DWORD, DWORD);
+
+/**
+ A prototype for a pointer to the BCryptCreateHash function.
+ */
+typedef BCRYPT_CREATE_HASH *PBCRYPT_CREATE_HASH;
+
+/**
+ A prototype for the BCryptHashData function.
+ */
+typedef
+LONG WINAPI
+BCRYPT_HASH_DATA(PVOID, PUCHAR, DWORD, DWORD);
+
+/**
+ A prototype for a pointer to the BCryptHashData function.
+ */
+typedef BCRYPT_HASH_DATA *PBCRYPT_HASH_DATA;
+
+/**
+ A prototype for the BCryptFinishHash function.
+ */
+typedef
+LONG WINAPI
+BCRYPT_FINISH_HASH(PVOID, PUCHAR, DWORD, DWORD);
+
+/**
+ A prototype for a pointer to the BCryptFinishHash function.
+ */
+typedef BCRYPT_FINISH_HASH *PBCRYPT_FINISH_HASH;
+
+/**
+ A prototype for the BCryptDestroyHash function.
+ */
+typedef
+LONG WINAPI
+BCRYPT_DESTROY_HASH(PVOID);
+
+/**
+ A prototype for a pointer to the BCryptDestroyHash function.
+ */
+typedef BCRYPT_DESTROY_HASH *PBCRYPT_DESTROY_HASH;
+
+/**
+ A structure containing optional function pointers to bcrypt.dll exported
+ functions which programs can operate without having hard dependencies on.
+ */
+typedef struct _YORI_BCRYPT_FUNCTIONS {
+
+    /**
+     A handle to the Dll module.
+     */
+    HINSTANCE hDll;
+
+    /**
+     If it's available on the current system, a pointer to BCryptOpenAlgorithmProvider.
+     */
+    PBCRYPT_OPEN_ALGORITHM_PROVIDER pBCryptOpenAlgorithmProvider;
+
+    /**
+     If it's available on the current system, a pointer to BCryptCloseAlgorithmProvider.
+     */
+    PBCRYPT_CLOSE_ALGORITHM_PROVIDER pBCryptCloseAlgorithmProvider;
+
+    /**
+     If it's available on the current system, a pointer to BCryptGetProperty.
+     */
+    PBCRYPT_GET_PROPERTY pBCryptGetProperty;
+
+    /**
+     If it's available on the current system, a pointer to BCryptCreateHash.
+     */
+    PBCRYPT_CREATE_HASH pBCryptCreateHash;
+
+    /**
+     If it's available on the current system, a pointer to BCryptHashData.
+     */
+    PBCRYPT_HASH_DATA pBCryptHashData;
+
+    /**
+     If it's available on the current system, a pointer to BCryptFinishHash.
+     */
+    PBCRYPT_FINISH_HASH pBCryptFinishHash;
+
+    /**
+     If it's available on the current system, a pointer to BCryptDestroyHash.
+     */
+    PBCRYPT_DESTROY_HASH pBCryptDestroyHash;
+} YORI_BCRYPT_FUNCTIONS, *PYORI_BCRYPT_FUNCTIONS;
+
+extern YORI_BCRYPT_FUNCTIONS DllBCrypt;
+
+/**
+ Prototype for the CryptBinaryToStringW function.
+ */
+typedef
+BOOL WINAPI
+CRYPT_BINARY_TO_STRINGW(LPBYTE, DWORD, DWORD, LPWSTR, PDWORD);
+
+/**
+ Prototype for a pointer to the CryptBinaryToStringW function.
+ */
+typedef CRYPT_BINARY_TO_STRINGW *PCRYPT_BINARY_TO_STRINGW;
+
+/**
+ Prototype for the CryptStringToBinaryW function.
+ */
+typedef
+BOOL WINAPI
+CRYPT_STRING_TO_BINARYW(LPCWSTR, DWORD, DWORD, LPBYTE, PDWORD, PDWORD, PDWORD);
+
+/**
+ Prototype for a pointer to the CryptStringToBinaryW function.
+ */
+typedef CRYPT_STRING_TO_BINARYW *PCRYPT_STRING_TO_BINARYW;
+
+/**
+ A structure containing optional function pointers to crypt32.dll exported
+ functions which programs can operate without having hard dependencies on.
+ */
+typedef struct _YORI_CRYPT32_FUNCTIONS {
+    /**
+     A handle to the Dll module.
+     */
+    HINSTANCE hDll;
 
     /**
      If it's available on the current system, a pointer to CryptBinaryToStringW.
@@ -9760,6 +11072,339 @@ MINI_DUMP_WRITE_DUMP(HANDLE, DWORD, HANDLE, DWORD, PVOID, PVOID, PVOID);
  */
 typedef MINI_DUMP_WRITE_DUMP *PMINI_DUMP_WRITE_DUMP;
 
+/**
+ An address mode indicating a flat address, as used by StackWalk64.
+ */
+#define YORI_ADDRESS_MODE_FLAT (3)
+
+/**
+ Symbol option indicating that C++ symbols should be undecorated.
+ */
+#define YORI_SYMOPT_UNDNAME (0x00000002)
+
+/**
+ Symbol option indicating that symbols should not be loaded until they are
+ needed.
+ */
+#define YORI_SYMOPT_DEFERRED_LOADS (0x00000004)
+
+/**
+ An address used by StackWalk64.  This corresponds to ADDRESS64.
+ */
+typedef struct _YORI_ADDRESS64 {
+
+    /**
+     The offset of the address.
+     */
+    DWORDLONG Offset;
+
+    /**
+     The segment of the address, which is not used for flat addresses.
+     */
+    WORD Segment;
+
+    /**
+     The addressing mode, typically YORI_ADDRESS_MODE_FLAT.
+     */
+    DWORD Mode;
+} YORI_ADDRESS64, *PYORI_ADDRESS64;
+
+/**
+ Information used by StackWalk64 to walk kernel mode callbacks.  This
+ corresponds to KDHELP64, and is not used by user mode callers other than
+ to provide space for it.
+ */
+typedef struct _YORI_KDHELP64 {
+
+    /**
+     The address of the kernel thread object.
+     */
+    DWORDLONG Thread;
+
+    /**
+     The offset of the callback stack in the thread object.
+     */
+    DWORD ThCallbackStack;
+
+    /**
+     The offset of the callback backing store in the thread object.
+     */
+    DWORD ThCallbackBStore;
+
+    /**
+     The offset of the next callback frame in the callback stack.
+     */
+    DWORD NextCallback;
+
+    /**
+     The offset of the saved frame pointer in the callback stack.
+     */
+    DWORD FramePointer;
+
+    /**
+     The address of the kernel function that calls into user mode.
+     */
+    DWORDLONG KiCallUserMode;
+
+    /**
+     The address of the user mode callback dispatcher.
+     */
+    DWORDLONG KeUserCallbackDispatcher;
+
+    /**
+     The lowest kernel mode address.
+     */
+    DWORDLONG SystemRangeStart;
+
+    /**
+     The address of the user mode exception dispatcher.
+     */
+    DWORDLONG KiUserExceptionDispatcher;
+
+    /**
+     The base of the kernel stack.
+     */
+    DWORDLONG StackBase;
+
+    /**
+     The limit of the kernel stack.
+     */
+    DWORDLONG StackLimit;
+
+    /**
+     Reserved space.
+     */
+    DWORDLONG Reserved[5];
+} YORI_KDHELP64, *PYORI_KDHELP64;
+
+/**
+ A single frame returned by StackWalk64.  This corresponds to STACKFRAME64.
+ */
+typedef struct _YORI_STACKFRAME64 {
+
+    /**
+     The program counter of the frame.
+     */
+    YORI_ADDRESS64 AddrPC;
+
+    /**
+     The return address of the frame.
+     */
+    YORI_ADDRESS64 AddrReturn;
+
+    /**
+     The frame pointer of the frame.
+     */
+    YORI_ADDRESS64 AddrFrame;
+
+    /**
+     The stack pointer of the frame.
+     */
+    YORI_ADDRESS64 AddrStack;
+
+    /**
+     The stack pointer of the backing store, used on Itanium.
+     */
+    YORI_ADDRESS64 AddrBStore;
+
+    /**
+     Pointer to the function table entry for the frame, if any.
+     */
+    PVOID FuncTableEntry;
+
+    /**
+     Possible arguments to the function.
+     */
+    DWORDLONG Params[4];
+
+    /**
+     TRUE if this is a far call.
+     */
+    BOOL Far;
+
+    /**
+     TRUE if this is a virtual frame.
+     */
+    BOOL Virtual;
+
+    /**
+     Reserved space.
+     */
+    DWORDLONG Reserved[3];
+
+    /**
+     Information used to walk kernel mode callbacks.
+     */
+    YORI_KDHELP64 KdHelp;
+} YORI_STACKFRAME64, *PYORI_STACKFRAME64;
+
+/**
+ Information about a symbol returned by SymFromAddr.  This corresponds to
+ SYMBOL_INFO.  The name is stored as a variable length array at the end of
+ the structure.
+ */
+typedef struct _YORI_SYMBOL_INFO {
+
+    /**
+     The size of this structure, not including the name.
+     */
+    DWORD SizeOfStruct;
+
+    /**
+     A unique value for the type of the symbol.
+     */
+    DWORD TypeIndex;
+
+    /**
+     Reserved space.
+     */
+    DWORDLONG Reserved[2];
+
+    /**
+     A unique value for the symbol.
+     */
+    DWORD Index;
+
+    /**
+     The size of the symbol in bytes.
+     */
+    DWORD Size;
+
+    /**
+     The base address of the module containing the symbol.
+     */
+    DWORDLONG ModBase;
+
+    /**
+     Flags describing the symbol.
+     */
+    DWORD Flags;
+
+    /**
+     The value of a constant symbol.
+     */
+    DWORDLONG Value;
+
+    /**
+     The address of the symbol.
+     */
+    DWORDLONG Address;
+
+    /**
+     The register that contains the value of the symbol, if any.
+     */
+    DWORD Register;
+
+    /**
+     The scope of the symbol.
+     */
+    DWORD Scope;
+
+    /**
+     The type of the symbol.
+     */
+    DWORD Tag;
+
+    /**
+     The length of the name in characters, not including the terminator.
+     */
+    DWORD NameLen;
+
+    /**
+     The number of characters available in the name buffer.
+     */
+    DWORD MaxNameLen;
+
+    /**
+     The name of the symbol.
+     */
+    CHAR Name[1];
+} YORI_SYMBOL_INFO, *PYORI_SYMBOL_INFO;
+
+/**
+ A prototype for the SymFunctionTableAccess64 function.
+ */
+typedef
+PVOID WINAPI
+SYM_FUNCTION_TABLE_ACCESS64(HANDLE, DWORDLONG);
+
+/**
+ A prototype for a pointer to the SymFunctionTableAccess64 function.
+ */
+typedef SYM_FUNCTION_TABLE_ACCESS64 *PSYM_FUNCTION_TABLE_ACCESS64;
+
+/**
+ A prototype for the SymGetModuleBase64 function.
+ */
+typedef
+DWORDLONG WINAPI
+SYM_GET_MODULE_BASE64(HANDLE, DWORDLONG);
+
+/**
+ A prototype for a pointer to the SymGetModuleBase64 function.
+ */
+typedef SYM_GET_MODULE_BASE64 *PSYM_GET_MODULE_BASE64;
+
+/**
+ A prototype for the StackWalk64 function.
+ */
+typedef
+BOOL WINAPI
+STACK_WALK64(DWORD, HANDLE, HANDLE, PYORI_STACKFRAME64, PVOID, PVOID, PSYM_FUNCTION_TABLE_ACCESS64, PSYM_GET_MODULE_BASE64, PVOID);
+
+/**
+ A prototype for a pointer to the StackWalk64 function.
+ */
+typedef STACK_WALK64 *PSTACK_WALK64;
+
+/**
+ A prototype for the SymCleanup function.
+ */
+typedef
+BOOL WINAPI
+SYM_CLEANUP(HANDLE);
+
+/**
+ A prototype for a pointer to the SymCleanup function.
+ */
+typedef SYM_CLEANUP *PSYM_CLEANUP;
+
+/**
+ A prototype for the SymFromAddr function.
+ */
+typedef
+BOOL WINAPI
+SYM_FROM_ADDR(HANDLE, DWORDLONG, PDWORDLONG, PYORI_SYMBOL_INFO);
+
+/**
+ A prototype for a pointer to the SymFromAddr function.
+ */
+typedef SYM_FROM_ADDR *PSYM_FROM_ADDR;
+
+/**
+ A prototype for the SymInitialize function.
+ */
+typedef
+BOOL WINAPI
+SYM_INITIALIZE(HANDLE, LPCSTR, BOOL);
+
+/**
+ A prototype for a pointer to the SymInitialize function.
+ */
+typedef SYM_INITIALIZE *PSYM_INITIALIZE;
+
+/**
+ A prototype for the SymSetOptions function.
+ */
+typedef
+DWORD WINAPI
+SYM_SET_OPTIONS(DWORD);
+
+/**
+ A prototype for a pointer to the SymSetOptions function.
+ */
+typedef SYM_SET_OPTIONS *PSYM_SET_OPTIONS;
+
 /**
  A structure containing optional function pointers to dbghelp.dll exported
  functions which programs can operate without having hard dependencies on.
@@ -9774,6 +11419,43 @@ typedef struct _YORI_DBGHELP_FUNCTIONS {
      If it's available on the current system, a pointer to MiniDumpWriteDump.
      */
     PMINI_DUMP_WRITE_DUMP pMiniDumpWriteDump;
+
+    /**
+     If it's available on the current system, a pointer to StackWalk64.
+     */
+    PSTACK_WALK64 pStackWalk64;
+
+    /**
+     If it's available on the current system, a pointer to SymCleanup.
+     */
+    PSYM_CLEANUP pSymCleanup;
+
+    /**
+     If it's available on the current system, a pointer to SymFromAddr.
+     */
+    PSYM_FROM_ADDR pSymFromAddr;
+
+    /**
+     If it's available on the current system, a pointer to
+     SymFunctionTableAccess64.
+     */
+    PSYM_FUNCTION_TABLE_ACCESS64 pSymFunctionTableAccess64;
+
+    /**
+     If it's available on the current system, a pointer to
+     SymGetModuleBase64.
+     */
+    PSYM_GET_MODULE_BASE64 pSymGetModuleBase64;
+
+    /**
+     If it's available on the current system, a pointer to SymInitialize.
+     */
+    PSYM_INITIALIZE pSymInitialize;
+
+    /**
+     If it's available on the current system, a pointer to SymSetOptions.
+     */
+    PSYM_SET_OPTIONS pSymSetOptions;
 } YORI_DBGHELP_FUNCTIONS, *PYORI_DBGHELP_FUNCTIONS;
 
 extern YORI_DBGHELP_FUNCTIONS DllDbgHelp;
@@ -10263,6 +11945,18 @@ CLOSE_CLIPBOARD(VOID);
  */
 typedef CLOSE_CLIPBOARD *PCLOSE_CLIPBOARD;
 
+/**
+ A prototype for the CreateWindowExW function.
+ */
+typedef
+HWND WINAPI
+CREATE_WINDOW_EXW(DWORD, LPCWSTR, LPCWSTR, DWORD, INT, INT, INT, INT, HWND, HMENU, HINSTANCE, LPVOID);
+
+/**
+ A prototype for a pointer to the CreateWindowExW function.
+ */
+typedef CREATE_WINDOW_EXW *PCREATE_WINDOW_EXW;
+
 /**
  A prototype for the DdeClientTransaction function.
  */
@@ -10359,6 +12053,30 @@ DDE_UNINITIALIZE(DWORD);
  */
 typedef DDE_UNINITIALIZE *PDDE_UNINITIALIZE;
 
+/**
+ A prototype for the DefWindowProcW function.
+ */
+typedef
+LRESULT WINAPI
+DEF_WINDOW_PROCW(HWND, UINT, WPARAM, LPARAM);
+
+/**
+ A prototype for a pointer to the DefWindowProcW function.
+ */
+typedef DEF_WINDOW_PROCW *PDEF_WINDOW_PROCW;
+
+/**
+ A prototype for the DispatchMessageW function.
+ */
+typedef
+LRESULT WINAPI
+DISPATCH_MESSAGEW(CONST MSG *);
+
+/**
+ A prototype for a pointer to the DispatchMessageW function.
+ */
+typedef DISPATCH_MESSAGEW *PDISPATCH_MESSAGEW;
+
 /**
  A prototype for the DrawIconEx function.
  */
@@ -10491,6 +12209,18 @@ GET_CLIPBOARD_FORMAT_NAMEW(UINT, LPWSTR, DWORD);
  */
 typedef GET_CLIPBOARD_FORMAT_NAMEW *PGET_CLIPBOARD_FORMAT_NAMEW;
 
+/**
+ A prototype for the GetClipboardOwner function.
+ */
+typedef
+HWND WINAPI
+GET_CLIPBOARD_OWNER(VOID);
+
+/**
+ A prototype for a pointer to the GetClipboardOwner function.
+ */
+typedef GET_CLIPBOARD_OWNER *PGET_CLIPBOARD_OWNER;
+
 /**
  A prototype for the GetDesktopWindow function.
  */
@@ -10515,6 +12245,18 @@ GET_KEYBOARD_LAYOUT(DWORD);
  */
 typedef GET_KEYBOARD_LAYOUT *PGET_KEYBOARD_LAYOUT;
 
+/**
+ A prototype for the GetMessageW function.
+ */
+typedef
+BOOL WINAPI
+GET_MESSAGEW(LPMSG, HWND, UINT, UINT);
+
+/**
+ A prototype for a pointer to the GetMessageW function.
+ */
+typedef GET_MESSAGEW *PGET_MESSAGEW;
+
 /**
  A prototype for the GetMonitorInfoW function.
  */
@@ -10659,6 +12401,30 @@ OPEN_CLIPBOARD(HANDLE);
  */
 typedef OPEN_CLIPBOARD *POPEN_CLIPBOARD;
 
+/**
+ A prototype for the PostMessageW function.
+ */
+typedef
+BOOL WINAPI
+POST_MESSAGEW(HWND, UINT, WPARAM, LPARAM);
+
+/**
+ A prototype for a pointer to the PostMessageW function.
+ */
+typedef POST_MESSAGEW *PPOST_MESSAGEW;
+
+/**
+ A prototype for the RegisterClassW function.
+ */
+typedef
+ATOM WINAPI
+REGISTER_CLASSW(CONST WNDCLASSW *);
+
+/**
+ A prototype for a pointer to the RegisterClassW function.
+ */
+typedef REGISTER_CLASSW *PREGISTER_CLASSW;
+
 /**
  A prototype for the RegisterClipboardFormatW function.
  */
@@ -10859,6 +12625,11 @@ typedef struct _YORI_USER32_FUNCTIONS {
      */
     PCLOSE_CLIPBOARD pCloseClipboard;
 
+    /**
+     If it's available on the current system, a pointer to CreateWindowExW.
+     */
+    PCREATE_WINDOW_EXW pCreateWindowExW;
+
     /**
      If it's available on the current system, a pointer to DdeClientTransaction.
      */
@@ -10899,6 +12670,16 @@ typedef struct _YORI_USER32_FUNCTIONS {
      */
     PDDE_UNINITIALIZE pDdeUninitialize;
 
+    /**
+     If it's available on the current system, a pointer to DefWindowProcW.
+     */
+    PDEF_WINDOW_PROCW pDefWindowProcW;
+
+    /**
+     If it's available on the current system, a pointer to DispatchMessageW.
+     */
+    PDISPATCH_MESSAGEW pDispatchMessageW;
+
     /**
      If it's available on the current system, a pointer to DrawIconEx.
      */
@@ -10959,6 +12740,11 @@ typedef struct _YORI_USER32_FUNCTIONS {
      */
     PGET_CLIPBOARD_FORMAT_NAMEW pGetClipboardFormatNameW;
 
+    /**
+     If it's available on the current system, a pointer to GetClipboardOwner.
+     */
+    PGET_CLIPBOARD_OWNER pGetClipboardOwner;
+
     /**
      If it's available on the current system, a pointer to GetDesktopWindow.
      */
@@ -10969,6 +12755,11 @@ typedef struct _YORI_USER32_FUNCTIONS {
      */
     PGET_KEYBOARD_LAYOUT pGetKeyboardLayout;
 
+    /**
+     If it's available on the current system, a pointer to GetMessageW.
+     */
+    PGET_MESSAGEW pGetMessageW;
+
     /**
      If it's available on the current system, a pointer to GetMonitorInfoW
      */
@@ -11029,6 +12820,16 @@ typedef struct _YORI_USER32_FUNCTIONS {
      */
     POPEN_CLIPBOARD pOpenClipboard;
 
+    /**
+     If it's available on the current system, a pointer to PostMessageW.
+     */
+    PPOST_MESSAGEW pPostMessageW;
+
+    /**
+     If it's available on the current system, a pointer to RegisterClassW.
+     */
+    PREGISTER_CLASSW pRegisterClassW;
+
     /**
      If it's available on the current system, a pointer to RegisterClipboardFormatW.
      */
@@ -11283,6 +13084,18 @@ EXPAND_VIRTUAL_DISK(HANDLE, DWORD, PEXPAND_VIRTUAL_DISK_PARAMETERS, LPOVERLAPPED
  */
 typedef EXPAND_VIRTUAL_DISK *PEXPAND_VIRTUAL_DISK;
 
+/**
+ A prototype for the GetVirtualDiskOperationProgress function.
+ */
+typedef
+DWORD WINAPI
+GET_VIRTUAL_DISK_OPERATION_PROGRESS(HANDLE, LPOVERLAPPED, PVIRTUAL_DISK_PROGRESS);
+
+/**
+ A prototype for a pointer to the GetVirtualDiskOperationProgress function.
+ */
+typedef GET_VIRTUAL_DISK_OPERATION_PROGRESS *PGET_VIRTUAL_DISK_OPERATION_PROGRESS;
+
 /**
  A prototype for the GetVirtualDiskPhysicalPath function.
  */
@@ -11367,6 +13180,12 @@ typedef struct _YORI_VIRTDISK_FUNCTIONS {
      */
     PEXPAND_VIRTUAL_DISK pExpandVirtualDisk;
 
+    /**
+     If it's available on the current system, a pointer to
+     GetVirtualDiskOperationProgress.
+     */
+    PGET_VIRTUAL_DISK_OPERATION_PROGRESS pGetVirtualDiskOperationProgress;
+
     /**
      If it's available on the current system, a pointer to GetVirtualDiskPhysicalPath.
      */
@@ -192,8 +192,319 @@ typedef struct _YORI_LIB_BYTE_BUFFER {
      */
     YORI_MAX_UNSIGNED_T BytesPopulated;
 
+    /**
+     If nonzero, the buffer is a range of address space of this many bytes
+     reserved with VirtualAlloc, of which the first BytesAllocated bytes are
+     committed.  Growing the buffer within this range commits more memory
+     without moving existing data.  If zero, the buffer is allocated from
+     the heap.
+     */
+    YORI_MAX_UNSIGNED_T BytesReserved;
+
 } YORI_LIB_BYTE_BUFFER, *PYORI_LIB_BYTE_BUFFER;
 
+/**
+ A substring to search for which has been preprocessed so that it can be
+ located efficiently in many strings.
+ */
+typedef struct _YORI_LIB_SUBSTRING_SEARCH {
+
+    /**
+     The substring to search for.  This refers to the caller's buffer,
+     which must remain valid while the search is in use.
+     */
+    YORI_STRING Needle;
+
+    /**
+     TRUE if the search should be performed without regard to case.
+     */
+    BOOLEAN Insensitive;
+
+    /**
+     The last character of the substring, upcased if the search is case
+     insensitive.
+     */
+    TCHAR LastChar;
+
+    /**
+     For each value of the low 8 bits of a character, the number of
+     characters that the search can advance when that character is found
+     at the end of a candidate match that fails.
+     */
+    YORI_ALLOC_SIZE_T Shift[256];
+} YORI_LIB_SUBSTRING_SEARCH, *PYORI_LIB_SUBSTRING_SEARCH;
+
+/**
+ A single state within a set of substrings which have been preprocessed so
+ that they can be located together in one pass over a string.
+ */
+typedef struct _YORI_LIB_MULTI_SUBSTRING_NODE {
+
+    /**
+     The character which leads to this state from its parent.
+     */
+    TCHAR Char;
+
+    /**
+     The index of the first state which follows this one, or zero if no
+     state follows this one.
+     */
+    DWORD FirstChild;
+
+    /**
+     The index of the next state with the same parent, or zero if this is
+     the final state with this parent.
+     */
+    DWORD NextSibling;
+
+    /**
+     The index of the state describing the longest suffix of this state
+     which is also a prefix of a substring.  This is the state to continue
+     from when the next character does not follow this state.
+     */
+    DWORD Failure;
+
+    /**
+     The index of the next state along the failure chain which completes a
+     substring, or zero if there is none.
+     */
+    DWORD NextMatch;
+
+    /**
+     One more than the index of the substring completed by this state, or
+     zero if this state does not complete a substring.
+     */
+    YORI_ALLOC_SIZE_T MatchIndex;
+} YORI_LIB_MULTI_SUBSTRING_NODE, *PYORI_LIB_MULTI_SUBSTRING_NODE;
+
+/**
+ A set of substrings to search for which have been preprocessed so that the
+ first match of any of them can be located in a single pass over a string.
+ */
+typedef struct _YORI_LIB_MULTI_SUBSTRING_SEARCH {
+
+    /**
+     An array of states.  The first state is the initial state.
+     */
+    PYORI_LIB_MULTI_SUBSTRING_NODE Nodes;
+
+    /**
+     The number of states in the Nodes array.
+     */
+    DWORD NodeCount;
+
+    /**
+     The substrings to search for.  This refers to the caller's array,
+     which must remain valid while the search is in use.
+     */
+    PYORI_STRING MatchArray;
+
+    /**
+     The number of elements in MatchArray.
+     */
+    YORI_ALLOC_SIZE_T NumberMatches;
+
+    /**
+     The length of the longest substring in MatchArray.
+     */
+    YORI_ALLOC_SIZE_T LongestMatch;
+
+    /**
+     One more than the index of the first empty substring in MatchArray, or
+     zero if there is none.
+     */
+    YORI_ALLOC_SIZE_T EmptyMatch;
+
+    /**
+     TRUE if the search should be performed without regard to case.
+     */
+    BOOLEAN Insensitive;
+
+    /**
+     For characters below 0x100, the state which follows the initial state,
+     or zero if no substring starts with the character.  This avoids
+     searching the children of the initial state for every character.
+     */
+    DWORD RootChild[256];
+} YORI_LIB_MULTI_SUBSTRING_SEARCH, *PYORI_LIB_MULTI_SUBSTRING_SEARCH;
+
+/**
+ A regular expression compiled so that it can be searched for in many
+ strings.  The memory used while searching is allocated when the expression
+ is compiled, so an expression can only be searched for by one thread at a
+ time.
+ */
+typedef struct _YORI_LIB_REGEX {
+
+    /**
+     The tokens that the expression was parsed into, which are used to
+     match characters and to search if no program could be compiled.
+     */
+    PVOID Tokens;
+
+    /**
+     The compiled program, followed by the memory used to execute it.  This
+     is NULL if the expression uses constructs that require backtracking,
+     or the program would be too large.
+     */
+    PVOID Program;
+
+    /**
+     The number of instructions in the program.
+     */
+    DWORD InstructionCount;
+
+    /**
+     The number of capture groups, including the entire match, whose
+     location is recorded by the program.
+     */
+    WORD CaptureCount;
+
+    /**
+     Two lists of threads, each containing at most one thread per
+     instruction, where each thread is an instruction followed by its
+     capture slots.
+     */
+    PLONG_PTR ThreadLists;
+
+    /**
+     Capture slots for the thread being followed, followed by capture slots
+     for the match that has been found.
+     */
+    PLONG_PTR Captures;
+
+    /**
+     A stack used to follow instructions that don't consume characters.
+     */
+    PVOID Stack;
+
+    /**
+     For each instruction, the generation when a thread last reached it.
+     */
+    PDWORD Generations;
+
+    /**
+     The generation number of the position currently being evaluated.
+     */
+    DWORD Generation;
+} YORI_LIB_REGEX, *PYORI_LIB_REGEX;
+
+/**
+ Forward declaration of a single block of memory owned by an arena.
+ */
+typedef struct _YORI_LIB_ARENA_CHUNK *PYORI_LIB_ARENA_CHUNK;
+
+/**
+ An arena which hands out small allocations from large blocks, and releases
+ every allocation at once.
+ */
+typedef struct _YORI_LIB_ARENA {
+
+    /**
+     The most recently allocated chunk, which allocations are carved from.
+     This is the head of a singly linked list of chunks in use.
+     */
+    PYORI_LIB_ARENA_CHUNK Chunks;
+
+    /**
+     A singly linked list of chunks that were in use before the arena was
+     last reset, and can be reused without returning to the heap.
+     */
+    PYORI_LIB_ARENA_CHUNK FreeChunks;
+
+    /**
+     The usable size of each regular chunk, in bytes.
+     */
+    YORI_ALLOC_SIZE_T ChunkSize;
+
+} YORI_LIB_ARENA, *PYORI_LIB_ARENA;
+
+/**
+ State for calculating an XXH64 hash incrementally.
+ */
+typedef struct _YORI_LIB_XXHASH64_STATE {
+
+    /**
+     The four accumulators, each of which processes eight bytes of every
+     thirty two byte stripe.
+     */
+    DWORDLONG Accumulator[4];
+
+    /**
+     The seed that the hash was initialized with.
+     */
+    DWORDLONG Seed;
+
+    /**
+     The total number of bytes added to the hash.
+     */
+    DWORDLONG TotalLength;
+
+    /**
+     Bytes that have been added to the hash but do not yet form a complete
+     stripe.
+     */
+    UCHAR Buffer[32];
+
+    /**
+     The number of bytes in Buffer.
+     */
+    YORI_ALLOC_SIZE_T BytesBuffered;
+
+} YORI_LIB_XXHASH64_STATE, *PYORI_LIB_XXHASH64_STATE;
+
+/**
+ The number of characters generated by base64 encoding a specified number of
+ bytes.
+ */
+#define YORI_LIB_BASE64_ENCODED_LENGTH(Bytes) (((Bytes) + 2) / 3 * 4)
+
+/**
+ The largest number of bytes that can be generated by decoding a specified
+ number of base64 characters, allowing for characters carried from a
+ previous call.
+ */
+#define YORI_LIB_BASE64_DECODED_LENGTH(Chars) (((Chars) / 4 + 1) * 3)
+
+/**
+ State for decoding a base64 stream that is supplied in pieces.
+ */
+typedef struct _YORI_LIB_BASE64_DECODE_STATE {
+
+    /**
+     The six bit values of characters in the current group which have not
+     yet been converted into bytes.
+     */
+    DWORD Accumulator;
+
+    /**
+     The number of characters in the current group, including padding.
+     */
+    DWORD CharCount;
+
+    /**
+     The number of padding characters in the current group.
+     */
+    DWORD PadCount;
+
+    /**
+     TRUE once a padded group has been decoded, after which only whitespace
+     is valid.
+     */
+    BOOLEAN Complete;
+
+} YORI_LIB_BASE64_DECODE_STATE, *PYORI_LIB_BASE64_DECODE_STATE;
+
+/**
+ A prototype for a function which hashes a string for use in a hash table.
+ */
+typedef DWORD YORI_HASH_STRING_FN(DWORD InitialHash, PCYORI_STRING String);
+
+/**
+ A pointer to a function which hashes a string for use in a hash table.
+ */
+typedef YORI_HASH_STRING_FN *PYORI_HASH_STRING_FN;
+
 /**
  A structure describing an entry that is an element of a hash table.
  */
@@ -237,12 +548,222 @@ typedef struct _YORI_HASH_TABLE {
      */
     YORI_ALLOC_SIZE_T NumberBuckets;
 
+    /**
+     The function used to hash keys in this table.
+     */
+    PYORI_HASH_STRING_FN HashFunction;
+
     /**
      An array of hash buckets.
      */
     PYORI_HASH_BUCKET Buckets;
 } YORI_HASH_TABLE, *PYORI_HASH_TABLE;
 
+/**
+ Forward declaration of an open addressing hash table.
+ */
+typedef struct _YORI_OPEN_HASH_TABLE *PYORI_OPEN_HASH_TABLE;
+
+/**
+ A structure describing an entry that is an element of an open addressing
+ hash table.
+ */
+typedef struct _YORI_OPEN_HASH_ENTRY {
+
+    /**
+     A string that represents the key for the object within the table.
+     */
+    YORI_STRING Key;
+
+    /**
+     An opaque context block that can be used by the user of the hash
+     table to identify the entry.
+     */
+    PVOID Context;
+
+    /**
+     Pointer to the hash table which contains this entry.
+     */
+    PYORI_OPEN_HASH_TABLE HashTable;
+
+    /**
+     The index of the slot within the hash table which refers to this entry.
+     This changes as the table is resized or other entries are removed.
+     */
+    YORI_ALLOC_SIZE_T SlotIndex;
+
+} YORI_OPEN_HASH_ENTRY, *PYORI_OPEN_HASH_ENTRY;
+
+/**
+ A single slot within an open addressing hash table.  The hash of the key is
+ stored alongside the entry pointer so that probing only needs to examine
+ an entry when the full hash matches.
+ */
+typedef struct _YORI_OPEN_HASH_SLOT {
+
+    /**
+     The full hash of the entry's key.
+     */
+    DWORD Hash;
+
+    /**
+     Pointer to the entry occupying this slot, or NULL if the slot is empty.
+     */
+    PYORI_OPEN_HASH_ENTRY Entry;
+
+} YORI_OPEN_HASH_SLOT, *PYORI_OPEN_HASH_SLOT;
+
+/**
+ A structure describing an open addressing hash table which grows as
+ entries are inserted.
+ */
+typedef struct _YORI_OPEN_HASH_TABLE {
+
+    /**
+     The number of slots in the hash table.  This is always a power of two.
+     */
+    YORI_ALLOC_SIZE_T NumberSlots;
+
+    /**
+     The number of slots which are currently occupied.
+     */
+    YORI_ALLOC_SIZE_T NumberEntries;
+
+    /**
+     The function used to hash keys in this table.  Since the low bits of
+     the hash are used to select a slot, this function should distribute
+     well in its low bits.
+     */
+    PYORI_HASH_STRING_FN HashFunction;
+
+    /**
+     An array of slots.
+     */
+    PYORI_OPEN_HASH_SLOT Slots;
+} YORI_OPEN_HASH_TABLE;
+
+/**
+ A string which has been interned into an atom table.  Every request to
+ intern a string which compares equal, ignoring case, to an existing atom
+ returns that atom, so two atoms from the same table are equal if and only
+ if they are the same pointer.  The string is immutable.  A caller that needs
+ the characters to outlive its reference on the atom can clone String with
+ @ref YoriLibCloneString .
+ */
+typedef struct _YORI_LIB_ATOM {
+
+    /**
+     The entry for this atom within the atom table's hash table.  The key of
+     this entry refers to the same memory as String.
+     */
+    YORI_OPEN_HASH_ENTRY HashEntry;
+
+    /**
+     The link of this atom within the list of all atoms in the table.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The interned string.  This is NULL terminated.
+     */
+    YORI_STRING String;
+
+    /**
+     A case sensitive hash of the string, from
+     @ref YoriLibHashStringCaseSensitiveFnv32 .
+     */
+    DWORD Hash;
+
+    /**
+     A case insensitive hash of the string, from
+     @ref YoriLibHashStringFnv32 .
+     */
+    DWORD FoldedHash;
+
+    /**
+     The number of references to the atom which have been returned from
+     @ref YoriLibInternString or taken with @ref YoriLibReferenceAtom .
+     When this reaches zero the atom is removed from the table.
+     */
+    DWORD ReferenceCount;
+
+} YORI_LIB_ATOM, *PYORI_LIB_ATOM;
+
+/**
+ A table of interned strings.  The table is not synchronized, so callers
+ that share one across threads need to provide their own lock.
+ */
+typedef struct _YORI_LIB_ATOM_TABLE {
+
+    /**
+     A hash table of atoms, keyed by the interned string.
+     */
+    PYORI_OPEN_HASH_TABLE HashTable;
+
+    /**
+     A list of every atom in the table, used to facilitate bulk delete.
+     */
+    YORI_LIST_ENTRY AtomList;
+
+} YORI_LIB_ATOM_TABLE, *PYORI_LIB_ATOM_TABLE;
+
+/**
+ A single component within a semicolon delimited environment variable, such
+ as one directory within PATH.
+ */
+typedef struct _YORI_ENV_COMPONENT {
+
+    /**
+     The link of this component within the ordered list of components.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The entry for this component within the list's hash table.  The key of
+     this entry refers to the same memory as Value.
+     */
+    YORI_OPEN_HASH_ENTRY HashEntry;
+
+    /**
+     The text of the component.  This is NULL terminated and is contained
+     within the same allocation as this structure.
+     */
+    YORI_STRING Value;
+
+} YORI_ENV_COMPONENT, *PYORI_ENV_COMPONENT;
+
+/**
+ A parsed form of a semicolon delimited environment variable.  Components
+ are kept in order and indexed by a case insensitive hash, so that a series
+ of additions, removals and moves can each be performed without scanning
+ or rebuilding the string, which is only generated once all of the edits
+ have been made.
+ */
+typedef struct _YORI_ENV_COMPONENT_LIST {
+
+    /**
+     The list of components, in the order they appear in the variable.
+     */
+    YORI_LIST_ENTRY ComponentList;
+
+    /**
+     A hash table of components, keyed by the text of the component.
+     */
+    PYORI_OPEN_HASH_TABLE HashTable;
+
+    /**
+     The number of components in the list.
+     */
+    YORI_ALLOC_SIZE_T ComponentCount;
+
+    /**
+     The total number of characters in all components, not including
+     seperators.  This is used to size the buffer when generating a string.
+     */
+    YORI_MAX_UNSIGNED_T TotalChars;
+
+} YORI_ENV_COMPONENT_LIST, *PYORI_ENV_COMPONENT_LIST;
+
 #pragma pack(push, 1)
 
 /**
@@ -475,6 +996,17 @@ typedef struct _YORI_FILE_INFO {
      Pointer to the extension within the file name string.
      */
     TCHAR *       Extension;
+
+    /**
+     A handle to the file shared by collection functions while the entry is
+     being populated, or NULL if each should open the file.
+     */
+    HANDLE        SharedHandle;
+
+    /**
+     The access that SharedHandle was opened with.
+     */
+    DWORD         SharedHandleAccess;
 } YORI_FILE_INFO, *PYORI_FILE_INFO;
 
 /**
@@ -553,6 +1085,199 @@ YoriLibSetAirplaneMode(
     __in BOOLEAN AirplaneModeEnabled
     );
 
+// *** ARENA.C ***
+
+VOID
+YoriLibArenaCreate(
+    __out PYORI_LIB_ARENA Arena,
+    __in YORI_ALLOC_SIZE_T ChunkSize
+    );
+
+__success(return != NULL)
+PVOID
+YoriLibArenaAlloc(
+    __inout PYORI_LIB_ARENA Arena,
+    __in YORI_ALLOC_SIZE_T SizeInBytes
+    );
+
+__success(return)
+BOOL
+YoriLibArenaAllocateString(
+    __inout PYORI_LIB_ARENA Arena,
+    __out PYORI_STRING String,
+    __in YORI_ALLOC_SIZE_T CharsToAllocate
+    );
+
+VOID
+YoriLibArenaReset(
+    __inout PYORI_LIB_ARENA Arena
+    );
+
+VOID
+YoriLibArenaDestroy(
+    __inout PYORI_LIB_ARENA Arena
+    );
+
+// *** ASYNCIO.C ***
+
+/**
+ A single buffer used to perform overlapped IO.
+ */
+typedef struct _YORI_LIB_ASYNC_IO_BUFFER {
+
+    /**
+     The overlapped structure for IO into this buffer, including the event
+     signalled when the IO completes.
+     */
+    OVERLAPPED Overlapped;
+
+    /**
+     Pointer to the buffer.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The number of bytes requested by the most recent write from this
+     buffer.
+     */
+    DWORD Length;
+
+    /**
+     TRUE if IO into this buffer is in progress.
+     */
+    BOOLEAN Active;
+
+} YORI_LIB_ASYNC_IO_BUFFER, *PYORI_LIB_ASYNC_IO_BUFFER;
+
+/**
+ A context for reading or writing a file sequentially while keeping several
+ IOs in flight.  Waits for IO also wait for the cancel event, so an
+ operation stops as soon as the user presses Ctrl+C.
+ */
+typedef struct _YORI_LIB_ASYNC_IO {
+
+    /**
+     The file being read or written.
+     */
+    HANDLE FileHandle;
+
+    /**
+     An array of BufferCount buffers.  Buffers are used in turn, so the
+     order of IO within the file follows the order of the array.
+     */
+    PYORI_LIB_ASYNC_IO_BUFFER Buffers;
+
+    /**
+     A single page aligned allocation containing the data for every buffer.
+     */
+    PUCHAR BufferMemory;
+
+    /**
+     The number of elements in the Buffers array.
+     */
+    DWORD BufferCount;
+
+    /**
+     The size of each buffer, in bytes.
+     */
+    DWORD BufferSize;
+
+    /**
+     The index of the buffer containing the earliest data in the file that
+     has not yet been returned to the caller when reading, or the next
+     buffer to fill when writing.
+     */
+    DWORD Oldest;
+
+    /**
+     The number of buffers with IO in progress.
+     */
+    DWORD ActiveCount;
+
+    /**
+     The first error encountered.  Once set, no further IO is performed.
+     */
+    DWORD Error;
+
+    /**
+     The offset within the file of the next IO to issue.
+     */
+    LARGE_INTEGER NextOffset;
+
+    /**
+     TRUE if the file is being written, FALSE if it is being read.
+     */
+    BOOLEAN Writing;
+
+    /**
+     TRUE once a read has reached the end of the file, so no more reads are
+     issued.
+     */
+    BOOLEAN EndOfFile;
+
+    /**
+     TRUE if the oldest buffer has been returned to the caller and should be
+     used for another read on the next request.
+     */
+    BOOLEAN CallerOwnsBuffer;
+
+} YORI_LIB_ASYNC_IO, *PYORI_LIB_ASYNC_IO;
+
+__success(return)
+BOOL
+YoriLibAsyncIoInitialize(
+    __out PYORI_LIB_ASYNC_IO AsyncIo,
+    __in DWORD BufferCount,
+    __in DWORD BufferSize
+    );
+
+VOID
+YoriLibAsyncIoCleanup(
+    __in PYORI_LIB_ASYNC_IO AsyncIo
+    );
+
+__success(return)
+BOOL
+YoriLibAsyncReadBegin(
+    __in PYORI_LIB_ASYNC_IO AsyncIo,
+    __in HANDLE FileHandle,
+    __in_opt PLARGE_INTEGER Offset
+    );
+
+__success(return)
+BOOL
+YoriLibAsyncRead(
+    __in PYORI_LIB_ASYNC_IO AsyncIo,
+    __out PUCHAR * Data,
+    __out PDWORD BytesRead
+    );
+
+VOID
+YoriLibAsyncWriteBegin(
+    __in PYORI_LIB_ASYNC_IO AsyncIo,
+    __in HANDLE FileHandle,
+    __in_opt PLARGE_INTEGER Offset
+    );
+
+__success(return != NULL)
+PUCHAR
+YoriLibAsyncWriteGetBuffer(
+    __in PYORI_LIB_ASYNC_IO AsyncIo
+    );
+
+__success(return)
+BOOL
+YoriLibAsyncWrite(
+    __in PYORI_LIB_ASYNC_IO AsyncIo,
+    __in DWORD Length
+    );
+
+__success(return)
+BOOL
+YoriLibAsyncIoComplete(
+    __in PYORI_LIB_ASYNC_IO AsyncIo
+    );
+
 // *** BARGRAPH.C ***
 
 BOOLEAN
@@ -563,6 +1288,38 @@ YoriLibDisplayBarGraph(
     __in DWORD RedThreshold
     );
 
+// *** BASE64.C ***
+
+YORI_ALLOC_SIZE_T
+YoriLibBase64Encode(
+    __in CONST UCHAR * Input,
+    __in YORI_ALLOC_SIZE_T InputLength,
+    __out_ecount(YORI_LIB_BASE64_ENCODED_LENGTH(InputLength)) PUCHAR Output
+    );
+
+VOID
+YoriLibBase64DecodeInitialize(
+    __out PYORI_LIB_BASE64_DECODE_STATE State
+    );
+
+__success(return)
+BOOLEAN
+YoriLibBase64Decode(
+    __inout PYORI_LIB_BASE64_DECODE_STATE State,
+    __in CONST UCHAR * Input,
+    __in YORI_ALLOC_SIZE_T InputLength,
+    __out_ecount(YORI_LIB_BASE64_DECODED_LENGTH(InputLength)) PUCHAR Output,
+    __out PYORI_ALLOC_SIZE_T BytesWritten
+    );
+
+__success(return)
+BOOLEAN
+YoriLibBase64DecodeFinalize(
+    __inout PYORI_LIB_BASE64_DECODE_STATE State,
+    __out_ecount(3) PUCHAR Output,
+    __out PYORI_ALLOC_SIZE_T BytesWritten
+    );
+
 // *** BUILTIN.C ***
 
 BOOL
@@ -583,6 +1340,12 @@ YoriLibByteBufferInitialize(
     __in YORI_MAX_UNSIGNED_T InitialSize
     );
 
+BOOL
+YoriLibByteBufferInitializeReserved(
+    __out PYORI_LIB_BYTE_BUFFER Buffer,
+    __in YORI_MAX_UNSIGNED_T MaximumSize
+    );
+
 VOID
 YoriLibByteBufferCleanup(
     __in PYORI_LIB_BYTE_BUFFER Buffer
@@ -718,6 +1481,40 @@ YoriLibSetInputConsoleModeWithoutExtended(
     __in DWORD ConsoleMode
     );
 
+// *** CKSUM.C ***
+
+DWORD
+YoriLibCrc32c(
+    __in DWORD Crc,
+    __in PVOID Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    );
+
+VOID
+YoriLibXxHash64Initialize(
+    __out PYORI_LIB_XXHASH64_STATE State,
+    __in DWORDLONG Seed
+    );
+
+VOID
+YoriLibXxHash64Update(
+    __inout PYORI_LIB_XXHASH64_STATE State,
+    __in PVOID Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    );
+
+DWORDLONG
+YoriLibXxHash64Finalize(
+    __in PYORI_LIB_XXHASH64_STATE State
+    );
+
+DWORD
+YoriLibPeChecksumUpdate(
+    __in DWORD Sum,
+    __in PVOID Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    );
+
 // *** CLIP.C ***
 
 DWORD
@@ -726,6 +1523,25 @@ YoriLibGetUsableEncoding(VOID);
 BOOLEAN
 YoriLibOpenClipboard(VOID);
 
+BOOLEAN
+YoriLibOpenClipboardForWindow(
+    __in HWND Window
+    );
+
+__success(return)
+BOOL
+YoriLibBuildTextClipboardBuffer(
+    __in PYORI_STRING TextToCopy,
+    __out PHANDLE HandleForClipboard
+    );
+
+__success(return)
+BOOL
+YoriLibBuildRtfClipboardBuffer(
+    __in PYORI_STRING TextToCopy,
+    __out PHANDLE HandleForClipboard
+    );
+
 __success(return)
 BOOL
 YoriLibBuildHtmlClipboardBuffer(
@@ -983,14 +1799,205 @@ YoriLibSetConsoleDisplayMode(
 
 // *** CPUINFO.C ***
 
+/**
+ A class of work that a thread performs, used to select suitable logical
+ processors.
+ */
+typedef enum _YORI_LIB_CPU_CLASS {
+    YoriLibCpuClassAny = 0,
+    YoriLibCpuClassPerformance = 1,
+    YoriLibCpuClassEfficiency = 2
+} YORI_LIB_CPU_CLASS;
+
+/**
+ Information about a single logical processor.
+ */
+typedef struct _YORI_LIB_CPU_PROCESSOR {
+
+    /**
+     The CPU set identifier of the logical processor, if CPU sets are
+     supported.
+     */
+    DWORD CpuSetId;
+
+    /**
+     The processor group containing the logical processor.
+     */
+    WORD Group;
+
+    /**
+     The index of the logical processor within its group.
+     */
+    UCHAR Number;
+
+    /**
+     The efficiency class of the core containing the logical processor.
+     Higher values indicate higher performance and lower efficiency.
+     */
+    UCHAR EfficiencyClass;
+
+    /**
+     The NUMA node containing the logical processor.
+     */
+    DWORD NumaNode;
+
+    /**
+     An index of the core containing the logical processor.  Logical
+     processors with the same index share a core.
+     */
+    DWORD Core;
+} YORI_LIB_CPU_PROCESSOR, *PYORI_LIB_CPU_PROCESSOR;
+
+/**
+ Information about the logical processors in the system.
+ */
+typedef struct _YORI_LIB_CPU_TOPOLOGY {
+
+    /**
+     The number of logical processors in the system.
+     */
+    DWORD ProcessorCount;
+
+    /**
+     The number of cores in the system.
+     */
+    DWORD CoreCount;
+
+    /**
+     The number of NUMA nodes in the system.
+     */
+    DWORD NumaNodeCount;
+
+    /**
+     The number of processor groups in the system.
+     */
+    WORD GroupCount;
+
+    /**
+     The highest efficiency class of any core.  If this is zero, the system
+     is homogenous.
+     */
+    UCHAR HighestEfficiencyClass;
+
+    /**
+     TRUE if every logical processor has a CPU set identifier.
+     */
+    BOOLEAN HaveCpuSets;
+
+    /**
+     An array of ProcessorCount logical processors, in group order.
+     */
+    YORI_LIB_CPU_PROCESSOR Processors[ANYSIZE_ARRAY];
+} YORI_LIB_CPU_TOPOLOGY, *PYORI_LIB_CPU_TOPOLOGY;
+
+DWORD
+YoriLibQueryLogicalProcessorInformation(
+    __in YORI_LOGICAL_PROCESSOR_RELATIONSHIP Relationship,
+    __out PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *ProcInfo,
+    __out PDWORD BytesInBuffer
+    );
+
+DWORD
+YoriLibCountCoreLogicalProcessors(
+    __in PYORI_PROCESSOR_RELATIONSHIP Core
+    );
+
 VOID
 YoriLibQueryCpuCount(
     __out PWORD PerformanceLogicalProcessors,
     __out PWORD EfficiencyLogicalProcessors
     );
 
+__success(return)
+BOOLEAN
+YoriLibQueryCpuTopology(
+    __out PYORI_LIB_CPU_TOPOLOGY *Topology
+    );
+
+BOOLEAN
+YoriLibPlaceThread(
+    __in HANDLE hThread,
+    __in PYORI_LIB_CPU_TOPOLOGY Topology,
+    __in YORI_LIB_CPU_CLASS CpuClass,
+    __in DWORD WorkerIndex
+    );
+
+__success(return)
+BOOLEAN
+YoriLibGetCpuClassAffinity(
+    __in PYORI_LIB_CPU_TOPOLOGY Topology,
+    __in YORI_LIB_CPU_CLASS CpuClass,
+    __out PYORI_PROCESSOR_GROUP_AFFINITY Affinity
+    );
+
 // *** CSHOT.C ***
 
+/**
+ State carried between incremental captures of the console window.
+ */
+typedef struct _YORILIB_CONSOLE_SNAPSHOT {
+
+    /**
+     The dimensions of the window most recently captured.
+     */
+    COORD Size;
+
+    /**
+     The cursor position most recently emitted, relative to the window.
+     */
+    COORD CursorPosition;
+
+    /**
+     The number of cells allocated in each of Cells and NewCells.
+     */
+    DWORD CellsAllocated;
+
+    /**
+     The cells most recently captured, containing Size.X * Size.Y elements.
+     NULL if no capture has been performed.
+     */
+    PCHAR_INFO Cells;
+
+    /**
+     A buffer to read the current console contents into before they are
+     compared against Cells.
+     */
+    PCHAR_INFO NewCells;
+
+    /**
+     A string used to build the VT stream describing changes.  This is
+     retained between captures to avoid reallocating it.
+     */
+    YORI_STRING Output;
+
+    /**
+     The attribute most recently emitted to the target.
+     */
+    WORD LastAttribute;
+
+} YORILIB_CONSOLE_SNAPSHOT, *PYORILIB_CONSOLE_SNAPSHOT;
+
+BOOL
+YoriLibReadConsoleRegion(
+    __in HANDLE hConsole,
+    __in PSMALL_RECT Region,
+    __out PCHAR_INFO Buffer
+    );
+
+BOOL
+YoriLibCshotEnsureSpace(
+    __inout PYORI_STRING String,
+    __in DWORD ExtraChars
+    );
+
+BOOL
+YoriLibAppendVtStringForCells(
+    __inout PYORI_STRING String,
+    __in PCHAR_INFO Cells,
+    __in DWORD Count,
+    __inout PWORD LastAttribute
+    );
+
 BOOL
 YoriLibRewriteConsoleContents(
     __in HANDLE hTarget,
@@ -998,6 +2005,23 @@ YoriLibRewriteConsoleContents(
     __in DWORD SkipCount
     );
 
+VOID
+YoriLibInitializeConsoleSnapshot(
+    __out PYORILIB_CONSOLE_SNAPSHOT Snapshot
+    );
+
+VOID
+YoriLibCleanupConsoleSnapshot(
+    __inout PYORILIB_CONSOLE_SNAPSHOT Snapshot
+    );
+
+BOOL
+YoriLibRewriteConsoleChanges(
+    __in HANDLE hConsole,
+    __in HANDLE hTarget,
+    __inout PYORILIB_CONSOLE_SNAPSHOT Snapshot
+    );
+
 BOOL
 YoriLibGenerateVtStringFromConsoleBuffers(
     __inout PYORI_STRING String,
@@ -1249,6 +2273,32 @@ YoriLibDbgRealAssert(
 #define ASSERT(x)
 #endif
 
+// *** DELTA.C ***
+
+__success(return)
+BOOL
+YoriLibDeltaHashFile(
+    __in PCYORI_STRING FileName,
+    __out PDWORDLONG FileSize,
+    __out PDWORDLONG Hash
+    );
+
+__success(return)
+BOOL
+YoriLibCreateDelta(
+    __in PCYORI_STRING SourceFile,
+    __in PCYORI_STRING TargetFile,
+    __in PCYORI_STRING DeltaFile
+    );
+
+__success(return)
+BOOL
+YoriLibApplyDelta(
+    __in PCYORI_STRING SourceFile,
+    __in PCYORI_STRING DeltaFile,
+    __in PCYORI_STRING TargetFile
+    );
+
 // *** DYLD.C ***
 
 __success(return)
@@ -1263,6 +2313,23 @@ YoriLibLoadLibraryFromSystemDirectory(
     __in LPCTSTR DllName
     );
 
+VOID
+YoriLibDisplayDllProfile(VOID);
+
+#if YORI_DLL_PROFILE
+FARPROC
+YoriLibDllProfileGetProcAddress(
+    __in HMODULE hDll,
+    __in LPCSTR FnName
+    );
+
+/**
+ When profiling DLL loads, route function resolution through a routine that
+ records the time spent and the number of functions found in each module.
+ */
+#define GetProcAddress YoriLibDllProfileGetProcAddress
+#endif
+
 BOOL
 YoriLibLoadNtDllFunctions(VOID);
 
@@ -1275,6 +2342,9 @@ YoriLibLoadAdvApi32Functions(VOID);
 BOOL
 YoriLibLoadCabinetFunctions(VOID);
 
+BOOL
+YoriLibLoadBCryptFunctions(VOID);
+
 BOOL
 YoriLibLoadCrypt32Functions(VOID);
 
@@ -1420,6 +2490,67 @@ YoriLibRemoveEnvComponent(
     __in PYORI_STRING ComponentToRemove
     );
 
+__success(return)
+BOOL
+YoriLibEnvCompInitialize(
+    __out PYORI_ENV_COMPONENT_LIST List
+    );
+
+VOID
+YoriLibEnvCompCleanup(
+    __in PYORI_ENV_COMPONENT_LIST List
+    );
+
+__success(return)
+BOOL
+YoriLibEnvCompAdd(
+    __in PYORI_ENV_COMPONENT_LIST List,
+    __in PCYORI_STRING NewComponent,
+    __in BOOL InsertAtFront
+    );
+
+__success(return)
+BOOL
+YoriLibEnvCompMove(
+    __in PYORI_ENV_COMPONENT_LIST List,
+    __in PCYORI_STRING Component,
+    __in BOOL MoveToFront
+    );
+
+BOOL
+YoriLibEnvCompRemove(
+    __in PYORI_ENV_COMPONENT_LIST List,
+    __in PCYORI_STRING ComponentToRemove
+    );
+
+__success(return)
+BOOL
+YoriLibEnvCompLoadString(
+    __in PYORI_ENV_COMPONENT_LIST List,
+    __in PCYORI_STRING String
+    );
+
+__success(return)
+BOOL
+YoriLibEnvCompLoadVariable(
+    __in PYORI_ENV_COMPONENT_LIST List,
+    __in LPCTSTR EnvironmentVariable
+    );
+
+__success(return)
+BOOL
+YoriLibEnvCompBuildString(
+    __in PYORI_ENV_COMPONENT_LIST List,
+    __out PYORI_STRING Result
+    );
+
+__success(return)
+BOOL
+YoriLibEnvCompApplyToVariable(
+    __in PYORI_ENV_COMPONENT_LIST List,
+    __in LPCTSTR EnvironmentVariable
+    );
+
 // *** FILECOMP.C ***
 
 /**
@@ -1449,9 +2580,24 @@ typedef union _YORILIB_COMPRESS_ALGORITHM {
  */
 typedef struct _YORILIB_COMPRESS_CONTEXT {
     /**
-     The list of files requiring compression.
+     The list of volumes containing files requiring compression.  Each
+     volume has its own queue of files and its own limit on the number of
+     files being processed concurrently.
+     */
+    YORI_LIST_ENTRY VolumeList;
+
+    /**
+     The parent directory of the most recently queued file.  Files are
+     typically queued a directory at a time, so this avoids resolving the
+     volume for every file.
+     */
+    YORI_STRING LastParentDirectory;
+
+    /**
+     The volume containing the most recently queued file.  The structure
+     pointed to is private to filecomp.c.
      */
-    YORI_LIST_ENTRY PendingList;
+    PVOID LastVolume;
 
     /**
      A mutex to synchronize the list of files requiring compression.
@@ -1494,10 +2640,22 @@ typedef struct _YORILIB_COMPRESS_CONTEXT {
     YORI_ALLOC_SIZE_T ThreadsAllocated;
 
     /**
-     The number of items currently queued in the list.
+     The number of items currently queued across all volumes.
      */
     YORI_ALLOC_SIZE_T ItemsQueued;
 
+    /**
+     The number of files that were not compressed because their format is
+     known to be compressed already, or because a sample of their contents
+     did not compress well.  This is updated by multiple threads.
+     */
+    DWORD FilesSkippedIncompressible;
+
+    /**
+     If TRUE, files are compressed even if they appear to be incompressible.
+     */
+    BOOL CompressIncompressible;
+
     /**
      If TRUE, output is generated describing thread creation and throttling.
      */
@@ -1585,37 +2743,143 @@ typedef YORILIB_FILE_ENUM_FN *PYORILIB_FILE_ENUM_FN;
  */
 #define YORILIB_FILEENUM_RECURSE_PRESERVE_WILD   0x00000010
 
-/**
- Indicates that basic file name expansion should be used only.
- */
-#define YORILIB_FILEENUM_BASIC_EXPANSION         0x00000020
+/**
+ Indicates that basic file name expansion should be used only.
+ */
+#define YORILIB_FILEENUM_BASIC_EXPANSION         0x00000020
+
+/**
+ Indicates that symbolic links and mount points should not be traversed
+ when recursing.
+ */
+#define YORILIB_FILEENUM_NO_LINK_TRAVERSE        0x00000040
+
+/**
+ Include dot and dotdot files during enumerate.
+ */
+#define YORILIB_FILEENUM_INCLUDE_DOTFILES        0x00000080
+
+/**
+ If the top level object is a directory, enumerate its children without
+ requiring explicit wildcards.
+ */
+#define YORILIB_FILEENUM_DIRECTORY_CONTENTS      0x00000100
+
+/**
+ When recursing, enumerate child directories concurrently on multiple
+ threads.  Callbacks are serialized unless
+ YORILIB_FILEENUM_CONCURRENT_CALLBACKS is also specified, but objects from
+ different directories may be reported in any order.
+ */
+#define YORILIB_FILEENUM_PARALLEL                0x00000200
+
+/**
+ When performing a parallel enumerate, allow callbacks to be invoked
+ concurrently on multiple threads.  The caller is responsible for any
+ synchronization required by its callbacks.
+ */
+#define YORILIB_FILEENUM_CONCURRENT_CALLBACKS    0x00000400
+
+/**
+ The caller does not require short file names.  This allows the enumerate
+ to request less information from the file system and use larger buffers,
+ which substantially reduces the number of round trips on network volumes.
+ When specified, cAlternateFileName may be empty.
+ */
+#define YORILIB_FILEENUM_BASIC_INFO              0x00000800
+
+HANDLE
+YoriLibFileEnumFindFirstFile(
+    __in LPCTSTR FileSpec,
+    __in WORD MatchFlags,
+    __out PWIN32_FIND_DATA FindData
+    );
+
+__success(return)
+BOOL
+YoriLibForEachFile(
+    __in PYORI_STRING FileSpec,
+    __in WORD MatchFlags,
+    __in DWORD Depth,
+    __in PYORILIB_FILE_ENUM_FN Callback,
+    __in_opt PYORILIB_FILE_ENUM_ERROR_FN ErrorCallback,
+    __in_opt PVOID Context
+    );
+
+/**
+ A wildcard expression which has been processed so that it can be compared
+ against many file names without reparsing it.  The expression consists of
+ a prefix which must be found at the start of the file name, a suffix which
+ must be found at the end, and any literal segments between them which are
+ separated by '*' characters.
+ */
+typedef struct _YORI_LIB_FILE_MATCH_EXPRESSION {
+
+    /**
+     The wildcard expression.  This is not copied, so the caller must keep
+     the string valid while the compiled expression is in use.
+     */
+    YORI_STRING Wildcard;
+
+    /**
+     The number of characters in the expression before the first '*'.  If
+     the expression contains no '*', this is the number of characters that
+     must match, excluding any optional trailing '?' characters.
+     */
+    YORI_ALLOC_SIZE_T PrefixLength;
+
+    /**
+     The offset within the expression of the segment following the final
+     '*'.
+     */
+    YORI_ALLOC_SIZE_T SuffixOffset;
+
+    /**
+     The number of characters in the segment following the final '*',
+     excluding any optional trailing '?' characters.
+     */
+    YORI_ALLOC_SIZE_T SuffixLength;
+
+    /**
+     The minimum number of characters a file name must contain to match the
+     expression.
+     */
+    YORI_ALLOC_SIZE_T MinimumLength;
+
+    /**
+     The number of '?' characters at the end of the expression.  These can
+     match a character or the end of the file name.
+     */
+    YORI_ALLOC_SIZE_T OptionalChars;
+
+    /**
+     TRUE if the expression contains a '*'.
+     */
+    BOOLEAN ContainsStar;
+
+    /**
+     TRUE if literal segments exist between the prefix and the suffix, which
+     must be searched for within the file name.
+     */
+    BOOLEAN ContainsMiddle;
 
-/**
- Indicates that symbolic links and mount points should not be traversed
- when recursing.
- */
-#define YORILIB_FILEENUM_NO_LINK_TRAVERSE        0x00000040
+} YORI_LIB_FILE_MATCH_EXPRESSION, *PYORI_LIB_FILE_MATCH_EXPRESSION;
 
 /**
- Include dot and dotdot files during enumerate.
+ A pointer to a compiled wildcard expression which cannot be modified.
  */
-#define YORILIB_FILEENUM_INCLUDE_DOTFILES        0x00000080
+typedef YORI_LIB_FILE_MATCH_EXPRESSION CONST *PCYORI_LIB_FILE_MATCH_EXPRESSION;
 
-/**
- If the top level object is a directory, enumerate its children without
- requiring explicit wildcards.
- */
-#define YORILIB_FILEENUM_DIRECTORY_CONTENTS      0x00000100
+VOID
+YoriLibCompileFileMatchExpression(
+    __in PCYORI_STRING Wildcard,
+    __out PYORI_LIB_FILE_MATCH_EXPRESSION Expression
+    );
 
-__success(return)
-BOOL
-YoriLibForEachFile(
-    __in PYORI_STRING FileSpec,
-    __in WORD MatchFlags,
-    __in DWORD Depth,
-    __in PYORILIB_FILE_ENUM_FN Callback,
-    __in_opt PYORILIB_FILE_ENUM_ERROR_FN ErrorCallback,
-    __in_opt PVOID Context
+BOOLEAN
+YoriLibDoesFileMatchCompiledExpression(
+    __in PCYORI_STRING FileName,
+    __in PCYORI_LIB_FILE_MATCH_EXPRESSION Expression
     );
 
 __success(return)
@@ -1643,10 +2907,26 @@ typedef struct _YORI_LIB_FILE_FILTER {
      */
     DWORD ElementSize;
 
+    /**
+     The number of criteria at the start of the array which only use
+     information returned from a directory enumerate.  These can be
+     evaluated without initializing the entry used to collect information,
+     which is initialized before evaluating any later criteria.
+     */
+    DWORD CriteriaFromFindData;
+
     /**
      An array of criteria to apply.
      */
     PVOID Criteria;
+
+    /**
+     For color filters, optionally points to an index of the criteria by
+     the file extension they compare against, so that each file is only
+     compared against criteria which could match it.  If NULL, every
+     criteria is evaluated in order.
+     */
+    PVOID ExtensionIndex;
 } YORI_LIB_FILE_FILTER, *PYORI_LIB_FILE_FILTER;
 
 /**
@@ -1716,6 +2996,48 @@ typedef struct _YORI_LIB_FILE_FILT_COLOR_CRITERIA {
     YORILIB_COLOR_ATTRIBUTES Color;
 } YORI_LIB_FILE_FILT_COLOR_CRITERIA, *PYORI_LIB_FILE_FILT_COLOR_CRITERIA;
 
+/**
+ State used to enumerate the criteria within a color filter which could
+ match a file, in the order that they should be evaluated.
+ */
+typedef struct _YORI_LIB_FILE_FILT_COLOR_ENUM {
+
+    /**
+     An array of indexes of criteria which compare against the file's
+     extension, or NULL if there are none.
+     */
+    PDWORD ExtensionRules;
+
+    /**
+     The number of elements in the ExtensionRules array.
+     */
+    DWORD NumberExtensionRules;
+
+    /**
+     The next element within the ExtensionRules array to return.
+     */
+    DWORD ExtensionRuleIndex;
+
+    /**
+     An array of indexes of criteria which do not compare against an
+     extension and need to be evaluated for all files.  If NULL, every
+     criteria in the filter is returned.
+     */
+    PDWORD GeneralRules;
+
+    /**
+     The number of elements in the GeneralRules array, or the number of
+     criteria in the filter if GeneralRules is NULL.
+     */
+    DWORD NumberGeneralRules;
+
+    /**
+     The next element within the GeneralRules array to return.
+     */
+    DWORD GeneralRuleIndex;
+
+} YORI_LIB_FILE_FILT_COLOR_ENUM, *PYORI_LIB_FILE_FILT_COLOR_ENUM;
+
 BOOL
 YoriLibFileFiltHelp(VOID);
 
@@ -1752,6 +3074,20 @@ YoriLibFileFiltCheckColorMatch(
     __out PYORILIB_COLOR_ATTRIBUTES Attribute
     );
 
+VOID
+YoriLibFileFiltStartColorEnum(
+    __in PYORI_LIB_FILE_FILTER Filter,
+    __in_opt PCYORI_STRING Extension,
+    __out PYORI_LIB_FILE_FILT_COLOR_ENUM Enum
+    );
+
+__success(return)
+BOOL
+YoriLibFileFiltGetNextColorCriteria(
+    __inout PYORI_LIB_FILE_FILT_COLOR_ENUM Enum,
+    __out PDWORD CriteriaIndex
+    );
+
 VOID
 YoriLibFileFiltFreeFilter(
     __in PYORI_LIB_FILE_FILTER Filter
@@ -2039,6 +3375,24 @@ YoriLibCollectWriteTime(
     __in PYORI_STRING FullPath
     );
 
+DWORD
+YoriLibCollectGetRequiredAccess(
+    __in YORI_LIB_FILE_FILT_COLLECT_FN CollectFn
+    );
+
+BOOL
+YoriLibCollectOpenSharedHandle(
+    __inout PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath,
+    __in DWORD DesiredAccess
+    );
+
+VOID
+YoriLibCollectCloseSharedHandle(
+    __inout PYORI_FILE_INFO Entry
+    );
+
 DWORD
 YoriLibCompareLargeInt (
     __in PULARGE_INTEGER Left,
@@ -2465,6 +3819,85 @@ YoriLibGenerateWriteTime(
     __in PYORI_STRING String
     );
 
+// *** FILEUPD.C ***
+
+/**
+ Forward declaration of an engine to apply updates to files in parallel.
+ */
+typedef struct _YORI_LIB_FILE_UPDATE_ENGINE *PYORI_LIB_FILE_UPDATE_ENGINE;
+
+/**
+ A description of an update to a single file, provided to the functions
+ which apply and report it.
+ */
+typedef struct _YORI_LIB_FILE_UPDATE {
+
+    /**
+     The full path to the file.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     Optionally points to information about the file returned from
+     enumeration.  If NULL, no information is available.
+     */
+    PWIN32_FIND_DATA FileInfo;
+
+    /**
+     Set by the update function to a Win32 error code, or ERROR_SUCCESS if
+     the update was applied.
+     */
+    DWORD Error;
+
+    /**
+     Set by the update function to an application defined value describing
+     which step of the update failed, allowing the report function to
+     describe the failure.
+     */
+    DWORD FailedStep;
+
+    /**
+     Set by the update function to TRUE if the file was modified.  An
+     update may succeed without modifying a file that already has the
+     requested state.
+     */
+    BOOLEAN Modified;
+
+} YORI_LIB_FILE_UPDATE, *PYORI_LIB_FILE_UPDATE;
+
+/**
+ A prototype for a callback function to apply or report an update to a file.
+ */
+typedef VOID YORI_LIB_FILE_UPDATE_FN(PYORI_LIB_FILE_UPDATE Update, PVOID Context);
+
+/**
+ A pointer to a callback function to apply or report an update to a file.
+ */
+typedef YORI_LIB_FILE_UPDATE_FN *PYORI_LIB_FILE_UPDATE_FN;
+
+__success(return)
+BOOLEAN
+YoriLibCreateFileUpdateEngine(
+    __in PYORI_LIB_FILE_UPDATE_FN UpdateFn,
+    __in_opt PYORI_LIB_FILE_UPDATE_FN ReportFn,
+    __in_opt PVOID Context,
+    __in DWORD MaxPerVolume,
+    __out PYORI_LIB_FILE_UPDATE_ENGINE *Engine
+    );
+
+__success(return)
+BOOLEAN
+YoriLibQueueFileUpdate(
+    __in PYORI_LIB_FILE_UPDATE_ENGINE Engine,
+    __in PYORI_STRING FilePath,
+    __in_opt PWIN32_FIND_DATA FileInfo
+    );
+
+VOID
+YoriLibDestroyFileUpdateEngine(
+    __in PYORI_LIB_FILE_UPDATE_ENGINE Engine
+    );
+
 // *** FULLPATH.C ***
 
 /**
@@ -2611,6 +4044,13 @@ YoriLibGetDiskFreeSpace(
 
 // *** GROUP.C ***
 
+__success(return)
+BOOL
+YoriLibQueryTokenGroups(
+    __in_opt HANDLE TokenHandle,
+    __out PTOKEN_GROUPS *Groups
+    );
+
 __success(return)
 BOOL
 YoriLibCheckTokenMembership(
@@ -2641,6 +4081,24 @@ YoriLibHashString32(
     __in PCYORI_STRING String
     );
 
+DWORD
+YoriLibHashStringFnv32(
+    __in DWORD InitialHash,
+    __in PCYORI_STRING String
+    );
+
+DWORD
+YoriLibHashStringCaseSensitiveFnv32(
+    __in DWORD InitialHash,
+    __in PCYORI_STRING String
+    );
+
+PYORI_HASH_TABLE
+YoriLibAllocateHashTableEx(
+    __in YORI_ALLOC_SIZE_T NumberBuckets,
+    __in_opt PYORI_HASH_STRING_FN HashFunction
+    );
+
 PYORI_HASH_TABLE
 YoriLibAllocateHashTable(
     __in YORI_ALLOC_SIZE_T NumberBuckets
@@ -2676,6 +4134,80 @@ YoriLibHashRemoveByKey(
     __in PYORI_STRING KeyString
     );
 
+PYORI_OPEN_HASH_TABLE
+YoriLibAllocateOpenHashTableEx(
+    __in YORI_ALLOC_SIZE_T ExpectedEntries,
+    __in_opt PYORI_HASH_STRING_FN HashFunction
+    );
+
+PYORI_OPEN_HASH_TABLE
+YoriLibAllocateOpenHashTable(
+    __in YORI_ALLOC_SIZE_T ExpectedEntries
+    );
+
+VOID
+YoriLibFreeEmptyOpenHashTable(
+    __in PYORI_OPEN_HASH_TABLE HashTable
+    );
+
+__success(return)
+BOOL
+YoriLibOpenHashInsertByKey(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in PYORI_STRING KeyString,
+    __in PVOID Context,
+    __out PYORI_OPEN_HASH_ENTRY HashEntry
+    );
+
+PYORI_OPEN_HASH_ENTRY
+YoriLibOpenHashLookupByKey(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in PCYORI_STRING KeyString
+    );
+
+VOID
+YoriLibOpenHashRemoveByEntry(
+    __in PYORI_OPEN_HASH_ENTRY HashEntry
+    );
+
+PYORI_OPEN_HASH_ENTRY
+YoriLibOpenHashRemoveByKey(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in PYORI_STRING KeyString
+    );
+
+PYORI_LIB_ATOM_TABLE
+YoriLibAllocateAtomTable(
+    __in YORI_ALLOC_SIZE_T ExpectedEntries
+    );
+
+VOID
+YoriLibFreeAtomTable(
+    __in PYORI_LIB_ATOM_TABLE AtomTable
+    );
+
+PYORI_LIB_ATOM
+YoriLibLookupAtom(
+    __in PYORI_LIB_ATOM_TABLE AtomTable,
+    __in PCYORI_STRING String
+    );
+
+PYORI_LIB_ATOM
+YoriLibInternString(
+    __in PYORI_LIB_ATOM_TABLE AtomTable,
+    __in PCYORI_STRING String
+    );
+
+VOID
+YoriLibReferenceAtom(
+    __in PYORI_LIB_ATOM Atom
+    );
+
+VOID
+YoriLibReleaseAtom(
+    __in PYORI_LIB_ATOM Atom
+    );
+
 // *** HEXDUMP.C ***
 
 /**
@@ -2709,6 +4241,12 @@ YoriLibHashRemoveByKey(
  */
 #define YORI_LIB_HEX_FLAG_C_STYLE              (0x00000010)
 
+/**
+ If set, YoriLibHexDiff only displays lines that differ between the two
+ buffers.
+ */
+#define YORI_LIB_HEX_FLAG_SKIP_IDENTICAL       (0x00000020)
+
 TCHAR
 YoriLibHexDigitFromValue(
     __in DWORD Value
@@ -2838,6 +4376,22 @@ YoriLibSetMultibyteInputEncoding(
     __in DWORD Encoding
     );
 
+YORI_ALLOC_SIZE_T
+YoriLibUtf8FromUtf16(
+    __in_ecount(InputBufferLength) LPCTSTR InputStringBuffer,
+    __in YORI_ALLOC_SIZE_T InputBufferLength,
+    __out_ecount_opt(OutputBufferLength) LPSTR OutputStringBuffer,
+    __in YORI_ALLOC_SIZE_T OutputBufferLength
+    );
+
+YORI_ALLOC_SIZE_T
+YoriLibUtf16FromUtf8(
+    __in_ecount(InputBufferLength) LPCSTR InputStringBuffer,
+    __in YORI_ALLOC_SIZE_T InputBufferLength,
+    __out_ecount_opt(OutputBufferLength) LPTSTR OutputStringBuffer,
+    __in YORI_ALLOC_SIZE_T OutputBufferLength
+    );
+
 YORI_ALLOC_SIZE_T
 YoriLibGetMbyteOutputSizeNeeded(
     __in LPCTSTR StringBuffer,
@@ -2866,6 +4420,73 @@ YoriLibMultibyteInput(
     __in YORI_ALLOC_SIZE_T OutputBufferLength
     );
 
+// *** INI.C ***
+
+/**
+ An INI file which has been loaded into memory.  The contents of this
+ structure are private to the INI module.
+ */
+typedef struct _YORI_LIB_INI_FILE *PYORI_LIB_INI_FILE;
+
+VOID
+YoriLibIniFree(
+    __in PYORI_LIB_INI_FILE IniFile
+    );
+
+__success(return != NULL)
+PYORI_LIB_INI_FILE
+YoriLibIniLoad(
+    __in PCYORI_STRING FileName
+    );
+
+DWORD
+YoriLibIniGetString(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName,
+    __in_opt LPCTSTR DefaultValue,
+    __out_ecount(BufferLength) LPTSTR Buffer,
+    __in DWORD BufferLength
+    );
+
+UINT
+YoriLibIniGetInt(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName,
+    __in INT DefaultValue
+    );
+
+DWORD
+YoriLibIniGetSection(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __in LPCTSTR SectionName,
+    __out_ecount(BufferLength) LPTSTR Buffer,
+    __in DWORD BufferLength
+    );
+
+DWORD
+YoriLibIniGetSectionNames(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __out_ecount(BufferLength) LPTSTR Buffer,
+    __in DWORD BufferLength
+    );
+
+__success(return)
+BOOL
+YoriLibIniWriteString(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __in LPCTSTR SectionName,
+    __in_opt LPCTSTR KeyName,
+    __in_opt LPCTSTR Value
+    );
+
+__success(return)
+BOOL
+YoriLibIniFlush(
+    __in PYORI_LIB_INI_FILE IniFile
+    );
+
 // *** JOBOBJ.C ***
 
 HANDLE
@@ -2877,12 +4498,31 @@ YoriLibAssignProcessToJobObject(
     __in HANDLE hProcess
     );
 
+VOID
+YoriLibQueryJobObjectBasicLimits(
+    __in HANDLE hJob,
+    __out PYORI_JOB_BASIC_LIMIT_INFORMATION LimitInfo
+    );
+
 BOOL
 YoriLibLimitJobObjectPriority(
     __in HANDLE hJob,
     __in DWORD Priority
     );
 
+BOOL
+YoriLibLimitJobObjectAffinity(
+    __in HANDLE hJob,
+    __in PYORI_PROCESSOR_GROUP_AFFINITY Affinity
+    );
+
+BOOL
+YoriLibAssociateJobObjectWithCompletionPort(
+    __in HANDLE hJob,
+    __in HANDLE hPort,
+    __in_opt PVOID Key
+    );
+
 // *** LICENSE.C ***
 
 BOOL
@@ -2913,6 +4553,30 @@ typedef enum _YORI_LIB_LINE_ENDING {
  */
 typedef YORI_LIB_LINE_ENDING *PYORI_LIB_LINE_ENDING;
 
+/**
+ A description of a line within the line reader's buffer.  The line is in
+ the input encoding, which is either 8 bit or 16 bit characters.
+ */
+typedef struct _YORI_LIB_LINE_SPAN {
+
+    /**
+     Pointer to the first character of the line within the buffer.
+     */
+    PVOID StartOfLine;
+
+    /**
+     The number of characters in the line, not including the line ending.
+     These are 16 bit characters if the input is UTF16, and 8 bit
+     characters otherwise.
+     */
+    YORI_ALLOC_SIZE_T LengthInChars;
+
+    /**
+     The line ending which terminated the line.
+     */
+    YORI_LIB_LINE_ENDING LineEnding;
+} YORI_LIB_LINE_SPAN, *PYORI_LIB_LINE_SPAN;
+
 PVOID
 YoriLibReadLineToString(
     __in PYORI_STRING UserString,
@@ -2931,11 +4595,30 @@ YoriLibReadLineToStringEx(
     __out PBOOL TimeoutReached
     );
 
+YORI_ALLOC_SIZE_T
+YoriLibLineReadFindBreakA(
+    __in PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    );
+
+YORI_ALLOC_SIZE_T
+YoriLibReadLineGetBufferedSpans(
+    __in_opt PVOID Context,
+    __out_ecount(MaximumSpans) PYORI_LIB_LINE_SPAN Spans,
+    __in YORI_ALLOC_SIZE_T MaximumSpans,
+    __out PBOOLEAN WideChars
+    );
+
 VOID
 YoriLibLineReadClose(
     __in_opt PVOID Context
     );
 
+VOID
+YoriLibLineReadDisableReadAhead(
+    __in_opt PVOID Context
+    );
+
 VOID
 YoriLibLineReadCloseOrCache(
     __in_opt PVOID Context
@@ -2993,6 +4676,15 @@ YoriLibIsListEmpty(
 #define YORI_SPECIAL_HEAP 1
 #endif
 
+#ifndef YORI_HEAP_PROFILE
+#define YORI_HEAP_PROFILE 0
+#endif
+
+#if YORI_HEAP_PROFILE && !YORI_SPECIAL_HEAP
+#undef YORI_SPECIAL_HEAP
+#define YORI_SPECIAL_HEAP 1
+#endif
+
 #if YORI_SPECIAL_HEAP
 
 PVOID
@@ -3038,6 +4730,9 @@ YoriLibFree(
     __in PVOID Ptr
     );
 
+VOID
+YoriLibDisplayHeapProfile(VOID);
+
 VOID
 YoriLibDisplayMemoryUsage(VOID);
 
@@ -3070,8 +4765,538 @@ YoriLibIsAllocationExtendable(
     __in YORI_ALLOC_SIZE_T DesiredExtraSize
     );
 
+// *** MFTENUM.C ***
+
+/**
+ The signature at the start of each valid NTFS file record, 'FILE'.
+ */
+#define YORI_LIB_NTFS_FILE_RECORD_SIGNATURE      (0x454C4946)
+
+/**
+ A flag in an NTFS file record indicating the record is in use.
+ */
+#define YORI_LIB_NTFS_FILE_RECORD_IN_USE         (0x0001)
+
+/**
+ A flag in an NTFS file record indicating the record describes a directory.
+ */
+#define YORI_LIB_NTFS_FILE_RECORD_DIRECTORY      (0x0002)
+
+/**
+ The attribute type code for standard information.
+ */
+#define YORI_LIB_NTFS_ATTRIBUTE_STANDARD_INFORMATION (0x10)
+
+/**
+ The attribute type code for an attribute list.
+ */
+#define YORI_LIB_NTFS_ATTRIBUTE_LIST             (0x20)
+
+/**
+ The attribute type code for a file name.
+ */
+#define YORI_LIB_NTFS_ATTRIBUTE_FILE_NAME        (0x30)
+
+/**
+ The attribute type code for a data stream.
+ */
+#define YORI_LIB_NTFS_ATTRIBUTE_DATA             (0x80)
+
+/**
+ The attribute type code for a reparse point.
+ */
+#define YORI_LIB_NTFS_ATTRIBUTE_REPARSE_POINT    (0xC0)
+
+/**
+ The attribute type code indicating no further attributes are in a record.
+ */
+#define YORI_LIB_NTFS_ATTRIBUTE_END              (0xFFFFFFFF)
+
+/**
+ The form code for an attribute whose value is within the file record.
+ */
+#define YORI_LIB_NTFS_ATTRIBUTE_RESIDENT         (0x00)
+
+/**
+ Attribute flags indicating the attribute is compressed.
+ */
+#define YORI_LIB_NTFS_ATTRIBUTE_COMPRESSED_MASK  (0x00FF)
+
+/**
+ An attribute flag indicating the attribute is sparse.
+ */
+#define YORI_LIB_NTFS_ATTRIBUTE_SPARSE           (0x8000)
+
+/**
+ The file name namespace for names that are only valid as 8.3 names.  Other
+ namespaces describe names that are visible to Win32 or POSIX callers.
+ */
+#define YORI_LIB_NTFS_FILE_NAME_DOS              (0x02)
+
+/**
+ Return the segment number component of an NTFS file reference.
+ */
+#define YORI_LIB_NTFS_SEGMENT_NUMBER(REF) ((REF) & 0x0000FFFFFFFFFFFF)
+
+/**
+ Return the sequence number component of an NTFS file reference.
+ */
+#define YORI_LIB_NTFS_SEQUENCE_NUMBER(REF) ((WORD)((REF) >> 48))
+
+/**
+ The header of a file record within the NTFS MFT.
+ */
+typedef struct _YORI_LIB_NTFS_FILE_RECORD {
+
+    /**
+     The signature of the record, YORI_LIB_NTFS_FILE_RECORD_SIGNATURE.
+     */
+    DWORD Signature;
+
+    /**
+     The offset in bytes from the start of the record to the update
+     sequence array.
+     */
+    WORD UpdateSequenceArrayOffset;
+
+    /**
+     The number of elements in the update sequence array.
+     */
+    WORD UpdateSequenceArraySize;
+
+    /**
+     The log file sequence number of the last change to the record.
+     */
+    DWORDLONG LogFileSequenceNumber;
+
+    /**
+     The number of times this record has been reused.  This forms the high
+     16 bits of a file reference.
+     */
+    WORD SequenceNumber;
+
+    /**
+     The number of names referring to this file.
+     */
+    WORD ReferenceCount;
+
+    /**
+     The offset in bytes from the start of the record to the first
+     attribute.
+     */
+    WORD FirstAttributeOffset;
+
+    /**
+     Flags for the record, including YORI_LIB_NTFS_FILE_RECORD_IN_USE and
+     YORI_LIB_NTFS_FILE_RECORD_DIRECTORY.
+     */
+    WORD Flags;
+
+    /**
+     The number of bytes in the record that are in use.
+     */
+    DWORD BytesInUse;
+
+    /**
+     The number of bytes allocated for the record.
+     */
+    DWORD BytesAllocated;
+
+    /**
+     For an extension record, the file reference of the base record for the
+     file.  Zero for a base record.
+     */
+    DWORDLONG BaseFileRecord;
+
+    /**
+     The instance number to assign to the next attribute.
+     */
+    WORD NextAttributeInstance;
+} YORI_LIB_NTFS_FILE_RECORD, *PYORI_LIB_NTFS_FILE_RECORD;
+
+/**
+ The header of an attribute within an NTFS file record.
+ */
+typedef struct _YORI_LIB_NTFS_ATTRIBUTE {
+
+    /**
+     The type of the attribute, for example YORI_LIB_NTFS_ATTRIBUTE_DATA.
+     */
+    DWORD TypeCode;
+
+    /**
+     The length of the attribute in bytes, including this header.
+     */
+    DWORD RecordLength;
+
+    /**
+     YORI_LIB_NTFS_ATTRIBUTE_RESIDENT if the value is within the record,
+     or nonzero if the value is stored in clusters elsewhere on the volume.
+     */
+    UCHAR FormCode;
+
+    /**
+     The length of the attribute name, in characters.
+     */
+    UCHAR NameLength;
+
+    /**
+     The offset in bytes from the start of the attribute to its name.
+     */
+    WORD NameOffset;
+
+    /**
+     Flags for the attribute, including compression and sparseness.
+     */
+    WORD Flags;
+
+    /**
+     A number identifying this attribute within the file.
+     */
+    WORD Instance;
+
+    /**
+     Information specific to resident or nonresident attributes.
+     */
+    union {
+
+        /**
+         Information about a resident attribute.
+         */
+        struct {
+
+            /**
+             The length of the value, in bytes.
+             */
+            DWORD ValueLength;
+
+            /**
+             The offset in bytes from the start of the attribute to its
+             value.
+             */
+            WORD ValueOffset;
+
+            /**
+             Flags for a resident attribute.
+             */
+            UCHAR ResidentFlags;
+
+            /**
+             Reserved.
+             */
+            UCHAR Reserved;
+        } Resident;
+
+        /**
+         Information about a nonresident attribute.
+         */
+        struct {
+
+            /**
+             The first cluster within the attribute described by this
+             record.
+             */
+            LONGLONG LowestVcn;
+
+            /**
+             The last cluster within the attribute described by this record.
+             */
+            LONGLONG HighestVcn;
+
+            /**
+             The offset in bytes from the start of the attribute to its
+             mapping pairs.
+             */
+            WORD MappingPairsOffset;
+
+            /**
+             The log base 2 of the number of clusters in a compression unit.
+             */
+            UCHAR CompressionUnit;
+
+            /**
+             Reserved.
+             */
+            UCHAR Reserved[5];
+
+            /**
+             The number of bytes allocated to the attribute.  Only valid
+             when LowestVcn is zero.
+             */
+            LONGLONG AllocatedLength;
+
+            /**
+             The length of the attribute in bytes.  Only valid when
+             LowestVcn is zero.
+             */
+            LONGLONG FileSize;
+
+            /**
+             The number of bytes that have been written.  Only valid when
+             LowestVcn is zero.
+             */
+            LONGLONG ValidDataLength;
+
+            /**
+             The number of bytes physically allocated.  Only present if the
+             attribute is compressed or sparse, and only valid when
+             LowestVcn is zero.
+             */
+            LONGLONG TotalAllocated;
+        } Nonresident;
+    } Form;
+} YORI_LIB_NTFS_ATTRIBUTE, *PYORI_LIB_NTFS_ATTRIBUTE;
+
+/**
+ The value of a file name attribute within an NTFS file record.
+ */
+typedef struct _YORI_LIB_NTFS_FILE_NAME {
+
+    /**
+     The file reference of the directory containing this name.
+     */
+    DWORDLONG ParentDirectory;
+
+    /**
+     The time the file was created.
+     */
+    LONGLONG CreationTime;
+
+    /**
+     The time the file was last written, as of the last name update.
+     */
+    LONGLONG LastModificationTime;
+
+    /**
+     The time the file's metadata was last changed, as of the last name
+     update.
+     */
+    LONGLONG LastChangeTime;
+
+    /**
+     The time the file was last accessed, as of the last name update.
+     */
+    LONGLONG LastAccessTime;
+
+    /**
+     The allocation size of the file, as of the last name update.
+     */
+    LONGLONG AllocatedLength;
+
+    /**
+     The size of the file, as of the last name update.
+     */
+    LONGLONG FileSize;
+
+    /**
+     The attributes of the file.
+     */
+    DWORD FileAttributes;
+
+    /**
+     For files with extended attributes, their size, or for reparse points,
+     the reparse tag.
+     */
+    DWORD PackedEaSize;
+
+    /**
+     The length of the name, in characters.
+     */
+    UCHAR FileNameLength;
+
+    /**
+     The namespace of the name, for example YORI_LIB_NTFS_FILE_NAME_DOS.
+     */
+    UCHAR Flags;
+
+    /**
+     The name.  This is not NULL terminated.
+     */
+    WCHAR FileName[1];
+} YORI_LIB_NTFS_FILE_NAME, *PYORI_LIB_NTFS_FILE_NAME;
+
+/**
+ A prototype for a callback function to invoke for each file record.
+ */
+typedef BOOL YORI_LIB_MFT_RECORD_FN(DWORDLONG SegmentNumber, PYORI_LIB_NTFS_FILE_RECORD FileRecord, DWORD RecordLength, PVOID Context);
+
+/**
+ A pointer to a callback function to invoke for each file record.
+ */
+typedef YORI_LIB_MFT_RECORD_FN *PYORI_LIB_MFT_RECORD_FN;
+
+HANDLE
+YoriLibMftOpenVolume(
+    __in PYORI_STRING FilePath,
+    __out PNTFS_VOLUME_DATA_BUFFER VolumeData
+    );
+
+BOOLEAN
+YoriLibMftApplyFixups(
+    __inout PYORI_LIB_NTFS_FILE_RECORD FileRecord,
+    __in DWORD RecordLength
+    );
+
+PYORI_LIB_NTFS_ATTRIBUTE
+YoriLibMftGetNextAttribute(
+    __in PYORI_LIB_NTFS_FILE_RECORD FileRecord,
+    __in DWORD RecordLength,
+    __in_opt PYORI_LIB_NTFS_ATTRIBUTE PreviousAttribute
+    );
+
+PVOID
+YoriLibMftGetResidentValue(
+    __in PYORI_LIB_NTFS_ATTRIBUTE Attribute,
+    __in DWORD MinimumLength
+    );
+
+__success(return)
+BOOL
+YoriLibMftEnumerateRecords(
+    __in HANDLE VolumeHandle,
+    __in PNTFS_VOLUME_DATA_BUFFER VolumeData,
+    __in PYORI_LIB_MFT_RECORD_FN Callback,
+    __in_opt PVOID Context
+    );
+
 // *** MOVEFILE.C ***
 
+/**
+ The number of buffers used by YoriLibCopyFileData if the caller does not
+ specify a number.
+ */
+#define YORI_LIB_COPY_DATA_DEFAULT_BUFFER_COUNT (4)
+
+/**
+ The size of each buffer used by YoriLibCopyFileData if the caller does not
+ specify a size.
+ */
+#define YORI_LIB_COPY_DATA_DEFAULT_BUFFER_SIZE (1024 * 1024)
+
+/**
+ The largest buffer size that YoriLibCopyFileData will use.
+ */
+#define YORI_LIB_COPY_DATA_MAXIMUM_BUFFER_SIZE (16 * 1024 * 1024)
+
+/**
+ The size of each chunk of data that is hashed separately when calculating
+ the digest of data copied by YoriLibCopyFileData.
+ */
+#define YORI_LIB_COPY_DATA_DIGEST_CHUNK (4096)
+
+/**
+ Parameters to YoriLibCopyFileData.
+ */
+typedef struct _YORI_LIB_COPY_DATA_PARAMS {
+
+    /**
+     The number of buffers to keep reads and writes in flight with, or zero
+     to use a default.  This is capped at MAXIMUM_WAIT_OBJECTS - 1.
+     */
+    DWORD BufferCount;
+
+    /**
+     The size of each buffer in bytes, or zero to use a default.  This is
+     rounded up to a multiple of the sector size.
+     */
+    DWORD BufferSize;
+
+    /**
+     The number of bytes to copy, or zero to copy until the end of the
+     source.
+     */
+    LARGE_INTEGER MaximumLength;
+
+    /**
+     The offset in the source to start reading from.  If the source is
+     opened with FILE_FLAG_NO_BUFFERING, this must be sector aligned.
+     */
+    LARGE_INTEGER SourceOffset;
+
+    /**
+     The offset in the destination to write the data read from SourceOffset
+     to.  If the destination is opened with FILE_FLAG_NO_BUFFERING, this
+     must be sector aligned.
+     */
+    LARGE_INTEGER DestOffset;
+
+    /**
+     If TRUE and the destination is a file, blocks which contain only zeroes
+     are not written, and the destination is made sparse so that they
+     occupy no space.  The destination must be empty.
+     */
+    BOOLEAN SkipZeroBlocks;
+
+    /**
+     On completion, the number of bytes copied.
+     */
+    LARGE_INTEGER BytesCopied;
+
+    /**
+     On completion, the number of bytes included in BytesCopied which were
+     zero and were not written because SkipZeroBlocks was specified.
+     */
+    LARGE_INTEGER ZeroBytesSkipped;
+
+    /**
+     On completion, the time taken to copy the data, in 100ns units.
+     */
+    LARGE_INTEGER ElapsedTime;
+
+    /**
+     On completion, TRUE if the destination was created by cloning the
+     blocks of the source rather than copying data.
+     */
+    BOOLEAN Cloned;
+
+    /**
+     On completion, TRUE if the source was sparse and only its allocated
+     ranges were copied.
+     */
+    BOOLEAN Sparse;
+
+    /**
+     If TRUE, a digest of the data is calculated as it is copied, so that
+     the destination can be verified with YoriLibCopyDataComputeDigest
+     without reading the source again.
+     */
+    BOOLEAN ComputeDigest;
+
+    /**
+     On completion, TRUE if Digest and DigestLength describe the data
+     written.  This is FALSE if the blocks were cloned, since no data was
+     read.
+     */
+    BOOLEAN DigestComputed;
+
+    /**
+     On completion, the digest of the data copied.
+     */
+    DWORDLONG Digest;
+
+    /**
+     On completion, the number of bytes from DestOffset that Digest
+     describes.
+     */
+    LARGE_INTEGER DigestLength;
+} YORI_LIB_COPY_DATA_PARAMS, *PYORI_LIB_COPY_DATA_PARAMS;
+
+DWORD
+YoriLibCopyDataComputeDigest(
+    __in HANDLE FileHandle,
+    __in PLARGE_INTEGER Offset,
+    __in PLARGE_INTEGER Length,
+    __in DWORD BufferSize,
+    __out PDWORDLONG Digest
+    );
+
+DWORD
+YoriLibCopyFileData(
+    __in HANDLE SourceHandle,
+    __in HANDLE DestHandle,
+    __inout PYORI_LIB_COPY_DATA_PARAMS Params
+    );
+
 DWORD
 YoriLibMoveFile(
     __in PYORI_STRING Source,
@@ -3256,6 +5481,13 @@ YoriLibPathLocateUnknownExtensionUnknownLocation(
     __inout PYORI_STRING FoundPath
     );
 
+__success(return)
+BOOLEAN
+YoriLibPathIndexEnable(VOID);
+
+VOID
+YoriLibPathIndexCleanup(VOID);
+
 __success(return)
 BOOLEAN
 YoriLibLocateExecutableInPath(
@@ -3384,12 +5616,29 @@ YoriLibGetSystemProcessList(
     __out PYORI_SYSTEM_PROCESS_INFORMATION *ProcessInfo
     );
 
+__success(return)
+BOOL
+YoriLibUpdateSystemProcessList(
+    __inout PYORI_SYSTEM_PROCESS_INFORMATION *ProcessInfo,
+    __inout PYORI_ALLOC_SIZE_T BytesAllocated
+    );
+
 __success(return)
 BOOL
 YoriLibGetSystemHandlesList(
     __out PYORI_SYSTEM_HANDLE_INFORMATION_EX *HandlesInfo
     );
 
+BOOL
+YoriLibSetProcessBackgroundPriority(
+    __in HANDLE hProcess
+    );
+
+BOOL
+YoriLibSetProcessPowerThrottling(
+    __in HANDLE hProcess
+    );
+
 // *** PROGMAN.C ***
 
 __success(return)
@@ -3405,11 +5654,102 @@ YoriLibAddProgmanItem(
 
 // *** RECYCLE.C ***
 
+/**
+ A prototype for a callback function invoked for an object which was queued
+ in a recycle bin batch but could not be sent to the recycle bin.
+ */
+typedef VOID YORI_LIB_RECYCLE_FAILED_FN(PYORI_STRING FilePath, PVOID Context);
+
+/**
+ A pointer to a callback function invoked for an object which could not be
+ sent to the recycle bin.
+ */
+typedef YORI_LIB_RECYCLE_FAILED_FN *PYORI_LIB_RECYCLE_FAILED_FN;
+
+/**
+ A set of objects waiting to be sent to the recycle bin in a single shell
+ operation.
+ */
+typedef struct _YORI_LIB_RECYCLE_BATCH {
+
+    /**
+     A buffer containing each NULL terminated path, followed by an extra
+     NULL.  LengthInChars refers to the end of the last path including its
+     NULL terminator.
+     */
+    YORI_STRING Paths;
+
+    /**
+     The number of paths in the buffer.
+     */
+    DWORD Count;
+
+    /**
+     A function to call for each object that could not be sent to the
+     recycle bin.
+     */
+    PYORI_LIB_RECYCLE_FAILED_FN FailedCallback;
+
+    /**
+     Context to pass to FailedCallback.
+     */
+    PVOID Context;
+
+} YORI_LIB_RECYCLE_BATCH, *PYORI_LIB_RECYCLE_BATCH;
+
 BOOL
 YoriLibRecycleBinFile(
     __in PYORI_STRING FilePath
     );
 
+VOID
+YoriLibRecycleBinBatchInitialize(
+    __out PYORI_LIB_RECYCLE_BATCH Batch,
+    __in PYORI_LIB_RECYCLE_FAILED_FN FailedCallback,
+    __in_opt PVOID Context
+    );
+
+BOOL
+YoriLibRecycleBinBatchFlush(
+    __inout PYORI_LIB_RECYCLE_BATCH Batch
+    );
+
+BOOL
+YoriLibRecycleBinBatchAdd(
+    __inout PYORI_LIB_RECYCLE_BATCH Batch,
+    __in PYORI_STRING FilePath
+    );
+
+VOID
+YoriLibRecycleBinBatchCleanup(
+    __inout PYORI_LIB_RECYCLE_BATCH Batch
+    );
+
+// *** REGEXVM.C ***
+
+int
+YoriLibRegexCompile(
+    __in LPCSTR Pattern,
+    __out PYORI_LIB_REGEX Regex
+    );
+
+VOID
+YoriLibRegexFree(
+    __inout PYORI_LIB_REGEX Regex
+    );
+
+LONG_PTR
+YoriLibRegexSearch(
+    __in PYORI_LIB_REGEX Regex,
+    __in LPCSTR Text,
+    __in YORI_ALLOC_SIZE_T TextLength,
+    __in YORI_ALLOC_SIZE_T StartOffset,
+    __in WORD CaptureSlots,
+    __out_ecount_opt(CaptureSlots) PLONG_PTR CapturePos,
+    __out_ecount_opt(CaptureSlots) PLONG_PTR CaptureSpan,
+    __out PYORI_ALLOC_SIZE_T MatchOffset
+    );
+
 // *** RSRC.C ***
 
 __success(return)
@@ -3841,6 +6181,15 @@ YoriLibTrimNullTerminators(
     __in PYORI_STRING String
     );
 
+/**
+ Convert a single english character to its uppercase form.  This is
+ equivalent to @ref YoriLibUpcaseChar but is expanded inline, for loops that
+ process every character in a string.  The argument is evaluated more than
+ once.
+ */
+#define YoriLibUpcaseCharInline(c) \
+    ((TCHAR)((c) - (((DWORD)((c) - 'a') < 26)?('a' - 'A'):0)))
+
 TCHAR
 YoriLibUpcaseChar(
     __in TCHAR c
@@ -3915,6 +6264,9 @@ YoriLibRegexMatchIns(
     __inout PYORI_STRING Pattern
     );
 
+VOID
+YoriLibRegexMatchCleanupCache(VOID);
+
 YORI_ALLOC_SIZE_T
 YoriLibCntStringMatchChars(
     __in PYORI_STRING Str1,
@@ -3989,6 +6341,42 @@ YoriLibFindRightMostCharacter(
     __in TCHAR CharToFind
     );
 
+VOID
+YoriLibPrepareSubstringSearch(
+    __out PYORI_LIB_SUBSTRING_SEARCH Search,
+    __in PCYORI_STRING Needle,
+    __in BOOLEAN Insensitive
+    );
+
+__success(return)
+BOOLEAN
+YoriLibSubstringSearch(
+    __in PYORI_LIB_SUBSTRING_SEARCH Search,
+    __in PCYORI_STRING String,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    );
+
+__success(return)
+BOOLEAN
+YoriLibPrepareMultiSubstringSearch(
+    __out PYORI_LIB_MULTI_SUBSTRING_SEARCH Search,
+    __in YORI_ALLOC_SIZE_T NumberMatches,
+    __in PYORI_STRING MatchArray,
+    __in BOOLEAN Insensitive
+    );
+
+VOID
+YoriLibFreeMultiSubstringSearch(
+    __inout PYORI_LIB_MULTI_SUBSTRING_SEARCH Search
+    );
+
+PYORI_STRING
+YoriLibMultiSubstringSearch(
+    __in PYORI_LIB_MULTI_SUBSTRING_SEARCH Search,
+    __in PCYORI_STRING String,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    );
+
 __success(return)
 BOOL
 YoriLibStringToHexBuffer(
@@ -4046,6 +6434,12 @@ YoriLibSortStringArray(
     __in YORI_ALLOC_SIZE_T Count
     );
 
+VOID
+YoriLibStableSortStringArray(
+    __in_ecount(Count) PYORI_STRING StringArray,
+    __in YORI_ALLOC_SIZE_T Count
+    );
+
 BOOLEAN
 YoriLibStringConcat(
     __inout PYORI_STRING String,
@@ -4105,6 +6499,174 @@ YoriLibGetTempPath(
     __in YORI_ALLOC_SIZE_T ExtraChars
     );
 
+// *** THRDPOOL.C ***
+
+/**
+ Forward declaration of a pool of worker threads.
+ */
+typedef struct _YORI_LIB_THREAD_POOL *PYORI_LIB_THREAD_POOL;
+
+/**
+ Forward declaration of an item of work to execute on a thread pool.
+ */
+typedef struct _YORI_LIB_WORK_ITEM *PYORI_LIB_WORK_ITEM;
+
+/**
+ A prototype for a callback function to execute or complete an item of work.
+ */
+typedef VOID YORI_LIB_WORK_ITEM_FN(PYORI_LIB_THREAD_POOL Pool, PYORI_LIB_WORK_ITEM Item);
+
+/**
+ A pointer to a callback function to execute or complete an item of work.
+ */
+typedef YORI_LIB_WORK_ITEM_FN *PYORI_LIB_WORK_ITEM_FN;
+
+/**
+ An item of work to execute on a thread pool.  Callers typically embed this
+ in a larger structure describing the work, and use CONTAINING_RECORD from
+ the callbacks to find it.
+ */
+typedef struct _YORI_LIB_WORK_ITEM {
+
+    /**
+     The list of items awaiting completion in the order that they were
+     submitted.  This is only used if CompleteFn is specified.
+     */
+    YORI_LIST_ENTRY CompletionList;
+
+    /**
+     The function to execute on a worker thread.  Items execute in any
+     order and concurrently with each other.  If CompleteFn is NULL, this
+     function owns the item and may free it.
+     */
+    PYORI_LIB_WORK_ITEM_FN ExecuteFn;
+
+    /**
+     Optionally points to a function to call after ExecuteFn has returned.
+     Completion functions are called one at a time, in the order that items
+     were submitted, which allows results of parallel work to be output in
+     a deterministic order.  This function owns the item and may free it.
+     */
+    PYORI_LIB_WORK_ITEM_FN CompleteFn;
+
+    /**
+     Set to TRUE once ExecuteFn has returned.  Used internally to find items
+     that are ready for completion.
+     */
+    BOOLEAN Executed;
+
+} YORI_LIB_WORK_ITEM;
+
+__success(return)
+BOOLEAN
+YoriLibCreateThreadPool(
+    __in DWORD ThreadCount,
+    __in YORI_LIB_CPU_CLASS CpuClass,
+    __out PYORI_LIB_THREAD_POOL *Pool
+    );
+
+VOID
+YoriLibSubmitWorkItem(
+    __in PYORI_LIB_THREAD_POOL Pool,
+    __in PYORI_LIB_WORK_ITEM Item
+    );
+
+BOOLEAN
+YoriLibIsThreadPoolCancelled(
+    __in PYORI_LIB_THREAD_POOL Pool
+    );
+
+VOID
+YoriLibCancelThreadPool(
+    __in PYORI_LIB_THREAD_POOL Pool
+    );
+
+DWORD
+YoriLibGetThreadPoolThreadCount(
+    __in PYORI_LIB_THREAD_POOL Pool
+    );
+
+BOOLEAN
+YoriLibWaitForThreadPool(
+    __in PYORI_LIB_THREAD_POOL Pool
+    );
+
+VOID
+YoriLibDestroyThreadPool(
+    __in PYORI_LIB_THREAD_POOL Pool
+    );
+
+// *** TRACE.C ***
+
+/**
+ An event tracing keyword for directory enumeration.
+ */
+#define YORI_LIB_TRACE_FILEENUM                 (0x0000000000000001)
+
+/**
+ An event tracing keyword for reading lines from files and pipes.
+ */
+#define YORI_LIB_TRACE_LINEREAD                 (0x0000000000000002)
+
+/**
+ An event tracing keyword for HTTP requests.
+ */
+#define YORI_LIB_TRACE_HTTP                     (0x0000000000000004)
+
+/**
+ An event tracing keyword for launching child processes.
+ */
+#define YORI_LIB_TRACE_PROCESS                  (0x0000000000000008)
+
+/**
+ An event tracing keyword for cabinet operations.
+ */
+#define YORI_LIB_TRACE_CABINET                  (0x0000000000000010)
+
+/**
+ An event tracing keyword for file compression.
+ */
+#define YORI_LIB_TRACE_COMPRESS                 (0x0000000000000020)
+
+extern ULONGLONG YoriLibTraceEnabledKeywords;
+extern LONG YoriLibTraceRegistrationAttempted;
+
+BOOLEAN
+YoriLibTraceRegister(VOID);
+
+VOID
+YoriLibTraceWrite(
+    __in ULONGLONG Keyword,
+    __in LPCTSTR Operation,
+    __in BOOLEAN Begin,
+    __in_opt PCYORI_STRING Object,
+    __in DWORDLONG Size
+    );
+
+/**
+ Returns TRUE if a trace session is collecting events with the specified
+ keyword.  When no session is active this is a test of a global variable,
+ so trace points cost almost nothing.  The provider is registered the first
+ time any trace point is reached.
+ */
+#define YoriLibTraceIsEnabled(Keyword) \
+    (((YoriLibTraceEnabledKeywords & (Keyword)) != 0) || \
+     (YoriLibTraceRegistrationAttempted == 0 && YoriLibTraceRegister() && (YoriLibTraceEnabledKeywords & (Keyword)) != 0))
+
+/**
+ Write an event marking the beginning of an operation, if a trace session is
+ collecting events with the specified keyword.
+ */
+#define YoriLibTraceBegin(Keyword, Operation, Object, Size) \
+    (YoriLibTraceIsEnabled(Keyword) ? YoriLibTraceWrite((Keyword), (Operation), TRUE, (Object), (Size)) : (VOID)0)
+
+/**
+ Write an event marking the end of an operation, if a trace session is
+ collecting events with the specified keyword.
+ */
+#define YoriLibTraceEnd(Keyword, Operation, Object, Size) \
+    (YoriLibTraceIsEnabled(Keyword) ? YoriLibTraceWrite((Keyword), (Operation), FALSE, (Object), (Size)) : (VOID)0)
+
 // *** UPDATE.C ***
 
 /**
@@ -4121,6 +6683,50 @@ typedef enum {
     YoriLibUpdErrorMax
 } YORI_LIB_UPDATE_ERROR;
 
+/**
+ A prototype for a function to invoke periodically while a download is in
+ progress.  The first parameter is the number of bytes received, the second
+ is the length of the object or zero if it is not known, and the third is a
+ caller supplied context.
+ */
+typedef
+VOID
+YORI_LIB_UPDATE_PROGRESS_FN(DWORDLONG, DWORDLONG, PVOID);
+
+/**
+ A pointer to a function to invoke periodically while a download is in
+ progress.
+ */
+typedef YORI_LIB_UPDATE_PROGRESS_FN *PYORI_LIB_UPDATE_PROGRESS_FN;
+
+/**
+ Optional behavior when downloading a Url.
+ */
+typedef struct _YORI_LIB_UPDATE_OPTIONS {
+
+    /**
+     If not NULL, a handle to write the object to in order, such as a pipe.
+     The object is not stored in a local file, and no deltas are applied.
+     */
+    HANDLE OutputHandle;
+
+    /**
+     The maximum number of byte ranges to download concurrently, or zero to
+     use the default.  Only large objects are split into ranges.
+     */
+    DWORD SegmentCount;
+
+    /**
+     Optionally points to a function to call to indicate progress.
+     */
+    PYORI_LIB_UPDATE_PROGRESS_FN ProgressCallback;
+
+    /**
+     Context to pass to ProgressCallback.
+     */
+    PVOID ProgressContext;
+} YORI_LIB_UPDATE_OPTIONS, *PYORI_LIB_UPDATE_OPTIONS;
+
 YORI_LIB_UPDATE_ERROR
 YoriLibUpdateBinaryFromUrl(
     __in PCYORI_STRING Url,
@@ -4129,11 +6735,85 @@ YoriLibUpdateBinaryFromUrl(
     __in_opt PSYSTEMTIME IfModifiedSince
     );
 
+YORI_LIB_UPDATE_ERROR
+YoriLibUpdateBinaryFromUrlEx(
+    __in PCYORI_STRING Url,
+    __in_opt PCYORI_STRING TargetName,
+    __in PCYORI_STRING Agent,
+    __in_opt PSYSTEMTIME IfModifiedSince,
+    __in_opt PYORI_LIB_UPDATE_OPTIONS Options
+    );
+
 LPCTSTR
 YoriLibUpdateErrorString(
     __in YORI_LIB_UPDATE_ERROR Error
     );
 
+// *** USNENUM.C ***
+
+/**
+ A position within the change journal of a volume.  Changes after this
+ position can be enumerated later.  A zero filled checkpoint indicates that
+ no position is known.
+ */
+typedef struct _YORI_LIB_USN_CHECKPOINT {
+
+    /**
+     The identifier of the change journal.  If the journal is deleted and
+     recreated, this changes, and previous checkpoints are invalid.
+     */
+    DWORDLONG JournalId;
+
+    /**
+     The next USN that the journal would generate.
+     */
+    LONGLONG NextUsn;
+} YORI_LIB_USN_CHECKPOINT, *PYORI_LIB_USN_CHECKPOINT;
+
+/**
+ Indicates the changed object is a directory.
+ */
+#define YORI_LIB_USN_CHANGE_DIRECTORY           0x00000001
+
+/**
+ Indicates the changed object no longer exists at the reported path.
+ */
+#define YORI_LIB_USN_CHANGE_DELETED             0x00000002
+
+/**
+ Indicates the changed object was renamed or moved to the reported path.
+ */
+#define YORI_LIB_USN_CHANGE_RENAMED             0x00000004
+
+/**
+ A prototype for a callback function to invoke for each changed object.
+ The first parameter is the full path to the object, the second is a set
+ of YORI_LIB_USN_CHANGE_* flags, and the third is a caller supplied context.
+ */
+typedef BOOL YORI_LIB_USN_CHANGE_FN(PYORI_STRING FilePath, DWORD Flags, PVOID Context);
+
+/**
+ A pointer to a callback function to invoke for each changed object.
+ */
+typedef YORI_LIB_USN_CHANGE_FN *PYORI_LIB_USN_CHANGE_FN;
+
+__success(return)
+BOOL
+YoriLibUsnQueryCheckpoint(
+    __in PYORI_STRING Root,
+    __out PYORI_LIB_USN_CHECKPOINT Checkpoint
+    );
+
+__success(return)
+BOOL
+YoriLibUsnEnumerateChanges(
+    __in PYORI_STRING Root,
+    __inout PYORI_LIB_USN_CHECKPOINT Checkpoint,
+    __in PYORI_LIB_USN_CHANGE_FN Callback,
+    __in_opt PVOID Context,
+    __out_opt PBOOLEAN FullEnumeration
+    );
+
 // *** UTIL.C ***
 
 BOOL
@@ -4428,6 +7108,25 @@ YoriLibOutputString(
     __in PYORI_STRING String
     );
 
+BOOLEAN
+YoriLibEnableOutputBuffering(VOID);
+
+VOID
+YoriLibFlushOutput(VOID);
+
+VOID
+YoriLibDisableOutputBuffering(VOID);
+
+__success(return)
+BOOLEAN
+YoriLibBeginOutputCapture(VOID);
+
+__success(return)
+BOOLEAN
+YoriLibEndOutputCapture(
+    __out PYORI_STRING Output
+    );
+
 BOOL
 YoriLibVtSetConsoleTextAttrDev(
     __in HANDLE hOut,
@@ -242,6 +242,12 @@
  */
 #define __in_ecount_opt(x)
 
+/**
+ SAL annotation describing a buffer with a specified number of elements
+ which is populated on input and updated on output.
+ */
+#define __inout_ecount(x)
+
 /**
  SAL annotation describing an output buffer with a specified number of
  bytes.
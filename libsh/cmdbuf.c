@@ -204,7 +204,7 @@ YoriLibShCmdBufferPumpToNextProcess(
 
     while (TRUE) {
 
-        BytesToWrite = 4096;
+        BytesToWrite = YORI_LIBSH_PIPE_BUFFER_SIZE;
         AcquireMutex(ThisBuffer->Mutex);
         if (BytesSent + BytesToWrite > ThisBuffer->BytesPopulated) {
             BytesToWrite = ThisBuffer->BytesPopulated - BytesSent;
@@ -545,7 +545,7 @@ YoriLibShForwardProcessBufferToNextProcess(
 
     if (ExecContext->NextProgram != NULL &&
         ExecContext->NextProgram->StdInType == StdInTypePipe &&
-        CreatePipe(&ReadHandle, &WriteHandle, NULL, 0)) {
+        CreatePipe(&ReadHandle, &WriteHandle, NULL, YORI_LIBSH_PIPE_BUFFER_SIZE)) {
 
         ExecContext->NextProgram->StdIn.Pipe.PipeFromPriorProcess = ReadHandle;
 
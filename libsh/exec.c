@@ -3,7 +3,7 @@
  *
  * Yori shell helper routines for executing programs
  *
- * Copyright (c) 2017-2021 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -125,6 +125,7 @@ YoriLibShInitializeRedirection(
     SECURITY_ATTRIBUTES InheritHandle;
     HANDLE Handle;
     DWORD Error;
+    DWORD BufferPipeSize;
 
     ZeroMemory(&InheritHandle, sizeof(InheritHandle));
     InheritHandle.nLength = sizeof(InheritHandle);
@@ -146,6 +147,16 @@ YoriLibShInitializeRedirection(
         YoriLibCancelInheritedProcess();
     }
 
+    //
+    //  Output to a buffer is drained by a separate thread, so give the pipe
+    //  enough space that the writer is not constantly waiting for that
+    //  thread.  This matters for builtins, which write from the primary
+    //  thread, and for child processes when many execute concurrently and
+    //  compete with the draining threads for processors.
+    //
+
+    BufferPipeSize = YORI_LIBSH_PIPE_BUFFER_SIZE;
+
     Error = ERROR_SUCCESS;
 
     if (ExecContext->StdInType == StdInTypeFile) {
@@ -293,7 +304,7 @@ YoriLibShInitializeRedirection(
         HANDLE ReadHandle;
         HANDLE WriteHandle;
         HANDLE NewHandle;
-        if (CreatePipe(&ReadHandle, &WriteHandle, NULL, 0)) {
+        if (CreatePipe(&ReadHandle, &WriteHandle, NULL, BufferPipeSize)) {
 
             if (!YoriLibMakeInheritableHandle(WriteHandle, &NewHandle)) {
                 Error = GetLastError();
@@ -364,7 +375,7 @@ YoriLibShInitializeRedirection(
         HANDLE ReadHandle;
         HANDLE WriteHandle;
         HANDLE NewHandle;
-        if (CreatePipe(&ReadHandle, &WriteHandle, NULL, 0)) {
+        if (CreatePipe(&ReadHandle, &WriteHandle, NULL, BufferPipeSize)) {
 
             if (!YoriLibMakeInheritableHandle(WriteHandle, &NewHandle)) {
                 Error = GetLastError();
@@ -555,12 +566,15 @@ YoriLibShCreateProcess(
         return LastError;
     }
 
+    YoriLibTraceBegin(YORI_LIB_TRACE_PROCESS, _T("CreateProcess"), &ExecContext->CmdToExec.ArgV[0], 0);
     if (!CreateProcess(NULL, CmdLine.StartOfString, NULL, NULL, TRUE, CreationFlags, NULL, CurrentDirectory, &StartupInfo, &ProcessInfo)) {
         LastError = GetLastError();
+        YoriLibTraceEnd(YORI_LIB_TRACE_PROCESS, _T("CreateProcess"), &ExecContext->CmdToExec.ArgV[0], 0);
         YoriLibShRevertRedirection(&PreviousRedirectContext);
         YoriLibFreeStringContents(&CmdLine);
         return LastError;
     } else {
+        YoriLibTraceEnd(YORI_LIB_TRACE_PROCESS, _T("CreateProcess"), &ExecContext->CmdToExec.ArgV[0], ProcessInfo.dwProcessId);
         YoriLibShRevertRedirection(&PreviousRedirectContext);
     }
 
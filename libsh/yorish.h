@@ -25,6 +25,16 @@
  * THE SOFTWARE.
  */
 
+/**
+ The size of the pipes used to move data between a builtin command and the
+ shell owned buffer that captures its output, and from that buffer to the
+ next command in a pipeline.  Builtins execute on the shell's primary thread
+ and depend on process wide standard handles, so they cannot execute
+ concurrently with each other and their output is buffered in memory.  A
+ larger pipe allows each of these transfers to proceed in large chunks
+ rather than switching threads for every few kilobytes.
+ */
+#define YORI_LIBSH_PIPE_BUFFER_SIZE (64 * 1024)
 
 /**
  Information about each argument in an enumerated list of arguments.
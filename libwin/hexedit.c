@@ -29,6 +29,29 @@
 #include "yoriwin.h"
 #include "winpriv.h"
 
+/**
+ The maximum number of distinct modified ranges to track.  If more ranges
+ are modified, the closest ranges are combined, so the tracked ranges
+ describe more data than was modified.
+ */
+#define YORI_WIN_HEX_EDIT_MAX_MODIFIED_RANGES (32)
+
+/**
+ A range of bytes within a hex edit control that has been modified.
+ */
+typedef struct _YORI_WIN_HEX_EDIT_RANGE {
+
+    /**
+     The first byte in the range.
+     */
+    YORI_ALLOC_SIZE_T Start;
+
+    /**
+     The byte beyond the last byte in the range.
+     */
+    YORI_ALLOC_SIZE_T End;
+} YORI_WIN_HEX_EDIT_RANGE, *PYORI_WIN_HEX_EDIT_RANGE;
+
 /**
  Information about the selection region within a hex edit control.
  */
@@ -208,6 +231,26 @@ typedef struct _YORI_WIN_CTRL_HEX_EDIT {
      */
     UCHAR OffsetWidth;
 
+    /**
+     A value to add to each buffer offset when displaying it.  This allows
+     the buffer to describe a range within a larger object while displaying
+     offsets within that object.
+     */
+    YORI_MAX_UNSIGNED_T DisplayOffset;
+
+    /**
+     The number of entries in ModifiedRanges.
+     */
+    DWORD ModifiedRangeCount;
+
+    /**
+     The ranges of the buffer that have been modified since the modify
+     state was last reset, in ascending order.  Ranges never overlap or
+     touch.  One extra entry is present so a new range can be inserted
+     before the closest ranges are combined.
+     */
+    YORI_WIN_HEX_EDIT_RANGE ModifiedRanges[YORI_WIN_HEX_EDIT_MAX_MODIFIED_RANGES + 1];
+
     /**
      0 if the cursor is currently not visible.  20 for insert mode, 50 for
      overwrite mode.  Paint calculates the desired value and based on
@@ -1461,10 +1504,10 @@ YoriWinHexEditPaintSingleLine(
 
         if (HexEdit->OffsetWidth == 64) {
             DWORDLONG LongOffset;
-            LongOffset = Offset;
+            LongOffset = HexEdit->DisplayOffset + Offset;
             String.LengthInChars = YoriLibSPrintfS(String.StartOfString, String.LengthAllocated, _T("%08x`%08x: "), (DWORD)(LongOffset >> 32), (DWORD)LongOffset);
         } else if (HexEdit->OffsetWidth == 32) {
-            String.LengthInChars = YoriLibSPrintfS(String.StartOfString, String.LengthAllocated, _T("%08x: "), Offset);
+            String.LengthInChars = YoriLibSPrintfS(String.StartOfString, String.LengthAllocated, _T("%08x: "), (DWORD)(HexEdit->DisplayOffset + Offset));
         }
 
         for (ColumnIndex = 0; ColumnIndex < String.LengthInChars; ColumnIndex++) {
@@ -1688,6 +1731,99 @@ YoriWinHexEditExpandDirtyRange(
     }
 }
 
+/**
+ Record that a range of the buffer has been modified.  Operations that
+ change the length of the buffer should indicate that everything from the
+ change to the end of the buffer is modified.
+
+ @param HexEdit Pointer to the hex edit control.
+
+ @param Start Specifies the first byte that was modified.
+
+ @param End Specifies the byte beyond the last byte that was modified.
+ */
+VOID
+YoriWinHexEditMarkModified(
+    __in PYORI_WIN_CTRL_HEX_EDIT HexEdit,
+    __in YORI_ALLOC_SIZE_T Start,
+    __in YORI_ALLOC_SIZE_T End
+    )
+{
+    PYORI_WIN_HEX_EDIT_RANGE Ranges;
+    DWORD Index;
+    DWORD Merge;
+    DWORD Closest;
+    YORI_ALLOC_SIZE_T Gap;
+    YORI_ALLOC_SIZE_T ClosestGap;
+
+    if (End <= Start) {
+        return;
+    }
+
+    Ranges = HexEdit->ModifiedRanges;
+
+    //
+    //  Find the first range that ends at or after the new range, and
+    //  combine it with any range the new range overlaps or touches.
+    //
+
+    for (Index = 0; Index < HexEdit->ModifiedRangeCount; Index++) {
+        if (Ranges[Index].End >= Start) {
+            break;
+        }
+    }
+
+    for (Merge = Index; Merge < HexEdit->ModifiedRangeCount; Merge++) {
+        if (Ranges[Merge].Start > End) {
+            break;
+        }
+        if (Ranges[Merge].Start < Start) {
+            Start = Ranges[Merge].Start;
+        }
+        if (Ranges[Merge].End > End) {
+            End = Ranges[Merge].End;
+        }
+    }
+
+    if (Merge > Index) {
+        Ranges[Index].Start = Start;
+        Ranges[Index].End = End;
+        if (Merge > Index + 1) {
+            memmove(&Ranges[Index + 1], &Ranges[Merge], (HexEdit->ModifiedRangeCount - Merge) * sizeof(YORI_WIN_HEX_EDIT_RANGE));
+            HexEdit->ModifiedRangeCount = HexEdit->ModifiedRangeCount - (Merge - Index - 1);
+        }
+        return;
+    }
+
+    memmove(&Ranges[Index + 1], &Ranges[Index], (HexEdit->ModifiedRangeCount - Index) * sizeof(YORI_WIN_HEX_EDIT_RANGE));
+    Ranges[Index].Start = Start;
+    Ranges[Index].End = End;
+    HexEdit->ModifiedRangeCount++;
+
+    if (HexEdit->ModifiedRangeCount <= YORI_WIN_HEX_EDIT_MAX_MODIFIED_RANGES) {
+        return;
+    }
+
+    //
+    //  Too many ranges are being tracked, so combine the two that are
+    //  closest together.
+    //
+
+    Closest = 0;
+    ClosestGap = Ranges[1].Start - Ranges[0].End;
+    for (Index = 1; Index < HexEdit->ModifiedRangeCount - 1; Index++) {
+        Gap = Ranges[Index + 1].Start - Ranges[Index].End;
+        if (Gap < ClosestGap) {
+            ClosestGap = Gap;
+            Closest = Index;
+        }
+    }
+
+    Ranges[Closest].End = Ranges[Closest + 1].End;
+    memmove(&Ranges[Closest + 1], &Ranges[Closest + 2], (HexEdit->ModifiedRangeCount - Closest - 2) * sizeof(YORI_WIN_HEX_EDIT_RANGE));
+    HexEdit->ModifiedRangeCount--;
+}
+
 /**
  Modify the cursor location within the hex edit control.
 
@@ -1973,6 +2109,7 @@ YoriWinHexEditDeleteCell(
         case YoriWinHexEditCellTypeHexDigit:
             if (BitShift == 0) {
                 if (BufferOffset < HexEdit->BufferValid) {
+                    YoriWinHexEditMarkModified(HexEdit, BufferOffset, HexEdit->BufferValid);
                     BytesToCopy = HexEdit->BufferValid - BufferOffset;
                     if (BytesToCopy > HexEdit->BytesPerWord) {
                         BytesToCopy = BytesToCopy - HexEdit->BytesPerWord;
@@ -1999,6 +2136,7 @@ YoriWinHexEditDeleteCell(
                 InputChar = *Cell;
                 InputChar = (UCHAR)(InputChar & ~(BitMask));
                 *Cell = InputChar;
+                YoriWinHexEditMarkModified(HexEdit, BufferOffset, BufferOffset + 1);
 
                 YoriWinHexEditNextCellSameType(HexEdit, CellType, BufferOffset, BitShift, &CurrentLine, &CurrentCharOffset);
             }
@@ -2006,6 +2144,7 @@ YoriWinHexEditDeleteCell(
             break;
         case YoriWinHexEditCellTypeCharValue:
             if (BufferOffset < HexEdit->BufferValid) {
+                YoriWinHexEditMarkModified(HexEdit, BufferOffset, HexEdit->BufferValid);
                 BytesToCopy = HexEdit->BufferValid - BufferOffset;
                 if (BytesToCopy > 1) {
                     BytesToCopy = BytesToCopy - 1;
@@ -2112,6 +2251,7 @@ YoriWinHexEditEnsureBufferValid(
         return FALSE;
     }
     ZeroMemory(YoriLibAddToPointer(HexEdit->Buffer, HexEdit->BufferValid), (DWORD)(NewBufferLength - HexEdit->BufferValid));
+    YoriWinHexEditMarkModified(HexEdit, HexEdit->BufferValid, NewBufferLength);
     HexEdit->BufferValid = NewBufferLength;
     return TRUE;
 }
@@ -2156,6 +2296,7 @@ YoriWinHexEditInsertSpaceInBuffer(
 
     ZeroMemory(&HexEdit->Buffer[BufferOffset], BytesToInsert);
     HexEdit->BufferValid = HexEdit->BufferValid + BytesToInsert;
+    YoriWinHexEditMarkModified(HexEdit, BufferOffset, HexEdit->BufferValid);
     ASSERT(HexEdit->BufferValid <= HexEdit->BufferAllocated);
 
     return TRUE;
@@ -2275,6 +2416,7 @@ YoriWinHexEditInsertCell(
             InputChar = (UCHAR)(InputChar & ~(BitMask));
             InputChar = (UCHAR)(InputChar | (NewNibble << EditBitShift));
             *Cell = InputChar;
+            YoriWinHexEditMarkModified(HexEdit, EditBufferOffset, EditBufferOffset + 1);
             CellUpdated = TRUE;
 
             break;
@@ -2402,6 +2544,7 @@ YoriWinHexEditOverwriteCell(
             InputChar = (UCHAR)(InputChar & ~(BitMask));
             InputChar = (UCHAR)(InputChar | (NewNibble << EditBitShift));
             *Cell = InputChar;
+            YoriWinHexEditMarkModified(HexEdit, EditBufferOffset, EditBufferOffset + 1);
             CellUpdated = TRUE;
 
             break;
@@ -2415,6 +2558,7 @@ YoriWinHexEditOverwriteCell(
             }
             Cell = YoriLibAddToPointer(HexEdit->Buffer, EditBufferOffset);
             *Cell = InputChar;
+            YoriWinHexEditMarkModified(HexEdit, EditBufferOffset, EditBufferOffset + 1);
             CellUpdated = TRUE;
             break;
     }
@@ -2471,6 +2615,7 @@ YoriWinHexEditSetDataNoCopy(
     HexEdit->Buffer = NewBuffer;
     HexEdit->BufferAllocated = NewBufferAllocated;
     HexEdit->BufferValid = NewBufferValid;
+    HexEdit->ModifiedRangeCount = 0;
 
     //
     //  Mark the whole range as dirty.  We didn't bother to count how many
@@ -3275,6 +3420,7 @@ YoriWinHexEditClear(
     }
     HexEdit->BufferAllocated = 0;
     HexEdit->BufferValid = 0;
+    HexEdit->ModifiedRangeCount = 0;
 
     HexEdit->ViewportTop = 0;
     HexEdit->ViewportLeft = 0;
@@ -3356,6 +3502,17 @@ YoriWinHexEditSetModifyState(
 
     PreviousValue = HexEdit->UserModified;
     HexEdit->UserModified = ModifyState;
+
+    //
+    //  If the caller is indicating the buffer is modified and the control
+    //  has no record of which parts changed, assume all of it did.
+    //
+
+    if (!ModifyState) {
+        HexEdit->ModifiedRangeCount = 0;
+    } else if (HexEdit->ModifiedRangeCount == 0) {
+        YoriWinHexEditMarkModified(HexEdit, 0, HexEdit->BufferValid);
+    }
     return PreviousValue;
 }
 
@@ -3383,6 +3540,68 @@ YoriWinHexEditGetModifyState(
     return HexEdit->UserModified;
 }
 
+/**
+ Return one of the ranges of the buffer that has been modified since the
+ last time @ref YoriWinHexEditSetModifyState indicated that no user
+ modification has occurred.  Ranges are returned in ascending order and do
+ not overlap.  A caller can enumerate all ranges by starting with an index
+ of zero and incrementing it until this function returns FALSE.
+
+ @param CtrlHandle Pointer to the hex edit control.
+
+ @param Index Specifies the index of the range to return.
+
+ @param RangeStart On successful completion, updated to contain the offset
+        of the first modified byte in the range.
+
+ @param RangeLength On successful completion, updated to contain the number
+        of bytes in the range.
+
+ @return TRUE to indicate a range was returned, FALSE if no range exists at
+         the specified index.
+ */
+__success(return)
+BOOLEAN
+YoriWinHexEditGetModifiedRange(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in DWORD Index,
+    __out PYORI_ALLOC_SIZE_T RangeStart,
+    __out PYORI_ALLOC_SIZE_T RangeLength
+    )
+{
+    PYORI_WIN_CTRL Ctrl;
+    PYORI_WIN_CTRL_HEX_EDIT HexEdit;
+    PYORI_WIN_HEX_EDIT_RANGE Range;
+    YORI_ALLOC_SIZE_T End;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    HexEdit = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_HEX_EDIT, Ctrl);
+
+    if (Index >= HexEdit->ModifiedRangeCount) {
+        return FALSE;
+    }
+
+    //
+    //  Ranges that describe a change in length can extend beyond the
+    //  current end of the buffer, so only return the part that still
+    //  exists.
+    //
+
+    Range = &HexEdit->ModifiedRanges[Index];
+    if (Range->Start >= HexEdit->BufferValid) {
+        return FALSE;
+    }
+
+    End = Range->End;
+    if (End > HexEdit->BufferValid) {
+        End = HexEdit->BufferValid;
+    }
+
+    *RangeStart = Range->Start;
+    *RangeLength = End - Range->Start;
+    return TRUE;
+}
+
 /**
  Set a function to call when the cursor location changes.
 
@@ -3685,6 +3904,7 @@ YoriWinHexEditDeleteData(
         LengthToRemove = HexEdit->BufferValid - DataOffset;
     }
 
+    YoriWinHexEditMarkModified(HexEdit, DataOffset, HexEdit->BufferValid);
     if (HexEdit->BufferValid > DataOffset + LengthToRemove) {
         memmove(&HexEdit->Buffer[DataOffset],
                 &HexEdit->Buffer[DataOffset + LengthToRemove],
@@ -3782,6 +4002,8 @@ YoriWinHexEditReplaceData(
             Data,
             (DWORD)Length);
 
+    YoriWinHexEditMarkModified(HexEdit, DataOffset, DataOffset + Length);
+
     FirstDirtyLine = (YORI_ALLOC_SIZE_T)(DataOffset / HexEdit->BytesPerLine);
     LastDirtyLine = (YORI_ALLOC_SIZE_T)((DataOffset + Length) / HexEdit->BytesPerLine);
     YoriWinHexEditExpandDirtyRange(HexEdit, FirstDirtyLine, LastDirtyLine);
@@ -5228,6 +5450,38 @@ YoriWinHexEditSetReadOnly(
     return TRUE;
 }
 
+/**
+ Set the value to add to each buffer offset when displaying it.  This is
+ used when the buffer contains a range within a larger object, so that
+ displayed offsets refer to the location within that object.
+
+ @param CtrlHandle Pointer to the hex edit control.
+
+ @param DisplayOffset Specifies the offset within the larger object of the
+        first byte in the buffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+YoriWinHexEditSetDisplayOffset(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in YORI_MAX_UNSIGNED_T DisplayOffset
+    )
+{
+    PYORI_WIN_CTRL Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    PYORI_WIN_CTRL_HEX_EDIT HexEdit;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    HexEdit = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_HEX_EDIT, Ctrl);
+    if (HexEdit->DisplayOffset != DisplayOffset) {
+        HexEdit->DisplayOffset = DisplayOffset;
+        YoriWinHexEditExpandDirtyRange(HexEdit, 0, (YORI_ALLOC_SIZE_T)-1);
+        YoriWinHexEditPaint(HexEdit);
+    }
+
+    return TRUE;
+}
+
 /**
  Set the cursor to a specific point, expressed in terms of a buffer offset
  and bit shift.  Bit shift is only meaningful when the cell type refers to
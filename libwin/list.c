@@ -3,7 +3,7 @@
  *
  * Yori display a list box control
  *
- * Copyright (c) 2019-2020 Malcolm J. Smith
+ * Copyright (c) 2019-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -60,6 +60,26 @@ typedef struct _YORI_WIN_CTRL_LIST {
      */
     YORI_WIN_ITEM_ARRAY ItemArray;
 
+    /**
+     If non-NULL, the list is virtual, and this function is invoked to
+     obtain the text of each item as it is displayed.  ItemArray is not used
+     while this is set.
+     */
+    PYORI_WIN_LIST_GET_ITEM_TEXT VirtualItemCallback;
+
+    /**
+     If non-NULL, this function is invoked to query or change whether an
+     item in a virtual multiple selection list is selected.  The caller
+     stores the selection state, since there is no item array entry to
+     record it in.
+     */
+    PYORI_WIN_LIST_TOGGLE_ITEM_SELECTED VirtualSelectCallback;
+
+    /**
+     The number of items in a virtual list.
+     */
+    YORI_ALLOC_SIZE_T VirtualItemCount;
+
     /**
      A string of keystrokes that the user has entered indicating the item to
      find.
@@ -149,6 +169,113 @@ typedef struct _YORI_WIN_CTRL_LIST {
 
 } YORI_WIN_CTRL_LIST, *PYORI_WIN_CTRL_LIST;
 
+/**
+ Return the number of items in the list, whether these are held in the item
+ array or supplied on demand by a virtual list.
+
+ @param List Pointer to the list control.
+
+ @return The number of items in the list.
+ */
+YORI_ALLOC_SIZE_T
+YoriWinListItemCount(
+    __in PYORI_WIN_CTRL_LIST List
+    )
+{
+    if (List->VirtualItemCallback != NULL) {
+        return List->VirtualItemCount;
+    }
+
+    return List->ItemArray.Count;
+}
+
+/**
+ Obtain an item from the list.  For a list populated from an item array,
+ this returns the entry within the array.  For a virtual list, the callback
+ is invoked to populate a caller provided entry.  Either way, the caller
+ should call @ref YoriWinListReleaseItem when it has finished with the item.
+
+ @param List Pointer to the list control.
+
+ @param Index Specifies the index of the item to return.
+
+ @param Scratch Pointer to an entry which can be populated if the list is
+        virtual.
+
+ @return Pointer to the item.
+ */
+PYORI_WIN_ITEM_ENTRY
+YoriWinListGetItem(
+    __in PYORI_WIN_CTRL_LIST List,
+    __in YORI_ALLOC_SIZE_T Index,
+    __out PYORI_WIN_ITEM_ENTRY Scratch
+    )
+{
+    if (List->VirtualItemCallback == NULL) {
+        ASSERT(Index < List->ItemArray.Count);
+        return &List->ItemArray.Items[Index];
+    }
+
+    ASSERT(Index < List->VirtualItemCount);
+    Scratch->Flags = 0;
+    if (List->VirtualSelectCallback != NULL &&
+        List->VirtualSelectCallback(&List->Ctrl, Index, FALSE)) {
+
+        Scratch->Flags = YORI_WIN_ITEM_SELECTED;
+    }
+    YoriLibInitEmptyString(&Scratch->String);
+    if (!List->VirtualItemCallback(&List->Ctrl, Index, &Scratch->String)) {
+        YoriLibFreeStringContents(&Scratch->String);
+    }
+    return Scratch;
+}
+
+/**
+ Indicate that the caller has finished with an item returned from
+ @ref YoriWinListGetItem .
+
+ @param List Pointer to the list control.
+
+ @param Element Pointer to the item.
+ */
+VOID
+YoriWinListReleaseItem(
+    __in PYORI_WIN_CTRL_LIST List,
+    __in PYORI_WIN_ITEM_ENTRY Element
+    )
+{
+    if (List->VirtualItemCallback != NULL) {
+        YoriLibFreeStringContents(&Element->String);
+    }
+}
+
+/**
+ Toggle whether an item in a multiple selection list is selected.
+
+ @param List Pointer to the list control.
+
+ @param Index Specifies the index of the item to toggle.
+ */
+VOID
+YoriWinListToggleItemSelected(
+    __in PYORI_WIN_CTRL_LIST List,
+    __in YORI_ALLOC_SIZE_T Index
+    )
+{
+    PYORI_WIN_ITEM_ENTRY Element;
+
+    ASSERT(Index < YoriWinListItemCount(List));
+    if (List->VirtualItemCallback != NULL) {
+        if (List->VirtualSelectCallback != NULL) {
+            List->VirtualSelectCallback(&List->Ctrl, Index, TRUE);
+        }
+        return;
+    }
+
+    Element = &List->ItemArray.Items[Index];
+    Element->Flags = Element->Flags ^ YORI_WIN_ITEM_SELECTED;
+}
+
 /**
  Move the first displayed option in the list to ensure that the currently
  selected item is within the display.
@@ -174,8 +301,8 @@ YoriWinListEnsureActiveItemVisible(
         ElementCountToDisplay = ClientSize.Y;
     }
 
-    if (List->ItemArray.Count < ElementCountToDisplay) {
-        ElementCountToDisplay = (WORD)List->ItemArray.Count;
+    if (YoriWinListItemCount(List) < ElementCountToDisplay) {
+        ElementCountToDisplay = (WORD)YoriWinListItemCount(List);
     }
 
     if (List->ActiveOption < List->FirstDisplayedOption) {
@@ -183,12 +310,12 @@ YoriWinListEnsureActiveItemVisible(
     }
 
     if (List->FirstDisplayedOption > 0 &&
-        List->FirstDisplayedOption + ElementCountToDisplay > List->ItemArray.Count) {
+        List->FirstDisplayedOption + ElementCountToDisplay > YoriWinListItemCount(List)) {
 
-        if (List->ItemArray.Count < ElementCountToDisplay) {
+        if (YoriWinListItemCount(List) < ElementCountToDisplay) {
             List->FirstDisplayedOption = 0;
         } else {
-            List->FirstDisplayedOption = (WORD)(List->ItemArray.Count - ElementCountToDisplay);
+            List->FirstDisplayedOption = (WORD)(YoriWinListItemCount(List) - ElementCountToDisplay);
         }
     }
 
@@ -308,6 +435,7 @@ YoriWinListPaintVerticalList(
     WORD Attributes;
     WORD WindowAttributes;
     PYORI_WIN_ITEM_ENTRY Element;
+    YORI_WIN_ITEM_ENTRY VirtualElement;
     COORD ClientSize;
     YORI_STRING DisplayCells;
     YORI_STRING VisibleString;
@@ -323,14 +451,14 @@ YoriWinListPaintVerticalList(
     YoriWinGetControlClientSize(&List->Ctrl, &ClientSize);
     ElementCountToDisplay = ClientSize.Y;
 
-    if (List->ItemArray.Count < ElementCountToDisplay) {
-        ElementCountToDisplay = (WORD)List->ItemArray.Count;
+    if (YoriWinListItemCount(List) < ElementCountToDisplay) {
+        ElementCountToDisplay = (WORD)YoriWinListItemCount(List);
     }
 
     MaxCharsToDisplay = YoriWinListGetVisibleCellCountPerItem(List);
 
     for (RowIndex = 0; RowIndex < ElementCountToDisplay; RowIndex++) {
-        Element = &List->ItemArray.Items[List->FirstDisplayedOption + RowIndex];
+        Element = YoriWinListGetItem(List, List->FirstDisplayedOption + RowIndex, &VirtualElement);
         Attributes = WindowAttributes;
         if (List->ItemActive &&
             RowIndex + List->FirstDisplayedOption == List->ActiveOption) {
@@ -338,6 +466,23 @@ YoriWinListPaintVerticalList(
             Attributes = List->ActiveAttributes;
         }
 
+        //
+        //  A virtual list only knows the length of items that have been
+        //  displayed, so extend the horizontal range as longer items are
+        //  found.
+        //
+
+        if (List->VirtualItemCallback != NULL &&
+            Element->String.LengthInChars > 0) {
+
+            YORI_ALLOC_SIZE_T ThisLength;
+            YoriWinTextDisplayCellOffsetFromBufferOffset(WinMgrHandle, &Element->String, 1, Element->String.LengthInChars - 1, &ThisLength);
+            ThisLength = ThisLength + 2;
+            if (ThisLength > List->LongestItemLength) {
+                List->LongestItemLength = ThisLength;
+            }
+        }
+
         YoriWinTextBufferOffsetFromDisplayCellOffset(WinMgrHandle,
                                                      &Element->String,
                                                      1,
@@ -388,6 +533,7 @@ YoriWinListPaintVerticalList(
             }
         }
         YoriLibFreeStringContents(&DisplayCells);
+        YoriWinListReleaseItem(List, Element);
     }
 
     //
@@ -426,8 +572,8 @@ YoriWinListPaintVerticalList(
 
     if (List->VScrollCtrl) {
         DWORD MaximumTopValue;
-        if (List->ItemArray.Count > (DWORD)ClientSize.Y) {
-            MaximumTopValue = List->ItemArray.Count - ClientSize.Y;
+        if (YoriWinListItemCount(List) > (DWORD)ClientSize.Y) {
+            MaximumTopValue = YoriWinListItemCount(List) - ClientSize.Y;
         } else {
             MaximumTopValue = 0;
         }
@@ -489,6 +635,7 @@ YoriWinListPaintHorizontalList(
     WORD Attributes;
     WORD WindowAttributes;
     PYORI_WIN_ITEM_ENTRY Element;
+    YORI_WIN_ITEM_ENTRY VirtualElement;
     COORD ClientSize;
     YORI_STRING DisplayLine;
     PYORI_WIN_WINDOW TopLevelWindow;
@@ -501,12 +648,12 @@ YoriWinListPaintHorizontalList(
     YoriWinGetControlClientSize(&List->Ctrl, &ClientSize);
     ElementCountToDisplay = (WORD)(ClientSize.X / List->HorizontalItemWidth);
 
-    if (List->ItemArray.Count < ElementCountToDisplay) {
-        ElementCountToDisplay = (WORD)List->ItemArray.Count;
+    if (YoriWinListItemCount(List) < ElementCountToDisplay) {
+        ElementCountToDisplay = (WORD)YoriWinListItemCount(List);
     }
 
     for (RowIndex = 0; RowIndex < ElementCountToDisplay; RowIndex++) {
-        Element = &List->ItemArray.Items[List->FirstDisplayedOption + RowIndex];
+        Element = YoriWinListGetItem(List, List->FirstDisplayedOption + RowIndex, &VirtualElement);
         CellOffset = (WORD)(List->HorizontalItemWidth * RowIndex);
         Attributes = WindowAttributes;
         if (List->ItemActive &&
@@ -552,6 +699,7 @@ YoriWinListPaintHorizontalList(
             }
         }
         YoriLibFreeStringContents(&DisplayLine);
+        YoriWinListReleaseItem(List, Element);
     }
 
     //
@@ -618,11 +766,20 @@ YoriWinListRecalculateLongestItem(
     PYORI_WIN_WINDOW TopLevelWindow;
     PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgrHandle;
 
+    //
+    //  A virtual list discovers the length of items as they are displayed,
+    //  since enumerating every item is what a virtual list avoids.
+    //
+
+    if (List->VirtualItemCallback != NULL) {
+        return;
+    }
+
     TopLevelWindow = YoriWinGetTopLevelWindow(List->Ctrl.Parent);
     WinMgrHandle = YoriWinGetWindowManagerHandle(TopLevelWindow);
 
     LongestItemLength = 0;
-    for (Index = 0; Index < List->ItemArray.Count; Index++) {
+    for (Index = 0; Index < YoriWinListItemCount(List); Index++) {
         Text = &List->ItemArray.Items[Index].String;
         YoriWinTextDisplayCellOffsetFromBufferOffset(WinMgrHandle, Text, 1, Text->LengthInChars - 1, &ThisLength);
         ThisLength = ThisLength + 2;
@@ -654,6 +811,8 @@ YoriWinListClearAllItems(
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
     YoriWinItemArrayCleanup(&List->ItemArray);
+    List->VirtualItemCallback = NULL;
+    List->VirtualItemCount = 0;
     List->FirstDisplayedOption = 0;
     List->ActiveOption = 0;
     if (List->ItemActive) {
@@ -722,16 +881,16 @@ YoriWinListNotifyVScrollChange(
     ElementCountToDisplay = ClientSize.Y;
 
     ScrollValue = YoriWinScrollBarGetPosition(ScrollCtrl);
-    ASSERT(ScrollValue <= List->ItemArray.Count);
-    if (ScrollValue + ElementCountToDisplay > List->ItemArray.Count) {
-        if (List->ItemArray.Count >= ElementCountToDisplay) {
-            List->FirstDisplayedOption = List->ItemArray.Count - ElementCountToDisplay;
+    ASSERT(ScrollValue <= YoriWinListItemCount(List));
+    if (ScrollValue + ElementCountToDisplay > YoriWinListItemCount(List)) {
+        if (YoriWinListItemCount(List) >= ElementCountToDisplay) {
+            List->FirstDisplayedOption = YoriWinListItemCount(List) - ElementCountToDisplay;
         } else {
             List->FirstDisplayedOption = 0;
         }
     } else {
 
-        if (ScrollValue < List->ItemArray.Count) {
+        if (ScrollValue < YoriWinListItemCount(List)) {
             List->FirstDisplayedOption = (YORI_ALLOC_SIZE_T)ScrollValue;
         }
     }
@@ -769,9 +928,9 @@ YoriWinListNotifyMouseWheel(
             List->FirstDisplayedOption = List->FirstDisplayedOption - LinesToMove;
         }
     } else {
-        if (List->FirstDisplayedOption + LinesToMove + ElementCountToDisplay > List->ItemArray.Count) {
-            if (List->ItemArray.Count >= ElementCountToDisplay) {
-                List->FirstDisplayedOption = List->ItemArray.Count - ElementCountToDisplay;
+        if (List->FirstDisplayedOption + LinesToMove + ElementCountToDisplay > YoriWinListItemCount(List)) {
+            if (YoriWinListItemCount(List) >= ElementCountToDisplay) {
+                List->FirstDisplayedOption = YoriWinListItemCount(List) - ElementCountToDisplay;
             } else {
                 List->FirstDisplayedOption = 0;
             }
@@ -814,7 +973,7 @@ YoriWinListGetItemSelectedByMouseLocation(
         ItemRelativeToFirstDisplayed = MousePos.Y;
     }
 
-    if (ItemRelativeToFirstDisplayed + List->FirstDisplayedOption < List->ItemArray.Count) {
+    if (ItemRelativeToFirstDisplayed + List->FirstDisplayedOption < YoriWinListItemCount(List)) {
         *SelectedItem = ItemRelativeToFirstDisplayed + List->FirstDisplayedOption;
         return TRUE;
     }
@@ -822,6 +981,37 @@ YoriWinListGetItemSelectedByMouseLocation(
     return FALSE;
 }
 
+/**
+ Check whether an item in the list starts with the string that the user has
+ typed.
+
+ @param List Pointer to the list control.
+
+ @param Index Specifies the index of the item to check.
+
+ @return TRUE if the item matches, FALSE if it does not.
+ */
+BOOLEAN
+YoriWinListDoesItemMatchSearch(
+    __in PYORI_WIN_CTRL_LIST List,
+    __in YORI_ALLOC_SIZE_T Index
+    )
+{
+    PYORI_WIN_ITEM_ENTRY Element;
+    YORI_WIN_ITEM_ENTRY VirtualElement;
+    BOOLEAN Match;
+
+    Match = FALSE;
+    Element = YoriWinListGetItem(List, Index, &VirtualElement);
+    if (Element->String.LengthInChars > 0 &&
+        YoriLibCompareStringInsCnt(&List->SearchString, &Element->String, List->SearchString.LengthInChars) == 0) {
+
+        Match = TRUE;
+    }
+    YoriWinListReleaseItem(List, Element);
+    return Match;
+}
+
 /**
  Given a user pressed character, look for an item in the list that starts with
  the character.  This might get smarter for consecutive characters someday.
@@ -840,7 +1030,6 @@ YoriWinListFindItemByChar(
     )
 {
     YORI_ALLOC_SIZE_T Index;
-    PYORI_WIN_ITEM_ENTRY Element;
     DWORD CurrentTick;
 
     //
@@ -875,11 +1064,8 @@ YoriWinListFindItemByChar(
 
     if (!List->ItemActive) {
 
-        for (Index = 0; Index < List->ItemArray.Count; Index++) {
-            Element = &List->ItemArray.Items[Index];
-            if (Element->String.LengthInChars > 0 &&
-                YoriLibCompareStringInsCnt(&List->SearchString, &Element->String, List->SearchString.LengthInChars) == 0) {
-
+        for (Index = 0; Index < YoriWinListItemCount(List); Index++) {
+            if (YoriWinListDoesItemMatchSearch(List, Index)) {
                 List->ItemActive = TRUE;
                 List->ActiveOption = Index;
                 return TRUE;
@@ -888,21 +1074,15 @@ YoriWinListFindItemByChar(
 
     } else {
 
-        for (Index = List->ActiveOption; Index < List->ItemArray.Count; Index++) {
-            Element = &List->ItemArray.Items[Index];
-            if (Element->String.LengthInChars > 0 &&
-                YoriLibCompareStringInsCnt(&List->SearchString, &Element->String, List->SearchString.LengthInChars) == 0) {
-
+        for (Index = List->ActiveOption; Index < YoriWinListItemCount(List); Index++) {
+            if (YoriWinListDoesItemMatchSearch(List, Index)) {
                 List->ActiveOption = Index;
                 return TRUE;
             }
         }
 
         for (Index = 0; Index < List->ActiveOption; Index++) {
-            Element = &List->ItemArray.Items[Index];
-            if (Element->String.LengthInChars > 0 &&
-                YoriLibCompareStringInsCnt(&List->SearchString, &Element->String, List->SearchString.LengthInChars) == 0) {
-
+            if (YoriWinListDoesItemMatchSearch(List, Index)) {
                 List->ActiveOption = Index;
                 return TRUE;
             }
@@ -951,7 +1131,7 @@ YoriWinListEventHandler(
                             }
                             YoriWinListPaint(List);
                         }
-                    } else if (List->ItemArray.Count > 0) {
+                    } else if (YoriWinListItemCount(List) > 0) {
                         List->ItemActive = TRUE;
                         List->ActiveOption = 0;
                         YoriWinListEnsureActiveItemVisible(List);
@@ -963,7 +1143,7 @@ YoriWinListEventHandler(
                 } else if (Event->KeyDown.VirtualKeyCode == VK_DOWN ||
                     (List->HorizontalDisplay && Event->KeyDown.VirtualKeyCode == VK_RIGHT)) {
                     if (List->ItemActive) {
-                        if (List->ActiveOption + 1 < List->ItemArray.Count) {
+                        if (List->ActiveOption + 1 < YoriWinListItemCount(List)) {
                             List->ActiveOption++;
                             YoriWinListEnsureActiveItemVisible(List);
                             if (List->SelectionChangeCallback) {
@@ -971,7 +1151,7 @@ YoriWinListEventHandler(
                             }
                             YoriWinListPaint(List);
                         }
-                    } else if (List->ItemArray.Count > 0) {
+                    } else if (YoriWinListItemCount(List) > 0) {
                         List->ItemActive = TRUE;
                         List->ActiveOption = 0;
                         YoriWinListEnsureActiveItemVisible(List);
@@ -993,7 +1173,7 @@ YoriWinListEventHandler(
                         } else {
                             List->ActiveOption = 0;
                         }
-                    } else if (List->ItemArray.Count > 0) {
+                    } else if (YoriWinListItemCount(List) > 0) {
                         List->ItemActive = TRUE;
                         List->ActiveOption = 0;
                     }
@@ -1009,14 +1189,14 @@ YoriWinListEventHandler(
                         YoriWinGetControlClientSize(&List->Ctrl, &ClientSize);
                         ElementCountToDisplay = ClientSize.Y;
                         if (List->ActiveOption < List->FirstDisplayedOption + ElementCountToDisplay - 1 &&
-                            List->FirstDisplayedOption + ElementCountToDisplay - 1 < List->ItemArray.Count) {
+                            List->FirstDisplayedOption + ElementCountToDisplay - 1 < YoriWinListItemCount(List)) {
                             List->ActiveOption = List->FirstDisplayedOption + ElementCountToDisplay - 1;
-                        } else if (List->ActiveOption + ElementCountToDisplay < List->ItemArray.Count) {
+                        } else if (List->ActiveOption + ElementCountToDisplay < YoriWinListItemCount(List)) {
                             List->ActiveOption = List->ActiveOption + ElementCountToDisplay;
                         } else {
-                            List->ActiveOption = List->ItemArray.Count - 1;
+                            List->ActiveOption = YoriWinListItemCount(List) - 1;
                         }
-                    } else if (List->ItemArray.Count > 0) {
+                    } else if (YoriWinListItemCount(List) > 0) {
                         List->ItemActive = TRUE;
                         List->ActiveOption = 0;
                     }
@@ -1042,11 +1222,8 @@ YoriWinListEventHandler(
                 } else if (Event->KeyDown.Char == ' ' &&
                            List->ItemActive &&
                            List->MultiSelect) {
-                    PYORI_WIN_ITEM_ENTRY Element;
 
-                    ASSERT(List->ActiveOption < List->ItemArray.Count);
-                    Element = &List->ItemArray.Items[List->ActiveOption];
-                    Element->Flags = Element->Flags ^ YORI_WIN_ITEM_SELECTED;
+                    YoriWinListToggleItemSelected(List, List->ActiveOption);
                     if (List->SelectionChangeCallback) {
                         List->SelectionChangeCallback(&List->Ctrl);
                     }
@@ -1065,13 +1242,10 @@ YoriWinListEventHandler(
         case YoriWinEventMouseDownInClient:
 
             if (YoriWinListGetItemSelectedByMouseLocation(List, Event->MouseDown.Location, &NewOption)) {
-                PYORI_WIN_ITEM_ENTRY Element;
 
                 List->ItemActive = TRUE;
                 if (List->ActiveOption == NewOption && List->MultiSelect) {
-
-                    Element = &List->ItemArray.Items[List->ActiveOption];
-                    Element->Flags = Element->Flags ^ YORI_WIN_ITEM_SELECTED;
+                    YoriWinListToggleItemSelected(List, List->ActiveOption);
                 }
                 List->ActiveOption = NewOption;
                 if (List->SelectionChangeCallback) {
@@ -1084,13 +1258,11 @@ YoriWinListEventHandler(
         case YoriWinEventMouseDoubleClickInClient:
             if (YoriWinListGetItemSelectedByMouseLocation(List, Event->MouseDown.Location, &NewOption)) {
                 YORI_WIN_EVENT DefaultEvent;
-                PYORI_WIN_ITEM_ENTRY Element;
 
                 List->ItemActive = TRUE;
                 List->ActiveOption = NewOption;
                 if (List->MultiSelect) {
-                    Element = &List->ItemArray.Items[List->ActiveOption];
-                    Element->Flags = Element->Flags ^ YORI_WIN_ITEM_SELECTED;
+                    YoriWinListToggleItemSelected(List, List->ActiveOption);
                 }
 
                 if (List->SelectionChangeCallback) {
@@ -1181,7 +1353,7 @@ YoriWinListGetItemCount(
     PYORI_WIN_CTRL_LIST List;
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
-    return List->ItemArray.Count;
+    return YoriWinListItemCount(List);
 }
 
 /**
@@ -1233,7 +1405,7 @@ YoriWinListSetActiveOption(
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
-    if (ActiveOption < List->ItemArray.Count) {
+    if (ActiveOption < YoriWinListItemCount(List)) {
         List->ItemActive = TRUE;
         List->ActiveOption = ActiveOption;
         YoriWinListEnsureActiveItemVisible(List);
@@ -1269,9 +1441,15 @@ YoriWinListIsOptionSelected(
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
-    if (Index < List->ItemArray.Count) {
+    if (Index < YoriWinListItemCount(List)) {
         if (List->MultiSelect) {
-            if (List->ItemArray.Items[Index].Flags & YORI_WIN_ITEM_SELECTED) {
+            if (List->VirtualItemCallback != NULL) {
+                if (List->VirtualSelectCallback != NULL &&
+                    List->VirtualSelectCallback(&List->Ctrl, Index, FALSE)) {
+
+                    return TRUE;
+                }
+            } else if (List->ItemArray.Items[Index].Flags & YORI_WIN_ITEM_SELECTED) {
                 return TRUE;
             }
         } else {
@@ -1310,6 +1488,10 @@ YoriWinListAddItems(
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
+    if (List->VirtualItemCallback != NULL) {
+        return FALSE;
+    }
+
     if (!YoriWinItemArrayAddItems(&List->ItemArray, ListOptions, NumberOptions)) {
         return FALSE;
     }
@@ -1343,6 +1525,10 @@ YoriWinListAddItemArray(
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
+    if (List->VirtualItemCallback != NULL) {
+        return FALSE;
+    }
+
     if (!YoriWinItemArrayAddItemArray(&List->ItemArray, NewItems)) {
         return FALSE;
     }
@@ -1354,6 +1540,114 @@ YoriWinListAddItemArray(
     return TRUE;
 }
 
+/**
+ Configure a list control to obtain its items on demand rather than from
+ items added to it.  The callback is only invoked for items that are being
+ displayed or searched, so the list can describe very large sets without
+ each item being allocated up front.  Items are displayed in index order,
+ so the caller is responsible for any sorting.  This can be called again
+ to change the number of items, for example as a caller discovers more
+ items.  A multiple selection list can only be virtual if the caller has
+ supplied a function to record selection with
+ @ref YoriWinListSetVirtualSelection .
+
+ @param CtrlHandle Pointer to the list control.
+
+ @param ItemCount Specifies the number of items in the list.
+
+ @param GetItemText Pointer to a function to invoke to obtain the text of
+        an item.  If NULL, the list returns to displaying items added to it,
+        and is initially empty.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriWinListSetVirtualItems(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in YORI_ALLOC_SIZE_T ItemCount,
+    __in_opt PYORI_WIN_LIST_GET_ITEM_TEXT GetItemText
+    )
+{
+    PYORI_WIN_CTRL Ctrl;
+    PYORI_WIN_CTRL_LIST List;
+    BOOLEAN SelectionChanged;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
+
+    if (List->MultiSelect &&
+        GetItemText != NULL &&
+        List->VirtualSelectCallback == NULL) {
+
+        return FALSE;
+    }
+
+    if (GetItemText != List->VirtualItemCallback) {
+        YoriWinItemArrayCleanup(&List->ItemArray);
+        List->DisplayOffset = 0;
+        List->LongestItemLength = 0;
+    }
+
+    List->VirtualItemCallback = GetItemText;
+    List->VirtualItemCount = 0;
+    if (GetItemText != NULL) {
+        List->VirtualItemCount = ItemCount;
+    }
+
+    SelectionChanged = FALSE;
+    if (List->ItemActive &&
+        List->ActiveOption >= YoriWinListItemCount(List)) {
+
+        List->ItemActive = FALSE;
+        List->ActiveOption = 0;
+        SelectionChanged = TRUE;
+    }
+
+    if (List->FirstDisplayedOption >= YoriWinListItemCount(List)) {
+        List->FirstDisplayedOption = 0;
+    }
+
+    YoriWinListEnsureActiveItemVisible(List);
+    if (SelectionChanged && List->SelectionChangeCallback) {
+        List->SelectionChangeCallback(&List->Ctrl);
+    }
+    YoriWinListPaint(List);
+    return TRUE;
+}
+
+/**
+ Set the function used to query and change whether items in a virtual
+ multiple selection list are selected.  This must be called before
+ @ref YoriWinListSetVirtualItems for a multiple selection list.
+
+ @param CtrlHandle Pointer to the list control.
+
+ @param ToggleItemSelected Pointer to a function to invoke to query or
+        toggle the selection state of an item.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+YoriWinListSetVirtualSelection(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in_opt PYORI_WIN_LIST_TOGGLE_ITEM_SELECTED ToggleItemSelected
+    )
+{
+    PYORI_WIN_CTRL Ctrl;
+    PYORI_WIN_CTRL_LIST List;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
+
+    if (!List->MultiSelect) {
+        return FALSE;
+    }
+
+    List->VirtualSelectCallback = ToggleItemSelected;
+    return TRUE;
+}
+
 /**
  Return the text within a specified element of a list control.
 
@@ -1376,20 +1670,24 @@ YoriWinListGetItemText(
 {
     PYORI_WIN_CTRL Ctrl;
     PYORI_WIN_CTRL_LIST List;
+    PYORI_WIN_ITEM_ENTRY Element;
+    YORI_WIN_ITEM_ENTRY VirtualElement;
     PYORI_STRING Source;
 
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
-    if (Index >= List->ItemArray.Count) {
+    if (Index >= YoriWinListItemCount(List)) {
         return FALSE;
     }
 
-    Source = &List->ItemArray.Items[Index].String;
+    Element = YoriWinListGetItem(List, Index, &VirtualElement);
+    Source = &Element->String;
 
     if (Text->LengthAllocated < Source->LengthInChars + 1) {
         YORI_STRING NewString;
         if (!YoriLibAllocateString(&NewString, Source->LengthInChars + 1)) {
+            YoriWinListReleaseItem(List, Element);
             return FALSE;
         }
 
@@ -1400,6 +1698,7 @@ YoriWinListGetItemText(
     memcpy(Text->StartOfString, Source->StartOfString, Source->LengthInChars * sizeof(TCHAR));
     Text->LengthInChars = Source->LengthInChars;
     Text->StartOfString[Source->LengthInChars] = '\0';
+    YoriWinListReleaseItem(List, Element);
     return TRUE;
 }
 
@@ -111,6 +111,18 @@ typedef struct _YORI_WIN_WINDOW {
      */
     PYORI_WIN_NOTIFY_WINDOW_MANAGER_RESIZE WindowManagerResizeNotifyCallback;
 
+    /**
+     Optionally points to a callback function to invoke periodically while
+     the window is processing input.
+     */
+    PYORI_WIN_NOTIFY PeriodicNotifyCallback;
+
+    /**
+     The timer used to invoke PeriodicNotifyCallback.  NULL if no periodic
+     callback is registered.
+     */
+    PYORI_WIN_CTRL_HANDLE PeriodicTimer;
+
     /**
      An array of callbacks that can be invoked when particular events occur
      in the window, which were not processed by any control on the window.
@@ -734,6 +746,11 @@ YoriWinDestroyWindow(
         Window->Contents = NULL;
     }
 
+    if (Window->PeriodicTimer != NULL) {
+        YoriWinMgrFreeTimer(Window->PeriodicTimer);
+        Window->PeriodicTimer = NULL;
+    }
+
     YoriWinDestroyControl(&Window->Ctrl);
 
     if (Window->CustomNotifications) {
@@ -1987,6 +2004,53 @@ YoriWinSetWindowManagerResizeNotifyCallback(
     return TRUE;
 }
 
+/**
+ Set a callback to invoke periodically while the window is processing input.
+ This allows the application to update the window in response to work that
+ is occurring outside of user input, such as the progress of a background
+ thread.  The callback is invoked on the thread processing input for the
+ window.
+
+ @param WindowHandle Pointer to the window to invoke a callback from.
+
+ @param PeriodicInterval The time in milliseconds between each invocation of
+        the callback.
+
+ @param NotifyCallback Optionally points to the function to invoke.  If NULL,
+        any existing periodic callback is stopped.  This function can
+        be called from within the callback to stop it.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+YoriWinSetPeriodicNotifyCallback(
+    __in PYORI_WIN_WINDOW_HANDLE WindowHandle,
+    __in DWORD PeriodicInterval,
+    __in_opt PYORI_WIN_NOTIFY NotifyCallback
+    )
+{
+    PYORI_WIN_WINDOW Window;
+    Window = (PYORI_WIN_WINDOW)WindowHandle;
+
+    if (Window->PeriodicTimer != NULL) {
+        YoriWinMgrFreeTimer(Window->PeriodicTimer);
+        Window->PeriodicTimer = NULL;
+    }
+
+    Window->PeriodicNotifyCallback = NULL;
+    if (NotifyCallback == NULL) {
+        return TRUE;
+    }
+
+    Window->PeriodicTimer = YoriWinMgrAllocateRecurringTimer(Window->WinMgrHandle, &Window->Ctrl, PeriodicInterval);
+    if (Window->PeriodicTimer == NULL) {
+        return FALSE;
+    }
+
+    Window->PeriodicNotifyCallback = NotifyCallback;
+    return TRUE;
+}
+
 /**
  Set a callback to be invoked when an event occurs on the window that is not
  explicitly handled by a control.  As of this writing, only one callback can
@@ -2467,6 +2531,13 @@ YoriWinNotifyEvent(
         if (Window->WindowManagerResizeNotifyCallback != NULL) {
             Window->WindowManagerResizeNotifyCallback(Window, &Event->WindowManagerResize.OldWinMgrDimensions, &Event->WindowManagerResize.NewWinMgrDimensions);
         }
+    } else if (Event->EventType == YoriWinEventTimer) {
+        if (Window->PeriodicTimer != NULL &&
+            Event->Timer.Timer == Window->PeriodicTimer &&
+            Window->PeriodicNotifyCallback != NULL) {
+
+            Window->PeriodicNotifyCallback(&Window->Ctrl);
+        }
     }
 
     if (Window->CustomNotifications != NULL &&
@@ -40,6 +40,40 @@
  */
 #define YORI_WIN_SHADOW_HEIGHT (1)
 
+/**
+ The approximate cost of each call to write to the console, expressed as a
+ number of cells.  When flushing the display, adjacent dirty lines are
+ combined into a single write if doing so would write fewer unchanged cells
+ than this.
+ */
+#define YORI_WIN_FLUSH_CALL_COST_IN_CELLS (80)
+
+/**
+ The maximum number of batches of input that can be processed without
+ updating the display.  If input is arriving faster than it can be
+ processed, the display is deferred until it has been consumed, but it
+ should still be updated periodically.
+ */
+#define YORI_WIN_MAX_DEFERRED_DISPLAY (8)
+
+/**
+ Describes the range of a single line of the window manager which has
+ changed and needs to be pushed to the console.  If Left is greater than
+ Right, the line is unchanged.
+ */
+typedef struct _YORI_WIN_DIRTY_LINE {
+
+    /**
+     The leftmost cell in the line that has changed.
+     */
+    SHORT Left;
+
+    /**
+     The rightmost cell in the line that has changed.
+     */
+    SHORT Right;
+} YORI_WIN_DIRTY_LINE, *PYORI_WIN_DIRTY_LINE;
+
 /**
  A timer that can be attached to the window manager.
  */
@@ -164,6 +198,13 @@ typedef struct _YORI_WIN_WINDOW_MANAGER {
      */
     PCHAR_INFO Contents;
 
+    /**
+     An array with one element per line of the Contents buffer above,
+     describing the range of each line which needs to be displayed.  This is
+     allocated as part of the Contents allocation.
+     */
+    PYORI_WIN_DIRTY_LINE DirtyLines;
+
     /**
      A single character which is repeated many times during rendering.  This
      is used to generate window shadows, where each character is the same,
@@ -172,9 +213,10 @@ typedef struct _YORI_WIN_WINDOW_MANAGER {
     CHAR_INFO RepeatingCell;
 
     /**
-     If DirtyRect above is TRUE, this contains the region of the Contents
-     buffer which needs to be displayed.  If DisplayDirty above is FALSE,
-     the values in DirtyRect are not meaningful.
+     If DisplayDirty below is TRUE, this contains the bounding region of the
+     Contents buffer which needs to be displayed.  If DisplayDirty is FALSE,
+     the values in DirtyRect are not meaningful.  The lines within this
+     region that have changed are described by DirtyLines above.
      */
     SMALL_RECT DirtyRect;
 
@@ -234,7 +276,7 @@ typedef struct _YORI_WIN_WINDOW_MANAGER {
 
     /**
      TRUE if some region of the display buffer has been regenerated and needs
-     to be pushed to the console.  When this occurs, DirtyRect below indicates
+     to be pushed to the console.  When this occurs, DirtyRect above indicates
      the range.  Contents in the Contents buffer above have been updated.
      */
     BOOLEAN DisplayDirty;
@@ -437,6 +479,78 @@ YoriWinMgrRestorePreviousContents(
     }
 }
 
+/**
+ Allocate a buffer describing the display of the window manager.  This
+ contains an array of cells for the display, followed by an array of
+ @ref YORI_WIN_DIRTY_LINE structures, one per line, which are initialized to
+ indicate that no line has changed.
+
+ @param Size Specifies the dimensions of the display.
+
+ @return Pointer to the newly allocated buffer, or NULL on allocation
+         failure.  The caller should free this with @ref YoriLibFree .
+ */
+PCHAR_INFO
+YoriWinMgrAllocateContents(
+    __in COORD Size
+    )
+{
+    PCHAR_INFO Contents;
+    PYORI_WIN_DIRTY_LINE DirtyLines;
+    YORI_ALLOC_SIZE_T CellCount;
+    YORI_ALLOC_SIZE_T LineIndex;
+
+    CellCount = Size.Y;
+    CellCount = CellCount * Size.X;
+
+    Contents = YoriLibMalloc(CellCount * sizeof(CHAR_INFO) + Size.Y * sizeof(YORI_WIN_DIRTY_LINE));
+    if (Contents == NULL) {
+        return NULL;
+    }
+
+    DirtyLines = (PYORI_WIN_DIRTY_LINE)&Contents[CellCount];
+    for (LineIndex = 0; LineIndex < (YORI_ALLOC_SIZE_T)Size.Y; LineIndex++) {
+        DirtyLines[LineIndex].Left = Size.X;
+        DirtyLines[LineIndex].Right = -1;
+    }
+
+    return Contents;
+}
+
+/**
+ Replace the buffer describing the display of the window manager with a
+ newly allocated one.
+
+ @param WinMgr Pointer to the window manager.
+
+ @param NewContents Pointer to a buffer allocated with
+        @ref YoriWinMgrAllocateContents .  Ownership of this buffer is
+        transferred to the window manager.
+
+ @param Size Specifies the dimensions of the display described by
+        NewContents.
+ */
+VOID
+YoriWinMgrReplaceContents(
+    __in PYORI_WIN_WINDOW_MANAGER WinMgr,
+    __in PCHAR_INFO NewContents,
+    __in COORD Size
+    )
+{
+    YORI_ALLOC_SIZE_T CellCount;
+
+    if (WinMgr->Contents != NULL) {
+        YoriLibFree(WinMgr->Contents);
+    }
+
+    CellCount = Size.Y;
+    CellCount = CellCount * Size.X;
+
+    WinMgr->Contents = NewContents;
+    WinMgr->DirtyLines = (PYORI_WIN_DIRTY_LINE)&NewContents[CellCount];
+    WinMgr->DisplayDirty = FALSE;
+}
+
 /**
  Close and free the window manager.
 
@@ -458,6 +572,7 @@ YoriWinCloseWindowManager(
     if (WinMgr->Contents != NULL) {
         YoriLibFree(WinMgr->Contents);
         WinMgr->Contents = NULL;
+        WinMgr->DirtyLines = NULL;
     }
 
     if (WinMgr->HaveSavedScreenBufferInfo) {
@@ -542,6 +657,7 @@ YoriWinOpenWindowManager(
 {
     PYORI_WIN_WINDOW_MANAGER WinMgr;
     COORD BufferSize;
+    PCHAR_INFO NewContents;
     YORI_ALLOC_SIZE_T CellCount;
     YORI_ALLOC_SIZE_T CellIndex;
 
@@ -554,6 +670,7 @@ YoriWinOpenWindowManager(
     WinMgr->hConOriginal = NULL;
     WinMgr->SavedContents = NULL;
     WinMgr->Contents = NULL;
+    WinMgr->DirtyLines = NULL;
     YoriLibInitializeListHead(&WinMgr->TimerList);
     YoriLibInitializeListHead(&WinMgr->ZOrderList);
     WinMgr->DisplayDirty = FALSE;
@@ -651,11 +768,12 @@ YoriWinOpenWindowManager(
     YoriWinGetWinMgrDimensions(WinMgr, &BufferSize);
     CellCount = BufferSize.X * BufferSize.Y;
 
-    WinMgr->Contents = YoriLibMalloc(CellCount * sizeof(CHAR_INFO));
-    if (WinMgr->Contents == NULL) {
+    NewContents = YoriWinMgrAllocateContents(BufferSize);
+    if (NewContents == NULL) {
         YoriWinCloseWindowManager(WinMgr);
         return FALSE;
     }
+    YoriWinMgrReplaceContents(WinMgr, NewContents, BufferSize);
 
     for (CellIndex = 0; CellIndex < CellCount; CellIndex++) {
         WinMgr->Contents[CellIndex].Attributes = WinMgr->SavedContents[CellIndex].Attributes;
@@ -1537,6 +1655,16 @@ YoriWinMgrExpandDirtyToPoint(
     __in COORD Point
     )
 {
+    PYORI_WIN_DIRTY_LINE DirtyLine;
+
+    DirtyLine = &WinMgr->DirtyLines[Point.Y];
+    if (Point.X < DirtyLine->Left) {
+        DirtyLine->Left = Point.X;
+    }
+    if (Point.X > DirtyLine->Right) {
+        DirtyLine->Right = Point.X;
+    }
+
     if (!WinMgr->DisplayDirty) {
         WinMgr->DisplayDirty = TRUE;
         WinMgr->DirtyRect.Left = Point.X;
@@ -1558,6 +1686,37 @@ YoriWinMgrExpandDirtyToPoint(
     }
 }
 
+/**
+ Indicate that every cell in the display has changed and needs to be
+ written to the console.
+
+ @param WinMgr Pointer to the window manager.
+ */
+VOID
+YoriWinMgrMarkAllDirty(
+    __in PYORI_WIN_WINDOW_MANAGER WinMgr
+    )
+{
+    COORD BufferSize;
+    SHORT LineIndex;
+
+    YoriWinGetWinMgrDimensions(WinMgr, &BufferSize);
+    if (BufferSize.X <= 0 || BufferSize.Y <= 0) {
+        return;
+    }
+
+    for (LineIndex = 0; LineIndex < BufferSize.Y; LineIndex++) {
+        WinMgr->DirtyLines[LineIndex].Left = 0;
+        WinMgr->DirtyLines[LineIndex].Right = (SHORT)(BufferSize.X - 1);
+    }
+
+    WinMgr->DisplayDirty = TRUE;
+    WinMgr->DirtyRect.Left = 0;
+    WinMgr->DirtyRect.Top = 0;
+    WinMgr->DirtyRect.Right = (SHORT)(BufferSize.X - 1);
+    WinMgr->DirtyRect.Bottom = (SHORT)(BufferSize.Y - 1);
+}
+
 /**
  If the viewport has been resized so that it is too small to continue with
  a TUI display a fixed message is rendered instead.  This function renders
@@ -1734,6 +1893,124 @@ YoriWinMgrRegenerateRegion(
     }
 }
 
+/**
+ Push the changed regions of the staged display to the console.  Rather than
+ writing the bounding rectangle of all changes, each line records the range
+ that has changed, and adjacent lines are combined into a single write only
+ when the number of unchanged cells that would be rewritten is small compared
+ to the cost of an additional write.  This means two small changes in
+ opposite corners of the display result in two small writes.
+
+ @param WinMgr Pointer to the window manager.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+YoriWinMgrFlushDirtyLines(
+    __in PYORI_WIN_WINDOW_MANAGER WinMgr
+    )
+{
+    PYORI_WIN_DIRTY_LINE DirtyLine;
+    COORD BufferPosition;
+    COORD BufferSize;
+    SMALL_RECT WinMgrPos;
+    SMALL_RECT WriteRect;
+    SMALL_RECT RedrawWindow;
+    SHORT LineIndex;
+    SHORT NewLeft;
+    SHORT NewRight;
+    DWORD ChangedCells;
+    DWORD MergedCells;
+    BOOLEAN HaveWriteRect;
+    BOOLEAN Result;
+
+    YoriWinGetWinMgrDimensions(WinMgr, &BufferSize);
+    YoriWinGetWinMgrLocation(WinMgr, &WinMgrPos);
+
+    Result = TRUE;
+    HaveWriteRect = FALSE;
+    ChangedCells = 0;
+    WriteRect.Left = 0;
+    WriteRect.Top = 0;
+    WriteRect.Right = 0;
+    WriteRect.Bottom = 0;
+
+    //
+    //  Walk one line beyond the dirty region so the final rectangle is
+    //  written when that line is found to be clean.
+    //
+
+    for (LineIndex = WinMgr->DirtyRect.Top; LineIndex <= WinMgr->DirtyRect.Bottom + 1; LineIndex++) {
+
+        DirtyLine = NULL;
+        if (LineIndex <= WinMgr->DirtyRect.Bottom && LineIndex < BufferSize.Y) {
+            DirtyLine = &WinMgr->DirtyLines[LineIndex];
+            if (DirtyLine->Right >= BufferSize.X) {
+                DirtyLine->Right = (SHORT)(BufferSize.X - 1);
+            }
+            if (DirtyLine->Left > DirtyLine->Right) {
+                DirtyLine = NULL;
+            }
+        }
+
+        //
+        //  If this line can be combined with the rectangle being built
+        //  without rewriting too many unchanged cells, extend the
+        //  rectangle and move to the next line.
+        //
+
+        if (HaveWriteRect && DirtyLine != NULL) {
+            NewLeft = WriteRect.Left;
+            NewRight = WriteRect.Right;
+            if (DirtyLine->Left < NewLeft) {
+                NewLeft = DirtyLine->Left;
+            }
+            if (DirtyLine->Right > NewRight) {
+                NewRight = DirtyLine->Right;
+            }
+            MergedCells = (DWORD)(NewRight - NewLeft + 1) * (DWORD)(LineIndex - WriteRect.Top + 1);
+            if (MergedCells - (ChangedCells + DirtyLine->Right - DirtyLine->Left + 1) <= YORI_WIN_FLUSH_CALL_COST_IN_CELLS) {
+                WriteRect.Left = NewLeft;
+                WriteRect.Right = NewRight;
+                WriteRect.Bottom = LineIndex;
+                ChangedCells = ChangedCells + DirtyLine->Right - DirtyLine->Left + 1;
+                DirtyLine->Left = BufferSize.X;
+                DirtyLine->Right = -1;
+                continue;
+            }
+        }
+
+        if (HaveWriteRect) {
+            BufferPosition.X = WriteRect.Left;
+            BufferPosition.Y = WriteRect.Top;
+
+            RedrawWindow.Left = (SHORT)(WriteRect.Left + WinMgrPos.Left);
+            RedrawWindow.Right = (SHORT)(WriteRect.Right + WinMgrPos.Left);
+            RedrawWindow.Top = (SHORT)(WriteRect.Top + WinMgrPos.Top);
+            RedrawWindow.Bottom = (SHORT)(WriteRect.Bottom + WinMgrPos.Top);
+
+            if (!WriteConsoleOutput(WinMgr->hConOut, WinMgr->Contents, BufferSize, BufferPosition, &RedrawWindow)) {
+                Result = FALSE;
+            }
+            HaveWriteRect = FALSE;
+        }
+
+        if (DirtyLine != NULL) {
+            WriteRect.Left = DirtyLine->Left;
+            WriteRect.Right = DirtyLine->Right;
+            WriteRect.Top = LineIndex;
+            WriteRect.Bottom = LineIndex;
+            ChangedCells = DirtyLine->Right - DirtyLine->Left + 1;
+            HaveWriteRect = TRUE;
+            DirtyLine->Left = BufferSize.X;
+            DirtyLine->Right = -1;
+        }
+    }
+
+    WinMgr->DisplayDirty = FALSE;
+    return Result;
+}
+
 /**
  Display the contents of the staged display into the console.  Generating
  this display is done via @ref YoriWinMgrRegenerateRegion .
@@ -1748,10 +2025,8 @@ YoriWinMgrDisplayContents(
     )
 {
     PYORI_WIN_WINDOW_MANAGER WinMgr = (PYORI_WIN_WINDOW_MANAGER)WinMgrHandle;
-    COORD BufferPosition;
     COORD BufferSize;
     SMALL_RECT WinMgrPos;
-    SMALL_RECT RedrawWindow;
     PYORI_LIST_ENTRY ListEntry;
     PYORI_WIN_WINDOW_HANDLE WindowHandle;
     YORI_WIN_CURSOR_STATE NewCursorState;
@@ -1768,25 +2043,13 @@ YoriWinMgrDisplayContents(
 
     if (WinMgr->DisplayDirty && YoriLibIsNanoServer()) {
 
-        YoriWinGetWinMgrLocation(WinMgr, &WinMgrPos);
-
-        BufferPosition.X = WinMgr->DirtyRect.Left;
-        BufferPosition.Y = WinMgr->DirtyRect.Top;
-
-        RedrawWindow.Left = (SHORT)(WinMgr->DirtyRect.Left + WinMgrPos.Left);
-        RedrawWindow.Right = (SHORT)(WinMgr->DirtyRect.Right + WinMgrPos.Left);
-        RedrawWindow.Top = (SHORT)(WinMgr->DirtyRect.Top + WinMgrPos.Top);
-        RedrawWindow.Bottom = (SHORT)(WinMgr->DirtyRect.Bottom + WinMgrPos.Top);
-
-        if (!WriteConsoleOutput(WinMgr->hConOut, WinMgr->Contents, BufferSize, BufferPosition, &RedrawWindow)) {
+        if (!YoriWinMgrFlushDirtyLines(WinMgr)) {
             return FALSE;
         }
 
         if (YoriLibIsNanoServer() && WinMgr->DisplayedCursorState.Visible) {
             WinMgr->UpdateCursor = TRUE;
         }
-
-        WinMgr->DisplayDirty = FALSE;
     }
 
     //
@@ -1878,21 +2141,9 @@ YoriWinMgrDisplayContents(
 
     if (WinMgr->DisplayDirty) {
 
-        YoriWinGetWinMgrLocation(WinMgr, &WinMgrPos);
-
-        BufferPosition.X = WinMgr->DirtyRect.Left;
-        BufferPosition.Y = WinMgr->DirtyRect.Top;
-
-        RedrawWindow.Left = (SHORT)(WinMgr->DirtyRect.Left + WinMgrPos.Left);
-        RedrawWindow.Right = (SHORT)(WinMgr->DirtyRect.Right + WinMgrPos.Left);
-        RedrawWindow.Top = (SHORT)(WinMgr->DirtyRect.Top + WinMgrPos.Top);
-        RedrawWindow.Bottom = (SHORT)(WinMgr->DirtyRect.Bottom + WinMgrPos.Top);
-
-        if (!WriteConsoleOutput(WinMgr->hConOut, WinMgr->Contents, BufferSize, BufferPosition, &RedrawWindow)) {
+        if (!YoriWinMgrFlushDirtyLines(WinMgr)) {
             return FALSE;
         }
-
-        WinMgr->DisplayDirty = FALSE;
     }
 
     return TRUE;
@@ -2489,9 +2740,15 @@ YoriWinMgrProcessExpiredTimers(
             if (Timer->ExpirationTime < CurrentTime) {
                 Event.EventType = YoriWinEventTimer;
                 Event.Timer.Timer = Timer;
-                Timer->NotifyCtrl->NotifyEventFn(Timer->NotifyCtrl, &Event);
+
+                //
+                //  Calculate the next expiration before notifying, since
+                //  the notification may free the timer.
+                //
+
                 Timer->PeriodsExpired++;
                 YoriWinMgrCalculateNextExpiration(Timer);
+                Timer->NotifyCtrl->NotifyEventFn(Timer->NotifyCtrl, &Event);
             }
         }
     }
@@ -2996,7 +3253,6 @@ YoriWinMgrProcessBufferSizeEvent(
     PCHAR_INFO NewAllocation;
     PSMALL_RECT Rect;
     SMALL_RECT NewRect;
-    YORI_ALLOC_SIZE_T CellCount;
     COORD NewSize;
     COORD OldSize;
     HANDLE hConOut;
@@ -3013,8 +3269,6 @@ YoriWinMgrProcessBufferSizeEvent(
     Rect = &NewScreenBufferInfo.srWindow;
     NewSize.X = (SHORT)(Rect->Right - Rect->Left + 1);
     NewSize.Y = (SHORT)(Rect->Bottom - Rect->Top + 1);
-    CellCount = NewSize.Y;
-    CellCount = CellCount * NewSize.X;
 
     //
     //  If this allocation fails, the console will reflow text, so we
@@ -3026,7 +3280,7 @@ YoriWinMgrProcessBufferSizeEvent(
     //  to the size of the actual console.
     //
 
-    NewAllocation = YoriLibMalloc(CellCount * sizeof(CHAR_INFO));
+    NewAllocation = YoriWinMgrAllocateContents(NewSize);
     if (NewAllocation != NULL) {
 
         //
@@ -3050,10 +3304,14 @@ YoriWinMgrProcessBufferSizeEvent(
 
         memcpy(&WinMgr->SavedScreenBufferInfo, &NewScreenBufferInfo, sizeof(CONSOLE_SCREEN_BUFFER_INFO));
 
-        if (WinMgr->Contents != NULL) {
-            YoriLibFree(WinMgr->Contents);
-        }
-        WinMgr->Contents = NewAllocation;
+        YoriWinMgrReplaceContents(WinMgr, NewAllocation, NewSize);
+
+        //
+        //  The new buffer has no relationship to what the console is
+        //  displaying, so every cell needs to be written.
+        //
+
+        YoriWinMgrMarkAllDirty(WinMgr);
 
         //
         //  From the bottom of the stack to the top of the stack, show all
@@ -3132,11 +3390,13 @@ YoriWinMgrProcessAllEvents(
 {
     HANDLE hConIn;
     HANDLE hConOut;
-    INPUT_RECORD InputRecords[10];
+    INPUT_RECORD InputRecords[64];
     PINPUT_RECORD InputRecord;
     PYORI_WIN_WINDOW_MANAGER WinMgr;
     DWORD ActuallyRead;
     DWORD Index;
+    DWORD PendingEvents;
+    DWORD DeferredDisplayCount;
     PYORI_WIN_CTRL WindowCtrl;
     BOOLEAN Result;
 
@@ -3146,6 +3406,7 @@ YoriWinMgrProcessAllEvents(
     hConOut = YoriWinGetConsoleOutputHandle(WinMgrHandle);
 
     Result = FALSE;
+    DeferredDisplayCount = 0;
 
     //
     //  Windows are created, then have controls populated, then events pumped.
@@ -3186,11 +3447,24 @@ YoriWinMgrProcessAllEvents(
         YoriWinMgrProcessPostedEvents(WinMgr);
 
         //
-        //  Display window manager contents if they have changed.
+        //  Display window manager contents if they have changed.  If more
+        //  input has already arrived, such as when keys are autorepeating
+        //  or text is being pasted, process it first so that the display
+        //  is updated once for the combined result, but don't defer the
+        //  display indefinitely.
         //
 
-        if (!YoriWinMgrDisplayContents(WinMgr)) {
-            break;
+        PendingEvents = 0;
+        if (DeferredDisplayCount < YORI_WIN_MAX_DEFERRED_DISPLAY &&
+            GetNumberOfConsoleInputEvents(hConIn, &PendingEvents) &&
+            PendingEvents > 0) {
+
+            DeferredDisplayCount++;
+        } else {
+            DeferredDisplayCount = 0;
+            if (!YoriWinMgrDisplayContents(WinMgr)) {
+                break;
+            }
         }
 
         //
@@ -3203,6 +3477,24 @@ YoriWinMgrProcessAllEvents(
 
         for (Index = 0; Index < ActuallyRead; Index++) {
             InputRecord = &InputRecords[Index];
+
+            //
+            //  If the mouse has moved and the next event indicates it has
+            //  moved again with no change in buttons, only the final
+            //  position needs to be processed.
+            //
+
+            if (InputRecord->EventType == MOUSE_EVENT &&
+                InputRecord->Event.MouseEvent.dwEventFlags == MOUSE_MOVED &&
+                Index + 1 < ActuallyRead &&
+                InputRecords[Index + 1].EventType == MOUSE_EVENT &&
+                InputRecords[Index + 1].Event.MouseEvent.dwEventFlags == MOUSE_MOVED &&
+                InputRecords[Index + 1].Event.MouseEvent.dwButtonState == InputRecord->Event.MouseEvent.dwButtonState &&
+                InputRecords[Index + 1].Event.MouseEvent.dwControlKeyState == InputRecord->Event.MouseEvent.dwControlKeyState) {
+
+                continue;
+            }
+
             if (InputRecord->EventType == KEY_EVENT) {
                 YoriWinMgrProcessKeyEvent(WinMgr, InputRecord);
             } else if (InputRecord->EventType == MOUSE_EVENT) {
@@ -349,6 +349,15 @@ YoriWinHexEditGetModifyState(
     __in PYORI_WIN_CTRL_HANDLE CtrlHandle
     );
 
+__success(return)
+BOOLEAN
+YoriWinHexEditGetModifiedRange(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in DWORD Index,
+    __out PYORI_ALLOC_SIZE_T RangeStart,
+    __out PYORI_ALLOC_SIZE_T RangeLength
+    );
+
 BOOLEAN
 YoriWinHexEditReposition(
     __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
@@ -406,6 +415,12 @@ YoriWinHexEditSetReadOnly(
     __in BOOLEAN NewReadOnlyState
     );
 
+BOOLEAN
+YoriWinHexEditSetDisplayOffset(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in YORI_MAX_UNSIGNED_T DisplayOffset
+    );
+
 __success(return)
 BOOLEAN
 YoriWinHexEditSetCursorLocation(
@@ -633,6 +648,38 @@ YoriWinLabelReposition(
  */
 #define YORI_WIN_LIST_STYLE_AUTO_HSCROLLBAR  (0x0040)
 
+/**
+ A function prototype that is invoked to obtain the text of an item in a
+ virtual list.  The function should populate the string, which may point to
+ memory owned by the caller or be a newly allocated or referenced string,
+ since the list control frees it when it is no longer needed.  The first
+ parameter is the list control, the second is the index of the item, and
+ the third is an initialized string to populate.  The function returns TRUE
+ to indicate the string was populated, FALSE if it was not.
+ */
+typedef BOOLEAN YORI_WIN_LIST_GET_ITEM_TEXT(PYORI_WIN_CTRL_HANDLE, YORI_ALLOC_SIZE_T, PYORI_STRING);
+
+/**
+ A pointer to a function that is invoked to obtain the text of an item in a
+ virtual list.
+ */
+typedef YORI_WIN_LIST_GET_ITEM_TEXT *PYORI_WIN_LIST_GET_ITEM_TEXT;
+
+/**
+ A function prototype that is invoked to query or change whether an item in
+ a virtual multiple selection list is selected.  The first parameter is the
+ list control, the second is the index of the item, and the third is TRUE
+ if the selection state of the item should be toggled.  The function
+ returns TRUE if the item is selected after any change.
+ */
+typedef BOOLEAN YORI_WIN_LIST_TOGGLE_ITEM_SELECTED(PYORI_WIN_CTRL_HANDLE, YORI_ALLOC_SIZE_T, BOOLEAN);
+
+/**
+ A pointer to a function that is invoked to query or change whether an item
+ in a virtual multiple selection list is selected.
+ */
+typedef YORI_WIN_LIST_TOGGLE_ITEM_SELECTED *PYORI_WIN_LIST_TOGGLE_ITEM_SELECTED;
+
 PYORI_WIN_CTRL_HANDLE
 YoriWinListCreate(
     __in PYORI_WIN_WINDOW_HANDLE Parent,
@@ -678,6 +725,20 @@ YoriWinListAddItems(
     __in YORI_ALLOC_SIZE_T NumberOptions
     );
 
+__success(return)
+BOOLEAN
+YoriWinListSetVirtualItems(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in YORI_ALLOC_SIZE_T ItemCount,
+    __in_opt PYORI_WIN_LIST_GET_ITEM_TEXT GetItemText
+    );
+
+BOOLEAN
+YoriWinListSetVirtualSelection(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in_opt PYORI_WIN_LIST_TOGGLE_ITEM_SELECTED ToggleItemSelected
+    );
+
 BOOLEAN
 YoriWinListGetItemText(
     __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
@@ -1130,6 +1191,13 @@ YoriWinSetWindowManagerResizeNotifyCallback(
     __in PYORI_WIN_NOTIFY_WINDOW_MANAGER_RESIZE NotifyCallback
     );
 
+BOOLEAN
+YoriWinSetPeriodicNotifyCallback(
+    __in PYORI_WIN_WINDOW_HANDLE WindowHandle,
+    __in DWORD PeriodicInterval,
+    __in_opt PYORI_WIN_NOTIFY NotifyCallback
+    );
+
 PYORI_WIN_WINDOW_MANAGER_HANDLE
 YoriWinGetWindowManagerHandle(
     __in PYORI_WIN_WINDOW_HANDLE WindowHandle
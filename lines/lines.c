@@ -124,6 +124,463 @@ typedef struct _LINES_CONTEXT {
     YORI_MAX_SIGNED_T TotalLinesFound;
 } LINES_CONTEXT, *PLINES_CONTEXT;
 
+/**
+ The number of lines to request from the line reader's buffer at a time.
+ */
+#define LINES_SPAN_COUNT (64)
+
+/**
+ Update the file's line statistics to include a line of a specified length.
+
+ @param LinesContext Specifies the context to record line count information.
+
+ @param LineLength The length of the line, in characters.
+
+ @param OneLineFound Points to a boolean indicating whether any line has been
+        found in this file yet.  This is set to TRUE on return.
+ */
+VOID
+LinesRecordLine(
+    __in PLINES_CONTEXT LinesContext,
+    __in YORI_ALLOC_SIZE_T LineLength,
+    __inout PBOOLEAN OneLineFound
+    )
+{
+    LinesContext->FileLinesFound++;
+    LinesContext->FileTotalChars = LinesContext->FileTotalChars + LineLength;
+    if (LineLength > LinesContext->FileLongestLine) {
+        LinesContext->FileLongestLine = LineLength;
+    }
+
+    if (!(*OneLineFound) || LineLength < LinesContext->FileShortestLine) {
+        LinesContext->FileShortestLine = LineLength;
+        *OneLineFound = TRUE;
+    }
+}
+
+/**
+ The smallest file which is counted by mapping it and scanning for line
+ breaks.  Smaller files are counted with the line reader.
+ */
+#define LINES_SCAN_MINIMUM_SIZE (64 * 1024)
+
+/**
+ The number of bytes of a file to map and scan at a time.  This must be a
+ multiple of the system allocation granularity.
+ */
+#define LINES_SCAN_VIEW_SIZE (16 * 1024 * 1024)
+
+/**
+ The maximum number of threads to use when counting the lines in a file.
+ */
+#define LINES_SCAN_MAX_THREADS 8
+
+/**
+ A pointer sized value with the value one in every byte.
+ */
+#define LINES_ONES_8 ((~(DWORD_PTR)0) / 0xFF)
+
+/**
+ A pointer sized value with the value one in every 16 bit word.
+ */
+#define LINES_ONES_16 ((~(DWORD_PTR)0) / 0xFFFF)
+
+/**
+ A range of a mapped file to count line breaks within, which is processed
+ by a single thread.
+ */
+typedef struct _LINES_SCAN_RANGE {
+
+    /**
+     Handle to the mapping of the file.
+     */
+    HANDLE MappingHandle;
+
+    /**
+     Handle to the thread processing this range, or NULL if the range was
+     processed by the calling thread.
+     */
+    HANDLE Thread;
+
+    /**
+     The offset of the first byte in the range.  This is a multiple of
+     LINES_SCAN_VIEW_SIZE.
+     */
+    DWORDLONG StartOffset;
+
+    /**
+     The offset of the byte following the range.
+     */
+    DWORDLONG EndOffset;
+
+    /**
+     The number of bytes in the file which can be scanned.  Characters
+     beyond the range are examined to determine whether a carriage return
+     is followed by a line feed.
+     */
+    DWORDLONG FileSize;
+
+    /**
+     On completion, the number of line breaks found in the range.
+     */
+    DWORDLONG BreaksFound;
+
+    /**
+     On completion, the final character in the range.
+     */
+    WCHAR LastChar;
+
+    /**
+     TRUE if the file consists of 16 bit characters, FALSE if it consists
+     of 8 bit characters.
+     */
+    BOOLEAN WideChars;
+
+    /**
+     Set to TRUE if the range could not be scanned.
+     */
+    BOOLEAN Failed;
+} LINES_SCAN_RANGE, *PLINES_SCAN_RANGE;
+
+/**
+ Count the line breaks in a buffer of 8 bit characters.  A carriage return
+ followed by a line feed is a single line break.  Aligned pointer sized
+ words are examined at a time, and only words which contain a character
+ below 0xE are examined character by character.
+
+ @param Buffer Pointer to the buffer to count line breaks in.
+
+ @param Length The number of characters in the buffer.
+
+ @param NextChar The character following the buffer, or zero if there is
+        none.
+
+ @return The number of line breaks found.
+ */
+DWORDLONG
+LinesCountBreaksA(
+    __in PUCHAR Buffer,
+    __in DWORD Length,
+    __in UCHAR NextChar
+    )
+{
+    DWORD Index;
+    DWORD End;
+    DWORD_PTR Word;
+    DWORDLONG BreaksFound;
+    UCHAR FollowingChar;
+
+    BreaksFound = 0;
+    Index = 0;
+    while (Index < Length) {
+        End = Index + 1;
+        if ((((DWORD_PTR)&Buffer[Index]) & (sizeof(DWORD_PTR) - 1)) == 0 &&
+            Length - Index >= sizeof(DWORD_PTR)) {
+
+            Word = *(DWORD_PTR *)&Buffer[Index];
+            if (((Word - LINES_ONES_8 * 0xE) & ~Word & (LINES_ONES_8 * 0x80)) == 0) {
+                Index = Index + sizeof(DWORD_PTR);
+                continue;
+            }
+            End = Index + sizeof(DWORD_PTR);
+        }
+
+        for (; Index < End; Index++) {
+            if (Buffer[Index] == 0xA) {
+                BreaksFound++;
+            } else if (Buffer[Index] == 0xD) {
+                FollowingChar = NextChar;
+                if (Index + 1 < Length) {
+                    FollowingChar = Buffer[Index + 1];
+                }
+                if (FollowingChar != 0xA) {
+                    BreaksFound++;
+                }
+            }
+        }
+    }
+
+    return BreaksFound;
+}
+
+/**
+ Count the line breaks in a buffer of 16 bit characters.  A carriage return
+ followed by a line feed is a single line break.  Aligned pointer sized
+ words are examined at a time, and only words which contain a character
+ below 0xE are examined character by character.
+
+ @param Buffer Pointer to the buffer to count line breaks in.
+
+ @param Length The number of characters in the buffer.
+
+ @param NextChar The character following the buffer, or zero if there is
+        none.
+
+ @return The number of line breaks found.
+ */
+DWORDLONG
+LinesCountBreaksW(
+    __in PWCHAR Buffer,
+    __in DWORD Length,
+    __in WCHAR NextChar
+    )
+{
+    DWORD Index;
+    DWORD End;
+    DWORD_PTR Word;
+    DWORDLONG BreaksFound;
+    WCHAR FollowingChar;
+
+    BreaksFound = 0;
+    Index = 0;
+    while (Index < Length) {
+        End = Index + 1;
+        if ((((DWORD_PTR)&Buffer[Index]) & (sizeof(DWORD_PTR) - 1)) == 0 &&
+            Length - Index >= sizeof(DWORD_PTR) / sizeof(WCHAR)) {
+
+            Word = *(DWORD_PTR *)&Buffer[Index];
+            if (((Word - LINES_ONES_16 * 0xE) & ~Word & (LINES_ONES_16 * 0x8000)) == 0) {
+                Index = Index + sizeof(DWORD_PTR) / sizeof(WCHAR);
+                continue;
+            }
+            End = Index + sizeof(DWORD_PTR) / sizeof(WCHAR);
+        }
+
+        for (; Index < End; Index++) {
+            if (Buffer[Index] == 0xA) {
+                BreaksFound++;
+            } else if (Buffer[Index] == 0xD) {
+                FollowingChar = NextChar;
+                if (Index + 1 < Length) {
+                    FollowingChar = Buffer[Index + 1];
+                }
+                if (FollowingChar != 0xA) {
+                    BreaksFound++;
+                }
+            }
+        }
+    }
+
+    return BreaksFound;
+}
+
+/**
+ Count the line breaks within a range of a mapped file.  This is invoked
+ on its own thread for each range, or on the calling thread if a thread
+ could not be created.
+
+ @param Context Pointer to the LINES_SCAN_RANGE structure describing the
+        range to scan.  On completion, this is updated with the number of
+        line breaks found.
+
+ @return Exit code for the thread, which is zero.
+ */
+DWORD WINAPI
+LinesScanRange(
+    __in LPVOID Context
+    )
+{
+    PLINES_SCAN_RANGE Range;
+    DWORDLONG ViewOffset;
+    DWORD ViewLength;
+    DWORD MapLength;
+    DWORD CharSize;
+    PUCHAR Buffer;
+    WCHAR NextChar;
+
+    Range = (PLINES_SCAN_RANGE)Context;
+    CharSize = sizeof(UCHAR);
+    if (Range->WideChars) {
+        CharSize = sizeof(WCHAR);
+    }
+
+    for (ViewOffset = Range->StartOffset; ViewOffset < Range->EndOffset; ViewOffset = ViewOffset + ViewLength) {
+
+        ViewLength = LINES_SCAN_VIEW_SIZE;
+        if (ViewOffset + ViewLength > Range->EndOffset) {
+            ViewLength = (DWORD)(Range->EndOffset - ViewOffset);
+        }
+
+        //
+        //  Map one character beyond the view when it exists, so a
+        //  carriage return at the end of the view can be checked for a
+        //  following line feed.
+        //
+
+        MapLength = ViewLength;
+        if (ViewOffset + ViewLength < Range->FileSize) {
+            MapLength = MapLength + CharSize;
+        }
+
+        Buffer = MapViewOfFile(Range->MappingHandle, FILE_MAP_READ, (DWORD)(ViewOffset >> 32), (DWORD)ViewOffset, MapLength);
+        if (Buffer == NULL) {
+            Range->Failed = TRUE;
+            break;
+        }
+
+        if (Range->WideChars) {
+            NextChar = 0;
+            if (MapLength > ViewLength) {
+                NextChar = ((PWCHAR)Buffer)[ViewLength / sizeof(WCHAR)];
+            }
+            Range->BreaksFound = Range->BreaksFound + LinesCountBreaksW((PWCHAR)Buffer, ViewLength / sizeof(WCHAR), NextChar);
+            Range->LastChar = ((PWCHAR)Buffer)[ViewLength / sizeof(WCHAR) - 1];
+        } else {
+            NextChar = 0;
+            if (MapLength > ViewLength) {
+                NextChar = Buffer[ViewLength];
+            }
+            Range->BreaksFound = Range->BreaksFound + LinesCountBreaksA(Buffer, ViewLength, (UCHAR)NextChar);
+            Range->LastChar = Buffer[ViewLength - 1];
+        }
+
+        UnmapViewOfFile(Buffer);
+    }
+
+    return 0;
+}
+
+/**
+ Count the lines in a file on disk by mapping it and counting line breaks
+ in ranges of the file concurrently on multiple threads.  This is only used
+ when line length statistics are not needed, since it does not decode the
+ text of each line.
+
+ @param hSource Handle to the source.
+
+ @param LinesFound On successful completion, updated to contain the number
+        of lines in the file.
+
+ @return TRUE to indicate the lines were counted, FALSE if the file should
+         be processed with the line reader.
+ */
+__success(return)
+BOOLEAN
+LinesCountMappedFile(
+    __in HANDLE hSource,
+    __out PYORI_MAX_SIGNED_T LinesFound
+    )
+{
+    LINES_SCAN_RANGE Ranges[LINES_SCAN_MAX_THREADS];
+    SYSTEM_INFO SystemInfo;
+    LARGE_INTEGER FileSize;
+    HANDLE MappingHandle;
+    DWORDLONG ViewCount;
+    DWORDLONG ViewsPerRange;
+    DWORDLONG BreaksFound;
+    DWORD RangeCount;
+    DWORD Index;
+    DWORD ThreadId;
+    BOOLEAN WideChars;
+    BOOLEAN Failed;
+    WCHAR LastChar;
+
+    if (GetFileType(hSource) != FILE_TYPE_DISK) {
+        return FALSE;
+    }
+
+    FileSize.LowPart = GetFileSize(hSource, (LPDWORD)&FileSize.HighPart);
+    if (FileSize.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+        return FALSE;
+    }
+
+    //
+    //  Since small files are never counted here, the file always contains
+    //  more than a byte order mark, and a byte order mark contains no line
+    //  breaks, so it has no effect on the count.  A trailing byte in a file
+    //  of 16 bit characters is not part of any character.
+    //
+
+    if (FileSize.QuadPart < LINES_SCAN_MINIMUM_SIZE) {
+        return FALSE;
+    }
+
+    WideChars = FALSE;
+    if (YoriLibGetMultibyteInputEncoding() == CP_UTF16) {
+        WideChars = TRUE;
+        FileSize.QuadPart = FileSize.QuadPart & ~((LONGLONG)1);
+    }
+
+    MappingHandle = CreateFileMapping(hSource, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (MappingHandle == NULL) {
+        return FALSE;
+    }
+
+    GetSystemInfo(&SystemInfo);
+    RangeCount = SystemInfo.dwNumberOfProcessors;
+    if (RangeCount < 1) {
+        RangeCount = 1;
+    }
+    if (RangeCount > LINES_SCAN_MAX_THREADS) {
+        RangeCount = LINES_SCAN_MAX_THREADS;
+    }
+
+    ViewCount = (FileSize.QuadPart + LINES_SCAN_VIEW_SIZE - 1) / LINES_SCAN_VIEW_SIZE;
+    if (RangeCount > ViewCount) {
+        RangeCount = (DWORD)ViewCount;
+    }
+    ViewsPerRange = (ViewCount + RangeCount - 1) / RangeCount;
+    RangeCount = (DWORD)((ViewCount + ViewsPerRange - 1) / ViewsPerRange);
+
+    ZeroMemory(Ranges, sizeof(Ranges));
+    for (Index = 0; Index < RangeCount; Index++) {
+        Ranges[Index].MappingHandle = MappingHandle;
+        Ranges[Index].FileSize = FileSize.QuadPart;
+        Ranges[Index].WideChars = WideChars;
+        Ranges[Index].StartOffset = Index * ViewsPerRange * LINES_SCAN_VIEW_SIZE;
+        Ranges[Index].EndOffset = Ranges[Index].StartOffset + ViewsPerRange * LINES_SCAN_VIEW_SIZE;
+        if (Ranges[Index].EndOffset > (DWORDLONG)FileSize.QuadPart) {
+            Ranges[Index].EndOffset = FileSize.QuadPart;
+        }
+    }
+
+    //
+    //  The calling thread processes the first range, and if a thread cannot
+    //  be created for any other range, processes that range too.
+    //
+
+    for (Index = 1; Index < RangeCount; Index++) {
+        Ranges[Index].Thread = CreateThread(NULL, 0, LinesScanRange, &Ranges[Index], 0, &ThreadId);
+    }
+
+    LinesScanRange(&Ranges[0]);
+
+    BreaksFound = 0;
+    Failed = FALSE;
+    LastChar = 0;
+    for (Index = 0; Index < RangeCount; Index++) {
+        if (Ranges[Index].Thread != NULL) {
+            WaitForSingleObject(Ranges[Index].Thread, INFINITE);
+            CloseHandle(Ranges[Index].Thread);
+        } else if (Index > 0) {
+            LinesScanRange(&Ranges[Index]);
+        }
+
+        if (Ranges[Index].Failed) {
+            Failed = TRUE;
+        }
+        BreaksFound = BreaksFound + Ranges[Index].BreaksFound;
+        LastChar = Ranges[Index].LastChar;
+    }
+
+    CloseHandle(MappingHandle);
+
+    if (Failed) {
+        return FALSE;
+    }
+
+    //
+    //  Text after the final line break is a line of its own.
+    //
+
+    if (LastChar != 0xA && LastChar != 0xD) {
+        BreaksFound++;
+    }
+
+    *LinesFound = (YORI_MAX_SIGNED_T)BreaksFound;
+    return TRUE;
+}
+
 /**
  Count the lines in an opened stream.
 
@@ -142,6 +599,11 @@ LinesProcessStream(
     PVOID LineContext = NULL;
     YORI_STRING LineString;
     BOOLEAN OneLineFound;
+    YORI_LIB_LINE_SPAN Spans[LINES_SPAN_COUNT];
+    YORI_ALLOC_SIZE_T SpanCount;
+    YORI_ALLOC_SIZE_T SpanIndex;
+    YORI_ALLOC_SIZE_T LineLength;
+    BOOLEAN WideChars;
 
     YoriLibInitEmptyString(&LineString);
 
@@ -153,22 +615,43 @@ LinesProcessStream(
     LinesContext->FileTotalChars = 0;
     OneLineFound = FALSE;
 
+    //
+    //  If only the number of lines is needed, a file on disk can be counted
+    //  without reading each line.
+    //
+
+    if (!LinesContext->DisplayLengthStats &&
+        LinesCountMappedFile(hSource, &LinesContext->FileLinesFound)) {
+
+        LinesContext->TotalLinesFound += LinesContext->FileLinesFound;
+        return TRUE;
+    }
+
     while (TRUE) {
 
-        if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
-            break;
+        //
+        //  Count any lines that are already buffered without copying them.
+        //  When the buffer is exhausted, read a line normally, which will
+        //  refill it.
+        //
+
+        SpanCount = YoriLibReadLineGetBufferedSpans(LineContext, Spans, LINES_SPAN_COUNT, &WideChars);
+        if (SpanCount > 0) {
+            for (SpanIndex = 0; SpanIndex < SpanCount; SpanIndex++) {
+                LineLength = Spans[SpanIndex].LengthInChars;
+                if (!WideChars && LineLength > 0) {
+                    LineLength = YoriLibGetMultibyteInputSizeNeeded(Spans[SpanIndex].StartOfLine, LineLength);
+                }
+                LinesRecordLine(LinesContext, LineLength, &OneLineFound);
+            }
+            continue;
         }
 
-        LinesContext->FileLinesFound++;
-        LinesContext->FileTotalChars = LinesContext->FileTotalChars + LineString.LengthInChars;
-        if (LineString.LengthInChars > LinesContext->FileLongestLine) {
-            LinesContext->FileLongestLine = LineString.LengthInChars;
+        if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
+            break;
         }
 
-        if (!OneLineFound || LineString.LengthInChars < LinesContext->FileShortestLine) {
-            LinesContext->FileShortestLine = LineString.LengthInChars;
-            OneLineFound = TRUE;
-        }
+        LinesRecordLine(LinesContext, LineString.LengthInChars, &OneLineFound);
     }
 
     YoriLibLineReadCloseOrCache(LineContext);
@@ -160,6 +160,410 @@ LsofFileFoundCallback(
     return TRUE;
 }
 
+/**
+ The number of handle names that can be resolved concurrently.
+ */
+#define LSOF_RESOLVER_COUNT 8
+
+/**
+ The number of milliseconds to wait for the name of a handle to be resolved
+ before abandoning the query.  Queries against some objects, notably
+ synchronous named pipes, can block indefinitely.
+ */
+#define LSOF_RESOLVE_TIMEOUT 500
+
+/**
+ The number of object type indexes whose type is remembered.  Handles with
+ a type index beyond this have their type queried each time.
+ */
+#define LSOF_TYPE_CACHE_SIZE 256
+
+/**
+ The type of objects with this type index has not been determined.
+ */
+#define LSOF_TYPE_UNKNOWN 0
+
+/**
+ Objects with this type index are files.
+ */
+#define LSOF_TYPE_FILE    1
+
+/**
+ Objects with this type index are not files.
+ */
+#define LSOF_TYPE_OTHER   2
+
+/**
+ State for resolving the name of a single handle at a time.  Each resolver
+ has its own thread which performs the query, so that a query that never
+ completes only consumes that thread.  A resolver whose query has timed out
+ is abandoned, and its thread frees it when the query eventually completes.
+ */
+typedef struct _LSOF_RESOLVER {
+
+    /**
+     The number of references on the resolver.  One is held by the thread
+     that is dispatching queries, and one by the resolver thread if it
+     exists.
+     */
+    LONG ReferenceCount;
+
+    /**
+     Set to TRUE to indicate the resolver thread should terminate.
+     */
+    BOOLEAN Abandoned;
+
+    /**
+     Handle to the resolver thread.  This can be NULL if the thread could
+     not be created, in which case queries are performed synchronously.
+     */
+    HANDLE Thread;
+
+    /**
+     An event signalled to indicate a query should be performed or the
+     thread should terminate.
+     */
+    HANDLE RequestEvent;
+
+    /**
+     An event signalled by the resolver thread when a query is complete.
+     */
+    HANDLE CompleteEvent;
+
+    /**
+     A local instance of the handle to query.  This is owned by the
+     resolver, and closed when the resolver is freed if the dispatching
+     thread did not close it after the query completed.
+     */
+    HANDLE Handle;
+
+    /**
+     The number of bytes in the ObjectName buffer.
+     */
+    YORI_ALLOC_SIZE_T ObjectNameLength;
+
+    /**
+     A buffer to receive the NT name of the object.
+     */
+    PYORI_OBJECT_NAME_INFORMATION ObjectName;
+
+    /**
+     A buffer to receive the Win32 name of the object.
+     */
+    YORI_STRING FinalPath;
+
+    /**
+     On completion of a query, refers to the name to display, which points
+     into either the ObjectName or FinalPath buffers.
+     */
+    YORI_STRING Name;
+
+} LSOF_RESOLVER, *PLSOF_RESOLVER;
+
+/**
+ A set of file handles within a single process whose names are being
+ resolved concurrently.
+ */
+typedef struct _LSOF_BATCH {
+
+    /**
+     The number of handles currently being resolved.
+     */
+    DWORD Count;
+
+    /**
+     The tick count when the first handle in the batch was submitted.
+     */
+    DWORD StartTick;
+
+    /**
+     The resolvers used for each entry in the batch.
+     */
+    PLSOF_RESOLVER Resolvers[LSOF_RESOLVER_COUNT];
+
+    /**
+     The system handle entry being resolved by each resolver.
+     */
+    PYORI_SYSTEM_HANDLE_ENTRY_EX Handles[LSOF_RESOLVER_COUNT];
+
+} LSOF_BATCH, *PLSOF_BATCH;
+
+/**
+ Query the name of the handle in a resolver.  This may block indefinitely.
+
+ @param Resolver Pointer to the resolver containing the handle to query.
+        On completion, its Name field is updated to refer to the name of
+        the object.
+ */
+VOID
+LsofResolveName(
+    __inout PLSOF_RESOLVER Resolver
+    )
+{
+    DWORD LengthReturned;
+
+    YoriLibInitEmptyString(&Resolver->Name);
+    Resolver->ObjectName->Name.LengthInBytes = 0;
+    DllNtDll.pNtQueryObject(Resolver->Handle, 1, Resolver->ObjectName, Resolver->ObjectNameLength, &LengthReturned);
+    if (Resolver->ObjectName->Name.LengthInBytes > 0) {
+        Resolver->Name.LengthInChars = Resolver->ObjectName->Name.LengthInBytes / sizeof(WCHAR);
+        Resolver->Name.StartOfString = Resolver->ObjectName->Name.Buffer;
+    }
+
+    //
+    //  If it's possible to get a Win32 path name, display that.
+    //  Otherwise, use what we have.
+    //
+
+    Resolver->FinalPath.LengthInChars = 0;
+    if (DllKernel32.pGetFinalPathNameByHandleW != NULL) {
+
+        Resolver->FinalPath.LengthInChars =
+            (YORI_ALLOC_SIZE_T)DllKernel32.pGetFinalPathNameByHandleW(Resolver->Handle,
+                                                                      Resolver->FinalPath.StartOfString,
+                                                                      Resolver->FinalPath.LengthAllocated,
+                                                                      0);
+
+        if (Resolver->FinalPath.LengthInChars > 0 &&
+            Resolver->FinalPath.LengthInChars < Resolver->FinalPath.LengthAllocated) {
+            Resolver->Name.StartOfString = Resolver->FinalPath.StartOfString;
+            Resolver->Name.LengthInChars = Resolver->FinalPath.LengthInChars;
+        }
+    }
+}
+
+/**
+ Release a reference on a resolver, freeing it if this was the last
+ reference.
+
+ @param Resolver Pointer to the resolver.
+ */
+VOID
+LsofDereferenceResolver(
+    __in PLSOF_RESOLVER Resolver
+    )
+{
+    if (InterlockedDecrement(&Resolver->ReferenceCount) != 0) {
+        return;
+    }
+
+    if (Resolver->Handle != NULL) {
+        CloseHandle(Resolver->Handle);
+    }
+    if (Resolver->Thread != NULL) {
+        CloseHandle(Resolver->Thread);
+    }
+    if (Resolver->RequestEvent != NULL) {
+        CloseHandle(Resolver->RequestEvent);
+    }
+    if (Resolver->CompleteEvent != NULL) {
+        CloseHandle(Resolver->CompleteEvent);
+    }
+    YoriLibFreeStringContents(&Resolver->FinalPath);
+    if (Resolver->ObjectName != NULL) {
+        YoriLibFree(Resolver->ObjectName);
+    }
+    YoriLibFree(Resolver);
+}
+
+/**
+ The entrypoint for a resolver thread.  This performs queries as they are
+ requested until the resolver is abandoned.
+
+ @param Context Pointer to the resolver.
+
+ @return Zero.
+ */
+DWORD WINAPI
+LsofResolverThread(
+    __in LPVOID Context
+    )
+{
+    PLSOF_RESOLVER Resolver;
+
+    Resolver = (PLSOF_RESOLVER)Context;
+
+    while (TRUE) {
+        WaitForSingleObject(Resolver->RequestEvent, INFINITE);
+        if (Resolver->Abandoned) {
+            break;
+        }
+        LsofResolveName(Resolver);
+        SetEvent(Resolver->CompleteEvent);
+    }
+
+    LsofDereferenceResolver(Resolver);
+    return 0;
+}
+
+/**
+ Allocate a new resolver and start its thread.  If the thread cannot be
+ started, the resolver is still returned and performs queries
+ synchronously.
+
+ @return Pointer to the resolver, or NULL on allocation failure.
+ */
+PLSOF_RESOLVER
+LsofAllocateResolver(VOID)
+{
+    PLSOF_RESOLVER Resolver;
+    DWORD ThreadId;
+
+    Resolver = YoriLibMalloc(sizeof(LSOF_RESOLVER));
+    if (Resolver == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Resolver, sizeof(LSOF_RESOLVER));
+    Resolver->ReferenceCount = 1;
+
+    Resolver->ObjectNameLength = YoriLibMaximumAllocationInRange(0x4000, 0x10000);
+    Resolver->ObjectName = YoriLibMalloc(Resolver->ObjectNameLength);
+    if (Resolver->ObjectName == NULL) {
+        LsofDereferenceResolver(Resolver);
+        return NULL;
+    }
+
+    if (!YoriLibAllocateString(&Resolver->FinalPath, 0x8000)) {
+        LsofDereferenceResolver(Resolver);
+        return NULL;
+    }
+
+    Resolver->RequestEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    Resolver->CompleteEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (Resolver->RequestEvent != NULL && Resolver->CompleteEvent != NULL) {
+        Resolver->ReferenceCount++;
+        Resolver->Thread = CreateThread(NULL, 0, LsofResolverThread, Resolver, 0, &ThreadId);
+        if (Resolver->Thread == NULL) {
+            Resolver->ReferenceCount--;
+        }
+    }
+
+    return Resolver;
+}
+
+/**
+ Release the dispatching thread's reference on a resolver and indicate its
+ thread should terminate.
+
+ @param Resolver Pointer to the resolver.
+
+ @param WaitForThread If TRUE, wait for the resolver thread to terminate.
+        This should only be used for resolvers that are not performing a
+        query, since a query may never complete.
+ */
+VOID
+LsofReleaseResolver(
+    __in PLSOF_RESOLVER Resolver,
+    __in BOOLEAN WaitForThread
+    )
+{
+    if (Resolver->Thread != NULL) {
+        Resolver->Abandoned = TRUE;
+        SetEvent(Resolver->RequestEvent);
+        if (WaitForThread) {
+            WaitForSingleObject(Resolver->Thread, INFINITE);
+        }
+    }
+    LsofDereferenceResolver(Resolver);
+}
+
+/**
+ Add a handle to a batch and start resolving its name.  The batch must not
+ be full.
+
+ @param Batch Pointer to the batch.
+
+ @param SystemHandle Pointer to the system handle entry describing the
+        handle.
+
+ @param LocalHandle A local instance of the handle.  Ownership of this handle
+        is transferred to the batch.
+ */
+VOID
+LsofSubmitToBatch(
+    __inout PLSOF_BATCH Batch,
+    __in PYORI_SYSTEM_HANDLE_ENTRY_EX SystemHandle,
+    __in HANDLE LocalHandle
+    )
+{
+    PLSOF_RESOLVER Resolver;
+
+    ASSERT(Batch->Count < LSOF_RESOLVER_COUNT);
+
+    if (Batch->Count == 0) {
+        Batch->StartTick = GetTickCount();
+    }
+
+    Resolver = Batch->Resolvers[Batch->Count];
+    Batch->Handles[Batch->Count] = SystemHandle;
+    Batch->Count++;
+
+    ASSERT(Resolver->Handle == NULL);
+    Resolver->Handle = LocalHandle;
+    if (Resolver->Thread != NULL) {
+        SetEvent(Resolver->RequestEvent);
+    } else {
+        LsofResolveName(Resolver);
+    }
+}
+
+/**
+ Wait for the names of all handles in a batch to be resolved and display
+ them in the order they were submitted.  Any query that does not complete
+ within LSOF_RESOLVE_TIMEOUT of the batch starting has its resolver
+ abandoned and replaced.
+
+ @param Batch Pointer to the batch.  On completion the batch is empty.
+
+ @return TRUE to indicate success, FALSE if a replacement resolver could not
+         be allocated.
+ */
+__success(return)
+BOOLEAN
+LsofCompleteBatch(
+    __inout PLSOF_BATCH Batch
+    )
+{
+    PLSOF_RESOLVER Resolver;
+    PYORI_SYSTEM_HANDLE_ENTRY_EX SystemHandle;
+    DWORD Index;
+    DWORD Elapsed;
+    DWORD WaitResult;
+    BOOLEAN Result;
+
+    Result = TRUE;
+    for (Index = 0; Index < Batch->Count; Index++) {
+        Resolver = Batch->Resolvers[Index];
+        SystemHandle = Batch->Handles[Index];
+
+        WaitResult = WAIT_OBJECT_0;
+        if (Resolver->Thread != NULL) {
+            Elapsed = GetTickCount() - Batch->StartTick;
+            if (Elapsed > LSOF_RESOLVE_TIMEOUT) {
+                Elapsed = LSOF_RESOLVE_TIMEOUT;
+            }
+            WaitResult = WaitForSingleObject(Resolver->CompleteEvent, LSOF_RESOLVE_TIMEOUT - Elapsed);
+        }
+
+        if (WaitResult == WAIT_OBJECT_0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Handle %lli Object %p  %y\n"), SystemHandle->HandleValue, SystemHandle->Object, &Resolver->Name);
+            CloseHandle(Resolver->Handle);
+            Resolver->Handle = NULL;
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Handle %lli Object %p  ** TIMED OUT **\n"), SystemHandle->HandleValue, SystemHandle->Object);
+            LsofReleaseResolver(Resolver, FALSE);
+            Batch->Resolvers[Index] = LsofAllocateResolver();
+            if (Batch->Resolvers[Index] == NULL) {
+                Result = FALSE;
+            }
+        }
+    }
+
+    Batch->Count = 0;
+    return Result;
+}
+
 /**
  Display information about handles opened for all processes.
 
@@ -172,19 +576,23 @@ LsofDumpHandles(VOID)
     DWORD_PTR Index;
     PYORI_SYSTEM_HANDLE_ENTRY_EX ThisHandle;
     HANDLE LocalProcessHandle;
-    PYORI_OBJECT_NAME_INFORMATION ObjectName;
     PYORI_OBJECT_TYPE_INFORMATION ObjectType;
     YORI_STRING ModuleNameString;
-    YORI_STRING ObjectNameString;
     YORI_STRING ObjectTypeString;
-    YORI_ALLOC_SIZE_T ObjectNameLength;
     YORI_ALLOC_SIZE_T ObjectTypeLength;
     DWORD LengthReturned;
     HANDLE ProcessHandle;
     DWORD LastPid;
+    DWORD ResolverIndex;
+    WORD TypeIndex;
+    UCHAR TypeState;
+    BOOLEAN Result;
+    LSOF_BATCH Batch;
+    UCHAR TypeCache[LSOF_TYPE_CACHE_SIZE];
 
     ProcessHandle = INVALID_HANDLE_VALUE;
     LastPid = 0;
+    Result = TRUE;
 
     YoriLibLoadPsapiFunctions();
 
@@ -193,33 +601,45 @@ LsofDumpHandles(VOID)
         return FALSE;
     }
 
-    ObjectNameLength = YoriLibMaximumAllocationInRange(0x4000, 0x10000);
-    ObjectName = YoriLibMalloc(ObjectNameLength);
-    if (ObjectName == NULL) {
-        YoriLibFree(Handles);
-        return FALSE;
-    }
-
     ObjectTypeLength = 0x1000;
     ObjectType = YoriLibMalloc(ObjectTypeLength);
-    if (ObjectName == NULL) {
-        YoriLibFree(ObjectName);
+    if (ObjectType == NULL) {
         YoriLibFree(Handles);
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&ModuleNameString, 0x8000)) {
         YoriLibFree(ObjectType);
-        YoriLibFree(ObjectName);
         YoriLibFree(Handles);
         return FALSE;
     }
 
-    for (Index = 0; Index < Handles->NumberOfHandles; Index++) {
+    ZeroMemory(&Batch, sizeof(Batch));
+    for (ResolverIndex = 0; ResolverIndex < LSOF_RESOLVER_COUNT; ResolverIndex++) {
+        Batch.Resolvers[ResolverIndex] = LsofAllocateResolver();
+        if (Batch.Resolvers[ResolverIndex] == NULL) {
+            Result = FALSE;
+            break;
+        }
+    }
+
+    ZeroMemory(TypeCache, sizeof(TypeCache));
+
+    for (Index = 0; Result && Index < Handles->NumberOfHandles; Index++) {
         ThisHandle = &Handles->Handles[Index];
         if (ProcessHandle == INVALID_HANDLE_VALUE ||
             LastPid != ThisHandle->ProcessId) {
 
+            //
+            //  Display everything from the previous process before moving
+            //  to the next one.
+            //
+
+            if (!LsofCompleteBatch(&Batch)) {
+                Result = FALSE;
+                break;
+            }
+
             if (ProcessHandle != INVALID_HANDLE_VALUE &&
                 ProcessHandle != NULL) {
 
@@ -259,85 +679,104 @@ LsofDumpHandles(VOID)
             }
         }
 
-        if (ProcessHandle != NULL) {
+        if (ProcessHandle == NULL) {
+            continue;
+        }
 
-            ObjectName->Name.LengthInBytes = 0;
-            ObjectType->TypeName.LengthInBytes = 0;
+        //
+        //  Only display files, since that's part of the point of the
+        //  program.  Every object of a given type has the same type
+        //  index, so once the type of an index is known, handles to
+        //  other types can be skipped without duplicating them.
+        //
 
-            //
-            //  Get a local instance of the handle and see what information
-            //  can be extracted from them
-            //
+        TypeIndex = ThisHandle->ObjectType;
+        if (TypeIndex < LSOF_TYPE_CACHE_SIZE &&
+            TypeCache[TypeIndex] == LSOF_TYPE_OTHER) {
 
-            LocalProcessHandle = INVALID_HANDLE_VALUE;
-            if (DuplicateHandle(ProcessHandle, (HANDLE)ThisHandle->HandleValue, GetCurrentProcess(), &LocalProcessHandle, 0, FALSE, DUPLICATE_SAME_ACCESS)) {
-                DllNtDll.pNtQueryObject(LocalProcessHandle, 1, ObjectName, ObjectNameLength, &LengthReturned);
-                DllNtDll.pNtQueryObject(LocalProcessHandle, 2, ObjectType, ObjectTypeLength, &LengthReturned);
-            } else {
-                LocalProcessHandle = INVALID_HANDLE_VALUE;
-            }
+            continue;
+        }
 
-            //
-            //  Convert any output into strings for display
-            //
+        //
+        //  Get a local instance of the handle and see what information
+        //  can be extracted from it
+        //
+
+        if (!DuplicateHandle(ProcessHandle, (HANDLE)ThisHandle->HandleValue, GetCurrentProcess(), &LocalProcessHandle, 0, FALSE, DUPLICATE_SAME_ACCESS)) {
+            continue;
+        }
+
+        if (TypeIndex >= LSOF_TYPE_CACHE_SIZE ||
+            TypeCache[TypeIndex] == LSOF_TYPE_UNKNOWN) {
+
+            ObjectType->TypeName.LengthInBytes = 0;
+            DllNtDll.pNtQueryObject(LocalProcessHandle, 2, ObjectType, ObjectTypeLength, &LengthReturned);
 
-            YoriLibInitEmptyString(&ObjectNameString);
-            if (ObjectName->Name.LengthInBytes > 0) {
-                ObjectNameString.LengthInChars = ObjectName->Name.LengthInBytes / sizeof(WCHAR);
-                ObjectNameString.StartOfString = ObjectName->Name.Buffer;
-            }
             YoriLibInitEmptyString(&ObjectTypeString);
             if (ObjectType->TypeName.LengthInBytes > 0) {
                 ObjectTypeString.LengthInChars = ObjectType->TypeName.LengthInBytes / sizeof(WCHAR);
                 ObjectTypeString.StartOfString = ObjectType->TypeName.Buffer;
             }
 
+            TypeState = LSOF_TYPE_OTHER;
+            if (YoriLibCompareStringLitIns(&ObjectTypeString, _T("File")) == 0) {
+                TypeState = LSOF_TYPE_FILE;
+            }
+
             //
-            //  Only display files, since that's part of the point of the
-            //  program.
+            //  If the type could not be queried, don't assume anything
+            //  about other handles with the same index.
             //
 
-            if (YoriLibCompareStringLitIns(&ObjectTypeString, _T("File")) == 0) {
+            if (TypeIndex < LSOF_TYPE_CACHE_SIZE &&
+                ObjectTypeString.LengthInChars > 0) {
 
-                PYORI_STRING NameToDisplay;
+                TypeCache[TypeIndex] = TypeState;
+            }
 
-                NameToDisplay = &ObjectNameString;
+            if (TypeState != LSOF_TYPE_FILE) {
+                CloseHandle(LocalProcessHandle);
+                continue;
+            }
+        }
 
-                //
-                //  If it's possible to get a Win32 path name, display that.
-                //  Otherwise, use what we have.
-                //
+        if (Batch.Count == LSOF_RESOLVER_COUNT) {
+            if (!LsofCompleteBatch(&Batch)) {
+                CloseHandle(LocalProcessHandle);
+                Result = FALSE;
+                break;
+            }
+        }
 
-                ModuleNameString.LengthInChars = 0;
-                if (DllKernel32.pGetFinalPathNameByHandleW != NULL) {
+        LsofSubmitToBatch(&Batch, ThisHandle, LocalProcessHandle);
+    }
 
-                    ModuleNameString.LengthInChars =
-                        (YORI_ALLOC_SIZE_T)DllKernel32.pGetFinalPathNameByHandleW(LocalProcessHandle,
-                                                                                  ModuleNameString.StartOfString,
-                                                                                  ModuleNameString.LengthAllocated,
-                                                                                  0);
+    if (Result) {
+        Result = LsofCompleteBatch(&Batch);
+    }
 
-                    if (ModuleNameString.LengthInChars > 0 &&
-                        ModuleNameString.LengthInChars < ModuleNameString.LengthAllocated) {
-                        NameToDisplay = &ModuleNameString;
-                    }
-                }
+    if (ProcessHandle != INVALID_HANDLE_VALUE &&
+        ProcessHandle != NULL) {
 
+        CloseHandle(ProcessHandle);
+    }
 
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Handle %lli Object %p  %y\n"), ThisHandle->HandleValue, ThisHandle->Object, NameToDisplay);
-            }
+    //
+    //  Any resolver still in a batch here is idle, except on failure where
+    //  the batch was not completed.  In that case, don't wait for threads
+    //  whose query may never return.
+    //
 
-            if (LocalProcessHandle != INVALID_HANDLE_VALUE) {
-                CloseHandle(LocalProcessHandle);
-            }
+    for (ResolverIndex = 0; ResolverIndex < LSOF_RESOLVER_COUNT; ResolverIndex++) {
+        if (Batch.Resolvers[ResolverIndex] != NULL) {
+            LsofReleaseResolver(Batch.Resolvers[ResolverIndex], (BOOLEAN)(ResolverIndex >= Batch.Count));
         }
     }
 
     YoriLibFreeStringContents(&ModuleNameString);
     YoriLibFree(ObjectType);
-    YoriLibFree(ObjectName);
     YoriLibFree(Handles);
-    return TRUE;
+    return Result;
 }
 
 #ifdef YORI_BUILTIN
@@ -0,0 +1,243 @@
+/**
+ * @file make/artcache.c
+ *
+ * Yori shell make shared artifact cache
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yorish.h>
+#include "make.h"
+
+/**
+ Generate the name of the file within the artifact cache that contains the
+ output of a target.  The name is a hash of the commands used to build the
+ target and the names and contents of its dependencies, so any change to
+ either refers to a different file.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target.
+
+ @param CacheFileName On successful completion, updated to contain a newly
+        allocated string referring to the file within the cache.  This
+        string has extra space allocated so the caller can append a suffix
+        of up to 32 characters.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeArtifactCacheGetFileName(
+    __in PMAKE_CONTEXT MakeContext,
+    __inout PMAKE_TARGET Target,
+    __out PYORI_STRING CacheFileName
+    )
+{
+    YORI_LIB_XXHASH64_STATE State;
+    DWORDLONG CmdHash;
+    DWORDLONG Key;
+
+    if (!MakeBuildDbCalculateInputHash(Target)) {
+        return FALSE;
+    }
+
+    CmdHash = MakeBuildDbCalculateCmdHash(Target);
+
+    YoriLibXxHash64Initialize(&State, 0);
+    YoriLibXxHash64Update(&State, &CmdHash, sizeof(CmdHash));
+    YoriLibXxHash64Update(&State, &Target->BuildDbInputHash, sizeof(Target->BuildDbInputHash));
+    Key = YoriLibXxHash64Finalize(&State);
+
+    if (!YoriLibAllocateString(CacheFileName, MakeContext->ArtifactCacheDir.LengthInChars + 1 + 16 + 32 + 1)) {
+        return FALSE;
+    }
+
+    CacheFileName->LengthInChars = YoriLibSPrintf(CacheFileName->StartOfString, _T("%y\\%016llx"), &MakeContext->ArtifactCacheDir, Key);
+    return TRUE;
+}
+
+/**
+ Attempt to populate the output of a target from the artifact cache rather
+ than executing its recipe.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target that is ready to build.
+
+ @return TRUE to indicate the output was found in the cache and the recipe
+         does not need to be executed, FALSE if it should be built.
+ */
+BOOLEAN
+MakeArtifactCacheFetch(
+    __in PMAKE_CONTEXT MakeContext,
+    __inout PMAKE_TARGET Target
+    )
+{
+    YORI_STRING CacheFileName;
+    PYORI_STRING TargetName;
+    FILETIME Now;
+    HANDLE FileHandle;
+    DWORD Attributes;
+    BOOLEAN Populated;
+
+    if (MakeContext->ArtifactCacheDir.LengthInChars == 0) {
+        return FALSE;
+    }
+
+    if (!MakeArtifactCacheGetFileName(MakeContext, Target, &CacheFileName)) {
+        return FALSE;
+    }
+
+    Attributes = GetFileAttributes(CacheFileName.StartOfString);
+    if (Attributes == (DWORD)-1 ||
+        (Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+
+        YoriLibFreeStringContents(&CacheFileName);
+        return FALSE;
+    }
+
+    TargetName = &Target->HashEntry.Key;
+    ASSERT(YoriLibIsStringNullTerminated(TargetName));
+
+    //
+    //  A hard link requires the target to not exist, and a copy should not
+    //  fail because a stale output is read only.
+    //
+
+    SetFileAttributes(TargetName->StartOfString, FILE_ATTRIBUTE_NORMAL);
+    DeleteFile(TargetName->StartOfString);
+
+    Populated = FALSE;
+    if (MakeContext->ArtifactCacheLink &&
+        DllKernel32.pCreateHardLinkW != NULL &&
+        DllKernel32.pCreateHardLinkW(TargetName->StartOfString, CacheFileName.StartOfString, NULL)) {
+
+        Populated = TRUE;
+    }
+
+    if (!Populated &&
+        CopyFile(CacheFileName.StartOfString, TargetName->StartOfString, FALSE)) {
+
+        Populated = TRUE;
+    }
+
+    YoriLibFreeStringContents(&CacheFileName);
+
+    if (!Populated) {
+        return FALSE;
+    }
+
+    //
+    //  The cached file retains the time it was originally built, which may
+    //  be older than local dependencies.  Mark it as written now so it is
+    //  considered current by timestamp checks in later builds.
+    //
+
+    FileHandle = CreateFile(TargetName->StartOfString,
+                            FILE_WRITE_ATTRIBUTES,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            0,
+                            NULL);
+    if (FileHandle != INVALID_HANDLE_VALUE) {
+        GetSystemTimeAsFileTime(&Now);
+        SetFileTime(FileHandle, NULL, NULL, &Now);
+        CloseHandle(FileHandle);
+    }
+
+    if (!MakeContext->SilentCommandLaunching) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Using cached %y\n"), TargetName);
+    }
+
+    MakeBuildDbUpdateTarget(MakeContext,
+                            Target,
+                            TRUE,
+                            MakeBuildDbGetTargetDuration(MakeContext, Target),
+                            MakeBuildDbGetTargetPeakCommit(MakeContext, Target));
+    return TRUE;
+}
+
+/**
+ Publish the output of a target whose recipe has succeeded to the artifact
+ cache.  The output is copied to a temporary name within the cache and
+ renamed into place, so other machines never observe a partial file.  If
+ another machine published the same output first, that copy is retained.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target whose recipe has succeeded.
+ */
+VOID
+MakeArtifactCachePublish(
+    __in PMAKE_CONTEXT MakeContext,
+    __inout PMAKE_TARGET Target
+    )
+{
+    YORI_STRING CacheFileName;
+    YORI_STRING TempFileName;
+    PYORI_STRING TargetName;
+    DWORD Attributes;
+
+    if (MakeContext->ArtifactCacheDir.LengthInChars == 0) {
+        return;
+    }
+
+    TargetName = &Target->HashEntry.Key;
+    ASSERT(YoriLibIsStringNullTerminated(TargetName));
+
+    Attributes = GetFileAttributes(TargetName->StartOfString);
+    if (Attributes == (DWORD)-1 ||
+        (Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+
+        return;
+    }
+
+    if (!MakeArtifactCacheGetFileName(MakeContext, Target, &CacheFileName)) {
+        return;
+    }
+
+    if (GetFileAttributes(CacheFileName.StartOfString) != (DWORD)-1) {
+        YoriLibFreeStringContents(&CacheFileName);
+        return;
+    }
+
+    if (!YoriLibAllocateString(&TempFileName, CacheFileName.LengthInChars + 32)) {
+        YoriLibFreeStringContents(&CacheFileName);
+        return;
+    }
+
+    TempFileName.LengthInChars = YoriLibSPrintf(TempFileName.StartOfString, _T("%y.%x.%x.tmp"), &CacheFileName, GetCurrentProcessId(), GetTickCount());
+
+    if (CopyFile(TargetName->StartOfString, TempFileName.StartOfString, FALSE)) {
+        if (!MoveFileEx(TempFileName.StartOfString, CacheFileName.StartOfString, 0)) {
+            DeleteFile(TempFileName.StartOfString);
+        }
+    }
+
+    YoriLibFreeStringContents(&TempFileName);
+    YoriLibFreeStringContents(&CacheFileName);
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,698 @@
+/**
+ * @file make/builddb.c
+ *
+ * Yori shell make content based build database
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yorish.h>
+#include "make.h"
+
+/**
+ The size of the buffer used to read files when calculating their hash.
+ */
+#define MAKE_BUILD_DB_READ_BUFFER_SIZE (64 * 1024)
+
+/**
+ Generate the build database file name from the makefile name.
+
+ @param MakeFileName Pointer to the makefile name.
+
+ @param DbFileName On successful completion, updated to contain a newly
+        allocated string referring to the file name of the build database.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeGetBuildDbFileNameFromMakeFileName(
+    __in PYORI_STRING MakeFileName,
+    __out PYORI_STRING DbFileName
+    )
+{
+    YoriLibInitEmptyString(DbFileName);
+    if (MakeFileName->LengthInChars > 0) {
+        if (YoriLibAllocateString(DbFileName, MakeFileName->LengthInChars + sizeof(".bdb"))) {
+            DbFileName->LengthInChars = YoriLibSPrintf(DbFileName->StartOfString, _T("%y.bdb"), MakeFileName);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Insert or update a record in the build database.
+
+ @param MakeContext Pointer to the context.
+
+ @param TargetName Pointer to the full name of the target.
+
+ @param CmdHash The hash of the commands used to build the target.
+
+ @param InputHash The hash of the names and contents of all of the target's
+        dependencies.
+
+ @param OutputTime The last write time of the target after it was built.
+
+ @param Duration The time taken to execute the recipe, in milliseconds.
+
+ @param PeakCommit The largest commit charge, in bytes, of any process
+        launched by the recipe.
+ */
+VOID
+MakeBuildDbSetRecord(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING TargetName,
+    __in DWORDLONG CmdHash,
+    __in DWORDLONG InputHash,
+    __in LARGE_INTEGER OutputTime,
+    __in DWORD Duration,
+    __in DWORDLONG PeakCommit
+    )
+{
+    PMAKE_BUILD_DB_ENTRY Entry;
+    PYORI_HASH_ENTRY HashEntry;
+
+    HashEntry = YoriLibHashLookupByKey(MakeContext->BuildDatabase, TargetName);
+    if (HashEntry != NULL) {
+        Entry = CONTAINING_RECORD(HashEntry, MAKE_BUILD_DB_ENTRY, HashEntry);
+    } else {
+        Entry = YoriLibMalloc(sizeof(MAKE_BUILD_DB_ENTRY));
+        if (Entry == NULL) {
+            return;
+        }
+
+        ZeroMemory(Entry, sizeof(MAKE_BUILD_DB_ENTRY));
+        YoriLibHashInsertByKey(MakeContext->BuildDatabase, TargetName, Entry, &Entry->HashEntry);
+        YoriLibAppendList(&MakeContext->BuildDatabaseList, &Entry->ListEntry);
+    }
+
+    Entry->CmdHash = CmdHash;
+    Entry->InputHash = InputHash;
+    Entry->OutputTime.QuadPart = OutputTime.QuadPart;
+    Entry->Duration = Duration;
+    Entry->PeakCommit = PeakCommit;
+}
+
+/**
+ Remove a record from the build database, if it exists.
+
+ @param MakeContext Pointer to the context.
+
+ @param TargetName Pointer to the full name of the target.
+ */
+VOID
+MakeBuildDbRemoveRecord(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING TargetName
+    )
+{
+    PMAKE_BUILD_DB_ENTRY Entry;
+    PYORI_HASH_ENTRY HashEntry;
+
+    HashEntry = YoriLibHashLookupByKey(MakeContext->BuildDatabase, TargetName);
+    if (HashEntry == NULL) {
+        return;
+    }
+
+    Entry = CONTAINING_RECORD(HashEntry, MAKE_BUILD_DB_ENTRY, HashEntry);
+    YoriLibRemoveListItem(&Entry->ListEntry);
+    YoriLibHashRemoveByEntry(&Entry->HashEntry);
+    YoriLibFree(Entry);
+}
+
+/**
+ Load the build database from a file.
+
+ @param MakeContext Pointer to the context.
+
+ @param MakeFileName Pointer to the file name of the makefile.  If this
+        contains a string, it will be used as the base name for the database.
+ */
+VOID
+MakeLoadBuildDatabase(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    )
+{
+    YORI_STRING DbFileName;
+    YORI_STRING LineString;
+    YORI_STRING Remaining;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    YORI_MAX_SIGNED_T llTemp;
+    DWORDLONG Fields[5];
+    DWORDLONG TotalDuration;
+    DWORD EntryCount;
+    LARGE_INTEGER OutputTime;
+    DWORD Index;
+    HANDLE hDb;
+    PVOID LineContext = NULL;
+
+    if (!MakeGetBuildDbFileNameFromMakeFileName(MakeFileName, &DbFileName)) {
+        return;
+    }
+
+    hDb = CreateFile(DbFileName.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    YoriLibFreeStringContents(&DbFileName);
+    if (hDb == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    YoriLibInitEmptyString(&LineString);
+    TotalDuration = 0;
+    EntryCount = 0;
+
+    while (TRUE) {
+        if (!YoriLibReadLineToString(&LineString, &LineContext, hDb)) {
+            break;
+        }
+
+        //
+        //  The format of each line is expected to be:
+        //  CmdHash:InputHash:OutputTime:Duration:PeakCommit:TargetName
+        //
+        //  Older databases have no PeakCommit field.  Since target names
+        //  start with a drive letter that looks like a hex number followed
+        //  by a colon, PeakCommit is always written with 16 digits and is
+        //  only accepted if it has that length.
+        //
+
+        YoriLibInitEmptyString(&Remaining);
+        Remaining.StartOfString = LineString.StartOfString;
+        Remaining.LengthInChars = LineString.LengthInChars;
+
+        for (Index = 0; Index < sizeof(Fields)/sizeof(Fields[0]); Index++) {
+            if (!YoriLibStringToNumberBase(&Remaining, 16, FALSE, &llTemp, &CharsConsumed) ||
+                CharsConsumed == 0 ||
+                (Index == 4 && CharsConsumed != 16) ||
+                CharsConsumed >= Remaining.LengthInChars ||
+                Remaining.StartOfString[CharsConsumed] != ':') {
+
+                break;
+            }
+            Fields[Index] = (DWORDLONG)llTemp;
+            Remaining.StartOfString = Remaining.StartOfString + CharsConsumed + 1;
+            Remaining.LengthInChars = Remaining.LengthInChars - CharsConsumed - 1;
+        }
+
+        if (Index < 4 || Remaining.LengthInChars == 0) {
+            continue;
+        }
+
+        if (Index == 4) {
+            Fields[4] = 0;
+        }
+
+        OutputTime.QuadPart = (LONGLONG)Fields[2];
+        MakeBuildDbSetRecord(MakeContext, &Remaining, Fields[0], Fields[1], OutputTime, (DWORD)Fields[3], Fields[4]);
+        TotalDuration = TotalDuration + (DWORD)Fields[3];
+        EntryCount++;
+    }
+
+    //
+    //  Targets that have not been built before are assumed to take as long
+    //  as an average target.
+    //
+
+    if (EntryCount > 0 && TotalDuration >= EntryCount) {
+        MakeContext->BuildDbDefaultDuration = (DWORD)(TotalDuration / EntryCount);
+    }
+
+    YoriLibLineReadCloseOrCache(LineContext);
+    YoriLibFreeStringContents(&LineString);
+    CloseHandle(hDb);
+}
+
+/**
+ Write the build database to a file and free all of its entries.
+
+ @param MakeContext Pointer to the context.
+
+ @param MakeFileName Pointer to the file name of the makefile.  If this
+        contains a string, it will be used as the base name for the database.
+ */
+VOID
+MakeSaveAndDeleteBuildDatabase(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_BUILD_DB_ENTRY Entry;
+    YORI_STRING DbFileName;
+    HANDLE hDb;
+
+    if (MakeContext->BuildDatabase == NULL) {
+        return;
+    }
+
+    hDb = NULL;
+    if (MakeGetBuildDbFileNameFromMakeFileName(MakeFileName, &DbFileName)) {
+        hDb = CreateFile(DbFileName.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hDb == INVALID_HANDLE_VALUE) {
+            hDb = NULL;
+        }
+        YoriLibFreeStringContents(&DbFileName);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->BuildDatabaseList, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, MAKE_BUILD_DB_ENTRY, ListEntry);
+
+        if (hDb != NULL) {
+            YoriLibOutputToDevice(hDb, 0, _T("%016llx:%016llx:%016llx:%x:%016llx:%y\n"), Entry->CmdHash, Entry->InputHash, Entry->OutputTime.QuadPart, Entry->Duration, Entry->PeakCommit, &Entry->HashEntry.Key);
+        }
+        YoriLibRemoveListItem(&Entry->ListEntry);
+        YoriLibHashRemoveByEntry(&Entry->HashEntry);
+        YoriLibFree(Entry);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->BuildDatabaseList, NULL);
+    }
+    YoriLibFreeEmptyHashTable(MakeContext->BuildDatabase);
+    MakeContext->BuildDatabase = NULL;
+
+    if (hDb != NULL) {
+        CloseHandle(hDb);
+    }
+}
+
+/**
+ Query the current last write time of a target.
+
+ @param Target Pointer to the target.
+
+ @param WriteTime On successful completion, updated to contain the last
+        write time of the target.
+
+ @return TRUE if the target exists as a file, FALSE if it does not.
+ */
+__success(return)
+BOOLEAN
+MakeBuildDbQueryWriteTime(
+    __in PMAKE_TARGET Target,
+    __out PLARGE_INTEGER WriteTime
+    )
+{
+    HANDLE FileHandle;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    BOOLEAN Result;
+
+    ASSERT(YoriLibIsStringNullTerminated(&Target->HashEntry.Key));
+    FileHandle = CreateFile(Target->HashEntry.Key.StartOfString,
+                            FILE_READ_ATTRIBUTES | FILE_READ_DATA,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_FLAG_BACKUP_SEMANTICS,
+                            NULL);
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    Result = FALSE;
+    if (GetFileInformationByHandle(FileHandle, &FileInfo) &&
+        (FileInfo.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+
+        WriteTime->LowPart = FileInfo.ftLastWriteTime.dwLowDateTime;
+        WriteTime->HighPart = FileInfo.ftLastWriteTime.dwHighDateTime;
+        Result = TRUE;
+    }
+
+    CloseHandle(FileHandle);
+    return Result;
+}
+
+/**
+ Calculate the hash of the contents of a target's file.  This is calculated
+ once per target, since a file is frequently a dependency of many targets.
+ A target that is not a file, such as a directory or a target with no
+ file, is given a hash of zero.
+
+ @param Target Pointer to the target.
+
+ @param Buffer Pointer to a buffer of MAKE_BUILD_DB_READ_BUFFER_SIZE bytes to
+        use when reading the file.
+
+ @return The hash of the file contents.
+ */
+DWORDLONG
+MakeBuildDbHashTargetContents(
+    __inout PMAKE_TARGET Target,
+    __out_bcount(MAKE_BUILD_DB_READ_BUFFER_SIZE) PUCHAR Buffer
+    )
+{
+    YORI_LIB_XXHASH64_STATE State;
+    HANDLE FileHandle;
+    DWORD BytesRead;
+
+    if (Target->ContentHashed) {
+        return Target->ContentHash;
+    }
+
+    Target->ContentHash = 0;
+    Target->ContentHashed = TRUE;
+
+    ASSERT(YoriLibIsStringNullTerminated(&Target->HashEntry.Key));
+    FileHandle = CreateFile(Target->HashEntry.Key.StartOfString,
+                            FILE_READ_DATA,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN,
+                            NULL);
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return Target->ContentHash;
+    }
+
+    YoriLibXxHash64Initialize(&State, 0);
+    while (ReadFile(FileHandle, Buffer, MAKE_BUILD_DB_READ_BUFFER_SIZE, &BytesRead, NULL) && BytesRead > 0) {
+        YoriLibXxHash64Update(&State, Buffer, BytesRead);
+    }
+    CloseHandle(FileHandle);
+
+    Target->ContentHash = YoriLibXxHash64Finalize(&State);
+    return Target->ContentHash;
+}
+
+/**
+ Calculate the hash of the names and contents of a target's dependencies.
+ This is only called once none of the target's dependencies will be rebuilt,
+ so the contents reflect what the target would be built from.
+
+ @param Target Pointer to the target.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeBuildDbCalculateInputHash(
+    __inout PMAKE_TARGET Target
+    )
+{
+    YORI_LIB_XXHASH64_STATE State;
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET_DEPENDENCY Dependency;
+    PYORI_STRING ParentName;
+    DWORDLONG ContentHash;
+    PUCHAR Buffer;
+
+    if (Target->BuildDbInputHashCalculated) {
+        return TRUE;
+    }
+
+    Buffer = YoriLibMalloc(MAKE_BUILD_DB_READ_BUFFER_SIZE);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    YoriLibXxHash64Initialize(&State, 0);
+    ListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, NULL);
+    while (ListEntry != NULL) {
+        Dependency = CONTAINING_RECORD(ListEntry, MAKE_TARGET_DEPENDENCY, ChildDependents);
+        ASSERT(Dependency->Child == Target);
+        ParentName = &Dependency->Parent->HashEntry.Key;
+        ContentHash = MakeBuildDbHashTargetContents(Dependency->Parent, Buffer);
+        YoriLibXxHash64Update(&State, &ParentName->LengthInChars, sizeof(ParentName->LengthInChars));
+        YoriLibXxHash64Update(&State, ParentName->StartOfString, ParentName->LengthInChars * sizeof(TCHAR));
+        YoriLibXxHash64Update(&State, &ContentHash, sizeof(ContentHash));
+        ListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, ListEntry);
+    }
+
+    YoriLibFree(Buffer);
+
+    Target->BuildDbInputHash = YoriLibXxHash64Finalize(&State);
+    Target->BuildDbInputHashCalculated = TRUE;
+    return TRUE;
+}
+
+/**
+ Calculate the hash of the commands used to build a target.  This is only
+ meaningful once the commands have been generated, when the target has been
+ marked for rebuild.
+
+ @param Target Pointer to the target.
+
+ @return The hash of the commands.
+ */
+DWORDLONG
+MakeBuildDbCalculateCmdHash(
+    __in PMAKE_TARGET Target
+    )
+{
+    YORI_LIB_XXHASH64_STATE State;
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_CMD_TO_EXEC CmdToExec;
+    UCHAR Flags[2];
+
+    YoriLibXxHash64Initialize(&State, 0);
+    ListEntry = YoriLibGetNextListEntry(&Target->ExecCmds, NULL);
+    while (ListEntry != NULL) {
+        CmdToExec = CONTAINING_RECORD(ListEntry, MAKE_CMD_TO_EXEC, ListEntry);
+        Flags[0] = CmdToExec->DisplayCmd;
+        Flags[1] = CmdToExec->IgnoreErrors;
+        YoriLibXxHash64Update(&State, Flags, sizeof(Flags));
+        YoriLibXxHash64Update(&State, &CmdToExec->Cmd.LengthInChars, sizeof(CmdToExec->Cmd.LengthInChars));
+        YoriLibXxHash64Update(&State, CmdToExec->Cmd.StartOfString, CmdToExec->Cmd.LengthInChars * sizeof(TCHAR));
+        ListEntry = YoriLibGetNextListEntry(&Target->ExecCmds, ListEntry);
+    }
+
+    return YoriLibXxHash64Finalize(&State);
+}
+
+/**
+ Check whether a target that timestamps indicate is up to date was built from
+ different inputs than it has now.  This catches changes that preserve
+ timestamps, such as a tool restoring an older file.  This is only called
+ when none of the target's dependencies will be rebuilt.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target.
+
+ @return TRUE if the build database has a record for the target that
+         indicates its inputs have changed, FALSE if they have not, or if
+         there is no record.
+ */
+BOOLEAN
+MakeBuildDbHaveInputsChanged(
+    __in PMAKE_CONTEXT MakeContext,
+    __inout PMAKE_TARGET Target
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PMAKE_BUILD_DB_ENTRY Entry;
+
+    if (MakeContext->BuildDatabase == NULL) {
+        return FALSE;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(MakeContext->BuildDatabase, &Target->HashEntry.Key);
+    if (HashEntry == NULL) {
+        return FALSE;
+    }
+
+    if (!MakeBuildDbCalculateInputHash(Target)) {
+        return FALSE;
+    }
+
+    Entry = CONTAINING_RECORD(HashEntry, MAKE_BUILD_DB_ENTRY, HashEntry);
+    if (Entry->InputHash != Target->BuildDbInputHash) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Check whether a target that is ready to build can be skipped because the
+ build database indicates it was previously built with the same commands
+ from the same inputs, and the file it produced has not changed since.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target that is ready to build.
+
+ @return TRUE to indicate the target is current and its recipe does not need
+         to be executed, FALSE if it should be built.
+ */
+BOOLEAN
+MakeBuildDbIsTargetCurrent(
+    __in PMAKE_CONTEXT MakeContext,
+    __inout PMAKE_TARGET Target
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PMAKE_BUILD_DB_ENTRY Entry;
+    LARGE_INTEGER WriteTime;
+
+    if (MakeContext->BuildDatabase == NULL) {
+        return FALSE;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(MakeContext->BuildDatabase, &Target->HashEntry.Key);
+    if (HashEntry == NULL) {
+        return FALSE;
+    }
+
+    if (!MakeBuildDbCalculateInputHash(Target)) {
+        return FALSE;
+    }
+
+    Entry = CONTAINING_RECORD(HashEntry, MAKE_BUILD_DB_ENTRY, HashEntry);
+    if (Entry->InputHash != Target->BuildDbInputHash ||
+        Entry->CmdHash != MakeBuildDbCalculateCmdHash(Target)) {
+
+        return FALSE;
+    }
+
+    //
+    //  If the output was modified or deleted since it was built, it can't
+    //  be trusted.
+    //
+
+    if (!MakeBuildDbQueryWriteTime(Target, &WriteTime) ||
+        WriteTime.QuadPart != Entry->OutputTime.QuadPart) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Return the expected time to execute a target's recipe.  This is the time
+ it took when it was last built if that is known.  If the build database is
+ not in use, every target with commands is assumed to take the same time.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target.
+
+ @return The expected time to execute the recipe, in milliseconds when the
+         build database is in use.
+ */
+DWORD
+MakeBuildDbGetTargetDuration(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PMAKE_BUILD_DB_ENTRY Entry;
+
+    if (YoriLibIsListEmpty(&Target->ExecCmds)) {
+        return 0;
+    }
+
+    if (MakeContext->BuildDatabase == NULL) {
+        return 1;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(MakeContext->BuildDatabase, &Target->HashEntry.Key);
+    if (HashEntry == NULL) {
+        if (MakeContext->BuildDbDefaultDuration == 0) {
+            return 1;
+        }
+        return MakeContext->BuildDbDefaultDuration;
+    }
+
+    Entry = CONTAINING_RECORD(HashEntry, MAKE_BUILD_DB_ENTRY, HashEntry);
+    return Entry->Duration;
+}
+
+/**
+ Return the largest commit charge of any process launched by a target's
+ recipe when it was last built.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target.
+
+ @return The peak commit charge in bytes, or zero if it is not known.
+ */
+DWORDLONG
+MakeBuildDbGetTargetPeakCommit(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PMAKE_BUILD_DB_ENTRY Entry;
+
+    if (MakeContext->BuildDatabase == NULL) {
+        return 0;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(MakeContext->BuildDatabase, &Target->HashEntry.Key);
+    if (HashEntry == NULL) {
+        return 0;
+    }
+
+    Entry = CONTAINING_RECORD(HashEntry, MAKE_BUILD_DB_ENTRY, HashEntry);
+    return Entry->PeakCommit;
+}
+
+/**
+ Update the build database after a target's recipe has finished executing.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target whose recipe has finished.
+
+ @param Succeeded TRUE if the recipe succeeded, FALSE if it failed.  If the
+        recipe failed, any record for the target is removed, since its
+        output may be incomplete.
+
+ @param Duration The time taken to execute the recipe, in milliseconds.
+
+ @param PeakCommit The largest commit charge, in bytes, of any process
+        launched by the recipe.
+ */
+VOID
+MakeBuildDbUpdateTarget(
+    __in PMAKE_CONTEXT MakeContext,
+    __inout PMAKE_TARGET Target,
+    __in BOOLEAN Succeeded,
+    __in DWORD Duration,
+    __in DWORDLONG PeakCommit
+    )
+{
+    LARGE_INTEGER WriteTime;
+
+    if (MakeContext->BuildDatabase == NULL) {
+        return;
+    }
+
+    if (!Succeeded ||
+        !MakeBuildDbCalculateInputHash(Target) ||
+        !MakeBuildDbQueryWriteTime(Target, &WriteTime)) {
+
+        MakeBuildDbRemoveRecord(MakeContext, &Target->HashEntry.Key);
+        return;
+    }
+
+    MakeBuildDbSetRecord(MakeContext, &Target->HashEntry.Key, MakeBuildDbCalculateCmdHash(Target), Target->BuildDbInputHash, WriteTime, Duration, PeakCommit);
+}
+
+// vim:sw=4:ts=4:et:
@@ -69,6 +69,49 @@ typedef struct _MAKE_CHILD_RECIPE {
      */
     HANDLE ProcessHandle;
 
+    /**
+     Nonzero if a wait thread should wait for ProcessHandle to complete.
+     This is set by the main thread once a process has been launched and
+     cleared by the wait thread when the process completes.
+     */
+    LONG volatile WaitArmed;
+
+    /**
+     The system time when the target's recipe started executing.
+     */
+    DWORDLONG StartTime;
+
+    /**
+     The performance counter value when the current command was launched.
+     This is only used when collecting a trace.
+     */
+    LARGE_INTEGER CmdStartTime;
+
+    /**
+     Output from the commands in the target executed so far.  This is
+     displayed when the target completes, so that output from targets that
+     execute concurrently is not interleaved.
+     */
+    YORI_STRING Output;
+
+    /**
+     If a command in the target failed, points to the command so it can be
+     displayed when the target completes.
+     */
+    PMAKE_CMD_TO_EXEC FailedCmd;
+
+    /**
+     The largest commit charge, in bytes, that the build database recorded
+     for this target when it was last built, or zero if not known.
+     */
+    DWORDLONG ExpectedCommit;
+
+    /**
+     The largest commit charge, in bytes, of any process launched by this
+     recipe so far.
+     */
+    DWORDLONG PeakCommit;
+
     /**
      A command context.  Should be deallocated if CmdContextPresent is TRUE.
      */
@@ -80,6 +123,113 @@ typedef struct _MAKE_CHILD_RECIPE {
     YORI_LIBSH_EXEC_PLAN ExecPlan;
 } MAKE_CHILD_RECIPE, *PMAKE_CHILD_RECIPE;
 
+/**
+ The number of child processes that a single wait thread can wait for.  One
+ wait object is reserved for the event used to tell the thread that the set
+ of processes to wait for has changed.
+ */
+#define MAKE_PROCESSES_PER_WAIT_THREAD (MAXIMUM_WAIT_OBJECTS - 1)
+
+/**
+ Forward declaration of the set of wait threads.
+ */
+typedef struct _MAKE_WAIT_POOL *PMAKE_WAIT_POOL;
+
+/**
+ A thread which waits for a range of child recipe slots to complete.
+ */
+typedef struct _MAKE_WAIT_THREAD {
+
+    /**
+     Pointer to the set of wait threads this thread belongs to.
+     */
+    PMAKE_WAIT_POOL Pool;
+
+    /**
+     A handle to the thread.
+     */
+    HANDLE Thread;
+
+    /**
+     An auto reset event signalled when a slot owned by this thread has a
+     new process to wait for, or the thread should exit.
+     */
+    HANDLE WakeEvent;
+
+    /**
+     The first child recipe slot owned by this thread.
+     */
+    DWORD FirstSlot;
+
+    /**
+     The number of child recipe slots owned by this thread.
+     */
+    DWORD SlotCount;
+} MAKE_WAIT_THREAD, *PMAKE_WAIT_THREAD;
+
+/**
+ A set of threads which wait for child processes and report their
+ completion to the main thread.  Each thread waits for up to
+ MAKE_PROCESSES_PER_WAIT_THREAD processes, so the number of concurrent
+ child processes is not limited by WaitForMultipleObjects, and the main
+ thread finds each completed slot in constant time.
+ */
+typedef struct _MAKE_WAIT_POOL {
+
+    /**
+     The array of child recipes being waited for.
+     */
+    PMAKE_CHILD_RECIPE ChildRecipeArray;
+
+    /**
+     The number of elements in ChildRecipeArray.
+     */
+    DWORD SlotCount;
+
+    /**
+     The number of wait threads.
+     */
+    DWORD ThreadCount;
+
+    /**
+     An array of wait threads.
+     */
+    PMAKE_WAIT_THREAD Threads;
+
+    /**
+     A mutex protecting the queue of completed slots.
+     */
+    HANDLE Mutex;
+
+    /**
+     A semaphore whose count is the number of completed slots in the
+     queue.
+     */
+    HANDLE CompletionSemaphore;
+
+    /**
+     A circular queue of slots which have completed and have not yet been
+     processed by the main thread.  Each slot can only be in the queue once,
+     so this has SlotCount elements.
+     */
+    PDWORD CompletedSlots;
+
+    /**
+     The index within CompletedSlots of the oldest completed slot.
+     */
+    DWORD CompletedHead;
+
+    /**
+     The number of slots in CompletedSlots.
+     */
+    DWORD CompletedCount;
+
+    /**
+     Set to TRUE to indicate that wait threads should exit.
+     */
+    BOOLEAN volatile Shutdown;
+} MAKE_WAIT_POOL;
+
 /**
  Attempt to set the temporary directory for this process to match the
  specified JobId, creating the directory if it does not exist.
@@ -99,26 +249,23 @@ MakeSetTemporaryDirectory(
     __in DWORD JobId
     )
 {
-    DWORDLONG TestMask;
     YORI_STRING JobTempPath;
 
     ASSERT(JobId < MakeContext->NumberProcesses);
-    TestMask = 1;
-    TestMask = TestMask << JobId;
 
-    if (!YoriLibAllocateString(&JobTempPath, MakeContext->TempPath.LengthInChars + sizeof("\\YMAKE12"))) {
+    if (!YoriLibAllocateString(&JobTempPath, MakeContext->TempPath.LengthInChars + sizeof("\\YMAKE1234"))) {
         return FALSE;
     }
 
     JobTempPath.LengthInChars = YoriLibSPrintf(JobTempPath.StartOfString, _T("%y\\YMAKE%i"), &MakeContext->TempPath, JobId);
 
-    if ((MakeContext->TempDirectoriesCreated & TestMask) == 0) {
+    if (!MakeContext->TempDirectoriesCreated[JobId]) {
         if (!YoriLibCreateDirectoryAndParents(&JobTempPath)) {
             YoriLibFreeStringContents(&JobTempPath);
             return FALSE;
         }
 
-        MakeContext->TempDirectoriesCreated = MakeContext->TempDirectoriesCreated | TestMask;
+        MakeContext->TempDirectoriesCreated[JobId] = TRUE;
     }
 
     if (!SetEnvironmentVariable(_T("TEMP"), JobTempPath.StartOfString)) {
@@ -148,23 +295,25 @@ MakeCleanupTemporaryDirectories(
     )
 {
     DWORD Probe;
-    DWORDLONG TestMask;
     YORI_STRING TempPath;
 
-    if (!YoriLibAllocateString(&TempPath, MakeContext->TempPath.LengthInChars + sizeof("\\YMAKE12"))) {
+    if (MakeContext->TempDirectoriesCreated == NULL) {
         return;
     }
 
-    for (Probe = 0; Probe < MakeContext->NumberProcesses; Probe++) {
-        TestMask = 1;
-        TestMask = TestMask << Probe;
-        if ((MakeContext->TempDirectoriesCreated & TestMask) != 0) {
-            TempPath.LengthInChars = YoriLibSPrintf(TempPath.StartOfString, _T("%y\\YMAKE%i"), &MakeContext->TempPath, Probe);
-            RemoveDirectory(TempPath.StartOfString);
+    if (YoriLibAllocateString(&TempPath, MakeContext->TempPath.LengthInChars + sizeof("\\YMAKE1234"))) {
+        for (Probe = 0; Probe < MakeContext->NumberProcesses; Probe++) {
+            if (MakeContext->TempDirectoriesCreated[Probe]) {
+                TempPath.LengthInChars = YoriLibSPrintf(TempPath.StartOfString, _T("%y\\YMAKE%i"), &MakeContext->TempPath, Probe);
+                RemoveDirectory(TempPath.StartOfString);
+            }
         }
+
+        YoriLibFreeStringContents(&TempPath);
     }
 
-    YoriLibFreeStringContents(&TempPath);
+    YoriLibFree(MakeContext->TempDirectoriesCreated);
+    MakeContext->TempDirectoriesCreated = NULL;
 }
 
 /**
@@ -183,13 +332,10 @@ MakeAllocateJobId(
     )
 {
     DWORD Probe;
-    DWORDLONG TestMask;
 
     for (Probe = 0; Probe < MakeContext->NumberProcesses; Probe++) {
-        TestMask = 1;
-        TestMask = TestMask << Probe;
-        if ((MakeContext->JobIdsAllocated & TestMask) == 0) {
-            MakeContext->JobIdsAllocated = MakeContext->JobIdsAllocated | TestMask;
+        if (!MakeContext->JobIdsAllocated[Probe]) {
+            MakeContext->JobIdsAllocated[Probe] = TRUE;
             MakeSetTemporaryDirectory(MakeContext, Probe);
             return Probe;
         }
@@ -212,14 +358,9 @@ MakeFreeJobId(
     __in DWORD JobId
     )
 {
-    DWORDLONG TestMask;
-
     ASSERT(JobId < MakeContext->NumberProcesses);
-
-    TestMask = 1;
-    TestMask = TestMask << JobId;
-    ASSERT(MakeContext->JobIdsAllocated & TestMask);
-    MakeContext->JobIdsAllocated = MakeContext->JobIdsAllocated & ~(TestMask);
+    ASSERT(MakeContext->JobIdsAllocated[JobId]);
+    MakeContext->JobIdsAllocated[JobId] = FALSE;
 }
 
 /**
@@ -229,6 +370,7 @@ MakeFreeJobId(
 CONST LPTSTR
 MakePuntToCmd[] = {
     _T("COPY"),
+    _T("DEL"),
     _T("ERASE"),
     _T("FOR"),
     _T("IF"),
@@ -237,6 +379,60 @@ MakePuntToCmd[] = {
     _T("TYPE")
 };
 
+/**
+ Return TRUE if a command which is also implemented by a builtin module needs
+ to be executed by cmd to preserve its behavior.  Builtin modules implement
+ the common forms of COPY, ERASE, MOVE and TYPE, but do not understand the
+ switches CMD accepts or concatenation via COPY a+b, and a builtin can only
+ be invoked in process if it is not part of a pipeline.
+
+ @param ExecPlan Pointer to the plan to execute.
+
+ @return TRUE if the command should not be executed by a builtin module in
+         process, FALSE if it can be.
+ */
+BOOLEAN
+MakeBuiltinRequiresCmd(
+    __in PYORI_LIBSH_EXEC_PLAN ExecPlan
+    )
+{
+    PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext;
+    DWORD Index;
+    YORI_ALLOC_SIZE_T ArgIndex;
+    BOOLEAN CmdCompatible;
+
+    if (ExecPlan->NumberCommands > 1) {
+        return TRUE;
+    }
+
+    ExecContext = ExecPlan->FirstCmd;
+    CmdCompatible = FALSE;
+    for (Index = 0; Index < sizeof(MakePuntToCmd)/sizeof(MakePuntToCmd[0]); Index++) {
+        if (YoriLibCompareStringLitIns(&ExecContext->CmdToExec.ArgV[0], MakePuntToCmd[Index]) == 0) {
+            CmdCompatible = TRUE;
+            break;
+        }
+    }
+
+    if (!CmdCompatible) {
+        return FALSE;
+    }
+
+    for (ArgIndex = 1; ArgIndex < ExecContext->CmdToExec.ArgC; ArgIndex++) {
+        if (ExecContext->CmdToExec.ArgV[ArgIndex].LengthInChars > 0 &&
+            ExecContext->CmdToExec.ArgV[ArgIndex].StartOfString[0] == '/') {
+
+            return TRUE;
+        }
+
+        if (YoriLibFindLeftMostCharacter(&ExecContext->CmdToExec.ArgV[ArgIndex], '+') != NULL) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
 /**
  Return TRUE if there are more commands to execute as part of constructing
  this target, or FALSE if this target is complete.
@@ -468,6 +664,103 @@ MakeFreeCmdContextIfNecessary(
     }
 }
 
+/**
+ Append text to the output collected for a target.  If memory cannot be
+ allocated to hold the text, it is displayed immediately instead.
+
+ @param ChildRecipe Pointer to the recipe executing the target.
+
+ @param Attribute If nonzero, specifies the color that the text should be
+        displayed in.
+
+ @param Text Pointer to the text to append.
+ */
+VOID
+MakeRecipeAppendOutput(
+    __inout PMAKE_CHILD_RECIPE ChildRecipe,
+    __in WORD Attribute,
+    __in PYORI_STRING Text
+    )
+{
+    YORI_STRING VtAttribute;
+    TCHAR VtAttributeBuffer[YORI_MAX_VT_ESCAPE_CHARS];
+    YORI_STRING VtReset;
+    YORI_ALLOC_SIZE_T LengthNeeded;
+    YORI_ALLOC_SIZE_T NewLength;
+    PYORI_STRING Output;
+
+    if (Text->LengthInChars == 0) {
+        return;
+    }
+
+    YoriLibInitEmptyString(&VtAttribute);
+    YoriLibInitEmptyString(&VtReset);
+    if (Attribute != 0) {
+        VtAttribute.StartOfString = VtAttributeBuffer;
+        VtAttribute.LengthAllocated = sizeof(VtAttributeBuffer)/sizeof(VtAttributeBuffer[0]);
+        YoriLibVtStringForTextAttribute(&VtAttribute, 0, Attribute);
+        YoriLibConstantString(&VtReset, _T("\x1b[0m"));
+    }
+
+    Output = &ChildRecipe->Output;
+    LengthNeeded = VtAttribute.LengthInChars + Text->LengthInChars + VtReset.LengthInChars;
+    if (Output->LengthInChars + LengthNeeded > Output->LengthAllocated) {
+        NewLength = YoriLibIsAllocationExtendable(Output->LengthInChars, LengthNeeded, Output->LengthInChars + LengthNeeded + 4096);
+        if (NewLength == 0 || !YoriLibReallocString(Output, NewLength)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y%y%y"), &VtAttribute, Text, &VtReset);
+            return;
+        }
+    }
+
+    if (VtAttribute.LengthInChars > 0) {
+        memcpy(&Output->StartOfString[Output->LengthInChars], VtAttribute.StartOfString, VtAttribute.LengthInChars * sizeof(TCHAR));
+        Output->LengthInChars = Output->LengthInChars + VtAttribute.LengthInChars;
+    }
+
+    memcpy(&Output->StartOfString[Output->LengthInChars], Text->StartOfString, Text->LengthInChars * sizeof(TCHAR));
+    Output->LengthInChars = Output->LengthInChars + Text->LengthInChars;
+
+    if (VtReset.LengthInChars > 0) {
+        memcpy(&Output->StartOfString[Output->LengthInChars], VtReset.StartOfString, VtReset.LengthInChars * sizeof(TCHAR));
+        Output->LengthInChars = Output->LengthInChars + VtReset.LengthInChars;
+    }
+}
+
+/**
+ Collect the output of a command that was sent to a buffer owned by make
+ into the output for the target.
+
+ @param ChildRecipe Pointer to the recipe executing the target.
+
+ @param ExecContext Pointer to the command whose output should be collected.
+
+ @param Attribute If nonzero, specifies the color that the output should be
+        displayed in.
+ */
+VOID
+MakeRecipeCollectOutput(
+    __inout PMAKE_CHILD_RECIPE ChildRecipe,
+    __in PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext,
+    __in WORD Attribute
+    )
+{
+    YORI_STRING ProcessOutput;
+
+    if (ExecContext->StdOutType != StdOutTypeBuffer ||
+        ExecContext->StdOut.Buffer.ProcessBuffers == NULL) {
+
+        return;
+    }
+
+    YoriLibShWaitForProcessBufferToFinalize(ExecContext->StdOut.Buffer.ProcessBuffers);
+    if (YoriLibShGetProcessOutputBuffer(ExecContext->StdOut.Buffer.ProcessBuffers, &ProcessOutput)) {
+        MakeRecipeAppendOutput(ChildRecipe, Attribute, &ProcessOutput);
+        YoriLibFreeStringContents(&ProcessOutput);
+    }
+
+    YoriLibShTeardownProcessBuffersIfCompleted(ExecContext->StdOut.Buffer.ProcessBuffers);
+}
+
 /**
  Start executing the next command within a target.
 
@@ -529,7 +822,11 @@ MakeLaunchNextCmd(
 
     CmdToExec = CONTAINING_RECORD(ListEntry, MAKE_CMD_TO_EXEC, ListEntry);
     if (CmdToExec->DisplayCmd && !MakeContext->SilentCommandLaunching) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &CmdToExec->Cmd);
+        YORI_STRING NewLine;
+
+        YoriLibConstantString(&NewLine, _T("\n"));
+        MakeRecipeAppendOutput(ChildRecipe, 0, &CmdToExec->Cmd);
+        MakeRecipeAppendOutput(ChildRecipe, 0, &NewLine);
     }
 
 
@@ -584,11 +881,19 @@ MakeLaunchNextCmd(
                 PYORI_LIBSH_BUILTIN_CALLBACK Callback;
 
                 Callback = YoriLibShLookupBuiltinByName(&ExecContext->CmdToExec.ArgV[0]);
-                if (Callback) {
+                if (Callback && !MakeBuiltinRequiresCmd(&ChildRecipe->ExecPlan)) {
+
+                    if (ExecContext->StdOutType == StdOutTypeDefault) {
+                        ExecContext->StdOutType = StdOutTypeBuffer;
+                        if (ExecContext->StdErrType == StdErrTypeDefault) {
+                            ExecContext->StdErrType = StdErrTypeStdOut;
+                        }
+                    }
 
                     SetCurrentDirectory(ChildRecipe->CurrentDirectory.StartOfString);
                     Result = MakeShExecuteInProc(Callback->BuiltInFn, ExecContext);
                     SetCurrentDirectory(MakeContext->ProcessCurrentDirectory.StartOfString);
+                    MakeRecipeCollectOutput(ChildRecipe, ExecContext, 0);
 
                     ExecutedBuiltin = TRUE;
                     ChildRecipe->ProcessHandle = NULL;
@@ -709,6 +1014,10 @@ MakeLaunchNextCmd(
         ExecContext->hPrimaryThread = NULL;
         ChildRecipe->ProcessHandle = ExecContext->hProcess;
         YoriLibShCommenceProcessBuffersIfNeeded(ExecContext);
+        if (MakeContext->TraceHandle != NULL) {
+            QueryPerformanceCounter(&ChildRecipe->CmdStartTime);
+            MakeTraceJobStarted(MakeContext, ChildRecipe->JobId, ChildRecipe->CmdStartTime.QuadPart);
+        }
     }
     YoriLibFreeStringContents(&CmdToParse);
 
@@ -718,24 +1027,47 @@ MakeLaunchNextCmd(
 /**
  Indicate that an entire recipe has completed.  This may have succeeded, or
  may have failed partway.  This function needs to clean up regardless.
+ Output collected from the recipe is displayed at this point, as a single
+ unit, unless the user requested that only output from failing targets be
+ displayed.
 
  @param MakeContext Pointer to the make context.
 
  @param ChildRecipe Pointer to the recipe to clean up for reuse.
+
+ @param Succeeded TRUE if all commands in the recipe succeeded, FALSE if
+        the recipe failed.
  */
 VOID
 MakeRecipeCompletion(
     __in PMAKE_CONTEXT MakeContext,
-    __inout PMAKE_CHILD_RECIPE ChildRecipe
+    __inout PMAKE_CHILD_RECIPE ChildRecipe,
+    __in BOOLEAN Succeeded
     )
 {
-    UNREFERENCED_PARAMETER(MakeContext);
+    WORD DefaultColor;
 
     //
     //  This recipe structure should not have child processes executing.
     //
 
     ASSERT(!ChildRecipe->CmdContextPresent);
+
+    if (ChildRecipe->Output.LengthInChars > 0 &&
+        (!Succeeded || !MakeContext->FailedTargetOutputOnly)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &ChildRecipe->Output);
+    }
+
+    if (ChildRecipe->FailedCmd != NULL) {
+        DefaultColor = YoriLibVtGetDefaultColor();
+        YoriLibVtSetConsoleTextAttr(YORI_LIB_OUTPUT_STDOUT, (WORD)((DefaultColor & 0xF0) | FOREGROUND_RED | FOREGROUND_INTENSITY));
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Error in target: %y\nCommand:\n%y\n"), &ChildRecipe->Target->HashEntry.Key, &ChildRecipe->FailedCmd->Cmd);
+        YoriLibVtSetConsoleTextAttr(YORI_LIB_OUTPUT_STDOUT, DefaultColor);
+        ChildRecipe->FailedCmd = NULL;
+    }
+
+    YoriLibFreeStringContents(&ChildRecipe->Output);
     YoriLibFreeStringContents(&ChildRecipe->CurrentDirectory);
 }
 
@@ -787,6 +1119,8 @@ MakeLaunchNextTarget(
 
     ChildRecipe->Target = Target;
     ChildRecipe->Cmd = NULL;
+    ChildRecipe->StartTime = YoriLibGetSystemTimeAsInteger();
+    ChildRecipe->ExpectedCommit = MakeBuildDbGetTargetPeakCommit(MakeContext, Target);
 
     //
     //  The previous recipe should have been cleaned up.
@@ -811,7 +1145,7 @@ MakeLaunchNextTarget(
 
     Result = MakeLaunchNextCmd(MakeContext, ChildRecipe);
     if (!Result) {
-        MakeRecipeCompletion(MakeContext, ChildRecipe);
+        MakeRecipeCompletion(MakeContext, ChildRecipe, FALSE);
     }
     return Result;
 }
@@ -844,7 +1178,7 @@ MakeUpdateDependenciesForTarget(
             Dependency->Child->NumberParentsToBuild--;
             if (Dependency->Child->NumberParentsToBuild == 0) {
                 YoriLibRemoveListItem(&Dependency->Child->RebuildList);
-                YoriLibAppendList(&MakeContext->TargetsReady, &Dependency->Child->RebuildList);
+                MakeInsertReadyTarget(MakeContext, Dependency->Child);
             }
         }
         ListEntry = YoriLibGetNextListEntry(&Target->ChildDependents, ListEntry);
@@ -871,10 +1205,9 @@ MakeProcessCompletion(
 {
     DWORD ExitCode;
     PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext;
-    YORI_STRING ProcessOutput;
     BOOLEAN Result;
-    BOOLEAN RestoreColor;
     WORD DefaultColor;
+    WORD Attribute;
 
     ExitCode = EXIT_SUCCESS;
 
@@ -883,8 +1216,9 @@ MakeProcessCompletion(
     //
     //  Ideally this would wait for the process buffer threads rather than
     //  wait for process termination, then get here and wait for the process
-    //  buffer threads.  Unfortunately since there are two threads and we're
-    //  hitting the 64 object wait limit, it seems like the lesser evil.
+    //  buffer threads.  Unfortunately that would need three wait objects per
+    //  child in the wait threads rather than one, so it seems like the
+    //  lesser evil.
     //
 
     if (ChildRecipe->ProcessHandle != NULL) {
@@ -893,53 +1227,60 @@ MakeProcessCompletion(
         GetExitCodeProcess(ChildRecipe->ProcessHandle, &ExitCode);
         ASSERT(ChildRecipe->CmdContextPresent);
 
+        if (DllNtDll.pNtQueryInformationProcess != NULL) {
+            PROCESS_VM_COUNTERS VmInfo;
+            DWORD BytesReturned;
+
+            if (DllNtDll.pNtQueryInformationProcess(ChildRecipe->ProcessHandle, ProcessVmCounters, &VmInfo, sizeof(VmInfo), &BytesReturned) == 0 &&
+                VmInfo.PeakCommitUsage > ChildRecipe->PeakCommit) {
+
+                ChildRecipe->PeakCommit = VmInfo.PeakCommitUsage;
+            }
+        }
+
+        if (MakeContext->TraceHandle != NULL) {
+            LARGE_INTEGER EndTime;
+            QueryPerformanceCounter(&EndTime);
+            MakeTraceCompleteEvent(MakeContext,
+                                   _T("recipe"),
+                                   &ChildRecipe->Target->HashEntry.Key,
+                                   ChildRecipe->JobId + 1,
+                                   ChildRecipe->CmdStartTime.QuadPart,
+                                   EndTime.QuadPart,
+                                   &ChildRecipe->Cmd->Cmd,
+                                   &ExitCode);
+            MakeTraceJobFinished(MakeContext, ChildRecipe->JobId, EndTime.QuadPart);
+        }
+
         DefaultColor = YoriLibVtGetDefaultColor();
-        RestoreColor = FALSE;
+        Attribute = 0;
 
         if (ExitCode != 0) {
 
             if (!ChildRecipe->Cmd->IgnoreErrors) {
-                YoriLibVtSetConsoleTextAttr(YORI_LIB_OUTPUT_STDOUT, (WORD)((DefaultColor & 0xF0) | FOREGROUND_RED | FOREGROUND_INTENSITY));
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Error in target: %y\n"), &ChildRecipe->Target->HashEntry.Key);
+                Attribute = (WORD)((DefaultColor & 0xF0) | FOREGROUND_RED | FOREGROUND_INTENSITY);
+                ChildRecipe->FailedCmd = ChildRecipe->Cmd;
                 Result = FALSE;
             } else {
-                YoriLibVtSetConsoleTextAttr(YORI_LIB_OUTPUT_STDOUT, (WORD)((DefaultColor & 0xF0) | FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_INTENSITY));
+                Attribute = (WORD)((DefaultColor & 0xF0) | FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_INTENSITY);
             }
-
-            RestoreColor = TRUE;
         }
 
         //
-        //  If the output was being sent to a buffer owned by make, display
-        //  the result now, in a different color if the process failed.
-        //  Note at this point execution is serialized - this might prevent
-        //  child processes from being launched, but output will be ordered.
+        //  If the output was being sent to a buffer owned by make, add it
+        //  to the output of the target, in a different color if the process
+        //  failed.  The target's output is displayed when the target
+        //  completes.
         //
 
         ExecContext = ChildRecipe->ExecPlan.FirstCmd;
 
         if (ExecContext->StdOutType == StdOutTypeBuffer) {
-            YoriLibShWaitForProcessBufferToFinalize(ExecContext->StdOut.Buffer.ProcessBuffers);
-            if (YoriLibShGetProcessOutputBuffer(ExecContext->StdOut.Buffer.ProcessBuffers, &ProcessOutput)) {
-                if (ProcessOutput.LengthInChars > 0) {
-                    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &ProcessOutput);
-                }
-                YoriLibFreeStringContents(&ProcessOutput);
-            }
-
-            YoriLibShTeardownProcessBuffersIfCompleted(ExecContext->StdOut.Buffer.ProcessBuffers);
+            MakeRecipeCollectOutput(ChildRecipe, ExecContext, Attribute);
         } else {
             ASSERT(ExecContext->StdErrType != StdErrTypeBuffer);
         }
 
-        if (!ChildRecipe->Cmd->IgnoreErrors && ExitCode != 0) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Command:\n%y\n"), &ChildRecipe->Cmd->Cmd);
-        }
-
-        if (RestoreColor) {
-            YoriLibVtSetConsoleTextAttr(YORI_LIB_OUTPUT_STDOUT, YoriLibVtGetDefaultColor());
-        }
-
         //
         //  This is closed implicitly as part of FreeExecPlan below
         //
@@ -955,9 +1296,89 @@ MakeProcessCompletion(
 }
 
 
+/**
+ Determine whether the next ready target can be launched without exceeding
+ available physical memory.  The target is expected to need as much memory
+ as it did when it was last built.  Each executing recipe is also expected
+ to grow to its recorded peak, so memory it has not yet committed is treated
+ as unavailable.  Targets with no recorded peak are always launched.
+
+ @param MakeContext Pointer to the context.
+
+ @param ChildRecipeArray Pointer to the array of recipe slots.
+
+ @return TRUE if the next ready target should be launched, FALSE if it
+         should wait for an executing recipe to complete.
+ */
+BOOLEAN
+MakeIsMemoryAvailableForNextTarget(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_CHILD_RECIPE ChildRecipeArray
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET Target;
+    PMAKE_CHILD_RECIPE ChildRecipe;
+    YORI_MEMORYSTATUSEX MemStatus;
+    DWORDLONG RequiredCommit;
+    DWORDLONG CurrentCommit;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (DllKernel32.pGlobalMemoryStatusEx == NULL) {
+        return TRUE;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, NULL);
+    ASSERT(ListEntry != NULL);
+    if (ListEntry == NULL) {
+        return TRUE;
+    }
+
+    Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
+    RequiredCommit = MakeBuildDbGetTargetPeakCommit(MakeContext, Target);
+    if (RequiredCommit == 0) {
+        return TRUE;
+    }
+
+    for (Index = 0; Index < MakeContext->NumberProcesses; Index++) {
+        ChildRecipe = &ChildRecipeArray[Index];
+        if (ChildRecipe->Target == NULL || ChildRecipe->ExpectedCommit == 0) {
+            continue;
+        }
+
+        CurrentCommit = 0;
+        if (ChildRecipe->ProcessHandle != NULL &&
+            DllNtDll.pNtQueryInformationProcess != NULL) {
+
+            PROCESS_VM_COUNTERS VmInfo;
+            DWORD BytesReturned;
+
+            if (DllNtDll.pNtQueryInformationProcess(ChildRecipe->ProcessHandle, ProcessVmCounters, &VmInfo, sizeof(VmInfo), &BytesReturned) == 0) {
+                CurrentCommit = VmInfo.CommitUsage;
+            }
+        }
+
+        if (ChildRecipe->ExpectedCommit > CurrentCommit) {
+            RequiredCommit = RequiredCommit + ChildRecipe->ExpectedCommit - CurrentCommit;
+        }
+    }
+
+    MemStatus.dwLength = sizeof(MemStatus);
+    if (!DllKernel32.pGlobalMemoryStatusEx(&MemStatus)) {
+        return TRUE;
+    }
+
+    if (RequiredCommit > MemStatus.ullAvailPhys) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  Remove all targets that are in the front of the ready queue but really have
- no actions to perform.
+ no actions to perform, including targets that the build database indicates
+ are already current and targets whose output is in the artifact cache.
 
  MSFIX This process should probably occur earlier, when a target moves from
  waiting it can move directly to completed if there is nothing to do.  This
@@ -983,7 +1404,10 @@ MakeCompleteReadyWithNoRecipe(
     ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, NULL);
     while (ListEntry != NULL) {
         Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
-        if (YoriLibIsListEmpty(&Target->ExecCmds)) {
+        if (YoriLibIsListEmpty(&Target->ExecCmds) ||
+            MakeBuildDbIsTargetCurrent(MakeContext, Target) ||
+            MakeArtifactCacheFetch(MakeContext, Target)) {
+
             RemovedItem = TRUE;
             MakeUpdateDependenciesForTarget(MakeContext, Target);
         } else {
@@ -995,6 +1419,259 @@ MakeCompleteReadyWithNoRecipe(
     return RemovedItem;
 }
 
+/**
+ Add a slot to the queue of completed slots and wake the main thread.
+
+ @param Pool Pointer to the set of wait threads.
+
+ @param Slot The index of the child recipe that has completed.
+ */
+VOID
+MakeWaitPoolComplete(
+    __in PMAKE_WAIT_POOL Pool,
+    __in DWORD Slot
+    )
+{
+    WaitForSingleObject(Pool->Mutex, INFINITE);
+    ASSERT(Pool->CompletedCount < Pool->SlotCount);
+    Pool->CompletedSlots[(Pool->CompletedHead + Pool->CompletedCount) % Pool->SlotCount] = Slot;
+    Pool->CompletedCount++;
+    ReleaseMutex(Pool->Mutex);
+    ReleaseSemaphore(Pool->CompletionSemaphore, 1, NULL);
+}
+
+/**
+ A thread which waits for child processes within a range of slots to
+ complete, and reports each completion to the main thread.
+
+ @param Context Pointer to the wait thread structure.
+
+ @return Thread exit code, which is always zero.
+ */
+DWORD WINAPI
+MakeWaitThread(
+    __in LPVOID Context
+    )
+{
+    PMAKE_WAIT_THREAD WaitThread;
+    PMAKE_WAIT_POOL Pool;
+    PMAKE_CHILD_RECIPE ChildRecipe;
+    HANDLE Handles[MAXIMUM_WAIT_OBJECTS];
+    DWORD Slots[MAXIMUM_WAIT_OBJECTS];
+    DWORD Count;
+    DWORD Slot;
+    DWORD Index;
+
+    WaitThread = (PMAKE_WAIT_THREAD)Context;
+    Pool = WaitThread->Pool;
+
+    while (!Pool->Shutdown) {
+
+        //
+        //  Rebuild the set of processes to wait for each time, since the
+        //  main thread arms slots as it launches processes.
+        //
+
+        Handles[0] = WaitThread->WakeEvent;
+        Count = 1;
+        for (Slot = WaitThread->FirstSlot; Slot < WaitThread->FirstSlot + WaitThread->SlotCount; Slot++) {
+            ChildRecipe = &Pool->ChildRecipeArray[Slot];
+            if (InterlockedCompareExchange(&ChildRecipe->WaitArmed, TRUE, TRUE)) {
+                Handles[Count] = ChildRecipe->ProcessHandle;
+                Slots[Count] = Slot;
+                Count++;
+            }
+        }
+
+        Index = WaitForMultipleObjectsEx(Count, Handles, FALSE, INFINITE, FALSE);
+        if (Index == WAIT_FAILED) {
+
+            //
+            //  Rather than leave the main thread waiting forever, report
+            //  every process as complete so errors are reported against
+            //  them.
+            //
+
+            for (Index = 1; Index < Count; Index++) {
+                InterlockedExchange(&Pool->ChildRecipeArray[Slots[Index]].WaitArmed, FALSE);
+                MakeWaitPoolComplete(Pool, Slots[Index]);
+            }
+            WaitForSingleObject(WaitThread->WakeEvent, INFINITE);
+            continue;
+        }
+
+        Index = Index - WAIT_OBJECT_0;
+        if (Index > 0 && Index < Count) {
+            InterlockedExchange(&Pool->ChildRecipeArray[Slots[Index]].WaitArmed, FALSE);
+            MakeWaitPoolComplete(Pool, Slots[Index]);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ Stop all wait threads and free the set of wait threads.  No slots should
+ be armed when this is called.
+
+ @param Pool Pointer to the set of wait threads.
+ */
+VOID
+MakeWaitPoolCleanup(
+    __in PMAKE_WAIT_POOL Pool
+    )
+{
+    DWORD Index;
+
+    Pool->Shutdown = TRUE;
+    if (Pool->Threads != NULL) {
+        for (Index = 0; Index < Pool->ThreadCount; Index++) {
+            if (Pool->Threads[Index].Thread != NULL) {
+                SetEvent(Pool->Threads[Index].WakeEvent);
+                WaitForSingleObject(Pool->Threads[Index].Thread, INFINITE);
+                CloseHandle(Pool->Threads[Index].Thread);
+            }
+            if (Pool->Threads[Index].WakeEvent != NULL) {
+                CloseHandle(Pool->Threads[Index].WakeEvent);
+            }
+        }
+        YoriLibFree(Pool->Threads);
+        Pool->Threads = NULL;
+    }
+
+    if (Pool->CompletedSlots != NULL) {
+        YoriLibFree(Pool->CompletedSlots);
+        Pool->CompletedSlots = NULL;
+    }
+
+    if (Pool->Mutex != NULL) {
+        CloseHandle(Pool->Mutex);
+        Pool->Mutex = NULL;
+    }
+
+    if (Pool->CompletionSemaphore != NULL) {
+        CloseHandle(Pool->CompletionSemaphore);
+        Pool->CompletionSemaphore = NULL;
+    }
+}
+
+/**
+ Start the threads which wait for child processes to complete.
+
+ @param Pool Pointer to the set of wait threads to initialize.
+
+ @param ChildRecipeArray Pointer to the array of child recipes to wait for.
+
+ @param SlotCount The number of elements in ChildRecipeArray.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeWaitPoolInitialize(
+    __out PMAKE_WAIT_POOL Pool,
+    __in PMAKE_CHILD_RECIPE ChildRecipeArray,
+    __in DWORD SlotCount
+    )
+{
+    DWORD Index;
+    DWORD ThreadId;
+    PMAKE_WAIT_THREAD WaitThread;
+
+    ZeroMemory(Pool, sizeof(MAKE_WAIT_POOL));
+    Pool->ChildRecipeArray = ChildRecipeArray;
+    Pool->SlotCount = SlotCount;
+    Pool->ThreadCount = (SlotCount + MAKE_PROCESSES_PER_WAIT_THREAD - 1) / MAKE_PROCESSES_PER_WAIT_THREAD;
+
+    Pool->Mutex = CreateMutex(NULL, FALSE, NULL);
+    Pool->CompletionSemaphore = CreateSemaphore(NULL, 0, SlotCount, NULL);
+    Pool->CompletedSlots = YoriLibMalloc(SlotCount * sizeof(DWORD));
+    Pool->Threads = YoriLibMalloc(Pool->ThreadCount * sizeof(MAKE_WAIT_THREAD));
+    if (Pool->Mutex == NULL ||
+        Pool->CompletionSemaphore == NULL ||
+        Pool->CompletedSlots == NULL ||
+        Pool->Threads == NULL) {
+
+        MakeWaitPoolCleanup(Pool);
+        return FALSE;
+    }
+
+    ZeroMemory(Pool->Threads, Pool->ThreadCount * sizeof(MAKE_WAIT_THREAD));
+    for (Index = 0; Index < Pool->ThreadCount; Index++) {
+        WaitThread = &Pool->Threads[Index];
+        WaitThread->Pool = Pool;
+        WaitThread->FirstSlot = Index * MAKE_PROCESSES_PER_WAIT_THREAD;
+        WaitThread->SlotCount = MAKE_PROCESSES_PER_WAIT_THREAD;
+        if (WaitThread->FirstSlot + WaitThread->SlotCount > SlotCount) {
+            WaitThread->SlotCount = SlotCount - WaitThread->FirstSlot;
+        }
+
+        WaitThread->WakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (WaitThread->WakeEvent == NULL) {
+            MakeWaitPoolCleanup(Pool);
+            return FALSE;
+        }
+
+        WaitThread->Thread = CreateThread(NULL, 0, MakeWaitThread, WaitThread, 0, &ThreadId);
+        if (WaitThread->Thread == NULL) {
+            MakeWaitPoolCleanup(Pool);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Indicate that a child recipe has launched a command and should be waited
+ for.  If the command did not launch a process, because it was a builtin or
+ a launch failure was ignored, the slot is reported as complete
+ immediately.
+
+ @param Pool Pointer to the set of wait threads.
+
+ @param Slot The index of the child recipe.
+ */
+VOID
+MakeWaitPoolArm(
+    __in PMAKE_WAIT_POOL Pool,
+    __in DWORD Slot
+    )
+{
+    if (Pool->ChildRecipeArray[Slot].ProcessHandle == NULL) {
+        MakeWaitPoolComplete(Pool, Slot);
+        return;
+    }
+
+    InterlockedExchange(&Pool->ChildRecipeArray[Slot].WaitArmed, TRUE);
+    SetEvent(Pool->Threads[Slot / MAKE_PROCESSES_PER_WAIT_THREAD].WakeEvent);
+}
+
+/**
+ Wait for any armed child recipe to complete.
+
+ @param Pool Pointer to the set of wait threads.
+
+ @return The index of the child recipe that completed.
+ */
+DWORD
+MakeWaitPoolWait(
+    __in PMAKE_WAIT_POOL Pool
+    )
+{
+    DWORD Slot;
+
+    WaitForSingleObject(Pool->CompletionSemaphore, INFINITE);
+    WaitForSingleObject(Pool->Mutex, INFINITE);
+    ASSERT(Pool->CompletedCount > 0);
+    Slot = Pool->CompletedSlots[Pool->CompletedHead];
+    Pool->CompletedHead = (Pool->CompletedHead + 1) % Pool->SlotCount;
+    Pool->CompletedCount--;
+    ReleaseMutex(Pool->Mutex);
+
+    return Slot;
+}
+
 /**
  Execute commands required to build the requested target.
 
@@ -1010,44 +1687,117 @@ MakeExecuteRequiredTargets(
 
     YORI_ALLOC_SIZE_T NumberActiveProcesses;
     DWORD Index;
-    HANDLE *ProcessHandleArray;
+    PDWORD FreeSlotArray;
+    DWORD FreeSlotCount;
     PMAKE_CHILD_RECIPE ChildRecipeArray;
+    MAKE_WAIT_POOL WaitPool;
     BOOLEAN Result;
     BOOLEAN MoveToNextTarget;
     BOOLEAN TargetFailureObserved;
+    BOOLEAN MemoryConstrained;
 
     NumberActiveProcesses = 0;
     TargetFailureObserved = FALSE;
+    MemoryConstrained = FALSE;
+
+    YoriLibLoadNtDllFunctions();
+    YoriLibLoadKernel32Functions();
 
-    ProcessHandleArray = YoriLibMalloc(MakeContext->NumberProcesses * sizeof(HANDLE));
-    if (ProcessHandleArray == NULL) {
+    ASSERT(MakeContext->JobIdsAllocated == NULL);
+    ASSERT(MakeContext->TempDirectoriesCreated == NULL);
+
+    MakeContext->JobIdsAllocated = YoriLibMalloc(MakeContext->NumberProcesses * sizeof(BOOLEAN));
+    if (MakeContext->JobIdsAllocated == NULL) {
         return FALSE;
     }
 
-    ZeroMemory(ProcessHandleArray, MakeContext->NumberProcesses * sizeof(HANDLE));
+    ZeroMemory(MakeContext->JobIdsAllocated, MakeContext->NumberProcesses * sizeof(BOOLEAN));
+
+    //
+    //  This is freed when temporary directories are cleaned up.
+    //
+
+    MakeContext->TempDirectoriesCreated = YoriLibMalloc(MakeContext->NumberProcesses * sizeof(BOOLEAN));
+    if (MakeContext->TempDirectoriesCreated == NULL) {
+        YoriLibFree(MakeContext->JobIdsAllocated);
+        MakeContext->JobIdsAllocated = NULL;
+        return FALSE;
+    }
+
+    ZeroMemory(MakeContext->TempDirectoriesCreated, MakeContext->NumberProcesses * sizeof(BOOLEAN));
+
+    FreeSlotArray = YoriLibMalloc(MakeContext->NumberProcesses * sizeof(DWORD));
+    if (FreeSlotArray == NULL) {
+        YoriLibFree(MakeContext->JobIdsAllocated);
+        MakeContext->JobIdsAllocated = NULL;
+        return FALSE;
+    }
+
+    //
+    //  Slots are handed out from the end of the array so the first slot is
+    //  used first.
+    //
+
+    for (Index = 0; Index < MakeContext->NumberProcesses; Index++) {
+        FreeSlotArray[Index] = MakeContext->NumberProcesses - Index - 1;
+    }
+    FreeSlotCount = MakeContext->NumberProcesses;
 
     ChildRecipeArray = YoriLibMalloc(MakeContext->NumberProcesses * sizeof(MAKE_CHILD_RECIPE));
     if (ChildRecipeArray == NULL) {
-        YoriLibFree(ProcessHandleArray);
+        YoriLibFree(FreeSlotArray);
+        YoriLibFree(MakeContext->JobIdsAllocated);
+        MakeContext->JobIdsAllocated = NULL;
         return FALSE;
     }
 
     ZeroMemory(ChildRecipeArray, MakeContext->NumberProcesses * sizeof(MAKE_CHILD_RECIPE));
+
+    if (!MakeWaitPoolInitialize(&WaitPool, ChildRecipeArray, MakeContext->NumberProcesses)) {
+        YoriLibFree(ChildRecipeArray);
+        YoriLibFree(FreeSlotArray);
+        YoriLibFree(MakeContext->JobIdsAllocated);
+        MakeContext->JobIdsAllocated = NULL;
+        return FALSE;
+    }
+
+    MakeTraceBeginExecute(MakeContext);
+
     Result = TRUE;
 
     while (TRUE) {
 
         while (NumberActiveProcesses < MakeContext->NumberProcesses && !YoriLibIsListEmpty(&MakeContext->TargetsReady)) {
             if (!MakeCompleteReadyWithNoRecipe(MakeContext)) {
-                if (!MakeLaunchNextTarget(MakeContext, &ChildRecipeArray[NumberActiveProcesses])) {
+
+                //
+                //  If launching the next target would exhaust memory, wait
+                //  for something to finish first.  If nothing is running,
+                //  launch it anyway, since waiting won't help.
+                //
+
+                if (NumberActiveProcesses > 0 &&
+                    !MakeIsMemoryAvailableForNextTarget(MakeContext, ChildRecipeArray)) {
+
+                    MemoryConstrained = TRUE;
+                    break;
+                }
+
+                ASSERT(FreeSlotCount > 0);
+                Index = FreeSlotArray[FreeSlotCount - 1];
+                if (!MakeLaunchNextTarget(MakeContext, &ChildRecipeArray[Index])) {
                     Result = FALSE;
                     goto Drain;
                 }
+                FreeSlotCount--;
                 NumberActiveProcesses++;
+                MakeWaitPoolArm(&WaitPool, Index);
             }
         }
 
-        while (NumberActiveProcesses == MakeContext->NumberProcesses || YoriLibIsListEmpty(&MakeContext->TargetsReady)) {
+        while (NumberActiveProcesses == MakeContext->NumberProcesses ||
+               YoriLibIsListEmpty(&MakeContext->TargetsReady) ||
+               MemoryConstrained) {
 
             if (NumberActiveProcesses == 0) {
                 break;
@@ -1057,22 +1807,13 @@ MakeExecuteRequiredTargets(
             //  A process handle can be NULL if either a command failed to
             //  launch but was prefixed with - indicating failures should be
             //  ignored; or if it's a builtin command that completed
-            //  synchronously.  In either case rather than wait, just process
-            //  as if this command completed and move to the next command or
-            //  target.
+            //  synchronously.  In either case the slot is reported as
+            //  complete without waiting, so just process as if this command
+            //  completed and move to the next command or target.
             //
 
-            for (Index = 0; Index < NumberActiveProcesses; Index++) {
-                ProcessHandleArray[Index] = ChildRecipeArray[Index].ProcessHandle;
-                if (ProcessHandleArray[Index] == NULL) {
-                    break;
-                }
-            }
-
-            if (Index == NumberActiveProcesses) {
-                Index = WaitForMultipleObjectsEx(NumberActiveProcesses, ProcessHandleArray, FALSE, INFINITE, FALSE);
-                Index = Index - WAIT_OBJECT_0;
-            }
+            Index = MakeWaitPoolWait(&WaitPool);
+            MemoryConstrained = FALSE;
 
             //
             //  Check if the process succeeded.  If so, and there are more
@@ -1085,42 +1826,37 @@ MakeExecuteRequiredTargets(
                 if (MakeDoesTargetHaveMoreCommands(&ChildRecipeArray[Index])) {
                     if (MakeLaunchNextCmd(MakeContext, &ChildRecipeArray[Index])) {
                         MoveToNextTarget = FALSE;
+                        MakeWaitPoolArm(&WaitPool, Index);
                     } else {
                         Result = FALSE;
                     }
                 } else {
-                    MakeRecipeCompletion(MakeContext, &ChildRecipeArray[Index]);
+                    MakeRecipeCompletion(MakeContext, &ChildRecipeArray[Index], TRUE);
                 }
             }
 
             //
-            //  If we are moving to the next target, overwrite this child
-            //  process with the executing ones, and launch a new target.
-            //  If we failed, we still need to move up all of the executing
-            //  ones to facilitate drain.
+            //  If we are moving to the next target, return this slot so a
+            //  new target can be launched in it.
             //
 
             if (MoveToNextTarget) {
+                MakeBuildDbUpdateTarget(MakeContext,
+                                        ChildRecipeArray[Index].Target,
+                                        Result,
+                                        (DWORD)((YoriLibGetSystemTimeAsInteger() - ChildRecipeArray[Index].StartTime) / (10 * 1000)),
+                                        ChildRecipeArray[Index].PeakCommit);
                 if (Result) {
+                    MakeArtifactCachePublish(MakeContext, ChildRecipeArray[Index].Target);
                     MakeUpdateDependenciesForTarget(MakeContext, ChildRecipeArray[Index].Target);
                 } else {
-                    MakeRecipeCompletion(MakeContext, &ChildRecipeArray[Index]);
-                }
-
-                if (NumberActiveProcesses > (YORI_ALLOC_SIZE_T)(Index + 1)) {
-                    memmove(&ChildRecipeArray[Index],
-                            &ChildRecipeArray[Index + 1],
-                            (NumberActiveProcesses - Index - 1) * sizeof(MAKE_CHILD_RECIPE));
+                    MakeRecipeCompletion(MakeContext, &ChildRecipeArray[Index], FALSE);
                 }
 
+                ZeroMemory(&ChildRecipeArray[Index], sizeof(MAKE_CHILD_RECIPE));
+                FreeSlotArray[FreeSlotCount] = Index;
+                FreeSlotCount++;
                 NumberActiveProcesses--;
-
-                //
-                //  Everything in the final entry has been moved to earlier
-                //  entries, so the final entry is uninitialized.
-                //
-
-                ZeroMemory(&ChildRecipeArray[NumberActiveProcesses], sizeof(MAKE_CHILD_RECIPE));
             }
 
             if (Result == FALSE) {
@@ -1150,40 +1886,29 @@ MakeExecuteRequiredTargets(
 
 Drain:
 
-    while (NumberActiveProcesses > 0) {
-        for (Index = 0; Index < NumberActiveProcesses; Index++) {
-            if (ChildRecipeArray[Index].ProcessHandle == NULL) {
-                break;
-            }
-            ProcessHandleArray[Index] = ChildRecipeArray[Index].ProcessHandle;
-        }
-
-        //
-        //  If all have active processes, wait for one to complete, then clean
-        //  up the one that did.  If Index != NumberActiveProcesses, it means
-        //  no handle was found above, so there's nothing to wait for, and
-        //  the entry needs to be cleaned up.
-        //
+    //
+    //  Every active slot is either being waited for or has already been
+    //  reported as complete, so each will be returned exactly once.
+    //
 
-        if (Index == NumberActiveProcesses) {
-            Index = WaitForMultipleObjectsEx(NumberActiveProcesses, ProcessHandleArray, FALSE, INFINITE, FALSE);
-            Index = Index - WAIT_OBJECT_0;
-        }
+    while (NumberActiveProcesses > 0) {
+        Index = MakeWaitPoolWait(&WaitPool);
 
         MakeProcessCompletion(MakeContext, &ChildRecipeArray[Index]);
-        MakeRecipeCompletion(MakeContext, &ChildRecipeArray[Index]);
-
-        if (NumberActiveProcesses > Index + 1) {
-            memmove(&ChildRecipeArray[Index],
-                    &ChildRecipeArray[Index + 1],
-                    (NumberActiveProcesses - Index - 1) * sizeof(MAKE_CHILD_RECIPE));
-        }
+        MakeRecipeCompletion(MakeContext, &ChildRecipeArray[Index], FALSE);
+        MakeBuildDbUpdateTarget(MakeContext, ChildRecipeArray[Index].Target, FALSE, 0, 0);
+        ZeroMemory(&ChildRecipeArray[Index], sizeof(MAKE_CHILD_RECIPE));
 
         NumberActiveProcesses--;
     }
 
+    MakeTraceEndExecute(MakeContext);
+
+    MakeWaitPoolCleanup(&WaitPool);
     YoriLibFree(ChildRecipeArray);
-    YoriLibFree(ProcessHandleArray);
+    YoriLibFree(FreeSlotArray);
+    YoriLibFree(MakeContext->JobIdsAllocated);
+    MakeContext->JobIdsAllocated = NULL;
 
     return Result;
 }
@@ -3,7 +3,7 @@
  *
  * Yori shell make program
  *
- * Copyright (c) 2020-2021 Malcolm J. Smith
+ * Copyright (c) 2020-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -37,17 +37,24 @@ CHAR strMakeHelpText[] =
         "\n"
         "Execute makefiles.\n"
         "\n"
-        "YMAKE [-license] [-f file] [-j n] [-m] [-perf] [-pru] [-s] [var=value] [target]\n"
+        "YMAKE [-license] [-f file] [-j n] [-m] [-bdb] [-cache dir [-cachelink]] [-o] [-perf] [-pru] [-s] [-spec] [-trace file] [-watch] [var=value] [target]\n"
         "\n"
         "   --             Treat all further arguments as display parameters\n"
+        "   -bdb           Skip targets whose inputs and commands are unchanged\n"
+        "   -cache         Share outputs of recipes with other builds via a directory\n"
+        "   -cachelink     Hard link outputs from the cache rather than copying\n"
         "   -f             Name of the makefile to use, default YMkFile or Makefile\n"
         "   -j             The number of child processes, default number of processors+1\n"
         "   -k             Keep executing jobs after errors\n"
         "   -m             Perform tasks at low priority\n"
         "   -mm            Perform tasks at very low priority\n"
+        "   -o             Only display output from targets that fail\n"
         "   -perf          Display how much time was spent in each phase of processing\n"
         "   -pru           Keep a cache of preprocessor recently executed results\n"
-        "   -s             Silently launch child processes\n";
+        "   -s             Silently launch child processes\n"
+        "   -spec          Execute preprocessor commands speculatively in parallel\n"
+        "   -trace         Write a timeline of the build to a file in Chrome trace format\n"
+        "   -watch         Rebuild whenever files under the makefile directory change\n";
 
 
 /**
@@ -86,8 +93,10 @@ typedef struct _MAKE_DEFAULT_MACRO {
  to skip that extra parameter when parsing variables or targets.
  */
 CONST YORI_STRING MakeArgsWithParameter[] = {
+    YORILIB_CONSTANT_STRING(_T("cache")),
     YORILIB_CONSTANT_STRING(_T("f")),
-    YORILIB_CONSTANT_STRING(_T("j"))
+    YORILIB_CONSTANT_STRING(_T("j")),
+    YORILIB_CONSTANT_STRING(_T("trace"))
 };
 
 /**
@@ -119,35 +128,82 @@ typedef struct _MAKE_BUILTIN_NAME_MAPPING {
     PYORI_CMD_BUILTIN BuiltinFn;
 } MAKE_BUILTIN_NAME_MAPPING, *PMAKE_BUILTIN_NAME_MAPPING;
 
+/**
+ Declaration for the builtin command.
+ */
+YORI_CMD_BUILTIN YoriCmd_FALSE;
+
 /**
  Declaration for the builtin command.
  */
 YORI_CMD_BUILTIN YoriCmd_REM;
 
+/**
+ Declaration for the builtin command.
+ */
+YORI_CMD_BUILTIN YoriCmd_TOUCH;
+
+/**
+ Declaration for the builtin command.
+ */
+YORI_CMD_BUILTIN YoriCmd_TRUE;
+
+/**
+ Declaration for the builtin command.
+ */
+YORI_CMD_BUILTIN YoriCmd_YCOPY;
+
 /**
  Declaration for the builtin command.
  */
 YORI_CMD_BUILTIN YoriCmd_YECHO;
 
+/**
+ Declaration for the builtin command.
+ */
+YORI_CMD_BUILTIN YoriCmd_YERASE;
+
 /**
  Declaration for the builtin command.
  */
 YORI_CMD_BUILTIN YoriCmd_YMKDIR;
 
+/**
+ Declaration for the builtin command.
+ */
+YORI_CMD_BUILTIN YoriCmd_YMOVE;
+
 /**
  Declaration for the builtin command.
  */
 YORI_CMD_BUILTIN YoriCmd_YRMDIR;
 
+/**
+ Declaration for the builtin command.
+ */
+YORI_CMD_BUILTIN YoriCmd_YTYPE;
+
 /**
  The list of builtin commands supported by this build of Yori.
  */
 CONST MAKE_BUILTIN_NAME_MAPPING
 MakeBuiltinCmds[] = {
+    {_T("COPY"),      YoriCmd_YCOPY},
+    {_T("DEL"),       YoriCmd_YERASE},
     {_T("ECHO"),      YoriCmd_YECHO},
+    {_T("ERASE"),     YoriCmd_YERASE},
+    {_T("FALSE"),     YoriCmd_FALSE},
     {_T("MKDIR"),     YoriCmd_YMKDIR},
+    {_T("MOVE"),      YoriCmd_YMOVE},
     {_T("REM"),       YoriCmd_REM},
     {_T("RMDIR"),     YoriCmd_YRMDIR},
+    {_T("TOUCH"),     YoriCmd_TOUCH},
+    {_T("TRUE"),      YoriCmd_TRUE},
+    {_T("TYPE"),      YoriCmd_YTYPE},
+    {_T("YCOPY"),     YoriCmd_YCOPY},
+    {_T("YERASE"),    YoriCmd_YERASE},
+    {_T("YMOVE"),     YoriCmd_YMOVE},
+    {_T("YTYPE"),     YoriCmd_YTYPE},
     {NULL,            NULL}
 };
 
@@ -323,31 +379,34 @@ MakeBuildVariableValueString(
 }
 
 
-#ifdef YORI_BUILTIN
-/**
- The main entrypoint for the ymake builtin command.
- */
-#define ENTRYPOINT YoriCmd_YMAKE
-#else
 /**
- The main entrypoint for the ymake standalone application.
+ The amount of time, in milliseconds, that the tree must be free of changes
+ before a watch mode rebuild starts.  Editors and source control tools
+ typically write several files in quick succession, and rebuilding after the
+ first one would only need to be repeated.
  */
-#define ENTRYPOINT ymain
-#endif
+#define MAKE_WATCH_SETTLE_TIME 300
 
 /**
- The main entrypoint for the ymake cmdlet.
+ Parse the command line, load the makefile, and build any out of date
+ targets.
 
  @param ArgC The number of arguments.
 
  @param ArgV An array of arguments.
 
- @return Exit code of the process, zero on success, nonzero on failure.
+ @param WatchDirectory On successful completion, if watch mode was requested,
+        populated with a NULL terminated copy of the directory containing
+        the makefile.  If watch mode was not requested, or the directory
+        could not be determined, this is left empty.
+
+ @return Exit code of the build, zero on success, nonzero on failure.
  */
 DWORD
-ENTRYPOINT(
+MakeBuild(
     __in YORI_ALLOC_SIZE_T ArgC,
-    __in YORI_STRING ArgV[]
+    __in YORI_STRING ArgV[],
+    __out PYORI_STRING WatchDirectory
     )
 {
     BOOLEAN ArgumentUnderstood;
@@ -355,7 +414,9 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T StartArg = 0;
     MAKE_CONTEXT MakeContext;
     PYORI_STRING FileName;
+    PYORI_STRING TraceFileName;
     PMAKE_TARGET RootTarget;
+    BOOLEAN Watch;
     YORI_STRING FullFileName;
     LARGE_INTEGER StartTime;
     LARGE_INTEGER EndTime;
@@ -367,10 +428,12 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T CharsConsumed;
     MAKE_PRIORITY Priority;
     BOOLEAN ExplicitTargetFound;
+    BOOLEAN PathIndexEnabled;
     WORD PerformanceProcessors;
     WORD EfficiencyProcessors;
 
     FileName = NULL;
+    TraceFileName = NULL;
     RootTarget = NULL;
     ZeroMemory(&MakeContext, sizeof(MakeContext));
     YoriLibInitializeListHead(&MakeContext.ScopesList);
@@ -381,9 +444,14 @@ ENTRYPOINT(
     YoriLibInitializeListHead(&MakeContext.TargetsReady);
     YoriLibInitializeListHead(&MakeContext.TargetsWaiting);
     YoriLibInitializeListHead(&MakeContext.PreprocessorCacheList);
+    YoriLibInitializeListHead(&MakeContext.SpeculativeCommandList);
+    YoriLibInitializeListHead(&MakeContext.BuildDatabaseList);
     YoriLibInitEmptyString(&FullFileName);
     Priority = MakePriorityNormal;
     ExplicitTargetFound = FALSE;
+    PathIndexEnabled = FALSE;
+    Watch = FALSE;
+    YoriLibInitEmptyString(WatchDirectory);
 
     {
         MAKE_BUILTIN_NAME_MAPPING CONST *BuiltinNameMapping = MakeBuiltinCmds;
@@ -437,13 +505,19 @@ ENTRYPOINT(
         MakeContext.TempPath.LengthInChars--;
     }
 
-    MakeContext.Scopes = YoriLibAllocateHashTable(1000);
+    MakeContext.Scopes = YoriLibAllocateHashTableEx(1000, YoriLibHashStringFnv32);
     if (MakeContext.Scopes == NULL) {
         Result = EXIT_FAILURE;
         goto Cleanup;
     }
 
-    MakeContext.Targets = YoriLibAllocateHashTable(4000);
+    MakeContext.Atoms = YoriLibAllocateAtomTable(8000);
+    if (MakeContext.Atoms == NULL) {
+        Result = EXIT_FAILURE;
+        goto Cleanup;
+    }
+
+    MakeContext.Targets = YoriLibAllocateOpenHashTable(4000);
     if (MakeContext.Targets == NULL) {
         Result = EXIT_FAILURE;
         goto Cleanup;
@@ -486,6 +560,30 @@ ENTRYPOINT(
                 ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("nologo")) == 0) {
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("bdb")) == 0) {
+                if (MakeContext.BuildDatabase == NULL) {
+                    MakeContext.BuildDatabase = YoriLibAllocateHashTable(1000);
+                    if (MakeContext.BuildDatabase == NULL) {
+                        Result = EXIT_FAILURE;
+                        goto Cleanup;
+                    }
+                }
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("cache")) == 0) {
+                if (i + 1 < ArgC) {
+                    YoriLibFreeStringContents(&MakeContext.ArtifactCacheDir);
+                    if (!YoriLibUserStringToSingleFilePath(&ArgV[i + 1], TRUE, &MakeContext.ArtifactCacheDir)) {
+                        Result = EXIT_FAILURE;
+                        goto Cleanup;
+                    }
+                    ArgumentUnderstood = TRUE;
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("cachelink")) == 0) {
+                MakeContext.ArtifactCacheLink = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("o")) == 0) {
+                MakeContext.FailedTargetOutputOnly = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("perf")) == 0) {
                 MakeContext.PerfDisplay = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -502,6 +600,23 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 MakeContext.SilentCommandLaunching = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("spec")) == 0) {
+                if (MakeContext.SpeculativeCommands == NULL) {
+                    MakeContext.SpeculativeCommands = YoriLibAllocateHashTable(100);
+                    if (MakeContext.SpeculativeCommands == NULL) {
+                        Result = EXIT_FAILURE;
+                        goto Cleanup;
+                    }
+                }
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("trace")) == 0) {
+                if (i + 1 < ArgC) {
+                    TraceFileName = &ArgV[i + 1];
+                    ArgumentUnderstood = TRUE;
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("watch")) == 0) {
+                Watch = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("wundef")) == 0) {
                 MakeContext.WarnOnUndefinedVariable = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -541,6 +656,13 @@ ENTRYPOINT(
         StartArg = ArgC;
     }
 
+    if (TraceFileName != NULL) {
+        if (!MakeTraceOpen(&MakeContext, TraceFileName)) {
+            Result = EXIT_FAILURE;
+            goto Cleanup;
+        }
+    }
+
     //
     //  If -j isn't specified, attempt to set the number of jobs based on the
     //  environment variable.
@@ -609,12 +731,12 @@ ENTRYPOINT(
     }
 
     //
-    //  WaitForMultipleObjects has a limit of 64 things to wait for, so this
-    //  program can't currently have more than 64 children.
+    //  Child processes are waited for by a pool of threads, so the limit is
+    //  only to keep job identifiers and wait threads bounded.
     //
 
-    if (MakeContext.NumberProcesses > 64) {
-        MakeContext.NumberProcesses = 64;
+    if (MakeContext.NumberProcesses > MAKE_MAX_CHILD_PROCESSES) {
+        MakeContext.NumberProcesses = MAKE_MAX_CHILD_PROCESSES;
     }
 
     //
@@ -650,6 +772,14 @@ ENTRYPOINT(
     //  Allocate and initialize the scope.
     //
 
+    if (Watch) {
+        if (!YoriLibCopyString(WatchDirectory, &RootDir)) {
+            YoriLibFreeStringContents(&RootDir);
+            Result = EXIT_FAILURE;
+            goto Cleanup;
+        }
+    }
+
     MakeContext.RootScope = MakeAllocateNewScope(&MakeContext, &RootDir);
     YoriLibFreeStringContents(&RootDir);
     if (MakeContext.RootScope == NULL) {
@@ -721,6 +851,13 @@ ENTRYPOINT(
     YoriLibCancelEnable(FALSE);
 #endif
 
+    //
+    //  Commands are located in the path throughout preprocessing and
+    //  execution, so index the path rather than searching it each time.
+    //
+
+    PathIndexEnabled = YoriLibPathIndexEnable();
+
     //
     //  When using a cache, try to load any cached preprocessor conditions for
     //  this makefile.
@@ -730,6 +867,10 @@ ENTRYPOINT(
         MakeLoadPreprocessorCacheEntries(&MakeContext, &FullFileName);
     }
 
+    if (MakeContext.BuildDatabase != NULL) {
+        MakeLoadBuildDatabase(&MakeContext, &FullFileName);
+    }
+
     hStream = CreateFile(FullFileName.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
     if (hStream == INVALID_HANDLE_VALUE) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("No makefile found\n"));
@@ -746,6 +887,8 @@ ENTRYPOINT(
     QueryPerformanceCounter(&EndTime);
 
     MakeContext.TimeInPreprocessor = EndTime.QuadPart - StartTime.QuadPart;
+    YoriLibConstantString(&Arg, _T("Preprocess"));
+    MakeTraceCompleteEvent(&MakeContext, _T("phase"), &Arg, 0, StartTime.QuadPart, EndTime.QuadPart, NULL, NULL);
 
     CloseHandle(hStream);
 
@@ -754,6 +897,17 @@ ENTRYPOINT(
         goto Cleanup;
     }
 
+    //
+    //  From this point until the graph is built, nothing should be changing
+    //  the tree, so the state of files can be captured a directory at a
+    //  time.
+    //
+
+    if (!MakeStatCacheInitialize(&MakeContext)) {
+        Result = EXIT_FAILURE;
+        goto Cleanup;
+    }
+
     MakeFindInferenceRulesForScope(MakeContext.RootScope);
 
     //
@@ -812,8 +966,13 @@ ENTRYPOINT(
         }
     }
 
+    MakeScheduleTargetsByCriticalPath(&MakeContext);
+    MakeStatCacheCleanup(&MakeContext);
+
     QueryPerformanceCounter(&EndTime);
     MakeContext.TimeBuildingGraph = EndTime.QuadPart - StartTime.QuadPart;
+    YoriLibConstantString(&Arg, _T("Build graph"));
+    MakeTraceCompleteEvent(&MakeContext, _T("phase"), &Arg, 0, StartTime.QuadPart, EndTime.QuadPart, NULL, NULL);
 
     //
     //  Execute the tasks
@@ -827,6 +986,8 @@ ENTRYPOINT(
     }
     QueryPerformanceCounter(&EndTime);
     MakeContext.TimeInExecute = EndTime.QuadPart - StartTime.QuadPart;
+    YoriLibConstantString(&Arg, _T("Execute"));
+    MakeTraceCompleteEvent(&MakeContext, _T("phase"), &Arg, 0, StartTime.QuadPart, EndTime.QuadPart, NULL, NULL);
 
 
     Result = EXIT_SUCCESS;
@@ -851,11 +1012,21 @@ Cleanup:
     MakeDeleteAllTargets(&MakeContext);
 
     if (MakeContext.Targets != NULL) {
-        YoriLibFreeEmptyHashTable(MakeContext.Targets);
+        YoriLibFreeEmptyOpenHashTable(MakeContext.Targets);
     }
 
+    MakeStatCacheCleanup(&MakeContext);
+    MakePrefetchCleanup(&MakeContext);
+    MakeDeleteAllSpeculativeCommands(&MakeContext);
     MakeDeleteAllScopes(&MakeContext);
     MakeSaveAndDeleteAllPreprocessorCacheEntries(&MakeContext, &FullFileName);
+    MakeSaveAndDeleteBuildDatabase(&MakeContext, &FullFileName);
+    MakeTraceClose(&MakeContext);
+    YoriLibFreeStringContents(&MakeContext.ArtifactCacheDir);
+
+    if (MakeContext.Atoms != NULL) {
+        YoriLibFreeAtomTable(MakeContext.Atoms);
+    }
 
     YoriLibFreeStringContents(&FullFileName);
 
@@ -867,6 +1038,10 @@ Cleanup:
 
     YoriLibLineReadCleanupCache();
 
+    if (PathIndexEnabled) {
+        YoriLibPathIndexCleanup();
+    }
+
     if (MakeContext.ErrorTermination) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Parse error!!\n"));
         Result = EXIT_FAILURE;
@@ -905,4 +1080,121 @@ Cleanup:
     return Result;
 }
 
+/**
+ Wait for a file to be created, deleted, renamed or written anywhere beneath
+ a directory.  Once a change is observed, keep waiting until the tree has been
+ quiet for MAKE_WATCH_SETTLE_TIME so that a burst of changes results in a
+ single rebuild.
+
+ @param Directory Pointer to a NULL terminated directory to monitor.
+
+ @return TRUE if a change was detected, FALSE if the wait was cancelled or
+         the directory could not be monitored.
+ */
+BOOLEAN
+MakeWaitForChange(
+    __in PYORI_STRING Directory
+    )
+{
+    HANDLE ChangeHandle;
+    HANDLE WaitHandles[2];
+    DWORD HandleCount;
+    DWORD WaitResult;
+    DWORD Err;
+    LPTSTR ErrText;
+
+    ChangeHandle = FindFirstChangeNotification(Directory->StartOfString,
+                                               TRUE,
+                                               FILE_NOTIFY_CHANGE_FILE_NAME |
+                                                 FILE_NOTIFY_CHANGE_DIR_NAME |
+                                                 FILE_NOTIFY_CHANGE_LAST_WRITE);
+
+    if (ChangeHandle == INVALID_HANDLE_VALUE) {
+        Err = GetLastError();
+        ErrText = YoriLibGetWinErrorText(Err);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ymake: could not monitor %y: %s"), Directory, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    HandleCount = 0;
+    WaitHandles[HandleCount++] = ChangeHandle;
+    if (YoriLibCancelGetEvent() != NULL) {
+        WaitHandles[HandleCount++] = YoriLibCancelGetEvent();
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("\nWaiting for changes in %y...\n"), Directory);
+
+    WaitResult = WaitForMultipleObjects(HandleCount, WaitHandles, FALSE, INFINITE);
+    while (WaitResult == WAIT_OBJECT_0) {
+        if (!FindNextChangeNotification(ChangeHandle)) {
+            break;
+        }
+        WaitResult = WaitForMultipleObjects(HandleCount, WaitHandles, FALSE, MAKE_WATCH_SETTLE_TIME);
+    }
+
+    FindCloseChangeNotification(ChangeHandle);
+
+    if (WaitResult != WAIT_OBJECT_0 && WaitResult != WAIT_TIMEOUT) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+#ifdef YORI_BUILTIN
+/**
+ The main entrypoint for the ymake builtin command.
+ */
+#define ENTRYPOINT YoriCmd_YMAKE
+#else
+/**
+ The main entrypoint for the ymake standalone application.
+ */
+#define ENTRYPOINT ymain
+#endif
+
+/**
+ The main entrypoint for the ymake cmdlet.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV An array of arguments.
+
+ @return Exit code of the process, zero on success, nonzero on failure.
+ */
+DWORD
+ENTRYPOINT(
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[]
+    )
+{
+    YORI_STRING WatchDirectory;
+    DWORD Result;
+
+    Result = MakeBuild(ArgC, ArgV, &WatchDirectory);
+
+    //
+    //  In watch mode, the change notification is armed once the build has
+    //  completed, so the build's own outputs and cache files don't trigger
+    //  another pass.  Each pass reloads state from scratch, but with -pru
+    //  and -bdb that reload is served from the caches written by the
+    //  previous pass.
+    //
+
+    while (WatchDirectory.LengthInChars > 0) {
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+        if (!MakeWaitForChange(&WatchDirectory)) {
+            break;
+        }
+        YoriLibFreeStringContents(&WatchDirectory);
+        Result = MakeBuild(ArgC, ArgV, &WatchDirectory);
+    }
+
+    YoriLibFreeStringContents(&WatchDirectory);
+    return Result;
+}
+
 // vim:sw=4:ts=4:et:
@@ -3,7 +3,7 @@
  *
  * Yori shell make master header
  *
- * Copyright (c) 2020-2021 Malcolm J. Smith
+ * Copyright (c) 2020-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -113,6 +113,146 @@ typedef struct _MAKE_PREPROC_EXEC_CACHE_ENTRY {
 
 } MAKE_PREPROC_EXEC_CACHE_ENTRY, *PMAKE_PREPROC_EXEC_CACHE_ENTRY;
 
+/**
+ A preprocessor command found by scanning ahead in a makefile.  These may be
+ launched before the parser reaches them so that their result is available
+ when it is needed.
+ */
+typedef struct _MAKE_PREPROC_SPECULATIVE_ENTRY {
+
+    /**
+     The hash entry of the preprocessor command.  This is keyed by the
+     command string only, so a result is only used if the parser evaluates
+     exactly the same command.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The list of all speculative entries, in the order they were found.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The parsed form of the command.
+     */
+    YORI_LIBSH_CMD_CONTEXT CmdContext;
+
+    /**
+     The plan to execute the command.  When the command has been launched,
+     the first program in the plan refers to the child process.
+     */
+    YORI_LIBSH_EXEC_PLAN ExecPlan;
+
+    /**
+     Identifies the makefile scan that found this command.
+     */
+    DWORD StreamId;
+
+    /**
+     TRUE if the command has been launched.
+     */
+    BOOLEAN Launched;
+
+} MAKE_PREPROC_SPECULATIVE_ENTRY, *PMAKE_PREPROC_SPECULATIVE_ENTRY;
+
+/**
+ A record of how a target was last successfully built.  These are saved
+ between runs so a target whose timestamps indicate it needs rebuilding can
+ be skipped if it would be built from identical inputs with identical
+ commands.
+ */
+typedef struct _MAKE_BUILD_DB_ENTRY {
+
+    /**
+     The hash entry of the target, keyed by the full target name.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     A list of all entries to facilitate efficient teardown.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The hash of the commands used to build the target.
+     */
+    DWORDLONG CmdHash;
+
+    /**
+     The hash of the names and contents of the target's dependencies.
+     */
+    DWORDLONG InputHash;
+
+    /**
+     The last write time of the target after it was built.  If the target
+     has been modified since, the record is not trusted.
+     */
+    LARGE_INTEGER OutputTime;
+
+    /**
+     The time taken to execute the recipe when the target was built, in
+     milliseconds.  This is used to prioritize targets on the critical path.
+     */
+    DWORD Duration;
+
+    /**
+     The largest commit charge, in bytes, of any process launched by the
+     recipe when the target was built.  This is used to avoid launching
+     recipes concurrently when they would exhaust memory.
+     */
+    DWORDLONG PeakCommit;
+
+} MAKE_BUILD_DB_ENTRY, *PMAKE_BUILD_DB_ENTRY;
+
+/**
+ The state of a file or directory as found by enumerating the directory that
+ contains it.  An entry also exists for each directory that has been
+ enumerated, and for files that were queried but do not exist.
+ */
+typedef struct _MAKE_STAT_CACHE_ENTRY {
+
+    /**
+     The hash entry, keyed by the full path to the object.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     A list of all entries to facilitate efficient teardown.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The last write time of the object.
+     */
+    LARGE_INTEGER LastWriteTime;
+
+    /**
+     The attributes of the object, or (DWORD)-1 if the object does not
+     exist.
+     */
+    DWORD FileAttributes;
+
+    /**
+     TRUE if this entry refers to a directory whose contents have been
+     enumerated into the cache.
+     */
+    BOOLEAN Enumerated;
+
+    /**
+     TRUE if this entry refers to a directory that could not be enumerated,
+     so objects within it need to be queried individually.
+     */
+    BOOLEAN EnumerateFailed;
+
+    /**
+     TRUE if this entry describes an object that was queried individually
+     because its directory could not answer the query, and the query found
+     that the object does not exist.
+     */
+    BOOLEAN NotFoundByQuery;
+
+} MAKE_STAT_CACHE_ENTRY, *PMAKE_STAT_CACHE_ENTRY;
+
 /**
  The name of the default target within a scope.  This refers to the first
  user defined target within the scope.  Note this name is chosen to be an
@@ -210,6 +350,26 @@ typedef struct _MAKE_SCOPE_CONTEXT {
      */
     YORI_LIST_ENTRY VariableList;
 
+    /**
+     A hash table of previously expanded variable expressions within this
+     scope.  This is allocated on first use.
+     */
+    PYORI_HASH_TABLE ExpansionCache;
+
+    /**
+     A list of previously expanded variable expressions, used to facilitate
+     bulk delete.  This is only initialized if ExpansionCache is allocated.
+     */
+    YORI_LIST_ENTRY ExpansionCacheList;
+
+    /**
+     The arena that previously expanded variable expressions are allocated
+     from.  Entries are never freed individually, so they are all released
+     when the cache is deleted.  This is only initialized if ExpansionCache
+     is allocated.
+     */
+    YORI_LIB_ARENA ExpansionCacheArena;
+
     /**
      A list of known inference rules.
      */
@@ -273,6 +433,36 @@ typedef enum _MAKE_VARIABLE_PRECEDENCE {
 } MAKE_VARIABLE_PRECEDENCE;
 
 
+/**
+ The result of expanding a variable expression within a scope.  This
+ structure is followed in memory by the expression.
+ */
+typedef struct _MAKE_EXPANSION_CACHE_ENTRY {
+
+    /**
+     The hash entry, keyed by the variable expression including any search
+     and replace text.  Paired with MAKE_SCOPE_CONTEXT::ExpansionCache.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The list entry.  Paired with MAKE_SCOPE_CONTEXT::ExpansionCacheList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     A referenced string containing the expanded value.
+     */
+    YORI_STRING Value;
+
+    /**
+     The value of MAKE_CONTEXT::VariableGeneration when the expansion was
+     generated.  If any variable has changed since, the expansion is stale.
+     */
+    DWORD Generation;
+
+} MAKE_EXPANSION_CACHE_ENTRY, *PMAKE_EXPANSION_CACHE_ENTRY;
+
 /**
  Structure describing a variable within a makefile.  This structure is
  followed in memory by the variable name, and is followed by the initial
@@ -449,7 +639,7 @@ typedef struct _MAKE_TARGET {
     /**
      The hash entry.  Key is fully qualified path name.
      */
-    YORI_HASH_ENTRY HashEntry;
+    YORI_OPEN_HASH_ENTRY HashEntry;
 
     /**
      A list of MAKE_TARGET_DEPENDENCY objects that this target depends upon.
@@ -555,6 +745,41 @@ typedef struct _MAKE_TARGET {
      */
     BOOLEAN InferenceRulePseudoTarget;
 
+    /**
+     TRUE if ContentHash has been calculated.
+     */
+    BOOLEAN ContentHashed;
+
+    /**
+     TRUE if BuildDbInputHash has been calculated.
+     */
+    BOOLEAN BuildDbInputHashCalculated;
+
+    /**
+     TRUE if CriticalPathCost has been calculated.
+     */
+    BOOLEAN CriticalPathCalculated;
+
+    /**
+     The hash of the contents of the file.  This is only meaningful if
+     ContentHashed is TRUE, and is zero if the target is not a file.
+     */
+    DWORDLONG ContentHash;
+
+    /**
+     The hash of the names and contents of this target's dependencies, used
+     to compare against the build database.  This is only meaningful if
+     BuildDbInputHashCalculated is TRUE.
+     */
+    DWORDLONG BuildDbInputHash;
+
+    /**
+     The expected time to execute this target's recipe and the longest chain
+     of recipes that depend on it.  Ready targets with the highest cost are
+     executed first.
+     */
+    DWORDLONG CriticalPathCost;
+
     /**
      The timestamp of the file.  This is only meaningful if FileExists is
      TRUE (implying FileProbed is also TRUE.)
@@ -616,6 +841,11 @@ typedef struct _MAKE_INLINE_FILE {
     HANDLE FileHandle;
 } MAKE_INLINE_FILE, *PMAKE_INLINE_FILE;
 
+/**
+ The maximum number of child processes to execute concurrently.
+ */
+#define MAKE_MAX_CHILD_PROCESSES (1024)
+
 /**
  Current state of the operation.
  */
@@ -668,7 +898,14 @@ typedef struct _MAKE_CONTEXT {
      as dependencies even if they are assumed to already exist (source files.)
      The key of this hash table is fully qualified path.
      */
-    PYORI_HASH_TABLE Targets;
+    PYORI_OPEN_HASH_TABLE Targets;
+
+    /**
+     A table of interned file names.  Target names and file state cache
+     entries refer to the same path many times, so these share a single
+     allocation per path.
+     */
+    PYORI_LIB_ATOM_TABLE Atoms;
 
     /**
      A list of known targets, used to facilitate bulk delete.
@@ -707,6 +944,136 @@ typedef struct _MAKE_CONTEXT {
      */
     YORI_LIST_ENTRY PreprocessorCacheList;
 
+    /**
+     A hash table of preprocessor commands found by scanning ahead in
+     makefiles, which may be executing before the parser needs their result.
+     This is only allocated if speculative execution was requested.
+     */
+    PYORI_HASH_TABLE SpeculativeCommands;
+
+    /**
+     A list of speculative preprocessor commands, in the order they were
+     found.
+     */
+    YORI_LIST_ENTRY SpeculativeCommandList;
+
+    /**
+     A hash table of records describing how targets were last built.  This
+     is only allocated if the build database was requested.
+     */
+    PYORI_HASH_TABLE BuildDatabase;
+
+    /**
+     A list of build database records, used to facilitate bulk delete.
+     */
+    YORI_LIST_ENTRY BuildDatabaseList;
+
+    /**
+     The full path to a directory shared between builds containing the
+     outputs of previously executed recipes.  This is empty if no artifact
+     cache was requested.
+     */
+    YORI_STRING ArtifactCacheDir;
+
+    /**
+     A hash table of file and directory state found by enumerating
+     directories.  This only exists while the dependency graph is being
+     built, since nothing should be changing the tree at that time.
+     */
+    PYORI_HASH_TABLE StatCache;
+
+    /**
+     A list of file state cache entries, used to facilitate bulk delete.
+     */
+    YORI_LIST_ENTRY StatCacheList;
+
+    /**
+     A hash table of outstanding requests to prefetch subdirectory
+     makefiles, keyed by directory.  This is allocated when the first
+     request is made.
+     */
+    PYORI_HASH_TABLE PrefetchRequests;
+
+    /**
+     A list of all outstanding prefetch requests, used to facilitate bulk
+     delete.
+     */
+    YORI_LIST_ENTRY PrefetchList;
+
+    /**
+     A list of prefetch requests which have not been started by a prefetch
+     thread.  This is protected by PrefetchMutex.
+     */
+    YORI_LIST_ENTRY PrefetchQueue;
+
+    /**
+     A mutex synchronizing the prefetch queue.
+     */
+    HANDLE PrefetchMutex;
+
+    /**
+     A semaphore signalled once for each prefetch request queued.
+     */
+    HANDLE PrefetchSemaphore;
+
+    /**
+     An array of PrefetchThreadCount handles to prefetch threads.
+     */
+    PHANDLE PrefetchThreads;
+
+    /**
+     The number of prefetch threads.
+     */
+    DWORD PrefetchThreadCount;
+
+    /**
+     A handle to a file to write a timeline of the build to.  This is NULL
+     if no trace was requested.
+     */
+    HANDLE TraceHandle;
+
+    /**
+     The frequency of the performance counter, used to convert times in the
+     trace to microseconds.
+     */
+    LARGE_INTEGER TraceFrequency;
+
+    /**
+     The performance counter value when the trace was opened.  Times in the
+     trace are relative to this point.
+     */
+    LARGE_INTEGER TraceStartTime;
+
+    /**
+     While executing targets with a trace open, an array of NumberProcesses
+     elements indicating the performance counter value when each job slot
+     became idle, or zero if the slot is currently executing.
+     */
+    PLONGLONG TraceSlotIdleSince;
+
+    /**
+     The number of job slots which have been described in the trace.
+     */
+    YORI_ALLOC_SIZE_T TraceSlotCount;
+
+    /**
+     TRUE once an event has been written to the trace, indicating that
+     further events need a separator.
+     */
+    BOOLEAN TraceEventWritten;
+
+    /**
+     Set to TRUE to indicate that prefetch threads should terminate.  This
+     is protected by PrefetchMutex.
+     */
+    BOOLEAN PrefetchShutdown;
+
+    /**
+     Set to TRUE if the prefetch threads could not be created, so
+     subdirectory makefiles are only read by the main thread.
+     */
+    BOOLEAN PrefetchUnavailable;
+
     /**
      Allocations used to generate files to look for when determining which
      inference rules to apply.  Because these are very temporary, they are
@@ -724,14 +1091,16 @@ typedef struct _MAKE_CONTEXT {
     YORI_STRING TempPath;
 
     /**
-     A bitmask representing which job IDs have been allocated.
+     An array of NumberProcesses elements indicating which job IDs have been
+     allocated.
      */
-    DWORDLONG JobIdsAllocated;
+    PBOOLEAN JobIdsAllocated;
 
     /**
-     A bitmask representing temporary directories which have been created.
+     An array of NumberProcesses elements indicating which temporary
+     directories have been created.
      */
-    DWORDLONG TempDirectoriesCreated;
+    PBOOLEAN TempDirectoriesCreated;
 
     /**
      The time taken to execute processes as part of preprocessor commands.
@@ -790,11 +1159,41 @@ typedef struct _MAKE_CONTEXT {
 
     /**
      The number of child processes to execute concurrently.  This defaults
-     to the number of logical processors, but is limited to 64 due to
-     WaitForMultipleObjects.
+     to the number of logical processors plus one, and is limited to
+     MAKE_MAX_CHILD_PROCESSES.
      */
     YORI_ALLOC_SIZE_T NumberProcesses;
 
+    /**
+     The number of speculative preprocessor commands currently executing.
+     This is limited to NumberProcesses.
+     */
+    YORI_ALLOC_SIZE_T SpeculativeCommandsLaunched;
+
+    /**
+     The expected time to execute a recipe that has no build database
+     record, in milliseconds.  This is the average of the recorded times.
+     */
+    DWORD BuildDbDefaultDuration;
+
+    /**
+     If TRUE, outputs found in the artifact cache are hard linked into the
+     tree rather than copied.
+     */
+    BOOLEAN ArtifactCacheLink;
+
+    /**
+     A counter incremented each time any variable is set, used to determine
+     whether cached variable expansions are current.
+     */
+    DWORD VariableGeneration;
+
+    /**
+     The identifier to assign to the next makefile scanned for speculative
+     preprocessor commands.
+     */
+    DWORD NextSpeculativeStreamId;
+
     /**
      The 32 bit hash of the environment block. This process does not modify
      its own environment, so this can be calculated once for the lifetime
@@ -825,6 +1224,12 @@ typedef struct _MAKE_CONTEXT {
      */
     BOOLEAN KeepGoing;
 
+    /**
+     TRUE to indicate that output from targets should only be displayed if
+     the target fails.
+     */
+    BOOLEAN FailedTargetOutputOnly;
+
     /**
      TRUE to indicate the user has requested to suppress display of commands
      as they are executing globally.
@@ -836,6 +1241,13 @@ typedef struct _MAKE_CONTEXT {
      */
     BOOLEAN WarnOnUndefinedVariable;
 
+    /**
+     TRUE if any preprocessor cache entries were loaded from a previous
+     run.  If so, speculative execution is not performed, since the
+     results are likely already known.
+     */
+    BOOLEAN PreprocessorCacheLoaded;
+
 } MAKE_CONTEXT, *PMAKE_CONTEXT;
 
 // *** ALLOC.C ***
@@ -882,6 +1294,11 @@ MakeExpandVariables(
     __out_opt PYORI_STRING VariableNotFound
     );
 
+VOID
+MakeDeleteExpansionCache(
+    __inout PMAKE_SCOPE_CONTEXT ScopeContext
+    );
+
 VOID
 MakeDeleteAllVariables(
     __inout PMAKE_SCOPE_CONTEXT ScopeContext
@@ -919,6 +1336,13 @@ MakeTrimWhitespace(
     __in PYORI_STRING String
     );
 
+__success(return)
+BOOLEAN
+MakeFindMakefileInDirectoryName(
+    __in PCYORI_STRING DirName,
+    __out PYORI_STRING FileName
+    );
+
 __success(return)
 BOOLEAN
 MakeFindMakefileInDirectory(
@@ -945,6 +1369,11 @@ MakeSaveAndDeleteAllPreprocessorCacheEntries(
     __in PYORI_STRING MakeFileName
     );
 
+VOID
+MakeDeleteAllSpeculativeCommands(
+    __inout PMAKE_CONTEXT MakeContext
+    );
+
 VOID
 MakeDeleteInlineFiles(
     __in PMAKE_CONTEXT MakeContext
@@ -1059,6 +1488,185 @@ MakeExpandTargetVariable(
     __out PYORI_STRING VariableData
     );
 
+VOID
+MakeInsertReadyTarget(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    );
+
+VOID
+MakeScheduleTargetsByCriticalPath(
+    __in PMAKE_CONTEXT MakeContext
+    );
+
+// *** BUILDDB.C ***
+
+VOID
+MakeLoadBuildDatabase(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    );
+
+VOID
+MakeSaveAndDeleteBuildDatabase(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    );
+
+__success(return)
+BOOLEAN
+MakeBuildDbCalculateInputHash(
+    __inout PMAKE_TARGET Target
+    );
+
+DWORDLONG
+MakeBuildDbCalculateCmdHash(
+    __in PMAKE_TARGET Target
+    );
+
+BOOLEAN
+MakeBuildDbHaveInputsChanged(
+    __in PMAKE_CONTEXT MakeContext,
+    __inout PMAKE_TARGET Target
+    );
+
+BOOLEAN
+MakeBuildDbIsTargetCurrent(
+    __in PMAKE_CONTEXT MakeContext,
+    __inout PMAKE_TARGET Target
+    );
+
+DWORD
+MakeBuildDbGetTargetDuration(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    );
+
+DWORDLONG
+MakeBuildDbGetTargetPeakCommit(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    );
+
+VOID
+MakeBuildDbUpdateTarget(
+    __in PMAKE_CONTEXT MakeContext,
+    __inout PMAKE_TARGET Target,
+    __in BOOLEAN Succeeded,
+    __in DWORD Duration,
+    __in DWORDLONG PeakCommit
+    );
+
+// *** ARTCACHE.C ***
+
+BOOLEAN
+MakeArtifactCacheFetch(
+    __in PMAKE_CONTEXT MakeContext,
+    __inout PMAKE_TARGET Target
+    );
+
+VOID
+MakeArtifactCachePublish(
+    __in PMAKE_CONTEXT MakeContext,
+    __inout PMAKE_TARGET Target
+    );
+
+// *** PREFETCH.C ***
+
+VOID
+MakePrefetchCleanup(
+    __inout PMAKE_CONTEXT MakeContext
+    );
+
+VOID
+MakePrefetchSubdirectories(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING DirList
+    );
+
+VOID
+MakePrefetchComplete(
+    __inout PMAKE_CONTEXT MakeContext
+    );
+
+// *** STATCACHE.C ***
+
+__success(return)
+BOOLEAN
+MakeStatCacheInitialize(
+    __inout PMAKE_CONTEXT MakeContext
+    );
+
+VOID
+MakeStatCacheCleanup(
+    __inout PMAKE_CONTEXT MakeContext
+    );
+
+__success(return)
+BOOLEAN
+MakeStatCacheQueryFile(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PCYORI_STRING FileName,
+    __out PDWORD FileAttributes,
+    __out PLARGE_INTEGER LastWriteTime
+    );
+
+VOID
+MakeStatCacheRecordNotFound(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PCYORI_STRING FileName
+    );
+
+// *** TRACE.C ***
+
+__success(return)
+BOOLEAN
+MakeTraceOpen(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING FileName
+    );
+
+VOID
+MakeTraceCompleteEvent(
+    __in PMAKE_CONTEXT MakeContext,
+    __in LPCTSTR Category,
+    __in PYORI_STRING Name,
+    __in DWORD ThreadId,
+    __in LONGLONG StartTime,
+    __in LONGLONG EndTime,
+    __in_opt PYORI_STRING Detail,
+    __in_opt PDWORD ExitCode
+    );
+
+VOID
+MakeTraceBeginExecute(
+    __inout PMAKE_CONTEXT MakeContext
+    );
+
+VOID
+MakeTraceJobStarted(
+    __in PMAKE_CONTEXT MakeContext,
+    __in DWORD JobId,
+    __in LONGLONG StartTime
+    );
+
+VOID
+MakeTraceJobFinished(
+    __in PMAKE_CONTEXT MakeContext,
+    __in DWORD JobId,
+    __in LONGLONG EndTime
+    );
+
+VOID
+MakeTraceEndExecute(
+    __inout PMAKE_CONTEXT MakeContext
+    );
+
+VOID
+MakeTraceClose(
+    __inout PMAKE_CONTEXT MakeContext
+    );
+
 // *** EXEC.C ***
 
 VOID
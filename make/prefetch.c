@@ -0,0 +1,501 @@
+/**
+ * @file make/prefetch.c
+ *
+ * Yori shell make subdirectory makefile prefetch
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yorish.h>
+#include "make.h"
+
+/**
+ Subdirectory makefiles need to be parsed in order on the main thread,
+ because a child scope resolves variables through its parent scope and the
+ parent can change those variables after the child is parsed.  What can be
+ done in parallel is the file system work: when a rule lists a series of
+ subdirectories, a pool of threads locates and reads each makefile so that
+ when the main thread reaches it, the makefile is already in the cache.
+ */
+
+/**
+ The maximum number of threads to use to prefetch makefiles.
+ */
+#define MAKE_PREFETCH_MAX_THREADS (16)
+
+/**
+ The size of the buffer used to read makefiles when prefetching.
+ */
+#define MAKE_PREFETCH_READ_BUFFER_SIZE (64 * 1024)
+
+/**
+ A request to prefetch the makefile within a single directory.
+ */
+typedef struct _MAKE_PREFETCH_ENTRY {
+
+    /**
+     The hash entry, keyed by the full path to the directory.  This is only
+     modified by the main thread, and is not modified while the request is
+     being processed.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The list of all requests, to facilitate bulk delete.  This is only
+     used by the main thread.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The list of requests that have not been processed yet.  This is
+     protected by the prefetch mutex.
+     */
+    YORI_LIST_ENTRY QueueEntry;
+
+    /**
+     An event signalled once a prefetch thread has finished with the
+     request.
+     */
+    HANDLE CompleteEvent;
+
+    /**
+     TRUE if the request is on the queue.  This is protected by the prefetch
+     mutex.
+     */
+    BOOLEAN Queued;
+
+} MAKE_PREFETCH_ENTRY, *PMAKE_PREFETCH_ENTRY;
+
+/**
+ Locate a makefile within a directory and read its contents so that a later
+ read by the main thread can be satisfied from the cache.
+
+ @param DirName Pointer to the full path to the directory.
+
+ @param Buffer Pointer to a buffer to read data into.
+ */
+VOID
+MakePrefetchMakefile(
+    __in PYORI_STRING DirName,
+    __in PUCHAR Buffer
+    )
+{
+    YORI_STRING FileName;
+    HANDLE hFile;
+    DWORD BytesRead;
+
+    if (!MakeFindMakefileInDirectoryName(DirName, &FileName)) {
+        return;
+    }
+
+    hFile = CreateFile(FileName.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    YoriLibFreeStringContents(&FileName);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    while (ReadFile(hFile, Buffer, MAKE_PREFETCH_READ_BUFFER_SIZE, &BytesRead, NULL) && BytesRead > 0);
+
+    CloseHandle(hFile);
+}
+
+/**
+ A thread which processes makefile prefetch requests until ymake indicates
+ that it should terminate.
+
+ @param Context Pointer to the context.
+
+ @return Thread exit code, which is always zero.
+ */
+DWORD WINAPI
+MakePrefetchThread(
+    __in LPVOID Context
+    )
+{
+    PMAKE_CONTEXT MakeContext;
+    PMAKE_PREFETCH_ENTRY Entry;
+    PYORI_LIST_ENTRY ListEntry;
+    PUCHAR Buffer;
+
+    MakeContext = (PMAKE_CONTEXT)Context;
+
+    Buffer = YoriLibMalloc(MAKE_PREFETCH_READ_BUFFER_SIZE);
+    if (Buffer == NULL) {
+        return 0;
+    }
+
+    while (TRUE) {
+        WaitForSingleObject(MakeContext->PrefetchSemaphore, INFINITE);
+
+        WaitForSingleObject(MakeContext->PrefetchMutex, INFINITE);
+        if (MakeContext->PrefetchShutdown) {
+            ReleaseMutex(MakeContext->PrefetchMutex);
+            break;
+        }
+
+        //
+        //  The main thread may have removed the request that this wakeup
+        //  corresponds to, so the queue can be empty.
+        //
+
+        Entry = NULL;
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->PrefetchQueue, NULL);
+        if (ListEntry != NULL) {
+            Entry = CONTAINING_RECORD(ListEntry, MAKE_PREFETCH_ENTRY, QueueEntry);
+            YoriLibRemoveListItem(&Entry->QueueEntry);
+            Entry->Queued = FALSE;
+        }
+        ReleaseMutex(MakeContext->PrefetchMutex);
+
+        if (Entry != NULL) {
+            MakePrefetchMakefile(&Entry->HashEntry.Key, Buffer);
+            SetEvent(Entry->CompleteEvent);
+        }
+    }
+
+    YoriLibFree(Buffer);
+    return 0;
+}
+
+/**
+ Create the synchronization objects and threads used to prefetch makefiles.
+
+ @param MakeContext Pointer to the context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakePrefetchInitialize(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    WORD PerformanceProcessors;
+    WORD EfficiencyProcessors;
+    DWORD ThreadCount;
+    DWORD ThreadId;
+    DWORD Index;
+
+    //
+    //  This is mostly waiting for the file system, so use more threads than
+    //  processors.
+    //
+
+    YoriLibQueryCpuCount(&PerformanceProcessors, &EfficiencyProcessors);
+    ThreadCount = ((DWORD)PerformanceProcessors + EfficiencyProcessors) * 2;
+    if (ThreadCount < 2) {
+        ThreadCount = 2;
+    }
+    if (ThreadCount > MAKE_PREFETCH_MAX_THREADS) {
+        ThreadCount = MAKE_PREFETCH_MAX_THREADS;
+    }
+
+    MakeContext->PrefetchRequests = YoriLibAllocateHashTable(250);
+    if (MakeContext->PrefetchRequests == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitializeListHead(&MakeContext->PrefetchList);
+    YoriLibInitializeListHead(&MakeContext->PrefetchQueue);
+
+    MakeContext->PrefetchMutex = CreateMutex(NULL, FALSE, NULL);
+    if (MakeContext->PrefetchMutex == NULL) {
+        MakePrefetchCleanup(MakeContext);
+        return FALSE;
+    }
+
+    MakeContext->PrefetchSemaphore = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+    if (MakeContext->PrefetchSemaphore == NULL) {
+        MakePrefetchCleanup(MakeContext);
+        return FALSE;
+    }
+
+    MakeContext->PrefetchThreads = YoriLibMalloc(ThreadCount * sizeof(HANDLE));
+    if (MakeContext->PrefetchThreads == NULL) {
+        MakePrefetchCleanup(MakeContext);
+        return FALSE;
+    }
+
+    for (Index = 0; Index < ThreadCount; Index++) {
+        MakeContext->PrefetchThreads[MakeContext->PrefetchThreadCount] = CreateThread(NULL, 0, MakePrefetchThread, MakeContext, 0, &ThreadId);
+        if (MakeContext->PrefetchThreads[MakeContext->PrefetchThreadCount] != NULL) {
+            MakeContext->PrefetchThreadCount++;
+        }
+    }
+
+    if (MakeContext->PrefetchThreadCount == 0) {
+        MakePrefetchCleanup(MakeContext);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Free a prefetch request.  The request must not be on the queue or being
+ processed by a prefetch thread.
+
+ @param Entry Pointer to the request to free.
+ */
+VOID
+MakePrefetchFreeEntry(
+    __in PMAKE_PREFETCH_ENTRY Entry
+    )
+{
+    ASSERT(!Entry->Queued);
+    YoriLibRemoveListItem(&Entry->ListEntry);
+    YoriLibHashRemoveByEntry(&Entry->HashEntry);
+    CloseHandle(Entry->CompleteEvent);
+    YoriLibFree(Entry);
+}
+
+/**
+ Terminate the prefetch threads and free any outstanding requests.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakePrefetchCleanup(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_PREFETCH_ENTRY Entry;
+    DWORD Index;
+
+    if (MakeContext->PrefetchThreadCount > 0) {
+        WaitForSingleObject(MakeContext->PrefetchMutex, INFINITE);
+        MakeContext->PrefetchShutdown = TRUE;
+        ReleaseMutex(MakeContext->PrefetchMutex);
+
+        ReleaseSemaphore(MakeContext->PrefetchSemaphore, MakeContext->PrefetchThreadCount, NULL);
+        for (Index = 0; Index < MakeContext->PrefetchThreadCount; Index++) {
+            WaitForSingleObject(MakeContext->PrefetchThreads[Index], INFINITE);
+            CloseHandle(MakeContext->PrefetchThreads[Index]);
+        }
+        MakeContext->PrefetchThreadCount = 0;
+    }
+
+    if (MakeContext->PrefetchThreads != NULL) {
+        YoriLibFree(MakeContext->PrefetchThreads);
+        MakeContext->PrefetchThreads = NULL;
+    }
+
+    //
+    //  With the threads gone, anything still queued can be torn down
+    //  directly.
+    //
+
+    if (MakeContext->PrefetchRequests != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->PrefetchList, NULL);
+        while (ListEntry != NULL) {
+            Entry = CONTAINING_RECORD(ListEntry, MAKE_PREFETCH_ENTRY, ListEntry);
+            ListEntry = YoriLibGetNextListEntry(&MakeContext->PrefetchList, ListEntry);
+            if (Entry->Queued) {
+                YoriLibRemoveListItem(&Entry->QueueEntry);
+                Entry->Queued = FALSE;
+            }
+            MakePrefetchFreeEntry(Entry);
+        }
+        YoriLibFreeEmptyHashTable(MakeContext->PrefetchRequests);
+        MakeContext->PrefetchRequests = NULL;
+    }
+
+    if (MakeContext->PrefetchSemaphore != NULL) {
+        CloseHandle(MakeContext->PrefetchSemaphore);
+        MakeContext->PrefetchSemaphore = NULL;
+    }
+
+    if (MakeContext->PrefetchMutex != NULL) {
+        CloseHandle(MakeContext->PrefetchMutex);
+        MakeContext->PrefetchMutex = NULL;
+    }
+}
+
+/**
+ Queue a request to prefetch the makefile in a subdirectory of the active
+ scope.  If the subdirectory has already been parsed or requested, this
+ function does nothing.
+
+ @param MakeContext Pointer to the context.
+
+ @param DirName Pointer to the directory name, relative to the active scope.
+ */
+VOID
+MakePrefetchQueueDirectory(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING DirName
+    )
+{
+    PMAKE_PREFETCH_ENTRY Entry;
+    YORI_STRING FullDir;
+
+    YoriLibInitEmptyString(&FullDir);
+    YoriLibYPrintf(&FullDir, _T("%y\\%y"), &MakeContext->ActiveScope->HashEntry.Key, DirName);
+    if (FullDir.StartOfString == NULL) {
+        return;
+    }
+
+    if (YoriLibHashLookupByKey(MakeContext->Scopes, &FullDir) != NULL ||
+        YoriLibHashLookupByKey(MakeContext->PrefetchRequests, &FullDir) != NULL) {
+
+        YoriLibFreeStringContents(&FullDir);
+        return;
+    }
+
+    Entry = YoriLibMalloc(sizeof(MAKE_PREFETCH_ENTRY));
+    if (Entry == NULL) {
+        YoriLibFreeStringContents(&FullDir);
+        return;
+    }
+
+    ZeroMemory(Entry, sizeof(MAKE_PREFETCH_ENTRY));
+    Entry->CompleteEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Entry->CompleteEvent == NULL) {
+        YoriLibFree(Entry);
+        YoriLibFreeStringContents(&FullDir);
+        return;
+    }
+
+    YoriLibHashInsertByKey(MakeContext->PrefetchRequests, &FullDir, Entry, &Entry->HashEntry);
+    YoriLibAppendList(&MakeContext->PrefetchList, &Entry->ListEntry);
+    YoriLibFreeStringContents(&FullDir);
+
+    WaitForSingleObject(MakeContext->PrefetchMutex, INFINITE);
+    YoriLibAppendList(&MakeContext->PrefetchQueue, &Entry->QueueEntry);
+    Entry->Queued = TRUE;
+    ReleaseMutex(MakeContext->PrefetchMutex);
+
+    ReleaseSemaphore(MakeContext->PrefetchSemaphore, 1, NULL);
+}
+
+/**
+ Queue prefetch requests for each subdirectory named in the dependencies of
+ a rule.  The list is split on whitespace outside of quotes in the same way
+ as the rule parser.  Because this is only a hint, failures are ignored.
+
+ @param MakeContext Pointer to the context.
+
+ @param DirList Pointer to the list of subdirectories, relative to the
+        active scope.
+ */
+VOID
+MakePrefetchSubdirectories(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING DirList
+    )
+{
+    YORI_STRING DirName;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Start;
+    BOOLEAN QuoteOpen;
+    TCHAR Char;
+
+    if (MakeContext->PrefetchRequests == NULL) {
+        if (MakeContext->PrefetchUnavailable) {
+            return;
+        }
+        if (!MakePrefetchInitialize(MakeContext)) {
+            MakeContext->PrefetchUnavailable = TRUE;
+            return;
+        }
+    }
+
+    YoriLibInitEmptyString(&DirName);
+    QuoteOpen = FALSE;
+    Start = 0;
+    for (Index = 0; Index <= DirList->LengthInChars; Index++) {
+        Char = '\0';
+        if (Index < DirList->LengthInChars) {
+            Char = DirList->StartOfString[Index];
+            if (Char == '"') {
+                QuoteOpen = (BOOLEAN)!QuoteOpen;
+            }
+            if (QuoteOpen || (Char != ' ' && Char != '\t')) {
+                continue;
+            }
+        }
+
+        DirName.StartOfString = &DirList->StartOfString[Start];
+        DirName.LengthInChars = Index - Start;
+        Start = Index + 1;
+
+        if (DirName.LengthInChars >= 3 &&
+            DirName.StartOfString[0] == '"' &&
+            DirName.StartOfString[DirName.LengthInChars - 1] == '"') {
+
+            DirName.StartOfString++;
+            DirName.LengthInChars = DirName.LengthInChars - 2;
+        }
+
+        if (DirName.LengthInChars > 0) {
+            MakePrefetchQueueDirectory(MakeContext, &DirName);
+        }
+    }
+}
+
+/**
+ Indicate that the main thread is about to parse the makefile in the active
+ scope.  If a prefetch was requested for it, this waits for any prefetch in
+ progress to complete, or cancels it if it has not started, so that the main
+ thread never reads the file concurrently with a prefetch thread.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakePrefetchComplete(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PMAKE_PREFETCH_ENTRY Entry;
+    BOOLEAN Wait;
+
+    if (MakeContext->PrefetchRequests == NULL) {
+        return;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(MakeContext->PrefetchRequests, &MakeContext->ActiveScope->HashEntry.Key);
+    if (HashEntry == NULL) {
+        return;
+    }
+
+    Entry = HashEntry->Context;
+
+    WaitForSingleObject(MakeContext->PrefetchMutex, INFINITE);
+    Wait = TRUE;
+    if (Entry->Queued) {
+        YoriLibRemoveListItem(&Entry->QueueEntry);
+        Entry->Queued = FALSE;
+        Wait = FALSE;
+    }
+    ReleaseMutex(MakeContext->PrefetchMutex);
+
+    if (Wait) {
+        WaitForSingleObject(Entry->CompleteEvent, INFINITE);
+    }
+
+    MakePrefetchFreeEntry(Entry);
+}
+
+// vim:sw=4:ts=4:et:
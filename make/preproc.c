@@ -796,6 +796,7 @@ MakeLoadPreprocessorCacheEntries(
         YoriLibHashInsertByKey(MakeContext->PreprocessorCache, &Key, Entry, &Entry->HashEntry);
 
         YoriLibAppendList(&MakeContext->PreprocessorCacheList, &Entry->ListEntry);
+        MakeContext->PreprocessorCacheLoaded = TRUE;
 
         YoriLibFreeStringContents(&Key);
     }
@@ -1023,6 +1024,451 @@ MakeAddToPreprocessorCache(
     YoriLibFreeStringContents(&Key);
 }
 
+/**
+ Free a speculative preprocessor command.  If the command has been launched,
+ this waits for it to complete.
+
+ @param MakeContext Pointer to the context.
+
+ @param Entry Pointer to the speculative command to free.
+
+ @param ExitCode Optionally points to a DWORD to receive the exit code of the
+        command.  This is only updated if the command was launched.
+ */
+VOID
+MakeFreeSpeculativeCommand(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PMAKE_PREPROC_SPECULATIVE_ENTRY Entry,
+    __out_opt PDWORD ExitCode
+    )
+{
+    PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext;
+
+    if (Entry->Launched) {
+        ExecContext = Entry->ExecPlan.FirstCmd;
+        WaitForSingleObject(ExecContext->hProcess, INFINITE);
+        if (ExitCode != NULL) {
+            GetExitCodeProcess(ExecContext->hProcess, ExitCode);
+        }
+        ASSERT(MakeContext->SpeculativeCommandsLaunched > 0);
+        MakeContext->SpeculativeCommandsLaunched--;
+    }
+
+    YoriLibRemoveListItem(&Entry->ListEntry);
+    YoriLibHashRemoveByEntry(&Entry->HashEntry);
+    YoriLibShFreeExecPlan(&Entry->ExecPlan);
+    YoriLibShFreeCmdContext(&Entry->CmdContext);
+    YoriLibFree(Entry);
+}
+
+/**
+ Launch speculative preprocessor commands, in the order they were found,
+ until the number of commands executing reaches the number of child
+ processes the user allowed.  Processes are launched from this thread
+ because launching alters process wide state for redirection, but they are
+ not waited for until the parser needs their result.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeLaunchSpeculativeCommands(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIST_ENTRY NextEntry;
+    PMAKE_PREPROC_SPECULATIVE_ENTRY Entry;
+    PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext;
+    YORI_STRING FoundInPath;
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->SpeculativeCommandList, NULL);
+    while (ListEntry != NULL && MakeContext->SpeculativeCommandsLaunched < MakeContext->NumberProcesses) {
+        NextEntry = YoriLibGetNextListEntry(&MakeContext->SpeculativeCommandList, ListEntry);
+        Entry = CONTAINING_RECORD(ListEntry, MAKE_PREPROC_SPECULATIVE_ENTRY, ListEntry);
+        if (!Entry->Launched) {
+
+            //
+            //  If the program can't be found or launched, discard the entry
+            //  and let the parser execute it normally, so any error is
+            //  reported at the point it would have been without speculation.
+            //
+
+            ExecContext = Entry->ExecPlan.FirstCmd;
+            YoriLibInitEmptyString(&FoundInPath);
+            if (!YoriLibLocateExecutableInPath(&ExecContext->CmdToExec.ArgV[0], NULL, NULL, &FoundInPath) ||
+                FoundInPath.LengthInChars == 0) {
+
+                YoriLibFreeStringContents(&FoundInPath);
+                MakeFreeSpeculativeCommand(MakeContext, Entry, NULL);
+            } else {
+                YoriLibFreeStringContents(&ExecContext->CmdToExec.ArgV[0]);
+                memcpy(&ExecContext->CmdToExec.ArgV[0], &FoundInPath, sizeof(YORI_STRING));
+                ExecContext->WaitForCompletion = FALSE;
+
+                if (YoriLibShCreateProcess(ExecContext, NULL, NULL) != NO_ERROR) {
+                    YoriLibShCleanupFailedProcessLaunch(ExecContext);
+                    MakeFreeSpeculativeCommand(MakeContext, Entry, NULL);
+                } else {
+                    YoriLibShCommenceProcessBuffersIfNeeded(ExecContext);
+                    Entry->Launched = TRUE;
+                    MakeContext->SpeculativeCommandsLaunched++;
+                }
+            }
+        }
+        ListEntry = NextEntry;
+    }
+}
+
+/**
+ Record a preprocessor command that may be needed by the parser later.
+ Only commands that invoke a single external program without buffering its
+ output are recorded, since builtins execute on this thread and cannot run
+ concurrently with the parser.
+
+ @param MakeContext Pointer to the context.
+
+ @param StreamId Identifies the makefile scan that found this command.
+
+ @param Cmd Pointer to the command, after variable expansion.
+ */
+VOID
+MakeAddSpeculativeCommand(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in DWORD StreamId,
+    __in PYORI_STRING Cmd
+    )
+{
+    PMAKE_PREPROC_SPECULATIVE_ENTRY Entry;
+    PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext;
+    YORI_STRING Key;
+
+    if (YoriLibHashLookupByKey(MakeContext->SpeculativeCommands, Cmd) != NULL) {
+        return;
+    }
+
+    Entry = YoriLibMalloc(sizeof(MAKE_PREPROC_SPECULATIVE_ENTRY));
+    if (Entry == NULL) {
+        return;
+    }
+
+    ZeroMemory(Entry, sizeof(MAKE_PREPROC_SPECULATIVE_ENTRY));
+    Entry->StreamId = StreamId;
+
+    if (!YoriLibShParseCmdlineToCmdContext(Cmd, 0, &Entry->CmdContext)) {
+        YoriLibFree(Entry);
+        return;
+    }
+
+    if (!YoriLibShParseCmdContextToExecPlan(&Entry->CmdContext, &Entry->ExecPlan, NULL, NULL, NULL, NULL)) {
+        YoriLibShFreeCmdContext(&Entry->CmdContext);
+        YoriLibFree(Entry);
+        return;
+    }
+
+    ExecContext = Entry->ExecPlan.FirstCmd;
+    if (ExecContext == NULL ||
+        ExecContext->NextProgram != NULL ||
+        ExecContext->CmdToExec.ArgC == 0 ||
+        ExecContext->StdOutType == StdOutTypeBuffer ||
+        ExecContext->StdOutType == StdOutTypePipe ||
+        ExecContext->StdErrType == StdErrTypeBuffer ||
+        YoriLibShLookupBuiltinByName(&ExecContext->CmdToExec.ArgV[0]) != NULL) {
+
+        YoriLibShFreeExecPlan(&Entry->ExecPlan);
+        YoriLibShFreeCmdContext(&Entry->CmdContext);
+        YoriLibFree(Entry);
+        return;
+    }
+
+    //
+    //  The command is a substring of a line that will be reused, so copy it
+    //  so the hash package has an allocation that won't go away
+    //
+
+    if (!YoriLibAllocateString(&Key, Cmd->LengthInChars)) {
+        YoriLibShFreeExecPlan(&Entry->ExecPlan);
+        YoriLibShFreeCmdContext(&Entry->CmdContext);
+        YoriLibFree(Entry);
+        return;
+    }
+
+    memcpy(Key.StartOfString, Cmd->StartOfString, Cmd->LengthInChars * sizeof(TCHAR));
+    Key.LengthInChars = Cmd->LengthInChars;
+
+    YoriLibHashInsertByKey(MakeContext->SpeculativeCommands, &Key, Entry, &Entry->HashEntry);
+    YoriLibAppendList(&MakeContext->SpeculativeCommandList, &Entry->ListEntry);
+    YoriLibFreeStringContents(&Key);
+}
+
+/**
+ Scan a makefile for preprocessor conditions that execute commands, and
+ start executing those commands concurrently.  Variables are expanded with
+ the state at the beginning of the makefile; if the parser later evaluates a
+ different command, the speculative result is not used.
+
+ @param ScopeContext Pointer to the scope context that will process the
+        makefile.
+
+ @param FileName Pointer to the file name of the makefile.
+
+ @return An identifier for this scan, to be passed to
+         MakeEndSpeculativeCommands when the makefile has been processed.
+         Zero indicates no scan was performed.
+ */
+DWORD
+MakeBeginSpeculativeCommands(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext,
+    __in PYORI_STRING FileName
+    )
+{
+    PMAKE_CONTEXT MakeContext;
+    PVOID LineContext = NULL;
+    YORI_STRING JoinedLine;
+    YORI_STRING LineString;
+    YORI_STRING LineToProcess;
+    YORI_STRING ExpandedLine;
+    YORI_STRING VariableNotFound;
+    YORI_STRING Cmd;
+    MAKE_PREPROCESSOR_LINE_TYPE LineType;
+    BOOLEAN MoreLinesNeeded;
+    BOOLEAN QuoteOpen;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T StartIndex;
+    HANDLE hSource;
+    DWORD StreamId;
+
+    MakeContext = ScopeContext->MakeContext;
+
+    if (MakeContext->SpeculativeCommands == NULL ||
+        MakeContext->PreprocessorCacheLoaded ||
+        FileName->LengthInChars == 0) {
+
+        return 0;
+    }
+
+    hSource = CreateFile(FileName->StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+    if (hSource == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    MakeContext->NextSpeculativeStreamId++;
+    StreamId = MakeContext->NextSpeculativeStreamId;
+
+    YoriLibInitEmptyString(&LineString);
+    YoriLibInitEmptyString(&JoinedLine);
+    YoriLibInitEmptyString(&LineToProcess);
+    YoriLibInitEmptyString(&ExpandedLine);
+
+    while (TRUE) {
+
+        if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
+            break;
+        }
+
+        LineToProcess.StartOfString = LineString.StartOfString;
+        LineToProcess.LengthInChars = LineString.LengthInChars;
+        MakeTruncateComments(&LineToProcess);
+
+        MoreLinesNeeded = FALSE;
+
+        if (LineToProcess.LengthInChars > 0 && LineToProcess.StartOfString[LineToProcess.LengthInChars - 1] == '\\') {
+            MoreLinesNeeded = TRUE;
+        }
+
+        if (JoinedLine.LengthInChars > 0 || MoreLinesNeeded) {
+            MakeTrimWhitespace(&LineToProcess);
+            MakeJoinLines(&JoinedLine, &LineToProcess);
+            if (MoreLinesNeeded) {
+                continue;
+            }
+            LineToProcess.StartOfString = JoinedLine.StartOfString;
+            LineToProcess.LengthInChars = JoinedLine.LengthInChars;
+        }
+
+        JoinedLine.LengthInChars = 0;
+
+        if (LineToProcess.LengthInChars == 0 || LineToProcess.StartOfString[0] != '!') {
+            continue;
+        }
+
+        MakeTrimWhitespace(&LineToProcess);
+        LineType = MakeDeterminePreprocessorLineType(&LineToProcess, NULL);
+        if (LineType != MakePreprocessorLineTypeIf &&
+            LineType != MakePreprocessorLineTypeElseIf) {
+
+            continue;
+        }
+
+        //
+        //  If a variable isn't defined yet, it may be defined before the
+        //  parser reaches this line, so don't guess.
+        //
+
+        YoriLibInitEmptyString(&VariableNotFound);
+        if (!MakeExpandVariables(ScopeContext, NULL, &ExpandedLine, &LineToProcess, &VariableNotFound) ||
+            VariableNotFound.LengthInChars > 0) {
+
+            continue;
+        }
+
+        //
+        //  Find each bracketed command in the condition.
+        //
+
+        for (Index = 0; Index < ExpandedLine.LengthInChars; Index++) {
+            if (ExpandedLine.StartOfString[Index] != '[') {
+                continue;
+            }
+
+            QuoteOpen = FALSE;
+            StartIndex = Index + 1;
+            for (Index = StartIndex; Index < ExpandedLine.LengthInChars; Index++) {
+                if (ExpandedLine.StartOfString[Index] == '"') {
+                    QuoteOpen = (BOOLEAN)!QuoteOpen;
+                } else if (ExpandedLine.StartOfString[Index] == ']' && !QuoteOpen) {
+                    break;
+                }
+            }
+
+            if (Index < ExpandedLine.LengthInChars && Index > StartIndex) {
+                YoriLibInitEmptyString(&Cmd);
+                Cmd.StartOfString = &ExpandedLine.StartOfString[StartIndex];
+                Cmd.LengthInChars = Index - StartIndex;
+                MakeAddSpeculativeCommand(MakeContext, StreamId, &Cmd);
+            }
+        }
+    }
+
+    YoriLibLineReadCloseOrCache(LineContext);
+    YoriLibFreeStringContents(&LineString);
+    YoriLibFreeStringContents(&JoinedLine);
+    YoriLibFreeStringContents(&ExpandedLine);
+    CloseHandle(hSource);
+
+    MakeLaunchSpeculativeCommands(MakeContext);
+
+    return StreamId;
+}
+
+/**
+ Discard any speculative commands found when scanning a makefile that has
+ now been fully processed, waiting for any that are still executing.  This
+ allows commands found in other makefiles to be launched.
+
+ @param MakeContext Pointer to the context.
+
+ @param StreamId The identifier returned from MakeBeginSpeculativeCommands.
+ */
+VOID
+MakeEndSpeculativeCommands(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in DWORD StreamId
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIST_ENTRY NextEntry;
+    PMAKE_PREPROC_SPECULATIVE_ENTRY Entry;
+
+    if (StreamId == 0) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->SpeculativeCommandList, NULL);
+    while (ListEntry != NULL) {
+        NextEntry = YoriLibGetNextListEntry(&MakeContext->SpeculativeCommandList, ListEntry);
+        Entry = CONTAINING_RECORD(ListEntry, MAKE_PREPROC_SPECULATIVE_ENTRY, ListEntry);
+        if (Entry->StreamId == StreamId) {
+            MakeFreeSpeculativeCommand(MakeContext, Entry, NULL);
+        }
+        ListEntry = NextEntry;
+    }
+
+    MakeLaunchSpeculativeCommands(MakeContext);
+}
+
+/**
+ Free all speculative preprocessor commands, waiting for any that are still
+ executing.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeDeleteAllSpeculativeCommands(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_PREPROC_SPECULATIVE_ENTRY Entry;
+
+    if (MakeContext->SpeculativeCommands == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->SpeculativeCommandList, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, MAKE_PREPROC_SPECULATIVE_ENTRY, ListEntry);
+        MakeFreeSpeculativeCommand(MakeContext, Entry, NULL);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->SpeculativeCommandList, NULL);
+    }
+    YoriLibFreeEmptyHashTable(MakeContext->SpeculativeCommands);
+    MakeContext->SpeculativeCommands = NULL;
+}
+
+/**
+ Check whether a preprocessor command was executed speculatively, and if so,
+ wait for it to complete and return its result.  Any earlier command from
+ the same makefile that is still pending was not needed by the parser, so
+ it is discarded to allow later commands to be launched.
+
+ @param MakeContext Pointer to the context.
+
+ @param Cmd Pointer to the command to execute.
+
+ @param ExitCode On successful completion, updated to contain the exit code
+        of the command.
+
+ @return TRUE if the command was executed speculatively and ExitCode is
+         valid, FALSE if the command should be executed normally.
+ */
+__success(return)
+BOOLEAN
+MakeCompleteSpeculativeCommand(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING Cmd,
+    __out PDWORD ExitCode
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIST_ENTRY NextEntry;
+    PMAKE_PREPROC_SPECULATIVE_ENTRY Entry;
+    PMAKE_PREPROC_SPECULATIVE_ENTRY EarlierEntry;
+    BOOLEAN Result;
+
+    HashEntry = YoriLibHashLookupByKey(MakeContext->SpeculativeCommands, Cmd);
+    if (HashEntry == NULL) {
+        return FALSE;
+    }
+
+    Entry = CONTAINING_RECORD(HashEntry, MAKE_PREPROC_SPECULATIVE_ENTRY, HashEntry);
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->SpeculativeCommandList, NULL);
+    while (ListEntry != &Entry->ListEntry) {
+        NextEntry = YoriLibGetNextListEntry(&MakeContext->SpeculativeCommandList, ListEntry);
+        EarlierEntry = CONTAINING_RECORD(ListEntry, MAKE_PREPROC_SPECULATIVE_ENTRY, ListEntry);
+        if (EarlierEntry->StreamId == Entry->StreamId) {
+            MakeFreeSpeculativeCommand(MakeContext, EarlierEntry, NULL);
+        }
+        ListEntry = NextEntry;
+    }
+
+    Result = Entry->Launched;
+    MakeFreeSpeculativeCommand(MakeContext, Entry, ExitCode);
+    MakeLaunchSpeculativeCommands(MakeContext);
+
+    return Result;
+}
+
 /**
  Execute a subcommand and capture the result.  Currently this is used to
  evaluate preprocessor if statements only.
@@ -1067,6 +1513,12 @@ MakeExecuteCommandCaptureExitCode(
         }
     }
 
+    if (ScopeContext->MakeContext->SpeculativeCommands != NULL &&
+        MakeCompleteSpeculativeCommand(ScopeContext->MakeContext, Cmd, &ExitCode)) {
+
+        goto CacheResult;
+    }
+
     if (!YoriLibShParseCmdlineToCmdContext(Cmd, 0, &CmdContext)) {
         goto Complete;
     }
@@ -1081,6 +1533,8 @@ MakeExecuteCommandCaptureExitCode(
     YoriLibShFreeExecPlan(&ExecPlan);
     YoriLibShFreeCmdContext(&CmdContext);
 
+CacheResult:
+
     if (ScopeContext->MakeContext->PreprocessorCache != NULL) {
         MakeAddToPreprocessorCache(ScopeContext, Cmd, ExitCode);
     }
@@ -1089,6 +1543,7 @@ Complete:
 
     QueryPerformanceCounter(&EndTime);
     ScopeContext->MakeContext->TimeInPreprocessorCreateProcess = ScopeContext->MakeContext->TimeInPreprocessorCreateProcess + EndTime.QuadPart - StartTime.QuadPart;
+    MakeTraceCompleteEvent(ScopeContext->MakeContext, _T("preprocessor"), Cmd, 0, StartTime.QuadPart, EndTime.QuadPart, NULL, &ExitCode);
 #if MAKE_DEBUG_PREPROCESSOR_CREATEPROCESS
     YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("...took %lli\n"), EndTime.QuadPart - StartTime.QuadPart);
 #endif
@@ -1871,10 +2326,10 @@ CONST YORI_STRING MakefileNameCandidates[] = {
 };
 
 /**
- Find the first existing makefile in a directory specified by the scope
- context.
+ Find the first existing makefile in a directory.  This function does not
+ use any shared state so it can be called from any thread.
 
- @param ScopeContext Pointer to the scope context.
+ @param DirName Pointer to the full path to the directory.
 
  @param FileName On successful completion, populated with a newly allocated
         string indicating the full path name to the makefile.
@@ -1884,8 +2339,8 @@ CONST YORI_STRING MakefileNameCandidates[] = {
  */
 __success(return)
 BOOLEAN
-MakeFindMakefileInDirectory(
-    __in PMAKE_SCOPE_CONTEXT ScopeContext,
+MakeFindMakefileInDirectoryName(
+    __in PCYORI_STRING DirName,
     __out PYORI_STRING FileName
     )
 {
@@ -1900,12 +2355,12 @@ MakeFindMakefileInDirectory(
         }
     }
 
-    if (!YoriLibAllocateString(&ProbeName, ScopeContext->HashEntry.Key.LengthInChars + 1 + LongestName + 1)) {
+    if (!YoriLibAllocateString(&ProbeName, DirName->LengthInChars + 1 + LongestName + 1)) {
         return FALSE;
     }
 
     for (Index = 0; Index < sizeof(MakefileNameCandidates)/sizeof(MakefileNameCandidates[0]); Index++) {
-        ProbeName.LengthInChars = YoriLibSPrintf(ProbeName.StartOfString, _T("%y\\%y"), &ScopeContext->HashEntry.Key, &MakefileNameCandidates[Index]);
+        ProbeName.LengthInChars = YoriLibSPrintf(ProbeName.StartOfString, _T("%y\\%y"), DirName, &MakefileNameCandidates[Index]);
         if (GetFileAttributes(ProbeName.StartOfString) != (DWORD)-1) {
             memcpy(FileName, &ProbeName, sizeof(YORI_STRING));
             return TRUE;
@@ -1916,6 +2371,28 @@ MakeFindMakefileInDirectory(
     return FALSE;
 }
 
+/**
+ Find the first existing makefile in a directory specified by the scope
+ context.
+
+ @param ScopeContext Pointer to the scope context.
+
+ @param FileName On successful completion, populated with a newly allocated
+        string indicating the full path name to the makefile.
+
+ @return TRUE to indicate that a makefile was found, FALSE to indicate it was
+         not found or an error occurred.
+ */
+__success(return)
+BOOLEAN
+MakeFindMakefileInDirectory(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext,
+    __out PYORI_STRING FileName
+    )
+{
+    return MakeFindMakefileInDirectoryName(&ScopeContext->HashEntry.Key, FileName);
+}
+
 /**
  Parse extended information about a target.  These options are enclosed in
  square braces.
@@ -2181,6 +2658,8 @@ MakeCreateSubdirectoryDependency(
 
     if (!FoundExisting) {
 
+        MakePrefetchComplete(MakeContext);
+
         if (!MakeFindMakefileInDirectory(MakeContext->ActiveScope, &FullPath)) {
             YoriLibInitEmptyString(&FullPath);
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not find makefile in directory: %y\n"), &MakeContext->ActiveScope->HashEntry.Key);
@@ -2325,6 +2804,17 @@ MakeAddRule(
 
     MakeContext = ScopeContext->MakeContext;
 
+    //
+    //  If the dependencies are subdirectories, start reading their makefiles
+    //  in the background while they are parsed in order below.
+    //
+
+    if (Subdirectories && ReadIndex < Line->LengthInChars) {
+        Substring.StartOfString = &Line->StartOfString[ReadIndex];
+        Substring.LengthInChars = Line->LengthInChars - ReadIndex;
+        MakePrefetchSubdirectories(MakeContext, &Substring);
+    }
+
     SwallowingWhitespace = TRUE;
     QuoteOpen = FALSE;
     Substring.LengthInChars = 0;
@@ -2701,8 +3191,15 @@ MakeProcessStream(
     PMAKE_TARGET ActiveRecipeTarget = NULL;
     PMAKE_SCOPE_CONTEXT ScopeContext;
     DWORD LineNumber;
+    DWORD SpeculativeStreamId;
+    LARGE_INTEGER StartTime;
+    LARGE_INTEGER EndTime;
 
     ScopeContext = MakeContext->ActiveScope;
+    StartTime.QuadPart = 0;
+    if (MakeContext->TraceHandle != NULL) {
+        QueryPerformanceCounter(&StartTime);
+    }
 
     YoriLibInitEmptyString(&LineString);
     YoriLibInitEmptyString(&JoinedLine);
@@ -2714,6 +3211,8 @@ MakeProcessStream(
     YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Processing %y\n"), FileName);
 #endif
 
+    SpeculativeStreamId = MakeBeginSpeculativeCommands(ScopeContext, FileName);
+
     while (TRUE) {
 
         if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
@@ -2875,6 +3374,13 @@ MakeProcessStream(
         JoinedLine.LengthInChars = 0;
     }
 
+    MakeEndSpeculativeCommands(MakeContext, SpeculativeStreamId);
+
+    if (MakeContext->TraceHandle != NULL) {
+        QueryPerformanceCounter(&EndTime);
+        MakeTraceCompleteEvent(MakeContext, _T("parse"), FileName, 0, StartTime.QuadPart, EndTime.QuadPart, NULL, NULL);
+    }
+
     YoriLibLineReadCloseOrCache(LineContext);
     YoriLibFreeStringContents(&LineString);
     YoriLibFreeStringContents(&JoinedLine);
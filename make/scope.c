@@ -58,6 +58,7 @@ MakeAllocateNewScope(
     ScopeContext->PreviousScope = NULL;
     ScopeContext->MakeContext = MakeContext;
     ScopeContext->ReferenceCount = 2; // One for the caller, one for the hash
+    ScopeContext->ExpansionCache = NULL;
 
     ScopeContext->Variables = YoriLibAllocateHashTable(1000);
     if (ScopeContext->Variables == NULL) {
@@ -140,6 +141,7 @@ MakeDereferenceScope(
 
         YoriLibHashRemoveByEntry(&ScopeContext->HashEntry);
         YoriLibFreeStringContents(&ScopeContext->CurrentIncludeDirectory);
+        MakeDeleteExpansionCache(ScopeContext);
         MakeDeleteAllVariables(ScopeContext);
         if (ScopeContext->Variables != NULL) {
             YoriLibFreeEmptyHashTable(ScopeContext->Variables);
@@ -0,0 +1,367 @@
+/**
+ * @file make/statcache.c
+ *
+ * Yori shell make directory based file state cache
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yorish.h>
+#include "make.h"
+
+/**
+ Allocate the file state cache.  While the cache exists, queries for files
+ are answered by enumerating the directory containing the file once and
+ retaining the result for every other file in that directory.  Since the
+ result is not updated as files change, the cache should only exist while
+ nothing is modifying the tree.
+
+ @param MakeContext Pointer to the context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeStatCacheInitialize(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    ASSERT(MakeContext->StatCache == NULL);
+
+    MakeContext->StatCache = YoriLibAllocateHashTable(4000);
+    if (MakeContext->StatCache == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitializeListHead(&MakeContext->StatCacheList);
+    return TRUE;
+}
+
+/**
+ Free all entries in the file state cache and the cache itself.  Once this
+ has been called, queries go to the file system.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeStatCacheCleanup(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_STAT_CACHE_ENTRY Entry;
+
+    if (MakeContext->StatCache == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->StatCacheList, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, MAKE_STAT_CACHE_ENTRY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->StatCacheList, ListEntry);
+        YoriLibRemoveListItem(&Entry->ListEntry);
+        YoriLibHashRemoveByEntry(&Entry->HashEntry);
+        YoriLibFree(Entry);
+    }
+
+    YoriLibFreeEmptyHashTable(MakeContext->StatCache);
+    MakeContext->StatCache = NULL;
+}
+
+/**
+ Find an entry in the file state cache, creating an entry that describes a
+ file that does not exist if none is present.
+
+ @param MakeContext Pointer to the context.
+
+ @param FileName Pointer to the full path to the file.
+
+ @return Pointer to the entry, or NULL on allocation failure.
+ */
+PMAKE_STAT_CACHE_ENTRY
+MakeStatCacheLookupOrCreate(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING FileName
+    )
+{
+    PMAKE_STAT_CACHE_ENTRY Entry;
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_LIB_ATOM Atom;
+
+    HashEntry = YoriLibHashLookupByKey(MakeContext->StatCache, FileName);
+    if (HashEntry != NULL) {
+        return CONTAINING_RECORD(HashEntry, MAKE_STAT_CACHE_ENTRY, HashEntry);
+    }
+
+    //
+    //  The name is typically in a buffer that will be reused, so the key
+    //  needs its own allocation.  Most of these files are also targets, so
+    //  the name is interned to share it with the target.
+    //
+
+    Atom = YoriLibInternString(MakeContext->Atoms, FileName);
+    if (Atom == NULL) {
+        return NULL;
+    }
+
+    Entry = YoriLibMalloc(sizeof(MAKE_STAT_CACHE_ENTRY));
+    if (Entry == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Entry, sizeof(MAKE_STAT_CACHE_ENTRY));
+    Entry->FileAttributes = (DWORD)-1;
+    YoriLibHashInsertByKey(MakeContext->StatCache, &Atom->String, Entry, &Entry->HashEntry);
+    YoriLibAppendList(&MakeContext->StatCacheList, &Entry->ListEntry);
+
+    return Entry;
+}
+
+/**
+ Enumerate a directory and record the state of every object within it.
+
+ @param MakeContext Pointer to the context.
+
+ @param DirEntry Pointer to the cache entry describing the directory.  This
+        is updated to indicate the result of the enumerate.
+ */
+VOID
+MakeStatCacheEnumerateDirectory(
+    __in PMAKE_CONTEXT MakeContext,
+    __inout PMAKE_STAT_CACHE_ENTRY DirEntry
+    )
+{
+    YORI_STRING FileName;
+    YORI_STRING FindName;
+    PYORI_STRING DirName;
+    PMAKE_STAT_CACHE_ENTRY Entry;
+    WIN32_FIND_DATA FindData;
+    HANDLE hFind;
+    DWORD Err;
+
+    DirEntry->Enumerated = TRUE;
+    DirName = &DirEntry->HashEntry.Key;
+
+    if (!YoriLibAllocateString(&FileName, DirName->LengthInChars + MAX_PATH + 2)) {
+        DirEntry->EnumerateFailed = TRUE;
+        return;
+    }
+
+    FileName.LengthInChars = YoriLibSPrintf(FileName.StartOfString, _T("%y\\*"), DirName);
+
+    hFind = YoriLibFileEnumFindFirstFile(FileName.StartOfString, YORILIB_FILEENUM_BASIC_INFO, &FindData);
+    if (hFind == INVALID_HANDLE_VALUE) {
+
+        //
+        //  If the directory does not exist, nothing within it exists.  Any
+        //  other failure means the directory cannot answer queries, and
+        //  the caller should ask about each file individually.
+        //
+
+        Err = GetLastError();
+        if (Err != ERROR_FILE_NOT_FOUND && Err != ERROR_PATH_NOT_FOUND) {
+            DirEntry->EnumerateFailed = TRUE;
+        }
+        YoriLibFreeStringContents(&FileName);
+        return;
+    }
+
+    do {
+        YoriLibConstantString(&FindName, FindData.cFileName);
+        if (YoriLibCompareStringLit(&FindName, _T(".")) == 0 ||
+            YoriLibCompareStringLit(&FindName, _T("..")) == 0) {
+
+            continue;
+        }
+
+        FileName.LengthInChars = YoriLibSPrintf(FileName.StartOfString, _T("%y\\%y"), DirName, &FindName);
+        Entry = MakeStatCacheLookupOrCreate(MakeContext, &FileName);
+        if (Entry == NULL) {
+            DirEntry->EnumerateFailed = TRUE;
+            break;
+        }
+
+        Entry->FileAttributes = FindData.dwFileAttributes;
+        Entry->LastWriteTime.LowPart = FindData.ftLastWriteTime.dwLowDateTime;
+        Entry->LastWriteTime.HighPart = FindData.ftLastWriteTime.dwHighDateTime;
+
+    } while (FindNextFile(hFind, &FindData));
+
+    FindClose(hFind);
+    YoriLibFreeStringContents(&FileName);
+}
+
+/**
+ Query the attributes and last write time of a file from the file state
+ cache.  The first query for a file within a directory enumerates the
+ directory.
+
+ @param MakeContext Pointer to the context.
+
+ @param FileName Pointer to the full path to the file.
+
+ @param FileAttributes On successful completion, updated to contain the
+        attributes of the file, or (DWORD)-1 if the file does not exist.
+
+ @param LastWriteTime On successful completion, updated to contain the last
+        write time of the file.
+
+ @return TRUE to indicate the cache answered the query, FALSE to indicate
+         that the caller should query the file system directly.
+ */
+__success(return)
+BOOLEAN
+MakeStatCacheQueryFile(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PCYORI_STRING FileName,
+    __out PDWORD FileAttributes,
+    __out PLARGE_INTEGER LastWriteTime
+    )
+{
+    YORI_STRING DirName;
+    YORI_STRING BaseName;
+    PMAKE_STAT_CACHE_ENTRY DirEntry;
+    PMAKE_STAT_CACHE_ENTRY Entry;
+    PYORI_HASH_ENTRY HashEntry;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (MakeContext->StatCache == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  If the object was previously queried individually and found not to
+    //  exist, it still does not exist.
+    //
+
+    HashEntry = YoriLibHashLookupByKey(MakeContext->StatCache, (PYORI_STRING)FileName);
+    if (HashEntry != NULL) {
+        Entry = CONTAINING_RECORD(HashEntry, MAKE_STAT_CACHE_ENTRY, HashEntry);
+        if (Entry->NotFoundByQuery) {
+            *FileAttributes = (DWORD)-1;
+            LastWriteTime->QuadPart = 0;
+            return TRUE;
+        }
+    }
+
+    YoriLibInitEmptyString(&DirName);
+    YoriLibInitEmptyString(&BaseName);
+    for (Index = FileName->LengthInChars; Index > 0; Index--) {
+        if (YoriLibIsSep(FileName->StartOfString[Index - 1])) {
+            DirName.StartOfString = FileName->StartOfString;
+            DirName.LengthInChars = Index - 1;
+            BaseName.StartOfString = &FileName->StartOfString[Index];
+            BaseName.LengthInChars = FileName->LengthInChars - Index;
+            break;
+        }
+    }
+
+    //
+    //  The enumerate returns long names for objects without following
+    //  links, so anything that might refer to a short name, a stream, or a
+    //  relative component is left to the file system.
+    //
+
+    if (DirName.LengthInChars == 0 ||
+        BaseName.LengthInChars == 0 ||
+        YoriLibCompareStringLit(&BaseName, _T(".")) == 0 ||
+        YoriLibCompareStringLit(&BaseName, _T("..")) == 0 ||
+        YoriLibFindLeftMostCharacter(&BaseName, '~') != NULL ||
+        YoriLibFindLeftMostCharacter(&BaseName, ':') != NULL) {
+
+        return FALSE;
+    }
+
+    DirEntry = MakeStatCacheLookupOrCreate(MakeContext, &DirName);
+    if (DirEntry == NULL) {
+        return FALSE;
+    }
+
+    if (!DirEntry->Enumerated) {
+        MakeStatCacheEnumerateDirectory(MakeContext, DirEntry);
+    }
+
+    if (DirEntry->EnumerateFailed) {
+        return FALSE;
+    }
+
+    //
+    //  The directory has been enumerated, so anything that is not in the
+    //  cache does not exist.  Inference rule probing asks about many files
+    //  that do not exist, so these are answered without allocating an
+    //  entry for each.
+    //
+
+    if (HashEntry == NULL) {
+        HashEntry = YoriLibHashLookupByKey(MakeContext->StatCache, (PYORI_STRING)FileName);
+    }
+    if (HashEntry == NULL) {
+        *FileAttributes = (DWORD)-1;
+        LastWriteTime->QuadPart = 0;
+        return TRUE;
+    }
+
+    Entry = CONTAINING_RECORD(HashEntry, MAKE_STAT_CACHE_ENTRY, HashEntry);
+    if (Entry->FileAttributes != (DWORD)-1 &&
+        (Entry->FileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0) {
+
+        return FALSE;
+    }
+
+    *FileAttributes = Entry->FileAttributes;
+    LastWriteTime->QuadPart = Entry->LastWriteTime.QuadPart;
+    return TRUE;
+}
+
+/**
+ Record that an object which the cache could not answer a query for was
+ queried individually and found not to exist.  Later queries for the same
+ object are answered from the cache.
+
+ @param MakeContext Pointer to the context.
+
+ @param FileName Pointer to the full path to the file.
+ */
+VOID
+MakeStatCacheRecordNotFound(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PCYORI_STRING FileName
+    )
+{
+    PMAKE_STAT_CACHE_ENTRY Entry;
+
+    if (MakeContext->StatCache == NULL) {
+        return;
+    }
+
+    Entry = MakeStatCacheLookupOrCreate(MakeContext, (PYORI_STRING)FileName);
+    if (Entry == NULL) {
+        return;
+    }
+
+    if (Entry->FileAttributes == (DWORD)-1 && !Entry->Enumerated) {
+        Entry->NotFoundByQuery = TRUE;
+    }
+}
+
+// vim:sw=4:ts=4:et:
@@ -3,7 +3,7 @@
  *
  * Yori shell make target support
  *
- * Copyright (c) 2020 Malcolm J. Smith
+ * Copyright (c) 2020-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -94,7 +94,7 @@ MakeDeactivateTarget(
     ASSERT(YoriLibIsListEmpty(&Target->ChildDependents));
 
     YoriLibRemoveListItem(&Target->ListEntry);
-    YoriLibHashRemoveByEntry(&Target->HashEntry);
+    YoriLibOpenHashRemoveByEntry(&Target->HashEntry);
     MakeDereferenceTarget(Target);
 }
 
@@ -162,15 +162,20 @@ MakeDeleteAllTargets(
  Open the target and query its timestamp.  The target may not exist (implying
  it needs to be rebuilt.)
 
+ @param MakeContext Pointer to the context.
+
  @param Target Pointer to the target to query.
  */
 VOID
 MakeProbeTargetFile(
+    __in PMAKE_CONTEXT MakeContext,
     __in PMAKE_TARGET Target
     )
 {
     HANDLE FileHandle;
     BY_HANDLE_FILE_INFORMATION FileInfo;
+    DWORD FileAttributes;
+    LARGE_INTEGER LastWriteTime;
 
     if (Target->FileProbed) {
         return;
@@ -178,6 +183,25 @@ MakeProbeTargetFile(
 
     ASSERT(!Target->FileExists);
 
+    //
+    //  If the directory state is cached, answer from the cache.  This
+    //  enumerates each directory once rather than opening every target.
+    //
+
+    if (MakeStatCacheQueryFile(MakeContext, &Target->HashEntry.Key, &FileAttributes, &LastWriteTime)) {
+        if (FileAttributes != (DWORD)-1) {
+            Target->FileExists = TRUE;
+            if (FileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                Target->ModifiedTime.LowPart = 0;
+                Target->ModifiedTime.HighPart = 0;
+            } else {
+                Target->ModifiedTime.QuadPart = LastWriteTime.QuadPart;
+            }
+        }
+        Target->FileProbed = TRUE;
+        return;
+    }
+
     //
     //  Check if the object already exists, and if so, when it was last
     //  modified.  Normally this would only need FILE_READ_ATTRIBUTES,
@@ -220,6 +244,40 @@ MakeProbeTargetFile(
     Target->FileProbed = TRUE;
 }
 
+/**
+ Check whether a file exists, using the directory state cache if it is
+ available.
+
+ @param MakeContext Pointer to the context.
+
+ @param FileName Pointer to the NULL terminated full path to the file.
+
+ @return TRUE if the file exists, FALSE if it does not.
+ */
+BOOLEAN
+MakeProbeFileExists(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING FileName
+    )
+{
+    DWORD FileAttributes;
+    LARGE_INTEGER LastWriteTime;
+
+    if (!MakeStatCacheQueryFile(MakeContext, FileName, &FileAttributes, &LastWriteTime)) {
+        ASSERT(YoriLibIsStringNullTerminated(FileName));
+        FileAttributes = GetFileAttributes(FileName->StartOfString);
+        if (FileAttributes == (DWORD)-1) {
+            MakeStatCacheRecordNotFound(MakeContext, FileName);
+        }
+    }
+
+    if (FileAttributes == (DWORD)-1) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  Resolve a user specified target name, as it might appear in a makefile, into
  one that contains a full path.
@@ -280,7 +338,7 @@ MakeLookupTarget(
     YORI_STRING FullPath;
     YORI_STRING TargetNoQuotes;
     PMAKE_TARGET Target;
-    PYORI_HASH_ENTRY HashEntry;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
     PMAKE_CONTEXT MakeContext;
 
     if (!MakeResolveFullTargetName(ScopeContext, TargetName, &TargetNoQuotes, &FullPath)) {
@@ -289,7 +347,7 @@ MakeLookupTarget(
 
     MakeContext = ScopeContext->MakeContext;
 
-    HashEntry = YoriLibHashLookupByKey(MakeContext->Targets, &FullPath);
+    HashEntry = YoriLibOpenHashLookupByKey(MakeContext->Targets, &FullPath);
     YoriLibFreeStringContents(&FullPath);
     if (HashEntry != NULL) {
         Target = HashEntry->Context;
@@ -324,8 +382,9 @@ MakeLookupOrCreateTarget(
     YORI_STRING FullPath;
     YORI_STRING TargetNoQuotes;
     PMAKE_TARGET Target;
-    PYORI_HASH_ENTRY HashEntry;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
     PMAKE_CONTEXT MakeContext;
+    PYORI_LIB_ATOM Atom;
 
     if (!MakeResolveFullTargetName(ScopeContext, TargetName, &TargetNoQuotes, &FullPath)) {
         return FALSE;
@@ -333,15 +392,25 @@ MakeLookupOrCreateTarget(
 
     MakeContext = ScopeContext->MakeContext;
 
-    HashEntry = YoriLibHashLookupByKey(MakeContext->Targets, &FullPath);
+    HashEntry = YoriLibOpenHashLookupByKey(MakeContext->Targets, &FullPath);
     if (HashEntry != NULL) {
         Target = HashEntry->Context;
         YoriLibFreeStringContents(&FullPath);
     } else {
 
+        //
+        //  The file state cache refers to the same paths, so intern the
+        //  name to share one allocation between them.
+        //
+
+        Atom = YoriLibInternString(MakeContext->Atoms, &FullPath);
+        YoriLibFreeStringContents(&FullPath);
+        if (Atom == NULL) {
+            return NULL;
+        }
+
         Target = MakeSlabAlloc(&ScopeContext->MakeContext->TargetAllocator, sizeof(MAKE_TARGET));
         if (Target == NULL) {
-            YoriLibFreeStringContents(&FullPath);
             return NULL;
         }
         ScopeContext->MakeContext->AllocTarget++;
@@ -363,15 +432,22 @@ MakeLookupOrCreateTarget(
         Target->DependenciesEvaluated = FALSE;
         Target->EvaluatingDependencies = FALSE;
         Target->InferenceRulePseudoTarget = FALSE;
+        Target->ContentHashed = FALSE;
+        Target->BuildDbInputHashCalculated = FALSE;
+        Target->CriticalPathCalculated = FALSE;
+        Target->ContentHash = 0;
+        Target->BuildDbInputHash = 0;
+        Target->CriticalPathCost = 0;
         Target->ModifiedTime.QuadPart = 0;
         Target->InferenceRule = NULL;
         Target->InferenceRuleParentTarget = NULL;
         YoriLibInitEmptyString(&Target->Recipe);
         YoriLibInitializeListHead(&Target->ExecCmds);
-        YoriLibHashInsertByKey(MakeContext->Targets, &FullPath, Target, &Target->HashEntry);
+        if (!YoriLibOpenHashInsertByKey(MakeContext->Targets, &Atom->String, Target, &Target->HashEntry)) {
+            MakeSlabFree(Target);
+            return NULL;
+        }
         YoriLibAppendList(&MakeContext->TargetsList, &Target->ListEntry);
-
-        YoriLibFreeStringContents(&FullPath);
     }
 
 #if MAKE_DEBUG_TARGETS
@@ -987,7 +1063,7 @@ MakeFindInferenceRuleForTarget(
 #if MAKE_DEBUG_TARGETS
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("GetFileAttributes for: %s\n"), FileToProbe->StartOfString);
 #endif
-            if (GetFileAttributes(FileToProbe->StartOfString) != (DWORD)-1) {
+            if (MakeProbeFileExists(ScopeContext->MakeContext, FileToProbe)) {
                 FileToProbe->LengthInChars = FileToProbe->LengthInChars + InferenceRule->SourceExtension.LengthInChars;
                 if (!MakeAssignInferenceRuleToTarget(ScopeContext, Target, InferenceRule, FileToProbe)) {
                     return FALSE;
@@ -1041,7 +1117,7 @@ MakeFindInferenceRuleForTarget(
 #if MAKE_DEBUG_TARGETS
                     YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Nested GetFileAttributes for: %s\n"), NestedFileToProbe->StartOfString);
 #endif
-                    if (GetFileAttributes(NestedFileToProbe->StartOfString) != (DWORD)-1) {
+                    if (MakeProbeFileExists(ScopeContext->MakeContext, NestedFileToProbe)) {
 
                         //
                         //  First, generate the outer rule, assigning the
@@ -1257,7 +1333,7 @@ MakeExpandTargetVariable(
     if (SymbolChars == 0) {
         return FALSE;
     }
-    MakeProbeTargetFile(Target);
+    MakeProbeTargetFile(MakeContext, Target);
 
     YoriLibInitEmptyString(&BaseVariableName);
     BaseVariableName.StartOfString = VariableName->StartOfString;
@@ -1305,7 +1381,7 @@ MakeExpandTargetVariable(
         ListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, NULL);
         while (ListEntry != NULL) {
             DependentTarget = CONTAINING_RECORD(ListEntry, MAKE_TARGET_DEPENDENCY, ChildDependents);
-            MakeProbeTargetFile(DependentTarget->Parent);
+            MakeProbeTargetFile(MakeContext, DependentTarget->Parent);
             if (!Target->FileExists ||
                 !DependentTarget->Parent->FileExists ||
                 DependentTarget->Parent->ModifiedTime.QuadPart > Target->ModifiedTime.QuadPart) {
@@ -1324,7 +1400,7 @@ MakeExpandTargetVariable(
         ListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, NULL);
         while (ListEntry != NULL) {
             DependentTarget = CONTAINING_RECORD(ListEntry, MAKE_TARGET_DEPENDENCY, ChildDependents);
-            MakeProbeTargetFile(DependentTarget->Parent);
+            MakeProbeTargetFile(MakeContext, DependentTarget->Parent);
             if (!Target->FileExists ||
                 !DependentTarget->Parent->FileExists ||
                 DependentTarget->Parent->ModifiedTime.QuadPart > Target->ModifiedTime.QuadPart) {
@@ -1664,13 +1740,10 @@ MakeMarkTargetForRebuild(
     }
 
     //
-    //  MSFIX Ideally these lists would be sorted or approximately sorted
-    //  where the targets that have the most dependencies are done before
-    //  those with fewer dependencies.  Doing this intelligently really
-    //  requires knowledge of all ancestors.  Appending to the end means
-    //  that depth first traversal should ensure that all dependencies are
-    //  satisfied, and if many targets depend on one target that target
-    //  should be uncovered relatively early.
+    //  The ready list is sorted by critical path once the full graph is
+    //  known, in MakeScheduleTargetsByCriticalPath.  Until then, appending
+    //  to the end means that depth first traversal should ensure that all
+    //  dependencies are satisfied.
     //
 
     Target->RebuildRequired = TRUE;
@@ -1760,7 +1833,7 @@ MakeDetermineDependenciesForTarget(
         return FALSE;
     }
 
-    MakeProbeTargetFile(Target);
+    MakeProbeTargetFile(MakeContext, Target);
 
     Target->EvaluatingDependencies = TRUE;
 
@@ -1802,7 +1875,7 @@ MakeDetermineDependenciesForTarget(
             Target->NumberParentsToBuild = Target->NumberParentsToBuild + 1;
             SetRebuildRequired = TRUE;
         }
-        MakeProbeTargetFile(Parent);
+        MakeProbeTargetFile(MakeContext, Parent);
         if (Parent->FileExists && Target->FileExists && Parent->ModifiedTime.QuadPart > Target->ModifiedTime.QuadPart) {
             SetRebuildRequired = TRUE;
         }
@@ -1816,6 +1889,16 @@ MakeDetermineDependenciesForTarget(
         SetRebuildRequired = TRUE;
     }
 
+    //
+    //  If timestamps indicate the target is current and nothing it depends
+    //  on will be rebuilt, check that its inputs are the same as when it
+    //  was last built.
+    //
+
+    if (!SetRebuildRequired && MakeBuildDbHaveInputsChanged(MakeContext, Target)) {
+        SetRebuildRequired = TRUE;
+    }
+
     if (SetRebuildRequired && !Target->RebuildRequired) {
 #if MAKE_DEBUG_TARGETS
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("RebuildRequired on %y\n"), &Target->HashEntry.Key);
@@ -1906,6 +1989,138 @@ MakeMarkCommandLineTargetForBuild(
     return TRUE;
 }
 
+/**
+ Insert a target into the list of targets that are ready to build, ordered
+ so that targets with the highest critical path cost are built first.
+ Targets with equal cost are built in the order they became ready.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target that is ready to build.  This must not
+        currently be on any list.
+ */
+VOID
+MakeInsertReadyTarget(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET Existing;
+
+    //
+    //  Most targets that become ready late in the build have low costs, so
+    //  search from the end.
+    //
+
+    ListEntry = YoriLibGetPreviousListEntry(&MakeContext->TargetsReady, NULL);
+    while (ListEntry != NULL) {
+        Existing = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
+        if (Existing->CriticalPathCost >= Target->CriticalPathCost) {
+            break;
+        }
+        ListEntry = YoriLibGetPreviousListEntry(&MakeContext->TargetsReady, ListEntry);
+    }
+
+    if (ListEntry == NULL) {
+        YoriLibInsertList(&MakeContext->TargetsReady, &Target->RebuildList);
+    } else {
+        YoriLibInsertList(ListEntry, &Target->RebuildList);
+    }
+}
+
+/**
+ Calculate the critical path cost of a target, being the expected time to
+ execute its recipe plus the most expensive chain of targets that are
+ waiting for it.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target which requires rebuilding.
+
+ @return The critical path cost of the target.
+ */
+DWORDLONG
+MakeCalculateCriticalPathForTarget(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET_DEPENDENCY Dependency;
+    DWORDLONG ChildCost;
+    DWORDLONG LongestChildCost;
+
+    if (Target->CriticalPathCalculated) {
+        return Target->CriticalPathCost;
+    }
+
+    LongestChildCost = 0;
+    ListEntry = YoriLibGetNextListEntry(&Target->ChildDependents, NULL);
+    while (ListEntry != NULL) {
+        Dependency = CONTAINING_RECORD(ListEntry, MAKE_TARGET_DEPENDENCY, ParentDependents);
+        if (Dependency->Child->RebuildRequired) {
+            ChildCost = MakeCalculateCriticalPathForTarget(MakeContext, Dependency->Child);
+            if (ChildCost > LongestChildCost) {
+                LongestChildCost = ChildCost;
+            }
+        }
+        ListEntry = YoriLibGetNextListEntry(&Target->ChildDependents, ListEntry);
+    }
+
+    Target->CriticalPathCost = LongestChildCost + MakeBuildDbGetTargetDuration(MakeContext, Target);
+    Target->CriticalPathCalculated = TRUE;
+    return Target->CriticalPathCost;
+}
+
+/**
+ Once all targets requiring rebuilding are known, calculate the critical
+ path cost of each and reorder the ready list so that targets which have
+ the longest chain of work waiting on them are built first.  This avoids
+ long running targets such as links being started last and leaving
+ processors idle at the end of the build.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeScheduleTargetsByCriticalPath(
+    __in PMAKE_CONTEXT MakeContext
+    )
+{
+    YORI_LIST_ENTRY ReadyList;
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET Target;
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsWaiting, NULL);
+    while (ListEntry != NULL) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
+        MakeCalculateCriticalPathForTarget(MakeContext, Target);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsWaiting, ListEntry);
+    }
+
+    //
+    //  Move the ready targets to a temporary list and insert them back in
+    //  priority order.
+    //
+
+    YoriLibInitializeListHead(&ReadyList);
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, NULL);
+    while (ListEntry != NULL) {
+        YoriLibRemoveListItem(ListEntry);
+        YoriLibAppendList(&ReadyList, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, NULL);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&ReadyList, NULL);
+    while (ListEntry != NULL) {
+        YoriLibRemoveListItem(ListEntry);
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
+        MakeCalculateCriticalPathForTarget(MakeContext, Target);
+        MakeInsertReadyTarget(MakeContext, Target);
+        ListEntry = YoriLibGetNextListEntry(&ReadyList, NULL);
+    }
+}
+
 /**
  Evaluate all of the dependencies for the first build target to determine
  what requires rebuilding.
@@ -0,0 +1,411 @@
+/**
+ * @file make/trace.c
+ *
+ * Yori shell make build timeline trace
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yorish.h>
+#include "make.h"
+
+/**
+ The trace is written in the Chrome trace event format, which is a JSON
+ array of events that can be loaded into chrome://tracing or Perfetto.
+ Events from ymake itself are recorded against thread zero, and events from
+ each job slot are recorded against a thread of the job identifier plus one.
+ */
+
+/**
+ Open a trace file and write the start of the event array.
+
+ @param MakeContext Pointer to the context.
+
+ @param FileName Pointer to the name of the trace file, as specified by the
+        user.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeTraceOpen(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING FileName
+    )
+{
+    YORI_STRING FullFileName;
+    HANDLE hFile;
+
+    ASSERT(MakeContext->TraceHandle == NULL);
+
+    YoriLibInitEmptyString(&FullFileName);
+    if (!YoriLibUserStringToSingleFilePath(FileName, TRUE, &FullFileName)) {
+        return FALSE;
+    }
+
+    hFile = CreateFile(FullFileName.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ymake: could not open trace file %y\n"), &FullFileName);
+        YoriLibFreeStringContents(&FullFileName);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&FullFileName);
+
+    QueryPerformanceFrequency(&MakeContext->TraceFrequency);
+    QueryPerformanceCounter(&MakeContext->TraceStartTime);
+    MakeContext->TraceHandle = hFile;
+    MakeContext->TraceEventWritten = FALSE;
+
+    YoriLibOutputToDevice(hFile, 0, _T("[\n"));
+    return TRUE;
+}
+
+/**
+ Convert a performance counter value into the number of microseconds since
+ the trace was opened.
+
+ @param MakeContext Pointer to the context.
+
+ @param Time The performance counter value.
+
+ @return The number of microseconds since the start of the trace.
+ */
+DWORDLONG
+MakeTraceTimeToMicroseconds(
+    __in PMAKE_CONTEXT MakeContext,
+    __in LONGLONG Time
+    )
+{
+    if (Time < MakeContext->TraceStartTime.QuadPart) {
+        return 0;
+    }
+
+    return (DWORDLONG)((Time - MakeContext->TraceStartTime.QuadPart) * 1000000 / MakeContext->TraceFrequency.QuadPart);
+}
+
+/**
+ Generate a copy of a string with any characters that are not valid in a
+ JSON string escaped.
+
+ @param Source Pointer to the string to escape.
+
+ @param Escaped On successful completion, updated to contain a newly
+        allocated escaped string.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeTraceEscapeString(
+    __in PYORI_STRING Source,
+    __out PYORI_STRING Escaped
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Length;
+    TCHAR Char;
+
+    //
+    //  The longest escape is \u00XX, which is six characters.
+    //
+
+    YoriLibInitEmptyString(Escaped);
+    if (!YoriLibAllocateString(Escaped, Source->LengthInChars * 6 + 1)) {
+        return FALSE;
+    }
+
+    Length = 0;
+    for (Index = 0; Index < Source->LengthInChars; Index++) {
+        Char = Source->StartOfString[Index];
+        if (Char == '\\' || Char == '"') {
+            Escaped->StartOfString[Length++] = '\\';
+            Escaped->StartOfString[Length++] = Char;
+        } else if (Char < 0x20) {
+            Length = Length + YoriLibSPrintf(&Escaped->StartOfString[Length], _T("\\u%04x"), Char);
+        } else {
+            Escaped->StartOfString[Length++] = Char;
+        }
+    }
+
+    Escaped->StartOfString[Length] = '\0';
+    Escaped->LengthInChars = Length;
+    return TRUE;
+}
+
+/**
+ Write an event describing an operation with a start and end time to the
+ trace.  If no trace is being collected, this function does nothing.
+
+ @param MakeContext Pointer to the context.
+
+ @param Category Pointer to a constant string describing the kind of
+        operation.
+
+ @param Name Pointer to the name of the operation.
+
+ @param ThreadId The trace thread to record the operation against.  Zero
+        refers to ymake itself, and other values refer to job slots.
+
+ @param StartTime The performance counter value when the operation started.
+
+ @param EndTime The performance counter value when the operation completed.
+
+ @param Detail Optionally points to a string to record as the command for
+        the operation.
+
+ @param ExitCode Optionally points to the exit code of the operation.
+ */
+VOID
+MakeTraceCompleteEvent(
+    __in PMAKE_CONTEXT MakeContext,
+    __in LPCTSTR Category,
+    __in PYORI_STRING Name,
+    __in DWORD ThreadId,
+    __in LONGLONG StartTime,
+    __in LONGLONG EndTime,
+    __in_opt PYORI_STRING Detail,
+    __in_opt PDWORD ExitCode
+    )
+{
+    YORI_STRING EscapedName;
+    YORI_STRING EscapedDetail;
+    DWORDLONG Start;
+    DWORDLONG End;
+
+    if (MakeContext->TraceHandle == NULL) {
+        return;
+    }
+
+    if (!MakeTraceEscapeString(Name, &EscapedName)) {
+        return;
+    }
+
+    YoriLibInitEmptyString(&EscapedDetail);
+    if (Detail != NULL && !MakeTraceEscapeString(Detail, &EscapedDetail)) {
+        YoriLibFreeStringContents(&EscapedName);
+        return;
+    }
+
+    Start = MakeTraceTimeToMicroseconds(MakeContext, StartTime);
+    End = MakeTraceTimeToMicroseconds(MakeContext, EndTime);
+    if (End < Start) {
+        End = Start;
+    }
+
+    if (MakeContext->TraceEventWritten) {
+        YoriLibOutputToDevice(MakeContext->TraceHandle, 0, _T(",\n"));
+    }
+    MakeContext->TraceEventWritten = TRUE;
+
+    YoriLibOutputToDevice(MakeContext->TraceHandle,
+                          0,
+                          _T("{\"name\":\"%y\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%i,\"ts\":%lli,\"dur\":%lli"),
+                          &EscapedName,
+                          Category,
+                          ThreadId,
+                          Start,
+                          End - Start);
+
+    if (Detail != NULL || ExitCode != NULL) {
+        YoriLibOutputToDevice(MakeContext->TraceHandle, 0, _T(",\"args\":{"));
+        if (Detail != NULL) {
+            YoriLibOutputToDevice(MakeContext->TraceHandle, 0, _T("\"cmd\":\"%y\""), &EscapedDetail);
+        }
+        if (ExitCode != NULL) {
+            YoriLibOutputToDevice(MakeContext->TraceHandle,
+                                  0,
+                                  _T("%s\"exitcode\":%i"),
+                                  Detail != NULL?_T(","):_T(""),
+                                  *ExitCode);
+        }
+        YoriLibOutputToDevice(MakeContext->TraceHandle, 0, _T("}"));
+    }
+
+    YoriLibOutputToDevice(MakeContext->TraceHandle, 0, _T("}"));
+
+    YoriLibFreeStringContents(&EscapedName);
+    YoriLibFreeStringContents(&EscapedDetail);
+}
+
+/**
+ Prepare to record job slot activity while executing the targets.  This
+ allocates a record of when each job slot became idle, so that the time a
+ slot spends waiting for work is visible in the trace.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeTraceBeginExecute(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    LARGE_INTEGER Now;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (MakeContext->TraceHandle == NULL) {
+        return;
+    }
+
+    ASSERT(MakeContext->TraceSlotIdleSince == NULL);
+    MakeContext->TraceSlotIdleSince = YoriLibMalloc(MakeContext->NumberProcesses * sizeof(LONGLONG));
+    if (MakeContext->TraceSlotIdleSince == NULL) {
+        return;
+    }
+
+    QueryPerformanceCounter(&Now);
+    for (Index = 0; Index < MakeContext->NumberProcesses; Index++) {
+        MakeContext->TraceSlotIdleSince[Index] = Now.QuadPart;
+    }
+
+    if (MakeContext->TraceSlotCount < MakeContext->NumberProcesses) {
+        MakeContext->TraceSlotCount = MakeContext->NumberProcesses;
+    }
+}
+
+/**
+ Indicate that a job slot has started executing a command.  If the slot was
+ idle before this point, an idle event is written for the interval.
+
+ @param MakeContext Pointer to the context.
+
+ @param JobId The job slot that is now executing.
+
+ @param StartTime The performance counter value when the command started.
+ */
+VOID
+MakeTraceJobStarted(
+    __in PMAKE_CONTEXT MakeContext,
+    __in DWORD JobId,
+    __in LONGLONG StartTime
+    )
+{
+    YORI_STRING Name;
+
+    if (MakeContext->TraceSlotIdleSince == NULL) {
+        return;
+    }
+
+    ASSERT(JobId < MakeContext->NumberProcesses);
+    if (MakeContext->TraceSlotIdleSince[JobId] != 0 &&
+        MakeTraceTimeToMicroseconds(MakeContext, StartTime) > MakeTraceTimeToMicroseconds(MakeContext, MakeContext->TraceSlotIdleSince[JobId])) {
+
+        YoriLibConstantString(&Name, _T("idle"));
+        MakeTraceCompleteEvent(MakeContext, _T("idle"), &Name, JobId + 1, MakeContext->TraceSlotIdleSince[JobId], StartTime, NULL, NULL);
+    }
+    MakeContext->TraceSlotIdleSince[JobId] = 0;
+}
+
+/**
+ Indicate that a job slot has finished executing a command and is now idle.
+
+ @param MakeContext Pointer to the context.
+
+ @param JobId The job slot that is now idle.
+
+ @param EndTime The performance counter value when the command completed.
+ */
+VOID
+MakeTraceJobFinished(
+    __in PMAKE_CONTEXT MakeContext,
+    __in DWORD JobId,
+    __in LONGLONG EndTime
+    )
+{
+    if (MakeContext->TraceSlotIdleSince == NULL) {
+        return;
+    }
+
+    ASSERT(JobId < MakeContext->NumberProcesses);
+    MakeContext->TraceSlotIdleSince[JobId] = EndTime;
+}
+
+/**
+ Indicate that targets have finished executing.  Any job slots that are idle
+ have the remaining idle interval written to the trace.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeTraceEndExecute(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    LARGE_INTEGER Now;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (MakeContext->TraceSlotIdleSince == NULL) {
+        return;
+    }
+
+    QueryPerformanceCounter(&Now);
+    for (Index = 0; Index < MakeContext->NumberProcesses; Index++) {
+        MakeTraceJobStarted(MakeContext, Index, Now.QuadPart);
+    }
+
+    YoriLibFree(MakeContext->TraceSlotIdleSince);
+    MakeContext->TraceSlotIdleSince = NULL;
+}
+
+/**
+ Write the names of each trace thread, terminate the event array, and close
+ the trace file.  If no trace is being collected, this function does
+ nothing.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeTraceClose(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    DWORD Index;
+
+    if (MakeContext->TraceHandle == NULL) {
+        return;
+    }
+
+    MakeTraceEndExecute(MakeContext);
+
+    if (MakeContext->TraceEventWritten) {
+        YoriLibOutputToDevice(MakeContext->TraceHandle, 0, _T(",\n"));
+    }
+
+    YoriLibOutputToDevice(MakeContext->TraceHandle,
+                          0,
+                          _T("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"ymake\"}}"));
+
+    for (Index = 0; Index < MakeContext->TraceSlotCount; Index++) {
+        YoriLibOutputToDevice(MakeContext->TraceHandle,
+                              0,
+                              _T(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":\"job %i\"}}"),
+                              Index + 1,
+                              Index);
+    }
+
+    YoriLibOutputToDevice(MakeContext->TraceHandle, 0, _T("\n]\n"));
+    CloseHandle(MakeContext->TraceHandle);
+    MakeContext->TraceHandle = NULL;
+}
+
+// vim:sw=4:ts=4:et:
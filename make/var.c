@@ -29,6 +29,12 @@
 #include <yorish.h>
 #include "make.h"
 
+/**
+ The number of bytes to allocate at a time for variable expansion cache
+ entries.  Each scope has its own cache, so this is kept small.
+ */
+#define MAKE_EXPANSION_CACHE_ARENA_CHUNK_SIZE (4096)
+
 /**
  Deallocate a single variable.
 
@@ -111,6 +117,137 @@ MakeHashAllVariables(
     return Hash;
 }
 
+/**
+ Deallocate all cached variable expansions within the specified context.
+
+ @param ScopeContext Pointer to the scope context.
+ */
+VOID
+MakeDeleteExpansionCache(
+    __inout PMAKE_SCOPE_CONTEXT ScopeContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_EXPANSION_CACHE_ENTRY Entry;
+
+    if (ScopeContext->ExpansionCache == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&ScopeContext->ExpansionCacheList, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, MAKE_EXPANSION_CACHE_ENTRY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&ScopeContext->ExpansionCacheList, ListEntry);
+        YoriLibRemoveListItem(&Entry->ListEntry);
+        YoriLibHashRemoveByEntry(&Entry->HashEntry);
+        YoriLibFreeStringContents(&Entry->Value);
+    }
+
+    YoriLibFreeEmptyHashTable(ScopeContext->ExpansionCache);
+    ScopeContext->ExpansionCache = NULL;
+    YoriLibArenaDestroy(&ScopeContext->ExpansionCacheArena);
+}
+
+/**
+ Find a previous expansion of a variable within a scope.  The expansion is
+ only returned if no variable has been modified since it was generated.
+
+ @param ScopeContext Pointer to the scope context.
+
+ @param VariableName Pointer to the variable name, including any search and
+        replace expression.
+
+ @return Pointer to the cache entry, or NULL if no current expansion is
+         known.
+ */
+PMAKE_EXPANSION_CACHE_ENTRY
+MakeLookupExpansionCache(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext,
+    __in PCYORI_STRING VariableName
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PMAKE_EXPANSION_CACHE_ENTRY Entry;
+
+    if (ScopeContext->ExpansionCache == NULL) {
+        return NULL;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(ScopeContext->ExpansionCache, VariableName);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+
+    Entry = HashEntry->Context;
+    if (Entry->Generation != ScopeContext->MakeContext->VariableGeneration) {
+        return NULL;
+    }
+
+    return Entry;
+}
+
+/**
+ Record the expansion of a variable within a scope.  The cache takes a
+ reference on the expanded value, so later expansions can share it without
+ allocating.  Since this is only an optimization, failures are ignored.
+
+ @param ScopeContext Pointer to the scope context.
+
+ @param VariableName Pointer to the variable name, including any search and
+        replace expression.
+
+ @param Value Pointer to the expanded value.
+ */
+VOID
+MakeAddExpansionCache(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext,
+    __in PCYORI_STRING VariableName,
+    __in PYORI_STRING Value
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PMAKE_EXPANSION_CACHE_ENTRY Entry;
+    YORI_STRING VariableNameCopy;
+
+    if (ScopeContext->ExpansionCache == NULL) {
+        ScopeContext->ExpansionCache = YoriLibAllocateHashTable(250);
+        if (ScopeContext->ExpansionCache == NULL) {
+            return;
+        }
+        YoriLibInitializeListHead(&ScopeContext->ExpansionCacheList);
+        YoriLibArenaCreate(&ScopeContext->ExpansionCacheArena, MAKE_EXPANSION_CACHE_ARENA_CHUNK_SIZE);
+    }
+
+    HashEntry = YoriLibHashLookupByKey(ScopeContext->ExpansionCache, VariableName);
+    if (HashEntry != NULL) {
+        Entry = HashEntry->Context;
+        YoriLibFreeStringContents(&Entry->Value);
+    } else {
+
+        //
+        //  As with variables, the name is copied into the same allocation
+        //  so the hash package can refer to it.  Entries live until the
+        //  cache is deleted, so they are carved from the scope's arena.
+        //
+
+        Entry = YoriLibArenaAlloc(&ScopeContext->ExpansionCacheArena, sizeof(MAKE_EXPANSION_CACHE_ENTRY) + VariableName->LengthInChars * sizeof(TCHAR));
+        if (Entry == NULL) {
+            return;
+        }
+
+        YoriLibInitEmptyString(&VariableNameCopy);
+        VariableNameCopy.StartOfString = (LPTSTR)(Entry + 1);
+        memcpy(VariableNameCopy.StartOfString, VariableName->StartOfString, VariableName->LengthInChars * sizeof(TCHAR));
+        VariableNameCopy.LengthInChars = VariableName->LengthInChars;
+
+        YoriLibHashInsertByKey(ScopeContext->ExpansionCache, &VariableNameCopy, Entry, &Entry->HashEntry);
+        YoriLibAppendList(&ScopeContext->ExpansionCacheList, &Entry->ListEntry);
+    }
+
+    YoriLibCloneString(&Entry->Value, Value);
+    Entry->Generation = ScopeContext->MakeContext->VariableGeneration;
+}
+
 /**
  Lookup a variable by name.
 
@@ -218,6 +355,7 @@ MakeSubstituteNamedVariable(
     )
 {
     PMAKE_VARIABLE FoundVariable;
+    PMAKE_EXPANSION_CACHE_ENTRY CacheEntry;
     YORI_STRING NameToFind;
     YORI_STRING SearchText;
     YORI_STRING ReplaceText;
@@ -239,6 +377,17 @@ MakeSubstituteNamedVariable(
         }
     }
 
+    //
+    //  If this expression has been expanded in this scope and no variables
+    //  have changed since, share the previous result.
+    //
+
+    CacheEntry = MakeLookupExpansionCache(ScopeContext, VariableName);
+    if (CacheEntry != NULL) {
+        YoriLibCloneString(VariableData, &CacheEntry->Value);
+        return TRUE;
+    }
+
     YoriLibInitEmptyString(&NameToFind);
     YoriLibInitEmptyString(&SearchText);
     YoriLibInitEmptyString(&ReplaceText);
@@ -280,6 +429,7 @@ MakeSubstituteNamedVariable(
     if (SearchText.LengthInChars == 0) {
         VariableData->StartOfString = FoundVariable->Value.StartOfString;
         VariableData->LengthInChars = FoundVariable->Value.LengthInChars;
+        MakeAddExpansionCache(ScopeContext, VariableName, &FoundVariable->Value);
         return TRUE;
     }
 
@@ -340,6 +490,7 @@ MakeSubstituteNamedVariable(
     }
 
     VariableData->LengthInChars = LengthNeeded;
+    MakeAddExpansionCache(ScopeContext, VariableName, VariableData);
     return TRUE;
 }
 
@@ -552,6 +703,13 @@ MakeSetVariable(
     PYORI_HASH_ENTRY FoundVariableEntry;
     PMAKE_VARIABLE FoundVariable;
 
+    //
+    //  A change to a variable in any scope can change the expansion in
+    //  child scopes, so this invalidates every cached expansion.
+    //
+
+    ScopeContext->MakeContext->VariableGeneration++;
+
     FoundVariableEntry = YoriLibHashLookupByKey(ScopeContext->Variables, Variable);
     if (FoundVariableEntry != NULL) {
         FoundVariable = FoundVariableEntry->Context;
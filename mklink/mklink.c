@@ -36,11 +36,17 @@ CHAR strMklinkHelpText[] =
         "Creates hardlinks, symbolic links, or junctions.\n"
         "\n"
         "MKLINK [-license] [[-d]|[-f]|[-h]|[-j]] <link> <target>\n"
+        "MKLINK -dedupe <dir> [<dir>...]\n"
         "\n"
         "   -d             Create a directory symbolic link\n"
+        "   -dedupe        Replace identical files with hard links to one copy\n"
         "   -f             Create a file symbolic link\n"
         "   -h             Create a hard link (files only)\n"
-        "   -j             Create a junction (directories only)\n" ;
+        "   -j             Create a junction (directories only)\n"
+        "\n"
+        "When deduplicating, files are only linked if they are on the same volume and\n"
+        "have the same attributes and last write time, since these are shared by\n"
+        "all links to a file.\n" ;
 
 /**
  Display usage text to the user.
@@ -228,6 +234,952 @@ MklinkCreateJunction(
 }
 
 
+/**
+ The number of bytes at the start of each file which are hashed to find
+ files which may be identical before hashing entire files.
+ */
+#define MKLINK_DEDUPE_PARTIAL_SIZE (64 * 1024)
+
+/**
+ The size of the buffer used to read files when hashing or comparing them.
+ */
+#define MKLINK_DEDUPE_BUFFER_SIZE (256 * 1024)
+
+/**
+ Attributes which are not shared between hard links or which do not
+ describe the contents of the file, and are ignored when determining whether
+ files are duplicates.
+ */
+#define MKLINK_DEDUPE_IGNORED_ATTRIBUTES (FILE_ATTRIBUTE_ARCHIVE)
+
+/**
+ Information about a file which may be a duplicate of another file.
+ */
+typedef struct _MKLINK_DEDUPE_FILE {
+
+    /**
+     The full path to the file.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     The size of the file, in bytes.
+     */
+    LARGE_INTEGER FileSize;
+
+    /**
+     The last write time of the file.  Hard links share timestamps, so only
+     files with the same last write time are linked.
+     */
+    LARGE_INTEGER LastWriteTime;
+
+    /**
+     The attributes of the file, excluding any which are ignored.  Hard
+     links share attributes, so only files with the same attributes are
+     linked.
+     */
+    DWORD FileAttributes;
+
+    /**
+     The serial number of the volume containing the file.  Hard links can
+     only be created within a volume.
+     */
+    DWORD VolumeSerialNumber;
+
+    /**
+     The file index of the file.  Files with the same file index on the same
+     volume are already links to each other.
+     */
+    LARGE_INTEGER FileIndex;
+
+    /**
+     The number of hard links to the file.  If the file has other links, its
+     space is not reclaimed when this link is replaced.
+     */
+    DWORD NumberOfLinks;
+
+    /**
+     A hash of the first MKLINK_DEDUPE_PARTIAL_SIZE bytes of the file.
+     */
+    DWORDLONG PartialHash;
+
+    /**
+     A hash of the entire file.
+     */
+    DWORDLONG FullHash;
+
+    /**
+     TRUE if the file could be opened and its partial hash is valid.
+     */
+    BOOLEAN PartialHashValid;
+
+    /**
+     TRUE if the full hash of the file is valid.
+     */
+    BOOLEAN FullHashValid;
+
+    /**
+     TRUE if the file could not be opened or read, and should not be linked.
+     */
+    BOOLEAN Failed;
+} MKLINK_DEDUPE_FILE, *PMKLINK_DEDUPE_FILE;
+
+/**
+ State for a deduplication operation.
+ */
+typedef struct _MKLINK_DEDUPE_CONTEXT {
+
+    /**
+     An array of pointers to files found.
+     */
+    PMKLINK_DEDUPE_FILE *Files;
+
+    /**
+     The number of files found.
+     */
+    DWORD FileCount;
+
+    /**
+     The number of elements allocated in the Files array.
+     */
+    DWORD FilesAllocated;
+
+    /**
+     A buffer used for reading the first file being hashed or compared.
+     */
+    PUCHAR Buffer1;
+
+    /**
+     A buffer used for reading the second file being compared.
+     */
+    PUCHAR Buffer2;
+
+    /**
+     The number of files which were replaced with hard links.
+     */
+    DWORD FilesLinked;
+
+    /**
+     The number of bytes which are no longer consumed because files were
+     replaced with hard links.
+     */
+    LARGE_INTEGER BytesReclaimed;
+
+    /**
+     TRUE if enumerating files failed due to memory allocation.
+     */
+    BOOLEAN OutOfMemory;
+} MKLINK_DEDUPE_CONTEXT, *PMKLINK_DEDUPE_CONTEXT;
+
+/**
+ A callback invoked for each file found when searching for duplicates.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @param FileInfo Information about the file.
+
+ @param Depth Recursion depth, ignored in this function.
+
+ @param Context Pointer to the deduplication context.
+
+ @return TRUE to continue enumerating, FALSE to abort.
+ */
+BOOL
+MklinkDedupeFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PMKLINK_DEDUPE_CONTEXT DedupeContext;
+    PMKLINK_DEDUPE_FILE File;
+    PMKLINK_DEDUPE_FILE *NewFiles;
+    DWORD NewAllocated;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    DedupeContext = (PMKLINK_DEDUPE_CONTEXT)Context;
+
+    //
+    //  Empty files consume no space, and reparse points may not be what
+    //  they seem, so neither is considered.
+    //
+
+    if ((FileInfo->dwFileAttributes & (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_REPARSE_POINT)) != 0 ||
+        (FileInfo->nFileSizeHigh == 0 && FileInfo->nFileSizeLow == 0)) {
+
+        return TRUE;
+    }
+
+    if (DedupeContext->FileCount >= DedupeContext->FilesAllocated) {
+        NewAllocated = DedupeContext->FilesAllocated * 2;
+        if (NewAllocated < 0x1000) {
+            NewAllocated = 0x1000;
+        }
+
+        if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)NewAllocated * sizeof(PMKLINK_DEDUPE_FILE))) {
+            DedupeContext->OutOfMemory = TRUE;
+            return FALSE;
+        }
+
+        NewFiles = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(PMKLINK_DEDUPE_FILE)));
+        if (NewFiles == NULL) {
+            DedupeContext->OutOfMemory = TRUE;
+            return FALSE;
+        }
+
+        if (DedupeContext->Files != NULL) {
+            memcpy(NewFiles, DedupeContext->Files, DedupeContext->FileCount * sizeof(PMKLINK_DEDUPE_FILE));
+            YoriLibFree(DedupeContext->Files);
+        }
+
+        DedupeContext->Files = NewFiles;
+        DedupeContext->FilesAllocated = NewAllocated;
+    }
+
+    File = YoriLibMalloc(sizeof(MKLINK_DEDUPE_FILE));
+    if (File == NULL) {
+        DedupeContext->OutOfMemory = TRUE;
+        return FALSE;
+    }
+
+    ZeroMemory(File, sizeof(MKLINK_DEDUPE_FILE));
+    if (!YoriLibCopyString(&File->FilePath, FilePath)) {
+        YoriLibFree(File);
+        DedupeContext->OutOfMemory = TRUE;
+        return FALSE;
+    }
+
+    File->FileSize.HighPart = FileInfo->nFileSizeHigh;
+    File->FileSize.LowPart = FileInfo->nFileSizeLow;
+    File->LastWriteTime.HighPart = FileInfo->ftLastWriteTime.dwHighDateTime;
+    File->LastWriteTime.LowPart = FileInfo->ftLastWriteTime.dwLowDateTime;
+    File->FileAttributes = FileInfo->dwFileAttributes & ~(MKLINK_DEDUPE_IGNORED_ATTRIBUTES);
+
+    DedupeContext->Files[DedupeContext->FileCount] = File;
+    DedupeContext->FileCount++;
+
+    return TRUE;
+}
+
+/**
+ A callback invoked when a directory cannot be enumerated when searching
+ for duplicates.
+
+ @param FilePath Pointer to the file path that could not be enumerated.
+
+ @param ErrorCode The Win32 error code describing the failure.
+
+ @param Depth Recursion depth, ignored in this function.
+
+ @param Context Pointer to the deduplication context, ignored in this
+        function.
+
+ @return TRUE to continue enumerating, FALSE to abort.
+ */
+BOOL
+MklinkDedupeErrorCallback(
+    __in PYORI_STRING FilePath,
+    __in DWORD ErrorCode,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    LPTSTR ErrText;
+
+    UNREFERENCED_PARAMETER(Depth);
+    UNREFERENCED_PARAMETER(Context);
+
+    if (ErrorCode == ERROR_FILE_NOT_FOUND || ErrorCode == ERROR_PATH_NOT_FOUND) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("mklink: not found: %y\n"), FilePath);
+        return TRUE;
+    }
+
+    ErrText = YoriLibGetWinErrorText(ErrorCode);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("mklink: enumerate of %y failed: %s"), FilePath, ErrText);
+    YoriLibFreeWinErrorText(ErrText);
+    return TRUE;
+}
+
+/**
+ Compare two files found when searching for duplicates.  Files which are
+ candidates to be linked compare as equal.  Fields which have not yet been
+ populated are zero, so the same comparison can be used as more is learned
+ about each file.
+
+ @param File1 Pointer to the first file.
+
+ @param File2 Pointer to the second file.
+
+ @return Less than zero if File1 should be ordered before File2, greater
+         than zero if File1 should be ordered after File2, or zero if the
+         files may be duplicates.
+ */
+int
+MklinkDedupeCompareFiles(
+    __in PMKLINK_DEDUPE_FILE File1,
+    __in PMKLINK_DEDUPE_FILE File2
+    )
+{
+    if (File1->FileSize.QuadPart != File2->FileSize.QuadPart) {
+        return (File1->FileSize.QuadPart < File2->FileSize.QuadPart)?-1:1;
+    }
+
+    if (File1->FileAttributes != File2->FileAttributes) {
+        return (File1->FileAttributes < File2->FileAttributes)?-1:1;
+    }
+
+    if (File1->LastWriteTime.QuadPart != File2->LastWriteTime.QuadPart) {
+        return (File1->LastWriteTime.QuadPart < File2->LastWriteTime.QuadPart)?-1:1;
+    }
+
+    if (File1->Failed != File2->Failed) {
+        return File1->Failed?1:-1;
+    }
+
+    if (File1->VolumeSerialNumber != File2->VolumeSerialNumber) {
+        return (File1->VolumeSerialNumber < File2->VolumeSerialNumber)?-1:1;
+    }
+
+    if (File1->PartialHash != File2->PartialHash) {
+        return (File1->PartialHash < File2->PartialHash)?-1:1;
+    }
+
+    if (File1->FullHash != File2->FullHash) {
+        return (File1->FullHash < File2->FullHash)?-1:1;
+    }
+
+    return 0;
+}
+
+/**
+ Move an element down a heap until it is no smaller than its children.
+
+ @param Files Pointer to an array of files arranged as a heap.
+
+ @param Index The index of the element to move.
+
+ @param Count The number of elements in the heap.
+ */
+VOID
+MklinkDedupeSiftDown(
+    __inout PMKLINK_DEDUPE_FILE *Files,
+    __in DWORD Index,
+    __in DWORD Count
+    )
+{
+    PMKLINK_DEDUPE_FILE Swap;
+    DWORD Child;
+
+    while (TRUE) {
+        Child = Index * 2 + 1;
+        if (Child >= Count) {
+            break;
+        }
+
+        if (Child + 1 < Count &&
+            MklinkDedupeCompareFiles(Files[Child], Files[Child + 1]) < 0) {
+
+            Child++;
+        }
+
+        if (MklinkDedupeCompareFiles(Files[Index], Files[Child]) >= 0) {
+            break;
+        }
+
+        Swap = Files[Index];
+        Files[Index] = Files[Child];
+        Files[Child] = Swap;
+        Index = Child;
+    }
+}
+
+/**
+ Sort an array of files so that files which may be duplicates are adjacent.
+ A heap sort is used since it needs no additional memory and cannot become
+ quadratic on the many equal elements this array typically contains.
+
+ @param Files Pointer to an array of files.
+
+ @param Count The number of elements in the array.
+ */
+VOID
+MklinkDedupeSortFiles(
+    __inout PMKLINK_DEDUPE_FILE *Files,
+    __in DWORD Count
+    )
+{
+    PMKLINK_DEDUPE_FILE Swap;
+    DWORD Index;
+
+    if (Count < 2) {
+        return;
+    }
+
+    for (Index = Count / 2; Index > 0; Index--) {
+        MklinkDedupeSiftDown(Files, Index - 1, Count);
+    }
+
+    for (Index = Count - 1; Index > 0; Index--) {
+        Swap = Files[0];
+        Files[0] = Files[Index];
+        Files[Index] = Swap;
+        MklinkDedupeSiftDown(Files, 0, Index);
+    }
+}
+
+/**
+ Return the number of elements starting from a specified element which
+ compare equal to it.  The array is expected to be sorted.
+
+ @param Files Pointer to an array of files.
+
+ @param Start The index of the first element in the run.
+
+ @param Count The number of elements in the array.
+
+ @return The number of elements in the run, which is at least one.
+ */
+DWORD
+MklinkDedupeRunLength(
+    __in PMKLINK_DEDUPE_FILE *Files,
+    __in DWORD Start,
+    __in DWORD Count
+    )
+{
+    DWORD End;
+
+    for (End = Start + 1; End < Count; End++) {
+        if (MklinkDedupeCompareFiles(Files[Start], Files[End]) != 0) {
+            break;
+        }
+    }
+
+    return End - Start;
+}
+
+/**
+ Open a file for reading in order to hash or compare it.
+
+ @param File Pointer to the file to open.
+
+ @return Handle to the opened file, or INVALID_HANDLE_VALUE on failure.
+ */
+HANDLE
+MklinkDedupeOpenFile(
+    __in PMKLINK_DEDUPE_FILE File
+    )
+{
+    return CreateFile(File->FilePath.StartOfString,
+                      FILE_READ_DATA | FILE_READ_ATTRIBUTES | SYNCHRONIZE,
+                      FILE_SHARE_READ | FILE_SHARE_DELETE,
+                      NULL,
+                      OPEN_EXISTING,
+                      FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_SEQUENTIAL_SCAN,
+                      NULL);
+}
+
+/**
+ Read from a file until a buffer is full or the end of the file is reached.
+
+ @param FileHandle Handle to the file to read from.
+
+ @param Buffer Pointer to the buffer to fill.
+
+ @param BufferLength The number of bytes to read.
+
+ @param BytesRead On successful completion, updated to contain the number of
+        bytes read.  This is less than BufferLength only at the end of the
+        file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MklinkDedupeReadFile(
+    __in HANDLE FileHandle,
+    __out_bcount(BufferLength) PUCHAR Buffer,
+    __in DWORD BufferLength,
+    __out PDWORD BytesRead
+    )
+{
+    DWORD TotalRead;
+    DWORD ThisRead;
+
+    TotalRead = 0;
+    while (TotalRead < BufferLength) {
+        if (!ReadFile(FileHandle, &Buffer[TotalRead], BufferLength - TotalRead, &ThisRead, NULL)) {
+            return FALSE;
+        }
+        if (ThisRead == 0) {
+            break;
+        }
+        TotalRead = TotalRead + ThisRead;
+    }
+
+    *BytesRead = TotalRead;
+    return TRUE;
+}
+
+/**
+ Open a file, record its identity, and hash either its first
+ MKLINK_DEDUPE_PARTIAL_SIZE bytes or the entire file.  If the partial hash
+ covers the entire file, the full hash is also populated.  If the file
+ cannot be opened or read, it is marked as failed.
+
+ @param DedupeContext Pointer to the deduplication context, which provides
+        the buffer to read with.
+
+ @param File Pointer to the file to hash.
+
+ @param FullHash If TRUE, the entire file is hashed.  If FALSE, only the
+        start of the file is hashed.
+ */
+VOID
+MklinkDedupeHashFile(
+    __in PMKLINK_DEDUPE_CONTEXT DedupeContext,
+    __inout PMKLINK_DEDUPE_FILE File,
+    __in BOOLEAN FullHash
+    )
+{
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    YORI_LIB_XXHASH64_STATE HashState;
+    LARGE_INTEGER TotalRead;
+    HANDLE FileHandle;
+    DWORD BytesToRead;
+    DWORD BytesRead;
+
+    FileHandle = MklinkDedupeOpenFile(File);
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        File->Failed = TRUE;
+        return;
+    }
+
+    if (!FullHash) {
+        if (!GetFileInformationByHandle(FileHandle, &FileInfo)) {
+            CloseHandle(FileHandle);
+            File->Failed = TRUE;
+            return;
+        }
+
+        File->VolumeSerialNumber = FileInfo.dwVolumeSerialNumber;
+        File->FileIndex.HighPart = FileInfo.nFileIndexHigh;
+        File->FileIndex.LowPart = FileInfo.nFileIndexLow;
+        File->NumberOfLinks = FileInfo.nNumberOfLinks;
+
+        //
+        //  If the file changed since it was enumerated, don't touch it.
+        //
+
+        if (FileInfo.nFileSizeHigh != (DWORD)File->FileSize.HighPart ||
+            FileInfo.nFileSizeLow != File->FileSize.LowPart ||
+            FileInfo.ftLastWriteTime.dwHighDateTime != (DWORD)File->LastWriteTime.HighPart ||
+            FileInfo.ftLastWriteTime.dwLowDateTime != File->LastWriteTime.LowPart) {
+
+            CloseHandle(FileHandle);
+            File->Failed = TRUE;
+            return;
+        }
+    }
+
+    YoriLibXxHash64Initialize(&HashState, 0);
+    TotalRead.QuadPart = 0;
+
+    while (TRUE) {
+        BytesToRead = MKLINK_DEDUPE_BUFFER_SIZE;
+        if (!FullHash && BytesToRead > MKLINK_DEDUPE_PARTIAL_SIZE) {
+            BytesToRead = MKLINK_DEDUPE_PARTIAL_SIZE;
+        }
+
+        if (!MklinkDedupeReadFile(FileHandle, DedupeContext->Buffer1, BytesToRead, &BytesRead)) {
+            CloseHandle(FileHandle);
+            File->Failed = TRUE;
+            return;
+        }
+
+        if (BytesRead > 0) {
+            YoriLibXxHash64Update(&HashState, DedupeContext->Buffer1, (YORI_ALLOC_SIZE_T)BytesRead);
+            TotalRead.QuadPart = TotalRead.QuadPart + BytesRead;
+        }
+
+        if (BytesRead < BytesToRead || !FullHash) {
+            break;
+        }
+    }
+
+    CloseHandle(FileHandle);
+
+    if (FullHash) {
+        File->FullHash = YoriLibXxHash64Finalize(&HashState);
+        File->FullHashValid = TRUE;
+    } else {
+        File->PartialHash = YoriLibXxHash64Finalize(&HashState);
+        File->PartialHashValid = TRUE;
+        if (TotalRead.QuadPart == File->FileSize.QuadPart) {
+            File->FullHash = File->PartialHash;
+            File->FullHashValid = TRUE;
+        }
+    }
+}
+
+/**
+ Compare the contents of two files byte by byte.  Hashes indicate which
+ files are likely identical, but since a duplicate is about to be replaced,
+ the contents are checked before doing so.
+
+ @param DedupeContext Pointer to the deduplication context, which provides
+        the buffers to read with.
+
+ @param File1 Pointer to the first file.
+
+ @param File2 Pointer to the second file.
+
+ @return TRUE if the files have identical contents, FALSE if they differ or
+         could not be read.
+ */
+BOOLEAN
+MklinkDedupeFilesIdentical(
+    __in PMKLINK_DEDUPE_CONTEXT DedupeContext,
+    __in PMKLINK_DEDUPE_FILE File1,
+    __in PMKLINK_DEDUPE_FILE File2
+    )
+{
+    HANDLE FileHandle1;
+    HANDLE FileHandle2;
+    DWORD BytesRead1;
+    DWORD BytesRead2;
+    BOOLEAN Identical;
+
+    FileHandle1 = MklinkDedupeOpenFile(File1);
+    if (FileHandle1 == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    FileHandle2 = MklinkDedupeOpenFile(File2);
+    if (FileHandle2 == INVALID_HANDLE_VALUE) {
+        CloseHandle(FileHandle1);
+        return FALSE;
+    }
+
+    Identical = FALSE;
+    while (TRUE) {
+        if (!MklinkDedupeReadFile(FileHandle1, DedupeContext->Buffer1, MKLINK_DEDUPE_BUFFER_SIZE, &BytesRead1) ||
+            !MklinkDedupeReadFile(FileHandle2, DedupeContext->Buffer2, MKLINK_DEDUPE_BUFFER_SIZE, &BytesRead2)) {
+
+            break;
+        }
+
+        if (BytesRead1 != BytesRead2 ||
+            memcmp(DedupeContext->Buffer1, DedupeContext->Buffer2, BytesRead1) != 0) {
+
+            break;
+        }
+
+        if (BytesRead1 < MKLINK_DEDUPE_BUFFER_SIZE) {
+            Identical = TRUE;
+            break;
+        }
+    }
+
+    CloseHandle(FileHandle1);
+    CloseHandle(FileHandle2);
+    return Identical;
+}
+
+/**
+ Replace a file with a hard link to another file with identical contents.
+ The link is created under a temporary name and renamed over the duplicate,
+ so if anything fails the duplicate is left intact.
+
+ @param Original Pointer to the file to link to.
+
+ @param Duplicate Pointer to the file to replace.
+
+ @param Error On failure, updated to contain the Win32 error code.
+
+ @return TRUE to indicate the duplicate was replaced, FALSE on failure.
+ */
+__success(return)
+BOOLEAN
+MklinkDedupeReplaceWithLink(
+    __in PMKLINK_DEDUPE_FILE Original,
+    __in PMKLINK_DEDUPE_FILE Duplicate,
+    __out PDWORD Error
+    )
+{
+    YORI_STRING TempName;
+    DWORD OldAttributes;
+    BOOLEAN AttributesChanged;
+
+    YoriLibInitEmptyString(&TempName);
+    YoriLibYPrintf(&TempName, _T("%y.%08x.dedupe"), &Duplicate->FilePath, GetCurrentProcessId());
+    if (TempName.StartOfString == NULL) {
+        *Error = ERROR_NOT_ENOUGH_MEMORY;
+        return FALSE;
+    }
+
+    if (!DllKernel32.pCreateHardLinkW(TempName.StartOfString, Original->FilePath.StartOfString, NULL)) {
+        *Error = GetLastError();
+        YoriLibFreeStringContents(&TempName);
+        return FALSE;
+    }
+
+    //
+    //  A read only file cannot be replaced by a rename.  The attributes of
+    //  both files are the same, so the new link already has the attributes
+    //  the duplicate had.
+    //
+
+    OldAttributes = GetFileAttributes(Duplicate->FilePath.StartOfString);
+    AttributesChanged = FALSE;
+    if (OldAttributes != (DWORD)-1 &&
+        (OldAttributes & FILE_ATTRIBUTE_READONLY) != 0) {
+
+        if (SetFileAttributes(Duplicate->FilePath.StartOfString, OldAttributes & ~(FILE_ATTRIBUTE_READONLY))) {
+            AttributesChanged = TRUE;
+        }
+    }
+
+    if (!MoveFileEx(TempName.StartOfString, Duplicate->FilePath.StartOfString, MOVEFILE_REPLACE_EXISTING)) {
+        *Error = GetLastError();
+        if (AttributesChanged) {
+            SetFileAttributes(Duplicate->FilePath.StartOfString, OldAttributes);
+        }
+        DeleteFile(TempName.StartOfString);
+        YoriLibFreeStringContents(&TempName);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&TempName);
+    return TRUE;
+}
+
+/**
+ Process a set of files which have identical full hashes.  The first file
+ becomes the original, and each other file with identical contents is
+ replaced with a hard link to it.
+
+ @param DedupeContext Pointer to the deduplication context.
+
+ @param Files Pointer to the array of files which may be duplicates.
+
+ @param Count The number of elements in the array.
+ */
+VOID
+MklinkDedupeLinkRun(
+    __in PMKLINK_DEDUPE_CONTEXT DedupeContext,
+    __in PMKLINK_DEDUPE_FILE *Files,
+    __in DWORD Count
+    )
+{
+    PMKLINK_DEDUPE_FILE Original;
+    PMKLINK_DEDUPE_FILE Duplicate;
+    LPTSTR ErrText;
+    DWORD Index;
+    DWORD Err;
+
+    Original = Files[0];
+    for (Index = 1; Index < Count; Index++) {
+        Duplicate = Files[Index];
+
+        //
+        //  If this is already a link to the same file, there's nothing to
+        //  do.
+        //
+
+        if (Duplicate->FileIndex.QuadPart == Original->FileIndex.QuadPart) {
+            continue;
+        }
+
+        if (!MklinkDedupeFilesIdentical(DedupeContext, Original, Duplicate)) {
+            continue;
+        }
+
+        if (!MklinkDedupeReplaceWithLink(Original, Duplicate, &Err)) {
+
+            //
+            //  If the original has as many links as the file system allows,
+            //  this file can become the original for the remaining files.
+            //
+
+            if (Err == ERROR_TOO_MANY_LINKS) {
+                Original = Duplicate;
+                continue;
+            }
+
+            ErrText = YoriLibGetWinErrorText(Err);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("mklink: link of %y to %y failed: %s"), &Duplicate->FilePath, &Original->FilePath, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            continue;
+        }
+
+        DedupeContext->FilesLinked++;
+
+        //
+        //  If the duplicate had other links, its data is still in use.
+        //
+
+        if (Duplicate->NumberOfLinks <= 1) {
+            DedupeContext->BytesReclaimed.QuadPart = DedupeContext->BytesReclaimed.QuadPart + Duplicate->FileSize.QuadPart;
+        }
+        Duplicate->FileIndex.QuadPart = Original->FileIndex.QuadPart;
+    }
+}
+
+/**
+ Find files with identical contents and replace all but one of each set
+ with hard links.  Files are grouped by size, then by a hash of their first
+ bytes, then by a hash of their entire contents, so most files are never
+ read, and most others only partially.  Files are only linked if they are
+ on the same volume and have the same attributes and last write time, since
+ these are shared by all links to a file.
+
+ @param ArgC The number of directories to search.
+
+ @param ArgV An array of directories to search.
+
+ @return Exit code indicating success or failure.
+ */
+DWORD
+MklinkDedupe(
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[]
+    )
+{
+    MKLINK_DEDUPE_CONTEXT DedupeContext;
+    YORI_STRING SizeString;
+    TCHAR SizeStringBuffer[16];
+    YORI_ALLOC_SIZE_T ArgIndex;
+    DWORD Index;
+    DWORD PartialIndex;
+    DWORD FullIndex;
+    DWORD RunLength;
+    DWORD PartialRunLength;
+    DWORD FullRunLength;
+    DWORD ExitCode;
+    WORD MatchFlags;
+
+    if (DllKernel32.pCreateHardLinkW == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("mklink: create hard link failed: CreateHardLinkW export not found\n"));
+        return EXIT_FAILURE;
+    }
+
+    ZeroMemory(&DedupeContext, sizeof(DedupeContext));
+    ExitCode = EXIT_FAILURE;
+
+    DedupeContext.Buffer1 = YoriLibMalloc(MKLINK_DEDUPE_BUFFER_SIZE);
+    DedupeContext.Buffer2 = YoriLibMalloc(MKLINK_DEDUPE_BUFFER_SIZE);
+    if (DedupeContext.Buffer1 == NULL || DedupeContext.Buffer2 == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("mklink: out of memory\n"));
+        goto Exit;
+    }
+
+    MatchFlags = YORILIB_FILEENUM_RETURN_FILES |
+                 YORILIB_FILEENUM_DIRECTORY_CONTENTS |
+                 YORILIB_FILEENUM_RECURSE_AFTER_RETURN |
+                 YORILIB_FILEENUM_NO_LINK_TRAVERSE |
+                 YORILIB_FILEENUM_BASIC_INFO;
+
+    for (ArgIndex = 0; ArgIndex < ArgC; ArgIndex++) {
+        YoriLibForEachFile(&ArgV[ArgIndex],
+                           MatchFlags,
+                           0,
+                           MklinkDedupeFileFoundCallback,
+                           MklinkDedupeErrorCallback,
+                           &DedupeContext);
+
+        if (DedupeContext.OutOfMemory) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("mklink: out of memory\n"));
+            goto Exit;
+        }
+    }
+
+    //
+    //  Group files by size, attributes and timestamp.  Within each group
+    //  of more than one file, hash the start of each file and regroup.
+    //  Within each resulting group of more than one file, hash the entire
+    //  file where that hasn't been done already, and regroup again.
+    //
+
+    MklinkDedupeSortFiles(DedupeContext.Files, DedupeContext.FileCount);
+
+    for (Index = 0; Index < DedupeContext.FileCount; Index += RunLength) {
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+
+        RunLength = MklinkDedupeRunLength(DedupeContext.Files, Index, DedupeContext.FileCount);
+        if (RunLength < 2) {
+            continue;
+        }
+
+        for (PartialIndex = Index; PartialIndex < Index + RunLength; PartialIndex++) {
+            MklinkDedupeHashFile(&DedupeContext, DedupeContext.Files[PartialIndex], FALSE);
+        }
+
+        MklinkDedupeSortFiles(&DedupeContext.Files[Index], RunLength);
+
+        for (PartialIndex = Index; PartialIndex < Index + RunLength; PartialIndex += PartialRunLength) {
+            PartialRunLength = MklinkDedupeRunLength(DedupeContext.Files, PartialIndex, Index + RunLength);
+            if (PartialRunLength < 2 || DedupeContext.Files[PartialIndex]->Failed) {
+                continue;
+            }
+
+            for (FullIndex = PartialIndex; FullIndex < PartialIndex + PartialRunLength; FullIndex++) {
+                if (!DedupeContext.Files[FullIndex]->FullHashValid) {
+                    MklinkDedupeHashFile(&DedupeContext, DedupeContext.Files[FullIndex], TRUE);
+                }
+            }
+
+            MklinkDedupeSortFiles(&DedupeContext.Files[PartialIndex], PartialRunLength);
+
+            for (FullIndex = PartialIndex; FullIndex < PartialIndex + PartialRunLength; FullIndex += FullRunLength) {
+                FullRunLength = MklinkDedupeRunLength(DedupeContext.Files, FullIndex, PartialIndex + PartialRunLength);
+                if (FullRunLength < 2 || DedupeContext.Files[FullIndex]->Failed) {
+                    continue;
+                }
+
+                MklinkDedupeLinkRun(&DedupeContext, &DedupeContext.Files[FullIndex], FullRunLength);
+            }
+        }
+    }
+
+    YoriLibInitEmptyString(&SizeString);
+    SizeString.StartOfString = SizeStringBuffer;
+    SizeString.LengthAllocated = sizeof(SizeStringBuffer)/sizeof(SizeStringBuffer[0]);
+    YoriLibFileSizeToString(&SizeString, &DedupeContext.BytesReclaimed);
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("%i files examined, %i files linked, %y reclaimed\n"),
+                  DedupeContext.FileCount,
+                  DedupeContext.FilesLinked,
+                  &SizeString);
+
+    ExitCode = EXIT_SUCCESS;
+
+Exit:
+
+    for (Index = 0; Index < DedupeContext.FileCount; Index++) {
+        YoriLibFreeStringContents(&DedupeContext.Files[Index]->FilePath);
+        YoriLibFree(DedupeContext.Files[Index]);
+    }
+
+    if (DedupeContext.Files != NULL) {
+        YoriLibFree(DedupeContext.Files);
+    }
+
+    if (DedupeContext.Buffer1 != NULL) {
+        YoriLibFree(DedupeContext.Buffer1);
+    }
+
+    if (DedupeContext.Buffer2 != NULL) {
+        YoriLibFree(DedupeContext.Buffer2);
+    }
+
+    return ExitCode;
+}
+
 /**
  Specifies the type of link to create.
  */
@@ -279,6 +1231,7 @@ ENTRYPOINT(
     YORI_STRING Arg;
     DWORD ExitCode;
     DWORD SymLinkFlags;
+    BOOLEAN Dedupe = FALSE;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -296,6 +1249,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("d")) == 0) {
                 LinkType = MklinkLinkTypeDirSym;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("dedupe")) == 0) {
+                Dedupe = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("f")) == 0) {
                 LinkType = MklinkLinkTypeFileSym;
                 ArgumentUnderstood = TRUE;
@@ -321,6 +1277,21 @@ ENTRYPOINT(
         }
     }
 
+    if (Dedupe) {
+        if (i >= ArgC) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("mklink: missing argument\n"));
+            return EXIT_FAILURE;
+        }
+
+        YoriLibEnableBackupPrivilege();
+
+#if YORI_BUILTIN
+        YoriLibCancelEnable(FALSE);
+#endif
+
+        return MklinkDedupe(ArgC - StartArg, &ArgV[StartArg]);
+    }
+
     if (StartArg == 0 || ArgC - StartArg < 2) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("mklink: missing argument\n"));
         return EXIT_FAILURE;
@@ -0,0 +1,522 @@
+/**
+ * @file more/filter.c
+ *
+ * Yori shell more background filtering
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "more.h"
+
+/**
+ Check whether a physical line matches the filter being applied.  This is
+ called from a filter thread, so lines from mapped files are decoded via the
+ thread's own view rather than the contents retained for display.
+
+ @param Worker Pointer to the filter thread.
+
+ @param PhysicalLine Pointer to the physical line to check.
+
+ @return TRUE if the line matches the filter, FALSE if it does not.
+ */
+BOOLEAN
+MoreFilterLineMatches(
+    __in PMORE_FILTER_WORKER Worker,
+    __in PMORE_PHYSICAL_LINE PhysicalLine
+    )
+{
+    PMORE_CONTEXT MoreContext;
+    PMORE_MAPPED_SOURCE Source;
+    YORI_STRING DecodedLine;
+    PUCHAR Buffer;
+    BOOLEAN Matches;
+
+    MoreContext = Worker->MoreContext;
+    Source = PhysicalLine->MappedSource;
+    if (Source == NULL) {
+        if (YoriLibFindFirstMatchSubstrIns(&PhysicalLine->LineContents, MoreContext->Filter.SearchCount, MoreContext->Filter.SearchStrings, NULL) != NULL) {
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    if (Worker->ViewSource != Source) {
+        if (Worker->View.Base != NULL) {
+            UnmapViewOfFile(Worker->View.Base);
+        }
+        ZeroMemory(&Worker->View, sizeof(Worker->View));
+        Worker->ViewSource = Source;
+    }
+
+    Buffer = MoreMapSourceRange(Source, &Worker->View, PhysicalLine->SourceOffset, PhysicalLine->SourceLength);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&DecodedLine);
+    if (!MoreDecodeMappedLine(MoreContext, Source->Encoding, Buffer, PhysicalLine->SourceLength, &DecodedLine)) {
+        return FALSE;
+    }
+
+    Matches = FALSE;
+    if (YoriLibFindFirstMatchSubstrIns(&DecodedLine, MoreContext->Filter.SearchCount, MoreContext->Filter.SearchStrings, NULL) != NULL) {
+        Matches = TRUE;
+    }
+
+    YoriLibFreeStringContents(&DecodedLine);
+    return Matches;
+}
+
+/**
+ Publish the results of any completed ranges, in order, to the set of
+ filtered lines.  A completed range cannot be published until all earlier
+ ranges have been published.  The caller is expected to hold
+ MORE_CONTEXT::PhysicalLineMutex .
+
+ @param MoreContext Pointer to the more context.
+ */
+VOID
+MoreFilterPublishRanges(
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    PMORE_FILTER_STATE Filter;
+    PMORE_FILTER_RANGE Range;
+    PMORE_PHYSICAL_LINE PhysicalLine;
+    DWORDLONG Index;
+    BOOLEAN Published;
+
+    Filter = &MoreContext->Filter;
+    Published = FALSE;
+
+    while (Filter->RangesPublished != Filter->RangesClaimed) {
+        Range = &Filter->Ranges[Filter->RangesPublished % MORE_FILTER_RANGE_COUNT];
+        if (!Range->Complete) {
+            break;
+        }
+
+        if (!Filter->Cancel) {
+            ASSERT(Range->Start == MoreContext->FilterScanLineCount);
+            for (Index = Range->Start; Index < Range->End; Index++) {
+                PhysicalLine = MoreLineIndexGet(&MoreContext->PhysicalLines, Index);
+                if (PhysicalLine->FilterMatch) {
+                    if (!MoreLineIndexSet(&MoreContext->FilteredPhysicalLines, MoreContext->FilteredLineCount, PhysicalLine)) {
+                        MoreContext->OutOfMemory = TRUE;
+                        break;
+                    }
+                    MoreContext->FilteredLineCount++;
+                    PhysicalLine->FilteredLineNumber = MoreContext->FilteredLineCount;
+                }
+            }
+            MoreContext->FilterScanLineCount = Range->End;
+            Published = TRUE;
+        }
+
+        Filter->RangesPublished++;
+    }
+
+    //
+    //  Tell the viewport there may be new lines to display, and since a
+    //  range has been released, tell any thread waiting for a free range
+    //  that there is one.
+    //
+
+    if (Published) {
+        SetEvent(MoreContext->PhysicalLineAvailableEvent);
+        if (Filter->NextLine < MoreContext->LineCount) {
+            SetEvent(Filter->WorkEvent);
+        }
+    }
+}
+
+/**
+ A filter thread.  This claims ranges of physical lines, compares each line
+ against the filter, and publishes the results.
+
+ @param Context Pointer to the filter thread's MORE_FILTER_WORKER structure.
+
+ @return Exit code for the thread, which is zero.
+ */
+DWORD WINAPI
+MoreFilterWorker(
+    __in LPVOID Context
+    )
+{
+    PMORE_FILTER_WORKER Worker;
+    PMORE_CONTEXT MoreContext;
+    PMORE_FILTER_STATE Filter;
+    PMORE_FILTER_RANGE Range;
+    PMORE_PHYSICAL_LINE *Chunk;
+    HANDLE WaitHandles[2];
+    DWORDLONG Index;
+    DWORDLONG End;
+
+    Worker = (PMORE_FILTER_WORKER)Context;
+    MoreContext = Worker->MoreContext;
+    Filter = &MoreContext->Filter;
+
+    WaitHandles[0] = Filter->WorkEvent;
+    WaitHandles[1] = Filter->ExitEvent;
+
+    while (WaitForMultipleObjects(2, WaitHandles, FALSE, INFINITE) == WAIT_OBJECT_0) {
+
+        WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+        Range = NULL;
+
+        while (TRUE) {
+
+            if (Range != NULL) {
+                Range->Complete = TRUE;
+                ASSERT(Filter->ActiveWorkers > 0);
+                Filter->ActiveWorkers--;
+                MoreFilterPublishRanges(MoreContext);
+                Range = NULL;
+            }
+
+            //
+            //  If there is nothing to claim, wait for more work.  If no
+            //  other thread is active, the filter is either complete or
+            //  abandoned.
+            //
+
+            if (Filter->Cancel ||
+                Filter->NextLine >= MoreContext->LineCount ||
+                Filter->RangesClaimed - Filter->RangesPublished >= MORE_FILTER_RANGE_COUNT) {
+
+                ResetEvent(Filter->WorkEvent);
+                if (Filter->ActiveWorkers == 0) {
+                    SetEvent(Filter->IdleEvent);
+                }
+                break;
+            }
+
+            //
+            //  Claim lines up to the end of the chunk containing the next
+            //  unclaimed line, so that the chunk can be referenced without
+            //  holding the mutex.  Chunks never move once allocated.
+            //
+
+            End = Filter->NextLine - (Filter->NextLine % MORE_LINE_INDEX_CHUNK_SIZE) + MORE_LINE_INDEX_CHUNK_SIZE;
+            if (End > MoreContext->LineCount) {
+                End = MoreContext->LineCount;
+            }
+
+            Range = &Filter->Ranges[Filter->RangesClaimed % MORE_FILTER_RANGE_COUNT];
+            Range->Start = Filter->NextLine;
+            Range->End = End;
+            Range->Complete = FALSE;
+            Filter->RangesClaimed++;
+            Filter->NextLine = End;
+            Filter->ActiveWorkers++;
+
+            Chunk = MoreContext->PhysicalLines.Chunks[Range->Start / MORE_LINE_INDEX_CHUNK_SIZE];
+            ReleaseMutex(MoreContext->PhysicalLineMutex);
+
+            for (Index = Range->Start; Index < Range->End; Index++) {
+                if (Filter->Cancel) {
+                    break;
+                }
+                Chunk[Index % MORE_LINE_INDEX_CHUNK_SIZE]->FilterMatch = MoreFilterLineMatches(Worker, Chunk[Index % MORE_LINE_INDEX_CHUNK_SIZE]);
+            }
+
+            WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+        }
+
+        ReleaseMutex(MoreContext->PhysicalLineMutex);
+    }
+
+    if (Worker->View.Base != NULL) {
+        UnmapViewOfFile(Worker->View.Base);
+        Worker->View.Base = NULL;
+    }
+
+    return 0;
+}
+
+/**
+ Create the filter threads if they have not been created already.
+
+ @param MoreContext Pointer to the more context.
+
+ @return TRUE if at least one filter thread exists, FALSE if filters must be
+         applied synchronously.
+ */
+__success(return)
+BOOLEAN
+MoreFilterInitialize(
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    PMORE_FILTER_STATE Filter;
+    PMORE_FILTER_WORKER Worker;
+    SYSTEM_INFO SystemInfo;
+    DWORD WorkerCount;
+    DWORD ThreadId;
+
+    Filter = &MoreContext->Filter;
+    if (Filter->WorkerCount > 0) {
+        return TRUE;
+    }
+
+    if (Filter->WorkEvent == NULL) {
+        Filter->WorkEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if (Filter->WorkEvent == NULL) {
+            return FALSE;
+        }
+    }
+
+    if (Filter->IdleEvent == NULL) {
+        Filter->IdleEvent = CreateEvent(NULL, TRUE, TRUE, NULL);
+        if (Filter->IdleEvent == NULL) {
+            return FALSE;
+        }
+    }
+
+    if (Filter->ExitEvent == NULL) {
+        Filter->ExitEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if (Filter->ExitEvent == NULL) {
+            return FALSE;
+        }
+    }
+
+    //
+    //  Each thread can map a view of a file, so on 32 bit systems only use
+    //  a small number of threads to avoid exhausting address space.
+    //
+
+    GetSystemInfo(&SystemInfo);
+    WorkerCount = SystemInfo.dwNumberOfProcessors;
+    if (WorkerCount < 1) {
+        WorkerCount = 1;
+    }
+    if (WorkerCount > MORE_FILTER_MAX_WORKERS) {
+        WorkerCount = MORE_FILTER_MAX_WORKERS;
+    }
+    if (sizeof(PVOID) < 8 && WorkerCount > 2) {
+        WorkerCount = 2;
+    }
+
+    while (Filter->WorkerCount < WorkerCount) {
+        Worker = &Filter->Workers[Filter->WorkerCount];
+        Worker->MoreContext = MoreContext;
+        Worker->Thread = CreateThread(NULL, 0, MoreFilterWorker, Worker, 0, &ThreadId);
+        if (Worker->Thread == NULL) {
+            break;
+        }
+        Filter->WorkerCount++;
+    }
+
+    if (Filter->WorkerCount == 0) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Free the copy of the search strings being applied as a filter.  The caller
+ is expected to ensure no filter thread is comparing lines.
+
+ @param MoreContext Pointer to the more context.
+ */
+VOID
+MoreFilterFreeSearchStrings(
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    UCHAR Index;
+
+    for (Index = 0; Index < MoreContext->Filter.SearchCount; Index++) {
+        YoriLibFreeStringContents(&MoreContext->Filter.SearchStrings[Index]);
+    }
+    MoreContext->Filter.SearchCount = 0;
+}
+
+/**
+ Abandon any filter being applied in the background, and wait for filter
+ threads to stop comparing lines.  On return, the set of filtered lines may
+ be incomplete, so the caller is expected to apply a filter again.
+
+ @param MoreContext Pointer to the more context.
+ */
+VOID
+MoreFilterCancel(
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    PMORE_FILTER_STATE Filter;
+    BOOLEAN Idle;
+
+    Filter = &MoreContext->Filter;
+    if (Filter->WorkerCount == 0) {
+        return;
+    }
+
+    WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+    Filter->Cancel = TRUE;
+    ResetEvent(Filter->WorkEvent);
+    Idle = (BOOLEAN)(Filter->ActiveWorkers == 0);
+    ReleaseMutex(MoreContext->PhysicalLineMutex);
+
+    if (!Idle) {
+        WaitForSingleObject(Filter->IdleEvent, INFINITE);
+    }
+}
+
+/**
+ Begin applying the current search strings as a filter in the background.
+ Any filter already being applied is abandoned.  The set of filtered lines
+ is emptied and repopulated as filter threads compare lines, and
+ MORE_CONTEXT::PhysicalLineAvailableEvent is signalled as matches are
+ published.
+
+ @param MoreContext Pointer to the more context.
+
+ @return TRUE to indicate the filter is being applied in the background,
+         FALSE if it could not be, in which case the caller should apply it
+         synchronously.
+ */
+__success(return)
+BOOLEAN
+MoreFilterStart(
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    PMORE_FILTER_STATE Filter;
+    PYORI_STRING Source;
+    PYORI_STRING Dest;
+    UCHAR SearchCount;
+    UCHAR Index;
+
+    Filter = &MoreContext->Filter;
+
+    if (!MoreFilterInitialize(MoreContext)) {
+        return FALSE;
+    }
+
+    MoreFilterCancel(MoreContext);
+    MoreFilterFreeSearchStrings(MoreContext);
+
+    SearchCount = MoreSearchCountActive(MoreContext);
+    for (Index = 0; Index < SearchCount; Index++) {
+        Source = &MoreContext->SearchStrings[Index];
+        Dest = &Filter->SearchStrings[Index];
+        if (!YoriLibAllocateString(Dest, Source->LengthInChars + 1)) {
+            MoreFilterFreeSearchStrings(MoreContext);
+            return FALSE;
+        }
+        memcpy(Dest->StartOfString, Source->StartOfString, Source->LengthInChars * sizeof(TCHAR));
+        Dest->StartOfString[Source->LengthInChars] = '\0';
+        Dest->LengthInChars = Source->LengthInChars;
+        Filter->SearchCount = (UCHAR)(Index + 1);
+    }
+
+    WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+
+    MoreContext->FilteredLineCount = 0;
+    MoreContext->FilterScanLineCount = 0;
+    Filter->NextLine = 0;
+    Filter->RangesClaimed = 0;
+    Filter->RangesPublished = 0;
+    Filter->Cancel = FALSE;
+    if (MoreContext->LineCount > 0) {
+        ResetEvent(Filter->IdleEvent);
+        SetEvent(Filter->WorkEvent);
+    }
+
+    ReleaseMutex(MoreContext->PhysicalLineMutex);
+
+    return TRUE;
+}
+
+/**
+ Return the progress of applying a filter in the background.
+
+ @param MoreContext Pointer to the more context.
+
+ @return The percentage of physical lines that have been compared against
+         the filter, or (DWORD)-1 if no filter is being applied.
+ */
+DWORD
+MoreFilterGetProgress(
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    DWORD Progress;
+
+    Progress = (DWORD)-1;
+    WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+    if (MoreContext->FilterScanLineCount < MoreContext->LineCount) {
+        Progress = (DWORD)(MoreContext->FilterScanLineCount * 100 / MoreContext->LineCount);
+    }
+    ReleaseMutex(MoreContext->PhysicalLineMutex);
+
+    return Progress;
+}
+
+/**
+ Terminate the filter threads and free any state used to apply filters in
+ the background.
+
+ @param MoreContext Pointer to the more context.
+ */
+VOID
+MoreFilterCleanup(
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    PMORE_FILTER_STATE Filter;
+    DWORD Index;
+
+    Filter = &MoreContext->Filter;
+
+    MoreFilterCancel(MoreContext);
+
+    if (Filter->ExitEvent != NULL) {
+        SetEvent(Filter->ExitEvent);
+    }
+
+    for (Index = 0; Index < Filter->WorkerCount; Index++) {
+        WaitForSingleObject(Filter->Workers[Index].Thread, INFINITE);
+        CloseHandle(Filter->Workers[Index].Thread);
+        Filter->Workers[Index].Thread = NULL;
+    }
+    Filter->WorkerCount = 0;
+
+    MoreFilterFreeSearchStrings(MoreContext);
+
+    if (Filter->WorkEvent != NULL) {
+        CloseHandle(Filter->WorkEvent);
+        Filter->WorkEvent = NULL;
+    }
+
+    if (Filter->IdleEvent != NULL) {
+        CloseHandle(Filter->IdleEvent);
+        Filter->IdleEvent = NULL;
+    }
+
+    if (Filter->ExitEvent != NULL) {
+        CloseHandle(Filter->ExitEvent);
+        Filter->ExitEvent = NULL;
+    }
+}
+
+// vim:sw=4:ts=4:et:
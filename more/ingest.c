@@ -3,7 +3,7 @@
  *
  * Yori shell more input strings and record them in memory
  *
- * Copyright (c) 2017-2021 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -26,6 +26,164 @@
 
 #include "more.h"
 
+/**
+ The maximum number of threads used to ingest files concurrently.
+ */
+#define MORE_INGEST_MAX_WORKERS 8
+
+/**
+ The number of files per ingest thread which can be found and not yet added
+ to the set of physical lines.  Enumeration pauses when this is reached, so
+ that the number of open files and retained lines is bounded.
+ */
+#define MORE_INGEST_FILES_PER_WORKER 4
+
+/**
+ A file which has been found and is being ingested by an ingest thread.
+ Lines from the file are retained here until all earlier files have been
+ added to the set of physical lines.  Once this occurs, retained lines are
+ published and later lines from the file are added directly.
+ */
+typedef struct _MORE_INGEST_FILE {
+
+    /**
+     The list of files which have not been published, in the order they
+     were found.  Paired with MORE_INGEST_STATE::FileList .
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The list of files which have not been claimed by an ingest thread.
+     Paired with MORE_INGEST_STATE::PendingList .
+     */
+    YORI_LIST_ENTRY PendingListEntry;
+
+    /**
+     The ingest thread processing this file, once claimed.
+     */
+    struct _MORE_INGEST_WORKER *Worker;
+
+    /**
+     The opened file.  This is closed by the ingest thread once the file has
+     been processed.
+     */
+    HANDLE FileHandle;
+
+    /**
+     The encoding of the file.
+     */
+    DWORD Encoding;
+
+    /**
+     Lines from the file which have not yet been added to the set of
+     physical lines.
+     */
+    MORE_LINE_INDEX Lines;
+
+    /**
+     The number of lines in Lines.
+     */
+    DWORDLONG LineCount;
+
+    /**
+     Set to TRUE once all earlier files have been published, indicating
+     that lines can be added directly to the set of physical lines.  This
+     is only ever changed from FALSE to TRUE.
+     */
+    volatile BOOLEAN Direct;
+
+    /**
+     Set to TRUE once the ingest thread has processed the entire file.
+     */
+    BOOLEAN Complete;
+} MORE_INGEST_FILE, *PMORE_INGEST_FILE;
+
+/**
+ A thread which ingests files concurrently with other ingest threads.
+ */
+typedef struct _MORE_INGEST_WORKER {
+
+    /**
+     Pointer to the ingest state.
+     */
+    struct _MORE_INGEST_STATE *State;
+
+    /**
+     Handle to the thread.
+     */
+    HANDLE Thread;
+
+    /**
+     The mapped file that View refers to, if any.
+     */
+    PMORE_MAPPED_SOURCE ViewSource;
+
+    /**
+     A view of a mapped file used by this thread to decode lines which are
+     being published, so they can be compared against any filter.
+     */
+    MORE_MAPPED_VIEW View;
+} MORE_INGEST_WORKER, *PMORE_INGEST_WORKER;
+
+/**
+ State for ingesting multiple files concurrently.  The thread enumerating
+ files adds each to FileList and PendingList, and ingest threads claim files
+ from PendingList.  Files are published in the order of FileList.
+ */
+typedef struct _MORE_INGEST_STATE {
+
+    /**
+     Pointer to the more context.
+     */
+    PMORE_CONTEXT MoreContext;
+
+    /**
+     Synchronization around the lists and files below.
+     */
+    HANDLE Mutex;
+
+    /**
+     A manual reset event which is signalled while PendingList is not empty.
+     */
+    HANDLE WorkEvent;
+
+    /**
+     A manual reset event which is signalled when ingest threads should
+     terminate once no work remains.
+     */
+    HANDLE ExitEvent;
+
+    /**
+     An auto reset event which is signalled when a file is published.
+     */
+    HANDLE PublishedEvent;
+
+    /**
+     The list of files which have not been published, in order.
+     */
+    YORI_LIST_ENTRY FileList;
+
+    /**
+     The list of files which have not been claimed by an ingest thread.
+     */
+    YORI_LIST_ENTRY PendingList;
+
+    /**
+     The number of files in FileList.
+     */
+    DWORD OutstandingFiles;
+
+    /**
+     The number of threads in Workers.
+     */
+    DWORD WorkerCount;
+
+    /**
+     The ingest threads.
+     */
+    MORE_INGEST_WORKER Workers[MORE_INGEST_MAX_WORKERS];
+} MORE_INGEST_STATE, *PMORE_INGEST_STATE;
+
 /**
  A context structure to allow a new physical line to share an allocation with
  previous physical lines.  Each added line can consume from and populate this
@@ -53,8 +211,409 @@ typedef struct _MORE_LINE_ALLOC_CONTEXT {
      updated to refer to the final color at the end of each line.
      */
     WORD PreviousColor;
+
+    /**
+     If the lines are being ingested concurrently with other files, points
+     to the file.  If NULL, lines are added directly to the set of physical
+     lines.
+     */
+    PMORE_INGEST_FILE File;
 } MORE_LINE_ALLOC_CONTEXT, *PMORE_LINE_ALLOC_CONTEXT;
 
+/**
+ Allocate space for a new physical line from the allocation, allocating a new
+ buffer if the existing one is exhausted.
+
+ @param MoreContext Pointer to the context describing process behavior.
+
+ @param AllocContext Pointer to the allocation context describing the buffer
+        that can be used for a new physical line.  This may be reallocated
+        within this routine.
+
+ @param BytesRequired The number of bytes needed for the physical line and
+        any text that follows it.
+
+ @return Pointer to the new physical line, or NULL on allocation failure.
+         On success, the physical line holds a reference on
+         AllocContext->Buffer via its MemoryToFree member.
+ */
+PMORE_PHYSICAL_LINE
+MoreAllocatePhysicalLine(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_LINE_ALLOC_CONTEXT AllocContext,
+    __in YORI_ALLOC_SIZE_T BytesRequired
+    )
+{
+    PMORE_PHYSICAL_LINE NewLine;
+    YORI_ALLOC_SIZE_T Alignment;
+
+    //
+    //  If we need a buffer, allocate a buffer that typically has space for
+    //  multiple lines
+    //
+
+    if (AllocContext->Buffer == NULL ||
+        BytesRequired > AllocContext->BytesRemainingInBuffer) {
+        if (AllocContext->Buffer != NULL) {
+            YoriLibDereference(AllocContext->Buffer);
+        }
+        AllocContext->BytesRemainingInBuffer = YoriLibMaximumAllocationInRange(16 * 1024, 64 * 1024);
+        if (BytesRequired > AllocContext->BytesRemainingInBuffer) {
+            AllocContext->BytesRemainingInBuffer = BytesRequired;
+        }
+        AllocContext->BufferOffset = 0;
+
+        AllocContext->Buffer = YoriLibReferencedMalloc(AllocContext->BytesRemainingInBuffer);
+        if (AllocContext->Buffer == NULL) {
+            MoreContext->OutOfMemory = TRUE;
+            return NULL;
+        }
+    }
+
+    NewLine = (PMORE_PHYSICAL_LINE)YoriLibAddToPointer(AllocContext->Buffer, AllocContext->BufferOffset);
+
+    YoriLibReference(AllocContext->Buffer);
+    NewLine->MemoryToFree = AllocContext->Buffer;
+    NewLine->InitialColor = AllocContext->PreviousColor;
+    NewLine->LineNumber = 0;
+    NewLine->FilteredLineNumber = 0;
+    NewLine->FilterMatch = FALSE;
+    NewLine->MappedSource = NULL;
+    NewLine->SourceOffset = 0;
+    NewLine->SourceLength = 0;
+    YoriLibInitEmptyString(&NewLine->LineContents);
+
+    AllocContext->BufferOffset = AllocContext->BufferOffset + BytesRequired;
+    AllocContext->BytesRemainingInBuffer = AllocContext->BytesRemainingInBuffer - BytesRequired;
+
+    //
+    //  Align the buffer to 8 bytes.  There's no length checking because
+    //  the allocation is assumed to be aligned to 8 bytes.
+    //
+
+    Alignment = AllocContext->BufferOffset % 8;
+    if (Alignment > 0) {
+        Alignment = 8 - Alignment;
+        AllocContext->BufferOffset = AllocContext->BufferOffset + Alignment;
+        AllocContext->BytesRemainingInBuffer = AllocContext->BytesRemainingInBuffer - Alignment;
+    }
+
+    return NewLine;
+}
+
+/**
+ Decode a line from a mapped file into a newly allocated string, replacing
+ tabs with spaces in the same way as lines that are copied at ingestion
+ time.
+
+ @param MoreContext Pointer to the context describing process behavior.
+
+ @param Encoding The encoding of the text in the file.
+
+ @param Buffer Pointer to the text of the line within the mapped file.
+
+ @param Length The number of bytes in the line.
+
+ @param Output On successful completion, populated with a newly allocated
+        string containing the line.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MoreDecodeMappedLine(
+    __in PMORE_CONTEXT MoreContext,
+    __in DWORD Encoding,
+    __in_ecount(Length) PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T Length,
+    __out PYORI_STRING Output
+    )
+{
+    YORI_ALLOC_SIZE_T TabCount;
+    YORI_ALLOC_SIZE_T CharsDecoded;
+    YORI_ALLOC_SIZE_T SrcIndex;
+    YORI_ALLOC_SIZE_T DestIndex;
+    YORI_ALLOC_SIZE_T TabIndex;
+
+    //
+    //  A tab is a single byte in any 8 bit encoding, so tabs can be counted
+    //  before decoding.
+    //
+
+    TabCount = 0;
+    for (SrcIndex = 0; SrcIndex < Length; SrcIndex++) {
+        if (Buffer[SrcIndex] == '\t') {
+            TabCount++;
+        }
+    }
+
+    CharsDecoded = 0;
+    if (Length > 0) {
+        CharsDecoded = (YORI_ALLOC_SIZE_T)MultiByteToWideChar(Encoding, 0, (LPCSTR)Buffer, Length, NULL, 0);
+        if (CharsDecoded == 0) {
+            return FALSE;
+        }
+    }
+
+    if (!YoriLibAllocateString(Output, CharsDecoded + TabCount * (MoreContext->TabWidth - 1) + 1)) {
+        return FALSE;
+    }
+
+    if (CharsDecoded > 0) {
+        MultiByteToWideChar(Encoding, 0, (LPCSTR)Buffer, Length, Output->StartOfString, CharsDecoded);
+    }
+
+    //
+    //  Expand tabs from the end of the string so the expansion can happen
+    //  within the same buffer.
+    //
+
+    DestIndex = CharsDecoded + TabCount * (MoreContext->TabWidth - 1);
+    Output->StartOfString[DestIndex] = '\0';
+    Output->LengthInChars = DestIndex;
+
+    if (TabCount > 0) {
+        for (SrcIndex = CharsDecoded; SrcIndex > 0; SrcIndex--) {
+            if (Output->StartOfString[SrcIndex - 1] == '\t') {
+                for (TabIndex = 0; TabIndex < MoreContext->TabWidth; TabIndex++) {
+                    DestIndex--;
+                    Output->StartOfString[DestIndex] = ' ';
+                }
+            } else {
+                DestIndex--;
+                Output->StartOfString[DestIndex] = Output->StartOfString[SrcIndex - 1];
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Insert a newly populated physical line into the set of lines, and into the
+ set of filtered lines if it matches the filter criteria.
+
+ @param MoreContext Pointer to the context describing process behavior.
+
+ @param NewLine Pointer to the new physical line.
+
+ @param SourceBuffer If the line refers to a mapped file, points to the text
+        of the line within the file, so that it can be decoded to apply any
+        filter.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.  On
+         failure, the physical line has been freed.
+ */
+BOOLEAN
+MoreInsertPhysicalLine(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_PHYSICAL_LINE NewLine,
+    __in_opt PUCHAR SourceBuffer
+    )
+{
+    YORI_STRING DecodedLine;
+    PYORI_STRING LineContents;
+    BOOLEAN Matches;
+
+    WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+    NewLine->LineNumber = MoreContext->LineCount + 1;
+    NewLine->FilteredLineNumber = NewLine->LineNumber;
+    if (!MoreLineIndexSet(&MoreContext->PhysicalLines, MoreContext->LineCount, NewLine)) {
+        MoreContext->OutOfMemory = TRUE;
+        ReleaseMutex(MoreContext->PhysicalLineMutex);
+        YoriLibFreeStringContents(&NewLine->LineContents);
+        YoriLibDereference(NewLine->MemoryToFree);
+        return FALSE;
+    }
+    MoreContext->LineCount++;
+
+    //
+    //  If a filter is being applied in the background, the filter threads
+    //  will reach this line.  Otherwise, compare it against the filter now.
+    //
+
+    if (MoreContext->FilterScanLineCount + 1 != MoreContext->LineCount) {
+        if (!MoreContext->Filter.Cancel) {
+            SetEvent(MoreContext->Filter.WorkEvent);
+        }
+        ReleaseMutex(MoreContext->PhysicalLineMutex);
+        return TRUE;
+    }
+
+    Matches = TRUE;
+    if (MoreContext->FilterToSearch) {
+        YoriLibInitEmptyString(&DecodedLine);
+        LineContents = &NewLine->LineContents;
+        if (NewLine->MappedSource != NULL && SourceBuffer != NULL) {
+            MoreDecodeMappedLine(MoreContext, NewLine->MappedSource->Encoding, SourceBuffer, NewLine->SourceLength, &DecodedLine);
+            LineContents = &DecodedLine;
+        }
+        Matches = MoreFindNextSearchMatch(MoreContext, LineContents, NULL, NULL);
+        YoriLibFreeStringContents(&DecodedLine);
+    }
+
+    //
+    //  If the filtered index cannot grow, the line is still displayed
+    //  when unfiltered, so this is not fatal to the physical line.
+    //
+
+    if (Matches) {
+        if (MoreLineIndexSet(&MoreContext->FilteredPhysicalLines, MoreContext->FilteredLineCount, NewLine)) {
+            MoreContext->FilteredLineCount++;
+            NewLine->FilteredLineNumber = MoreContext->FilteredLineCount;
+        } else {
+            MoreContext->OutOfMemory = TRUE;
+        }
+    }
+    MoreContext->FilterScanLineCount = MoreContext->LineCount;
+    ReleaseMutex(MoreContext->PhysicalLineMutex);
+
+    SetEvent(MoreContext->PhysicalLineAvailableEvent);
+    return TRUE;
+}
+
+/**
+ Free any lines retained for a file which is being ingested concurrently
+ without adding them to the set of physical lines.
+
+ @param File Pointer to the file.
+ */
+VOID
+MoreIngestFreeLines(
+    __in PMORE_INGEST_FILE File
+    )
+{
+    PMORE_PHYSICAL_LINE PhysicalLine;
+    DWORDLONG Index;
+
+    for (Index = 0; Index < File->LineCount; Index++) {
+        PhysicalLine = MoreLineIndexGet(&File->Lines, Index);
+        YoriLibFreeStringContents(&PhysicalLine->LineContents);
+        YoriLibDereference(PhysicalLine->MemoryToFree);
+    }
+    MoreLineIndexFree(&File->Lines);
+    File->LineCount = 0;
+}
+
+/**
+ Add any lines retained for a file which is being ingested concurrently to
+ the set of physical lines.  The caller is expected to ensure that all
+ earlier files have been published.
+
+ @param Worker Pointer to the ingest thread performing the publish.  Lines
+        from mapped files are decoded via this thread's view so they can be
+        compared against any filter.
+
+ @param File Pointer to the file.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.  On
+         failure, all retained lines have been freed.
+ */
+BOOLEAN
+MoreIngestPublishLines(
+    __in PMORE_INGEST_WORKER Worker,
+    __in PMORE_INGEST_FILE File
+    )
+{
+    PMORE_CONTEXT MoreContext;
+    PMORE_PHYSICAL_LINE PhysicalLine;
+    PMORE_MAPPED_SOURCE Source;
+    PUCHAR Buffer;
+    DWORDLONG Index;
+
+    MoreContext = Worker->State->MoreContext;
+    for (Index = 0; Index < File->LineCount; Index++) {
+        PhysicalLine = MoreLineIndexGet(&File->Lines, Index);
+        Buffer = NULL;
+        Source = PhysicalLine->MappedSource;
+        if (Source != NULL && MoreContext->FilterToSearch) {
+            if (Worker->ViewSource != Source) {
+                if (Worker->View.Base != NULL) {
+                    UnmapViewOfFile(Worker->View.Base);
+                }
+                ZeroMemory(&Worker->View, sizeof(Worker->View));
+                Worker->ViewSource = Source;
+            }
+            Buffer = MoreMapSourceRange(Source, &Worker->View, PhysicalLine->SourceOffset, PhysicalLine->SourceLength);
+        }
+
+        if (!MoreInsertPhysicalLine(MoreContext, PhysicalLine, Buffer)) {
+
+            //
+            //  The line that failed has been freed.  Free the rest.
+            //
+
+            for (Index++; Index < File->LineCount; Index++) {
+                PhysicalLine = MoreLineIndexGet(&File->Lines, Index);
+                YoriLibFreeStringContents(&PhysicalLine->LineContents);
+                YoriLibDereference(PhysicalLine->MemoryToFree);
+            }
+            MoreLineIndexFree(&File->Lines);
+            File->LineCount = 0;
+            return FALSE;
+        }
+    }
+
+    MoreLineIndexFree(&File->Lines);
+    File->LineCount = 0;
+    return TRUE;
+}
+
+/**
+ Add a newly populated physical line.  If the line is from a file being
+ ingested concurrently and earlier files have not been published, the line
+ is retained with the file; otherwise it is inserted into the set of lines.
+
+ @param MoreContext Pointer to the context describing process behavior.
+
+ @param AllocContext Pointer to the allocation context used to allocate the
+        line, indicating the file being ingested.
+
+ @param NewLine Pointer to the new physical line.
+
+ @param SourceBuffer If the line refers to a mapped file, points to the text
+        of the line within the file, so that it can be decoded to apply any
+        filter.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.  On
+         failure, the physical line has been freed.
+ */
+BOOLEAN
+MoreIngestPhysicalLine(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_LINE_ALLOC_CONTEXT AllocContext,
+    __in PMORE_PHYSICAL_LINE NewLine,
+    __in_opt PUCHAR SourceBuffer
+    )
+{
+    PMORE_INGEST_FILE File;
+
+    File = AllocContext->File;
+    if (File == NULL) {
+        return MoreInsertPhysicalLine(MoreContext, NewLine, SourceBuffer);
+    }
+
+    if (File->Direct) {
+        if (File->LineCount > 0 &&
+            !MoreIngestPublishLines(File->Worker, File)) {
+
+            YoriLibFreeStringContents(&NewLine->LineContents);
+            YoriLibDereference(NewLine->MemoryToFree);
+            return FALSE;
+        }
+        return MoreInsertPhysicalLine(MoreContext, NewLine, SourceBuffer);
+    }
+
+    if (!MoreLineIndexSet(&File->Lines, File->LineCount, NewLine)) {
+        MoreContext->OutOfMemory = TRUE;
+        YoriLibFreeStringContents(&NewLine->LineContents);
+        YoriLibDereference(NewLine->MemoryToFree);
+        return FALSE;
+    }
+    File->LineCount++;
+    return TRUE;
+}
+
 /**
  Add a new physical line to the allocation.
 
@@ -82,7 +641,6 @@ MoreAddPhysicalLineToBuffer(
     YORI_ALLOC_SIZE_T CharIndex;
     YORI_ALLOC_SIZE_T DestIndex;
     YORI_ALLOC_SIZE_T TabIndex;
-    YORI_ALLOC_SIZE_T Alignment;
     YORI_ALLOC_SIZE_T BytesRequired;
 
     //
@@ -108,124 +666,457 @@ MoreAddPhysicalLineToBuffer(
     BytesRequired = sizeof(MORE_PHYSICAL_LINE) + (LineString->LengthInChars + TabCount * (MoreContext->TabWidth - 1) + 1) * sizeof(TCHAR);
 
     //
-    //  If we need a buffer, allocate a buffer that typically has space for
-    //  multiple lines
+    //  Write this line into the current buffer
     //
 
-    if (AllocContext->Buffer == NULL ||
-        BytesRequired > AllocContext->BytesRemainingInBuffer) {
-        if (AllocContext->Buffer != NULL) {
-            YoriLibDereference(AllocContext->Buffer);
+    NewLine = MoreAllocatePhysicalLine(MoreContext, AllocContext, BytesRequired);
+    if (NewLine == NULL) {
+        return FALSE;
+    }
+
+    YoriLibReference(NewLine->MemoryToFree);
+    NewLine->LineContents.MemoryToFree = NewLine->MemoryToFree;
+    NewLine->LineContents.StartOfString = (LPTSTR)(NewLine + 1);
+
+    for (CharIndex = 0, DestIndex = 0; CharIndex < LineString->LengthInChars; CharIndex++) {
+        //
+        //  If the string is <ESC>[, then treat it as an escape sequence.
+        //  Look for the final letter after any numbers or semicolon.
+        //
+
+        if (LineString->LengthInChars > CharIndex + 2 &&
+            LineString->StartOfString[CharIndex] == 27 &&
+            LineString->StartOfString[CharIndex + 1] == '[') {
+
+            YORI_STRING EscapeSubset;
+            YORI_ALLOC_SIZE_T EndOfEscape;
+
+            YoriLibInitEmptyString(&EscapeSubset);
+            EscapeSubset.StartOfString = &LineString->StartOfString[CharIndex + 2];
+            EscapeSubset.LengthInChars = LineString->LengthInChars - CharIndex - 2;
+            EndOfEscape = YoriLibCntStringWithChars(&EscapeSubset, _T("0123456789;"));
+
+            //
+            //  Look for color changes so any later line can be marked as
+            //  starting with this color.
+            //
+
+            if (LineString->LengthInChars > CharIndex + 2 + EndOfEscape) {
+                EscapeSubset.StartOfString -= 2;
+                EscapeSubset.LengthInChars = EndOfEscape + 3;
+                YoriLibVtFinalColorFromEsc(AllocContext->PreviousColor, &EscapeSubset, &AllocContext->PreviousColor);
+            }
         }
-        AllocContext->BytesRemainingInBuffer = YoriLibMaximumAllocationInRange(16 * 1024, 64 * 1024);
-        if (BytesRequired > AllocContext->BytesRemainingInBuffer) {
-            AllocContext->BytesRemainingInBuffer = BytesRequired;
+        if (LineString->StartOfString[CharIndex] == '\t') {
+            for (TabIndex = 0; TabIndex < MoreContext->TabWidth; TabIndex++) {
+                NewLine->LineContents.StartOfString[DestIndex] = ' ';
+                DestIndex++;
+            }
+        } else {
+            NewLine->LineContents.StartOfString[DestIndex] = LineString->StartOfString[CharIndex];
+            DestIndex++;
         }
-        AllocContext->BufferOffset = 0;
+    }
+    NewLine->LineContents.StartOfString[DestIndex] = '\0';
+    NewLine->LineContents.LengthInChars = DestIndex;
+    NewLine->LineContents.LengthAllocated = DestIndex + 1;
 
-        AllocContext->Buffer = YoriLibReferencedMalloc(AllocContext->BytesRemainingInBuffer);
-        if (AllocContext->Buffer == NULL) {
-            MoreContext->OutOfMemory = TRUE;
-            return FALSE;
+    //
+    //  Insert the new line into the list
+    //
+
+    return MoreIngestPhysicalLine(MoreContext, AllocContext, NewLine, NULL);
+}
+
+/**
+ Add a new physical line which refers to a range of a mapped file.  The text
+ is not copied; it is decoded from the file when it is needed.
+
+ @param MoreContext Pointer to the context describing process behavior.
+
+ @param Source Pointer to the mapped file.
+
+ @param Offset The offset of the line within the file.
+
+ @param Buffer Pointer to the text of the line within the mapped file.
+
+ @param Length The number of bytes in the line, not including the line
+        ending.
+
+ @param AllocContext Pointer to the allocation context describing the buffer
+        that can be used for a new physical line.  This may be reallocated
+        within this routine.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  Failure
+         implies allocation failure, suggesting execution cannot continue.
+ */
+BOOL
+MoreAddMappedPhysicalLine(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_MAPPED_SOURCE Source,
+    __in DWORDLONG Offset,
+    __in_ecount(Length) PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T Length,
+    __in PMORE_LINE_ALLOC_CONTEXT AllocContext
+    )
+{
+    PMORE_PHYSICAL_LINE NewLine;
+    YORI_ALLOC_SIZE_T CharIndex;
+    YORI_ALLOC_SIZE_T EndOfEscape;
+    YORI_ALLOC_SIZE_T EscapeIndex;
+    YORI_STRING EscapeSubset;
+    TCHAR EscapeBuffer[64];
+
+    NewLine = MoreAllocatePhysicalLine(MoreContext, AllocContext, sizeof(MORE_PHYSICAL_LINE));
+    if (NewLine == NULL) {
+        return FALSE;
+    }
+
+    NewLine->MappedSource = Source;
+    NewLine->SourceOffset = Offset;
+    NewLine->SourceLength = Length;
+
+    //
+    //  Look for color changes so any later line can be marked as starting
+    //  with this color.  Escape sequences are only composed of characters
+    //  that have the same value in any 8 bit encoding, so this can be done
+    //  without decoding the line.
+    //
+
+    YoriLibInitEmptyString(&EscapeSubset);
+    EscapeSubset.StartOfString = EscapeBuffer;
+    EscapeSubset.LengthAllocated = sizeof(EscapeBuffer)/sizeof(EscapeBuffer[0]);
+
+    for (CharIndex = 0; CharIndex + 2 < Length; CharIndex++) {
+        if (Buffer[CharIndex] != 27 || Buffer[CharIndex + 1] != '[') {
+            continue;
+        }
+
+        for (EndOfEscape = CharIndex + 2; EndOfEscape < Length; EndOfEscape++) {
+            if ((Buffer[EndOfEscape] < '0' || Buffer[EndOfEscape] > '9') &&
+                Buffer[EndOfEscape] != ';') {
+                break;
+            }
         }
+
+        if (EndOfEscape < Length &&
+            EndOfEscape - CharIndex + 1 <= EscapeSubset.LengthAllocated) {
+
+            for (EscapeIndex = CharIndex; EscapeIndex <= EndOfEscape; EscapeIndex++) {
+                EscapeBuffer[EscapeIndex - CharIndex] = Buffer[EscapeIndex];
+            }
+            EscapeSubset.LengthInChars = EndOfEscape - CharIndex + 1;
+            YoriLibVtFinalColorFromEsc(AllocContext->PreviousColor, &EscapeSubset, &AllocContext->PreviousColor);
+        }
+    }
+
+    //
+    //  Insert the new line into the list
+    //
+
+    return MoreIngestPhysicalLine(MoreContext, AllocContext, NewLine, Buffer);
+}
+
+/**
+ Return a pointer to a range of a mapped file, mapping a new view of the file
+ if the range is not within the currently mapped view.
+
+ @param Source Pointer to the mapped file.
+
+ @param View Pointer to the view to use.  If the range is not within this
+        view, it is unmapped and a new view is mapped.
+
+ @param Offset The offset within the file of the range.
+
+ @param Length The number of bytes in the range.
+
+ @return Pointer to the range, or NULL if it could not be mapped.
+ */
+PUCHAR
+MoreMapSourceRange(
+    __in PMORE_MAPPED_SOURCE Source,
+    __inout PMORE_MAPPED_VIEW View,
+    __in DWORDLONG Offset,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    DWORDLONG ViewOffset;
+    DWORDLONG ViewLength;
+
+    if (View->Base != NULL &&
+        Offset >= View->Offset &&
+        Offset + Length <= View->Offset + View->Length) {
+
+        return View->Base + (DWORD)(Offset - View->Offset);
+    }
+
+    if (View->Base != NULL) {
+        UnmapViewOfFile(View->Base);
+        View->Base = NULL;
+    }
+
+    ViewOffset = Offset - (Offset % Source->AllocationGranularity);
+    ViewLength = MORE_MAPPED_VIEW_SIZE;
+    if (ViewLength < Offset - ViewOffset + Length) {
+        ViewLength = Offset - ViewOffset + Length;
+    }
+    if (ViewOffset + ViewLength > Source->FileSize) {
+        ViewLength = Source->FileSize - ViewOffset;
+    }
+
+    View->Base = MapViewOfFile(Source->MappingHandle, FILE_MAP_READ, (DWORD)(ViewOffset >> 32), (DWORD)ViewOffset, (SIZE_T)ViewLength);
+    if (View->Base == NULL) {
+        return NULL;
+    }
+
+    View->Offset = ViewOffset;
+    View->Length = (DWORD)ViewLength;
+
+    return View->Base + (DWORD)(Offset - ViewOffset);
+}
+
+/**
+ Return the contents of a physical line.  Lines from mapped files are decoded
+ when this is called, and the decoded contents of a bounded number of lines
+ are retained so memory usage does not scale with the size of the file.
+ Logical lines hold their own reference on the decoded contents, so
+ discarding the contents from the physical line does not affect anything
+ being displayed.  This function is only called from the viewport thread.
+
+ @param MoreContext Pointer to the context describing process behavior.
+
+ @param PhysicalLine Pointer to the physical line.
+
+ @return Pointer to the contents of the physical line.  If a line from a
+         mapped file cannot be decoded, this is an empty string.
+ */
+PYORI_STRING
+MoreGetPhysicalLineContents(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_PHYSICAL_LINE PhysicalLine
+    )
+{
+    PMORE_MAPPED_SOURCE Source;
+    PMORE_PHYSICAL_LINE DiscardLine;
+    PUCHAR Buffer;
+
+    Source = PhysicalLine->MappedSource;
+    if (Source == NULL || PhysicalLine->LineContents.StartOfString != NULL) {
+        return &PhysicalLine->LineContents;
+    }
+
+    DiscardLine = MoreContext->DecodedLines[MoreContext->DecodedLineIndex];
+    if (DiscardLine != NULL) {
+        YoriLibFreeStringContents(&DiscardLine->LineContents);
+        MoreContext->DecodedLines[MoreContext->DecodedLineIndex] = NULL;
+    }
+
+    Buffer = MoreMapSourceRange(Source, &Source->DecodeView, PhysicalLine->SourceOffset, PhysicalLine->SourceLength);
+    if (Buffer == NULL) {
+        return &PhysicalLine->LineContents;
+    }
+
+    if (!MoreDecodeMappedLine(MoreContext, Source->Encoding, Buffer, PhysicalLine->SourceLength, &PhysicalLine->LineContents)) {
+        return &PhysicalLine->LineContents;
+    }
+
+    MoreContext->DecodedLines[MoreContext->DecodedLineIndex] = PhysicalLine;
+    MoreContext->DecodedLineIndex++;
+    if (MoreContext->DecodedLineIndex >= MORE_DECODED_LINE_COUNT) {
+        MoreContext->DecodedLineIndex = 0;
+    }
+
+    return &PhysicalLine->LineContents;
+}
+
+/**
+ Ingest a file by mapping it and recording the location of each line within
+ the file, rather than copying the text of each line.  This is only possible
+ for files on disk in an 8 bit encoding which are not expected to change.
+
+ @param hSource The opened file.
+
+ @param MoreContext Pointer to context information specifying which lines to
+        display.
+
+ @param Encoding The encoding of the file.
+
+ @param File If the file is being ingested concurrently with other files,
+        points to the file.  If NULL, lines are added directly.
+
+ @return TRUE to indicate the file was processed, FALSE if it should be
+         processed as a stream instead.
+ */
+BOOL
+MoreProcessMappedFile(
+    __in HANDLE hSource,
+    __in PMORE_CONTEXT MoreContext,
+    __in DWORD Encoding,
+    __in_opt PMORE_INGEST_FILE File
+    )
+{
+    PMORE_MAPPED_SOURCE Source;
+    MORE_MAPPED_VIEW IngestView;
+    MORE_LINE_ALLOC_CONTEXT AllocContext;
+    SYSTEM_INFO SystemInfo;
+    LARGE_INTEGER FileSize;
+    DWORDLONG Offset;
+    DWORDLONG Remaining;
+    YORI_ALLOC_SIZE_T ChunkLength;
+    YORI_ALLOC_SIZE_T LineLength;
+    YORI_ALLOC_SIZE_T Consumed;
+    PUCHAR Buffer;
+
+    if (MoreContext->WaitForMore ||
+        GetFileType(hSource) != FILE_TYPE_DISK) {
+
+        return FALSE;
+    }
+
+    if (Encoding == CP_UTF16) {
+        return FALSE;
+    }
+
+    FileSize.LowPart = GetFileSize(hSource, (LPDWORD)&FileSize.HighPart);
+    if (FileSize.LowPart == (DWORD)-1 && GetLastError() != NO_ERROR) {
+        return FALSE;
     }
 
-    //
-    //  Write this line into the current buffer
-    //
+    //
+    //  A mapping of an empty file cannot be created.  An empty file has no
+    //  lines, so there's nothing to do.
+    //
+
+    if (FileSize.QuadPart == 0) {
+        return TRUE;
+    }
+
+    Source = YoriLibMalloc(sizeof(MORE_MAPPED_SOURCE));
+    if (Source == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(Source, sizeof(MORE_MAPPED_SOURCE));
+    Source->FileSize = FileSize.QuadPart;
+    Source->Encoding = Encoding;
+    GetSystemInfo(&SystemInfo);
+    Source->AllocationGranularity = SystemInfo.dwAllocationGranularity;
+
+    //
+    //  The mapping holds a reference on the file, so the caller can close
+    //  its handle once this returns.
+    //
+
+    Source->MappingHandle = CreateFileMapping(hSource, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (Source->MappingHandle == NULL) {
+        YoriLibFree(Source);
+        return FALSE;
+    }
+
+    WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+    YoriLibAppendList(&MoreContext->MappedSourceList, &Source->ListEntry);
+    ReleaseMutex(MoreContext->PhysicalLineMutex);
+
+    AllocContext.Buffer = NULL;
+    AllocContext.BytesRemainingInBuffer = 0;
+    AllocContext.BufferOffset = 0;
+    AllocContext.PreviousColor = MoreContext->InitialColor;
+    AllocContext.File = File;
+
+    IngestView.Base = NULL;
+    IngestView.Offset = 0;
+    IngestView.Length = 0;
 
-    NewLine = (PMORE_PHYSICAL_LINE)YoriLibAddToPointer(AllocContext->Buffer, AllocContext->BufferOffset);
+    Offset = 0;
+    while (Offset < Source->FileSize) {
 
-    YoriLibReference(AllocContext->Buffer);
-    NewLine->FilteredLineList.Next = NULL;
-    NewLine->FilteredLineList.Prev = NULL;
-    NewLine->MemoryToFree = AllocContext->Buffer;
-    NewLine->InitialColor = AllocContext->PreviousColor;
-    NewLine->LineNumber = MoreContext->LineCount + 1;
-    NewLine->FilteredLineNumber = NewLine->LineNumber;
-    YoriLibReference(AllocContext->Buffer);
-    NewLine->LineContents.MemoryToFree = AllocContext->Buffer;
-    NewLine->LineContents.StartOfString = (LPTSTR)(NewLine + 1);
+        Remaining = Source->FileSize - Offset;
+        ChunkLength = MORE_MAPPED_MAX_LINE_LENGTH;
+        if (Remaining < ChunkLength) {
+            ChunkLength = (YORI_ALLOC_SIZE_T)Remaining;
+        }
+
+        Buffer = MoreMapSourceRange(Source, &IngestView, Offset, ChunkLength);
+        if (Buffer == NULL) {
+            break;
+        }
 
-    for (CharIndex = 0, DestIndex = 0; CharIndex < LineString->LengthInChars; CharIndex++) {
         //
-        //  If the string is <ESC>[, then treat it as an escape sequence.
-        //  Look for the final letter after any numbers or semicolon.
+        //  Skip any byte order mark at the beginning of the file.
         //
 
-        if (LineString->LengthInChars > CharIndex + 2 &&
-            LineString->StartOfString[CharIndex] == 27 &&
-            LineString->StartOfString[CharIndex + 1] == '[') {
-
-            YORI_STRING EscapeSubset;
-            YORI_ALLOC_SIZE_T EndOfEscape;
+        if (Offset == 0 &&
+            Encoding == CP_UTF8 &&
+            ChunkLength >= 3 &&
+            Buffer[0] == 0xEF &&
+            Buffer[1] == 0xBB &&
+            Buffer[2] == 0xBF) {
 
-            YoriLibInitEmptyString(&EscapeSubset);
-            EscapeSubset.StartOfString = &LineString->StartOfString[CharIndex + 2];
-            EscapeSubset.LengthInChars = LineString->LengthInChars - CharIndex - 2;
-            EndOfEscape = YoriLibCntStringWithChars(&EscapeSubset, _T("0123456789;"));
+            Offset = 3;
+            continue;
+        }
 
-            //
-            //  Look for color changes so any later line can be marked as
-            //  starting with this color.
-            //
+        LineLength = YoriLibLineReadFindBreakA(Buffer, ChunkLength);
+        Consumed = LineLength;
+        if (LineLength < ChunkLength) {
+            Consumed++;
+            if (Buffer[LineLength] == 0xD &&
+                LineLength + 1 < ChunkLength &&
+                Buffer[LineLength + 1] == 0xA) {
 
-            if (LineString->LengthInChars > CharIndex + 2 + EndOfEscape) {
-                EscapeSubset.StartOfString -= 2;
-                EscapeSubset.LengthInChars = EndOfEscape + 3;
-                YoriLibVtFinalColorFromEsc(AllocContext->PreviousColor, &EscapeSubset, &AllocContext->PreviousColor);
-            }
-        }
-        if (LineString->StartOfString[CharIndex] == '\t') {
-            for (TabIndex = 0; TabIndex < MoreContext->TabWidth; TabIndex++) {
-                NewLine->LineContents.StartOfString[DestIndex] = ' ';
-                DestIndex++;
+                Consumed++;
             }
-        } else {
-            NewLine->LineContents.StartOfString[DestIndex] = LineString->StartOfString[CharIndex];
-            DestIndex++;
         }
-    }
-    NewLine->LineContents.StartOfString[DestIndex] = '\0';
-    NewLine->LineContents.LengthInChars = DestIndex;
-    NewLine->LineContents.LengthAllocated = DestIndex + 1;
 
-    AllocContext->BufferOffset = AllocContext->BufferOffset + BytesRequired;
-    AllocContext->BytesRemainingInBuffer = AllocContext->BytesRemainingInBuffer - BytesRequired;
+        if (!MoreAddMappedPhysicalLine(MoreContext, Source, Offset, Buffer, LineLength, &AllocContext)) {
+            break;
+        }
 
-    //
-    //  Align the buffer to 8 bytes.  There's no length checking because
-    //  the allocation is assumed to be aligned to 8 bytes.
-    //
+        Offset = Offset + Consumed;
 
-    Alignment = AllocContext->BufferOffset % 8;
-    if (Alignment > 0) {
-        Alignment = 8 - Alignment;
-        AllocContext->BufferOffset = AllocContext->BufferOffset + Alignment;
-        AllocContext->BytesRemainingInBuffer = AllocContext->BytesRemainingInBuffer - Alignment;
+        if (WaitForSingleObject(MoreContext->ShutdownEvent, 0) == WAIT_OBJECT_0) {
+            break;
+        }
     }
 
-    //
-    //  Insert the new line into the list
-    //
-
-    WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
-    MoreContext->LineCount++;
-    YoriLibAppendList(&MoreContext->PhysicalLineList, &NewLine->LineList);
-    if (!MoreContext->FilterToSearch ||
-        MoreFindNextSearchMatch(MoreContext, &NewLine->LineContents, NULL, NULL)) {
-
-        YoriLibAppendList(&MoreContext->FilteredPhysicalLineList, &NewLine->FilteredLineList);
-        MoreContext->FilteredLineCount++;
-        NewLine->FilteredLineNumber = MoreContext->FilteredLineCount;
+    if (IngestView.Base != NULL) {
+        UnmapViewOfFile(IngestView.Base);
     }
-    ReleaseMutex(MoreContext->PhysicalLineMutex);
 
-    SetEvent(MoreContext->PhysicalLineAvailableEvent);
+    if (AllocContext.Buffer != NULL) {
+        YoriLibDereference(AllocContext.Buffer);
+    }
 
     return TRUE;
 }
 
+/**
+ Close all files whose lines refer to a mapping of the file.  This must be
+ called once no physical lines refer to these files.
+
+ @param MoreContext Pointer to the context describing process behavior.
+ */
+VOID
+MoreCloseMappedSources(
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMORE_MAPPED_SOURCE Source;
+
+    ListEntry = YoriLibGetNextListEntry(&MoreContext->MappedSourceList, NULL);
+    while (ListEntry != NULL) {
+        Source = CONTAINING_RECORD(ListEntry, MORE_MAPPED_SOURCE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&MoreContext->MappedSourceList, ListEntry);
+        YoriLibRemoveListItem(&Source->ListEntry);
+        if (Source->DecodeView.Base != NULL) {
+            UnmapViewOfFile(Source->DecodeView.Base);
+        }
+        CloseHandle(Source->MappingHandle);
+        YoriLibFree(Source);
+    }
+}
+
 /**
  Process a single opened stream, enumerating through all lines and displaying
  the set requested by the user.
@@ -234,13 +1125,17 @@ MoreAddPhysicalLineToBuffer(
 
  @param MoreContext Pointer to context information specifying which lines to
         display.
+
+ @param File If the file is being ingested concurrently with other files,
+        points to the file.  If NULL, lines are added directly.
  
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 MoreProcessStream(
     __in HANDLE hSource,
-    __in PMORE_CONTEXT MoreContext
+    __in PMORE_CONTEXT MoreContext,
+    __in_opt PMORE_INGEST_FILE File
     )
 {
     PVOID LineContext = NULL;
@@ -252,13 +1147,12 @@ MoreProcessStream(
 
     YoriLibInitEmptyString(&LineString);
 
-    MoreContext->FilesFound++;
-
     Terminate = FALSE;
     AllocContext.Buffer = NULL;
     AllocContext.BytesRemainingInBuffer = 0;
     AllocContext.BufferOffset = 0;
     AllocContext.PreviousColor = MoreContext->InitialColor;
+    AllocContext.File = File;
 
     while (TRUE) {
 
@@ -318,6 +1212,327 @@ MoreProcessStream(
     return TRUE;
 }
 
+/**
+ Indicate that an ingest thread has finished processing a file, and publish
+ any files whose lines can now be added to the set of physical lines.  A
+ file cannot be published until all earlier files have been published.  If
+ the earliest unpublished file is still being processed, its ingest thread
+ is told to add lines directly from now on.
+
+ @param Worker Pointer to the ingest thread which processed the file.
+
+ @param File Pointer to the file which has been processed.
+ */
+VOID
+MoreIngestCompleteFile(
+    __in PMORE_INGEST_WORKER Worker,
+    __in PMORE_INGEST_FILE File
+    )
+{
+    PMORE_INGEST_STATE State;
+    PMORE_CONTEXT MoreContext;
+    PYORI_LIST_ENTRY ListEntry;
+    PMORE_INGEST_FILE Head;
+
+    State = Worker->State;
+    MoreContext = State->MoreContext;
+
+    WaitForSingleObject(State->Mutex, INFINITE);
+    File->Complete = TRUE;
+
+    while (TRUE) {
+        ListEntry = YoriLibGetNextListEntry(&State->FileList, NULL);
+        if (ListEntry == NULL) {
+            break;
+        }
+
+        Head = CONTAINING_RECORD(ListEntry, MORE_INGEST_FILE, ListEntry);
+        if (!Head->Complete) {
+            Head->Direct = TRUE;
+            break;
+        }
+
+        if (WaitForSingleObject(MoreContext->ShutdownEvent, 0) == WAIT_OBJECT_0) {
+            MoreIngestFreeLines(Head);
+        } else {
+            MoreIngestPublishLines(Worker, Head);
+        }
+
+        YoriLibRemoveListItem(&Head->ListEntry);
+        YoriLibFree(Head);
+        State->OutstandingFiles--;
+        SetEvent(State->PublishedEvent);
+    }
+
+    ReleaseMutex(State->Mutex);
+}
+
+/**
+ An ingest thread.  This claims files found by the enumerating thread and
+ ingests each of them.
+
+ @param Context Pointer to the ingest thread's MORE_INGEST_WORKER structure.
+
+ @return Exit code for the thread, which is zero.
+ */
+DWORD WINAPI
+MoreIngestWorker(
+    __in LPVOID Context
+    )
+{
+    PMORE_INGEST_WORKER Worker;
+    PMORE_INGEST_STATE State;
+    PMORE_CONTEXT MoreContext;
+    PMORE_INGEST_FILE File;
+    PYORI_LIST_ENTRY ListEntry;
+    HANDLE WaitHandles[2];
+
+    Worker = (PMORE_INGEST_WORKER)Context;
+    State = Worker->State;
+    MoreContext = State->MoreContext;
+
+    WaitHandles[0] = State->WorkEvent;
+    WaitHandles[1] = State->ExitEvent;
+
+    while (WaitForMultipleObjects(2, WaitHandles, FALSE, INFINITE) == WAIT_OBJECT_0) {
+
+        WaitForSingleObject(State->Mutex, INFINITE);
+        ListEntry = YoriLibGetNextListEntry(&State->PendingList, NULL);
+        if (ListEntry == NULL) {
+            ResetEvent(State->WorkEvent);
+            ReleaseMutex(State->Mutex);
+            continue;
+        }
+
+        File = CONTAINING_RECORD(ListEntry, MORE_INGEST_FILE, PendingListEntry);
+        YoriLibRemoveListItem(&File->PendingListEntry);
+        File->Worker = Worker;
+        if (YoriLibIsListEmpty(&State->PendingList)) {
+            ResetEvent(State->WorkEvent);
+        }
+        ReleaseMutex(State->Mutex);
+
+        if (!MoreProcessMappedFile(File->FileHandle, MoreContext, File->Encoding, File)) {
+            MoreProcessStream(File->FileHandle, MoreContext, File);
+        }
+
+        CloseHandle(File->FileHandle);
+        File->FileHandle = NULL;
+
+        MoreIngestCompleteFile(Worker, File);
+    }
+
+    if (Worker->View.Base != NULL) {
+        UnmapViewOfFile(Worker->View.Base);
+        Worker->View.Base = NULL;
+    }
+
+    return 0;
+}
+
+/**
+ Create the ingest threads.  If this fails, files are ingested
+ synchronously by the enumerating thread.
+
+ @param State Pointer to the ingest state to initialize.
+
+ @param MoreContext Pointer to the more context.
+
+ @return TRUE if at least one ingest thread exists, FALSE if files must be
+         ingested synchronously.
+ */
+__success(return)
+BOOLEAN
+MoreIngestInitialize(
+    __out PMORE_INGEST_STATE State,
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    PMORE_INGEST_WORKER Worker;
+    SYSTEM_INFO SystemInfo;
+    DWORD WorkerCount;
+    DWORD ThreadId;
+
+    ZeroMemory(State, sizeof(MORE_INGEST_STATE));
+    State->MoreContext = MoreContext;
+    YoriLibInitializeListHead(&State->FileList);
+    YoriLibInitializeListHead(&State->PendingList);
+
+    //
+    //  When waiting for more data, each file is followed in turn, so a file
+    //  is never complete and later files cannot be ingested concurrently.
+    //
+
+    if (MoreContext->WaitForMore) {
+        return FALSE;
+    }
+
+    State->Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (State->Mutex == NULL) {
+        return FALSE;
+    }
+
+    State->WorkEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (State->WorkEvent == NULL) {
+        return FALSE;
+    }
+
+    State->ExitEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (State->ExitEvent == NULL) {
+        return FALSE;
+    }
+
+    State->PublishedEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (State->PublishedEvent == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  Each thread maps views of files, so on 32 bit systems only use a
+    //  small number of threads to avoid exhausting address space.
+    //
+
+    GetSystemInfo(&SystemInfo);
+    WorkerCount = SystemInfo.dwNumberOfProcessors;
+    if (WorkerCount < 1) {
+        WorkerCount = 1;
+    }
+    if (WorkerCount > MORE_INGEST_MAX_WORKERS) {
+        WorkerCount = MORE_INGEST_MAX_WORKERS;
+    }
+    if (sizeof(PVOID) < 8 && WorkerCount > 2) {
+        WorkerCount = 2;
+    }
+
+    while (State->WorkerCount < WorkerCount) {
+        Worker = &State->Workers[State->WorkerCount];
+        Worker->State = State;
+        Worker->Thread = CreateThread(NULL, 0, MoreIngestWorker, Worker, 0, &ThreadId);
+        if (Worker->Thread == NULL) {
+            break;
+        }
+        State->WorkerCount++;
+    }
+
+    if (State->WorkerCount == 0) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Wait until every file found so far has been published.
+
+ @param State Pointer to the ingest state.
+ */
+VOID
+MoreIngestWaitForIdle(
+    __in PMORE_INGEST_STATE State
+    )
+{
+    DWORD OutstandingFiles;
+
+    if (State->WorkerCount == 0) {
+        return;
+    }
+
+    while (TRUE) {
+        WaitForSingleObject(State->Mutex, INFINITE);
+        OutstandingFiles = State->OutstandingFiles;
+        ReleaseMutex(State->Mutex);
+        if (OutstandingFiles == 0) {
+            break;
+        }
+        WaitForSingleObject(State->PublishedEvent, INFINITE);
+    }
+}
+
+/**
+ Tell the ingest threads to terminate once all files have been processed,
+ wait for them to terminate, and clean up the ingest state.
+
+ @param State Pointer to the ingest state.
+ */
+VOID
+MoreIngestCleanup(
+    __in PMORE_INGEST_STATE State
+    )
+{
+    DWORD Index;
+
+    if (State->WorkerCount > 0) {
+        SetEvent(State->ExitEvent);
+        for (Index = 0; Index < State->WorkerCount; Index++) {
+            WaitForSingleObject(State->Workers[Index].Thread, INFINITE);
+            CloseHandle(State->Workers[Index].Thread);
+        }
+        State->WorkerCount = 0;
+    }
+
+    ASSERT(YoriLibIsListEmpty(&State->FileList));
+
+    if (State->PublishedEvent != NULL) {
+        CloseHandle(State->PublishedEvent);
+        State->PublishedEvent = NULL;
+    }
+
+    if (State->ExitEvent != NULL) {
+        CloseHandle(State->ExitEvent);
+        State->ExitEvent = NULL;
+    }
+
+    if (State->WorkEvent != NULL) {
+        CloseHandle(State->WorkEvent);
+        State->WorkEvent = NULL;
+    }
+
+    if (State->Mutex != NULL) {
+        CloseHandle(State->Mutex);
+        State->Mutex = NULL;
+    }
+}
+
+/**
+ Queue a file to be ingested by an ingest thread.  If too many files are
+ outstanding, wait for earlier files to be published first.
+
+ @param State Pointer to the ingest state.
+
+ @param File Pointer to the file to ingest.  The ingest threads take
+        ownership of this allocation and its file handle.
+ */
+VOID
+MoreIngestQueueFile(
+    __in PMORE_INGEST_STATE State,
+    __in PMORE_INGEST_FILE File
+    )
+{
+    while (TRUE) {
+        WaitForSingleObject(State->Mutex, INFINITE);
+        if (State->OutstandingFiles < State->WorkerCount * MORE_INGEST_FILES_PER_WORKER) {
+            break;
+        }
+        ReleaseMutex(State->Mutex);
+        WaitForSingleObject(State->PublishedEvent, INFINITE);
+    }
+
+    //
+    //  If every earlier file has been published, lines from this file can
+    //  be displayed as soon as they are found.
+    //
+
+    if (YoriLibIsListEmpty(&State->FileList)) {
+        File->Direct = TRUE;
+    }
+
+    YoriLibAppendList(&State->FileList, &File->ListEntry);
+    YoriLibAppendList(&State->PendingList, &File->PendingListEntry);
+    State->OutstandingFiles++;
+    SetEvent(State->WorkEvent);
+    ReleaseMutex(State->Mutex);
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
@@ -328,8 +1543,8 @@ MoreProcessStream(
 
  @param Depth Specifies recursion depth.  Ignored in this application.
 
- @param Context Pointer to the more context structure indicating the
-        action to perform and populated with the file and line count found.
+ @param Context Pointer to the ingest state, including the more context
+        which is populated with the file and line count found.
 
  @return TRUE to continute enumerating, FALSE to abort.
  */
@@ -342,7 +1557,9 @@ MoreFileFoundCallback(
     )
 {
     HANDLE FileHandle;
-    PMORE_CONTEXT MoreContext = (PMORE_CONTEXT)Context;
+    PMORE_INGEST_STATE State = (PMORE_INGEST_STATE)Context;
+    PMORE_CONTEXT MoreContext = State->MoreContext;
+    PMORE_INGEST_FILE File;
 
     UNREFERENCED_PARAMETER(Depth);
 
@@ -355,6 +1572,7 @@ MoreFileFoundCallback(
     if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
         UCHAR LeadingBytes[3];
         DWORD SavedEncoding;
+        DWORD Encoding;
         DWORD BytesRead;
 
         FileHandle = CreateFile(FilePath->StartOfString,
@@ -373,7 +1591,9 @@ MoreFileFoundCallback(
             return TRUE;
         }
 
+        MoreContext->FilesFound++;
         SavedEncoding = YoriLibGetMultibyteInputEncoding();
+        Encoding = SavedEncoding;
 
         //
         //  If the file starts with a UTF-16 BOM, interpret it as UTF-16.
@@ -384,12 +1604,42 @@ MoreFileFoundCallback(
                 LeadingBytes[0] == 0xFF &&
                 LeadingBytes[1] == 0xFE) {
 
-                YoriLibSetMultibyteInputEncoding(CP_UTF16);
+                Encoding = CP_UTF16;
             }
         }
         SetFilePointer(FileHandle, 0, NULL, FILE_BEGIN);
 
-        MoreProcessStream(FileHandle, MoreContext);
+        //
+        //  Files on disk in an 8 bit encoding can be ingested concurrently.
+        //  Anything else is read with the process wide input encoding, so
+        //  it is ingested here once all earlier files have been published,
+        //  which implies no ingest thread is reading a stream.
+        //
+
+        if (State->WorkerCount > 0 &&
+            Encoding != CP_UTF16 &&
+            GetFileType(FileHandle) == FILE_TYPE_DISK) {
+
+            File = YoriLibMalloc(sizeof(MORE_INGEST_FILE));
+            if (File != NULL) {
+                ZeroMemory(File, sizeof(MORE_INGEST_FILE));
+                File->FileHandle = FileHandle;
+                File->Encoding = Encoding;
+                MoreIngestQueueFile(State, File);
+                if (MoreContext->OutOfMemory) {
+                    return FALSE;
+                }
+                return TRUE;
+            }
+        }
+
+        MoreIngestWaitForIdle(State);
+
+        YoriLibSetMultibyteInputEncoding(Encoding);
+
+        if (!MoreProcessMappedFile(FileHandle, MoreContext, Encoding, NULL)) {
+            MoreProcessStream(FileHandle, MoreContext, NULL);
+        }
 
         YoriLibSetMultibyteInputEncoding(SavedEncoding);
 
@@ -405,7 +1655,8 @@ MoreFileFoundCallback(
 /**
  A background thread that is tasked with collecting any input lines and adding
  them into the structure of lines, and signalling the foreground UI thread to
- indicate when it has done so.
+ indicate when it has done so.  When multiple files are specified, files are
+ ingested concurrently by a set of ingest threads and published in order.
 
  @param Context Pointer to the MORE_CONTEXT.
 
@@ -417,6 +1668,7 @@ MoreIngestThread(
     )
 {
     PMORE_CONTEXT MoreContext = (PMORE_CONTEXT)Context;
+    MORE_INGEST_STATE State;
     WORD MatchFlags;
     DWORD i;
 
@@ -431,7 +1683,8 @@ MoreIngestThread(
             return 0;
         }
 
-        MoreProcessStream(GetStdHandle(STD_INPUT_HANDLE), MoreContext);
+        MoreContext->FilesFound++;
+        MoreProcessStream(GetStdHandle(STD_INPUT_HANDLE), MoreContext, NULL);
     } else {
         MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
         if (MoreContext->Recursive) {
@@ -441,10 +1694,22 @@ MoreIngestThread(
             MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
         }
 
+        //
+        //  If ingest threads can't be created, files are processed
+        //  synchronously as they are found.
+        //
+
+        if (!MoreIngestInitialize(&State, MoreContext)) {
+            MoreIngestCleanup(&State);
+        }
+
         for (i = 0; i < MoreContext->InputSourceCount; i++) {
 
-            YoriLibForEachStream(&MoreContext->InputSources[i], MatchFlags, 0, MoreFileFoundCallback, NULL, MoreContext);
+            YoriLibForEachStream(&MoreContext->InputSources[i], MatchFlags, 0, MoreFileFoundCallback, NULL, &State);
         }
+
+        MoreIngestWaitForIdle(&State);
+        MoreIngestCleanup(&State);
     }
 
     if (MoreContext->FilesFound == 0) {
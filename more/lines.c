@@ -3,7 +3,7 @@
  *
  * Yori shell more search and split lines
  *
- * Copyright (c) 2017-2022 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -238,6 +238,7 @@ MoreSearchIndexFree(
 
     YoriLibInitEmptyString(&MoreContext->SearchStrings[Index]);
     MoreContext->SearchContext[Index].ColorIndex = (UCHAR)-1;
+    MoreInvalidateLineLayouts(MoreContext);
 }
 
 /**
@@ -294,6 +295,177 @@ MoreTruncateStringToVisibleChars(
     }
 }
 
+/**
+ Store a physical line at a specified index within a line index.  Lines are
+ expected to be stored in order, so the index is either an existing entry
+ or the entry immediately following the final chunk's existing entries.
+
+ @param LineIndex Pointer to the line index.
+
+ @param Index The zero based index of the entry to update.
+
+ @param PhysicalLine Pointer to the physical line to store.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOLEAN
+MoreLineIndexSet(
+    __inout PMORE_LINE_INDEX LineIndex,
+    __in DWORDLONG Index,
+    __in PMORE_PHYSICAL_LINE PhysicalLine
+    )
+{
+    PMORE_PHYSICAL_LINE **NewChunks;
+    PMORE_PHYSICAL_LINE *NewChunk;
+    DWORD ChunkIndex;
+    DWORD NewChunksAllocated;
+
+    ChunkIndex = (DWORD)(Index / MORE_LINE_INDEX_CHUNK_SIZE);
+
+    if (ChunkIndex >= LineIndex->ChunksPopulated) {
+        ASSERT(ChunkIndex == LineIndex->ChunksPopulated);
+
+        if (LineIndex->ChunksPopulated >= LineIndex->ChunksAllocated) {
+            NewChunksAllocated = LineIndex->ChunksAllocated * 2;
+            if (NewChunksAllocated < 16) {
+                NewChunksAllocated = 16;
+            }
+            NewChunks = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewChunksAllocated * sizeof(PMORE_PHYSICAL_LINE *)));
+            if (NewChunks == NULL) {
+                return FALSE;
+            }
+            if (LineIndex->Chunks != NULL) {
+                memcpy(NewChunks, LineIndex->Chunks, LineIndex->ChunksPopulated * sizeof(PMORE_PHYSICAL_LINE *));
+                YoriLibFree(LineIndex->Chunks);
+            }
+            LineIndex->Chunks = NewChunks;
+            LineIndex->ChunksAllocated = NewChunksAllocated;
+        }
+
+        NewChunk = YoriLibMalloc(MORE_LINE_INDEX_CHUNK_SIZE * sizeof(PMORE_PHYSICAL_LINE));
+        if (NewChunk == NULL) {
+            return FALSE;
+        }
+
+        LineIndex->Chunks[LineIndex->ChunksPopulated] = NewChunk;
+        LineIndex->ChunksPopulated++;
+    }
+
+    LineIndex->Chunks[ChunkIndex][Index % MORE_LINE_INDEX_CHUNK_SIZE] = PhysicalLine;
+    return TRUE;
+}
+
+/**
+ Return the physical line at a specified index within a line index.
+
+ @param LineIndex Pointer to the line index.
+
+ @param Index The zero based index of the entry to return.  The caller is
+        expected to ensure this entry has been populated.
+
+ @return Pointer to the physical line.
+ */
+PMORE_PHYSICAL_LINE
+MoreLineIndexGet(
+    __in PMORE_LINE_INDEX LineIndex,
+    __in DWORDLONG Index
+    )
+{
+    ASSERT(Index / MORE_LINE_INDEX_CHUNK_SIZE < LineIndex->ChunksPopulated);
+    return LineIndex->Chunks[Index / MORE_LINE_INDEX_CHUNK_SIZE][Index % MORE_LINE_INDEX_CHUNK_SIZE];
+}
+
+/**
+ Free all memory used by a line index.  This does not free the physical
+ lines that it refers to.
+
+ @param LineIndex Pointer to the line index.
+ */
+VOID
+MoreLineIndexFree(
+    __inout PMORE_LINE_INDEX LineIndex
+    )
+{
+    DWORD ChunkIndex;
+
+    for (ChunkIndex = 0; ChunkIndex < LineIndex->ChunksPopulated; ChunkIndex++) {
+        YoriLibFree(LineIndex->Chunks[ChunkIndex]);
+    }
+
+    if (LineIndex->Chunks != NULL) {
+        YoriLibFree(LineIndex->Chunks);
+    }
+
+    LineIndex->Chunks = NULL;
+    LineIndex->ChunksAllocated = 0;
+    LineIndex->ChunksPopulated = 0;
+}
+
+/**
+ Find the index within the set of filtered lines of the first line whose
+ line number is greater than or equal to a specified line number.  The
+ caller is expected to hold MORE_CONTEXT::PhysicalLineMutex .
+
+ @param MoreContext Pointer to the more context.
+
+ @param LineNumber The line number to search for.
+
+ @return The zero based index within the filtered lines.  This can be equal
+         to MORE_CONTEXT::FilteredLineCount if no filtered line has a line
+         number greater than or equal to LineNumber.
+ */
+DWORDLONG
+MoreFindFilteredLineIndex(
+    __in PMORE_CONTEXT MoreContext,
+    __in DWORDLONG LineNumber
+    )
+{
+    DWORDLONG Start;
+    DWORDLONG End;
+    DWORDLONG Middle;
+
+    Start = 0;
+    End = MoreContext->FilteredLineCount;
+    while (Start < End) {
+        Middle = Start + (End - Start) / 2;
+        if (MoreLineIndexGet(&MoreContext->FilteredPhysicalLines, Middle)->LineNumber < LineNumber) {
+            Start = Middle + 1;
+        } else {
+            End = Middle;
+        }
+    }
+
+    return Start;
+}
+
+/**
+ Check whether a physical line is currently a filtered line.  The caller is
+ expected to hold MORE_CONTEXT::PhysicalLineMutex .
+
+ @param MoreContext Pointer to the more context.
+
+ @param PhysicalLine Pointer to the physical line.
+
+ @return TRUE if the line is at the location in the filtered lines indicated
+         by its FilteredLineNumber, FALSE if it is not a filtered line.
+ */
+BOOLEAN
+MoreIsFilteredLine(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_PHYSICAL_LINE PhysicalLine
+    )
+{
+    if (PhysicalLine->FilteredLineNumber > 0 &&
+        PhysicalLine->FilteredLineNumber <= MoreContext->FilteredLineCount &&
+        MoreLineIndexGet(&MoreContext->FilteredPhysicalLines, PhysicalLine->FilteredLineNumber - 1) == PhysicalLine) {
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
 /**
  Return the next filtered physical line.  This refers to a physical line that
  matches the search criteria when filtering is enabled.  If filtering is not
@@ -314,27 +486,34 @@ MoreGetNextFilteredPhysicalLine(
     __in_opt PMORE_PHYSICAL_LINE PreviousLine
     )
 {
-    PYORI_LIST_ENTRY ListEntry;
     PMORE_PHYSICAL_LINE ThisLine;
+    DWORDLONG Index;
+
+    WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+
+    //
+    //  Typically the previous line is itself a filtered line, but if it no
+    //  longer matches the filter, search for the next line by line number.
+    //
 
     if (PreviousLine != NULL) {
-        ListEntry = YoriLibGetNextListEntry(&MoreContext->FilteredPhysicalLineList, &PreviousLine->FilteredLineList);
+        if (MoreIsFilteredLine(MoreContext, PreviousLine)) {
+            Index = PreviousLine->FilteredLineNumber;
+        } else {
+            Index = MoreFindFilteredLineIndex(MoreContext, PreviousLine->LineNumber + 1);
+        }
     } else {
-        ListEntry = YoriLibGetNextListEntry(&MoreContext->FilteredPhysicalLineList, NULL);
+        Index = 0;
     }
 
-    if (ListEntry == NULL) {
-        return NULL;
+    ThisLine = NULL;
+    if (Index < MoreContext->FilteredLineCount) {
+        ThisLine = MoreLineIndexGet(&MoreContext->FilteredPhysicalLines, Index);
+        ASSERT(ThisLine->FilteredLineNumber == Index + 1);
+        ASSERT(PreviousLine == NULL || ThisLine->LineNumber > PreviousLine->LineNumber);
     }
 
-    ThisLine = CONTAINING_RECORD(ListEntry, MORE_PHYSICAL_LINE, FilteredLineList);
-
-    //
-    //  Check that the list is sorted
-    //
-
-    ASSERT(PreviousLine == NULL || ThisLine->FilteredLineNumber == PreviousLine->FilteredLineNumber + 1);
-    ASSERT(PreviousLine == NULL || ThisLine->LineNumber > PreviousLine->LineNumber);
+    ReleaseMutex(MoreContext->PhysicalLineMutex);
 
     return ThisLine;
 }
@@ -359,37 +538,39 @@ MoreGetPreviousFilteredPhysicalLine(
     __in_opt PMORE_PHYSICAL_LINE NextLine
     )
 {
-    PYORI_LIST_ENTRY ListEntry;
     PMORE_PHYSICAL_LINE ThisLine;
+    DWORDLONG Index;
+
+    WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
 
     if (NextLine != NULL) {
-        ListEntry = YoriLibGetPreviousListEntry(&MoreContext->FilteredPhysicalLineList, &NextLine->FilteredLineList);
+        if (MoreIsFilteredLine(MoreContext, NextLine)) {
+            Index = NextLine->FilteredLineNumber - 1;
+        } else {
+            Index = MoreFindFilteredLineIndex(MoreContext, NextLine->LineNumber);
+        }
     } else {
-        ListEntry = YoriLibGetPreviousListEntry(&MoreContext->FilteredPhysicalLineList, NULL);
+        Index = MoreContext->FilteredLineCount;
     }
 
-    if (ListEntry == NULL) {
-        return NULL;
+    ThisLine = NULL;
+    if (Index > 0) {
+        ThisLine = MoreLineIndexGet(&MoreContext->FilteredPhysicalLines, Index - 1);
+        ASSERT(ThisLine->FilteredLineNumber == Index);
+        ASSERT(NextLine == NULL || ThisLine->LineNumber < NextLine->LineNumber);
     }
 
-    ThisLine = CONTAINING_RECORD(ListEntry, MORE_PHYSICAL_LINE, FilteredLineList);
-
-    //
-    //  Check that the list is sorted
-    //
+    ReleaseMutex(MoreContext->PhysicalLineMutex);
 
-    ASSERT(NextLine == NULL || ThisLine->FilteredLineNumber + 1 == NextLine->FilteredLineNumber);
-    ASSERT(NextLine == NULL || ThisLine->LineNumber < NextLine->LineNumber);
     return ThisLine;
 }
 
 /**
- Apply a new search criteria to update the set of filtered lines.
-
- MSFIX This routine wants to be much smarter.  Ideally it would initiate an
- asynchronous process that gets synchronized when next/previous lines are
- needed.  This would allow the display to rapidly update while the number of
- filtered lines is updated in the background (refreshing the status line.)
+ Apply a new search criteria to update the set of filtered lines, comparing
+ every line before returning.  Any filter being applied in the background is
+ abandoned.  This is used when filtering is disabled, which requires no
+ comparisons, or when filter threads are not available; otherwise
+ @ref MoreFilterStart applies the filter without blocking the viewport.
 
  @param MoreContext Pointer to the more context, indicating the current search
         terms.
@@ -408,10 +589,9 @@ MoreUpdateFilteredLines(
     __in_opt PMORE_PHYSICAL_LINE PreviousStartPoint
     )
 {
-    PYORI_LIST_ENTRY ListEntry;
-    PMORE_PHYSICAL_LINE PreviousFilteredLine;
     PMORE_PHYSICAL_LINE ThisLine;
     BOOLEAN MatchFound;
+    DWORDLONG Index;
     DWORDLONG FilteredLineNumber;
     DWORDLONG PreviousStartLineNumber;
     PMORE_PHYSICAL_LINE NewStartPoint;
@@ -422,52 +602,42 @@ MoreUpdateFilteredLines(
         PreviousStartLineNumber = PreviousStartPoint->LineNumber;
     }
 
+    MoreFilterCancel(MoreContext);
+
     WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
 
-    PreviousFilteredLine = NULL;
-    FilteredLineNumber = 0;
-    ListEntry = YoriLibGetNextListEntry(&MoreContext->PhysicalLineList, NULL);
+    //
+    //  The filtered lines are a subset of the physical lines in the same
+    //  order, so they can be regenerated in place.  Entries are only ever
+    //  written at or before the entry being examined.
+    //
 
-    while (ListEntry != NULL) {
+    FilteredLineNumber = 0;
+    for (Index = 0; Index < MoreContext->LineCount; Index++) {
 
-        ThisLine = CONTAINING_RECORD(ListEntry, MORE_PHYSICAL_LINE, LineList);
+        ThisLine = MoreLineIndexGet(&MoreContext->PhysicalLines, Index);
         if (MoreContext->FilterToSearch) {
-            MatchFound = MoreFindNextSearchMatch(MoreContext, &ThisLine->LineContents, NULL, NULL);
+            MatchFound = MoreFindNextSearchMatch(MoreContext, MoreGetPhysicalLineContents(MoreContext, ThisLine), NULL, NULL);
         } else {
             MatchFound = TRUE;
         }
 
-        if (!MatchFound) {
-            if (ThisLine->FilteredLineList.Next != NULL) {
-                ASSERT(MoreContext->FilteredLineCount > 0);
-                MoreContext->FilteredLineCount--;
-                YoriLibRemoveListItem(&ThisLine->FilteredLineList);
-                ThisLine->FilteredLineList.Next = NULL;
-            }
-        } else {
-            if (ThisLine->FilteredLineList.Next == NULL) {
-                if (PreviousFilteredLine != NULL) {
-                    ASSERT(ThisLine->LineNumber > PreviousFilteredLine->LineNumber);
-                    YoriLibInsertList(&PreviousFilteredLine->FilteredLineList, &ThisLine->FilteredLineList);
-                } else {
-                    YoriLibInsertList(&MoreContext->FilteredPhysicalLineList, &ThisLine->FilteredLineList);
-                }
-                MoreContext->FilteredLineCount++;
-                ASSERT(MoreContext->FilteredLineCount <= MoreContext->LineCount);
+        if (MatchFound) {
+            if (!MoreLineIndexSet(&MoreContext->FilteredPhysicalLines, FilteredLineNumber, ThisLine)) {
+                MoreContext->OutOfMemory = TRUE;
+                break;
             }
             FilteredLineNumber++;
             ThisLine->FilteredLineNumber = FilteredLineNumber;
-            PreviousFilteredLine = ThisLine;
             if (NewStartPoint == NULL && ThisLine->LineNumber >= PreviousStartLineNumber) {
                 NewStartPoint = ThisLine;
             }
         }
-
-
-        ListEntry = YoriLibGetNextListEntry(&MoreContext->PhysicalLineList, &ThisLine->LineList);
     }
 
-    ASSERT(MoreContext->FilteredLineCount == FilteredLineNumber);
+    MoreContext->FilteredLineCount = FilteredLineNumber;
+    MoreContext->FilterScanLineCount = MoreContext->LineCount;
+    ASSERT(MoreContext->FilteredLineCount <= MoreContext->LineCount);
 
     ReleaseMutex(MoreContext->PhysicalLineMutex);
 
@@ -693,6 +863,159 @@ MoreGetLogicalLineLength(
     return SourceIndex;
 }
 
+/**
+ Indicate that any previously calculated division of physical lines into
+ logical lines is no longer valid, because the search strings which affect
+ the generation of logical lines have changed.
+
+ @param MoreContext Pointer to the more context.
+ */
+VOID
+MoreInvalidateLineLayouts(
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    MoreContext->LineLayoutGeneration++;
+}
+
+/**
+ Free any memory used to retain the division of physical lines into logical
+ lines.
+
+ @param MoreContext Pointer to the more context.
+ */
+VOID
+MoreFreeLineLayouts(
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    PMORE_LINE_LAYOUT Layout;
+
+    for (Index = 0; Index < MORE_LINE_LAYOUT_CACHE_SIZE; Index++) {
+        Layout = &MoreContext->LineLayouts[Index];
+        if (Layout->LogicalLines != NULL) {
+            YoriLibFree(Layout->LogicalLines);
+        }
+        ZeroMemory(Layout, sizeof(MORE_LINE_LAYOUT));
+    }
+}
+
+/**
+ Return the division of a physical line into logical lines for the current
+ viewport width and search strings.  If this has been calculated recently it
+ is returned without parsing the physical line; otherwise the physical line
+ is parsed once and the result retained for subsequent calls.
+
+ @param MoreContext Pointer to the more context containing the data to
+        display.
+
+ @param PhysicalLine Pointer to the physical line to decompose into one or
+        more logical lines.
+
+ @return Pointer to the layout of the physical line, or NULL if memory could
+         not be allocated to describe it.
+ */
+__success(return != NULL)
+PMORE_LINE_LAYOUT
+MoreGetLineLayout(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_PHYSICAL_LINE PhysicalLine
+    )
+{
+    PMORE_LINE_LAYOUT Layout;
+    PMORE_LOGICAL_LINE_LAYOUT ThisLine;
+    PYORI_STRING LineContents;
+    YORI_STRING Subset;
+    YORI_ALLOC_SIZE_T EntriesNeeded;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_ALLOC_SIZE_T CharIndex;
+    YORI_ALLOC_SIZE_T LogicalLineLength;
+    YORI_ALLOC_SIZE_T CharactersRemainingInMatch;
+    WORD InitialUserColor;
+    WORD InitialDisplayColor;
+    MORE_LINE_END_CONTEXT LineEndContext;
+
+    Layout = &MoreContext->LineLayouts[PhysicalLine->LineNumber % MORE_LINE_LAYOUT_CACHE_SIZE];
+    if (Layout->PhysicalLine == PhysicalLine &&
+        Layout->ViewportWidth == MoreContext->ViewportWidth &&
+        Layout->Generation == MoreContext->LineLayoutGeneration) {
+
+        return Layout;
+    }
+
+    Layout->PhysicalLine = NULL;
+    LineContents = MoreGetPhysicalLineContents(MoreContext, PhysicalLine);
+
+    //
+    //  Every logical line other than the last fills the viewport width with
+    //  at least one source character per cell, so this is the most logical
+    //  lines that can be needed.
+    //
+
+    ASSERT(MoreContext->ViewportWidth > 0);
+    EntriesNeeded = LineContents->LengthInChars / MoreContext->ViewportWidth + 1;
+    if (Layout->LogicalLinesAllocated < EntriesNeeded) {
+        if (Layout->LogicalLines != NULL) {
+            YoriLibFree(Layout->LogicalLines);
+            Layout->LogicalLines = NULL;
+            Layout->LogicalLinesAllocated = 0;
+        }
+
+        if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)EntriesNeeded * sizeof(MORE_LOGICAL_LINE_LAYOUT))) {
+            return NULL;
+        }
+
+        Layout->LogicalLines = YoriLibMalloc(EntriesNeeded * sizeof(MORE_LOGICAL_LINE_LAYOUT));
+        if (Layout->LogicalLines == NULL) {
+            return NULL;
+        }
+        Layout->LogicalLinesAllocated = EntriesNeeded;
+    }
+
+    Count = 0;
+    CharIndex = 0;
+    CharactersRemainingInMatch = 0;
+    InitialUserColor = PhysicalLine->InitialColor;
+    InitialDisplayColor = PhysicalLine->InitialColor;
+
+    YoriLibInitEmptyString(&Subset);
+    Subset.StartOfString = LineContents->StartOfString;
+    Subset.LengthInChars = LineContents->LengthInChars;
+    while(TRUE) {
+        ASSERT(Count < Layout->LogicalLinesAllocated);
+        LogicalLineLength = MoreGetLogicalLineLength(MoreContext, &Subset, MoreContext->ViewportWidth, InitialDisplayColor, InitialUserColor, CharactersRemainingInMatch, &LineEndContext);
+
+        ThisLine = &Layout->LogicalLines[Count];
+        ThisLine->PhysicalLineCharacterOffset = CharIndex;
+        ThisLine->CharactersToConsume = LogicalLineLength;
+        ThisLine->CharactersNeededInAllocation = LineEndContext.CharactersNeededInAllocation;
+        ThisLine->CharactersRemainingInMatch = CharactersRemainingInMatch;
+        ThisLine->InitialDisplayColor = InitialDisplayColor;
+        ThisLine->InitialUserColor = InitialUserColor;
+        ThisLine->ExplicitNewlineRequired = LineEndContext.ExplicitNewlineRequired;
+        ThisLine->RequiresGeneration = LineEndContext.RequiresGeneration;
+
+        CharactersRemainingInMatch = LineEndContext.CharactersRemainingInMatch;
+        InitialUserColor = LineEndContext.FinalUserColor;
+        InitialDisplayColor = LineEndContext.FinalDisplayColor;
+        Subset.StartOfString += LogicalLineLength;
+        Subset.LengthInChars = Subset.LengthInChars - LogicalLineLength;
+        Count++;
+        CharIndex = CharIndex + LogicalLineLength;
+        if (Subset.LengthInChars == 0) {
+            break;
+        }
+    }
+
+    Layout->LogicalLineCount = Count;
+    Layout->ViewportWidth = MoreContext->ViewportWidth;
+    Layout->Generation = MoreContext->LineLayoutGeneration;
+    Layout->PhysicalLine = PhysicalLine;
+
+    return Layout;
+}
+
 /**
  Return the number of logical lines that can be derived from a single
  physical line.  Note that each physical line must have at least one logical
@@ -715,10 +1038,22 @@ MoreCountLogicalLinesOnPhysicalLine(
     YORI_ALLOC_SIZE_T Count = 0;
     YORI_ALLOC_SIZE_T LogicalLineLength;
     YORI_STRING Subset;
+    PYORI_STRING LineContents;
+    PMORE_LINE_LAYOUT Layout;
+
+    Layout = MoreGetLineLayout(MoreContext, PhysicalLine);
+    if (Layout != NULL) {
+        return Layout->LogicalLineCount;
+    }
+
+    //
+    //  If the layout can't be retained, count the lines without it.
+    //
 
+    LineContents = MoreGetPhysicalLineContents(MoreContext, PhysicalLine);
     YoriLibInitEmptyString(&Subset);
-    Subset.StartOfString = PhysicalLine->LineContents.StartOfString;
-    Subset.LengthInChars = PhysicalLine->LineContents.LengthInChars;
+    Subset.StartOfString = LineContents->StartOfString;
+    Subset.LengthInChars = LineContents->LengthInChars;
     while(TRUE) {
         LogicalLineLength = MoreGetLogicalLineLength(MoreContext, &Subset, MoreContext->ViewportWidth, 0, 0, 0, NULL);
         Subset.StartOfString += LogicalLineLength;
@@ -813,8 +1148,12 @@ MoreCopyRangeIntoLogicalLine(
     __in YORI_ALLOC_SIZE_T AllocationLengthRequired
     )
 {
+    PYORI_STRING LineContents;
+
     ASSERT(LogicalLine->Line.LengthAllocated == 0 && LogicalLine->Line.MemoryToFree == NULL);
 
+    LineContents = MoreGetPhysicalLineContents(MoreContext, LogicalLine->PhysicalLine);
+
     if (RegenerationRequired) {
         YORI_STRING PhysicalLineSubset;
         YORI_ALLOC_SIZE_T SourceIndex;
@@ -831,7 +1170,7 @@ MoreCopyRangeIntoLogicalLine(
         UCHAR MatchIndex;
 
         YoriLibInitEmptyString(&PhysicalLineSubset);
-        PhysicalLineSubset.StartOfString = &LogicalLine->PhysicalLine->LineContents.StartOfString[LogicalLine->PhysicalLineCharacterOffset]; 
+        PhysicalLineSubset.StartOfString = &LineContents->StartOfString[LogicalLine->PhysicalLineCharacterOffset];
         PhysicalLineSubset.LengthInChars = SourceCharsToConsume;
 
         if (!YoriLibAllocateString(&LogicalLine->Line, AllocationLengthRequired)) {
@@ -869,7 +1208,7 @@ MoreCopyRangeIntoLogicalLine(
 
                 YoriLibInitEmptyString(&StringForNextMatch);
                 StringForNextMatch.StartOfString = &PhysicalLineSubset.StartOfString[SourceIndex];
-                StringForNextMatch.LengthInChars = LogicalLine->PhysicalLine->LineContents.LengthInChars - LogicalLine->PhysicalLineCharacterOffset - SourceIndex;
+                StringForNextMatch.LengthInChars = LineContents->LengthInChars - LogicalLine->PhysicalLineCharacterOffset - SourceIndex;
                 MatchFound = MoreFindNextSearchMatch(MoreContext, &StringForNextMatch, &MatchOffset, &MatchIndex);
                 if (MatchFound) {
                     MatchLength = MoreContext->SearchStrings[MatchIndex].LengthInChars;
@@ -942,11 +1281,20 @@ MoreCopyRangeIntoLogicalLine(
     } else {
         ASSERT(SourceCharsToConsume == AllocationLengthRequired);
         YoriLibInitEmptyString(&LogicalLine->Line);
-        LogicalLine->Line.StartOfString = &LogicalLine->PhysicalLine->LineContents.StartOfString[LogicalLine->PhysicalLineCharacterOffset];
+        LogicalLine->Line.StartOfString = &LineContents->StartOfString[LogicalLine->PhysicalLineCharacterOffset];
         LogicalLine->Line.LengthInChars = SourceCharsToConsume;
 
-        YoriLibReference(LogicalLine->PhysicalLine->MemoryToFree);
-        LogicalLine->Line.MemoryToFree = LogicalLine->PhysicalLine->MemoryToFree;
+        //
+        //  Reference the allocation containing the text rather than the
+        //  physical line, since the text of a line from a mapped file is
+        //  allocated when it is decoded and may be discarded from the
+        //  physical line while this logical line is displayed.
+        //
+
+        if (LineContents->MemoryToFree != NULL) {
+            YoriLibReference(LineContents->MemoryToFree);
+        }
+        LogicalLine->Line.MemoryToFree = LineContents->MemoryToFree;
     }
 
     return TRUE;
@@ -971,6 +1319,8 @@ MoreCopyRangeIntoLogicalLine(
  @param OutputLines Points to an array of NumberLogicalLines elements.
         On successful completion, these are populated with the logical lines
         derived from the physical line.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOLEAN
 MoreGenerateLogicalLinesFromPhysicalLine(
@@ -981,56 +1331,39 @@ MoreGenerateLogicalLinesFromPhysicalLine(
     __out_ecount(NumberLogicalLines) PMORE_LOGICAL_LINE OutputLines
     )
 {
-    YORI_ALLOC_SIZE_T Count = 0;
-    YORI_ALLOC_SIZE_T CharIndex = 0;
-    YORI_ALLOC_SIZE_T LogicalLineLength;
-    YORI_ALLOC_SIZE_T CharactersRemainingInMatch = 0;
-    YORI_STRING Subset;
+    YORI_ALLOC_SIZE_T Count;
     PMORE_LOGICAL_LINE ThisLine;
-    WORD InitialUserColor = PhysicalLine->InitialColor;
-    WORD InitialDisplayColor = PhysicalLine->InitialColor;
-    MORE_LINE_END_CONTEXT LineEndContext;
+    PMORE_LOGICAL_LINE_LAYOUT LineLayout;
+    PMORE_LINE_LAYOUT Layout;
 
-    YoriLibInitEmptyString(&Subset);
-    Subset.StartOfString = PhysicalLine->LineContents.StartOfString;
-    Subset.LengthInChars = PhysicalLine->LineContents.LengthInChars;
-    while(TRUE) {
+    Layout = MoreGetLineLayout(MoreContext, PhysicalLine);
+    if (Layout == NULL) {
+        return FALSE;
+    }
+
+    for (Count = FirstLogicalLineIndex; Count < Layout->LogicalLineCount; Count++) {
         if (Count >= FirstLogicalLineIndex + NumberLogicalLines) {
             break;
         }
-        LogicalLineLength = MoreGetLogicalLineLength(MoreContext, &Subset, MoreContext->ViewportWidth, InitialDisplayColor, InitialUserColor, CharactersRemainingInMatch, &LineEndContext);
-        if (Count >= FirstLogicalLineIndex) {
-            ThisLine = &OutputLines[Count - FirstLogicalLineIndex];
-            ThisLine->PhysicalLine = PhysicalLine;
-            ThisLine->InitialUserColor = InitialUserColor;
-            ThisLine->InitialDisplayColor = InitialDisplayColor;
-            ThisLine->CharactersRemainingInMatch = CharactersRemainingInMatch;
-            ThisLine->LogicalLineIndex = Count;
-            ThisLine->PhysicalLineCharacterOffset = CharIndex;
-            if (LogicalLineLength >= Subset.LengthInChars) {
-                ThisLine->MoreLogicalLines = FALSE;
-            } else {
-                ThisLine->MoreLogicalLines = TRUE;
-            }
-            ThisLine->ExplicitNewlineRequired = LineEndContext.ExplicitNewlineRequired;
-
-            ASSERT(ThisLine->CharactersRemainingInMatch == 0 || ThisLine->InitialUserColor != ThisLine->InitialDisplayColor);
-
-            if (!MoreCopyRangeIntoLogicalLine(MoreContext, ThisLine, LineEndContext.RequiresGeneration, LogicalLineLength, LineEndContext.CharactersNeededInAllocation)) {
-                return FALSE;
-            }
-
-            CharactersRemainingInMatch = LineEndContext.CharactersRemainingInMatch;
+        LineLayout = &Layout->LogicalLines[Count];
+        ThisLine = &OutputLines[Count - FirstLogicalLineIndex];
+        ThisLine->PhysicalLine = PhysicalLine;
+        ThisLine->InitialUserColor = LineLayout->InitialUserColor;
+        ThisLine->InitialDisplayColor = LineLayout->InitialDisplayColor;
+        ThisLine->CharactersRemainingInMatch = LineLayout->CharactersRemainingInMatch;
+        ThisLine->LogicalLineIndex = Count;
+        ThisLine->PhysicalLineCharacterOffset = LineLayout->PhysicalLineCharacterOffset;
+        if (Count + 1 < Layout->LogicalLineCount) {
+            ThisLine->MoreLogicalLines = TRUE;
+        } else {
+            ThisLine->MoreLogicalLines = FALSE;
         }
+        ThisLine->ExplicitNewlineRequired = LineLayout->ExplicitNewlineRequired;
 
-        InitialUserColor = LineEndContext.FinalUserColor;
-        InitialDisplayColor = LineEndContext.FinalDisplayColor;
-        Subset.StartOfString += LogicalLineLength;
-        Subset.LengthInChars = Subset.LengthInChars - LogicalLineLength;
-        Count++;
-        CharIndex = CharIndex + LogicalLineLength;
-        if (Subset.LengthInChars == 0) {
-            break;
+        ASSERT(ThisLine->CharactersRemainingInMatch == 0 || ThisLine->InitialUserColor != ThisLine->InitialDisplayColor);
+
+        if (!MoreCopyRangeIntoLogicalLine(MoreContext, ThisLine, LineLayout->RequiresGeneration, LineLayout->CharactersToConsume, LineLayout->CharactersNeededInAllocation)) {
+            return FALSE;
         }
     }
 
@@ -1316,7 +1649,8 @@ MoreGetNextLogicalLines(
         match.  This value is limited to MaxLogicalLinesMoved above.
 
  @return Pointer to the next physical line containing a match, or NULL
-         if no further physical lines contain a match.
+         if no further physical lines contain a match or the user pressed a
+         key before a match was found.
  */
 __success(return != NULL)
 PMORE_PHYSICAL_LINE
@@ -1333,8 +1667,10 @@ MoreFindNextLineWithSearchMatch(
     YORI_ALLOC_SIZE_T MatchOffset;
     YORI_ALLOC_SIZE_T Count;
     YORI_ALLOC_SIZE_T LogicalLinesThisPhysicalLine;
+    DWORD LinesSearched;
 
     Count = 0;
+    LinesSearched = 0;
 
     //
     //  MSFIX Although the function signature takes a logical line, this
@@ -1370,11 +1706,11 @@ MoreFindNextLineWithSearchMatch(
         }
 
         if (MatchAny) {
-            if (MoreFindNextSearchMatch(MoreContext, &SearchLine->LineContents, NULL, NULL)) {
+            if (MoreFindNextSearchMatch(MoreContext, MoreGetPhysicalLineContents(MoreContext, SearchLine), NULL, NULL)) {
                 break;
             }
         } else {
-            if (YoriLibFindFirstMatchSubstrIns(&SearchLine->LineContents, 1, SearchString, &MatchOffset)) {
+            if (YoriLibFindFirstMatchSubstrIns(MoreGetPhysicalLineContents(MoreContext, SearchLine), 1, SearchString, &MatchOffset)) {
                 break;
             }
         }
@@ -1383,6 +1719,20 @@ MoreFindNextLineWithSearchMatch(
             LogicalLinesThisPhysicalLine = MoreCountLogicalLinesOnPhysicalLine(MoreContext, SearchLine);
             Count = Count + LogicalLinesThisPhysicalLine;
         }
+
+        //
+        //  Periodically allow lines to be added, and if the user has
+        //  pressed a key, abandon the search so the key can be processed.
+        //
+
+        LinesSearched++;
+        if ((LinesSearched % MORE_LINE_INDEX_CHUNK_SIZE) == 0) {
+            ReleaseMutex(MoreContext->PhysicalLineMutex);
+            if (MoreIsKeyPressPending(MoreContext)) {
+                return NULL;
+            }
+            WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+        }
     }
 
     if (LogicalLinesMoved != NULL) {
@@ -1423,7 +1773,8 @@ MoreFindNextLineWithSearchMatch(
         match.  This value is limited to MaxLogicalLinesMoved above.
 
  @return Pointer to the next physical line containing a match, or NULL
-         if no further physical lines contain a match.
+         if no further physical lines contain a match or the user pressed a
+         key before a match was found.
  */
 __success(return != NULL)
 PMORE_PHYSICAL_LINE
@@ -1440,8 +1791,10 @@ MoreFindPreviousLineWithSearchMatch(
     YORI_ALLOC_SIZE_T MatchOffset;
     YORI_ALLOC_SIZE_T Count;
     YORI_ALLOC_SIZE_T LogicalLinesThisPhysicalLine;
+    DWORD LinesSearched;
 
     Count = 0;
+    LinesSearched = 0;
 
     if (PreviousMatchLine == NULL) {
         SearchLine = NULL;
@@ -1465,11 +1818,11 @@ MoreFindPreviousLineWithSearchMatch(
         }
 
         if (MatchAny) {
-            if (MoreFindNextSearchMatch(MoreContext, &SearchLine->LineContents, NULL, NULL)) {
+            if (MoreFindNextSearchMatch(MoreContext, MoreGetPhysicalLineContents(MoreContext, SearchLine), NULL, NULL)) {
                 break;
             }
         } else {
-            if (YoriLibFindFirstMatchSubstrIns(&SearchLine->LineContents, 1, SearchString, &MatchOffset)) {
+            if (YoriLibFindFirstMatchSubstrIns(MoreGetPhysicalLineContents(MoreContext, SearchLine), 1, SearchString, &MatchOffset)) {
                 break;
             }
         }
@@ -1478,6 +1831,20 @@ MoreFindPreviousLineWithSearchMatch(
             LogicalLinesThisPhysicalLine = MoreCountLogicalLinesOnPhysicalLine(MoreContext, SearchLine);
             Count = Count + LogicalLinesThisPhysicalLine;
         }
+
+        //
+        //  Periodically allow lines to be added, and if the user has
+        //  pressed a key, abandon the search so the key can be processed.
+        //
+
+        LinesSearched++;
+        if ((LinesSearched % MORE_LINE_INDEX_CHUNK_SIZE) == 0) {
+            ReleaseMutex(MoreContext->PhysicalLineMutex);
+            if (MoreIsKeyPressPending(MoreContext)) {
+                return NULL;
+            }
+            WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+        }
     }
 
     if (LogicalLinesMoved != NULL) {
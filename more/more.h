@@ -36,23 +36,112 @@
 #define MORE_MAX_SEARCHES 10
 
 /**
- Data describing a physical line.  A physical line is a line of text from the
- data source, which may take more characters than fit on a viewport line.
+ The number of bytes of a mapped file to map at a time.  Ingesting a file
+ maps successive windows of this size, and decoding lines for display or
+ search retains one window so that neighbouring lines can be decoded without
+ remapping.
  */
-typedef struct _MORE_PHYSICAL_LINE {
+#define MORE_MAPPED_VIEW_SIZE (64 * 1024 * 1024)
+
+/**
+ The maximum number of bytes in a single physical line ingested from a mapped
+ file.  Longer lines are split into multiple physical lines.  This must be
+ smaller than MORE_MAPPED_VIEW_SIZE by at least the allocation granularity so
+ any line can be contained in a single view.
+ */
+#define MORE_MAPPED_MAX_LINE_LENGTH (16 * 1024 * 1024)
+
+/**
+ The number of physical lines from mapped files whose decoded contents are
+ retained at any one time.  When another line is decoded, the contents of
+ the line decoded this many lines earlier are discarded.
+ */
+#define MORE_DECODED_LINE_COUNT 4096
+
+/**
+ The number of physical lines whose division into logical lines is retained
+ at any one time.  A physical line's layout is stored in the slot indicated
+ by its line number modulo this value.
+ */
+#define MORE_LINE_LAYOUT_CACHE_SIZE 1024
+
+/**
+ The maximum number of threads used to compare physical lines against a new
+ filter.
+ */
+#define MORE_FILTER_MAX_WORKERS 8
+
+/**
+ The maximum number of ranges of physical lines which can be claimed by
+ filter threads before the results of the earliest range are published.
+ */
+#define MORE_FILTER_RANGE_COUNT 64
+
+/**
+ A range of a mapped file which is currently mapped into memory.
+ */
+typedef struct _MORE_MAPPED_VIEW {
+
+    /**
+     Pointer to the mapped range, or NULL if no range is mapped.
+     */
+    PUCHAR Base;
 
     /**
-     A list of physical lines.  Paired with MORE_CONTEXT::PhysicalLineList
-     and synchronized with MORE_CONTEXT::PhysicalLineMutex .
+     The offset within the file of the beginning of the mapped range.
      */
-    YORI_LIST_ENTRY LineList;
+    DWORDLONG Offset;
 
     /**
-     A list of physical lines matching the current search criteria.  Paired
-     with MORE_CONTEXT::FilteredPhysicalLineList and synchronized with
-     MORE_CONTEXT::PhysicalLineMutex .
+     The number of bytes in the mapped range.
      */
-    YORI_LIST_ENTRY FilteredLineList;
+    DWORD Length;
+} MORE_MAPPED_VIEW, *PMORE_MAPPED_VIEW;
+
+/**
+ A file in an 8 bit encoding whose physical lines refer to ranges within a
+ mapping of the file rather than containing a copy of the text.  The text is
+ decoded when a line is displayed or searched.
+ */
+typedef struct _MORE_MAPPED_SOURCE {
+
+    /**
+     The entry within MORE_CONTEXT::MappedSourceList .
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     A handle to the file mapping.
+     */
+    HANDLE MappingHandle;
+
+    /**
+     The size of the file when it was mapped.
+     */
+    DWORDLONG FileSize;
+
+    /**
+     The encoding of the text in the file.
+     */
+    DWORD Encoding;
+
+    /**
+     The granularity that a view of the file must be aligned to.
+     */
+    DWORD AllocationGranularity;
+
+    /**
+     The view used to decode lines for display or search.  This is only used
+     from the viewport thread.
+     */
+    MORE_MAPPED_VIEW DecodeView;
+} MORE_MAPPED_SOURCE, *PMORE_MAPPED_SOURCE;
+
+/**
+ Data describing a physical line.  A physical line is a line of text from the
+ data source, which may take more characters than fit on a viewport line.
+ */
+typedef struct _MORE_PHYSICAL_LINE {
 
     /**
      Pointer to the referenced allocation that contains this physical line.
@@ -64,25 +153,238 @@ typedef struct _MORE_PHYSICAL_LINE {
      */
     WORD InitialColor;
 
+    /**
+     Set by a filter thread to indicate whether this line matches the filter
+     being applied, until the result is published to
+     MORE_CONTEXT::FilteredPhysicalLines .
+     */
+    BOOLEAN FilterMatch;
+
     /**
      The number of this physical line within the input stream.  The first
-     line is one.
+     line is one.  This line is found at index LineNumber - 1 within
+     MORE_CONTEXT::PhysicalLines .
      */
     DWORDLONG LineNumber;
 
     /**
      The number of this physical line within the set of lines which match the
      filter criteria.  If filtering is not enabled, this is the same as
-     LineNumber, above.
+     LineNumber, above.  If the line matches, it is found at index
+     FilteredLineNumber - 1 within MORE_CONTEXT::FilteredPhysicalLines .
+     If the line does not match, this value is stale.
      */
     DWORDLONG FilteredLineNumber;
 
+    /**
+     If the line was ingested from a mapped file, points to the file.  In
+     this case LineContents is only populated while the line is decoded, and
+     should be obtained via @ref MoreGetPhysicalLineContents .  If NULL,
+     LineContents always contains the line.
+     */
+    PMORE_MAPPED_SOURCE MappedSource;
+
+    /**
+     If the line was ingested from a mapped file, the offset of the line
+     within the file.
+     */
+    DWORDLONG SourceOffset;
+
+    /**
+     If the line was ingested from a mapped file, the number of bytes in the
+     line within the file, not including the line ending.
+     */
+    YORI_ALLOC_SIZE_T SourceLength;
+
     /**
      The contents of the physical line.
      */
     YORI_STRING LineContents;
 } MORE_PHYSICAL_LINE, *PMORE_PHYSICAL_LINE;
 
+/**
+ The number of physical lines described by each chunk of a line index.
+ */
+#define MORE_LINE_INDEX_CHUNK_SIZE 4096
+
+/**
+ An array of physical lines, ordered by line number.  The array is divided
+ into fixed size chunks so that it can grow without moving existing
+ entries, and any line can be found by its index without walking the lines
+ before it.  Synchronized with MORE_CONTEXT::PhysicalLineMutex .
+ */
+typedef struct _MORE_LINE_INDEX {
+
+    /**
+     An array of pointers to chunks, each of which contains
+     MORE_LINE_INDEX_CHUNK_SIZE pointers to physical lines.
+     */
+    PMORE_PHYSICAL_LINE **Chunks;
+
+    /**
+     The number of elements allocated in the Chunks array.
+     */
+    DWORD ChunksAllocated;
+
+    /**
+     The number of chunks which have been allocated.
+     */
+    DWORD ChunksPopulated;
+} MORE_LINE_INDEX, *PMORE_LINE_INDEX;
+
+/**
+ A thread which compares physical lines against a new filter.
+ */
+typedef struct _MORE_FILTER_WORKER {
+
+    /**
+     Pointer to the more context.
+     */
+    struct _MORE_CONTEXT *MoreContext;
+
+    /**
+     Handle to the thread.
+     */
+    HANDLE Thread;
+
+    /**
+     The mapped file that View refers to, if any.
+     */
+    PMORE_MAPPED_SOURCE ViewSource;
+
+    /**
+     A view of a mapped file used by this thread to decode lines.  Each
+     thread needs its own view, since the view used for display is only
+     used from the viewport thread.
+     */
+    MORE_MAPPED_VIEW View;
+} MORE_FILTER_WORKER, *PMORE_FILTER_WORKER;
+
+/**
+ A range of physical lines claimed by a filter thread.
+ */
+typedef struct _MORE_FILTER_RANGE {
+
+    /**
+     The zero based index of the first physical line in the range.
+     */
+    DWORDLONG Start;
+
+    /**
+     The zero based index of the physical line following the range.
+     */
+    DWORDLONG End;
+
+    /**
+     TRUE once every line in the range has been compared against the filter.
+     */
+    BOOLEAN Complete;
+} MORE_FILTER_RANGE, *PMORE_FILTER_RANGE;
+
+/**
+ State describing the application of a new filter in the background.  The
+ physical lines are divided into ranges that are claimed by filter threads,
+ and the results for each range are published to the filtered lines in
+ order as ranges complete, so the viewport can display matches while later
+ lines are still being compared.  All fields except the events and threads
+ are synchronized with MORE_CONTEXT::PhysicalLineMutex .
+ */
+typedef struct _MORE_FILTER_STATE {
+
+    /**
+     A manual reset event which is signalled while there are lines which
+     have not been claimed by a filter thread.
+     */
+    HANDLE WorkEvent;
+
+    /**
+     A manual reset event which is signalled when no filter thread is
+     comparing lines.
+     */
+    HANDLE IdleEvent;
+
+    /**
+     A manual reset event which is signalled when filter threads should
+     terminate.
+     */
+    HANDLE ExitEvent;
+
+    /**
+     The number of threads in Workers.
+     */
+    DWORD WorkerCount;
+
+    /**
+     The number of filter threads which are currently comparing a range of
+     lines.
+     */
+    DWORD ActiveWorkers;
+
+    /**
+     The filter threads.
+     */
+    MORE_FILTER_WORKER Workers[MORE_FILTER_MAX_WORKERS];
+
+    /**
+     TRUE if the filter being applied has been abandoned.  Threads stop
+     comparing lines and nothing further is published.
+     */
+    BOOLEAN Cancel;
+
+    /**
+     TRUE if the viewport has been cleared for a new filter and is waiting
+     for the first match at or after RestartLineNumber to be published.
+     This is only used from the viewport thread.
+     */
+    BOOLEAN RestartPending;
+
+    /**
+     The number of search strings in SearchStrings.
+     */
+    UCHAR SearchCount;
+
+    /**
+     A copy of the search strings being applied, so that the user can edit
+     search strings while a filter is applied.
+     */
+    YORI_STRING SearchStrings[MORE_MAX_SEARCHES];
+
+    /**
+     The line number of the line at the top of the viewport when the filter
+     was changed.  This is only used from the viewport thread.
+     */
+    DWORDLONG RestartLineNumber;
+
+    /**
+     The zero based index of the first physical line which has not been
+     claimed by a filter thread.
+     */
+    DWORDLONG NextLine;
+
+    /**
+     The number of ranges which have been claimed.  The range is found at
+     this value modulo MORE_FILTER_RANGE_COUNT within Ranges.
+     */
+    DWORD RangesClaimed;
+
+    /**
+     The number of ranges whose results have been published.
+     */
+    DWORD RangesPublished;
+
+    /**
+     Ranges which have been claimed and not yet published.
+     */
+    MORE_FILTER_RANGE Ranges[MORE_FILTER_RANGE_COUNT];
+
+    /**
+     The progress displayed on the status line, as a percentage, or
+     (DWORD)-1 if no filter was being applied.  This is only used from the
+     viewport thread.
+     */
+    DWORD ProgressInStatus;
+} MORE_FILTER_STATE, *PMORE_FILTER_STATE;
+
 /**
  A logical line, meaning a line rendered for display on the console.
  */
@@ -201,6 +503,100 @@ typedef struct _MORE_LINE_END_CONTEXT {
     YORI_ALLOC_SIZE_T CharactersRemainingInMatch;
 } MORE_LINE_END_CONTEXT, *PMORE_LINE_END_CONTEXT;
 
+/**
+ Information about a single logical line within a physical line that is
+ needed to generate it without parsing any earlier part of the physical
+ line.
+ */
+typedef struct _MORE_LOGICAL_LINE_LAYOUT {
+
+    /**
+     The offset in characters from the beginning of the physical line to
+     the beginning of this logical line.
+     */
+    YORI_ALLOC_SIZE_T PhysicalLineCharacterOffset;
+
+    /**
+     The number of characters from the physical line which are part of this
+     logical line.
+     */
+    YORI_ALLOC_SIZE_T CharactersToConsume;
+
+    /**
+     The number of characters needed to describe the logical line contents,
+     which can differ from CharactersToConsume if RequiresGeneration is TRUE.
+     */
+    YORI_ALLOC_SIZE_T CharactersNeededInAllocation;
+
+    /**
+     Characters remaining in any search match at the beginning of this
+     logical line.
+     */
+    YORI_ALLOC_SIZE_T CharactersRemainingInMatch;
+
+    /**
+     The color attribute to display at the beginning of the line.
+     */
+    WORD InitialDisplayColor;
+
+    /**
+     The color attribute at the beginning of the line as indicated by the
+     input stream.
+     */
+    WORD InitialUserColor;
+
+    /**
+     If TRUE, an explicit newline should be added after this line.
+     */
+    BOOLEAN ExplicitNewlineRequired;
+
+    /**
+     If TRUE, the logical line contains escape sequences that are not in
+     the physical line, and must be generated character by character.
+     */
+    BOOLEAN RequiresGeneration;
+} MORE_LOGICAL_LINE_LAYOUT, *PMORE_LOGICAL_LINE_LAYOUT;
+
+/**
+ The division of a single physical line into logical lines for a specific
+ viewport width and set of search strings.
+ */
+typedef struct _MORE_LINE_LAYOUT {
+
+    /**
+     The physical line that this layout describes, or NULL if this slot is
+     not in use.
+     */
+    PMORE_PHYSICAL_LINE PhysicalLine;
+
+    /**
+     The viewport width that the layout was calculated for.
+     */
+    YORI_ALLOC_SIZE_T ViewportWidth;
+
+    /**
+     The value of MORE_CONTEXT::LineLayoutGeneration when the layout was
+     calculated.  If this no longer matches, the search strings have changed
+     since, and the layout is stale.
+     */
+    DWORD Generation;
+
+    /**
+     The number of logical lines within the physical line.
+     */
+    YORI_ALLOC_SIZE_T LogicalLineCount;
+
+    /**
+     The number of elements allocated in LogicalLines.
+     */
+    YORI_ALLOC_SIZE_T LogicalLinesAllocated;
+
+    /**
+     An array of LogicalLineCount elements describing each logical line.
+     */
+    PMORE_LOGICAL_LINE_LAYOUT LogicalLines;
+} MORE_LINE_LAYOUT, *PMORE_LINE_LAYOUT;
+
 /**
  Additional information about each search string.  This is seperated from the
  search strings to allow the search strings to be passed as-is when searching
@@ -222,23 +618,67 @@ typedef struct _MORE_SEARCH_CONTEXT {
 typedef struct _MORE_CONTEXT {
 
     /**
-     A linked list of physical lines.
+     An array of all physical lines.  The number of entries is LineCount.
+     */
+    MORE_LINE_INDEX PhysicalLines;
+
+    /**
+     An array of physical lines matching the current search criteria.  The
+     number of entries is FilteredLineCount.
+     */
+    MORE_LINE_INDEX FilteredPhysicalLines;
+
+    /**
+     The number of physical lines, from the beginning of PhysicalLines, that
+     have been compared against the current filter, with any matches added
+     to FilteredPhysicalLines.  If this is less than LineCount, a new filter
+     is being applied in the background.
      */
-    YORI_LIST_ENTRY PhysicalLineList;
+    DWORDLONG FilterScanLineCount;
 
     /**
-     A linked list of physical lines matching the current search criteria.
+     State for applying a new filter in the background.
      */
-    YORI_LIST_ENTRY FilteredPhysicalLineList;
+    MORE_FILTER_STATE Filter;
 
     /**
-     Synchronization around PhysicalLineList.
+     Synchronization around PhysicalLines and FilteredPhysicalLines.
      */
     HANDLE PhysicalLineMutex;
 
     /**
-     An event that is signalled when new lines are added to the
-     PhysicalLineList in case the viewport thread wants to update display
+     A list of files whose physical lines refer to a mapping of the file.
+     */
+    YORI_LIST_ENTRY MappedSourceList;
+
+    /**
+     An array of physical lines from mapped files whose contents are
+     currently decoded.  This is only used from the viewport thread.
+     */
+    PMORE_PHYSICAL_LINE DecodedLines[MORE_DECODED_LINE_COUNT];
+
+    /**
+     The index within DecodedLines of the next line to discard.
+     */
+    YORI_ALLOC_SIZE_T DecodedLineIndex;
+
+    /**
+     The division of recently displayed physical lines into logical lines,
+     so that moving the viewport does not need to parse each line again.
+     This is only used from the viewport thread.
+     */
+    MORE_LINE_LAYOUT LineLayouts[MORE_LINE_LAYOUT_CACHE_SIZE];
+
+    /**
+     Incremented whenever the search strings change, which invalidates any
+     layouts in LineLayouts since search matches affect the colors and
+     contents of logical lines.
+     */
+    DWORD LineLayoutGeneration;
+
+    /**
+     An event that is signalled when new lines are added to
+     PhysicalLines in case the viewport thread wants to update display
      when lines are added.
      */
     HANDLE PhysicalLineAvailableEvent;
@@ -269,14 +709,14 @@ typedef struct _MORE_CONTEXT {
 
     /**
      An array of size ViewportHeight of lines currently displayed.  Note these
-     refer to the strings in the PhysicalLineList.
+     refer to the strings in PhysicalLines.
      */
     PMORE_LOGICAL_LINE DisplayViewportLines;
 
     /**
      An array of size ViewportHeight of lines that are being constructed to
-     display in future.  Note these refer to the strings in the
-     PhysicalLineList.
+     display in future.  Note these refer to the strings in
+     PhysicalLines.
      */
     PMORE_LOGICAL_LINE StagingViewportLines;
 
@@ -353,6 +793,12 @@ typedef struct _MORE_CONTEXT {
      */
     HANDLE IngestThread;
 
+    /**
+     Handle to the console input, used to check whether the user has pressed
+     a key while a long search is in progress.
+     */
+    HANDLE InputHandle;
+
     /**
      TRUE if we are in search mode, meaning that keystrokes will be applied
      to the active SearchString.  The active SearchString is identified by
@@ -485,11 +931,45 @@ MoreIngestThread(
     __in LPVOID Context
     );
 
+__success(return)
+BOOLEAN
+MoreDecodeMappedLine(
+    __in PMORE_CONTEXT MoreContext,
+    __in DWORD Encoding,
+    __in_ecount(Length) PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T Length,
+    __out PYORI_STRING Output
+    );
+
+PUCHAR
+MoreMapSourceRange(
+    __in PMORE_MAPPED_SOURCE Source,
+    __inout PMORE_MAPPED_VIEW View,
+    __in DWORDLONG Offset,
+    __in YORI_ALLOC_SIZE_T Length
+    );
+
+PYORI_STRING
+MoreGetPhysicalLineContents(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_PHYSICAL_LINE PhysicalLine
+    );
+
+VOID
+MoreCloseMappedSources(
+    __in PMORE_CONTEXT MoreContext
+    );
+
 BOOL
 MoreViewportDisplay(
     __inout PMORE_CONTEXT MoreContext
     );
 
+BOOLEAN
+MoreIsKeyPressPending(
+    __in PMORE_CONTEXT MoreContext
+    );
+
 UCHAR
 MoreSearchIndexForColorIndex(
     __in PMORE_CONTEXT MoreContext,
@@ -586,10 +1066,66 @@ MoreFindPreviousLineWithSearchMatch(
     __out_opt PYORI_ALLOC_SIZE_T LogicalLinesMoved
     );
 
+__success(return)
+BOOLEAN
+MoreLineIndexSet(
+    __inout PMORE_LINE_INDEX LineIndex,
+    __in DWORDLONG Index,
+    __in PMORE_PHYSICAL_LINE PhysicalLine
+    );
+
+PMORE_PHYSICAL_LINE
+MoreLineIndexGet(
+    __in PMORE_LINE_INDEX LineIndex,
+    __in DWORDLONG Index
+    );
+
+VOID
+MoreLineIndexFree(
+    __inout PMORE_LINE_INDEX LineIndex
+    );
+
+VOID
+MoreInvalidateLineLayouts(
+    __in PMORE_CONTEXT MoreContext
+    );
+
+VOID
+MoreFreeLineLayouts(
+    __in PMORE_CONTEXT MoreContext
+    );
+
+DWORDLONG
+MoreFindFilteredLineIndex(
+    __in PMORE_CONTEXT MoreContext,
+    __in DWORDLONG LineNumber
+    );
+
 PMORE_PHYSICAL_LINE
 MoreUpdateFilteredLines(
     __in PMORE_CONTEXT MoreContext,
     __in_opt PMORE_PHYSICAL_LINE PreviousStartPoint
     );
 
+__success(return)
+BOOLEAN
+MoreFilterStart(
+    __in PMORE_CONTEXT MoreContext
+    );
+
+VOID
+MoreFilterCancel(
+    __in PMORE_CONTEXT MoreContext
+    );
+
+DWORD
+MoreFilterGetProgress(
+    __in PMORE_CONTEXT MoreContext
+    );
+
+VOID
+MoreFilterCleanup(
+    __in PMORE_CONTEXT MoreContext
+    );
+
 // vim:sw=4:ts=4:et:
@@ -167,9 +167,9 @@ MoreInitContext(
     MoreContext->SuspendPagination = SuspendPagination;
     MoreContext->WaitForMore = WaitForMore;
     MoreContext->TabWidth = 4;
+    MoreContext->Filter.ProgressInStatus = (DWORD)-1;
 
-    YoriLibInitializeListHead(&MoreContext->PhysicalLineList);
-    YoriLibInitializeListHead(&MoreContext->FilteredPhysicalLineList);
+    YoriLibInitializeListHead(&MoreContext->MappedSourceList);
     MoreContext->PhysicalLineMutex = CreateMutex(NULL, FALSE, NULL);
     if (MoreContext->PhysicalLineMutex == NULL) {
         return FALSE;
@@ -241,8 +241,8 @@ MoreCleanupContext(
 {
     YORI_ALLOC_SIZE_T Index;
 
-    ASSERT(YoriLibIsListEmpty(&MoreContext->PhysicalLineList));
-    ASSERT(YoriLibIsListEmpty(&MoreContext->FilteredPhysicalLineList));
+    ASSERT(MoreContext->PhysicalLines.Chunks == NULL);
+    ASSERT(MoreContext->FilteredPhysicalLines.Chunks == NULL);
 
     if (MoreContext->DisplayViewportLines != NULL) {
         YoriLibFree(MoreContext->DisplayViewportLines);
@@ -280,6 +280,7 @@ MoreCleanupContext(
     }
 
     MoreContext->SearchColorIndex = 0;
+    MoreFreeLineLayouts(MoreContext);
 }
 
 /**
@@ -294,8 +295,8 @@ MoreGracefulExit(
     __inout PMORE_CONTEXT MoreContext
     )
 {
-    PYORI_LIST_ENTRY ListEntry;
     PMORE_PHYSICAL_LINE PhysicalLine;
+    DWORDLONG LineIndex;
     YORI_ALLOC_SIZE_T Index;
 
     YoriLibCancelSet();
@@ -305,21 +306,19 @@ MoreGracefulExit(
         YoriLibFreeStringContents(&MoreContext->DisplayViewportLines[Index].Line);
     }
 
-    ListEntry = YoriLibGetNextListEntry(&MoreContext->FilteredPhysicalLineList, NULL);
-    while (ListEntry != NULL) {
-        PhysicalLine = CONTAINING_RECORD(ListEntry, MORE_PHYSICAL_LINE, LineList);
-        YoriLibRemoveListItem(ListEntry);
-        ListEntry = YoriLibGetNextListEntry(&MoreContext->FilteredPhysicalLineList, NULL);
-    }
+    MoreFilterCleanup(MoreContext);
+    MoreLineIndexFree(&MoreContext->FilteredPhysicalLines);
+    MoreContext->FilteredLineCount = 0;
 
-    ListEntry = YoriLibGetNextListEntry(&MoreContext->PhysicalLineList, NULL);
-    while (ListEntry != NULL) {
-        PhysicalLine = CONTAINING_RECORD(ListEntry, MORE_PHYSICAL_LINE, LineList);
-        YoriLibRemoveListItem(ListEntry);
+    for (LineIndex = 0; LineIndex < MoreContext->LineCount; LineIndex++) {
+        PhysicalLine = MoreLineIndexGet(&MoreContext->PhysicalLines, LineIndex);
         YoriLibFreeStringContents(&PhysicalLine->LineContents);
         YoriLibDereference(PhysicalLine->MemoryToFree);
-        ListEntry = YoriLibGetNextListEntry(&MoreContext->PhysicalLineList, NULL);
     }
+    MoreLineIndexFree(&MoreContext->PhysicalLines);
+    MoreContext->LineCount = 0;
+
+    MoreCloseMappedSources(MoreContext);
 
     MoreCleanupContext(MoreContext);
 }
@@ -121,6 +121,8 @@ MoreDrawStatusLine(
     UCHAR SearchIndex;
     DWORD InvisibleChars;
     DWORD Percent;
+    DWORD FilterProgress;
+    TCHAR FilterStatus[32];
 
     //
     //  If the screen isn't full, there's no point displaying status
@@ -131,6 +133,7 @@ MoreDrawStatusLine(
          MoreContext->SuspendPagination)) {
 
         MoreContext->SearchDirty = FALSE;
+        MoreContext->Filter.ProgressInStatus = (DWORD)-1;
 
         return;
     }
@@ -187,7 +190,22 @@ MoreDrawStatusLine(
         ThreadActive = TRUE;
     }
 
-    if (!ThreadActive && TotalFilteredLines == LastViewportLine) {
+    //
+    //  Check filter status
+    //
+
+    FilterProgress = MoreFilterGetProgress(MoreContext);
+    MoreContext->Filter.ProgressInStatus = FilterProgress;
+    FilterStatus[0] = '\0';
+    if (MoreContext->FilterToSearch) {
+        if (FilterProgress != (DWORD)-1) {
+            YoriLibSPrintf(FilterStatus, _T(" (filtering %i%%)"), FilterProgress);
+        } else {
+            YoriLibSPrintf(FilterStatus, _T(" (filtered)"));
+        }
+    }
+
+    if (!ThreadActive && FilterProgress == (DWORD)-1 && TotalFilteredLines == LastViewportLine) {
         StringToDisplay = _T("End");
     } else if (!PageFull) {
         StringToDisplay = _T("Awaiting data");
@@ -225,7 +243,7 @@ MoreDrawStatusLine(
                       LastViewportLine,
                       TotalFilteredLines,
                       Percent,
-                      (MoreContext->FilterToSearch?_T(" (filtered)"):_T("")),
+                      FilterStatus,
                       &SearchColorString,
                       SearchString);
     } else {
@@ -256,7 +274,7 @@ MoreDrawStatusLine(
                           LastViewportLine,
                           TotalFilteredLines,
                           Percent,
-                          (MoreContext->FilterToSearch?_T(" (filtered)"):_T("")));
+                          FilterStatus);
 
 
             //
@@ -1657,7 +1675,6 @@ MoreAreMoreLinesAvailable(
 {
     DWORDLONG LastViewportLineNumber;
     DWORDLONG LastPhysicalLineNumber;
-    PYORI_LIST_ENTRY ListEntry;
     PMORE_PHYSICAL_LINE LastPhysicalLine;
     PMORE_LOGICAL_LINE LastViewportLine;
 
@@ -1691,8 +1708,8 @@ MoreAreMoreLinesAvailable(
     LastViewportLineNumber = LastViewportLine->PhysicalLine->LineNumber;
 
     WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
-    ListEntry = YoriLibGetPreviousListEntry(&MoreContext->PhysicalLineList, NULL);
-    LastPhysicalLine = CONTAINING_RECORD(ListEntry, MORE_PHYSICAL_LINE, LineList);
+    ASSERT(MoreContext->LineCount > 0);
+    LastPhysicalLine = MoreLineIndexGet(&MoreContext->PhysicalLines, MoreContext->LineCount - 1);
     LastPhysicalLineNumber = LastPhysicalLine->LineNumber;
     ReleaseMutex(MoreContext->PhysicalLineMutex);
 
@@ -1704,9 +1721,92 @@ MoreAreMoreLinesAvailable(
 }
 
 /**
- Apply search changes that could affect the set of lines being filtered.
+ After a new filter has started to be applied in the background, check
+ whether the line that should be displayed at the top of the viewport is
+ known.  This is the first line matching the filter at or after the line
+ that was at the top of the viewport when the filter changed, which is known
+ once it has been published or every line has been compared.  When it is
+ known, the viewport is populated from it.
+
+ @param MoreContext Pointer to the more context.
+ */
+VOID
+MoreCheckForFilterRestart(
+    __inout PMORE_CONTEXT MoreContext
+    )
+{
+    PMORE_PHYSICAL_LINE NewStart;
+    DWORDLONG Index;
+
+    if (!MoreContext->Filter.RestartPending) {
+        return;
+    }
+
+    NewStart = NULL;
+    WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+    Index = MoreFindFilteredLineIndex(MoreContext, MoreContext->Filter.RestartLineNumber);
+    if (Index < MoreContext->FilteredLineCount) {
+        NewStart = MoreLineIndexGet(&MoreContext->FilteredPhysicalLines, Index);
+    } else if (MoreContext->FilterScanLineCount < MoreContext->LineCount) {
+        ReleaseMutex(MoreContext->PhysicalLineMutex);
+        return;
+    }
+    ReleaseMutex(MoreContext->PhysicalLineMutex);
+
+    MoreContext->Filter.RestartPending = FALSE;
+
+    //
+    //  If the user has navigated while waiting, leave the viewport alone.
+    //
+
+    if (MoreContext->LinesInViewport == 0) {
+        MoreGenerateEntireViewportWithStartingLine(MoreContext, NewStart);
+    }
+}
+
+/**
+ Check whether the user has pressed a key which has not yet been processed.
+ This allows long operations on the viewport thread to be abandoned so that
+ the key can be processed.
+
+ @param MoreContext Pointer to the more context.
+
+ @return TRUE if a key press is waiting to be processed, FALSE if not.
+ */
+BOOLEAN
+MoreIsKeyPressPending(
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    INPUT_RECORD InputRecords[20];
+    DWORD ActuallyRead;
+    DWORD Index;
+
+    if (MoreContext->InputHandle == NULL) {
+        return FALSE;
+    }
+
+    if (!PeekConsoleInput(MoreContext->InputHandle, InputRecords, sizeof(InputRecords)/sizeof(InputRecords[0]), &ActuallyRead)) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < ActuallyRead; Index++) {
+        if (InputRecords[Index].EventType == KEY_EVENT &&
+            InputRecords[Index].Event.KeyEvent.bKeyDown) {
+
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ After a new filter has started
  This applies the new filter, then displays the new set of lines in the
- viewport, and indicates that the status line needs to be redrawn.
+ viewport, and indicates that the status line needs to be redrawn.  When a
+ filter is in effect, it is applied in the background, and the viewport is
+ populated as matches are found.
 
  @param MoreContext Pointer to the more context.
  */
@@ -1716,6 +1816,23 @@ MoreRefreshFilteredLinesDisplay(
     )
 {
     PMORE_PHYSICAL_LINE NewStart;
+
+    MoreContext->Filter.RestartPending = FALSE;
+    if (MoreContext->FilterToSearch && MoreFilterStart(MoreContext)) {
+        MoreContext->Filter.RestartLineNumber = 0;
+        if (MoreContext->LinesInViewport > 0) {
+            MoreContext->Filter.RestartLineNumber = MoreContext->DisplayViewportLines[0].PhysicalLine->LineNumber;
+        }
+
+        MoreClearScreen(MoreContext);
+        MoreContext->LinesInViewport = 0;
+        MoreContext->LinesInPage = 0;
+        MoreContext->SearchDirty = TRUE;
+        MoreContext->Filter.RestartPending = TRUE;
+        MoreCheckForFilterRestart(MoreContext);
+        return;
+    }
+
     if (MoreContext->LinesInViewport > 0) {
         NewStart = MoreUpdateFilteredLines(MoreContext, MoreContext->DisplayViewportLines[0].PhysicalLine);
     } else {
@@ -1794,6 +1911,7 @@ MoreAppendToSearchString(
     }
     MoreContext->SearchContext[SearchIndex].ColorIndex = MoreContext->SearchColorIndex;
     MoreContext->SearchDirty = TRUE;
+    MoreInvalidateLineLayouts(MoreContext);
     return TRUE;
 }
 
@@ -1957,6 +2075,7 @@ MoreProcessKeyDown(
                     }
                 } else {
                     SearchString->LengthInChars = SearchString->LengthInChars - InputRecord->Event.KeyEvent.wRepeatCount;
+                    MoreInvalidateLineLayouts(MoreContext);
                 }
                 MoreContext->SearchDirty = TRUE;
             } else if (Char == '\r') {
@@ -2235,7 +2354,10 @@ MoreCheckForStatusLineChange(
     __inout PMORE_CONTEXT MoreContext
     )
 {
-    if (MoreContext->TotalLinesInViewportStatus != MoreContext->FilteredLineCount || MoreContext->SearchDirty) {
+    if (MoreContext->TotalLinesInViewportStatus != MoreContext->FilteredLineCount ||
+        MoreContext->Filter.ProgressInStatus != MoreFilterGetProgress(MoreContext) ||
+        MoreContext->SearchDirty) {
+
         MoreClearStatusLine(MoreContext);
         MoreDrawStatusLine(MoreContext);
     }
@@ -2706,6 +2828,7 @@ MoreViewportDisplay(
     if (InHandle == INVALID_HANDLE_VALUE) {
         return FALSE;
     }
+    MoreContext->InputHandle = InHandle;
 
     //
     //  If YoriQuickEdit is enabled, set the extended flags, which indicates
@@ -2810,11 +2933,14 @@ MoreViewportDisplay(
         }
 
         if (WaitObject == WAIT_TIMEOUT) {
+            MoreCheckForFilterRestart(MoreContext);
             if (YoriLibIsPeriodicScrollActive(&MoreContext->Selection)) {
                 MorePeriodicScrollForSelection(MoreContext);
                 MoreCheckForWindowSizeChange(MoreContext);
                 MoreCheckForStatusLineChange(MoreContext);
-            } else if (MoreContext->SuspendPagination && MoreAreMoreLinesAvailable(MoreContext)) {
+            } else if (MoreContext->SuspendPagination &&
+                       !MoreContext->Filter.RestartPending &&
+                       MoreAreMoreLinesAvailable(MoreContext)) {
                 MoreAddNewLinesToViewport(MoreContext);
             } else {
                 MoreCheckForWindowSizeChange(MoreContext);
@@ -2826,7 +2952,11 @@ MoreViewportDisplay(
             }
             if (ObjectsToWaitFor[WaitObject - WAIT_OBJECT_0] == MoreContext->PhysicalLineAvailableEvent) {
 
-                MoreAddNewLinesToViewport(MoreContext);
+                if (MoreContext->Filter.RestartPending) {
+                    MoreCheckForFilterRestart(MoreContext);
+                } else {
+                    MoreAddNewLinesToViewport(MoreContext);
+                }
 
             } else if (ObjectsToWaitFor[WaitObject - WAIT_OBJECT_0] == MoreContext->IngestThread) {
 
@@ -2938,6 +3068,7 @@ MoreViewportDisplay(
     }
 
     YoriLibCleanupSelection(&MoreContext->Selection);
+    MoreContext->InputHandle = NULL;
     CloseHandle(InHandle);
     return TRUE;
 }
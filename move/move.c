@@ -35,10 +35,11 @@ CHAR strMoveHelpText[] =
         "\n"
         "Moves or renames one or more files.\n"
         "\n"
-        "MOVE [-license] [-b] [-k] [-p] <src>\n"
-        "MOVE [-license] [-b] [-k] [-p] <src> [<src> ...] <dest>\n"
+        "MOVE [-license] [-b] [-j n] [-k] [-p] <src>\n"
+        "MOVE [-license] [-b] [-j n] [-k] [-p] <src> [<src> ...] <dest>\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
+        "   -j             Move up to n files concurrently to another volume\n"
         "   -p             Move with POSIX semantics\n"
         "   -k             Keep existing files, do not overwrite\n";
 
@@ -56,43 +57,1186 @@ MoveHelp(VOID)
     return TRUE;
 }
 
+/**
+ The maximum number of worker threads that can move files concurrently.
+ */
+#define MOVE_MAX_WORKERS (64)
+
+/**
+ The number of files that can be queued for each worker thread before
+ enumeration waits for workers to catch up.
+ */
+#define MOVE_JOBS_PER_WORKER (16)
+
+/**
+ Files at least this large are copied between volumes with unbuffered IO
+ and several reads and writes in flight, which avoids filling the cache with
+ data that is about to be deleted from the source.  Smaller files, and files
+ with metadata that copying their data would not preserve, are moved with
+ MoveFileEx or copied with CopyFileEx.
+ */
+#define MOVE_UNBUFFERED_MINIMUM_SIZE (16 * 1024 * 1024)
+
+/**
+ A context passed between each source file match when moving multiple
+ files.
+ */
+typedef struct _MOVE_CONTEXT {
+
+    /**
+     Path to the destination for the move operation.
+     */
+    YORI_STRING Dest;
+
+    /**
+     The file system attributes of the destination.  Used to determine if
+     the destination exists and is a directory.
+     */
+    DWORD DestAttributes;
+
+    /**
+     The number of files that have been previously moved.  This can be used
+     to determine if we're about to move a second object over the top of
+     an earlier moved file.
+     */
+    DWORD FilesMoved;
+
+    /**
+     TRUE if existing files should be replaced, FALSE if they should be kept.
+     */
+    BOOLEAN ReplaceExisting;
+
+    /**
+     TRUE if the move should use POSIX semantics, where in use files are
+     removed from the namespace immediately.
+     */
+    BOOLEAN PosixSemantics;
+
+    /**
+     The volume containing the destination.  Objects on other volumes are
+     moved by copying and deleting them here rather than by MoveFileEx.  If
+     this is empty, all objects are moved with MoveFileEx.
+     */
+    YORI_STRING DestVolume;
+
+    /**
+     The number of files that could not be moved to another volume.  This
+     is updated by worker threads.
+     */
+    DWORD FilesFailed;
+
+    /**
+     The pool of worker threads moving files to another volume.  If NULL,
+     files are moved by the main thread as they are found.
+     */
+    PYORI_LIB_THREAD_POOL Pool;
+
+    /**
+     A semaphore limiting the number of files queued to the pool, so that
+     enumeration waits for workers to catch up.
+     */
+    HANDLE JobSemaphore;
+
+} MOVE_CONTEXT, *PMOVE_CONTEXT;
+
+/**
+ A single file to move to another volume, which may be queued to a worker
+ thread.
+ */
+typedef struct _MOVE_JOB {
+
+    /**
+     The thread pool item header.
+     */
+    YORI_LIB_WORK_ITEM WorkItem;
+
+    /**
+     The entry for this job within the list of files in a directory tree
+     being moved.  Only used if DeleteSource is FALSE.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     Pointer to the move context.
+     */
+    PMOVE_CONTEXT MoveContext;
+
+    /**
+     The full path to the source file.  This points into the same allocation
+     as the job.
+     */
+    YORI_STRING Source;
+
+    /**
+     The full path to the destination file.  This points into the same
+     allocation as the job.
+     */
+    YORI_STRING Dest;
+
+    /**
+     Information about the source file from enumeration.
+     */
+    WIN32_FIND_DATA FileInfo;
+
+    /**
+     TRUE if the source should be deleted as soon as the file is copied, and
+     the job freed once it has been processed.  FALSE if the file is part of
+     a directory tree, where the source is retained until every file in the
+     tree has been copied and the job is owned by the tree.
+     */
+    BOOLEAN DeleteSource;
+
+    /**
+     Set to TRUE once the destination has been created by copying the
+     source, so that it can be deleted if the move of the tree fails.
+     */
+    BOOLEAN Copied;
+
+} MOVE_JOB, *PMOVE_JOB;
+
+/**
+ A directory created in the destination while moving a tree to another
+ volume.  These are recorded so that if the move fails, they can be
+ removed.
+ */
+typedef struct _MOVE_CREATED_DIRECTORY {
+
+    /**
+     The entry for this directory within the list of created directories.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The full path to the directory.  This points into the same allocation
+     as the entry.
+     */
+    YORI_STRING Path;
+} MOVE_CREATED_DIRECTORY, *PMOVE_CREATED_DIRECTORY;
+
+/**
+ A callback that is invoked when a directory cannot be successfully enumerated.
+
+ @param FilePath Pointer to the file path that could not be enumerated.
+
+ @param ErrorCode The Win32 error code describing the failure.
+
+ @param Depth Recursion depth, ignored in this application.
+
+ @param Context Ignored.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+MoveFileEnumerateErrorCallback(
+    __in PYORI_STRING FilePath,
+    __in DWORD ErrorCode,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    YORI_STRING UnescapedFilePath;
+    BOOL Result = FALSE;
+
+    UNREFERENCED_PARAMETER(Depth);
+    UNREFERENCED_PARAMETER(Context);
+
+    YoriLibInitEmptyString(&UnescapedFilePath);
+    if (!YoriLibUnescapePath(FilePath, &UnescapedFilePath)) {
+        UnescapedFilePath.StartOfString = FilePath->StartOfString;
+        UnescapedFilePath.LengthInChars = FilePath->LengthInChars;
+    }
+
+    if (ErrorCode == ERROR_FILE_NOT_FOUND || ErrorCode == ERROR_PATH_NOT_FOUND) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("File or directory not found: %y\n"), &UnescapedFilePath);
+        Result = TRUE;
+    } else {
+        LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
+        YORI_STRING DirName;
+        LPTSTR FilePart;
+        YoriLibInitEmptyString(&DirName);
+        DirName.StartOfString = UnescapedFilePath.StartOfString;
+        FilePart = YoriLibFindRightMostCharacter(&UnescapedFilePath, '\\');
+        if (FilePart != NULL) {
+            DirName.LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - DirName.StartOfString);
+        } else {
+            DirName.LengthInChars = UnescapedFilePath.LengthInChars;
+        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Enumerate of %y failed: %s"), &DirName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+    }
+    YoriLibFreeStringContents(&UnescapedFilePath);
+    return Result;
+}
+
+/**
+ State for moving a directory tree to another volume.
+ */
+typedef struct _MOVE_TREE_CONTEXT {
+
+    /**
+     Pointer to the move context.
+     */
+    PMOVE_CONTEXT MoveContext;
+
+    /**
+     The full path to the source directory being moved.
+     */
+    PYORI_STRING SourceRoot;
+
+    /**
+     The full path to the destination directory.
+     */
+    PYORI_STRING DestRoot;
+
+    /**
+     The list of directories created in the destination, in the order they
+     were created.
+     */
+    YORI_LIST_ENTRY CreatedDirectories;
+
+    /**
+     The list of files found within the tree, in the order they were found.
+     */
+    YORI_LIST_ENTRY Files;
+} MOVE_TREE_CONTEXT, *PMOVE_TREE_CONTEXT;
+
+/**
+ Determine whether an object is on a different volume to the destination,
+ so it must be moved by copying and deleting it.
+
+ @param MoveContext Pointer to the move context, specifying the destination
+        volume.
+
+ @param FilePath Pointer to the full path to the source object.
+
+ @return TRUE if the object is on a different volume, FALSE if it is on the
+         same volume or the volume cannot be determined.
+ */
+BOOLEAN
+MoveIsCrossVolume(
+    __in PMOVE_CONTEXT MoveContext,
+    __in PYORI_STRING FilePath
+    )
+{
+    YORI_STRING SourceVolume;
+    BOOLEAN CrossVolume;
+
+    if (MoveContext->DestVolume.LengthInChars == 0) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&SourceVolume);
+    if (!YoriLibGetVolumePathName(FilePath, &SourceVolume)) {
+        return FALSE;
+    }
+
+    CrossVolume = FALSE;
+    if (YoriLibCompareStringIns(&SourceVolume, &MoveContext->DestVolume) != 0) {
+        CrossVolume = TRUE;
+    }
+
+    YoriLibFreeStringContents(&SourceVolume);
+    return CrossVolume;
+}
+
+/**
+ Delete a file.  If the file is read only, the attribute is removed so that
+ it can be deleted.
+
+ @param FilePath Pointer to the full path to the file to delete.
+
+ @return ERROR_SUCCESS to indicate success, or a Win32 error code.
+ */
+DWORD
+MoveDeleteFile(
+    __in PYORI_STRING FilePath
+    )
+{
+    DWORD Attributes;
+    DWORD Err;
+
+    if (DeleteFile(FilePath->StartOfString)) {
+        return ERROR_SUCCESS;
+    }
+
+    Err = GetLastError();
+    if (Err == ERROR_ACCESS_DENIED) {
+        Attributes = GetFileAttributes(FilePath->StartOfString);
+        if (Attributes != (DWORD)-1 &&
+            (Attributes & FILE_ATTRIBUTE_READONLY) != 0 &&
+            SetFileAttributes(FilePath->StartOfString, Attributes & ~(FILE_ATTRIBUTE_READONLY))) {
+
+            if (DeleteFile(FilePath->StartOfString)) {
+                return ERROR_SUCCESS;
+            }
+            Err = GetLastError();
+            SetFileAttributes(FilePath->StartOfString, Attributes);
+        }
+    }
+
+    return Err;
+}
+
+/**
+ Determine whether a file has metadata that would be lost by copying its
+ data into a newly created file.  This is any alternate data stream, any
+ extended attributes, or any access control entry that was applied to the
+ file rather than inherited from its parent, since a new file only receives
+ the entries inherited from its new parent.
+
+ @param Source Pointer to the full path to the file.
+
+ @param SourceHandle Handle to the opened file.
+
+ @return TRUE if the file has metadata that copying its data would lose, or
+         if this cannot be determined.  FALSE if copying its data is
+         sufficient.
+ */
+BOOLEAN
+MoveFileHasUncopiedMetadata(
+    __in PYORI_STRING Source,
+    __in HANDLE SourceHandle
+    )
+{
+    WIN32_FIND_STREAM_DATA FindStreamData;
+    YORI_FILE_EA_INFORMATION EaInfo;
+    IO_STATUS_BLOCK IoStatusBlock;
+    PSECURITY_DESCRIPTOR SecurityDescriptor;
+    SECURITY_DESCRIPTOR_CONTROL Control;
+    PACL Dacl;
+    PACE_HEADER Ace;
+    HANDLE hFind;
+    DWORD Revision;
+    DWORD LengthNeeded;
+    DWORD Index;
+    BOOL DaclPresent;
+    BOOL DaclDefaulted;
+    BOOLEAN Result;
+
+    //
+    //  If streams cannot be enumerated there's no way to know whether the
+    //  file has alternate streams, so leave it to a method that copies
+    //  them.
+    //
+
+    if (DllKernel32.pFindFirstStreamW == NULL ||
+        DllKernel32.pFindNextStreamW == NULL ||
+        DllNtDll.pNtQueryInformationFile == NULL ||
+        DllAdvApi32.pGetFileSecurityW == NULL ||
+        DllAdvApi32.pGetSecurityDescriptorControl == NULL ||
+        DllAdvApi32.pGetSecurityDescriptorDacl == NULL) {
+
+        return TRUE;
+    }
+
+    //
+    //  Every file has a default data stream, so any second stream is an
+    //  alternate stream.  File systems without streams fail the call.
+    //
+
+    hFind = DllKernel32.pFindFirstStreamW(Source->StartOfString, 0, &FindStreamData, 0);
+    if (hFind != INVALID_HANDLE_VALUE) {
+        Result = FALSE;
+        if (DllKernel32.pFindNextStreamW(hFind, &FindStreamData)) {
+            Result = TRUE;
+        }
+        FindClose(hFind);
+        if (Result) {
+            return TRUE;
+        }
+    }
+
+    if (DllNtDll.pNtQueryInformationFile(SourceHandle, &IoStatusBlock, &EaInfo, sizeof(EaInfo), FileEaInformation) == 0 &&
+        EaInfo.EaSize != 0) {
+
+        return TRUE;
+    }
+
+    //
+    //  File systems without security return no security descriptor, and
+    //  have no entries to lose.
+    //
+
+    LengthNeeded = 0;
+    DllAdvApi32.pGetFileSecurityW(Source->StartOfString, DACL_SECURITY_INFORMATION, NULL, 0, &LengthNeeded);
+    if (LengthNeeded == 0) {
+        return FALSE;
+    }
+
+    if (!YoriLibIsSizeAllocatable(LengthNeeded)) {
+        return TRUE;
+    }
+
+    SecurityDescriptor = YoriLibMalloc((YORI_ALLOC_SIZE_T)LengthNeeded);
+    if (SecurityDescriptor == NULL) {
+        return TRUE;
+    }
+
+    Result = TRUE;
+    if (DllAdvApi32.pGetFileSecurityW(Source->StartOfString, DACL_SECURITY_INFORMATION, SecurityDescriptor, LengthNeeded, &LengthNeeded) &&
+        DllAdvApi32.pGetSecurityDescriptorControl(SecurityDescriptor, &Control, &Revision) &&
+        DllAdvApi32.pGetSecurityDescriptorDacl(SecurityDescriptor, &DaclPresent, &Dacl, &DaclDefaulted)) {
+
+        //
+        //  A protected DACL does not inherit from its parent, and an entry
+        //  without the inherited flag was applied to this file.  Neither
+        //  would be present on a newly created file.
+        //
+
+        Result = FALSE;
+        if (Control & SE_DACL_PROTECTED) {
+            Result = TRUE;
+        } else if (DaclPresent && Dacl != NULL) {
+            Ace = (PACE_HEADER)(Dacl + 1);
+            for (Index = 0; Index < Dacl->AceCount; Index++) {
+                if ((Ace->AceFlags & INHERITED_ACE) == 0) {
+                    Result = TRUE;
+                    break;
+                }
+                Ace = YoriLibAddToPointer(Ace, Ace->AceSize);
+            }
+        }
+    }
+
+    YoriLibFree(SecurityDescriptor);
+    return Result;
+}
+
+/**
+ Copy the data of a large file to another volume with unbuffered IO and
+ several reads and writes in flight.  Since this copies data only, the
+ timestamps and attributes of the source are applied to the destination
+ afterwards, and files with alternate streams, extended attributes or
+ access control entries of their own are left for another method.  The
+ destination is flushed before returning, so the caller can delete the
+ source once this succeeds.  If the copy fails, the partially written
+ destination is deleted.
+
+ @param Source Pointer to the full path to the source file.
+
+ @param Dest Pointer to the full path to the destination file.
+
+ @param FileInfo Information about the source file from enumeration.
+
+ @param ReplaceExisting TRUE if an existing destination file should be
+        overwritten, FALSE if the copy should fail if the destination
+        exists.
+
+ @param Err On completion, set to ERROR_SUCCESS or a Win32 error code
+        describing why the copy failed.
+
+ @return TRUE to indicate the copy was attempted, or FALSE if the file
+         cannot be copied with unbuffered IO and another method should be
+         used.
+ */
+__success(return)
+BOOLEAN
+MoveCopyFileUnbuffered(
+    __in PYORI_STRING Source,
+    __in PYORI_STRING Dest,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in BOOLEAN ReplaceExisting,
+    __out PDWORD Err
+    )
+{
+    YORI_LIB_COPY_DATA_PARAMS Params;
+    HANDLE SourceHandle;
+    HANDLE DestHandle;
+    DWORD Disposition;
+    DWORD LastError;
+
+    SourceHandle = CreateFile(Source->StartOfString,
+                              GENERIC_READ,
+                              FILE_SHARE_READ,
+                              NULL,
+                              OPEN_EXISTING,
+                              FILE_FLAG_OPEN_NO_RECALL|FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_NO_BUFFERING|FILE_FLAG_OVERLAPPED,
+                              NULL);
+
+    if (SourceHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    if (MoveFileHasUncopiedMetadata(Source, SourceHandle)) {
+        CloseHandle(SourceHandle);
+        return FALSE;
+    }
+
+    //
+    //  When keeping existing files, the destination is only created if it
+    //  does not exist, so a file created after the move started is never
+    //  overwritten.
+    //
+
+    Disposition = CREATE_ALWAYS;
+    if (!ReplaceExisting) {
+        Disposition = CREATE_NEW;
+    }
+
+    DestHandle = CreateFile(Dest->StartOfString,
+                            GENERIC_WRITE,
+                            0,
+                            NULL,
+                            Disposition,
+                            FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_NO_BUFFERING|FILE_FLAG_OVERLAPPED,
+                            NULL);
+
+    if (DestHandle == INVALID_HANDLE_VALUE) {
+        LastError = GetLastError();
+        CloseHandle(SourceHandle);
+        if (LastError == ERROR_FILE_EXISTS) {
+            *Err = LastError;
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    ZeroMemory(&Params, sizeof(Params));
+    LastError = YoriLibCopyFileData(SourceHandle, DestHandle, &Params);
+    CloseHandle(SourceHandle);
+
+    if (LastError == ERROR_SUCCESS) {
+        if (!SetFileTime(DestHandle, &FileInfo->ftCreationTime, &FileInfo->ftLastAccessTime, &FileInfo->ftLastWriteTime) ||
+            !FlushFileBuffers(DestHandle)) {
+
+            LastError = GetLastError();
+        }
+    }
+
+    CloseHandle(DestHandle);
+
+    if (LastError == ERROR_SUCCESS) {
+        if (!SetFileAttributes(Dest->StartOfString, FileInfo->dwFileAttributes & (FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_ARCHIVE | FILE_ATTRIBUTE_NOT_CONTENT_INDEXED))) {
+            LastError = GetLastError();
+        }
+    }
+
+    if (LastError != ERROR_SUCCESS) {
+        DeleteFile(Dest->StartOfString);
+    }
+
+    *Err = LastError;
+    return TRUE;
+}
+
+/**
+ Copy a file within a directory tree to another volume with CopyFileEx,
+ leaving the source in place.  Links are copied as links.
+
+ @param MoveContext Pointer to the move context.
+
+ @param Job Pointer to the job describing the file to copy.
+
+ @return ERROR_SUCCESS to indicate success, or a Win32 error code.
+ */
+DWORD
+MoveCopyFileBuffered(
+    __in PMOVE_CONTEXT MoveContext,
+    __in PMOVE_JOB Job
+    )
+{
+    DWORD Flags;
+    BOOL Cancelled;
+
+    if (MoveContext->ReplaceExisting &&
+        (Job->FileInfo.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0) {
+
+        return YoriLibCopyFile(&Job->Source, &Job->Dest);
+    }
+
+    if (DllKernel32.pCopyFileExW == NULL) {
+        return ERROR_PROC_NOT_FOUND;
+    }
+
+    Flags = 0;
+    if (!MoveContext->ReplaceExisting) {
+        Flags = Flags | COPY_FILE_FAIL_IF_EXISTS;
+    }
+    if (Job->FileInfo.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+        Flags = Flags | COPY_FILE_COPY_SYMLINK;
+    }
+
+    Cancelled = FALSE;
+    if (!DllKernel32.pCopyFileExW(Job->Source.StartOfString, Job->Dest.StartOfString, NULL, NULL, &Cancelled, Flags)) {
+        return GetLastError();
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/**
+ Move or copy a single file to another volume.  Large files are copied with
+ unbuffered IO; smaller files are moved with MoveFileEx, or if the file is
+ part of a directory tree, copied with CopyFileEx.  If the file is not part
+ of a tree, the source is deleted once the copy is complete, otherwise the
+ source is retained until every file in the tree has been copied.  This is
+ called on the main thread, or on a worker thread when moving files in
+ parallel.  Failures are displayed by this function.
+
+ @param MoveContext Pointer to the move context.
+
+ @param Job Pointer to the job describing the file to move.
+ */
+VOID
+MoveFileAcrossVolumes(
+    __in PMOVE_CONTEXT MoveContext,
+    __in PMOVE_JOB Job
+    )
+{
+    LARGE_INTEGER FileSize;
+    DWORD LastError;
+    LPTSTR ErrText;
+
+    FileSize.LowPart = Job->FileInfo.nFileSizeLow;
+    FileSize.HighPart = Job->FileInfo.nFileSizeHigh;
+
+    if (FileSize.QuadPart >= MOVE_UNBUFFERED_MINIMUM_SIZE &&
+        (Job->FileInfo.dwFileAttributes & (FILE_ATTRIBUTE_COMPRESSED | FILE_ATTRIBUTE_ENCRYPTED | FILE_ATTRIBUTE_REPARSE_POINT)) == 0 &&
+        MoveCopyFileUnbuffered(&Job->Source, &Job->Dest, &Job->FileInfo, MoveContext->ReplaceExisting, &LastError)) {
+
+        if (LastError == ERROR_SUCCESS) {
+            Job->Copied = TRUE;
+        }
+
+    } else if (Job->DeleteSource) {
+        LastError = YoriLibMoveFile(&Job->Source, &Job->Dest, MoveContext->ReplaceExisting, FALSE);
+    } else {
+        LastError = MoveCopyFileBuffered(MoveContext, Job);
+        if (LastError == ERROR_SUCCESS) {
+            Job->Copied = TRUE;
+        }
+    }
+
+    if (Job->Copied && Job->DeleteSource) {
+        LastError = MoveDeleteFile(&Job->Source);
+    }
+
+    if (LastError != ERROR_SUCCESS) {
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Move of %y to %y failed: %s"), &Job->Source, &Job->Dest, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&MoveContext->FilesFailed);
+    }
+}
+
+/**
+ Move a single queued file to another volume.  Jobs for files that are not
+ part of a tree are freed here; jobs within a tree are freed by the tree.
+
+ @param Pool Pointer to the thread pool, or NULL if the file is being moved
+        on the main thread.
+
+ @param WorkItem Pointer to the work item within the job.
+ */
+VOID
+MoveExecuteJob(
+    __in_opt PYORI_LIB_THREAD_POOL Pool,
+    __in PYORI_LIB_WORK_ITEM WorkItem
+    )
+{
+    PMOVE_JOB Job;
+    PMOVE_CONTEXT MoveContext;
+
+    UNREFERENCED_PARAMETER(Pool);
+
+    Job = CONTAINING_RECORD(WorkItem, MOVE_JOB, WorkItem);
+    MoveContext = Job->MoveContext;
+
+    MoveFileAcrossVolumes(MoveContext, Job);
+
+    if (Job->DeleteSource) {
+        YoriLibFree(Job);
+    }
+
+    if (MoveContext->JobSemaphore != NULL) {
+        ReleaseSemaphore(MoveContext->JobSemaphore, 1, NULL);
+    }
+}
+
+/**
+ Move a file to another volume.  If a thread pool is running, the file is
+ queued to it, waiting for workers to complete some files if too many are
+ already queued.  Otherwise the file is moved immediately.
+
+ @param MoveContext Pointer to the move context.
+
+ @param Source Pointer to the full path to the source file.
+
+ @param Dest Pointer to the full path to the destination file.
+
+ @param FileInfo Information about the source file from enumeration.
+
+ @param TreeFiles If the file is part of a directory tree, points to the
+        list of files in the tree.  The job is added to this list and the
+        source is not deleted.  If NULL, the source is deleted once it has
+        been copied.
+
+ @return TRUE to indicate the file was moved or queued, FALSE to indicate
+         failure.
+ */
+BOOL
+MoveQueueFile(
+    __in PMOVE_CONTEXT MoveContext,
+    __in PYORI_STRING Source,
+    __in PYORI_STRING Dest,
+    __in PWIN32_FIND_DATA FileInfo,
+    __inout_opt PYORI_LIST_ENTRY TreeFiles
+    )
+{
+    PMOVE_JOB Job;
+
+    Job = YoriLibMalloc(sizeof(MOVE_JOB) + (Source->LengthInChars + 1 + Dest->LengthInChars + 1) * sizeof(TCHAR));
+    if (Job == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(Job, sizeof(MOVE_JOB));
+    Job->MoveContext = MoveContext;
+
+    Job->Source.StartOfString = (LPTSTR)(Job + 1);
+    Job->Source.LengthInChars = Source->LengthInChars;
+    Job->Source.LengthAllocated = Source->LengthInChars + 1;
+    memcpy(Job->Source.StartOfString, Source->StartOfString, Source->LengthInChars * sizeof(TCHAR));
+    Job->Source.StartOfString[Source->LengthInChars] = '\0';
+
+    Job->Dest.StartOfString = Job->Source.StartOfString + Job->Source.LengthAllocated;
+    Job->Dest.LengthInChars = Dest->LengthInChars;
+    Job->Dest.LengthAllocated = Dest->LengthInChars + 1;
+    memcpy(Job->Dest.StartOfString, Dest->StartOfString, Dest->LengthInChars * sizeof(TCHAR));
+    Job->Dest.StartOfString[Dest->LengthInChars] = '\0';
+
+    memcpy(&Job->FileInfo, FileInfo, sizeof(WIN32_FIND_DATA));
+
+    if (TreeFiles != NULL) {
+        YoriLibAppendList(TreeFiles, &Job->ListEntry);
+    } else {
+        Job->DeleteSource = TRUE;
+    }
+
+    Job->WorkItem.ExecuteFn = MoveExecuteJob;
+    Job->WorkItem.CompleteFn = NULL;
+
+    if (MoveContext->Pool == NULL) {
+        MoveExecuteJob(NULL, &Job->WorkItem);
+        return TRUE;
+    }
+
+    WaitForSingleObject(MoveContext->JobSemaphore, INFINITE);
+    YoriLibSubmitWorkItem(MoveContext->Pool, &Job->WorkItem);
+    return TRUE;
+}
+
+/**
+ Wait for all queued files to be moved, leaving worker threads running for
+ later files.
+
+ @param MoveContext Pointer to the move context.
+ */
+VOID
+MoveWaitForQueuedFiles(
+    __in PMOVE_CONTEXT MoveContext
+    )
+{
+    if (MoveContext->Pool != NULL) {
+        YoriLibWaitForThreadPool(MoveContext->Pool);
+    }
+}
+
+/**
+ Wait for all queued files to be moved and terminate worker threads.
+
+ @param MoveContext Pointer to the move context.
+ */
+VOID
+MoveStopWorkers(
+    __in PMOVE_CONTEXT MoveContext
+    )
+{
+    if (MoveContext->Pool != NULL) {
+        YoriLibDestroyThreadPool(MoveContext->Pool);
+        MoveContext->Pool = NULL;
+    }
+
+    if (MoveContext->JobSemaphore != NULL) {
+        CloseHandle(MoveContext->JobSemaphore);
+        MoveContext->JobSemaphore = NULL;
+    }
+}
 
 /**
- A context passed between each source file match when moving multiple
- files.
+ Start a pool of worker threads to move files to another volume in
+ parallel.  If the pool cannot be started, files are moved by the main
+ thread.
+
+ @param MoveContext Pointer to the move context.
+
+ @param WorkerCount The number of worker threads to start.
  */
-typedef struct _MOVE_CONTEXT {
+VOID
+MoveStartWorkers(
+    __in PMOVE_CONTEXT MoveContext,
+    __in DWORD WorkerCount
+    )
+{
+    DWORD MaximumJobsQueued;
 
-    /**
-     Path to the destination for the move operation.
-     */
-    YORI_STRING Dest;
+    if (!YoriLibCreateThreadPool(WorkerCount, YoriLibCpuClassAny, &MoveContext->Pool)) {
+        MoveContext->Pool = NULL;
+        return;
+    }
 
-    /**
-     The file system attributes of the destination.  Used to determine if
-     the destination exists and is a directory.
-     */
-    DWORD DestAttributes;
+    MaximumJobsQueued = YoriLibGetThreadPoolThreadCount(MoveContext->Pool) * MOVE_JOBS_PER_WORKER;
+    MoveContext->JobSemaphore = CreateSemaphore(NULL, MaximumJobsQueued, MaximumJobsQueued, NULL);
+    if (MoveContext->JobSemaphore == NULL) {
+        MoveStopWorkers(MoveContext);
+    }
+}
 
-    /**
-     The number of files that have been previously moved.  This can be used
-     to determine if we're about to move a second object over the top of
-     an earlier moved file.
-     */
-    DWORD FilesMoved;
+/**
+ Create a directory in the destination while moving a tree to another
+ volume, and record it so that it can be removed if the move fails.  If the
+ directory already exists, it is used as is and is not recorded.
 
-    /**
-     TRUE if existing files should be replaced, FALSE if they should be kept.
-     */
-    BOOLEAN ReplaceExisting;
+ @param TreeContext Pointer to the tree context.
 
-    /**
-     TRUE if the move should use POSIX semantics, where in use files are
-     removed from the namespace immediately.
-     */
-    BOOLEAN PosixSemantics;
+ @param DirPath Pointer to the full path to the directory to create.
 
-} MOVE_CONTEXT, *PMOVE_CONTEXT;
+ @return ERROR_SUCCESS to indicate the directory exists, or a Win32 error
+         code.
+ */
+DWORD
+MoveCreateTreeDirectory(
+    __in PMOVE_TREE_CONTEXT TreeContext,
+    __in PYORI_STRING DirPath
+    )
+{
+    PMOVE_CREATED_DIRECTORY CreatedDir;
+    DWORD LastError;
+
+    if (!CreateDirectory(DirPath->StartOfString, NULL)) {
+        LastError = GetLastError();
+        if (LastError == ERROR_ALREADY_EXISTS) {
+            return ERROR_SUCCESS;
+        }
+        return LastError;
+    }
+
+    CreatedDir = YoriLibMalloc(sizeof(MOVE_CREATED_DIRECTORY) + (DirPath->LengthInChars + 1) * sizeof(TCHAR));
+    if (CreatedDir == NULL) {
+        return ERROR_SUCCESS;
+    }
+
+    YoriLibInitEmptyString(&CreatedDir->Path);
+    CreatedDir->Path.StartOfString = (LPTSTR)(CreatedDir + 1);
+    CreatedDir->Path.LengthInChars = DirPath->LengthInChars;
+    CreatedDir->Path.LengthAllocated = DirPath->LengthInChars + 1;
+    memcpy(CreatedDir->Path.StartOfString, DirPath->StartOfString, DirPath->LengthInChars * sizeof(TCHAR));
+    CreatedDir->Path.StartOfString[DirPath->LengthInChars] = '\0';
+    YoriLibAppendList(&TreeContext->CreatedDirectories, &CreatedDir->ListEntry);
+
+    return ERROR_SUCCESS;
+}
+
+/**
+ A callback invoked for each object found within a directory tree being
+ moved to another volume.  Directories are returned before their contents,
+ so are created in the destination before any file within them is moved.
+
+ @param FilePath Pointer to the full path to the object.
+
+ @param FileInfo Information about the object.
+
+ @param Depth Recursion depth, ignored in this function.
+
+ @param Context Pointer to the tree context.
+
+ @return TRUE to continue enumerating, FALSE to abort.
+ */
+BOOL
+MoveTreeObjectFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PMOVE_TREE_CONTEXT TreeContext;
+    PMOVE_CONTEXT MoveContext;
+    YORI_STRING RelativePath;
+    YORI_STRING DestPath;
+    DWORD LastError;
+    LPTSTR ErrText;
+    BOOL Result;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    TreeContext = (PMOVE_TREE_CONTEXT)Context;
+    MoveContext = TreeContext->MoveContext;
+
+    if (FilePath->LengthInChars <= TreeContext->SourceRoot->LengthInChars ||
+        YoriLibCompareStringInsCnt(FilePath, TreeContext->SourceRoot, TreeContext->SourceRoot->LengthInChars) != 0) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Unexpected path found within %y: %y\n"), TreeContext->SourceRoot, FilePath);
+        InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&MoveContext->FilesFailed);
+        return TRUE;
+    }
+
+    YoriLibInitEmptyString(&RelativePath);
+    RelativePath.StartOfString = FilePath->StartOfString + TreeContext->SourceRoot->LengthInChars;
+    RelativePath.LengthInChars = FilePath->LengthInChars - TreeContext->SourceRoot->LengthInChars;
+
+    if (!YoriLibAllocateString(&DestPath, TreeContext->DestRoot->LengthInChars + RelativePath.LengthInChars + 1)) {
+        InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&MoveContext->FilesFailed);
+        return FALSE;
+    }
+    DestPath.LengthInChars = YoriLibSPrintf(DestPath.StartOfString, _T("%y%y"), TreeContext->DestRoot, &RelativePath);
+
+    Result = TRUE;
+    if (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+
+        //
+        //  Links to directories are not traversed, and can't be recreated
+        //  on another volume, so they are left in the source.
+        //
+
+        if (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Cannot move link to another volume: %y\n"), FilePath);
+            InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&MoveContext->FilesFailed);
+        } else {
+            LastError = MoveCreateTreeDirectory(TreeContext, &DestPath);
+            if (LastError != ERROR_SUCCESS) {
+                ErrText = YoriLibGetWinErrorText(LastError);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("CreateDirectory failed: %y: %s"), &DestPath, ErrText);
+                YoriLibFreeWinErrorText(ErrText);
+                InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&MoveContext->FilesFailed);
+            }
+        }
+    } else {
+        Result = MoveQueueFile(MoveContext, FilePath, &DestPath, FileInfo, &TreeContext->Files);
+        if (!Result) {
+            InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&MoveContext->FilesFailed);
+        }
+    }
+
+    YoriLibFreeStringContents(&DestPath);
+    return Result;
+}
+
+/**
+ A callback invoked when a directory within a tree being moved to another
+ volume cannot be enumerated.  Since the files within it cannot be moved,
+ this is treated as a failure to move the tree.
+
+ @param FilePath Pointer to the path that could not be enumerated.
+
+ @param ErrorCode The Win32 error code describing the failure.
+
+ @param Depth Recursion depth.
+
+ @param Context Pointer to the tree context.
+
+ @return TRUE to continue enumerating, FALSE to abort.
+ */
+BOOL
+MoveTreeEnumerateErrorCallback(
+    __in PYORI_STRING FilePath,
+    __in DWORD ErrorCode,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PMOVE_TREE_CONTEXT TreeContext;
+
+    //
+    //  An empty directory on some file systems reports no objects found.
+    //
+
+    if (ErrorCode == ERROR_FILE_NOT_FOUND) {
+        return TRUE;
+    }
+
+    TreeContext = (PMOVE_TREE_CONTEXT)Context;
+    InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&TreeContext->MoveContext->FilesFailed);
+    return MoveFileEnumerateErrorCallback(FilePath, ErrorCode, Depth, NULL);
+}
+
+/**
+ A callback invoked for each directory within a source tree once all of its
+ files have been moved to another volume and deleted.  Directories are returned after
+ their contents, so each is empty by the time it is removed.
+
+ @param FilePath Pointer to the full path to the directory.
+
+ @param FileInfo Information about the directory.
+
+ @param Depth Recursion depth, ignored in this function.
+
+ @param Context Ignored in this function.
+
+ @return TRUE to continue enumerating.
+ */
+BOOL
+MoveTreeRemoveSourceCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    UNREFERENCED_PARAMETER(Depth);
+    UNREFERENCED_PARAMETER(Context);
+
+    if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0) {
+        RemoveDirectory(FilePath->StartOfString);
+    }
+
+    return TRUE;
+}
+
+/**
+ Move a directory tree to another volume.  Directories are created in the
+ destination and each file is copied individually, with the source left in
+ place.  If every file was copied, the source files are deleted and the
+ source directories are removed.  If any file could not be copied, the
+ source tree is left intact, and the files copied and directories created
+ in the destination are removed.
+
+ @param MoveContext Pointer to the move context.
+
+ @param SourceRoot Pointer to the full path to the source directory.
+
+ @param DestRoot Pointer to the full path to the destination directory.
+ */
+VOID
+MoveDirectoryAcrossVolumes(
+    __in PMOVE_CONTEXT MoveContext,
+    __in PYORI_STRING SourceRoot,
+    __in PYORI_STRING DestRoot
+    )
+{
+    MOVE_TREE_CONTEXT TreeContext;
+    PMOVE_CREATED_DIRECTORY CreatedDir;
+    PMOVE_JOB Job;
+    PYORI_LIST_ENTRY ListEntry;
+    YORI_STRING SearchPath;
+    DWORD FilesFailedBefore;
+    DWORD LastError;
+    LPTSTR ErrText;
+    WORD MatchFlags;
+    BOOLEAN Rollback;
+
+    TreeContext.MoveContext = MoveContext;
+    TreeContext.SourceRoot = SourceRoot;
+    TreeContext.DestRoot = DestRoot;
+    YoriLibInitializeListHead(&TreeContext.CreatedDirectories);
+    YoriLibInitializeListHead(&TreeContext.Files);
+
+    //
+    //  Files queued before this tree may still be failing, so wait for them
+    //  before counting failures within the tree.
+    //
+
+    MoveWaitForQueuedFiles(MoveContext);
+    FilesFailedBefore = MoveContext->FilesFailed;
+
+    LastError = MoveCreateTreeDirectory(&TreeContext, DestRoot);
+    if (LastError != ERROR_SUCCESS) {
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("CreateDirectory failed: %y: %s"), DestRoot, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&MoveContext->FilesFailed);
+        return;
+    }
+
+    Rollback = TRUE;
+    if (!YoriLibAllocateString(&SearchPath, SourceRoot->LengthInChars + sizeof("\\*"))) {
+        InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&MoveContext->FilesFailed);
+    } else {
+        SearchPath.LengthInChars = YoriLibSPrintf(SearchPath.StartOfString, _T("%y\\*"), SourceRoot);
+
+        MatchFlags = YORILIB_FILEENUM_RETURN_FILES |
+                     YORILIB_FILEENUM_RETURN_DIRECTORIES |
+                     YORILIB_FILEENUM_RECURSE_AFTER_RETURN |
+                     YORILIB_FILEENUM_NO_LINK_TRAVERSE |
+                     YORILIB_FILEENUM_BASIC_EXPANSION |
+                     YORILIB_FILEENUM_BASIC_INFO;
+
+        YoriLibForEachFile(&SearchPath, MatchFlags, 0, MoveTreeObjectFoundCallback, MoveTreeEnumerateErrorCallback, &TreeContext);
+
+        //
+        //  Source files can only be deleted once every file in the tree
+        //  has been copied.
+        //
+
+        MoveWaitForQueuedFiles(MoveContext);
+
+        if (MoveContext->FilesFailed == FilesFailedBefore) {
+            Rollback = FALSE;
+
+            //
+            //  Every file has a copy in the destination, so a source file
+            //  that cannot be deleted is reported but nothing is undone.
+            //
+
+            ListEntry = YoriLibGetNextListEntry(&TreeContext.Files, NULL);
+            while (ListEntry != NULL) {
+                Job = CONTAINING_RECORD(ListEntry, MOVE_JOB, ListEntry);
+                ListEntry = YoriLibGetNextListEntry(&TreeContext.Files, ListEntry);
+                LastError = MoveDeleteFile(&Job->Source);
+                if (LastError != ERROR_SUCCESS) {
+                    ErrText = YoriLibGetWinErrorText(LastError);
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Delete of %y failed: %s"), &Job->Source, ErrText);
+                    YoriLibFreeWinErrorText(ErrText);
+                    InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&MoveContext->FilesFailed);
+                }
+            }
+
+            MatchFlags = YORILIB_FILEENUM_RETURN_DIRECTORIES |
+                         YORILIB_FILEENUM_RECURSE_BEFORE_RETURN |
+                         YORILIB_FILEENUM_NO_LINK_TRAVERSE |
+                         YORILIB_FILEENUM_BASIC_EXPANSION |
+                         YORILIB_FILEENUM_BASIC_INFO;
+
+            YoriLibForEachFile(&SearchPath, MatchFlags, 0, MoveTreeRemoveSourceCallback, MoveTreeEnumerateErrorCallback, &TreeContext);
+            if (!RemoveDirectory(SourceRoot->StartOfString)) {
+                LastError = GetLastError();
+                ErrText = YoriLibGetWinErrorText(LastError);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("RemoveDirectory failed: %y: %s"), SourceRoot, ErrText);
+                YoriLibFreeWinErrorText(ErrText);
+            }
+        }
+
+        YoriLibFreeStringContents(&SearchPath);
+    }
+
+    //
+    //  If anything failed, the source is intact, so remove the files that
+    //  were copied and then the directories that were created, deepest
+    //  first.  Directories that already contained files remain.
+    //
+
+    ListEntry = YoriLibGetNextListEntry(&TreeContext.Files, NULL);
+    while (ListEntry != NULL) {
+        Job = CONTAINING_RECORD(ListEntry, MOVE_JOB, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&TreeContext.Files, ListEntry);
+        if (Rollback && Job->Copied) {
+            MoveDeleteFile(&Job->Dest);
+        }
+        YoriLibRemoveListItem(&Job->ListEntry);
+        YoriLibFree(Job);
+    }
+
+    ListEntry = YoriLibGetPreviousListEntry(&TreeContext.CreatedDirectories, NULL);
+    while (ListEntry != NULL) {
+        CreatedDir = CONTAINING_RECORD(ListEntry, MOVE_CREATED_DIRECTORY, ListEntry);
+        ListEntry = YoriLibGetPreviousListEntry(&TreeContext.CreatedDirectories, ListEntry);
+        if (Rollback) {
+            RemoveDirectory(CreatedDir->Path.StartOfString);
+        }
+        YoriLibRemoveListItem(&CreatedDir->ListEntry);
+        YoriLibFree(CreatedDir);
+    }
+}
 
 /**
  A callback that is invoked when a file is found that matches a search criteria
@@ -176,6 +1320,27 @@ MoveFileFoundCallback(
         }
     }
 
+    //
+    //  Objects on another volume are copied and deleted here, which allows
+    //  directories to be moved and files to be moved in parallel.  Links
+    //  to directories are left to MoveFileEx, which fails to move them.
+    //
+
+    if (MoveIsCrossVolume(MoveContext, FilePath)) {
+        if ((FileInfo->dwFileAttributes & (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_REPARSE_POINT)) == FILE_ATTRIBUTE_DIRECTORY) {
+            MoveDirectoryAcrossVolumes(MoveContext, FilePath, &FullDest);
+            MoveContext->FilesMoved++;
+            YoriLibDereference(FullDest.StartOfString);
+            return TRUE;
+        } else if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+            if (MoveQueueFile(MoveContext, FilePath, &FullDest, FileInfo, NULL)) {
+                MoveContext->FilesMoved++;
+            }
+            YoriLibDereference(FullDest.StartOfString);
+            return TRUE;
+        }
+    }
+
     LastError = YoriLibMoveFile(FilePath, &FullDest, MoveContext->ReplaceExisting, MoveContext->PosixSemantics);
     if (LastError != ERROR_SUCCESS) {
         LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
@@ -189,61 +1354,6 @@ MoveFileFoundCallback(
     return TRUE;
 }
 
-/**
- A callback that is invoked when a directory cannot be successfully enumerated.
-
- @param FilePath Pointer to the file path that could not be enumerated.
-
- @param ErrorCode The Win32 error code describing the failure.
-
- @param Depth Recursion depth, ignored in this application.
-
- @param Context Ignored.
-
- @return TRUE to continute enumerating, FALSE to abort.
- */
-BOOL
-MoveFileEnumerateErrorCallback(
-    __in PYORI_STRING FilePath,
-    __in DWORD ErrorCode,
-    __in DWORD Depth,
-    __in PVOID Context
-    )
-{
-    YORI_STRING UnescapedFilePath;
-    BOOL Result = FALSE;
-
-    UNREFERENCED_PARAMETER(Depth);
-    UNREFERENCED_PARAMETER(Context);
-
-    YoriLibInitEmptyString(&UnescapedFilePath);
-    if (!YoriLibUnescapePath(FilePath, &UnescapedFilePath)) {
-        UnescapedFilePath.StartOfString = FilePath->StartOfString;
-        UnescapedFilePath.LengthInChars = FilePath->LengthInChars;
-    }
-
-    if (ErrorCode == ERROR_FILE_NOT_FOUND || ErrorCode == ERROR_PATH_NOT_FOUND) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("File or directory not found: %y\n"), &UnescapedFilePath);
-        Result = TRUE;
-    } else {
-        LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
-        YORI_STRING DirName;
-        LPTSTR FilePart;
-        YoriLibInitEmptyString(&DirName);
-        DirName.StartOfString = UnescapedFilePath.StartOfString;
-        FilePart = YoriLibFindRightMostCharacter(&UnescapedFilePath, '\\');
-        if (FilePart != NULL) {
-            DirName.LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - DirName.StartOfString);
-        } else {
-            DirName.LengthInChars = UnescapedFilePath.LengthInChars;
-        }
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Enumerate of %y failed: %s"), &DirName, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-    }
-    YoriLibFreeStringContents(&UnescapedFilePath);
-    return Result;
-}
-
 
 #ifdef YORI_BUILTIN
 /**
@@ -282,10 +1392,16 @@ ENTRYPOINT(
     BOOLEAN AllocatedDest;
     BOOLEAN BasicEnumeration;
     YORI_STRING Arg;
+    YORI_STRING FullDestPath;
+    YORI_MAX_SIGNED_T llTemp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    DWORD WorkerCount;
 
     FileCount = 0;
+    WorkerCount = 0;
     AllocatedDest = FALSE;
     BasicEnumeration = FALSE;
+    ZeroMemory(&MoveContext, sizeof(MoveContext));
     MoveContext.ReplaceExisting = TRUE;
     MoveContext.PosixSemantics = FALSE;
 
@@ -305,6 +1421,20 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (i + 1 < ArgC) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], FALSE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        llTemp > 0) {
+
+                        WorkerCount = MOVE_MAX_WORKERS;
+                        if (llTemp < MOVE_MAX_WORKERS) {
+                            WorkerCount = (DWORD)llTemp;
+                        }
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("k")) == 0) {
                 MoveContext.ReplaceExisting = FALSE;
                 ArgumentUnderstood = TRUE;
@@ -348,8 +1478,20 @@ ENTRYPOINT(
     MoveContext.FilesMoved = 0;
     FilesProcessed = 0;
 
+    YoriLibInitEmptyString(&FullDestPath);
+    if (YoriLibGetFullPathNameAlloc(&MoveContext.Dest, TRUE, &FullDestPath, NULL)) {
+        if (!YoriLibGetVolumePathName(&FullDestPath, &MoveContext.DestVolume)) {
+            YoriLibInitEmptyString(&MoveContext.DestVolume);
+        }
+        YoriLibFreeStringContents(&FullDestPath);
+    }
+
     YoriLibLoadAdvApi32Functions();
 
+    if (WorkerCount > 1) {
+        MoveStartWorkers(&MoveContext, WorkerCount);
+    }
+
     for (i = 1; i < ArgC; i++) {
         if (!YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
             MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES;
@@ -369,11 +1511,14 @@ ENTRYPOINT(
         }
     }
 
+    MoveStopWorkers(&MoveContext);
+
     if (AllocatedDest) {
         YoriLibFreeStringContents(&MoveContext.Dest);
     }
+    YoriLibFreeStringContents(&MoveContext.DestVolume);
 
-    if (MoveContext.FilesMoved == 0) {
+    if (MoveContext.FilesMoved == 0 || MoveContext.FilesFailed > 0) {
         return EXIT_FAILURE;
     }
 
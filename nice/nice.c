@@ -3,7 +3,7 @@
  *
  * Yori shell child process priority tool
  *
- * Copyright (c) 2017-2018 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -38,7 +38,15 @@ CHAR strNiceHelpText[] =
         "\n"
         "Runs a child program at low priority.\n"
         "\n"
-        "NICE [-license] <command>\n";
+        "NICE [-license] [-a <mask>|-e] [-b] [-g <group>] [-q] <command>\n"
+        "\n"
+        "   -a             Restrict the process tree to processors in a mask\n"
+        "   -b             Use background I/O and memory priority\n"
+        "   -e             Restrict the process tree to efficiency processors\n"
+        "   -g             Run the process tree in a processor group\n"
+        "   -q             Allow the program to run slower to save power\n"
+        "\n"
+        "Options other than -license require the standalone nice program.\n";
 
 /**
  Display usage text to the user.
@@ -88,6 +96,19 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T StartArg = 1;
     YORI_ALLOC_SIZE_T i;
     YORI_STRING Arg;
+    YORI_PROCESSOR_GROUP_AFFINITY Affinity;
+    YORI_MAX_SIGNED_T llTemp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    BOOLEAN AffinitySpecified;
+    BOOLEAN EfficiencyProcessors;
+    BOOLEAN BackgroundPriority;
+    BOOLEAN PowerThrottling;
+
+    ZeroMemory(&Affinity, sizeof(Affinity));
+    AffinitySpecified = FALSE;
+    EfficiencyProcessors = FALSE;
+    BackgroundPriority = FALSE;
+    PowerThrottling = FALSE;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -100,8 +121,40 @@ ENTRYPOINT(
                 NiceHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2017-2018"));
+                YoriLibDisplayMitLicense(_T("2017-2026"));
                 return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("a")) == 0) {
+                if (ArgC > i + 1 &&
+                    YoriLibStringToNumber(&ArgV[i + 1], FALSE, &llTemp, &CharsConsumed) &&
+                    CharsConsumed > 0 &&
+                    llTemp != 0) {
+
+                    Affinity.Mask = (DWORD_PTR)llTemp;
+                    AffinitySpecified = TRUE;
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
+                BackgroundPriority = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("e")) == 0) {
+                EfficiencyProcessors = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("g")) == 0) {
+                if (ArgC > i + 1 &&
+                    YoriLibStringToNumber(&ArgV[i + 1], FALSE, &llTemp, &CharsConsumed) &&
+                    CharsConsumed > 0 &&
+                    llTemp >= 0 &&
+                    llTemp <= 0xFFFF) {
+
+                    Affinity.Group = (WORD)llTemp;
+                    AffinitySpecified = TRUE;
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("q")) == 0) {
+                PowerThrottling = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 StartArg = i + 1;
                 ArgumentUnderstood = TRUE;
@@ -123,9 +176,25 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
+    if (EfficiencyProcessors && AffinitySpecified) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("nice: -e cannot be combined with -a or -g\n"));
+        return EXIT_FAILURE;
+    }
 
 #ifdef YORI_BUILTIN
 
+    //
+    //  The builtin runs the command within the shell, so it can only
+    //  adjust the priority of the shell temporarily.  The remaining
+    //  settings are applied to a job and a new process tree, which the
+    //  shell cannot do to itself.
+    //
+
+    if (EfficiencyProcessors || AffinitySpecified || BackgroundPriority || PowerThrottling) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("nice: scheduling options require the standalone nice program\n"));
+        return EXIT_FAILURE;
+    }
+
     {
         DWORD OldPriority;
 
@@ -148,8 +217,24 @@ ENTRYPOINT(
         PYORI_STRING ChildArgs;
         PROCESS_INFORMATION ProcessInfo;
         STARTUPINFO StartupInfo;
+        PYORI_LIB_CPU_TOPOLOGY Topology;
         HANDLE hJob;
 
+        if (EfficiencyProcessors) {
+            if (!YoriLibQueryCpuTopology(&Topology)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("nice: unable to query processor topology\n"));
+                return EXIT_FAILURE;
+            }
+
+            if (!YoriLibGetCpuClassAffinity(Topology, YoriLibCpuClassEfficiency, &Affinity)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("nice: no efficiency processors found\n"));
+                YoriLibFree(Topology);
+                return EXIT_FAILURE;
+            }
+            YoriLibFree(Topology);
+            AffinitySpecified = TRUE;
+        }
+
         ChildArgs = YoriLibMalloc((YORI_ALLOC_SIZE_T)((ArgC - StartArg) * sizeof(YORI_STRING)));
         if (ChildArgs == NULL) {
             return EXIT_FAILURE;
@@ -195,11 +280,33 @@ ENTRYPOINT(
             return EXIT_FAILURE;
         }
 
+        //
+        //  Processor restrictions are applied to the job before the process
+        //  is assigned to it, so that the process is placed in the requested
+        //  group as it joins.  Because they belong to the job, they also
+        //  apply to any processes that the child launches.  I/O and memory
+        //  priority are inherited by those processes without a job.
+        //
+
+        if (AffinitySpecified &&
+            (hJob == NULL || !YoriLibLimitJobObjectAffinity(hJob, &Affinity))) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("nice: unable to restrict processors\n"));
+        }
+
         if (hJob != NULL) {
             YoriLibAssignProcessToJobObject(hJob, ProcessInfo.hProcess);
             YoriLibLimitJobObjectPriority(hJob, IDLE_PRIORITY_CLASS);
         }
 
+        if (BackgroundPriority && !YoriLibSetProcessBackgroundPriority(ProcessInfo.hProcess)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("nice: unable to set background priority\n"));
+        }
+
+        if (PowerThrottling && !YoriLibSetProcessPowerThrottling(ProcessInfo.hProcess)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("nice: unable to enable power throttling\n"));
+        }
+
         ResumeThread(ProcessInfo.hThread);
         WaitForSingleObject(ProcessInfo.hProcess, INFINITE);
         GetExitCodeProcess(ProcessInfo.hProcess, &ExitCode);
@@ -3,7 +3,7 @@
  *
  * Yori shell PE tool for manipulating PE files
  *
- * Copyright (c) 2021-2022 Malcolm J. Smith
+ * Copyright (c) 2021-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -36,13 +36,16 @@ CHAR strPeToolHelpText[] =
         "Manage PE files.\n"
         "\n"
         "PETOOL [-license]\n"
-        "PETOOL -c file\n"
-        "PETOOL -cu file\n"
-        "PETOOL -os file version\n"
+        "PETOOL -c <file> [<file>...]\n"
+        "PETOOL -cu <file> [<file>...]\n"
+        "PETOOL -os <file> <version> [<file>...]\n"
         "\n"
-        "   -c             Calculate the PE checksum for a binary\n"
+        "   -c             Calculate the PE checksum for binaries\n"
         "   -cu            Update the checksum in the PE header from contents\n"
-        "   -os            Set the minimum OS version and update checksum\n";
+        "   -os            Set the minimum OS version and update checksum\n"
+        "\n"
+        "When more than one file is specified, or a wildcard is used, files are\n"
+        "processed in parallel and each result is preceded by its file name.\n";
 
 /**
  Display usage text to the user.
@@ -148,80 +151,6 @@ PeToolVersionRange[] = {
     {IMAGE_FILE_MACHINE_ARM64,    10,  0,  10,  0}
 };
 
-/**
- Write a new checksum to a PE header in a file.
-
- @param FullPath Pointer to the executable file name.
-
- @param Checksum The new checksum to apply to the PE header.
-
- @return Win32 error code, including ERROR_SUCCESS to indicate success.
- */
-DWORD
-PeToolWriteChecksumToFile(
-    __in PYORI_STRING FullPath,
-    __in DWORD Checksum
-    )
-{
-    DWORD PeHeaderOffset;
-    HANDLE hFileRead;
-    union {
-        IMAGE_DOS_HEADER DosHeader;
-        YORILIB_PE_HEADERS PeHeaders;
-    } u;
-    DWORD BytesReturned;
-    DWORD Err;
-
-    //
-    //  We want the earlier handle to be attribute only so we can
-    //  operate on directories, but we need data for this, so we
-    //  end up with two handles.
-    //
-
-    hFileRead = CreateFile(FullPath->StartOfString,
-                           FILE_READ_ATTRIBUTES|FILE_READ_DATA|FILE_WRITE_DATA,
-                           FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                           NULL,
-                           OPEN_EXISTING,
-                           FILE_FLAG_BACKUP_SEMANTICS,
-                           NULL);
-
-    if (hFileRead == INVALID_HANDLE_VALUE) {
-        Err = GetLastError();
-        return Err;
-    }
-
-    if (ReadFile(hFileRead, &u.DosHeader, sizeof(u.DosHeader), &BytesReturned, NULL) &&
-        BytesReturned == sizeof(u.DosHeader) &&
-        u.DosHeader.e_magic == IMAGE_DOS_SIGNATURE &&
-        u.DosHeader.e_lfanew != 0) {
-
-        PeHeaderOffset = u.DosHeader.e_lfanew;
-        SetFilePointer(hFileRead, PeHeaderOffset, NULL, FILE_BEGIN);
-
-        if (ReadFile(hFileRead, &u.PeHeaders, sizeof(YORILIB_PE_HEADERS), &BytesReturned, NULL) &&
-            BytesReturned == sizeof(YORILIB_PE_HEADERS) &&
-            u.PeHeaders.Signature == IMAGE_NT_SIGNATURE &&
-            u.PeHeaders.ImageHeader.SizeOfOptionalHeader >= FIELD_OFFSET(IMAGE_OPTIONAL_HEADER, CheckSum) + sizeof(u.PeHeaders.OptionalHeader.CheckSum)) {
-
-            u.PeHeaders.OptionalHeader.CheckSum = Checksum;
-            SetFilePointer(hFileRead, PeHeaderOffset, NULL, FILE_BEGIN);
-
-            if (!WriteFile(hFileRead, &u.PeHeaders, sizeof(YORILIB_PE_HEADERS), &BytesReturned, NULL)) {
-                Err = GetLastError();
-                CloseHandle(hFileRead);
-                return Err;
-            }
-
-            CloseHandle(hFileRead);
-            return ERROR_SUCCESS;
-        }
-    }
-
-    CloseHandle(hFileRead);
-    return ERROR_BAD_EXE_FORMAT;
-}
-
 /**
  Check if the specified version is valid for a specified architecture.
  This includes checking if the specified version is a valid version, and if
@@ -290,289 +219,545 @@ PeToolIsVersionValidForArchitecture(
 }
 
 /**
- Check if a specified version is applicable to an executable file, and if so,
- update the minimum OS version in the header with the specified values.
+ The size of each view that is mapped while calculating a checksum.  This
+ must be a multiple of the allocation granularity.  The first view contains
+ the headers and remains mapped until the checksum is known so that it can
+ be updated.
+ */
+#define PETOOL_VIEW_SIZE (16 * 1024 * 1024)
+
+/**
+ A set of operations supported by this application.
+ */
+typedef enum _PETOOL_OP {
+    PeToolOpNone = 0,
+    PeToolOpCalculateChecksum = 1,
+    PeToolOpUpdateChecksum = 2,
+    PeToolOpUpdateSubsystemVersion = 3,
+} PETOOL_OP;
+
+/**
+ Context describing the operation to perform on each file.
+ */
+typedef struct _PETOOL_CONTEXT {
+
+    /**
+     The operation to perform.
+     */
+    PETOOL_OP Op;
+
+    /**
+     The new minimum OS major version, if the operation is to update the
+     subsystem version.
+     */
+    WORD MajorVersion;
+
+    /**
+     The new minimum OS minor version, if the operation is to update the
+     subsystem version.
+     */
+    WORD MinorVersion;
+
+    /**
+     TRUE if the name of each file should be displayed along with its
+     result.  This is used when more than one file can be processed.
+     */
+    BOOLEAN DisplayNames;
+
+    /**
+     Set to TRUE if any file could not be processed.
+     */
+    BOOLEAN Failed;
+
+    /**
+     Optionally points to a thread pool used to process files in parallel.
+     If NULL, each file is processed as it is found.
+     */
+    PYORI_LIB_THREAD_POOL Pool;
+
+    /**
+     The number of files found for the current argument.
+     */
+    DWORD FilesFoundThisArg;
+
+    /**
+     An error encountered while enumerating the current argument that
+     should be reported if no files are found.
+     */
+    DWORD SavedErrorThisArg;
+
+} PETOOL_CONTEXT, *PPETOOL_CONTEXT;
+
+/**
+ A single file to process.
+ */
+typedef struct _PETOOL_FILE {
+
+    /**
+     The work item used to process the file on a thread pool.
+     */
+    YORI_LIB_WORK_ITEM WorkItem;
+
+    /**
+     Pointer to the context describing the operation.
+     */
+    PPETOOL_CONTEXT Context;
+
+    /**
+     The full path to the file.
+     */
+    YORI_STRING FullPath;
+
+    /**
+     The result of processing the file.
+     */
+    DWORD Err;
+
+    /**
+     The checksum that was in the PE header before processing the file.
+     */
+    DWORD HeaderChecksum;
+
+    /**
+     The checksum calculated from the file contents.
+     */
+    DWORD DataChecksum;
+
+} PETOOL_FILE, *PPETOOL_FILE;
+
+/**
+ Calculate the checksum of a PE file by mapping it in views, and optionally
+ update the subsystem version and checksum in the header.  The header is
+ modified through the first view, which is summed last after any updates
+ are applied, so the file is traversed once.
 
  @param FullPath Pointer to the executable file name.
 
- @param MajorVersion Specifies the new minimum major version.
+ @param Op The operation to perform.
 
- @param MinorVersion Specifies the new minimum minor version.
+ @param MajorVersion If Op is PeToolOpUpdateSubsystemVersion, the new
+        minimum major version.
+
+ @param MinorVersion If Op is PeToolOpUpdateSubsystemVersion, the new
+        minimum minor version.
+
+ @param HeaderChecksum On successful completion, updated to contain the
+        checksum in the PE header before any update.
+
+ @param DataChecksum On successful completion, updated to contain the
+        checksum of the file contents.
 
  @return Win32 error code, including ERROR_SUCCESS to indicate success.
  */
 DWORD
-PeToolWriteSubsystemVersionToFile(
+PeToolProcessFile(
     __in PYORI_STRING FullPath,
+    __in PETOOL_OP Op,
     __in WORD MajorVersion,
-    __in WORD MinorVersion
+    __in WORD MinorVersion,
+    __out PDWORD HeaderChecksum,
+    __out PDWORD DataChecksum
     )
 {
-    DWORD PeHeaderOffset;
-    HANDLE hFileRead;
-    union {
-        IMAGE_DOS_HEADER DosHeader;
-        YORILIB_PE_HEADERS PeHeaders;
-    } u;
-    DWORD BytesReturned;
+    HANDLE hFile;
+    HANDLE hMapping;
+    PUCHAR HeaderView;
+    PUCHAR View;
+    PIMAGE_DOS_HEADER DosHeader;
+    PYORILIB_PE_HEADERS PeHeaders;
+    DWORD FileSize;
+    DWORD FileSizeHigh;
+    DWORD HeaderViewSize;
+    DWORD ViewSize;
+    DWORD Offset;
+    DWORD Sum;
+    DWORD Adjust;
+    DWORD OriginalChecksum;
     DWORD Err;
+    BOOLEAN Writable;
+
+    Writable = FALSE;
+    if (Op == PeToolOpUpdateChecksum || Op == PeToolOpUpdateSubsystemVersion) {
+        Writable = TRUE;
+    }
+
+    hFile = CreateFile(FullPath->StartOfString,
+                       Writable?(FILE_READ_DATA|FILE_WRITE_DATA):FILE_READ_DATA,
+                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_SEQUENTIAL_SCAN,
+                       NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return GetLastError();
+    }
 
     //
-    //  We want the earlier handle to be attribute only so we can
-    //  operate on directories, but we need data for this, so we
-    //  end up with two handles.
+    //  A PE file cannot exceed 4Gb, and must be large enough to contain a
+    //  DOS header.
     //
 
-    hFileRead = CreateFile(FullPath->StartOfString,
-                           FILE_READ_ATTRIBUTES|FILE_READ_DATA|FILE_WRITE_DATA,
-                           FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                           NULL,
-                           OPEN_EXISTING,
-                           FILE_FLAG_BACKUP_SEMANTICS,
-                           NULL);
+    FileSize = GetFileSize(hFile, &FileSizeHigh);
+    if (FileSize == INVALID_FILE_SIZE) {
+        Err = GetLastError();
+        if (Err != ERROR_SUCCESS) {
+            CloseHandle(hFile);
+            return Err;
+        }
+    }
+
+    if (FileSizeHigh != 0 || FileSize < sizeof(IMAGE_DOS_HEADER)) {
+        CloseHandle(hFile);
+        return ERROR_BAD_EXE_FORMAT;
+    }
 
-    if (hFileRead == INVALID_HANDLE_VALUE) {
+    hMapping = CreateFileMapping(hFile, NULL, Writable?PAGE_READWRITE:PAGE_READONLY, 0, 0, NULL);
+    if (hMapping == NULL) {
         Err = GetLastError();
+        CloseHandle(hFile);
         return Err;
     }
 
-    if (ReadFile(hFileRead, &u.DosHeader, sizeof(u.DosHeader), &BytesReturned, NULL) &&
-        BytesReturned == sizeof(u.DosHeader) &&
-        u.DosHeader.e_magic == IMAGE_DOS_SIGNATURE &&
-        u.DosHeader.e_lfanew != 0) {
+    HeaderViewSize = FileSize;
+    if (HeaderViewSize > PETOOL_VIEW_SIZE) {
+        HeaderViewSize = PETOOL_VIEW_SIZE;
+    }
 
-        PeHeaderOffset = u.DosHeader.e_lfanew;
-        SetFilePointer(hFileRead, PeHeaderOffset, NULL, FILE_BEGIN);
+    HeaderView = MapViewOfFile(hMapping, Writable?FILE_MAP_WRITE:FILE_MAP_READ, 0, 0, HeaderViewSize);
+    if (HeaderView == NULL) {
+        Err = GetLastError();
+        CloseHandle(hMapping);
+        CloseHandle(hFile);
+        return Err;
+    }
 
-        if (ReadFile(hFileRead, &u.PeHeaders, sizeof(YORILIB_PE_HEADERS), &BytesReturned, NULL) &&
-            BytesReturned == sizeof(YORILIB_PE_HEADERS) &&
-            u.PeHeaders.Signature == IMAGE_NT_SIGNATURE &&
-            u.PeHeaders.ImageHeader.SizeOfOptionalHeader >= FIELD_OFFSET(IMAGE_OPTIONAL_HEADER, CheckSum) + sizeof(u.PeHeaders.OptionalHeader.CheckSum)) {
+    Err = ERROR_BAD_EXE_FORMAT;
+    DosHeader = (PIMAGE_DOS_HEADER)HeaderView;
+    if (DosHeader->e_magic != IMAGE_DOS_SIGNATURE ||
+        DosHeader->e_lfanew <= 0 ||
+        HeaderViewSize < sizeof(YORILIB_PE_HEADERS) ||
+        (DWORD)DosHeader->e_lfanew > HeaderViewSize - sizeof(YORILIB_PE_HEADERS)) {
 
-            if (!PeToolIsVersionValidForArchitecture(u.PeHeaders.ImageHeader.Machine, MajorVersion, MinorVersion)) {
-                CloseHandle(hFileRead);
-                return ERROR_OLD_WIN_VERSION;
-            }
+        goto Exit;
+    }
 
-            u.PeHeaders.OptionalHeader.MajorSubsystemVersion = MajorVersion;
-            u.PeHeaders.OptionalHeader.MinorSubsystemVersion = MinorVersion;
-            SetFilePointer(hFileRead, PeHeaderOffset, NULL, FILE_BEGIN);
+    PeHeaders = (PYORILIB_PE_HEADERS)(HeaderView + DosHeader->e_lfanew);
+    if (PeHeaders->Signature != IMAGE_NT_SIGNATURE ||
+        PeHeaders->ImageHeader.SizeOfOptionalHeader < FIELD_OFFSET(IMAGE_OPTIONAL_HEADER, CheckSum) + sizeof(PeHeaders->OptionalHeader.CheckSum)) {
 
-            if (!WriteFile(hFileRead, &u.PeHeaders, sizeof(YORILIB_PE_HEADERS), &BytesReturned, NULL)) {
-                Err = GetLastError();
-                CloseHandle(hFileRead);
-                return Err;
-            }
+        goto Exit;
+    }
+
+    if (Op == PeToolOpUpdateSubsystemVersion) {
+        if (!PeToolIsVersionValidForArchitecture(PeHeaders->ImageHeader.Machine, MajorVersion, MinorVersion)) {
+            Err = ERROR_OLD_WIN_VERSION;
+            goto Exit;
+        }
+
+        PeHeaders->OptionalHeader.MajorSubsystemVersion = MajorVersion;
+        PeHeaders->OptionalHeader.MinorSubsystemVersion = MinorVersion;
+    }
+
+    //
+    //  Sum the remainder of the file one view at a time, then the header
+    //  view.  Since each view is a multiple of the allocation granularity,
+    //  every view other than the last contains an even number of bytes and
+    //  the order of the views does not change the sum.
+    //
+
+    Sum = 0;
+    for (Offset = HeaderViewSize; Offset < FileSize; Offset += ViewSize) {
+        ViewSize = FileSize - Offset;
+        if (ViewSize > PETOOL_VIEW_SIZE) {
+            ViewSize = PETOOL_VIEW_SIZE;
+        }
 
-            CloseHandle(hFileRead);
-            return ERROR_SUCCESS;
+        View = MapViewOfFile(hMapping, FILE_MAP_READ, 0, Offset, ViewSize);
+        if (View == NULL) {
+            Err = GetLastError();
+            goto Exit;
         }
+
+        Sum = YoriLibPeChecksumUpdate(Sum, View, ViewSize);
+        UnmapViewOfFile(View);
     }
 
-    CloseHandle(hFileRead);
-    return ERROR_BAD_EXE_FORMAT;
+    Sum = YoriLibPeChecksumUpdate(Sum, HeaderView, HeaderViewSize);
+
+    //
+    //  Remove the checksum field from the sum, one word at a time, the same
+    //  way as CheckSumMappedFile, then add the file length.
+    //
+
+    OriginalChecksum = PeHeaders->OptionalHeader.CheckSum;
+    Adjust = OriginalChecksum & 0xFFFF;
+    Sum = (Sum - (Sum < Adjust) - Adjust) & 0xFFFF;
+    Adjust = OriginalChecksum >> 16;
+    Sum = (Sum - (Sum < Adjust) - Adjust) & 0xFFFF;
+    Sum = Sum + FileSize;
+
+    if (Writable) {
+        PeHeaders->OptionalHeader.CheckSum = Sum;
+        if (!FlushViewOfFile(HeaderView, 0)) {
+            Err = GetLastError();
+            goto Exit;
+        }
+    }
+
+    *HeaderChecksum = OriginalChecksum;
+    *DataChecksum = Sum;
+    Err = ERROR_SUCCESS;
+
+Exit:
+    UnmapViewOfFile(HeaderView);
+    CloseHandle(hMapping);
+    CloseHandle(hFile);
+    return Err;
 }
 
+/**
+ Process a file on a worker thread.
+
+ @param Pool Pointer to the thread pool.
+
+ @param WorkItem Pointer to the work item within the file to process.
+ */
+VOID
+PeToolExecuteFile(
+    __in PYORI_LIB_THREAD_POOL Pool,
+    __in PYORI_LIB_WORK_ITEM WorkItem
+    )
+{
+    PPETOOL_FILE File;
+
+    UNREFERENCED_PARAMETER(Pool);
+
+    File = CONTAINING_RECORD(WorkItem, PETOOL_FILE, WorkItem);
+    File->Err = PeToolProcessFile(&File->FullPath,
+                                  File->Context->Op,
+                                  File->Context->MajorVersion,
+                                  File->Context->MinorVersion,
+                                  &File->HeaderChecksum,
+                                  &File->DataChecksum);
+}
 
 /**
- Calculate and display the checksum for a specified file.
+ Display the result of processing a file and free it.  Files complete in
+ the order they were found, so results are displayed in that order.
 
- @param FileName Pointer to the file name to calculate a checksum for.
+ @param Pool Pointer to the thread pool.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @param WorkItem Pointer to the work item within the file to complete.
  */
-BOOLEAN
-PeToolCalculateChecksum(
-    __in PYORI_STRING FileName
+VOID
+PeToolCompleteFile(
+    __in PYORI_LIB_THREAD_POOL Pool,
+    __in PYORI_LIB_WORK_ITEM WorkItem
     )
 {
-    DWORD Err;
-    DWORD HeaderChecksum;
-    DWORD DataChecksum;
-    YORI_STRING FullPath;
+    PPETOOL_FILE File;
+    PPETOOL_CONTEXT Context;
+    YORI_STRING UnescapedPath;
+    LPTSTR ErrText;
 
-    YoriLibLoadImageHlpFunctions();
+    UNREFERENCED_PARAMETER(Pool);
 
-    if (DllImageHlp.pMapFileAndCheckSumW == NULL) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("petool: OS support not present\n"));
-        return FALSE;
-    }
+    File = CONTAINING_RECORD(WorkItem, PETOOL_FILE, WorkItem);
+    Context = File->Context;
 
-    YoriLibInitEmptyString(&FullPath);
-    if (!YoriLibUserStringToSingleFilePath(FileName, TRUE, &FullPath)) {
-        return FALSE;
+    YoriLibInitEmptyString(&UnescapedPath);
+    if (!YoriLibUnescapePath(&File->FullPath, &UnescapedPath)) {
+        UnescapedPath.StartOfString = File->FullPath.StartOfString;
+        UnescapedPath.LengthInChars = File->FullPath.LengthInChars;
     }
 
-    Err = DllImageHlp.pMapFileAndCheckSumW(FullPath.StartOfString, &HeaderChecksum, &DataChecksum);
-    if (Err != 0) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of source failed: %y\n"), FileName);
-        YoriLibFreeStringContents(&FullPath);
-        return FALSE;
+    if (File->Err == ERROR_OLD_WIN_VERSION) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("The specified version is not valid for the processor architecture of this program: %y\n"), &UnescapedPath);
+        Context->Failed = TRUE;
+    } else if (File->Err == ERROR_BAD_EXE_FORMAT) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("This file is not a valid Windows executable: %y\n"), &UnescapedPath);
+        Context->Failed = TRUE;
+    } else if (File->Err != ERROR_SUCCESS) {
+        ErrText = YoriLibGetWinErrorText(File->Err);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of file failed: %y: %s"), &UnescapedPath, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        Context->Failed = TRUE;
+    } else if (Context->Op == PeToolOpCalculateChecksum) {
+        if (Context->DisplayNames) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y:\n"), &UnescapedPath);
+        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Checksum in PE header: %08x\n")
+                                              _T("Checksum of file contents: %08x\n"),
+                                              File->HeaderChecksum,
+                                              File->DataChecksum);
+    } else if (Context->DisplayNames) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y: %08x\n"), &UnescapedPath, File->DataChecksum);
     }
 
-    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Checksum in PE header: %08x\n")
-                                          _T("Checksum of file contents: %08x\n"),
-                                          HeaderChecksum,
-                                          DataChecksum);
-
-    YoriLibFreeStringContents(&FullPath);
-    return TRUE;
+    YoriLibFreeStringContents(&UnescapedPath);
+    YoriLibFreeStringContents(&File->FullPath);
+    YoriLibFree(File);
 }
 
 /**
- Generate the checksum for a binary and update the header.
+ A callback that is invoked when a file is found that matches a search
+ criteria specified in the set of strings to enumerate.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.  This can be NULL if the file
+        was not found by enumeration.
 
- @param FileName Pointer to the file name to generate a checksum for.
+ @param Depth Specifies the recursion depth.  Ignored in this application.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @param Context Pointer to the petool context.
+
+ @return TRUE to continue enumerating, FALSE to abort.
  */
-BOOLEAN
-PeToolUpdateChecksum(
-    __in PYORI_STRING FileName
+BOOL
+PeToolFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in_opt PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
     )
 {
-    DWORD Err;
-    DWORD HeaderChecksum;
-    DWORD DataChecksum;
-    YORI_STRING FullPath;
+    PPETOOL_CONTEXT PeToolContext = (PPETOOL_CONTEXT)Context;
+    PPETOOL_FILE File;
 
-    YoriLibLoadImageHlpFunctions();
+    UNREFERENCED_PARAMETER(FileInfo);
+    UNREFERENCED_PARAMETER(Depth);
 
-    if (DllImageHlp.pMapFileAndCheckSumW == NULL) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("petool: OS support not present\n"));
-        return FALSE;
-    }
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+
+    PeToolContext->FilesFoundThisArg++;
+    PeToolContext->SavedErrorThisArg = ERROR_SUCCESS;
 
-    YoriLibInitEmptyString(&FullPath);
-    if (!YoriLibUserStringToSingleFilePath(FileName, TRUE, &FullPath)) {
+    File = YoriLibMalloc(sizeof(PETOOL_FILE));
+    if (File == NULL) {
+        PeToolContext->Failed = TRUE;
         return FALSE;
     }
 
-    Err = DllImageHlp.pMapFileAndCheckSumW(FullPath.StartOfString, &HeaderChecksum, &DataChecksum);
-    if (Err != 0) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of source failed: %y\n"), FileName);
-        YoriLibFreeStringContents(&FullPath);
+    ZeroMemory(File, sizeof(PETOOL_FILE));
+    if (!YoriLibCopyString(&File->FullPath, FilePath)) {
+        YoriLibFree(File);
+        PeToolContext->Failed = TRUE;
         return FALSE;
     }
 
-    ASSERT(YoriLibIsStringNullTerminated(&FullPath));
+    File->Context = PeToolContext;
+    File->WorkItem.ExecuteFn = PeToolExecuteFile;
+    File->WorkItem.CompleteFn = PeToolCompleteFile;
 
-    Err = PeToolWriteChecksumToFile(&FullPath, DataChecksum);
-    if (Err != ERROR_SUCCESS) {
-        LPTSTR ErrText;
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of file failed: %y: %s"), &FullPath, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
+    if (PeToolContext->Pool != NULL) {
+        YoriLibSubmitWorkItem(PeToolContext->Pool, &File->WorkItem);
+    } else {
+        PeToolExecuteFile(NULL, &File->WorkItem);
+        PeToolCompleteFile(NULL, &File->WorkItem);
     }
 
-    YoriLibFreeStringContents(&FullPath);
-
     return TRUE;
 }
 
 /**
- Update the subsystem version for a PE file and regenerate the checksum.
+ A callback that is invoked when a directory cannot be successfully
+ enumerated.
+
+ @param FilePath Pointer to the file path that could not be enumerated.
+
+ @param ErrorCode The Win32 error code describing the failure.
 
- @param FileName Pointer to the file name to generate a checksum for.
+ @param Depth Recursion depth, ignored in this application.
 
- @param NewSubsystemVersion Pointer to the new subsystem version.
+ @param Context Pointer to the petool context.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @return TRUE to continue enumerating, FALSE to abort.
  */
-BOOLEAN
-PeToolUpdateSubsystemVersion(
-    __in PYORI_STRING FileName,
-    __in PYORI_STRING NewSubsystemVersion
+BOOL
+PeToolFileEnumerateErrorCallback(
+    __in PYORI_STRING FilePath,
+    __in DWORD ErrorCode,
+    __in DWORD Depth,
+    __in PVOID Context
     )
 {
-    DWORD Err;
-    DWORD HeaderChecksum;
-    DWORD DataChecksum;
-    YORI_STRING FullPath;
-    YORI_STRING WinVer;
-    YORI_MAX_SIGNED_T llTemp;
-    YORI_ALLOC_SIZE_T CharsConsumed;
-    WORD MajorVersion;
-    WORD MinorVersion;
+    YORI_STRING UnescapedFilePath;
+    BOOL Result = FALSE;
+    PPETOOL_CONTEXT PeToolContext = (PPETOOL_CONTEXT)Context;
 
-    YoriLibLoadImageHlpFunctions();
+    UNREFERENCED_PARAMETER(Depth);
 
-    if (DllImageHlp.pMapFileAndCheckSumW == NULL) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("petool: OS support not present\n"));
-        return FALSE;
+    YoriLibInitEmptyString(&UnescapedFilePath);
+    if (!YoriLibUnescapePath(FilePath, &UnescapedFilePath)) {
+        UnescapedFilePath.StartOfString = FilePath->StartOfString;
+        UnescapedFilePath.LengthInChars = FilePath->LengthInChars;
     }
 
-    YoriLibInitEmptyString(&FullPath);
-    if (!YoriLibUserStringToSingleFilePath(FileName, TRUE, &FullPath)) {
-        return FALSE;
+    if (ErrorCode == ERROR_FILE_NOT_FOUND || ErrorCode == ERROR_PATH_NOT_FOUND) {
+        PeToolContext->SavedErrorThisArg = ErrorCode;
+        Result = TRUE;
+    } else {
+        LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
+        YORI_STRING DirName;
+        LPTSTR FilePart;
+        YoriLibInitEmptyString(&DirName);
+        DirName.StartOfString = UnescapedFilePath.StartOfString;
+        FilePart = YoriLibFindRightMostCharacter(&UnescapedFilePath, '\\');
+        if (FilePart != NULL) {
+            DirName.LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - DirName.StartOfString);
+        } else {
+            DirName.LengthInChars = UnescapedFilePath.LengthInChars;
+        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Enumerate of %y failed: %s"), &DirName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        PeToolContext->Failed = TRUE;
     }
+    YoriLibFreeStringContents(&UnescapedFilePath);
+    return Result;
+}
+
+/**
+ Parse a user specified version string in the form major.minor.
+
+ @param VersionString Pointer to the version string.
 
-    MajorVersion = 0;
-    MinorVersion = 0;
+ @param MajorVersion On completion, updated to contain the major version.
+
+ @param MinorVersion On completion, updated to contain the minor version,
+        or zero if no minor version was specified.
+ */
+VOID
+PeToolParseVersion(
+    __in PYORI_STRING VersionString,
+    __out PWORD MajorVersion,
+    __out PWORD MinorVersion
+    )
+{
+    YORI_STRING WinVer;
+    YORI_MAX_SIGNED_T llTemp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+
+    *MajorVersion = 0;
+    *MinorVersion = 0;
     YoriLibInitEmptyString(&WinVer);
-    WinVer.StartOfString = NewSubsystemVersion->StartOfString;
-    WinVer.LengthInChars = NewSubsystemVersion->LengthInChars;
+    WinVer.StartOfString = VersionString->StartOfString;
+    WinVer.LengthInChars = VersionString->LengthInChars;
     if (YoriLibStringToNumber(&WinVer, FALSE, &llTemp, &CharsConsumed)) {
-        MajorVersion = (WORD)llTemp;
+        *MajorVersion = (WORD)llTemp;
         WinVer.LengthInChars = WinVer.LengthInChars - CharsConsumed;
         WinVer.StartOfString += CharsConsumed;
         if (WinVer.LengthInChars > 0) {
             WinVer.LengthInChars -= 1;
             WinVer.StartOfString += 1;
             if (YoriLibStringToNumber(&WinVer, FALSE, &llTemp, &CharsConsumed)) {
-                MinorVersion = (WORD)llTemp;
+                *MinorVersion = (WORD)llTemp;
             }
         }
     }
-
-    Err = PeToolWriteSubsystemVersionToFile(&FullPath, MajorVersion, MinorVersion);
-    if (Err == ERROR_OLD_WIN_VERSION) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("The specified version is not valid for the processor architecture of this program: %y\n"), &FullPath);
-    } else if (Err == ERROR_BAD_EXE_FORMAT) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("This file is not a valid Windows executable: %y\n"), &FullPath);
-    } else if (Err != ERROR_SUCCESS) {
-        LPTSTR ErrText;
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of file failed: %y: %s"), &FullPath, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&FullPath);
-        return FALSE;
-    }
-
-    Err = DllImageHlp.pMapFileAndCheckSumW(FullPath.StartOfString, &HeaderChecksum, &DataChecksum);
-    if (Err != 0) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of source failed: %y\n"), FileName);
-        YoriLibFreeStringContents(&FullPath);
-        return FALSE;
-    }
-
-    ASSERT(YoriLibIsStringNullTerminated(&FullPath));
-
-    Err = PeToolWriteChecksumToFile(&FullPath, DataChecksum);
-    if (Err != ERROR_SUCCESS) {
-        LPTSTR ErrText;
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of file failed: %y: %s"), &FullPath, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&FullPath);
-        return FALSE;
-    }
-
-    YoriLibFreeStringContents(&FullPath);
-
-    return TRUE;
 }
 
-/**
- A set of operations supported by this application.
- */
-typedef enum _PETOOL_OP {
-    PeToolOpNone = 0,
-    PeToolOpCalculateChecksum = 1,
-    PeToolOpUpdateChecksum = 2,
-    PeToolOpUpdateSubsystemVersion = 3,
-} PETOOL_OP;
-
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the petool builtin command.
@@ -603,14 +788,14 @@ ENTRYPOINT(
 {
     BOOLEAN ArgumentUnderstood;
     YORI_ALLOC_SIZE_T i;
-    YORI_ALLOC_SIZE_T StartArg;
+    YORI_ALLOC_SIZE_T StartArg = 0;
+    YORI_ALLOC_SIZE_T VersionArg = 0;
     YORI_STRING Arg;
-    PYORI_STRING FileName = NULL;
-    PYORI_STRING NewSubsystemVersion = NULL;
-    PETOOL_OP Op;
-    DWORD Result;
+    PETOOL_CONTEXT PeToolContext;
+    WORD MatchFlags;
 
-    Op = PeToolOpNone;
+    ZeroMemory(&PeToolContext, sizeof(PeToolContext));
+    PeToolContext.Op = PeToolOpNone;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -623,25 +808,22 @@ ENTRYPOINT(
                 PeToolHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2021"));
+                YoriLibDisplayMitLicense(_T("2021-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("c")) == 0) {
                 if (ArgC > i + 1) {
-                    FileName = &ArgV[i + 1];
-                    Op = PeToolOpCalculateChecksum;
+                    PeToolContext.Op = PeToolOpCalculateChecksum;
                     ArgumentUnderstood = TRUE;
                 }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("cu")) == 0) {
                 if (ArgC > i + 1) {
-                    FileName = &ArgV[i + 1];
-                    Op = PeToolOpUpdateChecksum;
+                    PeToolContext.Op = PeToolOpUpdateChecksum;
                     ArgumentUnderstood = TRUE;
                 }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("os")) == 0) {
                 if (ArgC > i + 2) {
-                    FileName = &ArgV[i + 1];
-                    NewSubsystemVersion = &ArgV[i + 2];
-                    Op = PeToolOpUpdateSubsystemVersion;
+                    VersionArg = i + 2;
+                    PeToolContext.Op = PeToolOpUpdateSubsystemVersion;
                     ArgumentUnderstood = TRUE;
                 }
             }
@@ -656,32 +838,77 @@ ENTRYPOINT(
         }
     }
 
-    if (Op == PeToolOpNone) {
+    if (PeToolContext.Op == PeToolOpNone || StartArg == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("petool: operation not specified\n"));
         return EXIT_FAILURE;
     }
 
-    Result = EXIT_SUCCESS;
+    if (VersionArg != 0) {
+        PeToolParseVersion(&ArgV[VersionArg], &PeToolContext.MajorVersion, &PeToolContext.MinorVersion);
+    }
 
-    switch(Op) {
-        case PeToolOpCalculateChecksum:
-            if (!PeToolCalculateChecksum(FileName)) {
-                Result = EXIT_FAILURE;
-            }
-            break;
-        case PeToolOpUpdateChecksum:
-            if (!PeToolUpdateChecksum(FileName)) {
-                Result = EXIT_FAILURE;
-            }
+    //
+    //  If more than one file may be processed, display each file name and
+    //  process them in parallel.  Results are still displayed in the order
+    //  that files are found.  If the pool cannot be created, files are
+    //  processed one at a time.
+    //
+
+    for (i = StartArg; i < ArgC; i++) {
+        if (i == VersionArg) {
+            continue;
+        }
+        if (i != StartArg ||
+            YoriLibFindLeftMostCharacter(&ArgV[i], '*') != NULL ||
+            YoriLibFindLeftMostCharacter(&ArgV[i], '?') != NULL) {
+
+            PeToolContext.DisplayNames = TRUE;
             break;
-        case PeToolOpUpdateSubsystemVersion:
-            if (!PeToolUpdateSubsystemVersion(FileName, NewSubsystemVersion)) {
-                Result = EXIT_FAILURE;
+        }
+    }
+
+    if (PeToolContext.DisplayNames) {
+        if (!YoriLibCreateThreadPool(0, YoriLibCpuClassAny, &PeToolContext.Pool)) {
+            PeToolContext.Pool = NULL;
+        }
+    }
+
+    MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
+
+    for (i = StartArg; i < ArgC; i++) {
+        if (i == VersionArg) {
+            continue;
+        }
+
+        PeToolContext.FilesFoundThisArg = 0;
+        PeToolContext.SavedErrorThisArg = ERROR_SUCCESS;
+        YoriLibForEachStream(&ArgV[i],
+                             MatchFlags,
+                             0,
+                             PeToolFileFoundCallback,
+                             PeToolFileEnumerateErrorCallback,
+                             &PeToolContext);
+
+        if (PeToolContext.FilesFoundThisArg == 0) {
+            YORI_STRING FullPath;
+            YoriLibInitEmptyString(&FullPath);
+            if (YoriLibUserStringToSingleFilePath(&ArgV[i], TRUE, &FullPath)) {
+                PeToolFileFoundCallback(&FullPath, NULL, 0, &PeToolContext);
+                YoriLibFreeStringContents(&FullPath);
             }
-            break;
+        }
     }
 
-    return Result;
+    if (PeToolContext.Pool != NULL) {
+        YoriLibWaitForThreadPool(PeToolContext.Pool);
+        YoriLibDestroyThreadPool(PeToolContext.Pool);
+    }
+
+    if (PeToolContext.Failed) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
 }
 
 // vim:sw=4:ts=4:et:
@@ -47,6 +47,7 @@ YoriPkgUpgradeInstalledPackages(
     )
 {
     YORI_STRING PkgIniFile;
+    PYORI_LIB_INI_FILE Ini;
     YORI_STRING InstalledSection;
     LPTSTR ThisLine;
     LPTSTR Equals;
@@ -77,8 +78,22 @@ YoriPkgUpgradeInstalledPackages(
         return FALSE;
     }
 
+    //
+    //  The upgrade paths of every installed package are queried before
+    //  anything is installed, so a single in memory copy of the INI file
+    //  is sufficient.
+    //
+
+    Ini = YoriLibIniLoad(&PkgIniFile);
+    if (Ini == NULL) {
+        YoriPkgDeletePendingPackages(&PendingPackages);
+        YoriLibFreeStringContents(&PkgIniFile);
+        return FALSE;
+    }
+
     if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
+        YoriLibIniFree(Ini);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
@@ -86,15 +101,16 @@ YoriPkgUpgradeInstalledPackages(
     if (!YoriLibAllocateString(&UpgradePath, YORIPKG_MAX_FIELD_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&InstalledSection);
+        YoriLibIniFree(Ini);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
     InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile.StartOfString);
+        YoriLibIniGetSection(Ini,
+                             _T("Installed"),
+                             InstalledSection.StartOfString,
+                             InstalledSection.LengthAllocated);
 
     YoriLibInitEmptyString(&PkgNameOnly);
     ThisLine = InstalledSection.StartOfString;
@@ -116,30 +132,30 @@ YoriPkgUpgradeInstalledPackages(
         UpgradePath.LengthInChars = 0;
         if (Prefer == YoriPkgUpgradePreferStable) {
             UpgradePath.LengthInChars = (YORI_ALLOC_SIZE_T)
-                DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                      _T("UpgradeToStablePath"),
-                                                      _T(""),
-                                                      UpgradePath.StartOfString,
-                                                      UpgradePath.LengthAllocated,
-                                                      PkgIniFile.StartOfString);
+                YoriLibIniGetString(Ini,
+                                    PkgNameOnly.StartOfString,
+                                    _T("UpgradeToStablePath"),
+                                    _T(""),
+                                    UpgradePath.StartOfString,
+                                    UpgradePath.LengthAllocated);
         } else if (Prefer == YoriPkgUpgradePreferDaily) {
             UpgradePath.LengthInChars = (YORI_ALLOC_SIZE_T)
-                DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                      _T("UpgradeToDailyPath"),
-                                                      _T(""),
-                                                      UpgradePath.StartOfString,
-                                                      UpgradePath.LengthAllocated,
-                                                      PkgIniFile.StartOfString);
+                YoriLibIniGetString(Ini,
+                                    PkgNameOnly.StartOfString,
+                                    _T("UpgradeToDailyPath"),
+                                    _T(""),
+                                    UpgradePath.StartOfString,
+                                    UpgradePath.LengthAllocated);
         }
 
         if (UpgradePath.LengthInChars == 0) {
             UpgradePath.LengthInChars = (YORI_ALLOC_SIZE_T)
-                DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                      _T("UpgradePath"),
-                                                      _T(""),
-                                                      UpgradePath.StartOfString,
-                                                      UpgradePath.LengthAllocated,
-                                                      PkgIniFile.StartOfString);
+                YoriLibIniGetString(Ini,
+                                    PkgNameOnly.StartOfString,
+                                    _T("UpgradePath"),
+                                    _T(""),
+                                    UpgradePath.StartOfString,
+                                    UpgradePath.LengthAllocated);
         }
         if (UpgradePath.LengthInChars > 0) {
             UpgradeThisPackage = TRUE;
@@ -174,6 +190,9 @@ YoriPkgUpgradeInstalledPackages(
         ThisLine++;
     }
 
+    YoriLibIniFree(Ini);
+    Ini = NULL;
+
     //
     //  Upgrade all packages which specify an upgrade path.
     //
@@ -192,6 +211,9 @@ Exit:
 
     YoriPkgDeletePendingPackages(&PendingPackages);
 
+    if (Ini != NULL) {
+        YoriLibIniFree(Ini);
+    }
     YoriLibFreeStringContents(&PkgIniFile);
     YoriLibFreeStringContents(&InstalledSection);
     YoriLibFreeStringContents(&UpgradePath);
@@ -834,6 +856,7 @@ YoriPkgListInstalledPackages(
     )
 {
     YORI_STRING PkgIniFile;
+    PYORI_LIB_INI_FILE Ini;
     YORI_STRING InstalledSection;
     LPTSTR ThisLine;
     LPTSTR Equals;
@@ -841,32 +864,39 @@ YoriPkgListInstalledPackages(
     YORI_STRING PkgVersion;
     YORI_STRING PkgArch;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileSectionW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL) {
+    if (!YoriPkgGetPackageIniFile(NULL, &PkgIniFile)) {
         return FALSE;
     }
 
-    if (!YoriPkgGetPackageIniFile(NULL, &PkgIniFile)) {
+    //
+    //  Load the INI file once and query each package from memory, rather
+    //  than reparsing the file for every installed package.
+    //
+
+    Ini = YoriLibIniLoad(&PkgIniFile);
+    if (Ini == NULL) {
+        YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
+        YoriLibIniFree(Ini);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&PkgArch, YORIPKG_MAX_FIELD_LENGTH)) {
         YoriLibFreeStringContents(&InstalledSection);
+        YoriLibIniFree(Ini);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
     InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile.StartOfString);
+        YoriLibIniGetSection(Ini,
+                             _T("Installed"),
+                             InstalledSection.StartOfString,
+                             InstalledSection.LengthAllocated);
 
     YoriLibInitEmptyString(&PkgNameOnly);
     YoriLibInitEmptyString(&PkgVersion);
@@ -891,12 +921,12 @@ YoriPkgListInstalledPackages(
         PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
 
         PkgArch.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                  _T("Architecture"),
-                                                  _T(""),
-                                                  PkgArch.StartOfString,
-                                                  PkgArch.LengthAllocated,
-                                                  PkgIniFile.StartOfString);
+            YoriLibIniGetString(Ini,
+                                PkgNameOnly.StartOfString,
+                                _T("Architecture"),
+                                _T(""),
+                                PkgArch.StartOfString,
+                                PkgArch.LengthAllocated);
 
         if (Verbose) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y (%y)\n"), &PkgNameOnly, &PkgVersion, &PkgArch);
@@ -905,6 +935,7 @@ YoriPkgListInstalledPackages(
         }
     }
 
+    YoriLibIniFree(Ini);
     YoriLibFreeStringContents(&PkgIniFile);
     YoriLibFreeStringContents(&InstalledSection);
     YoriLibFreeStringContents(&PkgArch);
@@ -1135,34 +1166,45 @@ YoriPkgInstallPseudoPackage(
     )
 {
     YORI_STRING PkgIniFile;
+    PYORI_LIB_INI_FILE Ini;
     DWORD FileIndex;
     TCHAR FileIndexString[16];
+    BOOL Result;
 
-    if (DllKernel32.pWritePrivateProfileStringW == NULL) {
+    if (!YoriPkgGetPackageIniFile(TargetDirectory, &PkgIniFile)) {
         return FALSE;
     }
 
-    if (!YoriPkgGetPackageIniFile(TargetDirectory, &PkgIniFile)) {
+    //
+    //  A pseudo package can contain a large number of files.  Update the
+    //  INI file in memory and write it once, rather than rewriting the
+    //  file for each entry.
+    //
+
+    Ini = YoriLibIniLoad(&PkgIniFile);
+    if (Ini == NULL) {
+        YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    DllKernel32.pWritePrivateProfileStringW(_T("Installed"), Name->StartOfString, Version->StartOfString, PkgIniFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(Name->StartOfString, _T("Version"), Version->StartOfString, PkgIniFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(Name->StartOfString, _T("Architecture"), Architecture->StartOfString, PkgIniFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(Name->StartOfString, _T("BestEffortDelete"), _T("1"), PkgIniFile.StartOfString);
+    YoriLibIniWriteString(Ini, _T("Installed"), Name->StartOfString, Version->StartOfString);
+    YoriLibIniWriteString(Ini, Name->StartOfString, _T("Version"), Version->StartOfString);
+    YoriLibIniWriteString(Ini, Name->StartOfString, _T("Architecture"), Architecture->StartOfString);
+    YoriLibIniWriteString(Ini, Name->StartOfString, _T("BestEffortDelete"), _T("1"));
 
     for (FileIndex = 1; FileIndex <= FileCount; FileIndex++) {
         YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
 
-        DllKernel32.pWritePrivateProfileStringW(Name->StartOfString, FileIndexString, FileArray[FileIndex - 1].StartOfString, PkgIniFile.StartOfString);
+        YoriLibIniWriteString(Ini, Name->StartOfString, FileIndexString, FileArray[FileIndex - 1].StartOfString);
     }
     YoriLibSPrintf(FileIndexString, _T("%i"), FileCount);
-    DllKernel32.pWritePrivateProfileStringW(Name->StartOfString, _T("FileCount"), FileIndexString, PkgIniFile.StartOfString);
-
+    YoriLibIniWriteString(Ini, Name->StartOfString, _T("FileCount"), FileIndexString);
 
+    Result = YoriLibIniFlush(Ini);
+    YoriLibIniFree(Ini);
     YoriLibFreeStringContents(&PkgIniFile);
 
-    return TRUE;
+    return Result;
 }
 
 /**
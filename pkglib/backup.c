@@ -3,7 +3,7 @@
  *
  * Yori package manager move existing files to backups and restore from them
  *
- * Copyright (c) 2018-2019 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -96,19 +96,16 @@ YoriPkgDeleteRenamedFiles(
  this also restores each file entry back into the INI file.  Note this routine
  is best effort and continues on error.
 
- @param IniPath Pointer to the system global INI file.
+ @param Ini Optionally points to the loaded system global INI file.  If
+        specified, File entries in the INI file are restored to match the
+        names of backed up files.  If NULL, the INI file is not touched.
 
  @param PackageBackup Pointer to the backed up package.
-
- @param RestoreIni If TRUE, File entries in the INI file are restored to
-        match the names of backed up files.  If FALSE, the INI file is not
-        touched.
  */
 VOID
 YoriPkgRollbackRenamedFiles(
-    __in PCYORI_STRING IniPath,
-    __in PYORIPKG_BACKUP_PACKAGE PackageBackup,
-    __in BOOL RestoreIni
+    __in_opt PYORI_LIB_INI_FILE Ini,
+    __in PYORIPKG_BACKUP_PACKAGE PackageBackup
     )
 {
     PYORI_LIST_ENTRY ListEntry = NULL;
@@ -117,8 +114,6 @@ YoriPkgRollbackRenamedFiles(
     DWORD Index;
     BOOL Result;
 
-    ASSERT(DllKernel32.pWritePrivateProfileStringW != NULL);
-
     ListEntry = YoriLibGetNextListEntry(&PackageBackup->FileList, ListEntry);
     Index = 1;
     while (ListEntry != NULL) {
@@ -126,10 +121,9 @@ YoriPkgRollbackRenamedFiles(
         ASSERT(YoriLibIsStringNullTerminated(&BackupFile->OriginalName));
         ASSERT(YoriLibIsStringNullTerminated(&BackupFile->OriginalRelativeName));
 
-        if (RestoreIni) {
+        if (Ini != NULL) {
             YoriLibSPrintf(FileIndexString, _T("File%i"), Index);
-            DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, FileIndexString, BackupFile->OriginalRelativeName.StartOfString, IniPath->StartOfString);
-
+            YoriLibIniWriteString(Ini, PackageBackup->PackageName.StartOfString, FileIndexString, BackupFile->OriginalRelativeName.StartOfString);
         }
 
         //
@@ -155,10 +149,40 @@ YoriPkgRollbackRenamedFiles(
     }
 }
 
+/**
+ Write an optional package header into a loaded INI file, removing it if the
+ backed up package did not have a value for it.
+
+ @param Ini Pointer to the loaded system global INI file.
+
+ @param PackageBackup Pointer to the backed up package.
+
+ @param KeyName Pointer to the name of the header.
+
+ @param Value Pointer to the value of the header.  If this is empty, the
+        header is removed.
+ */
+VOID
+YoriPkgRollbackOptionalHeader(
+    __in PYORI_LIB_INI_FILE Ini,
+    __in PYORIPKG_BACKUP_PACKAGE PackageBackup,
+    __in LPCTSTR KeyName,
+    __in PYORI_STRING Value
+    )
+{
+    if (Value->LengthInChars > 0) {
+        YoriLibIniWriteString(Ini, PackageBackup->PackageName.StartOfString, KeyName, Value->StartOfString);
+    } else {
+        YoriLibIniWriteString(Ini, PackageBackup->PackageName.StartOfString, KeyName, NULL);
+    }
+}
+
 /**
  Rename all backed up files back into their original location, and restore
  package INI entries to indicate the backed up package is once again
- installed.  Note this routine is best effort and continues on error.
+ installed.  The INI file is loaded once, all entries are restored in
+ memory, and the result is written once.  Note this routine is best effort
+ and continues on error.
 
  @param IniPath Pointer to the system global INI file.
 
@@ -171,8 +195,7 @@ YoriPkgRollbackPackage(
     )
 {
     TCHAR FileCountString[16];
-
-    ASSERT(DllKernel32.pWritePrivateProfileStringW != NULL);
+    PYORI_LIB_INI_FILE Ini;
 
     ASSERT(YoriLibIsStringNullTerminated(IniPath));
 
@@ -184,67 +207,56 @@ YoriPkgRollbackPackage(
     ASSERT(PackageBackup->Version.LengthInChars > 0);
     ASSERT(PackageBackup->Architecture.LengthInChars > 0);
 
+    //
+    //  If the INI file can't be loaded, put the files back anyway.
+    //
+
+    Ini = YoriLibIniLoad(IniPath);
+    if (Ini == NULL) {
+        YoriPkgRollbackRenamedFiles(NULL, PackageBackup);
+        return;
+    }
+
     //
     //  Delete the entire existing section.  This will clear out any files
     //  added there that aren't part of the backed up package.
     //
 
-    DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, NULL, NULL, IniPath->StartOfString);
+    YoriLibIniWriteString(Ini, PackageBackup->PackageName.StartOfString, NULL, NULL);
 
     //
     //  Put back the files and recreate their INI entries.
     //
 
-    YoriPkgRollbackRenamedFiles(IniPath, PackageBackup, TRUE);
+    YoriPkgRollbackRenamedFiles(Ini, PackageBackup);
     YoriLibSPrintf(FileCountString, _T("%i"), PackageBackup->FileCount);
 
     //
     //  Restore all of the fixed headers for the package.
     //
 
-    DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("FileCount"), FileCountString, IniPath->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("Version"), PackageBackup->Version.StartOfString, IniPath->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("Architecture"), PackageBackup->Architecture.StartOfString, IniPath->StartOfString);
+    YoriLibIniWriteString(Ini, PackageBackup->PackageName.StartOfString, _T("FileCount"), FileCountString);
+    YoriLibIniWriteString(Ini, PackageBackup->PackageName.StartOfString, _T("Version"), PackageBackup->Version.StartOfString);
+    YoriLibIniWriteString(Ini, PackageBackup->PackageName.StartOfString, _T("Architecture"), PackageBackup->Architecture.StartOfString);
 
     //
     //  Restore any optional headers for the package.
     //
 
-    if (PackageBackup->UpgradePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradePath"), PackageBackup->UpgradePath.StartOfString, IniPath->StartOfString);
-    } else {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradePath"), NULL, IniPath->StartOfString);
-    }
-
-    if (PackageBackup->SourcePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("SourcePath"), PackageBackup->SourcePath.StartOfString, IniPath->StartOfString);
-    } else {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("SourcePath"), NULL, IniPath->StartOfString);
-    }
-
-    if (PackageBackup->SymbolPath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("SymbolPath"), PackageBackup->SymbolPath.StartOfString, IniPath->StartOfString);
-    } else {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("SymbolPath"), NULL, IniPath->StartOfString);
-    }
-
-    if (PackageBackup->UpgradeToDailyPath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradeToDailyPath"), PackageBackup->UpgradeToDailyPath.StartOfString, IniPath->StartOfString);
-    } else {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradeToDailyPath"), NULL, IniPath->StartOfString);
-    }
-
-    if (PackageBackup->UpgradeToStablePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradeToStablePath"), PackageBackup->UpgradeToStablePath.StartOfString, IniPath->StartOfString);
-    } else {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradeToStablePath"), NULL, IniPath->StartOfString);
-    }
+    YoriPkgRollbackOptionalHeader(Ini, PackageBackup, _T("UpgradePath"), &PackageBackup->UpgradePath);
+    YoriPkgRollbackOptionalHeader(Ini, PackageBackup, _T("SourcePath"), &PackageBackup->SourcePath);
+    YoriPkgRollbackOptionalHeader(Ini, PackageBackup, _T("SymbolPath"), &PackageBackup->SymbolPath);
+    YoriPkgRollbackOptionalHeader(Ini, PackageBackup, _T("UpgradeToDailyPath"), &PackageBackup->UpgradeToDailyPath);
+    YoriPkgRollbackOptionalHeader(Ini, PackageBackup, _T("UpgradeToStablePath"), &PackageBackup->UpgradeToStablePath);
 
     //
     //  Indicate the package is installed.
     //
 
-    DllKernel32.pWritePrivateProfileStringW(_T("Installed"), PackageBackup->PackageName.StartOfString, PackageBackup->Version.StartOfString, IniPath->StartOfString);
+    YoriLibIniWriteString(Ini, _T("Installed"), PackageBackup->PackageName.StartOfString, PackageBackup->Version.StartOfString);
+
+    YoriLibIniFlush(Ini);
+    YoriLibIniFree(Ini);
 }
 
 /**
@@ -282,14 +294,12 @@ YoriPkgBackupPackage(
     PYORIPKG_BACKUP_FILE BackupFile;
     YORI_STRING FullTargetDirectory;
     YORI_STRING IniValue;
+    PYORI_LIB_INI_FILE Ini;
     DWORD FileIndex;
     DWORD Err;
     TCHAR FileIndexString[16];
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
+    if (DllKernel32.pGetPrivateProfileStringW == NULL) {
         return ERROR_PROC_NOT_FOUND;
     }
 
@@ -339,15 +349,28 @@ YoriPkgBackupPackage(
         return ERROR_NOT_ENOUGH_MEMORY;
     }
 
-    Context->FileCount = DllKernel32.pGetPrivateProfileIntW(Context->PackageName.StartOfString, _T("FileCount"), 0, IniPath->StartOfString);
+    //
+    //  Load the INI file once and read each file entry from memory, rather
+    //  than having the system reparse the file for each entry.
+    //
+
+    Ini = YoriLibIniLoad(IniPath);
+    if (Ini == NULL) {
+        YoriLibFreeStringContents(&FullTargetDirectory);
+        YoriPkgFreeBackupPackage(Context);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    Context->FileCount = YoriLibIniGetInt(Ini, Context->PackageName.StartOfString, _T("FileCount"), 0);
     if (Context->FileCount == 0) {
-        Err = GetLastError();
+        YoriLibIniFree(Ini);
         YoriLibFreeStringContents(&FullTargetDirectory);
         YoriPkgFreeBackupPackage(Context);
-        return Err;
+        return ERROR_FILE_NOT_FOUND;
     }
 
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
+        YoriLibIniFree(Ini);
         YoriLibFreeStringContents(&FullTargetDirectory);
         YoriPkgFreeBackupPackage(Context);
         return ERROR_NOT_ENOUGH_MEMORY;
@@ -357,12 +380,12 @@ YoriPkgBackupPackage(
         YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
 
         IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(Context->PackageName.StartOfString,
-                                                  FileIndexString,
-                                                  _T(""),
-                                                  IniValue.StartOfString,
-                                                  IniValue.LengthAllocated,
-                                                  IniPath->StartOfString);
+            YoriLibIniGetString(Ini,
+                                Context->PackageName.StartOfString,
+                                FileIndexString,
+                                _T(""),
+                                IniValue.StartOfString,
+                                IniValue.LengthAllocated);
 
         //
         //  Don't backup files with absolute paths
@@ -374,7 +397,8 @@ YoriPkgBackupPackage(
 
         BackupFile = YoriLibReferencedMalloc(sizeof(YORIPKG_BACKUP_FILE));
         if (BackupFile == NULL) {
-            YoriPkgRollbackRenamedFiles(IniPath, Context, FALSE);
+            YoriPkgRollbackRenamedFiles(NULL, Context);
+            YoriLibIniFree(Ini);
             YoriLibFreeStringContents(&FullTargetDirectory);
             YoriLibFreeStringContents(&IniValue);
             YoriPkgFreeBackupPackage(Context);
@@ -385,7 +409,8 @@ YoriPkgBackupPackage(
 
         YoriLibYPrintf(&BackupFile->OriginalName, _T("%y\\%y"), &FullTargetDirectory, &IniValue);
         if (BackupFile->OriginalName.LengthInChars == 0) {
-            YoriPkgRollbackRenamedFiles(IniPath, Context, FALSE);
+            YoriPkgRollbackRenamedFiles(NULL, Context);
+            YoriLibIniFree(Ini);
             YoriLibFreeStringContents(&FullTargetDirectory);
             YoriLibFreeStringContents(&IniValue);
             YoriLibDereference(BackupFile);
@@ -401,7 +426,8 @@ YoriPkgBackupPackage(
         if (!YoriLibRenameFileToBackupName(&BackupFile->OriginalName, &BackupFile->BackupName)) {
             Err = GetLastError();
             if (Err != ERROR_FILE_NOT_FOUND) {
-                YoriPkgRollbackRenamedFiles(IniPath, Context, FALSE);
+                YoriPkgRollbackRenamedFiles(NULL, Context);
+                YoriLibIniFree(Ini);
                 YoriLibFreeStringContents(&BackupFile->OriginalName);
                 YoriLibFreeStringContents(&FullTargetDirectory);
                 YoriLibFreeStringContents(&IniValue);
@@ -414,6 +440,7 @@ YoriPkgBackupPackage(
         YoriLibAppendList(&Context->FileList, &BackupFile->ListEntry);
 
     }
+    YoriLibIniFree(Ini);
     YoriLibFreeStringContents(&FullTargetDirectory);
     YoriLibFreeStringContents(&IniValue);
 
@@ -624,31 +651,38 @@ YoriPkgAddExistingFilesToPendingPackages(
     LPTSTR Equals;
     YORI_STRING PkgNameOnly;
     YORI_STRING IniValue;
+    PYORI_LIB_INI_FILE Ini;
     YORI_ALLOC_SIZE_T LineLength;
     DWORD FileCount;
     DWORD FileIndex;
     TCHAR FileIndexString[16];
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileSectionW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL) {
+    //
+    //  This walks every file of every installed package, so parse the INI
+    //  file once rather than asking the system to reparse it per entry.
+    //
+
+    Ini = YoriLibIniLoad(PkgIniFile);
+    if (Ini == NULL) {
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
+        YoriLibIniFree(Ini);
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
         YoriLibFreeStringContents(&InstalledSection);
+        YoriLibIniFree(Ini);
         return FALSE;
     }
 
     InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile->StartOfString);
+        YoriLibIniGetSection(Ini,
+                             _T("Installed"),
+                             InstalledSection.StartOfString,
+                             InstalledSection.LengthAllocated);
 
     YoriLibInitEmptyString(&PkgNameOnly);
     ThisLine = InstalledSection.StartOfString;
@@ -666,21 +700,22 @@ YoriPkgAddExistingFilesToPendingPackages(
         ThisLine++;
         PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
 
-        FileCount = DllKernel32.pGetPrivateProfileIntW(PkgNameOnly.StartOfString, _T("FileCount"), 0, PkgIniFile->StartOfString);
+        FileCount = YoriLibIniGetInt(Ini, PkgNameOnly.StartOfString, _T("FileCount"), 0);
 
         for (FileIndex = 1; FileIndex <= FileCount; FileIndex++) {
             YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
 
             IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-                DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                      FileIndexString,
-                                                      _T(""),
-                                                      IniValue.StartOfString,
-                                                      IniValue.LengthAllocated,
-                                                      PkgIniFile->StartOfString);
+                YoriLibIniGetString(Ini,
+                                    PkgNameOnly.StartOfString,
+                                    FileIndexString,
+                                    _T(""),
+                                    IniValue.StartOfString,
+                                    IniValue.LengthAllocated);
             if (!YoriPkgAddExistingFileToPendingPackages(PendingPackages, &IniValue)) {
                 YoriLibFreeStringContents(&InstalledSection);
                 YoriLibFreeStringContents(&IniValue);
+                YoriLibIniFree(Ini);
                 return FALSE;
             }
         }
@@ -688,6 +723,7 @@ YoriPkgAddExistingFilesToPendingPackages(
 
     YoriLibFreeStringContents(&InstalledSection);
     YoriLibFreeStringContents(&IniValue);
+    YoriLibIniFree(Ini);
 
     return TRUE;
 }
@@ -709,7 +745,8 @@ YoriPkgInitializePendingPackages(
     YoriLibInitializeListHead(&PendingPackages->PackageList);
     YoriLibInitializeListHead(&PendingPackages->BackupPackages);
     YoriLibInitializeListHead(&PendingPackages->KnownPackages);
-    PendingPackages->ExistingFilesTable = YoriLibAllocateHashTable(253);
+    PendingPackages->Prefetch = NULL;
+    PendingPackages->ExistingFilesTable = YoriLibAllocateHashTableEx(253, YoriLibHashStringFnv32);
     if (PendingPackages->ExistingFilesTable == NULL) {
         return FALSE;
     }
@@ -881,7 +918,16 @@ YoriPkgPreparePackageForInstall(
     }
     ZeroMemory(PendingPackage, sizeof(YORIPKG_PACKAGE_PENDING_INSTALL));
 
-    Result = YoriPkgPackagePathToLocalPath(PackageUrl, PkgIniFile, &PendingPackage->LocalPackagePath, &PendingPackage->DeleteLocalPackagePath);
+    //
+    //  If the package is being downloaded in the background, wait for it
+    //  and use that copy.  Otherwise, download it now.
+    //
+
+    if (PackageList->Prefetch == NULL ||
+        !YoriPkgTakePrefetchedPackage(PackageList->Prefetch, PackageUrl, &PendingPackage->LocalPackagePath, &PendingPackage->DeleteLocalPackagePath, &Result)) {
+
+        Result = YoriPkgPackagePathToLocalPath(PackageUrl, PkgIniFile, &PendingPackage->LocalPackagePath, &PendingPackage->DeleteLocalPackagePath);
+    }
     if (Result != ERROR_SUCCESS) {
         YoriLibFree(PendingPackage);
         return Result;
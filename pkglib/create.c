@@ -3,7 +3,7 @@
  *
  * Yori shell create packages
  *
- * Copyright (c) 2018-2021 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -274,6 +274,11 @@ typedef struct _YORIPKG_MATCH_ITEM {
      wildcards.
      */
     YORI_STRING MatchCriteria;
+
+    /**
+     The match criteria, compiled for matching against each file.
+     */
+    YORI_LIB_FILE_MATCH_EXPRESSION CompiledCriteria;
 } YORIPKG_MATCH_ITEM, *PYORIPKG_MATCH_ITEM;
 
 /**
@@ -338,6 +343,7 @@ YoriPkgCreateSourceAddMatch(
     MatchItem->MatchCriteria.LengthAllocated = NewCriteria->LengthInChars + 1;
     memcpy(MatchItem->MatchCriteria.StartOfString, NewCriteria->StartOfString, MatchItem->MatchCriteria.LengthInChars * sizeof(TCHAR));
     MatchItem->MatchCriteria.StartOfString[MatchItem->MatchCriteria.LengthInChars] = '\0';
+    YoriLibCompileFileMatchExpression(&MatchItem->MatchCriteria, &MatchItem->CompiledCriteria);
     YoriLibAppendList(List, &MatchItem->MatchList);
     return TRUE;
 }
@@ -397,12 +403,12 @@ YoriPkgCreateSourceShouldExclude(
     ListEntry = YoriLibGetNextListEntry(&CreateSourceContext->ExcludeList, NULL);
     while (ListEntry != NULL) {
         MatchItem = CONTAINING_RECORD(ListEntry, YORIPKG_MATCH_ITEM, MatchList);
-        if (YoriLibDoesFileMatchExpression(RelativeSourcePath, &MatchItem->MatchCriteria)) {
+        if (YoriLibDoesFileMatchCompiledExpression(RelativeSourcePath, &MatchItem->CompiledCriteria)) {
 
             ListEntry = YoriLibGetNextListEntry(&CreateSourceContext->IncludeList, NULL);
             while (ListEntry != NULL) {
                 MatchItem = CONTAINING_RECORD(ListEntry, YORIPKG_MATCH_ITEM, MatchList);
-                if (YoriLibDoesFileMatchExpression(RelativeSourcePath, &MatchItem->MatchCriteria)) {
+                if (YoriLibDoesFileMatchCompiledExpression(RelativeSourcePath, &MatchItem->CompiledCriteria)) {
                     return FALSE;
                 }
                 ListEntry = YoriLibGetNextListEntry(&CreateSourceContext->IncludeList, ListEntry);
@@ -552,7 +552,7 @@ YoriPkgCollectPackagesFromSource(
         goto Exit;
     }
 
-    Result = YoriPkgPackagePathToLocalPath(&Source->SourcePkgList, PackagesIni, &LocalPath, &DeleteWhenFinished);
+    Result = YoriPkgSourcePathToLocalPath(&Source->SourcePkgList, PackagesIni, &LocalPath, &DeleteWhenFinished);
     if (Result != ERROR_SUCCESS) {
         YoriLibInitEmptyString(&LocalPath);
         DeleteWhenFinished = FALSE;
@@ -893,6 +893,69 @@ YoriPkgDisplayAvailableRemotePackageNames(VOID)
     return TRUE;
 }
 
+/**
+ Start downloading all of the packages in a list of remote packages
+ concurrently, in list order.
+
+ @param PackageList Pointer to the list of remote packages.
+
+ @param IniFilePath Optionally points to the package INI file, used to
+        locate mirrors for packages.
+
+ @param Prefetch On successful completion, populated with a prefetch set
+        which the caller should clean up with @ref YoriPkgCleanupPrefetch .
+
+ @return TRUE to indicate downloads have started, FALSE if they have not and
+         the caller should download each package as it is needed.
+ */
+BOOL
+YoriPkgPrefetchRemotePackages(
+    __in PYORI_LIST_ENTRY PackageList,
+    __in_opt PCYORI_STRING IniFilePath,
+    __out PYORIPKG_PACKAGE_PREFETCH Prefetch
+    )
+{
+    PYORI_LIST_ENTRY PackageEntry;
+    PYORIPKG_REMOTE_PACKAGE Package;
+    PYORI_STRING PackageUrls;
+    DWORD PackageCount;
+    DWORD Index;
+    BOOL Result;
+
+    PackageCount = 0;
+    PackageEntry = YoriLibGetNextListEntry(PackageList, NULL);
+    while (PackageEntry != NULL) {
+        PackageCount++;
+        PackageEntry = YoriLibGetNextListEntry(PackageList, PackageEntry);
+    }
+
+    //
+    //  With one package there is nothing to overlap.
+    //
+
+    if (PackageCount < 2) {
+        return FALSE;
+    }
+
+    PackageUrls = YoriLibMalloc(PackageCount * sizeof(YORI_STRING));
+    if (PackageUrls == NULL) {
+        return FALSE;
+    }
+
+    Index = 0;
+    PackageEntry = YoriLibGetNextListEntry(PackageList, NULL);
+    while (PackageEntry != NULL) {
+        Package = CONTAINING_RECORD(PackageEntry, YORIPKG_REMOTE_PACKAGE, PackageList);
+        memcpy(&PackageUrls[Index], &Package->InstallUrl, sizeof(YORI_STRING));
+        Index++;
+        PackageEntry = YoriLibGetNextListEntry(PackageList, PackageEntry);
+    }
+
+    Result = YoriPkgStartPrefetch(Prefetch, PackageUrls, PackageCount, IniFilePath);
+    YoriLibFree(PackageUrls);
+    return Result;
+}
+
 /**
  Enumerate all packages on a server from its pkglist.ini, download all of the
  packages to a local directory, and generate a pkglist.ini in that directory
@@ -921,6 +984,8 @@ YoriPkgDownloadRemotePackages(
     YORI_ALLOC_SIZE_T Index;
     DWORD Err;
     BOOLEAN DeleteWhenFinished;
+    YORIPKG_PACKAGE_PREFETCH Prefetch;
+    BOOL Prefetching;
 
     if (DllKernel32.pWritePrivateProfileStringW == NULL) {
         return FALSE;
@@ -936,9 +1001,12 @@ YoriPkgDownloadRemotePackages(
     }
 
     //
-    //  Download the packages we found.
+    //  Download the packages we found.  These are fetched concurrently in
+    //  the background and saved here in order as each arrives.
     //
 
+    Prefetching = YoriPkgPrefetchRemotePackages(&PackageList, NULL, &Prefetch);
+
     PackageEntry = NULL;
     PackageEntry = YoriLibGetNextListEntry(&PackageList, PackageEntry);
     while (PackageEntry != NULL) {
@@ -967,7 +1035,11 @@ YoriPkgDownloadRemotePackages(
             //
 
             YoriLibInitEmptyString(&TempLocalPath);
-            Err = YoriPkgPackagePathToLocalPath(&Package->InstallUrl, NULL, &TempLocalPath, &DeleteWhenFinished);
+            if (!Prefetching ||
+                !YoriPkgTakePrefetchedPackage(&Prefetch, &Package->InstallUrl, &TempLocalPath, &DeleteWhenFinished, &Err)) {
+
+                Err = YoriPkgPackagePathToLocalPath(&Package->InstallUrl, NULL, &TempLocalPath, &DeleteWhenFinished);
+            }
             if (Err == ERROR_SUCCESS) {
                 YoriLibYPrintf(&FullFinalName, _T("%y\\%y"), DownloadPath, &FinalFileName);
                 if (FullFinalName.LengthInChars == 0) {
@@ -1048,6 +1120,10 @@ YoriPkgDownloadRemotePackages(
         PackageEntry = YoriLibGetNextListEntry(&PackageList, PackageEntry);
     }
 
+    if (Prefetching) {
+        YoriPkgCleanupPrefetch(&Prefetch);
+    }
+
     YoriPkgFreeAllSourcesAndPackages(&SourcesList, &PackageList);
     YoriLibFreeStringContents(&PackagesIni);
 
@@ -1347,6 +1423,7 @@ YoriPkgInstallRemotePackages(
     YORI_STRING IniFile;
     YORI_STRING IniValue;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
+    YORIPKG_PACKAGE_PREFETCH Prefetch;
     DWORD Error;
 
     Result = FALSE;
@@ -1381,6 +1458,16 @@ YoriPkgInstallRemotePackages(
                                                      MatchArch,
                                                      &PackagesMatchingCriteria);
 
+    //
+    //  Download the packages concurrently.  Each is still examined and
+    //  staged below in list order, waiting for its download only if it
+    //  hasn't arrived yet.
+    //
+
+    if (YoriPkgPrefetchRemotePackages(&PackagesMatchingCriteria, &IniFile, &Prefetch)) {
+        PendingPackages.Prefetch = &Prefetch;
+    }
+
     //
     //  Find if any of these are installed and back them up.
     //
@@ -1419,6 +1506,11 @@ Exit:
         YoriPkgRollbackAndFreeBackupPackageList(&IniFile, NewDirectory, &PendingPackages.BackupPackages);
     }
 
+    if (PendingPackages.Prefetch != NULL) {
+        YoriPkgCleanupPrefetch(PendingPackages.Prefetch);
+        PendingPackages.Prefetch = NULL;
+    }
+
     YoriPkgDeletePendingPackages(&PendingPackages);
 
     YoriPkgFreeAllSourcesAndPackages(NULL, &PackagesMatchingCriteria);
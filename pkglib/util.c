@@ -1061,6 +1061,54 @@ Exit:
     return Result;
 }
 
+/**
+ Download a Url into a local file.
+
+ @param Url Pointer to the Url to download.
+
+ @param TargetFile Pointer to the local file to write.
+
+ @param IfModifiedSince Optionally points to a timestamp where the local file
+        is only replaced if the remote object is newer.
+
+ @return ERROR_SUCCESS to indicate success, or other Win32 error to indicate
+         the type of failure.
+ */
+DWORD
+YoriPkgDownloadUrlToFile(
+    __in PCYORI_STRING Url,
+    __in PCYORI_STRING TargetFile,
+    __in_opt PSYSTEMTIME IfModifiedSince
+    )
+{
+    YORI_STRING UserAgent;
+    YORI_LIB_UPDATE_ERROR Error;
+
+    YoriLibInitEmptyString(&UserAgent);
+    YoriLibYPrintf(&UserAgent, _T("ypm %i.%02i\r\n"), YORI_VER_MAJOR, YORI_VER_MINOR);
+    if (UserAgent.StartOfString == NULL) {
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    Error = YoriLibUpdateBinaryFromUrl(Url, TargetFile, &UserAgent, IfModifiedSince);
+    YoriLibFreeStringContents(&UserAgent);
+
+    switch(Error) {
+        case YoriLibUpdErrorSuccess:
+            return ERROR_SUCCESS;
+        case YoriLibUpdErrorInetInit:
+        case YoriLibUpdErrorInetConnect:
+        case YoriLibUpdErrorInetRead:
+        case YoriLibUpdErrorInetContents:
+            return ERROR_NO_NETWORK;
+        case YoriLibUpdErrorFileWrite:
+        case YoriLibUpdErrorFileReplace:
+            return ERROR_WRITE_FAULT;
+    }
+
+    return ERROR_NOT_SUPPORTED;
+}
+
 /**
  Download a remote package into a temporary location and return the
  temporary location to allow for subsequent processing.
@@ -1118,8 +1166,6 @@ YoriPkgPackagePathToLocalPath(
 
         YORI_STRING TempPath;
         YORI_STRING TempFileName;
-        YORI_STRING UserAgent;
-        YORI_LIB_UPDATE_ERROR Error;
         YoriLibInitEmptyString(&TempPath);
 
         //
@@ -1152,37 +1198,8 @@ YoriPkgPackagePathToLocalPath(
 
         TempFileName.LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(TempFileName.StartOfString);
 
-        YoriLibInitEmptyString(&UserAgent);
-        YoriLibYPrintf(&UserAgent, _T("ypm %i.%02i\r\n"), YORI_VER_MAJOR, YORI_VER_MINOR);
-        if (UserAgent.StartOfString == NULL) {
-            YoriLibFreeStringContents(&TempPath);
-            YoriLibFreeStringContents(&TempFileName);
-            Result = ERROR_NOT_ENOUGH_MEMORY;
-            goto Exit;
-        }
-
-        Error = YoriLibUpdateBinaryFromUrl(&MirroredPath, &TempFileName, &UserAgent, NULL);
-
-        if (Error != YoriLibUpdErrorSuccess) {
-            switch(Error) {
-                case YoriLibUpdErrorInetInit:
-                case YoriLibUpdErrorInetConnect:
-                case YoriLibUpdErrorInetRead:
-                case YoriLibUpdErrorInetContents:
-                    Result = ERROR_NO_NETWORK;
-                    break;
-                case YoriLibUpdErrorFileWrite:
-                case YoriLibUpdErrorFileReplace:
-                    Result = ERROR_WRITE_FAULT;
-                    break;
-                default:
-                    Result = ERROR_NOT_SUPPORTED;
-                    break;
-            }
-        }
-
+        Result = YoriPkgDownloadUrlToFile(&MirroredPath, &TempFileName, NULL);
         YoriLibFreeStringContents(&TempPath);
-        YoriLibFreeStringContents(&UserAgent);
 
         if (Result != ERROR_SUCCESS) {
             YoriLibFreeStringContents(&TempFileName);
@@ -1203,6 +1220,395 @@ Exit:
     return Result;
 }
 
+/**
+ Return a path to the file used to cache a remote source's package list.
+ Cached lists live in a pkgcache directory next to the application, with a
+ name derived from the Url.
+
+ @param Url Pointer to the Url of the package list.
+
+ @param CacheFile On successful completion, populated with a path to the
+        cache file.  The file may not exist.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgGetSourceCacheFile(
+    __in PCYORI_STRING Url,
+    __out PYORI_STRING CacheFile
+    )
+{
+    YORI_STRING AppDirectory;
+    DWORD Hash;
+
+    if (!YoriPkgGetApplicationDirectory(&AppDirectory)) {
+        return FALSE;
+    }
+
+    //
+    //  The Url is hashed in full and its length folded in to make collisions
+    //  between sources less likely.  This hash is stable across versions so
+    //  it's suitable for a persisted name.
+    //
+
+    Hash = YoriLibHashString32(Url->LengthInChars, Url);
+
+    YoriLibInitEmptyString(CacheFile);
+    YoriLibYPrintf(CacheFile, _T("%y\\pkgcache"), &AppDirectory);
+    YoriLibFreeStringContents(&AppDirectory);
+    if (CacheFile->StartOfString == NULL) {
+        return FALSE;
+    }
+
+    if (GetFileAttributes(CacheFile->StartOfString) == (DWORD)-1 &&
+        !YoriLibCreateDirectoryAndParents(CacheFile)) {
+
+        YoriLibFreeStringContents(CacheFile);
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&AppDirectory);
+    YoriLibYPrintf(&AppDirectory, _T("%y\\%08x.ini"), CacheFile, Hash);
+    YoriLibFreeStringContents(CacheFile);
+    if (AppDirectory.StartOfString == NULL) {
+        return FALSE;
+    }
+
+    memcpy(CacheFile, &AppDirectory, sizeof(YORI_STRING));
+    return TRUE;
+}
+
+/**
+ Return a local path to a source's package list.  Remote lists are kept in
+ a local cache and only downloaded again if the server indicates the list
+ has been modified since the cached copy.
+
+ @param SourcePath Pointer to a string referring to the package list which
+        can be local or remote.
+
+ @param IniFilePath Pointer to a string containing a path to the package INI
+        file.
+
+ @param LocalPath On successful completion, populated with a string containing
+        a fully qualified local path to the package list.
+
+ @param DeleteWhenFinished On successful completion, set to TRUE to indicate
+        the caller should delete the file (it is temporary); set to FALSE to
+        indicate the file should be retained.
+
+ @return ERROR_SUCCESS to indicate success, or other Win32 error to indicate
+         the type of failure.
+ */
+__success(return == ERROR_SUCCESS)
+DWORD
+YoriPkgSourcePathToLocalPath(
+    __in PYORI_STRING SourcePath,
+    __in_opt PCYORI_STRING IniFilePath,
+    __out PYORI_STRING LocalPath,
+    __out PBOOLEAN DeleteWhenFinished
+    )
+{
+    YORI_STRING MirroredPath;
+    YORI_STRING CacheFile;
+    WIN32_FILE_ATTRIBUTE_DATA CacheFileInfo;
+    SYSTEMTIME CacheFileTime;
+    PSYSTEMTIME IfModifiedSince;
+    DWORD Result;
+
+    YoriLibInitEmptyString(&MirroredPath);
+    if (IniFilePath == NULL ||
+        !YoriPkgConvertUserPackagePathToMirroredPath(SourcePath, IniFilePath, &MirroredPath)) {
+
+        YoriLibCloneString(&MirroredPath, SourcePath);
+    }
+
+    if (!YoriLibIsPathUrl(&MirroredPath) ||
+        !YoriPkgGetSourceCacheFile(&MirroredPath, &CacheFile)) {
+
+        YoriLibFreeStringContents(&MirroredPath);
+        return YoriPkgPackagePathToLocalPath(SourcePath, IniFilePath, LocalPath, DeleteWhenFinished);
+    }
+
+    //
+    //  If a cached copy exists, ask for the list only if it's newer.  The
+    //  cached file carries the server's modification time when the server
+    //  provided one.  If the list is unchanged the request succeeds without
+    //  touching the cached copy.
+    //
+
+    IfModifiedSince = NULL;
+    if (GetFileAttributesEx(CacheFile.StartOfString, GetFileExInfoStandard, &CacheFileInfo) &&
+        CacheFileInfo.nFileSizeLow != 0 &&
+        FileTimeToSystemTime(&CacheFileInfo.ftLastWriteTime, &CacheFileTime)) {
+
+        IfModifiedSince = &CacheFileTime;
+    }
+
+    Result = YoriPkgDownloadUrlToFile(&MirroredPath, &CacheFile, IfModifiedSince);
+    YoriLibFreeStringContents(&MirroredPath);
+
+    if (Result != ERROR_SUCCESS) {
+        YoriLibFreeStringContents(&CacheFile);
+        return Result;
+    }
+
+    memcpy(LocalPath, &CacheFile, sizeof(YORI_STRING));
+    *DeleteWhenFinished = FALSE;
+    return ERROR_SUCCESS;
+}
+
+/**
+ A worker thread which downloads packages from a prefetch set until no more
+ packages remain to be claimed.
+
+ @param Context Pointer to the prefetch set.
+
+ @return Zero.
+ */
+DWORD WINAPI
+YoriPkgPrefetchWorker(
+    __in LPVOID Context
+    )
+{
+    PYORIPKG_PACKAGE_PREFETCH Prefetch;
+    PYORIPKG_PREFETCHED_PACKAGE Package;
+    PCYORI_STRING IniFilePath;
+    LONG Index;
+
+    Prefetch = (PYORIPKG_PACKAGE_PREFETCH)Context;
+    IniFilePath = NULL;
+    if (Prefetch->IniFilePath.StartOfString != NULL) {
+        IniFilePath = &Prefetch->IniFilePath;
+    }
+
+    while (TRUE) {
+        Index = InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&Prefetch->NextPackage) - 1;
+        if (Index < 0 || (DWORD)Index >= Prefetch->PackageCount) {
+            break;
+        }
+
+        Package = &Prefetch->Packages[Index];
+        Package->Error = YoriPkgPackagePathToLocalPath(&Package->PackagePath, IniFilePath, &Package->LocalPath, &Package->DeleteWhenFinished);
+        SetEvent(Package->CompleteEvent);
+    }
+
+    return 0;
+}
+
+/**
+ Start downloading a set of packages concurrently.  Packages are downloaded
+ in the order specified, with up to @ref YORIPKG_MAX_CONCURRENT_DOWNLOADS
+ in flight at once, so a caller that consumes them in the same order can
+ process each as it arrives while later ones are still downloading.
+
+ @param Prefetch Pointer to a prefetch set to initialize.  On success, the
+        caller should call @ref YoriPkgCleanupPrefetch when it is no longer
+        needed.
+
+ @param PackagePaths Pointer to an array of package paths or URLs.  These
+        are copied so the caller's strings are not referenced after this
+        call returns.
+
+ @param PackageCount The number of elements in the PackagePaths array.
+
+ @param IniFilePath Optionally points to the package INI file, which is used
+        to locate mirrors for packages.  This should be the same value that
+        the caller would otherwise pass to
+        @ref YoriPkgPackagePathToLocalPath .
+
+ @return TRUE to indicate downloads have started, FALSE if they could not be
+         started.  On failure the caller should download packages as it
+         otherwise would have done.
+ */
+BOOL
+YoriPkgStartPrefetch(
+    __out PYORIPKG_PACKAGE_PREFETCH Prefetch,
+    __in_ecount(PackageCount) PCYORI_STRING PackagePaths,
+    __in DWORD PackageCount,
+    __in_opt PCYORI_STRING IniFilePath
+    )
+{
+    DWORD Index;
+    DWORD ThreadId;
+    DWORD ThreadsNeeded;
+
+    ZeroMemory(Prefetch, sizeof(YORIPKG_PACKAGE_PREFETCH));
+    YoriLibInitEmptyString(&Prefetch->IniFilePath);
+
+    if (PackageCount == 0) {
+        return FALSE;
+    }
+
+    //
+    //  Resolve WinInet here so the workers don't race to load it.
+    //
+
+    YoriLibLoadWinInetFunctions();
+
+    if (IniFilePath != NULL) {
+        if (!YoriLibCopyString(&Prefetch->IniFilePath, IniFilePath)) {
+            return FALSE;
+        }
+    }
+
+    Prefetch->Packages = YoriLibMalloc(PackageCount * sizeof(YORIPKG_PREFETCHED_PACKAGE));
+    if (Prefetch->Packages == NULL) {
+        YoriPkgCleanupPrefetch(Prefetch);
+        return FALSE;
+    }
+    ZeroMemory(Prefetch->Packages, PackageCount * sizeof(YORIPKG_PREFETCHED_PACKAGE));
+
+    for (Index = 0; Index < PackageCount; Index++) {
+        YoriLibInitEmptyString(&Prefetch->Packages[Index].PackagePath);
+        YoriLibInitEmptyString(&Prefetch->Packages[Index].LocalPath);
+    }
+
+    for (Index = 0; Index < PackageCount; Index++) {
+        if (!YoriLibCopyString(&Prefetch->Packages[Index].PackagePath, &PackagePaths[Index])) {
+            break;
+        }
+        Prefetch->Packages[Index].CompleteEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if (Prefetch->Packages[Index].CompleteEvent == NULL) {
+            YoriLibFreeStringContents(&Prefetch->Packages[Index].PackagePath);
+            break;
+        }
+    }
+
+    Prefetch->PackageCount = Index;
+    if (Prefetch->PackageCount != PackageCount) {
+        YoriPkgCleanupPrefetch(Prefetch);
+        return FALSE;
+    }
+
+    ThreadsNeeded = PackageCount;
+    if (ThreadsNeeded > YORIPKG_MAX_CONCURRENT_DOWNLOADS) {
+        ThreadsNeeded = YORIPKG_MAX_CONCURRENT_DOWNLOADS;
+    }
+
+    for (Index = 0; Index < ThreadsNeeded; Index++) {
+        Prefetch->Threads[Prefetch->ThreadCount] = CreateThread(NULL, 0, YoriPkgPrefetchWorker, Prefetch, 0, &ThreadId);
+        if (Prefetch->Threads[Prefetch->ThreadCount] == NULL) {
+            break;
+        }
+        Prefetch->ThreadCount++;
+    }
+
+    //
+    //  If no worker could be created, nothing would ever complete, so
+    //  give up on the prefetch.  Fewer workers than requested is fine.
+    //
+
+    if (Prefetch->ThreadCount == 0) {
+        YoriPkgCleanupPrefetch(Prefetch);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Find a package in a prefetch set, wait for its download to complete, and
+ take ownership of the result.
+
+ @param Prefetch Pointer to the prefetch set.
+
+ @param PackagePath Pointer to the package path or URL to find.
+
+ @param LocalPath On successful completion, populated with the local path
+        to the package.  Only meaningful if Error is ERROR_SUCCESS.
+
+ @param DeleteWhenFinished On successful completion, set to TRUE to indicate
+        the caller should delete the file when finished with it.  Only
+        meaningful if Error is ERROR_SUCCESS.
+
+ @param Error On successful completion, set to the result of downloading the
+        package.
+
+ @return TRUE to indicate the package was found in the prefetch set, FALSE
+         if it was not and the caller should download it directly.
+ */
+BOOL
+YoriPkgTakePrefetchedPackage(
+    __in PYORIPKG_PACKAGE_PREFETCH Prefetch,
+    __in PCYORI_STRING PackagePath,
+    __out PYORI_STRING LocalPath,
+    __out PBOOLEAN DeleteWhenFinished,
+    __out PDWORD Error
+    )
+{
+    DWORD Index;
+    PYORIPKG_PREFETCHED_PACKAGE Package;
+
+    for (Index = 0; Index < Prefetch->PackageCount; Index++) {
+        Package = &Prefetch->Packages[Index];
+        if (!Package->Taken &&
+            YoriLibCompareString(&Package->PackagePath, PackagePath) == 0) {
+
+            WaitForSingleObject(Package->CompleteEvent, INFINITE);
+            Package->Taken = TRUE;
+            *Error = Package->Error;
+            if (Package->Error == ERROR_SUCCESS) {
+                memcpy(LocalPath, &Package->LocalPath, sizeof(YORI_STRING));
+                *DeleteWhenFinished = Package->DeleteWhenFinished;
+                YoriLibInitEmptyString(&Package->LocalPath);
+            }
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Stop any downloads in a prefetch set that have not started, wait for any
+ that are in progress, and delete any downloaded packages which the caller
+ did not take.
+
+ @param Prefetch Pointer to the prefetch set to clean up.
+ */
+VOID
+YoriPkgCleanupPrefetch(
+    __inout PYORIPKG_PACKAGE_PREFETCH Prefetch
+    )
+{
+    DWORD Index;
+    PYORIPKG_PREFETCHED_PACKAGE Package;
+
+    InterlockedExchange((INTERLOCKED_VOLATILE LONG *)&Prefetch->NextPackage, (LONG)Prefetch->PackageCount);
+
+    if (Prefetch->ThreadCount > 0) {
+        WaitForMultipleObjects(Prefetch->ThreadCount, Prefetch->Threads, TRUE, INFINITE);
+        for (Index = 0; Index < Prefetch->ThreadCount; Index++) {
+            CloseHandle(Prefetch->Threads[Index]);
+        }
+        Prefetch->ThreadCount = 0;
+    }
+
+    if (Prefetch->Packages != NULL) {
+        for (Index = 0; Index < Prefetch->PackageCount; Index++) {
+            Package = &Prefetch->Packages[Index];
+            if (!Package->Taken &&
+                Package->Error == ERROR_SUCCESS &&
+                Package->DeleteWhenFinished &&
+                Package->LocalPath.StartOfString != NULL) {
+
+                DeleteFile(Package->LocalPath.StartOfString);
+            }
+            YoriLibFreeStringContents(&Package->LocalPath);
+            YoriLibFreeStringContents(&Package->PackagePath);
+            if (Package->CompleteEvent != NULL) {
+                CloseHandle(Package->CompleteEvent);
+            }
+        }
+        YoriLibFree(Prefetch->Packages);
+        Prefetch->Packages = NULL;
+    }
+
+    Prefetch->PackageCount = 0;
+    YoriLibFreeStringContents(&Prefetch->IniFilePath);
+}
+
 /**
  Display the best available error text given an installation failure with the
  specified Win32 error code.
@@ -151,6 +151,94 @@ typedef struct _YORIPKG_EXISTING_FILE {
     YORI_STRING RelativeFileName;
 } YORIPKG_EXISTING_FILE, *PYORIPKG_EXISTING_FILE;
 
+/**
+ The maximum number of packages to download concurrently.
+ */
+#define YORIPKG_MAX_CONCURRENT_DOWNLOADS (4)
+
+/**
+ A single package being downloaded ahead of the point where it is needed.
+ */
+typedef struct _YORIPKG_PREFETCHED_PACKAGE {
+
+    /**
+     The path to the package as specified by the caller.  This is used to
+     find the package when it is needed, and is a private copy so worker
+     threads don't share allocations with the caller.
+     */
+    YORI_STRING PackagePath;
+
+    /**
+     On completion, the local path containing the package.
+     */
+    YORI_STRING LocalPath;
+
+    /**
+     An event which is signalled when the download has completed, either
+     successfully or not.
+     */
+    HANDLE CompleteEvent;
+
+    /**
+     On completion, the Win32 error from downloading the package.
+     */
+    DWORD Error;
+
+    /**
+     On successful completion, TRUE if LocalPath refers to a temporary file
+     which should be deleted when no longer needed.
+     */
+    BOOLEAN DeleteWhenFinished;
+
+    /**
+     TRUE if the caller has taken the result of this download.  Once taken,
+     the caller is responsible for the local file.
+     */
+    BOOLEAN Taken;
+
+} YORIPKG_PREFETCHED_PACKAGE, *PYORIPKG_PREFETCHED_PACKAGE;
+
+/**
+ A set of packages being downloaded concurrently by a set of worker threads.
+ Packages are claimed by workers in order, so the caller can consume them in
+ order as each arrives.
+ */
+typedef struct _YORIPKG_PACKAGE_PREFETCH {
+
+    /**
+     An array of packages to download.
+     */
+    PYORIPKG_PREFETCHED_PACKAGE Packages;
+
+    /**
+     The number of elements in the Packages array.
+     */
+    DWORD PackageCount;
+
+    /**
+     The index of the next package for a worker to claim.  When this is
+     greater than or equal to PackageCount, workers exit.
+     */
+    LONG NextPackage;
+
+    /**
+     Optionally points to the INI file used to find mirrors for packages.
+     This is a private copy for the same reason as PackagePath.
+     */
+    YORI_STRING IniFilePath;
+
+    /**
+     The number of elements in the Threads array that have been created.
+     */
+    DWORD ThreadCount;
+
+    /**
+     Handles to worker threads.
+     */
+    HANDLE Threads[YORIPKG_MAX_CONCURRENT_DOWNLOADS];
+
+} YORIPKG_PACKAGE_PREFETCH, *PYORIPKG_PACKAGE_PREFETCH;
+
 /**
  A list of packages awaiting installation.  These have been downloaded and
  parsed, and any existing packages that conflict with the new packages have
@@ -188,6 +276,13 @@ typedef struct _YORIPKG_PACKAGES_PENDING_INSTALL {
      */
     PYORI_HASH_TABLE ExistingFilesTable;
 
+    /**
+     Optionally points to a set of packages being downloaded ahead of being
+     prepared for installation.  If a package being prepared is found here,
+     the downloaded copy is used rather than downloading it again.
+     */
+    PYORIPKG_PACKAGE_PREFETCH Prefetch;
+
 } YORIPKG_PACKAGES_PENDING_INSTALL, *PYORIPKG_PACKAGES_PENDING_INSTALL;
 
 /**
@@ -376,6 +471,37 @@ YoriPkgPackagePathToLocalPath(
     __out PBOOLEAN DeleteWhenFinished
     );
 
+__success(return == ERROR_SUCCESS)
+DWORD
+YoriPkgSourcePathToLocalPath(
+    __in PYORI_STRING SourcePath,
+    __in_opt PCYORI_STRING IniFilePath,
+    __out PYORI_STRING LocalPath,
+    __out PBOOLEAN DeleteWhenFinished
+    );
+
+BOOL
+YoriPkgStartPrefetch(
+    __out PYORIPKG_PACKAGE_PREFETCH Prefetch,
+    __in_ecount(PackageCount) PCYORI_STRING PackagePaths,
+    __in DWORD PackageCount,
+    __in_opt PCYORI_STRING IniFilePath
+    );
+
+BOOL
+YoriPkgTakePrefetchedPackage(
+    __in PYORIPKG_PACKAGE_PREFETCH Prefetch,
+    __in PCYORI_STRING PackagePath,
+    __out PYORI_STRING LocalPath,
+    __out PBOOLEAN DeleteWhenFinished,
+    __out PDWORD Error
+    );
+
+VOID
+YoriPkgCleanupPrefetch(
+    __inout PYORIPKG_PACKAGE_PREFETCH Prefetch
+    );
+
 __success(return)
 BOOL
 YoriPkgIsNewerVersionAvailable(
@@ -392,6 +518,13 @@ YoriPkgFreeAllSourcesAndPackages(
     __in_opt PYORI_LIST_ENTRY PackageList
     );
 
+BOOL
+YoriPkgPrefetchRemotePackages(
+    __in PYORI_LIST_ENTRY PackageList,
+    __in_opt PCYORI_STRING IniFilePath,
+    __out PYORIPKG_PACKAGE_PREFETCH Prefetch
+    );
+
 VOID
 YoriPkgDisplayErrorStringForInstallFailure(
     __in DWORD ErrorCode
@@ -3,7 +3,7 @@
  *
  * Yori shell child process statistics tool
  *
- * Copyright (c) 2019-2021 Malcolm J. Smith
+ * Copyright (c) 2019-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -38,9 +38,13 @@ CHAR strProcInfoHelpText[] =
         "\n"
         "Collects information about a running system process.\n"
         "\n"
-        "PROCINFO [-license] [-f <fmt>] [-h] <pid>\n"
+        "PROCINFO [-license] [-f <fmt>] [-h] [-w <ms>] <pid>\n"
         "\n"
         "   -h              Display handles opened within the process\n"
+        "   -w              Sample the process every <ms> milliseconds until it exits,\n"
+        "                     displaying CPU and IO usage as deltas since the previous\n"
+        "                     sample in CSV form.  Samples where nothing changed are\n"
+        "                     not displayed\n"
         "\n"
         "Format specifiers are:\n"
         "   $COMMIT$        Amount of Kb of memory committed by the process\n"
@@ -52,6 +56,7 @@ CHAR strProcInfoHelpText[] =
         "   $CPUUSERMS$     Amount of user time used by the process in ms\n"
         "   $ELAPSED$       Amount of time the process has been in the system\n"
         "   $ELAPSEDMS$     Amount of time the process has been in the system in ms\n"
+        "   $HANDLES$       Number of handles opened within the process\n"
         "   $OTHERIOBYTES$  Number of bytes transferred by other IO requests in the process\n"
         "   $OTHERIOCOUNT$  Number of other IO operations in the process\n"
         "   $READCOUNT$     Number of read operations generated by the process\n"
@@ -196,8 +201,81 @@ typedef struct _PROCINFO_CONTEXT {
      */
     YORI_IO_COUNTERS IoCounters;
 
+    /**
+     The number of handles opened within the process.
+     */
+    DWORD HandleCount;
+
 } PROCINFO_CONTEXT, *PPROCINFO_CONTEXT;
 
+/**
+ The information class to query the number of handles opened within a
+ process from NtQueryInformationProcess.
+ */
+#define PROCINFO_PROCESS_HANDLE_COUNT (20)
+
+/**
+ Collect the current usage of a process.
+
+ @param hProcess Handle to the process, opened for PROCESS_QUERY_INFORMATION.
+
+ @param ProcInfoContext On successful completion, populated with the usage
+        of the process.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+ProcInfoCaptureSample(
+    __in HANDLE hProcess,
+    __out PPROCINFO_CONTEXT ProcInfoContext
+    )
+{
+    FILETIME ftCreationTime;
+    FILETIME ftExitTime;
+    FILETIME ftKernelTime;
+    FILETIME ftUserTime;
+    LARGE_INTEGER liNow;
+    LARGE_INTEGER liCreationTime;
+    DWORD Status;
+    DWORD dwBytesReturned;
+
+    //
+    //  Save off times from the process.
+    //
+
+    GetProcessTimes(hProcess, &ftCreationTime, &ftExitTime, &ftKernelTime, &ftUserTime);
+    liCreationTime.HighPart = ftCreationTime.dwHighDateTime;
+    liCreationTime.LowPart = ftCreationTime.dwLowDateTime;
+    ProcInfoContext->KernelTimeInMs.HighPart = ftKernelTime.dwHighDateTime;
+    ProcInfoContext->KernelTimeInMs.LowPart = ftKernelTime.dwLowDateTime;
+    ProcInfoContext->KernelTimeInMs.QuadPart = ProcInfoContext->KernelTimeInMs.QuadPart / (10 * 1000);
+    ProcInfoContext->UserTimeInMs.HighPart = ftUserTime.dwHighDateTime;
+    ProcInfoContext->UserTimeInMs.LowPart = ftUserTime.dwLowDateTime;
+    ProcInfoContext->UserTimeInMs.QuadPart = ProcInfoContext->UserTimeInMs.QuadPart / (10 * 1000);
+
+    liNow.QuadPart = YoriLibGetSystemTimeAsInteger();
+
+    ProcInfoContext->ElapsedTimeInMs.QuadPart = (liNow.QuadPart - liCreationTime.QuadPart) / (10 * 1000);
+
+    if (DllNtDll.pNtQueryInformationProcess != NULL) {
+        Status = DllNtDll.pNtQueryInformationProcess(hProcess, ProcessVmCounters, &ProcInfoContext->VmInfo, sizeof(ProcInfoContext->VmInfo), &dwBytesReturned);
+        if (Status != 0) {
+            return FALSE;
+        }
+
+        Status = DllNtDll.pNtQueryInformationProcess(hProcess, PROCINFO_PROCESS_HANDLE_COUNT, &ProcInfoContext->HandleCount, sizeof(ProcInfoContext->HandleCount), &dwBytesReturned);
+        if (Status != 0) {
+            ProcInfoContext->HandleCount = 0;
+        }
+    }
+
+    if (DllKernel32.pGetProcessIoCounters != NULL) {
+        DllKernel32.pGetProcessIoCounters(hProcess, &ProcInfoContext->IoCounters);
+    }
+
+    return TRUE;
+}
+
 /**
  A callback function to expand any known variables found when parsing the
  format string.
@@ -247,6 +325,9 @@ ProcInfoExpandVariables(
         return ProcInfoOutputTimestamp(ProcInfoContext->ElapsedTimeInMs, OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("ELAPSEDMS")) == 0) {
         return ProcInfoOutputLargeInteger(ProcInfoContext->ElapsedTimeInMs, 10, OutputBuffer);
+    } else if (YoriLibCompareStringLit(VariableName, _T("HANDLES")) == 0) {
+        IoCount.QuadPart = ProcInfoContext->HandleCount;
+        return ProcInfoOutputLargeInteger(IoCount, 10, OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("OTHERIOBYTES")) == 0) {
         IoCount.QuadPart = ProcInfoContext->IoCounters.OtherBytes;
         return ProcInfoOutputLargeInteger(IoCount, 10, OutputBuffer);
@@ -368,6 +449,145 @@ ProcInfoDumpHandles(
     return TRUE;
 }
 
+/**
+ Construct a sample describing the change between two samples of a process.
+ Cumulative counters, being CPU time and IO, describe the difference between
+ the two samples.  Other values describe the current sample.
+
+ @param Current Pointer to the most recent sample.
+
+ @param Previous Pointer to the previous sample.
+
+ @param Delta On completion, populated with the change between the samples.
+
+ @return TRUE if any value changed between the samples, FALSE if none did.
+ */
+BOOLEAN
+ProcInfoBuildDelta(
+    __in PPROCINFO_CONTEXT Current,
+    __in PPROCINFO_CONTEXT Previous,
+    __out PPROCINFO_CONTEXT Delta
+    )
+{
+    memcpy(Delta, Current, sizeof(PROCINFO_CONTEXT));
+    Delta->KernelTimeInMs.QuadPart = Current->KernelTimeInMs.QuadPart - Previous->KernelTimeInMs.QuadPart;
+    Delta->UserTimeInMs.QuadPart = Current->UserTimeInMs.QuadPart - Previous->UserTimeInMs.QuadPart;
+    Delta->IoCounters.ReadOperations = Current->IoCounters.ReadOperations - Previous->IoCounters.ReadOperations;
+    Delta->IoCounters.WriteOperations = Current->IoCounters.WriteOperations - Previous->IoCounters.WriteOperations;
+    Delta->IoCounters.OtherOperations = Current->IoCounters.OtherOperations - Previous->IoCounters.OtherOperations;
+    Delta->IoCounters.ReadBytes = Current->IoCounters.ReadBytes - Previous->IoCounters.ReadBytes;
+    Delta->IoCounters.WriteBytes = Current->IoCounters.WriteBytes - Previous->IoCounters.WriteBytes;
+    Delta->IoCounters.OtherBytes = Current->IoCounters.OtherBytes - Previous->IoCounters.OtherBytes;
+
+    if (Delta->KernelTimeInMs.QuadPart != 0 ||
+        Delta->UserTimeInMs.QuadPart != 0 ||
+        Delta->IoCounters.ReadOperations != 0 ||
+        Delta->IoCounters.WriteOperations != 0 ||
+        Delta->IoCounters.OtherOperations != 0 ||
+        Current->VmInfo.CommitUsage != Previous->VmInfo.CommitUsage ||
+        Current->VmInfo.WorkingSetSize != Previous->VmInfo.WorkingSetSize ||
+        Current->HandleCount != Previous->HandleCount) {
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Periodically sample a process until it exits or the user cancels, and
+ display the change since the previous sample.  The first sample is
+ displayed in full to provide a baseline.
+
+ @param hProcess Handle to the process, opened for PROCESS_QUERY_INFORMATION
+        and SYNCHRONIZE.
+
+ @param Interval The interval between samples, in milliseconds.
+
+ @param FormatString Pointer to the format string to display for each
+        sample.
+
+ @param DisplayHeader If TRUE, the default format is in use, and a header
+        describing its columns is displayed before the first sample.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+ProcInfoWatch(
+    __in HANDLE hProcess,
+    __in DWORD Interval,
+    __in PYORI_STRING FormatString,
+    __in BOOLEAN DisplayHeader
+    )
+{
+    PROCINFO_CONTEXT Samples[2];
+    PROCINFO_CONTEXT Delta;
+    PPROCINFO_CONTEXT Current;
+    PPROCINFO_CONTEXT Previous;
+    YORI_STRING DisplayString;
+    HANDLE WaitHandles[2];
+    DWORD WaitHandleCount;
+    DWORD WaitResult;
+    BOOLEAN Display;
+
+    ZeroMemory(Samples, sizeof(Samples));
+    Current = &Samples[0];
+    Previous = NULL;
+
+    WaitHandles[0] = hProcess;
+    WaitHandleCount = 1;
+    WaitHandles[1] = YoriLibCancelGetEvent();
+    if (WaitHandles[1] != NULL) {
+        WaitHandleCount++;
+    }
+
+    if (DisplayHeader) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("ElapsedMs,KernelMs,UserMs,CommitKb,WorkingSetKb,Handles,ReadCount,ReadBytes,WriteCount,WriteBytes,OtherIoCount,OtherIoBytes\n"));
+    }
+
+    //
+    //  The display string is reused for each sample, so once it has grown
+    //  to fit a line no further allocations are needed.
+    //
+
+    YoriLibInitEmptyString(&DisplayString);
+    while (TRUE) {
+        if (!ProcInfoCaptureSample(hProcess, Current)) {
+            YoriLibFreeStringContents(&DisplayString);
+            return FALSE;
+        }
+
+        Display = TRUE;
+        if (Previous == NULL) {
+            memcpy(&Delta, Current, sizeof(PROCINFO_CONTEXT));
+        } else {
+            Display = ProcInfoBuildDelta(Current, Previous, &Delta);
+        }
+
+        if (Display) {
+            YoriLibExpandCommandVariables(FormatString, '$', ProcInfoExpandVariables, &Delta, &DisplayString);
+            if (DisplayString.StartOfString != NULL) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+            }
+        }
+
+        Previous = Current;
+        if (Current == &Samples[0]) {
+            Current = &Samples[1];
+        } else {
+            Current = &Samples[0];
+        }
+
+        WaitResult = WaitForMultipleObjects(WaitHandleCount, WaitHandles, FALSE, Interval);
+        if (WaitResult != WAIT_TIMEOUT) {
+            break;
+        }
+    }
+
+    YoriLibFreeStringContents(&DisplayString);
+    return TRUE;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the procinfo builtin command.
@@ -406,15 +626,10 @@ ENTRYPOINT(
     YORI_STRING DisplayString;
     YORI_STRING AllocatedFormatString;
     PROCINFO_CONTEXT ProcInfoContext;
-    FILETIME ftCreationTime;
-    FILETIME ftExitTime;
-    FILETIME ftKernelTime;
-    FILETIME ftUserTime;
-    LARGE_INTEGER liNow;
     HANDLE hProcess;
     BOOLEAN DumpHandles;
-
-    LARGE_INTEGER liCreationTime;
+    BOOLEAN FormatSpecified;
+    DWORD WatchInterval;
 
     LPTSTR DefaultFormatString = 
                                  _T("Commit size:     $COMMIT$ Kb\n")
@@ -425,6 +640,8 @@ ENTRYPOINT(
                                  _T("Working set:     $WORKINGSET$ Kb\n");
 
     DumpHandles = FALSE;
+    FormatSpecified = FALSE;
+    WatchInterval = 0;
     YoriLibInitEmptyString(&AllocatedFormatString);
     YoriLibConstantString(&AllocatedFormatString, DefaultFormatString);
     ZeroMemory(&ProcInfoContext, sizeof(ProcInfoContext));
@@ -440,18 +657,32 @@ ENTRYPOINT(
                 ProcInfoHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2019-2021"));
+                YoriLibDisplayMitLicense(_T("2019-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("f")) == 0) {
                 if (ArgC > i + 1) {
                     YoriLibFreeStringContents(&AllocatedFormatString);
                     YoriLibCloneString(&AllocatedFormatString, &ArgV[i + 1]);
+                    FormatSpecified = TRUE;
                     ArgumentUnderstood = TRUE;
                     i++;
                 }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("h")) == 0) {
                 DumpHandles = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("w")) == 0) {
+                if (ArgC > i + 1) {
+                    if (!YoriLibStringToNumber(&ArgV[i + 1], FALSE, &llTemp, &CharsConsumed) ||
+                        CharsConsumed == 0 ||
+                        llTemp <= 0) {
+
+                        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("procinfo: could not parse interval\n"));
+                        return EXIT_FAILURE;
+                    }
+                    WatchInterval = (DWORD)llTemp;
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
             }
         } else {
             ArgumentUnderstood = TRUE;
@@ -496,7 +727,15 @@ ENTRYPOINT(
         return EXIT_SUCCESS;
     }
 
-    hProcess = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, Pid);
+    if (WatchInterval != 0 && !FormatSpecified) {
+        YoriLibConstantString(&AllocatedFormatString, _T("$ELAPSEDMS$,$CPUKERNELMS$,$CPUUSERMS$,$COMMIT$,$WORKINGSET$,$HANDLES$,$READCOUNT$,$READBYTES$,$WRITECOUNT$,$WRITEBYTES$,$OTHERIOCOUNT$,$OTHERIOBYTES$\n"));
+    }
+
+    if (WatchInterval != 0) {
+        hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | SYNCHRONIZE, FALSE, Pid);
+    } else {
+        hProcess = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, Pid);
+    }
     if (hProcess == NULL) {
         DWORD LastError = GetLastError();
         LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
@@ -505,36 +744,23 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
-    //
-    //  Save off times from the process.
-    //
-
-    GetProcessTimes(hProcess, &ftCreationTime, &ftExitTime, &ftKernelTime, &ftUserTime);
-    liCreationTime.HighPart = ftCreationTime.dwHighDateTime;
-    liCreationTime.LowPart = ftCreationTime.dwLowDateTime;
-    ProcInfoContext.KernelTimeInMs.HighPart = ftKernelTime.dwHighDateTime;
-    ProcInfoContext.KernelTimeInMs.LowPart = ftKernelTime.dwLowDateTime;
-    ProcInfoContext.KernelTimeInMs.QuadPart = ProcInfoContext.KernelTimeInMs.QuadPart / (10 * 1000);
-    ProcInfoContext.UserTimeInMs.HighPart = ftUserTime.dwHighDateTime;
-    ProcInfoContext.UserTimeInMs.LowPart = ftUserTime.dwLowDateTime;
-    ProcInfoContext.UserTimeInMs.QuadPart = ProcInfoContext.UserTimeInMs.QuadPart / (10 * 1000);
-
-    liNow.QuadPart = YoriLibGetSystemTimeAsInteger();
-
-    ProcInfoContext.ElapsedTimeInMs.QuadPart = (liNow.QuadPart - liCreationTime.QuadPart) / (10 * 1000);
-
-    if (DllNtDll.pNtQueryInformationProcess != NULL) {
-        DWORD Status;
-        DWORD dwBytesReturned;
-        Status = DllNtDll.pNtQueryInformationProcess(hProcess, ProcessVmCounters, &ProcInfoContext.VmInfo, sizeof(ProcInfoContext.VmInfo), &dwBytesReturned);
-        if (Status != 0) {
+    if (WatchInterval != 0) {
+#if YORI_BUILTIN
+        YoriLibCancelEnable(FALSE);
+#endif
+        if (!ProcInfoWatch(hProcess, WatchInterval, &AllocatedFormatString, !FormatSpecified)) {
             CloseHandle(hProcess);
-            return FALSE;
+            YoriLibFreeStringContents(&AllocatedFormatString);
+            return EXIT_FAILURE;
         }
+        CloseHandle(hProcess);
+        YoriLibFreeStringContents(&AllocatedFormatString);
+        return EXIT_SUCCESS;
     }
 
-    if (DllKernel32.pGetProcessIoCounters != NULL) {
-        DllKernel32.pGetProcessIoCounters(hProcess, &ProcInfoContext.IoCounters);
+    if (!ProcInfoCaptureSample(hProcess, &ProcInfoContext)) {
+        CloseHandle(hProcess);
+        return FALSE;
     }
 
     CloseHandle(hProcess);
@@ -35,11 +35,13 @@ CHAR strPsHelpText[] =
         "\n"
         "Display process list.\n"
         "\n"
-        "PS [-license] [-a] [-f] [-l]\n"
+        "PS [-license] [-a] [-f] [-l] [-w <interval>]\n"
         "\n"
         "   -a             Display all processes\n"
         "   -f             Display full format including command line\n"
-        "   -l             Display long format including memory usage\n";
+        "   -l             Display long format including memory usage\n"
+        "   -w             Continuously display activity of all processes, refreshing\n"
+        "                   every interval seconds\n";
 
 /**
  Display usage text to the user.
@@ -501,6 +503,670 @@ PsDisplayConsoleProcesses(
     return TRUE;
 }
 
+/**
+ Information about a single process captured from one sample of the process
+ list, along with how it changed since the previous sample.
+ */
+typedef struct _PS_SAMPLE {
+
+    /**
+     The process identifier.
+     */
+    DWORD_PTR ProcessId;
+
+    /**
+     The time the process was created.  This is used along with the process
+     identifier to detect identifier reuse between samples.
+     */
+    LARGE_INTEGER CreateTime;
+
+    /**
+     The total kernel and user time consumed by the process.
+     */
+    DWORDLONG ExecuteTime;
+
+    /**
+     The total number of bytes transferred by the process.
+     */
+    DWORDLONG TransferCount;
+
+    /**
+     The number of bytes in the working set of the process.
+     */
+    SIZE_T WorkingSetSize;
+
+    /**
+     Pointer to the entry in the current process list.  This is only valid
+     for the most recent sample.
+     */
+    PYORI_SYSTEM_PROCESS_INFORMATION ProcessInfo;
+
+    /**
+     The processor usage since the previous sample, in tenths of a percent
+     of all processors.
+     */
+    DWORD CpuTenthsOfPercent;
+
+    /**
+     The number of bytes transferred per second since the previous sample.
+     */
+    DWORDLONG TransferPerSecond;
+
+    /**
+     The change in working set size since the previous sample.
+     */
+    LONGLONG WorkingSetDelta;
+
+} PS_SAMPLE, *PPS_SAMPLE;
+
+/**
+ State for continuously displaying process activity.
+ */
+typedef struct _PS_LIVE_CONTEXT {
+
+    /**
+     The buffer containing the most recent process list.  This is reused
+     across samples and only reallocated if it is too small.
+     */
+    PYORI_SYSTEM_PROCESS_INFORMATION ProcessInfo;
+
+    /**
+     The number of bytes allocated in ProcessInfo.
+     */
+    YORI_ALLOC_SIZE_T ProcessInfoLength;
+
+    /**
+     An array of samples describing the most recent process list.
+     */
+    PPS_SAMPLE Samples;
+
+    /**
+     An array of samples describing the previous process list.
+     */
+    PPS_SAMPLE PreviousSamples;
+
+    /**
+     An array of pointers to entries in Samples, sorted for display.
+     */
+    PPS_SAMPLE *SortedSamples;
+
+    /**
+     The number of entries allocated in Samples and SortedSamples.
+     */
+    DWORD SamplesAllocated;
+
+    /**
+     The number of entries allocated in PreviousSamples.
+     */
+    DWORD PreviousSamplesAllocated;
+
+    /**
+     The number of valid entries in Samples.
+     */
+    DWORD SampleCount;
+
+    /**
+     The number of valid entries in PreviousSamples.
+     */
+    DWORD PreviousSampleCount;
+
+    /**
+     The system time when the most recent sample was captured.
+     */
+    LONGLONG SampleTime;
+
+    /**
+     The number of processors in the system.
+     */
+    DWORD ProcessorCount;
+
+    /**
+     TRUE if output is to a console and rows can be redrawn in place.  FALSE
+     if each sample should be written in full.
+     */
+    BOOLEAN ConsoleMode;
+
+    /**
+     The console location of the first displayed row.
+     */
+    COORD Origin;
+
+    /**
+     The number of rows to display, including the header.
+     */
+    WORD RowCount;
+
+    /**
+     The number of characters in each displayed row.
+     */
+    WORD RowWidth;
+
+    /**
+     An array of RowCount strings containing the text currently displayed
+     on each row of the console.
+     */
+    PYORI_STRING DisplayedRows;
+
+    /**
+     A buffer used to construct the text of a row.
+     */
+    YORI_STRING RowBuffer;
+
+} PS_LIVE_CONTEXT, *PPS_LIVE_CONTEXT;
+
+/**
+ Capture a new sample of the process list and calculate the change of each
+ process since the previous sample.
+
+ @param LiveContext Pointer to the live context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+PsLiveCaptureSample(
+    __inout PPS_LIVE_CONTEXT LiveContext
+    )
+{
+    PYORI_SYSTEM_PROCESS_INFORMATION CurrentEntry;
+    PPS_SAMPLE Sample;
+    PPS_SAMPLE PreviousSample;
+    PPS_SAMPLE SwapSamples;
+    DWORD SwapAllocated;
+    DWORD Count;
+    DWORD Index;
+    DWORD PreviousIndex;
+    DWORD SearchCount;
+    LONGLONG Now;
+    LONGLONG Elapsed;
+    DWORDLONG Delta;
+
+    if (!YoriLibUpdateSystemProcessList(&LiveContext->ProcessInfo, &LiveContext->ProcessInfoLength)) {
+        return FALSE;
+    }
+    Now = YoriLibGetSystemTimeAsInteger();
+
+    //
+    //  The current samples become the previous samples, and the previous
+    //  allocation is reused for the new samples.
+    //
+
+    SwapSamples = LiveContext->PreviousSamples;
+    SwapAllocated = LiveContext->PreviousSamplesAllocated;
+    LiveContext->PreviousSamples = LiveContext->Samples;
+    LiveContext->PreviousSamplesAllocated = LiveContext->SamplesAllocated;
+    LiveContext->PreviousSampleCount = LiveContext->SampleCount;
+    LiveContext->Samples = SwapSamples;
+    LiveContext->SamplesAllocated = SwapAllocated;
+    LiveContext->SampleCount = 0;
+
+    Count = 0;
+    CurrentEntry = LiveContext->ProcessInfo;
+    do {
+        Count++;
+        if (CurrentEntry->NextEntryOffset == 0) {
+            break;
+        }
+        CurrentEntry = YoriLibAddToPointer(CurrentEntry, CurrentEntry->NextEntryOffset);
+    } while(TRUE);
+
+    if (Count > LiveContext->SamplesAllocated) {
+        if (LiveContext->Samples != NULL) {
+            YoriLibFree(LiveContext->Samples);
+            LiveContext->Samples = NULL;
+        }
+        if (LiveContext->SortedSamples != NULL) {
+            YoriLibFree(LiveContext->SortedSamples);
+            LiveContext->SortedSamples = NULL;
+        }
+        LiveContext->SamplesAllocated = 0;
+
+        Count = Count + 64;
+        if (!YoriLibIsSizeAllocatable(Count * sizeof(PS_SAMPLE))) {
+            return FALSE;
+        }
+        LiveContext->Samples = YoriLibMalloc(Count * sizeof(PS_SAMPLE));
+        if (LiveContext->Samples == NULL) {
+            return FALSE;
+        }
+        LiveContext->SortedSamples = YoriLibMalloc(Count * sizeof(PPS_SAMPLE));
+        if (LiveContext->SortedSamples == NULL) {
+            return FALSE;
+        }
+        LiveContext->SamplesAllocated = Count;
+    }
+
+    Elapsed = Now - LiveContext->SampleTime;
+    LiveContext->SampleTime = Now;
+
+    Index = 0;
+    CurrentEntry = LiveContext->ProcessInfo;
+    do {
+        Sample = &LiveContext->Samples[Index];
+        ZeroMemory(Sample, sizeof(PS_SAMPLE));
+        Sample->ProcessId = CurrentEntry->ProcessId;
+        Sample->CreateTime.QuadPart = CurrentEntry->CreateTime.QuadPart;
+        Sample->ExecuteTime = (DWORDLONG)(CurrentEntry->KernelTime.QuadPart + CurrentEntry->UserTime.QuadPart);
+        Sample->TransferCount = (DWORDLONG)(CurrentEntry->ReadTransferCount.QuadPart +
+                                            CurrentEntry->WriteTransferCount.QuadPart +
+                                            CurrentEntry->OtherTransferCount.QuadPart);
+        Sample->WorkingSetSize = CurrentEntry->WorkingSetSize;
+        Sample->ProcessInfo = CurrentEntry;
+
+        //
+        //  The system returns processes in a consistent order, so the
+        //  process is usually at the same index as last time or slightly
+        //  before it if earlier processes have exited.  Check there first
+        //  and scan from there if it isn't found.
+        //
+
+        PreviousSample = NULL;
+        if (LiveContext->PreviousSampleCount > 0) {
+            PreviousIndex = Index;
+            if (PreviousIndex >= LiveContext->PreviousSampleCount) {
+                PreviousIndex = LiveContext->PreviousSampleCount - 1;
+            }
+            for (SearchCount = 0; SearchCount < LiveContext->PreviousSampleCount; SearchCount++) {
+                if (LiveContext->PreviousSamples[PreviousIndex].ProcessId == Sample->ProcessId &&
+                    LiveContext->PreviousSamples[PreviousIndex].CreateTime.QuadPart == Sample->CreateTime.QuadPart) {
+
+                    PreviousSample = &LiveContext->PreviousSamples[PreviousIndex];
+                    break;
+                }
+                PreviousIndex++;
+                if (PreviousIndex == LiveContext->PreviousSampleCount) {
+                    PreviousIndex = 0;
+                }
+            }
+        }
+
+        if (PreviousSample != NULL && Elapsed > 0) {
+            if (Sample->ExecuteTime > PreviousSample->ExecuteTime) {
+                Delta = Sample->ExecuteTime - PreviousSample->ExecuteTime;
+                Delta = Delta * 1000 / ((DWORDLONG)Elapsed * LiveContext->ProcessorCount);
+                if (Delta > 1000) {
+                    Delta = 1000;
+                }
+                Sample->CpuTenthsOfPercent = (DWORD)Delta;
+            }
+            if (Sample->TransferCount > PreviousSample->TransferCount) {
+                Delta = Sample->TransferCount - PreviousSample->TransferCount;
+                Sample->TransferPerSecond = Delta * 10 * 1000 * 1000 / (DWORDLONG)Elapsed;
+            }
+            Sample->WorkingSetDelta = (LONGLONG)Sample->WorkingSetSize - (LONGLONG)PreviousSample->WorkingSetSize;
+        }
+
+        LiveContext->SortedSamples[Index] = Sample;
+        Index++;
+
+        if (CurrentEntry->NextEntryOffset == 0) {
+            break;
+        }
+        CurrentEntry = YoriLibAddToPointer(CurrentEntry, CurrentEntry->NextEntryOffset);
+    } while(TRUE);
+
+    LiveContext->SampleCount = Index;
+    return TRUE;
+}
+
+/**
+ Sort the samples for display, with the processes consuming the most
+ processor time first, followed by those performing the most I/O.
+
+ @param LiveContext Pointer to the live context.
+ */
+VOID
+PsLiveSortSamples(
+    __inout PPS_LIVE_CONTEXT LiveContext
+    )
+{
+    PPS_SAMPLE *Sorted;
+    PPS_SAMPLE Sample;
+    DWORD Index;
+    DWORD InsertIndex;
+
+    //
+    //  Most processes are idle and compare equal, and the list is
+    //  typically a few hundred entries, so an insertion sort is cheap.
+    //
+
+    Sorted = LiveContext->SortedSamples;
+    for (Index = 1; Index < LiveContext->SampleCount; Index++) {
+        Sample = Sorted[Index];
+        InsertIndex = Index;
+        while (InsertIndex > 0) {
+            if (Sorted[InsertIndex - 1]->CpuTenthsOfPercent > Sample->CpuTenthsOfPercent) {
+                break;
+            }
+            if (Sorted[InsertIndex - 1]->CpuTenthsOfPercent == Sample->CpuTenthsOfPercent &&
+                Sorted[InsertIndex - 1]->TransferPerSecond >= Sample->TransferPerSecond) {
+                break;
+            }
+            Sorted[InsertIndex] = Sorted[InsertIndex - 1];
+            InsertIndex--;
+        }
+        Sorted[InsertIndex] = Sample;
+    }
+}
+
+/**
+ Generate the text for a single row of live output into the row buffer.
+
+ @param LiveContext Pointer to the live context.
+
+ @param Sample Pointer to the sample to display, or NULL to generate the
+        header.
+ */
+VOID
+PsLiveFormatRow(
+    __inout PPS_LIVE_CONTEXT LiveContext,
+    __in_opt PPS_SAMPLE Sample
+    )
+{
+    PYORI_STRING Row;
+    YORI_STRING BaseName;
+    YORI_STRING TransferString;
+    YORI_STRING WorkingSetString;
+    YORI_STRING DeltaString;
+    TCHAR TransferStringBuffer[6];
+    TCHAR WorkingSetStringBuffer[6];
+    TCHAR DeltaStringBuffer[6];
+    LARGE_INTEGER Value;
+    TCHAR DeltaSign;
+
+    Row = &LiveContext->RowBuffer;
+    if (Sample == NULL) {
+        Row->LengthInChars = YoriLibSPrintfS(Row->StartOfString, Row->LengthAllocated, _T("  Pid  | Parent | CPU%%  | IO/s   | WorkingSet | WS Change  | Process"));
+        return;
+    }
+
+    YoriLibInitEmptyString(&BaseName);
+    BaseName.StartOfString = Sample->ProcessInfo->ImageName;
+    BaseName.LengthInChars = Sample->ProcessInfo->ImageNameLengthInBytes / sizeof(WCHAR);
+
+    if (BaseName.LengthInChars == 0 && Sample->ProcessId == 0) {
+        YoriLibConstantString(&BaseName, _T("Idle"));
+    }
+
+    YoriLibInitEmptyString(&TransferString);
+    TransferString.StartOfString = TransferStringBuffer;
+    TransferString.LengthAllocated = sizeof(TransferStringBuffer)/sizeof(TransferStringBuffer[0]);
+    Value.QuadPart = Sample->TransferPerSecond;
+    YoriLibFileSizeToString(&TransferString, &Value);
+
+    YoriLibInitEmptyString(&WorkingSetString);
+    WorkingSetString.StartOfString = WorkingSetStringBuffer;
+    WorkingSetString.LengthAllocated = sizeof(WorkingSetStringBuffer)/sizeof(WorkingSetStringBuffer[0]);
+    Value.QuadPart = Sample->WorkingSetSize;
+    YoriLibFileSizeToString(&WorkingSetString, &Value);
+
+    YoriLibInitEmptyString(&DeltaString);
+    DeltaString.StartOfString = DeltaStringBuffer;
+    DeltaString.LengthAllocated = sizeof(DeltaStringBuffer)/sizeof(DeltaStringBuffer[0]);
+    DeltaSign = ' ';
+    Value.QuadPart = Sample->WorkingSetDelta;
+    if (Value.QuadPart < 0) {
+        DeltaSign = '-';
+        Value.QuadPart = -Value.QuadPart;
+    } else if (Value.QuadPart > 0) {
+        DeltaSign = '+';
+    }
+    YoriLibFileSizeToString(&DeltaString, &Value);
+
+    Row->LengthInChars = YoriLibSPrintfS(Row->StartOfString,
+                                         Row->LengthAllocated,
+                                         _T("%-6i | %-6i | %3i.%i | %-6y | %-10y | %c%-9y | %y"),
+                                         Sample->ProcessId,
+                                         Sample->ProcessInfo->ParentProcessId,
+                                         Sample->CpuTenthsOfPercent / 10,
+                                         Sample->CpuTenthsOfPercent % 10,
+                                         &TransferString,
+                                         &WorkingSetString,
+                                         DeltaSign,
+                                         &DeltaString,
+                                         &BaseName);
+}
+
+/**
+ Display the most recent sample.  When displaying to a console, only rows
+ whose text differs from what is already displayed are redrawn.  Otherwise
+ every process is written in full.
+
+ @param LiveContext Pointer to the live context.
+ */
+VOID
+PsLiveDisplaySample(
+    __inout PPS_LIVE_CONTEXT LiveContext
+    )
+{
+    PYORI_STRING Row;
+    PYORI_STRING DisplayedRow;
+    COORD Position;
+    DWORD Index;
+
+    Row = &LiveContext->RowBuffer;
+
+    if (!LiveContext->ConsoleMode) {
+        PsLiveFormatRow(LiveContext, NULL);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), Row);
+        for (Index = 0; Index < LiveContext->SampleCount; Index++) {
+            PsLiveFormatRow(LiveContext, LiveContext->SortedSamples[Index]);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), Row);
+        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+        return;
+    }
+
+    for (Index = 0; Index < LiveContext->RowCount; Index++) {
+        if (Index == 0) {
+            PsLiveFormatRow(LiveContext, NULL);
+        } else if (Index <= LiveContext->SampleCount) {
+            PsLiveFormatRow(LiveContext, LiveContext->SortedSamples[Index - 1]);
+        } else {
+            Row->LengthInChars = 0;
+        }
+
+        //
+        //  Pad each row to the full width so that redrawing a row
+        //  overwrites anything that was there before.
+        //
+
+        while (Row->LengthInChars < LiveContext->RowWidth) {
+            Row->StartOfString[Row->LengthInChars] = ' ';
+            Row->LengthInChars++;
+        }
+
+        DisplayedRow = &LiveContext->DisplayedRows[Index];
+        if (YoriLibCompareString(Row, DisplayedRow) == 0) {
+            continue;
+        }
+
+        Position.X = LiveContext->Origin.X;
+        Position.Y = (SHORT)(LiveContext->Origin.Y + Index);
+        SetConsoleCursorPosition(GetStdHandle(STD_OUTPUT_HANDLE), Position);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), Row);
+
+        memcpy(DisplayedRow->StartOfString, Row->StartOfString, Row->LengthInChars * sizeof(TCHAR));
+        DisplayedRow->LengthInChars = Row->LengthInChars;
+    }
+
+    Position.X = LiveContext->Origin.X;
+    Position.Y = (SHORT)(LiveContext->Origin.Y + LiveContext->RowCount);
+    SetConsoleCursorPosition(GetStdHandle(STD_OUTPUT_HANDLE), Position);
+}
+
+/**
+ Prepare to redraw rows in place if output is to a console.  This reserves
+ enough space below the cursor to display a screenful of processes.
+
+ @param LiveContext Pointer to the live context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+PsLiveInitializeDisplay(
+    __inout PPS_LIVE_CONTEXT LiveContext
+    )
+{
+    CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
+    HANDLE ConsoleHandle;
+    YORI_ALLOC_SIZE_T RowWidth;
+    YORI_ALLOC_SIZE_T Index;
+
+    ConsoleHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+    LiveContext->ConsoleMode = FALSE;
+    RowWidth = 200;
+    if (GetConsoleScreenBufferInfo(ConsoleHandle, &ScreenInfo)) {
+
+        //
+        //  Leave the last line for the cursor, and the last column so
+        //  that a full row doesn't wrap onto the next line.
+        //
+
+        LiveContext->RowCount = (WORD)(ScreenInfo.srWindow.Bottom - ScreenInfo.srWindow.Top);
+        LiveContext->RowWidth = (WORD)(ScreenInfo.dwSize.X - 1);
+        if (LiveContext->RowCount > 1 && LiveContext->RowWidth > 0) {
+            LiveContext->ConsoleMode = TRUE;
+            RowWidth = LiveContext->RowWidth;
+        }
+    }
+
+    if (!YoriLibAllocateString(&LiveContext->RowBuffer, RowWidth + 1)) {
+        return FALSE;
+    }
+
+    if (!LiveContext->ConsoleMode) {
+        return TRUE;
+    }
+
+    LiveContext->DisplayedRows = YoriLibMalloc(LiveContext->RowCount * sizeof(YORI_STRING));
+    if (LiveContext->DisplayedRows == NULL) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < LiveContext->RowCount; Index++) {
+        YoriLibInitEmptyString(&LiveContext->DisplayedRows[Index]);
+    }
+
+    for (Index = 0; Index < LiveContext->RowCount; Index++) {
+        if (!YoriLibAllocateString(&LiveContext->DisplayedRows[Index], RowWidth)) {
+            return FALSE;
+        }
+    }
+
+    //
+    //  Scroll the console so that all rows are visible, and remember where
+    //  the first row is.
+    //
+
+    if (ScreenInfo.dwCursorPosition.X != 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+    }
+    for (Index = 0; Index < LiveContext->RowCount; Index++) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+    }
+
+    if (!GetConsoleScreenBufferInfo(ConsoleHandle, &ScreenInfo)) {
+        return FALSE;
+    }
+
+    LiveContext->Origin.X = 0;
+    LiveContext->Origin.Y = (SHORT)(ScreenInfo.dwCursorPosition.Y - LiveContext->RowCount);
+    return TRUE;
+}
+
+/**
+ Free all state associated with live display.
+
+ @param LiveContext Pointer to the live context.
+ */
+VOID
+PsLiveCleanup(
+    __inout PPS_LIVE_CONTEXT LiveContext
+    )
+{
+    WORD Index;
+
+    if (LiveContext->DisplayedRows != NULL) {
+        for (Index = 0; Index < LiveContext->RowCount; Index++) {
+            YoriLibFreeStringContents(&LiveContext->DisplayedRows[Index]);
+        }
+        YoriLibFree(LiveContext->DisplayedRows);
+    }
+    YoriLibFreeStringContents(&LiveContext->RowBuffer);
+    if (LiveContext->SortedSamples != NULL) {
+        YoriLibFree(LiveContext->SortedSamples);
+    }
+    if (LiveContext->Samples != NULL) {
+        YoriLibFree(LiveContext->Samples);
+    }
+    if (LiveContext->PreviousSamples != NULL) {
+        YoriLibFree(LiveContext->PreviousSamples);
+    }
+    if (LiveContext->ProcessInfo != NULL) {
+        YoriLibFree(LiveContext->ProcessInfo);
+    }
+}
+
+/**
+ Continuously display processor, I/O and memory activity for all processes
+ until cancelled.
+
+ @param Interval Specifies the number of milliseconds between samples.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+PsDisplayLive(
+    __in DWORD Interval
+    )
+{
+    PS_LIVE_CONTEXT LiveContext;
+    SYSTEM_INFO SystemInfo;
+    HANDLE CancelHandle;
+    BOOL Result;
+
+    ZeroMemory(&LiveContext, sizeof(LiveContext));
+
+    GetSystemInfo(&SystemInfo);
+    LiveContext.ProcessorCount = SystemInfo.dwNumberOfProcessors;
+    if (LiveContext.ProcessorCount == 0) {
+        LiveContext.ProcessorCount = 1;
+    }
+
+    if (!PsLiveInitializeDisplay(&LiveContext)) {
+        PsLiveCleanup(&LiveContext);
+        return FALSE;
+    }
+
+    CancelHandle = YoriLibCancelGetEvent();
+    Result = TRUE;
+
+    while (TRUE) {
+        if (!PsLiveCaptureSample(&LiveContext)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yps: Unable to load system process list\n"));
+            Result = FALSE;
+            break;
+        }
+
+        PsLiveSortSamples(&LiveContext);
+        PsLiveDisplaySample(&LiveContext);
+
+        if (CancelHandle != NULL) {
+            if (WaitForSingleObject(CancelHandle, Interval) == WAIT_OBJECT_0) {
+                break;
+            }
+        } else {
+            Sleep(Interval);
+        }
+    }
+
+    PsLiveCleanup(&LiveContext);
+    return Result;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the ps builtin command.
@@ -535,9 +1201,13 @@ ENTRYPOINT(
     YORI_STRING Arg;
     BOOLEAN DisplayAll;
     PS_CONTEXT PsContext;
+    DWORD LiveInterval;
+    YORI_MAX_SIGNED_T llTemp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
 
     ZeroMemory(&PsContext, sizeof(PsContext));
     DisplayAll = FALSE;
+    LiveInterval = 0;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -561,6 +1231,19 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
                 PsContext.DisplayMemory = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("w")) == 0) {
+                if (ArgC > i + 1) {
+                    llTemp = 0;
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        llTemp > 0 &&
+                        llTemp <= 24 * 60 * 60) {
+
+                        LiveInterval = (DWORD)llTemp * 1000;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             }
         } else {
             ArgumentUnderstood = TRUE;
@@ -573,13 +1256,30 @@ ENTRYPOINT(
         }
     }
 
+    if (LiveInterval != 0) {
+#if YORI_BUILTIN
+        YoriLibCancelEnable(FALSE);
+#endif
+        if (!PsDisplayLive(LiveInterval)) {
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
     PsContext.Now.QuadPart = YoriLibGetSystemTimeAsInteger();
 
+    //
+    //  Live mode positions the cursor directly, so only the one shot
+    //  display buffers its output.
+    //
+
+    YoriLibEnableOutputBuffering();
     if (DisplayAll) {
         PsDisplayAllProcesses(&PsContext);
     } else {
         PsDisplayConsoleProcesses(&PsContext);
     }
+    YoriLibDisableOutputBuffering();
 
     return EXIT_SUCCESS;
 }
@@ -62,26 +62,10 @@ RegeditHelp(VOID)
     return TRUE;
 }
 
-/**
- A structure describing the well known root keys.
- */
-typedef struct _REGEDIT_KEY_NAME_PAIR {
-
-    /**
-     The string description of the root key name.
-     */
-    YORI_STRING KeyName;
-
-    /**
-     The pseudo handle to the root key.
-     */
-    HKEY KeyHandle;
-} REGEDIT_KEY_NAME_PAIR, *PREGEDIT_KEY_NAME_PAIR;
-
 /**
  An array of well known root keys.
  */
-CONST REGEDIT_KEY_NAME_PAIR RegeditRootKeys[] = {
+CONST REGEDIT_KEY_NAME_PAIR RegeditRootKeys[REGEDIT_ROOT_KEY_COUNT] = {
     {YORILIB_CONSTANT_STRING(_T("HKEY_CLASSES_ROOT")), HKEY_CLASSES_ROOT},
     {YORILIB_CONSTANT_STRING(_T("HKEY_CURRENT_USER")), HKEY_CURRENT_USER},
     {YORILIB_CONSTANT_STRING(_T("HKEY_LOCAL_MACHINE")), HKEY_LOCAL_MACHINE},
@@ -196,262 +180,26 @@ RegeditPopulateKeyValueList(
 {
     YORI_ALLOC_SIZE_T Index;
     PYORI_WIN_CTRL_HANDLE Parent;
-    YORI_ALLOC_SIZE_T ArrayCount;
-    DWORD BytesRequired;
-    YORI_ALLOC_SIZE_T ArrayElementSize;
-    DWORD SubKeyCount;
-    DWORD ValueCount;
-    DWORD MaxValueNameLength;
-    DWORD MaxSubKeyLength;
-    PYORI_STRING StringArray;
 
     Parent = YoriWinGetControlParent(KeyListCtrl);
-    YoriWinListClearAllItems(KeyListCtrl);
-    YoriWinListClearAllItems(ValueListCtrl);
+
+    //
+    //  The root keys are a fixed list and are displayed immediately.
+    //  Anything else is enumerated in the background, so a large key
+    //  displays its contents as they are found and doesn't stall the UI.
+    //
 
     if (RegeditContext->TreeDepth == 0) {
-        for (Index = 0; Index < sizeof(RegeditRootKeys)/sizeof(RegeditRootKeys[0]); Index++) {
+        RegeditEnumCancel(RegeditContext);
+        YoriWinListClearAllItems(KeyListCtrl);
+        YoriWinListClearAllItems(ValueListCtrl);
+        for (Index = 0; Index < REGEDIT_ROOT_KEY_COUNT; Index++) {
             YoriWinListAddItems(KeyListCtrl, &RegeditRootKeys[Index].KeyName, 1);
         }
     } else {
-        YORI_STRING Text;
-        DWORD Err;
-        YORI_ALLOC_SIZE_T SelectIndex;
-        DWORD ValueSize;
-        DWORD MaxClassLength;
-        DWORD MaxValueData;
-        DWORD SecurityDescriptorLength;
-        DWORD ClassLength;
-        HKEY Key;
-        FILETIME LastWriteTime;
-
-        YoriLibConstantString(&Text, _T(".."));
-        YoriWinListAddItems(KeyListCtrl, &Text, 1);
-
-        Err = DllAdvApi32.pRegOpenKeyExW(RegeditContext->ActiveRootKey, RegeditContext->Subkey.StartOfString, 0, KEY_READ, &Key);
-        if (Err != ERROR_SUCCESS) {
-            RegeditDisplayWin32Error(Parent, Err);
-            return;
-        }
-
-        ClassLength = 0;
-        Err = DllAdvApi32.pRegQueryInfoKeyW(Key,
-                                            NULL,
-                                            &ClassLength,
-                                            NULL,
-                                            &SubKeyCount,
-                                            &MaxSubKeyLength,
-                                            &MaxClassLength,
-                                            &ValueCount,
-                                            &MaxValueNameLength,
-                                            &MaxValueData,
-                                            &SecurityDescriptorLength,
-                                            &LastWriteTime);
-
-        //
-        //  Older versions of Windows insist all parameters are populated,
-        //  including the class name, which we don't care about.  If needed,
-        //  allocate space for it, call again, and throw it away.
-        //
-
-        if (Err == ERROR_MORE_DATA || Err == ERROR_INSUFFICIENT_BUFFER) {
-            if (!YoriLibIsSizeAllocatable(ClassLength + 1)) {
-                RegeditDisplayWin32Error(Parent, ERROR_OUTOFMEMORY);
-                DllAdvApi32.pRegCloseKey(Key);
-                return;
-            }
-            if (!YoriLibAllocateString(&Text, (YORI_ALLOC_SIZE_T)(ClassLength + 1))) {
-                RegeditDisplayWin32Error(Parent, GetLastError());
-                DllAdvApi32.pRegCloseKey(Key);
-                return;
-            }
-
-            ClassLength = Text.LengthAllocated;
-            Err = DllAdvApi32.pRegQueryInfoKeyW(Key,
-                                                Text.StartOfString,
-                                                &ClassLength,
-                                                NULL,
-                                                &SubKeyCount,
-                                                &MaxSubKeyLength,
-                                                &MaxClassLength,
-                                                &ValueCount,
-                                                &MaxValueNameLength,
-                                                &MaxValueData,
-                                                &SecurityDescriptorLength,
-                                                &LastWriteTime);
-            YoriLibFreeStringContents(&Text);
-        }
-
-        if (Err != ERROR_SUCCESS) {
-            RegeditDisplayWin32Error(Parent, Err);
-            DllAdvApi32.pRegCloseKey(Key);
-            return;
-        }
-
-        //
-        //  Use a single array both for keys and values.  This means the
-        //  allocations need to be for the larger of the two.
-        //
-
-        if (!YoriLibIsSizeAllocatable(SubKeyCount) ||
-            !YoriLibIsSizeAllocatable(ValueCount) ||
-            !YoriLibIsSizeAllocatable(MaxSubKeyLength + 1) ||
-            !YoriLibIsSizeAllocatable(MaxValueNameLength + 1)) {
-
-            RegeditDisplayWin32Error(Parent, ERROR_NOT_ENOUGH_MEMORY);
-            DllAdvApi32.pRegCloseKey(Key);
-            return;
-        }
-        ArrayCount = (YORI_ALLOC_SIZE_T)SubKeyCount;
-        if (ValueCount > ArrayCount) {
-            ArrayCount = (YORI_ALLOC_SIZE_T)ValueCount;
-        }
-
-        ArrayElementSize = (YORI_ALLOC_SIZE_T)(MaxSubKeyLength + 1);
-        if (MaxValueNameLength + 1 > ArrayElementSize) {
-            ArrayElementSize = (YORI_ALLOC_SIZE_T)(MaxValueNameLength + 1);
-        }
-
-        BytesRequired = ArrayCount;
-        BytesRequired = BytesRequired * sizeof(YORI_STRING);
-        if (!YoriLibIsSizeAllocatable(BytesRequired)) {
-            RegeditDisplayWin32Error(Parent, ERROR_NOT_ENOUGH_MEMORY);
-            DllAdvApi32.pRegCloseKey(Key);
-            return;
-        }
-
-        StringArray = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesRequired);
-        if (StringArray == NULL) {
+        if (!RegeditEnumStart(RegeditContext, KeyListCtrl, ValueListCtrl, SelectKey, SelectValue)) {
             RegeditDisplayWin32Error(Parent, GetLastError());
-            DllAdvApi32.pRegCloseKey(Key);
-            return;
-        }
-
-        for (Index = 0; Index < ArrayCount; Index++) {
-            YoriLibInitEmptyString(&StringArray[Index]);
-        }
-
-        //
-        //  Enumerate keys
-        //
-
-        for (Index = 0; Index < SubKeyCount; Index++) {
-            if (!YoriLibAllocateString(&StringArray[Index], ArrayElementSize)) {
-                Err = ERROR_OUTOFMEMORY;
-                break;
-            }
-            ValueSize = ArrayElementSize;
-            Err = DllAdvApi32.pRegEnumKeyExW(Key, Index, StringArray[Index].StartOfString, &ValueSize, NULL, NULL, NULL, &LastWriteTime);
-
-            //
-            //  MSFIX Possibly reallocate
-            //
-
-            if (Err == ERROR_NO_MORE_ITEMS) {
-                Err = ERROR_SUCCESS;
-                break;
-            } else if (Err != ERROR_SUCCESS) {
-                break;
-            }
-
-            if (!YoriLibIsSizeAllocatable(ValueSize)) {
-                Err = ERROR_NOT_ENOUGH_MEMORY;
-                break;
-            }
-
-            StringArray[Index].LengthInChars = (YORI_ALLOC_SIZE_T)ValueSize;
         }
-
-        //
-        //  If it failed, tell the user.  Otherwise, sort, and add them to the
-        //  list.  If an item should be selected, find the index of a matching
-        //  string or the first item to be greater than it, and select that.
-        //
-
-        if (Err != ERROR_SUCCESS) {
-            RegeditDisplayWin32Error(Parent, Err);
-        } else if (Index > 0) {
-            YoriLibSortStringArray(StringArray, Index);
-            YoriWinListAddItems(KeyListCtrl, StringArray, Index);
-            if (SelectKey != NULL) {
-                for (SelectIndex = 0; SelectIndex < Index; SelectIndex++) {
-                    if (YoriLibCompareStringIns(&StringArray[SelectIndex], SelectKey) >= 0) {
-                        break;
-                    }
-                }
-
-                //
-                //  Because of the .. entry above, we normally move forward one
-                //  element.  The exception is if we've already navigated
-                //  beyond the final element.
-                //
-
-                if (SelectIndex < Index) {
-                    SelectIndex++;
-                }
-                YoriWinListSetActiveOption(KeyListCtrl, SelectIndex);
-            }
-        }
-
-        Err = ERROR_SUCCESS;
-
-        //
-        //  Collect values, sort, find item to select, etc.
-        //
-
-        for (Index = 0; Index < ValueCount; Index++) {
-            if (StringArray[Index].LengthAllocated == 0) {
-                if (!YoriLibAllocateString(&StringArray[Index], (YORI_ALLOC_SIZE_T)(MaxValueNameLength + 1))) {
-                    Err = ERROR_OUTOFMEMORY;
-                    break;
-                }
-            }
-            ValueSize = StringArray[Index].LengthAllocated;
-            Err = DllAdvApi32.pRegEnumValueW(Key, Index, StringArray[Index].StartOfString, &ValueSize, NULL, NULL, NULL, NULL);
-
-            //
-            //  MSFIX Possibly reallocate
-            //
-            if (Err == ERROR_NO_MORE_ITEMS) {
-                Err = ERROR_SUCCESS;
-                break;
-            } else if (Err != ERROR_SUCCESS) {
-                break;
-            }
-
-            if (!YoriLibIsSizeAllocatable(ValueSize)) {
-                Err = ERROR_NOT_ENOUGH_MEMORY;
-                break;
-            }
-
-            StringArray[Index].LengthInChars = (YORI_ALLOC_SIZE_T)ValueSize;
-        }
-
-        if (Err != ERROR_SUCCESS) {
-            RegeditDisplayWin32Error(Parent, Err);
-        } else {
-            YoriLibSortStringArray(StringArray, Index);
-            YoriWinListAddItems(ValueListCtrl, StringArray, Index);
-            if (SelectValue != NULL) {
-                for (SelectIndex = 0; SelectIndex < Index; SelectIndex++) {
-                    if (YoriLibCompareStringIns(&StringArray[SelectIndex], SelectValue) >= 0) {
-                        break;
-                    }
-                }
-
-                if (SelectIndex == Index) {
-                    SelectIndex--;
-                }
-                YoriWinListSetActiveOption(ValueListCtrl, SelectIndex);
-            }
-        }
-
-        for (Index = 0; Index < ArrayCount; Index++) {
-            YoriLibFreeStringContents(&StringArray[Index]);
-        }
-        YoriLibFree(StringArray);
-
-        DllAdvApi32.pRegCloseKey(Key);
     }
 }
 
@@ -887,6 +635,54 @@ RegeditEditSelectedValue(
     YoriWinListSetActiveOption(ValueList, SelectedValueIndex);
 }
 
+/**
+ Update the caption above the key and value lists to describe the currently
+ opened key.
+
+ @param RegeditContext Pointer to the regedit context which indicates the
+        currently opened registry key.
+
+ @param Parent Pointer to the main window.
+ */
+VOID
+RegeditUpdateKeyCaption(
+    __in PREGEDIT_CONTEXT RegeditContext,
+    __in PYORI_WIN_CTRL_HANDLE Parent
+    )
+{
+    PYORI_WIN_CTRL_HANDLE KeyCaption;
+    YORI_STRING String;
+
+    KeyCaption = YoriWinFindControlById(Parent, RegeditControlKeyName);
+    ASSERT(KeyCaption != NULL);
+    __analysis_assume(KeyCaption != NULL);
+
+    if (RegeditContext->TreeDepth > 0) {
+        PCYORI_STRING RootString;
+        DWORD Index;
+
+        RootString = NULL;
+        for (Index = 0; Index < REGEDIT_ROOT_KEY_COUNT; Index++) {
+            if (RegeditContext->ActiveRootKey == RegeditRootKeys[Index].KeyHandle) {
+                RootString = &RegeditRootKeys[Index].KeyName;
+            }
+        }
+
+        ASSERT(RootString != NULL);
+
+        if (YoriLibAllocateString(&String, RootString->LengthInChars + 1 + RegeditContext->Subkey.LengthInChars + 1)) {
+            if (RegeditContext->TreeDepth == 1) {
+                YoriLibYPrintf(&String, _T("%y"), RootString);
+            } else {
+                YoriLibYPrintf(&String, _T("%y\\%y"), RootString, &RegeditContext->Subkey);
+            }
+
+            YoriWinLabelSetCaption(KeyCaption, &String);
+            YoriLibFreeStringContents(&String);
+        }
+    }
+}
+
 /**
  Find the currently selected key within the key list control, and navigate to
  it.  This may be navigating to a subkey, or a parent key, or the magic root
@@ -912,13 +708,7 @@ RegeditNavigateToSelectedKey(
     __in YORI_ALLOC_SIZE_T SelectedKeyIndex
     )
 {
-    PYORI_WIN_CTRL_HANDLE KeyCaption;
     YORI_STRING String;
-    YORI_STRING NewCaption;
-
-    KeyCaption = YoriWinFindControlById(Parent, RegeditControlKeyName);
-    ASSERT(KeyCaption != NULL);
-    __analysis_assume(KeyCaption != NULL);
 
     YoriLibInitEmptyString(&String);
     YoriWinListGetItemText(KeyList, SelectedKeyIndex, &String);
@@ -961,33 +751,84 @@ RegeditNavigateToSelectedKey(
     }
     YoriLibFreeStringContents(&String);
 
-    YoriLibInitEmptyString(&NewCaption);
-    if (RegeditContext->TreeDepth > 0) {
-        PCYORI_STRING RootString;
-        DWORD Index;
+    RegeditUpdateKeyCaption(RegeditContext, Parent);
 
-        RootString = NULL;
-        for (Index = 0; Index < sizeof(RegeditRootKeys)/sizeof(RegeditRootKeys[0]); Index++) {
-            if (RegeditContext->ActiveRootKey == RegeditRootKeys[Index].KeyHandle) {
-                RootString = &RegeditRootKeys[Index].KeyName;
-            }
-        }
+    RegeditPopulateKeyValueList(RegeditContext, KeyList, ValueList, NULL, NULL);
+}
 
-        ASSERT(RootString != NULL);
+/**
+ Open a specified key and display its contents, selecting a value within
+ it if requested.
 
-        if (YoriLibAllocateString(&String, RootString->LengthInChars + 1 + RegeditContext->Subkey.LengthInChars + 1)) {
-            if (RegeditContext->TreeDepth == 1) {
-                YoriLibYPrintf(&String, _T("%y"), RootString);
-            } else {
-                YoriLibYPrintf(&String, _T("%y\\%y"), RootString, &RegeditContext->Subkey);
-            }
+ @param RegeditContext Pointer to the regedit context.
 
-            YoriWinLabelSetCaption(KeyCaption, &String);
-            YoriLibFreeStringContents(&String);
+ @param Parent Pointer to the main window.
+
+ @param RootKey The root key containing the key to open.
+
+ @param Subkey Pointer to the path of the key to open, relative to RootKey.
+
+ @param SelectValue Optionally points to the name of a value to select
+        within the key.
+ */
+VOID
+RegeditNavigateToKey(
+    __in PREGEDIT_CONTEXT RegeditContext,
+    __in PYORI_WIN_CTRL_HANDLE Parent,
+    __in HKEY RootKey,
+    __in PYORI_STRING Subkey,
+    __in_opt PYORI_STRING SelectValue
+    )
+{
+    PYORI_WIN_CTRL_HANDLE KeyList;
+    PYORI_WIN_CTRL_HANDLE ValueList;
+    YORI_STRING NewSubkey;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD TreeDepth;
+
+    KeyList = YoriWinFindControlById(Parent, RegeditControlKeyList);
+    ASSERT(KeyList != NULL);
+    __analysis_assume(KeyList != NULL);
+
+    ValueList = YoriWinFindControlById(Parent, RegeditControlValueList);
+    ASSERT(ValueList != NULL);
+    __analysis_assume(ValueList != NULL);
+
+    if (!YoriLibCopyString(&NewSubkey, Subkey)) {
+        RegeditDisplayWin32Error(Parent, ERROR_NOT_ENOUGH_MEMORY);
+        return;
+    }
+
+    //
+    //  The root key is at depth one, and each component below it is one
+    //  more.
+    //
+
+    TreeDepth = 1;
+    if (NewSubkey.LengthInChars > 0) {
+        TreeDepth++;
+        for (Index = 0; Index < NewSubkey.LengthInChars; Index++) {
+            if (NewSubkey.StartOfString[Index] == '\\') {
+                TreeDepth++;
+            }
         }
     }
 
-    RegeditPopulateKeyValueList(RegeditContext, KeyList, ValueList, NULL, NULL);
+    YoriLibFreeStringContents(&RegeditContext->Subkey);
+    memcpy(&RegeditContext->Subkey, &NewSubkey, sizeof(YORI_STRING));
+    RegeditContext->ActiveRootKey = RootKey;
+    RegeditContext->TreeDepth = TreeDepth;
+
+    RegeditUpdateKeyCaption(RegeditContext, Parent);
+    RegeditPopulateKeyValueList(RegeditContext, KeyList, ValueList, NULL, SelectValue);
+
+    if (SelectValue != NULL) {
+        YoriWinSetFocus(YoriWinGetWindowFromWindowCtrl(Parent), ValueList);
+        RegeditContext->MostRecentListSelectedControl = RegeditControlValueList;
+    } else {
+        YoriWinSetFocus(YoriWinGetWindowFromWindowCtrl(Parent), KeyList);
+        RegeditContext->MostRecentListSelectedControl = RegeditControlKeyList;
+    }
 }
 
 /**
@@ -1500,6 +1341,48 @@ RegeditCopyKeyButtonClicked(
 }
 
 
+/**
+ A callback invoked when the find menu item is invoked.  This searches the
+ current key and the keys beneath it, allowing the user to navigate to a
+ result.
+
+ @param Ctrl Pointer to the menu bar control.
+ */
+VOID
+RegeditFindButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PREGEDIT_CONTEXT RegeditContext;
+    HKEY RootKey;
+    YORI_STRING Subkey;
+    YORI_STRING ValueName;
+    BOOLEAN ValueFound;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    RegeditContext = YoriWinGetControlContext(Parent);
+
+    if (!RegeditFind(RegeditContext,
+                     YoriWinGetWindowManagerHandle(YoriWinGetWindowFromWindowCtrl(Parent)),
+                     &RootKey,
+                     &Subkey,
+                     &ValueName,
+                     &ValueFound)) {
+
+        return;
+    }
+
+    if (ValueFound) {
+        RegeditNavigateToKey(RegeditContext, Parent, RootKey, &Subkey, &ValueName);
+    } else {
+        RegeditNavigateToKey(RegeditContext, Parent, RootKey, &Subkey, NULL);
+    }
+
+    YoriLibFreeStringContents(&Subkey);
+    YoriLibFreeStringContents(&ValueName);
+}
+
 /**
  Callback invoked when the refresh menu item is clicked.
 
@@ -1696,7 +1579,7 @@ RegeditPopulateMenuBar(
     )
 {
     YORI_WIN_MENU_ENTRY FileMenuEntries[1];
-    YORI_WIN_MENU_ENTRY EditMenuEntries[5];
+    YORI_WIN_MENU_ENTRY EditMenuEntries[7];
     YORI_WIN_MENU_ENTRY ViewMenuEntries[1];
     YORI_WIN_MENU_ENTRY NewMenuEntries[7];
     YORI_WIN_MENU_ENTRY HelpMenuEntries[1];
@@ -1756,6 +1639,13 @@ RegeditPopulateMenuBar(
     YoriLibConstantString(&EditMenuEntries[MenuIndex].Hotkey, _T("Ctrl+C"));
     RegeditContext->CopyKeyMenuIndex = MenuIndex;
 
+    MenuIndex++;
+    EditMenuEntries[MenuIndex].Flags = YORI_WIN_MENU_ENTRY_SEPERATOR;
+    MenuIndex++;
+    YoriLibConstantString(&EditMenuEntries[MenuIndex].Caption, _T("&Find..."));
+    EditMenuEntries[MenuIndex].NotifyCallback = RegeditFindButtonClicked;
+    YoriLibConstantString(&EditMenuEntries[MenuIndex].Hotkey, _T("Ctrl+F"));
+
     ZeroMemory(&ViewMenuEntries, sizeof(ViewMenuEntries));
     MenuIndex = 0;
     YoriLibConstantString(&ViewMenuEntries[MenuIndex].Caption, _T("&Refresh"));
@@ -2133,6 +2023,7 @@ RegeditCreateMainWindow(
         Result = FALSE;
     }
 
+    RegeditEnumCancel(RegeditContext);
     YoriWinDestroyWindow(Parent);
     YoriWinCloseWindowManager(WinMgr);
     return (BOOLEAN)Result;
@@ -2174,8 +2065,10 @@ ENTRYPOINT(
 
     RegeditContext.UseAsciiDrawing = FALSE;
     RegeditContext.TreeDepth = 0;
+    RegeditContext.Enum = NULL;
+    RegeditContext.FindMatchCase = FALSE;
     YoriLibInitEmptyString(&RegeditContext.Subkey);
-
+    YoriLibInitEmptyString(&RegeditContext.FindText);
 
     for (i = 1; i < ArgC; i++) {
 
@@ -2224,9 +2117,11 @@ ENTRYPOINT(
 
     if (!RegeditCreateMainWindow(&RegeditContext)) {
         YoriLibFreeStringContents(&RegeditContext.Subkey);
+        YoriLibFreeStringContents(&RegeditContext.FindText);
         return EXIT_FAILURE;
     }
     YoriLibFreeStringContents(&RegeditContext.Subkey);
+    YoriLibFreeStringContents(&RegeditContext.FindText);
     return EXIT_SUCCESS;
 }
 
@@ -38,6 +38,35 @@ typedef enum _REGEDIT_CONTROLS {
     RegeditControlValueCaption = 8,
 } REGEDIT_CONTROLS;
 
+/**
+ A structure describing the well known root keys.
+ */
+typedef struct _REGEDIT_KEY_NAME_PAIR {
+
+    /**
+     The string description of the root key name.
+     */
+    YORI_STRING KeyName;
+
+    /**
+     The pseudo handle to the root key.
+     */
+    HKEY KeyHandle;
+} REGEDIT_KEY_NAME_PAIR, *PREGEDIT_KEY_NAME_PAIR;
+
+/**
+ The number of well known root keys.
+ */
+#define REGEDIT_ROOT_KEY_COUNT (4)
+
+extern CONST REGEDIT_KEY_NAME_PAIR RegeditRootKeys[REGEDIT_ROOT_KEY_COUNT];
+
+/**
+ State describing the enumeration of a key on a background thread.  This is
+ defined in regenum.c.
+ */
+typedef struct _REGEDIT_ENUM REGEDIT_ENUM, *PREGEDIT_ENUM;
+
 
 /**
  Context for the regedit application.
@@ -62,6 +91,19 @@ typedef struct _REGEDIT_CONTEXT {
      */
     YORI_STRING Subkey;
 
+    /**
+     The enumeration of the subkeys and values within the active key.  The
+     key and value list controls display the results of this enumeration.
+     This is NULL when the root keys are displayed.
+     */
+    PREGEDIT_ENUM Enum;
+
+    /**
+     The text most recently searched for.  This is used as the initial
+     text when searching again.
+     */
+    YORI_STRING FindText;
+
     /**
      Indicates which list has had its selection changed most recently.  This
      is used to determine which list should be operated upon.
@@ -94,8 +136,45 @@ typedef struct _REGEDIT_CONTEXT {
      */
     BOOLEAN UseAsciiDrawing;
 
+    /**
+     TRUE if the most recent search was case sensitive.
+     */
+    BOOLEAN FindMatchCase;
+
 } REGEDIT_CONTEXT, *PREGEDIT_CONTEXT;
 
+VOID
+RegeditDisplayWin32Error(
+    __in PYORI_WIN_CTRL_HANDLE Parent,
+    __in DWORD Error
+    );
+
+__success(return)
+BOOLEAN
+RegeditEnumStart(
+    __in PREGEDIT_CONTEXT RegeditContext,
+    __in PYORI_WIN_CTRL_HANDLE KeyListCtrl,
+    __in PYORI_WIN_CTRL_HANDLE ValueListCtrl,
+    __in_opt PYORI_STRING SelectKey,
+    __in_opt PYORI_STRING SelectValue
+    );
+
+VOID
+RegeditEnumCancel(
+    __in PREGEDIT_CONTEXT RegeditContext
+    );
+
+__success(return)
+BOOLEAN
+RegeditFind(
+    __in PREGEDIT_CONTEXT RegeditContext,
+    __in PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgr,
+    __out PHKEY RootKey,
+    __out PYORI_STRING Subkey,
+    __out PYORI_STRING ValueName,
+    __out PBOOLEAN ValueFound
+    );
+
 __success(return)
 BOOLEAN
 RegeditEditBinaryValue(
@@ -0,0 +1,928 @@
+/**
+ * @file regedit/regenum.c
+ *
+ * Yori shell registry editor background key enumeration
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yoriwin.h>
+#include <yoridlg.h>
+#include "regedit.h"
+
+/**
+ The interval in milliseconds between checks for names found by the
+ background thread.
+ */
+#define REGEDIT_ENUM_INTERVAL (100)
+
+/**
+ The time in milliseconds to wait for an enumeration to complete before
+ displaying partial results.  Most keys are small, and waiting briefly for
+ them avoids displaying an empty list followed by its contents.
+ */
+#define REGEDIT_ENUM_SYNCHRONOUS_WAIT (50)
+
+/**
+ The number of names the background thread collects before making them
+ available to the display.
+ */
+#define REGEDIT_ENUM_BATCH_SIZE (256)
+
+/**
+ The number of characters to allocate for a key or value name.  Value names
+ are limited to 16,383 characters, and key names are shorter than that.
+ */
+#define REGEDIT_ENUM_NAME_LENGTH (16384)
+
+/**
+ A growable array of strings.
+ */
+typedef struct _REGEDIT_STRING_ARRAY {
+
+    /**
+     Pointer to the array of strings.
+     */
+    PYORI_STRING Items;
+
+    /**
+     The number of strings populated in the array.
+     */
+    YORI_ALLOC_SIZE_T Count;
+
+    /**
+     The number of strings allocated in the array.
+     */
+    YORI_ALLOC_SIZE_T Allocated;
+} REGEDIT_STRING_ARRAY, *PREGEDIT_STRING_ARRAY;
+
+/**
+ State describing the enumeration of a key on a background thread.
+ */
+struct _REGEDIT_ENUM {
+
+    /**
+     The root key containing the key to enumerate.
+     */
+    HKEY RootKey;
+
+    /**
+     The subkey to enumerate.  This is NULL terminated.
+     */
+    YORI_STRING Subkey;
+
+    /**
+     The list control to display subkeys in.
+     */
+    PYORI_WIN_CTRL_HANDLE KeyList;
+
+    /**
+     The list control to display values in.
+     */
+    PYORI_WIN_CTRL_HANDLE ValueList;
+
+    /**
+     The key to select once enumeration is complete, if HaveSelectKey is
+     TRUE.
+     */
+    YORI_STRING SelectKey;
+
+    /**
+     The value to select once enumeration is complete, if HaveSelectValue is
+     TRUE.
+     */
+    YORI_STRING SelectValue;
+
+    /**
+     Handle to the background thread.  NULL if enumeration is occurring
+     synchronously or the thread has been waited for.
+     */
+    HANDLE Thread;
+
+    /**
+     A mutex protecting the pending arrays and the error, cancel and
+     complete fields.
+     */
+    HANDLE Mutex;
+
+    /**
+     Subkeys found by the background thread that have not yet been
+     displayed.
+     */
+    REGEDIT_STRING_ARRAY PendingKeys;
+
+    /**
+     Values found by the background thread that have not yet been
+     displayed.
+     */
+    REGEDIT_STRING_ARRAY PendingValues;
+
+    /**
+     Subkeys being displayed.  This is only accessed by the UI thread.
+     */
+    REGEDIT_STRING_ARRAY Keys;
+
+    /**
+     Values being displayed.  This is only accessed by the UI thread.
+     */
+    REGEDIT_STRING_ARRAY Values;
+
+    /**
+     The first error encountered by the background thread, or
+     ERROR_SUCCESS.
+     */
+    DWORD Error;
+
+    /**
+     Set to TRUE to request the background thread to stop.
+     */
+    BOOLEAN Cancel;
+
+    /**
+     Set to TRUE by the background thread once it has found all names.
+     */
+    BOOLEAN Complete;
+
+    /**
+     Set to TRUE by the UI thread once all names have been displayed and
+     sorted.  This is only accessed by the UI thread.
+     */
+    BOOLEAN Finished;
+
+    /**
+     TRUE if SelectKey contains a key to select.
+     */
+    BOOLEAN HaveSelectKey;
+
+    /**
+     TRUE if SelectValue contains a value to select.
+     */
+    BOOLEAN HaveSelectValue;
+};
+
+/**
+ Free all strings in a string array and the array itself.
+
+ @param Array Pointer to the array to free.
+ */
+VOID
+RegeditStringArrayCleanup(
+    __inout PREGEDIT_STRING_ARRAY Array
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    for (Index = 0; Index < Array->Count; Index++) {
+        YoriLibFreeStringContents(&Array->Items[Index]);
+    }
+
+    if (Array->Items != NULL) {
+        YoriLibFree(Array->Items);
+    }
+
+    Array->Items = NULL;
+    Array->Count = 0;
+    Array->Allocated = 0;
+}
+
+/**
+ Ensure a string array has space for a number of additional strings.
+
+ @param Array Pointer to the array.
+
+ @param Additional The number of strings that will be added.
+
+ @return TRUE to indicate the space is available, FALSE on allocation
+         failure.
+ */
+__success(return)
+BOOLEAN
+RegeditStringArrayEnsureSpace(
+    __inout PREGEDIT_STRING_ARRAY Array,
+    __in YORI_ALLOC_SIZE_T Additional
+    )
+{
+    PYORI_STRING NewItems;
+    DWORD NewAllocated;
+    DWORD BytesRequired;
+
+    if (Array->Count + Additional <= Array->Allocated) {
+        return TRUE;
+    }
+
+    NewAllocated = Array->Allocated * 2;
+    if (NewAllocated < 64) {
+        NewAllocated = 64;
+    }
+    if (NewAllocated < (DWORD)Array->Count + Additional) {
+        NewAllocated = (DWORD)Array->Count + Additional;
+    }
+
+    BytesRequired = NewAllocated * sizeof(YORI_STRING);
+    if (!YoriLibIsSizeAllocatable(NewAllocated) ||
+        !YoriLibIsSizeAllocatable(BytesRequired)) {
+
+        return FALSE;
+    }
+
+    NewItems = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesRequired);
+    if (NewItems == NULL) {
+        return FALSE;
+    }
+
+    if (Array->Count > 0) {
+        memcpy(NewItems, Array->Items, Array->Count * sizeof(YORI_STRING));
+    }
+
+    if (Array->Items != NULL) {
+        YoriLibFree(Array->Items);
+    }
+
+    Array->Items = NewItems;
+    Array->Allocated = (YORI_ALLOC_SIZE_T)NewAllocated;
+    return TRUE;
+}
+
+/**
+ Add a copy of a string to a string array.
+
+ @param Array Pointer to the array.
+
+ @param String Pointer to the string to copy.
+
+ @return TRUE to indicate the string was added, FALSE on allocation failure.
+ */
+__success(return)
+BOOLEAN
+RegeditStringArrayAppend(
+    __inout PREGEDIT_STRING_ARRAY Array,
+    __in PCYORI_STRING String
+    )
+{
+    if (!RegeditStringArrayEnsureSpace(Array, 1)) {
+        return FALSE;
+    }
+
+    if (!YoriLibCopyString(&Array->Items[Array->Count], String)) {
+        return FALSE;
+    }
+
+    Array->Count++;
+    return TRUE;
+}
+
+/**
+ Move all strings from one string array to the end of another.  On success,
+ the source array is empty but retains its allocation.
+
+ @param Dest Pointer to the array to add strings to.
+
+ @param Src Pointer to the array to remove strings from.
+
+ @return TRUE to indicate the strings were moved, FALSE on allocation
+         failure, in which case neither array is changed.
+ */
+__success(return)
+BOOLEAN
+RegeditStringArrayMove(
+    __inout PREGEDIT_STRING_ARRAY Dest,
+    __inout PREGEDIT_STRING_ARRAY Src
+    )
+{
+    if (Src->Count == 0) {
+        return TRUE;
+    }
+
+    if (!RegeditStringArrayEnsureSpace(Dest, Src->Count)) {
+        return FALSE;
+    }
+
+    memcpy(&Dest->Items[Dest->Count], Src->Items, Src->Count * sizeof(YORI_STRING));
+    Dest->Count = Dest->Count + Src->Count;
+    Src->Count = 0;
+    return TRUE;
+}
+
+/**
+ Make a batch of names found by the background thread available to the
+ display.
+
+ @param Enum Pointer to the enumeration.
+
+ @param Pending Pointer to the pending array to add the names to.
+
+ @param Batch Pointer to the names found by the background thread.  On
+        success, this array is empty.
+
+ @return TRUE to indicate the names were added, FALSE on allocation failure.
+ */
+__success(return)
+BOOLEAN
+RegeditEnumPublish(
+    __in PREGEDIT_ENUM Enum,
+    __inout PREGEDIT_STRING_ARRAY Pending,
+    __inout PREGEDIT_STRING_ARRAY Batch
+    )
+{
+    BOOLEAN Result;
+
+    WaitForSingleObject(Enum->Mutex, INFINITE);
+    Result = RegeditStringArrayMove(Pending, Batch);
+    ReleaseMutex(Enum->Mutex);
+    return Result;
+}
+
+/**
+ Enumerate the subkeys and values within a key.  This is normally executed
+ on a background thread, and makes names available to the display in
+ batches.
+
+ @param Enum Pointer to the enumeration.
+ */
+VOID
+RegeditEnumWorker(
+    __in PREGEDIT_ENUM Enum
+    )
+{
+    REGEDIT_STRING_ARRAY Batch;
+    YORI_STRING Name;
+    FILETIME LastWriteTime;
+    DWORD NameLength;
+    DWORD Index;
+    DWORD Err;
+    HKEY Key;
+
+    Batch.Items = NULL;
+    Batch.Count = 0;
+    Batch.Allocated = 0;
+
+    Err = DllAdvApi32.pRegOpenKeyExW(Enum->RootKey, Enum->Subkey.StartOfString, 0, KEY_READ, &Key);
+    if (Err != ERROR_SUCCESS) {
+        WaitForSingleObject(Enum->Mutex, INFINITE);
+        Enum->Error = Err;
+        Enum->Complete = TRUE;
+        ReleaseMutex(Enum->Mutex);
+        return;
+    }
+
+    if (!YoriLibAllocateString(&Name, REGEDIT_ENUM_NAME_LENGTH)) {
+        DllAdvApi32.pRegCloseKey(Key);
+        WaitForSingleObject(Enum->Mutex, INFINITE);
+        Enum->Error = ERROR_NOT_ENOUGH_MEMORY;
+        Enum->Complete = TRUE;
+        ReleaseMutex(Enum->Mutex);
+        return;
+    }
+
+    //
+    //  Enumerate keys
+    //
+
+    for (Index = 0; !Enum->Cancel; Index++) {
+        NameLength = Name.LengthAllocated;
+        Err = DllAdvApi32.pRegEnumKeyExW(Key, Index, Name.StartOfString, &NameLength, NULL, NULL, NULL, &LastWriteTime);
+        if (Err == ERROR_NO_MORE_ITEMS) {
+            Err = ERROR_SUCCESS;
+            break;
+        } else if (Err != ERROR_SUCCESS) {
+            break;
+        }
+
+        Name.LengthInChars = (YORI_ALLOC_SIZE_T)NameLength;
+        if (!RegeditStringArrayAppend(&Batch, &Name)) {
+            Err = ERROR_NOT_ENOUGH_MEMORY;
+            break;
+        }
+
+        if (Batch.Count >= REGEDIT_ENUM_BATCH_SIZE &&
+            !RegeditEnumPublish(Enum, &Enum->PendingKeys, &Batch)) {
+
+            Err = ERROR_NOT_ENOUGH_MEMORY;
+            break;
+        }
+    }
+
+    if (Err == ERROR_SUCCESS &&
+        !RegeditEnumPublish(Enum, &Enum->PendingKeys, &Batch)) {
+
+        Err = ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    //
+    //  Enumerate values
+    //
+
+    if (Err == ERROR_SUCCESS) {
+        for (Index = 0; !Enum->Cancel; Index++) {
+            NameLength = Name.LengthAllocated;
+            Err = DllAdvApi32.pRegEnumValueW(Key, Index, Name.StartOfString, &NameLength, NULL, NULL, NULL, NULL);
+            if (Err == ERROR_NO_MORE_ITEMS) {
+                Err = ERROR_SUCCESS;
+                break;
+            } else if (Err != ERROR_SUCCESS) {
+                break;
+            }
+
+            Name.LengthInChars = (YORI_ALLOC_SIZE_T)NameLength;
+            if (!RegeditStringArrayAppend(&Batch, &Name)) {
+                Err = ERROR_NOT_ENOUGH_MEMORY;
+                break;
+            }
+
+            if (Batch.Count >= REGEDIT_ENUM_BATCH_SIZE &&
+                !RegeditEnumPublish(Enum, &Enum->PendingValues, &Batch)) {
+
+                Err = ERROR_NOT_ENOUGH_MEMORY;
+                break;
+            }
+        }
+
+        if (Err == ERROR_SUCCESS &&
+            !RegeditEnumPublish(Enum, &Enum->PendingValues, &Batch)) {
+
+            Err = ERROR_NOT_ENOUGH_MEMORY;
+        }
+    }
+
+    RegeditStringArrayCleanup(&Batch);
+    YoriLibFreeStringContents(&Name);
+    DllAdvApi32.pRegCloseKey(Key);
+
+    WaitForSingleObject(Enum->Mutex, INFINITE);
+    if (!Enum->Cancel) {
+        Enum->Error = Err;
+    }
+    Enum->Complete = TRUE;
+    ReleaseMutex(Enum->Mutex);
+}
+
+/**
+ The entrypoint for the background thread which enumerates a key.
+
+ @param Context Pointer to the enumeration.
+
+ @return Zero.
+ */
+DWORD WINAPI
+RegeditEnumThread(
+    __in PVOID Context
+    )
+{
+    RegeditEnumWorker((PREGEDIT_ENUM)Context);
+    return 0;
+}
+
+/**
+ Return the text of an item in the key list.  The first item is always
+ "..", followed by the subkeys found so far.
+
+ @param Ctrl Pointer to the key list control.
+
+ @param Index The index of the item to return.
+
+ @param String On successful completion, updated to point to the text of
+        the item.  This refers to memory owned by the enumeration.
+
+ @return TRUE to indicate the string was populated, FALSE if it was not.
+ */
+BOOLEAN
+RegeditEnumGetKeyText(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl,
+    __in YORI_ALLOC_SIZE_T Index,
+    __inout PYORI_STRING String
+    )
+{
+    PREGEDIT_CONTEXT RegeditContext;
+    PREGEDIT_ENUM Enum;
+
+    RegeditContext = YoriWinGetControlContext(YoriWinGetControlParent(Ctrl));
+    Enum = RegeditContext->Enum;
+
+    if (Index == 0) {
+        YoriLibConstantString(String, _T(".."));
+        return TRUE;
+    }
+
+    if (Enum == NULL || Index > Enum->Keys.Count) {
+        return FALSE;
+    }
+
+    String->StartOfString = Enum->Keys.Items[Index - 1].StartOfString;
+    String->LengthInChars = Enum->Keys.Items[Index - 1].LengthInChars;
+    return TRUE;
+}
+
+/**
+ Return the text of an item in the value list.
+
+ @param Ctrl Pointer to the value list control.
+
+ @param Index The index of the item to return.
+
+ @param String On successful completion, updated to point to the text of
+        the item.  This refers to memory owned by the enumeration.
+
+ @return TRUE to indicate the string was populated, FALSE if it was not.
+ */
+BOOLEAN
+RegeditEnumGetValueText(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl,
+    __in YORI_ALLOC_SIZE_T Index,
+    __inout PYORI_STRING String
+    )
+{
+    PREGEDIT_CONTEXT RegeditContext;
+    PREGEDIT_ENUM Enum;
+
+    RegeditContext = YoriWinGetControlContext(YoriWinGetControlParent(Ctrl));
+    Enum = RegeditContext->Enum;
+
+    if (Enum == NULL || Index >= Enum->Values.Count) {
+        return FALSE;
+    }
+
+    String->StartOfString = Enum->Values.Items[Index].StartOfString;
+    String->LengthInChars = Enum->Values.Items[Index].LengthInChars;
+    return TRUE;
+}
+
+/**
+ Find the index of the first string in a sorted array which is equal to or
+ greater than a specified string.
+
+ @param Array Pointer to the sorted array.
+
+ @param String The string to find.
+
+ @return The index of the first matching or greater string.  If all strings
+         are less than String, this is the number of strings in the array.
+ */
+YORI_ALLOC_SIZE_T
+RegeditStringArrayFind(
+    __in PREGEDIT_STRING_ARRAY Array,
+    __in PYORI_STRING String
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    for (Index = 0; Index < Array->Count; Index++) {
+        if (YoriLibCompareStringIns(&Array->Items[Index], String) >= 0) {
+            break;
+        }
+    }
+
+    return Index;
+}
+
+/**
+ Sort the names found by an enumeration which has completed, and select the
+ item the user had selected while enumeration was occurring, or the item
+ requested when the enumeration started.
+
+ @param Enum Pointer to the enumeration.
+ */
+VOID
+RegeditEnumFinish(
+    __in PREGEDIT_ENUM Enum
+    )
+{
+    YORI_STRING Selected;
+    YORI_ALLOC_SIZE_T SelectIndex;
+    YORI_ALLOC_SIZE_T ActiveOption;
+    PYORI_STRING SelectKey;
+    PYORI_STRING SelectValue;
+
+    YoriLibInitEmptyString(&Selected);
+
+    //
+    //  Sorting reorders the items, so remember what the user selected while
+    //  the list was being populated.  Item zero is "..", which does not
+    //  move.
+    //
+
+    SelectKey = NULL;
+    if (Enum->HaveSelectKey) {
+        SelectKey = &Enum->SelectKey;
+    }
+
+    if (YoriWinListGetActiveOption(Enum->KeyList, &ActiveOption) &&
+        ActiveOption > 0 &&
+        YoriWinListGetItemText(Enum->KeyList, ActiveOption, &Selected)) {
+
+        YoriLibFreeStringContents(&Enum->SelectKey);
+        memcpy(&Enum->SelectKey, &Selected, sizeof(YORI_STRING));
+        YoriLibInitEmptyString(&Selected);
+        SelectKey = &Enum->SelectKey;
+    }
+
+    SelectValue = NULL;
+    if (Enum->HaveSelectValue) {
+        SelectValue = &Enum->SelectValue;
+    }
+
+    if (YoriWinListGetActiveOption(Enum->ValueList, &ActiveOption) &&
+        YoriWinListGetItemText(Enum->ValueList, ActiveOption, &Selected)) {
+
+        YoriLibFreeStringContents(&Enum->SelectValue);
+        memcpy(&Enum->SelectValue, &Selected, sizeof(YORI_STRING));
+        YoriLibInitEmptyString(&Selected);
+        SelectValue = &Enum->SelectValue;
+    }
+
+    if (Enum->Keys.Count > 0) {
+        YoriLibSortStringArray(Enum->Keys.Items, Enum->Keys.Count);
+    }
+    if (Enum->Values.Count > 0) {
+        YoriLibSortStringArray(Enum->Values.Items, Enum->Values.Count);
+    }
+
+    YoriWinListSetVirtualItems(Enum->KeyList, Enum->Keys.Count + 1, RegeditEnumGetKeyText);
+    YoriWinListSetVirtualItems(Enum->ValueList, Enum->Values.Count, RegeditEnumGetValueText);
+
+    //
+    //  Because of the .. entry, the key list normally moves forward one
+    //  element.  The exception is if the selection is beyond the final
+    //  element.
+    //
+
+    if (SelectKey != NULL && Enum->Keys.Count > 0) {
+        SelectIndex = RegeditStringArrayFind(&Enum->Keys, SelectKey);
+        if (SelectIndex < Enum->Keys.Count) {
+            SelectIndex++;
+        }
+        YoriWinListSetActiveOption(Enum->KeyList, SelectIndex);
+    }
+
+    if (SelectValue != NULL && Enum->Values.Count > 0) {
+        SelectIndex = RegeditStringArrayFind(&Enum->Values, SelectValue);
+        if (SelectIndex == Enum->Values.Count) {
+            SelectIndex--;
+        }
+        YoriWinListSetActiveOption(Enum->ValueList, SelectIndex);
+    }
+}
+
+/**
+ Display any names found by the background thread since the previous call.
+ If the enumeration has completed, the names are sorted and the requested
+ items are selected.
+
+ @param RegeditContext Pointer to the registry editor context.
+ */
+VOID
+RegeditEnumUpdate(
+    __in PREGEDIT_CONTEXT RegeditContext
+    )
+{
+    PREGEDIT_ENUM Enum;
+    BOOLEAN Complete;
+    BOOLEAN Changed;
+    DWORD Err;
+
+    Enum = RegeditContext->Enum;
+    if (Enum == NULL || Enum->Finished) {
+        return;
+    }
+
+    Changed = FALSE;
+    WaitForSingleObject(Enum->Mutex, INFINITE);
+    if (Enum->PendingKeys.Count > 0 || Enum->PendingValues.Count > 0) {
+        Changed = TRUE;
+    }
+    if (!RegeditStringArrayMove(&Enum->Keys, &Enum->PendingKeys) ||
+        !RegeditStringArrayMove(&Enum->Values, &Enum->PendingValues)) {
+
+        if (Enum->Error == ERROR_SUCCESS) {
+            Enum->Error = ERROR_NOT_ENOUGH_MEMORY;
+        }
+        Enum->Cancel = TRUE;
+    }
+    Complete = Enum->Complete;
+    Err = Enum->Error;
+    ReleaseMutex(Enum->Mutex);
+
+    if (!Complete) {
+        if (Changed) {
+            YoriWinListSetVirtualItems(Enum->KeyList, Enum->Keys.Count + 1, RegeditEnumGetKeyText);
+            YoriWinListSetVirtualItems(Enum->ValueList, Enum->Values.Count, RegeditEnumGetValueText);
+        }
+        return;
+    }
+
+    //
+    //  Mark the enumeration finished before anything that could process
+    //  input, so a nested timer callback finds nothing to do.
+    //
+
+    Enum->Finished = TRUE;
+    YoriWinSetPeriodicNotifyCallback(YoriWinGetControlParent(Enum->KeyList), 0, NULL);
+
+    if (Enum->Thread != NULL) {
+        WaitForSingleObject(Enum->Thread, INFINITE);
+        CloseHandle(Enum->Thread);
+        Enum->Thread = NULL;
+    }
+
+    RegeditEnumFinish(Enum);
+
+    if (Err != ERROR_SUCCESS) {
+        RegeditDisplayWin32Error(YoriWinGetControlParent(Enum->KeyList), Err);
+    }
+}
+
+/**
+ A callback invoked periodically while a key is being enumerated on a
+ background thread.
+
+ @param Ctrl Pointer to the main window.
+ */
+VOID
+RegeditEnumPeriodicCallback(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PREGEDIT_CONTEXT RegeditContext;
+
+    RegeditContext = YoriWinGetControlContext(Ctrl);
+    RegeditEnumUpdate(RegeditContext);
+}
+
+/**
+ Stop any enumeration in progress and free its state.  The key and value
+ lists are emptied, since they display names owned by the enumeration.
+
+ @param RegeditContext Pointer to the registry editor context.
+ */
+VOID
+RegeditEnumCancel(
+    __in PREGEDIT_CONTEXT RegeditContext
+    )
+{
+    PREGEDIT_ENUM Enum;
+
+    Enum = RegeditContext->Enum;
+    if (Enum == NULL) {
+        return;
+    }
+
+    if (Enum->Thread != NULL) {
+        WaitForSingleObject(Enum->Mutex, INFINITE);
+        Enum->Cancel = TRUE;
+        ReleaseMutex(Enum->Mutex);
+
+        WaitForSingleObject(Enum->Thread, INFINITE);
+        CloseHandle(Enum->Thread);
+        Enum->Thread = NULL;
+    }
+
+    if (!Enum->Finished) {
+        YoriWinSetPeriodicNotifyCallback(YoriWinGetControlParent(Enum->KeyList), 0, NULL);
+    }
+
+    YoriWinListClearAllItems(Enum->KeyList);
+    YoriWinListClearAllItems(Enum->ValueList);
+
+    RegeditContext->Enum = NULL;
+
+    RegeditStringArrayCleanup(&Enum->PendingKeys);
+    RegeditStringArrayCleanup(&Enum->PendingValues);
+    RegeditStringArrayCleanup(&Enum->Keys);
+    RegeditStringArrayCleanup(&Enum->Values);
+    YoriLibFreeStringContents(&Enum->SelectKey);
+    YoriLibFreeStringContents(&Enum->SelectValue);
+    YoriLibFreeStringContents(&Enum->Subkey);
+    if (Enum->Mutex != NULL) {
+        CloseHandle(Enum->Mutex);
+    }
+    YoriLibFree(Enum);
+}
+
+/**
+ Begin enumerating the subkeys and values within the active key.  The key
+ and value lists display the names as they are found, and once enumeration
+ completes, the names are sorted.  Enumeration occurs on a background
+ thread so that large keys do not prevent the user from interacting with
+ the display.
+
+ @param RegeditContext Pointer to the registry editor context, indicating
+        the active key.
+
+ @param KeyListCtrl Pointer to the list control containing subkeys.
+
+ @param ValueListCtrl Pointer to the list control containing values.
+
+ @param SelectKey Optionally points to a string containing a key to select
+        once enumeration completes.  Either this key, the one following it,
+        or the last key will be selected.
+
+ @param SelectValue Optionally points to a string containing a value to
+        select once enumeration completes.  Either this value, the one
+        following it, or the last value will be selected.
+
+ @return TRUE to indicate enumeration has started, FALSE on failure.  On
+         failure, the caller is expected to display an error based on
+         GetLastError.
+ */
+__success(return)
+BOOLEAN
+RegeditEnumStart(
+    __in PREGEDIT_CONTEXT RegeditContext,
+    __in PYORI_WIN_CTRL_HANDLE KeyListCtrl,
+    __in PYORI_WIN_CTRL_HANDLE ValueListCtrl,
+    __in_opt PYORI_STRING SelectKey,
+    __in_opt PYORI_STRING SelectValue
+    )
+{
+    PREGEDIT_ENUM Enum;
+    PYORI_WIN_CTRL_HANDLE Parent;
+    DWORD ThreadId;
+
+    RegeditEnumCancel(RegeditContext);
+
+    Enum = YoriLibMalloc(sizeof(REGEDIT_ENUM));
+    if (Enum == NULL) {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+
+    ZeroMemory(Enum, sizeof(REGEDIT_ENUM));
+    Enum->RootKey = RegeditContext->ActiveRootKey;
+    Enum->KeyList = KeyListCtrl;
+    Enum->ValueList = ValueListCtrl;
+    Enum->Error = ERROR_SUCCESS;
+
+    if (!YoriLibCopyString(&Enum->Subkey, &RegeditContext->Subkey)) {
+        YoriLibFree(Enum);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+
+    if (SelectKey != NULL &&
+        YoriLibCopyString(&Enum->SelectKey, SelectKey)) {
+
+        Enum->HaveSelectKey = TRUE;
+    }
+
+    if (SelectValue != NULL &&
+        YoriLibCopyString(&Enum->SelectValue, SelectValue)) {
+
+        Enum->HaveSelectValue = TRUE;
+    }
+
+    Enum->Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (Enum->Mutex == NULL) {
+        ThreadId = GetLastError();
+        YoriLibFreeStringContents(&Enum->SelectKey);
+        YoriLibFreeStringContents(&Enum->SelectValue);
+        YoriLibFreeStringContents(&Enum->Subkey);
+        YoriLibFree(Enum);
+        SetLastError(ThreadId);
+        return FALSE;
+    }
+
+    RegeditContext->Enum = Enum;
+    YoriWinListSetVirtualItems(KeyListCtrl, 1, RegeditEnumGetKeyText);
+    YoriWinListSetVirtualItems(ValueListCtrl, 0, RegeditEnumGetValueText);
+
+    Parent = YoriWinGetControlParent(KeyListCtrl);
+    if (YoriWinSetPeriodicNotifyCallback(Parent, REGEDIT_ENUM_INTERVAL, RegeditEnumPeriodicCallback)) {
+        Enum->Thread = CreateThread(NULL, 0, RegeditEnumThread, Enum, 0, &ThreadId);
+        if (Enum->Thread != NULL) {
+            WaitForSingleObject(Enum->Thread, REGEDIT_ENUM_SYNCHRONOUS_WAIT);
+            RegeditEnumUpdate(RegeditContext);
+            return TRUE;
+        }
+
+        YoriWinSetPeriodicNotifyCallback(Parent, 0, NULL);
+    }
+
+    //
+    //  If a thread cannot be created, enumerate the key now.
+    //
+
+    RegeditEnumWorker(Enum);
+    RegeditEnumUpdate(RegeditContext);
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,1299 @@
+/**
+ * @file regedit/regfind.c
+ *
+ * Yori shell registry editor search
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yoriwin.h>
+#include <yoridlg.h>
+#include "regedit.h"
+
+/**
+ The interval in milliseconds between checks for results found by the
+ search threads.
+ */
+#define REGEDIT_FIND_INTERVAL (200)
+
+/**
+ The maximum number of threads to search with.  Searching is mostly limited
+ by the registry's own locking, so beyond a handful of threads there is
+ little benefit.
+ */
+#define REGEDIT_FIND_MAX_THREADS (8)
+
+/**
+ The number of characters to allocate for a key or value name.  Value names
+ are limited to 16,383 characters, and key names are shorter than that.
+ */
+#define REGEDIT_FIND_NAME_LENGTH (16384)
+
+/**
+ The initial number of bytes to allocate for value data.  This is grown as
+ larger values are found.
+ */
+#define REGEDIT_FIND_INITIAL_DATA_SIZE (4096)
+
+/**
+ A set of well known control IDs within the search results window.
+ */
+typedef enum _REGEDIT_FIND_CONTROLS {
+    RegeditFindControlStatus = 1,
+    RegeditFindControlResultList = 2
+} REGEDIT_FIND_CONTROLS;
+
+/**
+ A key which should be searched.
+ */
+typedef struct _REGEDIT_FIND_WORK_ITEM {
+
+    /**
+     The entry for this key within the list of keys to search.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The root key containing the key to search.
+     */
+    HKEY RootKey;
+
+    /**
+     The path to the key to search, relative to RootKey.  This is NULL
+     terminated.
+     */
+    YORI_STRING Subkey;
+} REGEDIT_FIND_WORK_ITEM, *PREGEDIT_FIND_WORK_ITEM;
+
+/**
+ A key or value that matches the search.
+ */
+typedef struct _REGEDIT_FIND_RESULT {
+
+    /**
+     The text to display for this result.  This contains the full path to
+     the key, followed by the name of the value if a value matched.
+     */
+    YORI_STRING Display;
+
+    /**
+     The root key containing the match.
+     */
+    HKEY RootKey;
+
+    /**
+     The offset within Display of the path to the key, relative to RootKey.
+     */
+    YORI_ALLOC_SIZE_T SubkeyOffset;
+
+    /**
+     The length of the path to the key, relative to RootKey.
+     */
+    YORI_ALLOC_SIZE_T SubkeyLength;
+
+    /**
+     The offset within Display of the name of the value.
+     */
+    YORI_ALLOC_SIZE_T ValueOffset;
+
+    /**
+     The length of the name of the value.
+     */
+    YORI_ALLOC_SIZE_T ValueLength;
+
+    /**
+     TRUE if a value matched, FALSE if a key matched.
+     */
+    BOOLEAN ValueFound;
+} REGEDIT_FIND_RESULT, *PREGEDIT_FIND_RESULT;
+
+/**
+ A growable array of search results.
+ */
+typedef struct _REGEDIT_FIND_RESULT_ARRAY {
+
+    /**
+     Pointer to the array of results.
+     */
+    PREGEDIT_FIND_RESULT Items;
+
+    /**
+     The number of results populated in the array.
+     */
+    YORI_ALLOC_SIZE_T Count;
+
+    /**
+     The number of results allocated in the array.
+     */
+    YORI_ALLOC_SIZE_T Allocated;
+} REGEDIT_FIND_RESULT_ARRAY, *PREGEDIT_FIND_RESULT_ARRAY;
+
+/**
+ State describing a search in progress.
+ */
+typedef struct _REGEDIT_FIND_CONTEXT {
+
+    /**
+     The text being searched for.
+     */
+    YORI_STRING SearchText;
+
+    /**
+     The preprocessed form of SearchText.  This is read only once the search
+     starts, so it can be used by all threads.
+     */
+    YORI_LIB_SUBSTRING_SEARCH Search;
+
+    /**
+     A mutex protecting the fields below which are used by search threads.
+     */
+    HANDLE Mutex;
+
+    /**
+     A manual reset event which is signalled when keys are available to
+     search, when all keys have been searched, or when the search is
+     cancelled.
+     */
+    HANDLE WorkAvailableEvent;
+
+    /**
+     The list of keys which have been found but not yet searched.
+     */
+    YORI_LIST_ENTRY WorkList;
+
+    /**
+     The number of threads currently searching a key.  Once this is zero and
+     WorkList is empty, the search is complete.
+     */
+    DWORD ActiveWorkers;
+
+    /**
+     The number of search threads which have not yet exited.
+     */
+    DWORD ThreadsRunning;
+
+    /**
+     The number of search threads created.
+     */
+    DWORD ThreadCount;
+
+    /**
+     Handles to the search threads.
+     */
+    HANDLE Threads[REGEDIT_FIND_MAX_THREADS];
+
+    /**
+     Results found by the search threads which have not yet been
+     displayed.
+     */
+    REGEDIT_FIND_RESULT_ARRAY PendingResults;
+
+    /**
+     The number of keys which have been searched.
+     */
+    DWORDLONG KeysSearched;
+
+    /**
+     Results being displayed.  This is only accessed by the UI thread.
+     */
+    REGEDIT_FIND_RESULT_ARRAY Results;
+
+    /**
+     The list control displaying results.
+     */
+    PYORI_WIN_CTRL_HANDLE ResultList;
+
+    /**
+     The label displaying the progress of the search.
+     */
+    PYORI_WIN_CTRL_HANDLE StatusLabel;
+
+    /**
+     Set to TRUE to request the search threads to stop.
+     */
+    BOOLEAN Cancel;
+
+    /**
+     Set to TRUE by the UI thread once all search threads have exited and
+     the final results have been displayed.
+     */
+    BOOLEAN Finished;
+} REGEDIT_FIND_CONTEXT, *PREGEDIT_FIND_CONTEXT;
+
+/**
+ Free all results in a result array and the array itself.
+
+ @param Array Pointer to the array to free.
+ */
+VOID
+RegeditFindResultArrayCleanup(
+    __inout PREGEDIT_FIND_RESULT_ARRAY Array
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    for (Index = 0; Index < Array->Count; Index++) {
+        YoriLibFreeStringContents(&Array->Items[Index].Display);
+    }
+
+    if (Array->Items != NULL) {
+        YoriLibFree(Array->Items);
+    }
+
+    Array->Items = NULL;
+    Array->Count = 0;
+    Array->Allocated = 0;
+}
+
+/**
+ Ensure a result array has space for a number of additional results.
+
+ @param Array Pointer to the array.
+
+ @param Additional The number of results that will be added.
+
+ @return TRUE to indicate the space is available, FALSE on allocation
+         failure.
+ */
+__success(return)
+BOOLEAN
+RegeditFindResultArrayEnsureSpace(
+    __inout PREGEDIT_FIND_RESULT_ARRAY Array,
+    __in YORI_ALLOC_SIZE_T Additional
+    )
+{
+    PREGEDIT_FIND_RESULT NewItems;
+    DWORD NewAllocated;
+    DWORD BytesRequired;
+
+    if (Array->Count + Additional <= Array->Allocated) {
+        return TRUE;
+    }
+
+    NewAllocated = Array->Allocated * 2;
+    if (NewAllocated < 64) {
+        NewAllocated = 64;
+    }
+    if (NewAllocated < (DWORD)Array->Count + Additional) {
+        NewAllocated = (DWORD)Array->Count + Additional;
+    }
+
+    BytesRequired = NewAllocated * sizeof(REGEDIT_FIND_RESULT);
+    if (!YoriLibIsSizeAllocatable(NewAllocated) ||
+        !YoriLibIsSizeAllocatable(BytesRequired)) {
+
+        return FALSE;
+    }
+
+    NewItems = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesRequired);
+    if (NewItems == NULL) {
+        return FALSE;
+    }
+
+    if (Array->Count > 0) {
+        memcpy(NewItems, Array->Items, Array->Count * sizeof(REGEDIT_FIND_RESULT));
+    }
+
+    if (Array->Items != NULL) {
+        YoriLibFree(Array->Items);
+    }
+
+    Array->Items = NewItems;
+    Array->Allocated = (YORI_ALLOC_SIZE_T)NewAllocated;
+    return TRUE;
+}
+
+/**
+ Move all results from one result array to the end of another.  On success,
+ the source array is empty but retains its allocation.
+
+ @param Dest Pointer to the array to add results to.
+
+ @param Src Pointer to the array to remove results from.
+
+ @return TRUE to indicate the results were moved, FALSE on allocation
+         failure, in which case neither array is changed.
+ */
+__success(return)
+BOOLEAN
+RegeditFindResultArrayMove(
+    __inout PREGEDIT_FIND_RESULT_ARRAY Dest,
+    __inout PREGEDIT_FIND_RESULT_ARRAY Src
+    )
+{
+    if (Src->Count == 0) {
+        return TRUE;
+    }
+
+    if (!RegeditFindResultArrayEnsureSpace(Dest, Src->Count)) {
+        return FALSE;
+    }
+
+    memcpy(&Dest->Items[Dest->Count], Src->Items, Src->Count * sizeof(REGEDIT_FIND_RESULT));
+    Dest->Count = Dest->Count + Src->Count;
+    Src->Count = 0;
+    return TRUE;
+}
+
+/**
+ Record a key or value which matches the search.
+
+ @param Results Pointer to the array of results to add to.
+
+ @param RootKey The root key containing the match.
+
+ @param Subkey The path to the key containing the match, relative to
+        RootKey.
+
+ @param ValueName If a value matched, points to the name of the value.  If a
+        key matched, this is NULL.
+
+ @return TRUE to indicate the result was added, FALSE on allocation failure.
+ */
+__success(return)
+BOOLEAN
+RegeditFindAddResult(
+    __inout PREGEDIT_FIND_RESULT_ARRAY Results,
+    __in HKEY RootKey,
+    __in PYORI_STRING Subkey,
+    __in_opt PYORI_STRING ValueName
+    )
+{
+    PREGEDIT_FIND_RESULT Result;
+    PCYORI_STRING RootName;
+    YORI_STRING DefaultValueName;
+    PYORI_STRING DisplayValueName;
+    DWORD CharsRequired;
+    DWORD Index;
+
+    RootName = NULL;
+    for (Index = 0; Index < REGEDIT_ROOT_KEY_COUNT; Index++) {
+        if (RegeditRootKeys[Index].KeyHandle == RootKey) {
+            RootName = &RegeditRootKeys[Index].KeyName;
+            break;
+        }
+    }
+
+    ASSERT(RootName != NULL);
+    if (RootName == NULL) {
+        return FALSE;
+    }
+
+    YoriLibConstantString(&DefaultValueName, _T("(Default)"));
+    DisplayValueName = ValueName;
+    if (ValueName != NULL && ValueName->LengthInChars == 0) {
+        DisplayValueName = &DefaultValueName;
+    }
+
+    CharsRequired = RootName->LengthInChars + 1 + Subkey->LengthInChars + 1;
+    if (DisplayValueName != NULL) {
+        CharsRequired = CharsRequired + 2 + DisplayValueName->LengthInChars + 1;
+    }
+
+    if (!YoriLibIsSizeAllocatable(CharsRequired)) {
+        return FALSE;
+    }
+
+    if (!RegeditFindResultArrayEnsureSpace(Results, 1)) {
+        return FALSE;
+    }
+
+    Result = &Results->Items[Results->Count];
+    if (!YoriLibAllocateString(&Result->Display, (YORI_ALLOC_SIZE_T)CharsRequired)) {
+        return FALSE;
+    }
+
+    Result->RootKey = RootKey;
+    Result->SubkeyOffset = (YORI_ALLOC_SIZE_T)(RootName->LengthInChars + 1);
+    Result->SubkeyLength = Subkey->LengthInChars;
+    Result->ValueOffset = 0;
+    Result->ValueLength = 0;
+    Result->ValueFound = FALSE;
+
+    if (Subkey->LengthInChars == 0) {
+        Result->SubkeyOffset = RootName->LengthInChars;
+        Result->Display.LengthInChars = YoriLibSPrintf(Result->Display.StartOfString, _T("%y"), RootName);
+    } else {
+        Result->Display.LengthInChars = YoriLibSPrintf(Result->Display.StartOfString, _T("%y\\%y"), RootName, Subkey);
+    }
+
+    if (ValueName != NULL) {
+        ASSERT(DisplayValueName != NULL);
+        __analysis_assume(DisplayValueName != NULL);
+        Result->ValueFound = TRUE;
+        Result->ValueOffset = (YORI_ALLOC_SIZE_T)(Result->Display.LengthInChars + 2);
+        Result->ValueLength = ValueName->LengthInChars;
+        Result->Display.LengthInChars = (YORI_ALLOC_SIZE_T)(Result->Display.LengthInChars +
+            YoriLibSPrintf(&Result->Display.StartOfString[Result->Display.LengthInChars], _T(" [%y]"), DisplayValueName));
+    }
+
+    Results->Count++;
+    return TRUE;
+}
+
+/**
+ Allocate a key to be searched.
+
+ @param RootKey The root key containing the key to search.
+
+ @param ParentKey The path to the parent of the key to search, relative to
+        RootKey.
+
+ @param Name Optionally points to the name of the key to search within
+        ParentKey.  If NULL, ParentKey itself is searched.
+
+ @return Pointer to the newly allocated work item, or NULL on allocation
+         failure.
+ */
+PREGEDIT_FIND_WORK_ITEM
+RegeditFindAllocateWorkItem(
+    __in HKEY RootKey,
+    __in PYORI_STRING ParentKey,
+    __in_opt PYORI_STRING Name
+    )
+{
+    PREGEDIT_FIND_WORK_ITEM Item;
+    DWORD CharsRequired;
+
+    CharsRequired = ParentKey->LengthInChars + 1;
+    if (Name != NULL) {
+        CharsRequired = CharsRequired + 1 + Name->LengthInChars;
+    }
+
+    if (!YoriLibIsSizeAllocatable(CharsRequired)) {
+        return NULL;
+    }
+
+    Item = YoriLibMalloc(sizeof(REGEDIT_FIND_WORK_ITEM));
+    if (Item == NULL) {
+        return NULL;
+    }
+
+    if (!YoriLibAllocateString(&Item->Subkey, (YORI_ALLOC_SIZE_T)CharsRequired)) {
+        YoriLibFree(Item);
+        return NULL;
+    }
+
+    Item->RootKey = RootKey;
+    if (Name == NULL) {
+        Item->Subkey.LengthInChars = YoriLibSPrintf(Item->Subkey.StartOfString, _T("%y"), ParentKey);
+    } else if (ParentKey->LengthInChars == 0) {
+        Item->Subkey.LengthInChars = YoriLibSPrintf(Item->Subkey.StartOfString, _T("%y"), Name);
+    } else {
+        Item->Subkey.LengthInChars = YoriLibSPrintf(Item->Subkey.StartOfString, _T("%y\\%y"), ParentKey, Name);
+    }
+
+    return Item;
+}
+
+/**
+ Free a key to be searched.
+
+ @param Item Pointer to the work item to free.
+ */
+VOID
+RegeditFindFreeWorkItem(
+    __in PREGEDIT_FIND_WORK_ITEM Item
+    )
+{
+    YoriLibFreeStringContents(&Item->Subkey);
+    YoriLibFree(Item);
+}
+
+/**
+ Free all keys within a list of keys to be searched.
+
+ @param WorkList Pointer to the list of work items.
+ */
+VOID
+RegeditFindFreeWorkList(
+    __inout PYORI_LIST_ENTRY WorkList
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PREGEDIT_FIND_WORK_ITEM Item;
+
+    while (!YoriLibIsListEmpty(WorkList)) {
+        ListEntry = YoriLibGetNextListEntry(WorkList, NULL);
+        Item = CONTAINING_RECORD(ListEntry, REGEDIT_FIND_WORK_ITEM, ListEntry);
+        YoriLibRemoveListItem(ListEntry);
+        RegeditFindFreeWorkItem(Item);
+    }
+}
+
+/**
+ Search a single key.  The names of its subkeys and values are compared
+ against the search text, as is the data of string values.  Each subkey is
+ added to a list so it can be searched in turn.
+
+ @param FindContext Pointer to the search context.
+
+ @param Item Pointer to the key to search.
+
+ @param Name Pointer to a buffer to use for key and value names.
+
+ @param Data On input, points to a buffer to use for value data.  On output,
+        may be updated to point to a larger buffer.
+
+ @param DataAllocated On input, the size of the Data buffer in bytes.  On
+        output, updated to the size of the Data buffer if it changed.
+
+ @param SubkeyList Pointer to a list to which keys to search are added.
+
+ @param Results Pointer to an array to which matching keys and values are
+        added.
+ */
+VOID
+RegeditFindSearchKey(
+    __in PREGEDIT_FIND_CONTEXT FindContext,
+    __in PREGEDIT_FIND_WORK_ITEM Item,
+    __inout PYORI_STRING Name,
+    __inout PUCHAR *Data,
+    __inout PDWORD DataAllocated,
+    __inout PYORI_LIST_ENTRY SubkeyList,
+    __inout PREGEDIT_FIND_RESULT_ARRAY Results
+    )
+{
+    PREGEDIT_FIND_WORK_ITEM Subkey;
+    YORI_STRING DataString;
+    FILETIME LastWriteTime;
+    DWORD NameLength;
+    DWORD DataSize;
+    DWORD DataType;
+    DWORD Index;
+    DWORD Err;
+    HKEY Key;
+
+    Err = DllAdvApi32.pRegOpenKeyExW(Item->RootKey, Item->Subkey.StartOfString, 0, KEY_READ, &Key);
+    if (Err != ERROR_SUCCESS) {
+        return;
+    }
+
+    for (Index = 0; !FindContext->Cancel; Index++) {
+        NameLength = Name->LengthAllocated;
+        Err = DllAdvApi32.pRegEnumKeyExW(Key, Index, Name->StartOfString, &NameLength, NULL, NULL, NULL, &LastWriteTime);
+        if (Err != ERROR_SUCCESS) {
+            break;
+        }
+
+        Name->LengthInChars = (YORI_ALLOC_SIZE_T)NameLength;
+
+        Subkey = RegeditFindAllocateWorkItem(Item->RootKey, &Item->Subkey, Name);
+        if (Subkey == NULL) {
+            break;
+        }
+
+        if (YoriLibSubstringSearch(&FindContext->Search, Name, NULL)) {
+            RegeditFindAddResult(Results, Item->RootKey, &Subkey->Subkey, NULL);
+        }
+
+        YoriLibAppendList(SubkeyList, &Subkey->ListEntry);
+    }
+
+    for (Index = 0; !FindContext->Cancel; Index++) {
+        NameLength = Name->LengthAllocated;
+        DataSize = *DataAllocated;
+        Err = DllAdvApi32.pRegEnumValueW(Key, Index, Name->StartOfString, &NameLength, NULL, &DataType, *Data, &DataSize);
+
+        //
+        //  If the data doesn't fit, try to grow the buffer and query this
+        //  value again.  If the buffer can't be grown, the name can still
+        //  be compared.
+        //
+
+        if (Err == ERROR_MORE_DATA && DataSize > *DataAllocated && YoriLibIsSizeAllocatable(DataSize)) {
+            PUCHAR NewData;
+            NewData = YoriLibMalloc((YORI_ALLOC_SIZE_T)DataSize);
+            if (NewData != NULL) {
+                YoriLibFree(*Data);
+                *Data = NewData;
+                *DataAllocated = DataSize;
+                NameLength = Name->LengthAllocated;
+                Err = DllAdvApi32.pRegEnumValueW(Key, Index, Name->StartOfString, &NameLength, NULL, &DataType, *Data, &DataSize);
+            }
+        }
+
+        if (Err == ERROR_MORE_DATA) {
+            NameLength = Name->LengthAllocated;
+            DataSize = 0;
+            Err = DllAdvApi32.pRegEnumValueW(Key, Index, Name->StartOfString, &NameLength, NULL, &DataType, NULL, NULL);
+        }
+
+        if (Err != ERROR_SUCCESS) {
+            break;
+        }
+
+        Name->LengthInChars = (YORI_ALLOC_SIZE_T)NameLength;
+
+        if (YoriLibSubstringSearch(&FindContext->Search, Name, NULL)) {
+            RegeditFindAddResult(Results, Item->RootKey, &Item->Subkey, Name);
+            continue;
+        }
+
+        if (DataSize > 0 &&
+            (DataType == REG_SZ || DataType == REG_EXPAND_SZ || DataType == REG_MULTI_SZ)) {
+
+            YoriLibInitEmptyString(&DataString);
+            DataString.StartOfString = (LPTSTR)*Data;
+            DataString.LengthInChars = (YORI_ALLOC_SIZE_T)(DataSize / sizeof(TCHAR));
+            if (YoriLibSubstringSearch(&FindContext->Search, &DataString, NULL)) {
+                RegeditFindAddResult(Results, Item->RootKey, &Item->Subkey, Name);
+            }
+        }
+    }
+
+    DllAdvApi32.pRegCloseKey(Key);
+}
+
+/**
+ The entrypoint for a search thread.  Each thread removes a key from the
+ shared list of keys to search, searches it, and adds its subkeys to the
+ list, until no keys remain and no other thread is searching a key that
+ could add more.
+
+ @param Context Pointer to the search context.
+
+ @return Zero.
+ */
+DWORD WINAPI
+RegeditFindThread(
+    __in PVOID Context
+    )
+{
+    PREGEDIT_FIND_CONTEXT FindContext;
+    PREGEDIT_FIND_WORK_ITEM Item;
+    PYORI_LIST_ENTRY ListEntry;
+    REGEDIT_FIND_RESULT_ARRAY Results;
+    YORI_LIST_ENTRY SubkeyList;
+    YORI_STRING Name;
+    PUCHAR Data;
+    DWORD DataAllocated;
+
+    FindContext = (PREGEDIT_FIND_CONTEXT)Context;
+
+    Results.Items = NULL;
+    Results.Count = 0;
+    Results.Allocated = 0;
+    YoriLibInitializeListHead(&SubkeyList);
+
+    DataAllocated = REGEDIT_FIND_INITIAL_DATA_SIZE;
+    Data = YoriLibMalloc((YORI_ALLOC_SIZE_T)DataAllocated);
+    if (Data != NULL &&
+        !YoriLibAllocateString(&Name, REGEDIT_FIND_NAME_LENGTH)) {
+
+        YoriLibFree(Data);
+        Data = NULL;
+    }
+
+    WaitForSingleObject(FindContext->Mutex, INFINITE);
+    while (Data != NULL && !FindContext->Cancel) {
+
+        //
+        //  If there's no key to search and no other thread is searching
+        //  a key, the search is complete.  Wake any other thread so it
+        //  can observe this.  If another thread is still searching, it
+        //  may find more keys, so wait for it.
+        //
+
+        if (YoriLibIsListEmpty(&FindContext->WorkList)) {
+            if (FindContext->ActiveWorkers == 0) {
+                SetEvent(FindContext->WorkAvailableEvent);
+                break;
+            }
+            ReleaseMutex(FindContext->Mutex);
+            WaitForSingleObject(FindContext->WorkAvailableEvent, INFINITE);
+            WaitForSingleObject(FindContext->Mutex, INFINITE);
+            continue;
+        }
+
+        ListEntry = YoriLibGetNextListEntry(&FindContext->WorkList, NULL);
+        YoriLibRemoveListItem(ListEntry);
+        if (YoriLibIsListEmpty(&FindContext->WorkList)) {
+            ResetEvent(FindContext->WorkAvailableEvent);
+        }
+        FindContext->ActiveWorkers++;
+        ReleaseMutex(FindContext->Mutex);
+
+        Item = CONTAINING_RECORD(ListEntry, REGEDIT_FIND_WORK_ITEM, ListEntry);
+        RegeditFindSearchKey(FindContext, Item, &Name, &Data, &DataAllocated, &SubkeyList, &Results);
+        RegeditFindFreeWorkItem(Item);
+
+        WaitForSingleObject(FindContext->Mutex, INFINITE);
+        FindContext->ActiveWorkers--;
+        FindContext->KeysSearched++;
+
+        if (!YoriLibIsListEmpty(&SubkeyList)) {
+            while (!YoriLibIsListEmpty(&SubkeyList)) {
+                ListEntry = YoriLibGetNextListEntry(&SubkeyList, NULL);
+                YoriLibRemoveListItem(ListEntry);
+                YoriLibAppendList(&FindContext->WorkList, ListEntry);
+            }
+            SetEvent(FindContext->WorkAvailableEvent);
+        } else if (FindContext->ActiveWorkers == 0 &&
+                   YoriLibIsListEmpty(&FindContext->WorkList)) {
+            SetEvent(FindContext->WorkAvailableEvent);
+        }
+
+        if (!RegeditFindResultArrayMove(&FindContext->PendingResults, &Results)) {
+            RegeditFindResultArrayCleanup(&Results);
+        }
+    }
+
+    FindContext->ThreadsRunning--;
+    ReleaseMutex(FindContext->Mutex);
+
+    RegeditFindFreeWorkList(&SubkeyList);
+    RegeditFindResultArrayCleanup(&Results);
+    if (Data != NULL) {
+        YoriLibFreeStringContents(&Name);
+        YoriLibFree(Data);
+    }
+
+    return 0;
+}
+
+/**
+ Return the text of an item in the result list.
+
+ @param Ctrl Pointer to the result list control.
+
+ @param Index The index of the item to return.
+
+ @param String On successful completion, updated to point to the text of
+        the item.  This refers to memory owned by the search context.
+
+ @return TRUE to indicate the string was populated, FALSE if it was not.
+ */
+BOOLEAN
+RegeditFindGetResultText(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl,
+    __in YORI_ALLOC_SIZE_T Index,
+    __inout PYORI_STRING String
+    )
+{
+    PREGEDIT_FIND_CONTEXT FindContext;
+
+    FindContext = YoriWinGetControlContext(YoriWinGetControlParent(Ctrl));
+    if (Index >= FindContext->Results.Count) {
+        return FALSE;
+    }
+
+    String->StartOfString = FindContext->Results.Items[Index].Display.StartOfString;
+    String->LengthInChars = FindContext->Results.Items[Index].Display.LengthInChars;
+    return TRUE;
+}
+
+/**
+ Display any results found by the search threads since the previous call,
+ and update the status of the search.
+
+ @param FindContext Pointer to the search context.
+ */
+VOID
+RegeditFindUpdate(
+    __in PREGEDIT_FIND_CONTEXT FindContext
+    )
+{
+    YORI_STRING Status;
+    DWORDLONG KeysSearched;
+    BOOLEAN Changed;
+    BOOLEAN Complete;
+    BOOLEAN Cancelled;
+
+    if (FindContext->Finished) {
+        return;
+    }
+
+    WaitForSingleObject(FindContext->Mutex, INFINITE);
+    Changed = FALSE;
+    if (FindContext->PendingResults.Count > 0) {
+        if (RegeditFindResultArrayMove(&FindContext->Results, &FindContext->PendingResults)) {
+            Changed = TRUE;
+        } else {
+            FindContext->Cancel = TRUE;
+            SetEvent(FindContext->WorkAvailableEvent);
+        }
+    }
+    KeysSearched = FindContext->KeysSearched;
+    Complete = (BOOLEAN)(FindContext->ThreadsRunning == 0);
+    Cancelled = FindContext->Cancel;
+    ReleaseMutex(FindContext->Mutex);
+
+    if (Changed) {
+        YoriWinListSetVirtualItems(FindContext->ResultList, FindContext->Results.Count, RegeditFindGetResultText);
+    }
+
+    YoriLibInitEmptyString(&Status);
+    if (!Complete) {
+        YoriLibYPrintf(&Status, _T("Searching: %lli keys searched, %i found"), KeysSearched, FindContext->Results.Count);
+    } else if (Cancelled) {
+        YoriLibYPrintf(&Status, _T("Stopped: %lli keys searched, %i found"), KeysSearched, FindContext->Results.Count);
+    } else {
+        YoriLibYPrintf(&Status, _T("Complete: %lli keys searched, %i found"), KeysSearched, FindContext->Results.Count);
+    }
+
+    if (Status.StartOfString != NULL) {
+        YoriWinLabelSetCaption(FindContext->StatusLabel, &Status);
+        YoriLibFreeStringContents(&Status);
+    }
+
+    if (Complete) {
+        FindContext->Finished = TRUE;
+        YoriWinSetPeriodicNotifyCallback(YoriWinGetControlParent(FindContext->ResultList), 0, NULL);
+    }
+}
+
+/**
+ A callback invoked periodically while a search is in progress.
+
+ @param Ctrl Pointer to the search results window.
+ */
+VOID
+RegeditFindPeriodicCallback(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PREGEDIT_FIND_CONTEXT FindContext;
+
+    FindContext = YoriWinGetControlContext(Ctrl);
+    RegeditFindUpdate(FindContext);
+}
+
+/**
+ Request the search threads to stop.
+
+ @param FindContext Pointer to the search context.
+ */
+VOID
+RegeditFindStop(
+    __in PREGEDIT_FIND_CONTEXT FindContext
+    )
+{
+    WaitForSingleObject(FindContext->Mutex, INFINITE);
+    FindContext->Cancel = TRUE;
+    SetEvent(FindContext->WorkAvailableEvent);
+    ReleaseMutex(FindContext->Mutex);
+}
+
+/**
+ Callback invoked when the go button is clicked.  This closes the dialog
+ and navigates to the selected result.
+
+ @param Ctrl Pointer to the go button control.
+ */
+VOID
+RegeditFindGoButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PREGEDIT_FIND_CONTEXT FindContext;
+    YORI_ALLOC_SIZE_T ActiveOption;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    FindContext = YoriWinGetControlContext(Parent);
+
+    if (YoriWinListGetActiveOption(FindContext->ResultList, &ActiveOption)) {
+        YoriWinCloseWindow(Parent, TRUE);
+    }
+}
+
+/**
+ Callback invoked when the stop button is clicked.  This stops the search
+ while leaving the results found so far available.
+
+ @param Ctrl Pointer to the stop button control.
+ */
+VOID
+RegeditFindStopButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PREGEDIT_FIND_CONTEXT FindContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    FindContext = YoriWinGetControlContext(Parent);
+    RegeditFindStop(FindContext);
+}
+
+/**
+ Callback invoked when the close button is clicked.  This closes the dialog
+ without navigating.
+
+ @param Ctrl Pointer to the close button control.
+ */
+VOID
+RegeditFindCloseButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    Parent = YoriWinGetControlParent(Ctrl);
+    YoriWinCloseWindow(Parent, FALSE);
+}
+
+/**
+ Stop a search, wait for its threads to exit, and free the search context.
+
+ @param FindContext Pointer to the search context.
+ */
+VOID
+RegeditFindCleanup(
+    __in PREGEDIT_FIND_CONTEXT FindContext
+    )
+{
+    DWORD Index;
+
+    if (FindContext->Mutex != NULL && FindContext->WorkAvailableEvent != NULL) {
+        RegeditFindStop(FindContext);
+    }
+
+    for (Index = 0; Index < FindContext->ThreadCount; Index++) {
+        WaitForSingleObject(FindContext->Threads[Index], INFINITE);
+        CloseHandle(FindContext->Threads[Index]);
+    }
+
+    RegeditFindFreeWorkList(&FindContext->WorkList);
+    RegeditFindResultArrayCleanup(&FindContext->PendingResults);
+    RegeditFindResultArrayCleanup(&FindContext->Results);
+    YoriLibFreeStringContents(&FindContext->SearchText);
+
+    if (FindContext->WorkAvailableEvent != NULL) {
+        CloseHandle(FindContext->WorkAvailableEvent);
+    }
+
+    if (FindContext->Mutex != NULL) {
+        CloseHandle(FindContext->Mutex);
+    }
+
+    YoriLibFree(FindContext);
+}
+
+/**
+ Start the threads to search the registry.  If no thread can be created,
+ the search is performed synchronously.
+
+ @param FindContext Pointer to the search context, which has its list of
+        keys to search populated.
+ */
+VOID
+RegeditFindStartThreads(
+    __in PREGEDIT_FIND_CONTEXT FindContext
+    )
+{
+    SYSTEM_INFO SystemInfo;
+    DWORD ThreadCount;
+    DWORD ThreadId;
+    DWORD Index;
+
+    GetSystemInfo(&SystemInfo);
+    ThreadCount = SystemInfo.dwNumberOfProcessors;
+    if (ThreadCount > REGEDIT_FIND_MAX_THREADS) {
+        ThreadCount = REGEDIT_FIND_MAX_THREADS;
+    }
+    if (ThreadCount < 2) {
+        ThreadCount = 2;
+    }
+
+    //
+    //  Each thread decrements ThreadsRunning as it exits, so count all
+    //  threads before any of them start.
+    //
+
+    FindContext->ThreadsRunning = ThreadCount;
+
+    for (Index = 0; Index < ThreadCount; Index++) {
+        FindContext->Threads[Index] = CreateThread(NULL, 0, RegeditFindThread, FindContext, 0, &ThreadId);
+        if (FindContext->Threads[Index] == NULL) {
+            break;
+        }
+        FindContext->ThreadCount++;
+    }
+
+    WaitForSingleObject(FindContext->Mutex, INFINITE);
+    FindContext->ThreadsRunning = FindContext->ThreadsRunning - (ThreadCount - FindContext->ThreadCount);
+    ReleaseMutex(FindContext->Mutex);
+
+    if (FindContext->ThreadCount == 0) {
+        FindContext->ThreadsRunning = 1;
+        RegeditFindThread(FindContext);
+    }
+}
+
+/**
+ Prompt the user for text to search for, and search the active key and all
+ keys beneath it for keys, values and string data which contain the text.
+ Keys are searched by several threads, and results are displayed in a list
+ as they are found.  The user can stop the search, or select a result to
+ navigate to.
+
+ @param RegeditContext Pointer to the registry editor context, indicating
+        the active key.
+
+ @param WinMgr Pointer to the window manager.
+
+ @param RootKey On successful completion, updated to contain the root key
+        of the selected result.
+
+ @param Subkey On successful completion, updated to contain a newly
+        allocated string describing the key of the selected result,
+        relative to RootKey.
+
+ @param ValueName On successful completion, updated to contain a newly
+        allocated string describing the value of the selected result.  This
+        is empty if the result is a key.
+
+ @param ValueFound On successful completion, set to TRUE if the selected
+        result is a value, or FALSE if it is a key.
+
+ @return TRUE to indicate the user selected a result to navigate to, FALSE
+         if the search was cancelled or failed.
+ */
+__success(return)
+BOOLEAN
+RegeditFind(
+    __in PREGEDIT_CONTEXT RegeditContext,
+    __in PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgr,
+    __out PHKEY RootKey,
+    __out PYORI_STRING Subkey,
+    __out PYORI_STRING ValueName,
+    __out PBOOLEAN ValueFound
+    )
+{
+    PREGEDIT_FIND_CONTEXT FindContext;
+    PREGEDIT_FIND_WORK_ITEM Item;
+    PREGEDIT_FIND_RESULT Result;
+    PYORI_WIN_WINDOW_HANDLE Parent;
+    PYORI_WIN_CTRL_HANDLE Ctrl;
+    YORI_STRING Title;
+    YORI_STRING Caption;
+    YORI_STRING Text;
+    YORI_STRING EmptyString;
+    YORI_ALLOC_SIZE_T ActiveOption;
+    BOOLEAN MatchCase;
+    COORD WinMgrSize;
+    COORD WindowSize;
+    SMALL_RECT Area;
+    DWORD_PTR DialogResult;
+    DWORD ButtonWidth;
+    DWORD Index;
+
+    YoriLibConstantString(&Title, _T("Find"));
+    YoriLibInitEmptyString(&Text);
+    MatchCase = RegeditContext->FindMatchCase;
+
+    if (!YoriDlgFindText(WinMgr, &Title, &RegeditContext->FindText, &MatchCase, &Text)) {
+        return FALSE;
+    }
+
+    if (Text.LengthInChars == 0) {
+        YoriLibFreeStringContents(&Text);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&RegeditContext->FindText);
+    YoriLibCloneString(&RegeditContext->FindText, &Text);
+    RegeditContext->FindMatchCase = MatchCase;
+
+    FindContext = YoriLibMalloc(sizeof(REGEDIT_FIND_CONTEXT));
+    if (FindContext == NULL) {
+        YoriLibFreeStringContents(&Text);
+        return FALSE;
+    }
+
+    ZeroMemory(FindContext, sizeof(REGEDIT_FIND_CONTEXT));
+    YoriLibInitializeListHead(&FindContext->WorkList);
+    memcpy(&FindContext->SearchText, &Text, sizeof(YORI_STRING));
+    YoriLibPrepareSubstringSearch(&FindContext->Search, &FindContext->SearchText, (BOOLEAN)!MatchCase);
+
+    FindContext->Mutex = CreateMutex(NULL, FALSE, NULL);
+    FindContext->WorkAvailableEvent = CreateEvent(NULL, TRUE, TRUE, NULL);
+    if (FindContext->Mutex == NULL || FindContext->WorkAvailableEvent == NULL) {
+        RegeditFindCleanup(FindContext);
+        return FALSE;
+    }
+
+    //
+    //  Search the active key, or if the root keys are displayed, all of
+    //  them.
+    //
+
+    YoriLibInitEmptyString(&EmptyString);
+    if (RegeditContext->TreeDepth == 0) {
+        for (Index = 0; Index < REGEDIT_ROOT_KEY_COUNT; Index++) {
+            Item = RegeditFindAllocateWorkItem(RegeditRootKeys[Index].KeyHandle, &EmptyString, NULL);
+            if (Item != NULL) {
+                YoriLibAppendList(&FindContext->WorkList, &Item->ListEntry);
+            }
+        }
+    } else {
+        Item = RegeditFindAllocateWorkItem(RegeditContext->ActiveRootKey, &RegeditContext->Subkey, NULL);
+        if (Item != NULL) {
+            YoriLibAppendList(&FindContext->WorkList, &Item->ListEntry);
+        }
+    }
+
+    if (!YoriWinGetWinMgrDimensions(WinMgr, &WinMgrSize)) {
+        RegeditFindCleanup(FindContext);
+        return FALSE;
+    }
+
+    WindowSize.X = (WORD)(WinMgrSize.X - 10);
+    WindowSize.Y = (WORD)(WinMgrSize.Y - 4);
+
+    YoriLibConstantString(&Caption, _T("Find Results"));
+
+    if (!YoriWinCreateWindow(WinMgr, WindowSize.X, WindowSize.Y, WindowSize.X, WindowSize.Y, YORI_WIN_WINDOW_STYLE_BORDER_SINGLE | YORI_WIN_WINDOW_STYLE_SHADOW_TRANSPARENT, &Caption, &Parent)) {
+        RegeditFindCleanup(FindContext);
+        return FALSE;
+    }
+
+    YoriWinSetControlContext(Parent, FindContext);
+    YoriWinGetClientSize(Parent, &WindowSize);
+
+    Area.Left = 1;
+    Area.Top = 0;
+    Area.Right = (WORD)(WindowSize.X - 2);
+    Area.Bottom = 0;
+
+    YoriLibConstantString(&Caption, _T("Searching..."));
+
+    Ctrl = YoriWinLabelCreate(Parent, &Area, &Caption, YORI_WIN_LABEL_NO_ACCELERATOR);
+    if (Ctrl == NULL) {
+        YoriWinDestroyWindow(Parent);
+        RegeditFindCleanup(FindContext);
+        return FALSE;
+    }
+
+    YoriWinSetControlId(Ctrl, RegeditFindControlStatus);
+    FindContext->StatusLabel = Ctrl;
+
+    Area.Top = 1;
+    Area.Bottom = (WORD)(WindowSize.Y - 4);
+
+    Ctrl = YoriWinListCreate(Parent, &Area, YORI_WIN_LIST_STYLE_VSCROLLBAR | YORI_WIN_LIST_STYLE_AUTO_HSCROLLBAR);
+    if (Ctrl == NULL) {
+        YoriWinDestroyWindow(Parent);
+        RegeditFindCleanup(FindContext);
+        return FALSE;
+    }
+
+    YoriWinSetControlId(Ctrl, RegeditFindControlResultList);
+    FindContext->ResultList = Ctrl;
+    YoriWinListSetVirtualItems(Ctrl, 0, RegeditFindGetResultText);
+
+    ButtonWidth = 8;
+
+    YoriLibConstantString(&Caption, _T("&Go"));
+
+    Area.Top = (WORD)(WindowSize.Y - 3);
+    Area.Bottom = (WORD)(Area.Top + 2);
+    Area.Left = 1;
+    Area.Right = (WORD)(Area.Left + 1 + ButtonWidth);
+
+    Ctrl = YoriWinButtonCreate(Parent, &Area, &Caption, YORI_WIN_BUTTON_STYLE_DEFAULT, RegeditFindGoButtonClicked);
+    if (Ctrl == NULL) {
+        YoriWinDestroyWindow(Parent);
+        RegeditFindCleanup(FindContext);
+        return FALSE;
+    }
+
+    YoriLibConstantString(&Caption, _T("&Stop"));
+
+    Area.Left = (WORD)(Area.Right + 2);
+    Area.Right = (WORD)(Area.Left + 1 + ButtonWidth);
+
+    Ctrl = YoriWinButtonCreate(Parent, &Area, &Caption, 0, RegeditFindStopButtonClicked);
+    if (Ctrl == NULL) {
+        YoriWinDestroyWindow(Parent);
+        RegeditFindCleanup(FindContext);
+        return FALSE;
+    }
+
+    YoriLibConstantString(&Caption, _T("&Close"));
+
+    Area.Left = (WORD)(Area.Right + 2);
+    Area.Right = (WORD)(Area.Left + 1 + ButtonWidth);
+
+    Ctrl = YoriWinButtonCreate(Parent, &Area, &Caption, YORI_WIN_BUTTON_STYLE_CANCEL, RegeditFindCloseButtonClicked);
+    if (Ctrl == NULL) {
+        YoriWinDestroyWindow(Parent);
+        RegeditFindCleanup(FindContext);
+        return FALSE;
+    }
+
+    //
+    //  If a timer can't be created to display results as they are found,
+    //  the search still runs, and results are displayed when it is
+    //  complete.
+    //
+
+    YoriWinSetPeriodicNotifyCallback(Parent, REGEDIT_FIND_INTERVAL, RegeditFindPeriodicCallback);
+    RegeditFindStartThreads(FindContext);
+    if (FindContext->ThreadCount == 0) {
+        RegeditFindUpdate(FindContext);
+    }
+
+    DialogResult = FALSE;
+    if (!YoriWinProcessInputForWindow(Parent, &DialogResult)) {
+        DialogResult = FALSE;
+    }
+
+    YoriWinSetPeriodicNotifyCallback(Parent, 0, NULL);
+
+    if (DialogResult &&
+        YoriWinListGetActiveOption(FindContext->ResultList, &ActiveOption) &&
+        ActiveOption < FindContext->Results.Count) {
+
+        Result = &FindContext->Results.Items[ActiveOption];
+        YoriLibInitEmptyString(Subkey);
+        YoriLibInitEmptyString(ValueName);
+
+        if (!YoriLibAllocateString(Subkey, Result->SubkeyLength + 1) ||
+            !YoriLibAllocateString(ValueName, Result->ValueLength + 1)) {
+
+            YoriLibFreeStringContents(Subkey);
+            DialogResult = FALSE;
+        } else {
+            memcpy(Subkey->StartOfString, &Result->Display.StartOfString[Result->SubkeyOffset], Result->SubkeyLength * sizeof(TCHAR));
+            Subkey->LengthInChars = Result->SubkeyLength;
+            Subkey->StartOfString[Subkey->LengthInChars] = '\0';
+
+            memcpy(ValueName->StartOfString, &Result->Display.StartOfString[Result->ValueOffset], Result->ValueLength * sizeof(TCHAR));
+            ValueName->LengthInChars = Result->ValueLength;
+            ValueName->StartOfString[ValueName->LengthInChars] = '\0';
+
+            *RootKey = Result->RootKey;
+            *ValueFound = Result->ValueFound;
+        }
+    } else {
+        DialogResult = FALSE;
+    }
+
+    YoriWinDestroyWindow(Parent);
+    RegeditFindCleanup(FindContext);
+    return (BOOLEAN)DialogResult;
+}
+
+// vim:sw=4:ts=4:et:
@@ -26,7 +26,6 @@
 
 #include <yoripch.h>
 #include <yorilib.h>
-#include <remimu.hxx>
 
 // Modified from https://github.com/sheredom/utf8.h
 // SPDX-Licence-Identifier: Unlicense
@@ -69,11 +68,13 @@ CHAR strReplHelpText[] =
         "Output the contents of one or more files with specified text replaced\n"
         "with alternate text.\n"
         "\n"
-        "REPL [-license] [-b] [-i] [-e] [-s] <old text> [<new text> [<file>...]]\n"
+        "REPL [-license] [-b] [-i] [-e] [-j n] [-s] <old text> [<new text> [<file>...]]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -i             Match insensitively\n"
         "   -e             Perform regex match\n"
+        "   -j n           Replace text within files in place, processing up to n\n"
+        "                    files concurrently\n"
         "   -s             Process files from all subdirectories\n";
 
 /**
@@ -90,338 +91,1185 @@ ReplHelp(VOID)
     return TRUE;
 }
 
+/**
+ The maximum number of worker threads that can replace text in files
+ concurrently.
+ */
+#define REPL_MAX_WORKERS 64
+
+/**
+ The number of files that can be queued for each worker before the
+ enumerating thread waits for files to be processed.
+ */
+#define REPL_JOBS_PER_WORKER 16
+
+/**
+ The largest file that can have text replaced in place.  The file and its
+ new contents are held in memory.
+ */
+#define REPL_IN_PLACE_MAXIMUM_SIZE (YORI_MAX_ALLOC_SIZE / 4)
+
+/**
+ A file which is waiting to have text replaced by a worker thread.
+ */
+typedef struct _REPL_JOB {
+
+    /**
+     The list of jobs waiting to be processed.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The attributes of the file.
+     */
+    DWORD FileAttributes;
+
+    /**
+     The full path to the file.  The string is allocated as part of this
+     structure.
+     */
+    YORI_STRING FilePath;
+} REPL_JOB, *PREPL_JOB;
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
 typedef struct _REPL_CONTEXT {
 
-    /**
-     Records the total number of files processed.
-     */
-    LONGLONG FilesFound;
+    /**
+     Records the total number of files processed.
+     */
+    LONGLONG FilesFound;
+
+    /**
+     Records the number of files whose contents were replaced.  This is
+     updated by worker threads.
+     */
+    DWORD FilesChanged;
+
+    /**
+     TRUE if matches should be applied case insensitively, FALSE if they
+     should be applied case sensitively.
+     */
+    BOOL Insensitive;
+
+    /**
+     TRUE if a regex match should be performed.
+     */
+    BOOL RegexMatch;
+
+    /**
+     TRUE to indicate that files are being enumerated recursively.
+     */
+    BOOL Recursive;
+
+    /**
+     A string to compare with to determine a match.
+     */
+    PYORI_STRING MatchString;
+
+    /**
+     A string to replace the match with.
+     */
+    PYORI_STRING NewString;
+
+    /**
+     Encoding to use.
+     */
+    DWORD EncodingToUse;
+
+    /**
+     The compiled regular expression.
+     */
+    YORI_LIB_REGEX Regex;
+
+    /**
+     The regular expression in multibyte form.  Each worker thread compiles
+     its own copy from this.
+     */
+    char *Pattern;
+
+    /**
+     TRUE if files should be updated in place rather than output.
+     */
+    BOOLEAN InPlace;
+
+    /**
+     Set to TRUE to indicate worker threads should exit once the job list is
+     empty.
+     */
+    BOOLEAN Shutdown;
+
+    /**
+     The number of worker threads running.  If zero, files are processed
+     on the enumerating thread.
+     */
+    DWORD WorkerCount;
+
+    /**
+     An array of handles to worker threads.
+     */
+    PHANDLE Workers;
+
+    /**
+     The list of files waiting to be processed by worker threads.
+     */
+    YORI_LIST_ENTRY JobList;
+
+    /**
+     The number of files waiting in or being processed from JobList.
+     */
+    DWORD JobsQueued;
+
+    /**
+     The number of files that can be queued before the enumerating thread
+     waits.
+     */
+    DWORD MaximumJobsQueued;
+
+    /**
+     A mutex synchronizing access to the job list.
+     */
+    HANDLE Mutex;
+
+    /**
+     An event signalled when files are added to the job list.
+     */
+    HANDLE WorkAvailableEvent;
+
+    /**
+     An event signalled when a worker completes a file.
+     */
+    HANDLE JobCompleteEvent;
+
+} REPL_CONTEXT, *PREPL_CONTEXT;
+
+/**
+ State used to apply replacements to lines.  Each thread applying
+ replacements has its own copy.
+ */
+typedef struct _REPL_LINE_STATE {
+
+    /**
+     Two buffers which alternately hold the line as replacements are applied.
+     */
+    YORI_STRING AlternateStrings[2];
+
+    /**
+     A buffer holding the text to substitute for a regular expression match.
+     */
+    YORI_STRING PatchString;
+
+    /**
+     The compiled regular expression used by this thread.
+     */
+    PYORI_LIB_REGEX Regex;
+
+    /**
+     A buffer holding the multibyte form of the line for regular expression
+     matching.
+     */
+    char *Text;
+
+    /**
+     The number of bytes allocated in Text.
+     */
+    int TextAllocated;
+} REPL_LINE_STATE, *PREPL_LINE_STATE;
+
+/**
+ Initialize state used to apply replacements to lines.
+
+ @param State Pointer to the state to initialize.
+
+ @param Regex Pointer to the compiled regular expression for the thread to
+        use.
+ */
+VOID
+ReplInitializeLineState(
+    __out PREPL_LINE_STATE State,
+    __in PYORI_LIB_REGEX Regex
+    )
+{
+    YoriLibInitEmptyString(&State->AlternateStrings[0]);
+    YoriLibInitEmptyString(&State->AlternateStrings[1]);
+    YoriLibInitEmptyString(&State->PatchString);
+    State->Regex = Regex;
+    State->Text = NULL;
+    State->TextAllocated = 0;
+}
+
+/**
+ Free buffers allocated within state used to apply replacements to lines.
+
+ @param State Pointer to the state to clean up.
+ */
+VOID
+ReplCleanupLineState(
+    __inout PREPL_LINE_STATE State
+    )
+{
+    YoriLibFreeStringContents(&State->AlternateStrings[0]);
+    YoriLibFreeStringContents(&State->AlternateStrings[1]);
+    YoriLibFreeStringContents(&State->PatchString);
+    if (State->Text != NULL) {
+        YoriLibFree(State->Text);
+        State->Text = NULL;
+    }
+    State->TextAllocated = 0;
+}
+
+/**
+ Apply the repl criteria to a single line.
+
+ @param ReplContext Pointer to a set of criteria to apply to the line.
+
+ @param State Pointer to buffers used by the calling thread.
+
+ @param LineString Pointer to the line.  The contents of this string may be
+        modified.
+
+ @param Modified On successful completion, set to TRUE if any replacement
+        was made.  This is not modified if no replacement was made.
+
+ @return Pointer to the line after replacements, which may be LineString or
+         a buffer within State, or NULL on allocation failure.
+ */
+PYORI_STRING
+ReplReplaceInLine(
+    __in PREPL_CONTEXT ReplContext,
+    __inout PREPL_LINE_STATE State,
+    __inout PYORI_STRING LineString,
+    __inout PBOOLEAN Modified
+    )
+{
+    YORI_STRING InitialPortion;
+    YORI_STRING TrailingPortion;
+    PYORI_STRING SourceString;
+    YORI_ALLOC_SIZE_T SearchOffset;
+    YORI_STRING SearchSubset;
+    YORI_ALLOC_SIZE_T MatchOffset;
+    YORI_ALLOC_SIZE_T MatchLength;
+    YORI_ALLOC_SIZE_T NextAlternate;
+    YORI_ALLOC_SIZE_T LengthRequired;
+
+    //
+    //  Loop through the line, finding all occurrences of the MatchString
+    //  and replacing them with NewString
+    //
+
+    SourceString = LineString;
+    SearchOffset = 0;
+    NextAlternate = 0;
+
+    //
+    //  For regex matching, convert the line to UTF8
+    //
+
+    if (ReplContext->RegexMatch) {
+        YORI_ALLOC_SIZE_T offset = 0;
+        const int cbtext = WideCharToMultiByte(ReplContext->EncodingToUse, 0, LineString->StartOfString, LineString->LengthInChars, NULL, 0, NULL, NULL);
+        char *text;
+
+        if (ReplContext->Insensitive && DllUser32.pCharLowerBuffW) {
+            SourceString = &State->AlternateStrings[NextAlternate];
+            NextAlternate = (NextAlternate + 1) % 2;
+            if (!YoriLibCopyString(SourceString, LineString)) {
+                return NULL;
+            }
+            DllUser32.pCharLowerBuffW(LineString->StartOfString, LineString->LengthInChars);
+        }
+
+        if (State->TextAllocated < cbtext + 1) {
+            if (State->Text != NULL) {
+                YoriLibFree(State->Text);
+            }
+            State->TextAllocated = cbtext + 256;
+            State->Text = YoriLibMalloc(State->TextAllocated);
+            if (State->Text == NULL) {
+                State->TextAllocated = 0;
+                return NULL;
+            }
+        }
+        text = State->Text;
+        WideCharToMultiByte(ReplContext->EncodingToUse, 0, LineString->StartOfString, LineString->LengthInChars, text, cbtext, NULL, NULL);
+        text[cbtext] = '\0';
+        MatchOffset = 0;
+        while (offset < (YORI_ALLOC_SIZE_T)cbtext) {
+            YORI_ALLOC_SIZE_T Index;
+            YORI_ALLOC_SIZE_T ByteOffsetOfMatch;
+            BOOL Escaped;
+            LONG_PTR cap_pos[10];
+            LONG_PTR cap_span[10];
+            LONG_PTR length;
+
+            memset(cap_pos, 0xFF, sizeof(cap_pos));
+            memset(cap_span, 0xFF, sizeof(cap_span));
+            length = YoriLibRegexSearch(State->Regex, text, cbtext, offset, 10, cap_pos, cap_span, &ByteOffsetOfMatch);
+            if (length < 0) {
+                break;
+            }
+
+            //
+            //  Count the characters skipped before the match.  An empty
+            //  match is not replaced, since it would be found again at
+            //  the same place, so searching resumes after it.
+            //
+
+            for (Index = offset; Index < ByteOffsetOfMatch; Index++) {
+                if ((text[Index] & '\xC0') != '\x80') {
+                    ++MatchOffset;
+                }
+            }
+
+            if (length == 0) {
+                ++MatchOffset;
+                offset = ByteOffsetOfMatch + 1;
+                continue;
+            }
+
+            //
+            //  If a match is found, a new line needs to be assembled
+            //  consisting of characters already processed and not searched
+            //  for, characters before any match was found, the new string,
+            //  and any characters following the match.
+            //
+
+            Escaped = FALSE;
+            LengthRequired = 0;
+            for (Index = 0; Index < ReplContext->NewString->LengthInChars; ++Index)
+            {
+                const TCHAR Char = ReplContext->NewString->StartOfString[Index];
+                if (Escaped)
+                {
+                    Escaped = FALSE;
+                    if (Char >= '0' && Char <= '9')
+                    {
+                        YORI_ALLOC_SIZE_T Digit = Char - '0';
+                        if (cap_span[Digit] > 0)
+                        {
+                            YORI_ALLOC_SIZE_T Span = utf8nlen(text + (YORI_ALLOC_SIZE_T)cap_pos[Digit], (YORI_ALLOC_SIZE_T)cap_span[Digit]);
+                            LengthRequired += Span;
+                        }
+                        continue;
+                    }
+                }
+                else if (Char == '$')
+                {
+                    Escaped = TRUE;
+                    continue;
+                }
+                ++LengthRequired;
+            }
+
+            if (LengthRequired > State->PatchString.LengthAllocated) {
+                YoriLibFreeStringContents(&State->PatchString);
+                if (!YoriLibAllocateString(&State->PatchString, LengthRequired + 256)) {
+                    break;
+                }
+            }
+
+            Escaped = FALSE;
+            State->PatchString.LengthInChars = 0;
+            for (Index = 0; Index < ReplContext->NewString->LengthInChars; ++Index)
+            {
+                const TCHAR Char = ReplContext->NewString->StartOfString[Index];
+                if (Escaped)
+                {
+                    Escaped = FALSE;
+                    if (Char >= '0' && Char <= '9')
+                    {
+                        YORI_ALLOC_SIZE_T Digit = Char - '0';
+                        if (cap_span[Digit] > 0)
+                        {
+                            YORI_ALLOC_SIZE_T Pos = utf8nlen(text, (YORI_ALLOC_SIZE_T)cap_pos[Digit]);
+                            YORI_ALLOC_SIZE_T Span = utf8nlen(text + (YORI_ALLOC_SIZE_T)cap_pos[Digit], (YORI_ALLOC_SIZE_T)cap_span[Digit]);
+                            memcpy(State->PatchString.StartOfString + State->PatchString.LengthInChars, LineString->StartOfString + Pos, Span * sizeof(TCHAR));
+                            State->PatchString.LengthInChars += Span;
+                        }
+                        continue;
+                    }
+                }
+                else if (Char == '$')
+                {
+                    Escaped = TRUE;
+                    continue;
+                }
+                State->PatchString.StartOfString[State->PatchString.LengthInChars] = Char;
+                ++State->PatchString.LengthInChars;
+            }
+
+            MatchLength = utf8nlen(text + ByteOffsetOfMatch, (YORI_ALLOC_SIZE_T)length);
+            LengthRequired = SourceString->LengthInChars + State->PatchString.LengthInChars - MatchLength + 1;
+
+            if (LengthRequired > State->AlternateStrings[NextAlternate].LengthAllocated) {
+                YoriLibFreeStringContents(&State->AlternateStrings[NextAlternate]);
+                if (!YoriLibAllocateString(&State->AlternateStrings[NextAlternate], LengthRequired + 256)) {
+                    break;
+                }
+            }
+
+            YoriLibInitEmptyString(&InitialPortion);
+            InitialPortion.StartOfString = SourceString->StartOfString;
+            InitialPortion.LengthInChars = SearchOffset + MatchOffset;
+
+            YoriLibInitEmptyString(&TrailingPortion);
+            TrailingPortion.StartOfString = &SourceString->StartOfString[SearchOffset + MatchOffset + MatchLength];
+            TrailingPortion.LengthInChars = SourceString->LengthInChars - SearchOffset - MatchOffset - MatchLength;
+
+            State->AlternateStrings[NextAlternate].LengthInChars = YoriLibSPrintf(State->AlternateStrings[NextAlternate].StartOfString, _T("%y%y%y"), &InitialPortion, &State->PatchString, &TrailingPortion);
+
+            //
+            //  Continue searching from the newly assembled string after
+            //  the point of any substitutions.
+            //
+
+            SourceString = &State->AlternateStrings[NextAlternate];
+            *Modified = TRUE;
+            SearchOffset += MatchOffset + State->PatchString.LengthInChars;
+            NextAlternate = (NextAlternate + 1) % 2;
+
+            MatchOffset = 0;
+            offset = ByteOffsetOfMatch + (YORI_ALLOC_SIZE_T)length;
+        }
+    } else
+    while(TRUE) {
+
+        //
+        //  Continue searching after any previous replacements
+        //
+
+        YoriLibInitEmptyString(&SearchSubset);
+        SearchSubset.StartOfString = &SourceString->StartOfString[SearchOffset];
+        SearchSubset.LengthInChars = SourceString->LengthInChars - SearchOffset;
+
+        //
+        //  If no match is found, the line processing is complete
+        //
+
+        if (ReplContext->Insensitive) {
+            if (YoriLibFindFirstMatchSubstrIns(&SearchSubset, 1, ReplContext->MatchString, &MatchOffset) == NULL) {
+                break;
+            }
+        } else {
+            if (YoriLibFindFirstMatchSubstr(&SearchSubset, 1, ReplContext->MatchString, &MatchOffset) == NULL) {
+                break;
+            }
+        }
+
+        //
+        //  If a match is found, a new line needs to be assembled
+        //  consisting of characters already processed and not searched
+        //  for, characters before any match was found, the new string,
+        //  and any characters following the match.
+        //
+
+        LengthRequired = SearchOffset + SearchSubset.LengthInChars + ReplContext->NewString->LengthInChars - ReplContext->MatchString->LengthInChars + 1;
+
+        if (LengthRequired > State->AlternateStrings[NextAlternate].LengthAllocated) {
+            YoriLibFreeStringContents(&State->AlternateStrings[NextAlternate]);
+            if (!YoriLibAllocateString(&State->AlternateStrings[NextAlternate], LengthRequired + 256)) {
+                break;
+            }
+        }
+
+        YoriLibInitEmptyString(&InitialPortion);
+        InitialPortion.StartOfString = SourceString->StartOfString;
+        InitialPortion.LengthInChars = SearchOffset + MatchOffset;
+
+        YoriLibInitEmptyString(&TrailingPortion);
+        TrailingPortion.StartOfString = &SourceString->StartOfString[SearchOffset + MatchOffset + ReplContext->MatchString->LengthInChars];
+        TrailingPortion.LengthInChars = SourceString->LengthInChars - SearchOffset - MatchOffset - ReplContext->MatchString->LengthInChars;
+
+        State->AlternateStrings[NextAlternate].LengthInChars = YoriLibSPrintf(State->AlternateStrings[NextAlternate].StartOfString, _T("%y%y%y"), &InitialPortion, ReplContext->NewString, &TrailingPortion);
+
+        //
+        //  Continue searching from the newly assembled string after
+        //  the point of any substitutions.
+        //
+
+        SourceString = &State->AlternateStrings[NextAlternate];
+        *Modified = TRUE;
+        SearchOffset += MatchOffset + ReplContext->NewString->LengthInChars;
+        NextAlternate = (NextAlternate + 1) % 2;
+    }
+
+    return SourceString;
+}
+
+/**
+ Process a stream and apply the repl criteria before outputting to standard
+ output.
+
+ @param hSource The incoming stream to highlight.
+
+ @param ReplContext Pointer to a set of criteria to apply to the stream
+        before outputting.
+
+ @return TRUE for success, FALSE on failure.
+ */
+BOOL
+ReplProcessStream(
+    __in HANDLE hSource,
+    __in PREPL_CONTEXT ReplContext
+    )
+{
+    PVOID LineContext = NULL;
+    CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
+    YORI_STRING LineString;
+    PYORI_STRING SourceString;
+    REPL_LINE_STATE State;
+    BOOLEAN Modified;
+
+    YoriLibInitEmptyString(&LineString);
+    ReplInitializeLineState(&State, &ReplContext->Regex);
+
+    ReplContext->FilesFound++;
+
+    while (TRUE) {
+
+        if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
+            break;
+        }
+
+        SourceString = ReplReplaceInLine(ReplContext, &State, &LineString, &Modified);
+        if (SourceString == NULL) {
+            break;
+        }
+
+        //
+        //  Output the line.
+        //
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), SourceString);
+        if (SourceString->LengthInChars == 0 || !GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &ScreenInfo) || ScreenInfo.dwCursorPosition.X != 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+        }
+    }
+
+    YoriLibLineReadCloseOrCache(LineContext);
+    YoriLibFreeStringContents(&LineString);
+    ReplCleanupLineState(&State);
+
+    return TRUE;
+}
+
+/**
+ Display an error encountered when processing a file.
+
+ @param Operation The operation that failed.
+
+ @param FilePath Pointer to the file that could not be processed.
+
+ @param LastError The Win32 error code describing the failure.
+ */
+VOID
+ReplReportFileError(
+    __in LPCTSTR Operation,
+    __in PYORI_STRING FilePath,
+    __in DWORD LastError
+    )
+{
+    LPTSTR ErrText;
+
+    ErrText = YoriLibGetWinErrorText(LastError);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("repl: %s of %y failed: %s"), Operation, FilePath, ErrText);
+    YoriLibFreeWinErrorText(ErrText);
+}
+
+/**
+ Read the entire contents of a file and decode it into a string.
+
+ @param FilePath Pointer to the file to read, which must be NULL terminated.
+
+ @param Contents On successful completion, updated to contain the decoded
+        contents of the file.
+
+ @param Encoding On successful completion, updated to contain the encoding
+        of the file.
+
+ @param BomLength On successful completion, updated to contain the number of
+        bytes of byte order mark at the start of the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+ReplReadFileContents(
+    __in PYORI_STRING FilePath,
+    __out PYORI_STRING Contents,
+    __out PDWORD Encoding,
+    __out PDWORD BomLength
+    )
+{
+    HANDLE FileHandle;
+    LARGE_INTEGER FileSize;
+    PUCHAR Buffer;
+    DWORD BytesRead;
+    DWORD TotalRead;
+    DWORD CharCount;
+
+    YoriLibInitEmptyString(Contents);
+
+    FileHandle = CreateFile(FilePath->StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        ReplReportFileError(_T("open"), FilePath, GetLastError());
+        return FALSE;
+    }
+
+    FileSize.LowPart = GetFileSize(FileHandle, (LPDWORD)&FileSize.HighPart);
+    if (FileSize.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+        ReplReportFileError(_T("read"), FilePath, GetLastError());
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    if (FileSize.HighPart != 0 || FileSize.LowPart > REPL_IN_PLACE_MAXIMUM_SIZE) {
+        ReplReportFileError(_T("read"), FilePath, ERROR_FILE_TOO_LARGE);
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc(FileSize.LowPart + 1);
+    if (Buffer == NULL) {
+        ReplReportFileError(_T("read"), FilePath, ERROR_NOT_ENOUGH_MEMORY);
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    TotalRead = 0;
+    while (TotalRead < FileSize.LowPart) {
+        if (!ReadFile(FileHandle, &Buffer[TotalRead], FileSize.LowPart - TotalRead, &BytesRead, NULL) ||
+            BytesRead == 0) {
+
+            break;
+        }
+        TotalRead += BytesRead;
+    }
+
+    if (TotalRead < FileSize.LowPart) {
+        ReplReportFileError(_T("read"), FilePath, GetLastError());
+        YoriLibFree(Buffer);
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    CloseHandle(FileHandle);
+
+    //
+    //  Honor a byte order mark if present, and otherwise assume the file is
+    //  in the same encoding that would be used when reading it as a stream.
+    //
+
+    *BomLength = 0;
+    *Encoding = YoriLibGetMultibyteInputEncoding();
+    if (TotalRead >= 2 && Buffer[0] == 0xFF && Buffer[1] == 0xFE) {
+        *Encoding = CP_UTF16;
+        *BomLength = 2;
+    } else if (TotalRead >= 3 && Buffer[0] == 0xEF && Buffer[1] == 0xBB && Buffer[2] == 0xBF) {
+        *Encoding = CP_UTF8;
+        *BomLength = 3;
+    }
+
+    if (*Encoding == CP_UTF16) {
+        CharCount = (TotalRead - *BomLength) / sizeof(WCHAR);
+    } else {
+        CharCount = MultiByteToWideChar(*Encoding, 0, (LPCSTR)&Buffer[*BomLength], TotalRead - *BomLength, NULL, 0);
+    }
+
+    if (!YoriLibAllocateString(Contents, (YORI_ALLOC_SIZE_T)CharCount + 1)) {
+        ReplReportFileError(_T("read"), FilePath, ERROR_NOT_ENOUGH_MEMORY);
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    if (*Encoding == CP_UTF16) {
+        memcpy(Contents->StartOfString, &Buffer[*BomLength], CharCount * sizeof(WCHAR));
+    } else if (CharCount > 0) {
+        CharCount = MultiByteToWideChar(*Encoding, 0, (LPCSTR)&Buffer[*BomLength], TotalRead - *BomLength, Contents->StartOfString, CharCount);
+    }
+    Contents->LengthInChars = (YORI_ALLOC_SIZE_T)CharCount;
+    Contents->StartOfString[CharCount] = '\0';
+
+    YoriLibFree(Buffer);
+    return TRUE;
+}
+
+/**
+ Write new contents for a file.  The contents are written to a temporary
+ file in the same directory, which is then renamed over the original, so
+ the original file is never left partially written.
+
+ @param FilePath Pointer to the file to replace, which must be NULL
+        terminated.
+
+ @param FileAttributes The attributes of the original file.
+
+ @param Contents Pointer to the new contents of the file.
+
+ @param Encoding The encoding to write the file in.
+
+ @param BomLength The number of bytes of byte order mark to write before the
+        contents.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+ReplWriteFileContents(
+    __in PYORI_STRING FilePath,
+    __in DWORD FileAttributes,
+    __in PYORI_STRING Contents,
+    __in DWORD Encoding,
+    __in DWORD BomLength
+    )
+{
+    YORI_STRING TempPath;
+    HANDLE FileHandle;
+    PUCHAR Buffer;
+    DWORD BufferLength;
+    DWORD BytesWritten;
+    DWORD LastError;
+    UCHAR Bom[3];
+
+    if (Encoding == CP_UTF16) {
+        Buffer = (PUCHAR)Contents->StartOfString;
+        BufferLength = Contents->LengthInChars * sizeof(WCHAR);
+        Bom[0] = 0xFF;
+        Bom[1] = 0xFE;
+    } else {
+        BufferLength = WideCharToMultiByte(Encoding, 0, Contents->StartOfString, Contents->LengthInChars, NULL, 0, NULL, NULL);
+        Buffer = YoriLibMalloc(BufferLength + 1);
+        if (Buffer == NULL) {
+            ReplReportFileError(_T("write"), FilePath, ERROR_NOT_ENOUGH_MEMORY);
+            return FALSE;
+        }
+        BufferLength = WideCharToMultiByte(Encoding, 0, Contents->StartOfString, Contents->LengthInChars, (LPSTR)Buffer, BufferLength, NULL, NULL);
+        Bom[0] = 0xEF;
+        Bom[1] = 0xBB;
+        Bom[2] = 0xBF;
+    }
+
+    if (!YoriLibAllocateString(&TempPath, FilePath->LengthInChars + 32)) {
+        ReplReportFileError(_T("write"), FilePath, ERROR_NOT_ENOUGH_MEMORY);
+        if (Buffer != (PUCHAR)Contents->StartOfString) {
+            YoriLibFree(Buffer);
+        }
+        return FALSE;
+    }
 
-    /**
-     TRUE if matches should be applied case insensitively, FALSE if they
-     should be applied case sensitively.
-     */
-    BOOL Insensitive;
+    TempPath.LengthInChars = YoriLibSPrintf(TempPath.StartOfString, _T("%y.%x.%x.tmp"), FilePath, GetCurrentProcessId(), GetCurrentThreadId());
 
-    /**
-     TRUE if a regex match should be performed.
-     */
-    BOOL RegexMatch;
+    LastError = ERROR_SUCCESS;
+    FileHandle = CreateFile(TempPath.StartOfString,
+                            GENERIC_WRITE,
+                            0,
+                            NULL,
+                            CREATE_NEW,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
 
-    /**
-     TRUE to indicate that files are being enumerated recursively.
-     */
-    BOOL Recursive;
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        LastError = GetLastError();
+    } else {
+        if ((BomLength > 0 && !WriteFile(FileHandle, Bom, BomLength, &BytesWritten, NULL)) ||
+            !WriteFile(FileHandle, Buffer, BufferLength, &BytesWritten, NULL) ||
+            !FlushFileBuffers(FileHandle)) {
 
-    /**
-     A string to compare with to determine a match.
-     */
-    PYORI_STRING MatchString;
+            LastError = GetLastError();
+        }
+        CloseHandle(FileHandle);
 
-    /**
-     A string to replace the match with.
-     */
-    PYORI_STRING NewString;
+        //
+        //  The data is flushed before the rename, so after a crash the file
+        //  contains either the old or the new contents.
+        //
 
-    /**
-     Encoding to use.
-     */
-    DWORD EncodingToUse;
+        if (LastError == ERROR_SUCCESS) {
+            SetFileAttributes(TempPath.StartOfString, FileAttributes & ~(FILE_ATTRIBUTE_READONLY));
+            if (!MoveFileEx(TempPath.StartOfString, FilePath->StartOfString, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+                LastError = GetLastError();
+            }
+        }
 
-    /**
-     Regex tokens.
-     */
-    RegexToken tokens[1024];
-    int16_t token_count;
+        if (LastError != ERROR_SUCCESS) {
+            DeleteFile(TempPath.StartOfString);
+        }
+    }
 
-} REPL_CONTEXT, *PREPL_CONTEXT;
+    if (LastError != ERROR_SUCCESS) {
+        ReplReportFileError(_T("write"), FilePath, LastError);
+    }
+
+    YoriLibFreeStringContents(&TempPath);
+    if (Buffer != (PUCHAR)Contents->StartOfString) {
+        YoriLibFree(Buffer);
+    }
+
+    return (LastError == ERROR_SUCCESS);
+}
 
 /**
- Process a stream and apply the repl criteria before outputting to standard
- output.
+ Apply the repl criteria to a file and replace its contents if any
+ replacement was made.  Line endings and encoding are preserved.
 
- @param hSource The incoming stream to highlight.
+ @param ReplContext Pointer to a set of criteria to apply to the file.
 
- @param ReplContext Pointer to a set of criteria to apply to the stream
-        before outputting.
+ @param State Pointer to buffers used by the calling thread.
+
+ @param FilePath Pointer to the file, which must be NULL terminated.
+
+ @param FileAttributes The attributes of the file.
 
  @return TRUE for success, FALSE on failure.
  */
 BOOL
-ReplProcessStream(
-    __in HANDLE hSource,
-    __in PREPL_CONTEXT ReplContext
+ReplProcessFileInPlace(
+    __in PREPL_CONTEXT ReplContext,
+    __inout PREPL_LINE_STATE State,
+    __in PYORI_STRING FilePath,
+    __in DWORD FileAttributes
     )
 {
-    PVOID LineContext = NULL;
-    CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
+    YORI_STRING Contents;
+    YORI_STRING Output;
     YORI_STRING LineString;
-    YORI_STRING AlternateStrings[2];
-    YORI_STRING InitialPortion;
-    YORI_STRING TrailingPortion;
-    PYORI_STRING SourceString;
-    YORI_ALLOC_SIZE_T SearchOffset;
-    YORI_STRING SearchSubset;
-    YORI_STRING PatchString;
-    YORI_ALLOC_SIZE_T MatchOffset;
-    YORI_ALLOC_SIZE_T MatchLength;
-    YORI_ALLOC_SIZE_T NextAlternate;
+    PYORI_STRING Replaced;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T LineEnd;
+    YORI_ALLOC_SIZE_T BreakLength;
     YORI_ALLOC_SIZE_T LengthRequired;
+    DWORD Encoding;
+    DWORD BomLength;
+    BOOLEAN Modified;
+    BOOL Result;
 
-    YoriLibInitEmptyString(&LineString);
-    YoriLibInitEmptyString(&PatchString);
-    YoriLibInitEmptyString(&AlternateStrings[0]);
-    YoriLibInitEmptyString(&AlternateStrings[1]);
-
-    ReplContext->FilesFound++;
+    if (!ReplReadFileContents(FilePath, &Contents, &Encoding, &BomLength)) {
+        return FALSE;
+    }
 
-    while (TRUE) {
+    //
+    //  Most files in a large tree typically don't contain the text, so
+    //  check the whole file before splitting it into lines.  A match that
+    //  spans lines is only a false positive, since each line is checked
+    //  again below.  Regular expressions can contain anchors which depend
+    //  on line boundaries, so these are always split into lines.
+    //
 
-        if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
-            break;
+    if (!ReplContext->RegexMatch) {
+        if (ReplContext->Insensitive) {
+            if (YoriLibFindFirstMatchSubstrIns(&Contents, 1, ReplContext->MatchString, NULL) == NULL) {
+                YoriLibFreeStringContents(&Contents);
+                return TRUE;
+            }
+        } else {
+            if (YoriLibFindFirstMatchSubstr(&Contents, 1, ReplContext->MatchString, NULL) == NULL) {
+                YoriLibFreeStringContents(&Contents);
+                return TRUE;
+            }
         }
+    }
 
-        //
-        //  Loop through the line, finding all occurrences of the MatchString
-        //  and replacing them with NewString
-        //
+    if (!YoriLibAllocateString(&Output, Contents.LengthInChars + 1024)) {
+        ReplReportFileError(_T("write"), FilePath, ERROR_NOT_ENOUGH_MEMORY);
+        YoriLibFreeStringContents(&Contents);
+        return FALSE;
+    }
 
-        SourceString = &LineString;
-        SearchOffset = 0;
-        NextAlternate = 0;
+    Modified = FALSE;
+    Result = TRUE;
+    Index = 0;
+    while (Index < Contents.LengthInChars) {
 
         //
-        //  For regex matching, convert the line to UTF8
+        //  Find the end of the line and the length of the line break, which
+        //  is copied unchanged.
         //
 
-        if (ReplContext->RegexMatch) {
-            int offset = 0;
-            const int cbtext = WideCharToMultiByte(ReplContext->EncodingToUse, 0, LineString.StartOfString, LineString.LengthInChars, NULL, 0, NULL, NULL);
-            char *text;
+        for (LineEnd = Index; LineEnd < Contents.LengthInChars; LineEnd++) {
+            if (Contents.StartOfString[LineEnd] == '\r' || Contents.StartOfString[LineEnd] == '\n') {
+                break;
+            }
+        }
+
+        BreakLength = 0;
+        if (LineEnd < Contents.LengthInChars) {
+            BreakLength = 1;
+            if (Contents.StartOfString[LineEnd] == '\r' &&
+                LineEnd + 1 < Contents.LengthInChars &&
+                Contents.StartOfString[LineEnd + 1] == '\n') {
 
-            if (ReplContext->Insensitive && DllUser32.pCharLowerBuffW) {
-                SourceString = &AlternateStrings[NextAlternate];
-                NextAlternate = (NextAlternate + 1) % 2;
-                if (!YoriLibCopyString(SourceString, &LineString)) {
-                    break;
-                }
-                DllUser32.pCharLowerBuffW(LineString.StartOfString, LineString.LengthInChars);
+                BreakLength = 2;
             }
+        }
+
+        YoriLibInitEmptyString(&LineString);
+        LineString.StartOfString = &Contents.StartOfString[Index];
+        LineString.LengthInChars = LineEnd - Index;
+
+        Replaced = ReplReplaceInLine(ReplContext, State, &LineString, &Modified);
+        if (Replaced == NULL) {
+            ReplReportFileError(_T("write"), FilePath, ERROR_NOT_ENOUGH_MEMORY);
+            Result = FALSE;
+            break;
+        }
 
-            text = YoriLibMalloc(cbtext + 1);
-            if (text == NULL) {
+        LengthRequired = Output.LengthInChars + Replaced->LengthInChars + BreakLength + 1;
+        if (LengthRequired > Output.LengthAllocated) {
+            if (!YoriLibReallocString(&Output, LengthRequired + Output.LengthAllocated / 2)) {
+                ReplReportFileError(_T("write"), FilePath, ERROR_NOT_ENOUGH_MEMORY);
+                Result = FALSE;
                 break;
             }
-            WideCharToMultiByte(ReplContext->EncodingToUse, 0, LineString.StartOfString, LineString.LengthInChars, text, cbtext, NULL, NULL);
-            text[cbtext] = '\0';
-            MatchOffset = 0;
-            while (offset < cbtext) {
-                YORI_ALLOC_SIZE_T Index;
-                BOOL Escaped;
-                ptrdiff_t cap_pos[10];
-                ptrdiff_t cap_span[10];
-                int length;
-
-                if ((text[offset] & '\xC0') == '\x80') {
-                    ++offset;
-                    continue;
-                }
+        }
 
-                memset(cap_pos, 0xFF, sizeof(cap_pos));
-                memset(cap_span, 0xFF, sizeof(cap_span));
-                length = (int)regex_match(ReplContext->tokens, text, offset, 10, cap_pos, cap_span);
-                if (length <= 0)
-                {
-                    ++MatchOffset;
-                    ++offset;
-                    continue;
-                }
+        memcpy(&Output.StartOfString[Output.LengthInChars], Replaced->StartOfString, Replaced->LengthInChars * sizeof(TCHAR));
+        Output.LengthInChars = Output.LengthInChars + Replaced->LengthInChars;
+        memcpy(&Output.StartOfString[Output.LengthInChars], &Contents.StartOfString[LineEnd], BreakLength * sizeof(TCHAR));
+        Output.LengthInChars = Output.LengthInChars + BreakLength;
 
-                //
-                //  If a match is found, a new line needs to be assembled
-                //  consisting of characters already processed and not searched
-                //  for, characters before any match was found, the new string,
-                //  and any characters following the match.
-                //
+        Index = LineEnd + BreakLength;
+    }
 
-                Escaped = FALSE;
-                LengthRequired = 0;
-                for (Index = 0; Index < ReplContext->NewString->LengthInChars; ++Index)
-                {
-                    const TCHAR Char = ReplContext->NewString->StartOfString[Index];
-                    if (Escaped)
-                    {
-                        Escaped = FALSE;
-                        if (Char >= '0' && Char <= '9')
-                        {
-                            YORI_ALLOC_SIZE_T Digit = Char - '0';
-                            if (cap_span[Digit] > 0)
-                            {
-                                YORI_ALLOC_SIZE_T Span = utf8nlen(text + (YORI_ALLOC_SIZE_T)cap_pos[Digit], (YORI_ALLOC_SIZE_T)cap_span[Digit]);
-                                LengthRequired += Span;
-                            }
-                            continue;
-                        }
-                    }
-                    else if (Char == '$')
-                    {
-                        Escaped = TRUE;
-                        continue;
-                    }
-                    ++LengthRequired;
-                }
+    YoriLibFreeStringContents(&Contents);
 
-                if (LengthRequired > PatchString.LengthAllocated) {
-                    YoriLibFreeStringContents(&PatchString);
-                    if (!YoriLibAllocateString(&PatchString, LengthRequired + 256)) {
-                        break;
-                    }
-                }
+    if (Result && Modified) {
+        Result = ReplWriteFileContents(FilePath, FileAttributes, &Output, Encoding, BomLength);
+        if (Result) {
+            InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&ReplContext->FilesChanged);
+        }
+    }
 
-                Escaped = FALSE;
-                PatchString.LengthInChars = 0;
-                for (Index = 0; Index < ReplContext->NewString->LengthInChars; ++Index)
-                {
-                    const TCHAR Char = ReplContext->NewString->StartOfString[Index];
-                    if (Escaped)
-                    {
-                        Escaped = FALSE;
-                        if (Char >= '0' && Char <= '9')
-                        {
-                            YORI_ALLOC_SIZE_T Digit = Char - '0';
-                            if (cap_span[Digit] > 0)
-                            {
-                                YORI_ALLOC_SIZE_T Pos = utf8nlen(text, (YORI_ALLOC_SIZE_T)cap_pos[Digit]);
-                                YORI_ALLOC_SIZE_T Span = utf8nlen(text + (YORI_ALLOC_SIZE_T)cap_pos[Digit], (YORI_ALLOC_SIZE_T)cap_span[Digit]);
-                                memcpy(PatchString.StartOfString + PatchString.LengthInChars, LineString.StartOfString + Pos, Span * sizeof(TCHAR));
-                                PatchString.LengthInChars += Span;
-                            }
-                            continue;
-                        }
-                    }
-                    else if (Char == '$')
-                    {
-                        Escaped = TRUE;
-                        continue;
-                    }
-                    PatchString.StartOfString[PatchString.LengthInChars] = Char;
-                    ++PatchString.LengthInChars;
-                }
+    YoriLibFreeStringContents(&Output);
+    return Result;
+}
 
-                MatchLength = utf8nlen(text + offset, length - offset);
-                LengthRequired = SourceString->LengthInChars + PatchString.LengthInChars - MatchLength + 1;
+/**
+ A worker thread that applies replacements to queued files until told to
+ exit.
 
-                if (LengthRequired > AlternateStrings[NextAlternate].LengthAllocated) {
-                    YoriLibFreeStringContents(&AlternateStrings[NextAlternate]);
-                    if (!YoriLibAllocateString(&AlternateStrings[NextAlternate], LengthRequired + 256)) {
-                        break;
-                    }
-                }
+ @param Context Pointer to the repl context.
 
-                YoriLibInitEmptyString(&InitialPortion);
-                InitialPortion.StartOfString = SourceString->StartOfString;
-                InitialPortion.LengthInChars = SearchOffset + MatchOffset;
+ @return Thread exit code, which is always zero.
+ */
+DWORD WINAPI
+ReplWorkerThread(
+    __in LPVOID Context
+    )
+{
+    PREPL_CONTEXT ReplContext;
+    PYORI_LIST_ENTRY ListEntry;
+    PREPL_JOB Job;
+    REPL_LINE_STATE State;
+    YORI_LIB_REGEX Regex;
+    BOOLEAN StateValid;
 
-                YoriLibInitEmptyString(&TrailingPortion);
-                TrailingPortion.StartOfString = &SourceString->StartOfString[SearchOffset + MatchOffset + MatchLength];
-                TrailingPortion.LengthInChars = SourceString->LengthInChars - SearchOffset - MatchOffset - MatchLength;
+    ReplContext = (PREPL_CONTEXT)Context;
 
-                AlternateStrings[NextAlternate].LengthInChars = YoriLibSPrintf(AlternateStrings[NextAlternate].StartOfString, _T("%y%y%y"), &InitialPortion, &PatchString, &TrailingPortion);
+    //
+    //  A compiled regular expression can only be used by one thread at a
+    //  time, so each worker compiles its own.
+    //
 
-                //
-                //  Continue searching from the newly assembled string after
-                //  the point of any substitutions.
-                //
+    ZeroMemory(&Regex, sizeof(Regex));
+    StateValid = TRUE;
+    if (ReplContext->RegexMatch &&
+        YoriLibRegexCompile(ReplContext->Pattern, &Regex) != 0) {
 
-                SourceString = &AlternateStrings[NextAlternate];
-                SearchOffset += MatchOffset + PatchString.LengthInChars;
-                NextAlternate = (NextAlternate + 1) % 2;
+        StateValid = FALSE;
+    }
+    ReplInitializeLineState(&State, &Regex);
 
-                MatchOffset = 0;
-                offset = length;
+    while (TRUE) {
+        WaitForSingleObject(ReplContext->Mutex, INFINITE);
+        ListEntry = YoriLibGetNextListEntry(&ReplContext->JobList, NULL);
+        if (ListEntry != NULL) {
+            YoriLibRemoveListItem(ListEntry);
+            ReleaseMutex(ReplContext->Mutex);
+
+            Job = CONTAINING_RECORD(ListEntry, REPL_JOB, ListEntry);
+            if (StateValid) {
+                ReplProcessFileInPlace(ReplContext, &State, &Job->FilePath, Job->FileAttributes);
+            } else {
+                ReplReportFileError(_T("read"), &Job->FilePath, ERROR_NOT_ENOUGH_MEMORY);
             }
-            YoriLibFree(text);
-        } else
-        while(TRUE) {
+            YoriLibFree(Job);
 
-            //
-            //  Continue searching after any previous replacements
-            //
+            WaitForSingleObject(ReplContext->Mutex, INFINITE);
+            ReplContext->JobsQueued--;
+            ReleaseMutex(ReplContext->Mutex);
+            SetEvent(ReplContext->JobCompleteEvent);
+            continue;
+        }
 
-            YoriLibInitEmptyString(&SearchSubset);
-            SearchSubset.StartOfString = &SourceString->StartOfString[SearchOffset];
-            SearchSubset.LengthInChars = SourceString->LengthInChars - SearchOffset;
+        if (ReplContext->Shutdown) {
+            ReleaseMutex(ReplContext->Mutex);
+            break;
+        }
 
-            //
-            //  If no match is found, the line processing is complete
-            //
+        ResetEvent(ReplContext->WorkAvailableEvent);
+        ReleaseMutex(ReplContext->Mutex);
+        WaitForSingleObject(ReplContext->WorkAvailableEvent, INFINITE);
+    }
 
-            if (ReplContext->Insensitive) {
-                if (YoriLibFindFirstMatchSubstrIns(&SearchSubset, 1, ReplContext->MatchString, &MatchOffset) == NULL) {
-                    break;
-                }
-            } else {
-                if (YoriLibFindFirstMatchSubstr(&SearchSubset, 1, ReplContext->MatchString, &MatchOffset) == NULL) {
-                    break;
-                }
-            }
+    ReplCleanupLineState(&State);
+    YoriLibRegexFree(&Regex);
+    return 0;
+}
 
-            //
-            //  If a match is found, a new line needs to be assembled
-            //  consisting of characters already processed and not searched
-            //  for, characters before any match was found, the new string,
-            //  and any characters following the match.
-            //
+/**
+ Queue a file to have replacements applied by a worker thread.  If too many
+ files are already queued, this waits for workers to complete some of them.
 
-            LengthRequired = SearchOffset + SearchSubset.LengthInChars + ReplContext->NewString->LengthInChars - ReplContext->MatchString->LengthInChars + 1;
+ @param ReplContext Pointer to the repl context.
 
-            if (LengthRequired > AlternateStrings[NextAlternate].LengthAllocated) {
-                YoriLibFreeStringContents(&AlternateStrings[NextAlternate]);
-                if (!YoriLibAllocateString(&AlternateStrings[NextAlternate], LengthRequired + 256)) {
-                    break;
-                }
-            }
+ @param FilePath Pointer to the full path to the file.
 
-            YoriLibInitEmptyString(&InitialPortion);
-            InitialPortion.StartOfString = SourceString->StartOfString;
-            InitialPortion.LengthInChars = SearchOffset + MatchOffset;
+ @param FileAttributes The attributes of the file.
 
-            YoriLibInitEmptyString(&TrailingPortion);
-            TrailingPortion.StartOfString = &SourceString->StartOfString[SearchOffset + MatchOffset + ReplContext->MatchString->LengthInChars];
-            TrailingPortion.LengthInChars = SourceString->LengthInChars - SearchOffset - MatchOffset - ReplContext->MatchString->LengthInChars;
+ @return TRUE to indicate the file was queued, FALSE to indicate failure.
+ */
+BOOL
+ReplQueueFile(
+    __in PREPL_CONTEXT ReplContext,
+    __in PYORI_STRING FilePath,
+    __in DWORD FileAttributes
+    )
+{
+    PREPL_JOB Job;
 
-            AlternateStrings[NextAlternate].LengthInChars = YoriLibSPrintf(AlternateStrings[NextAlternate].StartOfString, _T("%y%y%y"), &InitialPortion, ReplContext->NewString, &TrailingPortion);
+    Job = YoriLibMalloc(sizeof(REPL_JOB) + (FilePath->LengthInChars + 1) * sizeof(TCHAR));
+    if (Job == NULL) {
+        return FALSE;
+    }
 
-            //
-            //  Continue searching from the newly assembled string after
-            //  the point of any substitutions.
-            //
+    YoriLibInitEmptyString(&Job->FilePath);
+    Job->FilePath.StartOfString = (LPTSTR)(Job + 1);
+    Job->FilePath.LengthInChars = FilePath->LengthInChars;
+    Job->FilePath.LengthAllocated = FilePath->LengthInChars + 1;
+    memcpy(Job->FilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    Job->FilePath.StartOfString[FilePath->LengthInChars] = '\0';
+    Job->FileAttributes = FileAttributes;
 
-            SourceString = &AlternateStrings[NextAlternate];
-            SearchOffset += MatchOffset + ReplContext->NewString->LengthInChars;
-            NextAlternate = (NextAlternate + 1) % 2;
+    while (TRUE) {
+        WaitForSingleObject(ReplContext->Mutex, INFINITE);
+        if (ReplContext->JobsQueued < ReplContext->MaximumJobsQueued) {
+            break;
         }
+        ReleaseMutex(ReplContext->Mutex);
+        WaitForSingleObject(ReplContext->JobCompleteEvent, INFINITE);
+    }
 
-        //
-        //  Output the line.
-        //
+    YoriLibAppendList(&ReplContext->JobList, &Job->ListEntry);
+    ReplContext->JobsQueued++;
+    ReleaseMutex(ReplContext->Mutex);
+    SetEvent(ReplContext->WorkAvailableEvent);
+    return TRUE;
+}
 
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), SourceString);
-        if (SourceString->LengthInChars == 0 || !GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &ScreenInfo) || ScreenInfo.dwCursorPosition.X != 0) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+/**
+ Wait for all queued files to be processed and terminate worker threads.
+
+ @param ReplContext Pointer to the repl context.
+ */
+VOID
+ReplStopWorkers(
+    __in PREPL_CONTEXT ReplContext
+    )
+{
+    DWORD Index;
+
+    if (ReplContext->Workers != NULL) {
+        WaitForSingleObject(ReplContext->Mutex, INFINITE);
+        ReplContext->Shutdown = TRUE;
+        ReleaseMutex(ReplContext->Mutex);
+        SetEvent(ReplContext->WorkAvailableEvent);
+
+        for (Index = 0; Index < ReplContext->WorkerCount; Index++) {
+            WaitForSingleObject(ReplContext->Workers[Index], INFINITE);
+            CloseHandle(ReplContext->Workers[Index]);
         }
+        YoriLibFree(ReplContext->Workers);
+        ReplContext->Workers = NULL;
     }
+    ReplContext->WorkerCount = 0;
 
-    YoriLibLineReadCloseOrCache(LineContext);
-    YoriLibFreeStringContents(&LineString);
-    YoriLibFreeStringContents(&PatchString);
-    YoriLibFreeStringContents(&AlternateStrings[0]);
-    YoriLibFreeStringContents(&AlternateStrings[1]);
+    if (ReplContext->Mutex != NULL) {
+        CloseHandle(ReplContext->Mutex);
+        ReplContext->Mutex = NULL;
+    }
 
-    return TRUE;
+    if (ReplContext->WorkAvailableEvent != NULL) {
+        CloseHandle(ReplContext->WorkAvailableEvent);
+        ReplContext->WorkAvailableEvent = NULL;
+    }
+
+    if (ReplContext->JobCompleteEvent != NULL) {
+        CloseHandle(ReplContext->JobCompleteEvent);
+        ReplContext->JobCompleteEvent = NULL;
+    }
+}
+
+/**
+ Start worker threads to apply replacements to files in parallel.  If the
+ threads cannot be started, files are processed by the main thread.
+
+ @param ReplContext Pointer to the repl context.
+
+ @param WorkerCount The number of worker threads to start.
+ */
+VOID
+ReplStartWorkers(
+    __in PREPL_CONTEXT ReplContext,
+    __in DWORD WorkerCount
+    )
+{
+    DWORD Index;
+    DWORD ThreadId;
+
+    YoriLibInitializeListHead(&ReplContext->JobList);
+    ReplContext->JobsQueued = 0;
+    ReplContext->MaximumJobsQueued = WorkerCount * REPL_JOBS_PER_WORKER;
+    ReplContext->Shutdown = FALSE;
+
+    ReplContext->Mutex = CreateMutex(NULL, FALSE, NULL);
+    ReplContext->WorkAvailableEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    ReplContext->JobCompleteEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    ReplContext->Workers = YoriLibMalloc(WorkerCount * sizeof(HANDLE));
+
+    if (ReplContext->Mutex == NULL ||
+        ReplContext->WorkAvailableEvent == NULL ||
+        ReplContext->JobCompleteEvent == NULL ||
+        ReplContext->Workers == NULL) {
+
+        if (ReplContext->Workers != NULL) {
+            YoriLibFree(ReplContext->Workers);
+            ReplContext->Workers = NULL;
+        }
+        ReplStopWorkers(ReplContext);
+        return;
+    }
+
+    for (Index = 0; Index < WorkerCount; Index++) {
+        ReplContext->Workers[Index] = CreateThread(NULL, 0, ReplWorkerThread, ReplContext, 0, &ThreadId);
+        if (ReplContext->Workers[Index] == NULL) {
+            break;
+        }
+        ReplContext->WorkerCount++;
+    }
+
+    if (ReplContext->WorkerCount == 0) {
+        YoriLibFree(ReplContext->Workers);
+        ReplContext->Workers = NULL;
+        ReplStopWorkers(ReplContext);
+    }
 }
 
 /**
@@ -454,7 +1302,19 @@ ReplFileFoundCallback(
 
     ASSERT(YoriLibIsStringNullTerminated(FilePath));
 
-    if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+    if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 &&
+        ReplContext->InPlace) {
+
+        ReplContext->FilesFound++;
+        if (ReplContext->WorkerCount == 0 ||
+            !ReplQueueFile(ReplContext, FilePath, FileInfo->dwFileAttributes)) {
+
+            REPL_LINE_STATE State;
+            ReplInitializeLineState(&State, &ReplContext->Regex);
+            ReplProcessFileInPlace(ReplContext, &State, FilePath, FileInfo->dwFileAttributes);
+            ReplCleanupLineState(&State);
+        }
+    } else if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
         FileHandle = CreateFile(FilePath->StartOfString,
                                 GENERIC_READ,
                                 FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
@@ -576,6 +1436,9 @@ ENTRYPOINT(
     REPL_CONTEXT ReplContext;
     YORI_STRING Arg;
     YORI_STRING EmptyString;
+    LONGLONG llTemp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    DWORD WorkerCount = 0;
 
     ZeroMemory(&ReplContext, sizeof(ReplContext));
     ReplContext.EncodingToUse = YoriLibGetUsableEncoding();
@@ -602,6 +1465,21 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("e")) == 0) {
                 ReplContext.RegexMatch = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (ArgC > i + 1) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], FALSE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        llTemp > 0) {
+
+                        WorkerCount = REPL_MAX_WORKERS;
+                        if (llTemp < REPL_MAX_WORKERS) {
+                            WorkerCount = (DWORD)llTemp;
+                        }
+                        ReplContext.InPlace = TRUE;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 ReplContext.Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -671,11 +1549,19 @@ ENTRYPOINT(
 
         WideCharToMultiByte(ReplContext.EncodingToUse, 0, ReplContext.MatchString->StartOfString, ReplContext.MatchString->LengthInChars, pattern, cbpattern, NULL, NULL);
         pattern[cbpattern] = '\0';
-        ReplContext.token_count = 1024;
-        if (regex_parse(pattern, ReplContext.tokens, &ReplContext.token_count, 0) != 0) {
+        if (YoriLibRegexCompile(pattern, &ReplContext.Regex) != 0) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("repl: invalid regex\n"));
             return EXIT_FAILURE;
         }
+
+        if (WorkerCount > 1) {
+            ReplContext.Pattern = YoriLibMalloc(cbpattern + 1);
+            if (ReplContext.Pattern == NULL) {
+                YoriLibRegexFree(&ReplContext.Regex);
+                return EXIT_FAILURE;
+            }
+            memcpy(ReplContext.Pattern, pattern, cbpattern + 1);
+        }
     }
 
     if (StartArg + 1 >= ArgC) {
@@ -695,8 +1581,16 @@ ENTRYPOINT(
     //
 
     if (StartArg == 0 || StartArg >= ArgC) {
-        if (YoriLibIsStdInConsole()) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("No file or pipe for input\n"));
+        if (YoriLibIsStdInConsole() || ReplContext.InPlace) {
+            if (ReplContext.InPlace) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("repl: -j requires files to update\n"));
+            } else {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("No file or pipe for input\n"));
+            }
+            YoriLibRegexFree(&ReplContext.Regex);
+            if (ReplContext.Pattern != NULL) {
+                YoriLibFree(ReplContext.Pattern);
+            }
             return EXIT_FAILURE;
         }
 
@@ -710,6 +1604,10 @@ ENTRYPOINT(
             MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
         }
 
+        if (WorkerCount > 1) {
+            ReplStartWorkers(&ReplContext, WorkerCount);
+        }
+
         for (i = StartArg; i < ArgC; i++) {
 
             YoriLibForEachStream(&ArgV[i],
@@ -719,11 +1617,17 @@ ENTRYPOINT(
                                  ReplFileEnumerateErrorCallback,
                                  &ReplContext);
         }
+
+        ReplStopWorkers(&ReplContext);
     }
 
 #if !YORI_BUILTIN
     YoriLibLineReadCleanupCache();
 #endif
+    YoriLibRegexFree(&ReplContext.Regex);
+    if (ReplContext.Pattern != NULL) {
+        YoriLibFree(ReplContext.Pattern);
+    }
 
     if (ReplContext.FilesFound == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("repl: no matching files found\n"));
@@ -35,10 +35,11 @@ CHAR strRmdirHelpText[] =
         "\n"
         "Removes directories.\n"
         "\n"
-        "RMDIR [-license] [-b] [-r] [-s] <dir> [<dir>...]\n"
+        "RMDIR [-license] [-b] [-j] [-r] [-s] <dir> [<dir>...]\n"
         "\n"
         "   -b             Use basic search criteria for directories only\n"
         "   -f             Delete files as well as directories\n"
+        "   -j             Remove subdirectories concurrently on multiple threads\n"
         "   -l             Delete links without contents\n"
         "   -p             Delete with POSIX semantics\n"
         "   -r             Send directories to the recycle bin\n"
@@ -80,10 +81,17 @@ typedef struct _RMDIR_CONTEXT {
     BOOLEAN PosixSemantics;
 
     /**
-     The number of directories successfully removed.
+     The number of directories successfully removed.  This is updated with
+     interlocked operations since directories may be removed on multiple
+     threads.
      */
     DWORD DirectoriesRemoved;
 
+    /**
+     Objects waiting to be sent to the recycle bin.
+     */
+    YORI_LIB_RECYCLE_BATCH RecycleBatch;
+
 } RMDIR_CONTEXT, *PRMDIR_CONTEXT;
 
 BOOL
@@ -95,86 +103,48 @@ RmdirFileEnumerateErrorCallback(
     );
 
 /**
- A callback that is invoked when a file is found that matches a search criteria
- specified in the set of strings to enumerate.
-
- @param FilePath Pointer to the file path that was found.
+ Delete a file or remove a directory directly, removing any attributes that
+ prevent deletion if necessary, and display any error encountered.
 
- @param FileInfo Information about the file.
+ @param RmdirContext Pointer to the context indicating which delete mode to
+        use, and recording the number of directories removed.
 
- @param Depth Specifies the recursion depth.  Ignored in this application.
+ @param FilePath Pointer to the path of the object to delete.
 
- @param Context Pointer to a RMDIR_CONTEXT.
+ @param IsDirectory TRUE if the object is a directory, FALSE if it is a file.
 
- @return TRUE to continute enumerating, FALSE to abort.
+ @return TRUE to indicate the object was deleted, FALSE to indicate failure.
  */
 BOOL
-RmdirFileFoundCallback(
+RmdirDeleteObject(
+    __in PRMDIR_CONTEXT RmdirContext,
     __in PYORI_STRING FilePath,
-    __in PWIN32_FIND_DATA FileInfo,
-    __in DWORD Depth,
-    __in PVOID Context
+    __in BOOLEAN IsDirectory
     )
 {
     DWORD Err = NO_ERROR;
     LPTSTR ErrText;
     DWORD OldAttributes;
     DWORD NewAttributes;
-    BOOL FileDeleted;
-    PRMDIR_CONTEXT RmdirContext = (PRMDIR_CONTEXT)Context;
-
-    //
-    //  Don't delete any files that are specified on the command line
-    //  directly.  These can be deleted if they're enumerated underneath
-    //  a parent object.
-    //
-
-    if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 &&
-        Depth == 0 &&
-        !RmdirContext->DeleteFiles) {
-
-        RmdirFileEnumerateErrorCallback(FilePath, ERROR_DIRECTORY, Depth, Context);
-        return TRUE;
-    }
-
-    ASSERT(YoriLibIsStringNullTerminated(FilePath));
-
-    FileDeleted = FALSE;
 
-    //
-    //  Try to delete it.
-    //
-
-    if (RmdirContext->RecycleBin) {
-        if (YoriLibRecycleBinFile(FilePath)) {
-            if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
-                RmdirContext->DirectoriesRemoved++;
-            }
-            FileDeleted = TRUE;
+    if (RmdirContext->PosixSemantics) {
+        if (!YoriLibPosixDeleteFile(FilePath)) {
+            Err = GetLastError();
+        } else if (IsDirectory) {
+            InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&RmdirContext->DirectoriesRemoved);
         }
-    }
-
-    if (!FileDeleted) {
-        if (RmdirContext->PosixSemantics) {
-            if (!YoriLibPosixDeleteFile(FilePath)) {
-                Err = GetLastError();
-            } else if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
-                RmdirContext->DirectoriesRemoved++;
-            }
-        } else if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
-            if (!DeleteFile(FilePath->StartOfString)) {
-                Err = GetLastError();
-            }
+    } else if (!IsDirectory) {
+        if (!DeleteFile(FilePath->StartOfString)) {
+            Err = GetLastError();
+        }
+    } else {
+        if (!RemoveDirectory(FilePath->StartOfString)) {
+            Err = GetLastError();
         } else {
-            if (!RemoveDirectory(FilePath->StartOfString)) {
-                Err = GetLastError();
-            } else {
-                RmdirContext->DirectoriesRemoved++;
-            }
+            InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&RmdirContext->DirectoriesRemoved);
         }
     }
 
-
     //
     //  If it fails with access denied, try to remove any readonly, hidden or
     //  system attributes which might be getting in the way, then try the
@@ -191,7 +161,7 @@ RmdirFileFoundCallback(
 
             Err = NO_ERROR;
 
-            if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+            if (!IsDirectory) {
                 if (!DeleteFile(FilePath->StartOfString)) {
                     Err = GetLastError();
                 }
@@ -199,7 +169,7 @@ RmdirFileFoundCallback(
                 if (!RemoveDirectory(FilePath->StartOfString)) {
                     Err = GetLastError();
                 } else {
-                    RmdirContext->DirectoriesRemoved++;
+                    InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&RmdirContext->DirectoriesRemoved);
                 }
             }
 
@@ -215,13 +185,116 @@ RmdirFileFoundCallback(
 
     if (Err != NO_ERROR) {
         ErrText = YoriLibGetWinErrorText(Err);
-        if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+        if (!IsDirectory) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("rmdir: delete failed: %y: %s"), FilePath, ErrText);
         } else {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("rmdir: rmdir failed: %y: %s"), FilePath, ErrText);
         }
         YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
     }
+
+    return TRUE;
+}
+
+/**
+ A callback invoked for an object that was queued to be sent to the recycle
+ bin but could not be.  The object is deleted directly instead.
+
+ @param FilePath Pointer to the object that could not be recycled.
+
+ @param Context Pointer to the rmdir context.
+ */
+VOID
+RmdirRecycleFailedCallback(
+    __in PYORI_STRING FilePath,
+    __in PVOID Context
+    )
+{
+    PRMDIR_CONTEXT RmdirContext = (PRMDIR_CONTEXT)Context;
+    DWORD Attributes;
+    BOOLEAN IsDirectory;
+
+    //
+    //  A directory was counted as removed when it was queued.  Undo that,
+    //  since removing it directly will count it again on success.
+    //
+
+    IsDirectory = FALSE;
+    Attributes = GetFileAttributes(FilePath->StartOfString);
+    if (Attributes != (DWORD)-1 &&
+        (Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+
+        IsDirectory = TRUE;
+        InterlockedDecrement((INTERLOCKED_VOLATILE LONG *)&RmdirContext->DirectoriesRemoved);
+    }
+
+    RmdirDeleteObject(RmdirContext, FilePath, IsDirectory);
+}
+
+/**
+ A callback that is invoked when a file is found that matches a search criteria
+ specified in the set of strings to enumerate.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.
+
+ @param Depth Specifies the recursion depth.  Ignored in this application.
+
+ @param Context Pointer to a RMDIR_CONTEXT.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+RmdirFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    BOOLEAN IsDirectory;
+    PRMDIR_CONTEXT RmdirContext = (PRMDIR_CONTEXT)Context;
+
+    IsDirectory = FALSE;
+    if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+        IsDirectory = TRUE;
+    }
+
+    //
+    //  Don't delete any files that are specified on the command line
+    //  directly.  These can be deleted if they're enumerated underneath
+    //  a parent object.
+    //
+
+    if (!IsDirectory &&
+        Depth == 0 &&
+        !RmdirContext->DeleteFiles) {
+
+        RmdirFileEnumerateErrorCallback(FilePath, ERROR_DIRECTORY, Depth, Context);
+        return TRUE;
+    }
+
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+
+    //
+    //  If the user wanted it deleted via the recycle bin, queue it.  Objects
+    //  are sent in batches since each shell operation is expensive.  Since
+    //  contents are returned before their directory, a directory is always
+    //  queued after everything within it.
+    //
+
+    if (RmdirContext->RecycleBin) {
+        if (YoriLibRecycleBinBatchAdd(&RmdirContext->RecycleBatch, FilePath)) {
+            if (IsDirectory) {
+                InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&RmdirContext->DirectoriesRemoved);
+            }
+            return TRUE;
+        }
+    }
+
+    RmdirDeleteObject(RmdirContext, FilePath, IsDirectory);
     return TRUE;
 }
 
@@ -314,6 +387,7 @@ ENTRYPOINT(
     BOOLEAN Recursive;
     BOOLEAN BasicEnumeration;
     BOOLEAN DeleteLinks;
+    BOOLEAN Parallel;
     WORD MatchFlags;
     YORI_ALLOC_SIZE_T StartArg = 0;
     YORI_ALLOC_SIZE_T i;
@@ -325,6 +399,7 @@ ENTRYPOINT(
     Recursive = FALSE;
     BasicEnumeration = FALSE;
     DeleteLinks = FALSE;
+    Parallel = FALSE;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -345,6 +420,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("f")) == 0) {
                 ArgumentUnderstood = TRUE;
                 RmdirContext.DeleteFiles = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                Parallel = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
                 DeleteLinks = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -384,6 +462,23 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
+    //
+    //  When removing concurrently, POSIX semantics are used where the OS
+    //  supports them.  A directory is only reported once everything
+    //  beneath it has been deleted, and POSIX semantics ensure those names
+    //  are already gone, so it can be removed immediately without waiting
+    //  for other handles to its children to be closed.  Sending objects to
+    //  the recycle bin is not done concurrently.
+    //
+
+    if (Parallel) {
+        if (RmdirContext.RecycleBin) {
+            Parallel = FALSE;
+        } else if (DllKernel32.pSetFileInformationByHandle != NULL) {
+            RmdirContext.PosixSemantics = TRUE;
+        }
+    }
+
     if (RmdirContext.PosixSemantics &&
         DllKernel32.pSetFileInformationByHandle == NULL) {
 
@@ -404,6 +499,11 @@ ENTRYPOINT(
     if (DeleteLinks) {
         MatchFlags |= YORILIB_FILEENUM_NO_LINK_TRAVERSE;
     }
+    if (Parallel) {
+        MatchFlags |= YORILIB_FILEENUM_PARALLEL | YORILIB_FILEENUM_CONCURRENT_CALLBACKS;
+    }
+
+    YoriLibRecycleBinBatchInitialize(&RmdirContext.RecycleBatch, RmdirRecycleFailedCallback, &RmdirContext);
 
     for (i = StartArg; i < ArgC; i++) {
         YoriLibForEachFile(&ArgV[i],
@@ -414,6 +514,9 @@ ENTRYPOINT(
                            &RmdirContext);
     }
 
+    YoriLibRecycleBinBatchFlush(&RmdirContext.RecycleBatch);
+    YoriLibRecycleBinBatchCleanup(&RmdirContext.RecycleBatch);
+
     if (RmdirContext.DirectoriesRemoved == 0) {
         return EXIT_FAILURE;
     }
@@ -452,6 +452,8 @@ SdirApplyAttribute(
     {
         PYORI_LIB_FILE_FILT_COLOR_CRITERIA ThisApply;
         PYORI_LIB_FILE_FILT_COLOR_CRITERIA ColorsToApply;
+        YORI_LIB_FILE_FILT_COLOR_ENUM Enum;
+        YORI_STRING Extension;
 
         //
         //  We expect each element to be the criteria determining a match and
@@ -461,8 +463,21 @@ SdirApplyAttribute(
         ASSERT((SdirGlobal.FileColorCriteria.ElementSize == 0 &&
                 SdirGlobal.FileColorCriteria.NumberCriteria == 0) ||
                SdirGlobal.FileColorCriteria.ElementSize == sizeof(YORI_LIB_FILE_FILT_COLOR_CRITERIA));
+
+        //
+        //  Only evaluate criteria which could match this file's extension,
+        //  along with criteria that apply to all files.
+        //
+
+        if (DirEnt->Extension != NULL) {
+            YoriLibConstantString(&Extension, DirEnt->Extension);
+            YoriLibFileFiltStartColorEnum(&SdirGlobal.FileColorCriteria, &Extension, &Enum);
+        } else {
+            YoriLibFileFiltStartColorEnum(&SdirGlobal.FileColorCriteria, NULL, &Enum);
+        }
+
         ColorsToApply = (PYORI_LIB_FILE_FILT_COLOR_CRITERIA)SdirGlobal.FileColorCriteria.Criteria;
-        for (Index = 0; Index < SdirGlobal.FileColorCriteria.NumberCriteria; Index++) {
+        while (YoriLibFileFiltGetNextColorCriteria(&Enum, &Index)) {
             ThisApply = &ColorsToApply[Index];
             if (ThisApply->Match.TruthStates[ThisApply->Match.CompareFn(DirEnt, &ThisApply->Match.CompareEntry)]) {
                 YoriLibCombineColors(ThisAttribute, ThisApply->Color, &ThisAttribute);
@@ -188,6 +188,7 @@ SdirWriteStringWithAttribute (
 
     if (Opts->OutputHasAutoLineWrap) {
 
+        YoriLibFlushOutput();
         GetConsoleScreenBufferInfo(hConsole, &ScreenInfo);
 
         while (str[TCharsInBuffer] != '\0') {
@@ -416,6 +417,7 @@ SdirPressAnyKey (VOID)
     DWORD NumRead;
 
     SdirWriteString(_T("Press any key to continue..."));
+    YoriLibFlushOutput();
 
     //
     //  Loop throwing away events until we get a key pressed
@@ -343,6 +343,13 @@ SdirParseOpt (
                 OptParsed = TRUE;
             }
         }
+    } else if (Opt[0] == 'j') {
+        i = SdirStringToNum32(&Opt[1], NULL);
+        if (i > SDIR_MAX_COLLECT_WORKERS) {
+            i = SDIR_MAX_COLLECT_WORKERS;
+        }
+        Opts->CollectWorkerCount = i;
+        OptParsed = TRUE;
     } else if (Opt[0] == 'l') {
         if (Opt[1] == 'n') {
             Opts->TraverseLinks = FALSE;
@@ -43,7 +43,7 @@ PYORI_FILE_INFO SdirDirCollection;
 
 /**
  Pointer to an array of pointers to directory entries.  These pointers
- are maintained sorted based on the user's sort criteria so that files
+ are sorted based on the user's sort criteria before display so that files
  can be displayed in order from this indirection.
  */
 PYORI_FILE_INFO * SdirDirSorted;
@@ -84,12 +84,159 @@ PSDIR_SUMMARY Summary;
  */
 SDIR_GLOBAL SdirGlobal;
 
+/**
+ The number of files that can be queued for each worker before the
+ enumerating thread waits for files to be processed.
+ */
+#define SDIR_COLLECT_JOBS_PER_WORKER 16
+
+/**
+ Indicates that information which is returned from the directory enumerate
+ should be collected.
+ */
+#define SDIR_COLLECT_FROM_FIND_DATA  0x00000001
+
+/**
+ Indicates that information which requires opening or querying the file
+ should be collected.
+ */
+#define SDIR_COLLECT_FROM_FILE       0x00000002
+
+/**
+ A file which is waiting to have information collected by a worker thread.
+ */
+typedef struct _SDIR_COLLECT_JOB {
+
+    /**
+     The list of jobs waiting to be processed.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     Pointer to the directory entry to populate.
+     */
+    PYORI_FILE_INFO Entry;
+
+    /**
+     The information returned from the directory enumerate.
+     */
+    WIN32_FIND_DATA FindData;
+
+    /**
+     The full path to the file.  The string is allocated as part of this
+     structure.
+     */
+    YORI_STRING FullPath;
+} SDIR_COLLECT_JOB, *PSDIR_COLLECT_JOB;
+
+/**
+ State for threads which collect information about files in parallel.
+ */
+typedef struct _SDIR_COLLECT_WORKERS {
+
+    /**
+     The list of files waiting to be processed by worker threads.
+     */
+    YORI_LIST_ENTRY JobList;
+
+    /**
+     The number of worker threads running.  If zero, information is
+     collected while enumerating.
+     */
+    DWORD WorkerCount;
+
+    /**
+     An array of handles to worker threads.
+     */
+    PHANDLE Workers;
+
+    /**
+     The number of files waiting in or being processed from JobList.
+     */
+    DWORD JobsQueued;
+
+    /**
+     The number of files that can be queued before the enumerating thread
+     waits.
+     */
+    DWORD MaximumJobsQueued;
+
+    /**
+     A mutex synchronizing access to the job list.
+     */
+    HANDLE Mutex;
+
+    /**
+     An event signalled when files are added to the job list.
+     */
+    HANDLE WorkAvailableEvent;
+
+    /**
+     An event signalled when a worker completes a file.
+     */
+    HANDLE JobCompleteEvent;
+
+    /**
+     Set to TRUE to indicate worker threads should exit once the job list is
+     empty.
+     */
+    BOOLEAN Shutdown;
+} SDIR_COLLECT_WORKERS, *PSDIR_COLLECT_WORKERS;
+
+/**
+ State for threads which collect information about files in parallel.
+ */
+SDIR_COLLECT_WORKERS SdirCollectWorkers;
+
+/**
+ Collection functions which only use information returned from the
+ directory enumerate.  Any other collection function opens or queries the
+ file and can be performed on a worker thread.
+ */
+const SDIR_COLLECT_FN
+SdirFindDataCollectFns[] = {
+    YoriLibCollectAccessTime,
+    YoriLibCollectCreateTime,
+    YoriLibCollectFileAttributes,
+    YoriLibCollectFileExtension,
+    YoriLibCollectFileName,
+    YoriLibCollectFileSize,
+    YoriLibCollectReparseTag,
+    YoriLibCollectShortName,
+    YoriLibCollectWriteTime,
+    };
+
 BOOL
 SdirDisplayCollection(VOID);
 
 /**
- Capture all required information from a file found by the system into a
- directory entry.
+ Returns TRUE if a collection function only uses information returned from
+ the directory enumerate.
+
+ @param CollectFn The collection function.
+
+ @return TRUE if the collection function does not open or query the file,
+         FALSE if it does.
+ */
+BOOLEAN
+SdirIsCollectFnFromFindData(
+    __in SDIR_COLLECT_FN CollectFn
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < sizeof(SdirFindDataCollectFns)/sizeof(SdirFindDataCollectFns[0]); Index++) {
+        if (SdirFindDataCollectFns[Index] == CollectFn) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Collect information about a file into a directory entry for each feature
+ that needs it.
 
  @param CurrentEntry Pointer to a directory entry to populate with
         information.
@@ -98,21 +245,44 @@ SdirDisplayCollection(VOID);
 
  @param FullPath Pointer to a string referring to the full path to the file.
 
- @param ForceDisplay If TRUE, suppress processing to hide the entry because it
-        needs to be displayed unconditionally.  This is used for directory
-        headers etc.  If FALSE, the regular user specified rules are applied.
+ @param Sources Specifies which information to collect, as a combination of
+        SDIR_COLLECT_FROM_FIND_DATA and SDIR_COLLECT_FROM_FILE.
  */
 VOID
-SdirCaptureFoundItemIntoDirent (
-    __out PYORI_FILE_INFO CurrentEntry,
+SdirCollectFeatures (
+    __inout PYORI_FILE_INFO CurrentEntry,
     __in PWIN32_FIND_DATA FindData,
     __in PYORI_STRING FullPath,
-    __in BOOL ForceDisplay
-    ) 
+    __in DWORD Sources
+    )
 {
     YORI_ALLOC_SIZE_T i;
+    DWORD DesiredAccess;
+    DWORD Source;
 
-    memset(CurrentEntry, 0, sizeof(*CurrentEntry));
+    //
+    //  Find the access needed by every column that opens the file, so the
+    //  file can be opened once and that handle used for all of them.
+    //
+
+    DesiredAccess = 0;
+    if (Sources & SDIR_COLLECT_FROM_FILE) {
+        for (i = 0; i < SdirGetNumSdirOptions(); i++) {
+
+            PSDIR_FEATURE Feature;
+            Feature = SdirFeatureByOptionNumber(i);
+
+            if ((Feature->Flags & SDIR_FEATURE_COLLECT) &&
+                   SdirOptions[i].CollectFn) {
+
+                DesiredAccess |= YoriLibCollectGetRequiredAccess(SdirOptions[i].CollectFn);
+            }
+        }
+    }
+
+    if (DesiredAccess != 0) {
+        YoriLibCollectOpenSharedHandle(CurrentEntry, FindData, FullPath, DesiredAccess);
+    }
 
     //
     //  Copy over the data from Win32's FindFirstFile into our own structure.
@@ -130,10 +300,47 @@ SdirCaptureFoundItemIntoDirent (
         if ((Feature->Flags & SDIR_FEATURE_COLLECT) &&
                SdirOptions[i].CollectFn) {
 
-            SdirOptions[i].CollectFn(CurrentEntry, FindData, FullPath);
+            Source = SDIR_COLLECT_FROM_FILE;
+            if (SdirIsCollectFnFromFindData(SdirOptions[i].CollectFn)) {
+                Source = SDIR_COLLECT_FROM_FIND_DATA;
+            }
+
+            if (Sources & Source) {
+                SdirOptions[i].CollectFn(CurrentEntry, FindData, FullPath);
+            }
         }
     }
 
+    YoriLibCollectCloseSharedHandle(CurrentEntry);
+}
+
+/**
+ Capture all required information from a file found by the system into a
+ directory entry.
+
+ @param CurrentEntry Pointer to a directory entry to populate with
+        information.
+
+ @param FindData Information returned by the system when enumerating files.
+
+ @param FullPath Pointer to a string referring to the full path to the file.
+
+ @param ForceDisplay If TRUE, suppress processing to hide the entry because it
+        needs to be displayed unconditionally.  This is used for directory
+        headers etc.  If FALSE, the regular user specified rules are applied.
+ */
+VOID
+SdirCaptureFoundItemIntoDirent (
+    __out PYORI_FILE_INFO CurrentEntry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath,
+    __in BOOL ForceDisplay
+    ) 
+{
+    memset(CurrentEntry, 0, sizeof(*CurrentEntry));
+
+    SdirCollectFeatures(CurrentEntry, FindData, FullPath, SDIR_COLLECT_FROM_FIND_DATA | SDIR_COLLECT_FROM_FILE);
+
     //
     //  Determine the color to display each entry from extensions and attributes.
     //
@@ -191,37 +398,262 @@ SdirRenderAttributesFromPath (
 }
 
 /**
- Add a single found object to the set of files found so far.
+ A worker thread that collects information about queued files until told to
+ exit.
 
- @param FindData Pointer to the block of data returned from the directory as
-        part of the enumeration.
+ @param Context Unused.
 
- @param FullPath Pointer to a fully specified file name for the file.
+ @return Thread exit code, which is always zero.
+ */
+DWORD WINAPI
+SdirCollectWorkerThread(
+    __in LPVOID Context
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PSDIR_COLLECT_JOB Job;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    while (TRUE) {
+        WaitForSingleObject(SdirCollectWorkers.Mutex, INFINITE);
+        ListEntry = YoriLibGetNextListEntry(&SdirCollectWorkers.JobList, NULL);
+        if (ListEntry != NULL) {
+            YoriLibRemoveListItem(ListEntry);
+            ReleaseMutex(SdirCollectWorkers.Mutex);
+
+            Job = CONTAINING_RECORD(ListEntry, SDIR_COLLECT_JOB, ListEntry);
+            SdirCollectFeatures(Job->Entry, &Job->FindData, &Job->FullPath, SDIR_COLLECT_FROM_FILE);
+            YoriLibFree(Job);
+
+            WaitForSingleObject(SdirCollectWorkers.Mutex, INFINITE);
+            SdirCollectWorkers.JobsQueued--;
+            ReleaseMutex(SdirCollectWorkers.Mutex);
+            SetEvent(SdirCollectWorkers.JobCompleteEvent);
+            continue;
+        }
 
- @return TRUE to indicate success, FALSE to indicate failure.
+        if (SdirCollectWorkers.Shutdown) {
+            ReleaseMutex(SdirCollectWorkers.Mutex);
+            break;
+        }
+
+        ResetEvent(SdirCollectWorkers.WorkAvailableEvent);
+        ReleaseMutex(SdirCollectWorkers.Mutex);
+        WaitForSingleObject(SdirCollectWorkers.WorkAvailableEvent, INFINITE);
+    }
+
+    return 0;
+}
+
+/**
+ Queue a directory entry to have information that requires opening the file
+ collected by a worker thread.  If too many files are already queued, this
+ waits for workers to complete some of them.
+
+ @param CurrentEntry Pointer to the directory entry to populate.  This must
+        remain valid until @ref SdirWaitForCollectWorkers returns.
+
+ @param FindData Information returned by the system when enumerating files.
+
+ @param FullPath Pointer to a string referring to the full path to the file.
+
+ @return TRUE to indicate the entry was queued, FALSE to indicate failure.
  */
 BOOL
-SdirAddToCollection (
+SdirQueueCollect(
+    __in PYORI_FILE_INFO CurrentEntry,
     __in PWIN32_FIND_DATA FindData,
     __in PYORI_STRING FullPath
-    ) 
+    )
 {
-    PYORI_FILE_INFO CurrentEntry;
-    YORI_ALLOC_SIZE_T i, j;
-    DWORD CompareResult = 0;
+    PSDIR_COLLECT_JOB Job;
 
-    if (SdirDirCollectionCurrent >= SdirAllocatedDirents) {
-        if (SdirDirCollectionCurrent < ((YORI_ALLOC_SIZE_T)-1)) {
-            SdirDirCollectionCurrent++;
-        }
+    Job = YoriLibMalloc(sizeof(SDIR_COLLECT_JOB) + (FullPath->LengthInChars + 1) * sizeof(TCHAR));
+    if (Job == NULL) {
         return FALSE;
     }
 
-    CurrentEntry = &SdirDirCollection[SdirDirCollectionCurrent];
+    Job->Entry = CurrentEntry;
+    memcpy(&Job->FindData, FindData, sizeof(WIN32_FIND_DATA));
+    YoriLibInitEmptyString(&Job->FullPath);
+    Job->FullPath.StartOfString = (LPTSTR)(Job + 1);
+    Job->FullPath.LengthInChars = FullPath->LengthInChars;
+    Job->FullPath.LengthAllocated = FullPath->LengthInChars + 1;
+    memcpy(Job->FullPath.StartOfString, FullPath->StartOfString, FullPath->LengthInChars * sizeof(TCHAR));
+    Job->FullPath.StartOfString[FullPath->LengthInChars] = '\0';
+
+    while (TRUE) {
+        WaitForSingleObject(SdirCollectWorkers.Mutex, INFINITE);
+        if (SdirCollectWorkers.JobsQueued < SdirCollectWorkers.MaximumJobsQueued) {
+            break;
+        }
+        ReleaseMutex(SdirCollectWorkers.Mutex);
+        WaitForSingleObject(SdirCollectWorkers.JobCompleteEvent, INFINITE);
+    }
 
-    SdirDirCollectionCurrent++;
+    YoriLibAppendList(&SdirCollectWorkers.JobList, &Job->ListEntry);
+    SdirCollectWorkers.JobsQueued++;
+    ReleaseMutex(SdirCollectWorkers.Mutex);
+    SetEvent(SdirCollectWorkers.WorkAvailableEvent);
+    return TRUE;
+}
 
-    SdirCaptureFoundItemIntoDirent(CurrentEntry, FindData, FullPath, FALSE);
+/**
+ Wait for worker threads to complete collecting information for every
+ queued file.
+ */
+VOID
+SdirWaitForCollectWorkers(VOID)
+{
+    while (TRUE) {
+        WaitForSingleObject(SdirCollectWorkers.Mutex, INFINITE);
+        if (SdirCollectWorkers.JobsQueued == 0) {
+            ReleaseMutex(SdirCollectWorkers.Mutex);
+            break;
+        }
+        ReleaseMutex(SdirCollectWorkers.Mutex);
+        WaitForSingleObject(SdirCollectWorkers.JobCompleteEvent, INFINITE);
+    }
+}
+
+/**
+ Wait for all queued files to be processed and terminate worker threads.
+ */
+VOID
+SdirStopCollectWorkers(VOID)
+{
+    DWORD Index;
+
+    if (SdirCollectWorkers.Workers != NULL) {
+        WaitForSingleObject(SdirCollectWorkers.Mutex, INFINITE);
+        SdirCollectWorkers.Shutdown = TRUE;
+        ReleaseMutex(SdirCollectWorkers.Mutex);
+        SetEvent(SdirCollectWorkers.WorkAvailableEvent);
+
+        for (Index = 0; Index < SdirCollectWorkers.WorkerCount; Index++) {
+            WaitForSingleObject(SdirCollectWorkers.Workers[Index], INFINITE);
+            CloseHandle(SdirCollectWorkers.Workers[Index]);
+        }
+        YoriLibFree(SdirCollectWorkers.Workers);
+        SdirCollectWorkers.Workers = NULL;
+    }
+    SdirCollectWorkers.WorkerCount = 0;
+
+    if (SdirCollectWorkers.Mutex != NULL) {
+        CloseHandle(SdirCollectWorkers.Mutex);
+        SdirCollectWorkers.Mutex = NULL;
+    }
+
+    if (SdirCollectWorkers.WorkAvailableEvent != NULL) {
+        CloseHandle(SdirCollectWorkers.WorkAvailableEvent);
+        SdirCollectWorkers.WorkAvailableEvent = NULL;
+    }
+
+    if (SdirCollectWorkers.JobCompleteEvent != NULL) {
+        CloseHandle(SdirCollectWorkers.JobCompleteEvent);
+        SdirCollectWorkers.JobCompleteEvent = NULL;
+    }
+}
+
+/**
+ Start worker threads to collect information that requires opening files,
+ if the user requested it and any such information is needed.  If the
+ threads cannot be started, information is collected while enumerating.
+ */
+VOID
+SdirStartCollectWorkers(VOID)
+{
+    DWORD Index;
+    DWORD ThreadId;
+    DWORD WorkerCount;
+    BOOLEAN CollectFromFile;
+
+    WorkerCount = Opts->CollectWorkerCount;
+    if (WorkerCount <= 1) {
+        return;
+    }
+
+    CollectFromFile = FALSE;
+    for (Index = 0; Index < SdirGetNumSdirOptions(); Index++) {
+
+        PSDIR_FEATURE Feature;
+        Feature = SdirFeatureByOptionNumber(Index);
+
+        if ((Feature->Flags & SDIR_FEATURE_COLLECT) &&
+            SdirOptions[Index].CollectFn != NULL &&
+            !SdirIsCollectFnFromFindData(SdirOptions[Index].CollectFn)) {
+
+            CollectFromFile = TRUE;
+            break;
+        }
+    }
+
+    if (!CollectFromFile) {
+        return;
+    }
+
+    //
+    //  Load optional DLLs before any worker can race to load them.
+    //
+
+    YoriLibLoadAdvApi32Functions();
+    YoriLibLoadVersionFunctions();
+
+    YoriLibInitializeListHead(&SdirCollectWorkers.JobList);
+    SdirCollectWorkers.JobsQueued = 0;
+    SdirCollectWorkers.MaximumJobsQueued = WorkerCount * SDIR_COLLECT_JOBS_PER_WORKER;
+    SdirCollectWorkers.Shutdown = FALSE;
+
+    SdirCollectWorkers.Mutex = CreateMutex(NULL, FALSE, NULL);
+    SdirCollectWorkers.WorkAvailableEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    SdirCollectWorkers.JobCompleteEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    SdirCollectWorkers.Workers = YoriLibMalloc(WorkerCount * sizeof(HANDLE));
+
+    if (SdirCollectWorkers.Mutex == NULL ||
+        SdirCollectWorkers.WorkAvailableEvent == NULL ||
+        SdirCollectWorkers.JobCompleteEvent == NULL ||
+        SdirCollectWorkers.Workers == NULL) {
+
+        if (SdirCollectWorkers.Workers != NULL) {
+            YoriLibFree(SdirCollectWorkers.Workers);
+            SdirCollectWorkers.Workers = NULL;
+        }
+        SdirStopCollectWorkers();
+        return;
+    }
+
+    for (Index = 0; Index < WorkerCount; Index++) {
+        SdirCollectWorkers.Workers[Index] = CreateThread(NULL, 0, SdirCollectWorkerThread, NULL, 0, &ThreadId);
+        if (SdirCollectWorkers.Workers[Index] == NULL) {
+            break;
+        }
+        SdirCollectWorkers.WorkerCount++;
+    }
+
+    if (SdirCollectWorkers.WorkerCount == 0) {
+        YoriLibFree(SdirCollectWorkers.Workers);
+        SdirCollectWorkers.Workers = NULL;
+        SdirStopCollectWorkers();
+    }
+}
+
+/**
+ Add the most recently populated entry in the collection to the array of
+ entries to display, or remove it from the collection if it should be
+ hidden.  The array is sorted by @ref SdirSortCollection before display.
+
+ @param CurrentEntry Pointer to the most recently populated entry in the
+        collection, which must be fully populated.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SdirInsertIntoCollection (
+    __in PYORI_FILE_INFO CurrentEntry
+    )
+{
+    ASSERT(CurrentEntry == &SdirDirCollection[SdirDirCollectionCurrent - 1]);
 
     if (CurrentEntry->RenderAttributes.Ctrl & YORILIB_ATTRCTRL_HIDE) {
 
@@ -240,47 +672,207 @@ SdirAddToCollection (
     }
 
     //
-    //  Now that our internal entry is fully poulated, insert it into the
-    //  correct sorted position.  As an optimization, check if we just need
-    //  to insert at the end (for file name sort on NTFS, this is the
-    //  common case.)
+    //  Now that our internal entry is fully populated, add it to the end of
+    //  the array.  The array is sorted once the collection is complete.
     //
 
-    if (SdirDirCollectionCurrent > 1 &&
-        Opts->Sort[0].CompareFn(SdirDirSorted[SdirDirCollectionCurrent - 2], CurrentEntry) == Opts->Sort[0].CompareInverseCondition) {
+    SdirDirSorted[SdirDirCollectionCurrent - 1] = CurrentEntry;
+    return TRUE;
+}
 
-        SdirDirSorted[SdirDirCollectionCurrent - 1] = CurrentEntry;
-        return TRUE;
+/**
+ Reallocate the collection and sorted array to hold a different number of
+ entries.  Entries that have been populated so far are moved into the new
+ collection, and the sorted array is updated to refer to them.  This relies
+ on the sorted array being in collection order until the collection is
+ sorted for display.
+
+ @param EntriesRequired The number of entries to allocate.  This must be
+        larger than the number of entries populated so far.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+SdirReallocateCollection(
+    __in YORI_ALLOC_SIZE_T EntriesRequired
+    )
+{
+    PYORI_FILE_INFO NewSdirDirCollection;
+    PYORI_FILE_INFO * NewSdirDirSorted;
+    PYORI_FILE_INFO CurrentEntry;
+    YORI_MAX_UNSIGNED_T BytesRequired;
+    YORI_ALLOC_SIZE_T Index;
+
+    ASSERT(EntriesRequired > SdirDirCollectionCurrent);
+
+    BytesRequired = EntriesRequired;
+    BytesRequired = BytesRequired * sizeof(YORI_FILE_INFO);
+    if (!YoriLibIsSizeAllocatable(BytesRequired)) {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+
+    NewSdirDirCollection = YoriLibMalloc(EntriesRequired * sizeof(YORI_FILE_INFO));
+    if (NewSdirDirCollection == NULL) {
+        return FALSE;
+    }
+
+    NewSdirDirSorted = YoriLibMalloc(EntriesRequired * sizeof(PYORI_FILE_INFO));
+    if (NewSdirDirSorted == NULL) {
+        YoriLibFree(NewSdirDirCollection);
+        return FALSE;
     }
 
     //
-    //  Currently sorting is done very inefficiently by a selection sort
-    //  type algorithm.  Generally this doesn't run due to the optimization
-    //  above.  When a different sort order is requested, performance could
-    //  be improved by using a better algorithm here.
+    //  Worker threads may be populating entries, so wait for them before
+    //  moving anything.  The extension points within the file name, so it
+    //  needs to refer to the new copy of the name.
     //
 
-    for (i = 0; i < SdirDirCollectionCurrent - 1; i++) {
+    if (SdirDirCollection != NULL) {
+        SdirWaitForCollectWorkers();
 
-        for (j = 0; j < Opts->CurrentSort; j++) {
-            CompareResult = Opts->Sort[j].CompareFn(SdirDirSorted[i], CurrentEntry);
-
-            if (CompareResult == Opts->Sort[j].CompareBreakCondition ||
-                CompareResult == Opts->Sort[j].CompareInverseCondition) {
-                break;
+        for (Index = 0; Index < SdirDirCollectionCurrent; Index++) {
+            CurrentEntry = &NewSdirDirCollection[Index];
+            memcpy(CurrentEntry, &SdirDirCollection[Index], sizeof(YORI_FILE_INFO));
+            if (CurrentEntry->Extension != NULL) {
+                CurrentEntry->Extension = CurrentEntry->FileName + (SdirDirCollection[Index].Extension - SdirDirCollection[Index].FileName);
             }
+            NewSdirDirSorted[Index] = CurrentEntry;
         }
 
-        if (CompareResult == Opts->Sort[j].CompareBreakCondition) {
-            for (j = SdirDirCollectionCurrent - 1; j > i; j--) {
-                SdirDirSorted[j] = SdirDirSorted[j - 1];
+        YoriLibFree(SdirDirCollection);
+    }
+
+    if (SdirDirSorted != NULL) {
+        YoriLibFree(SdirDirSorted);
+    }
+
+    SdirDirCollection = NewSdirDirCollection;
+    SdirDirSorted = NewSdirDirSorted;
+    SdirAllocatedDirents = EntriesRequired;
+    return TRUE;
+}
+
+/**
+ Add a single found object to the set of files found so far.  If worker
+ threads are collecting information, the entry is only populated with
+ information from the directory enumerate, and is inserted into the sorted
+ array by @ref SdirCompleteCollection .
+
+ @param FindData Pointer to the block of data returned from the directory as
+        part of the enumeration.
+
+ @param FullPath Pointer to a fully specified file name for the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SdirAddToCollection (
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath
+    ) 
+{
+    PYORI_FILE_INFO CurrentEntry;
+    YORI_ALLOC_SIZE_T EntriesIncrement;
+
+    //
+    //  If the collection is full, try to grow it so the directory does not
+    //  need to be enumerated again.  If that fails, count the remaining
+    //  entries so the caller can allocate enough for all of them and
+    //  enumerate again.
+    //
+
+    if (SdirDirCollectionCurrent == SdirAllocatedDirents) {
+        EntriesIncrement = SdirAllocatedDirents / 2;
+        if (EntriesIncrement < 64) {
+            EntriesIncrement = 64;
+        }
+        if (SdirAllocatedDirents + EntriesIncrement > SdirAllocatedDirents) {
+            SdirReallocateCollection(SdirAllocatedDirents + EntriesIncrement);
+        }
+    }
+
+    if (SdirDirCollectionCurrent >= SdirAllocatedDirents) {
+        if (SdirDirCollectionCurrent < ((YORI_ALLOC_SIZE_T)-1)) {
+            SdirDirCollectionCurrent++;
+        }
+        return FALSE;
+    }
+
+    CurrentEntry = &SdirDirCollection[SdirDirCollectionCurrent];
+
+    SdirDirCollectionCurrent++;
+
+    if (SdirCollectWorkers.WorkerCount > 0) {
+        memset(CurrentEntry, 0, sizeof(*CurrentEntry));
+        SdirCollectFeatures(CurrentEntry, FindData, FullPath, SDIR_COLLECT_FROM_FIND_DATA);
+        if (!SdirQueueCollect(CurrentEntry, FindData, FullPath)) {
+            SdirCollectFeatures(CurrentEntry, FindData, FullPath, SDIR_COLLECT_FROM_FILE);
+        }
+        return TRUE;
+    }
+
+    SdirCaptureFoundItemIntoDirent(CurrentEntry, FindData, FullPath, FALSE);
+
+    return SdirInsertIntoCollection(CurrentEntry);
+}
+
+/**
+ Once worker threads have been given every file from an enumerate, wait for
+ them to complete, then apply colors, hide entries, and sort every entry
+ found by the enumerate.
+
+ @param FirstEntry The index of the first entry in the collection which was
+        found by the enumerate.
+ */
+VOID
+SdirCompleteCollection(
+    __in YORI_ALLOC_SIZE_T FirstEntry
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T EntryCount;
+    PYORI_FILE_INFO CurrentEntry;
+
+    if (SdirCollectWorkers.WorkerCount == 0) {
+        return;
+    }
+
+    SdirWaitForCollectWorkers();
+
+    //
+    //  If the collection was not large enough, the caller will enumerate
+    //  again into a larger allocation, so these entries are discarded.
+    //
+
+    if (SdirDirCollectionCurrent > SdirAllocatedDirents) {
+        return;
+    }
+
+    EntryCount = SdirDirCollectionCurrent;
+    SdirDirCollectionCurrent = FirstEntry;
+
+    for (Index = FirstEntry; Index < EntryCount; Index++) {
+        CurrentEntry = &SdirDirCollection[SdirDirCollectionCurrent];
+        if (CurrentEntry != &SdirDirCollection[Index]) {
+
+            //
+            //  The extension points within the file name, so it needs to
+            //  refer to the new copy of the name.
+            //
+
+            memcpy(CurrentEntry, &SdirDirCollection[Index], sizeof(YORI_FILE_INFO));
+            if (CurrentEntry->Extension != NULL) {
+                CurrentEntry->Extension = CurrentEntry->FileName + (SdirDirCollection[Index].Extension - SdirDirCollection[Index].FileName);
             }
-            SdirDirSorted[i] = CurrentEntry;
-            return TRUE;
         }
+        SdirDirCollectionCurrent++;
+
+        SdirApplyAttribute(CurrentEntry, FALSE, &CurrentEntry->RenderAttributes);
+        SdirInsertIntoCollection(CurrentEntry);
     }
-    SdirDirSorted[SdirDirCollectionCurrent - 1] = CurrentEntry;
-    return TRUE;
 }
 
 /**
@@ -478,68 +1070,6 @@ SdirItemFoundCallback(
     return TRUE;
 }
 
-/**
- Copy entries from one old sorted array allocation to a new allocation.
- When this occurs the pointer values in the old array need to be adjusted
- from the old allocation to the new allocation.  In addition, entries may
- have been inserted into the old collection which should not be preserved
- because they will be reenumerated.  When this occurs they will be in the
- sorted array in sorted order, so any entry beyond the end of the
- collection array should not be propagated to the new sort array.
-
- @param OldCollection Pointer to the previous array of directory entries.
-
- @param NewCollection Pointer to the new array of directory entries.  This,
-        combined with OldCollection, implies the offset adjustment to apply
-        to any entry within the sorted array.
-
- @param NumberEntriesToCopy Specifies the maximum number of entries that
-        should be copied into the new sorted array.  This is the number of
-        entries within the collection that are being preserved; newer entries
-        will be enumerated again in a subsequent operation.
-
- @param OldSorted Pointer to the previous array of sorted entries.  Entries
-        within this array will be filtered against NumberEntriesToCopy,
-        adjusted based on pointer offset, and propagated to the new array.
-
- @param NewSorted Pointer to the new array of sorted entries.  This will be
-        populated within this routine.
-
- @param NumberSortedEntries The number of elements in the OldSorted array.
- */
-VOID
-SdirMoveSortedEntries(
-    __in PYORI_FILE_INFO OldCollection,
-    __in PYORI_FILE_INFO NewCollection,
-    __in YORI_ALLOC_SIZE_T NumberEntriesToCopy,
-    __in_ecount(NumberSortedEntries) PYORI_FILE_INFO* OldSorted,
-    __out_ecount(NumberEntriesToCopy) PYORI_FILE_INFO* NewSorted,
-    __in YORI_ALLOC_SIZE_T NumberSortedEntries
-    )
-{
-    YORI_ALLOC_SIZE_T SrcIndex;
-    YORI_ALLOC_SIZE_T DestIndex;
-    PYORI_FILE_INFO ThisEntry;
-
-    DestIndex = 0;
-    for (SrcIndex = 0; SrcIndex < NumberSortedEntries; SrcIndex++) {
-        ThisEntry = (PYORI_FILE_INFO)OldSorted[SrcIndex];
-        ASSERT(ThisEntry >= OldCollection);
-        if (ThisEntry < &OldCollection[NumberEntriesToCopy]) {
-            ASSERT(DestIndex < NumberEntriesToCopy);
-            if (DestIndex >= NumberEntriesToCopy) {
-                break;
-            }
-            NewSorted[DestIndex] = (PYORI_FILE_INFO)((PUCHAR)ThisEntry -
-                                                     (PUCHAR)OldCollection +
-                                                     (PUCHAR)NewCollection);
-            DestIndex++;
-        }
-    }
-
-    ASSERT(DestIndex == NumberEntriesToCopy);
-}
-
 
 /**
  Enumerate all of the files in a given single directory/wildcard pattern,
@@ -560,10 +1090,9 @@ SdirEnumeratePathWithDepth (
     LPTSTR FinalPart;
     YORI_ALLOC_SIZE_T DirEntsToPreserve;
     SDIR_SUMMARY SummaryToPreserve;
-    PYORI_FILE_INFO NewSdirDirCollection;
-    PYORI_FILE_INFO * NewSdirDirSorted;
     SDIR_ITEM_FOUND_CONTEXT ItemFoundContext;
     WORD MatchFlags;
+    BOOL Result;
 
     //
     //  At this point we should have a directory and an enumeration criteria.
@@ -644,9 +1173,10 @@ SdirEnumeratePathWithDepth (
     //  We loop enumerating all the files.  Hopefully for common directories
     //  we'll allocate a big enough buffer in the first case and we can then
     //  just populate that buffer and display it.  If the directory is large
-    //  enough though, we count the number of entries, loop back, and allocate
-    //  a large enough buffer to hold the result, then enumerate it again.
-    //  Because we sort the output, we must keep the entire set in memory to
+    //  enough, the buffer is grown as entries are found.  If that fails, we
+    //  count the number of entries, loop back, and allocate a large enough
+    //  buffer to hold the result, then enumerate it again.  Because we sort
+    //  the output, we must keep the entire set of a directory in memory to
     //  be able to meaningfully process it.
     //
 
@@ -661,64 +1191,38 @@ SdirEnumeratePathWithDepth (
         //  we're still adding files in real time.
         //
 
-        if (SdirDirCollectionCurrent >= SdirAllocatedDirents || SdirDirCollection == NULL) {
-            YORI_ALLOC_SIZE_T PreviousAllocatedDirents = SdirAllocatedDirents;
-            DWORD BytesRequired;
+        if (SdirDirCollectionCurrent > SdirAllocatedDirents || SdirDirCollection == NULL) {
+            YORI_ALLOC_SIZE_T EntriesRequired;
+            YORI_MAX_UNSIGNED_T BytesRequired;
 
+            EntriesRequired = SdirAllocatedDirents;
             if (SdirDirCollectionCurrent >= SdirAllocatedDirents) {
-                SdirAllocatedDirents = SdirDirCollectionCurrent + 1;
+                EntriesRequired = SdirDirCollectionCurrent + 1;
             }
-            if (SdirAllocatedDirents < UINT_MAX - 64) {
-                SdirAllocatedDirents += 64;
+            if (EntriesRequired < UINT_MAX - 64) {
+                EntriesRequired += 64;
             }
 
-            BytesRequired = SdirAllocatedDirents;
+            BytesRequired = EntriesRequired;
             BytesRequired = BytesRequired * sizeof(YORI_FILE_INFO);
             if (!YoriLibIsSizeAllocatable(BytesRequired)) {
-                SdirAllocatedDirents = SdirDirCollectionCurrent;
                 SdirWriteStringWithAttribute(_T("Too many files for a single memory allocation\n"), Opts->FtError.HighlightColor);
                 return FALSE;
             }
 
-            NewSdirDirCollection = YoriLibMalloc(SdirAllocatedDirents * sizeof(YORI_FILE_INFO));
-            if (NewSdirDirCollection == NULL) {
-                SdirAllocatedDirents = SdirDirCollectionCurrent;
-                SdirDisplayError(GetLastError(), _T("YoriLibMalloc"));
-                return FALSE;
-            }
-
-            NewSdirDirSorted = YoriLibMalloc(SdirAllocatedDirents * sizeof(PYORI_FILE_INFO));
-            if (NewSdirDirSorted == NULL) {
-                SdirAllocatedDirents = SdirDirCollectionCurrent;
-                YoriLibFree(NewSdirDirCollection);
-                SdirDisplayError(GetLastError(), _T("YoriLibMalloc"));
-                return FALSE;
-            }
-
             //
             //  Copy back any previous data.  This occurs when multiple
-            //  criteria are specified, eg., "*.a *.b".  Apply fixups to
-            //  everything in the sorted array which were based on the
-            //  previous collection and now need to be based on the new one.
+            //  criteria are specified, eg., "*.a *.b".  Entries from an
+            //  incomplete enumerate are discarded and found again.
             //
 
-            if (DirEntsToPreserve > 0 && SdirDirCollection != NULL) {
-                memcpy(NewSdirDirCollection, SdirDirCollection, sizeof(YORI_FILE_INFO)*DirEntsToPreserve);
-                SdirMoveSortedEntries(SdirDirCollection, NewSdirDirCollection, DirEntsToPreserve, SdirDirSorted, NewSdirDirSorted, PreviousAllocatedDirents);
-            }
-
-            if (SdirDirCollection != NULL) {
-                YoriLibFree(SdirDirCollection);
-            }
-
-            if (SdirDirSorted != NULL) {
-                YoriLibFree(SdirDirSorted);
-            }
-
-            SdirDirCollection = NewSdirDirCollection;
-            SdirDirSorted = NewSdirDirSorted;
             SdirDirCollectionCurrent = DirEntsToPreserve;
             memcpy(Summary, &SummaryToPreserve, sizeof(SummaryToPreserve));
+
+            if (!SdirReallocateCollection(EntriesRequired)) {
+                SdirDisplayError(GetLastError(), _T("YoriLibMalloc"));
+                return FALSE;
+            }
         }
 
         //
@@ -743,12 +1247,16 @@ SdirEnumeratePathWithDepth (
         YoriLibInitEmptyString(&ItemFoundContext.StreamFullPath);
         ItemFoundContext.Error = ERROR_SUCCESS;
 
-        if (!YoriLibForEachFile(FindStr,
-                                MatchFlags,
-                                0,
-                                SdirItemFoundCallback,
-                                SdirEnumerateErrorCallback,
-                                &ItemFoundContext)) {
+        Result = YoriLibForEachFile(FindStr,
+                                    MatchFlags,
+                                    0,
+                                    SdirItemFoundCallback,
+                                    SdirEnumerateErrorCallback,
+                                    &ItemFoundContext);
+
+        SdirCompleteCollection(DirEntsToPreserve);
+
+        if (!Result) {
 
             if (!Opts->Recursive) {
                 if (ItemFoundContext.Error == ERROR_SUCCESS) {
@@ -797,7 +1305,7 @@ SdirEnumeratePathWithDepth (
         //  and reallocate.
         //
 
-    } while (SdirDirCollectionCurrent >= SdirAllocatedDirents);
+    } while (SdirDirCollectionCurrent > SdirAllocatedDirents);
 
     return TRUE;
 }
@@ -898,6 +1406,536 @@ SdirFeatureColor(
 }
 
 
+/**
+ The number of entries that are ordered by insertion sort before runs are
+ combined by merge sort.
+ */
+#define SDIR_SORT_RUN_LENGTH 16
+
+/**
+ An entry to sort along with a key describing its sorted position.  Entries
+ with different keys are ordered by the key, and only entries with equal
+ keys need to be compared with the sort criteria.
+ */
+typedef struct _SDIR_SORT_ITEM {
+
+    /**
+     A packed form of the leading sort criteria for the entry.
+     */
+    DWORDLONG Key;
+
+    /**
+     Pointer to the entry.
+     */
+    PYORI_FILE_INFO Entry;
+} SDIR_SORT_ITEM, *PSDIR_SORT_ITEM;
+
+/**
+ The index of the first sort criterion that is not completely described by
+ the sort key.  Entries with equal keys are compared from this criterion.
+ */
+DWORD SdirSortFirstInexactCriterion;
+
+/**
+ Convert a character from a file name into a value within a sort key.  This
+ must order characters the same way as the comparison function, which
+ uppercases only the base 26 english characters.
+
+ @param Char The character to convert.
+
+ @return The value to include in the sort key.
+ */
+WORD
+SdirSortKeyFromChar(
+    __in TCHAR Char
+    )
+{
+    int Value;
+
+    Value = Char;
+    if (Value >= 'a' && Value <= 'z') {
+        Value = Value - 'a' + 'A';
+    }
+
+#ifdef UNICODE
+    return (WORD)Value;
+#else
+    //
+    //  Characters may be signed, so bias them to ensure they sort the
+    //  same way as unsigned values.
+    //
+
+    return (WORD)(Value + 0x80);
+#endif
+}
+
+/**
+ Generate the portion of a sort key that describes a single sort criterion.
+
+ @param CompareFn Pointer to the comparison function for the criterion.
+
+ @param Entry Pointer to the entry to generate a key for.
+
+ @param BitsAvailable The number of bits remaining in the sort key.
+
+ @param Value On completion, updated to contain the value to place in the
+        sort key.
+
+ @param Bits On completion, updated to contain the number of bits in Value.
+        This can be zero if the criterion cannot be included in the key.
+
+ @return TRUE to indicate that Value completely describes the criterion, so
+         entries with the same Value compare as equal; FALSE if entries with
+         the same Value need to be compared with the comparison function.
+ */
+BOOLEAN
+SdirGetSortKeyField(
+    __in SDIR_COMPARE_FN CompareFn,
+    __in PYORI_FILE_INFO Entry,
+    __in DWORD BitsAvailable,
+    __out PDWORDLONG Value,
+    __out PDWORD Bits
+    )
+{
+    LPTSTR Name;
+    PSYSTEMTIME Time;
+    DWORD Chars;
+    DWORD Index;
+    BOOLEAN Ended;
+
+    *Value = 0;
+    *Bits = 0;
+
+    if (CompareFn == YoriLibCompareFileName ||
+        CompareFn == YoriLibCompareFileExtension) {
+
+        if (CompareFn == YoriLibCompareFileName) {
+            Name = Entry->FileName;
+        } else {
+            Name = Entry->Extension;
+        }
+
+        Chars = BitsAvailable / 16;
+        if (Chars > sizeof(DWORDLONG) / sizeof(WORD)) {
+            Chars = sizeof(DWORDLONG) / sizeof(WORD);
+        }
+
+        //
+        //  Once the name has ended the remaining characters are zero.
+        //  Names that are equal up to this point are equal, so the value
+        //  after the terminator is irrelevant.
+        //
+
+        Ended = FALSE;
+        for (Index = 0; Index < Chars; Index++) {
+            *Value = *Value << 16;
+            if (!Ended) {
+                *Value = *Value | SdirSortKeyFromChar(Name[Index]);
+                if (Name[Index] == '\0') {
+                    Ended = TRUE;
+                }
+            }
+        }
+        *Bits = Chars * 16;
+        return FALSE;
+    }
+
+    if (CompareFn == YoriLibCompareFileSize ||
+        CompareFn == YoriLibCompareAllocationSize ||
+        CompareFn == YoriLibCompareCompressedFileSize ||
+        CompareFn == YoriLibCompareFileId) {
+
+        if (BitsAvailable < 64) {
+            return FALSE;
+        }
+
+        if (CompareFn == YoriLibCompareFileSize) {
+            *Value = Entry->FileSize.QuadPart;
+        } else if (CompareFn == YoriLibCompareAllocationSize) {
+            *Value = Entry->AllocationSize.QuadPart;
+        } else if (CompareFn == YoriLibCompareCompressedFileSize) {
+            *Value = Entry->CompressedFileSize.QuadPart;
+        } else {
+            *Value = Entry->FileId.QuadPart;
+        }
+        *Bits = 64;
+        return TRUE;
+    }
+
+    if (CompareFn == YoriLibCompareWriteDate ||
+        CompareFn == YoriLibCompareCreateDate ||
+        CompareFn == YoriLibCompareAccessDate) {
+
+        if (BitsAvailable < 25) {
+            return FALSE;
+        }
+
+        if (CompareFn == YoriLibCompareWriteDate) {
+            Time = &Entry->WriteTime;
+        } else if (CompareFn == YoriLibCompareCreateDate) {
+            Time = &Entry->CreateTime;
+        } else {
+            Time = &Entry->AccessTime;
+        }
+
+        *Value = ((DWORDLONG)Time->wYear << 9) |
+                 ((DWORDLONG)(Time->wMonth & 0xF) << 5) |
+                 (Time->wDay & 0x1F);
+        *Bits = 25;
+        return TRUE;
+    }
+
+    if (CompareFn == YoriLibCompareWriteTime ||
+        CompareFn == YoriLibCompareCreateTime ||
+        CompareFn == YoriLibCompareAccessTime) {
+
+        if (BitsAvailable < 27) {
+            return FALSE;
+        }
+
+        if (CompareFn == YoriLibCompareWriteTime) {
+            Time = &Entry->WriteTime;
+        } else if (CompareFn == YoriLibCompareCreateTime) {
+            Time = &Entry->CreateTime;
+        } else {
+            Time = &Entry->AccessTime;
+        }
+
+        *Value = ((DWORDLONG)(Time->wHour & 0x1F) << 22) |
+                 ((DWORDLONG)(Time->wMinute & 0x3F) << 16) |
+                 ((DWORDLONG)(Time->wSecond & 0x3F) << 10) |
+                 (Time->wMilliseconds & 0x3FF);
+        *Bits = 27;
+        return TRUE;
+    }
+
+    if (CompareFn == YoriLibCompareFileAttributes) {
+        if (BitsAvailable < 32) {
+            return FALSE;
+        }
+        *Value = Entry->FileAttributes;
+        *Bits = 32;
+        return TRUE;
+    }
+
+    if (CompareFn == YoriLibCompareDirectory) {
+        if (BitsAvailable < 1) {
+            return FALSE;
+        }
+        if ((Entry->FileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+            *Value = 1;
+        }
+        *Bits = 1;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Generate a sort key for an entry by packing as many of the sort criteria
+ as fit into a single integer.
+
+ @param Entry Pointer to the entry to generate a key for.
+
+ @param Key On completion, updated to contain the sort key.
+
+ @return The index of the first sort criterion that is not completely
+         described by the key.  This is the same for every entry.
+ */
+DWORD
+SdirBuildSortKey(
+    __in PYORI_FILE_INFO Entry,
+    __out PDWORDLONG Key
+    )
+{
+    DWORDLONG Value;
+    DWORD BitsAvailable;
+    DWORD Bits;
+    DWORD Index;
+    BOOLEAN Exact;
+
+    *Key = 0;
+    BitsAvailable = 64;
+
+    for (Index = 0; Index < Opts->CurrentSort; Index++) {
+        Exact = SdirGetSortKeyField(Opts->Sort[Index].CompareFn, Entry, BitsAvailable, &Value, &Bits);
+        if (Bits > 0) {
+
+            //
+            //  For an inverse sort, invert the value so larger values
+            //  come first.
+            //
+
+            if (Opts->Sort[Index].CompareBreakCondition == YORI_LIB_LESS_THAN) {
+                if (Bits < 64) {
+                    Value = (~Value) & ((((DWORDLONG)1) << Bits) - 1);
+                } else {
+                    Value = ~Value;
+                }
+            }
+
+            if (Bits < 64) {
+                *Key = (*Key << Bits) | Value;
+            } else {
+                *Key = Value;
+            }
+            BitsAvailable -= Bits;
+        }
+
+        if (!Exact) {
+            break;
+        }
+    }
+
+    return Index;
+}
+
+/**
+ Compare two entries according to the user's sort criteria.
+
+ @param Left Pointer to the first entry.
+
+ @param Right Pointer to the second entry.
+
+ @param FirstCriterion The index of the first sort criterion to compare.
+        Earlier criteria are known to be equal.
+
+ @return YORI_LIB_LESS_THAN if Left should be displayed before Right,
+         YORI_LIB_GREATER_THAN if Right should be displayed before Left, or
+         YORI_LIB_EQUAL if the two are equal.
+ */
+DWORD
+SdirCompareEntries(
+    __in PYORI_FILE_INFO Left,
+    __in PYORI_FILE_INFO Right,
+    __in DWORD FirstCriterion
+    )
+{
+    DWORD Index;
+    DWORD CompareResult;
+
+    for (Index = FirstCriterion; Index < Opts->CurrentSort; Index++) {
+        CompareResult = Opts->Sort[Index].CompareFn(Left, Right);
+        if (CompareResult == Opts->Sort[Index].CompareInverseCondition) {
+            return YORI_LIB_LESS_THAN;
+        } else if (CompareResult == Opts->Sort[Index].CompareBreakCondition) {
+            return YORI_LIB_GREATER_THAN;
+        }
+    }
+
+    return YORI_LIB_EQUAL;
+}
+
+/**
+ Compare two sort items, using the key where possible and the sort criteria
+ if the keys are equal.
+
+ @param Left Pointer to the first item.
+
+ @param Right Pointer to the second item.
+
+ @return YORI_LIB_LESS_THAN if Left should be displayed before Right,
+         YORI_LIB_GREATER_THAN if Right should be displayed before Left, or
+         YORI_LIB_EQUAL if the two are equal.
+ */
+DWORD
+SdirCompareSortItems(
+    __in PSDIR_SORT_ITEM Left,
+    __in PSDIR_SORT_ITEM Right
+    )
+{
+    if (Left->Key < Right->Key) {
+        return YORI_LIB_LESS_THAN;
+    } else if (Left->Key > Right->Key) {
+        return YORI_LIB_GREATER_THAN;
+    }
+
+    return SdirCompareEntries(Left->Entry, Right->Entry, SdirSortFirstInexactCriterion);
+}
+
+/**
+ Sort a small number of items with an insertion sort.  Equal items retain
+ their order.
+
+ @param Items Pointer to the array of items to sort.
+
+ @param Count The number of items in the array.
+ */
+VOID
+SdirInsertionSortItems(
+    __inout_ecount(Count) PSDIR_SORT_ITEM Items,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    SDIR_SORT_ITEM Item;
+    YORI_ALLOC_SIZE_T i, j;
+
+    for (i = 1; i < Count; i++) {
+        Item = Items[i];
+        j = i;
+        while (j > 0 && SdirCompareSortItems(&Items[j - 1], &Item) == YORI_LIB_GREATER_THAN) {
+            Items[j] = Items[j - 1];
+            j--;
+        }
+        Items[j] = Item;
+    }
+}
+
+/**
+ Sort an array of items with a merge sort.  Equal items retain their order,
+ so entries that the user's criteria consider equal are displayed in the
+ order they were found.
+
+ @param Items Pointer to the array of items to sort.
+
+ @param Temp Pointer to an array with space for the same number of items to
+        use while merging.
+
+ @param Count The number of items in the array.
+ */
+VOID
+SdirMergeSortItems(
+    __inout_ecount(Count) PSDIR_SORT_ITEM Items,
+    __out_ecount(Count) PSDIR_SORT_ITEM Temp,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    PSDIR_SORT_ITEM Src;
+    PSDIR_SORT_ITEM Dest;
+    PSDIR_SORT_ITEM Swap;
+    YORI_ALLOC_SIZE_T Width;
+    YORI_ALLOC_SIZE_T Start;
+    YORI_ALLOC_SIZE_T Middle;
+    YORI_ALLOC_SIZE_T End;
+    YORI_ALLOC_SIZE_T Left;
+    YORI_ALLOC_SIZE_T Right;
+    YORI_ALLOC_SIZE_T Out;
+
+    for (Start = 0; Start < Count; Start += SDIR_SORT_RUN_LENGTH) {
+        End = Count - Start;
+        if (End > SDIR_SORT_RUN_LENGTH) {
+            End = SDIR_SORT_RUN_LENGTH;
+        }
+        SdirInsertionSortItems(&Items[Start], End);
+    }
+
+    Src = Items;
+    Dest = Temp;
+
+    for (Width = SDIR_SORT_RUN_LENGTH; Width < Count; Width = Width * 2) {
+        for (Start = 0; Start < Count; Start = End) {
+            Middle = Count;
+            if (Count - Start > Width) {
+                Middle = Start + Width;
+            }
+            End = Count;
+            if (Count - Middle > Width) {
+                End = Middle + Width;
+            }
+
+            //
+            //  If the runs are already in order, which is common when the
+            //  file system returns entries sorted by name, copy them
+            //  without comparing each item.
+            //
+
+            if (Middle == End ||
+                SdirCompareSortItems(&Src[Middle - 1], &Src[Middle]) != YORI_LIB_GREATER_THAN) {
+
+                memcpy(&Dest[Start], &Src[Start], (End - Start) * sizeof(SDIR_SORT_ITEM));
+                continue;
+            }
+
+            Left = Start;
+            Right = Middle;
+            Out = Start;
+            while (Left < Middle && Right < End) {
+                if (SdirCompareSortItems(&Src[Right], &Src[Left]) == YORI_LIB_LESS_THAN) {
+                    Dest[Out++] = Src[Right++];
+                } else {
+                    Dest[Out++] = Src[Left++];
+                }
+            }
+
+            if (Left < Middle) {
+                memcpy(&Dest[Out], &Src[Left], (Middle - Left) * sizeof(SDIR_SORT_ITEM));
+            }
+
+            if (Right < End) {
+                memcpy(&Dest[Out], &Src[Right], (End - Right) * sizeof(SDIR_SORT_ITEM));
+            }
+        }
+
+        Swap = Src;
+        Src = Dest;
+        Dest = Swap;
+    }
+
+    if (Src != Items) {
+        memcpy(Items, Src, Count * sizeof(SDIR_SORT_ITEM));
+    }
+}
+
+/**
+ Sort the entries in the collection according to the user's sort criteria.
+ Each entry is given a key containing as many of the criteria as fit, so
+ most comparisons are a single integer comparison, and only entries with
+ equal keys invoke the comparison functions.
+ */
+VOID
+SdirSortCollection(VOID)
+{
+    PSDIR_SORT_ITEM Items;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T j;
+    PYORI_FILE_INFO CurrentEntry;
+    YORI_MAX_UNSIGNED_T BytesRequired;
+
+    if (SdirDirCollectionCurrent < 2) {
+        return;
+    }
+
+    BytesRequired = SdirDirCollectionCurrent;
+    BytesRequired = BytesRequired * 2 * sizeof(SDIR_SORT_ITEM);
+    Items = NULL;
+    if (YoriLibIsSizeAllocatable(BytesRequired)) {
+        Items = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesRequired);
+    }
+
+    //
+    //  If memory is not available, sort the entries in place.  This is
+    //  slow, but needs no memory.
+    //
+
+    if (Items == NULL) {
+        for (Index = 1; Index < SdirDirCollectionCurrent; Index++) {
+            CurrentEntry = SdirDirSorted[Index];
+            j = Index;
+            while (j > 0 && SdirCompareEntries(SdirDirSorted[j - 1], CurrentEntry, 0) == YORI_LIB_GREATER_THAN) {
+                SdirDirSorted[j] = SdirDirSorted[j - 1];
+                j--;
+            }
+            SdirDirSorted[j] = CurrentEntry;
+        }
+        return;
+    }
+
+    for (Index = 0; Index < SdirDirCollectionCurrent; Index++) {
+        Items[Index].Entry = SdirDirSorted[Index];
+        SdirSortFirstInexactCriterion = SdirBuildSortKey(Items[Index].Entry, &Items[Index].Key);
+    }
+
+    SdirMergeSortItems(Items, &Items[SdirDirCollectionCurrent], SdirDirCollectionCurrent);
+
+    for (Index = 0; Index < SdirDirCollectionCurrent; Index++) {
+        SdirDirSorted[Index] = Items[Index].Entry;
+    }
+
+    YoriLibFree(Items);
+}
+
+
 /**
  Display the loaded set of files.
 
@@ -926,6 +1964,8 @@ SdirDisplayCollection(VOID)
     }
 #endif
 
+    SdirSortCollection();
+
     //
     //  If we're allowed to shorten names to make the display more
     //  legible, we won't allow a longest name greater than twice
@@ -1633,10 +2673,14 @@ ENTRYPOINT(
     SdirDirCollectionTotalNameLength = 0;
     SdirWriteStringLinesDisplayed = 0;
 
+    YoriLibEnableOutputBuffering();
+
     if (!SdirInit(ArgC, ArgV)) {
         goto restore_and_exit;
     }
 
+    SdirStartCollectWorkers();
+
     if (Opts->Recursive) {
         if (!SdirEnumerateAndDisplayRecursive(ArgC, ArgV)) {
             goto restore_and_exit;
@@ -1658,9 +2702,12 @@ ENTRYPOINT(
 
 restore_and_exit:
 
+    SdirStopCollectWorkers();
+
     if (Opts != NULL) {
         SdirSetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), Opts->PreviousAttributes);
     }
+    YoriLibDisableOutputBuffering();
     SdirAppCleanup();
 
     return 0;
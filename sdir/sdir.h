@@ -39,6 +39,12 @@
  */
 #define SDIR_MAX_WIDTH   500
 
+/**
+ The maximum number of threads that can collect information about files
+ concurrently.
+ */
+#define SDIR_MAX_COLLECT_WORKERS 64
+
 /**
  Fallback color for when all else fails.
  */
@@ -519,6 +525,13 @@ typedef struct _SDIR_OPTS {
      */
     WORD            AlignmentPadding;
 
+    /**
+     The number of threads to use to collect information about files that
+     requires opening each file.  If this is zero or one, information is
+     collected while enumerating.
+     */
+    DWORD           CollectWorkerCount;
+
     /**
      Specifies the number of populated compare functions in the sort array,
      below.
@@ -212,6 +212,8 @@ CHAR strCmdLineOpts[] =
                    "   -cw[num]     Width of console when writing to files\n"
                    "   -fc[string]  Apply custom file color string, see file color section\n"
                    "   -fe[string]  Exclude files matching criteria, see file color section\n"
+                   "   -j[num]      Collect information that requires opening files on num\n"
+                   "                  threads concurrently\n"
                    "   -l/-ln       Traverse symbolic links and mount points when recursing\n"
                    "   -p/-pn       Pause/no pause after each screen\n"
                    "   -r           Recurse through directories when enumerating\n"
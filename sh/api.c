@@ -356,6 +356,7 @@ YoriApiGetHistoryStrings(
     )
 {
     YoriLibInitEmptyString(HistoryStrings);
+    YoriShLoadDeferredHistory();
     return YoriShGetHistoryStrings(MaximumNumber, HistoryStrings);
 }
 
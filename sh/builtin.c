@@ -196,6 +196,7 @@ YoriShExecuteInProc(
 {
     YORI_LIBSH_PREVIOUS_REDIRECT_CONTEXT PreviousRedirectContext;
     BOOLEAN WasPipe = FALSE;
+    BOOLEAN CaptureToMemory = FALSE;
     PYORI_STRING NoEscapedArgV;
     PYORI_STRING SavedEscapedArgV;
     YORI_ALLOC_SIZE_T SavedEscapedArgC;
@@ -240,8 +241,40 @@ YoriShExecuteInProc(
         ExecContext->StdOutType = StdOutTypeBuffer;
     }
 
+    //
+    //  If this is the only command in a backquoted expression, capture its
+    //  output directly into memory rather than creating a pipe and a thread
+    //  to drain it.  Standard output refers to NUL while this happens so
+    //  that anything which bypasses the capture is discarded, as it would
+    //  be if nothing read from the pipe.
+    //
+
+    if (YoriShGlobal.InProcCapture != NULL &&
+        YoriShGlobal.InProcCapture->ExecContext == ExecContext &&
+        !YoriShGlobal.InProcCaptureActive &&
+        !WasPipe &&
+        ExecContext->StdOutType == StdOutTypeBuffer &&
+        ExecContext->StdOut.Buffer.ProcessBuffers == NULL) {
+
+        CaptureToMemory = TRUE;
+        ExecContext->StdOutType = StdOutTypeNull;
+    }
+
     ExitCode = YoriLibShInitializeRedirection(ExecContext, TRUE, &PreviousRedirectContext);
+    if (ExitCode == ERROR_SUCCESS &&
+        CaptureToMemory &&
+        !YoriLibBeginOutputCapture()) {
+
+        YoriLibShRevertRedirection(&PreviousRedirectContext);
+        CaptureToMemory = FALSE;
+        ExecContext->StdOutType = StdOutTypeBuffer;
+        ExitCode = YoriLibShInitializeRedirection(ExecContext, TRUE, &PreviousRedirectContext);
+    }
+
     if (ExitCode != ERROR_SUCCESS) {
+        if (CaptureToMemory) {
+            ExecContext->StdOutType = StdOutTypeBuffer;
+        }
         LPTSTR ErrText = YoriLibGetWinErrorText(ExitCode);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Failed to initialize redirection: %s"), ErrText);
         YoriLibFreeWinErrorText(ErrText);
@@ -275,13 +308,26 @@ YoriShExecuteInProc(
     YoriShGlobal.EscapedArgV = EscapedArgV;
     YoriShGlobal.EscapedArgQuotesPresent = ArgQuotesPresent;
     YoriShGlobal.RecursionDepth++;
+    if (CaptureToMemory) {
+        YoriShGlobal.InProcCaptureActive = TRUE;
+    }
     ExitCode = Fn(ArgC, NoEscapedArgV);
+    if (CaptureToMemory) {
+        YoriShGlobal.InProcCaptureActive = FALSE;
+        if (YoriLibEndOutputCapture(&YoriShGlobal.InProcCapture->Output)) {
+            YoriShGlobal.InProcCapture->Complete = TRUE;
+        }
+    }
     YoriShGlobal.RecursionDepth--;
     YoriShGlobal.EscapedArgC = SavedEscapedArgC;
     YoriShGlobal.EscapedArgV = SavedEscapedArgV;
     YoriShGlobal.EscapedArgQuotesPresent = SavedEscapedArgQuotesPresent;
     YoriLibShRevertRedirection(&PreviousRedirectContext);
 
+    if (CaptureToMemory) {
+        ExecContext->StdOutType = StdOutTypeBuffer;
+    }
+
     if (WasPipe) {
         YoriLibShForwardProcessBufferToNextProcess(ExecContext);
     } else {
@@ -3,7 +3,7 @@
  *
  * Yori shell tab completion
  *
- * Copyright (c) 2017-2020 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -26,6 +26,40 @@
 
 #include "yori.h"
 
+/**
+ The state of a suggestion being calculated on a background thread.
+ */
+typedef struct _YORI_SH_BACKGROUND_SUGGESTION {
+
+    /**
+     A private input buffer containing a copy of the text and cursor
+     position that the suggestion is being calculated for.  The background
+     thread populates the tab context and suggestion string within this
+     buffer.
+     */
+    YORI_SH_INPUT_BUFFER Buffer;
+
+    /**
+     A handle to the thread calculating the suggestion.  This is signalled
+     when the calculation has completed.
+     */
+    HANDLE Thread;
+
+    /**
+     Set to TRUE by the input thread to indicate the result is no longer
+     needed, so the background thread should stop as soon as possible.
+     */
+    volatile BOOLEAN Cancelled;
+
+    /**
+     Set to TRUE by the background thread if the suggestion requires
+     executing a completion script.  Scripts are executed by the shell, so
+     the suggestion must be calculated on the input thread instead.
+     */
+    BOOLEAN ForegroundRequired;
+
+} YORI_SH_BACKGROUND_SUGGESTION, *PYORI_SH_BACKGROUND_SUGGESTION;
+
 /**
  Add a new match to the list of matches and add the match to the hash table
  to check for duplicates.
@@ -101,6 +135,83 @@ YoriShRemoveMatchFromTabContext(
     YoriLibDereference(Match);
 }
 
+/**
+ The interval in milliseconds between checks for user input while matches
+ are being populated.
+ */
+#define YORI_SH_TAB_INPUT_CHECK_INTERVAL (50)
+
+/**
+ Check whether the user has pressed a key since matches started being
+ populated.  Populating matches can take a long time in large directories
+ or on slow shares, and a key press means the user has moved on, so the
+ populate should stop and the key should be processed.  Tab itself and
+ modifier keys are not considered, since they are part of requesting the
+ completion.  The console is only checked periodically so that a fast
+ populate does not pay for it.
+
+ @param TabContext Pointer to the tab completion context.
+
+ @return TRUE if populating matches should stop, FALSE if it should
+         continue.
+ */
+BOOLEAN
+YoriShIsTabCompletionInterrupted(
+    __inout PYORI_SH_TAB_COMPLETE_CONTEXT TabContext
+    )
+{
+    INPUT_RECORD InputRecords[16];
+    DWORD RecordsRead;
+    DWORD Index;
+    DWORD Now;
+    WORD KeyCode;
+
+    if (TabContext->Interrupted) {
+        return TRUE;
+    }
+
+    //
+    //  When populating on a background thread, the input thread processes
+    //  any key press itself and cancels the populate since its result is
+    //  stale.
+    //
+
+    if (TabContext->BackgroundSuggestion != NULL) {
+        if (TabContext->BackgroundSuggestion->Cancelled) {
+            TabContext->Interrupted = TRUE;
+        }
+        return TabContext->Interrupted;
+    }
+
+    Now = GetTickCount();
+    if (Now - TabContext->LastInputCheckTick < YORI_SH_TAB_INPUT_CHECK_INTERVAL) {
+        return FALSE;
+    }
+    TabContext->LastInputCheckTick = Now;
+
+    if (!PeekConsoleInput(GetStdHandle(STD_INPUT_HANDLE), InputRecords, sizeof(InputRecords)/sizeof(InputRecords[0]), &RecordsRead)) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < RecordsRead; Index++) {
+        if (InputRecords[Index].EventType == KEY_EVENT &&
+            InputRecords[Index].Event.KeyEvent.bKeyDown) {
+
+            KeyCode = InputRecords[Index].Event.KeyEvent.wVirtualKeyCode;
+            if (KeyCode != VK_TAB &&
+                KeyCode != VK_SHIFT &&
+                KeyCode != VK_CONTROL &&
+                KeyCode != VK_MENU) {
+
+                TabContext->Interrupted = TRUE;
+                break;
+            }
+        }
+    }
+
+    return TabContext->Interrupted;
+}
+
 /**
  Compare two Yori strings as file names, which implies case insensitively.
  This routine is a custom version of YoriLibCompareStringIns which
@@ -189,6 +300,8 @@ YoriShPerformHistoryTabCompletion(
 
     UNREFERENCED_PARAMETER(ExpandFullPath);
 
+    YoriShLoadDeferredHistory();
+
     //
     //  Set up state necessary for different types of searching.
     //
@@ -209,6 +322,10 @@ YoriShPerformHistoryTabCompletion(
     while (ListEntry != NULL) {
         HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
 
+        if (YoriShIsTabCompletionInterrupted(TabContext)) {
+            break;
+        }
+
         if (YoriLibCompareStringInsCnt(&HistoryEntry->CmdLine, &TabContext->SearchString, CompareLength) == 0) {
 
             //
@@ -347,6 +464,10 @@ YoriShAddExecutableToTabList(
     YORI_STRING PathToReturn;
     YORI_STRING StringToFinalSlash;
 
+    if (YoriShIsTabCompletionInterrupted(ExecTabContext->TabContext)) {
+        return FALSE;
+    }
+
     YoriLibInitEmptyString(&PathToReturn);
     YoriLibInitEmptyString(&StringToFinalSlash);
 
@@ -813,6 +934,10 @@ YoriShFileTabCompletionCallback(
 
     UNREFERENCED_PARAMETER(Depth);
 
+    if (YoriShIsTabCompletionInterrupted(FileCompleteContext->TabContext)) {
+        return FALSE;
+    }
+
     if (FileCompleteContext->ExpandFullPath) {
 
         //
@@ -1351,7 +1476,10 @@ YoriShPerformFileTabCompletion(
     //  file name but it's prefixed with some other string.
     //
 
-    if (EnumContext.FilesFound == 0 && !EnumContext.AbortMatching) {
+    if (EnumContext.FilesFound == 0 &&
+        !EnumContext.AbortMatching &&
+        !TabContext->Interrupted) {
+
         YORI_ALLOC_SIZE_T MatchCount = sizeof(YoriShTabHeuristicMatches)/sizeof(YoriShTabHeuristicMatches[0]);
         YORI_ALLOC_SIZE_T MismatchCount = sizeof(YoriShTabHeuristicMismatches)/sizeof(YoriShTabHeuristicMismatches[0]);
         YORI_ALLOC_SIZE_T AllocCount;
@@ -1676,8 +1804,356 @@ YoriShResolveTabCompletionStringToAction(
     return TRUE;
 }
 
+/**
+ The number of items a completion cache can hold before it is discarded and
+ repopulated.
+ */
+#define YORI_SH_COMPLETION_CACHE_MAX_ENTRIES 64
+
+/**
+ The time, in milliseconds, that the location of a completion script for an
+ executable is remembered.  This allows a newly installed script to be found
+ without restarting the shell.
+ */
+#define YORI_SH_COMPLETION_SCRIPT_LIFETIME (60 * 1000)
+
+/**
+ The time, in milliseconds, that the output of a completion script is
+ remembered.  Scripts typically return a static list for a given argument,
+ but may return a list that changes slowly, such as the branches in a
+ repository.
+ */
+#define YORI_SH_COMPLETION_OUTPUT_LIFETIME (10 * 1000)
+
+/**
+ A single item remembered in a completion cache.
+ */
+typedef struct _YORI_SH_COMPLETION_CACHE_ENTRY {
+
+    /**
+     The entry within the hash table.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The entry within the list of all items in the cache.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The tick count when the item was added to the cache.
+     */
+    DWORD TickAdded;
+
+    /**
+     The value of the item.
+     */
+    YORI_STRING Value;
+} YORI_SH_COMPLETION_CACHE_ENTRY, *PYORI_SH_COMPLETION_CACHE_ENTRY;
+
+/**
+ A cache of recent results of argument completion.  Items are discarded
+ when their lifetime expires or when the environment changes.
+ */
+typedef struct _YORI_SH_COMPLETION_CACHE {
+
+    /**
+     A hash table of items, or NULL if the cache has not been used.
+     */
+    PYORI_HASH_TABLE Table;
+
+    /**
+     A list of all items in the cache.
+     */
+    YORI_LIST_ENTRY List;
+
+    /**
+     The number of items in the cache.
+     */
+    DWORD Count;
+
+    /**
+     The environment generation that the cache describes.
+     */
+    DWORD Generation;
+
+    /**
+     The time, in milliseconds, that an item remains valid.
+     */
+    DWORD Lifetime;
+} YORI_SH_COMPLETION_CACHE, *PYORI_SH_COMPLETION_CACHE;
+
+/**
+ A cache of completion script locations, whose key is the executable name
+ and whose value is the fully qualified path to the script, or an empty
+ string if the executable has no completion script.
+ */
+YORI_SH_COMPLETION_CACHE YoriShCompletionScriptCache = {NULL, {NULL, NULL}, 0, 0, YORI_SH_COMPLETION_SCRIPT_LIFETIME};
+
+/**
+ A cache of completion script output, whose key is the expression used to
+ invoke the script and whose value is the output of the script.
+ */
+YORI_SH_COMPLETION_CACHE YoriShCompletionOutputCache = {NULL, {NULL, NULL}, 0, 0, YORI_SH_COMPLETION_OUTPUT_LIFETIME};
+
+/**
+ Remove an item from a completion cache and free it.
+
+ @param Cache Pointer to the cache containing the item.
+
+ @param Entry Pointer to the item to free.
+ */
+VOID
+YoriShCompletionCacheFreeEntry(
+    __inout PYORI_SH_COMPLETION_CACHE Cache,
+    __in PYORI_SH_COMPLETION_CACHE_ENTRY Entry
+    )
+{
+    YoriLibRemoveListItem(&Entry->ListEntry);
+    YoriLibHashRemoveByEntry(&Entry->HashEntry);
+    YoriLibFreeStringContents(&Entry->Value);
+    YoriLibFree(Entry);
+    Cache->Count--;
+}
+
+/**
+ Discard all items from a completion cache.
+
+ @param Cache Pointer to the cache to discard items from.
+ */
+VOID
+YoriShCompletionCacheInvalidate(
+    __inout PYORI_SH_COMPLETION_CACHE Cache
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_COMPLETION_CACHE_ENTRY Entry;
+
+    if (Cache->Table == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&Cache->List, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, YORI_SH_COMPLETION_CACHE_ENTRY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Cache->List, ListEntry);
+        YoriShCompletionCacheFreeEntry(Cache, Entry);
+    }
+}
+
+/**
+ Find an item in a completion cache.  Items that have expired are discarded
+ rather than returned.
+
+ @param Cache Pointer to the cache to search.
+
+ @param Key Pointer to the key of the item to find.  This is compared case
+        sensitively.
+
+ @param Value On successful completion, populated with a newly allocated
+        copy of the item's value.
+
+ @return TRUE if the item was found, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+YoriShCompletionCacheLookup(
+    __inout PYORI_SH_COMPLETION_CACHE Cache,
+    __in PYORI_STRING Key,
+    __out PYORI_STRING Value
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_SH_COMPLETION_CACHE_ENTRY Entry;
+
+    if (Cache->Table == NULL) {
+        return FALSE;
+    }
+
+    if (Cache->Generation != YoriShGlobal.EnvironmentGeneration) {
+        YoriShCompletionCacheInvalidate(Cache);
+        Cache->Generation = YoriShGlobal.EnvironmentGeneration;
+        return FALSE;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(Cache->Table, Key);
+    if (HashEntry == NULL) {
+        return FALSE;
+    }
+
+    Entry = CONTAINING_RECORD(HashEntry, YORI_SH_COMPLETION_CACHE_ENTRY, HashEntry);
+    if (GetTickCount() - Entry->TickAdded >= Cache->Lifetime ||
+        YoriLibCompareString(Key, &HashEntry->Key) != 0) {
+
+        YoriShCompletionCacheFreeEntry(Cache, Entry);
+        return FALSE;
+    }
+
+    return YoriLibCopyString(Value, &Entry->Value);
+}
+
+/**
+ Add an item to a completion cache.  Failure to add an item is not fatal,
+ since it will be recalculated when next needed.
+
+ @param Cache Pointer to the cache to add the item to.
+
+ @param Key Pointer to the key of the item.  The cache must not already
+        contain an item with this key.
+
+ @param Value Pointer to the value of the item.  This is copied into the
+        cache.
+ */
+VOID
+YoriShCompletionCacheInsert(
+    __inout PYORI_SH_COMPLETION_CACHE Cache,
+    __in PYORI_STRING Key,
+    __in PYORI_STRING Value
+    )
+{
+    PYORI_SH_COMPLETION_CACHE_ENTRY Entry;
+    YORI_STRING KeyCopy;
+
+    if (Cache->Table == NULL) {
+        Cache->Table = YoriLibAllocateHashTable(YORI_SH_COMPLETION_CACHE_MAX_ENTRIES);
+        if (Cache->Table == NULL) {
+            return;
+        }
+        YoriLibInitializeListHead(&Cache->List);
+        Cache->Count = 0;
+        Cache->Generation = YoriShGlobal.EnvironmentGeneration;
+    }
+
+    if (Cache->Count >= YORI_SH_COMPLETION_CACHE_MAX_ENTRIES) {
+        YoriShCompletionCacheInvalidate(Cache);
+    }
+
+    Entry = YoriLibMalloc(sizeof(YORI_SH_COMPLETION_CACHE_ENTRY));
+    if (Entry == NULL) {
+        return;
+    }
+
+    ZeroMemory(Entry, sizeof(YORI_SH_COMPLETION_CACHE_ENTRY));
+    if (!YoriLibCopyString(&Entry->Value, Value)) {
+        YoriLibFree(Entry);
+        return;
+    }
+
+    //
+    //  The key is typically in a buffer that will be reused, so the key
+    //  needs its own allocation.
+    //
+
+    if (!YoriLibCopyString(&KeyCopy, Key)) {
+        YoriLibFreeStringContents(&Entry->Value);
+        YoriLibFree(Entry);
+        return;
+    }
+
+    Entry->TickAdded = GetTickCount();
+    YoriLibHashInsertByKey(Cache->Table, &KeyCopy, Entry, &Entry->HashEntry);
+    YoriLibAppendList(&Cache->List, &Entry->ListEntry);
+    Cache->Count++;
+    YoriLibFreeStringContents(&KeyCopy);
+}
+
+/**
+ Free the caches of completion script locations and output.
+ */
+VOID
+YoriShCleanupCompletionCache(VOID)
+{
+    if (YoriShCompletionScriptCache.Table != NULL) {
+        YoriShCompletionCacheInvalidate(&YoriShCompletionScriptCache);
+        YoriLibFreeEmptyHashTable(YoriShCompletionScriptCache.Table);
+        YoriShCompletionScriptCache.Table = NULL;
+    }
+
+    if (YoriShCompletionOutputCache.Table != NULL) {
+        YoriShCompletionCacheInvalidate(&YoriShCompletionOutputCache);
+        YoriLibFreeEmptyHashTable(YoriShCompletionOutputCache.Table);
+        YoriShCompletionOutputCache.Table = NULL;
+    }
+}
+
+/**
+ Search the locations in YORICOMPLETEPATH for a completion script for an
+ executable.  If no script is found for the full name of the executable,
+ any extension is removed and the search repeated.
+
+ @param Executable Pointer to the file name of the executable, without any
+        path.
+
+ @param YoriCompletePathVariable Pointer to the value of YORICOMPLETEPATH.
+
+ @param FoundCompletionScript On successful completion, populated with the
+        fully qualified path to the completion script, or an empty string if
+        the executable has no completion script.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShLocateCompletionScript(
+    __in PYORI_STRING Executable,
+    __in PYORI_STRING YoriCompletePathVariable,
+    __out PYORI_STRING FoundCompletionScript
+    )
+{
+    YORI_STRING FilePartOnly;
+    YORI_STRING PathVariableCopy;
+    LPTSTR FinalPeriod;
+
+    if (!YoriLibAllocateString(FoundCompletionScript, YoriCompletePathVariable->LengthInChars + MAX_PATH)) {
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(&PathVariableCopy, YoriCompletePathVariable->LengthInChars + 1)) {
+        YoriLibFreeStringContents(FoundCompletionScript);
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&FilePartOnly);
+    FilePartOnly.StartOfString = Executable->StartOfString;
+    FilePartOnly.LengthInChars = Executable->LengthInChars;
+
+    //
+    //  The function below uses strtok which is destructive, so being called
+    //  in a loop requires providing a new buffer each time.
+    //
+
+    memcpy(PathVariableCopy.StartOfString, YoriCompletePathVariable->StartOfString, YoriCompletePathVariable->LengthInChars * sizeof(TCHAR));
+    PathVariableCopy.LengthInChars = YoriCompletePathVariable->LengthInChars;
+    PathVariableCopy.StartOfString[PathVariableCopy.LengthInChars] = '\0';
+
+    //
+    //  Search through the locations for a matching script name.
+    //
+
+    while (!YoriLibPathLocateUnknownExtensionUnknownLocation(&FilePartOnly, &PathVariableCopy, FALSE, NULL, NULL, FoundCompletionScript) ||
+        FoundCompletionScript->LengthInChars == 0) {
+
+        FinalPeriod = YoriLibFindRightMostCharacter(&FilePartOnly, '.');
+        if (FinalPeriod == NULL) {
+            FoundCompletionScript->LengthInChars = 0;
+            break;
+        }
+
+        FilePartOnly.LengthInChars = (YORI_ALLOC_SIZE_T)(FinalPeriod - FilePartOnly.StartOfString);
+        memcpy(PathVariableCopy.StartOfString, YoriCompletePathVariable->StartOfString, YoriCompletePathVariable->LengthInChars * sizeof(TCHAR));
+        PathVariableCopy.LengthInChars = YoriCompletePathVariable->LengthInChars;
+        PathVariableCopy.StartOfString[PathVariableCopy.LengthInChars] = '\0';
+    }
+
+    YoriLibFreeStringContents(&PathVariableCopy);
+    return TRUE;
+}
+
 /**
  Check for the given executable or builtin command how to expand its arguments.
+ The location of any completion script, and the output of the script, are
+ remembered for a short time so that repeatedly completing arguments for the
+ same command does not search for and execute the script each time.
 
  @param TabContext Pointer to the tab completion context.  This provides
         the search criteria and has its match list populated with results
@@ -1704,14 +2180,12 @@ YoriShResolveTabCompletionActionForExecutable(
     YORI_STRING FilePartOnly;
     YORI_STRING ActionString;
     YORI_STRING YoriCompletePathVariable;
-    YORI_STRING PathVariableCopy;
     YORI_STRING FoundCompletionScript;
     YORI_STRING CompletionExpression;
     YORI_STRING ArgToComplete;
     YORI_STRING FullArgs;
     PYORI_STRING Executable;
     YORI_ALLOC_SIZE_T FinalSeperator;
-    LPTSTR FinalPeriod;
 
     YoriLibInitializeListHead(&Action->List);
 
@@ -1745,53 +2219,27 @@ YoriShResolveTabCompletionActionForExecutable(
         return TRUE;
     }
 
-    if (!YoriLibAllocateString(&FoundCompletionScript, YoriCompletePathVariable.LengthInChars + MAX_PATH)) {
-        YoriLibFreeStringContents(&YoriCompletePathVariable);
-        return FALSE;
-    }
-
-    if (!YoriLibAllocateString(&PathVariableCopy, YoriCompletePathVariable.LengthInChars + 1)) {
-        YoriLibFreeStringContents(&YoriCompletePathVariable);
-        YoriLibFreeStringContents(&FoundCompletionScript);
-        return FALSE;
-    }
-
-    //
-    //  The function below uses strtok which is destructive, so being called
-    //  in a loop requires providing a new buffer each time.
-    //
-
-    memcpy(PathVariableCopy.StartOfString, YoriCompletePathVariable.StartOfString, YoriCompletePathVariable.LengthInChars * sizeof(TCHAR));
-    PathVariableCopy.LengthInChars = YoriCompletePathVariable.LengthInChars;
-    PathVariableCopy.StartOfString[PathVariableCopy.LengthInChars] = '\0';
-
     //
-    //  Search through the locations for a matching script name.  If there
-    //  isn't one, perform a default action.
+    //  Search through the locations for a matching script name, unless
+    //  this was done recently.  If there isn't one, perform a default
+    //  action.
     //
 
-    while (!YoriLibPathLocateUnknownExtensionUnknownLocation(&FilePartOnly, &PathVariableCopy, FALSE, NULL, NULL, &FoundCompletionScript) ||
-        FoundCompletionScript.LengthInChars == 0) {
-
-        FinalPeriod = YoriLibFindRightMostCharacter(&FilePartOnly, '.');
-        if (FinalPeriod == NULL) {
-            YoriLibFreeStringContents(&FoundCompletionScript);
+    if (!YoriShCompletionCacheLookup(&YoriShCompletionScriptCache, &FilePartOnly, &FoundCompletionScript)) {
+        if (!YoriShLocateCompletionScript(&FilePartOnly, &YoriCompletePathVariable, &FoundCompletionScript)) {
             YoriLibFreeStringContents(&YoriCompletePathVariable);
-            YoriLibFreeStringContents(&PathVariableCopy);
-
-            Action->CompletionAction = CompletionActionTypeFilesAndDirectories;
-            return TRUE;
+            return FALSE;
         }
-
-        FilePartOnly.LengthInChars = (YORI_ALLOC_SIZE_T)(FinalPeriod - FilePartOnly.StartOfString);
-        memcpy(PathVariableCopy.StartOfString, YoriCompletePathVariable.StartOfString, YoriCompletePathVariable.LengthInChars * sizeof(TCHAR));
-        PathVariableCopy.LengthInChars = YoriCompletePathVariable.LengthInChars;
-        PathVariableCopy.StartOfString[PathVariableCopy.LengthInChars] = '\0';
+        YoriShCompletionCacheInsert(&YoriShCompletionScriptCache, &FilePartOnly, &FoundCompletionScript);
     }
 
     YoriLibFreeStringContents(&YoriCompletePathVariable);
-    YoriLibFreeStringContents(&PathVariableCopy);
-    ASSERT(FoundCompletionScript.LengthInChars > 0);
+
+    if (FoundCompletionScript.LengthInChars == 0) {
+        YoriLibFreeStringContents(&FoundCompletionScript);
+        Action->CompletionAction = CompletionActionTypeFilesAndDirectories;
+        return TRUE;
+    }
 
     //
     //  If there is one, create an expression and invoke the script.
@@ -1828,10 +2276,30 @@ YoriShResolveTabCompletionActionForExecutable(
     YoriLibFreeStringContents(&FoundCompletionScript);
     YoriLibFreeStringContents(&FullArgs);
 
-    if (!YoriShExecuteExpressionAndCaptureOutput(&CompletionExpression, &ActionString)) {
+    //
+    //  If the same expression was executed recently, use its output.
+    //  Otherwise, execute it.  Completion scripts can only be executed on
+    //  the input thread.  If this is a background suggestion, stop and
+    //  indicate that it needs to be calculated on the input thread.
+    //
 
-        Action->CompletionAction = CompletionActionTypeFilesAndDirectories;
-        return TRUE;
+    if (!YoriShCompletionCacheLookup(&YoriShCompletionOutputCache, &CompletionExpression, &ActionString)) {
+
+        if (TabContext->BackgroundSuggestion != NULL) {
+            TabContext->BackgroundSuggestion->ForegroundRequired = TRUE;
+            TabContext->Interrupted = TRUE;
+            YoriLibFreeStringContents(&CompletionExpression);
+            return FALSE;
+        }
+
+        if (!YoriShExecuteExpressionAndCaptureOutput(&CompletionExpression, &ActionString)) {
+
+            YoriLibFreeStringContents(&CompletionExpression);
+            Action->CompletionAction = CompletionActionTypeFilesAndDirectories;
+            return TRUE;
+        }
+
+        YoriShCompletionCacheInsert(&YoriShCompletionOutputCache, &CompletionExpression, &ActionString);
     }
 
     YoriLibFreeStringContents(&CompletionExpression);
@@ -2126,6 +2594,8 @@ YoriShPopulateTabCompletionMatches(
     }
     YoriLibInitializeListHead(&Buffer->TabContext.MatchList);
     Buffer->TabContext.PreviousMatch = NULL;
+    Buffer->TabContext.Interrupted = FALSE;
+    Buffer->TabContext.LastInputCheckTick = GetTickCount();
 
     if (CmdContext->CurrentArg < CmdContext->ArgC) {
         memcpy(&CurrentArgString, &CmdContext->ArgV[CmdContext->CurrentArg], sizeof(YORI_STRING));
@@ -2188,6 +2658,10 @@ YoriShPopulateTabCompletionMatches(
 
     Buffer->TabContext.TabFlagsUsedCreatingList = TabFlags;
 
+    if (Buffer->TabContext.Interrupted) {
+        return;
+    }
+
     if (Buffer->TabContext.SearchType == YoriTabCompleteSearchExecutables) {
         YoriShPerformExecutableTabCompletion(&Buffer->TabContext, ExpandFullPath, TRUE);
     } else if (Buffer->TabContext.SearchType == YoriTabCompleteSearchHistory) {
@@ -2673,6 +3147,20 @@ YoriShTabCompletion(
         YoriShPopulateTabCompletionMatches(Buffer,
                                            &CmdContext,
                                            (WORD)(TabFlags & YORI_SH_TAB_COMPLETE_COMPAT_MASK));
+
+        //
+        //  If the user typed something while matches were being found,
+        //  leave the buffer unchanged so the key is processed against it.
+        //
+
+        if (Buffer->TabContext.Interrupted) {
+            YoriShClearTabCompletionMatches(Buffer);
+            Buffer->PriorTabCount = 0;
+            YoriLibFreeStringContents(&PrefixBeforeBackquoteSubstring);
+            YoriLibFreeStringContents(&SuffixAfterBackquoteSubstring);
+            YoriLibShFreeCmdContext(&CmdContext);
+            return FALSE;
+        }
     }
 
     //
@@ -3146,6 +3634,11 @@ YoriShCompleteSuggestion(
     //
 
     YoriShPopulateTabCompletionMatches(Buffer, &CmdContext, YORI_SH_TAB_SUGGESTIONS);
+    if (Buffer->TabContext.Interrupted) {
+        YoriShClearTabCompletionMatches(Buffer);
+        YoriLibShFreeCmdContext(&CmdContext);
+        return;
+    }
 
     //
     //  Check if we have any match.  If we do, try to use it.  If not, leave
@@ -3178,4 +3671,217 @@ YoriShCompleteSuggestion(
     YoriLibShFreeCmdContext(&CmdContext);
 }
 
+/**
+ Free the state of a suggestion calculated on a background thread.  The
+ thread must have terminated.
+
+ @param Suggestion Pointer to the suggestion state to free.
+ */
+VOID
+YoriShFreeBackgroundSuggestion(
+    __in PYORI_SH_BACKGROUND_SUGGESTION Suggestion
+    )
+{
+    YoriShClearTabCompletionMatches(&Suggestion->Buffer);
+    YoriLibFreeStringContents(&Suggestion->Buffer.SuggestionString);
+    YoriLibFreeStringContents(&Suggestion->Buffer.String);
+    YoriLibFree(Suggestion);
+}
+
+/**
+ Calculate a suggestion on a background thread.
+
+ @param Param Pointer to the background suggestion state.
+
+ @return Thread return code, which is ignored for this thread.
+ */
+DWORD WINAPI
+YoriShBackgroundSuggestionThread(
+    __in LPVOID Param
+    )
+{
+    PYORI_SH_BACKGROUND_SUGGESTION Suggestion;
+
+    Suggestion = (PYORI_SH_BACKGROUND_SUGGESTION)Param;
+    YoriShCompleteSuggestion(&Suggestion->Buffer);
+    return 0;
+}
+
+/**
+ Begin calculating a suggestion for the current input on a background
+ thread, so the input thread can continue to process key presses while
+ directories or the path are searched.  The background thread operates on
+ a copy of the input, and only reads shell state, which does not change
+ while the input thread is waiting for input.
+
+ @param Buffer Pointer to the input buffer.
+
+ @return TRUE to indicate the calculation has started, FALSE if it could
+         not be started and the suggestion should be calculated on the
+         input thread.
+ */
+BOOLEAN
+YoriShStartBackgroundSuggestion(
+    __inout PYORI_SH_INPUT_BUFFER Buffer
+    )
+{
+    PYORI_SH_BACKGROUND_SUGGESTION Suggestion;
+    DWORD ThreadId;
+
+    ASSERT(Buffer->BackgroundSuggestion == NULL);
+
+    Suggestion = YoriLibMalloc(sizeof(YORI_SH_BACKGROUND_SUGGESTION));
+    if (Suggestion == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(Suggestion, sizeof(YORI_SH_BACKGROUND_SUGGESTION));
+    if (!YoriLibAllocateString(&Suggestion->Buffer.String, Buffer->String.LengthInChars + 1)) {
+        YoriLibFree(Suggestion);
+        return FALSE;
+    }
+
+    memcpy(Suggestion->Buffer.String.StartOfString, Buffer->String.StartOfString, Buffer->String.LengthInChars * sizeof(TCHAR));
+    Suggestion->Buffer.String.LengthInChars = Buffer->String.LengthInChars;
+    Suggestion->Buffer.String.StartOfString[Suggestion->Buffer.String.LengthInChars] = '\0';
+    Suggestion->Buffer.CurrentOffset = Buffer->CurrentOffset;
+    Suggestion->Buffer.TabContext.SearchType = Buffer->TabContext.SearchType;
+    Suggestion->Buffer.TabContext.BackgroundSuggestion = Suggestion;
+
+    Suggestion->Thread = CreateThread(NULL, 0, YoriShBackgroundSuggestionThread, Suggestion, 0, &ThreadId);
+    if (Suggestion->Thread == NULL) {
+        YoriShFreeBackgroundSuggestion(Suggestion);
+        return FALSE;
+    }
+
+    Buffer->BackgroundSuggestion = Suggestion;
+    return TRUE;
+}
+
+/**
+ Return a handle which is signalled when a suggestion being calculated on a
+ background thread completes.
+
+ @param Buffer Pointer to the input buffer.
+
+ @return A handle to wait on, or NULL if no calculation is in progress.
+ */
+HANDLE
+YoriShGetBackgroundSuggestionWaitHandle(
+    __in PYORI_SH_INPUT_BUFFER Buffer
+    )
+{
+    if (Buffer->BackgroundSuggestion == NULL) {
+        return NULL;
+    }
+    return Buffer->BackgroundSuggestion->Thread;
+}
+
+/**
+ If a suggestion being calculated on a background thread has completed,
+ move its matches and suggestion string into the input buffer.  The result
+ is discarded if the input has changed since the calculation started.
+
+ @param Buffer Pointer to the input buffer.
+
+ @param ForegroundRequired On successful completion, set to TRUE if the
+        suggestion could not be calculated in the background and should be
+        calculated on the input thread.
+
+ @return TRUE if a calculation completed for the current input, FALSE if no
+         calculation has completed or its result is stale.
+ */
+__success(return)
+BOOLEAN
+YoriShCollectBackgroundSuggestion(
+    __inout PYORI_SH_INPUT_BUFFER Buffer,
+    __out PBOOLEAN ForegroundRequired
+    )
+{
+    PYORI_SH_BACKGROUND_SUGGESTION Suggestion;
+    PYORI_SH_TAB_COMPLETE_CONTEXT TabContext;
+    BOOLEAN Result;
+
+    Suggestion = Buffer->BackgroundSuggestion;
+    if (Suggestion == NULL ||
+        WaitForSingleObject(Suggestion->Thread, 0) != WAIT_OBJECT_0) {
+
+        return FALSE;
+    }
+
+    CloseHandle(Suggestion->Thread);
+    Buffer->BackgroundSuggestion = NULL;
+
+    Result = FALSE;
+    if (!Buffer->SuggestionPopulated &&
+        Buffer->TabContext.MatchList.Next == NULL &&
+        Buffer->CurrentOffset == Suggestion->Buffer.CurrentOffset &&
+        YoriLibCompareString(&Buffer->String, &Suggestion->Buffer.String) == 0) {
+
+        Result = TRUE;
+        *ForegroundRequired = Suggestion->ForegroundRequired;
+
+        if (!Suggestion->ForegroundRequired) {
+
+            //
+            //  Move the tab context, including its list of matches, so
+            //  that later key presses can refine the suggestion.
+            //
+
+            YoriShClearTabCompletionMatches(Buffer);
+            TabContext = &Buffer->TabContext;
+            memcpy(TabContext, &Suggestion->Buffer.TabContext, sizeof(YORI_SH_TAB_COMPLETE_CONTEXT));
+            TabContext->BackgroundSuggestion = NULL;
+            if (TabContext->MatchList.Next != NULL) {
+                if (YoriLibIsListEmpty(&Suggestion->Buffer.TabContext.MatchList)) {
+                    YoriLibInitializeListHead(&TabContext->MatchList);
+                } else {
+                    TabContext->MatchList.Next->Prev = &TabContext->MatchList;
+                    TabContext->MatchList.Prev->Next = &TabContext->MatchList;
+                }
+            }
+            ZeroMemory(&Suggestion->Buffer.TabContext, sizeof(YORI_SH_TAB_COMPLETE_CONTEXT));
+
+            ASSERT(Buffer->SuggestionString.MemoryToFree == NULL);
+            memcpy(&Buffer->SuggestionString, &Suggestion->Buffer.SuggestionString, sizeof(YORI_STRING));
+            YoriLibInitEmptyString(&Suggestion->Buffer.SuggestionString);
+
+            Buffer->SuggestionPopulated = TRUE;
+            if (Buffer->SuggestionString.LengthInChars > 0) {
+                Buffer->SuggestionDirty = TRUE;
+            }
+        }
+    }
+
+    YoriShFreeBackgroundSuggestion(Suggestion);
+    return Result;
+}
+
+/**
+ Stop calculating a suggestion on a background thread, because the input
+ has changed or is about to be executed.  This waits for the thread to
+ terminate so that the input thread has exclusive use of shell state on
+ return.
+
+ @param Buffer Pointer to the input buffer.
+ */
+VOID
+YoriShCancelBackgroundSuggestion(
+    __inout PYORI_SH_INPUT_BUFFER Buffer
+    )
+{
+    PYORI_SH_BACKGROUND_SUGGESTION Suggestion;
+
+    Suggestion = Buffer->BackgroundSuggestion;
+    if (Suggestion == NULL) {
+        return;
+    }
+
+    Buffer->BackgroundSuggestion = NULL;
+    Suggestion->Cancelled = TRUE;
+    WaitForSingleObject(Suggestion->Thread, INFINITE);
+    CloseHandle(Suggestion->Thread);
+    YoriShFreeBackgroundSuggestion(Suggestion);
+}
+
 // vim:sw=4:ts=4:et:
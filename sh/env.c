@@ -195,6 +195,250 @@ YoriShGetAppDirectoryWithTrailingSlash(
     return LengthNeeded;
 }
 
+/**
+ The number of variables the environment cache can hold before it is
+ discarded and repopulated.
+ */
+#define YORI_SH_ENV_CACHE_MAX_ENTRIES 512
+
+/**
+ The result of querying a single variable from the process environment.
+ */
+typedef struct _YORI_SH_ENV_CACHE_ENTRY {
+
+    /**
+     The entry within the hash table, whose key is the variable name.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The entry within the list of all cached variables.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     TRUE if the variable exists in the process environment, FALSE if it
+     was found to not exist.
+     */
+    BOOLEAN Defined;
+
+    /**
+     The value of the variable, if Defined is TRUE.  This string is NULL
+     terminated.
+     */
+    YORI_STRING Value;
+} YORI_SH_ENV_CACHE_ENTRY, *PYORI_SH_ENV_CACHE_ENTRY;
+
+/**
+ A hash table of variables recently queried from the process environment,
+ or NULL if none are cached.  Expanding a variable queries it once to find
+ its length and again to fetch it, and scripts tend to expand the same
+ variables repeatedly, each of which would otherwise be a linear search of
+ the process environment block.
+ */
+PYORI_HASH_TABLE YoriShEnvCacheTable;
+
+/**
+ A list of all variables in the environment cache.
+ */
+YORI_LIST_ENTRY YoriShEnvCacheList;
+
+/**
+ The number of variables in the environment cache.
+ */
+DWORD YoriShEnvCacheCount;
+
+/**
+ The environment generation that the environment cache describes.  If the
+ environment generation changes, the cache is discarded.
+ */
+DWORD YoriShEnvCacheGeneration;
+
+/**
+ Remove a variable from the environment cache and free it.
+
+ @param Entry Pointer to the cached variable to free.
+ */
+VOID
+YoriShEnvCacheFreeEntry(
+    __in PYORI_SH_ENV_CACHE_ENTRY Entry
+    )
+{
+    YoriLibRemoveListItem(&Entry->ListEntry);
+    YoriLibHashRemoveByEntry(&Entry->HashEntry);
+    YoriLibFreeStringContents(&Entry->Value);
+    YoriLibFree(Entry);
+    YoriShEnvCacheCount--;
+}
+
+/**
+ Discard all variables from the environment cache so later queries go to
+ the process environment.  This is called whenever the process environment
+ may have been changed without going through this module, such as by a
+ builtin command.
+ */
+VOID
+YoriShInvalidateEnvironmentCache(VOID)
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_ENV_CACHE_ENTRY Entry;
+
+    if (YoriShEnvCacheTable == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&YoriShEnvCacheList, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, YORI_SH_ENV_CACHE_ENTRY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&YoriShEnvCacheList, ListEntry);
+        YoriShEnvCacheFreeEntry(Entry);
+    }
+}
+
+/**
+ Free the environment cache.
+ */
+VOID
+YoriShCleanupEnvironmentCache(VOID)
+{
+    if (YoriShEnvCacheTable == NULL) {
+        return;
+    }
+
+    YoriShInvalidateEnvironmentCache();
+    YoriLibFreeEmptyHashTable(YoriShEnvCacheTable);
+    YoriShEnvCacheTable = NULL;
+}
+
+/**
+ Remove a single variable from the environment cache, if it is present.
+
+ @param Name Pointer to the name of the variable.
+ */
+VOID
+YoriShInvalidateEnvironmentCacheEntry(
+    __in PYORI_STRING Name
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+
+    if (YoriShEnvCacheTable == NULL) {
+        return;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(YoriShEnvCacheTable, Name);
+    if (HashEntry != NULL) {
+        YoriShEnvCacheFreeEntry(CONTAINING_RECORD(HashEntry, YORI_SH_ENV_CACHE_ENTRY, HashEntry));
+    }
+}
+
+/**
+ Query a variable from the process environment, consulting the environment
+ cache first and populating it on a miss.
+
+ @param Name The name of the environment variable to get.
+
+ @param Variable Pointer to the buffer to receive the variable's contents.
+
+ @param Size The length of the Variable parameter, in characters.
+
+ @return The number of characters copied (without NULL), of if the buffer
+         is too small, the number of characters needed (including NULL.)
+         Zero indicates the variable is not defined.
+ */
+YORI_ALLOC_SIZE_T
+YoriShGetCachedEnvironmentVariable(
+    __in LPCTSTR Name,
+    __out_opt _When_(Size > 0, __out) LPTSTR Variable,
+    __in YORI_ALLOC_SIZE_T Size
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_SH_ENV_CACHE_ENTRY Entry;
+    YORI_STRING NameString;
+    YORI_ALLOC_SIZE_T Length;
+
+    if (YoriShEnvCacheTable == NULL) {
+        YoriShEnvCacheTable = YoriLibAllocateHashTable(256);
+        if (YoriShEnvCacheTable == NULL) {
+            return (YORI_ALLOC_SIZE_T)GetEnvironmentVariable(Name, Variable, Size);
+        }
+        YoriLibInitializeListHead(&YoriShEnvCacheList);
+        YoriShEnvCacheCount = 0;
+        YoriShEnvCacheGeneration = YoriShGlobal.EnvironmentGeneration;
+    }
+
+    if (YoriShEnvCacheGeneration != YoriShGlobal.EnvironmentGeneration) {
+        YoriShInvalidateEnvironmentCache();
+        YoriShEnvCacheGeneration = YoriShGlobal.EnvironmentGeneration;
+    }
+
+    YoriLibConstantString(&NameString, Name);
+    HashEntry = YoriLibHashLookupByKey(YoriShEnvCacheTable, &NameString);
+    if (HashEntry != NULL) {
+        Entry = CONTAINING_RECORD(HashEntry, YORI_SH_ENV_CACHE_ENTRY, HashEntry);
+    } else {
+
+        if (YoriShEnvCacheCount >= YORI_SH_ENV_CACHE_MAX_ENTRIES) {
+            YoriShInvalidateEnvironmentCache();
+        }
+
+        Entry = YoriLibMalloc(sizeof(YORI_SH_ENV_CACHE_ENTRY));
+        if (Entry == NULL) {
+            return (YORI_ALLOC_SIZE_T)GetEnvironmentVariable(Name, Variable, Size);
+        }
+
+        ZeroMemory(Entry, sizeof(YORI_SH_ENV_CACHE_ENTRY));
+        YoriLibInitEmptyString(&Entry->Value);
+
+        Length = (YORI_ALLOC_SIZE_T)GetEnvironmentVariable(Name, NULL, 0);
+        if (Length != 0) {
+            if (!YoriLibAllocateString(&Entry->Value, Length)) {
+                YoriLibFree(Entry);
+                return (YORI_ALLOC_SIZE_T)GetEnvironmentVariable(Name, Variable, Size);
+            }
+
+            Entry->Value.LengthInChars = (YORI_ALLOC_SIZE_T)GetEnvironmentVariable(Name, Entry->Value.StartOfString, Entry->Value.LengthAllocated);
+            if (Entry->Value.LengthInChars == 0 ||
+                Entry->Value.LengthInChars >= Entry->Value.LengthAllocated) {
+
+                YoriLibFreeStringContents(&Entry->Value);
+                YoriLibFree(Entry);
+                return (YORI_ALLOC_SIZE_T)GetEnvironmentVariable(Name, Variable, Size);
+            }
+            Entry->Defined = TRUE;
+        }
+
+        //
+        //  The name is typically in a buffer that will be reused, so the
+        //  key needs its own allocation.
+        //
+
+        if (!YoriLibAllocateString(&NameString, NameString.LengthInChars + 1)) {
+            YoriLibFreeStringContents(&Entry->Value);
+            YoriLibFree(Entry);
+            return (YORI_ALLOC_SIZE_T)GetEnvironmentVariable(Name, Variable, Size);
+        }
+
+        NameString.LengthInChars = YoriLibSPrintf(NameString.StartOfString, _T("%s"), Name);
+        YoriLibHashInsertByKey(YoriShEnvCacheTable, &NameString, Entry, &Entry->HashEntry);
+        YoriLibAppendList(&YoriShEnvCacheList, &Entry->ListEntry);
+        YoriShEnvCacheCount++;
+        YoriLibFreeStringContents(&NameString);
+    }
+
+    if (!Entry->Defined) {
+        return 0;
+    }
+
+    if (Variable == NULL || Size <= Entry->Value.LengthInChars) {
+        return Entry->Value.LengthInChars + 1;
+    }
+
+    memcpy(Variable, Entry->Value.StartOfString, (Entry->Value.LengthInChars + 1) * sizeof(TCHAR));
+    return Entry->Value.LengthInChars;
+}
+
 //
 //  Warning about manipulating the Variable buffer but failing the
 //  function.  This function is trying to mimic the behavior of the
@@ -269,7 +513,7 @@ YoriShGetEnvironmentVariableWithoutSubstitution(
         }
     } else {
 
-        Length = (YORI_ALLOC_SIZE_T)GetEnvironmentVariable(Name, Variable, Size);
+        Length = YoriShGetCachedEnvironmentVariable(Name, Variable, Size);
     }
 
     if (Generation != NULL) {
@@ -1005,6 +1249,7 @@ YoriShSetEnvironmentVariable(
     LPTSTR NullTerminatedValue;
     BOOLEAN AllocatedVariable;
     BOOLEAN AllocatedValue;
+    BOOLEAN CacheWasCurrent;
     BOOL Result;
 
     if (YoriLibIsStringNullTerminated(VariableName)) {
@@ -1037,9 +1282,25 @@ YoriShSetEnvironmentVariable(
 
     ASSERT(!AllocatedVariable && !AllocatedValue);
 
+    //
+    //  Changing one variable only needs to discard that variable from the
+    //  environment cache.  If the cache was current before the change, it
+    //  remains current afterwards.
+    //
+
+    CacheWasCurrent = FALSE;
+    if (YoriShEnvCacheGeneration == YoriShGlobal.EnvironmentGeneration) {
+        CacheWasCurrent = TRUE;
+    }
+
     Result = SetEnvironmentVariable(NullTerminatedVariable, NullTerminatedValue);
     YoriShGlobal.EnvironmentGeneration++;
 
+    YoriShInvalidateEnvironmentCacheEntry(VariableName);
+    if (CacheWasCurrent) {
+        YoriShEnvCacheGeneration = YoriShGlobal.EnvironmentGeneration;
+    }
+
     if (AllocatedVariable) {
         YoriLibDereference(NullTerminatedVariable);
     }
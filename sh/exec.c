@@ -147,6 +147,7 @@ YoriShExecuteSingleProgram(
     BOOLEAN ExecProcess = TRUE;
     BOOLEAN LaunchFailed = FALSE;
     BOOLEAN LaunchViaShellExecute = FALSE;
+    LONGLONG CreateStartTime;
 
     if (YoriLibIsPathUrl(&ExecContext->CmdToExec.ArgV[0])) {
         LaunchViaShellExecute = TRUE;
@@ -190,7 +191,16 @@ YoriShExecuteSingleProgram(
         BOOL FailedInRedirection = FALSE;
 
         if (!LaunchViaShellExecute && !ExecContext->CaptureEnvironmentOnExit) {
-            DWORD Err = YoriLibShCreateProcess(ExecContext, NULL, &FailedInRedirection);
+            DWORD Err;
+
+            CreateStartTime = 0;
+            if (YoriShGlobal.ProfileCommand != NULL) {
+                CreateStartTime = YoriShProfileGetTime();
+            }
+            Err = YoriLibShCreateProcess(ExecContext, NULL, &FailedInRedirection);
+            if (CreateStartTime != 0) {
+                YoriShProfileAddElapsed(&YoriShGlobal.ProfileCommand->CreateTime, CreateStartTime);
+            }
 
             if (Err != NO_ERROR) {
                 if (Err == ERROR_ELEVATION_REQUIRED) {
@@ -360,6 +370,72 @@ YoriShExecViaSubshell(
 }
 
 
+/**
+ Prepare an exec plan for its output to be captured.  Any command which
+ would output to the default location is changed to output to a shell owned
+ buffer, and the shell must wait for it.
+
+ @param ExecPlan Pointer to the exec plan to update.
+ */
+VOID
+YoriShPrepareExecPlanForCapture(
+    __inout PYORI_LIBSH_EXEC_PLAN ExecPlan
+    )
+{
+    PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext;
+
+    ExecContext = ExecPlan->FirstCmd;
+    while (ExecContext != NULL) {
+
+        if (ExecContext->StdOutType == StdOutTypeDefault) {
+            ExecContext->StdOutType = StdOutTypeBuffer;
+
+            if (!ExecContext->WaitForCompletion &&
+                ExecContext->NextProgramType != NextProgramExecUnconditionally) {
+
+                ExecContext->WaitForCompletion = TRUE;
+            }
+        }
+
+        ExecContext = ExecContext->NextProgram;
+    }
+}
+
+/**
+ Execute an exec plan on behalf of a builtin whose output is being captured
+ into memory.  The output of the plan is buffered and then written to
+ standard output, which places it into the capture at the point where the
+ builtin invoked the plan.
+
+ @param ExecPlan Pointer to the exec plan to execute.
+ */
+VOID
+YoriShExecExecPlanIntoCapture(
+    __in PYORI_LIBSH_EXEC_PLAN ExecPlan
+    )
+{
+    PVOID OutputBuffer;
+    YORI_STRING Output;
+
+    YoriShPrepareExecPlanForCapture(ExecPlan);
+
+    //
+    //  Anything executed by this plan has a pipe to write to, so it does not
+    //  need to be redirected again.
+    //
+
+    YoriShGlobal.InProcCaptureActive = FALSE;
+    YoriShExecExecPlan(ExecPlan, &OutputBuffer);
+    YoriShGlobal.InProcCaptureActive = TRUE;
+
+    if (OutputBuffer != NULL &&
+        YoriLibShGetProcessOutputBuffer(OutputBuffer, &Output)) {
+
+        YoriLibOutputString(GetStdHandle(STD_OUTPUT_HANDLE), 0, &Output);
+        YoriLibFreeStringContents(&Output);
+    }
+}
+
 /**
  Execute an exec plan.  An exec plan has multiple processes, including
  different pipe and redirection operators.  Optionally return the result
@@ -379,6 +455,14 @@ YoriShExecExecPlan(
     PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext;
     PVOID PreviouslyObservedOutputBuffer = NULL;
     BOOLEAN ExecutableFound;
+    YORI_SH_PROFILE_COMMAND ProfileCommand;
+    PYORI_SH_PROFILE_COMMAND PreviousProfileCommand;
+    LONGLONG ResolveStartTime;
+
+    if (OutputBuffer == NULL && YoriShGlobal.InProcCaptureActive) {
+        YoriShExecExecPlanIntoCapture(ExecPlan);
+        return;
+    }
 
     //
     //  If a plan requires executing multiple tasks without waiting, hand the
@@ -394,6 +478,7 @@ YoriShExecExecPlan(
         return;
     }
 
+    PreviousProfileCommand = YoriShGlobal.ProfileCommand;
     ExecContext = ExecPlan->FirstCmd;
     while (ExecContext != NULL) {
 
@@ -416,6 +501,11 @@ YoriShExecExecPlan(
 
         YoriShExpandAlias(&ExecContext->CmdToExec);
 
+        YoriShGlobal.ProfileCommand = NULL;
+        if (YoriShProfileBeginCommand(&ProfileCommand)) {
+            YoriShGlobal.ProfileCommand = &ProfileCommand;
+        }
+
         if (YoriLibIsPathUrl(&ExecContext->CmdToExec.ArgV[0])) {
             YoriShGlobal.ErrorLevel = YoriShExecuteSingleProgram(ExecContext);
         } else if (ExecContext->CmdToExec.ArgC >= 2 &&
@@ -430,9 +520,16 @@ YoriShExecExecPlan(
 
             YoriShGlobal.ErrorLevel = YoriShBuiltIn(ExecContext);
         } else {
+            ResolveStartTime = 0;
+            if (YoriShGlobal.ProfileCommand != NULL) {
+                ResolveStartTime = YoriShProfileGetTime();
+            }
             if (!YoriShResolveCommandToExecutable(&ExecContext->CmdToExec, &ExecutableFound)) {
                 break;
             }
+            if (ResolveStartTime != 0) {
+                YoriShProfileAddElapsed(&ProfileCommand.ResolveTime, ResolveStartTime);
+            }
 
             if (ExecutableFound) {
                 YoriShGlobal.ErrorLevel = YoriShExecuteSingleProgram(ExecContext);
@@ -441,12 +538,18 @@ YoriShExecExecPlan(
                 if (OutputBuffer != NULL) {
                     *OutputBuffer = NULL;
                 }
+                YoriShGlobal.ProfileCommand = PreviousProfileCommand;
                 return;
             } else {
                 YoriShGlobal.ErrorLevel = YoriShBuiltIn(ExecContext);
             }
         }
 
+        if (YoriShGlobal.ProfileCommand != NULL) {
+            YoriShProfileEndCommand(&ProfileCommand, ExecContext);
+            YoriShGlobal.ProfileCommand = NULL;
+        }
+
         if (ExecContext->TaskCompletionDisplayed) {
             ExecPlan->TaskCompletionDisplayed = TRUE;
         }
@@ -513,6 +616,8 @@ YoriShExecExecPlan(
         }
     }
 
+    YoriShGlobal.ProfileCommand = PreviousProfileCommand;
+
     if (OutputBuffer != NULL) {
         *OutputBuffer = PreviouslyObservedOutputBuffer;
     }
@@ -544,6 +649,8 @@ YoriShExecuteExpressionAndCaptureOutput(
     PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext;
     YORI_LIBSH_CMD_CONTEXT CmdContext;
     PVOID OutputBuffer;
+    YORI_SH_INPROC_CAPTURE Capture;
+    PYORI_SH_INPROC_CAPTURE PreviousCapture;
     YORI_ALLOC_SIZE_T Index;
 
     //
@@ -572,32 +679,39 @@ YoriShExecuteExpressionAndCaptureOutput(
     }
 
     //
-    //  If we're doing backquote evaluation, set the output back to a 
-    //  shell owned buffer, and the process must wait.
+    //  If the expression is a single command with no redirection, and it
+    //  turns out to be a builtin or module, its output can be captured
+    //  directly into memory.
     //
 
+    ZeroMemory(&Capture, sizeof(Capture));
     ExecContext = ExecPlan.FirstCmd;
-    while (ExecContext != NULL) {
+    if (ExecPlan.NumberCommands == 1 &&
+        ExecContext->StdInType == StdInTypeDefault &&
+        ExecContext->StdOutType == StdOutTypeDefault &&
+        ExecContext->StdErrType == StdErrTypeDefault) {
 
-        if (ExecContext->StdOutType == StdOutTypeDefault) {
-            ExecContext->StdOutType = StdOutTypeBuffer;
-
-            if (!ExecContext->WaitForCompletion &&
-                ExecContext->NextProgramType != NextProgramExecUnconditionally) {
+        Capture.ExecContext = ExecContext;
+    }
 
-                ExecContext->WaitForCompletion = TRUE;
-            }
-        }
+    //
+    //  If we're doing backquote evaluation, set the output back to a 
+    //  shell owned buffer, and the process must wait.
+    //
 
-        ExecContext = ExecContext->NextProgram;
-    }
+    YoriShPrepareExecPlanForCapture(&ExecPlan);
 
+    PreviousCapture = YoriShGlobal.InProcCapture;
+    YoriShGlobal.InProcCapture = &Capture;
     YoriShExecExecPlan(&ExecPlan, &OutputBuffer);
+    YoriShGlobal.InProcCapture = PreviousCapture;
 
     YoriLibInitEmptyString(ProcessOutput);
-    if (OutputBuffer != NULL) {
+    if (Capture.Complete || OutputBuffer != NULL) {
 
-        if (!YoriLibShGetProcessOutputBuffer(OutputBuffer, ProcessOutput)) {
+        if (Capture.Complete) {
+            memcpy(ProcessOutput, &Capture.Output, sizeof(YORI_STRING));
+        } else if (!YoriLibShGetProcessOutputBuffer(OutputBuffer, ProcessOutput)) {
             YoriLibInitEmptyString(ProcessOutput);
         }
 
@@ -717,6 +831,256 @@ YoriShExpandBackquotes(
     return TRUE;
 }
 
+/**
+ The maximum number of parsed expressions to retain.  Scripts and loops
+ tend to execute a small number of distinct expressions many times, so this
+ only needs to be large enough to hold the body of a typical loop.
+ */
+#define YORI_SH_PARSE_CACHE_MAX_ENTRIES 64
+
+/**
+ A parsed expression retained so that executing the same text again does
+ not need to tokenize it again.
+ */
+typedef struct _YORI_SH_PARSE_CACHE_ENTRY {
+
+    /**
+     The entry within the hash table, whose key is the expression text
+     before environment expansion.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The entry within the list of cached expressions, ordered from least
+     recently used to most recently used.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The result of parsing the expression.  This is never handed to a
+     caller directly; callers receive a copy so that any modification made
+     while executing the expression does not alter the cached copy.
+     */
+    YORI_LIBSH_CMD_CONTEXT CmdContext;
+} YORI_SH_PARSE_CACHE_ENTRY, *PYORI_SH_PARSE_CACHE_ENTRY;
+
+/**
+ A hash table of parsed expressions, or NULL if no expression has been
+ cached.
+ */
+PYORI_HASH_TABLE YoriShParseCacheTable;
+
+/**
+ A list of parsed expressions, ordered from least recently used to most
+ recently used.
+ */
+YORI_LIST_ENTRY YoriShParseCacheList;
+
+/**
+ The number of entries in the parse cache.
+ */
+DWORD YoriShParseCacheCount;
+
+/**
+ Remove an entry from the parse cache and free it.
+
+ @param Entry Pointer to the entry to free.
+ */
+VOID
+YoriShParseCacheFreeEntry(
+    __in PYORI_SH_PARSE_CACHE_ENTRY Entry
+    )
+{
+    YoriLibRemoveListItem(&Entry->ListEntry);
+    YoriLibHashRemoveByEntry(&Entry->HashEntry);
+    YoriLibShFreeCmdContext(&Entry->CmdContext);
+    YoriLibFree(Entry);
+    YoriShParseCacheCount--;
+}
+
+/**
+ Free all entries in the parse cache and the cache itself.
+ */
+VOID
+YoriShClearParseCache(VOID)
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_PARSE_CACHE_ENTRY Entry;
+
+    if (YoriShParseCacheTable == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&YoriShParseCacheList, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, YORI_SH_PARSE_CACHE_ENTRY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&YoriShParseCacheList, ListEntry);
+        YoriShParseCacheFreeEntry(Entry);
+    }
+
+    YoriLibFreeEmptyHashTable(YoriShParseCacheTable);
+    YoriShParseCacheTable = NULL;
+}
+
+/**
+ Copy a parsed expression from the parse cache into a new CmdContext which
+ has its own allocation for each argument, in the same form as the parser
+ would have generated.
+
+ @param SrcCmdContext Pointer to the cached CmdContext.
+
+ @param DestCmdContext On successful completion, populated with a copy of
+        the cached CmdContext.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShParseCacheCopyCmdContext(
+    __in PYORI_LIBSH_CMD_CONTEXT SrcCmdContext,
+    __out PYORI_LIBSH_CMD_CONTEXT DestCmdContext
+    )
+{
+    YORI_ALLOC_SIZE_T Count;
+    YORI_ALLOC_SIZE_T RequiredCharCount;
+    LPTSTR OutputString;
+
+    RequiredCharCount = 0;
+    for (Count = 0; Count < SrcCmdContext->ArgC; Count++) {
+        RequiredCharCount = RequiredCharCount + SrcCmdContext->ArgV[Count].LengthInChars + 1;
+    }
+
+    if (!YoriLibShAllocateArgCount(DestCmdContext, SrcCmdContext->ArgC, RequiredCharCount * sizeof(TCHAR), (PVOID *)&OutputString)) {
+        return FALSE;
+    }
+
+    DestCmdContext->CurrentArg = SrcCmdContext->CurrentArg;
+    DestCmdContext->CurrentArgOffset = SrcCmdContext->CurrentArgOffset;
+    DestCmdContext->TrailingChars = SrcCmdContext->TrailingChars;
+
+    for (Count = 0; Count < SrcCmdContext->ArgC; Count++) {
+        YoriLibInitEmptyString(&DestCmdContext->ArgV[Count]);
+        DestCmdContext->ArgV[Count].StartOfString = OutputString;
+        DestCmdContext->ArgV[Count].LengthInChars = SrcCmdContext->ArgV[Count].LengthInChars;
+        DestCmdContext->ArgV[Count].LengthAllocated = SrcCmdContext->ArgV[Count].LengthInChars + 1;
+        memcpy(OutputString, SrcCmdContext->ArgV[Count].StartOfString, SrcCmdContext->ArgV[Count].LengthInChars * sizeof(TCHAR));
+        OutputString[SrcCmdContext->ArgV[Count].LengthInChars] = '\0';
+        YoriLibReference(DestCmdContext->ArgV);
+        DestCmdContext->ArgV[Count].MemoryToFree = DestCmdContext->ArgV;
+        DestCmdContext->ArgContexts[Count] = SrcCmdContext->ArgContexts[Count];
+        OutputString = OutputString + SrcCmdContext->ArgV[Count].LengthInChars + 1;
+    }
+
+    return TRUE;
+}
+
+/**
+ Parse an expression into a CmdContext, using a previous parse of the same
+ text if one is available.  Parsing only depends on the text of the
+ expression, since environment variables and aliases are expanded after
+ parsing, so a previous result can be used for as long as it is retained.
+
+ @param Expression Pointer to the expression to parse.
+
+ @param CmdContext On successful completion, populated with the parsed
+        expression.  The caller should free this with
+        YoriLibShFreeCmdContext.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShParseCmdlineToCmdContextCached(
+    __in PYORI_STRING Expression,
+    __out PYORI_LIBSH_CMD_CONTEXT CmdContext
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_SH_PARSE_CACHE_ENTRY Entry;
+    PYORI_LIST_ENTRY ListEntry;
+    YORI_STRING Key;
+
+    if (YoriShParseCacheTable == NULL) {
+        YoriShParseCacheTable = YoriLibAllocateHashTable(YORI_SH_PARSE_CACHE_MAX_ENTRIES);
+        if (YoriShParseCacheTable != NULL) {
+            YoriLibInitializeListHead(&YoriShParseCacheList);
+            YoriShParseCacheCount = 0;
+        }
+    }
+
+    if (YoriShParseCacheTable != NULL) {
+        HashEntry = YoriLibHashLookupByKey(YoriShParseCacheTable, Expression);
+        if (HashEntry != NULL) {
+            Entry = CONTAINING_RECORD(HashEntry, YORI_SH_PARSE_CACHE_ENTRY, HashEntry);
+
+            //
+            //  The hash table compares keys without regard to case, but
+            //  case is significant to the commands being executed.  An
+            //  entry that differs only by case is replaced below.
+            //
+
+            if (YoriLibCompareString(&Entry->HashEntry.Key, Expression) == 0) {
+                if (!YoriShParseCacheCopyCmdContext(&Entry->CmdContext, CmdContext)) {
+                    return FALSE;
+                }
+                YoriLibRemoveListItem(&Entry->ListEntry);
+                YoriLibAppendList(&YoriShParseCacheList, &Entry->ListEntry);
+                return TRUE;
+            }
+
+            YoriShParseCacheFreeEntry(Entry);
+        }
+    }
+
+    if (!YoriLibShParseCmdlineToCmdContext(Expression, 0, CmdContext)) {
+        return FALSE;
+    }
+
+    if (YoriShParseCacheTable == NULL || CmdContext->ArgC == 0) {
+        return TRUE;
+    }
+
+    //
+    //  The expression is typically in a buffer that will be freed once it
+    //  is executed, so the key needs its own allocation.
+    //
+
+    if (!YoriLibAllocateString(&Key, Expression->LengthInChars + 1)) {
+        return TRUE;
+    }
+
+    memcpy(Key.StartOfString, Expression->StartOfString, Expression->LengthInChars * sizeof(TCHAR));
+    Key.StartOfString[Expression->LengthInChars] = '\0';
+    Key.LengthInChars = Expression->LengthInChars;
+
+    Entry = YoriLibMalloc(sizeof(YORI_SH_PARSE_CACHE_ENTRY));
+    if (Entry == NULL) {
+        YoriLibFreeStringContents(&Key);
+        return TRUE;
+    }
+
+    ZeroMemory(Entry, sizeof(YORI_SH_PARSE_CACHE_ENTRY));
+    if (!YoriShParseCacheCopyCmdContext(CmdContext, &Entry->CmdContext)) {
+        YoriLibFreeStringContents(&Key);
+        YoriLibFree(Entry);
+        return TRUE;
+    }
+
+    if (YoriShParseCacheCount >= YORI_SH_PARSE_CACHE_MAX_ENTRIES) {
+        ListEntry = YoriLibGetNextListEntry(&YoriShParseCacheList, NULL);
+        if (ListEntry != NULL) {
+            YoriShParseCacheFreeEntry(CONTAINING_RECORD(ListEntry, YORI_SH_PARSE_CACHE_ENTRY, ListEntry));
+        }
+    }
+
+    YoriLibHashInsertByKey(YoriShParseCacheTable, &Key, Entry, &Entry->HashEntry);
+    YoriLibAppendList(&YoriShParseCacheList, &Entry->ListEntry);
+    YoriShParseCacheCount++;
+    YoriLibFreeStringContents(&Key);
+
+    return TRUE;
+}
+
 /**
  Parse and execute a command string.  This will internally perform parsing
  and redirection, as well as execute multiple subprocesses as needed.  This
@@ -737,6 +1101,9 @@ YoriShExecuteExpression(
     YORI_LIBSH_EXEC_PLAN ExecPlan;
     YORI_LIBSH_CMD_CONTEXT CmdContext;
     YORI_STRING CurrentFullExpression;
+    LONGLONG ParseStartTime;
+
+    ParseStartTime = YoriShProfileGetTime();
 
     //
     //  Expand all backquotes.
@@ -752,7 +1119,7 @@ YoriShExecuteExpression(
     //  Parse the expression we're trying to execute.
     //
 
-    if (!YoriLibShParseCmdlineToCmdContext(&CurrentFullExpression, 0, &CmdContext)) {
+    if (!YoriShParseCmdlineToCmdContextCached(&CurrentFullExpression, &CmdContext)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Parse error\n"));
         YoriLibFreeStringContents(&CurrentFullExpression);
         return FALSE;
@@ -777,6 +1144,7 @@ YoriShExecuteExpression(
         return FALSE;
     }
 
+    YoriShProfileSetParseTime(ParseStartTime);
     YoriShExecExecPlan(&ExecPlan, NULL);
 
     YoriLibShFreeExecPlan(&ExecPlan);
@@ -48,6 +48,459 @@ HANDLE YoriShHistoryLock;
  */
 BOOL YoriShHistoryInitialized;
 
+/**
+ The number of most recent entries to load from the history file when the
+ shell starts.  Older entries are loaded when history is first searched.
+ */
+#define YORI_SH_HISTORY_EAGER_LOAD_COUNT 200
+
+/**
+ The number of bytes to read from the history file at a time when scanning
+ or compacting it.
+ */
+#define YORI_SH_HISTORY_FILE_CHUNK_SIZE (64 * 1024)
+
+/**
+ The number of bytes at the beginning of the history file containing
+ entries older than those loaded when the shell started, which have not yet
+ been loaded.
+ */
+DWORDLONG YoriShHistoryDeferredLength;
+
+/**
+ The volume serial number of the history file when it was loaded.  Used to
+ detect whether the file has been replaced before loading deferred entries.
+ */
+DWORD YoriShHistoryFileVolume;
+
+/**
+ The high part of the file index of the history file when it was loaded.
+ */
+DWORD YoriShHistoryFileIndexHigh;
+
+/**
+ The low part of the file index of the history file when it was loaded.
+ */
+DWORD YoriShHistoryFileIndexLow;
+
+/**
+ The number of characters in each substring used to index history.
+ */
+#define YORI_SH_HISTORY_TRIGRAM_LENGTH 3
+
+/**
+ A set of history entries which contain a particular three character
+ sequence, compared case insensitively.
+ */
+typedef struct _YORI_SH_HISTORY_TRIGRAM {
+
+    /**
+     The entry for this trigram within the hash table of trigrams.  The key
+     refers to @ref KeyBuffer .
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The links for this trigram within the list of all trigrams, used to
+     free them.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     An array of history entries containing this trigram, ordered from
+     oldest to newest.  Valid elements begin at @ref Start .
+     */
+    PYORI_SH_HISTORY_ENTRY *Entries;
+
+    /**
+     The index of the first valid element in @ref Entries .  Since history
+     is trimmed from the oldest entry, removing an entry typically just
+     advances this value.
+     */
+    DWORD Start;
+
+    /**
+     The number of valid elements in @ref Entries .
+     */
+    DWORD Count;
+
+    /**
+     The number of elements allocated in @ref Entries .
+     */
+    DWORD Allocated;
+
+    /**
+     The characters of the trigram.
+     */
+    TCHAR KeyBuffer[YORI_SH_HISTORY_TRIGRAM_LENGTH];
+
+} YORI_SH_HISTORY_TRIGRAM, *PYORI_SH_HISTORY_TRIGRAM;
+
+/**
+ A hash table of every trigram found in history, used to find entries
+ containing a search string without comparing against every entry.
+ */
+PYORI_HASH_TABLE YoriShHistoryTrigrams;
+
+/**
+ A list of every trigram within @ref YoriShHistoryTrigrams .
+ */
+YORI_LIST_ENTRY YoriShHistoryTrigramList;
+
+/**
+ Set to TRUE if the trigram index could not be maintained due to allocation
+ failure.  Searches scan all of history in this case.
+ */
+BOOLEAN YoriShHistoryIndexFailed;
+
+/**
+ The sequence number to assign to the next history entry.
+ */
+DWORD YoriShHistoryNextSequence;
+
+/**
+ Free the trigram index of history.
+ */
+VOID
+YoriShHistoryIndexFree(VOID)
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_HISTORY_TRIGRAM Trigram;
+
+    if (YoriShHistoryTrigrams == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&YoriShHistoryTrigramList, NULL);
+    while (ListEntry != NULL) {
+        Trigram = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_TRIGRAM, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&YoriShHistoryTrigramList, ListEntry);
+        YoriLibRemoveListItem(&Trigram->ListEntry);
+        YoriLibHashRemoveByEntry(&Trigram->HashEntry);
+        if (Trigram->Entries != NULL) {
+            YoriLibFree(Trigram->Entries);
+        }
+        YoriLibFree(Trigram);
+    }
+
+    YoriLibFreeEmptyHashTable(YoriShHistoryTrigrams);
+    YoriShHistoryTrigrams = NULL;
+}
+
+/**
+ Add a newly inserted history entry to the trigram index.  If this fails,
+ the index is discarded, since an index that is missing entries would
+ cause searches to miss matches.
+
+ @param HistoryEntry Pointer to the history entry to add.
+ */
+VOID
+YoriShHistoryIndexAddEntry(
+    __in PYORI_SH_HISTORY_ENTRY HistoryEntry
+    )
+{
+    PYORI_SH_HISTORY_TRIGRAM Trigram;
+    PYORI_SH_HISTORY_ENTRY *NewEntries;
+    PYORI_HASH_ENTRY HashEntry;
+    YORI_STRING Substring;
+    YORI_STRING Key;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD NewAllocated;
+    BOOLEAN Failed;
+
+    if (YoriShHistoryIndexFailed) {
+        return;
+    }
+
+    if (YoriShHistoryTrigrams == NULL) {
+        YoriShHistoryTrigrams = YoriLibAllocateHashTable(4000);
+        if (YoriShHistoryTrigrams == NULL) {
+            YoriShHistoryIndexFailed = TRUE;
+            return;
+        }
+        YoriLibInitializeListHead(&YoriShHistoryTrigramList);
+    }
+
+    YoriLibInitEmptyString(&Substring);
+    Substring.LengthInChars = YORI_SH_HISTORY_TRIGRAM_LENGTH;
+    Failed = FALSE;
+
+    for (Index = 0; Index + YORI_SH_HISTORY_TRIGRAM_LENGTH <= HistoryEntry->CmdLine.LengthInChars; Index++) {
+        Substring.StartOfString = &HistoryEntry->CmdLine.StartOfString[Index];
+
+        HashEntry = YoriLibHashLookupByKey(YoriShHistoryTrigrams, &Substring);
+        if (HashEntry != NULL) {
+            Trigram = HashEntry->Context;
+        } else {
+            Trigram = YoriLibMalloc(sizeof(YORI_SH_HISTORY_TRIGRAM));
+            if (Trigram == NULL) {
+                Failed = TRUE;
+                break;
+            }
+
+            ZeroMemory(Trigram, sizeof(YORI_SH_HISTORY_TRIGRAM));
+            memcpy(Trigram->KeyBuffer, Substring.StartOfString, YORI_SH_HISTORY_TRIGRAM_LENGTH * sizeof(TCHAR));
+            YoriLibInitEmptyString(&Key);
+            Key.StartOfString = Trigram->KeyBuffer;
+            Key.LengthInChars = YORI_SH_HISTORY_TRIGRAM_LENGTH;
+            YoriLibHashInsertByKey(YoriShHistoryTrigrams, &Key, Trigram, &Trigram->HashEntry);
+            YoriLibAppendList(&YoriShHistoryTrigramList, &Trigram->ListEntry);
+        }
+
+        //
+        //  A trigram that occurs more than once in the same entry only
+        //  needs to refer to the entry once.  Since the entry is the newest,
+        //  it can only be the final element.
+        //
+
+        if (Trigram->Count > 0 &&
+            Trigram->Entries[Trigram->Start + Trigram->Count - 1] == HistoryEntry) {
+
+            continue;
+        }
+
+        if (Trigram->Start + Trigram->Count >= Trigram->Allocated) {
+
+            //
+            //  If at least half of the array has been consumed by removing
+            //  old entries, shuffle the remaining entries down rather than
+            //  growing it.
+            //
+
+            if (Trigram->Start > 0 && Trigram->Start >= Trigram->Count) {
+                memmove(Trigram->Entries, &Trigram->Entries[Trigram->Start], Trigram->Count * sizeof(PYORI_SH_HISTORY_ENTRY));
+                Trigram->Start = 0;
+            } else {
+                NewAllocated = Trigram->Allocated * 2;
+                if (NewAllocated < 4) {
+                    NewAllocated = 4;
+                }
+                NewEntries = YoriLibMalloc(NewAllocated * sizeof(PYORI_SH_HISTORY_ENTRY));
+                if (NewEntries == NULL) {
+                    Failed = TRUE;
+                    break;
+                }
+
+                if (Trigram->Entries != NULL) {
+                    memcpy(NewEntries, &Trigram->Entries[Trigram->Start], Trigram->Count * sizeof(PYORI_SH_HISTORY_ENTRY));
+                    YoriLibFree(Trigram->Entries);
+                }
+                Trigram->Entries = NewEntries;
+                Trigram->Allocated = NewAllocated;
+                Trigram->Start = 0;
+            }
+        }
+
+        Trigram->Entries[Trigram->Start + Trigram->Count] = HistoryEntry;
+        Trigram->Count++;
+    }
+
+    if (Failed) {
+        YoriShHistoryIndexFree();
+        YoriShHistoryIndexFailed = TRUE;
+    }
+}
+
+/**
+ Remove a history entry that is about to be freed from the trigram index.
+
+ @param HistoryEntry Pointer to the history entry to remove.
+ */
+VOID
+YoriShHistoryIndexRemoveEntry(
+    __in PYORI_SH_HISTORY_ENTRY HistoryEntry
+    )
+{
+    PYORI_SH_HISTORY_TRIGRAM Trigram;
+    PYORI_HASH_ENTRY HashEntry;
+    YORI_STRING Substring;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD EntryIndex;
+
+    if (YoriShHistoryTrigrams == NULL) {
+        return;
+    }
+
+    YoriLibInitEmptyString(&Substring);
+    Substring.LengthInChars = YORI_SH_HISTORY_TRIGRAM_LENGTH;
+
+    for (Index = 0; Index + YORI_SH_HISTORY_TRIGRAM_LENGTH <= HistoryEntry->CmdLine.LengthInChars; Index++) {
+        Substring.StartOfString = &HistoryEntry->CmdLine.StartOfString[Index];
+
+        HashEntry = YoriLibHashLookupByKey(YoriShHistoryTrigrams, &Substring);
+        if (HashEntry == NULL) {
+            continue;
+        }
+
+        Trigram = HashEntry->Context;
+        if (Trigram->Count == 0) {
+            continue;
+        }
+
+        //
+        //  Trimming history removes the oldest entry, which is the first
+        //  element.  Anything else requires a search.  If the trigram
+        //  occurs more than once in this entry, later occurrences will not
+        //  find it.
+        //
+
+        if (Trigram->Entries[Trigram->Start] == HistoryEntry) {
+            Trigram->Start++;
+            Trigram->Count--;
+        } else {
+            for (EntryIndex = Trigram->Start + 1; EntryIndex < Trigram->Start + Trigram->Count; EntryIndex++) {
+                if (Trigram->Entries[EntryIndex] == HistoryEntry) {
+                    memmove(&Trigram->Entries[EntryIndex], &Trigram->Entries[EntryIndex + 1], (Trigram->Start + Trigram->Count - EntryIndex - 1) * sizeof(PYORI_SH_HISTORY_ENTRY));
+                    Trigram->Count--;
+                    break;
+                }
+            }
+        }
+
+        if (Trigram->Count == 0) {
+            YoriLibRemoveListItem(&Trigram->ListEntry);
+            YoriLibHashRemoveByEntry(&Trigram->HashEntry);
+            if (Trigram->Entries != NULL) {
+                YoriLibFree(Trigram->Entries);
+            }
+            YoriLibFree(Trigram);
+        }
+    }
+}
+
+/**
+ Search history for the most recent entry containing a string, compared
+ case insensitively, which is older than a specified entry.  This is used
+ to implement incremental reverse search.
+
+ @param SearchString Pointer to the string to search for.
+
+ @param OlderThanSequence Only entries whose sequence number is less than
+        this value are returned.  Specify (DWORD)-1 to search all history.
+
+ @param StringOffsetOfMatch On successful completion, updated to contain the
+        offset within the entry's command of the match.
+
+ @return Pointer to the history entry, or NULL if no match is found.
+ */
+PYORI_SH_HISTORY_ENTRY
+YoriShFindHistoryEntryContaining(
+    __in PYORI_STRING SearchString,
+    __in DWORD OlderThanSequence,
+    __out PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    )
+{
+    PYORI_SH_HISTORY_TRIGRAM Trigram;
+    PYORI_SH_HISTORY_TRIGRAM Rarest;
+    PYORI_SH_HISTORY_ENTRY HistoryEntry;
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_LIST_ENTRY ListEntry;
+    YORI_STRING Substring;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD Low;
+    DWORD High;
+    DWORD Mid;
+
+    if (SearchString->LengthInChars == 0 ||
+        YoriShGlobal.CommandHistory.Next == NULL) {
+
+        return NULL;
+    }
+
+    //
+    //  If the string is too short to contain a trigram, or the index could
+    //  not be built, scan history from the most recent entry.  Short
+    //  strings tend to match something recent, so this is still quick.
+    //
+
+    if (SearchString->LengthInChars < YORI_SH_HISTORY_TRIGRAM_LENGTH ||
+        YoriShHistoryTrigrams == NULL) {
+
+        ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, NULL);
+        while (ListEntry != NULL) {
+            HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+            if (HistoryEntry->Sequence < OlderThanSequence &&
+                YoriLibFindFirstMatchSubstrIns(&HistoryEntry->CmdLine, 1, SearchString, StringOffsetOfMatch) != NULL) {
+
+                return HistoryEntry;
+            }
+            ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+        }
+        return NULL;
+    }
+
+    //
+    //  Any entry that matches must contain every trigram in the search
+    //  string, so only the entries for the least common trigram need to be
+    //  compared.  If any trigram is absent, nothing can match.
+    //
+
+    YoriLibInitEmptyString(&Substring);
+    Substring.LengthInChars = YORI_SH_HISTORY_TRIGRAM_LENGTH;
+    Rarest = NULL;
+
+    for (Index = 0; Index + YORI_SH_HISTORY_TRIGRAM_LENGTH <= SearchString->LengthInChars; Index++) {
+        Substring.StartOfString = &SearchString->StartOfString[Index];
+        HashEntry = YoriLibHashLookupByKey(YoriShHistoryTrigrams, &Substring);
+        if (HashEntry == NULL) {
+            return NULL;
+        }
+
+        Trigram = HashEntry->Context;
+        if (Rarest == NULL || Trigram->Count < Rarest->Count) {
+            Rarest = Trigram;
+        }
+    }
+
+    //
+    //  Entries are in sequence order, so find the first entry that is not
+    //  older than the requested sequence and walk backwards from there.
+    //
+
+    Low = Rarest->Start;
+    High = Rarest->Start + Rarest->Count;
+    while (Low < High) {
+        Mid = Low + (High - Low) / 2;
+        if (Rarest->Entries[Mid]->Sequence < OlderThanSequence) {
+            Low = Mid + 1;
+        } else {
+            High = Mid;
+        }
+    }
+
+    while (Low > Rarest->Start) {
+        Low--;
+        HistoryEntry = Rarest->Entries[Low];
+        if (YoriLibFindFirstMatchSubstrIns(&HistoryEntry->CmdLine, 1, SearchString, StringOffsetOfMatch) != NULL) {
+            return HistoryEntry;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ Remove the oldest entries from history until it contains no more than the
+ maximum number of entries.  The caller is expected to hold the history
+ lock.
+ */
+VOID
+YoriShTrimHistory(VOID)
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_HISTORY_ENTRY OldHistoryEntry;
+
+    while (YoriShCommandHistoryCount > YoriShCommandHistoryMax) {
+        ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
+        OldHistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+        YoriLibRemoveListItem(ListEntry);
+        YoriShHistoryIndexRemoveEntry(OldHistoryEntry);
+        YoriLibFreeStringContents(&OldHistoryEntry->CmdLine);
+        YoriLibFree(OldHistoryEntry);
+        YoriShCommandHistoryCount--;
+    }
+}
+
 /**
  Add an entered command into the command history buffer.
 
@@ -102,20 +555,13 @@ YoriShAddToHistory(
         }
 
         YoriLibCloneString(&NewHistoryEntry->CmdLine, NewCmd);
+        YoriShHistoryNextSequence++;
+        NewHistoryEntry->Sequence = YoriShHistoryNextSequence;
 
         YoriLibAppendList(&YoriShGlobal.CommandHistory, &NewHistoryEntry->ListEntry);
+        YoriShHistoryIndexAddEntry(NewHistoryEntry);
         YoriShCommandHistoryCount++;
-        while (YoriShCommandHistoryCount > YoriShCommandHistoryMax) {
-            PYORI_LIST_ENTRY ListEntry;
-            PYORI_SH_HISTORY_ENTRY OldHistoryEntry;
-
-            ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
-            OldHistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
-            YoriLibRemoveListItem(ListEntry);
-            YoriLibFreeStringContents(&OldHistoryEntry->CmdLine);
-            YoriLibFree(OldHistoryEntry);
-            YoriShCommandHistoryCount--;
-        }
+        YoriShTrimHistory();
         ReleaseMutex(YoriShHistoryLock);
     }
 
@@ -140,6 +586,7 @@ YoriShRemoveOneHistoryEntry(
 {
     if (WaitForSingleObject(YoriShHistoryLock, 0) == WAIT_OBJECT_0) {
         YoriLibRemoveListItem(&HistoryEntry->ListEntry);
+        YoriShHistoryIndexRemoveEntry(HistoryEntry);
         YoriLibFreeStringContents(&HistoryEntry->CmdLine);
         YoriLibFree(HistoryEntry);
         YoriShCommandHistoryCount--;
@@ -157,6 +604,15 @@ YoriShClearAllHistory(VOID)
     PYORI_SH_HISTORY_ENTRY HistoryEntry;
 
     if (WaitForSingleObject(YoriShHistoryLock, 0) == WAIT_OBJECT_0) {
+
+        //
+        //  Once history is empty, an index that previously failed can be
+        //  rebuilt as new entries arrive.
+        //
+
+        YoriShHistoryIndexFree();
+        YoriShHistoryIndexFailed = FALSE;
+
         ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
         while (ListEntry != NULL) {
             HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
@@ -235,36 +691,27 @@ YoriShInitHistory(VOID)
 }
 
 /**
- Load history from a file if the user has requested this behavior by
- setting YORIHISTFILE.  Configure the maximum amount of history to retain
- if the user has requested this behavior by setting YORIHISTSIZE.
+ Determine the full path to the history file if the user has requested
+ history to be saved by setting YORIHISTFILE.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @param FilePath On successful completion, updated to contain a newly
+        allocated string describing the full path to the history file.
+
+ @return TRUE to indicate a history file is configured and its path has been
+         returned, FALSE if no history file is configured or on failure.
  */
 __success(return)
 BOOL
-YoriShLoadHistoryFromFile(VOID)
+YoriShGetHistoryFileName(
+    __out PYORI_STRING FilePath
+    )
 {
     YORI_ALLOC_SIZE_T EnvVarLength;
     YORI_STRING UserHistFileName;
-    YORI_STRING FilePath;
-    HANDLE FileHandle;
-    PVOID LineContext = NULL;
-    YORI_STRING LineString;
-
-    if (YoriShHistoryInitialized) {
-        return TRUE;
-    }
-
-    YoriShInitHistory();
-
-    //
-    //  Check if there's a file to load saved history from.
-    //
 
     EnvVarLength = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTFILE"), NULL, 0, NULL);
     if (EnvVarLength == 0) {
-        return TRUE;
+        return FALSE;
     }
 
     if (!YoriLibAllocateString(&UserHistFileName, EnvVarLength)) {
@@ -278,12 +725,145 @@ YoriShLoadHistoryFromFile(VOID)
         return FALSE;
     }
 
-    if (!YoriLibUserStringToSingleFilePath(&UserHistFileName, TRUE, &FilePath)) {
+    if (!YoriLibUserStringToSingleFilePath(&UserHistFileName, TRUE, FilePath)) {
         YoriLibFreeStringContents(&UserHistFileName);
         return FALSE;
     }
 
     YoriLibFreeStringContents(&UserHistFileName);
+    return TRUE;
+}
+
+/**
+ Find the offset within the history file where the final lines in the file
+ begin.  This reads backwards from the end of the file so that the cost
+ depends on the number of lines requested rather than the size of the file.
+
+ @param FileHandle Handle to the history file.
+
+ @param LineCount The number of lines to find.
+
+ @param FileSize On successful completion, updated to contain the size of
+        the file, in bytes.
+
+ @param TailOffset On successful completion, updated to contain the offset
+        of the first of the final LineCount lines.  If the file contains
+        fewer lines, this is zero.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriShFindHistoryFileTail(
+    __in HANDLE FileHandle,
+    __in DWORD LineCount,
+    __out PDWORDLONG FileSize,
+    __out PDWORDLONG TailOffset
+    )
+{
+    LARGE_INTEGER Size;
+    LARGE_INTEGER Position;
+    PUCHAR Buffer;
+    DWORD ChunkLength;
+    DWORD BytesRead;
+    DWORD Index;
+    DWORD LinesFound;
+
+    Size.LowPart = GetFileSize(FileHandle, (LPDWORD)&Size.HighPart);
+    if (Size.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc(YORI_SH_HISTORY_FILE_CHUNK_SIZE);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    *FileSize = Size.QuadPart;
+    Position.QuadPart = Size.QuadPart;
+    LinesFound = 0;
+
+    while (Position.QuadPart > 0) {
+        ChunkLength = YORI_SH_HISTORY_FILE_CHUNK_SIZE;
+        if (Position.QuadPart < ChunkLength) {
+            ChunkLength = Position.LowPart;
+        }
+        Position.QuadPart = Position.QuadPart - ChunkLength;
+
+        if (SetFilePointer(FileHandle, Position.LowPart, &Position.HighPart, FILE_BEGIN) == (DWORD)-1 &&
+            GetLastError() != NO_ERROR) {
+
+            YoriLibFree(Buffer);
+            return FALSE;
+        }
+
+        if (!ReadFile(FileHandle, Buffer, ChunkLength, &BytesRead, NULL) ||
+            BytesRead != ChunkLength) {
+
+            YoriLibFree(Buffer);
+            return FALSE;
+        }
+
+        //
+        //  Each newline other than one terminating the file marks the
+        //  beginning of a line.
+        //
+
+        for (Index = ChunkLength; Index > 0; Index--) {
+            if (Buffer[Index - 1] == '\n' &&
+                (DWORDLONG)Position.QuadPart + Index < (DWORDLONG)Size.QuadPart) {
+
+                LinesFound++;
+                if (LinesFound == LineCount) {
+                    *TailOffset = Position.QuadPart + Index;
+                    YoriLibFree(Buffer);
+                    return TRUE;
+                }
+            }
+        }
+    }
+
+    YoriLibFree(Buffer);
+    *TailOffset = 0;
+    return TRUE;
+}
+
+/**
+ Load history from a file if the user has requested this behavior by
+ setting YORIHISTFILE.  Configure the maximum amount of history to retain
+ if the user has requested this behavior by setting YORIHISTSIZE.  Only the
+ most recent entries are loaded here; older entries are loaded by
+ @ref YoriShLoadDeferredHistory when history is first searched.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriShLoadHistoryFromFile(VOID)
+{
+    YORI_STRING FilePath;
+    HANDLE FileHandle;
+    PVOID LineContext = NULL;
+    YORI_STRING LineString;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    LARGE_INTEGER StartOffset;
+    DWORDLONG FileSize;
+    DWORDLONG TailOffset;
+    DWORD EagerCount;
+
+    if (YoriShHistoryInitialized) {
+        return TRUE;
+    }
+
+    YoriShInitHistory();
+
+    //
+    //  Check if there's a file to load saved history from.
+    //
+
+    if (!YoriShGetHistoryFileName(&FilePath)) {
+        return TRUE;
+    }
 
     FileHandle = CreateFile(FilePath.StartOfString,
                             GENERIC_READ,
@@ -306,6 +886,33 @@ YoriShLoadHistoryFromFile(VOID)
 
     YoriLibFreeStringContents(&FilePath);
 
+    //
+    //  Find where the most recent entries begin.  If more entries than that
+    //  would be retained, remember where the older ones are so they can be
+    //  loaded if needed.  If the file cannot be scanned, load all of it.
+    //
+
+    EagerCount = YORI_SH_HISTORY_EAGER_LOAD_COUNT;
+    if (EagerCount > YoriShCommandHistoryMax) {
+        EagerCount = YoriShCommandHistoryMax;
+    }
+
+    StartOffset.QuadPart = 0;
+    if (YoriShFindHistoryFileTail(FileHandle, EagerCount, &FileSize, &TailOffset)) {
+        StartOffset.QuadPart = TailOffset;
+        if (TailOffset > 0 &&
+            EagerCount < YoriShCommandHistoryMax &&
+            GetFileInformationByHandle(FileHandle, &FileInfo)) {
+
+            YoriShHistoryDeferredLength = TailOffset;
+            YoriShHistoryFileVolume = FileInfo.dwVolumeSerialNumber;
+            YoriShHistoryFileIndexHigh = FileInfo.nFileIndexHigh;
+            YoriShHistoryFileIndexLow = FileInfo.nFileIndexLow;
+        }
+    }
+
+    SetFilePointer(FileHandle, StartOffset.LowPart, &StartOffset.HighPart, FILE_BEGIN);
+
     YoriLibInitEmptyString(&LineString);
 
     while (TRUE) {
@@ -335,88 +942,326 @@ YoriShLoadHistoryFromFile(VOID)
 }
 
 /**
- Write the current command history buffer to a file, if the user has requested
- this behavior by configuring the YORIHISTFILE environment variable.
+ Load history entries from the history file that are older than the entries
+ loaded by @ref YoriShLoadHistoryFromFile .  This is performed when history
+ is first searched, so the cost of loading a large history file is not
+ incurred when starting the shell.  Entries already in history, including
+ commands entered since the shell started, are retained as the most recent
+ entries, although their sequence numbers change.
+ */
+VOID
+YoriShLoadDeferredHistory(VOID)
+{
+    YORI_STRING FilePath;
+    YORI_STRING Text;
+    YORI_STRING Line;
+    YORI_LIST_ENTRY RecentEntries;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_HISTORY_ENTRY HistoryEntry;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    HANDLE FileHandle;
+    LPSTR Buffer;
+    YORI_ALLOC_SIZE_T Length;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD BytesRead;
+
+    if (YoriShHistoryDeferredLength == 0) {
+        return;
+    }
+
+    if (!YoriLibIsSizeAllocatable(YoriShHistoryDeferredLength)) {
+        YoriShHistoryDeferredLength = 0;
+        return;
+    }
+
+    Length = (YORI_ALLOC_SIZE_T)YoriShHistoryDeferredLength;
+    YoriShHistoryDeferredLength = 0;
+
+    if (!YoriShGetHistoryFileName(&FilePath)) {
+        return;
+    }
+
+    FileHandle = CreateFile(FilePath.StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    YoriLibFreeStringContents(&FilePath);
+
+    if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    //
+    //  If another shell has compacted the file since it was loaded, the
+    //  offset no longer refers to the entries that were skipped.
+    //
+
+    if (!GetFileInformationByHandle(FileHandle, &FileInfo) ||
+        FileInfo.dwVolumeSerialNumber != YoriShHistoryFileVolume ||
+        FileInfo.nFileIndexHigh != YoriShHistoryFileIndexHigh ||
+        FileInfo.nFileIndexLow != YoriShHistoryFileIndexLow) {
+
+        CloseHandle(FileHandle);
+        return;
+    }
+
+    Buffer = YoriLibMalloc(Length);
+    if (Buffer == NULL) {
+        CloseHandle(FileHandle);
+        return;
+    }
+
+    if (!ReadFile(FileHandle, Buffer, Length, &BytesRead, NULL) ||
+        BytesRead != Length) {
+
+        YoriLibFree(Buffer);
+        CloseHandle(FileHandle);
+        return;
+    }
+
+    CloseHandle(FileHandle);
+
+    if (!YoriLibAllocateString(&Text, YoriLibGetMultibyteInputSizeNeeded(Buffer, Length) + 1)) {
+        YoriLibFree(Buffer);
+        return;
+    }
+
+    Text.LengthInChars = YoriLibGetMultibyteInputSizeNeeded(Buffer, Length);
+    YoriLibMultibyteInput(Buffer, Length, Text.StartOfString, Text.LengthInChars);
+    YoriLibFree(Buffer);
+
+    if (WaitForSingleObject(YoriShHistoryLock, 0) != WAIT_OBJECT_0) {
+        YoriLibFreeStringContents(&Text);
+        return;
+    }
+
+    //
+    //  Entries are indexed in the order they were added, so move the loaded
+    //  entries aside, add the older entries, and add the loaded entries
+    //  back.  Adding entries reacquires the lock, which succeeds since this
+    //  thread already owns it.
+    //
+
+    YoriLibInitializeListHead(&RecentEntries);
+    ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
+    while (ListEntry != NULL) {
+        YoriLibRemoveListItem(ListEntry);
+        YoriLibAppendList(&RecentEntries, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
+    }
+    YoriShCommandHistoryCount = 0;
+    YoriShHistoryIndexFree();
+    YoriShHistoryIndexFailed = FALSE;
+
+    YoriLibInitEmptyString(&Line);
+    Line.StartOfString = Text.StartOfString;
+    if (Text.LengthInChars > 0 && Text.StartOfString[0] == 0xFEFF) {
+        Line.StartOfString++;
+    }
+
+    for (Index = (YORI_ALLOC_SIZE_T)(Line.StartOfString - Text.StartOfString); Index < Text.LengthInChars; Index++) {
+        if (Text.StartOfString[Index] == '\n') {
+            Line.LengthInChars = (YORI_ALLOC_SIZE_T)(&Text.StartOfString[Index] - Line.StartOfString);
+            if (Line.LengthInChars > 0 && Line.StartOfString[Line.LengthInChars - 1] == '\r') {
+                Line.LengthInChars--;
+            }
+            YoriShAddToHistoryAndReallocate(&Line);
+            Line.StartOfString = &Text.StartOfString[Index + 1];
+        }
+    }
+
+    YoriLibFreeStringContents(&Text);
+
+    ListEntry = YoriLibGetNextListEntry(&RecentEntries, NULL);
+    while (ListEntry != NULL) {
+        HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+        YoriLibRemoveListItem(ListEntry);
+        YoriShHistoryNextSequence++;
+        HistoryEntry->Sequence = YoriShHistoryNextSequence;
+        YoriLibAppendList(&YoriShGlobal.CommandHistory, ListEntry);
+        YoriShHistoryIndexAddEntry(HistoryEntry);
+        YoriShCommandHistoryCount++;
+        YoriShTrimHistory();
+        ListEntry = YoriLibGetNextListEntry(&RecentEntries, NULL);
+    }
+
+    ReleaseMutex(YoriShHistoryLock);
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1700)
+#pragma warning(suppress: 26165) // Analyze thinks a lock might be leaked
+                                 // if WaitForSingleObject acquired it but
+                                 // returned a different result.  That can't
+                                 // happen.
+#endif
+}
+
+/**
+ Append a newly entered command to the history file, if the user has
+ requested this behavior by configuring the YORIHISTFILE environment
+ variable.  The file is opened for append for each command, so commands
+ from multiple concurrent shells are interleaved rather than overwritten.
+
+ @param NewCmd Pointer to the command to append.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 __success(return)
 BOOL
-YoriShSaveHistoryToFile(VOID)
+YoriShAppendToHistoryFile(
+    __in PYORI_STRING NewCmd
+    )
 {
-    YORI_ALLOC_SIZE_T FileNameLength;
-    YORI_STRING UserHistFileName;
     YORI_STRING FilePath;
     HANDLE FileHandle;
-    PYORI_LIST_ENTRY ListEntry;
-    PYORI_SH_HISTORY_ENTRY HistoryEntry;
 
-    FileNameLength = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTFILE"), NULL, 0, NULL);
-    if (FileNameLength == 0) {
+    if (!YoriShGetHistoryFileName(&FilePath)) {
         return TRUE;
     }
 
-    if (!YoriLibAllocateString(&UserHistFileName, FileNameLength)) {
+    FileHandle = CreateFile(FilePath.StartOfString,
+                            FILE_APPEND_DATA | SYNCHRONIZE,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    YoriLibFreeStringContents(&FilePath);
+
+    if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
         return FALSE;
     }
 
-    UserHistFileName.LengthInChars = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTFILE"), UserHistFileName.StartOfString, UserHistFileName.LengthAllocated, NULL);
+    YoriLibOutputToDevice(FileHandle, 0, _T("%y\n"), NewCmd);
+    CloseHandle(FileHandle);
+    return TRUE;
+}
 
-    if (UserHistFileName.LengthInChars == 0 || UserHistFileName.LengthInChars >= UserHistFileName.LengthAllocated) {
-        YoriLibFreeStringContents(&UserHistFileName);
+/**
+ Compact the history file, if the user has requested history to be saved by
+ configuring the YORIHISTFILE environment variable.  Since commands are
+ appended to the file as they are entered, the file grows without bound.
+ Once at least half of it consists of entries older than would be retained
+ in history, the retained entries are copied to a new file which replaces
+ the existing one.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriShCompactHistoryFile(VOID)
+{
+    YORI_STRING FilePath;
+    YORI_STRING TempPath;
+    HANDLE FileHandle;
+    HANDLE TempHandle;
+    LARGE_INTEGER StartOffset;
+    DWORDLONG FileSize;
+    DWORDLONG TailOffset;
+    PUCHAR Buffer;
+    DWORD BytesRead;
+    DWORD BytesWritten;
+    BOOL Success;
+
+    if (!YoriShGetHistoryFileName(&FilePath)) {
+        return TRUE;
+    }
+
+    FileHandle = CreateFile(FilePath.StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
+        YoriLibFreeStringContents(&FilePath);
         return FALSE;
     }
 
-    if (!YoriLibUserStringToSingleFilePath(&UserHistFileName, TRUE, &FilePath)) {
-        YoriLibFreeStringContents(&UserHistFileName);
+    if (!YoriShFindHistoryFileTail(FileHandle, YoriShCommandHistoryMax, &FileSize, &TailOffset) ||
+        TailOffset == 0 ||
+        TailOffset < FileSize - TailOffset) {
+
+        CloseHandle(FileHandle);
+        YoriLibFreeStringContents(&FilePath);
+        return TRUE;
+    }
+
+    if (!YoriLibAllocateString(&TempPath, FilePath.LengthInChars + 32)) {
+        CloseHandle(FileHandle);
+        YoriLibFreeStringContents(&FilePath);
         return FALSE;
     }
 
-    YoriLibFreeStringContents(&UserHistFileName);
+    TempPath.LengthInChars = YoriLibSPrintf(TempPath.StartOfString, _T("%y.%x.tmp"), &FilePath, GetCurrentProcessId());
 
-    FileHandle = CreateFile(FilePath.StartOfString,
+    TempHandle = CreateFile(TempPath.StartOfString,
                             GENERIC_WRITE,
-                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            0,
                             NULL,
                             CREATE_ALWAYS,
                             FILE_ATTRIBUTE_NORMAL,
                             NULL);
 
-    if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yori: open of %y failed: %s"), &FilePath, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
+    Buffer = NULL;
+    if (TempHandle != INVALID_HANDLE_VALUE) {
+        Buffer = YoriLibMalloc(YORI_SH_HISTORY_FILE_CHUNK_SIZE);
+    }
+
+    if (Buffer == NULL) {
+        if (TempHandle != INVALID_HANDLE_VALUE) {
+            CloseHandle(TempHandle);
+            DeleteFile(TempPath.StartOfString);
+        }
+        CloseHandle(FileHandle);
+        YoriLibFreeStringContents(&TempPath);
         YoriLibFreeStringContents(&FilePath);
         return FALSE;
     }
 
-    YoriLibFreeStringContents(&FilePath);
-
-    //
-    //  Search the list of history.
-    //
+    Success = TRUE;
+    StartOffset.QuadPart = TailOffset;
+    SetFilePointer(FileHandle, StartOffset.LowPart, &StartOffset.HighPart, FILE_BEGIN);
+    while (TRUE) {
+        if (!ReadFile(FileHandle, Buffer, YORI_SH_HISTORY_FILE_CHUNK_SIZE, &BytesRead, NULL)) {
+            Success = FALSE;
+            break;
+        }
 
-    if (WaitForSingleObject(YoriShHistoryLock, 0) == WAIT_OBJECT_0) {
-        ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
-        while (ListEntry != NULL) {
-            HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+        if (BytesRead == 0) {
+            break;
+        }
 
-            YoriLibOutputToDevice(FileHandle, 0, _T("%y\n"), &HistoryEntry->CmdLine);
+        if (!WriteFile(TempHandle, Buffer, BytesRead, &BytesWritten, NULL) ||
+            BytesWritten != BytesRead) {
 
-            ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+            Success = FALSE;
+            break;
         }
-        ReleaseMutex(YoriShHistoryLock);
     }
 
+    YoriLibFree(Buffer);
+    CloseHandle(TempHandle);
     CloseHandle(FileHandle);
-#if defined(_MSC_VER) && (_MSC_VER >= 1700)
-#pragma warning(suppress: 26165) // Analyze thinks a lock might be leaked
-                                 // if WaitForSingleObject acquired it but
-                                 // returned a different result.  That can't
-                                 // happen.
-#endif
-    return TRUE;
+
+    if (Success) {
+        Success = MoveFileEx(TempPath.StartOfString, FilePath.StartOfString, MOVEFILE_REPLACE_EXISTING);
+    }
+
+    if (!Success) {
+        DeleteFile(TempPath.StartOfString);
+    }
+
+    YoriLibFreeStringContents(&TempPath);
+    YoriLibFreeStringContents(&FilePath);
+
+    return Success;
 }
 
 /**
@@ -0,0 +1,769 @@
+/**
+ * @file sh/initsnap.c
+ *
+ * Yori shell snapshot of state established by init scripts
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yori.h"
+
+/**
+ The signature at the beginning of a snapshot file, 'YSNP'.
+ */
+#define YORI_SH_INIT_SNAPSHOT_SIGNATURE 0x504E5359
+
+/**
+ The version of the snapshot format.  This is included in the key, so a
+ snapshot written in a different format is never applied.
+ */
+#define YORI_SH_INIT_SNAPSHOT_VERSION 1
+
+/**
+ The number of bytes to read from an init script at a time when hashing it.
+ */
+#define YORI_SH_INIT_SNAPSHOT_READ_SIZE (16 * 1024)
+
+/**
+ A record indicating an environment variable should be set.
+ */
+#define YORI_SH_INIT_SNAPSHOT_SET_VARIABLE    1
+
+/**
+ A record indicating an environment variable should be deleted.
+ */
+#define YORI_SH_INIT_SNAPSHOT_DELETE_VARIABLE 2
+
+/**
+ A record indicating an alias should be set.
+ */
+#define YORI_SH_INIT_SNAPSHOT_SET_ALIAS       3
+
+/**
+ A record indicating an alias should be deleted.
+ */
+#define YORI_SH_INIT_SNAPSHOT_DELETE_ALIAS    4
+
+/**
+ The header of a snapshot file.
+ */
+typedef struct _YORI_SH_INIT_SNAPSHOT_HEADER {
+
+    /**
+     Set to @ref YORI_SH_INIT_SNAPSHOT_SIGNATURE .
+     */
+    DWORD Signature;
+
+    /**
+     The number of records following the header.
+     */
+    DWORD RecordCount;
+
+    /**
+     A hash of the init scripts and the state that existed before they
+     executed.  The snapshot is only applied if this matches.
+     */
+    DWORDLONG Key;
+} YORI_SH_INIT_SNAPSHOT_HEADER, *PYORI_SH_INIT_SNAPSHOT_HEADER;
+
+/**
+ A single change made by init scripts.  This is followed by the NULL
+ terminated name and the NULL terminated value.
+ */
+typedef struct _YORI_SH_INIT_SNAPSHOT_RECORD {
+
+    /**
+     The type of the change, for example
+     @ref YORI_SH_INIT_SNAPSHOT_SET_VARIABLE .
+     */
+    DWORD Type;
+
+    /**
+     The length of the name, in characters, not including the NULL.
+     */
+    DWORD NameLength;
+
+    /**
+     The length of the value, in characters, not including the NULL.
+     */
+    DWORD ValueLength;
+} YORI_SH_INIT_SNAPSHOT_RECORD, *PYORI_SH_INIT_SNAPSHOT_RECORD;
+
+/**
+ Determine the full path to the snapshot file if the user has requested
+ init script state to be cached by setting YORIINITCACHE.
+
+ @param FilePath On successful completion, updated to contain a newly
+        allocated string describing the full path to the snapshot file.
+
+ @return TRUE to indicate a snapshot file is configured and its path has
+         been returned, FALSE if none is configured or on failure.
+ */
+__success(return)
+BOOL
+YoriShGetInitSnapshotFileName(
+    __out PYORI_STRING FilePath
+    )
+{
+    YORI_ALLOC_SIZE_T EnvVarLength;
+    YORI_STRING UserFileName;
+
+    EnvVarLength = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIINITCACHE"), NULL, 0, NULL);
+    if (EnvVarLength == 0) {
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(&UserFileName, EnvVarLength)) {
+        return FALSE;
+    }
+
+    UserFileName.LengthInChars = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIINITCACHE"), UserFileName.StartOfString, UserFileName.LengthAllocated, NULL);
+
+    if (UserFileName.LengthInChars == 0 || UserFileName.LengthInChars >= UserFileName.LengthAllocated) {
+        YoriLibFreeStringContents(&UserFileName);
+        return FALSE;
+    }
+
+    if (!YoriLibUserStringToSingleFilePath(&UserFileName, TRUE, FilePath)) {
+        YoriLibFreeStringContents(&UserFileName);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&UserFileName);
+    return TRUE;
+}
+
+/**
+ A callback function for every init script, which adds the name, timestamp,
+ size and contents of the script to the snapshot key.
+
+ @param Filename Pointer to the fully qualified file name of the script.
+
+ @param FileInfo Pointer to information about the file.
+
+ @param Depth The recursion depth.  Ignored in this function.
+
+ @param Context Pointer to the hash state of the key.
+
+ @return TRUE to continue enumerating, FALSE to terminate.
+ */
+BOOL
+YoriShInitSnapshotHashScript(
+    __in PYORI_STRING Filename,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PYORI_LIB_XXHASH64_STATE State;
+    HANDLE FileHandle;
+    PUCHAR Buffer;
+    DWORD BytesRead;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    State = (PYORI_LIB_XXHASH64_STATE)Context;
+
+    YoriLibXxHash64Update(State, Filename->StartOfString, Filename->LengthInChars * sizeof(TCHAR));
+    YoriLibXxHash64Update(State, &FileInfo->ftLastWriteTime, sizeof(FileInfo->ftLastWriteTime));
+    YoriLibXxHash64Update(State, &FileInfo->nFileSizeHigh, sizeof(FileInfo->nFileSizeHigh));
+    YoriLibXxHash64Update(State, &FileInfo->nFileSizeLow, sizeof(FileInfo->nFileSizeLow));
+
+    //
+    //  Timestamps can be preserved by tools that modify files, so include
+    //  the contents.  If the file can't be read, include something that
+    //  won't match a readable file.
+    //
+
+    FileHandle = CreateFile(Filename->StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        YoriLibXxHash64Update(State, &FileHandle, sizeof(FileHandle));
+        return TRUE;
+    }
+
+    Buffer = YoriLibMalloc(YORI_SH_INIT_SNAPSHOT_READ_SIZE);
+    if (Buffer == NULL) {
+        YoriLibXxHash64Update(State, &FileHandle, sizeof(FileHandle));
+        CloseHandle(FileHandle);
+        return TRUE;
+    }
+
+    while (ReadFile(FileHandle, Buffer, YORI_SH_INIT_SNAPSHOT_READ_SIZE, &BytesRead, NULL) &&
+           BytesRead > 0) {
+
+        YoriLibXxHash64Update(State, Buffer, BytesRead);
+    }
+
+    YoriLibFree(Buffer);
+    CloseHandle(FileHandle);
+    return TRUE;
+}
+
+/**
+ Add a NULL terminated block of name=value strings to the snapshot key.
+ Entries beginning with '=' describe per drive current directories, which
+ differ between launches and are not changed by the snapshot, so they are
+ not included.
+
+ @param State Pointer to the hash state of the key.
+
+ @param Block Pointer to the block of strings.
+ */
+VOID
+YoriShInitSnapshotHashBlock(
+    __inout PYORI_LIB_XXHASH64_STATE State,
+    __in PYORI_STRING Block
+    )
+{
+    LPTSTR ThisPair;
+    YORI_ALLOC_SIZE_T Length;
+
+    ThisPair = Block->StartOfString;
+    while (*ThisPair != '\0') {
+        Length = (YORI_ALLOC_SIZE_T)_tcslen(ThisPair);
+        if (ThisPair[0] != '=') {
+            YoriLibXxHash64Update(State, ThisPair, (Length + 1) * sizeof(TCHAR));
+        }
+        ThisPair += Length + 1;
+    }
+}
+
+/**
+ Calculate the key for a snapshot of the state established by init scripts.
+ This combines the state before the scripts are executed with the names,
+ timestamps, sizes and contents of every script that would be executed.
+
+ @param IgnoreUserScripts TRUE if only system scripts are executed.
+
+ @param Env Pointer to the environment block before the scripts execute.
+
+ @param Aliases Pointer to the user aliases before the scripts execute.
+
+ @return The key.
+ */
+DWORDLONG
+YoriShInitSnapshotCalculateKey(
+    __in BOOLEAN IgnoreUserScripts,
+    __in PYORI_STRING Env,
+    __in PYORI_STRING Aliases
+    )
+{
+    YORI_LIB_XXHASH64_STATE State;
+    DWORD Value;
+
+    YoriLibXxHash64Initialize(&State, 0);
+
+    Value = YORI_SH_INIT_SNAPSHOT_VERSION;
+    YoriLibXxHash64Update(&State, &Value, sizeof(Value));
+    Value = (YORI_VER_MAJOR << 16) | YORI_VER_MINOR;
+    YoriLibXxHash64Update(&State, &Value, sizeof(Value));
+    Value = IgnoreUserScripts;
+    YoriLibXxHash64Update(&State, &Value, sizeof(Value));
+
+    YoriShInitSnapshotHashBlock(&State, Env);
+    Value = 0;
+    YoriLibXxHash64Update(&State, &Value, sizeof(Value));
+    YoriShInitSnapshotHashBlock(&State, Aliases);
+
+    YoriShForEachInitScript(IgnoreUserScripts, YoriShInitSnapshotHashScript, &State);
+
+    return YoriLibXxHash64Finalize(&State);
+}
+
+/**
+ Find an entry within a NULL terminated block of name=value strings.
+
+ @param Block Pointer to the block of strings.
+
+ @param Name Pointer to the name to find.  This is compared case
+        insensitively.
+
+ @return Pointer to the value of the entry, or NULL if the name is not found.
+ */
+LPTSTR
+YoriShInitSnapshotFindInBlock(
+    __in PYORI_STRING Block,
+    __in PYORI_STRING Name
+    )
+{
+    YORI_STRING ThisName;
+    LPTSTR ThisPair;
+    LPTSTR Equals;
+    YORI_ALLOC_SIZE_T Length;
+
+    ThisPair = Block->StartOfString;
+    while (*ThisPair != '\0') {
+        Length = (YORI_ALLOC_SIZE_T)_tcslen(ThisPair);
+        if (ThisPair[0] != '=') {
+            YoriLibInitEmptyString(&ThisName);
+            ThisName.StartOfString = ThisPair;
+            ThisName.LengthInChars = Length;
+            Equals = YoriLibFindLeftMostCharacter(&ThisName, '=');
+            if (Equals != NULL) {
+                ThisName.LengthInChars = (YORI_ALLOC_SIZE_T)(Equals - ThisPair);
+                if (YoriLibCompareStringIns(&ThisName, Name) == 0) {
+                    return Equals + 1;
+                }
+            }
+        }
+        ThisPair += Length + 1;
+    }
+
+    return NULL;
+}
+
+/**
+ Write a single record to a snapshot buffer, or calculate its size.
+
+ @param Buffer Pointer to the snapshot buffer, or NULL to only calculate the
+        size of the record.
+
+ @param Offset The offset within the buffer to write the record.
+
+ @param Type The type of the record.
+
+ @param Name Pointer to the name.
+
+ @param Value Pointer to the value.  This may be empty.
+
+ @return The offset within the buffer following the record.
+ */
+DWORD
+YoriShInitSnapshotWriteRecord(
+    __out_opt PUCHAR Buffer,
+    __in DWORD Offset,
+    __in DWORD Type,
+    __in PYORI_STRING Name,
+    __in PYORI_STRING Value
+    )
+{
+    PYORI_SH_INIT_SNAPSHOT_RECORD Record;
+    LPTSTR Chars;
+
+    if (Buffer != NULL) {
+        Record = (PYORI_SH_INIT_SNAPSHOT_RECORD)&Buffer[Offset];
+        Record->Type = Type;
+        Record->NameLength = Name->LengthInChars;
+        Record->ValueLength = Value->LengthInChars;
+        Chars = (LPTSTR)(Record + 1);
+        memcpy(Chars, Name->StartOfString, Name->LengthInChars * sizeof(TCHAR));
+        Chars[Name->LengthInChars] = '\0';
+        Chars = Chars + Name->LengthInChars + 1;
+        memcpy(Chars, Value->StartOfString, Value->LengthInChars * sizeof(TCHAR));
+        Chars[Value->LengthInChars] = '\0';
+    }
+
+    return Offset + sizeof(YORI_SH_INIT_SNAPSHOT_RECORD) + (Name->LengthInChars + Value->LengthInChars + 2) * sizeof(TCHAR);
+}
+
+/**
+ Compare the state of a NULL terminated block of name=value strings before
+ and after init scripts execute, and write records describing each change
+ to a snapshot buffer, or calculate their size.
+
+ @param Before Pointer to the block before init scripts executed.
+
+ @param After Pointer to the block after init scripts executed.
+
+ @param SetType The type of record to write for an entry that was added or
+        changed.
+
+ @param DeleteType The type of record to write for an entry that was
+        removed.
+
+ @param Buffer Pointer to the snapshot buffer, or NULL to only calculate the
+        size of the records.
+
+ @param Offset The offset within the buffer to write the first record.
+
+ @param RecordCount On input, the number of records written so far.  On
+        output, updated to include the records written by this call.
+
+ @return The offset within the buffer following the records.
+ */
+DWORD
+YoriShInitSnapshotWriteChanges(
+    __in PYORI_STRING Before,
+    __in PYORI_STRING After,
+    __in DWORD SetType,
+    __in DWORD DeleteType,
+    __out_opt PUCHAR Buffer,
+    __in DWORD Offset,
+    __inout PDWORD RecordCount
+    )
+{
+    YORI_STRING Name;
+    YORI_STRING Value;
+    LPTSTR ThisPair;
+    LPTSTR Equals;
+    LPTSTR OldValue;
+    YORI_ALLOC_SIZE_T Length;
+
+    ThisPair = After->StartOfString;
+    while (*ThisPair != '\0') {
+        Length = (YORI_ALLOC_SIZE_T)_tcslen(ThisPair);
+        YoriLibInitEmptyString(&Name);
+        Name.StartOfString = ThisPair;
+        Name.LengthInChars = Length;
+        Equals = YoriLibFindLeftMostCharacter(&Name, '=');
+        if (ThisPair[0] != '=' && Equals != NULL) {
+            Name.LengthInChars = (YORI_ALLOC_SIZE_T)(Equals - ThisPair);
+            YoriLibConstantString(&Value, Equals + 1);
+            OldValue = YoriShInitSnapshotFindInBlock(Before, &Name);
+            if (OldValue == NULL || YoriLibCompareStringLit(&Value, OldValue) != 0) {
+                Offset = YoriShInitSnapshotWriteRecord(Buffer, Offset, SetType, &Name, &Value);
+                (*RecordCount)++;
+            }
+        }
+        ThisPair += Length + 1;
+    }
+
+    YoriLibInitEmptyString(&Value);
+    ThisPair = Before->StartOfString;
+    while (*ThisPair != '\0') {
+        Length = (YORI_ALLOC_SIZE_T)_tcslen(ThisPair);
+        YoriLibInitEmptyString(&Name);
+        Name.StartOfString = ThisPair;
+        Name.LengthInChars = Length;
+        Equals = YoriLibFindLeftMostCharacter(&Name, '=');
+        if (ThisPair[0] != '=' && Equals != NULL) {
+            Name.LengthInChars = (YORI_ALLOC_SIZE_T)(Equals - ThisPair);
+            if (YoriShInitSnapshotFindInBlock(After, &Name) == NULL) {
+                Offset = YoriShInitSnapshotWriteRecord(Buffer, Offset, DeleteType, &Name, &Value);
+                (*RecordCount)++;
+            }
+        }
+        ThisPair += Length + 1;
+    }
+
+    return Offset;
+}
+
+/**
+ Apply a previously saved snapshot of the state established by init
+ scripts, if one exists and its key matches.
+
+ @param FileName Pointer to the name of the snapshot file.
+
+ @param Key The key describing the current init scripts and state.
+
+ @return TRUE to indicate the snapshot was applied and init scripts do not
+         need to be executed, FALSE if they should be executed.
+ */
+__success(return)
+BOOLEAN
+YoriShApplyInitSnapshot(
+    __in PYORI_STRING FileName,
+    __in DWORDLONG Key
+    )
+{
+    PYORI_SH_INIT_SNAPSHOT_HEADER Header;
+    PYORI_SH_INIT_SNAPSHOT_RECORD Record;
+    YORI_STRING Name;
+    YORI_STRING Value;
+    HANDLE FileHandle;
+    PUCHAR Buffer;
+    DWORD FileSize;
+    DWORD FileSizeHigh;
+    DWORD BytesRead;
+    DWORD Offset;
+    DWORD RecordLength;
+    DWORD Index;
+
+    FileHandle = CreateFile(FileName->StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    FileSize = GetFileSize(FileHandle, &FileSizeHigh);
+    if (FileSizeHigh != 0 ||
+        FileSize < sizeof(YORI_SH_INIT_SNAPSHOT_HEADER) ||
+        !YoriLibIsSizeAllocatable(FileSize)) {
+
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)FileSize);
+    if (Buffer == NULL) {
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    if (!ReadFile(FileHandle, Buffer, FileSize, &BytesRead, NULL) ||
+        BytesRead != FileSize) {
+
+        YoriLibFree(Buffer);
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    CloseHandle(FileHandle);
+
+    Header = (PYORI_SH_INIT_SNAPSHOT_HEADER)Buffer;
+    if (Header->Signature != YORI_SH_INIT_SNAPSHOT_SIGNATURE ||
+        Header->Key != Key) {
+
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    //
+    //  Validate every record before applying any, so a truncated file
+    //  results in executing scripts rather than partial state.
+    //
+
+    Offset = sizeof(YORI_SH_INIT_SNAPSHOT_HEADER);
+    for (Index = 0; Index < Header->RecordCount; Index++) {
+        if (FileSize - Offset < sizeof(YORI_SH_INIT_SNAPSHOT_RECORD)) {
+            YoriLibFree(Buffer);
+            return FALSE;
+        }
+
+        Record = (PYORI_SH_INIT_SNAPSHOT_RECORD)&Buffer[Offset];
+        if (Record->NameLength > FileSize || Record->ValueLength > FileSize) {
+            YoriLibFree(Buffer);
+            return FALSE;
+        }
+
+        RecordLength = sizeof(YORI_SH_INIT_SNAPSHOT_RECORD) + (Record->NameLength + Record->ValueLength + 2) * sizeof(TCHAR);
+        if (FileSize - Offset < RecordLength) {
+            YoriLibFree(Buffer);
+            return FALSE;
+        }
+        Offset = Offset + RecordLength;
+    }
+
+    Offset = sizeof(YORI_SH_INIT_SNAPSHOT_HEADER);
+    for (Index = 0; Index < Header->RecordCount; Index++) {
+        Record = (PYORI_SH_INIT_SNAPSHOT_RECORD)&Buffer[Offset];
+
+        YoriLibInitEmptyString(&Name);
+        Name.StartOfString = (LPTSTR)(Record + 1);
+        Name.LengthInChars = (YORI_ALLOC_SIZE_T)Record->NameLength;
+        YoriLibInitEmptyString(&Value);
+        Value.StartOfString = Name.StartOfString + Name.LengthInChars + 1;
+        Value.LengthInChars = (YORI_ALLOC_SIZE_T)Record->ValueLength;
+
+        switch(Record->Type) {
+            case YORI_SH_INIT_SNAPSHOT_SET_VARIABLE:
+                SetEnvironmentVariable(Name.StartOfString, Value.StartOfString);
+                break;
+            case YORI_SH_INIT_SNAPSHOT_DELETE_VARIABLE:
+                SetEnvironmentVariable(Name.StartOfString, NULL);
+                break;
+            case YORI_SH_INIT_SNAPSHOT_SET_ALIAS:
+                YoriShAddAlias(&Name, &Value, FALSE);
+                break;
+            case YORI_SH_INIT_SNAPSHOT_DELETE_ALIAS:
+                YoriShDeleteAlias(&Name);
+                break;
+        }
+
+        Offset = Offset + sizeof(YORI_SH_INIT_SNAPSHOT_RECORD) + (Record->NameLength + Record->ValueLength + 2) * sizeof(TCHAR);
+    }
+
+    YoriLibFree(Buffer);
+    return TRUE;
+}
+
+/**
+ Save a snapshot of the changes made by init scripts, so that a later
+ instance with the same key can apply them without executing the scripts.
+ The snapshot is written to a temporary file and renamed into place, so a
+ concurrently starting shell never observes a partial snapshot.
+
+ @param FileName Pointer to the name of the snapshot file.
+
+ @param Key The key describing the init scripts and the state before they
+        executed.
+
+ @param EnvBefore Pointer to the environment block before the scripts
+        executed.
+
+ @param AliasesBefore Pointer to the user aliases before the scripts
+        executed.
+ */
+VOID
+YoriShSaveInitSnapshot(
+    __in PYORI_STRING FileName,
+    __in DWORDLONG Key,
+    __in PYORI_STRING EnvBefore,
+    __in PYORI_STRING AliasesBefore
+    )
+{
+    PYORI_SH_INIT_SNAPSHOT_HEADER Header;
+    YORI_STRING EnvAfter;
+    YORI_STRING AliasesAfter;
+    YORI_STRING TempName;
+    HANDLE FileHandle;
+    PUCHAR Buffer;
+    DWORD Offset;
+    DWORD RecordCount;
+    DWORD BytesWritten;
+    BOOL Success;
+
+    if (!YoriLibGetEnvironmentStrings(&EnvAfter)) {
+        return;
+    }
+
+    YoriLibInitEmptyString(&AliasesAfter);
+    if (!YoriShGetAliasStrings(YORI_SH_GET_ALIAS_STRINGS_INCLUDE_USER, &AliasesAfter)) {
+        YoriLibFreeStringContents(&EnvAfter);
+        return;
+    }
+
+    RecordCount = 0;
+    Offset = sizeof(YORI_SH_INIT_SNAPSHOT_HEADER);
+    Offset = YoriShInitSnapshotWriteChanges(EnvBefore, &EnvAfter, YORI_SH_INIT_SNAPSHOT_SET_VARIABLE, YORI_SH_INIT_SNAPSHOT_DELETE_VARIABLE, NULL, Offset, &RecordCount);
+    Offset = YoriShInitSnapshotWriteChanges(AliasesBefore, &AliasesAfter, YORI_SH_INIT_SNAPSHOT_SET_ALIAS, YORI_SH_INIT_SNAPSHOT_DELETE_ALIAS, NULL, Offset, &RecordCount);
+
+    Buffer = NULL;
+    if (YoriLibIsSizeAllocatable(Offset)) {
+        Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)Offset);
+    }
+
+    if (Buffer == NULL) {
+        YoriLibFreeStringContents(&AliasesAfter);
+        YoriLibFreeStringContents(&EnvAfter);
+        return;
+    }
+
+    Header = (PYORI_SH_INIT_SNAPSHOT_HEADER)Buffer;
+    Header->Signature = YORI_SH_INIT_SNAPSHOT_SIGNATURE;
+    Header->RecordCount = RecordCount;
+    Header->Key = Key;
+
+    RecordCount = 0;
+    Offset = sizeof(YORI_SH_INIT_SNAPSHOT_HEADER);
+    Offset = YoriShInitSnapshotWriteChanges(EnvBefore, &EnvAfter, YORI_SH_INIT_SNAPSHOT_SET_VARIABLE, YORI_SH_INIT_SNAPSHOT_DELETE_VARIABLE, Buffer, Offset, &RecordCount);
+    Offset = YoriShInitSnapshotWriteChanges(AliasesBefore, &AliasesAfter, YORI_SH_INIT_SNAPSHOT_SET_ALIAS, YORI_SH_INIT_SNAPSHOT_DELETE_ALIAS, Buffer, Offset, &RecordCount);
+
+    YoriLibFreeStringContents(&AliasesAfter);
+    YoriLibFreeStringContents(&EnvAfter);
+
+    if (!YoriLibAllocateString(&TempName, FileName->LengthInChars + 32)) {
+        YoriLibFree(Buffer);
+        return;
+    }
+
+    TempName.LengthInChars = YoriLibSPrintf(TempName.StartOfString, _T("%y.%x.tmp"), FileName, GetCurrentProcessId());
+
+    FileHandle = CreateFile(TempName.StartOfString,
+                            GENERIC_WRITE,
+                            0,
+                            NULL,
+                            CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        YoriLibFreeStringContents(&TempName);
+        YoriLibFree(Buffer);
+        return;
+    }
+
+    Success = WriteFile(FileHandle, Buffer, Offset, &BytesWritten, NULL);
+    if (BytesWritten != Offset) {
+        Success = FALSE;
+    }
+    CloseHandle(FileHandle);
+    YoriLibFree(Buffer);
+
+    if (Success) {
+        Success = MoveFileEx(TempName.StartOfString, FileName->StartOfString, MOVEFILE_REPLACE_EXISTING);
+    }
+
+    if (!Success) {
+        DeleteFile(TempName.StartOfString);
+    }
+
+    YoriLibFreeStringContents(&TempName);
+}
+
+/**
+ Execute any system or user init scripts, applying a snapshot of their
+ results instead if the user has requested this by setting YORIINITCACHE and
+ neither the scripts nor the state they start from have changed since the
+ snapshot was saved.
+
+ @param IgnoreUserScripts If TRUE, system scripts are executed but user
+        scripts are not.
+
+ @return TRUE to indicate a snapshot was applied or the scripts were
+         executed, FALSE if no snapshot is configured or it could not be
+         used and the caller should execute the scripts.
+ */
+__success(return)
+BOOL
+YoriShExecuteInitScriptsWithSnapshot(
+    __in BOOLEAN IgnoreUserScripts
+    )
+{
+    YORI_STRING FileName;
+    YORI_STRING EnvBefore;
+    YORI_STRING AliasesBefore;
+    DWORDLONG Key;
+
+    if (!YoriShGetInitSnapshotFileName(&FileName)) {
+        return FALSE;
+    }
+
+    if (!YoriLibGetEnvironmentStrings(&EnvBefore)) {
+        YoriLibFreeStringContents(&FileName);
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&AliasesBefore);
+    if (!YoriShGetAliasStrings(YORI_SH_GET_ALIAS_STRINGS_INCLUDE_USER, &AliasesBefore)) {
+        YoriLibFreeStringContents(&EnvBefore);
+        YoriLibFreeStringContents(&FileName);
+        return FALSE;
+    }
+
+    Key = YoriShInitSnapshotCalculateKey(IgnoreUserScripts, &EnvBefore, &AliasesBefore);
+
+    if (!YoriShApplyInitSnapshot(&FileName, Key)) {
+        YoriShForEachInitScript(IgnoreUserScripts, YoriShExecuteYoriInit, NULL);
+        YoriShSaveInitSnapshot(&FileName, Key, &EnvBefore, &AliasesBefore);
+    }
+
+    YoriLibFreeStringContents(&AliasesBefore);
+    YoriLibFreeStringContents(&EnvBefore);
+    YoriLibFreeStringContents(&FileName);
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -3,7 +3,7 @@
  *
  * Yori shell command entry from a console
  *
- * Copyright (c) 2017-2019 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -322,6 +322,74 @@ YoriShPostKeyPress(
     }
 }
 
+/**
+ Determine whether a cell already displays the specified character, drawn
+ either as part of the buffer or as part of the suggestion.
+
+ @param Buffer Pointer to the input buffer.
+
+ @param Offset The offset of the cell from the beginning of the buffer.
+
+ @param Char The character that should be displayed in the cell.
+
+ @param Suggestion TRUE if the cell should be drawn as part of the
+        suggestion, FALSE if it should be drawn as part of the buffer.
+
+ @return TRUE to indicate the cell is already correct, FALSE if it needs to
+         be drawn.
+ */
+BOOLEAN
+YoriShIsCellDisplayed(
+    __in PYORI_SH_INPUT_BUFFER Buffer,
+    __in YORI_ALLOC_SIZE_T Offset,
+    __in TCHAR Char,
+    __in BOOLEAN Suggestion
+    )
+{
+    if (Offset >= Buffer->DisplayedCells.LengthInChars) {
+        return FALSE;
+    }
+
+    if (Buffer->DisplayedCells.StartOfString[Offset] != Char) {
+        return FALSE;
+    }
+
+    if ((Offset >= Buffer->DisplayedSuggestionOffset) != Suggestion) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Record the characters currently drawn for the buffer and suggestion so
+ that a later redraw can skip cells that are unchanged.  If memory cannot
+ be allocated, nothing is recorded and later redraws draw every dirty cell.
+
+ @param Buffer Pointer to the input buffer.
+ */
+VOID
+YoriShRecordDisplayedCells(
+    __inout PYORI_SH_INPUT_BUFFER Buffer
+    )
+{
+    YORI_ALLOC_SIZE_T CellCount;
+
+    CellCount = Buffer->String.LengthInChars + Buffer->SuggestionString.LengthInChars;
+    if (CellCount >= Buffer->DisplayedCells.LengthAllocated) {
+        YoriLibFreeStringContents(&Buffer->DisplayedCells);
+        if (!YoriLibAllocateString(&Buffer->DisplayedCells, CellCount * 2 + 1)) {
+            YoriLibInitEmptyString(&Buffer->DisplayedCells);
+            return;
+        }
+    }
+
+    memcpy(Buffer->DisplayedCells.StartOfString, Buffer->String.StartOfString, Buffer->String.LengthInChars * sizeof(TCHAR));
+    memcpy(&Buffer->DisplayedCells.StartOfString[Buffer->String.LengthInChars], Buffer->SuggestionString.StartOfString, Buffer->SuggestionString.LengthInChars * sizeof(TCHAR));
+    Buffer->DisplayedCells.LengthInChars = CellCount;
+    Buffer->DisplayedSuggestionOffset = Buffer->String.LengthInChars;
+}
+
 /**
  After a key has been pressed and processed, display the resulting buffer.
 
@@ -343,6 +411,9 @@ YoriShDisplayAfterKeyPress(
     COORD SuggestionPosition;
     CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
     HANDLE hConsole;
+    YORI_ALLOC_SIZE_T DirtyEnd;
+    YORI_ALLOC_SIZE_T SuggestionSkip;
+    YORI_ALLOC_SIZE_T SuggestionToWrite;
 
     //
     //  We don't want to have a selection and mouseover active at once, since
@@ -399,6 +470,52 @@ YoriShDisplayAfterKeyPress(
             return FALSE;
         }
 
+        //
+        //  Remove cells from either end of the dirty range that already
+        //  display the correct character, so only the span that changed is
+        //  written.  Edits such as recalling history or completing a word
+        //  mark large ranges dirty where much of the text is unchanged.
+        //
+
+        if (Buffer->DirtyLength > 0 && Buffer->DirtyBeginOffset < Buffer->String.LengthInChars) {
+            DirtyEnd = Buffer->DirtyBeginOffset + Buffer->DirtyLength;
+            if (DirtyEnd > Buffer->String.LengthInChars) {
+                DirtyEnd = Buffer->String.LengthInChars;
+            }
+
+            while (Buffer->DirtyBeginOffset < DirtyEnd &&
+                   YoriShIsCellDisplayed(Buffer, Buffer->DirtyBeginOffset, Buffer->String.StartOfString[Buffer->DirtyBeginOffset], FALSE)) {
+
+                Buffer->DirtyBeginOffset++;
+            }
+
+            while (DirtyEnd > Buffer->DirtyBeginOffset &&
+                   YoriShIsCellDisplayed(Buffer, DirtyEnd - 1, Buffer->String.StartOfString[DirtyEnd - 1], FALSE)) {
+
+                DirtyEnd--;
+            }
+
+            Buffer->DirtyLength = DirtyEnd - Buffer->DirtyBeginOffset;
+        }
+
+        SuggestionSkip = 0;
+        SuggestionToWrite = 0;
+        if (Buffer->SuggestionDirty) {
+            SuggestionToWrite = Buffer->SuggestionString.LengthInChars;
+            while (SuggestionToWrite > 0 &&
+                   YoriShIsCellDisplayed(Buffer, Buffer->String.LengthInChars + SuggestionSkip, Buffer->SuggestionString.StartOfString[SuggestionSkip], TRUE)) {
+
+                SuggestionSkip++;
+                SuggestionToWrite--;
+            }
+
+            while (SuggestionToWrite > 0 &&
+                   YoriShIsCellDisplayed(Buffer, Buffer->String.LengthInChars + SuggestionSkip + SuggestionToWrite - 1, Buffer->SuggestionString.StartOfString[SuggestionSkip + SuggestionToWrite - 1], TRUE)) {
+
+                SuggestionToWrite--;
+            }
+        }
+
         //
         //  Calculate the number of characters truncated from the currently
         //  displayed buffer.  If the text is being updated, it needs to be
@@ -434,7 +551,8 @@ YoriShDisplayAfterKeyPress(
             if (!YoriShDetermineCellLocationIfMovedCacheResult(Buffer,
                                                                &ScreenInfo,
                                                                -1 * Buffer->PreviousCurrentOffset +
-                                                                 Buffer->String.LengthInChars,
+                                                                 Buffer->String.LengthInChars +
+                                                                 SuggestionSkip,
                                                                &SuggestionPosition)) {
                 return FALSE;
             }
@@ -508,11 +626,11 @@ YoriShDisplayAfterKeyPress(
             FillConsoleOutputAttribute(hConsole, ScreenInfo.wAttributes, NumberToWrite, WritePosition, &NumberWritten);
         }
 
-        if (Buffer->SuggestionDirty) {
-            WriteConsoleOutputCharacter(hConsole, Buffer->SuggestionString.StartOfString, Buffer->SuggestionString.LengthInChars, SuggestionPosition, &NumberWritten);
+        if (SuggestionToWrite > 0) {
+            WriteConsoleOutputCharacter(hConsole, &Buffer->SuggestionString.StartOfString[SuggestionSkip], SuggestionToWrite, SuggestionPosition, &NumberWritten);
             FillConsoleOutputAttribute(hConsole,
                                        (USHORT)((ScreenInfo.wAttributes & 0xF0) | FOREGROUND_INTENSITY),
-                                       Buffer->SuggestionString.LengthInChars,
+                                       SuggestionToWrite,
                                        SuggestionPosition,
                                        &NumberWritten);
         }
@@ -542,6 +660,7 @@ YoriShDisplayAfterKeyPress(
 
         Buffer->PreviousCurrentOffset = Buffer->CurrentOffset;
         Buffer->PreviousCharsDisplayed = Buffer->String.LengthInChars + Buffer->SuggestionString.LengthInChars;
+        YoriShRecordDisplayedCells(Buffer);
         Buffer->DirtyBeginOffset = 0;
         Buffer->DirtyLength = 0;
         Buffer->SuggestionDirty = FALSE;
@@ -721,7 +840,7 @@ YoriShAppCloseCtrlHandler(
         CtrlType == CTRL_LOGOFF_EVENT ||
         CtrlType == CTRL_SHUTDOWN_EVENT) {
 
-        YoriShSaveHistoryToFile();
+        YoriShCompactHistoryFile();
         return FALSE;
     }
 
@@ -751,8 +870,10 @@ YoriShTerminateInput(
     Buffer->SuggestionPopulated = FALSE;
     YoriLibFreeStringContents(&Buffer->SuggestionString);
     YoriLibFreeStringContents(&Buffer->SearchString);
+    YoriLibFreeStringContents(&Buffer->PreSearchString);
     SetConsoleCtrlHandler(YoriShAppCloseCtrlHandler, FALSE);
     YoriShDisplayAfterKeyPress(Buffer);
+    YoriLibFreeStringContents(&Buffer->DisplayedCells);
     YoriShPostKeyPress(Buffer);
     YoriShClearTabCompletionMatches(Buffer);
     YoriLibCleanupSelection(&Buffer->Selection);
@@ -826,12 +947,73 @@ YoriShClearInput(
     Buffer->String.LengthInChars = 0;
     Buffer->CurrentOffset = 0;
     Buffer->SearchMode = FALSE;
+    Buffer->HistorySearchMode = FALSE;
+    Buffer->HistorySearchSequence = 0;
+    YoriLibFreeStringContents(&Buffer->PreSearchString);
     YoriShClearInputSelections(Buffer);
 }
 
+/**
+ Based on the history search text entered so far, find the most recent
+ matching history entry and replace the input buffer with it, placing the
+ cursor after the matching text.  If no match is found, the previous match
+ remains displayed.
+
+ @param Buffer Pointer to the input buffer to update.
+
+ @param FindOlder If TRUE, find a match older than the one currently
+        displayed.  If FALSE, the currently displayed match is retained if
+        it still matches.
+ */
+VOID
+YoriShUpdateInputWithHistorySearchResult(
+    __inout PYORI_SH_INPUT_BUFFER Buffer,
+    __in BOOLEAN FindOlder
+    )
+{
+    PYORI_SH_HISTORY_ENTRY HistoryEntry;
+    YORI_ALLOC_SIZE_T StringOffsetOfMatch;
+    DWORD OlderThanSequence;
+
+    if (Buffer->SearchString.LengthInChars == 0) {
+        if (YoriShReplaceInputBufferTrackDirtyRange(Buffer, &Buffer->PreSearchString)) {
+            Buffer->CurrentOffset = Buffer->PreSearchOffset;
+        }
+        Buffer->HistorySearchSequence = 0;
+        return;
+    }
+
+    if (Buffer->HistorySearchSequence == 0) {
+        OlderThanSequence = (DWORD)-1;
+    } else if (FindOlder) {
+        OlderThanSequence = Buffer->HistorySearchSequence;
+    } else {
+        OlderThanSequence = Buffer->HistorySearchSequence + 1;
+    }
+
+    HistoryEntry = YoriShFindHistoryEntryContaining(&Buffer->SearchString, OlderThanSequence, &StringOffsetOfMatch);
+    if (HistoryEntry == NULL) {
+        return;
+    }
+
+    if (!YoriShReplaceInputBufferTrackDirtyRange(Buffer, &HistoryEntry->CmdLine)) {
+        return;
+    }
+
+    YoriLibFreeStringContents(&Buffer->SuggestionString);
+    Buffer->SuggestionPopulated = FALSE;
+    Buffer->SuggestionDirty = TRUE;
+    YoriShClearTabCompletionMatches(Buffer);
+
+    Buffer->CurrentOffset = StringOffsetOfMatch + Buffer->SearchString.LengthInChars;
+    Buffer->HistorySearchSequence = HistoryEntry->Sequence;
+    Buffer->HistoryEntryToUse = &HistoryEntry->ListEntry;
+}
+
 /**
  Based on the search text entered so far, find the first match within the
- main string and set the current offset to it.
+ main string and set the current offset to it.  When searching history, the
+ input buffer is replaced with the matching history entry instead.
 
  @param Buffer Pointer to the input buffer to update.
  */
@@ -842,6 +1024,11 @@ YoriShUpdateSelectionWithSearchResult(
 {
     YORI_ALLOC_SIZE_T StringOffsetOfMatch;
 
+    if (Buffer->HistorySearchMode) {
+        YoriShUpdateInputWithHistorySearchResult(Buffer, FALSE);
+        return;
+    }
+
     //
     //  MSFIX Would like to do something with selection for this, but that
     //  implies having a selection that follows text around lines rather
@@ -855,6 +1042,65 @@ YoriShUpdateSelectionWithSearchResult(
     }
 }
 
+/**
+ Begin searching history.  Subsequent keystrokes are added to the search
+ string, and the input buffer displays the most recent history entry that
+ contains it.
+
+ @param Buffer Pointer to the input buffer to update.
+ */
+VOID
+YoriShStartHistorySearch(
+    __inout PYORI_SH_INPUT_BUFFER Buffer
+    )
+{
+    YoriShLoadDeferredHistory();
+
+    YoriLibFreeStringContents(&Buffer->PreSearchString);
+    if (!YoriLibAllocateString(&Buffer->PreSearchString, Buffer->String.LengthInChars + 1)) {
+        return;
+    }
+
+    memcpy(Buffer->PreSearchString.StartOfString, Buffer->String.StartOfString, Buffer->String.LengthInChars * sizeof(TCHAR));
+    Buffer->PreSearchString.LengthInChars = Buffer->String.LengthInChars;
+
+    YoriLibFreeStringContents(&Buffer->SearchString);
+    Buffer->SearchMode = TRUE;
+    Buffer->HistorySearchMode = TRUE;
+    Buffer->HistorySearchSequence = 0;
+    Buffer->PreSearchOffset = Buffer->CurrentOffset;
+}
+
+/**
+ Leave search mode, either retaining the result of the search or returning
+ the input buffer to its state before the search started.
+
+ @param Buffer Pointer to the input buffer to update.
+
+ @param Cancel If TRUE, the cursor is returned to where it was before the
+        search, and if searching history, the input string is restored.
+ */
+VOID
+YoriShEndSearch(
+    __inout PYORI_SH_INPUT_BUFFER Buffer,
+    __in BOOLEAN Cancel
+    )
+{
+    if (Cancel) {
+        if (Buffer->HistorySearchMode) {
+            YoriShReplaceInputBufferTrackDirtyRange(Buffer, &Buffer->PreSearchString);
+            Buffer->HistoryEntryToUse = NULL;
+        }
+        Buffer->CurrentOffset = Buffer->PreSearchOffset;
+    }
+
+    Buffer->SearchMode = FALSE;
+    Buffer->HistorySearchMode = FALSE;
+    Buffer->HistorySearchSequence = 0;
+    YoriLibFreeStringContents(&Buffer->SearchString);
+    YoriLibFreeStringContents(&Buffer->PreSearchString);
+}
+
 
 /**
  Display all of the tab completion matches.  Note this routine needs to
@@ -997,6 +1243,13 @@ YoriShBackspace(
 
         Buffer->SearchString.LengthInChars = Buffer->SearchString.LengthInChars - CountToUse;
 
+        //
+        //  A shorter history search string may match a more recent entry
+        //  than the current one, so search again from the newest.
+        //
+
+        Buffer->HistorySearchSequence = 0;
+
         YoriShUpdateSelectionWithSearchResult(Buffer);
         return;
     }
@@ -1859,10 +2112,83 @@ YoriShClearScreen(
     YoriShDisplayPrompt();
     YoriShPreCommand(TRUE);
 
+    Buffer->DisplayedCells.LengthInChars = 0;
     Buffer->PreviousCurrentOffset = 0;
     YoriShExtendDirtyRangeToCover(Buffer, 0, Buffer->String.LengthInChars);
 }
 
+/**
+ Redraw the prompt in place, followed by the current input buffer.  This is
+ used when an asynchronous part of the prompt has been updated, or a
+ background job has completed, while the user is entering input.  If the
+ beginning of the prompt is no longer in the console buffer, nothing is
+ redrawn.
+
+ @param Buffer Pointer to the input buffer.
+
+ @param ReportJobs If TRUE, report any completed background jobs where the
+        prompt was, and display the prompt and input below them.
+ */
+VOID
+YoriShRedrawPromptAndInput(
+    __in PYORI_SH_INPUT_BUFFER Buffer,
+    __in BOOLEAN ReportJobs
+    )
+{
+    HANDLE ConsoleHandle;
+    CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
+    DWORD CharsWritten;
+    DWORD CursorPosition;
+    DWORD PromptPosition;
+    DWORD PromptCells;
+    COORD PromptStart;
+
+    //
+    //  Remove any selection and complete any pending display so the
+    //  cursor position reflects the displayed buffer.
+    //
+
+    if (YoriShClearInputSelections(Buffer)) {
+        YoriShDisplayAfterKeyPress(Buffer);
+    }
+
+    ConsoleHandle = Buffer->ConsoleOutputHandle;
+    if (!GetConsoleScreenBufferInfo(ConsoleHandle, &ScreenInfo)) {
+        return;
+    }
+
+    PromptCells = YoriShGetPromptCellCount();
+    CursorPosition = (DWORD)ScreenInfo.dwCursorPosition.Y * ScreenInfo.dwSize.X + ScreenInfo.dwCursorPosition.X;
+    if (PromptCells == 0 ||
+        CursorPosition < Buffer->PreviousCurrentOffset + PromptCells) {
+
+        return;
+    }
+
+    PromptPosition = CursorPosition - Buffer->PreviousCurrentOffset - PromptCells;
+    PromptStart.X = (SHORT)(PromptPosition % ScreenInfo.dwSize.X);
+    PromptStart.Y = (SHORT)(PromptPosition / ScreenInfo.dwSize.X);
+
+    FillConsoleOutputCharacter(ConsoleHandle, ' ', PromptCells + Buffer->PreviousCharsDisplayed, PromptStart, &CharsWritten);
+    FillConsoleOutputAttribute(ConsoleHandle, ScreenInfo.wAttributes, PromptCells + Buffer->PreviousCharsDisplayed, PromptStart, &CharsWritten);
+    SetConsoleCursorPosition(ConsoleHandle, PromptStart);
+
+    if (ReportJobs) {
+        YoriShReportCompletedJobs(TRUE);
+    }
+
+    YoriShPreCommand(FALSE);
+    YoriShRedisplayPrompt();
+    YoriShPreCommand(TRUE);
+
+    Buffer->DisplayedCells.LengthInChars = 0;
+    Buffer->PreviousCurrentOffset = 0;
+    Buffer->PreviousCharsDisplayed = 0;
+    Buffer->SuggestionDirty = TRUE;
+    YoriShExtendDirtyRangeToCover(Buffer, 0, Buffer->String.LengthInChars);
+    YoriShDisplayAfterKeyPress(Buffer);
+}
+
 /**
  Create a new selection, and if one already exists, extend it to the specified
  buffer offset.
@@ -2088,8 +2414,7 @@ YoriShProcessEnhancedKeyDown(
         }
     } else if (KeyCode == VK_RETURN) {
         if (Buffer->SearchMode) {
-            Buffer->SearchMode = FALSE;
-            YoriLibFreeStringContents(&Buffer->SearchString);
+            YoriShEndSearch(Buffer, FALSE);
         } else {
             if (!YoriLibCopySelectionIfPresent(&Buffer->Selection)) {
                 *TerminateInput = TRUE;
@@ -2317,8 +2642,7 @@ YoriShProcessKeyDown(
 
         if (Char == '\r') {
             if (Buffer->SearchMode) {
-                Buffer->SearchMode = FALSE;
-                YoriLibFreeStringContents(&Buffer->SearchString);
+                YoriShEndSearch(Buffer, FALSE);
             } else {
                 if (!YoriLibCopySelectionIfPresent(&Buffer->Selection)) {
                     *TerminateInput = TRUE;
@@ -2328,9 +2652,7 @@ YoriShProcessKeyDown(
             }
         } else if (Char == 27) {
             if (Buffer->SearchMode) {
-                Buffer->SearchMode = FALSE;
-                Buffer->CurrentOffset = Buffer->PreSearchOffset;
-                YoriLibFreeStringContents(&Buffer->SearchString);
+                YoriShEndSearch(Buffer, TRUE);
             } else {
                 YoriShClearInput(Buffer);
                 Buffer->HistoryEntryToUse = NULL;
@@ -2429,6 +2751,15 @@ YoriShProcessKeyDown(
             ClearSelection = TRUE;
         } else if (KeyCode == 'L') {
             YoriShClearScreen(Buffer);
+        } else if (KeyCode == 'R') {
+            if (Buffer->HistorySearchMode) {
+                YoriShUpdateInputWithHistorySearchResult(Buffer, TRUE);
+            } else {
+                if (Buffer->SearchMode) {
+                    YoriShEndSearch(Buffer, FALSE);
+                }
+                YoriShStartHistorySearch(Buffer);
+            }
         } else if (KeyCode == 'V') {
             YORI_STRING ClipboardData;
             YoriLibInitEmptyString(&ClipboardData);
@@ -2442,14 +2773,15 @@ YoriShProcessKeyDown(
             YoriShAddYoriStringToInput(Buffer, &YoriShGlobal.YankBuffer);
         } else if (KeyCode == 0xDB) { // Aka VK_OEM_4, { or [ on US keyboards
             if (Buffer->SearchMode) {
-                Buffer->SearchMode = FALSE;
-                Buffer->CurrentOffset = Buffer->PreSearchOffset;
-                YoriLibFreeStringContents(&Buffer->SearchString);
+                YoriShEndSearch(Buffer, TRUE);
             } else {
                 YoriShClearInput(Buffer);
                 Buffer->HistoryEntryToUse = NULL;
             }
         } else if (KeyCode == 0xBF) { // Aka VK_OEM_2, / or ? on US keyboards
+            if (Buffer->HistorySearchMode) {
+                YoriShEndSearch(Buffer, FALSE);
+            }
             Buffer->SearchMode = TRUE;
             Buffer->PreSearchOffset = Buffer->CurrentOffset;
         } else if (KeyCode == VK_TAB) {
@@ -3051,6 +3383,114 @@ YoriShProcessMouseScroll(
     return FALSE;
 }
 
+/**
+ Calculate a suggestion for the current input on the input thread, and
+ display it if one is found.
+
+ @param Buffer Pointer to the input buffer.
+ */
+VOID
+YoriShCompleteSuggestionOnInputThread(
+    __inout PYORI_SH_INPUT_BUFFER Buffer
+    )
+{
+    ASSERT(!Buffer->SuggestionPopulated);
+    ASSERT(Buffer->SuggestionString.LengthInChars == 0);
+    YoriShConfigureConsoleForTabComplete(Buffer);
+    YoriShCompleteSuggestion(Buffer);
+    YoriShConfigureConsoleForInput(Buffer);
+    Buffer->SuggestionPopulated = TRUE;
+    if (Buffer->SuggestionString.LengthInChars > 0) {
+        Buffer->SuggestionDirty = TRUE;
+        YoriShDisplayAfterKeyPress(Buffer);
+    }
+}
+
+/**
+ Wait for console input to arrive.  If an asynchronous part of the prompt
+ completes evaluation, or a background job completes, while waiting, the
+ prompt is redrawn and waiting resumes.
+
+ @param Buffer Pointer to the input buffer.
+
+ @param InputHandle The handle to the console input.
+
+ @param Timeout The maximum time to wait, in milliseconds.
+
+ @return The result of the wait, which is WAIT_OBJECT_0 if input has
+         arrived or WAIT_TIMEOUT if the timeout elapsed or a suggestion
+         being calculated in the background has completed.
+ */
+DWORD
+YoriShWaitForInputOrPromptUpdate(
+    __in PYORI_SH_INPUT_BUFFER Buffer,
+    __in HANDLE InputHandle,
+    __in DWORD Timeout
+    )
+{
+    HANDLE WaitHandles[3];
+    DWORD HandleCount;
+    DWORD PromptIndex;
+    DWORD JobIndex;
+    DWORD SuggestionIndex;
+    DWORD Result;
+    BOOLEAN ForegroundRequired;
+
+    while (TRUE) {
+        WaitHandles[0] = InputHandle;
+        HandleCount = 1;
+        PromptIndex = 0;
+        JobIndex = 0;
+        SuggestionIndex = 0;
+
+        //
+        //  While a suggestion is being calculated in the background, only
+        //  wait for it or for input.  Redrawing the prompt and reporting
+        //  jobs use shell state that the background thread may be reading,
+        //  so these wait until the suggestion is complete.
+        //
+
+        WaitHandles[HandleCount] = YoriShGetBackgroundSuggestionWaitHandle(Buffer);
+        if (WaitHandles[HandleCount] != NULL) {
+            SuggestionIndex = HandleCount;
+            HandleCount++;
+        } else {
+            WaitHandles[HandleCount] = YoriShGetAsyncPromptWaitHandle();
+            if (WaitHandles[HandleCount] != NULL) {
+                PromptIndex = HandleCount;
+                HandleCount++;
+            }
+
+            WaitHandles[HandleCount] = YoriShGetJobCompletionWaitHandle();
+            if (WaitHandles[HandleCount] != NULL) {
+                JobIndex = HandleCount;
+                HandleCount++;
+            }
+        }
+
+        Result = WaitForMultipleObjects(HandleCount, WaitHandles, FALSE, Timeout);
+        if (SuggestionIndex != 0 && Result == WAIT_OBJECT_0 + SuggestionIndex) {
+            if (YoriShCollectBackgroundSuggestion(Buffer, &ForegroundRequired)) {
+                if (ForegroundRequired) {
+                    YoriShCompleteSuggestionOnInputThread(Buffer);
+                } else if (Buffer->SuggestionDirty) {
+                    YoriShDisplayAfterKeyPress(Buffer);
+                }
+            }
+            return WAIT_TIMEOUT;
+        } else if (PromptIndex != 0 && Result == WAIT_OBJECT_0 + PromptIndex) {
+            if (YoriShCollectAsyncPromptResult()) {
+                YoriShRedrawPromptAndInput(Buffer, FALSE);
+            }
+        } else if (JobIndex != 0 && Result == WAIT_OBJECT_0 + JobIndex) {
+            if (YoriShIsJobCompletionUnreported()) {
+                YoriShRedrawPromptAndInput(Buffer, TRUE);
+            }
+        } else {
+            return Result;
+        }
+    }
+}
 
 /**
  Get a new expression from the user through the console.
@@ -3114,6 +3554,13 @@ YoriShGetExpressionFromConsole(
 
     while (TRUE) {
 
+        //
+        //  Any suggestion still being calculated is for input that is about
+        //  to change, so stop it before processing the input.
+        //
+
+        YoriShCancelBackgroundSuggestion(&Buffer);
+
         if (!PeekConsoleInput(InputHandle, InputRecords, sizeof(InputRecords)/sizeof(InputRecords[0]), &ActuallyRead)) {
             break;
         }
@@ -3165,6 +3612,12 @@ YoriShGetExpressionFromConsole(
 
                     ReDisplayRequired |= YoriShClearInputSelections(&Buffer);
 
+                    //
+                    //  The console may have rewrapped the displayed text, so
+                    //  don't assume any cell is still correct.
+                    //
+
+                    Buffer.DisplayedCells.LengthInChars = 0;
                     Buffer.ConsoleBufferDimensions.X = InputRecord->Event.WindowBufferSizeEvent.dwSize.X;
                     Buffer.ConsoleBufferDimensions.Y = InputRecord->Event.WindowBufferSizeEvent.dwSize.Y;
                 }
@@ -3183,7 +3636,9 @@ YoriShGetExpressionFromConsole(
                 YoriShTerminateInput(&Buffer);
                 ReadConsoleInput(InputHandle, InputRecords, CurrentRecordIndex + 1, &ActuallyRead);
                 if (Buffer.String.LengthInChars > 0) {
-                    YoriShAddToHistory(&Buffer.String, TRUE);
+                    if (YoriShAddToHistory(&Buffer.String, TRUE)) {
+                        YoriShAppendToHistoryFile(&Buffer.String);
+                    }
                 }
                 memcpy(Expression, &Buffer.String, sizeof(YORI_STRING));
                 return TRUE;
@@ -3222,7 +3677,7 @@ YoriShGetExpressionFromConsole(
         while (TRUE) {
             if (YoriLibIsPeriodicScrollActive(&Buffer.Selection)) {
 
-                err = WaitForSingleObject(InputHandle, 100);
+                err = YoriShWaitForInputOrPromptUpdate(&Buffer, InputHandle, 100);
                 if (err == WAIT_OBJECT_0) {
                     break;
                 }
@@ -3230,24 +3685,32 @@ YoriShGetExpressionFromConsole(
                     YoriLibPeriodicScrollForSelection(&Buffer.Selection);
                 }
             } else if (!Buffer.SuggestionPopulated) {
-                err = WaitForSingleObject(InputHandle, YoriShGlobal.DelayBeforeSuggesting);
+
+                //
+                //  Once the user has paused for long enough, calculate a
+                //  suggestion in the background.  Keep waiting for input
+                //  while that happens, so that a key press can be processed
+                //  immediately.
+                //
+
+                if (Buffer.BackgroundSuggestion != NULL) {
+                    err = YoriShWaitForInputOrPromptUpdate(&Buffer, InputHandle, INFINITE);
+                } else {
+                    err = YoriShWaitForInputOrPromptUpdate(&Buffer, InputHandle, YoriShGlobal.DelayBeforeSuggesting);
+                }
                 if (err == WAIT_OBJECT_0) {
                     break;
                 }
-                if (err == WAIT_TIMEOUT) {
-                    ASSERT(!Buffer.SuggestionPopulated);
-                    ASSERT(Buffer.SuggestionString.LengthInChars == 0);
-                    YoriShConfigureConsoleForTabComplete(&Buffer);
-                    YoriShCompleteSuggestion(&Buffer);
-                    YoriShConfigureConsoleForInput(&Buffer);
-                    Buffer.SuggestionPopulated = TRUE;
-                    if (Buffer.SuggestionString.LengthInChars > 0) {
-                        Buffer.SuggestionDirty = TRUE;
-                        YoriShDisplayAfterKeyPress(&Buffer);
+                if (err == WAIT_TIMEOUT &&
+                    !Buffer.SuggestionPopulated &&
+                    Buffer.BackgroundSuggestion == NULL) {
+
+                    if (!YoriShStartBackgroundSuggestion(&Buffer)) {
+                        YoriShCompleteSuggestionOnInputThread(&Buffer);
                     }
                 }
             } else if (!RestartStateSaved) {
-                err = WaitForSingleObject(InputHandle, 30 * 1000);
+                err = YoriShWaitForInputOrPromptUpdate(&Buffer, InputHandle, 30 * 1000);
                 if (err == WAIT_OBJECT_0) {
                     break;
                 }
@@ -3257,7 +3720,7 @@ YoriShGetExpressionFromConsole(
                     RestartStateSaved = TRUE;
                 }
             } else {
-                err = WaitForSingleObject(InputHandle, INFINITE);
+                err = YoriShWaitForInputOrPromptUpdate(&Buffer, InputHandle, INFINITE);
                 if (err == WAIT_OBJECT_0) {
                     break;
                 }
@@ -3277,6 +3740,7 @@ YoriShGetExpressionFromConsole(
 
     YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Error reading from console %i handle %08x\n"), err, InputHandle);
 
+    YoriShCancelBackgroundSuggestion(&Buffer);
     YoriShTerminateInput(&Buffer);
     YoriLibFreeStringContents(&Buffer.String);
     return FALSE;
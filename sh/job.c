@@ -3,7 +3,7 @@
  *
  * Facilities for managing background jobs
  *
- * Copyright (c) 2017 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -78,6 +78,13 @@ typedef struct _YORI_JOB {
      */
     HANDLE hProcess;
 
+    /**
+     A handle to a job object containing the child process, which reports
+     process exit to the job listener.  This is NULL if the job is not being
+     tracked by the listener, in which case completion is only noticed when
+     the prompt is next displayed.
+     */
+    HANDLE hJobObject;
 
     /**
      The full command line that was used to execute the child process.
@@ -95,6 +102,257 @@ typedef struct _YORI_JOB {
  */
 YORI_LIST_ENTRY JobList;
 
+/**
+ State for a thread which listens for background job processes exiting, so
+ the shell can report completion while waiting for input.
+ */
+typedef struct _YORI_SH_JOB_LISTENER {
+
+    /**
+     A completion port which job objects for background jobs report to.
+     */
+    HANDLE Port;
+
+    /**
+     A handle to the listener thread.
+     */
+    HANDLE Thread;
+
+    /**
+     An auto reset event signalled by the listener thread when a process
+     within a background job has exited.
+     */
+    HANDLE Event;
+} YORI_SH_JOB_LISTENER;
+
+/**
+ The global job listener.
+ */
+YORI_SH_JOB_LISTENER YoriShJobListener;
+
+/**
+ A thread which waits for notifications from job objects and signals the
+ listener event when a process has exited.  The thread exits when a
+ notification with a completion key of zero is posted.
+
+ @param Context Ignored.
+
+ @return Thread exit code, which is always zero.
+ */
+DWORD WINAPI
+YoriShJobListenerThread(
+    __in LPVOID Context
+    )
+{
+    DWORD CompletionCode;
+    ULONG_PTR CompletionKey;
+    LPOVERLAPPED Overlapped;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    while (DllKernel32.pGetQueuedCompletionStatus(YoriShJobListener.Port, &CompletionCode, &CompletionKey, &Overlapped, INFINITE)) {
+        if (CompletionKey == 0) {
+            break;
+        }
+
+        if (CompletionCode == JOB_OBJECT_MSG_EXIT_PROCESS ||
+            CompletionCode == JOB_OBJECT_MSG_ABNORMAL_EXIT_PROCESS) {
+
+            SetEvent(YoriShJobListener.Event);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ Stop the job listener thread if it is running.
+ */
+VOID
+YoriShStopJobListener(VOID)
+{
+    if (YoriShJobListener.Thread != NULL) {
+        DllKernel32.pPostQueuedCompletionStatus(YoriShJobListener.Port, 0, 0, NULL);
+        WaitForSingleObject(YoriShJobListener.Thread, INFINITE);
+        CloseHandle(YoriShJobListener.Thread);
+        YoriShJobListener.Thread = NULL;
+    }
+
+    if (YoriShJobListener.Port != NULL) {
+        CloseHandle(YoriShJobListener.Port);
+        YoriShJobListener.Port = NULL;
+    }
+
+    if (YoriShJobListener.Event != NULL) {
+        CloseHandle(YoriShJobListener.Event);
+        YoriShJobListener.Event = NULL;
+    }
+}
+
+/**
+ Start the job listener thread if it is not already running.
+
+ @return TRUE to indicate the listener is running, FALSE if it could not be
+         started.
+ */
+__success(return)
+BOOLEAN
+YoriShStartJobListener(VOID)
+{
+    DWORD ThreadId;
+
+    if (YoriShJobListener.Thread != NULL) {
+        return TRUE;
+    }
+
+    if (DllKernel32.pCreateIoCompletionPort == NULL ||
+        DllKernel32.pGetQueuedCompletionStatus == NULL ||
+        DllKernel32.pPostQueuedCompletionStatus == NULL) {
+
+        return FALSE;
+    }
+
+    YoriShJobListener.Port = DllKernel32.pCreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    YoriShJobListener.Event = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (YoriShJobListener.Port == NULL ||
+        YoriShJobListener.Event == NULL) {
+
+        YoriShStopJobListener();
+        return FALSE;
+    }
+
+    YoriShJobListener.Thread = CreateThread(NULL, 0, YoriShJobListenerThread, NULL, 0, &ThreadId);
+    if (YoriShJobListener.Thread == NULL) {
+        YoriShStopJobListener();
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Place the process for a job into a job object which reports to the job
+ listener, so that its completion can be reported while the shell is
+ waiting for input.  If this is not possible, the job is still reported
+ when the prompt is next displayed.
+
+ @param ThisJob Pointer to the job.
+ */
+VOID
+YoriShTrackJobCompletion(
+    __in PYORI_JOB ThisJob
+    )
+{
+    DWORD OsVerMajor;
+    DWORD OsVerMinor;
+    DWORD OsBuildNumber;
+
+    //
+    //  Prior to Windows 8 a process can only be in one job, so placing a
+    //  background job in a job object would prevent it from using job
+    //  objects itself.
+    //
+
+    YoriLibGetOsVersion(&OsVerMajor, &OsVerMinor, &OsBuildNumber);
+    if (OsVerMajor < 6 || (OsVerMajor == 6 && OsVerMinor < 2)) {
+        return;
+    }
+
+    if (!YoriShStartJobListener()) {
+        return;
+    }
+
+    ThisJob->hJobObject = YoriLibCreateJobObject();
+    if (ThisJob->hJobObject == NULL) {
+        return;
+    }
+
+    if (!YoriLibAssociateJobObjectWithCompletionPort(ThisJob->hJobObject, YoriShJobListener.Port, (PVOID)(DWORD_PTR)ThisJob->JobId) ||
+        !YoriLibAssignProcessToJobObject(ThisJob->hJobObject, ThisJob->hProcess)) {
+
+        CloseHandle(ThisJob->hJobObject);
+        ThisJob->hJobObject = NULL;
+    }
+}
+
+/**
+ Return a handle which is signalled when a process within a background job
+ may have completed.  The shell can wait on this while waiting for input.
+
+ @return A handle to wait on, or NULL if no background job is being tracked.
+ */
+HANDLE
+YoriShGetJobCompletionWaitHandle(VOID)
+{
+    return YoriShJobListener.Event;
+}
+
+/**
+ Check whether any job that was last known to be executing has completed.
+ This does not update the state of any job.
+
+ @return TRUE if a job has completed and has not yet been reported, FALSE
+         if not.
+ */
+BOOLEAN
+YoriShIsJobCompletionUnreported(VOID)
+{
+    PYORI_JOB ThisJob;
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (YoriShGlobal.PreviousJobId == 0) {
+        return FALSE;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&JobList, NULL);
+    while (ListEntry != NULL) {
+        ThisJob = CONTAINING_RECORD(ListEntry, YORI_JOB, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&JobList, ListEntry);
+        if (ThisJob->JobState == JobStateExecuting &&
+            WaitForSingleObject(ThisJob->hProcess, 0) == WAIT_OBJECT_0) {
+
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Update the state of any job that was last known to be executing and has
+ completed.
+
+ @param Report TRUE to tell the user about each job that has completed,
+        FALSE to update state silently.
+ */
+VOID
+YoriShReportCompletedJobs(
+    __in BOOL Report
+    )
+{
+    PYORI_JOB ThisJob;
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (YoriShGlobal.PreviousJobId == 0) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&JobList, NULL);
+    while (ListEntry != NULL) {
+        ThisJob = CONTAINING_RECORD(ListEntry, YORI_JOB, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&JobList, ListEntry);
+        if (ThisJob->JobState == JobStateExecuting) {
+            if (WaitForSingleObject(ThisJob->hProcess, 0) == WAIT_OBJECT_0) {
+                GetExitCodeProcess(ThisJob->hProcess, &ThisJob->ExitCode);
+                ThisJob->JobState = JobStateCompletedAwaitingDelete;
+                if (Report) {
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Job %i completed, result %i: %y\n"), ThisJob->JobId, ThisJob->ExitCode, &ThisJob->CmdLine);
+                }
+            }
+        }
+    }
+}
+
 /**
  Allocate a new job for background processing.
 
@@ -144,6 +402,7 @@ YoriShCreateNewJob(
     }
 
     ThisJob->JobState = JobStateExecuting;
+    YoriShTrackJobCompletion(ThisJob);
 
     YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Job %i: %y\n"), ThisJob->JobId, &ThisJob->CmdLine);
     YoriLibAppendList(&JobList, &ThisJob->ListEntry);
@@ -167,6 +426,10 @@ YoriShFreeJob(
         YoriLibShDereferenceProcessBuffer(ThisJob->ProcessBuffers);
     }
 
+    if (ThisJob->hJobObject != NULL) {
+        CloseHandle(ThisJob->hJobObject);
+    }
+
     YoriLibFreeStringContents(&ThisJob->CmdLine);
     YoriLibFree(ThisJob);
 }
@@ -194,19 +457,12 @@ YoriShScanJobsReportCompletion(
         return TRUE;
     }
 
+    YoriShReportCompletedJobs(!TeardownAll);
+
     ListEntry = YoriLibGetNextListEntry(&JobList, NULL);
     while (ListEntry != NULL) {
         ThisJob = CONTAINING_RECORD(ListEntry, YORI_JOB, ListEntry);
         ListEntry = YoriLibGetNextListEntry(&JobList, ListEntry);
-        if (ThisJob->JobState == JobStateExecuting) {
-            if (WaitForSingleObject(ThisJob->hProcess, 0) == WAIT_OBJECT_0) {
-                GetExitCodeProcess(ThisJob->hProcess, &ThisJob->ExitCode);
-                ThisJob->JobState = JobStateCompletedAwaitingDelete;
-                if (!TeardownAll) {
-                    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Job %i completed, result %i: %y\n"), ThisJob->JobId, ThisJob->ExitCode, &ThisJob->CmdLine);
-                }
-            }
-        }
 
         if (TeardownAll && ThisJob->JobState == JobStateExecuting) {
             ThisJob->JobState = JobStateCompletedAwaitingDelete;
@@ -223,6 +479,10 @@ YoriShScanJobsReportCompletion(
         }
     }
 
+    if (TeardownAll) {
+        YoriShStopJobListener();
+    }
+
     return TRUE;
 }
 
@@ -138,6 +138,14 @@ YoriShInit(VOID)
 
     YoriLibEnableBackupPrivilege();
 
+    //
+    //  Index the directories in the path so that launching programs does
+    //  not need to search each directory.  If this fails, searches go to
+    //  the file system.
+    //
+
+    YoriLibPathIndexEnable();
+
     //
     //  Translate the constant builtin function mapping into dynamic function
     //  mappings.
@@ -238,20 +246,25 @@ YoriShInit(VOID)
 
         if (YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORICOMPLETEPATH"), NULL, 0, NULL) == 0) {
             YORI_STRING CompletePath;
+            YORI_ENV_COMPONENT_LIST CompleteComponents;
 
             if (YoriLibAllocateString(&CompletePath, ModuleName.LengthInChars + sizeof("\\completion"))) {
-                CompletePath.LengthInChars = YoriLibSPrintf(CompletePath.StartOfString, _T("%y\\completion"), &ModuleName);
-                YoriLibAddEnvComponent(_T("YORICOMPLETEPATH"), &CompletePath, FALSE);
-
-                //
-                //  Convert "completion" into "complete" so there's an 8.3
-                //  compliant name in the search path
-                //
-
-                CompletePath.LengthInChars = (YORI_ALLOC_SIZE_T)(CompletePath.LengthInChars - 2);
-                CompletePath.StartOfString[CompletePath.LengthInChars - 1] = 'e';
-                CompletePath.StartOfString[CompletePath.LengthInChars] = '\0';
-                YoriLibAddEnvComponent(_T("YORICOMPLETEPATH"), &CompletePath, FALSE);
+                if (YoriLibEnvCompInitialize(&CompleteComponents)) {
+                    CompletePath.LengthInChars = YoriLibSPrintf(CompletePath.StartOfString, _T("%y\\completion"), &ModuleName);
+                    YoriLibEnvCompAdd(&CompleteComponents, &CompletePath, FALSE);
+
+                    //
+                    //  Convert "completion" into "complete" so there's an 8.3
+                    //  compliant name in the search path
+                    //
+
+                    CompletePath.LengthInChars = (YORI_ALLOC_SIZE_T)(CompletePath.LengthInChars - 2);
+                    CompletePath.StartOfString[CompletePath.LengthInChars - 1] = 'e';
+                    CompletePath.StartOfString[CompletePath.LengthInChars] = '\0';
+                    YoriLibEnvCompAdd(&CompleteComponents, &CompletePath, FALSE);
+                    YoriLibEnvCompApplyToVariable(&CompleteComponents, _T("YORICOMPLETEPATH"));
+                    YoriLibEnvCompCleanup(&CompleteComponents);
+                }
                 YoriLibFreeStringContents(&CompletePath);
             }
         }
@@ -302,39 +315,68 @@ YoriShInit(VOID)
 }
 
 /**
- Execute any system or user init scripts.
+ Invoke a callback for every system or user init script, in the order they
+ would be executed.
 
- @param IgnoreUserScripts If TRUE, system scripts are executed but user
-        scripts are not.  This is useful to ensure that a script executes
-        consistently in any user context.
+ @param IgnoreUserScripts If TRUE, system scripts are enumerated but user
+        scripts are not.
 
- @return TRUE to indicate success.
+ @param Callback The function to invoke for each script.
+
+ @param Context Context to pass to the callback.
  */
-BOOL
-YoriShExecuteInitScripts(
-    __in BOOLEAN IgnoreUserScripts
+VOID
+YoriShForEachInitScript(
+    __in BOOLEAN IgnoreUserScripts,
+    __in PYORILIB_FILE_ENUM_FN Callback,
+    __in_opt PVOID Context
     )
 {
     YORI_STRING RelativeYoriInitName;
 
     //
-    //  Execute all system YoriInit scripts.
+    //  Enumerate all system YoriInit scripts.
     //
 
     YoriLibConstantString(&RelativeYoriInitName, _T("~AppDir\\YoriInit.d\\*"));
-    YoriLibForEachFile(&RelativeYoriInitName, YORILIB_FILEENUM_RETURN_FILES, 0, YoriShExecuteYoriInit, NULL, NULL);
+    YoriLibForEachFile(&RelativeYoriInitName, YORILIB_FILEENUM_RETURN_FILES, 0, Callback, NULL, Context);
     YoriLibConstantString(&RelativeYoriInitName, _T("~AppDir\\YoriInit*"));
-    YoriLibForEachFile(&RelativeYoriInitName, YORILIB_FILEENUM_RETURN_FILES, 0, YoriShExecuteYoriInit, NULL, NULL);
+    YoriLibForEachFile(&RelativeYoriInitName, YORILIB_FILEENUM_RETURN_FILES, 0, Callback, NULL, Context);
 
     //
-    //  Execute all user YoriInit scripts.
+    //  Enumerate all user YoriInit scripts.
     //
 
     if (!IgnoreUserScripts) {
         YoriLibConstantString(&RelativeYoriInitName, _T("~\\YoriInit.d\\*"));
-        YoriLibForEachFile(&RelativeYoriInitName, YORILIB_FILEENUM_RETURN_FILES, 0, YoriShExecuteYoriInit, NULL, NULL);
+        YoriLibForEachFile(&RelativeYoriInitName, YORILIB_FILEENUM_RETURN_FILES, 0, Callback, NULL, Context);
         YoriLibConstantString(&RelativeYoriInitName, _T("~\\YoriInit*"));
-        YoriLibForEachFile(&RelativeYoriInitName, YORILIB_FILEENUM_RETURN_FILES, 0, YoriShExecuteYoriInit, NULL, NULL);
+        YoriLibForEachFile(&RelativeYoriInitName, YORILIB_FILEENUM_RETURN_FILES, 0, Callback, NULL, Context);
+    }
+}
+
+/**
+ Execute any system or user init scripts.
+
+ @param IgnoreUserScripts If TRUE, system scripts are executed but user
+        scripts are not.  This is useful to ensure that a script executes
+        consistently in any user context.
+
+ @return TRUE to indicate success.
+ */
+BOOL
+YoriShExecuteInitScripts(
+    __in BOOLEAN IgnoreUserScripts
+    )
+{
+    //
+    //  If the user has requested a snapshot of the results of init
+    //  scripts, apply it or execute the scripts and save a new one.
+    //  Otherwise, execute the scripts.
+    //
+
+    if (!YoriShExecuteInitScriptsWithSnapshot(IgnoreUserScripts)) {
+        YoriShForEachInitScript(IgnoreUserScripts, YoriShExecuteYoriInit, NULL);
     }
 
     //
@@ -909,18 +951,24 @@ ymain (
             YoriLibFreeStringContents(&CurrentExpression);
         }
 
-        YoriShSaveHistoryToFile();
+        YoriShCompactHistoryFile();
     }
 
     YoriLibShScanProcessBuffersForTeardown(TRUE);
     YoriShScanJobsReportCompletion(TRUE);
     YoriShClearAllHistory();
     YoriShClearAllAliases();
+    YoriShClearParseCache();
+    YoriShCleanupEnvironmentCache();
+    YoriShCleanupCompletionCache();
+    YoriShCleanupProfile();
     YoriLibShBuiltinUnregisterAll();
     YoriShDiscardSavedRestartState(NULL);
     YoriShCleanupInputContext();
     YoriLibLineReadCleanupCache();
+    YoriLibRegexMatchCleanupCache();
     YoriLibCleanupCurrentDirectory();
+    YoriLibPathIndexCleanup();
     YoriLibFreeStringContents(&YoriShGlobal.PreCmdVariable);
     YoriLibFreeStringContents(&YoriShGlobal.PostCmdVariable);
     YoriLibFreeStringContents(&YoriShGlobal.PromptVariable);
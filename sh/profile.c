@@ -0,0 +1,398 @@
+/**
+ * @file sh/profile.c
+ *
+ * Yori shell per command profiling
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yori.h"
+
+/**
+ When the YORIPROFILE environment variable refers to a file, a line is
+ appended to that file in CSV form for each command that the shell executes.
+ Times are recorded in microseconds and memory in bytes.  The resulting file
+ can be sorted or summarized by any tool that understands CSV.
+ */
+
+/**
+ A handle to the file that profile records are currently being written to,
+ or NULL if profiling is not active.
+ */
+HANDLE YoriShProfileHandle;
+
+/**
+ The name of the file that YoriShProfileHandle refers to, as specified in
+ the YORIPROFILE environment variable.
+ */
+YORI_STRING YoriShProfileFileName;
+
+/**
+ The environment generation when the YORIPROFILE variable was last checked.
+ */
+DWORD YoriShProfileGeneration;
+
+/**
+ TRUE if the YORIPROFILE variable has been checked at least once, meaning
+ YoriShProfileGeneration is meaningful.
+ */
+BOOLEAN YoriShProfileChecked;
+
+/**
+ The frequency of the performance counter, used to convert performance
+ counter values to microseconds.
+ */
+LARGE_INTEGER YoriShProfileFrequency;
+
+/**
+ Close any file that profile records are being written to.
+ */
+VOID
+YoriShCleanupProfile(VOID)
+{
+    if (YoriShProfileHandle != NULL) {
+        CloseHandle(YoriShProfileHandle);
+        YoriShProfileHandle = NULL;
+    }
+    YoriLibFreeStringContents(&YoriShProfileFileName);
+    YoriShProfileChecked = FALSE;
+}
+
+/**
+ Determine whether profiling is currently enabled.  This checks the
+ YORIPROFILE environment variable if it may have changed since it was last
+ checked, and opens or closes the profile file accordingly.
+
+ @return TRUE if profile records should be collected, FALSE if they should
+         not.
+ */
+BOOLEAN
+YoriShProfileIsEnabled(VOID)
+{
+    YORI_STRING FileName;
+    YORI_STRING FullFileName;
+    HANDLE hFile;
+
+    if (YoriShProfileChecked &&
+        YoriShProfileGeneration == YoriShGlobal.EnvironmentGeneration) {
+
+        return (BOOLEAN)(YoriShProfileHandle != NULL);
+    }
+
+    YoriShProfileChecked = TRUE;
+    YoriShProfileGeneration = YoriShGlobal.EnvironmentGeneration;
+
+    YoriLibInitEmptyString(&FileName);
+    if (!YoriShAllocateAndGetEnvironmentVariable(_T("YORIPROFILE"), &FileName, NULL) ||
+        FileName.LengthInChars == 0) {
+
+        YoriLibFreeStringContents(&FileName);
+        if (YoriShProfileHandle != NULL) {
+            CloseHandle(YoriShProfileHandle);
+            YoriShProfileHandle = NULL;
+        }
+        YoriLibFreeStringContents(&YoriShProfileFileName);
+        return FALSE;
+    }
+
+    if (YoriShProfileHandle != NULL &&
+        YoriLibCompareStringIns(&FileName, &YoriShProfileFileName) == 0) {
+
+        YoriLibFreeStringContents(&FileName);
+        return TRUE;
+    }
+
+    if (YoriShProfileHandle != NULL) {
+        CloseHandle(YoriShProfileHandle);
+        YoriShProfileHandle = NULL;
+    }
+    YoriLibFreeStringContents(&YoriShProfileFileName);
+
+    YoriLibInitEmptyString(&FullFileName);
+    if (!YoriLibUserStringToSingleFilePath(&FileName, TRUE, &FullFileName)) {
+        YoriLibFreeStringContents(&FileName);
+        return FALSE;
+    }
+
+    hFile = CreateFile(FullFileName.StartOfString, FILE_APPEND_DATA | SYNCHRONIZE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not open profile file %y\n"), &FullFileName);
+        YoriLibFreeStringContents(&FullFileName);
+        YoriLibFreeStringContents(&FileName);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&FullFileName);
+
+    if (GetFileSize(hFile, NULL) == 0) {
+        YoriLibOutputToDevice(hFile, 0, _T("Command,Type,ExitCode,Parse,Resolve,Create,Wall,Cpu,PeakWorkingSet\n"));
+    }
+
+    YoriLibLoadNtDllFunctions();
+    QueryPerformanceFrequency(&YoriShProfileFrequency);
+    if (YoriShProfileFrequency.QuadPart == 0) {
+        YoriShProfileFrequency.QuadPart = 1;
+    }
+
+    YoriShProfileHandle = hFile;
+    memcpy(&YoriShProfileFileName, &FileName, sizeof(YORI_STRING));
+    return TRUE;
+}
+
+/**
+ Return the current performance counter value if profiling is enabled.
+
+ @return The current performance counter value, or zero if profiling is not
+         enabled.
+ */
+LONGLONG
+YoriShProfileGetTime(VOID)
+{
+    LARGE_INTEGER Now;
+
+    if (!YoriShProfileIsEnabled()) {
+        return 0;
+    }
+
+    QueryPerformanceCounter(&Now);
+    return Now.QuadPart;
+}
+
+/**
+ Record the time spent parsing an expression.  This is attributed to the
+ next command that commences execution.
+
+ @param StartTime The value returned from YoriShProfileGetTime when parsing
+        commenced.  If this is zero, profiling was not enabled and nothing is
+        recorded.
+ */
+VOID
+YoriShProfileSetParseTime(
+    __in LONGLONG StartTime
+    )
+{
+    LARGE_INTEGER Now;
+
+    if (StartTime == 0) {
+        return;
+    }
+
+    QueryPerformanceCounter(&Now);
+    YoriShGlobal.ProfileParseTime = Now.QuadPart - StartTime;
+}
+
+/**
+ Add the time since a specified start time to a profile counter.
+
+ @param Counter Pointer to the counter to update.
+
+ @param StartTime The value returned from YoriShProfileGetTime when the
+        operation commenced.
+ */
+VOID
+YoriShProfileAddElapsed(
+    __inout PLONGLONG Counter,
+    __in LONGLONG StartTime
+    )
+{
+    LARGE_INTEGER Now;
+
+    QueryPerformanceCounter(&Now);
+    *Counter = *Counter + (Now.QuadPart - StartTime);
+}
+
+/**
+ Convert a FILETIME into a 64 bit integer.
+
+ @param FileTime Pointer to the FILETIME to convert.
+
+ @return The value of the FILETIME as an integer.
+ */
+LONGLONG
+YoriShProfileFileTimeToInteger(
+    __in PFILETIME FileTime
+    )
+{
+    LARGE_INTEGER Value;
+
+    Value.LowPart = FileTime->dwLowDateTime;
+    Value.HighPart = FileTime->dwHighDateTime;
+    return Value.QuadPart;
+}
+
+/**
+ Return the amount of CPU time consumed by the current thread, in 100ns
+ units.
+
+ @return The CPU time consumed by the current thread.
+ */
+LONGLONG
+YoriShProfileGetThreadCpuTime(VOID)
+{
+    FILETIME CreationTime;
+    FILETIME ExitTime;
+    FILETIME KernelTime;
+    FILETIME UserTime;
+
+    if (!GetThreadTimes(GetCurrentThread(), &CreationTime, &ExitTime, &KernelTime, &UserTime)) {
+        return 0;
+    }
+
+    return YoriShProfileFileTimeToInteger(&KernelTime) + YoriShProfileFileTimeToInteger(&UserTime);
+}
+
+/**
+ Indicate that a command is about to be executed.  If profiling is enabled,
+ the command record is initialized and becomes the record that later timing
+ information is attributed to.
+
+ @param Command Pointer to the profile record to initialize.
+
+ @return TRUE if the command is being profiled, FALSE if it is not.
+ */
+BOOLEAN
+YoriShProfileBeginCommand(
+    __out PYORI_SH_PROFILE_COMMAND Command
+    )
+{
+    LARGE_INTEGER Now;
+
+    if (!YoriShProfileIsEnabled()) {
+        YoriShGlobal.ProfileParseTime = 0;
+        return FALSE;
+    }
+
+    ZeroMemory(Command, sizeof(YORI_SH_PROFILE_COMMAND));
+    Command->ParseTime = YoriShGlobal.ProfileParseTime;
+    YoriShGlobal.ProfileParseTime = 0;
+    Command->ThreadCpuTime = YoriShProfileGetThreadCpuTime();
+    QueryPerformanceCounter(&Now);
+    Command->StartTime = Now.QuadPart;
+    return TRUE;
+}
+
+/**
+ Write a profile record for a command that has completed execution.
+
+ @param Command Pointer to the profile record that was initialized with
+        YoriShProfileBeginCommand.
+
+ @param ExecContext Pointer to the command that was executed.
+ */
+VOID
+YoriShProfileEndCommand(
+    __in PYORI_SH_PROFILE_COMMAND Command,
+    __in PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext
+    )
+{
+    LARGE_INTEGER Now;
+    LONGLONG WallTime;
+    LONGLONG CpuTime;
+    DWORDLONG PeakWorkingSet;
+    PYORI_STRING Name;
+    YORI_STRING Escaped;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Length;
+    LPCTSTR Type;
+
+    QueryPerformanceCounter(&Now);
+    WallTime = Now.QuadPart - Command->StartTime;
+
+    if (YoriShProfileHandle == NULL) {
+        return;
+    }
+
+    //
+    //  If a child process was waited on, report its resource usage.
+    //  Otherwise the command was executed in process, so report the CPU
+    //  time consumed by this thread while it executed.  Memory is not
+    //  reported for these, since it is not distinguishable from the shell's.
+    //
+
+    PeakWorkingSet = 0;
+    if (ExecContext->hProcess != NULL && ExecContext->WaitForCompletion) {
+        FILETIME CreationTime;
+        FILETIME ExitTime;
+        FILETIME KernelTime;
+        FILETIME UserTime;
+
+        Type = _T("process");
+        CpuTime = 0;
+        if (GetProcessTimes(ExecContext->hProcess, &CreationTime, &ExitTime, &KernelTime, &UserTime)) {
+            CpuTime = YoriShProfileFileTimeToInteger(&KernelTime) + YoriShProfileFileTimeToInteger(&UserTime);
+        }
+
+        if (DllNtDll.pNtQueryInformationProcess != NULL) {
+            PROCESS_VM_COUNTERS VmInfo;
+            DWORD BytesReturned;
+
+            if (DllNtDll.pNtQueryInformationProcess(ExecContext->hProcess, ProcessVmCounters, &VmInfo, sizeof(VmInfo), &BytesReturned) == 0) {
+                PeakWorkingSet = VmInfo.PeakWorkingSetSize;
+            }
+        }
+    } else if (ExecContext->hProcess != NULL || ExecContext->dwProcessId != 0) {
+        Type = _T("async");
+        CpuTime = 0;
+    } else {
+        Type = _T("inproc");
+        CpuTime = YoriShProfileGetThreadCpuTime() - Command->ThreadCpuTime;
+        if (CpuTime < 0) {
+            CpuTime = 0;
+        }
+    }
+
+    //
+    //  The command name is quoted, with any embedded quotes doubled.
+    //
+
+    Name = &ExecContext->CmdToExec.ArgV[0];
+    YoriLibInitEmptyString(&Escaped);
+    if (!YoriLibAllocateString(&Escaped, Name->LengthInChars * 2 + 1)) {
+        return;
+    }
+
+    Length = 0;
+    for (Index = 0; Index < Name->LengthInChars; Index++) {
+        if (Name->StartOfString[Index] == '"') {
+            Escaped.StartOfString[Length++] = '"';
+        }
+        Escaped.StartOfString[Length++] = Name->StartOfString[Index];
+    }
+    Escaped.StartOfString[Length] = '\0';
+    Escaped.LengthInChars = Length;
+
+    YoriLibOutputToDevice(YoriShProfileHandle,
+                          0,
+                          _T("\"%y\",%s,%i,%lli,%lli,%lli,%lli,%lli,%lli\n"),
+                          &Escaped,
+                          Type,
+                          YoriShGlobal.ErrorLevel,
+                          Command->ParseTime * 1000000 / YoriShProfileFrequency.QuadPart,
+                          Command->ResolveTime * 1000000 / YoriShProfileFrequency.QuadPart,
+                          Command->CreateTime * 1000000 / YoriShProfileFrequency.QuadPart,
+                          WallTime * 1000000 / YoriShProfileFrequency.QuadPart,
+                          CpuTime / 10,
+                          PeakWorkingSet);
+
+    YoriLibFreeStringContents(&Escaped);
+}
+
+// vim:sw=4:ts=4:et:
@@ -38,6 +38,65 @@ BOOL YoriShPromptAdminDetermined;
  */
 BOOL YoriShPromptAdminPresent;
 
+/**
+ The maximum number of bytes of output to capture from the YORIPROMPTASYNC
+ expression.  Any further output is discarded.
+ */
+#define YORI_SH_PROMPT_ASYNC_MAX_OUTPUT (4 * 1024)
+
+/**
+ State for an asynchronous evaluation of the YORIPROMPTASYNC expression.
+ This is owned by the thread reading output until that thread terminates.
+ */
+typedef struct _YORI_SH_PROMPT_ASYNC_CONTEXT {
+
+    /**
+     A handle to the pipe containing the output of the expression.
+     */
+    HANDLE ReadPipe;
+
+    /**
+     The number of bytes of output captured in Buffer.
+     */
+    DWORD BytesPopulated;
+
+    /**
+     The output of the expression.
+     */
+    UCHAR Buffer[YORI_SH_PROMPT_ASYNC_MAX_OUTPUT];
+} YORI_SH_PROMPT_ASYNC_CONTEXT, *PYORI_SH_PROMPT_ASYNC_CONTEXT;
+
+/**
+ Pointer to the state of the asynchronous evaluation in progress, or NULL if
+ no evaluation is in progress.
+ */
+PYORI_SH_PROMPT_ASYNC_CONTEXT YoriShPromptAsyncContext;
+
+/**
+ A handle to the thread capturing the output of the asynchronous evaluation
+ in progress.  This is signalled when the evaluation has completed.
+ */
+HANDLE YoriShPromptAsyncThread;
+
+/**
+ The result of the most recently completed evaluation of YORIPROMPTASYNC,
+ which is displayed in place of $ASYNC$ in the prompt.
+ */
+YORI_STRING YoriShPromptAsyncValue;
+
+/**
+ The prompt as last displayed after backquote and environment expansion but
+ before prompt variables are expanded.  This allows the prompt to be redrawn
+ when a new asynchronous value arrives without evaluating anything again.
+ */
+YORI_STRING YoriShPromptLastExpanded;
+
+/**
+ The number of cells between the beginning of the prompt as last displayed
+ and the cursor position following it.
+ */
+YORI_ALLOC_SIZE_T YoriShPromptLastCellCount;
+
 /**
  Return TRUE if the process is running as part of the administrator group,
  FALSE if not.
@@ -86,6 +145,11 @@ YoriShExpandPrompt(
         if (OutputString->LengthAllocated > CharsNeeded) {
             OutputString->StartOfString[0] = '&';
         }
+    } else if (YoriLibCompareStringLitIns(VariableName, _T("ASYNC")) == 0) {
+        CharsNeeded = YoriShPromptAsyncValue.LengthInChars;
+        if (OutputString->LengthAllocated >= CharsNeeded) {
+            memcpy(OutputString->StartOfString, YoriShPromptAsyncValue.StartOfString, CharsNeeded * sizeof(TCHAR));
+        }
     } else if (YoriLibCompareStringLitIns(VariableName, _T("B")) == 0) {
         CharsNeeded = 1;
         if (OutputString->LengthAllocated > CharsNeeded) {
@@ -171,6 +235,370 @@ YoriShExpandPrompt(
     return CharsNeeded;
 }
 
+/**
+ A thread which captures the output of an asynchronous evaluation of
+ YORIPROMPTASYNC.  The thread terminates once the expression has finished
+ writing output.
+
+ @param Param Pointer to the asynchronous evaluation context.
+
+ @return Thread return code, which is ignored for this thread.
+ */
+DWORD WINAPI
+YoriShPromptAsyncPump(
+    __in LPVOID Param
+    )
+{
+    PYORI_SH_PROMPT_ASYNC_CONTEXT Context;
+    DWORD BytesRead;
+
+    Context = (PYORI_SH_PROMPT_ASYNC_CONTEXT)Param;
+
+    while (Context->BytesPopulated < sizeof(Context->Buffer) &&
+           ReadFile(Context->ReadPipe,
+                    &Context->Buffer[Context->BytesPopulated],
+                    sizeof(Context->Buffer) - Context->BytesPopulated,
+                    &BytesRead,
+                    NULL) &&
+           BytesRead > 0) {
+
+        Context->BytesPopulated = Context->BytesPopulated + BytesRead;
+    }
+
+    CloseHandle(Context->ReadPipe);
+    Context->ReadPipe = NULL;
+    return 0;
+}
+
+/**
+ Begin evaluating the YORIPROMPTASYNC expression in the background, if it is
+ defined and no evaluation is already in progress.  The expression is
+ executed by a subshell process attached to a separate console, so it cannot
+ interfere with the state of this process or its console while the user is
+ entering input.  The subshell inherits the environment and current
+ directory at the time this function is called.
+ */
+VOID
+YoriShStartAsyncPromptEvaluation(VOID)
+{
+    PYORI_SH_PROMPT_ASYNC_CONTEXT Context;
+    YORI_STRING Expression;
+    YORI_STRING PathToYori;
+    YORI_STRING CmdLine;
+    SECURITY_ATTRIBUTES InheritHandle;
+    STARTUPINFO StartupInfo;
+    PROCESS_INFORMATION ProcessInfo;
+    HANDLE WritePipe;
+    HANDLE InheritableWritePipe;
+    HANDLE NulHandle;
+    DWORD ThreadId;
+    BOOL Success;
+
+    if (YoriShPromptAsyncThread != NULL) {
+        return;
+    }
+
+    YoriLibInitEmptyString(&Expression);
+    if (!YoriShAllocateAndGetEnvironmentVariable(_T("YORIPROMPTASYNC"), &Expression, NULL)) {
+        return;
+    }
+
+    if (Expression.LengthInChars == 0) {
+        YoriLibFreeStringContents(&Expression);
+        return;
+    }
+
+    YoriLibInitEmptyString(&PathToYori);
+    if (!YoriShAllocateAndGetEnvironmentVariable(_T("YORISPEC"), &PathToYori, NULL) ||
+        PathToYori.LengthInChars == 0) {
+
+        YoriLibFreeStringContents(&PathToYori);
+        YoriLibFreeStringContents(&Expression);
+        return;
+    }
+
+    if (!YoriLibAllocateString(&CmdLine, PathToYori.LengthInChars + Expression.LengthInChars + sizeof("\"\" /ss "))) {
+        YoriLibFreeStringContents(&PathToYori);
+        YoriLibFreeStringContents(&Expression);
+        return;
+    }
+
+    CmdLine.LengthInChars = YoriLibSPrintf(CmdLine.StartOfString, _T("\"%y\" /ss %y"), &PathToYori, &Expression);
+    YoriLibFreeStringContents(&PathToYori);
+    YoriLibFreeStringContents(&Expression);
+
+    Context = YoriLibMalloc(sizeof(YORI_SH_PROMPT_ASYNC_CONTEXT));
+    if (Context == NULL) {
+        YoriLibFreeStringContents(&CmdLine);
+        return;
+    }
+
+    Context->BytesPopulated = 0;
+
+    if (!CreatePipe(&Context->ReadPipe, &WritePipe, NULL, 0)) {
+        YoriLibFree(Context);
+        YoriLibFreeStringContents(&CmdLine);
+        return;
+    }
+
+    if (!YoriLibMakeInheritableHandle(WritePipe, &InheritableWritePipe)) {
+        CloseHandle(WritePipe);
+        CloseHandle(Context->ReadPipe);
+        YoriLibFree(Context);
+        YoriLibFreeStringContents(&CmdLine);
+        return;
+    }
+
+    ZeroMemory(&InheritHandle, sizeof(InheritHandle));
+    InheritHandle.nLength = sizeof(InheritHandle);
+    InheritHandle.bInheritHandle = TRUE;
+
+    NulHandle = CreateFile(_T("NUL"),
+                           GENERIC_READ | GENERIC_WRITE,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           &InheritHandle,
+                           OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL,
+                           NULL);
+
+    if (NulHandle == INVALID_HANDLE_VALUE) {
+        CloseHandle(InheritableWritePipe);
+        CloseHandle(Context->ReadPipe);
+        YoriLibFree(Context);
+        YoriLibFreeStringContents(&CmdLine);
+        return;
+    }
+
+    ZeroMemory(&StartupInfo, sizeof(StartupInfo));
+    StartupInfo.cb = sizeof(StartupInfo);
+    StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+    StartupInfo.hStdInput = NulHandle;
+    StartupInfo.hStdOutput = InheritableWritePipe;
+    StartupInfo.hStdError = NulHandle;
+
+    Success = CreateProcess(NULL, CmdLine.StartOfString, NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL, &StartupInfo, &ProcessInfo);
+
+    CloseHandle(NulHandle);
+    CloseHandle(InheritableWritePipe);
+    YoriLibFreeStringContents(&CmdLine);
+
+    if (!Success) {
+        CloseHandle(Context->ReadPipe);
+        YoriLibFree(Context);
+        return;
+    }
+
+    CloseHandle(ProcessInfo.hThread);
+    CloseHandle(ProcessInfo.hProcess);
+
+    YoriShPromptAsyncThread = CreateThread(NULL, 0, YoriShPromptAsyncPump, Context, 0, &ThreadId);
+    if (YoriShPromptAsyncThread == NULL) {
+        CloseHandle(Context->ReadPipe);
+        YoriLibFree(Context);
+        return;
+    }
+
+    YoriShPromptAsyncContext = Context;
+}
+
+/**
+ Return a handle which is signalled when an asynchronous evaluation of the
+ prompt completes.
+
+ @return A handle to wait on, or NULL if no evaluation is in progress.
+ */
+HANDLE
+YoriShGetAsyncPromptWaitHandle(VOID)
+{
+    return YoriShPromptAsyncThread;
+}
+
+/**
+ If an asynchronous evaluation of the prompt has completed, record its
+ result so that it is used the next time the prompt is displayed.
+
+ @return TRUE to indicate the result differs from the value previously
+         displayed, so the prompt should be redrawn.  FALSE if no evaluation
+         has completed or its result is unchanged.
+ */
+BOOLEAN
+YoriShCollectAsyncPromptResult(VOID)
+{
+    PYORI_SH_PROMPT_ASYNC_CONTEXT Context;
+    YORI_STRING Output;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+    BOOLEAN Changed;
+
+    if (YoriShPromptAsyncThread == NULL ||
+        WaitForSingleObject(YoriShPromptAsyncThread, 0) != WAIT_OBJECT_0) {
+
+        return FALSE;
+    }
+
+    CloseHandle(YoriShPromptAsyncThread);
+    YoriShPromptAsyncThread = NULL;
+    Context = YoriShPromptAsyncContext;
+    YoriShPromptAsyncContext = NULL;
+
+    Changed = FALSE;
+    CharsNeeded = YoriLibGetMultibyteInputSizeNeeded((LPCSTR)Context->Buffer, (YORI_ALLOC_SIZE_T)Context->BytesPopulated);
+    if (YoriLibAllocateString(&Output, CharsNeeded + 1)) {
+        YoriLibMultibyteInput((LPCSTR)Context->Buffer, (YORI_ALLOC_SIZE_T)Context->BytesPopulated, Output.StartOfString, CharsNeeded);
+        Output.LengthInChars = CharsNeeded;
+
+        //
+        //  Format the output in the same way as a backquoted expression.
+        //
+
+        YoriLibTrimTrailingNewlines(&Output);
+        for (Index = 0; Index < Output.LengthInChars; Index++) {
+            if (Output.StartOfString[Index] == '\n' ||
+                Output.StartOfString[Index] == '\r') {
+
+                Output.StartOfString[Index] = ' ';
+            }
+        }
+        Output.StartOfString[Output.LengthInChars] = '\0';
+
+        if (YoriLibCompareString(&Output, &YoriShPromptAsyncValue) != 0) {
+            YoriLibFreeStringContents(&YoriShPromptAsyncValue);
+            memcpy(&YoriShPromptAsyncValue, &Output, sizeof(YORI_STRING));
+            Changed = TRUE;
+        } else {
+            YoriLibFreeStringContents(&Output);
+        }
+    }
+
+    YoriLibFree(Context);
+    return Changed;
+}
+
+/**
+ Calculate the number of cells the cursor moves when a string is displayed.
+ VT escape sequences do not move the cursor, and a newline moves it to the
+ beginning of the following line.
+
+ @param String Pointer to the string that is displayed.
+
+ @param StartColumn The column of the cursor before the string is displayed.
+
+ @param Width The number of columns in the console.
+
+ @return The number of cells the cursor moves.
+ */
+YORI_ALLOC_SIZE_T
+YoriShPromptCountCells(
+    __in PYORI_STRING String,
+    __in YORI_ALLOC_SIZE_T StartColumn,
+    __in YORI_ALLOC_SIZE_T Width
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Cells;
+    YORI_ALLOC_SIZE_T Column;
+    TCHAR Char;
+
+    Cells = 0;
+    Column = StartColumn;
+
+    for (Index = 0; Index < String->LengthInChars; Index++) {
+        Char = String->StartOfString[Index];
+        if (Char == 27) {
+            if (Index + 1 < String->LengthInChars &&
+                String->StartOfString[Index + 1] == '[') {
+
+                Index = Index + 2;
+                while (Index < String->LengthInChars &&
+                       (String->StartOfString[Index] < 0x40 ||
+                        String->StartOfString[Index] > 0x7E)) {
+
+                    Index++;
+                }
+            }
+        } else if (Char == '\n') {
+            Cells = Cells + Width - Column;
+            Column = 0;
+        } else if (Char == '\r') {
+            Cells = Cells - Column;
+            Column = 0;
+        } else {
+            Cells++;
+            Column++;
+            if (Column >= Width) {
+                Column = 0;
+            }
+        }
+    }
+
+    return Cells;
+}
+
+/**
+ Expand prompt variables in a prompt that has already had backquotes and
+ environment variables expanded, and display the result.  This records the
+ string and the number of cells it occupies so that it can be redrawn
+ later.
+
+ @param Expanded Pointer to the prompt after backquote and environment
+        expansion.
+ */
+VOID
+YoriShRenderPrompt(
+    __in PYORI_STRING Expanded
+    )
+{
+    YORI_STRING DisplayString;
+    CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
+
+    YoriLibInitEmptyString(&DisplayString);
+    YoriLibExpandCommandVariables(Expanded, '$', YoriShExpandPrompt, NULL, &DisplayString);
+
+    YoriShPromptLastCellCount = 0;
+    if (DisplayString.StartOfString != NULL) {
+        if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &ScreenInfo)) {
+            YoriShPromptLastCellCount = YoriShPromptCountCells(&DisplayString, ScreenInfo.dwCursorPosition.X, ScreenInfo.dwSize.X);
+        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+        YoriLibFreeStringContents(&DisplayString);
+    }
+}
+
+/**
+ Display the prompt again at the current cursor location, using the result
+ of expansion from when it was last displayed along with the latest result
+ of any asynchronous evaluation.
+
+ @return TRUE to indicate the prompt was displayed, FALSE if no prompt is
+         available to redraw.
+ */
+__success(return)
+BOOL
+YoriShRedisplayPrompt(VOID)
+{
+    if (YoriShPromptLastExpanded.LengthInChars == 0) {
+        return FALSE;
+    }
+
+    YoriShRenderPrompt(&YoriShPromptLastExpanded);
+    return TRUE;
+}
+
+/**
+ Return the number of cells between the beginning of the prompt as last
+ displayed and the cursor position following it.
+
+ @return The number of cells, or zero if the prompt cannot be redrawn.
+ */
+YORI_ALLOC_SIZE_T
+YoriShGetPromptCellCount(VOID)
+{
+    if (YoriShPromptLastExpanded.LengthInChars == 0) {
+        return 0;
+    }
+    return YoriShPromptLastCellCount;
+}
+
 /**
  Displays the current prompt string on the console.
 
@@ -248,6 +676,13 @@ YoriShDisplayPrompt(VOID)
         }
     }
 
+    //
+    //  If an asynchronous evaluation completed while the previous command
+    //  was executing, display its result.
+    //
+
+    YoriShCollectAsyncPromptResult();
+
     //
     //  Expand and display the prompt
     //
@@ -288,19 +723,17 @@ YoriShDisplayPrompt(VOID)
         }
 
         //
-        //  Expand any prompt command variables.
-        //
-
-        YoriLibExpandCommandVariables(StringToUse, '$', YoriShExpandPrompt, NULL, &DisplayString);
-
-        //
-        //  Display the result.
+        //  Retain the expanded prompt so it can be redrawn if an
+        //  asynchronous evaluation completes while input is in progress,
+        //  then expand any prompt command variables and display the
+        //  result.
         //
 
-        if (DisplayString.StartOfString != NULL) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
-            YoriLibFreeStringContents(&DisplayString);
+        YoriLibFreeStringContents(&YoriShPromptLastExpanded);
+        if (!YoriLibCopyString(&YoriShPromptLastExpanded, StringToUse)) {
+            YoriLibInitEmptyString(&YoriShPromptLastExpanded);
         }
+        YoriShRenderPrompt(StringToUse);
 
         //
         //  If any step involved generating a new string, free those now.
@@ -313,8 +746,17 @@ YoriShDisplayPrompt(VOID)
             YoriLibFreeStringContents(&PromptAfterBackquoteExpansion);
         }
 
+        //
+        //  Start evaluating any asynchronous part of the prompt for next
+        //  time.  The value displayed now is from the previous evaluation.
+        //
+
+        YoriShStartAsyncPromptEvaluation();
+
     } else {
 
+        YoriLibFreeStringContents(&YoriShPromptLastExpanded);
+
         LPTSTR PromptString;
         EnvVarLength = (YORI_ALLOC_SIZE_T)GetCurrentDirectory(0, NULL);
 
@@ -191,6 +191,30 @@ YoriShCompleteSuggestion(
     __inout PYORI_SH_INPUT_BUFFER Buffer
     );
 
+BOOLEAN
+YoriShStartBackgroundSuggestion(
+    __inout PYORI_SH_INPUT_BUFFER Buffer
+    );
+
+HANDLE
+YoriShGetBackgroundSuggestionWaitHandle(
+    __in PYORI_SH_INPUT_BUFFER Buffer
+    );
+
+BOOLEAN
+YoriShCollectBackgroundSuggestion(
+    __inout PYORI_SH_INPUT_BUFFER Buffer,
+    __out PBOOLEAN ForegroundRequired
+    );
+
+VOID
+YoriShCancelBackgroundSuggestion(
+    __inout PYORI_SH_INPUT_BUFFER Buffer
+    );
+
+VOID
+YoriShCleanupCompletionCache(VOID);
+
 // *** ENV.C ***
 
 BOOLEAN
@@ -198,6 +222,9 @@ YoriShIsEnvironmentVariableChar(
     __in TCHAR Char
     );
 
+VOID
+YoriShCleanupEnvironmentCache(VOID);
+
 __success(return != 0)
 YORI_ALLOC_SIZE_T
 YoriShGetEnvironmentVariableWithoutSubstitution(
@@ -260,6 +287,12 @@ YoriShExecuteSingleProgram(
     __in PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext
     );
 
+VOID
+YoriShExecExecPlan(
+    __in PYORI_LIBSH_EXEC_PLAN ExecPlan,
+    __out_opt PVOID * OutputBuffer
+    );
+
 __success(return)
 BOOL
 YoriShExecuteExpressionAndCaptureOutput(
@@ -274,6 +307,9 @@ YoriShExpandBackquotes(
     __out PYORI_STRING ResultingExpression
     );
 
+VOID
+YoriShClearParseCache(VOID);
+
 __success(return)
 BOOL
 YoriShExecuteExpression(
@@ -303,6 +339,13 @@ YoriShRemoveOneHistoryEntry(
 VOID
 YoriShClearAllHistory(VOID);
 
+PYORI_SH_HISTORY_ENTRY
+YoriShFindHistoryEntryContaining(
+    __in PYORI_STRING SearchString,
+    __in DWORD OlderThanSequence,
+    __out PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    );
+
 __success(return)
 BOOL
 YoriShInitHistory(VOID);
@@ -311,9 +354,18 @@ __success(return)
 BOOL
 YoriShLoadHistoryFromFile(VOID);
 
+VOID
+YoriShLoadDeferredHistory(VOID);
+
+__success(return)
+BOOL
+YoriShAppendToHistoryFile(
+    __in PYORI_STRING NewCmd
+    );
+
 __success(return)
 BOOL
-YoriShSaveHistoryToFile(VOID);
+YoriShCompactHistoryFile(VOID);
 
 __success(return)
 BOOL
@@ -322,6 +374,14 @@ YoriShGetHistoryStrings(
     __inout PYORI_STRING HistoryStrings
     );
 
+// *** INITSNAP.C ***
+
+__success(return)
+BOOL
+YoriShExecuteInitScriptsWithSnapshot(
+    __in BOOLEAN IgnoreUserScripts
+    );
+
 // *** INPUT.C ***
 
 __success(return)
@@ -361,6 +421,17 @@ YoriShScanJobsReportCompletion(
     __in BOOL TeardownAll
     );
 
+HANDLE
+YoriShGetJobCompletionWaitHandle(VOID);
+
+BOOLEAN
+YoriShIsJobCompletionUnreported(VOID);
+
+VOID
+YoriShReportCompletedJobs(
+    __in BOOL Report
+    );
+
 DWORD
 YoriShGetNextJobId(
     __in DWORD PreviousJobId
@@ -412,6 +483,21 @@ YoriShGetJobInformation(
 
 // *** MAIN.C ***
 
+BOOL
+YoriShExecuteYoriInit(
+    __in PYORI_STRING Filename,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    );
+
+VOID
+YoriShForEachInitScript(
+    __in BOOLEAN IgnoreUserScripts,
+    __in PYORILIB_FILE_ENUM_FN Callback,
+    __in_opt PVOID Context
+    );
+
 VOID
 YoriShPreCommand(
     __in BOOLEAN EnableVt
@@ -431,7 +517,50 @@ YoriShResolveCommandToExecutable(
     __out PBOOLEAN ExecutableFound
     );
 
+// *** PROFILE.C ***
+
+VOID
+YoriShCleanupProfile(VOID);
+
+LONGLONG
+YoriShProfileGetTime(VOID);
+
+VOID
+YoriShProfileSetParseTime(
+    __in LONGLONG StartTime
+    );
+
+VOID
+YoriShProfileAddElapsed(
+    __inout PLONGLONG Counter,
+    __in LONGLONG StartTime
+    );
+
+BOOLEAN
+YoriShProfileBeginCommand(
+    __out PYORI_SH_PROFILE_COMMAND Command
+    );
+
+VOID
+YoriShProfileEndCommand(
+    __in PYORI_SH_PROFILE_COMMAND Command,
+    __in PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext
+    );
+
 // *** PROMPT.C ***
+HANDLE
+YoriShGetAsyncPromptWaitHandle(VOID);
+
+BOOLEAN
+YoriShCollectAsyncPromptResult(VOID);
+
+__success(return)
+BOOL
+YoriShRedisplayPrompt(VOID);
+
+YORI_ALLOC_SIZE_T
+YoriShGetPromptCellCount(VOID);
+
 BOOL
 YoriShDisplayPrompt(VOID);
 
@@ -38,6 +38,12 @@ typedef struct _YORI_SH_HISTORY_ENTRY {
      The command that was executed by the user.
      */
     YORI_STRING CmdLine;
+
+    /**
+     A number which increases with each entry added to history, used to
+     order entries when searching.
+     */
+    DWORD Sequence;
 } YORI_SH_HISTORY_ENTRY, *PYORI_SH_HISTORY_ENTRY;
 
 /**
@@ -126,6 +132,26 @@ typedef struct _YORI_SH_TAB_COMPLETE_CONTEXT {
      */
     BOOLEAN PotentialNonPrefixMatch;
 
+    /**
+     TRUE if the user pressed a key while matches were being populated.
+     The matches are incomplete and should be discarded so the key can be
+     processed.
+     */
+    BOOLEAN Interrupted;
+
+    /**
+     The tick count when the console was last checked for input while
+     populating matches.
+     */
+    DWORD LastInputCheckTick;
+
+    /**
+     If matches are being populated on a background thread to calculate a
+     suggestion, points to the state of that calculation.  NULL if matches
+     are being populated on the input thread.
+     */
+    struct _YORI_SH_BACKGROUND_SUGGESTION *BackgroundSuggestion;
+
     /**
      A list of matches that apply to the criteria that was searched.
      */
@@ -213,6 +239,19 @@ typedef struct _YORI_SH_INPUT_BUFFER {
      */
     YORI_ALLOC_SIZE_T DirtyLength;
 
+    /**
+     The characters most recently drawn for the buffer, followed by those
+     drawn for the suggestion.  Cells in the dirty range that still contain
+     the correct character are not drawn again.  This has no characters if
+     the contents of the console are not known.
+     */
+    YORI_STRING DisplayedCells;
+
+    /**
+     The offset within @ref DisplayedCells where the suggestion begins.
+     */
+    YORI_ALLOC_SIZE_T DisplayedSuggestionOffset;
+
     /**
      TRUE if the input should be in insert mode, FALSE if it should be
      overwrite mode.
@@ -299,6 +338,12 @@ typedef struct _YORI_SH_INPUT_BUFFER {
      */
     YORI_STRING SuggestionString;
 
+    /**
+     If a suggestion is being calculated on a background thread, points to
+     the state of that calculation.  NULL if no calculation is in progress.
+     */
+    struct _YORI_SH_BACKGROUND_SUGGESTION *BackgroundSuggestion;
+
     /**
      If TRUE, the search buffer is the active buffer where keystrokes and
      backspace keys should be delivered to.  If FALSE, keystrokes are
@@ -317,6 +362,24 @@ typedef struct _YORI_SH_INPUT_BUFFER {
      */
     YORI_STRING SearchString;
 
+    /**
+     If TRUE, the search buffer is being used to search history rather than
+     the input buffer, and the input buffer contains the current match.
+     */
+    BOOLEAN HistorySearchMode;
+
+    /**
+     The sequence number of the history entry currently displayed as the
+     result of a history search, or zero if no match has been found.
+     */
+    DWORD HistorySearchSequence;
+
+    /**
+     The input string as it was when a history search started.  This is
+     restored if the search is cancelled.
+     */
+    YORI_STRING PreSearchString;
+
 } YORI_SH_INPUT_BUFFER, *PYORI_SH_INPUT_BUFFER;
 
 /**
@@ -412,6 +475,66 @@ typedef enum _YORI_SH_WAIT_OUTCOME {
     YoriShWaitOutcomeLoseFocus = 3
 } YORI_SH_WAIT_OUTCOME;
 
+/**
+ State describing a backquoted expression whose output may be captured
+ directly into memory if it is executed in process.
+ */
+typedef struct _YORI_SH_INPROC_CAPTURE {
+
+    /**
+     The single command within the expression that is eligible to have its
+     output captured into memory, or NULL if no command is eligible.
+     */
+    PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext;
+
+    /**
+     On completion, the output of ExecContext.  This is only meaningful if
+     Complete is TRUE.
+     */
+    YORI_STRING Output;
+
+    /**
+     TRUE if ExecContext was executed in process and Output has been
+     populated with its output.
+     */
+    BOOLEAN Complete;
+} YORI_SH_INPROC_CAPTURE, *PYORI_SH_INPROC_CAPTURE;
+
+/**
+ Timing information collected for a single command while it executes, when
+ profiling is enabled.  All times are in performance counter units.
+ */
+typedef struct _YORI_SH_PROFILE_COMMAND {
+
+    /**
+     The time spent parsing the expression containing the command.  This is
+     only recorded against the first command in an expression.
+     */
+    LONGLONG ParseTime;
+
+    /**
+     The time spent resolving the command to an executable.
+     */
+    LONGLONG ResolveTime;
+
+    /**
+     The time spent creating a child process.
+     */
+    LONGLONG CreateTime;
+
+    /**
+     The performance counter value when the command commenced.
+     */
+    LONGLONG StartTime;
+
+    /**
+     The CPU time consumed by the shell thread when the command commenced, in
+     100ns units.  This is used to determine the CPU time of commands that
+     execute in process.
+     */
+    LONGLONG ThreadCpuTime;
+} YORI_SH_PROFILE_COMMAND, *PYORI_SH_PROFILE_COMMAND;
+
 /**
  A structure containing state that is global across the Yori shell process.
  */
@@ -462,6 +585,24 @@ typedef struct _YORI_SH_GLOBALS {
      */
     DWORD RecursionDepth;
 
+    /**
+     Points to the backquoted expression currently being evaluated, if any.
+     */
+    PYORI_SH_INPROC_CAPTURE InProcCapture;
+
+    /**
+     Points to the profile record of the command currently being executed,
+     or NULL if profiling is not enabled.
+     */
+    PYORI_SH_PROFILE_COMMAND ProfileCommand;
+
+    /**
+     The time spent parsing the expression that is about to be executed, in
+     performance counter units.  This is attributed to the first command
+     that is executed.
+     */
+    LONGLONG ProfileParseTime;
+
     /**
      Count of prompt recursion depth.  This is the number of characters to
      display when $+$ is used.
@@ -646,6 +787,14 @@ typedef struct _YORI_SH_GLOBALS {
      */
     BOOLEAN InteractiveMode;
 
+    /**
+     TRUE while the output of a builtin is being captured into memory.  Any
+     command executed by that builtin needs its output buffered and written
+     through the capture, since standard output does not refer to anything
+     that a child process could write to.
+     */
+    BOOLEAN InProcCaptureActive;
+
     /**
      The Win32 color to use when changing text color due to a mouse over.
      */
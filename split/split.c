@@ -3,7 +3,7 @@
  *
  * Yori shell split a file into pieces
  *
- * Copyright (c) 2018-2019 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -35,12 +35,13 @@ CHAR strSplitHelpText[] =
         "\n"
         "Split a file into pieces.\n"
         "\n"
-        "SPLIT [-license] [-j] [-l n | -b n] [-p <prefix>] [<file>]\n"
+        "SPLIT [-license] [-j] [-l n | -b n] [-p <prefix>] [-u] [<file>]\n"
         "\n"
         "   -b             Use <n> bytes per part\n"
         "   -j             Join files previously split into one\n"
         "   -l             Use <n> number of lines per part\n"
-        "   -p             Specify the prefix of part files\n";
+        "   -p             Specify the prefix of part files\n"
+        "   -u             Use unbuffered IO for files\n";
 
 /**
  Display usage text to the user.
@@ -89,20 +90,77 @@ typedef struct _SPLIT_CONTEXT {
      */
     YORI_STRING Prefix;
 
+    /**
+     If TRUE, files are opened with FILE_FLAG_NO_BUFFERING where the sizes
+     of parts allow it.
+     */
+    BOOLEAN Unbuffered;
+
 } SPLIT_CONTEXT, *PSPLIT_CONTEXT;
 
+/**
+ The maximum number of part files to write at the same time when splitting
+ a file by bytes.
+ */
+#define SPLIT_MAX_CONCURRENT_PARTS (4)
+
+/**
+ The alignment that offsets must have to use unbuffered IO.  This is a
+ multiple of any common sector size.
+ */
+#define SPLIT_UNBUFFERED_ALIGNMENT (4096)
+
+/**
+ State shared between threads which are splitting a file into parts.
+ */
+typedef struct _SPLIT_FILE_CONTEXT {
+
+    /**
+     Pointer to the context describing the split operation.
+     */
+    PSPLIT_CONTEXT SplitContext;
+
+    /**
+     Handle to the source file, opened for overlapped IO.
+     */
+    HANDLE SourceHandle;
+
+    /**
+     The number of parts to create.
+     */
+    YORI_MAX_SIGNED_T PartCount;
+
+    /**
+     The index of the next part for a thread to create.
+     */
+    volatile LONG NextPart;
+
+    /**
+     The first error encountered by any thread, or ERROR_SUCCESS.  Once set,
+     threads stop creating parts.
+     */
+    volatile LONG Error;
+
+} SPLIT_FILE_CONTEXT, *PSPLIT_FILE_CONTEXT;
+
 /**
  Open a file in which to output the result of a fragment of the split
  operation.
 
- @param SplitContext Pointer to a context describing the split operation
-        and its current state.
+ @param SplitContext Pointer to a context describing the split operation.
+
+ @param PartNumber The number of the part to open.
+
+ @param Flags Additional flags to open the file with, such as
+        FILE_FLAG_OVERLAPPED.
 
  @return Handle to the opened object, or NULL on failure.
  */
 HANDLE
-SplitOpenTargetForCurrentPart(
-    __in PSPLIT_CONTEXT SplitContext
+SplitOpenTargetForPart(
+    __in PSPLIT_CONTEXT SplitContext,
+    __in YORI_MAX_SIGNED_T PartNumber,
+    __in DWORD Flags
     )
 {
     LPTSTR NewFileName;
@@ -110,7 +168,7 @@ SplitOpenTargetForCurrentPart(
     HANDLE hDestFile;
 
     YoriLibInitEmptyString(&NumberString);
-    if (!YoriLibNumberToString(&NumberString, SplitContext->CurrentPartNumber, 10, 0, '\0')) {
+    if (!YoriLibNumberToString(&NumberString, PartNumber, 10, 0, '\0')) {
         return NULL;
     }
 
@@ -128,7 +186,7 @@ SplitOpenTargetForCurrentPart(
                            FILE_SHARE_READ|FILE_SHARE_DELETE,
                            NULL,
                            CREATE_ALWAYS,
-                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | Flags,
                            NULL);
     if (hDestFile == INVALID_HANDLE_VALUE) {
         DWORD LastError = GetLastError();
@@ -143,6 +201,192 @@ SplitOpenTargetForCurrentPart(
     return hDestFile;
 }
 
+/**
+ Open a file in which to output the result of the next fragment of the
+ split operation, and advance to the following fragment.
+
+ @param SplitContext Pointer to a context describing the split operation
+        and its current state.
+
+ @return Handle to the opened object, or NULL on failure.
+ */
+HANDLE
+SplitOpenTargetForCurrentPart(
+    __in PSPLIT_CONTEXT SplitContext
+    )
+{
+    HANDLE hDestFile;
+
+    hDestFile = SplitOpenTargetForPart(SplitContext, SplitContext->CurrentPartNumber, 0);
+    if (hDestFile != NULL) {
+        SplitContext->CurrentPartNumber++;
+    }
+    return hDestFile;
+}
+
+/**
+ A thread which copies parts of a file into part files until all parts
+ have been created or an error occurs.
+
+ @param Context Pointer to the state shared between threads.
+
+ @return Zero.
+ */
+DWORD WINAPI
+SplitFilePartThread(
+    __in LPVOID Context
+    )
+{
+    PSPLIT_FILE_CONTEXT FileContext;
+    PSPLIT_CONTEXT SplitContext;
+    YORI_LIB_COPY_DATA_PARAMS Params;
+    YORI_MAX_SIGNED_T PartNumber;
+    HANDLE hDestFile;
+    DWORD Flags;
+    DWORD Err;
+    LPTSTR ErrText;
+
+    FileContext = (PSPLIT_FILE_CONTEXT)Context;
+    SplitContext = FileContext->SplitContext;
+
+    Flags = FILE_FLAG_OVERLAPPED;
+    if (SplitContext->Unbuffered) {
+        Flags = Flags | FILE_FLAG_NO_BUFFERING;
+    }
+
+    while (FileContext->Error == ERROR_SUCCESS) {
+        PartNumber = InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&FileContext->NextPart) - 1;
+        if (PartNumber >= FileContext->PartCount) {
+            break;
+        }
+
+        hDestFile = SplitOpenTargetForPart(SplitContext, SplitContext->CurrentPartNumber + PartNumber, Flags);
+        if (hDestFile == NULL) {
+            InterlockedCompareExchange((INTERLOCKED_VOLATILE LONG *)&FileContext->Error, ERROR_OPEN_FAILED, ERROR_SUCCESS);
+            break;
+        }
+
+        ZeroMemory(&Params, sizeof(Params));
+        Params.SourceOffset.QuadPart = PartNumber * SplitContext->BytesPerPart;
+        Params.MaximumLength.QuadPart = SplitContext->BytesPerPart;
+
+        Err = YoriLibCopyFileData(FileContext->SourceHandle, hDestFile, &Params);
+        CloseHandle(hDestFile);
+
+        if (Err != ERROR_SUCCESS) {
+            ErrText = YoriLibGetWinErrorText(Err);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: write failed: %s"), ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            InterlockedCompareExchange((INTERLOCKED_VOLATILE LONG *)&FileContext->Error, Err, ERROR_SUCCESS);
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ Split a file into parts of a fixed number of bytes.  Each part is copied
+ with several reads and writes in flight, and several parts are written
+ at the same time.
+
+ @param FilePath Pointer to the full path to the file to split.
+
+ @param SplitContext Pointer to a context describing the actions to perform.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SplitProcessFile(
+    __in PYORI_STRING FilePath,
+    __in PSPLIT_CONTEXT SplitContext
+    )
+{
+    SPLIT_FILE_CONTEXT FileContext;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    LARGE_INTEGER FileSize;
+    HANDLE Threads[SPLIT_MAX_CONCURRENT_PARTS];
+    DWORD ThreadCount;
+    DWORD ThreadId;
+    DWORD Flags;
+    DWORD Index;
+
+    //
+    //  Unbuffered reads need each part to start on an aligned offset.
+    //
+
+    if (SplitContext->Unbuffered &&
+        (SplitContext->BytesPerPart % SPLIT_UNBUFFERED_ALIGNMENT) != 0) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: bytes per part is not a multiple of %i, not using unbuffered IO\n"), SPLIT_UNBUFFERED_ALIGNMENT);
+        SplitContext->Unbuffered = FALSE;
+    }
+
+    Flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED;
+    if (SplitContext->Unbuffered) {
+        Flags = Flags | FILE_FLAG_NO_BUFFERING;
+    }
+
+    ZeroMemory(&FileContext, sizeof(FileContext));
+    FileContext.SplitContext = SplitContext;
+    FileContext.SourceHandle = CreateFile(FilePath->StartOfString,
+                                          GENERIC_READ,
+                                          FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                          NULL,
+                                          OPEN_EXISTING,
+                                          Flags,
+                                          NULL);
+
+    if (FileContext.SourceHandle == INVALID_HANDLE_VALUE) {
+        DWORD LastError = GetLastError();
+        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: open of %y failed: %s"), FilePath, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    if (!GetFileInformationByHandle(FileContext.SourceHandle, &FileInfo)) {
+        CloseHandle(FileContext.SourceHandle);
+        return FALSE;
+    }
+
+    FileSize.LowPart = FileInfo.nFileSizeLow;
+    FileSize.HighPart = FileInfo.nFileSizeHigh;
+    FileContext.PartCount = (FileSize.QuadPart + SplitContext->BytesPerPart - 1) / SplitContext->BytesPerPart;
+    FileContext.Error = ERROR_SUCCESS;
+
+    ThreadCount = 0;
+    for (Index = 0; Index < SPLIT_MAX_CONCURRENT_PARTS && Index < FileContext.PartCount; Index++) {
+        Threads[ThreadCount] = CreateThread(NULL, 0, SplitFilePartThread, &FileContext, 0, &ThreadId);
+        if (Threads[ThreadCount] == NULL) {
+            break;
+        }
+        ThreadCount++;
+    }
+
+    //
+    //  If no thread could be created, do the work on this one.
+    //
+
+    if (ThreadCount == 0) {
+        SplitFilePartThread(&FileContext);
+    } else {
+        WaitForMultipleObjects(ThreadCount, Threads, TRUE, INFINITE);
+        for (Index = 0; Index < ThreadCount; Index++) {
+            CloseHandle(Threads[Index]);
+        }
+    }
+
+    CloseHandle(FileContext.SourceHandle);
+
+    if (FileContext.Error != ERROR_SUCCESS) {
+        return FALSE;
+    }
+
+    SplitContext->CurrentPartNumber = SplitContext->CurrentPartNumber + FileContext.PartCount;
+    return TRUE;
+}
+
 /**
  Take a single incoming stream and break it into pieces.
 
@@ -187,7 +431,6 @@ SplitProcessStream(
                     YoriLibFreeStringContents(&LineString);
                     return FALSE;
                 }
-                SplitContext->CurrentPartNumber++;
             }
 
             YoriLibOutputToDevice(hDestFile, 0, _T("%y\n"), &LineString);
@@ -197,16 +440,34 @@ SplitProcessStream(
         YoriLibLineReadCloseOrCache(LineContext);
         YoriLibFreeStringContents(&LineString);
     } else {
-        PVOID Buffer;
-        ULONG BytesRead;
+        PUCHAR Buffer;
+        YORI_ALLOC_SIZE_T BufferSize;
+        DWORD BytesRead;
+        DWORD BytesToRead;
+        DWORD BytesWritten;
+        YORI_MAX_SIGNED_T PartRemaining;
 
-        Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)SplitContext->BytesPerPart);
+        //
+        //  Parts may be larger than memory allows, so data is moved through
+        //  a fixed size buffer and each part is closed once it has received
+        //  enough bytes.
+        //
+
+        BufferSize = YoriLibMaximumAllocationInRange(60 * 1024, 1024 * 1024);
+        Buffer = YoriLibMalloc(BufferSize);
         if (Buffer == NULL) {
             return FALSE;
         }
 
+        PartRemaining = 0;
+
         while (TRUE) {
-            if (!ReadFile(hSource, Buffer, (YORI_ALLOC_SIZE_T)SplitContext->BytesPerPart, &BytesRead, NULL)) {
+            BytesToRead = BufferSize;
+            if (hDestFile != NULL && PartRemaining < BytesToRead) {
+                BytesToRead = (DWORD)PartRemaining;
+            }
+
+            if (!ReadFile(hSource, Buffer, BytesToRead, &BytesRead, NULL)) {
                 break;
             }
 
@@ -214,23 +475,56 @@ SplitProcessStream(
                 break;
             }
 
-            hDestFile = SplitOpenTargetForCurrentPart(SplitContext);
             if (hDestFile == NULL) {
-                YoriLibFree(Buffer);
-                return FALSE;
+                hDestFile = SplitOpenTargetForCurrentPart(SplitContext);
+                if (hDestFile == NULL) {
+                    YoriLibFree(Buffer);
+                    return FALSE;
+                }
+                PartRemaining = SplitContext->BytesPerPart;
             }
-            SplitContext->CurrentPartNumber++;
-
-            if (!WriteFile(hDestFile, Buffer, BytesRead, &BytesRead, NULL)) {
-                DWORD LastError = GetLastError();
-                LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: write failed: %s"), ErrText);
-                YoriLibFreeWinErrorText(ErrText);
-                CloseHandle(hDestFile);
-                YoriLibFree(Buffer);
-                return FALSE;
+
+            //
+            //  A part that has just been opened may be smaller than the
+            //  buffer, so the data read can need more than one part.
+            //
+
+            BytesToRead = 0;
+            while (BytesToRead < BytesRead) {
+                BytesWritten = BytesRead - BytesToRead;
+                if (PartRemaining < BytesWritten) {
+                    BytesWritten = (DWORD)PartRemaining;
+                }
+
+                if (!WriteFile(hDestFile, Buffer + BytesToRead, BytesWritten, &BytesWritten, NULL)) {
+                    DWORD LastError = GetLastError();
+                    LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: write failed: %s"), ErrText);
+                    YoriLibFreeWinErrorText(ErrText);
+                    CloseHandle(hDestFile);
+                    YoriLibFree(Buffer);
+                    return FALSE;
+                }
+
+                BytesToRead = BytesToRead + BytesWritten;
+                PartRemaining = PartRemaining - BytesWritten;
+
+                if (PartRemaining == 0) {
+                    CloseHandle(hDestFile);
+                    hDestFile = NULL;
+                    if (BytesToRead < BytesRead) {
+                        hDestFile = SplitOpenTargetForCurrentPart(SplitContext);
+                        if (hDestFile == NULL) {
+                            YoriLibFree(Buffer);
+                            return FALSE;
+                        }
+                        PartRemaining = SplitContext->BytesPerPart;
+                    }
+                }
             }
+        }
 
+        if (hDestFile != NULL) {
             CloseHandle(hDestFile);
         }
 
@@ -240,9 +534,59 @@ SplitProcessStream(
     return TRUE;
 }
 
+/**
+ Open the file that split files are joined into.
+
+ @param OutputFile Pointer to the string containing the name of the combined
+        file.
+
+ @param Disposition Specifies whether to create a new file or open the
+        existing one.
+
+ @param Unbuffered If TRUE, the file is opened with FILE_FLAG_NO_BUFFERING.
+
+ @return Handle to the opened file, or NULL on failure.
+ */
+HANDLE
+SplitOpenJoinTarget(
+    __in PYORI_STRING OutputFile,
+    __in DWORD Disposition,
+    __in BOOLEAN Unbuffered
+    )
+{
+    HANDLE TargetHandle;
+    DWORD Flags;
+    DWORD LastError;
+    LPTSTR ErrText;
+
+    Flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED;
+    if (Unbuffered) {
+        Flags = Flags | FILE_FLAG_NO_BUFFERING;
+    }
+
+    TargetHandle = CreateFile(OutputFile->StartOfString,
+                              GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_DELETE,
+                              NULL,
+                              Disposition,
+                              Flags,
+                              NULL);
+
+    if (TargetHandle == NULL || TargetHandle == INVALID_HANDLE_VALUE) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: open of %y failed: %s"), OutputFile, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return NULL;
+    }
+
+    return TargetHandle;
+}
+
 /**
  Join a series of files with a given prefix back into a single file.  This is
- the inverse of split.
+ the inverse of split.  Each part is copied with several reads and writes in
+ flight.
 
  @param Prefix Pointer to the string containing the prefix name of the set of
         files.
@@ -250,58 +594,54 @@ SplitProcessStream(
  @param OutputFile Pointer to the string containing the name of the combined
         file to generate.
 
+ @param Unbuffered If TRUE, use unbuffered IO.  The combined file is only
+        written unbuffered while every part so far has been a multiple of
+        the sector size.
+
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 SplitJoin(
     __in PYORI_STRING Prefix,
-    __in PYORI_STRING OutputFile
+    __in PYORI_STRING OutputFile,
+    __in BOOLEAN Unbuffered
     )
 {
     HANDLE SourceHandle;
     HANDLE TargetHandle;
-    PUCHAR Buffer;
-    DWORD BytesRead;
-    YORI_ALLOC_SIZE_T BytesAllocated;
+    YORI_LIB_COPY_DATA_PARAMS Params;
+    BY_HANDLE_FILE_INFORMATION SourceInfo;
+    LARGE_INTEGER SourceSize;
+    LARGE_INTEGER DestOffset;
     YORI_MAX_SIGNED_T CurrentFragment;
     LPTSTR FragmentFileName;
     YORI_STRING NumberString;
+    BOOLEAN TargetUnbuffered;
+    DWORD Flags;
     DWORD LastError;
     LPTSTR ErrText;
 
     ASSERT(YoriLibIsStringNullTerminated(OutputFile));
 
-    BytesAllocated = YoriLibMaximumAllocationInRange(60 * 1024, 256 * 1024);
-    Buffer = YoriLibMalloc(BytesAllocated);
-    if (Buffer == NULL) {
+    TargetUnbuffered = Unbuffered;
+    TargetHandle = SplitOpenJoinTarget(OutputFile, CREATE_ALWAYS, TargetUnbuffered);
+    if (TargetHandle == NULL) {
         return FALSE;
     }
 
-    TargetHandle = CreateFile(OutputFile->StartOfString,
-                              GENERIC_WRITE,
-                              FILE_SHARE_READ | FILE_SHARE_DELETE,
-                              NULL,
-                              CREATE_ALWAYS,
-                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
-                              NULL);
-
-    if (TargetHandle == NULL || TargetHandle == INVALID_HANDLE_VALUE) {
-        LastError = GetLastError();
-        ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: open of %y failed: %s"), OutputFile, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFree(Buffer);
-        return FALSE;
+    Flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED;
+    if (Unbuffered) {
+        Flags = Flags | FILE_FLAG_NO_BUFFERING;
     }
 
     CurrentFragment = 0;
+    DestOffset.QuadPart = 0;
 
     while(TRUE) {
 
         YoriLibInitEmptyString(&NumberString);
         if (!YoriLibNumberToString(&NumberString, CurrentFragment, 10, 0, '\0')) {
             CloseHandle(TargetHandle);
-            YoriLibFree(Buffer);
             return FALSE;
         }
 
@@ -309,7 +649,6 @@ SplitJoin(
         if (FragmentFileName == NULL) {
             YoriLibFreeStringContents(&NumberString);
             CloseHandle(TargetHandle);
-            YoriLibFree(Buffer);
             return FALSE;
         }
 
@@ -321,7 +660,7 @@ SplitJoin(
                                   FILE_SHARE_READ|FILE_SHARE_DELETE,
                                   NULL,
                                   OPEN_EXISTING,
-                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
+                                  Flags,
                                   NULL);
         if (SourceHandle == INVALID_HANDLE_VALUE) {
             LastError = GetLastError();
@@ -334,50 +673,59 @@ SplitJoin(
             YoriLibFreeWinErrorText(ErrText);
             YoriLibFree(FragmentFileName);
             CloseHandle(TargetHandle);
-            YoriLibFree(Buffer);
             return FALSE;
         }
 
-        while(TRUE) {
+        if (!GetFileInformationByHandle(SourceHandle, &SourceInfo)) {
+            LastError = GetLastError();
+            ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: query of %s failed: %s"), FragmentFileName, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            YoriLibFree(FragmentFileName);
+            CloseHandle(SourceHandle);
+            CloseHandle(TargetHandle);
+            return FALSE;
+        }
 
-            if (!ReadFile(SourceHandle, Buffer, BytesAllocated, &BytesRead, NULL)) {
-                LastError = GetLastError();
-                if (LastError == ERROR_HANDLE_EOF) {
-                    break;
-                }
-                ErrText = YoriLibGetWinErrorText(LastError);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: read of %s failed: %s"), FragmentFileName, ErrText);
-                YoriLibFreeWinErrorText(ErrText);
-                YoriLibFree(FragmentFileName);
-                CloseHandle(TargetHandle);
-                CloseHandle(SourceHandle);
-                YoriLibFree(Buffer);
-                return FALSE;
-            }
+        SourceSize.LowPart = SourceInfo.nFileSizeLow;
+        SourceSize.HighPart = SourceInfo.nFileSizeHigh;
 
-            if (BytesRead == 0) {
-                break;
-            }
+        //
+        //  If an earlier part was not a multiple of the sector size, this
+        //  part can't be written unbuffered, so reopen the target.
+        //
 
-            if (!WriteFile(TargetHandle, Buffer, BytesRead, &BytesRead, NULL)) {
-                LastError = GetLastError();
-                ErrText = YoriLibGetWinErrorText(LastError);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: write to %y failed: %s"), OutputFile, ErrText);
-                YoriLibFreeWinErrorText(ErrText);
+        if (TargetUnbuffered && (DestOffset.QuadPart % SPLIT_UNBUFFERED_ALIGNMENT) != 0) {
+            CloseHandle(TargetHandle);
+            TargetUnbuffered = FALSE;
+            TargetHandle = SplitOpenJoinTarget(OutputFile, OPEN_EXISTING, TargetUnbuffered);
+            if (TargetHandle == NULL) {
                 YoriLibFree(FragmentFileName);
-                CloseHandle(TargetHandle);
                 CloseHandle(SourceHandle);
-                YoriLibFree(Buffer);
                 return FALSE;
             }
         }
 
+        ZeroMemory(&Params, sizeof(Params));
+        Params.DestOffset.QuadPart = DestOffset.QuadPart;
+
+        LastError = YoriLibCopyFileData(SourceHandle, TargetHandle, &Params);
+        if (LastError != ERROR_SUCCESS) {
+            ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: copy of %s to %y failed: %s"), FragmentFileName, OutputFile, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            YoriLibFree(FragmentFileName);
+            CloseHandle(TargetHandle);
+            CloseHandle(SourceHandle);
+            return FALSE;
+        }
+
+        DestOffset.QuadPart = DestOffset.QuadPart + SourceSize.QuadPart;
         CloseHandle(SourceHandle);
         YoriLibFree(FragmentFileName);
         CurrentFragment++;
     }
 
-    YoriLibFree(Buffer);
     CloseHandle(TargetHandle);
     return TRUE;
 }
@@ -431,7 +779,7 @@ ENTRYPOINT(
                 SplitHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2018-2019"));
+                YoriLibDisplayMitLicense(_T("2018-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 if (ArgC > i + 1) {
@@ -461,6 +809,9 @@ ENTRYPOINT(
                     }
                     i++;
                 }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("u")) == 0) {
+                SplitContext.Unbuffered = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 StartArg = i + 1;
                 ArgumentUnderstood = TRUE;
@@ -505,7 +856,7 @@ ENTRYPOINT(
             return EXIT_FAILURE;
         }
 
-        if (!SplitJoin(&SplitContext.Prefix, &ArgV[StartArg])) {
+        if (!SplitJoin(&SplitContext.Prefix, &ArgV[StartArg], SplitContext.Unbuffered)) {
             Result = EXIT_FAILURE;
         }
     } else {
@@ -515,7 +866,7 @@ ENTRYPOINT(
                 Result = EXIT_FAILURE;
             }
         } else {
-            if (SplitContext.BytesPerPart == 0 || SplitContext.BytesPerPart >= YORI_MAX_ALLOC_SIZE) {
+            if (SplitContext.BytesPerPart <= 0) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: invalid bytes per part\n"));
                 Result = EXIT_FAILURE;
             }
@@ -552,6 +903,7 @@ ENTRYPOINT(
             HANDLE FileHandle;
             YORI_STRING FilePath;
 
+            YoriLibInitEmptyString(&FilePath);
             if (!YoriLibUserStringToSingleFilePath(&ArgV[StartArg], TRUE, &FilePath)) {
                 Result = EXIT_FAILURE;
             }
@@ -573,16 +925,28 @@ ENTRYPOINT(
                     YoriLibFreeWinErrorText(ErrText);
                     Result = EXIT_FAILURE;
                 }
-
-                YoriLibFreeStringContents(&FilePath);
             }
 
+            //
+            //  Files split by bytes are copied in parts by offset.  Other
+            //  objects, or splitting by lines, are read as a stream.
+            //
+
             if (Result == EXIT_SUCCESS) {
-                if (!SplitProcessStream(FileHandle, &SplitContext)) {
-                    Result = EXIT_FAILURE;
+                if (!SplitContext.LinesMode && GetFileType(FileHandle) == FILE_TYPE_DISK) {
+                    CloseHandle(FileHandle);
+                    if (!SplitProcessFile(&FilePath, &SplitContext)) {
+                        Result = EXIT_FAILURE;
+                    }
+                } else {
+                    if (!SplitProcessStream(FileHandle, &SplitContext)) {
+                        Result = EXIT_FAILURE;
+                    }
+                    CloseHandle(FileHandle);
                 }
-                CloseHandle(FileHandle);
             }
+
+            YoriLibFreeStringContents(&FilePath);
         }
         YoriLibFreeStringContents(&SplitContext.Prefix);
     }
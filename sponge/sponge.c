@@ -3,7 +3,7 @@
  *
  * Yori shell load standard input into memory and output once load complete
  *
- * Copyright (c) 2019 Malcolm J. Smith
+ * Copyright (c) 2019-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -36,7 +36,10 @@ CHAR strSpongeHelpText[] =
         "Read input into memory and output once all input is read,\n"
         "  allowing the output to modify the source stream.\n"
         "\n"
-        "SPONGE [-license] [file]\n"
+        "SPONGE [-license] [-m <size>] [file]\n"
+        "\n"
+        "   -m <size>      Hold up to this much input in memory before using a\n"
+        "                  temporary file, default 64Mb\n"
         ;
 
 /**
@@ -53,6 +56,23 @@ SpongeHelp(VOID)
     return TRUE;
 }
 
+/**
+ The default number of bytes to hold in memory before moving data to a
+ temporary file.
+ */
+#define SPONGE_DEFAULT_SPILL_THRESHOLD (64 * 1024 * 1024)
+
+/**
+ The minimum number of bytes to make available for each read from the
+ source.
+ */
+#define SPONGE_READ_SIZE (16384)
+
+/**
+ The size of each read when replaying data from a temporary file.
+ */
+#define SPONGE_SPILL_READ_SIZE (1024 * 1024)
+
 /**
  A buffer for a single data stream.
  */
@@ -64,12 +84,148 @@ typedef struct _SPONGE_BUFFER {
     HANDLE hSource;
 
     /**
-     The data buffer.
+     The data buffer.  Once a temporary file is in use, this contains data
+     that follows the data in the file.
      */
     YORI_LIB_BYTE_BUFFER ByteBuffer;
 
+    /**
+     A handle to a temporary file opened for overlapped IO that holds the
+     start of the stream, or NULL if all data is in memory.  The file is
+     deleted when this handle is closed.
+     */
+    HANDLE hSpill;
+
+    /**
+     An event used to wait for IO to the temporary file.
+     */
+    HANDLE SpillEvent;
+
+    /**
+     The number of bytes written to the temporary file.
+     */
+    DWORDLONG SpillLength;
+
+    /**
+     The number of bytes to hold in memory before writing them to the
+     temporary file.
+     */
+    DWORDLONG SpillThreshold;
+
 } SPONGE_BUFFER, *PSPONGE_BUFFER;
 
+/**
+ Create the temporary file used to hold data that exceeds the memory
+ threshold.
+
+ @param ThisBuffer A pointer to the process buffer set.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+SpongeCreateSpillFile(
+    __in PSPONGE_BUFFER ThisBuffer
+    )
+{
+    YORI_STRING TempPath;
+    YORI_STRING Prefix;
+    YORI_STRING TempName;
+
+    if (!YoriLibGetTempPath(&TempPath, 0)) {
+        return FALSE;
+    }
+
+    YoriLibConstantString(&Prefix, _T("SPG"));
+    if (!YoriLibGetTempFileName(&TempPath, &Prefix, NULL, &TempName)) {
+        YoriLibFreeStringContents(&TempPath);
+        return FALSE;
+    }
+    YoriLibFreeStringContents(&TempPath);
+
+    ThisBuffer->SpillEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (ThisBuffer->SpillEvent == NULL) {
+        DeleteFile(TempName.StartOfString);
+        YoriLibFreeStringContents(&TempName);
+        return FALSE;
+    }
+
+    ThisBuffer->hSpill = CreateFile(TempName.StartOfString,
+                                    GENERIC_READ | GENERIC_WRITE,
+                                    FILE_SHARE_DELETE,
+                                    NULL,
+                                    CREATE_ALWAYS,
+                                    FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE | FILE_FLAG_OVERLAPPED,
+                                    NULL);
+
+    if (ThisBuffer->hSpill == INVALID_HANDLE_VALUE) {
+        ThisBuffer->hSpill = NULL;
+        DeleteFile(TempName.StartOfString);
+        YoriLibFreeStringContents(&TempName);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&TempName);
+    return TRUE;
+}
+
+/**
+ Move all data currently held in memory to the end of the temporary file,
+ creating the file if it does not exist yet.  The data is written with as
+ few calls as the memory buffer allows.
+
+ @param ThisBuffer A pointer to the process buffer set.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+SpongeSpillToFile(
+    __in PSPONGE_BUFFER ThisBuffer
+    )
+{
+    YORI_MAX_UNSIGNED_T BytesSpilled;
+    YORI_MAX_UNSIGNED_T BytesPopulated;
+    PUCHAR SrcBuffer;
+    YORI_ALLOC_SIZE_T BytesToWrite;
+    DWORD BytesWritten;
+    OVERLAPPED Overlapped;
+
+    if (ThisBuffer->hSpill == NULL) {
+        if (!SpongeCreateSpillFile(ThisBuffer)) {
+            return FALSE;
+        }
+    }
+
+    BytesSpilled = 0;
+    BytesPopulated = YoriLibByteBufferGetValidBytes(&ThisBuffer->ByteBuffer);
+
+    while (BytesSpilled < BytesPopulated) {
+        SrcBuffer = YoriLibByteBufferGetPointerToValidData(&ThisBuffer->ByteBuffer, BytesSpilled, &BytesToWrite);
+
+        ZeroMemory(&Overlapped, sizeof(Overlapped));
+        Overlapped.Offset = (DWORD)ThisBuffer->SpillLength;
+        Overlapped.OffsetHigh = (DWORD)(ThisBuffer->SpillLength >> 32);
+        Overlapped.hEvent = ThisBuffer->SpillEvent;
+
+        if (!WriteFile(ThisBuffer->hSpill, SrcBuffer, BytesToWrite, NULL, &Overlapped) &&
+            GetLastError() != ERROR_IO_PENDING) {
+
+            return FALSE;
+        }
+
+        if (!GetOverlappedResult(ThisBuffer->hSpill, &Overlapped, &BytesWritten, TRUE) ||
+            BytesWritten == 0) {
+
+            return FALSE;
+        }
+
+        BytesSpilled = BytesSpilled + BytesWritten;
+        ThisBuffer->SpillLength = ThisBuffer->SpillLength + BytesWritten;
+    }
+
+    YoriLibByteBufferReset(&ThisBuffer->ByteBuffer);
+    return TRUE;
+}
+
 /**
  Populate data from stdin into an in memory buffer.
 
@@ -89,9 +245,26 @@ SpongeBufferPump(
 
     while (TRUE) {
 
-        WriteBuffer = YoriLibByteBufferGetPointerToEnd(&ThisBuffer->ByteBuffer, 16384, &BytesAvailable);
+        //
+        //  Once the memory threshold is reached, or memory can't be
+        //  extended, move what has been read so far to disk and keep
+        //  going.
+        //
+
+        if (YoriLibByteBufferGetValidBytes(&ThisBuffer->ByteBuffer) >= ThisBuffer->SpillThreshold) {
+            if (!SpongeSpillToFile(ThisBuffer)) {
+                break;
+            }
+        }
+
+        WriteBuffer = YoriLibByteBufferGetPointerToEnd(&ThisBuffer->ByteBuffer, SPONGE_READ_SIZE, &BytesAvailable);
         if (WriteBuffer == NULL) {
-            break;
+            if (YoriLibByteBufferGetValidBytes(&ThisBuffer->ByteBuffer) == 0 ||
+                !SpongeSpillToFile(ThisBuffer)) {
+
+                break;
+            }
+            continue;
         }
 
         if (ReadFile(ThisBuffer->hSource,
@@ -115,6 +288,127 @@ SpongeBufferPump(
     return Result;
 }
 
+/**
+ Output the contents of the temporary file to a stream.  Two buffers are
+ used so that the next read from the file is in flight while the previous
+ one is being written.
+
+ @param ThisBuffer Pointer to the buffer to output.
+
+ @param hTarget Handle to the target stream to output the buffer to.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+SpongeSpillForward(
+    __in PSPONGE_BUFFER ThisBuffer,
+    __in HANDLE hTarget
+    )
+{
+    PUCHAR Buffers[2];
+    OVERLAPPED Overlapped[2];
+    HANDLE ReadEvent;
+    DWORDLONG ReadOffset;
+    DWORD BytesRead;
+    DWORD BytesWritten;
+    DWORD BytesToRead;
+    DWORD Index;
+    DWORD Current;
+    BOOLEAN ReadPending[2];
+    BOOLEAN Result;
+
+    Buffers[0] = YoriLibMalloc(SPONGE_SPILL_READ_SIZE * 2);
+    if (Buffers[0] == NULL) {
+        return FALSE;
+    }
+    Buffers[1] = Buffers[0] + SPONGE_SPILL_READ_SIZE;
+
+    ReadEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (ReadEvent == NULL) {
+        YoriLibFree(Buffers[0]);
+        return FALSE;
+    }
+
+    Result = TRUE;
+    ReadOffset = 0;
+    ReadPending[0] = FALSE;
+    ReadPending[1] = FALSE;
+    Current = 0;
+
+    while (TRUE) {
+
+        //
+        //  Keep a read in flight for each buffer that is not waiting to be
+        //  written.
+        //
+
+        for (Index = 0; Index < 2; Index++) {
+            if (ReadPending[Index] || ReadOffset >= ThisBuffer->SpillLength) {
+                continue;
+            }
+
+            BytesToRead = SPONGE_SPILL_READ_SIZE;
+            if (ThisBuffer->SpillLength - ReadOffset < BytesToRead) {
+                BytesToRead = (DWORD)(ThisBuffer->SpillLength - ReadOffset);
+            }
+
+            ZeroMemory(&Overlapped[Index], sizeof(OVERLAPPED));
+            Overlapped[Index].Offset = (DWORD)ReadOffset;
+            Overlapped[Index].OffsetHigh = (DWORD)(ReadOffset >> 32);
+            Overlapped[Index].hEvent = (Index == 0)?ThisBuffer->SpillEvent:ReadEvent;
+
+            if (!ReadFile(ThisBuffer->hSpill, Buffers[Index], BytesToRead, NULL, &Overlapped[Index]) &&
+                GetLastError() != ERROR_IO_PENDING) {
+
+                Result = FALSE;
+                break;
+            }
+
+            ReadPending[Index] = TRUE;
+            ReadOffset = ReadOffset + BytesToRead;
+        }
+
+        if (!ReadPending[Current]) {
+            break;
+        }
+
+        ReadPending[Current] = FALSE;
+        if (!GetOverlappedResult(ThisBuffer->hSpill, &Overlapped[Current], &BytesRead, TRUE) ||
+            BytesRead == 0) {
+
+            Result = FALSE;
+            break;
+        }
+
+        if (Result &&
+            !WriteFile(hTarget, Buffers[Current], BytesRead, &BytesWritten, NULL)) {
+
+            Result = FALSE;
+        }
+
+        if (!Result) {
+            break;
+        }
+
+        Current = 1 - Current;
+    }
+
+    //
+    //  If anything failed, wait for outstanding reads before their buffers
+    //  are freed.
+    //
+
+    for (Index = 0; Index < 2; Index++) {
+        if (ReadPending[Index]) {
+            GetOverlappedResult(ThisBuffer->hSpill, &Overlapped[Index], &BytesRead, TRUE);
+        }
+    }
+
+    CloseHandle(ReadEvent);
+    YoriLibFree(Buffers[0]);
+    return Result;
+}
+
 /**
  Output the collected buffer to a stream.
 
@@ -139,6 +433,12 @@ SpongeBufferForward(
     BytesSent = 0;
     Result = TRUE;
 
+    if (ThisBuffer->hSpill != NULL) {
+        if (!SpongeSpillForward(ThisBuffer, hTarget)) {
+            return FALSE;
+        }
+    }
+
     BytesPopulated = YoriLibByteBufferGetValidBytes(&ThisBuffer->ByteBuffer);
 
     while (BytesSent < BytesPopulated) {
@@ -164,17 +464,31 @@ SpongeBufferForward(
 }
 
 /**
- Allocate and initialize a buffer for an input stream.
+ Allocate and initialize a buffer for an input stream.  Since data is moved
+ to a temporary file once the spill threshold is reached, the buffer never
+ needs to hold much more than that, so address space for it is reserved up
+ front and the buffer grows without copying.
 
  @param Buffer Pointer to the buffer to allocate structures for.
 
+ @param SpillThreshold The number of bytes to hold in memory before writing
+        them to a temporary file.
+
  @return TRUE if the buffer is successfully initialized, FALSE if it is not.
  */
 BOOL
 SpongeAllocateBuffer(
-    __out PSPONGE_BUFFER Buffer
+    __out PSPONGE_BUFFER Buffer,
+    __in DWORDLONG SpillThreshold
     )
 {
+    Buffer->hSpill = NULL;
+    Buffer->SpillEvent = NULL;
+    Buffer->SpillLength = 0;
+    Buffer->SpillThreshold = SpillThreshold;
+    if (YoriLibByteBufferInitializeReserved(&Buffer->ByteBuffer, SpillThreshold + SPONGE_READ_SIZE)) {
+        return TRUE;
+    }
     return YoriLibByteBufferInitialize(&Buffer->ByteBuffer, 1024);
 }
 
@@ -189,6 +503,14 @@ SpongeFreeBuffer(
     )
 {
     YoriLibByteBufferCleanup(&Buffer->ByteBuffer);
+    if (Buffer->hSpill != NULL) {
+        CloseHandle(Buffer->hSpill);
+        Buffer->hSpill = NULL;
+    }
+    if (Buffer->SpillEvent != NULL) {
+        CloseHandle(Buffer->SpillEvent);
+        Buffer->SpillEvent = NULL;
+    }
 }
 
 
@@ -227,8 +549,10 @@ ENTRYPOINT(
     SPONGE_BUFFER SpongeBuffer;
     YORI_STRING FullFilePath;
     HANDLE hTarget;
+    LARGE_INTEGER SpillThreshold;
 
     ZeroMemory(&SpongeBuffer, sizeof(SpongeBuffer));
+    SpillThreshold.QuadPart = SPONGE_DEFAULT_SPILL_THRESHOLD;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -242,6 +566,12 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
                 YoriLibDisplayMitLicense(_T("2019"));
                 return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("m")) == 0) {
+                if (i + 1 < ArgC) {
+                    YoriLibStringToFileSize(&ArgV[i + 1], &SpillThreshold);
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 ArgumentUnderstood = TRUE;
                 StartArg = i + 1;
@@ -267,7 +597,7 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
-    if (!SpongeAllocateBuffer(&SpongeBuffer)) {
+    if (!SpongeAllocateBuffer(&SpongeBuffer, SpillThreshold.QuadPart)) {
         return EXIT_FAILURE;
     }
     SpongeBuffer.hSource = GetStdHandle(STD_INPUT_HANDLE);
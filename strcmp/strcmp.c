@@ -263,6 +263,10 @@ ENTRYPOINT(
 
     YoriLibFreeStringContents(&Expression);
 
+#if !YORI_BUILTIN
+    YoriLibRegexMatchCleanupCache();
+#endif
+
     return Result;
 }
 
@@ -35,12 +35,13 @@ CHAR strSyncHelpText[] =
         "\n"
         "Flush files, directories or volumes to disk.\n"
         "\n"
-        "SYNC [-license] [-b] [-s] [-v] <file>...\n"
+        "SYNC [-license] [-b] [-q] [-r] [-s] [-t <sec>] [-v] <file>...\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -q             Query if the volume is in use, and flush if it is not in use\n"
         "   -r             Dismount and remount the volume\n"
         "   -s             Process files from all subdirectories\n"
+        "   -t <sec>       Stop waiting for flushes to complete after sec seconds\n"
         "   -v             Display verbose output\n";
 
 /**
@@ -57,6 +58,91 @@ SyncHelp(VOID)
     return TRUE;
 }
 
+/**
+ A single file or directory waiting to be flushed.
+ */
+typedef struct _SYNC_FILE {
+
+    /**
+     The entry for this file within the volume's list of pending files.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The full path to the file.  The characters follow this structure in
+     the same allocation.
+     */
+    YORI_STRING FilePath;
+} SYNC_FILE, *PSYNC_FILE;
+
+/**
+ A volume whose files are being flushed by a dedicated thread, so that a
+ slow volume does not delay flushing others.  This structure is referenced
+ by both the main thread and the volume's thread, and is freed by whichever
+ finishes with it last, which allows the main thread to stop waiting for a
+ volume which does not respond.
+ */
+typedef struct _SYNC_VOLUME {
+
+    /**
+     The entry for this volume within the context's list of volumes.  This
+     is only used by the main thread.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The list of files waiting to be flushed, protected by Mutex.
+     */
+    YORI_LIST_ENTRY PendingFiles;
+
+    /**
+     The path to the root of the volume.
+     */
+    YORI_STRING VolumePath;
+
+    /**
+     A mutex protecting the list of pending files and Shutdown.
+     */
+    HANDLE Mutex;
+
+    /**
+     A manual reset event signalled when files are pending or the thread
+     should exit.
+     */
+    HANDLE WorkAvailableEvent;
+
+    /**
+     The thread flushing files on this volume.
+     */
+    HANDLE Thread;
+
+    /**
+     The number of threads referencing this structure.
+     */
+    LONG ReferenceCount;
+
+    /**
+     Set to TRUE to indicate the thread should exit once no more files are
+     pending.
+     */
+    BOOLEAN Shutdown;
+
+    /**
+     If TRUE, display output for each object where sync is attempted.
+     */
+    BOOLEAN Verbose;
+
+    /**
+     The number of files that have been flushed on this volume.
+     */
+    DWORD FilesFlushed;
+
+    /**
+     The total time spent flushing files on this volume, in 100ns units.
+     */
+    LONGLONG ElapsedTime;
+} SYNC_VOLUME, *PSYNC_VOLUME;
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
@@ -86,8 +172,363 @@ typedef struct _SYNC_CONTEXT {
      */
     BOOL Verbose;
 
+    /**
+     The number of milliseconds to wait for all volumes to be flushed, or
+     INFINITE to wait until they are.
+     */
+    DWORD Timeout;
+
+    /**
+     The list of volumes that have files being flushed.
+     */
+    YORI_LIST_ENTRY Volumes;
+
 } SYNC_CONTEXT, *PSYNC_CONTEXT;
 
+/**
+ Flush a single file or directory to disk.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @param Verbose If TRUE, display the file being flushed.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SyncFlushFile(
+    __in PYORI_STRING FilePath,
+    __in BOOL Verbose
+    )
+{
+    HANDLE FileHandle;
+    DWORD LastError;
+    LPTSTR ErrText;
+
+    if (Verbose) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("sync: syncing %y\n"), FilePath);
+    }
+
+    FileHandle = CreateFile(FilePath->StartOfString,
+                            GENERIC_WRITE,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
+                            NULL);
+
+    if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: open of %y failed: %s"), FilePath, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    if (!FlushFileBuffers(FileHandle)) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: flush of %y failed: %s"), FilePath, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    CloseHandle(FileHandle);
+    return TRUE;
+}
+
+/**
+ Release a reference on a volume, freeing it when no references remain.
+
+ @param Volume Pointer to the volume.
+ */
+VOID
+SyncDereferenceVolume(
+    __in PSYNC_VOLUME Volume
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PSYNC_FILE File;
+
+    if (InterlockedDecrement(&Volume->ReferenceCount) != 0) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&Volume->PendingFiles, NULL);
+    while (ListEntry != NULL) {
+        File = CONTAINING_RECORD(ListEntry, SYNC_FILE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Volume->PendingFiles, ListEntry);
+        YoriLibRemoveListItem(&File->ListEntry);
+        YoriLibFree(File);
+    }
+
+    if (Volume->Mutex != NULL) {
+        CloseHandle(Volume->Mutex);
+    }
+    if (Volume->WorkAvailableEvent != NULL) {
+        CloseHandle(Volume->WorkAvailableEvent);
+    }
+    YoriLibFreeStringContents(&Volume->VolumePath);
+    YoriLibFree(Volume);
+}
+
+/**
+ A thread which flushes files on a single volume until told to exit.
+
+ @param Context Pointer to the volume.
+
+ @return Thread exit code, which is always zero.
+ */
+DWORD WINAPI
+SyncVolumeThread(
+    __in LPVOID Context
+    )
+{
+    PSYNC_VOLUME Volume;
+    PYORI_LIST_ENTRY ListEntry;
+    PSYNC_FILE File;
+    LONGLONG StartTime;
+
+    Volume = (PSYNC_VOLUME)Context;
+
+    while (TRUE) {
+        WaitForSingleObject(Volume->Mutex, INFINITE);
+        ListEntry = YoriLibGetNextListEntry(&Volume->PendingFiles, NULL);
+        if (ListEntry != NULL) {
+            YoriLibRemoveListItem(ListEntry);
+            ReleaseMutex(Volume->Mutex);
+
+            File = CONTAINING_RECORD(ListEntry, SYNC_FILE, ListEntry);
+            StartTime = YoriLibGetSystemTimeAsInteger();
+            SyncFlushFile(&File->FilePath, Volume->Verbose);
+            YoriLibFree(File);
+
+            WaitForSingleObject(Volume->Mutex, INFINITE);
+            Volume->ElapsedTime += YoriLibGetSystemTimeAsInteger() - StartTime;
+            Volume->FilesFlushed++;
+            ReleaseMutex(Volume->Mutex);
+            continue;
+        }
+
+        if (Volume->Shutdown) {
+            ReleaseMutex(Volume->Mutex);
+            break;
+        }
+
+        ResetEvent(Volume->WorkAvailableEvent);
+        ReleaseMutex(Volume->Mutex);
+        WaitForSingleObject(Volume->WorkAvailableEvent, INFINITE);
+    }
+
+    SyncDereferenceVolume(Volume);
+    return 0;
+}
+
+/**
+ Find the volume containing a file, starting a thread to flush files on the
+ volume if one has not already been started.
+
+ @param SyncContext Pointer to the sync context.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @return Pointer to the volume, or NULL if the volume could not be
+         determined or a thread could not be started.
+ */
+PSYNC_VOLUME
+SyncGetVolume(
+    __in PSYNC_CONTEXT SyncContext,
+    __in PYORI_STRING FilePath
+    )
+{
+    YORI_STRING VolumePath;
+    PYORI_LIST_ENTRY ListEntry;
+    PSYNC_VOLUME Volume;
+    DWORD ThreadId;
+
+    YoriLibInitEmptyString(&VolumePath);
+    if (!YoriLibGetVolumePathName(FilePath, &VolumePath)) {
+        return NULL;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&SyncContext->Volumes, NULL);
+    while (ListEntry != NULL) {
+        Volume = CONTAINING_RECORD(ListEntry, SYNC_VOLUME, ListEntry);
+        if (YoriLibCompareStringIns(&Volume->VolumePath, &VolumePath) == 0) {
+            YoriLibFreeStringContents(&VolumePath);
+            return Volume;
+        }
+        ListEntry = YoriLibGetNextListEntry(&SyncContext->Volumes, ListEntry);
+    }
+
+    Volume = YoriLibMalloc(sizeof(SYNC_VOLUME));
+    if (Volume == NULL) {
+        YoriLibFreeStringContents(&VolumePath);
+        return NULL;
+    }
+
+    ZeroMemory(Volume, sizeof(SYNC_VOLUME));
+    YoriLibInitializeListHead(&Volume->PendingFiles);
+    memcpy(&Volume->VolumePath, &VolumePath, sizeof(YORI_STRING));
+    Volume->ReferenceCount = 1;
+    Volume->Verbose = (BOOLEAN)SyncContext->Verbose;
+    Volume->Mutex = CreateMutex(NULL, FALSE, NULL);
+    Volume->WorkAvailableEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Volume->Mutex == NULL || Volume->WorkAvailableEvent == NULL) {
+        SyncDereferenceVolume(Volume);
+        return NULL;
+    }
+
+    Volume->ReferenceCount = 2;
+    Volume->Thread = CreateThread(NULL, 0, SyncVolumeThread, Volume, 0, &ThreadId);
+    if (Volume->Thread == NULL) {
+        Volume->ReferenceCount = 1;
+        SyncDereferenceVolume(Volume);
+        return NULL;
+    }
+
+    YoriLibAppendList(&SyncContext->Volumes, &Volume->ListEntry);
+    return Volume;
+}
+
+/**
+ Queue a file to be flushed by the thread for its volume.  If this is not
+ possible, the file is flushed immediately.
+
+ @param SyncContext Pointer to the sync context.
+
+ @param FilePath Pointer to the full path to the file.
+ */
+VOID
+SyncQueueFile(
+    __in PSYNC_CONTEXT SyncContext,
+    __in PYORI_STRING FilePath
+    )
+{
+    PSYNC_VOLUME Volume;
+    PSYNC_FILE File;
+
+    Volume = SyncGetVolume(SyncContext, FilePath);
+    if (Volume == NULL) {
+        SyncFlushFile(FilePath, SyncContext->Verbose);
+        return;
+    }
+
+    File = YoriLibMalloc(sizeof(SYNC_FILE) + (FilePath->LengthInChars + 1) * sizeof(TCHAR));
+    if (File == NULL) {
+        SyncFlushFile(FilePath, SyncContext->Verbose);
+        return;
+    }
+
+    YoriLibInitEmptyString(&File->FilePath);
+    File->FilePath.StartOfString = (LPTSTR)(File + 1);
+    File->FilePath.LengthInChars = FilePath->LengthInChars;
+    File->FilePath.LengthAllocated = FilePath->LengthInChars + 1;
+    memcpy(File->FilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    File->FilePath.StartOfString[FilePath->LengthInChars] = '\0';
+
+    WaitForSingleObject(Volume->Mutex, INFINITE);
+    YoriLibAppendList(&Volume->PendingFiles, &File->ListEntry);
+    SetEvent(Volume->WorkAvailableEvent);
+    ReleaseMutex(Volume->Mutex);
+}
+
+/**
+ Wait for the threads flushing each volume to complete, up to the timeout
+ specified by the user.  Volumes which do not complete in time are reported
+ and any files not yet flushed on them are discarded.
+
+ @param SyncContext Pointer to the sync context.
+
+ @return TRUE if all volumes completed, FALSE if any did not complete
+         within the timeout.
+ */
+BOOL
+SyncWaitForVolumes(
+    __in PSYNC_CONTEXT SyncContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PSYNC_VOLUME Volume;
+    PSYNC_FILE File;
+    LONGLONG StartTime;
+    LONGLONG Elapsed;
+    DWORD Remaining;
+    BOOL Result;
+
+    //
+    //  Tell every thread to exit once its queue is empty before waiting on
+    //  any of them, so the volumes finish concurrently.
+    //
+
+    ListEntry = YoriLibGetNextListEntry(&SyncContext->Volumes, NULL);
+    while (ListEntry != NULL) {
+        Volume = CONTAINING_RECORD(ListEntry, SYNC_VOLUME, ListEntry);
+        WaitForSingleObject(Volume->Mutex, INFINITE);
+        Volume->Shutdown = TRUE;
+        SetEvent(Volume->WorkAvailableEvent);
+        ReleaseMutex(Volume->Mutex);
+        ListEntry = YoriLibGetNextListEntry(&SyncContext->Volumes, ListEntry);
+    }
+
+    Result = TRUE;
+    StartTime = YoriLibGetSystemTimeAsInteger();
+    ListEntry = YoriLibGetNextListEntry(&SyncContext->Volumes, NULL);
+    while (ListEntry != NULL) {
+        Volume = CONTAINING_RECORD(ListEntry, SYNC_VOLUME, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&SyncContext->Volumes, ListEntry);
+
+        Remaining = INFINITE;
+        if (SyncContext->Timeout != INFINITE) {
+            Elapsed = (YoriLibGetSystemTimeAsInteger() - StartTime) / (10 * 1000);
+            Remaining = 0;
+            if (Elapsed < SyncContext->Timeout) {
+                Remaining = SyncContext->Timeout - (DWORD)Elapsed;
+            }
+        }
+
+        if (WaitForSingleObject(Volume->Thread, Remaining) == WAIT_OBJECT_0) {
+            if (SyncContext->Verbose) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                              _T("sync: flushed %i objects on %y in %lli ms\n"),
+                              Volume->FilesFlushed,
+                              &Volume->VolumePath,
+                              Volume->ElapsedTime / (10 * 1000));
+            }
+        } else {
+
+            //
+            //  The thread may still be flushing a file, but nothing more
+            //  should be flushed after returning.  The thread frees the
+            //  volume when it exits.
+            //
+
+            WaitForSingleObject(Volume->Mutex, INFINITE);
+            while (TRUE) {
+                PYORI_LIST_ENTRY FileEntry;
+                FileEntry = YoriLibGetNextListEntry(&Volume->PendingFiles, NULL);
+                if (FileEntry == NULL) {
+                    break;
+                }
+                File = CONTAINING_RECORD(FileEntry, SYNC_FILE, ListEntry);
+                YoriLibRemoveListItem(FileEntry);
+                YoriLibFree(File);
+            }
+            ReleaseMutex(Volume->Mutex);
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: flush of %y did not complete in time\n"), &Volume->VolumePath);
+            Result = FALSE;
+        }
+
+        YoriLibRemoveListItem(&Volume->ListEntry);
+        CloseHandle(Volume->Thread);
+        Volume->Thread = NULL;
+        SyncDereferenceVolume(Volume);
+    }
+
+    return Result;
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
@@ -130,8 +571,9 @@ SyncFileFoundCallback(
 
     //
     //  If the user requested a volume operation, find the volume name and
-    //  attempt the operation on the volume.  If not, just use the file name
-    //  that has already been located.
+    //  attempt the operation on the volume.  If not, queue the file name
+    //  that has already been located to be flushed by the thread for its
+    //  volume.
     //
 
     if (SyncContext->VolumeDismount || SyncContext->LockVolume) {
@@ -190,40 +632,10 @@ SyncFileFoundCallback(
         YoriLibFreeStringContents(&VolumePath);
         CloseHandle(FileHandle);
         return TRUE;
-
-    } else {
-
-        if (SyncContext->Verbose) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("sync: syncing %y\n"), FilePath);
-        }
-
-        FileHandle = CreateFile(FilePath->StartOfString,
-                                DesiredAccess,
-                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
-                                NULL,
-                                OPEN_ALWAYS,
-                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
-                                NULL);
-
-        if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
-            LastError = GetLastError();
-            ErrText = YoriLibGetWinErrorText(LastError);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: open of %y failed: %s"), FilePath, ErrText);
-            YoriLibFreeWinErrorText(ErrText);
-            return TRUE;
-        }
-
-        if (!FlushFileBuffers(FileHandle)) {
-            LastError = GetLastError();
-            ErrText = YoriLibGetWinErrorText(LastError);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: flush of %y failed: %s"), FilePath, ErrText);
-            YoriLibFreeWinErrorText(ErrText);
-            return TRUE;
-        }
-
-        CloseHandle(FileHandle);
-        return TRUE;
     }
+
+    SyncQueueFile(SyncContext, FilePath);
+    return TRUE;
 }
 
 #ifdef YORI_BUILTIN
@@ -264,6 +676,8 @@ ENTRYPOINT(
     YORI_STRING Arg;
 
     ZeroMemory(&SyncContext, sizeof(SyncContext));
+    YoriLibInitializeListHead(&SyncContext.Volumes);
+    SyncContext.Timeout = INFINITE;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -290,6 +704,20 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("t")) == 0) {
+                if (i + 1 < ArgC) {
+                    YORI_MAX_SIGNED_T Seconds;
+                    YORI_ALLOC_SIZE_T CharsConsumed;
+                    if (YoriLibStringToNumber(&ArgV[i + 1], FALSE, &Seconds, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        Seconds >= 0 &&
+                        Seconds < INFINITE / 1000) {
+
+                        SyncContext.Timeout = (DWORD)Seconds * 1000;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("v")) == 0) {
                 SyncContext.Verbose = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -347,6 +775,10 @@ ENTRYPOINT(
         }
     }
 
+    if (!SyncWaitForVolumes(&SyncContext)) {
+        return EXIT_FAILURE;
+    }
+
     return EXIT_SUCCESS;
 }
 
@@ -48,7 +48,11 @@ CHAR strTailHelpText[] =
         "   -c             Specify a line to display context around instead of EOF\n"
         "   -f             Wait for new output and continue outputting\n"
         "   -n             Specify the number of lines to display\n"
-        "   -s             Process files from all subdirectories\n";
+        "   -s             Process files from all subdirectories\n"
+        "\n"
+        "When following more than one file, a wildcard, a directory or with -s,\n"
+        "each line is prefixed by the name of its file, and files created later\n"
+        "that match are also followed.\n";
 
 /**
  Display usage text to the user.
@@ -132,14 +136,797 @@ typedef struct _TAIL_CONTEXT {
      */
     BOOLEAN StartLineSpecified;
 
+    /**
+     TRUE if every matching file is followed from a single wait loop, with
+     each line prefixed by the name of the file it came from.  This is used
+     when following more than one file, or files that may be created later.
+     */
+    BOOLEAN FollowMultiple;
+
+    /**
+     TRUE while the arguments are being enumerated again to find files that
+     have been created or replaced since following started.
+     */
+    BOOLEAN FollowRescan;
+
+    /**
+     TRUE if some directories could not be watched for changes, so the
+     arguments need to be enumerated again periodically to find new files.
+     */
+    BOOLEAN FollowRescanPeriodically;
+
+    /**
+     The list of files being followed, linked by TAIL_FOLLOW_FILE::ListEntry.
+     */
+    YORI_LIST_ENTRY FollowFiles;
+
+    /**
+     A hash table of files being followed, keyed by full path.  This is used
+     to determine whether a file found when enumerating again is new.
+     */
+    PYORI_OPEN_HASH_TABLE FollowFileTable;
+
+    /**
+     The list of directories being watched for changes, linked by
+     TAIL_FOLLOW_WATCH::ListEntry.
+     */
+    YORI_LIST_ENTRY FollowWatches;
+
 } TAIL_CONTEXT, *PTAIL_CONTEXT;
 
+/**
+ Information about a single file being followed when following multiple
+ files.
+ */
+typedef struct _TAIL_FOLLOW_FILE {
+
+    /**
+     The link within the list of files being followed.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The entry within the hash table of files being followed.
+     */
+    YORI_OPEN_HASH_ENTRY HashEntry;
+
+    /**
+     The full path to the file.  This is allocated as part of this
+     structure.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     The name of the file to display before each line.
+     */
+    YORI_STRING DisplayName;
+
+    /**
+     A handle to the file, positioned after the data that has been read.
+     */
+    HANDLE FileHandle;
+
+    /**
+     The line read context for FileHandle, or NULL if no line has been read
+     from it yet.
+     */
+    PVOID LineContext;
+
+} TAIL_FOLLOW_FILE, *PTAIL_FOLLOW_FILE;
+
+/**
+ Information about a directory that is being watched for changes when
+ following multiple files.
+ */
+typedef struct _TAIL_FOLLOW_WATCH {
+
+    /**
+     The link within the list of watched directories.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The path to the directory.  This is allocated as part of this
+     structure.
+     */
+    YORI_STRING DirectoryName;
+
+    /**
+     TRUE if changes within subdirectories are watched.
+     */
+    BOOLEAN WatchSubtree;
+
+    /**
+     A change notification which is signalled when a file is created,
+     renamed or deleted.
+     */
+    HANDLE NameChangeHandle;
+
+    /**
+     A change notification which is signalled when a file is written to.
+     */
+    HANDLE DataChangeHandle;
+
+} TAIL_FOLLOW_WATCH, *PTAIL_FOLLOW_WATCH;
+
+/**
+ The maximum time to wait, in milliseconds, between checks for new data in
+ a file being followed.  New data is normally detected by a directory change
+ notification, but the file system may defer updating the size of a file
+ that is still open for writing, so the file is checked periodically too.
+ */
+#define TAIL_FOLLOW_MAX_WAIT (1000)
+
+/**
+ Check whether two handles refer to the same file.
+
+ @param FirstHandle The first handle.
+
+ @param SecondHandle The second handle.
+
+ @return TRUE if the handles refer to the same file, FALSE if they do not or
+         this cannot be determined.
+ */
+BOOLEAN
+TailIsSameFile(
+    __in HANDLE FirstHandle,
+    __in HANDLE SecondHandle
+    )
+{
+    BY_HANDLE_FILE_INFORMATION FirstInfo;
+    BY_HANDLE_FILE_INFORMATION SecondInfo;
+
+    if (!GetFileInformationByHandle(FirstHandle, &FirstInfo) ||
+        !GetFileInformationByHandle(SecondHandle, &SecondInfo)) {
+
+        return FALSE;
+    }
+
+    if (FirstInfo.dwVolumeSerialNumber == SecondInfo.dwVolumeSerialNumber &&
+        FirstInfo.nFileIndexHigh == SecondInfo.nFileIndexHigh &&
+        FirstInfo.nFileIndexLow == SecondInfo.nFileIndexLow) {
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Check whether a file has been truncated to below the current file position,
+ indicating that it has been rewritten and should be read from the
+ beginning.
+
+ @param FileHandle Handle to the file.
+
+ @return TRUE if the file is smaller than the current file position, FALSE
+         if it is not or this cannot be determined.
+ */
+BOOLEAN
+TailIsFileTruncated(
+    __in HANDLE FileHandle
+    )
+{
+    LARGE_INTEGER FileSize;
+    LARGE_INTEGER Position;
+
+    Position.HighPart = 0;
+    Position.LowPart = SetFilePointer(FileHandle, 0, &Position.HighPart, FILE_CURRENT);
+    if (Position.LowPart == (DWORD)-1 && GetLastError() != NO_ERROR) {
+        return FALSE;
+    }
+    FileSize.LowPart = GetFileSize(FileHandle, (PDWORD)&FileSize.HighPart);
+    if (FileSize.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+        return FALSE;
+    }
+
+    if (FileSize.QuadPart < Position.QuadPart) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Output lines as they are added to a stream, until the stream or the output
+ is closed or the user cancels.  Pipes and devices are read with blocking
+ reads.  Files are waited on with a change notification on the directory
+ containing the file, and if the file is truncated or replaced by another
+ file with the same name, the new contents are output from the beginning.
+
+ @param hSource The opened source stream, positioned after the lines which
+        have already been output.
+
+ @param FilePath Optionally points to the full path to the file.  If not
+        specified, the file cannot be waited on or checked for replacement,
+        so it is checked periodically instead.
+
+ @param TailContext Pointer to context information.
+
+ @param LineContext Pointer to the line read context for hSource.  This may
+        be replaced if the file is truncated or replaced.
+ */
+VOID
+TailFollowStream(
+    __in HANDLE hSource,
+    __in_opt PYORI_STRING FilePath,
+    __in PTAIL_CONTEXT TailContext,
+    __inout PVOID *LineContext
+    )
+{
+    YORI_STRING ParentName;
+    YORI_LIB_LINE_ENDING LineEnding;
+    HANDLE CurrentHandle;
+    HANDLE NewHandle;
+    HANDLE ChangeHandle;
+    HANDLE WaitHandles[2];
+    LPTSTR FinalSep;
+    BOOL TimeoutReached;
+    BOOLEAN CheckForReplacement;
+    DWORD FileType;
+    DWORD WaitResult;
+    DWORD Err;
+    DWORD BytesWritten;
+
+    FileType = GetFileType(hSource);
+    FileType = FileType & ~(FILE_TYPE_REMOTE);
+
+    CurrentHandle = hSource;
+    ChangeHandle = NULL;
+
+    if (FileType == FILE_TYPE_DISK && FilePath != NULL) {
+        FinalSep = YoriLibFindRightMostCharacter(FilePath, '\\');
+        if (FinalSep != NULL &&
+            YoriLibAllocateString(&ParentName, (YORI_ALLOC_SIZE_T)(FinalSep - FilePath->StartOfString) + 2)) {
+
+            ParentName.LengthInChars = (YORI_ALLOC_SIZE_T)(FinalSep - FilePath->StartOfString);
+
+            //
+            //  The root of a drive needs its trailing separator.
+            //
+
+            if (ParentName.LengthInChars > 0 && FilePath->StartOfString[ParentName.LengthInChars - 1] == ':') {
+                ParentName.LengthInChars++;
+            }
+            memcpy(ParentName.StartOfString, FilePath->StartOfString, ParentName.LengthInChars * sizeof(TCHAR));
+            ParentName.StartOfString[ParentName.LengthInChars] = '\0';
+
+            ChangeHandle = FindFirstChangeNotification(ParentName.StartOfString,
+                                                       FALSE,
+                                                       FILE_NOTIFY_CHANGE_FILE_NAME |
+                                                         FILE_NOTIFY_CHANGE_SIZE |
+                                                         FILE_NOTIFY_CHANGE_LAST_WRITE);
+            if (ChangeHandle == INVALID_HANDLE_VALUE) {
+                ChangeHandle = NULL;
+            }
+            YoriLibFreeStringContents(&ParentName);
+        }
+    }
+
+    while (TRUE) {
+
+        if (YoriLibReadLineToStringEx(&TailContext->LinesArray[0], LineContext, FALSE, INFINITE, CurrentHandle, &LineEnding, &TimeoutReached)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &TailContext->LinesArray[0]);
+            continue;
+        }
+
+        //
+        //  Reads from pipes and devices wait for data, so failure means
+        //  the stream has ended.
+        //
+
+        if (FileType != FILE_TYPE_DISK) {
+            break;
+        }
+
+        //
+        //  Check if the target handle is still around
+        //
+
+        if (!WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), NULL, 0, &BytesWritten, NULL)) {
+            Err = GetLastError();
+            if (Err == ERROR_NO_DATA ||
+                Err == ERROR_PIPE_NOT_CONNECTED) {
+                break;
+            }
+        }
+
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+
+        CheckForReplacement = FALSE;
+        if (ChangeHandle != NULL) {
+            WaitHandles[0] = ChangeHandle;
+            WaitHandles[1] = YoriLibCancelGetEvent();
+            WaitResult = WaitForMultipleObjects(2, WaitHandles, FALSE, TAIL_FOLLOW_MAX_WAIT);
+            if (WaitResult == WAIT_OBJECT_0) {
+                FindNextChangeNotification(ChangeHandle);
+                CheckForReplacement = TRUE;
+            }
+        } else {
+            WaitForSingleObject(YoriLibCancelGetEvent(), 200);
+        }
+
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+
+        //
+        //  If the file is now smaller than the amount that has been read,
+        //  it has been truncated, so start again from the beginning.
+        //
+
+        if (TailIsFileTruncated(CurrentHandle)) {
+
+            if (FilePath != NULL) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tail: %y: file truncated\n"), FilePath);
+            }
+            YoriLibLineReadCloseOrCache(*LineContext);
+            *LineContext = NULL;
+            SetFilePointer(CurrentHandle, 0, NULL, FILE_BEGIN);
+            continue;
+        }
+
+        //
+        //  If a name in the directory changed, check whether the file has
+        //  been replaced by another file with the same name.  If so, output
+        //  anything that was written to the old file before switching.
+        //
+
+        if (CheckForReplacement) {
+            NewHandle = CreateFile(FilePath->StartOfString,
+                                   GENERIC_READ,
+                                   FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                   NULL,
+                                   OPEN_EXISTING,
+                                   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
+                                   NULL);
+
+            if (NewHandle != INVALID_HANDLE_VALUE) {
+                if (TailIsSameFile(CurrentHandle, NewHandle)) {
+                    CloseHandle(NewHandle);
+                } else {
+                    while (YoriLibReadLineToStringEx(&TailContext->LinesArray[0], LineContext, TRUE, INFINITE, CurrentHandle, &LineEnding, &TimeoutReached)) {
+                        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &TailContext->LinesArray[0]);
+                    }
+                    YoriLibLineReadCloseOrCache(*LineContext);
+                    *LineContext = NULL;
+                    if (CurrentHandle != hSource) {
+                        CloseHandle(CurrentHandle);
+                    }
+                    CurrentHandle = NewHandle;
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tail: %y has been replaced; following new file\n"), FilePath);
+                }
+            }
+        }
+    }
+
+    if (ChangeHandle != NULL) {
+        FindCloseChangeNotification(ChangeHandle);
+    }
+
+    //
+    //  The line context may refer to a handle opened here, so it needs to
+    //  be closed before the handle is.
+    //
+
+    if (CurrentHandle != hSource) {
+        YoriLibLineReadCloseOrCache(*LineContext);
+        *LineContext = NULL;
+        CloseHandle(CurrentHandle);
+    }
+}
+
+/**
+ The number of bytes read at a time when scanning backwards from the end of
+ a file to find the final lines.
+ */
+#define TAIL_REVERSE_SCAN_BLOCK_SIZE (64 * 1024)
+
+/**
+ A pointer sized value with each byte set to one.
+ */
+#define TAIL_ONES_8 ((~(DWORD_PTR)0) / 0xFF)
+
+/**
+ Find the offset within a file of the beginning of the final lines, by
+ reading blocks backwards from the end of the file and counting line breaks.
+ A carriage return, line feed, or carriage return followed by line feed are
+ each treated as a single line break, consistent with the line reader.
+ Aligned pointer sized words without any character below 0xE are skipped
+ without examining each character.
+
+ @param hSource Handle to the file.  On return, the file pointer is not
+        defined, and the caller is expected to seek.
+
+ @param LineCount The number of lines to find.
+
+ @param StartOffset On successful completion, updated to contain the offset
+        of the first of the final LineCount lines.  This is zero if the
+        file contains fewer lines.
+
+ @return TRUE to indicate the offset was found, or FALSE if it could not be
+         determined, including for files in a 16 bit encoding.
+ */
+__success(return)
+BOOLEAN
+TailFindFinalLinesOffset(
+    __in HANDLE hSource,
+    __in YORI_ALLOC_SIZE_T LineCount,
+    __out PLARGE_INTEGER StartOffset
+    )
+{
+    LARGE_INTEGER FileSize;
+    LARGE_INTEGER BlockStart;
+    LARGE_INTEGER End;
+    PUCHAR Buffer;
+    DWORD_PTR Word;
+    DWORD BlockLength;
+    DWORD BytesRead;
+    DWORD Index;
+    YORI_ALLOC_SIZE_T LinesFound;
+    UCHAR Char;
+    UCHAR NextChar;
+
+    FileSize.LowPart = GetFileSize(hSource, (PDWORD)&FileSize.HighPart);
+    if (FileSize.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc(TAIL_REVERSE_SCAN_BLOCK_SIZE);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  Line breaks can't be found by examining bytes in a 16 bit encoding,
+    //  so leave those files for the line reader.
+    //
+
+    if (FileSize.QuadPart >= 2 &&
+        SetFilePointer(hSource, 0, NULL, FILE_BEGIN) == 0 &&
+        ReadFile(hSource, Buffer, 2, &BytesRead, NULL) &&
+        BytesRead == 2 &&
+        ((Buffer[0] == 0xFF && Buffer[1] == 0xFE) ||
+         (Buffer[0] == 0xFE && Buffer[1] == 0xFF))) {
+
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    LinesFound = 0;
+    NextChar = '\0';
+    End.QuadPart = FileSize.QuadPart;
+
+    while (End.QuadPart > 0 && LinesFound < LineCount) {
+        BlockStart.QuadPart = (End.QuadPart - 1) - ((End.QuadPart - 1) % TAIL_REVERSE_SCAN_BLOCK_SIZE);
+        BlockLength = (DWORD)(End.QuadPart - BlockStart.QuadPart);
+
+        if (SetFilePointer(hSource, BlockStart.LowPart, &BlockStart.HighPart, FILE_BEGIN) == (DWORD)-1 &&
+            GetLastError() != NO_ERROR) {
+
+            YoriLibFree(Buffer);
+            return FALSE;
+        }
+
+        if (!ReadFile(hSource, Buffer, BlockLength, &BytesRead, NULL) ||
+            BytesRead != BlockLength) {
+
+            YoriLibFree(Buffer);
+            return FALSE;
+        }
+
+        Index = BlockLength;
+        while (Index > 0) {
+
+            //
+            //  The buffer is aligned, so an offset which is a multiple of
+            //  the word size refers to an aligned word.
+            //
+
+            if ((Index % sizeof(DWORD_PTR)) == 0 && Index >= sizeof(DWORD_PTR)) {
+                Word = *(DWORD_PTR *)&Buffer[Index - sizeof(DWORD_PTR)];
+                if (((Word - TAIL_ONES_8 * 0xE) & ~Word & (TAIL_ONES_8 * 0x80)) == 0) {
+                    Index = Index - sizeof(DWORD_PTR);
+                    NextChar = Buffer[Index];
+                    continue;
+                }
+            }
+
+            Index--;
+            Char = Buffer[Index];
+
+            //
+            //  A line break at the end of the file terminates the final
+            //  line rather than beginning another one.
+            //
+
+            if ((Char == '\n' || (Char == '\r' && NextChar != '\n')) &&
+                BlockStart.QuadPart + Index + 1 != FileSize.QuadPart) {
+
+                LinesFound++;
+                if (LinesFound == LineCount) {
+                    StartOffset->QuadPart = BlockStart.QuadPart + Index + 1;
+                    break;
+                }
+            }
+            NextChar = Char;
+        }
+
+        End.QuadPart = BlockStart.QuadPart;
+    }
+
+    if (LinesFound < LineCount) {
+        StartOffset->QuadPart = 0;
+    }
+
+    YoriLibFree(Buffer);
+    return TRUE;
+}
+
+/**
+ Generate the name of a file to display to the user, which is the full path
+ without any escape prefix.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @param DisplayName On completion, updated to contain the name to display.
+        This may refer to the memory of FilePath, and should be freed with
+        YoriLibFreeStringContents.
+ */
+VOID
+TailGetDisplayName(
+    __in PYORI_STRING FilePath,
+    __out PYORI_STRING DisplayName
+    )
+{
+    YoriLibInitEmptyString(DisplayName);
+    if (!YoriLibUnescapePath(FilePath, DisplayName)) {
+        DisplayName->StartOfString = FilePath->StartOfString;
+        DisplayName->LengthInChars = FilePath->LengthInChars;
+    }
+}
+
+/**
+ Find a file which is already being followed.
+
+ @param TailContext Pointer to context information.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @return Pointer to the followed file, or NULL if the file is not being
+         followed.
+ */
+PTAIL_FOLLOW_FILE
+TailFollowLookupFile(
+    __in PTAIL_CONTEXT TailContext,
+    __in PYORI_STRING FilePath
+    )
+{
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+
+    HashEntry = YoriLibOpenHashLookupByKey(TailContext->FollowFileTable, FilePath);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+
+    return (PTAIL_FOLLOW_FILE)HashEntry->Context;
+}
+
+/**
+ Add a file to the set of files being followed.
+
+ @param TailContext Pointer to context information.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @param hSource Handle to the file, positioned after any data which has
+        already been output.  This handle is duplicated, so the caller
+        remains responsible for closing it.
+
+ @param LineContext Optionally points to a line read context for hSource.
+        On success, this is owned by the followed file and the caller should
+        not use it further.
+
+ @return Pointer to the followed file, or NULL if the file could not be
+         added.
+ */
+PTAIL_FOLLOW_FILE
+TailFollowAddFile(
+    __in PTAIL_CONTEXT TailContext,
+    __in PYORI_STRING FilePath,
+    __in HANDLE hSource,
+    __in_opt PVOID LineContext
+    )
+{
+    PTAIL_FOLLOW_FILE FollowFile;
+    YORI_MAX_UNSIGNED_T BytesRequired;
+
+    BytesRequired = sizeof(TAIL_FOLLOW_FILE) + (FilePath->LengthInChars + 1) * sizeof(TCHAR);
+    if (!YoriLibIsSizeAllocatable(BytesRequired)) {
+        return NULL;
+    }
+
+    FollowFile = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesRequired);
+    if (FollowFile == NULL) {
+        return NULL;
+    }
+
+    if (!DuplicateHandle(GetCurrentProcess(),
+                         hSource,
+                         GetCurrentProcess(),
+                         &FollowFile->FileHandle,
+                         0,
+                         FALSE,
+                         DUPLICATE_SAME_ACCESS)) {
+
+        YoriLibFree(FollowFile);
+        return NULL;
+    }
+
+    YoriLibInitEmptyString(&FollowFile->FilePath);
+    FollowFile->FilePath.StartOfString = (LPTSTR)(FollowFile + 1);
+    memcpy(FollowFile->FilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    FollowFile->FilePath.StartOfString[FilePath->LengthInChars] = '\0';
+    FollowFile->FilePath.LengthInChars = FilePath->LengthInChars;
+    FollowFile->FilePath.LengthAllocated = FilePath->LengthInChars + 1;
+
+    if (!YoriLibOpenHashInsertByKey(TailContext->FollowFileTable, &FollowFile->FilePath, FollowFile, &FollowFile->HashEntry)) {
+        CloseHandle(FollowFile->FileHandle);
+        YoriLibFree(FollowFile);
+        return NULL;
+    }
+
+    TailGetDisplayName(&FollowFile->FilePath, &FollowFile->DisplayName);
+
+    //
+    //  Each followed file keeps its line context for as long as it is
+    //  followed, and a read ahead thread for each would be wasteful when
+    //  only appended data is being read.  The handles share a file
+    //  position, so any data read ahead is returned to the duplicate.
+    //
+
+    YoriLibLineReadDisableReadAhead(LineContext);
+    FollowFile->LineContext = LineContext;
+
+    YoriLibAppendList(&TailContext->FollowFiles, &FollowFile->ListEntry);
+    return FollowFile;
+}
+
+/**
+ Stop following a file and free it.
+
+ @param FollowFile Pointer to the file to stop following.
+ */
+VOID
+TailFollowFreeFile(
+    __in PTAIL_FOLLOW_FILE FollowFile
+    )
+{
+    //
+    //  The line context refers to the handle, so it needs to be closed
+    //  before the handle is.
+    //
+
+    YoriLibLineReadCloseOrCache(FollowFile->LineContext);
+    CloseHandle(FollowFile->FileHandle);
+    YoriLibOpenHashRemoveByEntry(&FollowFile->HashEntry);
+    YoriLibRemoveListItem(&FollowFile->ListEntry);
+    YoriLibFreeStringContents(&FollowFile->DisplayName);
+    YoriLibFree(FollowFile);
+}
+
+/**
+ Output any complete lines that have been added to a followed file, each
+ prefixed by the name of the file.
+
+ @param TailContext Pointer to context information.
+
+ @param FollowFile Pointer to the followed file.
+
+ @param ReturnFinal TRUE if the file is no longer being written to, so any
+        final line without a line ending should be output.
+ */
+VOID
+TailFollowOutputLines(
+    __in PTAIL_CONTEXT TailContext,
+    __in PTAIL_FOLLOW_FILE FollowFile,
+    __in BOOLEAN ReturnFinal
+    )
+{
+    YORI_LIB_LINE_ENDING LineEnding;
+    BOOL TimeoutReached;
+    BOOLEAN NewContext;
+
+    NewContext = (BOOLEAN)(FollowFile->LineContext == NULL);
+
+    while (YoriLibReadLineToStringEx(&TailContext->LinesArray[0], &FollowFile->LineContext, ReturnFinal, INFINITE, FollowFile->FileHandle, &LineEnding, &TimeoutReached)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y: %y\n"), &FollowFile->DisplayName, &TailContext->LinesArray[0]);
+    }
+
+    if (NewContext) {
+        YoriLibLineReadDisableReadAhead(FollowFile->LineContext);
+    }
+}
+
+/**
+ Output any lines that have been added to a followed file.  If the file has
+ been truncated, output its contents from the beginning.
+
+ @param TailContext Pointer to context information.
+
+ @param FollowFile Pointer to the followed file.
+ */
+VOID
+TailFollowReadFile(
+    __in PTAIL_CONTEXT TailContext,
+    __in PTAIL_FOLLOW_FILE FollowFile
+    )
+{
+    TailFollowOutputLines(TailContext, FollowFile, FALSE);
+
+    if (TailIsFileTruncated(FollowFile->FileHandle)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tail: %y: file truncated\n"), &FollowFile->DisplayName);
+        YoriLibLineReadCloseOrCache(FollowFile->LineContext);
+        FollowFile->LineContext = NULL;
+        SetFilePointer(FollowFile->FileHandle, 0, NULL, FILE_BEGIN);
+        TailFollowOutputLines(TailContext, FollowFile, FALSE);
+    }
+}
+
+/**
+ Check whether a followed file has been replaced by another file with the
+ same name.  If so, output anything that was written to the old file, and
+ follow the new file from the beginning.
+
+ @param TailContext Pointer to context information.
+
+ @param FollowFile Pointer to the followed file.
+ */
+VOID
+TailFollowCheckForReplacement(
+    __in PTAIL_CONTEXT TailContext,
+    __in PTAIL_FOLLOW_FILE FollowFile
+    )
+{
+    HANDLE NewHandle;
+
+    NewHandle = CreateFile(FollowFile->FilePath.StartOfString,
+                           GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           NULL,
+                           OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
+                           NULL);
+
+    if (NewHandle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    if (TailIsSameFile(FollowFile->FileHandle, NewHandle)) {
+        CloseHandle(NewHandle);
+        return;
+    }
+
+    TailFollowOutputLines(TailContext, FollowFile, TRUE);
+    YoriLibLineReadCloseOrCache(FollowFile->LineContext);
+    FollowFile->LineContext = NULL;
+    CloseHandle(FollowFile->FileHandle);
+    FollowFile->FileHandle = NewHandle;
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tail: %y has been replaced; following new file\n"), &FollowFile->DisplayName);
+}
+
 /**
  Process a single opened stream, enumerating through all lines and displaying
  the set requested by the user.
 
  @param hSource The opened source stream.
 
+ @param FilePath Optionally points to the full path to the file that the
+        stream refers to.  This is used to detect the file being replaced
+        when waiting for more output.
+
  @param TailContext Pointer to context information specifying which lines to
         display.
  
@@ -148,6 +935,7 @@ typedef struct _TAIL_CONTEXT {
 BOOL
 TailProcessStream(
     __in HANDLE hSource,
+    __in_opt PYORI_STRING FilePath,
     __in PTAIL_CONTEXT TailContext
     )
 {
@@ -158,22 +946,29 @@ TailProcessStream(
     YORI_LIB_LINE_ENDING LineEnding;
     BOOL TimeoutReached;
     DWORD SeekToEndOffset = 0;
-    DWORD Err;
-    DWORD BytesWritten;
+    LARGE_INTEGER StartOffset;
+    YORI_STRING DisplayName;
 
     DWORD FileType = GetFileType(hSource);
     FileType = FileType & ~(FILE_TYPE_REMOTE);
 
     //
-    //  If it's a file and we want the final few lines, start searching
-    //  from the end, assuming an average line size of 256 bytes.
+    //  If it's a file and we want the final few lines, find where they
+    //  start by scanning backwards from the end.  If that's not possible,
+    //  start searching from the end, assuming an average line size of 256
+    //  bytes.
     //
 
     if (FileType == FILE_TYPE_DISK &&
         !TailContext->StartLineSpecified &&
         TailContext->FinalLine == 0) {
 
-        SeekToEndOffset = 256 * TailContext->LinesToDisplay;
+        if (TailFindFinalLinesOffset(hSource, TailContext->LinesToDisplay, &StartOffset)) {
+            SetFilePointer(hSource, StartOffset.LowPart, &StartOffset.HighPart, FILE_BEGIN);
+        } else {
+            SetFilePointer(hSource, 0, NULL, FILE_BEGIN);
+            SeekToEndOffset = 256 * TailContext->LinesToDisplay;
+        }
     }
 
     TailContext->FilesFound++;
@@ -241,36 +1036,31 @@ TailProcessStream(
         }
     }
 
-    for (CurrentLine = StartLine; CurrentLine < TailContext->LinesFound; CurrentLine++) {
-        LineString = &TailContext->LinesArray[CurrentLine % TailContext->LinesToDisplay];
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), LineString);
-    }
-
-    if (TailContext->WaitForMore) {
-        while (TRUE) {
-
-            if (!YoriLibReadLineToStringEx(&TailContext->LinesArray[0], &LineContext, FALSE, INFINITE, hSource, &LineEnding, &TimeoutReached)) {
-
-                //
-                //  Check if the target handle is still around
-                //
+    //
+    //  When following multiple files, each line is prefixed by the name of
+    //  the file it came from, and the file is followed along with the
+    //  others once all arguments have been processed.
+    //
 
-                if (!WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), NULL, 0, &BytesWritten, NULL)) {
-                    Err = GetLastError();
-                    if (Err == ERROR_NO_DATA ||
-                        Err == ERROR_PIPE_NOT_CONNECTED) {
-                        break;
-                    }
-                }
+    if (TailContext->FollowMultiple && FilePath != NULL && FileType == FILE_TYPE_DISK) {
+        TailGetDisplayName(FilePath, &DisplayName);
+        for (CurrentLine = StartLine; CurrentLine < TailContext->LinesFound; CurrentLine++) {
+            LineString = &TailContext->LinesArray[CurrentLine % TailContext->LinesToDisplay];
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y: %y\n"), &DisplayName, LineString);
+        }
+        YoriLibFreeStringContents(&DisplayName);
 
-                if (YoriLibIsOperationCancelled()) {
-                    break;
-                }
+        if (TailFollowAddFile(TailContext, FilePath, hSource, LineContext) != NULL) {
+            LineContext = NULL;
+        }
+    } else {
+        for (CurrentLine = StartLine; CurrentLine < TailContext->LinesFound; CurrentLine++) {
+            LineString = &TailContext->LinesArray[CurrentLine % TailContext->LinesToDisplay];
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), LineString);
+        }
 
-                Sleep(200);
-                continue;
-            }
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &TailContext->LinesArray[0]);
+        if (TailContext->WaitForMore) {
+            TailFollowStream(hSource, FilePath, TailContext, &LineContext);
         }
     }
 
@@ -303,6 +1093,7 @@ TailFileFoundCallback(
     )
 {
     HANDLE FileHandle;
+    PTAIL_FOLLOW_FILE FollowFile;
     PTAIL_CONTEXT TailContext = (PTAIL_CONTEXT)Context;
 
     UNREFERENCED_PARAMETER(Depth);
@@ -312,6 +1103,22 @@ TailFileFoundCallback(
     if (FileInfo == NULL ||
         (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
 
+        //
+        //  When following multiple files, a file that is already being
+        //  followed is not processed again, but when enumerating again
+        //  after names have changed, check whether it has been replaced.
+        //
+
+        if (TailContext->FollowMultiple) {
+            FollowFile = TailFollowLookupFile(TailContext, FilePath);
+            if (FollowFile != NULL) {
+                if (TailContext->FollowRescan) {
+                    TailFollowCheckForReplacement(TailContext, FollowFile);
+                }
+                return TRUE;
+            }
+        }
+
         FileHandle = CreateFile(FilePath->StartOfString,
                                 GENERIC_READ,
                                 FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
@@ -321,7 +1128,9 @@ TailFileFoundCallback(
                                 NULL);
 
         if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
-            if (TailContext->SavedErrorThisArg == ERROR_SUCCESS) {
+            if (!TailContext->FollowRescan &&
+                TailContext->SavedErrorThisArg == ERROR_SUCCESS) {
+
                 DWORD LastError = GetLastError();
                 LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
                 YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tail: open of %y failed: %s"), FilePath, ErrText);
@@ -330,8 +1139,21 @@ TailFileFoundCallback(
             return TRUE;
         }
 
-        TailContext->SavedErrorThisArg = ERROR_SUCCESS;
-        TailProcessStream(FileHandle, TailContext);
+        //
+        //  A file that has been created since following started is output
+        //  from the beginning.
+        //
+
+        if (TailContext->FollowRescan) {
+            FollowFile = TailFollowAddFile(TailContext, FilePath, FileHandle, NULL);
+            if (FollowFile != NULL) {
+                TailContext->FilesFound++;
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tail: %y has appeared; following new file\n"), &FollowFile->DisplayName);
+            }
+        } else {
+            TailContext->SavedErrorThisArg = ERROR_SUCCESS;
+            TailProcessStream(FileHandle, FilePath, TailContext);
+        }
 
         CloseHandle(FileHandle);
     }
@@ -399,6 +1221,388 @@ TailFileEnumerateErrorCallback(
     return Result;
 }
 
+/**
+ A callback that is invoked when a directory cannot be successfully
+ enumerated while looking for new files to follow.  Errors are not displayed
+ here, because the same error would be displayed each time the arguments are
+ enumerated.
+
+ @param FilePath Pointer to the file path that could not be enumerated.
+
+ @param ErrorCode The Win32 error code describing the failure.
+
+ @param Depth Recursion depth, ignored in this application.
+
+ @param Context Pointer to the tail context structure, ignored in this
+        function.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+TailFollowRescanErrorCallback(
+    __in PYORI_STRING FilePath,
+    __in DWORD ErrorCode,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    UNREFERENCED_PARAMETER(FilePath);
+    UNREFERENCED_PARAMETER(ErrorCode);
+    UNREFERENCED_PARAMETER(Depth);
+    UNREFERENCED_PARAMETER(Context);
+
+    return TRUE;
+}
+
+/**
+ Check whether a string contains characters which are interpreted as
+ wildcards when enumerating files.
+
+ @param String Pointer to the string to check.
+
+ @param MatchFlags The flags used to enumerate files.
+
+ @return TRUE if the string contains wildcards, FALSE if it does not.
+ */
+BOOLEAN
+TailHasWildcard(
+    __in PCYORI_STRING String,
+    __in WORD MatchFlags
+    )
+{
+    LPCTSTR WildChars;
+
+    WildChars = _T("*?[{");
+    if (MatchFlags & YORILIB_FILEENUM_BASIC_EXPANSION) {
+        WildChars = _T("*?");
+    }
+
+    if (YoriLibCntStringNotWithChars(String, WildChars) != String->LengthInChars) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Check whether a command line argument can refer to more than one file, or
+ to files which do not exist yet.
+
+ @param Arg Pointer to the command line argument.
+
+ @param MatchFlags The flags used to enumerate files.
+
+ @return TRUE if the argument contains wildcards or refers to a directory,
+         FALSE if it refers to a single file.
+ */
+BOOLEAN
+TailIsMultipleFileSpec(
+    __in PYORI_STRING Arg,
+    __in WORD MatchFlags
+    )
+{
+    YORI_STRING FullPath;
+    DWORD Attributes;
+
+    if (TailHasWildcard(Arg, MatchFlags)) {
+        return TRUE;
+    }
+
+    YoriLibInitEmptyString(&FullPath);
+    if (!YoriLibUserStringToSingleFilePath(Arg, TRUE, &FullPath)) {
+        return FALSE;
+    }
+
+    Attributes = GetFileAttributes(FullPath.StartOfString);
+    YoriLibFreeStringContents(&FullPath);
+
+    if (Attributes != INVALID_FILE_ATTRIBUTES &&
+        (Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Watch the directory that may contain files matching a command line argument
+ for changes.  If the argument refers to a directory, that directory is
+ watched; otherwise the directory containing the final component is watched.
+ If a directory component contains wildcards, the nearest parent without
+ wildcards is watched along with all of its subdirectories.
+
+ @param TailContext Pointer to context information.
+
+ @param Arg Pointer to the command line argument.
+
+ @param MatchFlags The flags used to enumerate files.
+ */
+VOID
+TailFollowAddWatch(
+    __in PTAIL_CONTEXT TailContext,
+    __in PYORI_STRING Arg,
+    __in WORD MatchFlags
+    )
+{
+    YORI_STRING FullPath;
+    PYORI_LIST_ENTRY ListEntry;
+    PTAIL_FOLLOW_WATCH Watch;
+    LPTSTR FinalSep;
+    DWORD Attributes;
+    BOOLEAN WatchSubtree;
+
+    YoriLibInitEmptyString(&FullPath);
+    if (!YoriLibUserStringToSingleFilePath(Arg, FALSE, &FullPath)) {
+        TailContext->FollowRescanPeriodically = TRUE;
+        return;
+    }
+
+    WatchSubtree = TailContext->Recursive;
+
+    Attributes = GetFileAttributes(FullPath.StartOfString);
+    if (Attributes == INVALID_FILE_ATTRIBUTES ||
+        (Attributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+
+        while (TRUE) {
+            FinalSep = YoriLibFindRightMostCharacter(&FullPath, '\\');
+            if (FinalSep == NULL) {
+                YoriLibFreeStringContents(&FullPath);
+                TailContext->FollowRescanPeriodically = TRUE;
+                return;
+            }
+
+            FullPath.LengthInChars = (YORI_ALLOC_SIZE_T)(FinalSep - FullPath.StartOfString);
+            if (!TailHasWildcard(&FullPath, MatchFlags)) {
+                break;
+            }
+            WatchSubtree = TRUE;
+        }
+
+        //
+        //  The root of a drive needs its trailing separator.
+        //
+
+        if (FullPath.LengthInChars > 0 && FullPath.StartOfString[FullPath.LengthInChars - 1] == ':') {
+            FullPath.LengthInChars++;
+        }
+        FullPath.StartOfString[FullPath.LengthInChars] = '\0';
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&TailContext->FollowWatches, NULL);
+    while (ListEntry != NULL) {
+        Watch = CONTAINING_RECORD(ListEntry, TAIL_FOLLOW_WATCH, ListEntry);
+        if (Watch->WatchSubtree == WatchSubtree &&
+            YoriLibCompareStringIns(&Watch->DirectoryName, &FullPath) == 0) {
+
+            YoriLibFreeStringContents(&FullPath);
+            return;
+        }
+        ListEntry = YoriLibGetNextListEntry(&TailContext->FollowWatches, ListEntry);
+    }
+
+    Watch = YoriLibMalloc((YORI_ALLOC_SIZE_T)(sizeof(TAIL_FOLLOW_WATCH) + (FullPath.LengthInChars + 1) * sizeof(TCHAR)));
+    if (Watch == NULL) {
+        YoriLibFreeStringContents(&FullPath);
+        TailContext->FollowRescanPeriodically = TRUE;
+        return;
+    }
+
+    YoriLibInitEmptyString(&Watch->DirectoryName);
+    Watch->DirectoryName.StartOfString = (LPTSTR)(Watch + 1);
+    memcpy(Watch->DirectoryName.StartOfString, FullPath.StartOfString, FullPath.LengthInChars * sizeof(TCHAR));
+    Watch->DirectoryName.StartOfString[FullPath.LengthInChars] = '\0';
+    Watch->DirectoryName.LengthInChars = FullPath.LengthInChars;
+    Watch->DirectoryName.LengthAllocated = FullPath.LengthInChars + 1;
+    Watch->WatchSubtree = WatchSubtree;
+    YoriLibFreeStringContents(&FullPath);
+
+    //
+    //  Names and data are watched separately so that only changes to names
+    //  need the arguments to be enumerated again.
+    //
+
+    Watch->NameChangeHandle = FindFirstChangeNotification(Watch->DirectoryName.StartOfString,
+                                                          WatchSubtree,
+                                                          FILE_NOTIFY_CHANGE_FILE_NAME);
+    if (Watch->NameChangeHandle == INVALID_HANDLE_VALUE) {
+        YoriLibFree(Watch);
+        TailContext->FollowRescanPeriodically = TRUE;
+        return;
+    }
+
+    Watch->DataChangeHandle = FindFirstChangeNotification(Watch->DirectoryName.StartOfString,
+                                                          WatchSubtree,
+                                                          FILE_NOTIFY_CHANGE_SIZE |
+                                                            FILE_NOTIFY_CHANGE_LAST_WRITE);
+    if (Watch->DataChangeHandle == INVALID_HANDLE_VALUE) {
+        FindCloseChangeNotification(Watch->NameChangeHandle);
+        YoriLibFree(Watch);
+        TailContext->FollowRescanPeriodically = TRUE;
+        return;
+    }
+
+    YoriLibAppendList(&TailContext->FollowWatches, &Watch->ListEntry);
+}
+
+/**
+ Output lines as they are added to any of the files being followed, each
+ prefixed by the name of the file, until the output is closed or the user
+ cancels.  Files are waited on with change notifications on the directories
+ that contain them, and when names change in those directories, the
+ arguments are enumerated again to find files which have been created or
+ replaced.
+
+ @param TailContext Pointer to context information.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV An array of arguments.
+
+ @param StartArg The index of the first argument describing files to follow.
+
+ @param MatchFlags The flags used to enumerate files.
+ */
+VOID
+TailFollowMultipleFiles(
+    __in PTAIL_CONTEXT TailContext,
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[],
+    __in YORI_ALLOC_SIZE_T StartArg,
+    __in WORD MatchFlags
+    )
+{
+    HANDLE WaitHandles[MAXIMUM_WAIT_OBJECTS];
+    BOOLEAN IsNameChange[MAXIMUM_WAIT_OBJECTS];
+    PYORI_LIST_ENTRY ListEntry;
+    PTAIL_FOLLOW_WATCH Watch;
+    PTAIL_FOLLOW_FILE FollowFile;
+    YORI_ALLOC_SIZE_T i;
+    DWORD HandleCount;
+    DWORD WaitResult;
+    DWORD Index;
+    DWORD Err;
+    DWORD BytesWritten;
+    BOOLEAN Rescan;
+
+    HandleCount = 0;
+    WaitHandles[HandleCount] = YoriLibCancelGetEvent();
+    IsNameChange[HandleCount] = FALSE;
+    HandleCount++;
+
+    ListEntry = YoriLibGetNextListEntry(&TailContext->FollowWatches, NULL);
+    while (ListEntry != NULL) {
+        Watch = CONTAINING_RECORD(ListEntry, TAIL_FOLLOW_WATCH, ListEntry);
+        if (HandleCount + 2 > MAXIMUM_WAIT_OBJECTS) {
+            TailContext->FollowRescanPeriodically = TRUE;
+            break;
+        }
+        WaitHandles[HandleCount] = Watch->NameChangeHandle;
+        IsNameChange[HandleCount] = TRUE;
+        HandleCount++;
+        WaitHandles[HandleCount] = Watch->DataChangeHandle;
+        IsNameChange[HandleCount] = FALSE;
+        HandleCount++;
+        ListEntry = YoriLibGetNextListEntry(&TailContext->FollowWatches, ListEntry);
+    }
+
+    while (TRUE) {
+
+        ListEntry = YoriLibGetNextListEntry(&TailContext->FollowFiles, NULL);
+        while (ListEntry != NULL) {
+            FollowFile = CONTAINING_RECORD(ListEntry, TAIL_FOLLOW_FILE, ListEntry);
+            TailFollowReadFile(TailContext, FollowFile);
+            ListEntry = YoriLibGetNextListEntry(&TailContext->FollowFiles, ListEntry);
+        }
+
+        //
+        //  Check if the target handle is still around
+        //
+
+        if (!WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), NULL, 0, &BytesWritten, NULL)) {
+            Err = GetLastError();
+            if (Err == ERROR_NO_DATA ||
+                Err == ERROR_PIPE_NOT_CONNECTED) {
+                break;
+            }
+        }
+
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+
+        Rescan = FALSE;
+        WaitResult = WaitForMultipleObjects(HandleCount, WaitHandles, FALSE, TAIL_FOLLOW_MAX_WAIT);
+        if (WaitResult == WAIT_TIMEOUT) {
+            Rescan = TailContext->FollowRescanPeriodically;
+        } else if (WaitResult > WAIT_OBJECT_0 && WaitResult < WAIT_OBJECT_0 + HandleCount) {
+            Index = WaitResult - WAIT_OBJECT_0;
+            FindNextChangeNotification(WaitHandles[Index]);
+            Rescan = IsNameChange[Index];
+        } else if (WaitResult == WAIT_FAILED) {
+            break;
+        }
+
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+
+        //
+        //  If names have changed, look for files which have been created or
+        //  replaced.
+        //
+
+        if (Rescan) {
+            TailContext->FollowRescan = TRUE;
+            for (i = StartArg; i < ArgC; i++) {
+                YoriLibForEachStream(&ArgV[i],
+                                     MatchFlags,
+                                     0,
+                                     TailFileFoundCallback,
+                                     TailFollowRescanErrorCallback,
+                                     TailContext);
+            }
+            TailContext->FollowRescan = FALSE;
+        }
+    }
+}
+
+/**
+ Stop following all files and watching all directories.
+
+ @param TailContext Pointer to context information.
+ */
+VOID
+TailFollowCleanup(
+    __in PTAIL_CONTEXT TailContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PTAIL_FOLLOW_FILE FollowFile;
+    PTAIL_FOLLOW_WATCH Watch;
+
+    ListEntry = YoriLibGetNextListEntry(&TailContext->FollowFiles, NULL);
+    while (ListEntry != NULL) {
+        FollowFile = CONTAINING_RECORD(ListEntry, TAIL_FOLLOW_FILE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&TailContext->FollowFiles, ListEntry);
+        TailFollowFreeFile(FollowFile);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&TailContext->FollowWatches, NULL);
+    while (ListEntry != NULL) {
+        Watch = CONTAINING_RECORD(ListEntry, TAIL_FOLLOW_WATCH, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&TailContext->FollowWatches, ListEntry);
+        YoriLibRemoveListItem(&Watch->ListEntry);
+        FindCloseChangeNotification(Watch->NameChangeHandle);
+        FindCloseChangeNotification(Watch->DataChangeHandle);
+        YoriLibFree(Watch);
+    }
+
+    if (TailContext->FollowFileTable != NULL) {
+        YoriLibFreeEmptyOpenHashTable(TailContext->FollowFileTable);
+        TailContext->FollowFileTable = NULL;
+    }
+}
 
 #ifdef YORI_BUILTIN
 /**
@@ -558,7 +1762,7 @@ ENTRYPOINT(
             return EXIT_FAILURE;
         }
 
-        TailProcessStream(GetStdHandle(STD_INPUT_HANDLE), &TailContext);
+        TailProcessStream(GetStdHandle(STD_INPUT_HANDLE), NULL, &TailContext);
     } else {
         MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
         if (TailContext.Recursive) {
@@ -568,6 +1772,26 @@ ENTRYPOINT(
             MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
         }
 
+        //
+        //  If following more than one file, or files which may be created
+        //  later, follow all of them from a single wait loop once each has
+        //  been processed.  If the state for this can't be allocated,
+        //  follow the first file only.
+        //
+
+        YoriLibInitializeListHead(&TailContext.FollowFiles);
+        YoriLibInitializeListHead(&TailContext.FollowWatches);
+        if (TailContext.WaitForMore &&
+            (ArgC - StartArg > 1 ||
+             TailContext.Recursive ||
+             TailIsMultipleFileSpec(&ArgV[StartArg], MatchFlags))) {
+
+            TailContext.FollowFileTable = YoriLibAllocateOpenHashTable(0);
+            if (TailContext.FollowFileTable != NULL) {
+                TailContext.FollowMultiple = TRUE;
+            }
+        }
+
         for (i = StartArg; i < ArgC; i++) {
 
             TailContext.FilesFoundThisArg = 0;
@@ -593,6 +1817,14 @@ ENTRYPOINT(
                 }
             }
         }
+
+        if (TailContext.FollowMultiple) {
+            for (i = StartArg; i < ArgC; i++) {
+                TailFollowAddWatch(&TailContext, &ArgV[i], MatchFlags);
+            }
+            TailFollowMultipleFiles(&TailContext, ArgC, ArgV, StartArg, MatchFlags);
+            TailFollowCleanup(&TailContext);
+        }
     }
 
     for (Count = 0; Count < TailContext.LinesToDisplay; Count++) {
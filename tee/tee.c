@@ -3,7 +3,7 @@
  *
  * Yori shell output to a file and stdout
  *
- * Copyright (c) 2017-2023 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -35,10 +35,11 @@ CHAR strTeeHelpText[] =
         "\n"
         "Output the contents of standard input to standard output and a file.\n"
         "\n"
-        "TEE [-license] -c\n"
-        "TEE [-license] [-a] <file>]\n"
+        "TEE [-license] [-b] -c\n"
+        "TEE [-license] [-a] [-b] <file>]\n"
         "\n"
         "   -a             Append to the file\n"
+        "   -b             Copy data without interpreting it as lines of text\n"
         "   -c             Write to the console and standard output\n";
 
 /**
@@ -55,6 +56,96 @@ TeeHelp(VOID)
     return TRUE;
 }
 
+/**
+ The number of chunks in the ring buffer shared by all output sinks.  This
+ is also the furthest any single sink can fall behind the input before
+ reading input is paused.
+ */
+#define TEE_RING_CHUNK_COUNT (16)
+
+/**
+ The size of each chunk in the ring buffer, in bytes.  In text mode a chunk
+ can be reallocated to be larger if a single line will not fit.
+ */
+#define TEE_RING_CHUNK_SIZE (64 * 1024)
+
+/**
+ The number of output sinks.  Tee always writes to standard output and one
+ other device.
+ */
+#define TEE_SINK_COUNT (2)
+
+/**
+ A single chunk of data in the ring buffer.
+ */
+typedef struct _TEE_CHUNK {
+
+    /**
+     Pointer to the data.  In text mode this contains TCHARs, with each line
+     terminated by a newline.  In binary mode it contains the bytes read from
+     the input.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The number of bytes allocated in Buffer.
+     */
+    DWORD BufferSize;
+
+    /**
+     The number of bytes in Buffer that contain data.
+     */
+    DWORD BytesPopulated;
+
+} TEE_CHUNK, *PTEE_CHUNK;
+
+struct _TEE_CONTEXT;
+
+/**
+ A single output device, which is written to by its own thread.
+ */
+typedef struct _TEE_SINK {
+
+    /**
+     Pointer to the context that owns the ring buffer.
+     */
+    struct _TEE_CONTEXT *TeeContext;
+
+    /**
+     Handle to the output device.
+     */
+    HANDLE hDevice;
+
+    /**
+     Handle to the thread writing to the device.
+     */
+    HANDLE hThread;
+
+    /**
+     An event signalled when new chunks are available or input has ended.
+     */
+    HANDLE DataEvent;
+
+    /**
+     The number of chunks this sink has finished with.
+     */
+    volatile LONG ChunksConsumed;
+
+    /**
+     TRUE if hDevice is a handle to a console; FALSE if it is a handle to a
+     different type of device.
+     */
+    BOOLEAN IsConsole;
+
+    /**
+     Set to TRUE if a write to this device failed.  Later chunks are
+     discarded rather than written, so a device that has gone away does
+     not stop output to other devices.
+     */
+    BOOLEAN WriteFailed;
+
+} TEE_SINK, *PTEE_SINK;
+
 /**
  Context passed to the callback which is invoked for each source stream
  processed.
@@ -73,6 +164,37 @@ typedef struct _TEE_CONTEXT {
      */
     BOOLEAN FileIsConsole;
 
+    /**
+     TRUE if data should be copied exactly as it was read, FALSE if it
+     should be read and written as lines of text.
+     */
+    BOOLEAN BinaryMode;
+
+    /**
+     Set to TRUE once all input has been placed in the ring buffer.
+     */
+    volatile LONG InputComplete;
+
+    /**
+     The number of chunks that have been placed in the ring buffer.
+     */
+    volatile LONG ChunksProduced;
+
+    /**
+     An event signalled whenever a sink finishes with a chunk.
+     */
+    HANDLE SpaceEvent;
+
+    /**
+     The ring buffer of chunks.
+     */
+    TEE_CHUNK Chunks[TEE_RING_CHUNK_COUNT];
+
+    /**
+     The output devices.
+     */
+    TEE_SINK Sinks[TEE_SINK_COUNT];
+
 } TEE_CONTEXT, *PTEE_CONTEXT;
 
 /**
@@ -115,35 +237,215 @@ TeeWriteLine(
 }
 
 /**
- Process a single stream.
+ Write a chunk of text to an output device.  If the device is a console,
+ each line is written separately so the cursor position can be checked
+ after it.
+
+ @param Sink Pointer to the output device.
+
+ @param Chunk Pointer to the chunk to write.
+ */
+VOID
+TeeWriteTextChunk(
+    __in PTEE_SINK Sink,
+    __in PTEE_CHUNK Chunk
+    )
+{
+    YORI_STRING Text;
+    YORI_STRING Line;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T LineStart;
+
+    YoriLibInitEmptyString(&Text);
+    Text.StartOfString = (LPTSTR)Chunk->Buffer;
+    Text.LengthInChars = (YORI_ALLOC_SIZE_T)(Chunk->BytesPopulated / sizeof(TCHAR));
+
+    if (!Sink->IsConsole) {
+        YoriLibOutputToDevice(Sink->hDevice, 0, _T("%y"), &Text);
+        return;
+    }
+
+    YoriLibInitEmptyString(&Line);
+    LineStart = 0;
+    for (Index = 0; Index < Text.LengthInChars; Index++) {
+        if (Text.StartOfString[Index] == '\n') {
+            Line.StartOfString = &Text.StartOfString[LineStart];
+            Line.LengthInChars = Index - LineStart;
+            TeeWriteLine(Sink->hDevice, TRUE, &Line);
+            LineStart = Index + 1;
+        }
+    }
+}
+
+/**
+ A thread which writes chunks from the ring buffer to a single output
+ device until all input has been written.
+
+ @param Context Pointer to the sink to write to.
+
+ @return Zero.
+ */
+DWORD WINAPI
+TeeSinkThread(
+    __in LPVOID Context
+    )
+{
+    PTEE_SINK Sink;
+    PTEE_CONTEXT TeeContext;
+    PTEE_CHUNK Chunk;
+    DWORD BytesWritten;
+    LONG ChunksProduced;
+
+    Sink = (PTEE_SINK)Context;
+    TeeContext = Sink->TeeContext;
+
+    while (TRUE) {
+
+        //
+        //  Check for completion before checking for data, so that any
+        //  chunks produced before input ended are seen.
+        //
+
+        if (TeeContext->InputComplete) {
+            ChunksProduced = TeeContext->ChunksProduced;
+            if (Sink->ChunksConsumed == ChunksProduced) {
+                break;
+            }
+        } else {
+            ChunksProduced = TeeContext->ChunksProduced;
+            if (Sink->ChunksConsumed == ChunksProduced) {
+                WaitForSingleObject(Sink->DataEvent, INFINITE);
+                continue;
+            }
+        }
+
+        Chunk = &TeeContext->Chunks[(DWORD)Sink->ChunksConsumed % TEE_RING_CHUNK_COUNT];
+
+        if (!Sink->WriteFailed) {
+            if (TeeContext->BinaryMode) {
+                if (!WriteFile(Sink->hDevice, Chunk->Buffer, Chunk->BytesPopulated, &BytesWritten, NULL)) {
+                    Sink->WriteFailed = TRUE;
+                }
+            } else {
+                TeeWriteTextChunk(Sink, Chunk);
+            }
+        }
+
+        InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&Sink->ChunksConsumed);
+        SetEvent(TeeContext->SpaceEvent);
+    }
+
+    return 0;
+}
+
+/**
+ Wait until the chunk that will be produced next is no longer needed by
+ any sink.  Only a sink that is a full ring behind the input causes a
+ wait, so other sinks continue writing while it catches up.
+
+ @param TeeContext Pointer to the context describing the ring buffer.
+
+ @return Pointer to the chunk to populate.
+ */
+PTEE_CHUNK
+TeeWaitForFreeChunk(
+    __in PTEE_CONTEXT TeeContext
+    )
+{
+    DWORD Index;
+    BOOLEAN Full;
+
+    while (TRUE) {
+        Full = FALSE;
+        for (Index = 0; Index < TEE_SINK_COUNT; Index++) {
+            if ((DWORD)(TeeContext->ChunksProduced - TeeContext->Sinks[Index].ChunksConsumed) >= TEE_RING_CHUNK_COUNT) {
+                Full = TRUE;
+                break;
+            }
+        }
+
+        if (!Full) {
+            break;
+        }
+
+        WaitForSingleObject(TeeContext->SpaceEvent, INFINITE);
+    }
+
+    return &TeeContext->Chunks[(DWORD)TeeContext->ChunksProduced % TEE_RING_CHUNK_COUNT];
+}
+
+/**
+ Return TRUE if the ring buffer has room for a chunk after the one that is
+ currently being populated.  While this is true, there is no benefit to
+ holding data back to make a larger chunk.
+
+ @param TeeContext Pointer to the context describing the ring buffer.
+
+ @return TRUE if another chunk can be populated without waiting.
+ */
+BOOLEAN
+TeeIsChunkAvailable(
+    __in PTEE_CONTEXT TeeContext
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < TEE_SINK_COUNT; Index++) {
+        if ((DWORD)(TeeContext->ChunksProduced + 1 - TeeContext->Sinks[Index].ChunksConsumed) >= TEE_RING_CHUNK_COUNT) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Make the chunk that has been populated available to all sinks.
+
+ @param TeeContext Pointer to the context describing the ring buffer.
+ */
+VOID
+TeePublishChunk(
+    __in PTEE_CONTEXT TeeContext
+    )
+{
+    DWORD Index;
+
+    InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&TeeContext->ChunksProduced);
+    for (Index = 0; Index < TEE_SINK_COUNT; Index++) {
+        SetEvent(TeeContext->Sinks[Index].DataEvent);
+    }
+}
+
+/**
+ Read input as lines of text and place them in the ring buffer.  Each chunk
+ is made available as soon as there is room for another, so output is not
+ delayed; when a sink falls behind, lines are collected into larger chunks
+ until it catches up.
 
  @param hSource Handle to the source.
 
- @param TeeContext Pointer to the context for the operation, including a
-        handle to the output stream to write data to.
+ @param TeeContext Pointer to the context describing the ring buffer.
 
  @return TRUE to indicate success or FALSE to indicate failure.
  */
 BOOL
-TeeProcessStream(
+TeeReadText(
     __in HANDLE hSource,
     __in PTEE_CONTEXT TeeContext
     )
 {
     PVOID LineContext = NULL;
-    DWORD Junk;
     YORI_STRING LineString;
-    HANDLE StdOutHandle;
-    BOOLEAN StdOutIsConsole;
-
-    StdOutIsConsole = FALSE;
-
-    StdOutHandle = GetStdHandle(STD_OUTPUT_HANDLE);
-    if (GetConsoleMode(StdOutHandle, &Junk)) {
-        StdOutIsConsole = TRUE;
-    }
+    PTEE_CHUNK Chunk;
+    PUCHAR NewBuffer;
+    DWORD BytesNeeded;
+    BOOL Result;
 
     YoriLibInitEmptyString(&LineString);
+    Result = TRUE;
+    Chunk = TeeWaitForFreeChunk(TeeContext);
+    Chunk->BytesPopulated = 0;
 
     while (TRUE) {
 
@@ -151,16 +453,208 @@ TeeProcessStream(
             break;
         }
 
-        TeeWriteLine(StdOutHandle, StdOutIsConsole, &LineString);
-        TeeWriteLine(TeeContext->hFile, TeeContext->FileIsConsole, &LineString);
+        BytesNeeded = (LineString.LengthInChars + 1) * sizeof(TCHAR);
+
+        //
+        //  If the line doesn't fit in the current chunk, send the current
+        //  chunk.  If it doesn't fit in an empty chunk either, the chunk
+        //  needs to be larger.
+        //
+
+        if (Chunk->BytesPopulated + BytesNeeded > Chunk->BufferSize &&
+            Chunk->BytesPopulated > 0) {
+
+            TeePublishChunk(TeeContext);
+            Chunk = TeeWaitForFreeChunk(TeeContext);
+            Chunk->BytesPopulated = 0;
+        }
+
+        if (BytesNeeded > Chunk->BufferSize) {
+            NewBuffer = YoriLibMalloc(BytesNeeded);
+            if (NewBuffer == NULL) {
+                Result = FALSE;
+                break;
+            }
+            YoriLibFree(Chunk->Buffer);
+            Chunk->Buffer = NewBuffer;
+            Chunk->BufferSize = BytesNeeded;
+        }
+
+        memcpy(Chunk->Buffer + Chunk->BytesPopulated, LineString.StartOfString, LineString.LengthInChars * sizeof(TCHAR));
+        Chunk->BytesPopulated = Chunk->BytesPopulated + BytesNeeded;
+        ((LPTSTR)(Chunk->Buffer + Chunk->BytesPopulated))[-1] = '\n';
+
+        if (TeeIsChunkAvailable(TeeContext)) {
+            TeePublishChunk(TeeContext);
+            Chunk = TeeWaitForFreeChunk(TeeContext);
+            Chunk->BytesPopulated = 0;
+        }
+    }
+
+    if (Chunk->BytesPopulated > 0) {
+        TeePublishChunk(TeeContext);
     }
 
     YoriLibLineReadCloseOrCache(LineContext);
     YoriLibFreeStringContents(&LineString);
 
+    return Result;
+}
+
+/**
+ Read input without interpreting it and place it in the ring buffer.  Each
+ read is made available to sinks as soon as it completes.
+
+ @param hSource Handle to the source.
+
+ @param TeeContext Pointer to the context describing the ring buffer.
+
+ @return TRUE to indicate success or FALSE to indicate failure.
+ */
+BOOL
+TeeReadBinary(
+    __in HANDLE hSource,
+    __in PTEE_CONTEXT TeeContext
+    )
+{
+    PTEE_CHUNK Chunk;
+    DWORD BytesRead;
+
+    while (TRUE) {
+        Chunk = TeeWaitForFreeChunk(TeeContext);
+        if (!ReadFile(hSource, Chunk->Buffer, Chunk->BufferSize, &BytesRead, NULL) ||
+            BytesRead == 0) {
+
+            break;
+        }
+
+        Chunk->BytesPopulated = BytesRead;
+        TeePublishChunk(TeeContext);
+    }
+
     return TRUE;
 }
 
+/**
+ Process a single stream.  Input is read on this thread and placed in a
+ ring buffer, and each output device is written to by its own thread, so
+ a slow device does not delay reading input until it is a full ring behind.
+
+ @param hSource Handle to the source.
+
+ @param TeeContext Pointer to the context for the operation, including a
+        handle to the output stream to write data to.
+
+ @return TRUE to indicate success or FALSE to indicate failure.
+ */
+BOOL
+TeeProcessStream(
+    __in HANDLE hSource,
+    __in PTEE_CONTEXT TeeContext
+    )
+{
+    DWORD Junk;
+    DWORD Index;
+    DWORD ThreadId;
+    DWORD ThreadCount;
+    HANDLE Threads[TEE_SINK_COUNT];
+    BOOL Result;
+
+    Result = FALSE;
+    ThreadCount = 0;
+    TeeContext->ChunksProduced = 0;
+    TeeContext->InputComplete = FALSE;
+
+    TeeContext->Sinks[0].hDevice = GetStdHandle(STD_OUTPUT_HANDLE);
+    TeeContext->Sinks[0].IsConsole = FALSE;
+    if (GetConsoleMode(TeeContext->Sinks[0].hDevice, &Junk)) {
+        TeeContext->Sinks[0].IsConsole = TRUE;
+    }
+
+    TeeContext->Sinks[1].hDevice = TeeContext->hFile;
+    TeeContext->Sinks[1].IsConsole = TeeContext->FileIsConsole;
+
+    TeeContext->SpaceEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (TeeContext->SpaceEvent == NULL) {
+        goto Cleanup;
+    }
+
+    for (Index = 0; Index < TEE_RING_CHUNK_COUNT; Index++) {
+        TeeContext->Chunks[Index].Buffer = YoriLibMalloc(TEE_RING_CHUNK_SIZE);
+        if (TeeContext->Chunks[Index].Buffer == NULL) {
+            goto Cleanup;
+        }
+        TeeContext->Chunks[Index].BufferSize = TEE_RING_CHUNK_SIZE;
+        TeeContext->Chunks[Index].BytesPopulated = 0;
+    }
+
+    for (Index = 0; Index < TEE_SINK_COUNT; Index++) {
+        TeeContext->Sinks[Index].TeeContext = TeeContext;
+        TeeContext->Sinks[Index].ChunksConsumed = 0;
+        TeeContext->Sinks[Index].WriteFailed = FALSE;
+        TeeContext->Sinks[Index].DataEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (TeeContext->Sinks[Index].DataEvent == NULL) {
+            goto Cleanup;
+        }
+    }
+
+    for (Index = 0; Index < TEE_SINK_COUNT; Index++) {
+        TeeContext->Sinks[Index].hThread = CreateThread(NULL, 0, TeeSinkThread, &TeeContext->Sinks[Index], 0, &ThreadId);
+        if (TeeContext->Sinks[Index].hThread == NULL) {
+            goto Cleanup;
+        }
+        Threads[ThreadCount] = TeeContext->Sinks[Index].hThread;
+        ThreadCount++;
+    }
+
+    if (TeeContext->BinaryMode) {
+        Result = TeeReadBinary(hSource, TeeContext);
+    } else {
+        Result = TeeReadText(hSource, TeeContext);
+    }
+
+Cleanup:
+
+    //
+    //  Tell any threads that were started that there is no more input and
+    //  wait for them to finish writing what they have.
+    //
+
+    InterlockedExchange((INTERLOCKED_VOLATILE LONG *)&TeeContext->InputComplete, TRUE);
+    for (Index = 0; Index < ThreadCount; Index++) {
+        SetEvent(TeeContext->Sinks[Index].DataEvent);
+    }
+
+    if (ThreadCount > 0) {
+        WaitForMultipleObjects(ThreadCount, Threads, TRUE, INFINITE);
+    }
+
+    for (Index = 0; Index < TEE_SINK_COUNT; Index++) {
+        if (TeeContext->Sinks[Index].hThread != NULL) {
+            CloseHandle(TeeContext->Sinks[Index].hThread);
+            TeeContext->Sinks[Index].hThread = NULL;
+        }
+        if (TeeContext->Sinks[Index].DataEvent != NULL) {
+            CloseHandle(TeeContext->Sinks[Index].DataEvent);
+            TeeContext->Sinks[Index].DataEvent = NULL;
+        }
+    }
+
+    for (Index = 0; Index < TEE_RING_CHUNK_COUNT; Index++) {
+        if (TeeContext->Chunks[Index].Buffer != NULL) {
+            YoriLibFree(TeeContext->Chunks[Index].Buffer);
+            TeeContext->Chunks[Index].Buffer = NULL;
+        }
+    }
+
+    if (TeeContext->SpaceEvent != NULL) {
+        CloseHandle(TeeContext->SpaceEvent);
+        TeeContext->SpaceEvent = NULL;
+    }
+
+    return Result;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the tee builtin command.
@@ -212,11 +706,14 @@ ENTRYPOINT(
                 TeeHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2017-2023"));
+                YoriLibDisplayMitLicense(_T("2017-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("a")) == 0) {
                 Append = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
+                TeeContext.BinaryMode = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("c")) == 0) {
                 Console = TRUE;
                 ArgumentUnderstood = TRUE;
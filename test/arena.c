@@ -0,0 +1,191 @@
+/**
+ * @file test/arena.c
+ *
+ * Yori shell test arena allocations
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ The number of bytes in each regular chunk of the arena used by the test.
+ */
+#define TEST_ARENA_CHUNK_SIZE (1024)
+
+/**
+ The number of small allocations to make from the arena.  This is enough to
+ span several chunks.
+ */
+#define TEST_ARENA_ALLOCATION_COUNT (200)
+
+/**
+ Allocate a set of small buffers of varying sizes from an arena, fill each
+ with a pattern, and check that no buffer was overwritten by another.
+
+ @param Arena Pointer to the arena.
+
+ @param Buffers Pointer to an array of TEST_ARENA_ALLOCATION_COUNT elements
+        to populate with the allocations.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestArenaFill(
+    __inout PYORI_LIB_ARENA Arena,
+    __out PUCHAR *Buffers
+    )
+{
+    DWORD Index;
+    DWORD Size;
+    DWORD Offset;
+
+    for (Index = 0; Index < TEST_ARENA_ALLOCATION_COUNT; Index++) {
+        Size = Index % 37 + 1;
+        Buffers[Index] = YoriLibArenaAlloc(Arena, Size);
+        if (Buffers[Index] == NULL) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibArenaAlloc failed\n"), __FILE__, __LINE__);
+            return FALSE;
+        }
+
+        if (((DWORD_PTR)Buffers[Index] & (sizeof(YORI_MAX_UNSIGNED_T) - 1)) != 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation %i is not aligned\n"), __FILE__, __LINE__, Index);
+            return FALSE;
+        }
+
+        memset(Buffers[Index], (UCHAR)Index, Size);
+    }
+
+    for (Index = 0; Index < TEST_ARENA_ALLOCATION_COUNT; Index++) {
+        Size = Index % 37 + 1;
+        for (Offset = 0; Offset < Size; Offset++) {
+            if (Buffers[Index][Offset] != (UCHAR)Index) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation %i was overwritten\n"), __FILE__, __LINE__, Index);
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Allocate small buffers, large buffers and strings from an arena, and check
+ that regular chunks are reused after a reset.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestArena(VOID)
+{
+    YORI_LIB_ARENA Arena;
+    PUCHAR Buffers[TEST_ARENA_ALLOCATION_COUNT];
+    PUCHAR FirstBuffer;
+    PUCHAR Large;
+    YORI_STRING String;
+    DWORD Index;
+    BOOLEAN Result;
+
+    YoriLibArenaCreate(&Arena, TEST_ARENA_CHUNK_SIZE);
+    Result = FALSE;
+
+    if (!TestArenaFill(&Arena, Buffers)) {
+        goto Exit;
+    }
+
+    //
+    //  An allocation larger than a chunk gets a chunk of its own, and
+    //  should not disturb allocations that have already been made.
+    //
+
+    Large = YoriLibArenaAlloc(&Arena, TEST_ARENA_CHUNK_SIZE * 4);
+    if (Large == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibArenaAlloc failed\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+    memset(Large, 0xFF, TEST_ARENA_CHUNK_SIZE * 4);
+
+    for (Index = 0; Index < TEST_ARENA_ALLOCATION_COUNT; Index++) {
+        if (Buffers[Index][0] != (UCHAR)Index) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation %i was overwritten\n"), __FILE__, __LINE__, Index);
+            goto Exit;
+        }
+    }
+
+    //
+    //  A string from the arena holds no reference, so freeing it should
+    //  leave the arena's memory alone.
+    //
+
+    if (!YoriLibArenaAllocateString(&Arena, &String, 16)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibArenaAllocateString failed\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    if (String.MemoryToFree != NULL || String.LengthAllocated != 16) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i arena string is not as expected\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+    String.StartOfString[0] = 'a';
+    String.LengthInChars = 1;
+    YoriLibFreeStringContents(&String);
+
+    //
+    //  After a reset, regular chunks are retained, so the first allocation
+    //  should come from memory the arena already owns.
+    //
+
+    FirstBuffer = Buffers[0];
+    YoriLibArenaReset(&Arena);
+    if (Arena.Chunks != NULL || Arena.FreeChunks == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i reset did not retain chunks\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    if (!TestArenaFill(&Arena, Buffers)) {
+        goto Exit;
+    }
+
+    for (Index = 0; Index < TEST_ARENA_ALLOCATION_COUNT; Index++) {
+        if (Buffers[Index] == FirstBuffer) {
+            break;
+        }
+    }
+
+    if (Index == TEST_ARENA_ALLOCATION_COUNT) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i reset chunks were not reused\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    Result = TRUE;
+
+Exit:
+    YoriLibArenaDestroy(&Arena);
+    if (Result && (Arena.Chunks != NULL || Arena.FreeChunks != NULL)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i destroy did not release chunks\n"), __FILE__, __LINE__);
+        Result = FALSE;
+    }
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
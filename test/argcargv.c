@@ -3,7 +3,7 @@
  *
  * Yori shell test entrypoint parsing
  *
- * Copyright (c) 2022 Malcolm J. Smith
+ * Copyright (c) 2022-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -422,5 +422,74 @@ TestArgBackslashEscapeCmd(VOID)
     return TRUE;
 }
 
+/**
+ A test variation to parse a command into fewer arguments than it contains,
+ so that trailing arguments are joined with the final argument.
+ */
+BOOLEAN
+TestArgMaxArgsCmd(VOID)
+{
+    LPCTSTR InputString = _T("  foo   bar  \"baz qux\"  ");
+    PYORI_STRING ArgV;
+    YORI_ALLOC_SIZE_T ArgC;
+    PBOOLEAN ArgQuotes;
+
+    ArgV = YoriLibCmdlineToArgcArgv(InputString, 2, FALSE, &ArgC, &ArgQuotes);
+    if (ArgV == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibCmdlineToArgcArgv failed on '%s'\n"), __FILE__, __LINE__, InputString);
+        return FALSE;
+    }
+
+    if (ArgC != 2) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                      _T("%hs:%i YoriLibCmdlineToArgcArgv returned unexpected ArgC '%s', have %i expected 2\n"),
+                      __FILE__,
+                      __LINE__,
+                      InputString,
+                      ArgC);
+        TestArgCleanupArg(ArgC, ArgV);
+        return FALSE;
+    }
+
+    if (YoriLibCompareStringLit(&ArgV[0], _T("foo")) != 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                      _T("%hs:%i YoriLibCmdlineToArgcArgv returned unexpected ArgV in '%s', have %y expected foo\n"),
+                      __FILE__,
+                      __LINE__,
+                      InputString,
+                      &ArgV[0]);
+        TestArgCleanupArg(ArgC, ArgV);
+        return FALSE;
+    }
+
+    if (YoriLibCompareStringLit(&ArgV[1], _T("bar  baz qux  ")) != 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                      _T("%hs:%i YoriLibCmdlineToArgcArgv returned unexpected ArgV in '%s', have %y expected bar  baz qux  \n"),
+                      __FILE__,
+                      __LINE__,
+                      InputString,
+                      &ArgV[1]);
+        TestArgCleanupArg(ArgC, ArgV);
+        return FALSE;
+    }
+
+    if (ArgQuotes[0] != FALSE ||
+        ArgQuotes[1] == FALSE) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                      _T("%hs:%i YoriLibCmdlineToArgcArgv returned unexpected quote state in '%s', have %i, %i expected 0, 1\n"),
+                      __FILE__,
+                      __LINE__,
+                      InputString,
+                      ArgQuotes[0],
+                      ArgQuotes[1]);
+        TestArgCleanupArg(ArgC, ArgV);
+        return FALSE;
+    }
+
+    TestArgCleanupArg(ArgC, ArgV);
+
+    return TRUE;
+}
+
 
 // vim:sw=4:ts=4:et:
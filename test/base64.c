@@ -0,0 +1,194 @@
+/**
+ * @file test/base64.c
+ *
+ * Yori shell test base64 encoding
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ The number of bytes used by the test when encoding and decoding in pieces.
+ */
+#define TEST_BASE64_BUFFER_SIZE (1000)
+
+/**
+ The input for the known answer test.
+ */
+CHAR TestBase64Input[] = "foobar";
+
+/**
+ The expected encoding of each prefix of TestBase64Input, from RFC 4648.
+ */
+LPCSTR TestBase64Expected[] = {
+    "",
+    "Zg==",
+    "Zm8=",
+    "Zm9v",
+    "Zm9vYg==",
+    "Zm9vYmE=",
+    "Zm9vYmFy"
+};
+
+/**
+ Decode a complete base64 string, supplying it a specified number of
+ characters at a time.
+
+ @param Input Pointer to the characters to decode.
+
+ @param InputLength The number of characters in Input.
+
+ @param Step The number of characters to supply to each call.
+
+ @param Output Pointer to a buffer to receive the decoded data.  This must be
+        at least YORI_LIB_BASE64_DECODED_LENGTH(InputLength) bytes.
+
+ @param OutputLength On successful completion, updated to contain the number
+        of bytes written to Output.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestBase64DecodeInPieces(
+    __in PUCHAR Input,
+    __in YORI_ALLOC_SIZE_T InputLength,
+    __in YORI_ALLOC_SIZE_T Step,
+    __out PUCHAR Output,
+    __out PYORI_ALLOC_SIZE_T OutputLength
+    )
+{
+    YORI_LIB_BASE64_DECODE_STATE State;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T Length;
+    YORI_ALLOC_SIZE_T BytesWritten;
+    YORI_ALLOC_SIZE_T TotalWritten;
+
+    YoriLibBase64DecodeInitialize(&State);
+    TotalWritten = 0;
+
+    for (Offset = 0; Offset < InputLength; Offset = Offset + Length) {
+        Length = Step;
+        if (Offset + Length > InputLength) {
+            Length = InputLength - Offset;
+        }
+
+        if (!YoriLibBase64Decode(&State, &Input[Offset], Length, &Output[TotalWritten], &BytesWritten)) {
+            return FALSE;
+        }
+        TotalWritten = TotalWritten + BytesWritten;
+    }
+
+    if (!YoriLibBase64DecodeFinalize(&State, &Output[TotalWritten], &BytesWritten)) {
+        return FALSE;
+    }
+
+    *OutputLength = TotalWritten + BytesWritten;
+    return TRUE;
+}
+
+/**
+ A test variation to base64 encode known strings, and check that data which
+ is encoded and decoded in pieces of different sizes is unchanged.
+ */
+BOOLEAN
+TestBase64(VOID)
+{
+    UCHAR Source[TEST_BASE64_BUFFER_SIZE];
+    UCHAR Encoded[YORI_LIB_BASE64_ENCODED_LENGTH(TEST_BASE64_BUFFER_SIZE) + 2];
+    UCHAR Decoded[YORI_LIB_BASE64_DECODED_LENGTH(sizeof(Encoded))];
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T EncodedLength;
+    YORI_ALLOC_SIZE_T DecodedLength;
+    YORI_ALLOC_SIZE_T Step;
+    DWORD Seed;
+
+    for (Index = 0; Index < sizeof(TestBase64Expected)/sizeof(TestBase64Expected[0]); Index++) {
+        EncodedLength = YoriLibBase64Encode((PUCHAR)TestBase64Input, Index, Encoded);
+        if (EncodedLength != strlen(TestBase64Expected[Index]) ||
+            memcmp(Encoded, TestBase64Expected[Index], EncodedLength) != 0) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i encoding %i bytes returned unexpected data\n"), __FILE__, __LINE__, Index);
+            return FALSE;
+        }
+
+        if (!TestBase64DecodeInPieces(Encoded, EncodedLength, 1, Decoded, &DecodedLength) ||
+            DecodedLength != Index ||
+            memcmp(Decoded, TestBase64Input, Index) != 0) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i decoding %i bytes returned unexpected data\n"), __FILE__, __LINE__, Index);
+            return FALSE;
+        }
+    }
+
+    Seed = 0x12345678;
+    for (Index = 0; Index < TEST_BASE64_BUFFER_SIZE; Index++) {
+        Seed = Seed * 1103515245 + 12345;
+        Source[Index] = (UCHAR)(Seed >> 16);
+    }
+
+    //
+    //  Encode in pieces that are a multiple of three bytes, and insert a
+    //  line break partway through, which decoding should ignore.
+    //
+
+    EncodedLength = 0;
+    for (Index = 0; Index < TEST_BASE64_BUFFER_SIZE; Index = Index + Step) {
+        Step = 48;
+        if (Index + Step > TEST_BASE64_BUFFER_SIZE) {
+            Step = TEST_BASE64_BUFFER_SIZE - Index;
+        }
+        EncodedLength = EncodedLength + YoriLibBase64Encode(&Source[Index], Step, &Encoded[EncodedLength]);
+        if (Index == 480) {
+            Encoded[EncodedLength] = '\r';
+            Encoded[EncodedLength + 1] = '\n';
+            EncodedLength = EncodedLength + 2;
+        }
+    }
+
+    for (Step = 1; Step < 10; Step++) {
+        if (!TestBase64DecodeInPieces(Encoded, EncodedLength, Step, Decoded, &DecodedLength) ||
+            DecodedLength != TEST_BASE64_BUFFER_SIZE ||
+            memcmp(Decoded, Source, TEST_BASE64_BUFFER_SIZE) != 0) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i decoding in pieces of %i returned unexpected data\n"), __FILE__, __LINE__, Step);
+            return FALSE;
+        }
+    }
+
+    //
+    //  Data after padding, or padding in the wrong place, is invalid.
+    //
+
+    if (TestBase64DecodeInPieces((PUCHAR)"Zg==Zg==", 8, 8, Decoded, &DecodedLength) ||
+        TestBase64DecodeInPieces((PUCHAR)"Z===", 4, 4, Decoded, &DecodedLength) ||
+        TestBase64DecodeInPieces((PUCHAR)"Zm9v*", 5, 5, Decoded, &DecodedLength)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i invalid data decoded successfully\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,1312 @@
+/**
+ * @file test/bench.c
+ *
+ * Yori shell benchmark suite
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yorish.h>
+
+/**
+ Help text to display to the user.
+ */
+const
+CHAR strBenchHelpText[] =
+        "\n"
+        "Run benchmarks.\n"
+        "\n"
+        "YBENCH [-license] [-baseline file] [-e cmd] [-save file] [-v Variation]\n"
+        "       [-x Variation]\n"
+        "\n"
+        "   -baseline      Compare results against a file saved with -save\n"
+        "   -e             Time a command as an end to end scenario\n"
+        "   -save          Save results to a file\n"
+        "   -v             Variation to include\n"
+        "   -x             Variation to exclude\n"
+        "\n"
+        "Supported variations:\n";
+
+/**
+ The number of bytes of synthetic text used by benchmarks.
+ */
+#define BENCH_TEXT_SIZE (1024 * 1024)
+
+/**
+ The number of strings sorted in each sort operation.
+ */
+#define BENCH_SORT_COUNT (4096)
+
+/**
+ The number of files created in the directory used for enumeration.
+ */
+#define BENCH_FILE_COUNT (256)
+
+/**
+ The minimum amount of time, in milliseconds, that each timed pass of a
+ benchmark should take.  Iteration counts are doubled until this is
+ reached.
+ */
+#define BENCH_PASS_TIME_MS (50)
+
+/**
+ The number of timed passes of each benchmark.  The fastest pass is
+ reported, which excludes interference from other activity on the system.
+ */
+#define BENCH_PASS_COUNT (5)
+
+/**
+ The maximum number of end to end scenarios specified with -e.
+ */
+#define BENCH_MAX_SCENARIOS (16)
+
+/**
+ Specifies the function signature for a benchmark.  The function should
+ perform the measured operation Iterations times.
+ */
+typedef
+BOOLEAN
+BENCH_FN(
+    __in DWORD Iterations,
+    __in_opt PVOID Context
+    );
+
+/**
+ A pointer to a benchmark.
+ */
+typedef BENCH_FN *PBENCH_FN;
+
+/**
+ A structure to describe a benchmark variation.
+ */
+typedef struct _BENCH_VARIATION {
+
+    /**
+     The function to call to invoke the variation.
+     */
+    PBENCH_FN Fn;
+
+    /**
+     The name of the variation.
+     */
+    LPCTSTR Name;
+
+    /**
+     Context to pass to the function.
+     */
+    PVOID Context;
+
+    /**
+     The number of bytes processed by each operation, if the benchmark
+     processes data.  This is populated when synthetic data is generated.
+     */
+    DWORDLONG BytesPerOp;
+
+    /**
+     The time taken by each operation in nanoseconds, populated when the
+     benchmark has run.
+     */
+    DWORDLONG NsPerOp;
+
+    /**
+     Set to TRUE if the variation was explicitly specified by the user.
+     */
+    BOOLEAN ExplicitlySpecified;
+
+    /**
+     Set to TRUE if the variation was explicitly specified to execute.
+     */
+    BOOLEAN Execute;
+
+    /**
+     Set to TRUE once the benchmark has run successfully.
+     */
+    BOOLEAN Complete;
+
+} BENCH_VARIATION, *PBENCH_VARIATION;
+
+/**
+ Synthetic data shared between benchmarks.
+ */
+typedef struct _BENCH_DATA {
+
+    /**
+     A buffer of text consisting of lines of words.
+     */
+    YORI_STRING Text;
+
+    /**
+     Text containing VT escapes to change color.
+     */
+    YORI_STRING VtText;
+
+    /**
+     An array of substrings within Text, one per line.
+     */
+    PYORI_STRING Lines;
+
+    /**
+     The number of elements in Lines.
+     */
+    YORI_ALLOC_SIZE_T LineCount;
+
+    /**
+     An array of strings which is overwritten from Lines and sorted.
+     */
+    PYORI_STRING SortLines;
+
+    /**
+     An array of strings to search for, which are not found in Text.
+     */
+    YORI_STRING Needles[4];
+
+    /**
+     The name of a file containing Text.
+     */
+    YORI_STRING FileName;
+
+    /**
+     The name of a directory containing BENCH_FILE_COUNT files.
+     */
+    YORI_STRING DirName;
+
+    /**
+     A search criteria to enumerate everything within DirName.
+     */
+    YORI_STRING DirSpec;
+
+    /**
+     A handle to the null device to write output to.
+     */
+    HANDLE hNul;
+
+    /**
+     The result of hashing, recorded so that hashing cannot be optimized
+     away.
+     */
+    DWORD HashResult;
+
+} BENCH_DATA, *PBENCH_DATA;
+
+/**
+ Synthetic data shared between benchmarks.
+ */
+BENCH_DATA BenchData;
+
+/**
+ A command line used for parsing benchmarks.
+ */
+LPCTSTR BenchCmdLine = _T("yori.exe -c \"dir /s c:\\program files\\*.exe\" foo\\bar\\ \"a b\"c ^& baz > out.txt");
+
+/**
+ Words used to construct synthetic text.
+ */
+LPCSTR BenchWords[] = {
+    "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+    "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta",
+    "C:\\Windows\\System32", "0x1234", "12345678", "yori", "shell", "file"
+};
+
+/**
+ Read every line from the synthetic file.
+
+ @param Iterations The number of times to read the file.
+
+ @param Context Unused.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchReadLine(
+    __in DWORD Iterations,
+    __in_opt PVOID Context
+    )
+{
+    HANDLE hFile;
+    PVOID LineContext;
+    YORI_STRING LineString;
+    YORI_LIB_LINE_ENDING LineEnding;
+    BOOL TimeoutReached;
+    DWORD Index;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    for (Index = 0; Index < Iterations; Index++) {
+        hFile = CreateFile(BenchData.FileName.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (hFile == INVALID_HANDLE_VALUE) {
+            return FALSE;
+        }
+
+        LineContext = NULL;
+        YoriLibInitEmptyString(&LineString);
+        while (YoriLibReadLineToStringEx(&LineString, &LineContext, TRUE, INFINITE, hFile, &LineEnding, &TimeoutReached)) {
+        }
+        YoriLibLineReadCloseOrCache(LineContext);
+        YoriLibFreeStringContents(&LineString);
+        CloseHandle(hFile);
+    }
+
+    return TRUE;
+}
+
+/**
+ Hash lines of text.
+
+ @param Iterations The number of lines to hash.
+
+ @param Context Unused.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchHashString(
+    __in DWORD Iterations,
+    __in_opt PVOID Context
+    )
+{
+    DWORD Index;
+    DWORD Hash;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    Hash = 0;
+    for (Index = 0; Index < Iterations; Index++) {
+        Hash = YoriLibHashString32(Hash, &BenchData.Lines[Index % BenchData.LineCount]);
+    }
+
+    //
+    //  Store the result so the compiler cannot discard the work.
+    //
+
+    BenchData.HashResult = Hash;
+    return TRUE;
+}
+
+/**
+ Sort an array of lines of text.  The array is restored to its unsorted
+ order before each sort.
+
+ @param Iterations The number of times to sort the array.
+
+ @param Context Unused.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchSortStrings(
+    __in DWORD Iterations,
+    __in_opt PVOID Context
+    )
+{
+    DWORD Index;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    for (Index = 0; Index < Iterations; Index++) {
+        memcpy(BenchData.SortLines, BenchData.Lines, BENCH_SORT_COUNT * sizeof(YORI_STRING));
+        YoriLibSortStringArray(BenchData.SortLines, BENCH_SORT_COUNT);
+    }
+
+    return TRUE;
+}
+
+/**
+ Search the synthetic text for a set of strings which are not present, so
+ that each search examines the entire text.
+
+ @param Iterations The number of times to search the text.
+
+ @param Context Unused.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchFindSubstr(
+    __in DWORD Iterations,
+    __in_opt PVOID Context
+    )
+{
+    DWORD Index;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    for (Index = 0; Index < Iterations; Index++) {
+        if (YoriLibFindFirstMatchSubstr(&BenchData.Text, sizeof(BenchData.Needles)/sizeof(BenchData.Needles[0]), BenchData.Needles, NULL) != NULL) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Split a command line into arguments.
+
+ @param Iterations The number of times to split the command line.
+
+ @param Context Unused.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchArgcArgv(
+    __in DWORD Iterations,
+    __in_opt PVOID Context
+    )
+{
+    PYORI_STRING ArgV;
+    YORI_ALLOC_SIZE_T ArgC;
+    YORI_ALLOC_SIZE_T ArgIndex;
+    DWORD Index;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    for (Index = 0; Index < Iterations; Index++) {
+        ArgV = YoriLibCmdlineToArgcArgv(BenchCmdLine, (YORI_ALLOC_SIZE_T)-1, TRUE, &ArgC, NULL);
+        if (ArgV == NULL) {
+            return FALSE;
+        }
+        for (ArgIndex = 0; ArgIndex < ArgC; ArgIndex++) {
+            YoriLibFreeStringContents(&ArgV[ArgIndex]);
+        }
+        YoriLibDereference(ArgV);
+    }
+
+    return TRUE;
+}
+
+/**
+ Parse a command line into a shell command context.
+
+ @param Iterations The number of times to parse the command line.
+
+ @param Context Unused.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchShParse(
+    __in DWORD Iterations,
+    __in_opt PVOID Context
+    )
+{
+    YORI_LIBSH_CMD_CONTEXT CmdContext;
+    YORI_STRING InputString;
+    DWORD Index;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    YoriLibConstantString(&InputString, BenchCmdLine);
+    for (Index = 0; Index < Iterations; Index++) {
+        if (!YoriLibShParseCmdlineToCmdContext(&InputString, 0, &CmdContext)) {
+            return FALSE;
+        }
+        YoriLibShFreeCmdContext(&CmdContext);
+    }
+
+    return TRUE;
+}
+
+/**
+ A callback invoked for each file found when enumerating.
+
+ @param FilePath Pointer to the file path found.
+
+ @param FileInfo Information about the file.
+
+ @param Depth Recursion depth, ignored in this application.
+
+ @param Context Pointer to a count of files found.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+BenchFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in_opt PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PDWORD FilesFound;
+
+    UNREFERENCED_PARAMETER(FilePath);
+    UNREFERENCED_PARAMETER(FileInfo);
+    UNREFERENCED_PARAMETER(Depth);
+
+    FilesFound = (PDWORD)Context;
+    (*FilesFound)++;
+    return TRUE;
+}
+
+/**
+ Enumerate the files in the synthetic directory.
+
+ @param Iterations The number of times to enumerate the directory.
+
+ @param Context Unused.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchForEachFile(
+    __in DWORD Iterations,
+    __in_opt PVOID Context
+    )
+{
+    DWORD Index;
+    DWORD FilesFound;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    for (Index = 0; Index < Iterations; Index++) {
+        FilesFound = 0;
+        if (!YoriLibForEachFile(&BenchData.DirSpec, YORILIB_FILEENUM_RETURN_FILES, 0, BenchFileFoundCallback, NULL, &FilesFound)) {
+            return FALSE;
+        }
+        if (FilesFound != BENCH_FILE_COUNT) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Format and write lines of text to the null device.
+
+ @param Iterations The number of lines to write.
+
+ @param Context Unused.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchOutput(
+    __in DWORD Iterations,
+    __in_opt PVOID Context
+    )
+{
+    DWORD Index;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    for (Index = 0; Index < Iterations; Index++) {
+        if (!YoriLibOutputToDevice(BenchData.hNul, 0, _T("%y\n"), &BenchData.Lines[Index % BenchData.LineCount])) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Parse text containing VT escapes and write it to the null device as text
+ without escapes.
+
+ @param Iterations The number of times to process the text.
+
+ @param Context Unused.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchVtParse(
+    __in DWORD Iterations,
+    __in_opt PVOID Context
+    )
+{
+    YORI_LIB_VT_CALLBACK_FUNCTIONS Callbacks;
+    DWORD Index;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    YoriLibUtf8TextNoEscSetFn(&Callbacks);
+    for (Index = 0; Index < Iterations; Index++) {
+        if (!YoriLibProcVtEscOnOpenStream(BenchData.VtText.StartOfString, BenchData.VtText.LengthInChars, BenchData.hNul, &Callbacks)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Launch a command and wait for it to complete.  Output from the command is
+ discarded.
+
+ @param Iterations The number of times to launch the command.
+
+ @param Context Pointer to a NULL terminated string containing the command
+        line to execute.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchScenario(
+    __in DWORD Iterations,
+    __in_opt PVOID Context
+    )
+{
+    YORI_STRING CmdLine;
+    STARTUPINFO StartupInfo;
+    PROCESS_INFORMATION ProcessInfo;
+    DWORD Index;
+
+    if (Context == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  CreateProcess may modify the command line, so operate on a copy.
+    //
+
+    if (!YoriLibAllocateString(&CmdLine, (YORI_ALLOC_SIZE_T)(_tcslen((LPCTSTR)Context) + 1))) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < Iterations; Index++) {
+        CmdLine.LengthInChars = YoriLibSPrintf(CmdLine.StartOfString, _T("%s"), (LPCTSTR)Context);
+
+        ZeroMemory(&StartupInfo, sizeof(StartupInfo));
+        StartupInfo.cb = sizeof(StartupInfo);
+        StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+        StartupInfo.hStdInput = BenchData.hNul;
+        StartupInfo.hStdOutput = BenchData.hNul;
+        StartupInfo.hStdError = BenchData.hNul;
+
+        if (!CreateProcess(NULL, CmdLine.StartOfString, NULL, NULL, TRUE, CREATE_DEFAULT_ERROR_MODE, NULL, NULL, &StartupInfo, &ProcessInfo)) {
+            YoriLibFreeStringContents(&CmdLine);
+            return FALSE;
+        }
+
+        WaitForSingleObject(ProcessInfo.hProcess, INFINITE);
+        CloseHandle(ProcessInfo.hProcess);
+        CloseHandle(ProcessInfo.hThread);
+    }
+
+    YoriLibFreeStringContents(&CmdLine);
+    return TRUE;
+}
+
+/**
+ A list of benchmark variations to execute.
+ */
+BENCH_VARIATION BenchVariations[] = {
+    {BenchReadLine,                        _T("ReadLine")},
+    {BenchHashString,                      _T("HashString")},
+    {BenchSortStrings,                     _T("SortStrings")},
+    {BenchFindSubstr,                      _T("FindSubstr")},
+    {BenchArgcArgv,                        _T("ArgcArgv")},
+    {BenchShParse,                         _T("ShParse")},
+    {BenchForEachFile,                     _T("ForEachFile")},
+    {BenchOutput,                          _T("Output")},
+    {BenchVtParse,                         _T("VtParse")},
+};
+
+/**
+ Free synthetic data.
+ */
+VOID
+BenchCleanupData(VOID)
+{
+    YORI_STRING FileName;
+    DWORD Index;
+
+    if (BenchData.DirName.StartOfString != NULL) {
+        if (YoriLibAllocateString(&FileName, BenchData.DirName.LengthInChars + 16)) {
+            for (Index = 0; Index < BENCH_FILE_COUNT; Index++) {
+                YoriLibSPrintf(FileName.StartOfString, _T("%y\\f%i.txt"), &BenchData.DirName, Index);
+                DeleteFile(FileName.StartOfString);
+            }
+            YoriLibFreeStringContents(&FileName);
+        }
+        RemoveDirectory(BenchData.DirName.StartOfString);
+    }
+
+    if (BenchData.FileName.StartOfString != NULL) {
+        DeleteFile(BenchData.FileName.StartOfString);
+    }
+
+    if (BenchData.hNul != NULL && BenchData.hNul != INVALID_HANDLE_VALUE) {
+        CloseHandle(BenchData.hNul);
+    }
+
+    YoriLibFreeStringContents(&BenchData.DirSpec);
+    YoriLibFreeStringContents(&BenchData.DirName);
+    YoriLibFreeStringContents(&BenchData.FileName);
+    YoriLibFreeStringContents(&BenchData.VtText);
+    YoriLibFreeStringContents(&BenchData.Text);
+    if (BenchData.Lines != NULL) {
+        YoriLibFree(BenchData.Lines);
+    }
+    if (BenchData.SortLines != NULL) {
+        YoriLibFree(BenchData.SortLines);
+    }
+    ZeroMemory(&BenchData, sizeof(BenchData));
+}
+
+/**
+ Generate synthetic data used by benchmarks, and record the number of bytes
+ processed by each operation.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchInitializeData(VOID)
+{
+    YORI_STRING TempPath;
+    YORI_STRING Prefix;
+    YORI_STRING FileName;
+    HANDLE hFile;
+    PUCHAR FileBuffer;
+    DWORD BytesWritten;
+    DWORD Seed;
+    DWORD Index;
+    DWORD WordIndex;
+    DWORD LineLength;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T LineStart;
+    YORI_ALLOC_SIZE_T WordLength;
+    PBENCH_VARIATION Variation;
+
+    ZeroMemory(&BenchData, sizeof(BenchData));
+
+    BenchData.hNul = CreateFile(_T("NUL"), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+    if (BenchData.hNul == INVALID_HANDLE_VALUE) {
+        BenchData.hNul = NULL;
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(&BenchData.Text, BENCH_TEXT_SIZE + 64) ||
+        !YoriLibAllocateString(&BenchData.VtText, BENCH_TEXT_SIZE + 64)) {
+
+        BenchCleanupData();
+        return FALSE;
+    }
+
+    //
+    //  Generate lines of pseudorandom words.  Each line is between 20 and
+    //  100 characters.
+    //
+
+    Seed = 0x12345678;
+    Offset = 0;
+    BenchData.LineCount = 0;
+    while (Offset < BENCH_TEXT_SIZE) {
+        Seed = Seed * 1103515245 + 12345;
+        LineLength = 20 + ((Seed >> 16) % 80);
+        LineStart = Offset;
+        while (Offset - LineStart < LineLength && Offset < BENCH_TEXT_SIZE) {
+            Seed = Seed * 1103515245 + 12345;
+            WordIndex = (Seed >> 16) % (sizeof(BenchWords)/sizeof(BenchWords[0]));
+            WordLength = (YORI_ALLOC_SIZE_T)strlen(BenchWords[WordIndex]);
+            for (Index = 0; Index < WordLength; Index++) {
+                BenchData.Text.StartOfString[Offset++] = BenchWords[WordIndex][Index];
+            }
+            BenchData.Text.StartOfString[Offset++] = ' ';
+        }
+        BenchData.Text.StartOfString[Offset - 1] = '\n';
+        BenchData.LineCount++;
+    }
+    BenchData.Text.LengthInChars = Offset;
+
+    BenchData.Lines = YoriLibMalloc(BenchData.LineCount * sizeof(YORI_STRING));
+    BenchData.SortLines = YoriLibMalloc(BENCH_SORT_COUNT * sizeof(YORI_STRING));
+    if (BenchData.Lines == NULL || BenchData.SortLines == NULL || BenchData.LineCount < BENCH_SORT_COUNT) {
+        BenchCleanupData();
+        return FALSE;
+    }
+
+    LineStart = 0;
+    WordIndex = 0;
+    for (Offset = 0; Offset < BenchData.Text.LengthInChars; Offset++) {
+        if (BenchData.Text.StartOfString[Offset] == '\n') {
+            YoriLibInitEmptyString(&BenchData.Lines[WordIndex]);
+            BenchData.Lines[WordIndex].StartOfString = &BenchData.Text.StartOfString[LineStart];
+            BenchData.Lines[WordIndex].LengthInChars = Offset - LineStart;
+            WordIndex++;
+            LineStart = Offset + 1;
+        }
+    }
+
+    //
+    //  Generate text with escapes by coloring each word in the text.
+    //
+
+    Offset = 0;
+    WordIndex = 0;
+    for (Index = 0; Index < BenchData.Text.LengthInChars && Offset + 16 < BENCH_TEXT_SIZE; Index++) {
+        if (Index == 0 || BenchData.Text.StartOfString[Index - 1] == ' ') {
+            Offset = Offset + YoriLibSPrintf(&BenchData.VtText.StartOfString[Offset], _T("%c[%im"), 27, 31 + (WordIndex % 7));
+            WordIndex++;
+        }
+        BenchData.VtText.StartOfString[Offset++] = BenchData.Text.StartOfString[Index];
+    }
+    BenchData.VtText.LengthInChars = Offset;
+
+    YoriLibConstantString(&BenchData.Needles[0], _T("needle"));
+    YoriLibConstantString(&BenchData.Needles[1], _T("haystack"));
+    YoriLibConstantString(&BenchData.Needles[2], _T("brown cow"));
+    YoriLibConstantString(&BenchData.Needles[3], _T("\\Temp\\"));
+
+    //
+    //  Write the text to a temporary file, and create a temporary directory
+    //  of empty files.
+    //
+
+    if (!YoriLibGetTempPath(&TempPath, 0)) {
+        BenchCleanupData();
+        return FALSE;
+    }
+
+    YoriLibConstantString(&Prefix, _T("YBN"));
+    if (!YoriLibGetTempFileName(&TempPath, &Prefix, &hFile, &BenchData.FileName)) {
+        YoriLibFreeStringContents(&TempPath);
+        BenchCleanupData();
+        return FALSE;
+    }
+
+    FileBuffer = YoriLibMalloc(BenchData.Text.LengthInChars);
+    if (FileBuffer == NULL) {
+        CloseHandle(hFile);
+        YoriLibFreeStringContents(&TempPath);
+        BenchCleanupData();
+        return FALSE;
+    }
+
+    for (Offset = 0; Offset < BenchData.Text.LengthInChars; Offset++) {
+        FileBuffer[Offset] = (UCHAR)BenchData.Text.StartOfString[Offset];
+    }
+
+    if (!WriteFile(hFile, FileBuffer, BenchData.Text.LengthInChars, &BytesWritten, NULL)) {
+        YoriLibFree(FileBuffer);
+        CloseHandle(hFile);
+        YoriLibFreeStringContents(&TempPath);
+        BenchCleanupData();
+        return FALSE;
+    }
+    YoriLibFree(FileBuffer);
+    CloseHandle(hFile);
+
+    if (!YoriLibGetTempFileName(&TempPath, &Prefix, NULL, &BenchData.DirName)) {
+        YoriLibFreeStringContents(&TempPath);
+        BenchCleanupData();
+        return FALSE;
+    }
+    YoriLibFreeStringContents(&TempPath);
+
+    DeleteFile(BenchData.DirName.StartOfString);
+    if (!CreateDirectory(BenchData.DirName.StartOfString, NULL)) {
+        YoriLibFreeStringContents(&BenchData.DirName);
+        BenchCleanupData();
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(&FileName, BenchData.DirName.LengthInChars + 16)) {
+        BenchCleanupData();
+        return FALSE;
+    }
+
+    for (Index = 0; Index < BENCH_FILE_COUNT; Index++) {
+        YoriLibSPrintf(FileName.StartOfString, _T("%y\\f%i.txt"), &BenchData.DirName, Index);
+        hFile = CreateFile(FileName.StartOfString, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hFile == INVALID_HANDLE_VALUE) {
+            YoriLibFreeStringContents(&FileName);
+            BenchCleanupData();
+            return FALSE;
+        }
+        CloseHandle(hFile);
+    }
+    YoriLibFreeStringContents(&FileName);
+
+    YoriLibYPrintf(&BenchData.DirSpec, _T("%y\\*"), &BenchData.DirName);
+    if (BenchData.DirSpec.StartOfString == NULL) {
+        BenchCleanupData();
+        return FALSE;
+    }
+
+    //
+    //  Record the amount of data processed by each operation, so that
+    //  throughput can be reported.
+    //
+
+    for (Index = 0; Index < sizeof(BenchVariations)/sizeof(BenchVariations[0]); Index++) {
+        Variation = &BenchVariations[Index];
+        if (Variation->Fn == BenchReadLine) {
+            Variation->BytesPerOp = BenchData.Text.LengthInChars;
+        } else if (Variation->Fn == BenchHashString ||
+                   Variation->Fn == BenchOutput) {
+
+            Variation->BytesPerOp = (BenchData.Text.LengthInChars * sizeof(TCHAR)) / BenchData.LineCount;
+        } else if (Variation->Fn == BenchFindSubstr) {
+            Variation->BytesPerOp = BenchData.Text.LengthInChars * sizeof(TCHAR);
+        } else if (Variation->Fn == BenchVtParse) {
+            Variation->BytesPerOp = BenchData.VtText.LengthInChars * sizeof(TCHAR);
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Run a benchmark.  The number of iterations is doubled until a pass takes
+ long enough to measure, and the fastest of several passes is recorded.
+
+ @param Variation Pointer to the benchmark to run.  On successful
+        completion, NsPerOp is updated.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchRunVariation(
+    __inout PBENCH_VARIATION Variation
+    )
+{
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER StartTime;
+    LARGE_INTEGER EndTime;
+    DWORDLONG Elapsed;
+    DWORDLONG BestElapsed;
+    DWORDLONG MinimumElapsed;
+    DWORD Iterations;
+    DWORD Pass;
+
+    if (!QueryPerformanceFrequency(&Frequency) || Frequency.QuadPart == 0) {
+        return FALSE;
+    }
+
+    MinimumElapsed = (DWORDLONG)Frequency.QuadPart * BENCH_PASS_TIME_MS / 1000;
+
+    //
+    //  The first pass warms caches and determines the iteration count.
+    //
+
+    Iterations = 1;
+    while (TRUE) {
+        QueryPerformanceCounter(&StartTime);
+        if (!Variation->Fn(Iterations, Variation->Context)) {
+            return FALSE;
+        }
+        QueryPerformanceCounter(&EndTime);
+        Elapsed = (DWORDLONG)(EndTime.QuadPart - StartTime.QuadPart);
+        if (Elapsed >= MinimumElapsed || Iterations >= 0x40000000) {
+            break;
+        }
+        Iterations = Iterations * 2;
+    }
+
+    BestElapsed = Elapsed;
+    for (Pass = 0; Pass < BENCH_PASS_COUNT; Pass++) {
+        QueryPerformanceCounter(&StartTime);
+        if (!Variation->Fn(Iterations, Variation->Context)) {
+            return FALSE;
+        }
+        QueryPerformanceCounter(&EndTime);
+        Elapsed = (DWORDLONG)(EndTime.QuadPart - StartTime.QuadPart);
+        if (Elapsed < BestElapsed) {
+            BestElapsed = Elapsed;
+        }
+
+        if (YoriLibIsOperationCancelled()) {
+            return FALSE;
+        }
+    }
+
+    //
+    //  Convert the time to nanoseconds in two parts to avoid overflow with
+    //  high frequency counters.
+    //
+
+    Elapsed = (BestElapsed / (DWORDLONG)Frequency.QuadPart) * 1000000000;
+    Elapsed = Elapsed + (BestElapsed % (DWORDLONG)Frequency.QuadPart) * 1000000000 / (DWORDLONG)Frequency.QuadPart;
+    Variation->NsPerOp = Elapsed / Iterations;
+    Variation->Complete = TRUE;
+    return TRUE;
+}
+
+/**
+ Find the result for a benchmark in a baseline file.
+
+ @param Baseline Pointer to the contents of the baseline file.
+
+ @param Name The name of the benchmark.
+
+ @param NsPerOp On successful completion, updated to contain the time taken
+        by each operation when the baseline was saved.
+
+ @return TRUE if the benchmark was found, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+BenchFindBaseline(
+    __in PYORI_STRING Baseline,
+    __in LPCTSTR Name,
+    __out PDWORDLONG NsPerOp
+    )
+{
+    YORI_STRING Line;
+    YORI_STRING Number;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T LineStart;
+    YORI_ALLOC_SIZE_T Space;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    YORI_MAX_SIGNED_T Value;
+
+    LineStart = 0;
+    for (Offset = 0; Offset <= Baseline->LengthInChars; Offset++) {
+        if (Offset < Baseline->LengthInChars &&
+            Baseline->StartOfString[Offset] != '\n') {
+
+            continue;
+        }
+
+        YoriLibInitEmptyString(&Line);
+        Line.StartOfString = &Baseline->StartOfString[LineStart];
+        Line.LengthInChars = Offset - LineStart;
+        LineStart = Offset + 1;
+        YoriLibTrimSpaces(&Line);
+
+        //
+        //  Lines are the name followed by the time taken.  Names of end to
+        //  end scenarios can contain spaces, so the number follows the final
+        //  space.
+        //
+
+        for (Space = Line.LengthInChars; Space > 0; Space--) {
+            if (Line.StartOfString[Space - 1] == ' ') {
+                break;
+            }
+        }
+
+        if (Space == 0) {
+            continue;
+        }
+
+        YoriLibInitEmptyString(&Number);
+        Number.StartOfString = &Line.StartOfString[Space];
+        Number.LengthInChars = Line.LengthInChars - Space;
+        Line.LengthInChars = Space - 1;
+
+        if (YoriLibCompareStringLit(&Line, Name) == 0 &&
+            YoriLibStringToNumber(&Number, FALSE, &Value, &CharsConsumed) &&
+            CharsConsumed > 0 &&
+            Value > 0) {
+
+            *NsPerOp = (DWORDLONG)Value;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Load a baseline file into memory.
+
+ @param FileName The name of the file.
+
+ @param Baseline On successful completion, updated to contain the contents
+        of the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+BenchLoadBaseline(
+    __in PYORI_STRING FileName,
+    __out PYORI_STRING Baseline
+    )
+{
+    HANDLE hFile;
+    PVOID LineContext;
+    YORI_STRING LineString;
+
+    hFile = CreateFile(FileName->StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(Baseline);
+    YoriLibInitEmptyString(&LineString);
+    LineContext = NULL;
+    while (YoriLibReadLineToString(&LineString, &LineContext, hFile)) {
+        if (!YoriLibStringConcat(Baseline, &LineString) ||
+            !YoriLibStringConcatWithLiteral(Baseline, _T("\n"))) {
+
+            break;
+        }
+    }
+
+    YoriLibLineReadCloseOrCache(LineContext);
+    YoriLibFreeStringContents(&LineString);
+    CloseHandle(hFile);
+    return TRUE;
+}
+
+/**
+ Display the result of a benchmark, and if a baseline is available, the
+ change relative to it.
+
+ @param Variation Pointer to the benchmark.
+
+ @param Baseline Optionally points to the contents of a baseline file.
+ */
+VOID
+BenchDisplayResult(
+    __in PBENCH_VARIATION Variation,
+    __in_opt PYORI_STRING Baseline
+    )
+{
+    DWORDLONG BaselineNsPerOp;
+    DWORDLONG Throughput;
+    LONGLONG Change;
+    TCHAR Sign;
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%-24s %12lli ns/op"), Variation->Name, Variation->NsPerOp);
+    if (Variation->BytesPerOp != 0 && Variation->NsPerOp != 0) {
+        Throughput = Variation->BytesPerOp * 1000000000 / Variation->NsPerOp / (1024 * 1024);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(" %8lli MB/s"), Throughput);
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%14s"), _T(""));
+    }
+
+    //
+    //  Report the change in time in tenths of a percent.  Positive values
+    //  indicate the benchmark has become slower.
+    //
+
+    if (Baseline != NULL &&
+        BenchFindBaseline(Baseline, Variation->Name, &BaselineNsPerOp)) {
+
+        Change = ((LONGLONG)Variation->NsPerOp - (LONGLONG)BaselineNsPerOp) * 1000 / (LONGLONG)BaselineNsPerOp;
+        Sign = '+';
+        if (Change < 0) {
+            Sign = '-';
+            Change = -Change;
+        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  baseline %12lli ns/op %c%lli.%lli%%"), BaselineNsPerOp, Sign, Change / 10, Change % 10);
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+}
+
+/**
+ Display usage text to the user.
+ */
+BOOL
+BenchHelp(VOID)
+{
+    DWORD i;
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("YBench %i.%02i\n"), YORI_VER_MAJOR, YORI_VER_MINOR);
+#if YORI_BUILD_ID
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Build %i\n"), YORI_BUILD_ID);
+#endif
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%hs"), strBenchHelpText);
+    for (i = 0; i < sizeof(BenchVariations)/sizeof(BenchVariations[0]); i++) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("    %s\n"), BenchVariations[i].Name);
+    }
+    return TRUE;
+}
+
+
+/**
+ The main entrypoint for the bench cmdlet.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV An array of arguments.
+
+ @return Exit code of the process, zero indicating success or nonzero on
+         failure.
+ */
+DWORD
+ymain(
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[]
+    )
+{
+    YORI_ALLOC_SIZE_T i;
+    WORD Var;
+    WORD Failed;
+    WORD ScenarioCount;
+    YORI_STRING Arg;
+    YORI_STRING Baseline;
+    PYORI_STRING SaveFileName;
+    PYORI_STRING BaselineFileName;
+    BENCH_VARIATION Scenarios[BENCH_MAX_SCENARIOS];
+    PBENCH_VARIATION Variation;
+    HANDLE hSaveFile;
+    BOOLEAN ArgumentUnderstood;
+    BOOLEAN RunAll;
+    BOOLEAN ExecuteVariation;
+    BOOLEAN HaveBaseline;
+
+    RunAll = TRUE;
+    ScenarioCount = 0;
+    SaveFileName = NULL;
+    BaselineFileName = NULL;
+    ZeroMemory(Scenarios, sizeof(Scenarios));
+
+    for (i = 1; i < ArgC; i++) {
+
+        ArgumentUnderstood = FALSE;
+        ASSERT(YoriLibIsStringNullTerminated(&ArgV[i]));
+
+        if (YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
+
+            if (YoriLibCompareStringLitIns(&Arg, _T("?")) == 0) {
+                BenchHelp();
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
+                YoriLibDisplayMitLicense(_T("2026"));
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("baseline")) == 0) {
+                if (ArgC > i + 1) {
+                    BaselineFileName = &ArgV[i + 1];
+                    i++;
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("e")) == 0) {
+                if (ArgC > i + 1 && ScenarioCount < BENCH_MAX_SCENARIOS) {
+                    Scenarios[ScenarioCount].Fn = BenchScenario;
+                    Scenarios[ScenarioCount].Name = ArgV[i + 1].StartOfString;
+                    Scenarios[ScenarioCount].Context = ArgV[i + 1].StartOfString;
+                    ScenarioCount++;
+                    RunAll = FALSE;
+                    i++;
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("save")) == 0) {
+                if (ArgC > i + 1) {
+                    SaveFileName = &ArgV[i + 1];
+                    i++;
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("v")) == 0) {
+                if (ArgC > i + 1) {
+                    for (Var = 0; Var < sizeof(BenchVariations)/sizeof(BenchVariations[0]); Var++) {
+                        if (YoriLibCompareStringLitIns(&ArgV[i + 1], BenchVariations[Var].Name) == 0) {
+                            BenchVariations[Var].ExplicitlySpecified = TRUE;
+                            BenchVariations[Var].Execute = TRUE;
+                            RunAll = FALSE;
+                        }
+                    }
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("x")) == 0) {
+                if (ArgC > i + 1) {
+                    for (Var = 0; Var < sizeof(BenchVariations)/sizeof(BenchVariations[0]); Var++) {
+                        if (YoriLibCompareStringLitIns(&ArgV[i + 1], BenchVariations[Var].Name) == 0) {
+                            BenchVariations[Var].ExplicitlySpecified = TRUE;
+                            BenchVariations[Var].Execute = FALSE;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    HaveBaseline = FALSE;
+    if (BaselineFileName != NULL) {
+        if (!BenchLoadBaseline(BaselineFileName, &Baseline)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ybench: could not open %y\n"), BaselineFileName);
+            return EXIT_FAILURE;
+        }
+        HaveBaseline = TRUE;
+    }
+
+    if (!BenchInitializeData()) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ybench: could not generate data\n"));
+        if (HaveBaseline) {
+            YoriLibFreeStringContents(&Baseline);
+        }
+        return EXIT_FAILURE;
+    }
+
+    Failed = 0;
+
+    for (i = 0; i < sizeof(BenchVariations)/sizeof(BenchVariations[0]) + ScenarioCount; i++) {
+
+        if (i < sizeof(BenchVariations)/sizeof(BenchVariations[0])) {
+            Variation = &BenchVariations[i];
+            ExecuteVariation = FALSE;
+            if (RunAll) {
+                if (!Variation->ExplicitlySpecified ||
+                    Variation->Execute) {
+
+                    ExecuteVariation = TRUE;
+                }
+            } else {
+                if (Variation->ExplicitlySpecified &&
+                    Variation->Execute) {
+
+                    ExecuteVariation = TRUE;
+                }
+            }
+        } else {
+            Variation = &Scenarios[i - sizeof(BenchVariations)/sizeof(BenchVariations[0])];
+            ExecuteVariation = TRUE;
+        }
+
+        if (ExecuteVariation) {
+            if (BenchRunVariation(Variation)) {
+                BenchDisplayResult(Variation, HaveBaseline?&Baseline:NULL);
+            } else {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%s FAILED\n"), Variation->Name);
+                Failed++;
+            }
+        }
+
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+    }
+
+    BenchCleanupData();
+    if (HaveBaseline) {
+        YoriLibFreeStringContents(&Baseline);
+    }
+
+    if (SaveFileName != NULL) {
+        hSaveFile = CreateFile(SaveFileName->StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hSaveFile == INVALID_HANDLE_VALUE) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ybench: could not create %y\n"), SaveFileName);
+            return EXIT_FAILURE;
+        }
+        for (i = 0; i < sizeof(BenchVariations)/sizeof(BenchVariations[0]) + ScenarioCount; i++) {
+            if (i < sizeof(BenchVariations)/sizeof(BenchVariations[0])) {
+                Variation = &BenchVariations[i];
+            } else {
+                Variation = &Scenarios[i - sizeof(BenchVariations)/sizeof(BenchVariations[0])];
+            }
+            if (Variation->Complete) {
+                YoriLibOutputToDevice(hSaveFile, 0, _T("%s %lli\n"), Variation->Name, Variation->NsPerOp);
+            }
+        }
+        CloseHandle(hSaveFile);
+    }
+
+    if (Failed == 0) {
+        return EXIT_SUCCESS;
+    }
+    return EXIT_FAILURE;
+}
+
+// vim:sw=4:ts=4:et:
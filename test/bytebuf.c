@@ -0,0 +1,112 @@
+/**
+ * @file test/bytebuf.c
+ *
+ * Yori shell test byte buffers
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ The number of bytes of address space to reserve for the buffer.
+ */
+#define TEST_BYTE_BUFFER_RESERVE_SIZE (256 * 1024)
+
+/**
+ The number of bytes to write in each step.
+ */
+#define TEST_BYTE_BUFFER_WRITE_SIZE (10000)
+
+/**
+ The number of bytes to write in total.  This exceeds the reservation so
+ that the buffer needs to move once.
+ */
+#define TEST_BYTE_BUFFER_TOTAL_SIZE (1024 * 1024)
+
+/**
+ A test variation to fill a reserved byte buffer, checking that it does not
+ move while it fits in its reservation and that data is preserved once it
+ grows beyond it.
+ */
+BOOLEAN
+TestByteBuffer(VOID)
+{
+    YORI_LIB_BYTE_BUFFER Buffer;
+    PUCHAR Start;
+    PUCHAR End;
+    PUCHAR Data;
+    YORI_ALLOC_SIZE_T BytesAvailable;
+    DWORD Offset;
+    DWORD Index;
+    BOOLEAN Result;
+
+    if (!YoriLibByteBufferInitializeReserved(&Buffer, TEST_BYTE_BUFFER_RESERVE_SIZE)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibByteBufferInitializeReserved failed\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    Result = FALSE;
+    Start = Buffer.Buffer;
+
+    for (Offset = 0; Offset < TEST_BYTE_BUFFER_TOTAL_SIZE; Offset += TEST_BYTE_BUFFER_WRITE_SIZE) {
+        End = YoriLibByteBufferGetPointerToEnd(&Buffer, TEST_BYTE_BUFFER_WRITE_SIZE, &BytesAvailable);
+        if (End == NULL || BytesAvailable < TEST_BYTE_BUFFER_WRITE_SIZE) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibByteBufferGetPointerToEnd failed at %i\n"), __FILE__, __LINE__, Offset);
+            goto Cleanup;
+        }
+
+        if (Offset + TEST_BYTE_BUFFER_WRITE_SIZE <= TEST_BYTE_BUFFER_RESERVE_SIZE &&
+            Buffer.Buffer != Start) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i buffer moved within its reservation at %i\n"), __FILE__, __LINE__, Offset);
+            goto Cleanup;
+        }
+
+        for (Index = 0; Index < TEST_BYTE_BUFFER_WRITE_SIZE; Index++) {
+            End[Index] = (UCHAR)(Offset + Index);
+        }
+        YoriLibByteBufferAddToPopulatedLength(&Buffer, TEST_BYTE_BUFFER_WRITE_SIZE);
+    }
+
+    Data = YoriLibByteBufferGetPointerToValidData(&Buffer, 0, &BytesAvailable);
+    if (Data == NULL || BytesAvailable != Offset) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibByteBufferGetPointerToValidData returned %i bytes\n"), __FILE__, __LINE__, BytesAvailable);
+        goto Cleanup;
+    }
+
+    for (Index = 0; Index < Offset; Index++) {
+        if (Data[Index] != (UCHAR)Index) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i data mismatch at %i\n"), __FILE__, __LINE__, Index);
+            goto Cleanup;
+        }
+    }
+
+    Result = TRUE;
+
+Cleanup:
+    YoriLibByteBufferCleanup(&Buffer);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,229 @@
+/**
+ * @file test/delta.c
+ *
+ * Yori shell test binary deltas
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ The number of bytes in the source file used by the test.
+ */
+#define TEST_DELTA_SOURCE_SIZE (256 * 1024)
+
+/**
+ Create a temporary file name and write a buffer to it.
+
+ @param Prefix The prefix for the temporary file name.
+
+ @param Buffer Pointer to the data to write.  This may be NULL to create a
+        temporary file name without writing any data.
+
+ @param Length The number of bytes to write.
+
+ @param FileName On successful completion, updated to contain the name of
+        the temporary file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestDeltaWriteTempFile(
+    __in LPCTSTR Prefix,
+    __in_opt PUCHAR Buffer,
+    __in DWORD Length,
+    __out PYORI_STRING FileName
+    )
+{
+    YORI_STRING TempPath;
+    YORI_STRING PrefixString;
+    HANDLE hFile;
+    DWORD BytesWritten;
+    BOOL Result;
+
+    if (!YoriLibGetTempPath(&TempPath, 0)) {
+        return FALSE;
+    }
+
+    YoriLibConstantString(&PrefixString, Prefix);
+    if (!YoriLibGetTempFileName(&TempPath, &PrefixString, &hFile, FileName)) {
+        YoriLibFreeStringContents(&TempPath);
+        return FALSE;
+    }
+    YoriLibFreeStringContents(&TempPath);
+
+    Result = TRUE;
+    if (Buffer != NULL) {
+        Result = WriteFile(hFile, Buffer, Length, &BytesWritten, NULL);
+    }
+    CloseHandle(hFile);
+
+    if (!Result) {
+        DeleteFile(FileName->StartOfString);
+        YoriLibFreeStringContents(FileName);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ A test variation to create a delta between two similar files, check that it
+ is small, and check that applying it regenerates the newer file exactly.
+ Applying the delta to a different file is expected to fail.
+ */
+BOOLEAN
+TestDelta(VOID)
+{
+    PUCHAR Source;
+    PUCHAR Target;
+    DWORD TargetLength;
+    DWORD Index;
+    DWORD Seed;
+    DWORDLONG ExpectedSize;
+    DWORDLONG ExpectedHash;
+    DWORDLONG ActualSize;
+    DWORDLONG ActualHash;
+    YORI_STRING SourceName;
+    YORI_STRING TargetName;
+    YORI_STRING DeltaName;
+    YORI_STRING OutputName;
+    BOOLEAN Result;
+
+    Result = FALSE;
+    YoriLibInitEmptyString(&SourceName);
+    YoriLibInitEmptyString(&TargetName);
+    YoriLibInitEmptyString(&DeltaName);
+    YoriLibInitEmptyString(&OutputName);
+
+    Source = YoriLibMalloc(TEST_DELTA_SOURCE_SIZE * 2);
+    if (Source == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibMalloc failed\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+    Target = Source + TEST_DELTA_SOURCE_SIZE;
+
+    Seed = 0x12345678;
+    for (Index = 0; Index < TEST_DELTA_SOURCE_SIZE; Index++) {
+        Seed = Seed * 1103515245 + 12345;
+        Source[Index] = (UCHAR)(Seed >> 16);
+    }
+
+    //
+    //  The target inserts bytes near the start, changes a range in the
+    //  middle, drops a range, and appends new data at the end.
+    //
+
+    TargetLength = 0;
+    memcpy(&Target[TargetLength], Source, 1000);
+    TargetLength = TargetLength + 1000;
+    memset(&Target[TargetLength], 'x', 100);
+    TargetLength = TargetLength + 100;
+    memcpy(&Target[TargetLength], &Source[1000], 100000);
+    TargetLength = TargetLength + 100000;
+    memset(&Target[TargetLength], 'y', 50);
+    TargetLength = TargetLength + 50;
+    memcpy(&Target[TargetLength], &Source[101050], 100000);
+    TargetLength = TargetLength + 100000;
+    memcpy(&Target[TargetLength], &Source[210000], TEST_DELTA_SOURCE_SIZE - 210000);
+    TargetLength = TargetLength + TEST_DELTA_SOURCE_SIZE - 210000;
+    memset(&Target[TargetLength], 'z', 200);
+    TargetLength = TargetLength + 200;
+
+    if (!TestDeltaWriteTempFile(_T("TST"), Source, TEST_DELTA_SOURCE_SIZE, &SourceName) ||
+        !TestDeltaWriteTempFile(_T("TST"), Target, TargetLength, &TargetName) ||
+        !TestDeltaWriteTempFile(_T("TST"), NULL, 0, &DeltaName) ||
+        !TestDeltaWriteTempFile(_T("TST"), NULL, 0, &OutputName)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i TestDeltaWriteTempFile failed\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    if (!YoriLibCreateDelta(&SourceName, &TargetName, &DeltaName)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibCreateDelta failed\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    if (!YoriLibDeltaHashFile(&DeltaName, &ActualSize, &ActualHash)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibDeltaHashFile failed\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    if (ActualSize > 1024) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i delta is %lli bytes, expected less than 1024\n"), __FILE__, __LINE__, ActualSize);
+        goto Cleanup;
+    }
+
+    if (!YoriLibApplyDelta(&SourceName, &DeltaName, &OutputName)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibApplyDelta failed\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    if (!YoriLibDeltaHashFile(&TargetName, &ExpectedSize, &ExpectedHash) ||
+        !YoriLibDeltaHashFile(&OutputName, &ActualSize, &ActualHash)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibDeltaHashFile failed\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    if (ActualSize != ExpectedSize || ActualHash != ExpectedHash) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i applied delta does not match target\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    //
+    //  The target is not the file the delta was generated against, so
+    //  this should be rejected without generating anything.
+    //
+
+    if (YoriLibApplyDelta(&TargetName, &DeltaName, &OutputName)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibApplyDelta succeeded against the wrong file\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    Result = TRUE;
+
+Cleanup:
+
+    if (SourceName.StartOfString != NULL) {
+        DeleteFile(SourceName.StartOfString);
+        YoriLibFreeStringContents(&SourceName);
+    }
+    if (TargetName.StartOfString != NULL) {
+        DeleteFile(TargetName.StartOfString);
+        YoriLibFreeStringContents(&TargetName);
+    }
+    if (DeltaName.StartOfString != NULL) {
+        DeleteFile(DeltaName.StartOfString);
+        YoriLibFreeStringContents(&DeltaName);
+    }
+    if (OutputName.StartOfString != NULL) {
+        DeleteFile(OutputName.StartOfString);
+        YoriLibFreeStringContents(&OutputName);
+    }
+    YoriLibFree(Source);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
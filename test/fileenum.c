@@ -3,7 +3,7 @@
  *
  * Yori shell test file enumeration
  *
- * Copyright (c) 2022 Malcolm J. Smith
+ * Copyright (c) 2022-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -391,4 +391,145 @@ TestEnumWindows(VOID)
     return TRUE;
 }
 
+/**
+ A test variation to recursively enumerate files using multiple threads and
+ check that the same objects are found as a single threaded enumerate.
+ */
+BOOLEAN
+TestEnumParallel(VOID)
+{
+    TEST_ENUM_CONTEXT TestContext;
+    DWORDLONG SerialFilesFound;
+    WORD MatchFlags;
+    DWORD Index;
+
+    for (Index = 0; Index < 2; Index++) {
+
+        MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES;
+        if (Index == 0) {
+            MatchFlags = (WORD)(MatchFlags | YORILIB_FILEENUM_RECURSE_AFTER_RETURN);
+        } else {
+            MatchFlags = (WORD)(MatchFlags | YORILIB_FILEENUM_RECURSE_BEFORE_RETURN);
+        }
+
+        TestContext.Failed = FALSE;
+        TestContext.FilesFound = 0;
+
+        YoriLibConstantString(&TestContext.FileSpec, _T("C:\\Windows\\System32\\drivers\\*"));
+        if (!YoriLibForEachFile(&TestContext.FileSpec,
+                                MatchFlags,
+                                0,
+                                TestEnumFileFoundCallback,
+                                TestEnumFileEnumerateErrorCallback,
+                                &TestContext)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibForEachFile failed searching %y, error %i\n"), __FILE__, __LINE__, &TestContext.FileSpec, GetLastError());
+            return FALSE;
+        }
+
+        if (TestContext.FilesFound == 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibForEachFile found no files looking for %y\n"), __FILE__, __LINE__, &TestContext.FileSpec);
+            return FALSE;
+        }
+
+        if (TestContext.Failed) {
+            return FALSE;
+        }
+
+        SerialFilesFound = TestContext.FilesFound;
+        TestContext.FilesFound = 0;
+
+        if (!YoriLibForEachFile(&TestContext.FileSpec,
+                                (WORD)(MatchFlags | YORILIB_FILEENUM_PARALLEL),
+                                0,
+                                TestEnumFileFoundCallback,
+                                TestEnumFileEnumerateErrorCallback,
+                                &TestContext)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibForEachFile failed searching %y in parallel, error %i\n"), __FILE__, __LINE__, &TestContext.FileSpec, GetLastError());
+            return FALSE;
+        }
+
+        if (TestContext.Failed) {
+            return FALSE;
+        }
+
+        if (TestContext.FilesFound != SerialFilesFound) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i Parallel enumerate found %lli files, serial enumerate found %lli files\n"), __FILE__, __LINE__, TestContext.FilesFound, SerialFilesFound);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ A single file name and wildcard expression to compare, and the expected
+ result.
+ */
+typedef struct _TEST_MATCH_EXPRESSION_CASE {
+
+    /**
+     The file name to compare.
+     */
+    LPCTSTR FileName;
+
+    /**
+     The wildcard expression to compare against.
+     */
+    LPCTSTR Wildcard;
+
+    /**
+     TRUE if the file name is expected to match the expression.
+     */
+    BOOLEAN ExpectMatch;
+} TEST_MATCH_EXPRESSION_CASE, *PTEST_MATCH_EXPRESSION_CASE;
+
+/**
+ A test variation to compare file names against wildcard expressions.
+ */
+BOOLEAN
+TestEnumMatchExpression(VOID)
+{
+    YORI_STRING FileName;
+    YORI_STRING Wildcard;
+    YORI_LIB_FILE_MATCH_EXPRESSION Expression;
+    BOOLEAN Match;
+    DWORD Index;
+    TEST_MATCH_EXPRESSION_CASE Cases[] = {
+        {_T("foo.txt"),      _T("*.txt"),    TRUE},
+        {_T("FOO.TXT"),      _T("foo.*"),    TRUE},
+        {_T("foo.txt"),      _T("*.c"),      FALSE},
+        {_T("foo.txt"),      _T("foo.txt"),  TRUE},
+        {_T("foo.txt"),      _T("foo.tx"),   FALSE},
+        {_T("aab"),          _T("*ab"),      TRUE},
+        {_T("abcabd"),       _T("*ab?*d"),   TRUE},
+        {_T("abcab"),        _T("a*c*d"),    FALSE},
+        {_T("foo"),          _T("foo??"),    TRUE},
+        {_T("fooab"),        _T("foo??"),    TRUE},
+        {_T("fooabc"),       _T("foo??"),    FALSE},
+        {_T("foo"),          _T("f?o"),      TRUE},
+        {_T("fo"),           _T("f?o"),      FALSE},
+        {_T(""),             _T("*"),        TRUE},
+        {_T("a"),            _T("a?*"),      TRUE},
+    };
+
+    for (Index = 0; Index < sizeof(Cases)/sizeof(Cases[0]); Index++) {
+        YoriLibConstantString(&FileName, Cases[Index].FileName);
+        YoriLibConstantString(&Wildcard, Cases[Index].Wildcard);
+
+        YoriLibCompileFileMatchExpression(&Wildcard, &Expression);
+        Match = YoriLibDoesFileMatchCompiledExpression(&FileName, &Expression);
+        if (Match != Cases[Index].ExpectMatch) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i Matching %y against %y returned %i, expected %i\n"), __FILE__, __LINE__, &FileName, &Wildcard, Match, Cases[Index].ExpectMatch);
+            return FALSE;
+        }
+
+        if ((BOOLEAN)YoriLibDoesFileMatchExpression(&FileName, &Wildcard) != Match) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i Compiled and uncompiled matching of %y against %y differ\n"), __FILE__, __LINE__, &FileName, &Wildcard);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
 // vim:sw=4:ts=4:et:
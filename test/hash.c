@@ -0,0 +1,316 @@
+/**
+ * @file test/hash.c
+ *
+ * Yori shell test hash tables
+ *
+ * Copyright (c) 2024-2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ The number of entries to insert into the open addressing hash table.  This
+ is chosen to force the table to grow several times.
+ */
+#define TEST_OPEN_HASH_ENTRY_COUNT (1000)
+
+/**
+ A test variation to insert, find and remove entries from an open addressing
+ hash table, including across resizes.
+ */
+BOOLEAN
+TestOpenHashTable(VOID)
+{
+    PYORI_OPEN_HASH_TABLE HashTable;
+    PYORI_OPEN_HASH_ENTRY Entries;
+    PYORI_OPEN_HASH_ENTRY Found;
+    YORI_STRING Key;
+    TCHAR KeyBuffer[32];
+    DWORD Index;
+    DWORD InsertedCount;
+    BOOLEAN Result;
+
+    Result = FALSE;
+    InsertedCount = 0;
+    HashTable = YoriLibAllocateOpenHashTable(0);
+    if (HashTable == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibAllocateOpenHashTable failed\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    Entries = YoriLibMalloc(TEST_OPEN_HASH_ENTRY_COUNT * sizeof(YORI_OPEN_HASH_ENTRY));
+    if (Entries == NULL) {
+        YoriLibFreeEmptyOpenHashTable(HashTable);
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Key);
+    Key.StartOfString = KeyBuffer;
+    Key.LengthAllocated = sizeof(KeyBuffer)/sizeof(KeyBuffer[0]);
+
+    for (Index = 0; Index < TEST_OPEN_HASH_ENTRY_COUNT; Index++) {
+        Key.LengthInChars = YoriLibSPrintf(KeyBuffer, _T("Key%i"), Index);
+        if (!YoriLibOpenHashInsertByKey(HashTable, &Key, &Entries[Index], &Entries[Index])) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibOpenHashInsertByKey failed on '%y'\n"), __FILE__, __LINE__, &Key);
+            goto Cleanup;
+        }
+        InsertedCount++;
+    }
+
+    //
+    //  Remove every third entry, then check that everything that should be
+    //  found is found, and everything that was removed is not.  Lookups are
+    //  case insensitive.
+    //
+
+    for (Index = 0; Index < TEST_OPEN_HASH_ENTRY_COUNT; Index += 3) {
+        YoriLibOpenHashRemoveByEntry(&Entries[Index]);
+    }
+
+    for (Index = 0; Index < TEST_OPEN_HASH_ENTRY_COUNT; Index++) {
+        Key.LengthInChars = YoriLibSPrintf(KeyBuffer, _T("KEY%i"), Index);
+        Found = YoriLibOpenHashLookupByKey(HashTable, &Key);
+        if ((Index % 3) == 0) {
+            if (Found != NULL) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i found removed entry '%y'\n"), __FILE__, __LINE__, &Key);
+                goto Cleanup;
+            }
+        } else if (Found != &Entries[Index] || Found->Context != &Entries[Index]) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i did not find entry '%y'\n"), __FILE__, __LINE__, &Key);
+            goto Cleanup;
+        }
+    }
+
+    Result = TRUE;
+
+Cleanup:
+
+    for (Index = 0; Index < InsertedCount; Index++) {
+        if (Entries[Index].HashTable != NULL) {
+            YoriLibOpenHashRemoveByEntry(&Entries[Index]);
+        }
+    }
+
+    YoriLibFree(Entries);
+    YoriLibFreeEmptyOpenHashTable(HashTable);
+    return Result;
+}
+
+/**
+ A test variation to intern strings into an atom table, checking that equal
+ strings return the same atom and that atoms are removed when their final
+ reference is released.
+ */
+BOOLEAN
+TestAtomTable(VOID)
+{
+    PYORI_LIB_ATOM_TABLE AtomTable;
+    PYORI_LIB_ATOM First;
+    PYORI_LIB_ATOM Second;
+    PYORI_LIB_ATOM Other;
+    YORI_STRING Key;
+    YORI_STRING Clone;
+    TCHAR KeyBuffer[32];
+    BOOLEAN Result;
+
+    Result = FALSE;
+    AtomTable = YoriLibAllocateAtomTable(0);
+    if (AtomTable == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibAllocateAtomTable failed\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Clone);
+    YoriLibInitEmptyString(&Key);
+    Key.StartOfString = KeyBuffer;
+    Key.LengthAllocated = sizeof(KeyBuffer)/sizeof(KeyBuffer[0]);
+
+    //
+    //  Intern a string from a buffer, then overwrite the buffer with a
+    //  string differing only in case.  Both should return the same atom,
+    //  which retains the first spelling.
+    //
+
+    Key.LengthInChars = YoriLibSPrintf(KeyBuffer, _T("Foo.obj"));
+    First = YoriLibInternString(AtomTable, &Key);
+    if (First == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibInternString failed\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    Key.LengthInChars = YoriLibSPrintf(KeyBuffer, _T("FOO.OBJ"));
+    Second = YoriLibInternString(AtomTable, &Key);
+    if (Second != First ||
+        First->ReferenceCount != 2 ||
+        YoriLibCompareStringLit(&First->String, _T("Foo.obj")) != 0 ||
+        !YoriLibIsStringNullTerminated(&First->String)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibInternString did not return the existing atom\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    if (First->FoldedHash != YoriLibHashStringFnv32(0, &Key) ||
+        First->Hash == YoriLibHashStringCaseSensitiveFnv32(0, &Key)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i atom hashes are incorrect\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    Key.LengthInChars = YoriLibSPrintf(KeyBuffer, _T("Bar.obj"));
+    Other = YoriLibInternString(AtomTable, &Key);
+    if (Other == NULL || Other == First) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibInternString returned an incorrect atom\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    //
+    //  Releasing both references removes the atom, but a clone of its
+    //  string remains valid.
+    //
+
+    YoriLibCloneString(&Clone, &First->String);
+    YoriLibReleaseAtom(Second);
+    YoriLibReleaseAtom(First);
+
+    Key.LengthInChars = YoriLibSPrintf(KeyBuffer, _T("foo.obj"));
+    if (YoriLibLookupAtom(AtomTable, &Key) != NULL ||
+        YoriLibLookupAtom(AtomTable, &Other->String) != Other ||
+        YoriLibCompareStringLit(&Clone, _T("Foo.obj")) != 0) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i atom was not removed on release\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    Result = TRUE;
+
+Cleanup:
+
+    YoriLibFreeStringContents(&Clone);
+    YoriLibFreeAtomTable(AtomTable);
+    return Result;
+}
+
+/**
+ A test variation to check CRC32C and XXH64 against published results, and
+ the PE checksum against a known sum, including when data is supplied in
+ pieces.
+ */
+BOOLEAN
+TestChecksum(VOID)
+{
+    YORI_LIB_XXHASH64_STATE State;
+    DWORDLONG XxHash;
+    DWORDLONG Expected;
+    DWORD Crc;
+    DWORD PeSum;
+    DWORD Index;
+    DWORD ByteIndex;
+    CHAR CrcData[] = "123456789";
+    CHAR XxData[] = "Nobody inspects the spammish repetition";
+    UCHAR PeData[40];
+
+    Crc = YoriLibCrc32c(0, CrcData, sizeof(CrcData) - 1);
+    if (Crc != 0xE3069283) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibCrc32c returned %08x\n"), __FILE__, __LINE__, Crc);
+        return FALSE;
+    }
+
+    Crc = 0;
+    for (Index = 0; Index < sizeof(CrcData) - 1; Index++) {
+        Crc = YoriLibCrc32c(Crc, &CrcData[Index], 1);
+    }
+    if (Crc != 0xE3069283) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibCrc32c returned %08x\n"), __FILE__, __LINE__, Crc);
+        return FALSE;
+    }
+
+    YoriLibXxHash64Initialize(&State, 0);
+    XxHash = YoriLibXxHash64Finalize(&State);
+    Expected = (((DWORDLONG)0xEF46DB37) << 32) | 0x51D8E999;
+    if (XxHash != Expected) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibXxHash64Finalize returned %llx\n"), __FILE__, __LINE__, XxHash);
+        return FALSE;
+    }
+
+    //
+    //  Supply the data in uneven pieces so that stripes are split across
+    //  calls.
+    //
+
+    YoriLibXxHash64Initialize(&State, 0);
+    for (Index = 0; Index < sizeof(XxData) - 1; Index += 5) {
+        if (Index + 5 > sizeof(XxData) - 1) {
+            YoriLibXxHash64Update(&State, &XxData[Index], sizeof(XxData) - 1 - Index);
+        } else {
+            YoriLibXxHash64Update(&State, &XxData[Index], 5);
+        }
+    }
+    XxHash = YoriLibXxHash64Finalize(&State);
+    Expected = (((DWORDLONG)0xFBCEA83C) << 32) | 0x8A378BF1;
+    if (XxHash != Expected) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibXxHash64Finalize returned %llx\n"), __FILE__, __LINE__, XxHash);
+        return FALSE;
+    }
+
+    //
+    //  Calculate the PE checksum of an odd length buffer at every
+    //  alignment, and with the data supplied in even length pieces, so
+    //  that each path through the word summing code is used.
+    //
+
+    for (Index = 0; Index < 4; Index++) {
+        for (ByteIndex = 0; ByteIndex < 37; ByteIndex++) {
+            PeData[Index + ByteIndex] = (UCHAR)(ByteIndex * 37 + 11);
+        }
+
+        PeSum = YoriLibPeChecksumUpdate(0, &PeData[Index], 37);
+        if (PeSum != 0xA347) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibPeChecksumUpdate returned %04x at offset %i\n"), __FILE__, __LINE__, PeSum, Index);
+            return FALSE;
+        }
+
+        PeSum = YoriLibPeChecksumUpdate(0, &PeData[Index], 6);
+        PeSum = YoriLibPeChecksumUpdate(PeSum, &PeData[Index + 6], 18);
+        PeSum = YoriLibPeChecksumUpdate(PeSum, &PeData[Index + 24], 13);
+        if (PeSum != 0xA347) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibPeChecksumUpdate returned %04x at offset %i\n"), __FILE__, __LINE__, PeSum, Index);
+            return FALSE;
+        }
+    }
+
+    //
+    //  A sum of words that carries all the way around should produce
+    //  0xFFFF rather than zero.
+    //
+
+    memset(PeData, 0xFF, 8);
+    PeSum = YoriLibPeChecksumUpdate(0, PeData, 8);
+    if (PeSum != 0xFFFF) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibPeChecksumUpdate returned %04x\n"), __FILE__, __LINE__, PeSum);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
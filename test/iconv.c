@@ -0,0 +1,108 @@
+/**
+ * @file test/iconv.c
+ *
+ * Yori shell test UTF8 and UTF16 conversions
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ A UTF16 string containing runs of ASCII longer than the block size used by
+ the conversion, interleaved with two byte, three byte and surrogate pair
+ characters.
+ */
+CONST WCHAR TestIconvWide[] = {
+    'T', 'h', 'e', ' ', 'q', 'u', 'i', 'c', 'k', ' ', 'b', 'r', 'o', 'w', 'n',
+    0x00E9, 'f', 'o', 'x', ' ', 0x20AC, ' ', 'j', 'u', 'm', 'p', 's', ' ',
+    'o', 'v', 'e', 'r', ' ', 't', 'h', 'e', ' ', 'l', 'a', 'z', 'y', ' ',
+    0xD83D, 0xDE00, 'd', 'o', 'g', '\r', '\n'
+};
+
+/**
+ The expected UTF8 encoding of TestIconvWide.
+ */
+CONST UCHAR TestIconvUtf8[] = {
+    'T', 'h', 'e', ' ', 'q', 'u', 'i', 'c', 'k', ' ', 'b', 'r', 'o', 'w', 'n',
+    0xC3, 0xA9, 'f', 'o', 'x', ' ', 0xE2, 0x82, 0xAC, ' ', 'j', 'u', 'm', 'p',
+    's', ' ', 'o', 'v', 'e', 'r', ' ', 't', 'h', 'e', ' ', 'l', 'a', 'z', 'y',
+    ' ', 0xF0, 0x9F, 0x98, 0x80, 'd', 'o', 'g', '\r', '\n'
+};
+
+/**
+ A test variation to convert known strings between UTF16 and UTF8, starting
+ from each offset so that ASCII runs are checked at every alignment.
+ */
+BOOLEAN
+TestIconv(VOID)
+{
+    CHAR Narrow[sizeof(TestIconvUtf8)];
+    WCHAR Wide[sizeof(TestIconvWide) / sizeof(WCHAR)];
+    YORI_ALLOC_SIZE_T WideLength;
+    YORI_ALLOC_SIZE_T NarrowLength;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T Length;
+
+    WideLength = sizeof(TestIconvWide) / sizeof(WCHAR);
+    NarrowLength = sizeof(TestIconvUtf8);
+
+    Length = YoriLibUtf8FromUtf16(TestIconvWide, WideLength, NULL, 0);
+    if (Length != NarrowLength) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i UTF8 length %i, expected %i\n"), __FILE__, __LINE__, Length, NarrowLength);
+        return FALSE;
+    }
+
+    Length = YoriLibUtf16FromUtf8((LPCSTR)TestIconvUtf8, NarrowLength, NULL, 0);
+    if (Length != WideLength) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i UTF16 length %i, expected %i\n"), __FILE__, __LINE__, Length, WideLength);
+        return FALSE;
+    }
+
+    //
+    //  The first fifteen characters are ASCII, so an offset into the wide
+    //  string is the same offset into the narrow string.
+    //
+
+    for (Offset = 0; Offset < 15; Offset++) {
+        Length = YoriLibUtf8FromUtf16(&TestIconvWide[Offset], WideLength - Offset, Narrow, sizeof(Narrow));
+        if (Length != NarrowLength - Offset ||
+            memcmp(Narrow, &TestIconvUtf8[Offset], Length) != 0) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i UTF8 conversion mismatch at offset %i\n"), __FILE__, __LINE__, Offset);
+            return FALSE;
+        }
+
+        Length = YoriLibUtf16FromUtf8((LPCSTR)&TestIconvUtf8[Offset], NarrowLength - Offset, Wide, sizeof(Wide) / sizeof(WCHAR));
+        if (Length != WideLength - Offset ||
+            memcmp(Wide, &TestIconvWide[Offset], Length * sizeof(WCHAR)) != 0) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i UTF16 conversion mismatch at offset %i\n"), __FILE__, __LINE__, Offset);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
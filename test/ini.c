@@ -0,0 +1,204 @@
+/**
+ * @file test/ini.c
+ *
+ * Yori shell test in memory INI files
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ The initial contents of the INI file used by the test.
+ */
+CHAR TestIniContents[] = "; A comment\r\n"
+                         "[First]\r\n"
+                         "Alpha = 1\r\n"
+                         "Beta=\"quoted\"\r\n"
+                         "alpha=ignored\r\n"
+                         "\r\n"
+                         "[Second]\r\n"
+                         "Gamma=3\r\n";
+
+/**
+ Check that a value in an INI file matches an expected value.
+
+ @param IniFile Pointer to the INI file.
+
+ @param Section Pointer to the section name.
+
+ @param Key Pointer to the key name.
+
+ @param Expected Pointer to the expected value.
+
+ @return TRUE if the value matches, FALSE if it does not.
+ */
+BOOLEAN
+TestIniCheckValue(
+    __in PYORI_LIB_INI_FILE IniFile,
+    __in LPCTSTR Section,
+    __in LPCTSTR Key,
+    __in LPCTSTR Expected
+    )
+{
+    TCHAR Buffer[64];
+    YORI_STRING Value;
+
+    YoriLibInitEmptyString(&Value);
+    Value.StartOfString = Buffer;
+    Value.LengthInChars = (YORI_ALLOC_SIZE_T)YoriLibIniGetString(IniFile, Section, Key, _T("<default>"), Buffer, sizeof(Buffer)/sizeof(Buffer[0]));
+
+    if (YoriLibCompareStringLit(&Value, Expected) != 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i [%s] %s returned '%y', expected '%s'\n"), __FILE__, __LINE__, Section, Key, &Value, Expected);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ A test variation to load an INI file, query and update values, write it
+ back, and check the result when it is loaded again.
+ */
+BOOLEAN
+TestIniFile(VOID)
+{
+    YORI_STRING TempPath;
+    YORI_STRING Prefix;
+    YORI_STRING TempName;
+    PYORI_LIB_INI_FILE IniFile;
+    HANDLE hFile;
+    DWORD BytesWritten;
+    DWORD Length;
+    TCHAR Names[64];
+    BOOLEAN Result;
+
+    Result = FALSE;
+    IniFile = NULL;
+
+    if (!YoriLibGetTempPath(&TempPath, 0)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibGetTempPath failed\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    YoriLibConstantString(&Prefix, _T("TST"));
+    if (!YoriLibGetTempFileName(&TempPath, &Prefix, &hFile, &TempName)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibGetTempFileName failed\n"), __FILE__, __LINE__);
+        YoriLibFreeStringContents(&TempPath);
+        return FALSE;
+    }
+    YoriLibFreeStringContents(&TempPath);
+
+    if (!WriteFile(hFile, TestIniContents, sizeof(TestIniContents) - 1, &BytesWritten, NULL)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i WriteFile failed\n"), __FILE__, __LINE__);
+        CloseHandle(hFile);
+        goto Cleanup;
+    }
+    CloseHandle(hFile);
+
+    IniFile = YoriLibIniLoad(&TempName);
+    if (IniFile == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibIniLoad failed\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    //
+    //  Lookups are case insensitive, surrounding whitespace and quotes are
+    //  removed, and the first assignment to a key wins.
+    //
+
+    if (!TestIniCheckValue(IniFile, _T("first"), _T("ALPHA"), _T("1")) ||
+        !TestIniCheckValue(IniFile, _T("First"), _T("Beta"), _T("quoted")) ||
+        !TestIniCheckValue(IniFile, _T("First"), _T("Gamma"), _T("<default>")) ||
+        !TestIniCheckValue(IniFile, _T("Missing"), _T("Alpha"), _T("<default>"))) {
+
+        goto Cleanup;
+    }
+
+    if (YoriLibIniGetInt(IniFile, _T("Second"), _T("Gamma"), 0) != 3) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibIniGetInt failed\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    //
+    //  Removing the first assignment exposes the second.
+    //
+
+    if (!YoriLibIniWriteString(IniFile, _T("First"), _T("Alpha"), NULL) ||
+        !TestIniCheckValue(IniFile, _T("First"), _T("Alpha"), _T("ignored"))) {
+
+        goto Cleanup;
+    }
+
+    if (!YoriLibIniWriteString(IniFile, _T("First"), _T("Delta"), _T("4")) ||
+        !YoriLibIniWriteString(IniFile, _T("First"), _T("Beta"), _T("changed")) ||
+        !YoriLibIniWriteString(IniFile, _T("Second"), NULL, NULL) ||
+        !YoriLibIniWriteString(IniFile, _T("Third"), _T("Epsilon"), _T("5"))) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibIniWriteString failed\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    if (!YoriLibIniFlush(IniFile)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibIniFlush failed\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    YoriLibIniFree(IniFile);
+    IniFile = YoriLibIniLoad(&TempName);
+    if (IniFile == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibIniLoad failed\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    if (!TestIniCheckValue(IniFile, _T("First"), _T("Alpha"), _T("ignored")) ||
+        !TestIniCheckValue(IniFile, _T("First"), _T("Beta"), _T("changed")) ||
+        !TestIniCheckValue(IniFile, _T("First"), _T("Delta"), _T("4")) ||
+        !TestIniCheckValue(IniFile, _T("Second"), _T("Gamma"), _T("<default>")) ||
+        !TestIniCheckValue(IniFile, _T("Third"), _T("Epsilon"), _T("5"))) {
+
+        goto Cleanup;
+    }
+
+    Length = YoriLibIniGetSectionNames(IniFile, Names, sizeof(Names)/sizeof(Names[0]));
+    if (Length != sizeof("First\0Third") ||
+        memcmp(Names, _T("First\0Third\0"), (Length + 1) * sizeof(TCHAR)) != 0) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibIniGetSectionNames returned unexpected names\n"), __FILE__, __LINE__);
+        goto Cleanup;
+    }
+
+    Result = TRUE;
+
+Cleanup:
+
+    if (IniFile != NULL) {
+        YoriLibIniFree(IniFile);
+    }
+
+    DeleteFile(TempName.StartOfString);
+    YoriLibFreeStringContents(&TempName);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,345 @@
+/**
+ * @file test/regex.c
+ *
+ * Yori shell test regular expressions
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ The number of capture slots requested from each search.  This matches the
+ largest number of captures that either engine records.
+ */
+#define TEST_REGEX_CAPTURE_SLOTS (10)
+
+/**
+ A single expression to search for, the text to search, and whether the
+ location of each capture group is expected to be identical between the
+ compiled program and the backtracking engine.
+ */
+typedef struct _TEST_REGEX_CASE {
+
+    /**
+     The expression to search for.
+     */
+    LPCSTR Pattern;
+
+    /**
+     The text to search.
+     */
+    LPCSTR Text;
+
+    /**
+     TRUE if each capture group should be recorded at the same location by
+     both engines.  FALSE if only the location of the match is compared,
+     which applies to repeated groups that can match an empty string, where
+     the compiled program records the final empty iteration.
+     */
+    BOOLEAN CompareCaptures;
+} TEST_REGEX_CASE, *PTEST_REGEX_CASE;
+
+/**
+ A pointer to an expression and text to search which cannot be modified.
+ */
+typedef TEST_REGEX_CASE CONST *PCTEST_REGEX_CASE;
+
+/**
+ Expressions to search for with both engines.
+ */
+CONST TEST_REGEX_CASE TestRegexCases[] = {
+    {"abc",                       "xxabcxx",                  TRUE},
+    {"a|b|c",                     "zzzc",                     TRUE},
+    {"(a|ab)(c|bcd)(d*)",         "abcd",                     TRUE},
+    {"(a+)(b+)?",                 "caaab",                    TRUE},
+    {"([a-z]+)@([a-z]+)\\.com",   "mail bob@example.com now", TRUE},
+    {"^(\\d+)-(\\d+)$",           "123-456",                  TRUE},
+    {"\\bfoo\\b",                 "a foobar foo",             TRUE},
+    {"\\Bb",                      "ab b",                     TRUE},
+    {"(a*?)(a*)",                 "aaa",                      TRUE},
+    {"x(a|b)*?y",                 "xababy",                   TRUE},
+    {"(?:ab){2,3}",               "abababab",                 TRUE},
+    {"[^ ]+$",                    "one two three",            TRUE},
+    {"[A-Z][a-z]+",               "hello World",              TRUE},
+    {"colou?r",                   "the color red",            TRUE},
+    {"(\\w+)\\s(\\w+)",           "hello world",              TRUE},
+    {"(x)?y",                     "y",                        TRUE},
+    {"([0-9]{2,4})",              "a12345",                   TRUE},
+    {"(a|b)*c",                   "abababc",                  TRUE},
+    {"(.*)x",                     "abcxdefx",                 TRUE},
+    {"(.*?)x",                    "abcxdefx",                 TRUE},
+    {"(foo|foobar)baz",           "foobarbaz",                TRUE},
+    {"(ab|a)(bc|c)?",             "abc",                      TRUE},
+    {"((a)|b)+",                  "ab",                       TRUE},
+    {"(a|aa)+$",                  "aaaaa",                    TRUE},
+    {"(a+)+$",                    "aaaaX",                    TRUE},
+    {"(a*)*b",                    "aaab",                     TRUE},
+    {"(a*)*b",                    "aaaa",                     TRUE},
+    {"^$",                        "",                         TRUE},
+    {"(a*)+",                     "b",                        FALSE},
+    {"(a?){3}a{3}",               "aaa",                      FALSE},
+};
+
+/**
+ Search for a compiled expression with the compiled program and with the
+ backtracking engine, and check that both find the same match.
+
+ @param Case Pointer to the expression and text to search.
+
+ @return TRUE to indicate both engines found the same match, FALSE if they
+         did not.
+ */
+BOOLEAN
+TestRegexCompareCase(
+    __in PCTEST_REGEX_CASE Case
+    )
+{
+    YORI_LIB_REGEX Regex;
+    YORI_LIB_REGEX Backtrack;
+    LONG_PTR VmPos[TEST_REGEX_CAPTURE_SLOTS];
+    LONG_PTR VmSpan[TEST_REGEX_CAPTURE_SLOTS];
+    LONG_PTR BtPos[TEST_REGEX_CAPTURE_SLOTS];
+    LONG_PTR BtSpan[TEST_REGEX_CAPTURE_SLOTS];
+    YORI_ALLOC_SIZE_T VmOffset;
+    YORI_ALLOC_SIZE_T BtOffset;
+    YORI_ALLOC_SIZE_T TextLength;
+    LONG_PTR VmResult;
+    LONG_PTR BtResult;
+    DWORD Index;
+    BOOLEAN Result;
+
+    if (YoriLibRegexCompile(Case->Pattern, &Regex) != 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibRegexCompile failed for %hs\n"), __FILE__, __LINE__, Case->Pattern);
+        return FALSE;
+    }
+
+    //
+    //  Every expression in the table should be compiled into a program,
+    //  otherwise both searches would use the backtracking engine and the
+    //  comparison would prove nothing.
+    //
+
+    if (Regex.Program == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i no program compiled for %hs\n"), __FILE__, __LINE__, Case->Pattern);
+        YoriLibRegexFree(&Regex);
+        return FALSE;
+    }
+
+    //
+    //  A copy of the expression without a program searches with the
+    //  backtracking engine.  The copy shares the original's allocations,
+    //  so only the original is freed.
+    //
+
+    memcpy(&Backtrack, &Regex, sizeof(YORI_LIB_REGEX));
+    Backtrack.Program = NULL;
+
+    for (Index = 0; Index < TEST_REGEX_CAPTURE_SLOTS; Index++) {
+        VmPos[Index] = -1;
+        VmSpan[Index] = -1;
+        BtPos[Index] = -1;
+        BtSpan[Index] = -1;
+    }
+
+    TextLength = (YORI_ALLOC_SIZE_T)strlen(Case->Text);
+    VmOffset = 0;
+    BtOffset = 0;
+    VmResult = YoriLibRegexSearch(&Regex, Case->Text, TextLength, 0, TEST_REGEX_CAPTURE_SLOTS, VmPos, VmSpan, &VmOffset);
+    BtResult = YoriLibRegexSearch(&Backtrack, Case->Text, TextLength, 0, TEST_REGEX_CAPTURE_SLOTS, BtPos, BtSpan, &BtOffset);
+
+    Result = TRUE;
+    if (VmResult != BtResult) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i %hs in %hs returned %lli, expected %lli\n"), __FILE__, __LINE__, Case->Pattern, Case->Text, (LONGLONG)VmResult, (LONGLONG)BtResult);
+        Result = FALSE;
+    } else if (VmResult >= 0) {
+        if (VmOffset != BtOffset) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i %hs in %hs matched at %i, expected %i\n"), __FILE__, __LINE__, Case->Pattern, Case->Text, VmOffset, BtOffset);
+            Result = FALSE;
+        }
+
+        for (Index = 0; Result && Index < Regex.CaptureCount && Index < TEST_REGEX_CAPTURE_SLOTS; Index++) {
+            if (Index > 0 && !Case->CompareCaptures) {
+                break;
+            }
+            if (VmPos[Index] != BtPos[Index] ||
+                VmSpan[Index] != BtSpan[Index]) {
+
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i %hs in %hs capture %i at %lli length %lli, expected %lli length %lli\n"), __FILE__, __LINE__, Case->Pattern, Case->Text, Index, (LONGLONG)VmPos[Index], (LONGLONG)VmSpan[Index], (LONGLONG)BtPos[Index], (LONGLONG)BtSpan[Index]);
+                Result = FALSE;
+            }
+        }
+    }
+
+    YoriLibRegexFree(&Regex);
+    return Result;
+}
+
+/**
+ Check that expressions compiled into a program find the same matches and
+ capture groups as the backtracking engine.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestRegexCompare(VOID)
+{
+    DWORD Index;
+    BOOLEAN Result;
+
+    Result = TRUE;
+    for (Index = 0; Index < sizeof(TestRegexCases)/sizeof(TestRegexCases[0]); Index++) {
+        if (!TestRegexCompareCase(&TestRegexCases[Index])) {
+            Result = FALSE;
+        }
+    }
+
+    return Result;
+}
+
+/**
+ The number of characters in the text searched by pathological expressions.
+ A backtracking search for these expressions takes time exponential in
+ this length, so it is only practical with the compiled program.
+ */
+#define TEST_REGEX_PATHOLOGICAL_LENGTH (20000)
+
+/**
+ Search for an expression that requires exponential time to backtrack
+ and check the result.
+
+ @param Pattern The expression to search for.
+
+ @param Text The text to search.
+
+ @param TextLength The number of characters in Text.
+
+ @param ExpectedLength The expected length of the match, or -1 if no match
+        is expected.
+
+ @param ExpectedOffset The expected offset of the match, if one is expected.
+
+ @return TRUE to indicate the expected result was found, FALSE if it was
+         not.
+ */
+BOOLEAN
+TestRegexPathologicalCase(
+    __in LPCSTR Pattern,
+    __in LPCSTR Text,
+    __in YORI_ALLOC_SIZE_T TextLength,
+    __in LONG_PTR ExpectedLength,
+    __in YORI_ALLOC_SIZE_T ExpectedOffset
+    )
+{
+    YORI_LIB_REGEX Regex;
+    YORI_ALLOC_SIZE_T MatchOffset;
+    LONG_PTR MatchLength;
+    BOOLEAN Result;
+
+    if (YoriLibRegexCompile(Pattern, &Regex) != 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibRegexCompile failed for %hs\n"), __FILE__, __LINE__, Pattern);
+        return FALSE;
+    }
+
+    if (Regex.Program == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i no program compiled for %hs\n"), __FILE__, __LINE__, Pattern);
+        YoriLibRegexFree(&Regex);
+        return FALSE;
+    }
+
+    Result = TRUE;
+    MatchOffset = 0;
+    MatchLength = YoriLibRegexSearch(&Regex, Text, TextLength, 0, 0, NULL, NULL, &MatchOffset);
+    if (MatchLength != ExpectedLength) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i %hs returned %lli, expected %lli\n"), __FILE__, __LINE__, Pattern, (LONGLONG)MatchLength, (LONGLONG)ExpectedLength);
+        Result = FALSE;
+    } else if (MatchLength >= 0 && MatchOffset != ExpectedOffset) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i %hs matched at %i, expected %i\n"), __FILE__, __LINE__, Pattern, MatchOffset, ExpectedOffset);
+        Result = FALSE;
+    }
+
+    YoriLibRegexFree(&Regex);
+    return Result;
+}
+
+/**
+ Check that expressions which take exponential time to backtrack complete
+ with the expected result when searched with the compiled program.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestRegexPathological(VOID)
+{
+    LPSTR Text;
+    YORI_ALLOC_SIZE_T Length;
+    BOOLEAN Result;
+
+    Length = TEST_REGEX_PATHOLOGICAL_LENGTH;
+    Text = YoriLibMalloc(Length + 2);
+    if (Text == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibMalloc failed\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    memset(Text, 'a', Length);
+    Text[Length] = '\0';
+
+    Result = TRUE;
+    if (!TestRegexPathologicalCase("(a*)*b", Text, Length, -1, 0)) {
+        Result = FALSE;
+    }
+
+    if (!TestRegexPathologicalCase("(a+)+$", Text, Length, Length, 0)) {
+        Result = FALSE;
+    }
+
+    if (!TestRegexPathologicalCase("(a?){25}a{25}", Text, 25, 25, 0)) {
+        Result = FALSE;
+    }
+
+    //
+    //  Append a character that the expressions can match, so the search
+    //  has to succeed after the whole string has been considered.
+    //
+
+    Text[Length] = 'b';
+    Text[Length + 1] = '\0';
+
+    if (!TestRegexPathologicalCase("(a*)*b", Text, Length + 1, Length + 1, 0)) {
+        Result = FALSE;
+    }
+
+    if (!TestRegexPathologicalCase("(a+)+$", Text, Length + 1, -1, 0)) {
+        Result = FALSE;
+    }
+
+    if (!TestRegexPathologicalCase("(a|aa)+b", Text, Length + 1, Length + 1, 0)) {
+        Result = FALSE;
+    }
+
+    YoriLibFree(Text);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
@@ -3,7 +3,7 @@
  *
  * Yori shell test suite
  *
- * Copyright (c) 2022 Malcolm J. Smith
+ * Copyright (c) 2022-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -79,6 +79,21 @@ typedef struct _TEST_VARIATION {
 TEST_VARIATION TestVariations[] = {
     {TestEnumRoot,                         _T("EnumRoot")},
     {TestEnumWindows,                      _T("EnumWindows")},
+    {TestEnumParallel,                     _T("EnumParallel")},
+    {TestEnumMatchExpression,              _T("EnumMatchExpression")},
+    {TestOpenHashTable,                    _T("OpenHashTable")},
+    {TestAtomTable,                        _T("AtomTable")},
+    {TestChecksum,                         _T("Checksum")},
+    {TestIniFile,                          _T("IniFile")},
+    {TestDelta,                            _T("Delta")},
+    {TestBase64,                           _T("Base64")},
+    {TestByteBuffer,                       _T("ByteBuffer")},
+    {TestArena,                            _T("Arena")},
+    {TestIconv,                            _T("Iconv")},
+    {TestThreadPool,                       _T("ThreadPool")},
+    {TestRegexCompare,                     _T("RegexCompare")},
+    {TestRegexPathological,                _T("RegexPathological")},
+    {TestFileUpdate,                       _T("FileUpdate")},
     {TestParseTwoArgCmd,                   _T("ParseTwoArgCmd")},
     {TestParseOneArgContainingQuotesCmd,   _T("ParseOneArgContainingQuotesCmd")},
     {TestParseOneArgEnclosedInQuotesCmd,   _T("ParseOneArgEnclosedInQuotesCmd")},
@@ -93,6 +108,7 @@ TEST_VARIATION TestVariations[] = {
     {TestArgOneArgEnclosedInQuotesCmd,     _T("ArgOneArgEnclosedInQuotesCmd")},
     {TestArgRedirectWithEndingQuoteCmd,    _T("ArgRedirectWithEndingQuoteCmd")},
     {TestArgBackslashEscapeCmd,            _T("ArgBackslashEscapeCmd")},
+    {TestArgMaxArgsCmd,                    _T("ArgMaxArgsCmd")},
 };
 
 
@@ -3,7 +3,7 @@
  *
  * Yori shell test header
  *
- * Copyright (c) 2022 Malcolm J. Smith
+ * Copyright (c) 2022-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -46,6 +46,84 @@ YORI_TEST_FN TestEnumRoot;
  */
 YORI_TEST_FN TestEnumWindows;
 
+/**
+ A test variation to enumerate files recursively on multiple threads.
+ */
+YORI_TEST_FN TestEnumParallel;
+
+/**
+ A test variation to compare file names against wildcard expressions.
+ */
+YORI_TEST_FN TestEnumMatchExpression;
+
+/**
+ A test variation to insert, find and remove entries from an open addressing
+ hash table.
+ */
+YORI_TEST_FN TestOpenHashTable;
+
+/**
+ A test variation to intern strings into an atom table.
+ */
+YORI_TEST_FN TestAtomTable;
+
+/**
+ A test variation to check CRC32C and XXH64 results.
+ */
+YORI_TEST_FN TestChecksum;
+
+/**
+ A test variation to load, query, update and write back an INI file.
+ */
+YORI_TEST_FN TestIniFile;
+
+/**
+ A test variation to create and apply a binary delta.
+ */
+YORI_TEST_FN TestDelta;
+
+/**
+ A test variation to encode and decode base64 data.
+ */
+YORI_TEST_FN TestBase64;
+
+/**
+ A test variation to grow a reserved byte buffer.
+ */
+YORI_TEST_FN TestByteBuffer;
+
+/**
+ A test variation to allocate from, reset and destroy an arena.
+ */
+YORI_TEST_FN TestArena;
+
+/**
+ A test variation to convert strings between UTF16 and UTF8.
+ */
+YORI_TEST_FN TestIconv;
+
+/**
+ A test variation to execute and complete items on a thread pool.
+ */
+YORI_TEST_FN TestThreadPool;
+
+/**
+ A test variation to compare regular expression matches found by the
+ compiled program with those found by backtracking.
+ */
+YORI_TEST_FN TestRegexCompare;
+
+/**
+ A test variation to search for regular expressions that take exponential
+ time to backtrack.
+ */
+YORI_TEST_FN TestRegexPathological;
+
+/**
+ A test variation to apply updates to files in parallel.
+ */
+YORI_TEST_FN TestFileUpdate;
+
 /**
  A test variation to parse a command with two space delimited arguments.
  */
@@ -125,4 +203,10 @@ YORI_TEST_FN TestArgRedirectWithEndingQuoteCmd;
  */
 YORI_TEST_FN TestArgBackslashEscapeCmd;
 
+/**
+ A test variation to parse a command into fewer arguments than it contains,
+ so that trailing arguments are joined with the final argument.
+ */
+YORI_TEST_FN TestArgMaxArgsCmd;
+
 // vim:sw=4:ts=4:et:
@@ -0,0 +1,410 @@
+/**
+ * @file test/thrdpool.c
+ *
+ * Yori shell test thread pool
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ The number of ordered items submitted by the test.
+ */
+#define TEST_THREAD_POOL_ITEM_COUNT (1000)
+
+/**
+ The number of ordered items which submit an additional unordered item from
+ within the pool.
+ */
+#define TEST_THREAD_POOL_NESTED_COUNT (100)
+
+/**
+ State shared by every item in the test.
+ */
+typedef struct _TEST_THREAD_POOL_CONTEXT {
+
+    /**
+     The index of the next item expected to complete.
+     */
+    DWORD NextCompletion;
+
+    /**
+     Set to TRUE if any item completed out of order or with an incorrect
+     result.
+     */
+    BOOLEAN Failed;
+
+    /**
+     The number of unordered items which have executed.
+     */
+    LONG NestedExecuted;
+} TEST_THREAD_POOL_CONTEXT, *PTEST_THREAD_POOL_CONTEXT;
+
+/**
+ An item submitted by the test.
+ */
+typedef struct _TEST_THREAD_POOL_ITEM {
+
+    /**
+     The thread pool item header.
+     */
+    YORI_LIB_WORK_ITEM WorkItem;
+
+    /**
+     Pointer to state shared by every item.
+     */
+    PTEST_THREAD_POOL_CONTEXT Context;
+
+    /**
+     The order in which this item was submitted.
+     */
+    DWORD Index;
+
+    /**
+     The result calculated when the item executes.
+     */
+    DWORDLONG Value;
+} TEST_THREAD_POOL_ITEM, *PTEST_THREAD_POOL_ITEM;
+
+/**
+ Execute an unordered item, which frees itself.
+
+ @param Pool Pointer to the pool.
+
+ @param WorkItem Pointer to the item.
+ */
+VOID
+TestThreadPoolExecuteNested(
+    __in PYORI_LIB_THREAD_POOL Pool,
+    __in PYORI_LIB_WORK_ITEM WorkItem
+    )
+{
+    PTEST_THREAD_POOL_ITEM Item;
+
+    UNREFERENCED_PARAMETER(Pool);
+
+    Item = CONTAINING_RECORD(WorkItem, TEST_THREAD_POOL_ITEM, WorkItem);
+    InterlockedIncrement(&Item->Context->NestedExecuted);
+    YoriLibFree(Item);
+}
+
+/**
+ Execute an ordered item.  Some items submit an unordered item, which
+ should execute before the pool becomes idle.
+
+ @param Pool Pointer to the pool.
+
+ @param WorkItem Pointer to the item.
+ */
+VOID
+TestThreadPoolExecute(
+    __in PYORI_LIB_THREAD_POOL Pool,
+    __in PYORI_LIB_WORK_ITEM WorkItem
+    )
+{
+    PTEST_THREAD_POOL_ITEM Item;
+    PTEST_THREAD_POOL_ITEM Nested;
+
+    Item = CONTAINING_RECORD(WorkItem, TEST_THREAD_POOL_ITEM, WorkItem);
+
+    //
+    //  Some items take longer than others, so that they finish executing
+    //  out of order.
+    //
+
+    if ((Item->Index % 10) == 0) {
+        Sleep(1);
+    }
+    Item->Value = Item->Index;
+
+    if (Item->Index < TEST_THREAD_POOL_NESTED_COUNT) {
+        Nested = YoriLibMalloc(sizeof(TEST_THREAD_POOL_ITEM));
+        if (Nested == NULL) {
+            Item->Context->Failed = TRUE;
+            return;
+        }
+        ZeroMemory(Nested, sizeof(TEST_THREAD_POOL_ITEM));
+        Nested->WorkItem.ExecuteFn = TestThreadPoolExecuteNested;
+        Nested->Context = Item->Context;
+        YoriLibSubmitWorkItem(Pool, &Nested->WorkItem);
+    }
+}
+
+/**
+ Complete an ordered item, checking that it completed in order.
+
+ @param Pool Pointer to the pool.
+
+ @param WorkItem Pointer to the item.
+ */
+VOID
+TestThreadPoolComplete(
+    __in PYORI_LIB_THREAD_POOL Pool,
+    __in PYORI_LIB_WORK_ITEM WorkItem
+    )
+{
+    PTEST_THREAD_POOL_ITEM Item;
+
+    UNREFERENCED_PARAMETER(Pool);
+
+    Item = CONTAINING_RECORD(WorkItem, TEST_THREAD_POOL_ITEM, WorkItem);
+    if (Item->Index != Item->Context->NextCompletion ||
+        Item->Value != Item->Index) {
+
+        Item->Context->Failed = TRUE;
+    }
+    Item->Context->NextCompletion++;
+}
+
+/**
+ A test variation to execute items on a thread pool, checking that every
+ item executes, including items submitted from within the pool, and that
+ completion functions are called in submission order.
+ */
+BOOLEAN
+TestThreadPool(VOID)
+{
+    PYORI_LIB_THREAD_POOL Pool;
+    PTEST_THREAD_POOL_ITEM Items;
+    TEST_THREAD_POOL_CONTEXT Context;
+    DWORD Index;
+    BOOLEAN Result;
+
+    Items = YoriLibMalloc(TEST_THREAD_POOL_ITEM_COUNT * sizeof(TEST_THREAD_POOL_ITEM));
+    if (Items == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibMalloc failed\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    if (!YoriLibCreateThreadPool(4, YoriLibCpuClassAny, &Pool)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibCreateThreadPool failed\n"), __FILE__, __LINE__);
+        YoriLibFree(Items);
+        return FALSE;
+    }
+
+    ZeroMemory(&Context, sizeof(Context));
+    ZeroMemory(Items, TEST_THREAD_POOL_ITEM_COUNT * sizeof(TEST_THREAD_POOL_ITEM));
+    for (Index = 0; Index < TEST_THREAD_POOL_ITEM_COUNT; Index++) {
+        Items[Index].WorkItem.ExecuteFn = TestThreadPoolExecute;
+        Items[Index].WorkItem.CompleteFn = TestThreadPoolComplete;
+        Items[Index].Context = &Context;
+        Items[Index].Index = Index;
+        YoriLibSubmitWorkItem(Pool, &Items[Index].WorkItem);
+    }
+
+    Result = FALSE;
+    if (!YoriLibWaitForThreadPool(Pool)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibWaitForThreadPool failed\n"), __FILE__, __LINE__);
+    } else if (Context.Failed) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i items completed out of order\n"), __FILE__, __LINE__);
+    } else if (Context.NextCompletion != TEST_THREAD_POOL_ITEM_COUNT) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i %i items completed, expected %i\n"), __FILE__, __LINE__, Context.NextCompletion, TEST_THREAD_POOL_ITEM_COUNT);
+    } else if (Context.NestedExecuted != TEST_THREAD_POOL_NESTED_COUNT) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i %i nested items executed, expected %i\n"), __FILE__, __LINE__, Context.NestedExecuted, TEST_THREAD_POOL_NESTED_COUNT);
+    } else {
+        Result = TRUE;
+    }
+
+    YoriLibDestroyThreadPool(Pool);
+    YoriLibFree(Items);
+    return Result;
+}
+
+/**
+ The number of files updated by the file update test.
+ */
+#define TEST_FILE_UPDATE_COUNT (200)
+
+/**
+ The number of updates allowed in progress against each volume by the file
+ update test.
+ */
+#define TEST_FILE_UPDATE_PER_VOLUME (3)
+
+/**
+ State shared by every update in the file update test.
+ */
+typedef struct _TEST_FILE_UPDATE_CONTEXT {
+
+    /**
+     The number of updates in progress against each of the two volumes.
+     */
+    LONG InProgress[2];
+
+    /**
+     The index of the next update expected to be reported.
+     */
+    DWORD NextReport;
+
+    /**
+     Set to TRUE if any update exceeded the limit for its volume or was
+     reported out of order.
+     */
+    BOOLEAN Failed;
+} TEST_FILE_UPDATE_CONTEXT, *PTEST_FILE_UPDATE_CONTEXT;
+
+/**
+ Generate the path of a file used by the file update test.  Files alternate
+ between two volumes.
+
+ @param Index The index of the file.
+
+ @param FilePath On successful completion, populated with the path.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestFileUpdatePath(
+    __in DWORD Index,
+    __inout PYORI_STRING FilePath
+    )
+{
+    TCHAR VolumeLetter;
+
+    VolumeLetter = 'C';
+    if ((Index % 2) != 0) {
+        VolumeLetter = 'D';
+    }
+
+    YoriLibYPrintf(FilePath, _T("%c:\\Dir\\File%i"), VolumeLetter, Index);
+    if (FilePath->StartOfString == NULL) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ Apply a simulated update, checking that the volume's limit is respected.
+
+ @param Update Pointer to the update.
+
+ @param Context Pointer to the test context.
+ */
+VOID
+TestFileUpdateApply(
+    __in PYORI_LIB_FILE_UPDATE Update,
+    __in PVOID Context
+    )
+{
+    PTEST_FILE_UPDATE_CONTEXT UpdateContext = (PTEST_FILE_UPDATE_CONTEXT)Context;
+    LONG VolumeIndex;
+
+    VolumeIndex = 0;
+    if (Update->FilePath.StartOfString[0] == 'D') {
+        VolumeIndex = 1;
+    }
+
+    if (InterlockedIncrement(&UpdateContext->InProgress[VolumeIndex]) > TEST_FILE_UPDATE_PER_VOLUME) {
+        UpdateContext->Failed = TRUE;
+    }
+
+    if (Update->FileInfo != NULL) {
+        Sleep(1);
+    }
+
+    InterlockedDecrement(&UpdateContext->InProgress[VolumeIndex]);
+    Update->Modified = TRUE;
+}
+
+/**
+ Report a simulated update, checking that it is reported in order.
+
+ @param Update Pointer to the update.
+
+ @param Context Pointer to the test context.
+ */
+VOID
+TestFileUpdateReport(
+    __in PYORI_LIB_FILE_UPDATE Update,
+    __in PVOID Context
+    )
+{
+    PTEST_FILE_UPDATE_CONTEXT UpdateContext = (PTEST_FILE_UPDATE_CONTEXT)Context;
+    YORI_STRING Expected;
+
+    YoriLibInitEmptyString(&Expected);
+    if (!TestFileUpdatePath(UpdateContext->NextReport, &Expected) ||
+        YoriLibCompareString(&Expected, &Update->FilePath) != 0 ||
+        !Update->Modified) {
+
+        UpdateContext->Failed = TRUE;
+    }
+    YoriLibFreeStringContents(&Expected);
+    UpdateContext->NextReport++;
+}
+
+/**
+ A test variation to apply simulated updates to files on two volumes,
+ checking that the number in progress against each volume is bounded and
+ that results are reported in the order updates were queued.
+ */
+BOOLEAN
+TestFileUpdate(VOID)
+{
+    PYORI_LIB_FILE_UPDATE_ENGINE Engine;
+    TEST_FILE_UPDATE_CONTEXT Context;
+    WIN32_FIND_DATA FileInfo;
+    YORI_STRING FilePath;
+    DWORD Index;
+
+    ZeroMemory(&Context, sizeof(Context));
+    ZeroMemory(&FileInfo, sizeof(FileInfo));
+    if (!YoriLibCreateFileUpdateEngine(TestFileUpdateApply, TestFileUpdateReport, &Context, TEST_FILE_UPDATE_PER_VOLUME, &Engine)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibCreateFileUpdateEngine failed\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    //
+    //  Some updates are queued without find data, and take less time than
+    //  others, so that they finish applying out of order.
+    //
+
+    YoriLibInitEmptyString(&FilePath);
+    for (Index = 0; Index < TEST_FILE_UPDATE_COUNT; Index++) {
+        if (!TestFileUpdatePath(Index, &FilePath) ||
+            !YoriLibQueueFileUpdate(Engine, &FilePath, ((Index % 3) == 0)?NULL:&FileInfo)) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibQueueFileUpdate failed\n"), __FILE__, __LINE__);
+            Context.Failed = TRUE;
+            break;
+        }
+    }
+    YoriLibFreeStringContents(&FilePath);
+
+    YoriLibDestroyFileUpdateEngine(Engine);
+
+    if (Context.Failed) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i updates exceeded the volume limit or were reported out of order\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    if (Context.NextReport != TEST_FILE_UPDATE_COUNT) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i %i updates reported, expected %i\n"), __FILE__, __LINE__, Context.NextReport, TEST_FILE_UPDATE_COUNT);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
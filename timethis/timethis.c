@@ -3,7 +3,7 @@
  *
  * Yori shell child process timer tool
  *
- * Copyright (c) 2017-2019 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -38,25 +38,38 @@ CHAR strTimeThisHelpText[] =
         "\n"
         "Runs a child program and times its execution.\n"
         "\n"
-        "TIMETHIS [-license] [-r] [-f <fmt>] <command>\n"
+        "TIMETHIS [-license] [-r] [-f <fmt>] [-n <runs> [-warmup <runs>] [-csv|-json]]\n"
+        "         <command>\n"
         "\n"
+        "   -csv               Display the result of each run as comma separated values\n"
+        "   -json              Display each run and summary statistics as JSON\n"
+        "   -n                 Run the command repeatedly and display statistics\n"
         "   -r                 Wait for all processes within the tree\n"
+        "   -warmup            Run the command before measuring and discard the results\n"
         "\n"
         "Format specifiers are:\n"
         "   $CHILDCPU$         Amount of CPU time used by the child process\n"
         "   $CHILDCPUMS$       Amount of CPU time used by the child process in ms\n"
+        "   $CHILDCYCLES$      Number of CPU cycles used by the child process\n"
         "   $CHILDKERNEL$      Amount of kernel time used by the child process\n"
         "   $CHILDKERNELMS$    Amount of kernel time used by the child process in ms\n"
         "   $CHILDUSER$        Amount of user time used by the child process\n"
         "   $CHILDUSERMS$      Amount of user time used by the child process in ms\n"
         "   $ELAPSEDTIME$      Amount of time taken to execute the child process\n"
         "   $ELAPSEDTIMEMS$    Amount of time taken to execute the child process in ms\n"
+        "   $PAGEFAULTS$       Number of page faults taken by all child processes\n"
+        "   $PEAKCOMMIT$       Peak memory committed by all child processes in bytes\n"
+        "   $PEAKWORKINGSET$   Peak working set of the child process in bytes\n"
+        "   $READBYTES$        Number of bytes read by all child processes\n"
+        "   $READOPS$          Number of read operations by all child processes\n"
         "   $TREECPU$          Amount of CPU time used by all child processes\n"
         "   $TREECPUMS$        Amount of CPU time used by all child processes in ms\n"
         "   $TREEKERNEL$       Amount of kernel time used by all child processes\n"
         "   $TREEKERNELMS$     Amount of kernel time used by all child processes in ms\n"
         "   $TREEUSER$         Amount of user time used by all child processes\n"
-        "   $TREEUSERMS$       Amount of user time used by all child processes in ms\n";
+        "   $TREEUSERMS$       Amount of user time used by all child processes in ms\n"
+        "   $WRITEBYTES$       Number of bytes written by all child processes\n"
+        "   $WRITEOPS$         Number of write operations by all child processes\n";
 
 /**
  Display usage text to the user.
@@ -159,43 +172,159 @@ TimeThisOutputTimestamp(
     return String.LengthInChars;
 }
 
+/**
+ The set of values measured for each execution of the child.
+ */
+typedef enum _TIMETHIS_METRIC {
+    TimeThisMetricElapsed = 0,
+    TimeThisMetricChildCpu,
+    TimeThisMetricChildKernel,
+    TimeThisMetricChildUser,
+    TimeThisMetricChildCycles,
+    TimeThisMetricTreeCpu,
+    TimeThisMetricTreeKernel,
+    TimeThisMetricTreeUser,
+    TimeThisMetricPeakWorkingSet,
+    TimeThisMetricPeakCommit,
+    TimeThisMetricPageFaults,
+    TimeThisMetricReadOperations,
+    TimeThisMetricWriteOperations,
+    TimeThisMetricReadBytes,
+    TimeThisMetricWriteBytes,
+    TimeThisMetricCount
+} TIMETHIS_METRIC;
 
 /**
- Context containing the results of execution to pass to helper function used
- to format output.
+ A description of a measured value, used when displaying it.
  */
-typedef struct _TIMETHIS_CONTEXT {
+typedef struct _TIMETHIS_METRIC_DESCRIPTION {
 
     /**
-     Amount of time in milliseconds that the immediate child process spent in
-     kernel execution.
+     The name to display for the value in a table.
      */
-    LARGE_INTEGER KernelTimeInMs;
+    LPCTSTR DisplayName;
 
     /**
-     Amount of time in milliseconds that the immediate child process spent in
-     user mode execution.
+     The name to use for the value in CSV or JSON output.
      */
-    LARGE_INTEGER UserTimeInMs;
+    LPCTSTR KeyName;
 
     /**
-     Amount of time in milliseconds that the child process tree spent in
-     kernel execution.
+     TRUE if the value is a time in 100ns units, which is displayed in
+     milliseconds.  FALSE if the value is a count.
      */
-    LARGE_INTEGER KernelTimeTreeInMs;
+    BOOLEAN IsTime;
+} TIMETHIS_METRIC_DESCRIPTION, *PTIMETHIS_METRIC_DESCRIPTION;
+
+/**
+ Descriptions of each measured value, in TIMETHIS_METRIC order.
+ */
+CONST TIMETHIS_METRIC_DESCRIPTION TimeThisMetrics[TimeThisMetricCount] = {
+    {_T("Elapsed time (ms)"),      _T("elapsed_ms"),       TRUE},
+    {_T("Child CPU time (ms)"),    _T("child_cpu_ms"),     TRUE},
+    {_T("Child kernel time (ms)"), _T("child_kernel_ms"),  TRUE},
+    {_T("Child user time (ms)"),   _T("child_user_ms"),    TRUE},
+    {_T("Child CPU cycles"),       _T("child_cycles"),     FALSE},
+    {_T("Tree CPU time (ms)"),     _T("tree_cpu_ms"),      TRUE},
+    {_T("Tree kernel time (ms)"),  _T("tree_kernel_ms"),   TRUE},
+    {_T("Tree user time (ms)"),    _T("tree_user_ms"),     TRUE},
+    {_T("Peak working set"),       _T("peak_working_set"), FALSE},
+    {_T("Peak commit"),            _T("peak_commit"),      FALSE},
+    {_T("Page faults"),            _T("page_faults"),      FALSE},
+    {_T("Read operations"),        _T("read_ops"),         FALSE},
+    {_T("Write operations"),       _T("write_ops"),        FALSE},
+    {_T("Read bytes"),             _T("read_bytes"),       FALSE},
+    {_T("Write bytes"),            _T("write_bytes"),      FALSE}
+};
+
+/**
+ The results of a single execution of the child.
+ */
+typedef struct _TIMETHIS_CONTEXT {
 
     /**
-     Amount of time in milliseconds that the child process tree spent in
-     user mode execution.
+     Each measured value, indexed by TIMETHIS_METRIC.  Times are in 100ns
+     units.
      */
-    LARGE_INTEGER UserTimeTreeInMs;
+    DWORDLONG Values[TimeThisMetricCount];
 
     /**
-     Amount of time taken to execute the child process.
+     The exit code of the child process.
      */
-    LARGE_INTEGER WallTimeInMs;
+    DWORD ExitCode;
 } TIMETHIS_CONTEXT, *PTIMETHIS_CONTEXT;
 
+/**
+ Summary statistics of a single measured value across every run.
+ */
+typedef struct _TIMETHIS_STATISTICS {
+
+    /**
+     The smallest value.
+     */
+    DWORDLONG Min;
+
+    /**
+     The middle value.
+     */
+    DWORDLONG Median;
+
+    /**
+     The average value.
+     */
+    DWORDLONG Mean;
+
+    /**
+     The value that 95% of runs are less than or equal to.
+     */
+    DWORDLONG P95;
+
+    /**
+     The standard deviation of the values.
+     */
+    DWORDLONG StdDev;
+} TIMETHIS_STATISTICS, *PTIMETHIS_STATISTICS;
+
+/**
+ Convert a value in 100ns units to a large integer of milliseconds.
+
+ @param Value The value in 100ns units.
+
+ @return The value in milliseconds.
+ */
+LARGE_INTEGER
+TimeThisToMs(
+    __in DWORDLONG Value
+    )
+{
+    LARGE_INTEGER Result;
+    Result.QuadPart = (LONGLONG)(Value / (10 * 1000));
+    return Result;
+}
+
+/**
+ Output a count from a run of the child.
+
+ @param Value The count to output.
+
+ @param OutputString Pointer to a string to populate with the contents of
+        the variable.
+
+ @return The number of characters populated into the variable, or the number
+         of characters required to successfully populate the contents into
+         the variable.
+ */
+YORI_ALLOC_SIZE_T
+TimeThisOutputCount(
+    __in DWORDLONG Value,
+    __inout PYORI_STRING OutputString
+    )
+{
+    LARGE_INTEGER LargeInt;
+    LargeInt.QuadPart = (LONGLONG)Value;
+    return TimeThisOutputLargeInteger(LargeInt, 10, OutputString);
+}
+
 /**
  A callback function to expand any known variables found when parsing the
  format string.
@@ -205,9 +334,9 @@ typedef struct _TIMETHIS_CONTEXT {
 
  @param VariableName The variable name to expand.
 
- @param Context Pointer to a SYSTEMTIME structure containing the data to
-        populate.
- 
+ @param Context Pointer to a TIMETHIS_CONTEXT structure containing the data
+        to populate.
+
  @return The number of characters successfully populated, or the number of
          characters required in order to successfully populate, or zero
          on error.
@@ -219,45 +348,573 @@ TimeThisExpandVariables(
     __in PVOID Context
     )
 {
-    LARGE_INTEGER CpuTime;
     PTIMETHIS_CONTEXT TimeThisContext = (PTIMETHIS_CONTEXT)Context;
+    PDWORDLONG Values = TimeThisContext->Values;
 
     if (YoriLibCompareStringLit(VariableName, _T("CHILDCPU")) == 0) {
-        CpuTime.QuadPart = TimeThisContext->KernelTimeInMs.QuadPart + TimeThisContext->UserTimeInMs.QuadPart;
-        return TimeThisOutputTimestamp(CpuTime, OutputBuffer);
+        return TimeThisOutputTimestamp(TimeThisToMs(Values[TimeThisMetricChildCpu]), OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("CHILDCPUMS")) == 0) {
-        CpuTime.QuadPart = TimeThisContext->KernelTimeInMs.QuadPart + TimeThisContext->UserTimeInMs.QuadPart;
-        return TimeThisOutputLargeInteger(CpuTime, 10, OutputBuffer);
+        return TimeThisOutputLargeInteger(TimeThisToMs(Values[TimeThisMetricChildCpu]), 10, OutputBuffer);
+    } else if (YoriLibCompareStringLit(VariableName, _T("CHILDCYCLES")) == 0) {
+        return TimeThisOutputCount(Values[TimeThisMetricChildCycles], OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("CHILDKERNEL")) == 0) {
-        return TimeThisOutputTimestamp(TimeThisContext->KernelTimeInMs, OutputBuffer);
+        return TimeThisOutputTimestamp(TimeThisToMs(Values[TimeThisMetricChildKernel]), OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("CHILDKERNELMS")) == 0) {
-        return TimeThisOutputLargeInteger(TimeThisContext->KernelTimeInMs, 10, OutputBuffer);
+        return TimeThisOutputLargeInteger(TimeThisToMs(Values[TimeThisMetricChildKernel]), 10, OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("CHILDUSER")) == 0) {
-        return TimeThisOutputTimestamp(TimeThisContext->UserTimeInMs, OutputBuffer);
+        return TimeThisOutputTimestamp(TimeThisToMs(Values[TimeThisMetricChildUser]), OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("CHILDUSERMS")) == 0) {
-        return TimeThisOutputLargeInteger(TimeThisContext->UserTimeInMs, 10, OutputBuffer);
+        return TimeThisOutputLargeInteger(TimeThisToMs(Values[TimeThisMetricChildUser]), 10, OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("ELAPSEDTIME")) == 0) {
-        return TimeThisOutputTimestamp(TimeThisContext->WallTimeInMs, OutputBuffer);
+        return TimeThisOutputTimestamp(TimeThisToMs(Values[TimeThisMetricElapsed]), OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("ELAPSEDTIMEMS")) == 0) {
-        return TimeThisOutputLargeInteger(TimeThisContext->WallTimeInMs, 10, OutputBuffer);
+        return TimeThisOutputLargeInteger(TimeThisToMs(Values[TimeThisMetricElapsed]), 10, OutputBuffer);
+    } else if (YoriLibCompareStringLit(VariableName, _T("PAGEFAULTS")) == 0) {
+        return TimeThisOutputCount(Values[TimeThisMetricPageFaults], OutputBuffer);
+    } else if (YoriLibCompareStringLit(VariableName, _T("PEAKCOMMIT")) == 0) {
+        return TimeThisOutputCount(Values[TimeThisMetricPeakCommit], OutputBuffer);
+    } else if (YoriLibCompareStringLit(VariableName, _T("PEAKWORKINGSET")) == 0) {
+        return TimeThisOutputCount(Values[TimeThisMetricPeakWorkingSet], OutputBuffer);
+    } else if (YoriLibCompareStringLit(VariableName, _T("READBYTES")) == 0) {
+        return TimeThisOutputCount(Values[TimeThisMetricReadBytes], OutputBuffer);
+    } else if (YoriLibCompareStringLit(VariableName, _T("READOPS")) == 0) {
+        return TimeThisOutputCount(Values[TimeThisMetricReadOperations], OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("TREECPU")) == 0) {
-        CpuTime.QuadPart = TimeThisContext->KernelTimeTreeInMs.QuadPart + TimeThisContext->UserTimeTreeInMs.QuadPart;
-        return TimeThisOutputTimestamp(CpuTime, OutputBuffer);
+        return TimeThisOutputTimestamp(TimeThisToMs(Values[TimeThisMetricTreeCpu]), OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("TREECPUMS")) == 0) {
-        CpuTime.QuadPart = TimeThisContext->KernelTimeTreeInMs.QuadPart + TimeThisContext->UserTimeTreeInMs.QuadPart;
-        return TimeThisOutputLargeInteger(CpuTime, 10, OutputBuffer);
+        return TimeThisOutputLargeInteger(TimeThisToMs(Values[TimeThisMetricTreeCpu]), 10, OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("TREEKERNEL")) == 0) {
-        return TimeThisOutputTimestamp(TimeThisContext->KernelTimeTreeInMs, OutputBuffer);
+        return TimeThisOutputTimestamp(TimeThisToMs(Values[TimeThisMetricTreeKernel]), OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("TREEKERNELMS")) == 0) {
-        return TimeThisOutputLargeInteger(TimeThisContext->KernelTimeTreeInMs, 10, OutputBuffer);
+        return TimeThisOutputLargeInteger(TimeThisToMs(Values[TimeThisMetricTreeKernel]), 10, OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("TREEUSER")) == 0) {
-        return TimeThisOutputTimestamp(TimeThisContext->UserTimeTreeInMs, OutputBuffer);
+        return TimeThisOutputTimestamp(TimeThisToMs(Values[TimeThisMetricTreeUser]), OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("TREEUSERMS")) == 0) {
-        return TimeThisOutputLargeInteger(TimeThisContext->UserTimeTreeInMs, 10, OutputBuffer);
+        return TimeThisOutputLargeInteger(TimeThisToMs(Values[TimeThisMetricTreeUser]), 10, OutputBuffer);
+    } else if (YoriLibCompareStringLit(VariableName, _T("WRITEBYTES")) == 0) {
+        return TimeThisOutputCount(Values[TimeThisMetricWriteBytes], OutputBuffer);
+    } else if (YoriLibCompareStringLit(VariableName, _T("WRITEOPS")) == 0) {
+        return TimeThisOutputCount(Values[TimeThisMetricWriteOperations], OutputBuffer);
     }
     return 0;
 }
 
+/**
+ Convert a FILETIME into a 64 bit integer.
+
+ @param FileTime Pointer to the FILETIME to convert.
+
+ @return The FILETIME as a 64 bit integer.
+ */
+DWORDLONG
+TimeThisFileTimeToInteger(
+    __in PFILETIME FileTime
+    )
+{
+    LARGE_INTEGER Value;
+    Value.HighPart = FileTime->dwHighDateTime;
+    Value.LowPart = FileTime->dwLowDateTime;
+    return (DWORDLONG)Value.QuadPart;
+}
+
+/**
+ Execute the child once and record the results.
+
+ @param CmdLine Pointer to the command line to execute.
+
+ @param Recursive If TRUE, wait for all processes within the tree to
+        terminate.  If FALSE, wait only for the immediate child.
+
+ @param TimeThisContext On successful completion, populated with the results
+        of executing the child.
+
+ @return TRUE to indicate the child was executed, FALSE if it could not be
+         launched or waiting for it was cancelled.
+ */
+BOOL
+TimeThisExecute(
+    __in PYORI_STRING CmdLine,
+    __in BOOLEAN Recursive,
+    __out PTIMETHIS_CONTEXT TimeThisContext
+    )
+{
+    PROCESS_INFORMATION ProcessInfo;
+    STARTUPINFO StartupInfo;
+    HANDLE hJob = NULL;
+    HANDLE hPort = NULL;
+    FILETIME ftCreationTime;
+    FILETIME ftExitTime;
+    FILETIME ftKernelTime;
+    FILETIME ftUserTime;
+    PROCESS_VM_COUNTERS VmInfo;
+    YORI_IO_COUNTERS IoCounters;
+    PDWORDLONG Values;
+
+    ZeroMemory(TimeThisContext, sizeof(TIMETHIS_CONTEXT));
+    Values = TimeThisContext->Values;
+
+    memset(&StartupInfo, 0, sizeof(StartupInfo));
+    StartupInfo.cb = sizeof(StartupInfo);
+
+    if (!CreateProcess(NULL, CmdLine->StartOfString, NULL, NULL, TRUE, CREATE_SUSPENDED | CREATE_DEFAULT_ERROR_MODE, NULL, NULL, &StartupInfo, &ProcessInfo)) {
+        DWORD LastError = GetLastError();
+        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: execution failed: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    hJob = YoriLibCreateJobObject();
+    if (hJob != NULL) {
+        if (Recursive) {
+            hPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+            if (hPort != NULL) {
+                YORI_JOB_ASSOCIATE_COMPLETION_PORT Port;
+                Port.Key = hJob;
+                Port.Port = hPort;
+                DllKernel32.pSetInformationJobObject(hJob, JobObjectAssociateCompletionPortInformation, &Port, sizeof(Port));
+            }
+        }
+        YoriLibAssignProcessToJobObject(hJob, ProcessInfo.hProcess);
+    }
+
+    ResumeThread(ProcessInfo.hThread);
+
+    //
+    //  Wait for the immediate child process to terminate.
+    //
+
+#if YORI_BUILTIN
+    {
+        HANDLE HandleArray[2];
+        DWORD WaitResult;
+
+        HandleArray[1] = YoriLibCancelGetEvent();
+        HandleArray[0] = ProcessInfo.hProcess;
+
+        WaitResult = WaitForMultipleObjectsEx(2, HandleArray, FALSE, INFINITE, FALSE);
+
+        //
+        //  If cancelled, abort
+        //
+
+        if (WaitResult == WAIT_OBJECT_0 + 1) {
+            CloseHandle(ProcessInfo.hProcess);
+            CloseHandle(ProcessInfo.hThread);
+            if (hPort != NULL) {
+                CloseHandle(hPort);
+            }
+            if (hJob != NULL) {
+                CloseHandle(hJob);
+            }
+
+            return FALSE;
+        }
+    }
+#else
+    WaitForSingleObject(ProcessInfo.hProcess, INFINITE);
+#endif
+    GetExitCodeProcess(ProcessInfo.hProcess, &TimeThisContext->ExitCode);
+
+    //
+    //  Save off times from the child process.
+    //
+
+    GetProcessTimes(ProcessInfo.hProcess, &ftCreationTime, &ftExitTime, &ftKernelTime, &ftUserTime);
+
+    Values[TimeThisMetricElapsed] = TimeThisFileTimeToInteger(&ftExitTime) - TimeThisFileTimeToInteger(&ftCreationTime);
+    Values[TimeThisMetricChildKernel] = TimeThisFileTimeToInteger(&ftKernelTime);
+    Values[TimeThisMetricChildUser] = TimeThisFileTimeToInteger(&ftUserTime);
+
+    //
+    //  Cycle counts are more precise than times, which are only updated
+    //  on each clock tick, so short runs can be compared meaningfully.
+    //
+
+    if (DllKernel32.pQueryProcessCycleTime != NULL) {
+        DllKernel32.pQueryProcessCycleTime(ProcessInfo.hProcess, &Values[TimeThisMetricChildCycles]);
+    }
+
+    //
+    //  Save off memory and IO usage from the child process.  These are
+    //  replaced with values for the whole tree if the job can report them.
+    //
+
+    if (DllNtDll.pNtQueryInformationProcess != NULL) {
+        DWORD dwBytesReturned;
+        if (DllNtDll.pNtQueryInformationProcess(ProcessInfo.hProcess, ProcessVmCounters, &VmInfo, sizeof(VmInfo), &dwBytesReturned) == 0) {
+            Values[TimeThisMetricPeakWorkingSet] = VmInfo.PeakWorkingSetSize;
+            Values[TimeThisMetricPeakCommit] = VmInfo.PeakCommitUsage;
+            Values[TimeThisMetricPageFaults] = VmInfo.PageFaultCount;
+        }
+    }
+
+    if (DllKernel32.pGetProcessIoCounters != NULL &&
+        DllKernel32.pGetProcessIoCounters(ProcessInfo.hProcess, &IoCounters)) {
+
+        Values[TimeThisMetricReadOperations] = IoCounters.ReadOperations;
+        Values[TimeThisMetricWriteOperations] = IoCounters.WriteOperations;
+        Values[TimeThisMetricReadBytes] = IoCounters.ReadBytes;
+        Values[TimeThisMetricWriteBytes] = IoCounters.WriteBytes;
+    }
+
+    //
+    //  Save off times from all processes within the job, if it exists.
+    //
+
+    Values[TimeThisMetricTreeKernel] = Values[TimeThisMetricChildKernel];
+    Values[TimeThisMetricTreeUser] = Values[TimeThisMetricChildUser];
+
+    if (hJob != NULL) {
+        YORI_JOB_BASIC_AND_IO_ACCOUNTING_INFORMATION JobInfo;
+        YORI_JOB_EXTENDED_LIMIT_INFORMATION LimitInfo;
+        DWORD BytesReturned;
+
+        if (hPort != NULL) {
+            DWORD CompletionCode;
+            ULONG_PTR CompletionKey;
+            LPOVERLAPPED Overlapped;
+            while (GetQueuedCompletionStatus(hPort, &CompletionCode, &CompletionKey, &Overlapped, INFINITE) &&
+                !((HANDLE)CompletionKey == hJob && CompletionCode == JOB_OBJECT_MSG_ACTIVE_PROCESS_ZERO)) {
+            }
+            CloseHandle(hPort);
+        }
+
+        if (DllKernel32.pQueryInformationJobObject != NULL) {
+            if (DllKernel32.pQueryInformationJobObject(hJob, JobObjectBasicAndIoAccountingInformation, &JobInfo, sizeof(JobInfo), &BytesReturned)) {
+                Values[TimeThisMetricTreeKernel] = JobInfo.BasicInfo.TotalKernelTime.QuadPart;
+                Values[TimeThisMetricTreeUser] = JobInfo.BasicInfo.TotalUserTime.QuadPart;
+                Values[TimeThisMetricPageFaults] = JobInfo.BasicInfo.TotalPageFaultCount;
+                Values[TimeThisMetricReadOperations] = JobInfo.IoInfo.ReadOperations;
+                Values[TimeThisMetricWriteOperations] = JobInfo.IoInfo.WriteOperations;
+                Values[TimeThisMetricReadBytes] = JobInfo.IoInfo.ReadBytes;
+                Values[TimeThisMetricWriteBytes] = JobInfo.IoInfo.WriteBytes;
+            } else {
+                YORI_JOB_BASIC_ACCOUNTING_INFORMATION BasicInfo;
+                if (DllKernel32.pQueryInformationJobObject(hJob, 1, &BasicInfo, sizeof(BasicInfo), &BytesReturned)) {
+                    Values[TimeThisMetricTreeKernel] = BasicInfo.TotalKernelTime.QuadPart;
+                    Values[TimeThisMetricTreeUser] = BasicInfo.TotalUserTime.QuadPart;
+                    Values[TimeThisMetricPageFaults] = BasicInfo.TotalPageFaultCount;
+                }
+            }
+
+            if (DllKernel32.pQueryInformationJobObject(hJob, JobObjectExtendedLimitInformation, &LimitInfo, sizeof(LimitInfo), &BytesReturned)) {
+                Values[TimeThisMetricPeakCommit] = LimitInfo.PeakJobMemoryUsed;
+            }
+        }
+        CloseHandle(hJob);
+    }
+
+    Values[TimeThisMetricChildCpu] = Values[TimeThisMetricChildKernel] + Values[TimeThisMetricChildUser];
+    Values[TimeThisMetricTreeCpu] = Values[TimeThisMetricTreeKernel] + Values[TimeThisMetricTreeUser];
+
+    CloseHandle(ProcessInfo.hProcess);
+    CloseHandle(ProcessInfo.hThread);
+
+    return TRUE;
+}
+
+/**
+ Calculate the integer square root of a value.
+
+ @param Value The value to calculate the square root of.
+
+ @return The largest integer whose square is less than or equal to Value.
+ */
+DWORDLONG
+TimeThisSquareRoot(
+    __in DWORDLONG Value
+    )
+{
+    DWORDLONG Root;
+    DWORDLONG Next;
+
+    if (Value < 2) {
+        return Value;
+    }
+
+    //
+    //  Newton's method converges from above when started from a value no
+    //  smaller than the root.  Half of the value is at least the root for
+    //  values of four or more, and for two and three it is already the
+    //  result.
+    //
+
+    Root = Value;
+    Next = Value / 2;
+    while (Next < Root) {
+        Root = Next;
+        Next = (Root + Value / Root) / 2;
+    }
+
+    return Root;
+}
+
+/**
+ Calculate summary statistics for a single measured value across every run.
+
+ @param Runs Pointer to an array of results from each run.
+
+ @param RunCount The number of elements in the Runs array.
+
+ @param Metric The measured value to calculate statistics for.
+
+ @param SortBuffer Pointer to an array of RunCount elements to use when
+        sorting values.
+
+ @param Statistics On completion, populated with the statistics.
+ */
+VOID
+TimeThisCalculateStatistics(
+    __in PTIMETHIS_CONTEXT Runs,
+    __in DWORD RunCount,
+    __in TIMETHIS_METRIC Metric,
+    __inout PDWORDLONG SortBuffer,
+    __out PTIMETHIS_STATISTICS Statistics
+    )
+{
+    DWORD Index;
+    DWORD InsertIndex;
+    DWORDLONG Value;
+    DWORDLONG Total;
+    DWORDLONG Difference;
+    DWORDLONG MaxDifference;
+    DWORDLONG Variance;
+    DWORD Shift;
+
+    //
+    //  The number of runs is specified by the user and is expected to be
+    //  small, so an insertion sort is sufficient.
+    //
+
+    Total = 0;
+    for (Index = 0; Index < RunCount; Index++) {
+        Value = Runs[Index].Values[Metric];
+        Total = Total + Value;
+        for (InsertIndex = Index; InsertIndex > 0 && SortBuffer[InsertIndex - 1] > Value; InsertIndex--) {
+            SortBuffer[InsertIndex] = SortBuffer[InsertIndex - 1];
+        }
+        SortBuffer[InsertIndex] = Value;
+    }
+
+    Statistics->Min = SortBuffer[0];
+    Statistics->Mean = Total / RunCount;
+    if (RunCount % 2 == 0) {
+        Statistics->Median = (SortBuffer[RunCount / 2 - 1] + SortBuffer[RunCount / 2]) / 2;
+    } else {
+        Statistics->Median = SortBuffer[RunCount / 2];
+    }
+
+    //
+    //  Use the nearest rank, which is the smallest value that at least 95%
+    //  of values are less than or equal to.
+    //
+
+    Statistics->P95 = SortBuffer[(RunCount * 95 + 99) / 100 - 1];
+
+    //
+    //  Values such as byte counts can be large enough that squaring the
+    //  difference from the mean overflows, so scale the differences down
+    //  until each square fits in 62 bits, and scale the result back up.
+    //
+
+    MaxDifference = 0;
+    for (Index = 0; Index < RunCount; Index++) {
+        Value = Runs[Index].Values[Metric];
+        if (Value > Statistics->Mean) {
+            Difference = Value - Statistics->Mean;
+        } else {
+            Difference = Statistics->Mean - Value;
+        }
+        if (Difference > MaxDifference) {
+            MaxDifference = Difference;
+        }
+    }
+
+    Shift = 0;
+    while ((MaxDifference >> Shift) > 0x7FFFFFFF) {
+        Shift++;
+    }
+
+    Variance = 0;
+    for (Index = 0; Index < RunCount; Index++) {
+        Value = Runs[Index].Values[Metric];
+        if (Value > Statistics->Mean) {
+            Difference = Value - Statistics->Mean;
+        } else {
+            Difference = Statistics->Mean - Value;
+        }
+        Difference = Difference >> Shift;
+        Variance = Variance + Difference * Difference / RunCount;
+    }
+    Statistics->StdDev = TimeThisSquareRoot(Variance) << Shift;
+}
+
+/**
+ Format a measured value for display.  Times are displayed in milliseconds
+ with microsecond precision.
+
+ @param Value The value to format.
+
+ @param Metric The measured value, which determines how it is displayed.
+
+ @param Buffer Pointer to a buffer to populate with the formatted value.
+
+ @param BufferLength The number of characters in Buffer.
+ */
+VOID
+TimeThisFormatValue(
+    __in DWORDLONG Value,
+    __in TIMETHIS_METRIC Metric,
+    __out_ecount(BufferLength) LPTSTR Buffer,
+    __in YORI_ALLOC_SIZE_T BufferLength
+    )
+{
+    if (TimeThisMetrics[Metric].IsTime) {
+        YoriLibSPrintfS(Buffer, BufferLength, _T("%lli.%03i"), (LONGLONG)(Value / (10 * 1000)), (DWORD)((Value / 10) % 1000));
+    } else {
+        YoriLibSPrintfS(Buffer, BufferLength, _T("%lli"), (LONGLONG)Value);
+    }
+}
+
+/**
+ Display summary statistics for every measured value as a table.
+
+ @param Runs Pointer to an array of results from each run.
+
+ @param RunCount The number of elements in the Runs array.
+
+ @param SortBuffer Pointer to an array of RunCount elements to use when
+        sorting values.
+ */
+VOID
+TimeThisDisplaySummary(
+    __in PTIMETHIS_CONTEXT Runs,
+    __in DWORD RunCount,
+    __inout PDWORDLONG SortBuffer
+    )
+{
+    TIMETHIS_STATISTICS Statistics;
+    TCHAR Min[32];
+    TCHAR Median[32];
+    TCHAR Mean[32];
+    TCHAR P95[32];
+    TCHAR StdDev[32];
+    DWORD Metric;
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Runs: %i\n\n"), RunCount);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%-24s %14s %14s %14s %14s %14s\n"), _T(""), _T("Min"), _T("Median"), _T("Mean"), _T("P95"), _T("StdDev"));
+
+    for (Metric = 0; Metric < TimeThisMetricCount; Metric++) {
+        TimeThisCalculateStatistics(Runs, RunCount, Metric, SortBuffer, &Statistics);
+        TimeThisFormatValue(Statistics.Min, Metric, Min, sizeof(Min)/sizeof(Min[0]));
+        TimeThisFormatValue(Statistics.Median, Metric, Median, sizeof(Median)/sizeof(Median[0]));
+        TimeThisFormatValue(Statistics.Mean, Metric, Mean, sizeof(Mean)/sizeof(Mean[0]));
+        TimeThisFormatValue(Statistics.P95, Metric, P95, sizeof(P95)/sizeof(P95[0]));
+        TimeThisFormatValue(Statistics.StdDev, Metric, StdDev, sizeof(StdDev)/sizeof(StdDev[0]));
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%-24s %14s %14s %14s %14s %14s\n"), TimeThisMetrics[Metric].DisplayName, Min, Median, Mean, P95, StdDev);
+    }
+}
+
+/**
+ Display the results of each run as comma separated values.
+
+ @param Runs Pointer to an array of results from each run.
+
+ @param RunCount The number of elements in the Runs array.
+ */
+VOID
+TimeThisDisplayCsv(
+    __in PTIMETHIS_CONTEXT Runs,
+    __in DWORD RunCount
+    )
+{
+    TCHAR Value[32];
+    DWORD Index;
+    DWORD Metric;
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("run,exit_code"));
+    for (Metric = 0; Metric < TimeThisMetricCount; Metric++) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(",%s"), TimeThisMetrics[Metric].KeyName);
+    }
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+
+    for (Index = 0; Index < RunCount; Index++) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%i,%i"), Index + 1, Runs[Index].ExitCode);
+        for (Metric = 0; Metric < TimeThisMetricCount; Metric++) {
+            TimeThisFormatValue(Runs[Index].Values[Metric], Metric, Value, sizeof(Value)/sizeof(Value[0]));
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(",%s"), Value);
+        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+    }
+}
+
+/**
+ Display the results of each run and summary statistics as JSON.
+
+ @param Runs Pointer to an array of results from each run.
+
+ @param RunCount The number of elements in the Runs array.
+
+ @param SortBuffer Pointer to an array of RunCount elements to use when
+        sorting values.
+ */
+VOID
+TimeThisDisplayJson(
+    __in PTIMETHIS_CONTEXT Runs,
+    __in DWORD RunCount,
+    __inout PDWORDLONG SortBuffer
+    )
+{
+    TIMETHIS_STATISTICS Statistics;
+    TCHAR Min[32];
+    TCHAR Median[32];
+    TCHAR Mean[32];
+    TCHAR P95[32];
+    TCHAR StdDev[32];
+    DWORD Index;
+    DWORD Metric;
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("{\n  \"runs\": [\n"));
+    for (Index = 0; Index < RunCount; Index++) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("    {\"exit_code\": %i"), Runs[Index].ExitCode);
+        for (Metric = 0; Metric < TimeThisMetricCount; Metric++) {
+            TimeThisFormatValue(Runs[Index].Values[Metric], Metric, Min, sizeof(Min)/sizeof(Min[0]));
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(", \"%s\": %s"), TimeThisMetrics[Metric].KeyName, Min);
+        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("}%s\n"), (Index + 1 < RunCount)?_T(","):_T(""));
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  ],\n  \"summary\": {\n"));
+    for (Metric = 0; Metric < TimeThisMetricCount; Metric++) {
+        TimeThisCalculateStatistics(Runs, RunCount, Metric, SortBuffer, &Statistics);
+        TimeThisFormatValue(Statistics.Min, Metric, Min, sizeof(Min)/sizeof(Min[0]));
+        TimeThisFormatValue(Statistics.Median, Metric, Median, sizeof(Median)/sizeof(Median[0]));
+        TimeThisFormatValue(Statistics.Mean, Metric, Mean, sizeof(Mean)/sizeof(Mean[0]));
+        TimeThisFormatValue(Statistics.P95, Metric, P95, sizeof(P95)/sizeof(P95[0]));
+        TimeThisFormatValue(Statistics.StdDev, Metric, StdDev, sizeof(StdDev)/sizeof(StdDev[0]));
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                      _T("    \"%s\": {\"min\": %s, \"median\": %s, \"mean\": %s, \"p95\": %s, \"stddev\": %s}%s\n"),
+                      TimeThisMetrics[Metric].KeyName,
+                      Min,
+                      Median,
+                      Mean,
+                      P95,
+                      StdDev,
+                      (Metric + 1 < TimeThisMetricCount)?_T(","):_T(""));
+    }
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  }\n}\n"));
+}
+
+/**
+ The ways that results from repeated runs can be displayed.
+ */
+typedef enum _TIMETHIS_REPORT_FORMAT {
+    TimeThisReportTable = 0,
+    TimeThisReportCsv = 1,
+    TimeThisReportJson = 2
+} TIMETHIS_REPORT_FORMAT;
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the timethis builtin command.
@@ -290,25 +947,23 @@ ENTRYPOINT(
     DWORD ExitCode;
     BOOLEAN ArgumentUnderstood;
     BOOLEAN Recursive = FALSE;
+    BOOLEAN RepeatRequested = FALSE;
+    TIMETHIS_REPORT_FORMAT ReportFormat = TimeThisReportTable;
     YORI_ALLOC_SIZE_T StartArg = 0;
     YORI_ALLOC_SIZE_T i;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    YORI_MAX_SIGNED_T llTemp;
     YORI_STRING Arg;
     YORI_STRING DisplayString;
     YORI_STRING AllocatedFormatString;
     TIMETHIS_CONTEXT TimeThisContext;
+    PTIMETHIS_CONTEXT Runs;
+    PDWORDLONG SortBuffer;
+    DWORD RunCount = 1;
+    DWORD WarmupCount = 0;
+    DWORD Index;
     YORI_STRING Executable;
     PYORI_STRING ChildArgs;
-    PROCESS_INFORMATION ProcessInfo;
-    STARTUPINFO StartupInfo;
-    HANDLE hJob = NULL;
-    HANDLE hPort = NULL;
-    FILETIME ftCreationTime;
-    FILETIME ftExitTime;
-    FILETIME ftKernelTime;
-    FILETIME ftUserTime;
-
-    LARGE_INTEGER liCreationTime;
-    LARGE_INTEGER liExitTime;
     LPTSTR DefaultFormatString = _T("Elapsed time:      $ELAPSEDTIME$\n")
                                  _T("Child CPU time:    $CHILDCPU$\n")
                                  _T("Child kernel time: $CHILDKERNEL$\n")
@@ -331,11 +986,40 @@ ENTRYPOINT(
                 TimeThisHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2017-2019"));
+                YoriLibDisplayMitLicense(_T("2017-2026"));
                 return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("csv")) == 0) {
+                ReportFormat = TimeThisReportCsv;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("json")) == 0) {
+                ReportFormat = TimeThisReportJson;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("n")) == 0) {
+                if (ArgC > i + 1 &&
+                    YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                    CharsConsumed > 0 &&
+                    llTemp > 0 &&
+                    llTemp <= 0x10000) {
+
+                    RunCount = (DWORD)llTemp;
+                    RepeatRequested = TRUE;
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("r")) == 0) {
                 Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("warmup")) == 0) {
+                if (ArgC > i + 1 &&
+                    YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                    CharsConsumed > 0 &&
+                    llTemp >= 0 &&
+                    llTemp <= 0x10000) {
+
+                    WarmupCount = (DWORD)llTemp;
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("f")) == 0) {
                 if (ArgC > i + 1) {
                     YoriLibFreeStringContents(&AllocatedFormatString);
@@ -357,6 +1041,7 @@ ENTRYPOINT(
 
     if (StartArg == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: missing argument\n"));
+        YoriLibFreeStringContents(&AllocatedFormatString);
         return EXIT_FAILURE;
     }
 
@@ -392,135 +1077,75 @@ ENTRYPOINT(
 
     ASSERT(YoriLibIsStringNullTerminated(&CmdLine));
 
-    memset(&StartupInfo, 0, sizeof(StartupInfo));
-    StartupInfo.cb = sizeof(StartupInfo);
-
-    if (!CreateProcess(NULL, CmdLine.StartOfString, NULL, NULL, TRUE, CREATE_SUSPENDED | CREATE_DEFAULT_ERROR_MODE, NULL, NULL, &StartupInfo, &ProcessInfo)) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: execution failed: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFree(ChildArgs);
-        YoriLibFreeStringContents(&CmdLine);
-        YoriLibFreeStringContents(&Executable);
-        YoriLibFreeStringContents(&AllocatedFormatString);
-        return EXIT_FAILURE;
-    }
-
-    hJob = YoriLibCreateJobObject();
-    if (hJob != NULL) {
-        if (Recursive) {
-            hPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
-            if (hPort != NULL) {
-                YORI_JOB_ASSOCIATE_COMPLETION_PORT Port;
-                Port.Key = hJob;
-                Port.Port = hPort;
-                DllKernel32.pSetInformationJobObject(hJob, JobObjectAssociateCompletionPortInformation, &Port, sizeof(Port));
-            }
-        }
-        YoriLibAssignProcessToJobObject(hJob, ProcessInfo.hProcess);
-    }
-
-    ResumeThread(ProcessInfo.hThread);
-
     YoriLibFreeStringContents(&Executable);
-    YoriLibFreeStringContents(&CmdLine);
     YoriLibFree(ChildArgs);
 
-    //
-    //  Wait for the immediate child process to terminate.
-    //
+    YoriLibLoadNtDllFunctions();
 
 #if YORI_BUILTIN
-    {
-        HANDLE HandleArray[2];
-        DWORD WaitResult;
-
-        YoriLibCancelEnable(FALSE);
-        HandleArray[1] = YoriLibCancelGetEvent();
-        HandleArray[0] = ProcessInfo.hProcess;
-
-        WaitResult = WaitForMultipleObjectsEx(2, HandleArray, FALSE, INFINITE, FALSE);
-
-        //
-        //  If cancelled, abort
-        //
-
-        if (WaitResult == WAIT_OBJECT_0 + 1) {
-            CloseHandle(ProcessInfo.hProcess);
-            CloseHandle(ProcessInfo.hThread);
-            if (hJob != NULL) {
-                CloseHandle(hJob);
-            }
-            YoriLibFreeStringContents(&AllocatedFormatString);
-
-            return EXIT_FAILURE;
-        }
-    }
-#else
-    WaitForSingleObject(ProcessInfo.hProcess, INFINITE);
+    YoriLibCancelEnable(FALSE);
 #endif
-    GetExitCodeProcess(ProcessInfo.hProcess, &ExitCode);
 
     //
-    //  Save off times from the child process.
+    //  With a single run, display the results using the format string.
     //
 
-    GetProcessTimes(ProcessInfo.hProcess, &ftCreationTime, &ftExitTime, &ftKernelTime, &ftUserTime);
-
-    liCreationTime.HighPart = ftCreationTime.dwHighDateTime;
-    liCreationTime.LowPart = ftCreationTime.dwLowDateTime;
-    liExitTime.HighPart = ftExitTime.dwHighDateTime;
-    liExitTime.LowPart = ftExitTime.dwLowDateTime;
-    TimeThisContext.KernelTimeInMs.HighPart = ftKernelTime.dwHighDateTime;
-    TimeThisContext.KernelTimeInMs.LowPart = ftKernelTime.dwLowDateTime;
-    TimeThisContext.KernelTimeInMs.QuadPart = TimeThisContext.KernelTimeInMs.QuadPart / (10 * 1000);
-    TimeThisContext.UserTimeInMs.HighPart = ftUserTime.dwHighDateTime;
-    TimeThisContext.UserTimeInMs.LowPart = ftUserTime.dwLowDateTime;
-    TimeThisContext.UserTimeInMs.QuadPart = TimeThisContext.UserTimeInMs.QuadPart / (10 * 1000);
+    if (!RepeatRequested) {
+        if (!TimeThisExecute(&CmdLine, Recursive, &TimeThisContext)) {
+            YoriLibFreeStringContents(&CmdLine);
+            YoriLibFreeStringContents(&AllocatedFormatString);
+            return EXIT_FAILURE;
+        }
+        YoriLibFreeStringContents(&CmdLine);
 
-    TimeThisContext.WallTimeInMs.QuadPart = (liExitTime.QuadPart - liCreationTime.QuadPart) / (10 * 1000);
+        YoriLibInitEmptyString(&DisplayString);
+        YoriLibExpandCommandVariables(&AllocatedFormatString, '$', TimeThisExpandVariables, &TimeThisContext, &DisplayString);
+        if (DisplayString.StartOfString != NULL) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+            YoriLibFreeStringContents(&DisplayString);
+        }
+        YoriLibFreeStringContents(&AllocatedFormatString);
 
-    //
-    //  Save off times from all processes within the job, if it exists.
-    //
+        return TimeThisContext.ExitCode;
+    }
 
-    TimeThisContext.KernelTimeTreeInMs.QuadPart = TimeThisContext.KernelTimeInMs.QuadPart;
-    TimeThisContext.UserTimeTreeInMs.QuadPart = TimeThisContext.UserTimeInMs.QuadPart;
+    YoriLibFreeStringContents(&AllocatedFormatString);
 
-    if (hJob != NULL) {
-        YORI_JOB_BASIC_ACCOUNTING_INFORMATION JobInfo;
-        DWORD BytesReturned;
+    Runs = YoriLibMalloc(RunCount * (sizeof(TIMETHIS_CONTEXT) + sizeof(DWORDLONG)));
+    if (Runs == NULL) {
+        YoriLibFreeStringContents(&CmdLine);
+        return EXIT_FAILURE;
+    }
+    SortBuffer = (PDWORDLONG)&Runs[RunCount];
 
-        if (hPort != NULL) {
-            DWORD CompletionCode;
-            ULONG_PTR CompletionKey;
-            LPOVERLAPPED Overlapped;
-            while (GetQueuedCompletionStatus(hPort, &CompletionCode, &CompletionKey, &Overlapped, INFINITE) &&
-                !((HANDLE)CompletionKey == hJob && CompletionCode == JOB_OBJECT_MSG_ACTIVE_PROCESS_ZERO)) {
-            }
-            CloseHandle(hPort);
+    for (Index = 0; Index < WarmupCount; Index++) {
+        if (!TimeThisExecute(&CmdLine, Recursive, &TimeThisContext)) {
+            YoriLibFree(Runs);
+            YoriLibFreeStringContents(&CmdLine);
+            return EXIT_FAILURE;
         }
+    }
 
-        if (DllKernel32.pQueryInformationJobObject != NULL &&
-            DllKernel32.pQueryInformationJobObject(hJob, 1, &JobInfo, sizeof(JobInfo), &BytesReturned)) {
-
-            TimeThisContext.KernelTimeTreeInMs.QuadPart = JobInfo.TotalKernelTime.QuadPart / (10 * 1000);
-            TimeThisContext.UserTimeTreeInMs.QuadPart = JobInfo.TotalUserTime.QuadPart / (10 * 1000);
+    for (Index = 0; Index < RunCount; Index++) {
+        if (!TimeThisExecute(&CmdLine, Recursive, &Runs[Index])) {
+            YoriLibFree(Runs);
+            YoriLibFreeStringContents(&CmdLine);
+            return EXIT_FAILURE;
         }
-        CloseHandle(hJob);
     }
 
-    CloseHandle(ProcessInfo.hProcess);
-    CloseHandle(ProcessInfo.hThread);
+    YoriLibFreeStringContents(&CmdLine);
 
-    YoriLibInitEmptyString(&DisplayString);
-    YoriLibExpandCommandVariables(&AllocatedFormatString, '$', TimeThisExpandVariables, &TimeThisContext, &DisplayString);
-    if (DisplayString.StartOfString != NULL) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
-        YoriLibFreeStringContents(&DisplayString);
+    if (ReportFormat == TimeThisReportCsv) {
+        TimeThisDisplayCsv(Runs, RunCount);
+    } else if (ReportFormat == TimeThisReportJson) {
+        TimeThisDisplayJson(Runs, RunCount, SortBuffer);
+    } else {
+        TimeThisDisplaySummary(Runs, RunCount, SortBuffer);
     }
-    YoriLibFreeStringContents(&AllocatedFormatString);
+
+    ExitCode = Runs[RunCount - 1].ExitCode;
+    YoriLibFree(Runs);
 
     return ExitCode;
 }
@@ -3,7 +3,7 @@
  *
  * Yori create files or update timestamps
  *
- * Copyright (c) 2018-2022 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -104,29 +104,36 @@ typedef struct _TOUCH_CONTEXT {
      */
     BOOLEAN NoFollowLinks;
 
+    /**
+     The engine used to create files and update timestamps in parallel.
+     */
+    PYORI_LIB_FILE_UPDATE_ENGINE Engine;
+
 } TOUCH_CONTEXT, *PTOUCH_CONTEXT;
 
 /**
- A callback that is invoked when a file is found that matches a search criteria
- specified in the set of strings to enumerate.
-
- @param FilePath Pointer to the file path that was found.
-
- @param FileInfo Information about the file.  Note in this application this can
-        be NULL when it is operating on files that do not yet exist.
+ The step of a timestamp update that failed.
+ */
+typedef enum _TOUCH_UPDATE_STEP {
+    TouchUpdateStepOpen = 0,
+    TouchUpdateStepSize = 1,
+    TouchUpdateStepTimestamps = 2
+} TOUCH_UPDATE_STEP;
 
- @param Depth Specifies the recursion depth.  Ignored in this application.
+/**
+ Create a file or update its timestamps.  This is invoked on a worker
+ thread.
 
- @param Context Pointer to the touch context structure indicating the
-        action to perform and populated with the file and line count found.
+ @param Update Pointer to the update describing the file.  If no
+        information is available from enumeration, the file is assumed not
+        to exist and may be created.  On completion, this is updated with
+        the result.
 
- @return TRUE to continute enumerating, FALSE to abort.
+ @param Context Pointer to the touch context.
  */
-BOOL
-TouchFileFoundCallback(
-    __in PYORI_STRING FilePath,
-    __in_opt PWIN32_FIND_DATA FileInfo,
-    __in DWORD Depth,
+VOID
+TouchApplyFile(
+    __in PYORI_LIB_FILE_UPDATE Update,
     __in PVOID Context
     )
 {
@@ -134,14 +141,10 @@ TouchFileFoundCallback(
     DWORD DesiredAccess;
     DWORD OpenFlags;
     PTOUCH_CONTEXT TouchContext = (PTOUCH_CONTEXT)Context;
-
-    UNREFERENCED_PARAMETER(Depth);
-    UNREFERENCED_PARAMETER(FileInfo);
-
-    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+    LARGE_INTEGER NewFileSize;
 
     DesiredAccess = GENERIC_READ | FILE_WRITE_ATTRIBUTES;
-    if (FileInfo == NULL) {
+    if (Update->FileInfo == NULL) {
         DesiredAccess |= GENERIC_WRITE;
     }
 
@@ -150,7 +153,7 @@ TouchFileFoundCallback(
         OpenFlags = OpenFlags | FILE_FLAG_OPEN_REPARSE_POINT;
     }
 
-    FileHandle = CreateFile(FilePath->StartOfString,
+    FileHandle = CreateFile(Update->FilePath.StartOfString,
                             DesiredAccess,
                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
                             NULL,
@@ -159,23 +162,18 @@ TouchFileFoundCallback(
                             NULL);
 
     if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("touch: open of %y failed: %s"), FilePath, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        return TRUE;
+        Update->Error = GetLastError();
+        Update->FailedStep = TouchUpdateStepOpen;
+        return;
     }
 
-    TouchContext->FilesFoundThisArg++;
-
-    if (FileInfo == NULL) {
+    if (Update->FileInfo == NULL) {
         if (TouchContext->NewFileSize.QuadPart != 0) {
-            SetFilePointer(FileHandle, TouchContext->NewFileSize.LowPart, &TouchContext->NewFileSize.HighPart, FILE_BEGIN);
+            NewFileSize.QuadPart = TouchContext->NewFileSize.QuadPart;
+            SetFilePointer(FileHandle, NewFileSize.LowPart, &NewFileSize.HighPart, FILE_BEGIN);
             if (!SetEndOfFile(FileHandle)) {
-                DWORD LastError = GetLastError();
-                LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("touch: setting file size of %y failed: %s"), FilePath, ErrText);
-                YoriLibFreeWinErrorText(ErrText);
+                Update->Error = GetLastError();
+                Update->FailedStep = TouchUpdateStepSize;
 
                 //
                 //  Intentional fallout
@@ -185,17 +183,85 @@ TouchFileFoundCallback(
     }
 
     if (!SetFileTime(FileHandle, &TouchContext->NewCreationTime, &TouchContext->NewAccessTime, &TouchContext->NewWriteTime)) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("touch: updating timestamps of %y failed: %s"), FilePath, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-
-        //
-        //  Intentional fallout
-        //
+        if (Update->Error == ERROR_SUCCESS) {
+            Update->Error = GetLastError();
+            Update->FailedStep = TouchUpdateStepTimestamps;
+        }
+    } else {
+        Update->Modified = TRUE;
     }
 
     CloseHandle(FileHandle);
+}
+
+/**
+ Report the result of creating a file or updating its timestamps.  This is
+ invoked for one file at a time, in the order that files were found.
+
+ @param Update Pointer to the update describing the file and its result.
+
+ @param Context Pointer to the touch context.
+ */
+VOID
+TouchReportFile(
+    __in PYORI_LIB_FILE_UPDATE Update,
+    __in PVOID Context
+    )
+{
+    LPTSTR ErrText;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    if (Update->Error == ERROR_SUCCESS) {
+        return;
+    }
+
+    ErrText = YoriLibGetWinErrorText(Update->Error);
+    if (Update->FailedStep == TouchUpdateStepOpen) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("touch: open of %y failed: %s"), &Update->FilePath, ErrText);
+    } else if (Update->FailedStep == TouchUpdateStepSize) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("touch: setting file size of %y failed: %s"), &Update->FilePath, ErrText);
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("touch: updating timestamps of %y failed: %s"), &Update->FilePath, ErrText);
+    }
+    YoriLibFreeWinErrorText(ErrText);
+}
+
+/**
+ A callback that is invoked when a file is found that matches a search criteria
+ specified in the set of strings to enumerate.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.  Note in this application this can
+        be NULL when it is operating on files that do not yet exist.
+
+ @param Depth Specifies the recursion depth.  Ignored in this application.
+
+ @param Context Pointer to the touch context structure indicating the
+        action to perform and populated with the file and line count found.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+TouchFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in_opt PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PTOUCH_CONTEXT TouchContext = (PTOUCH_CONTEXT)Context;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+
+    TouchContext->FilesFoundThisArg++;
+    if (!YoriLibQueueFileUpdate(TouchContext->Engine, FilePath, FileInfo)) {
+        return FALSE;
+    }
+
     return TRUE;
 }
 
@@ -259,7 +325,7 @@ ENTRYPOINT(
                 TouchHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2018-2022"));
+                YoriLibDisplayMitLicense(_T("2018-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("a")) == 0) {
                 UpdateLastAccess = TRUE;
@@ -367,6 +433,21 @@ ENTRYPOINT(
             MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
         }
 
+        //
+        //  Files are updated in parallel, and errors are reported in the
+        //  order that files are found.  A file that does not exist is
+        //  queued without find data, which indicates it should be created.
+        //
+
+        if (!YoriLibCreateFileUpdateEngine(TouchApplyFile, TouchReportFile, &TouchContext, 0, &TouchContext.Engine)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("touch: out of memory\n"));
+            return EXIT_FAILURE;
+        }
+
+#if YORI_BUILTIN
+        YoriLibCancelEnable(FALSE);
+#endif
+
         for (i = StartArg; i < ArgC; i++) {
 
             TouchContext.FilesFoundThisArg = 0;
@@ -380,6 +461,8 @@ ENTRYPOINT(
                 }
             }
         }
+
+        YoriLibDestroyFileUpdateEngine(TouchContext.Engine);
     }
 
     return EXIT_SUCCESS;
@@ -3,7 +3,7 @@
  *
  * Yori shell vhdtool for managing VHD files
  *
- * Copyright (c) 2019 Malcolm J. Smith
+ * Copyright (c) 2019-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -38,7 +38,7 @@ CHAR strVhdToolHelpText[] =
         "VHDTOOL [-license]\n"
         "VHDTOOL [-sector:512|-sector:512e|-sector:4096] -clonedynamic <file> <source>\n"
         "VHDTOOL [-sector:512|-sector:512e|-sector:4096] -clonefixed <file> <source>\n"
-        "VHDTOOL -compact <file>\n"
+        "VHDTOOL -compact <file> [<file>...]\n"
         "VHDTOOL -creatediff <file> <parent>\n"
         "VHDTOOL [-sector:512|-sector:512e|-sector:4096] -createdynamic <file> <size>\n"
         "VHDTOOL [-sector:512|-sector:512e|-sector:4096] -createfixed <file> <size>\n"
@@ -50,8 +50,9 @@ CHAR strVhdToolHelpText[] =
         "                  .vhd or .vhdx file\n"
         "   -clonefixed    Copy an existing disk or VHD into a fixed sized .iso, .vhd\n"
         "                  or .vhdx file\n"
-        "   -compact       Remove unused regions from a dynamically expanding .vhd or\n"
-        "                  .vhdx file\n"
+        "   -compact       Remove unused regions from dynamically expanding .vhd or\n"
+        "                  .vhdx files.  Files on different volumes are compacted\n"
+        "                  concurrently.\n"
         "   -creatediff    Create a differencing .vhd or .vhdx file from a read-only\n"
         "                  parent .vhd or .vhdx file\n"
         "   -createdynamic Create a new dynamically expanding .vhd or .vhdx file.  Size\n"
@@ -99,7 +100,25 @@ typedef enum _VHDTOOL_SECTOR_SIZE {
 } VHDTOOL_SECTOR_SIZE;
 
 /**
- Clone a fixed ISO file.
+ A set of operations supported by this application.
+ */
+typedef enum _VHDTOOL_OP {
+    VhdToolOpNone = 0,
+    VhdToolOpCreateFixedVhd = 1,
+    VhdToolOpCreateDynamicVhd = 2,
+    VhdToolOpExpand = 3,
+    VhdToolOpCompact = 4,
+    VhdToolOpShrink = 5,
+    VhdToolOpCreateDiffVhd = 6,
+    VhdToolOpMerge = 7,
+    VhdToolOpCloneFixed = 8,
+    VhdToolOpCloneDynamic = 9,
+} VHDTOOL_OP;
+
+/**
+ Clone a fixed ISO file.  Data is copied with several reads and writes in
+ flight, and blocks of zeroes are not written, so the resulting file is
+ sparse.
 
  @param Path Pointer to the path of the file to create.
 
@@ -117,14 +136,7 @@ VhdToolCloneIso(
     HANDLE TargetHandle;
     YORI_STRING FullPath;
     YORI_STRING FullSourcePath;
-    PVOID Buffer;
-    YORI_ALLOC_SIZE_T BufferSize;
-    DWORD BytesRead;
-    DWORD SectorsPerCluster;
-    DWORD BytesPerSector;
-    DWORD FreeClusters;
-    DWORD TotalClusters;
-    DISK_GEOMETRY DiskGeometry;
+    YORI_LIB_COPY_DATA_PARAMS Params;
     LPTSTR ErrText;
     DWORD Err;
 
@@ -144,7 +156,7 @@ VhdToolCloneIso(
     //  Open the source.  Note this can be a file or a device.
     //
 
-    SourceHandle = CreateFile(FullSourcePath.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    SourceHandle = CreateFile(FullSourcePath.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
     if (SourceHandle == INVALID_HANDLE_VALUE) {
         Err = GetLastError();
         ErrText = YoriLibGetWinErrorText(Err);
@@ -155,8 +167,8 @@ VhdToolCloneIso(
         return FALSE;
     }
 
-    TargetHandle = CreateFile(FullPath.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (SourceHandle == INVALID_HANDLE_VALUE) {
+    TargetHandle = CreateFile(FullPath.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+    if (TargetHandle == INVALID_HANDLE_VALUE) {
         Err = GetLastError();
         ErrText = YoriLibGetWinErrorText(Err);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of target failed: %y: %s"), &FullPath, ErrText);
@@ -168,56 +180,29 @@ VhdToolCloneIso(
     }
 
     //
-    //  Try to query the sector size of the source, first as a device, and if
-    //  that fails, as a file.
+    //  The copy engine limits the final read of a device to the sectors
+    //  that remain, since devices fail reads beyond their end.
     //
 
-    if (DeviceIoControl(SourceHandle, IOCTL_DISK_GET_DRIVE_GEOMETRY, NULL, 0, &DiskGeometry, sizeof(DiskGeometry), &BytesRead, NULL)) {
-        BytesPerSector = DiskGeometry.BytesPerSector;
-    } else if (!GetDiskFreeSpace(FullSourcePath.StartOfString, &SectorsPerCluster, &BytesPerSector, &FreeClusters, &TotalClusters)) {
-        BytesPerSector = 4096;
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("BytesPerSector could not be detected, using default %i\n"), BytesPerSector);
-    }
+    ZeroMemory(&Params, sizeof(Params));
+    Params.SkipZeroBlocks = TRUE;
+    Err = YoriLibCopyFileData(SourceHandle, TargetHandle, &Params);
 
-    BufferSize = YoriLibMaximumAllocationInRange(32 * 1024, 1024 * 1024);
-    Buffer = YoriLibMalloc(BufferSize);
-    if (Buffer == NULL) {
+    CloseHandle(SourceHandle);
+    CloseHandle(TargetHandle);
+
+    if (Err != ERROR_SUCCESS) {
+        ErrText = YoriLibGetWinErrorText(Err);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Copy of data failed: %y: %s"), &FullSourcePath, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        DeleteFile(FullPath.StartOfString);
         YoriLibFreeStringContents(&FullPath);
         YoriLibFreeStringContents(&FullSourcePath);
-        CloseHandle(SourceHandle);
-        CloseHandle(TargetHandle);
         return FALSE;
     }
 
-    //
-    //  Copy data.  Devices appear to fail outright if the end of the device
-    //  is reached, so the final portion is read one sector at a time.
-    //
-
-    while(TRUE) {
-        if (!ReadFile(SourceHandle, Buffer, BufferSize, &BytesRead, NULL)) {
-            Err = GetLastError();
-            if (Err == ERROR_INVALID_FUNCTION) {
-                if (BufferSize != BytesPerSector) {
-                    BufferSize = (YORI_ALLOC_SIZE_T)BytesPerSector;
-                    continue;
-                }
-            }
-            break;
-        }
-
-        if (BytesRead == 0) {
-            break;
-        }
-
-        WriteFile(TargetHandle, Buffer, BytesRead, &BytesRead, NULL);
-    }
-
-    YoriLibFree(Buffer);
     YoriLibFreeStringContents(&FullPath);
     YoriLibFreeStringContents(&FullSourcePath);
-    CloseHandle(SourceHandle);
-    CloseHandle(TargetHandle);
     return TRUE;
 }
 
@@ -628,49 +613,161 @@ VhdToolCreateDiffVhdx(
 }
 
 /**
- Expand a VHD to a larger size.
+ The interval in milliseconds between updates of the progress display.
+ */
+#define VHDTOOL_PROGRESS_INTERVAL (500)
 
- @param Path Pointer to the path of the file to expand.
+/**
+ The maximum number of operations that can be outstanding at once.  One
+ wait slot is reserved for the cancel event.
+ */
+#define VHDTOOL_MAX_OUTSTANDING (MAXIMUM_WAIT_OBJECTS - 1)
 
- @param SizeAsString Pointer to a string form of the size of the file to
-        expand to.
+/**
+ State describing a single virtual disk operation which is performed
+ asynchronously.
+ */
+typedef struct _VHDTOOL_OPERATION {
+
+    /**
+     The operation to perform.  This is either VhdToolOpCompact or
+     VhdToolOpExpand.
+     */
+    VHDTOOL_OP Op;
+
+    /**
+     The full path to the virtual disk.
+     */
+    YORI_STRING FullPath;
+
+    /**
+     The volume containing the virtual disk.  Only one operation is
+     performed on each volume at a time, because concurrent operations on
+     the same storage compete with each other rather than completing
+     sooner.  This can be empty if the volume could not be determined, in
+     which case the operation is not serialized against any other.
+     */
+    YORI_STRING VolumeName;
+
+    /**
+     A handle to the opened virtual disk.
+     */
+    HANDLE Handle;
+
+    /**
+     The overlapped structure describing the operation.  Its event is
+     signalled when the operation completes.
+     */
+    OVERLAPPED Overlapped;
+
+    /**
+     Parameters for a compact operation.  These are retained for the
+     duration of the operation.
+     */
+    COMPACT_VIRTUAL_DISK_PARAMETERS CompactParams;
+
+    /**
+     Parameters for an expand operation.  These are retained for the
+     duration of the operation.
+     */
+    EXPAND_VIRTUAL_DISK_PARAMETERS ExpandParams;
+
+    /**
+     The amount of work completed, in units of CompletionValue.
+     */
+    ULONGLONG CurrentValue;
+
+    /**
+     The amount of work in the operation, or zero if not yet known.
+     */
+    ULONGLONG CompletionValue;
+
+    /**
+     The final status of the operation, once it is complete.
+     */
+    DWORD Result;
+
+    /**
+     TRUE once the operation has been issued.
+     */
+    BOOLEAN Started;
+
+    /**
+     TRUE once the operation has finished, successfully or otherwise.
+     */
+    BOOLEAN Complete;
+
+    /**
+     TRUE once the result of the operation has been reported.
+     */
+    BOOLEAN Reported;
+} VHDTOOL_OPERATION, *PVHDTOOL_OPERATION;
+
+/**
+ Free the resources associated with a virtual disk operation.  The
+ operation must not be outstanding.
+
+ @param Operation Pointer to the operation to clean up.
+ */
+VOID
+VhdToolCleanupOperation(
+    __in PVHDTOOL_OPERATION Operation
+    )
+{
+    ASSERT(!Operation->Started || Operation->Complete);
+
+    if (Operation->Overlapped.hEvent != NULL) {
+        CloseHandle(Operation->Overlapped.hEvent);
+        Operation->Overlapped.hEvent = NULL;
+    }
+    if (Operation->Handle != NULL) {
+        CloseHandle(Operation->Handle);
+        Operation->Handle = NULL;
+    }
+    YoriLibFreeStringContents(&Operation->FullPath);
+    YoriLibFreeStringContents(&Operation->VolumeName);
+}
+
+/**
+ Open a virtual disk in preparation for performing an asynchronous
+ operation on it.
+
+ @param Path Pointer to the user specified path of the virtual disk.
+
+ @param Op The operation that will be performed.
+
+ @param Operation On successful completion, populated with an opened
+        virtual disk that is ready to have the operation started.  The
+        caller should free this with @ref VhdToolCleanupOperation .
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-VhdToolExpand(
+VhdToolOpenOperation(
     __in PYORI_STRING Path,
-    __in PYORI_STRING SizeAsString
+    __in VHDTOOL_OP Op,
+    __out PVHDTOOL_OPERATION Operation
     )
 {
-    LARGE_INTEGER FileSize;
     VIRTUAL_STORAGE_TYPE StorageType;
-    HANDLE Handle;
-    YORI_STRING FullPath;
     OPEN_VIRTUAL_DISK_PARAMETERS OpenParams;
-    EXPAND_VIRTUAL_DISK_PARAMETERS ExpandParams;
     DWORD Err;
-    DWORD AccessRequested;
     LPTSTR ErrText;
 
-    YoriLibLoadVirtDiskFunctions();
-    if (DllVirtDisk.pExpandVirtualDisk == NULL ||
-        DllVirtDisk.pOpenVirtualDisk == NULL) {
+    ZeroMemory(Operation, sizeof(VHDTOOL_OPERATION));
+    Operation->Op = Op;
+    YoriLibInitEmptyString(&Operation->FullPath);
+    YoriLibInitEmptyString(&Operation->VolumeName);
 
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("vhdtool: OS support not present\n"));
+    if (!YoriLibUserStringToSingleFilePath(Path, TRUE, &Operation->FullPath)) {
         return FALSE;
     }
 
-    ZeroMemory(&StorageType, sizeof(StorageType));
-
-    YoriLibInitEmptyString(&FullPath);
-
-    if (!YoriLibUserStringToSingleFilePath(Path, TRUE, &FullPath)) {
-        return FALSE;
+    if (!YoriLibGetVolumePathName(&Operation->FullPath, &Operation->VolumeName)) {
+        YoriLibInitEmptyString(&Operation->VolumeName);
     }
 
-    YoriLibStringToFileSize(SizeAsString, &FileSize);
-
+    ZeroMemory(&StorageType, sizeof(StorageType));
     StorageType.DeviceId = VIRTUAL_STORAGE_TYPE_DEVICE_UNKNOWN;
     StorageType.VendorId = VIRTUAL_STORAGE_TYPE_VENDOR_UNKNOWN;
 
@@ -678,103 +775,413 @@ VhdToolExpand(
     OpenParams.Version = OPEN_VIRTUAL_DISK_VERSION_1;
     OpenParams.Version1.RWDepth = OPEN_VIRTUAL_DISK_RW_DEPTH_DEFAULT;
 
-    AccessRequested = VIRTUAL_DISK_ACCESS_METAOPS;
-
-    Err = DllVirtDisk.pOpenVirtualDisk(&StorageType, FullPath.StartOfString, AccessRequested, OPEN_VIRTUAL_DISK_FLAG_NONE, &OpenParams, &Handle);
+    Err = DllVirtDisk.pOpenVirtualDisk(&StorageType, Operation->FullPath.StartOfString, VIRTUAL_DISK_ACCESS_METAOPS, OPEN_VIRTUAL_DISK_FLAG_NONE, &OpenParams, &Operation->Handle);
     if (Err != ERROR_SUCCESS) {
         ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("vhdtool: open of %y failed: %s"), &FullPath, ErrText);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("vhdtool: open of %y failed: %s"), &Operation->FullPath, ErrText);
         YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&FullPath);
+        Operation->Handle = NULL;
+        VhdToolCleanupOperation(Operation);
         return FALSE;
     }
 
-    ExpandParams.Version = 1;
-    ExpandParams.Version1.NewSizeInBytes = FileSize.QuadPart;
-    Err = DllVirtDisk.pExpandVirtualDisk(Handle, 0, &ExpandParams, NULL);
-    if (Err != ERROR_SUCCESS) {
+    Operation->Overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Operation->Overlapped.hEvent == NULL) {
+        Err = GetLastError();
         ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("vhdtool: expand of %y failed: %s"), &FullPath, ErrText);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("vhdtool: CreateEvent failed: %s"), ErrText);
         YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&FullPath);
-        CloseHandle(Handle);
+        VhdToolCleanupOperation(Operation);
         return FALSE;
     }
 
-    YoriLibFreeStringContents(&FullPath);
-    CloseHandle(Handle);
     return TRUE;
 }
 
 /**
- Compact a dynamic VHD by removing unused space.
+ Issue an asynchronous operation against a virtual disk.  If the operation
+ cannot be started, it is marked complete with the error.
 
- @param Path Pointer to the path of the file to compact.
+ @param Operation Pointer to the operation to start.
+ */
+VOID
+VhdToolStartOperation(
+    __inout PVHDTOOL_OPERATION Operation
+    )
+{
+    DWORD Err;
 
- @return TRUE to indicate success, FALSE to indicate failure.
+    Operation->Started = TRUE;
+
+    if (Operation->Op == VhdToolOpCompact) {
+        Operation->CompactParams.Version = 1;
+        Err = DllVirtDisk.pCompactVirtualDisk(Operation->Handle, 0, &Operation->CompactParams, &Operation->Overlapped);
+    } else {
+        ASSERT(Operation->Op == VhdToolOpExpand);
+        Operation->ExpandParams.Version = 1;
+        Err = DllVirtDisk.pExpandVirtualDisk(Operation->Handle, 0, &Operation->ExpandParams, &Operation->Overlapped);
+    }
+
+    if (Err != ERROR_IO_PENDING) {
+        Operation->Complete = TRUE;
+        Operation->Result = Err;
+    }
+}
+
+/**
+ Query the progress of an outstanding operation, and mark it complete if
+ it has finished.
+
+ @param Operation Pointer to the operation to update.
  */
-BOOL
-VhdToolCompact(
-    __in PYORI_STRING Path
+VOID
+VhdToolUpdateOperation(
+    __inout PVHDTOOL_OPERATION Operation
     )
 {
-    VIRTUAL_STORAGE_TYPE StorageType;
-    HANDLE Handle;
-    YORI_STRING FullPath;
-    OPEN_VIRTUAL_DISK_PARAMETERS OpenParams;
-    COMPACT_VIRTUAL_DISK_PARAMETERS CompactParams;
+    VIRTUAL_DISK_PROGRESS Progress;
+    DWORD BytesTransferred;
     DWORD Err;
-    DWORD AccessRequested;
+
+    ZeroMemory(&Progress, sizeof(Progress));
+    Err = DllVirtDisk.pGetVirtualDiskOperationProgress(Operation->Handle, &Operation->Overlapped, &Progress);
+    if (Err == ERROR_SUCCESS) {
+        if (Progress.OperationStatus == ERROR_IO_PENDING) {
+            Operation->CurrentValue = Progress.CurrentValue;
+            Operation->CompletionValue = Progress.CompletionValue;
+        } else {
+            Operation->Complete = TRUE;
+            Operation->Result = Progress.OperationStatus;
+        }
+        return;
+    }
+
+    //
+    //  If progress can't be queried, the operation is only known to be
+    //  complete once its event is signalled.
+    //
+
+    if (WaitForSingleObject(Operation->Overlapped.hEvent, 0) == WAIT_OBJECT_0) {
+        Operation->Complete = TRUE;
+        Operation->Result = ERROR_SUCCESS;
+        if (!GetOverlappedResult(Operation->Handle, &Operation->Overlapped, &BytesTransferred, FALSE)) {
+            Operation->Result = GetLastError();
+        }
+    }
+}
+
+/**
+ Determine whether an operation is already outstanding on the volume that
+ contains a specified virtual disk.
+
+ @param Operations Pointer to an array of operations.
+
+ @param OperationCount The number of elements in the Operations array.
+
+ @param Operation Pointer to the operation which is about to be started.
+
+ @return TRUE if another operation is outstanding on the same volume, FALSE
+         if the operation can be started.
+ */
+BOOLEAN
+VhdToolIsVolumeBusy(
+    __in PVHDTOOL_OPERATION Operations,
+    __in DWORD OperationCount,
+    __in PVHDTOOL_OPERATION Operation
+    )
+{
+    DWORD Index;
+
+    if (Operation->VolumeName.LengthInChars == 0) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < OperationCount; Index++) {
+        if (Operations[Index].Started &&
+            !Operations[Index].Complete &&
+            YoriLibCompareStringIns(&Operations[Index].VolumeName, &Operation->VolumeName) == 0) {
+
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Perform a set of virtual disk operations asynchronously.  Operations on
+ different volumes execute concurrently.  While operations are outstanding,
+ progress is displayed if standard error is a console, and the operations
+ are cancelled if the user presses Ctrl+C.
+
+ @param Operations Pointer to an array of opened operations.  Elements which
+        have already been marked complete are not started.
+
+ @param OperationCount The number of elements in the Operations array.
+
+ @return TRUE if all operations completed successfully, FALSE if any failed
+         or were cancelled.
+ */
+BOOL
+VhdToolRunOperations(
+    __in PVHDTOOL_OPERATION Operations,
+    __in DWORD OperationCount
+    )
+{
+    HANDLE WaitHandles[MAXIMUM_WAIT_OBJECTS];
+    HANDLE CancelEvent;
+    PVHDTOOL_OPERATION Operation;
+    DWORD Index;
+    DWORD Outstanding;
+    DWORD Completed;
+    DWORD WaitCount;
+    DWORD WaitResult;
+    DWORD ConsoleMode;
+    DWORDLONG PercentTotal;
     LPTSTR ErrText;
+    LPCTSTR Verb;
+    BOOLEAN ShowProgress;
+    BOOLEAN ProgressDisplayed;
+    BOOLEAN Cancelled;
+    BOOL Success;
+
+    ShowProgress = FALSE;
+    if (GetConsoleMode(GetStdHandle(STD_ERROR_HANDLE), &ConsoleMode)) {
+        ShowProgress = TRUE;
+    }
+
+    CancelEvent = YoriLibCancelGetEvent();
+    ProgressDisplayed = FALSE;
+    Cancelled = FALSE;
+    Success = TRUE;
+
+    while (TRUE) {
+
+        //
+        //  Check on any operations in flight, then start new ones on
+        //  volumes that are now idle.
+        //
+
+        Outstanding = 0;
+        for (Index = 0; Index < OperationCount; Index++) {
+            Operation = &Operations[Index];
+            if (Operation->Started && !Operation->Complete) {
+                VhdToolUpdateOperation(Operation);
+                if (!Operation->Complete) {
+                    Outstanding++;
+                }
+            }
+        }
+
+        if (!Cancelled) {
+            for (Index = 0; Index < OperationCount && Outstanding < VHDTOOL_MAX_OUTSTANDING; Index++) {
+                Operation = &Operations[Index];
+                if (!Operation->Started &&
+                    !Operation->Complete &&
+                    !VhdToolIsVolumeBusy(Operations, OperationCount, Operation)) {
+
+                    VhdToolStartOperation(Operation);
+                    if (!Operation->Complete) {
+                        Outstanding++;
+                    }
+                }
+            }
+        }
 
+        //
+        //  Report anything that has finished, and calculate the overall
+        //  progress.
+        //
+
+        Completed = 0;
+        PercentTotal = 0;
+        WaitCount = 0;
+        for (Index = 0; Index < OperationCount; Index++) {
+            Operation = &Operations[Index];
+            if (Operation->Complete) {
+                Completed++;
+                PercentTotal += 100;
+                if (!Operation->Reported) {
+                    Operation->Reported = TRUE;
+                    if (Operation->Result != ERROR_SUCCESS) {
+                        Success = FALSE;
+                        if (ProgressDisplayed) {
+                            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("\n"));
+                            ProgressDisplayed = FALSE;
+                        }
+                        Verb = _T("compact");
+                        if (Operation->Op == VhdToolOpExpand) {
+                            Verb = _T("expand");
+                        }
+                        ErrText = YoriLibGetWinErrorText(Operation->Result);
+                        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("vhdtool: %s of %y failed: %s"), Verb, &Operation->FullPath, ErrText);
+                        YoriLibFreeWinErrorText(ErrText);
+                    }
+                }
+            } else if (Operation->Started) {
+                if (Operation->CompletionValue != 0) {
+                    PercentTotal += Operation->CurrentValue * 100 / Operation->CompletionValue;
+                }
+                WaitHandles[WaitCount] = Operation->Overlapped.hEvent;
+                WaitCount++;
+            }
+        }
+
+        if (Outstanding == 0) {
+            break;
+        }
+
+        if (ShowProgress) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("\r%i of %i complete, %i%% "), Completed, OperationCount, (DWORD)(PercentTotal / OperationCount));
+            ProgressDisplayed = TRUE;
+        }
+
+        if (!Cancelled && CancelEvent != NULL) {
+            WaitHandles[WaitCount] = CancelEvent;
+            WaitCount++;
+        }
+
+        WaitResult = WaitForMultipleObjects(WaitCount, WaitHandles, FALSE, VHDTOOL_PROGRESS_INTERVAL);
+        if (!Cancelled &&
+            CancelEvent != NULL &&
+            WaitResult == WAIT_OBJECT_0 + WaitCount - 1) {
+
+            //
+            //  The operations were issued from this thread, so CancelIo can
+            //  cancel them.  Anything not yet started is skipped, and the
+            //  loop continues until the cancelled operations complete.
+            //
+
+            Cancelled = TRUE;
+            Success = FALSE;
+            for (Index = 0; Index < OperationCount; Index++) {
+                Operation = &Operations[Index];
+                if (Operation->Started && !Operation->Complete) {
+                    CancelIo(Operation->Handle);
+                }
+            }
+        }
+    }
+
+    if (ProgressDisplayed) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("\r%i of %i complete, %i%% \n"), Completed, OperationCount, (DWORD)(PercentTotal / OperationCount));
+    }
+
+    return Success;
+}
+
+/**
+ Check that the OS supports asynchronous virtual disk operations.
+
+ @return TRUE if support is present, FALSE if it is not.  On failure, an
+         error has been displayed.
+ */
+BOOL
+VhdToolCheckOperationSupport(VOID)
+{
     YoriLibLoadVirtDiskFunctions();
     if (DllVirtDisk.pCompactVirtualDisk == NULL ||
+        DllVirtDisk.pExpandVirtualDisk == NULL ||
+        DllVirtDisk.pGetVirtualDiskOperationProgress == NULL ||
         DllVirtDisk.pOpenVirtualDisk == NULL) {
 
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("vhdtool: OS support not present\n"));
         return FALSE;
     }
 
-    ZeroMemory(&StorageType, sizeof(StorageType));
+    return TRUE;
+}
 
-    YoriLibInitEmptyString(&FullPath);
+/**
+ Expand a VHD to a larger size.
 
-    if (!YoriLibUserStringToSingleFilePath(Path, TRUE, &FullPath)) {
+ @param Path Pointer to the path of the file to expand.
+
+ @param SizeAsString Pointer to a string form of the size of the file to
+        expand to.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+VhdToolExpand(
+    __in PYORI_STRING Path,
+    __in PYORI_STRING SizeAsString
+    )
+{
+    LARGE_INTEGER FileSize;
+    VHDTOOL_OPERATION Operation;
+    BOOL Result;
+
+    if (!VhdToolCheckOperationSupport()) {
         return FALSE;
     }
 
-    StorageType.DeviceId = VIRTUAL_STORAGE_TYPE_DEVICE_UNKNOWN;
-    StorageType.VendorId = VIRTUAL_STORAGE_TYPE_VENDOR_UNKNOWN;
+    YoriLibStringToFileSize(SizeAsString, &FileSize);
 
-    ZeroMemory(&OpenParams, sizeof(OpenParams));
-    OpenParams.Version = OPEN_VIRTUAL_DISK_VERSION_1;
-    OpenParams.Version1.RWDepth = OPEN_VIRTUAL_DISK_RW_DEPTH_DEFAULT;
+    if (!VhdToolOpenOperation(Path, VhdToolOpExpand, &Operation)) {
+        return FALSE;
+    }
 
-    AccessRequested = VIRTUAL_DISK_ACCESS_METAOPS;
+    Operation.ExpandParams.Version1.NewSizeInBytes = FileSize.QuadPart;
+    Result = VhdToolRunOperations(&Operation, 1);
+    VhdToolCleanupOperation(&Operation);
+    return Result;
+}
 
-    Err = DllVirtDisk.pOpenVirtualDisk(&StorageType, FullPath.StartOfString, AccessRequested, OPEN_VIRTUAL_DISK_FLAG_NONE, &OpenParams, &Handle);
-    if (Err != ERROR_SUCCESS) {
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("vhdtool: open of %y failed: %s"), &FullPath, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&FullPath);
+/**
+ Compact a set of dynamic VHDs by removing unused space.  Files on different
+ volumes are compacted concurrently.
+
+ @param Paths Pointer to an array of paths of files to compact.
+
+ @param PathCount The number of elements in the Paths array.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+VhdToolCompact(
+    __in PYORI_STRING Paths,
+    __in DWORD PathCount
+    )
+{
+    PVHDTOOL_OPERATION Operations;
+    DWORD Index;
+    BOOL Result;
+
+    if (!VhdToolCheckOperationSupport()) {
         return FALSE;
     }
 
-    CompactParams.Version = 1;
-    Err = DllVirtDisk.pCompactVirtualDisk(Handle, 0, &CompactParams, NULL);
-    if (Err != ERROR_SUCCESS) {
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("vhdtool: compact of %y failed: %s"), &FullPath, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&FullPath);
-        CloseHandle(Handle);
+    Operations = YoriLibMalloc(PathCount * sizeof(VHDTOOL_OPERATION));
+    if (Operations == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("vhdtool: out of memory\n"));
         return FALSE;
     }
 
-    YoriLibFreeStringContents(&FullPath);
-    CloseHandle(Handle);
-    return TRUE;
+    //
+    //  A file that can't be opened has already reported an error.  Mark it
+    //  complete so the remaining files are still compacted.
+    //
+
+    Result = TRUE;
+    for (Index = 0; Index < PathCount; Index++) {
+        if (!VhdToolOpenOperation(&Paths[Index], VhdToolOpCompact, &Operations[Index])) {
+            Operations[Index].Complete = TRUE;
+            Operations[Index].Reported = TRUE;
+            Result = FALSE;
+        }
+    }
+
+    if (!VhdToolRunOperations(Operations, PathCount)) {
+        Result = FALSE;
+    }
+
+    for (Index = 0; Index < PathCount; Index++) {
+        VhdToolCleanupOperation(&Operations[Index]);
+    }
+
+    YoriLibFree(Operations);
+    return Result;
 }
 
 /**
@@ -938,22 +1345,6 @@ VhdToolMerge(
     return TRUE;
 }
 
-/**
- A set of operations supported by this application.
- */
-typedef enum _VHDTOOL_OP {
-    VhdToolOpNone = 0,
-    VhdToolOpCreateFixedVhd = 1,
-    VhdToolOpCreateDynamicVhd = 2,
-    VhdToolOpExpand = 3,
-    VhdToolOpCompact = 4,
-    VhdToolOpShrink = 5,
-    VhdToolOpCreateDiffVhd = 6,
-    VhdToolOpMerge = 7,
-    VhdToolOpCloneFixed = 8,
-    VhdToolOpCloneDynamic = 9,
-} VHDTOOL_OP;
-
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the vhdtool builtin command.
@@ -984,7 +1375,7 @@ ENTRYPOINT(
 {
     BOOLEAN ArgumentUnderstood;
     YORI_ALLOC_SIZE_T i;
-    YORI_ALLOC_SIZE_T StartArg;
+    YORI_ALLOC_SIZE_T StartArg = 0;
     YORI_STRING Arg;
     PYORI_STRING FileName = NULL;
     PYORI_STRING FileParent = NULL;
@@ -1008,7 +1399,7 @@ ENTRYPOINT(
                 VhdToolHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2019"));
+                YoriLibDisplayMitLicense(_T("2019-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("clonedynamic")) == 0) {
                 if (ArgC > i + 2) {
@@ -1149,10 +1540,26 @@ ENTRYPOINT(
             }
             break;
         case VhdToolOpExpand:
+#if YORI_BUILTIN
+            YoriLibCancelEnable(FALSE);
+#endif
             VhdToolExpand(FileName, FileSize);
             break;
         case VhdToolOpCompact:
-            VhdToolCompact(FileName);
+#if YORI_BUILTIN
+            YoriLibCancelEnable(FALSE);
+#endif
+
+            //
+            //  Any arguments following the first file are additional files
+            //  to compact.
+            //
+
+            if (StartArg > 0) {
+                VhdToolCompact(&ArgV[StartArg], ArgC - StartArg);
+            } else {
+                VhdToolCompact(FileName, 1);
+            }
             break;
         case VhdToolOpShrink:
             VhdToolShrink(FileName, FileSize, ExtType);
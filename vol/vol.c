@@ -3,7 +3,7 @@
  *
  * Yori shell display volume properties
  *
- * Copyright (c) 2017-2024 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -35,7 +35,9 @@ CHAR strVolHelpText[] =
         "\n"
         "Outputs volume information in a specified format.\n"
         "\n"
-        "VOL [-license] [-f <fmt>] [<vol>]\n"
+        "VOL [-license] [-f <fmt>] [-t <seconds>] [<vol>]\n"
+        "\n"
+        "   -t             Seconds to wait for the volume to respond, 0 to wait forever\n"
         "\n"
         "Format specifiers are:\n"
         "   $clustersize$        The size of each cluster in bytes\n"
@@ -63,6 +65,17 @@ CHAR strVolHelpText[] =
         "   $usnmaxallocated$    The maximum size of the journal in bytes\n"
         ;
 
+/**
+ The default number of seconds to wait for a volume to respond.
+ */
+#define VOL_DEFAULT_TIMEOUT (10)
+
+/**
+ The number of characters allocated for the volume label and file system
+ name.
+ */
+#define VOL_MAX_NAME_LENGTH (256)
+
 /**
  Display usage text to the user.
  */
@@ -229,6 +242,12 @@ typedef struct _VOL_RESULT {
      */
     YORI_VOLUME_DISK_EXTENTS VolumeDiskExtents;
 
+    /**
+     The root of the volume to query.  This is allocated along with this
+     structure.
+     */
+    YORI_STRING VolRootName;
+
 } VOL_RESULT, *PVOL_RESULT;
 
 /**
@@ -432,6 +451,221 @@ VolExpandVariables(
     return CharsNeeded;
 }
 
+/**
+ Query information about a volume.
+
+ @param VolResult Pointer to the structure to populate with information
+        about the volume.  The VolRootName member specifies the volume to
+        query, which should include a trailing backslash.
+ */
+VOID
+VolQueryVolume(
+    __inout PVOL_RESULT VolResult
+    )
+{
+    DWORD SectorsPerCluster;
+    DWORD NumberOfFreeClusters;
+    DWORD TotalNumberOfClusters;
+    HANDLE hDir;
+
+    if (GetVolumeInformation(VolResult->VolRootName.StartOfString,
+                             VolResult->VolumeLabel.StartOfString,
+                             VolResult->VolumeLabel.LengthAllocated,
+                             &VolResult->ShortSerialNumber,
+                             &VolResult->MaxComponentLength,
+                             &VolResult->Capabilities,
+                             VolResult->FsName.StartOfString,
+                             VolResult->FsName.LengthAllocated)) {
+
+        VolResult->Have.GetVolInfo = TRUE;
+
+        VolResult->VolumeLabel.LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(VolResult->VolumeLabel.StartOfString);
+        VolResult->FsName.LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(VolResult->FsName.StartOfString);
+    }
+
+    //
+    //  Get the total and free space using the best available API.
+    //
+
+    if (YoriLibGetDiskFreeSpace(VolResult->VolRootName.StartOfString,
+                                NULL,
+                                &VolResult->VolumeSize,
+                                &VolResult->FreeSpace)) {
+
+        VolResult->Have.FreeSpace = TRUE;
+    }
+
+    //
+    //  Get the sector size and calculate the cluster size.
+    //
+
+    if (GetDiskFreeSpace(VolResult->VolRootName.StartOfString,
+                         &SectorsPerCluster,
+                         &VolResult->SectorSize,
+                         &NumberOfFreeClusters,
+                         &TotalNumberOfClusters)) {
+
+        VolResult->Have.SectorSize = TRUE;
+        VolResult->ClusterSize = VolResult->SectorSize * SectorsPerCluster;
+    }
+
+    VolResult->PhysicalSectorSize = VolResult->SectorSize;
+
+    //
+    //  Truncate the trailing backslash so as to open the volume instead of
+    //  root directory
+    //
+
+    if (VolResult->VolRootName.LengthInChars > 0 &&
+        VolResult->VolRootName.StartOfString[VolResult->VolRootName.LengthInChars - 1] == '\\') {
+
+        VolResult->VolRootName.LengthInChars--;
+        VolResult->VolRootName.StartOfString[VolResult->VolRootName.LengthInChars] = '\0';
+    }
+
+    //
+    //  This needs to be more than FILE_READ_ATTRIBUTES to get a file system
+    //  handle, but not require any form of write access or read data access,
+    //  or else it needs an administrative caller.
+    //
+
+    hDir = CreateFile(VolResult->VolRootName.StartOfString,
+                      FILE_READ_ATTRIBUTES | FILE_TRAVERSE,
+                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                      NULL,
+                      OPEN_EXISTING,
+                      FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_OPEN_NO_RECALL,
+                      NULL);
+    if (hDir != INVALID_HANDLE_VALUE) {
+        FILE_STORAGE_INFO StorageInfo;
+        USN_JOURNAL_DATA UsnData;
+        DWORD BytesReturned;
+
+        if (DllKernel32.pGetFileInformationByHandleEx) {
+            if (DllKernel32.pGetFileInformationByHandleEx(hDir, FileStorageInfo, &StorageInfo, sizeof(StorageInfo))) {
+                VolResult->Have.PhysicalSectorSize = TRUE;
+                VolResult->PhysicalSectorSize = StorageInfo.FileSystemEffectivePhysicalBytesPerSectorForAtomicity;
+            }
+        }
+
+        //
+        //  This needs admin for no good reason
+        //
+
+        if (DeviceIoControl(hDir,
+                            FSCTL_QUERY_USN_JOURNAL,
+                            NULL,
+                            0,
+                            &UsnData,
+                            sizeof(UsnData),
+                            &BytesReturned,
+                            NULL)) {
+
+            VolResult->Have.Usn = TRUE;
+            VolResult->UsnJournalId = UsnData.UsnJournalID;
+            VolResult->UsnFirst = UsnData.FirstUsn;
+            VolResult->UsnNext = UsnData.NextUsn;
+            VolResult->UsnLowestValid = UsnData.LowestValidUsn;
+            VolResult->UsnMax = UsnData.MaxUsn;
+            VolResult->UsnMaxAllocated = UsnData.MaximumSize;
+        }
+
+        if (DeviceIoControl(hDir,
+                            FSCTL_GET_NTFS_VOLUME_DATA,
+                            NULL,
+                            0,
+                            &VolResult->NtfsData,
+                            sizeof(VolResult->NtfsData),
+                            &BytesReturned,
+                            NULL)) {
+
+            VolResult->Have.NtfsData = TRUE;
+
+            VolResult->FullSerialNumber = VolResult->NtfsData.VolumeSerialNumber.QuadPart;
+            VolResult->Have.FullSerial = TRUE;
+            VolResult->ReservedSize = VolResult->NtfsData.TotalReserved.QuadPart * VolResult->NtfsData.BytesPerCluster;
+            VolResult->Have.Reserved = TRUE;
+        }
+
+        if (DeviceIoControl(hDir,
+                            FSCTL_GET_REFS_VOLUME_DATA,
+                            NULL,
+                            0,
+                            &VolResult->RefsData,
+                            sizeof(VolResult->RefsData),
+                            &BytesReturned,
+                            NULL)) {
+
+            VolResult->Have.RefsData = TRUE;
+
+            VolResult->FullSerialNumber = VolResult->RefsData.VolumeSerialNumber.QuadPart;
+            VolResult->Have.FullSerial = TRUE;
+            VolResult->ReservedSize = VolResult->RefsData.TotalReserved.QuadPart * VolResult->RefsData.BytesPerCluster;
+            VolResult->Have.Reserved = TRUE;
+            VolResult->PhysicalSectorSize = VolResult->RefsData.BytesPerPhysicalSector;
+            VolResult->Have.PhysicalSectorSize = TRUE;
+        }
+
+        //
+        //  NTFS will not answer this unless the user is elevated.  exFAT,
+        //  which is what this is really for, will answer it regardless.
+        //
+
+        if (DeviceIoControl(hDir,
+                            FSCTL_GET_RETRIEVAL_POINTER_BASE,
+                            NULL,
+                            0,
+                            &VolResult->RetrievalPointerBase,
+                            sizeof(VolResult->RetrievalPointerBase),
+                            &BytesReturned,
+                            NULL)) {
+
+            if (VolResult->Have.SectorSize) {
+                VolResult->RetrievalPointerBase = VolResult->RetrievalPointerBase * VolResult->SectorSize;
+                VolResult->Have.RetrievalPointerBase = TRUE;
+            }
+        }
+
+        if (DeviceIoControl(hDir,
+                            IOCTL_VOLUME_GET_VOLUME_DISK_EXTENTS,
+                            NULL,
+                            0,
+                            &VolResult->VolumeDiskExtents,
+                            sizeof(VolResult->VolumeDiskExtents),
+                            &BytesReturned,
+                            NULL)) {
+
+            if (VolResult->VolumeDiskExtents.NumberOfDiskExtents == 1) {
+                VolResult->Have.VolumeDiskExtents = TRUE;
+            }
+        }
+
+        CloseHandle(hDir);
+    }
+}
+
+/**
+ A worker thread which queries information about a volume.  This allows
+ the main thread to stop waiting for a volume which does not respond.
+
+ @param Context Pointer to the VOL_RESULT structure to populate.  The worker
+        holds a reference on this which it releases on completion.
+
+ @return Zero.
+ */
+DWORD WINAPI
+VolQueryVolumeThread(
+    __in LPVOID Context
+    )
+{
+    PVOL_RESULT VolResult;
+
+    VolResult = (PVOL_RESULT)Context;
+    VolQueryVolume(VolResult);
+    YoriLibDereference(VolResult);
+    return 0;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the vol builtin command.
@@ -460,21 +694,24 @@ ENTRYPOINT(
     __in YORI_STRING ArgV[]
     )
 {
-    VOL_RESULT VolResult;
+    PVOL_RESULT VolResult;
     BOOLEAN ArgumentUnderstood;
     YORI_STRING DisplayString;
     YORI_STRING YsFormatString;
     YORI_ALLOC_SIZE_T StartArg = 0;
     YORI_ALLOC_SIZE_T i;
-    DWORD SectorsPerCluster;
-    DWORD NumberOfFreeClusters;
-    DWORD TotalNumberOfClusters;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    YORI_MAX_SIGNED_T llTemp;
     YORI_STRING Arg;
     YORI_STRING FullPathName;
     YORI_STRING VolRootName;
-    HANDLE hDir;
+    HANDLE hThread;
+    DWORD ThreadId;
+    DWORD Timeout;
+    DWORD WaitResult;
 
     YoriLibInitEmptyString(&YsFormatString);
+    Timeout = VOL_DEFAULT_TIMEOUT * 1000;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -487,7 +724,7 @@ ENTRYPOINT(
                 VolHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2017-2024"));
+                YoriLibDisplayMitLicense(_T("2017-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("f")) == 0) {
                 if (ArgC > i + 1) {
@@ -497,6 +734,20 @@ ENTRYPOINT(
                     ArgumentUnderstood = TRUE;
                     i++;
                 }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("t")) == 0) {
+                if (ArgC > i + 1 &&
+                    YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                    CharsConsumed > 0 &&
+                    llTemp >= 0 &&
+                    llTemp < 0x100000) {
+
+                    Timeout = (DWORD)llTemp * 1000;
+                    if (Timeout == 0) {
+                        Timeout = INFINITE;
+                    }
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
             }
         } else {
             ArgumentUnderstood = TRUE;
@@ -515,21 +766,8 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
-    ZeroMemory(&VolResult, sizeof(VolResult));
-
-    if (!YoriLibAllocateString(&VolResult.VolumeLabel, 256)) {
-        return FALSE;
-    }
-
-    if (!YoriLibAllocateString(&VolResult.FsName, 256)) {
-        YoriLibFreeStringContents(&VolResult.VolumeLabel);
-        return FALSE;
-    }
-
     if (!YoriLibUserStringToSingleFilePath(&ArgV[StartArg], TRUE, &FullPathName)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("vol: failed to resolve %y\n"), &ArgV[StartArg]);
-        YoriLibFreeStringContents(&VolResult.VolumeLabel);
-        YoriLibFreeStringContents(&VolResult.FsName);
         return EXIT_FAILURE;
     }
 
@@ -542,16 +780,12 @@ ENTRYPOINT(
     //
 
     if (!YoriLibAllocateString(&VolRootName, FullPathName.LengthInChars + 2)) {
-        YoriLibFreeStringContents(&VolResult.VolumeLabel);
-        YoriLibFreeStringContents(&VolResult.FsName);
         YoriLibFreeStringContents(&FullPathName);
         return EXIT_FAILURE;
     }
 
     if (!YoriLibGetVolumePathName(&FullPathName, &VolRootName)) {
         YoriLibFreeStringContents(&VolRootName);
-        YoriLibFreeStringContents(&VolResult.VolumeLabel);
-        YoriLibFreeStringContents(&VolResult.FsName);
         YoriLibFreeStringContents(&FullPathName);
         return EXIT_FAILURE;
     }
@@ -570,179 +804,54 @@ ENTRYPOINT(
         VolRootName.LengthInChars++;
     }
 
-    if (GetVolumeInformation(VolRootName.StartOfString,
-                             VolResult.VolumeLabel.StartOfString,
-                             VolResult.VolumeLabel.LengthAllocated,
-                             &VolResult.ShortSerialNumber,
-                             &VolResult.MaxComponentLength,
-                             &VolResult.Capabilities,
-                             VolResult.FsName.StartOfString,
-                             VolResult.FsName.LengthAllocated)) {
-
-        VolResult.Have.GetVolInfo = TRUE;
-
-        VolResult.VolumeLabel.LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(VolResult.VolumeLabel.StartOfString);
-        VolResult.FsName.LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(VolResult.FsName.StartOfString);
-    }
-
-    //
-    //  Get the total and free space using the best available API.
-    //
-
-    if (YoriLibGetDiskFreeSpace(VolRootName.StartOfString,
-                                NULL,
-                                &VolResult.VolumeSize,
-                                &VolResult.FreeSpace)) {
-
-        VolResult.Have.FreeSpace = TRUE;
-    }
-
     //
-    //  Get the sector size and calculate the cluster size.
+    //  Allocate the result along with buffers for the strings it contains,
+    //  so that a worker which does not complete in time can continue to
+    //  use it after this command returns.
     //
 
-    if (GetDiskFreeSpace(VolRootName.StartOfString,
-                         &SectorsPerCluster,
-                         &VolResult.SectorSize,
-                         &NumberOfFreeClusters,
-                         &TotalNumberOfClusters)) {
-
-        VolResult.Have.SectorSize = TRUE;
-        VolResult.ClusterSize = VolResult.SectorSize * SectorsPerCluster;
+    VolResult = YoriLibReferencedMalloc(sizeof(VOL_RESULT) + (VOL_MAX_NAME_LENGTH * 2 + VolRootName.LengthInChars + 1) * sizeof(TCHAR));
+    if (VolResult == NULL) {
+        YoriLibFreeStringContents(&VolRootName);
+        YoriLibFreeStringContents(&FullPathName);
+        return EXIT_FAILURE;
     }
 
-    VolResult.PhysicalSectorSize = VolResult.SectorSize;
-
-    //
-    //  Truncate the trailing backslash so as to open the volume instead of
-    //  root directory
-    //
-
-    if (VolRootName.LengthInChars > 0 &&
-        VolRootName.StartOfString[VolRootName.LengthInChars - 1] == '\\') {
-
-        VolRootName.LengthInChars--;
-        VolRootName.StartOfString[VolRootName.LengthInChars] = '\0';
-    }
+    ZeroMemory(VolResult, sizeof(VOL_RESULT));
+    YoriLibInitEmptyString(&VolResult->VolumeLabel);
+    VolResult->VolumeLabel.StartOfString = (LPTSTR)(VolResult + 1);
+    VolResult->VolumeLabel.LengthAllocated = VOL_MAX_NAME_LENGTH;
+    YoriLibInitEmptyString(&VolResult->FsName);
+    VolResult->FsName.StartOfString = VolResult->VolumeLabel.StartOfString + VOL_MAX_NAME_LENGTH;
+    VolResult->FsName.LengthAllocated = VOL_MAX_NAME_LENGTH;
+    YoriLibInitEmptyString(&VolResult->VolRootName);
+    VolResult->VolRootName.StartOfString = VolResult->FsName.StartOfString + VOL_MAX_NAME_LENGTH;
+    VolResult->VolRootName.LengthAllocated = VolRootName.LengthInChars + 1;
+    VolResult->VolRootName.LengthInChars = VolRootName.LengthInChars;
+    memcpy(VolResult->VolRootName.StartOfString, VolRootName.StartOfString, VolRootName.LengthInChars * sizeof(TCHAR));
+    VolResult->VolRootName.StartOfString[VolRootName.LengthInChars] = '\0';
 
     //
-    //  This needs to be more than FILE_READ_ATTRIBUTES to get a file system
-    //  handle, but not require any form of write access or read data access,
-    //  or else it needs an administrative caller.
+    //  Query the volume on a worker thread so that a volume which does not
+    //  respond, such as a disconnected network drive, cannot stall the
+    //  caller indefinitely.
     //
 
-    hDir = CreateFile(VolRootName.StartOfString,
-                      FILE_READ_ATTRIBUTES | FILE_TRAVERSE,
-                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
-                      NULL,
-                      OPEN_EXISTING,
-                      FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_OPEN_NO_RECALL,
-                      NULL);
-    if (hDir != INVALID_HANDLE_VALUE) {
-        FILE_STORAGE_INFO StorageInfo;
-        USN_JOURNAL_DATA UsnData;
-        DWORD BytesReturned;
-
-        if (DllKernel32.pGetFileInformationByHandleEx) {
-            if (DllKernel32.pGetFileInformationByHandleEx(hDir, FileStorageInfo, &StorageInfo, sizeof(StorageInfo))) {
-                VolResult.Have.PhysicalSectorSize = TRUE;
-                VolResult.PhysicalSectorSize = StorageInfo.FileSystemEffectivePhysicalBytesPerSectorForAtomicity;
-            }
-        }
-
-        //
-        //  This needs admin for no good reason
-        //
-
-        if (DeviceIoControl(hDir,
-                            FSCTL_QUERY_USN_JOURNAL,
-                            NULL,
-                            0,
-                            &UsnData,
-                            sizeof(UsnData),
-                            &BytesReturned,
-                            NULL)) {
-
-            VolResult.Have.Usn = TRUE;
-            VolResult.UsnJournalId = UsnData.UsnJournalID;
-            VolResult.UsnFirst = UsnData.FirstUsn;
-            VolResult.UsnNext = UsnData.NextUsn;
-            VolResult.UsnLowestValid = UsnData.LowestValidUsn;
-            VolResult.UsnMax = UsnData.MaxUsn;
-            VolResult.UsnMaxAllocated = UsnData.MaximumSize;
-        }
-
-        if (DeviceIoControl(hDir,
-                            FSCTL_GET_NTFS_VOLUME_DATA,
-                            NULL,
-                            0,
-                            &VolResult.NtfsData,
-                            sizeof(VolResult.NtfsData),
-                            &BytesReturned,
-                            NULL)) {
-
-            VolResult.Have.NtfsData = TRUE;
-
-            VolResult.FullSerialNumber = VolResult.NtfsData.VolumeSerialNumber.QuadPart;
-            VolResult.Have.FullSerial = TRUE;
-            VolResult.ReservedSize = VolResult.NtfsData.TotalReserved.QuadPart * VolResult.NtfsData.BytesPerCluster;
-            VolResult.Have.Reserved = TRUE;
-        }
-
-        if (DeviceIoControl(hDir,
-                            FSCTL_GET_REFS_VOLUME_DATA,
-                            NULL,
-                            0,
-                            &VolResult.RefsData,
-                            sizeof(VolResult.RefsData),
-                            &BytesReturned,
-                            NULL)) {
-
-            VolResult.Have.RefsData = TRUE;
-
-            VolResult.FullSerialNumber = VolResult.RefsData.VolumeSerialNumber.QuadPart;
-            VolResult.Have.FullSerial = TRUE;
-            VolResult.ReservedSize = VolResult.RefsData.TotalReserved.QuadPart * VolResult.RefsData.BytesPerCluster;
-            VolResult.Have.Reserved = TRUE;
-            VolResult.PhysicalSectorSize = VolResult.RefsData.BytesPerPhysicalSector;
-            VolResult.Have.PhysicalSectorSize = TRUE;
-        }
-
-        //
-        //  NTFS will not answer this unless the user is elevated.  exFAT,
-        //  which is what this is really for, will answer it regardless.
-        //
-
-        if (DeviceIoControl(hDir,
-                            FSCTL_GET_RETRIEVAL_POINTER_BASE,
-                            NULL,
-                            0,
-                            &VolResult.RetrievalPointerBase,
-                            sizeof(VolResult.RetrievalPointerBase),
-                            &BytesReturned,
-                            NULL)) {
-
-            if (VolResult.Have.SectorSize) {
-                VolResult.RetrievalPointerBase = VolResult.RetrievalPointerBase * VolResult.SectorSize;
-                VolResult.Have.RetrievalPointerBase = TRUE;
-            }
-        }
-
-        if (DeviceIoControl(hDir,
-                            IOCTL_VOLUME_GET_VOLUME_DISK_EXTENTS,
-                            NULL,
-                            0,
-                            &VolResult.VolumeDiskExtents,
-                            sizeof(VolResult.VolumeDiskExtents),
-                            &BytesReturned,
-                            NULL)) {
-
-            if (VolResult.VolumeDiskExtents.NumberOfDiskExtents == 1) {
-                VolResult.Have.VolumeDiskExtents = TRUE;
-            }
+    YoriLibReference(VolResult);
+    hThread = CreateThread(NULL, 0, VolQueryVolumeThread, VolResult, 0, &ThreadId);
+    if (hThread == NULL) {
+        YoriLibDereference(VolResult);
+        VolQueryVolume(VolResult);
+    } else {
+        WaitResult = WaitForSingleObject(hThread, Timeout);
+        CloseHandle(hThread);
+        if (WaitResult != WAIT_OBJECT_0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("vol: %y unavailable\n"), &VolRootName);
+            YoriLibDereference(VolResult);
+            YoriLibFreeStringContents(&FullPathName);
+            YoriLibFreeStringContents(&VolRootName);
+            return EXIT_FAILURE;
         }
-
-        CloseHandle(hDir);
     }
 
     YoriLibInitEmptyString(&DisplayString);
@@ -753,14 +862,14 @@ ENTRYPOINT(
     //
 
     if (YsFormatString.StartOfString != NULL) {
-        YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, &VolResult, &DisplayString);
+        YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, VolResult, &DisplayString);
         if (DisplayString.StartOfString != NULL) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
             YoriLibFreeStringContents(&DisplayString);
         }
     } else {
 
-        if (VolResult.Have.GetVolInfo) {
+        if (VolResult->Have.GetVolInfo) {
 
             LPTSTR FormatString = 
                           _T("File system:          $fsname$\n")
@@ -768,45 +877,45 @@ ENTRYPOINT(
                           _T("Longest file name:    $maxfilename$\n")
                           _T("Serial number:        $serial$\n");
             YoriLibConstantString(&YsFormatString, FormatString);
-            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, &VolResult, &DisplayString);
+            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, VolResult, &DisplayString);
             if (DisplayString.StartOfString != NULL) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
             }
         }
 
-        if (VolResult.Have.FreeSpace) {
+        if (VolResult->Have.FreeSpace) {
             LPTSTR FormatString = 
                           _T("Free space (bytes):   $free$\n")
                           _T("Size (bytes):         $size$\n");
             YoriLibConstantString(&YsFormatString, FormatString);
-            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, &VolResult, &DisplayString);
+            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, VolResult, &DisplayString);
             if (DisplayString.StartOfString != NULL) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
             }
         }
 
-        if (VolResult.Have.SectorSize) {
+        if (VolResult->Have.SectorSize) {
             LPTSTR FormatString = 
                           _T("Cluster size:         $clustersize$\n")
                           _T("Sector size:          $sectorsize$\n");
             YoriLibConstantString(&YsFormatString, FormatString);
-            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, &VolResult, &DisplayString);
+            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, VolResult, &DisplayString);
             if (DisplayString.StartOfString != NULL) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
             }
         }
 
-        if (VolResult.Have.PhysicalSectorSize) {
+        if (VolResult->Have.PhysicalSectorSize) {
             LPTSTR FormatString = 
                           _T("Physical sector size: $physicalsectorsize$\n");
             YoriLibConstantString(&YsFormatString, FormatString);
-            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, &VolResult, &DisplayString);
+            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, VolResult, &DisplayString);
             if (DisplayString.StartOfString != NULL) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
             }
         }
 
-        if (VolResult.Have.Usn) {
+        if (VolResult->Have.Usn) {
             LPTSTR FormatString = 
                           _T("USN journal id:       $usnjournalid$\n")
                           _T("First journalled USN: $usnfirst$\n")
@@ -815,60 +924,60 @@ ENTRYPOINT(
                           _T("Maximum USN value:    $usnmax$\n")
                           _T("Maximum journal size: $usnmaxallocated$\n");
             YoriLibConstantString(&YsFormatString, FormatString);
-            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, &VolResult, &DisplayString);
+            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, VolResult, &DisplayString);
             if (DisplayString.StartOfString != NULL) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
             }
         }
 
-        if (VolResult.Have.FullSerial) {
+        if (VolResult->Have.FullSerial) {
             LPTSTR FormatString = 
                           _T("Full serial number:   $fullserial$\n");
             YoriLibConstantString(&YsFormatString, FormatString);
-            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, &VolResult, &DisplayString);
+            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, VolResult, &DisplayString);
             if (DisplayString.StartOfString != NULL) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
             }
         }
 
-        if (VolResult.Have.Reserved) {
+        if (VolResult->Have.Reserved) {
             LPTSTR FormatString = 
                           _T("Reserved bytes:       $reserved$\n");
             YoriLibConstantString(&YsFormatString, FormatString);
-            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, &VolResult, &DisplayString);
+            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, VolResult, &DisplayString);
             if (DisplayString.StartOfString != NULL) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
             }
         }
 
-        if (VolResult.Have.NtfsData) {
+        if (VolResult->Have.NtfsData) {
             LPTSTR FormatString = 
                           _T("File record size:     $filerecordsize$\n")
                           _T("MFT size:             $mftsize$\n");
             YoriLibConstantString(&YsFormatString, FormatString);
-            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, &VolResult, &DisplayString);
+            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, VolResult, &DisplayString);
             if (DisplayString.StartOfString != NULL) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
             }
         }
 
-        if (VolResult.Have.RetrievalPointerBase) {
+        if (VolResult->Have.RetrievalPointerBase) {
             LPTSTR FormatString = 
                           _T("First cluster offset: $firstclusteroffset$\n");
             YoriLibConstantString(&YsFormatString, FormatString);
-            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, &VolResult, &DisplayString);
+            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, VolResult, &DisplayString);
             if (DisplayString.StartOfString != NULL) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
             }
         }
 
-        if (VolResult.Have.VolumeDiskExtents) {
+        if (VolResult->Have.VolumeDiskExtents) {
             LPTSTR FormatString = 
                           _T("Hosting disk number:  $disknumber$\n")
                           _T("Disk offset:          $diskoffset$\n")
                           _T("Partition size:       $partitionsize$\n");
             YoriLibConstantString(&YsFormatString, FormatString);
-            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, &VolResult, &DisplayString);
+            YoriLibExpandCommandVariables(&YsFormatString, '$', VolExpandVariables, VolResult, &DisplayString);
             if (DisplayString.StartOfString != NULL) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
             }
@@ -876,16 +985,16 @@ ENTRYPOINT(
 
         YoriLibFreeStringContents(&DisplayString);
     }
-    YoriLibFreeStringContents(&VolResult.VolumeLabel);
-    YoriLibFreeStringContents(&VolResult.FsName);
     YoriLibFreeStringContents(&FullPathName);
     YoriLibFreeStringContents(&VolRootName);
 
-    if (VolResult.VariableExpansionFailure) {
+    if (VolResult->VariableExpansionFailure) {
+        YoriLibDereference(VolResult);
         return EXIT_FAILURE;
-    } else {
-        return EXIT_SUCCESS;
     }
+
+    YoriLibDereference(VolResult);
+    return EXIT_SUCCESS;
 }
 
 // vim:sw=4:ts=4:et:
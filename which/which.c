@@ -38,6 +38,11 @@ PYORI_STRING SearchFor = NULL;
  */
 LPTSTR SearchVar = _T("PATH");
 
+/**
+ TRUE if every match should be displayed, FALSE to display only the first.
+ */
+BOOLEAN MatchAll = FALSE;
+
 /**
  Usage text for this application.
  */
@@ -47,8 +52,9 @@ CHAR strWhichUsageText[] =
      "Searches a semicolon delimited environment variable for a file.  When\n"
      "searching PATH, also applies PATHEXT executable extension matching.\n"
      "\n"
-     "WHICH [-license] [-p <variable>] <file>\n"
+     "WHICH [-license] [-a] [-p <variable>] <file>\n"
      "\n"
+     "   -a     Display every match rather than the first\n"
      "   -p var Indicates the environment variable to search.  If not specified, use PATH\n"
      "\n"
      " If PATHEXT not defined, defaults to .COM, .EXE, .BAT and .CMD\n"
@@ -87,6 +93,8 @@ WhichParseArgs(
     YORI_ALLOC_SIZE_T i;
     YORI_STRING Arg;
 
+    MatchAll = FALSE;
+
     for (i = 1; i < ArgC; i++) {
         if (YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
             BOOLEAN Parsed = FALSE;
@@ -94,6 +102,9 @@ WhichParseArgs(
             if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
                 YoriLibDisplayMitLicense(_T("2014-2018"));
                 return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("a")) == 0) {
+                MatchAll = TRUE;
+                Parsed = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("p")) == 0 &&
                        ArgC > i + 1) {
 
@@ -119,6 +130,30 @@ WhichParseArgs(
     return TRUE;
 }
 
+/**
+ A callback invoked for each match when every match should be displayed.
+
+ @param Match Pointer to the full path to the match.
+
+ @param Context Pointer to a count of matches displayed, which is
+        incremented.
+
+ @return TRUE to continue searching.
+ */
+BOOL
+WhichDisplayMatch(
+    __in PYORI_STRING Match,
+    __in PVOID Context
+    )
+{
+    PDWORD MatchCount;
+
+    MatchCount = (PDWORD)Context;
+    (*MatchCount)++;
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), Match);
+    return TRUE;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the which builtin command.
@@ -148,6 +183,8 @@ ENTRYPOINT(
 {
     YORI_STRING FoundPath;
     BOOL Result = FALSE;
+    PYORI_LIB_PATH_MATCH_FN MatchFn;
+    DWORD MatchCount;
 
     if (!WhichParseArgs(ArgC, ArgV)) {
         return EXIT_FAILURE;
@@ -168,9 +205,14 @@ ENTRYPOINT(
     }
 
     YoriLibInitEmptyString(&FoundPath);
+    MatchFn = NULL;
+    MatchCount = 0;
+    if (MatchAll) {
+        MatchFn = WhichDisplayMatch;
+    }
 
     if (_tcsicmp(SearchVar, _T("PATH")) == 0) {
-        Result = YoriLibLocateExecutableInPath(SearchFor, NULL, NULL, &FoundPath);
+        Result = YoriLibLocateExecutableInPath(SearchFor, MatchFn, &MatchCount, &FoundPath);
     } else {
         YORI_ALLOC_SIZE_T VarLength;
         YORI_STRING SearchVarData;
@@ -194,7 +236,7 @@ ENTRYPOINT(
         Result = FALSE;
         if (SearchVarData.StartOfString != NULL) {
             if (FoundPath.StartOfString != NULL) {
-                Result = YoriLibPathLocateKnownExtensionUnknownLocation(SearchFor, &SearchVarData, NULL, NULL, &FoundPath);
+                Result = YoriLibPathLocateKnownExtensionUnknownLocation(SearchFor, &SearchVarData, MatchFn, &MatchCount, &FoundPath);
             }
             YoriLibFreeStringContents(&SearchVarData);
         }
@@ -207,6 +249,13 @@ ENTRYPOINT(
     if (!Result) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Error performing search\n"));
         return EXIT_FAILURE;
+    } else if (MatchAll) {
+        YoriLibFreeStringContents(&FoundPath);
+        if (MatchCount == 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Not found\n"));
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
     } else if (FoundPath.LengthInChars > 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &FoundPath);
         YoriLibFreeStringContents(&FoundPath);
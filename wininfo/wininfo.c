@@ -26,7 +26,6 @@
 
 #include <yoripch.h>
 #include <yorilib.h>
-#include <remimu.hxx>
 
 /**
  Help text to display to the user.
@@ -109,10 +108,9 @@ typedef struct _WININFO_CONTEXT {
     DWORD EncodingToUse;
 
     /**
-     Regex tokens.
+     The compiled regular expression.
      */
-    RegexToken tokens[1024];
-    int16_t token_count;
+    YORI_LIB_REGEX Regex;
 
 } WININFO_CONTEXT, *PWININFO_CONTEXT;
 
@@ -151,7 +149,7 @@ WinInfoWindowFound(
         BOOL MatchFound = FALSE;
         WindowTitle.LengthInChars = DllUser32.pGetWindowTextW(hWnd, Buffer, sizeof(Buffer)/sizeof(Buffer[0]));
         if (WinInfoContext->RegexMatch) {
-            int offset = 0;
+            YORI_ALLOC_SIZE_T MatchOffset;
             const int cbtext = WideCharToMultiByte(WinInfoContext->EncodingToUse, 0, WindowTitle.StartOfString, WindowTitle.LengthInChars, NULL, 0, NULL, NULL);
             char *text = (char *)_alloca(cbtext + 1);
             if (WinInfoContext->CaseInsensitive && DllUser32.pCharLowerBuffW) {
@@ -159,18 +157,8 @@ WinInfoWindowFound(
             }
             WideCharToMultiByte(WinInfoContext->EncodingToUse, 0, WindowTitle.StartOfString, WindowTitle.LengthInChars, text, cbtext, NULL, NULL);
             text[cbtext] = '\0';
-            while (offset <= cbtext) {
-                int length;
-                if ((text[offset] & '\xC0') == '\x80') {
-                    ++offset;
-                    continue;
-                }
-                length = (int)regex_match(WinInfoContext->tokens, text, offset, 0, NULL, NULL);
-                if (length >= 0) {
-                    MatchFound = TRUE;
-                    break;
-                }
-                ++offset;
+            if (YoriLibRegexSearch(&WinInfoContext->Regex, text, cbtext, 0, 0, NULL, NULL, &MatchOffset) >= 0) {
+                MatchFound = TRUE;
             }
         } else if (WinInfoContext->CaseInsensitive) {
             if (YoriLibCompareStringIns(&WindowTitle, WinInfoContext->WindowTitle) == 0) {
@@ -393,8 +381,7 @@ ENTRYPOINT(
 
             WideCharToMultiByte(Context.EncodingToUse, 0, Context.WindowTitle->StartOfString, Context.WindowTitle->LengthInChars, pattern, cbpattern, NULL, NULL);
             pattern[cbpattern] = '\0';
-            Context.token_count = 1024;
-            if (regex_parse(pattern, Context.tokens, &Context.token_count, 0) != 0) {
+            if (YoriLibRegexCompile(pattern, &Context.Regex) != 0) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("wininfo: invalid regex\n"));
                 return EXIT_FAILURE;
             }
@@ -402,10 +389,12 @@ ENTRYPOINT(
 
         if (DllUser32.pEnumWindows == NULL) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("wininfo: operating system support not present\n"));
+            YoriLibRegexFree(&Context.Regex);
             return EXIT_FAILURE;
         }
 
         DllUser32.pEnumWindows(WinInfoWindowFound, (LPARAM)&Context);
+        YoriLibRegexFree(&Context.Regex);
 
         if (Context.Window == NULL) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("wininfo: window not found\n"));
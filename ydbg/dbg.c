@@ -3,7 +3,7 @@
  *
  * Yori shell debug processes
  *
- * Copyright (c) 2018-2021 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -36,19 +36,26 @@ CHAR strYDbgHelpText[] =
         "Debugs processes and system components.\n"
         "\n"
         "YDBG -c <file>\n"
-        "YDBG -d <pid> <file>\n"
+        "YDBG [-dt <type>] [-z] -d <pid> <file>\n"
         "YDBG [-l] [-w] -e <executable> <args>\n"
         "YDBG -license\n"
         "YDBG -k <file>\n"
         "YDBG -ks <pid> <file>\n"
+        "YDBG -sample <pid> <ms> <file>\n"
         "\n"
         "   -c             Dump memory from kernel and user processes to a file\n"
-        "   -d             Dump memory from a process to a file\n"
+        "   -d             Dump memory from a process to a file.  If the file name ends\n"
+        "                    in .cab, the dump is placed in a cabinet\n"
+        "   -dt            Specify the dump type, one of full (default), noheap or\n"
+        "                    threads\n"
         "   -e             Execute a child process and capture debug output\n"
         "   -k             Dump memory from kernel to a file\n"
         "   -ks            Dump memory from kernel stacks associated with a process to a file\n"
         "   -l             Enable loader snaps for a child process\n"
-        "   -w             Create child process in a new window\n";
+        "   -sample        Sample user stacks of a process for a number of milliseconds\n"
+        "                    and write them to a file as folded stacks\n"
+        "   -w             Create child process in a new window\n"
+        "   -z             Compress the dump as it is written\n";
 
 /**
  Display usage text to the user.
@@ -65,25 +72,134 @@ YDbgHelp(VOID)
 }
 
 /**
- Write the memory from a process to a dump file.
+ The MiniDumpWriteDump flag to include data sections of loaded modules.
+ */
+#define YDBG_MINIDUMP_WITH_DATA_SEGS                      (0x00000001)
+
+/**
+ The MiniDumpWriteDump flag to include all accessible memory.
+ */
+#define YDBG_MINIDUMP_WITH_FULL_MEMORY                    (0x00000002)
+
+/**
+ The MiniDumpWriteDump flag to include information about open handles.
+ */
+#define YDBG_MINIDUMP_WITH_HANDLE_DATA                    (0x00000004)
+
+/**
+ The MiniDumpWriteDump flag to include a list of unloaded modules.
+ */
+#define YDBG_MINIDUMP_WITH_UNLOADED_MODULES               (0x00000020)
+
+/**
+ The MiniDumpWriteDump flag to include memory referenced by pointers found
+ on thread stacks.
+ */
+#define YDBG_MINIDUMP_WITH_INDIRECTLY_REFERENCED_MEMORY   (0x00000040)
+
+/**
+ The MiniDumpWriteDump flag to include extended information about threads.
+ */
+#define YDBG_MINIDUMP_WITH_THREAD_INFO                    (0x00001000)
+
+/**
+ A named set of MiniDumpWriteDump flags that can be selected by the user.
+ */
+typedef struct _YDBG_DUMP_TYPE {
+
+    /**
+     The name of the dump type as specified on the command line.
+     */
+    LPCTSTR Name;
+
+    /**
+     The flags to supply to MiniDumpWriteDump.
+     */
+    DWORD Flags;
+} YDBG_DUMP_TYPE, *PYDBG_DUMP_TYPE;
+
+/**
+ The set of dump types that can be selected by the user.  The first entry
+ is the default.
+ */
+CONST YDBG_DUMP_TYPE YDbgDumpTypes[] = {
+    {_T("full"),    YDBG_MINIDUMP_WITH_FULL_MEMORY},
+    {_T("noheap"),  YDBG_MINIDUMP_WITH_DATA_SEGS |
+                    YDBG_MINIDUMP_WITH_HANDLE_DATA |
+                    YDBG_MINIDUMP_WITH_UNLOADED_MODULES |
+                    YDBG_MINIDUMP_WITH_INDIRECTLY_REFERENCED_MEMORY |
+                    YDBG_MINIDUMP_WITH_THREAD_INFO},
+    {_T("threads"), YDBG_MINIDUMP_WITH_THREAD_INFO}
+};
+
+/**
+ Find a dump type by the name specified by the user.
+
+ @param Name Pointer to the name of the dump type.
+
+ @param Flags On successful completion, populated with the flags to supply
+        to MiniDumpWriteDump.
+
+ @return TRUE if the dump type was found, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+YDbgFindDumpType(
+    __in PYORI_STRING Name,
+    __out PDWORD Flags
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < sizeof(YDbgDumpTypes)/sizeof(YDbgDumpTypes[0]); Index++) {
+        if (YoriLibCompareStringLitIns(Name, YDbgDumpTypes[Index].Name) == 0) {
+            *Flags = YDbgDumpTypes[Index].Flags;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Write the memory from a process to a dump file.  If the file name ends in
+ .cab, the dump is written to a temporary file in the same directory and
+ then placed in a cabinet with the same base name.
 
  @param ProcessPid Specifies the process whose memory should be written.
 
  @param FileName Specifies the file name to write the memory to.
 
+ @param DumpFlags Specifies the flags to supply to MiniDumpWriteDump,
+        which control how much of the process is written.
+
+ @param Compress If TRUE, enable file system compression on the dump file
+        before writing it, so it is compressed as it is written.
+
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 YDbgDumpProcess(
     __in DWORD ProcessPid,
-    __in PYORI_STRING FileName
+    __in PYORI_STRING FileName,
+    __in DWORD DumpFlags,
+    __in BOOLEAN Compress
     )
 {
     HANDLE ProcessHandle;
     HANDLE FileHandle;
     DWORD LastError;
+    DWORD BytesReturned;
+    USHORT Algorithm;
     LPTSTR ErrText;
+    LPTSTR FinalComponent;
     YORI_STRING FullPath;
+    YORI_STRING DumpPath;
+    YORI_STRING Extension;
+    YORI_STRING NameInCab;
+    PVOID CabHandle;
+    BOOLEAN WriteCab;
+    BOOL Result;
 
     YoriLibLoadDbgHelpFunctions();
     if (DllDbgHelp.pMiniDumpWriteDump == NULL) {
@@ -111,34 +227,114 @@ YDbgDumpProcess(
         return FALSE;
     }
 
-    FileHandle = CreateFile(FullPath.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    //
+    //  If the target is a cabinet, write the dump next to it first.
+    //
+
+    WriteCab = FALSE;
+    if (FullPath.LengthInChars > sizeof(".cab") - 1) {
+        YoriLibInitEmptyString(&Extension);
+        Extension.StartOfString = &FullPath.StartOfString[FullPath.LengthInChars - (sizeof(".cab") - 1)];
+        Extension.LengthInChars = sizeof(".cab") - 1;
+        if (YoriLibCompareStringLitIns(&Extension, _T(".cab")) == 0) {
+            WriteCab = TRUE;
+        }
+    }
+
+    YoriLibInitEmptyString(&DumpPath);
+    if (WriteCab) {
+        if (!YoriLibAllocateString(&DumpPath, FullPath.LengthInChars + sizeof(".tmp"))) {
+            YoriLibFreeStringContents(&FullPath);
+            CloseHandle(ProcessHandle);
+            return FALSE;
+        }
+        DumpPath.LengthInChars = YoriLibSPrintf(DumpPath.StartOfString, _T("%y.tmp"), &FullPath);
+    } else {
+        YoriLibCloneString(&DumpPath, &FullPath);
+    }
+
+    FileHandle = CreateFile(DumpPath.StartOfString, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
     if (FileHandle == INVALID_HANDLE_VALUE) {
         LastError = GetLastError();
         ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: CreateFile of %y failed: %s"), &FullPath, ErrText);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: CreateFile of %y failed: %s"), &DumpPath, ErrText);
         YoriLibFreeWinErrorText(ErrText);
+        YoriLibFreeStringContents(&DumpPath);
         YoriLibFreeStringContents(&FullPath);
         CloseHandle(ProcessHandle);
         return FALSE;
     }
 
-    if (!DllDbgHelp.pMiniDumpWriteDump(ProcessHandle, ProcessPid, FileHandle, 2, NULL, NULL, NULL)) {
+    //
+    //  Compressing the file before writing means it is compressed as it is
+    //  written, so the uncompressed dump never needs to fit on disk.  If
+    //  the file system can't compress, continue without it.
+    //
+
+    if (Compress) {
+        Algorithm = COMPRESSION_FORMAT_DEFAULT;
+        if (!DeviceIoControl(FileHandle, FSCTL_SET_COMPRESSION, &Algorithm, sizeof(Algorithm), NULL, 0, &BytesReturned, NULL)) {
+            LastError = GetLastError();
+            ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: could not compress %y: %s"), &DumpPath, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+        }
+    }
+
+    if (!DllDbgHelp.pMiniDumpWriteDump(ProcessHandle, ProcessPid, FileHandle, DumpFlags, NULL, NULL, NULL)) {
         LastError = GetLastError();
         ErrText = YoriLibGetWinErrorText(LastError);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: MiniDumpWriteDump failed: %s"), ErrText);
         YoriLibFreeWinErrorText(ErrText);
+        CloseHandle(FileHandle);
+        if (WriteCab) {
+            DeleteFile(DumpPath.StartOfString);
+        }
+        YoriLibFreeStringContents(&DumpPath);
         YoriLibFreeStringContents(&FullPath);
         CloseHandle(ProcessHandle);
-        CloseHandle(FileHandle);
         return FALSE;
     }
 
-    YoriLibFreeStringContents(&FullPath);
-    CloseHandle(ProcessHandle);
     CloseHandle(FileHandle);
-    return TRUE;
-}
+    CloseHandle(ProcessHandle);
+
+    Result = TRUE;
+    if (WriteCab) {
+
+        //
+        //  Name the dump within the cabinet after the cabinet, with a .dmp
+        //  extension.
+        //
+
+        YoriLibInitEmptyString(&NameInCab);
+        NameInCab.StartOfString = FullPath.StartOfString;
+        NameInCab.LengthInChars = FullPath.LengthInChars;
+        FinalComponent = YoriLibFindRightMostCharacter(&NameInCab, '\\');
+        if (FinalComponent != NULL) {
+            NameInCab.StartOfString = FinalComponent + 1;
+            NameInCab.LengthInChars = FullPath.LengthInChars - (YORI_ALLOC_SIZE_T)(NameInCab.StartOfString - FullPath.StartOfString);
+        }
+        memcpy(&NameInCab.StartOfString[NameInCab.LengthInChars - (sizeof(".cab") - 1)], _T(".dmp"), (sizeof(".dmp") - 1) * sizeof(TCHAR));
 
+        Result = FALSE;
+        if (YoriLibCreateCab(&FullPath, &CabHandle)) {
+            if (YoriLibAddFileToCab(CabHandle, &DumpPath, &NameInCab)) {
+                Result = TRUE;
+            }
+            YoriLibCloseCab(CabHandle);
+        }
+
+        if (!Result) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: could not write cabinet %y\n"), &FullPath);
+        }
+        DeleteFile(DumpPath.StartOfString);
+    }
+
+    YoriLibFreeStringContents(&DumpPath);
+    YoriLibFreeStringContents(&FullPath);
+    return Result;
+}
 /**
  Scan through the set of processes in the system to find the requested
  process, and scan through each of its threads, opening them to have
@@ -466,6 +662,561 @@ YDbgDumpKernel(
     return Result;
 }
 
+/**
+ The interval between samples when sampling a process, in milliseconds.
+ */
+#define YDBG_SAMPLE_INTERVAL_MS (10)
+
+/**
+ The maximum number of frames to capture from a single thread's stack when
+ sampling a process.
+ */
+#define YDBG_SAMPLE_MAX_FRAMES (64)
+
+/**
+ The maximum number of characters of a symbol name to capture when
+ sampling a process.
+ */
+#define YDBG_SAMPLE_MAX_SYMBOL (256)
+
+/**
+ A unique stack observed while sampling a process, and the number of times
+ it has been observed.
+ */
+typedef struct _YDBG_SAMPLE_STACK {
+
+    /**
+     The entry of this stack within the hash table of stacks, keyed by the
+     folded stack.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The entry of this stack within the list of stacks, in the order they
+     were first observed.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The number of samples which observed this stack.
+     */
+    DWORD Count;
+
+    /**
+     The folded stack, consisting of each symbol from the outermost frame to
+     the innermost frame seperated by semicolons.  The string is allocated
+     with this structure.
+     */
+    YORI_STRING Stack;
+} YDBG_SAMPLE_STACK, *PYDBG_SAMPLE_STACK;
+
+/**
+ State used while sampling a process.
+ */
+typedef struct _YDBG_SAMPLE_CONTEXT {
+
+    /**
+     A handle to the process being sampled.
+     */
+    HANDLE ProcessHandle;
+
+    /**
+     A hash table of unique stacks that have been observed.
+     */
+    PYORI_HASH_TABLE StackTable;
+
+    /**
+     A list of unique stacks that have been observed.
+     */
+    YORI_LIST_ENTRY StackList;
+
+    /**
+     A buffer used to construct the folded form of each stack.
+     */
+    YORI_STRING FoldedStack;
+
+    /**
+     The number of thread stacks that have been captured.
+     */
+    DWORD SampleCount;
+} YDBG_SAMPLE_CONTEXT, *PYDBG_SAMPLE_CONTEXT;
+
+/**
+ Initialize a stack frame from a thread's context for the architecture that
+ this program is compiled for.
+
+ @param ThreadContext Pointer to the context of the thread.
+
+ @param StackFrame On successful completion, populated with the initial
+        state to walk the stack.
+
+ @param MachineType On successful completion, populated with the machine
+        type to supply to StackWalk64.
+
+ @return TRUE to indicate success, FALSE if this architecture is not
+         supported.
+ */
+__success(return)
+BOOLEAN
+YDbgInitializeStackFrame(
+    __in PCONTEXT ThreadContext,
+    __out PYORI_STACKFRAME64 StackFrame,
+    __out PDWORD MachineType
+    )
+{
+    ZeroMemory(StackFrame, sizeof(YORI_STACKFRAME64));
+    StackFrame->AddrPC.Mode = YORI_ADDRESS_MODE_FLAT;
+    StackFrame->AddrFrame.Mode = YORI_ADDRESS_MODE_FLAT;
+    StackFrame->AddrStack.Mode = YORI_ADDRESS_MODE_FLAT;
+
+#if defined(_M_AMD64)
+    *MachineType = IMAGE_FILE_MACHINE_AMD64;
+    StackFrame->AddrPC.Offset = ThreadContext->Rip;
+    StackFrame->AddrFrame.Offset = ThreadContext->Rsp;
+    StackFrame->AddrStack.Offset = ThreadContext->Rsp;
+    return TRUE;
+#elif defined(_M_ARM64)
+    *MachineType = IMAGE_FILE_MACHINE_ARM64;
+    StackFrame->AddrPC.Offset = ThreadContext->Pc;
+    StackFrame->AddrFrame.Offset = ThreadContext->Fp;
+    StackFrame->AddrStack.Offset = ThreadContext->Sp;
+    return TRUE;
+#elif defined(_M_ARM)
+    *MachineType = IMAGE_FILE_MACHINE_ARMNT;
+    StackFrame->AddrPC.Offset = ThreadContext->Pc;
+    StackFrame->AddrFrame.Offset = ThreadContext->R11;
+    StackFrame->AddrStack.Offset = ThreadContext->Sp;
+    return TRUE;
+#elif defined(_M_IX86)
+    *MachineType = IMAGE_FILE_MACHINE_I386;
+    StackFrame->AddrPC.Offset = ThreadContext->Eip;
+    StackFrame->AddrFrame.Offset = ThreadContext->Ebp;
+    StackFrame->AddrStack.Offset = ThreadContext->Esp;
+    return TRUE;
+#else
+    UNREFERENCED_PARAMETER(ThreadContext);
+    *MachineType = 0;
+    return FALSE;
+#endif
+}
+
+/**
+ Suspend a thread, capture the program counter of each frame on its user
+ mode stack, and resume it.  Symbols are resolved by the caller after the
+ thread is resumed so that it is suspended for as little time as possible.
+
+ @param SampleContext Pointer to the sampling state.
+
+ @param ThreadHandle A handle to the thread to capture.
+
+ @param Frames On successful completion, populated with the program counter
+        of each frame, from innermost to outermost.
+
+ @param FrameCount On successful completion, populated with the number of
+        frames captured.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YDbgCaptureThreadStack(
+    __in PYDBG_SAMPLE_CONTEXT SampleContext,
+    __in HANDLE ThreadHandle,
+    __out_ecount(YDBG_SAMPLE_MAX_FRAMES) DWORDLONG * Frames,
+    __out PDWORD FrameCount
+    )
+{
+    CONTEXT ThreadContext;
+    YORI_STACKFRAME64 StackFrame;
+    DWORD MachineType;
+    DWORD Count;
+
+    if (SuspendThread(ThreadHandle) == (DWORD)-1) {
+        return FALSE;
+    }
+
+    ZeroMemory(&ThreadContext, sizeof(ThreadContext));
+    ThreadContext.ContextFlags = CONTEXT_FULL;
+    if (!GetThreadContext(ThreadHandle, &ThreadContext) ||
+        !YDbgInitializeStackFrame(&ThreadContext, &StackFrame, &MachineType)) {
+
+        ResumeThread(ThreadHandle);
+        return FALSE;
+    }
+
+    Count = 0;
+    while (Count < YDBG_SAMPLE_MAX_FRAMES) {
+        if (!DllDbgHelp.pStackWalk64(MachineType,
+                                     SampleContext->ProcessHandle,
+                                     ThreadHandle,
+                                     &StackFrame,
+                                     &ThreadContext,
+                                     NULL,
+                                     DllDbgHelp.pSymFunctionTableAccess64,
+                                     DllDbgHelp.pSymGetModuleBase64,
+                                     NULL)) {
+            break;
+        }
+
+        if (StackFrame.AddrPC.Offset == 0) {
+            break;
+        }
+
+        Frames[Count] = StackFrame.AddrPC.Offset;
+        Count++;
+    }
+
+    ResumeThread(ThreadHandle);
+
+    *FrameCount = Count;
+    return (Count > 0);
+}
+
+/**
+ Resolve the frames of a captured stack into a folded stack, and count it
+ against any identical stack previously observed.
+
+ @param SampleContext Pointer to the sampling state.
+
+ @param Frames Pointer to the program counter of each frame, from innermost
+        to outermost.
+
+ @param FrameCount The number of frames.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+YDbgRecordThreadStack(
+    __in PYDBG_SAMPLE_CONTEXT SampleContext,
+    __in DWORDLONG * Frames,
+    __in DWORD FrameCount
+    )
+{
+    PYORI_STRING FoldedStack;
+    PYORI_HASH_ENTRY HashEntry;
+    PYDBG_SAMPLE_STACK Stack;
+    PYORI_SYMBOL_INFO Symbol;
+    UCHAR SymbolBuffer[sizeof(YORI_SYMBOL_INFO) + YDBG_SAMPLE_MAX_SYMBOL];
+    DWORDLONG Displacement;
+    YORI_SIGNED_ALLOC_SIZE_T CharsWritten;
+    DWORD Index;
+
+    FoldedStack = &SampleContext->FoldedStack;
+    FoldedStack->LengthInChars = 0;
+    Symbol = (PYORI_SYMBOL_INFO)SymbolBuffer;
+
+    for (Index = FrameCount; Index > 0; Index--) {
+        ZeroMemory(Symbol, sizeof(YORI_SYMBOL_INFO));
+        Symbol->SizeOfStruct = sizeof(YORI_SYMBOL_INFO);
+        Symbol->MaxNameLen = YDBG_SAMPLE_MAX_SYMBOL;
+
+        if (FoldedStack->LengthInChars > 0 &&
+            FoldedStack->LengthInChars + 1 < FoldedStack->LengthAllocated) {
+
+            FoldedStack->StartOfString[FoldedStack->LengthInChars] = ';';
+            FoldedStack->LengthInChars++;
+        }
+
+        if (DllDbgHelp.pSymFromAddr(SampleContext->ProcessHandle, Frames[Index - 1], &Displacement, Symbol)) {
+            Symbol->Name[YDBG_SAMPLE_MAX_SYMBOL - 1] = '\0';
+            CharsWritten = YoriLibSPrintfS(&FoldedStack->StartOfString[FoldedStack->LengthInChars],
+                                           FoldedStack->LengthAllocated - FoldedStack->LengthInChars,
+                                           _T("%hs"),
+                                           Symbol->Name);
+        } else {
+            CharsWritten = YoriLibSPrintfS(&FoldedStack->StartOfString[FoldedStack->LengthInChars],
+                                           FoldedStack->LengthAllocated - FoldedStack->LengthInChars,
+                                           _T("0x%llx"),
+                                           Frames[Index - 1]);
+        }
+
+        if (CharsWritten > 0) {
+            FoldedStack->LengthInChars = FoldedStack->LengthInChars + (YORI_ALLOC_SIZE_T)CharsWritten;
+        }
+    }
+
+    SampleContext->SampleCount++;
+
+    HashEntry = YoriLibHashLookupByKey(SampleContext->StackTable, FoldedStack);
+    if (HashEntry != NULL) {
+        Stack = (PYDBG_SAMPLE_STACK)HashEntry->Context;
+        Stack->Count++;
+        return TRUE;
+    }
+
+    Stack = YoriLibReferencedMalloc(sizeof(YDBG_SAMPLE_STACK) + (FoldedStack->LengthInChars + 1) * sizeof(TCHAR));
+    if (Stack == NULL) {
+        return FALSE;
+    }
+
+    YoriLibReference(Stack);
+    Stack->Count = 1;
+    YoriLibInitEmptyString(&Stack->Stack);
+    Stack->Stack.MemoryToFree = Stack;
+    Stack->Stack.StartOfString = (LPTSTR)(Stack + 1);
+    Stack->Stack.LengthAllocated = FoldedStack->LengthInChars + 1;
+    Stack->Stack.LengthInChars = FoldedStack->LengthInChars;
+    memcpy(Stack->Stack.StartOfString, FoldedStack->StartOfString, FoldedStack->LengthInChars * sizeof(TCHAR));
+    Stack->Stack.StartOfString[Stack->Stack.LengthInChars] = '\0';
+
+    YoriLibHashInsertByKey(SampleContext->StackTable, &Stack->Stack, Stack, &Stack->HashEntry);
+    YoriLibAppendList(&SampleContext->StackList, &Stack->ListEntry);
+    return TRUE;
+}
+
+/**
+ Capture the stack of every thread in a process once.  Threads are
+ enumerated on each sample so that threads created while sampling are
+ included, and threads which exit while sampling are skipped.
+
+ @param SampleContext Pointer to the sampling state.
+
+ @param ProcessPid The process identifier of the process to sample.
+
+ @return TRUE if the process was found, FALSE if it was not, which
+         typically indicates that it has exited.
+ */
+BOOLEAN
+YDbgSampleProcessOnce(
+    __in PYDBG_SAMPLE_CONTEXT SampleContext,
+    __in DWORD ProcessPid
+    )
+{
+    PYORI_SYSTEM_PROCESS_INFORMATION ProcessInfo;
+    PYORI_SYSTEM_PROCESS_INFORMATION CurrentEntry;
+    PYORI_SYSTEM_THREAD_INFORMATION CurrentThread;
+    DWORDLONG Frames[YDBG_SAMPLE_MAX_FRAMES];
+    DWORD FrameCount;
+    DWORD ThreadId;
+    DWORD Index;
+    HANDLE ThreadHandle;
+
+    if (!YoriLibGetSystemProcessList(&ProcessInfo)) {
+        return FALSE;
+    }
+
+    CurrentEntry = ProcessInfo;
+    do {
+        if (CurrentEntry->ProcessId == ProcessPid) {
+            break;
+        }
+        if (CurrentEntry->NextEntryOffset == 0) {
+            CurrentEntry = NULL;
+            break;
+        }
+        CurrentEntry = YoriLibAddToPointer(CurrentEntry, CurrentEntry->NextEntryOffset);
+    } while(TRUE);
+
+    if (CurrentEntry == NULL) {
+        YoriLibFree(ProcessInfo);
+        return FALSE;
+    }
+
+    CurrentThread = (PYORI_SYSTEM_THREAD_INFORMATION)(CurrentEntry + 1);
+    for (Index = 0; Index < CurrentEntry->NumberOfThreads; Index++) {
+        ThreadId = (DWORD)(DWORD_PTR)CurrentThread[Index].ThreadId;
+        if (ThreadId == GetCurrentThreadId()) {
+            continue;
+        }
+
+        ThreadHandle = DllKernel32.pOpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION, FALSE, ThreadId);
+        if (ThreadHandle == NULL) {
+            continue;
+        }
+
+        if (YDbgCaptureThreadStack(SampleContext, ThreadHandle, Frames, &FrameCount)) {
+            YDbgRecordThreadStack(SampleContext, Frames, FrameCount);
+        }
+
+        CloseHandle(ThreadHandle);
+    }
+
+    YoriLibFree(ProcessInfo);
+    return TRUE;
+}
+
+/**
+ Periodically capture the user mode stacks of all threads in a process and
+ write the result to a file in folded stack form, where each line contains
+ a unique stack followed by the number of samples that observed it.  This
+ form can be used to generate a flame graph.
+
+ @param ProcessPid Specifies the process to sample.
+
+ @param Duration Specifies the length of time to sample for, in
+        milliseconds.
+
+ @param FileName Specifies the file name to write the stacks to.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YDbgSampleProcess(
+    __in DWORD ProcessPid,
+    __in DWORD Duration,
+    __in PYORI_STRING FileName
+    )
+{
+    YDBG_SAMPLE_CONTEXT SampleContext;
+    PYORI_LIST_ENTRY ListEntry;
+    PYDBG_SAMPLE_STACK Stack;
+    HANDLE FileHandle;
+    DWORD LastError;
+    LPTSTR ErrText;
+    YORI_STRING FullPath;
+    DWORD StartTime;
+    BOOL TargetWow64;
+    BOOL OurWow64;
+    BOOL Result;
+
+    YoriLibLoadDbgHelpFunctions();
+    if (DllKernel32.pOpenThread == NULL ||
+        DllDbgHelp.pStackWalk64 == NULL ||
+        DllDbgHelp.pSymCleanup == NULL ||
+        DllDbgHelp.pSymFromAddr == NULL ||
+        DllDbgHelp.pSymFunctionTableAccess64 == NULL ||
+        DllDbgHelp.pSymGetModuleBase64 == NULL ||
+        DllDbgHelp.pSymInitialize == NULL ||
+        DllDbgHelp.pSymSetOptions == NULL) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: OS support not present\n"));
+        return FALSE;
+    }
+
+    YoriLibEnableDebugPrivilege();
+
+    ZeroMemory(&SampleContext, sizeof(SampleContext));
+    SampleContext.ProcessHandle = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, ProcessPid);
+    if (SampleContext.ProcessHandle == NULL) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: OpenProcess of %i failed: %s"), ProcessPid, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    //
+    //  The stack is walked using this program's thread context format, so
+    //  a 32 bit process must be sampled by a 32 bit build and vice versa.
+    //
+
+    if (DllKernel32.pIsWow64Process != NULL) {
+        TargetWow64 = FALSE;
+        OurWow64 = FALSE;
+        DllKernel32.pIsWow64Process(SampleContext.ProcessHandle, &TargetWow64);
+        DllKernel32.pIsWow64Process(GetCurrentProcess(), &OurWow64);
+        if (TargetWow64 != OurWow64) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: process %i has a different architecture to ydbg\n"), ProcessPid);
+            CloseHandle(SampleContext.ProcessHandle);
+            return FALSE;
+        }
+    }
+
+    YoriLibInitEmptyString(&FullPath);
+    if (!YoriLibUserStringToSingleFilePath(FileName, TRUE, &FullPath)) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: getfullpathname of %y failed: %s"), FileName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        CloseHandle(SampleContext.ProcessHandle);
+        return FALSE;
+    }
+
+    FileHandle = CreateFile(FullPath.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: CreateFile of %y failed: %s"), &FullPath, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        YoriLibFreeStringContents(&FullPath);
+        CloseHandle(SampleContext.ProcessHandle);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&FullPath);
+
+    SampleContext.StackTable = YoriLibAllocateHashTable(1000);
+    if (SampleContext.StackTable == NULL ||
+        !YoriLibAllocateString(&SampleContext.FoldedStack, YDBG_SAMPLE_MAX_FRAMES * (YDBG_SAMPLE_MAX_SYMBOL + 1))) {
+
+        if (SampleContext.StackTable != NULL) {
+            YoriLibFreeEmptyHashTable(SampleContext.StackTable);
+        }
+        CloseHandle(FileHandle);
+        CloseHandle(SampleContext.ProcessHandle);
+        return FALSE;
+    }
+    YoriLibInitializeListHead(&SampleContext.StackList);
+
+    DllDbgHelp.pSymSetOptions(YORI_SYMOPT_UNDNAME | YORI_SYMOPT_DEFERRED_LOADS);
+    if (!DllDbgHelp.pSymInitialize(SampleContext.ProcessHandle, NULL, TRUE)) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: SymInitialize failed: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        YoriLibFreeStringContents(&SampleContext.FoldedStack);
+        YoriLibFreeEmptyHashTable(SampleContext.StackTable);
+        CloseHandle(FileHandle);
+        CloseHandle(SampleContext.ProcessHandle);
+        return FALSE;
+    }
+
+    //
+    //  Capture samples until the duration has elapsed or the process
+    //  exits.
+    //
+
+    StartTime = GetTickCount();
+    while (TRUE) {
+        if (!YDbgSampleProcessOnce(&SampleContext, ProcessPid)) {
+            break;
+        }
+
+        if (GetTickCount() - StartTime >= Duration) {
+            break;
+        }
+
+        Sleep(YDBG_SAMPLE_INTERVAL_MS);
+    }
+
+    DllDbgHelp.pSymCleanup(SampleContext.ProcessHandle);
+
+    //
+    //  Write each unique stack and free it.
+    //
+
+    Result = TRUE;
+    ListEntry = YoriLibGetNextListEntry(&SampleContext.StackList, NULL);
+    while (ListEntry != NULL) {
+        Stack = CONTAINING_RECORD(ListEntry, YDBG_SAMPLE_STACK, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&SampleContext.StackList, ListEntry);
+        if (Result &&
+            !YoriLibOutputToDevice(FileHandle, 0, _T("%y %i\n"), &Stack->Stack, Stack->Count)) {
+
+            LastError = GetLastError();
+            ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: write failed: %s"), ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            Result = FALSE;
+        }
+        YoriLibHashRemoveByEntry(&Stack->HashEntry);
+        YoriLibRemoveListItem(&Stack->ListEntry);
+        YoriLibFreeStringContents(&Stack->Stack);
+        YoriLibDereference(Stack);
+    }
+
+    if (SampleContext.SampleCount == 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: no stacks could be captured from process %i\n"), ProcessPid);
+        Result = FALSE;
+    }
+
+    YoriLibFreeStringContents(&SampleContext.FoldedStack);
+    YoriLibFreeEmptyHashTable(SampleContext.StackTable);
+    CloseHandle(FileHandle);
+    CloseHandle(SampleContext.ProcessHandle);
+    return Result;
+}
+
 /**
  Information about a process where the mini-debugger has observed it be
  launched and has not yet observed termination.
@@ -1137,6 +1888,7 @@ typedef enum _YDBG_OP {
     YDbgOperationCompleteDump = 3,
     YDbgOperationProcessKernelStacks = 4,
     YDbgOperationDebugChildProcess = 5,
+    YDbgOperationSampleProcess = 6,
 } YDBG_OP;
 
 #ifdef YORI_BUILTIN
@@ -1173,15 +1925,20 @@ ENTRYPOINT(
     YORI_STRING Arg;
     YDBG_OP Op;
     DWORD ProcessPid = 0;
+    DWORD Duration = 0;
     PYORI_STRING FileName = NULL;
     YORI_MAX_SIGNED_T llTemp;
     YORI_ALLOC_SIZE_T CharsConsumed;
     DWORD ExitResult;
     BOOLEAN EnableLoaderSnaps;
     BOOLEAN CreateNewWindow;
+    BOOLEAN CompressDump;
+    DWORD DumpFlags;
 
     EnableLoaderSnaps = FALSE;
     CreateNewWindow = FALSE;
+    CompressDump = FALSE;
+    DumpFlags = YDbgDumpTypes[0].Flags;
     Op = YDbgOperationNone;
 
     for (i = 1; i < ArgC; i++) {
@@ -1195,7 +1952,7 @@ ENTRYPOINT(
                 YDbgHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2018-2021"));
+                YoriLibDisplayMitLicense(_T("2018-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("c")) == 0) {
                 if (ArgC > i + 1) {
@@ -1216,6 +1973,15 @@ ENTRYPOINT(
                     ArgumentUnderstood = TRUE;
                     i += 2;
                 }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("dt")) == 0) {
+                if (ArgC > i + 1) {
+                    if (!YDbgFindDumpType(&ArgV[i + 1], &DumpFlags)) {
+                        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%y is not a valid dump type.\n"), &ArgV[i + 1]);
+                        return EXIT_FAILURE;
+                    }
+                    ArgumentUnderstood = TRUE;
+                    i += 1;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("e")) == 0) {
                 if (ArgC > i + 1) {
                     Op = YDbgOperationDebugChildProcess;
@@ -1245,9 +2011,31 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
                 EnableLoaderSnaps = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("sample")) == 0) {
+                if (ArgC > i + 3) {
+                    Op = YDbgOperationSampleProcess;
+                    if (!YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed)) {
+                        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%y is not a valid pid.\n"), &ArgV[i + 1]);
+                        return EXIT_FAILURE;
+                    }
+                    ProcessPid = (DWORD)llTemp;
+                    if (!YoriLibStringToNumber(&ArgV[i + 2], TRUE, &llTemp, &CharsConsumed) ||
+                        llTemp <= 0) {
+
+                        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%y is not a valid duration.\n"), &ArgV[i + 2]);
+                        return EXIT_FAILURE;
+                    }
+                    Duration = (DWORD)llTemp;
+                    FileName = &ArgV[i + 3];
+                    ArgumentUnderstood = TRUE;
+                    i += 3;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("w")) == 0) {
                 CreateNewWindow = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("z")) == 0) {
+                CompressDump = TRUE;
+                ArgumentUnderstood = TRUE;
             }
         } else {
             ArgumentUnderstood = TRUE;
@@ -1269,7 +2057,7 @@ ENTRYPOINT(
 
     ExitResult = EXIT_SUCCESS;
     if (Op == YDbgOperationProcessDump) {
-        if (!YDbgDumpProcess(ProcessPid, FileName)) {
+        if (!YDbgDumpProcess(ProcessPid, FileName, DumpFlags, CompressDump)) {
             ExitResult = EXIT_FAILURE;
         }
     } else if (Op == YDbgOperationProcessKernelStacks) {
@@ -1284,6 +2072,10 @@ ENTRYPOINT(
         if (!YDbgDumpKernel(FileName, TRUE)) {
             ExitResult = EXIT_FAILURE;
         }
+    } else if (Op == YDbgOperationSampleProcess) {
+        if (!YDbgSampleProcess(ProcessPid, Duration, FileName)) {
+            ExitResult = EXIT_FAILURE;
+        }
     } else if (Op == YDbgOperationDebugChildProcess) {
         ExitResult = YDbgDebugChildProcess(EnableLoaderSnaps, CreateNewWindow, ArgC - StartArg, &ArgV[StartArg]);
     }
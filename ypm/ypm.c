@@ -66,6 +66,7 @@ typedef struct _YPM_OP_MAP {
  */
 CONST YPM_OP_MAP YpmCallbackFunctions[] = {
     {_T("c"),               YpmCreateBinaryPackage, "Create a new installable package"},
+    {_T("cd"),              YpmCreateDelta,         "Create a binary delta between two versions of a file"},
     {_T("config"),          YpmConfig,              "Update system configuration"},
     {_T("cs"),              YpmCreateSourcePackage, "Create a new source package"},
     {_T("d"),               YpmDelete,              "Delete an installed package"},
@@ -1,6 +1,7 @@
 
 YORI_CMD_BUILTIN YpmConfig;
 YORI_CMD_BUILTIN YpmCreateBinaryPackage;
+YORI_CMD_BUILTIN YpmCreateDelta;
 YORI_CMD_BUILTIN YpmCreateSourcePackage;
 YORI_CMD_BUILTIN YpmDelete;
 YORI_CMD_BUILTIN YpmDownload;
@@ -73,6 +73,25 @@ CHAR strYpmCreateSourceHelpText[] =
         "\n"
         "   -filepath       Specifies a directory containing source code\n";
 
+/**
+ Help text to display to the user.
+ */
+const
+CHAR strYpmCreateDeltaHelpText[] =
+        "\n"
+        "Create a binary delta that updates one version of a file to the next.\n"
+        "\n"
+        "YPM [-license]\n"
+        "YPM -cd <oldfile> <newfile> [<deltafile>]\n"
+        "\n"
+        "   If deltafile is not specified, the delta is written next to newfile with\n"
+        "   the name that clients look for when updating oldfile, which is\n"
+        "   <newfile>.<hash of oldfile>.ydlt.  Publish it alongside newfile.\n"
+        "\n"
+        "   The hash of newfile is also written to <newfile>.xxh64, which must be\n"
+        "   published alongside newfile.  Clients only use deltas that produce a file\n"
+        "   with this hash, and download the complete file otherwise.\n";
+
 /**
  Display usage text to the user.
  */
@@ -101,6 +120,20 @@ YpmCreateSourceHelp(VOID)
     return TRUE;
 }
 
+/**
+ Display usage text to the user.
+ */
+BOOL
+YpmCreateDeltaHelp(VOID)
+{
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Ypm %i.%02i\n"), YORI_VER_MAJOR, YORI_VER_MINOR);
+#if YORI_BUILD_ID
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Build %i\n"), YORI_BUILD_ID);
+#endif
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%hs"), strYpmCreateDeltaHelpText);
+    return TRUE;
+}
+
 /**
  Create a new package containing binary files that can be installed on a
  user's system.  These packages consist of files provided in a list of files.
@@ -378,5 +411,182 @@ YpmCreateSourcePackage(
     return EXIT_SUCCESS;
 }
 
+/**
+ Write the hash of a file as sixteen hex digits, which is the form clients
+ expect when checking the result of applying deltas.
+
+ @param HashFileName Pointer to the name of the file to write.
+
+ @param Hash The hash to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YpmWriteHashFile(
+    __in PYORI_STRING HashFileName,
+    __in DWORDLONG Hash
+    )
+{
+    HANDLE hFile;
+    CHAR Buffer[32];
+    DWORD BytesToWrite;
+    DWORD BytesWritten;
+    BOOL Result;
+
+    hFile = CreateFile(HashFileName->StartOfString,
+                       GENERIC_WRITE,
+                       0,
+                       NULL,
+                       CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL,
+                       NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    BytesToWrite = (DWORD)YoriLibSPrintfA(Buffer, "%016llx\r\n", Hash);
+
+    Result = FALSE;
+    if (WriteFile(hFile, Buffer, BytesToWrite, &BytesWritten, NULL) &&
+        BytesWritten == BytesToWrite) {
+
+        Result = TRUE;
+    }
+
+    CloseHandle(hFile);
+    return Result;
+}
+
+/**
+ Create a binary delta which converts an older version of a file into a newer
+ version, so clients updating the file can download the delta rather than
+ the complete file.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV An array of arguments.
+
+ @return Exit code of the process.
+ */
+DWORD
+YpmCreateDelta(
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[]
+    )
+{
+    BOOLEAN ArgumentUnderstood;
+    YORI_ALLOC_SIZE_T i;
+    YORI_ALLOC_SIZE_T StartArg = 0;
+    YORI_STRING Arg;
+    YORI_STRING OldFileName;
+    YORI_STRING NewFileName;
+    YORI_STRING DeltaFileName;
+    YORI_STRING HashFileName;
+    DWORDLONG FileSize;
+    DWORDLONG Hash;
+    DWORD ExitCode;
+
+    for (i = 1; i < ArgC; i++) {
+
+        ArgumentUnderstood = FALSE;
+        ASSERT(YoriLibIsStringNullTerminated(&ArgV[i]));
+
+        if (YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
+
+            if (YoriLibCompareStringLitIns(&Arg, _T("?")) == 0) {
+                YpmCreateDeltaHelp();
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
+                YoriLibDisplayMitLicense(_T("2017-2026"));
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
+                ArgumentUnderstood = TRUE;
+                StartArg = i + 1;
+                break;
+            }
+        } else {
+            ArgumentUnderstood = TRUE;
+            StartArg = i;
+            break;
+        }
+
+        if (!ArgumentUnderstood) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Argument not understood, ignored: %y\n"), &ArgV[i]);
+        }
+    }
+
+    if (StartArg == 0 || StartArg + 1 >= ArgC) {
+        YpmCreateDeltaHelp();
+        return EXIT_FAILURE;
+    }
+
+    YoriLibInitEmptyString(&OldFileName);
+    YoriLibInitEmptyString(&NewFileName);
+    YoriLibInitEmptyString(&DeltaFileName);
+    YoriLibInitEmptyString(&HashFileName);
+    ExitCode = EXIT_FAILURE;
+
+    if (!YoriLibUserStringToSingleFilePath(&ArgV[StartArg], FALSE, &OldFileName) ||
+        !YoriLibUserStringToSingleFilePath(&ArgV[StartArg + 1], FALSE, &NewFileName)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ypm: could not resolve file names\n"));
+        goto Exit;
+    }
+
+    if (StartArg + 2 < ArgC) {
+        if (!YoriLibUserStringToSingleFilePath(&ArgV[StartArg + 2], FALSE, &DeltaFileName)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ypm: could not resolve %y\n"), &ArgV[StartArg + 2]);
+            goto Exit;
+        }
+    } else {
+        if (!YoriLibDeltaHashFile(&OldFileName, &FileSize, &Hash)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ypm: could not read %y\n"), &OldFileName);
+            goto Exit;
+        }
+
+        YoriLibYPrintf(&DeltaFileName, _T("%y.%016llx.ydlt"), &NewFileName, Hash);
+        if (DeltaFileName.StartOfString == NULL) {
+            goto Exit;
+        }
+    }
+
+    if (!YoriLibCreateDelta(&OldFileName, &NewFileName, &DeltaFileName)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ypm: could not create delta %y\n"), &DeltaFileName);
+        goto Exit;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Created %y\n"), &DeltaFileName);
+
+    //
+    //  Clients only install the result of deltas if it matches the hash of
+    //  the complete file, so publish that too.
+    //
+
+    if (!YoriLibDeltaHashFile(&NewFileName, &FileSize, &Hash)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ypm: could not read %y\n"), &NewFileName);
+        goto Exit;
+    }
+
+    YoriLibYPrintf(&HashFileName, _T("%y.xxh64"), &NewFileName);
+    if (HashFileName.StartOfString == NULL) {
+        goto Exit;
+    }
+
+    if (!YpmWriteHashFile(&HashFileName, Hash)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ypm: could not write %y\n"), &HashFileName);
+        goto Exit;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Created %y\n"), &HashFileName);
+    ExitCode = EXIT_SUCCESS;
+
+Exit:
+    YoriLibFreeStringContents(&OldFileName);
+    YoriLibFreeStringContents(&NewFileName);
+    YoriLibFreeStringContents(&DeltaFileName);
+    YoriLibFreeStringContents(&HashFileName);
+    return ExitCode;
+}
 
 // vim:sw=4:ts=4:et:
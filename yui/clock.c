@@ -82,6 +82,47 @@ YuiClockDisplayBatteryInfo(
     YoriLibFreeStringContents(&Text);
 }
 
+/**
+ The number of milliseconds after the start of a minute that the clock timer
+ should fire.  Timers are not precise, so this ensures that the timer does
+ not fire just before the minute changes.
+ */
+#define YUI_CLOCK_TIMER_SLACK (250)
+
+/**
+ Set the clock timer to fire shortly after the next minute begins.  The
+ clock only displays hours and minutes, so there is no value in waking up
+ more frequently than that, and waking at the start of each minute allows
+ the displayed time to change when the minute does.
+
+ @param YuiContext Pointer to the application context.
+ */
+VOID
+YuiClockScheduleUpdate(
+    __in PYUI_CONTEXT YuiContext
+    )
+{
+    SYSTEMTIME CurrentLocalTime;
+    DWORD Delay;
+    DWORD_PTR TimerId;
+
+    GetLocalTime(&CurrentLocalTime);
+
+    Delay = (60 - (DWORD)CurrentLocalTime.wSecond) * 1000;
+    Delay = Delay - CurrentLocalTime.wMilliseconds + YUI_CLOCK_TIMER_SLACK;
+
+    //
+    //  Setting a timer with the same identifier replaces the existing one.
+    //  If this fails, leave the existing timer in place so the clock
+    //  continues to update, albeit at the wrong time.
+    //
+
+    TimerId = SetTimer(YuiContext->PrimaryMon->hWndTaskbar, YUI_CLOCK_TIMER, Delay, NULL);
+    if (TimerId != 0) {
+        YuiContext->ClockTimerId = TimerId;
+    }
+}
+
 /**
  Update the value displayed in the clock and battery indicators in the
  taskbar.
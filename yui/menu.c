@@ -129,6 +129,55 @@ typedef struct _YUI_MENU_FILE {
     DWORD MenuId;
 } YUI_MENU_FILE, *PYUI_MENU_FILE;
 
+/**
+ A structure describing the icon found by resolving a shortcut.  These are
+ retained across reloads of the start menu so that a shortcut which has not
+ changed since it was last loaded does not need to be opened again.
+ */
+typedef struct _YUI_MENU_SHORTCUT_CACHE_ENTRY {
+
+    /**
+     The entry for this shortcut within the hash table.  The key is the
+     fully qualified path to the shortcut.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The list linkage associating this entry with all other cached
+     shortcuts.  This is paired with
+     @ref YUI_MENU_CONTEXT::ShortcutCacheList .
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The last write time of the shortcut when it was resolved.
+     */
+    FILETIME LastWriteTime;
+
+    /**
+     The size of the shortcut when it was resolved.
+     */
+    DWORD FileSizeLow;
+
+    /**
+     The path to the file containing the icon.  This is empty if the
+     shortcut did not describe an icon.
+     */
+    YORI_STRING IconPath;
+
+    /**
+     The index of the icon within IconPath.
+     */
+    DWORD IconIndex;
+
+    /**
+     TRUE if the shortcut was found when the start menu was most recently
+     populated.  Entries that are not found are removed once population
+     completes.
+     */
+    BOOLEAN Found;
+} YUI_MENU_SHORTCUT_CACHE_ENTRY, *PYUI_MENU_SHORTCUT_CACHE_ENTRY;
+
 
 /**
  A context structure for the menu module.
@@ -145,6 +194,27 @@ typedef struct _YUI_MENU_CONTEXT {
      */
     YUI_MENU_DIRECTORY ProgramsDirectory;
 
+    /**
+     A hash table of shortcuts that have previously been resolved, keyed by
+     the fully qualified path to the shortcut.  This can be NULL if the
+     table could not be allocated, in which case every shortcut is resolved
+     each time the menu is populated.
+     */
+    PYORI_HASH_TABLE ShortcutCache;
+
+    /**
+     A list of all shortcuts that have previously been resolved.  This is
+     paired with @ref YUI_MENU_SHORTCUT_CACHE_ENTRY::ListEntry .
+     */
+    YORI_LIST_ENTRY ShortcutCacheList;
+
+    /**
+     TRUE if the start menu is being displayed or an item from it is being
+     executed.  While this is set, the menu must not be reloaded in the
+     background.
+     */
+    BOOLEAN TreeInUse;
+
     /**
      Owner draw state for a menu seperator.  This is reused for all of them,
      since they're all rendered the same.
@@ -358,6 +428,152 @@ YuiMenuCleanupItem(
     YoriLibFreeStringContents(&Item->Text);
 }
 
+/**
+ Free a previously resolved shortcut, removing it from the shortcut cache.
+
+ @param Entry Pointer to the entry to free.
+ */
+VOID
+YuiMenuShortcutCacheFreeEntry(
+    __in PYUI_MENU_SHORTCUT_CACHE_ENTRY Entry
+    )
+{
+    YoriLibRemoveListItem(&Entry->ListEntry);
+    YoriLibHashRemoveByEntry(&Entry->HashEntry);
+    YoriLibFreeStringContents(&Entry->IconPath);
+    YoriLibFree(Entry);
+}
+
+/**
+ Remove entries from the shortcut cache.  Entries for shortcuts that were not
+ found when the start menu was most recently populated are removed, and the
+ remaining entries are marked so the next population can determine which are
+ still present.
+
+ @param RemoveAll If TRUE, all entries are removed regardless of whether the
+        shortcut was found.
+ */
+VOID
+YuiMenuShortcutCachePrune(
+    __in BOOLEAN RemoveAll
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYUI_MENU_SHORTCUT_CACHE_ENTRY Entry;
+
+    if (YuiMenuContext.ShortcutCache == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&YuiMenuContext.ShortcutCacheList, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, YUI_MENU_SHORTCUT_CACHE_ENTRY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&YuiMenuContext.ShortcutCacheList, ListEntry);
+        if (RemoveAll || !Entry->Found) {
+            YuiMenuShortcutCacheFreeEntry(Entry);
+        } else {
+            Entry->Found = FALSE;
+        }
+    }
+}
+
+/**
+ Find the icon for a shortcut.  If the shortcut has been resolved previously
+ and has not changed since, the previous result is used.  Otherwise the
+ shortcut is opened and the result is retained for the next time the start
+ menu is populated.
+
+ @param FilePath Pointer to the fully qualified path to the shortcut.
+
+ @param FileInfo Pointer to information about the shortcut returned from
+        enumerating its directory.
+
+ @param IconPath On successful completion, updated to contain the path to the
+        file containing the icon.  The caller should free this with
+        @ref YoriLibFreeStringContents .
+
+ @param IconIndex On successful completion, updated to contain the index of
+        the icon within IconPath.
+
+ @return TRUE if the shortcut describes an icon, FALSE if it does not.
+ */
+__success(return)
+BOOL
+YuiMenuResolveShortcutIcon(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __out PYORI_STRING IconPath,
+    __out PDWORD IconIndex
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PYUI_MENU_SHORTCUT_CACHE_ENTRY Entry;
+    YORI_STRING Key;
+    BOOL Result;
+
+    if (YuiMenuContext.ShortcutCache != NULL) {
+        HashEntry = YoriLibHashLookupByKey(YuiMenuContext.ShortcutCache, FilePath);
+        if (HashEntry != NULL) {
+            Entry = (PYUI_MENU_SHORTCUT_CACHE_ENTRY)HashEntry->Context;
+            if (Entry->LastWriteTime.dwLowDateTime == FileInfo->ftLastWriteTime.dwLowDateTime &&
+                Entry->LastWriteTime.dwHighDateTime == FileInfo->ftLastWriteTime.dwHighDateTime &&
+                Entry->FileSizeLow == FileInfo->nFileSizeLow) {
+
+                Entry->Found = TRUE;
+                if (Entry->IconPath.LengthInChars == 0) {
+                    return FALSE;
+                }
+
+                YoriLibCloneString(IconPath, &Entry->IconPath);
+                *IconIndex = Entry->IconIndex;
+                return TRUE;
+            }
+
+            YuiMenuShortcutCacheFreeEntry(Entry);
+        }
+    }
+
+    YoriLibInitEmptyString(IconPath);
+    *IconIndex = 0;
+    Result = YoriLibLoadShortcutIconPath(FilePath, IconPath, IconIndex);
+
+    if (YuiMenuContext.ShortcutCache == NULL) {
+        return Result;
+    }
+
+    //
+    //  The path is in a buffer that is reused by the enumerate, so the key
+    //  needs its own allocation.
+    //
+
+    if (!YoriLibCopyString(&Key, FilePath)) {
+        return Result;
+    }
+
+    Entry = YoriLibMalloc(sizeof(YUI_MENU_SHORTCUT_CACHE_ENTRY));
+    if (Entry == NULL) {
+        YoriLibFreeStringContents(&Key);
+        return Result;
+    }
+
+    Entry->LastWriteTime.dwLowDateTime = FileInfo->ftLastWriteTime.dwLowDateTime;
+    Entry->LastWriteTime.dwHighDateTime = FileInfo->ftLastWriteTime.dwHighDateTime;
+    Entry->FileSizeLow = FileInfo->nFileSizeLow;
+    YoriLibInitEmptyString(&Entry->IconPath);
+    Entry->IconIndex = 0;
+    if (Result) {
+        YoriLibCloneString(&Entry->IconPath, IconPath);
+        Entry->IconIndex = *IconIndex;
+    }
+    Entry->Found = TRUE;
+
+    YoriLibHashInsertByKey(YuiMenuContext.ShortcutCache, &Key, Entry, &Entry->HashEntry);
+    YoriLibAppendList(&YuiMenuContext.ShortcutCacheList, &Entry->ListEntry);
+    YoriLibFreeStringContents(&Key);
+
+    return Result;
+}
+
 /**
  Cleanup state associated with the menu module.
  */
@@ -408,6 +624,12 @@ YuiMenuCleanupContext(VOID)
     YuiMenuCleanupItem(&YuiMenuContext.WinContextClose);
     YuiMenuCleanupItem(&YuiMenuContext.WinContextTerminateProcess);
     YuiMenuCleanupItem(&YuiMenuContext.WinContextLaunchNew);
+
+    YuiMenuShortcutCachePrune(TRUE);
+    if (YuiMenuContext.ShortcutCache != NULL) {
+        YoriLibFreeEmptyHashTable(YuiMenuContext.ShortcutCache);
+        YuiMenuContext.ShortcutCache = NULL;
+    }
 }
 
 /**
@@ -431,6 +653,14 @@ YuiMenuInitializeContext(
     YoriLibInitializeListHead(&YuiMenuContext.StartDirectory.ChildFiles);
     YuiMenuInitializeItem(&YuiMenuContext.StartDirectory.Item);
 
+    //
+    //  Failing to allocate the shortcut cache is not fatal; it just means
+    //  every shortcut is opened each time the menu is populated.
+    //
+
+    YoriLibInitializeListHead(&YuiMenuContext.ShortcutCacheList);
+    YuiMenuContext.ShortcutCache = YoriLibAllocateHashTable(250);
+
     YuiMenuInitializeItem(&YuiMenuContext.Seperator);
     YoriLibConstantString(&YuiMenuContext.Seperator.Text, _T(""));
     YuiMenuContext.Seperator.TallItem = FALSE;
@@ -754,6 +984,9 @@ YuiDeleteMenuDirectory(
 
  @param FilePath Pointer to the full path to a shortcut file for this entry.
 
+ @param FileInfo Pointer to information about the shortcut file returned
+        from enumerating its directory.
+
  @param FriendlyName Pointer to the human readable name for the file.
 
  @param TallItem TRUE if the item should be a full height item, FALSE if the
@@ -765,6 +998,7 @@ PYUI_MENU_FILE
 YuiCreateMenuFile(
     __in PYUI_CONTEXT YuiContext,
     __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
     __in PYORI_STRING FriendlyName,
     __in BOOLEAN TallItem
     )
@@ -807,7 +1041,7 @@ YuiCreateMenuFile(
     memcpy(Entry->Item.Text.StartOfString, FriendlyName->StartOfString, FriendlyName->LengthInChars * sizeof(TCHAR));
     Entry->Item.Text.StartOfString[Entry->Item.Text.LengthInChars] = '\0';
 
-    if (YoriLibLoadShortcutIconPath(FilePath, &IconPath, &IconIndex)) {
+    if (YuiMenuResolveShortcutIcon(FilePath, FileInfo, &IconPath, &IconIndex)) {
         YORI_STRING Ext;
 
         YoriLibInitEmptyString(&Ext);
@@ -1488,7 +1722,7 @@ YuiFileFoundCallback(
             if (YoriLibCompareStringLitIns(&Ext, _T(".lnk")) == 0 &&
                 YuiFindDepthComponent(FilePath, &FriendlyName, 0, TRUE)) {
 
-                NewFile = YuiCreateMenuFile(YuiContext, FilePath, &FriendlyName, TRUE);
+                NewFile = YuiCreateMenuFile(YuiContext, FilePath, FileInfo, &FriendlyName, TRUE);
                 if (NewFile != NULL) {
                     NewFile->Depth = Depth + 1;
                     YuiInsertFileInOrder(&YuiMenuContext.StartDirectory, NewFile);
@@ -1529,7 +1763,7 @@ YuiFileFoundCallback(
         if (Parent != NULL &&
             YoriLibCompareStringLitIns(&Ext, _T(".lnk")) == 0 &&
             YuiFindDepthComponent(FilePath, &FriendlyName, 0, TRUE)) {
-            NewFile = YuiCreateMenuFile(YuiContext, FilePath, &FriendlyName, FALSE);
+            NewFile = YuiCreateMenuFile(YuiContext, FilePath, FileInfo, &FriendlyName, FALSE);
             if (NewFile != NULL) {
                 NewFile->Depth = Depth + 1;
                 YuiInsertFileInOrder(Parent, NewFile);
@@ -1861,6 +2095,12 @@ YuiMenuPopulate(
                        YuiFileEnumerateErrorCallback,
                        YuiContext);
 
+    //
+    //  Discard any previously resolved shortcuts that no longer exist.
+    //
+
+    YuiMenuShortcutCachePrune(FALSE);
+
     //
     //  Populate the menus with human readable strings from the entries we
     //  just loaded, and assign each menu an identifier that corresponds
@@ -2054,6 +2294,9 @@ YuiMenuPopulateInBackground(
     }
 
     ThreadHandle = CreateThread(NULL, 0, YuiMenuPopulateWorker, YuiContext, 0, &ThreadId);
+    if (ThreadHandle == NULL) {
+        return FALSE;
+    }
     YuiContext->MenuPopulateThread = ThreadHandle;
     return TRUE;
 }
@@ -2119,6 +2362,45 @@ YuiMenuReloadIfChanged(
     return YuiMenuPopulate(YuiContext);
 }
 
+/**
+ Check if any change notification that is monitoring start menu changes has
+ detected a change, and if so, purge the old start menu and reload the new
+ one on a background thread.  This is invoked periodically so that the menu
+ is typically current before the user opens it, and opening it does not need
+ to wait for the file system.  If the menu is being displayed, or a previous
+ background reload is still in progress, this returns without checking, and
+ any change will be found on a later call.
+
+ @param YuiContext Pointer to the context containing the start menu and the
+        change notifications that are monitoring it.
+ */
+VOID
+YuiMenuReloadInBackgroundIfChanged(
+    __in PYUI_CONTEXT YuiContext
+    )
+{
+    if (YuiMenuContext.TreeInUse) {
+        return;
+    }
+
+    if (YuiContext->MenuPopulateThread != NULL) {
+        if (WaitForSingleObject(YuiContext->MenuPopulateThread, 0) != WAIT_OBJECT_0) {
+            return;
+        }
+        CloseHandle(YuiContext->MenuPopulateThread);
+        YuiContext->MenuPopulateThread = NULL;
+    }
+
+    if (!YuiMenuCheckForFileSystemChanges(YuiContext)) {
+        return;
+    }
+
+    YuiMenuFreeAll(YuiContext);
+    if (!YuiMenuPopulateInBackground(YuiContext)) {
+        YuiMenuPopulate(YuiContext);
+    }
+}
+
 /**
  A callback function invoked for all windows found in the system which may
  minimize a window in order to show the desktop.
@@ -2795,6 +3077,14 @@ YuiMenuDisplayAndExecute(
         return FALSE;
     }
 
+    //
+    //  Messages, including timers, are dispatched while the menu is
+    //  displayed and while the selected item is executed.  Prevent the
+    //  menu from being reloaded underneath either.
+    //
+
+    YuiMenuContext.TreeInUse = TRUE;
+
     DllUser32.pGetWindowRect(hWnd, &WindowRect);
 
     //
@@ -2831,6 +3121,8 @@ YuiMenuDisplayAndExecute(
         YuiTaskbarSwitchToActiveTask(YuiContext);
     }
 
+    YuiMenuContext.TreeInUse = FALSE;
+
     return TRUE;
 }
 
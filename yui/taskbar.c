@@ -392,6 +392,9 @@ YuiTaskbarAllocateAndAddButton(
     NewButton->WindowActive = FALSE;
     NewButton->AssociatedWindowFound = TRUE;
     NewButton->Flashing = FALSE;
+    NewButton->WindowIconValid = FALSE;
+    NewButton->WindowIconPending = FALSE;
+    NewButton->WindowIcon = NULL;
     NewButton->ProcessId = 0;
 
     CurrentTime = YoriLibGetSystemTimeAsInteger();
@@ -741,6 +744,49 @@ YuiTaskbarRepositionExistingButtons(
     EndDeferWindowPos(WindowPos);
 }
 
+/**
+ Request that the buttons on a taskbar are moved to reflect buttons being
+ added or removed.  Rather than moving them immediately, a message is posted
+ to the taskbar window, so a burst of changes such as many windows being
+ created or destroyed together results in a single layout pass.
+
+ @param YuiMonitor Pointer to the monitor context.
+ */
+VOID
+YuiTaskbarQueueReposition(
+    __in PYUI_MONITOR YuiMonitor
+    )
+{
+    if (YuiMonitor->RepositionPending) {
+        return;
+    }
+
+    YuiMonitor->RepositionPending = TRUE;
+    if (!PostMessage(YuiMonitor->hWndTaskbar, YUI_WM_REPOSITION_BUTTONS, 0, 0)) {
+        YuiMonitor->RepositionPending = FALSE;
+        YuiTaskbarRepositionExistingButtons(YuiMonitor);
+    }
+}
+
+/**
+ Move the buttons on a taskbar if a request to do so has been queued with
+ @ref YuiTaskbarQueueReposition .
+
+ @param YuiMonitor Pointer to the monitor context.
+ */
+VOID
+YuiTaskbarProcessQueuedReposition(
+    __in PYUI_MONITOR YuiMonitor
+    )
+{
+    if (!YuiMonitor->RepositionPending) {
+        return;
+    }
+
+    YuiMonitor->RepositionPending = FALSE;
+    YuiTaskbarRepositionExistingButtons(YuiMonitor);
+}
+
 /**
  Populate the taskbar with the set of windows that exist at the time the
  taskbar was created.
@@ -984,15 +1030,17 @@ YuiTaskbarNotifyResolutionChange(
 }
 
 /**
- A function invoked to indicate the existence of a new window.
+ Add a button for a window to the taskbar on a specified monitor.  The caller
+ is expected to have determined that the window should be displayed on the
+ taskbar and which monitor it is on.
 
- @param YuiContext Pointer to the application context.
+ @param YuiMonitor Pointer to the monitor context.
 
- @param hWnd The new window being created.
+ @param hWnd The window to add a button for.
  */
 VOID
-YuiTaskbarNotifyNewWindow(
-    __in PYUI_CONTEXT YuiContext,
+YuiTaskbarAddButtonForWindow(
+    __in PYUI_MONITOR YuiMonitor,
     __in HWND hWnd
     )
 {
@@ -1001,13 +1049,7 @@ YuiTaskbarNotifyNewWindow(
     DWORD WidthPerButton;
     PYORI_LIST_ENTRY ListEntry;
     RECT TaskbarWindowClient;
-    PYUI_MONITOR YuiMonitor;
 
-    if (!YuiTaskbarIncludeWindow(hWnd)) {
-        return;
-    }
-
-    YuiMonitor = YuiMonitorFromApplicationHwnd(YuiContext, hWnd);
     YuiTaskbarUpdateFullscreenStatus(YuiMonitor, hWnd);
 
     ThisButton = YuiTaskbarFindButtonFromHwndToActivate(YuiMonitor, hWnd);
@@ -1017,7 +1059,7 @@ YuiTaskbarNotifyNewWindow(
         }
     }
 
-    YuiTaskbarRepositionExistingButtons(YuiMonitor);
+    YuiTaskbarQueueReposition(YuiMonitor);
     WidthPerButton = YuiTaskbarCalculateButtonWidth(YuiMonitor);
     DllUser32.pGetClientRect(YuiMonitor->hWndTaskbar, &TaskbarWindowClient);
 
@@ -1044,6 +1086,29 @@ YuiTaskbarNotifyNewWindow(
     }
 }
 
+/**
+ A function invoked to indicate the existence of a new window.
+
+ @param YuiContext Pointer to the application context.
+
+ @param hWnd The new window being created.
+ */
+VOID
+YuiTaskbarNotifyNewWindow(
+    __in PYUI_CONTEXT YuiContext,
+    __in HWND hWnd
+    )
+{
+    PYUI_MONITOR YuiMonitor;
+
+    if (!YuiTaskbarIncludeWindow(hWnd)) {
+        return;
+    }
+
+    YuiMonitor = YuiMonitorFromApplicationHwnd(YuiContext, hWnd);
+    YuiTaskbarAddButtonForWindow(YuiMonitor, hWnd);
+}
+
 /**
  A function invoked to indicate that a window is being destroyed.
 
@@ -1084,7 +1149,7 @@ YuiTaskbarNotifyDestroyWindow(
             ASSERT(YuiMonitor->TaskbarButtonCount > 0);
             YuiMonitor->TaskbarButtonCount--;
         
-            YuiTaskbarRepositionExistingButtons(YuiMonitor);
+            YuiTaskbarQueueReposition(YuiMonitor);
         }
         YuiMonitor = YuiGetNextMonitor(YuiContext, YuiMonitor);
     }
@@ -1144,6 +1209,37 @@ YuiTaskbarNotifyActivateWindow(
     }
 }
 
+/**
+ Refresh the text of a taskbar button from the title of its window.
+
+ @param ThisButton Pointer to the button to update.
+ */
+VOID
+YuiTaskbarUpdateButtonText(
+    __in PYUI_TASKBAR_BUTTON ThisButton
+    )
+{
+    YORI_STRING NewTitle;
+    HWND hWnd;
+
+    hWnd = ThisButton->hWndToActivate;
+    YoriLibInitEmptyString(&NewTitle);
+    if (YoriLibAllocateString(&NewTitle, (YORI_ALLOC_SIZE_T)GetWindowTextLength(hWnd) + 1)) {
+        NewTitle.LengthInChars = (YORI_ALLOC_SIZE_T)GetWindowText(hWnd, NewTitle.StartOfString, NewTitle.LengthAllocated);
+        YoriLibFreeStringContents(&ThisButton->ButtonText);
+        memcpy(&ThisButton->ButtonText, &NewTitle, sizeof(YORI_STRING));
+        YuiTaskbarMungeButtonText(ThisButton);
+
+        //
+        //  This notification is also used to indicate the window's icon
+        //  has changed, so request it again when the button is redrawn.
+        //
+
+        ThisButton->WindowIconValid = FALSE;
+        RedrawWindow(ThisButton->hWndButton, NULL, NULL, RDW_ERASE | RDW_INVALIDATE);
+    }
+}
+
 /**
  A function invoked to indicate that a window's title is changing.
 
@@ -1187,17 +1283,9 @@ YuiTaskbarNotifyTitleChange(
         //  even if the title is removed.
         //
 
-        YuiTaskbarNotifyNewWindow(YuiContext, hWnd);
+        YuiTaskbarAddButtonForWindow(YuiMonitor, hWnd);
     } else {
-        YORI_STRING NewTitle;
-        YoriLibInitEmptyString(&NewTitle);
-        if (YoriLibAllocateString(&NewTitle, (YORI_ALLOC_SIZE_T)GetWindowTextLength(hWnd) + 1)) {
-            NewTitle.LengthInChars = (YORI_ALLOC_SIZE_T)GetWindowText(hWnd, NewTitle.StartOfString, NewTitle.LengthAllocated);
-            YoriLibFreeStringContents(&ThisButton->ButtonText);
-            memcpy(&ThisButton->ButtonText, &NewTitle, sizeof(YORI_STRING));
-            YuiTaskbarMungeButtonText(ThisButton);
-            RedrawWindow(ThisButton->hWndButton, NULL, NULL, RDW_ERASE | RDW_INVALIDATE);
-        }
+        YuiTaskbarUpdateButtonText(ThisButton);
     }
 }
 
@@ -1282,9 +1370,9 @@ YuiTaskbarSyncWindowCallback(
     }
 
     //
-    //  MSFIX Might want lower level helper functions since we've already
-    //  determined the monitor and the child functions here will do it
-    //  again
+    //  The window is known to be included and its monitor is known, so use
+    //  the lower level helpers rather than the notification functions,
+    //  which would evaluate both again.
     //
 
     YuiMonitor = YuiMonitorFromApplicationHwnd(YuiContext, hWnd);
@@ -1295,11 +1383,12 @@ YuiTaskbarSyncWindowCallback(
         //  If it doesn't have a button, go ahead and create a new one.
         //
 
-        YuiTaskbarNotifyNewWindow(YuiContext, hWnd);
+        YuiTaskbarAddButtonForWindow(YuiMonitor, hWnd);
     } else {
         ThisButton->AssociatedWindowFound = TRUE;
         if ((DWORD)GetWindowTextLength(ThisButton->hWndToActivate) != ThisButton->ButtonText.LengthInChars) {
-            YuiTaskbarNotifyTitleChange(YuiContext, hWnd);
+            YuiTaskbarUpdateFullscreenStatus(YuiMonitor, hWnd);
+            YuiTaskbarUpdateButtonText(ThisButton);
         }
     }
 
@@ -1608,6 +1697,64 @@ YuiTaskbarSwitchToActiveTask(
     }
 }
 
+/**
+ A callback invoked when a window responds to a request for its icon.  This
+ is invoked on the taskbar thread while it is processing messages.  Because
+ the button may have been destroyed or moved to a different monitor since the
+ request was sent, the button is found again from the window handle.
+
+ @param hWnd The window that responded.
+
+ @param Msg The message that was sent, which is WM_GETICON.
+
+ @param Context Pointer to the application context.
+
+ @param Result The icon returned by the window, or NULL if it did not return
+        one.
+ */
+VOID CALLBACK
+YuiTaskbarWindowIconCallback(
+    __in HWND hWnd,
+    __in UINT Msg,
+    __in ULONG_PTR Context,
+    __in LRESULT Result
+    )
+{
+    PYUI_CONTEXT YuiContext;
+    PYUI_MONITOR YuiMonitor;
+    PYUI_TASKBAR_BUTTON ThisButton;
+    HICON Icon;
+
+    UNREFERENCED_PARAMETER(Msg);
+
+    YuiContext = (PYUI_CONTEXT)Context;
+
+    Icon = (HICON)Result;
+    if (Icon == NULL) {
+        Icon = (HICON)GetClassLongPtr(hWnd, GCLP_HICONSM);
+    }
+
+    YuiMonitor = YuiGetNextMonitor(YuiContext, NULL);
+    while (YuiMonitor != NULL) {
+        ThisButton = YuiTaskbarFindButtonFromHwndToActivate(YuiMonitor, hWnd);
+        if (ThisButton != NULL && ThisButton->WindowIconPending) {
+            ThisButton->WindowIconPending = FALSE;
+
+            //
+            //  If the window changed while the request was outstanding,
+            //  WindowIconValid is clear, and redrawing the button will
+            //  request the icon again.
+            //
+
+            if (Icon != ThisButton->WindowIcon || !ThisButton->WindowIconValid) {
+                ThisButton->WindowIcon = Icon;
+                RedrawWindow(ThisButton->hWndButton, NULL, NULL, RDW_ERASE | RDW_INVALIDATE);
+            }
+        }
+        YuiMonitor = YuiGetNextMonitor(YuiContext, YuiMonitor);
+    }
+}
+
 /**
  Draw a taskbar button.
 
@@ -1627,8 +1774,6 @@ YuiTaskbarDrawButton(
 {
     PYUI_TASKBAR_BUTTON ThisButton;
     HICON Icon;
-    LRESULT Result;
-    DWORD_PTR MsgResult;
 
     ThisButton = YuiTaskbarFindButtonFromCtrlId(YuiMonitor, CtrlId);
     if (ThisButton == NULL) {
@@ -1636,19 +1781,25 @@ YuiTaskbarDrawButton(
     }
 
     //
-    //  Try to get the icon for the window.  This can invoke a different
-    //  process window procedure, and we're currently in the rendering path
-    //  of the taskbar.  Set a fairly small timeout - if the remote window
-    //  procedure doesn't respond really fast, just fall back to the class
-    //  icon.
+    //  Request the icon for the window if it is not known.  This invokes a
+    //  different process window procedure, and we're currently in the
+    //  rendering path of the taskbar, so the request is sent without
+    //  waiting.  Until the window responds, display the most recent icon
+    //  it returned, or the class icon if it has not returned one.  If the
+    //  request cannot be sent, the class icon is used until the window
+    //  changes.
     //
 
-    Icon = NULL;
-    Result = SendMessageTimeout(ThisButton->hWndToActivate, WM_GETICON, ICON_SMALL, 0, SMTO_ABORTIFHUNG | SMTO_BLOCK, 10, &MsgResult);
-    if (Result) {
-        Icon = (HICON)MsgResult;
+    if (!ThisButton->WindowIconValid && !ThisButton->WindowIconPending) {
+        ThisButton->WindowIconValid = TRUE;
+        if (SendMessageCallback(ThisButton->hWndToActivate, WM_GETICON, ICON_SMALL, 0, YuiTaskbarWindowIconCallback, (ULONG_PTR)YuiMonitor->YuiContext)) {
+            ThisButton->WindowIconPending = TRUE;
+        } else {
+            ThisButton->WindowIcon = NULL;
+        }
     }
 
+    Icon = ThisButton->WindowIcon;
     if (Icon == NULL) {
         Icon = (HICON)GetClassLongPtr(ThisButton->hWndToActivate, GCLP_HICONSM);
     }
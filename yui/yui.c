@@ -836,6 +836,10 @@ YuiTaskbarWindowProc(
                     break;
                 case YUI_CLOCK_TIMER:
                     YuiClockUpdate(&YuiContext, FALSE);
+                    YuiClockScheduleUpdate(&YuiContext);
+                    break;
+                case YUI_MENU_CHANGE_TIMER:
+                    YuiMenuReloadInBackgroundIfChanged(&YuiContext);
                     break;
             }
             return 0;
@@ -979,6 +983,16 @@ YuiTaskbarWindowProc(
         case WM_CTLCOLORBTN:
             return (LRESULT)YuiContext.BackgroundBrush;
             break;
+        case WM_TIMECHANGE:
+            YuiClockUpdate(&YuiContext, FALSE);
+            YuiClockScheduleUpdate(&YuiContext);
+            break;
+        case YUI_WM_REPOSITION_BUTTONS:
+            YuiMonitor = YuiMonitorFromTaskbarHwnd(&YuiContext, hwnd);
+            if (YuiMonitor != NULL) {
+                YuiTaskbarProcessQueuedReposition(YuiMonitor);
+            }
+            return 0;
         case WM_PAINT:
             YuiMonitor = YuiMonitorFromTaskbarHwnd(&YuiContext, hwnd);
             ASSERT(YuiMonitor != NULL);
@@ -1162,6 +1176,11 @@ YuiCleanupGlobalState(VOID)
         YuiContext.ClockTimerId = 0;
     }
 
+    if (YuiContext.MenuChangeTimerId != 0) {
+        KillTimer(hWndPrimaryTaskbar, YUI_MENU_CHANGE_TIMER);
+        YuiContext.MenuChangeTimerId = 0;
+    }
+
     if (YuiContext.SyncTimerId != 0) {
         KillTimer(hWndPrimaryTaskbar, YUI_WINDOW_POLL_TIMER);
         YuiContext.SyncTimerId = 0;
@@ -1633,7 +1652,8 @@ YuiInitializeApplication(
         }
     }
 
-    Context->ClockTimerId = SetTimer(hWnd, YUI_CLOCK_TIMER, 5000, NULL);
+    YuiClockScheduleUpdate(Context);
+    Context->MenuChangeTimerId = SetTimer(hWnd, YUI_MENU_CHANGE_TIMER, 2000, NULL);
 
     YuiTaskbarPopulateWindows(Context);
 
@@ -156,6 +156,25 @@ typedef struct _YUI_TASKBAR_BUTTON {
      */
     BOOLEAN Flashing;
 
+    /**
+     TRUE if WindowIcon reflects the most recent icon requested from the
+     window.  This is cleared when the window indicates it has changed, so
+     the icon is requested again.
+     */
+    BOOLEAN WindowIconValid;
+
+    /**
+     TRUE if a request for the window's icon has been sent and the window has
+     not yet responded.
+     */
+    BOOLEAN WindowIconPending;
+
+    /**
+     The icon to display for the window, or NULL if the window has not yet
+     provided one.  This handle is owned by the window, not by the taskbar.
+     */
+    HICON WindowIcon;
+
     /**
      The text to display on the taskbar button.
      */
@@ -369,6 +388,12 @@ typedef struct _YUI_MONITOR {
      */
     WORD TaskbarButtonCount;
 
+    /**
+     TRUE if a message has been posted to the taskbar window to move its
+     buttons, and that message has not yet been processed.
+     */
+    BOOLEAN RepositionPending;
+
     /**
      The next control ID to allocate for the next taskbar button.
      */
@@ -556,6 +581,12 @@ typedef struct _YUI_CONTEXT {
      */
     DWORD_PTR ClockTimerId;
 
+    /**
+     An identifier for a periodic timer used to check for changes to the
+     start menu.
+     */
+    DWORD_PTR MenuChangeTimerId;
+
     /**
      The string containing the current value of the clock display.  It is only
      updated if the value changes.
@@ -875,6 +906,19 @@ typedef struct _YUI_MENU_OWNERDRAW_ITEM {
  */
 #define YUI_CLOCK_TIMER (2)
 
+/**
+ The timer identifier of the timer that checks for changes to the start menu
+ so it can be reloaded before it is displayed.
+ */
+#define YUI_MENU_CHANGE_TIMER (3)
+
+/**
+ A message posted to a taskbar window to move its buttons after buttons have
+ been added or removed.  Posting this allows a series of changes to be
+ handled with a single layout pass.
+ */
+#define YUI_WM_REPOSITION_BUTTONS (WM_USER + 1)
+
 /**
  The first identifier for a user program within the start menu.  Other
  programs will have an identifier higher than this one.
@@ -1114,6 +1158,11 @@ YuiMenuWaitForBackgroundReload(
     __in PYUI_CONTEXT YuiContext
     );
 
+VOID
+YuiMenuReloadInBackgroundIfChanged(
+    __in PYUI_CONTEXT YuiContext
+    );
+
 BOOL
 YuiExecuteShortcut(
     __in PYUI_MONITOR YuiMonitor,
@@ -1285,6 +1334,11 @@ YuiTaskbarNotifyNewWindow(
     __in HWND hWnd
     );
 
+VOID
+YuiTaskbarProcessQueuedReposition(
+    __in PYUI_MONITOR YuiMonitor
+    );
+
 VOID
 YuiTaskbarNotifyDestroyWindow(
     __in PYUI_CONTEXT YuiContext,
@@ -1354,6 +1408,11 @@ YuiClockDisplayBatteryInfo(
     __in PYUI_MONITOR YuiMonitor
     );
 
+VOID
+YuiClockScheduleUpdate(
+    __in PYUI_CONTEXT YuiContext
+    );
+
 VOID
 YuiClockUpdate(
     __in PYUI_CONTEXT YuiContext,